@@ -96,7 +96,7 @@ Output parameters:
 The memory for array G has already been allocated in the calling subroutine,
 and it isn't necessary to allocate it in the FuncGrad subroutine.
 *************************************************************************/
-typedef void (*lbfgs_callback_function)(ap::real_1d_array x, double& f, ap::real_1d_array& g, void* data);
+typedef void (*lbfgs_callback_function)(const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* data);
 
 void lbfgsminimize(const int& n,
                    const int& m,
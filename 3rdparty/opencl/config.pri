@@ -0,0 +1,14 @@
+# OpenCL comes with the GPU vendor's SDK or the system's ICD loader
+# package. Set OPENCL_ROOT if the headers aren't in the default
+# include path.
+isEmpty(OPENCL_ROOT): OPENCL_ROOT = $$(OPENCL_ROOT)
+
+!isEmpty(OPENCL_ROOT):exists($$OPENCL_ROOT/include/CL/cl.h) {
+  INCLUDEPATH += $$OPENCL_ROOT/include
+  win32: LIBS += -L$$OPENCL_ROOT/lib/x64
+  else: LIBS += -L$$OPENCL_ROOT/lib
+  EXT_ENABLED = true
+}
+unix:!macx:exists(/usr/include/CL/cl.h): EXT_ENABLED = true
+
+LIBS += -lOpenCL
@@ -98,6 +98,13 @@ defineReplace(forcedLink) {
 PRO_FILE_BASENAME = $$basename(_PRO_FILE_)
 PRO_FILE_BASENAME = $$replace(PRO_FILE_BASENAME, .pro, "")
 
+# "qmake DISABLE+=statistics" compiles out the collection of
+# processing time statistics in operations.
+contains(DISABLE,statistics):DEFINES += PII_NO_OPERATION_STATISTICS
+# "qmake DISABLE+=matrixaccounting" compiles out the accounting of
+# matrix allocations and copies.
+contains(DISABLE,matrixaccounting):DEFINES += PII_NO_MATRIX_ACCOUNTING
+
 include(qt5.pri)
 include(c++11.pri)
 include(extensions.pri)
@@ -64,8 +64,25 @@ public:
    * built by a weighted sum of the nearest neighbors. With
    * two-dimensional signals, linear interpolation is in fact
    * bi-linear.
+   *
+   * - `CubicInterpolation` means that the interpolated value is a
+   * weighted sum of the four nearest neighbors in each dimension.
+   * The weights are given by a cubic convolution kernel.
+   *
+   * - `AreaInterpolation` means that the interpolated value is the
+   * average over the area a discrete sample covers in the original
+   * signal. It is meant for reducing the sampling rate.
+   *
+   * Cubic and area interpolation are currently supported only by
+   * PiiImage::scale().
    */
-  enum Interpolation { NearestNeighborInterpolation, LinearInterpolation };
+  enum Interpolation
+    {
+      NearestNeighborInterpolation,
+      LinearInterpolation,
+      CubicInterpolation,
+      AreaInterpolation
+    };
 
   /**
    * An enumeration that specifies the direction of operation for
@@ -18,8 +18,12 @@
 
 #include "PiiGlobal.h"
 #include "PiiTypeTraits.h"
+#include "PiiParallel.h"
+#include <algorithm>
+#include <functional>
 #include <cstdarg>
 #include <cstdlib>
+#include <climits>
 
 #define PII_DIFF_TYPE typename std::iterator_traits<Iterator>::difference_type
 
@@ -619,6 +623,116 @@ namespace Pii
   {
     shuffleN(begin, end-begin);
   }
+
+  /// @hide
+  template <class Iterator> class ParallelSortChunks
+  {
+  public:
+    ParallelSortChunks(Iterator begin, Iterator end, int chunks) :
+      _begin(begin), _size(end - begin), _iChunks(chunks)
+    {}
+
+    Iterator chunk(int index) const
+    {
+      return _begin + PII_DIFF_TYPE(qint64(_size) * qMin(index, _iChunks) / _iChunks);
+    }
+
+  private:
+    Iterator _begin;
+    PII_DIFF_TYPE _size;
+    int _iChunks;
+  };
+
+  template <class Iterator, class LessThan> struct ParallelSorter
+  {
+    ParallelSorter(const ParallelSortChunks<Iterator>& chunks, LessThan lessThan) :
+      chunks(chunks), lessThan(lessThan)
+    {}
+
+    void operator() (int firstChunk, int endChunk)
+    {
+      for (int i=firstChunk; i<endChunk; ++i)
+        std::sort(chunks.chunk(i), chunks.chunk(i+1), lessThan);
+    }
+
+    const ParallelSortChunks<Iterator>& chunks;
+    LessThan lessThan;
+  };
+
+  // Merges pairs of sorted runs of *width* chunks each.
+  template <class Iterator, class LessThan> struct ParallelMerger
+  {
+    ParallelMerger(const ParallelSortChunks<Iterator>& chunks, LessThan lessThan, int width) :
+      chunks(chunks), lessThan(lessThan), iWidth(width)
+    {}
+
+    void operator() (int firstPair, int endPair)
+    {
+      for (int i=firstPair; i<endPair; ++i)
+        std::inplace_merge(chunks.chunk(2*i*iWidth),
+                           chunks.chunk((2*i+1)*iWidth),
+                           chunks.chunk((2*i+2)*iWidth),
+                           lessThan);
+    }
+
+    const ParallelSortChunks<Iterator>& chunks;
+    LessThan lessThan;
+    int iWidth;
+  };
+  /// @endhide
+
+  /**
+   * Sorts [*begin*, *end*) concurrently using the threads allowed by
+   * *policy*. The range is divided into chunks that are first sorted
+   * with `std::sort()` in parallel and then merged pairwise, each
+   * level of merges again in parallel. The sort is not stable.
+   *
+   * The minimum strip size of the policy is measured in units of 1024
+   * elements. With the default policy, a chunk thus holds at least
+   * 32768 elements, and smaller ranges are sorted in the calling
+   * thread.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matData(1, 10000000);
+   * // Sort the only row of a large matrix
+   * Pii::parallelSort(matData.rowBegin(0), matData.rowEnd(0), std::less<float>());
+   * ~~~
+   */
+  template <class Iterator, class LessThan>
+  void parallelSort(Iterator begin, Iterator end, LessThan lessThan,
+                    const PiiParallelPolicy& policy = PiiParallelPolicy())
+  {
+    const qint64 iSize = end - begin;
+    const int iChunks = policy.stripCount(int(qMin(iSize / 1024, qint64(INT_MAX))));
+    if (iChunks <= 1)
+      {
+        std::sort(begin, end, lessThan);
+        return;
+      }
+
+    ParallelSortChunks<Iterator> chunks(begin, end, iChunks);
+    // One strip per chunk
+    ParallelSorter<Iterator,LessThan> sorter(chunks, lessThan);
+    forEachStrip(iChunks, sorter, PiiParallelPolicy(iChunks, 1));
+
+    for (int iWidth = 1; iWidth < iChunks; iWidth *= 2)
+      {
+        const int iPairs = (iChunks + 2*iWidth - 1) / (2*iWidth);
+        ParallelMerger<Iterator,LessThan> merger(chunks, lessThan, iWidth);
+        forEachStrip(iPairs, merger, PiiParallelPolicy(iPairs, 1));
+      }
+  }
+
+  /**
+   * Sorts [*begin*, *end*) into ascending order concurrently. See
+   * [parallelSort()].
+   */
+  template <class Iterator>
+  inline void parallelSort(Iterator begin, Iterator end,
+                           const PiiParallelPolicy& policy = PiiParallelPolicy())
+  {
+    parallelSort(begin, end, std::less<typename std::iterator_traits<Iterator>::value_type>(), policy);
+  }
 }
 
 #endif //_PIIALGORITHM_H
@@ -45,6 +45,18 @@ struct PiiAtomicIntImpl
   int operator-- () { return --i; }
   int operator-- (int) { return i--; }
   int operator-= (int val) { return i -= val; }
+  int exchange(int desired)
+  {
+    int old = i;
+    i = desired;
+    return old;
+  }
+  bool compare_exchange_strong(int& expected, int desired)
+  {
+    if (i != expected) { expected = i; return false; }
+    i = desired;
+    return true;
+  }
   bool operator== (const PiiAtomicIntImpl& other) const { return i == other.i; }
   bool operator!= (const PiiAtomicIntImpl& other) const { return i != other.i; }
   int i;
@@ -61,11 +73,21 @@ class PII_CORE_EXPORT PiiAtomicInt
 {
 public:
   PiiAtomicInt(int value = 0) : _value(value) {}
+  // QAtomicInt can be copied, std::atomic_int cannot.
+  PiiAtomicInt(const PiiAtomicInt& other) : _value(other.load()) {}
+  PiiAtomicInt& operator= (const PiiAtomicInt& other) { _value.store(other.load()); return *this; }
 
   void ref() { ++_value; }
   int deref() { return --_value; }
   int load() const { return _value.load(); }
   void store(int value) { _value.store(value); }
+#  ifdef PII_CXX11
+  int loadAcquire() const { return _value.load(std::memory_order_acquire); }
+  void storeRelease(int value) { _value.store(value, std::memory_order_release); }
+#  else
+  int loadAcquire() const { return _value.load(); }
+  void storeRelease(int value) { _value.store(value); }
+#  endif
 
   int operator++ () { return ++_value; }
   int operator++ (int) { return _value++; }
@@ -74,6 +96,9 @@ public:
   int operator+= (int value) { return _value += value; }
   int operator-= (int value) { return _value -= value; }
 
+  bool testAndSet(int expected, int newValue) { return _value.compare_exchange_strong(expected, newValue); }
+  int fetchAndStore(int newValue) { return _value.exchange(newValue); }
+
   bool operator== (const PiiAtomicInt& other) const { return _value.load() == other.load(); }
   bool operator!= (const PiiAtomicInt& other) const { return _value.load() != other.load(); }
   bool operator== (int value) const { return _value.load() == value; }
@@ -112,12 +137,33 @@ public:
 #endif
   }
 
+  int loadAcquire() const
+  {
+#if QT_VERSION >= 0x050000
+    return _value.loadAcquire();
+#else
+    return const_cast<QAtomicInt&>(_value).fetchAndAddAcquire(0);
+#endif
+  }
+
+  void storeRelease(int value)
+  {
+#if QT_VERSION >= 0x050000
+    _value.storeRelease(value);
+#else
+    _value.fetchAndStoreRelease(value);
+#endif
+  }
+
   int operator++ () { return _value.fetchAndAddOrdered(1) + 1; }
   int operator++ (int) { return _value.fetchAndAddOrdered(1); }
   int operator-- () { return _value.fetchAndAddOrdered(-1) - 1; }
   int operator-- (int) { return _value.fetchAndAddOrdered(-1); }
   int operator+= (int value) { return _value.fetchAndAddOrdered(value) + value; }
-  int operator-= (int value) { return _value.fetchAndAddOrdered(value) - value; }
+  int operator-= (int value) { return _value.fetchAndAddOrdered(-value) - value; }
+
+  bool testAndSet(int expected, int newValue) { return _value.testAndSetOrdered(expected, newValue); }
+  int fetchAndStore(int newValue) { return _value.fetchAndStoreOrdered(newValue); }
 
   bool operator== (const PiiAtomicInt& other) const { return load() == other.load(); }
   bool operator!= (const PiiAtomicInt& other) const { return load() != other.load(); }
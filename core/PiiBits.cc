@@ -21,13 +21,13 @@ namespace Pii
 {
   int countOnes(unsigned int c, const unsigned char bits)
   {
-    int count = 0;
-    for (int i=0;i<bits;i++)
-      {
-        count += c & 1; //add the lsb
-        c >>= 1; //take next bit to lsb
-      }
-    return count;
+    if (bits < INTBITS)
+      c &= (1u << bits) - 1;
+    // Sum up bit fields of increasing width in parallel.
+    c -= (c >> 1) & 0x55555555u;
+    c = (c & 0x33333333u) + ((c >> 2) & 0x33333333u);
+    c = (c + (c >> 4)) & 0x0f0f0f0fu;
+    return int((c * 0x01010101u) >> 24);
   }
 
   int countTransitions(unsigned int c, const unsigned char bits)
@@ -0,0 +1,88 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIBUFFERLEASE_H
+#define _PIIBUFFERLEASE_H
+
+#include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
+
+/**
+ * A reference-counted lease on a memory buffer owned by someone
+ * else. Leases make it possible to wrap memory such as a camera
+ * driver's DMA buffers into [PiiMatrix] instances without copying.
+ * The owner creates a lease when it hands out a buffer and is
+ * notified through [returnBuffer()] once the last user has released
+ * it. Until then, the owner must not reuse the buffer.
+ *
+ * ~~~(c++)
+ * class MyLease : public PiiBufferLease
+ * {
+ * public:
+ *   MyLease(MyRing* ring, int index) : _pRing(ring), _iIndex(index) {}
+ * protected:
+ *   void returnBuffer() { _pRing->requeue(_iIndex); }
+ * private:
+ *   MyRing* _pRing;
+ *   int _iIndex;
+ * };
+ *
+ * PiiBufferLease* pLease = new MyLease(pRing, iIndex);
+ * PiiMatrix<uchar> image(iHeight, iWidth, pRing->buffer(iIndex), pLease);
+ * pLease->release(); // image holds a reference
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiBufferLease
+{
+public:
+  /**
+   * Increases the reference count by one.
+   */
+  void reserve() { _ref.ref(); }
+
+  /**
+   * Decreases the reference count by one. Once the count reaches
+   * zero, calls [returnBuffer()] and deletes this object.
+   */
+  void release()
+  {
+    if (!_ref.deref())
+      {
+        returnBuffer();
+        delete this;
+      }
+  }
+
+protected:
+  /**
+   * Creates a new lease with a reference count of one.
+   */
+  PiiBufferLease() : _ref(1) {}
+  virtual ~PiiBufferLease();
+
+  /**
+   * Called when the last reference to the lease has been released.
+   * The implementation must give the buffer back to its owner. This
+   * function may be called in any thread.
+   */
+  virtual void returnBuffer() = 0;
+
+private:
+  PiiAtomicInt _ref;
+
+  PII_DISABLE_COPY(PiiBufferLease);
+};
+
+#endif //_PIIBUFFERLEASE_H
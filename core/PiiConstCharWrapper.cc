@@ -17,17 +17,13 @@
 
 uint qHash(const PiiConstCharWrapper& key)
 {
-  uint h = 0;
-  uint g;
-
-  const char* p = key.ptr;
-  int n = std::strlen(p);
-  while (n--)
+  // FNV-1a in a single pass over the string. Class names share long
+  // prefixes, and this mixes every byte into all bits.
+  uint h = 2166136261u;
+  for (const unsigned char* p = reinterpret_cast<const unsigned char*>(key.ptr); *p != 0; ++p)
     {
-      h = (h << 4) + (*p++);
-      if ((g = (h & 0xf0000000)) != 0)
-        h ^= g >> 23;
-      h &= ~g;
+      h ^= *p;
+      h *= 16777619u;
     }
   return h;
 }
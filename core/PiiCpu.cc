@@ -0,0 +1,296 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCpu.h"
+
+#if defined(PII_X86)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#if defined(__linux__)
+#  include <sched.h>
+#  include <unistd.h>
+#  include <cstdio>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+namespace Pii
+{
+#if defined(PII_X86)
+  static void cpuid(int leaf, unsigned int regs[4])
+  {
+#  if defined(_MSC_VER)
+    __cpuidex(reinterpret_cast<int*>(regs), leaf, 0);
+#  else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#  endif
+  }
+
+  static unsigned long long xgetbv()
+  {
+#  if defined(_MSC_VER)
+    return _xgetbv(0);
+#  else
+    unsigned int eax, edx;
+    __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#  endif
+  }
+#endif
+
+  static int probeCpuFeatures()
+  {
+    int iFeatures = 0;
+#if defined(PII_X86)
+    unsigned int regs[4];
+    cpuid(0, regs);
+    const unsigned int uiMaxLeaf = regs[0];
+    if (uiMaxLeaf < 1)
+      return 0;
+    cpuid(1, regs);
+    if (regs[3] & (1 << 26))
+      iFeatures |= CpuSse2;
+    if (regs[2] & (1 << 19))
+      iFeatures |= CpuSse41;
+    // AVX2 is usable only if the OS has enabled the XMM and YMM
+    // state (OSXSAVE and XCR0 bits 1 and 2). AVX-512 additionally
+    // needs the opmask and ZMM state (XCR0 bits 5-7).
+    const bool bOsXsave = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28));
+    const unsigned long long ullXcr0 = bOsXsave ? xgetbv() : 0;
+    if ((ullXcr0 & 0x6) == 0x6 && uiMaxLeaf >= 7)
+      {
+        cpuid(7, regs);
+        if (regs[1] & (1 << 5))
+          iFeatures |= CpuAvx2;
+        if ((ullXcr0 & 0xe6) == 0xe6 &&
+            (regs[1] & (1 << 16)) && (regs[1] & (1 << 30)))
+          iFeatures |= CpuAvx512;
+      }
+#elif defined(PII_NEON)
+    iFeatures |= CpuNeon;
+#endif
+    return iFeatures;
+  }
+
+  // Parses the value of PII_CPU_FEATURES. Unknown names are ignored.
+  static int initialCpuFeatureMask()
+  {
+    const char* pFeatures = std::getenv("PII_CPU_FEATURES");
+    if (pFeatures == 0 || *pFeatures == 0)
+      return -1;
+
+    static const struct { const char* pName; int iFeature; } aNames[] =
+      {
+        { "sse2", CpuSse2 },
+        { "sse41", CpuSse41 },
+        { "avx2", CpuAvx2 },
+        { "neon", CpuNeon },
+        { "avx512", CpuAvx512 },
+        { "none", 0 }
+      };
+    int iMask = 0;
+    while (*pFeatures != 0)
+      {
+        size_t iLength = std::strcspn(pFeatures, ",");
+        for (size_t i=0; i<sizeof(aNames)/sizeof(aNames[0]); ++i)
+          if (std::strlen(aNames[i].pName) == iLength &&
+              std::strncmp(aNames[i].pName, pFeatures, iLength) == 0)
+            iMask |= aNames[i].iFeature;
+        pFeatures += iLength;
+        if (*pFeatures == ',')
+          ++pFeatures;
+      }
+    return iMask;
+  }
+
+  // Both values are initialized on first use. The race between
+  // threads initializing them simultaneously is benign since all of
+  // them store the same value.
+  static volatile int& cpuFeatureMaskRef()
+  {
+    static volatile int iCpuFeatureMask = initialCpuFeatureMask();
+    return iCpuFeatureMask;
+  }
+
+  int cpuFeatures()
+  {
+    static const int iFeatures = probeCpuFeatures();
+    return iFeatures & cpuFeatureMaskRef();
+  }
+
+  void setCpuFeatureMask(int mask)
+  {
+    cpuFeatureMaskRef() = mask;
+  }
+
+  int cpuFeatureMask()
+  {
+    return cpuFeatureMaskRef();
+  }
+
+  struct CpuTopology
+  {
+    CpuTopology();
+
+    QList<QList<int> > lstNodeCpus;
+    // Index: CPU, value: node
+    QList<int> lstCpuNodes;
+  };
+
+#if defined(__linux__)
+  // Parses a sysfs CPU list such as "0-3,8-11".
+  static QList<int> readCpuList(const char* fileName)
+  {
+    QList<int> lstCpus;
+    FILE* pFile = std::fopen(fileName, "r");
+    if (pFile == 0)
+      return lstCpus;
+    int iFirst, iLast;
+    char cSeparator;
+    while (std::fscanf(pFile, "%d", &iFirst) == 1)
+      {
+        iLast = iFirst;
+        int iChars = std::fscanf(pFile, "%c", &cSeparator);
+        if (iChars == 1 && cSeparator == '-')
+          {
+            if (std::fscanf(pFile, "%d", &iLast) != 1)
+              break;
+            iChars = std::fscanf(pFile, "%c", &cSeparator);
+          }
+        for (int i=iFirst; i<=iLast; ++i)
+          lstCpus << i;
+        if (iChars != 1 || cSeparator != ',')
+          break;
+      }
+    std::fclose(pFile);
+    return lstCpus;
+  }
+
+  static int configuredCpuCount()
+  {
+    long lCount = sysconf(_SC_NPROCESSORS_CONF);
+    return lCount > 0 ? int(lCount) : 1;
+  }
+#else
+  static int configuredCpuCount() { return 1; }
+#endif
+
+  CpuTopology::CpuTopology()
+  {
+#if defined(__linux__)
+    char aFileName[64];
+    for (int iNode=0; ; ++iNode)
+      {
+        std::sprintf(aFileName, "/sys/devices/system/node/node%d/cpulist", iNode);
+        QList<int> lstCpus(readCpuList(aFileName));
+        if (lstCpus.isEmpty())
+          break;
+        lstNodeCpus << lstCpus;
+      }
+#endif
+    int iCpuCount = configuredCpuCount();
+    for (int i=0; i<lstNodeCpus.size(); ++i)
+      for (int j=0; j<lstNodeCpus[i].size(); ++j)
+        if (lstNodeCpus[i][j] >= iCpuCount)
+          iCpuCount = lstNodeCpus[i][j] + 1;
+    for (int i=0; i<iCpuCount; ++i)
+      lstCpuNodes << 0;
+
+    // Unknown topology: all CPUs are in node 0.
+    if (lstNodeCpus.isEmpty())
+      {
+        QList<int> lstCpus;
+        for (int i=0; i<iCpuCount; ++i)
+          lstCpus << i;
+        lstNodeCpus << lstCpus;
+      }
+    else
+      for (int i=0; i<lstNodeCpus.size(); ++i)
+        for (int j=0; j<lstNodeCpus[i].size(); ++j)
+          lstCpuNodes[lstNodeCpus[i][j]] = i;
+  }
+
+  static const CpuTopology& topology()
+  {
+    static const CpuTopology topology;
+    return topology;
+  }
+
+  int numaNodeCount()
+  {
+    return topology().lstNodeCpus.size();
+  }
+
+  QList<int> numaNodeCpus(int node)
+  {
+    const CpuTopology& t = topology();
+    if (node < 0 || node >= t.lstNodeCpus.size())
+      return QList<int>();
+    return t.lstNodeCpus[node];
+  }
+
+  int numaNodeOfCpu(int cpu)
+  {
+    const CpuTopology& t = topology();
+    if (cpu < 0 || cpu >= t.lstCpuNodes.size())
+      return 0;
+    return t.lstCpuNodes[cpu];
+  }
+
+  int currentCpu()
+  {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+  }
+
+  int currentNumaNode()
+  {
+    if (numaNodeCount() == 1)
+      return 0;
+    return numaNodeOfCpu(currentCpu());
+  }
+
+  bool setThreadAffinity(const QList<int>& cpus)
+  {
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (cpus.isEmpty())
+      {
+        int iCpuCount = topology().lstCpuNodes.size();
+        for (int i=0; i<iCpuCount && i<CPU_SETSIZE; ++i)
+          CPU_SET(i, &cpuSet);
+      }
+    else
+      for (int i=0; i<cpus.size(); ++i)
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+          CPU_SET(cpus[i], &cpuSet);
+    // On Linux, pid zero refers to the calling thread.
+    return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+    Q_UNUSED(cpus);
+    return false;
+#endif
+  }
+}
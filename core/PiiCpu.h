@@ -0,0 +1,159 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICPU_H
+#define _PIICPU_H
+
+#include "PiiGlobal.h"
+#include <QList>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define PII_X86 1
+// GCC and Clang can compile functions for instruction sets not
+// enabled on the command line. The function must be called only if
+// the CPU supports the instruction set.
+#  define PII_TARGET(ISA) __attribute__ ((target(ISA)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define PII_X86 1
+#  define PII_TARGET(ISA)
+#else
+#  define PII_TARGET(ISA)
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  define PII_NEON 1
+#endif
+
+namespace Pii
+{
+  /**
+   * Instruction set extensions that may be used by optimized
+   * algorithm implementations.
+   *
+   * - `CpuSse2` - SSE2 (always present on x86-64)
+   * - `CpuSse41` - SSE4.1
+   * - `CpuAvx2` - AVX2. Implies that the operating system saves the
+   * YMM registers on context switches.
+   * - `CpuNeon` - ARM NEON (Advanced SIMD)
+   * - `CpuAvx512` - AVX-512 foundation and byte/word instructions
+   * (F and BW). Implies that the operating system saves the ZMM
+   * registers on context switches.
+   */
+  enum CpuFeature
+  {
+    CpuSse2 = 0x1,
+    CpuSse41 = 0x2,
+    CpuAvx2 = 0x4,
+    CpuNeon = 0x8,
+    CpuAvx512 = 0x10
+  };
+
+  /**
+   * Returns the instruction set extensions supported by the CPU the
+   * program is running on, masked by [setCpuFeatureMask()]. The
+   * return value is a bitwise OR of [CpuFeature] values. The CPU is
+   * probed only once.
+   *
+   * ~~~(c++)
+   * if (Pii::cpuFeatures() & Pii::CpuAvx2)
+   *   filterAvx2(image);
+   * else
+   *   filterGeneric(image);
+   * ~~~
+   */
+  PII_CORE_EXPORT int cpuFeatures();
+
+  /**
+   * Returns `true` if *feature* is supported by the CPU and not
+   * masked out by [setCpuFeatureMask()].
+   */
+  inline bool hasCpuFeature(CpuFeature feature) { return (cpuFeatures() & feature) != 0; }
+
+  /**
+   * Restricts the instruction set extensions reported by
+   * [cpuFeatures()] to those set in *mask*. This makes it possible to
+   * benchmark and test generic code paths on any hardware. Setting
+   * the mask to zero disables all optimized code paths; setting it to
+   * -1 enables all supported ones.
+   *
+   * The initial mask is read from the `PII_CPU_FEATURES` environment
+   * variable. It is a comma-separated list of feature names (`sse2`,
+   * `sse41`, `avx2`, `avx512`, `neon`) or `none`. If the variable is
+   * not set, all features are enabled. For example, the following
+   * runs a benchmark without AVX2 and AVX-512 code paths:
+   *
+   * ~~~
+   * PII_CPU_FEATURES=sse2,sse41 ./benchmark
+   * ~~~
+   */
+  PII_CORE_EXPORT void setCpuFeatureMask(int mask);
+  /**
+   * Returns the current feature mask.
+   */
+  PII_CORE_EXPORT int cpuFeatureMask();
+
+  /**
+   * Returns the number of NUMA nodes in the system. If the topology
+   * cannot be determined, returns one. The topology is probed only
+   * once.
+   */
+  PII_CORE_EXPORT int numaNodeCount();
+
+  /**
+   * Returns the indices of the logical CPUs that belong to NUMA
+   * *node*. If the topology is unknown, node 0 contains all CPUs.
+   * Returns an empty list if *node* is out of range.
+   */
+  PII_CORE_EXPORT QList<int> numaNodeCpus(int node);
+
+  /**
+   * Returns the NUMA node logical CPU *cpu* belongs to, or 0 if the
+   * topology is unknown.
+   */
+  PII_CORE_EXPORT int numaNodeOfCpu(int cpu);
+
+  /**
+   * Returns the index of the logical CPU the calling thread is
+   * currently running on, or -1 if this cannot be determined. Unless
+   * the thread has been pinned with [setThreadAffinity()], the value
+   * may be out of date as soon as the function returns.
+   */
+  PII_CORE_EXPORT int currentCpu();
+
+  /**
+   * Returns the NUMA node the calling thread is currently running
+   * on. Returns 0 on single-node systems and if the node cannot be
+   * determined.
+   */
+  PII_CORE_EXPORT int currentNumaNode();
+
+  /**
+   * Restricts the calling thread to the logical CPUs listed in
+   * *cpus*. An empty list allows the thread to run on any CPU.
+   * Returns `true` on success and `false` if the operating system
+   * rejected the request or thread affinity is not supported on the
+   * platform.
+   *
+   * ~~~(c++)
+   * // Keep the calling thread close to memory on node 1.
+   * Pii::setThreadAffinity(Pii::numaNodeCpus(1));
+   * ~~~
+   *
+   * ! Thread affinity is currently supported on Linux only.
+   */
+  PII_CORE_EXPORT bool setThreadAffinity(const QList<int>& cpus);
+}
+
+#endif //_PIICPU_H
@@ -0,0 +1,167 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICPUDISPATCHER_H
+#define _PIICPUDISPATCHER_H
+
+#include "PiiCpu.h"
+
+/**
+ * Selects one of many implementations of a function based on the
+ * instruction set extensions of the CPU. Each implementation is
+ * registered with the set of [Pii::CpuFeature] flags it requires.
+ * [function()] returns the first registered implementation whose
+ * requirements are met by [Pii::cpuFeatures()], or the generic
+ * implementation given to the constructor if none is.
+ * Implementations should therefore be added in order of preference,
+ * the fastest one first.
+ *
+ * The choice is made on the first call and cached. It is redone
+ * only if the enabled features change, which happens if
+ * [Pii::setCpuFeatureMask()] is called. Thus, the `PII_CPU_FEATURES`
+ * environment variable and the feature mask control all dispatchers
+ * in the same way, and a dispatcher can be used in tight loops.
+ *
+ * The generic implementation may be a null pointer. In this case the
+ * caller must check the return value of [function()] and fall back
+ * to its own scalar code.
+ *
+ * ~~~(c++)
+ * typedef void (*SumFunction)(const float*, int, float*);
+ *
+ * static const PiiCpuDispatcher<SumFunction> sumDispatcher =
+ *   PiiCpuDispatcher<SumFunction>(sumGeneric)
+ *   .add(Pii::CpuAvx2, sumAvx2)
+ *   .add(Pii::CpuSse2, sumSse2);
+ *
+ * void sum(const float* data, int count, float* result)
+ * {
+ *   sumDispatcher.function()(data, count, result);
+ * }
+ * ~~~
+ *
+ * The dispatcher is thread-safe once all implementations have been
+ * added.
+ */
+template <class Function> class PiiCpuDispatcher
+{
+public:
+  /**
+   * The maximum number of implementations in addition to the generic
+   * one.
+   */
+  enum { MaxImplementations = 8 };
+
+  /**
+   * Creates a dispatcher with the given generic implementation.
+   */
+  PiiCpuDispatcher(Function generic = 0) :
+    _generic(generic),
+    _iCount(0),
+    _iCache(-1)
+  {}
+
+  PiiCpuDispatcher(const PiiCpuDispatcher& other) :
+    _generic(other._generic),
+    _iCount(other._iCount),
+    _iCache(-1)
+  {
+    for (int i=0; i<_iCount; ++i)
+      _aImplementations[i] = other._aImplementations[i];
+  }
+
+  /**
+   * Registers *function* as an implementation that requires all of
+   * the *features*, a bitwise OR of [Pii::CpuFeature] values. If the
+   * dispatcher is already full, the implementation is ignored. Null
+   * pointers are ignored as well. Returns a reference to `this`.
+   */
+  PiiCpuDispatcher& add(int features, Function function)
+  {
+    if (function != 0 && _iCount < MaxImplementations)
+      {
+        _aImplementations[_iCount].iFeatures = features;
+        _aImplementations[_iCount].function = function;
+        ++_iCount;
+        _iCache = -1;
+      }
+    return *this;
+  }
+
+  /**
+   * Returns the best implementation for the currently enabled CPU
+   * features.
+   */
+  Function function() const
+  {
+    const int iIndex = selectedIndex();
+    return iIndex == Generic ? _generic : _aImplementations[iIndex].function;
+  }
+
+  /**
+   * Returns the feature flags required by the implementation
+   * currently returned by [function()], or zero if the generic
+   * implementation is selected.
+   */
+  int selectedFeatures() const
+  {
+    const int iIndex = selectedIndex();
+    return iIndex == Generic ? 0 : _aImplementations[iIndex].iFeatures;
+  }
+
+  /**
+   * Returns the number of registered implementations, excluding the
+   * generic one.
+   */
+  int count() const { return _iCount; }
+
+private:
+  enum { Generic = 0xff };
+
+  PiiCpuDispatcher& operator= (const PiiCpuDispatcher&);
+
+  int selectedIndex() const
+  {
+    const int iFeatures = Pii::cpuFeatures();
+    // The cache stores the enabled features and the index of the
+    // selected implementation in a single int to avoid locking.
+    const int iCache = _iCache;
+    if (iCache >= 0 && (iCache >> 8) == iFeatures)
+      return iCache & 0xff;
+
+    int iIndex = Generic;
+    for (int i=0; i<_iCount; ++i)
+      if ((_aImplementations[i].iFeatures & iFeatures) == _aImplementations[i].iFeatures)
+        {
+          iIndex = i;
+          break;
+        }
+    _iCache = iFeatures << 8 | iIndex;
+    return iIndex;
+  }
+
+  struct Implementation
+  {
+    int iFeatures;
+    Function function;
+  };
+
+  Function _generic;
+  Implementation _aImplementations[MaxImplementations];
+  int _iCount;
+  mutable volatile int _iCache;
+};
+
+#endif //_PIICPUDISPATCHER_H
@@ -0,0 +1,44 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiDeviceBuffer.h"
+
+PiiDeviceBuffer::~PiiDeviceBuffer()
+{}
+
+void PiiDeviceBuffer::syncToHost(void* host, std::size_t stride, int rows)
+{
+  for (;;)
+    {
+      switch (_iState.load())
+        {
+        case Fresh:
+          return;
+        case Stale:
+          if (_iState.testAndSet(Stale, Syncing))
+            {
+              download(host, stride, rows);
+              // Unless the backend wrote again in between.
+              _iState.testAndSet(Syncing, Fresh);
+              return;
+            }
+          break;
+        default:
+          // Another thread is downloading. Downloads are rare and
+          // short compared to the kernels that caused them.
+          break;
+        }
+    }
+}
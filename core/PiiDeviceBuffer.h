@@ -0,0 +1,118 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDEVICEBUFFER_H
+#define _PIIDEVICEBUFFER_H
+
+#include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
+
+/**
+ * A reference-counted copy of matrix data in device memory, such as
+ * the memory of a GPU. A compute backend attaches a device buffer to
+ * a matrix with [PiiTypelessMatrix::setDeviceBuffer()] so that
+ * consecutive device operations can pass the data on without copying
+ * it through host memory.
+ *
+ * The host copy is synchronized lazily. A backend that writes to the
+ * device memory calls [setHostStale()], and the data is downloaded
+ * only when somebody asks for it with [PiiTypelessMatrix::syncHost()].
+ * Cloning a matrix synchronizes the host copy automatically. Other
+ * host accessors don't: code that reads a matrix produced by a device
+ * operation on the host must call `syncHost()` first, and code that
+ * modifies such a matrix on the host must detach the device buffer.
+ *
+ * ~~~(c++)
+ * class MyDeviceBuffer : public PiiDeviceBuffer
+ * {
+ * public:
+ *   MyDeviceBuffer(MyDevice* device, std::size_t bytesPerRow, int rows);
+ *   MyMemory memory() const { return _memory; }
+ * protected:
+ *   void download(void* host, std::size_t stride, int rows);
+ * private:
+ *   MyMemory _memory;
+ * };
+ *
+ * PiiMatrix<uchar> result(PiiMatrix<uchar>::uninitialized(iRows, iColumns));
+ * MyDeviceBuffer* pBuffer = new MyDeviceBuffer(pDevice, iColumns, iRows);
+ * runKernel(pDevice, pBuffer->memory());
+ * pBuffer->setHostStale(true);
+ * result.setDeviceBuffer(pBuffer);
+ * pBuffer->release(); // result holds a reference
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiDeviceBuffer
+{
+public:
+  /**
+   * Increases the reference count by one.
+   */
+  void reserve() { _ref.ref(); }
+
+  /**
+   * Decreases the reference count by one and deletes this object
+   * once the count reaches zero.
+   */
+  void release()
+  {
+    if (!_ref.deref())
+      delete this;
+  }
+
+  /**
+   * Returns `true` if the device memory has been modified after the
+   * host copy was last synchronized.
+   */
+  bool isHostStale() const { return _iState.load() != Fresh; }
+
+  /**
+   * Marks the host copy out of date (`true`) or up to date (`false`).
+   */
+  void setHostStale(bool stale) { _iState.store(stale ? Stale : Fresh); }
+
+  /**
+   * Downloads the device memory into *host* if the host copy is out
+   * of date. *host* has *rows* rows, *stride* bytes apart. If many
+   * threads call this function at the same time, one of them
+   * downloads the data and the others wait for it.
+   */
+  void syncToHost(void* host, std::size_t stride, int rows);
+
+protected:
+  /**
+   * Creates a new device buffer with a reference count of one. The
+   * host copy is initially up to date.
+   */
+  PiiDeviceBuffer() : _ref(1), _iState(Fresh) {}
+  virtual ~PiiDeviceBuffer();
+
+  /**
+   * Copies the contents of the device memory to *host*. The
+   * implementation knows the width of the rows it stores. This
+   * function may be called in any thread.
+   */
+  virtual void download(void* host, std::size_t stride, int rows) = 0;
+
+private:
+  enum State { Fresh, Stale, Syncing };
+
+  PiiAtomicInt _ref;
+  PiiAtomicInt _iState;
+
+  PII_DISABLE_COPY(PiiDeviceBuffer);
+};
+
+#endif //_PIIDEVICEBUFFER_H
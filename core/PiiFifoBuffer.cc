@@ -16,19 +16,95 @@
 #include "PiiFifoBuffer.h"
 #include <QMutexLocker>
 #include <cstdlib>
+#include <cstring>
+
+/* Synchronization
+ *
+ * Only the writer changes iWriteIndex and only the reader changes
+ * iReadIndex. Each side publishes its position with a release store
+ * and reads the other one with an acquire load, which is enough to
+ * make the data in between visible.
+ *
+ * A thread that must wait increments its waiting counter while
+ * holding waitLock, checks the buffer once more and waits. The other
+ * side checks the counter after publishing its position with an
+ * atomic read-modify-write, which orders the check after the store.
+ * Waking up is thus never missed, and waitLock is only touched if
+ * someone actually waits.
+ */
 
 PiiFifoBuffer::Data::Data(qint64 size) :
-  iSize(size),
-  iReadStart(0),
-  iWriteStart(0),
-  iFreeSpace(size),
+  iSize(int(qBound(qint64(1), size, qint64(1) << 30))),
   iReadTotal(0),
-  pBuffer((char*)std::malloc(size)),
-  ulWaitTime(100),
-  bWriteFinished(false)
+  pBuffer((char*)std::malloc(iSize)),
+  ulWaitTime(100)
 {
 }
 
+int PiiFifoBuffer::Data::readableBytes() const
+{
+  int iBytes = iWriteIndex.loadAcquire() - iReadIndex.load();
+  return iBytes < 0 ? iBytes + 2*iSize : iBytes;
+}
+
+int PiiFifoBuffer::Data::writableBytes() const
+{
+  int iBytes = iWriteIndex.load() - iReadIndex.loadAcquire();
+  return iSize - (iBytes < 0 ? iBytes + 2*iSize : iBytes);
+}
+
+int PiiFifoBuffer::Data::advance(int index, int bytes) const
+{
+  index += bytes;
+  return index >= 2*iSize ? index - 2*iSize : index;
+}
+
+int PiiFifoBuffer::Data::waitForData()
+{
+  int iBytes = readableBytes();
+  if (iBytes > 0 || ulWaitTime == 0 || iWriteFinished.load())
+    return iBytes;
+
+  QMutexLocker lock(&waitLock);
+  ++iReaderWaiting;
+  iBytes = readableBytes();
+  if (iBytes == 0 && !iWriteFinished.load())
+    {
+      dataWritten.wait(&waitLock, ulWaitTime);
+      iBytes = readableBytes();
+    }
+  --iReaderWaiting;
+  return iBytes;
+}
+
+int PiiFifoBuffer::Data::waitForSpace()
+{
+  int iBytes = writableBytes();
+  if (iBytes > 0 || ulWaitTime == 0)
+    return iBytes;
+
+  QMutexLocker lock(&waitLock);
+  ++iWriterWaiting;
+  iBytes = writableBytes();
+  if (iBytes == 0)
+    {
+      dataRead.wait(&waitLock, ulWaitTime);
+      iBytes = writableBytes();
+    }
+  --iWriterWaiting;
+  return iBytes;
+}
+
+void PiiFifoBuffer::Data::wake(PiiAtomicInt& waiting, QWaitCondition& condition)
+{
+  // Adding zero is a read-modify-write and thus a full barrier.
+  if ((waiting += 0) != 0)
+    {
+      QMutexLocker lock(&waitLock);
+      condition.wakeOne();
+    }
+}
+
 PiiFifoBuffer::PiiFifoBuffer(qint64 size) :
   d(new Data(size))
 {
@@ -43,46 +119,31 @@ PiiFifoBuffer::~PiiFifoBuffer()
 
 bool PiiFifoBuffer::atEnd() const
 {
-  return (d->iSize - d->iFreeSpace) == 0 && d->bWriteFinished;
+  return d->readableBytes() == 0 && d->iWriteFinished.load();
 }
 
 qint64 PiiFifoBuffer::pos() const
 {
-  //qDebug("Pos: %d", (int)(d->iReadTotal - QIODevice::bytesAvailable()));
   return d->iReadTotal - QIODevice::bytesAvailable();
 }
 
 bool PiiFifoBuffer::seek(qint64 position)
 {
-  d->bufferLock.lock();
-  //qDebug("Seek to: %d, current: %d", (int)position, (int)pos());
   // Cannot seek back beyond the unget buffer
   if (position < pos())
-    {
-      d->bufferLock.unlock();
-      return false;
-    }
+    return false;
 
   QIODevice::seek(position);
-  //qDebug("Pos after QIODevice::seek: %d", (int)pos());
   qint64 diff = position - d->iReadTotal;
   if (diff > 0)
-    {
-      //qDebug("Discarding %d bytes", (int)diff);
-      return readBytes(0, diff) == diff;
-    }
-  d->bufferLock.unlock();
+    return readBytes(0, diff) == diff;
   return true;
 }
 
 qint64 PiiFifoBuffer::bytesAvailable () const
 {
-  /*qDebug("Bytes available: %d (unget buffer: %d)",
-         (int)(d->iSize-d->iFreeSpace+QIODevice::bytesAvailable()),
-         (int)QIODevice::bytesAvailable());
-  */
-  // My free space + the size of the unget buffer
-  return d->iSize - d->iFreeSpace + QIODevice::bytesAvailable();
+  // Unread data + the size of the unget buffer
+  return d->readableBytes() + QIODevice::bytesAvailable();
 }
 
 void PiiFifoBuffer::setWaitTime(unsigned long readWaitTime) { d->ulWaitTime = readWaitTime; }
@@ -93,28 +154,60 @@ bool PiiFifoBuffer::isSequential() const { return true; }
 bool PiiFifoBuffer::reset()
 {
   QIODevice::reset();
-  QMutexLocker lock(&d->bufferLock);
-  d->iReadStart = d->iWriteStart = d->iReadTotal = 0;
-  d->iFreeSpace = d->iSize;
-  d->bWriteFinished = false;
+  d->iReadIndex.store(0);
+  d->iWriteIndex.store(0);
+  d->iReadTotal = 0;
+  d->iWriteFinished.storeRelease(0);
   return true;
 }
 
 void PiiFifoBuffer::finishWriting()
 {
-  QMutexLocker lock(&d->bufferLock);
-  d->bWriteFinished = true;
+  d->iWriteFinished.storeRelease(1);
   // Wake a waiting reader
+  QMutexLocker lock(&d->waitLock);
   d->dataWritten.wakeOne();
 }
 
+qint64 PiiFifoBuffer::peekWrite(char** data)
+{
+  int iBytes = d->waitForSpace();
+  int iOffset = d->offset(d->iWriteIndex.load());
+  *data = d->pBuffer + iOffset;
+  return qMin(iBytes, d->iSize - iOffset);
+}
+
+void PiiFifoBuffer::commitWrite(qint64 bytes)
+{
+  if (bytes <= 0)
+    return;
+  d->iWriteIndex.storeRelease(d->advance(d->iWriteIndex.load(), int(bytes)));
+  // Wake up any pending read operation
+  d->wake(d->iReaderWaiting, d->dataWritten);
+}
+
+qint64 PiiFifoBuffer::peekRead(const char** data)
+{
+  int iBytes = d->waitForData();
+  int iOffset = d->offset(d->iReadIndex.load());
+  *data = d->pBuffer + iOffset;
+  return qMin(iBytes, d->iSize - iOffset);
+}
+
+void PiiFifoBuffer::commitRead(qint64 bytes)
+{
+  if (bytes <= 0)
+    return;
+  d->iReadIndex.storeRelease(d->advance(d->iReadIndex.load(), int(bytes)));
+  d->iReadTotal += bytes;
+  // Wake up any pending write operation
+  d->wake(d->iWriterWaiting, d->dataRead);
+}
+
 qint64 PiiFifoBuffer::readData(char * data, qint64 maxSize)
 {
-  //qDebug("PiiFifoBuffer::readData(0x%x, %d)", (int)data, (int)maxSize);
   if (maxSize == 0)
     return 0;
-
-  d->bufferLock.lock();
   return readBytes(data, maxSize);
 }
 
@@ -125,121 +218,45 @@ qint64 PiiFifoBuffer::readBytes(char * data, qint64 maxSize)
   // Read until everything was received
   while (bytesRemaining > 0)
     {
-      // If no data is available, we must wait
-      if (d->iSize - d->iFreeSpace == 0)
-        {
-          // If writing has not been finished, and wait time is set, we need to wait a bit
-          if (!d->bWriteFinished && d->ulWaitTime > 0)
-            d->dataWritten.wait(&d->bufferLock, d->ulWaitTime);
-          // No more data is available -> return
-          // This happens if writing is finished or new data comes too late
-          if (d->iSize - d->iFreeSpace == 0)
-            {
-              /*qDebug("Read wait exited with no signal! "
-                     "remaining: %d, maxSize: %d, bytes available: %d",
-                     (int)bytesRemaining, (int)maxSize, (int)(d->iSize - d->iFreeSpace));
-              */
-              d->bufferLock.unlock();
-              return maxSize - bytesRemaining;
-            }
-        }
-      // Read as much as possible
-      // Len must be larger than zero because new data has arrived
-      qint64 len = bytesRemaining < (d->iSize - d->iFreeSpace) ? bytesRemaining : (d->iSize - d->iFreeSpace);
-
-      //qDebug("Reading %d bytes", (int)len);
-      qint64 end = d->iReadStart + len;
-      //printf("len = %d, freeSpace = %d, start = %d, end = %d\n", len, d->iFreeSpace, d->iReadStart, end);
-      // The buffer is addressed circularly.
-      if (end <= d->iSize)  // We can read the whole part at once
+      // Waits if no data is available. Returns zero if writing is
+      // finished or new data comes too late.
+      const char* pRegion;
+      qint64 len = peekRead(&pRegion);
+      if (len == 0)
+        break;
+      if (len > bytesRemaining)
+        len = bytesRemaining;
+      if (data)
         {
-          if (data)
-            ::memcpy(data, d->pBuffer + d->iReadStart, len);
-          d->iReadStart += len;
-          if (d->iReadStart >= d->iSize)
-            d->iReadStart -= d->iSize;
+          ::memcpy(data, pRegion, len);
+          data += len;
         }
-      else // We must read both at the end and at the beginning
-        {
-          qint64 firstPieceLen = d->iSize - d->iReadStart;
-          if (data)
-            {
-              ::memcpy(data, d->pBuffer + d->iReadStart, firstPieceLen);
-              ::memcpy(data + firstPieceLen, d->pBuffer, len-firstPieceLen);
-            }
-          d->iReadStart = len-firstPieceLen;
-        }
-      d->iFreeSpace += len;
-      data += len;
+      commitRead(len);
       bytesRemaining -= len;
-      d->iReadTotal += len;
-
-      // Wake up any pending write operation
-      d->dataRead.wakeOne();
     }
 
-  d->bufferLock.unlock();
-  return maxSize;
+  return maxSize - bytesRemaining;
 }
 
 qint64 PiiFifoBuffer::writeData(const char * data, qint64 maxSize)
 {
-  //qDebug("PiiFifoBuffer::writeData(0x%x, %d)", (int)data, (int)maxSize);
-  if (maxSize == 0)
-    return 0;
-
-  d->bufferLock.lock();
-
-  // Analogous to readData
   qint64 bytesRemaining = maxSize;
 
   // Write in pieces until everything is completed
   while (bytesRemaining > 0)
     {
-      // Write as much as possible
       // Can't write yet. Wait for a while
-      if (d->iFreeSpace == 0)
-        {
-          //qDebug("Cannot write yet. Waiting for %ld msec.", d->ulWaitTime);
-          // This is signalled whenever new data arrives
-          bool dataRead = d->ulWaitTime > 0 && d->dataRead.wait(&d->bufferLock, d->ulWaitTime);
-          if (!dataRead)
-            {
-              /*qDebug("Write wait exited with no signal! "
-                     "remaining: %d, maxSize: %d, free space: %d",
-                     (int)bytesRemaining, (int)maxSize, (int)d->iFreeSpace);
-              */
-              d->bufferLock.unlock();
-              return maxSize - bytesRemaining;
-            }
-        }
-      qint64 len = bytesRemaining < d->iFreeSpace ? bytesRemaining : d->iFreeSpace;
-
-      //qDebug("Writing %d bytes", (int)len);
-      qint64 end = d->iWriteStart + len;
-      //printf("len = %d, freeSpace = %d, start = %d, end = %d\n", len, d->iFreeSpace, d->iWriteStart, end);
-      if (end <= d->iSize)
-        {
-          ::memcpy(d->pBuffer + d->iWriteStart, data, len);
-          d->iWriteStart += len;
-          if (d->iWriteStart >= d->iSize)
-            d->iWriteStart -= d->iSize;
-        }
-      else
-        {
-          qint64 firstPieceLen = d->iSize - d->iWriteStart;
-          ::memcpy(d->pBuffer + d->iWriteStart, data, firstPieceLen);
-          ::memcpy(d->pBuffer, data + firstPieceLen, len-firstPieceLen);
-          d->iWriteStart = len-firstPieceLen;
-        }
-      d->iFreeSpace -= len;
+      char* pRegion;
+      qint64 len = peekWrite(&pRegion);
+      if (len == 0)
+        break;
+      if (len > bytesRemaining)
+        len = bytesRemaining;
+      ::memcpy(pRegion, data, len);
+      commitWrite(len);
       data += len;
       bytesRemaining -= len;
-
-      // Wake up any pending read operation
-      d->dataWritten.wakeOne();
     }
 
-  d->bufferLock.unlock();
-  return maxSize;
+  return maxSize - bytesRemaining;
 }
@@ -20,14 +20,39 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
 
 /**
- * A first in first out I/O device. PiiFifoBuffer is a thread-safe
- * buffer that can be read and written simultaneously. It reads and
- * writes data into a fixed array in memory. PiiFifoBuffer can work as
- * a replacement to QBuffer in situations where the amount of incoming
- * data is unlimited.
+ * A first in first out I/O device. PiiFifoBuffer is a buffer that can
+ * be read and written simultaneously by one reader and one writer
+ * thread. It reads and writes data into a fixed array in memory.
+ * PiiFifoBuffer can work as a replacement to QBuffer in situations
+ * where the amount of incoming data is unlimited.
  *
+ * The reader and the writer don't lock each other out. They only
+ * communicate through atomic read and write positions. A mutex and a
+ * wait condition are used only if the reader finds the buffer empty
+ * or the writer finds it full.
+ *
+ * In addition to the QIODevice interface, PiiFifoBuffer makes it
+ * possible to read and write data in place. [peekWrite()] and
+ * [peekRead()] return a contiguous region of the internal buffer,
+ * and [commitWrite()] and [commitRead()] move the positions once the
+ * region has been filled or consumed.
+ *
+ * ~~~(c++)
+ * // Writer thread
+ * char* pData;
+ * qint64 iBytes = buffer.peekWrite(&pData);
+ * iBytes = socket.read(pData, iBytes);
+ * buffer.commitWrite(iBytes);
+ *
+ * // Reader thread
+ * const char* pData;
+ * qint64 iBytes = buffer.peekRead(&pData);
+ * decoder.decode(pData, iBytes);
+ * buffer.commitRead(iBytes);
+ * ~~~
  */
 class PII_CORE_EXPORT PiiFifoBuffer : public QIODevice
 {
@@ -37,7 +62,8 @@ public:
   /**
    * Creates a new fifo buffer.
    *
-   * @param size the number of bytes to reserve for the memory buffer
+   * @param size the number of bytes to reserve for the memory
+   * buffer. The maximum size is 1 GiB.
    */
   PiiFifoBuffer(qint64 size);
 
@@ -59,7 +85,8 @@ public:
 
   /**
    * Moves both reading and writing position to the beginning of the
-   * buffer.
+   * buffer. This function must not be called while the buffer is
+   * being read or written.
    */
   bool reset();
 
@@ -87,6 +114,48 @@ public:
    */
   bool isSequential() const;
 
+  /**
+   * Returns a contiguous region of free space in the buffer. The
+   * address of the region will be stored to *data*, and its size will
+   * be returned. If the buffer is full, the calling thread will be
+   * blocked for at most [waitTime()] milliseconds. Returns zero if
+   * no space becomes available. The region may be smaller than the
+   * total free space if the free space wraps around the end of the
+   * buffer.
+   *
+   * Nothing will be visible to the reader until [commitWrite()] is
+   * called. Only the writer thread may call this function.
+   */
+  qint64 peekWrite(char** data);
+
+  /**
+   * Makes *bytes* bytes written to the region returned by
+   * [peekWrite()] available to the reader. *bytes* must not exceed
+   * the size of the region.
+   */
+  void commitWrite(qint64 bytes);
+
+  /**
+   * Returns a contiguous region of readable data in the buffer. The
+   * address of the region will be stored to *data*, and its size will
+   * be returned. If the buffer is empty, the calling thread will be
+   * blocked for at most [waitTime()] milliseconds. Returns zero if no
+   * data becomes available.
+   *
+   * The region remains valid until [commitRead()] is called. Data
+   * already buffered by QIODevice (e.g. by QIODevice::peek() or
+   * QIODevice::ungetChar()) is not included. Only the reader thread
+   * may call this function.
+   */
+  qint64 peekRead(const char** data);
+
+  /**
+   * Releases *bytes* bytes read from the region returned by
+   * [peekRead()] for the writer. *bytes* must not exceed the size of
+   * the region.
+   */
+  void commitRead(qint64 bytes);
+
 protected:
   /**
    * Reads at most `maxSize` bytes into `data`. In any case, the
@@ -123,12 +192,26 @@ private:
   {
   public:
     Data(qint64 size);
-    qint64 iSize, iReadStart, iWriteStart, iFreeSpace, iReadTotal;
+
+    int readableBytes() const;
+    int writableBytes() const;
+    int offset(int index) const { return index < iSize ? index : index - iSize; }
+    int advance(int index, int bytes) const;
+    int waitForData();
+    int waitForSpace();
+    void wake(PiiAtomicInt& waiting, QWaitCondition& condition);
+
+    // Read and write positions run from 0 to 2*iSize-1 so that a full
+    // buffer can be told apart from an empty one.
+    int iSize;
+    PiiAtomicInt iReadIndex, iWriteIndex;
+    qint64 iReadTotal;
     char* pBuffer;
     unsigned long ulWaitTime;
-    QMutex bufferLock;
+    QMutex waitLock;
     QWaitCondition dataWritten, dataRead;
-    bool bWriteFinished;
+    PiiAtomicInt iReaderWaiting, iWriterWaiting;
+    PiiAtomicInt iWriteFinished;
   } *d;
 };
 
@@ -16,6 +16,8 @@
 #ifndef _PIIFIXEDPOINT_H
 #define _PIIFIXEDPOINT_H
 
+#include "PiiMathDefs.h"
+
 /*
  * A structure that defines the type used for intermediate values in
  * calculations that require more precision than the original type.
@@ -49,6 +51,8 @@ template <> struct PiiFixedPointTraits<long> { typedef long long WiderType; };
 template <int decimals, class T = int> class PiiFixedPoint
 {
 public:
+  typedef typename PiiFixedPointTraits<T>::WiderType WiderType;
+
   /**
    * Initialize the fixed point value to zero.
    */
@@ -61,34 +65,97 @@ public:
    * @param shift the number of decimal bits to add to the number.
    * `value` will be shifted this many times to the left.
    */
-  PiiFixedPoint(T value, int shift = decimals) : _value(value << shift) {}
+  PiiFixedPoint(T value, int shift = decimals) : _value(T(value * (T(1) << shift))) {}
   /**
    * Copy constructor.
    */
   PiiFixedPoint(const PiiFixedPoint& other) : _value(other._value) {}
   /**
    * Initialize the fixed point number with a floating point value.
-   * This may result in rounding errors.
+   * The value is rounded to the nearest representable number.
+   */
+  PiiFixedPoint(double value) : _value(T(value * (T(1) << decimals) + (value < 0 ? -0.5 : 0.5))) {}
+
+  /**
+   * Creates a fixed point number whose internal representation is
+   * *raw*.
+   */
+  static PiiFixedPoint fromRaw(T raw) { return PiiFixedPoint(raw, 0); }
+  /**
+   * Returns the internal representation of the number, i.e. the
+   * value multiplied by \(2^{decimals}\).
+   */
+  T rawValue() const { return _value; }
+
+  /**
+   * Returns the largest integer that is not greater than the value.
+   * Relies on arithmetic right shift, which all supported compilers
+   * use for signed types.
    */
-  PiiFixedPoint(double value) : _value(value * (1 << decimals)) {}
+  T floor() const { return _value >> decimals; }
+  /**
+   * Returns the value rounded to the nearest integer.
+   */
+  T round() const { return T(_value + (T(1) << (decimals-1))) >> decimals; }
+
+  operator float () const { return (float)_value / (T(1) << decimals); }
+  operator double () const { return (double)_value / (T(1) << decimals); }
+
+  PiiFixedPoint& operator= (const PiiFixedPoint& other) { _value = other._value; return *this; }
+
+  PiiFixedPoint& operator+= (const PiiFixedPoint& other) { _value += other._value; return *this; }
+  PiiFixedPoint& operator-= (const PiiFixedPoint& other) { _value -= other._value; return *this; }
+  PiiFixedPoint& operator*= (const PiiFixedPoint& other) { _value = multiply(_value, other._value); return *this; }
+  PiiFixedPoint& operator/= (const PiiFixedPoint& other) { _value = divide(_value, other._value); return *this; }
+  PiiFixedPoint& operator*= (T value) { _value *= value; return *this; }
+  PiiFixedPoint& operator/= (T value) { _value /= value; return *this; }
 
-  operator float () const { return (float)_value / (1 << decimals); }
-  operator double () const { return (double)_value / (1 << decimals); }
+  PiiFixedPoint operator- () const { return fromRaw(T(-_value)); }
 
-  void operator+= (const PiiFixedPoint& other) { _value += other._value; }
-  void operator-= (const PiiFixedPoint& other) { _value -= other._value; }
-  void operator*= (const PiiFixedPoint& other) { _value = T(PiiFixedPointTraits<T>::WiderType(_value * other._value) >> decimals); }
-  void operator/= (const PiiFixedPoint& other) { _value = (_value / other._value) << decimal; }
+  PiiFixedPoint operator+ (const PiiFixedPoint& other) const { return fromRaw(T(_value + other._value)); }
+  PiiFixedPoint operator- (const PiiFixedPoint& other) const { return fromRaw(T(_value - other._value)); }
+  PiiFixedPoint operator* (const PiiFixedPoint& other) const { return fromRaw(multiply(_value, other._value)); }
+  PiiFixedPoint operator/ (const PiiFixedPoint& other) const { return fromRaw(divide(_value, other._value)); }
 
-  PiiFixedPoint operator+ (const PiiFixedPoint& other) { return PiiFixedPoint(_value + other_value, 0); }
-  PiiFixedPoint operator- (const PiiFixedPoint& other) { return PiiFixedPoint(_value - other_value, 0); }
-  PiiFixedPoint operator* (const PiiFixedPoint& other) { return PiiFixedPoint(T(PiiFixedPointTraits<T>::WiderType(_value * other_value) >> decimals), 0); }
-  PiiFixedPoint operator/ (const PiiFixedPoint& other) { return PiiFixedPoint(_value / other_value); }
+  /* Mixed-type operators. Without these, expressions like x*2 would
+     be ambiguous because the number converts implicitly both to and
+     from the built-in types.
+   */
+  PiiFixedPoint operator+ (T value) const { return *this + PiiFixedPoint(value); }
+  PiiFixedPoint operator- (T value) const { return *this - PiiFixedPoint(value); }
+  PiiFixedPoint operator* (T value) const { return fromRaw(T(_value * value)); }
+  PiiFixedPoint operator/ (T value) const { return fromRaw(T(_value / value)); }
+  PiiFixedPoint operator+ (double value) const { return *this + PiiFixedPoint(value); }
+  PiiFixedPoint operator- (double value) const { return *this - PiiFixedPoint(value); }
+  PiiFixedPoint operator* (double value) const { return *this * PiiFixedPoint(value); }
+  PiiFixedPoint operator/ (double value) const { return *this / PiiFixedPoint(value); }
+
+  bool operator== (const PiiFixedPoint& other) const { return _value == other._value; }
+  bool operator!= (const PiiFixedPoint& other) const { return _value != other._value; }
+  bool operator< (const PiiFixedPoint& other) const { return _value < other._value; }
+  bool operator> (const PiiFixedPoint& other) const { return _value > other._value; }
+  bool operator<= (const PiiFixedPoint& other) const { return _value <= other._value; }
+  bool operator>= (const PiiFixedPoint& other) const { return _value >= other._value; }
 
 private:
+  static T multiply(T a, T b) { return T((WiderType(a) * b) >> decimals); }
+  static T divide(T a, T b) { return T((WiderType(a) << decimals) / b); }
+
   T _value;
 };
 
-//PENDING conversion to int (requires arithmetic shift), calculations/conversions betwee numbers with different number of decimals
+namespace Pii
+{
+  template <int decimals, class T> struct Numeric<PiiFixedPoint<decimals,T> >
+  {
+    typedef PiiFixedPoint<decimals,T> Type;
+    static Type tolerance() { return Type::fromRaw(1); }
+    static Type maxValue() { return Type::fromRaw(std::numeric_limits<T>::max()); }
+    static Type minValue() { return Type::fromRaw(std::numeric_limits<T>::min()); }
+    static Type smallestPositive() { return Type::fromRaw(1); }
+  };
+}
+
+//PENDING calculations/conversions between numbers with different number of decimals
 
 #endif //_PIIFIXEDPOINT_H
@@ -115,10 +115,16 @@ namespace std { template <class T> T declval(); }
 #  define PII_ITERATOR_KEY(IT) (IT).key()
 #else
 #  include <cstdio>
-#  define piiDebug std::printf
-#  define piiWarning std::printf
-#  define piiCritical std::printf
-#  define piiFatal std::printf
+namespace Pii
+{
+  using std::printf;
+  // Lets the log macros take a QString as their Qt counterparts do.
+  template <class String> inline int printf(const String& msg) { return std::printf("%s", msg.c_str()); }
+}
+#  define piiDebug Pii::printf
+#  define piiWarning Pii::printf
+#  define piiCritical Pii::printf
+#  define piiFatal Pii::printf
 #  define piiPrintable(STR) (STR).c_str()
 // Map-like types in stl use std::pair as value_type
 #  define PII_ITERATOR_VALUE(IT) (IT)->second
@@ -0,0 +1,178 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiHalf.h"
+
+#include "PiiCpu.h"
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_HALF_SSE2 1
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_HALF_NEON 1
+#endif
+
+namespace Pii
+{
+  namespace
+  {
+    /* The vector conversions use the same bit manipulations as
+       halfToFloat() and floatToHalf(), with branches replaced by
+       masks. Instead of renormalizing denormals with a subtraction,
+       half-to-float conversion multiplies the shifted bits by
+       2^112, which requires denormal floats to be enabled. The
+       results are bit-exact otherwise.
+     */
+#ifdef PII_HALF_SSE2
+    inline __m128 halfToFloat4(__m128i half)
+    {
+      const __m128i expMant = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+      const __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, expMant), 16);
+      const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)),
+                                       _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+      const __m128i infNan = _mm_and_si128(_mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7bff)),
+                                           _mm_set1_epi32(255 << 23));
+      return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+    }
+
+    // Returns the half-precision bit patterns sign-extended to 32 bits
+    inline __m128i floatToHalf4(__m128 value)
+    {
+      __m128i bits = _mm_castps_si128(value);
+      const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(int(0x80000000u)));
+      bits = _mm_xor_si128(bits, sign);
+
+      const __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+      const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(int(0xc8000fffu))), odd), 13);
+      const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(126 << 23));
+      const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), magic)),
+                                             _mm_castps_si128(magic));
+      const __m128i infNan = _mm_or_si128(_mm_set1_epi32(0x7c00),
+                                          _mm_and_si128(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7f800000)),
+                                                        _mm_set1_epi32(0x0200)));
+      const __m128i isDenormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+      const __m128i isLarge = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x477fffff));
+      __m128i result = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+      result = _mm_or_si128(_mm_and_si128(isLarge, infNan), _mm_andnot_si128(isLarge, result));
+      result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+      return _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+    }
+
+    void halfToFloatSse2(const PiiHalf* source, int n, float* target)
+    {
+      int i = 0;
+      for (; i <= n-8; i += 8)
+        {
+          const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+          const __m128i zero = _mm_setzero_si128();
+          _mm_storeu_ps(target + i, halfToFloat4(_mm_unpacklo_epi16(half, zero)));
+          _mm_storeu_ps(target + i + 4, halfToFloat4(_mm_unpackhi_epi16(half, zero)));
+        }
+      for (; i<n; ++i)
+        target[i] = source[i];
+    }
+
+    void floatToHalfSse2(const float* source, int n, PiiHalf* target)
+    {
+      int i = 0;
+      for (; i <= n-8; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i),
+                         _mm_packs_epi32(floatToHalf4(_mm_loadu_ps(source + i)),
+                                         floatToHalf4(_mm_loadu_ps(source + i + 4))));
+      for (; i<n; ++i)
+        target[i] = source[i];
+    }
+#endif
+
+#ifdef PII_HALF_NEON
+    inline float32x4_t halfToFloat4(uint32x4_t half)
+    {
+      const uint32x4_t expMant = vandq_u32(half, vdupq_n_u32(0x7fff));
+      const uint32x4_t sign = vshlq_n_u32(veorq_u32(half, expMant), 16);
+      const float32x4_t scaled = vmulq_f32(vreinterpretq_f32_u32(vshlq_n_u32(expMant, 13)),
+                                           vreinterpretq_f32_u32(vdupq_n_u32((254 - 15) << 23)));
+      const uint32x4_t infNan = vandq_u32(vcgtq_u32(expMant, vdupq_n_u32(0x7bff)),
+                                          vdupq_n_u32(255 << 23));
+      return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(scaled), vorrq_u32(sign, infNan)));
+    }
+
+    inline uint16x4_t floatToHalf4(float32x4_t value)
+    {
+      uint32x4_t bits = vreinterpretq_u32_f32(value);
+      const uint32x4_t sign = vandq_u32(bits, vdupq_n_u32(0x80000000u));
+      bits = veorq_u32(bits, sign);
+
+      const uint32x4_t odd = vandq_u32(vshrq_n_u32(bits, 13), vdupq_n_u32(1));
+      const uint32x4_t normal = vshrq_n_u32(vaddq_u32(vaddq_u32(bits, vdupq_n_u32(0xc8000fffu)), odd), 13);
+      const float32x4_t magic = vreinterpretq_f32_u32(vdupq_n_u32(126 << 23));
+      const uint32x4_t denormal = vsubq_u32(vreinterpretq_u32_f32(vaddq_f32(vreinterpretq_f32_u32(bits), magic)),
+                                            vreinterpretq_u32_f32(magic));
+      const uint32x4_t infNan = vorrq_u32(vdupq_n_u32(0x7c00),
+                                          vandq_u32(vcgtq_u32(bits, vdupq_n_u32(0x7f800000)),
+                                                    vdupq_n_u32(0x0200)));
+      uint32x4_t result = vbslq_u32(vcltq_u32(bits, vdupq_n_u32(113 << 23)), denormal, normal);
+      result = vbslq_u32(vcgtq_u32(bits, vdupq_n_u32(0x477fffff)), infNan, result);
+      return vmovn_u32(vorrq_u32(result, vshrq_n_u32(sign, 16)));
+    }
+
+    void halfToFloatNeon(const PiiHalf* source, int n, float* target)
+    {
+      const uint16_t* pSource = reinterpret_cast<const uint16_t*>(source);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        vst1q_f32(target + i, halfToFloat4(vmovl_u16(vld1_u16(pSource + i))));
+      for (; i<n; ++i)
+        target[i] = source[i];
+    }
+
+    void floatToHalfNeon(const float* source, int n, PiiHalf* target)
+    {
+      uint16_t* pTarget = reinterpret_cast<uint16_t*>(target);
+      int i = 0;
+      for (; i <= n-4; i += 4)
+        vst1_u16(pTarget + i, floatToHalf4(vld1q_f32(source + i)));
+      for (; i<n; ++i)
+        target[i] = source[i];
+    }
+#endif
+  }
+
+  void halfToFloatN(const PiiHalf* source, int n, float* target)
+  {
+#if defined(PII_HALF_SSE2)
+    if (hasCpuFeature(CpuSse2))
+      return halfToFloatSse2(source, n, target);
+#elif defined(PII_HALF_NEON)
+    if (hasCpuFeature(CpuNeon))
+      return halfToFloatNeon(source, n, target);
+#endif
+    for (int i=0; i<n; ++i)
+      target[i] = source[i];
+  }
+
+  void floatToHalfN(const float* source, int n, PiiHalf* target)
+  {
+#if defined(PII_HALF_SSE2)
+    if (hasCpuFeature(CpuSse2))
+      return floatToHalfSse2(source, n, target);
+#elif defined(PII_HALF_NEON)
+    if (hasCpuFeature(CpuNeon))
+      return floatToHalfNeon(source, n, target);
+#endif
+    for (int i=0; i<n; ++i)
+      target[i] = source[i];
+  }
+}
@@ -0,0 +1,195 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIHALF_H
+#define _PIIHALF_H
+
+#include "PiiGlobal.h"
+#include "PiiMathDefs.h"
+#include "PiiTypeTraits.h"
+#include "PiiMatrix.h"
+#include <cstring>
+
+namespace Pii
+{
+  /**
+   * Converts the bit pattern of an IEEE 754 half-precision number to
+   * a `float`. The conversion is exact.
+   */
+  inline float halfToFloat(unsigned short half)
+  {
+    const unsigned int uiShiftedExp = 0x7c00 << 13;
+    unsigned int uiBits = unsigned(half & 0x7fff) << 13;
+    const unsigned int uiExp = uiBits & uiShiftedExp;
+    uiBits += (127 - 15) << 23;
+    float fResult;
+    if (uiExp == uiShiftedExp) // Inf/NaN
+      uiBits += (128 - 16) << 23;
+    else if (uiExp == 0) // zero/denormal
+      {
+        uiBits += 1 << 23;
+        const unsigned int uiMagic = 113 << 23;
+        float fMagic;
+        std::memcpy(&fMagic, &uiMagic, 4);
+        std::memcpy(&fResult, &uiBits, 4);
+        fResult -= fMagic;
+        std::memcpy(&uiBits, &fResult, 4);
+      }
+    uiBits |= unsigned(half & 0x8000) << 16;
+    std::memcpy(&fResult, &uiBits, 4);
+    return fResult;
+  }
+
+  /**
+   * Converts a `float` to the bit pattern of the nearest IEEE 754
+   * half-precision number. Ties are rounded to even. Values beyond
+   * the range of half-precision numbers become infinities, and NaNs
+   * become quiet NaNs.
+   */
+  inline unsigned short floatToHalf(float value)
+  {
+    unsigned int uiBits;
+    std::memcpy(&uiBits, &value, 4);
+    const unsigned int uiSign = uiBits & 0x80000000u;
+    uiBits ^= uiSign;
+    unsigned int uiResult;
+    if (uiBits >= 0x47800000u) // Inf/NaN, or too large
+      uiResult = uiBits > 0x7f800000u ? 0x7e00 : 0x7c00;
+    else if (uiBits < (113u << 23)) // zero/denormal
+      {
+        // Adding 0.5 aligns the ten mantissa bits at the bottom of
+        // the float, and the FPU does the rounding.
+        const unsigned int uiMagic = 126u << 23;
+        float fMagic, fValue;
+        std::memcpy(&fMagic, &uiMagic, 4);
+        std::memcpy(&fValue, &uiBits, 4);
+        fValue += fMagic;
+        std::memcpy(&uiResult, &fValue, 4);
+        uiResult -= uiMagic;
+      }
+    else
+      {
+        const unsigned int uiOdd = (uiBits >> 13) & 1;
+        uiBits += ((15u - 127u) << 23) + 0xfff + uiOdd;
+        uiResult = uiBits >> 13;
+      }
+    return (unsigned short)(uiResult | (uiSign >> 16));
+  }
+}
+
+/**
+ * A 16-bit IEEE 754 half-precision floating-point number. PiiHalf is
+ * a storage type: it converts implicitly to and from `float`, and all
+ * arithmetic is performed in single precision. Storing large feature
+ * matrices and images as half-precision numbers halves the memory
+ * bandwidth compared to `float` with three significant decimal
+ * digits of precision. The largest finite value is 65504.
+ *
+ * Converting single values is cheap but not free. Use
+ * Pii::halfToFloatN() and Pii::floatToHalfN() to convert whole rows
+ * at once; they are vectorized if the CPU supports it.
+ *
+ * ~~~(c++)
+ * PiiMatrix<PiiHalf> matFeatures(100, 64);
+ * matFeatures(0,0) = 0.5f;
+ * float fSum = matFeatures(0,0) + matFeatures(0,1);
+ * PiiMatrix<float> matSingle(Pii::halfToFloat(matFeatures));
+ * ~~~
+ */
+class PiiHalf
+{
+public:
+  /**
+   * Initializes the number to zero.
+   */
+  PiiHalf() : _usBits(0) {}
+  /**
+   * Converts *value* to the nearest half-precision number.
+   */
+  PiiHalf(float value) : _usBits(Pii::floatToHalf(value)) {}
+
+  /**
+   * Returns the number as a `float`.
+   */
+  operator float () const { return Pii::halfToFloat(_usBits); }
+
+  PiiHalf& operator+= (float value) { return *this = PiiHalf(float(*this) + value); }
+  PiiHalf& operator-= (float value) { return *this = PiiHalf(float(*this) - value); }
+  PiiHalf& operator*= (float value) { return *this = PiiHalf(float(*this) * value); }
+  PiiHalf& operator/= (float value) { return *this = PiiHalf(float(*this) / value); }
+
+  /**
+   * Returns the bit pattern of the number.
+   */
+  unsigned short bits() const { return _usBits; }
+
+  /**
+   * Creates a half-precision number out of a bit pattern.
+   */
+  static PiiHalf fromBits(unsigned short bits) { PiiHalf result; result._usBits = bits; return result; }
+
+private:
+  unsigned short _usBits;
+};
+
+namespace Pii
+{
+  /**
+   * Converts the *n* first elements of *source* to `floats` and
+   * stores them to *target*.
+   */
+  PII_CORE_EXPORT void halfToFloatN(const PiiHalf* source, int n, float* target);
+
+  /**
+   * Converts the *n* first elements of *source* to half-precision
+   * numbers and stores them to *target*. The result is the same as
+   * that of floatToHalf().
+   */
+  PII_CORE_EXPORT void floatToHalfN(const float* source, int n, PiiHalf* target);
+
+  /**
+   * Converts a half-precision matrix to single precision.
+   */
+  inline PiiMatrix<float> halfToFloat(const PiiMatrix<PiiHalf>& matrix)
+  {
+    PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(matrix.rows(), matrix.columns()));
+    for (int r=0; r<matrix.rows(); ++r)
+      halfToFloatN(matrix[r], matrix.columns(), matResult[r]);
+    return matResult;
+  }
+
+  /**
+   * Converts a single-precision matrix to half precision.
+   */
+  inline PiiMatrix<PiiHalf> floatToHalf(const PiiMatrix<float>& matrix)
+  {
+    PiiMatrix<PiiHalf> matResult(PiiMatrix<PiiHalf>::uninitialized(matrix.rows(), matrix.columns()));
+    for (int r=0; r<matrix.rows(); ++r)
+      floatToHalfN(matrix[r], matrix.columns(), matResult[r]);
+    return matResult;
+  }
+
+  template <> struct Numeric<PiiHalf>
+  {
+    static PiiHalf tolerance() { return PiiHalf::fromBits(0x1400); } // 2^-10
+    static PiiHalf maxValue() { return PiiHalf::fromBits(0x7bff); }
+    static PiiHalf minValue() { return PiiHalf::fromBits(0xfbff); }
+    static PiiHalf smallestPositive() { return PiiHalf::fromBits(0x0400); }
+  };
+
+  template <> struct IsFloatingPoint<PiiHalf> : True {};
+}
+
+#endif //_PIIHALF_H
@@ -19,7 +19,23 @@
 #include <QRegExp>
 #include <QStringList>
 #include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QHash>
+#include <QReadWriteLock>
+#include <PiiAtomicInt.h>
+#include <PiiRingBuffer.h>
+#include <PiiDelay.h>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <stdint.h>
+
+// Asynchronous logging needs per-thread buffers.
+#ifdef PII_CXX11
+#  define PII_ASYNC_LOG
+#endif
 
 namespace PiiLog
 {
@@ -29,6 +45,14 @@ namespace PiiLog
   static qint64 iMaxFileSize = 1024*1024;
   static int iMaxArchivedFiles = 5;
 
+  static PiiAtomicInt iModuleLevelCount(0);
+  static QReadWriteLock moduleLevelLock;
+  static QHash<QByteArray,int>& moduleLevels()
+  {
+    static QHash<QByteArray,int> hashLevels;
+    return hashLevels;
+  }
+
   static void rotateLog()
   {
     for (int i=iMaxArchivedFiles; i>=0; --i)
@@ -47,8 +71,15 @@ namespace PiiLog
       }
   }
 
-  bool defaultMessageFilter(const char* /*module*/, QtMsgType level)
+  bool defaultMessageFilter(const char* module, QtMsgType level)
   {
+    if (iModuleLevelCount.load() != 0 && module != 0)
+      {
+        QReadLocker lock(&moduleLevelLock);
+        QHash<QByteArray,int>::const_iterator i = moduleLevels().constFind(QByteArray::fromRawData(module, int(std::strlen(module))));
+        if (i != moduleLevels().constEnd())
+          return int(level) >= i.value();
+      }
     static struct LogEnv
     {
       LogEnv()
@@ -79,13 +110,29 @@ namespace PiiLog
     file.close();
   }
 
-  MessageFilter setLogMessageFilter(MessageFilter filter)
+  MessageFilter setMessageFilter(MessageFilter filter)
   {
     MessageFilter pOldFilter = pLogMessageFilter;
     pLogMessageFilter = filter;
     return pOldFilter;
   }
 
+  void setModuleLogLevel(const char* module, int level)
+  {
+    QWriteLocker lock(&moduleLevelLock);
+    if (level < 0)
+      moduleLevels().remove(module);
+    else
+      moduleLevels().insert(module, level);
+    iModuleLevelCount = moduleLevels().size();
+  }
+
+  int moduleLogLevel(const char* module)
+  {
+    QReadLocker lock(&moduleLevelLock);
+    return moduleLevels().value(module, -1);
+  }
+
   void setLogFormat(const QString& format)
   {
     strMessageFormat = format;
@@ -111,7 +158,7 @@ namespace PiiLog
     iMaxFileSize = maxSize;
   }
 
-  qint64 getMaxFileSize()
+  qint64 maxFileSize()
   {
     return iMaxFileSize;
   }
@@ -121,7 +168,7 @@ namespace PiiLog
     iMaxArchivedFiles = maxCount;
   }
 
-  int getMaxArchivedFiles()
+  int maxArchivedFiles()
   {
     return iMaxArchivedFiles;
   }
@@ -136,19 +183,12 @@ static void outputMessage(QtMsgType level, const QString& message)
 #endif
 }
 
-void piiLogv(const char* module, QtMsgType level, const char* msg, va_list argp)
+static void formatAndOutput(const char* module, QtMsgType level, const QDateTime& time, const QString& strMessage)
 {
   // PENDING should use Pii::replaceVariables() here (DRY)
   static const QString aTypes[] = { "Debug", "Warning", "Critical", "Fatal" };
   static const QString strDefaultDateFormat("yyyy-MM-dd hh:mm");
 
-  if (PiiLog::pLogMessageFilter != 0 && !(*PiiLog::pLogMessageFilter)(module, level))
-    return;
-
-  QString strMessage;
-  if (msg != 0)
-    strMessage.vsprintf(msg, argp);
-
   if (PiiLog::strMessageFormat.isEmpty())
     outputMessage(level, strMessage);
   else
@@ -173,7 +213,7 @@ void piiLogv(const char* module, QtMsgType level, const char* msg, va_list argp)
           switch (lstVariables.indexOf(strVarName))
             {
             case 0: // time
-              strReplacement = QDateTime::currentDateTime().toString(strParams.isEmpty() ? strDefaultDateFormat : strParams);
+              strReplacement = time.toString(strParams.isEmpty() ? strDefaultDateFormat : strParams);
               break;
             case 1: // type
               strReplacement = aTypes[qBound(0, int(level), 3)].left(strParams.isEmpty() ? -1 : strParams.toInt());
@@ -191,3 +231,601 @@ void piiLogv(const char* module, QtMsgType level, const char* msg, va_list argp)
       outputMessage(level, strLogLine);
     }
 }
+
+#ifdef PII_ASYNC_LOG
+namespace
+{
+  /* A conversion specification in a printf format string. Both the
+     producer and the consumer parse the format string with the same
+     function, which makes it unnecessary to store type information
+     with the packed arguments.
+   */
+  struct ConversionSpec
+  {
+    enum ArgumentType { NoArgument, IntArgument, DoubleArgument, LongDoubleArgument,
+                        StringArgument, WideStringArgument, PointerArgument,
+                        CountArgument, UnknownArgument };
+
+    // The whole specification, starting at '%'.
+    const char* pStart;
+    int iLength;
+    // The number of '*' widths and precisions.
+    int iStarCount;
+    // 'H' for hh, 'Q' for ll and q, otherwise the modifier itself or 0.
+    char cLengthModifier;
+    ArgumentType type;
+  };
+
+  // Finds the next conversion in format. Literal text and "%%" are
+  // skipped. Returns the position after the conversion, or 0 if
+  // there are no more conversions.
+  const char* nextConversion(const char* format, ConversionSpec& spec)
+  {
+    const char* p = format;
+    for (;;)
+      {
+        p = std::strchr(p, '%');
+        if (p == 0)
+          return 0;
+        if (p[1] != '%')
+          break;
+        p += 2;
+      }
+    spec.pStart = p++;
+    spec.iStarCount = 0;
+    spec.cLengthModifier = 0;
+    while (*p != 0 && std::strchr("-+ #0'", *p) != 0) ++p;
+    if (*p == '*') { ++spec.iStarCount; ++p; }
+    while (*p >= '0' && *p <= '9') ++p;
+    if (*p == '.')
+      {
+        ++p;
+        if (*p == '*') { ++spec.iStarCount; ++p; }
+        while (*p >= '0' && *p <= '9') ++p;
+      }
+    switch (*p)
+      {
+      case 'h':
+        spec.cLengthModifier = p[1] == 'h' ? 'H' : 'h';
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+      case 'l':
+        spec.cLengthModifier = p[1] == 'l' ? 'Q' : 'l';
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+      case 'q':
+        spec.cLengthModifier = 'Q';
+        ++p;
+        break;
+      case 'L': case 'z': case 'j': case 't':
+        spec.cLengthModifier = *p++;
+        break;
+      }
+    switch (*p)
+      {
+      case 'd': case 'i': case 'c': case 'u': case 'o': case 'x': case 'X':
+        spec.type = ConversionSpec::IntArgument;
+        break;
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        spec.type = spec.cLengthModifier == 'L' ? ConversionSpec::LongDoubleArgument : ConversionSpec::DoubleArgument;
+        break;
+      case 's':
+        spec.type = spec.cLengthModifier == 'l' ? ConversionSpec::WideStringArgument : ConversionSpec::StringArgument;
+        break;
+      case 'p':
+        spec.type = ConversionSpec::PointerArgument;
+        break;
+      case 'n':
+        spec.type = ConversionSpec::CountArgument;
+        break;
+      default:
+        spec.type = ConversionSpec::UnknownArgument;
+        return 0;
+      }
+    ++p;
+    spec.iLength = int(p - spec.pStart);
+    return p;
+  }
+
+  // A log message whose formatting has been deferred to the writer
+  // thread.
+  struct LogRecord
+  {
+    enum { ModuleSize = 32, ArgumentSize = 440 };
+
+    qint64 iTime;
+    const char* pFormat;
+    int iLevel;
+    int iArgumentBytes;
+    char aModule[ModuleSize];
+    char aArguments[ArgumentSize];
+
+    template <class T> bool write(const T& value)
+    {
+      if (iArgumentBytes + int(sizeof(T)) > ArgumentSize)
+        return false;
+      std::memcpy(aArguments + iArgumentBytes, &value, sizeof(T));
+      iArgumentBytes += int(sizeof(T));
+      return true;
+    }
+
+    // Copies a zero-terminated string. Truncates if needed.
+    template <class Char> bool writeString(const Char* str)
+    {
+      int iMaxChars = (ArgumentSize - iArgumentBytes) / int(sizeof(Char)) - 1;
+      if (iMaxChars < 0)
+        return false;
+      Char* pTarget = reinterpret_cast<Char*>(aArguments + iArgumentBytes);
+      int i = 0;
+      for (; str != 0 && i < iMaxChars && str[i] != 0; ++i)
+        pTarget[i] = str[i];
+      pTarget[i] = 0;
+      iArgumentBytes += (i+1) * int(sizeof(Char));
+      return true;
+    }
+
+    template <class T> T read(int& offset) const
+    {
+      T value;
+      std::memcpy(&value, aArguments + offset, sizeof(T));
+      offset += int(sizeof(T));
+      return value;
+    }
+
+    template <class Char> const Char* readString(int& offset) const
+    {
+      const Char* pStr = reinterpret_cast<const Char*>(aArguments + offset);
+      int i = 0;
+      while (pStr[i] != 0) ++i;
+      offset += (i+1) * int(sizeof(Char));
+      return pStr;
+    }
+  };
+
+  /* Packs the arguments of msg from argp into record. Returns false
+     if a conversion is not understood or the arguments don't fit.
+     Strings are copied because they may not outlive the call.
+   */
+  bool packArguments(LogRecord& record, const char* msg, va_list argp)
+  {
+    ConversionSpec spec;
+    spec.type = ConversionSpec::NoArgument;
+    const char* p = msg;
+    while ((p = nextConversion(p, spec)) != 0)
+      {
+        for (int i=0; i<spec.iStarCount; ++i)
+          if (!record.write(va_arg(argp, int)))
+            return false;
+        bool bOk = true;
+        switch (spec.type)
+          {
+          case ConversionSpec::IntArgument:
+            {
+              qint64 iValue;
+              switch (spec.cLengthModifier)
+                {
+                case 'l': iValue = qint64(va_arg(argp, long)); break;
+                case 'Q': iValue = qint64(va_arg(argp, long long)); break;
+                case 'z': iValue = qint64(va_arg(argp, size_t)); break;
+                case 'j': iValue = qint64(va_arg(argp, intmax_t)); break;
+                case 't': iValue = qint64(va_arg(argp, ptrdiff_t)); break;
+                default: iValue = qint64(va_arg(argp, int)); break;
+                }
+              bOk = record.write(iValue);
+            }
+            break;
+          case ConversionSpec::DoubleArgument:
+            bOk = record.write(va_arg(argp, double));
+            break;
+          case ConversionSpec::LongDoubleArgument:
+            bOk = record.write(va_arg(argp, long double));
+            break;
+          case ConversionSpec::StringArgument:
+            bOk = record.writeString(va_arg(argp, const char*));
+            break;
+          case ConversionSpec::WideStringArgument:
+            // Qt's printf takes %ls as UTF-16.
+            bOk = record.writeString(va_arg(argp, const ushort*));
+            break;
+          case ConversionSpec::PointerArgument:
+            bOk = record.write(va_arg(argp, void*));
+            break;
+          case ConversionSpec::CountArgument:
+            va_arg(argp, int*);
+            break;
+          default:
+            return false;
+          }
+        if (!bOk)
+          return false;
+      }
+    // nextConversion() returns 0 also for an unknown conversion.
+    return spec.type != ConversionSpec::UnknownArgument;
+  }
+
+  // Literal text between conversions may contain escaped percent
+  // signs.
+  QString literal(const char* text, int length)
+  {
+    return QString::fromUtf8(text, length).replace("%%", "%");
+  }
+
+  QString formatOne(const char* spec, ...)
+  {
+    va_list argp;
+    va_start(argp, spec);
+    QString strResult;
+    strResult.vsprintf(spec, argp);
+    va_end(argp);
+    return strResult;
+  }
+
+  template <class T> QString formatArgument(const char* spec, const int* stars, int starCount, T value)
+  {
+    switch (starCount)
+      {
+      case 0: return formatOne(spec, value);
+      case 1: return formatOne(spec, stars[0], value);
+      default: return formatOne(spec, stars[0], stars[1], value);
+      }
+  }
+
+  // The inverse of packArguments().
+  QString unpackMessage(const LogRecord& record)
+  {
+    QString strMessage;
+    ConversionSpec spec;
+    int iOffset = 0;
+    const char* pLiteral = record.pFormat;
+    const char* p = pLiteral;
+    char aSpec[32];
+    while ((p = nextConversion(p, spec)) != 0)
+      {
+        strMessage += literal(pLiteral, int(spec.pStart - pLiteral));
+        pLiteral = p;
+        // Unreasonably long specifications are dropped.
+        if (spec.iLength >= int(sizeof(aSpec)))
+          aSpec[0] = 0;
+        else
+          {
+            std::memcpy(aSpec, spec.pStart, spec.iLength);
+            aSpec[spec.iLength] = 0;
+          }
+        int aStars[2];
+        for (int i=0; i<spec.iStarCount; ++i)
+          aStars[i] = record.read<int>(iOffset);
+        switch (spec.type)
+          {
+          case ConversionSpec::IntArgument:
+            {
+              qint64 iValue = record.read<qint64>(iOffset);
+              switch (spec.cLengthModifier)
+                {
+                case 'l': strMessage += formatArgument(aSpec, aStars, spec.iStarCount, long(iValue)); break;
+                case 'Q': strMessage += formatArgument(aSpec, aStars, spec.iStarCount, (long long)iValue); break;
+                case 'z': strMessage += formatArgument(aSpec, aStars, spec.iStarCount, size_t(iValue)); break;
+                case 'j': strMessage += formatArgument(aSpec, aStars, spec.iStarCount, intmax_t(iValue)); break;
+                case 't': strMessage += formatArgument(aSpec, aStars, spec.iStarCount, ptrdiff_t(iValue)); break;
+                default: strMessage += formatArgument(aSpec, aStars, spec.iStarCount, int(iValue)); break;
+                }
+            }
+            break;
+          case ConversionSpec::DoubleArgument:
+            strMessage += formatArgument(aSpec, aStars, spec.iStarCount, record.read<double>(iOffset));
+            break;
+          case ConversionSpec::LongDoubleArgument:
+            strMessage += formatArgument(aSpec, aStars, spec.iStarCount, record.read<long double>(iOffset));
+            break;
+          case ConversionSpec::StringArgument:
+            strMessage += formatArgument(aSpec, aStars, spec.iStarCount, record.readString<char>(iOffset));
+            break;
+          case ConversionSpec::WideStringArgument:
+            strMessage += formatArgument(aSpec, aStars, spec.iStarCount, record.readString<ushort>(iOffset));
+            break;
+          case ConversionSpec::PointerArgument:
+            strMessage += formatArgument(aSpec, aStars, spec.iStarCount, record.read<void*>(iOffset));
+            break;
+          default:
+            break;
+          }
+      }
+    strMessage += literal(pLiteral, int(std::strlen(pLiteral)));
+    return strMessage;
+  }
+
+  // A single-producer buffer owned by a logging thread.
+  struct ThreadBuffer
+  {
+    enum { Capacity = 256 };
+
+    ThreadBuffer() : buffer(Capacity), iDropped(0), iOrphaned(0) {}
+
+    PiiRingBuffer<LogRecord> buffer;
+    PiiAtomicInt iDropped;
+    // Set to one when the owning thread exits.
+    PiiAtomicInt iOrphaned;
+  };
+
+  class LogWriter;
+
+  struct AsyncState
+  {
+    AsyncState() : pWriter(0), iEnabled(0) {}
+    ~AsyncState();
+
+    // Protects lstBuffers and pWriter.
+    QMutex mutex;
+    QList<ThreadBuffer*> lstBuffers;
+    LogWriter* pWriter;
+    PiiAtomicInt iEnabled;
+  };
+
+  AsyncState& asyncState()
+  {
+    static AsyncState state;
+    return state;
+  }
+
+  // True in the writer thread, which must never queue messages to
+  // itself.
+  thread_local bool bInWriter = false;
+
+  bool recordTimeLessThan(const LogRecord& r1, const LogRecord& r2) { return r1.iTime < r2.iTime; }
+
+  class LogWriter : public QThread
+  {
+  public:
+    LogWriter() : _iRunning(1) {}
+
+    void stop() { _iRunning.storeRelease(0); }
+
+    // Formats and writes out all queued messages. Returns the number
+    // of messages written.
+    int drain()
+    {
+      AsyncState& state = asyncState();
+      QList<ThreadBuffer*> lstBuffers;
+      synchronized (state.mutex)
+        {
+          // Threads that have exited won't write any more.
+          for (int i=state.lstBuffers.size(); i--; )
+            {
+              ThreadBuffer* pBuffer = state.lstBuffers[i];
+              if (pBuffer->iOrphaned.loadAcquire() != 0 && pBuffer->buffer.isEmpty())
+                {
+                  delete pBuffer;
+                  state.lstBuffers.removeAt(i);
+                }
+            }
+          lstBuffers = state.lstBuffers;
+        }
+      int iDropped = 0;
+      for (int i=0; i<lstBuffers.size(); ++i)
+        {
+          for (int j=lstBuffers[i]->buffer.size(); j--; )
+            _vecRecords.append(lstBuffers[i]->buffer.takeFirst());
+          int iBufferDropped = lstBuffers[i]->iDropped.load();
+          if (iBufferDropped != 0)
+            {
+              lstBuffers[i]->iDropped -= iBufferDropped;
+              iDropped += iBufferDropped;
+            }
+        }
+      // Merge the messages of different threads into time order.
+      std::stable_sort(_vecRecords.begin(), _vecRecords.end(), recordTimeLessThan);
+      for (int i=0; i<_vecRecords.size(); ++i)
+        {
+          const LogRecord& record = _vecRecords[i];
+          formatAndOutput(record.aModule, QtMsgType(record.iLevel),
+                          QDateTime::fromMSecsSinceEpoch(record.iTime),
+                          unpackMessage(record));
+        }
+      int iCount = _vecRecords.size();
+      _vecRecords.clear();
+      if (iDropped != 0)
+        formatAndOutput("Into", QtWarningMsg, QDateTime::currentDateTime(),
+                        QString("PiiLog: %1 messages were dropped because the log buffer was full.").arg(iDropped));
+      return iCount;
+    }
+
+  protected:
+    void run()
+    {
+      bInWriter = true;
+      while (_iRunning.loadAcquire() != 0)
+        {
+          if (drain() == 0)
+            msleep(5);
+        }
+      drain();
+    }
+
+  private:
+    PiiAtomicInt _iRunning;
+    QVector<LogRecord> _vecRecords;
+  };
+
+  void stopWriter(AsyncState& state)
+  {
+    LogWriter* pWriter = 0;
+    synchronized (state.mutex)
+      {
+        pWriter = state.pWriter;
+        state.pWriter = 0;
+      }
+    if (pWriter != 0)
+      {
+        pWriter->stop();
+        pWriter->wait();
+        delete pWriter;
+      }
+  }
+
+  AsyncState::~AsyncState()
+  {
+    iEnabled = 0;
+    stopWriter(*this);
+    qDeleteAll(lstBuffers);
+  }
+
+  // Registers the buffer of the calling thread on first use and
+  // orphans it when the thread exits.
+  struct ThreadBufferHolder
+  {
+    ThreadBufferHolder() : pBuffer(0) {}
+    ~ThreadBufferHolder()
+    {
+      if (pBuffer != 0)
+        pBuffer->iOrphaned.storeRelease(1);
+    }
+
+    ThreadBuffer* buffer()
+    {
+      if (pBuffer == 0)
+        {
+          pBuffer = new ThreadBuffer;
+          AsyncState& state = asyncState();
+          synchronized (state.mutex) state.lstBuffers.append(pBuffer);
+        }
+      return pBuffer;
+    }
+
+    ThreadBuffer* pBuffer;
+  };
+
+  thread_local ThreadBufferHolder bufferHolder;
+
+  // Queues a message to the buffer of the calling thread. Returns
+  // false if the message must be written synchronously.
+  bool enqueue(const char* module, QtMsgType level, const char* msg, va_list argp)
+  {
+    if (bInWriter || msg == 0)
+      return false;
+    LogRecord record;
+    record.iTime = QDateTime::currentMSecsSinceEpoch();
+    record.pFormat = msg;
+    record.iLevel = int(level);
+    record.iArgumentBytes = 0;
+    std::strncpy(record.aModule, module != 0 ? module : "", LogRecord::ModuleSize - 1);
+    record.aModule[LogRecord::ModuleSize - 1] = 0;
+
+    va_list args;
+    va_copy(args, argp);
+    bool bPacked = packArguments(record, msg, args);
+    va_end(args);
+    if (!bPacked)
+      {
+        // Format in the calling thread as a last resort.
+        QString strMessage;
+        strMessage.vsprintf(msg, argp);
+        record.pFormat = "%s";
+        record.iArgumentBytes = 0;
+        record.writeString(strMessage.toUtf8().constData());
+      }
+
+    ThreadBuffer* pBuffer = bufferHolder.buffer();
+    if (pBuffer->buffer.isFull())
+      ++pBuffer->iDropped;
+    else
+      pBuffer->buffer.append(record);
+    return true;
+  }
+
+  // Waits until the writer has written out everything queued so far.
+  void waitDrained()
+  {
+    AsyncState& state = asyncState();
+    for (int iRound = 0; iRound < 1000; ++iRound)
+      {
+        bool bEmpty = true;
+        synchronized (state.mutex)
+          {
+            if (state.pWriter == 0)
+              return;
+            for (int i=0; i<state.lstBuffers.size(); ++i)
+              if (!state.lstBuffers[i]->buffer.isEmpty())
+                bEmpty = false;
+          }
+        if (bEmpty)
+          return;
+        PiiDelay::msleep(1);
+      }
+  }
+}
+#endif
+
+namespace PiiLog
+{
+  void setAsynchronous(bool asynchronous)
+  {
+#ifdef PII_ASYNC_LOG
+    AsyncState& state = asyncState();
+    if (asynchronous)
+      {
+        synchronized (state.mutex)
+          {
+            if (state.pWriter == 0)
+              {
+                state.pWriter = new LogWriter;
+                state.pWriter->start();
+              }
+          }
+        state.iEnabled = 1;
+      }
+    else
+      {
+        state.iEnabled = 0;
+        stopWriter(state);
+      }
+#else
+    Q_UNUSED(asynchronous);
+#endif
+  }
+
+  bool isAsynchronous()
+  {
+#ifdef PII_ASYNC_LOG
+    return asyncState().iEnabled.load() != 0;
+#else
+    return false;
+#endif
+  }
+
+  void flush()
+  {
+#ifdef PII_ASYNC_LOG
+    if (isAsynchronous())
+      waitDrained();
+#endif
+  }
+
+  void logv(const char* module, QtMsgType level, const char* msg, va_list argp)
+  {
+#ifdef PII_ASYNC_LOG
+    if (isAsynchronous())
+      {
+        // The application will be aborted after a fatal message.
+        // Write out everything before it.
+        if (level == QtFatalMsg)
+          flush();
+        else if (enqueue(module, level, msg, argp))
+          return;
+      }
+#endif
+    QString strMessage;
+    if (msg != 0)
+      strMessage.vsprintf(msg, argp);
+    formatAndOutput(module, level, QDateTime::currentDateTime(), strMessage);
+  }
+}
+
+bool piiLogEnabled(const char* module, QtMsgType level)
+{
+  return PiiLog::pLogMessageFilter == 0 || (*PiiLog::pLogMessageFilter)(module, level);
+}
+
+void piiLogv(const char* module, QtMsgType level, const char* msg, va_list argp)
+{
+  if (piiLogEnabled(module, level))
+    PiiLog::logv(module, level, msg, argp);
+}
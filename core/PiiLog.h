@@ -52,6 +52,18 @@
  * #define PII_LOG_MODULE MyModule
  * #include <PiiGlobal.h>
  * ~~~
+ *
+ * piiDebug(), piiWarning() etc. are macros that pass the module name
+ * and the message type to the message filter (see
+ * PiiLog::setMessageFilter()) before the arguments are evaluated.
+ * A disabled log message thus costs one filter call, no matter how
+ * expensive the arguments are to compute.
+ *
+ * By default, messages are formatted and written in the calling
+ * thread. In asynchronous mode (see PiiLog::setAsynchronous()), the
+ * calling thread only copies the arguments to a thread-private
+ * lock-free buffer, and a background thread formats and writes the
+ * messages.
  */
 
 #include <QString>
@@ -106,6 +118,12 @@ PII_CORE_EXPORT void piiLogv(const char* module, QtMsgType level, const char* ms
  *
  * @param msg the log message in printf format.
  */
+/**
+ * Returns `true` if a message from *module* at *level* passes the
+ * current [message filter](PiiLog::setMessageFilter()).
+ */
+PII_CORE_EXPORT bool piiLogEnabled(const char* module, QtMsgType level);
+
 inline void PII_PRINTF_ATTR(3,4) piiLog(const char* module, QtMsgType level, const char* msg, ...)
 {
   va_list argp;
@@ -190,6 +208,68 @@ namespace PiiLog
    */
   PII_CORE_EXPORT bool defaultMessageFilter(const char* module, QtMsgType level);
 
+  /**
+   * Sets the log level of *module* for the
+   * [default message filter](defaultMessageFilter()). Messages from
+   * *module* are logged if their level is higher than or equal to
+   * *level*, irrespective of `PII_LOG_LEVEL`. A negative *level*
+   * removes the module-specific setting.
+   *
+   * ~~~(c++)
+   * // Show debug messages from MyPlugin only
+   * PiiLog::setModuleLogLevel("MyPlugin", QtDebugMsg);
+   * ~~~
+   */
+  PII_CORE_EXPORT void setModuleLogLevel(const char* module, int level);
+
+  /**
+   * Returns the log level of *module*, or -1 if there is no
+   * module-specific setting.
+   */
+  PII_CORE_EXPORT int moduleLogLevel(const char* module);
+
+  /**
+   * Enables or disables asynchronous logging. In asynchronous mode,
+   * each logging thread packs the arguments of its messages into a
+   * thread-private lock-free ring buffer, and a background thread
+   * formats the messages and passes them to the message handler in
+   * time order. Logging thus doesn't block or change the timing of
+   * the calling thread. Disabling asynchronous mode writes out all
+   * queued messages.
+   *
+   * Note that only the pointer to the format string is stored. In
+   * asynchronous mode, the format string must therefore remain
+   * valid after the log call, which is the case with string
+   * literals. String arguments are copied and truncated to a few
+   * hundred bytes per message. If a thread logs faster than the
+   * messages can be written out, its buffer fills up and new
+   * messages are dropped. The number of dropped messages is reported
+   * in a warning. Fatal messages are always written synchronously
+   * after the queued messages.
+   *
+   * ! Asynchronous logging requires C++11 support. Without it, this
+   * function does nothing.
+   */
+  PII_CORE_EXPORT void setAsynchronous(bool asynchronous);
+
+  /**
+   * Returns `true` if asynchronous logging is enabled.
+   */
+  PII_CORE_EXPORT bool isAsynchronous();
+
+  /**
+   * Waits until all messages queued in asynchronous mode have been
+   * written out.
+   */
+  PII_CORE_EXPORT void flush();
+
+  /**
+   * Writes a log message without consulting the message filter.
+   *
+   * @internal
+   */
+  PII_CORE_EXPORT void logv(const char* module, QtMsgType level, const char* msg, va_list argp);
+
   /**
    * Sets the log format. The default log format is an empty string,
    * which means that only the message itself will be logged. The
@@ -295,6 +375,25 @@ PII_LOG_FUNCTION(Fatal)
 PII_LOG_FUNCTION_NOOP(Fatal)
 #endif
 
+// Check the filter before the arguments are evaluated. The macro
+// does not expand recursively, and the inner name refers to the
+// function.
+#define PII_LOG_MACRO(NAME, ...) \
+  (piiLogEnabled(piiLogModuleName, Qt##NAME##Msg) ? pii##NAME(__VA_ARGS__) : (void)0)
+
+#if PII_LOG_LEVEL < 1
+#  define piiDebug(...) PII_LOG_MACRO(Debug, __VA_ARGS__)
+#endif
+#if PII_LOG_LEVEL < 2
+#  define piiWarning(...) PII_LOG_MACRO(Warning, __VA_ARGS__)
+#endif
+#if PII_LOG_LEVEL < 3
+#  define piiCritical(...) PII_LOG_MACRO(Critical, __VA_ARGS__)
+#endif
+#if PII_LOG_LEVEL < 4
+#  define piiFatal(...) PII_LOG_MACRO(Fatal, __VA_ARGS__)
+#endif
+
 /// @endhide
 
 #endif //_PIILOG_H
@@ -0,0 +1,189 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMAILBOX_H
+#define _PIIMAILBOX_H
+
+#include "PiiAtomicInt.h"
+
+/**
+ * A bounded, lock-free multiple-producer/single-consumer queue for
+ * passing events to a receiving thread. Any number of threads may
+ * append() objects simultaneously, while one thread takes them out
+ * with takeFirst(). Appending never allocates memory and never
+ * blocks. If the mailbox is full, append() fails.
+ *
+ * To avoid waking the consumer for each object, the mailbox has a
+ * *pending* flag. A producer calls notify() after appending. Only the
+ * first call after the consumer has [acknowledged](acknowledge()) the
+ * previous notification returns `true`, and only then the producer
+ * needs to wake up the consumer, for example by emitting a queued
+ * signal. The consumer acknowledges before reading the mailbox empty.
+ *
+ * ~~~(c++)
+ * PiiMailbox<PiiVariant> mailbox(1024);
+ *
+ * // Producer thread(s)
+ * if (mailbox.append(obj) && mailbox.notify())
+ *   emit objectsAvailable();
+ *
+ * // Consumer thread, in a slot connected to objectsAvailable()
+ * mailbox.acknowledge();
+ * PiiVariant obj;
+ * while (mailbox.takeFirst(obj))
+ *   handle(obj);
+ * ~~~
+ */
+template <class T> class PiiMailbox
+{
+public:
+  /**
+   * Creates a mailbox that can hold at least *capacity* objects. The
+   * capacity is rounded up to the next power of two.
+   */
+  PiiMailbox(int capacity = 1) :
+    _pSlots(0), _uMask(0), _uHead(0)
+  {
+    setCapacity(capacity);
+  }
+
+  ~PiiMailbox()
+  {
+    delete[] _pSlots;
+  }
+
+  /**
+   * Changes the capacity of the mailbox. All queued objects will be
+   * destroyed. This function is not thread-safe.
+   */
+  void setCapacity(int capacity)
+  {
+    unsigned int uCapacity = 1;
+    while (uCapacity < unsigned(capacity) && uCapacity < 0x40000000u)
+      uCapacity <<= 1;
+    delete[] _pSlots;
+    _pSlots = new Slot[uCapacity];
+    _uMask = uCapacity - 1;
+    for (unsigned int i=0; i<uCapacity; ++i)
+      _pSlots[i].iSequence.store(int(i));
+    _uHead = 0;
+    _iTail.store(0);
+    _iPending.store(0);
+  }
+
+  /**
+   * Returns the maximum number of objects in the mailbox.
+   */
+  int capacity() const { return int(_uMask + 1); }
+
+  /**
+   * Adds *value* to the tail of the queue. Returns `false` if the
+   * mailbox is full. Any thread may call this function.
+   */
+  bool append(const T& value)
+  {
+    unsigned int uPos = unsigned(_iTail.load());
+    Slot* pSlot;
+    for (;;)
+      {
+        pSlot = _pSlots + (uPos & _uMask);
+        int iDiff = int(unsigned(pSlot->iSequence.loadAcquire()) - uPos);
+        if (iDiff == 0)
+          {
+            // The slot is free. Try to reserve it.
+            if (_iTail.testAndSet(int(uPos), int(uPos + 1)))
+              break;
+            uPos = unsigned(_iTail.load());
+          }
+        else if (iDiff < 0)
+          // The consumer hasn't released the slot yet.
+          return false;
+        else
+          // Another producer took the slot.
+          uPos = unsigned(_iTail.load());
+      }
+    pSlot->value = value;
+    // Publish the object to the consumer.
+    pSlot->iSequence.storeRelease(int(uPos + 1));
+    return true;
+  }
+
+  /**
+   * Takes the object at the head of the queue to *value*. Returns
+   * `false` if the mailbox is empty. Only the consumer may call this
+   * function. Note that an object is not visible to the consumer
+   * until the producer that appended it has finished, even if
+   * objects appended after it are.
+   */
+  bool takeFirst(T& value)
+  {
+    Slot* pSlot = _pSlots + (_uHead & _uMask);
+    if (int(unsigned(pSlot->iSequence.loadAcquire()) - (_uHead + 1)) < 0)
+      return false;
+    value = pSlot->value;
+    // Release the reference before the slot is handed back to the
+    // producers.
+    pSlot->value = T();
+    pSlot->iSequence.storeRelease(int(_uHead + _uMask + 1));
+    ++_uHead;
+    return true;
+  }
+
+  /**
+   * Returns `true` if there are no objects readable by the consumer.
+   */
+  bool isEmpty() const
+  {
+    const Slot* pSlot = _pSlots + (_uHead & _uMask);
+    return int(unsigned(pSlot->iSequence.loadAcquire()) - (_uHead + 1)) < 0;
+  }
+
+  /**
+   * Marks the mailbox pending. Returns `true` if it wasn't pending
+   * before, in which case the caller must wake up the consumer. Any
+   * thread may call this function.
+   */
+  bool notify() { return _iPending.load() == 0 && _iPending.testAndSet(0, 1); }
+
+  /**
+   * Clears the pending flag. The consumer must call this function
+   * before it starts reading objects. Objects appended after this
+   * will be followed by a new notification.
+   */
+  void acknowledge() { _iPending.store(0); }
+
+private:
+  PiiMailbox(const PiiMailbox&);
+  PiiMailbox& operator= (const PiiMailbox&);
+
+  // Each slot has a sequence number that tells whose turn it is.
+  // When the sequence number equals the position of the slot, it is
+  // free for a producer. Position + 1 means that the slot contains
+  // an object for the consumer. All positions are unsigned and wrap
+  // around.
+  struct Slot
+  {
+    T value;
+    PiiAtomicInt iSequence;
+  };
+
+  Slot* _pSlots;
+  unsigned int _uMask;
+  unsigned int _uHead;
+  PiiAtomicInt _iTail;
+  PiiAtomicInt _iPending;
+};
+
+#endif //_PIIMAILBOX_H
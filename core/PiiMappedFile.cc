@@ -0,0 +1,117 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMappedFile.h"
+
+#if defined(_WIN32)
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+PiiMappedFile::PiiMappedFile(char* base, std::size_t offset, std::size_t size, void* handle) :
+  _ref(1),
+  _pBase(base),
+  _pData(base + offset),
+  _iSize(size),
+  _pHandle(handle)
+{}
+
+PiiMappedFile::~PiiMappedFile()
+{
+#if defined(_WIN32)
+  UnmapViewOfFile(_pBase);
+  CloseHandle(static_cast<HANDLE>(_pHandle));
+#else
+  munmap(_pBase, _iSize + std::size_t(_pData - _pBase));
+#endif
+}
+
+PiiMappedFile* PiiMappedFile::map(int fd)
+{
+  if (fd < 0)
+    return 0;
+#if defined(_WIN32)
+  HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+  LARGE_INTEGER size;
+  if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &size) || size.QuadPart <= 0)
+    return 0;
+  HANDLE hMapping = CreateFileMapping(hFile, 0, PAGE_WRITECOPY, 0, 0, 0);
+  if (hMapping == 0)
+    return 0;
+  void* pData = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+  if (pData == 0)
+    {
+      CloseHandle(hMapping);
+      return 0;
+    }
+  return new PiiMappedFile(static_cast<char*>(pData), 0, std::size_t(size.QuadPart), hMapping);
+#else
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    return 0;
+  void* pData = mmap(0, std::size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (pData == MAP_FAILED)
+    return 0;
+  return new PiiMappedFile(static_cast<char*>(pData), 0, std::size_t(info.st_size), 0);
+#endif
+}
+
+PiiMappedFile* PiiMappedFile::map(int fd, qint64 offset, std::size_t size, MappingMode mode)
+{
+  if (fd < 0 || offset < 0 || size == 0)
+    return 0;
+#if defined(_WIN32)
+  HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+  LARGE_INTEGER fileSize;
+  if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &fileSize) ||
+      fileSize.QuadPart < offset + qint64(size))
+    return 0;
+  // Views must start at a multiple of the allocation granularity.
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const qint64 iStart = offset - offset % info.dwAllocationGranularity;
+  const std::size_t iDelta = std::size_t(offset - iStart);
+  HANDLE hMapping = CreateFileMapping(hFile, 0, mode == ReadWrite ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, 0);
+  if (hMapping == 0)
+    return 0;
+  void* pData = MapViewOfFile(hMapping, mode == ReadWrite ? FILE_MAP_WRITE : FILE_MAP_COPY,
+                              DWORD(quint64(iStart) >> 32), DWORD(iStart & 0xffffffff),
+                              size + iDelta);
+  if (pData == 0)
+    {
+      CloseHandle(hMapping);
+      return 0;
+    }
+  return new PiiMappedFile(static_cast<char*>(pData), iDelta, size, hMapping);
+#else
+  struct stat info;
+  if (fstat(fd, &info) != 0 || qint64(info.st_size) < offset + qint64(size))
+    return 0;
+  // Mappings must start at a page boundary.
+  const qint64 iPageSize = sysconf(_SC_PAGESIZE);
+  const qint64 iStart = offset - offset % iPageSize;
+  const std::size_t iDelta = std::size_t(offset - iStart);
+  void* pData = mmap(0, size + iDelta, PROT_READ | PROT_WRITE,
+                     mode == ReadWrite ? MAP_SHARED : MAP_PRIVATE,
+                     fd, off_t(iStart));
+  if (pData == MAP_FAILED)
+    return 0;
+  return new PiiMappedFile(static_cast<char*>(pData), iDelta, size, 0);
+#endif
+}
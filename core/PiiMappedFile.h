@@ -0,0 +1,112 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMAPPEDFILE_H
+#define _PIIMAPPEDFILE_H
+
+#include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
+#include <cstddef>
+
+/**
+ * A memory mapping of a file. By default, the whole file is mapped
+ * privately: writes to the mapped memory are visible only to this
+ * process and never reach the file. A part of a file can also be
+ * mapped so that writes go to the file. The mapping is reference counted
+ * and it stays valid after the file descriptor it was created from
+ * has been closed. It will be unmapped once the last reference is
+ * released.
+ *
+ * PiiMappedFile makes it possible to use large data blocks stored in
+ * files without copying them. For example, PiiBinaryInputArchive
+ * maps large matrices directly into [PiiMatrix] instances.
+ *
+ * ~~~(c++)
+ * PiiMappedFile* pFile = PiiMappedFile::map(file.handle());
+ * if (pFile != 0)
+ *   {
+ *     PiiMatrix<float> mat(rows, columns, pFile->data() + offset, pFile);
+ *     pFile->release(); // mat holds a reference
+ *   }
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiMappedFile
+{
+public:
+  /**
+   * Mapping modes.
+   *
+   * - `CopyOnWrite` - writes to the mapped memory are private to
+   * this process.
+   *
+   * - `ReadWrite` - writes to the mapped memory are stored to the
+   * file. The file must have been opened for writing.
+   */
+  enum MappingMode { CopyOnWrite, ReadWrite };
+
+  /**
+   * Maps the whole file referred to by the file descriptor *fd*.
+   * Returns a new mapping with a reference count of one, or zero if
+   * the file cannot be mapped. Empty files cannot be mapped.
+   */
+  static PiiMappedFile* map(int fd);
+
+  /**
+   * Maps *size* bytes starting at *offset* of the file referred to
+   * by *fd*. The offset need not be aligned to a page boundary. The
+   * mapped range must be within the file. Returns a new mapping with
+   * a reference count of one, or zero if the range cannot be mapped.
+   */
+  static PiiMappedFile* map(int fd, qint64 offset, std::size_t size, MappingMode mode);
+
+  /**
+   * Returns a pointer to the beginning of the mapped range. If the
+   * whole file was mapped, the pointer is aligned to a page
+   * boundary.
+   */
+  char* data() const { return _pData; }
+
+  /**
+   * Returns the size of the mapped range in bytes.
+   */
+  std::size_t size() const { return _iSize; }
+
+  /**
+   * Increases the reference count by one.
+   */
+  void reserve() { _ref.ref(); }
+
+  /**
+   * Decreases the reference count by one. Unmaps the file and
+   * deletes this object once the count reaches zero.
+   */
+  void release() { if (!_ref.deref()) delete this; }
+
+private:
+  PiiMappedFile(char* base, std::size_t offset, std::size_t size, void* handle);
+  ~PiiMappedFile();
+
+  PiiAtomicInt _ref;
+  // The mapping starts at an aligned address before the data.
+  char* _pBase;
+  char* _pData;
+  std::size_t _iSize;
+  // Platform-specific mapping handle
+  void* _pHandle;
+
+  PII_DISABLE_COPY(PiiMappedFile);
+};
+
+#endif //_PIIMAPPEDFILE_H
@@ -294,13 +294,7 @@ namespace Pii
       {
         PiiMatrix<U> result(PiiMatrix<U>::uninitialized(iRows, 1));
         for (int r=0; r<iRows; ++r)
-          {
-            U sum(0);
-            Row row = mat.rowBegin(r);
-            for (int c=0; c<iCols; ++c)
-              sum += U(row[c]);
-            *result[r] = sum;
-          }
+          *result[r] = MatrixReduction<VectorizedReduction<Matrix,U>::boolValue>::template sumRow<U>(mat, r);
         return result;
       }
   }
@@ -498,15 +492,172 @@ namespace Pii
     delete[] pSum;
   }
 
+  template <bool vectorized> struct MatrixReduction
+  {
+    template <class U, class Matrix> static U sum(const Matrix& mat)
+    {
+      return Pii::accumulate(mat.begin(), mat.end(), std::plus<U>(), U(0));
+    }
+
+    template <class U, class Matrix> static U sumRow(const Matrix& mat, int r)
+    {
+      typename Matrix::const_row_iterator row = mat.rowBegin(r);
+      U sum(0);
+      for (int c=0; c<mat.columns(); ++c)
+        sum += U(row[c]);
+      return sum;
+    }
+
+    template <class U, class Matrix> static U var(const Matrix& mat, U* average)
+    {
+      U avg = mean<U>(mat);
+      U sum(0);
+      for (typename Matrix::const_iterator i = mat.begin(); i != mat.end(); ++i)
+        sum += square(U(*i) - avg);
+      if (average != 0)
+        *average = avg;
+      return sum != 0 ? (sum / (mat.rows() * mat.columns())) : 0;
+    }
+
+    template <class Matrix> static void minMax(const Matrix& mat,
+                                               typename Matrix::value_type* minimum,
+                                               typename Matrix::value_type* maximum,
+                                               int* minR, int* minC,
+                                               int* maxR, int* maxC)
+    {
+      typename Matrix::const_iterator minIt = mat.begin(), maxIt = mat.begin();
+      for (typename Matrix::const_iterator it = mat.begin(); it != mat.end(); ++it)
+        {
+          if (*it < *minIt)
+            minIt = it;
+          else if (*it > *maxIt)
+            maxIt = it;
+        }
+      *minimum = *minIt;
+      *maximum = *maxIt;
+      if (minR) *minR = minIt.row();
+      if (minC) *minC = minIt.column();
+      if (maxR) *maxR = maxIt.row();
+      if (maxC) *maxC = maxIt.column();
+    }
+
+    template <class Matrix> static double norm1(const Matrix& mat)
+    {
+      typedef typename Matrix::value_type T;
+      return forEach(mat.begin(), mat.end(),
+                     createForEachFunction(Abs<T>(), std::plus<typename Abs<T>::result_type>(), 0))();
+    }
+
+    template <class Matrix> static double sumOfSquares(const Matrix& mat)
+    {
+      return forEach(mat.begin(), mat.end(),
+                     createForEachFunction(Square<typename Matrix::value_type>(),
+                                           std::plus<double>(), 0))();
+    }
+  };
+
+  /* Each row is reduced with a vectorized kernel, and the partial
+     results are combined in the accumulator type of the element
+     type. The variance uses the two-pass algorithm as above. With
+     integer elements, the deviations of a row are expanded in terms
+     of exact integer sums.
+   */
+  template <> struct MatrixReduction<true>
+  {
+    template <class U, class T> static U sum(const PiiMatrix<T>& mat)
+    {
+      typename ReductionTraits<T>::SumType total(0);
+      for (int r=0; r<mat.rows(); ++r)
+        total += sumN(mat[r], mat.columns());
+      return U(total);
+    }
+
+    template <class U, class T> static U sumRow(const PiiMatrix<T>& mat, int r)
+    {
+      return U(sumN(mat[r], mat.columns()));
+    }
+
+    template <class U, class T> static U var(const PiiMatrix<T>& mat, U* average)
+    {
+      const int iCount = mat.rows() * mat.columns();
+      const double dMean = double(sum<typename ReductionTraits<T>::SumType>(mat)) / iCount;
+      double dSum = 0;
+      for (int r=0; r<mat.rows(); ++r)
+        dSum += deviationSum(mat[r], mat.columns(), dMean);
+      if (average != 0)
+        *average = U(dMean);
+      return dSum > 0 ? U(dSum / iCount) : U(0);
+    }
+
+    template <class T> static void minMax(const PiiMatrix<T>& mat,
+                                          T* minimum, T* maximum,
+                                          int* minR, int* minC,
+                                          int* maxR, int* maxC)
+    {
+      const int iColumns = mat.columns();
+      int iMinRow = 0, iMaxRow = 0;
+      minMaxN(mat[0], iColumns, minimum, maximum);
+      for (int r=1; r<mat.rows(); ++r)
+        {
+          T rowMin, rowMax;
+          minMaxN(mat[r], iColumns, &rowMin, &rowMax);
+          if (rowMin < *minimum)
+            {
+              *minimum = rowMin;
+              iMinRow = r;
+            }
+          if (rowMax > *maximum)
+            {
+              *maximum = rowMax;
+              iMaxRow = r;
+            }
+        }
+      // Only the first occurrence on the row needs to be searched.
+      if (minR) *minR = iMinRow;
+      if (minC) *minC = int(std::find(mat[iMinRow], mat[iMinRow] + iColumns, *minimum) - mat[iMinRow]);
+      if (maxR) *maxR = iMaxRow;
+      if (maxC) *maxC = int(std::find(mat[iMaxRow], mat[iMaxRow] + iColumns, *maximum) - mat[iMaxRow]);
+    }
+
+    template <class T> static double norm1(const PiiMatrix<T>& mat)
+    {
+      double dSum = 0;
+      for (int r=0; r<mat.rows(); ++r)
+        dSum += double(absSum(mat[r], mat.columns()));
+      return dSum;
+    }
+
+    template <class T> static double sumOfSquares(const PiiMatrix<T>& mat)
+    {
+      double dSum = 0;
+      for (int r=0; r<mat.rows(); ++r)
+        dSum += double(sumOfSquaresN(mat[r], mat.columns()));
+      return dSum;
+    }
+
+  private:
+    template <class T> static double integerDeviationSum(const T* row, int n, double mean)
+    {
+      // sum((x-m)^2) = sum(x^2) - 2m sum(x) + n m^2
+      const double dSum = double(sumN(row, n));
+      return double(sumOfSquaresN(row, n)) - mean * (2 * dSum - n * mean);
+    }
+
+    static double deviationSum(const unsigned char* row, int n, double mean) { return integerDeviationSum(row, n, mean); }
+    static double deviationSum(const short* row, int n, double mean) { return integerDeviationSum(row, n, mean); }
+    static double deviationSum(const unsigned short* row, int n, double mean) { return integerDeviationSum(row, n, mean); }
+    static double deviationSum(const float* row, int n, double mean) { return squaredDeviationSumN(row, n, mean); }
+    static double deviationSum(const double* row, int n, double mean) { return squaredDeviationSumN(row, n, mean); }
+
+    static long long absSum(const unsigned char* row, int n) { return sumN(row, n); }
+    static long long absSum(const unsigned short* row, int n) { return sumN(row, n); }
+    template <class T> static typename ReductionTraits<T>::SumType absSum(const T* row, int n) { return absSumN(row, n); }
+  };
+
   template <class U, class Matrix> U var(const Matrix& mat, U* average)
   {
-    U avg = mean<U>(mat);
-    U sum(0);
-    for (typename Matrix::const_iterator i = mat.begin(); i != mat.end(); ++i)
-      sum += square(U(*i) - avg);
-    if (average != 0)
-      *average = avg;
-    return sum != 0 ? (sum / (mat.rows() * mat.columns())) : 0;
+    return MatrixReduction<And<VectorizedReduction<Matrix,U>::boolValue,
+                               IsFloatingPoint<U>::boolValue>::boolValue>::var(mat, average);
   }
 
   template <class U, class Matrix> PiiMatrix<U> var(const Matrix& mat, MatrixDirection direction)
@@ -623,20 +774,9 @@ namespace Pii
   {
     if (mat.isEmpty())
       return;
-    typename Matrix::const_iterator minIt = mat.begin(), maxIt = mat.begin();
-    for (typename Matrix::const_iterator it = mat.begin(); it != mat.end(); ++it)
-      {
-        if (*it < *minIt)
-          minIt = it;
-        else if (*it > *maxIt)
-          maxIt = it;
-      }
-    *minimum = *minIt;
-    *maximum = *maxIt;
-    if (minR) *minR = minIt.row();
-    if (minC) *minC = minIt.column();
-    if (maxR) *maxR = maxIt.row();
-    if (maxC) *maxC = maxIt.column();
+    typedef typename Matrix::value_type T;
+    MatrixReduction<VectorizedReduction<Matrix,T>::boolValue>::minMax(mat, minimum, maximum,
+                                                                     minR, minC, maxR, maxC);
   }
 
   template <class T> PiiMatrix<T> diff(const PiiMatrix<T>& mat, int step, int order, MatrixDirection direction)
@@ -803,101 +943,191 @@ namespace Pii
     heap.sort();
   }
 
-  template <class T> T kthSmallest(T* data,int size, int k)
+  /// @hide
+  namespace Private
   {
-    if(size <= 6)
-      {
-        //Case when there is not so many elements we just sort data
-        //and take k:th element.
-
-        insertionSort(data,size);
-        return data[k];
+    // Moves the elements smaller than pivot to the beginning of the
+    // range [begin, end) and returns the end of them. There are no
+    // data-dependent branches in the loop: every element is swapped,
+    // and the store position moves conditionally.
+    template <class T, class LessThan>
+    inline T* branchlessPartition(T* begin, T* end, const T& pivot, LessThan lessThan)
+    {
+      T* pStore = begin;
+      for (; begin != end; ++begin)
+        {
+          T value = *begin;
+          *begin = *pStore;
+          *pStore = value;
+          pStore += lessThan(value, pivot) ? 1 : 0;
+        }
+      return pStore;
+    }
+
+    template <class T> struct SelectLess
+    {
+      bool operator() (const T& a, const T& b) const { return a < b; }
+    };
+    // !(pivot < value), i.e. value <= pivot
+    template <class T> struct SelectNotGreater
+    {
+      bool operator() (const T& a, const T& b) const { return !(b < a); }
+    };
+
+    // Median of medians of five. Reorders data.
+    template <class T> T medianOfMedians(T* data, int size)
+    {
+      const int iGroups = size / 5;
+      for (int i = 0; i < iGroups; ++i)
+        {
+          median5(data + i*5);
+          qSwap(data[i], data[i*5+2]);
+        }
+      return kthSmallest(data, iGroups, (iGroups-1) / 2);
+    }
+  }
+  /// @endhide
 
-      }
-    else
+  template <class T> T kthSmallest(T* data, int size, int k)
+  {
+    // After this many unbalanced partitions, pivots are chosen with
+    // the median of medians, which guarantees linear time.
+    int iBadPartitions = 0;
+    while (size > 16)
       {
-
-        //Lets divide data to to five element groups.
-
-        int overElements = size % 5;
-        int groups = size / 5;
-
-        //Here we go through data and divide it to groups (which
-        //contains five elements) and we search median value to each group.
-        //after that we will swap median value to begin of each data.
-
-        for (int i = 0; i < groups; ++i)
+        T pivot;
+        if (iBadPartitions < 4)
           {
-            median5(data + i*5);
-            qSwap(data[i], data[i*5+2]);
+            T* pMiddle = data + size/2;
+            T aCandidates[3] = { data[0], *pMiddle, data[size-1] };
+            pivot = median3(aCandidates);
           }
+        else
+          pivot = Private::medianOfMedians(data, size);
 
-        if (overElements != 0)
+        // [data, pLess) < pivot <= [pLess, end)
+        T* pEnd = data + size;
+        T* pLess = Private::branchlessPartition(data, pEnd, pivot, Private::SelectLess<T>());
+        int iLess = int(pLess - data);
+        if (k < iLess)
           {
-            T* lastElements = data + groups*5;
-            T value = medianN(lastElements, overElements);
-            for (int i=0; i<overElements; ++i)
-              {
-                if (lastElements[i] == value)
-                  {
-                    qSwap(lastElements[i], data[groups]);
-                    break;
-                  }
-              }
-            ++groups;
+            if (iLess > size - size/8)
+              ++iBadPartitions;
+            size = iLess;
+            continue;
           }
-
-        //Then we will search median of medians.
-
-        T m = medianN(data, groups);
-
-        //Now we will use partition function to divide data so that at
-        //position x there will be median of medians (m) and on
-        //position 0 to x-1 there will be smaller values and at x+1 to
-        //groups there will be greater values.
-
-        int index = 0;
-        for(int p = 0; p < size; ++p)
-          {
-            if(data[p] == m)
-              {
-                index = p;
-                break;
-              }
-          }
-
-        int x = partition(data, size, index);
-
-        if (k == x)
-          return m;
-        else if (k < x)
-          return kthSmallest(data, x, k);
-        else
-          return kthSmallest(data + x+1, size-x-1, k-x-1);
-
-
+        // [pLess, pEqual) == pivot < [pEqual, end)
+        T* pEqual = Private::branchlessPartition(pLess, pEnd, pivot, Private::SelectNotGreater<T>());
+        int iNotGreater = int(pEqual - data);
+        if (k < iNotGreater)
+          return pivot;
+        if (iNotGreater < size/8)
+          ++iBadPartitions;
+        data = pEqual;
+        size -= iNotGreater;
+        k -= iNotGreater;
       }
+    insertionSort(data, size);
+    return data[k];
   }
+
   template <class T> int partition(T* data, int size, int pivot)
   {
-
     T pivotValue = data[pivot];
     qSwap(data[pivot], data[size-1]);
-    int storePos = 0;
-    int elements = size-1;
-    for(int loadPos = 0; loadPos < elements; ++loadPos)
+    int storePos = int(Private::branchlessPartition(data, data + size-1, pivotValue,
+                                                    Private::SelectLess<T>()) - data);
+    qSwap(data[storePos], data[size-1]);
+    return storePos;
+  }
+
+  /// @hide
+  namespace Private
+  {
+    template <class T> inline void networkCompareExchange(T& a, T& b)
+    {
+      const T x(a), y(b);
+      const bool bLess = y < x;
+      a = bLess ? y : x;
+      b = bLess ? x : y;
+    }
+
+    /* Batcher's odd-even merge sort, unrolled at compile time. The
+       network is built for the smallest power of two P >= N.
+       Comparators that would touch the padding (indices >= N) are
+       left out, which is equivalent to padding with infinities.
+     */
+    template <int N, int I, int J, bool bActive = (J < N)> struct NetworkComparator
+    {
+      template <class Iterator> static inline void apply(Iterator p) { networkCompareExchange(p[I], p[J]); }
+    };
+    template <int N, int I, int J> struct NetworkComparator<N,I,J,false>
+    {
+      template <class Iterator> static inline void apply(Iterator) {}
+    };
+
+    // for (i = I; i + R < Hi; i += 2*R) compare(i, i + R)
+    template <int N, int I, int R, int Hi, bool bActive = (I + R < Hi && I + R < N)> struct NetworkMergeLoop
+    {
+      template <class Iterator> static inline void apply(Iterator p)
       {
-        if (data[loadPos] < pivotValue)
-          {
-            qSwap(data[loadPos], data[storePos]);
-            storePos++;
-          }
+        NetworkComparator<N,I,I+R>::apply(p);
+        NetworkMergeLoop<N,I+2*R,R,Hi>::apply(p);
       }
+    };
+    template <int N, int I, int R, int Hi> struct NetworkMergeLoop<N,I,R,Hi,false>
+    {
+      template <class Iterator> static inline void apply(Iterator) {}
+    };
+
+    // Merges the sorted halves of [Lo, Hi], considering every R'th element.
+    template <int N, int Lo, int Hi, int R, bool bRecurse = (2*R < Hi - Lo)> struct NetworkMerge
+    {
+      template <class Iterator> static inline void apply(Iterator p)
+      {
+        NetworkMerge<N,Lo,Hi,2*R>::apply(p);
+        NetworkMerge<N,Lo+R,Hi,2*R>::apply(p);
+        NetworkMergeLoop<N,Lo+R,R,Hi>::apply(p);
+      }
+    };
+    template <int N, int Lo, int Hi, int R> struct NetworkMerge<N,Lo,Hi,R,false>
+    {
+      template <class Iterator> static inline void apply(Iterator p) { NetworkComparator<N,Lo,Lo+R>::apply(p); }
+    };
+
+    // Sorts [Lo, Hi].
+    template <int N, int Lo, int Hi, bool bActive = (Lo < Hi && Lo < N - 1)> struct NetworkSort
+    {
+      template <class Iterator> static inline void apply(Iterator p)
+      {
+        NetworkSort<N,Lo,(Lo+Hi)/2>::apply(p);
+        NetworkSort<N,(Lo+Hi)/2+1,Hi>::apply(p);
+        NetworkMerge<N,Lo,Hi,1>::apply(p);
+      }
+    };
+    template <int N, int Lo, int Hi> struct NetworkSort<N,Lo,Hi,false>
+    {
+      template <class Iterator> static inline void apply(Iterator) {}
+    };
+
+    template <int N, int P = 1, bool bLarger = (P >= N)> struct NetworkSize
+    {
+      enum { value = P };
+    };
+    template <int N, int P> struct NetworkSize<N,P,false> : NetworkSize<N,2*P> {};
+  }
+  /// @endhide
 
-    qSwap(data[storePos], data[elements]);
-
-    return storePos;
+  template <int N, class Iterator> inline void networkSort(Iterator data)
+  {
+    Private::NetworkSort<N,0,Private::NetworkSize<N>::value-1>::apply(data);
+  }
 
+  template <int N, class Iterator>
+  inline typename std::iterator_traits<Iterator>::value_type networkMedian(Iterator data)
+  {
+    networkSort<N>(data);
+    return data[(N-1)/2];
   }
 
   // template <class Iterator, class Comparator> void
@@ -945,9 +1175,34 @@ namespace Pii
 #define MEDIAN_ELEM_SWAP(a,b) { tmp=(a);(a)=(b);(b)=tmp; }
 #define MEDIAN_SORT(a,b) { if ((a)>(b)) MEDIAN_ELEM_SWAP((a),(b)); }
 
+#define PII_NETWORK_MEDIAN_CASE(N) case N: return networkMedian<N>(data)
+
   template <class Iterator> typename std::iterator_traits<Iterator>::value_type fastMedian(Iterator data, int len)
   {
     typedef typename std::iterator_traits<Iterator>::value_type T;
+    // Typical filter windows have a fixed, small size.
+    switch (len)
+      {
+      case 1: return data[0];
+      case 3: return median3(data);
+      case 5: return median5(data);
+      case 7: return median7(data);
+      case 9: return median9(data);
+      case 25: return median25(data);
+      PII_NETWORK_MEDIAN_CASE(2);
+      PII_NETWORK_MEDIAN_CASE(4);
+      PII_NETWORK_MEDIAN_CASE(6);
+      PII_NETWORK_MEDIAN_CASE(8);
+      PII_NETWORK_MEDIAN_CASE(10);
+      PII_NETWORK_MEDIAN_CASE(11);
+      PII_NETWORK_MEDIAN_CASE(12);
+      PII_NETWORK_MEDIAN_CASE(13);
+      PII_NETWORK_MEDIAN_CASE(14);
+      PII_NETWORK_MEDIAN_CASE(15);
+      PII_NETWORK_MEDIAN_CASE(16);
+      default: break;
+      }
+
     int low = 0, high = len-1;
     int medianIndex = (low + high) >> 1;
     int middle, ll, hh;
@@ -997,9 +1252,18 @@ namespace Pii
    * This code in public domain.
    */
 
+#undef PII_NETWORK_MEDIAN_CASE
+
   template <class Iterator> typename std::iterator_traits<Iterator>::value_type medianN(Iterator data, int len)
   {
     typedef typename std::iterator_traits<Iterator>::value_type T;
+    if (len <= 25)
+      {
+        T aBuffer[25];
+        for (int i=0; i<len; ++i)
+          aBuffer[i] = data[i];
+        return fastMedian(aBuffer, len);
+      }
     int i, less, greater, equal;
     T min, max, guess, maxltguess, mingtguess;
     min = max = data[0] ;
@@ -1327,12 +1591,19 @@ namespace Pii
 
     avg.initAverageMatrix(signalLength);
 
+    // Cumulative sum of the current signal. The sum over any window
+    // is a difference of two entries, independent of window width.
+    typedef typename Averager::OutputType OutputType;
+    OutputType* pCumulative = new OutputType[avg.signalLength() + 1];
+    pCumulative[0] = 0;
+
     for (int signal=0; signal < avg.signalCount(); ++signal)
       {
         avg.selectSignal(signal);
+        for (int i=0; i<avg.signalLength(); ++i)
+          pCumulative[i+1] = pCumulative[i] + avg.value(i);
         for (int t=0; t<signalLength; ++t)
           {
-            typename Averager::OutputType localAverage(0);
             // Find boundaries of the local averaging window
             int first = t-left, last = t+right;
             if (first < 0)
@@ -1347,9 +1618,7 @@ namespace Pii
                   first += last - avg.signalLength();
                 last = avg.signalLength();
               }
-            // Sum up
-            for (int i=first; i<last; ++i)
-              localAverage += avg.value(i);
+            OutputType localAverage(pCumulative[last] - pCumulative[first]);
             // Divide based on selected mode
             if (endPointHandling == AssumeZeros)
               avg.setAverage(t, localAverage/width);
@@ -1357,6 +1626,7 @@ namespace Pii
               avg.setAverage(t, localAverage/(last-first));
           }
       }
+    delete[] pCumulative;
 
     return avg.averageMatrix();
   }
@@ -23,6 +23,8 @@
 #include "PiiHeap.h"
 #include "PiiMatrixValue.h"
 #include "PiiPreprocessor.h"
+#include "PiiMatrixProduct.h"
+#include "PiiReductions.h"
 
 #include <cstdlib>
 #include <complex>
@@ -947,6 +949,24 @@ namespace Pii
   template <class InputIterator, class OutputIterator>
   void fastMovingAverage(InputIterator input, int n, OutputIterator output, int windowSize);
 
+  /// @hide
+  /* Reductions over dynamic PiiMatrix types are calculated row by
+     row with the vectorized kernels in PiiReductions whenever the
+     result type makes it safe: integer elements are summed exactly
+     and may be converted to any numeric type, but floating-point
+     elements are only summed into floating-point results. Other
+     matrices are accumulated element by element in the result type.
+   */
+  template <class Matrix, class U> struct VectorizedReduction : False {};
+
+  template <class T, class U> struct VectorizedReduction<PiiMatrix<T>, U> :
+    And<ReductionTraits<T>::supported,
+        ReductionTraits<T>::integer ? IsNumeric<U>::boolValue : IsFloatingPoint<U>::boolValue>
+  {};
+
+  template <bool vectorized> struct MatrixReduction;
+  /// @endhide
+
   /**
    * Returns the sum of all entries in a matrix. Returns the value as
    * a (possibly) different type, denoted by the template parameter
@@ -954,9 +974,7 @@ namespace Pii
    */
   template <class T, class Matrix> inline T sum(const Matrix& mat)
   {
-    return Pii::accumulate(mat.begin(), mat.end(),
-                           std::plus<T>(),
-                           T(0));
+    return MatrixReduction<VectorizedReduction<Matrix,T>::boolValue>::template sum<T>(mat);
   }
 
   /**
@@ -1128,6 +1146,13 @@ namespace Pii
    * @param k is ordinal number. ! now k = 0 means smallest, k = 1
    * second smallest etc.
    *
+   * The selection is an introselect: quickselect with
+   * median-of-three pivots, which falls back to median-of-medians
+   * pivots if the partitions get unbalanced. The expected running
+   * time is linear, and the worst case stays linear as well. Runs of
+   * equal values are handled without degenerating. The array will be
+   * reordered.
+   *
    * ~~~(c++)
    * int array[8] = {0,2,3,9,4,5,6,8};
    * int element = Pii::kthSmallest<int>(array, 8, 2);
@@ -1164,6 +1189,29 @@ namespace Pii
 
   template <class T> int partition(T* data, int size, int pivot);
 
+  /**
+   * Sorts *N* elements in place with a sorting network. The network
+   * (Batcher's odd-even merge sort) is generated at compile time, and
+   * each of its comparators is a branchless compare-exchange. For
+   * small arrays of primitive types, this is considerably faster than
+   * any sorting algorithm with data-dependent branches.
+   *
+   * ~~~(c++)
+   * int array[6] = {5,3,4,0,2,1};
+   * Pii::networkSort<6>(array);
+   * // array is now 0,1,2,3,4,5
+   * ~~~
+   */
+  template <int N, class Iterator> inline void networkSort(Iterator data);
+
+  /**
+   * Returns the median of *N* elements using [networkSort()]. If
+   * *N* is even, the lower one of the two middle elements will be
+   * returned. The array will be sorted.
+   */
+  template <int N, class Iterator>
+  inline typename std::iterator_traits<Iterator>::value_type networkMedian(Iterator data);
+
   /**
    * Classical insertion sort. Sorts elements in array (in-place) to
    * ascending order. Complexity class is O(n^2) where, n is number of elements in
@@ -1197,7 +1245,8 @@ namespace Pii
 
   /**
    * Returns the median of all elements in `data`. This function
-   * modifies `data`.
+   * modifies `data`. Arrays of at most 16 elements, and arrays of 25
+   * elements, are handled with sorting networks.
    *
    * @param data a random access iterator to the beginning of the
    * data. Will be modified during calculation.
@@ -1210,7 +1259,8 @@ namespace Pii
   /**
    * Returns the median of all elements in *data*. This function does
    * not modify *data*. It is slower than the intrusive fastMedian(),
-   * but retains data intact.
+   * but retains data intact. At most 25 elements are copied to a
+   * temporary buffer and passed to fastMedian().
    *
    * @param data a random access iterator to the beginning of the
    * data. Will be modified during calculation.
@@ -2382,8 +2432,107 @@ namespace Pii
   }
 }
 
+namespace Pii
+{
+  /// @hide
+  template <class Matrix1, class Matrix2, class T> struct IsBlockedProduct
+  {
+    enum
+      {
+        boolValue = StridedAccess<Matrix1>::supported &&
+                    StridedAccess<Matrix2>::supported &&
+                    IsSame<typename Matrix1::value_type, T>::boolValue &&
+                    IsSame<typename Matrix2::value_type, T>::boolValue &&
+                    (IsSame<T, float>::boolValue || IsSame<T, double>::boolValue)
+      };
+  };
+
+  template <class Matrix1, class Matrix2, class T,
+            bool blocked = IsBlockedProduct<Matrix1, Matrix2, T>::boolValue>
+  struct MatrixProduct;
+
+  // The generic version works with any matrix types through
+  // iterators.
+  template <class Matrix1, class Matrix2, class T>
+  struct MatrixProduct<Matrix1, Matrix2, T, false>
+  {
+    template <class Result>
+    static void multiply(const Matrix1& m1, const Matrix2& m2, Result& result, const PiiParallelPolicy&)
+    {
+      const int iRows1 = m1.rows(), iCols1 = m1.columns(), iCols2 = m2.columns();
+      for (int r=0; r<iRows1; ++r)
+        {
+          T* pRow = result[r];
+          for (int c=0; c<iCols2; ++c)
+            pRow[c] = Pii::innerProductN(m1.rowBegin(r), iCols1, m2.columnBegin(c), T(0));
+        }
+    }
+  };
+
+  template <class Matrix1, class Matrix2, class T>
+  struct MatrixProduct<Matrix1, Matrix2, T, true>
+  {
+    template <class Result>
+    static void multiply(const Matrix1& m1, const Matrix2& m2, Result& result, const PiiParallelPolicy& policy)
+    {
+      MatrixProductArgs<T> args;
+      args.iRows = m1.rows();
+      args.iInner = m1.columns();
+      args.iColumns = m2.columns();
+      // Packing the operands doesn't pay off with small matrices.
+      if (double(args.iRows) * args.iInner * args.iColumns >= 32768 &&
+          StridedAccess<Matrix1>::get(m1, args.pA, args.iARowStride, args.iAColumnStride) &&
+          StridedAccess<Matrix2>::get(m2, args.pB, args.iBRowStride, args.iBColumnStride) &&
+          result.stride() % sizeof(T) == 0)
+        {
+          args.pC = result[0];
+          args.iCRowStride = std::ptrdiff_t(result.stride() / sizeof(T));
+          blockedProduct(args, policy);
+        }
+      else
+        MatrixProduct<Matrix1, Matrix2, T, false>::multiply(m1, m2, result, policy);
+    }
+  };
+  /// @endhide
+
+  /**
+   * Returns the matrix product *mat1* * *mat2*. This function works
+   * like the multiplication operator, but makes it possible to
+   * calculate large products of float and double matrices in
+   * parallel. The rows of the result are divided into strips as
+   * determined by *policy*.
+   *
+   * ~~~(c++)
+   * PiiMatrix<double> matA(4000, 4000), matB(4000, 4000);
+   * PiiMatrix<double> matC = Pii::matrixProduct(Pii::transpose(matA), matB,
+   *                                             PiiParallelPolicy());
+   * ~~~
+   *
+   * @exception PiiMathException& if matrix sizes don't match
+   */
+  template <class Matrix1, class Matrix2>
+  PiiMatrix<PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::value_type),
+            Matrix1::staticRows, Matrix2::staticColumns>
+  matrixProduct(const PiiConceptualMatrix<Matrix1>& mat1,
+                const PiiConceptualMatrix<Matrix2>& mat2,
+                const PiiParallelPolicy& policy)
+  {
+    const Matrix1& m1 = mat1.selfRef();
+    const Matrix2& m2 = mat2.selfRef();
+    if (m1.columns() != m2.rows())
+      PII_MATRIX_SIZE_MISMATCH;
+
+    typedef PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::value_type) T;
+    PiiMatrix<T, Matrix1::staticRows, Matrix2::staticColumns> result(PiiMatrix<T>::uninitialized(m1.rows(), m2.columns()));
+    MatrixProduct<Matrix1, Matrix2, T>::multiply(m1, m2, result, policy);
+    return result;
+  }
+}
+
 /**
- * Matrix multiplication. Returns *mat1* * *mat2*.
+ * Matrix multiplication. Returns *mat1* * *mat2*. Large products of
+ * float and double matrices are calculated with a cache-blocked,
+ * vectorized algorithm (see Pii::blockedProduct()).
  *
  * @exception PiiMathException& if matrix sizes don't match
  */
@@ -2393,22 +2542,7 @@ PiiMatrix<PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::valu
 operator* (const PiiConceptualMatrix<Matrix1>& mat1,
            const PiiConceptualMatrix<Matrix2>& mat2)
 {
-  const Matrix1& m1 = mat1.selfRef();
-  const Matrix2& m2 = mat2.selfRef();
-  const int iCols1 = m1.columns();
-  if (iCols1 != m2.rows())
-    PII_MATRIX_SIZE_MISMATCH;
-  const int iRows1 = m1.rows(), iCols2 = m2.columns();
-
-  typedef PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::value_type) T;
-  PiiMatrix<T, Matrix1::staticRows, Matrix2::staticColumns> result(PiiMatrix<T>::uninitialized(iRows1, iCols2));
-  for (int r=0; r<iRows1; ++r)
-    {
-      T* pRow = result[r];
-      for (int c=0; c<iCols2; ++c)
-        pRow[c] = Pii::innerProductN(m1.rowBegin(r), iCols1, m2.columnBegin(c), T(0));
-    }
-  return result;
+  return Pii::matrixProduct(mat1, mat2, PiiParallelPolicy::sequential());
 }
 
 template <class T, class Matrix>
@@ -2442,8 +2576,8 @@ template <class T> inline PiiMatrix<T>& operator/= (PiiMatrix<T>& mat1, const Pi
 }
 
 
-#include "PiiMath-templates.h"
 #include "PiiMathFunctional.h"
+#include "PiiMath-templates.h"
 
 /// @hide
 #define PII_MATH_MATRIX_TRANSFORM(FUNCTION, CLASS) \
@@ -2740,17 +2874,15 @@ namespace Pii
    * denote the elements of `mat` and N is the total number of
    * entries.
    *
-   * ! Sum is not calculated with double but with the datatype
-   * given by the absolute value functor, which in most cases is
-   * the same as the matrix element type. Possible overflow
-   * issue.
+   * ! Except for dynamic matrices of unsigned char, short, unsigned
+   * short, float and double, the sum is not calculated with double
+   * but with the datatype given by the absolute value functor, which
+   * in most cases is the same as the matrix element type. Possible
+   * overflow issue.
    */
   template <class Matrix> inline double norm1(const Matrix& mat)
   {
-    typedef typename Matrix::value_type T;
-    return forEach(mat.begin(), mat.end(),
-                   createForEachFunction(Abs<T>(), std::plus<typename Abs<T>::result_type>(), 0))();
-    //return sum<T>(abs(mat));
+    return MatrixReduction<VectorizedReduction<Matrix,double>::boolValue>::norm1(mat);
   }
 
   /// @internal
@@ -2769,9 +2901,7 @@ namespace Pii
   {
     static double calculate(const Matrix& matrix)
     {
-      return sqrt(forEach(matrix.begin(), matrix.end(),
-                          createForEachFunction(Square<typename Matrix::value_type>(),
-                                                std::plus<double>(), 0))());
+      return sqrt(MatrixReduction<VectorizedReduction<Matrix,double>::boolValue>::sumOfSquares(matrix));
     }
   };
 
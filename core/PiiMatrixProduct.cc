@@ -0,0 +1,397 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMatrixProduct.h"
+
+#include "PiiCpuDispatcher.h"
+#include <cstring>
+#include <vector>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_PRODUCT_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_PRODUCT_AVX 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_PRODUCT_NEON 1
+#endif
+
+namespace Pii
+{
+  namespace
+  {
+    MatrixProductHook<float>::Type pFloatHook = 0;
+    MatrixProductHook<double>::Type pDoubleHook = 0;
+
+    bool callHook(const MatrixProductArgs<float>& args) { return pFloatHook != 0 && pFloatHook(args); }
+    bool callHook(const MatrixProductArgs<double>& args) { return pDoubleHook != 0 && pDoubleHook(args); }
+
+    /* Blocking parameters. A KC x NC panel of B is shared by all
+       rows of a strip and stays in the outer cache levels. An MC x KC
+       panel of A is reused for every NR columns of B and should fit
+       into L2. The micro-kernel keeps an MR x NR tile of C in
+       registers.
+     */
+    enum { MR = 4, MC = 128, KC = 256, NC = 1024 };
+
+    template <class U> struct ScalarOps
+    {
+      typedef U T;
+      typedef U Vec;
+      enum { Width = 1 };
+
+      static inline Vec zero() { return U(0); }
+      static inline Vec set1(U value) { return value; }
+      static inline Vec load(const U* data) { return *data; }
+      static inline Vec add(Vec a, Vec b) { return a + b; }
+      static inline Vec mul(Vec a, Vec b) { return a * b; }
+      static inline void store(U* data, Vec value) { *data = value; }
+    };
+  }
+
+  /* The blocked product is compiled separately for each instruction
+     set, in the same way as the linear filters in PiiImage. Both
+     operands are copied into panels in the order the micro-kernel
+     reads them: A in groups of MR rows, B in groups of NR columns.
+     Panels are padded with zeros, which makes it possible to always
+     compute full tiles. Only the valid part of a tile is added to C.
+     The strides of the source matrices are arbitrary, which makes
+     transposed operands as fast as normal ones once packed.
+   */
+#define PII_PRODUCT_STRIP(TARGET)                                       \
+  template <class Ops> TARGET                                           \
+  void multiplyStrip(const MatrixProductArgs<typename Ops::T>& args,    \
+                     int firstRow, int endRow)                          \
+  {                                                                     \
+    typedef typename Ops::T T;                                          \
+    typedef typename Ops::Vec Vec;                                      \
+    const int iWidth = Ops::Width, NR = 2 * Ops::Width;                 \
+    const int iRows = endRow - firstRow;                                \
+                                                                        \
+    for (int r=firstRow; r<endRow; ++r)                                 \
+      std::memset(args.pC + r*args.iCRowStride, 0, sizeof(T) * args.iColumns); \
+    if (args.iInner == 0 || args.iColumns == 0 || iRows <= 0)           \
+      return;                                                           \
+                                                                        \
+    const int iMaxKc = qMin(int(KC), args.iInner);                      \
+    const int iMaxMc = qMin(int(MC), (iRows + MR - 1) / MR * MR);       \
+    const int iMaxNc = qMin(int(NC), (args.iColumns + NR - 1) / NR * NR); \
+    std::vector<T> vecA(iMaxMc * iMaxKc), vecB(iMaxNc * iMaxKc);        \
+    T aTile[MR * 2 * Ops::Width];                                       \
+                                                                        \
+    for (int jc=0; jc<args.iColumns; jc+=NC)                            \
+      {                                                                 \
+        const int nc = qMin(int(NC), args.iColumns - jc);               \
+        for (int pc=0; pc<args.iInner; pc+=KC)                          \
+          {                                                             \
+            const int kc = qMin(int(KC), args.iInner - pc);             \
+            /* Pack B[pc:pc+kc, jc:jc+nc] */                            \
+            T* pPacked = &vecB[0];                                      \
+            for (int j=0; j<nc; j+=NR)                                  \
+              {                                                         \
+                const int iValid = qMin(NR, nc - j);                    \
+                for (int k=0; k<kc; ++k, pPacked += NR)                 \
+                  {                                                     \
+                    const T* pSource = args.pB + (pc+k)*args.iBRowStride + \
+                      (jc+j)*args.iBColumnStride;                       \
+                    int jj = 0;                                         \
+                    for (; jj<iValid; ++jj)                             \
+                      pPacked[jj] = pSource[jj*args.iBColumnStride];    \
+                    for (; jj<NR; ++jj)                                 \
+                      pPacked[jj] = T(0);                               \
+                  }                                                     \
+              }                                                         \
+                                                                        \
+            for (int ic=firstRow; ic<endRow; ic+=MC)                    \
+              {                                                         \
+                const int mc = qMin(int(MC), endRow - ic);              \
+                /* Pack A[ic:ic+mc, pc:pc+kc] */                        \
+                pPacked = &vecA[0];                                     \
+                for (int i=0; i<mc; i+=MR, pPacked += MR*kc)            \
+                  for (int ii=0; ii<MR; ++ii)                           \
+                    {                                                   \
+                      if (i+ii < mc)                                    \
+                        {                                               \
+                          const T* pSource = args.pA + (ic+i+ii)*args.iARowStride + \
+                            pc*args.iAColumnStride;                     \
+                          for (int k=0; k<kc; ++k)                      \
+                            pPacked[k*MR + ii] = pSource[k*args.iAColumnStride]; \
+                        }                                               \
+                      else                                              \
+                        for (int k=0; k<kc; ++k)                        \
+                          pPacked[k*MR + ii] = T(0);                    \
+                    }                                                   \
+                                                                        \
+                for (int jr=0; jr<nc; jr+=NR)                           \
+                  {                                                     \
+                    const int iCols = qMin(NR, nc - jr);                \
+                    for (int ir=0; ir<mc; ir+=MR)                       \
+                      {                                                 \
+                        const T* pA = &vecA[ir*kc];                     \
+                        const T* pB = &vecB[jr*kc];                     \
+                        Vec c00 = Ops::zero(), c01 = Ops::zero(),       \
+                          c10 = Ops::zero(), c11 = Ops::zero(),         \
+                          c20 = Ops::zero(), c21 = Ops::zero(),         \
+                          c30 = Ops::zero(), c31 = Ops::zero();         \
+                        for (int k=0; k<kc; ++k, pA += MR, pB += NR)    \
+                          {                                             \
+                            const Vec b0 = Ops::load(pB), b1 = Ops::load(pB + iWidth); \
+                            Vec a = Ops::set1(pA[0]);                   \
+                            c00 = Ops::add(c00, Ops::mul(a, b0));       \
+                            c01 = Ops::add(c01, Ops::mul(a, b1));       \
+                            a = Ops::set1(pA[1]);                       \
+                            c10 = Ops::add(c10, Ops::mul(a, b0));       \
+                            c11 = Ops::add(c11, Ops::mul(a, b1));       \
+                            a = Ops::set1(pA[2]);                       \
+                            c20 = Ops::add(c20, Ops::mul(a, b0));       \
+                            c21 = Ops::add(c21, Ops::mul(a, b1));       \
+                            a = Ops::set1(pA[3]);                       \
+                            c30 = Ops::add(c30, Ops::mul(a, b0));       \
+                            c31 = Ops::add(c31, Ops::mul(a, b1));       \
+                          }                                             \
+                        Ops::store(aTile, c00);                         \
+                        Ops::store(aTile + iWidth, c01);                \
+                        Ops::store(aTile + NR, c10);                    \
+                        Ops::store(aTile + NR + iWidth, c11);           \
+                        Ops::store(aTile + 2*NR, c20);                  \
+                        Ops::store(aTile + 2*NR + iWidth, c21);         \
+                        Ops::store(aTile + 3*NR, c30);                  \
+                        Ops::store(aTile + 3*NR + iWidth, c31);         \
+                        const int iTileRows = qMin(int(MR), mc - ir);   \
+                        for (int i=0; i<iTileRows; ++i)                 \
+                          {                                             \
+                            T* pTarget = args.pC + (ic+ir+i)*args.iCRowStride + jc + jr; \
+                            for (int j=0; j<iCols; ++j)                 \
+                              pTarget[j] += aTile[i*NR + j];            \
+                          }                                             \
+                      }                                                 \
+                  }                                                     \
+              }                                                         \
+          }                                                             \
+      }                                                                 \
+  }
+
+  namespace Scalar
+  {
+    PII_PRODUCT_STRIP()
+  }
+
+#ifdef PII_PRODUCT_SSE2
+  namespace Sse2
+  {
+    template <class T> struct Ops;
+
+    template <> struct Ops<float>
+    {
+      typedef float T;
+      typedef __m128 Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return _mm_setzero_ps(); }
+      static inline Vec set1(float value) { return _mm_set1_ps(value); }
+      static inline Vec load(const float* data) { return _mm_loadu_ps(data); }
+      static inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+      static inline void store(float* data, Vec value) { _mm_storeu_ps(data, value); }
+    };
+
+    template <> struct Ops<double>
+    {
+      typedef double T;
+      typedef __m128d Vec;
+      enum { Width = 2 };
+
+      static inline Vec zero() { return _mm_setzero_pd(); }
+      static inline Vec set1(double value) { return _mm_set1_pd(value); }
+      static inline Vec load(const double* data) { return _mm_loadu_pd(data); }
+      static inline Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+      static inline void store(double* data, Vec value) { _mm_storeu_pd(data, value); }
+    };
+
+    PII_PRODUCT_STRIP()
+  }
+#endif
+
+#ifdef PII_PRODUCT_AVX
+  namespace Avx
+  {
+    template <class T> struct Ops;
+
+#  define PII_AVX PII_TARGET("avx")
+
+    template <> struct Ops<float>
+    {
+      typedef float T;
+      typedef __m256 Vec;
+      enum { Width = 8 };
+
+      PII_AVX static inline Vec zero() { return _mm256_setzero_ps(); }
+      PII_AVX static inline Vec set1(float value) { return _mm256_set1_ps(value); }
+      PII_AVX static inline Vec load(const float* data) { return _mm256_loadu_ps(data); }
+      PII_AVX static inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+      PII_AVX static inline Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+      PII_AVX static inline void store(float* data, Vec value) { _mm256_storeu_ps(data, value); }
+    };
+
+    template <> struct Ops<double>
+    {
+      typedef double T;
+      typedef __m256d Vec;
+      enum { Width = 4 };
+
+      PII_AVX static inline Vec zero() { return _mm256_setzero_pd(); }
+      PII_AVX static inline Vec set1(double value) { return _mm256_set1_pd(value); }
+      PII_AVX static inline Vec load(const double* data) { return _mm256_loadu_pd(data); }
+      PII_AVX static inline Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+      PII_AVX static inline Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+      PII_AVX static inline void store(double* data, Vec value) { _mm256_storeu_pd(data, value); }
+    };
+
+    PII_PRODUCT_STRIP(PII_AVX)
+
+#  undef PII_AVX
+  }
+#endif
+
+#ifdef PII_PRODUCT_NEON
+  namespace Neon
+  {
+    template <class T> struct Ops;
+
+    template <> struct Ops<float>
+    {
+      typedef float T;
+      typedef float32x4_t Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return vdupq_n_f32(0); }
+      static inline Vec set1(float value) { return vdupq_n_f32(value); }
+      static inline Vec load(const float* data) { return vld1q_f32(data); }
+      static inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+      static inline void store(float* data, Vec value) { vst1q_f32(data, value); }
+    };
+
+#  ifdef __aarch64__
+    template <> struct Ops<double>
+    {
+      typedef double T;
+      typedef float64x2_t Vec;
+      enum { Width = 2 };
+
+      static inline Vec zero() { return vdupq_n_f64(0); }
+      static inline Vec set1(double value) { return vdupq_n_f64(value); }
+      static inline Vec load(const double* data) { return vld1q_f64(data); }
+      static inline Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+      static inline void store(double* data, Vec value) { vst1q_f64(data, value); }
+    };
+#  endif
+
+    PII_PRODUCT_STRIP()
+  }
+#endif
+
+#undef PII_PRODUCT_STRIP
+
+  namespace
+  {
+    template <class T> struct StripKernel
+    {
+      typedef void (*Type)(const MatrixProductArgs<T>&, int, int);
+    };
+
+    StripKernel<float>::Type selectKernel(float*)
+    {
+      static const PiiCpuDispatcher<StripKernel<float>::Type> dispatcher =
+        PiiCpuDispatcher<StripKernel<float>::Type>(Scalar::multiplyStrip<ScalarOps<float> >)
+#if defined(PII_PRODUCT_AVX)
+        .add(CpuAvx2, Avx::multiplyStrip<Avx::Ops<float> >)
+#endif
+#if defined(PII_PRODUCT_SSE2)
+        .add(CpuSse2, Sse2::multiplyStrip<Sse2::Ops<float> >)
+#elif defined(PII_PRODUCT_NEON)
+        .add(CpuNeon, Neon::multiplyStrip<Neon::Ops<float> >)
+#endif
+        ;
+      return dispatcher.function();
+    }
+
+    StripKernel<double>::Type selectKernel(double*)
+    {
+      static const PiiCpuDispatcher<StripKernel<double>::Type> dispatcher =
+        PiiCpuDispatcher<StripKernel<double>::Type>(Scalar::multiplyStrip<ScalarOps<double> >)
+#if defined(PII_PRODUCT_AVX)
+        .add(CpuAvx2, Avx::multiplyStrip<Avx::Ops<double> >)
+#endif
+#if defined(PII_PRODUCT_SSE2)
+        .add(CpuSse2, Sse2::multiplyStrip<Sse2::Ops<double> >)
+#elif defined(PII_PRODUCT_NEON) && defined(__aarch64__)
+        .add(CpuNeon, Neon::multiplyStrip<Neon::Ops<double> >)
+#endif
+        ;
+      return dispatcher.function();
+    }
+
+    template <class T> class ProductStrips
+    {
+    public:
+      ProductStrips(const MatrixProductArgs<T>& args) :
+        _args(args),
+        _pKernel(selectKernel((T*)0))
+      {}
+
+      void operator() (int firstRow, int endRow)
+      {
+        _pKernel(_args, firstRow, endRow);
+      }
+
+    private:
+      const MatrixProductArgs<T>& _args;
+      typename StripKernel<T>::Type _pKernel;
+    };
+
+    template <class T> void multiplyBlocked(const MatrixProductArgs<T>& args, const PiiParallelPolicy& policy)
+    {
+      if (callHook(args))
+        return;
+      ProductStrips<T> strips(args);
+      forEachStrip(args.iRows, strips, policy);
+    }
+  }
+
+  void blockedProduct(const MatrixProductArgs<float>& args, const PiiParallelPolicy& policy)
+  {
+    multiplyBlocked(args, policy);
+  }
+
+  void blockedProduct(const MatrixProductArgs<double>& args, const PiiParallelPolicy& policy)
+  {
+    multiplyBlocked(args, policy);
+  }
+
+  void setMatrixProductHook(MatrixProductHook<float>::Type hook)
+  {
+    pFloatHook = hook;
+  }
+
+  void setMatrixProductHook(MatrixProductHook<double>::Type hook)
+  {
+    pDoubleHook = hook;
+  }
+}
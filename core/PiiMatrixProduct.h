@@ -0,0 +1,133 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMATRIXPRODUCT_H
+#define _PIIMATRIXPRODUCT_H
+
+#include "PiiMatrix.h"
+#include "PiiParallel.h"
+#include "PiiTypeTraits.h"
+
+#include <cstddef>
+
+namespace Pii
+{
+  /**
+   * The operands of a matrix product *C* = *A* *B*, where *A* is a
+   * *rows* x *inner* matrix, *B* is an *inner* x *columns* matrix,
+   * and *C* is a *rows* x *columns* matrix. Element (*r*, *c*) of *A*
+   * is at `pA[r*iARowStride + c*iAColumnStride]`, and similarly for
+   * *B* and *C*. Strides are given in elements, not bytes. A
+   * transposed operand is described by exchanging its strides.
+   */
+  template <class T> struct MatrixProductArgs
+  {
+    int iRows, iInner, iColumns;
+    const T* pA;
+    std::ptrdiff_t iARowStride, iAColumnStride;
+    const T* pB;
+    std::ptrdiff_t iBRowStride, iBColumnStride;
+    T* pC;
+    std::ptrdiff_t iCRowStride;
+  };
+
+  /**
+   * Calculates the matrix product described by *args* using a
+   * cache-blocked algorithm. Both operands are copied to small
+   * contiguous panels that fit into the processor's caches, and the
+   * panels are multiplied with SIMD instructions if the CPU supports
+   * them (see [cpuFeatures()]). *C* must not overlap with *A* or
+   * *B*. The rows of *C* are divided into strips as determined by
+   * *policy*.
+   *
+   * If a matrix product hook has been installed with
+   * [setMatrixProductHook()], it will be tried first.
+   *
+   * This function is usually not called directly. The matrix
+   * multiplication operator uses it for float and double matrices
+   * whose elements can be accessed directly.
+   */
+  PII_CORE_EXPORT void blockedProduct(const MatrixProductArgs<float>& args,
+                                      const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+  PII_CORE_EXPORT void blockedProduct(const MatrixProductArgs<double>& args,
+                                      const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
+  /**
+   * A function that calculates a matrix product, for example by
+   * calling an external BLAS library. The function returns `true` if
+   * it calculated the product and `false` if the built-in algorithm
+   * should be used instead.
+   *
+   * ~~~(c++)
+   * bool cblasProduct(const Pii::MatrixProductArgs<double>& args)
+   * {
+   *   // cblas_dgemm needs one unit stride in each operand.
+   *   if (args.iAColumnStride != 1 || args.iBColumnStride != 1)
+   *     return false;
+   *   cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+   *               args.iRows, args.iColumns, args.iInner,
+   *               1.0, args.pA, args.iARowStride, args.pB, args.iBRowStride,
+   *               0.0, args.pC, args.iCRowStride);
+   *   return true;
+   * }
+   *
+   * Pii::setMatrixProductHook(cblasProduct);
+   * ~~~
+   */
+  template <class T> struct MatrixProductHook
+  {
+    typedef bool (*Type)(const MatrixProductArgs<T>&);
+  };
+
+  /**
+   * Installs a *hook* that will be tried before the built-in matrix
+   * multiplication algorithm for float matrices. Pass zero to remove
+   * the hook. The hook must be thread-safe.
+   */
+  PII_CORE_EXPORT void setMatrixProductHook(MatrixProductHook<float>::Type hook);
+  /**
+   * Installs a *hook* for double matrices.
+   */
+  PII_CORE_EXPORT void setMatrixProductHook(MatrixProductHook<double>::Type hook);
+
+  /// @hide
+  /* Direct access to the elements of a matrix. Specializations set
+     supported to true and fill in the pointer to the first element
+     and the distance between adjacent rows and columns in elements.
+   */
+  template <class Matrix> struct StridedAccess
+  {
+    enum { supported = false };
+  };
+
+  template <class T> struct StridedAccess<PiiMatrix<T> >
+  {
+    enum { supported = true };
+    static bool get(const PiiMatrix<T>& mat, const T*& data,
+                    std::ptrdiff_t& rowStride, std::ptrdiff_t& columnStride)
+    {
+      if (mat.rows() == 0 || mat.stride() % sizeof(T) != 0)
+        return false;
+      data = mat[0];
+      rowStride = std::ptrdiff_t(mat.stride() / sizeof(T));
+      columnStride = 1;
+      return true;
+    }
+  };
+
+  /// @endhide
+}
+
+#endif //_PIIMATRIXPRODUCT_H
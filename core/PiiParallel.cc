@@ -0,0 +1,185 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiParallel.h"
+#include "PiiException.h"
+
+#ifndef PII_NO_QT
+#  include "PiiSynchronized.h"
+#  include <QCoreApplication>
+#  include <QThread>
+#  include <QThreadPool>
+#  include <QRunnable>
+#  include <QMutex>
+#  include <QWaitCondition>
+#endif
+
+int PiiParallelPolicy::stripCount(int rows) const
+{
+  int iThreads = _iThreadCount;
+  if (iThreads <= 0)
+    {
+#ifdef PII_NO_QT
+      iThreads = 1;
+#else
+      iThreads = QThread::idealThreadCount();
+#endif
+    }
+  return qBound(1, rows / _iMinStripRows, qMax(1, iThreads));
+}
+
+namespace Pii
+{
+  StripFunction::~StripFunction() {}
+
+#ifndef PII_NO_QT
+  namespace
+  {
+    /* Shared by the calling thread and the helper tasks. Strips are
+       claimed from a counter, so the caller never waits for a helper
+       that hasn't started yet. This makes it safe to call
+       forEachStrip() recursively from the global thread pool. The
+       last one to release the job deletes it. A helper may start
+       after all strips are done and must still find the job alive.
+     */
+    struct StripJob
+    {
+      StripJob(int rows, int stripCount, StripFunction* function, int refCount) :
+        iRows(rows),
+        iStripCount(stripCount),
+        iNextStrip(0),
+        iFinishedStrips(0),
+        iRefCount(refCount),
+        pFunction(function),
+        bFailed(false)
+      {}
+
+      // Returns true if the job is finished.
+      bool processStrip()
+      {
+        int iStrip;
+        synchronized (mutex)
+          {
+            if (iNextStrip >= iStripCount)
+              return true;
+            iStrip = iNextStrip++;
+          }
+
+        const int iFirstRow = int(qint64(iRows) * iStrip / iStripCount),
+          iEndRow = int(qint64(iRows) * (iStrip+1) / iStripCount);
+        try
+          {
+            (*pFunction)(iFirstRow, iEndRow);
+          }
+        catch (PiiException& ex)
+          {
+            setError(ex);
+          }
+        catch (...)
+          {
+            setError(PiiException(QCoreApplication::translate("Pii", "Unknown exception in a parallel strip.")));
+          }
+
+        synchronized (mutex)
+          {
+            if (++iFinishedStrips == iStripCount)
+              finishedCondition.wakeAll();
+          }
+        return false;
+      }
+
+      void setError(const PiiException& ex)
+      {
+        synchronized (mutex)
+          {
+            if (!bFailed)
+              {
+                bFailed = true;
+                exception = ex;
+              }
+          }
+      }
+
+      void release()
+      {
+        mutex.lock();
+        bool bLast = --iRefCount == 0;
+        mutex.unlock();
+        if (bLast)
+          delete this;
+      }
+
+      const int iRows, iStripCount;
+      int iNextStrip, iFinishedStrips, iRefCount;
+      StripFunction* pFunction;
+      bool bFailed;
+      PiiException exception;
+      QMutex mutex;
+      QWaitCondition finishedCondition;
+    };
+
+    class StripTask : public QRunnable
+    {
+    public:
+      StripTask(StripJob* job) : _pJob(job) {}
+      ~StripTask() { _pJob->release(); }
+
+      void run()
+      {
+        while (!_pJob->processStrip()) ;
+      }
+
+    private:
+      StripJob* _pJob;
+    };
+  }
+#endif
+
+  void runStrips(int rows, StripFunction& function, const PiiParallelPolicy& policy)
+  {
+    if (rows <= 0)
+      return;
+    const int iStripCount = policy.stripCount(rows);
+#ifndef PII_NO_QT
+    if (iStripCount > 1)
+      {
+        const int iHelpers = iStripCount - 1;
+        StripJob* pJob = new StripJob(rows, iStripCount, &function, iHelpers + 1);
+        QThreadPool* pPool = QThreadPool::globalInstance();
+        for (int i=0; i<iHelpers; ++i)
+          pPool->start(new StripTask(pJob));
+
+        while (!pJob->processStrip()) ;
+
+        pJob->mutex.lock();
+        while (pJob->iFinishedStrips < iStripCount)
+          pJob->finishedCondition.wait(&pJob->mutex);
+        const bool bFailed = pJob->bFailed;
+        PiiException exception(pJob->exception);
+        pJob->mutex.unlock();
+        pJob->release();
+
+        if (bFailed)
+          throw exception;
+        return;
+      }
+#endif
+    // Without threads, strips are processed one by one. This is still
+    // useful for testing functions that are given a thread count
+    // explicitly.
+    for (int i=0; i<iStripCount; ++i)
+      function(int(qint64(rows) * i / iStripCount), int(qint64(rows) * (i+1) / iStripCount));
+  }
+}
@@ -0,0 +1,149 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPARALLEL_H
+#define _PIIPARALLEL_H
+
+#include "PiiGlobal.h"
+
+/**
+ * An execution policy for functions that process large matrices.
+ * Functions that accept a policy divide their output into horizontal
+ * strips and process the strips concurrently. Strips are processed
+ * in the global thread pool (QThreadPool::globalInstance()) and the
+ * calling thread. If Qt is disabled, all strips are processed in the
+ * calling thread.
+ *
+ * ~~~(c++)
+ * // Use all cores
+ * PiiMatrix<int> matFiltered = PiiImage::filter<int>(image, filter,
+ *                                                    Pii::ExtendReplicate,
+ *                                                    PiiParallelPolicy());
+ * // Use at most four threads, at least 128 rows per strip
+ * PiiMatrix<uchar> matBinary = PiiImage::threshold(image,
+ *                                                  PiiImage::ThresholdFunction<uchar>(),
+ *                                                  uchar(128),
+ *                                                  PiiParallelPolicy(4, 128));
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiParallelPolicy
+{
+public:
+  /**
+   * Creates a new execution policy.
+   *
+   * @param threadCount the maximum number of threads used to process
+   * one matrix, including the calling thread. Zero means
+   * QThread::idealThreadCount().
+   *
+   * @param minStripRows the minimum number of rows in a strip. Small
+   * matrices are not split because the overhead of synchronization
+   * would outweigh the gains.
+   */
+  PiiParallelPolicy(int threadCount = 0, int minStripRows = 32) :
+    _iThreadCount(threadCount),
+    _iMinStripRows(qMax(1, minStripRows))
+  {}
+
+  /**
+   * Returns a policy that processes everything in the calling
+   * thread.
+   */
+  static PiiParallelPolicy sequential() { return PiiParallelPolicy(1); }
+
+  int threadCount() const { return _iThreadCount; }
+  int minStripRows() const { return _iMinStripRows; }
+
+  /**
+   * Returns the number of strips a matrix with *rows* rows will be
+   * divided into.
+   */
+  int stripCount(int rows) const;
+
+private:
+  int _iThreadCount;
+  int _iMinStripRows;
+};
+
+namespace Pii
+{
+  /**
+   * An interface for functions that process a range of rows. Used by
+   * [forEachStrip()].
+   */
+  class PII_CORE_EXPORT StripFunction
+  {
+  public:
+    virtual ~StripFunction();
+    /**
+     * Processes rows [*firstRow*, *endRow*). Exceptions thrown by
+     * this function are passed to the caller of [forEachStrip()].
+     */
+    virtual void operator() (int firstRow, int endRow) = 0;
+  };
+
+  /// @hide
+  template <class Function> class StripFunctionAdapter : public StripFunction
+  {
+  public:
+    StripFunctionAdapter(Function& function) : _function(function) {}
+    void operator() (int firstRow, int endRow) { _function(firstRow, endRow); }
+  private:
+    Function& _function;
+  };
+
+  PII_CORE_EXPORT void runStrips(int rows, StripFunction& function, const PiiParallelPolicy& policy);
+  /// @endhide
+
+  /**
+   * Divides *rows* into strips as determined by *policy* and calls
+   * *function* concurrently for each of them. The function receives
+   * the first row of a strip and the row just past its end. This
+   * function returns once all strips have been processed. If any of
+   * the strips throws a PiiException, the first such exception will
+   * be rethrown in the calling thread.
+   *
+   * The function object is shared by all threads. The strips are
+   * disjoint, but the function must otherwise be thread-safe. Any
+   * neighborhood, such as the border needed by a filter, must be
+   * read from the input. The output of another strip may not be
+   * complete yet.
+   *
+   * ~~~(c++)
+   * struct Invert
+   * {
+   *   Invert(PiiMatrix<uchar>& image) : image(image) {}
+   *   void operator() (int firstRow, int endRow)
+   *   {
+   *     for (int r=firstRow; r<endRow; ++r)
+   *       for (int c=0; c<image.columns(); ++c)
+   *         image(r,c) = 255 - image(r,c);
+   *   }
+   *   PiiMatrix<uchar>& image;
+   * };
+   *
+   * Invert invert(image);
+   * Pii::forEachStrip(image.rows(), invert, PiiParallelPolicy());
+   * ~~~
+   */
+  template <class Function>
+  void forEachStrip(int rows, Function& function, const PiiParallelPolicy& policy)
+  {
+    StripFunctionAdapter<Function> adapter(function);
+    runStrips(rows, adapter, policy);
+  }
+}
+
+#endif //_PIIPARALLEL_H
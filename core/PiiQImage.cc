@@ -23,6 +23,11 @@
 
 int iQImagePtrTypeId = qRegisterMetaType<QImagePtr>("QImagePtr");
 
+void PiiQImageLease::returnBuffer()
+{
+  // The image is released when the lease is deleted.
+}
+
 // Taken from src/gui/image/qimage.cpp
 struct PrivateQImageData
 {
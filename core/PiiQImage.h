@@ -19,6 +19,7 @@
 #include "PiiMatrix.h"
 #include "PiiColorTable.h"
 #include "PiiSharedPtr.h"
+#include "PiiBufferLease.h"
 #include <QMetaType>
 #include <QImage>
 
@@ -85,6 +86,36 @@ namespace Pii
    * copy of matrix' data.
    */
   template <class T> QImage matrixToQImage(const PiiMatrix<T>& matrix);
+
+  /**
+   * Returns a QImage that shares data with *matrix* without copying.
+   * The image holds a reference to the matrix data, so either one
+   * can be destroyed first. The image is read-only: modifying it
+   * detaches it from the matrix, and *matrix* is never changed
+   * through the image.
+   *
+   * Sharing is possible if the pixel layout of `T` matches a QImage
+   * format and the rows of *matrix* are aligned to four bytes:
+   *
+   * - `unsigned char` - `Format_Grayscale8` (Qt 5.5)
+   * - `unsigned short` - `Format_Grayscale16` (Qt 5.13)
+   * - `PiiColor<unsigned char>` - `Format_BGR888` (Qt 5.14)
+   * - `PiiColor4<unsigned char>` - `Format_RGB32`
+   *
+   * Otherwise, the result is the same as that of [matrixToQImage()].
+   */
+  template <class T> QImage matrixToSharedQImage(const PiiMatrix<T>& matrix);
+
+  /**
+   * Returns a matrix that shares data with *image* without copying.
+   * The matrix holds a reference to the image data. It is immutable:
+   * the first non-const access makes a private copy, and *image* is
+   * never changed through the matrix. If the format of *image* does
+   * not match `T` (see [matrixToSharedQImage()]), the image will be
+   * converted first. If `T` has no matching QImage format, returns
+   * an empty matrix.
+   */
+  template <class T> PiiMatrix<T> qImageToSharedMatrix(const QImage& image);
 }
 
 /**
@@ -95,6 +126,11 @@ namespace Pii
  * class; if you construct a PiiQImage with a QImage, the
  * QImage will be hacked to believe it doesn't own its data any more.
  *
+ * ! If you just need to move images between PiiMatrix and QImage,
+ * prefer Pii::matrixToSharedQImage() and Pii::qImageToSharedMatrix().
+ * They share the data with reference counting and don't need to
+ * hack QImage.
+ *
  * PiiQImage breaks many usual programming paradigms, and can be
  * considered an ugly, dangerous hack. But it saves a lot of memory
  * and processing time by making conversions between PiiMatrix and
@@ -317,6 +353,59 @@ template <> struct PiiQImageTraits<float>
   }
 };
 
+/// @hide
+// The QImage format whose memory layout equals that of PiiMatrix<T>.
+template <class T> struct PiiSharedQImageTraits
+{
+  enum { Format = QImage::Format_Invalid };
+  static bool isCompatible(const QImage&) { return false; }
+};
+#if QT_VERSION >= 0x050500
+template <> struct PiiSharedQImageTraits<uchar>
+{
+  enum { Format = QImage::Format_Grayscale8 };
+  static bool isCompatible(const QImage& image)
+  {
+    return image.format() == QImage::Format_Grayscale8 ||
+      (image.format() == QImage::Format_Indexed8 && image.colorTable() == Pii::grayColorTable());
+  }
+};
+#endif
+#if QT_VERSION >= 0x050d00
+template <> struct PiiSharedQImageTraits<ushort>
+{
+  enum { Format = QImage::Format_Grayscale16 };
+  static bool isCompatible(const QImage& image) { return image.format() == QImage::Format_Grayscale16; }
+};
+#endif
+#if QT_VERSION >= 0x050e00
+template <> struct PiiSharedQImageTraits<PiiColor<uchar> >
+{
+  enum { Format = QImage::Format_BGR888 };
+  static bool isCompatible(const QImage& image) { return image.format() == QImage::Format_BGR888; }
+};
+#endif
+template <> struct PiiSharedQImageTraits<PiiColor4<uchar> >
+{
+  enum { Format = QImage::Format_RGB32 };
+  static bool isCompatible(const QImage& image)
+  {
+    return image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32;
+  }
+};
+
+// Keeps a QImage alive as long as a matrix uses its data.
+class PII_CORE_EXPORT PiiQImageLease : public PiiBufferLease
+{
+public:
+  PiiQImageLease(const QImage& image) : _image(image) {}
+protected:
+  void returnBuffer();
+private:
+  QImage _image;
+};
+/// @endhide
+
 
 template <class T> PiiQImage<T>* PiiQImage<T>::create(QImage& image)
 {
@@ -384,6 +473,42 @@ namespace Pii
     return result;
   }
 
+  /// @hide
+  template <class T> void releaseSharedMatrix(void* matrix)
+  {
+    delete static_cast<PiiMatrix<T>*>(matrix);
+  }
+  /// @endhide
+
+  template <class T> QImage matrixToSharedQImage(const PiiMatrix<T>& matrix)
+  {
+#if QT_VERSION >= 0x050000
+    // QImage needs 32-bit aligned scan lines.
+    if (int(PiiSharedQImageTraits<T>::Format) != QImage::Format_Invalid &&
+        !matrix.isEmpty() && matrix.alignment() >= 4)
+      return QImage(static_cast<const uchar*>(static_cast<const void*>(matrix.row(0))),
+                    matrix.columns(), matrix.rows(), int(matrix.stride()),
+                    (QImage::Format)PiiSharedQImageTraits<T>::Format,
+                    &releaseSharedMatrix<T>, new PiiMatrix<T>(matrix));
+#endif
+    return matrixToQImage(matrix);
+  }
+
+  template <class T> PiiMatrix<T> qImageToSharedMatrix(const QImage& image)
+  {
+    const QImage::Format format = (QImage::Format)PiiSharedQImageTraits<T>::Format;
+    if (format == QImage::Format_Invalid || image.isNull())
+      return PiiMatrix<T>();
+
+    QImage source(PiiSharedQImageTraits<T>::isCompatible(image) ? image : image.convertToFormat(format));
+    PiiBufferLease* pLease = new PiiQImageLease(source);
+    PiiMatrix<T> result(source.height(), source.width(),
+                        static_cast<const void*>(source.constBits()), pLease,
+                        std::size_t(source.bytesPerLine()));
+    pLease->release();
+    return result;
+  }
+
   template <class T> QImage* createQImage(PiiMatrix<T>& matrix)
   {
     return Pii::IfClass<Pii::IsColor<T>,
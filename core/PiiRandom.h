@@ -26,7 +26,10 @@ namespace Pii
   /**
    * @group random Random Number Generation
    *
-   * Functions for generating different types of random numbers.
+   * Functions for generating different types of random numbers. The
+   * functions share a global generator. PiiRandomGenerator is faster
+   * for filling large buffers and gives each thread its own
+   * reproducible sequence.
    */
 
   /**
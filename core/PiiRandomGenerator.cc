@@ -0,0 +1,267 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRandomGenerator.h"
+#include "PiiMath.h"
+
+#include <cmath>
+
+namespace
+{
+  inline quint64 splitMix64(quint64& state)
+  {
+    quint64 z = (state += Q_UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+  }
+
+  inline quint64 rotl(quint64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  // Maps 32 random bits to [0, range) without bias. This is Lemire's
+  // multiply-and-shift method; the rejection loop is entered with a
+  // probability of at most range/2^32.
+  template <class Generator> inline quint32 boundedInteger(Generator& generator, quint32 bits, quint32 range)
+  {
+    quint64 m = quint64(bits) * range;
+    quint32 l = quint32(m);
+    if (l < range)
+      {
+        const quint32 t = quint32(-range) % range;
+        while (l < t)
+          {
+            m = quint64(quint32(generator.next() >> 32)) * range;
+            l = quint32(m);
+          }
+      }
+    return quint32(m >> 32);
+  }
+}
+
+PiiRandomGenerator::PiiRandomGenerator(quint64 seed, quint64 stream)
+{
+  this->seed(seed, stream);
+}
+
+void PiiRandomGenerator::seed(quint64 seed, quint64 stream)
+{
+  // Different streams go through a different splitmix sequence. The
+  // state of each lane is filled from the same sequence so that no
+  // two lanes start from the same point.
+  quint64 iStreamKey = stream;
+  quint64 iMixer = seed ^ splitMix64(iStreamKey);
+  for (int l=0; l<LaneCount; ++l)
+    for (int w=0; w<4; ++w)
+      _aState[w][l] = splitMix64(iMixer);
+  _iBufferPos = BufferSize;
+  _dSpareNormal = 0;
+  _bHasSpareNormal = false;
+}
+
+void PiiRandomGenerator::generate(quint64* data, int count)
+{
+  quint64 s0[LaneCount], s1[LaneCount], s2[LaneCount], s3[LaneCount];
+  for (int l=0; l<LaneCount; ++l)
+    {
+      s0[l] = _aState[0][l];
+      s1[l] = _aState[1][l];
+      s2[l] = _aState[2][l];
+      s3[l] = _aState[3][l];
+    }
+
+  // The lanes are independent, and the inner loop has no branches.
+  // Multiplications by 5 and 9 are written as shifts and additions
+  // because SSE2 and AVX2 lack 64-bit multiplications.
+  for (int i=0; i<count; i += LaneCount)
+    for (int l=0; l<LaneCount; ++l)
+      {
+        const quint64 x = (s1[l] << 2) + s1[l];
+        const quint64 y = rotl(x, 7);
+        data[i+l] = (y << 3) + y;
+
+        const quint64 t = s1[l] << 17;
+        s2[l] ^= s0[l];
+        s3[l] ^= s1[l];
+        s1[l] ^= s2[l];
+        s0[l] ^= s3[l];
+        s2[l] ^= t;
+        s3[l] = rotl(s3[l], 45);
+      }
+
+  for (int l=0; l<LaneCount; ++l)
+    {
+      _aState[0][l] = s0[l];
+      _aState[1][l] = s1[l];
+      _aState[2][l] = s2[l];
+      _aState[3][l] = s3[l];
+    }
+}
+
+void PiiRandomGenerator::refill()
+{
+  generate(_aBuffer, BufferSize);
+  _iBufferPos = 0;
+}
+
+void PiiRandomGenerator::fillBits(quint64* data, int count)
+{
+  const int iBulk = count & ~(LaneCount-1);
+  generate(data, iBulk);
+  for (int i=iBulk; i<count; ++i)
+    data[i] = next();
+}
+
+double PiiRandomGenerator::normal()
+{
+  if (_bHasSpareNormal)
+    {
+      _bHasSpareNormal = false;
+      return _dSpareNormal;
+    }
+  // Box-Muller. 1-u is in (0,1], which keeps log() finite.
+  const double dR = std::sqrt(-2.0 * std::log(1.0 - uniform()));
+  const double dTheta = 2 * M_PI * uniform();
+  _dSpareNormal = dR * std::sin(dTheta);
+  _bHasSpareNormal = true;
+  return dR * std::cos(dTheta);
+}
+
+int PiiRandomGenerator::integer(int min, int max)
+{
+  if (max <= min)
+    return min;
+  const quint64 iRange = quint64(qint64(max) - qint64(min)) + 1;
+  const quint32 iBits = quint32(next() >> 32);
+  if (iRange > Q_UINT64_C(0xffffffff))
+    return int(qint64(min) + qint64(iBits));
+  return int(qint64(min) + qint64(boundedInteger(*this, iBits, quint32(iRange))));
+}
+
+namespace
+{
+  template <class T, class Generator, class Converter>
+  void fillInChunks(Generator& generator, T* data, int count, Converter convert)
+  {
+    quint64 aBits[256];
+    while (count > 0)
+      {
+        const int iChunk = qMin(count, 256) & ~3;
+        if (iChunk == 0)
+          break;
+        generator.fillBits(aBits, iChunk);
+        convert(aBits, data, iChunk);
+        data += iChunk;
+        count -= iChunk;
+      }
+    if (count > 0)
+      {
+        generator.fillBits(aBits, count);
+        convert(aBits, data, count);
+      }
+  }
+
+  template <class T> T toUnit(quint64 bits);
+  template <> inline double toUnit<double>(quint64 bits) { return double(bits >> 11) * (1.0 / 9007199254740992.0); }
+  template <> inline float toUnit<float>(quint64 bits) { return float(bits >> 40) * (1.0f / 16777216.0f); }
+
+  template <class T> struct UniformConverter
+  {
+    UniformConverter(T min, T max) : min(min), scale(max - min) {}
+    void operator() (const quint64* bits, T* data, int count) const
+    {
+      for (int i=0; i<count; ++i)
+        data[i] = toUnit<T>(bits[i]) * scale + min;
+    }
+    T min, scale;
+  };
+
+  template <class T> struct NormalConverter
+  {
+    NormalConverter(PiiRandomGenerator& generator, T mean, T sigma) :
+      generator(generator), mean(mean), sigma(sigma)
+    {}
+    void operator() (const quint64* bits, T* data, int count) const
+    {
+      int i = 0;
+      for (; i+1<count; i += 2)
+        {
+          const double dR = std::sqrt(-2.0 * std::log(1.0 - toUnit<double>(bits[i])));
+          const double dTheta = 2 * M_PI * toUnit<double>(bits[i+1]);
+          data[i] = T(dR * std::cos(dTheta)) * sigma + mean;
+          data[i+1] = T(dR * std::sin(dTheta)) * sigma + mean;
+        }
+      // An odd element at the end of the data needs one more number.
+      // This happens at most once per fill.
+      if (i < count)
+        {
+          const double dR = std::sqrt(-2.0 * std::log(1.0 - toUnit<double>(bits[i])));
+          data[i] = T(dR * std::cos(2 * M_PI * toUnit<double>(generator.next()))) * sigma + mean;
+        }
+    }
+    PiiRandomGenerator& generator;
+    T mean, sigma;
+  };
+
+  struct IntegerConverter
+  {
+    IntegerConverter(PiiRandomGenerator& generator, int min, int max) :
+      generator(generator), min(min),
+      range(quint64(qint64(max) - qint64(min)) + 1)
+    {}
+    void operator() (const quint64* bits, int* data, int count) const
+    {
+      if (range > Q_UINT64_C(0xffffffff))
+        for (int i=0; i<count; ++i)
+          data[i] = int(qint64(min) + qint64(bits[i] >> 32));
+      else
+        for (int i=0; i<count; ++i)
+          data[i] = int(qint64(min) + qint64(boundedInteger(generator, quint32(bits[i] >> 32), quint32(range))));
+    }
+    PiiRandomGenerator& generator;
+    int min;
+    quint64 range;
+  };
+}
+
+void PiiRandomGenerator::fillUniform(double* data, int count, double min, double max)
+{
+  fillInChunks(*this, data, count, UniformConverter<double>(min, max));
+}
+
+void PiiRandomGenerator::fillUniform(float* data, int count, float min, float max)
+{
+  fillInChunks(*this, data, count, UniformConverter<float>(min, max));
+}
+
+void PiiRandomGenerator::fillNormal(double* data, int count, double mean, double sigma)
+{
+  fillInChunks(*this, data, count, NormalConverter<double>(*this, mean, sigma));
+}
+
+void PiiRandomGenerator::fillNormal(float* data, int count, float mean, float sigma)
+{
+  fillInChunks(*this, data, count, NormalConverter<float>(*this, mean, sigma));
+}
+
+void PiiRandomGenerator::fillIntegers(int* data, int count, int min, int max)
+{
+  if (max <= min)
+    {
+      for (int i=0; i<count; ++i)
+        data[i] = min;
+      return;
+    }
+  fillInChunks(*this, data, count, IntegerConverter(*this, min, max));
+}
@@ -0,0 +1,160 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRANDOMGENERATOR_H
+#define _PIIRANDOMGENERATOR_H
+
+#include "PiiGlobal.h"
+#include <PiiMatrix.h>
+
+/**
+ * A fast pseudo-random number generator for filling large buffers.
+ * Unlike the functions in [random](group:random), PiiRandomGenerator
+ * has no global state. Each instance produces its own reproducible
+ * sequence, which makes it safe to use one generator per thread.
+ *
+ * The generator runs four independent xoshiro256** streams side by
+ * side. The bulk functions draw one number from each stream in turn,
+ * which lets the compiler keep the four states in vector registers
+ * and generate four 64-bit numbers at a time.
+ *
+ * Generators created with the same *seed* but different *stream*
+ * numbers produce sequences that don't overlap in practice. To get
+ * reproducible results from parallel code, give each worker its own
+ * stream:
+ *
+ * ~~~(c++)
+ * // In a worker with index iWorker
+ * PiiRandomGenerator generator(12345, iWorker);
+ * PiiMatrix<float> matNoise(PiiMatrix<float>::uninitialized(rows, columns));
+ * generator.fillNormal(matNoise, 0, 5);
+ * ~~~
+ *
+ * A generator must not be used by many threads simultaneously.
+ */
+class PII_CORE_EXPORT PiiRandomGenerator
+{
+public:
+  /**
+   * Creates a generator whose state is derived from *seed* and
+   * *stream*.
+   */
+  PiiRandomGenerator(quint64 seed = 0, quint64 stream = 0);
+
+  /**
+   * Re-initializes the generator as if it was just created with
+   * *seed* and *stream*.
+   */
+  void seed(quint64 seed, quint64 stream = 0);
+
+  /**
+   * Returns the next 64 random bits.
+   */
+  quint64 next()
+  {
+    if (_iBufferPos == BufferSize)
+      refill();
+    return _aBuffer[_iBufferPos++];
+  }
+
+  /**
+   * Returns a uniformly distributed random number in [0,1).
+   */
+  double uniform() { return toUnitDouble(next()); }
+
+  /**
+   * Returns a random number from N(0,1).
+   */
+  double normal();
+
+  /**
+   * Returns a uniformly distributed integer in [*min*, *max*].
+   * Every value has exactly the same probability.
+   */
+  int integer(int min, int max);
+
+  /**
+   * Fills *data* with *count* 64-bit random numbers.
+   */
+  void fillBits(quint64* data, int count);
+
+  /**
+   * Fills *data* with *count* uniformly distributed numbers in
+   * [*min*, *max*).
+   */
+  void fillUniform(double* data, int count, double min = 0, double max = 1);
+  void fillUniform(float* data, int count, float min = 0, float max = 1);
+
+  /**
+   * Fills *data* with *count* normally distributed numbers with the
+   * given *mean* and standard deviation *sigma*.
+   */
+  void fillNormal(double* data, int count, double mean = 0, double sigma = 1);
+  void fillNormal(float* data, int count, float mean = 0, float sigma = 1);
+
+  /**
+   * Fills *data* with *count* uniformly distributed integers in
+   * [*min*, *max*].
+   */
+  void fillIntegers(int* data, int count, int min, int max);
+
+  /**
+   * Fills *matrix* with uniformly distributed numbers in [*min*,
+   * *max*). Only `float` and `double` are supported.
+   */
+  template <class T> void fillUniform(PiiMatrix<T>& matrix, T min = 0, T max = 1)
+  {
+    for (int r=0; r<matrix.rows(); ++r)
+      fillUniform(matrix.row(r), matrix.columns(), min, max);
+  }
+
+  /**
+   * Fills *matrix* with normally distributed numbers. Only `float`
+   * and `double` are supported.
+   */
+  template <class T> void fillNormal(PiiMatrix<T>& matrix, T mean = 0, T sigma = 1)
+  {
+    for (int r=0; r<matrix.rows(); ++r)
+      fillNormal(matrix.row(r), matrix.columns(), mean, sigma);
+  }
+
+  /**
+   * Fills *matrix* with uniformly distributed integers in [*min*,
+   * *max*].
+   */
+  void fillIntegers(PiiMatrix<int>& matrix, int min, int max)
+  {
+    for (int r=0; r<matrix.rows(); ++r)
+      fillIntegers(matrix.row(r), matrix.columns(), min, max);
+  }
+
+private:
+  enum { LaneCount = 4, BufferSize = 64 };
+
+  static double toUnitDouble(quint64 bits) { return double(bits >> 11) * (1.0 / 9007199254740992.0); }
+
+  void refill();
+  // Generates count/LaneCount rounds of numbers. count must be a
+  // multiple of LaneCount.
+  void generate(quint64* data, int count);
+
+  quint64 _aState[4][LaneCount];
+  quint64 _aBuffer[BufferSize];
+  int _iBufferPos;
+  double _dSpareNormal;
+  bool _bHasSpareNormal;
+};
+
+#endif //_PIIRANDOMGENERATOR_H
@@ -14,19 +14,200 @@
  */
 
 #include "PiiReadWriteLock.h"
+#include "PiiAtomicInt.h"
 
 #include <QThread>
+#include <QVarLengthArray>
+#include <new>
 
-// Note: Similarities to QReadWriteLock are not coincidental.
+namespace
+{
+  enum { CacheLineSize = 64, MaxSlots = 64 };
+  // Writer states
+  enum { Free, Draining, Locked };
+
+  // One reader counter per core, rounded up to a power of two.
+  int countSlots()
+  {
+    const int iCores = QThread::idealThreadCount();
+    int iSlots = 1;
+    while (iSlots < iCores && iSlots < MaxSlots)
+      iSlots <<= 1;
+    return iSlots;
+  }
+
+  inline int slotCount()
+  {
+    static const int iCount = countSlots();
+    return iCount;
+  }
+
+  // Threads are numbered in order of first use so that the first N
+  // threads get different reader counters.
+  PiiAtomicInt iNextThreadIndex;
+  thread_local int iThreadIndex = -1;
+
+  inline int threadIndex()
+  {
+    if (iThreadIndex < 0)
+      iThreadIndex = iNextThreadIndex++ & 0x7fffffff;
+    return iThreadIndex;
+  }
+
+  // Recursive locks held by the current thread.
+  struct HeldLock
+  {
+    const void* pLock;
+    int iReadCount;
+    int iWriteCount;
+  };
+  typedef QVarLengthArray<HeldLock, 8> HeldLockList;
+
+  inline HeldLockList& heldLocks()
+  {
+    thread_local HeldLockList lstLocks;
+    return lstLocks;
+  }
+
+  inline HeldLock* findHeldLock(const void* lock)
+  {
+    HeldLockList& lstLocks = heldLocks();
+    for (int i=0; i<lstLocks.size(); ++i)
+      if (lstLocks[i].pLock == lock)
+        return &lstLocks[i];
+    return 0;
+  }
+
+  inline HeldLock* addHeldLock(const void* lock)
+  {
+    HeldLockList& lstLocks = heldLocks();
+    HeldLock held = { lock, 0, 0 };
+    lstLocks.append(held);
+    return &lstLocks[lstLocks.size()-1];
+  }
+
+  inline void removeHeldLock(HeldLock* held)
+  {
+    HeldLockList& lstLocks = heldLocks();
+    *held = lstLocks[lstLocks.size()-1];
+    lstLocks.resize(lstLocks.size()-1);
+  }
+}
+
+/* The reader counters and the writer state are only modified with
+ * ordered atomic operations. A reader increments its counter before
+ * it checks the writer state, and a writer changes the state before
+ * it sums up the counters. Therefore, at least one of them always
+ * sees the other.
+ */
+class PiiReadWriteLock::Data
+{
+public:
+  Data(bool recursive);
+  ~Data();
+
+  PiiAtomicInt& readers(int thread)
+  {
+    return *reinterpret_cast<PiiAtomicInt*>(pSlots + (thread & iSlotMask) * CacheLineSize);
+  }
+
+  int activeReaders()
+  {
+    int iReaders = 0;
+    for (int i=0; i<=iSlotMask; ++i)
+      iReaders += readers(i).loadAcquire();
+    return iReaders;
+  }
+
+  void releaseReader(PiiAtomicInt& counter);
+  void waitUntilFree(bool yieldToUpgraders);
+  bool drain(int ownReaders);
+  void wakeWaiters();
+
+  char* pBuffer;
+  char* pSlots;
+  int iSlotMask;
+  PiiAtomicInt iWriterState;
+  // Number of threads waiting for iWriterState to become Free.
+  PiiAtomicInt iWaiters;
+  // Number of threads that hold a read lock and want to write.
+  PiiAtomicInt iUpgraders;
+  bool bRecursive;
+
+  QMutex mutex;
+  QWaitCondition freeCondition, drainedCondition;
+};
 
 PiiReadWriteLock::Data::Data(bool recursive) :
-  currentWriter(0),
-  bRecursive(recursive),
-  iActiveReaders(0),
-  iActiveWriters(0),
-  iWaitingReaders(0),
-  iWaitingWriters(0)
-{}
+  pBuffer(new char[(slotCount() + 1) * CacheLineSize]),
+  iSlotMask(slotCount() - 1),
+  bRecursive(recursive)
+{
+  // Each counter lives on a cache line of its own.
+  pSlots = pBuffer + CacheLineSize - reinterpret_cast<quintptr>(pBuffer) % CacheLineSize;
+  for (int i=0; i<=iSlotMask; ++i)
+    new (pSlots + i * CacheLineSize) PiiAtomicInt(0);
+}
+
+PiiReadWriteLock::Data::~Data()
+{
+  delete[] pBuffer;
+}
+
+void PiiReadWriteLock::Data::releaseReader(PiiAtomicInt& counter)
+{
+  --counter;
+  // A writer may be waiting for us.
+  if (iWriterState.load() == Draining)
+    {
+      mutex.lock();
+      drainedCondition.wakeOne();
+      mutex.unlock();
+    }
+}
+
+void PiiReadWriteLock::Data::waitUntilFree(bool yieldToUpgraders)
+{
+  ++iWaiters;
+  mutex.lock();
+  while (iWriterState.load() != Free ||
+         (yieldToUpgraders && iUpgraders.load() > 0))
+    freeCondition.wait(&mutex);
+  mutex.unlock();
+  --iWaiters;
+}
+
+bool PiiReadWriteLock::Data::drain(int ownReaders)
+{
+  if (activeReaders() == ownReaders)
+    return true;
+
+  QMutexLocker lock(&mutex);
+  while (activeReaders() != ownReaders)
+    {
+      // A thread that holds a read lock wants to write. It won't
+      // release its read lock before it gets the write lock, so we
+      // must step aside.
+      if (ownReaders == 0 && iUpgraders.load() > 0)
+        {
+          iWriterState.testAndSet(Draining, Free);
+          freeCondition.wakeAll();
+          return false;
+        }
+      drainedCondition.wait(&mutex);
+    }
+  return true;
+}
+
+void PiiReadWriteLock::Data::wakeWaiters()
+{
+  if (iWaiters.load() > 0)
+    {
+      mutex.lock();
+      freeCondition.wakeAll();
+      mutex.unlock();
+    }
+}
 
 PiiReadWriteLock::PiiReadWriteLock() : d(new Data(false))
 {
@@ -41,117 +222,128 @@ PiiReadWriteLock::~PiiReadWriteLock()
   delete d;
 }
 
-void PiiReadWriteLock::lockForRead()
+void PiiReadWriteLock::acquireRead()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Qt::HANDLE self = 0;
-  // If the lock is recursive, must check if we currently hold it.
-  if (d->bRecursive)
+  PiiAtomicInt& counter = d->readers(threadIndex());
+  for (;;)
     {
-      self = QThread::currentThreadId();
+      ++counter;
+      if (d->iWriterState.load() == Free)
+        return;
+      // A writer is active or waiting. Back off and let it proceed.
+      d->releaseReader(counter);
+      d->waitUntilFree(false);
+    }
+}
 
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      // Re-acquiring a read lock
-      if (it != d->hashCurrentReaders.end())
-        {
-          ++it.value();
-          ++d->iActiveReaders;
-          return;
-        }
-      // Using a write lock for reading
-      if (d->currentWriter == self)
-        {
-          d->hashCurrentReaders.insert(self, 1);
-          ++d->iActiveReaders;
-          return;
-        }
+void PiiReadWriteLock::acquireWrite(int ownReaders)
+{
+  const bool bUpgrade = ownReaders > 0;
+  if (bUpgrade)
+    {
+      ++d->iUpgraders;
+      // Another writer may be waiting for our read lock to go.
+      d->mutex.lock();
+      d->drainedCondition.wakeAll();
+      d->mutex.unlock();
     }
 
-  // Must wait for all writers to finish.
-  while (d->iActiveWriters > 0 || d->iWaitingWriters > 0)
+  for (;;)
     {
-      ++d->iWaitingReaders;
-      d->readerWait.wait(&d->mutex);
-      --d->iWaitingReaders;
+      // Announce ourselves. This keeps new readers away.
+      if ((!bUpgrade && d->iUpgraders.load() > 0) ||
+          !d->iWriterState.testAndSet(Free, Draining))
+        {
+          d->waitUntilFree(!bUpgrade);
+          continue;
+        }
+      // Wait for current readers to finish.
+      if (d->drain(ownReaders))
+        break;
     }
-  if (d->bRecursive)
-    d->hashCurrentReaders.insert(self, 1);
 
-  ++d->iActiveReaders;
+  if (bUpgrade)
+    --d->iUpgraders;
+  d->iWriterState.storeRelease(Locked);
 }
 
-void PiiReadWriteLock::lockForWrite()
+void PiiReadWriteLock::lockForRead()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Qt::HANDLE self = 0;
-  int iRemainingReaders = 0;
+  // If the lock is recursive, must check if we currently hold it.
   if (d->bRecursive)
     {
-      self = QThread::currentThreadId();
-
-      // Recursive lock can be locked for writing again.
-      if (d->currentWriter == self)
+      HeldLock* pHeld = findHeldLock(this);
+      // Re-acquiring a read lock or using a write lock for reading.
+      if (pHeld != 0)
         {
-          ++d->iActiveWriters;
+          // The first read lock of a writer is counted as any other
+          // so that it keeps writers away once the write lock is
+          // released.
+          if (pHeld->iReadCount++ == 0)
+            ++d->readers(threadIndex());
           return;
         }
-      // See if we currently hold a read lock.
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      // Yes, we must leave one reader in the queue.
-      if (it != d->hashCurrentReaders.end())
-        iRemainingReaders = it.value();
+      acquireRead();
+      addHeldLock(this)->iReadCount = 1;
     }
+  else
+    acquireRead();
+}
 
-  while (d->iActiveWriters > 0 || d->iActiveReaders > iRemainingReaders)
+void PiiReadWriteLock::lockForWrite()
+{
+  if (d->bRecursive)
     {
-      ++d->iWaitingWriters;
-      d->writerWait.wait(&d->mutex);
-      --d->iWaitingWriters;
+      HeldLock* pHeld = findHeldLock(this);
+      if (pHeld != 0)
+        {
+          // Recursive lock can be locked for writing again.
+          if (pHeld->iWriteCount > 0)
+            {
+              ++pHeld->iWriteCount;
+              return;
+            }
+          // We currently hold a read lock and must leave one reader
+          // in the counters.
+          acquireWrite(1);
+          pHeld->iWriteCount = 1;
+          return;
+        }
+      acquireWrite(0);
+      addHeldLock(this)->iWriteCount = 1;
     }
-
-  d->currentWriter = self;
-  ++d->iActiveWriters;
+  else
+    acquireWrite(0);
 }
 
 void PiiReadWriteLock::unlockRead()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Q_ASSERT(d->iActiveReaders > 0);
-
   if (d->bRecursive)
     {
-      Qt::HANDLE self = QThread::currentThreadId();
-      ThreadHash::iterator it = d->hashCurrentReaders.find(self);
-      if (it != d->hashCurrentReaders.end() &&
-          --it.value() <= 0)
-        d->hashCurrentReaders.erase(it);
+      HeldLock* pHeld = findHeldLock(this);
+      Q_ASSERT(pHeld != 0 && pHeld->iReadCount > 0);
+      if (--pHeld->iReadCount > 0)
+        return;
+      if (pHeld->iWriteCount == 0)
+        removeHeldLock(pHeld);
     }
 
-  if (--d->iActiveReaders == 0 && d->iActiveWriters == 0)
-    wakeUp();
+  d->releaseReader(d->readers(threadIndex()));
 }
 
 void PiiReadWriteLock::unlockWrite()
 {
-  QMutexLocker lock(&d->mutex);
-
-  Q_ASSERT(d->iActiveWriters > 0);
-
-  if (--d->iActiveWriters == 0)
+  if (d->bRecursive)
     {
-      d->currentWriter = 0;
-      if (d->iActiveReaders == 0)
-        wakeUp();
+      HeldLock* pHeld = findHeldLock(this);
+      Q_ASSERT(pHeld != 0 && pHeld->iWriteCount > 0);
+      if (--pHeld->iWriteCount > 0)
+        return;
+      if (pHeld->iReadCount == 0)
+        removeHeldLock(pHeld);
     }
-}
 
-void PiiReadWriteLock::wakeUp()
-{
-  if (d->iWaitingWriters)
-    d->writerWait.wakeOne();
-  else if (d->iWaitingReaders)
-    d->readerWait.wakeAll();
+  Q_ASSERT(d->iWriterState.load() == Locked);
+  d->iWriterState.testAndSet(Locked, Free);
+  d->wakeWaiters();
 }
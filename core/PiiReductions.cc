@@ -0,0 +1,749 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiReductions.h"
+
+#include "PiiCpu.h"
+#include <cmath>
+#include <cstdlib>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_REDUCTION_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_REDUCTION_AVX 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_REDUCTION_NEON 1
+#endif
+
+namespace Pii
+{
+  namespace
+  {
+    /* The function applied to each element before summing. */
+    enum Mapping { Identity, Square, Absolute, Deviation };
+
+    /* Floating-point reductions always accumulate into doubles.
+       Vec is a vector of Width doubles, and load() converts Width
+       input elements to doubles.
+     */
+    template <class U> struct ScalarOps
+    {
+      typedef U T;
+      typedef double Vec;
+      enum { Width = 1 };
+
+      static inline Vec zero() { return 0.0; }
+      static inline Vec set1(double value) { return value; }
+      static inline Vec load(const U* data) { return double(*data); }
+      static inline Vec add(Vec a, Vec b) { return a + b; }
+      static inline Vec sub(Vec a, Vec b) { return a - b; }
+      static inline Vec mul(Vec a, Vec b) { return a * b; }
+      static inline Vec abs(Vec a) { return std::fabs(a); }
+      static inline double sum(Vec a) { return a; }
+    };
+
+    /* Min-max operations work on native element types. minimum()
+       and maximum() reduce a vector to a single element.
+     */
+    template <class U> struct ScalarMinMaxOps
+    {
+      typedef U T;
+      typedef U Vec;
+      enum { Width = 1 };
+
+      static inline Vec load(const U* data) { return *data; }
+      static inline Vec min(Vec a, Vec b) { return b < a ? b : a; }
+      static inline Vec max(Vec a, Vec b) { return b > a ? b : a; }
+      static inline U minimum(Vec a) { return a; }
+      static inline U maximum(Vec a) { return a; }
+    };
+
+    template <class T> long long sumInteger(const T* data, int n)
+    {
+      long long iSum = 0;
+      for (int i=0; i<n; ++i)
+        iSum += data[i];
+      return iSum;
+    }
+
+    template <class T> long long sumOfSquaresInteger(const T* data, int n)
+    {
+      long long iSum = 0;
+      for (int i=0; i<n; ++i)
+        iSum += (long long)data[i] * data[i];
+      return iSum;
+    }
+
+    long long absSumInteger(const short* data, int n)
+    {
+      long long iSum = 0;
+      for (int i=0; i<n; ++i)
+        iSum += std::abs(int(data[i]));
+      return iSum;
+    }
+  }
+
+  /* The floating-point kernels are compiled separately for each
+     instruction set, in the same way as the matrix product. Four
+     independent accumulators hide the latency of vector additions.
+     Elements that don't fill a whole vector are handled with scalar
+     code.
+   */
+#define PII_REDUCTION_KERNELS(TARGET)                                   \
+  template <int mapping, class Ops> TARGET inline                       \
+  typename Ops::Vec map(typename Ops::Vec value, typename Ops::Vec mean) \
+  {                                                                     \
+    if (mapping == Square)                                              \
+      return Ops::mul(value, value);                                    \
+    else if (mapping == Absolute)                                       \
+      return Ops::abs(value);                                           \
+    else if (mapping == Deviation)                                      \
+      {                                                                 \
+        value = Ops::sub(value, mean);                                  \
+        return Ops::mul(value, value);                                  \
+      }                                                                 \
+    return value;                                                       \
+  }                                                                     \
+                                                                        \
+  template <int mapping, class Ops> TARGET                              \
+  double reduce(const typename Ops::T* data, int n, double mean)        \
+  {                                                                     \
+    typedef typename Ops::T T;                                          \
+    typedef typename Ops::Vec Vec;                                      \
+    const int iWidth = Ops::Width;                                      \
+    const Vec vMean = Ops::set1(mean);                                  \
+    Vec s0 = Ops::zero(), s1 = Ops::zero(), s2 = Ops::zero(), s3 = Ops::zero(); \
+    int i = 0;                                                          \
+    for (; i+4*iWidth <= n; i += 4*iWidth)                              \
+      {                                                                 \
+        s0 = Ops::add(s0, map<mapping,Ops>(Ops::load(data + i), vMean)); \
+        s1 = Ops::add(s1, map<mapping,Ops>(Ops::load(data + i + iWidth), vMean)); \
+        s2 = Ops::add(s2, map<mapping,Ops>(Ops::load(data + i + 2*iWidth), vMean)); \
+        s3 = Ops::add(s3, map<mapping,Ops>(Ops::load(data + i + 3*iWidth), vMean)); \
+      }                                                                 \
+    for (; i+iWidth <= n; i += iWidth)                                  \
+      s0 = Ops::add(s0, map<mapping,Ops>(Ops::load(data + i), vMean));  \
+    double dSum = Ops::sum(Ops::add(Ops::add(s0, s1), Ops::add(s2, s3))); \
+    for (; i<n; ++i)                                                    \
+      dSum += map<mapping,ScalarOps<T> >(double(data[i]), mean);        \
+    return dSum;                                                        \
+  }                                                                     \
+                                                                        \
+  template <class Ops> TARGET                                           \
+  void minMax(const typename Ops::T* data, int n,                       \
+              typename Ops::T* min, typename Ops::T* max)               \
+  {                                                                     \
+    typedef typename Ops::T T;                                          \
+    typedef typename Ops::Vec Vec;                                      \
+    const int iWidth = Ops::Width;                                      \
+    T minValue = data[0], maxValue = data[0];                           \
+    int i = 0;                                                          \
+    if (n >= iWidth)                                                    \
+      {                                                                 \
+        Vec vMin = Ops::load(data), vMax = vMin;                        \
+        for (i = iWidth; i+iWidth <= n; i += iWidth)                    \
+          {                                                             \
+            Vec vValue = Ops::load(data + i);                           \
+            vMin = Ops::min(vMin, vValue);                              \
+            vMax = Ops::max(vMax, vValue);                              \
+          }                                                             \
+        minValue = Ops::minimum(vMin);                                  \
+        maxValue = Ops::maximum(vMax);                                  \
+      }                                                                 \
+    for (; i<n; ++i)                                                    \
+      {                                                                 \
+        if (data[i] < minValue)                                         \
+          minValue = data[i];                                           \
+        else if (data[i] > maxValue)                                    \
+          maxValue = data[i];                                           \
+      }                                                                 \
+    *min = minValue;                                                    \
+    *max = maxValue;                                                    \
+  }
+
+  namespace
+  {
+    namespace Scalar
+    {
+      PII_REDUCTION_KERNELS()
+    }
+
+#ifdef PII_REDUCTION_SSE2
+    namespace Sse2
+    {
+      template <class T> struct Ops;
+
+      template <> struct Ops<float>
+      {
+        typedef float T;
+        typedef __m128d Vec;
+        enum { Width = 2 };
+
+        static inline Vec zero() { return _mm_setzero_pd(); }
+        static inline Vec set1(double value) { return _mm_set1_pd(value); }
+        static inline Vec load(const float* data)
+        {
+          return _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(data))));
+        }
+        static inline Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static inline Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        static inline Vec abs(Vec a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        static inline double sum(Vec a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+      };
+
+      template <> struct Ops<double> : Ops<float>
+      {
+        typedef double T;
+        static inline Vec load(const double* data) { return _mm_loadu_pd(data); }
+      };
+
+      template <class T> struct MinMaxOps;
+
+      template <> struct MinMaxOps<unsigned char>
+      {
+        typedef unsigned char T;
+        typedef __m128i Vec;
+        enum { Width = 16 };
+
+        static inline Vec load(const T* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_epu8(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_epu8(a, b); }
+        static inline T minimum(Vec a)
+        {
+          T aValues[Width];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+          T result = aValues[0];
+          for (int i=1; i<Width; ++i) result = qMin(result, aValues[i]);
+          return result;
+        }
+        static inline T maximum(Vec a)
+        {
+          T aValues[Width];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+          T result = aValues[0];
+          for (int i=1; i<Width; ++i) result = qMax(result, aValues[i]);
+          return result;
+        }
+      };
+
+      template <> struct MinMaxOps<short>
+      {
+        typedef short T;
+        typedef __m128i Vec;
+        enum { Width = 8 };
+
+        static inline Vec load(const T* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_epi16(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+        static inline T minimum(Vec a)
+        {
+          T aValues[Width];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+          T result = aValues[0];
+          for (int i=1; i<Width; ++i) result = qMin(result, aValues[i]);
+          return result;
+        }
+        static inline T maximum(Vec a)
+        {
+          T aValues[Width];
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+          T result = aValues[0];
+          for (int i=1; i<Width; ++i) result = qMax(result, aValues[i]);
+          return result;
+        }
+      };
+
+      /* SSE2 has no unsigned 16-bit min/max. Flipping the sign bit
+         maps unsigned values to signed ones in the same order.
+       */
+      template <> struct MinMaxOps<unsigned short>
+      {
+        typedef unsigned short T;
+        typedef __m128i Vec;
+        enum { Width = 8 };
+
+        static inline Vec load(const T* data)
+        {
+          return _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                               _mm_set1_epi16(short(0x8000)));
+        }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_epi16(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+        static inline T minimum(Vec a) { return T(MinMaxOps<short>::minimum(a) ^ 0x8000); }
+        static inline T maximum(Vec a) { return T(MinMaxOps<short>::maximum(a) ^ 0x8000); }
+      };
+
+      template <> struct MinMaxOps<float>
+      {
+        typedef float T;
+        typedef __m128 Vec;
+        enum { Width = 4 };
+
+        static inline Vec load(const T* data) { return _mm_loadu_ps(data); }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        static inline T minimum(Vec a)
+        {
+          a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+          return _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(a, a, 1)));
+        }
+        static inline T maximum(Vec a)
+        {
+          a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+          return _mm_cvtss_f32(_mm_max_ss(a, _mm_shuffle_ps(a, a, 1)));
+        }
+      };
+
+      template <> struct MinMaxOps<double>
+      {
+        typedef double T;
+        typedef __m128d Vec;
+        enum { Width = 2 };
+
+        static inline Vec load(const T* data) { return _mm_loadu_pd(data); }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_pd(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_pd(a, b); }
+        static inline T minimum(Vec a) { return _mm_cvtsd_f64(_mm_min_sd(a, _mm_unpackhi_pd(a, a))); }
+        static inline T maximum(Vec a) { return _mm_cvtsd_f64(_mm_max_sd(a, _mm_unpackhi_pd(a, a))); }
+      };
+
+      PII_REDUCTION_KERNELS()
+
+      inline long long sum64(__m128i a)
+      {
+        long long aValues[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+        return aValues[0] + aValues[1];
+      }
+
+      inline long long sum32(__m128i a)
+      {
+        int aValues[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(aValues), a);
+        return (long long)aValues[0] + aValues[1] + aValues[2] + aValues[3];
+      }
+
+      inline __m128i load(const void* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+
+      /* 32-bit lane accumulators are flushed into 64-bit totals
+         before they can overflow. */
+      enum { BlockSize = 8192 };
+
+      long long sum(const unsigned char* data, int n)
+      {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i vSum = zero;
+        int i = 0;
+        for (; i+16 <= n; i += 16)
+          vSum = _mm_add_epi64(vSum, _mm_sad_epu8(load(data + i), zero));
+        return sum64(vSum) + sumInteger(data + i, n - i);
+      }
+
+      long long sum(const short* data, int n, short bias = 0)
+      {
+        const __m128i ones = _mm_set1_epi16(1), vBias = _mm_set1_epi16(bias);
+        long long iSum = 0;
+        int i = 0;
+        while (i+8 <= n)
+          {
+            __m128i vSum = _mm_setzero_si128();
+            for (int iEnd = qMin(n - 7, i + 8*BlockSize); i < iEnd; i += 8)
+              vSum = _mm_add_epi32(vSum, _mm_madd_epi16(_mm_xor_si128(load(data + i), vBias), ones));
+            iSum += sum32(vSum);
+          }
+        if (bias != 0)
+          {
+            iSum += (long long)i * 0x8000;
+            for (; i<n; ++i) iSum += (unsigned short)data[i];
+            return iSum;
+          }
+        return iSum + sumInteger(data + i, n - i);
+      }
+
+      long long sum(const unsigned short* data, int n)
+      {
+        return sum(reinterpret_cast<const short*>(data), n, short(0x8000));
+      }
+
+      long long sumOfSquares(const unsigned char* data, int n)
+      {
+        const __m128i zero = _mm_setzero_si128();
+        long long iSum = 0;
+        int i = 0;
+        while (i+16 <= n)
+          {
+            __m128i vSum = zero;
+            for (int iEnd = qMin(n - 15, i + 16*BlockSize); i < iEnd; i += 16)
+              {
+                __m128i vData = load(data + i);
+                __m128i vLow = _mm_unpacklo_epi8(vData, zero), vHigh = _mm_unpackhi_epi8(vData, zero);
+                vSum = _mm_add_epi32(vSum, _mm_add_epi32(_mm_madd_epi16(vLow, vLow),
+                                                         _mm_madd_epi16(vHigh, vHigh)));
+              }
+            iSum += sum32(vSum);
+          }
+        return iSum + sumOfSquaresInteger(data + i, n - i);
+      }
+
+      /* A pair of squared shorts may be 2^31, which overflows a
+         signed 32-bit lane. The lanes are treated as unsigned and
+         widened immediately. */
+      long long sumOfSquares(const short* data, int n)
+      {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i vSum = zero;
+        int i = 0;
+        for (; i+8 <= n; i += 8)
+          {
+            __m128i vData = load(data + i);
+            __m128i vSquares = _mm_madd_epi16(vData, vData);
+            vSum = _mm_add_epi64(vSum, _mm_add_epi64(_mm_unpacklo_epi32(vSquares, zero),
+                                                     _mm_unpackhi_epi32(vSquares, zero)));
+          }
+        return sum64(vSum) + sumOfSquaresInteger(data + i, n - i);
+      }
+
+      /* The absolute value of -32768 doesn't fit into a short but is
+         correct when interpreted as an unsigned short. */
+      long long absSum(const short* data, int n)
+      {
+        const __m128i zero = _mm_setzero_si128();
+        long long iSum = 0;
+        int i = 0;
+        while (i+8 <= n)
+          {
+            __m128i vSum = zero;
+            for (int iEnd = qMin(n - 7, i + 8*BlockSize); i < iEnd; i += 8)
+              {
+                __m128i vData = load(data + i);
+                __m128i vSign = _mm_srai_epi16(vData, 15);
+                __m128i vAbs = _mm_sub_epi16(_mm_xor_si128(vData, vSign), vSign);
+                vSum = _mm_add_epi32(vSum, _mm_add_epi32(_mm_unpacklo_epi16(vAbs, zero),
+                                                         _mm_unpackhi_epi16(vAbs, zero)));
+              }
+            iSum += sum32(vSum);
+          }
+        return iSum + absSumInteger(data + i, n - i);
+      }
+    }
+#endif
+
+#ifdef PII_REDUCTION_AVX
+    namespace Avx
+    {
+#  define PII_AVX PII_TARGET("avx")
+
+      template <class T> struct Ops;
+
+      template <> struct Ops<float>
+      {
+        typedef float T;
+        typedef __m256d Vec;
+        enum { Width = 4 };
+
+        PII_AVX static inline Vec zero() { return _mm256_setzero_pd(); }
+        PII_AVX static inline Vec set1(double value) { return _mm256_set1_pd(value); }
+        PII_AVX static inline Vec load(const float* data) { return _mm256_cvtps_pd(_mm_loadu_ps(data)); }
+        PII_AVX static inline Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        PII_AVX static inline Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        PII_AVX static inline Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        PII_AVX static inline Vec abs(Vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        PII_AVX static inline double sum(Vec a)
+        {
+          __m128d vSum = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+          return _mm_cvtsd_f64(_mm_add_sd(vSum, _mm_unpackhi_pd(vSum, vSum)));
+        }
+      };
+
+      template <> struct Ops<double> : Ops<float>
+      {
+        typedef double T;
+        PII_AVX static inline Vec load(const double* data) { return _mm256_loadu_pd(data); }
+      };
+
+      template <class T> struct MinMaxOps;
+
+      template <> struct MinMaxOps<float>
+      {
+        typedef float T;
+        typedef __m256 Vec;
+        enum { Width = 8 };
+
+        PII_AVX static inline Vec load(const T* data) { return _mm256_loadu_ps(data); }
+        PII_AVX static inline Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+        PII_AVX static inline Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        PII_AVX static inline T minimum(Vec a)
+        {
+          return Sse2::MinMaxOps<float>::minimum(_mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+        }
+        PII_AVX static inline T maximum(Vec a)
+        {
+          return Sse2::MinMaxOps<float>::maximum(_mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+        }
+      };
+
+      template <> struct MinMaxOps<double>
+      {
+        typedef double T;
+        typedef __m256d Vec;
+        enum { Width = 4 };
+
+        PII_AVX static inline Vec load(const T* data) { return _mm256_loadu_pd(data); }
+        PII_AVX static inline Vec min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+        PII_AVX static inline Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+        PII_AVX static inline T minimum(Vec a)
+        {
+          return Sse2::MinMaxOps<double>::minimum(_mm_min_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1)));
+        }
+        PII_AVX static inline T maximum(Vec a)
+        {
+          return Sse2::MinMaxOps<double>::maximum(_mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1)));
+        }
+      };
+
+      PII_REDUCTION_KERNELS(PII_AVX)
+
+#  undef PII_AVX
+    }
+#endif
+
+#ifdef PII_REDUCTION_NEON
+    namespace Neon
+    {
+      template <class T> struct MinMaxOps;
+
+#  define PII_NEON_MINMAX(TYPE, VEC, WIDTH, SUFFIX)                     \
+      template <> struct MinMaxOps<TYPE>                                \
+      {                                                                 \
+        typedef TYPE T;                                                 \
+        typedef VEC Vec;                                                \
+        enum { Width = WIDTH };                                         \
+                                                                        \
+        static inline Vec load(const T* data) { return vld1q_##SUFFIX(data); } \
+        static inline Vec min(Vec a, Vec b) { return vminq_##SUFFIX(a, b); } \
+        static inline Vec max(Vec a, Vec b) { return vmaxq_##SUFFIX(a, b); } \
+        static inline T minimum(Vec a)                                  \
+        {                                                               \
+          T aValues[Width];                                             \
+          vst1q_##SUFFIX(aValues, a);                                   \
+          T result = aValues[0];                                        \
+          for (int i=1; i<Width; ++i) result = qMin(result, aValues[i]); \
+          return result;                                                \
+        }                                                               \
+        static inline T maximum(Vec a)                                  \
+        {                                                               \
+          T aValues[Width];                                             \
+          vst1q_##SUFFIX(aValues, a);                                   \
+          T result = aValues[0];                                        \
+          for (int i=1; i<Width; ++i) result = qMax(result, aValues[i]); \
+          return result;                                                \
+        }                                                               \
+      }
+
+      PII_NEON_MINMAX(unsigned char, uint8x16_t, 16, u8);
+      PII_NEON_MINMAX(short, int16x8_t, 8, s16);
+      PII_NEON_MINMAX(unsigned short, uint16x8_t, 8, u16);
+      PII_NEON_MINMAX(float, float32x4_t, 4, f32);
+#  undef PII_NEON_MINMAX
+
+#  ifdef __aarch64__
+      template <class T> struct Ops;
+
+      template <> struct Ops<float>
+      {
+        typedef float T;
+        typedef float64x2_t Vec;
+        enum { Width = 2 };
+
+        static inline Vec zero() { return vdupq_n_f64(0); }
+        static inline Vec set1(double value) { return vdupq_n_f64(value); }
+        static inline Vec load(const float* data) { return vcvt_f64_f32(vld1_f32(data)); }
+        static inline Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+        static inline Vec mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+        static inline Vec abs(Vec a) { return vabsq_f64(a); }
+        static inline double sum(Vec a) { return vaddvq_f64(a); }
+      };
+
+      template <> struct Ops<double> : Ops<float>
+      {
+        typedef double T;
+        static inline Vec load(const double* data) { return vld1q_f64(data); }
+      };
+
+      template <> struct MinMaxOps<double>
+      {
+        typedef double T;
+        typedef float64x2_t Vec;
+        enum { Width = 2 };
+
+        static inline Vec load(const T* data) { return vld1q_f64(data); }
+        static inline Vec min(Vec a, Vec b) { return vminq_f64(a, b); }
+        static inline Vec max(Vec a, Vec b) { return vmaxq_f64(a, b); }
+        static inline T minimum(Vec a) { return vminvq_f64(a); }
+        static inline T maximum(Vec a) { return vmaxvq_f64(a); }
+      };
+#  endif
+
+      PII_REDUCTION_KERNELS()
+    }
+#endif
+
+#undef PII_REDUCTION_KERNELS
+
+    template <int mapping, class T> double reduce(const T* data, int n, double mean = 0.0)
+    {
+#if defined(PII_REDUCTION_AVX)
+      if (hasCpuFeature(CpuAvx2))
+        return Avx::reduce<mapping, Avx::Ops<T> >(data, n, mean);
+#endif
+#if defined(PII_REDUCTION_SSE2)
+      if (hasCpuFeature(CpuSse2))
+        return Sse2::reduce<mapping, Sse2::Ops<T> >(data, n, mean);
+#elif defined(PII_REDUCTION_NEON) && defined(__aarch64__)
+      if (hasCpuFeature(CpuNeon))
+        return Neon::reduce<mapping, Neon::Ops<T> >(data, n, mean);
+#endif
+      return Scalar::reduce<mapping, ScalarOps<T> >(data, n, mean);
+    }
+
+    template <class T> void minMaxDefault(const T* data, int n, T* min, T* max)
+    {
+#if defined(PII_REDUCTION_SSE2)
+      if (hasCpuFeature(CpuSse2))
+        return Sse2::minMax<Sse2::MinMaxOps<T> >(data, n, min, max);
+#elif defined(PII_REDUCTION_NEON)
+      if (hasCpuFeature(CpuNeon))
+        return Neon::minMax<Neon::MinMaxOps<T> >(data, n, min, max);
+#endif
+      Scalar::minMax<ScalarMinMaxOps<T> >(data, n, min, max);
+    }
+  }
+
+  long long sumN(const unsigned char* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::sum(data, n);
+#endif
+    return sumInteger(data, n);
+  }
+
+  long long sumN(const short* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::sum(data, n);
+#endif
+    return sumInteger(data, n);
+  }
+
+  long long sumN(const unsigned short* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::sum(data, n);
+#endif
+    return sumInteger(data, n);
+  }
+
+  double sumN(const float* data, int n) { return reduce<Identity>(data, n); }
+  double sumN(const double* data, int n) { return reduce<Identity>(data, n); }
+
+  long long sumOfSquaresN(const unsigned char* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::sumOfSquares(data, n);
+#endif
+    return sumOfSquaresInteger(data, n);
+  }
+
+  long long sumOfSquaresN(const short* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::sumOfSquares(data, n);
+#endif
+    return sumOfSquaresInteger(data, n);
+  }
+
+  long long sumOfSquaresN(const unsigned short* data, int n)
+  {
+    return sumOfSquaresInteger(data, n);
+  }
+
+  double sumOfSquaresN(const float* data, int n) { return reduce<Square>(data, n); }
+  double sumOfSquaresN(const double* data, int n) { return reduce<Square>(data, n); }
+
+  long long absSumN(const short* data, int n)
+  {
+#ifdef PII_REDUCTION_SSE2
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::absSum(data, n);
+#endif
+    return absSumInteger(data, n);
+  }
+
+  double absSumN(const float* data, int n) { return reduce<Absolute>(data, n); }
+  double absSumN(const double* data, int n) { return reduce<Absolute>(data, n); }
+
+  double squaredDeviationSumN(const float* data, int n, double mean) { return reduce<Deviation>(data, n, mean); }
+  double squaredDeviationSumN(const double* data, int n, double mean) { return reduce<Deviation>(data, n, mean); }
+
+  void minMaxN(const unsigned char* data, int n, unsigned char* min, unsigned char* max)
+  {
+    minMaxDefault(data, n, min, max);
+  }
+
+  void minMaxN(const short* data, int n, short* min, short* max)
+  {
+    minMaxDefault(data, n, min, max);
+  }
+
+  void minMaxN(const unsigned short* data, int n, unsigned short* min, unsigned short* max)
+  {
+    minMaxDefault(data, n, min, max);
+  }
+
+  void minMaxN(const float* data, int n, float* min, float* max)
+  {
+#if defined(PII_REDUCTION_AVX)
+    if (hasCpuFeature(CpuAvx2))
+      return Avx::minMax<Avx::MinMaxOps<float> >(data, n, min, max);
+#endif
+    minMaxDefault(data, n, min, max);
+  }
+
+  void minMaxN(const double* data, int n, double* min, double* max)
+  {
+#if defined(PII_REDUCTION_AVX)
+    if (hasCpuFeature(CpuAvx2))
+      return Avx::minMax<Avx::MinMaxOps<double> >(data, n, min, max);
+#endif
+#if defined(PII_REDUCTION_SSE2)
+    if (hasCpuFeature(CpuSse2))
+      return Sse2::minMax<Sse2::MinMaxOps<double> >(data, n, min, max);
+#elif defined(PII_REDUCTION_NEON) && defined(__aarch64__)
+    if (hasCpuFeature(CpuNeon))
+      return Neon::minMax<Neon::MinMaxOps<double> >(data, n, min, max);
+#endif
+    Scalar::minMax<ScalarMinMaxOps<double> >(data, n, min, max);
+  }
+}
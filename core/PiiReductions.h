@@ -0,0 +1,130 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIREDUCTIONS_H
+#define _PIIREDUCTIONS_H
+
+#include "PiiGlobal.h"
+
+/**
+ * @file
+ *
+ * Vectorized reductions over contiguous arrays. These functions are
+ * the building blocks of Pii::sum(), Pii::mean(), Pii::var(),
+ * Pii::minMax() and the norms in PiiMath. They are compiled
+ * separately for each supported instruction set, and the best one
+ * available on the running CPU is selected at run time (see
+ * Pii::cpuFeatures()).
+ *
+ * Integer sums are exact: the elements are accumulated into 64-bit
+ * integers. Floating-point elements are accumulated into doubles. The
+ * order of summation differs from a sequential loop, which makes
+ * the results of floating-point reductions differ from those of a
+ * naive loop by a few ulps.
+ *
+ * ~~~(c++)
+ * PiiMatrix<unsigned char> image(480, 640);
+ * long long iTotal = 0;
+ * for (int r=0; r<image.rows(); ++r)
+ *   iTotal += Pii::sumN(image[r], image.columns());
+ * ~~~
+ */
+
+namespace Pii
+{
+  /**
+   * Returns the sum of the *n* first elements of *data*.
+   */
+  PII_CORE_EXPORT long long sumN(const unsigned char* data, int n);
+  PII_CORE_EXPORT long long sumN(const short* data, int n);
+  PII_CORE_EXPORT long long sumN(const unsigned short* data, int n);
+  PII_CORE_EXPORT double sumN(const float* data, int n);
+  PII_CORE_EXPORT double sumN(const double* data, int n);
+
+  /**
+   * Returns the sum of squares of the *n* first elements of *data*.
+   */
+  PII_CORE_EXPORT long long sumOfSquaresN(const unsigned char* data, int n);
+  PII_CORE_EXPORT long long sumOfSquaresN(const short* data, int n);
+  PII_CORE_EXPORT long long sumOfSquaresN(const unsigned short* data, int n);
+  PII_CORE_EXPORT double sumOfSquaresN(const float* data, int n);
+  PII_CORE_EXPORT double sumOfSquaresN(const double* data, int n);
+
+  /**
+   * Returns the sum of the absolute values of the *n* first elements
+   * of *data*.
+   */
+  PII_CORE_EXPORT long long absSumN(const short* data, int n);
+  PII_CORE_EXPORT double absSumN(const float* data, int n);
+  PII_CORE_EXPORT double absSumN(const double* data, int n);
+
+  /**
+   * Returns the sum of squared differences between the *n* first
+   * elements of *data* and *mean*. This is the numerator in the
+   * two-pass variance algorithm.
+   */
+  PII_CORE_EXPORT double squaredDeviationSumN(const float* data, int n, double mean);
+  PII_CORE_EXPORT double squaredDeviationSumN(const double* data, int n, double mean);
+
+  /**
+   * Finds the smallest and the largest of the *n* first elements of
+   * *data*. *n* must be at least one. If the data contains NaNs, the
+   * result is undefined.
+   */
+  PII_CORE_EXPORT void minMaxN(const unsigned char* data, int n, unsigned char* min, unsigned char* max);
+  PII_CORE_EXPORT void minMaxN(const short* data, int n, short* min, short* max);
+  PII_CORE_EXPORT void minMaxN(const unsigned short* data, int n, unsigned short* min, unsigned short* max);
+  PII_CORE_EXPORT void minMaxN(const float* data, int n, float* min, float* max);
+  PII_CORE_EXPORT void minMaxN(const double* data, int n, double* min, double* max);
+
+  /// @hide
+  /* Tells which element types have vectorized reductions and the
+     types their sums accumulate into.
+   */
+  template <class T> struct ReductionTraits
+  {
+    enum { supported = false, integer = false };
+    typedef T SumType;
+  };
+
+  template <> struct ReductionTraits<unsigned char>
+  {
+    enum { supported = true, integer = true };
+    typedef long long SumType;
+  };
+  template <> struct ReductionTraits<short>
+  {
+    enum { supported = true, integer = true };
+    typedef long long SumType;
+  };
+  template <> struct ReductionTraits<unsigned short>
+  {
+    enum { supported = true, integer = true };
+    typedef long long SumType;
+  };
+  template <> struct ReductionTraits<float>
+  {
+    enum { supported = true, integer = false };
+    typedef double SumType;
+  };
+  template <> struct ReductionTraits<double>
+  {
+    enum { supported = true, integer = false };
+    typedef double SumType;
+  };
+  /// @endhide
+}
+
+#endif //_PIIREDUCTIONS_H
@@ -15,6 +15,9 @@
 
 #include "PiiResourceDatabase.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace Pii
 {
   Subject subject;
@@ -23,6 +26,19 @@ namespace Pii
   Attribute attribute("");
   ResourceType resourceType;
   StatementId statementId;
+
+  QList<int> uniteResourceIds(const QList<int>& ids1, const QList<int>& ids2)
+  {
+    if (ids1.isEmpty())
+      return ids2;
+    if (ids2.isEmpty())
+      return ids1;
+    QList<int> lstResult;
+    lstResult.reserve(ids1.size() + ids2.size());
+    std::set_union(ids1.begin(), ids1.end(), ids2.begin(), ids2.end(),
+                   std::back_inserter(lstResult));
+    return lstResult;
+  }
 }
 
 PiiResourceDatabase::PiiResourceDatabase() :
@@ -77,7 +93,34 @@ PiiResourceStatement PiiResourceDatabase::literal(int subject, const QString& pr
 int PiiResourceDatabase::generateId()
 {
   // PENDING overflow handling
-  return d->lstStatements.size() > 0 ? d->lstStatements.back().id() + 1 : 0;
+  return d->mapStatements.size() > 0 ? d->mapStatements.lastKey() + 1 : 0;
+}
+
+void PiiResourceDatabase::index(const PiiResourceStatement& statement)
+{
+  // Ids grow monotonically, which keeps the index lists sorted.
+  d->aIndices[SubjectIndex][statement.subject()].append(statement.id());
+  d->aIndices[PredicateIndex][statement.predicate()].append(statement.id());
+  d->aIndices[ObjectIndex][statement.object()].append(statement.id());
+}
+
+void PiiResourceDatabase::unindex(const PiiResourceStatement& statement)
+{
+  const QString aKeys[IndexedFieldCount] = { statement.subject(), statement.predicate(), statement.object() };
+  for (int i=0; i<IndexedFieldCount; ++i)
+    {
+      QHash<QString, QList<int> >::iterator it = d->aIndices[i].find(aKeys[i]);
+      if (it == d->aIndices[i].end())
+        continue;
+      it.value().removeOne(statement.id());
+      if (it.value().isEmpty())
+        d->aIndices[i].erase(it);
+    }
+}
+
+QList<int> PiiResourceDatabase::indexedStatements(IndexedField field, const QString& value) const
+{
+  return d->aIndices[field].value(value);
 }
 
 int PiiResourceDatabase::addStatement(const PiiResourceStatement& statement)
@@ -85,7 +128,8 @@ int PiiResourceDatabase::addStatement(const PiiResourceStatement& statement)
   PiiResourceStatement copy(statement);
   int id = generateId();
   copy.setId(id);
-  d->lstStatements.push_back(copy);
+  d->mapStatements.insert(id, copy);
+  index(copy);
   return id;
 }
 
@@ -122,39 +166,38 @@ void PiiResourceDatabase::removeStatements(const QList<int>& ids)
 
 void PiiResourceDatabase::removeStatement(int id)
 {
-  for (int i=0; i<d->lstStatements.size(); ++i)
+  StatementMap::iterator i = d->mapStatements.find(id);
+  if (i != d->mapStatements.end())
     {
-      if (d->lstStatements[i].id() == id)
-        {
-          d->lstStatements.removeAt(i);
-          return;
-        }
+      unindex(i.value());
+      d->mapStatements.erase(i);
     }
 }
 
 QList<PiiResourceStatement> PiiResourceDatabase::statements() const
 {
-  return d->lstStatements;
+  return d->mapStatements.values();
 }
 
 int PiiResourceDatabase::statementCount() const
 {
-  return d->lstStatements.size();
+  return d->mapStatements.size();
 }
 
 void PiiResourceDatabase::dump() const
 {
-  for (int i=0; i<d->lstStatements.size(); ++i)
+  for (StatementMap::const_iterator i=d->mapStatements.constBegin(); i != d->mapStatements.constEnd(); ++i)
     {
+      const PiiResourceStatement& statement = i.value();
       QString strStatement("(%1, %2, %4) #%3");
       strStatement = strStatement
-        .arg(d->lstStatements[i].subject())
-        .arg(d->lstStatements[i].predicate())
-        .arg(d->lstStatements[i].id());
-      if (d->lstStatements[i].type() == PiiResourceStatement::Literal)
-        strStatement = strStatement.arg(QString("\"%1\"").arg(d->lstStatements[i].object()));
+        .arg(statement.subject())
+        .arg(statement.predicate())
+        .arg(statement.id());
+      if (statement.type() == PiiResourceStatement::Literal)
+        strStatement = strStatement.arg(QString("\"%1\"").arg(statement.object()));
       else
-        strStatement = strStatement.arg(d->lstStatements[i].object());
+        strStatement = strStatement.arg(statement.object());
       piiWarning("%s", piiPrintable(strStatement));
     }
 }
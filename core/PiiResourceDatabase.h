@@ -24,6 +24,8 @@
 #endif
 
 #include <QStringList>
+#include <QHash>
+#include <QMap>
 
 #include <functional>
 
@@ -68,6 +70,12 @@
  * *reify* statements in RDF style. In RDF terminology, reification
  * means staments about statements. Resource ids of the form "[123]"
  * (a hash followed by an integer) are reserved for statements.
+ *
+ * The database keeps hash indices on the subjects, predicates and
+ * objects of statements. Queries whose filter compares one of these
+ * fields for equality (possibly combined with other conditions using
+ * the logical AND and OR operators) only test the statements found
+ * in the index. Other filters test all statements.
  */
 class PII_CORE_EXPORT PiiResourceDatabase
 {
@@ -264,50 +272,40 @@ public:
    */
   void dump() const;
 
+  /// @internal
+  enum IndexedField { SubjectIndex, PredicateIndex, ObjectIndex };
+  enum { IndexedFieldCount = 3 };
+
+  /**
+   * Returns the ids of the statements whose *field* is equal to
+   * *value* in ascending order.
+   *
+   * @internal
+   */
+  QList<int> indexedStatements(IndexedField field, const QString& value) const;
+
 private:
+  typedef QMap<int, PiiResourceStatement> StatementMap;
+
   class Data
   {
   public:
-    QList<PiiResourceStatement> lstStatements;
+    // Keyed by statement id, which is also the order of insertion.
+    StatementMap mapStatements;
+    // Maps subjects, predicates and objects to statement ids.
+    QHash<QString, QList<int> > aIndices[IndexedFieldCount];
   } *d;
 
   int generateId();
+  void index(const PiiResourceStatement& statement);
+  void unindex(const PiiResourceStatement& statement);
+  // Calls function(statement) for each statement that matches
+  // filter until function returns false.
+  template <class Filter, class Function> void forEachMatch(Filter& filter, Function& function) const;
 
   PII_DISABLE_COPY(PiiResourceDatabase);
 };
 
-template <class Filter> QList<PiiResourceStatement> PiiResourceDatabase::select(Filter filter) const
-{
-  QList<PiiResourceStatement> lstResult;
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      lstResult.push_back(d->lstStatements[i]);
-  return lstResult;
-}
-
-template <class Selector, class Filter>
-QList<typename Selector::ValueType> PiiResourceDatabase::select(Selector selector, Filter filter) const
-{
-  typedef typename Selector::ValueType ValueType;
-  QList<ValueType> lstResult;
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      {
-        ValueType selected = selector(d->lstStatements[i]);
-        if (!lstResult.contains(selected))
-          lstResult.push_back(selected);
-      }
-  return lstResult;
-}
-
-template <class Filter> int PiiResourceDatabase::findFirst(Filter filter) const
-{
-  for (int i=0; i<d->lstStatements.size(); ++i)
-    if (filter(d->lstStatements[i]))
-      return d->lstStatements[i].id();
-  return -1;
-}
-
 /// @hide
 namespace Pii
 {
@@ -612,4 +610,193 @@ namespace Pii
 }
 /// @endhide
 
+/// @hide
+namespace Pii
+{
+  /* Index lookups. Each function stores the ids of the statements
+     that may match a filter into ids in ascending order and returns
+     true. If the index cannot be used with the filter, false is
+     returned and all statements need to be tested.
+   */
+  template <class Filter> inline bool resourceCandidates(const PiiResourceDatabase*, const Filter&, QList<int>&)
+  {
+    return false;
+  }
+
+  inline bool resourceCandidates(const PiiResourceDatabase* db,
+                                 const ResourceFilter<Subject, std::equal_to<QString> >& filter,
+                                 QList<int>& ids)
+  {
+    ids = db->indexedStatements(PiiResourceDatabase::SubjectIndex, filter.value);
+    return true;
+  }
+
+  inline bool resourceCandidates(const PiiResourceDatabase* db,
+                                 const ResourceFilter<Predicate, std::equal_to<QString> >& filter,
+                                 QList<int>& ids)
+  {
+    ids = db->indexedStatements(PiiResourceDatabase::PredicateIndex, filter.value);
+    return true;
+  }
+
+  inline bool resourceCandidates(const PiiResourceDatabase* db,
+                                 const ResourceFilter<Object, std::equal_to<QString> >& filter,
+                                 QList<int>& ids)
+  {
+    ids = db->indexedStatements(PiiResourceDatabase::ObjectIndex, filter.value);
+    return true;
+  }
+
+  // attribute("name") == value matches both predicate and object.
+  // The shorter list is enough.
+  inline bool resourceCandidates(const PiiResourceDatabase* db,
+                                 const ResourceFilter<Attribute, std::equal_to<QString> >& filter,
+                                 QList<int>& ids)
+  {
+    QList<int> lstPredicates(db->indexedStatements(PiiResourceDatabase::PredicateIndex, filter.select.strPredicate));
+    if (lstPredicates.isEmpty())
+      ids = lstPredicates;
+    else
+      {
+        QList<int> lstObjects(db->indexedStatements(PiiResourceDatabase::ObjectIndex, filter.value));
+        ids = lstObjects.size() < lstPredicates.size() ? lstObjects : lstPredicates;
+      }
+    return true;
+  }
+
+  PII_CORE_EXPORT QList<int> uniteResourceIds(const QList<int>& ids1, const QList<int>& ids2);
+
+  template <class Selector>
+  bool resourceCandidates(const PiiResourceDatabase* db,
+                          const MatchListFilter<Selector, std::equal_to<QString> >& filter,
+                          QList<int>& ids)
+  {
+    ids.clear();
+    for (int i=0; i<filter.lstValues.size(); ++i)
+      {
+        QList<int> lstIds;
+        if (!resourceCandidates(db, filter.select == filter.lstValues[i], lstIds))
+          return false;
+        ids = uniteResourceIds(ids, lstIds);
+      }
+    return true;
+  }
+
+  template <class Filter1, class Filter2>
+  bool resourceCandidates(const PiiResourceDatabase* db,
+                          const ComposeFilter<std::logical_and<bool>, Filter1, Filter2>& filter,
+                          QList<int>& ids)
+  {
+    QList<int> lstIds1, lstIds2;
+    bool bIndexed1 = resourceCandidates(db, filter.filter1, lstIds1);
+    if (bIndexed1 && lstIds1.isEmpty())
+      {
+        ids = lstIds1;
+        return true;
+      }
+    bool bIndexed2 = resourceCandidates(db, filter.filter2, lstIds2);
+    if (bIndexed1 && (!bIndexed2 || lstIds1.size() <= lstIds2.size()))
+      ids = lstIds1;
+    else if (bIndexed2)
+      ids = lstIds2;
+    else
+      return false;
+    return true;
+  }
+
+  template <class Filter1, class Filter2>
+  bool resourceCandidates(const PiiResourceDatabase* db,
+                          const ComposeFilter<std::logical_or<bool>, Filter1, Filter2>& filter,
+                          QList<int>& ids)
+  {
+    QList<int> lstIds1, lstIds2;
+    if (!resourceCandidates(db, filter.filter1, lstIds1) ||
+        !resourceCandidates(db, filter.filter2, lstIds2))
+      return false;
+    ids = uniteResourceIds(lstIds1, lstIds2);
+    return true;
+  }
+
+  // Function objects for PiiResourceDatabase::forEachMatch().
+  struct ResourceStatementCollector
+  {
+    bool operator() (const PiiResourceStatement& statement)
+    {
+      lstResult.push_back(statement);
+      return true;
+    }
+    QList<PiiResourceStatement> lstResult;
+  };
+
+  template <class Selector> struct ResourceValueCollector
+  {
+    typedef typename Selector::ValueType ValueType;
+    ResourceValueCollector(const Selector& s) : select(s) {}
+    bool operator() (const PiiResourceStatement& statement)
+    {
+      ValueType selected = select(statement);
+      if (!lstResult.contains(selected))
+        lstResult.push_back(selected);
+      return true;
+    }
+    const Selector& select;
+    QList<ValueType> lstResult;
+  };
+
+  struct ResourceIdFinder
+  {
+    ResourceIdFinder() : iId(-1) {}
+    bool operator() (const PiiResourceStatement& statement)
+    {
+      iId = statement.id();
+      return false;
+    }
+    int iId;
+  };
+}
+/// @endhide
+
+template <class Filter, class Function>
+void PiiResourceDatabase::forEachMatch(Filter& filter, Function& function) const
+{
+  QList<int> lstCandidates;
+  if (Pii::resourceCandidates(this, filter, lstCandidates))
+    {
+      for (int i=0; i<lstCandidates.size(); ++i)
+        {
+          const PiiResourceStatement& statement = d->mapStatements.constFind(lstCandidates[i]).value();
+          if (filter(statement) && !function(statement))
+            return;
+        }
+    }
+  else
+    {
+      for (StatementMap::const_iterator i=d->mapStatements.constBegin(); i != d->mapStatements.constEnd(); ++i)
+        if (filter(i.value()) && !function(i.value()))
+          return;
+    }
+}
+
+template <class Filter> QList<PiiResourceStatement> PiiResourceDatabase::select(Filter filter) const
+{
+  Pii::ResourceStatementCollector collector;
+  forEachMatch(filter, collector);
+  return collector.lstResult;
+}
+
+template <class Selector, class Filter>
+QList<typename Selector::ValueType> PiiResourceDatabase::select(Selector selector, Filter filter) const
+{
+  Pii::ResourceValueCollector<Selector> collector(selector);
+  forEachMatch(filter, collector);
+  return collector.lstResult;
+}
+
+template <class Filter> int PiiResourceDatabase::findFirst(Filter filter) const
+{
+  Pii::ResourceIdFinder finder;
+  forEachMatch(filter, finder);
+  return finder.iId;
+}
+
 #endif //_PIIRESOURCEDATABASE_H
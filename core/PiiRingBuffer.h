@@ -0,0 +1,167 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRINGBUFFER_H
+#define _PIIRINGBUFFER_H
+
+#include "PiiAtomicInt.h"
+
+/**
+ * A bounded, lock-free single-producer/single-consumer queue. One
+ * thread may put objects to the tail of the queue while another one
+ * simultaneously reads and removes objects at the head. No locks are
+ * needed as long as each side is accessed by at most one thread at a
+ * time.
+ *
+ * Unlike typical FIFO queues, PiiRingBuffer gives the consumer random
+ * access to all objects currently in the queue. The consumer may also
+ * reorder the queued objects. The producer only writes to the empty
+ * slot after the tail. Therefore, rearranging the occupied slots
+ * doesn't interfere with it.
+ *
+ * ~~~(c++)
+ * PiiRingBuffer<int> buffer(4);
+ *
+ * // Producer thread
+ * if (!buffer.isFull())
+ *   buffer.append(1);
+ *
+ * // Consumer thread
+ * while (!buffer.isEmpty())
+ *   doSomethingWith(buffer.takeFirst());
+ * ~~~
+ */
+template <class T> class PiiRingBuffer
+{
+public:
+  /**
+   * Creates a ring buffer that can hold at most *capacity* objects.
+   */
+  PiiRingBuffer(int capacity = 1) :
+    _pData(0), _iCapacity(0)
+  {
+    setCapacity(capacity);
+  }
+
+  ~PiiRingBuffer()
+  {
+    delete[] _pData;
+  }
+
+  /**
+   * Changes the capacity of the buffer. All queued objects will be
+   * destroyed. This function is not thread-safe.
+   */
+  void setCapacity(int capacity)
+  {
+    if (capacity < 1) capacity = 1;
+    delete[] _pData;
+    _pData = new T[capacity];
+    _iCapacity = capacity;
+    _iHead.store(0);
+    _iTail.store(0);
+  }
+
+  /**
+   * Returns the maximum number of objects in the buffer.
+   */
+  int capacity() const { return _iCapacity; }
+
+  /**
+   * Destroys all queued objects. This function is not thread-safe.
+   */
+  void clear()
+  {
+    for (int i=0; i<_iCapacity; ++i)
+      _pData[i] = T();
+    _iHead.store(0);
+    _iTail.store(0);
+  }
+
+  /**
+   * Returns the number of objects in the queue. The value is exact
+   * if called by either the producer or the consumer. From the
+   * producer's point of view, the queue may actually be shorter, and
+   * from the consumer's point of view longer.
+   */
+  int size() const
+  {
+    return distance(_iHead.loadAcquire(), _iTail.loadAcquire());
+  }
+
+  bool isEmpty() const { return size() == 0; }
+
+  /**
+   * Returns `true` if the queue is full. This function is intended
+   * to be called by the producer.
+   */
+  bool isFull() const
+  {
+    return distance(_iHead.loadAcquire(), _iTail.load()) >= _iCapacity;
+  }
+
+  /**
+   * Adds *value* to the tail of the queue. The caller (the producer)
+   * must make sure the queue is not full.
+   */
+  void append(const T& value)
+  {
+    int iTail = _iTail.load();
+    _pData[iTail % _iCapacity] = value;
+    // Publish the new object to the consumer.
+    _iTail.storeRelease(advance(iTail, 1));
+  }
+
+  /**
+   * Returns a reference to the object at *index*, counting from the
+   * head of the queue. Only the consumer may call this function, and
+   * *index* must be less than size().
+   */
+  T& operator[] (int index) { return _pData[advance(_iHead.load(), index) % _iCapacity]; }
+  const T& operator[] (int index) const { return _pData[advance(_iHead.load(), index) % _iCapacity]; }
+
+  /**
+   * Removes the object at the head of the queue and returns it. Only
+   * the consumer may call this function, and the queue must not be
+   * empty.
+   */
+  T takeFirst()
+  {
+    int iHead = _iHead.load();
+    T* pSlot = _pData + iHead % _iCapacity;
+    T value(*pSlot);
+    // Release the reference before the slot is handed back to the
+    // producer.
+    *pSlot = T();
+    _iHead.storeRelease(advance(iHead, 1));
+    return value;
+  }
+
+private:
+  PiiRingBuffer(const PiiRingBuffer&);
+  PiiRingBuffer& operator= (const PiiRingBuffer&);
+
+  // Indices run from 0 to 2*capacity-1. This makes it possible to
+  // distinguish between a full and an empty buffer without sharing a
+  // counter between the producer and the consumer.
+  int advance(int index, int steps) const { return (index + steps) % (2*_iCapacity); }
+  int distance(int head, int tail) const { return (tail - head + 2*_iCapacity) % (2*_iCapacity); }
+
+  T* _pData;
+  int _iCapacity;
+  PiiAtomicInt _iHead, _iTail;
+};
+
+#endif //_PIIRINGBUFFER_H
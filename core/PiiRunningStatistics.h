@@ -0,0 +1,378 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRUNNINGSTATISTICS_H
+#define _PIIRUNNINGSTATISTICS_H
+
+#include "PiiMatrix.h"
+#include "PiiInvalidArgumentException.h"
+
+#include <QList>
+
+/**
+ * @file
+ *
+ * Accumulators for statistics over a stream of values. Each
+ * accumulator is updated in constant time when a value enters or
+ * leaves a window, which makes moving statistics independent of the
+ * window size. The sums and variances also work element-wise on
+ * matrices.
+ */
+
+namespace Pii
+{
+  /**
+   * Adds *value* to *sum* using Kahan's compensated summation.
+   * *compensation* keeps the negated low-order bits lost in the
+   * addition and must be zero initially. The effective sum is `sum -
+   * compensation`. Adding a negative value removes it from the sum
+   * without accumulating rounding errors, which makes the function
+   * suitable for sliding windows. Note that aggressive floating-point
+   * optimizations (such as -ffast-math) may remove the compensation.
+   */
+  template <class T> inline void compensatedAdd(T& sum, T& compensation, T value)
+  {
+    T y = value - compensation;
+    T t = sum + y;
+    compensation = (t - sum) - y;
+    sum = t;
+  }
+}
+
+/**
+ * A compensated running sum. In addition to real and complex
+ * scalars, *T* may be a PiiMatrix, in which case the sum is
+ * calculated element-wise. The first added matrix fixes the size of
+ * the sum.
+ *
+ * ~~~(c++)
+ * PiiRunningSum<double> sum;
+ * for (int i=0; i<1000000; ++i)
+ *   sum.add(0.1);
+ * for (int i=0; i<999999; ++i)
+ *   sum.remove(0.1);
+ * // sum.sum() is 0.1 to full precision
+ * ~~~
+ */
+template <class T> class PiiRunningSum
+{
+public:
+  PiiRunningSum() : _sum(0), _compensation(0), _iCount(0) {}
+
+  /**
+   * Adds *value* to the sum.
+   */
+  void add(T value) { Pii::compensatedAdd(_sum, _compensation, value); ++_iCount; }
+  /**
+   * Removes a previously added *value* from the sum.
+   */
+  void remove(T value) { Pii::compensatedAdd(_sum, _compensation, T(-value)); --_iCount; }
+  /**
+   * Returns the sum of the values currently in the accumulator.
+   */
+  T sum() const { return _sum - _compensation; }
+  /**
+   * Returns the mean of the values currently in the accumulator, or
+   * zero if there are none.
+   */
+  T mean() const { return _iCount > 0 ? T(sum() / T(_iCount)) : T(0); }
+  /**
+   * Returns the number of values in the accumulator.
+   */
+  int count() const { return _iCount; }
+  /**
+   * Resets the sum to zero.
+   */
+  void clear() { _sum = _compensation = T(0); _iCount = 0; }
+
+private:
+  T _sum, _compensation;
+  int _iCount;
+};
+
+template <class T> class PiiRunningSum<PiiMatrix<T> >
+{
+public:
+  PiiRunningSum() : _iCount(0) {}
+
+  /**
+   * Adds *values* to the sum element-wise.
+   *
+   * @exception PiiInvalidArgumentException& if the size of *values*
+   * differs from that of the previously added matrices.
+   */
+  void add(const PiiMatrix<T>& values) { update(values, 1); }
+  void remove(const PiiMatrix<T>& values) { update(values, -1); }
+  PiiMatrix<T> sum() const { return PiiMatrix<T>(_matSum - _matCompensation); }
+  PiiMatrix<T> mean() const { return _iCount > 0 ? PiiMatrix<T>(sum() / T(_iCount)) : sum(); }
+  int count() const { return _iCount; }
+  void clear() { _matSum = _matCompensation = PiiMatrix<T>(); _iCount = 0; }
+
+private:
+  void update(const PiiMatrix<T>& values, int sign)
+  {
+    if (_matSum.isEmpty())
+      {
+        _matSum = PiiMatrix<T>(values.rows(), values.columns());
+        _matCompensation = PiiMatrix<T>(values.rows(), values.columns());
+      }
+    else if (values.rows() != _matSum.rows() || values.columns() != _matSum.columns())
+      PII_MATRIX_SIZE_MISMATCH;
+
+    for (int r=0; r<values.rows(); ++r)
+      {
+        const T* pValues = values[r];
+        T* pSum = _matSum[r];
+        T* pCompensation = _matCompensation[r];
+        if (sign > 0)
+          for (int c=0; c<values.columns(); ++c)
+            Pii::compensatedAdd(pSum[c], pCompensation[c], pValues[c]);
+        else
+          for (int c=0; c<values.columns(); ++c)
+            Pii::compensatedAdd(pSum[c], pCompensation[c], T(-pValues[c]));
+      }
+    _iCount += sign;
+  }
+
+  PiiMatrix<T> _matSum, _matCompensation;
+  int _iCount;
+};
+
+/**
+ * A running mean and variance calculated with Welford's algorithm.
+ * Unlike the textbook formula based on the sum of squares, Welford's
+ * update doesn't suffer from catastrophic cancellation when the
+ * variance is small compared to the mean. Values can also be
+ * removed, which makes the accumulator suitable for sliding windows.
+ * *T* must be a real type or a PiiMatrix of one, in which case the
+ * statistics are calculated element-wise.
+ */
+template <class T> class PiiRunningVariance
+{
+public:
+  PiiRunningVariance() : _mean(0), _m2(0), _iCount(0) {}
+
+  /**
+   * Adds *value* to the statistics.
+   */
+  void add(T value)
+  {
+    ++_iCount;
+    T delta = value - _mean;
+    _mean += delta / _iCount;
+    _m2 += delta * (value - _mean);
+  }
+
+  /**
+   * Removes a previously added *value* from the statistics.
+   */
+  void remove(T value)
+  {
+    if (_iCount <= 1)
+      {
+        clear();
+        return;
+      }
+    T delta = value - _mean;
+    _mean -= delta / (_iCount - 1);
+    _m2 -= delta * (value - _mean);
+    if (_m2 < 0)
+      _m2 = 0;
+    --_iCount;
+  }
+
+  /**
+   * Returns the mean of the values currently in the statistics.
+   */
+  T mean() const { return _mean; }
+  /**
+   * Returns the population variance (the sum of squared deviations
+   * divided by count()), or zero if there are no values.
+   */
+  T variance() const { return _iCount > 0 ? T(_m2 / _iCount) : T(0); }
+  /**
+   * Returns the sample variance (the sum of squared deviations
+   * divided by count() - 1), or zero if there are less than two
+   * values.
+   */
+  T sampleVariance() const { return _iCount > 1 ? T(_m2 / (_iCount - 1)) : T(0); }
+  int count() const { return _iCount; }
+  void clear() { _mean = _m2 = T(0); _iCount = 0; }
+
+private:
+  T _mean, _m2;
+  int _iCount;
+};
+
+template <class T> class PiiRunningVariance<PiiMatrix<T> >
+{
+public:
+  PiiRunningVariance() : _iCount(0) {}
+
+  /**
+   * Adds *values* to the statistics element-wise.
+   *
+   * @exception PiiInvalidArgumentException& if the size of *values*
+   * differs from that of the previously added matrices.
+   */
+  void add(const PiiMatrix<T>& values)
+  {
+    if (_matMean.isEmpty())
+      {
+        _matMean = PiiMatrix<T>(values.rows(), values.columns());
+        _matM2 = PiiMatrix<T>(values.rows(), values.columns());
+      }
+    else if (values.rows() != _matMean.rows() || values.columns() != _matMean.columns())
+      PII_MATRIX_SIZE_MISMATCH;
+
+    ++_iCount;
+    const T scale = T(1) / _iCount;
+    for (int r=0; r<values.rows(); ++r)
+      {
+        const T* pValues = values[r];
+        T* pMean = _matMean[r];
+        T* pM2 = _matM2[r];
+        for (int c=0; c<values.columns(); ++c)
+          {
+            T delta = pValues[c] - pMean[c];
+            pMean[c] += delta * scale;
+            pM2[c] += delta * (pValues[c] - pMean[c]);
+          }
+      }
+  }
+
+  void remove(const PiiMatrix<T>& values)
+  {
+    if (_iCount <= 1)
+      {
+        clear();
+        return;
+      }
+    if (values.rows() != _matMean.rows() || values.columns() != _matMean.columns())
+      PII_MATRIX_SIZE_MISMATCH;
+
+    const T scale = T(1) / (_iCount - 1);
+    for (int r=0; r<values.rows(); ++r)
+      {
+        const T* pValues = values[r];
+        T* pMean = _matMean[r];
+        T* pM2 = _matM2[r];
+        for (int c=0; c<values.columns(); ++c)
+          {
+            T delta = pValues[c] - pMean[c];
+            pMean[c] -= delta * scale;
+            pM2[c] -= delta * (pValues[c] - pMean[c]);
+            if (pM2[c] < 0)
+              pM2[c] = 0;
+          }
+      }
+    --_iCount;
+  }
+
+  PiiMatrix<T> mean() const { return _matMean; }
+  PiiMatrix<T> variance() const { return _iCount > 0 ? PiiMatrix<T>(_matM2 / T(_iCount)) : _matM2; }
+  PiiMatrix<T> sampleVariance() const { return _iCount > 1 ? PiiMatrix<T>(_matM2 / T(_iCount - 1)) : PiiMatrix<T>(_matM2.rows(), _matM2.columns()); }
+  int count() const { return _iCount; }
+  void clear() { _matMean = _matM2 = PiiMatrix<T>(); _iCount = 0; }
+
+private:
+  PiiMatrix<T> _matMean, _matM2;
+  int _iCount;
+};
+
+/**
+ * The minimum and maximum over a sliding window of the last N
+ * values. Both extrema are maintained with monotonic queues: a value
+ * that can never become the minimum (maximum) because a smaller
+ * (larger) one arrived after it is dropped immediately. Each value
+ * enters and leaves the queues once, and the amortized cost of add()
+ * is therefore constant regardless of the window size.
+ *
+ * ~~~(c++)
+ * PiiSlidingExtrema<int> extrema(3);
+ * extrema.add(5);
+ * extrema.add(1);
+ * extrema.add(4);
+ * extrema.add(3); // 5 leaves the window
+ * // extrema.minimum() == 1, extrema.maximum() == 4
+ * ~~~
+ */
+template <class T> class PiiSlidingExtrema
+{
+public:
+  /**
+   * Creates an empty window that holds at most *windowSize* values.
+   */
+  PiiSlidingExtrema(int windowSize = 1) :
+    _iWindowSize(qMax(1, windowSize)), _iIndex(0)
+  {}
+
+  /**
+   * Changes the size of the window and removes all values.
+   */
+  void setWindowSize(int windowSize) { _iWindowSize = qMax(1, windowSize); clear(); }
+  int windowSize() const { return _iWindowSize; }
+
+  /**
+   * Adds *value* to the window. If the window is full, the oldest
+   * value leaves it.
+   */
+  void add(T value)
+  {
+    while (!_lstMinima.isEmpty() && !(_lstMinima.last().value < value))
+      _lstMinima.removeLast();
+    _lstMinima.append(Entry(_iIndex, value));
+    while (!_lstMaxima.isEmpty() && !(value < _lstMaxima.last().value))
+      _lstMaxima.removeLast();
+    _lstMaxima.append(Entry(_iIndex, value));
+    ++_iIndex;
+
+    const qint64 iOldest = _iIndex - _iWindowSize;
+    if (_lstMinima.first().iIndex < iOldest)
+      _lstMinima.removeFirst();
+    if (_lstMaxima.first().iIndex < iOldest)
+      _lstMaxima.removeFirst();
+  }
+
+  /**
+   * Returns the smallest value in the window. The window must not be
+   * empty.
+   */
+  T minimum() const { return _lstMinima.first().value; }
+  /**
+   * Returns the largest value in the window. The window must not be
+   * empty.
+   */
+  T maximum() const { return _lstMaxima.first().value; }
+  /**
+   * Returns the number of values in the window.
+   */
+  int count() const { return int(qMin(_iIndex, qint64(_iWindowSize))); }
+  bool isEmpty() const { return _iIndex == 0; }
+  void clear() { _lstMinima.clear(); _lstMaxima.clear(); _iIndex = 0; }
+
+private:
+  struct Entry
+  {
+    Entry(qint64 index = 0, T v = T()) : iIndex(index), value(v) {}
+    qint64 iIndex;
+    T value;
+  };
+  int _iWindowSize;
+  qint64 _iIndex;
+  QList<Entry> _lstMinima, _lstMaxima;
+};
+
+#endif //_PIIRUNNINGSTATISTICS_H
@@ -0,0 +1,346 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiSmallObjectAllocator.h"
+#include "PiiSimpleMemoryManager.h"
+#include "PiiSynchronized.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <cstdlib>
+
+/* Size classes
+ *
+ * Class N holds blocks of 16*(N+1) - sizeof(void*) bytes. Each slab
+ * is a PiiSimpleMemoryManager whose blocks exactly fill 16*(N+1)
+ * bytes, so no memory is wasted in alignment. Blocks are carved from
+ * the newest slab of a class only when its free list is empty, and
+ * they are never returned to the slab. Free blocks are linked through
+ * their first bytes.
+ *
+ * Each thread caches free blocks for each class. An empty cache is
+ * refilled with BatchSize blocks from the shared list. Once a cache
+ * holds more than ThreadCacheDepth blocks, BatchSize blocks are
+ * moved back. Each class in the shared pool has its own mutex.
+ *
+ * The shared pool is never destroyed because objects may still be
+ * released during static destruction. For the same reason, a thread
+ * whose cache has already been destroyed uses the shared pool
+ * directly.
+ */
+
+namespace
+{
+  enum
+  {
+    BatchSize = 32,
+    ThreadCacheDepth = 2 * BatchSize
+  };
+
+  struct FreeBlock
+  {
+    FreeBlock* pNext;
+  };
+
+  struct FreeList
+  {
+    FreeList() : pHead(0), iCount(0) {}
+
+    void push(void* buffer)
+    {
+      FreeBlock* pBlock = static_cast<FreeBlock*>(buffer);
+      pBlock->pNext = pHead;
+      pHead = pBlock;
+      ++iCount;
+    }
+
+    void* pop()
+    {
+      FreeBlock* pBlock = pHead;
+      if (pBlock != 0)
+        {
+          pHead = pBlock->pNext;
+          --iCount;
+        }
+      return pBlock;
+    }
+
+    FreeBlock* pHead;
+    int iCount;
+  };
+
+  struct SizeClass
+  {
+    SizeClass() :
+      pSlab(0),
+      iUncarvedBlocks(0),
+      iSlabCount(0),
+      iAllocations(0),
+      iDeallocations(0)
+    {}
+
+    // mutex must be held
+    void* carve(int sizeClass)
+    {
+      if (iUncarvedBlocks == 0)
+        {
+          void* pMemory = std::malloc(PiiSmallObjectAllocator::SlabSize);
+          if (pMemory == 0)
+            return 0;
+          // Slabs are never released. The previous one is fully
+          // carved, and its blocks are in free lists or in use.
+          pSlab = new PiiSimpleMemoryManager(pMemory, PiiSmallObjectAllocator::SlabSize,
+                                             PiiSmallObjectAllocator::blockSize(sizeClass));
+          iUncarvedBlocks = int(pSlab->blockCount());
+          ++iSlabCount;
+        }
+      --iUncarvedBlocks;
+      return pSlab->allocate(1);
+    }
+
+    // mutex must be held
+    void* pop(int sizeClass)
+    {
+      void* pBuffer = freeList.pop();
+      return pBuffer != 0 ? pBuffer : carve(sizeClass);
+    }
+
+    QMutex mutex;
+    FreeList freeList;
+    PiiSimpleMemoryManager* pSlab;
+    int iUncarvedBlocks;
+    int iSlabCount;
+    qint64 iAllocations, iDeallocations;
+  };
+
+  struct Pool
+  {
+    Pool() : iHeapAllocations(0) {}
+
+    SizeClass aClasses[PiiSmallObjectAllocator::SizeClassCount];
+    QMutex heapMutex;
+    qint64 iHeapAllocations;
+  };
+
+  Pool* pool()
+  {
+    // Intentionally leaked. See above.
+    static Pool* pPool = new Pool;
+    return pPool;
+  }
+
+  void* poolAllocate(int sizeClass)
+  {
+    SizeClass& cls = pool()->aClasses[sizeClass];
+    QMutexLocker lock(&cls.mutex);
+    void* pBuffer = cls.pop(sizeClass);
+    if (pBuffer != 0)
+      ++cls.iAllocations;
+    return pBuffer;
+  }
+
+  void poolDeallocate(void* buffer, int sizeClass)
+  {
+    SizeClass& cls = pool()->aClasses[sizeClass];
+    QMutexLocker lock(&cls.mutex);
+    cls.freeList.push(buffer);
+    ++cls.iDeallocations;
+  }
+
+  void countHeapAllocations(int count)
+  {
+    Pool* pPool = pool();
+    QMutexLocker lock(&pPool->heapMutex);
+    pPool->iHeapAllocations += count;
+  }
+
+#ifdef PII_CXX11
+  // Trivially destructible and thus valid until the thread exits.
+  thread_local bool bCacheDestroyed = false;
+
+  struct ThreadCache
+  {
+    ThreadCache() :
+      pPool(pool()),
+      iHeapAllocations(0)
+    {
+      for (int i=0; i<PiiSmallObjectAllocator::SizeClassCount; ++i)
+        aAllocations[i] = aDeallocations[i] = 0;
+    }
+
+    ~ThreadCache()
+    {
+      bCacheDestroyed = true;
+      for (int i=0; i<PiiSmallObjectAllocator::SizeClassCount; ++i)
+        {
+          SizeClass& cls = pPool->aClasses[i];
+          QMutexLocker lock(&cls.mutex);
+          while (void* pBuffer = aLists[i].pop())
+            cls.freeList.push(pBuffer);
+          flush(cls, i);
+        }
+      if (iHeapAllocations != 0)
+        countHeapAllocations(iHeapAllocations);
+    }
+
+    // cls.mutex must be held
+    void flush(SizeClass& cls, int sizeClass)
+    {
+      cls.iAllocations += aAllocations[sizeClass];
+      cls.iDeallocations += aDeallocations[sizeClass];
+      aAllocations[sizeClass] = aDeallocations[sizeClass] = 0;
+    }
+
+    void* pop(int sizeClass)
+    {
+      FreeList& list = aLists[sizeClass];
+      if (list.pHead == 0)
+        {
+          SizeClass& cls = pPool->aClasses[sizeClass];
+          QMutexLocker lock(&cls.mutex);
+          for (int i=0; i<BatchSize; ++i)
+            {
+              void* pBuffer = cls.pop(sizeClass);
+              if (pBuffer == 0)
+                break;
+              list.push(pBuffer);
+            }
+          flush(cls, sizeClass);
+          if (list.pHead == 0)
+            return 0;
+        }
+      ++aAllocations[sizeClass];
+      return list.pop();
+    }
+
+    void push(void* buffer, int sizeClass)
+    {
+      FreeList& list = aLists[sizeClass];
+      list.push(buffer);
+      ++aDeallocations[sizeClass];
+      if (list.iCount > ThreadCacheDepth)
+        {
+          SizeClass& cls = pPool->aClasses[sizeClass];
+          QMutexLocker lock(&cls.mutex);
+          for (int i=0; i<BatchSize; ++i)
+            cls.freeList.push(list.pop());
+          flush(cls, sizeClass);
+        }
+    }
+
+    void countHeapAllocation()
+    {
+      if (++iHeapAllocations == BatchSize)
+        {
+          countHeapAllocations(iHeapAllocations);
+          iHeapAllocations = 0;
+        }
+    }
+
+    Pool* pPool;
+    FreeList aLists[PiiSmallObjectAllocator::SizeClassCount];
+    int aAllocations[PiiSmallObjectAllocator::SizeClassCount];
+    int aDeallocations[PiiSmallObjectAllocator::SizeClassCount];
+    int iHeapAllocations;
+  };
+
+  ThreadCache* threadCache()
+  {
+    thread_local ThreadCache cache;
+    return &cache;
+  }
+#endif
+}
+
+int PiiSmallObjectAllocator::sizeClass(std::size_t bytes)
+{
+  if (bytes > std::size_t(MaxPooledSize))
+    return -1;
+  return int((bytes + sizeof(void*) - 1) >> 4);
+}
+
+std::size_t PiiSmallObjectAllocator::blockSize(int sizeClass)
+{
+  return std::size_t(sizeClass + 1) * 16 - sizeof(void*);
+}
+
+void* PiiSmallObjectAllocator::allocate(std::size_t bytes)
+{
+  int iClass = sizeClass(bytes);
+  if (iClass < 0)
+    {
+#ifdef PII_CXX11
+      if (!bCacheDestroyed)
+        threadCache()->countHeapAllocation();
+      else
+#endif
+        countHeapAllocations(1);
+      return std::malloc(bytes);
+    }
+#ifdef PII_CXX11
+  if (!bCacheDestroyed)
+    return threadCache()->pop(iClass);
+#endif
+  return poolAllocate(iClass);
+}
+
+void PiiSmallObjectAllocator::deallocate(void* buffer, std::size_t bytes)
+{
+  if (buffer == 0)
+    return;
+  int iClass = sizeClass(bytes);
+  if (iClass < 0)
+    {
+      std::free(buffer);
+      return;
+    }
+#ifdef PII_CXX11
+  if (!bCacheDestroyed)
+    {
+      threadCache()->push(buffer, iClass);
+      return;
+    }
+#endif
+  poolDeallocate(buffer, iClass);
+}
+
+PiiSmallObjectAllocator::Statistics PiiSmallObjectAllocator::statistics()
+{
+  Pool* pPool = pool();
+  Statistics stats;
+  for (int i=0; i<SizeClassCount; ++i)
+    {
+      SizeClass& cls = pPool->aClasses[i];
+      QMutexLocker lock(&cls.mutex);
+      stats.iAllocations += cls.iAllocations;
+      stats.iDeallocations += cls.iDeallocations;
+      stats.iReservedBytes += qint64(cls.iSlabCount) * SlabSize;
+      stats.iSlabCount += cls.iSlabCount;
+      stats.iFreeBlocks += cls.freeList.iCount + cls.iUncarvedBlocks;
+    }
+  synchronized (pPool->heapMutex) stats.iHeapAllocations = pPool->iHeapAllocations;
+  return stats;
+}
+
+void PiiSmallObjectAllocator::resetStatistics()
+{
+  Pool* pPool = pool();
+  for (int i=0; i<SizeClassCount; ++i)
+    {
+      SizeClass& cls = pPool->aClasses[i];
+      QMutexLocker lock(&cls.mutex);
+      cls.iAllocations = cls.iDeallocations = 0;
+    }
+  synchronized (pPool->heapMutex) pPool->iHeapAllocations = 0;
+}
@@ -0,0 +1,173 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISMALLOBJECTALLOCATOR_H
+#define _PIISMALLOBJECTALLOCATOR_H
+
+#include <PiiGlobal.h>
+#include <cstddef>
+#include <new>
+
+/**
+ * A pooled allocator for small objects. Allocating and releasing
+ * small objects at high rates, such as the heap-allocated values of
+ * PiiVariant and the list nodes that carry them through socket
+ * queues, spends much of its time in `malloc()` and contends on its
+ * locks. PiiSmallObjectAllocator serves such requests from slabs of
+ * fixed-size blocks.
+ *
+ * Requests up to [MaxPooledSize] bytes are rounded up to one of
+ * [SizeClassCount] size classes. Each class has its own slabs, each
+ * of which is a PiiSimpleMemoryManager with [SlabSize] bytes of
+ * memory. Larger requests go to the heap.
+ *
+ * Each thread keeps a cache of free blocks per size class. If the
+ * cache is empty, a batch of blocks is taken from the shared pool. If
+ * it grows too large, a batch is returned. Allocation and release
+ * thus lock a mutex only once per batch, even if objects are
+ * allocated in one thread and released in another, which is the
+ * normal case with objects passed between operations.
+ *
+ * Memory allocated to slabs is never returned to the heap. The
+ * allocator is thus suitable for objects whose total number stays
+ * bounded, but may be bloated by a peak.
+ *
+ * ~~~(c++)
+ * void* ptr = PiiSmallObjectAllocator::allocate(24);
+ * PiiSmallObjectAllocator::deallocate(ptr, 24);
+ * PiiSmallObjectAllocator::Statistics stats(PiiSmallObjectAllocator::statistics());
+ * piiDebug("%lld bytes in %d slabs", stats.iReservedBytes, stats.iSlabCount);
+ * ~~~
+ *
+ * ! Per-thread caches are only available if the library was built
+ * with C++11 support. Otherwise, every allocation locks the shared
+ * pool.
+ */
+class PII_CORE_EXPORT PiiSmallObjectAllocator
+{
+public:
+  enum
+  {
+    /// The largest allocation served from the pool.
+    MaxPooledSize = int(256 - sizeof(void*)),
+    /// The number of size classes.
+    SizeClassCount = 16,
+    /// The number of bytes reserved for a slab at once.
+    SlabSize = 65536
+  };
+
+  /**
+   * Allocator statistics. The allocation and release counters of a
+   * thread are added to the shared counters only when the thread
+   * accesses the shared pool or exits. They may thus lag behind by
+   * a few batches.
+   */
+  struct Statistics
+  {
+    Statistics() :
+      iAllocations(0), iDeallocations(0), iHeapAllocations(0),
+      iReservedBytes(0), iSlabCount(0), iFreeBlocks(0)
+    {}
+
+    /// The number of allocations served from the pool.
+    qint64 iAllocations;
+    /// The number of blocks returned to the pool.
+    qint64 iDeallocations;
+    /// The number of allocations too large for the pool.
+    qint64 iHeapAllocations;
+    /// The total size of all slabs.
+    qint64 iReservedBytes;
+    /// The number of slabs.
+    int iSlabCount;
+    /// The number of free blocks in the shared pool and the caches of
+    /// exited threads. Blocks cached by running threads are not
+    /// included.
+    qint64 iFreeBlocks;
+
+    /**
+     * Returns the number of pooled blocks currently in use.
+     */
+    qint64 liveBlocks() const { return iAllocations - iDeallocations; }
+  };
+
+  /**
+   * Allocates at least *bytes* bytes of memory aligned at a 16-byte
+   * boundary. Returns 0 if the memory cannot be allocated. The memory
+   * must be released with [deallocate()] using the same size.
+   */
+  static void* allocate(std::size_t bytes);
+
+  /**
+   * Releases memory previously allocated with [allocate()]. *bytes*
+   * must be equal to the number of bytes originally requested.
+   * Releasing a null pointer does nothing.
+   */
+  static void deallocate(void* buffer, std::size_t bytes);
+
+  /**
+   * Returns the current statistics.
+   */
+  static Statistics statistics();
+
+  /**
+   * Resets the allocation counters. Blocks allocated before the reset
+   * and released after it make [Statistics::liveBlocks()] negative.
+   */
+  static void resetStatistics();
+
+  /**
+   * Returns the size class that fits *bytes* bytes, or -1 if
+   * allocations of this size are not pooled.
+   */
+  static int sizeClass(std::size_t bytes);
+
+  /**
+   * Returns the size of blocks in *sizeClass*, in bytes.
+   */
+  static std::size_t blockSize(int sizeClass);
+
+private:
+  PiiSmallObjectAllocator();
+};
+
+/**
+ * Declares class-specific `new` and `delete` operators that allocate
+ * instances from PiiSmallObjectAllocator. Place this macro in the
+ * public section of a class declaration. Placement new is declared
+ * as well, because a class-specific operator would hide the global
+ * one.
+ *
+ * ~~~(c++)
+ * class MyNode
+ * {
+ * public:
+ *   PII_SMALL_OBJECT_ALLOCATOR
+ *   int iValue;
+ *   MyNode* pNext;
+ * };
+ * ~~~
+ */
+#define PII_SMALL_OBJECT_ALLOCATOR                                      \
+  static void* operator new (std::size_t size)                          \
+  {                                                                     \
+    void* ptr = PiiSmallObjectAllocator::allocate(size);                \
+    if (ptr == 0) throw std::bad_alloc();                               \
+    return ptr;                                                         \
+  }                                                                     \
+  static void operator delete (void* ptr, std::size_t size) { PiiSmallObjectAllocator::deallocate(ptr, size); } \
+  static void* operator new (std::size_t, void* ptr) { return ptr; }    \
+  static void operator delete (void*, void*) {}
+
+#endif //_PIISMALLOBJECTALLOCATOR_H
@@ -14,30 +14,39 @@
  */
 
 #include "PiiThreadSafeTimer.h"
+#include "PiiDelay.h"
+#include "PiiTimer.h"
 
-#include <QDateTime>
+// Wheel resolution in microseconds.
+static const qint64 iTimerResolution = 100;
+// Waits shorter than this (in microseconds) are slept with usleep().
+static const qint64 iShortWaitThreshold = 2000;
 
 PiiTimerThread* PiiThreadSafeTimer::_pTimerThread = 0;
 QMutex PiiThreadSafeTimer::_threadMutex;
 int PiiThreadSafeTimer::_iInstanceCount = 0;
 
-class PiiThreadSafeTimer::Data
+class PiiThreadSafeTimer::Data : public PiiTimerWheel::Entry
 {
 public:
-  Data() :
+  Data(PiiThreadSafeTimer* owner) :
+    pOwner(owner),
     bSingleShot(false),
-    iNextFiringTime(0),
+    bActive(false),
     iInterval(0)
   {}
 
+  PiiThreadSafeTimer* pOwner;
   bool bSingleShot;
-  qint64 iNextFiringTime;
+  // Stays true while the timeout signal of a repeating timer is
+  // being emitted, although the entry is out of the wheel.
+  bool bActive;
   int iInterval;
 };
 
 PiiThreadSafeTimer::PiiThreadSafeTimer(QObject* parent) :
   QObject(parent),
-  d(new Data)
+  d(new Data(this))
 {
   synchronized (_threadMutex)
     if (++_iInstanceCount == 1)
@@ -119,16 +128,21 @@ void PiiThreadSafeTimer::setInterval(int interval)
     }
 }
 int PiiThreadSafeTimer::interval() const { return d->iInterval; }
-bool PiiThreadSafeTimer::isActive() const { return d->iNextFiringTime != 0; }
+bool PiiThreadSafeTimer::isActive() const { return d->bActive; }
 int PiiThreadSafeTimer::remainingTime() const
 {
-  if (d->iNextFiringTime == 0) return -1;
-  return qMax(0, int(d->iNextFiringTime - PiiTimerThread::currentTime()));
+  if (!d->bActive) return -1;
+  return int(qMax(qint64(0), d->time() - PiiTimerThread::currentTime()) / 1000);
 }
 
+PiiTimerThread::PiiTimerThread() :
+  _wheel(iTimerResolution, currentTime())
+{}
+
 qint64 PiiTimerThread::currentTime()
 {
-  return QDateTime::currentDateTime().toMSecsSinceEpoch();
+  static PiiTimer timer;
+  return timer.microseconds();
 }
 
 void PiiTimerThread::run()
@@ -138,36 +152,51 @@ void PiiTimerThread::run()
   unsigned long ulTimeToNextEvent = ULONG_MAX;
   forever
     {
-      _eventCondition.wait(&_eventMapMutex, ulTimeToNextEvent);
+      if (ulTimeToNextEvent > 0)
+        _eventCondition.wait(&_eventMapMutex, ulTimeToNextEvent);
       if (!PiiThreadSafeTimer::_pTimerThread)
         break;
       qint64 iCurrentTime = currentTime();
-      QMultiMap<qint64,PiiThreadSafeTimer*>::iterator it = _mapEvents.begin();
       // Send all events whose time has passed
-      while (it != _mapEvents.end() && it.key() <= iCurrentTime)
+      PiiTimerWheel::Entry* pEntry = _wheel.advance(iCurrentTime);
+      while (pEntry != 0)
         {
-          qint64 iTime = it.key();
-          PiiThreadSafeTimer* pTimer = it.value();
-          _mapEvents.erase(it);
+          PiiThreadSafeTimer::Data* pData = static_cast<PiiThreadSafeTimer::Data*>(pEntry);
+          pEntry = pEntry->next();
 
-          emit pTimer->timeout();
+          emit pData->pOwner->timeout();
 
           // If this timer is a repeating one, add a new event to
           // queue.
-          if (!pTimer->isSingleShot())
-            _mapEvents.insert(pTimer->d->iNextFiringTime = iTime + pTimer->interval(), pTimer);
+          if (!pData->bSingleShot)
+            _wheel.schedule(pData, pData->time() + qint64(pData->iInterval) * 1000);
           else
-            pTimer->d->iNextFiringTime = 0;
-
-          it = _mapEvents.begin();
+            pData->bActive = false;
         }
+
+      qint64 iNextTime = _wheel.nextExpirationTime();
       // If there are no more events to handle, wait until a new one
       // is added to the queue.
-      if (it == _mapEvents.end())
+      if (iNextTime < 0)
         ulTimeToNextEvent = ULONG_MAX;
-      // Otherwise wait just enough.
       else
-        ulTimeToNextEvent = qMax(0ll, it.key() - iCurrentTime);
+        {
+          qint64 iRemaining = iNextTime - currentTime();
+          // Otherwise wait just enough. The condition is only
+          // accurate to a millisecond or so; sleep the rest.
+          if (iRemaining >= iShortWaitThreshold)
+            ulTimeToNextEvent = (unsigned long)((iRemaining - iShortWaitThreshold / 2) / 1000);
+          else
+            {
+              if (iRemaining > 0)
+                {
+                  _eventMapMutex.unlock();
+                  PiiDelay::usleep(int(iRemaining));
+                  _eventMapMutex.lock();
+                }
+              ulTimeToNextEvent = 0;
+            }
+        }
     }
   _eventMapMutex.unlock();
 }
@@ -175,20 +204,18 @@ void PiiTimerThread::run()
 // _eventMapMutex must be locked when calling this function
 void PiiTimerThread::addEvent(PiiThreadSafeTimer* timer)
 {
-  qint64 iFiringTime = currentTime() + timer->d->iInterval;
+  qint64 iFiringTime = currentTime() + qint64(timer->d->iInterval) * 1000;
   // If this event is the next one in the queue, wake up the sender thread.
-  if (_mapEvents.isEmpty() || _mapEvents.constBegin().key() > iFiringTime)
+  qint64 iNextTime = _wheel.nextExpirationTime();
+  if (iNextTime < 0 || iNextTime > iFiringTime)
     _eventCondition.wakeOne();
-  _mapEvents.insert(timer->d->iNextFiringTime = iFiringTime, timer);
+  _wheel.schedule(timer->d, iFiringTime);
+  timer->d->bActive = true;
 }
 
 // _eventMapMutex must be locked when calling this function
 void PiiTimerThread::removeEvent(PiiThreadSafeTimer* timer)
 {
-  QMultiMap<qint64,PiiThreadSafeTimer*>::iterator it = _mapEvents.find(timer->d->iNextFiringTime, timer);
-  if (it != _mapEvents.end())
-    {
-      _mapEvents.erase(it);
-      timer->d->iNextFiringTime = 0;
-    }
+  _wheel.cancel(timer->d);
+  timer->d->bActive = false;
 }
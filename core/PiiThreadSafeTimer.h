@@ -17,9 +17,9 @@
 #define _PIITHREADSAFETIMER_H
 
 #include "PiiGlobal.h"
+#include "PiiTimerWheel.h"
 #include <QObject>
 #include <QThread>
-#include <QMultiMap>
 #include <QMutex>
 #include <QWaitCondition>
 
@@ -30,6 +30,14 @@ class PiiTimerThread;
  * a global timer thread that emits [timeout()] signals for all
  * registered timers. This class provides a thread-safe API for
  * creating timer events.
+ *
+ * The pending timeouts are kept in a [PiiTimerWheel] with a
+ * resolution of 0.1 ms, which makes starting and stopping a timer
+ * take constant time. Time is measured with a monotonic clock in
+ * microseconds. The last millisecond before a timeout is slept with
+ * PiiDelay::usleep() so that timeouts are not late by the
+ * granularity of QWaitCondition. Repeating timers are rescheduled
+ * relative to their previous timeout and don't drift.
  */
 class PII_CORE_EXPORT PiiThreadSafeTimer : public QObject
 {
@@ -103,13 +111,15 @@ class PiiTimerThread : public QThread
 {
   Q_OBJECT
 public:
+  PiiTimerThread();
   void addEvent(PiiThreadSafeTimer* timer);
   void removeEvent(PiiThreadSafeTimer* timer);
   void run();
-  static inline qint64 currentTime();
+  // Microseconds on a monotonic clock.
+  static qint64 currentTime();
   QMutex _eventMapMutex;
   QWaitCondition _eventCondition;
-  QMultiMap<qint64,PiiThreadSafeTimer*> _mapEvents;
+  PiiTimerWheel _wheel;
 };
 
 #endif //_PIITHREADSAFETIMER_H
@@ -231,3 +231,10 @@ double PiiTimer::minutes() const
 {
   return (double)microseconds()/60000000.0;
 }
+
+qint64 PiiTimer::timestamp()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return qint64(t.tv_sec) * 1000000 + qint64(t.tv_nsec) / 1000;
+}
@@ -78,6 +78,16 @@ public:
 
   bool isRunning() const;
 
+  /**
+   * Returns the current value of the monotonic clock in
+   * microseconds. The zero point is unspecified but the same for all
+   * threads, which makes the value suitable for computing intervals
+   * between events recorded in different threads. This function
+   * involves no memory allocation and is cheaper than constructing a
+   * PiiTimer.
+   */
+  static qint64 timestamp();
+
 private:
   class Data;
   Data* d;
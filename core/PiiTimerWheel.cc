@@ -0,0 +1,247 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiTimerWheel.h"
+
+PiiTimerWheel::PiiTimerWheel(qint64 resolution, qint64 currentTime) :
+  _iResolution(qMax(qint64(1), resolution)),
+  _iTick(currentTime / _iResolution),
+  _iCount(0)
+{
+  for (int i=0; i<SlotCount; ++i)
+    _apSlots[i] = 0;
+  for (int i=0; i<RootSize/64; ++i)
+    _aRootBits[i] = 0;
+}
+
+void PiiTimerWheel::schedule(Entry* entry, qint64 time)
+{
+  if (entry->isScheduled())
+    remove(entry);
+  else
+    ++_iCount;
+  entry->_iTime = time;
+  insert(entry);
+}
+
+void PiiTimerWheel::cancel(Entry* entry)
+{
+  if (entry->isScheduled())
+    {
+      remove(entry);
+      --_iCount;
+    }
+}
+
+void PiiTimerWheel::insert(Entry* entry)
+{
+  // Overdue entries go to the current tick.
+  qint64 iExpires = qMax(entry->_iTime / _iResolution, _iTick);
+  qint64 iDelta = iExpires - _iTick;
+  int iSlot;
+  if (iDelta < RootSize)
+    iSlot = int(iExpires & RootMask);
+  else
+    {
+      // Entries beyond the last level are parked at its end and
+      // re-inserted when the last level is cascaded.
+      const qint64 iMaxDelta = (qint64(1) << (RootBits + LevelCount * LevelBits)) - 1;
+      if (iDelta > iMaxDelta)
+        {
+          iExpires = _iTick + iMaxDelta;
+          iDelta = iMaxDelta;
+        }
+      int iLevel = 0, iShift = RootBits;
+      while (iDelta >= (qint64(1) << (iShift + LevelBits)))
+        {
+          ++iLevel;
+          iShift += LevelBits;
+        }
+      iSlot = RootSize + iLevel * LevelSize + int((iExpires >> iShift) & LevelMask);
+    }
+
+  entry->_iSlot = iSlot;
+  entry->_pPrev = 0;
+  entry->_pNext = _apSlots[iSlot];
+  if (entry->_pNext != 0)
+    entry->_pNext->_pPrev = entry;
+  _apSlots[iSlot] = entry;
+  if (iSlot < RootSize)
+    _aRootBits[iSlot >> 6] |= quint64(1) << (iSlot & 63);
+}
+
+void PiiTimerWheel::remove(Entry* entry)
+{
+  const int iSlot = entry->_iSlot;
+  if (entry->_pPrev != 0)
+    entry->_pPrev->_pNext = entry->_pNext;
+  else
+    _apSlots[iSlot] = entry->_pNext;
+  if (entry->_pNext != 0)
+    entry->_pNext->_pPrev = entry->_pPrev;
+  if (iSlot < RootSize && _apSlots[iSlot] == 0)
+    _aRootBits[iSlot >> 6] &= ~(quint64(1) << (iSlot & 63));
+  entry->_pNext = entry->_pPrev = 0;
+  entry->_iSlot = -1;
+}
+
+PiiTimerWheel::Entry* PiiTimerWheel::takeSlot(int slot)
+{
+  Entry* pList = _apSlots[slot];
+  _apSlots[slot] = 0;
+  if (slot < RootSize)
+    _aRootBits[slot >> 6] &= ~(quint64(1) << (slot & 63));
+  return pList;
+}
+
+void PiiTimerWheel::cascade()
+{
+  // Move the entries of the current slot on each level down until a
+  // level that hasn't wrapped around is found.
+  int iShift = RootBits;
+  for (int iLevel=0; iLevel<LevelCount; ++iLevel, iShift += LevelBits)
+    {
+      const int iIndex = int((_iTick >> iShift) & LevelMask);
+      Entry* pEntry = takeSlot(RootSize + iLevel * LevelSize + iIndex);
+      while (pEntry != 0)
+        {
+          Entry* pNext = pEntry->_pNext;
+          insert(pEntry);
+          pEntry = pNext;
+        }
+      if (iIndex != 0)
+        break;
+    }
+}
+
+int PiiTimerWheel::nextRootSlot(int index) const
+{
+  while (index < RootSize)
+    {
+      quint64 iBits = _aRootBits[index >> 6] >> (index & 63);
+      if (iBits != 0)
+        {
+          while ((iBits & 1) == 0)
+            {
+              iBits >>= 1;
+              ++index;
+            }
+          return index;
+        }
+      index = ((index >> 6) + 1) << 6;
+    }
+  return RootSize;
+}
+
+PiiTimerWheel::Entry* PiiTimerWheel::advance(qint64 time)
+{
+  Entry* pExpired = 0;
+  const qint64 iTarget = time / _iResolution;
+
+  // Expire all entries in full ticks before the current one.
+  while (_iTick < iTarget)
+    {
+      if (_iCount == 0)
+        {
+          _iTick = iTarget;
+          break;
+        }
+      const int iIndex = int(_iTick & RootMask);
+      if (iIndex == 0)
+        cascade();
+      Entry* pEntry = takeSlot(iIndex);
+      while (pEntry != 0)
+        {
+          Entry* pNext = pEntry->_pNext;
+          pEntry->_iSlot = -1;
+          pEntry->_pPrev = 0;
+          pEntry->_pNext = pExpired;
+          pExpired = pEntry;
+          --_iCount;
+          pEntry = pNext;
+        }
+      _iTick = qMin(iTarget, nextTick(iIndex + 1));
+    }
+
+  // In the current tick, only the entries whose time has passed
+  // expire.
+  const int iIndex = int(_iTick & RootMask);
+  if (iIndex == 0)
+    cascade();
+  Entry* pEntry = _apSlots[iIndex];
+  while (pEntry != 0)
+    {
+      Entry* pNext = pEntry->_pNext;
+      if (pEntry->_iTime <= time)
+        {
+          remove(pEntry);
+          pEntry->_pNext = pExpired;
+          pExpired = pEntry;
+          --_iCount;
+        }
+      pEntry = pNext;
+    }
+  return pExpired;
+}
+
+/* Returns the next tick at or after the first-level slot *index*
+ * that has something to do, skipping empty slots. If the rest of the
+ * first level is empty, this is either the end of the first level
+ * (if it still contains entries for the next round) or the start of
+ * the next non-empty slot on the upper levels.
+ */
+qint64 PiiTimerWheel::nextTick(int index) const
+{
+  const qint64 iRoundStart = _iTick & ~qint64(RootMask);
+  const int iSlot = nextRootSlot(index);
+  if (iSlot < RootSize)
+    return iRoundStart + iSlot;
+  const qint64 iRoundEnd = iRoundStart + RootSize;
+  if (nextRootSlot(0) < RootSize)
+    return iRoundEnd;
+
+  // The current slot on each level has already been cascaded. Its
+  // entries, if any, belong to the next round.
+  qint64 iNext = -1;
+  int iShift = RootBits;
+  for (int iLevel=0; iLevel<LevelCount; ++iLevel, iShift += LevelBits)
+    {
+      const qint64 iBase = _iTick >> iShift;
+      for (int i=1; i<=LevelSize; ++i)
+        if (_apSlots[RootSize + iLevel * LevelSize + int((iBase + i) & LevelMask)] != 0)
+          {
+            const qint64 iTick = (iBase + i) << iShift;
+            if (iNext < 0 || iTick < iNext)
+              iNext = iTick;
+            break;
+          }
+    }
+  return iNext < 0 ? iRoundEnd : qMax(iNext, iRoundEnd);
+}
+
+qint64 PiiTimerWheel::nextExpirationTime() const
+{
+  if (_iCount == 0)
+    return -1;
+  const int iSlot = nextRootSlot(int(_iTick & RootMask));
+  if (iSlot < RootSize)
+    {
+      qint64 iTime = _apSlots[iSlot]->_iTime;
+      for (const Entry* pEntry = _apSlots[iSlot]->_pNext; pEntry != 0; pEntry = pEntry->_pNext)
+        iTime = qMin(iTime, pEntry->_iTime);
+      return iTime;
+    }
+  return nextTick(RootSize) * _iResolution;
+}
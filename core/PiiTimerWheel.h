@@ -0,0 +1,161 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITIMERWHEEL_H
+#define _PIITIMERWHEEL_H
+
+#include "PiiGlobal.h"
+
+/**
+ * A hierarchical timer wheel. A timer wheel keeps a large number of
+ * pending timeouts so that scheduling and cancelling a timeout takes
+ * constant time, independent of the number of pending timeouts.
+ *
+ * Time is divided into *ticks* whose length is given by the
+ * *resolution* in the constructor. The unit of time is up to the
+ * user; PiiThreadSafeTimer uses microseconds. The first level of the
+ * wheel has a slot for each of the next 256 ticks. Four more levels
+ * with 64 slots per level cover increasingly long spans of time.
+ * Entries on the higher levels are moved down as time advances. An
+ * entry never expires before its scheduled time, and an entry in the
+ * current tick expires as soon as its scheduled time has passed.
+ *
+ * The wheel doesn't allocate memory. The entries are intrusive list
+ * nodes owned by the user.
+ *
+ * @internal
+ */
+class PII_CORE_EXPORT PiiTimerWheel
+{
+public:
+  /**
+   * A pending timeout. Usually, the user derives a class from Entry
+   * to attach data to it.
+   */
+  class Entry
+  {
+  public:
+    Entry() : _pNext(0), _pPrev(0), _iTime(0), _iSlot(-1) {}
+
+    /**
+     * Returns `true` if the entry is currently in a wheel.
+     */
+    bool isScheduled() const { return _iSlot >= 0; }
+    /**
+     * Returns the time the entry was scheduled to expire at.
+     */
+    qint64 time() const { return _iTime; }
+    /**
+     * Returns the next entry in the list returned by
+     * PiiTimerWheel::advance().
+     */
+    Entry* next() const { return _pNext; }
+
+  private:
+    friend class PiiTimerWheel;
+    Entry* _pNext;
+    Entry* _pPrev;
+    qint64 _iTime;
+    int _iSlot;
+  };
+
+  /**
+   * Creates a new timer wheel.
+   *
+   * @param resolution the length of a tick
+   *
+   * @param currentTime the current time. Entries scheduled before
+   * this time expire on the next call to advance().
+   */
+  PiiTimerWheel(qint64 resolution, qint64 currentTime = 0);
+
+  /**
+   * Schedules *entry* to expire at *time*. If the entry has already
+   * been scheduled, it will be rescheduled.
+   */
+  void schedule(Entry* entry, qint64 time);
+
+  /**
+   * Removes *entry* from the wheel. Does nothing if the entry hasn't
+   * been scheduled.
+   */
+  void cancel(Entry* entry);
+
+  /**
+   * Advances the wheel to *time* and removes all entries whose
+   * scheduled time is less than or equal to *time*. Returns the
+   * removed entries as a list linked through Entry::next(), or 0 if
+   * no entries expired. The order of the entries in the list is
+   * unspecified. *time* must not be smaller than in the previous
+   * call.
+   */
+  Entry* advance(qint64 time);
+
+  /**
+   * Returns the earliest time at which advance() may return a
+   * non-empty list, or -1 if the wheel is empty. If the next entry
+   * is in the next 256 ticks, the returned value is its exact
+   * scheduled time. Otherwise, the time at which the entries of the
+   * next non-empty slot on the upper levels need to be moved down is
+   * returned.
+   */
+  qint64 nextExpirationTime() const;
+
+  /**
+   * Returns the number of scheduled entries.
+   */
+  int count() const { return _iCount; }
+  /**
+   * Returns `true` if no entries have been scheduled.
+   */
+  bool isEmpty() const { return _iCount == 0; }
+
+  /**
+   * Returns the resolution of the wheel.
+   */
+  qint64 resolution() const { return _iResolution; }
+
+private:
+  enum
+  {
+    RootBits = 8,
+    RootSize = 1 << RootBits,
+    RootMask = RootSize - 1,
+    LevelBits = 6,
+    LevelSize = 1 << LevelBits,
+    LevelMask = LevelSize - 1,
+    LevelCount = 4,
+    SlotCount = RootSize + LevelCount * LevelSize
+  };
+
+  void insert(Entry* entry);
+  void remove(Entry* entry);
+  void cascade();
+  Entry* takeSlot(int slot);
+  int nextRootSlot(int index) const;
+  qint64 nextTick(int index) const;
+
+  qint64 _iResolution;
+  // The tick being processed. All earlier ticks have expired.
+  qint64 _iTick;
+  int _iCount;
+  Entry* _apSlots[SlotCount];
+  // A bit for each non-empty slot on the first level.
+  quint64 _aRootBits[RootSize / 64];
+
+  PII_DISABLE_COPY(PiiTimerWheel);
+};
+
+#endif //_PIITIMERWHEEL_H
@@ -15,19 +15,23 @@
 
 #include "PiiUtil.h"
 
-#include "PiiFunctional.h"
-#include <PiiQVariantWrapper.h>
-#include <PiiSerializationFactory.h>
-
-#include <QtDebug>
-#include <QLinkedList>
-#include <QCoreApplication>
-#include <QHash>
-#include <QSet>
+#ifndef PII_NO_QT
+#  include "PiiFunctional.h"
+#  include <PiiQVariantWrapper.h>
+#  include <PiiSerializationFactory.h>
+
+#  include <QtDebug>
+#  include <QLinkedList>
+#  include <QCoreApplication>
+#  include <QHash>
+#  include <QSet>
+#endif
 #include <cmath>
+#include <cstring>
 
 namespace Pii
 {
+#ifndef PII_NO_QT
   QStringList argsToList(int argc, char* argv[])
   {
     QStringList lstResult;
@@ -36,6 +40,7 @@ namespace Pii
       lstResult << argv[i];
     return lstResult;
   }
+#endif
 
   bool isParent(const QObject* parent, const QObject* child)
   {
@@ -78,6 +83,7 @@ namespace Pii
     return 0;
   }
 
+#ifndef PII_NO_QT
   bool isA(const char* className, const QObject* obj)
   {
     if (obj == 0) return false;
@@ -90,6 +96,7 @@ namespace Pii
       }
     return false;
   }
+#endif
 
   uint qHash(const char* key)
   {
@@ -108,6 +115,7 @@ namespace Pii
     return h;
   }
 
+#ifndef PII_NO_QT
   static bool checkList(int temp, const QString& string )
   {
     QList<int> list;
@@ -742,4 +750,5 @@ namespace Pii
     pWrapper->setVariant(var1);
     return pWrapper->equals(var2);
   }
+#endif
 }
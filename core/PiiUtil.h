@@ -20,18 +20,20 @@
 #include <iostream>
 #include <cstdarg>
 
-#include <QList>
-#include <QVariant>
-#include <QDateTime>
 #include <QList>
 #include <QStringList>
-#include <QtGui/QPolygon>
-#include <QPoint>
-#include <QSettings>
-#include <QVariantMap>
 #include <QPair>
-#include <QMetaObject>
-#include <QMetaProperty>
+#include <QObject>
+#ifndef PII_NO_QT
+#  include <QVariant>
+#  include <QDateTime>
+#  include <QtGui/QPolygon>
+#  include <QPoint>
+#  include <QSettings>
+#  include <QVariantMap>
+#  include <QMetaObject>
+#  include <QMetaProperty>
+#endif
 
 #include "PiiGlobal.h"
 #include "PiiTypeTraits.h"
@@ -46,10 +48,15 @@ namespace Pii
    */
   inline std::ostream& operator<< (std::ostream& out, const QString& str)
   {
+#ifndef PII_NO_QT
     out << str.toLocal8Bit().constData();
+#else
+    out << static_cast<const std::string&>(str);
+#endif
     return out;
   }
 
+#ifndef PII_NO_QT
   /**
    * Returns `true` if *var1* and *var2* are equal and `false`
    * otherwise. Unlike QVariant::operator==, this function works with
@@ -57,6 +64,7 @@ namespace Pii
    * types using PiiQVariantWrapper.
    */
   PII_CORE_EXPORT bool equals(const QVariant& var1, const QVariant& var2);
+#endif
 
   /**
    * Find the intersection of two lists. The result contains the
@@ -102,6 +110,7 @@ namespace Pii
     return result;
   }
 
+#ifndef PII_NO_QT
   /**
    * Property types for properties().
    */
@@ -280,6 +289,7 @@ namespace Pii
       result[i] = variants[i].value<T>();
     return result;
   }
+#endif
 
   /**
    * Find all parent objects of `obj` up to `maxParents` parent
@@ -308,6 +318,7 @@ namespace Pii
     return result;
   }
 
+#ifndef PII_NO_QT
   /**
    * Returns `true` if *obj* is an instance of *className*.
    *
@@ -318,6 +329,7 @@ namespace Pii
    * ~~~
    */
   PII_CORE_EXPORT bool isA(const char* className, const QObject* obj);
+#endif
 
   /**
    * Find all parents independent of their type.
@@ -381,6 +393,7 @@ namespace Pii
    */
   PII_CORE_EXPORT uint qHash(const char* key);
 
+#ifndef PII_NO_QT
   /**
    * Match a list of crontab-like strings against the given time
    * stamp. Each string in `list` represents a rule with a syntax
@@ -597,6 +610,7 @@ namespace Pii
                                           Qt::CaseSensitivity sensitivity,
                                           const QString& commentMark),
                                          PII_BUILDING_CORE);
+#endif
 
   /**
    * Performs array copy of non-overlapping arrays. If used with
@@ -621,6 +635,7 @@ namespace Pii
       }
   }
 
+#ifndef PII_NO_QT
   /**
    * Converts a string into a number. This function differs from
    * QString::toDouble() and friends in that it recognizes magnitude
@@ -785,9 +800,12 @@ namespace Pii
    */
   PII_CORE_EXPORT QList<QList<int> > findDependencies(QLinkedList<QPair<int,int> >& edges,
                                                       DependencyOrder order = AnyValidOrder);
+#endif
 }
 
+#ifndef PII_NO_QT
 Q_DECLARE_OPERATORS_FOR_FLAGS(Pii::PropertyFlags);
+#endif
 
 template <class T> QList<T> operator&& (const QList<T>& list1, const QList<T>& list2)
 {
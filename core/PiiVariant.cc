@@ -91,6 +91,38 @@ PiiVariant& PiiVariant::operator= (const PiiVariant& other)
   return *this;
 }
 
+#ifdef PII_CXX11
+PiiVariant::PiiVariant(PiiVariant&& other) :
+  _pVTable(other._pVTable), _uiType(other._uiType)
+{
+  if (other._pVTable != 0)
+    other._pVTable->constructMove(*this, other);
+  else
+    _value = other._value;
+  other._pVTable = 0;
+  other._uiType = InvalidType;
+}
+
+PiiVariant& PiiVariant::operator= (PiiVariant&& other)
+{
+  if (&other != this)
+    {
+      if (_pVTable != 0)
+        _pVTable->destruct(*this);
+      if (other._pVTable == 0)
+        _value = other._value;
+      else
+        other._pVTable->constructMove(*this, other);
+
+      _uiType = other._uiType;
+      _pVTable = other._pVTable;
+      other._pVTable = 0;
+      other._uiType = InvalidType;
+    }
+  return *this;
+}
+#endif
+
 bool PiiVariant::operator== (const PiiVariant& other) const
 {
   if (_uiType != other._uiType)
@@ -20,6 +20,7 @@
 #include "PiiTypeTraits.h"
 #include "PiiTemplateExport.h"
 #include "PiiPreprocessor.h"
+#include "PiiSmallObjectAllocator.h"
 
 #include <QHash>
 #include <QMap>
@@ -292,6 +293,10 @@ public:
       InvalidType = 0xffffffff
     };
 
+  /* Variants allocated with new, such as QList nodes, come from the
+     small-object pool. */
+  PII_SMALL_OBJECT_ALLOCATOR
+
   /**
    * Creates an invalid variant.
    */
@@ -308,6 +313,26 @@ public:
    */
   template <class T> explicit PiiVariant(const T& value);
 
+#ifdef PII_CXX11
+  /**
+   * Creates a variant that takes over the contents of a temporary
+   * *value*. Types that fit into the internal buffer (such as
+   * PiiMatrix and QString, whose size equals that of a pointer) are
+   * stored without a heap allocation. Moving a temporary avoids the
+   * reference count manipulation a copy would need.
+   *
+   * ~~~(c++)
+   * PiiVariant var(PiiMatrix<int>(480, 640));
+   * ~~~
+   */
+  // The condition is a template argument instead of a defaulted
+  // parameter. Otherwise PiiVariant(0, MyType) would end up here.
+  template <class T, class = typename Pii::OnlyIf<!Pii::IsReference<T>::boolValue &&
+                                                  !Pii::IsConst<T>::boolValue &&
+                                                  !Pii::IsSame<T,PiiVariant>::boolValue>::Type>
+  explicit PiiVariant(T&& value);
+#endif
+
   /**
    * Creates a variant with a non-default type ID. If you want to give
    * a special meaning to a variant while still storing its actual
@@ -334,6 +359,40 @@ public:
    */
   PiiVariant& operator= (const PiiVariant& other);
 
+#ifdef PII_CXX11
+  /**
+   * Moves the contents of *other* to a new variant. Heap-allocated
+   * values change owner without being copied. *other* will be
+   * invalid after the call.
+   */
+  PiiVariant(PiiVariant&& other);
+
+  /**
+   * Releases the current contents of `this` and moves the contents
+   * of *other* in their place. *other* will be invalid after the
+   * call.
+   */
+  PiiVariant& operator= (PiiVariant&& other);
+
+  /**
+   * Destroys the current value and constructs a new object of type
+   * `T` in place, passing *args* to its constructor. Returns a
+   * reference to the new object. This makes it possible to build a
+   * value directly into a variant without creating and copying a
+   * temporary. `T` must be a non-primitive type registered with
+   * [PII_REGISTER_VARIANT_TYPE].
+   *
+   * ~~~(c++)
+   * PiiVariant var;
+   * PiiMatrix<int>& matResult = var.emplace<PiiMatrix<int> >(rows, columns);
+   * fillResult(matResult);
+   * emitObject(var);
+   * ~~~
+   */
+  template <class T, class... Args>
+  typename Pii::OnlyNonPrimitive<T,T&>::Type emplace(Args&&... args);
+#endif
+
   /**
    * Destroys the variant.
    */
@@ -528,10 +587,14 @@ private:
      Therefore, all unnecessary heap allocations must be avoided. The
      idea is to store a copy of the class instance into _buffer if it
      fits there. Otherwise, the data must be placed into heap, and
-     _pointer will point to its location.
+     _pointer will point to its location. Heap-allocated objects and
+     the variants themselves (e.g. QList nodes) are taken from
+     PiiSmallObjectAllocator.
    */
   template <class T> struct SmallObjectFunctions;
   template <class T> struct LargeObjectFunctions;
+  template <class T> class HeapBuffer;
+  template <class T> static inline void deleteHeapObject(T* obj);
   template <class T> struct VTableImpl;
   template <class T> friend struct VTableImpl;
   template <unsigned int typeId> struct TypeIdMapper;
@@ -555,6 +618,10 @@ private:
     void (*load)(PiiGenericInputArchive&, PiiVariant&);
     bool (*equals)(const PiiVariant&, const PiiVariant&);
     const char* typeName;
+    // Moves the contents of the second variant to the first one and
+    // destroys the source object. Only the type-specific data is
+    // touched.
+    void (*constructMove)(PiiVariant&, PiiVariant&);
   } *_pVTable;
 
   unsigned int _uiType;
@@ -647,8 +714,49 @@ template <class T> PiiVariant::PiiVariant(const T& value) :
   if (sizeof(T) <= InternalBufferSize)
     new ((void*)_buffer) T(value);
   else
-    _pointer = new T(value);
+    {
+      HeapBuffer<T> buffer;
+      _pointer = buffer.release(new (buffer.get()) T(value));
+    }
+}
+
+#ifdef PII_CXX11
+template <class T, class> PiiVariant::PiiVariant(T&& value) :
+  _pVTable(&VTableImpl<T>::instance),
+  _uiType(Pii::typeId<T>())
+{
+  if (sizeof(T) <= InternalBufferSize)
+    new ((void*)_buffer) T(std::move(value));
+  else
+    {
+      HeapBuffer<T> buffer;
+      _pointer = buffer.release(new (buffer.get()) T(std::move(value)));
+    }
+}
+
+template <class T, class... Args>
+typename Pii::OnlyNonPrimitive<T,T&>::Type PiiVariant::emplace(Args&&... args)
+{
+  if (_pVTable != 0)
+    _pVTable->destruct(*this);
+  // Stay valid even if the constructor throws.
+  _pVTable = 0;
+  _uiType = InvalidType;
+
+  T* pObj;
+  if (sizeof(T) <= InternalBufferSize)
+    pObj = new ((void*)_buffer) T(std::forward<Args>(args)...);
+  else
+    {
+      HeapBuffer<T> buffer;
+      _pointer = pObj = buffer.release(new (buffer.get()) T(std::forward<Args>(args)...));
+    }
+
+  _pVTable = &VTableImpl<T>::instance;
+  _uiType = Pii::typeId<T>();
+  return *pObj;
 }
+#endif
 
 template <class T> PiiVariant::PiiVariant(T value, unsigned int typeId, typename Pii::OnlyPrimitive<T>::Type) :
   _pVTable(0),
@@ -664,7 +772,10 @@ template <class T> PiiVariant::PiiVariant(T value, unsigned int typeId, typename
   if (sizeof(T) <= InternalBufferSize)
     new ((void*)_buffer) T(value);
   else
-    _pointer = new T(value);
+    {
+      HeapBuffer<T> buffer;
+      _pointer = buffer.release(new (buffer.get()) T(value));
+    }
 }
 
 template <class T> struct PiiVariant::SmallObjectFunctions
@@ -674,6 +785,16 @@ template <class T> struct PiiVariant::SmallObjectFunctions
     new (to._buffer) T(*from.ptrAs<T>());
   }
 
+  static void constructMoveImpl(PiiVariant& to, PiiVariant& from)
+  {
+#ifdef PII_CXX11
+    new (to._buffer) T(std::move(*from.ptrAs<T>()));
+#else
+    new (to._buffer) T(*from.ptrAs<T>());
+#endif
+    from.ptrAs<T>()->~T();
+  }
+
   static void destructImpl(PiiVariant& var)
   {
     var.ptrAs<T>()->~T();
@@ -708,16 +829,46 @@ template <class T> struct PiiVariant::SmallObjectFunctions
 #endif
 };
 
+// Releases the pooled memory if the constructor of T throws.
+template <class T> class PiiVariant::HeapBuffer
+{
+public:
+  HeapBuffer() : _pBuffer(PiiSmallObjectAllocator::allocate(sizeof(T)))
+  {
+    if (_pBuffer == 0)
+      throw std::bad_alloc();
+  }
+  ~HeapBuffer() { PiiSmallObjectAllocator::deallocate(_pBuffer, sizeof(T)); }
+
+  void* get() const { return _pBuffer; }
+  T* release(T* obj) { _pBuffer = 0; return obj; }
+
+private:
+  void* _pBuffer;
+};
+
+template <class T> inline void PiiVariant::deleteHeapObject(T* obj)
+{
+  obj->~T();
+  PiiSmallObjectAllocator::deallocate(obj, sizeof(T));
+}
+
 template <class T> struct PiiVariant::LargeObjectFunctions
 {
   static void constructCopyImpl(PiiVariant& to, const PiiVariant& from)
   {
-    to._pointer = new T(*from.ptrAs<T>());
+    HeapBuffer<T> buffer;
+    to._pointer = buffer.release(new (buffer.get()) T(*from.ptrAs<T>()));
+  }
+
+  static void constructMoveImpl(PiiVariant& to, PiiVariant& from)
+  {
+    to._pointer = from._pointer;
   }
 
   static void destructImpl(PiiVariant& var)
   {
-    delete var.ptrAs<T>();
+    deleteHeapObject(var.ptrAs<T>());
   }
 
   static void copyImpl(PiiVariant& to, const PiiVariant& from)
@@ -743,7 +894,8 @@ template <class T> struct PiiVariant::LargeObjectFunctions
 
   static void loadImpl(PiiGenericInputArchive& archive, PiiVariant& var)
   {
-    var._pointer = new T;
+    HeapBuffer<T> buffer;
+    var._pointer = buffer.release(new (buffer.get()) T);
     archive >> *reinterpret_cast<T*>(var._pointer);
   }
 #endif
@@ -761,6 +913,7 @@ template <class T> struct PiiVariant::VTableImpl :
   VTableImpl(unsigned int type, const char* name)
   {
     this->constructCopy = ParentType::constructCopyImpl;
+    this->constructMove = ParentType::constructMoveImpl;
     this->destruct = ParentType::destructImpl;
     this->copy = ParentType::copyImpl;
     this->data = ParentType::dataImpl;
@@ -15,61 +15,117 @@
 
 #include "PiiWaitCondition.h"
 
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
 PiiWaitCondition::PiiWaitCondition(QueueMode mode) :
-  _bQueue(mode == Queue), _iWaiters(0), _iWakeSignals(0)
+  _bQueue(mode == Queue), _iState(0), _iWakeups(0), _iEpoch(0)
 {}
 
+/* The state can only become negative under _mutex, and only threads
+ * holding _mutex change a negative state. Consuming and queuing
+ * signals (a non-negative state) is lock-free.
+ */
 bool PiiWaitCondition::wait(unsigned long time)
 {
-  //serialize access to _iWakeSignals and _iWaiters
-  QMutexLocker locker(&_mutex);
+  // Consume a pending signal without locking.
+  for (int iState = _iState.load(); iState > 0; iState = _iState.load())
+    if (_iState.testAndSet(iState, iState - 1))
+      return true;
+
+  QMutexLocker lock(&_mutex);
+  // Either consume a signal that arrived in between or register as
+  // a waiter. Registering and reading the epoch happen under the
+  // same lock as wakeAll(), so only a wakeAll() that counts this
+  // thread out can release it.
+  if (_iState-- > 0)
+    return true;
+  const unsigned int iEpoch = _iEpoch;
+
+  QElapsedTimer timer;
+  if (time != ULONG_MAX)
+    timer.start();
 
-  //see if we have already been signalled
-  if (_iWakeSignals > 0)
+  for (;;)
     {
-      //we are queuing signals -> just decrement by one
-      if (_bQueue)
-        --_iWakeSignals;
-      //we just need one signal -> clear the queue
-      else
-        _iWakeSignals = 0;
-      return true;
+      // Released by wakeAll(). The wake-ups granted before it were
+      // cleared.
+      if (_iEpoch != iEpoch)
+        return true;
+      // Grab a wake-up granted by wakeOne().
+      if (_iWakeups > 0)
+        {
+          --_iWakeups;
+          return true;
+        }
+
+      unsigned long ulRemaining = ULONG_MAX;
+      if (time != ULONG_MAX)
+        {
+          qint64 iElapsed = timer.elapsed();
+          if (iElapsed >= qint64(time))
+            break;
+          ulRemaining = (unsigned long)(qint64(time) - iElapsed);
+        }
+      _condition.wait(&_mutex, ulRemaining);
     }
-  ++_iWaiters;
 
-  //Unlock the mutex and wait for a signal. The mutex is atomically
-  //unlocked at the time this thread enters suspended mode and
-  //atomically locked again when the suspension ends.
-  return _condition.wait(&_mutex, time);
+  // Timed out. No wake-up is left, so this thread is still counted
+  // in the (negative) state. Withdraw.
+  ++_iState;
+  return false;
 }
 
 void PiiWaitCondition::wakeOne()
 {
-  _mutex.lock();
-  //if no thread is waiting, build up a queue
-  if (_iWaiters == 0)
-    ++_iWakeSignals;
-  else
+  for (;;)
     {
-      // Somebody is waiting: wake one up
-      _condition.wakeOne();
-      // Decrement the waiter count. In some rare cases, wait()
-      // doesn't return immediately after wakeOne(), but multiple
-      // wakeOne() calls may be invoked before wait() finishes.
-      // Therefore, the waiter count must be decreased before the
-      // wait() call actually returns.
-      --_iWaiters;
+      int iState = _iState.load();
+      if (iState < 0)
+        {
+          // Somebody is waiting: count one out and wake it up.
+          QMutexLocker lock(&_mutex);
+          iState = _iState.load();
+          if (iState < 0)
+            {
+              _iState.store(iState + 1);
+              ++_iWakeups;
+              _condition.wakeOne();
+              return;
+            }
+          // All waiters timed out or were released in between.
+        }
+      // In NoQueue mode, a single pending signal is enough.
+      else if (iState > 0 && !_bQueue)
+        return;
+      // Nobody is waiting: build up a queue.
+      else if (_iState.testAndSet(iState, iState + 1))
+        return;
     }
-  _mutex.unlock();
 }
 
 void PiiWaitCondition::wakeAll()
 {
-  _mutex.lock();
-  //release all waiting threads
-  _condition.wakeAll();
-  //make sure no signals are left in the queue
-  _iWakeSignals = 0;
-  _iWaiters = 0;
-  _mutex.unlock();
+  for (;;)
+    {
+      int iState = _iState.load();
+      if (iState < 0)
+        {
+          // Release everybody registered so far. Threads that arrive
+          // later will read the new epoch and keep waiting.
+          QMutexLocker lock(&_mutex);
+          if (_iState.load() < 0)
+            {
+              _iState.store(0);
+              _iWakeups = 0;
+              ++_iEpoch;
+              _condition.wakeAll();
+              return;
+            }
+        }
+      // Nobody is waiting: make sure no signals are left in the
+      // queue.
+      else if (_iState.testAndSet(iState, 0))
+        return;
+    }
 }
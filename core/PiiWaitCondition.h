@@ -19,6 +19,7 @@
 #include <QWaitCondition>
 #include <QMutex>
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
 
 /**
  * Provides waiting/waking conditions between two threads. The
@@ -61,6 +62,12 @@
  *   }
  * ~~~
  *
+ * The signal count is kept in an atomic word. wait() and wakeOne()
+ * never touch a mutex if a signal is already pending or nobody is
+ * waiting. Threads that need to block register under a mutex, which
+ * lets wakeAll() release exactly the threads that were waiting when
+ * it was called.
+ *
  */
 class PII_CORE_EXPORT PiiWaitCondition
 {
@@ -123,19 +130,24 @@ public:
   /**
    * Get the number of wakeOne() signals currently in queue.
    */
-  unsigned int queueLength() const { return _iWakeSignals; }
+  unsigned int queueLength() const { int iState = _iState.load(); return iState > 0 ? iState : 0; }
 
   /**
    * Get the number of threads currently waiting on the condition.
    */
-  unsigned int waiterCount() const { return _iWaiters; }
+  unsigned int waiterCount() const { int iState = _iState.load(); return iState < 0 ? -iState : 0; }
 
 private:
   bool _bQueue;
-  //number of threads waiting
-  unsigned int _iWaiters;
-  //number of wake signals in queue
-  unsigned int _iWakeSignals;
+  // Number of queued wake signals minus the number of threads that
+  // are waiting and haven't been woken yet.
+  PiiAtomicInt _iState;
+  // Wake-ups granted by wakeOne() but not yet consumed. Protected by
+  // _mutex.
+  int _iWakeups;
+  // Incremented by each wakeAll() that releases waiters. Protected by
+  // _mutex.
+  unsigned int _iEpoch;
 
   QWaitCondition _condition;
   QMutex _mutex;
@@ -10,15 +10,21 @@ qt {
   !contains(DISABLE,network) {
     HEADERS += network/*.h
     SOURCES += network/*.cc
+    # "qmake DISABLE+=zlib" builds the network library without HTTP
+    # compression.
+    contains(DISABLE,zlib): DEFINES += PII_NO_ZLIB
+    else: LIBS += -lz
   }
 } else {
-  SOURCES += PiiBits.cc PiiColorTable.cc PiiConstCharWrapper.cc PiiException.cc PiiGlobal.cc \
-    PiiInvalidArgumentException.cc PiiIOException.cc PiiMath.cc PiiMathException.cc \
-    PiiPtrHolder.cc PiiRandom.cc PiiResourceStatement.cc PiiResourceDatabase.cc \
-    PiiSharedObject.cc PiiSharedPtr.cc PiiSimpleMemoryManager.cc PiiTimer.cc PiiVariant.cc \
-    PiiVersionNumber.cc
+  SOURCES += PiiBits.cc PiiBufferLease.cc PiiColorTable.cc PiiDeviceBuffer.cc PiiConstCharWrapper.cc PiiCpu.cc PiiException.cc PiiGlobal.cc PiiHalf.cc \
+    PiiInvalidArgumentException.cc PiiIOException.cc PiiMappedFile.cc PiiMath.cc PiiMathException.cc \
+    PiiMatrixProduct.cc PiiParallel.cc PiiPtrHolder.cc PiiRandom.cc PiiRandomGenerator.cc PiiReductions.cc PiiResourceStatement.cc \
+    PiiResourceDatabase.cc PiiSharedObject.cc PiiSharedPtr.cc PiiSimpleMemoryManager.cc PiiSmallObjectAllocator.cc \
+    PiiTimer.cc PiiUtil.cc PiiVariant.cc PiiVersionNumber.cc
+  # Thread emulation, needed by ydin.
+  !c++03: SOURCES += PiiDelay.cc PiiReadWriteLock.cc PiiWaitCondition.cc
   SOURCES += stdwrapper/*.cc matrix/*.cc
-  INCLUDEPATH += stdwapper
+  INCLUDEPATH += stdwrapper
   posix: LIBS += -lrt
 }
 
@@ -0,0 +1,356 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIBITMATRIX_H
+#define _PIIBITMATRIX_H
+
+#include "PiiMatrix.h"
+#include <iterator>
+
+/// @hide
+namespace Pii
+{
+  /// Returns the number of set bits in *word*.
+  inline int countBits(quint64 word)
+  {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & Q_UINT64_C(0x5555555555555555));
+    word = (word & Q_UINT64_C(0x3333333333333333)) + ((word >> 2) & Q_UINT64_C(0x3333333333333333));
+    word = (word + (word >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return int((word * Q_UINT64_C(0x0101010101010101)) >> 56);
+#endif
+  }
+
+  /// Returns the index of the lowest set bit in *word*, which must not be zero.
+  inline int lowestBit(quint64 word)
+  {
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int iIndex = 0;
+    while (!(word & 1))
+      {
+        word >>= 1;
+        ++iIndex;
+      }
+    return iIndex;
+#endif
+  }
+
+  /// Returns the index of the highest set bit in *word*, which must not be zero.
+  inline int highestBit(quint64 word)
+  {
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(word);
+#else
+    int iIndex = 63;
+    while (!(word & Q_UINT64_C(0x8000000000000000)))
+      {
+        word <<= 1;
+        --iIndex;
+      }
+    return iIndex;
+#endif
+  }
+}
+
+/// @internal
+class PiiBitMatrixRowIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef std::ptrdiff_t difference_type;
+  typedef bool value_type;
+  typedef const bool* pointer;
+  typedef bool reference;
+
+  PiiBitMatrixRowIterator(const quint64* words, int column) : _pWords(words), _iColumn(column) {}
+
+  bool operator* () const { return (*this)[0]; }
+  bool operator[] (int index) const
+  {
+    const int iColumn = _iColumn + index;
+    return (_pWords[iColumn >> 6] >> (iColumn & 63)) & 1;
+  }
+
+  PiiBitMatrixRowIterator& operator++ () { ++_iColumn; return *this; }
+  PiiBitMatrixRowIterator& operator-- () { --_iColumn; return *this; }
+  PiiBitMatrixRowIterator operator++ (int) { PiiBitMatrixRowIterator tmp(*this); ++_iColumn; return tmp; }
+  PiiBitMatrixRowIterator operator-- (int) { PiiBitMatrixRowIterator tmp(*this); --_iColumn; return tmp; }
+  PiiBitMatrixRowIterator& operator+= (difference_type amount) { _iColumn += int(amount); return *this; }
+  PiiBitMatrixRowIterator& operator-= (difference_type amount) { _iColumn -= int(amount); return *this; }
+  PiiBitMatrixRowIterator operator+ (difference_type amount) const { return PiiBitMatrixRowIterator(_pWords, _iColumn + int(amount)); }
+  PiiBitMatrixRowIterator operator- (difference_type amount) const { return PiiBitMatrixRowIterator(_pWords, _iColumn - int(amount)); }
+  difference_type operator- (const PiiBitMatrixRowIterator& other) const { return _iColumn - other._iColumn; }
+
+  bool operator== (const PiiBitMatrixRowIterator& other) const { return _iColumn == other._iColumn; }
+  bool operator!= (const PiiBitMatrixRowIterator& other) const { return _iColumn != other._iColumn; }
+  bool operator< (const PiiBitMatrixRowIterator& other) const { return _iColumn < other._iColumn; }
+
+private:
+  const quint64* _pWords;
+  int _iColumn;
+};
+/// @endhide
+
+/**
+ * A binary matrix that packs 64 pixels to a word. PiiBitMatrix is
+ * meant for thresholded images and masks, which are usually the most
+ * common intermediate results in image processing pipelines. Compared
+ * to PiiMatrix<bool> or PiiMatrix<uchar>, it uses one eighth of the
+ * memory and memory bandwidth, and many operations such as
+ * morphology and run extraction can process 64 pixels at a time.
+ *
+ * Pixel (r,c) is stored in bit c%64 of word c/64 on row r. The bits
+ * beyond the last column are always zero. The words are stored in a
+ * PiiMatrix<quint64>, which makes PiiBitMatrix implicitly shared.
+ *
+ * PiiBitMatrix provides read-only row access in the same way as
+ * PiiMatrix (see [rowBegin()]), so algorithms that only read pixel
+ * values, such as PiiBoundaryFinder, work with it as such. Use
+ * [toMatrix()] to convert it to an ordinary byte mask when needed.
+ *
+ * ~~~(c++)
+ * PiiMatrix<uchar> matImage;
+ * PiiBitMatrix matBinary(matImage, std::bind2nd(std::greater<uchar>(), 128));
+ * PiiMatrix<uchar> matMask(matBinary.toMatrix<uchar>(255));
+ * ~~~
+ */
+class PiiBitMatrix
+{
+public:
+  typedef bool value_type;
+  typedef PiiBitMatrixRowIterator const_row_iterator;
+
+  /**
+   * Constructs an empty matrix.
+   */
+  PiiBitMatrix() : _iColumns(0) {}
+
+  /**
+   * Constructs a *rows*-by-*columns* matrix with all bits
+   * initialized to zero.
+   */
+  PiiBitMatrix(int rows, int columns) :
+    _matWords(rows, wordCount(columns)), _iColumns(columns)
+  {}
+
+  /**
+   * Constructs a matrix out of packed words. *words* must have
+   * exactly `(columns + 63) / 64` columns, and the bits beyond
+   * *columns* must be zero.
+   */
+  PiiBitMatrix(const PiiMatrix<quint64>& words, int columns) :
+    _matWords(words), _iColumns(columns)
+  {}
+
+  /**
+   * Packs the pixels of *mat* to a bit matrix. A bit is set if *rule*
+   * returns `true` for the corresponding pixel.
+   */
+  template <class Matrix, class UnaryOp> PiiBitMatrix(const Matrix& mat, UnaryOp rule) :
+    _matWords(mat.rows(), wordCount(mat.columns())), _iColumns(mat.columns())
+  {
+    for (int r=0; r<mat.rows(); ++r)
+      {
+        typename Matrix::const_row_iterator pSource = mat.rowBegin(r);
+        quint64* pWords = _matWords[r];
+        for (int c=0; c<_iColumns; c += 64)
+          {
+            // Collect a full word before storing it.
+            quint64 iWord = 0;
+            const int iEnd = qMin(64, _iColumns - c);
+            for (int i=0; i<iEnd; ++i)
+              if (rule(pSource[c+i]))
+                iWord |= quint64(1) << i;
+            pWords[c >> 6] = iWord;
+          }
+      }
+  }
+
+  /**
+   * Packs the non-zero pixels of *mat* to a bit matrix.
+   */
+  template <class Matrix> static PiiBitMatrix fromMatrix(const Matrix& mat)
+  {
+    typedef typename Matrix::value_type T;
+    return PiiBitMatrix(mat, std::bind2nd(std::not_equal_to<T>(), T(0)));
+  }
+
+  /**
+   * Returns the number of 64-bit words needed for *columns* pixels.
+   */
+  static int wordCount(int columns) { return (columns + 63) >> 6; }
+
+  int rows() const { return _matWords.rows(); }
+  int columns() const { return _iColumns; }
+  bool isEmpty() const { return _iColumns == 0 || _matWords.rows() == 0; }
+
+  /**
+   * Returns the number of words on each row.
+   */
+  int wordsPerRow() const { return _matWords.columns(); }
+
+  /**
+   * Returns a pointer to the packed words on row *r*.
+   */
+  const quint64* row(int r) const { return _matWords[r]; }
+  /**
+   * Returns a pointer to the packed words on row *r*. The bits
+   * beyond the last column must be kept zero.
+   */
+  quint64* row(int r) { return _matWords[r]; }
+
+  /**
+   * Returns the packed words.
+   */
+  const PiiMatrix<quint64>& words() const { return _matWords; }
+
+  const_row_iterator rowBegin(int r) const { return const_row_iterator(_matWords[r], 0); }
+  const_row_iterator rowEnd(int r) const { return const_row_iterator(_matWords[r], _iColumns); }
+
+  /**
+   * Returns the bit at (*r*, *c*).
+   */
+  bool operator() (int r, int c) const { return (_matWords(r, c >> 6) >> (c & 63)) & 1; }
+
+  /**
+   * Sets the bit at (*r*, *c*) to *value*.
+   */
+  void set(int r, int c, bool value = true)
+  {
+    quint64& iWord = _matWords(r, c >> 6);
+    const quint64 iBit = quint64(1) << (c & 63);
+    if (value)
+      iWord |= iBit;
+    else
+      iWord &= ~iBit;
+  }
+
+  /**
+   * Returns the number of set bits.
+   */
+  int count() const
+  {
+    int iCount = 0;
+    for (int r=0; r<rows(); ++r)
+      {
+        const quint64* pWords = row(r);
+        for (int w=0; w<wordsPerRow(); ++w)
+          iCount += Pii::countBits(pWords[w]);
+      }
+    return iCount;
+  }
+
+  /**
+   * Returns a matrix in which set bits are replaced with *value* and
+   * others with zeros.
+   */
+  template <class T> PiiMatrix<T> toMatrix(T value = T(1)) const
+  {
+    PiiMatrix<T> matResult(rows(), _iColumns);
+    for (int r=0; r<rows(); ++r)
+      {
+        const quint64* pWords = row(r);
+        T* pRow = matResult[r];
+        for (int w=0; w<wordsPerRow(); ++w)
+          for (quint64 iWord = pWords[w]; iWord != 0; iWord &= iWord - 1)
+            pRow[(w << 6) + Pii::lowestBit(iWord)] = value;
+      }
+    return matResult;
+  }
+
+  /**
+   * Returns a matrix in which each bit has been inverted.
+   */
+  PiiBitMatrix operator~ () const
+  {
+    PiiBitMatrix matResult(rows(), _iColumns);
+    for (int r=0; r<rows(); ++r)
+      {
+        const quint64* pSource = row(r);
+        quint64* pTarget = matResult.row(r);
+        for (int w=0; w<wordsPerRow(); ++w)
+          pTarget[w] = ~pSource[w];
+        matResult.clearTail(r);
+      }
+    return matResult;
+  }
+
+  /**
+   * Bitwise AND. The matrices must be equal in size.
+   */
+  PiiBitMatrix& operator&= (const PiiBitMatrix& other) { return combine(other, And()); }
+  /**
+   * Bitwise OR. The matrices must be equal in size.
+   */
+  PiiBitMatrix& operator|= (const PiiBitMatrix& other) { return combine(other, Or()); }
+  /**
+   * Bitwise XOR. The matrices must be equal in size.
+   */
+  PiiBitMatrix& operator^= (const PiiBitMatrix& other) { return combine(other, Xor()); }
+
+  PiiBitMatrix operator& (const PiiBitMatrix& other) const { PiiBitMatrix matResult(*this); return matResult &= other; }
+  PiiBitMatrix operator| (const PiiBitMatrix& other) const { PiiBitMatrix matResult(*this); return matResult |= other; }
+  PiiBitMatrix operator^ (const PiiBitMatrix& other) const { PiiBitMatrix matResult(*this); return matResult ^= other; }
+
+  /**
+   * Returns `true` if the matrices are equal in size and content.
+   */
+  bool operator== (const PiiBitMatrix& other) const
+  {
+    if (rows() != other.rows() || _iColumns != other._iColumns)
+      return false;
+    for (int r=0; r<rows(); ++r)
+      if (memcmp(row(r), other.row(r), wordsPerRow() * sizeof(quint64)) != 0)
+        return false;
+    return true;
+  }
+  bool operator!= (const PiiBitMatrix& other) const { return !operator==(other); }
+
+  /**
+   * Zeros the bits beyond the last column on row *r*. This must be
+   * called if the words on a row have been modified directly with
+   * operations that may set the trailing bits.
+   */
+  void clearTail(int r)
+  {
+    if (_iColumns & 63)
+      _matWords(r, _iColumns >> 6) &= (quint64(1) << (_iColumns & 63)) - 1;
+  }
+
+private:
+  struct And { quint64 operator() (quint64 a, quint64 b) const { return a & b; } };
+  struct Or { quint64 operator() (quint64 a, quint64 b) const { return a | b; } };
+  struct Xor { quint64 operator() (quint64 a, quint64 b) const { return a ^ b; } };
+
+  template <class Op> PiiBitMatrix& combine(const PiiBitMatrix& other, Op op)
+  {
+    for (int r=0; r<rows(); ++r)
+      {
+        quint64* pTarget = row(r);
+        const quint64* pSource = other.row(r);
+        for (int w=0; w<wordsPerRow(); ++w)
+          pTarget[w] = op(pTarget[w], pSource[w]);
+      }
+    return *this;
+  }
+
+  PiiMatrix<quint64> _matWords;
+  int _iColumns;
+};
+
+#endif //_PIIBITMATRIX_H
@@ -49,6 +49,39 @@ namespace Pii
   PII_CORE_EXPORT QString notSquareErrorMessage();
   /// @internal
   PII_CORE_EXPORT QString sizeMismatchErrorMessage();
+
+  /// @hide
+  /* Element-wise operations on conceptual matrices are evaluated one
+     row at a time. The row iterators of PiiMatrix are plain pointers,
+     and those of nested transforms are thin wrappers around them.
+     Without checks for row boundaries, a whole expression such as
+     a*2 + b - c compiles into a single counted loop per row that the
+     compiler can inline and vectorize.
+   */
+  template <class Source, class Target, class UnaryFunction>
+  inline void transformMatrixRows(const Source& source, Target& target, UnaryFunction func)
+  {
+    const int iRows = source.rows(), iColumns = source.columns();
+    for (int r=0; r<iRows; ++r)
+      transformN(source.rowBegin(r), iColumns, target.rowBegin(r), func);
+  }
+
+  template <class Target, class Source, class BinaryFunction>
+  inline void mapMatrixRows(Target& target, const Source& source, BinaryFunction func)
+  {
+    const int iRows = target.rows(), iColumns = target.columns();
+    for (int r=0; r<iRows; ++r)
+      mapN(target.rowBegin(r), iColumns, source.rowBegin(r), func);
+  }
+
+  template <class Target, class UnaryFunction>
+  inline void mapMatrixRows(Target& target, UnaryFunction func)
+  {
+    const int iRows = target.rows(), iColumns = target.columns();
+    for (int r=0; r<iRows; ++r)
+      mapN(target.rowBegin(r), iColumns, func);
+  }
+  /// @endhide
 }
 
 template <class Matrix> struct PiiMatrixTraits;
@@ -58,8 +91,8 @@ template <class Matrix1, class Matrix2, class BinaryFunction> class PiiBinaryMat
 #define PII_MATRIX_SCALAR_ASSIGNMENT_OPERATOR(OPERATOR, FUNCTION) \
 Derived& operator OPERATOR ## = (typename PiiMatrixTraits<Derived>::value_type value) \
 { \
-  Pii::map(self()->begin(), self()->end(), \
-           std::bind2nd(FUNCTION<typename PiiMatrixTraits<Derived>::value_type>(), value)); \
+  Pii::mapMatrixRows(selfRef(), \
+                     std::bind2nd(FUNCTION<typename PiiMatrixTraits<Derived>::value_type>(), value)); \
   return selfRef(); \
 }
 
@@ -72,8 +105,8 @@ template <class Derived> template <class Matrix> \
 Derived& PiiConceptualMatrix<Derived>::operator OPERATOR ## = (const PiiConceptualMatrix<Matrix>& other) \
 { \
   PII_MATRIX_CHECK_EQUAL_SIZE(*this, other); \
-  Pii::map(self()->begin(), self()->end(), other.self()->begin(), \
-           FUNCTION<typename PiiMatrixTraits<Derived>::value_type>()); \
+  Pii::mapMatrixRows(selfRef(), other.selfRef(), \
+                     FUNCTION<typename PiiMatrixTraits<Derived>::value_type>()); \
   return selfRef(); \
 }
 
@@ -276,7 +309,7 @@ public:
   template <class BinaryFunc>
   Derived& map(BinaryFunc op, typename BinaryFunc::second_argument_type value)
   {
-    Pii::map(self()->begin(), self()->end(), std::bind2nd(op, value));
+    Pii::mapMatrixRows(selfRef(), std::bind2nd(op, value));
     return selfRef();
   }
 
@@ -292,7 +325,7 @@ public:
   template <class UnaryFunc>
   Derived& map(UnaryFunc op)
   {
-    Pii::map(self()->begin(), self()->end(), op);
+    Pii::mapMatrixRows(selfRef(), op);
     return selfRef();
   }
 
@@ -452,7 +485,7 @@ public:
   }
   typename Traits::const_row_iterator rowEnd(int index) const
   {
-    return typename Traits::const_row_iterator(_mat.roEnd(index), _func);
+    return typename Traits::const_row_iterator(_mat.rowEnd(index), _func);
   }
   typename Traits::const_column_iterator columnEnd(int index) const
   {
@@ -618,8 +651,7 @@ template <class Derived> template <class Matrix>
 Derived& PiiConceptualMatrix<Derived>::operator<< (const Matrix& other)
 {
   PII_MATRIX_CHECK_EQUAL_SIZE(*this, other);
-  std::transform(other.begin(), other.end(), self()->begin(),
-                 Pii::Cast<typename Matrix::value_type, value_type>());
+  Pii::transformMatrixRows(other, selfRef(), Pii::Cast<typename Matrix::value_type, value_type>());
   return selfRef();
 }
 
@@ -641,7 +673,7 @@ template <class Derived> template <class BinaryFunc, class Matrix>
 Derived& PiiConceptualMatrix<Derived>::map(BinaryFunc op, const PiiConceptualMatrix<Matrix>& other)
 {
   PII_MATRIX_CHECK_EQUAL_SIZE(other, *this);
-  Pii::map(self()->begin(), self()->end(), other.self()->begin(), op);
+  Pii::mapMatrixRows(selfRef(), other.selfRef(), op);
   return selfRef();
 }
 
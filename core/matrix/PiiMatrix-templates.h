@@ -193,14 +193,12 @@ PiiMatrix<T>& PiiMatrix<T,-1,-1>::operator= (const PiiConceptualMatrix<Matrix>&
     {
       PiiMatrix matCopy(PiiMatrixData::createUninitializedData(other.self()->rows(), other.self()->columns(),
                                                                other.self()->columns() * sizeof(T)));
-      Pii::transform(other.self()->begin(), other.self()->end(), matCopy.begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
+      Pii::transformMatrixRows(other.selfRef(), matCopy, Pii::Cast<typename Matrix::value_type,T>());
       *this = matCopy;
     }
   else
     {
-      Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
+      Pii::transformMatrixRows(other.selfRef(), *this, Pii::Cast<typename Matrix::value_type,T>());
     }
   return *this;
 }
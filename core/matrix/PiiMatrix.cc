@@ -25,6 +25,25 @@ PiiMatrixData* PiiTypelessMatrix::createReference(int rows, int columns, void* b
   return pData;
 }
 
+std::size_t PiiTypelessMatrix::alignment() const
+{
+  std::size_t stBits = reinterpret_cast<std::size_t>(d->pBuffer) | 4096;
+  if (d->iRows > 1)
+    stBits |= d->iStride;
+  // Isolate the lowest set bit.
+  return stBits & (~stBits + 1);
+}
+
+void PiiTypelessMatrix::setDefaultAlignment(std::size_t alignment)
+{
+  PiiMatrixData::setDefaultAlignment(alignment);
+}
+
+std::size_t PiiTypelessMatrix::defaultAlignment()
+{
+  return PiiMatrixData::defaultAlignment();
+}
+
 void* PiiTypelessMatrix::appendRow(std::size_t bytesPerRow)
 {
   if (d->iRows >= d->iCapacity)
@@ -197,6 +216,12 @@ void PiiTypelessMatrix::resize(int rows, int columns, std::size_t bytesPerItem)
     }
 }
 
+void PiiTypelessMatrix::setDeviceBuffer(PiiDeviceBuffer* buffer)
+{
+  if (d != PiiMatrixData::sharedNull())
+    d->setDeviceBuffer(buffer);
+}
+
 void PiiTypelessMatrix::clear()
 {
   d->release();
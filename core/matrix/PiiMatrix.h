@@ -17,6 +17,10 @@
 #define _PIIMATRIX_H
 
 #include "PiiMatrixData.h"
+#include "PiiMatrixAccounting.h"
+#include "PiiMappedFile.h"
+#include "PiiBufferLease.h"
+#include "PiiDeviceBuffer.h"
 #include "PiiFunctional.h"
 #include "Pii.h"
 #include "PiiConceptualMatrix.h"
@@ -168,6 +172,13 @@ private:
 class PII_CORE_EXPORT PiiTypelessMatrix
 {
 public:
+  /**
+   * An alignment suitable for aligned SIMD loads and stores up to
+   * AVX-512. The value is also the size of a cache line on most
+   * current processors.
+   */
+  enum { SimdAlignment = 64 };
+
   /// Releases the internal data pointer.
   ~PiiTypelessMatrix() { d->release(); }
 
@@ -187,7 +198,8 @@ public:
    *
    * - Matrix rows are aligned to four-byte boundaries. For example,
    * if the data type is `char`, and the matrix has three columns
-   * (three bytes per row), *stride* will be four.
+   * (three bytes per row), *stride* will be four. A larger alignment
+   * can be set with [setDefaultAlignment()].
    *
    * - The matrix references external data. In this case the stride
    * may be anything, but always larger than or equal to the number of
@@ -195,6 +207,40 @@ public:
    */
   std::size_t stride() const { return d->iStride; }
 
+  /**
+   * Returns the largest power of two (up to 4096) that divides both
+   * the address of the first element and the [stride()] of the
+   * matrix. Kernels can use aligned loads and stores on every row if
+   * `alignment()` is at least the width of a vector register.
+   *
+   * ~~~(c++)
+   * PiiTypelessMatrix::setDefaultAlignment(32);
+   * PiiMatrix<float> mat(480, 640);
+   * if (mat.alignment() >= 32)
+   *   processWithAvx2(mat); // uses _mm256_load_ps()
+   * ~~~
+   */
+  std::size_t alignment() const;
+
+  /**
+   * Sets the alignment of matrices allocated from now on. If
+   * *alignment* is larger than four, the first element and the stride
+   * of each new matrix will be aligned to the closest power of two
+   * that is at least *alignment* bytes. The rows of narrow matrices
+   * will be padded accordingly. The default argument matches the
+   * requirements of AVX2 and AVX-512. Alignment can be restored to
+   * the default four bytes by setting *alignment* to four or less.
+   *
+   * This setting has no effect on matrices that reference external
+   * data, and it should be changed before any matrices are
+   * allocated, typically at the beginning of `main()`.
+   */
+  static void setDefaultAlignment(std::size_t alignment = SimdAlignment);
+  /**
+   * Returns the alignment that will be applied to new matrices.
+   */
+  static std::size_t defaultAlignment();
+
   /**
    * Returns the maximum number or rows that can be stored in the
    * matrix without reallocation. If the matrix references external
@@ -208,6 +254,31 @@ public:
    */
   void clear();
 
+  /**
+   * Returns the copy of the data in device memory, or zero if the
+   * data is on the host only.
+   *
+   * @see PiiDeviceBuffer
+   */
+  PiiDeviceBuffer* deviceBuffer() const { return d->pDeviceBuffer; }
+
+  /**
+   * Attaches *buffer* to the data of this matrix. The data may be
+   * shared by other matrices, which will see the same buffer. The
+   * matrix holds a reference to *buffer* and releases the buffer that
+   * was previously attached. Setting *buffer* to zero detaches the
+   * current one, which must be done after modifying the data on the
+   * host. Does nothing if the matrix is a null matrix.
+   */
+  void setDeviceBuffer(PiiDeviceBuffer* buffer);
+
+  /**
+   * Downloads the data from the device buffer if the host copy is
+   * out of date. Must be called before reading a matrix produced by
+   * a device operation on the host.
+   */
+  void syncHost() const { d->syncHost(); }
+
 protected:
   /// @hide
   PiiTypelessMatrix() : d(PiiMatrixData::sharedNull()) { d->reserve(); }
@@ -374,8 +445,9 @@ public:
                                                              other.self()->columns(),
                                                              other.self()->columns() * sizeof(T)))
   {
-    Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                   Pii::Cast<typename Matrix::value_type,T>());
+    if (!Pii::IsSame<typename Matrix::value_type,T>::boolValue)
+      PiiMatrixAccounting::recordConversion(stride() * rows());
+    Pii::transformMatrixRows(other.selfRef(), *this, Pii::Cast<typename Matrix::value_type,T>());
   }
 
   /**
@@ -444,6 +516,86 @@ public:
       d->bufferType = PiiMatrixData::ExternalOwnBuffer;
   }
 
+  /**
+   * Constructs a *rows*-by-*columns* matrix that references *data*
+   * in a memory-mapped *file*. The matrix holds a reference to the
+   * file, which stays mapped until the last matrix using it has been
+   * destroyed. Since the mapping is private, modifying the matrix
+   * never changes the file.
+   *
+   * ~~~(c++)
+   * PiiMappedFile* pFile = PiiMappedFile::map(fd);
+   * PiiMatrix<double> mat(100, 100, pFile->data() + 4096, pFile);
+   * pFile->release();
+   * ~~~
+   */
+  PiiMatrix(int rows, int columns, void* data, PiiMappedFile* file, std::size_t stride = 0) :
+    PiiTypelessMatrix(PiiMatrixData::createReferenceData(rows, columns,
+                                                         qMax(stride, sizeof(T)*columns),
+                                                         data))
+  {
+    d->bufferType = PiiMatrixData::MappedBuffer;
+    d->pMappedFile = file;
+    file->reserve();
+  }
+
+  /**
+   * Constructs a *rows*-by-*columns* matrix that references constant
+   * *data* in a memory-mapped *file*. The matrix is immutable: all
+   * non-const functions make a copy of the data first. Use this
+   * constructor if the same mapped data is going to be referenced
+   * many times, and changes made through one matrix must not show up
+   * in the others.
+   */
+  PiiMatrix(int rows, int columns, const void* data, PiiMappedFile* file, std::size_t stride = 0) :
+    PiiTypelessMatrix(PiiMatrixData::createReferenceData(rows, columns,
+                                                         qMax(stride, sizeof(T)*columns),
+                                                         const_cast<void*>(data))->makeImmutable())
+  {
+    d->bufferType = PiiMatrixData::MappedBuffer;
+    d->pMappedFile = file;
+    file->reserve();
+  }
+
+  /**
+   * Constructs a *rows*-by-*columns* matrix that references *data*
+   * owned by someone else. The matrix holds a reference to *lease*,
+   * and the buffer is returned to its owner once the last matrix
+   * using it has been destroyed. Modifying the matrix modifies the
+   * leased buffer.
+   *
+   * ~~~(c++)
+   * PiiBufferLease* pLease = new MyLease(pRing, iIndex);
+   * PiiMatrix<uchar> image(480, 640, pRing->buffer(iIndex), pLease);
+   * pLease->release();
+   * ~~~
+   */
+  PiiMatrix(int rows, int columns, void* data, PiiBufferLease* lease, std::size_t stride = 0) :
+    PiiTypelessMatrix(PiiMatrixData::createReferenceData(rows, columns,
+                                                         qMax(stride, sizeof(T)*columns),
+                                                         data))
+  {
+    d->bufferType = PiiMatrixData::LeasedBuffer;
+    d->pLease = lease;
+    lease->reserve();
+  }
+
+  /**
+   * Constructs a *rows*-by-*columns* matrix that references leased
+   * read-only *data*. The matrix is immutable: the first non-const
+   * access makes a private copy of the data, and the leased buffer is
+   * never modified.
+   */
+  PiiMatrix(int rows, int columns, const void* data, PiiBufferLease* lease, std::size_t stride = 0) :
+    PiiTypelessMatrix(PiiMatrixData::createReferenceData(rows, columns,
+                                                         qMax(stride, sizeof(T)*columns),
+                                                         const_cast<void*>(data))->makeImmutable())
+  {
+    d->bufferType = PiiMatrixData::LeasedBuffer;
+    d->pLease = lease;
+    lease->reserve();
+  }
+
   /**
    * Constructs a matrix with the given number of *rows* and
    * *columns*. Matrix contents are given as a variable-length parameter
@@ -693,7 +845,8 @@ public:
    * Returns a mutable reference to a sub-matrix. Take care that the
    * dimensions of the matrix are not exceeded. If you modify the
    * returned result, the data within this matrix will also change.
-   * The const version returns a copy.
+   * The const version returns a matrix that shares the data with
+   * this one without copying it and detaches only if modified.
    *
    * @param r the row of the upper left column of the sub-matrix. If
    * this is negative, it is treated as a backwards index from the
@@ -744,6 +897,7 @@ public:
   template <class U> operator PiiMatrix<U>() const
   {
     PiiMatrix<U> result(PiiMatrix<U>::uninitialized(rows(), columns()));
+    PiiMatrixAccounting::recordConversion(result.stride() * rows());
     Pii::transform(begin(), end(), result.begin(), Pii::Cast<T,U>());
     return result;
   }
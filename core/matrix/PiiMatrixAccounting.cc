@@ -0,0 +1,100 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMatrixAccounting.h"
+#include <PiiAtomicInt.h>
+
+// Thread-local storage is needed for attributing events to threads.
+#if !defined(PII_NO_MATRIX_ACCOUNTING) && defined(PII_CXX11)
+#  define PII_MATRIX_ACCOUNTING
+#endif
+
+namespace
+{
+  PiiAtomicInt iEnabled(0);
+#ifdef PII_MATRIX_ACCOUNTING
+  thread_local PiiMatrixAccounting::Counters* pCurrentCounters = 0;
+#endif
+}
+
+PiiMatrixAccounting::Counters::Counters()
+{
+  clear();
+}
+
+void PiiMatrixAccounting::Counters::merge(const Counters& other)
+{
+  iAllocations += other.iAllocations;
+  iAllocatedBytes += other.iAllocatedBytes;
+  iClones += other.iClones;
+  iClonedBytes += other.iClonedBytes;
+  iConversions += other.iConversions;
+  iConvertedBytes += other.iConvertedBytes;
+}
+
+void PiiMatrixAccounting::Counters::clear()
+{
+  iAllocations = iAllocatedBytes = 0;
+  iClones = iClonedBytes = 0;
+  iConversions = iConvertedBytes = 0;
+}
+
+bool PiiMatrixAccounting::Counters::isEmpty() const
+{
+  return iAllocations == 0 && iClones == 0 && iConversions == 0;
+}
+
+PiiMatrixAccounting::Scope::Scope(Counters* counters) :
+  _pPrevious(0),
+  _bActive(false)
+{
+#ifdef PII_MATRIX_ACCOUNTING
+  if (iEnabled.load() != 0)
+    {
+      _pPrevious = pCurrentCounters;
+      pCurrentCounters = counters;
+      _bActive = true;
+    }
+#else
+  Q_UNUSED(counters);
+#endif
+}
+
+PiiMatrixAccounting::Scope::~Scope()
+{
+#ifdef PII_MATRIX_ACCOUNTING
+  if (_bActive)
+    pCurrentCounters = _pPrevious;
+#endif
+}
+
+void PiiMatrixAccounting::setEnabled(bool enabled)
+{
+  iEnabled.store(enabled ? 1 : 0);
+}
+
+bool PiiMatrixAccounting::isEnabled()
+{
+  return iEnabled.load() != 0;
+}
+
+PiiMatrixAccounting::Counters* PiiMatrixAccounting::currentCounters()
+{
+#ifdef PII_MATRIX_ACCOUNTING
+  return pCurrentCounters;
+#else
+  return 0;
+#endif
+}
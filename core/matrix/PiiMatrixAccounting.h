@@ -0,0 +1,179 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMATRIXACCOUNTING_H
+#define _PIIMATRIXACCOUNTING_H
+
+#include <PiiGlobal.h>
+#include <cstddef>
+
+/**
+ * Accounting of matrix allocations and copies. Implicit sharing
+ * makes it hard to see where matrix data is actually copied: a
+ * non-const function call on shared data clones it, and type
+ * conversions such as PiiImage::toFloat() allocate a new matrix. When
+ * accounting is enabled, PiiMatrixData records four kinds of events
+ * into the [Counters] installed for the calling thread:
+ *
+ * - allocations of new internal buffers and their size in bytes,
+ * - clones (detaches) of shared data and the number of bytes copied,
+ * - conversions of matrices from one type to another.
+ *
+ * Counters are thread-private and contain no atomic variables. The
+ * processing threads of PiiDefaultOperation install a scope around
+ * each processing round. The events are thus attributed to the
+ * operation whose process() caused them and reported under the
+ * `matrices` key of PiiOperation::statistics(). Events that happen
+ * in a thread with no counters installed are not recorded.
+ *
+ * ~~~(c++)
+ * PiiMatrixAccounting::setEnabled(true);
+ * PiiMatrixAccounting::Counters counters;
+ * {
+ *   PiiMatrixAccounting::Scope scope(&counters);
+ *   PiiMatrix<int> a(10,10), b(a);
+ *   b(0,0) = 1; // detaches
+ * }
+ * // counters.iAllocations == 2, counters.iClones == 1
+ * ~~~
+ *
+ * Accounting is disabled by default. When disabled, the cost is one
+ * test of a thread-local pointer per allocation. It can be compiled
+ * out entirely by adding "matrixaccounting" to the `DISABLE` qmake
+ * variable, which defines `PII_NO_MATRIX_ACCOUNTING`.
+ *
+ * ! Accounting is only available if the library was built with C++11
+ * support. Otherwise, no events will be recorded.
+ */
+class PII_CORE_EXPORT PiiMatrixAccounting
+{
+public:
+  /**
+   * Event counters. All sizes are in bytes.
+   */
+  struct PII_CORE_EXPORT Counters
+  {
+    Counters();
+
+    /// The number of new matrix buffers allocated.
+    qint64 iAllocations;
+    /// The total size of the allocated buffers.
+    qint64 iAllocatedBytes;
+    /// The number of times shared data was cloned.
+    qint64 iClones;
+    /// The total number of bytes copied in cloning.
+    qint64 iClonedBytes;
+    /// The number of type conversions.
+    qint64 iConversions;
+    /// The total size of the conversion results.
+    qint64 iConvertedBytes;
+
+    void merge(const Counters& other);
+    void clear();
+    /**
+     * Returns `true` if no events have been recorded.
+     */
+    bool isEmpty() const;
+  };
+
+  /**
+   * Installs counters for the calling thread while in scope. The
+   * previously installed counters will be restored on destruction,
+   * which makes it possible to nest scopes. If accounting is
+   * disabled, the scope does nothing.
+   */
+  class PII_CORE_EXPORT Scope
+  {
+  public:
+    Scope(Counters* counters);
+    ~Scope();
+
+  private:
+    Counters* _pPrevious;
+    bool _bActive;
+  };
+
+  /**
+   * Enables or disables accounting globally. The change affects
+   * scopes created after the call.
+   */
+  static void setEnabled(bool enabled);
+
+  /**
+   * Returns `true` if accounting is enabled.
+   */
+  static bool isEnabled();
+
+  /**
+   * Returns the counters installed for the calling thread, or zero
+   * if there are none.
+   */
+  static Counters* currentCounters();
+
+  /**
+   * Records the allocation of a buffer of *bytes* bytes.
+   */
+  static inline void recordAllocation(std::size_t bytes)
+  {
+#ifndef PII_NO_MATRIX_ACCOUNTING
+    if (Counters* pCounters = currentCounters())
+      {
+        ++pCounters->iAllocations;
+        pCounters->iAllocatedBytes += qint64(bytes);
+      }
+#else
+    Q_UNUSED(bytes);
+#endif
+  }
+
+  /**
+   * Records a clone that copied *bytes* bytes.
+   */
+  static inline void recordClone(std::size_t bytes)
+  {
+#ifndef PII_NO_MATRIX_ACCOUNTING
+    if (Counters* pCounters = currentCounters())
+      {
+        ++pCounters->iClones;
+        pCounters->iClonedBytes += qint64(bytes);
+      }
+#else
+    Q_UNUSED(bytes);
+#endif
+  }
+
+  /**
+   * Records a type conversion whose result takes *bytes* bytes.
+   * Conversion functions that allocate their result should call
+   * this function.
+   */
+  static inline void recordConversion(std::size_t bytes)
+  {
+#ifndef PII_NO_MATRIX_ACCOUNTING
+    if (Counters* pCounters = currentCounters())
+      {
+        ++pCounters->iConversions;
+        pCounters->iConvertedBytes += qint64(bytes);
+      }
+#else
+    Q_UNUSED(bytes);
+#endif
+  }
+
+private:
+  PiiMatrixAccounting();
+};
+
+#endif //_PIIMATRIXACCOUNTING_H
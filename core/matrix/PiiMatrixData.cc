@@ -14,6 +14,11 @@
  */
 
 #include "PiiMatrixData.h"
+#include "PiiMatrixPool.h"
+#include "PiiMatrixAccounting.h"
+#include <PiiMappedFile.h>
+#include <PiiBufferLease.h>
+#include <PiiDeviceBuffer.h>
 #include <cstdlib>
 #include <cstring>
 #include <new>
@@ -24,39 +29,111 @@ PiiMatrixData* PiiMatrixData::sharedNull()
   return &nullData;
 }
 
-PiiMatrixData* PiiMatrixData::allocate(int rows, int columns, std::size_t stride)
+static std::size_t stDefaultAlignment = 4;
+
+void PiiMatrixData::setDefaultAlignment(std::size_t alignment)
+{
+  // Round up to a power of two between 4 and 4096.
+  std::size_t stAlignment = 4;
+  while (stAlignment < alignment && stAlignment < 4096)
+    stAlignment <<= 1;
+  stDefaultAlignment = stAlignment;
+}
+
+std::size_t PiiMatrixData::defaultAlignment()
 {
-  void* bfr = std::malloc(headerSize() + rows * stride);
-  return new (bfr) PiiMatrixData(rows, columns, stride);
+  return stDefaultAlignment;
+}
+
+PiiMatrixData* PiiMatrixData::allocate(int rows, int columns, std::size_t stride, std::size_t alignment)
+{
+  int iPoolClass, iPoolNode;
+  void* bfr = PiiMatrixPool::allocate(headerSize(alignment) + rows * stride, &iPoolClass, &iPoolNode);
+  PiiMatrixData* pData = new (bfr) PiiMatrixData(rows, columns, stride);
+  pData->iPoolClass = iPoolClass;
+  pData->iPoolNode = iPoolNode;
+  pData->iAlignment = alignment > 8 ? int(alignment) : 0;
+  return pData;
 }
 
 PiiMatrixData* PiiMatrixData::reallocate(PiiMatrixData* d, int rows)
 {
+  std::size_t iBytes = headerSize(d->iAlignment) + rows * d->iStride;
+  if (d->iPoolClass != -1)
+    {
+      // Pooled blocks are usually larger than requested.
+      if (iBytes <= PiiMatrixPool::blockSize(d->iPoolClass))
+        return d;
+      // The block won't fit its class any more.
+      d->iPoolClass = -1;
+    }
+  // Position of the data with respect to the end of the header.
+  std::size_t iOffset = 0;
+  bool bMove = d->bufferType == InternalBuffer && d->iAlignment != 0 && d->pBuffer != 0;
+  if (bMove)
+    iOffset = static_cast<char*>(d->pBuffer) - (reinterpret_cast<char*>(d) + headerSize());
   // This may move the contents of d into a new memory location
-  d = static_cast<PiiMatrixData*>(std::realloc(d, headerSize() + rows * d->iStride));
+  d = static_cast<PiiMatrixData*>(std::realloc(d, iBytes));
   // If the data buffer is internal, we need to fix the data pointer
   if (d->bufferType == InternalBuffer)
-    d->pBuffer = d->bufferAddress();
+    {
+      d->pBuffer = d->bufferAddress();
+      // The padding needed for alignment may have changed.
+      if (bMove)
+        {
+          char* pOldBuffer = reinterpret_cast<char*>(d) + headerSize() + iOffset;
+          if (pOldBuffer != d->pBuffer)
+            std::memmove(d->pBuffer, pOldBuffer, qMin(d->iRows, rows) * d->iStride);
+        }
+    }
   return d;
 }
 
+void PiiMatrixData::syncDeviceBuffer()
+{
+  // A submatrix shares the buffer with its source.
+  if (pSourceData != 0)
+    pSourceData->syncHost();
+  else
+    pDeviceBuffer->syncToHost(pBuffer, iStride, iRows);
+}
+
+void PiiMatrixData::setDeviceBuffer(PiiDeviceBuffer* buffer)
+{
+  if (buffer != 0)
+    buffer->reserve();
+  if (pDeviceBuffer != 0)
+    pDeviceBuffer->release();
+  pDeviceBuffer = buffer;
+}
+
 void PiiMatrixData::destroy()
 {
+  if (pDeviceBuffer != 0)
+    pDeviceBuffer->release();
   if (bufferType == ExternalOwnBuffer)
     std::free(pBuffer);
+  else if (bufferType == MappedBuffer)
+    pMappedFile->release();
+  else if (bufferType == LeasedBuffer)
+    pLease->release();
   else if (pSourceData != 0)
     pSourceData->release();
-  std::free(this);
+  PiiMatrixPool::deallocate(this, iPoolClass, iPoolNode);
 }
 
 PiiMatrixData* PiiMatrixData::createUninitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride)
 {
+  std::size_t stAlignment = stDefaultAlignment;
   if (stride < bytesPerRow)
-    stride = alignedWidth(bytesPerRow);
-  PiiMatrixData* pData = allocate(rows, columns, stride);
+    stride = alignedWidth(bytesPerRow, stAlignment);
+  PiiMatrixData* pData = allocate(rows, columns, stride, stAlignment);
   pData->bufferType = InternalBuffer;
   if (rows*columns != 0)
-    pData->pBuffer = pData->bufferAddress();
+    {
+      pData->pBuffer = pData->bufferAddress();
+      PiiMatrixAccounting::recordAllocation(stride * rows);
+    }
   else
     pData->pBuffer = 0;
   return pData;
@@ -81,6 +158,8 @@ PiiMatrixData* PiiMatrixData::createReferenceData(int rows, int columns, std::si
 
 PiiMatrixData* PiiMatrixData::clone(int capacity, std::size_t bytesPerRow)
 {
+  // The clone is a host copy only.
+  syncHost();
   PiiMatrixData* pData;
   int iNewRows = qMax(capacity, iRows);
   // If this is not a submatrix, retain the full width.
@@ -100,5 +179,6 @@ PiiMatrixData* PiiMatrixData::clone(int capacity, std::size_t bytesPerRow)
         std::memcpy(pData->row(i), row(i), bytesPerRow);
     }
   pData->iRows = iRows;
+  PiiMatrixAccounting::recordClone(bytesPerRow * iRows);
   return pData;
 }
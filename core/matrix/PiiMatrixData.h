@@ -19,10 +19,14 @@
 #include <PiiGlobal.h>
 #include <PiiAtomicInt.h>
 
+class PiiMappedFile;
+class PiiBufferLease;
+class PiiDeviceBuffer;
+
 /// @internal
 struct PII_CORE_EXPORT PiiMatrixData
 {
-  enum BufferType { InternalBuffer, ExternalBuffer, ExternalOwnBuffer };
+  enum BufferType { InternalBuffer, ExternalBuffer, ExternalOwnBuffer, MappedBuffer, LeasedBuffer };
 
   // Constructs a null data
   PiiMatrixData() :
@@ -34,7 +38,13 @@ struct PII_CORE_EXPORT PiiMatrixData
     iCapacity(0),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    pMappedFile(0),
+    pLease(0),
+    pDeviceBuffer(0),
+    iPoolClass(-1),
+    iPoolNode(0),
+    iAlignment(0)
   {}
 
   PiiMatrixData(int rows, int columns, std::size_t stride) :
@@ -46,7 +56,13 @@ struct PII_CORE_EXPORT PiiMatrixData
     iCapacity(rows),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    pMappedFile(0),
+    pLease(0),
+    pDeviceBuffer(0),
+    iPoolClass(-1),
+    iPoolNode(0),
+    iAlignment(0)
   {}
 
   PiiAtomicInt iRefCount;
@@ -65,16 +81,55 @@ struct PII_CORE_EXPORT PiiMatrixData
   PiiMatrixData* pSourceData;
   // Points to the first element of the matrix.
   void* pBuffer;
+  // The file pBuffer points into if bufferType is MappedBuffer.
+  PiiMappedFile* pMappedFile;
+  // The lease on pBuffer if bufferType is LeasedBuffer.
+  PiiBufferLease* pLease;
+  // A copy of the data in device memory, or null.
+  PiiDeviceBuffer* pDeviceBuffer;
+  // The PiiMatrixPool size class of this structure and its internal
+  // buffer, or -1 if the memory was allocated directly from the heap.
+  int iPoolClass;
+  // The NUMA node whose free list the pooled memory belongs to.
+  int iPoolNode;
+  // The alignment of an internal buffer, or zero if the buffer
+  // immediately follows the header.
+  int iAlignment;
 
   void* row(int index) { return static_cast<char*>(pBuffer) + iStride * index; }
   const void* row(int index) const { return static_cast<const char*>(pBuffer) + iStride * index; }
 
   // Aligns row width to a four-byte boundary
   static std::size_t alignedWidth(std::size_t bytes) { return (bytes + 3) & ~3; }
+  // Aligns row width to a multiple of alignment, which must be a
+  // power of two.
+  static std::size_t alignedWidth(std::size_t bytes, std::size_t alignment)
+  {
+    return alignment > 4 ? (bytes + alignment - 1) & ~(alignment - 1) : alignedWidth(bytes);
+  }
   // Returns the size of this structure rounded up to closest multiple of 8.
   static std::size_t headerSize() { return (sizeof(PiiMatrixData) + 7) & ~7; }
+  // Returns the number of bytes needed for the header and the
+  // padding required by alignment.
+  static std::size_t headerSize(std::size_t alignment) { return headerSize() + (alignment > 8 ? alignment - 8 : 0); }
   // Returns a pointer to the beginning of an internally allocated buffer.
-  char* bufferAddress() { return reinterpret_cast<char*>(this) + headerSize(); }
+  char* bufferAddress()
+  {
+    char* pAddress = reinterpret_cast<char*>(this) + headerSize();
+    if (iAlignment <= 8)
+      return pAddress;
+    return reinterpret_cast<char*>((reinterpret_cast<std::size_t>(pAddress) + iAlignment - 1) & ~std::size_t(iAlignment - 1));
+  }
+
+  // The alignment applied to new internal buffers. 4 means no
+  // alignment beyond the default.
+  static void setDefaultAlignment(std::size_t alignment);
+  static std::size_t defaultAlignment();
+
+  // Downloads the device copy of the data if the host copy is out of
+  // date.
+  void syncHost() { if (pDeviceBuffer != 0 || pSourceData != 0) syncDeviceBuffer(); }
+  void setDeviceBuffer(PiiDeviceBuffer* buffer);
 
   void reserve() { iRefCount.ref(); }
   void release() { if (iRefCount-- == iLastRef) destroy(); }
@@ -91,13 +146,16 @@ struct PII_CORE_EXPORT PiiMatrixData
   }
 
   static PiiMatrixData* sharedNull();
-  static PiiMatrixData* allocate(int rows, int columns, std::size_t stride);
+  static PiiMatrixData* allocate(int rows, int columns, std::size_t stride, std::size_t alignment = 0);
   static PiiMatrixData* reallocate(PiiMatrixData* d, int rows);
   static PiiMatrixData* createUninitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride = 0);
   static PiiMatrixData* createInitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride = 0);
   static PiiMatrixData* createReferenceData(int rows, int columns, std::size_t stride, void* buffer);
 
   void destroy();
+
+private:
+  void syncDeviceBuffer();
 };
 
 #endif //_PIIMATRIXDATA_H
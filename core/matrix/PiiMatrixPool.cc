@@ -0,0 +1,440 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMatrixPool.h"
+#include <PiiAtomicInt.h>
+#include <PiiCpu.h>
+#include <QMutex>
+#include <QMutexLocker>
+#include <cstdlib>
+
+/* Size classes
+ *
+ * Class 0 holds buffers of 64 KiB. After that, each power of two is
+ * divided into four classes: 80, 96, 112 and 128 KiB, then 160, 192,
+ * 224 and 256 KiB and so on. The largest class is 2 GiB.
+ *
+ * Free buffers are linked through their first bytes. Each thread
+ * caches at most ThreadCacheDepth buffers per class, all of them
+ * from the same NUMA node. The shared pool has a set of lists for
+ * each node and is protected by a mutex. Clearing the shared pool increases a
+ * generation counter, which makes thread caches release their
+ * buffers the next time they are accessed.
+ */
+
+namespace
+{
+  enum
+  {
+    MinBlockShift = 16,
+    ThreadCacheDepth = 2,
+    MaxThreadCacheBytes = 64 << 20,
+    MaxCachedHits = 1 << 30
+  };
+
+  struct FreeBlock
+  {
+    FreeBlock* pNext;
+  };
+
+  struct FreeList
+  {
+    FreeList() : pHead(0), iCount(0) {}
+
+    void push(void* buffer)
+    {
+      FreeBlock* pBlock = static_cast<FreeBlock*>(buffer);
+      pBlock->pNext = pHead;
+      pHead = pBlock;
+      ++iCount;
+    }
+
+    void* pop()
+    {
+      FreeBlock* pBlock = pHead;
+      if (pBlock != 0)
+        {
+          pHead = pBlock->pNext;
+          --iCount;
+        }
+      return pBlock;
+    }
+
+    void clear()
+    {
+      while (pHead != 0)
+        std::free(pop());
+    }
+
+    FreeBlock* pHead;
+    int iCount;
+  };
+
+  struct ThreadCache;
+
+  struct Pool
+  {
+    Pool() :
+      iMaxRetainedBytes(qint64(256) << 20),
+      iRetainedBytes(0),
+      iRetainedBlocks(0),
+      iHits(0),
+      iMisses(0),
+      bGloballyEnabled(false),
+      pFirstCache(0)
+    {}
+
+    ~Pool()
+    {
+      clearLists();
+    }
+
+    void clearLists()
+    {
+      for (int iNode=0; iNode<PiiMatrixPool::MaxNodeCount; ++iNode)
+        for (int i=0; i<PiiMatrixPool::SizeClassCount; ++i)
+          aLists[iNode][i].clear();
+      iRetainedBytes = 0;
+      iRetainedBlocks = 0;
+      ++iGeneration;
+    }
+
+    // mutex must be held
+    void* pop(int sizeClass, int node)
+    {
+      void* pBuffer = aLists[node][sizeClass].pop();
+      if (pBuffer != 0)
+        {
+          ++iHits;
+          iRetainedBytes -= PiiMatrixPool::blockSize(sizeClass);
+          --iRetainedBlocks;
+        }
+      else
+        ++iMisses;
+      return pBuffer;
+    }
+
+    // mutex must be held
+    void push(void* buffer, int sizeClass, int node)
+    {
+      qint64 iSize = PiiMatrixPool::blockSize(sizeClass);
+      if (iRetainedBytes + iSize > iMaxRetainedBytes)
+        std::free(buffer);
+      else
+        {
+          aLists[node][sizeClass].push(buffer);
+          iRetainedBytes += iSize;
+          ++iRetainedBlocks;
+        }
+    }
+
+    QMutex mutex;
+    FreeList aLists[PiiMatrixPool::MaxNodeCount][PiiMatrixPool::SizeClassCount];
+    qint64 iMaxRetainedBytes;
+    qint64 iRetainedBytes;
+    int iRetainedBlocks;
+    qint64 iHits, iMisses;
+    bool bGloballyEnabled;
+    PiiAtomicInt iGeneration;
+    ThreadCache* pFirstCache;
+  };
+
+  Pool* pool()
+  {
+    static Pool pool;
+    return &pool;
+  }
+
+  PiiAtomicInt iUserCount;
+
+  // The free list of the calling thread's node.
+  int currentNode()
+  {
+    static const bool bNuma = Pii::numaNodeCount() > 1;
+    return bNuma ? Pii::currentNumaNode() % PiiMatrixPool::MaxNodeCount : 0;
+  }
+
+#ifdef PII_CXX11
+  struct ThreadCache
+  {
+    ThreadCache() :
+      pPool(pool()),
+      iGeneration(pPool->iGeneration.load()),
+      iNode(0),
+      pPrev(0)
+    {
+      QMutexLocker lock(&pPool->mutex);
+      pNext = pPool->pFirstCache;
+      if (pNext != 0)
+        pNext->pPrev = this;
+      pPool->pFirstCache = this;
+    }
+
+    ~ThreadCache()
+    {
+      QMutexLocker lock(&pPool->mutex);
+      if (pNext != 0)
+        pNext->pPrev = pPrev;
+      if (pPrev != 0)
+        pPrev->pNext = pNext;
+      else
+        pPool->pFirstCache = pNext;
+      pPool->iHits += iHits.load();
+
+      // Return the buffers to the shared pool if they are still
+      // wanted there.
+      bool bKeep = iGeneration == pPool->iGeneration.load() && iUserCount.load() > 0;
+      for (int i=0; i<PiiMatrixPool::SizeClassCount; ++i)
+        while (void* pBuffer = aLists[i].pop())
+          {
+            if (bKeep)
+              pPool->push(pBuffer, i, iNode);
+            else
+              std::free(pBuffer);
+          }
+    }
+
+    void sync()
+    {
+      int iPoolGeneration = pPool->iGeneration.load();
+      if (iGeneration != iPoolGeneration)
+        {
+          for (int i=0; i<PiiMatrixPool::SizeClassCount; ++i)
+            aLists[i].clear();
+          iBytes = 0;
+          iBlocks = 0;
+          iGeneration = iPoolGeneration;
+        }
+    }
+
+    void* pop(int sizeClass, int node)
+    {
+      sync();
+      if (node != iNode)
+        return 0;
+      void* pBuffer = aLists[sizeClass].pop();
+      if (pBuffer != 0)
+        {
+          iBytes -= int(PiiMatrixPool::blockSize(sizeClass));
+          --iBlocks;
+          if (++iHits == MaxCachedHits)
+            {
+              QMutexLocker lock(&pPool->mutex);
+              pPool->iHits += iHits.load();
+              iHits = 0;
+            }
+        }
+      return pBuffer;
+    }
+
+    bool push(void* buffer, int sizeClass, int node)
+    {
+      sync();
+      // Only buffers local to the thread are cached. If the thread
+      // has moved to another node, the cache is refilled with
+      // buffers of the new node once the old ones have been used.
+      if (node != iNode)
+        {
+          if (iBlocks.load() > 0 || node != currentNode())
+            return false;
+          iNode = node;
+        }
+      std::size_t iSize = PiiMatrixPool::blockSize(sizeClass);
+      if (aLists[sizeClass].iCount >= ThreadCacheDepth ||
+          std::size_t(iBytes.load()) + iSize > std::size_t(MaxThreadCacheBytes))
+        return false;
+      aLists[sizeClass].push(buffer);
+      iBytes += int(iSize);
+      ++iBlocks;
+      return true;
+    }
+
+    Pool* pPool;
+    int iGeneration;
+    // The node of all cached buffers.
+    int iNode;
+    FreeList aLists[PiiMatrixPool::SizeClassCount];
+    // Read by statistics() in other threads.
+    PiiAtomicInt iBytes, iBlocks, iHits;
+    ThreadCache *pPrev, *pNext;
+  };
+
+  ThreadCache* threadCache()
+  {
+    static thread_local ThreadCache cache;
+    return &cache;
+  }
+#endif
+}
+
+void PiiMatrixPool::setEnabled(bool enabled)
+{
+  Pool* pPool = pool();
+  pPool->mutex.lock();
+  bool bChanged = pPool->bGloballyEnabled != enabled;
+  pPool->bGloballyEnabled = enabled;
+  pPool->mutex.unlock();
+  if (!bChanged)
+    return;
+  if (enabled)
+    addUser();
+  else
+    removeUser();
+}
+
+bool PiiMatrixPool::isEnabled()
+{
+  return iUserCount.load() > 0;
+}
+
+void PiiMatrixPool::addUser()
+{
+  ++iUserCount;
+}
+
+void PiiMatrixPool::removeUser()
+{
+  if (--iUserCount == 0)
+    clear();
+}
+
+void PiiMatrixPool::setMaxRetainedBytes(qint64 maxRetainedBytes)
+{
+  Pool* pPool = pool();
+  QMutexLocker lock(&pPool->mutex);
+  pPool->iMaxRetainedBytes = maxRetainedBytes;
+  if (pPool->iRetainedBytes > maxRetainedBytes)
+    pPool->clearLists();
+}
+
+qint64 PiiMatrixPool::maxRetainedBytes()
+{
+  Pool* pPool = pool();
+  QMutexLocker lock(&pPool->mutex);
+  return pPool->iMaxRetainedBytes;
+}
+
+PiiMatrixPool::Statistics PiiMatrixPool::statistics()
+{
+  Pool* pPool = pool();
+  QMutexLocker lock(&pPool->mutex);
+  Statistics stats;
+  stats.iHits = pPool->iHits;
+  stats.iMisses = pPool->iMisses;
+  stats.iRetainedBytes = pPool->iRetainedBytes;
+  stats.iRetainedBlocks = pPool->iRetainedBlocks;
+#ifdef PII_CXX11
+  for (ThreadCache* pCache = pPool->pFirstCache; pCache != 0; pCache = pCache->pNext)
+    {
+      stats.iHits += pCache->iHits.load();
+      stats.iRetainedBytes += pCache->iBytes.load();
+      stats.iRetainedBlocks += pCache->iBlocks.load();
+    }
+#endif
+  return stats;
+}
+
+void PiiMatrixPool::resetStatistics()
+{
+  Pool* pPool = pool();
+  QMutexLocker lock(&pPool->mutex);
+  pPool->iHits = 0;
+  pPool->iMisses = 0;
+#ifdef PII_CXX11
+  for (ThreadCache* pCache = pPool->pFirstCache; pCache != 0; pCache = pCache->pNext)
+    pCache->iHits = 0;
+#endif
+}
+
+void PiiMatrixPool::clear()
+{
+  Pool* pPool = pool();
+  pPool->mutex.lock();
+  pPool->clearLists();
+  pPool->mutex.unlock();
+#ifdef PII_CXX11
+  // The calling thread can release its cache immediately.
+  threadCache()->sync();
+#endif
+}
+
+std::size_t PiiMatrixPool::blockSize(int sizeClass)
+{
+  if (sizeClass == 0)
+    return std::size_t(1) << MinBlockShift;
+  int iShift = MinBlockShift + (sizeClass-1) / 4;
+  return std::size_t(5 + (sizeClass-1) % 4) << (iShift - 2);
+}
+
+int PiiMatrixPool::sizeClass(std::size_t bytes)
+{
+  if (bytes < std::size_t(MinPooledSize))
+    return -1;
+  if (bytes <= std::size_t(1) << MinBlockShift)
+    return 0;
+  // Find the highest set bit of bytes-1.
+  std::size_t iValue = bytes - 1;
+  int iShift = 0;
+  while (iValue >> (iShift + 1))
+    ++iShift;
+  int iClass = 1 + (iShift - MinBlockShift) * 4 + int((iValue >> (iShift - 2)) & 3);
+  return iClass < SizeClassCount ? iClass : -1;
+}
+
+void* PiiMatrixPool::allocate(std::size_t bytes, int* sizeClass, int* node)
+{
+  int iClass = iUserCount.load() > 0 ? PiiMatrixPool::sizeClass(bytes) : -1;
+  *sizeClass = iClass;
+  int iNode = iClass != -1 ? currentNode() : 0;
+  if (node != 0)
+    *node = iNode;
+  if (iClass == -1)
+    return std::malloc(bytes);
+
+  void* pBuffer;
+#ifdef PII_CXX11
+  pBuffer = threadCache()->pop(iClass, iNode);
+  if (pBuffer != 0)
+    return pBuffer;
+#endif
+  Pool* pPool = pool();
+  pPool->mutex.lock();
+  pBuffer = pPool->pop(iClass, iNode);
+  pPool->mutex.unlock();
+  // Fresh memory is placed on the node that touches it first, which
+  // is usually the calling thread.
+  if (pBuffer == 0)
+    pBuffer = std::malloc(blockSize(iClass));
+  return pBuffer;
+}
+
+void PiiMatrixPool::deallocate(void* buffer, int sizeClass, int node)
+{
+  // If the pool has been disabled, pooled buffers go directly to the
+  // heap.
+  if (sizeClass == -1 || iUserCount.load() == 0)
+    {
+      std::free(buffer);
+      return;
+    }
+  node = node >= 0 ? node % MaxNodeCount : currentNode();
+#ifdef PII_CXX11
+  if (threadCache()->push(buffer, sizeClass, node))
+    return;
+#endif
+  Pool* pPool = pool();
+  QMutexLocker lock(&pPool->mutex);
+  pPool->push(buffer, sizeClass, node);
+}
@@ -0,0 +1,186 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMATRIXPOOL_H
+#define _PIIMATRIXPOOL_H
+
+#include <PiiGlobal.h>
+#include <cstddef>
+
+/**
+ * A size-bucketed buffer pool for matrix data. Image processing
+ * pipelines allocate and free lots of large, identically sized
+ * matrices. Each allocation goes to the heap, which causes page
+ * faults and contention on the allocator's locks. When the pool is
+ * enabled, PiiMatrixData::createUninitializedData() takes memory
+ * from the pool, and a buffer released by the last matrix that
+ * refers to it returns to the pool instead of the heap.
+ *
+ * Buffers smaller than [MinPooledSize] bytes always go directly to
+ * the heap. Larger requests are rounded up to the closest size class.
+ * There are four size classes per power of two above 64 KiB, which
+ * wastes at most 25% of the requested size. Each thread keeps a small cache of
+ * recently released buffers that can be reused without locking. The
+ * rest are kept in a shared pool whose size is limited by
+ * [setMaxRetainedBytes()].
+ *
+ * On NUMA systems, the shared pool keeps separate free lists for
+ * each node. A buffer always returns to the list of the node it was
+ * allocated on, and allocations are served from the list of the node
+ * the calling thread is running on. Matrices are thus allocated in
+ * memory local to the consuming thread, provided that it is pinned
+ * to a node (see PiiDefaultOperation::affinityMode). Thread caches
+ * only retain buffers of the node the thread is running on.
+ *
+ * The pool is disabled by default. It is enabled as long as it has at
+ * least one user. PiiEngine adds itself as a user while running if
+ * its `matrixPoolEnabled` property is `true`. The pool can also be
+ * enabled globally.
+ *
+ * ~~~(c++)
+ * PiiMatrixPool::setEnabled(true);
+ * for (int i=0; i<100; ++i)
+ *   PiiMatrix<uchar> image(2048, 2048); // allocated only once
+ * PiiMatrixPool::Statistics stats(PiiMatrixPool::statistics());
+ * piiDebug("Hit rate %.2f, %lld bytes retained",
+ *          stats.hitRate(), stats.iRetainedBytes);
+ * ~~~
+ *
+ * ! Per-thread caches are only available if the library was built
+ * with C++11 support. Otherwise, every pooled allocation locks the
+ * shared pool.
+ */
+class PII_CORE_EXPORT PiiMatrixPool
+{
+public:
+  enum
+  {
+    /// The smallest allocation served from the pool.
+    MinPooledSize = 32768,
+    /// The number of size classes.
+    SizeClassCount = 61,
+    /// The number of NUMA nodes with separate free lists. Nodes
+    /// beyond this share lists.
+    MaxNodeCount = 8
+  };
+
+  /**
+   * Pool usage statistics.
+   */
+  struct Statistics
+  {
+    Statistics() : iHits(0), iMisses(0), iRetainedBytes(0), iRetainedBlocks(0) {}
+
+    /// The number of pooled allocations satisfied with a released buffer.
+    qint64 iHits;
+    /// The number of pooled allocations that had to go to the heap.
+    qint64 iMisses;
+    /// The total size of free buffers currently kept in the pool.
+    qint64 iRetainedBytes;
+    /// The number of free buffers currently kept in the pool.
+    int iRetainedBlocks;
+
+    /**
+     * Returns the fraction of pooled allocations that didn't need to
+     * go to the heap.
+     */
+    double hitRate() const { return iHits + iMisses > 0 ? double(iHits) / double(iHits + iMisses) : 0.0; }
+  };
+
+  /**
+   * Enables or disables the pool globally. Enabling makes the
+   * application one user of the pool. The pool stays enabled until
+   * all users are gone.
+   */
+  static void setEnabled(bool enabled);
+
+  /**
+   * Returns `true` if the pool has at least one user.
+   */
+  static bool isEnabled();
+
+  /**
+   * Adds a user to the pool. Each call must be balanced by a call to
+   * [removeUser()].
+   */
+  static void addUser();
+
+  /**
+   * Removes a user from the pool. When the last user is gone, the
+   * pool will be disabled and all buffers in the shared pool released
+   * to the heap. Buffers cached by other threads are released when
+   * the threads exit or the pool is enabled again.
+   */
+  static void removeUser();
+
+  /**
+   * Sets the maximum number of bytes kept in the shared pool. Buffers
+   * released beyond this limit go back to the heap. The default is
+   * 256 MiB. Per-thread caches aren't included in the limit; each
+   * of them retains at most two buffers per size class and 64 MiB in
+   * total.
+   */
+  static void setMaxRetainedBytes(qint64 maxRetainedBytes);
+  static qint64 maxRetainedBytes();
+
+  /**
+   * Returns the current usage statistics.
+   */
+  static Statistics statistics();
+
+  /**
+   * Resets the hit and miss counters.
+   */
+  static void resetStatistics();
+
+  /**
+   * Releases all buffers in the shared pool to the heap.
+   */
+  static void clear();
+
+  /**
+   * Allocates at least *bytes* bytes of memory. If the request was
+   * served from the pool, the size class of the returned buffer will
+   * be stored to *sizeClass*. Otherwise, *sizeClass* will be set to
+   * -1. The free list the buffer belongs to will be stored to *node*
+   * if it is non-zero. The buffer must be released with
+   * [deallocate()].
+   */
+  static void* allocate(std::size_t bytes, int* sizeClass, int* node = 0);
+
+  /**
+   * Releases a buffer returned by [allocate()]. If *sizeClass* is
+   * -1, the buffer goes directly to the heap. *node* must be the
+   * value stored by [allocate()]. -1 means the node of the calling
+   * thread.
+   */
+  static void deallocate(void* buffer, int sizeClass, int node = -1);
+
+  /**
+   * Returns the size of buffers in *sizeClass*, in bytes.
+   */
+  static std::size_t blockSize(int sizeClass);
+
+  /**
+   * Returns the size class that fits *bytes* bytes, or -1 if
+   * allocations of this size are not pooled.
+   */
+  static int sizeClass(std::size_t bytes);
+
+private:
+  PiiMatrixPool();
+};
+
+#endif //_PIIMATRIXPOOL_H
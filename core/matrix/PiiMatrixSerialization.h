@@ -17,6 +17,8 @@
 #define _PIIMATRIXSERIALIZATION_H
 
 #include "PiiMatrix.h"
+#include "PiiSparseMatrix.h"
+#include "PiiBitMatrix.h"
 #include <PiiSmartPtr.h>
 #include <PiiSerializationTraits.h>
 #include <PiiNameValuePair.h>
@@ -37,6 +39,7 @@ namespace PiiSerialization
     archive << PII_NVP("rows", iRows);
     archive << PII_NVP("cols", iCols);
     unsigned int uiBytes = iCols*sizeof(T);
+    archive.startRawBlock(iRows*uiBytes);
     for (int r=0; r<iRows; ++r)
       archive.writeRawData(mat[r], uiBytes);
   }
@@ -51,9 +54,20 @@ namespace PiiSerialization
     if (iRows < 0 || iCols < 0)
       PII_SERIALIZATION_ERROR(InvalidDataFormat);
 
-    mat.resize(iRows, iCols);
-
     unsigned int uiBytes = iCols*sizeof(T);
+    archive.startRawBlock(iRows*uiBytes);
+    // Large blocks may be memory-mapped directly from the archive
+    // file.
+    PiiMappedFile* pFile = 0;
+    void* pData = archive.mapRawBlock(iRows*uiBytes, &pFile);
+    if (pData != 0)
+      {
+        mat = PiiMatrix<T>(iRows, iCols, pData, pFile, uiBytes);
+        pFile->release();
+        return;
+      }
+
+    mat.resize(iRows, iCols);
     for (int r=0; r<iRows; ++r)
       archive.readRawData(mat[r], uiBytes);
   }
@@ -89,9 +103,102 @@ namespace PiiSerialization
   {
     separateFunctions(archive, mat, version);
   }
+
+  /**** Sparse matrices ****/
+
+  template <class Archive, class T>
+  void save(Archive& archive, const PiiSparseMatrix<T>& mat, const unsigned int /*version*/)
+  {
+    int iRows = mat.rows(), iCols = mat.columns(), iCount = mat.nonZeroCount();
+    archive << PII_NVP("rows", iRows);
+    archive << PII_NVP("cols", iCols);
+    archive << PII_NVP("count", iCount);
+    archive.startRawBlock((iRows+1) * sizeof(int));
+    archive.writeRawData(mat.rowOffsets().constData(), (iRows+1) * sizeof(int));
+    archive.startRawBlock(iCount * sizeof(int));
+    archive.writeRawData(mat.columnIndices().constData(), iCount * sizeof(int));
+    archive.startRawBlock(iCount * sizeof(T));
+    archive.writeRawData(mat.values().constData(), iCount * sizeof(T));
+  }
+
+  template <class Archive, class T>
+  void load(Archive& archive, PiiSparseMatrix<T>& mat, const unsigned int /*version*/)
+  {
+    int iRows, iCols, iCount;
+    archive >> PII_NVP("rows", iRows);
+    archive >> PII_NVP("cols", iCols);
+    archive >> PII_NVP("count", iCount);
+
+    if (iRows < 0 || iCols < 0 || iCount < 0)
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    QVector<int> vecRowOffsets(iRows+1), vecColumnIndices(iCount);
+    QVector<T> vecValues(iCount);
+    archive.startRawBlock((iRows+1) * sizeof(int));
+    archive.readRawData(vecRowOffsets.data(), (iRows+1) * sizeof(int));
+    archive.startRawBlock(iCount * sizeof(int));
+    archive.readRawData(vecColumnIndices.data(), iCount * sizeof(int));
+    archive.startRawBlock(iCount * sizeof(T));
+    archive.readRawData(vecValues.data(), iCount * sizeof(T));
+
+    if (!PiiSparseMatrix<T>::isValid(iRows, iCols, vecRowOffsets, vecColumnIndices, iCount))
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+    mat = PiiSparseMatrix<T>(iRows, iCols, vecRowOffsets, vecColumnIndices, vecValues);
+  }
+
+  template <class Archive, class T>
+  inline void serialize(Archive& archive, PiiSparseMatrix<T>& mat, const unsigned int version)
+  {
+    separateFunctions(archive, mat, version);
+  }
+
+  /**** Bit matrices ****/
+
+  template <class Archive>
+  void save(Archive& archive, const PiiBitMatrix& mat, const unsigned int /*version*/)
+  {
+    int iRows = mat.rows(), iCols = mat.columns();
+    archive << PII_NVP("rows", iRows);
+    archive << PII_NVP("cols", iCols);
+    const int iBytes = mat.wordsPerRow() * sizeof(quint64);
+    for (int r=0; r<iRows; ++r)
+      {
+        archive.startRawBlock(iBytes);
+        archive.writeRawData(mat.row(r), iBytes);
+      }
+  }
+
+  template <class Archive>
+  void load(Archive& archive, PiiBitMatrix& mat, const unsigned int /*version*/)
+  {
+    int iRows, iCols;
+    archive >> PII_NVP("rows", iRows);
+    archive >> PII_NVP("cols", iCols);
+
+    if (iRows < 0 || iCols < 0)
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+    PiiBitMatrix matResult(iRows, iCols);
+    const int iBytes = matResult.wordsPerRow() * sizeof(quint64);
+    for (int r=0; r<iRows; ++r)
+      {
+        archive.startRawBlock(iBytes);
+        archive.readRawData(matResult.row(r), iBytes);
+        matResult.clearTail(r);
+      }
+    mat = matResult;
+  }
+
+  template <class Archive>
+  inline void serialize(Archive& archive, PiiBitMatrix& mat, const unsigned int version)
+  {
+    separateFunctions(archive, mat, version);
+  }
 }
 
 PII_SERIALIZATION_TRACKING_TEMPLATE(PiiMatrix, false);
+PII_SERIALIZATION_TRACKING_TEMPLATE(PiiSparseMatrix, false);
+PII_SERIALIZATION_TRACKING(PiiBitMatrix, false);
 /// @endhide
 
 #endif //_PIIMATRIXSERIALIZATION_H
@@ -17,6 +17,7 @@
 #define _PIIPRINCIPALCOMPONENTS_H
 
 #include "PiiSvDecomposition.h"
+#include "PiiParallel.h"
 
 namespace Pii
 {
@@ -84,4 +85,145 @@ namespace Pii
   }
 }
 
+/**
+ * Principal component analysis on a data set that grows over time.
+ * Instead of storing and decomposing all observations, this class
+ * accumulates the mean and the scatter matrix (the sum of outer
+ * products of centered observations). When new observations are
+ * added, their own scatter is combined with the old one using a
+ * rank-one correction for the shift in mean. The cost of adding m
+ * observations of dimension n is thus O(mn²) regardless of how many
+ * observations have been added before.
+ *
+ * The principal components are calculated lazily from the n-by-n
+ * scatter matrix. If a previous base exists, the scatter matrix is
+ * first rotated into it. Since the new matrix is nearly diagonal, the
+ * Jacobi iteration of [Pii::svDecompose()] converges in much fewer
+ * sweeps than when started from scratch.
+ *
+ * ~~~(c++)
+ * PiiIncrementalPca<double> pca;
+ * pca.addSamples(matFirstBatch);
+ * PiiMatrix<double> matV = pca.baseVectors();
+ * // Later
+ * pca.addSamples(matSecondBatch, PiiParallelPolicy());
+ * matV = pca.baseVectors();
+ * ~~~
+ */
+template <class T> class PiiIncrementalPca
+{
+public:
+  PiiIncrementalPca() : _iSampleCount(0), _bDirty(false) {}
+
+  /**
+   * Adds a set of observations, stored as the rows of *X*. The
+   * number of columns in *X* must match that of the previously added
+   * observations. The scatter matrix of the new observations is
+   * calculated with [Pii::matrixProduct()], whose workload is divided
+   * as determined by *policy*.
+   *
+   * @exception PiiMathException& if the number of columns doesn't
+   * match
+   */
+  template <class Matrix>
+  void addSamples(const Matrix& X, const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    const int iRows = X.rows(), iColumns = X.columns();
+    if (iRows == 0)
+      return;
+    if (_iSampleCount == 0)
+      {
+        _matMean.resize(1, iColumns);
+        _matMean = 0;
+        _matScatter.resize(iColumns, iColumns);
+        _matScatter = 0;
+        _matBase.clear();
+      }
+    else if (iColumns != _matMean.columns())
+      PII_MATRIX_SIZE_MISMATCH;
+
+    PiiMatrix<T> matBatch(X);
+    PiiMatrix<T> matDelta(Pii::subtractMean(matBatch));
+    _matScatter += Pii::matrixProduct(Pii::transpose(matBatch), matBatch, policy);
+
+    // Correct for the difference between the old and the new mean.
+    matDelta -= _matMean;
+    const T total = T(_iSampleCount + iRows);
+    if (_iSampleCount > 0)
+      _matScatter += Pii::transpose(matDelta) * matDelta * (T(_iSampleCount) * T(iRows) / total);
+    _matMean += matDelta * (T(iRows) / total);
+    _iSampleCount += iRows;
+    _bDirty = true;
+  }
+
+  /**
+   * Returns the principal components of all observations added so far
+   * as the columns of an n-by-n orthonormal matrix V. See
+   * [Pii::principalComponents()].
+   */
+  PiiMatrix<T> baseVectors() const { update(); return _matBase; }
+
+  /**
+   * Returns the singular values of the centered observation matrix as
+   * a row vector, in descending order. These are the same values
+   * [Pii::principalComponents()] would return. The variance along
+   * the i'th component is the square of the i'th singular value
+   * divided by `sampleCount()` - 1.
+   */
+  PiiMatrix<T> singularValues() const { update(); return _matSingularValues; }
+
+  /**
+   * Returns the mean of all observations as a row vector.
+   */
+  PiiMatrix<T> mean() const { return _matMean; }
+
+  /**
+   * Returns the scatter matrix of all observations. This is the
+   * covariance matrix multiplied by `sampleCount()` - 1.
+   */
+  PiiMatrix<T> scatter() const { return _matScatter; }
+
+  /**
+   * Returns the number of observations added so far.
+   */
+  int sampleCount() const { return _iSampleCount; }
+
+  /**
+   * Removes all observations.
+   */
+  void clear()
+  {
+    _iSampleCount = 0;
+    _bDirty = false;
+    _matMean.clear();
+    _matScatter.clear();
+    _matBase.clear();
+    _matSingularValues.clear();
+  }
+
+private:
+  void update() const
+  {
+    if (!_bDirty)
+      return;
+    PiiMatrix<T> matEigenvalues;
+    if (_matBase.isEmpty())
+      matEigenvalues = Pii::svDecompose(_matScatter, 0, &_matBase, Pii::SvdFullV);
+    else
+      {
+        PiiMatrix<T> matRotation;
+        matEigenvalues = Pii::svDecompose(Pii::transpose(_matBase) * _matScatter * _matBase,
+                                          0, &matRotation, Pii::SvdFullV);
+        _matBase = _matBase * matRotation;
+      }
+    _matSingularValues = matEigenvalues.mapped(Pii::Sqrt<T>());
+    _bDirty = false;
+  }
+
+  int _iSampleCount;
+  PiiMatrix<T> _matMean, _matScatter;
+  mutable PiiMatrix<T> _matBase, _matSingularValues;
+  mutable bool _bDirty;
+};
+
 #endif //_PIIPRINCIPALCOMPONENTS_H
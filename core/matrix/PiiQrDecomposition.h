@@ -360,14 +360,17 @@ namespace Pii
                    We are doing this:
 
                    A2 <- (I + A1 T'A1') A2
-                   A2 <- A2 + A1 T'A1'A2
+                   A2 <- A2 + A1 (T' (A1'A2))
+
+                   The products must be evaluated right to left.
+                   Otherwise, A1 T'A1' would be a huge m-by-m matrix.
                 */
 
-                A(iBlockStart, iBlockStart + iCurrentBlockSize, -1, -1) +=      // A2  +=
-                  matA1 *                                                       // A1  *
-                  transpose(matT(0,0, iCurrentBlockSize, iCurrentBlockSize)) *  // T'  *
-                  transpose(matA1) *                                            // A1' *
-                  A(iBlockStart, iBlockStart + iCurrentBlockSize, -1, -1);      // A2
+                A(iBlockStart, iBlockStart + iCurrentBlockSize, -1, -1) +=        // A2  +=
+                  matA1 *                                                         // A1  *
+                  (transpose(matT(0,0, iCurrentBlockSize, iCurrentBlockSize)) *   // (T' *
+                   (transpose(matA1) *                                            // (A1' *
+                    A(iBlockStart, iBlockStart + iCurrentBlockSize, -1, -1)));    // A2))
               }
             // The remaining part is small. Use the reflector vectors
             // directly.
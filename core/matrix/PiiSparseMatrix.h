@@ -0,0 +1,720 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISPARSEMATRIX_H
+#define _PIISPARSEMATRIX_H
+
+#include "PiiMatrix.h"
+#include <PiiMath.h>
+#include <PiiParallel.h>
+#include <PiiInvalidArgumentException.h>
+#include <QVector>
+#include <QCoreApplication>
+#include <algorithm>
+
+template <class T> class PiiSparseMatrix;
+
+/// @internal
+template <class T> class PiiSparseMatrixIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef std::ptrdiff_t difference_type;
+  typedef T value_type;
+  typedef const T* pointer;
+  typedef T reference;
+
+  PiiSparseMatrixIterator(const PiiSparseMatrix<T>* matrix, int row, int column) :
+    _pMatrix(matrix),
+    _iRow(row),
+    _iColumn(column),
+    _iIndex(matrix->lowerBound(row, column))
+  {}
+
+  T operator* () const { return isStored() ? _pMatrix->values()[_iIndex] : T(0); }
+  T operator[] (int index) const { return *(*this + index); }
+
+  PiiSparseMatrixIterator& operator++ ()
+  {
+    if (isStored())
+      ++_iIndex;
+    if (++_iColumn == _pMatrix->columns())
+      {
+        _iColumn = 0;
+        ++_iRow;
+      }
+    return *this;
+  }
+
+  PiiSparseMatrixIterator& operator-- ()
+  {
+    if (_iColumn == 0)
+      {
+        --_iRow;
+        _iColumn = _pMatrix->columns() - 1;
+      }
+    else
+      --_iColumn;
+    if (_iIndex > _pMatrix->rowOffsets()[_iRow] &&
+        _pMatrix->columnIndices()[_iIndex-1] == _iColumn)
+      --_iIndex;
+    return *this;
+  }
+
+  PiiSparseMatrixIterator operator++ (int)
+  {
+    PiiSparseMatrixIterator tmp(*this);
+    ++(*this);
+    return tmp;
+  }
+
+  PiiSparseMatrixIterator operator-- (int)
+  {
+    PiiSparseMatrixIterator tmp(*this);
+    --(*this);
+    return tmp;
+  }
+
+  PiiSparseMatrixIterator& operator+= (difference_type amount)
+  {
+    const int iColumns = _pMatrix->columns();
+    if (iColumns == 0)
+      return *this;
+    difference_type iPos = position() + amount;
+    _iRow = int(iPos / iColumns);
+    _iColumn = int(iPos % iColumns);
+    _iIndex = _pMatrix->lowerBound(_iRow, _iColumn);
+    return *this;
+  }
+  PiiSparseMatrixIterator& operator-= (difference_type amount) { return operator+= (-amount); }
+
+  PiiSparseMatrixIterator operator+ (difference_type amount) const
+  {
+    PiiSparseMatrixIterator tmp(*this);
+    return tmp += amount;
+  }
+
+  PiiSparseMatrixIterator operator- (difference_type amount) const
+  {
+    PiiSparseMatrixIterator tmp(*this);
+    return tmp += -amount;
+  }
+
+  difference_type operator- (const PiiSparseMatrixIterator& other) const { return position() - other.position(); }
+
+  bool operator== (const PiiSparseMatrixIterator& other) const { return position() == other.position(); }
+  bool operator!= (const PiiSparseMatrixIterator& other) const { return position() != other.position(); }
+  bool operator< (const PiiSparseMatrixIterator& other) const { return position() < other.position(); }
+  bool operator> (const PiiSparseMatrixIterator& other) const { return position() > other.position(); }
+  bool operator<= (const PiiSparseMatrixIterator& other) const { return position() <= other.position(); }
+  bool operator>= (const PiiSparseMatrixIterator& other) const { return position() >= other.position(); }
+
+private:
+  difference_type position() const { return difference_type(_iRow) * _pMatrix->columns() + _iColumn; }
+  bool isStored() const
+  {
+    return _iIndex < _pMatrix->rowOffsets()[_iRow+1] &&
+      _pMatrix->columnIndices()[_iIndex] == _iColumn;
+  }
+
+  const PiiSparseMatrix<T>* _pMatrix;
+  int _iRow, _iColumn, _iIndex;
+};
+
+/// @internal
+template <class T> class PiiSparseColumnIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef std::ptrdiff_t difference_type;
+  typedef T value_type;
+  typedef const T* pointer;
+  typedef T reference;
+
+  PiiSparseColumnIterator(const PiiSparseMatrix<T>* matrix, int row, int column) :
+    _pMatrix(matrix), _iRow(row), _iColumn(column)
+  {}
+
+  T operator* () const { return _pMatrix->value(_iRow, _iColumn); }
+  T operator[] (int index) const { return _pMatrix->value(_iRow + index, _iColumn); }
+
+  PiiSparseColumnIterator& operator++ () { ++_iRow; return *this; }
+  PiiSparseColumnIterator& operator-- () { --_iRow; return *this; }
+  PiiSparseColumnIterator operator++ (int) { PiiSparseColumnIterator tmp(*this); ++_iRow; return tmp; }
+  PiiSparseColumnIterator operator-- (int) { PiiSparseColumnIterator tmp(*this); --_iRow; return tmp; }
+  PiiSparseColumnIterator& operator+= (difference_type amount) { _iRow += int(amount); return *this; }
+  PiiSparseColumnIterator& operator-= (difference_type amount) { _iRow -= int(amount); return *this; }
+  PiiSparseColumnIterator operator+ (difference_type amount) const { return PiiSparseColumnIterator(_pMatrix, _iRow + int(amount), _iColumn); }
+  PiiSparseColumnIterator operator- (difference_type amount) const { return PiiSparseColumnIterator(_pMatrix, _iRow - int(amount), _iColumn); }
+  difference_type operator- (const PiiSparseColumnIterator& other) const { return _iRow - other._iRow; }
+
+  bool operator== (const PiiSparseColumnIterator& other) const { return _iRow == other._iRow; }
+  bool operator!= (const PiiSparseColumnIterator& other) const { return _iRow != other._iRow; }
+  bool operator< (const PiiSparseColumnIterator& other) const { return _iRow < other._iRow; }
+
+private:
+  const PiiSparseMatrix<T>* _pMatrix;
+  int _iRow, _iColumn;
+};
+
+/// @hide
+template <class T> struct PiiMatrixTraits<PiiSparseMatrix<T> >
+{
+  enum { staticRows = -1, staticColumns = -1 };
+
+  typedef T value_type;
+  typedef T reference;
+  typedef PiiSparseMatrixIterator<T> const_iterator;
+  typedef const_iterator iterator;
+  typedef PiiSparseMatrixIterator<T> const_row_iterator;
+  typedef const_row_iterator row_iterator;
+  typedef PiiSparseColumnIterator<T> const_column_iterator;
+  typedef const_column_iterator column_iterator;
+};
+/// @endhide
+
+/**
+ * A sparse matrix in the compressed sparse row (CSR) format. Only
+ * non-zero elements are stored, which makes PiiSparseMatrix suitable
+ * for large, mostly empty matrices such as co-occurrence matrices,
+ * histograms with many unused bins and Hough accumulators.
+ *
+ * The non-zero elements are stored row by row in [values()]. The
+ * column of each element is stored in [columnIndices()], in
+ * increasing order within each row. The elements of row *r* are at
+ * indices [rowOffsets()][r] ... [rowOffsets()][r+1] - 1.
+ *
+ * PiiSparseMatrix models the matrix concept: its iterators scan all
+ * elements, zeros included, in row-major order. Therefore, it can be
+ * used as a read-only operand in any matrix expression. The iterators
+ * are much slower than direct access to the non-zero elements, which
+ * is used by conversions, products and the distance functions below.
+ * Once created, the elements cannot be modified one by one; build a
+ * new matrix instead.
+ *
+ * ~~~(c++)
+ * PiiMatrix<int> matDense(3,4,
+ *                         0, 0, 2, 0,
+ *                         0, 0, 0, 0,
+ *                         1, 0, 0, 3);
+ * PiiSparseMatrix<int> matSparse(matDense);
+ * // matSparse.values() = { 2, 1, 3 }
+ * // matSparse.columnIndices() = { 2, 0, 3 }
+ * // matSparse.rowOffsets() = { 0, 1, 1, 3 }
+ * PiiMatrix<int> matProduct = matSparse * Pii::transpose(matDense);
+ * int iSum = Pii::sum<int>(matSparse); // 6
+ * ~~~
+ */
+template <class T> class PiiSparseMatrix :
+  public PiiConceptualMatrix<PiiSparseMatrix<T> >
+{
+public:
+  typedef PiiConceptualMatrix<PiiSparseMatrix<T> > BaseType;
+  typedef PiiMatrixTraits<PiiSparseMatrix<T> > Traits;
+
+  /**
+   * Creates an empty matrix.
+   */
+  PiiSparseMatrix() : _iRows(0), _iColumns(0), _vecRowOffsets(1, 0) {}
+
+  /**
+   * Creates a *rows*-by-*columns* matrix with no non-zero elements.
+   */
+  PiiSparseMatrix(int rows, int columns) :
+    _iRows(qMax(rows, 0)), _iColumns(qMax(columns, 0)), _vecRowOffsets(_iRows + 1, 0)
+  {}
+
+  /**
+   * Creates a matrix out of CSR data. *rowOffsets* must contain
+   * *rows* + 1 increasing offsets, starting at zero and ending at the
+   * number of elements in *values*. *columnIndices* must be as long
+   * as *values* and its elements on each row must be in increasing
+   * order.
+   *
+   * @exception PiiInvalidArgumentException& if the data is not a
+   * valid CSR matrix.
+   */
+  PiiSparseMatrix(int rows, int columns,
+                  const QVector<int>& rowOffsets,
+                  const QVector<int>& columnIndices,
+                  const QVector<T>& values) :
+    _iRows(rows), _iColumns(columns),
+    _vecRowOffsets(rowOffsets),
+    _vecColumnIndices(columnIndices),
+    _vecValues(values)
+  {
+    if (!isValid(rows, columns, rowOffsets, columnIndices, values.size()))
+      PII_THROW(PiiInvalidArgumentException,
+                QCoreApplication::translate("PiiSparseMatrix", "Invalid compressed sparse row data."));
+  }
+
+  /**
+   * Converts any matrix to a sparse matrix. Only elements that are
+   * not equal to zero will be stored.
+   */
+  template <class Matrix> explicit PiiSparseMatrix(const PiiConceptualMatrix<Matrix>& other) :
+    _iRows(other.selfRef().rows()), _iColumns(other.selfRef().columns()),
+    _vecRowOffsets(_iRows + 1, 0)
+  {
+    const Matrix& mat = other.selfRef();
+    for (int r=0; r<_iRows; ++r)
+      {
+        typename Matrix::const_row_iterator row = mat.rowBegin(r);
+        for (int c=0; c<_iColumns; ++c, ++row)
+          {
+            T value(*row);
+            if (value != T(0))
+              {
+                _vecColumnIndices.append(c);
+                _vecValues.append(value);
+              }
+          }
+        _vecRowOffsets[r+1] = _vecValues.size();
+      }
+  }
+
+  /**
+   * Creates a matrix out of coordinate (row, column, value) triplets.
+   * The order of the triplets is arbitrary. Values at duplicate
+   * coordinates are summed, which makes this function suitable for
+   * collecting histograms. Elements that sum to zero are not stored.
+   *
+   * ~~~(c++)
+   * QVector<int> vecRows, vecColumns;
+   * QVector<int> vecOnes;
+   * for (int i=0; i<pixels.size()-1; ++i)
+   *   {
+   *     vecRows << pixels[i];
+   *     vecColumns << pixels[i+1];
+   *     vecOnes << 1;
+   *   }
+   * PiiSparseMatrix<int> matCooccurrence(PiiSparseMatrix<int>::fromTriplets(256, 256, vecRows, vecColumns, vecOnes));
+   * ~~~
+   *
+   * @exception PiiInvalidArgumentException& if the vectors are not
+   * equally long or a coordinate is out of range.
+   */
+  static PiiSparseMatrix fromTriplets(int rows, int columns,
+                                      const QVector<int>& rowIndices,
+                                      const QVector<int>& columnIndices,
+                                      const QVector<T>& values);
+
+  int rows() const { return _iRows; }
+  int columns() const { return _iColumns; }
+
+  /**
+   * Returns the number of stored (non-zero) elements.
+   */
+  int nonZeroCount() const { return _vecValues.size(); }
+  /**
+   * Returns the number of stored elements on row *r*.
+   */
+  int rowNonZeroCount(int r) const { return _vecRowOffsets[r+1] - _vecRowOffsets[r]; }
+  /**
+   * Returns a pointer to the column indices of the stored elements on
+   * row *r*.
+   */
+  const int* rowColumnIndices(int r) const { return _vecColumnIndices.constData() + _vecRowOffsets[r]; }
+  /**
+   * Returns a pointer to the stored elements on row *r*.
+   */
+  const T* rowValues(int r) const { return _vecValues.constData() + _vecRowOffsets[r]; }
+
+  const QVector<int>& rowOffsets() const { return _vecRowOffsets; }
+  const QVector<int>& columnIndices() const { return _vecColumnIndices; }
+  const QVector<T>& values() const { return _vecValues; }
+
+  /**
+   * Returns the value at (*r*, *c*). Takes a binary search over the
+   * stored elements on row *r*.
+   */
+  T value(int r, int c) const
+  {
+    int i = lowerBound(r, c);
+    return i < _vecRowOffsets[r+1] && _vecColumnIndices[i] == c ? _vecValues[i] : T(0);
+  }
+  T operator() (int r, int c) const { return value(r, c); }
+
+  typename Traits::const_iterator begin() const { return typename Traits::const_iterator(this, 0, 0); }
+  typename Traits::const_iterator end() const { return typename Traits::const_iterator(this, _iRows, 0); }
+  typename Traits::const_row_iterator rowBegin(int r) const { return typename Traits::const_row_iterator(this, r, 0); }
+  typename Traits::const_row_iterator rowEnd(int r) const { return typename Traits::const_row_iterator(this, r+1, 0); }
+  typename Traits::const_column_iterator columnBegin(int c) const { return typename Traits::const_column_iterator(this, 0, c); }
+  typename Traits::const_column_iterator columnEnd(int c) const { return typename Traits::const_column_iterator(this, _iRows, c); }
+
+  /**
+   * Converts the matrix to a dense one.
+   */
+  PiiMatrix<T> toDense() const
+  {
+    PiiMatrix<T> result(_iRows, _iColumns);
+    for (int r=0; r<_iRows; ++r)
+      {
+        T* pRow = result[r];
+        for (int i=_vecRowOffsets[r]; i<_vecRowOffsets[r+1]; ++i)
+          pRow[_vecColumnIndices[i]] = _vecValues[i];
+      }
+    return result;
+  }
+
+  /**
+   * Returns the transpose of this matrix as a new sparse matrix. The
+   * result is the same matrix in the compressed sparse column
+   * format.
+   */
+  PiiSparseMatrix transposed() const;
+
+  /// @internal
+  int lowerBound(int r, int c) const
+  {
+    if (r >= _iRows)
+      return _vecValues.size();
+    const int* pBegin = _vecColumnIndices.constData() + _vecRowOffsets[r];
+    const int* pEnd = _vecColumnIndices.constData() + _vecRowOffsets[r+1];
+    return int(std::lower_bound(pBegin, pEnd, c) - _vecColumnIndices.constData());
+  }
+
+  /// @internal
+  static bool isValid(int rows, int columns,
+                      const QVector<int>& rowOffsets,
+                      const QVector<int>& columnIndices,
+                      int count);
+
+private:
+  int _iRows, _iColumns;
+  QVector<int> _vecRowOffsets;
+  QVector<int> _vecColumnIndices;
+  QVector<T> _vecValues;
+};
+
+/// @hide
+namespace Pii
+{
+  struct SparseTripletLess
+  {
+    SparseTripletLess(const QVector<int>& rows, const QVector<int>& columns) :
+      _rows(rows), _columns(columns)
+    {}
+    bool operator() (int a, int b) const
+    {
+      return _rows[a] < _rows[b] || (_rows[a] == _rows[b] && _columns[a] < _columns[b]);
+    }
+    const QVector<int>& _rows;
+    const QVector<int>& _columns;
+  };
+}
+/// @endhide
+
+template <class T> bool PiiSparseMatrix<T>::isValid(int rows, int columns,
+                                                    const QVector<int>& rowOffsets,
+                                                    const QVector<int>& columnIndices,
+                                                    int count)
+{
+  if (rows < 0 || columns < 0 ||
+      rowOffsets.size() != rows + 1 ||
+      columnIndices.size() != count ||
+      rowOffsets[0] != 0 || rowOffsets[rows] != count)
+    return false;
+  for (int r=0; r<rows; ++r)
+    {
+      if (rowOffsets[r+1] < rowOffsets[r])
+        return false;
+      for (int i=rowOffsets[r]; i<rowOffsets[r+1]; ++i)
+        if (columnIndices[i] < 0 || columnIndices[i] >= columns ||
+            (i > rowOffsets[r] && columnIndices[i] <= columnIndices[i-1]))
+          return false;
+    }
+  return true;
+}
+
+template <class T> PiiSparseMatrix<T> PiiSparseMatrix<T>::fromTriplets(int rows, int columns,
+                                                                       const QVector<int>& rowIndices,
+                                                                       const QVector<int>& columnIndices,
+                                                                       const QVector<T>& values)
+{
+  const int iCount = values.size();
+  if (rowIndices.size() != iCount || columnIndices.size() != iCount)
+    PII_MATRIX_SIZE_MISMATCH;
+  for (int i=0; i<iCount; ++i)
+    if (rowIndices[i] < 0 || rowIndices[i] >= rows ||
+        columnIndices[i] < 0 || columnIndices[i] >= columns)
+      PII_THROW(PiiInvalidArgumentException,
+                QCoreApplication::translate("PiiSparseMatrix", "Element index out of range."));
+
+  QVector<int> vecOrder(iCount);
+  for (int i=0; i<iCount; ++i)
+    vecOrder[i] = i;
+  std::sort(vecOrder.begin(), vecOrder.end(), Pii::SparseTripletLess(rowIndices, columnIndices));
+
+  PiiSparseMatrix result(rows, columns);
+  for (int i=0; i<iCount; )
+    {
+      const int iRow = rowIndices[vecOrder[i]], iColumn = columnIndices[vecOrder[i]];
+      T sum(values[vecOrder[i]]);
+      for (++i; i<iCount && rowIndices[vecOrder[i]] == iRow && columnIndices[vecOrder[i]] == iColumn; ++i)
+        sum += values[vecOrder[i]];
+      if (sum != T(0))
+        {
+          result._vecColumnIndices.append(iColumn);
+          result._vecValues.append(sum);
+          ++result._vecRowOffsets[iRow+1];
+        }
+    }
+  for (int r=0; r<rows; ++r)
+    result._vecRowOffsets[r+1] += result._vecRowOffsets[r];
+  return result;
+}
+
+template <class T> PiiSparseMatrix<T> PiiSparseMatrix<T>::transposed() const
+{
+  PiiSparseMatrix result(_iColumns, _iRows);
+  const int iCount = _vecValues.size();
+  result._vecColumnIndices.resize(iCount);
+  result._vecValues.resize(iCount);
+  // Counting sort by column
+  for (int i=0; i<iCount; ++i)
+    ++result._vecRowOffsets[_vecColumnIndices[i]+1];
+  for (int c=0; c<_iColumns; ++c)
+    result._vecRowOffsets[c+1] += result._vecRowOffsets[c];
+  QVector<int> vecNext(result._vecRowOffsets);
+  for (int r=0; r<_iRows; ++r)
+    for (int i=_vecRowOffsets[r]; i<_vecRowOffsets[r+1]; ++i)
+      {
+        int iTarget = vecNext[_vecColumnIndices[i]]++;
+        result._vecColumnIndices[iTarget] = r;
+        result._vecValues[iTarget] = _vecValues[i];
+      }
+  return result;
+}
+
+namespace Pii
+{
+  /// @hide
+  /* Products with sparse operands skip zeros by looping over the
+     stored elements only. sparse * dense adds scaled rows of the
+     dense matrix to each row of the result, and dense * sparse
+     scatters each non-zero element of the dense row to the columns
+     of a sparse row. The rows of the result are independent and can
+     be calculated in parallel.
+   */
+  template <class Product, class Matrix1, class Matrix2, class Result> class SparseProductStrips
+  {
+  public:
+    SparseProductStrips(const Matrix1& m1, const Matrix2& m2, Result& result) :
+      _m1(m1), _m2(m2), _result(result)
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      for (int r=firstRow; r<endRow; ++r)
+        {
+          typename Result::value_type* pRow = _result[r];
+          std::fill(pRow, pRow + _result.columns(), typename Result::value_type(0));
+          Product::multiplyRow(_m1, _m2, r, pRow);
+        }
+    }
+
+  private:
+    const Matrix1& _m1;
+    const Matrix2& _m2;
+    Result& _result;
+  };
+
+  template <class Product, class Matrix1, class Matrix2, class Result>
+  void multiplySparse(const Matrix1& m1, const Matrix2& m2, Result& result, const PiiParallelPolicy& policy)
+  {
+    SparseProductStrips<Product, Matrix1, Matrix2, Result> strips(m1, m2, result);
+    forEachStrip(m1.rows(), strips, policy);
+  }
+
+  template <class U, class Matrix2, class T>
+  struct MatrixProduct<PiiSparseMatrix<U>, Matrix2, T, false>
+  {
+    template <class Result>
+    static void multiply(const PiiSparseMatrix<U>& m1, const Matrix2& m2, Result& result, const PiiParallelPolicy& policy)
+    {
+      multiplySparse<MatrixProduct>(m1, m2, result, policy);
+    }
+
+    static void multiplyRow(const PiiSparseMatrix<U>& m1, const Matrix2& m2, int r, T* result)
+    {
+      const int iColumns = m2.columns(), iCount = m1.rowNonZeroCount(r);
+      const int* pColumns = m1.rowColumnIndices(r);
+      const U* pValues = m1.rowValues(r);
+      for (int i=0; i<iCount; ++i)
+        {
+          const T value(pValues[i]);
+          typename Matrix2::const_row_iterator row = m2.rowBegin(pColumns[i]);
+          for (int c=0; c<iColumns; ++c, ++row)
+            result[c] += value * T(*row);
+        }
+    }
+  };
+
+  template <class Matrix1, class U, class T>
+  struct MatrixProduct<Matrix1, PiiSparseMatrix<U>, T, false>
+  {
+    template <class Result>
+    static void multiply(const Matrix1& m1, const PiiSparseMatrix<U>& m2, Result& result, const PiiParallelPolicy& policy)
+    {
+      multiplySparse<MatrixProduct>(m1, m2, result, policy);
+    }
+
+    static void multiplyRow(const Matrix1& m1, const PiiSparseMatrix<U>& m2, int r, T* result)
+    {
+      const int iInner = m1.columns();
+      typename Matrix1::const_row_iterator row = m1.rowBegin(r);
+      for (int k=0; k<iInner; ++k, ++row)
+        {
+          const T value(*row);
+          if (value == T(0))
+            continue;
+          const int iCount = m2.rowNonZeroCount(k);
+          const int* pColumns = m2.rowColumnIndices(k);
+          const U* pValues = m2.rowValues(k);
+          for (int i=0; i<iCount; ++i)
+            result[pColumns[i]] += value * T(pValues[i]);
+        }
+    }
+  };
+
+  template <class U, class V, class T>
+  struct MatrixProduct<PiiSparseMatrix<U>, PiiSparseMatrix<V>, T, false>
+  {
+    template <class Result>
+    static void multiply(const PiiSparseMatrix<U>& m1, const PiiSparseMatrix<V>& m2, Result& result, const PiiParallelPolicy& policy)
+    {
+      multiplySparse<MatrixProduct>(m1, m2, result, policy);
+    }
+
+    static void multiplyRow(const PiiSparseMatrix<U>& m1, const PiiSparseMatrix<V>& m2, int r, T* result)
+    {
+      const int iCount1 = m1.rowNonZeroCount(r);
+      const int* pColumns1 = m1.rowColumnIndices(r);
+      const U* pValues1 = m1.rowValues(r);
+      for (int i=0; i<iCount1; ++i)
+        {
+          const T value(pValues1[i]);
+          const int k = pColumns1[i], iCount2 = m2.rowNonZeroCount(k);
+          const int* pColumns2 = m2.rowColumnIndices(k);
+          const V* pValues2 = m2.rowValues(k);
+          for (int j=0; j<iCount2; ++j)
+            result[pColumns2[j]] += value * T(pValues2[j]);
+        }
+    }
+  };
+  /// @endhide
+
+  /**
+   * Returns the inner product of row *rowA* in *a* and row *rowB* in
+   * *b*. Only elements that are non-zero in both rows are visited.
+   */
+  template <class T, class U>
+  double sparseInnerProduct(const PiiSparseMatrix<T>& a, int rowA,
+                            const PiiSparseMatrix<U>& b, int rowB)
+  {
+    const int* pColumnsA = a.rowColumnIndices(rowA), *pColumnsB = b.rowColumnIndices(rowB);
+    const T* pValuesA = a.rowValues(rowA);
+    const U* pValuesB = b.rowValues(rowB);
+    const int iCountA = a.rowNonZeroCount(rowA), iCountB = b.rowNonZeroCount(rowB);
+    double dSum = 0;
+    for (int i=0, j=0; i<iCountA && j<iCountB; )
+      {
+        if (pColumnsA[i] < pColumnsB[j])
+          ++i;
+        else if (pColumnsB[j] < pColumnsA[i])
+          ++j;
+        else
+          dSum += double(pValuesA[i++]) * double(pValuesB[j++]);
+      }
+    return dSum;
+  }
+
+  /**
+   * Returns the inner product of row *row* in *a* and a dense vector
+   * starting at *dense*. Only the non-zero elements of the sparse row
+   * are visited.
+   */
+  template <class T, class RandomAccessIterator>
+  double sparseInnerProduct(const PiiSparseMatrix<T>& a, int row, RandomAccessIterator dense)
+  {
+    const int* pColumns = a.rowColumnIndices(row);
+    const T* pValues = a.rowValues(row);
+    double dSum = 0;
+    for (int i=a.rowNonZeroCount(row); i--; )
+      dSum += double(pValues[i]) * double(dense[pColumns[i]]);
+    return dSum;
+  }
+
+  /**
+   * Returns the squared geometric distance between row *rowA* in *a*
+   * and row *rowB* in *b* (see PiiSquaredGeometricDistance). Elements
+   * that are zero in both rows are skipped.
+   */
+  template <class T, class U>
+  double sparseSquaredDistance(const PiiSparseMatrix<T>& a, int rowA,
+                               const PiiSparseMatrix<U>& b, int rowB)
+  {
+    const int* pColumnsA = a.rowColumnIndices(rowA), *pColumnsB = b.rowColumnIndices(rowB);
+    const T* pValuesA = a.rowValues(rowA);
+    const U* pValuesB = b.rowValues(rowB);
+    const int iCountA = a.rowNonZeroCount(rowA), iCountB = b.rowNonZeroCount(rowB);
+    double dSum = 0;
+    int i = 0, j = 0;
+    while (i<iCountA && j<iCountB)
+      {
+        if (pColumnsA[i] < pColumnsB[j])
+          dSum += square(double(pValuesA[i++]));
+        else if (pColumnsB[j] < pColumnsA[i])
+          dSum += square(double(pValuesB[j++]));
+        else
+          dSum += square(double(pValuesA[i++]) - double(pValuesB[j++]));
+      }
+    for (; i<iCountA; ++i) dSum += square(double(pValuesA[i]));
+    for (; j<iCountB; ++j) dSum += square(double(pValuesB[j]));
+    return dSum;
+  }
+
+  /**
+   * Returns the sum of absolute differences between row *rowA* in *a*
+   * and row *rowB* in *b* (see PiiAbsDiffDistance). Elements that are
+   * zero in both rows are skipped.
+   */
+  template <class T, class U>
+  double sparseAbsDiffDistance(const PiiSparseMatrix<T>& a, int rowA,
+                               const PiiSparseMatrix<U>& b, int rowB)
+  {
+    const int* pColumnsA = a.rowColumnIndices(rowA), *pColumnsB = b.rowColumnIndices(rowB);
+    const T* pValuesA = a.rowValues(rowA);
+    const U* pValuesB = b.rowValues(rowB);
+    const int iCountA = a.rowNonZeroCount(rowA), iCountB = b.rowNonZeroCount(rowB);
+    double dSum = 0;
+    int i = 0, j = 0;
+    while (i<iCountA && j<iCountB)
+      {
+        if (pColumnsA[i] < pColumnsB[j])
+          dSum += std::fabs(double(pValuesA[i++]));
+        else if (pColumnsB[j] < pColumnsA[i])
+          dSum += std::fabs(double(pValuesB[j++]));
+        else
+          dSum += std::fabs(double(pValuesA[i++]) - double(pValuesB[j++]));
+      }
+    for (; i<iCountA; ++i) dSum += std::fabs(double(pValuesA[i]));
+    for (; j<iCountB; ++j) dSum += std::fabs(double(pValuesB[j]));
+    return dSum;
+  }
+}
+
+#endif //_PIISPARSEMATRIX_H
@@ -205,6 +205,11 @@ public:
   int rows() const { return _matrix.columns(); }
   int columns() const { return _matrix.rows(); }
 
+  /**
+   * Returns the original, untransposed matrix.
+   */
+  const Matrix& matrix() const { return _matrix; }
+
 private:
   Matrix _matrix;
 };
@@ -224,6 +229,21 @@ namespace Pii
   {
     return PiiTransposedMatrix<Matrix>(mat.selfRef());
   }
+
+  /// @hide
+  // The transpose of a directly accessible matrix is accessible by
+  // exchanging the strides.
+  template <class Matrix> struct StridedAccess<PiiTransposedMatrix<Matrix> >
+  {
+    enum { supported = StridedAccess<Matrix>::supported };
+    template <class T>
+    static bool get(const PiiTransposedMatrix<Matrix>& mat, const T*& data,
+                    std::ptrdiff_t& rowStride, std::ptrdiff_t& columnStride)
+    {
+      return StridedAccess<Matrix>::get(mat.matrix(), data, columnStride, rowStride);
+    }
+  };
+  /// @endhide
 }
 
 #endif //_PII_TRANSPOSEDMATRIX_H
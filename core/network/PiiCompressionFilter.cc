@@ -0,0 +1,175 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCompressionFilter.h"
+
+#include <QStringList>
+
+#ifndef PII_NO_ZLIB
+#  include <zlib.h>
+#endif
+
+class PiiCompressionFilter::Data : public PiiDefaultStreamFilter::Data
+{
+public:
+  Data(Format f) : format(f), bInitialized(false), bFinished(false) {}
+
+  Format format;
+  bool bInitialized, bFinished;
+#ifndef PII_NO_ZLIB
+  z_stream stream;
+#endif
+};
+
+inline PiiCompressionFilter::Data* PiiCompressionFilter::_d() { return static_cast<Data*>(PiiStreamFilter::d); }
+inline const PiiCompressionFilter::Data* PiiCompressionFilter::_d() const { return static_cast<const Data*>(PiiStreamFilter::d); }
+
+PiiCompressionFilter::PiiCompressionFilter(Format format, int level) :
+  PiiDefaultStreamFilter(new Data(format))
+{
+#ifndef PII_NO_ZLIB
+  Data* d = _d();
+  d->stream.zalloc = Z_NULL;
+  d->stream.zfree = Z_NULL;
+  d->stream.opaque = Z_NULL;
+  // 15 is the maximum window size. Adding 16 makes zlib write a gzip
+  // header and trailer instead of its own.
+  d->bInitialized = deflateInit2(&d->stream, qBound(-1, level, 9), Z_DEFLATED,
+                                 format == GzipFormat ? 15 + 16 : 15,
+                                 8, Z_DEFAULT_STRATEGY) == Z_OK;
+  if (!d->bInitialized)
+    piiWarning("Cannot initialize zlib. Data will not be compressed.");
+#else
+  Q_UNUSED(level);
+#endif
+}
+
+PiiCompressionFilter::~PiiCompressionFilter()
+{
+#ifndef PII_NO_ZLIB
+  if (_d()->bInitialized)
+    deflateEnd(&_d()->stream);
+#endif
+}
+
+qint64 PiiCompressionFilter::compress(const char* data, qint64 size, int flush)
+{
+#ifndef PII_NO_ZLIB
+  Data* d = _d();
+  char buffer[16384];
+  qint64 iTotalBytes = 0;
+  d->stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  d->stream.avail_in = uInt(size);
+  do
+    {
+      d->stream.next_out = reinterpret_cast<Bytef*>(buffer);
+      d->stream.avail_out = sizeof(buffer);
+      if (deflate(&d->stream, flush) == Z_STREAM_ERROR)
+        return -1;
+      qint64 iBytes = qint64(sizeof(buffer) - d->stream.avail_out);
+      if (iBytes > 0)
+        {
+          if (d->pOutputFilter == 0 ||
+              d->pOutputFilter->filterData(buffer, iBytes) != iBytes)
+            return -1;
+          iTotalBytes += iBytes;
+        }
+    }
+  // A full output buffer means there may be more to come.
+  while (d->stream.avail_out == 0);
+  return iTotalBytes;
+#else
+  Q_UNUSED(data);
+  Q_UNUSED(size);
+  Q_UNUSED(flush);
+  return -1;
+#endif
+}
+
+qint64 PiiCompressionFilter::filterData(const char* data, qint64 maxSize)
+{
+  Data* d = _d();
+  if (!d->bInitialized)
+    return d->pOutputFilter != 0 ? d->pOutputFilter->filterData(data, maxSize) : -1;
+  if (d->bFinished)
+    return -1;
+#ifndef PII_NO_ZLIB
+  // zlib counts input in uInts.
+  const qint64 iMaxPiece = 1 << 30;
+  for (qint64 i=0; i<maxSize; i+=iMaxPiece)
+    if (compress(data + i, qMin(maxSize - i, iMaxPiece), Z_NO_FLUSH) < 0)
+      return -1;
+#endif
+  return maxSize;
+}
+
+qint64 PiiCompressionFilter::flushFilter()
+{
+  Data* d = _d();
+  if (!d->bInitialized || d->bFinished)
+    return 0;
+  d->bFinished = true;
+#ifndef PII_NO_ZLIB
+  return compress(0, 0, Z_FINISH);
+#else
+  return 0;
+#endif
+}
+
+PiiCompressionFilter::Format PiiCompressionFilter::format() const { return _d()->format; }
+
+QString PiiCompressionFilter::encodingName(Format format)
+{
+  return format == GzipFormat ? "gzip" : "deflate";
+}
+
+bool PiiCompressionFilter::negotiate(const QString& acceptEncoding, Format* format)
+{
+#ifndef PII_NO_ZLIB
+  // Quality values for gzip, deflate and the wildcard. -1 means "not
+  // mentioned".
+  double dGzip = -1, dDeflate = -1, dAny = -1;
+  QStringList lstCodings = acceptEncoding.split(',', QString::SkipEmptyParts);
+  for (int i=0; i<lstCodings.size(); ++i)
+    {
+      QStringList lstParts = lstCodings[i].split(';');
+      QString strCoding = lstParts[0].trimmed().toLower();
+      double dQuality = 1;
+      for (int j=1; j<lstParts.size(); ++j)
+        {
+          QString strParam = lstParts[j].trimmed();
+          if (strParam.startsWith("q="))
+            dQuality = strParam.mid(2).toDouble();
+        }
+      if (strCoding == "gzip" || strCoding == "x-gzip")
+        dGzip = dQuality;
+      else if (strCoding == "deflate")
+        dDeflate = dQuality;
+      else if (strCoding == "*")
+        dAny = dQuality;
+    }
+  if (dGzip < 0) dGzip = dAny;
+  if (dDeflate < 0) dDeflate = dAny;
+
+  if (dGzip <= 0 && dDeflate <= 0)
+    return false;
+  *format = dGzip >= dDeflate ? GzipFormat : DeflateFormat;
+  return true;
+#else
+  Q_UNUSED(acceptEncoding);
+  Q_UNUSED(format);
+  return false;
+#endif
+}
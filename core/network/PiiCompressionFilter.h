@@ -0,0 +1,112 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICOMPRESSIONFILTER_H
+#define _PIICOMPRESSIONFILTER_H
+
+#include "PiiStreamFilter.h"
+
+/**
+ * An output filter that compresses data with zlib before passing it
+ * to the next filter. The filter is usually not created directly,
+ * but through [PiiHttpDevice::startOutputCompression()], which sets
+ * the Content-Encoding header according to the client's
+ * Accept-Encoding header.
+ *
+ * ~~~(c++)
+ * void MyHandler::handleRequest(const QString& uri,
+ *                               PiiHttpDevice* h,
+ *                               PiiProgressController* controller)
+ * {
+ *   // Buffer the compressed data to get a correct Content-Length.
+ *   h->startOutputFiltering(new PiiStreamBuffer);
+ *   h->startOutputCompression();
+ *   h->print(PiiNetwork::toJson(resultList()));
+ * }
+ * ~~~
+ *
+ * Compressed data is passed on in blocks as soon as zlib produces
+ * it. If the filter writes directly to PiiHttpDevice, the response
+ * is sent with chunked transfer coding, and the body is never held
+ * in memory as a whole.
+ *
+ * If Into is built with `DISABLE+=zlib`, no compression algorithms
+ * are available, and the filter passes data through as such.
+ */
+class PII_NETWORK_EXPORT PiiCompressionFilter : public PiiDefaultStreamFilter
+{
+public:
+  /**
+   * Compressed data formats.
+   *
+   * - `DeflateFormat` - zlib format (RFC 1950). This is what
+   * "Content-Encoding: deflate" means in HTTP.
+   *
+   * - `GzipFormat` - gzip format (RFC 1952).
+   */
+  enum Format { DeflateFormat, GzipFormat };
+
+  /**
+   * Creates a new compression filter that writes data in the given
+   * *format*. *level* is a zlib compression level (0-9), or -1 for
+   * the default level.
+   */
+  PiiCompressionFilter(Format format = GzipFormat, int level = -1);
+  ~PiiCompressionFilter();
+
+  /**
+   * Compresses *maxSize* bytes of *data* and writes whatever output
+   * is ready to the output filter. Returns *maxSize* on success and
+   * -1 on failure.
+   */
+  qint64 filterData(const char* data, qint64 maxSize);
+
+  /**
+   * Finishes the compressed stream and writes the rest of the data
+   * to the output filter. No data can be compressed after this.
+   * Returns the number of bytes written, or -1 on failure.
+   */
+  qint64 flushFilter();
+
+  /**
+   * Returns the data format.
+   */
+  Format format() const;
+
+  /**
+   * Returns the HTTP content coding of *format*, i.e. "deflate" or
+   * "gzip".
+   */
+  static QString encodingName(Format format);
+
+  /**
+   * Chooses a compression format based on an Accept-Encoding header
+   * value. Gzip is preferred over deflate if the client accepts both
+   * with the same quality value. Returns `true` and stores the
+   * format to *format* if a supported coding is accepted, and
+   * `false` otherwise.
+   */
+  static bool negotiate(const QString& acceptEncoding, Format* format);
+
+private:
+  /// @internal
+  class Data;
+  inline Data* _d();
+  inline const Data* _d() const;
+
+  qint64 compress(const char* data, qint64 size, int flush);
+};
+
+#endif //_PIICOMPRESSIONFILTER_H
@@ -38,7 +38,9 @@ PiiFileSystemUriHandler::Data::Data(const QString& fileSystemRoot) :
   bShowHiddenFiles(false),
   pMimeTypeMap(&defaultMimeTypeMap),
   defaultDirectoryListFormat(HtmlFormat),
-  bLockFiles(false)
+  bLockFiles(false),
+  fileCache(4*1024*1024),
+  iMaxCachedFileSize(64*1024)
 {
   ensureTrainingSlash();
   lstAllowedMethods << "GET" << "HEAD";
@@ -60,6 +62,120 @@ PiiFileSystemUriHandler::~PiiFileSystemUriHandler()
   delete d;
 }
 
+namespace
+{
+  enum RangeType { NoRange, ValidRange, UnsatisfiableRange };
+
+  /* Parses a single byte range from a Range header. Multiple ranges
+     are not supported; such requests are answered with the whole
+     file, which is allowed by RFC 7233.
+   */
+  RangeType parseRange(const QString& range, qint64 size, qint64* start, qint64* length)
+  {
+    if (!range.startsWith("bytes=") || range.contains(','))
+      return NoRange;
+    QString strSpec = range.mid(6).trimmed();
+    int iDash = strSpec.indexOf('-');
+    if (iDash == -1)
+      return NoRange;
+    QString strFirst = strSpec.left(iDash).trimmed(), strLast = strSpec.mid(iDash+1).trimmed();
+    bool bFirstOk = true, bLastOk = true;
+    if (strFirst.isEmpty())
+      {
+        // bytes=-N means the last N bytes.
+        qint64 iSuffix = strLast.toLongLong(&bLastOk);
+        if (!bLastOk || iSuffix < 0)
+          return NoRange;
+        if (iSuffix == 0 || size == 0)
+          return UnsatisfiableRange;
+        *length = qMin(iSuffix, size);
+        *start = size - *length;
+        return ValidRange;
+      }
+    qint64 iFirst = strFirst.toLongLong(&bFirstOk);
+    qint64 iLast = strLast.isEmpty() ? size - 1 : strLast.toLongLong(&bLastOk);
+    if (!bFirstOk || !bLastOk || iFirst < 0 || (!strLast.isEmpty() && iLast < iFirst))
+      return NoRange;
+    if (iFirst >= size)
+      return UnsatisfiableRange;
+    *start = iFirst;
+    *length = qMin(iLast, size - 1) - iFirst + 1;
+    return ValidRange;
+  }
+
+  // Size and modification time identify a version of the file well
+  // enough for caching and resuming downloads.
+  QString entityTag(qint64 size, const QDateTime& modTime)
+  {
+    return QString("\"%1-%2\"").arg(size, 0, 16).arg(modTime.toMSecsSinceEpoch(), 0, 16);
+  }
+
+  bool matchesTag(const QString& tags, const QString& tag)
+  {
+    QStringList lstTags = tags.split(',', QString::SkipEmptyParts);
+    for (int i=0; i<lstTags.size(); ++i)
+      {
+        QString strTag = lstTags[i].trimmed();
+        // If-None-Match uses weak comparison.
+        if (strTag.startsWith("W/"))
+          strTag.remove(0, 2);
+        if (strTag == "*" || strTag == tag)
+          return true;
+      }
+    return false;
+  }
+}
+
+void PiiFileSystemUriHandler::lockFile(QFile& file)
+{
+#ifdef Q_OS_LINUX
+  if (d->bLockFiles && flock(file.handle(), LOCK_SH) == -1)
+    piiWarning(tr("Cannot obtain a shared lock for %1.").arg(file.fileName()));
+#else
+  Q_UNUSED(file);
+#endif
+}
+
+void PiiFileSystemUriHandler::unlockFile(QFile& file)
+{
+#ifdef Q_OS_LINUX
+  if (d->bLockFiles && flock(file.handle(), LOCK_UN) == -1)
+    piiWarning(tr("Cannot unlock %1.").arg(file.fileName()));
+#else
+  Q_UNUSED(file);
+#endif
+}
+
+QByteArray PiiFileSystemUriHandler::cachedFile(const QString& fileName,
+                                               const QDateTime& modTime,
+                                               qint64 size)
+{
+  synchronized (d->cacheMutex)
+    {
+      Data::CachedFile* pCached = d->fileCache.object(fileName);
+      if (pCached != 0 && pCached->modTime == modTime && pCached->aData.size() == size)
+        return pCached->aData;
+    }
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  lockFile(file);
+  QByteArray aData(file.readAll());
+  unlockFile(file);
+
+  // The file may have changed after it was stat'ed. Serve what was
+  // read, but don't cache it with the wrong time stamp.
+  if (aData.size() == size)
+    {
+      Data::CachedFile* pCached = new Data::CachedFile;
+      pCached->modTime = modTime;
+      pCached->aData = aData;
+      synchronized (d->cacheMutex) d->fileCache.insert(fileName, pCached, aData.size());
+    }
+  return aData;
+}
+
 void PiiFileSystemUriHandler::getFile(const QString& fileName,
                                       PiiHttpDevice* dev,
                                       PiiHttpProtocol::TimeLimiter* controller)
@@ -68,47 +184,80 @@ void PiiFileSystemUriHandler::getFile(const QString& fileName,
     PII_THROW_HTTP_ERROR(MethodNotAllowedStatus);
   QFileInfo info(fileName);
   if ((!d->bFollowSymLinks && info.isSymLink()) ||
-      (!d->bShowHiddenFiles && info.isHidden()))
+      (!d->bShowHiddenFiles && info.isHidden()) ||
+      !info.isFile() || !info.isReadable())
     PII_THROW_HTTP_ERROR(NotFoundStatus);
 
-  QFile file(fileName);
-  if (!file.open(QIODevice::ReadOnly))
-    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  const qint64 iSize = info.size();
+  const QDateTime fileTime(info.lastModified().toUTC());
+  // HTTP time stamps have a resolution of one second.
+  const QDateTime modTime(fileTime.addMSecs(-fileTime.time().msec()));
+  const QString strETag(entityTag(iSize, fileTime));
+  const PiiHttpRequestHeader requestHeader(dev->requestHeader());
 
-  QDateTime modTime(info.lastModified().toUTC());
+  dev->setHeader("Last-Modified", PiiHttpProtocol::timeToString(modTime));
+  dev->setHeader("ETag", strETag);
+  dev->setHeader("Accept-Ranges", "bytes");
+
+  // If the client already has the file, we don't need to send it at
+  // all. If-None-Match takes precedence over If-Modified-Since.
+  QString strNoneMatch = requestHeader.value("If-None-Match");
+  QString strReqTime = requestHeader.value("If-Modified-Since");
+  if (!strNoneMatch.isEmpty() ?
+      matchesTag(strNoneMatch, strETag) :
+      (!strReqTime.isEmpty() && PiiHttpProtocol::stringToTime(strReqTime) >= modTime))
+    {
+      dev->setHeader("Date", PiiHttpProtocol::timeToString(QDateTime::currentDateTime()));
+      PII_THROW_HTTP_ERROR(NotModifiedStatus);
+    }
 
-  // If the client gave us an If-Modified-Since header, we may not
-  // need to send the file at all.
-  QString strReqTime = dev->requestHeader().value("If-Modified-Since");
-  if (!strReqTime.isEmpty())
+  qint64 iStart = 0, iLength = iSize;
+  QString strRange = requestHeader.value("Range");
+  QString strIfRange = requestHeader.value("If-Range");
+  // With If-Range, a changed file is sent as a whole.
+  if (!strRange.isEmpty() &&
+      (strIfRange.isEmpty() ||
+       strIfRange == strETag ||
+       strIfRange == PiiHttpProtocol::timeToString(modTime)))
     {
-      QDateTime reqTime(PiiHttpProtocol::stringToTime(strReqTime));
-      if (reqTime >= modTime)
+      switch (parseRange(strRange, iSize, &iStart, &iLength))
         {
-          dev->setHeader("Date", PiiHttpProtocol::timeToString(QDateTime::currentDateTime()));
-          PII_THROW_HTTP_ERROR(NotModifiedStatus);
+        case ValidRange:
+          dev->setStatus(PiiHttpProtocol::PartialContentStatus);
+          dev->setHeader("Content-Range", QString("bytes %1-%2/%3")
+                         .arg(iStart).arg(iStart + iLength - 1).arg(iSize));
+          break;
+        case UnsatisfiableRange:
+          dev->setHeader("Content-Range", QString("bytes */%1").arg(iSize));
+          PII_THROW_HTTP_ERROR(RequestedRangeNotSatisfiableStatus);
+        case NoRange:
+          break;
         }
     }
 
-  qint64 iSize = info.size();
-  dev->setHeader("Last-Modified", PiiHttpProtocol::timeToString(modTime));
-  dev->setHeader("Content-Length", iSize);
+  dev->setHeader("Content-Length", iLength);
   dev->setHeader("Content-Type", d->pMimeTypeMap->typeForExtension(info.suffix()));
-  // PENDING Range
   if (dev->requestMethod() == "HEAD")
     return;
 
-#ifdef Q_OS_LINUX
-  bool bLock = d->bLockFiles;
-  if (bLock && flock(file.handle(), LOCK_SH) == -1)
-    piiWarning(tr("Cannot obtain a shared lock for %1.").arg(file.fileName()));
-#endif
-  // Read file contents and pass to the socket.
-  PiiNetwork::passData(&file, dev, iSize, controller);
-#ifdef Q_OS_LINUX
-  if (bLock && flock(file.handle(), LOCK_UN) == -1)
-    piiWarning(tr("Cannot unlock %1.").arg(file.fileName()));
-#endif
+  if (iSize <= d->iMaxCachedFileSize && cacheSize() > 0)
+    {
+      QByteArray aData(cachedFile(fileName, fileTime, iSize));
+      if (iStart + iLength <= aData.size())
+        dev->write(aData.constData() + iStart, iLength);
+      return;
+    }
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+
+  lockFile(file);
+  // Pass file contents to the socket, bypassing user space if
+  // possible. The device already reports to *controller*.
+  Q_UNUSED(controller);
+  dev->sendFile(&file, iStart, iLength);
+  unlockFile(file);
 }
 
 void PiiFileSystemUriHandler::putFile(const QString& fileName,
@@ -499,3 +648,18 @@ bool PiiFileSystemUriHandler::lockFiles() const { return d->bLockFiles; }
 
 void PiiFileSystemUriHandler::setAllowedMethods(const QStringList& allowedMethods) { d->lstAllowedMethods = allowedMethods; }
 QStringList PiiFileSystemUriHandler::allowedMethods() const { return d->lstAllowedMethods; }
+
+void PiiFileSystemUriHandler::setCacheSize(int cacheSize)
+{
+  QMutexLocker lock(&d->cacheMutex);
+  d->fileCache.setMaxCost(qMax(0, cacheSize));
+}
+
+int PiiFileSystemUriHandler::cacheSize() const
+{
+  QMutexLocker lock(&d->cacheMutex);
+  return d->fileCache.maxCost();
+}
+
+void PiiFileSystemUriHandler::setMaxCachedFileSize(int maxCachedFileSize) { d->iMaxCachedFileSize = maxCachedFileSize; }
+int PiiFileSystemUriHandler::maxCachedFileSize() const { return d->iMaxCachedFileSize; }
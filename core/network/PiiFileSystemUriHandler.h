@@ -21,6 +21,11 @@
 
 #include <QObject>
 #include <QFileInfoList>
+#include <QDateTime>
+#include <QCache>
+#include <QMutex>
+
+class QFile;
 
 /**
  * A URI handler for PiiHttpProtocol that maps request URIs to files.
@@ -50,6 +55,13 @@
  * file uploads, this directory should be on the same mounted file
  * system as the target directory.
  *
+ * Files are sent with ETag and Last-Modified headers. Requests with a
+ * matching If-None-Match or If-Modified-Since header are answered
+ * with 304 (Not Modified). Single byte ranges (e.g. "Range:
+ * bytes=1000-") are supported for resuming downloads and seeking in
+ * videos. On Linux, file contents are passed to the socket with
+ * `sendfile()` without copying them through user space. Small files
+ * are served from an in-memory cache (see [cacheSize]).
  */
 class PII_NETWORK_EXPORT PiiFileSystemUriHandler :
   public QObject,
@@ -115,6 +127,21 @@ class PII_NETWORK_EXPORT PiiFileSystemUriHandler :
    */
   Q_PROPERTY(QStringList allowedMethods READ allowedMethods WRITE setAllowedMethods);
 
+  /**
+   * The maximum total size of cached files, in bytes. Files no larger
+   * than [maxCachedFileSize] are kept in memory after the first
+   * request and served from there as long as their size and
+   * modification time don't change. The least recently used files
+   * are dropped first. The default is 4 MB. Zero disables the cache.
+   */
+  Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize);
+
+  /**
+   * The size of the largest file that will be cached, in bytes. The
+   * default is 64 kB.
+   */
+  Q_PROPERTY(int maxCachedFileSize READ maxCachedFileSize WRITE setMaxCachedFileSize);
+
 public:
   /**
    * Supported automatic directory list formats.
@@ -152,6 +179,10 @@ public:
   bool lockFiles() const;
   void setAllowedMethods(const QStringList& allowedMethods);
   QStringList allowedMethods() const;
+  void setCacheSize(int cacheSize);
+  int cacheSize() const;
+  void setMaxCachedFileSize(int maxCachedFileSize);
+  int maxCachedFileSize() const;
 
 private:
   class Data
@@ -170,8 +201,20 @@ private:
     DirectoryListFormat defaultDirectoryListFormat;
     bool bLockFiles;
     QStringList lstAllowedMethods;
+
+    struct CachedFile
+    {
+      QDateTime modTime;
+      QByteArray aData;
+    };
+    mutable QMutex cacheMutex; // Must be held when accessing fileCache
+    QCache<QString,CachedFile> fileCache;
+    int iMaxCachedFileSize;
   } *d;
 
+  QByteArray cachedFile(const QString& fileName, const QDateTime& modTime, qint64 size);
+  void lockFile(QFile& file);
+  void unlockFile(QFile& file);
   void getFile(const QString& fileName, PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller);
   void putFile(const QString& fileName, PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller);
   void deleteFile(const QString& fileName, PiiHttpDevice* dev);
@@ -17,8 +17,10 @@
 #include "PiiHttpProtocol.h"
 #include "PiiMimeHeader.h"
 #include "PiiMimeException.h"
+#include "PiiCompressionFilter.h"
 
 #include <QUrl>
+#include <QFile>
 #include <QBuffer>
 #include <QTextCodec>
 #include <QAbstractSocket>
@@ -49,7 +51,10 @@ PiiHttpDevice::Data::Data(PiiHttpDevice* owner, const PiiSocketDevice& device, M
   bFinished(false),
   iBodyLength(-1),
   iHeaderLength(-1),
-  iDataTimeout(5000)
+  iDataTimeout(5000),
+  bChunkedOutput(false),
+  bChunkedInput(false),
+  iChunkBytesLeft(-1)
 {
 }
 
@@ -95,6 +100,9 @@ void PiiHttpDevice::finish()
             setHeader("Content-Length", 0);
           sendHeader();
         }
+      // The last chunk is empty.
+      else if (d->bChunkedOutput)
+        writeToSocket("0\r\n\r\n", 5);
 
       // Flush the device if it is still connected
       if (d->pSocket->bytesToWrite() > 0 && isWritable())
@@ -247,9 +255,38 @@ qint64 PiiHttpDevice::filterData(const char* data, qint64 maxSize)
 {
   // Must ensure that headers are sent first.
   sendHeader();
+  if (_d()->bChunkedOutput)
+    return writeChunk(data, maxSize);
   return writeToSocket(data, maxSize);
 }
 
+qint64 PiiHttpDevice::writeChunk(const char* data, qint64 maxSize)
+{
+  // An empty chunk would end the body.
+  if (maxSize <= 0)
+    return 0;
+  QByteArray aSize(QByteArray::number(maxSize, 16) + "\r\n");
+  if (writeToSocket(aSize.constData(), aSize.size()) != aSize.size())
+    return -1;
+  qint64 iBytesWritten = writeToSocket(data, maxSize);
+  if (iBytesWritten != maxSize || writeToSocket("\r\n", 2) != 2)
+    return -1;
+  return iBytesWritten;
+}
+
+bool PiiHttpDevice::startOutputCompression(int level)
+{
+  PII_D;
+  PiiCompressionFilter::Format format;
+  if (d->mode != Server || d->bHeaderSent ||
+      !PiiCompressionFilter::negotiate(d->requestHeader.value("Accept-Encoding"), &format))
+    return false;
+  setHeader("Content-Encoding", PiiCompressionFilter::encodingName(format));
+  setHeader("Vary", "Accept-Encoding");
+  startOutputFiltering(new PiiCompressionFilter(format, level));
+  return true;
+}
+
 PiiStreamFilter* PiiHttpDevice::outputFilter() const
 {
   return _d()->pActiveOutputFilter;
@@ -271,7 +308,9 @@ void PiiHttpDevice::endOutputFiltering(PiiStreamFilter* filter)
       if (tmpFilter->outputFilter() == this && iBufferedSize >= 0)
         setHeader("Content-Length", iBufferedSize);
 
-      if (iBufferedSize != tmpFilter->flushFilter())
+      // A filter that doesn't know its size may still fail.
+      qint64 iBytesFlushed = tmpFilter->flushFilter();
+      if (iBytesFlushed < 0 || (iBufferedSize >= 0 && iBufferedSize != iBytesFlushed))
         piiWarning("Output filter could not write all buffered data.");
       d->pActiveOutputFilter = tmpFilter->outputFilter();
 
@@ -543,6 +582,29 @@ qint64 PiiHttpDevice::print(const QString& msg)
   return write(encode(msg));
 }
 
+qint64 PiiHttpDevice::sendFile(QFile* file, qint64 offset, qint64 length)
+{
+  PII_D;
+  if (length <= 0)
+    return 0;
+  if (d->pActiveOutputFilter == this && file->handle() != -1)
+    {
+      // Sending the header decides whether the body will be chunked.
+      if (!sendHeader())
+        return -1;
+    }
+  if (d->pActiveOutputFilter == this && file->handle() != -1 && !d->bChunkedOutput)
+    {
+      qint64 iBytesSent = d->pSocket.sendFile(file->handle(), offset, length,
+                                              d->iDataTimeout, d->pController);
+      if (iBytesSent != -1)
+        return iBytesSent;
+    }
+  if (!file->seek(offset))
+    return -1;
+  return PiiNetwork::passData(file, this, length, d->pController);
+}
+
 qint64 PiiHttpDevice::writeData(const char* bytes, qint64 maxSize)
 {
   // Write data to the active output filter
@@ -577,6 +639,15 @@ qint64 PiiHttpDevice::readData(char* bytes, qint64 maxSize)
       maxSize = qMin(iBytesLeft, maxSize);
     }
 
+  if (d->bChunkedInput)
+    return readChunked(bytes, maxSize);
+
+  return readFromSocket(bytes, maxSize);
+}
+
+qint64 PiiHttpDevice::readFromSocket(char* bytes, qint64 maxSize)
+{
+  PII_D;
   /*piiDebug("PiiHttpDevice::readData(%d). d->pSocket->bytesAvailable() = %d, QIODevice::bytesAvailable() = %d",
     (int)maxSize, (int)d->pSocket->bytesAvailable(), (int)QIODevice::bytesAvailable());*/
 
@@ -595,6 +666,83 @@ qint64 PiiHttpDevice::readData(char* bytes, qint64 maxSize)
   return iRead;
 }
 
+bool PiiHttpDevice::readSocketLine(QByteArray* line)
+{
+  line->clear();
+  char c;
+  // Chunk headers are short. A limit protects against garbage.
+  while (line->size() < 1024)
+    {
+      if (readFromSocket(&c, 1) != 1)
+        return false;
+      if (c == '\n')
+        {
+          if (line->endsWith('\r'))
+            line->chop(1);
+          return true;
+        }
+      line->append(c);
+    }
+  return false;
+}
+
+bool PiiHttpDevice::readChunkHeader()
+{
+  PII_D;
+  QByteArray aLine;
+  // Each chunk but the first is preceded by the CRLF that ends the
+  // previous one.
+  if (d->iChunkBytesLeft == -2 && (!readSocketLine(&aLine) || !aLine.isEmpty()))
+    return false;
+  if (!readSocketLine(&aLine))
+    return false;
+  // Chunk extensions are ignored.
+  int iSemicolon = aLine.indexOf(';');
+  if (iSemicolon != -1)
+    aLine.truncate(iSemicolon);
+  bool bOk = false;
+  d->iChunkBytesLeft = aLine.trimmed().toLongLong(&bOk, 16);
+  if (!bOk || d->iChunkBytesLeft < 0)
+    return false;
+  if (d->iChunkBytesLeft == 0)
+    {
+      // Skip trailer fields up to the empty line.
+      do
+        if (!readSocketLine(&aLine))
+          return false;
+      while (!aLine.isEmpty());
+      // Now we know the length of the whole message.
+      d->iBodyLength = d->iBytesRead - d->iHeaderLength;
+      d->bChunkedInput = false;
+    }
+  return true;
+}
+
+qint64 PiiHttpDevice::readChunked(char* bytes, qint64 maxSize)
+{
+  PII_D;
+  qint64 iTotalBytes = 0;
+  // Fill the buffer across chunk boundaries so that a short read
+  // means the end of the body.
+  while (iTotalBytes < maxSize && d->bChunkedInput)
+    {
+      if (d->iChunkBytesLeft <= 0)
+        {
+          if (!readChunkHeader())
+            return iTotalBytes > 0 ? iTotalBytes : -1;
+          continue;
+        }
+      qint64 iRead = readFromSocket(bytes + iTotalBytes, qMin(maxSize - iTotalBytes, d->iChunkBytesLeft));
+      if (iRead <= 0)
+        return iTotalBytes > 0 ? iTotalBytes : iRead;
+      iTotalBytes += iRead;
+      d->iChunkBytesLeft -= iRead;
+      if (d->iChunkBytesLeft == 0)
+        d->iChunkBytesLeft = -2;
+    }
+  return iTotalBytes;
+}
+
 QByteArray PiiHttpDevice::readBody()
 {
   PII_D;
@@ -647,6 +795,10 @@ qint64 PiiHttpDevice::bytesAvailable() const
 {
   const PII_D;
   //qDebug("PiiHttpDevice::bytesAvailable(): socket: %ld, QIODevice: %ld", d->pSocket->bytesAvailable(), QIODevice::bytesAvailable());
+  // Chunk headers are not data. Don't promise more than the current
+  // chunk has, or a read of bytesAvailable() bytes may block.
+  if (d->bChunkedInput)
+    return qMin(d->pSocket->bytesAvailable(), qMax(d->iChunkBytesLeft, qint64(0))) + QIODevice::bytesAvailable();
   return d->pSocket->bytesAvailable() + QIODevice::bytesAvailable();
 }
 
@@ -659,13 +811,30 @@ bool PiiHttpDevice::isSequential() const
 bool PiiHttpDevice::sendResponseHeader()
 {
   PII_D;
-  // If the response header has no Content-Length, the end of the
-  // transfer must be indicated by closing the connection.
-  if (!d->responseHeader.hasContentLength() && !d->responseHeader.hasKey("Connection"))
-    setHeader("Connection", "close");
+  // If the response header has no Content-Length, HTTP/1.1 clients
+  // get the body in chunks. Otherwise, the end of the transfer must
+  // be indicated by closing the connection.
+  bool bChunked = false;
+  if (!d->responseHeader.hasContentLength())
+    {
+      int iStatus = d->responseHeader.statusCode();
+      if (d->requestHeader.httpVersion() >= PiiVersionNumber(1,1) &&
+          requestMethod() != "HEAD" &&
+          iStatus >= 200 &&
+          iStatus not_member_of<int> (PiiHttpProtocol::NoContentStatus, PiiHttpProtocol::NotModifiedStatus))
+        {
+          setHeader("Transfer-Encoding", "chunked");
+          bChunked = true;
+        }
+      else if (!d->responseHeader.hasKey("Connection"))
+        setHeader("Connection", "close");
+    }
 
   QByteArray aHeader(d->responseHeader.toByteArray());
-  return writeToSocket(aHeader.constData(), aHeader.size()) == aHeader.size();
+  bool bResult = writeToSocket(aHeader.constData(), aHeader.size()) == aHeader.size();
+  // The header itself is not chunked.
+  d->bChunkedOutput = bChunked;
+  return bResult;
 }
 
 
@@ -681,7 +850,9 @@ bool PiiHttpDevice::decodeResponseHeader()
       PiiHttpResponseHeader header(aHeader);
       if (!header.isValid())
         return false;
-      if (header.hasContentLength())
+      if (header.value("Transfer-Encoding").contains("chunked", Qt::CaseInsensitive))
+        d->bChunkedInput = true;
+      else if (header.hasContentLength())
         d->iBodyLength = header.contentLength();
 
       d->responseHeader = header;
@@ -789,6 +960,13 @@ bool PiiHttpDevice::decodeRequestHeader()
 bool PiiHttpDevice::isBodyRead() const { return _d()->bBodyRead; }
 qint64 PiiHttpDevice::bodyLength() const { return _d()->iBodyLength; }
 qint64 PiiHttpDevice::headerLength() const { return _d()->iHeaderLength; }
+
+bool PiiHttpDevice::isMessageComplete() const
+{
+  const PII_D;
+  return d->bHeaderRead && d->iHeaderLength != -1 && d->iBodyLength != -1 &&
+    d->iBytesRead >= d->iHeaderLength + d->iBodyLength;
+}
 bool PiiHttpDevice::headerRead() const { return _d()->bHeaderRead; }
 void PiiHttpDevice::setHeaderSizeLimit(qint64 headerSizeLimit) { _d()->iHeaderSizeLimit = headerSizeLimit; }
 qint64 PiiHttpDevice::headerSizeLimit() const { return _d()->iHeaderSizeLimit; }
@@ -831,6 +1009,8 @@ void PiiHttpDevice::restart()
   d->bHeaderRead = d->bHeaderSent = false;
   d->iBytesRead = d->iBytesWritten = 0;
   d->iBodyLength = d->iHeaderLength = -1;
+  d->bChunkedOutput = d->bChunkedInput = false;
+  d->iChunkBytesLeft = -1;
   d->bFinished = false;
   d->mapFormValues.clear();
   d->lstFormItems.clear();
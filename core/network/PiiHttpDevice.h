@@ -29,6 +29,7 @@
 #include "PiiHttpResponseHeader.h"
 
 class QTextCodec;
+class QFile;
 class PiiProgressController;
 
 /**
@@ -442,6 +443,29 @@ public:
    */
   void endOutputFiltering(PiiStreamFilter* filter = 0);
 
+  /**
+   * Starts compressing the response body if the client accepts a
+   * compressed response. The compression format is chosen based on
+   * the Accept-Encoding request header, and a matching
+   * Content-Encoding header is added to the response. The
+   * compression filter is pushed on top of the filter stack like
+   * with [startOutputFiltering()].
+   *
+   * If the body is not buffered, its length is unknown, and the
+   * response will be sent to HTTP/1.1 clients with chunked transfer
+   * coding.
+   *
+   * @param level zlib compression level (0-9), or -1 for the default
+   * level.
+   *
+   * @return `true` if compression was started, `false` if the client
+   * doesn't accept compressed data or the header has already been
+   * sent.
+   *
+   * @see PiiCompressionFilter
+   */
+  bool startOutputCompression(int level = -1);
+
   /**
    * Sets a HTTP request/response header field. If the device is in
    * `Client` mode, this function modifies the request header. In
@@ -572,6 +596,18 @@ public:
    */
   qint64 print(const QString& data);
 
+  /**
+   * Writes *length* bytes starting at *offset* in *file* to the
+   * message body. If no output filter is active, the data is passed
+   * to the socket with PiiSocketDevice::sendFile(), which avoids
+   * copying it through user space. Otherwise, or if the socket
+   * doesn't support zero-copy transmission, the file is read and
+   * written to this device.
+   *
+   * @return the number of bytes written, or -1 on error
+   */
+  qint64 sendFile(QFile* file, qint64 offset, qint64 length);
+
   /**
    * Encodes *msg* to a byte array using the current encoding. If the
    * `Content`-Encoding header has not been set, UTF-8 will be used.
@@ -642,6 +678,14 @@ public:
    */
   qint64 headerLength() const;
 
+  /**
+   * Returns `true` if the header and the whole body of the incoming
+   * message have been read. This is possible only if the length of
+   * the body is known. A client can use this function to check if a
+   * keep-alive connection can carry another request.
+   */
+  bool isMessageComplete() const;
+
   /**
    * Decodes *data* and returns its value as a %QVariant. The
    * following conversions are tried, in preference order:
@@ -720,6 +764,11 @@ private:
   template <class Archive> static QByteArray encode(const QVariant& variant);
 
   inline qint64 writeToSocket(const char * data, qint64 maxSize);
+  qint64 writeChunk(const char* data, qint64 maxSize);
+  qint64 readFromSocket(char* data, qint64 maxSize);
+  qint64 readChunked(char* data, qint64 maxSize);
+  bool readChunkHeader();
+  bool readSocketLine(QByteArray* line);
   void checkCodec(const QString& key, const QString& value);
 
   void destroyOutputFilters();
@@ -758,6 +807,10 @@ private:
     bool bBodyRead, bFinished;
     qint64 iBodyLength, iHeaderLength;
     int iDataTimeout;
+    // Chunked transfer coding. iChunkBytesLeft is -1 before the
+    // first chunk header and -2 between chunks.
+    bool bChunkedOutput, bChunkedInput;
+    qint64 iChunkBytesLeft;
   };
   PII_D_FUNC;
 
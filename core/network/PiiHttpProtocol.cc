@@ -151,6 +151,58 @@ void PiiHttpProtocol::communicate(QIODevice* dev, PiiProgressController* control
     }
 }
 
+int PiiHttpProtocol::requestLength(const QByteArray& buffer) const
+{
+  // The default limits of PiiHttpDevice. The device reports the
+  // error once it sees the data.
+  static const int iHeaderSizeLimit = 4096;
+  static const qint64 iMessageSizeLimit = 8*1024*1024;
+
+  const char* pData = buffer.constData();
+  const int iSize = buffer.size();
+  int iLineStart = 0, iHeaderLength = -1;
+  qint64 iBodyLength = 0;
+  // Like PiiMimeHeader, accept both CRLF and LF line ends.
+  for (int i=0; i<iSize && i<=iHeaderSizeLimit; ++i)
+    {
+      if (pData[i] != '\n')
+        continue;
+      int iLineLength = i - iLineStart;
+      if (iLineLength > 0 && pData[i-1] == '\r')
+        --iLineLength;
+      if (iLineLength == 0)
+        {
+          iHeaderLength = i + 1;
+          break;
+        }
+      static const char pContentLength[] = "content-length:";
+      static const int iKeyLength = int(sizeof(pContentLength)) - 1;
+      if (iLineLength > iKeyLength &&
+          qstrnicmp(pData + iLineStart, pContentLength, iKeyLength) == 0)
+        {
+          bool bOk = false;
+          iBodyLength = QByteArray(pData + iLineStart + iKeyLength,
+                                   iLineLength - iKeyLength).trimmed().toLongLong(&bOk);
+          if (!bOk || iBodyLength < 0)
+            iBodyLength = 0;
+        }
+      iLineStart = i + 1;
+    }
+
+  if (iHeaderLength == -1)
+    return iSize > iHeaderSizeLimit ? iSize : 0;
+
+  // PiiHttpDevice ignores the body of a GET request.
+  if (buffer.startsWith("GET "))
+    iBodyLength = 0;
+
+  if (iHeaderLength + iBodyLength > iMessageSizeLimit)
+    return iHeaderLength;
+  if (iHeaderLength + iBodyLength > iSize)
+    return 0;
+  return iHeaderLength + int(iBodyLength);
+}
+
 PiiHttpProtocol::UriHandler* PiiHttpProtocol::uriHandler(const QString& uri, bool exactMatch)
 {
   HandlerPair pair = findHandler(uri);
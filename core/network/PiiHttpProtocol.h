@@ -167,6 +167,17 @@ public:
 
   void communicate(QIODevice* dev, PiiProgressController* controller);
 
+  /**
+   * Frames an HTTP request. The request ends after the empty line
+   * that terminates the header plus `Content-Length` bytes of body.
+   * A request with no `Content-Length` has no body. Chunked request
+   * bodies are not supported. If the header or the whole message
+   * exceeds the default limits of PiiHttpDevice, only the part needed
+   * to detect the error is framed, and the connection will be closed
+   * after an error response.
+   */
+  int requestLength(const QByteArray& buffer) const;
+
   /**
    * Register a URI handler. He caller retains the ownership of the
    * handler. The same handler can be register many times in different
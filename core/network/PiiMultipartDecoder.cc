@@ -17,18 +17,31 @@
 #include "PiiMimeHeader.h"
 #include "PiiMimeException.h"
 
+#include <cstring>
+
+namespace
+{
+  // The amount of data buffered ahead of the read position.
+  const int iWindowSize = 65536;
+  // Reads at least this large bypass the read-ahead window.
+  const qint64 iDirectReadSize = 16384;
+  const int iMaxHeaderSize = 4096;
+}
+
 PiiMultipartDecoder::Data::Data(QIODevice* device) :
   pDevice(device),
   bHeadersRead(false),
   iContentLength(-1),
-  iCurrentMultipartDepth(0)
+  iCurrentMultipartDepth(0),
+  iWindowStart(0)
 {
+  aWindow.reserve(iWindowSize);
 }
 
 PiiMultipartDecoder::PiiMultipartDecoder(QIODevice* device) :
   d(new Data(device))
 {
-  open(device->openMode());
+  open(device->openMode() | QIODevice::Unbuffered);
 }
 
 PiiMultipartDecoder::PiiMultipartDecoder(QIODevice* device, const PiiMimeHeader& header) :
@@ -36,7 +49,7 @@ PiiMultipartDecoder::PiiMultipartDecoder(QIODevice* device, const PiiMimeHeader&
 {
   d->stkHeaders.push(header);
   updateBodyPartInfo();
-  open(device->openMode());
+  open(device->openMode() | QIODevice::Unbuffered);
 }
 
 PiiMultipartDecoder::~PiiMultipartDecoder()
@@ -44,12 +57,139 @@ PiiMultipartDecoder::~PiiMultipartDecoder()
   delete d;
 }
 
+int PiiMultipartDecoder::fillWindow(int minBytes)
+{
+  int iAvailable = d->aWindow.size() - d->iWindowStart;
+  if (iAvailable >= minBytes)
+    return iAvailable;
+
+  // Move unread data to the beginning of the window.
+  if (d->iWindowStart > 0)
+    {
+      d->aWindow.remove(0, d->iWindowStart);
+      d->iWindowStart = 0;
+    }
+
+  while (iAvailable < minBytes)
+    {
+      // Ask for what is needed or what has already been received,
+      // whichever is more. Waiting for more could block a streaming
+      // device until data that belongs to the next message arrives.
+      qint64 iBytesToRead = qMax(qint64(minBytes - iAvailable),
+                                 qMin(d->pDevice->bytesAvailable(), qint64(iWindowSize - iAvailable)));
+      d->aWindow.resize(iAvailable + int(iBytesToRead));
+      qint64 iBytesRead = d->pDevice->read(d->aWindow.data() + iAvailable, iBytesToRead);
+      if (iBytesRead <= 0)
+        {
+          d->aWindow.resize(iAvailable);
+          break;
+        }
+      iAvailable += int(iBytesRead);
+      d->aWindow.resize(iAvailable);
+    }
+  return iAvailable;
+}
+
+qint64 PiiMultipartDecoder::findBoundary(const char* data, qint64 size, bool* found) const
+{
+  const char* pBoundary = d->aBoundary.constData();
+  const qint64 iBoundarySize = d->aBoundary.size();
+  const char* pEnd = data + size;
+  // All boundaries start with "--". memchr() is vectorized in any
+  // decent C library and skips non-candidates quickly.
+  for (const char* p = data; (p = static_cast<const char*>(std::memchr(p, '-', pEnd - p))) != 0; ++p)
+    {
+      qint64 iTailLength = pEnd - p;
+      if (iTailLength >= iBoundarySize)
+        {
+          if (std::memcmp(p, pBoundary, iBoundarySize) == 0)
+            {
+              *found = true;
+              return p - data;
+            }
+        }
+      // The end of data may be the beginning of a boundary. Need to
+      // read more to be sure.
+      else if (std::memcmp(p, pBoundary, iTailLength) == 0)
+        {
+          *found = false;
+          return p - data;
+        }
+    }
+  *found = false;
+  return size;
+}
+
+qint64 PiiMultipartDecoder::readRaw(char* data, qint64 maxSize)
+{
+  qint64 iBytesInWindow = qMin(qint64(d->aWindow.size() - d->iWindowStart), maxSize);
+  if (iBytesInWindow > 0)
+    {
+      std::memcpy(data, d->aWindow.constData() + d->iWindowStart, iBytesInWindow);
+      d->iWindowStart += int(iBytesInWindow);
+      return iBytesInWindow;
+    }
+  return d->pDevice->read(data, maxSize);
+}
+
+qint64 PiiMultipartDecoder::readBodyData(char* data, qint64 maxSize)
+{
+  const int iBoundarySize = d->aBoundary.size();
+  bool bFound = false;
+
+  // Large reads go directly to the caller's memory. Only the part
+  // that may belong to a boundary will be copied to the window.
+  if (d->iWindowStart == d->aWindow.size() && maxSize >= iDirectReadSize)
+    {
+      qint64 iBytesRead = d->pDevice->read(data, qMin(maxSize, qMax(qint64(iBoundarySize),
+                                                                    d->pDevice->bytesAvailable())));
+      if (iBytesRead <= 0)
+        return iBytesRead;
+      qint64 iBodyLength = findBoundary(data, iBytesRead, &bFound);
+      if (iBodyLength < iBytesRead)
+        {
+          d->aWindow = QByteArray(data + iBodyLength, int(iBytesRead - iBodyLength));
+          d->aWindow.reserve(iWindowSize);
+          d->iWindowStart = 0;
+        }
+      // If a boundary (or the beginning of one) is at the very
+      // beginning, the window must be consulted.
+      if (iBodyLength > 0)
+        return iBodyLength;
+    }
+
+  // Make sure a boundary at the read position can be recognized.
+  int iAvailable = fillWindow(iBoundarySize);
+  if (iAvailable == 0)
+    return 0;
+
+  const char* pWindow = d->aWindow.constData() + d->iWindowStart;
+  qint64 iBodyLength = findBoundary(pWindow, iAvailable, &bFound);
+  // A partial boundary at the beginning means that the device ran
+  // out of data. It is just data then.
+  if (iBodyLength == 0 && !bFound)
+    iBodyLength = iAvailable;
+
+  qint64 iBytesRead = qMin(iBodyLength, maxSize);
+  std::memcpy(data, pWindow, iBytesRead);
+  d->iWindowStart += int(iBytesRead);
+
+  if (bFound && iBytesRead == iBodyLength)
+    {
+      // This blocks reads beyond the boundary.
+      d->iContentLength = 0;
+      // This allows one to read a new header.
+      d->bHeadersRead = false;
+    }
+  return iBytesRead;
+}
+
 qint64 PiiMultipartDecoder::readData(char* data, qint64 maxSize)
 {
   // If content-length is given, trust it.
   if (d->iContentLength > 0)
     {
-      qint64 iBytesRead = d->pDevice->read(data, qMin(maxSize, qint64(d->iContentLength)));
+      qint64 iBytesRead = readRaw(data, qMin(maxSize, qint64(d->iContentLength)));
       if (iBytesRead < 0)
         return iBytesRead;
       d->iContentLength -= iBytesRead;
@@ -71,55 +211,10 @@ qint64 PiiMultipartDecoder::readData(char* data, qint64 maxSize)
   // We are out of luck. Must filter the input for the boundary
   // delimiter.
   else if (d->aBoundary.size() > 0)
-    {
-      // Read at most the size of the boundary bytes
-      qint64 iBytesRead = d->pDevice->read(data, qMin(d->aBoundary.size(), int(maxSize)));
-      if (iBytesRead <= 0)
-        return iBytesRead;
-
-      // Check received data for the boundary marker
-      int i = 0, iTailLength = 0, iPeekLength = 0;
-      while (i < iBytesRead)
-        {
-          // If the end of the read data matches the beginning of the
-          // boundary marker, we must check if this is really the
-          // start of the boundary.
-          iTailLength = iBytesRead - i;
-          iPeekLength = d->aBoundary.size()-iTailLength;
-          if (std::memcmp(d->aBoundary.constData(), data + i, iTailLength) == 0)
-            {
-              // either the boundary was fully matched ...
-              if (iPeekLength == 0)
-                break;
-              else
-                {
-                  // ... or the data to come next is the boundary
-                  QByteArray aRest = d->pDevice->peek(iPeekLength);
-                  if (aRest.size() == iPeekLength &&
-                      std::memcmp(aRest.constData(), d->aBoundary.constData() + iTailLength, iPeekLength) == 0)
-                    break;
-                }
-            }
-          ++i;
-        }
-
-      // Great, we found the boundary
-      if (i < iBytesRead)
-        {
-          // Put the boundary marker back. nextMessage() will handle it.
-          while (iBytesRead > i)
-            d->pDevice->ungetChar(data[--iBytesRead]);
-
-          // This blocks reads beyond the boundary.
-          d->iContentLength = 0;
-          // This allows one to read a new header.
-          d->bHeadersRead = false;
-        }
-      return iBytesRead;
-    }
+    return readBodyData(data, maxSize);
   // No boundary, no Content-Length. Too bad...
   else
-    return d->pDevice->read(data, maxSize);
+    return readRaw(data, maxSize);
 }
 
 qint64 PiiMultipartDecoder::writeData(const char* data, qint64 maxSize)
@@ -134,7 +229,7 @@ bool PiiMultipartDecoder::isSequential() const
 
 qint64 PiiMultipartDecoder::bytesAvailable() const
 {
-  return d->pDevice->bytesAvailable();
+  return d->aWindow.size() - d->iWindowStart + d->pDevice->bytesAvailable();
 }
 
 bool PiiMultipartDecoder::readPreamble()
@@ -145,6 +240,47 @@ bool PiiMultipartDecoder::readPreamble()
 }
 
 
+QByteArray PiiMultipartDecoder::readHeaderData()
+{
+  QByteArray aHeader;
+  for (;;)
+    {
+      // Find the end of the next line in the window. Read more if
+      // needed.
+      int iAvailable = d->aWindow.size() - d->iWindowStart, iLineLength = 0;
+      for (;;)
+        {
+          const char* pStart = d->aWindow.constData() + d->iWindowStart;
+          const char* pEol = static_cast<const char*>(std::memchr(pStart, '\n', iAvailable));
+          if (pEol != 0)
+            {
+              iLineLength = int(pEol - pStart) + 1;
+              break;
+            }
+          if (aHeader.size() + iAvailable > iMaxHeaderSize)
+            PII_THROW_MIME(HeaderTooLarge);
+          int iNewAvailable = fillWindow(iAvailable + 1);
+          // EOD. Take what we got.
+          if (iNewAvailable == iAvailable)
+            {
+              iLineLength = iAvailable;
+              break;
+            }
+          iAvailable = iNewAvailable;
+        }
+
+      if (iLineLength == 0)
+        break;
+      const char* pLine = d->aWindow.constData() + d->iWindowStart;
+      d->iWindowStart += iLineLength;
+      // Empty line -> end of header
+      if (*pLine == '\r' || *pLine == '\n')
+        break;
+      aHeader.append(pLine, iLineLength);
+    }
+  return aHeader;
+}
+
 bool PiiMultipartDecoder::nextMessage()
 {
   // Can't reread headers
@@ -153,7 +289,7 @@ bool PiiMultipartDecoder::nextMessage()
 
   for (;;)
     {
-      QByteArray aHeader(PiiMimeHeader::readHeaderData(d->pDevice, 4096));
+      QByteArray aHeader(readHeaderData());
       // The first line of the header can be a message end boundary.
       while (d->aBoundary.size() > 0 && aHeader.startsWith(d->aBoundary))
         {
@@ -85,6 +85,17 @@
  * third round fetches the contents of file2.gif, after which the loop
  * will break.
  *
+ * If a body part has no Content-Length header, the decoder must look
+ * for the boundary in the data. To make this fast, the decoder reads
+ * ahead into an internal window and locates boundaries with
+ * `memchr()` and `memcmp()`, which are vectorized in typical C
+ * libraries. Large reads (such as one that fills the data buffer of
+ * a matrix) pass the window and go directly to the caller's memory;
+ * only the bytes after a boundary are copied. The decoder never
+ * waits for more data than needed to recognize a boundary, so that
+ * streams such as "multipart/x-mixed-replace" are not delayed. Note
+ * that data read ahead after the final boundary (the epilogue) is
+ * discarded with the decoder.
  */
 class PII_NETWORK_EXPORT PiiMultipartDecoder : public QIODevice
 {
@@ -183,6 +194,11 @@ private:
   void popHeader();
   void updateBodyPartInfo();
   bool readPreamble();
+  QByteArray readHeaderData();
+  int fillWindow(int minBytes);
+  qint64 findBoundary(const char* data, qint64 size, bool* found) const;
+  qint64 readRaw(char* data, qint64 maxSize);
+  qint64 readBodyData(char* data, qint64 maxSize);
 
   /// @internal
   class Data
@@ -196,6 +212,9 @@ private:
     int iContentLength;
     int iCurrentMultipartDepth;
     QByteArray aBoundary, aBfr;
+    // Read-ahead buffer. Unread data starts at iWindowStart.
+    QByteArray aWindow;
+    int iWindowStart;
   } *d;
 };
 
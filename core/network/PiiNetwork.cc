@@ -38,6 +38,7 @@ namespace PiiNetwork
   const char* pFormContentType = "application/x-www-form-urlencoded";
   const char* pTextArchiveContentType = "application/x-into-txt";
   const char* pBinaryArchiveContentType = "application/x-into-bin";
+  const char* pVariantContentType = "application/x-into-variant";
 
   static inline QString tr(const char* text)
   {
@@ -236,6 +237,7 @@ namespace PiiNetwork
         switch (pDev->status())
           {
           case PiiHttpProtocol::OkStatus:
+          case PiiHttpProtocol::PartialContentStatus:
             if (header) *header = pDev->responseHeader();
             if (maxSize != 0 && pDev->responseHeader().contentLength() > maxSize)
               throwTooBig();
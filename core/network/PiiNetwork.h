@@ -220,6 +220,7 @@ namespace PiiNetwork
   extern PII_NETWORK_EXPORT const char* pServerRepliedWithStatus;
   extern PII_NETWORK_EXPORT const char* pTextArchiveContentType;
   extern PII_NETWORK_EXPORT const char* pBinaryArchiveContentType;
+  extern PII_NETWORK_EXPORT const char* pVariantContentType;
 
   enum ResolutionError { NoResolutionError, FunctionNameNotFound, OverloadNotFound };
   PiiGenericFunction* resolveFunction(const QList<QPair<QString,PiiGenericFunction*> >& functions,
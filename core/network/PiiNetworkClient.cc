@@ -57,15 +57,15 @@ PiiSocketDevice PiiNetworkClient::openConnection()
     {
       //qDebug("PiiNetworkClient::openConnection(): creating new device");
       delete d->pDevice;
-      d->pDevice = connectToServer();
+      d->pDevice = connectToServer(d->strServerAddress, d->iConnectionTimeout);
       d->strOldAddress = d->strServerAddress;
     }
   return d->pDevice;
 }
 
-PiiSocketDevice PiiNetworkClient::connectToServer()
+PiiSocketDevice PiiNetworkClient::connectToServer(const QString& serverAddress, int connectionTimeout)
 {
-  QUrl serverUrl(d->strServerAddress);
+  QUrl serverUrl(serverAddress);
   QString strScheme = serverUrl.scheme();
 
   int iPort = serverUrl.port();
@@ -82,7 +82,7 @@ PiiSocketDevice PiiNetworkClient::connectToServer()
         return PiiSocketDevice();
       QTcpSocket* pSocket = new QTcpSocket;
       pSocket->connectToHost(serverUrl.host(), iPort);
-      if (!pSocket->waitForConnected(d->iConnectionTimeout))
+      if (!pSocket->waitForConnected(connectionTimeout))
         {
           delete pSocket;
           return PiiSocketDevice();
@@ -96,7 +96,7 @@ PiiSocketDevice PiiNetworkClient::connectToServer()
         return PiiSocketDevice();
       QSslSocket* pSocket = new QSslSocket;
       pSocket->connectToHostEncrypted(serverUrl.host(), iPort);
-      if (!pSocket->waitForEncrypted(d->iConnectionTimeout))
+      if (!pSocket->waitForEncrypted(connectionTimeout))
         {
           delete pSocket;
           return PiiSocketDevice();
@@ -107,8 +107,8 @@ PiiSocketDevice PiiNetworkClient::connectToServer()
   else if (strScheme == "local")
     {
       QLocalSocket* pSocket = new QLocalSocket;
-      pSocket->connectToServer(d->strServerAddress.mid(8)); // strlen("local://")
-      if (!pSocket->waitForConnected(d->iConnectionTimeout))
+      pSocket->connectToServer(serverAddress.mid(8)); // strlen("local://")
+      if (!pSocket->waitForConnected(connectionTimeout))
         {
           delete pSocket;
           return PiiSocketDevice();
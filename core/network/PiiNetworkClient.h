@@ -94,6 +94,18 @@ public:
    */
   QString serverAddress() const;
 
+  /**
+   * Opens a new connection to the server at *serverAddress*, which
+   * may be given in any of the formats accepted by
+   * [setServerAddress()]. Waits at most *connectionTimeout*
+   * milliseconds for the connection to be established. The caller
+   * owns the QIODevice in the returned device.
+   *
+   * @return the connected device, or a null device if the
+   * connection failed.
+   */
+  static PiiSocketDevice connectToServer(const QString& serverAddress, int connectionTimeout);
+
 public slots:
   /**
    * Closes the connection to the server.
@@ -101,7 +113,6 @@ public slots:
   void closeConnection();
 
 private:
-  PiiSocketDevice connectToServer();
 
   /// @internal
   class Data
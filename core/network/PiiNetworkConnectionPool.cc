@@ -0,0 +1,191 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiNetworkConnectionPool.h"
+#include "PiiNetworkClient.h"
+
+#include <PiiTimer.h>
+#include <QIODevice>
+#include <QThread>
+#include <QMutex>
+#include <QMap>
+#include <QList>
+
+namespace PiiNetworkConnectionPool
+{
+  namespace
+  {
+    struct IdleConnection
+    {
+      PiiSocketDevice socket;
+      qint64 iIdleSince;
+    };
+
+    typedef QMap<QString, QList<IdleConnection> > ConnectionMap;
+
+    QMutex* poolMutex()
+    {
+      static QMutex mutex;
+      return &mutex;
+    }
+
+    ConnectionMap* connectionMap()
+    {
+      static ConnectionMap map;
+      return &map;
+    }
+
+    int iMaxIdleConnections = 8;
+    int iMaxIdleTime = 4000;
+
+    // Closes and deletes a connection that may be detached from any
+    // thread.
+    void destroy(const PiiSocketDevice& socket)
+    {
+      attachToThread(socket.device());
+      delete socket.device();
+    }
+  }
+
+  PiiSocketDevice take(const QString& serverAddress, int connectionTimeout, bool* reused)
+  {
+    QList<PiiSocketDevice> lstExpired;
+    PiiSocketDevice socket;
+    synchronized (poolMutex())
+      {
+        QList<IdleConnection>& lstIdle = (*connectionMap())[serverAddress];
+        const qint64 iNow = PiiTimer::timestamp();
+        // The most recently used connection is at the end.
+        while (!lstIdle.isEmpty())
+          {
+            IdleConnection connection = lstIdle.takeLast();
+            if (iMaxIdleTime > 0 && (iNow - connection.iIdleSince) / 1000 > iMaxIdleTime)
+              lstExpired << connection.socket;
+            else
+              {
+                socket = connection.socket;
+                break;
+              }
+          }
+        // Anything older than the expired one is expired, too.
+        while (!lstIdle.isEmpty() && lstExpired.size() > 0)
+          lstExpired << lstIdle.takeFirst().socket;
+      }
+
+    for (int i=0; i<lstExpired.size(); ++i)
+      destroy(lstExpired[i]);
+
+    if (socket != 0)
+      {
+        attachToThread(socket.device());
+        /* The server may have closed the connection while it was in
+           the pool. A zero-time wait updates the socket state. An
+           idle connection must not have data either.
+        */
+        if (socket->bytesAvailable() == 0 && !socket->waitForReadyRead(0) && socket.isWritable())
+          {
+            if (reused != 0)
+              *reused = true;
+            return socket;
+          }
+        delete socket.device();
+      }
+
+    if (reused != 0)
+      *reused = false;
+    return PiiNetworkClient::connectToServer(serverAddress, connectionTimeout);
+  }
+
+  void give(const QString& serverAddress, const PiiSocketDevice& socket)
+  {
+    if (socket == 0)
+      return;
+    if (!socket.isWritable() || socket->bytesAvailable() > 0)
+      {
+        delete socket.device();
+        return;
+      }
+
+    detachFromThread(socket.device());
+    synchronized (poolMutex())
+      {
+        QList<IdleConnection>& lstIdle = (*connectionMap())[serverAddress];
+        if (lstIdle.size() < iMaxIdleConnections)
+          {
+            IdleConnection connection = { socket, PiiTimer::timestamp() };
+            lstIdle << connection;
+            return;
+          }
+      }
+    destroy(socket);
+  }
+
+  void clear(const QString& serverAddress)
+  {
+    QList<PiiSocketDevice> lstClosed;
+    synchronized (poolMutex())
+      {
+        ConnectionMap* pMap = connectionMap();
+        for (ConnectionMap::iterator i=pMap->begin(); i!=pMap->end(); )
+          {
+            if (serverAddress.isEmpty() || i.key() == serverAddress)
+              {
+                for (int j=0; j<i.value().size(); ++j)
+                  lstClosed << i.value()[j].socket;
+                i = pMap->erase(i);
+              }
+            else
+              ++i;
+          }
+      }
+    for (int i=0; i<lstClosed.size(); ++i)
+      destroy(lstClosed[i]);
+  }
+
+  void detachFromThread(QIODevice* socket)
+  {
+    if (socket != 0 && socket->thread() != 0)
+      socket->moveToThread(0);
+  }
+
+  void attachToThread(QIODevice* socket)
+  {
+    // Only objects with no thread can be pulled to the current thread.
+    if (socket != 0 && socket->thread() == 0)
+      socket->moveToThread(QThread::currentThread());
+  }
+
+  void setMaxIdleConnections(int maxIdleConnections)
+  {
+    synchronized (poolMutex()) iMaxIdleConnections = qMax(0, maxIdleConnections);
+  }
+
+  int maxIdleConnections()
+  {
+    QMutexLocker lock(poolMutex());
+    return iMaxIdleConnections;
+  }
+
+  void setMaxIdleTime(int maxIdleTime)
+  {
+    synchronized (poolMutex()) iMaxIdleTime = maxIdleTime;
+  }
+
+  int maxIdleTime()
+  {
+    QMutexLocker lock(poolMutex());
+    return iMaxIdleTime;
+  }
+}
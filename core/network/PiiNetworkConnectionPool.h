@@ -0,0 +1,112 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIINETWORKCONNECTIONPOOL_H
+#define _PIINETWORKCONNECTIONPOOL_H
+
+#include "PiiSocketDevice.h"
+#include <QString>
+
+/**
+ * A process-wide pool of idle keep-alive connections. Clients that
+ * make many short requests to the same server, such as
+ * PiiRemoteObject, take a connection from the pool for each request
+ * and give it back once the response has been read. This saves
+ * connection set-up time and lets different clients of the same
+ * server share connections.
+ *
+ * Connections are keyed by server address (see
+ * PiiNetworkClient::setServerAddress()). A connection that has been
+ * idle longer than [maxIdleTime()] is closed when it is next found
+ * in the pool.
+ *
+ * Sockets are thread-affine QObjects. The pool detaches the sockets
+ * given to it from their thread, and [take()] moves them to the
+ * calling thread. A taken connection may thus be used in any thread,
+ * but only in one at a time.
+ *
+ * All functions are thread-safe.
+ */
+namespace PiiNetworkConnectionPool
+{
+  /**
+   * Takes an idle connection to *serverAddress* from the pool. If
+   * none is available, opens a new connection, waiting at most
+   * *connectionTimeout* milliseconds. The caller owns the QIODevice
+   * in the returned device and must either delete it or [give()] it
+   * back.
+   *
+   * @param serverAddress the address of the server
+   *
+   * @param connectionTimeout the maximum time to wait for a new
+   * connection
+   *
+   * @param reused if non-zero, set to `true` if the connection was
+   * taken from the pool and to `false` if a new connection was
+   * opened.
+   *
+   * @return a connected device, or a null device if the connection
+   * failed.
+   */
+  PII_NETWORK_EXPORT PiiSocketDevice take(const QString& serverAddress,
+                                          int connectionTimeout = 5000,
+                                          bool* reused = 0);
+
+  /**
+   * Gives a connection back to the pool. The connection must be
+   * in an idle state: all responses must have been read. If the
+   * connection is broken, or the pool already has
+   * [maxIdleConnections()] connections to *serverAddress*, the
+   * device will be deleted. The pool takes the ownership of the
+   * device.
+   */
+  PII_NETWORK_EXPORT void give(const QString& serverAddress, const PiiSocketDevice& socket);
+
+  /**
+   * Closes idle connections to *serverAddress*, or all idle
+   * connections if *serverAddress* is empty.
+   */
+  PII_NETWORK_EXPORT void clear(const QString& serverAddress = QString());
+
+  /**
+   * Sets the maximum number of idle connections kept per server. The
+   * default value is 8.
+   */
+  PII_NETWORK_EXPORT void setMaxIdleConnections(int maxIdleConnections);
+  PII_NETWORK_EXPORT int maxIdleConnections();
+
+  /**
+   * Sets the maximum number of milliseconds a connection may stay
+   * idle in the pool. Keep this below the idle time-out of the
+   * server. The default value is 4000, which is less than the
+   * five-second keep-alive time of PiiHttpServer's threaded mode.
+   */
+  PII_NETWORK_EXPORT void setMaxIdleTime(int maxIdleTime);
+  PII_NETWORK_EXPORT int maxIdleTime();
+
+  /**
+   * Detaches *socket* from its thread so that another thread can
+   * [attachToThread()] it. Must be called in the thread that
+   * currently owns the socket.
+   */
+  PII_NETWORK_EXPORT void detachFromThread(QIODevice* socket);
+
+  /**
+   * Moves a detached *socket* to the calling thread.
+   */
+  PII_NETWORK_EXPORT void attachToThread(QIODevice* socket);
+}
+
+#endif //_PIINETWORKCONNECTIONPOOL_H
@@ -0,0 +1,240 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiNetworkIoThread.h"
+#include "PiiNetworkRequestDevice.h"
+
+#include <QIODevice>
+#include <QMetaObject>
+#include <QTimerEvent>
+
+PiiNetworkConnection::PiiNetworkConnection(PiiNetworkIoThread* owner, QIODevice* socket) :
+  _pOwner(owner),
+  _socket(socket),
+  _pRequest(0),
+  _bClosing(false)
+{
+  connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+  connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(updateBytesToWrite()));
+  // QAbstractSocket and QLocalSocket have no common superclass, but
+  // both have this signal.
+  if (socket->metaObject()->indexOfSignal("disconnected()") != -1)
+    connect(socket, SIGNAL(disconnected()), this, SLOT(handleDisconnect()), Qt::QueuedConnection);
+}
+
+PiiNetworkConnection::~PiiNetworkConnection()
+{
+  if (_pRequest != 0)
+    {
+      _pRequest->disconnectClient();
+      _pRequest->release();
+    }
+  delete _socket.device();
+}
+
+bool PiiNetworkConnection::isBusy() const
+{
+  return _pRequest != 0;
+}
+
+qint64 PiiNetworkConnection::idleTime() const
+{
+  return _idleTimer.milliseconds();
+}
+
+void PiiNetworkConnection::readClient()
+{
+  _idleTimer.restart();
+  // Don't buffer pipelined requests while one is being served.
+  if (_pRequest != 0 || _bClosing)
+    return;
+
+  _aInput.append(_socket->readAll());
+  if (_aInput.isEmpty())
+    return;
+
+  int iLength = _pOwner->protocol()->requestLength(_aInput);
+  if (iLength == 0)
+    return;
+  if (iLength < 0 || iLength > _aInput.size())
+    iLength = _aInput.size();
+
+  _pRequest = new PiiNetworkRequestDevice(_aInput.left(iLength), this);
+  _aInput.remove(0, iLength);
+  // One reference for us, one for the worker.
+  _pRequest->reserve();
+  if (!_pOwner->controller()->startRequest(_pRequest))
+    {
+      _pRequest->release();
+      _pRequest = 0;
+      close();
+    }
+}
+
+void PiiNetworkConnection::flush()
+{
+  if (_pRequest == 0)
+    return;
+  QByteArray aData;
+  _pRequest->takeOutput(aData);
+  if (!aData.isEmpty())
+    _socket->write(aData);
+  _pRequest->setSocketBytesToWrite(_socket->bytesToWrite());
+}
+
+void PiiNetworkConnection::updateBytesToWrite()
+{
+  if (_pRequest != 0)
+    _pRequest->setSocketBytesToWrite(_socket->bytesToWrite());
+}
+
+void PiiNetworkConnection::requestDone(bool finished)
+{
+  if (_pRequest == 0)
+    return;
+  // Anything left in the buffer must go out before the next request.
+  flush();
+  _pRequest->release();
+  _pRequest = 0;
+  _idleTimer.restart();
+
+  if (finished)
+    readClient();
+  else
+    close();
+}
+
+void PiiNetworkConnection::close()
+{
+  if (_bClosing)
+    return;
+  _bClosing = true;
+  // Sockets finish writing pending data before they disconnect.
+  _socket.disconnect();
+  if (!_socket.isWritable())
+    handleDisconnect();
+}
+
+void PiiNetworkConnection::handleDisconnect()
+{
+  if (_pRequest != 0)
+    {
+      _pRequest->disconnectClient();
+      _pRequest->release();
+      _pRequest = 0;
+    }
+  _bClosing = true;
+  _pOwner->removeConnection(this);
+}
+
+
+PiiNetworkIoThread::Data::Data(Controller* controller, PiiNetworkProtocol* protocol) :
+  pController(controller),
+  pProtocol(protocol),
+  iConnectionCount(0),
+  iMaxIdleTime(60000)
+{}
+
+PiiNetworkIoThread::PiiNetworkIoThread(Controller* controller, PiiNetworkProtocol* protocol) :
+  d(new Data(controller, protocol))
+{
+  // Slots and timers run in the I/O thread.
+  moveToThread(this);
+}
+
+PiiNetworkIoThread::~PiiNetworkIoThread()
+{
+  stop();
+  wait();
+  delete d;
+}
+
+void PiiNetworkIoThread::addConnection(PiiGenericSocketDescriptor socketDescriptor)
+{
+  synchronized (d->queueLock)
+    d->lstNewConnections.enqueue(socketDescriptor);
+  d->iConnectionCount.ref();
+  QMetaObject::invokeMethod(this, "acceptConnections", Qt::QueuedConnection);
+}
+
+void PiiNetworkIoThread::acceptConnections()
+{
+  QQueue<PiiGenericSocketDescriptor> lstDescriptors;
+  synchronized (d->queueLock)
+    lstDescriptors.swap(d->lstNewConnections);
+
+  while (!lstDescriptors.isEmpty())
+    {
+      QIODevice* pSocket = d->pController->createSocket(lstDescriptors.dequeue());
+      if (pSocket == 0)
+        {
+          d->iConnectionCount.deref();
+          continue;
+        }
+      PiiNetworkConnection* pConnection = new PiiNetworkConnection(this, pSocket);
+      d->lstConnections << pConnection;
+      // The client may have been faster than us.
+      if (pSocket->bytesAvailable() > 0)
+        pConnection->readClient();
+    }
+}
+
+void PiiNetworkIoThread::removeConnection(PiiNetworkConnection* connection)
+{
+  if (d->lstConnections.removeOne(connection))
+    {
+      d->iConnectionCount.deref();
+      connection->deleteLater();
+    }
+}
+
+void PiiNetworkIoThread::run()
+{
+  int iTimerId = startTimer(1000);
+  exec();
+  killTimer(iTimerId);
+
+  qDeleteAll(d->lstConnections);
+  d->lstConnections.clear();
+  synchronized (d->queueLock)
+    {
+      // Connections that were never accepted are dropped.
+      for (int i=d->lstNewConnections.size(); i--; )
+        d->iConnectionCount.deref();
+      d->lstNewConnections.clear();
+    }
+}
+
+void PiiNetworkIoThread::timerEvent(QTimerEvent*)
+{
+  if (d->iMaxIdleTime <= 0)
+    return;
+  // close() may remove the connection from the list.
+  QList<PiiNetworkConnection*> lstConnections(d->lstConnections);
+  for (int i=0; i<lstConnections.size(); ++i)
+    if (!lstConnections[i]->isBusy() && lstConnections[i]->idleTime() > d->iMaxIdleTime)
+      lstConnections[i]->close();
+}
+
+void PiiNetworkIoThread::stop()
+{
+  quit();
+}
+
+int PiiNetworkIoThread::connectionCount() const { return d->iConnectionCount.load(); }
+void PiiNetworkIoThread::setMaxIdleTime(int maxIdleTime) { d->iMaxIdleTime = maxIdleTime; }
+int PiiNetworkIoThread::maxIdleTime() const { return d->iMaxIdleTime; }
+PiiNetworkIoThread::Controller* PiiNetworkIoThread::controller() const { return d->pController; }
+PiiNetworkProtocol* PiiNetworkIoThread::protocol() const { return d->pProtocol; }
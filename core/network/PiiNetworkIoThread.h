@@ -0,0 +1,192 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIINETWORKIOTHREAD_H
+#define _PIINETWORKIOTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QQueue>
+#include <PiiAtomicInt.h>
+#include <PiiTimer.h>
+
+#include "PiiNetworkProtocol.h"
+#include "PiiGenericSocketDescriptor.h"
+#include "PiiSocketDevice.h"
+
+class PiiNetworkIoThread;
+class PiiNetworkRequestDevice;
+
+/**
+ * A client connection served by a PiiNetworkIoThread. The connection
+ * collects incoming data until the protocol recognizes a complete
+ * request, passes the request to a worker and writes the response
+ * to the socket. Only one request on a connection is served at a
+ * time; pipelined requests wait in the socket's buffer.
+ *
+ * @internal
+ */
+class PII_NETWORK_EXPORT PiiNetworkConnection : public QObject
+{
+  Q_OBJECT
+
+public:
+  /**
+   * Creates a connection that communicates through *socket*. Takes
+   * the ownership of the socket.
+   */
+  PiiNetworkConnection(PiiNetworkIoThread* owner, QIODevice* socket);
+  /**
+   * Detaches the active request, if any, and deletes the socket.
+   */
+  ~PiiNetworkConnection();
+
+  /**
+   * Returns `true` if a worker is currently handling a request on
+   * this connection.
+   */
+  bool isBusy() const;
+  /**
+   * Returns the number of milliseconds since the last request was
+   * finished or data was received.
+   */
+  qint64 idleTime() const;
+  /**
+   * Closes the connection once all pending data has been written.
+   */
+  void close();
+
+public slots:
+  void flush();
+  void requestDone(bool finished);
+  void readClient();
+
+private slots:
+  void updateBytesToWrite();
+  void handleDisconnect();
+
+private:
+  PiiNetworkIoThread* _pOwner;
+  PiiSocketDevice _socket;
+  QByteArray _aInput;
+  PiiNetworkRequestDevice* _pRequest;
+  PiiTimer _idleTimer;
+  bool _bClosing;
+};
+
+/**
+ * A thread that multiplexes many client connections in an event loop
+ * in the event-driven mode of PiiNetworkServer. The sockets are
+ * created in and owned by the I/O thread. Complete requests are
+ * passed to the controller, which runs them in worker threads.
+ *
+ * @internal
+ */
+class PII_NETWORK_EXPORT PiiNetworkIoThread : public QThread
+{
+  Q_OBJECT
+
+public:
+  /**
+   * An interface for I/O thread controllers.
+   */
+  class Controller
+  {
+  public:
+    virtual ~Controller() {}
+
+    /**
+     * Creates a new socket device for communicating through the
+     * given socket. Called in the I/O thread, which will own the
+     * returned device.
+     */
+    virtual QIODevice* createSocket(PiiGenericSocketDescriptor socketDescriptor) = 0;
+
+    /**
+     * Starts serving *request* in a worker thread. The controller
+     * takes over one reference to *request* and must release it once
+     * done, also if the request is not started. Returns `false` if
+     * the request cannot be served. In this case the connection will
+     * be closed.
+     */
+    virtual bool startRequest(PiiNetworkRequestDevice* request) = 0;
+  };
+
+  /**
+   * Creates a new I/O thread that frames requests with *protocol*.
+   * Both *controller* and *protocol* must remain valid during the
+   * lifetime of the thread.
+   */
+  PiiNetworkIoThread(Controller* controller, PiiNetworkProtocol* protocol);
+  /**
+   * Stops the thread and waits for it to exit.
+   */
+  ~PiiNetworkIoThread();
+
+  /**
+   * Passes a newly accepted connection to the thread. This function
+   * is thread-safe.
+   */
+  void addConnection(PiiGenericSocketDescriptor socketDescriptor);
+
+  /**
+   * Returns the number of connections currently assigned to this
+   * thread. This function is thread-safe.
+   */
+  int connectionCount() const;
+
+  /**
+   * Closes all connections and stops the event loop. The thread will
+   * later exit asynchronously.
+   */
+  void stop();
+
+  /**
+   * Set the maximum number of milliseconds a connection may be idle
+   * before it is closed. Zero means no limit.
+   */
+  void setMaxIdleTime(int maxIdleTime);
+  int maxIdleTime() const;
+
+  Controller* controller() const;
+  PiiNetworkProtocol* protocol() const;
+
+protected:
+  void run();
+  void timerEvent(QTimerEvent*);
+
+private slots:
+  void acceptConnections();
+
+private:
+  friend class PiiNetworkConnection;
+  void removeConnection(PiiNetworkConnection* connection);
+
+  /// @internal
+  class Data
+  {
+  public:
+    Data(Controller* controller, PiiNetworkProtocol* protocol);
+    Controller* pController;
+    PiiNetworkProtocol* pProtocol;
+    QMutex queueLock;
+    QQueue<PiiGenericSocketDescriptor> lstNewConnections;
+    QList<PiiNetworkConnection*> lstConnections;
+    PiiAtomicInt iConnectionCount;
+    int iMaxIdleTime;
+  } *d;
+};
+
+#endif //_PIINETWORKIOTHREAD_H
@@ -37,3 +37,8 @@ PiiNetworkProtocol* PiiNetworkProtocol::clone() const
 {
   return const_cast<PiiNetworkProtocol*>(this);
 }
+
+int PiiNetworkProtocol::requestLength(const QByteArray&) const
+{
+  return -1;
+}
@@ -19,6 +19,7 @@
 #include "PiiNetwork.h"
 
 class QIODevice;
+class QByteArray;
 class PiiProgressController;
 
 /**
@@ -69,6 +70,33 @@ public:
    */
   virtual PiiNetworkProtocol* clone() const;
 
+  /**
+   * Finds the end of the first request in *buffer*, which contains
+   * data received from a client but not yet passed to the protocol.
+   * PiiNetworkServer uses this function in event-driven mode (see
+   * [PiiNetworkServer::ioThreads]) to collect complete requests
+   * before handing them to a worker thread.
+   *
+   * Once a request has been framed, [communicate()] will be called
+   * with a device that contains only the bytes of that request. If
+   * the protocol wants to keep the connection open, it must try to
+   * read past the end of the request after sending its response. The
+   * device will then report end of data, and the next request will
+   * be dispatched anew. If [communicate()] returns without doing so,
+   * the connection will be closed.
+   *
+   * This function must be thread-safe.
+   *
+   * @return the number of bytes in the first request, or 0 if
+   * *buffer* does not contain a complete request yet. If the data
+   * can never become a valid request (e.g. it exceeds a size limit),
+   * the protocol should return a size that lets [communicate()]
+   * detect and report the error. The default implementation returns
+   * -1, which means the protocol cannot frame requests and the
+   * server must use a dedicated thread for each connection.
+   */
+  virtual int requestLength(const QByteArray& buffer) const;
+
 protected:
   /// @internal
   class Data
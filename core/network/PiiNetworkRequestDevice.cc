@@ -0,0 +1,175 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiNetworkRequestDevice.h"
+
+#include <QMetaObject>
+
+// At most this many bytes may wait for the I/O thread before writers
+// are blocked.
+static const qint64 iMaxBufferedOutput = 1024*1024;
+
+PiiNetworkRequestDevice::Data::Data(const QByteArray& request, QObject* connection) :
+  aRequest(request),
+  iReadPosition(0),
+  bWritten(false), bFinished(false),
+  pConnection(connection),
+  iSocketBytesToWrite(0),
+  bFlushPending(false), bDisconnected(false)
+{}
+
+PiiNetworkRequestDevice::PiiNetworkRequestDevice(const QByteArray& request, QObject* connection) :
+  d(new Data(request, connection))
+{
+  open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+PiiNetworkRequestDevice::~PiiNetworkRequestDevice()
+{
+  delete d;
+}
+
+bool PiiNetworkRequestDevice::isSequential() const
+{
+  return true;
+}
+
+qint64 PiiNetworkRequestDevice::bytesAvailable() const
+{
+  return d->aRequest.size() - d->iReadPosition + QIODevice::bytesAvailable();
+}
+
+qint64 PiiNetworkRequestDevice::bytesToWrite() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->aOutput.size() + d->iSocketBytesToWrite;
+}
+
+bool PiiNetworkRequestDevice::waitForReadyRead(int)
+{
+  // Everything we'll ever get is already here.
+  return false;
+}
+
+bool PiiNetworkRequestDevice::waitForBytesWritten(int msecs)
+{
+  QMutexLocker lock(&d->mutex);
+  const qint64 iPending = d->aOutput.size() + d->iSocketBytesToWrite;
+  if (iPending == 0 || d->bDisconnected)
+    return false;
+  d->bufferCondition.wait(&d->mutex, msecs);
+  return d->aOutput.size() + d->iSocketBytesToWrite < iPending;
+}
+
+bool PiiNetworkRequestDevice::isReadable() const
+{
+  return !d->bFinished && d->iReadPosition < d->aRequest.size();
+}
+
+bool PiiNetworkRequestDevice::isWritable() const
+{
+  if (d->bFinished)
+    return false;
+  QMutexLocker lock(&d->mutex);
+  return !d->bDisconnected;
+}
+
+bool PiiNetworkRequestDevice::isFinished() const
+{
+  return d->bFinished;
+}
+
+qint64 PiiNetworkRequestDevice::readData(char* data, qint64 maxSize)
+{
+  const int iBytesLeft = d->aRequest.size() - d->iReadPosition;
+  if (iBytesLeft > 0)
+    {
+      const int iBytes = int(qMin(qint64(iBytesLeft), maxSize));
+      memcpy(data, d->aRequest.constData() + d->iReadPosition, iBytes);
+      d->iReadPosition += iBytes;
+      return iBytes;
+    }
+  /* Reading past the request after a response has been sent means
+     the protocol is waiting for the next request. A handler may also
+     read until the end of data before responding, which must not end
+     the request yet.
+   */
+  if (d->bWritten)
+    d->bFinished = true;
+  return -1;
+}
+
+qint64 PiiNetworkRequestDevice::writeData(const char* data, qint64 maxSize)
+{
+  if (d->bFinished)
+    return -1;
+
+  QMutexLocker lock(&d->mutex);
+  if (d->bDisconnected)
+    return -1;
+
+  d->aOutput.append(data, int(maxSize));
+  d->bWritten = true;
+  requestFlush();
+
+  // Don't let a fast producer fill the memory if the client is slow.
+  while (!d->bDisconnected &&
+         d->aOutput.size() + d->iSocketBytesToWrite > iMaxBufferedOutput)
+    d->bufferCondition.wait(&d->mutex);
+
+  return d->bDisconnected ? -1 : maxSize;
+}
+
+void PiiNetworkRequestDevice::requestFlush()
+{
+  if (!d->bFlushPending && d->pConnection != 0)
+    {
+      QMetaObject::invokeMethod(d->pConnection, "flush", Qt::QueuedConnection);
+      d->bFlushPending = true;
+    }
+}
+
+void PiiNetworkRequestDevice::takeOutput(QByteArray& data)
+{
+  QMutexLocker lock(&d->mutex);
+  data.append(d->aOutput);
+  d->aOutput.clear();
+  d->bFlushPending = false;
+}
+
+void PiiNetworkRequestDevice::setSocketBytesToWrite(qint64 bytes)
+{
+  QMutexLocker lock(&d->mutex);
+  d->iSocketBytesToWrite = bytes;
+  d->bufferCondition.wakeAll();
+}
+
+void PiiNetworkRequestDevice::disconnectClient()
+{
+  QMutexLocker lock(&d->mutex);
+  d->bDisconnected = true;
+  d->pConnection = 0;
+  d->aOutput.clear();
+  d->iSocketBytesToWrite = 0;
+  d->bufferCondition.wakeAll();
+}
+
+void PiiNetworkRequestDevice::requestDone()
+{
+  QMutexLocker lock(&d->mutex);
+  if (d->pConnection != 0)
+    QMetaObject::invokeMethod(d->pConnection, "requestDone", Qt::QueuedConnection,
+                              Q_ARG(bool, d->bFinished));
+}
@@ -0,0 +1,127 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIINETWORKREQUESTDEVICE_H
+#define _PIINETWORKREQUESTDEVICE_H
+
+#include <QIODevice>
+#include <QMutex>
+#include <QWaitCondition>
+#include <PiiSharedObject.h>
+#include "PiiNetwork.h"
+
+/**
+ * An I/O device that carries a single request from an I/O thread to
+ * a worker in the event-driven mode of PiiNetworkServer. The device
+ * is given the complete request when it is created, and reading
+ * never blocks. Written data is buffered and passed to the I/O
+ * thread that owns the real socket.
+ *
+ * Once the request has been consumed and a response written, an
+ * attempt to read more marks the request *finished*: the device
+ * reports end of data and becomes neither readable nor writable (see
+ * PiiSocketDevice). The server then waits for the next request on
+ * the same connection.
+ *
+ * The device is shared between the I/O thread and the worker. It is
+ * deleted when both have released it.
+ *
+ * @internal
+ */
+class PII_NETWORK_EXPORT PiiNetworkRequestDevice : public QIODevice, public PiiSharedObject
+{
+  Q_OBJECT
+
+public:
+  /**
+   * Creates a device that reads *request* and sends written data to
+   * *connection*. The connection must have a `flush()` slot, which
+   * will be invoked in its own thread when there is data to write,
+   * and a `requestDone(bool)` slot.
+   */
+  PiiNetworkRequestDevice(const QByteArray& request, QObject* connection);
+  ~PiiNetworkRequestDevice();
+
+  bool isSequential() const;
+  qint64 bytesAvailable() const;
+  qint64 bytesToWrite() const;
+  bool waitForReadyRead(int msecs);
+  bool waitForBytesWritten(int msecs);
+
+  /**
+   * Returns `true` if there is unread request data.
+   */
+  bool isReadable() const;
+  /**
+   * Returns `true` if the client is connected and the request has
+   * not been finished.
+   */
+  bool isWritable() const;
+  /**
+   * Returns `true` if the protocol tried to read past the request
+   * after writing a response.
+   */
+  bool isFinished() const;
+
+  /**
+   * Moves all buffered output to *data*. Called by the I/O thread.
+   */
+  void takeOutput(QByteArray& data);
+  /**
+   * Tells the device how many bytes are waiting in the socket's own
+   * buffer. Wakes up writers waiting for buffer space. Called by the
+   * I/O thread.
+   */
+  void setSocketBytesToWrite(qint64 bytes);
+  /**
+   * Marks the client disconnected and detaches the device from the
+   * connection object. Called by the I/O thread.
+   */
+  void disconnectClient();
+  /**
+   * Tells the connection that the worker is done with the request.
+   * Invokes the connection's `requestDone(bool)` slot in its own
+   * thread, passing [isFinished()] as the argument. Called by the
+   * worker.
+   */
+  void requestDone();
+
+protected:
+  qint64 readData(char* data, qint64 maxSize);
+  qint64 writeData(const char* data, qint64 maxSize);
+
+private:
+  /// @internal
+  class Data
+  {
+  public:
+    Data(const QByteArray& request, QObject* connection);
+
+    QByteArray aRequest;
+    int iReadPosition;
+    bool bWritten, bFinished;
+
+    mutable QMutex mutex;
+    QWaitCondition bufferCondition;
+    QObject* pConnection;
+    QByteArray aOutput;
+    qint64 iSocketBytesToWrite;
+    bool bFlushPending, bDisconnected;
+  } *d;
+
+  void requestFlush();
+};
+
+#endif //_PIINETWORKREQUESTDEVICE_H
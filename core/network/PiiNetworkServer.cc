@@ -15,19 +15,68 @@
 
 #include "PiiNetworkServer.h"
 #include "PiiNetworkServerThread.h"
+#include "PiiNetworkRequestDevice.h"
+#include <PiiProgressController.h>
 #include <QIODevice>
+#include <QThreadPool>
+#include <QRunnable>
+
+namespace
+{
+  // Serves a single framed request in event-driven mode.
+  class RequestTask : public QRunnable, public PiiProgressController
+  {
+  public:
+    RequestTask(PiiNetworkProtocol* protocol, PiiNetworkRequestDevice* request,
+                const volatile bool* interrupted) :
+      _pProtocol(protocol), _pRequest(request), _pbInterrupted(interrupted)
+    {}
+
+    ~RequestTask()
+    {
+      _pRequest->release();
+    }
+
+    void run()
+    {
+      // A stateful protocol gets a fresh copy for each request.
+      PiiNetworkProtocol* pProtocol = _pProtocol->clone();
+      pProtocol->communicate(_pRequest, this);
+      if (pProtocol != _pProtocol)
+        delete pProtocol;
+      _pRequest->requestDone();
+    }
+
+    bool canContinue(double) const
+    {
+      return !*_pbInterrupted;
+    }
+
+  private:
+    PiiNetworkProtocol* _pProtocol;
+    PiiNetworkRequestDevice* _pRequest;
+    const volatile bool* _pbInterrupted;
+  };
+}
 
 PiiNetworkServer::Data::Data(PiiNetworkProtocol* protocol) :
   iMinWorkers(0), iMaxWorkers(10),
-  iWorkerMaxIdleTime(20),
+  iWorkerMaxIdleTime(10000),
   iMaxPendingConnections(0),
   aBusyMessage("Server busy\n"),
+  iIoThreads(0),
+  iMaxConnections(10000),
+  iMaxConnectionIdleTime(60000),
   pProtocol(protocol),
+  pWorkerPool(new QThreadPool),
+  bInterrupted(false),
   state(Stopped)
 {}
 
 PiiNetworkServer::Data::~Data()
-{}
+{
+  delete pWorkerPool;
+}
 
 PiiNetworkServer::PiiNetworkServer(PiiNetworkProtocol* protocol) :
   d(new Data(protocol))
@@ -53,6 +102,7 @@ PiiNetworkServer::~PiiNetworkServer()
 
   waitAll(lstThreads);
   qDeleteAll(lstThreads);
+  stopIoThreads(PiiNetwork::InterruptClients);
 
   delete d;
 }
@@ -67,6 +117,30 @@ bool PiiNetworkServer::start()
     return false;
 
   d->lstPendingConnections.clear();
+  d->bInterrupted = false;
+
+  // Event-driven mode only works if the protocol can tell where
+  // requests end.
+  if (d->iIoThreads > 0 && d->pProtocol->requestLength(QByteArray()) >= 0)
+    {
+      d->pWorkerPool->setMaxThreadCount(d->iMaxWorkers);
+      d->pWorkerPool->setExpiryTimeout(d->iWorkerMaxIdleTime);
+      for (int i=0; i<d->iIoThreads; ++i)
+        {
+          PiiNetworkIoThread* pThread = new PiiNetworkIoThread(this, d->pProtocol);
+          pThread->setMaxIdleTime(d->iMaxConnectionIdleTime);
+          pThread->start();
+          d->lstIoThreads << pThread;
+        }
+      if (startListening())
+        {
+          d->state = Running;
+          return true;
+        }
+      lock.unlock();
+      stopIoThreads(PiiNetwork::InterruptClients);
+      return false;
+    }
 
   // Add threads to the pool.
   while (d->lstFreeThreads.size() < d->iMinWorkers)
@@ -114,6 +188,7 @@ bool PiiNetworkServer::stop(PiiNetwork::StopMode mode)
   // Wait until all threads are done. We can't use d->lstAllThreads here
   // because it is modified by threadFinished().
   waitAll(lstThreads);
+  stopIoThreads(mode);
 
   synchronized (d->threadListLock)
     {
@@ -126,6 +201,45 @@ bool PiiNetworkServer::stop(PiiNetwork::StopMode mode)
   return true;
 }
 
+void PiiNetworkServer::stopIoThreads(PiiNetwork::StopMode mode)
+{
+  if (d->lstIoThreads.isEmpty())
+    return;
+
+  // Running requests are allowed to finish while the I/O threads are
+  // still there to deliver the responses. New requests are not
+  // started because the state is no longer Running.
+  if (mode == PiiNetwork::InterruptClients)
+    d->bInterrupted = true;
+  else
+    d->pWorkerPool->waitForDone();
+
+  // Destroying the connections wakes up workers blocked on writing.
+  for (int i=0; i<d->lstIoThreads.size(); ++i)
+    d->lstIoThreads[i]->stop();
+  qDeleteAll(d->lstIoThreads);
+  d->lstIoThreads.clear();
+
+  d->pWorkerPool->waitForDone();
+  d->bInterrupted = false;
+}
+
+bool PiiNetworkServer::startRequest(PiiNetworkRequestDevice* request)
+{
+  RequestTask* pTask = new RequestTask(d->pProtocol, request, &d->bInterrupted);
+  synchronized (d->threadListLock)
+    {
+      if (d->state == Running)
+        {
+          // The pool queues the task if all workers are busy.
+          d->pWorkerPool->start(pTask);
+          return true;
+        }
+    }
+  delete pTask;
+  return false;
+}
+
 void PiiNetworkServer::deleteFinishedThreads()
 {
   synchronized (d->threadListLock)
@@ -181,6 +295,24 @@ void PiiNetworkServer::incomingConnection(PiiGenericSocketDescriptor socketDescr
 
   if (d->state != Running) return;
 
+  if (!d->lstIoThreads.isEmpty())
+    {
+      PiiNetworkIoThread* pLeastBusy = d->lstIoThreads[0];
+      int iTotalConnections = 0;
+      for (int i=0; i<d->lstIoThreads.size(); ++i)
+        {
+          int iCount = d->lstIoThreads[i]->connectionCount();
+          iTotalConnections += iCount;
+          if (iCount < pLeastBusy->connectionCount())
+            pLeastBusy = d->lstIoThreads[i];
+        }
+      if (iTotalConnections < d->iMaxConnections)
+        pLeastBusy->addConnection(socketDescriptor);
+      else
+        serverBusy(socketDescriptor);
+      return;
+    }
+
   // If at least one thread is available, use it.
   if (d->lstFreeThreads.size() > 0)
     {
@@ -244,4 +376,10 @@ void PiiNetworkServer::setMaxPendingConnections(int maxPendingConnections) { d->
 int PiiNetworkServer::maxPendingConnections() const { return d->iMaxPendingConnections; }
 void PiiNetworkServer::setBusyMessage(const QString& busyMessage) { d->aBusyMessage = busyMessage.toUtf8(); }
 QString PiiNetworkServer::busyMessage() const { return QString::fromUtf8(d->aBusyMessage.constData(), d->aBusyMessage.size()); }
+void PiiNetworkServer::setIoThreads(int ioThreads) { if (ioThreads >= 0 && ioThreads <= 64) d->iIoThreads = ioThreads; }
+int PiiNetworkServer::ioThreads() const { return d->iIoThreads; }
+void PiiNetworkServer::setMaxConnections(int maxConnections) { if (maxConnections > 0) d->iMaxConnections = maxConnections; }
+int PiiNetworkServer::maxConnections() const { return d->iMaxConnections; }
+void PiiNetworkServer::setMaxConnectionIdleTime(int maxConnectionIdleTime) { d->iMaxConnectionIdleTime = maxConnectionIdleTime; }
+int PiiNetworkServer::maxConnectionIdleTime() const { return d->iMaxConnectionIdleTime; }
 PiiNetworkProtocol* PiiNetworkServer::protocol() const { return d->pProtocol; }
@@ -22,6 +22,9 @@
 #include <QMutex>
 
 #include "PiiNetworkServerThread.h"
+#include "PiiNetworkIoThread.h"
+
+class QThreadPool;
 
 /**
  * An implementation of a threaded network server. This class provides
@@ -37,13 +40,23 @@
  * event loop there. It is not possible to move servers from a thread
  * to another due to limitations of the Qt threading system.
  *
+ * By default, each connection occupies a worker thread until the
+ * client disconnects. If [ioThreads] is set to a non-zero value and
+ * the protocol can frame its requests (see
+ * [PiiNetworkProtocol::requestLength()]), the server runs in
+ * *event-driven* mode instead. A few I/O threads multiplex all
+ * connections in their event loops, and only complete requests are
+ * passed to a pool of at most [maxWorkers] worker threads. Idle
+ * keep-alive connections consume no threads in this mode.
+ *
  * @see PiiTcpServer
  * @see PiiLocalServer
  *
  */
 class PII_NETWORK_EXPORT PiiNetworkServer :
   public QObject,
-  private PiiNetworkServerThread::Controller
+  private PiiNetworkServerThread::Controller,
+  private PiiNetworkIoThread::Controller
 {
   Q_OBJECT
 
@@ -96,6 +109,32 @@ class PII_NETWORK_EXPORT PiiNetworkServer :
    */
   Q_PROPERTY(QString busyMessage READ busyMessage WRITE setBusyMessage);
 
+  /**
+   * The number of I/O threads in event-driven mode. Zero means that
+   * each connection is served by a dedicated worker thread. If the
+   * protocol cannot frame requests, this value is ignored. Changes
+   * take effect when the server is started next time. The default
+   * value is 0.
+   */
+  Q_PROPERTY(int ioThreads READ ioThreads WRITE setIoThreads);
+
+  /**
+   * The maximum number of concurrent connections in event-driven
+   * mode. Further connection attempts will be responded with
+   * [serverBusy()]. In the threaded mode, the number of connections
+   * is limited by [maxWorkers] and [maxPendingConnections]. The
+   * default value is 10000.
+   */
+  Q_PROPERTY(int maxConnections READ maxConnections WRITE setMaxConnections);
+
+  /**
+   * The time (in milliseconds) a connection is allowed to stay idle
+   * in event-driven mode. A connection is idle if no data has been
+   * received and no request is being served. Zero means no limit.
+   * The default value is 60000.
+   */
+  Q_PROPERTY(int maxConnectionIdleTime READ maxConnectionIdleTime WRITE setMaxConnectionIdleTime);
+
 public:
   /**
    * Interrupts all open connections and destroys the server.
@@ -141,6 +180,12 @@ public:
   int maxPendingConnections() const;
   void setBusyMessage(const QString& busyMessage);
   QString busyMessage() const;
+  void setIoThreads(int ioThreads);
+  int ioThreads() const;
+  void setMaxConnections(int maxConnections);
+  int maxConnections() const;
+  void setMaxConnectionIdleTime(int maxConnectionIdleTime);
+  int maxConnectionIdleTime() const;
 
   /**
    * Get the communication protocol.
@@ -159,6 +204,14 @@ public:
   virtual bool setServerAddress(const QString& serverAddress) = 0;
   virtual QString serverAddress() const = 0;
 
+  /**
+   * Creates a socket device for communicating through
+   * *socketDescriptor*. In threaded mode, the function is called by
+   * worker threads. In event-driven mode, it is called by the I/O
+   * threads, which will own the sockets.
+   */
+  virtual QIODevice* createSocket(PiiGenericSocketDescriptor socketDescriptor) = 0;
+
 protected:
   /// @internal
   enum State { Stopped, Stopping, Running };
@@ -174,12 +227,19 @@ protected:
     int iWorkerMaxIdleTime;
     int iMaxPendingConnections;
     QByteArray aBusyMessage;
+    int iIoThreads;
+    int iMaxConnections;
+    int iMaxConnectionIdleTime;
 
     QMutex threadListLock;
     QList<PiiNetworkServerThread*> lstFreeThreads, lstAllThreads, lstFinishedThreads;
     QQueue<PiiGenericSocketDescriptor> lstPendingConnections;
     PiiNetworkProtocol* pProtocol;
 
+    QList<PiiNetworkIoThread*> lstIoThreads;
+    QThreadPool* pWorkerPool;
+    volatile bool bInterrupted;
+
     State state;
     QString strServerAddress;
   } *d;
@@ -232,6 +292,10 @@ protected:
    *
    * -# Call [serverBusy()].
    *
+   * In event-driven mode, the connection is given to the I/O thread
+   * with the least connections, or [serverBusy()] is called if
+   * [maxConnections] has been reached.
+   *
    * The function is called by subclasses that handle the conversion
    * from their native socket descriptor format to
    * PiiGenericSocketDescriptor.
@@ -270,6 +334,9 @@ private:
   friend class PiiNetworkServerThread;
   void threadAvailable(PiiNetworkServerThread* thread);
   void threadFinished(PiiNetworkServerThread* tread);
+  bool startRequest(PiiNetworkRequestDevice* request);
+
+  void stopIoThreads(PiiNetwork::StopMode mode);
 
   void deleteFinishedThreads();
   void waitAll(const QList<PiiNetworkServerThread*>& threads);
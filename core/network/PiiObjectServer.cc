@@ -28,6 +28,7 @@
 #include <QMetaProperty>
 #include <QMetaMethod>
 #include <QUuid>
+#include <QCryptographicHash>
 
 #include "PiiNetworkEncoding.h"
 
@@ -268,7 +269,13 @@ void PiiObjectServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
             {
               varReturn = call(strFunction, lstParams);
               if (varReturn.isValid())
-                dev->write(dev->encode(varReturn));
+                {
+                  QByteArray aReturn(dev->encode(varReturn));
+                  // Small values are not worth compressing.
+                  if (aReturn.size() > 1024)
+                    dev->startOutputCompression();
+                  dev->write(aReturn);
+                }
             }
           catch (PiiHttpException& ex)
             {
@@ -302,9 +309,7 @@ void PiiObjectServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
             {
               PII_REQUIRE_HTTP_METHOD("GET");
               QString strChannelId = createNewChannel(dev->requestHeader().value("X-Client-ID"));
-              dev->print(strChannelId);
-              dev->putChar('\n');
-              channelById(strChannelId)->push(dev, controller, &lock); // may throw
+              channelById(strChannelId)->push(dev, controller, &lock, strChannelId); // may throw
             }
           else
             // strFunction must be of the form channel-id/action
@@ -421,7 +426,11 @@ QString PiiObjectServer::createNewChannel(const QString& clientId)
   // Remove curly braces around the uuid
   QString strId = QUuid::createUuid().toString().mid(1);
   strId.chop(1);
-  d->hashChannelsById.insert(strId, createChannel(clientId));
+  ChannelImpl* pChannel = createChannel(clientId);
+  for (QMap<QString,int>::const_iterator it = d->mapPushIntervals.constBegin();
+       it != d->mapPushIntervals.constEnd(); ++it)
+    pChannel->setPushInterval(it.key(), it.value());
+  d->hashChannelsById.insert(strId, pChannel);
   return strId;
 }
 
@@ -480,6 +489,24 @@ void PiiObjectServer::sendToOtherClients(const QString& sendingClientId,
 void PiiObjectServer::setChannelTimeout(int channelTimeout) { d->iChannelTimeout = channelTimeout; }
 int PiiObjectServer::channelTimeout() const { return d->iChannelTimeout; }
 
+void PiiObjectServer::setPushInterval(const QString& sourceId, int interval)
+{
+  QMutexLocker lock(&d->channelMutex);
+  if (interval < 0)
+    d->mapPushIntervals.remove(sourceId);
+  else
+    d->mapPushIntervals[sourceId] = interval;
+  for (QHash<QString,ChannelImpl*>::const_iterator it = d->hashChannelsById.constBegin();
+       it != d->hashChannelsById.constEnd(); ++it)
+    (*it)->setPushInterval(sourceId, interval);
+}
+
+int PiiObjectServer::pushInterval(const QString& sourceId) const
+{
+  QMutexLocker lock(&d->channelMutex);
+  return d->mapPushIntervals.value(sourceId, -1);
+}
+
 bool PiiObjectServer::addCallback(const QString& signature)
 {
   QRegExp re("([^(]+)\\(([^)]*)\\)");
@@ -533,6 +560,18 @@ QString PiiObjectServer::Channel::clientId() const { return _strClientId; }
 bool PiiObjectServer::Channel::enqueuePushData(const QString& sourceId, const QByteArray& data)
 {
   QMutexLocker lock(&_queueMutex);
+  // Latest value wins. The replaced value keeps its place in the
+  // queue so that a frequently changing source won't starve.
+  if (_hashPushIntervals.contains(sourceId))
+    {
+      for (int i=0; i<_dataQueue.size(); ++i)
+        if (_dataQueue[i].first == sourceId)
+          {
+            _dataQueue[i].second = data;
+            return true;
+          }
+    }
+
   if (_dataQueue.size() >= 20)
     return false;
 
@@ -546,6 +585,15 @@ bool PiiObjectServer::Channel::enqueuePushData(const QString& sourceId, const QB
   return true;
 }
 
+void PiiObjectServer::Channel::setPushInterval(const QString& sourceId, int interval)
+{
+  QMutexLocker lock(&_queueMutex);
+  if (interval < 0)
+    _hashPushIntervals.remove(sourceId);
+  else
+    _hashPushIntervals[sourceId] = interval;
+}
+
 PiiObjectServer::ChannelImpl::ChannelImpl(const QString& clientId) :
   Channel(clientId),
   _bPushing(false),
@@ -582,12 +630,186 @@ void PiiObjectServer::ChannelImpl::wait()
     _pushEndCondition.wait(&_queueMutex);
 }
 
+namespace
+{
+  const char* pBoundary = "--243F6A8885A308D3";
+  const char* pWebSocketGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+  enum WebSocketOpCode
+    {
+      WebSocketText = 0x1,
+      WebSocketBinary = 0x2,
+      WebSocketClose = 0x8,
+      WebSocketPing = 0x9,
+      WebSocketPong = 0xa
+    };
+
+  void appendLittleEndian(QByteArray& array, quint32 value)
+  {
+    for (int i=0; i<4; ++i, value >>= 8)
+      array.append(char(value & 0xff));
+  }
+
+  // Writes the header of an unmasked, unfragmented WebSocket frame.
+  bool writeWebSocketHeader(PiiHttpDevice* dev, int opCode, qint64 length)
+  {
+    QByteArray aHeader;
+    aHeader.append(char(0x80 | opCode));
+    if (length < 126)
+      aHeader.append(char(length));
+    else if (length < 65536)
+      {
+        aHeader.append(char(126));
+        aHeader.append(char(length >> 8));
+        aHeader.append(char(length & 0xff));
+      }
+    else
+      {
+        aHeader.append(char(127));
+        for (int i=56; i>=0; i-=8)
+          aHeader.append(char((length >> i) & 0xff));
+      }
+    return dev->write(aHeader) == aHeader.size();
+  }
+}
+
+PiiObjectServer::ChannelImpl::Framing PiiObjectServer::ChannelImpl::framingOf(PiiHttpDevice* dev)
+{
+  PiiHttpRequestHeader header(dev->requestHeader());
+  if (header.value("Upgrade").toLower() == "websocket")
+    {
+      if (header.value("Sec-WebSocket-Version") != "13")
+        {
+          dev->setHeader("Sec-WebSocket-Version", "13");
+          PII_THROW_HTTP_ERROR(UpgradeRequiredStatus);
+        }
+      if (header.value("Sec-WebSocket-Key").isEmpty())
+        PII_THROW_HTTP_ERROR(BadRequestStatus);
+      return WebSocketFraming;
+    }
+  if (dev->queryValue("format").toString() == "binary")
+    return BinaryFraming;
+  return MultipartFraming;
+}
+
+// _queueMutex must be held when calling this function. Returns the
+// index of the first item in the queue that can be sent now, or -1
+// if there is none. In the latter case, *waitTime* is set to the
+// number of milliseconds until a rate-limited item becomes due.
+int PiiObjectServer::ChannelImpl::nextPushable(int* waitTime) const
+{
+  qint64 iNow = _pushTimer.milliseconds();
+  for (int i=0; i<_dataQueue.size(); ++i)
+    {
+      int iInterval = _hashPushIntervals.value(_dataQueue[i].first, 0);
+      QHash<QString,qint64>::const_iterator it = _hashLastPushTimes.constFind(_dataQueue[i].first);
+      if (iInterval <= 0 || it == _hashLastPushTimes.constEnd())
+        return i;
+      qint64 iElapsed = iNow - *it;
+      if (iElapsed >= iInterval)
+        return i;
+      *waitTime = qMin(*waitTime, int(iInterval - iElapsed));
+    }
+  return -1;
+}
+
+bool PiiObjectServer::ChannelImpl::writeMessage(PiiHttpDevice* dev, Framing framing,
+                                                const QString& sourceId, const QByteArray& data)
+{
+  if (framing == MultipartFraming)
+    {
+      dev->print(QString("X-ID: %1\r\nContent-Length: %2\r\n\r\n")
+                 .arg(sourceId).arg(data.size()));
+      qint64 iBytesWritten = dev->write(data);
+      if (iBytesWritten != data.size())
+        {
+          piiWarning("Failed to push data to channel. Only %d bytes written out of %d.",
+                     int(iBytesWritten), data.size());
+          return false;
+        }
+      dev->write("\r\n");
+      dev->write(pBoundary);
+      dev->write("\r\n");
+    }
+  else
+    {
+      QByteArray aHeader, aId(sourceId.toUtf8());
+      appendLittleEndian(aHeader, aId.size());
+      aHeader.append(aId);
+      appendLittleEndian(aHeader, data.size());
+      if ((framing == WebSocketFraming &&
+           !writeWebSocketHeader(dev, WebSocketBinary, aHeader.size() + data.size())) ||
+          dev->write(aHeader) != aHeader.size() ||
+          dev->write(data) != data.size())
+        {
+          piiWarning("Failed to push data to channel.");
+          return false;
+        }
+    }
+  dev->flushFilter();
+  return true;
+}
+
+// Reads and handles one frame sent by a WebSocket client. Returns
+// false if the connection must be closed.
+bool PiiObjectServer::ChannelImpl::readWebSocketFrame(PiiHttpDevice* dev)
+{
+  PiiSocketDevice socket(dev->device());
+  unsigned char header[8];
+  if (socket.readWaited(reinterpret_cast<char*>(header), 2) != 2)
+    return false;
+  int iOpCode = header[0] & 0xf;
+  bool bMasked = (header[1] & 0x80) != 0;
+  qint64 iLength = header[1] & 0x7f;
+  if (iLength >= 126)
+    {
+      int iBytes = iLength == 126 ? 2 : 8;
+      if (socket.readWaited(reinterpret_cast<char*>(header), iBytes) != iBytes)
+        return false;
+      iLength = 0;
+      for (int i=0; i<iBytes; ++i)
+        iLength = (iLength << 8) | header[i];
+    }
+  // The channel is controlled with HTTP requests. There is no reason
+  // for a client to send large messages.
+  if (iLength > 65536)
+    return false;
+  unsigned char mask[4] = { 0, 0, 0, 0 };
+  if (bMasked && socket.readWaited(reinterpret_cast<char*>(mask), 4) != 4)
+    return false;
+  QByteArray aPayload(int(iLength), 0);
+  if (socket.readWaited(aPayload.data(), iLength) != iLength)
+    return false;
+  for (int i=0; i<aPayload.size(); ++i)
+    aPayload[i] = char(aPayload.at(i) ^ mask[i & 3]);
+
+  switch (iOpCode)
+    {
+    case WebSocketClose:
+      // Echo the status code back and close.
+      aPayload = aPayload.left(2);
+      writeWebSocketHeader(dev, WebSocketClose, aPayload.size());
+      dev->write(aPayload);
+      dev->flushFilter();
+      return false;
+    case WebSocketPing:
+      writeWebSocketHeader(dev, WebSocketPong, aPayload.size());
+      dev->write(aPayload);
+      dev->flushFilter();
+      break;
+    default:
+      break;
+    }
+  return true;
+}
+
 // *lock* must be held when calling this function
 void PiiObjectServer::ChannelImpl::push(PiiHttpDevice* dev,
                                         PiiHttpProtocol::TimeLimiter* controller,
-                                        QMutexLocker* lock)
+                                        QMutexLocker* lock,
+                                        const QString& preamble)
 {
-  static const char* pBoundary = "--243F6A8885A308D3";
+  Framing framing = framingOf(dev); // may throw
 
   /* If we are currently pushing, it means either of the following:
      1) an unauthorized client figured out the channel ID and is trying to steal it.
@@ -615,9 +837,50 @@ void PiiObjectServer::ChannelImpl::push(PiiHttpDevice* dev,
   lock->unlock();
 
   controller->setMaxTime(-1);
-  dev->setHeader("Content-Type", QString("multipart/mixed-replace; boundary=\"%1\"").arg(pBoundary+2));
-  dev->write(pBoundary);
-  dev->write("\r\n");
+  switch (framing)
+    {
+    case MultipartFraming:
+      dev->setHeader("Content-Type", QString("multipart/mixed-replace; boundary=\"%1\"").arg(pBoundary+2));
+      break;
+    case BinaryFraming:
+      dev->setHeader("Content-Type", "application/x-into-channel");
+      break;
+    case WebSocketFraming:
+      dev->setStatus(PiiHttpProtocol::SwitchingProtocolsStatus);
+      dev->setHeader("Upgrade", "websocket");
+      dev->setHeader("Connection", "Upgrade");
+      dev->setHeader("Sec-WebSocket-Accept",
+                     QCryptographicHash::hash(dev->requestHeader().value("Sec-WebSocket-Key").toLatin1() +
+                                              pWebSocketGuid,
+                                              QCryptographicHash::Sha1).toBase64().constData());
+      break;
+    }
+  // Send the header now. Otherwise an empty buffer would make
+  // endOutputFiltering() set Content-Length to zero.
+  dev->sendHeader();
+
+  if (framing == WebSocketFraming)
+    {
+      if (!preamble.isEmpty())
+        {
+          QByteArray aId(preamble.toUtf8());
+          writeWebSocketHeader(dev, WebSocketText, aId.size());
+          dev->write(aId);
+        }
+    }
+  else
+    {
+      if (!preamble.isEmpty())
+        {
+          dev->print(preamble);
+          dev->putChar('\n');
+        }
+      if (framing == MultipartFraming)
+        {
+          dev->write(pBoundary);
+          dev->write("\r\n");
+        }
+    }
   // Flush all buffered data to socket and pass all remaining data
   // unfiltered.
   dev->outputFilter()->flushFilter();
@@ -626,40 +889,46 @@ void PiiObjectServer::ChannelImpl::push(PiiHttpDevice* dev,
   dev->flushFilter();
 
   _queueMutex.lock();
+  _pushTimer.restart();
+  _hashLastPushTimes.clear();
 
   forever
     {
-      while (!_bKilled && !_dataQueue.isEmpty() && dev->isWritable() && controller->canContinue())
+      int iWaitTime = 50;
+      while (!_bKilled && dev->isWritable() && controller->canContinue())
         {
-          QPair<QString,QByteArray> pair(_dataQueue.dequeue());
+          int iIndex = nextPushable(&iWaitTime);
+          if (iIndex < 0)
+            break;
+          QPair<QString,QByteArray> pair(_dataQueue.takeAt(iIndex));
+          if (_hashPushIntervals.contains(pair.first))
+            _hashLastPushTimes[pair.first] = _pushTimer.milliseconds();
 
           // Writing to the device may take time. Let new data appear
           // meanwhile.
           _queueMutex.unlock();
-          //piiDebug("PiiObjectServer::push() writing");
-          dev->print(QString("X-ID: %1\r\nContent-Length: %2\r\n\r\n")
-                     .arg(pair.first).arg(pair.second.size()));
-          qint64 iBytesWritten = dev->write(pair.second);
-          // Couldn't write all data -> warn and put the data back to
-          // the queue.
-          if (iBytesWritten != pair.second.size())
-            {
-              piiWarning("Failed to push data to channel. Only %d bytes written out of %d.",
-                         int(iBytesWritten), pair.second.size());
-              synchronized (_queueMutex) _dataQueue.prepend(pair);
-              continue;
-            }
-          dev->write("\r\n");
-          dev->write(pBoundary);
-          dev->write("\r\n");
-          dev->flushFilter();
-          //piiDebug("Wrote %d of %d bytes to %s", (int)iBytesWritten, pair.second.size(), piiPrintable(pair.first));
+          bool bWritten = writeMessage(dev, framing, pair.first, pair.second);
           _queueMutex.lock();
+          // Couldn't write all data -> put the data back to the queue.
+          if (!bWritten)
+            _dataQueue.prepend(pair);
         }
       if (_bKilled || !dev->isWritable() || !controller->canContinue())
         break;
 
-      _queueCondition.wait(&_queueMutex, 50);
+      if (framing == WebSocketFraming)
+        {
+          _queueMutex.unlock();
+          bool bOpen = true;
+          PiiSocketDevice socket(dev->device());
+          while (bOpen && (socket->bytesAvailable() >= 2 || socket->waitForReadyRead(0)))
+            bOpen = readWebSocketFrame(dev);
+          _queueMutex.lock();
+          if (!bOpen)
+            break;
+        }
+
+      _queueCondition.wait(&_queueMutex, qMax(iWaitTime, 1));
     }
 
   _bKilled = false;
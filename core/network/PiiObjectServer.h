@@ -208,6 +208,40 @@
  * data pushed to the channel is just a QByteArray. Encoding and
  * decoding must be implemented case-by-case.
  *
+ * By default, each data item is queued and sent to the client as
+ * such. If a source changes faster than a slow client can read it
+ * (think of a live counter or the latest image from a camera), the
+ * queue fills up and further data is dropped. To prevent this, use
+ * [setPushInterval()] to make the source *coalesced*: a new value
+ * from a coalesced source replaces the one still waiting in the
+ * queue, and the server sends at most one value per push interval.
+ * The client will always receive the latest value, but may miss
+ * intermediate ones.
+ *
+ * Framing
+ * -------
+ *
+ * The multipart encoding shown above is the default. Clients that
+ * don't want to parse MIME headers can request binary framing by
+ * adding "format=binary" to the query string of /channels/new (or
+ * /channels/channel-id). The response will have the Content-Type
+ * "application/x-into-channel", the first row will still contain
+ * the channel ID, and each message is encoded as follows:
+ *
+ * - Length of the source ID in bytes (32-bit unsigned, little endian)
+ * - Source ID, UTF-8 encoded
+ * - Length of data in bytes (32-bit unsigned, little endian)
+ * - Data
+ *
+ * Web browsers can connect to a channel using the WebSocket
+ * protocol (RFC 6455). If the request to /channels/new contains
+ * the "Upgrade: websocket" header, the server switches protocols.
+ * The channel ID will be sent as a text message, and each pushed
+ * data item as a binary message that uses the binary framing
+ * described above. The server answers to ping and close messages
+ * but ignores other messages sent by the client; the channel is
+ * controlled with normal HTTP requests.
+ *
  * A client can reconnect to a disconnected channel by requesting
  * /channels/channel-id. The server keeps unclosed channels in memory
  * for a while allowing clients to recover from network failures. If
@@ -391,6 +425,30 @@ public:
    */
   int channelTimeout() const;
 
+  /**
+   * Sets the minimum number of milliseconds between two successive
+   * messages pushed from *sourceId* to a channel. Setting an
+   * interval makes the source coalesced: if a channel already has a
+   * value from *sourceId* in its queue, a new value replaces it
+   * instead of being queued after it. Zero means that values are
+   * coalesced but sent as fast as the client can receive them. A
+   * negative value restores the default behavior, which is to queue
+   * every value. The setting affects all current and future
+   * channels.
+   *
+   * ~~~(c++)
+   * // Send the latest image at most ten times a second
+   * server.setPushInterval("properties/image", 100);
+   * ~~~
+   */
+  void setPushInterval(const QString& sourceId, int interval);
+
+  /**
+   * Returns the push interval of *sourceId*, or -1 if the source is
+   * not coalesced.
+   */
+  int pushInterval(const QString& sourceId) const;
+
   /**
    * Registers a call-back function with the given *signature*. The
    * signature will be listed under "/callbacks/" and clients will be
@@ -484,6 +542,12 @@ protected:
      */
     bool enqueuePushData(const QString& sourceId, const QByteArray& data);
 
+    /**
+     * Sets the push interval of *sourceId* in this channel. See
+     * [PiiObjectServer::setPushInterval()].
+     */
+    void setPushInterval(const QString& sourceId, int interval);
+
     /**
      * Returns the ID of the client connected to this channel. If the
      * client didn't provide an ID, returns an empty string.
@@ -496,6 +560,7 @@ protected:
     mutable QMutex _queueMutex;
     QWaitCondition _queueCondition, _pushEndCondition;
     QQueue<QPair<QString,QByteArray> > _dataQueue;
+    QHash<QString,int> _hashPushIntervals;
     QString _strClientId;
     /// @endhide
   };
@@ -506,7 +571,8 @@ protected:
   public:
     ChannelImpl(const QString& clientId);
 
-    void push(PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller, QMutexLocker* lock);
+    void push(PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller, QMutexLocker* lock,
+              const QString& preamble = QString());
     void removeObjectsQueuedTo(const QString& uri);
     bool isAlive(int timeout) const;
     void quit();
@@ -515,8 +581,17 @@ protected:
     QStringList lstSources;
 
   private:
+    enum Framing { MultipartFraming, BinaryFraming, WebSocketFraming };
+
+    int nextPushable(int* waitTime) const;
+    bool writeMessage(PiiHttpDevice* dev, Framing framing,
+                      const QString& sourceId, const QByteArray& data);
+    bool readWebSocketFrame(PiiHttpDevice* dev);
+    static Framing framingOf(PiiHttpDevice* dev);
+
     bool _bPushing, _bKilled;
-    PiiTimer _idleTimer;
+    PiiTimer _idleTimer, _pushTimer;
+    QHash<QString,qint64> _hashLastPushTimes;
   };
 
   /// @internal
@@ -551,6 +626,7 @@ protected:
     QMutex channelMutex;
     QHash<QString,ChannelImpl*> hashChannelsById;
     int iChannelTimeout;
+    QMap<QString,int> mapPushIntervals;
     ThreadSafetyLevel safetyLevel;
     SafetyLevelMap mapFunctionSafetyLevels;
     QString strId;
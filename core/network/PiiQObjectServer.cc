@@ -260,6 +260,7 @@ void PiiQObjectServer::listProperties(PiiHttpDevice* dev) const
   if (dev->queryValue("format").toString() == "json")
     {
       dev->setHeader("Content-Type", "application/javascript");
+      dev->startOutputCompression();
       jsonProperties(dev, dev->queryValue("fields").toString().split(',', QString::SkipEmptyParts));
     }
   else
@@ -19,6 +19,7 @@
 #include "PiiHttpProtocol.h"
 #include "PiiMultipartDecoder.h"
 #include "PiiStreamBuffer.h"
+#include "PiiNetworkConnectionPool.h"
 
 #include <PiiTimer.h>
 #include <PiiAsyncCall.h>
@@ -29,12 +30,235 @@
 
 #include <QUrl>
 #include <QUuid>
+#include <QQueue>
 
 #include "PiiNetworkEncoding.h"
 #include "PiiQObjectServer.h"
 
+class PiiRemoteReply::Data : public PiiSharedObject
+{
+public:
+  Data() : pPipeline(0), bFinished(false) {}
+  ~Data();
+
+  // The pipeline the call was sent to, if any. The reply holds a
+  // reference to it.
+  PiiRemotePipeline* pPipeline;
+  bool bFinished;
+  QVariant varValue;
+  QByteArray aRemoteException;
+  QString strError, strErrorLocation;
+
+  void setError(const PiiException& ex)
+  {
+    strError = ex.message();
+    strErrorLocation = ex.location();
+  }
+};
+
+/* Asynchronous calls of a remote object. The requests are written
+   one after another on the same connection, and the responses are
+   read in the same order. The pipeline is shared by the remote object
+   and the replies that may still be waiting for it.
+*/
+class PiiRemotePipeline : public PiiSharedObject
+{
+public:
+  ~PiiRemotePipeline();
+
+  struct PendingCall
+  {
+    PiiHttpDevice* pDevice;
+    // Zero if nobody is interested in the result any more.
+    PiiRemoteReply::Data* pReply;
+  };
+
+  // Must be held when accessing anything in the pipeline and the
+  // replies pending in it.
+  QMutex mutex;
+  QString strServerAddress;
+  PiiSocketDevice socket;
+  QQueue<PendingCall> lstPending;
+
+  void readNext();
+  void failAll(const QString& message);
+  void closeSocket();
+  void returnSocket();
+  static void readReply(PiiHttpDevice* dev, PiiRemoteReply::Data* reply);
+
+private:
+  static QString tr(const char* s) { return QCoreApplication::translate("PiiRemoteObject", s); }
+};
+
+// Locks the pipeline and holds its socket in the current thread.
+class PiiRemotePipelineLocker
+{
+public:
+  PiiRemotePipelineLocker(PiiRemotePipeline* pipeline) :
+    _lock(&pipeline->mutex),
+    _pPipeline(pipeline)
+  {
+    PiiNetworkConnectionPool::attachToThread(_pPipeline->socket.device());
+  }
+
+  ~PiiRemotePipelineLocker()
+  {
+    PiiNetworkConnectionPool::detachFromThread(_pPipeline->socket.device());
+  }
+
+private:
+  QMutexLocker _lock;
+  PiiRemotePipeline* _pPipeline;
+};
+
+PiiRemotePipeline::~PiiRemotePipeline()
+{
+  // Only abandoned calls can be left here.
+  while (!lstPending.isEmpty())
+    delete lstPending.dequeue().pDevice;
+  closeSocket();
+}
+
+void PiiRemotePipeline::readReply(PiiHttpDevice* dev, PiiRemoteReply::Data* reply)
+{
+  PiiHttpDevice* pDev = dev;
+  try
+    {
+      PII_THROW_IF_NOT_CONNECTED;
+      if (!pDev->readHeader())
+        PII_THROW(PiiNetworkException, tr(PiiNetwork::pErrorReadingResponseHeader));
+      if (pDev->status() == PiiNetwork::RemoteExceptionStatus)
+        {
+          reply->aRemoteException = pDev->readBody();
+          if (reply->aRemoteException.isEmpty())
+            PII_THROW(PiiSerializationException, tr("The remote function threw an exception, but no data was received."));
+        }
+      else
+        reply->varValue = PiiRemoteObject::decodeResponse(pDev);
+    }
+  catch (PiiException& ex)
+    {
+      reply->setError(ex);
+    }
+  reply->bFinished = true;
+}
+
+void PiiRemotePipeline::readNext()
+{
+  PendingCall call = lstPending.dequeue();
+  PiiRemoteReply::Data tmpReply;
+  PiiRemoteReply::Data* pReply = call.pReply != 0 ? call.pReply : &tmpReply;
+  readReply(call.pDevice, pReply);
+
+  const bool bReusable = call.pDevice->isMessageComplete() &&
+    call.pDevice->connectionType() != PiiHttpDevice::CloseConnection;
+  delete call.pDevice;
+  if (!bReusable)
+    {
+      closeSocket();
+      failAll(tr("The connection broke before the response was received."));
+    }
+}
+
+void PiiRemotePipeline::failAll(const QString& message)
+{
+  while (!lstPending.isEmpty())
+    {
+      PendingCall call = lstPending.dequeue();
+      delete call.pDevice;
+      if (call.pReply != 0)
+        {
+          call.pReply->strError = message;
+          call.pReply->bFinished = true;
+        }
+    }
+}
+
+void PiiRemotePipeline::closeSocket()
+{
+  delete socket.device();
+  socket = PiiSocketDevice();
+}
+
+void PiiRemotePipeline::returnSocket()
+{
+  PiiNetworkConnectionPool::give(strServerAddress, socket);
+  socket = PiiSocketDevice();
+}
+
+PiiRemoteReply::Data::~Data()
+{
+  if (pPipeline == 0)
+    return;
+  // The response still needs to be read, but nobody will store it.
+  synchronized (pPipeline->mutex)
+    for (int i=0; i<pPipeline->lstPending.size(); ++i)
+      if (pPipeline->lstPending[i].pReply == this)
+        pPipeline->lstPending[i].pReply = 0;
+  pPipeline->release();
+}
+
+PiiRemoteReply::PiiRemoteReply() : d(new Data)
+{
+  d->bFinished = true;
+}
+
+PiiRemoteReply::PiiRemoteReply(Data* data) : d(data)
+{}
+
+PiiRemoteReply::PiiRemoteReply(const PiiRemoteReply& other) : d(other.d)
+{
+  d->reserve();
+}
+
+PiiRemoteReply::~PiiRemoteReply()
+{
+  d->release();
+}
+
+PiiRemoteReply& PiiRemoteReply::operator= (const PiiRemoteReply& other)
+{
+  other.d->reserve();
+  d->release();
+  d = other.d;
+  return *this;
+}
+
+bool PiiRemoteReply::isFinished() const
+{
+  if (d->pPipeline == 0)
+    return d->bFinished;
+  QMutexLocker lock(&d->pPipeline->mutex);
+  return d->bFinished;
+}
+
+void PiiRemoteReply::waitForFinished()
+{
+  if (d->pPipeline == 0)
+    return;
+  PiiRemotePipeline* pPipeline = d->pPipeline;
+  PiiRemotePipelineLocker lock(pPipeline);
+  while (!d->bFinished && !pPipeline->lstPending.isEmpty())
+    pPipeline->readNext();
+  // Nothing more to read. Let others use the connection.
+  if (pPipeline->lstPending.isEmpty() && pPipeline->socket != 0)
+    pPipeline->returnSocket();
+}
+
+QVariant PiiRemoteReply::value()
+{
+  waitForFinished();
+  if (!d->aRemoteException.isEmpty())
+    PiiRemoteObject::throwRemoteException(d->aRemoteException); // throws
+  if (!d->strError.isEmpty())
+    throw PiiNetworkException(d->strError, d->strErrorLocation);
+  return d->varValue;
+}
+
 PiiRemoteObject::Data::Data() :
   pHttpDevice(0),
+  pPipeline(new PiiRemotePipeline),
+  iMaxPipelineDepth(8),
   pChannelThread(0),
   bChannelRunning(false),
   iRetryCount(3),
@@ -71,21 +295,77 @@ PiiRemoteObject::~PiiRemoteObject()
       }
 
   delete d->pHttpDevice;
+  d->pPipeline->release();
   for (int i = 0; i < d->lstCallbacks.size(); ++i)
     delete d->lstCallbacks[i].second;
   delete d;
 }
 
-// PENDING this should use a global pool of connections to avoid
-// establishing a new one for each remote object on the same server.
+PiiRemoteObject::HttpDevicePtr::Data::Data(QMutex* mutex, PiiHttpDevice* device,
+                                            const QString& serverAddress, bool reused) :
+  pMutex(mutex),
+  pDevice(device),
+  strServerAddress(serverAddress),
+  bReused(reused)
+{
+  if (pMutex != 0)
+    pMutex->lock();
+}
+
+PiiRemoteObject::HttpDevicePtr::Data::~Data()
+{
+  if (pMutex != 0)
+    {
+      pMutex->unlock();
+      return;
+    }
+  // A connection can carry another request only if the response has
+  // been fully read.
+  PiiSocketDevice socket(pDevice->device());
+  const bool bReusable = pDevice->isMessageComplete() &&
+    pDevice->connectionType() != PiiHttpDevice::CloseConnection;
+  delete pDevice;
+  if (bReusable)
+    PiiNetworkConnectionPool::give(strServerAddress, socket);
+  else
+    delete socket.device();
+}
+
+PiiRemoteObject::HttpDevicePtr::HttpDevicePtr(QMutex* mutex, PiiHttpDevice* device) :
+  d(new Data(mutex, device, QString(), false))
+{}
+
+PiiRemoteObject::HttpDevicePtr::HttpDevicePtr(PiiHttpDevice* device, const QString& serverAddress, bool reused) :
+  d(new Data(0, device, serverAddress, reused))
+{}
+
+PiiRemoteObject::HttpDevicePtr::HttpDevicePtr(const HttpDevicePtr& other) :
+  d(other.d->reserved())
+{}
+
+PiiRemoteObject::HttpDevicePtr::~HttpDevicePtr()
+{
+  d->release();
+}
+
+PiiRemoteObject::HttpDevicePtr& PiiRemoteObject::HttpDevicePtr::operator= (const HttpDevicePtr& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+PiiRemoteObject::HttpDevicePtr::operator PiiHttpDevice* () const { return d->pDevice; }
+PiiHttpDevice* PiiRemoteObject::HttpDevicePtr::operator-> () const { return d->pDevice; }
+bool PiiRemoteObject::HttpDevicePtr::isReusedConnection() const { return d->bReused; }
+
 PiiRemoteObject::HttpDevicePtr PiiRemoteObject::openConnection()
 {
-  HttpDevicePtr pDev(&d->deviceMutex);
   // If the server is in the same process and this call is being made
   // from the main thread, we could deadlock otherwise...
   if (d->pLocalServer &&
       QThread::currentThread() == qApp->thread())
     {
+      HttpDevicePtr pDev(&d->deviceMutex, 0);
       d->buffer.close();
       d->buffer.setData(QByteArray());
       d->buffer.open(QIODevice::ReadWrite);
@@ -98,42 +378,51 @@ PiiRemoteObject::HttpDevicePtr PiiRemoteObject::openConnection()
         d->pHttpDevice = new PiiHttpDevice(&d->buffer, PiiHttpDevice::Client);
       else if (d->pHttpDevice->device() != &d->buffer)
         d->pHttpDevice->setDevice(&d->buffer);
+      // Add an X-Client-ID header to all outgoing requests.
+      d->pHttpDevice->setHeader("X-Client-ID", d->strClientId);
+      pDev.d->pDevice = d->pHttpDevice;
+      return pDev;
     }
-  else
-    {
-      if (unsigned(d->iFailureCount.load()) > unsigned(d->iMaxFailureCount))
-        PII_THROW(PiiNetworkException, tr("Maximum number of failures reached."));
 
-      QIODevice* pSocket = 0;
-      for (int iTry = 0; iTry <= d->iRetryCount; ++iTry)
-        {
-          pSocket = d->networkClient.openConnection();
-          if (pSocket != 0)
-            break;
-          else if (iTry != d->iRetryCount)
-            PiiDelay::msleep(d->iRetryDelay);
-        }
-      if (pSocket == 0)
-        {
-          addFailure();
-          PII_THROW(PiiNetworkException,
-                    tr("Connection to the server object at %1 could not be established.").arg(serverUri()));
-        }
-      if (d->pHttpDevice == 0)
-        d->pHttpDevice = new PiiHttpDevice(pSocket, PiiHttpDevice::Client);
-      else if (d->pHttpDevice->device() != pSocket)
-        d->pHttpDevice->setDevice(pSocket);
-    }
+  bool bReused = false;
+  PiiSocketDevice socket = takeConnection(&bReused);
+  HttpDevicePtr pDev(new PiiHttpDevice(socket, PiiHttpDevice::Client),
+                     d->networkClient.serverAddress(), bReused);
+  pDev->setHeader("X-Client-ID", d->strClientId);
+  return pDev;
+}
 
-  // Add an X-Client-ID header to all outgoing requests.
-  d->pHttpDevice->setHeader("X-Client-ID", d->strClientId);
-  return pDev = d->pHttpDevice;
+PiiSocketDevice PiiRemoteObject::takeConnection(bool* reused)
+{
+  if (unsigned(d->iFailureCount.load()) > unsigned(d->iMaxFailureCount))
+    PII_THROW(PiiNetworkException, tr("Maximum number of failures reached."));
+
+  PiiSocketDevice socket;
+  for (int iTry = 0; iTry <= d->iRetryCount; ++iTry)
+    {
+      socket = PiiNetworkConnectionPool::take(d->networkClient.serverAddress(),
+                                              d->networkClient.connectionTimeout(),
+                                              reused);
+      if (socket != 0)
+        break;
+      else if (iTry != d->iRetryCount)
+        PiiDelay::msleep(d->iRetryDelay);
+    }
+  if (socket == 0)
+    {
+      addFailure();
+      PII_THROW(PiiNetworkException,
+                tr("Connection to the server object at %1 could not be established.").arg(serverUri()));
+    }
+  return socket;
 }
 
 void PiiRemoteObject::closeConnection()
 {
-  QMutexLocker lock(&d->deviceMutex);
-  d->networkClient.closeConnection();
+  PiiNetworkConnectionPool::clear(d->networkClient.serverAddress());
+  PiiRemotePipelineLocker lock(d->pPipeline);
+  d->pPipeline->failAll(tr("The connection was closed."));
+  d->pPipeline->closeSocket();
 }
 
 void PiiRemoteObject::finishRequest(PiiHttpDevice* dev)
@@ -565,53 +854,162 @@ QString PiiRemoteObject::serverUri() const
 
 void PiiRemoteObject::handleException(PiiHttpDevice* dev)
 {
-  QByteArray aData = dev->readBody();
-  if (!aData.isEmpty())
+  throwRemoteException(dev->readBody());
+}
+
+void PiiRemoteObject::throwRemoteException(const QByteArray& data)
+{
+  if (!data.isEmpty())
     {
       PiiException* pException;
-      pException = PiiNetwork::fromByteArray<PiiException*>(aData); // may throw
+      pException = PiiNetwork::fromByteArray<PiiException*>(data); // may throw
       pException->throwIt(); // throws
     }
   PII_THROW(PiiSerializationException, tr("The remote function threw an exception, but no data was received."));
 }
 
-QVariant PiiRemoteObject::callList(const QString& uri, const QVariantList& params)
+QVariant PiiRemoteObject::decodeResponse(PiiHttpDevice* dev)
 {
-  HttpDevicePtr pDev = openConnection();
+  switch (dev->status())
+    {
+    case PiiHttpProtocol::OkStatus:
+      if (dev->responseHeader().contentLength() > 0)
+        return dev->decodeVariant(dev->readBody()); // may throw
+      else
+        dev->discardBody();
+      return QVariant();
+    default:
+      PII_THROW(PiiNetworkException, tr(PiiNetwork::pServerRepliedWithStatus).arg(dev->status()));
+    }
+}
 
-  if (params.size() > 0)
+void PiiRemoteObject::writeRequest(PiiHttpDevice* dev, const QString& uri, const QByteArray& body)
+{
+  if (!body.isEmpty())
     {
-      pDev->setRequest("POST", d->strPath + uri);
-      pDev->startOutputFiltering(new PiiStreamBuffer);
-      try { pDev->write(PiiNetwork::toByteArray(params, PiiNetwork::BinaryFormat)); }
-      catch (...) { finishRequest(pDev); throw; }
+      dev->setRequest("POST", d->strPath + uri);
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      try { dev->write(body); }
+      catch (...) { finishRequest(dev); throw; }
     }
   else
     {
-      pDev->setRequest("GET", d->strPath + uri);
+      dev->setRequest("GET", d->strPath + uri);
     }
+  finishRequest(dev);
+}
 
-  finishRequest(pDev);
+QVariant PiiRemoteObject::callList(const QString& uri, const QVariantList& params)
+{
+  QByteArray aBody;
+  if (params.size() > 0)
+    aBody = PiiNetwork::toByteArray(params, PiiNetwork::BinaryFormat);
+
+  for (int iTry = 0; ; ++iTry)
+    {
+      HttpDevicePtr pDev = openConnection();
+      writeRequest(pDev, uri, aBody);
+
+      PII_THROW_IF_NOT_CONNECTED;
+      if (!pDev->readHeader())
+        {
+          // The server may have closed an idle connection just before
+          // the request was sent. Try once more with a new one.
+          if (pDev.isReusedConnection() && iTry == 0)
+            continue;
+          PII_THROW(PiiNetworkException, tr(PiiNetwork::pErrorReadingResponseHeader));
+        }
+
+      if (pDev->status() == PiiNetwork::RemoteExceptionStatus)
+        handleException(pDev); // throws
+      return decodeResponse(pDev);
+    }
+}
 
-  PII_THROW_IF_NOT_CONNECTED;
-  if (!pDev->readHeader())
-    PII_THROW(PiiNetworkException, tr(PiiNetwork::pErrorReadingResponseHeader));
+PiiRemoteReply PiiRemoteObject::callListAsync(const QString& uri, const QVariantList& params)
+{
+  PiiRemoteReply::Data* pReply = new PiiRemoteReply::Data;
+  PiiRemoteReply reply(pReply);
 
-  switch (pDev->status())
+  // An in-process server in the main thread answers immediately.
+  if (d->pLocalServer &&
+      QThread::currentThread() == qApp->thread())
     {
-    case PiiHttpProtocol::OkStatus:
-      if (pDev->responseHeader().contentLength() > 0)
-        return pDev->decodeVariant(pDev->readBody()); // may throw
-      else
-        pDev->discardBody();
-      return QVariant();
-    case PiiNetwork::RemoteExceptionStatus:
-      handleException(pDev); // throws
-    default:
-      PII_THROW(PiiNetworkException, tr(PiiNetwork::pServerRepliedWithStatus).arg(pDev->status()));
+      try
+        {
+          HttpDevicePtr pDev = openConnection();
+          QByteArray aBody;
+          if (params.size() > 0)
+            aBody = PiiNetwork::toByteArray(params, PiiNetwork::BinaryFormat);
+          writeRequest(pDev, uri, aBody);
+          PiiRemotePipeline::readReply(pDev, pReply);
+        }
+      catch (PiiException& ex)
+        {
+          pReply->setError(ex);
+        }
+      pReply->bFinished = true;
+      return reply;
+    }
+
+  PiiRemotePipeline* pPipeline = d->pPipeline;
+  try
+    {
+      QByteArray aBody;
+      if (params.size() > 0)
+        aBody = PiiNetwork::toByteArray(params, PiiNetwork::BinaryFormat);
+
+      PiiRemotePipelineLocker lock(pPipeline);
+      const QString strAddress = d->networkClient.serverAddress();
+      if (pPipeline->socket == 0 ||
+          !pPipeline->socket.isWritable() ||
+          pPipeline->strServerAddress != strAddress)
+        {
+          pPipeline->failAll(tr("The connection was closed."));
+          pPipeline->closeSocket();
+          pPipeline->socket = takeConnection();
+          pPipeline->strServerAddress = strAddress;
+        }
+      // Don't let the server buffer an unlimited number of responses.
+      while (pPipeline->lstPending.size() >= d->iMaxPipelineDepth)
+        pPipeline->readNext();
+      // readNext() may have dropped a broken connection.
+      if (pPipeline->socket == 0)
+        {
+          pPipeline->socket = takeConnection();
+          pPipeline->strServerAddress = strAddress;
+        }
+
+      PiiHttpDevice* pDev = new PiiHttpDevice(pPipeline->socket, PiiHttpDevice::Client);
+      pDev->setHeader("X-Client-ID", d->strClientId);
+      try
+        {
+          writeRequest(pDev, uri, aBody);
+          PII_THROW_IF_NOT_CONNECTED;
+        }
+      catch (...)
+        {
+          delete pDev;
+          pPipeline->failAll(tr("The connection was closed."));
+          pPipeline->closeSocket();
+          throw;
+        }
+      pPipeline->reserve();
+      pReply->pPipeline = pPipeline;
+      PiiRemotePipeline::PendingCall call = { pDev, pReply };
+      pPipeline->lstPending.enqueue(call);
     }
+  catch (PiiException& ex)
+    {
+      pReply->setError(ex);
+      pReply->bFinished = true;
+    }
+  return reply;
 }
 
+void PiiRemoteObject::setMaxPipelineDepth(int maxPipelineDepth) { d->iMaxPipelineDepth = qMax(1, maxPipelineDepth); }
+int PiiRemoteObject::maxPipelineDepth() const { return d->iMaxPipelineDepth; }
+
 void PiiRemoteObject::setRetryCount(int retryCount) { d->iRetryCount = qBound(0,retryCount,5); }
 int PiiRemoteObject::retryCount() const { return d->iRetryCount; }
 void PiiRemoteObject::setRetryDelay(int retryDelay) { d->iRetryDelay = qBound(0,retryDelay,2000); }
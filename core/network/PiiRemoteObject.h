@@ -18,7 +18,7 @@
 
 #include "PiiNetwork.h"
 #include <PiiPreprocessor.h>
-#include <PiiLockedPtr.h>
+#include <PiiSharedD.h>
 #include <PiiAtomicInt.h>
 
 #include <QVector>
@@ -36,6 +36,88 @@
 #include "PiiHttpDevice.h"
 #include "PiiObjectServer.h"
 
+class PiiRemotePipeline;
+
+/// @hide
+#define PII_CREATE_REMOTE_ASYNC_CALL(N, PARAMS)                          \
+  template <class R, PII_FOR_N_SEP(PII_REMOTE_CALL_TPL_PARAM, PII_COMMA_SEP, N, PARAMS) > \
+  PiiRemoteFuture<R> callAsync(const QString& function                  \
+                               PII_FOR_N(PII_REMOTE_CALL_FUNC_PARAM, N, PARAMS)) \
+  {                                                                     \
+    QVariantList lstParams;                                             \
+    lstParams PII_FOR_N(PII_REMOTE_CALL_LIST_PARAM, N, PARAMS);         \
+    return callListAsync(function, lstParams);                          \
+  }
+/// @endhide
+
+/**
+ * The result of an asynchronous remote function call. See
+ * [PiiRemoteObject::callAsync()]. PiiRemoteReply is explicitly
+ * shared; copies refer to the same call.
+ *
+ * The response of a call is read only when it is needed. Waiting for
+ * a reply reads the responses of all calls that were made before it
+ * on the same connection. A reply can be waited for in any thread.
+ */
+class PII_NETWORK_EXPORT PiiRemoteReply
+{
+public:
+  /**
+   * Constructs a null reply, which is finished and has an invalid
+   * value.
+   */
+  PiiRemoteReply();
+  PiiRemoteReply(const PiiRemoteReply& other);
+  ~PiiRemoteReply();
+  PiiRemoteReply& operator= (const PiiRemoteReply& other);
+
+  /**
+   * Returns `true` if the response of the call has been received.
+   */
+  bool isFinished() const;
+
+  /**
+   * Blocks until the response of the call has been received.
+   */
+  void waitForFinished();
+
+  /**
+   * Waits for the call to finish and returns the return value of the
+   * remote function.
+   *
+   * @exception PiiException& if the remote function throws one. The
+   * type of the exception is preserved as in
+   * [PiiRemoteObject::call()]. Communication errors are reported as
+   * PiiNetworkException.
+   */
+  QVariant value();
+
+private:
+  friend class PiiRemoteObject;
+  friend class PiiRemotePipeline;
+  class Data;
+  Data* d;
+  PiiRemoteReply(Data* data);
+};
+
+/**
+ * A typed version of PiiRemoteReply.
+ */
+template <class R> class PiiRemoteFuture : public PiiRemoteReply
+{
+public:
+  PiiRemoteFuture() {}
+  PiiRemoteFuture(const PiiRemoteReply& other) : PiiRemoteReply(other) {}
+
+  /**
+   * Waits for the call to finish and returns its return value as an
+   * object of type `R`.
+   *
+   * @exception PiiException& see [PiiRemoteReply::value()].
+   */
+  R result() { return PiiNetwork::returnValue<R>(value()); }
+};
+
 /**
  * PiiRemoteObject is a client for PiiObjectServer. It is used to call
  * functions transparently over network. PiiRemoteObject also supports
@@ -61,6 +143,23 @@
  * obj.addCallback("callback", &h, &MyHandler::callback);
  * ~~~
  *
+ * Each call takes a keep-alive connection from
+ * PiiNetworkConnectionPool and returns it once the response has been
+ * read. Remote objects on the same server thus share connections,
+ * and concurrent calls from different threads don't wait for each
+ * other.
+ *
+ * Independent calls can also be made asynchronously. [callAsync()]
+ * writes the request and returns immediately. Successive
+ * asynchronous calls are *pipelined*: their requests are sent over a
+ * single connection without waiting for the responses in between.
+ *
+ * ~~~(c++)
+ * PiiRemoteFuture<int> sum = obj.callAsync<int>("plus", 1, 2);
+ * PiiRemoteFuture<QString> hello = obj.callAsync<QString>("hello");
+ * // Both requests are now on their way.
+ * piiDebug(hello.result() + QString::number(sum.result()));
+ * ~~~
  */
 class PII_NETWORK_EXPORT PiiRemoteObject :
   private PiiProgressController
@@ -203,6 +302,44 @@ public:
 
   QVariant callList(const QString& function, const QVariantList& params);
 
+  /**
+   * @decl template <class R> PiiRemoteFuture<R> callAsync(const QString& function, ...)
+   *
+   * Calls the remote *function* asynchronously. The request is
+   * written immediately, but the function doesn't wait for the
+   * response. At most [maxPipelineDepth()] calls can be waiting for a
+   * response; if the limit is reached, the oldest response will be
+   * read first.
+   *
+   * Calls are sent in the order of `callAsync()` invocations. There
+   * is no ordering guarantee with respect to [call()], which uses a
+   * separate connection.
+   */
+
+  /// @hide
+  template <class R> PiiRemoteFuture<R> callAsync(const QString& function)
+  {
+    return callListAsync(function, QVariantList());
+  }
+  PII_CREATE_REMOTE_ASYNC_CALL(1, (P1))
+  PII_CREATE_REMOTE_ASYNC_CALL(2, (P1,P2))
+  PII_CREATE_REMOTE_ASYNC_CALL(3, (P1,P2,P3))
+  PII_CREATE_REMOTE_ASYNC_CALL(4, (P1,P2,P3,P4))
+  PII_CREATE_REMOTE_ASYNC_CALL(5, (P1,P2,P3,P4,P5))
+  PII_CREATE_REMOTE_ASYNC_CALL(6, (P1,P2,P3,P4,P5,P6))
+  PII_CREATE_REMOTE_ASYNC_CALL(7, (P1,P2,P3,P4,P5,P6,P7))
+  PII_CREATE_REMOTE_ASYNC_CALL(8, (P1,P2,P3,P4,P5,P6,P7,P8))
+  /// @endhide
+
+  PiiRemoteReply callListAsync(const QString& function, const QVariantList& params);
+
+  /**
+   * Sets the maximum number of asynchronous calls waiting for a
+   * response. The default value is 8.
+   */
+  void setMaxPipelineDepth(int maxPipelineDepth);
+  int maxPipelineDepth() const;
+
   /**
    * Returns the number of failures in remote calls since construction
    * or last reset. The count is incremented each time a remote
@@ -234,6 +371,8 @@ protected:
     PiiNetworkClient networkClient;
     QMutex deviceMutex; // Must be held when accessing pHttpDevice
     PiiHttpDevice* pHttpDevice;
+    PiiRemotePipeline* pPipeline;
+    int iMaxPipelineDepth;
     QString strPath;
     QList<QPair<QString,PiiGenericFunction*> > lstCallbacks;
 
@@ -257,7 +396,48 @@ protected:
   /// @internal
   PiiRemoteObject(Data*, const QString&);
 
-  typedef PiiLockedPtr<PiiHttpDevice> HttpDevicePtr;
+  /**
+   * A pointer to the HTTP device of a single request. If the
+   * connection comes from PiiNetworkConnectionPool, the device is
+   * deleted with the last copy of the pointer. The connection goes
+   * back to the pool if the whole response has been read. Otherwise
+   * the pointer holds a lock to the device of an in-process
+   * connection.
+   *
+   * @internal
+   */
+  class PII_NETWORK_EXPORT HttpDevicePtr
+  {
+  public:
+    HttpDevicePtr(const HttpDevicePtr& other);
+    ~HttpDevicePtr();
+    HttpDevicePtr& operator= (const HttpDevicePtr& other);
+
+    operator PiiHttpDevice* () const;
+    PiiHttpDevice* operator-> () const;
+
+    /**
+     * Returns `true` if the connection was idle in the pool before
+     * this request.
+     */
+    bool isReusedConnection() const;
+
+  private:
+    friend class PiiRemoteObject;
+    HttpDevicePtr(QMutex* mutex, PiiHttpDevice* device);
+    HttpDevicePtr(PiiHttpDevice* device, const QString& serverAddress, bool reused);
+
+    class Data : public PiiSharedD<Data>
+    {
+    public:
+      Data(QMutex* mutex, PiiHttpDevice* device, const QString& serverAddress, bool reused);
+      ~Data();
+      QMutex* pMutex;
+      PiiHttpDevice* pDevice;
+      QString strServerAddress;
+      bool bReused;
+    } *d;
+  };
 
   /**
    * Adds the given *sourceId* to the resources pushed from the
@@ -297,16 +477,16 @@ protected:
   /**
    * Tries [retryCount()] times to open a connection to [serverUri()].
    * Returns an exclusive pointer to a connected HTTP device.
-   * PiiRemoteObject owns the returned pointer.
+   * The device is valid as long as the returned pointer exists.
    *
    * @exception PiiNetworkException& if the connection cannot be
    * established.
    */
   HttpDevicePtr openConnection();
   /**
-   * Closes the connection. There is usually no need to call this
-   * function in normal operation, but it may be useful in recovering
-   * from errors.
+   * Closes the connection and all idle pooled connections to the
+   * server. There is usually no need to call this function in normal
+   * operation, but it may be useful in recovering from errors.
    */
   void closeConnection();
 
@@ -321,6 +501,8 @@ protected:
   virtual void serverUriChanged(const QString& strNewUri);
 
 private:
+  friend class PiiRemotePipeline;
+  friend class PiiRemoteReply;
   inline static QString tr(const char* s) { return QCoreApplication::translate("PiiRemoteObject", s); }
 
   void manageChannel(const QString& operation, const QString& sourceId);
@@ -333,7 +515,11 @@ private:
   bool checkChannelResponse(PiiHttpDevice& dev);
   bool canContinue(double progressPercentage) const;
   void setServerUriImpl(const QString& uri);
-  void handleException(PiiHttpDevice* dev);
+  static void handleException(PiiHttpDevice* dev);
+  static void throwRemoteException(const QByteArray& data);
+  static QVariant decodeResponse(PiiHttpDevice* dev);
+  void writeRequest(PiiHttpDevice* dev, const QString& uri, const QByteArray& body);
+  PiiSocketDevice takeConnection(bool* reused = 0);
 };
 
 
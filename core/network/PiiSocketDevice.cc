@@ -16,10 +16,17 @@
 #include "PiiSocketDevice.h"
 
 #include "PiiProgressController.h"
+#include "PiiNetworkRequestDevice.h"
 
 #include <QAbstractSocket>
 #include <QLocalSocket>
 
+#ifdef Q_OS_LINUX
+#  include <sys/sendfile.h>
+#  include <poll.h>
+#  include <errno.h>
+#endif
+
 PiiSocketDevice::Data::Data() :
   pDevice(0),
   type(IODevice)
@@ -46,6 +53,8 @@ PiiSocketDevice::Type PiiSocketDevice::typeOf(QIODevice* device)
     return AbstractSocket;
   else if (qobject_cast<QLocalSocket*>(device) != 0)
     return LocalSocket;
+  else if (qobject_cast<PiiNetworkRequestDevice*>(device) != 0)
+    return RequestDevice;
   return IODevice;
 }
 
@@ -104,6 +113,8 @@ bool PiiSocketDevice::isReadable() const
     case LocalSocket:
       return static_cast<QLocalSocket*>(d->pDevice)->state() == QLocalSocket::ConnectedState ||
         d->pDevice->bytesAvailable() > 0;
+    case RequestDevice:
+      return static_cast<PiiNetworkRequestDevice*>(d->pDevice)->isReadable();
     case IODevice:
     default:
       return d->pDevice->openMode() & QIODevice::ReadOnly;
@@ -119,6 +130,8 @@ bool PiiSocketDevice::isWritable() const
       return static_cast<QAbstractSocket*>(d->pDevice)->state() == QAbstractSocket::ConnectedState;
     case LocalSocket:
       return static_cast<QLocalSocket*>(d->pDevice)->state() == QLocalSocket::ConnectedState;
+    case RequestDevice:
+      return static_cast<PiiNetworkRequestDevice*>(d->pDevice)->isWritable();
     case IODevice:
     default:
       return d->pDevice->openMode() & QIODevice::WriteOnly;
@@ -212,6 +225,77 @@ qint64 PiiSocketDevice::writeWaited(const char* data, qint64 maxSize, int waitTi
   return iBytesWritten;
 }
 
+PiiNetwork::SocketDescriptorType PiiSocketDevice::socketDescriptor() const
+{
+  if (d->pDevice == 0) return -1;
+  switch (d->type)
+    {
+    case AbstractSocket:
+      return static_cast<QAbstractSocket*>(d->pDevice)->socketDescriptor();
+    case LocalSocket:
+      return PiiNetwork::SocketDescriptorType(static_cast<QLocalSocket*>(d->pDevice)->socketDescriptor());
+    default:
+      return -1;
+    }
+}
+
+qint64 PiiSocketDevice::sendFile(int fileDescriptor, qint64 offset, qint64 length,
+                                 int waitTime, PiiProgressController* controller)
+{
+#ifdef Q_OS_LINUX
+  // Bypassing an SSL socket would send plain text.
+  if (d->pDevice == 0 || d->pDevice->inherits("QSslSocket"))
+    return -1;
+  const int iSocket = int(socketDescriptor());
+  if (iSocket == -1)
+    return -1;
+
+  // Whatever was written through QIODevice must go out first.
+  while (d->pDevice->bytesToWrite() > 0)
+    if (!waitForDataWritten(waitTime, controller))
+      return 0;
+
+  off_t iOffset = off_t(offset);
+  qint64 iBytesLeft = length;
+  PiiTimer timer;
+  while (iBytesLeft > 0)
+    {
+      ssize_t iBytesSent = ::sendfile(iSocket, fileDescriptor, &iOffset,
+                                      size_t(qMin(iBytesLeft, qint64(1 << 30))));
+      if (iBytesSent > 0)
+        {
+          iBytesLeft -= iBytesSent;
+          timer.restart();
+        }
+      else if (iBytesSent == 0) // The file was truncated.
+        break;
+      else if (errno == EAGAIN || errno == EINTR)
+        {
+          // Qt sockets are non-blocking. Wait until the kernel buffer
+          // has room again.
+          if (!isWritable() ||
+              (controller != 0 && !controller->canContinue()) ||
+              timer.milliseconds() >= waitTime)
+            break;
+          pollfd fd = { iSocket, POLLOUT, 0 };
+          ::poll(&fd, 1, qMin(waitTime, 100));
+        }
+      else if (iBytesLeft == length && (errno == EINVAL || errno == ENOSYS))
+        return -1; // This descriptor pair doesn't support sendfile().
+      else
+        break;
+    }
+  return length - iBytesLeft;
+#else
+  Q_UNUSED(fileDescriptor);
+  Q_UNUSED(offset);
+  Q_UNUSED(length);
+  Q_UNUSED(waitTime);
+  Q_UNUSED(controller);
+  return -1;
+#endif
+}
+
 bool PiiSocketDevice::waitForConnected(int waitTime)
 {
   if (d->pDevice == 0) return false;
@@ -231,6 +315,7 @@ bool PiiSocketDevice::waitForConnected(int waitTime)
           pSocket->waitForConnected(waitTime);
       }
     case IODevice:
+    case RequestDevice:
       break;
     }
   return true;
@@ -247,6 +332,7 @@ void PiiSocketDevice::disconnect()
       static_cast<QLocalSocket*>(d->pDevice)->disconnectFromServer();
       break;
     case IODevice:
+    case RequestDevice:
       break;
     }
 }
@@ -268,6 +354,7 @@ bool PiiSocketDevice::waitForDisconnected(int waitTime)
           pSocket->waitForDisconnected(waitTime);
       }
     case IODevice:
+    case RequestDevice:
       break;
     }
   return true;
@@ -58,7 +58,8 @@ public:
   /**
    * Constructs a PiiSocketDevice that wraps the given *device*. The
    * type of the device will be automatically determined. All Qt
-   * socket types are recognized.
+   * socket types and the request devices of an event-driven
+   * PiiNetworkServer are recognized.
    */
   PiiSocketDevice(QIODevice* device);
   /**
@@ -106,6 +107,31 @@ public:
    */
   qint64 writeWaited(const char* data, qint64 maxSize, int waitTime = 5000, PiiProgressController* controller = 0);
 
+  /**
+   * Sends *length* bytes starting at *offset* from the file
+   * identified by *fileDescriptor* to the socket without copying the
+   * data through user space. Data already buffered in the socket is
+   * flushed first. If all data cannot be immediately sent, waits at
+   * most *waitTime* milliseconds for more room. If *controller* is
+   * given, it can be used to terminate a long wait.
+   *
+   * Zero-copy transmission is implemented with `sendfile()` on
+   * Linux. It is not available for encrypted sockets and devices
+   * with no native descriptor.
+   *
+   * @return the number of bytes sent, or -1 if zero-copy
+   * transmission is not possible. In the latter case nothing has been
+   * sent, and the caller should fall back to [writeWaited()].
+   */
+  qint64 sendFile(int fileDescriptor, qint64 offset, qint64 length,
+                  int waitTime = 5000, PiiProgressController* controller = 0);
+
+  /**
+   * Returns the native descriptor of the socket, or -1 if the device
+   * is not a socket.
+   */
+  PiiNetwork::SocketDescriptorType socketDescriptor() const;
+
   bool waitForConnected(int waitTime);
 
   /**
@@ -120,7 +146,7 @@ public:
   QIODevice* operator-> () const;
 
 private:
-  enum Type { IODevice, AbstractSocket, LocalSocket };
+  enum Type { IODevice, AbstractSocket, LocalSocket, RequestDevice };
   class Data : public PiiSharedD<Data>
   {
   public:
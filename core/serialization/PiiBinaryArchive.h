@@ -18,6 +18,55 @@
 
 #define PII_BINARY_ARCHIVE_ID "Into Bin"
 #define PII_BINARY_ARCHIVE_ID_LEN 8
-#define PII_BINARY_ARCHIVE_VERSION 0
+#define PII_BINARY_ARCHIVE_VERSION 2
+
+#include <QtGlobal>
+#include <cstring>
+
+/// @internal
+/// Raw data blocks of at least this many bytes are aligned (version 1).
+#define PII_BINARY_ARCHIVE_BLOCK_THRESHOLD 4096
+/// @internal
+#define PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT 64
+/// @internal
+/// The size of the I/O buffer of binary archives.
+#define PII_BINARY_ARCHIVE_BUFFER_SIZE 65536
+
+/// @internal
+/// Primitive operators for binary archives. Version 2 stores
+/// primitives in little-endian byte order with no conversions.
+#define PII_BINARY_PRIMITIVE_OPERATORS(Archive, dir, ref, func)        \
+  Archive& operator dir (short ref value) { func(value); return *this; } \
+  Archive& operator dir (int ref value) { func(value); return *this; }  \
+  Archive& operator dir (long long ref value) { func(value); return *this; } \
+  Archive& operator dir (unsigned short ref value) { func(value); return *this; } \
+  Archive& operator dir (unsigned int ref value) { func(value); return *this; } \
+  Archive& operator dir (unsigned long long ref value) { func(value); return *this; } \
+  Archive& operator dir (float ref value) { func(value); return *this; } \
+  Archive& operator dir (double ref value) { func(value); return *this; } \
+  Archive& operator dir (char ref value) { func(value); return *this; } \
+  Archive& operator dir (signed char ref value) { func(value); return *this; } \
+  Archive& operator dir (unsigned char ref value) { func(value); return *this; } \
+  Archive& operator dir (bool ref value) { return operator dir ((unsigned char ref) value); } \
+  Archive& operator dir (long ref value) { return operator dir ((int ref) value); } \
+  Archive& operator dir (unsigned long ref value) { return operator dir ((unsigned int ref) value); }
+
+namespace PiiSerialization
+{
+  /// @internal
+  /// Converts *value* from native to little-endian byte order or
+  /// vice versa.
+  template <class T> inline T swapToLittleEndian(T value)
+  {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    char aBytes[sizeof(T)];
+    std::memcpy(aBytes, &value, sizeof(T));
+    for (unsigned i=0; i<sizeof(T)/2; ++i)
+      qSwap(aBytes[i], aBytes[sizeof(T)-1-i]);
+    std::memcpy(&value, aBytes, sizeof(T));
+#endif
+    return value;
+  }
+}
 
 #endif //_PIIBINARYARCHIVE_H
@@ -14,11 +14,20 @@
  */
 
 #include "PiiBinaryInputArchive.h"
+#include <PiiMappedFile.h>
+#include <QFile>
 
 PII_DEFINE_SERIALIZER(PiiBinaryInputArchive);
 PII_DEFINE_FACTORY_MAP(PiiBinaryInputArchive);
 
-PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) : QDataStream(d)
+PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) :
+  QDataStream(d),
+  _pMappedFile(0),
+  _bMappingFailed(false),
+  _bLegacyFormat(true),
+  _pBuffer(0),
+  _iBufferedBytes(0),
+  _iBufferPos(0)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
@@ -30,7 +39,8 @@ PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) : QDataStream(d)
   if (std::strncmp(id, PII_BINARY_ARCHIVE_ID, PII_BINARY_ARCHIVE_ID_LEN))
     PII_SERIALIZATION_ERROR(UnrecognizedArchiveFormat);
 
-  // Read and verify major and minor version
+  // Read and verify major and minor version. The version numbers
+  // are always big-endian.
   int iVersion;
   *this >> iVersion;
   if (iVersion > PII_ARCHIVE_VERSION)
@@ -40,14 +50,117 @@ PiiBinaryInputArchive::PiiBinaryInputArchive(QIODevice* d) : QDataStream(d)
   if (iVersion > PII_BINARY_ARCHIVE_VERSION)
     PII_SERIALIZATION_ERROR(ArchiveVersionMismatch);
   setMinorVersion(iVersion);
+
+  _bLegacyFormat = iVersion < 2;
+  // Reading ahead is possible only if the extra data can be put
+  // back.
+  if (!_bLegacyFormat && !d->isSequential())
+    _pBuffer = new char[PII_BINARY_ARCHIVE_BUFFER_SIZE];
+}
+
+PiiBinaryInputArchive::~PiiBinaryInputArchive()
+{
+  // Leave the device at the end of the data actually read.
+  if (_iBufferPos < _iBufferedBytes)
+    device()->seek(position());
+  delete[] _pBuffer;
+  if (_pMappedFile != 0)
+    _pMappedFile->release();
+}
+
+qint64 PiiBinaryInputArchive::position() const
+{
+  return device()->pos() - (_iBufferedBytes - _iBufferPos);
+}
+
+void PiiBinaryInputArchive::dropBuffer()
+{
+  _iBufferedBytes = _iBufferPos = 0;
 }
 
-void PiiBinaryInputArchive::readRawData(void* ptr, unsigned int size)
+void PiiBinaryInputArchive::readFromDevice(char* ptr, qint64 size)
 {
-  if (QDataStream::readRawData(static_cast<char*>(ptr), size) != int(size))
+  if (device()->read(ptr, size) != size)
     PII_SERIALIZATION_ERROR(StreamError);
 }
 
+void PiiBinaryInputArchive::readLargeData(void* ptr, unsigned int size)
+{
+  char* pTarget = static_cast<char*>(ptr);
+  // Take what is left in the buffer.
+  const int iBuffered = _iBufferedBytes - _iBufferPos;
+  if (iBuffered > 0)
+    {
+      std::memcpy(pTarget, _pBuffer + _iBufferPos, iBuffered);
+      pTarget += iBuffered;
+      size -= iBuffered;
+    }
+  dropBuffer();
+
+  // Large blocks are read directly, small ones through the buffer.
+  if (_pBuffer == 0 || size >= unsigned(PII_BINARY_ARCHIVE_BUFFER_SIZE/2))
+    {
+      readFromDevice(pTarget, size);
+      return;
+    }
+  qint64 iBytesRead = device()->read(_pBuffer, PII_BINARY_ARCHIVE_BUFFER_SIZE);
+  if (iBytesRead < qint64(size))
+    {
+      if (iBytesRead > 0)
+        device()->seek(device()->pos() - iBytesRead);
+      PII_SERIALIZATION_ERROR(StreamError);
+    }
+  _iBufferedBytes = int(iBytesRead);
+  std::memcpy(pTarget, _pBuffer, size);
+  _iBufferPos = size;
+}
+
+void PiiBinaryInputArchive::startRawBlock(unsigned int size)
+{
+  if (minorVersion() < 1 || size < PII_BINARY_ARCHIVE_BLOCK_THRESHOLD)
+    return;
+  unsigned char ucPadding;
+  *this >> ucPadding;
+  if (ucPadding >= PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT)
+    PII_SERIALIZATION_ERROR(InvalidDataFormat);
+  char aPadding[PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT];
+  readRawData(aPadding, ucPadding);
+}
+
+void* PiiBinaryInputArchive::mapRawBlock(unsigned int size, PiiMappedFile** file)
+{
+  if (minorVersion() < 1 || size < PII_BINARY_ARCHIVE_BLOCK_THRESHOLD)
+    return 0;
+  if (_pMappedFile == 0)
+    {
+      if (_bMappingFailed)
+        return 0;
+      QFile* pFile = qobject_cast<QFile*>(device());
+      if (pFile != 0 && !pFile->isSequential())
+        _pMappedFile = PiiMappedFile::map(pFile->handle());
+      if (_pMappedFile == 0)
+        {
+          _bMappingFailed = true;
+          return 0;
+        }
+    }
+
+  qint64 iPos = position();
+  char* pBlock = _pMappedFile->data() + iPos;
+  // The block may be misplaced if the archive was not written
+  // directly into a file.
+  if (iPos + size > qint64(_pMappedFile->size()) ||
+      reinterpret_cast<std::size_t>(pBlock) % PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT != 0)
+    return 0;
+  dropBuffer();
+  if (!device()->seek(iPos + size))
+    PII_SERIALIZATION_ERROR(StreamError);
+
+  _pMappedFile->reserve();
+  *file = _pMappedFile;
+  return pBlock;
+}
+
 PiiBinaryInputArchive& PiiBinaryInputArchive::operator>> (QString& value)
 {
   // Read the raw bytes
@@ -23,10 +23,16 @@
 #include "PiiArchiveMacros.h"
 #include "PiiBinaryArchive.h"
 
+class PiiMappedFile;
+
 /**
  * PiiBinaryInputArchive reads raw binary data. The binary format is
  * platform-dependent.
  *
+ * If the input device supports random access, data is read ahead in
+ * large blocks. The device is positioned right after the archived
+ * data once the archive is destroyed. Archives written before
+ * version 2 of the binary format are read through QDataStream.
  */
 class PII_SERIALIZATION_EXPORT PiiBinaryInputArchive :
   public PiiInputArchive<PiiBinaryInputArchive>,
@@ -42,23 +48,67 @@ public:
    * or it cannot be read from, or the archive format is unknown
    */
   PiiBinaryInputArchive(QIODevice* d);
+  ~PiiBinaryInputArchive();
+
+  void readRawData(void* ptr, unsigned int size)
+  {
+    if (size <= unsigned(_iBufferedBytes - _iBufferPos))
+      {
+        std::memcpy(ptr, _pBuffer + _iBufferPos, size);
+        _iBufferPos += size;
+      }
+    else
+      readLargeData(ptr, size);
+  }
+
+  /**
+   * Skips the padding written by PiiBinaryOutputArchive::startRawBlock().
+   */
+  void startRawBlock(unsigned int size);
 
-  void readRawData(void* ptr, unsigned int size);
+  /**
+   * Maps an aligned block of raw data directly from the archive file.
+   * This is possible if the input device is a QFile that can be
+   * memory mapped. The whole file will be mapped once, on the first
+   * call. The mapping stays valid even after the archive and the
+   * file have been destroyed, as long as references to it exist.
+   */
+  void* mapRawBlock(unsigned int size, PiiMappedFile** file);
 
   PiiBinaryInputArchive& operator>> (QString& value);
 
   PiiBinaryInputArchive& operator>> (char*& value);
 
-  PiiBinaryInputArchive& operator>> (char& value) { return operator>> ((signed char&)value); }
-  PiiBinaryInputArchive& operator>> (unsigned char& value) { QDataStream::operator>>(value); return *this; }
-
-  PII_PRIMITIVE_INPUT_OPERATORS(PiiBinaryInputArchive, QDataStream)
-  PII_PRIMITIVE_OPERATOR(PiiBinaryInputArchive, signed char, QDataStream, >>, &)
+  PII_BINARY_PRIMITIVE_OPERATORS(PiiBinaryInputArchive, >>, &, readPrimitive)
   PII_DEFAULT_INPUT_OPERATORS(PiiBinaryInputArchive)
 
 protected:
   void startDelim() {}
   void endDelim() {}
+
+private:
+  template <class T> void readPrimitive(T& value)
+  {
+    if (_bLegacyFormat)
+      QDataStream::operator>> (value);
+    else
+      {
+        readRawData(&value, sizeof(T));
+        value = PiiSerialization::swapToLittleEndian(value);
+      }
+  }
+  // QDataStream has no operator for plain char.
+  void readPrimitive(char& value) { readPrimitive(reinterpret_cast<signed char&>(value)); }
+  void readLargeData(void* ptr, unsigned int size);
+  void readFromDevice(char* ptr, qint64 size);
+  qint64 position() const;
+  void dropBuffer();
+
+  PiiMappedFile* _pMappedFile;
+  bool _bMappingFailed;
+  bool _bLegacyFormat;
+  char* _pBuffer;
+  int _iBufferedBytes, _iBufferPos;
 };
 
 PII_DECLARE_SERIALIZER(PiiBinaryInputArchive);
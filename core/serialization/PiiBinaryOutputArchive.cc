@@ -14,11 +14,15 @@
  */
 
 #include "PiiBinaryOutputArchive.h"
+#include <QtEndian>
 
 PII_DEFINE_SERIALIZER(PiiBinaryOutputArchive);
 PII_DEFINE_FACTORY_MAP(PiiBinaryOutputArchive);
 
-PiiBinaryOutputArchive::PiiBinaryOutputArchive(QIODevice* d) : QDataStream(d)
+PiiBinaryOutputArchive::PiiBinaryOutputArchive(QIODevice* d) :
+  _pDevice(d),
+  _pBuffer(0),
+  _iBufferedBytes(0)
 {
   if (!d->isOpen())
     PII_SERIALIZATION_ERROR(StreamNotOpen);
@@ -27,18 +31,68 @@ PiiBinaryOutputArchive::PiiBinaryOutputArchive(QIODevice* d) : QDataStream(d)
   if (d->write(PII_BINARY_ARCHIVE_ID, PII_BINARY_ARCHIVE_ID_LEN) != PII_BINARY_ARCHIVE_ID_LEN)
     PII_SERIALIZATION_ERROR(StreamError);
 
-  // Store archive version
-  *this << PII_ARCHIVE_VERSION;
-  *this << PII_BINARY_ARCHIVE_VERSION;
+  // Store archive version. The version numbers are big-endian as
+  // in version 0 so that old readers can reject the archive.
+  const quint32 aVersions[2] = { qToBigEndian(quint32(PII_ARCHIVE_VERSION)),
+                                 qToBigEndian(quint32(PII_BINARY_ARCHIVE_VERSION)) };
+  writeToDevice(reinterpret_cast<const char*>(aVersions), sizeof(aVersions));
+
+  _pBuffer = new char[PII_BINARY_ARCHIVE_BUFFER_SIZE];
+}
+
+PiiBinaryOutputArchive::~PiiBinaryOutputArchive()
+{
+  try
+    {
+      flush();
+    }
+  catch (PiiSerializationException&)
+    {}
+  delete[] _pBuffer;
 }
 
-void PiiBinaryOutputArchive::writeRawData(const void* ptr, unsigned int size)
+void PiiBinaryOutputArchive::writeToDevice(const char* ptr, qint64 size)
 {
-  // Store bytes
-  if (QDataStream::writeRawData(reinterpret_cast<const char*>(ptr), size) != int(size))
+  if (_pDevice->write(ptr, size) != size)
     PII_SERIALIZATION_ERROR(StreamError);
 }
 
+void PiiBinaryOutputArchive::flush()
+{
+  if (_iBufferedBytes == 0)
+    return;
+  const int iBytes = _iBufferedBytes;
+  _iBufferedBytes = 0;
+  writeToDevice(_pBuffer, iBytes);
+}
+
+void PiiBinaryOutputArchive::writeLargeData(const void* ptr, unsigned int size)
+{
+  flush();
+  // Blocks that don't fit into the buffer go directly to the device.
+  if (size >= unsigned(PII_BINARY_ARCHIVE_BUFFER_SIZE))
+    writeToDevice(static_cast<const char*>(ptr), size);
+  else
+    {
+      std::memcpy(_pBuffer, ptr, size);
+      _iBufferedBytes = size;
+    }
+}
+
+void PiiBinaryOutputArchive::startRawBlock(unsigned int size)
+{
+  if (size < PII_BINARY_ARCHIVE_BLOCK_THRESHOLD)
+    return;
+  static const char aZeros[PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT] = { 0 };
+  // The padding starts after the byte that stores its length.
+  qint64 iPos = _pDevice->pos() + _iBufferedBytes + 1;
+  unsigned char ucPadding = (unsigned char)((PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT -
+                                             iPos % PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT) %
+                                            PII_BINARY_ARCHIVE_BLOCK_ALIGNMENT);
+  *this << ucPadding;
+  writeRawData(aZeros, ucPadding);
+}
+
 PiiBinaryOutputArchive& PiiBinaryOutputArchive::operator<< (const QString& value)
 {
   QByteArray utf8Data = value.toUtf8();
@@ -16,7 +16,7 @@
 #ifndef _PIIBINARYOUTPUTARCHIVE_H
 #define _PIIBINARYOUTPUTARCHIVE_H
 
-#include <QDataStream>
+#include <QIODevice>
 #include <cstring>
 #include "PiiArchive.h"
 #include "PiiOutputArchive.h"
@@ -25,13 +25,26 @@
 
 /**
  * Binary output archive stores data in a raw binary format. The
- * binary format is platform-dependent.
+ * binary format is platform-dependent: primitive types are stored in
+ * little-endian byte order, but raw data blocks (such as matrix rows)
+ * are copied as such.
  *
+ * Data is collected into a buffer and written to the output device
+ * in large blocks. The buffer is flushed when the archive is
+ * destroyed. If the device is needed while the archive still exists,
+ * call [flush()] first.
+ *
+ * ~~~(c++)
+ * QFile file("data.bin");
+ * file.open(QIODevice::WriteOnly);
+ * PiiBinaryOutputArchive oa(&file);
+ * oa << matrix;
+ * oa.flush(); // reports write errors
+ * ~~~
  */
 class PII_SERIALIZATION_EXPORT PiiBinaryOutputArchive :
   public PiiOutputArchive<PiiBinaryOutputArchive>,
-  public PiiArchive,
-  private QDataStream
+  public PiiArchive
 {
 public:
   /**
@@ -43,19 +56,68 @@ public:
    */
   PiiBinaryOutputArchive(QIODevice* d);
 
-  void writeRawData(const void* ptr, unsigned int size);
+  /**
+   * Writes buffered data to the device. Errors are ignored. Use
+   * [flush()] to detect them.
+   */
+  ~PiiBinaryOutputArchive();
+
+  void writeRawData(const void* ptr, unsigned int size)
+  {
+    if (size <= unsigned(PII_BINARY_ARCHIVE_BUFFER_SIZE - _iBufferedBytes))
+      {
+        std::memcpy(_pBuffer + _iBufferedBytes, ptr, size);
+        _iBufferedBytes += size;
+      }
+    else
+      writeLargeData(ptr, size);
+  }
+
+  /**
+   * Writes buffered data to the output device.
+   *
+   * @exception PiiSerializationException& if the data cannot be
+   * written.
+   */
+  void flush();
+
+  /**
+   * Returns the output device.
+   */
+  QIODevice* device() const { return _pDevice; }
+
+  /**
+   * Aligns blocks of at least [PII_BINARY_ARCHIVE_BLOCK_THRESHOLD]
+   * bytes to a 64-byte boundary in the output. The amount of padding
+   * is written to the archive so that the block can be found even if
+   * the output device reports no position.
+   */
+  void startRawBlock(unsigned int size);
 
   PiiBinaryOutputArchive& operator<< (const QString& value);
   PiiBinaryOutputArchive& operator<< (const char* value);
 
-  PII_PRIMITIVE_OUTPUT_OPERATORS(PiiBinaryOutputArchive, QDataStream)
-  PII_PRIMITIVE_OPERATOR(PiiBinaryOutputArchive, char, QDataStream, <<, )
-  PII_PRIMITIVE_OPERATOR(PiiBinaryOutputArchive, unsigned char, QDataStream, <<, )
+  PII_BINARY_PRIMITIVE_OPERATORS(PiiBinaryOutputArchive, <<, , writePrimitive)
   PII_DEFAULT_OUTPUT_OPERATORS(PiiBinaryOutputArchive)
 
 protected:
   void startDelim() {}
   void endDelim() {}
+
+private:
+  template <class T> void writePrimitive(T value)
+  {
+    value = PiiSerialization::swapToLittleEndian(value);
+    writeRawData(&value, sizeof(T));
+  }
+  void writeLargeData(const void* ptr, unsigned int size);
+  void writeToDevice(const char* ptr, qint64 size);
+
+  QIODevice* _pDevice;
+  char* _pBuffer;
+  int _iBufferedBytes;
+
+  PII_DISABLE_COPY(PiiBinaryOutputArchive);
 };
 
 PII_DECLARE_SERIALIZER(PiiBinaryOutputArchive);
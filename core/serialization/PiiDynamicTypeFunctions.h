@@ -120,16 +120,9 @@ template <class T, class Archive> T* PiiSerializationFactory::create(const char*
 {
   if (PiiSerialization::isDynamicType((T*)0))
     {
-      // Try archive-specific factory first
-      PiiSerializationFactory* pFactory = factory<Archive>(className);
+      PiiSerializationFactory* pFactory = resolveFactory<Archive>(className);
       if (pFactory == 0)
-        {
-          // If this is already the default factory, fail
-          if (Pii::IsSame<Archive, PiiSerialization::Void>::boolValue ||
-              // Otherwise try the default factory
-              (pFactory = factory<PiiSerialization::Void>(className)) == 0)
-            return 0;
-        }
+        return 0;
       return reinterpret_cast<T*>(pFactory->create(&archive));
     }
   return create<T>(archive);
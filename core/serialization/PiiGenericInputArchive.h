@@ -54,6 +54,8 @@ public:
   virtual PiiGenericInputArchive& operator>>(char*& value) = 0;
   virtual PiiGenericInputArchive& operator>>(QString& value) = 0;
   virtual void readRawData(void* ptr, unsigned int size) = 0;
+  virtual void startRawBlock(unsigned int size) = 0;
+  virtual void* mapRawBlock(unsigned int size, PiiMappedFile** file) = 0;
 
   PII_DEFAULT_INPUT_OPERATORS(PiiGenericInputArchive)
 private:
@@ -100,6 +102,8 @@ public:
   PII_STREAM_OP(QString&)
 #undef PII_STREAM_OP
   virtual void readRawData(void* ptr, unsigned int size) { Archive::readRawData(ptr, size); }
+  virtual void startRawBlock(unsigned int size) { Archive::startRawBlock(size); }
+  virtual void* mapRawBlock(unsigned int size, PiiMappedFile** file) { return Archive::mapRawBlock(size, file); }
 
   PII_DEFAULT_INPUT_OPERATORS(PiiGenericInputArchive)
 
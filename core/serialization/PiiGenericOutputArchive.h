@@ -55,6 +55,7 @@ public:
   virtual PiiGenericOutputArchive& operator<<(const char* value) = 0;
   virtual PiiGenericOutputArchive& operator<<(const QString& value) = 0;
   virtual void writeRawData(const void* ptr, unsigned int size) = 0;
+  virtual void startRawBlock(unsigned int size) = 0;
 
   PII_DEFAULT_OUTPUT_OPERATORS(PiiGenericOutputArchive)
 
@@ -102,6 +103,7 @@ public:
   PII_STREAM_OP(const QString&)
 #undef PII_STREAM_OP
   virtual void writeRawData(const void* ptr, unsigned int size) { Archive::writeRawData(ptr, size); }
+  virtual void startRawBlock(unsigned int size) { Archive::startRawBlock(size); }
 
   PII_DEFAULT_OUTPUT_OPERATORS(PiiGenericOutputArchive)
 
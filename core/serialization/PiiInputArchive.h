@@ -17,6 +17,8 @@
 #define _PIIINPUTARCHIVE_H
 
 #include <QList>
+#include <QHash>
+#include <QByteArray>
 #include <cstring>
 #include <PiiMetaTemplate.h>
 #include "PiiTypeTraits.h"
@@ -28,6 +30,8 @@
 #include "PiiSmartPtr.h"
 #include "PiiDynamicTypeFunctions.h"
 
+class PiiMappedFile;
+
 /// @internal
 struct PiiArchivePointerInfo
 {
@@ -133,6 +137,24 @@ public:
       ptr = 0;
   }
 
+  /**
+   * Prepares the archive for reading a contiguous block of raw data
+   * whose size is *size* bytes. Must be called before reading a
+   * block that was stored after PiiOutputArchive::startRawBlock().
+   * The default implementation does nothing.
+   */
+  void startRawBlock(unsigned int /*size*/) {}
+
+  /**
+   * Returns a pointer to a raw data block of *size* bytes in a memory
+   * mapping of the archive file and skips the block in the input. If
+   * a mapping is returned, a reference to it will be stored to
+   * *file*; the caller must release it. If the block cannot be
+   * mapped, 0 will be returned and the block must be read with
+   * readRawData(). The default implementation always returns 0.
+   */
+  void* mapRawBlock(unsigned int /*size*/, PiiMappedFile** /*file*/) { return 0; }
+
   /**
    * Analogous to PiiOutputArchive::operator<<(T&). This function
    * calls Archive::load(value).
@@ -297,10 +319,46 @@ private:
       ::loadPointer(*self(), name, value, tracked);
   }
 
+  // The factory and the serializer of a dynamic type resolved by
+  // this archive.
+  struct ClassInfo
+  {
+    ClassInfo() : pFactory(0), pSerializer(0) {}
+    PiiSerializationFactory* pFactory;
+    const PiiSerializer<Archive>* pSerializer;
+  };
+
+  /* Returns the factory and the serializer for the named class. The
+     registries are only consulted once per class name and archive.
+     Archives typically contain many instances of few classes.
+   */
+  ClassInfo classInfo(const char* name, bool needFactory)
+  {
+    typename QHash<QByteArray,ClassInfo>::iterator i = _hashClasses.find(QByteArray::fromRawData(name, int(std::strlen(name))));
+    if (i == _hashClasses.end())
+      i = _hashClasses.insert(QByteArray(name), ClassInfo());
+    ClassInfo& info = i.value();
+    // Missing entries are looked up again because the resolver may
+    // load a plug-in that registers the class later.
+    if (needFactory && info.pFactory == 0)
+      info.pFactory = PiiSerializationFactory::resolveFactory<Archive>(name);
+    if (info.pSerializer == 0)
+      info.pSerializer = PiiSerializer<Archive>::serializer(name);
+    return info;
+  }
+
   template <class T> void loadComplexPointer(const char* name, T*& value, bool tracked = false)
   {
+    const bool bDynamic = PiiSerialization::isDynamicType((T*)0);
+    ClassInfo info;
     // Create an instance of the named class
-    value = PiiSerializationFactory::create<T>(name, *self());
+    if (bDynamic)
+      {
+        info = classInfo(name, true);
+        value = info.pFactory != 0 ? reinterpret_cast<T*>(info.pFactory->create(self())) : 0;
+      }
+    else
+      value = PiiSerializationFactory::create<T>(name, *self());
     PiiSmartPtr<T> valuePtr(value); // Exception safety
     if (value == 0)
       PII_SERIALIZATION_ERROR_INFO(UnregisteredClass, name);
@@ -326,7 +384,13 @@ private:
       _lstPointers << PiiArchivePointerInfo(value, QList<void**>() << reinterpret_cast<void**>(&value), false);
 
     // Restore
-    PiiSerializer<Archive>::serialize(name, *self(), *value, version);
+    if (bDynamic)
+      {
+        if (info.pSerializer != 0)
+          info.pSerializer->serialize(*self(), (void*)value, version);
+      }
+    else
+      PiiSerializer<Archive>::serialize(name, *self(), *value, version);
     valuePtr.release();
   }
 
@@ -350,7 +414,14 @@ private:
       PII_SERIALIZATION_ERROR_INFO(ClassVersionMismatch,
                                    metaObject.className());
 
-    PiiSerializer<Archive>::serialize(metaObject.className(), *self(), value, version);
+    if (PiiSerialization::isDynamicType(&value))
+      {
+        const PiiSerializer<Archive>* pSerializer = classInfo(metaObject.className(), false).pSerializer;
+        if (pSerializer != 0)
+          pSerializer->serialize(*self(), (void*)&value, version);
+      }
+    else
+      PiiSerializer<Archive>::serialize(metaObject.className(), *self(), value, version);
   }
 
   template <class T> void loadTrackedObject(T& value)
@@ -383,6 +454,7 @@ private:
    * locations. (Clear, no?)
    */
   QList<PiiArchivePointerInfo> _lstPointers;
+  QHash<QByteArray,ClassInfo> _hashClasses;
 };
 
 
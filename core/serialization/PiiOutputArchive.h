@@ -78,6 +78,15 @@ public:
       self()->writeRawData(ptr, sizeof(T)*size);
   }
 
+  /**
+   * Starts a contiguous block of raw data of *size* bytes. Archives
+   * may use this to place large blocks so that they can be memory
+   * mapped when read back. The block itself must be written with
+   * writeRawData() right after calling this function. The default
+   * implementation does nothing.
+   */
+  void startRawBlock(unsigned int /*size*/) {}
+
   /**
    * This operator is defined for both input and output archives,
    * which makes it possible to serialize and deserialize data with a
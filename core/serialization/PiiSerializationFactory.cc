@@ -17,6 +17,18 @@
 
 PII_DEFINE_FACTORY_MAP(PiiSerialization::Void);
 
+PiiSerializationFactory::Resolver PiiSerializationFactory::_pResolver = 0;
+
+void PiiSerializationFactory::setResolver(Resolver resolver)
+{
+  _pResolver = resolver;
+}
+
+PiiSerializationFactory::Resolver PiiSerializationFactory::resolver()
+{
+  return _pResolver;
+}
+
 QList<const char*> PiiSerializationFactory::keys(MapType* map)
 {
   QList<const char*> lstResult;
@@ -290,6 +290,22 @@ public:
     return keys(map<Archive>());
   }
 
+  /**
+   * Returns a factory for *className*, first from the
+   * archive-specific map and then from the default one. If no
+   * factory is found, the [resolver](setResolver()) will be given a
+   * chance to register the class. Returns 0 if the class cannot be
+   * found.
+   */
+  template <class Archive> static PiiSerializationFactory* resolveFactory(const char* className)
+  {
+    PiiSerializationFactory* pFactory = findFactory<Archive>(className);
+    // Give the resolver a chance to register the class.
+    if (pFactory == 0 && _pResolver != 0 && (*_pResolver)(className))
+      pFactory = findFactory<Archive>(className);
+    return pFactory;
+  }
+
   /// @internal
   template <class T, class Archive> static T* create(const char* className, Archive& archive);
   // NOTE: the implementation of this function is in
@@ -340,6 +356,36 @@ public:
 
   template <class T, class Archive> class Template;
 
+  /**
+   * A function that is called when no factory is registered for
+   * *className*. The resolver may, for example, load a shared
+   * library that registers the missing factory. It returns `true` if
+   * it did something that may have made the class available and
+   * `false` otherwise.
+   */
+  typedef bool (*Resolver)(const char* className);
+
+  /**
+   * Sets the function that will be called whenever an unregistered
+   * class is encountered while creating an object by its name. There
+   * is at most one resolver in an application. Passing zero disables
+   * resolving. The default value is zero.
+   *
+   * ~~~(c++)
+   * static bool loadMissingClass(const char* className)
+   * {
+   *   return loadLibraryFor(className);
+   * }
+   *
+   * PiiSerializationFactory::setResolver(loadMissingClass);
+   * ~~~
+   */
+  static void setResolver(Resolver resolver);
+  /**
+   * Returns the current resolver.
+   */
+  static Resolver resolver();
+
 protected:
   typedef QHash<PiiConstCharWrapper, PiiSerializationFactory*> MapType;
   template <class Archive> static MapType* map();
@@ -348,8 +394,21 @@ protected:
 
 private:
   static QList<const char*> keys(MapType* map);
+  template <class Archive> static PiiSerializationFactory* findFactory(const char* className);
+  static Resolver _pResolver;
 };
 
+template <class Archive> PiiSerializationFactory* PiiSerializationFactory::findFactory(const char* className)
+{
+  // Try archive-specific factory first
+  PiiSerializationFactory* pFactory = factory<Archive>(className);
+  // Otherwise try the default factory unless this already is the
+  // default one.
+  if (pFactory == 0 && !Pii::IsSame<Archive, PiiSerialization::Void>::boolValue)
+    pFactory = factory<PiiSerialization::Void>(className);
+  return pFactory;
+}
+
 template <class Archive> PiiSerializationFactory::MapType* PiiSerializationFactory::map()
 {
   static MapType map = MapType();
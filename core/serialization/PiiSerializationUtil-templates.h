@@ -667,8 +667,11 @@ namespace PiiSerialization
     QByteArray array;
     QBuffer buffer(&array);
     buffer.open(QIODevice::WriteOnly);
-    Archive archive(&buffer);
-    archive << object;
+    {
+      // Buffered archives write their data when destroyed.
+      Archive archive(&buffer);
+      archive << object;
+    }
     return array;
   }
 
@@ -31,24 +31,71 @@ public:
 #endif
   using SuperType::operator=;
 
+  /* Qt-style iterators that give access to the key and the value
+     through key() and value() instead of first and second.
+   */
+  class iterator : public SuperType::iterator
+  {
+  public:
+    iterator() {}
+    iterator(const typename SuperType::iterator& other) : SuperType::iterator(other) {}
+    const key_type& key() const { return (*this)->first; }
+    mapped_type& value() const { return (*this)->second; }
+  };
+
+  class const_iterator : public SuperType::const_iterator
+  {
+  public:
+    const_iterator() {}
+    const_iterator(const typename SuperType::const_iterator& other) : SuperType::const_iterator(other) {}
+    const_iterator(const typename SuperType::iterator& other) : SuperType::const_iterator(other) {}
+    const key_type& key() const { return (*this)->first; }
+    const mapped_type& value() const { return (*this)->second; }
+  };
+
+  iterator begin() { return SuperType::begin(); }
+  iterator end() { return SuperType::end(); }
+  const_iterator begin() const { return SuperType::begin(); }
+  const_iterator end() const { return SuperType::end(); }
+  const_iterator constBegin() const { return SuperType::begin(); }
+  const_iterator constEnd() const { return SuperType::end(); }
+  iterator find(const key_type& key) { return SuperType::find(key); }
+  const_iterator find(const key_type& key) const { return SuperType::find(key); }
+  const_iterator constFind(const key_type& key) const { return SuperType::find(key); }
+
+  bool contains(const key_type& key) const { return SuperType::find(key) != SuperType::end(); }
+  bool isEmpty() const { return this->empty(); }
+  int size() const { return int(SuperType::size()); }
+
+  // Replaces an existing value like Qt does; std insert() won't.
   void insert(const key_type& key, const mapped_type& value)
   {
-    SuperType::insert(std::make_pair(key, value));
+    (*this)[key] = value;
   }
 
-  mapped_type value(const key_type& key) const
+  mapped_type value(const key_type& key, const mapped_type& defaultValue = mapped_type()) const
   {
-    typename SuperType::const_iterator it = this->find(key);
-    if (it != this->end())
+    typename SuperType::const_iterator it = SuperType::find(key);
+    if (it != SuperType::end())
       return it->second;
-    return mapped_type();
+    return defaultValue;
+  }
+
+  mapped_type take(const key_type& key)
+  {
+    typename SuperType::iterator it = SuperType::find(key);
+    if (it == SuperType::end())
+      return mapped_type();
+    mapped_type result(it->second);
+    SuperType::erase(it);
+    return result;
   }
 
   void remove(const key_type& key)
   {
-    typename SuperType::iterator it = this->find(key);
-    if (it != this->end())
-      this->erase(it);
+    typename SuperType::iterator it = SuperType::find(key);
+    if (it != SuperType::end())
+      SuperType::erase(it);
   }
 };
 
@@ -17,6 +17,8 @@
 #define _LINEARCONTAINER_H
 
 #include <algorithm>
+#include <iterator>
+#include "qtalgorithms.h"
 
 template <class Derived, class T> class LinearContainer
 {
@@ -25,7 +27,7 @@ public:
   {
     typename Derived::const_iterator it = std::find(self()->begin(), self()->end(), elem);
     if (it != self()->end())
-      return int(it - self()->begin());
+      return int(std::distance(self()->begin(), it));
     return -1;
   }
 
@@ -37,13 +39,58 @@ public:
 
   bool isEmpty() const { return self()->size() == 0; }
 
-  void removeAt(int i) { self()->erase(self()->begin() + i); }
+  void removeAt(int i) { self()->erase(iteratorAt(self(), i)); }
+  bool removeOne(const T& value)
+  {
+    int i = indexOf(value);
+    if (i < 0)
+      return false;
+    removeAt(i);
+    return true;
+  }
+  int removeAll(const T& value)
+  {
+    typename Derived::iterator it = std::remove(self()->begin(), self()->end(), value);
+    int iCount = int(std::distance(it, self()->end()));
+    self()->erase(it, self()->end());
+    return iCount;
+  }
+  bool contains(const T& value) const { return indexOf(value) != -1; }
+  int count() const { return int(self()->size()); }
+  void prepend(const T& value)
+  {
+    typename Derived::SuperType* pSuper = self();
+    pSuper->insert(pSuper->begin(), value);
+  }
+  T takeAt(int i)
+  {
+    typename Derived::iterator it = iteratorAt(self(), i);
+    T value(*it);
+    self()->erase(it);
+    return value;
+  }
+  T takeFirst() { return takeAt(0); }
+  T takeLast()
+  {
+    T value(last());
+    removeLast();
+    return value;
+  }
+  T value(int i, const T& defaultValue = T()) const
+  {
+    if (i < 0 || i >= int(self()->size()))
+      return defaultValue;
+    typename Derived::const_iterator it = self()->begin();
+    std::advance(it, i);
+    return *it;
+  }
+  void removeFirst() { self()->erase(self()->begin()); }
   void removeLast() { self()->pop_back(); }
   void append(const T& value) { self()->push_back(value); }
   void append(const Derived& values)
   {
-    for (int i=0; i<values.size(); ++i)
-      self()->push_back(values.at(i));
+    for (typename Derived::const_iterator it = values.begin(); it != values.end(); ++it)
+      self()->push_back(*it);
   }
 
   Derived& operator<< (const T& value)
@@ -52,7 +99,28 @@ public:
     return *self();
   }
 
+  Derived& operator<< (const Derived& values)
+  {
+    append(values);
+    return *self();
+  }
+
+  Derived& operator+= (const Derived& values)
+  {
+    append(values);
+    return *self();
+  }
+
 private:
+  // QLinkedList has no random access; std::advance is constant time
+  // for the others.
+  template <class Container> static typename Container::iterator iteratorAt(Container* container, int i)
+  {
+    typename Container::iterator it = container->begin();
+    std::advance(it, i);
+    return it;
+  }
+
   Derived* self() { return static_cast<Derived*>(this); }
   const Derived* self() const { return static_cast<const Derived*>(this); }
 };
@@ -0,0 +1,72 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "qcoreapplication.h"
+#include "qobject.h"
+#include "qmutex.h"
+#include "qmutexlocker.h"
+#include "qpair.h"
+
+namespace QCoreApplication
+{
+  typedef QPair<QObject*,QEvent*> PostedEvent;
+
+  static QMutex& eventMutex()
+  {
+    static QMutex mutex;
+    return mutex;
+  }
+
+  static QList<PostedEvent>& postedEvents()
+  {
+    static QList<PostedEvent> lstEvents;
+    return lstEvents;
+  }
+
+  void postEvent(QObject* receiver, QEvent* event)
+  {
+    QMutexLocker lock(&eventMutex());
+    postedEvents().append(PostedEvent(receiver, event));
+  }
+
+  void processEvents()
+  {
+    QList<PostedEvent>& lstEvents = postedEvents();
+    eventMutex().lock();
+    // Events posted by the handlers are left for the next round.
+    for (int iCount = lstEvents.size(); iCount > 0 && !lstEvents.isEmpty(); --iCount)
+      {
+        PostedEvent event = lstEvents.first();
+        lstEvents.removeFirst();
+        eventMutex().unlock();
+        event.first->event(event.second);
+        delete event.second;
+        eventMutex().lock();
+      }
+    eventMutex().unlock();
+  }
+
+  void removePostedEvents(QObject* receiver)
+  {
+    QMutexLocker lock(&eventMutex());
+    QList<PostedEvent>& lstEvents = postedEvents();
+    for (int i=lstEvents.size(); i--; )
+      if (lstEvents[i].first == receiver)
+        {
+          delete lstEvents[i].second;
+          lstEvents.removeAt(i);
+        }
+  }
+}
@@ -18,12 +18,27 @@
 
 #include "qstring.h"
 
+class QObject;
+class QEvent;
+
+/* Without Qt, there is no event loop. Events posted from any thread
+   are queued globally and delivered to QObject::event() in the
+   thread that calls processEvents(). Pending events are discarded
+   when the receiver is destroyed.
+ */
 namespace QCoreApplication
 {
   inline QString translate(const char* /*context*/, const char* text)
   {
     return QString(text);
   }
+
+  /// Queues *event* to *receiver* and takes the ownership of *event*.
+  PII_CORE_EXPORT void postEvent(QObject* receiver, QEvent* event);
+  /// Delivers all events that were queued when the call was made.
+  PII_CORE_EXPORT void processEvents();
+  /// Removes and deletes all pending events to *receiver*.
+  PII_CORE_EXPORT void removePostedEvents(QObject* receiver);
 };
 
 #endif //_QCOREAPPLICATION_H
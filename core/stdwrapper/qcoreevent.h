@@ -0,0 +1,35 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QCOREEVENT_H
+#define _QCOREEVENT_H
+
+#include <PiiGlobal.h>
+
+class PII_CORE_EXPORT QEvent
+{
+public:
+  enum Type { None = 0, User = 1000, MaxUser = 65535 };
+
+  explicit QEvent(Type type) : _type(type) {}
+  virtual ~QEvent() {}
+
+  Type type() const { return _type; }
+
+private:
+  Type _type;
+};
+
+#endif //_QCOREEVENT_H
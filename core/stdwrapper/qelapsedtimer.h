@@ -0,0 +1,54 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QELAPSEDTIMER_H
+#define _QELAPSEDTIMER_H
+
+#ifndef PII_CXX11
+#  error "QElapsedTimer emulation requires C++11."
+#endif
+
+#include "qtglobal.h"
+#include <PiiGlobal.h>
+#include <chrono>
+
+class PII_CORE_EXPORT QElapsedTimer
+{
+public:
+  QElapsedTimer() : _bValid(false) {}
+
+  void start() { _start = std::chrono::steady_clock::now(); _bValid = true; }
+  qint64 restart()
+  {
+    qint64 iElapsed = elapsed();
+    start();
+    return iElapsed;
+  }
+  bool isValid() const { return _bValid; }
+  void invalidate() { _bValid = false; }
+
+  qint64 elapsed() const { return nsecsElapsed() / 1000000; }
+  qint64 nsecsElapsed() const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+  }
+  bool hasExpired(qint64 timeout) const { return timeout >= 0 && elapsed() > timeout; }
+
+private:
+  std::chrono::steady_clock::time_point _start;
+  bool _bValid;
+};
+
+#endif //_QELAPSEDTIMER_H
@@ -31,12 +31,12 @@ public:
   QHash(QHash&& other) : SuperType(other) {}
   QHash& operator= (QHash&& other)
   {
-    return static_cast<QHash&>(std::move(other));
+    return static_cast<QHash&>(SuperType::operator= (std::move(other)));
   }
 #endif
   QHash& operator= (const QHash& other)
   {
-    return static_cast<QHash&>(other);
+    return static_cast<QHash&>(SuperType::operator= (other));
   }
 };
 
@@ -42,6 +42,12 @@ public:
   }
 
   int size() const { return int(SuperType::size()); }
+
+  using SuperType::insert;
+  void insert(int i, const T& value) { SuperType::insert(this->begin() + i, value); }
+
+  // std::deque allocates in blocks and cannot reserve
+  void reserve(int) {}
 };
 
 #endif //_QLIST_H
@@ -18,6 +18,7 @@
 
 #include <map>
 #include "keyvaluecontainer.h"
+#include "qlist.h"
 
 template <class Key, class Value> class QMap :
   public KeyValueContainer<std::map<Key,Value> >
@@ -30,12 +31,31 @@ public:
   QMap(QMap&& other) : SuperType(other) {}
   QMap& operator= (QMap&& other)
   {
-    return static_cast<QMap&>(std::move(other));
+    return static_cast<QMap&>(SuperType::operator= (std::move(other)));
   }
 #endif
   QMap& operator= (const QMap& other)
   {
-    return static_cast<QMap&>(other);
+    return static_cast<QMap&>(SuperType::operator= (other));
+  }
+
+  const Key& firstKey() const { return this->constBegin().key(); }
+  const Key& lastKey() const { return this->rbegin()->first; }
+
+  QList<Key> keys() const
+  {
+    QList<Key> lstResult;
+    for (typename SuperType::const_iterator i = this->constBegin(); i != this->constEnd(); ++i)
+      lstResult.push_back(i.key());
+    return lstResult;
+  }
+
+  QList<Value> values() const
+  {
+    QList<Value> lstResult;
+    for (typename SuperType::const_iterator i = this->constBegin(); i != this->constEnd(); ++i)
+      lstResult.push_back(i.value());
+    return lstResult;
   }
 };
 
@@ -16,16 +16,62 @@
 #ifndef _QMUTEX_H
 #define _QMUTEX_H
 
+#include <PiiGlobal.h>
+
 #ifdef PII_CXX11
 #  include <mutex>
-typedef std::mutex QMutex;
+#  include <chrono>
+
+class PII_CORE_EXPORT QMutex
+{
+public:
+  enum RecursionMode { NonRecursive, Recursive };
+
+  QMutex(RecursionMode mode = NonRecursive) : _bRecursive(mode == Recursive) {}
+
+  void lock()
+  {
+    if (_bRecursive)
+      _recursiveMutex.lock();
+    else
+      _mutex.lock();
+  }
+  void unlock()
+  {
+    if (_bRecursive)
+      _recursiveMutex.unlock();
+    else
+      _mutex.unlock();
+  }
+  bool tryLock(int timeout = 0)
+  {
+    if (timeout < 0)
+      {
+        lock();
+        return true;
+      }
+    std::chrono::milliseconds ms(timeout);
+    return _bRecursive ? _recursiveMutex.try_lock_for(ms) : _mutex.try_lock_for(ms);
+  }
+  // Makes QMutex usable with std::unique_lock and condition_variable_any.
+  bool try_lock() { return tryLock(); }
+
+private:
+  PII_DISABLE_COPY(QMutex);
+  bool _bRecursive;
+  std::timed_mutex _mutex;
+  std::recursive_timed_mutex _recursiveMutex;
+};
 #elif !defined(PII_MUTEX_IMPL)
 // A dummy implementation that doesn't provide mutual exclusion.
 class PII_CORE_EXPORT QMutex
 {
 public:
+  enum RecursionMode { NonRecursive, Recursive };
+  QMutex(RecursionMode = NonRecursive) {}
   void lock() {}
   void unlock() {}
+  bool tryLock(int = 0) { return true; }
   bool try_lock() { return true; }
 };
 #else
@@ -35,4 +81,7 @@ public:
 typedef PII_MUTEX_IMPL QMutex;
 #endif
 
+// Qt declares QMutexLocker in the same header.
+#include "qmutexlocker.h"
+
 #endif //_QMUTEX_H
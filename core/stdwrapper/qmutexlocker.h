@@ -22,12 +22,15 @@
 class PII_CORE_EXPORT QMutexLocker
 {
 public:
-  QMutexLocker(QMutex* mutex) : _pMutex(mutex) { mutex->lock(); }
-  ~QMutexLocker() { _pMutex->unlock(); }
+  QMutexLocker(QMutex* mutex) : _pMutex(mutex), _bLocked(true) { mutex->lock(); }
+  ~QMutexLocker() { unlock(); }
   QMutex* mutex() { return _pMutex; }
+  void unlock() { if (_bLocked) { _pMutex->unlock(); _bLocked = false; } }
+  void relock() { if (!_bLocked) { _pMutex->lock(); _bLocked = true; } }
 private:
   PII_DISABLE_COPY(QMutexLocker);
   QMutex* _pMutex;
+  bool _bLocked;
 };
 
 #endif //_QMUTEXLOCKER_H
@@ -0,0 +1,90 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "qobject.h"
+#include "qcoreapplication.h"
+#include "qmutex.h"
+#include "qmutexlocker.h"
+#include <map>
+#include <typeinfo>
+#include <cstdlib>
+#ifdef __GNUC__
+#  include <cxxabi.h>
+#endif
+
+QMetaObject::QMetaObject(const char* mangledName)
+{
+#ifdef __GNUC__
+  int iStatus = 0;
+  char* pDemangled = abi::__cxa_demangle(mangledName, 0, 0, &iStatus);
+  if (pDemangled != 0)
+    {
+      _strClassName = pDemangled;
+      std::free(pDemangled);
+      return;
+    }
+#endif
+  _strClassName = mangledName;
+  // MSVC returns "class Name".
+  if (_strClassName.compare(0, 6, "class ") == 0)
+    _strClassName.erase(0, 6);
+}
+
+QObject::QObject(QObject* parent) :
+  _pParent(0)
+{
+  setParent(parent);
+}
+
+QObject::~QObject()
+{
+  QCoreApplication::removePostedEvents(this);
+  while (!_lstChildren.isEmpty())
+    {
+      QObject* pChild = _lstChildren.last();
+      _lstChildren.removeLast();
+      // As in Qt, parent() stays valid while the child is destroyed.
+      delete pChild;
+    }
+  setParent(0);
+}
+
+const QMetaObject* QObject::metaObject() const
+{
+  // One meta object is created for each dynamic type. Map nodes
+  // never move, so the returned pointer stays valid.
+  static QMutex mutex;
+  static std::map<std::string, QMetaObject> mapMetaObjects;
+  const char* pName = typeid(*this).name();
+  QMutexLocker lock(&mutex);
+  std::map<std::string, QMetaObject>::iterator it = mapMetaObjects.find(pName);
+  if (it == mapMetaObjects.end())
+    it = mapMetaObjects.insert(std::make_pair(std::string(pName), QMetaObject(pName))).first;
+  return &it->second;
+}
+
+void QObject::setParent(QObject* parent)
+{
+  if (_pParent != 0)
+    _pParent->_lstChildren.removeOne(this);
+  _pParent = parent;
+  if (_pParent != 0)
+    _pParent->_lstChildren.append(this);
+}
+
+bool QObject::event(QEvent*)
+{
+  return false;
+}
@@ -0,0 +1,128 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QOBJECT_H
+#define _QOBJECT_H
+
+#include <PiiGlobal.h>
+#include "qstring.h"
+#include "qlist.h"
+#include "qcoreevent.h"
+
+// There is no meta-object compiler. Signals are ordinary member
+// functions the class itself must implement, and slots are called
+// directly.
+#define Q_OBJECT
+#define Q_GADGET
+#define Q_INVOKABLE
+#define Q_PROPERTY(...)
+#define Q_CLASSINFO(NAME, VALUE)
+#define Q_INTERFACES(...)
+#define Q_DECLARE_METATYPE(...)
+#define Q_DECLARE_INTERFACE(...)
+#define Q_SIGNALS public
+#define Q_SLOTS
+#define Q_EMIT
+#define signals Q_SIGNALS
+#define slots Q_SLOTS
+#define emit Q_EMIT
+
+class QObject;
+typedef QList<QObject*> QObjectList;
+
+/* Provides the class name of a QObject. The name is derived from
+   run-time type information.
+ */
+class PII_CORE_EXPORT QMetaObject
+{
+public:
+  const char* className() const { return _strClassName.c_str(); }
+
+private:
+  friend class QObject;
+  explicit QMetaObject(const char* mangledName);
+  std::string _strClassName;
+};
+
+class PII_CORE_EXPORT QObject
+{
+public:
+  explicit QObject(QObject* parent = 0);
+  virtual ~QObject();
+
+  virtual const QMetaObject* metaObject() const;
+
+  QString objectName() const { return _strObjectName; }
+  void setObjectName(const QString& name) { _strObjectName = name; }
+
+  QObject* parent() const { return _pParent; }
+  void setParent(QObject* parent);
+  const QObjectList& children() const { return _lstChildren; }
+
+  template <class T> T findChild(const QString& name = QString()) const
+  {
+    for (int i=0; i<_lstChildren.size(); ++i)
+      {
+        T pChild = dynamic_cast<T>(_lstChildren[i]);
+        if (pChild != 0 && (name.isEmpty() || name == _lstChildren[i]->objectName()))
+          return pChild;
+      }
+    for (int i=0; i<_lstChildren.size(); ++i)
+      {
+        T pChild = _lstChildren[i]->findChild<T>(name);
+        if (pChild != 0)
+          return pChild;
+      }
+    return 0;
+  }
+
+  template <class T> QList<T> findChildren(const QString& name = QString()) const
+  {
+    QList<T> lstResult;
+    findChildren(name, lstResult);
+    return lstResult;
+  }
+
+  /**
+   * Receives events posted with QCoreApplication::postEvent(). The
+   * default implementation does nothing and returns .
+   */
+  virtual bool event(QEvent* e);
+
+  static QString tr(const char* text) { return QString(text); }
+
+private:
+  template <class T> void findChildren(const QString& name, QList<T>& result) const
+  {
+    for (int i=0; i<_lstChildren.size(); ++i)
+      {
+        T pChild = dynamic_cast<T>(_lstChildren[i]);
+        if (pChild != 0 && (name.isEmpty() || name == _lstChildren[i]->objectName()))
+          result.append(pChild);
+        _lstChildren[i]->findChildren(name, result);
+      }
+  }
+
+  PII_DISABLE_COPY(QObject);
+
+  QString _strObjectName;
+  QObject* _pParent;
+  QObjectList _lstChildren;
+};
+
+template <class T> inline T qobject_cast(QObject* object) { return dynamic_cast<T>(object); }
+template <class T> inline T qobject_cast(const QObject* object) { return dynamic_cast<T>(object); }
+
+#endif //_QOBJECT_H
@@ -0,0 +1,53 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QQUEUE_H
+#define _QQUEUE_H
+
+#include "qlist.h"
+
+template <class T>
+class QQueue : public QList<T>
+{
+public:
+  typedef QList<T> SuperType;
+
+  QQueue() {}
+  QQueue(const QQueue& other) : SuperType(other) {}
+#ifdef PII_CXX11
+  QQueue(QQueue&& other) : SuperType(other) {}
+  QQueue& operator= (QQueue&& other)
+  {
+    return static_cast<QQueue&>(SuperType::operator= (std::move(other)));
+  }
+#endif
+  QQueue& operator= (const QQueue& other)
+  {
+    return static_cast<QQueue&>(SuperType::operator= (other));
+  }
+
+  T dequeue()
+  {
+    T val(this->front());
+    this->pop_front();
+    return val;
+  }
+
+  void enqueue(const T& val) { this->push_back(val); }
+  T& head() { return this->front(); }
+  const T& head() const { return this->front(); }
+};
+
+#endif //_QQUEUE_H
@@ -38,6 +38,11 @@ public:
   QString(SuperType&& other) : SuperType(other) {}
 #endif
   using SuperType::operator=;
+  QString& operator= (const QString& other)
+  {
+    SuperType::operator= (other);
+    return *this;
+  }
 
   QString& append(const SuperType& str)
   {
@@ -51,6 +56,18 @@ public:
     return *this;
   }
 
+  QString& prepend(const SuperType& str)
+  {
+    insert(0, str);
+    return *this;
+  }
+
+  QString& prepend(char chr)
+  {
+    insert(size_type(0), size_type(1), chr);
+    return *this;
+  }
+
   int indexOf(char chr, int from = 0) const
   {
     size_type i = find(chr, from);
@@ -58,6 +75,8 @@ public:
   }
 
   bool isEmpty() const { return size() == 0; }
+  // Null and empty strings cannot be told apart.
+  bool isNull() const { return size() == 0; }
   int size() const { return int(SuperType::size()); }
   int length() const { return int(SuperType::size()); }
 
@@ -76,11 +95,14 @@ public:
     return ss.str();
   }
 
+  // Strings are stored as bytes in whatever encoding they came in.
+  static QString fromLocal8Bit(const char* str) { return QString(str); }
+
   template <class T>
   bool to(T& value) const
   {
     std::basic_istringstream<SuperType::value_type> ss(*this);
-    return ss >> value;
+    return !(ss >> value).fail();
   }
 
   template <class T>
@@ -122,15 +144,66 @@ public:
     return *this;
   }
 
+  template <class T> QString arg(T value, int fieldWidth, int base = 10, char fillChar = ' ') const
+  {
+    std::basic_ostringstream<SuperType::value_type> stream;
+    if (base == 16)
+      stream << std::hex;
+    else if (base == 8)
+      stream << std::oct;
+    // Unary plus prints char types as numbers.
+    stream << +value;
+    return arg(pad(stream.str(), fieldWidth, fillChar));
+  }
+
+  template <class T, class U> QString arg(const T& value1, const U& value2) const
+  {
+    return arg(value1).arg(value2);
+  }
+
+  QString arg(double value, int fieldWidth, char format, int precision = -1, char fillChar = ' ') const
+  {
+    std::basic_ostringstream<SuperType::value_type> stream;
+    if (format == 'f')
+      stream << std::fixed;
+    else if (format == 'e')
+      stream << std::scientific;
+    if (precision >= 0)
+      stream.precision(precision);
+    stream << value;
+    return arg(pad(stream.str(), fieldWidth, fillChar));
+  }
+
   QStringList split(char sep, SplitBehavior behavior = KeepEmptyParts) const;
 
   QString toLower() const;
   QString toUpper() const;
+
+private:
+  // A positive field width aligns right, a negative one left.
+  static SuperType pad(const SuperType& str, int fieldWidth, char fillChar)
+  {
+    int iPadding = (fieldWidth < 0 ? -fieldWidth : fieldWidth) - int(str.size());
+    if (iPadding <= 0)
+      return str;
+    return fieldWidth > 0 ? SuperType(iPadding, fillChar) + str : str + SuperType(iPadding, fillChar);
+  }
 };
 
+#define qPrintable(STR) (QString(STR).c_str())
+
 namespace Pii
 {
   template <class T> inline T stringTo(const QString& number, bool* ok = 0) { return number.to<T>(ok); }
 }
 
+#ifdef PII_CXX11
+#  include <functional>
+// Makes QString usable as a QHash (std::unordered_map) key.
+namespace std
+{
+  template <> struct hash<QString> : hash<std::string> {};
+}
+#endif
+
 #endif //_QSTRING_H
@@ -42,6 +42,18 @@ public:
   {
     return static_cast<QStringList&>(SuperType::operator<< (value));
   }
+
+  QString join(const QString& separator) const
+  {
+    QString strResult;
+    for (int i=0; i<size(); ++i)
+      {
+        if (i > 0)
+          strResult += separator;
+        strResult += at(i);
+      }
+    return strResult;
+  }
 };
 
 #endif //_QSTRINGLIST_H
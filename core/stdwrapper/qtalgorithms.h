@@ -0,0 +1,42 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QTALGORITHMS_H
+#define _QTALGORITHMS_H
+
+#include <algorithm>
+
+template <class RandomAccessIterator> inline void qSort(RandomAccessIterator begin, RandomAccessIterator end)
+{
+  std::sort(begin, end);
+}
+
+template <class Container> inline void qSort(Container& c)
+{
+  std::sort(c.begin(), c.end());
+}
+
+template <class ForwardIterator> inline void qDeleteAll(ForwardIterator begin, ForwardIterator end)
+{
+  for (; begin != end; ++begin)
+    delete *begin;
+}
+
+template <class Container> inline void qDeleteAll(const Container& c)
+{
+  qDeleteAll(c.begin(), c.end());
+}
+
+#endif //_QTALGORITHMS_H
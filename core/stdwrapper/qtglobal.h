@@ -27,13 +27,23 @@
 inline void qt_noop(void) {}
 
 #define Q_DECLARE_FLAGS(A,B) typedef int A
-#define Q_FLAGS(A) namespace {}
-#define Q_ENUMS(A) namespace {}
+// Used in class scope, where a namespace cannot be declared. The
+// trailing semicolon is an empty declaration.
+#define Q_FLAGS(...)
+#define Q_ENUMS(...)
 #define Q_DECLARE_OPERATORS_FOR_FLAGS(A) namespace {}
 #define Q_ASSERT(A) qt_noop()
 #define QT_TR_NOOP(A) (A)
 #define QT_TRANSLATE_NOOP(A,B) (B)
 #define QT_VERSION 0x050000
+#define forever for (;;)
+
+#ifdef PII_CXX11
+// Like Qt's foreach, iterates over a copy of the container.
+template <class T> inline T qForeachCopy(const T& container) { return container; }
+#  define foreach(VARIABLE, CONTAINER) for (VARIABLE : qForeachCopy(CONTAINER))
+#  define Q_FOREACH(VARIABLE, CONTAINER) foreach(VARIABLE, CONTAINER)
+#endif
 
 typedef unsigned char uchar;
 typedef unsigned short ushort;
@@ -52,6 +62,15 @@ typedef unsigned __int64 quint64;
 typedef long long qint64;
 typedef unsigned long long quint64;
 #endif
+#if (defined(__SIZEOF_POINTER__) && __SIZEOF_POINTER__ == 8) || defined(_WIN64)
+typedef quint64 quintptr;
+typedef qint64 qptrdiff;
+#else
+typedef quint32 quintptr;
+typedef qint32 qptrdiff;
+#endif
+#define Q_INT64_C(c) static_cast<long long>(c ## LL)
+#define Q_UINT64_C(c) static_cast<unsigned long long>(c ## ULL)
 
 
 template <class T> inline T qMin(T a, T b) { return a <= b ? a : b; }
@@ -72,4 +91,9 @@ template <class T> inline void qSwap(T& a, T&b) { std::swap(a, b); }
 
 #define Q_UNUSED(X) (void)(X)
 
+namespace Qt
+{
+  typedef void* HANDLE;
+}
+
 #endif //_QTGLOBAL_H
@@ -0,0 +1,115 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+// Threads need C++11; the emulation is not available otherwise.
+#ifdef PII_CXX11
+
+#include "qthread.h"
+#include "qmutexlocker.h"
+#include <chrono>
+
+QThread::QThread(QObject* parent) :
+  QObject(parent),
+  _priority(InheritPriority),
+  _state(NotStarted)
+{}
+
+QThread::~QThread()
+{
+  // Like in Qt, destroying a running thread is a programming error.
+  // Detaching at least doesn't terminate the process.
+  if (_thread.joinable())
+    {
+      if (isFinished())
+        _thread.join();
+      else
+        _thread.detach();
+    }
+}
+
+void QThread::start(Priority priority)
+{
+  QMutexLocker lock(&_mutex);
+  if (_state == Running)
+    return;
+  if (_thread.joinable())
+    _thread.join();
+  _priority = priority;
+  _state = Running;
+  _thread = std::thread(&QThread::execute, this);
+}
+
+void QThread::execute()
+{
+  run();
+  QMutexLocker lock(&_mutex);
+  _state = Finished;
+  _finishedCondition.wakeAll();
+}
+
+bool QThread::wait(unsigned long time)
+{
+  QMutexLocker lock(&_mutex);
+  if (_state != Running)
+    return true;
+  if (_thread.get_id() == std::this_thread::get_id())
+    return false;
+  if (time == ULONG_MAX)
+    {
+      while (_state == Running)
+        _finishedCondition.wait(&_mutex);
+    }
+  else if (_state == Running)
+    _finishedCondition.wait(&_mutex, time);
+  return _state != Running;
+}
+
+bool QThread::isRunning() const
+{
+  QMutexLocker lock(&_mutex);
+  return _state == Running;
+}
+
+bool QThread::isFinished() const
+{
+  QMutexLocker lock(&_mutex);
+  return _state == Finished;
+}
+
+void QThread::run()
+{
+  exec();
+}
+
+Qt::HANDLE QThread::currentThreadId()
+{
+  // The address of a thread-local variable uniquely identifies the
+  // thread.
+  static thread_local char cThreadTag;
+  return &cThreadTag;
+}
+
+int QThread::idealThreadCount()
+{
+  int iCount = int(std::thread::hardware_concurrency());
+  return iCount > 0 ? iCount : -1;
+}
+
+void QThread::yieldCurrentThread() { std::this_thread::yield(); }
+void QThread::sleep(unsigned long secs) { std::this_thread::sleep_for(std::chrono::seconds(secs)); }
+void QThread::msleep(unsigned long msecs) { std::this_thread::sleep_for(std::chrono::milliseconds(msecs)); }
+void QThread::usleep(unsigned long usecs) { std::this_thread::sleep_for(std::chrono::microseconds(usecs)); }
+
+#endif // PII_CXX11
@@ -0,0 +1,84 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QTHREAD_H
+#define _QTHREAD_H
+
+#ifndef PII_CXX11
+#  error "QThread emulation requires C++11."
+#endif
+
+#include "qobject.h"
+#include "qmutex.h"
+#include "qwaitcondition.h"
+#include <thread>
+#include <climits>
+
+/* A QThread built on std::thread. Thread priorities are recorded but
+   not applied, and there is no event loop: exec() returns
+   immediately. Subclasses that need to react to termination must do
+   so at the end of run() because there is no finished() signal.
+ */
+class PII_CORE_EXPORT QThread : public QObject
+{
+public:
+  enum Priority
+    {
+      IdlePriority,
+      LowestPriority,
+      LowPriority,
+      NormalPriority,
+      HighPriority,
+      HighestPriority,
+      TimeCriticalPriority,
+      InheritPriority
+    };
+
+  explicit QThread(QObject* parent = 0);
+  ~QThread();
+
+  void start(Priority priority = InheritPriority);
+  bool wait(unsigned long time = ULONG_MAX);
+
+  bool isRunning() const;
+  bool isFinished() const;
+
+  void setPriority(Priority priority) { _priority = priority; }
+  Priority priority() const { return _priority; }
+
+  static Qt::HANDLE currentThreadId();
+  static int idealThreadCount();
+  static void yieldCurrentThread();
+  static void sleep(unsigned long secs);
+  static void msleep(unsigned long msecs);
+  static void usleep(unsigned long usecs);
+
+protected:
+  virtual void run();
+  int exec() { return 0; }
+
+private:
+  void execute();
+
+  enum State { NotStarted, Running, Finished };
+
+  std::thread _thread;
+  Priority _priority;
+  mutable QMutex _mutex;
+  QWaitCondition _finishedCondition;
+  State _state;
+};
+
+#endif //_QTHREAD_H
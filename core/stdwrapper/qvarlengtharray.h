@@ -16,18 +16,19 @@
 #ifndef _QVARLENGTHARRAY_H
 #define _QVARLENGTHARRAY_H
 
-template <class T, int prealloc> class QVarLengthArray
+template <class T, int prealloc = 256> class QVarLengthArray
 {
 public:
   QVarLengthArray(int size = 0) :
     _iSize(size),
+    _iCapacity(size <= prealloc ? prealloc : size),
     _ptr(size <= prealloc ? _array : new T[size])
   {}
 
   ~QVarLengthArray()
   {
     if (_ptr != _array)
-      delete _ptr;
+      delete[] _ptr;
   }
 
   T& operator[] (int index) { return _ptr[index]; }
@@ -35,9 +36,54 @@ public:
   const T& at(int index) const { return _ptr[index]; }
 
   int size() const { return _iSize; }
+  int count() const { return _iSize; }
+  int capacity() const { return _iCapacity; }
+  bool isEmpty() const { return _iSize == 0; }
+  void clear() { resize(0); }
+
+  /* Keeps the old elements. Shrinking never releases memory,
+     which is what Qt does, too. Removed elements are reset to
+     default values so that they release their resources.
+   */
+  void resize(int size)
+  {
+    for (int i=size; i<_iSize; ++i)
+      _ptr[i] = T();
+    if (size > _iCapacity)
+      {
+        T* pNew = new T[size];
+        for (int i=0; i<_iSize; ++i)
+          pNew[i] = _ptr[i];
+        if (_ptr != _array)
+          delete[] _ptr;
+        _ptr = pNew;
+        _iCapacity = size;
+      }
+    _iSize = size;
+  }
+
+  void append(const T& value)
+  {
+    if (_iSize == _iCapacity)
+      {
+        // resize() changes the size
+        int iSize = _iSize;
+        resize(_iCapacity * 2);
+        _iSize = iSize;
+      }
+    _ptr[_iSize++] = value;
+  }
+
+  T* data() { return _ptr; }
+  const T* data() const { return _ptr; }
+  const T* constData() const { return _ptr; }
+
+private:
+  QVarLengthArray(const QVarLengthArray&);
+  QVarLengthArray& operator= (const QVarLengthArray&);
 
 private:
-  int _iSize;
+  int _iSize, _iCapacity;
   T _array[prealloc];
   T* _ptr;
 };
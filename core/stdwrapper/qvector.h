@@ -58,6 +58,9 @@ public:
 
   int size() const { return int(SuperType::size()); }
 
+  void remove(int i) { this->erase(this->begin() + i); }
+  void remove(int i, int count) { this->erase(this->begin() + i, this->begin() + i + count); }
+
   T* data() { return &(*this->begin()); }
   const T* data() const { return &(*this->begin()); }
   const T* constData() const { return data(); }
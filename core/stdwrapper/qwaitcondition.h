@@ -0,0 +1,50 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _QWAITCONDITION_H
+#define _QWAITCONDITION_H
+
+#ifndef PII_CXX11
+#  error "QWaitCondition emulation requires C++11."
+#endif
+
+#include "qmutex.h"
+#include <condition_variable>
+#include <climits>
+
+class PII_CORE_EXPORT QWaitCondition
+{
+public:
+  QWaitCondition() {}
+
+  bool wait(QMutex* mutex, unsigned long time = ULONG_MAX)
+  {
+    if (time == ULONG_MAX)
+      {
+        _condition.wait(*mutex);
+        return true;
+      }
+    return _condition.wait_for(*mutex, std::chrono::milliseconds(time)) == std::cv_status::no_timeout;
+  }
+
+  void wakeOne() { _condition.notify_one(); }
+  void wakeAll() { _condition.notify_all(); }
+
+private:
+  PII_DISABLE_COPY(QWaitCondition);
+  std::condition_variable_any _condition;
+};
+
+#endif //_QWAITCONDITION_H
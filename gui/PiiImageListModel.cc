@@ -128,8 +128,7 @@ void PiiImageListModel::setFileNames(const QStringList& fileNames)
 
   emit layoutChanged();
 
-  for (int i=0; i<fileNames.size(); i++)
-    d->thumbnailLoader.addFileName(fileNames[i]);
+  d->thumbnailLoader.setFileNames(fileNames);
 }
 
 QStringList PiiImageListModel::fileNames() const
@@ -172,11 +171,26 @@ void PiiImageListModel::updateThumbnail(const QString& fileName, const QImage& i
     if (d->lstItems[i].fileName() == fileName)
       {
         d->lstItems[i].setIcon(QIcon(QPixmap::fromImage(image)));
-        //QModelIndex index = createIndex(i,0);
-        emit layoutChanged();
+        QModelIndex changedIndex = QAbstractListModel::index(i);
+        emit dataChanged(changedIndex, changedIndex);
       }
 }
 
+void PiiImageListModel::prioritizeThumbnails(int firstRow, int lastRow)
+{
+  firstRow = qMax(firstRow, 0);
+  lastRow = qMin(lastRow, d->lstItems.size()-1);
+  QStringList lstFileNames;
+  for (int i=firstRow; i<=lastRow; ++i)
+    lstFileNames << d->lstItems[i].fileName();
+  d->thumbnailLoader.prioritize(lstFileNames);
+}
+
+PiiThumbnailLoader* PiiImageListModel::thumbnailLoader() const
+{
+  return &d->thumbnailLoader;
+}
+
 QModelIndex PiiImageListModel::index(const QString& fileName) const
 {
   for (int i=0; i<d->lstItems.size(); i++)
@@ -103,6 +103,20 @@ public:
    */
   QModelIndex index(const QString& fileName) const;
 
+  /**
+   * Moves the thumbnails of the items from *firstRow* to *lastRow*
+   * (inclusive) to the head of the loading queue. Views call this
+   * function to load visible thumbnails first.
+   */
+  void prioritizeThumbnails(int firstRow, int lastRow);
+
+  /**
+   * Returns the thumbnail loader. It can be used to configure the
+   * thumbnail size, the number of loading threads and the cache
+   * directory.
+   */
+  PiiThumbnailLoader* thumbnailLoader() const;
+
 public slots:
   /**
    * Update an icon to the item by the given fileName.
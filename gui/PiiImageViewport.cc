@@ -15,6 +15,7 @@
 
 #include "PiiImageViewport.h"
 #include "PiiImageOverlay.h"
+#include "PiiImageViewportGL.h"
 #include <PiiMath.h>
 
 #include <QAction>
@@ -36,6 +37,7 @@ PiiImageViewport::Data::Data() :
   bShowOverlayColoring(true),
   pUpdater(0),
   pAdapter(0),
+  pGLView(0),
   selectionMode(Area),
   bDrawGrid(false),
   dHLineStart(0),
@@ -125,11 +127,55 @@ void PiiImageViewport::setPixelSize(const QSizeF& pixelSize)
 void PiiImageViewport::setDrawGrid(bool drawGrid)
 {
   d->bDrawGrid = drawGrid;
-  update();
+  updateDecorations();
 }
 
 bool PiiImageViewport::drawGrid() const { return d->bDrawGrid; }
 
+void PiiImageViewport::setOpenGLEnabled(bool openGLEnabled)
+{
+#ifdef PII_IMAGEVIEWPORT_GL
+  if (openGLEnabled == (d->pGLView != 0))
+    return;
+
+  if (openGLEnabled)
+    {
+      d->pGLView = new PiiImageViewportGL(this);
+      d->pGLView->setGeometry(rect());
+      d->pGLView->show();
+      d->pUpdater->setEnabled(false);
+      // The prescaled image is not needed any more.
+      d->imageLock.lock();
+      d->prescaledImage = QImage();
+      d->imageLock.unlock();
+    }
+  else
+    {
+      delete d->pGLView;
+      d->pGLView = 0;
+      d->pUpdater->setEnabled(isVisible());
+    }
+  updateImage();
+#else
+  Q_UNUSED(openGLEnabled);
+#endif
+}
+
+bool PiiImageViewport::isOpenGLEnabled() const { return d->pGLView != 0; }
+
+void PiiImageViewport::updateDecorations()
+{
+  // Overlays are painted by whichever widget draws the image.
+#ifdef PII_IMAGEVIEWPORT_GL
+  if (d->pGLView != 0)
+    {
+      d->pGLView->update();
+      return;
+    }
+#endif
+  update();
+}
+
 void PiiImageViewport::updateZoomFactors()
 {
   if (d->dAspectRatio >= 1)
@@ -572,7 +618,7 @@ void PiiImageViewport::mouseMoveEvent(QMouseEvent* event)
           else
             d->selectionArea = QRect(-1,minY, width()+2, maxY-minY);
 
-          update();
+          updateDecorations();
         }
       else if (!d->selectionArea.isNull())
         {
@@ -583,7 +629,7 @@ void PiiImageViewport::mouseMoveEvent(QMouseEvent* event)
           else
             d->selectionArea.setCoords(-1,minY, width()+2, maxY);
 
-          update();
+          updateDecorations();
         }
 
       if (!d->selectionArea.isNull())
@@ -683,6 +729,13 @@ void PiiImageViewport::paintEvent(QPaintEvent* event)
   // portions in the image.
   p.fillRect(paintRect, palette().brush(backgroundRole()));
 
+  // The OpenGL back-end covers the whole widget.
+  if (d->pGLView != 0)
+    {
+      d->imageLock.unlock();
+      return;
+    }
+
   // Draw image only if there is one
   if (!d->prescaledImage.isNull())
     {
@@ -715,107 +768,110 @@ void PiiImageViewport::paintEvent(QPaintEvent* event)
 
       d->imageLock.unlock();
 
-      QRect tempWindow = p.window();
-      p.setWindow(d->visibleArea);
-      // Draw the overlays.
-      for (int i = 0; i < d->overlays.size(); ++i)
-        // Some optimization. Draw the overlay only, if it is in the
-        // visible area.
-        if (d->overlays.at(i)->enabled() && d->overlays.at(i)->intersects(d->visibleArea))
-          d->overlays.at(i)->paint((&p), d->bShowOverlayColoring);
+      paintDecorations(p);
+    }
+  else
+    d->imageLock.unlock();
+}
 
-      p.setWindow(tempWindow);
+void PiiImageViewport::paintDecorations(QPainter& p)
+{
+  QRect tempWindow = p.window();
+  p.setWindow(d->visibleArea);
+  // Draw the overlays.
+  for (int i = 0; i < d->overlays.size(); ++i)
+    // Some optimization. Draw the overlay only, if it is in the
+    // visible area.
+    if (d->overlays.at(i)->enabled() && d->overlays.at(i)->intersects(d->visibleArea))
+      d->overlays.at(i)->paint((&p), d->bShowOverlayColoring);
 
-      // Draw the selection rectangle with dashed line and color white/black
-      if (!d->selectionArea.isNull())
-        {
-          p.setPen(Qt::NoPen);
-          p.setBrush(QColor(0,0,255,10));
-          p.drawRect(d->selectionArea);
+  p.setWindow(tempWindow);
 
-          QPen pen(QColor(0,0,0));
-          p.setPen(pen);
-          p.setBrush(Qt::NoBrush);
-          p.drawRect(d->selectionArea);
+  // Draw the selection rectangle with dashed line and color white/black
+  if (!d->selectionArea.isNull())
+    {
+      p.setPen(Qt::NoPen);
+      p.setBrush(QColor(0,0,255,10));
+      p.drawRect(d->selectionArea);
+
+      QPen pen(QColor(0,0,0));
+      p.setPen(pen);
+      p.setBrush(Qt::NoBrush);
+      p.drawRect(d->selectionArea);
+
+      if (d->selectionMode == Area)
+        p.drawLine(d->mousePressPoint, d->mouseCurrPoint);
+
+      pen.setColor(QColor(255,255,255));
+      pen.setStyle(Qt::DashLine);
+      p.setPen(pen);
+      p.drawRect(d->selectionArea);
+      if (d->selectionMode == Area)
+        p.drawLine(d->mousePressPoint, d->mouseCurrPoint);
+    }
 
-          if (d->selectionMode == Area)
-            p.drawLine(d->mousePressPoint, d->mouseCurrPoint);
+  // Draw grid if enabled
+  if (d->bDrawGrid)
+    {
+      QRectF gridRect = QRectF(d->pixelSize.width() * d->visibleArea.x(),
+                               d->pixelSize.height() * d->visibleArea.y(),
+                               d->pixelSize.width() * d->visibleArea.width(),
+                               d->pixelSize.height() * d->visibleArea.height());
+      double w = gridRect.width();
+      double h = gridRect.height();
+
+      // Calculate horizontal lines if necessary
+      if (gridRect.top() != d->previousGridRect.top() ||
+          gridRect.bottom() != d->previousGridRect.bottom())
+        {
+          d->dHLineStep = d->pAdapter->gridSpacing(d->dYScale/d->pixelSize.height(), Pii::Vertically);
+          if (d->dHLineStep > 0)
+            {
+              d->iHLineCount = h / d->dHLineStep + 2;
 
-          pen.setColor(QColor(255,255,255));
-          pen.setStyle(Qt::DashLine);
-          p.setPen(pen);
-          p.drawRect(d->selectionArea);
-          if (d->selectionMode == Area)
-            p.drawLine(d->mousePressPoint, d->mouseCurrPoint);
+              double dMod = fmod(gridRect.top(), d->dHLineStep);
+              d->dHLineStart = gridRect.top() - dMod;
+            }
+          else
+            d->dHLineStart = d->iHLineCount = 0;
         }
 
-      // Draw grid if enabled
-      if (d->bDrawGrid)
+      // Calculate vertical lines if necessary
+      if (gridRect.left() != d->previousGridRect.left() ||
+          gridRect.right() != d->previousGridRect.right())
         {
-          QRectF gridRect = QRectF(d->pixelSize.width() * d->visibleArea.x(),
-                                   d->pixelSize.height() * d->visibleArea.y(),
-                                   d->pixelSize.width() * d->visibleArea.width(),
-                                   d->pixelSize.height() * d->visibleArea.height());
-          double w = gridRect.width();
-          double h = gridRect.height();
-
-          // Calculate horizontal lines if necessary
-          if (gridRect.top() != d->previousGridRect.top() ||
-              gridRect.bottom() != d->previousGridRect.bottom())
+          d->dVLineStep = d->pAdapter->gridSpacing(d->dXScale/d->pixelSize.width(), Pii::Horizontally);
+          if (d->dVLineStep > 0)
             {
-              d->dHLineStep = d->pAdapter->gridSpacing(d->dYScale/d->pixelSize.height(), Pii::Vertically);
-              if (d->dHLineStep > 0)
-                {
-                  d->iHLineCount = h / d->dHLineStep + 2;
-
-                  double dMod = fmod(gridRect.top(), d->dHLineStep);
-                  d->dHLineStart = gridRect.top() - dMod;
-                }
-              else
-                d->dHLineStart = d->iHLineCount = 0;
-            }
+              d->iVLineCount = w / d->dVLineStep + 2;
 
-          // Calculate vertical lines if necessary
-          if (gridRect.left() != d->previousGridRect.left() ||
-              gridRect.right() != d->previousGridRect.right())
-            {
-              d->dVLineStep = d->pAdapter->gridSpacing(d->dXScale/d->pixelSize.width(), Pii::Horizontally);
-              if (d->dVLineStep > 0)
-                {
-                  d->iVLineCount = w / d->dVLineStep + 2;
-
-                  double dMod = fmod(gridRect.left(), d->dVLineStep);
-                  d->dVLineStart = gridRect.left() - dMod;
-                }
-              else
-                d->dVLineStart = d->iVLineCount = 0;
+              double dMod = fmod(gridRect.left(), d->dVLineStep);
+              d->dVLineStart = gridRect.left() - dMod;
             }
-          d->previousGridRect = gridRect;
+          else
+            d->dVLineStart = d->iVLineCount = 0;
+        }
+      d->previousGridRect = gridRect;
 
-          QPen pen(Qt::DotLine);
-          pen.setColor(QColor(130,130,130));
-          p.setPen(pen);
-          p.setBrush(Qt::NoBrush);
+      QPen pen(Qt::DotLine);
+      pen.setColor(QColor(130,130,130));
+      p.setPen(pen);
+      p.setBrush(Qt::NoBrush);
 
-          // Draw horizontal grid lines
-          for (int i=0; i<d->iHLineCount; i++)
-            {
-              double y = d->dYScale * ((d->dHLineStart + (double)i*d->dHLineStep) / d->pixelSize.height() - (double)d->visibleArea.y());
-              p.drawLine(QLineF(0, y, width(), y));
-            }
-
-          // Draw vertical grid lines
-          for (int i=0; i<d->iVLineCount; i++)
-            {
-              double x = d->dXScale * ((d->dVLineStart + (double)i*d->dVLineStep) / d->pixelSize.width() - (double)d->visibleArea.x());
-              p.drawLine(QLineF(x, 0, x, height()));
-            }
+      // Draw horizontal grid lines
+      for (int i=0; i<d->iHLineCount; i++)
+        {
+          double y = d->dYScale * ((d->dHLineStart + (double)i*d->dHLineStep) / d->pixelSize.height() - (double)d->visibleArea.y());
+          p.drawLine(QLineF(0, y, width(), y));
         }
 
+      // Draw vertical grid lines
+      for (int i=0; i<d->iVLineCount; i++)
+        {
+          double x = d->dXScale * ((d->dVLineStart + (double)i*d->dVLineStep) / d->pixelSize.width() - (double)d->visibleArea.x());
+          p.drawLine(QLineF(x, 0, x, height()));
+        }
     }
-  else
-    d->imageLock.unlock();
-
 }
 
 double PiiImageViewport::gridSpacing(double pixelsPerUnit, Pii::MatrixDirection) const
@@ -836,6 +892,10 @@ void PiiImageViewport::resizeEvent(QResizeEvent* event)
       checkFitMode();
     }
   focusImage(PiiImageViewport::FocusToWidgetTopLeft);
+#ifdef PII_IMAGEVIEWPORT_GL
+  if (d->pGLView != 0)
+    d->pGLView->setGeometry(rect());
+#endif
   setUpdatesEnabled(true);
   QWidget::resizeEvent(event);
   updateImage();
@@ -857,7 +917,7 @@ void PiiImageViewport::wheelEvent(QWheelEvent* event)
 
 void PiiImageViewport::showEvent(QShowEvent* event)
 {
-  d->pUpdater->setEnabled(true);
+  d->pUpdater->setEnabled(d->pGLView == 0);
   QWidget::showEvent(event);
   updateImage();
 }
@@ -1170,7 +1230,17 @@ double PiiImageViewport::zoom() const { return d->dZoomFactor; }
 double PiiImageViewport::xScale() const { return d->dXScale; }
 double PiiImageViewport::yScale() const { return d->dYScale; }
 QSizeF PiiImageViewport::pixelSize() const {  return d->pixelSize; }
-void PiiImageViewport::updateImage() { d->pUpdater->refresh(); }
+void PiiImageViewport::updateImage()
+{
+#ifdef PII_IMAGEVIEWPORT_GL
+  if (d->pGLView != 0)
+    {
+      d->pGLView->update();
+      return;
+    }
+#endif
+  d->pUpdater->refresh();
+}
 
 /************************* PiiImageViewportUpdater **************************/
 PiiImageViewportUpdater::PiiImageViewportUpdater(PiiImageViewport* parent) :
@@ -27,9 +27,11 @@
 
 class QAction;
 class QMenu;
+class QPainter;
 class PiiImageOverlay;
 class PiiRectangleOverlay;
 class PiiImageViewport;
+class PiiImageViewportGL;
 
 /**
  * @internal
@@ -157,8 +159,20 @@ class PII_GUI_EXPORT PiiImageViewport : public QWidget, public PiiImageViewportA
    */
   Q_PROPERTY(bool drawGrid READ drawGrid WRITE setDrawGrid);
 
+  /**
+   * Render the image with OpenGL. If enabled, the layers are kept as
+   * textures in the GPU, and zooming and panning don't rescale the
+   * image on the CPU. When a new frame arrives, only the changed
+   * parts of the image are transferred. Overlays are drawn with the
+   * OpenGL paint engine. The default is `false`. The property
+   * cannot be enabled if Into was built without OpenGL support
+   * (requires Qt 5.4).
+   */
+  Q_PROPERTY(bool openGLEnabled READ isOpenGLEnabled WRITE setOpenGLEnabled);
+
   friend class PiiImageScrollArea;
   friend class PiiImageViewportUpdater;
+  friend class PiiImageViewportGL;
 
 public:
   /**
@@ -325,6 +339,9 @@ public:
   void setDrawGrid(bool drawGrid);
   bool drawGrid() const;
 
+  void setOpenGLEnabled(bool openGLEnabled);
+  bool isOpenGLEnabled() const;
+
   QString toolTipForPoint(const QPoint& point) const;
   QString toolTipForSelection(const QRect& area) const;
   QMenu* popupMenu(const QPoint& point) const;
@@ -583,6 +600,8 @@ protected:
 
     PiiImageViewportUpdater* pUpdater;
     PiiImageViewportAdapter* pAdapter;
+    // OpenGL rendering back-end, or zero in software mode.
+    PiiImageViewportGL* pGLView;
 
     SelectionMode selectionMode;
 
@@ -627,6 +646,9 @@ private:
 
   QString formatToolTipText(const QString& text) const;
 
+  void paintDecorations(QPainter& p);
+  void updateDecorations();
+
   QRect startRendering();
   void endRendering(QRect visibleArea);
 };
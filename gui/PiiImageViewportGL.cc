@@ -0,0 +1,265 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImageViewportGL.h"
+
+#ifdef PII_IMAGEVIEWPORT_GL
+
+#include "PiiImageViewport.h"
+
+#include <QOpenGLContext>
+#include <QMatrix4x4>
+#include <QPainter>
+#include <cstring>
+
+static const char* pVertexShader =
+  "attribute highp vec2 vertex;\n"
+  "attribute highp vec2 texCoord;\n"
+  "uniform highp mat4 matrix;\n"
+  "varying highp vec2 tc;\n"
+  "void main()\n"
+  "{\n"
+  "  tc = texCoord;\n"
+  "  gl_Position = matrix * vec4(vertex, 0.0, 1.0);\n"
+  "}\n";
+
+static const char* pFragmentShader =
+  "uniform sampler2D tile;\n"
+  "uniform lowp float opacity;\n"
+  "varying highp vec2 tc;\n"
+  "void main()\n"
+  "{\n"
+  "  lowp vec4 color = texture2D(tile, tc);\n"
+  "  gl_FragColor = vec4(color.rgb, color.a * opacity);\n"
+  "}\n";
+
+PiiImageViewportGL::PiiImageViewportGL(PiiImageViewport* parent) :
+  QOpenGLWidget(parent),
+  _pViewport(parent),
+  _pProgram(0)
+{
+  // Mouse and keyboard events go to the viewport underneath.
+  setAttribute(Qt::WA_TransparentForMouseEvents);
+  setFocusPolicy(Qt::NoFocus);
+}
+
+PiiImageViewportGL::~PiiImageViewportGL()
+{
+  releaseTextures();
+  qDeleteAll(_vecTiles);
+}
+
+void PiiImageViewportGL::initializeGL()
+{
+  initializeOpenGLFunctions();
+  connect(context(), SIGNAL(aboutToBeDestroyed()), this, SLOT(releaseTextures()), Qt::DirectConnection);
+
+  _pProgram = new QOpenGLShaderProgram;
+  _pProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, pVertexShader);
+  _pProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, pFragmentShader);
+  _pProgram->bindAttributeLocation("vertex", 0);
+  _pProgram->bindAttributeLocation("texCoord", 1);
+  _pProgram->link();
+}
+
+void PiiImageViewportGL::releaseTextures()
+{
+  if (_pProgram == 0)
+    return;
+
+  makeCurrent();
+  for (int i=0; i<_vecTiles.size(); ++i)
+    {
+      Tiles* pTiles = _vecTiles[i];
+      if (!pTiles->vecTextures.isEmpty())
+        glDeleteTextures(pTiles->vecTextures.size(), pTiles->vecTextures.constData());
+      *pTiles = Tiles();
+    }
+  delete _pProgram;
+  _pProgram = 0;
+  doneCurrent();
+}
+
+void PiiImageViewportGL::resizeTiles(int count)
+{
+  while (_vecTiles.size() > count)
+    {
+      Tiles* pTiles = _vecTiles.takeLast();
+      if (!pTiles->vecTextures.isEmpty())
+        glDeleteTextures(pTiles->vecTextures.size(), pTiles->vecTextures.constData());
+      delete pTiles;
+    }
+  while (_vecTiles.size() < count)
+    _vecTiles << new Tiles;
+}
+
+bool PiiImageViewportGL::tileChanged(const QImage& previous, const QImage& current, const QRect& rect)
+{
+  const int iDepth = current.depth();
+  if (iDepth < 8)
+    return true;
+
+  const int iOffset = rect.x() * iDepth / 8, iBytes = rect.width() * iDepth / 8;
+  for (int y=rect.top(); y<=rect.bottom(); ++y)
+    if (std::memcmp(previous.constScanLine(y) + iOffset, current.constScanLine(y) + iOffset, iBytes) != 0)
+      return true;
+  return false;
+}
+
+void PiiImageViewportGL::uploadTile(GLuint texture, const QImage& image, const QRect& rect, bool allocate)
+{
+  QImage tile = image.copy(rect).convertToFormat(QImage::Format_RGBA8888);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if (allocate)
+    {
+      // Edge tiles are not powers of two. OpenGL ES only accepts
+      // them with clamping and without mipmaps.
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tile.width(), tile.height(), 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, tile.constBits());
+    }
+  else
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile.width(), tile.height(),
+                    GL_RGBA, GL_UNSIGNED_BYTE, tile.constBits());
+}
+
+void PiiImageViewportGL::uploadLayer(Tiles& tiles, const QImage& image)
+{
+  // The same image has already been uploaded.
+  if (!tiles.vecTextures.isEmpty() && image.cacheKey() == tiles.image.cacheKey())
+    return;
+
+  // If the size and format are unchanged, the textures can be
+  // reused, and only changed tiles need to be transferred.
+  const bool bReuse = !tiles.vecTextures.isEmpty() &&
+    image.size() == tiles.image.size() &&
+    image.format() == tiles.image.format();
+
+  if (!bReuse)
+    {
+      if (!tiles.vecTextures.isEmpty())
+        glDeleteTextures(tiles.vecTextures.size(), tiles.vecTextures.constData());
+      tiles.iColumns = (image.width() + TileSize - 1) / TileSize;
+      tiles.iRows = (image.height() + TileSize - 1) / TileSize;
+      tiles.vecTextures.resize(tiles.iColumns * tiles.iRows);
+      glGenTextures(tiles.vecTextures.size(), tiles.vecTextures.data());
+    }
+
+  for (int r=0; r<tiles.iRows; ++r)
+    for (int c=0; c<tiles.iColumns; ++c)
+      {
+        QRect tileRect = QRect(c * TileSize, r * TileSize, TileSize, TileSize) & image.rect();
+        if (!bReuse || tileChanged(tiles.image, image, tileRect))
+          uploadTile(tiles.vecTextures[r * tiles.iColumns + c], image, tileRect, !bReuse);
+      }
+
+  // Keep a shallow copy. If the owner of the image modifies it in
+  // place, the copy detaches and the next frame is compared against
+  // the pixels that are in the textures.
+  tiles.image = image;
+}
+
+void PiiImageViewportGL::drawLayer(const Tiles& tiles, const QRect& visibleArea, double opacity, GLint filter)
+{
+  _pProgram->setUniformValue("opacity", GLfloat(opacity));
+  static const GLfloat texCoords[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+  _pProgram->setAttributeArray(1, texCoords, 2);
+
+  const QRect imageRect = tiles.image.rect();
+  for (int r=0; r<tiles.iRows; ++r)
+    for (int c=0; c<tiles.iColumns; ++c)
+      {
+        QRect tileRect = QRect(c * TileSize, r * TileSize, TileSize, TileSize) & imageRect;
+        if (!tileRect.intersects(visibleArea))
+          continue;
+
+        const GLfloat x0 = tileRect.x(), y0 = tileRect.y(),
+          x1 = x0 + tileRect.width(), y1 = y0 + tileRect.height();
+        const GLfloat vertices[] = { x0, y0, x1, y0, x0, y1, x1, y1 };
+        _pProgram->setAttributeArray(0, vertices, 2);
+
+        glBindTexture(GL_TEXTURE_2D, tiles.vecTextures[r * tiles.iColumns + c]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+      }
+}
+
+void PiiImageViewportGL::paintGL()
+{
+  PiiImageViewport::Data* d = _pViewport->d;
+
+  QPainter p(this);
+  p.beginNativePainting();
+
+  QColor background = _pViewport->palette().color(_pViewport->backgroundRole());
+  glClearColor(background.redF(), background.greenF(), background.blueF(), 1);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  d->imageLock.lock();
+  resizeTiles(d->lstLayers.size());
+  const QImage* pBase = d->lstLayers[0]->pImage;
+  const bool bHasImage = !pBase->isNull();
+  if (bHasImage && _pProgram != 0)
+    {
+      // Same placement as in the software path: the visible portion
+      // is centered if it is smaller than the widget.
+      QRect visibleImageArea = d->visibleArea & pBase->rect();
+      int iDrawWidth = int(d->dXScale * visibleImageArea.width()),
+        iDrawHeight = int(d->dYScale * visibleImageArea.height());
+
+      QMatrix4x4 matrix;
+      matrix.ortho(0, width(), height(), 0, -1, 1);
+      matrix.translate((width() - iDrawWidth) / 2, (height() - iDrawHeight) / 2);
+      matrix.scale(d->dXScale, d->dYScale);
+      matrix.translate(-visibleImageArea.x(), -visibleImageArea.y());
+
+      // Show individual pixels when zoomed in, as QPainter does.
+      const GLint filter = d->dZoomFactor >= 1.0 ? GL_NEAREST : GL_LINEAR;
+
+      _pProgram->bind();
+      _pProgram->setUniformValue("matrix", matrix);
+      _pProgram->setUniformValue("tile", 0);
+      _pProgram->enableAttributeArray(0);
+      _pProgram->enableAttributeArray(1);
+      glActiveTexture(GL_TEXTURE0);
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+      for (int i=0; i<d->lstLayers.size(); ++i)
+        {
+          const PiiImageViewport::Layer* pLayer = d->lstLayers[i];
+          if (pLayer->pImage->isNull() || !pLayer->bVisible)
+            continue;
+          uploadLayer(*_vecTiles[i], *pLayer->pImage);
+          drawLayer(*_vecTiles[i], visibleImageArea, pLayer->dOpacity, filter);
+        }
+
+      glDisable(GL_BLEND);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      _pProgram->disableAttributeArray(0);
+      _pProgram->disableAttributeArray(1);
+      _pProgram->release();
+    }
+  d->imageLock.unlock();
+
+  p.endNativePainting();
+
+  if (bHasImage)
+    _pViewport->paintDecorations(p);
+}
+
+#endif // PII_IMAGEVIEWPORT_GL
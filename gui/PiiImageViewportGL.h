@@ -0,0 +1,90 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEVIEWPORTGL_H
+#define _PIIIMAGEVIEWPORTGL_H
+
+#include <QtGlobal>
+
+#if QT_VERSION >= 0x050400 && !defined(QT_NO_OPENGL)
+#  define PII_IMAGEVIEWPORT_GL 1
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QImage>
+#include <QVector>
+
+class PiiImageViewport;
+
+/**
+ * @internal
+ *
+ * An OpenGL rendering back-end for PiiImageViewport. The widget
+ * covers the viewport and is transparent for mouse events. Each
+ * layer is uploaded into the GPU as a grid of fixed-size textures.
+ * Zooming and panning only change the transformation, and a new
+ * frame of the same size and format only re-uploads the tiles whose
+ * pixels actually changed. Overlays, the selection and the grid are
+ * painted on top of the textures with the OpenGL paint engine in
+ * the same pass.
+ *
+ * The back-end is enabled with PiiImageViewport::setOpenGLEnabled().
+ * It requires Qt 5.4 or newer.
+ */
+class PiiImageViewportGL : public QOpenGLWidget, protected QOpenGLFunctions
+{
+  Q_OBJECT
+
+public:
+  PiiImageViewportGL(PiiImageViewport* parent);
+  ~PiiImageViewportGL();
+
+  /// The side length of a texture tile, in pixels.
+  enum { TileSize = 512 };
+
+protected:
+  void initializeGL();
+  void paintGL();
+
+private slots:
+  void releaseTextures();
+
+private:
+  struct Tiles
+  {
+    Tiles() : iColumns(0), iRows(0) {}
+
+    // A shallow copy of the uploaded image. Used for detecting
+    // changed tiles.
+    QImage image;
+    int iColumns, iRows;
+    QVector<GLuint> vecTextures;
+  };
+
+  void uploadLayer(Tiles& tiles, const QImage& image);
+  void uploadTile(GLuint texture, const QImage& image, const QRect& rect, bool allocate);
+  void drawLayer(const Tiles& tiles, const QRect& visibleArea, double opacity, GLint filter);
+  void resizeTiles(int count);
+  static bool tileChanged(const QImage& previous, const QImage& current, const QRect& rect);
+
+  PiiImageViewport* _pViewport;
+  QOpenGLShaderProgram* _pProgram;
+  QVector<Tiles*> _vecTiles;
+};
+
+#endif // QT_VERSION >= 0x050400
+
+#endif //_PIIIMAGEVIEWPORTGL_H
@@ -31,22 +31,61 @@
 #include <QDoubleValidator>
 #include <QItemSelectionModel>
 #include <QAbstractItemView>
-
+#include <QTimer>
 PiiTableModel::Data::Data(PiiTableModel* model) :
   pDelegate(new PiiTableModelDelegate(model)),
+  iRows(0),
   bCanDeleteLast(true),
   iLastInsertRow(-1),
-  iInsertCount(0)
+  iInsertCount(0),
+  pBatchTimer(new QTimer(model)),
+  iBatchInterval(100)
 {
-  // Create an empty header. First row in lstItems is the header.
-  // Table data starts at row 1.
-  lstItems << QList<PiiModelItem*>();
+  pBatchTimer->setSingleShot(true);
 }
 
 PiiTableModel::Data::~Data()
 {
   // Delete header
-  qDeleteAll(lstItems[0]);
+  qDeleteAll(lstHeader);
+}
+
+void PiiTableModel::Data::Column::insert(int row, int count)
+{
+  vecTexts.insert(row, count, QVariant());
+  vecValues.insert(row, count, QVariant());
+  vecItems.insert(row, count, 0);
+}
+
+void PiiTableModel::Data::Column::remove(int row, int count)
+{
+  for (int r=row; r<row+count; ++r)
+    delete vecItems[r];
+  vecTexts.remove(row, count);
+  vecValues.remove(row, count);
+  vecItems.remove(row, count);
+}
+
+void PiiTableModel::Data::Column::setItem(int row, PiiModelItem* item)
+{
+  delete vecItems[row];
+  vecItems[row] = item;
+  vecTexts[row] = QVariant();
+  vecValues[row] = QVariant();
+}
+
+void PiiTableModel::Data::insertCells(int row, int count)
+{
+  for (int c=0; c<vecColumns.size(); ++c)
+    vecColumns[c].insert(row, count);
+  iRows += count;
+}
+
+void PiiTableModel::Data::removeCells(int row, int count)
+{
+  for (int c=0; c<vecColumns.size(); ++c)
+    vecColumns[c].remove(row, count);
+  iRows -= count;
 }
 
 PiiTableModel::PiiTableModel(QAbstractItemView *parent) :
@@ -71,6 +110,7 @@ void PiiTableModel::initialize(QAbstractItemView* parent)
           SIGNAL(currentItemChanged()));
   connect(pSelectionModel, SIGNAL(selectionChanged(QItemSelection,QItemSelection)),
           SLOT(enableControls()));
+  connect(d->pBatchTimer, SIGNAL(timeout()), SLOT(flushQueuedRows()));
   parent->setItemDelegate(d->pDelegate);
   parent->setSelectionBehavior(QAbstractItemView::SelectRows);
 }
@@ -84,13 +124,12 @@ PiiTableModel::~PiiTableModel()
 
 void PiiTableModel::clear()
 {
+  d->lstQueuedRows.clear();
+  d->pBatchTimer->stop();
+
   beginResetModel();
-  QList<PiiModelItem*> lstHeader = d->lstItems.first();
   // Delete everything except the header
-  for (int i=1; i<d->lstItems.size(); ++i)
-    qDeleteAll(d->lstItems[i]);
-  d->lstItems.clear();
-  d->lstItems.append(lstHeader);
+  d->removeCells(0, d->rows());
   endResetModel();
 
   enableControls();
@@ -101,13 +140,7 @@ void PiiTableModel::beginInsertRows(int row, int count)
   row = qBound(0,row,d->rows());
   QAbstractTableModel::beginInsertRows(QModelIndex(), row, row+count-1);
 
-  d->lstItems.reserve(d->lstItems.size() + count);
-
-  for (int i=0; i<count; ++i)
-    d->lstItems.append(QList<PiiModelItem*>());
-
-  for (int i=d->lstItems.size()-1; i>row+count; --i)
-    d->lstItems[i] = d->lstItems[i-count];
+  d->insertCells(row, count);
 
   d->iInsertCount = count;
   d->iLastInsertRow = row+count;
@@ -138,9 +171,9 @@ void PiiTableModel::insertRow(const QList<PiiModelItem*>& items)
       return;
     }
 
-  int iIndex = d->iLastInsertRow-d->iInsertCount+1;
-  qDeleteAll(d->lstItems[iIndex]);
-  d->lstItems[iIndex] = items;
+  int iRow = d->iLastInsertRow-d->iInsertCount;
+  for (int c=0; c<items.size(); ++c)
+    d->vecColumns[c].setItem(iRow, items[c]);
   --d->iInsertCount;
 }
 
@@ -157,16 +190,84 @@ void PiiTableModel::insertRow(const QList<PiiModelItem*>& items, int row)
     row = d->rows();
 
   QAbstractTableModel::beginInsertRows(QModelIndex(), row, row);
-  d->lstItems.insert(row+1, items);
+  d->insertCells(row, 1);
+  for (int c=0; c<items.size(); ++c)
+    d->vecColumns[c].vecItems[row] = items[c];
+  QAbstractTableModel::endInsertRows();
+}
+
+void PiiTableModel::appendRows(const QList<QVariantList>& rows)
+{
+  const int iColumns = d->columns();
+  if (rows.isEmpty() || iColumns == 0)
+    return;
+
+  const int iFirstRow = d->rows();
+  QAbstractTableModel::beginInsertRows(QModelIndex(), iFirstRow, iFirstRow + rows.size() - 1);
+  d->insertCells(iFirstRow, rows.size());
+  // Only the value and its text are stored. Items will be created
+  // once somebody needs them.
+  for (int c=0; c<iColumns; ++c)
+    {
+      Data::Column& column = d->vecColumns[c];
+      const QVariant varDefault(defaultValue(c));
+      const QString strDefault(textForValue(c, varDefault));
+      for (int r=0; r<rows.size(); ++r)
+        {
+          if (c < rows[r].size())
+            {
+              column.vecValues[iFirstRow + r] = rows[r][c];
+              column.vecTexts[iFirstRow + r] = textForValue(c, rows[r][c]);
+            }
+          else if (varDefault.isValid())
+            {
+              column.vecValues[iFirstRow + r] = varDefault;
+              column.vecTexts[iFirstRow + r] = strDefault;
+            }
+        }
+    }
   QAbstractTableModel::endInsertRows();
+  enableControls();
+}
+
+void PiiTableModel::queueRow(const QVariantList& values)
+{
+  d->lstQueuedRows << values;
+  if (!d->pBatchTimer->isActive())
+    d->pBatchTimer->start(d->iBatchInterval);
+}
+
+void PiiTableModel::flushQueuedRows()
+{
+  d->pBatchTimer->stop();
+  QList<QVariantList> lstRows;
+  lstRows.swap(d->lstQueuedRows);
+  appendRows(lstRows);
+}
+
+void PiiTableModel::setBatchInterval(int batchInterval)
+{
+  d->iBatchInterval = qMax(0, batchInterval);
+}
+
+int PiiTableModel::batchInterval() const
+{
+  return d->iBatchInterval;
 }
 
 QList<PiiModelItem*> PiiTableModel::takeRow(int row)
 {
   if (row >= 0 && row < d->rows())
     {
+      QList<PiiModelItem*> lstRow;
+      for (int c=0; c<d->columns(); ++c)
+        {
+          lstRow << itemAt(row, c);
+          // The caller owns the item now.
+          d->vecColumns[c].vecItems[row] = 0;
+        }
       beginRemoveRows(QModelIndex(), row, row);
-      QList<PiiModelItem*> lstRow = d->lstItems.takeAt(row+1);
+      d->removeCells(row, 1);
       endRemoveRows();
       enableControls();
       return lstRow;
@@ -184,6 +285,41 @@ int PiiTableModel::columnCount(const QModelIndex &parent) const
   return parent.isValid() ? 0 : d->columns();
 }
 
+QVariant PiiTableModel::cellData(int row, int column, int role) const
+{
+  const Data::Column& col = d->vecColumns[column];
+  PiiModelItem* pItem = col.vecItems[row];
+  if (pItem == 0)
+    {
+      // Text and value don't need an item.
+      if (role == Qt::DisplayRole)
+        return col.vecTexts[row];
+      if (role == ColumnEditorValueRole)
+        return col.vecValues[row];
+      pItem = itemAt(row, column);
+    }
+  return pItem->data(role);
+}
+
+void PiiTableModel::setCellData(int row, int column, const QVariant& value, int role)
+{
+  Data::Column& col = d->vecColumns[column];
+  if (col.vecItems[row] == 0)
+    {
+      if (role == Qt::DisplayRole)
+        {
+          col.vecTexts[row] = value;
+          return;
+        }
+      if (role == ColumnEditorValueRole)
+        {
+          col.vecValues[row] = value;
+          return;
+        }
+    }
+  itemAt(row, column)->setData(role, value);
+}
+
 QVariant PiiTableModel::data(const QModelIndex &index, int role) const
 {
   const int iRow = index.row(), iCol = index.column();
@@ -191,7 +327,7 @@ QVariant PiiTableModel::data(const QModelIndex &index, int role) const
       iRow < 0 || iRow >= d->rows() ||
       iCol < 0 || iCol >= d->columns())
     return QVariant();
-  return d->lstItems[iRow+1][iCol]->data(role);
+  return cellData(iRow, iCol, role);
 }
 
 bool PiiTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
@@ -201,7 +337,7 @@ bool PiiTableModel::setData(const QModelIndex &index, const QVariant &value, int
       iRow < 0 || iRow >= d->rows() ||
       iCol < 0 || iCol >= d->columns())
     return false;
-  d->lstItems[iRow+1][iCol]->setData(role, value);
+  setCellData(iRow, iCol, value, role);
   emit dataChanged(index, index);
   return true;
 }
@@ -211,23 +347,37 @@ PiiModelItem* PiiTableModel::itemAt(int row, int column) const
   if (row < 0 || row >= d->rows() ||
       column < 0 || column >= d->columns())
     return 0;
-  return d->lstItems[row+1][column];
+  Data::Column& col = d->vecColumns[column];
+  PiiModelItem*& pItem = col.vecItems[row];
+  if (pItem == 0)
+    {
+      // Create the item on first use and move the stored text and
+      // value into it.
+      pItem = const_cast<PiiTableModel*>(this)->createItem(row, column);
+      if (col.vecTexts[row].isValid())
+        pItem->setData(Qt::DisplayRole, col.vecTexts[row]);
+      if (col.vecValues[row].isValid())
+        pItem->setData(ColumnEditorValueRole, col.vecValues[row]);
+      col.vecTexts[row] = QVariant();
+      col.vecValues[row] = QVariant();
+    }
+  return pItem;
 }
 
 QVariant PiiTableModel::data(int row, int column, int role) const
 {
-  PiiModelItem* pItem = itemAt(row, column);
-  if (pItem != 0)
-    return pItem->data(role);
-  return QVariant();
+  if (row < 0 || row >= d->rows() ||
+      column < 0 || column >= d->columns())
+    return QVariant();
+  return cellData(row, column, role);
 }
 
 void PiiTableModel::setData(int row, int column, const QVariant& value, int role)
 {
-  PiiModelItem* pItem = itemAt(row, column);
-  if (pItem != 0)
+  if (row >= 0 && row < d->rows() &&
+      column >= 0 && column < d->columns())
     {
-      pItem->setData(role, value);
+      setCellData(row, column, value, role);
       QModelIndex idx = index(row, column);
       emit dataChanged(idx, idx);
     }
@@ -235,12 +385,12 @@ void PiiTableModel::setData(int row, int column, const QVariant& value, int role
 
 void PiiTableModel::setValue(int row, int column, const QVariant& value, ValueChangeBehavior behavior)
 {
-  PiiModelItem* pItem = itemAt(row, column);
-  if (pItem != 0)
+  if (row >= 0 && row < d->rows() &&
+      column >= 0 && column < d->columns())
     {
-      pItem->setData(ColumnEditorValueRole, value);
+      setCellData(row, column, value, ColumnEditorValueRole);
       if (behavior == ChangeTextAutomatically)
-        pItem->setText(textForValue(column, value));
+        setCellData(row, column, textForValue(column, value), Qt::DisplayRole);
       QModelIndex idx = index(row, column);
       emit dataChanged(idx, idx);
     }
@@ -255,7 +405,7 @@ QMap<int, QVariant> PiiTableModel::itemData(const QModelIndex &index) const
       iCol < 0 || iCol >= d->columns())
     return QMap<int, QVariant>();
 
-  return d->lstItems[iRow+1][iCol]->dataMap();
+  return itemAt(iRow, iCol)->dataMap();
 }
 
 Qt::ItemFlags PiiTableModel::flags(const QModelIndex &index) const
@@ -265,7 +415,7 @@ Qt::ItemFlags PiiTableModel::flags(const QModelIndex &index) const
       iRow < 0 || iRow >= d->rows() ||
       iCol < 0 || iCol >= d->columns())
     return Qt::ItemIsDropEnabled; // allow drops outside of the items
-  return d->lstItems[iRow+1][iCol]->flags();
+  return itemAt(iRow, iCol)->flags();
 }
 
 QVariant PiiTableModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -278,7 +428,7 @@ QVariant PiiTableModel::headerData(int section, Qt::Orientation orientation, int
   else
     {
       if (section >= 0 && section < d->columns())
-        return d->lstItems[0][section]->data(role);
+        return d->lstHeader[section]->data(role);
     }
   return QVariant();
 }
@@ -291,7 +441,7 @@ bool PiiTableModel::setHeaderData(int section, Qt::Orientation orientation, cons
   if (section >= 0 && section < d->columns())
     {
       // Set data
-      d->lstItems[0][section]->setData(role, value);
+      d->lstHeader[section]->setData(role, value);
       // Inform view
       emit headerDataChanged(orientation, section, section);
       return true;
@@ -311,8 +461,10 @@ bool PiiTableModel::insertRows(int row, int count, const QModelIndex &parent)
     return false;
 
   QAbstractTableModel::beginInsertRows(QModelIndex(), row, row + count - 1);
+  d->insertCells(row, count);
   for (int r = row; r < row + count; ++r)
-    d->lstItems.insert(r+1, createRow(r));
+    for (int c = 0; c < d->columns(); ++c)
+      d->vecColumns[c].vecItems[r] = createItem(r, c);
   QAbstractTableModel::endInsertRows();
   return true;
 }
@@ -333,8 +485,7 @@ bool PiiTableModel::removeRows(int row, int count, const QModelIndex &parent)
     return false;
 
   beginRemoveRows(QModelIndex(), row, row + count - 1);
-  for (int r = 0; r < count; ++r)
-    qDeleteAll(d->lstItems.takeAt(row+1));
+  d->removeCells(row, count);
   endRemoveRows();
   return true;
 }
@@ -346,8 +497,14 @@ bool PiiTableModel::insertColumns(int column, int count, const QModelIndex &pare
 
   beginInsertColumns(QModelIndex(), column, column + count - 1);
   for (int c = column; c < column + count; ++c)
-    for (int r = 0; r < d->lstItems.size(); ++r)
-      d->lstItems[r].insert(c, createItem(r-1, c));
+    {
+      d->lstHeader.insert(c, createItem(-1, c));
+      Data::Column col;
+      col.insert(0, d->rows());
+      for (int r = 0; r < d->rows(); ++r)
+        col.vecItems[r] = createItem(r, c);
+      d->vecColumns.insert(c, col);
+    }
   endInsertColumns();
   return true;
 }
@@ -359,8 +516,11 @@ bool PiiTableModel::removeColumns(int column, int count, const QModelIndex &pare
 
   beginRemoveColumns(QModelIndex(), column, column + count - 1);
   for (int c = 0; c < count; ++c)
-    for (int r = 0; r < d->lstItems.size(); ++r)
-      delete d->lstItems[r].takeAt(column);
+    {
+      delete d->lstHeader.takeAt(column);
+      d->vecColumns[column].remove(0, d->rows());
+      d->vecColumns.remove(column);
+    }
   endRemoveColumns();
   return true;
 }
@@ -523,20 +683,19 @@ void PiiTableModel::setModelData(QWidget* editor, int row, int column)
       column < 0 || column >= d->columns())
     return;
 
-  PiiModelItem* pItem = d->lstItems[row+1][column];
   switch (columnEditorType(column))
     {
     case LineEditor:
-      pItem->setData(Qt::DisplayRole, editor->property("text"));
+      setCellData(row, column, editor->property("text"), Qt::DisplayRole);
       break;
     case IntegerSpinBoxEditor:
     case DoubleSpinBoxEditor:
-      pItem->setData(Qt::DisplayRole, editor->property("text"));
-      pItem->setData(ColumnEditorValueRole, editor->property("value"));
+      setCellData(row, column, editor->property("text"), Qt::DisplayRole);
+      setCellData(row, column, editor->property("value"), ColumnEditorValueRole);
       break;
     case ComboBoxEditor:
-      pItem->setData(Qt::DisplayRole, editor->property("currentText"));
-      pItem->setData(ColumnEditorValueRole, editor->property("currentIndex"));
+      setCellData(row, column, editor->property("currentText"), Qt::DisplayRole);
+      setCellData(row, column, editor->property("currentIndex"), ColumnEditorValueRole);
       break;
     }
   QModelIndex idx(index(row, column));
@@ -554,12 +713,18 @@ QVariantList PiiTableModel::columnValues(int column) const
 
 void PiiTableModel::setColumnValues(int column, const QVariantList& values)
 {
-  if (d->rows() > values.size())
-    removeRows(values.size(), d->rows() - values.size());
-  else if (d->rows() < values.size())
-    insertRows(d->rows(), values.size() - d->rows());
+  if (column < 0 || column >= d->columns())
+    return;
+  const int iOldRows = d->rows();
+  resizeRows(values.size());
   for (int r=0; r<values.size(); ++r)
-    setValue(r, column, values[r]);
+    {
+      setCellData(r, column, values[r], ColumnEditorValueRole);
+      setCellData(r, column, textForValue(column, values[r]), Qt::DisplayRole);
+    }
+  // New rows have already been announced.
+  if (qMin(iOldRows, values.size()) > 0)
+    emit dataChanged(index(0, column), index(qMin(iOldRows, values.size())-1, column));
 }
 
 QStringList PiiTableModel::columnTexts(int column) const
@@ -572,12 +737,24 @@ QStringList PiiTableModel::columnTexts(int column) const
 
 void PiiTableModel::setColumnTexts(int column, const QStringList& texts)
 {
-  if (d->rows() > texts.size())
-    removeRows(texts.size(), d->rows() - texts.size());
-  else if (d->rows() < texts.size())
-    insertRows(d->rows(), texts.size() - d->rows());
+  if (column < 0 || column >= d->columns())
+    return;
+  const int iOldRows = d->rows();
+  resizeRows(texts.size());
   for (int r=0; r<texts.size(); ++r)
-    setText(r, column, texts[r]);
+    setCellData(r, column, texts[r], Qt::DisplayRole);
+  if (qMin(iOldRows, texts.size()) > 0)
+    emit dataChanged(index(0, column), index(qMin(iOldRows, texts.size())-1, column));
+}
+
+void PiiTableModel::resizeRows(int rows)
+{
+  if (d->rows() > rows)
+    removeRows(rows, d->rows() - rows);
+  else if (d->rows() < rows)
+    // Added rows contain default values, but their items will be
+    // created only when needed.
+    appendRows(QVector<QVariantList>(rows - d->rows()).toList());
 }
 
 
@@ -21,9 +21,11 @@
 #include <QAbstractTableModel>
 #include <QAbstractItemView>
 #include <QList>
+#include <QVector>
 
 class PiiTableModelDelegate;
 class PiiModelItem;
+class QTimer;
 
 /**
  * A hybrid of a table model and an item "delegate". This model can be
@@ -46,6 +48,14 @@ class PiiModelItem;
  * but the cell displays the text associated with the index. See
  * [EditorType] for data types associated with editors.
  *
+ * The model stores its data column by column. Rows added with
+ * [appendRows()], [queueRow()], [setColumnValues()] and
+ * [setColumnTexts()] only store the value and text of each cell. A
+ * PiiModelItem is created with [createItem()] when the item is
+ * first needed, e.g. when a view asks for its flags or for a data
+ * role other than text and value. Views only do this for visible
+ * cells, which keeps large tables cheap. Reading texts and values
+ * never creates items.
  */
 class PII_GUI_EXPORT PiiTableModel : public QAbstractTableModel
 {
@@ -233,6 +243,31 @@ public:
   void insertRow(const QList<PiiModelItem*>& items, int row);
   void insertRow(const QList<PiiModelItem*>& items);
 
+  /**
+   * Appends *rows* to the end of the model with a single
+   * notification to views. Each element of *rows* contains the
+   * values (`ColumnEditorValueRole`) of one row. The displayed texts
+   * are created with [textForValue()]. Missing values are replaced by
+   * column default values. Items are not created until needed.
+   */
+  void appendRows(const QList<QVariantList>& rows);
+
+  /**
+   * Queues a row of *values* to be appended to the model. Queued rows
+   * are appended with [appendRows()] in one batch at most
+   * [batchInterval()] milliseconds after the first row was queued.
+   * Use this function when rows arrive one at a time at a high rate.
+   * [clear()] discards queued rows.
+   */
+  void queueRow(const QVariantList& values);
+
+  /**
+   * Sets the maximum time queued rows wait before they are appended
+   * to the model. The default is 100 ms.
+   */
+  void setBatchInterval(int batchInterval);
+  int batchInterval() const;
+
   /**
    * Removes `row` and returns its items as a list. The model no
    * longer owns the pointers, and they must be deleted by the caller.
@@ -451,6 +486,11 @@ public slots:
    * selected rows or the last row is selected.
    */
   void moveSelectedRowsDown();
+  /**
+   * Appends all rows queued with [queueRow()] to the model
+   * immediately.
+   */
+  void flushQueuedRows();
 
 private slots:
   void enableControls();
@@ -462,14 +502,38 @@ protected:
     Data(PiiTableModel* model);
     ~Data();
 
-    int rows() const { return lstItems.size()-1; }
-    int columns() const { return lstItems[0].size(); }
+    int rows() const { return iRows; }
+    int columns() const { return lstHeader.size(); }
+
+    /*
+     * The cells of one column. If vecItems[r] is zero, the text and
+     * value of the cell are in vecTexts[r] and vecValues[r].
+     * Otherwise the item holds all data.
+     */
+    struct Column
+    {
+      void insert(int row, int count);
+      void remove(int row, int count);
+      void setItem(int row, PiiModelItem* item);
+
+      QVector<QVariant> vecTexts;
+      QVector<QVariant> vecValues;
+      QVector<PiiModelItem*> vecItems;
+    };
+
+    void insertCells(int row, int count);
+    void removeCells(int row, int count);
 
     PiiTableModelDelegate* pDelegate;
-    QList<QList<PiiModelItem*> > lstItems;
+    QList<PiiModelItem*> lstHeader;
+    QVector<Column> vecColumns;
+    int iRows;
     bool bCanDeleteLast;
     int iLastInsertRow;
     int iInsertCount;
+    QList<QVariantList> lstQueuedRows;
+    QTimer* pBatchTimer;
+    int iBatchInterval;
   } *d;
 
   /**
@@ -504,6 +568,9 @@ private:
   friend class PiiTableModelDelegate;
 
   QList<PiiModelItem*> createRow(int row = -1);
+  QVariant cellData(int row, int column, int role) const;
+  void setCellData(int row, int column, const QVariant& value, int role);
+  void resizeRows(int rows);
   inline void selectRows(const QList<int>& rows);
   void selectRow(int row);
   inline QItemSelectionModel* selectionModel() const { return static_cast<QAbstractItemView*>(QObject::parent())->selectionModel(); }
@@ -15,6 +15,8 @@
 
 #include "PiiThumbnailListView.h"
 #include <QMenu>
+#include <QScrollBar>
+#include <QTimer>
 
 #include <QtDebug>
 
@@ -32,6 +34,9 @@ PiiThumbnailListView::PiiThumbnailListView(QWidget *parent) :
 
   connect(this, SIGNAL(activated(const QModelIndex&)), this, SLOT(itemSelected(const QModelIndex&)));
   connect(this, SIGNAL(clicked(const QModelIndex&)), this, SLOT(itemSelected(const QModelIndex&)));
+  // Load visible thumbnails first.
+  connect(horizontalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(schedulePrioritization()));
+  connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(schedulePrioritization()));
 }
 
 PiiThumbnailListView::~PiiThumbnailListView()
@@ -43,6 +48,52 @@ void PiiThumbnailListView::setModel(PiiImageListModel *model)
 {
   d->pModel = model;
   QListView::setModel(model);
+  if (model != 0)
+    {
+      connect(model, SIGNAL(layoutChanged()), this, SLOT(schedulePrioritization()));
+      connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this, SLOT(schedulePrioritization()));
+    }
+}
+
+void PiiThumbnailListView::resizeEvent(QResizeEvent *e)
+{
+  QListView::resizeEvent(e);
+  schedulePrioritization();
+}
+
+void PiiThumbnailListView::schedulePrioritization()
+{
+  // Scrolling produces bursts of signals. Handle them once the event
+  // loop is idle.
+  if (!d->bPrioritizationScheduled)
+    {
+      d->bPrioritizationScheduled = true;
+      QTimer::singleShot(0, this, SLOT(prioritizeVisibleThumbnails()));
+    }
+}
+
+void PiiThumbnailListView::prioritizeVisibleThumbnails()
+{
+  d->bPrioritizationScheduled = false;
+  if (d->pModel == 0)
+    return;
+
+  // Visible items are consecutive in the list.
+  QRect visibleRect = viewport()->rect();
+  int iRows = d->pModel->rowCount(QModelIndex()), iFirst = -1, iLast = -1;
+  for (int i=0; i<iRows; ++i)
+    {
+      if (visualRect(d->pModel->index(i, 0)).intersects(visibleRect))
+        {
+          if (iFirst == -1)
+            iFirst = i;
+          iLast = i;
+        }
+      else if (iFirst != -1)
+        break;
+    }
+  if (iFirst != -1)
+    d->pModel->prioritizeThumbnails(iFirst, iLast);
 }
 
 void PiiThumbnailListView::mousePressEvent(QMouseEvent *e)
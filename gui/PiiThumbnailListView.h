@@ -46,10 +46,13 @@ signals:
 
 protected:
   void mousePressEvent(QMouseEvent *e);
+  void resizeEvent(QResizeEvent *e);
 
 private slots:
   void removeCurrent();
   void itemSelected(const QModelIndex& index);
+  void schedulePrioritization();
+  void prioritizeVisibleThumbnails();
 
 private:
   void showMenu(const QPoint& point);
@@ -57,7 +60,9 @@ private:
   class Data
   {
   public:
+    Data() : pModel(0), bPrioritizationScheduled(false) {}
     PiiImageListModel *pModel;
+    bool bPrioritizationScheduled;
   } *d;
 };
 
@@ -16,41 +16,258 @@
 #include "PiiThumbnailLoader.h"
 #include <PiiQImage.h>
 
-PiiThumbnailLoader::PiiThumbnailLoader(QObject *parent) : QThread(parent), _bRunning(false)
+#include <QImageReader>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#if QT_VERSION >= 0x050000
+#  include <QStandardPaths>
+#else
+#  include <QDesktopServices>
+#endif
+
+namespace
+{
+  /* Reads unsigned integers from a TIFF structure with the byte
+   * order given in its header. Out-of-range reads return zero.
+   */
+  class TiffReader
+  {
+  public:
+    TiffReader(const QByteArray& data) :
+      _pData(reinterpret_cast<const uchar*>(data.constData())),
+      _iSize(data.size()),
+      _bLittleEndian(data.size() > 0 && data[0] == 'I')
+    {}
+
+    uint get16(uint offset) const
+    {
+      if (offset + 2 > _iSize) return 0;
+      const uchar* p = _pData + offset;
+      return _bLittleEndian ? (p[0] | p[1] << 8) : (p[0] << 8 | p[1]);
+    }
+
+    uint get32(uint offset) const
+    {
+      if (offset + 4 > _iSize) return 0;
+      return _bLittleEndian ?
+        (get16(offset) | get16(offset + 2) << 16) :
+        (get16(offset) << 16 | get16(offset + 2));
+    }
+
+    const uchar* data() const { return _pData; }
+    uint size() const { return _iSize; }
+
+  private:
+    const uchar* _pData;
+    uint _iSize;
+    bool _bLittleEndian;
+  };
+
+  /* Returns the thumbnail embedded in the EXIF data of a JPEG file,
+   * or a null image if there is none. The thumbnail is stored as a
+   * JPEG stream described by IFD1.
+   */
+  QImage readExifThumbnail(const QString& fileName)
+  {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.read(2) != "\xff\xd8")
+      return QImage();
+
+    // The APP1 marker is among the first application markers.
+    for (;;)
+      {
+        QByteArray marker = file.read(4);
+        if (marker.size() != 4 || uchar(marker[0]) != 0xff)
+          return QImage();
+        const uint iMarker = uchar(marker[1]),
+          iLength = uchar(marker[2]) << 8 | uchar(marker[3]);
+        if (iMarker < 0xe0 || iMarker > 0xef || iLength < 2)
+          return QImage();
+        if (iMarker != 0xe1)
+          {
+            if (!file.seek(file.pos() + iLength - 2))
+              return QImage();
+            continue;
+          }
+
+        QByteArray data = file.read(iLength - 2);
+        if (!data.startsWith(QByteArray("Exif\0\0", 6)))
+          continue;
+
+        TiffReader tiff(data.mid(6));
+        uint iIfd0 = tiff.get32(4);
+        uint iIfd1 = tiff.get32(iIfd0 + 2 + tiff.get16(iIfd0) * 12);
+        if (iIfd1 == 0)
+          return QImage();
+
+        uint iOffset = 0, iSize = 0;
+        const uint iEntries = tiff.get16(iIfd1);
+        for (uint i=0; i<iEntries; ++i)
+          {
+            const uint iEntry = iIfd1 + 2 + i*12;
+            switch (tiff.get16(iEntry))
+              {
+              case 0x0201: iOffset = tiff.get32(iEntry + 8); break; // JPEGInterchangeFormat
+              case 0x0202: iSize = tiff.get32(iEntry + 8); break; // JPEGInterchangeFormatLength
+              }
+          }
+        if (iOffset == 0 || iSize == 0 || iOffset + iSize > tiff.size())
+          return QImage();
+
+        QImage thumbnail;
+        thumbnail.loadFromData(tiff.data() + iOffset, int(iSize), "JPEG");
+        return thumbnail;
+      }
+  }
+
+  QString defaultCacheDirectory()
+  {
+#if QT_VERSION >= 0x050000
+    QString strBase = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString strBase = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    if (strBase.isEmpty())
+      return QString();
+    return strBase + "/thumbnails";
+  }
+}
+
+PiiThumbnailLoader::PiiThumbnailLoader(QObject *parent) :
+  QObject(parent),
+  _bRunning(false),
+  _iWorkerCount(QThread::idealThreadCount()),
+  _thumbnailSize(70,90)
+{
+  if (_iWorkerCount < 1)
+    _iWorkerCount = 1;
+  setCacheDirectory(defaultCacheDirectory());
+}
+
+PiiThumbnailLoader::~PiiThumbnailLoader()
 {
+  stopLoading();
+  wait();
 }
 
-void PiiThumbnailLoader::run()
+void PiiThumbnailLoader::loadThumbnails()
 {
+  _loadingMutex.lock();
   while (_bRunning)
     {
-      _loadingMutex.lock();
       if (_lstFileNames.isEmpty())
         {
-          _bRunning = false;
-          _loadingMutex.unlock();
-          break;
+          _queueCondition.wait(&_loadingMutex);
+          continue;
         }
       QString strFileName = _lstFileNames.takeFirst();
       _loadingMutex.unlock();
 
-      QImage image(strFileName);
-      if (image.format() == QImage::Format_ARGB32)
-        Pii::setQImageFormat(&image, QImage::Format_RGB32);
-      emit thumbnailReady(strFileName, image.scaled(70,90,Qt::KeepAspectRatio));
+      emit thumbnailReady(strFileName, createThumbnail(strFileName));
 
       _loadingMutex.lock();
-      if (_lstFileNames.isEmpty())
-        _bRunning = false;
-      _loadingMutex.unlock();
     }
+  _loadingMutex.unlock();
+}
+
+QImage PiiThumbnailLoader::createThumbnail(const QString& fileName) const
+{
+  QSize size(thumbnailSize());
+  QString strCacheFile(cacheFileName(fileName));
+  if (!strCacheFile.isEmpty())
+    {
+      QImage cached(strCacheFile);
+      if (!cached.isNull())
+        return cached;
+    }
+
+  QImage image(readThumbnail(fileName, size));
+  if (image.format() == QImage::Format_ARGB32)
+    Pii::setQImageFormat(&image, QImage::Format_RGB32);
+
+  if (!image.isNull() && !strCacheFile.isEmpty())
+    {
+      // Write to a temporary file first so that another loader never
+      // sees a partial file.
+      QString strTempFile(strCacheFile + ".tmp");
+      if (image.save(strTempFile, "PNG"))
+        {
+          if (!QFile::rename(strTempFile, strCacheFile))
+            QFile::remove(strTempFile);
+        }
+    }
+  return image;
+}
+
+QImage PiiThumbnailLoader::readThumbnail(const QString& fileName, const QSize& size) const
+{
+  QImageReader reader(fileName);
+  QSize imageSize(reader.size());
+  QSize targetSize(imageSize.isValid() ? imageSize.scaled(size, Qt::KeepAspectRatio) : size);
+
+  QImage image;
+  // An embedded EXIF thumbnail will do if it doesn't need to be
+  // enlarged.
+  if (reader.format() == "jpeg")
+    {
+      image = readExifThumbnail(fileName);
+      if (!image.isNull())
+        {
+          QSize thumbSize(image.size().scaled(targetSize, Qt::KeepAspectRatio));
+          if (thumbSize.width() > image.width() || thumbSize.height() > image.height())
+            image = QImage();
+        }
+    }
+
+  if (image.isNull())
+    {
+      // The JPEG reader scales in the DCT domain and doesn't need to
+      // decode the full image.
+      if (imageSize.isValid() && targetSize.width() < imageSize.width() &&
+          reader.supportsOption(QImageIOHandler::ScaledSize))
+        reader.setScaledSize(targetSize);
+      image = reader.read();
+      if (image.isNull())
+        return image;
+    }
+
+  QSize scaledSize(image.size().scaled(size, Qt::KeepAspectRatio));
+  if (scaledSize != image.size())
+    image = image.scaled(scaledSize);
+  return image;
+}
+
+QString PiiThumbnailLoader::cacheFileName(const QString& fileName) const
+{
+  QString strDirectory(cacheDirectory());
+  if (strDirectory.isEmpty())
+    return QString();
+  QFileInfo info(fileName);
+  if (!info.isFile())
+    return QString();
+
+  QSize size(thumbnailSize());
+  QString strKey = QString("%1\n%2\n%3\n%4x%5")
+    .arg(info.absoluteFilePath())
+    .arg(info.size())
+    .arg(info.lastModified().toMSecsSinceEpoch())
+    .arg(size.width()).arg(size.height());
+  return strDirectory + "/" +
+    QString::fromLatin1(QCryptographicHash::hash(strKey.toUtf8(), QCryptographicHash::Sha1).toHex()) +
+    ".png";
 }
 
 void PiiThumbnailLoader::setFileNames(const QStringList& fileNames)
 {
-  _loadingMutex.lock();
-  _lstFileNames = fileNames;
-  _loadingMutex.unlock();
+  synchronized (_loadingMutex)
+    {
+      _lstFileNames = fileNames;
+      _queueCondition.wakeAll();
+    }
 
   if (!_bRunning)
     startLoading();
@@ -58,22 +275,102 @@ void PiiThumbnailLoader::setFileNames(const QStringList& fileNames)
 
 void PiiThumbnailLoader::addFileName(const QString& fileName)
 {
-  _loadingMutex.lock();
-  _lstFileNames << fileName;
-  _loadingMutex.unlock();
+  synchronized (_loadingMutex)
+    {
+      _lstFileNames << fileName;
+      _queueCondition.wakeOne();
+    }
 
   if (!_bRunning)
     startLoading();
 }
 
+void PiiThumbnailLoader::prioritize(const QStringList& fileNames)
+{
+  QMutexLocker lock(&_loadingMutex);
+  for (int i=fileNames.size(); i--; )
+    if (_lstFileNames.removeOne(fileNames[i]))
+      _lstFileNames.prepend(fileNames[i]);
+}
+
+QStringList PiiThumbnailLoader::fileNames() const
+{
+  QMutexLocker lock(&_loadingMutex);
+  return _lstFileNames;
+}
+
 void PiiThumbnailLoader::startLoading()
 {
-  _bRunning = true;
-  start();
+  if (_bRunning)
+    return;
+
+  // Threads that were stopped but haven't finished yet must not pick
+  // up new work.
+  wait();
+
+  synchronized (_loadingMutex) _bRunning = true;
+  for (int i=0; i<_iWorkerCount; ++i)
+    {
+      Worker* pWorker = new Worker(this);
+      _lstWorkers << pWorker;
+      pWorker->start(QThread::LowPriority);
+    }
 }
 
 void PiiThumbnailLoader::stopLoading()
 {
+  QMutexLocker lock(&_loadingMutex);
   _bRunning = false;
+  _queueCondition.wakeAll();
+}
+
+void PiiThumbnailLoader::wait()
+{
+  for (int i=0; i<_lstWorkers.size(); ++i)
+    _lstWorkers[i]->wait();
+  qDeleteAll(_lstWorkers);
+  _lstWorkers.clear();
+}
+
+void PiiThumbnailLoader::setWorkerCount(int workerCount)
+{
+  if (workerCount < 1 || workerCount == _iWorkerCount)
+    return;
+  bool bRunning = _bRunning;
+  if (bRunning)
+    {
+      stopLoading();
+      wait();
+    }
+  _iWorkerCount = workerCount;
+  if (bRunning)
+    startLoading();
 }
 
+int PiiThumbnailLoader::workerCount() const { return _iWorkerCount; }
+
+void PiiThumbnailLoader::setThumbnailSize(const QSize& thumbnailSize)
+{
+  QMutexLocker lock(&_loadingMutex);
+  _thumbnailSize = thumbnailSize;
+}
+
+QSize PiiThumbnailLoader::thumbnailSize() const
+{
+  QMutexLocker lock(&_loadingMutex);
+  return _thumbnailSize;
+}
+
+void PiiThumbnailLoader::setCacheDirectory(const QString& cacheDirectory)
+{
+  if (!cacheDirectory.isEmpty())
+    QDir().mkpath(cacheDirectory);
+  QMutexLocker lock(&_loadingMutex);
+  _strCacheDirectory = cacheDirectory;
+}
+
+QString PiiThumbnailLoader::cacheDirectory() const
+{
+  QMutexLocker lock(&_loadingMutex);
+  return _strCacheDirectory;
+}
@@ -20,28 +20,73 @@
 #include <QImage>
 #include <QMutex>
 #include <QStringList>
+#include <QWaitCondition>
+#include <QList>
 
 #include "PiiGui.h"
 
-class PII_GUI_EXPORT PiiThumbnailLoader : public QThread
+/**
+ * Creates thumbnails in background threads. File names are queued
+ * with [addFileName()] or [setFileNames()], and [thumbnailReady()]
+ * is emitted for each of them once the thumbnail is available.
+ *
+ * Thumbnails are created in parallel by [workerCount] threads. If
+ * the image format supports scaled reading (e.g. JPEG, which scales
+ * in the DCT domain), the image is never decoded at full size. If a
+ * JPEG file contains an embedded EXIF thumbnail that is large
+ * enough, it is used instead. Finished thumbnails are stored in
+ * [cacheDirectory], keyed by the absolute path, size and
+ * modification time of the file, so that browsing the same images
+ * again doesn't decode anything.
+ *
+ * Files that are currently visible can be moved to the head of the
+ * queue with [prioritize()].
+ */
+class PII_GUI_EXPORT PiiThumbnailLoader : public QObject
 {
   Q_OBJECT
 
+  /**
+   * The number of loading threads. The default is
+   * QThread::idealThreadCount(). Changing the value stops the
+   * current threads, but keeps the queue.
+   */
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  /**
+   * The maximum size of a thumbnail. The aspect ratio of the image is
+   * retained. The default is 70 by 90 pixels.
+   */
+  Q_PROPERTY(QSize thumbnailSize READ thumbnailSize WRITE setThumbnailSize);
+
+  /**
+   * The directory where thumbnails are cached. The directory will be
+   * created if it doesn't exist. An empty string disables the disk
+   * cache. The default is a "thumbnails" subdirectory in the
+   * platform's cache location.
+   */
+  Q_PROPERTY(QString cacheDirectory READ cacheDirectory WRITE setCacheDirectory);
+
 public:
   PiiThumbnailLoader(QObject *parent = 0);
-
-  void run();
+  ~PiiThumbnailLoader();
 
   /**
-   * Start the loading thread.
+   * Start the loading threads.
    */
   void startLoading();
 
   /**
-   * Stop the loading thread.
+   * Stop the loading threads. Thumbnails that are being created will
+   * still be finished. Use [wait()] to wait for them.
    */
   void stopLoading();
 
+  /**
+   * Waits until all loading threads have exited.
+   */
+  void wait();
+
   /**
    * Get the list of the file names which are waiting list.
    */
@@ -59,6 +104,25 @@ public:
    */
   void addFileName(const QString& fileName);
 
+  /**
+   * Moves *fileNames* to the head of the loading queue in the given
+   * order. File names that are not in the queue are ignored.
+   */
+  void prioritize(const QStringList& fileNames);
+
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+  void setThumbnailSize(const QSize& thumbnailSize);
+  QSize thumbnailSize() const;
+  void setCacheDirectory(const QString& cacheDirectory);
+  QString cacheDirectory() const;
+
+  /**
+   * Creates a thumbnail for *fileName*, using the disk cache if
+   * possible. This function is thread-safe.
+   */
+  QImage createThumbnail(const QString& fileName) const;
+
 signals:
   /**
    * This signal was emitted just after we have created the thumbnail
@@ -67,9 +131,28 @@ signals:
   void thumbnailReady(const QString& fileName, const QImage& image);
 
 private:
+  class Worker : public QThread
+  {
+  public:
+    Worker(PiiThumbnailLoader* loader) : _pLoader(loader) {}
+  protected:
+    void run() { _pLoader->loadThumbnails(); }
+  private:
+    PiiThumbnailLoader* _pLoader;
+  };
+
+  void loadThumbnails();
+  QString cacheFileName(const QString& fileName) const;
+  QImage readThumbnail(const QString& fileName, const QSize& size) const;
+
   bool _bRunning;
-  QMutex _loadingMutex;
+  int _iWorkerCount;
+  QSize _thumbnailSize;
+  QString _strCacheDirectory;
+  mutable QMutex _loadingMutex;
+  QWaitCondition _queueCondition;
   QStringList _lstFileNames;
+  QList<Worker*> _lstWorkers;
 };
 
 #endif //_PIITHUMBNAILLOADER_H
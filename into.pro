@@ -24,6 +24,7 @@ contains(CONFIG,qt) {
     qml.depends += ydin
   }
 } else {
-  SUBDIRS = core modules
+  SUBDIRS = core ydin modules
+  ydin.depends += core
   modules.depends += core
 }
@@ -18,7 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include <QDateTime>
-#include <QTimer>
+#include <PiiThreadSafeTimer.h>
 
 /**
  * An operation that emits current time whenever a trigger is
@@ -167,7 +167,7 @@ private:
     InputType inputType;
     QString strFormat;
     TimeType timeType;
-    QTimer timer;
+    PiiThreadSafeTimer timer;
     bool bUseTimer, bTimeOutputConnected, bTimestampOutputConnected;
     PiiOutputSocket* pTimeOutput, *pTimeStampOutput;
   };
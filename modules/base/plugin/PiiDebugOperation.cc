@@ -146,6 +146,10 @@ void PiiDebugOperation::printControlObject(const PiiVariant& obj)
       d->mapVariables["value"] = "resume tag";
       d->mapVariables["symbol"] = "R";
       break;
+    case PiiYdin::DropTagType:
+      d->mapVariables["value"] = "drop tag";
+      d->mapVariables["symbol"] = "D";
+      break;
     default:
       d->mapVariables["value"] = "unidentified tag";
       d->mapVariables["symbol"] = "?";
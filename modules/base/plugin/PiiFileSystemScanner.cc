@@ -16,13 +16,20 @@
 #include "PiiFileSystemScanner.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
 
 PiiFileSystemScanner::Data::Data() :
   iMaxDepth(1),
   iSortFlags(Unsorted),
   iFilters(Readable | Files),
   iRepeatCount(-1),
-  iLoopIndex(0)
+  iLoopIndex(0),
+  bIncremental(false),
+  iScannerThreads(4),
+  bScanning(false),
+  iIndexedFileCount(0),
+  pWatcher(0)
 {
 }
 
@@ -37,18 +44,205 @@ PiiFileSystemScanner::PiiFileSystemScanner() :
   d->pPathInput->setOptional(true);
 
   addSocket(new PiiOutputSocket("filename"));
+
+  setProtectionLevel("incremental", WriteWhenStoppedOrPaused);
+  setProtectionLevel("scannerThreads", WriteWhenStoppedOrPaused);
+}
+
+PiiFileSystemScanner::~PiiFileSystemScanner()
+{
+  stopScanner();
 }
 
 void PiiFileSystemScanner::check(bool reset)
 {
+  PII_D;
   PiiDefaultOperation::check(reset);
 
+  if (d->bIncremental && !d->pPathInput->isConnected())
+    {
+      // Resuming a paused scan continues where it left.
+      if (reset || d->lstScannerThreads.isEmpty())
+        startScanner();
+      return;
+    }
+  stopScanner();
+
   if (reset)
     {
       resetPaths();
-      _d()->iLoopIndex = 0;
+      d->iLoopIndex = 0;
+    }
+}
+
+void PiiFileSystemScanner::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    stopScanner();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiFileSystemScanner::startScanner()
+{
+  PII_D;
+  stopScanner();
+  // Removes all watched paths.
+  delete d->pWatcher;
+  d->pWatcher = 0;
+
+  QStringList lstRoots(d->lstPaths);
+  if (lstRoots.isEmpty())
+    lstRoots << QString(".");
+
+  d->lstCollectedFiles.clear();
+  d->lstDirectoriesToScan.clear();
+  d->setQueuedDirectories.clear();
+  d->hashDirectoryDepths.clear();
+  d->hashIndex.clear();
+  d->iIndexedFileCount = 0;
+  for (int i=0; i<lstRoots.size(); ++i)
+    {
+      d->lstDirectoriesToScan << qMakePair(lstRoots[i], d->iMaxDepth);
+      d->setQueuedDirectories << lstRoots[i];
+      d->hashDirectoryDepths.insert(lstRoots[i], d->iMaxDepth);
+    }
+  watchDirectories(lstRoots);
+
+  d->bScanning = true;
+  for (int i=qMax(d->iScannerThreads, 1); i--; )
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiFileSystemScanner::scanDirectories);
+      d->lstScannerThreads << pThread;
+      pThread->start();
+    }
+}
+
+void PiiFileSystemScanner::stopScanner()
+{
+  PII_D;
+  synchronized (d->indexMutex)
+    {
+      d->bScanning = false;
+      d->directoriesAvailable.wakeAll();
+      d->filesAvailable.wakeAll();
     }
- }
+  for (int i=0; i<d->lstScannerThreads.size(); ++i)
+    {
+      d->lstScannerThreads[i]->wait();
+      delete d->lstScannerThreads[i];
+    }
+  d->lstScannerThreads.clear();
+}
+
+void PiiFileSystemScanner::watchDirectories(const QStringList& directories)
+{
+  PII_D;
+  // Scanner threads find directories, but the watcher must be used
+  // in the thread it lives in.
+  if (d->pWatcher == 0)
+    {
+      d->pWatcher = new QFileSystemWatcher(this);
+      connect(d->pWatcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(directoryChanged(const QString&)));
+    }
+  d->pWatcher->addPaths(directories);
+}
+
+void PiiFileSystemScanner::directoryChanged(const QString& path)
+{
+  PII_D;
+  synchronized (d->indexMutex)
+    {
+      // A late notification from a previous run or a directory
+      // that is already waiting.
+      if (!d->bScanning ||
+          !d->hashDirectoryDepths.contains(path) ||
+          d->setQueuedDirectories.contains(path))
+        break;
+      d->lstDirectoriesToScan << qMakePair(path, d->hashDirectoryDepths[path]);
+      d->setQueuedDirectories << path;
+      d->directoriesAvailable.wakeOne();
+    }
+}
+
+void PiiFileSystemScanner::scanDirectories()
+{
+  PII_D;
+  forever
+    {
+      QPair<QString,int> pathPair;
+      synchronized (d->indexMutex)
+        {
+          while (d->bScanning && d->lstDirectoriesToScan.isEmpty())
+            d->directoriesAvailable.wait(&d->indexMutex);
+          if (!d->bScanning)
+            return;
+          pathPair = d->lstDirectoriesToScan.takeFirst();
+          d->setQueuedDirectories.remove(pathPair.first);
+        }
+
+      // Listing the directory takes most of the time and needs no lock.
+      PathList lstSubdirectories;
+      QStringList lstFiles;
+      scanFolder(pathPair.first, pathPair.second, lstSubdirectories, lstFiles);
+
+      QStringList lstNewDirectories;
+      synchronized (d->indexMutex)
+        {
+          QSet<QString> setCurrentFiles;
+          bool bNewFiles = false;
+          const QSet<QString>& setPreviousFiles = d->hashIndex[pathPair.first];
+          for (int i=0; i<lstFiles.size(); ++i)
+            {
+              setCurrentFiles << lstFiles[i];
+              if (!setPreviousFiles.contains(lstFiles[i]))
+                {
+                  d->lstCollectedFiles << lstFiles[i];
+                  bNewFiles = true;
+                }
+            }
+          d->iIndexedFileCount += setCurrentFiles.size() - setPreviousFiles.size();
+          d->hashIndex[pathPair.first] = setCurrentFiles;
+          if (bNewFiles)
+            d->filesAvailable.wakeAll();
+
+          for (int i=0; i<lstSubdirectories.size(); ++i)
+            if (!d->hashDirectoryDepths.contains(lstSubdirectories[i].first))
+              {
+                d->hashDirectoryDepths.insert(lstSubdirectories[i].first, lstSubdirectories[i].second);
+                d->lstDirectoriesToScan << lstSubdirectories[i];
+                d->setQueuedDirectories << lstSubdirectories[i].first;
+                lstNewDirectories << lstSubdirectories[i].first;
+              }
+          if (!lstNewDirectories.isEmpty())
+            d->directoriesAvailable.wakeAll();
+        }
+
+      if (!lstNewDirectories.isEmpty())
+        QMetaObject::invokeMethod(this, "watchDirectories", Qt::QueuedConnection,
+                                  Q_ARG(QStringList, lstNewDirectories));
+    }
+}
+
+void PiiFileSystemScanner::processIncremental()
+{
+  PII_D;
+  QString strFileName;
+  synchronized (d->indexMutex)
+    {
+      // Wait a while so that the state can be checked regularly. A
+      // trigger keeps waiting until there is a file to emit.
+      while (d->lstCollectedFiles.isEmpty() && d->bScanning && state() == Running)
+        {
+          d->filesAvailable.wait(&d->indexMutex, 200);
+          if (!d->pTriggerInput->isConnected())
+            break;
+        }
+      if (d->lstCollectedFiles.isEmpty())
+        return;
+      strFileName = d->lstCollectedFiles.takeFirst();
+    }
+  emitObject(strFileName);
+}
 
 void PiiFileSystemScanner::resetPaths()
 {
@@ -77,6 +271,8 @@ void PiiFileSystemScanner::process()
         emitObject(d->lstCollectedFiles[i]);
       endMany();
     }
+  else if (d->bIncremental)
+    processIncremental();
   else
     {
       emitObject(d->lstCollectedFiles.takeFirst());
@@ -185,3 +381,9 @@ void PiiFileSystemScanner::setNameFilters(const QStringList& nameFilters) { _d()
 QStringList PiiFileSystemScanner::nameFilters() const { return _d()->lstNameFilters; }
 void PiiFileSystemScanner::setRepeatCount(int repeatCount) { _d()->iRepeatCount = repeatCount; }
 int PiiFileSystemScanner::repeatCount() const { return _d()->iRepeatCount; }
+void PiiFileSystemScanner::setIncremental(bool incremental) { _d()->bIncremental = incremental; }
+bool PiiFileSystemScanner::incremental() const { return _d()->bIncremental; }
+void PiiFileSystemScanner::setScannerThreads(int scannerThreads) { _d()->iScannerThreads = qBound(1, scannerThreads, 64); }
+int PiiFileSystemScanner::scannerThreads() const { return _d()->iScannerThreads; }
+
+int PiiFileSystemScanner::indexedFileCount() const { return _d()->iIndexedFileCount; }
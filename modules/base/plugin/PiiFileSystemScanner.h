@@ -18,12 +18,25 @@
 
 #include <PiiDefaultOperation.h>
 #include <QDir>
+#include <QSet>
+#include <QHash>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFileSystemWatcher>
 
 /**
  * Scans directory hierarchies finding files that match filters. This
  * operation is somewhat similar to the Unix "find" command or "dir
  * /s" in Windows.
  *
+ * By default, the matching files are collected one directory at a
+ * time, and the whole hierarchy is scanned again once all files have
+ * been emitted. In [incremental] mode, the directory hierarchy is
+ * walked only once, in parallel, and file names are emitted as soon
+ * as they are found. After that, the scanner keeps watching the
+ * directories and emits the names of new files as they appear.
+ *
  * Inputs
  * ------
  *
@@ -92,6 +105,45 @@ class PiiFileSystemScanner : public PiiDefaultOperation
    */
   Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
 
+  /**
+   * Enables incremental scanning. In incremental mode, the scanner
+   * keeps an in-memory index of the files it has seen in each
+   * directory. The initial walk is performed by [scannerThreads]
+   * background threads, and matching files are emitted while the
+   * walk is still in progress. Once a directory has been scanned, it
+   * is monitored for changes using the native notification mechanism
+   * of the operating system (inotify on Linux,
+   * ReadDirectoryChangesW on Windows). When a directory changes, only
+   * that directory is scanned again, and the names of files not in
+   * the index are emitted. The operation never stops spontaneously,
+   * and [repeatCount] has no effect.
+   *
+   * Files within a directory are emitted in the order determined by
+   * [sortFlags], but directories are scanned in parallel, and there
+   * is no global order. If the `trigger` input is connected, each
+   * trigger waits until a new file is available. Incremental mode
+   * has no effect if the `path` input is connected.
+   *
+   * Note that operating systems may limit the number of directories
+   * a process can watch. On Linux, the limit can be raised through
+   * `/proc/sys/fs/inotify/max_user_watches`. The default value is
+   * `false`.
+   */
+  Q_PROPERTY(bool incremental READ incremental WRITE setIncremental);
+
+  /**
+   * The number of threads used for scanning directories in
+   * [incremental] mode. Using many threads pays off especially with
+   * network file systems, where most of the time is spent waiting
+   * for the server. The default value is 4.
+   */
+  Q_PROPERTY(int scannerThreads READ scannerThreads WRITE setScannerThreads);
+
+  /**
+   * The number of files in the index built in [incremental] mode.
+   */
+  Q_PROPERTY(int indexedFileCount READ indexedFileCount);
+
   Q_FLAGS(SortFlags);
   Q_FLAGS(Filters);
 
@@ -143,11 +195,13 @@ public:
   Q_DECLARE_FLAGS(Filters, Filter);
 
   PiiFileSystemScanner();
+  ~PiiFileSystemScanner();
 
   void check(bool reset);
 
 protected:
   void process();
+  void aboutToChangeState(State state);
 
   void setPaths(const QStringList& paths);
   QStringList paths() const;
@@ -161,6 +215,15 @@ protected:
   QStringList nameFilters() const;
   void setRepeatCount(int repeatCount);
   int repeatCount() const;
+  void setIncremental(bool incremental);
+  bool incremental() const;
+  void setScannerThreads(int scannerThreads);
+  int scannerThreads() const;
+  int indexedFileCount() const;
+
+private slots:
+  void watchDirectories(const QStringList& directories);
+  void directoryChanged(const QString& path);
 
 private:
   typedef QList<QPair<QString,int> > PathList;
@@ -180,6 +243,23 @@ private:
     PathList lstPathsToScan;
     QStringList lstCollectedFiles;
     int iLoopIndex;
+
+    bool bIncremental;
+    int iScannerThreads;
+    QList<QThread*> lstScannerThreads;
+    bool bScanning;
+    // Protects everything below and lstCollectedFiles in incremental mode.
+    QMutex indexMutex;
+    QWaitCondition directoriesAvailable, filesAvailable;
+    // Directories waiting to be scanned and their remaining depths
+    PathList lstDirectoriesToScan;
+    QSet<QString> setQueuedDirectories;
+    // Remaining depths of all directories found so far
+    QHash<QString,int> hashDirectoryDepths;
+    // Full paths of matching files in each directory
+    QHash<QString,QSet<QString> > hashIndex;
+    int iIndexedFileCount;
+    QFileSystemWatcher* pWatcher;
   };
   PII_D_FUNC;
 
@@ -187,6 +267,10 @@ private:
   bool findAtLeastOneFile();
   void scanFolder(const QString& path, int maxDepth);
   void scanFolder(const QString& path, int maxDepth, PathList& paths, QStringList& files);
+  void startScanner();
+  void stopScanner();
+  void scanDirectories();
+  void processIncremental();
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(PiiFileSystemScanner::SortFlags);
@@ -14,14 +14,18 @@
  */
 
 #include "PiiLookupTable.h"
+#include "PiiLookupTableKernels.h"
 
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
 #include <PiiUtil.h>
 
+#include <limits>
+
 PiiLookupTable::Data::Data() :
   iMaxTableIndex(0),
-  iMaxLookupIndex(0)
+  iMaxLookupIndex(0),
+  matrixType(UnsignedCharMatrix)
 {
 }
 
@@ -37,6 +41,8 @@ void PiiLookupTable::setTable(const QVariantList& table)
   PII_D;
   d->lstTable = table;
   d->lstOutputValues.clear();
+  d->lstByteTables.clear();
+  d->lstFloatTables.clear();
 
   if (table.size() == 0)
     return;
@@ -78,6 +84,85 @@ void PiiLookupTable::check(bool reset)
     for (int j=d->lstOutputValues[i].size(); j--; )
       if (!d->lstOutputValues[i][j].isValid())
         PII_THROW(PiiExecutionException, tr("The provided look-up table contains invalid values."));
+
+  // The table may have changed.
+  d->lstByteTables.clear();
+  d->lstFloatTables.clear();
+}
+
+template <class U> void PiiLookupTable::createTables(QList<QVector<U> >& tables, int size)
+{
+  PII_D;
+  if (!tables.isEmpty() && tables[0].size() >= size)
+    return;
+
+  tables.clear();
+  const U defaultValue = PiiYdin::convertPrimitiveTo<U>(d->varDefaultValue);
+  for (int i=0; i<d->lstOutputValues.size(); ++i)
+    {
+      const QList<PiiVariant>& lstValues = d->lstOutputValues[i];
+      // Three bytes of padding for the gather kernels.
+      QVector<U> vecTable(size + 3, defaultValue);
+      for (int j=0; j<lstValues.size() && j<size; ++j)
+        {
+          if (!lstValues[j].isPrimitive())
+            PII_THROW(PiiExecutionException, tr("Matrix look-up requires a numeric look-up table."));
+          vecTable[j] = PiiYdin::convertPrimitiveTo<U>(lstValues[j]);
+        }
+      tables << vecTable;
+    }
+}
+
+template <class T, class U>
+void PiiLookupTable::lookUpMatrix(const PiiMatrix<T>& indices, const QList<QVector<U> >& tables)
+{
+  PII_D;
+  const int iRows = indices.rows(), iColumns = indices.columns();
+  for (int i=0; i<outputCount(); ++i)
+    {
+      const U* pTable = tables[qMin(i, d->iMaxTableIndex)].constData();
+      PiiMatrix<U> matValues(PiiMatrix<U>::uninitialized(iRows, iColumns));
+      for (int r=0; r<iRows; ++r)
+        {
+          const T* pIndices = indices[r];
+          U* pValues = matValues[r];
+          if (!PiiLookupTableKernel<T,U>::apply(pIndices, iColumns, pTable, pValues))
+            for (int c=0; c<iColumns; ++c)
+              pValues[c] = pTable[pIndices[c]];
+        }
+      emitObject(matValues, i);
+    }
+}
+
+template <class T> void PiiLookupTable::lookUpMatrix(const PiiVariant& obj)
+{
+  PII_D;
+  const PiiMatrix<T> matIndices(obj.valueAs<PiiMatrix<T> >());
+  const int iSize = int(std::numeric_limits<T>::max()) + 1;
+
+  if (d->iMaxTableIndex < 0)
+    PII_THROW(PiiExecutionException, tr("The look-up table is empty."));
+
+  // The typed tables are filled with the default value. Without one,
+  // the indices must be checked.
+  if (d->iMaxLookupIndex < iSize - 1 && !d->varDefaultValue.isValid() && !matIndices.isEmpty())
+    {
+      T minimum, maximum;
+      Pii::minMax(matIndices, &minimum, &maximum);
+      if (int(maximum) > d->iMaxLookupIndex)
+        PII_THROW(PiiExecutionException, tr("The value of the index input (%1) is out of range (0-%2).").arg(int(maximum)).arg(d->iMaxLookupIndex));
+    }
+
+  if (d->matrixType == FloatMatrix)
+    {
+      createTables(d->lstFloatTables, iSize);
+      lookUpMatrix(matIndices, d->lstFloatTables);
+    }
+  else
+    {
+      createTables(d->lstByteTables, iSize);
+      lookUpMatrix(matIndices, d->lstByteTables);
+    }
 }
 
 void PiiLookupTable::process()
@@ -89,6 +174,12 @@ void PiiLookupTable::process()
   switch (obj.type())
     {
       PII_PRIMITIVE_CASES(index = (int)PiiYdin::primitiveAs, obj);
+    case PiiYdin::UnsignedCharMatrixType:
+      lookUpMatrix<unsigned char>(obj);
+      return;
+    case PiiYdin::UnsignedShortMatrixType:
+      lookUpMatrix<unsigned short>(obj);
+      return;
     default:
       PII_THROW_UNKNOWN_TYPE(inputAt(0));
     }
@@ -119,5 +210,13 @@ void PiiLookupTable::process()
 
 QVariantList PiiLookupTable::table() const { return _d()->lstTable; }
 int PiiLookupTable::dynamicOutputCount() const { return outputCount(); }
-void PiiLookupTable::setDefaultValue(const PiiVariant& defaultValue) { _d()->varDefaultValue = defaultValue; }
+void PiiLookupTable::setDefaultValue(const PiiVariant& defaultValue)
+{
+  PII_D;
+  d->varDefaultValue = defaultValue;
+  d->lstByteTables.clear();
+  d->lstFloatTables.clear();
+}
 PiiVariant PiiLookupTable::defaultValue() const { return _d()->varDefaultValue; }
+void PiiLookupTable::setMatrixType(MatrixType matrixType) { _d()->matrixType = matrixType; }
+PiiLookupTable::MatrixType PiiLookupTable::matrixType() const { return _d()->matrixType; }
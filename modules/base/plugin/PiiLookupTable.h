@@ -27,13 +27,16 @@
  * @in index - a zero-based index into the look-up table. If there is
  * no [default value](defaultValue), overflows and underflows will
  * cause a run-time exception. Any primitive type is be accepted.
+ * `unsigned char` and `unsigned short` matrices are also accepted
+ * (see [matrixType]).
  *
  * Outputs
  * -------
  *
  * @out outputX - any number of outputs that emit arbitrary data. For
  * each incoming `index`, the corresponding look-up table entry will
- * be emitted.
+ * be emitted. If `index` is a matrix, a matrix of the same size with
+ * each element replaced by its look-up table entry will be emitted.
  *
  */
 class PiiLookupTable : public PiiDefaultOperation
@@ -86,8 +89,37 @@ class PiiLookupTable : public PiiDefaultOperation
    */
   Q_PROPERTY(PiiVariant defaultValue READ defaultValue WRITE setDefaultValue);
 
+  /**
+   * The type of the matrices emitted when `index` is a matrix. With
+   * matrix input, the look-up table values (and the default value)
+   * must be numbers, which are converted to the selected type. This
+   * makes it possible to apply gamma correction, contrast stretching
+   * or class remapping to whole images in one stage. The look-up is
+   * vectorized for `unsigned char` to `unsigned char` (NEON), and
+   * for `unsigned char` to `float` and `unsigned short` to `unsigned
+   * char` (AVX2). The default value is `UnsignedCharMatrix`.
+   *
+   * ~~~(c++)
+   * // Gamma correction for gray-level images
+   * QVariantList lstGamma;
+   * for (int i=0; i<256; ++i)
+   *   lstGamma << Pii::createQVariant(255 * std::pow(i / 255.0, 0.5));
+   * lut->setProperty("table", lstGamma);
+   * ~~~
+   */
+  Q_PROPERTY(MatrixType matrixType READ matrixType WRITE setMatrixType);
+  Q_ENUMS(MatrixType);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Element types of the matrices emitted in matrix mode.
+   *
+   * - `UnsignedCharMatrix` - emit PiiMatrix<unsigned char>
+   * - `FloatMatrix` - emit PiiMatrix<float>
+   */
+  enum MatrixType { UnsignedCharMatrix, FloatMatrix };
+
   PiiLookupTable();
 
   void check(bool reset);
@@ -98,11 +130,17 @@ public:
   int dynamicOutputCount() const;
   void setDefaultValue(const PiiVariant& defaultValue);
   PiiVariant defaultValue() const;
+  void setMatrixType(MatrixType matrixType);
+  MatrixType matrixType() const;
 
 protected:
   void process();
 
 private:
+  template <class T> void lookUpMatrix(const PiiVariant& obj);
+  template <class T, class U> void lookUpMatrix(const PiiMatrix<T>& indices, const QList<QVector<U> >& tables);
+  template <class U> void createTables(QList<QVector<U> >& tables, int size);
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
@@ -119,6 +157,12 @@ private:
     // (lstOutputValues[0])
     int iMaxLookupIndex;
     PiiVariant varDefaultValue;
+    MatrixType matrixType;
+    // Typed look-up tables for matrix mode, one for each look-up
+    // list. Created on the first matrix. The size covers the range
+    // of the index type (plus padding for the kernels).
+    QList<QVector<unsigned char> > lstByteTables;
+    QList<QVector<float> > lstFloatTables;
   };
   PII_D_FUNC;
 };
@@ -0,0 +1,152 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiLookupTableKernels.h"
+
+#include <PiiCpu.h>
+
+#if defined(PII_X86) && (!defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  include <immintrin.h>
+#  define PII_LUT_AVX2 1
+#elif defined(PII_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define PII_LUT_NEON 1
+#endif
+
+typedef unsigned char uchar;
+typedef unsigned short ushort;
+
+namespace
+{
+  template <class T, class U> void lookupTail(const T* indices, int i, int count,
+                                              const U* table, U* values)
+  {
+    for (; i<count; ++i)
+      values[i] = table[indices[i]];
+  }
+
+#ifdef PII_LUT_AVX2
+#  define PII_AVX2 PII_TARGET("avx2")
+
+  PII_AVX2 void lookupFloatsAvx2(const uchar* indices, int count, const float* table, float* values)
+  {
+    int i = 0;
+    for (; i <= count - 8; i += 8)
+      {
+        const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i)));
+        _mm256_storeu_ps(values + i, _mm256_i32gather_ps(table, index, 4));
+      }
+    lookupTail(indices, i, count, table, values);
+  }
+
+  /* Gathers 32-bit words at byte offsets and keeps the lowest byte.
+     This reads up to three bytes past the requested entry, hence the
+     padding requirement.
+   */
+  PII_AVX2 void lookupWideBytesAvx2(const ushort* indices, int count, const uchar* table, uchar* values)
+  {
+    const int* pWords = reinterpret_cast<const int*>(table);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    int i = 0;
+    for (; i <= count - 16; i += 16)
+      {
+        const __m256i index0 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)));
+        const __m256i index1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i + 8)));
+        const __m256i values0 = _mm256_and_si256(_mm256_i32gather_epi32(pWords, index0, 1), byteMask);
+        const __m256i values1 = _mm256_and_si256(_mm256_i32gather_epi32(pWords, index1, 1), byteMask);
+        // Packing works within 128-bit lanes. Restore the order of
+        // the 64-bit quarters before the final pack.
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(values0, values1), 0xd8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i),
+                         _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+      }
+    lookupTail(indices, i, count, table, values);
+  }
+
+#  undef PII_AVX2
+#endif
+
+#ifdef PII_LUT_NEON
+  /* Four 64-byte table registers cover the whole range. An index
+     that is out of the range of a register leaves the destination
+     byte untouched, so subtracting the offset of each register
+     (with wrap-around) selects exactly one of them.
+   */
+  void lookupBytesNeon(const uchar* indices, int count, const uchar* table, uchar* values)
+  {
+    uint8x16x4_t aTables[4];
+    for (int k=0; k<4; ++k)
+      for (int j=0; j<4; ++j)
+        aTables[k].val[j] = vld1q_u8(table + 64*k + 16*j);
+    const uint8x16_t offset = vdupq_n_u8(64);
+    int i = 0;
+    for (; i <= count - 16; i += 16)
+      {
+        uint8x16_t index = vld1q_u8(indices + i);
+        uint8x16_t result = vqtbl4q_u8(aTables[0], index);
+        index = vsubq_u8(index, offset);
+        result = vqtbx4q_u8(result, aTables[1], index);
+        index = vsubq_u8(index, offset);
+        result = vqtbx4q_u8(result, aTables[2], index);
+        index = vsubq_u8(index, offset);
+        result = vqtbx4q_u8(result, aTables[3], index);
+        vst1q_u8(values + i, result);
+      }
+    lookupTail(indices, i, count, table, values);
+  }
+#endif
+}
+
+bool PiiLookupTableKernel<uchar,uchar>::apply(const uchar* indices, int count,
+                                              const uchar* table, uchar* values)
+{
+#if defined(PII_LUT_NEON)
+  if (!Pii::hasCpuFeature(Pii::CpuNeon))
+    return false;
+  lookupBytesNeon(indices, count, table, values);
+  return true;
+#else
+  Q_UNUSED(indices); Q_UNUSED(count); Q_UNUSED(table); Q_UNUSED(values);
+  return false;
+#endif
+}
+
+bool PiiLookupTableKernel<uchar,float>::apply(const uchar* indices, int count,
+                                              const float* table, float* values)
+{
+#if defined(PII_LUT_AVX2)
+  if (!Pii::hasCpuFeature(Pii::CpuAvx2))
+    return false;
+  lookupFloatsAvx2(indices, count, table, values);
+  return true;
+#else
+  Q_UNUSED(indices); Q_UNUSED(count); Q_UNUSED(table); Q_UNUSED(values);
+  return false;
+#endif
+}
+
+bool PiiLookupTableKernel<ushort,uchar>::apply(const ushort* indices, int count,
+                                               const uchar* table, uchar* values)
+{
+#if defined(PII_LUT_AVX2)
+  if (!Pii::hasCpuFeature(Pii::CpuAvx2))
+    return false;
+  lookupWideBytesAvx2(indices, count, table, values);
+  return true;
+#else
+  Q_UNUSED(indices); Q_UNUSED(count); Q_UNUSED(table); Q_UNUSED(values);
+  return false;
+#endif
+}
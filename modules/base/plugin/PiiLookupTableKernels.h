@@ -0,0 +1,62 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILOOKUPTABLEKERNELS_H
+#define _PIILOOKUPTABLEKERNELS_H
+
+/**
+ * Vectorized table look-ups for PiiLookupTable. The kernels replace
+ * each of the *count* elements in *indices* with `table[index]` and
+ * store the result to *values*. Byte tables indexed with bytes
+ * are applied with NEON table instructions, the others with AVX2
+ * gathers. On x86, a plain byte look-up is as fast as the 16
+ * shuffles needed to cover a 256-entry table, and the byte-to-byte
+ * kernel is therefore NEON only.
+ *
+ * The generic template says "not supported", and PiiLookupTable
+ * falls back to scalar code. Specializations exist for `unsigned
+ * char` indices with `unsigned char` and `float` values and for
+ * `unsigned short` indices with `unsigned char` values. The table
+ * must cover the whole range of the index type. A byte table indexed
+ * with `unsigned short` must be followed by three bytes of readable
+ * memory. Each function returns `false` if the CPU lacks the
+ * required instructions. In this case *values* is not modified.
+ *
+ * @internal
+ */
+template <class T, class U> struct PiiLookupTableKernel
+{
+  static bool apply(const T*, int, const U*, U*) { return false; }
+};
+
+template <> struct PiiLookupTableKernel<unsigned char, unsigned char>
+{
+  static bool apply(const unsigned char* indices, int count,
+                    const unsigned char* table, unsigned char* values);
+};
+
+template <> struct PiiLookupTableKernel<unsigned char, float>
+{
+  static bool apply(const unsigned char* indices, int count,
+                    const float* table, float* values);
+};
+
+template <> struct PiiLookupTableKernel<unsigned short, unsigned char>
+{
+  static bool apply(const unsigned short* indices, int count,
+                    const unsigned char* table, unsigned char* values);
+};
+
+#endif //_PIILOOKUPTABLEKERNELS_H
@@ -54,6 +54,7 @@ void PiiMatrixCombiner::process()
   int maxType = 0;
   PiiVariant::PrimitiveType maxPrimitive = PiiVariant::CharType;
   bool primitiveFound = false, colorFound = false, complexFound = false;
+  bool bUniformSize = true;
   QSize maxSize(0,0);
 
   for (int i=0; i<cnt; ++i)
@@ -90,6 +91,8 @@ void PiiMatrixCombiner::process()
           PII_ALL_MATRIX_CASES(size = matrixSize, obj);
           PII_COLOR_IMAGE_CASES(size = matrixSize, obj);
         }
+      if (i > 0 && size != maxSize)
+        bUniformSize = false;
       maxSize = maxSize.expandedTo(size);
     }
 
@@ -103,8 +106,8 @@ void PiiMatrixCombiner::process()
 
   switch (maxType)
     {
-      PII_PRIMITIVE_MATRIX_CASES(buildCompound, maxSize);
-      PII_COLOR_IMAGE_CASES(buildCompound, maxSize);
+      PII_PRIMITIVE_MATRIX_CASES_M(buildCompound, (maxSize, bUniformSize));
+      PII_COLOR_IMAGE_CASES_M(buildCompound, (maxSize, bUniformSize));
     default:
       PII_THROW_UNKNOWN_TYPE(inputAt(0));
     }
@@ -117,7 +120,7 @@ template <class T> QSize PiiMatrixCombiner::matrixSize(const PiiVariant& obj)
 }
 
 
-template <class T> void PiiMatrixCombiner::buildCompound(QSize maxSize)
+template <class T> void PiiMatrixCombiner::buildCompound(QSize maxSize, bool uniformSize)
 {
   PII_D;
   int cnt = inputCount();
@@ -143,7 +146,11 @@ template <class T> void PiiMatrixCombiner::buildCompound(QSize maxSize)
       columns = cnt;
     }
 
-  PiiMatrix<T> matResult(rows * maxSize.height(), columns * maxSize.width());
+  // If the blocks tile the whole compound, every element will be
+  // overwritten. Otherwise the gaps must be zeroed.
+  PiiMatrix<T> matResult(uniformSize && rows * columns == cnt ?
+                         PiiMatrix<T>::uninitialized(rows * maxSize.height(), columns * maxSize.width()) :
+                         PiiMatrix<T>(rows * maxSize.height(), columns * maxSize.width()));
 
   Pii::IfClass<Pii::IsPrimitive<T>,
     PrimitiveBuilder,
@@ -151,6 +158,18 @@ template <class T> void PiiMatrixCombiner::buildCompound(QSize maxSize)
   emitObject(matResult);
 }
 
+namespace
+{
+  // Converts the elements of the input matrix straight into the
+  // compound without a temporary converted matrix.
+  template <class U, class T> void placeBlock(const PiiVariant& obj, PiiMatrix<T>& result, int row, int column)
+  {
+    const PiiMatrix<U> block = obj.valueAs<PiiMatrix<U> >();
+    if (!block.isEmpty())
+      result(row, column, block.rows(), block.columns()) << block;
+  }
+}
+
 struct PiiMatrixCombiner::PrimitiveBuilder
 {
   template <class T> static void buildCompound(PiiMatrixCombiner* combiner, PiiMatrix<T>& result, QSize maxSize, int columns)
@@ -158,15 +177,13 @@ struct PiiMatrixCombiner::PrimitiveBuilder
     for (int i=0; i<combiner->inputCount(); ++i)
       {
         PiiVariant obj = combiner->readInput(i);
-        PiiMatrix<T> block;
+        int iRow = (i/columns)*maxSize.height(), iColumn = (i%columns)*maxSize.width();
         switch (obj.type())
           {
-            PII_PRIMITIVE_MATRIX_CASES(block = (PiiMatrix<T>)PiiYdin::matrixAs, obj);
+            PII_PRIMITIVE_MATRIX_CASES_M(placeBlock, (obj, result, iRow, iColumn));
           default:
             qDebug("PiiMatrixCombiner: unrecognized object in input %d (type 0x%x)", i, obj.type());
           }
-        if (!block.isEmpty())
-          result((i/columns)*maxSize.height(), (i%columns)*maxSize.width(), block.rows(), block.columns()) << block;
       }
   }
 };
@@ -178,15 +195,13 @@ struct PiiMatrixCombiner::ColorBuilder
     for (int i=0; i<combiner->inputCount(); ++i)
       {
         PiiVariant obj = combiner->readInput(i);
-        PiiMatrix<T> block;
+        int iRow = (i/columns)*maxSize.height(), iColumn = (i%columns)*maxSize.width();
         switch (obj.type())
           {
-            PII_COLOR_IMAGE_CASES(block = (PiiMatrix<T>)PiiYdin::matrixAs, obj);
+            PII_COLOR_IMAGE_CASES_M(placeBlock, (obj, result, iRow, iColumn));
           default:
             qDebug("PiiMatrixCombiner: unrecognized object in input %d (type 0x%x)", i, obj.type());
           }
-        if (!block.isEmpty())
-          result((i/columns)*maxSize.height(), (i%columns)*maxSize.width(), block.rows(), block.columns()) << block;
       }
   }
 };
@@ -32,7 +32,9 @@
  * -------
  *
  * @out compound - a compound matrix on which the input matrices are
- * placed as denoted by the [rows] an [columns] properties.
+ * placed as denoted by the [rows] an [columns] properties. Input
+ * matrices are written directly to their places in the compound,
+ * converting the elements on the fly if needed.
  *
  */
 class PiiMatrixCombiner : public PiiDefaultOperation
@@ -79,7 +81,7 @@ private:
   PII_D_FUNC;
 
   template <class T> QSize matrixSize(const PiiVariant& obj);
-  template <class T> void buildCompound(QSize maxSize);
+  template <class T> void buildCompound(QSize maxSize, bool uniformSize);
 
   struct PrimitiveBuilder;
   struct ColorBuilder;
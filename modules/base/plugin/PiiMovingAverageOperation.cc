@@ -18,6 +18,50 @@
 #include <PiiTypeTraits.h>
 #include <complex>
 #include <PiiMath.h>
+#include <PiiRunningStatistics.h>
+
+class PiiMovingAverageOperation::Statistics
+{
+public:
+  virtual ~Statistics() {}
+};
+
+// T is the output type of the average.
+template <class T> class PiiMovingAverageOperation::WindowStatistics :
+  public PiiMovingAverageOperation::Statistics
+{
+public:
+  WindowStatistics(int windowSize) : extrema(windowSize) {}
+
+  PiiRunningSum<T> sum;
+  PiiRunningVariance<T> variance;
+  PiiSlidingExtrema<T> extrema;
+};
+
+namespace
+{
+  template <class T> struct HasRealElements : Pii::True {};
+  template <class T> struct HasRealElements<std::complex<T> > : Pii::False {};
+  template <class T> struct HasRealElements<PiiMatrix<T> > : HasRealElements<T> {};
+
+  // Variances and extrema are only touched for types that support
+  // them. The operation checks the types before calling these.
+  template <class S, class T> inline void addVariance(S* statistics, const T& value, Pii::True) { statistics->variance.add(value); }
+  template <class S, class T> inline void addVariance(S*, const T&, Pii::False) {}
+  template <class S, class T> inline void removeVariance(S* statistics, const T& value, Pii::True) { statistics->variance.remove(value); }
+  template <class S, class T> inline void removeVariance(S*, const T&, Pii::False) {}
+  template <class S> inline void emitVariance(PiiOutputSocket* output, S* statistics, Pii::True) { output->emitObject(statistics->variance.variance()); }
+  template <class S> inline void emitVariance(PiiOutputSocket*, S*, Pii::False) {}
+
+  template <class S, class T> inline void addExtremum(S* statistics, const T& value, Pii::True) { statistics->extrema.add(value); }
+  template <class S, class T> inline void addExtremum(S*, const T&, Pii::False) {}
+  template <class S> inline void emitExtrema(PiiOutputSocket* minimum, PiiOutputSocket* maximum, S* statistics, Pii::True)
+  {
+    minimum->emitObject(statistics->extrema.minimum());
+    maximum->emitObject(statistics->extrema.maximum());
+  }
+  template <class S> inline void emitExtrema(PiiOutputSocket*, PiiOutputSocket*, S*, Pii::False) {}
+}
 
 PiiMovingAverageOperation::Data::Data() :
   iWindowSize(2),
@@ -25,8 +69,16 @@ PiiMovingAverageOperation::Data::Data() :
   dRangeMax(0),
   dRange(0),
   uiType(PiiVariant::InvalidType),
-  bForceInputType(false)
+  bForceInputType(false),
+  pStatistics(0),
+  bVarianceConnected(false),
+  bExtremaConnected(false)
+{
+}
+
+PiiMovingAverageOperation::Data::~Data()
 {
+  delete pStatistics;
 }
 
 PiiMovingAverageOperation::PiiMovingAverageOperation() :
@@ -34,6 +86,11 @@ PiiMovingAverageOperation::PiiMovingAverageOperation() :
 {
   addSocket(new PiiInputSocket("input"));
   addSocket(new PiiOutputSocket("average"));
+  addSocket(new PiiOutputSocket("variance"));
+  addSocket(new PiiOutputSocket("minimum"));
+  addSocket(new PiiOutputSocket("maximum"));
+
+  setProtectionLevel("windowSize", WriteWhenStopped);
 }
 
 void PiiMovingAverageOperation::check(bool reset)
@@ -44,6 +101,10 @@ void PiiMovingAverageOperation::check(bool reset)
     {
       d->uiType = PiiVariant::InvalidType;
       d->lstBuffer.clear();
+      delete d->pStatistics;
+      d->pStatistics = 0;
+      d->bVarianceConnected = outputAt(1)->isConnected();
+      d->bExtremaConnected = outputAt(2)->isConnected() || outputAt(3)->isConnected();
     }
 }
 
@@ -87,58 +148,80 @@ template <class T> void PiiMovingAverageOperation::matrixAverage(const PiiVarian
 template <class T, class ResultType> void PiiMovingAverageOperation::averageTemplate(const PiiVariant& obj)
 {
   PII_D;
+  typedef WindowStatistics<ResultType> StatisticsType;
   if (d->lstBuffer.isEmpty())
     {
-      d->lstBuffer << obj;
-      if ( d->bForceInputType )
-        d->lstOutputs[0]->emitObject(obj.valueAs<T>());
-      else
-        {
-          ResultType result(obj.valueAs<T>());
-          d->lstOutputs[0]->emitObject(result);
-        }
+      if (d->bVarianceConnected && !HasRealElements<ResultType>::boolValue)
+        PII_THROW(PiiExecutionException, tr("Variance can only be calculated for real numbers."));
+      if (d->bExtremaConnected && !Pii::IsPrimitive<ResultType>::boolValue)
+        PII_THROW(PiiExecutionException, tr("Minimum and maximum can only be calculated for real scalars."));
       d->uiType = Pii::typeId<T>();
-      return;
+      delete d->pStatistics;
+      d->pStatistics = new StatisticsType(d->iWindowSize);
     }
-
-  if (obj.type() != d->uiType)
+  else if (obj.type() != d->uiType)
     PII_THROW(PiiExecutionException, tr("Cannot average objects of different type."));
 
-  // Add the object to the buffer, and remove the first one if window
-  // size is exceeded.
-  d->lstBuffer << obj;
-  while (d->lstBuffer.size() > d->iWindowSize)
-    d->lstBuffer.removeFirst();
-
-  // Calculate average
-  int index = 0;
-  QLinkedList<PiiVariant>::iterator i = d->lstBuffer.begin();
-  ResultType result((*i).valueAs<T>());
-  i++, index++;
+  StatisticsType* pStatistics = static_cast<StatisticsType*>(d->pStatistics);
+  ResultType value(obj.valueAs<T>());
   try
     {
-      while (i != d->lstBuffer.end())
-        {
-          // Same type -> no conversion
-          if (Pii::typeId<T>() == Pii::typeId<ResultType>())
-            add(result, (*i).valueAs<ResultType>(), index);
-          // Different type -> conversion needed
-          else
-            add(result, ResultType((*i).valueAs<T>()), index);
-          i++, index++;;
-        }
+      pStatistics->sum.add(value);
     }
-  catch (PiiMathException&)
+  catch (PiiInvalidArgumentException&)
     {
       PII_THROW(PiiExecutionException, tr("Cannot average matrices of different size."));
     }
+  if (d->bVarianceConnected)
+    addVariance(pStatistics, value, HasRealElements<ResultType>());
+  if (d->bExtremaConnected)
+    addExtremum(pStatistics, value, Pii::IsPrimitive<ResultType>());
 
-  scale(result, d->lstBuffer.size());
+  // Add the object to the buffer, and remove the first one if window
+  // size is exceeded. The buffer stores converted values to avoid
+  // converting them again on removal.
+  d->lstBuffer << PiiVariant(value);
+  while (d->lstBuffer.size() > d->iWindowSize)
+    {
+      ResultType oldValue(d->lstBuffer.first().valueAs<ResultType>());
+      d->lstBuffer.removeFirst();
+      pStatistics->sum.remove(oldValue);
+      if (d->bVarianceConnected)
+        removeVariance(pStatistics, oldValue, HasRealElements<ResultType>());
+    }
+
+  ResultType result(d->dRange != 0 && Pii::IsPrimitive<ResultType>::boolValue ?
+                    circularAverage<ResultType>() :
+                    pStatistics->sum.mean());
 
   if ( d->bForceInputType )
     emitObject((T)result);
   else
     emitObject(result);
+
+  if (d->bVarianceConnected)
+    emitVariance(outputAt(1), pStatistics, HasRealElements<ResultType>());
+  if (d->bExtremaConnected)
+    emitExtrema(outputAt(2), outputAt(3), pStatistics, Pii::IsPrimitive<ResultType>());
+}
+
+// Circular values cannot be summed up. Each value is brought as close
+// to the average of the preceding ones as possible, which requires a
+// pass over the whole window.
+template <class T> T PiiMovingAverageOperation::circularAverage()
+{
+  PII_D;
+  int index = 0;
+  QLinkedList<PiiVariant>::iterator i = d->lstBuffer.begin();
+  T result((*i).valueAs<T>());
+  i++, index++;
+  while (i != d->lstBuffer.end())
+    {
+      add(result, (*i).valueAs<T>(), index);
+      i++, index++;
+    }
+  scale(result, d->lstBuffer.size());
+  return result;
 }
 
 template <class T> void PiiMovingAverageOperation::addImpl(T& op1, T op2, int index)
@@ -201,7 +284,7 @@ template <class T> void PiiMovingAverageOperation::scale(T& result, int cnt)
   Pii::IfClass<Pii::IsPrimitive<T>, PiiMovingAverageOperation, AggregateHandler>::Type::scaleImpl(result, cnt);
 }
 
-void PiiMovingAverageOperation::setWindowSize(int windowSize) { _d()->iWindowSize = windowSize; }
+void PiiMovingAverageOperation::setWindowSize(int windowSize) { _d()->iWindowSize = qMax(1, windowSize); }
 int PiiMovingAverageOperation::windowSize() const { return _d()->iWindowSize; }
 void PiiMovingAverageOperation::setRangeMin(double rangeMin) { PII_D; d->dRangeMin = rangeMin; d->dRange = d->dRangeMax-d->dRangeMin; }
 double PiiMovingAverageOperation::rangeMin() const { return _d()->dRangeMin; }
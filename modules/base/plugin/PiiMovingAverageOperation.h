@@ -38,6 +38,24 @@
  * long int in input result in double output, others result in float
  * output.
  *
+ * @out variance - the population variance over the last N entries.
+ * Matrices produce element-wise variances. The type is the same as
+ * that of `average`. Only calculated if the output is connected and
+ * the input is real-valued.
+ *
+ * @out minimum - the smallest of the last N entries. Only for real
+ * scalars. The type is the same as that of `average`.
+ *
+ * @out maximum - the largest of the last N entries. Only for real
+ * scalars. The type is the same as that of `average`.
+ *
+ * The statistics are updated incrementally as objects enter and
+ * leave the window (see PiiRunningSum, PiiRunningVariance and
+ * PiiSlidingExtrema), and the cost of processing an object doesn't
+ * depend on [windowSize]. This makes per-pixel moving averages over
+ * large images feasible at full frame rate. Only the circular mode
+ * (see [rangeMin]) iterates over the whole window.
+ *
  */
 class PiiMovingAverageOperation : public PiiDefaultOperation
 {
@@ -47,6 +65,8 @@ class PiiMovingAverageOperation : public PiiDefaultOperation
    * The size of the averaging window. Note that the operation buffers
    * this many past values. If large matrices are averaged, a large
    * portion of memory may be reserved. The default value is two (2).
+   * The window size cannot be changed while the operation is
+   * running or paused.
    */
   Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize);
   /**
@@ -89,10 +109,14 @@ protected:
 
 private:
   /// @internal
+  class Statistics;
+  template <class T> class WindowStatistics;
+
   class Data : public PiiDefaultOperation::Data
   {
   public:
     Data();
+    ~Data();
     int iWindowSize;
     double dRangeMin;
     double dRangeMax;
@@ -100,12 +124,17 @@ private:
     unsigned int uiType;
     QLinkedList<PiiVariant> lstBuffer;
     bool bForceInputType;
+    // Accumulators for the type of the first object. Cleared on
+    // reset.
+    Statistics* pStatistics;
+    bool bVarianceConnected, bExtremaConnected;
   };
   PII_D_FUNC;
 
   template <class T> void average(const PiiVariant& obj);
   template <class T> void matrixAverage(const PiiVariant& obj);
   template <class T, class ResultType> void averageTemplate(const PiiVariant& obj);
+  template <class T> T circularAverage();
   template <class T> void addImpl(T& op1, T op2, int index);
   template <class T> void scaleImpl(T& result, int cnt);
   template <class T> void add(T& op1, const T& op2, int index);
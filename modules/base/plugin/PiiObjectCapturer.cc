@@ -21,10 +21,17 @@
 
 PiiObjectCapturer::Data::Data() :
   iDynamicInputCount(1),
-  listMode(OneListPerInput)
+  listMode(OneListPerInput),
+  iMailboxCapacity(0),
+  pMailbox(0)
 {
 }
 
+PiiObjectCapturer::Data::~Data()
+{
+  delete pMailbox;
+}
+
 PiiObjectCapturer::PiiObjectCapturer() :
   PiiDefaultOperation(new Data)
 {
@@ -37,6 +44,7 @@ PiiObjectCapturer::PiiObjectCapturer() :
 
   setProtectionLevel("dynamicInputCount", WriteWhenStopped);
   setProtectionLevel("listMode", WriteWhenStopped);
+  setProtectionLevel("mailboxCapacity", WriteWhenStopped);
 }
 
 PiiObjectCapturer::~PiiObjectCapturer()
@@ -44,11 +52,32 @@ PiiObjectCapturer::~PiiObjectCapturer()
 
 void PiiObjectCapturer::check(bool reset)
 {
+  PII_D;
   PiiDefaultOperation::check(reset);
   if (reset)
-    clearObjects();
+    {
+      clearObjects();
+      d->iDroppedCount.store(0);
+    }
 }
 
+QList<PiiVariant> PiiObjectCapturer::takeCapturedObjects()
+{
+  PII_D;
+  QList<PiiVariant> lstObjects;
+  if (d->pMailbox == 0)
+    return lstObjects;
+  // Acknowledge first so that objects arriving during the loop
+  // trigger a new notification.
+  d->pMailbox->acknowledge();
+  PiiVariant obj;
+  while (d->pMailbox->takeFirst(obj))
+    lstObjects << obj;
+  return lstObjects;
+}
+
+int PiiObjectCapturer::droppedObjectCount() const { return _d()->iDroppedCount.load(); }
+
 PiiInputSocket* PiiObjectCapturer::input(const QString &name) const
 {
   if (name == "input")
@@ -96,7 +125,14 @@ void PiiObjectCapturer::process()
       else
         {
           if (d->iDynamicInputCount == 1)
-            emit objectCaptured(inputAt(1)->firstObject());
+            {
+              if (d->pMailbox == 0)
+                emit objectCaptured(inputAt(1)->firstObject());
+              else if (!d->pMailbox->append(inputAt(1)->firstObject()))
+                d->iDroppedCount.ref();
+              else if (d->pMailbox->notify())
+                emit objectsAvailable();
+            }
           else
             {
               QVariantList lstObjects;
@@ -150,3 +186,14 @@ int PiiObjectCapturer::dynamicInputCount() const { return _d()->iDynamicInputCou
 
 void PiiObjectCapturer::setListMode(ListMode listMode) { _d()->listMode = listMode; }
 PiiObjectCapturer::ListMode PiiObjectCapturer::listMode() const { return _d()->listMode; }
+
+void PiiObjectCapturer::setMailboxCapacity(int mailboxCapacity)
+{
+  PII_D;
+  mailboxCapacity = qMax(mailboxCapacity, 0);
+  d->iMailboxCapacity = mailboxCapacity;
+  delete d->pMailbox;
+  d->pMailbox = mailboxCapacity > 0 ? new PiiMailbox<PiiVariant>(mailboxCapacity) : 0;
+}
+
+int PiiObjectCapturer::mailboxCapacity() const { return _d()->iMailboxCapacity; }
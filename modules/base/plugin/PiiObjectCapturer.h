@@ -17,6 +17,7 @@
 #define _PIIOBJECTCAPTURER_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiMailbox.h>
 #include <QVariantList>
 
 /**
@@ -33,6 +34,27 @@
  * @in inputX - reads in objects of any type. X ranges from 1 to
  * [dynamicInputCount] - 1. `input0` can also be accessed as `input`.
  *
+ * Mailbox delivery
+ * ----------------
+ *
+ * Each queued signal emission allocates an event and copies its
+ * arguments. At thousands of objects per second, this becomes a
+ * bottleneck for the receiving thread. If [mailboxCapacity] is
+ * greater than zero and objects would be emitted with
+ * objectCaptured(), they are instead put into a lock-free mailbox,
+ * and objectsAvailable() is emitted once for a batch of objects. The
+ * receiver fetches the objects with takeCapturedObjects().
+ *
+ * ~~~(c++)
+ * // In the GUI thread
+ * connect(pCapturer, SIGNAL(objectsAvailable()), this, SLOT(readObjects()), Qt::QueuedConnection);
+ *
+ * void MyWidget::readObjects()
+ * {
+ *   QList<PiiVariant> lstObjects = pCapturer->takeCapturedObjects();
+ *   // ...
+ * }
+ * ~~~
  */
 class PiiObjectCapturer : public PiiDefaultOperation
 {
@@ -51,6 +73,15 @@ class PiiObjectCapturer : public PiiDefaultOperation
   Q_PROPERTY(ListMode listMode READ listMode WRITE setListMode);
   Q_ENUMS(ListMode);
 
+  /**
+   * The maximum number of objects waiting in the mailbox. Zero (the
+   * default) disables the mailbox, and objectCaptured() is emitted
+   * for each object. If the receiver falls behind and the mailbox
+   * becomes full, new objects will be dropped. See
+   * [droppedObjectCount()].
+   */
+  Q_PROPERTY(int mailboxCapacity READ mailboxCapacity WRITE setMailboxCapacity);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -80,6 +111,21 @@ public:
 
   void check(bool reset);
 
+  /**
+   * Removes all objects currently in the mailbox and returns them in
+   * the order they were captured. The objects are the ones that
+   * would have been passed to objectCaptured() if [mailboxCapacity]
+   * was zero. This function must be called from one thread at a
+   * time, usually from a slot connected to objectsAvailable().
+   */
+  QList<PiiVariant> takeCapturedObjects();
+
+  /**
+   * Returns the number of objects dropped because the mailbox was
+   * full. The counter is reset by check().
+   */
+  int droppedObjectCount() const;
+
 signals:
   /**
    * Emitted for each incoming object if the `sync` input is not
@@ -103,6 +149,12 @@ signals:
    * contain PiiVariants.
    */
   void objectsCaptured(const PiiVariant& syncObject, const QVariantList& objects);
+  /**
+   * Emitted when new objects arrive to an empty mailbox. The signal
+   * will not be emitted again until takeCapturedObjects() has been
+   * called. Only used if [mailboxCapacity] is greater than zero.
+   */
+  void objectsAvailable();
 
 protected:
   /// @internal
@@ -110,11 +162,15 @@ protected:
   {
   public:
     Data();
+    ~Data();
     PiiInputSocket *pSyncInput;
     PiiVariant syncObject;
     QList<QVariantList> lstObjects;
     int iDynamicInputCount;
     ListMode listMode;
+    int iMailboxCapacity;
+    PiiMailbox<PiiVariant>* pMailbox;
+    PiiAtomicInt iDroppedCount;
   };
   PII_D_FUNC;
 
@@ -127,6 +183,9 @@ protected:
   void setListMode(ListMode listMode);
   ListMode listMode() const;
 
+  void setMailboxCapacity(int mailboxCapacity);
+  int mailboxCapacity() const;
+
 private:
   void initObjectList();
   void clearObjects();
@@ -15,6 +15,7 @@
 
 #include "PiiTriggerSource.h"
 #include <PiiYdinTypes.h>
+#include <PiiTimer.h>
 #include <QMutexLocker>
 
 PiiTriggerSource::Data::Data()
@@ -31,7 +32,10 @@ template <class T> void PiiTriggerSource::emitValue(T value)
   QMutexLocker lock(&_d()->stateMutex);
 
   if (state() == Running)
-    emitObject(value);
+    {
+      PiiYdin::setCurrentOriginTime(PiiTimer::timestamp());
+      emitObject(value);
+    }
 }
 
 void PiiTriggerSource::trigger(const PiiVariant& value)
@@ -14,9 +14,11 @@
  */
 
 #include "PiiCalibration.h"
+#include "PiiCalibrationKernels.h"
 
 #include <cstring>
 #include <QCoreApplication>
+#include <QVector>
 
 #ifndef PII_NO_OPENCV
 #  include <PiiOpenCv.h>
@@ -94,6 +96,40 @@ namespace PiiCalibration
   }
 
 
+  // The maximum number of views calibrated with OpenCV.
+  static const int iMaxInitialCalibrationViews = 16;
+
+  // Calculates the positions of the views that were not used in
+  // initial calibration.
+  class CameraPositionStrip
+  {
+  public:
+    CameraPositionStrip(const QList<PiiMatrix<double> >& worldPoints,
+                        const QList<PiiMatrix<double> >& imagePoints,
+                        const CameraParameters& intrinsic,
+                        const QVector<bool>& known,
+                        QVector<RelativePosition>& positions) :
+      _worldPoints(worldPoints), _imagePoints(imagePoints),
+      _intrinsic(intrinsic), _known(known), _positions(positions)
+    {}
+
+    void operator() (int firstView, int endView)
+    {
+      for (int view = firstView; view < endView; ++view)
+        if (!_known[view])
+          _positions[view] = calculateCameraPosition(_worldPoints.size() == 1 ? _worldPoints[0] : _worldPoints[view],
+                                                     _imagePoints[view],
+                                                     _intrinsic);
+    }
+
+  private:
+    const QList<PiiMatrix<double> >& _worldPoints;
+    const QList<PiiMatrix<double> >& _imagePoints;
+    const CameraParameters& _intrinsic;
+    const QVector<bool>& _known;
+    QVector<RelativePosition>& _positions;
+  };
+
   /************************************************************************
    * Main calibration functions
    ************************************************************************/
@@ -101,7 +137,8 @@ namespace PiiCalibration
                        const QList<PiiMatrix<double> >& imagePoints,
                        CameraParameters& intrinsic,
                        QList<RelativePosition>* extrinsic,
-                       CalibrationOptions options)
+                       CalibrationOptions options,
+                       const PiiParallelPolicy& policy)
 
   {
     if (worldPoints.size() == 0 || imagePoints.size() == 0 ||
@@ -134,43 +171,45 @@ namespace PiiCalibration
 
 
     int viewCount = imagePoints.size();
-    int totalPoints = 0;
-    // Create a 1-by-N one-channel int matrix
-    CvMat* pCounts = cvCreateMat(1, imagePoints.size(), CV_32SC1);
 
-    // Calculate the total number of points and check everything is OK
-    // for calibration.
+    // Check everything is OK for calibration.
     for (int view=0; view < viewCount; ++view)
       {
         int points = imagePoints[view].rows();
         // Check that there are enough points for calibration
         if (points < 4)
-          {
-            cvReleaseMat(&pCounts);
-            PII_THROW(PiiCalibrationException,
-                      tr("The number of calibration points per view must be at least four. View %1 has only %2.").arg(view).arg(points));
-          }
+          PII_THROW(PiiCalibrationException,
+                    tr("The number of calibration points per view must be at least four. View %1 has only %2.").arg(view).arg(points));
         const PiiMatrix<double>& currentWorldPoints = worldPoints.size() == 1 ? worldPoints[0] : worldPoints[view];
         int wPoints = currentWorldPoints.rows();
         // Check that the number of points match
         if (wPoints != points)
-          {
-            cvReleaseMat(&pCounts);
-            PII_THROW(PiiCalibrationException,
-                      tr("The number of calibration points per view must match. View %1 has %2 world points and %3 image points.")
-                      .arg(view).arg(wPoints).arg(points));
-          }
+          PII_THROW(PiiCalibrationException,
+                    tr("The number of calibration points per view must match. View %1 has %2 world points and %3 image points.")
+                    .arg(view).arg(wPoints).arg(points));
         // Check input dimensions
         if (currentWorldPoints.columns() != 3 || imagePoints[view].columns() != 2)
-          {
-            cvReleaseMat(&pCounts);
-            PII_THROW(PiiCalibrationException,
-                      tr("Incorrect point dimensions. View %1 has a %2-dimensional world space and a %3-dimensional image space.")
-                      .arg(view).arg(currentWorldPoints.columns()).arg(imagePoints[view].columns()));
-          }
+          PII_THROW(PiiCalibrationException,
+                    tr("Incorrect point dimensions. View %1 has a %2-dimensional world space and a %3-dimensional image space.")
+                    .arg(view).arg(currentWorldPoints.columns()).arg(imagePoints[view].columns()));
+      }
+
+    // OpenCV's dense solver becomes slow with many views. Calibrate
+    // with evenly spaced views first and refine over all of them
+    // later.
+    QList<int> lstInitialViews;
+    int initialViewCount = qMin(viewCount, iMaxInitialCalibrationViews);
+    for (int i=0; i<initialViewCount; ++i)
+      lstInitialViews << i * viewCount / initialViewCount;
 
+    int totalPoints = 0;
+    // Create a 1-by-N one-channel int matrix
+    CvMat* pCounts = cvCreateMat(1, initialViewCount, CV_32SC1);
+    for (int i=0; i<initialViewCount; ++i)
+      {
+        int points = imagePoints[lstInitialViews[i]].rows();
         totalPoints += points;
-        pCounts->data.i[view] = points;
+        pCounts->data.i[i] = points;
       }
 
     // Collect all world points here (64-bit double coordinates)
@@ -179,8 +218,9 @@ namespace PiiCalibration
 
     // Go through all points in all views and store to the OpenCv
     // matrices.
-    for (int view = 0, pointIndex = 0; view < viewCount; ++view)
+    for (int i = 0, pointIndex = 0; i < initialViewCount; ++i)
       {
+        int view = lstInitialViews[i];
         const PiiMatrix<double>& currentWorldPoints = worldPoints.size() == 1 ? worldPoints[0] : worldPoints[view];
         for (int r=0; r<imagePoints[view].rows(); ++r, ++pointIndex)
           {
@@ -201,8 +241,8 @@ namespace PiiCalibration
     CvMat* pDistortionCoeffs = createDistortionCoeffs(intrinsic);
 
     // Extrinsic parameters for each view are stored in these double matrices.
-    CvMat* pRotationVectors = PiiOpenCv::cvMat<double>(viewCount, 3);
-    CvMat* pTranslationVectors = PiiOpenCv::cvMat<double>(viewCount, 3);
+    CvMat* pRotationVectors = PiiOpenCv::cvMat<double>(initialViewCount, 3);
+    CvMat* pTranslationVectors = PiiOpenCv::cvMat<double>(initialViewCount, 3);
 
     cvCalibrateCamera2(pWorldPoints, pImagePoints,
                        pCounts, imageSize,
@@ -213,18 +253,31 @@ namespace PiiCalibration
     // Store intrinsic parameters back to the structure
     storeCameraParameters(intrinsic, pIntrinsicMatrix, pDistortionCoeffs);
 
-    // Store extrinsic parameters if needed.
-    if (extrinsic != 0)
+    // Initialize the rotation and translation vectors directly from
+    // the corresponding matrix rows.
+    QList<RelativePosition> lstPositions;
+    if (initialViewCount == viewCount)
+      {
+        if (extrinsic != 0)
+          for (int view = 0; view < viewCount; ++view)
+            lstPositions.append(createRelativePosition(pRotationVectors,
+                                                       pTranslationVectors,
+                                                       view));
+      }
+    else
       {
-        extrinsic->clear();
-        for (int view = 0; view < viewCount; ++view)
+        QVector<RelativePosition> vecPositions(viewCount);
+        QVector<bool> vecKnown(viewCount, false);
+        for (int i = 0; i < initialViewCount; ++i)
           {
-            // Initialize the rotation and translation vectors
-            // directly from the corresponding matrix rows.
-            extrinsic->append(createRelativePosition(pRotationVectors,
-                                                     pTranslationVectors,
-                                                     view));
+            vecPositions[lstInitialViews[i]] = createRelativePosition(pRotationVectors,
+                                                                      pTranslationVectors,
+                                                                      i);
+            vecKnown[lstInitialViews[i]] = true;
           }
+        CameraPositionStrip positionStrip(worldPoints, imagePoints, intrinsic, vecKnown, vecPositions);
+        Pii::forEachStrip(viewCount, positionStrip, policy);
+        lstPositions = vecPositions.toList();
       }
 
     // Destroy all temporary matrices
@@ -235,6 +288,13 @@ namespace PiiCalibration
     cvReleaseMat(&pDistortionCoeffs);
     cvReleaseMat(&pRotationVectors);
     cvReleaseMat(&pTranslationVectors);
+
+    if (initialViewCount < viewCount)
+      refineCalibration(worldPoints, imagePoints, intrinsic, lstPositions, options, policy);
+
+    // Store extrinsic parameters if needed.
+    if (extrinsic != 0)
+      *extrinsic = lstPositions;
   }
 
   RelativePosition calculateCameraPosition(const PiiMatrix<double>& worldPoints,
@@ -612,31 +672,35 @@ namespace PiiCalibration
   }
 
 
+  // Runs the fused projection kernel on all rows of points.
+  static PiiMatrix<double> projectToPixelCoordinates(const PiiMatrix<double>& points,
+                                                     int dimensions, int resultColumns,
+                                                     const ProjectionKernel& kernel)
+  {
+    PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(points.rows(), resultColumns));
+    if (points.rows() > 0)
+      kernel.project(points[0], int(points.stride() / sizeof(double)), dimensions, points.rows(),
+                     matResult[0], int(matResult.stride() / sizeof(double)));
+    return matResult;
+  }
+
   PiiMatrix<double> normalizedToPixelCoordinates(const PiiMatrix<double>& points,
                                                  const CameraParameters& intrinsic)
   {
-
-    PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(points.rows(), points.columns()));
-    for (int row=0; row < points.rows(); ++row)
-      {
-        const double* pSource = points[row];
-        double* pTarget = matResult[row];
-        normalizedToPixelCoordinates(intrinsic, pSource[0], pSource[1], pTarget, pTarget+1);
-      }
-    return matResult;
+    return projectToPixelCoordinates(points, 2, points.columns(), ProjectionKernel(intrinsic));
   }
 
   PiiMatrix<double> cameraToPixelCoordinates(const PiiMatrix<double>& points,
                                              const CameraParameters& intrinsic)
   {
-    return normalizedToPixelCoordinates(perspectiveProjection(points),intrinsic);
+    return projectToPixelCoordinates(points, 3, 2, ProjectionKernel(intrinsic));
   }
 
   PiiMatrix<double> worldToPixelCoordinates(const PiiMatrix<double>& points,
                                             const RelativePosition& extrinsic,
                                             const CameraParameters& intrinsic)
   {
-    return cameraToPixelCoordinates(worldToCameraCoordinates(points, extrinsic), intrinsic);
+    return projectToPixelCoordinates(points, 3, 2, ProjectionKernel(intrinsic, &extrinsic));
   }
 
   PiiMatrix<double> perspectiveProjection(const PiiMatrix<double>& points,
@@ -21,6 +21,7 @@
 #include <PiiVector.h>
 #include <PiiGeometricObjects.h>
 #include <PiiImage.h>
+#include <PiiParallel.h>
 
 /**
  * Functions for camera calibration.
@@ -218,6 +219,18 @@ namespace PiiCalibration
    * @param options a logical OR of calibration options, e.g.
    * `EstimateIntrinsic` | `NoTangentialDistortion`.
    *
+   * @param policy the execution policy used in refining the solution
+   * over a large number of views. The views are divided into strips;
+   * see [refineCalibration()].
+   *
+   * OpenCV optimizes all parameters with a dense Levenberg-Marquardt
+   * solver whose cost grows quickly with the number of views. If
+   * more than 16 views are given, an initial estimate is calculated
+   * from 16 evenly spaced views only. The positions of the rest of
+   * the views are then calculated with the initial intrinsic
+   * parameters, and all parameters are refined over all views with
+   * [refineCalibration()].
+   *
    * @exception PiiCalibrationException& if the calibration cannot be
    * performed with the given data.
    */
@@ -225,7 +238,8 @@ namespace PiiCalibration
                                               const QList<PiiMatrix<double> >& imagePoints,
                                               CameraParameters& intrinsic,
                                               QList<RelativePosition>* extrinsic = 0,
-                                              CalibrationOptions options = EstimateIntrinsic);
+                                              CalibrationOptions options = EstimateIntrinsic,
+                                              const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
 
   /**
    * Calculate the position of the camera reference frame with respect
@@ -254,6 +268,60 @@ namespace PiiCalibration
 
 #endif //PII_NO_OPENCV
 
+  /**
+   * Refines the intrinsic and extrinsic parameters of a calibrated
+   * camera by minimizing the reprojection error over all views. The
+   * parameters are optimized with a sparse Levenberg-Marquardt
+   * solver that exploits the structure of the problem: the
+   * extrinsic parameters of a view only affect the points in that
+   * view, and the intrinsic parameters are shared by all views. The
+   * extrinsic parameters are eliminated from the normal equations
+   * view by view (Schur complement), leaving a small system for the
+   * intrinsic parameters only. The cost of an iteration is linear in
+   * the number of views.
+   *
+   * The distortion model is the same as in [calibrateCamera()]. This
+   * function needs reasonable initial values for all parameters,
+   * for example a solution calculated from a subset of the views.
+   *
+   * @param worldPoints the world coordinates of the calibration
+   * points in each view. See [calibrateCamera()].
+   *
+   * @param imagePoints the corresponding image coordinates in each
+   * view.
+   *
+   * @param intrinsic initial values for the intrinsic parameters.
+   * Will be replaced with the refined values.
+   *
+   * @param extrinsic initial positions of the camera in each view.
+   * Will be replaced with the refined values.
+   *
+   * @param options a logical OR of `FixPrincipalPoint`,
+   * `FixAspectRatio` and `NoTangentialDistortion`. Other options
+   * are ignored. With `NoTangentialDistortion`, the tangential
+   * distortion factors are set to zero.
+   *
+   * @param policy the execution policy. Views are divided into
+   * strips, and the Jacobians and residuals of the strips are
+   * evaluated concurrently. The results do not depend on the number
+   * of threads.
+   *
+   * @param maxIterations the maximum number of Levenberg-Marquardt
+   * iterations.
+   *
+   * @return the root-mean-square reprojection error over all
+   * points, in pixels.
+   *
+   * @exception PiiCalibrationException& if the input data is invalid.
+   */
+  PII_CALIBRATION_EXPORT double refineCalibration(const QList<PiiMatrix<double> >& worldPoints,
+                                                  const QList<PiiMatrix<double> >& imagePoints,
+                                                  CameraParameters& intrinsic,
+                                                  QList<RelativePosition>& extrinsic,
+                                                  CalibrationOptions options = NoCalibrationOptions,
+                                                  const PiiParallelPolicy& policy = PiiParallelPolicy::sequential(),
+                                                  int maxIterations = 50);
+
   /**
    * Calculate the relative position of `camera2` with respect to
    * `camera1`. When the positions of the cameras have been calculated
@@ -420,6 +488,10 @@ namespace PiiCalibration
 
   /**
    * Transform points from world coordinates to pixel coordinates.
+   * The result is the same as that of cameraToPixelCoordinates()
+   * applied to the output of worldToCameraCoordinates(), but all
+   * stages are calculated in one vectorized pass without temporary
+   * matrices.
    *
    * @param points input points in the world coordinate system. A
    * N-by-3 matrix (x,y,z).
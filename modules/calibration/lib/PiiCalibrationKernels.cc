@@ -0,0 +1,276 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCalibrationKernels.h"
+
+#include <PiiCpu.h>
+#include <cstring>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_PROJECTION_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_PROJECTION_AVX2 1
+#  endif
+#elif defined(PII_NEON) && defined(__aarch64__)
+// Double-precision vectors are not available on 32-bit ARM.
+#  include <arm_neon.h>
+#  define PII_PROJECTION_NEON 1
+#endif
+
+namespace
+{
+  /* The rigid transformation and camera parameters in the form the
+     loops want them. Normalized input uses an identity
+     transformation and a unit z coordinate, which leaves the
+     coordinates untouched.
+   */
+  struct Constants
+  {
+    const double* pRotation;
+    const double* pTranslation;
+    double fx, fy, cx, cy, k1, k2, p1, p2, twoP1, twoP2;
+  };
+
+  void projectTail(const Constants& k, const double* points, int pointStride, bool planar,
+                   int i, int count, double* pixels, int pixelStride)
+  {
+    const double* r = k.pRotation;
+    const double* t = k.pTranslation;
+    for (; i<count; ++i)
+      {
+        const double* p = points + i*pointStride;
+        double x = p[0], y = p[1], z = planar ? 1.0 : p[2];
+        double cameraX = r[0]*x + r[1]*y + r[2]*z + t[0];
+        double cameraY = r[3]*x + r[4]*y + r[5]*z + t[1];
+        double cameraZ = r[6]*x + r[7]*y + r[8]*z + t[2];
+        x = cameraX / cameraZ;
+        y = cameraY / cameraZ;
+        double x2 = x*x, y2 = y*y, xy = x*y, r2 = x2 + y2;
+        double radial = 1.0 + k.k1 * r2 + k.k2 * r2 * r2;
+        double tangentialX = k.twoP1*xy + k.p2*(r2 + 2*x2);
+        double tangentialY = k.p1*(r2 + 2*y2) + k.twoP2*xy;
+        double* pPixel = pixels + i*pixelStride;
+        pPixel[0] = k.fx * (x*radial + tangentialX) + k.cx;
+        pPixel[1] = k.fy * (y*radial + tangentialY) + k.cy;
+      }
+  }
+
+  bool isVectorized()
+  {
+#if defined(PII_PROJECTION_SSE2)
+    return Pii::hasCpuFeature(Pii::CpuSse2) || Pii::hasCpuFeature(Pii::CpuAvx2);
+#elif defined(PII_PROJECTION_NEON)
+    return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+    return false;
+#endif
+  }
+}
+
+/* Points are stored row by row. Ops::gather() collects one
+   coordinate of Width consecutive points into a vector, and
+   Ops::scatter() stores Width (x,y) pairs. The operations are in the
+   same order as in projectTail().
+ */
+#define PII_PROJECTION_LOOPS(TARGET)                                    \
+  TARGET int project(const Constants& k, const double* points, int pointStride, bool planar, \
+                     int count, double* pixels, int pixelStride)        \
+  {                                                                     \
+    const double* r = k.pRotation;                                      \
+    const double* t = k.pTranslation;                                   \
+    const Vec r0 = Ops::set1(r[0]), r1 = Ops::set1(r[1]), r2 = Ops::set1(r[2]); \
+    const Vec r3 = Ops::set1(r[3]), r4 = Ops::set1(r[4]), r5 = Ops::set1(r[5]); \
+    const Vec r6 = Ops::set1(r[6]), r7 = Ops::set1(r[7]), r8 = Ops::set1(r[8]); \
+    const Vec t0 = Ops::set1(t[0]), t1 = Ops::set1(t[1]), t2 = Ops::set1(t[2]); \
+    const Vec one = Ops::set1(1.0), two = Ops::set1(2.0);               \
+    const Vec k1 = Ops::set1(k.k1), k2 = Ops::set1(k.k2);               \
+    const Vec p1 = Ops::set1(k.p1), p2 = Ops::set1(k.p2);               \
+    const Vec twoP1 = Ops::set1(k.twoP1), twoP2 = Ops::set1(k.twoP2);   \
+    const Vec fx = Ops::set1(k.fx), fy = Ops::set1(k.fy);               \
+    const Vec cx = Ops::set1(k.cx), cy = Ops::set1(k.cy);               \
+    int i = 0;                                                          \
+    for (; i <= count - Ops::Width; i += Ops::Width)                    \
+      {                                                                 \
+        const double* p = points + i*pointStride;                       \
+        const Vec x = Ops::gather(p, pointStride);                      \
+        const Vec y = Ops::gather(p + 1, pointStride);                  \
+        const Vec z = planar ? one : Ops::gather(p + 2, pointStride);   \
+        const Vec cameraX = Ops::add(Ops::add(Ops::add(Ops::mul(r0, x), Ops::mul(r1, y)), Ops::mul(r2, z)), t0); \
+        const Vec cameraY = Ops::add(Ops::add(Ops::add(Ops::mul(r3, x), Ops::mul(r4, y)), Ops::mul(r5, z)), t1); \
+        const Vec cameraZ = Ops::add(Ops::add(Ops::add(Ops::mul(r6, x), Ops::mul(r7, y)), Ops::mul(r8, z)), t2); \
+        const Vec nx = Ops::div(cameraX, cameraZ);                      \
+        const Vec ny = Ops::div(cameraY, cameraZ);                      \
+        const Vec x2 = Ops::mul(nx, nx), y2 = Ops::mul(ny, ny), xy = Ops::mul(nx, ny); \
+        const Vec rr = Ops::add(x2, y2);                                \
+        const Vec radial = Ops::add(Ops::add(one, Ops::mul(k1, rr)), Ops::mul(Ops::mul(k2, rr), rr)); \
+        const Vec tangentialX = Ops::add(Ops::mul(twoP1, xy), Ops::mul(p2, Ops::add(rr, Ops::mul(two, x2)))); \
+        const Vec tangentialY = Ops::add(Ops::mul(p1, Ops::add(rr, Ops::mul(two, y2))), Ops::mul(twoP2, xy)); \
+        const Vec u = Ops::add(Ops::mul(fx, Ops::add(Ops::mul(nx, radial), tangentialX)), cx); \
+        const Vec v = Ops::add(Ops::mul(fy, Ops::add(Ops::mul(ny, radial), tangentialY)), cy); \
+        Ops::scatter(pixels + i*pixelStride, pixelStride, u, v);        \
+      }                                                                 \
+    Ops::done();                                                        \
+    return i;                                                           \
+  }
+
+#ifdef PII_PROJECTION_SSE2
+namespace Sse2
+{
+  struct Ops
+  {
+    enum { Width = 2 };
+    static inline __m128d set1(double value) { return _mm_set1_pd(value); }
+    static inline __m128d gather(const double* p, int stride) { return _mm_loadh_pd(_mm_load_sd(p), p + stride); }
+    static inline void scatter(double* p, int stride, __m128d u, __m128d v)
+    {
+      _mm_storeu_pd(p, _mm_unpacklo_pd(u, v));
+      _mm_storeu_pd(p + stride, _mm_unpackhi_pd(u, v));
+    }
+    static inline __m128d add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+    static inline __m128d mul(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+    static inline __m128d div(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+    static inline void done() {}
+  };
+  typedef __m128d Vec;
+
+  PII_PROJECTION_LOOPS(static)
+}
+#endif
+
+#ifdef PII_PROJECTION_AVX2
+namespace Avx2
+{
+#  define PII_AVX2 PII_TARGET("avx2")
+
+  struct Ops
+  {
+    enum { Width = 4 };
+    PII_AVX2 static inline __m256d set1(double value) { return _mm256_set1_pd(value); }
+    PII_AVX2 static inline __m256d gather(const double* p, int stride)
+    {
+      return _mm256_setr_pd(p[0], p[stride], p[2*stride], p[3*stride]);
+    }
+    PII_AVX2 static inline void scatter(double* p, int stride, __m256d u, __m256d v)
+    {
+      // (u0 v0 u2 v2) and (u1 v1 u3 v3)
+      __m256d even = _mm256_unpacklo_pd(u, v), odd = _mm256_unpackhi_pd(u, v);
+      _mm_storeu_pd(p, _mm256_castpd256_pd128(even));
+      _mm_storeu_pd(p + stride, _mm256_castpd256_pd128(odd));
+      _mm_storeu_pd(p + 2*stride, _mm256_extractf128_pd(even, 1));
+      _mm_storeu_pd(p + 3*stride, _mm256_extractf128_pd(odd, 1));
+    }
+    PII_AVX2 static inline __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    PII_AVX2 static inline __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    PII_AVX2 static inline __m256d div(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+    // Dirty upper halves would slow down the SSE code that follows.
+    PII_AVX2 static inline void done() { _mm256_zeroupper(); }
+  };
+  typedef __m256d Vec;
+
+  PII_PROJECTION_LOOPS(PII_AVX2 static)
+
+#  undef PII_AVX2
+}
+#endif
+
+#ifdef PII_PROJECTION_NEON
+namespace Neon
+{
+  struct Ops
+  {
+    enum { Width = 2 };
+    static inline float64x2_t set1(double value) { return vdupq_n_f64(value); }
+    static inline float64x2_t gather(const double* p, int stride) { return vcombine_f64(vld1_f64(p), vld1_f64(p + stride)); }
+    static inline void scatter(double* p, int stride, float64x2_t u, float64x2_t v)
+    {
+      vst1q_f64(p, vzip1q_f64(u, v));
+      vst1q_f64(p + stride, vzip2q_f64(u, v));
+    }
+    static inline float64x2_t add(float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }
+    static inline float64x2_t mul(float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }
+    static inline float64x2_t div(float64x2_t a, float64x2_t b) { return vdivq_f64(a, b); }
+    static inline void done() {}
+  };
+  typedef float64x2_t Vec;
+
+  PII_PROJECTION_LOOPS(static)
+}
+#endif
+
+#undef PII_PROJECTION_LOOPS
+
+namespace PiiCalibration
+{
+  ProjectionKernel::ProjectionKernel(const CameraParameters& intrinsic,
+                                     const RelativePosition* extrinsic)
+  {
+    static const double aIdentity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    if (extrinsic != 0)
+      {
+        PiiMatrix<double> matRotation(extrinsic->rotationMatrix());
+        for (int r=0; r<3; ++r)
+          for (int c=0; c<3; ++c)
+            _adRotation[r*3+c] = matRotation(r,c);
+        std::memcpy(_adTranslation, extrinsic->translation.values, sizeof(_adTranslation));
+      }
+    else
+      {
+        std::memcpy(_adRotation, aIdentity, sizeof(_adRotation));
+        std::memset(_adTranslation, 0, sizeof(_adTranslation));
+      }
+
+    _adIntrinsic[0] = intrinsic.focalLength.x;
+    _adIntrinsic[1] = intrinsic.focalLength.y;
+    _adIntrinsic[2] = intrinsic.center.x;
+    _adIntrinsic[3] = intrinsic.center.y;
+    _adIntrinsic[4] = intrinsic.k1;
+    _adIntrinsic[5] = intrinsic.k2;
+    _adIntrinsic[6] = intrinsic.p1;
+    _adIntrinsic[7] = intrinsic.p2;
+  }
+
+  void ProjectionKernel::project(const double* points, int pointStride, int dimensions, int count,
+                                 double* pixels, int pixelStride) const
+  {
+    static const double aIdentity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    static const double aZero[3] = { 0, 0, 0 };
+    const bool bPlanar = dimensions == 2;
+    Constants k =
+      {
+        bPlanar ? aIdentity : _adRotation,
+        bPlanar ? aZero : _adTranslation,
+        _adIntrinsic[0], _adIntrinsic[1], _adIntrinsic[2], _adIntrinsic[3],
+        _adIntrinsic[4], _adIntrinsic[5], _adIntrinsic[6], _adIntrinsic[7],
+        2*_adIntrinsic[6], 2*_adIntrinsic[7]
+      };
+
+    int i = 0;
+    if (isVectorized())
+      {
+#if defined(PII_PROJECTION_AVX2)
+        if (Pii::hasCpuFeature(Pii::CpuAvx2))
+          i = Avx2::project(k, points, pointStride, bPlanar, count, pixels, pixelStride);
+        else
+          i = Sse2::project(k, points, pointStride, bPlanar, count, pixels, pixelStride);
+#elif defined(PII_PROJECTION_SSE2)
+        i = Sse2::project(k, points, pointStride, bPlanar, count, pixels, pixelStride);
+#elif defined(PII_PROJECTION_NEON)
+        i = Neon::project(k, points, pointStride, bPlanar, count, pixels, pixelStride);
+#endif
+      }
+    projectTail(k, points, pointStride, bPlanar, i, count, pixels, pixelStride);
+  }
+}
@@ -0,0 +1,68 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICALIBRATIONKERNELS_H
+#define _PIICALIBRATIONKERNELS_H
+
+#include "PiiCalibration.h"
+
+namespace PiiCalibration
+{
+  /**
+   * A fused kernel that takes points straight to distorted pixel
+   * coordinates. The rigid transformation, perspective division,
+   * lens distortion and the mapping to pixel coordinates are
+   * calculated in one pass with SSE2, AVX2 or NEON instructions,
+   * without temporary matrices. If the CPU lacks the instructions,
+   * scalar code is used.
+   *
+   * The arithmetic is the same, operation by operation, as in
+   * [worldToCameraCoordinates()], [perspectiveProjection()] and
+   * [normalizedToPixelCoordinates()]. Thus, the results are
+   * identical to those of the unfused functions.
+   *
+   * @internal
+   */
+  class PII_CALIBRATION_EXPORT ProjectionKernel
+  {
+  public:
+    /**
+     * Creates a kernel for the given camera. If *extrinsic* is
+     * non-zero, points are assumed to be in world coordinates.
+     * Otherwise they are in the camera reference frame.
+     */
+    ProjectionKernel(const CameraParameters& intrinsic,
+                     const RelativePosition* extrinsic = 0);
+
+    /**
+     * Projects *count* points to pixel coordinates. *points* points
+     * to the first point, and consecutive points are *pointStride*
+     * doubles apart. If *dimensions* is two, the points are taken to
+     * be normalized image coordinates, and the rigid transformation
+     * and perspective division are skipped. Otherwise, *dimensions*
+     * must be three. *pixels* receives (x,y) pairs *pixelStride*
+     * doubles apart.
+     */
+    void project(const double* points, int pointStride, int dimensions, int count,
+                 double* pixels, int pixelStride) const;
+
+  private:
+    double _adRotation[9];
+    double _adTranslation[3];
+    double _adIntrinsic[8];
+  };
+}
+
+#endif //_PIICALIBRATIONKERNELS_H
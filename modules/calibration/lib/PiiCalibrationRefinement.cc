@@ -0,0 +1,627 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiCalibration.h"
+
+#include <QVector>
+#include <cmath>
+#include <cstring>
+
+namespace PiiCalibration
+{
+  QString tr(const char* message);
+}
+
+namespace
+{
+  using namespace PiiCalibration;
+
+  enum { IntrinsicCount = 8, ExtrinsicCount = 6 };
+
+  /* Maps the eight intrinsic parameters (fx, fy, cx, cy, k1, k2, p1,
+     p2) to the free parameters of the optimization. Intrinsic
+     parameter i changes by adScales[i] times the free parameter
+     aiColumns[i]. A negative column means a fixed parameter.
+   */
+  struct IntrinsicModel
+  {
+    IntrinsicModel(const double* intrinsic, CalibrationOptions options) :
+      iCount(0)
+    {
+      aiColumns[0] = iCount++;
+      if (options & FixAspectRatio)
+        aiColumns[1] = 0;
+      else
+        aiColumns[1] = iCount++;
+      for (int i=2; i<4; ++i)
+        aiColumns[i] = options & FixPrincipalPoint ? -1 : iCount++;
+      for (int i=4; i<6; ++i)
+        aiColumns[i] = iCount++;
+      for (int i=6; i<8; ++i)
+        aiColumns[i] = options & NoTangentialDistortion ? -1 : iCount++;
+
+      for (int i=0; i<IntrinsicCount; ++i)
+        adScales[i] = 1;
+      if (options & FixAspectRatio)
+        adScales[1] = intrinsic[1] / intrinsic[0];
+    }
+
+    int iCount;
+    int aiColumns[IntrinsicCount];
+    double adScales[IntrinsicCount];
+  };
+
+  struct ViewPose
+  {
+    double adRotation[9];
+    double adTranslation[3];
+  };
+
+  /* The blocks of the normal equations contributed by the points of
+     a single view. U is the intrinsic block, V the extrinsic block
+     and W the cross terms. All matrices are row-major, and the
+     intrinsic dimension is the number of free parameters.
+   */
+  struct ViewTerms
+  {
+    double adU[IntrinsicCount*IntrinsicCount];
+    double adW[IntrinsicCount*ExtrinsicCount];
+    double adV[ExtrinsicCount*ExtrinsicCount];
+    double adIntrinsicGradient[IntrinsicCount];
+    double adExtrinsicGradient[ExtrinsicCount];
+  };
+
+  /* The per-view part of the Schur complement. The Cholesky factor
+     of the damped V block is retained for back substitution.
+   */
+  struct ViewReduction
+  {
+    double adFactor[ExtrinsicCount*ExtrinsicCount];
+    double adS[IntrinsicCount*IntrinsicCount];
+    double adRhs[IntrinsicCount];
+    bool bValid;
+  };
+
+  // Factorizes the symmetric n-by-n matrix a in place into its lower
+  // triangle. Returns false if a is not positive definite.
+  bool choleskyDecompose(double* a, int n)
+  {
+    for (int j=0; j<n; ++j)
+      {
+        double dDiag = a[j*n+j];
+        for (int k=0; k<j; ++k)
+          dDiag -= a[j*n+k] * a[j*n+k];
+        if (!(dDiag > 0))
+          return false;
+        dDiag = std::sqrt(dDiag);
+        a[j*n+j] = dDiag;
+        for (int i=j+1; i<n; ++i)
+          {
+            double dSum = a[i*n+j];
+            for (int k=0; k<j; ++k)
+              dSum -= a[i*n+k] * a[j*n+k];
+            a[i*n+j] = dSum / dDiag;
+          }
+      }
+    return true;
+  }
+
+  // Solves L L^T x = b in place.
+  void choleskySolve(const double* l, int n, double* b)
+  {
+    for (int i=0; i<n; ++i)
+      {
+        double dSum = b[i];
+        for (int k=0; k<i; ++k)
+          dSum -= l[i*n+k] * b[k];
+        b[i] = dSum / l[i*n+i];
+      }
+    for (int i=n; i--; )
+      {
+        double dSum = b[i];
+        for (int k=i+1; k<n; ++k)
+          dSum -= l[k*n+i] * b[k];
+        b[i] = dSum / l[i*n+i];
+      }
+  }
+
+  // Rodrigues' formula for a rotation vector.
+  void rotationMatrix(const double* v, double* r)
+  {
+    double dTheta = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if (dTheta == 0)
+      {
+        static const double aIdentity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+        std::memcpy(r, aIdentity, sizeof(aIdentity));
+        return;
+      }
+    double x = v[0] / dTheta, y = v[1] / dTheta, z = v[2] / dTheta;
+    double s = std::sin(dTheta), c = 1.0 - std::cos(dTheta);
+    r[0] = 1 - c*(y*y + z*z); r[1] = c*x*y - s*z;       r[2] = c*x*z + s*y;
+    r[3] = c*x*y + s*z;       r[4] = 1 - c*(x*x + z*z); r[5] = c*y*z - s*x;
+    r[6] = c*x*z - s*y;       r[7] = c*y*z + s*x;       r[8] = 1 - c*(x*x + y*y);
+  }
+
+  /* Converts a rotation matrix back to a rotation vector. Unlike
+     PiiCalibration::rotationMatrixToVector(), this version is stable
+     for rotations whose axes are almost but not exactly aligned with
+     a coordinate axis, which is the rule rather than the exception
+     after optimization.
+   */
+  PiiVector<double,3> rotationVector(const double* r)
+  {
+    double x = 0.5 * (r[7] - r[5]), y = 0.5 * (r[2] - r[6]), z = 0.5 * (r[3] - r[1]);
+    double dSin = std::sqrt(x*x + y*y + z*z);
+    double dCos = 0.5 * (r[0] + r[4] + r[8] - 1);
+    double dTheta = std::atan2(dSin, dCos);
+    if (dCos > -0.9)
+      {
+        double dScale = dSin > 0 ? dTheta / dSin : 1.0;
+        return PiiVector<double,3>(x * dScale, y * dScale, z * dScale);
+      }
+    // Close to pi, the antisymmetric part vanishes. Take the axis
+    // from the symmetric part instead, R + R^T = 2 cI + 2 (1-c) aa^T.
+    double adAxis[3];
+    int iMax = 0;
+    for (int i=0; i<3; ++i)
+      {
+        adAxis[i] = std::sqrt(qMax(0.0, (r[i*4] - dCos) / (1 - dCos)));
+        if (adAxis[i] > adAxis[iMax])
+          iMax = i;
+      }
+    for (int i=0; i<3; ++i)
+      if (i != iMax && r[iMax*3+i] + r[i*3+iMax] < 0)
+        adAxis[i] = -adAxis[i];
+    // The sign of the axis is given by the antisymmetric part.
+    if (adAxis[0]*x + adAxis[1]*y + adAxis[2]*z < 0)
+      for (int i=0; i<3; ++i)
+        adAxis[i] = -adAxis[i];
+    return PiiVector<double,3>(adAxis[0] * dTheta, adAxis[1] * dTheta, adAxis[2] * dTheta);
+  }
+
+  /* Projects a world point to pixel coordinates using the same
+     camera model as PiiCalibration::worldToPixelCoordinates() and
+     stores the residual (observed - projected) to *residual*. If
+     *intrinsicJacobian* is non-zero, the derivatives of the
+     projected u and v coordinates with respect to the eight
+     intrinsic parameters and to the six extrinsic parameters are
+     stored too. The extrinsic parameters are a small rotation
+     applied before the current rotation (exp([w]x) R) and an
+     additive change in translation.
+   */
+  inline void project(const double* intrinsic, const ViewPose& pose,
+                      const double* world, const double* image,
+                      double* residual,
+                      double (*intrinsicJacobian)[IntrinsicCount] = 0,
+                      double (*extrinsicJacobian)[ExtrinsicCount] = 0)
+  {
+    const double* r = pose.adRotation;
+    double qx = r[0]*world[0] + r[1]*world[1] + r[2]*world[2];
+    double qy = r[3]*world[0] + r[4]*world[1] + r[5]*world[2];
+    double qz = r[6]*world[0] + r[7]*world[1] + r[8]*world[2];
+    double dInvZ = 1.0 / (qz + pose.adTranslation[2]);
+    double x = (qx + pose.adTranslation[0]) * dInvZ, y = (qy + pose.adTranslation[1]) * dInvZ;
+
+    const double fx = intrinsic[0], fy = intrinsic[1];
+    const double k1 = intrinsic[4], k2 = intrinsic[5], p1 = intrinsic[6], p2 = intrinsic[7];
+    double x2 = x*x, y2 = y*y, xy = x*y, r2 = x2 + y2;
+    double dRadial = 1.0 + k1 * r2 + k2 * r2 * r2;
+    double dDistortedX = x*dRadial + 2*p1*xy + p2*(r2 + 2*x2);
+    double dDistortedY = y*dRadial + p1*(r2 + 2*y2) + 2*p2*xy;
+    residual[0] = image[0] - (fx * dDistortedX + intrinsic[2]);
+    residual[1] = image[1] - (fy * dDistortedY + intrinsic[3]);
+
+    if (intrinsicJacobian == 0)
+      return;
+
+    double* pU = intrinsicJacobian[0], *pV = intrinsicJacobian[1];
+    pU[0] = dDistortedX; pU[1] = 0; pU[2] = 1; pU[3] = 0;
+    pU[4] = fx*x*r2; pU[5] = fx*x*r2*r2; pU[6] = fx*2*xy; pU[7] = fx*(r2 + 2*x2);
+    pV[0] = 0; pV[1] = dDistortedY; pV[2] = 0; pV[3] = 1;
+    pV[4] = fy*y*r2; pV[5] = fy*y*r2*r2; pV[6] = fy*(r2 + 2*y2); pV[7] = fy*2*xy;
+
+    // Derivatives of pixel coordinates wrt normalized coordinates.
+    double dRadialDerivative = 2*(k1 + 2*k2*r2);
+    double dUx = fx * (dRadial + dRadialDerivative*x2 + 2*p1*y + 6*p2*x);
+    double dUy = fx * (dRadialDerivative*xy + 2*p1*x + 2*p2*y);
+    double dVx = fy * (dRadialDerivative*xy + 2*p1*x + 2*p2*y);
+    double dVy = fy * (dRadial + dRadialDerivative*y2 + 6*p1*y + 2*p2*x);
+
+    // ... wrt the point in camera coordinates.
+    double aGradients[2][3] =
+      {
+        { dUx * dInvZ, dUy * dInvZ, -(dUx*x + dUy*y) * dInvZ },
+        { dVx * dInvZ, dVy * dInvZ, -(dVx*x + dVy*y) * dInvZ }
+      };
+
+    // The point moves by w x q when rotated by a small w. Thus, the
+    // derivative wrt w is q x gradient.
+    for (int i=0; i<2; ++i)
+      {
+        const double* g = aGradients[i];
+        double* pE = extrinsicJacobian[i];
+        pE[0] = qy*g[2] - qz*g[1];
+        pE[1] = qz*g[0] - qx*g[2];
+        pE[2] = qx*g[1] - qy*g[0];
+        pE[3] = g[0];
+        pE[4] = g[1];
+        pE[5] = g[2];
+      }
+  }
+
+  /* Evaluates the reprojection error of each view and, if *terms*
+     is non-zero, the blocks of the normal equations. Views are
+     independent, and each strip only writes to its own views.
+   */
+  class Linearization
+  {
+  public:
+    Linearization(const QList<PiiMatrix<double> >& worldPoints,
+                  const QList<PiiMatrix<double> >& imagePoints,
+                  const IntrinsicModel& model,
+                  const double* intrinsic,
+                  const ViewPose* poses,
+                  double* costs,
+                  ViewTerms* terms = 0) :
+      _worldPoints(worldPoints), _imagePoints(imagePoints),
+      _model(model), _pIntrinsic(intrinsic), _pPoses(poses),
+      _pCosts(costs), _pTerms(terms)
+    {}
+
+    void operator() (int firstView, int endView)
+    {
+      const int n = _model.iCount;
+      for (int view=firstView; view<endView; ++view)
+        {
+          const PiiMatrix<double>& matWorld = _worldPoints.size() == 1 ? _worldPoints[0] : _worldPoints[view];
+          const PiiMatrix<double>& matImage = _imagePoints[view];
+          const ViewPose& pose = _pPoses[view];
+          double dCost = 0;
+          double adResidual[2];
+
+          if (_pTerms == 0)
+            {
+              for (int r=0; r<matImage.rows(); ++r)
+                {
+                  project(_pIntrinsic, pose, matWorld[r], matImage[r], adResidual);
+                  dCost += adResidual[0]*adResidual[0] + adResidual[1]*adResidual[1];
+                }
+              _pCosts[view] = dCost;
+              continue;
+            }
+
+          ViewTerms& terms = _pTerms[view];
+          std::memset(&terms, 0, sizeof(ViewTerms));
+          double aFull[2][IntrinsicCount], aExtrinsic[2][ExtrinsicCount], aIntrinsic[2][IntrinsicCount];
+          for (int r=0; r<matImage.rows(); ++r)
+            {
+              project(_pIntrinsic, pose, matWorld[r], matImage[r], adResidual, aFull, aExtrinsic);
+              dCost += adResidual[0]*adResidual[0] + adResidual[1]*adResidual[1];
+
+              for (int k=0; k<2; ++k)
+                {
+                  std::memset(aIntrinsic[k], 0, sizeof(aIntrinsic[k]));
+                  for (int i=0; i<IntrinsicCount; ++i)
+                    if (_model.aiColumns[i] >= 0)
+                      aIntrinsic[k][_model.aiColumns[i]] += _model.adScales[i] * aFull[k][i];
+                }
+
+              for (int k=0; k<2; ++k)
+                {
+                  const double* pI = aIntrinsic[k], *pE = aExtrinsic[k];
+                  for (int i=0; i<n; ++i)
+                    {
+                      for (int j=i; j<n; ++j)
+                        terms.adU[i*n+j] += pI[i] * pI[j];
+                      for (int j=0; j<ExtrinsicCount; ++j)
+                        terms.adW[i*ExtrinsicCount+j] += pI[i] * pE[j];
+                      terms.adIntrinsicGradient[i] += pI[i] * adResidual[k];
+                    }
+                  for (int i=0; i<ExtrinsicCount; ++i)
+                    {
+                      for (int j=i; j<ExtrinsicCount; ++j)
+                        terms.adV[i*ExtrinsicCount+j] += pE[i] * pE[j];
+                      terms.adExtrinsicGradient[i] += pE[i] * adResidual[k];
+                    }
+                }
+            }
+          // Only the upper triangles were accumulated.
+          for (int i=0; i<n; ++i)
+            for (int j=0; j<i; ++j)
+              terms.adU[i*n+j] = terms.adU[j*n+i];
+          for (int i=0; i<ExtrinsicCount; ++i)
+            for (int j=0; j<i; ++j)
+              terms.adV[i*ExtrinsicCount+j] = terms.adV[j*ExtrinsicCount+i];
+          _pCosts[view] = dCost;
+        }
+    }
+
+  private:
+    const QList<PiiMatrix<double> >& _worldPoints;
+    const QList<PiiMatrix<double> >& _imagePoints;
+    const IntrinsicModel& _model;
+    const double* _pIntrinsic;
+    const ViewPose* _pPoses;
+    double* _pCosts;
+    ViewTerms* _pTerms;
+  };
+
+  /* Eliminates the extrinsic parameters of each view from the damped
+     normal equations: S_i = W_i V_i^-1 W_i^T and r_i = W_i V_i^-1
+     g_i.
+   */
+  class Reduction
+  {
+  public:
+    Reduction(int intrinsicCount, double lambda,
+              const ViewTerms* terms, ViewReduction* reductions) :
+      _iIntrinsicCount(intrinsicCount), _dLambda(lambda),
+      _pTerms(terms), _pReductions(reductions)
+    {}
+
+    void operator() (int firstView, int endView)
+    {
+      const int n = _iIntrinsicCount;
+      for (int view=firstView; view<endView; ++view)
+        {
+          const ViewTerms& terms = _pTerms[view];
+          ViewReduction& reduction = _pReductions[view];
+          std::memcpy(reduction.adFactor, terms.adV, sizeof(terms.adV));
+          for (int i=0; i<ExtrinsicCount; ++i)
+            reduction.adFactor[i*ExtrinsicCount+i] *= 1 + _dLambda;
+          reduction.bValid = choleskyDecompose(reduction.adFactor, ExtrinsicCount);
+          if (!reduction.bValid)
+            continue;
+
+          // Y = W V^-1, one row at a time.
+          double aY[IntrinsicCount][ExtrinsicCount];
+          for (int i=0; i<n; ++i)
+            {
+              std::memcpy(aY[i], terms.adW + i*ExtrinsicCount, sizeof(aY[i]));
+              choleskySolve(reduction.adFactor, ExtrinsicCount, aY[i]);
+            }
+          for (int i=0; i<n; ++i)
+            {
+              for (int j=0; j<n; ++j)
+                {
+                  double dSum = 0;
+                  for (int k=0; k<ExtrinsicCount; ++k)
+                    dSum += aY[i][k] * terms.adW[j*ExtrinsicCount+k];
+                  reduction.adS[i*n+j] = dSum;
+                }
+              double dSum = 0;
+              for (int k=0; k<ExtrinsicCount; ++k)
+                dSum += aY[i][k] * terms.adExtrinsicGradient[k];
+              reduction.adRhs[i] = dSum;
+            }
+        }
+    }
+
+  private:
+    int _iIntrinsicCount;
+    double _dLambda;
+    const ViewTerms* _pTerms;
+    ViewReduction* _pReductions;
+  };
+
+  double totalCost(const QVector<double>& costs)
+  {
+    // Summing in a fixed order keeps the result independent of the
+    // number of threads.
+    double dSum = 0;
+    for (int i=0; i<costs.size(); ++i)
+      dSum += costs[i];
+    return dSum;
+  }
+}
+
+namespace PiiCalibration
+{
+  double refineCalibration(const QList<PiiMatrix<double> >& worldPoints,
+                           const QList<PiiMatrix<double> >& imagePoints,
+                           CameraParameters& intrinsic,
+                           QList<RelativePosition>& extrinsic,
+                           CalibrationOptions options,
+                           const PiiParallelPolicy& policy,
+                           int maxIterations)
+  {
+    const int iViewCount = imagePoints.size();
+    if (iViewCount == 0 || worldPoints.size() == 0 ||
+        (worldPoints.size() != 1 && worldPoints.size() != iViewCount))
+      PII_THROW(PiiCalibrationException,
+                tr("Cannot calibrate with non-matching number of views. World views: %1. Image views: %2")
+                .arg(worldPoints.size()).arg(iViewCount));
+    if (extrinsic.size() != iViewCount)
+      PII_THROW(PiiCalibrationException,
+                tr("An initial camera position is required for each view. %1 positions were given for %2 views.")
+                .arg(extrinsic.size()).arg(iViewCount));
+    if (intrinsic.focalLength.x <= 0 || intrinsic.focalLength.y <= 0)
+      PII_THROW(PiiCalibrationException,
+                tr("Focal lengths must be positive"));
+
+    int iTotalPoints = 0;
+    for (int view=0; view<iViewCount; ++view)
+      {
+        const PiiMatrix<double>& matWorld = worldPoints.size() == 1 ? worldPoints[0] : worldPoints[view];
+        if (matWorld.columns() != 3 || imagePoints[view].columns() != 2)
+          PII_THROW(PiiCalibrationException,
+                    tr("Incorrect point dimensions. View %1 has a %2-dimensional world space and a %3-dimensional image space.")
+                    .arg(view).arg(matWorld.columns()).arg(imagePoints[view].columns()));
+        if (matWorld.rows() != imagePoints[view].rows())
+          PII_THROW(PiiCalibrationException,
+                    tr("The number of calibration points per view must match. View %1 has %2 world points and %3 image points.")
+                    .arg(view).arg(matWorld.rows()).arg(imagePoints[view].rows()));
+        iTotalPoints += matWorld.rows();
+      }
+    if (iTotalPoints == 0)
+      return 0;
+
+    if (options & NoTangentialDistortion)
+      intrinsic.p1 = intrinsic.p2 = 0;
+
+    double adIntrinsic[IntrinsicCount] =
+      {
+        intrinsic.focalLength.x, intrinsic.focalLength.y,
+        intrinsic.center.x, intrinsic.center.y,
+        intrinsic.k1, intrinsic.k2, intrinsic.p1, intrinsic.p2
+      };
+    const IntrinsicModel model(adIntrinsic, options);
+    const int n = model.iCount;
+
+    QVector<ViewPose> vecPoses(iViewCount), vecCandidatePoses(iViewCount);
+    for (int view=0; view<iViewCount; ++view)
+      {
+        rotationMatrix(extrinsic[view].rotation.values, vecPoses[view].adRotation);
+        std::memcpy(vecPoses[view].adTranslation, extrinsic[view].translation.values, 3*sizeof(double));
+      }
+
+    QVector<ViewTerms> vecTerms(iViewCount);
+    QVector<ViewReduction> vecReductions(iViewCount);
+    QVector<double> vecCosts(iViewCount);
+
+    Linearization linearize(worldPoints, imagePoints, model, adIntrinsic, vecPoses.constData(),
+                            vecCosts.data(), vecTerms.data());
+    Pii::forEachStrip(iViewCount, linearize, policy);
+    double dCost = totalCost(vecCosts);
+
+    double adCandidate[IntrinsicCount];
+    Linearization evaluate(worldPoints, imagePoints, model, adCandidate, vecCandidatePoses.constData(),
+                           vecCosts.data());
+
+    double dLambda = 1e-3;
+    for (int iIteration=0; iIteration<maxIterations && dCost > 0; )
+      {
+        Reduction reduce(n, dLambda, vecTerms.constData(), vecReductions.data());
+        Pii::forEachStrip(iViewCount, reduce, policy);
+
+        // Reduced system for the intrinsic parameters:
+        // (U - sum S_i) d = g - sum r_i
+        double adSystem[IntrinsicCount*IntrinsicCount], adStep[IntrinsicCount];
+        std::memset(adSystem, 0, sizeof(adSystem));
+        std::memset(adStep, 0, sizeof(adStep));
+        bool bValid = true;
+        for (int view=0; view<iViewCount && bValid; ++view)
+          {
+            const ViewTerms& terms = vecTerms[view];
+            const ViewReduction& reduction = vecReductions[view];
+            bValid = reduction.bValid;
+            for (int i=0; i<n*n; ++i)
+              adSystem[i] += terms.adU[i] - reduction.adS[i];
+            for (int i=0; i<n; ++i)
+              adStep[i] += terms.adIntrinsicGradient[i] - reduction.adRhs[i];
+          }
+        if (bValid)
+          {
+            // The diagonal of the Schur complement is not the diagonal
+            // of U, but damping U's diagonal is what LM would do on
+            // the full system.
+            for (int view=0; view<iViewCount; ++view)
+              for (int i=0; i<n; ++i)
+                adSystem[i*n+i] += dLambda * vecTerms[view].adU[i*n+i];
+            bValid = choleskyDecompose(adSystem, n);
+          }
+
+        if (bValid)
+          {
+            choleskySolve(adSystem, n, adStep);
+
+            double dStepNorm = 0, dParamNorm = 0;
+            std::memcpy(adCandidate, adIntrinsic, sizeof(adIntrinsic));
+            for (int i=0; i<IntrinsicCount; ++i)
+              {
+                if (model.aiColumns[i] >= 0)
+                  adCandidate[i] += model.adScales[i] * adStep[model.aiColumns[i]];
+                dParamNorm += adIntrinsic[i] * adIntrinsic[i];
+              }
+            for (int i=0; i<n; ++i)
+              dStepNorm += adStep[i] * adStep[i];
+
+            // Back substitution: V_i e_i = g_i - W_i^T d
+            for (int view=0; view<iViewCount; ++view)
+              {
+                const ViewTerms& terms = vecTerms[view];
+                double adExtrinsicStep[ExtrinsicCount];
+                for (int j=0; j<ExtrinsicCount; ++j)
+                  {
+                    double dSum = terms.adExtrinsicGradient[j];
+                    for (int i=0; i<n; ++i)
+                      dSum -= terms.adW[i*ExtrinsicCount+j] * adStep[i];
+                    adExtrinsicStep[j] = dSum;
+                  }
+                choleskySolve(vecReductions[view].adFactor, ExtrinsicCount, adExtrinsicStep);
+
+                const ViewPose& pose = vecPoses[view];
+                ViewPose& candidate = vecCandidatePoses[view];
+                double adDelta[9];
+                rotationMatrix(adExtrinsicStep, adDelta);
+                for (int r=0; r<3; ++r)
+                  for (int c=0; c<3; ++c)
+                    candidate.adRotation[r*3+c] =
+                      adDelta[r*3] * pose.adRotation[c] +
+                      adDelta[r*3+1] * pose.adRotation[3+c] +
+                      adDelta[r*3+2] * pose.adRotation[6+c];
+                for (int i=0; i<3; ++i)
+                  candidate.adTranslation[i] = pose.adTranslation[i] + adExtrinsicStep[3+i];
+                for (int i=0; i<ExtrinsicCount; ++i)
+                  dStepNorm += adExtrinsicStep[i] * adExtrinsicStep[i];
+                for (int i=0; i<3; ++i)
+                  dParamNorm += pose.adTranslation[i] * pose.adTranslation[i];
+              }
+            // Once the steps are at the level of round-off noise,
+            // nothing can be gained.
+            bool bSmallStep = std::sqrt(dStepNorm) <= 1e-12 * std::sqrt(dParamNorm);
+
+            Pii::forEachStrip(iViewCount, evaluate, policy);
+            double dNewCost = totalCost(vecCosts);
+
+            if (dNewCost < dCost)
+              {
+                bool bConverged = dCost - dNewCost <= 1e-12 * dCost;
+                std::memcpy(adIntrinsic, adCandidate, sizeof(adIntrinsic));
+                std::memcpy(vecPoses.data(), vecCandidatePoses.constData(), iViewCount * sizeof(ViewPose));
+                dCost = dNewCost;
+                if (bConverged || bSmallStep || ++iIteration == maxIterations)
+                  break;
+                dLambda = qMax(dLambda * 0.1, 1e-12);
+                Pii::forEachStrip(iViewCount, linearize, policy);
+                continue;
+              }
+            else if (bSmallStep)
+              break;
+          }
+
+        // The step failed. Move towards gradient descent.
+        dLambda *= 10;
+        if (dLambda > 1e12)
+          break;
+        ++iIteration;
+      }
+
+    intrinsic.focalLength.x = adIntrinsic[0];
+    intrinsic.focalLength.y = adIntrinsic[1];
+    intrinsic.center.x = adIntrinsic[2];
+    intrinsic.center.y = adIntrinsic[3];
+    intrinsic.k1 = adIntrinsic[4];
+    intrinsic.k2 = adIntrinsic[5];
+    intrinsic.p1 = adIntrinsic[6];
+    intrinsic.p2 = adIntrinsic[7];
+
+    for (int view=0; view<iViewCount; ++view)
+      extrinsic[view] = RelativePosition(rotationVector(vecPoses[view].adRotation),
+                                         PiiVector<double,3>(vecPoses[view].adTranslation));
+
+    return std::sqrt(dCost / iTotalPoints);
+  }
+}
@@ -38,6 +38,12 @@ void PiiStereoTriangulator::addCamera(const PiiCalibration::CameraParameters& in
                                       const PiiCalibration::RelativePosition& extrinsic)
 {
   d->lstCameraParameters << intrinsic;
+  // The image size is not known here. The principal point is close
+  // to the center of the image, and the grid extrapolates outside of
+  // its boundaries anyway.
+  d->lstGrids << PiiUndistortionGrid(intrinsic,
+                                     qMax(1, int(2*intrinsic.center.x + 1.1)),
+                                     qMax(1, int(2*intrinsic.center.y + 1.1)));
   // Calculate relative position wrt all added cameras
   // The lst[0][0] is the relative position of camera 0 wrt the world
   // coordinate system, lst[0][1] is the relative position of camera 1
@@ -73,7 +79,7 @@ PiiMatrix<double> PiiStereoTriangulator::calculate3DPoints(const QList<PiiMatrix
                   .arg(i).arg(imagePoints[i].columns()));
 
       // Transform to normalized image coordinates and add a fixed z coordinate
-      lstNormalized << PiiCalibration::undistort(imagePoints[i], d->lstCameraParameters[i], 1.0);
+      lstNormalized << d->lstGrids[i].undistort(imagePoints[i], 1.0);
     }
 
   // Initialize a zero matrix
@@ -17,6 +17,7 @@
 #define _PIISTEREOTRIANGULATOR_H
 
 #include "PiiCalibration.h"
+#include "PiiUndistortionGrid.h"
 
 /**
  * A class that calculates 3D world coordinates for objects seen from
@@ -104,6 +105,11 @@ private:
      * Intrinsic parameters of cameras added so far.
      */
     QList<PiiCalibration::CameraParameters> lstCameraParameters;
+
+    /**
+     * Undistortion lookup grids, one for each camera.
+     */
+    QList<PiiUndistortionGrid> lstGrids;
   } *d;
 };
 
@@ -0,0 +1,206 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiUndistortionGrid.h"
+
+#include <QCoreApplication>
+#include <cmath>
+
+namespace
+{
+  using PiiCalibration::CameraParameters;
+
+  // Inf - Inf and NaN - NaN are both NaN.
+  inline bool isFinite(double value) { return value - value == 0; }
+
+  /* Solves normalizedToDistorted(x,y) = (targetX, targetY) for (x,y)
+     with Newton's method, starting from the given (x,y). Returns
+     `false` if the iteration does not converge in *maxIterations*
+     steps.
+   */
+  bool invertDistortion(const CameraParameters& intrinsic,
+                        double targetX, double targetY,
+                        double& x, double& y, int maxIterations)
+  {
+    const double k1 = intrinsic.k1, k2 = intrinsic.k2, p1 = intrinsic.p1, p2 = intrinsic.p2;
+    for (int i=0; i<maxIterations; ++i)
+      {
+        double x2 = x*x, y2 = y*y, xy = x*y, r2 = x2 + y2;
+        double dRadial = 1.0 + k1 * r2 + k2 * r2 * r2;
+        double dErrorX = x*dRadial + 2*p1*xy + p2*(r2 + 2*x2) - targetX;
+        double dErrorY = y*dRadial + p1*(r2 + 2*y2) + 2*p2*xy - targetY;
+
+        // The Jacobian of the distortion model. It is symmetric.
+        double dRadialDerivative = 2*(k1 + 2*k2*r2);
+        double a = dRadial + dRadialDerivative*x2 + 2*p1*y + 6*p2*x;
+        double b = dRadialDerivative*xy + 2*p1*x + 2*p2*y;
+        double c = dRadial + dRadialDerivative*y2 + 6*p1*y + 2*p2*x;
+        double dDet = a*c - b*b;
+        if (dDet == 0)
+          return false;
+
+        double dStepX = (c*dErrorX - b*dErrorY) / dDet;
+        double dStepY = (a*dErrorY - b*dErrorX) / dDet;
+        x -= dStepX;
+        y -= dStepY;
+        if (!isFinite(x) || !isFinite(y))
+          return false;
+        // Newton converges quadratically. Once the step is at the
+        // level of round-off noise, we are done.
+        if (dStepX*dStepX + dStepY*dStepY <= 1e-30 * (1.0 + x*x + y*y))
+          return true;
+      }
+    return false;
+  }
+
+  class UndistortStrip
+  {
+  public:
+    UndistortStrip(const PiiUndistortionGrid& grid,
+                   const PiiMatrix<double>& distorted,
+                   PiiMatrix<double>& result) :
+      _grid(grid), _distorted(distorted), _result(result)
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      for (int r=firstRow; r<endRow; ++r)
+        {
+          const double* pSource = _distorted[r];
+          double* pTarget = _result[r];
+          _grid.undistort(pSource[0], pSource[1], pTarget, pTarget+1);
+        }
+    }
+
+  private:
+    const PiiUndistortionGrid& _grid;
+    const PiiMatrix<double>& _distorted;
+    PiiMatrix<double>& _result;
+  };
+}
+
+PiiUndistortionGrid::PiiUndistortionGrid() :
+  d(new Data)
+{}
+
+PiiUndistortionGrid::PiiUndistortionGrid(const PiiCalibration::CameraParameters& intrinsic,
+                                         int imageWidth, int imageHeight,
+                                         int cellSize) :
+  d(new Data)
+{
+  d->intrinsic = intrinsic;
+  d->iCellSize = qMax(1, cellSize);
+  d->dOrigin = -d->iCellSize;
+  // One cell of margin on each side, and the last node on the far
+  // side of the image edge.
+  const int iRows = (qMax(imageHeight, 0) + d->iCellSize - 1) / d->iCellSize + 3;
+  const int iColumns = (qMax(imageWidth, 0) + d->iCellSize - 1) / d->iCellSize + 3;
+  d->matNodes = PiiMatrix<double>(PiiMatrix<double>::uninitialized(iRows, iColumns*2));
+
+  const double dFx = intrinsic.focalLength.x, dFy = intrinsic.focalLength.y;
+  for (int r=0; r<iRows; ++r)
+    {
+      double* pNodes = d->matNodes[r];
+      const double dTargetY = (d->dOrigin + r*d->iCellSize - intrinsic.center.y) / dFy;
+      for (int c=0; c<iColumns; ++c)
+        {
+          const double dTargetX = (d->dOrigin + c*d->iCellSize - intrinsic.center.x) / dFx;
+          // Continue from the previous node. The solution changes
+          // smoothly, so this keeps Newton in the right basin even
+          // with strong distortion.
+          double x = c > 0 ? pNodes[2*c-2] : dTargetX, y = c > 0 ? pNodes[2*c-1] : dTargetY;
+          if (!invertDistortion(intrinsic, dTargetX, dTargetY, x, y, 20))
+            PiiCalibration::undistort(intrinsic, dTargetX*dFx + intrinsic.center.x, dTargetY*dFy + intrinsic.center.y,
+                                      &x, &y);
+          pNodes[2*c] = x;
+          pNodes[2*c+1] = y;
+        }
+    }
+}
+
+PiiUndistortionGrid::PiiUndistortionGrid(const PiiUndistortionGrid& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+PiiUndistortionGrid::~PiiUndistortionGrid()
+{
+  d->release();
+}
+
+PiiUndistortionGrid& PiiUndistortionGrid::operator= (const PiiUndistortionGrid& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+bool PiiUndistortionGrid::isEmpty() const { return d->matNodes.isEmpty(); }
+PiiCalibration::CameraParameters PiiUndistortionGrid::cameraParameters() const { return d->intrinsic; }
+
+void PiiUndistortionGrid::undistort(double x, double y, double* newX, double* newY) const
+{
+  if (isEmpty() || !isFinite(x) || !isFinite(y))
+    {
+      *newX = *newY = NAN;
+      return;
+    }
+
+  const PiiCalibration::CameraParameters& intrinsic = d->intrinsic;
+  const double dTargetX = (x - intrinsic.center.x) / intrinsic.focalLength.x;
+  const double dTargetY = (y - intrinsic.center.y) / intrinsic.focalLength.y;
+
+  // Bilinear interpolation between the four closest nodes. Outside
+  // of the grid, the border cells are extrapolated.
+  const double dColumn = (x - d->dOrigin) / d->iCellSize, dRow = (y - d->dOrigin) / d->iCellSize;
+  const int iColumn = qBound(0, int(std::floor(dColumn)), d->matNodes.columns()/2 - 2);
+  const int iRow = qBound(0, int(std::floor(dRow)), d->matNodes.rows() - 2);
+  const double dFracX = dColumn - iColumn, dFracY = dRow - iRow;
+  const double* pTop = d->matNodes[iRow] + 2*iColumn;
+  const double* pBottom = d->matNodes[iRow+1] + 2*iColumn;
+  double dX = (1-dFracY) * ((1-dFracX) * pTop[0] + dFracX * pTop[2]) +
+    dFracY * ((1-dFracX) * pBottom[0] + dFracX * pBottom[2]);
+  double dY = (1-dFracY) * ((1-dFracX) * pTop[1] + dFracX * pTop[3]) +
+    dFracY * ((1-dFracX) * pBottom[1] + dFracX * pBottom[3]);
+
+  if (!invertDistortion(intrinsic, dTargetX, dTargetY, dX, dY, 8))
+    {
+      // Far outside of the grid. Start from scratch.
+      dX = dTargetX;
+      dY = dTargetY;
+      if (!invertDistortion(intrinsic, dTargetX, dTargetY, dX, dY, 20))
+        PiiCalibration::undistort(intrinsic, x, y, &dX, &dY);
+    }
+  *newX = dX;
+  *newY = dY;
+}
+
+PiiMatrix<double> PiiUndistortionGrid::undistort(const PiiMatrix<double>& distorted,
+                                                 double zValue,
+                                                 const PiiParallelPolicy& policy) const
+{
+  if (distorted.columns() != 2)
+    PII_THROW(PiiCalibrationException,
+              QCoreApplication::translate("PiiCalibration", "Distorted coordinates must be represented by a N-by-2 matrix. %1-by-%2 was given.")
+              .arg(distorted.rows()).arg(distorted.columns()));
+
+  PiiMatrix<double> matResult(PiiMatrix<double>::uninitialized(distorted.rows(), Pii::isNan(zValue) ? 2 : 3));
+  if (!Pii::isNan(zValue))
+    Pii::fill(matResult.columnBegin(2), matResult.columnEnd(2), zValue);
+
+  UndistortStrip strip(*this, distorted, matResult);
+  Pii::forEachStrip(distorted.rows(), strip, policy);
+  return matResult;
+}
@@ -0,0 +1,116 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIUNDISTORTIONGRID_H
+#define _PIIUNDISTORTIONGRID_H
+
+#include "PiiCalibration.h"
+#include <PiiSharedD.h>
+
+/**
+ * A lookup grid for removing lens distortion from large numbers of
+ * points. [PiiCalibration::undistort()] inverts the distortion model
+ * with a general-purpose optimizer for each point separately, which
+ * limits it to a few thousand points per second. PiiUndistortionGrid
+ * samples the inverse mapping at the nodes of a regular grid over
+ * the image once. A point is undistorted by interpolating an initial
+ * guess from the four surrounding nodes and polishing it with a few
+ * Newton iterations. The result is accurate to a few units in the
+ * last place, and the cost is that of a handful of evaluations of
+ * the distortion model.
+ *
+ * Points outside of the image are undistorted as well, but the
+ * initial guess is extrapolated and may need more iterations.
+ *
+ * PiiUndistortionGrid is implicitly shared and read-only once built.
+ * It can be used in concurrent threads.
+ *
+ * ~~~(c++)
+ * PiiUndistortionGrid grid(intrinsic, 1280, 960);
+ * // Normalized image coordinates with z = 1
+ * PiiMatrix<double> matRays(grid.undistort(matPixels, 1.0));
+ * ~~~
+ */
+class PII_CALIBRATION_EXPORT PiiUndistortionGrid
+{
+public:
+  /**
+   * Creates an empty grid. All coordinates undistorted with an empty
+   * grid will be NaN.
+   */
+  PiiUndistortionGrid();
+
+  /**
+   * Creates a grid for a camera described by *intrinsic*. The grid
+   * covers an *imageWidth*-by-*imageHeight* image with a margin of
+   * one cell on each side. The grid nodes are *cellSize* pixels
+   * apart. Denser grids give better initial guesses, but the Newton
+   * iterations make the final accuracy almost independent of cell
+   * size.
+   */
+  PiiUndistortionGrid(const PiiCalibration::CameraParameters& intrinsic,
+                      int imageWidth, int imageHeight,
+                      int cellSize = 16);
+
+  PiiUndistortionGrid(const PiiUndistortionGrid& other);
+  ~PiiUndistortionGrid();
+  PiiUndistortionGrid& operator= (const PiiUndistortionGrid& other);
+
+  /**
+   * Returns `true` if the grid has not been built.
+   */
+  bool isEmpty() const;
+
+  /**
+   * Returns the camera parameters the grid was built for.
+   */
+  PiiCalibration::CameraParameters cameraParameters() const;
+
+  /**
+   * Converts the pixel coordinates (*x*, *y*) to undistorted
+   * normalized image coordinates (*newX*, *newY*). This function is
+   * equivalent to [PiiCalibration::undistort()].
+   */
+  void undistort(double x, double y, double* newX, double* newY) const;
+
+  /**
+   * Converts a N-by-2 matrix of pixel coordinates to undistorted
+   * normalized image coordinates. The parameters and the return
+   * value are the same as in [PiiCalibration::undistort()]. Rows
+   * with NaN coordinates produce NaNs.
+   *
+   * @param policy the execution policy. Points are divided into
+   * strips that are processed concurrently.
+   */
+  PiiMatrix<double> undistort(const PiiMatrix<double>& distorted,
+                              double zValue = NAN,
+                              const PiiParallelPolicy& policy = PiiParallelPolicy::sequential()) const;
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : dOrigin(0), iCellSize(0) {}
+
+    PiiCalibration::CameraParameters intrinsic;
+    // The pixel coordinates of the top left node (both x and y)
+    double dOrigin;
+    int iCellSize;
+    // Normalized (x,y) pairs at the nodes
+    PiiMatrix<double> matNodes;
+  } *d;
+};
+
+#endif //_PIIUNDISTORTIONGRID_H
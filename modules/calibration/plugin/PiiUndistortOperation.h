@@ -18,6 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include "PiiCalibration.h"
+#include <PiiRemapTable.h>
 
 /**
  * Corrects lens distortion.
@@ -32,6 +33,9 @@
  *
  * @out image - undistorted image. Same type as the input.
  *
+ * The undistortion map is converted to a PiiRemapTable when the
+ * first image is received and whenever the size of the input image
+ * or any of the camera parameters change.
  */
 class PiiUndistortOperation : public PiiDefaultOperation
 {
@@ -135,8 +139,7 @@ private:
     Data();
 
     PiiCalibration::CameraParameters intrinsic;
-    PiiImage::DoubleCoordinateMap dmatMap;
-    PiiImage::IntCoordinateMap imatMap;
+    PiiRemapTable remapTable;
     Pii::Interpolation interpolation;
   };
   PII_D_FUNC;
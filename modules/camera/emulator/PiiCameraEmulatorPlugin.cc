@@ -15,11 +15,15 @@
 
 #include "PiiPlugin.h"
 #include "PiiLineScanEmulator.h"
+#include "PiiRecordingCameraDriver.h"
+#include "PiiReplayCameraDriver.h"
 #include "PiiNonWovenGenerator.h"
 #include "PiiTiledImageGenerator.h"
 
 PII_IMPLEMENT_PLUGIN(PiiCameraEmulatorPlugin);
 
 PII_REGISTER_SERIALIZABLE_CLASS(PiiLineScanEmulator, PiiCameraDriver);
+PII_REGISTER_SERIALIZABLE_CLASS(PiiRecordingCameraDriver, PiiCameraDriver);
+PII_REGISTER_SERIALIZABLE_CLASS(PiiReplayCameraDriver, PiiCameraDriver);
 PII_REGISTER_SERIALIZABLE_CLASS(PiiNonWovenGenerator, PiiTextureGenerator);
 PII_REGISTER_SERIALIZABLE_CLASS(PiiTiledImageGenerator, PiiTextureGenerator);
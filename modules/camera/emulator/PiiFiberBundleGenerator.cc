@@ -46,20 +46,17 @@ public:
 
   void draw(unsigned char* line, int lineWidth)
   {
+    // Clip the bundle to the line first so that the inner loop has no
+    // branches.
+    int iOffset = _iStartPos + int(_dStartPos);
+    int iStart = qMax(0, -iOffset), iEnd = qMin(_iBundleWidth, lineWidth - iOffset);
+    unsigned char* pLine = line + iOffset;
     // Draw fibers
-    for (int i=0; i<_iBundleWidth; ++i)
+    for (int i=iStart; i<iEnd; ++i)
       {
-        int bufferPos = i + _iStartPos + int(_dStartPos);
-        if (bufferPos >= 0 && bufferPos < lineWidth)
-          {
-            // Thickness brings light intensity down
-            int newValue = int(line[bufferPos]) - int(_dpFiberThickness[i]);
-            if (newValue < 0)
-              newValue = 0;
-            else if (newValue > 255)
-              newValue = 255;
-            line[bufferPos] = static_cast<unsigned char>(newValue);
-          }
+        // Thickness brings light intensity down
+        int newValue = int(pLine[i]) - int(_dpFiberThickness[i]);
+        pLine[i] = static_cast<unsigned char>(qBound(0, newValue, 255));
       }
   }
 
@@ -145,28 +142,33 @@ void PiiFiberBundleGenerator::generateTexture(PiiMatrix<unsigned char>& buffer,
         _lstBundles << new FiberBundle(this, i*columns/_iBundleCount);
     }
 
-  unsigned char** ppScanLines = new unsigned char*[rows];
-
-  // Fill the buffer line by line and store scan-line pointers at the
-  // same time.
-  for (int r=0; r<rows; ++r)
-    {
-      ppScanLines[r] = buffer[(row + r) % buffer.rows()] + column;
-      generateLine(ppScanLines[r], columns);
-    }
-
   if (_bSmooth)
     {
-      PiiMatrix<unsigned char> newBuffer(rows, columns, *ppScanLines);
-      newBuffer = Pii::movingAverage<int>(Pii::movingAverage<int>(newBuffer, 3,
-                                                                  Pii::Vertically,
-                                                                  Pii::ShrinkWindow),
-                                          3,
-                                          Pii::Horizontally,
-                                          Pii::ShrinkWindow);
+      // Generate to a contiguous buffer because the frame buffer may
+      // wrap around.
+      _matSmoothingBuffer.resize(rows, columns);
+      for (int r=0; r<rows; ++r)
+        generateLine(_matSmoothingBuffer.row(r), columns);
+
+      PiiMatrix<int> matSmoothed(Pii::movingAverage<int>(Pii::movingAverage<int>(_matSmoothingBuffer, 3,
+                                                                                Pii::Vertically,
+                                                                                Pii::ShrinkWindow),
+                                                        3,
+                                                        Pii::Horizontally,
+                                                        Pii::ShrinkWindow));
+      for (int r=0; r<rows; ++r)
+        {
+          unsigned char* pTarget = buffer[(row + r) % buffer.rows()] + column;
+          const int* pSource = matSmoothed.row(r);
+          for (int c=0; c<columns; ++c)
+            pTarget[c] = static_cast<unsigned char>(pSource[c]);
+        }
     }
   else
-    delete[] ppScanLines;
+    {
+      for (int r=0; r<rows; ++r)
+        generateLine(buffer[(row + r) % buffer.rows()] + column, columns);
+    }
 }
 
 
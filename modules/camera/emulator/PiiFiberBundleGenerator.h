@@ -114,6 +114,7 @@ private:
   bool _bSmooth;
 
   QList<FiberBundle*> _lstBundles;
+  PiiMatrix<unsigned char> _matSmoothingBuffer;
 };
 
 
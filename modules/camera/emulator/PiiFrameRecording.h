@@ -0,0 +1,77 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIFRAMERECORDING_H
+#define _PIIFRAMERECORDING_H
+
+#include <QtGlobal>
+
+/**
+ * The file format shared by PiiRecordingCameraDriver and
+ * PiiReplayCameraDriver. A recording starts with a [FileHeader],
+ * which is followed by one record per frame. Each record consists of
+ * a [FrameHeader] and the raw frame data, padded to a multiple of
+ * [Alignment] bytes. Since all headers are [Alignment] bytes, frame
+ * data is aligned in a memory-mapped file and can be passed on
+ * without copying.
+ *
+ * All values are stored in the byte order of the recording machine.
+ * A recording that was interrupted is valid up to the last complete
+ * record.
+ *
+ * @internal
+ */
+namespace PiiFrameRecording
+{
+  enum { Alignment = 64, Version = 1 };
+
+  static const char magic[8] = { 'P', 'I', 'I', 'F', 'R', 'A', 'M', 'E' };
+
+  struct FileHeader
+  {
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    qint32 width, height;
+    qint32 imageFormat;
+    qint32 bitsPerPixel;
+    qint32 cameraType;
+    qint32 triggerMode;
+    // Capture start time as milliseconds since the epoch (UTC).
+    qint64 startTime;
+    char reserved[16];
+  };
+
+  struct FrameHeader
+  {
+    // Time from the start of capture, in microseconds.
+    qint64 timestamp;
+    // Time from the previous frame as reported by the driver, in
+    // microseconds. Zero if the driver doesn't measure time.
+    qint64 elapsedTime;
+    // The frame index given by the recorded driver.
+    quint32 frameIndex;
+    // The number of bytes of frame data following this header.
+    quint32 dataSize;
+    // The number of software triggers issued since the previous
+    // frame.
+    quint32 triggerCount;
+    char reserved[36];
+  };
+
+  /// Rounds *size* up to the next multiple of [Alignment].
+  inline qint64 align(qint64 size) { return (size + Alignment - 1) & ~qint64(Alignment - 1); }
+}
+
+#endif //_PIIFRAMERECORDING_H
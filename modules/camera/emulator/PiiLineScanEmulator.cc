@@ -19,6 +19,7 @@
 #include <PiiDelay.h>
 #include <PiiRandom.h>
 #include <PiiBits.h>
+#include <PiiParallel.h>
 #include <PiiYdinResources.h>
 
 #include <QMutexLocker>
@@ -26,6 +27,37 @@
 #include <QFile>
 #include <QFileInfo>
 
+namespace
+{
+  // Multiplies each pixel in a strip of the frame by a per-column
+  // fixed-point multiplier. The loop body is branch-free so that the
+  // compiler can vectorize it.
+  struct PixelScaler
+  {
+    PixelScaler(PiiMatrix<unsigned char>& buffer, int firstRow, const int* multipliers) :
+      buffer(buffer), iFirstRow(firstRow), pMultipliers(multipliers)
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      const int iColumns = buffer.columns();
+      for (int r=firstRow; r<endRow; ++r)
+        {
+          unsigned char* pRow = buffer.row(iFirstRow + r);
+          for (int c=0; c<iColumns; ++c)
+            {
+              const int iValue = (pRow[c] * pMultipliers[c] + 128) >> 8;
+              pRow[c] = static_cast<unsigned char>(iValue < 255 ? iValue : 255);
+            }
+        }
+    }
+
+    PiiMatrix<unsigned char>& buffer;
+    int iFirstRow;
+    const int* pMultipliers;
+  };
+}
+
 PiiLineScanEmulator::PiiLineScanEmulator() :
   _bOpen(false),
   _bCapturingRunning(false),
@@ -55,6 +87,8 @@ PiiLineScanEmulator::PiiLineScanEmulator() :
   _iLeftEdgeLimit(0),
   _iRightEdgeLimit(0),
   _iTextureBlockSize(128),
+  _iTextureCacheRows(0),
+  _iThreadCount(0),
   _dGain(0.0),
   _iExposureTime(100),
   _iBaseExposureTime(100),
@@ -63,6 +97,8 @@ PiiLineScanEmulator::PiiLineScanEmulator() :
   _dOutputPulseFrequency(1000),
   _bFirstScanLine(true),
   _pTextureGenerator(0),
+  _iTextureCacheRow(0),
+  _iTextureCacheDirection(1),
   _iLineCounter(0),
   _iCurrentLineIndex(0),
   _iCurrLineInImage(0),
@@ -83,6 +119,7 @@ PiiLineScanEmulator::~PiiLineScanEmulator()
 {
   close();
 
+  delete[] _dpMultipliers;
   delete _pTextureGenerator;
   _pTextureGenerator = 0;
 }
@@ -108,7 +145,10 @@ bool PiiLineScanEmulator::setProperty(const char* name, const QVariant& value)
   if (strncmp(name, "textureGenerator.", 17) == 0)
     {
       if (_pTextureGenerator != 0)
-        return _pTextureGenerator->setProperty(name+17, value);
+        {
+          _matTextureCache = PiiMatrix<unsigned char>();
+          return _pTextureGenerator->setProperty(name+17, value);
+        }
       else
         _mapGeneratorProperties[name+17] = value;
     }
@@ -170,6 +210,7 @@ void PiiLineScanEmulator::initialize(const QString& /*cameraId*/)
   _frameBuffer = PiiMatrix<unsigned char>(_iFrameBufferHeight, _iWidth);
   _frameBuffer = 0;
   _vecBufferPointers.fill(0,_iFrameBufferCount);
+  _matTextureCache = PiiMatrix<unsigned char>();
   _iSkippingLimit = _vecBufferPointers.size() / 2;
 
   loadImages();
@@ -276,6 +317,7 @@ void PiiLineScanEmulator::stopCapturing()
 void PiiLineScanEmulator::buffer()
 {
   generateMultipliers();
+  generateTextureCache();
   _leftTargetPoint = QPoint(_iLeftEdgeLimit/2,0);
   _rightTargetPoint = QPoint(_iRightEdgeLimit/2,0);
   _dLeftEdgePos = _iLeftEdgeLimit/2;
@@ -313,12 +355,7 @@ void PiiLineScanEmulator::buffer()
         }
 
       // Fake the frame intensity depends on gain and exposureTime
-      double dFactor = (double)_iExposureTime / (double)_iBaseExposureTime * (_dGain + 1.0);
-      unsigned char *pPtr = _frameBuffer.row(iStartLineIndex);
-      int count = _iHeight*_frameBuffer.columns();
-
-      for (int i=0; i<count; i++)
-        pPtr[i] = (unsigned char)qBound(0.0,dFactor * pPtr[i], 255.0);
+      scaleFrame(iStartLineIndex);
 
       // Increase frame index
       _iFrameIndex++;
@@ -330,6 +367,27 @@ void PiiLineScanEmulator::buffer()
     }
 }
 
+void PiiLineScanEmulator::scaleFrame(int firstRow)
+{
+  double dFactor = (double)_iExposureTime / (double)_iBaseExposureTime * (_dGain + 1.0);
+
+  // Combine gain and vignetting into one multiplier per column.
+  _vecPixelMultipliers.resize(_iWidth);
+  int* piMultipliers = _vecPixelMultipliers.data();
+  bool bIdentity = true;
+  for (int i=0; i<_iWidth; ++i)
+    {
+      double dMultiplier = _dpMultipliers ? dFactor * _dpMultipliers[i] : dFactor;
+      piMultipliers[i] = qBound(0, int(dMultiplier * 256 + 0.5), 65535);
+      bIdentity &= piMultipliers[i] == 256;
+    }
+  if (bIdentity)
+    return;
+
+  PixelScaler scaler(_frameBuffer, firstRow, piMultipliers);
+  Pii::forEachStrip(_iHeight, scaler, PiiParallelPolicy(_iThreadCount, 64));
+}
+
 void PiiLineScanEmulator::capture()
 {
   _pCapturingThread->setPriority(QThread::HighestPriority);
@@ -553,6 +611,18 @@ void PiiLineScanEmulator::generateTexture()
   // If texture generator is not set, use a constant color for the background
   if (_pTextureGenerator == 0)
     memset(_frameBuffer.row(_iCurrentLineIndex), _backgroundColor.red(), _iWidth);
+  // Scroll through the cache. Reversing the direction at the ends
+  // avoids a visible seam.
+  else if (!_matTextureCache.isEmpty())
+    {
+      std::memcpy(_frameBuffer.row(_iCurrentLineIndex), _matTextureCache.row(_iTextureCacheRow), _iWidth);
+      if (_matTextureCache.rows() > 1)
+        {
+          _iTextureCacheRow += _iTextureCacheDirection;
+          if (_iTextureCacheRow <= 0 || _iTextureCacheRow >= _matTextureCache.rows()-1)
+            _iTextureCacheDirection = -_iTextureCacheDirection;
+        }
+    }
   // Else use the generator to produce background texture (in blocks)
   else if (_iCurrentLineIndex % _iTextureBlockSize == 0)
     {
@@ -567,6 +637,42 @@ void PiiLineScanEmulator::generateTexture()
     }
 }
 
+void PiiLineScanEmulator::generateTextureCache()
+{
+  if (_pTextureGenerator == 0 || _iTextureCacheRows <= 0)
+    {
+      _matTextureCache = PiiMatrix<unsigned char>();
+      return;
+    }
+
+  // The cache is still valid
+  if (_matTextureCache.rows() == _iTextureCacheRows && _matTextureCache.columns() == _iWidth)
+    return;
+
+  _matTextureCache = PiiMatrix<unsigned char>::uninitialized(_iTextureCacheRows, _iWidth);
+  int iBlockSize = qMax(1, _iTextureBlockSize);
+  for (int r=0; r<_iTextureCacheRows; r += iBlockSize)
+    {
+      _pTextureGenerator->generateTexture(_matTextureCache,
+                                          r, 0,
+                                          qMin(iBlockSize, _iTextureCacheRows - r),
+                                          _iWidth,
+                                          r == 0);
+    }
+  // The next block generated directly to the frame buffer must not
+  // continue from the cache.
+  _bFirstScanLine = true;
+  _iTextureCacheRow = 0;
+  _iTextureCacheDirection = 1;
+}
+
+bool PiiLineScanEmulator::setTextureCacheRows(int textureCacheRows)
+{
+  _iTextureCacheRows = qMax(0, textureCacheRows);
+  _matTextureCache = PiiMatrix<unsigned char>();
+  return true;
+}
+
 bool PiiLineScanEmulator::setTextureGeneratorName(const QString& textureGeneratorName)
 {
   PiiTextureGenerator *pGenerator = PiiYdin::createResource<PiiTextureGenerator>(textureGeneratorName);
@@ -583,6 +689,7 @@ bool PiiLineScanEmulator::setTextureGeneratorName(const QString& textureGenerato
   // Ensure that the generator will not try to continue from what
   // the previous one left behind.
   _bFirstScanLine = true;
+  _matTextureCache = PiiMatrix<unsigned char>();
 
   return true;
 }
@@ -607,6 +714,7 @@ void PiiLineScanEmulator::setImages(const QList<QImage>& images, const QList<QIm
 void PiiLineScanEmulator::generateMultipliers()
 {
   delete[] _dpMultipliers;
+  _dpMultipliers = 0;
 
   int width = _iWidth;
   if (_dFieldOfView != 0 && width > 1)
@@ -719,10 +827,7 @@ void PiiLineScanEmulator::generateLine()
       memset(line + _iWidth - int(_dRightEdgePos), _borderColor.red(), int(_dRightEdgePos));
     }
 
-  // Simulate vignetting
-  if (_dpMultipliers)
-    for (int i=_iWidth; i--; )
-      line[i] = static_cast<unsigned char>(_dpMultipliers[i] * line[i]);
+  // Vignetting is simulated in scaleFrame()
 
   updateTotalDefRate(double(newDefPixels)/_iWidth);
 
@@ -117,6 +117,26 @@ class PII_CAMERAEMULATOR_EXPORT PiiLineScanEmulator : public PiiCameraDriver
    */
   Q_PROPERTY(int textureBlockSize READ textureBlockSize WRITE setTextureBlockSize);
 
+  /**
+   * The number of scan-lines in the texture cache. If this value is
+   * larger than zero, the texture generator is used only once to
+   * fill a cache of this many lines when capture starts. The emulator
+   * then scrolls back and forth through the cache instead of calling
+   * the generator for each new block. This makes the line rate
+   * independent of the cost of the generator and allows emulating
+   * wide cameras at high trigger rates. The cache is regenerated if
+   * the frame size, the generator or its properties change. The
+   * default value is 0, which disables the cache.
+   */
+  Q_PROPERTY(int textureCacheRows READ textureCacheRows WRITE setTextureCacheRows);
+
+  /**
+   * The maximum number of threads used for applying gain, exposure
+   * and vignetting to captured frames. Zero means all processor
+   * cores. The default value is 0.
+   */
+  Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
+
   /**
    * gain description
    */
@@ -201,6 +221,8 @@ public:
   bool setRightEdgeLimit(int rightEdgeLimit) { _iRightEdgeLimit = rightEdgeLimit; return true; }
   bool setTextureGeneratorName(const QString& textureGeneratorName);
   bool setTextureBlockSize(int textureBlockSize) { _iTextureBlockSize = textureBlockSize; return true; }
+  bool setTextureCacheRows(int textureCacheRows);
+  bool setThreadCount(int threadCount) { _iThreadCount = qMax(0,threadCount); return true; }
   bool setGain(double gain) { _dGain = qBound(0.0,gain,1.0); return true; }
   bool setExposureTime(int exposureTime) { _iExposureTime = qMax(1,exposureTime); return true; }
   bool setBaseExposureTime(int baseExposureTime) { _iBaseExposureTime = qMax(1,baseExposureTime); return true; }
@@ -221,6 +243,8 @@ public:
   int rightEdgeLimit() const { return _iRightEdgeLimit; }
   QString textureGeneratorName() const;
   int textureBlockSize() const { return _iTextureBlockSize; }
+  int textureCacheRows() const { return _iTextureCacheRows; }
+  int threadCount() const { return _iThreadCount; }
   double gain() const { return _dGain; }
   int exposureTime() const { return _iExposureTime; }
   int baseExposureTime() const { return _iBaseExposureTime; }
@@ -262,6 +286,7 @@ private:
   int _iLeftEdgeLimit;
   int _iRightEdgeLimit;
   int _iTextureBlockSize;
+  int _iTextureCacheRows, _iThreadCount;
   double _dGain;
   int _iExposureTime;
   int _iBaseExposureTime;
@@ -273,6 +298,14 @@ private:
   QVariantMap _mapGeneratorProperties;
   PiiTextureGenerator* _pTextureGenerator;
 
+  // Pre-generated texture. Empty if the cache is disabled or must be
+  // regenerated.
+  PiiMatrix<unsigned char> _matTextureCache;
+  // The cache row to be copied next and the scrolling direction.
+  int _iTextureCacheRow, _iTextureCacheDirection;
+  // Fixed-point (8.8) intensity multipliers for each column.
+  QVector<int> _vecPixelMultipliers;
+
   bool loadImages();
   void lineAdded();
 
@@ -317,6 +350,8 @@ private:
   QPoint getRandomCoord(const QImage& image);
   void generateLine();
   void generateTexture();
+  void generateTextureCache();
+  void scaleFrame(int firstRow);
   void updateTotalDefRate(double currRowDefRate);
   void generateMultipliers();
   double updateEdgePos(double pos, QPoint& targetPoint, int limit);
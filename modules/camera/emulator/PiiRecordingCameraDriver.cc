@@ -0,0 +1,350 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiRecordingCameraDriver.h"
+#include "PiiFrameRecording.h"
+
+#include <PiiYdinResources.h>
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <cstring>
+
+PiiRecordingCameraDriver::PiiRecordingCameraDriver() :
+  _pDriver(0),
+  _iRecordedFrames(0)
+{
+}
+
+PiiRecordingCameraDriver::~PiiRecordingCameraDriver()
+{
+  close();
+  delete _pDriver;
+}
+
+bool PiiRecordingCameraDriver::isOwnProperty(const char* name) const
+{
+  return metaObject()->indexOfProperty(name) >= staticMetaObject.propertyOffset();
+}
+
+QVariant PiiRecordingCameraDriver::property(const char* name) const
+{
+  if (isOwnProperty(name))
+    return QObject::property(name);
+  if (_pDriver != 0)
+    return _pDriver->property(name);
+  return QVariant();
+}
+
+bool PiiRecordingCameraDriver::setProperty(const char* name, const QVariant& value)
+{
+  if (isOwnProperty(name))
+    return QObject::setProperty(name, value);
+  if (_pDriver != 0)
+    return _pDriver->setProperty(name, value);
+  return false;
+}
+
+bool PiiRecordingCameraDriver::setDriverName(const QString& driverName)
+{
+  if (isOpen())
+    {
+      piiWarning(tr("The recorded driver cannot be changed while the driver is open."));
+      return false;
+    }
+
+  PiiCameraDriver* pDriver = PiiYdin::createResource<PiiCameraDriver>(driverName);
+  if (pDriver == 0)
+    {
+      piiWarning(tr("Camera driver %1 is not available.").arg(driverName));
+      return false;
+    }
+
+  delete _pDriver;
+  _pDriver = pDriver;
+  _pDriver->setParent(this);
+  _pDriver->setListener(this);
+  return true;
+}
+
+QString PiiRecordingCameraDriver::driverName() const
+{
+  if (_pDriver == 0)
+    return "";
+  return _pDriver->metaObject()->className();
+}
+
+QStringList PiiRecordingCameraDriver::cameraList() const
+{
+  return _pDriver != 0 ? _pDriver->cameraList() : QStringList();
+}
+
+void PiiRecordingCameraDriver::initialize(const QString& cameraId)
+{
+  if (_pDriver == 0)
+    PII_THROW(PiiCameraDriverException, tr("The recorded driver has not been set."));
+  _pDriver->initialize(cameraId);
+}
+
+bool PiiRecordingCameraDriver::close()
+{
+  if (_pDriver == 0)
+    return false;
+  bool bResult = _pDriver->close();
+  closeRecording();
+  return bResult;
+}
+
+bool PiiRecordingCameraDriver::startCapture(int frames)
+{
+  if (_pDriver == 0 || !_pDriver->isOpen() || _pDriver->isCapturing())
+    return false;
+
+  if (!openRecording())
+    return false;
+
+  if (!_pDriver->startCapture(frames))
+    {
+      closeRecording();
+      return false;
+    }
+  return true;
+}
+
+bool PiiRecordingCameraDriver::stopCapture()
+{
+  if (_pDriver == 0)
+    return false;
+  bool bResult = _pDriver->stopCapture();
+  closeRecording();
+  return bResult;
+}
+
+bool PiiRecordingCameraDriver::openRecording()
+{
+  QMutexLocker lock(&_fileMutex);
+  _iRecordedFrames = 0;
+  _iTriggerCount.store(0);
+  _timer.restart();
+
+  if (_strFileName.isEmpty())
+    return true;
+
+  _file.setFileName(_strFileName);
+  if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      piiWarning(tr("Cannot open %1 for recording.").arg(_strFileName));
+      return false;
+    }
+
+  PiiFrameRecording::FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, PiiFrameRecording::magic, sizeof(header.magic));
+  header.version = PiiFrameRecording::Version;
+  header.headerSize = sizeof(header);
+  QSize size = _pDriver->frameSize();
+  header.width = size.width();
+  header.height = size.height();
+  header.imageFormat = _pDriver->imageFormat();
+  header.bitsPerPixel = _pDriver->bitsPerPixel();
+  header.cameraType = _pDriver->cameraType();
+  header.triggerMode = _pDriver->triggerMode();
+  header.startTime = QDateTime::currentMSecsSinceEpoch();
+
+  if (_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+    {
+      piiWarning(tr("Cannot write to %1.").arg(_strFileName));
+      _file.close();
+      return false;
+    }
+  return true;
+}
+
+void PiiRecordingCameraDriver::closeRecording()
+{
+  QMutexLocker lock(&_fileMutex);
+  if (_file.isOpen())
+    _file.close();
+}
+
+void PiiRecordingCameraDriver::recordFrame(uint frameIndex, const void* frameBuffer, qint64 elapsedTime)
+{
+  QMutexLocker lock(&_fileMutex);
+  if (!_file.isOpen() || frameBuffer == 0)
+    return;
+
+  PiiFrameRecording::FrameHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.timestamp = _timer.microseconds();
+  header.elapsedTime = elapsedTime;
+  header.frameIndex = frameIndex;
+  int iTriggers = _iTriggerCount.load();
+  _iTriggerCount -= iTriggers;
+  header.triggerCount = iTriggers;
+
+  int iDataSize = _pDriver->frameDataSize(frameIndex);
+  if (iDataSize < 0)
+    {
+      QSize size = _pDriver->frameSize();
+      iDataSize = size.width() * size.height() * _pDriver->bitsPerPixel() / 8;
+    }
+  header.dataSize = iDataSize;
+
+  static const char padding[PiiFrameRecording::Alignment] = { 0 };
+  int iPadding = int(PiiFrameRecording::align(iDataSize) - iDataSize);
+
+  if (_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header) ||
+      _file.write(static_cast<const char*>(frameBuffer), iDataSize) != iDataSize ||
+      _file.write(padding, iPadding) != iPadding)
+    {
+      // Stop recording but let the capture go on.
+      _file.close();
+      lock.unlock();
+      PiiCameraDriver::Listener* pListener = listener();
+      if (pListener != 0)
+        pListener->captureError(tr("Writing to %1 failed. Recording stopped.").arg(_strFileName));
+      return;
+    }
+  ++_iRecordedFrames;
+}
+
+void PiiRecordingCameraDriver::frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime)
+{
+  // Record before passing the frame on. The listener may free or
+  // reuse the buffer.
+  recordFrame(frameIndex,
+              frameBuffer != 0 ? frameBuffer : _pDriver->frameBuffer(frameIndex),
+              elapsedTime);
+
+  PiiCameraDriver::Listener* pListener = listener();
+  if (pListener != 0)
+    pListener->frameCaptured(frameIndex, frameBuffer, elapsedTime);
+  else if (frameBuffer != 0)
+    free(frameBuffer);
+}
+
+void PiiRecordingCameraDriver::framesMissed(uint startIndex, uint endIndex)
+{
+  PiiCameraDriver::Listener* pListener = listener();
+  if (pListener != 0)
+    pListener->framesMissed(startIndex, endIndex);
+}
+
+void PiiRecordingCameraDriver::captureFinished(bool success)
+{
+  closeRecording();
+  PiiCameraDriver::Listener* pListener = listener();
+  if (pListener != 0)
+    pListener->captureFinished(success);
+}
+
+void PiiRecordingCameraDriver::captureError(const QString& message)
+{
+  PiiCameraDriver::Listener* pListener = listener();
+  if (pListener != 0)
+    pListener->captureError(message);
+}
+
+bool PiiRecordingCameraDriver::triggerImage()
+{
+  if (_pDriver == 0)
+    return false;
+  _iTriggerCount.ref();
+  return _pDriver->triggerImage();
+}
+
+void* PiiRecordingCameraDriver::frameBuffer(uint frameIndex) const
+{
+  return _pDriver != 0 ? _pDriver->frameBuffer(frameIndex) : 0;
+}
+
+PiiBufferLease* PiiRecordingCameraDriver::leaseFrame(uint frameIndex)
+{
+  return _pDriver != 0 ? _pDriver->leaseFrame(frameIndex) : 0;
+}
+
+int PiiRecordingCameraDriver::frameDataSize(uint frameIndex) const
+{
+  return _pDriver != 0 ? _pDriver->frameDataSize(frameIndex) : -1;
+}
+
+int PiiRecordingCameraDriver::frameBufferHandle(uint frameIndex) const
+{
+  return _pDriver != 0 ? _pDriver->frameBufferHandle(frameIndex) : -1;
+}
+
+PiiCameraDriver::BufferStatistics PiiRecordingCameraDriver::bufferStatistics() const
+{
+  return _pDriver != 0 ? _pDriver->bufferStatistics() : BufferStatistics();
+}
+
+bool PiiRecordingCameraDriver::resizeFrameBuffers(int bufferCount)
+{
+  return _pDriver != 0 && _pDriver->resizeFrameBuffers(bufferCount);
+}
+
+bool PiiRecordingCameraDriver::isOpen() const
+{
+  return _pDriver != 0 && _pDriver->isOpen();
+}
+
+bool PiiRecordingCameraDriver::isCapturing() const
+{
+  return _pDriver != 0 && _pDriver->isCapturing();
+}
+
+bool PiiRecordingCameraDriver::setTriggerMode(PiiCameraDriver::TriggerMode mode)
+{
+  return _pDriver != 0 && _pDriver->setTriggerMode(mode);
+}
+
+PiiCameraDriver::TriggerMode PiiRecordingCameraDriver::triggerMode() const
+{
+  return _pDriver != 0 ? _pDriver->triggerMode() : PiiCameraDriver::SoftwareTrigger;
+}
+
+int PiiRecordingCameraDriver::bitsPerPixel() const
+{
+  return _pDriver != 0 ? _pDriver->bitsPerPixel() : 0;
+}
+
+QSize PiiRecordingCameraDriver::frameSize() const
+{
+  return _pDriver != 0 ? _pDriver->frameSize() : QSize();
+}
+
+bool PiiRecordingCameraDriver::setFrameSize(const QSize& frameSize)
+{
+  return _pDriver != 0 && _pDriver->setFrameSize(frameSize);
+}
+
+int PiiRecordingCameraDriver::imageFormat() const
+{
+  return _pDriver != 0 ? _pDriver->imageFormat() : (int)PiiCamera::InvalidFormat;
+}
+
+bool PiiRecordingCameraDriver::setImageFormat(int format)
+{
+  return _pDriver != 0 && _pDriver->setImageFormat(format);
+}
+
+QSize PiiRecordingCameraDriver::resolution() const
+{
+  return _pDriver != 0 ? _pDriver->resolution() : QSize();
+}
+
+int PiiRecordingCameraDriver::cameraType() const
+{
+  return _pDriver != 0 ? _pDriver->cameraType() : PiiCameraDriver::cameraType();
+}
@@ -0,0 +1,137 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIRECORDINGCAMERADRIVER_H
+#define _PIIRECORDINGCAMERADRIVER_H
+
+#include <PiiCameraDriver.h>
+#include <PiiAtomicInt.h>
+#include <PiiTimer.h>
+#include "PiiCameraEmulatorGlobal.h"
+
+#include <QFile>
+#include <QMutex>
+
+/**
+ * A camera driver that records the frames captured by another driver.
+ * The recording driver wraps the driver named by [driverName] and
+ * passes its frames to the listener unchanged. While capturing, each
+ * frame is also written to [fileName] together with its timestamp
+ * and the number of software triggers issued before it.
+ * PiiReplayCameraDriver plays the recording back.
+ *
+ * Properties not declared by this class are passed to the wrapped
+ * driver. Thus, the recording driver can be configured just like the
+ * driver it wraps.
+ *
+ * Frames are written in the capture thread of the wrapped driver
+ * before they are passed to the listener. The writes normally go to
+ * the page cache of the operating system, but a slow disk will
+ * eventually slow down the capture.
+ */
+class PII_CAMERAEMULATOR_EXPORT PiiRecordingCameraDriver :
+  public PiiCameraDriver,
+  private PiiCameraDriver::Listener
+{
+  Q_OBJECT
+
+  /**
+   * The class name of the recorded driver, e.g.
+   * "PiiGenicamDriver".
+   */
+  Q_PROPERTY(QString driverName READ driverName WRITE setDriverName STORED false);
+
+  /**
+   * The name of the file frames are recorded to. The file is
+   * overwritten whenever capture is started. If the file name is
+   * empty, nothing will be recorded. The default value is empty.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * The number of frames recorded since capture was last started.
+   */
+  Q_PROPERTY(int recordedFrameCount READ recordedFrameCount);
+
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    PII_SERIALIZE_BASE(archive, PiiCameraDriver);
+    PiiSerialization::serializeProperties(archive, *this);
+    archive & PII_NVP("driver", _pDriver);
+    if (Archive::InputArchive && _pDriver)
+      {
+        _pDriver->setParent(this);
+        _pDriver->setListener(this);
+      }
+  }
+public:
+  PiiRecordingCameraDriver();
+  ~PiiRecordingCameraDriver();
+
+  QVariant property(const char* name) const;
+  bool setProperty(const char* name, const QVariant& value);
+
+  QStringList cameraList() const;
+  void initialize(const QString& cameraId);
+  bool close();
+  bool startCapture(int frames);
+  bool stopCapture();
+  void* frameBuffer(uint frameIndex) const;
+  PiiBufferLease* leaseFrame(uint frameIndex);
+  int frameDataSize(uint frameIndex) const;
+  int frameBufferHandle(uint frameIndex) const;
+  BufferStatistics bufferStatistics() const;
+  bool resizeFrameBuffers(int bufferCount);
+  bool isOpen() const;
+  bool isCapturing() const;
+  bool triggerImage();
+  bool setTriggerMode(PiiCameraDriver::TriggerMode mode);
+  PiiCameraDriver::TriggerMode triggerMode() const;
+  int bitsPerPixel() const;
+  QSize frameSize() const;
+  bool setFrameSize(const QSize& frameSize);
+  int imageFormat() const;
+  bool setImageFormat(int format);
+  QSize resolution() const;
+  int cameraType() const;
+
+  bool setDriverName(const QString& driverName);
+  QString driverName() const;
+  void setFileName(const QString& fileName) { _strFileName = fileName; }
+  QString fileName() const { return _strFileName; }
+  int recordedFrameCount() const { return _iRecordedFrames; }
+
+private:
+  // Listener interface
+  void frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime);
+  void framesMissed(uint startIndex, uint endIndex);
+  void captureFinished(bool success);
+  void captureError(const QString& message);
+
+  bool isOwnProperty(const char* name) const;
+  bool openRecording();
+  void closeRecording();
+  void recordFrame(uint frameIndex, const void* frameBuffer, qint64 elapsedTime);
+
+  PiiCameraDriver* _pDriver;
+  QString _strFileName;
+  QFile _file;
+  QMutex _fileMutex;
+  PiiTimer _timer;
+  PiiAtomicInt _iTriggerCount;
+  int _iRecordedFrames;
+};
+
+#endif //_PIIRECORDINGCAMERADRIVER_H
@@ -0,0 +1,322 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiReplayCameraDriver.h"
+#include "PiiFrameRecording.h"
+
+#include <PiiAsyncCall.h>
+#include <PiiDelay.h>
+
+#include <cstring>
+
+PiiReplayCameraDriver::PiiReplayCameraDriver() :
+  _replayRate(OriginalRate),
+  _dAccelerationFactor(2.0),
+  _bLoop(false),
+  _pMappedData(0),
+  _iImageFormat(PiiCamera::InvalidFormat),
+  _iBitsPerPixel(0),
+  _iCameraType(PiiCamera::AreaScan),
+  _triggerMode(PiiCameraDriver::FreeRun),
+  _pReplayThread(0),
+  _bCapturing(false),
+  _iMaxFrames(0),
+  _triggerWaitCondition(PiiWaitCondition::Queue)
+{
+}
+
+PiiReplayCameraDriver::~PiiReplayCameraDriver()
+{
+  close();
+}
+
+QStringList PiiReplayCameraDriver::cameraList() const
+{
+  return QStringList();
+}
+
+void PiiReplayCameraDriver::initialize(const QString& cameraId)
+{
+  if (_bCapturing)
+    PII_THROW(PiiCameraDriverException, tr("Capturing is running. Stop the capture first."));
+
+  close();
+
+  QVariantMap& dataMap = propertyMap();
+  if (dataMap.contains("fileName"))
+    _strFileName = dataMap.take("fileName").toString();
+  if (!cameraId.isEmpty())
+    _strFileName = cameraId;
+
+  _file.setFileName(_strFileName);
+  if (!_file.open(QIODevice::ReadOnly))
+    PII_THROW(PiiCameraDriverException, tr("Cannot open %1.").arg(_strFileName));
+
+  qint64 iFileSize = _file.size();
+  if (iFileSize < qint64(sizeof(PiiFrameRecording::FileHeader)))
+    {
+      _file.close();
+      PII_THROW(PiiCameraDriverException, tr("%1 is not a frame recording.").arg(_strFileName));
+    }
+
+  // Map privately so that receivers can modify the frames they get
+  // without touching the file.
+#if QT_VERSION >= 0x050400
+  _pMappedData = _file.map(0, iFileSize, QFileDevice::MapPrivateOption);
+#else
+  _pMappedData = _file.map(0, iFileSize);
+#endif
+  if (_pMappedData == 0)
+    {
+      _file.close();
+      PII_THROW(PiiCameraDriverException, tr("Cannot map %1 to memory.").arg(_strFileName));
+    }
+
+  const PiiFrameRecording::FileHeader* pHeader =
+    reinterpret_cast<const PiiFrameRecording::FileHeader*>(_pMappedData);
+  if (std::memcmp(pHeader->magic, PiiFrameRecording::magic, sizeof(pHeader->magic)) != 0 ||
+      pHeader->version != PiiFrameRecording::Version ||
+      pHeader->headerSize < sizeof(PiiFrameRecording::FileHeader))
+    {
+      unmap();
+      PII_THROW(PiiCameraDriverException, tr("%1 is not a frame recording.").arg(_strFileName));
+    }
+
+  _frameSize = QSize(pHeader->width, pHeader->height);
+  _iImageFormat = pHeader->imageFormat;
+  _iBitsPerPixel = pHeader->bitsPerPixel;
+  _iCameraType = pHeader->cameraType;
+  _triggerMode = PiiCameraDriver::TriggerMode(pHeader->triggerMode);
+
+  // Index all complete frame records. An interrupted recording may
+  // end with a partial one.
+  for (qint64 iOffset = pHeader->headerSize;
+       iOffset + qint64(sizeof(PiiFrameRecording::FrameHeader)) <= iFileSize; )
+    {
+      const PiiFrameRecording::FrameHeader* pFrame =
+        reinterpret_cast<const PiiFrameRecording::FrameHeader*>(_pMappedData + iOffset);
+      qint64 iDataEnd = iOffset + sizeof(PiiFrameRecording::FrameHeader) + pFrame->dataSize;
+      if (iDataEnd > iFileSize)
+        break;
+      _vecFrameOffsets << iOffset;
+      iOffset += sizeof(PiiFrameRecording::FrameHeader) + PiiFrameRecording::align(pFrame->dataSize);
+    }
+
+  if (_vecFrameOffsets.isEmpty())
+    {
+      unmap();
+      PII_THROW(PiiCameraDriverException, tr("%1 contains no frames.").arg(_strFileName));
+    }
+
+  // Write all configuration values from the map
+  for (QVariantMap::iterator i=dataMap.begin(); i != dataMap.end(); ++i)
+    {
+      if (!QObject::setProperty(qPrintable(i.key()), i.value()))
+        {
+          unmap();
+          PII_THROW(PiiCameraDriverException, tr("Couldn't write the configuration value '%1'").arg(i.key()));
+        }
+    }
+  dataMap.clear();
+}
+
+void PiiReplayCameraDriver::unmap()
+{
+  if (_pMappedData != 0)
+    {
+      _file.unmap(_pMappedData);
+      _pMappedData = 0;
+    }
+  _file.close();
+  _vecFrameOffsets.clear();
+}
+
+bool PiiReplayCameraDriver::close()
+{
+  if (_pMappedData == 0)
+    return false;
+
+  stopCapture();
+  delete _pReplayThread;
+  _pReplayThread = 0;
+
+  // Leased frames point to the mapping.
+  _leases.waitForLeases();
+  unmap();
+  return true;
+}
+
+bool PiiReplayCameraDriver::startCapture(int frames)
+{
+  if (_pMappedData == 0 || listener() == 0 || _bCapturing)
+    return false;
+
+  // The previous replay may have ended by itself.
+  if (_pReplayThread != 0)
+    {
+      _pReplayThread->wait();
+      delete _pReplayThread;
+    }
+
+  _iMaxFrames = frames;
+  _iCapturedFrames.store(0);
+  _leases.resetStatistics();
+  _bCapturing = true;
+  _pReplayThread = Pii::createAsyncCall(this, &PiiReplayCameraDriver::replay);
+  _pReplayThread->start();
+  return true;
+}
+
+bool PiiReplayCameraDriver::stopCapture()
+{
+  if (!_bCapturing)
+    return false;
+
+  _bCapturing = false;
+  _triggerWaitCondition.wakeAll();
+  _stopWaitCondition.wakeAll();
+  _pReplayThread->wait();
+  return true;
+}
+
+bool PiiReplayCameraDriver::sleepUntil(const PiiTimer& timer, qint64 time)
+{
+  for (;;)
+    {
+      if (!_bCapturing)
+        return false;
+      qint64 iRemaining = time - timer.microseconds();
+      if (iRemaining <= 0)
+        return true;
+      // Sleep coarsely on the wait condition so that stopCapture()
+      // can interrupt, and wait for the last fraction precisely.
+      if (iRemaining > 2000)
+        _stopWaitCondition.wait((unsigned long)(iRemaining - 1000) / 1000);
+      else
+        PiiDelay::usleep(int(iRemaining));
+    }
+}
+
+void PiiReplayCameraDriver::replay()
+{
+  const int iRecordedFrames = _vecFrameOffsets.size();
+  const double dSpeed = _replayRate == AcceleratedRate ? _dAccelerationFactor : 1.0;
+  PiiTimer timer;
+  qint64 iLoopStartTime = 0, iFirstTimestamp = 0;
+
+  for (uint uiFrameIndex = 0; _bCapturing; ++uiFrameIndex)
+    {
+      if (_iMaxFrames > 0 && uiFrameIndex >= uint(_iMaxFrames))
+        break;
+
+      int iRecord = uiFrameIndex % iRecordedFrames;
+      if (iRecord == 0 && uiFrameIndex > 0 && !_bLoop)
+        break;
+
+      const PiiFrameRecording::FrameHeader* pHeader =
+        reinterpret_cast<const PiiFrameRecording::FrameHeader*>(frameRecord(uiFrameIndex));
+
+      if (_triggerMode == PiiCameraDriver::SoftwareTrigger)
+        {
+          _triggerWaitCondition.wait();
+          if (!_bCapturing)
+            break;
+        }
+      else if (_replayRate != MaximumRate)
+        {
+          // Each round through the recording restarts the clock.
+          if (iRecord == 0)
+            {
+              iLoopStartTime = timer.microseconds();
+              iFirstTimestamp = pHeader->timestamp;
+            }
+          if (!sleepUntil(timer, iLoopStartTime + qint64((pHeader->timestamp - iFirstTimestamp) / dSpeed)))
+            break;
+        }
+
+      _iCapturedFrames.ref();
+      listener()->frameCaptured(uiFrameIndex, 0, qint64(pHeader->elapsedTime / dSpeed));
+    }
+
+  _bCapturing = false;
+  listener()->captureFinished(true);
+}
+
+const uchar* PiiReplayCameraDriver::frameRecord(uint frameIndex) const
+{
+  return _pMappedData + _vecFrameOffsets[frameIndex % _vecFrameOffsets.size()];
+}
+
+void* PiiReplayCameraDriver::frameBuffer(uint frameIndex) const
+{
+  if (_pMappedData == 0)
+    return 0;
+  return const_cast<uchar*>(frameRecord(frameIndex)) + sizeof(PiiFrameRecording::FrameHeader);
+}
+
+PiiBufferLease* PiiReplayCameraDriver::leaseFrame(uint /*frameIndex*/)
+{
+  // Frames are never overwritten, so the lease only keeps the mapping
+  // alive.
+  return _leases.createLease();
+}
+
+int PiiReplayCameraDriver::frameDataSize(uint frameIndex) const
+{
+  if (_pMappedData == 0)
+    return -1;
+  return reinterpret_cast<const PiiFrameRecording::FrameHeader*>(frameRecord(frameIndex))->dataSize;
+}
+
+PiiCameraDriver::BufferStatistics PiiReplayCameraDriver::bufferStatistics() const
+{
+  BufferStatistics statistics;
+  statistics.bufferCount = _vecFrameOffsets.size();
+  statistics.queuedBuffers = statistics.minQueuedBuffers = statistics.bufferCount;
+  statistics.capturedFrames = _iCapturedFrames.load();
+  _leases.fillStatistics(statistics);
+  return statistics;
+}
+
+bool PiiReplayCameraDriver::isOpen() const
+{
+  return _pMappedData != 0;
+}
+
+bool PiiReplayCameraDriver::isCapturing() const
+{
+  return _bCapturing;
+}
+
+bool PiiReplayCameraDriver::triggerImage()
+{
+  _triggerWaitCondition.wakeOne();
+  return true;
+}
+
+bool PiiReplayCameraDriver::setTriggerMode(PiiCameraDriver::TriggerMode mode)
+{
+  _triggerMode = mode;
+  return true;
+}
+
+PiiCameraDriver::TriggerMode PiiReplayCameraDriver::triggerMode() const
+{
+  return _triggerMode;
+}
+
+bool PiiReplayCameraDriver::requiresInitialization(const char* name) const
+{
+  return std::strcmp(name, "fileName") == 0;
+}
@@ -0,0 +1,168 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIREPLAYCAMERADRIVER_H
+#define _PIIREPLAYCAMERADRIVER_H
+
+#include <PiiCameraDriver.h>
+#include <PiiWaitCondition.h>
+#include <PiiAtomicInt.h>
+#include <PiiTimer.h>
+#include "PiiCameraEmulatorGlobal.h"
+
+#include <QFile>
+#include <QVector>
+
+class QThread;
+
+/**
+ * A camera driver that plays back frames recorded by
+ * PiiRecordingCameraDriver. The recording is memory-mapped, and
+ * frames are leased to the listener straight from the mapping.
+ * Nothing is copied unless the receiver modifies a frame.
+ *
+ * Frames are delivered in the capture thread. The driver never
+ * drops frames. If the listener cannot keep up with the requested
+ * [replayRate], the replay slows down. Thus, replay at
+ * `MaximumRate` measures the throughput of the processing pipeline
+ * with exactly the input it saw in production.
+ *
+ * The frame size, image format and the other camera parameters are
+ * read-only and come from the recording. The trigger mode defaults
+ * to that of the recording. In `SoftwareTrigger` mode, one frame is
+ * played back per [triggerImage()] call, and time stamps are
+ * ignored.
+ */
+class PII_CAMERAEMULATOR_EXPORT PiiReplayCameraDriver : public PiiCameraDriver
+{
+  Q_OBJECT
+
+  /**
+   * The name of the recording to play back. If the camera id passed
+   * to [initialize()] is not empty, it will be used as the file name.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * Replay speed. The default value is `OriginalRate`.
+   */
+  Q_PROPERTY(ReplayRate replayRate READ replayRate WRITE setReplayRate);
+  Q_ENUMS(ReplayRate);
+
+  /**
+   * The speed-up factor used when [replayRate] is `AcceleratedRate`.
+   * The default value is 2.
+   */
+  Q_PROPERTY(double accelerationFactor READ accelerationFactor WRITE setAccelerationFactor);
+
+  /**
+   * If `true`, the recording will be played back from the beginning
+   * once its end is reached. Frame indices continue to grow. The
+   * default value is `false`.
+   */
+  Q_PROPERTY(bool loop READ loop WRITE setLoop);
+
+  /**
+   * The number of frames in the recording.
+   */
+  Q_PROPERTY(int recordedFrameCount READ recordedFrameCount);
+
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    PII_SERIALIZE_BASE(archive, PiiCameraDriver);
+    PiiSerialization::serializeProperties(archive, *this);
+  }
+public:
+  /**
+   * Replay speeds.
+   *
+   * - `OriginalRate` - frames are delivered at their recorded time
+   * stamps.
+   *
+   * - `AcceleratedRate` - time stamps are divided by
+   * [accelerationFactor].
+   *
+   * - `MaximumRate` - frames are delivered as fast as the listener
+   * accepts them.
+   */
+  enum ReplayRate { OriginalRate, AcceleratedRate, MaximumRate };
+
+  PiiReplayCameraDriver();
+  ~PiiReplayCameraDriver();
+
+  QStringList cameraList() const;
+  void initialize(const QString& cameraId);
+  bool close();
+  bool startCapture(int frames);
+  bool stopCapture();
+  void* frameBuffer(uint frameIndex) const;
+  PiiBufferLease* leaseFrame(uint frameIndex);
+  int frameDataSize(uint frameIndex) const;
+  BufferStatistics bufferStatistics() const;
+  bool isOpen() const;
+  bool isCapturing() const;
+  bool triggerImage();
+  bool setTriggerMode(PiiCameraDriver::TriggerMode mode);
+  PiiCameraDriver::TriggerMode triggerMode() const;
+  int bitsPerPixel() const { return _iBitsPerPixel; }
+  QSize frameSize() const { return _frameSize; }
+  bool setFrameSize(const QSize& frameSize) { return frameSize == _frameSize; }
+  int imageFormat() const { return _iImageFormat; }
+  bool setImageFormat(int format) { return format == _iImageFormat; }
+  QSize resolution() const { return _frameSize; }
+  int cameraType() const { return _iCameraType; }
+
+  void setFileName(const QString& fileName) { _strFileName = fileName; }
+  QString fileName() const { return _strFileName; }
+  void setReplayRate(ReplayRate replayRate) { _replayRate = replayRate; }
+  ReplayRate replayRate() const { return _replayRate; }
+  void setAccelerationFactor(double accelerationFactor) { _dAccelerationFactor = qMax(1e-3, accelerationFactor); }
+  double accelerationFactor() const { return _dAccelerationFactor; }
+  void setLoop(bool loop) { _bLoop = loop; }
+  bool loop() const { return _bLoop; }
+  int recordedFrameCount() const { return _vecFrameOffsets.size(); }
+
+protected:
+  bool requiresInitialization(const char* name) const;
+
+private:
+  const uchar* frameRecord(uint frameIndex) const;
+  void replay();
+  void unmap();
+  bool sleepUntil(const PiiTimer& timer, qint64 time);
+
+  QString _strFileName;
+  ReplayRate _replayRate;
+  double _dAccelerationFactor;
+  bool _bLoop;
+
+  QFile _file;
+  uchar* _pMappedData;
+  // Offsets of frame records in the mapped file.
+  QVector<qint64> _vecFrameOffsets;
+
+  QSize _frameSize;
+  int _iImageFormat, _iBitsPerPixel, _iCameraType;
+  PiiCameraDriver::TriggerMode _triggerMode;
+
+  QThread* _pReplayThread;
+  volatile bool _bCapturing;
+  int _iMaxFrames;
+  PiiWaitCondition _triggerWaitCondition, _stopWaitCondition;
+  LeaseCounter _leases;
+  PiiAtomicInt _iCapturedFrames;
+};
+
+#endif //_PIIREPLAYCAMERADRIVER_H
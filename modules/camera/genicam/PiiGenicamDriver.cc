@@ -41,6 +41,7 @@ PiiGenicamDriver::~PiiGenicamDriver()
   if (_bWrapperFunctionsInitialized)
     genicamTerminate();
 
+  _leases.waitForLeases();
   delete[] _pBuffer;
 }
 
@@ -202,6 +203,11 @@ void PiiGenicamDriver::initializeGenicamDevice(const QString& camId)
     }
   mapProperties.clear();
 
+  allocateFrameBuffers();
+}
+
+void PiiGenicamDriver::allocateFrameBuffers()
+{
   // Create an image buffer
   int iImageSize = 0;
   if (genicamGetProperty(_pDevice, "payloadSize", &iImageSize) != 0)
@@ -215,6 +221,7 @@ void PiiGenicamDriver::initializeGenicamDevice(const QString& camId)
 
   _vecBufferPointers.fill(0,_iFrameBufferCount);
 
+  _leases.waitForLeases();
   delete[] _pBuffer;
   _pBuffer = pBuffer;
 }
@@ -305,15 +312,27 @@ bool PiiGenicamDriver::startCapture(int frames)
   if (_pCapturingThread == 0)
     _pCapturingThread = Pii::createAsyncCall(this, &PiiGenicamDriver::capture);
 
-  _bCapturingRunning = true;
   _iFrameIndex = -1;
   _iHandledFrameCount = 0;
   _iMaxFrames = _triggerMode == SoftwareTrigger ? 0 : frames;
+  _iGrabbedBuffers = 0;
+  _iMinQueuedBuffers = _iFrameBufferCount;
+  _iCapturedFrames = 0;
+  _iMissedFrames = 0;
+  _leases.resetStatistics();
+
+  return startCaptureThread();
+}
+
+bool PiiGenicamDriver::startCaptureThread()
+{
+  _bCapturingRunning = true;
 
   // Let the camera acquire
   if (genicamStartCapture(_pDevice) != 0)
     {
       piiWarning(lastError());
+      _bCapturingRunning = false;
       return false;
     }
 
@@ -322,6 +341,59 @@ bool PiiGenicamDriver::startCapture(int frames)
   return true;
 }
 
+bool PiiGenicamDriver::resizeFrameBuffers(int bufferCount)
+{
+  if (!_bOpen || _pDevice == 0 || bufferCount < 1)
+    return false;
+
+  // The capture thread must not touch the buffers while they are
+  // being replaced. Frame indices and statistics are retained.
+  bool bCapturing = stopCapture();
+
+  int iOldCount = _iFrameBufferCount;
+  bool bSuccess = true;
+  try
+    {
+      if (genicamDeregisterFramebuffers(_pDevice) != 0)
+        PII_THROW(PiiCameraDriverException, tr("Could not deregister frame buffers: %1").arg(lastError()));
+      _iFrameBufferCount = bufferCount;
+      try
+        {
+          allocateFrameBuffers();
+        }
+      catch (PiiException& ex)
+        {
+          // Try to get the old buffers back.
+          piiWarning(ex.message());
+          bSuccess = false;
+          _iFrameBufferCount = iOldCount;
+          allocateFrameBuffers();
+        }
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+      return false;
+    }
+
+  _iMinQueuedBuffers = qMin(_iMinQueuedBuffers.load(), _iFrameBufferCount);
+  if (bCapturing && !startCaptureThread())
+    return false;
+  return bSuccess;
+}
+
+PiiCameraDriver::BufferStatistics PiiGenicamDriver::bufferStatistics() const
+{
+  BufferStatistics statistics;
+  statistics.bufferCount = _iFrameBufferCount;
+  statistics.queuedBuffers = _iFrameBufferCount - _iGrabbedBuffers.load();
+  statistics.minQueuedBuffers = _iMinQueuedBuffers.load();
+  statistics.capturedFrames = _iCapturedFrames.load();
+  statistics.missedFrames = _iMissedFrames.load();
+  _leases.fillStatistics(statistics);
+  return statistics;
+}
+
 bool PiiGenicamDriver::stopCapture()
 {
   if (!_bCapturingRunning)
@@ -398,6 +470,7 @@ void PiiGenicamDriver::capture()
                       int adder = _iFrameBufferCount - _iFrameIndex % _iFrameBufferCount;
                       if (adder > 0)
                         {
+                          _iMissedFrames += adder;
                           listener()->framesMissed(_iFrameIndex+1, _iFrameIndex+adder);
                           _iFrameIndex += adder;
                         }
@@ -410,8 +483,16 @@ void PiiGenicamDriver::capture()
         }
       while (!bSoftwareTrigger && lstBuffers.size() < _iFrameBufferCount);
 
+      // Until requeued, the grabbed buffers are not available to the
+      // device.
+      _iGrabbedBuffers = lstBuffers.size();
+      _iCapturedFrames += lstBuffers.size();
+      if (_iFrameBufferCount - lstBuffers.size() < _iMinQueuedBuffers.load())
+        _iMinQueuedBuffers = _iFrameBufferCount - lstBuffers.size();
+
       if (lstBuffers.size() > _iFrameBufferCount/2)
         {
+          _iMissedFrames += lstBuffers.size()-1;
           listener()->framesMissed(_iFrameIndex+1, _iFrameIndex+lstBuffers.size()-1);
           _iFrameIndex += lstBuffers.size();
           _vecBufferPointers[_iFrameIndex % _iFrameBufferCount] = lstBuffers.last();
@@ -434,11 +515,13 @@ void PiiGenicamDriver::capture()
       if (lstBuffers.size() > 0)
         lstBuffers.clear();
 
+      waitForLeases();
       if (genicamRequeueBuffers(_pDevice) != 0)
         {
           piiWarning(tr("Couldn't requeue buffers: %1").arg(lastError()));
           _bCapturingRunning = false;
         }
+      _iGrabbedBuffers = 0;
 
       // Check if we must stop capturing
       if (_iMaxFrames > 0)
@@ -457,6 +540,20 @@ void PiiGenicamDriver::capture()
   listener()->captureFinished(true);
 }
 
+void PiiGenicamDriver::waitForLeases()
+{
+  // Don't block a stop request forever. Once capture has been
+  // stopped, the buffers will not be overwritten.
+  while (!_leases.waitForLeases(100))
+    if (!_bCapturingRunning)
+      break;
+}
+
+PiiBufferLease* PiiGenicamDriver::leaseFrame(uint /*frameIndex*/)
+{
+  return _leases.createLease();
+}
+
 void* PiiGenicamDriver::frameBuffer(uint frameIndex) const
 {
   frameIndex %= _iFrameBufferCount;
@@ -29,6 +29,7 @@ extern "C"
 #include <QMutex>
 #include <QLibrary>
 #include <PiiCameraDriver.h>
+#include <PiiAtomicInt.h>
 
 /// @internal
 class PII_CAMERA_EXPORT PiiGenicamDriver : public PiiCameraDriver
@@ -78,6 +79,9 @@ public:
   bool startCapture(int frames);
   bool stopCapture();
   void* frameBuffer(uint frameIndex) const;
+  PiiBufferLease* leaseFrame(uint frameIndex);
+  BufferStatistics bufferStatistics() const;
+  bool resizeFrameBuffers(int bufferCount);
   bool isOpen() const;
   bool isCapturing() const;
   bool triggerImage();
@@ -128,6 +132,8 @@ protected:
   template <class T> T resolveLib(QLibrary& lib, const QString& name);
   void initializeWrapperFunctions();
   void initializeGenicamDevice(const QString& camId);
+  void allocateFrameBuffers();
+  bool startCaptureThread();
 
   QString _strWrapperLibrary;
   bool _bWrapperFunctionsInitialized;
@@ -152,6 +158,7 @@ protected:
 
   void capture();
   bool reconnect();
+  void waitForLeases();
 
   genicam_device* _pDevice;
   unsigned char* _pBuffer;
@@ -169,6 +176,11 @@ protected:
   TriggerMode _triggerMode;
   int _iFrameBufferCount;
   mutable QMutex _reconnectMutex;
+  // The wrapper requeues all buffers at once. Leased frames must be
+  // released before that.
+  LeaseCounter _leases;
+  // Buffer statistics
+  PiiAtomicInt _iGrabbedBuffers, _iMinQueuedBuffers, _iCapturedFrames, _iMissedFrames;
 
 private:
   QString lastError() const;
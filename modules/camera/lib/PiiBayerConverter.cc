@@ -15,6 +15,17 @@
 
 #include "PiiBayerConverter.h"
 
+#include <PiiCpu.h>
+#include <PiiMath.h>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define PII_BAYER_SSE2 1
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_BAYER_NEON 1
+#endif
+
 namespace PiiCamera
 {
   PiiMatrix<PiiColor4<> > rggbToRgb(const PiiMatrix<unsigned char>& encoded)
@@ -26,4 +37,345 @@ namespace PiiCamera
   {
     return bayerToRgb(encoded, GrbgDecoder<unsigned char>(), Rgb4Pixel<>());
   }
+
+  /* Demosaicing is done one row at a time. Each row of the Bayer
+     pattern contains two kinds of sites that alternate. For each
+     kind, rowLayout() tells which interpolation produces each of the
+     three color channels. The vector loops calculate all
+     interpolations for a block of pixels and pick the right one for
+     each channel with masks that alternate between even and odd
+     columns. Pixels on the borders average the neighbors that are
+     available, just like the border functions of the interpolators
+     used by bayerToRgb().
+   */
+  namespace
+  {
+    enum Interpolation { Center, Straight, Diagonal, Horizontal, Vertical, EdgeAware };
+
+    // kinds[column parity][channel]
+    bool rowLayout(ImageFormat format, int row, BayerInterpolation interpolation, int kinds[2][3])
+    {
+      bool bRedRow, bGreenFirst;
+      switch (format)
+        {
+        case BayerRGGBFormat: bRedRow = true; bGreenFirst = false; break;
+        case BayerBGGRFormat: bRedRow = false; bGreenFirst = false; break;
+        case BayerGRBGFormat: bRedRow = true; bGreenFirst = true; break;
+        case BayerGBRGFormat: bRedRow = false; bGreenFirst = true; break;
+        default: return false;
+        }
+      if (row & 1)
+        {
+          bRedRow = !bRedRow;
+          bGreenFirst = !bGreenFirst;
+        }
+
+      const int iGreen = interpolation == EdgeAwareBayerInterpolation ? EdgeAware : Straight;
+      for (int iParity=0; iParity<2; ++iParity)
+        {
+          int* pKinds = kinds[iParity];
+          if (bGreenFirst == (iParity == 0))
+            {
+              // Green site: red and blue neighbors are either
+              // horizontal or vertical.
+              pKinds[0] = bRedRow ? Horizontal : Vertical;
+              pKinds[1] = Center;
+              pKinds[2] = bRedRow ? Vertical : Horizontal;
+            }
+          else
+            {
+              pKinds[0] = bRedRow ? Center : Diagonal;
+              pKinds[1] = iGreen;
+              pKinds[2] = bRedRow ? Diagonal : Center;
+            }
+        }
+      return true;
+    }
+
+    template <class T> inline void addNeighbor(const PiiMatrix<T>& encoded, int r, int c, int* sum, int* count)
+    {
+      if (r >= 0 && r < encoded.rows() && c >= 0 && c < encoded.columns())
+        {
+          *sum += encoded(r,c);
+          ++*count;
+        }
+    }
+
+    template <class T> int borderValue(const PiiMatrix<T>& encoded, int r, int c, int kind)
+    {
+      int iSum = 0, iCount = 0;
+      if (kind == Center)
+        return encoded(r,c);
+      if (kind == Diagonal)
+        {
+          addNeighbor(encoded, r-1, c-1, &iSum, &iCount);
+          addNeighbor(encoded, r-1, c+1, &iSum, &iCount);
+          addNeighbor(encoded, r+1, c-1, &iSum, &iCount);
+          addNeighbor(encoded, r+1, c+1, &iSum, &iCount);
+        }
+      else
+        {
+          if (kind != Vertical)
+            {
+              addNeighbor(encoded, r, c-1, &iSum, &iCount);
+              addNeighbor(encoded, r, c+1, &iSum, &iCount);
+            }
+          if (kind != Horizontal)
+            {
+              addNeighbor(encoded, r-1, c, &iSum, &iCount);
+              addNeighbor(encoded, r+1, c, &iSum, &iCount);
+            }
+        }
+      return iSum / iCount;
+    }
+
+    template <class T> inline int interiorValue(const T* row0, const T* row1, const T* row2, int c, int kind)
+    {
+      switch (kind)
+        {
+        case Center:
+          return row1[c];
+        case Diagonal:
+          return (row0[c-1] + row0[c+1] + row2[c-1] + row2[c+1]) >> 2;
+        case Horizontal:
+          return (row1[c-1] + row1[c+1]) >> 1;
+        case Vertical:
+          return (row0[c] + row2[c]) >> 1;
+        case EdgeAware:
+          {
+            const int iHorizontal = Pii::abs(int(row1[c-1]) - int(row1[c+1]));
+            const int iVertical = Pii::abs(int(row0[c]) - int(row2[c]));
+            if (iHorizontal < iVertical)
+              return (row1[c-1] + row1[c+1]) >> 1;
+            else if (iVertical < iHorizontal)
+              return (row0[c] + row2[c]) >> 1;
+          }
+          // Fall through
+        default:
+          return (row0[c] + row2[c] + row1[c-1] + row1[c+1]) >> 2;
+        }
+    }
+
+    bool isVectorized()
+    {
+#if defined(PII_BAYER_SSE2)
+      return Pii::hasCpuFeature(Pii::CpuSse2);
+#elif defined(PII_BAYER_NEON)
+      return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+      return false;
+#endif
+    }
+
+#if defined(PII_BAYER_SSE2) || defined(PII_BAYER_NEON)
+    /* Processes the interior columns of a row up to end (exclusive)
+       in blocks of Ops::Step pixels. Returns the first column that
+       was not processed.
+     */
+    template <class Ops, class T>
+    int interiorBlocks(const T* row0, const T* row1, const T* row2, int end,
+                       const int kinds[2][3], bool edgeAware, T** targets)
+    {
+      typedef typename Ops::Vec Vec;
+      // Processing starts at column one. Thus, odd lanes hold even
+      // columns.
+      const Vec evenColumns = Ops::oddLanes();
+      Vec aValues[6];
+      int c = 1;
+      for (; c + Ops::Step <= end; c += Ops::Step)
+        {
+          const Vec up = Ops::load(row0 + c), down = Ops::load(row2 + c);
+          const Vec left = Ops::load(row1 + c - 1), right = Ops::load(row1 + c + 1);
+          const Vec vertical = Ops::add(up, down), horizontal = Ops::add(left, right);
+          aValues[Center] = Ops::load(row1 + c);
+          aValues[Straight] = Ops::quarter(Ops::add(vertical, horizontal));
+          aValues[Diagonal] = Ops::quarter(Ops::add(Ops::add(Ops::load(row0 + c - 1), Ops::load(row0 + c + 1)),
+                                                    Ops::add(Ops::load(row2 + c - 1), Ops::load(row2 + c + 1))));
+          aValues[Horizontal] = Ops::half(horizontal);
+          aValues[Vertical] = Ops::half(vertical);
+          if (edgeAware)
+            {
+              const Vec gradientX = Ops::absDiff(left, right), gradientY = Ops::absDiff(up, down);
+              aValues[EdgeAware] = Ops::select(Ops::less(gradientX, gradientY), aValues[Horizontal],
+                                               Ops::select(Ops::less(gradientY, gradientX), aValues[Vertical],
+                                                           aValues[Straight]));
+            }
+          for (int i=0; i<3; ++i)
+            Ops::store(targets[i] + c, Ops::select(evenColumns, aValues[kinds[0][i]], aValues[kinds[1][i]]));
+        }
+      return c;
+    }
+#endif
+  }
+
+#ifdef PII_BAYER_SSE2
+  namespace Sse2
+  {
+    // 8-bit input in 16-bit lanes
+    struct Ops8
+    {
+      typedef __m128i Vec;
+      enum { Step = 8 };
+      static Vec load(const unsigned char* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128()); }
+      static void store(unsigned char* p, Vec v) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(v, v)); }
+      static Vec add(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+      static Vec half(Vec a) { return _mm_srli_epi16(a, 1); }
+      static Vec quarter(Vec a) { return _mm_srli_epi16(a, 2); }
+      static Vec absDiff(Vec a, Vec b) { return _mm_sub_epi16(_mm_max_epi16(a, b), _mm_min_epi16(a, b)); }
+      static Vec less(Vec a, Vec b) { return _mm_cmplt_epi16(a, b); }
+      static Vec select(Vec mask, Vec a, Vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+      static Vec oddLanes() { return _mm_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1); }
+    };
+
+    // 16-bit input in 32-bit lanes
+    struct Ops16
+    {
+      typedef __m128i Vec;
+      enum { Step = 4 };
+      static Vec load(const unsigned short* p) { return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128()); }
+      static void store(unsigned short* p, Vec v)
+      {
+        // SSE2 has no unsigned 32-to-16 bit pack. Shift to signed
+        // range, pack, and shift back.
+        const __m128i words = _mm_packs_epi32(_mm_sub_epi32(v, _mm_set1_epi32(0x8000)), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_xor_si128(words, _mm_set1_epi16(-0x8000)));
+      }
+      static Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+      static Vec half(Vec a) { return _mm_srli_epi32(a, 1); }
+      static Vec quarter(Vec a) { return _mm_srli_epi32(a, 2); }
+      static Vec absDiff(Vec a, Vec b)
+      {
+        const __m128i diff = _mm_sub_epi32(a, b), sign = _mm_srai_epi32(diff, 31);
+        return _mm_sub_epi32(_mm_xor_si128(diff, sign), sign);
+      }
+      static Vec less(Vec a, Vec b) { return _mm_cmplt_epi32(a, b); }
+      static Vec select(Vec mask, Vec a, Vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+      static Vec oddLanes() { return _mm_setr_epi32(0, -1, 0, -1); }
+    };
+
+    template <class T> struct OpsFor;
+    template <> struct OpsFor<unsigned char> { typedef Ops8 Type; };
+    template <> struct OpsFor<unsigned short> { typedef Ops16 Type; };
+  }
+#endif
+
+#ifdef PII_BAYER_NEON
+  namespace Neon
+  {
+    struct Ops8
+    {
+      typedef uint16x8_t Vec;
+      enum { Step = 8 };
+      static Vec load(const unsigned char* p) { return vmovl_u8(vld1_u8(p)); }
+      static void store(unsigned char* p, Vec v) { vst1_u8(p, vmovn_u16(v)); }
+      static Vec add(Vec a, Vec b) { return vaddq_u16(a, b); }
+      static Vec half(Vec a) { return vshrq_n_u16(a, 1); }
+      static Vec quarter(Vec a) { return vshrq_n_u16(a, 2); }
+      static Vec absDiff(Vec a, Vec b) { return vabdq_u16(a, b); }
+      static Vec less(Vec a, Vec b) { return vcltq_u16(a, b); }
+      static Vec select(Vec mask, Vec a, Vec b) { return vbslq_u16(mask, a, b); }
+      static Vec oddLanes()
+      {
+        static const uint16_t aMask[8] = { 0, 0xffff, 0, 0xffff, 0, 0xffff, 0, 0xffff };
+        return vld1q_u16(aMask);
+      }
+    };
+
+    struct Ops16
+    {
+      typedef uint32x4_t Vec;
+      enum { Step = 4 };
+      static Vec load(const unsigned short* p) { return vmovl_u16(vld1_u16(p)); }
+      static void store(unsigned short* p, Vec v) { vst1_u16(p, vmovn_u32(v)); }
+      static Vec add(Vec a, Vec b) { return vaddq_u32(a, b); }
+      static Vec half(Vec a) { return vshrq_n_u32(a, 1); }
+      static Vec quarter(Vec a) { return vshrq_n_u32(a, 2); }
+      static Vec absDiff(Vec a, Vec b) { return vabdq_u32(a, b); }
+      static Vec less(Vec a, Vec b) { return vcltq_u32(a, b); }
+      static Vec select(Vec mask, Vec a, Vec b) { return vbslq_u32(mask, a, b); }
+      static Vec oddLanes()
+      {
+        static const uint32_t aMask[4] = { 0, 0xffffffff, 0, 0xffffffff };
+        return vld1q_u32(aMask);
+      }
+    };
+
+    template <class T> struct OpsFor;
+    template <> struct OpsFor<unsigned char> { typedef Ops8 Type; };
+    template <> struct OpsFor<unsigned short> { typedef Ops16 Type; };
+  }
+#endif
+
+  namespace
+  {
+    template <class T> bool demosaicRowImpl(const PiiMatrix<T>& encoded, int row,
+                                            ImageFormat format, BayerInterpolation interpolation,
+                                            T* red, T* green, T* blue)
+    {
+      const int iRows = encoded.rows(), iCols = encoded.columns();
+      int aKinds[2][3];
+      if (iRows < 2 || iCols < 2 || !rowLayout(format, row, interpolation, aKinds))
+        return false;
+
+      T* aTargets[3] = { red, green, blue };
+      if (row == 0 || row == iRows-1)
+        {
+          for (int c=0; c<iCols; ++c)
+            for (int i=0; i<3; ++i)
+              aTargets[i][c] = T(borderValue(encoded, row, c, aKinds[c & 1][i]));
+          return true;
+        }
+
+      for (int i=0; i<3; ++i)
+        {
+          aTargets[i][0] = T(borderValue(encoded, row, 0, aKinds[0][i]));
+          aTargets[i][iCols-1] = T(borderValue(encoded, row, iCols-1, aKinds[(iCols-1) & 1][i]));
+        }
+
+      const T* pRow0 = encoded[row-1], *pRow1 = encoded[row], *pRow2 = encoded[row+1];
+      const int iEnd = iCols-1;
+      int c = 1;
+#if defined(PII_BAYER_SSE2)
+      if (isVectorized())
+        c = interiorBlocks<typename Sse2::OpsFor<T>::Type>(pRow0, pRow1, pRow2, iEnd, aKinds,
+                                                             interpolation == EdgeAwareBayerInterpolation,
+                                                             aTargets);
+#elif defined(PII_BAYER_NEON)
+      if (isVectorized())
+        c = interiorBlocks<typename Neon::OpsFor<T>::Type>(pRow0, pRow1, pRow2, iEnd, aKinds,
+                                                             interpolation == EdgeAwareBayerInterpolation,
+                                                             aTargets);
+#endif
+      for (; c<iEnd; ++c)
+        for (int i=0; i<3; ++i)
+          aTargets[i][c] = T(interiorValue(pRow0, pRow1, pRow2, c, aKinds[c & 1][i]));
+      return true;
+    }
+  }
+
+  bool demosaicRow(const PiiMatrix<unsigned char>& encoded, int row,
+                   ImageFormat format, BayerInterpolation interpolation,
+                   unsigned char* red, unsigned char* green, unsigned char* blue)
+  {
+    return demosaicRowImpl(encoded, row, format, interpolation, red, green, blue);
+  }
+
+  bool demosaicRow(const PiiMatrix<unsigned short>& encoded, int row,
+                   ImageFormat format, BayerInterpolation interpolation,
+                   unsigned short* red, unsigned short* green, unsigned short* blue)
+  {
+    return demosaicRowImpl(encoded, row, format, interpolation, red, green, blue);
+  }
+
+  bool bayerCellLayout(ImageFormat format, int* redIndex, int* blueIndex)
+  {
+    switch (format)
+      {
+      case BayerRGGBFormat: *redIndex = 0; *blueIndex = 3; return true;
+      case BayerBGGRFormat: *redIndex = 3; *blueIndex = 0; return true;
+      case BayerGRBGFormat: *redIndex = 1; *blueIndex = 2; return true;
+      case BayerGBRGFormat: *redIndex = 2; *blueIndex = 1; return true;
+      default: return false;
+      }
+  }
 }
@@ -19,6 +19,7 @@
 #include <PiiMatrix.h>
 #include <PiiColor.h>
 #include <PiiCameraGlobal.h>
+#include "PiiCamera.h"
 
 namespace PiiCamera
 {
@@ -591,6 +592,7 @@ namespace PiiCamera
                              decoder.interpolatorG00.bottomLeft(row0, row1),
                              decoder.interpolatorB00.bottomLeft(row0, row1));
 
+        ++row0; ++row1;
         // Bottom Row
         for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1)
           {
@@ -616,6 +618,243 @@ namespace PiiCamera
       }
   }
 
+  /**
+   * Interpolation methods for [demosaic()] and related functions.
+   *
+   * - `BilinearBayerInterpolation` - each missing color channel is
+   * the average of the nearest samples of that channel. The result is
+   * identical to that of [bayerToRgb()] with the prebuilt decoders
+   * and RgbPixel.
+   *
+   * - `EdgeAwareBayerInterpolation` - same as bilinear, but green at
+   * red and blue sites is averaged along the direction (horizontal or
+   * vertical) with the smaller gradient. This reduces zipper
+   * artifacts at sharp edges at a small extra cost. Pixels at image
+   * borders are always interpolated bilinearly.
+   */
+  enum BayerInterpolation { BilinearBayerInterpolation, EdgeAwareBayerInterpolation };
+
+  /**
+   * The color type [demosaic()] produces out of raw data of type
+   * `T`. 8-bit data is decoded to PiiColor4<unsigned char> and 16-bit
+   * data to PiiColor<unsigned short>.
+   */
+  template <class T> struct BayerColor;
+  template <> struct BayerColor<unsigned char> { typedef PiiColor4<unsigned char> Type; };
+  template <> struct BayerColor<unsigned short> { typedef PiiColor<unsigned short> Type; };
+
+  /**
+   * Returns `true` if *format* is one of the four Bayer formats.
+   */
+  inline bool isBayerFormat(ImageFormat format)
+  {
+    return format >= BayerRGGBFormat && format <= BayerGRBGFormat;
+  }
+
+  /**
+   * Decodes row *row* of a Bayer-encoded image into three color
+   * channels. Each of *red*, *green*, and *blue* must have room for
+   * `encoded.columns()` values. The interior of the row is processed
+   * with SSE2 or NEON instructions if the CPU supports them. Returns
+   * `false` if *format* is not a Bayer format or *encoded* is smaller
+   * than 2-by-2.
+   *
+   * @internal
+   */
+  PII_CAMERA_EXPORT bool demosaicRow(const PiiMatrix<unsigned char>& encoded, int row,
+                                     ImageFormat format, BayerInterpolation interpolation,
+                                     unsigned char* red, unsigned char* green, unsigned char* blue);
+  /// @internal
+  PII_CAMERA_EXPORT bool demosaicRow(const PiiMatrix<unsigned short>& encoded, int row,
+                                     ImageFormat format, BayerInterpolation interpolation,
+                                     unsigned short* red, unsigned short* green, unsigned short* blue);
+
+  /**
+   * Returns the positions (`row*2 + column`) of the red and blue
+   * samples in a 2-by-2 cell of a Bayer *format*. The two green
+   * samples take up the other two positions. Returns `false` if
+   * *format* is not a Bayer format.
+   *
+   * @internal
+   */
+  PII_CAMERA_EXPORT bool bayerCellLayout(ImageFormat format, int* redIndex, int* blueIndex);
+
+  /**
+   * Converts 8 or 16-bit Bayer-encoded raw data to RGB colors. This
+   * function works like [bayerToRgb()], but the pattern is selected
+   * at run time, and the interpolation is vectorized. Each raw pixel
+   * is read just once from memory: three rows of input are needed
+   * to produce a row of output.
+   *
+   * @param encoded raw image data, at least 2-by-2 pixels
+   *
+   * @param format one of the Bayer formats
+   *
+   * @param interpolation the interpolation method
+   *
+   * @return the decoded color image, or an empty matrix if *format*
+   * is not a Bayer format or *encoded* is too small.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned short> matRaw = ...;
+   * PiiMatrix<PiiColor<unsigned short> > matColor =
+   *   PiiCamera::demosaic(matRaw, PiiCamera::BayerGRBGFormat,
+   *                       PiiCamera::EdgeAwareBayerInterpolation);
+   * ~~~
+   */
+  template <class T>
+  PiiMatrix<typename BayerColor<T>::Type> demosaic(const PiiMatrix<T>& encoded,
+                                                   ImageFormat format,
+                                                   BayerInterpolation interpolation = BilinearBayerInterpolation);
+
+  /**
+   * This version stores the decoded colors into *result*, which may
+   * be of any color type that can be constructed out of three
+   * channel values. *result* will be reallocated if its size doesn't
+   * match that of *encoded*. Returns `false` if the image cannot be
+   * decoded.
+   */
+  template <class T, class Color>
+  bool demosaic(const PiiMatrix<T>& encoded,
+                PiiMatrix<Color>& result,
+                ImageFormat format,
+                BayerInterpolation interpolation = BilinearBayerInterpolation);
+
+  /**
+   * Converts Bayer-encoded raw data directly to gray levels. The gray
+   * level is the average of the interpolated red, green and blue
+   * channels (see GrayPixel), but no color image is created in
+   * between. Returns an empty matrix if the image cannot be decoded.
+   */
+  template <class T>
+  PiiMatrix<T> demosaicToGray(const PiiMatrix<T>& encoded,
+                              ImageFormat format,
+                              BayerInterpolation interpolation = BilinearBayerInterpolation);
+
+  /**
+   * Converts Bayer-encoded raw data to separate red, green and blue
+   * channel images. The channels are interpolated directly into
+   * *red*, *green* and *blue*, which will be reallocated to the size
+   * of *encoded*. Returns `false` if the image cannot be decoded.
+   */
+  template <class T>
+  bool demosaicToChannels(const PiiMatrix<T>& encoded,
+                          PiiMatrix<T>& red, PiiMatrix<T>& green, PiiMatrix<T>& blue,
+                          ImageFormat format,
+                          BayerInterpolation interpolation = BilinearBayerInterpolation);
+
+  /**
+   * Converts Bayer-encoded raw data to a color image of half the
+   * width and height. Each 2-by-2 cell of the pattern becomes one
+   * pixel whose red and blue channels are taken as such and whose
+   * green channel is the average of the two green samples. No
+   * interpolation is needed, which makes this the fastest way of
+   * obtaining a color image if full resolution is not needed. An odd
+   * last row or column will be ignored. Returns an empty matrix if
+   * *format* is not a Bayer format.
+   */
+  template <class T>
+  PiiMatrix<typename BayerColor<T>::Type> demosaicHalfSize(const PiiMatrix<T>& encoded,
+                                                           ImageFormat format);
+
+  template <class T>
+  PiiMatrix<typename BayerColor<T>::Type> demosaic(const PiiMatrix<T>& encoded,
+                                                   ImageFormat format,
+                                                   BayerInterpolation interpolation)
+  {
+    PiiMatrix<typename BayerColor<T>::Type> matResult;
+    demosaic(encoded, matResult, format, interpolation);
+    return matResult;
+  }
+
+  template <class T, class Color>
+  bool demosaic(const PiiMatrix<T>& encoded,
+                PiiMatrix<Color>& result,
+                ImageFormat format,
+                BayerInterpolation interpolation)
+  {
+    const int iRows = encoded.rows(), iCols = encoded.columns();
+    if (!isBayerFormat(format) || iRows < 2 || iCols < 2)
+      return false;
+    if (result.rows() != iRows || result.columns() != iCols)
+      result = PiiMatrix<Color>(PiiMatrix<Color>::uninitialized(iRows, iCols));
+
+    PiiMatrix<T> matChannels(PiiMatrix<T>::uninitialized(3, iCols));
+    T* pRed = matChannels[0], *pGreen = matChannels[1], *pBlue = matChannels[2];
+    for (int r=0; r<iRows; ++r)
+      {
+        demosaicRow(encoded, r, format, interpolation, pRed, pGreen, pBlue);
+        Color* pResultRow = result[r];
+        for (int c=0; c<iCols; ++c)
+          pResultRow[c] = Color(pRed[c], pGreen[c], pBlue[c]);
+      }
+    return true;
+  }
+
+  template <class T>
+  PiiMatrix<T> demosaicToGray(const PiiMatrix<T>& encoded,
+                              ImageFormat format,
+                              BayerInterpolation interpolation)
+  {
+    const int iRows = encoded.rows(), iCols = encoded.columns();
+    if (!isBayerFormat(format) || iRows < 2 || iCols < 2)
+      return PiiMatrix<T>();
+
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iRows, iCols));
+    PiiMatrix<T> matChannels(PiiMatrix<T>::uninitialized(3, iCols));
+    T* pRed = matChannels[0], *pGreen = matChannels[1], *pBlue = matChannels[2];
+    for (int r=0; r<iRows; ++r)
+      {
+        demosaicRow(encoded, r, format, interpolation, pRed, pGreen, pBlue);
+        T* pResultRow = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          pResultRow[c] = T((int(pRed[c]) + int(pGreen[c]) + int(pBlue[c])) / 3);
+      }
+    return matResult;
+  }
+
+  template <class T>
+  bool demosaicToChannels(const PiiMatrix<T>& encoded,
+                          PiiMatrix<T>& red, PiiMatrix<T>& green, PiiMatrix<T>& blue,
+                          ImageFormat format,
+                          BayerInterpolation interpolation)
+  {
+    const int iRows = encoded.rows(), iCols = encoded.columns();
+    if (!isBayerFormat(format) || iRows < 2 || iCols < 2)
+      return false;
+
+    red = PiiMatrix<T>(PiiMatrix<T>::uninitialized(iRows, iCols));
+    green = PiiMatrix<T>(PiiMatrix<T>::uninitialized(iRows, iCols));
+    blue = PiiMatrix<T>(PiiMatrix<T>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      demosaicRow(encoded, r, format, interpolation, red[r], green[r], blue[r]);
+    return true;
+  }
+
+  template <class T>
+  PiiMatrix<typename BayerColor<T>::Type> demosaicHalfSize(const PiiMatrix<T>& encoded,
+                                                           ImageFormat format)
+  {
+    typedef typename BayerColor<T>::Type Color;
+    int iRed, iBlue;
+    if (!bayerCellLayout(format, &iRed, &iBlue))
+      return PiiMatrix<Color>();
+    // Greens are on the other diagonal.
+    const int iGreen1 = iRed == 0 || iRed == 3 ? 1 : 0, iGreen2 = 3 - iGreen1;
+
+    const int iRows = encoded.rows()/2, iCols = encoded.columns()/2;
+    PiiMatrix<Color> matResult(PiiMatrix<Color>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* aCell[4] = { encoded[r*2], encoded[r*2] + 1, encoded[r*2+1], encoded[r*2+1] + 1 };
+        const T* pRed = aCell[iRed], *pBlue = aCell[iBlue], *pGreen1 = aCell[iGreen1], *pGreen2 = aCell[iGreen2];
+        Color* pResultRow = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          pResultRow[c] = Color(pRed[c*2], (int(pGreen1[c*2]) + int(pGreen2[c*2])) >> 1, pBlue[c*2]);
+      }
+    return matResult;
+  }
+
   /**
    * A convenience function that decodes an RGGB-encoded 8-bit image
    * into a 32-bit RGB color image.
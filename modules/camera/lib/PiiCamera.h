@@ -46,6 +46,10 @@ namespace PiiCamera
    * - `RgbFormat` - the image is in RGB format
    *
    * - `BgrFormat` - the image is in BGR format.
+   *
+   * - `MjpegFormat` - each frame is a separately compressed JPEG
+   * image. The size of the compressed data varies from frame to
+   * frame.
    */
   enum ImageFormat
     {
@@ -58,7 +62,8 @@ namespace PiiCamera
       Yuv411Format,
       Yuv422Format,
       RgbFormat = 16,
-      BgrFormat
+      BgrFormat,
+      MjpegFormat = 32
     };
 
   /**
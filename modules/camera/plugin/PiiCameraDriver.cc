@@ -38,6 +38,31 @@ bool PiiCameraDriver::requiresInitialization(const char* /*name*/) const
   return false;
 }
 
+PiiBufferLease* PiiCameraDriver::leaseFrame(uint /*frameIndex*/)
+{
+  return 0;
+}
+
+int PiiCameraDriver::frameDataSize(uint /*frameIndex*/) const
+{
+  return -1;
+}
+
+int PiiCameraDriver::frameBufferHandle(uint /*frameIndex*/) const
+{
+  return -1;
+}
+
+PiiCameraDriver::BufferStatistics PiiCameraDriver::bufferStatistics() const
+{
+  return BufferStatistics();
+}
+
+bool PiiCameraDriver::resizeFrameBuffers(int /*bufferCount*/)
+{
+  return false;
+}
+
 int PiiCameraDriver::cameraType() const
 {
   return (int)PiiCamera::AreaScan;
@@ -81,6 +106,77 @@ bool PiiCameraDriver::setProperty(const char* name, const QVariant& value)
 
 
 
+class PiiCameraDriver::LeaseCounter::Lease : public PiiBufferLease
+{
+public:
+  Lease(LeaseCounter* counter) : _pCounter(counter) {}
+
+protected:
+  void returnBuffer() { _pCounter->leaseReturned(_timer.microseconds()); }
+
+private:
+  LeaseCounter* _pCounter;
+  PiiTimer _timer;
+};
+
+PiiCameraDriver::LeaseCounter::LeaseCounter() :
+  _iOutstandingLeases(0),
+  _iReturnedLeases(0),
+  _iTotalLeaseTime(0),
+  _iMaxLeaseTime(0)
+{}
+
+PiiCameraDriver::LeaseCounter::~LeaseCounter()
+{
+  waitForLeases();
+}
+
+PiiBufferLease* PiiCameraDriver::LeaseCounter::createLease()
+{
+  QMutexLocker lock(&_mutex);
+  ++_iOutstandingLeases;
+  return new Lease(this);
+}
+
+void PiiCameraDriver::LeaseCounter::leaseReturned(qint64 leaseTime)
+{
+  QMutexLocker lock(&_mutex);
+  ++_iReturnedLeases;
+  _iTotalLeaseTime += leaseTime;
+  _iMaxLeaseTime = qMax(_iMaxLeaseTime, leaseTime);
+  if (--_iOutstandingLeases == 0)
+    _allReturned.wakeAll();
+}
+
+bool PiiCameraDriver::LeaseCounter::waitForLeases(unsigned long time)
+{
+  QMutexLocker lock(&_mutex);
+  while (_iOutstandingLeases > 0)
+    if (!_allReturned.wait(&_mutex, time))
+      break;
+  return _iOutstandingLeases == 0;
+}
+
+int PiiCameraDriver::LeaseCounter::outstandingLeases() const
+{
+  QMutexLocker lock(&_mutex);
+  return _iOutstandingLeases;
+}
+
+void PiiCameraDriver::LeaseCounter::fillStatistics(BufferStatistics& statistics) const
+{
+  QMutexLocker lock(&_mutex);
+  statistics.leasedBuffers = _iOutstandingLeases;
+  statistics.averageReleaseTime = _iReturnedLeases > 0 ? _iTotalLeaseTime / _iReturnedLeases : 0;
+  statistics.maxReleaseTime = _iMaxLeaseTime;
+}
+
+void PiiCameraDriver::LeaseCounter::resetStatistics()
+{
+  QMutexLocker lock(&_mutex);
+  _iReturnedLeases = _iTotalLeaseTime = _iMaxLeaseTime = 0;
+}
+
 void PiiCameraDriver::setListener(Listener* listener) { d->pListener = listener; }
 PiiCameraDriver::Listener* PiiCameraDriver::listener() const { return d->pListener; }
 
@@ -18,8 +18,12 @@
 
 #include <QObject>
 #include <QSize>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <PiiConfigurable.h>
+#include <PiiBufferLease.h>
+#include <PiiTimer.h>
 
 #include "PiiCameraDriverException.h"
 #include "PiiCamera.h"
@@ -89,6 +93,20 @@
  * taken to ensure proper mutual exclusion. To directly access the
  * frame buffer memory, use the [frameBuffer()] function.
  *
+ * Drivers that recycle a fixed set of buffers can also lend them out
+ * with [leaseFrame()]. A leased buffer is given back to the
+ * acquisition queue only after the last [PiiMatrix] referencing it
+ * has been destroyed. This makes direct access safe without copying
+ * the frame. The [LeaseCounter] class helps in implementing this.
+ *
+ * Sizing the frame buffer
+ * -----------------------
+ *
+ * If processing cannot keep up with capture for a while, frames
+ * pile up in the frame buffer. Once all buffers are in use, frames
+ * will be missed. [bufferStatistics()] tells how close the driver
+ * has come to running out of buffers. The buffer can be enlarged
+ * on the fly with [resizeFrameBuffers()].
  */
 class PII_CAMERA_EXPORT PiiCameraDriver : public QObject, public PiiConfigurable
 {
@@ -107,6 +125,37 @@ class PII_CAMERA_EXPORT PiiCameraDriver : public QObject, public PiiConfigurable
 public:
   class Listener;
 
+  /**
+   * Statistics on the use of frame buffers. Times are in
+   * microseconds. The counts are reset when capture is started.
+   */
+  struct BufferStatistics
+  {
+    BufferStatistics() :
+      bufferCount(0), queuedBuffers(0), minQueuedBuffers(0), leasedBuffers(0),
+      capturedFrames(0), missedFrames(0), averageReleaseTime(0), maxReleaseTime(0)
+    {}
+
+    /// The number of frame buffers. Zero means no statistics are available.
+    int bufferCount;
+    /// The number of buffers currently waiting to be filled by the device.
+    int queuedBuffers;
+    /// The smallest value of [queuedBuffers] seen so far. Zero means
+    /// the device has run out of buffers at least once.
+    int minQueuedBuffers;
+    /// The number of frames currently leased out with [leaseFrame()].
+    int leasedBuffers;
+    /// The number of frames captured.
+    qint64 capturedFrames;
+    /// The number of frames known to be missed. Drivers that cannot
+    /// detect lost frames leave this at zero.
+    qint64 missedFrames;
+    /// The average time from leasing a frame to its release.
+    qint64 averageReleaseTime;
+    /// The longest time from leasing a frame to its release.
+    qint64 maxReleaseTime;
+  };
+
   PiiCameraDriver();
   ~PiiCameraDriver();
 
@@ -245,6 +294,65 @@ public:
    */
   virtual void* frameBuffer(uint frameIndex = 0) const = 0;
 
+  /**
+   * Returns a lease on the buffer of the frame at *frameIndex*. The
+   * driver promises not to reuse the buffer returned by
+   * [frameBuffer()] until the lease has been released. The caller
+   * receives one reference and must eventually call
+   * PiiBufferLease::release(). Typically, the lease is passed to a
+   * [PiiMatrix] constructor, and the reference is released
+   * immediately thereafter.
+   *
+   * This function may only be called from within
+   * [Listener::frameCaptured()]. Holding leased frames for a long
+   * time stalls the capture because the driver runs out of buffers.
+   *
+   * The default implementation returns zero, which means that the
+   * driver does not support leasing.
+   */
+  virtual PiiBufferLease* leaseFrame(uint frameIndex);
+
+  /**
+   * Returns the number of bytes of valid data in the frame buffer
+   * at *frameIndex*. With compressed [image formats](imageFormat())
+   * the size of a frame cannot be deduced from [frameSize()] and
+   * [bitsPerPixel()]. The default implementation returns -1, which
+   * means the size is not known.
+   */
+  virtual int frameDataSize(uint frameIndex) const;
+
+  /**
+   * Returns an operating system handle to the frame buffer at
+   * *frameIndex*, or -1 if the driver cannot export its buffers. On
+   * Linux, the handle is a DMABUF file descriptor that can be
+   * imported into other devices, such as a GPU or a hardware
+   * decoder, without copying the frame. The handle is owned by the
+   * driver and remains valid until the frame buffers are
+   * reallocated. The default implementation returns -1.
+   */
+  virtual int frameBufferHandle(uint frameIndex) const;
+
+  /**
+   * Returns statistics on the use of frame buffers. This function
+   * can be called from any thread at any time. The default
+   * implementation returns an empty structure, which means that the
+   * driver does not collect statistics.
+   */
+  virtual BufferStatistics bufferStatistics() const;
+
+  /**
+   * Changes the number of frame buffers to *bufferCount*. Unlike
+   * setting a frame buffer count property, this function takes
+   * effect immediately, without initializing the driver again. If
+   * frames are being captured, capture is paused until the buffers
+   * have been reallocated. Frames captured during the pause will be
+   * missed. The driver may round *bufferCount* to a suitable value.
+   *
+   * Returns `true` on success and `false` if the buffers could not
+   * be reallocated. The default implementation returns `false`.
+   */
+  virtual bool resizeFrameBuffers(int bufferCount);
+
   /**
    * Sets the listener that handles received image frames.
    */
@@ -271,6 +379,61 @@ public:
   QVariant property(const char* name) const;
   bool setProperty(const char* name, const QVariant& value);
 
+protected:
+  /**
+   * Keeps track of frame leases handed out by a driver. The driver
+   * calls [createLease()] in its implementation of [leaseFrame()] and
+   * [waitForLeases()] before it gives the buffers back to the
+   * acquisition queue.
+   */
+  class PII_CAMERA_EXPORT LeaseCounter
+  {
+  public:
+    LeaseCounter();
+    ~LeaseCounter();
+
+    /**
+     * Creates a new lease with a reference count of one. The lease
+     * is outstanding until its last reference has been released.
+     */
+    PiiBufferLease* createLease();
+
+    /**
+     * Blocks until all outstanding leases have been released or
+     * *time* milliseconds have passed. Returns `true` if there are
+     * no outstanding leases.
+     */
+    bool waitForLeases(unsigned long time = ULONG_MAX);
+
+    /**
+     * Returns the number of outstanding leases.
+     */
+    int outstandingLeases() const;
+
+    /**
+     * Stores the number of outstanding leases and the release times
+     * into *statistics*.
+     */
+    void fillStatistics(BufferStatistics& statistics) const;
+
+    /**
+     * Resets release time statistics.
+     */
+    void resetStatistics();
+
+  private:
+    class Lease;
+    friend class Lease;
+    void leaseReturned(qint64 leaseTime);
+
+    mutable QMutex _mutex;
+    QWaitCondition _allReturned;
+    int _iOutstandingLeases;
+    qint64 _iReturnedLeases, _iTotalLeaseTime, _iMaxLeaseTime;
+
+    PII_DISABLE_COPY(LeaseCounter);
+  };
+
 private:
   class Data
   {
@@ -23,6 +23,7 @@
 #include <QSettings>
 
 #include <PiiLog.h>
+#include <PiiTimer.h>
 #include <QFile>
 
 PiiCameraOperation::Data::Data() :
@@ -33,6 +34,7 @@ PiiCameraOperation::Data::Data() :
   iImageHeight(0),
   iBitsPerPixel(8),
   bCopyImage(false),
+  bEdgeAwareDemosaicing(false),
   iFrameCount(-1),
   bWaitPause(false),
   bMissedFrames(false),
@@ -168,6 +170,9 @@ void PiiCameraOperation::stop()
 void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime)
 {
   PII_D;
+  // Drivers report no capture time stamp. The notification is the
+  // earliest moment the frame is known to exist.
+  PiiYdin::setCurrentOriginTime(PiiTimer::timestamp());
 
   QMutexLocker lock(&d->pauseMutex);
   if (d->bWaitPause)
@@ -195,25 +200,52 @@ void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint6
         ; //piiWarning("PiiCameraOperation::frameCaptured(), pFrameBuffer == 0");
       else
         {
-          switch (d->iBitsPerPixel)
+          // If the driver can lend out the buffer, the frame can be
+          // passed on without copying.
+          PiiBufferLease* pLease = ownership == Pii::RetainOwnership ?
+            d->pCameraDriver->leaseFrame(frameIndex) : 0;
+
+          if (d->imageFormat == PiiCamera::MjpegFormat)
+            {
+              // Compressed frames are emitted as such and decoded
+              // downstream.
+              int iDataSize = d->pCameraDriver->frameDataSize(frameIndex);
+              if (iDataSize > 0)
+                {
+                  PiiMatrix<unsigned char> frame(pLease != 0 ?
+                                                 PiiMatrix<unsigned char>(1, iDataSize, pFrameBuffer, pLease) :
+                                                 PiiMatrix<unsigned char>(1, iDataSize, pFrameBuffer, ownership));
+                  emitImage(frame, ownership, pLease, frameIndex, elapsedTime);
+                }
+              else if (ownership == Pii::ReleaseOwnership)
+                free(pFrameBuffer);
+            }
+          else
             {
-            case 8:
-              convert<unsigned char>(pFrameBuffer, ownership, frameIndex, elapsedTime);
-              break;
-            case 16:
-              convert<unsigned short>(pFrameBuffer, ownership, frameIndex, elapsedTime);
-              break;
-            case 24:
-              emitImage(PiiMatrix<PiiColor<unsigned char> >(d->iImageHeight, d->iImageWidth, pFrameBuffer, ownership),
-                        ownership, frameIndex, elapsedTime);
-              break;
-              /*case 32:
-                convertColor<PiiColor4<unsigned char> >(pFrameBuffer,
-                ownership, frameIndex);
-                break;
-              */
+              switch (d->iBitsPerPixel)
+                {
+                case 8:
+                  convert<unsigned char>(pFrameBuffer, ownership, pLease, frameIndex, elapsedTime);
+                  break;
+                case 16:
+                  convert<unsigned short>(pFrameBuffer, ownership, pLease, frameIndex, elapsedTime);
+                  break;
+                case 24:
+                  emitImage(frameMatrix<PiiColor<unsigned char> >(pFrameBuffer, ownership, pLease),
+                            ownership, pLease, frameIndex, elapsedTime);
+                  break;
+                  /*case 32:
+                    convertColor<PiiColor4<unsigned char> >(pFrameBuffer,
+                    ownership, frameIndex);
+                    break;
+                  */
+                }
             }
 
+          // Emitted images hold their own references.
+          if (pLease != 0)
+            pLease->release();
+
           // If we are triggered-mode we must wake one now
           if (d->bTriggered)
             d->waitCondition.wakeOne();
@@ -223,8 +255,19 @@ void PiiCameraOperation::frameCaptured(uint frameIndex, void *frameBuffer, qint6
     d->waitCondition.wakeOne();
 }
 
+template <class T> PiiMatrix<T> PiiCameraOperation::frameMatrix(void *frameBuffer,
+                                                                Pii::PtrOwnership ownership,
+                                                                PiiBufferLease* lease)
+{
+  PII_D;
+  if (lease != 0)
+    return PiiMatrix<T>(d->iImageHeight, d->iImageWidth, frameBuffer, lease);
+  return PiiMatrix<T>(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
+}
+
 template <class T> void PiiCameraOperation::convert(void *frameBuffer,
                                                     Pii::PtrOwnership ownership,
+                                                    PiiBufferLease* lease,
                                                     int frameIndex,
                                                     qint64 elapsedTime)
 {
@@ -232,8 +275,7 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
 
   if (d->imageType == Original && d->imageFormat member_of (PiiCamera::MonoFormat, PiiCamera::RgbFormat))
     {
-      PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
-      emitImage(image, ownership, frameIndex, elapsedTime);
+      emitImage(frameMatrix<T>(frameBuffer, ownership, lease), ownership, lease, frameIndex, elapsedTime);
     }
   else
     {
@@ -243,7 +285,7 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
           {
             emitImage(PiiColors::yuv411toRgb<PiiColor<T> >(reinterpret_cast<T*>(frameBuffer),
                                                            d->iImageWidth, d->iImageHeight),
-                      Pii::ReleaseOwnership, frameIndex, elapsedTime);
+                      Pii::ReleaseOwnership, 0, frameIndex, elapsedTime);
 
             // Free frameBuffer-memory if necessary
             if (ownership == Pii::ReleaseOwnership)
@@ -255,7 +297,7 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
           {
             emitImage(PiiColors::yuv422toRgb<PiiColor<T> >(reinterpret_cast<T*>(frameBuffer),
                                                            d->iImageWidth, d->iImageHeight),
-                      Pii::ReleaseOwnership, frameIndex, elapsedTime);
+                      Pii::ReleaseOwnership, 0, frameIndex, elapsedTime);
 
             // Free frameBuffer-memory if necessary
             if (ownership == Pii::ReleaseOwnership)
@@ -263,27 +305,38 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
 
             break;
           }
+        case PiiCamera::BayerRGGBFormat:
         case PiiCamera::BayerBGGRFormat:
+        case PiiCamera::BayerGBRGFormat:
+        case PiiCamera::BayerGRBGFormat:
           {
-            PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
-            emitImage(bayerToRgb(image, PiiCamera::BggrDecoder<T>(), PiiCamera::Rgb4Pixel<>()),
-                      Pii::ReleaseOwnership, frameIndex, elapsedTime);
+            PiiMatrix<T> image(frameMatrix<T>(frameBuffer, ownership, lease));
+            PiiCamera::BayerInterpolation interpolation = d->bEdgeAwareDemosaicing ?
+              PiiCamera::EdgeAwareBayerInterpolation :
+              PiiCamera::BilinearBayerInterpolation;
+            if (d->imageType == GrayScale)
+              emitImage(PiiCamera::demosaicToGray(image, d->imageFormat, interpolation),
+                        Pii::ReleaseOwnership, 0, frameIndex, elapsedTime);
+            else
+              emitImage(PiiCamera::demosaic(image, d->imageFormat, interpolation),
+                        Pii::ReleaseOwnership, 0, frameIndex, elapsedTime);
             break;
           }
         default:
           {
-            PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
-            emitImage(image, ownership, frameIndex, elapsedTime);
+            emitImage(frameMatrix<T>(frameBuffer, ownership, lease), ownership, lease, frameIndex, elapsedTime);
           }
         }
     }
 }
 
-template <class T> void PiiCameraOperation::emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime)
+template <class T> void PiiCameraOperation::emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership,
+                                                      PiiBufferLease* lease, int frameIndex, qint64 elapsedTime)
 {
   PII_D;
 
-  if (d->bCopyImage && ownership == Pii::RetainOwnership)
+  // A leased buffer will not be overwritten while the image is alive.
+  if (d->bCopyImage && ownership == Pii::RetainOwnership && lease == 0)
     {
       PiiMatrix<T> img(image);
       img.detach();
@@ -373,6 +426,17 @@ bool PiiCameraOperation::saveCameraConfig(const QString& fileName)
   return true;
 }
 
+bool PiiCameraOperation::resizeFrameBuffers(int bufferCount)
+{
+  PII_D;
+  if (d->pCameraDriver == 0)
+    {
+      piiWarning(tr("Camera driver has not been set."));
+      return false;
+    }
+  return d->pCameraDriver->resizeFrameBuffers(bufferCount);
+}
+
 void PiiCameraOperation::setDriverName(const QString& driverName)
 {
   PII_D;
@@ -459,3 +523,35 @@ bool PiiCameraOperation::copyImage() const
 {
   return _d()->bCopyImage;
 }
+
+void PiiCameraOperation::setEdgeAwareDemosaicing(bool edgeAware)
+{
+  _d()->bEdgeAwareDemosaicing = edgeAware;
+}
+
+bool PiiCameraOperation::edgeAwareDemosaicing() const
+{
+  return _d()->bEdgeAwareDemosaicing;
+}
+
+QVariantMap PiiCameraOperation::bufferStatistics() const
+{
+  QVariantMap mapStatistics;
+  const PII_D;
+  if (d->pCameraDriver == 0)
+    return mapStatistics;
+
+  PiiCameraDriver::BufferStatistics statistics = d->pCameraDriver->bufferStatistics();
+  if (statistics.bufferCount == 0)
+    return mapStatistics;
+
+  mapStatistics["bufferCount"] = statistics.bufferCount;
+  mapStatistics["queuedBuffers"] = statistics.queuedBuffers;
+  mapStatistics["minQueuedBuffers"] = statistics.minQueuedBuffers;
+  mapStatistics["leasedBuffers"] = statistics.leasedBuffers;
+  mapStatistics["capturedFrames"] = statistics.capturedFrames;
+  mapStatistics["missedFrames"] = statistics.missedFrames;
+  mapStatistics["averageReleaseTime"] = statistics.averageReleaseTime;
+  mapStatistics["maxReleaseTime"] = statistics.maxReleaseTime;
+  return mapStatistics;
+}
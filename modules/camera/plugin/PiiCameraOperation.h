@@ -24,6 +24,12 @@
 /**
  * PiiCameraOperation description
  *
+ * If the [image format](PiiCameraDriver::imageFormat()) of the driver
+ * is `PiiCamera::MjpegFormat`, frames are not decoded. Each
+ * compressed frame is emitted as a 1-by-N `PiiMatrix<unsigned char>`
+ * that can be decoded with PiiImageDecoder. Since decoding is
+ * usually much slower than capturing, the decoder can be run in
+ * many threads.
  */
 class PII_CAMERA_EXPORT PiiCameraOperation : public PiiImageReaderOperation, public PiiCameraDriver::Listener
 {
@@ -58,9 +64,35 @@ class PII_CAMERA_EXPORT PiiCameraOperation : public PiiImageReaderOperation, pub
    * drivers that use a circular frame buffer, will silently overwrite
    * image data if the frame buffer is not big enough. The default
    * value is `false`.
+   *
+   * If the driver supports [frame leasing](PiiCameraDriver::leaseFrame()),
+   * frames are never copied. The driver will not reuse a buffer until
+   * all images referencing it have been destroyed, and this property
+   * has no effect.
    */
   Q_PROPERTY(bool copyImage READ copyImage WRITE setCopyImage);
 
+  /**
+   * If this property is `true`, the green channel of raw Bayer
+   * frames will be interpolated along the local edge direction
+   * instead of averaging all four neighbors. This reduces zipper
+   * artifacts at sharp edges but makes demosaicing somewhat slower.
+   * The default value is `false`.
+   */
+  Q_PROPERTY(bool edgeAwareDemosaicing READ edgeAwareDemosaicing WRITE setEdgeAwareDemosaicing);
+
+  /**
+   * Frame buffer statistics reported by the driver. The map
+   * contains the fields of PiiCameraDriver::BufferStatistics
+   * (`bufferCount`, `queuedBuffers`, `minQueuedBuffers`,
+   * `leasedBuffers`, `capturedFrames`, `missedFrames`,
+   * `averageReleaseTime` and `maxReleaseTime`). If `minQueuedBuffers`
+   * drops close to zero, the frame buffer is too small for the
+   * processing latency; see [resizeFrameBuffers()]. If the driver
+   * does not collect statistics, the map is empty.
+   */
+  Q_PROPERTY(QVariantMap bufferStatistics READ bufferStatistics STORED false);
+
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
@@ -110,6 +142,16 @@ public slots:
    */
   bool saveCameraConfig(const QString& file);
 
+  /**
+   * Changes the number of frame buffers in the driver to
+   * *bufferCount* without stopping the operation. Capture will be
+   * paused while the buffers are reallocated. Returns `true` on
+   * success, `false` otherwise.
+   *
+   * @see PiiCameraDriver::resizeFrameBuffers()
+   */
+  bool resizeFrameBuffers(int bufferCount);
+
 signals:
   void framesPerSecond(double frames);
 
@@ -128,6 +170,11 @@ protected:
   void setCopyImage(bool copy);
   bool copyImage() const;
 
+  void setEdgeAwareDemosaicing(bool edgeAware);
+  bool edgeAwareDemosaicing() const;
+
+  QVariantMap bufferStatistics() const;
+
   /**
    * Processes an image before delivery. The default implementation
    * returns *image*. Subclasses may add custom functionality by
@@ -138,8 +185,11 @@ protected:
   void timerEvent(QTimerEvent*);
 
 private:
-  template <class T> void convert(void *frameBuffer, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
-  template <class T> void emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership, int frameIndex, qint64 elapsedTime);
+  template <class T> PiiMatrix<T> frameMatrix(void *frameBuffer, Pii::PtrOwnership ownership, PiiBufferLease* lease);
+  template <class T> void convert(void *frameBuffer, Pii::PtrOwnership ownership, PiiBufferLease* lease,
+                                  int frameIndex, qint64 elapsedTime);
+  template <class T> void emitImage(const PiiMatrix<T>& image, Pii::PtrOwnership ownership, PiiBufferLease* lease,
+                                    int frameIndex, qint64 elapsedTime);
 
   void init();
 protected:
@@ -157,6 +207,7 @@ protected:
     PiiCamera::ImageFormat imageFormat;
     int iBitsPerPixel;
     bool bCopyImage;
+    bool bEdgeAwareDemosaicing;
     QAtomicInt iFrameCount;
     PiiTimer frameTimer;
     bool bWaitPause, bMissedFrames;
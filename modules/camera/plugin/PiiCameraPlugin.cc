@@ -17,11 +17,13 @@
 
 #include "PiiNetworkCameraOperation.h"
 #include "PiiCameraOperation.h"
+#include "PiiMultiCameraOperation.h"
 
 PII_IMPLEMENT_PLUGIN(PiiCameraPlugin);
 
 PII_REGISTER_OPERATION(PiiNetworkCameraOperation);
 PII_REGISTER_OPERATION(PiiCameraOperation);
+PII_REGISTER_OPERATION(PiiMultiCameraOperation);
 
 
 
@@ -0,0 +1,503 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMultiCameraOperation.h"
+#include <PiiYdinTypes.h>
+#include <PiiYdinResources.h>
+#include <PiiMatrixPool.h>
+#include <PiiColor.h>
+#include <PiiLog.h>
+#include <PiiTimer.h>
+#include <cstring>
+#include <cstdlib>
+
+namespace
+{
+  // Parses "driverX.property". Returns X and stores the property name
+  // to *property*, or returns -1 if the name has no driver prefix.
+  int driverIndex(const char* name, const char** property)
+  {
+    if (strncmp(name, "driver", 6) != 0)
+      return -1;
+    const char* pDigits = name + 6;
+    int iIndex = 0;
+    const char* p = pDigits;
+    for (; *p >= '0' && *p <= '9'; ++p)
+      iIndex = iIndex * 10 + (*p - '0');
+    if (p == pDigits || *p != '.')
+      return -1;
+    *property = p + 1;
+    return iIndex;
+  }
+}
+
+class PiiMultiCameraOperation::CameraListener : public PiiCameraDriver::Listener
+{
+public:
+  CameraListener(PiiMultiCameraOperation* operation, int camera) :
+    _pOperation(operation), _iCamera(camera)
+  {}
+
+  void frameCaptured(uint frameIndex, void *frameBuffer, qint64 elapsedTime)
+  {
+    _pOperation->frameCaptured(_iCamera, frameIndex, frameBuffer, elapsedTime);
+  }
+
+  void captureFinished(bool success)
+  {
+    _pOperation->captureFinished(_iCamera, success);
+  }
+
+  void captureError(const QString& message)
+  {
+    _pOperation->captureError(_iCamera, message);
+  }
+
+private:
+  PiiMultiCameraOperation* _pOperation;
+  int _iCamera;
+};
+
+PiiMultiCameraOperation::Camera::Camera() :
+  pDriver(0),
+  pListener(0),
+  iImageWidth(0),
+  iImageHeight(0),
+  iBitsPerPixel(8),
+  iClock(-1)
+{
+}
+
+PiiMultiCameraOperation::Data::Data() :
+  pTriggerInput(0),
+  pIndexOutput(0),
+  matchingMode(MatchFrameIndex),
+  iMaxTimeDifference(1000),
+  iMaxPendingFrames(4),
+  bPoolFrames(true),
+  bUsingPool(false),
+  bTriggered(false),
+  bCaptureFailed(false),
+  iGroupIndex(0),
+  iDroppedFrames(0)
+{
+}
+
+PiiMultiCameraOperation::PiiMultiCameraOperation() : PiiDefaultOperation(new Data)
+{
+  PII_D;
+  setThreadingCapabilities(NonThreaded);
+
+  d->pTriggerInput = new PiiInputSocket("trigger");
+  d->pTriggerInput->setOptional(true);
+  addSocket(d->pTriggerInput);
+
+  d->pIndexOutput = new PiiOutputSocket("index");
+  addSocket(d->pIndexOutput);
+}
+
+PiiMultiCameraOperation::~PiiMultiCameraOperation()
+{
+  deleteDrivers();
+  stopPool();
+}
+
+void PiiMultiCameraOperation::deleteDrivers()
+{
+  PII_D;
+  clearPendingFrames();
+  for (int i=0; i<d->lstCameras.size(); ++i)
+    {
+      d->lstCameras[i].pDriver->close();
+      delete d->lstCameras[i].pDriver;
+      delete d->lstCameras[i].pListener;
+    }
+  d->lstCameras.clear();
+}
+
+QVariant PiiMultiCameraOperation::property(const char* name) const
+{
+  const PII_D;
+  const char* pProperty = 0;
+  int iCamera = driverIndex(name, &pProperty);
+  if (iCamera < 0)
+    return PiiDefaultOperation::property(name);
+
+  if (iCamera < d->lstCameras.size())
+    return d->lstCameras[iCamera].pDriver->property(pProperty);
+  return QVariant();
+}
+
+bool PiiMultiCameraOperation::setProperty(const char* name, const QVariant& value)
+{
+  PII_D;
+  const char* pProperty = 0;
+  int iCamera = driverIndex(name, &pProperty);
+  if (iCamera < 0)
+    return PiiDefaultOperation::setProperty(name, value);
+
+  if (iCamera < d->lstCameras.size())
+    return d->lstCameras[iCamera].pDriver->setProperty(pProperty, value);
+  return false;
+}
+
+void PiiMultiCameraOperation::check(bool reset)
+{
+  PII_D;
+
+  if (d->lstCameras.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Camera drivers have not been set."));
+
+  if (reset)
+    {
+      // Software trigger is needed for all cameras if the trigger
+      // input is connected.
+      d->bTriggered = d->pTriggerInput->isConnected();
+
+      for (int i=0; i<d->lstCameras.size(); ++i)
+        {
+          Camera& camera = d->lstCameras[i];
+          if (d->bTriggered)
+            camera.pDriver->setProperty("triggerMode", PiiCameraDriver::SoftwareTrigger);
+
+          try
+            {
+              camera.pDriver->initialize(i < d->lstCameraIds.size() ? d->lstCameraIds[i] : QString());
+            }
+          catch (PiiException& ex)
+            {
+              PII_THROW(PiiExecutionException, tr("Couldn't initialize driver %1: %2").arg(i).arg(ex.message()));
+            }
+
+          QSize frameSize = camera.pDriver->frameSize();
+          camera.iImageWidth = frameSize.width();
+          camera.iImageHeight = frameSize.height();
+          camera.iBitsPerPixel = camera.pDriver->bitsPerPixel();
+          if (camera.iBitsPerPixel != 8 && camera.iBitsPerPixel != 16 && camera.iBitsPerPixel != 24)
+            PII_THROW(PiiExecutionException, tr("Camera %1 uses an unsupported pixel size (%2 bits).")
+                      .arg(i).arg(camera.iBitsPerPixel));
+        }
+
+      clearPendingFrames();
+      d->iGroupIndex = 0;
+      d->iDroppedFrames = 0;
+    }
+
+  PiiDefaultOperation::check(reset);
+}
+
+void PiiMultiCameraOperation::process()
+{
+  PII_D;
+  // Trigger all cameras at once and wait until their frames have
+  // been matched.
+  for (int i=0; i<d->lstCameras.size(); ++i)
+    d->lstCameras[i].pDriver->triggerImage();
+  d->groupWaitCondition.wait();
+}
+
+void PiiMultiCameraOperation::start()
+{
+  PII_D;
+
+  if (d->lstCameras.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Camera drivers have not been set."));
+
+  startPool();
+  synchronized (d->frameMutex)
+    {
+      // Frame indices and clocks restart with capture.
+      for (int i=0; i<d->lstCameras.size(); ++i)
+        d->lstCameras[i].iClock = -1;
+      d->bCaptureFailed = false;
+      d->captureTimer.restart();
+    }
+
+  for (int i=0; i<d->lstCameras.size(); ++i)
+    {
+      PiiCameraDriver* pDriver = d->lstCameras[i].pDriver;
+      if (!pDriver->isCapturing() && !pDriver->startCapture())
+        {
+          stopCapture();
+          PII_THROW(PiiExecutionException, tr("Couldn't start capture on camera %1.").arg(i));
+        }
+    }
+
+  PiiDefaultOperation::start();
+}
+
+void PiiMultiCameraOperation::interrupt()
+{
+  stopCapture();
+  PiiDefaultOperation::interrupt();
+  _d()->groupWaitCondition.wakeAll();
+  stopPool();
+}
+
+void PiiMultiCameraOperation::pause()
+{
+  // Frames captured during the pause could not be matched reliably.
+  stopCapture();
+  PiiDefaultOperation::pause();
+  _d()->groupWaitCondition.wakeAll();
+}
+
+void PiiMultiCameraOperation::stop()
+{
+  stopCapture();
+  PiiDefaultOperation::stop();
+  _d()->groupWaitCondition.wakeAll();
+  stopPool();
+}
+
+void PiiMultiCameraOperation::stopCapture()
+{
+  PII_D;
+  for (int i=0; i<d->lstCameras.size(); ++i)
+    d->lstCameras[i].pDriver->stopCapture();
+  // Return leased buffers to the drivers.
+  clearPendingFrames();
+}
+
+void PiiMultiCameraOperation::clearPendingFrames()
+{
+  PII_D;
+  QMutexLocker lock(&d->frameMutex);
+  for (int i=0; i<d->lstCameras.size(); ++i)
+    d->lstCameras[i].lstPending.clear();
+}
+
+void PiiMultiCameraOperation::startPool()
+{
+  PII_D;
+  if (d->bPoolFrames && !d->bUsingPool)
+    {
+      PiiMatrixPool::addUser();
+      d->bUsingPool = true;
+    }
+}
+
+void PiiMultiCameraOperation::stopPool()
+{
+  PII_D;
+  if (d->bUsingPool)
+    {
+      PiiMatrixPool::removeUser();
+      d->bUsingPool = false;
+    }
+}
+
+void PiiMultiCameraOperation::frameCaptured(int camera, uint frameIndex, void* frameBuffer, qint64 elapsedTime)
+{
+  PII_D;
+  qint64 iOriginTime = PiiTimer::timestamp();
+  QMutexLocker lock(&d->frameMutex);
+  Camera& cam = d->lstCameras[camera];
+
+  qint64 iKey = frameIndex;
+  if (d->matchingMode == MatchTimestamp)
+    {
+      // Prefer the time measured by the camera. The first frame has
+      // no predecessor, so its time comes from the host clock.
+      if (elapsedTime > 0 && cam.iClock >= 0)
+        cam.iClock += elapsedTime;
+      else
+        cam.iClock = d->captureTimer.microseconds();
+      iKey = cam.iClock;
+    }
+
+  PiiVariant image = createFrame(cam, frameIndex, frameBuffer);
+  if (!image.isValid())
+    return;
+
+  cam.lstPending << Frame(image, iKey, iOriginTime);
+  if (cam.lstPending.size() > d->iMaxPendingFrames)
+    {
+      cam.lstPending.removeFirst();
+      ++d->iDroppedFrames;
+    }
+
+  emitCompleteGroups();
+}
+
+void PiiMultiCameraOperation::emitCompleteGroups()
+{
+  PII_D;
+  const qint64 iTolerance = d->matchingMode == MatchTimestamp ? d->iMaxTimeDifference : 0;
+  forever
+    {
+      // Every camera must have at least one frame.
+      int iOldest = 0;
+      qint64 iMinKey = 0, iMaxKey = 0, iOriginTime = 0;
+      for (int i=0; i<d->lstCameras.size(); ++i)
+        {
+          if (d->lstCameras[i].lstPending.isEmpty())
+            return;
+          qint64 iKey = d->lstCameras[i].lstPending.first().iKey;
+          qint64 iFrameOrigin = d->lstCameras[i].lstPending.first().iOriginTime;
+          if (i == 0 || iFrameOrigin < iOriginTime)
+            iOriginTime = iFrameOrigin;
+          if (i == 0 || iKey < iMinKey)
+            {
+              iMinKey = iKey;
+              iOldest = i;
+            }
+          if (i == 0 || iKey > iMaxKey)
+            iMaxKey = iKey;
+        }
+
+      // The oldest frame has no counterpart in some camera.
+      if (iMaxKey - iMinKey > iTolerance)
+        {
+          d->lstCameras[iOldest].lstPending.removeFirst();
+          ++d->iDroppedFrames;
+          continue;
+        }
+
+      // The group is as old as its oldest frame.
+      PiiYdin::setCurrentOriginTime(iOriginTime);
+      try
+        {
+          d->pIndexOutput->emitObject(d->iGroupIndex++);
+          for (int i=0; i<d->lstCameras.size(); ++i)
+            outputAt(i+1)->emitObject(d->lstCameras[i].lstPending.takeFirst().image);
+        }
+      catch (PiiExecutionException&)
+        {
+          // Interrupted
+          return;
+        }
+
+      if (d->bTriggered)
+        d->groupWaitCondition.wakeOne();
+    }
+}
+
+void PiiMultiCameraOperation::captureFinished(int camera, bool success)
+{
+  PII_D;
+  if (success)
+    return;
+
+  piiWarning(tr("Camera %1 stopped capturing unexpectedly.").arg(camera));
+  bool bFirstFailure = false;
+  synchronized (d->frameMutex)
+    {
+      bFirstFailure = !d->bCaptureFailed;
+      d->bCaptureFailed = true;
+    }
+  if (bFirstFailure)
+    operationStopped();
+}
+
+void PiiMultiCameraOperation::captureError(int camera, const QString& message)
+{
+  piiWarning(tr("Error in capturing image from camera %1: %2").arg(camera).arg(message));
+}
+
+PiiVariant PiiMultiCameraOperation::createFrame(const Camera& camera, uint frameIndex, void* frameBuffer)
+{
+  Pii::PtrOwnership ownership = frameBuffer != 0 ? Pii::ReleaseOwnership : Pii::RetainOwnership;
+  void* pBuffer = ownership == Pii::ReleaseOwnership ? frameBuffer : camera.pDriver->frameBuffer(frameIndex);
+  if (pBuffer == 0)
+    return PiiVariant();
+
+  // Leased frames can wait for their group without copying.
+  PiiBufferLease* pLease = ownership == Pii::RetainOwnership ?
+    camera.pDriver->leaseFrame(frameIndex) : 0;
+
+  PiiVariant image;
+  switch (camera.iBitsPerPixel)
+    {
+    case 8:
+      image = PiiVariant(frameMatrix<unsigned char>(camera, pBuffer, ownership, pLease));
+      break;
+    case 16:
+      image = PiiVariant(frameMatrix<unsigned short>(camera, pBuffer, ownership, pLease));
+      break;
+    case 24:
+      image = PiiVariant(frameMatrix<PiiColor<unsigned char> >(camera, pBuffer, ownership, pLease));
+      break;
+    default:
+      if (ownership == Pii::ReleaseOwnership)
+        free(pBuffer);
+    }
+
+  if (pLease != 0)
+    pLease->release();
+  return image;
+}
+
+template <class T> PiiMatrix<T> PiiMultiCameraOperation::frameMatrix(const Camera& camera,
+                                                                     void* frameBuffer,
+                                                                     Pii::PtrOwnership ownership,
+                                                                     PiiBufferLease* lease)
+{
+  if (lease != 0)
+    return PiiMatrix<T>(camera.iImageHeight, camera.iImageWidth, frameBuffer, lease);
+  if (ownership == Pii::ReleaseOwnership)
+    return PiiMatrix<T>(camera.iImageHeight, camera.iImageWidth, frameBuffer, ownership);
+
+  // The driver may overwrite its buffer before the group is
+  // complete.
+  PiiMatrix<T> matCopy(camera.iImageHeight, camera.iImageWidth, static_cast<const T*>(frameBuffer));
+  matCopy.detach();
+  return matCopy;
+}
+
+void PiiMultiCameraOperation::setDriverNames(const QStringList& driverNames)
+{
+  PII_D;
+  QList<PiiCameraDriver*> lstDrivers;
+  for (int i=0; i<driverNames.size(); ++i)
+    {
+      PiiCameraDriver* pDriver = PiiYdin::createResource<PiiCameraDriver>(driverNames[i]);
+      if (pDriver == 0)
+        {
+          piiWarning(tr("Camera driver %1 is not available.").arg(driverNames[i]));
+          qDeleteAll(lstDrivers);
+          return;
+        }
+      lstDrivers << pDriver;
+    }
+
+  deleteDrivers();
+  for (int i=0; i<lstDrivers.size(); ++i)
+    {
+      Camera camera;
+      camera.pDriver = lstDrivers[i];
+      camera.pDriver->setObjectName(QString("driver%1").arg(i));
+      camera.pDriver->setParent(this);
+      camera.pListener = new CameraListener(this, i);
+      camera.pDriver->setListener(camera.pListener);
+      d->lstCameras << camera;
+    }
+  d->lstDriverNames = driverNames;
+  setNumberedOutputs(driverNames.size(), 1, "image");
+}
+
+QStringList PiiMultiCameraOperation::driverNames() const { return _d()->lstDriverNames; }
+void PiiMultiCameraOperation::setCameraIds(const QStringList& cameraIds) { _d()->lstCameraIds = cameraIds; }
+QStringList PiiMultiCameraOperation::cameraIds() const { return _d()->lstCameraIds; }
+int PiiMultiCameraOperation::cameraCount() const { return _d()->lstCameras.size(); }
+void PiiMultiCameraOperation::setMatchingMode(MatchingMode matchingMode) { _d()->matchingMode = matchingMode; }
+PiiMultiCameraOperation::MatchingMode PiiMultiCameraOperation::matchingMode() const { return _d()->matchingMode; }
+void PiiMultiCameraOperation::setMaxTimeDifference(int maxTimeDifference) { _d()->iMaxTimeDifference = qMax(0, maxTimeDifference); }
+int PiiMultiCameraOperation::maxTimeDifference() const { return _d()->iMaxTimeDifference; }
+void PiiMultiCameraOperation::setMaxPendingFrames(int maxPendingFrames) { _d()->iMaxPendingFrames = qMax(1, maxPendingFrames); }
+int PiiMultiCameraOperation::maxPendingFrames() const { return _d()->iMaxPendingFrames; }
+void PiiMultiCameraOperation::setPoolFrames(bool poolFrames) { _d()->bPoolFrames = poolFrames; }
+bool PiiMultiCameraOperation::poolFrames() const { return _d()->bPoolFrames; }
+int PiiMultiCameraOperation::droppedFrameCount() const { return _d()->iDroppedFrames; }
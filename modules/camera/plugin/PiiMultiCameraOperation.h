@@ -0,0 +1,236 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMULTICAMERAOPERATION_H
+#define _PIIMULTICAMERAOPERATION_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiWaitCondition.h>
+#include <PiiTimer.h>
+#include <QMutex>
+#include "PiiCameraDriver.h"
+
+/**
+ * Synchronized acquisition from many cameras. The operation owns one
+ * camera driver for each camera and emits the frames they capture
+ * in groups. A group contains one frame from each camera, and all
+ * frames in a group are emitted in the same processing round.
+ * Downstream operations thus receive frames that were taken at the
+ * same time without separate queueing and pairing logic.
+ *
+ * Frames are matched either by their frame index or by time (see
+ * [matchingMode]). If a camera misses a frame, the frames other
+ * cameras captured at the same time cannot form a complete group.
+ * They will be dropped and counted to [droppedFrameCount].
+ *
+ * Frames whose buffers the [driver can lease](PiiCameraDriver::leaseFrame())
+ * are never copied. Otherwise, each frame is copied while its group
+ * is being formed. If [poolFrames] is `true`, the copies of all
+ * cameras share the same [buffer pool](PiiMatrixPool), which is
+ * enabled while the operation is running.
+ *
+ * Driver properties can be accessed with the `driverX.` prefix,
+ * where X is the index of the camera. For example, to set the
+ * exposure time of the second camera:
+ *
+ * ~~~(c++)
+ * pOperation->setProperty("driver1.exposureTime", 1000);
+ * ~~~
+ *
+ * Inputs
+ * ------
+ *
+ * @in trigger - an optional trigger input. If this input is
+ * connected, all cameras are software-triggered whenever an object
+ * is received, and the operation waits until a complete group has
+ * been emitted. Otherwise, the cameras run in the trigger mode they
+ * have been configured to, usually with a common hardware trigger.
+ *
+ * Outputs
+ * -------
+ *
+ * @out index - the index of the frame group (int), starting at zero.
+ *
+ * @out imageX - the frame captured by camera X, where X ranges from
+ * 0 to [cameraCount] - 1. Frames are emitted as captured, without
+ * color conversion. Depending on the bit depth of the camera, the
+ * type is either `PiiMatrix<unsigned char>`, `PiiMatrix<unsigned
+ * short>` or `PiiMatrix<PiiColor<unsigned char> >`.
+ */
+class PII_CAMERA_EXPORT PiiMultiCameraOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The names of the camera drivers, one for each camera. Setting
+   * this property creates new drivers and as many image outputs as
+   * there are driver names. If a driver is not available, the
+   * operation will fail to start.
+   */
+  Q_PROPERTY(QStringList driverNames READ driverNames WRITE setDriverNames);
+
+  /**
+   * The IDs of the cameras, in the same order as [driverNames].
+   */
+  Q_PROPERTY(QStringList cameraIds READ cameraIds WRITE setCameraIds);
+
+  /**
+   * The number of cameras.
+   */
+  Q_PROPERTY(int cameraCount READ cameraCount);
+
+  /**
+   * The way frames are matched to each other. The default is
+   * `MatchFrameIndex`.
+   */
+  Q_PROPERTY(MatchingMode matchingMode READ matchingMode WRITE setMatchingMode);
+  Q_ENUMS(MatchingMode);
+
+  /**
+   * The maximum time difference between frames in a group, in
+   * microseconds. Only used in `MatchTimestamp` mode. The default is
+   * 1000.
+   */
+  Q_PROPERTY(int maxTimeDifference READ maxTimeDifference WRITE setMaxTimeDifference);
+
+  /**
+   * The maximum number of unmatched frames kept for each camera. If
+   * one camera is not delivering frames, the oldest frames of the
+   * others are dropped once this limit is exceeded. Note that
+   * pending frames leased from a driver keep its buffers reserved.
+   * The default is 4.
+   */
+  Q_PROPERTY(int maxPendingFrames READ maxPendingFrames WRITE setMaxPendingFrames);
+
+  /**
+   * If `true`, copied frames are allocated from PiiMatrixPool, which
+   * is enabled while the operation is running. The default is `true`.
+   */
+  Q_PROPERTY(bool poolFrames READ poolFrames WRITE setPoolFrames);
+
+  /**
+   * The number of frames dropped because no matching frame was
+   * received from the other cameras.
+   */
+  Q_PROPERTY(int droppedFrameCount READ droppedFrameCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  /**
+   * Frame matching modes.
+   *
+   * - `MatchFrameIndex` - frames with equal indices form a group.
+   * This requires that all cameras are triggered by the same signal
+   * and start capturing before the first trigger.
+   *
+   * - `MatchTimestamp` - frames whose capture times differ by at most
+   * [maxTimeDifference] form a group. The capture time is
+   * accumulated from the frame intervals reported by the driver. If
+   * the driver cannot measure them, the time the frame was received
+   * is used instead.
+   */
+  enum MatchingMode { MatchFrameIndex, MatchTimestamp };
+
+  PiiMultiCameraOperation();
+  ~PiiMultiCameraOperation();
+
+  QVariant property(const char* name) const;
+  bool setProperty(const char* name, const QVariant& value);
+
+  void check(bool reset);
+  void start();
+  void interrupt();
+  void pause();
+  void stop();
+
+  void setDriverNames(const QStringList& driverNames);
+  QStringList driverNames() const;
+  void setCameraIds(const QStringList& cameraIds);
+  QStringList cameraIds() const;
+  int cameraCount() const;
+  void setMatchingMode(MatchingMode matchingMode);
+  MatchingMode matchingMode() const;
+  void setMaxTimeDifference(int maxTimeDifference);
+  int maxTimeDifference() const;
+  void setMaxPendingFrames(int maxPendingFrames);
+  int maxPendingFrames() const;
+  void setPoolFrames(bool poolFrames);
+  bool poolFrames() const;
+  int droppedFrameCount() const;
+
+protected:
+  void process();
+
+private:
+  class CameraListener;
+  friend class CameraListener;
+
+  struct Frame
+  {
+    Frame(const PiiVariant& image = PiiVariant(), qint64 key = 0, qint64 originTime = 0) :
+      image(image), iKey(key), iOriginTime(originTime)
+    {}
+    PiiVariant image;
+    qint64 iKey;
+    qint64 iOriginTime;
+  };
+
+  struct Camera
+  {
+    Camera();
+    PiiCameraDriver* pDriver;
+    CameraListener* pListener;
+    int iImageWidth, iImageHeight, iBitsPerPixel;
+    qint64 iClock;
+    QList<Frame> lstPending;
+  };
+
+  void frameCaptured(int camera, uint frameIndex, void* frameBuffer, qint64 elapsedTime);
+  void captureFinished(int camera, bool success);
+  void captureError(int camera, const QString& message);
+
+  PiiVariant createFrame(const Camera& camera, uint frameIndex, void* frameBuffer);
+  template <class T> PiiMatrix<T> frameMatrix(const Camera& camera, void* frameBuffer,
+                                              Pii::PtrOwnership ownership, PiiBufferLease* lease);
+  void emitCompleteGroups();
+  void clearPendingFrames();
+  void deleteDrivers();
+  void startPool();
+  void stopPool();
+  void stopCapture();
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    PiiInputSocket* pTriggerInput;
+    PiiOutputSocket* pIndexOutput;
+    QStringList lstDriverNames, lstCameraIds;
+    QList<Camera> lstCameras;
+    MatchingMode matchingMode;
+    int iMaxTimeDifference;
+    int iMaxPendingFrames;
+    bool bPoolFrames, bUsingPool;
+    bool bTriggered, bCaptureFailed;
+    int iGroupIndex, iDroppedFrames;
+    QMutex frameMutex;
+    PiiWaitCondition groupWaitCondition;
+    PiiTimer captureTimer;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIMULTICAMERAOPERATION_H
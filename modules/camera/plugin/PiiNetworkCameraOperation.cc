@@ -19,12 +19,25 @@
 #include <cstdio>
 #include <PiiHttpDevice.h>
 #include <PiiSocketDevice.h>
+#include <PiiMultipartDecoder.h>
+#include <PiiAsyncCall.h>
+#include <PiiQImage.h>
+#include <PiiColor.h>
+#include <PiiYdinTypes.h>
+#include <PiiSynchronized.h>
+#include <QBuffer>
+#include <cstring>
 
 PiiNetworkCameraOperation::Data::Data() :
   iPort(0),
   dMaxIoDelay(1.0),
   bStreamMode(false),
-  bIgnoreErrors(false)
+  bIgnoreErrors(false),
+  iDecoderThreads(2),
+  pReceiverThread(0),
+  iReceivedFrames(0),
+  iEmittedFrames(0),
+  bReceiverFinished(false)
 {
 }
 
@@ -39,6 +52,7 @@ PiiNetworkCameraOperation::PiiNetworkCameraOperation() :
 
 PiiNetworkCameraOperation::~PiiNetworkCameraOperation()
 {
+  stopStream();
 }
 
 void PiiNetworkCameraOperation::setMaxIoDelay(double delay)
@@ -85,9 +99,22 @@ void PiiNetworkCameraOperation::check(bool reset)
     d->strPreviousUrl = "";
 }
 
+void PiiNetworkCameraOperation::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    stopStream();
+  PiiImageReaderOperation::aboutToChangeState(state);
+}
+
 void PiiNetworkCameraOperation::process()
 {
   PII_D;
+  if (d->bStreamMode && !d->pUrlInput->isConnected())
+    {
+      processStream();
+      return;
+    }
+
   QString strHost = d->strHost, strPath = d->strPath;
   qint16 iPort = d->iPort;
   QString strUrl = d->strImageUrl;
@@ -189,3 +216,255 @@ void PiiNetworkCameraOperation::setStreamMode(bool streamMode) { _d()->bStreamMo
 bool PiiNetworkCameraOperation::ignoreErrors() const { return _d()->bIgnoreErrors; }
 void PiiNetworkCameraOperation::setIgnoreErrors(bool ignoreErrors) { _d()->bIgnoreErrors = ignoreErrors; }
 double PiiNetworkCameraOperation::maxIoDelay() const { return _d()->dMaxIoDelay; }
+int PiiNetworkCameraOperation::decoderThreads() const { return _d()->iDecoderThreads; }
+void PiiNetworkCameraOperation::setDecoderThreads(int decoderThreads) { _d()->iDecoderThreads = qBound(1, decoderThreads, 64); }
+
+void PiiNetworkCameraOperation::processStream()
+{
+  PII_D;
+  if (d->pReceiverThread == 0)
+    startStream();
+
+  PiiVariant image;
+  bool bStreamEnded = false;
+  synchronized (d->streamMutex)
+    {
+      // Wait for the next frame in reception order.
+      while (!d->mapDecodedFrames.contains(d->iEmittedFrames))
+        {
+          if (d->bReceiverFinished && d->iEmittedFrames == d->iReceivedFrames)
+            {
+              bStreamEnded = true;
+              break;
+            }
+          // Let the processor check for state changes every now and
+          // then. A trigger must always be answered with an image.
+          if (!d->frameDecoded.wait(&d->streamMutex, 100) &&
+              (!d->pTriggerInput->isConnected() || state() != Running))
+            return;
+        }
+
+      if (d->mapDecodedFrames.contains(d->iEmittedFrames))
+        {
+          image = d->mapDecodedFrames.take(d->iEmittedFrames++);
+          d->frameEmitted.wakeOne();
+        }
+    }
+
+  // All frames have been emitted, and the stream has ended. It will
+  // be restarted on the next round.
+  if (bStreamEnded)
+    {
+      QString strError = d->strStreamError;
+      stopStream();
+      if (!strError.isEmpty())
+        {
+          if (!d->bIgnoreErrors)
+            PII_THROW(PiiExecutionException, strError);
+          piiWarning(strError);
+        }
+      return;
+    }
+
+  if (image.isValid())
+    d->pImageOutput->emitObject(image);
+  else if (!d->bIgnoreErrors)
+    PII_THROW(PiiExecutionException, tr("Could not decode image at %1.").arg(d->strImageUrl));
+}
+
+void PiiNetworkCameraOperation::startStream()
+{
+  PII_D;
+  stopStream();
+
+  d->streamController.bRunning = true;
+  d->bReceiverFinished = false;
+  d->strStreamError.clear();
+  d->iReceivedFrames = d->iEmittedFrames = 0;
+
+  d->pReceiverThread = Pii::createAsyncCall(this, &PiiNetworkCameraOperation::receiveStream);
+  d->pReceiverThread->start();
+  for (int i=0; i<d->iDecoderThreads; ++i)
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiNetworkCameraOperation::decodeStream);
+      d->lstDecoderThreads << pThread;
+      pThread->start();
+    }
+}
+
+void PiiNetworkCameraOperation::stopStream()
+{
+  PII_D;
+  synchronized (d->streamMutex)
+    {
+      d->streamController.bRunning = false;
+      d->frameReceived.wakeAll();
+      d->frameEmitted.wakeAll();
+    }
+
+  if (d->pReceiverThread != 0)
+    {
+      d->pReceiverThread->wait();
+      delete d->pReceiverThread;
+      d->pReceiverThread = 0;
+    }
+  for (int i=0; i<d->lstDecoderThreads.size(); ++i)
+    {
+      d->lstDecoderThreads[i]->wait();
+      delete d->lstDecoderThreads[i];
+    }
+  d->lstDecoderThreads.clear();
+  d->queEncodedFrames.clear();
+  d->mapDecodedFrames.clear();
+}
+
+void PiiNetworkCameraOperation::receiveStream()
+{
+  PII_D;
+  disconnectSocket();
+  d->strPreviousUrl = d->strImageUrl;
+  d->networkClient.setServerAddress(QString("tcp://%1:%2").arg(d->strHost).arg(d->iPort));
+
+  PiiSocketDevice socket = d->networkClient.openConnection();
+  if (socket == 0)
+    {
+      finishStream(tr("Cannot open connection to: %1").arg(d->networkClient.serverAddress()));
+      return;
+    }
+
+  try
+    {
+      PiiHttpDevice dev(socket, PiiHttpDevice::Client);
+      // A stream has no size limit.
+      dev.setMessageSizeLimit(0);
+      dev.setController(&d->streamController);
+      dev.setDataTimeout(int(d->dMaxIoDelay * 1000));
+      dev.setRequest("GET", d->strPath);
+      dev.setHeader("Host", d->strHost);
+      dev.finish();
+
+      dev.readHeader();
+      PiiHttpResponseHeader header = dev.responseHeader();
+      if (header.statusCode() != 200) // 200 OK
+        {
+          disconnectSocket();
+          finishStream(tr("HTTP error: %1").arg(header.reasonPhrase()));
+          return;
+        }
+
+      if (header.contentType().startsWith("multipart/"))
+        {
+          // Typically multipart/x-mixed-replace. Each body part is a
+          // frame.
+          PiiMultipartDecoder decoder(&dev, header);
+          while (d->streamController.bRunning && dev.isReadable() &&
+                 decoder.nextMessage())
+            {
+              QByteArray aFrame = decoder.readAll();
+              if (!aFrame.isEmpty() && !enqueueFrame(aFrame))
+                break;
+            }
+        }
+      else
+        // Not a stream after all.
+        enqueueFrame(dev.readAll());
+    }
+  catch (PiiException& ex)
+    {
+      disconnectSocket();
+      finishStream(ex.message());
+      return;
+    }
+
+  disconnectSocket();
+  finishStream(QString());
+}
+
+bool PiiNetworkCameraOperation::enqueueFrame(const QByteArray& frame)
+{
+  PII_D;
+  QMutexLocker lock(&d->streamMutex);
+  // Don't let reception run too far ahead of emission.
+  while (d->streamController.bRunning &&
+         d->iReceivedFrames - d->iEmittedFrames >= 2 * d->iDecoderThreads + 2)
+    d->frameEmitted.wait(&d->streamMutex);
+  if (!d->streamController.bRunning)
+    return false;
+
+  d->queEncodedFrames.enqueue(qMakePair(d->iReceivedFrames++, frame));
+  d->frameReceived.wakeOne();
+  return true;
+}
+
+void PiiNetworkCameraOperation::finishStream(const QString& error)
+{
+  PII_D;
+  QMutexLocker lock(&d->streamMutex);
+  d->strStreamError = error;
+  d->bReceiverFinished = true;
+  d->frameReceived.wakeAll();
+  d->frameDecoded.wakeAll();
+}
+
+void PiiNetworkCameraOperation::decodeStream()
+{
+  PII_D;
+  // Reused as long as the size and format of frames don't change.
+  QImage image;
+  forever
+    {
+      QPair<int,QByteArray> frame;
+      synchronized (d->streamMutex)
+        {
+          while (d->queEncodedFrames.isEmpty())
+            {
+              if (!d->streamController.bRunning || d->bReceiverFinished)
+                return;
+              d->frameReceived.wait(&d->streamMutex);
+            }
+          if (!d->streamController.bRunning)
+            return;
+          frame = d->queEncodedFrames.dequeue();
+        }
+
+      PiiVariant result = decodeFrame(frame.second, image);
+
+      synchronized (d->streamMutex)
+        {
+          // An invalid result keeps a failed frame in order.
+          d->mapDecodedFrames.insert(frame.first, result);
+          d->frameDecoded.wakeAll();
+        }
+    }
+}
+
+PiiVariant PiiNetworkCameraOperation::decodeFrame(const QByteArray& frame, QImage& image)
+{
+  PII_D;
+  QBuffer buffer;
+  buffer.setData(frame);
+  buffer.open(QIODevice::ReadOnly);
+  QImageReader imageReader(&buffer);
+  if (!imageReader.read(&image) || image.width() == 0 || image.height() == 0)
+    {
+      piiWarning(tr("Image decoding error: %1").arg(imageReader.errorString()));
+      return PiiVariant();
+    }
+
+  const int iRows = image.height(), iColumns = image.width();
+  if (d->imageType == GrayScale ||
+      (d->imageType == Original && image.depth() != 32))
+    {
+      Pii::convertToGray(image);
+      PiiMatrix<unsigned char> matImage(PiiMatrix<unsigned char>::uninitialized(iRows, iColumns));
+      for (int r=0; r<iRows; ++r)
+        memcpy(matImage.row(r), image.constScanLine(r), iColumns);
+      return PiiVariant(matImage);
+    }
+
+  Pii::convertToRgba(image);
+  PiiMatrix<PiiColor4<unsigned char> > matImage(PiiMatrix<PiiColor4<unsigned char> >::uninitialized(iRows, iColumns));
+  for (int r=0; r<iRows; ++r)
+    memcpy(matImage.row(r), image.constScanLine(r), iColumns * sizeof(PiiColor4<unsigned char>));
+  return PiiVariant(matImage);
+}
@@ -22,6 +22,11 @@
 #include "PiiCameraGlobal.h"
 #include <PiiWaitCondition.h>
 #include <PiiNetworkClient.h>
+#include <PiiProgressController.h>
+#include <QWaitCondition>
+#include <QThread>
+#include <QQueue>
+#include <QMap>
 
 /**
  * A camera interface that reads images from a network camera.
@@ -65,9 +70,16 @@ class PII_CAMERA_EXPORT PiiNetworkCameraOperation : public PiiImageReaderOperati
    * to set this flag for better performance. In stream mode, only one
    * HTTP request is performed and the stream is read forever,
    * provided that any further operations are able to process the
-   * data. If they are not, the internal buffer of
-   * PiiHttpCameraOperation may overflow which causes the operation to
-   * abort. The default value is `false`.
+   * data. If they are not, reception will be suspended until they
+   * catch up. The default value is `false`.
+   *
+   * In stream mode, frames are received in a separate thread and
+   * decoded in [decoderThreads] parallel threads. Decoded images are
+   * still emitted in the order they were received. Each decoder
+   * thread reuses its decoding buffer, and the emitted images are
+   * allocated with PiiMatrix::uninitialized(), which takes them from
+   * PiiMatrixPool if the pool is enabled. If the `url` input is
+   * connected, stream mode has no effect.
    */
   Q_PROPERTY(bool streamMode READ streamMode WRITE setStreamMode);
 
@@ -86,6 +98,13 @@ class PII_CAMERA_EXPORT PiiNetworkCameraOperation : public PiiImageReaderOperati
    */
   Q_PROPERTY(double maxIoDelay READ maxIoDelay WRITE setMaxIoDelay);
 
+  /**
+   * The number of threads that decode images in stream mode. The
+   * default value is 2. A 1080p MJPEG stream at 30 frames per second
+   * usually needs two or three threads on a desktop processor.
+   */
+  Q_PROPERTY(int decoderThreads READ decoderThreads WRITE setDecoderThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -107,10 +126,14 @@ public:
   double maxIoDelay() const;
   void setMaxIoDelay(double maxIoDelay);
 
+  int decoderThreads() const;
+  void setDecoderThreads(int decoderThreads);
+
   void check(bool reset);
 
 protected:
   void process();
+  void aboutToChangeState(State state);
 
 private:
   /// @internal
@@ -127,11 +150,38 @@ private:
     bool bStreamMode, bIgnoreErrors;
     PiiInputSocket* pUrlInput;
     QString strPreviousUrl;
+
+    // Stream mode
+    struct StreamController : PiiProgressController
+    {
+      StreamController() : bRunning(false) {}
+      bool canContinue(double) const { return bRunning; }
+      volatile bool bRunning;
+    } streamController;
+    int iDecoderThreads;
+    QThread* pReceiverThread;
+    QList<QThread*> lstDecoderThreads;
+    QMutex streamMutex;
+    QWaitCondition frameReceived, frameDecoded, frameEmitted;
+    QQueue<QPair<int,QByteArray> > queEncodedFrames;
+    QMap<int,PiiVariant> mapDecodedFrames;
+    int iReceivedFrames, iEmittedFrames;
+    bool bReceiverFinished;
+    QString strStreamError;
   };
   PII_D_FUNC;
 
   void disconnectSocket();
   void checkUrl(const QUrl& url);
+
+  void processStream();
+  void startStream();
+  void stopStream();
+  void receiveStream();
+  bool enqueueFrame(const QByteArray& frame);
+  void finishStream(const QString& error);
+  void decodeStream();
+  PiiVariant decodeFrame(const QByteArray& frame, QImage& image);
 };
 
 #endif //_PIINETWORKCAMERAOPERATION_H
@@ -173,6 +173,8 @@ void PiiWebcamDriver::initialize(const QString& cameraId)
     PII_THROW(PiiCameraDriverException, tr("Could not register frame buffers"));
 
   _vecBufferPointers.fill(0,_iFrameBufferCount);
+  _vecBufferIndices.fill(-1,_iFrameBufferCount);
+  _vecFrameDataSizes.fill(-1,_iFrameBufferCount);
 
   _bOpen = true;
 }
@@ -220,7 +222,17 @@ bool PiiWebcamDriver::startCapture(int frames)
 
   _uiFrameIndex = -1;
   _iMaxFrames = _triggerMode == PiiCameraDriver::SoftwareTrigger ? 0 : frames;
+  _iGrabbedBuffers = 0;
+  _iMinQueuedBuffers = _iFrameBufferCount;
+  _iCapturedFrames = 0;
+  _leases.resetStatistics();
 
+  return startCaptureThread();
+}
+
+// _captureMutex must be locked when calling this function.
+bool PiiWebcamDriver::startCaptureThread()
+{
   if (!startVideoStream(_fileDevice.handle()))
     {
       piiWarning(tr("Couldn't start video stream."));
@@ -237,6 +249,55 @@ bool PiiWebcamDriver::startCapture(int frames)
   return true;
 }
 
+bool PiiWebcamDriver::resizeFrameBuffers(int bufferCount)
+{
+  if (!_bOpen || bufferCount < 1)
+    return false;
+
+  // Frame indices and statistics are retained over the pause.
+  bool bCapturing = stopCapture();
+
+  QMutexLocker lock(&_captureMutex);
+  if (_pCaptureThread)
+    return false;
+
+  int iOldCount = _iFrameBufferCount;
+  deregisterFrameBuffers();
+  _iFrameBufferCount = bufferCount < 2 ? 1 :
+    1 << Pii::lastOneBit((bufferCount-1));
+  bool bSuccess = registerFrameBuffers(_fileDevice.handle());
+  if (!bSuccess)
+    {
+      // Try to get the old buffers back.
+      deregisterFrameBuffers();
+      _iFrameBufferCount = iOldCount;
+      if (!registerFrameBuffers(_fileDevice.handle()))
+        {
+          piiWarning(tr("Could not register frame buffers"));
+          return false;
+        }
+    }
+  _vecBufferPointers.fill(0,_iFrameBufferCount);
+  _vecBufferIndices.fill(-1,_iFrameBufferCount);
+  _vecFrameDataSizes.fill(-1,_iFrameBufferCount);
+  _iMinQueuedBuffers = qMin(_iMinQueuedBuffers.load(), _iFrameBufferCount);
+
+  if (bCapturing && !startCaptureThread())
+    return false;
+  return bSuccess;
+}
+
+PiiCameraDriver::BufferStatistics PiiWebcamDriver::bufferStatistics() const
+{
+  BufferStatistics statistics;
+  statistics.bufferCount = _iFrameBufferCount;
+  statistics.queuedBuffers = _iFrameBufferCount - _iGrabbedBuffers.load();
+  statistics.minQueuedBuffers = _iMinQueuedBuffers.load();
+  statistics.capturedFrames = _iCapturedFrames.load();
+  _leases.fillStatistics(statistics);
+  return statistics;
+}
+
 void PiiWebcamDriver::deleteCaptureThread()
 {
   QMutexLocker lock(&_captureMutex);
@@ -295,13 +356,23 @@ void PiiWebcamDriver::capture()
         }
       while (!bSoftwareTrigger && lstBuffers.size() < _iFrameBufferCount);
 
+      // Until requeued, the grabbed buffers are not available to v4l.
+      _iGrabbedBuffers = lstBuffers.size();
+      _iCapturedFrames += lstBuffers.size();
+      if (_iFrameBufferCount - lstBuffers.size() < _iMinQueuedBuffers.load())
+        _iMinQueuedBuffers = _iFrameBufferCount - lstBuffers.size();
+
       // Inform listener about each frame in turn.
       if (lstBuffers.size() > 0)
         {
           for (int i=0; i<lstBuffers.size(); ++i)
             {
               ++_uiFrameIndex;
-              _vecBufferPointers[_uiFrameIndex % _iFrameBufferCount] = lstBuffers[i];
+              int iSlot = _uiFrameIndex % _iFrameBufferCount;
+              // Buffers were reserved in the order they were grabbed.
+              _vecBufferPointers[iSlot] = lstBuffers[i];
+              _vecBufferIndices[iSlot] = _vecReservedBuffers[i].index;
+              _vecFrameDataSizes[iSlot] = _vecReservedBuffers[i].bytesused;
               listener()->frameCaptured(_uiFrameIndex, 0,0);
               if (_iMaxFrames > 0 && int(_uiFrameIndex) > _iMaxFrames)
                 break;
@@ -311,11 +382,13 @@ void PiiWebcamDriver::capture()
         }
 
       // Release buffers back to v4l
+      waitForLeases();
       if (!requeueBuffers(_fileDevice.handle()))
         {
           bSuccess = false;
           break;
         }
+      _iGrabbedBuffers = 0;
     }
 
   // Stop streaming
@@ -466,10 +539,23 @@ bool PiiWebcamDriver::registerFrameBuffers(int fd)
                                  MAP_SHARED /* recommended */,
                                  fd, buf.m.offset);
       wBuffer->v4l2Buffer = buf;
+      wBuffer->dmaBufFd = -1;
 
       if (wBuffer->frameStart == MAP_FAILED)
         PII_THROW(PiiCameraDriverException, tr("Error in mmap buffers"));
 
+#ifdef VIDIOC_EXPBUF
+      // Export the buffer so that other devices can access the frame
+      // directly. Not all kernel drivers support this.
+      v4l2_exportbuffer expbuf;
+      CLEAR (expbuf);
+      expbuf.type  = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      expbuf.index = i;
+      expbuf.flags = O_RDONLY | O_CLOEXEC;
+      if (xioctl(fd, VIDIOC_EXPBUF, &expbuf))
+        wBuffer->dmaBufFd = expbuf.fd;
+#endif
+
       _vecBuffers << wBuffer;
     }
 
@@ -478,25 +564,57 @@ bool PiiWebcamDriver::registerFrameBuffers(int fd)
 
 bool PiiWebcamDriver::deregisterFrameBuffers()
 {
+  // Leased frames still point to the mapped memory.
+  _leases.waitForLeases();
+
   // munmap buffers
   for (int i=0; i<_vecBuffers.size(); i++)
     {
       if (munmap(_vecBuffers[i]->frameStart, _vecBuffers[i]->v4l2Buffer.length) == -1)
         piiWarning(tr("Error in unmap buffers"));
+      if (_vecBuffers[i]->dmaBufFd != -1)
+        ::close(_vecBuffers[i]->dmaBufFd);
       delete _vecBuffers[i];
     }
   _vecBuffers.clear();
   _vecReservedBuffers.clear();
   _vecBufferPointers.clear();
+  _vecBufferIndices.clear();
+  _vecFrameDataSizes.clear();
 
   return true;
 }
 
+void PiiWebcamDriver::waitForLeases()
+{
+  // Don't block a stop request forever. Once the stream has been
+  // stopped, the buffers will not be overwritten.
+  while (!_leases.waitForLeases(100))
+    if (!_pCaptureThread)
+      break;
+}
+
+PiiBufferLease* PiiWebcamDriver::leaseFrame(uint /*index*/)
+{
+  return _leases.createLease();
+}
+
 void* PiiWebcamDriver::frameBuffer(uint index) const
 {
   return _vecBufferPointers[index % _iFrameBufferCount];
 }
 
+int PiiWebcamDriver::frameDataSize(uint index) const
+{
+  return _vecFrameDataSizes[index % _iFrameBufferCount];
+}
+
+int PiiWebcamDriver::frameBufferHandle(uint index) const
+{
+  int iBuffer = _vecBufferIndices[index % _iFrameBufferCount];
+  return iBuffer >= 0 ? _vecBuffers[iBuffer]->dmaBufFd : -1;
+}
+
 bool PiiWebcamDriver::isOpen() const
 {
   return _bOpen;
@@ -567,6 +685,8 @@ int PiiWebcamDriver::imageFormat() const
         case V4L2_PIX_FMT_YUYV: return PiiCamera::Yuv422Format;
         case V4L2_PIX_FMT_RGB24: return PiiCamera::RgbFormat;
         case V4L2_PIX_FMT_BGR24: return PiiCamera::BgrFormat;
+        case V4L2_PIX_FMT_MJPEG:
+        case V4L2_PIX_FMT_JPEG: return PiiCamera::MjpegFormat;
         default:
           piiWarning(tr("Unrecognized image format."));
           return (int)PiiCamera::InvalidFormat;
@@ -726,6 +846,11 @@ bool PiiWebcamDriver::setImageFormat(int value)
       _iPixelFormat = V4L2_PIX_FMT_BGR24;
       _iBitsPerPixel = 24;
       break;
+    case PiiCamera::MjpegFormat:
+      // Compressed frames are passed through as such.
+      _iPixelFormat = V4L2_PIX_FMT_MJPEG;
+      _iBitsPerPixel = 8;
+      break;
     default:
       bSupported = false;
       break;
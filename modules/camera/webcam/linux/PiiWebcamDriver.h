@@ -20,6 +20,7 @@
 #include <PiiWaitCondition.h>
 #include <PiiWebcamDriverGlobal.h>
 #include <PiiTimer.h>
+#include <PiiAtomicInt.h>
 
 #include <QThread>
 #include <QMutex>
@@ -71,6 +72,11 @@ public:
   bool startCapture(int frames);
   bool stopCapture();
   void* frameBuffer(uint frameIndex) const;
+  PiiBufferLease* leaseFrame(uint frameIndex);
+  int frameDataSize(uint frameIndex) const;
+  int frameBufferHandle(uint frameIndex) const;
+  BufferStatistics bufferStatistics() const;
+  bool resizeFrameBuffers(int bufferCount);
   bool isOpen() const;
   bool isCapturing() const;
   bool triggerImage();
@@ -94,6 +100,7 @@ private slots:
   void deleteCaptureThread();
 private:
   void capture();
+  bool startCaptureThread();
 
   bool requiresInitialization(const char* name) const;
 
@@ -104,6 +111,7 @@ private:
   // v4l-functions
   bool grabFrame(int fd, void **buffer, int timeout);
   bool requeueBuffers(int fd);
+  void waitForLeases();
   bool startVideoStream(int fd);
   bool stopVideoStream(int fd);
   bool registerFrameBuffers(int fd);
@@ -118,12 +126,22 @@ private:
   {
     v4l2_buffer v4l2Buffer;
     void *frameStart;
+    // DMABUF file descriptor, -1 if the buffer could not be exported.
+    int dmaBufFd;
   };
 
   int _iFrameBufferCount;
   QVector<WebcamBuffer*> _vecBuffers;
   QVector<v4l2_buffer> _vecReservedBuffers;
   QVector<void*> _vecBufferPointers;
+  // The v4l buffer index and the number of valid bytes of each frame
+  // in the ring.
+  QVector<int> _vecBufferIndices, _vecFrameDataSizes;
+  // Leased frames must be released before their buffers are given
+  // back to v4l.
+  LeaseCounter _leases;
+  // Buffer statistics
+  PiiAtomicInt _iGrabbedBuffers, _iMinQueuedBuffers, _iCapturedFrames;
 
   QThread *_pCaptureThread;
   QMutex _captureMutex;
@@ -17,6 +17,7 @@
 #define _PIIABSDIFFDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Calculates the sum of absolute differences between corresponding
@@ -24,13 +25,28 @@
  * *S* and *M* represent the sample and model distributions,
  * respectively.
  *
+ * The distance can be bounded (see PiiBoundedDistance). `float` and
+ * `double` features are processed with SIMD instructions if the CPU
+ * supports them.
  */
-PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiAbsDiffDistance)
+PII_BOUNDED_DISTANCE_MEASURE_DEF(PiiAbsDiffDistance)
 {
   double distance = 0;
-  for (int i=0; i<length; ++i)
-    distance += Pii::abs(sample[i] - model[i]);
+  if (PiiDistanceKernel<FeatureIterator>::absDiff(sample, model, length, bound, &distance))
+    return distance;
+  enum { BlockSize = 64 };
+  for (int i=0; i<length && distance <= bound; i += BlockSize)
+    {
+      const int iEnd = qMin(i + int(BlockSize), length);
+      for (int j=i; j<iEnd; ++j)
+        distance += Pii::abs(sample[j] - model[j]);
+    }
   return distance;
 }
 
+template <class FeatureIterator> struct PiiDistanceForm<PiiAbsDiffDistance<FeatureIterator> >
+{
+  enum { value = PiiClassification::AbsoluteDifferenceSum };
+};
+
 #endif //_PIIABSDIFFDISTANCE_H
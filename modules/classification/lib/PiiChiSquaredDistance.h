@@ -17,6 +17,7 @@
 #define _PIICHISQUAREDDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Chi squared distance. The chi squared distance between two vectors
@@ -28,6 +29,8 @@
 PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiChiSquaredDistance)
 {
   double sum = 0.0, tmp;
+  if (PiiDistanceKernel<FeatureIterator>::chiSquared(sample, model, length, &sum))
+    return sum;
   for (int i=0; i<length; ++i)
     {
       tmp = double(sample[i] - model[i]);
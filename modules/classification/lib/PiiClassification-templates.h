@@ -106,25 +106,64 @@ namespace PiiClassification
   }
 
 
+  /// @internal
+  template <class FeatureIterator, class DistanceMeasure>
+  inline void measureDistances(FeatureIterator sample,
+                               const FeatureIterator* models,
+                               int modelCount,
+                               int length,
+                               const DistanceMeasure& measure,
+                               double bound,
+                               double* distances)
+  {
+    for (int i=0; i<modelCount; ++i)
+      distances[i] = PiiBoundedDistance<DistanceMeasure>::measure(measure, sample, models[i], length, bound);
+  }
+
+  /// @internal
+  template <class FeatureIterator>
+  inline void measureDistances(FeatureIterator sample,
+                               const FeatureIterator* models,
+                               int modelCount,
+                               int length,
+                               const PiiDistanceMeasure<FeatureIterator>& measure,
+                               double bound,
+                               double* distances)
+  {
+    // One virtual call per block instead of one per model.
+    measure.distances(sample, models, modelCount, length, bound, distances);
+  }
+
   template <class SampleSet, class DistanceMeasure>
   int findClosestMatch(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
                        const SampleSet& modelSet,
                        const DistanceMeasure& measure,
                        double* distance)
   {
+    typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
     const int iModels = PiiSampleSet::sampleCount(modelSet),
       iFeatures = PiiSampleSet::featureCount(modelSet);
 
+    enum { BlockSize = 16 };
+    ConstFeatureIterator aModels[BlockSize];
+    double aDistances[BlockSize];
+
     double dMinDistance = INFINITY;
     int minIndex = -1;
-    for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
+    for (int iStart = 0; iStart < iModels; iStart += BlockSize)
       {
-        double d = measure(sample, modelSet[modelIndex], iFeatures);
-        if (d < dMinDistance)
-          {
-            minIndex = modelIndex;
-            dMinDistance = d;
-          }
+        const int iCount = qMin(int(BlockSize), iModels - iStart);
+        for (int i=0; i<iCount; ++i)
+          aModels[i] = PiiSampleSet::sampleAt(modelSet, iStart + i);
+        // Models farther than the current best can't win, and their
+        // distances need not be calculated exactly.
+        measureDistances(sample, aModels, iCount, iFeatures, measure, dMinDistance, aDistances);
+        for (int i=0; i<iCount; ++i)
+          if (aDistances[i] < dMinDistance)
+            {
+              minIndex = iStart + i;
+              dMinDistance = aDistances[i];
+            }
       }
     if (distance != 0)
       *distance = dMinDistance;
@@ -137,14 +176,30 @@ namespace PiiClassification
                                const DistanceMeasure& measure,
                                int n)
   {
+    typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
     const int iModels = PiiSampleSet::sampleCount(modelSet),
       iFeatures = PiiSampleSet::featureCount(modelSet);
     MatchList heap;
     heap.fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
+    if (heap.size() == 0)
+      return heap;
+
+    enum { BlockSize = 16 };
+    ConstFeatureIterator aModels[BlockSize];
+    double aDistances[BlockSize];
+
     // Heap ensures that only shortest distances will be preserved
-    for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
-      heap.put(qMakePair(measure(sample, PiiSampleSet::sampleAt(modelSet, modelIndex), iFeatures),
-                         modelIndex));
+    for (int iStart = 0; iStart < iModels; iStart += BlockSize)
+      {
+        const int iCount = qMin(int(BlockSize), iModels - iStart);
+        for (int i=0; i<iCount; ++i)
+          aModels[i] = PiiSampleSet::sampleAt(modelSet, iStart + i);
+        // The top of the heap is the farthest of the n closest
+        // matches found so far.
+        measureDistances(sample, aModels, iCount, iFeatures, measure, heap[0].first, aDistances);
+        for (int i=0; i<iCount; ++i)
+          heap.put(qMakePair(aDistances[i], iStart + i));
+      }
     // Ascending order -> first is the best match
     heap.sort();
     return heap;
@@ -159,40 +214,7 @@ namespace PiiClassification
                      double* distance,
                      int* closestIndex)
   {
-    MatchList lstClosest = findClosestMatches(sample, modelSet, measure, k);
-    // May be smaller than original if we have less samples in the
-    // model set.
-    k = lstClosest.size();
-
-    if (k == 0) // empty set
-      return NAN;
-    PiiSmartPtr<double[]> pClosestLabels = new double[k];
-
-    int iMaxMatches = 0, iBestLabel = -1;
-
-    // Store class labels corresponding to the closest samples.
-    for (int i=0; i<k; ++i)
-      pClosestLabels[i] = labels[lstClosest[i].second];
-    // Find the class label with the most occurrences.
-    for (int i=0; i<k; ++i)
-      {
-        double label = pClosestLabels[i];
-        int iMatchCnt = 1;
-        for (int j=i+1; j<k; ++j)
-          if (label == pClosestLabels[j])
-            ++iMatchCnt;
-        // Nearest wins if the number of votes is equal.
-        if (iMatchCnt > iMaxMatches)
-          {
-            iMaxMatches = iMatchCnt;
-            iBestLabel = i;
-          }
-      }
-    if (distance != 0)
-      *distance = lstClosest[iBestLabel].first;
-    if (closestIndex != 0)
-      *closestIndex = lstClosest[iBestLabel].second;
-    return pClosestLabels[iBestLabel];
+    return knnVote(findClosestMatches(sample, modelSet, measure, k), labels, distance, closestIndex);
   }
 
   template <class FeatureIterator, class ConstFeatureIterator>
@@ -98,6 +98,45 @@ namespace PiiClassification
     return lstResult;
   }
 
+  double knnVote(const MatchList& closestMatches,
+                 const QVector<double>& labels,
+                 double* distance,
+                 int* closestIndex)
+  {
+    // May be smaller than k if we have less samples in the model set.
+    const int k = closestMatches.size();
+
+    if (k == 0) // empty set
+      return NAN;
+    PiiSmartPtr<double[]> pClosestLabels = new double[k];
+
+    int iMaxMatches = 0, iBestLabel = -1;
+
+    // Store class labels corresponding to the closest samples.
+    for (int i=0; i<k; ++i)
+      pClosestLabels[i] = labels[closestMatches[i].second];
+    // Find the class label with the most occurrences.
+    for (int i=0; i<k; ++i)
+      {
+        double label = pClosestLabels[i];
+        int iMatchCnt = 1;
+        for (int j=i+1; j<k; ++j)
+          if (label == pClosestLabels[j])
+            ++iMatchCnt;
+        // Nearest wins if the number of votes is equal.
+        if (iMatchCnt > iMaxMatches)
+          {
+            iMaxMatches = iMatchCnt;
+            iBestLabel = i;
+          }
+      }
+    if (distance != 0)
+      *distance = closestMatches[iBestLabel].first;
+    if (closestIndex != 0)
+      *closestIndex = closestMatches[iBestLabel].second;
+    return pClosestLabels[iBestLabel];
+  }
+
   QVector<int> countLabelsInt(const QVector<double>& labels)
   {
     int iMaxLabel = int(Pii::maxIn(labels.begin(), labels.end()));
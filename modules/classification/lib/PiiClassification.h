@@ -261,6 +261,33 @@ namespace PiiClassification
                      double* distance = 0,
                      int* closestIndex = 0);
 
+  /**
+   * Selects a class label by voting among the given closest matches.
+   * This is the voting step of [knnClassify()], separated for use
+   * with other nearest neighbor search methods, such as
+   * PiiHnswIndex.
+   *
+   * @param closestMatches the closest matches in ascending order of
+   * distance, as returned by [findClosestMatches()].
+   *
+   * @param labels a label for each sample in the model set.
+   *
+   * @param distance an optional output value that, if non-zero, will
+   * store the distance to the closest sample representing the winning
+   * class.
+   *
+   * @param closestIndex an optional output value that, if non-zero,
+   * will store the index of the closest model sample of the winning
+   * class.
+   *
+   * @return the class label with the most representatives among
+   * *closestMatches*, or `NaN` if the list is empty.
+   */
+  double PII_CLASSIFICATION_EXPORT knnVote(const MatchList& closestMatches,
+                                           const QVector<double>& labels,
+                                           double* distance = 0,
+                                           int* closestIndex = 0);
+
   /**
    * Adapt a *code* vector towards *sample* with the given strength
    * *alpha*. The code vector will be modified in place. The function
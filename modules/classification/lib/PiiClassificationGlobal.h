@@ -49,7 +49,8 @@ namespace PiiClassification
           SomRateFunction
           SomNeighborhood
           SomInitMode
-          SomLearningAlgorithm);
+          SomLearningAlgorithm
+          ModelPrecision);
   Q_FLAGS(LearnerCapability LearnerCapabilities);
 public:
 #endif
@@ -231,8 +232,47 @@ public:
    * quantization error. This algorithm is the most "elastic" of the
    * three. It tries to cover the whole input space independent of
    * data density.
+   *
+   * - `SomBatchAlgorithm` - a mini-batch variant of the sequential
+   * algorithm. The closest code vectors of a batch of samples are
+   * found concurrently, and each code vector is then moved towards
+   * the neighborhood-weighted mean of the samples in one step. The
+   * learning rate and radius decrease as in the sequential
+   * algorithm. With a batch size of one, the algorithm is equivalent
+   * to `SomSequentialAlgorithm`.
+   */
+  enum SomLearningAlgorithm { SomSequentialAlgorithm, SomBalancedAlgorithm, SomQErrAlgorithm, SomBatchAlgorithm };
+
+  /**
+   * Storage formats for model samples. See PiiQuantizedModelSet.
+   *
+   * - `FullPrecision` - the models are stored as such.
+   *
+   * - `Float16Precision` - each feature is scaled to [-1, 1] and
+   * stored as a 16-bit half-precision number.
+   *
+   * - `Int8Precision` - each feature is scaled to [0, 255] and
+   * rounded to an 8-bit unsigned integer.
+   */
+  enum ModelPrecision { FullPrecision, Float16Precision, Int8Precision };
+
+  /**
+   * Ways a distance measure combines the differences of
+   * corresponding features. See PiiDistanceForm.
+   *
+   * - `GenericDistance` - the distance is an arbitrary function of
+   * the two feature vectors.
+   *
+   * - `SquaredDifferenceSum` - the distance is the sum of squared
+   * feature differences.
+   *
+   * - `SquaredDifferenceSumRoot` - the distance is the square root
+   * of the sum of squared feature differences.
+   *
+   * - `AbsoluteDifferenceSum` - the distance is the sum of absolute
+   * feature differences.
    */
-  enum SomLearningAlgorithm { SomSequentialAlgorithm, SomBalancedAlgorithm, SomQErrAlgorithm };
+  enum DistanceForm { GenericDistance, SquaredDifferenceSum, SquaredDifferenceSumRoot, AbsoluteDifferenceSum };
 };
 
 #endif //_PIICLASSIFICATIONGLOBAL_H
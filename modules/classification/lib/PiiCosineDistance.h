@@ -17,6 +17,7 @@
 #define _PIICOSINEDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Cosine distance calculates the cosine of the angle between feature
@@ -26,6 +27,8 @@
 PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiCosineDistance)
 {
   double sum = 0.0, len1 = 0.0, len2 = 0.0, tmp1, tmp2;
+  if (PiiDistanceKernel<FeatureIterator>::cosine(sample, model, length, &sum))
+    return sum;
   for (int i=0; i<length; ++i)
     {
       tmp1 = double(sample[i]);
@@ -61,68 +61,248 @@ double PiiDecisionStump<SampleSet>::optimizeSplit(const QVector<double>& leftWei
 }
 
 
+template <class SampleSet> class PiiDecisionStump<SampleSet>::Index::SortFunction
+{
+public:
+  typedef QPair<FeatureType,int> Entry;
+
+  SortFunction(Index* index) :
+    _pIndex(index),
+    _pOrder(index->_vecOrder.data()),
+    _pSortedValues(index->_vecSortedValues.data()),
+    _pBins(index->_vecBins.data()),
+    _pBinCounts(index->_vecBinCounts.data()),
+    _pBinLimits(index->_vecBinLimits.data())
+  {}
+
+  void operator() (int firstFeature, int endFeature)
+  {
+    const int iSamples = _pIndex->_iSampleCount, iBins = _pIndex->_iBinCount;
+    QVector<Entry> vecEntries(iSamples);
+    for (int f=firstFeature; f<endFeature; ++f)
+      {
+        for (int i=0; i<iSamples; ++i)
+          vecEntries[i] = Entry(PiiSampleSet::sampleAt(_pIndex->_samples, i)[f], i);
+        // Equal values retain their original order.
+        std::sort(vecEntries.begin(), vecEntries.end());
+
+        const qint64 iOffset = qint64(f) * iSamples;
+        if (iBins == 0)
+          {
+            for (int i=0; i<iSamples; ++i)
+              {
+                _pSortedValues[iOffset + i] = vecEntries[i].first;
+                _pOrder[iOffset + i] = vecEntries[i].second;
+              }
+            continue;
+          }
+
+        // Start a new bin once the current one is full, but never
+        // between equal values. Thresholds are placed at the largest
+        // value of each bin.
+        FeatureType* pLimits = _pBinLimits + qint64(f) * iBins;
+        const int iBinSize = (iSamples + iBins - 1) / iBins;
+        int iBin = 0, iBinStart = 0;
+        for (int i=0; i<iSamples; ++i)
+          {
+            if (i - iBinStart >= iBinSize && iBin < iBins-1 &&
+                vecEntries[i-1].first < vecEntries[i].first)
+              {
+                pLimits[iBin++] = vecEntries[i-1].first;
+                iBinStart = i;
+              }
+            _pBins[iOffset + vecEntries[i].second] = (unsigned short)iBin;
+          }
+        pLimits[iBin] = vecEntries[iSamples-1].first;
+        _pBinCounts[f] = iBin + 1;
+      }
+  }
+
+private:
+  const Index* _pIndex;
+  int* _pOrder;
+  FeatureType* _pSortedValues;
+  unsigned short* _pBins;
+  int* _pBinCounts;
+  FeatureType* _pBinLimits;
+};
+
+template <class SampleSet> PiiDecisionStump<SampleSet>::Index::Index() :
+  _iSampleCount(0),
+  _iFeatureCount(0),
+  _iBinCount(0)
+{}
+
+template <class SampleSet> PiiDecisionStump<SampleSet>::Index::Index(const SampleSet& samples,
+                                                                     int binCount,
+                                                                     const PiiParallelPolicy& policy) :
+  _samples(samples),
+  _iSampleCount(PiiSampleSet::sampleCount(samples)),
+  _iFeatureCount(PiiSampleSet::featureCount(samples)),
+  _iBinCount(qBound(0, binCount, 65536))
+{
+  if (_iSampleCount == 0)
+    {
+      _iFeatureCount = 0;
+      return;
+    }
+  const qint64 iSize = qint64(_iSampleCount) * _iFeatureCount;
+  if (_iBinCount > 0)
+    {
+      _vecBins.resize(iSize);
+      _vecBinCounts.resize(_iFeatureCount);
+      _vecBinLimits.resize(_iFeatureCount * _iBinCount);
+    }
+  else
+    {
+      _vecOrder.resize(iSize);
+      _vecSortedValues.resize(iSize);
+    }
+  SortFunction sorter(this);
+  Pii::forEachStrip(_iFeatureCount, sorter, policy);
+}
+
+/*
+ * Finds the best split for a range of features. Each feature is
+ * scanned in ascending order, accumulating the weights on the left
+ * side of the threshold. Without bins, a threshold is tried after
+ * each distinct value; with bins, after each bin.
+ */
+template <class SampleSet> class PiiDecisionStump<SampleSet>::SplitFunction
+{
+public:
+  SplitFunction(const Index& index,
+                const int* labels,
+                const double* weights,
+                const QVector<double>& weightTotals,
+                double weightSum,
+                Split* splits) :
+    _index(index), _pLabels(labels), _pWeights(weights),
+    _weightTotals(weightTotals), _dWeightSum(weightSum), _pSplits(splits)
+  {}
+
+  void operator() (int firstFeature, int endFeature)
+  {
+    const int iSamples = _index._iSampleCount, iLabels = _weightTotals.size();
+    QVector<double> vecLeftWeights(iLabels);
+    QVector<double> vecHistogram(_index._iBinCount * iLabels);
+    for (int f=firstFeature; f<endFeature; ++f)
+      {
+        Split& split = _pSplits[f];
+        const qint64 iOffset = qint64(f) * iSamples;
+        vecLeftWeights.fill(0);
+        if (_index._iBinCount == 0)
+          {
+            const int* pOrder = _index._vecOrder.constData() + iOffset;
+            const FeatureType* pValues = _index._vecSortedValues.constData() + iOffset;
+            for (int i=0; i<iSamples; ++i)
+              {
+                vecLeftWeights[_pLabels[pOrder[i]]] += _pWeights[pOrder[i]];
+                // All equal values must go to the same side.
+                if (i < iSamples-1 && pValues[i+1] == pValues[i])
+                  continue;
+                tryThreshold(split, vecLeftWeights, pValues[i]);
+              }
+          }
+        else
+          {
+            const unsigned short* pBins = _index._vecBins.constData() + iOffset;
+            const FeatureType* pLimits = _index._vecBinLimits.constData() + qint64(f) * _index._iBinCount;
+            const int iBins = _index._vecBinCounts[f];
+            double* pHistogram = vecHistogram.data();
+            Pii::fillN(pHistogram, iBins * iLabels, 0.0);
+            for (int i=0; i<iSamples; ++i)
+              pHistogram[pBins[i] * iLabels + _pLabels[i]] += _pWeights[i];
+            for (int b=0; b<iBins; ++b, pHistogram += iLabels)
+              {
+                for (int l=0; l<iLabels; ++l)
+                  vecLeftWeights[l] += pHistogram[l];
+                tryThreshold(split, vecLeftWeights, pLimits[b]);
+              }
+          }
+      }
+  }
+
+private:
+  void tryThreshold(Split& split, const QVector<double>& leftWeights, FeatureType threshold)
+  {
+    int iLeftLabel = 0, iRightLabel = 0;
+    const double dError = optimizeSplit(leftWeights, _weightTotals, _dWeightSum,
+                                        &iLeftLabel, &iRightLabel);
+    if (dError < split.dError)
+      {
+        split.dError = dError;
+        split.threshold = threshold;
+        split.iLeftLabel = iLeftLabel;
+        split.iRightLabel = iRightLabel;
+      }
+  }
+
+  const Index& _index;
+  const int* _pLabels;
+  const double* _pWeights;
+  const QVector<double>& _weightTotals;
+  const double _dWeightSum;
+  Split* _pSplits;
+};
+
 template <class SampleSet>
 void PiiDecisionStump<SampleSet>::learn(const SampleSet& samples,
                                         const QVector<double>& labels,
                                         const QVector<double>& weights)
+{
+  learn(Index(samples), labels, weights);
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::learn(const Index& index,
+                                        const QVector<double>& labels,
+                                        const QVector<double>& weights,
+                                        const PiiParallelPolicy& policy)
 {
   PII_D;
   d->iSelectedFeature = 0;
   d->threshold = 0;
   d->dLeftLabel = d->dRightLabel = NAN;
 
-  const int iSamples = PiiSampleSet::sampleCount(samples),
-    iFeatures = PiiSampleSet::featureCount(samples);
+  const int iSamples = index._iSampleCount,
+    iFeatures = index._iFeatureCount;
+  if (iSamples == 0)
+    return;
 
   const QVector<double> vecWeights(weights.size() == iSamples ?
                                    weights : QVector<double>(iSamples, 1.0/iSamples));
 
-
   double dWeightSum = 0;
   // Calculate the sum of weights for each class separately
   QVector<double> vecWeightTotals;
+  QVector<int> vecLabels(iSamples);
   for (int i=0; i<iSamples; ++i)
     {
       int iLabel = int(labels[i]);
       if (iLabel >= vecWeightTotals.size())
         vecWeightTotals.resize(iLabel+1);
-      vecWeightTotals[iLabel] += weights[i];
-      dWeightSum += weights[i];
+      vecLabels[i] = iLabel;
+      vecWeightTotals[iLabel] += vecWeights[i];
+      dWeightSum += vecWeights[i];
     }
 
-  QVector<Feature> vecFeatures(iSamples);
-  QVector<double> vecLeftWeights(vecWeightTotals.size());
+  QVector<Split> vecSplits(iFeatures);
+  SplitFunction splitter(index, vecLabels.constData(), vecWeights.constData(),
+                         vecWeightTotals, dWeightSum, vecSplits.data());
+  Pii::forEachStrip(iFeatures, splitter, policy);
 
+  // The first feature wins ties, as in a sequential search.
   double dMinError = INFINITY;
-
-  // For each feature
   for (int f=0; f<iFeatures; ++f)
     {
-      for (int i=0; i<iSamples; ++i)
-        vecFeatures[i] = Feature(PiiSampleSet::sampleAt(samples,i)[f], int(labels[i]), weights[i]);
-
-      // Sort according to the feature value
-      qSort(vecFeatures);
-      vecLeftWeights.fill(0);
-
-      // Calculate classification error for each threshold.
-      for (int i=0; i<iSamples; i++)
+      if (vecSplits[f].dError < dMinError)
         {
-          vecLeftWeights[vecFeatures[i].iLabel] += vecFeatures[i].dWeight;
-
-          int iLeftLabel = 0, iRightLabel = 0;
-          double dError = optimizeSplit(vecLeftWeights, vecWeightTotals,
-                                        dWeightSum,
-                                        &iLeftLabel, &iRightLabel);
-
-          if (dError < dMinError)
-            {
-              dMinError = dError;
-              d->dLeftLabel = iLeftLabel;
-              d->dRightLabel = iRightLabel;
-              d->iSelectedFeature = f;
-              d->threshold = vecFeatures[i].value;
-            }
+          dMinError = vecSplits[f].dError;
+          d->dLeftLabel = vecSplits[f].iLeftLabel;
+          d->dRightLabel = vecSplits[f].iRightLabel;
+          d->iSelectedFeature = f;
+          d->threshold = vecSplits[f].threshold;
         }
     }
 
@@ -135,7 +315,7 @@ template <class SampleSet> double PiiDecisionStump<SampleSet>::classify(ConstFea
   return sample[d->iSelectedFeature] <= d->threshold ? d->dLeftLabel : d->dRightLabel;
 }
 
-template <class SampleSet> void PiiDecisionStump<SampleSet>::setSelectedFeature(int feature) { return _d()->iSelectedFeature = feature; }
+template <class SampleSet> void PiiDecisionStump<SampleSet>::setSelectedFeature(int feature) { _d()->iSelectedFeature = feature; }
 template <class SampleSet> int PiiDecisionStump<SampleSet>::selectedFeature() const { return _d()->iSelectedFeature; }
 template <class SampleSet> void PiiDecisionStump<SampleSet>::setThreshold(FeatureType threshold) { _d()->threshold = threshold; }
 template <class SampleSet> typename PiiDecisionStump<SampleSet>::FeatureType PiiDecisionStump<SampleSet>::threshold() const { return _d()->threshold; }
@@ -20,6 +20,7 @@
 #include "PiiClassifier.h"
 
 #include <PiiSerializationTraits.h>
+#include <PiiParallel.h>
 
 /**
  * A primitive learner that works by thresholding a single feature. A
@@ -33,6 +34,12 @@
  * stump that selects not only the optimal threshold but also two
  * classes that are optimally separated by the threshold.
  *
+ * Finding the optimal split requires the samples to be sorted on each
+ * feature. In boosting, the same samples are used in each round with
+ * different weights. PiiDecisionStump::Index stores the sort order so
+ * that it only needs to be computed once (see
+ * PiiDecisionStumpFactory).
+ *
  */
 template <class SampleSet> class PiiDecisionStump :
   public PiiClassifier<SampleSet>,
@@ -42,6 +49,64 @@ public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
   typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
 
+  /**
+   * The samples of a training set sorted on each feature. If the
+   * index is *binned*, the distinct values of each feature are
+   * grouped into bins with roughly equal numbers of samples, and
+   * thresholds are only searched at bin boundaries. Each learning
+   * round then needs only one pass over the samples to collect the
+   * weights into the bins, and the search time per feature no longer
+   * depends on the number of samples. Binning may make the optimal
+   * split slightly worse, but a few hundred bins are usually enough.
+   */
+  class Index
+  {
+  public:
+    /**
+     * Constructs an empty index.
+     */
+    Index();
+    /**
+     * Sorts *samples* on each feature. If *binCount* is positive, at
+     * most *binCount* (maximum 65536) bins are created for each
+     * feature. The features are processed in parallel according to
+     * *policy*.
+     */
+    Index(const SampleSet& samples,
+          int binCount = 0,
+          const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
+    /**
+     * Returns the indexed samples.
+     */
+    SampleSet samples() const { return _samples; }
+    /**
+     * Returns `true` if the index contains no samples.
+     */
+    bool isEmpty() const { return _iSampleCount == 0; }
+    /**
+     * Returns the maximum number of bins per feature, or zero if the
+     * index is not binned.
+     */
+    int binCount() const { return _iBinCount; }
+
+  private:
+    friend class PiiDecisionStump;
+    class SortFunction;
+
+    SampleSet _samples;
+    int _iSampleCount, _iFeatureCount, _iBinCount;
+    // Feature-major arrays. Without bins, sample indices in the
+    // ascending order of each feature and the sorted values.
+    QVector<int> _vecOrder;
+    QVector<FeatureType> _vecSortedValues;
+    // With bins, the bin of each sample on each feature, the number
+    // of bins for each feature and the largest value in each bin.
+    QVector<unsigned short> _vecBins;
+    QVector<int> _vecBinCounts;
+    QVector<FeatureType> _vecBinLimits;
+  };
+
   PiiDecisionStump();
 
   /**
@@ -52,6 +117,27 @@ public:
              const QVector<double>& labels,
              const QVector<double>& weights);
 
+  /**
+   * Finds the optimal split using a precomputed *index*. The
+   * features are evaluated in parallel according to *policy*. The
+   * result doesn't depend on the number of threads. If *index* is
+   * not binned, the result is the same as that of learning directly
+   * from the samples.
+   *
+   * @param index sorted training samples
+   *
+   * @param labels a class label for each sample in the index
+   *
+   * @param weights a weight for each sample. If empty, uniform
+   * weights will be used.
+   *
+   * @param policy the parallel execution policy
+   */
+  void learn(const Index& index,
+             const QVector<double>& labels,
+             const QVector<double>& weights,
+             const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
   /**
    * Returns [leftLabel()] if the [selectedFeature()] "selected
    * feature" is less than or equal to [threshold()] and [rightLabel()]
@@ -92,18 +178,15 @@ public:
 
 private:
   /// @internal
-  struct Feature
+  struct Split
   {
-    Feature() : value(0), iLabel(0), dWeight(0) {}
-    Feature(FeatureType v, int l, double w) : value(v), iLabel(l), dWeight(w) {}
-
-    FeatureType value;
-    int iLabel;
-    double dWeight;
+    Split() : dError(INFINITY), threshold(0), iLeftLabel(0), iRightLabel(0) {}
 
-    bool operator< (const Feature& other) const { return value < other.value; }
-    bool operator> (const Feature& other) const { return value > other.value; }
+    double dError;
+    FeatureType threshold;
+    int iLeftLabel, iRightLabel;
   };
+  class SplitFunction;
 
   /// @internal
   class Data : public PiiLearningAlgorithm<SampleSet>::Data
@@ -117,10 +200,10 @@ private:
   };
   PII_D_FUNC;
 
-  double optimizeSplit(const QVector<double>& leftWeights,
-                       const QVector<double>& weightTotals,
-                       double totalWeightSum,
-                       int* leftLabel, int* rightLabel);
+  static double optimizeSplit(const QVector<double>& leftWeights,
+                              const QVector<double>& weightTotals,
+                              double totalWeightSum,
+                              int* leftLabel, int* rightLabel);
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
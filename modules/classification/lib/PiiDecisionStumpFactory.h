@@ -0,0 +1,123 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDECISIONSTUMPFACTORY_H
+#define _PIIDECISIONSTUMPFACTORY_H
+
+#include "PiiBoostClassifier.h"
+#include "PiiDecisionStump.h"
+
+/**
+ * A PiiBoostClassifier::Factory that creates decision stumps. Unlike
+ * PiiDefaultClassifierFactory, this factory sorts the training
+ * samples only once and reuses the sort order in all boosting rounds.
+ * The index is rebuilt whenever the factory is given a different
+ * sample set. Optionally, feature values can be binned and the
+ * features evaluated in parallel.
+ *
+ * ~~~(c++)
+ * PiiDecisionStumpFactory<PiiMatrix<double> > factory;
+ * factory.setBinCount(256);
+ * factory.setThreadCount(0);
+ * PiiBoostClassifier<PiiMatrix<double> > classifier(&factory);
+ * classifier.learn(samples, labels);
+ * ~~~
+ *
+ * @see PiiDecisionStump::Index
+ */
+template <class SampleSet> class PiiDecisionStumpFactory :
+  public PiiBoostClassifier<SampleSet>::Factory
+{
+public:
+  typedef PiiDecisionStump<SampleSet> Classifier;
+
+  PiiDecisionStumpFactory() :
+    _iBinCount(0),
+    _iThreadCount(1)
+  {}
+
+  /**
+   * Creates a new decision stump and trains it using the given
+   * *samples*, *labels*, and *weights*.
+   */
+  Classifier* create(PiiBoostClassifier<SampleSet>* classifier,
+                     const SampleSet& samples,
+                     const QVector<double>& labels,
+                     const QVector<double>& weights);
+
+  /**
+   * Sets the maximum number of bins for each feature. Zero means that
+   * all distinct feature values will be tried as thresholds. The
+   * default is zero. See PiiDecisionStump::Index.
+   */
+  void setBinCount(int binCount) { _iBinCount = qBound(0, binCount, 65536); }
+  int binCount() const { return _iBinCount; }
+
+  /**
+   * Sets the maximum number of threads used in sorting the samples
+   * and in finding the optimal split. Zero means the ideal thread
+   * count. The default is one.
+   */
+  void setThreadCount(int threadCount) { _iThreadCount = qMax(0, threadCount); }
+  int threadCount() const { return _iThreadCount; }
+
+  /**
+   * Releases the memory reserved by the sort order of the previous
+   * sample set.
+   */
+  void clearIndex() { _index = typename Classifier::Index(); }
+
+private:
+  bool isIndexed(const SampleSet& samples) const;
+
+  int _iBinCount, _iThreadCount;
+  typename Classifier::Index _index;
+};
+
+template <class SampleSet>
+bool PiiDecisionStumpFactory<SampleSet>::isIndexed(const SampleSet& samples) const
+{
+  if (_index.isEmpty() || _index.binCount() != _iBinCount)
+    return false;
+  // The index holds a reference to the samples. If the data has been
+  // modified since, or if this is another sample set, the samples
+  // are in a different memory location.
+  const SampleSet indexedSamples(_index.samples());
+  return PiiSampleSet::sampleCount(indexedSamples) == PiiSampleSet::sampleCount(samples) &&
+    PiiSampleSet::featureCount(indexedSamples) == PiiSampleSet::featureCount(samples) &&
+    PiiSampleSet::sampleAt(indexedSamples, 0) == PiiSampleSet::sampleAt(samples, 0);
+}
+
+template <class SampleSet>
+PiiDecisionStump<SampleSet>* PiiDecisionStumpFactory<SampleSet>::create(PiiBoostClassifier<SampleSet>* classifier,
+                                                                        const SampleSet& samples,
+                                                                        const QVector<double>& labels,
+                                                                        const QVector<double>& weights)
+{
+  Q_UNUSED(classifier);
+  // Each feature is a unit of work.
+  const PiiParallelPolicy policy(_iThreadCount, 1);
+  if (!isIndexed(samples))
+    {
+      // Release the old index first.
+      _index = typename Classifier::Index();
+      _index = typename Classifier::Index(samples, _iBinCount, policy);
+    }
+  Classifier* pClassifier = new Classifier;
+  pClassifier->learn(_index, labels, weights, policy);
+  return pClassifier;
+}
+
+#endif //_PIIDECISIONSTUMPFACTORY_H
@@ -0,0 +1,674 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiDistanceKernels.h"
+
+#include <PiiCpu.h>
+#include <cmath>
+#include <cstring>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_DISTANCE_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_DISTANCE_AVX2 1
+#  endif
+#elif defined(PII_NEON) && defined(__aarch64__)
+// Double-precision vectors are not available on 32-bit ARM.
+#  include <arm_neon.h>
+#  define PII_DISTANCE_NEON 1
+#endif
+
+namespace
+{
+  // The bound is checked after each block of this many features.
+  enum { BoundBlockSize = 64 };
+
+  template <class T> inline T absolute(T value) { return value < 0 ? -value : value; }
+  template <class T> inline T minimum(T a, T b) { return b < a ? b : a; }
+
+  /* Scalar versions for the features that don't fill a whole vector.
+     They are identical to the scalar distance measures.
+   */
+  template <class T> double squaredGeometricTail(const T* a, const T* b, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      {
+        const double dDiff = double(a[i] - b[i]);
+        dSum += dDiff * dDiff;
+      }
+    return dSum;
+  }
+
+  template <class T> double absDiffTail(const T* a, const T* b, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      dSum += double(absolute(a[i] - b[i]));
+    return dSum;
+  }
+
+  template <class T> double chiSquaredTail(const T* a, const T* b, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      {
+        const double dDiff = double(a[i] - b[i]);
+        dSum += dDiff * dDiff / double(a[i] + b[i]);
+      }
+    return dSum;
+  }
+
+  template <class T> double histogramIntersectionTail(const T* a, const T* b, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      dSum += double(minimum(a[i], b[i]));
+    return dSum;
+  }
+
+  template <class T> void cosineTail(const T* a, const T* b, int i, int length,
+                                     double* product, double* squares1, double* squares2)
+  {
+    for (; i<length; ++i)
+      {
+        const double dA = double(a[i]), dB = double(b[i]);
+        *product += dA * dB;
+        *squares1 += dA * dA;
+        *squares2 += dB * dB;
+      }
+  }
+
+  /* Scalar versions of the quantized distances. The sample and the
+     weights are always floats. The codes are either bytes or floats.
+   */
+  template <class Code> double squaredDifferenceTail(const float* sample, const float* weights,
+                                                     const Code* codes, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      {
+        const double dDiff = double(sample[i] - float(codes[i]));
+        dSum += double(weights[i]) * dDiff * dDiff;
+      }
+    return dSum;
+  }
+
+  template <class Code> double absDifferenceTail(const float* sample, const float* weights,
+                                                 const Code* codes, int i, int length)
+  {
+    double dSum = 0;
+    for (; i<length; ++i)
+      dSum += double(weights[i]) * double(absolute(sample[i] - float(codes[i])));
+    return dSum;
+  }
+
+  template <class Code> double squaredDifferenceScalar(const float* sample, const float* weights,
+                                                       const Code* codes, int length, double bound)
+  {
+    double dSum = 0;
+    for (int i=0; i<length && dSum <= bound; i += BoundBlockSize)
+      dSum += squaredDifferenceTail(sample, weights, codes, i, minimum(i + int(BoundBlockSize), length));
+    return dSum;
+  }
+
+  template <class Code> double absDifferenceScalar(const float* sample, const float* weights,
+                                                   const Code* codes, int length, double bound)
+  {
+    double dSum = 0;
+    for (int i=0; i<length && dSum <= bound; i += BoundBlockSize)
+      dSum += absDifferenceTail(sample, weights, codes, i, minimum(i + int(BoundBlockSize), length));
+    return dSum;
+  }
+
+  // Counts the ones in a 64-bit word by summing up bit fields of
+  // increasing width.
+  inline int countOnes64(unsigned long long x)
+  {
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return int((x * 0x0101010101010101ULL) >> 56);
+  }
+
+  /* Scalar Hamming distance from byte i on. Eight bytes are compared
+     at once as long as possible.
+   */
+  int hammingTail(const unsigned char* a, const unsigned char* b, int i, int length)
+  {
+    int iSum = 0;
+    for (; i <= length - 8; i += 8)
+      {
+        unsigned long long ullA, ullB;
+        std::memcpy(&ullA, a + i, 8);
+        std::memcpy(&ullB, b + i, 8);
+        iSum += countOnes64(ullA ^ ullB);
+      }
+    for (; i<length; ++i)
+      iSum += countOnes64(a[i] ^ b[i]);
+    return iSum;
+  }
+
+  bool isVectorized()
+  {
+#if defined(PII_DISTANCE_SSE2)
+    return Pii::hasCpuFeature(Pii::CpuSse2) || Pii::hasCpuFeature(Pii::CpuAvx2);
+#elif defined(PII_DISTANCE_NEON)
+    return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+    return false;
+#endif
+  }
+}
+
+/* Each Ops struct holds Width doubles in a vector. The binary
+   operations on two feature pointers first combine Width features in
+   the original type, like the scalar code does, and then convert the
+   results to double precision. The loops are stamped out with a
+   macro because all functions called from an AVX2 loop must have the
+   same target attribute.
+ */
+#define PII_DISTANCE_LOOPS(TARGET)                                      \
+  template <class T> TARGET double squaredGeometric(const T* a, const T* b, int length, double bound) \
+  {                                                                     \
+    double dSum = 0;                                                    \
+    int i = 0;                                                          \
+    while (i <= length - Ops::Width)                                    \
+      {                                                                 \
+        const int iEnd = (i + BoundBlockSize < length ? i + BoundBlockSize : length) - Ops::Width; \
+        Vec sum = Ops::zero();                                          \
+        for (; i <= iEnd; i += Ops::Width)                              \
+          {                                                             \
+            const Vec diff = Ops::difference(a + i, b + i);             \
+            sum = Ops::add(sum, Ops::mul(diff, diff));                  \
+          }                                                             \
+        dSum += Ops::total(sum);                                        \
+        if (dSum > bound)                                               \
+          return dSum;                                                  \
+      }                                                                 \
+    return dSum + squaredGeometricTail(a, b, i, length);                \
+  }                                                                     \
+                                                                        \
+  template <class T> TARGET double absDiff(const T* a, const T* b, int length, double bound) \
+  {                                                                     \
+    double dSum = 0;                                                    \
+    int i = 0;                                                          \
+    while (i <= length - Ops::Width)                                    \
+      {                                                                 \
+        const int iEnd = (i + BoundBlockSize < length ? i + BoundBlockSize : length) - Ops::Width; \
+        Vec sum = Ops::zero();                                          \
+        for (; i <= iEnd; i += Ops::Width)                              \
+          sum = Ops::add(sum, Ops::abs(Ops::difference(a + i, b + i))); \
+        dSum += Ops::total(sum);                                        \
+        if (dSum > bound)                                               \
+          return dSum;                                                  \
+      }                                                                 \
+    return dSum + absDiffTail(a, b, i, length);                         \
+  }                                                                     \
+                                                                        \
+  template <class T> TARGET double chiSquared(const T* a, const T* b, int length) \
+  {                                                                     \
+    Vec sum = Ops::zero();                                              \
+    int i = 0;                                                          \
+    for (; i <= length - Ops::Width; i += Ops::Width)                   \
+      {                                                                 \
+        const Vec diff = Ops::difference(a + i, b + i);                 \
+        sum = Ops::add(sum, Ops::div(Ops::mul(diff, diff), Ops::sum(a + i, b + i))); \
+      }                                                                 \
+    return Ops::total(sum) + chiSquaredTail(a, b, i, length);           \
+  }                                                                     \
+                                                                        \
+  template <class T> TARGET double histogramIntersection(const T* a, const T* b, int length) \
+  {                                                                     \
+    Vec sum = Ops::zero();                                              \
+    int i = 0;                                                          \
+    for (; i <= length - Ops::Width; i += Ops::Width)                   \
+      sum = Ops::add(sum, Ops::minimum(a + i, b + i));                  \
+    return -(Ops::total(sum) + histogramIntersectionTail(a, b, i, length)); \
+  }                                                                     \
+                                                                        \
+  template <class T> TARGET double cosine(const T* a, const T* b, int length) \
+  {                                                                     \
+    Vec product = Ops::zero(), squares1 = Ops::zero(), squares2 = Ops::zero(); \
+    int i = 0;                                                          \
+    for (; i <= length - Ops::Width; i += Ops::Width)                   \
+      {                                                                 \
+        const Vec va = Ops::load(a + i), vb = Ops::load(b + i);         \
+        product = Ops::add(product, Ops::mul(va, vb));                  \
+        squares1 = Ops::add(squares1, Ops::mul(va, va));                \
+        squares2 = Ops::add(squares2, Ops::mul(vb, vb));                \
+      }                                                                 \
+    double dProduct = Ops::total(product), dSquares1 = Ops::total(squares1), dSquares2 = Ops::total(squares2); \
+    cosineTail(a, b, i, length, &dProduct, &dSquares1, &dSquares2);     \
+    dSquares1 *= dSquares2;                                             \
+    if (dSquares1 != 0)                                                 \
+      return -dProduct / std::sqrt(dSquares1);                          \
+    return 0;                                                           \
+  }
+
+/* QOps holds Width floats in a vector. Quantized distances are
+   calculated in single precision, and only the block sums are
+   converted to double.
+ */
+#define PII_QUANTIZED_DISTANCE_LOOPS(TARGET)                            \
+  template <class Code> TARGET double squaredDifference(const float* s, const float* w, const Code* c, \
+                                                        int length, double bound) \
+  {                                                                     \
+    double dSum = 0;                                                    \
+    int i = 0;                                                          \
+    while (i <= length - QOps::Width)                                   \
+      {                                                                 \
+        const int iEnd = (i + BoundBlockSize < length ? i + BoundBlockSize : length) - QOps::Width; \
+        QVec sum = QOps::zero();                                        \
+        for (; i <= iEnd; i += QOps::Width)                             \
+          {                                                             \
+            const QVec diff = QOps::sub(QOps::load(s + i), QOps::load(c + i)); \
+            sum = QOps::add(sum, QOps::mul(QOps::load(w + i), QOps::mul(diff, diff))); \
+          }                                                             \
+        dSum += QOps::total(sum);                                       \
+        if (dSum > bound)                                               \
+          return dSum;                                                  \
+      }                                                                 \
+    return dSum + squaredDifferenceTail(s, w, c, i, length);            \
+  }                                                                     \
+                                                                        \
+  template <class Code> TARGET double absDifference(const float* s, const float* w, const Code* c, \
+                                                    int length, double bound) \
+  {                                                                     \
+    double dSum = 0;                                                    \
+    int i = 0;                                                          \
+    while (i <= length - QOps::Width)                                   \
+      {                                                                 \
+        const int iEnd = (i + BoundBlockSize < length ? i + BoundBlockSize : length) - QOps::Width; \
+        QVec sum = QOps::zero();                                        \
+        for (; i <= iEnd; i += QOps::Width)                             \
+          sum = QOps::add(sum, QOps::mul(QOps::load(w + i),             \
+                                         QOps::abs(QOps::sub(QOps::load(s + i), QOps::load(c + i))))); \
+        dSum += QOps::total(sum);                                       \
+        if (dSum > bound)                                               \
+          return dSum;                                                  \
+      }                                                                 \
+    return dSum + absDifferenceTail(s, w, c, i, length);                \
+  }
+
+/* HOps compares Width bytes at a time and sums the bit counts into
+   64-bit lanes. The sample pointer is the same for all models in
+   hammings().
+ */
+#define PII_HAMMING_LOOPS(TARGET)                                       \
+  TARGET int hamming(const unsigned char* a, const unsigned char* b, int length) \
+  {                                                                     \
+    HVec sum = HOps::zero();                                            \
+    int i = 0;                                                          \
+    for (; i <= length - HOps::Width; i += HOps::Width)                 \
+      sum = HOps::add(sum, HOps::count(a + i, b + i));                  \
+    return HOps::total(sum) + hammingTail(a, b, i, length);             \
+  }                                                                     \
+                                                                        \
+  TARGET void hammings(const unsigned char* sample, const unsigned char* const* models, \
+                       int count, int length, int* distances)           \
+  {                                                                     \
+    for (int i=0; i<count; ++i)                                         \
+      distances[i] = hamming(sample, models[i], length);                \
+  }
+
+#ifdef PII_DISTANCE_SSE2
+namespace Sse2
+{
+  struct Ops
+  {
+    enum { Width = 2 };
+    static inline __m128 loadPair(const float* p) { return _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p)); }
+
+    static inline __m128d zero() { return _mm_setzero_pd(); }
+    static inline __m128d load(const float* p) { return _mm_cvtps_pd(loadPair(p)); }
+    static inline __m128d load(const double* p) { return _mm_loadu_pd(p); }
+    static inline __m128d difference(const float* a, const float* b) { return _mm_cvtps_pd(_mm_sub_ps(loadPair(a), loadPair(b))); }
+    static inline __m128d difference(const double* a, const double* b) { return _mm_sub_pd(load(a), load(b)); }
+    static inline __m128d sum(const float* a, const float* b) { return _mm_cvtps_pd(_mm_add_ps(loadPair(a), loadPair(b))); }
+    static inline __m128d sum(const double* a, const double* b) { return _mm_add_pd(load(a), load(b)); }
+    // min(b,a) returns a unless b < a, which is what qMin() does.
+    static inline __m128d minimum(const float* a, const float* b) { return _mm_cvtps_pd(_mm_min_ps(loadPair(b), loadPair(a))); }
+    static inline __m128d minimum(const double* a, const double* b) { return _mm_min_pd(load(b), load(a)); }
+    static inline __m128d add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+    static inline __m128d mul(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+    static inline __m128d div(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+    static inline __m128d abs(__m128d a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static inline double total(__m128d a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+  };
+  typedef __m128d Vec;
+
+  PII_DISTANCE_LOOPS(static)
+
+  struct QOps
+  {
+    enum { Width = 4 };
+    static inline __m128 zero() { return _mm_setzero_ps(); }
+    static inline __m128 load(const float* p) { return _mm_loadu_ps(p); }
+    static inline __m128 load(const unsigned char* p)
+    {
+      int iBytes;
+      std::memcpy(&iBytes, p, 4);
+      const __m128i zero = _mm_setzero_si128();
+      return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(iBytes), zero), zero));
+    }
+    static inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+    static inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+    static inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+    static inline __m128 abs(__m128 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static inline double total(__m128 a) { return Ops::total(_mm_add_pd(_mm_cvtps_pd(a), _mm_cvtps_pd(_mm_movehl_ps(a, a)))); }
+  };
+  typedef __m128 QVec;
+
+  PII_QUANTIZED_DISTANCE_LOOPS(static)
+
+  struct HOps
+  {
+    enum { Width = 16 };
+    static inline __m128i zero() { return _mm_setzero_si128(); }
+    /* SSE2 has no byte shifts. Shifting 16-bit lanes is fine because
+       the masks remove the bits that leak over byte boundaries.
+     */
+    static inline __m128i count(const unsigned char* a, const unsigned char* b)
+    {
+      __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+      const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+      x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+      x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+      x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+      return _mm_sad_epu8(x, _mm_setzero_si128());
+    }
+    static inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi64(a, b); }
+    static inline int total(__m128i a) { return _mm_cvtsi128_si32(a) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(a, a)); }
+  };
+  typedef __m128i HVec;
+
+  PII_HAMMING_LOOPS(static)
+}
+#endif
+
+#ifdef PII_DISTANCE_AVX2
+namespace Avx2
+{
+#  define PII_AVX2 PII_TARGET("avx2")
+
+  struct Ops
+  {
+    enum { Width = 4 };
+    PII_AVX2 static inline __m256d zero() { return _mm256_setzero_pd(); }
+    PII_AVX2 static inline __m256d load(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+    PII_AVX2 static inline __m256d load(const double* p) { return _mm256_loadu_pd(p); }
+    PII_AVX2 static inline __m256d difference(const float* a, const float* b) { return _mm256_cvtps_pd(_mm_sub_ps(_mm_loadu_ps(a), _mm_loadu_ps(b))); }
+    PII_AVX2 static inline __m256d difference(const double* a, const double* b) { return _mm256_sub_pd(load(a), load(b)); }
+    PII_AVX2 static inline __m256d sum(const float* a, const float* b) { return _mm256_cvtps_pd(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b))); }
+    PII_AVX2 static inline __m256d sum(const double* a, const double* b) { return _mm256_add_pd(load(a), load(b)); }
+    PII_AVX2 static inline __m256d minimum(const float* a, const float* b) { return _mm256_cvtps_pd(_mm_min_ps(_mm_loadu_ps(b), _mm_loadu_ps(a))); }
+    PII_AVX2 static inline __m256d minimum(const double* a, const double* b) { return _mm256_min_pd(load(b), load(a)); }
+    PII_AVX2 static inline __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    PII_AVX2 static inline __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    PII_AVX2 static inline __m256d div(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+    PII_AVX2 static inline __m256d abs(__m256d a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    PII_AVX2 static inline double total(__m256d a)
+    {
+      const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+      return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+    }
+  };
+  typedef __m256d Vec;
+
+  PII_DISTANCE_LOOPS(PII_AVX2 static)
+
+  struct QOps
+  {
+    enum { Width = 8 };
+    PII_AVX2 static inline __m256 zero() { return _mm256_setzero_ps(); }
+    PII_AVX2 static inline __m256 load(const float* p) { return _mm256_loadu_ps(p); }
+    PII_AVX2 static inline __m256 load(const unsigned char* p)
+    {
+      return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    }
+    PII_AVX2 static inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+    PII_AVX2 static inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+    PII_AVX2 static inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+    PII_AVX2 static inline __m256 abs(__m256 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    PII_AVX2 static inline double total(__m256 a)
+    {
+      return Ops::total(_mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(a)),
+                                      _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1))));
+    }
+  };
+  typedef __m256 QVec;
+
+  PII_QUANTIZED_DISTANCE_LOOPS(PII_AVX2 static)
+
+  struct HOps
+  {
+    enum { Width = 32 };
+    PII_AVX2 static inline __m256i zero() { return _mm256_setzero_si256(); }
+    // Looks up the bit counts of both nibbles of each byte.
+    PII_AVX2 static inline __m256i count(const unsigned char* a, const unsigned char* b)
+    {
+      const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+      const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+      const __m256i low = _mm256_set1_epi8(0x0f);
+      const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(x, low)),
+                                             _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+      return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+    }
+    PII_AVX2 static inline __m256i add(__m256i a, __m256i b) { return _mm256_add_epi64(a, b); }
+    /* GCC doesn't always clear the upper halves of the registers
+       before the scalar tail is called. Dirty upper halves would slow
+       down all SSE code that follows.
+     */
+    PII_AVX2 static inline int total(__m256i a)
+    {
+      const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+      const int iTotal = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+      _mm256_zeroupper();
+      return iTotal;
+    }
+  };
+  typedef __m256i HVec;
+
+  PII_HAMMING_LOOPS(PII_AVX2 static)
+
+#  undef PII_AVX2
+}
+#endif
+
+#ifdef PII_DISTANCE_NEON
+namespace Neon
+{
+  struct Ops
+  {
+    enum { Width = 2 };
+    static inline float64x2_t zero() { return vdupq_n_f64(0); }
+    static inline float64x2_t load(const float* p) { return vcvt_f64_f32(vld1_f32(p)); }
+    static inline float64x2_t load(const double* p) { return vld1q_f64(p); }
+    static inline float64x2_t difference(const float* a, const float* b) { return vcvt_f64_f32(vsub_f32(vld1_f32(a), vld1_f32(b))); }
+    static inline float64x2_t difference(const double* a, const double* b) { return vsubq_f64(load(a), load(b)); }
+    static inline float64x2_t sum(const float* a, const float* b) { return vcvt_f64_f32(vadd_f32(vld1_f32(a), vld1_f32(b))); }
+    static inline float64x2_t sum(const double* a, const double* b) { return vaddq_f64(load(a), load(b)); }
+    static inline float64x2_t minimum(const float* a, const float* b) { return vcvt_f64_f32(vmin_f32(vld1_f32(a), vld1_f32(b))); }
+    static inline float64x2_t minimum(const double* a, const double* b) { return vminq_f64(load(a), load(b)); }
+    static inline float64x2_t add(float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }
+    static inline float64x2_t mul(float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }
+    static inline float64x2_t div(float64x2_t a, float64x2_t b) { return vdivq_f64(a, b); }
+    static inline float64x2_t abs(float64x2_t a) { return vabsq_f64(a); }
+    static inline double total(float64x2_t a) { return vaddvq_f64(a); }
+  };
+  typedef float64x2_t Vec;
+
+  PII_DISTANCE_LOOPS(static)
+
+  struct QOps
+  {
+    enum { Width = 4 };
+    static inline float32x4_t zero() { return vdupq_n_f32(0); }
+    static inline float32x4_t load(const float* p) { return vld1q_f32(p); }
+    static inline float32x4_t load(const unsigned char* p)
+    {
+      uint32_t uiBytes;
+      std::memcpy(&uiBytes, p, 4);
+      return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(uiBytes))))));
+    }
+    static inline float32x4_t sub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+    static inline float32x4_t add(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+    static inline float32x4_t mul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+    static inline float32x4_t abs(float32x4_t a) { return vabsq_f32(a); }
+    static inline double total(float32x4_t a) { return vaddvq_f64(vaddq_f64(vcvt_f64_f32(vget_low_f32(a)), vcvt_high_f64_f32(a))); }
+  };
+  typedef float32x4_t QVec;
+
+  PII_QUANTIZED_DISTANCE_LOOPS(static)
+
+  struct HOps
+  {
+    enum { Width = 16 };
+    static inline uint64x2_t zero() { return vdupq_n_u64(0); }
+    static inline uint64x2_t count(const unsigned char* a, const unsigned char* b)
+    {
+      return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vcntq_u8(veorq_u8(vld1q_u8(a), vld1q_u8(b))))));
+    }
+    static inline uint64x2_t add(uint64x2_t a, uint64x2_t b) { return vaddq_u64(a, b); }
+    static inline int total(uint64x2_t a) { return int(vgetq_lane_u64(a, 0) + vgetq_lane_u64(a, 1)); }
+  };
+  typedef uint64x2_t HVec;
+
+  PII_HAMMING_LOOPS(static)
+}
+#endif
+
+#undef PII_DISTANCE_LOOPS
+#undef PII_QUANTIZED_DISTANCE_LOOPS
+#undef PII_HAMMING_LOOPS
+
+#if defined(PII_DISTANCE_AVX2)
+#  define PII_DISTANCE_CALL(FUNCTION, ARGS) (Pii::hasCpuFeature(Pii::CpuAvx2) ? Avx2::FUNCTION ARGS : Sse2::FUNCTION ARGS)
+#elif defined(PII_DISTANCE_SSE2)
+#  define PII_DISTANCE_CALL(FUNCTION, ARGS) Sse2::FUNCTION ARGS
+#elif defined(PII_DISTANCE_NEON)
+#  define PII_DISTANCE_CALL(FUNCTION, ARGS) Neon::FUNCTION ARGS
+#else
+// Never called because isVectorized() returns false.
+static inline double unsupported(const void*, const void*, int) { return 0; }
+static inline double unsupported(const void*, const void*, int, double) { return 0; }
+static inline double unsupported(const void*, const void*, const void*, int, double) { return 0; }
+static inline double unsupported(const void*, const void*, int, int, const void*) { return 0; }
+#  define PII_DISTANCE_CALL(FUNCTION, ARGS) unsupported ARGS
+#endif
+
+#define PII_DEFINE_DISTANCE_KERNEL(TYPE)                                \
+  bool PiiDistanceKernel<const TYPE*>::squaredGeometric(const TYPE* sample, const TYPE* model, int length, \
+                                                        double bound, double* distance) \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return false;                                                     \
+    *distance = PII_DISTANCE_CALL(squaredGeometric, (sample, model, length, bound)); \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  bool PiiDistanceKernel<const TYPE*>::absDiff(const TYPE* sample, const TYPE* model, int length, \
+                                               double bound, double* distance) \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return false;                                                     \
+    *distance = PII_DISTANCE_CALL(absDiff, (sample, model, length, bound)); \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  bool PiiDistanceKernel<const TYPE*>::chiSquared(const TYPE* sample, const TYPE* model, int length, \
+                                                  double* distance)     \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return false;                                                     \
+    *distance = PII_DISTANCE_CALL(chiSquared, (sample, model, length)); \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  bool PiiDistanceKernel<const TYPE*>::histogramIntersection(const TYPE* sample, const TYPE* model, int length, \
+                                                             double* distance) \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return false;                                                     \
+    *distance = PII_DISTANCE_CALL(histogramIntersection, (sample, model, length)); \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  bool PiiDistanceKernel<const TYPE*>::cosine(const TYPE* sample, const TYPE* model, int length, \
+                                              double* distance)         \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return false;                                                     \
+    *distance = PII_DISTANCE_CALL(cosine, (sample, model, length));     \
+    return true;                                                        \
+  }
+
+PII_DEFINE_DISTANCE_KERNEL(float)
+PII_DEFINE_DISTANCE_KERNEL(double)
+
+#undef PII_DEFINE_DISTANCE_KERNEL
+
+#define PII_DEFINE_QUANTIZED_DISTANCE_KERNEL(CODE)                      \
+  double PiiQuantizedDistanceKernel::squaredDifference(const float* sample, const float* weights, \
+                                                       const CODE* codes, int length, double bound) \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return squaredDifferenceScalar(sample, weights, codes, length, bound); \
+    return PII_DISTANCE_CALL(squaredDifference, (sample, weights, codes, length, bound)); \
+  }                                                                     \
+                                                                        \
+  double PiiQuantizedDistanceKernel::absDifference(const float* sample, const float* weights, \
+                                                   const CODE* codes, int length, double bound) \
+  {                                                                     \
+    if (!isVectorized())                                                \
+      return absDifferenceScalar(sample, weights, codes, length, bound); \
+    return PII_DISTANCE_CALL(absDifference, (sample, weights, codes, length, bound)); \
+  }
+
+PII_DEFINE_QUANTIZED_DISTANCE_KERNEL(unsigned char)
+PII_DEFINE_QUANTIZED_DISTANCE_KERNEL(float)
+
+#undef PII_DEFINE_QUANTIZED_DISTANCE_KERNEL
+
+bool PiiHammingKernel<const unsigned char*>::distance(const unsigned char* sample, const unsigned char* model,
+                                                      int length, int* distance)
+{
+  if (!isVectorized())
+    *distance = hammingTail(sample, model, 0, length);
+  else
+    *distance = int(PII_DISTANCE_CALL(hamming, (sample, model, length)));
+  return true;
+}
+
+bool PiiHammingKernel<const unsigned char*>::distances(const unsigned char* sample,
+                                                       const unsigned char* const* models,
+                                                       int count, int length, int* distances)
+{
+  if (!isVectorized())
+    {
+      for (int i=0; i<count; ++i)
+        distances[i] = hammingTail(sample, models[i], 0, length);
+    }
+  else
+    PII_DISTANCE_CALL(hammings, (sample, models, count, length, distances));
+  return true;
+}
+
+#undef PII_DISTANCE_CALL
@@ -0,0 +1,125 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDISTANCEKERNELS_H
+#define _PIIDISTANCEKERNELS_H
+
+#include "PiiClassificationGlobal.h"
+
+/**
+ * Vectorized implementations of common distance measures. The
+ * kernels compare two feature vectors of *length* elements using
+ * SSE2, AVX2 or NEON instructions and store the result to
+ * *distance*. Each feature (or the difference, sum or minimum of two
+ * features) is converted to double precision before accumulation,
+ * like in the scalar code. As the sums are accumulated in a
+ * different order, the result may differ in the last bits.
+ *
+ * The *bound* parameter of the squared geometric and absolute
+ * difference kernels works as described in PiiBoundedDistance: once
+ * the partial sum exceeds *bound*, the kernel stops and stores the
+ * partial sum.
+ *
+ * The generic template says "not supported", and the distance
+ * measures fall back to scalar code. Specializations exist for `const
+ * float*` and `const double*`. Each function returns `false` if the
+ * CPU lacks the required instructions. In this case *distance* is not
+ * modified.
+ *
+ * @internal
+ */
+template <class FeatureIterator> struct PiiDistanceKernel
+{
+  static bool squaredGeometric(FeatureIterator, FeatureIterator, int, double, double*) { return false; }
+  static bool absDiff(FeatureIterator, FeatureIterator, int, double, double*) { return false; }
+  static bool chiSquared(FeatureIterator, FeatureIterator, int, double*) { return false; }
+  static bool histogramIntersection(FeatureIterator, FeatureIterator, int, double*) { return false; }
+  static bool cosine(FeatureIterator, FeatureIterator, int, double*) { return false; }
+};
+
+#define PII_DECLARE_DISTANCE_KERNEL(TYPE)                               \
+  template <> struct PII_CLASSIFICATION_EXPORT PiiDistanceKernel<const TYPE*> \
+  {                                                                     \
+    static bool squaredGeometric(const TYPE* sample, const TYPE* model, int length, \
+                                 double bound, double* distance);       \
+    static bool absDiff(const TYPE* sample, const TYPE* model, int length, \
+                        double bound, double* distance);                \
+    static bool chiSquared(const TYPE* sample, const TYPE* model, int length, double* distance); \
+    static bool histogramIntersection(const TYPE* sample, const TYPE* model, int length, double* distance); \
+    static bool cosine(const TYPE* sample, const TYPE* model, int length, double* distance); \
+  }
+
+PII_DECLARE_DISTANCE_KERNEL(float);
+PII_DECLARE_DISTANCE_KERNEL(double);
+
+#undef PII_DECLARE_DISTANCE_KERNEL
+
+/**
+ * Vectorized distances between a sample and a quantized model (see
+ * PiiQuantizedModelSet). The sample has been transformed to the
+ * scale of the codes, and *weights* compensate for the per-feature
+ * scaling. [squaredDifference()] calculates \(\sum_i w_i (s_i -
+ * c_i)^2\) and [absDifference()] \(\sum_i w_i |s_i - c_i|\), where *s*,
+ * *w* and *c* denote the sample, the weights and the codes. Both
+ * stop once the partial sum exceeds *bound* (see PiiBoundedDistance).
+ *
+ * The differences are calculated in single precision and summed up
+ * in double precision after each block of 64 features. Scalar code
+ * is used if the CPU lacks SIMD instructions.
+ *
+ * @internal
+ */
+struct PII_CLASSIFICATION_EXPORT PiiQuantizedDistanceKernel
+{
+  static double squaredDifference(const float* sample, const float* weights, const unsigned char* codes,
+                                  int length, double bound);
+  static double squaredDifference(const float* sample, const float* weights, const float* codes,
+                                  int length, double bound);
+  static double absDifference(const float* sample, const float* weights, const unsigned char* codes,
+                              int length, double bound);
+  static double absDifference(const float* sample, const float* weights, const float* codes,
+                              int length, double bound);
+};
+
+/**
+ * Vectorized Hamming distances between packed binary descriptors.
+ * Each byte stores eight bits of a descriptor, and the distance is
+ * the number of differing bits in *length* bytes.
+ * [distance()] compares two descriptors, and [distances()] compares
+ * *sample* to *count* models and stores the results to *distances*.
+ * The bits are counted with SSE2 bit slicing, AVX2 table look-ups
+ * or NEON `vcnt`, and with 64-bit bit slicing if the CPU has none of
+ * them.
+ *
+ * The generic template says "not supported", and the callers fall
+ * back to Pii::hammingDistance(). A specialization exists for `const
+ * unsigned char*`. It always succeeds.
+ *
+ * @internal
+ */
+template <class FeatureIterator> struct PiiHammingKernel
+{
+  static bool distance(FeatureIterator, FeatureIterator, int, int*) { return false; }
+  static bool distances(FeatureIterator, const FeatureIterator*, int, int, int*) { return false; }
+};
+
+template <> struct PII_CLASSIFICATION_EXPORT PiiHammingKernel<const unsigned char*>
+{
+  static bool distance(const unsigned char* sample, const unsigned char* model, int length, int* distance);
+  static bool distances(const unsigned char* sample, const unsigned char* const* models,
+                        int count, int length, int* distances);
+};
+
+#endif //_PIIDISTANCEKERNELS_H
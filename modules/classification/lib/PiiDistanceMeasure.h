@@ -33,6 +33,90 @@ template <class FeatureIterator> double NAME<FeatureIterator>::operator() (Featu
                                                                            FeatureIterator model, \
                                                                            int length) const throw()
 
+/**
+ * Calculates the distance between *sample* and *model* with
+ * *measure*, but allows the measure to give up once the distance is
+ * known to exceed *bound*. In this case, the returned value is some
+ * number larger than *bound*. Nearest neighbor searches pass the
+ * distance to the farthest neighbor found so far as the bound.
+ *
+ * The generic implementation ignores the bound. Measures whose
+ * partial sums never decrease are defined with
+ * PII_BOUNDED_DISTANCE_MEASURE_DEF, which specializes this template.
+ */
+template <class Measure> struct PiiBoundedDistance
+{
+  template <class FeatureIterator>
+  static double measure(const Measure& distance, FeatureIterator sample, FeatureIterator model,
+                        int length, double /*bound*/)
+  {
+    return distance(sample, model, length);
+  }
+};
+
+/**
+ * Calculates the distances between all pairs of *sampleCount*
+ * samples and *modelCount* models with *measure*. The result is
+ * stored in row-major order to *distances*: the distance between
+ * sample *i* and model *j* goes to `distances[i*modelCount + j]`.
+ *
+ * The generic implementation measures each pair separately. Kernel
+ * functions that only depend on inner products and norms of their
+ * arguments specialize this template to calculate the inner products
+ * with a single matrix multiplication (see
+ * PiiInnerProductKernelMatrix).
+ */
+template <class Measure> struct PiiDistanceMatrix
+{
+  template <class FeatureIterator>
+  static void measure(const Measure& distance,
+                      const FeatureIterator* samples, int sampleCount,
+                      const FeatureIterator* models, int modelCount,
+                      int length, double* distances)
+  {
+    for (int i=0; i<sampleCount; ++i)
+      for (int j=0; j<modelCount; ++j)
+        *distances++ = distance(samples[i], models[j], length);
+  }
+};
+
+/**
+ * Tells how *Measure* combines the differences of corresponding
+ * features into a distance. PiiQuantizedModelSet uses this
+ * information to calculate distances to quantized models without
+ * decoding them first. The generic implementation says
+ * PiiClassification::GenericDistance. Measures that are sums of
+ * per-feature differences specialize this template.
+ */
+template <class Measure> struct PiiDistanceForm
+{
+  enum { value = PiiClassification::GenericDistance };
+};
+
+/// @internal
+#define PII_BOUNDED_DISTANCE_MEASURE_DEF(NAME) \
+template <class FeatureIterator> class NAME \
+{ \
+public: \
+  inline double operator() (FeatureIterator sample, FeatureIterator model, int length) const throw() \
+  { \
+    return operator() (sample, model, length, INFINITY); \
+  } \
+  inline double operator() (FeatureIterator sample, FeatureIterator model, int length, double bound) const throw(); \
+}; \
+template <class FeatureIterator> struct PiiBoundedDistance<NAME<FeatureIterator> > \
+{ \
+  static double measure(const NAME<FeatureIterator>& distance, FeatureIterator sample, FeatureIterator model, \
+                        int length, double bound) \
+  { \
+    return distance(sample, model, length, bound); \
+  } \
+}; \
+template <class FeatureIterator> double NAME<FeatureIterator>::operator() (FeatureIterator sample, \
+                                                                           FeatureIterator model, \
+                                                                           int length, \
+                                                                           double bound) const throw()
+
 /**
  * Type definition for a polymorphic implementation of the function
  * object *MEASURE*.
@@ -72,6 +156,56 @@ public:
                              int length) const throw() = 0;
 
 
+  /**
+   * Measures the distances between *sample* and *modelCount* models.
+   * Nearest neighbor searches use this function to avoid a virtual
+   * function call for each model. If the distance to a model exceeds
+   * *bound*, the measure may stop early and store any number larger
+   * than *bound* (see PiiBoundedDistance).
+   *
+   * @param sample a sample feature vector
+   *
+   * @param models an array of *modelCount* model feature vectors
+   *
+   * @param modelCount the number of models
+   *
+   * @param length the number of features (dimensions) to consider
+   *
+   * @param bound distances larger than this need not be exact
+   *
+   * @param distances an array of *modelCount* values that receives
+   * the distances
+   *
+   * The default implementation calls [operator()] for each model.
+   */
+  virtual void distances(FeatureIterator sample,
+                         const FeatureIterator* models,
+                         int modelCount,
+                         int length,
+                         double bound,
+                         double* distances) const throw();
+
+  /**
+   * Measures the distances between all pairs of *sampleCount*
+   * samples and *modelCount* models. The distance between sample *i*
+   * and model *j* is stored to `distances[i*modelCount + j]`.
+   *
+   * The default implementation calls [distances()] for each sample.
+   */
+  virtual void distanceMatrix(const FeatureIterator* samples,
+                              int sampleCount,
+                              const FeatureIterator* models,
+                              int modelCount,
+                              int length,
+                              double* distances) const throw();
+
+  /**
+   * Returns the form of the distance measure (see PiiDistanceForm).
+   * The default implementation returns
+   * PiiClassification::GenericDistance.
+   */
+  virtual PiiClassification::DistanceForm distanceForm() const;
+
   virtual PiiDistanceMeasure* clone() const = 0;
 
   template <class Measure> class Impl;
@@ -92,11 +226,42 @@ template <class FeatureIterator> PiiDistanceMeasure<FeatureIterator>::~PiiDistan
 {
 }
 
+template <class FeatureIterator>
+void PiiDistanceMeasure<FeatureIterator>::distances(FeatureIterator sample,
+                                                    const FeatureIterator* models,
+                                                    int modelCount,
+                                                    int length,
+                                                    double /*bound*/,
+                                                    double* distances) const throw()
+{
+  for (int i=0; i<modelCount; ++i)
+    distances[i] = (*this)(sample, models[i], length);
+}
+
+template <class FeatureIterator>
+void PiiDistanceMeasure<FeatureIterator>::distanceMatrix(const FeatureIterator* samples,
+                                                         int sampleCount,
+                                                         const FeatureIterator* models,
+                                                         int modelCount,
+                                                         int length,
+                                                         double* distances) const throw()
+{
+  for (int i=0; i<sampleCount; ++i, distances += modelCount)
+    this->distances(samples[i], models, modelCount, length, INFINITY, distances);
+}
+
+template <class FeatureIterator>
+PiiClassification::DistanceForm PiiDistanceMeasure<FeatureIterator>::distanceForm() const
+{
+  return PiiClassification::GenericDistance;
+}
+
 /**
  * A template that implements the PiiDistanceMeasure interface by
  * using `Measure` as the distance measure implementation. The
  * virtual measure() function just passes the call to the given
- * `Measure` class.
+ * `Measure` class. [distances()] and [distanceMatrix()] measure a
+ * block of models with a single virtual function call.
  *
  */
 template <class FeatureIterator> template <class Measure>
@@ -112,6 +277,32 @@ public:
     return Measure::operator() (sample, model, length);
   }
 
+  void distances(FeatureIterator sample,
+                 const FeatureIterator* models,
+                 int modelCount,
+                 int length,
+                 double bound,
+                 double* distances) const throw()
+  {
+    for (int i=0; i<modelCount; ++i)
+      distances[i] = PiiBoundedDistance<Measure>::measure(*this, sample, models[i], length, bound);
+  }
+
+  void distanceMatrix(const FeatureIterator* samples,
+                      int sampleCount,
+                      const FeatureIterator* models,
+                      int modelCount,
+                      int length,
+                      double* distances) const throw()
+  {
+    PiiDistanceMatrix<Measure>::measure(*this, samples, sampleCount, models, modelCount, length, distances);
+  }
+
+  PiiClassification::DistanceForm distanceForm() const
+  {
+    return PiiClassification::DistanceForm(PiiDistanceForm<Measure>::value);
+  }
+
   Impl* clone() const
   {
     return new Impl;
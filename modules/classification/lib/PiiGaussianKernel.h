@@ -16,6 +16,8 @@
 #ifndef _PIIGAUSSIANKERNEL_H
 #define _PIIGAUSSIANKERNEL_H
 
+#include "PiiKernelFunction.h"
+
 /**
  * Gaussian kernel function. The Gaussian kernel is defined as
  * \(k(x,y) = e^-\fraq{||x-y||^2}{2\sigma^2}\), where *x* and *y*
@@ -53,8 +55,22 @@ public:
   {
     return Pii::exp(-Pii::squaredDistanceN(sample, length, model, 0.0) * _dNormalizer);
   }
+
+  /**
+   * Evaluates the kernel given the inner product of two vectors and
+   * their squared norms. See PiiInnerProductKernelMatrix.
+   */
+  inline double fromInnerProduct(double innerProduct, double sampleNorm, double modelNorm) const throw()
+  {
+    // Rounding errors may make the squared distance slightly negative.
+    return Pii::exp(-qMax(0.0, sampleNorm + modelNorm - 2*innerProduct) * _dNormalizer);
+  }
 private:
   double _dSigma, _dNormalizer;
 };
 
+template <class FeatureIterator> struct PiiDistanceMatrix<PiiGaussianKernel<FeatureIterator> > :
+  PiiInnerProductKernelMatrix<PiiGaussianKernel<FeatureIterator> >
+{};
+
 #endif //_PIIGAUSSIANKERNEL_H
@@ -16,7 +16,7 @@
 #ifndef _PIIGEOMETRICDISTANCE_H
 #define _PIIGEOMETRICDISTANCE_H
 
-#include "PiiDistanceMeasure.h"
+#include "PiiSquaredGeometricDistance.h"
 
 /**
  * Geometric distance. The geometric distance is calculated as the
@@ -36,4 +36,22 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiGeometricDistance)
   return sqrt(sum);
 }
 
+/**
+ * Specialization for half-precision features. See
+ * PiiSquaredGeometricDistance<const PiiHalf*>.
+ */
+template <> class PiiGeometricDistance<const PiiHalf*>
+{
+public:
+  inline double operator() (const PiiHalf* sample, const PiiHalf* model, int length) const throw()
+  {
+    return sqrt(PiiSquaredGeometricDistance<const PiiHalf*>()(sample, model, length));
+  }
+};
+
+template <class FeatureIterator> struct PiiDistanceForm<PiiGeometricDistance<FeatureIterator> >
+{
+  enum { value = PiiClassification::SquaredDifferenceSumRoot };
+};
+
 #endif //_PIIGEOMETRICDISTANCE_H
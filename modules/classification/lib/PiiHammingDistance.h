@@ -17,6 +17,7 @@
 #define _PIIHAMMINGDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 #include <PiiBits.h>
 
 /**
@@ -24,13 +25,22 @@
  * vectors. The Hamming distance is the number of different bits in
  * two numbers.
  *
+ * Binary descriptors packed eight bits per byte (see
+ * PiiRandomLbp::calculateDescriptor()) should be stored as
+ * `unsigned char`. With `const unsigned char*` as the feature
+ * iterator, the bits are counted with SIMD instructions.
+ *
  */
 PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiHammingDistance)
 {
+  int iDistance;
+  if (PiiHammingKernel<FeatureIterator>::distance(sample, model, length, &iDistance))
+    return iDistance;
+
   double distance = 0;
   for (int i=0; i<length; ++i)
     distance += Pii::hammingDistance(sample[i], model[i],
-                                     sizeof(typename std::iterator_traits<FeatureIterator>::value_type));
+                                     sizeof(typename std::iterator_traits<FeatureIterator>::value_type) * 8);
   return distance;
 }
 
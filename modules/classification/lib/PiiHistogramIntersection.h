@@ -17,6 +17,7 @@
 #define _PIIHISTOGRAMINTERSECTION_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
 
 /**
  * Histogram intersection. Measures difference between two
@@ -35,6 +36,8 @@
 PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiHistogramIntersection)
 {
   double diffSum = 0.0;
+  if (PiiDistanceKernel<FeatureIterator>::histogramIntersection(sample, model, length, &diffSum))
+    return diffSum;
   for (int i=0; i<length; ++i)
     diffSum += double(qMin(sample[i], model[i]));
 
@@ -0,0 +1,366 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIHNSWINDEX_H
+# error "Never use <PiiHnswIndex-templates.h> directly; include <PiiHnswIndex.h> instead."
+#endif
+
+#include <cmath>
+#include <algorithm>
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::PiiHnswIndex() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::PiiHnswIndex(const PiiHnswIndex& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiHnswIndex<SampleSet>::~PiiHnswIndex()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>& PiiHnswIndex<SampleSet>::operator= (const PiiHnswIndex& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setNeighborCount(int neighborCount)
+{
+  d = d->detach();
+  d->iNeighborCount = qMax(2, neighborCount);
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setBuildWidth(int buildWidth)
+{
+  d = d->detach();
+  d->iBuildWidth = qMax(1, buildWidth);
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setSearchWidth(int searchWidth)
+{
+  d = d->detach();
+  d->iSearchWidth = qMax(1, searchWidth);
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::clear()
+{
+  Data* pData = new Data;
+  pData->iNeighborCount = d->iNeighborCount;
+  pData->iBuildWidth = d->iBuildWidth;
+  pData->iSearchWidth = d->iSearchWidth;
+  d->release();
+  d = pData;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::buildIndex(const SampleSet& modelSet,
+                                         const DistanceMeasure& measure,
+                                         PiiProgressController* controller)
+{
+  clear();
+  const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
+  d->iFeatureCount = PiiSampleSet::featureCount(modelSet);
+  if (d->iFeatureCount == 0 || iSampleCount == 0)
+    return;
+
+  d->modelSet = modelSet;
+  const int iLinks = d->iLinkCount = d->iNeighborCount;
+
+  /* Assign each sample to a random top level. The probability of a
+     level decays exponentially so that each layer has about
+     1/iLinks of the samples of the one below. A fixed seed makes
+     the graph reproducible.
+   */
+  const double dLevelScale = 1.0 / std::log(double(iLinks));
+  unsigned int uiSeed = 1;
+  int iUpperSize = 0;
+  d->vecLevels.resize(iSampleCount);
+  d->vecUpperOffsets.resize(iSampleCount);
+  for (int i=0; i<iSampleCount; ++i)
+    {
+      uiSeed = uiSeed * 1664525u + 1013904223u;
+      const double dUniform = (double(uiSeed >> 8) + 0.5) / 16777216.0;
+      const int iLevel = qMin(int(-std::log(dUniform) * dLevelScale), 30);
+      d->vecLevels[i] = iLevel;
+      d->vecUpperOffsets[i] = iLevel > 0 ? iUpperSize : -1;
+      iUpperSize += iLevel * (iLinks + 1);
+    }
+  d->vecBaseLinks.fill(0, iSampleCount * (2 * iLinks + 1));
+  d->vecUpperLinks.fill(0, iUpperSize);
+
+  VisitedSet visited(iSampleCount);
+  try
+    {
+      for (int i=0; i<iSampleCount; ++i)
+        {
+          insert(i, measure, visited);
+          if ((i & 63) == 63)
+            PII_TRY_CONTINUE(controller, double(i+1) / iSampleCount);
+        }
+    }
+  catch (...)
+    {
+      // Don't leave a half-built graph behind.
+      clear();
+      throw;
+    }
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::insert(int sample, const DistanceMeasure& measure, VisitedSet& visited)
+{
+  if (d->iEntryPoint < 0)
+    {
+      d->iEntryPoint = sample;
+      return;
+    }
+
+  const Sample pSample = sampleAt(sample);
+  const int iLevel = d->vecLevels[sample], iTopLevel = topLevel();
+  int iEntryPoint = d->iEntryPoint;
+  double dEntryDistance = distance(pSample, iEntryPoint, measure, INFINITY);
+  // Greedy descent through the layers above the sample's own ones.
+  for (int l=iTopLevel; l>iLevel; --l)
+    descend(pSample, measure, l, &iEntryPoint, &dEntryDistance);
+
+  for (int l=qMin(iLevel, iTopLevel); l>=0; --l)
+    {
+      // Sorting inverts the heap, so a new one is needed on each layer.
+      PiiClassification::MatchList results;
+      visited.reset();
+      searchLayer(pSample, measure, l, iEntryPoint, dEntryDistance, d->iBuildWidth, visited, results);
+      results.sort();
+      int iCandidates = 0;
+      while (iCandidates < results.size() && results[iCandidates].second >= 0)
+        ++iCandidates;
+      // The closest candidate is the entry point to the next layer.
+      iEntryPoint = results[0].second;
+      dEntryDistance = results[0].first;
+
+      const int iCount = selectNeighbors(measure, &results[0], iCandidates, d->iLinkCount);
+      int* pLinks = links(sample, l);
+      pLinks[0] = iCount;
+      for (int i=0; i<iCount; ++i)
+        pLinks[i+1] = results[i].second;
+      for (int i=0; i<iCount; ++i)
+        addLink(results[i].second, sample, results[i].first, l, measure);
+    }
+
+  if (iLevel > iTopLevel)
+    d->iEntryPoint = sample;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::descend(Sample sample, const DistanceMeasure& measure, int level,
+                                      int* entryPoint, double* entryDistance) const
+{
+  QVarLengthArray<Sample,64> vecModels(linkCapacity(level));
+  QVarLengthArray<double,64> vecDistances(linkCapacity(level));
+  for (bool bMoved = true; bMoved; )
+    {
+      bMoved = false;
+      const int* pLinks = links(*entryPoint, level);
+      const int iCount = pLinks[0];
+      for (int i=0; i<iCount; ++i)
+        vecModels[i] = sampleAt(pLinks[i+1]);
+      PiiClassification::measureDistances(sample, vecModels.data(), iCount, d->iFeatureCount,
+                                          measure, *entryDistance, vecDistances.data());
+      for (int i=0; i<iCount; ++i)
+        if (vecDistances[i] < *entryDistance)
+          {
+            *entryDistance = vecDistances[i];
+            *entryPoint = pLinks[i+1];
+            bMoved = true;
+          }
+    }
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::searchLayer(Sample sample, const DistanceMeasure& measure, int level,
+                                          int entryPoint, double entryDistance, int width,
+                                          VisitedSet& visited, PiiClassification::MatchList& results) const
+{
+  /* results keeps the width closest samples found so far, the
+     farthest one at the top. candidates holds the samples whose
+     neighbors haven't been inspected yet, the closest one at the
+     top.
+   */
+  results.fill(width, Candidate(INFINITY, -1));
+  results.put(Candidate(entryDistance, entryPoint));
+  PiiHeap<Candidate> candidates(0, Pii::InverseHeap);
+  candidates.append(Candidate(entryDistance, entryPoint));
+  visited.visit(entryPoint);
+
+  const int iCapacity = linkCapacity(level);
+  QVarLengthArray<Sample,64> vecModels(iCapacity);
+  QVarLengthArray<int,64> vecIndices(iCapacity);
+  QVarLengthArray<double,64> vecDistances(iCapacity);
+  while (candidates.size() > 0)
+    {
+      const Candidate closest = candidates.take(0);
+      // All remaining candidates are farther than the current results.
+      if (closest.first > results[0].first)
+        break;
+      const int* pLinks = links(closest.second, level);
+      int iCount = 0;
+      for (int i=1; i<=pLinks[0]; ++i)
+        if (visited.visit(pLinks[i]))
+          {
+            vecIndices[iCount] = pLinks[i];
+            vecModels[iCount++] = sampleAt(pLinks[i]);
+          }
+      // Samples farther than the worst result need not be measured exactly.
+      PiiClassification::measureDistances(sample, vecModels.data(), iCount, d->iFeatureCount,
+                                          measure, results[0].first, vecDistances.data());
+      for (int i=0; i<iCount; ++i)
+        if (vecDistances[i] < results[0].first)
+          {
+            results.put(Candidate(vecDistances[i], vecIndices[i]));
+            candidates.append(Candidate(vecDistances[i], vecIndices[i]));
+          }
+    }
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+int PiiHnswIndex<SampleSet>::selectNeighbors(const DistanceMeasure& measure, Candidate* candidates,
+                                             int candidateCount, int maxCount) const
+{
+  /* Candidates are in ascending order of distance. A candidate is
+     selected only if it is closer to the base sample than to any of
+     the already selected ones. This keeps links pointing to
+     different directions, which is essential for navigating
+     clustered data. Remaining slots are filled with the closest
+     rejected candidates.
+   */
+  QVarLengthArray<Sample,64> vecSelected(maxCount);
+  QVarLengthArray<double,64> vecDistances(maxCount);
+  QVector<Candidate> vecRejected;
+  int iSelected = 0;
+  for (int i=0; i<candidateCount && iSelected < maxCount; ++i)
+    {
+      const Candidate candidate = candidates[i];
+      PiiClassification::measureDistances(sampleAt(candidate.second), vecSelected.data(), iSelected,
+                                          d->iFeatureCount, measure, candidate.first, vecDistances.data());
+      bool bDiverse = true;
+      for (int j=0; j<iSelected; ++j)
+        if (vecDistances[j] < candidate.first)
+          {
+            bDiverse = false;
+            break;
+          }
+      if (bDiverse)
+        {
+          vecSelected[iSelected] = sampleAt(candidate.second);
+          // Overwrites an already inspected candidate.
+          candidates[iSelected++] = candidate;
+        }
+      else
+        vecRejected.append(candidate);
+    }
+  for (int i=0; i<vecRejected.size() && iSelected < maxCount; ++i)
+    candidates[iSelected++] = vecRejected[i];
+  return iSelected;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::addLink(int from, int to, double distance, int level,
+                                      const DistanceMeasure& measure)
+{
+  int* pLinks = links(from, level);
+  const int iCapacity = linkCapacity(level);
+  if (pLinks[0] < iCapacity)
+    {
+      pLinks[++pLinks[0]] = to;
+      return;
+    }
+
+  // The list is full. Select the best ones out of the old links and the new one.
+  QVarLengthArray<Sample,64> vecModels(iCapacity);
+  QVarLengthArray<double,64> vecDistances(iCapacity);
+  for (int i=0; i<iCapacity; ++i)
+    vecModels[i] = sampleAt(pLinks[i+1]);
+  PiiClassification::measureDistances(sampleAt(from), vecModels.data(), iCapacity, d->iFeatureCount,
+                                      measure, INFINITY, vecDistances.data());
+  QVarLengthArray<Candidate,64> vecCandidates(iCapacity + 1);
+  for (int i=0; i<iCapacity; ++i)
+    vecCandidates[i] = Candidate(vecDistances[i], pLinks[i+1]);
+  vecCandidates[iCapacity] = Candidate(distance, to);
+  std::sort(vecCandidates.data(), vecCandidates.data() + iCapacity + 1);
+
+  const int iCount = selectNeighbors(measure, vecCandidates.data(), iCapacity + 1, iCapacity);
+  pLinks[0] = iCount;
+  for (int i=0; i<iCount; ++i)
+    pLinks[i+1] = vecCandidates[i].second;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiHnswIndex<SampleSet>::searchFromTop(Sample sample, const DistanceMeasure& measure, int width,
+                                            PiiClassification::MatchList& results) const
+{
+  int iEntryPoint = d->iEntryPoint;
+  double dEntryDistance = distance(sample, iEntryPoint, measure, INFINITY);
+  for (int l=topLevel(); l>0; --l)
+    descend(sample, measure, l, &iEntryPoint, &dEntryDistance);
+  VisitedSet visited(sampleCount());
+  searchLayer(sample, measure, 0, iEntryPoint, dEntryDistance, width, visited, results);
+  // Ascending order -> first is the best match
+  results.sort();
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+int PiiHnswIndex<SampleSet>::findClosestMatch(Sample sample,
+                                              const DistanceMeasure& measure,
+                                              double* distance) const
+{
+  Candidate closest(INFINITY, -1);
+  if (!isEmpty())
+    {
+      PiiClassification::MatchList results;
+      searchFromTop(sample, measure, d->iSearchWidth, results);
+      closest = results[0];
+    }
+  if (distance != 0)
+    *distance = closest.first;
+  return closest.second;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+PiiClassification::MatchList PiiHnswIndex<SampleSet>::findClosestMatches(Sample sample,
+                                                                        const DistanceMeasure& measure,
+                                                                        int n) const
+{
+  PiiClassification::MatchList lstMatches;
+  if (isEmpty() || n <= 0)
+    return lstMatches;
+
+  PiiClassification::MatchList results;
+  searchFromTop(sample, measure, qMax(n, d->iSearchWidth), results);
+  int iCount = 0;
+  while (iCount < n && iCount < results.size() && results[iCount].second >= 0)
+    ++iCount;
+  lstMatches.fill(iCount, Candidate(INFINITY, -1));
+  for (int i=0; i<iCount; ++i)
+    lstMatches[i] = results[i];
+  return lstMatches;
+}
@@ -0,0 +1,327 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIHNSWINDEX_H
+#define _PIIHNSWINDEX_H
+
+#include <QVector>
+#include <QVarLengthArray>
+#include <QPair>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * A hierarchical navigable small world (HNSW) graph for approximate
+ * nearest neighbor search. HNSW connects each model sample to a few
+ * of its near neighbors and stacks progressively sparser layers of
+ * such graphs on top of each other. A query starts at the sparse top
+ * layer and greedily walks towards the sample, refining the search
+ * on each layer below. The complexity of a query is roughly `O(log
+ * N)` and, unlike with PiiKdTree, does not degrade with the
+ * dimensionality of the feature space.
+ *
+ * The result is approximate: the exact nearest neighbors are found
+ * with a high probability, which can be controlled with
+ * [setSearchWidth()]. A larger search width means higher recall but
+ * slower queries. Construction is affected similarly by
+ * [setBuildWidth()] and [setNeighborCount()].
+ *
+ * The graph works with any distance measure that is symmetric and
+ * roughly obeys the triangle inequality, including those that don't
+ * define a Euclidean space. The measure is given as a parameter to
+ * [buildIndex()] and the search functions. The same measure must be
+ * used in both. Measures whose partial sums never decrease (see
+ * PiiBoundedDistance) make the look-ups faster.
+ *
+ * ~~~(c++)
+ * PiiMatrix<float> matModels(100000, 300);
+ * PiiSquaredGeometricDistance<const float*> measure;
+ * PiiHnswIndex<PiiMatrix<float> > index;
+ * index.buildIndex(matModels, measure);
+ * index.setSearchWidth(100);
+ * PiiClassification::MatchList lstMatches = index.findClosestMatches(matModels[0], measure, 5);
+ * ~~~
+ */
+template <class SampleSet> class PiiHnswIndex
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("neighbors", d->iNeighborCount);
+    archive & PII_NVP("links", d->iLinkCount);
+    archive & PII_NVP("buildWidth", d->iBuildWidth);
+    archive & PII_NVP("searchWidth", d->iSearchWidth);
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("entry", d->iEntryPoint);
+    archive & PII_NVP("levels", d->vecLevels);
+    archive & PII_NVP("baseLinks", d->vecBaseLinks);
+    archive & PII_NVP("upperOffsets", d->vecUpperOffsets);
+    archive & PII_NVP("upperLinks", d->vecUpperLinks);
+    archive & PII_NVP("models", d->modelSet);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  /**
+   * Constructs an empty index.
+   */
+  PiiHnswIndex();
+  /**
+   * Constructs a shallow copy of *other*.
+   */
+  PiiHnswIndex(const PiiHnswIndex& other);
+  /**
+   * Destroys the index.
+   */
+  ~PiiHnswIndex();
+
+  /**
+   * Assigns *other* to `this`.
+   */
+  PiiHnswIndex& operator= (const PiiHnswIndex& other);
+
+  /**
+   * Deletes the old graph (if any) and builds a new one out of the
+   * given model samples. The search parameters are retained.
+   *
+   * @param modelSet model samples
+   *
+   * @param measure the distance measure used to connect the samples
+   *
+   * @param controller an optional external controller that can be
+   * used to stop building the graph on user request.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted.
+   */
+  template <class DistanceMeasure>
+  void buildIndex(const SampleSet& modelSet,
+                  const DistanceMeasure& measure,
+                  PiiProgressController* controller = 0);
+
+  /**
+   * Removes all model samples from the index.
+   */
+  void clear();
+
+  /**
+   * Returns `true` if the index contains no model samples.
+   */
+  bool isEmpty() const { return d->iEntryPoint < 0; }
+
+  /**
+   * Returns the index of a probably nearest neighbor of *sample* in
+   * the model set.
+   *
+   * @param sample input feature vector
+   *
+   * @param measure the distance measure. Must be the same that was
+   * used in building the index.
+   *
+   * @param distance an optional output-value argument that will store
+   * the distance to the closest neighbor of *sample*.
+   *
+   * @return the index of the closest sample found, or -1 if the set
+   * is empty.
+   */
+  template <class DistanceMeasure>
+  int findClosestMatch(Sample sample,
+                       const DistanceMeasure& measure,
+                       double* distance = 0) const;
+
+  /**
+   * Returns *n* matches that are probably the closest ones of
+   * *sample*. At least *n* candidates are considered on the bottom
+   * layer even if [searchWidth()] is smaller.
+   *
+   * @return the *n* closest matches found, in ascending order of
+   * distance. If the model set is smaller than *n*, less than *n*
+   * matches will be returned.
+   */
+  template <class DistanceMeasure>
+  PiiClassification::MatchList findClosestMatches(Sample sample,
+                                                  const DistanceMeasure& measure,
+                                                  int n) const;
+
+  /**
+   * Sets the number of links each sample has to its neighbors on
+   * the upper layers. The bottom layer has twice as many. A larger
+   * number improves recall especially in high-dimensional spaces,
+   * but makes the graph larger and slower to build. Takes effect
+   * when the index is rebuilt. The default is 16.
+   */
+  void setNeighborCount(int neighborCount);
+  /**
+   * Returns the maximum number of links per sample on the upper
+   * layers used in the next build.
+   */
+  int neighborCount() const { return d->iNeighborCount; }
+
+  /**
+   * Sets the number of candidate neighbors considered when a sample
+   * is inserted into the graph. Larger values build a better graph
+   * more slowly. Takes effect when the index is rebuilt. The
+   * default is 100.
+   */
+  void setBuildWidth(int buildWidth);
+  /**
+   * Returns the number of candidates considered at insertion.
+   */
+  int buildWidth() const { return d->iBuildWidth; }
+
+  /**
+   * Sets the number of candidates kept on the bottom layer during a
+   * query. This is the trade-off between speed and recall. A search
+   * width equal to the number of model samples makes the search
+   * (slowly) exhaustive. The default is 50.
+   */
+  void setSearchWidth(int searchWidth);
+  /**
+   * Returns the number of candidates kept during a query.
+   */
+  int searchWidth() const { return d->iSearchWidth; }
+
+  /**
+   * Returns the model sample set the index was built of.
+   */
+  SampleSet modelSet() const { return d->modelSet; }
+
+  /**
+   * Returns the number of samples in the index.
+   */
+  int modelCount() const { return d->vecLevels.size(); }
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() :
+      iNeighborCount(16), iBuildWidth(100), iSearchWidth(50),
+      iLinkCount(16), iFeatureCount(0), iEntryPoint(-1)
+    {}
+    Data(const Data& other) :
+      iNeighborCount(other.iNeighborCount),
+      iBuildWidth(other.iBuildWidth),
+      iSearchWidth(other.iSearchWidth),
+      iLinkCount(other.iLinkCount),
+      iFeatureCount(other.iFeatureCount),
+      iEntryPoint(other.iEntryPoint),
+      vecLevels(other.vecLevels),
+      vecBaseLinks(other.vecBaseLinks),
+      vecUpperOffsets(other.vecUpperOffsets),
+      vecUpperLinks(other.vecUpperLinks),
+      modelSet(other.modelSet)
+    {}
+
+    int iNeighborCount, iBuildWidth, iSearchWidth;
+    // The neighbor count the current graph was built with.
+    int iLinkCount;
+    int iFeatureCount;
+    int iEntryPoint;
+    // The topmost layer each sample belongs to.
+    QVector<int> vecLevels;
+    /* Links on the bottom layer, 2*iLinkCount+1 entries per
+       sample. The first entry of each block holds the number of
+       links. */
+    QVector<int> vecBaseLinks;
+    // Start of each sample's upper layer links in vecUpperLinks, or -1.
+    QVector<int> vecUpperOffsets;
+    // Links on layers 1...level, iLinkCount+1 entries per layer.
+    QVector<int> vecUpperLinks;
+    SampleSet modelSet;
+  } *d;
+
+  typedef QPair<double,int> Candidate;
+
+  // Marks visited samples during a search without clearing an array.
+  class VisitedSet
+  {
+  public:
+    VisitedSet(int size) : _vecMarks(size), _uiMark(0) { reset(); }
+    void reset()
+    {
+      if (++_uiMark == 0)
+        {
+          _vecMarks.fill(0);
+          _uiMark = 1;
+        }
+    }
+    bool visit(int index)
+    {
+      if (_vecMarks[index] == _uiMark)
+        return false;
+      _vecMarks[index] = _uiMark;
+      return true;
+    }
+
+  private:
+    QVector<unsigned int> _vecMarks;
+    unsigned int _uiMark;
+  };
+
+  int linkCapacity(int level) const { return level == 0 ? 2 * d->iLinkCount : d->iLinkCount; }
+  const int* links(int sample, int level) const
+  {
+    return level == 0 ?
+      d->vecBaseLinks.constData() + sample * (2 * d->iLinkCount + 1) :
+      d->vecUpperLinks.constData() + d->vecUpperOffsets[sample] + (level-1) * (d->iLinkCount + 1);
+  }
+  int* links(int sample, int level)
+  {
+    return level == 0 ?
+      d->vecBaseLinks.data() + sample * (2 * d->iLinkCount + 1) :
+      d->vecUpperLinks.data() + d->vecUpperOffsets[sample] + (level-1) * (d->iLinkCount + 1);
+  }
+  int topLevel() const { return d->vecLevels[d->iEntryPoint]; }
+
+  template <class DistanceMeasure>
+  void insert(int sample, const DistanceMeasure& measure, VisitedSet& visited);
+  template <class DistanceMeasure>
+  void descend(Sample sample, const DistanceMeasure& measure, int level,
+               int* entryPoint, double* entryDistance) const;
+  template <class DistanceMeasure>
+  void searchLayer(Sample sample, const DistanceMeasure& measure, int level,
+                   int entryPoint, double entryDistance, int width,
+                   VisitedSet& visited, PiiClassification::MatchList& results) const;
+  template <class DistanceMeasure>
+  int selectNeighbors(const DistanceMeasure& measure, Candidate* candidates,
+                      int candidateCount, int maxCount) const;
+  template <class DistanceMeasure>
+  void addLink(int from, int to, double distance, int level, const DistanceMeasure& measure);
+  template <class DistanceMeasure>
+  void searchFromTop(Sample sample, const DistanceMeasure& measure, int width,
+                     PiiClassification::MatchList& results) const;
+
+  template <class DistanceMeasure>
+  inline double distance(Sample sample, int model, const DistanceMeasure& measure, double bound) const
+  {
+    Sample pModel = sampleAt(model);
+    double dDistance;
+    PiiClassification::measureDistances(sample, &pModel, 1, d->iFeatureCount, measure, bound, &dDistance);
+    return dDistance;
+  }
+
+  inline int sampleCount() const { return PiiSampleSet::sampleCount(d->modelSet); }
+  inline Sample sampleAt(int index) const { return PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->modelSet), index); }
+};
+
+#include "PiiHnswIndex-templates.h"
+
+#endif //_PIIHNSWINDEX_H
@@ -17,6 +17,9 @@
 # error "Never use <PiiKdTree-templates.h> directly; include <PiiKdTree.h> instead."
 #endif
 
+#include <algorithm>
+#include <climits>
+
 
 template <class SampleSet>
 PiiKdTree<SampleSet>::PiiKdTree() :
@@ -50,175 +53,283 @@ PiiKdTree<SampleSet>& PiiKdTree<SampleSet>::operator= (const PiiKdTree& other)
   return *this;
 }
 
-template <class SampleSet>
-void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
-                                     PiiProgressController* controller)
+template <class SampleSet> void PiiKdTree<SampleSet>::setBucketSize(int bucketSize)
 {
-  d->release();
-  d = new Data;
-  const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
-  d->iFeatureCount = PiiSampleSet::featureCount(modelSet);
-  if (d->iFeatureCount == 0 || iSampleCount == 0)
-    return;
-
-  QVector<FeatureSorter> vecSorters(iSampleCount);
-  QVector<double> vecMeans(d->iFeatureCount);
-  d->pMeans = vecMeans.data();
-  QVector<double> vecVars(d->iFeatureCount);
-  d->pVars = vecVars.data();
-  for (int i=0; i<iSampleCount; ++i)
-    vecSorters[i].second = i;
-
-  d->modelSet = modelSet;
-  // May throw a PiiClassificationException
-  d->pRoot = createNode(vecSorters.data(), iSampleCount, 0, controller);
+  d = d->detach();
+  d->iBucketSize = qBound(1, bucketSize, int(MaxBucketSize));
 }
 
-template <class SampleSet>
-int PiiKdTree<SampleSet>::selectDimension(FeatureSorter* sorterArray,
-                                          int sampleCount,
-                                          int /*depth*/)
+template <class SampleSet> int PiiKdTree<SampleSet>::bucketSize() const { return d->iBucketSize; }
+
+template <class SampleSet> class PiiKdTree<SampleSet>::Builder
 {
-  Pii::fillN(d->pMeans, d->iFeatureCount, 0.0);
-  Pii::fillN(d->pVars, d->iFeatureCount, 0.0);
-  // Calculate mean for each dimension.
-  for (int i=0; i<sampleCount; ++i)
-    Pii::mapN(d->pMeans, d->iFeatureCount, sampleAt(sorterArray[i].second), std::plus<double>());
-  Pii::mapN(d->pMeans, d->iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/sampleCount));
+public:
+  Builder(PiiKdTree* tree,
+          FeatureSorter* sorters,
+          const PiiParallelPolicy& policy,
+          PiiProgressController* controller) :
+    _pTree(tree),
+    _pSorters(sorters),
+    _iThreadCount(policy.threadCount()),
+    _bParallel(PiiParallelPolicy(_iThreadCount, 1).stripCount(2) > 1),
+    _iSampleCount(PiiSampleSet::sampleCount(tree->d->modelSet)),
+    _pController(controller)
+  {}
+
+  /* Appends the subtree of sampleCount samples starting at start to
+     nodes. Inner nodes refer to their larger children with indices
+     relative to the beginning of nodes.
+   */
+  void createNode(QVector<Node>& nodes, int start, int sampleCount);
 
-  // Sum of squared differences to mean = variance
-  for (int i=0; i<sampleCount; ++i)
+  bool isInterrupted() const { return _iInterrupted.load() != 0; }
+
+private:
+  // Builds the two branches of a node concurrently.
+  struct BranchFunction
+  {
+    void operator() (int firstBranch, int endBranch)
     {
-      Sample sample = sampleAt(sorterArray[i].second);
-      for (int j=0; j<d->iFeatureCount; ++j)
-        d->pVars[j] += Pii::square(sample[j] - d->pMeans[j]);
+      for (int i=firstBranch; i<endBranch; ++i)
+        pBuilder->createNode(aNodes[i], aStarts[i], aCounts[i]);
     }
-  Pii::mapN(d->pVars, d->iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/sampleCount));
 
-  // Return the index of the dimension with max variance.
-  return Pii::findSpecialValue(d->pVars, d->pVars + d->iFeatureCount,
-                               std::greater<T>(),
-                               Pii::Identity<T>()) - d->pVars;
-}
+    Builder* pBuilder;
+    QVector<Node> aNodes[2];
+    int aStarts[2], aCounts[2];
+  };
+
+  struct SmallerThan
+  {
+    SmallerThan(T v) : value(v) {}
+    bool operator() (const FeatureSorter& sorter) const { return sorter.first < value; }
+    T value;
+  };
+
+  // Branches smaller than this are not worth a task of their own.
+  enum { MinParallelSamples = 4096, MedianSampleSize = 255 };
+
+  int split(FeatureSorter* sorters, int sampleCount, T* splitValue);
+  void appendNodes(QVector<Node>& nodes, const QVector<Node>& branch);
+  void checkProgress(int finishedSamples);
+
+  PiiKdTree* _pTree;
+  FeatureSorter* _pSorters;
+  const int _iThreadCount;
+  const bool _bParallel;
+  const int _iSampleCount;
+  PiiProgressController* _pController;
+  PiiAtomicInt _iFinishedSamples, _iInterrupted, _iChecking;
+};
 
 template <class SampleSet>
-typename PiiKdTree<SampleSet>::Node* PiiKdTree<SampleSet>::createNode(FeatureSorter* sorterArray,
-                                                                      int sampleCount,
-                                                                      int depth,
-                                                                      PiiProgressController* controller)
+void PiiKdTree<SampleSet>::Builder::createNode(QVector<Node>& nodes, int start, int sampleCount)
 {
-  if (sampleCount == 0)
-    return 0;
-  else if (sampleCount == 1)
-    return new Node(sorterArray[0].second);
+  if (isInterrupted())
+    return;
+
+  const int iNode = nodes.size();
+  if (sampleCount <= _pTree->d->iBucketSize)
+    {
+      nodes.append(Node(-1, start, sampleCount));
+      checkProgress(_iFinishedSamples += sampleCount);
+      return;
+    }
 
+  FeatureSorter* pSorters = _pSorters + start;
   // Select the dimension that best splits the remaining samples.
-  int iSplitDimension = selectDimension(sorterArray, sampleCount, depth);
+  const int iSplitDimension = _pTree->selectDimension(pSorters, sampleCount);
 
   // Collect the features on the selected dimension.
   for (int i=0; i<sampleCount; ++i)
-    sorterArray[i].first = sampleAt(sorterArray[i].second)[iSplitDimension];
+    pSorters[i].first = _pTree->sampleAt(pSorters[i].second)[iSplitDimension];
 
-  // Partial sort. Median is now at the center of the array.
-  Pii::fastMedian(sorterArray, sampleCount);
+  T splitValue;
+  const int iHalf = split(pSorters, sampleCount, &splitValue);
+  nodes.append(Node(iSplitDimension, 0, 0, splitValue));
 
-  int iHalf = (sampleCount-1) / 2;
+  if (_bParallel && sampleCount >= MinParallelSamples)
+    {
+      BranchFunction function;
+      function.pBuilder = this;
+      function.aStarts[0] = start;
+      function.aCounts[0] = iHalf;
+      function.aStarts[1] = start + iHalf;
+      function.aCounts[1] = sampleCount - iHalf;
+      Pii::forEachStrip(2, function, PiiParallelPolicy(_iThreadCount, 1));
+      appendNodes(nodes, function.aNodes[0]);
+      nodes[iNode].index = nodes.size();
+      appendNodes(nodes, function.aNodes[1]);
+    }
+  else
+    {
+      createNode(nodes, start, iHalf);
+      nodes[iNode].index = nodes.size();
+      createNode(nodes, start + iHalf, sampleCount - iHalf);
+    }
+}
 
-  ++depth;
+template <class SampleSet>
+int PiiKdTree<SampleSet>::Builder::split(FeatureSorter* sorters, int sampleCount, T* splitValue)
+{
+  /* Large branches are split at the median of evenly spaced samples.
+     Samples smaller than it go to the smaller branch. This is a
+     single linear pass and still balances the tree well.
+   */
+  if (sampleCount > 4 * MedianSampleSize)
+    {
+      FeatureSorter aSubset[MedianSampleSize];
+      for (int i=0; i<MedianSampleSize; ++i)
+        aSubset[i] = sorters[int(qint64(sampleCount) * i / MedianSampleSize)];
+      std::nth_element(aSubset, aSubset + MedianSampleSize/2, aSubset + MedianSampleSize);
+      const T pivot = aSubset[MedianSampleSize/2].first;
+      FeatureSorter* pSplit = std::partition(sorters, sorters + sampleCount, SmallerThan(pivot));
+      // An empty smaller branch means that the pivot is the minimum.
+      // Fall back to exact median to avoid a zero-sized split.
+      if (pSplit != sorters)
+        {
+          *splitValue = pivot;
+          return pSplit - sorters;
+        }
+    }
 
-  // Exception safety
-  PiiSmartPtr<Node> smaller(createNode(sorterArray, iHalf, depth, controller));
-  PiiSmartPtr<Node> larger(createNode(sorterArray + iHalf + 1, sampleCount - iHalf - 1, depth, controller));
+  // Partial sort. Everything before the median is at most and
+  // everything after it at least the median.
+  const int iHalf = sampleCount / 2;
+  std::nth_element(sorters, sorters + iHalf, sorters + sampleCount);
+  *splitValue = sorters[iHalf].first;
+  return iHalf;
+}
 
-  PII_TRY_CONTINUE(controller, NAN);
+template <class SampleSet>
+void PiiKdTree<SampleSet>::Builder::appendNodes(QVector<Node>& nodes, const QVector<Node>& branch)
+{
+  const int iOffset = nodes.size();
+  nodes.reserve(iOffset + branch.size());
+  for (int i=0; i<branch.size(); ++i)
+    {
+      nodes.append(branch[i]);
+      if (branch[i].splitDimension >= 0)
+        nodes.last().index += iOffset;
+    }
+}
 
-  int iSampleIndex = sorterArray[iHalf].second;
-  return new Node(iSampleIndex,
-                  iSplitDimension,
-                  sampleAt(iSampleIndex)[iSplitDimension],
-                  smaller.release(),
-                  larger.release());
+template <class SampleSet>
+void PiiKdTree<SampleSet>::Builder::checkProgress(int finishedSamples)
+{
+  if (_pController == 0)
+    return;
+  // Only one thread at a time may talk to the controller. The others
+  // skip the check.
+  if (++_iChecking == 1 &&
+      !_pController->canContinue(double(finishedSamples) / _iSampleCount))
+    _iInterrupted = 1;
+  --_iChecking;
 }
 
 template <class SampleSet>
-int PiiKdTree<SampleSet>::findClosestMatch(Sample sample,
-                                           double* distance) const
+void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
+                                     PiiProgressController* controller)
 {
-  QPair<double,int> minimum(INFINITY, -1);
-  if (d->pRoot != 0)
-    findClosestMatches(d->pRoot, sample, minimum);
-  if (distance != 0)
-    *distance = minimum.first;
-  return minimum.second;
+  buildTree(modelSet, PiiParallelPolicy::sequential(), controller);
 }
 
 template <class SampleSet>
-PiiClassification::MatchList PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
-                                                                      int n) const
+void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
+                                     const PiiParallelPolicy& policy,
+                                     PiiProgressController* controller)
 {
-  PiiClassification::MatchList heap;
+  const int iBucketSize = d->iBucketSize;
+  d->release();
+  d = new Data(iBucketSize);
+  const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
+  d->iFeatureCount = PiiSampleSet::featureCount(modelSet);
+  if (d->iFeatureCount == 0 || iSampleCount == 0)
+    return;
 
-  if (d->pRoot == 0)
-    return heap;
+  QVector<FeatureSorter> vecSorters(iSampleCount);
+  for (int i=0; i<iSampleCount; ++i)
+    vecSorters[i].second = i;
 
-  heap.fill(qMin(sampleCount(), n), qMakePair(double(INFINITY), -1));
+  d->modelSet = modelSet;
+  // A full binary tree with buckets of at least half the maximum size.
+  d->vecNodes.reserve(4 * iSampleCount / iBucketSize + 1);
+  Builder builder(this, vecSorters.data(), policy, controller);
+  builder.createNode(d->vecNodes, 0, iSampleCount);
+  if (builder.isInterrupted())
+    {
+      d->vecNodes.clear();
+      d->modelSet = SampleSet();
+      PII_THROW(PiiClassificationException, PiiClassificationException::LearningInterrupted);
+    }
 
-  findClosestMatches(d->pRoot, sample, heap);
-  // Ascending order -> first is the best match
-  heap.sort();
-  return heap;
+  d->vecIndices.resize(iSampleCount);
+  for (int i=0; i<iSampleCount; ++i)
+    d->vecIndices[i] = vecSorters[i].second;
+  packBuckets();
 }
 
-template <class SampleSet> template <class MatchList>
-void PiiKdTree<SampleSet>::findClosestMatches(Node* node,
-                                              Sample sample,
-                                              MatchList& matchList) const
+template <class SampleSet> void PiiKdTree<SampleSet>::packBuckets()
 {
-  if (node == 0)
-    return;
+  const int iSampleCount = d->vecIndices.size();
+  d->bucketSet = PiiSampleSet::create<SampleSet>(iSampleCount, d->iFeatureCount);
+  for (int i=0; i<iSampleCount; ++i)
+    PiiSampleSet::setSampleAt(d->bucketSet, i, sampleAt(d->vecIndices[i]));
+}
 
-  // Measure distance to the sample at this node.
-  double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
-  /* Update minimum distance if needed. In k-NN search, a priority
-     queue of k best matches are maintained. The first element in the
-     queue is the current estimate of the kth closest match.
-   */
-  if (dDistance < distanceLimit(matchList))
-    updateLimit(dDistance, node->sampleIndex, matchList);
+template <class SampleSet>
+int PiiKdTree<SampleSet>::selectDimension(const FeatureSorter* sorterArray,
+                                          int sampleCount) const
+{
+  // At most 128 evenly spaced samples are enough to estimate the
+  // spread of large branches.
+  const int iStep = qMax(1, sampleCount / 128),
+    iFeatureCount = d->iFeatureCount;
+  QVector<double> vecMeans(iFeatureCount), vecVars(iFeatureCount);
+  double* pMeans = vecMeans.data(), *pVars = vecVars.data();
+  int iUsed = 0;
+  // Calculate mean for each dimension.
+  for (int i=0; i<sampleCount; i += iStep, ++iUsed)
+    Pii::mapN(pMeans, iFeatureCount, sampleAt(sorterArray[i].second), std::plus<double>());
+  Pii::mapN(pMeans, iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/iUsed));
 
-  // Recursive descend
-  T featureValue = sample[node->splitDimension];
-  // Decide search order based on the selected feature value.
-  if (featureValue <= node->featureValue)
-    {
-      this->findClosestMatches(node->smaller, sample, matchList);
-      /* If the closest child could be on the other side of this
-         splitting hyperplane, we need to search the other side too.
-         In the case of a k-NN search take the kth closest node
-         instead of the closest one.
-      */
-      if (Pii::square(node->featureValue - featureValue) <= distanceLimit(matchList))
-        findClosestMatches(node->larger, sample, matchList);
-    }
-  else
+  // Sum of squared differences to mean = variance
+  for (int i=0; i<sampleCount; i += iStep)
     {
-      findClosestMatches(node->larger, sample, matchList);
-      if (Pii::square(node->featureValue - featureValue) <= distanceLimit(matchList))
-        findClosestMatches(node->smaller, sample, matchList);
+      Sample sample = sampleAt(sorterArray[i].second);
+      for (int j=0; j<iFeatureCount; ++j)
+        pVars[j] += Pii::square(sample[j] - pMeans[j]);
     }
+
+  // Return the index of the dimension with max variance.
+  return Pii::findSpecialValue(pVars, pVars + iFeatureCount,
+                               std::greater<double>(),
+                               Pii::Identity<double>()) - pVars;
 }
 
 template <class SampleSet>
 int PiiKdTree<SampleSet>::findClosestMatch(Sample sample,
-                                           int maxEvaluations,
                                            double* distance) const
 {
-  if (d->pRoot == 0)
-    return -1;
+  return findClosestMatch(sample, INT_MAX, distance);
+}
+
+template <class SampleSet>
+PiiClassification::MatchList PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
+                                                                      int n) const
+{
+  return findClosestMatches(sample, n, INT_MAX);
+}
 
+template <class SampleSet>
+int PiiKdTree<SampleSet>::findClosestMatch(Sample sample,
+                                           int maxEvaluations,
+                                           double* distance) const
+{
   QPair<double,int> pair(INFINITY, -1);
 
-  findClosestMatches(sample, maxEvaluations, pair);
+  if (!d->vecNodes.isEmpty())
+    findClosestMatches(sample, maxEvaluations, pair);
 
   if (distance != 0)
     *distance = pair.first;
@@ -231,95 +342,109 @@ PiiClassification::MatchList PiiKdTree<SampleSet>::findClosestMatches(Sample sam
                                                                       int maxEvaluations) const
 {
   PiiClassification::MatchList heap;
-  if (d->pRoot == 0)
+  if (d->vecNodes.isEmpty() || n <= 0)
     return heap;
 
   heap.fill(qMin(sampleCount(), n), qMakePair(double(INFINITY), -1));
 
   findClosestMatches(sample, maxEvaluations, heap);
 
+  // Ascending order -> first is the best match
   heap.sort();
   return heap;
 }
 
+template <class SampleSet> template <class MatchList>
+void PiiKdTree<SampleSet>::searchBucket(const Node& bucket,
+                                        Sample sample,
+                                        MatchList& matches) const
+{
+  Sample aModels[MaxBucketSize];
+  double aDistances[MaxBucketSize];
+  const SampleSet& bucketSet = d->bucketSet;
+  for (int i=0; i<bucket.count; ++i)
+    aModels[i] = PiiSampleSet::sampleAt(bucketSet, bucket.index + i);
+  PiiClassification::measureDistances(sample, aModels, bucket.count, d->iFeatureCount,
+                                      d->measure, distanceLimit(matches), aDistances);
+  /* Update minimum distance if needed. In k-NN search, a priority
+     queue of k best matches are maintained. The first element in the
+     queue is the current estimate of the kth closest match.
+   */
+  const int* pIndices = d->vecIndices.constData() + bucket.index;
+  for (int i=0; i<bucket.count; ++i)
+    if (aDistances[i] < distanceLimit(matches))
+      updateLimit(aDistances[i], pIndices[i], matches);
+}
+
 template <class SampleSet> template <class MatchList>
 void PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
                                               int maxEvaluations,
                                               MatchList& matches) const
 {
-  Node* pNode = d->pRoot;
-
-  BranchList lstBranches;
+  /* Descend to the bucket the sample falls into and collect the path
+     not taken at each inner node into a priority queue. The key is a
+     lower bound of the distance between the sample and anything in
+     the branch. Then continue from the closest branch until all
+     remaining branches are farther than the current limit (exact
+     answer) or the evaluation budget runs out.
+   */
+  const Node* pNodes = d->vecNodes.constData();
+  PiiHeap<BranchSorter> branches(0, Pii::InverseHeap);
+  branches.append(BranchSorter(0.0, 0));
 
-  for (;;)
+  while (branches.size() > 0)
     {
-      // Search recursively to a leaf node. In backtracking,
-      // lstBranches will be filled with nodes that need to be
-      // evaluated to be sure about the NN.
-      findPossibleBranches(pNode, sample, &maxEvaluations, lstBranches, matches);
-      // No more choices found -> found the exact NN
-      // No more evaluations allowed -> don't know the NN for sure,
-      // but who cares?
-      if (lstBranches.isEmpty() || maxEvaluations <= 0)
+      const BranchSorter branch = branches.take(0);
+      // All remaining branches are at least this far.
+      if (branch.first > distanceLimit(matches))
+        break;
+
+      int iNode = branch.second;
+      while (pNodes[iNode].splitDimension >= 0)
+        {
+          const Node& node = pNodes[iNode];
+          const double dDiff = double(sample[node.splitDimension]) - double(node.featureValue);
+          int iNear = iNode + 1, iFar = node.index;
+          if (dDiff > 0)
+            qSwap(iNear, iFar);
+          /* The other side of the splitting hyperplane is at least as
+             far as the plane itself, and never closer than the branch
+             we are in.
+           */
+          const double dFarDistance = qMax(branch.first, dDiff * dDiff);
+          if (dFarDistance <= distanceLimit(matches))
+            branches.append(BranchSorter(dFarDistance, iFar));
+          iNode = iNear;
+        }
+
+      searchBucket(pNodes[iNode], sample, matches);
+      maxEvaluations -= pNodes[iNode].count;
+      if (maxEvaluations <= 0)
         break;
-      // Otherwise find the closest node and continue search from there.
-      typename BranchList::iterator i = Pii::findSpecialValue(lstBranches.begin(),
-                                                              lstBranches.end(),
-                                                              std::less<BranchSorter>(),
-                                                              Pii::Identity<BranchSorter>());
-      lstBranches.erase(i);
-      pNode = i->second;
     }
 }
 
-
-template <class SampleSet> template <class MatchList>
-void PiiKdTree<SampleSet>::findPossibleBranches(Node* node,
-                                                Sample sample,
-                                                int *maxEvaluations,
-                                                BranchList& branchList,
-                                                MatchList& matches) const
+template <class SampleSet> template <class Stream>
+void PiiKdTree<SampleSet>::print(Stream& stream, int node, int level) const
 {
-  if (node == 0 || *maxEvaluations <= 0)
-    return;
-
-  /* This function is equivalent to the normal recursive tree look-up,
-     but instead of inspecting each possible branch when unwinding the
-     stack, all possible branches are collected into a priority queue
-     and inspected in the order of increasing distance from the query
-     sample.
-   */
-  --*maxEvaluations;
-
-  double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
-
-  if (dDistance < distanceLimit(matches))
-    updateLimit(dDistance, node->sampleIndex, matches);
-  /* Prune branches that are no longer possible.
-     for (typename BranchList::iterator i=branchList.begin(); i != branchList.end(); )
-     {
-     T diff = sample[i->second->splitDimension] - i->second->featureValue;
-     double dSqDiff = Pii::square(diff);
-     if (Pii::square(diff) > distanceLimit(matches))
-     i = branchList.erase(i);
-     else
-     ++i;
-     }
-  */
-
-  T featureValue = sample[node->splitDimension];
-  if (featureValue <= node->featureValue)
+  const Node& n = d->vecNodes.at(node);
+  for (int i=level; i--; )
+    stream << "  ";
+  if (n.splitDimension < 0)
     {
-      findPossibleBranches(node->smaller, sample, maxEvaluations, branchList, matches);
-      // The NN could be on the other branch -> store to possible
-      // branches and let the caller to evaluate it if needed.
-      if (node->larger != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->larger));
+      stream << "models[";
+      for (int i=0; i<n.count; ++i)
+        {
+          if (i > 0)
+            stream << ", ";
+          stream << d->vecIndices.at(n.index + i);
+        }
+      stream << "]\n";
     }
   else
     {
-      findPossibleBranches(node->larger, sample, maxEvaluations, branchList, matches);
-      if (node->smaller != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->smaller));
+      stream << "[" << n.splitDimension << "] <= " << n.featureValue << "\n";
+      print(stream, node + 1, level + 1);
+      print(stream, n.index, level + 1);
     }
 }
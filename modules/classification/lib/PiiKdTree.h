@@ -16,8 +16,8 @@
 #ifndef _PIIKDTREE_H
 #define _PIIKDTREE_H
 
-#include <QLinkedList>
 #include <QPair>
+#include <QVector>
 #include <PiiProgressController.h>
 #include "PiiSampleSet.h"
 #include "PiiClassification.h"
@@ -25,13 +25,14 @@
 #include <PiiSerialization.h>
 #include <PiiNameValuePair.h>
 #include <PiiSharedD.h>
+#include <PiiParallel.h>
+#include <PiiAtomicInt.h>
 
 /**
  * K-dimensional tree. The kd-tree is a binary tree in which every
- * node is a k-dimensional point. Each non-leaf node in the tree
- * splits the k-dimensional hyperspace with a hyperplane that is
- * aligned to one of the axes and passes through the point in the
- * node.
+ * inner node splits the k-dimensional hyperspace with a hyperplane
+ * that is aligned to one of the axes. The leaves of the tree are
+ * *buckets* that contain a small number of samples each.
  *
  * The kd-tree can be used to quickly look up nearest neighbors in
  * large databases. For randomly distributed data, the complexity of
@@ -46,31 +47,63 @@
  * that performs approximate NN search. (k-NN search is also
  * supported.) Instead of recursively checking all possible branches
  * of the tree the approximate algorithm orders the look-ups so that
- * the most likely ones come first. The algorithm stops when the exact
- * nearest neighbor has been found or a predefined maximum number of
- * look-ups have been performed. This makes it possible to set a hard
- * upper bound for the search time while still returning the nearest
- * neighbor(s) with a high probability.
+ * the most likely ones come first (best bin first). The algorithm
+ * stops when the exact nearest neighbor has been found or a
+ * predefined maximum number of samples have been evaluated. This
+ * makes it possible to set a hard upper bound for the search time
+ * while still returning the nearest neighbor(s) with a high
+ * probability.
+ *
+ * The tree is stored in a single array in depth-first order so that
+ * the smaller child of a node always follows its parent in memory.
+ * The samples of each bucket are copied next to each other in the
+ * order of the leaves. Therefore, a query touches a few contiguous
+ * memory blocks instead of hopping between individually allocated
+ * nodes and randomly ordered model samples. The price is that the
+ * tree holds a copy of the model set in addition to the original
+ * one.
  *
  * PiiKdTree only works with geometric distances. Thus, there is no
  * option to use user-defined distance measures. If you need a special
- * distance measure, exhaustive search is currently the only viable
- * option.
+ * distance measure, use PiiHnswIndex or exhaustive search.
  *
  */
 template <class SampleSet> class PiiKdTree
 {
   friend struct PiiSerialization::Accessor;
-  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  template <class Archive> void serialize(Archive& archive, const unsigned int version)
   {
-    archive & PII_NVP("root", d->pRoot);
+    if (version == 0)
+      {
+        // Old pointer-linked trees are read and thrown away. The tree
+        // is rebuilt from the model samples.
+        LegacyNode* pRoot = 0;
+        archive & PII_NVP("root", pRoot);
+        delete pRoot;
+        int iFeatureCount = 0;
+        archive & PII_NVP("features", iFeatureCount);
+        SampleSet modelSet;
+        archive & PII_NVP("models", modelSet);
+        buildTree(modelSet);
+        return;
+      }
+    archive & PII_NVP("bucketSize", d->iBucketSize);
     archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("nodes", d->vecNodes);
+    archive & PII_NVP("indices", d->vecIndices);
     archive & PII_NVP("models", d->modelSet);
+    if (Archive::InputArchive)
+      packBuckets();
   }
 
 public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
 
+  /**
+   * The maximum number of samples in a bucket.
+   */
+  enum { MaxBucketSize = 64 };
+
   /**
    * Constructs an empty kd-tree.
    */
@@ -94,20 +127,56 @@ public:
    */
   PiiKdTree& operator= (const PiiKdTree& other);
 
+  /**
+   * Sets the maximum number of samples in a leaf node. Larger
+   * buckets make the tree shallower and let the distances be
+   * calculated in longer runs over contiguous memory, but fewer
+   * samples can be pruned. The value is clamped to [1,
+   * MaxBucketSize] and takes effect when the tree is built next
+   * time. The default is 8.
+   */
+  void setBucketSize(int bucketSize);
+  /**
+   * Returns the maximum number of samples in a leaf node.
+   */
+  int bucketSize() const;
+
   /**
    * Deletes the old kd-tree (if any) and rebuilds a new one based on
-   * the given model samples.
+   * the given model samples. Large branches are split at the median
+   * of a subset of their samples, which avoids a full partial sort
+   * at each node. This function uses only the calling thread.
    *
    * @param modelSet model samples
    *
    * @param controller an optional external controller that can be
-   * used to stop building the tree on user request.
+   * used to stop building the tree on user request. The controller
+   * receives the fraction of samples already placed into buckets.
    *
    * @exception PiiClassificationException& if the algorithm was
    * interrupted.
    */
   void buildTree(const SampleSet& modelSet, PiiProgressController* controller = 0);
 
+  /**
+   * Builds the tree concurrently according to *policy*. The two
+   * branches of large nodes are built as separate tasks whose
+   * results are merged into the flat node array. The resulting tree
+   * is identical to the one built sequentially.
+   *
+   * The controller may be called from any of the worker threads, but
+   * never by two threads at the same time.
+   *
+   * ~~~(c++)
+   * PiiKdTree<PiiMatrix<float> > tree;
+   * // Use all cores
+   * tree.buildTree(matModels, PiiParallelPolicy(), pController);
+   * ~~~
+   */
+  void buildTree(const SampleSet& modelSet,
+                 const PiiParallelPolicy& policy,
+                 PiiProgressController* controller = 0);
+
   /**
    * Returns the index of the nearest neighbor in the model set.
    *
@@ -132,12 +201,13 @@ public:
    *
    * @param sample input feature vector
    *
-   * @param maxEvaluations the maximum number of node look-ups to be
-   * done. If you set this value to `log`(N), the algorithm will do a
-   * simple best first search to the first leaf node. Usually, it is a
-   * good idea to give the algorithm a bit more time to find a good
-   * match. If you set this value to the size of the model set, the
-   * exact nearest neighbor will be returned.
+   * @param maxEvaluations the maximum number of model samples to
+   * compare *sample* to. The search is finished at the first bucket
+   * that exceeds the limit, which means that at least one bucket
+   * will always be evaluated. Usually, it is a good idea to give the
+   * algorithm a few buckets' worth of time to find a good match. If
+   * you set this value to the size of the model set, the exact
+   * nearest neighbor will be returned.
    *
    * @param distance an optional output-value argument that will store
    * the *squared* geometric distance to the closest neighbor of
@@ -164,20 +234,22 @@ public:
 
   /**
    * Returns *n* matches that are probably the closest of *sample*.
-   * This function stops after *maxEvaluations* most probable nodes
-   * have been checked and may not return the exact nearest neighbors.
+   * This function stops after *maxEvaluations* model samples in the
+   * most probable buckets have been checked and may not return the
+   * exact nearest neighbors.
    *
    * @param sample input feature vector
    *
    * @param n the number of closest matches to return.
    *
-   * @param maxEvaluations the maximum number of node look-ups to be
-   * done. A suitable value is about *n* * `log`(N), where N is the
-   * number of samples in the model set.
+   * @param maxEvaluations the maximum number of model samples to
+   * compare *sample* to. A suitable value is about *n* * `log`(N),
+   * where N is the number of samples in the model set.
    *
-   * @return the *n* closest matches. Note that if either the model
-   * data set or *maxEvaluations* is smaller than *n*, less than
-   * *n* matches may be returned.
+   * @return the *n* closest matches. Note that if the model data
+   * set is smaller than *n*, less than *n* matches may be returned.
+   * If *maxEvaluations* is smaller than *n*, some of the returned
+   * matches may have an infinite distance and a negative index.
    */
   PiiClassification::MatchList findClosestMatches(Sample sample,
                                                   int n,
@@ -192,7 +264,11 @@ public:
    * Prints the structure of the k-d tree to *stream*. This function
    * is mainly for informational and debugging purposes.
    */
-  template <class Stream> void print(Stream& stream) { d->pRoot->print(stream); }
+  template <class Stream> void print(Stream& stream) const
+  {
+    if (!d->vecNodes.isEmpty())
+      print(stream, 0, 0);
+  }
 
 private:
   typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType T;
@@ -201,26 +277,43 @@ private:
   {
     template <class Archive> void serialize(Archive& archive, const unsigned int)
     {
-      archive & PII_NVP("index", sampleIndex);
       archive & PII_NVP("dim", splitDimension);
+      archive & PII_NVP("index", index);
+      archive & PII_NVP("count", count);
       archive & PII_NVP("value", featureValue);
-      archive & PII_NVP("smaller", smaller);
-      archive & PII_NVP("larger", larger);
     }
 
-    Node(int index=0, int dim = 0, T value = 0, Node* s = 0, Node* l = 0) :
-      sampleIndex(index), splitDimension(dim), featureValue(value), smaller(s), larger(l)
+    Node(int dim = -1, int i = 0, int c = 0, T value = 0) :
+      splitDimension(dim), index(i), count(c), featureValue(value)
     {}
 
-    Node(const Node& other) :
-      sampleIndex(other.sampleIndex),
-      splitDimension(other.splitDimension),
-      featureValue(other.featureValue),
-      smaller(other.smaller != 0 ? new Node(*other.smaller) : 0),
-      larger(other.larger != 0 ? new Node(*other.larger) : 0)
-    {}
+    // Split dimension, or -1 if this node is a bucket.
+    int splitDimension;
+    // An inner node stores the index of the larger child. (The
+    // smaller one follows its parent.) A bucket stores the index of
+    // its first sample in vecIndices and bucketSet.
+    int index;
+    // The number of samples in a bucket.
+    int count;
+    // Samples in the smaller branch are at most and those in the
+    // larger branch at least this on splitDimension.
+    T featureValue;
+  };
+
+  // The node format of serialization version 0.
+  struct LegacyNode
+  {
+    template <class Archive> void serialize(Archive& archive, const unsigned int)
+    {
+      archive & PII_NVP("index", sampleIndex);
+      archive & PII_NVP("dim", splitDimension);
+      archive & PII_NVP("value", featureValue);
+      archive & PII_NVP("smaller", smaller);
+      archive & PII_NVP("larger", larger);
+    }
 
-    ~Node()
+    LegacyNode() : sampleIndex(0), splitDimension(0), featureValue(0), smaller(0), larger(0) {}
+    ~LegacyNode()
     {
       delete larger;
       delete smaller;
@@ -228,70 +321,59 @@ private:
 
     int sampleIndex, splitDimension;
     T featureValue;
-    Node* smaller;
-    Node* larger;
-
-    template <class Stream> void print(Stream& stream, int level = 0) const
-    {
-      for (int i=level; i--; )
-        stream << "  ";
-      stream << "model[" << sampleIndex << "][" << splitDimension << "] = " << featureValue << "\n";
-      if (smaller)
-        smaller->print(stream, level+1);
-      if (larger)
-        larger->print(stream, level+1);
-    }
+    LegacyNode* smaller;
+    LegacyNode* larger;
   };
 
   // Stores feature value and the index of the sample it belongs to.
   typedef QPair<T,int> FeatureSorter;
-  // Stores a pointer to a node and the distance to it.
-  typedef QPair<double,Node*> BranchSorter;
-  typedef QLinkedList<BranchSorter> BranchList;
+  // Stores a lower bound of the distance to a subtree and the index
+  // of its root node.
+  typedef QPair<double,int> BranchSorter;
 
   class Data : public PiiSharedD<Data>
   {
   public:
-    Data() : pRoot(0), iFeatureCount(0), pMeans(0), pVars(0) {}
+    Data(int bucketSize = 8) : iBucketSize(bucketSize), iFeatureCount(0) {}
     Data(const Data& other) :
-      pRoot(new Node(*other.pRoot)),
+      PiiSharedD<Data>(),
+      iBucketSize(other.iBucketSize),
       iFeatureCount(other.iFeatureCount),
-      pMeans(0), pVars(0),
-      modelSet(other.modelSet)
+      vecNodes(other.vecNodes),
+      vecIndices(other.vecIndices),
+      modelSet(other.modelSet),
+      bucketSet(other.bucketSet)
     {}
 
-    Node* pRoot;
+    int iBucketSize;
     int iFeatureCount;
-    double* pMeans, *pVars;
+    QVector<Node> vecNodes;
+    // Model indices in the order of the buckets.
+    QVector<int> vecIndices;
     SampleSet modelSet;
+    // A copy of modelSet in the order of vecIndices.
+    SampleSet bucketSet;
     PiiSquaredGeometricDistance<Sample> measure;
   } *d;
 
   // Tree construction
-  Node* createNode(FeatureSorter* sorterArray,
-                   int sampleCount,
-                   int depth,
-                   PiiProgressController* controller);
-  int selectDimension(FeatureSorter* sorterArray,
-                      int sampleCount,
-                      int depth);
-
-  // Exact (k-)NN search
-  template <class MatchList>
-  void findClosestMatches(Node* node,
-                          Sample sample,
-                          MatchList& matches) const;
-  // Approximate (k-)NN search
+  class Builder;
+  friend class Builder;
+  int selectDimension(const FeatureSorter* sorterArray,
+                      int sampleCount) const;
+  void packBuckets();
+
+  // (k-)NN search. Exact search has no limit on evaluations.
   template <class MatchList>
   void findClosestMatches(Sample sample,
                           int maxEvaluations,
                           MatchList& matches) const;
   template <class MatchList>
-  void findPossibleBranches(Node* node,
-                            Sample sample,
-                            int* maxEvaluations,
-                            BranchList& branchList,
-                            MatchList& matches) const;
+  void searchBucket(const Node& bucket,
+                    Sample sample,
+                    MatchList& matches) const;
+
+  template <class Stream> void print(Stream& stream, int node, int level) const;
 
   // Match list helper functions. In NN search "list" is actually a pair.
   static inline void updateLimit(double distance, int index, QPair<double,int>& pair)
@@ -311,6 +393,9 @@ private:
   inline Sample sampleAt(int index) const { return PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->modelSet), index); }
 };
 
+// Version 1 stores the tree as a flat array of nodes and buckets.
+PII_SERIALIZATION_VERSION_TEMPLATE(PiiKdTree, 1);
+
 #include "PiiKdTree-templates.h"
 
 #endif //_PIIKDTREE_H
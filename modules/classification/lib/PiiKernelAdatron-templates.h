@@ -18,11 +18,13 @@
 #endif
 
 #include "PiiGaussianKernel.h"
+#include "PiiKernelCache.h"
 
 template <class SampleSet> PiiKernelAdatron<SampleSet>::Data::Data() :
   pKernel(new PII_POLYMORPHIC_KERNEL(PiiGaussianKernel)),
   bConverged(false),
   iMaxIterations(100),
+  iKernelCacheSize(256),
   dTheta(0),
   dLearningRate(1),
   dConvergenceThreshold(1e-2)
@@ -48,11 +50,21 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
   const int iSamples = PiiSampleSet::sampleCount(samples),
     iFeatures = PiiSampleSet::featureCount(samples);
 
-  PiiMatrix<double> matKernel(PiiClassification::calculateDistanceMatrix(samples,
-                                                                         *d->pKernel,
-                                                                         true, true));
+  PiiKernelCache<SampleSet> cache(samples, *d->pKernel, qint64(d->iKernelCacheSize) << 20);
   QVector<double> vecWeights(iSamples, 1.0);
-  QVector<double> vecZ(iSamples);
+  /* The weighted sum of kernel values for each sample. Since the
+     kernel is symmetric, changing weight i changes the sums by the
+     change times row i of the kernel matrix. Kernel values are thus
+     only needed for samples whose weight changes.
+   */
+  QVector<double> vecZ(iSamples, 0.0);
+  for (int j=0; j<iSamples; ++j)
+    {
+      const double* pKernelRow = cache.row(j);
+      const double dLabel = labels[j] - 0.5;
+      for (int i=0; i<iSamples; ++i)
+        vecZ[i] += dLabel * pKernelRow[i];
+    }
 
   d->vecWeights.clear();
   d->vecLabels.clear();
@@ -66,11 +78,7 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
       dMinZ = INFINITY, dMaxZ = -INFINITY;
       for (int i=0; i<iSamples; ++i)
         {
-          const double* pKernelRow = matKernel.constRowBegin(i);
-          double dSum = 0;
-          for (int j=0; j<iSamples; ++j, ++pKernelRow)
-            dSum += (labels[j] - 0.5) * *pKernelRow * vecWeights[j];
-          vecZ[i] = dSum;
+          const double dSum = vecZ[i];
           double dDelta;
           if (labels[i] == 1)
             {
@@ -84,7 +92,15 @@ void PiiKernelAdatron<SampleSet>::learn(const SampleSet& samples,
                 dMaxZ = dSum;
               dDelta = dLearningRate * (1 + dSum*2 - dTheta);
             }
-          vecWeights[i] = qMax(0.0, vecWeights[i] + dDelta);
+          const double dNewWeight = qMax(0.0, vecWeights[i] + dDelta);
+          if (dNewWeight != vecWeights[i])
+            {
+              const double dChange = (labels[i] - 0.5) * (dNewWeight - vecWeights[i]);
+              vecWeights[i] = dNewWeight;
+              const double* pKernelRow = cache.row(i);
+              for (int j=0; j<iSamples; ++j)
+                vecZ[j] += dChange * pKernelRow[j];
+            }
           PII_TRY_CONTINUE(this->controller(), NAN);
         }
       dTheta = dMaxZ + dMinZ;
@@ -129,12 +145,20 @@ double PiiKernelAdatron<SampleSet>::classify(ConstFeatureIterator featureVector)
     {
       const int iSamples = PiiSampleSet::sampleCount(d->supportVectors),
         iFeatures = PiiSampleSet::featureCount(d->supportVectors);
+      enum { BlockSize = 16 };
+      ConstFeatureIterator aSupportVectors[BlockSize];
+      double aKernelValues[BlockSize];
       double dSum = 0;
-      for (int i=0; i<iSamples; ++i)
-        dSum += (d->vecLabels[i]-0.5) * d->vecWeights[i] *
-          (*d->pKernel)(PiiSampleSet::sampleAt(d->supportVectors, i),
-                        featureVector,
-                        iFeatures);
+      // One virtual call per block of support vectors.
+      for (int iStart=0; iStart<iSamples; iStart += BlockSize)
+        {
+          const int iCount = qMin(int(BlockSize), iSamples - iStart);
+          for (int i=0; i<iCount; ++i)
+            aSupportVectors[i] = PiiSampleSet::sampleAt(d->supportVectors, iStart + i);
+          d->pKernel->distances(featureVector, aSupportVectors, iCount, iFeatures, INFINITY, aKernelValues);
+          for (int i=0; i<iCount; ++i)
+            dSum += (d->vecLabels[iStart + i]-0.5) * d->vecWeights[iStart + i] * aKernelValues[i];
+        }
       return dSum > d->dTheta ? 1 : 0;
     }
   return NAN;
@@ -167,5 +191,7 @@ template <class SampleSet> void PiiKernelAdatron<SampleSet>::setLearningRate(dou
 template <class SampleSet> double PiiKernelAdatron<SampleSet>::learningRate() const { return _d()->dLearningRate; }
 template <class SampleSet> void PiiKernelAdatron<SampleSet>::setConvergenceThreshold(double convergenceThreshold) { _d()->dConvergenceThreshold = convergenceThreshold; }
 template <class SampleSet> double PiiKernelAdatron<SampleSet>::convergenceThreshold() const { return _d()->dConvergenceThreshold; }
+template <class SampleSet> void PiiKernelAdatron<SampleSet>::setKernelCacheSize(int kernelCacheSize) { _d()->iKernelCacheSize = qMax(0, kernelCacheSize); }
+template <class SampleSet> int PiiKernelAdatron<SampleSet>::kernelCacheSize() const { return _d()->iKernelCacheSize; }
 template <class SampleSet> SampleSet PiiKernelAdatron<SampleSet>::supportVectors() const { return _d()->supportVectors; }
 template <class SampleSet> void PiiKernelAdatron<SampleSet>::setSupportVectors(const SampleSet& supportVectors) { _d()->supportVectors = supportVectors; }
@@ -177,6 +177,19 @@ public:
    */
   double convergenceThreshold() const;
 
+  /**
+   * Sets the maximum amount of memory used for caching kernel values
+   * during training, in megabytes. If the kernel matrix of the
+   * training set doesn't fit into the cache, kernel values will be
+   * recalculated as needed (see PiiKernelCache). The default value
+   * is 256.
+   */
+  void setKernelCacheSize(int kernelCacheSize);
+  /**
+   * Returns the size of the kernel cache in megabytes.
+   */
+  int kernelCacheSize() const;
+
 private:
   class Data : public PiiLearningAlgorithm<SampleSet>::Data
   {
@@ -185,6 +198,7 @@ private:
     PiiKernelFunction<ConstFeatureIterator>* pKernel;
     bool bConverged;
     int iMaxIterations;
+    int iKernelCacheSize;
     double dTheta, dLearningRate, dConvergenceThreshold;
     QVector<double> vecWeights, vecLabels;
     SampleSet supportVectors;
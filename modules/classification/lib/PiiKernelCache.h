@@ -0,0 +1,224 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIKERNELCACHE_H
+#define _PIIKERNELCACHE_H
+
+#include "PiiKernelFunction.h"
+#include "PiiSampleSet.h"
+
+/**
+ * A cache for the rows of a kernel matrix. Kernel machines such as
+ * PiiKernelPerceptron and PiiKernelAdatron need the kernel function
+ * evaluated between a training sample and all other training samples
+ * over and over again. Storing the whole kernel matrix needs memory
+ * proportional to the square of the number of samples, which limits
+ * the size of the training set. PiiKernelCache stores as many rows as
+ * fit into a given memory budget and discards the least recently used
+ * ones when needed.
+ *
+ * While the cache has free room, a missing row is calculated
+ * together with the following missing rows using
+ * PiiKernelFunction::distanceMatrix(), which is efficient for
+ * kernels that support PiiInnerProductKernelMatrix. Once the cache
+ * is full, single rows are calculated on demand.
+ *
+ * ~~~(c++)
+ * // Use at most 64 MB
+ * PiiKernelCache<PiiMatrix<double> > cache(samples, kernel, 64 << 20);
+ * const double* pRow = cache.row(5);
+ * // pRow[i] = kernel(samples[5], samples[i])
+ * ~~~
+ */
+template <class SampleSet> class PiiKernelCache
+{
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+
+  /**
+   * Creates a cache for the kernel matrix of *samples*. The cache
+   * will keep a reference to *samples* and *kernel*, which must
+   * remain valid while the cache is in use. At most *maxBytes* bytes
+   * will be used for storing kernel values, but at least one row
+   * will always be stored.
+   */
+  PiiKernelCache(const SampleSet& samples,
+                 const PiiKernelFunction<ConstFeatureIterator>& kernel,
+                 qint64 maxBytes);
+
+  /**
+   * Returns row *index* of the kernel matrix. The returned pointer
+   * is valid until the next call to row().
+   */
+  const double* row(int index);
+
+  /**
+   * Returns the number of samples and the length of the rows.
+   */
+  int sampleCount() const { return _iSampleCount; }
+  /**
+   * Returns the maximum number of rows stored at once.
+   */
+  int capacity() const { return _iCapacity; }
+  /**
+   * Returns the number of kernel rows calculated so far.
+   */
+  int calculatedRowCount() const { return _iCalculatedRows; }
+
+private:
+  enum { BlockSize = 32 };
+
+  int takeSlot();
+  void moveToFront(int slot);
+  void unlink(int slot);
+  double* slotData(int slot) { return _vecData.data() + qint64(slot) * _iSampleCount; }
+
+  const PiiKernelFunction<ConstFeatureIterator>& _kernel;
+  int _iSampleCount, _iFeatureCount, _iCapacity, _iUsedSlots, _iCalculatedRows;
+  QVector<ConstFeatureIterator> _vecSamples;
+  QVector<double> _vecData;
+  // Cache slot of each row (-1 if not cached) and the row stored in
+  // each slot.
+  QVector<int> _vecSlotOfRow, _vecRowOfSlot;
+  // A doubly linked list of slots, most recently used first.
+  QVector<int> _vecPrevious, _vecNext;
+  int _iFirst, _iLast;
+
+  PII_DISABLE_COPY(PiiKernelCache);
+};
+
+template <class SampleSet>
+PiiKernelCache<SampleSet>::PiiKernelCache(const SampleSet& samples,
+                                          const PiiKernelFunction<ConstFeatureIterator>& kernel,
+                                          qint64 maxBytes) :
+  _kernel(kernel),
+  _iSampleCount(PiiSampleSet::sampleCount(samples)),
+  _iFeatureCount(PiiSampleSet::featureCount(samples)),
+  _iCapacity(int(qBound(qint64(1),
+                        maxBytes / qMax(qint64(1), qint64(_iSampleCount) * qint64(sizeof(double))),
+                        qint64(qMax(1, _iSampleCount))))),
+  _iUsedSlots(0),
+  _iCalculatedRows(0),
+  _vecSamples(_iSampleCount),
+  _vecData(qint64(_iCapacity) * _iSampleCount),
+  _vecSlotOfRow(_iSampleCount, -1),
+  _vecRowOfSlot(_iCapacity, -1),
+  _vecPrevious(_iCapacity, -1),
+  _vecNext(_iCapacity, -1),
+  _iFirst(-1),
+  _iLast(-1)
+{
+  for (int i=0; i<_iSampleCount; ++i)
+    _vecSamples[i] = PiiSampleSet::sampleAt(samples, i);
+}
+
+template <class SampleSet> void PiiKernelCache<SampleSet>::unlink(int slot)
+{
+  const int iPrevious = _vecPrevious[slot], iNext = _vecNext[slot];
+  if (iPrevious != -1)
+    _vecNext[iPrevious] = iNext;
+  else
+    _iFirst = iNext;
+  if (iNext != -1)
+    _vecPrevious[iNext] = iPrevious;
+  else
+    _iLast = iPrevious;
+}
+
+template <class SampleSet> void PiiKernelCache<SampleSet>::moveToFront(int slot)
+{
+  if (slot == _iFirst)
+    return;
+  unlink(slot);
+  _vecPrevious[slot] = -1;
+  _vecNext[slot] = _iFirst;
+  if (_iFirst != -1)
+    _vecPrevious[_iFirst] = slot;
+  _iFirst = slot;
+  if (_iLast == -1)
+    _iLast = slot;
+}
+
+template <class SampleSet> int PiiKernelCache<SampleSet>::takeSlot()
+{
+  if (_iUsedSlots < _iCapacity)
+    {
+      // A fresh slot is not linked yet. Make it the only element of
+      // a one-element list to be prepended.
+      const int iSlot = _iUsedSlots++;
+      _vecNext[iSlot] = _iFirst;
+      if (_iFirst != -1)
+        _vecPrevious[_iFirst] = iSlot;
+      _iFirst = iSlot;
+      if (_iLast == -1)
+        _iLast = iSlot;
+      return iSlot;
+    }
+  // Recycle the least recently used slot.
+  const int iSlot = _iLast;
+  _vecSlotOfRow[_vecRowOfSlot[iSlot]] = -1;
+  moveToFront(iSlot);
+  return iSlot;
+}
+
+template <class SampleSet> const double* PiiKernelCache<SampleSet>::row(int index)
+{
+  int iSlot = _vecSlotOfRow[index];
+  if (iSlot != -1)
+    {
+      moveToFront(iSlot);
+      return slotData(iSlot);
+    }
+
+  // Calculate following missing rows at the same time, but only if
+  // they fit into the free part of the cache.
+  int iRows = 1;
+  while (iRows < BlockSize &&
+         _iUsedSlots + iRows < _iCapacity &&
+         index + iRows < _iSampleCount &&
+         _vecSlotOfRow[index + iRows] == -1)
+    ++iRows;
+
+  if (iRows == 1)
+    {
+      iSlot = takeSlot();
+      _kernel.distances(_vecSamples[index], _vecSamples.constData(), _iSampleCount,
+                        _iFeatureCount, INFINITY, slotData(iSlot));
+    }
+  else
+    {
+      // Free slots are allocated in order and are thus contiguous.
+      iSlot = _iUsedSlots;
+      _kernel.distanceMatrix(_vecSamples.constData() + index, iRows,
+                             _vecSamples.constData(), _iSampleCount,
+                             _iFeatureCount, slotData(iSlot));
+      for (int i=0; i<iRows; ++i)
+        {
+          const int iNewSlot = takeSlot();
+          _vecRowOfSlot[iNewSlot] = index + i;
+          _vecSlotOfRow[index + i] = iNewSlot;
+        }
+      // The requested row is the most recently used one.
+      moveToFront(iSlot);
+      _iCalculatedRows += iRows;
+      return slotData(iSlot);
+    }
+  _vecRowOfSlot[iSlot] = index;
+  _vecSlotOfRow[index] = iSlot;
+  ++_iCalculatedRows;
+  return slotData(iSlot);
+}
+
+#endif //_PIIKERNELCACHE_H
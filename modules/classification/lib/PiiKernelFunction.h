@@ -34,4 +34,83 @@ template <class SampleSet> using PiiKernelFunction = PiiDistanceMeasure<SampleSe
  */
 #define PII_POLYMORPHIC_KERNEL(KERNEL) typename PiiKernelFunction<ConstFeatureIterator>::template Impl<KERNEL<ConstFeatureIterator> >
 
+/**
+ * A PiiDistanceMatrix implementation for kernels that can be
+ * expressed in terms of the inner product of their arguments and
+ * their squared norms. Such a kernel must provide a
+ * `fromInnerProduct(double innerProduct, double sampleNorm, double
+ * modelNorm)` member function. The inner products between all
+ * samples and models are calculated as one matrix product with
+ * Pii::blockedProduct(), which is much faster than evaluating the
+ * kernel separately for each pair of vectors. Since the features are
+ * summed in a different order, the results may differ from those of
+ * the kernel function in the last bits.
+ *
+ * ~~~(c++)
+ * template <class FeatureIterator> struct PiiDistanceMatrix<MyKernel<FeatureIterator> > :
+ *   PiiInnerProductKernelMatrix<MyKernel<FeatureIterator> >
+ * {};
+ * ~~~
+ */
+template <class Kernel> struct PiiInnerProductKernelMatrix
+{
+  template <class FeatureIterator>
+  static void measure(const Kernel& kernel,
+                      const FeatureIterator* samples, int sampleCount,
+                      const FeatureIterator* models, int modelCount,
+                      int length, double* distances)
+  {
+    // Packing the operands doesn't pay off with small matrices.
+    if (double(sampleCount) * modelCount * length < 32768)
+      {
+        for (int i=0; i<sampleCount; ++i)
+          for (int j=0; j<modelCount; ++j)
+            *distances++ = kernel(samples[i], models[j], length);
+        return;
+      }
+
+    // Convert the vectors to contiguous rows of doubles.
+    QVector<double> vecSamples(sampleCount * length), vecModels(modelCount * length);
+    QVector<double> vecSampleNorms(sampleCount), vecModelNorms(modelCount);
+    copyRows(samples, sampleCount, length, vecSamples.data(), vecSampleNorms.data());
+    copyRows(models, modelCount, length, vecModels.data(), vecModelNorms.data());
+
+    // distances = samples * models^T
+    Pii::MatrixProductArgs<double> args;
+    args.iRows = sampleCount;
+    args.iInner = length;
+    args.iColumns = modelCount;
+    args.pA = vecSamples.constData();
+    args.iARowStride = length;
+    args.iAColumnStride = 1;
+    args.pB = vecModels.constData();
+    args.iBRowStride = 1;
+    args.iBColumnStride = length;
+    args.pC = distances;
+    args.iCRowStride = modelCount;
+    Pii::blockedProduct(args);
+
+    for (int i=0; i<sampleCount; ++i)
+      for (int j=0; j<modelCount; ++j, ++distances)
+        *distances = kernel.fromInnerProduct(*distances, vecSampleNorms[i], vecModelNorms[j]);
+  }
+
+private:
+  template <class FeatureIterator>
+  static void copyRows(const FeatureIterator* vectors, int count, int length,
+                       double* rows, double* norms)
+  {
+    for (int i=0; i<count; ++i, rows += length)
+      {
+        double dNorm = 0;
+        for (int f=0; f<length; ++f)
+          {
+            rows[f] = double(vectors[i][f]);
+            dNorm += rows[f] * rows[f];
+          }
+        norms[i] = dNorm;
+      }
+  }
+};
+
 #endif //_PIIKERNELFUNCTION_H
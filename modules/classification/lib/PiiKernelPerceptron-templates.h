@@ -18,11 +18,13 @@
 #endif
 
 #include "PiiGaussianKernel.h"
+#include "PiiKernelCache.h"
 
 template <class SampleSet> PiiKernelPerceptron<SampleSet>::Data::Data() :
   pKernel(new PII_POLYMORPHIC_KERNEL(PiiGaussianKernel)),
   bConverged(false),
-  iMaxIterations(100)
+  iMaxIterations(100),
+  iKernelCacheSize(256)
 {
 }
 
@@ -45,10 +47,14 @@ void PiiKernelPerceptron<SampleSet>::learn(const SampleSet& samples,
   const int iSamples = PiiSampleSet::sampleCount(samples),
     iFeatures = PiiSampleSet::featureCount(samples);
 
-  PiiMatrix<double> matKernel(PiiClassification::calculateDistanceMatrix(samples,
-                                                                         *d->pKernel,
-                                                                         true, true));
+  PiiKernelCache<SampleSet> cache(samples, *d->pKernel, qint64(d->iKernelCacheSize) << 20);
   QVector<double> vecWeights(iSamples, 0.0);
+  /* Projections of all samples to the hyperplane's normal. Since the
+     kernel is symmetric, changing weight i changes the projections by
+     the change times row i of the kernel matrix. Kernel values are
+     thus only needed for misclassified samples.
+   */
+  QVector<double> vecProjections(iSamples, 0.0);
   d->vecWeights.clear();
   d->supportVectors.clear();
   d->bConverged = false;
@@ -60,22 +66,15 @@ void PiiKernelPerceptron<SampleSet>::learn(const SampleSet& samples,
       iErrorCount = 0;
       for (int i=0; i<iSamples; ++i)
         {
-          const double* pKernelRow = matKernel.constRowBegin(i);
-          // Projection to the hyperplane's normal
-          double dSum = 0;
-          for (int j=0; j<iSamples; ++j, ++pKernelRow)
-            dSum += *pKernelRow * vecWeights[j];
-          if (dSum > 0)
-            dSum = 1;
-          else
-            dSum = 0;
+          const double dPrediction = vecProjections[i] > 0 ? 1 : 0;
           // Prediction doesn't match the training label -> update weights
-          if (dSum != labels[i])
+          if (dPrediction != labels[i])
             {
-              if (labels[i] == 1)
-                ++vecWeights[i];
-              else
-                --vecWeights[i];
+              const double dDelta = labels[i] == 1 ? 1 : -1;
+              vecWeights[i] += dDelta;
+              const double* pKernelRow = cache.row(i);
+              for (int j=0; j<iSamples; ++j)
+                vecProjections[j] += dDelta * pKernelRow[j];
               ++iErrorCount;
             }
           PII_TRY_CONTINUE(this->controller(), NAN);
@@ -117,12 +116,20 @@ double PiiKernelPerceptron<SampleSet>::classify(ConstFeatureIterator featureVect
     {
       const int iSamples = PiiSampleSet::sampleCount(d->supportVectors),
         iFeatures = PiiSampleSet::featureCount(d->supportVectors);
+      enum { BlockSize = 16 };
+      ConstFeatureIterator aSupportVectors[BlockSize];
+      double aKernelValues[BlockSize];
       double dSum = 0;
-      for (int i=0; i<iSamples; ++i)
-        dSum += d->vecWeights[i] *
-          (*d->pKernel)(PiiSampleSet::sampleAt(d->supportVectors, i),
-                        featureVector,
-                        iFeatures);
+      // One virtual call per block of support vectors.
+      for (int iStart=0; iStart<iSamples; iStart += BlockSize)
+        {
+          const int iCount = qMin(int(BlockSize), iSamples - iStart);
+          for (int i=0; i<iCount; ++i)
+            aSupportVectors[i] = PiiSampleSet::sampleAt(d->supportVectors, iStart + i);
+          d->pKernel->distances(featureVector, aSupportVectors, iCount, iFeatures, INFINITY, aKernelValues);
+          for (int i=0; i<iCount; ++i)
+            dSum += d->vecWeights[iStart + i] * aKernelValues[i];
+        }
       return dSum > 0 ? 1 : 0;
     }
   return NAN;
@@ -147,6 +154,8 @@ template <class SampleSet> PiiClassification::LearnerCapabilities PiiKernelPerce
 template <class SampleSet> int PiiKernelPerceptron<SampleSet>::featureCount() const { return _d()->supportVectors.featureCount(); }
 template <class SampleSet> void PiiKernelPerceptron<SampleSet>::setMaxIterations(int maxIterations) { _d()->iMaxIterations = maxIterations; }
 template <class SampleSet> int PiiKernelPerceptron<SampleSet>::maxIterations() const { return _d()->iMaxIterations; }
+template <class SampleSet> void PiiKernelPerceptron<SampleSet>::setKernelCacheSize(int kernelCacheSize) { _d()->iKernelCacheSize = qMax(0, kernelCacheSize); }
+template <class SampleSet> int PiiKernelPerceptron<SampleSet>::kernelCacheSize() const { return _d()->iKernelCacheSize; }
 template <class SampleSet> void PiiKernelPerceptron<SampleSet>::setWeights(const QVector<double>& weights) { _d()->vecWeights = weights; }
 template <class SampleSet> QVector<double> PiiKernelPerceptron<SampleSet>::weights() const { return _d()->vecWeights; }
 template <class SampleSet> bool PiiKernelPerceptron<SampleSet>::converged() const throw() { return _d()->bConverged; }
@@ -174,6 +174,19 @@ public:
    */
   void setMaxIterations(int maxIterations);
 
+  /**
+   * Sets the maximum amount of memory used for caching kernel values
+   * during training, in megabytes. If the kernel matrix of the
+   * training set doesn't fit into the cache, kernel values will be
+   * recalculated as needed (see PiiKernelCache). The default value
+   * is 256.
+   */
+  void setKernelCacheSize(int kernelCacheSize);
+  /**
+   * Returns the size of the kernel cache in megabytes.
+   */
+  int kernelCacheSize() const;
+
 private:
   class Data : public PiiLearningAlgorithm<SampleSet>::Data
   {
@@ -182,6 +195,7 @@ private:
     PiiKernelFunction<ConstFeatureIterator>* pKernel;
     bool bConverged;
     int iMaxIterations;
+    int iKernelCacheSize;
     QVector<double> vecWeights;
     SampleSet supportVectors;
   };
@@ -76,8 +76,28 @@ template <class SampleSet> int PiiKnnClassifier<SampleSet>::findClosestMatch(Con
                                                                              double* distance) const throw()
 {
   const PII_D;
-  int iClosestIndex;
-  if (d->k == 1)
+  int iClosestIndex = -1;
+  if (!d->index.isEmpty())
+    {
+      if (d->k == 1)
+        iClosestIndex = d->index.findClosestMatch(featureVector, *d->pMeasure, distance);
+      else
+        PiiClassification::knnVote(d->index.findClosestMatches(featureVector, *d->pMeasure, d->k),
+                                   d->vecClassLabels,
+                                   distance,
+                                   &iClosestIndex);
+    }
+  else if (d->useQuantizedModels())
+    {
+      if (d->k == 1)
+        iClosestIndex = d->quantizedModels.findClosestMatch(featureVector, *d->pMeasure, distance);
+      else
+        PiiClassification::knnVote(d->quantizedModels.findClosestMatches(featureVector, *d->pMeasure, d->k),
+                                   d->vecClassLabels,
+                                   distance,
+                                   &iClosestIndex);
+    }
+  else if (d->k == 1)
     iClosestIndex = PiiClassification::findClosestMatch(featureVector,
                                                         d->modelSet,
                                                         *d->pMeasure,
@@ -54,7 +54,10 @@ public:
 
   /**
    * Returns the index of the closest model sample in the winning
-   * class selected by the k nearest neighbors rule.
+   * class selected by the k nearest neighbors rule. If an index has
+   * been built with [buildIndex()], the neighbors are looked up from
+   * it. Otherwise, quantized models are used if a reduced model
+   * precision has been set with [setModelPrecision()].
    */
   int findClosestMatch(ConstFeatureIterator featureVector, double* distance) const throw();
 
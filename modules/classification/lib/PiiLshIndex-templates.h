@@ -0,0 +1,232 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILSHINDEX_H
+# error "Never use <PiiLshIndex-templates.h> directly; include <PiiLshIndex.h> instead."
+#endif
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+template <class SampleSet>
+PiiLshIndex<SampleSet>::PiiLshIndex() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiLshIndex<SampleSet>::PiiLshIndex(const PiiLshIndex& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiLshIndex<SampleSet>::~PiiLshIndex()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiLshIndex<SampleSet>& PiiLshIndex<SampleSet>::operator= (const PiiLshIndex& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiLshIndex<SampleSet>::setTableCount(int tableCount)
+{
+  d = d->detach();
+  d->iTableCount = qMax(1, tableCount);
+}
+
+template <class SampleSet> void PiiLshIndex<SampleSet>::setKeyBits(int keyBits)
+{
+  d = d->detach();
+  d->iKeyBits = qMin(keyBits, 30);
+}
+
+template <class SampleSet> void PiiLshIndex<SampleSet>::setFeatureBits(int featureBits)
+{
+  d = d->detach();
+  d->iFeatureBits = qMin(featureBits, 32);
+}
+
+template <class SampleSet> void PiiLshIndex<SampleSet>::clear()
+{
+  Data* pData = new Data;
+  pData->iTableCount = d->iTableCount;
+  pData->iKeyBits = d->iKeyBits;
+  pData->iFeatureBits = d->iFeatureBits;
+  d->release();
+  d = pData;
+}
+
+template <class SampleSet>
+void PiiLshIndex<SampleSet>::buildIndex(const SampleSet& modelSet,
+                                        PiiProgressController* controller)
+{
+  typedef typename std::iterator_traits<Sample>::value_type FeatureType;
+
+  clear();
+  const int iSampleCount = PiiSampleSet::sampleCount(modelSet),
+    iFeatureCount = PiiSampleSet::featureCount(modelSet);
+  if (iFeatureCount == 0 || iSampleCount == 0)
+    return;
+
+  // Floating-point features are assumed to store bytes.
+  const int iFeatureBits = d->iFeatureBits > 0 ? d->iFeatureBits :
+    std::numeric_limits<FeatureType>::is_integer ? qMin(int(sizeof(FeatureType) * 8), 32) : 8;
+  const int iTotalBits = iFeatureCount * iFeatureBits;
+  int iKeyBits = d->iKeyBits;
+  if (iKeyBits <= 0)
+    iKeyBits = qBound(4, int(std::log(double(iSampleCount)) / std::log(2.0) + 0.5), 24);
+  iKeyBits = qMin(iKeyBits, iTotalBits);
+  const int iTables = d->iTableCount;
+
+  d->modelSet = modelSet;
+  d->iFeatureCount = iFeatureCount;
+  d->iUsedKeyBits = iKeyBits;
+
+  /* Each table takes a different random subset of the bits. A
+     partial shuffle of all bit positions picks iKeyBits distinct
+     ones. A fixed seed makes the index reproducible.
+   */
+  QVector<int> vecPositions(iTotalBits);
+  for (int i=0; i<iTotalBits; ++i)
+    vecPositions[i] = (i / iFeatureBits) * 32 + i % iFeatureBits;
+  unsigned int uiSeed = 1;
+  d->vecBits.resize(iTables * iKeyBits);
+  for (int t=0; t<iTables; ++t)
+    for (int i=0; i<iKeyBits; ++i)
+      {
+        uiSeed = uiSeed * 1664525u + 1013904223u;
+        const int iSelected = i + int((unsigned long long)(uiSeed >> 8) * (iTotalBits - i) >> 24);
+        qSwap(vecPositions[i], vecPositions[iSelected]);
+        d->vecBits[t * iKeyBits + i] = vecPositions[i];
+      }
+
+  try
+    {
+      QVector<QPair<int,int> > vecKeys(iSampleCount);
+      d->vecKeyOffsets.resize(iTables + 1);
+      d->vecBucketSamples.resize(iTables * iSampleCount);
+      for (int t=0; t<iTables; ++t)
+        {
+          for (int i=0; i<iSampleCount; ++i)
+            vecKeys[i] = qMakePair(key(sampleAt(i), t), i);
+          std::sort(vecKeys.begin(), vecKeys.end());
+
+          d->vecKeyOffsets[t] = d->vecKeys.size();
+          int* pSamples = d->vecBucketSamples.data() + t * iSampleCount;
+          for (int i=0; i<iSampleCount; ++i)
+            {
+              if (i == 0 || vecKeys[i].first != vecKeys[i-1].first)
+                {
+                  d->vecKeys.append(vecKeys[i].first);
+                  d->vecBucketOffsets.append(t * iSampleCount + i);
+                }
+              pSamples[i] = vecKeys[i].second;
+            }
+          PII_TRY_CONTINUE(controller, double(t+1) / iTables);
+        }
+      d->vecKeyOffsets[iTables] = d->vecKeys.size();
+      d->vecBucketOffsets.append(d->vecBucketSamples.size());
+      d->iModelCount = iSampleCount;
+    }
+  catch (...)
+    {
+      // Don't leave half-filled tables behind.
+      clear();
+      throw;
+    }
+}
+
+template <class SampleSet>
+void PiiLshIndex<SampleSet>::collectCandidates(Sample sample, QVector<int>& candidates) const
+{
+  const int* pKeys = d->vecKeys.constData();
+  for (int t=0; t<d->iTableCount; ++t)
+    {
+      const int* pBegin = pKeys + d->vecKeyOffsets[t], *pEnd = pKeys + d->vecKeyOffsets[t+1];
+      const int iKey = key(sample, t);
+      const int* pKey = std::lower_bound(pBegin, pEnd, iKey);
+      if (pKey == pEnd || *pKey != iKey)
+        continue;
+      const int iBucket = int(pKey - pKeys);
+      for (int i=d->vecBucketOffsets[iBucket]; i<d->vecBucketOffsets[iBucket+1]; ++i)
+        candidates.append(d->vecBucketSamples[i]);
+    }
+  // The same sample is usually found in many tables.
+  std::sort(candidates.begin(), candidates.end());
+  candidates.resize(int(std::unique(candidates.begin(), candidates.end()) - candidates.begin()));
+}
+
+template <class SampleSet>
+void PiiLshIndex<SampleSet>::measureDistances(Sample sample, const Sample* models,
+                                              int count, int* distances) const
+{
+  if (!PiiHammingKernel<Sample>::distances(sample, models, count, d->iFeatureCount, distances))
+    {
+      PiiHammingDistance<Sample> measure;
+      for (int i=0; i<count; ++i)
+        distances[i] = int(measure(sample, models[i], d->iFeatureCount));
+    }
+}
+
+template <class SampleSet>
+int PiiLshIndex<SampleSet>::findClosestMatch(Sample sample, double* distance) const
+{
+  PiiClassification::MatchList lstMatches(findClosestMatches(sample, 1));
+  if (lstMatches.size() == 0)
+    {
+      if (distance != 0)
+        *distance = INFINITY;
+      return -1;
+    }
+  if (distance != 0)
+    *distance = lstMatches[0].first;
+  return lstMatches[0].second;
+}
+
+template <class SampleSet>
+PiiClassification::MatchList PiiLshIndex<SampleSet>::findClosestMatches(Sample sample, int n) const
+{
+  PiiClassification::MatchList heap;
+  if (d->iModelCount == 0 || n <= 0)
+    return heap;
+
+  QVector<int> vecCandidates;
+  collectCandidates(sample, vecCandidates);
+  const int iCandidates = vecCandidates.size();
+  heap.fill(qMin(iCandidates, n), qMakePair(double(INFINITY), -1));
+  if (heap.size() == 0)
+    return heap;
+
+  enum { BlockSize = 16 };
+  Sample aModels[BlockSize];
+  int aDistances[BlockSize];
+  for (int iStart = 0; iStart < iCandidates; iStart += BlockSize)
+    {
+      const int iCount = qMin(int(BlockSize), iCandidates - iStart);
+      for (int i=0; i<iCount; ++i)
+        aModels[i] = sampleAt(vecCandidates[iStart + i]);
+      measureDistances(sample, aModels, iCount, aDistances);
+      for (int i=0; i<iCount; ++i)
+        heap.put(qMakePair(double(aDistances[i]), vecCandidates[iStart + i]));
+    }
+  heap.sort();
+  return heap;
+}
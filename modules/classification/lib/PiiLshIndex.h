@@ -0,0 +1,258 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILSHINDEX_H
+#define _PIILSHINDEX_H
+
+#include <QVector>
+#include <QPair>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include "PiiHammingDistance.h"
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * A locality sensitive hash (LSH) index for binary descriptors. Each
+ * feature vector is treated as a string of bits, and the similarity
+ * of two strings is measured with the Hamming distance. The index
+ * consists of a number of hash tables, each of which uses a random
+ * subset of the bits as the key. Descriptors that are close to each
+ * other in the Hamming space share most of their bits and therefore
+ * end up in the same bucket in at least one of the tables with a
+ * high probability. A query only compares the sample to the
+ * descriptors in its own buckets.
+ *
+ * The result is approximate. Increasing [tableCount()] finds more of
+ * the true nearest neighbors at the expense of memory and query
+ * time. Decreasing [keyBits()] makes the buckets larger, which has a
+ * similar effect.
+ *
+ * The features must have integer values. By default, all bits of
+ * each integer feature are used, which is appropriate for
+ * descriptors packed eight bits per byte into a PiiMatrix<unsigned
+ * char>. With `unsigned char` features, the distances are calculated
+ * with SIMD instructions (see PiiHammingDistance). Floating-point
+ * features are assumed to store bytes, and only their eight least
+ * significant bits are used. If bytes are stored in a wider integer
+ * type, set [featureBits()] to 8.
+ *
+ * ~~~(c++)
+ * PiiMatrix<unsigned char> matModels(100000, 32); // 256-bit descriptors
+ * PiiLshIndex<PiiMatrix<unsigned char> > index;
+ * index.buildIndex(matModels);
+ * PiiClassification::MatchList lstMatches = index.findClosestMatches(matModels[0], 2);
+ * ~~~
+ */
+template <class SampleSet> class PiiLshIndex
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("tables", d->iTableCount);
+    archive & PII_NVP("keyBits", d->iKeyBits);
+    archive & PII_NVP("featureBits", d->iFeatureBits);
+    archive & PII_NVP("usedKeyBits", d->iUsedKeyBits);
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("modelCount", d->iModelCount);
+    archive & PII_NVP("bits", d->vecBits);
+    archive & PII_NVP("keyOffsets", d->vecKeyOffsets);
+    archive & PII_NVP("keys", d->vecKeys);
+    archive & PII_NVP("bucketOffsets", d->vecBucketOffsets);
+    archive & PII_NVP("bucketSamples", d->vecBucketSamples);
+    archive & PII_NVP("models", d->modelSet);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  /**
+   * Constructs an empty index.
+   */
+  PiiLshIndex();
+  /**
+   * Constructs a shallow copy of *other*.
+   */
+  PiiLshIndex(const PiiLshIndex& other);
+  /**
+   * Destroys the index.
+   */
+  ~PiiLshIndex();
+
+  /**
+   * Assigns *other* to `this`.
+   */
+  PiiLshIndex& operator= (const PiiLshIndex& other);
+
+  /**
+   * Deletes the old hash tables (if any) and builds new ones out of
+   * the given model samples. The parameters are retained.
+   *
+   * @param modelSet model samples
+   *
+   * @param controller an optional external controller that can be
+   * used to stop building the index on user request.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted.
+   */
+  void buildIndex(const SampleSet& modelSet,
+                  PiiProgressController* controller = 0);
+
+  /**
+   * Removes all model samples from the index.
+   */
+  void clear();
+
+  /**
+   * Returns `true` if the index contains no model samples.
+   */
+  bool isEmpty() const { return d->iModelCount == 0; }
+
+  /**
+   * Returns the index of a probably nearest neighbor of *sample* in
+   * the model set.
+   *
+   * @param sample input feature vector
+   *
+   * @param distance an optional output-value argument that will store
+   * the Hamming distance to the closest neighbor found.
+   *
+   * @return the index of the closest sample found, or -1 if none of
+   * the buckets of *sample* contains a model sample.
+   */
+  int findClosestMatch(Sample sample, double* distance = 0) const;
+
+  /**
+   * Returns *n* matches that are probably the closest ones of
+   * *sample*.
+   *
+   * @return the *n* closest matches found, in ascending order of
+   * Hamming distance. If the buckets of *sample* contain less than
+   * *n* model samples, less than *n* matches will be returned.
+   */
+  PiiClassification::MatchList findClosestMatches(Sample sample, int n) const;
+
+  /**
+   * Sets the number of hash tables. Each table stores the index of
+   * every model sample once. Takes effect when the index is rebuilt.
+   * The default is 8.
+   */
+  void setTableCount(int tableCount);
+  /**
+   * Returns the number of hash tables used in the next build.
+   */
+  int tableCount() const { return d->iTableCount; }
+
+  /**
+   * Sets the number of bits in the hash keys. Each additional bit
+   * halves the expected size of the buckets. If *keyBits* is zero or
+   * negative, the number of bits will be chosen so that there are
+   * about as many buckets as model samples. The number of bits is
+   * limited to 30 and to the length of the descriptors. Takes effect
+   * when the index is rebuilt. The default is 0.
+   */
+  void setKeyBits(int keyBits);
+  /**
+   * Returns the number of key bits used in the next build.
+   */
+  int keyBits() const { return d->iKeyBits; }
+
+  /**
+   * Sets the number of bits stored in each feature. Only the
+   * *featureBits* least significant bits of each feature are used as
+   * hash key bits. If *featureBits* is zero or negative, the size of
+   * an integer feature type in bits or 8 with floating-point types
+   * will be used. Takes effect when the index is rebuilt. The
+   * default is 0.
+   */
+  void setFeatureBits(int featureBits);
+  /**
+   * Returns the number of bits used in each feature.
+   */
+  int featureBits() const { return d->iFeatureBits; }
+
+  /**
+   * Returns the model sample set the index was built of.
+   */
+  SampleSet modelSet() const { return d->modelSet; }
+
+  /**
+   * Returns the number of samples in the index.
+   */
+  int modelCount() const { return d->iModelCount; }
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() :
+      iTableCount(8), iKeyBits(0), iFeatureBits(0),
+      iUsedKeyBits(0), iFeatureCount(0), iModelCount(0)
+    {}
+    Data(const Data& other) :
+      iTableCount(other.iTableCount),
+      iKeyBits(other.iKeyBits),
+      iFeatureBits(other.iFeatureBits),
+      iUsedKeyBits(other.iUsedKeyBits),
+      iFeatureCount(other.iFeatureCount),
+      iModelCount(other.iModelCount),
+      vecBits(other.vecBits),
+      vecKeyOffsets(other.vecKeyOffsets),
+      vecKeys(other.vecKeys),
+      vecBucketOffsets(other.vecBucketOffsets),
+      vecBucketSamples(other.vecBucketSamples),
+      modelSet(other.modelSet)
+    {}
+
+    int iTableCount, iKeyBits, iFeatureBits;
+    // The number of key bits the current tables were built with.
+    int iUsedKeyBits;
+    int iFeatureCount;
+    int iModelCount;
+    /* The bits that make up the key of each table, iUsedKeyBits
+       entries per table. Each entry is feature index * 32 + bit
+       index. */
+    QVector<int> vecBits;
+    // Start of each table's keys in vecKeys. One extra entry at the end.
+    QVector<int> vecKeyOffsets;
+    // The distinct keys of each table in ascending order.
+    QVector<int> vecKeys;
+    // Start of the bucket of each key in vecBucketSamples.
+    QVector<int> vecBucketOffsets;
+    QVector<int> vecBucketSamples;
+    SampleSet modelSet;
+  } *d;
+
+  int key(Sample sample, int table) const
+  {
+    const int* pBits = d->vecBits.constData() + table * d->iUsedKeyBits;
+    int iKey = 0;
+    for (int i=0; i<d->iUsedKeyBits; ++i)
+      iKey |= int((static_cast<unsigned int>(sample[pBits[i] >> 5]) >> (pBits[i] & 31)) & 1) << i;
+    return iKey;
+  }
+
+  void collectCandidates(Sample sample, QVector<int>& candidates) const;
+  void measureDistances(Sample sample, const Sample* models, int count, int* distances) const;
+
+  inline Sample sampleAt(int index) const { return PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->modelSet), index); }
+};
+
+#include "PiiLshIndex-templates.h"
+
+#endif //_PIILSHINDEX_H
@@ -0,0 +1,306 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMAPPEDSAMPLESET_H
+# error "Never use <PiiMappedSampleSet-templates.h> directly; include <PiiMappedSampleSet.h> instead."
+#endif
+
+#include <cstring>
+#include <algorithm>
+
+template <class T> PiiMappedSampleSet<T>::Data::Data() :
+  pFile(0),
+  pHeader(0),
+  iChunkSize(0),
+  iFeatureCount(0),
+  iSampleCount(0),
+  iChunkShift(0)
+{}
+
+template <class T> PiiMappedSampleSet<T>::Data::Data(const Data& other) :
+  PiiSharedD<Data>(),
+  pFile(0),
+  pHeader(0),
+  iChunkSize(0),
+  iFeatureCount(other.iFeatureCount),
+  iSampleCount(0),
+  iChunkShift(other.iChunkShift)
+{
+  // A copy always goes to a temporary file.
+  allocate(other.iSampleCount);
+  const qint64 iChunkBytes = chunkBytes(), iSampleBytes = qint64(sizeof(T)) * iFeatureCount;
+  for (int i=0; i<lstChunks.size(); ++i)
+    {
+      const qint64 iUsedSamples = qMin(qint64(1) << iChunkShift,
+                                       qint64(other.iSampleCount) - (qint64(i) << iChunkShift));
+      if (iUsedSamples <= 0)
+        break;
+      std::memcpy(lstChunks[i]->data(), other.lstChunks[i]->data(),
+                  std::size_t(qMin(iChunkBytes, iUsedSamples * iSampleBytes)));
+    }
+  setSampleCount(other.iSampleCount);
+}
+
+template <class T> PiiMappedSampleSet<T>::Data::~Data()
+{
+  unmap();
+  // QTemporaryFile removes the file.
+  delete pFile;
+}
+
+template <class T> void PiiMappedSampleSet<T>::Data::unmap()
+{
+  for (int i=0; i<lstChunks.size(); ++i)
+    lstChunks[i]->release();
+  lstChunks.clear();
+  if (pHeader != 0)
+    pHeader->release();
+  pHeader = 0;
+}
+
+template <class T> void PiiMappedSampleSet<T>::Data::open(QFile* file, int featureCount)
+{
+  pFile = file;
+  if (pFile->size() == 0)
+    {
+      if (featureCount > 0)
+        setLayout(featureCount);
+      return;
+    }
+
+  pHeader = PiiMappedFile::map(pFile->handle(), 0, HeaderSize, PiiMappedFile::ReadWrite);
+  if (pHeader == 0)
+    PII_THROW(PiiIOException, tr("Cannot map %1 to memory.").arg(pFile->fileName()));
+  const Header* pHeaderData = reinterpret_cast<const Header*>(pHeader->data());
+  if (std::memcmp(pHeaderData->magic, "PIISMPLS", 8) != 0 ||
+      pHeaderData->iVersion != 1 ||
+      pHeaderData->iFeatureSize != int(sizeof(T)) ||
+      pHeaderData->iFeatureCount <= 0 ||
+      pHeaderData->iChunkShift < 0 || pHeaderData->iChunkShift > 30)
+    PII_THROW(PiiIOException, tr("%1 does not contain a valid sample set.").arg(pFile->fileName()));
+  if (featureCount != -1 && featureCount != pHeaderData->iFeatureCount)
+    PII_THROW(PiiIOException, tr("%1 contains samples with %2 features instead of %3.")
+              .arg(pFile->fileName()).arg(pHeaderData->iFeatureCount).arg(featureCount));
+
+  iFeatureCount = pHeaderData->iFeatureCount;
+  iChunkShift = pHeaderData->iChunkShift;
+  const int iStoredSamples = int(pHeaderData->iSampleCount);
+  const int iChunks = int((pFile->size() - HeaderSize) / chunkBytes());
+  if ((qint64(iChunks) << iChunkShift) < iStoredSamples)
+    PII_THROW(PiiIOException, tr("%1 has been truncated.").arg(pFile->fileName()));
+  allocate(iChunks << iChunkShift);
+  iSampleCount = iStoredSamples;
+}
+
+template <class T> void PiiMappedSampleSet<T>::Data::setLayout(int featureCount)
+{
+  // Discard old samples. The header will be written once space is
+  // reserved.
+  unmap();
+  if (pFile != 0)
+    pFile->resize(0);
+  iFeatureCount = qMax(0, featureCount);
+  iSampleCount = 0;
+  iChunkShift = 0;
+  const qint64 iSampleBytes = qMax(qint64(1), qint64(sizeof(T)) * iFeatureCount);
+  while ((iSampleBytes << iChunkShift) < DefaultChunkBytes &&
+         (iChunkSize == 0 || (1 << iChunkShift) < iChunkSize))
+    ++iChunkShift;
+}
+
+template <class T> void PiiMappedSampleSet<T>::Data::setSampleCount(int count)
+{
+  iSampleCount = count;
+  if (pHeader != 0)
+    reinterpret_cast<Header*>(pHeader->data())->iSampleCount = count;
+}
+
+template <class T> void PiiMappedSampleSet<T>::Data::allocate(int sampleCount)
+{
+  if (sampleCount <= (lstChunks.size() << iChunkShift) || iFeatureCount == 0)
+    return;
+
+  if (pFile == 0)
+    {
+      QTemporaryFile* pTemporaryFile = new QTemporaryFile;
+      if (!pTemporaryFile->open())
+        {
+          delete pTemporaryFile;
+          PII_THROW(PiiIOException, tr("Cannot create a temporary file for samples."));
+        }
+      pFile = pTemporaryFile;
+    }
+
+  if (pHeader == 0)
+    {
+      if (!pFile->resize(HeaderSize) ||
+          (pHeader = PiiMappedFile::map(pFile->handle(), 0, HeaderSize, PiiMappedFile::ReadWrite)) == 0)
+        PII_THROW(PiiIOException, tr("Cannot map %1 to memory.").arg(pFile->fileName()));
+      Header* pHeaderData = reinterpret_cast<Header*>(pHeader->data());
+      std::memcpy(pHeaderData->magic, "PIISMPLS", 8);
+      pHeaderData->iVersion = 1;
+      pHeaderData->iFeatureSize = int(sizeof(T));
+      pHeaderData->iFeatureCount = iFeatureCount;
+      pHeaderData->iChunkShift = iChunkShift;
+      pHeaderData->iSampleCount = iSampleCount;
+    }
+
+  const qint64 iChunkBytes = chunkBytes();
+  const int iChunks = int(((qint64(sampleCount) - 1) >> iChunkShift) + 1);
+  const qint64 iFileSize = HeaderSize + iChunks * iChunkBytes;
+  if (pFile->size() < iFileSize && !pFile->resize(iFileSize))
+    PII_THROW(PiiIOException, tr("Cannot extend %1.").arg(pFile->fileName()));
+  while (lstChunks.size() < iChunks)
+    {
+      PiiMappedFile* pChunk = PiiMappedFile::map(pFile->handle(),
+                                                 HeaderSize + lstChunks.size() * iChunkBytes,
+                                                 std::size_t(iChunkBytes),
+                                                 PiiMappedFile::ReadWrite);
+      if (pChunk == 0)
+        PII_THROW(PiiIOException, tr("Cannot map %1 to memory.").arg(pFile->fileName()));
+      lstChunks << pChunk;
+    }
+}
+
+template <class T> PiiMappedSampleSet<T>::PiiMappedSampleSet() :
+  d(new Data)
+{}
+
+template <class T> PiiMappedSampleSet<T>::PiiMappedSampleSet(int sampleCount, int featureCount) :
+  d(new Data)
+{
+  // Don't create huge chunks for small sets.
+  d->iChunkSize = sampleCount;
+  resize(sampleCount, featureCount);
+}
+
+template <class T> PiiMappedSampleSet<T>::PiiMappedSampleSet(const QString& fileName, int featureCount, int chunkSize) :
+  d(new Data)
+{
+  QFile* pFile = new QFile(fileName);
+  if (!pFile->open(QIODevice::ReadWrite))
+    {
+      delete pFile;
+      delete d;
+      PII_THROW(PiiIOException, tr("Cannot open %1 for reading and writing.").arg(fileName));
+    }
+  d->iChunkSize = qMax(0, chunkSize);
+  try
+    {
+      d->open(pFile, featureCount);
+    }
+  catch (PiiException&)
+    {
+      delete d;
+      throw;
+    }
+}
+
+template <class T> PiiMappedSampleSet<T>::PiiMappedSampleSet(const PiiMappedSampleSet& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class T> PiiMappedSampleSet<T>::~PiiMappedSampleSet()
+{
+  d->release();
+}
+
+template <class T> PiiMappedSampleSet<T>& PiiMappedSampleSet<T>::operator= (const PiiMappedSampleSet& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class T> QString PiiMappedSampleSet<T>::fileName() const
+{
+  return d->pFile != 0 ? d->pFile->fileName() : QString();
+}
+
+template <class T> void PiiMappedSampleSet<T>::setSampleAt(int index, const T* features)
+{
+  std::memcpy(sampleAt(index), features, sizeof(T) * d->iFeatureCount);
+}
+
+template <class T> void PiiMappedSampleSet<T>::append(const T* sample)
+{
+  Data* pData = _d();
+  if (pData->iFeatureCount == 0)
+    return;
+  pData->allocate(pData->iSampleCount + 1);
+  std::memcpy(pData->sampleAt(pData->iSampleCount), sample, sizeof(T) * pData->iFeatureCount);
+  pData->setSampleCount(pData->iSampleCount + 1);
+}
+
+template <class T> void PiiMappedSampleSet<T>::resize(int sampleCount, int featureCount)
+{
+  reserve(sampleCount, featureCount);
+  Data* pData = _d();
+  for (int i=pData->iSampleCount; i<sampleCount; ++i)
+    std::memset(pData->sampleAt(i), 0, sizeof(T) * pData->iFeatureCount);
+  pData->setSampleCount(qMax(0, sampleCount));
+}
+
+template <class T> void PiiMappedSampleSet<T>::reserve(int sampleCount, int featureCount)
+{
+  if (featureCount != -1 && featureCount != d->iFeatureCount)
+    {
+      // No need to copy samples that will be discarded anyway.
+      if (d->iRefCount != 1)
+        {
+          const int iChunkSize = d->iChunkSize;
+          d->release();
+          d = new Data;
+          d->iChunkSize = iChunkSize;
+        }
+      d->setLayout(featureCount);
+    }
+  _d()->allocate(sampleCount);
+}
+
+template <class T> void PiiMappedSampleSet<T>::clear()
+{
+  if (d->iRefCount != 1)
+    {
+      Data* pData = new Data;
+      pData->iChunkSize = d->iChunkSize;
+      pData->setLayout(d->iFeatureCount);
+      d->release();
+      d = pData;
+    }
+  else
+    d->setSampleCount(0);
+}
+
+template <class T> void PiiMappedSampleSet<T>::remove(int index)
+{
+  Data* pData = _d();
+  for (int i=index+1; i<pData->iSampleCount; ++i)
+    std::memcpy(pData->sampleAt(i-1), pData->sampleAt(i), sizeof(T) * pData->iFeatureCount);
+  pData->setSampleCount(pData->iSampleCount - 1);
+}
+
+template <class T> bool PiiMappedSampleSet<T>::operator== (const PiiMappedSampleSet& other) const
+{
+  if (d == other.d)
+    return true;
+  if (d->iSampleCount != other.d->iSampleCount || d->iFeatureCount != other.d->iFeatureCount)
+    return false;
+  for (int i=0; i<d->iSampleCount; ++i)
+    if (!std::equal(d->sampleAt(i), d->sampleAt(i) + d->iFeatureCount, other.d->sampleAt(i)))
+      return false;
+  return true;
+}
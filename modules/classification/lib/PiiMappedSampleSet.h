@@ -0,0 +1,272 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMAPPEDSAMPLESET_H
+#define _PIIMAPPEDSAMPLESET_H
+
+#include "PiiSampleSet.h"
+
+#include <PiiMappedFile.h>
+#include <PiiSharedD.h>
+#include <PiiIOException.h>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QVector>
+
+/**
+ * A sample set stored in a memory-mapped file. PiiMappedSampleSet
+ * makes it possible to train classifiers with more feature vectors
+ * than fit into memory. The operating system pages the samples in
+ * from the file as they are accessed and writes modified pages back
+ * to the file.
+ *
+ * The samples are stored in fixed-size chunks, each of which is
+ * mapped separately. Appending samples grows the file one chunk at a
+ * time. Since existing chunks are never moved, pointers returned by
+ * sampleAt() remain valid while samples are appended. Within a chunk,
+ * samples are stored contiguously, one after another, so that each
+ * sample can be accessed through a plain pointer. All algorithms
+ * that access sample sets through the functions in the PiiSampleSet
+ * namespace work with PiiMappedSampleSet.
+ *
+ * ~~~(c++)
+ * // Collect samples into a file
+ * PiiMappedSampleSet<float> samples("samples.bin", 128);
+ * for (int i=0; i<10000000; ++i)
+ *   samples.append(nextFeatureVector());
+ *
+ * // Later, or in another process
+ * PiiMappedSampleSet<float> samples("samples.bin");
+ * PiiKdTree<PiiMappedSampleSet<float> > tree(samples);
+ * ~~~
+ *
+ * A sample set that is not associated with a named file stores its
+ * samples in a temporary file that will be removed once the last copy
+ * of the set is destroyed. Algorithms that need a new sample set of
+ * the same type, for example for storing code vectors, create such
+ * sets.
+ *
+ * PiiMappedSampleSet is implicitly shared, like PiiMatrix. Copying a
+ * set is cheap, but modifying a shared set copies all samples to a
+ * new temporary file. The file format is native-endian: the file
+ * starts with a header that stores the number and the size of
+ * features, the chunk size and the number of samples. The samples
+ * follow at offset 4096.
+ *
+ * ! PiiMappedSampleSet cannot be serialized.
+ */
+template <class T> class PiiMappedSampleSet
+{
+public:
+  /**
+   * Creates an empty sample set. A temporary file will be created
+   * when samples are first added.
+   */
+  PiiMappedSampleSet();
+
+  /**
+   * Creates a sample set with *sampleCount* samples with
+   * *featureCount* features each in a temporary file. All features
+   * are initialized to zero.
+   */
+  PiiMappedSampleSet(int sampleCount, int featureCount);
+
+  /**
+   * Opens the sample set stored in *fileName*. If the file does not
+   * exist or is empty, a new sample set with *featureCount* features
+   * will be created. The file must be writable.
+   *
+   * @param fileName the name of the file
+   *
+   * @param featureCount the number of features in each sample. If
+   * the file already contains samples, this must be either -1 or
+   * equal to the number of features in the file.
+   *
+   * @param chunkSize the number of samples per chunk in a new file.
+   * The value will be rounded up to the next power of two, but a
+   * chunk will not be made larger than about 16 MB. Zero means that
+   * the maximum size will be used.
+   *
+   * @exception PiiIOException& if the file cannot be opened or
+   * mapped, or if it doesn't contain a valid sample set
+   */
+  PiiMappedSampleSet(const QString& fileName, int featureCount = -1, int chunkSize = 0);
+
+  PiiMappedSampleSet(const PiiMappedSampleSet& other);
+  ~PiiMappedSampleSet();
+
+  PiiMappedSampleSet& operator= (const PiiMappedSampleSet& other);
+
+  /**
+   * Returns the name of the file the samples are stored in.
+   */
+  QString fileName() const;
+
+  /**
+   * Returns the number of samples.
+   */
+  int sampleCount() const { return d->iSampleCount; }
+  /**
+   * Returns the number of features in each sample.
+   */
+  int featureCount() const { return d->iFeatureCount; }
+  /**
+   * Returns the number of samples the set can hold without growing
+   * the file.
+   */
+  int capacity() const { return d->lstChunks.size() << d->iChunkShift; }
+  /**
+   * Returns the number of samples in each chunk.
+   */
+  int chunkSize() const { return 1 << d->iChunkShift; }
+
+  /**
+   * Returns a pointer to the beginning of the sample at *index*.
+   */
+  const T* sampleAt(int index) const { return d->sampleAt(index); }
+  /**
+   * Returns a modifiable pointer to the sample at *index*. Detaches
+   * the set if it is shared.
+   */
+  T* sampleAt(int index) { return _d()->sampleAt(index); }
+
+  /**
+   * Replaces the sample at *index* with *features*.
+   */
+  void setSampleAt(int index, const T* features);
+
+  /**
+   * Appends *sample* to the end of the set. The number of features
+   * must have been set before; appending to a set with no features
+   * does nothing.
+   *
+   * @exception PiiIOException& if the file cannot be extended
+   */
+  void append(const T* sample);
+
+  /**
+   * Resizes the set to *sampleCount* samples. New samples will be
+   * initialized to zero. If *featureCount* differs from the current
+   * number of features, all samples will be discarded first.
+   *
+   * @exception PiiIOException& if the file cannot be extended
+   */
+  void resize(int sampleCount, int featureCount = -1);
+
+  /**
+   * Ensures that the set can hold at least *sampleCount* samples
+   * without growing the file. If *featureCount* differs from the
+   * current number of features, all samples will be discarded.
+   *
+   * @exception PiiIOException& if the file cannot be extended
+   */
+  void reserve(int sampleCount, int featureCount = -1);
+
+  /**
+   * Removes all samples. The file will not be truncated.
+   */
+  void clear();
+
+  /**
+   * Removes the sample at *index*. All samples after *index* will be
+   * moved one step towards the beginning.
+   */
+  void remove(int index);
+
+  /**
+   * Returns `true` if the two sets contain the same samples.
+   */
+  bool operator== (const PiiMappedSampleSet& other) const;
+
+private:
+  enum { HeaderSize = 4096, DefaultChunkBytes = 16 << 20 };
+
+  struct Header
+  {
+    char magic[8];
+    qint32 iVersion;
+    qint32 iFeatureSize;
+    qint32 iFeatureCount;
+    qint32 iChunkShift;
+    qint64 iSampleCount;
+  };
+
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data();
+    Data(const Data& other);
+    ~Data();
+
+    T* sampleAt(int index) const
+    {
+      return reinterpret_cast<T*>(lstChunks[index >> iChunkShift]->data()) +
+        std::size_t(index & ((1 << iChunkShift) - 1)) * iFeatureCount;
+    }
+    qint64 chunkBytes() const { return qint64(sizeof(T)) * iFeatureCount << iChunkShift; }
+
+    void open(QFile* file, int featureCount);
+    void setLayout(int featureCount);
+    void setSampleCount(int count);
+    void allocate(int sampleCount);
+    void unmap();
+
+    QFile* pFile;
+    PiiMappedFile* pHeader;
+    QVector<PiiMappedFile*> lstChunks;
+    // A requested chunk size, or zero for automatic.
+    int iChunkSize;
+    int iFeatureCount, iSampleCount, iChunkShift;
+  } *d;
+
+  static QString tr(const char* text) { return QCoreApplication::translate("PiiMappedSampleSet", text); }
+
+  inline Data* _d() { return d = d->detach(); }
+};
+
+namespace PiiSampleSet
+{
+  /**
+   * Defines the traits of PiiMappedSampleSet when used as a sample
+   * set.
+   */
+  template <class T> struct Traits<PiiMappedSampleSet<T> >
+  {
+    typedef PiiMappedSampleSet<T> Type;
+    typedef T FeatureType;
+    typedef T* FeatureIterator;
+    typedef const T* ConstFeatureIterator;
+
+    static Type create(int sampleCount, int featureCount) { return Type(sampleCount, featureCount); }
+
+    static int sampleCount(const Type& samples) { return samples.sampleCount(); }
+    static int featureCount(const Type& samples) { return samples.featureCount(); }
+    static void resize(Type& samples, int sampleCount, int featureCount) { samples.resize(sampleCount, featureCount); }
+    static void reserve(Type& samples, int sampleCount, int featureCount) { samples.reserve(sampleCount, featureCount); }
+    static void clear(Type& samples) { samples.clear(); }
+    static int capacity(const Type& samples) { return samples.capacity(); }
+    static const T* sampleAt(const Type& samples, int index) { return samples.sampleAt(index); }
+    static T* sampleAt(Type& samples, int index) { return samples.sampleAt(index); }
+    static void setSampleAt(Type& samples, int index, const T* features) { samples.setSampleAt(index, features); }
+    static void append(Type& samples, const T* sample) { samples.append(sample); }
+    static void remove(Type& samples, int index) { samples.remove(index); }
+    static bool equals(const Type& set1, const Type& set2) { return set1 == set2; }
+  };
+}
+
+#include "PiiMappedSampleSet-templates.h"
+
+#endif //_PIIMAPPEDSAMPLESET_H
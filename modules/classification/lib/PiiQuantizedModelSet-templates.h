@@ -0,0 +1,286 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIQUANTIZEDMODELSET_H
+# error "Never use <PiiQuantizedModelSet-templates.h> directly; include <PiiQuantizedModelSet.h> instead."
+#endif
+
+#include <QVarLengthArray>
+#include <PiiMath.h>
+#include <PiiTypeTraits.h>
+
+template <class SampleSet> class PiiQuantizedModelSet<SampleSet>::Query
+{
+public:
+  Query(const Data* d, Sample sample, PiiClassification::DistanceForm form) :
+    form(form), sample(sample)
+  {
+    const int iFeatures = d->vecOffsets.size();
+    if (form == PiiClassification::GenericDistance)
+      vecModels.resize(BlockSize * iFeatures);
+    else
+      {
+        // Move the sample to the scale of the codes once instead of
+        // decoding each model.
+        vecSample.resize(iFeatures);
+        for (int i=0; i<iFeatures; ++i)
+          vecSample[i] = float((double(sample[i]) - d->vecOffsets[i]) * d->vecInverseScales[i]);
+      }
+  }
+
+  PiiClassification::DistanceForm form;
+  Sample sample;
+  QVarLengthArray<float, 256> vecSample;
+  // Decoded models for generic distance measures.
+  QVarLengthArray<FeatureType, 1024> vecModels;
+};
+
+template <class SampleSet> void PiiQuantizedModelSet<SampleSet>::Data::updateScales()
+{
+  const int iFeatures = vecScales.size();
+  vecInverseScales.resize(iFeatures);
+  vecSquaredScales.resize(iFeatures);
+  for (int i=0; i<iFeatures; ++i)
+    {
+      vecInverseScales[i] = 1.0f / vecScales[i];
+      vecSquaredScales[i] = vecScales[i] * vecScales[i];
+    }
+}
+
+template <class SampleSet>
+PiiQuantizedModelSet<SampleSet>::PiiQuantizedModelSet() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiQuantizedModelSet<SampleSet>::PiiQuantizedModelSet(const PiiQuantizedModelSet& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiQuantizedModelSet<SampleSet>::~PiiQuantizedModelSet()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiQuantizedModelSet<SampleSet>& PiiQuantizedModelSet<SampleSet>::operator= (const PiiQuantizedModelSet& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiQuantizedModelSet<SampleSet>::clear()
+{
+  d = d->detach();
+  d->iPrecision = PiiClassification::FullPrecision;
+  d->vecOffsets.clear();
+  d->vecScales.clear();
+  d->updateScales();
+  d->matCodes = PiiMatrix<unsigned char>();
+}
+
+template <class SampleSet>
+void PiiQuantizedModelSet<SampleSet>::quantize(const SampleSet& modelSet,
+                                               PiiClassification::ModelPrecision precision)
+{
+  const int iModels = PiiSampleSet::sampleCount(modelSet),
+    iFeatures = PiiSampleSet::featureCount(modelSet);
+  if (precision == PiiClassification::FullPrecision || iModels == 0 || iFeatures <= 0)
+    {
+      clear();
+      return;
+    }
+
+  // Find the range of each feature.
+  QVector<double> vecMin(iFeatures, INFINITY), vecMax(iFeatures, -INFINITY);
+  for (int r=0; r<iModels; ++r)
+    {
+      Sample pModel = PiiSampleSet::sampleAt(modelSet, r);
+      for (int c=0; c<iFeatures; ++c)
+        {
+          const double dValue = double(pModel[c]);
+          if (dValue < vecMin[c]) vecMin[c] = dValue;
+          if (dValue > vecMax[c]) vecMax[c] = dValue;
+        }
+    }
+
+  d = d->detach();
+  d->iPrecision = precision;
+  d->vecOffsets.resize(iFeatures);
+  d->vecScales.resize(iFeatures);
+  for (int c=0; c<iFeatures; ++c)
+    {
+      double dOffset, dScale;
+      if (precision == PiiClassification::Int8Precision)
+        {
+          dOffset = vecMin[c];
+          dScale = (vecMax[c] - vecMin[c]) / 255;
+        }
+      else
+        {
+          dOffset = (vecMin[c] + vecMax[c]) / 2;
+          dScale = (vecMax[c] - vecMin[c]) / 2;
+        }
+      // Constant features are stored as zeros.
+      d->vecOffsets[c] = float(dOffset);
+      d->vecScales[c] = dScale > 0 ? float(dScale) : 1.0f;
+    }
+  d->updateScales();
+
+  const int iCodeSize = precision == PiiClassification::Int8Precision ? 1 : int(sizeof(PiiHalf));
+  d->matCodes = PiiMatrix<unsigned char>::uninitialized(iModels, iFeatures * iCodeSize);
+  QVarLengthArray<float, 256> vecScaled(iFeatures);
+  for (int r=0; r<iModels; ++r)
+    {
+      Sample pModel = PiiSampleSet::sampleAt(modelSet, r);
+      for (int c=0; c<iFeatures; ++c)
+        vecScaled[c] = float((double(pModel[c]) - d->vecOffsets[c]) / d->vecScales[c]);
+      if (precision == PiiClassification::Int8Precision)
+        {
+          unsigned char* pCodes = d->matCodes[r];
+          for (int c=0; c<iFeatures; ++c)
+            pCodes[c] = (unsigned char)qBound(0, Pii::round<int>(vecScaled[c]), 255);
+        }
+      else
+        Pii::floatToHalfN(vecScaled.constData(), iFeatures, reinterpret_cast<PiiHalf*>(d->matCodes[r]));
+    }
+}
+
+template <class SampleSet> void PiiQuantizedModelSet<SampleSet>::decode(int index, FeatureType* features) const
+{
+  const int iFeatures = featureCount();
+  QVarLengthArray<float, 256> vecCodes(iFeatures);
+  if (d->iPrecision == PiiClassification::Int8Precision)
+    std::copy(byteCodesAt(index), byteCodesAt(index) + iFeatures, vecCodes.data());
+  else
+    Pii::halfToFloatN(halfCodesAt(index), iFeatures, vecCodes.data());
+  for (int i=0; i<iFeatures; ++i)
+    {
+      const float fValue = d->vecOffsets[i] + d->vecScales[i] * vecCodes[i];
+      features[i] = Pii::IsInteger<FeatureType>::boolValue ?
+        FeatureType(Pii::round(fValue)) :
+        FeatureType(fValue);
+    }
+}
+
+template <class SampleSet>
+double PiiQuantizedModelSet<SampleSet>::codeDistance(const Query& query, int index, double bound) const
+{
+  const int iFeatures = featureCount();
+  const bool bAbsolute = query.form == PiiClassification::AbsoluteDifferenceSum,
+    bRoot = query.form == PiiClassification::SquaredDifferenceSumRoot;
+  const float* pSample = query.vecSample.constData();
+  const float* pWeights = bAbsolute ? d->vecScales.constData() : d->vecSquaredScales.constData();
+  if (bRoot)
+    bound *= bound;
+
+  double dDistance = 0;
+  if (d->iPrecision == PiiClassification::Int8Precision)
+    dDistance = bAbsolute ?
+      PiiQuantizedDistanceKernel::absDifference(pSample, pWeights, byteCodesAt(index), iFeatures, bound) :
+      PiiQuantizedDistanceKernel::squaredDifference(pSample, pWeights, byteCodesAt(index), iFeatures, bound);
+  else
+    {
+      // Half-precision codes are converted in blocks that fit in the
+      // L1 cache.
+      enum { CodeBlockSize = 256 };
+      float afCodes[CodeBlockSize];
+      const PiiHalf* pCodes = halfCodesAt(index);
+      for (int i=0; i<iFeatures && dDistance <= bound; i += CodeBlockSize)
+        {
+          const int iCount = qMin(int(CodeBlockSize), iFeatures - i);
+          Pii::halfToFloatN(pCodes + i, iCount, afCodes);
+          dDistance += bAbsolute ?
+            PiiQuantizedDistanceKernel::absDifference(pSample + i, pWeights + i, afCodes, iCount, bound - dDistance) :
+            PiiQuantizedDistanceKernel::squaredDifference(pSample + i, pWeights + i, afCodes, iCount, bound - dDistance);
+        }
+    }
+  return bRoot ? std::sqrt(dDistance) : dDistance;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiQuantizedModelSet<SampleSet>::measureDistances(Query& query, const DistanceMeasure& measure,
+                                                       int first, int count, double bound,
+                                                       double* distances) const
+{
+  if (query.form == PiiClassification::GenericDistance)
+    {
+      const int iFeatures = featureCount();
+      Sample aModels[BlockSize];
+      for (int i=0; i<count; ++i)
+        {
+          FeatureType* pModel = query.vecModels.data() + i * iFeatures;
+          decode(first + i, pModel);
+          aModels[i] = pModel;
+        }
+      PiiClassification::measureDistances(query.sample, aModels, count, iFeatures, measure, bound, distances);
+    }
+  else
+    for (int i=0; i<count; ++i)
+      distances[i] = codeDistance(query, first + i, bound);
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+int PiiQuantizedModelSet<SampleSet>::findClosestMatch(Sample sample,
+                                                      const DistanceMeasure& measure,
+                                                      double* distance) const
+{
+  Query query(d, sample, distanceForm(measure));
+  const int iModels = modelCount();
+  double aDistances[BlockSize];
+  double dMinDistance = INFINITY;
+  int iMinIndex = -1;
+  for (int iStart = 0; iStart < iModels; iStart += BlockSize)
+    {
+      const int iCount = qMin(int(BlockSize), iModels - iStart);
+      measureDistances(query, measure, iStart, iCount, dMinDistance, aDistances);
+      for (int i=0; i<iCount; ++i)
+        if (aDistances[i] < dMinDistance)
+          {
+            iMinIndex = iStart + i;
+            dMinDistance = aDistances[i];
+          }
+    }
+  if (distance != 0)
+    *distance = dMinDistance;
+  return iMinIndex;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+PiiClassification::MatchList PiiQuantizedModelSet<SampleSet>::findClosestMatches(Sample sample,
+                                                                                  const DistanceMeasure& measure,
+                                                                                  int n) const
+{
+  const int iModels = modelCount();
+  PiiClassification::MatchList heap;
+  heap.fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
+  if (heap.size() == 0)
+    return heap;
+
+  Query query(d, sample, distanceForm(measure));
+  double aDistances[BlockSize];
+  for (int iStart = 0; iStart < iModels; iStart += BlockSize)
+    {
+      const int iCount = qMin(int(BlockSize), iModels - iStart);
+      measureDistances(query, measure, iStart, iCount, heap[0].first, aDistances);
+      for (int i=0; i<iCount; ++i)
+        heap.put(qMakePair(aDistances[i], iStart + i));
+    }
+  heap.sort();
+  return heap;
+}
@@ -0,0 +1,221 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIQUANTIZEDMODELSET_H
+#define _PIIQUANTIZEDMODELSET_H
+
+#include <QVector>
+#include <PiiMatrix.h>
+#include <PiiHalf.h>
+#include <PiiSharedD.h>
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include "PiiDistanceKernels.h"
+
+/**
+ * A compact copy of a model sample set for nearest neighbor search.
+ * Each feature is stored either as an 8-bit integer or as a 16-bit
+ * half-precision number instead of the original type. With `double`
+ * features this reduces the memory needed by the models by a factor
+ * of eight or four, which often makes a whole model set fit in
+ * the CPU cache. Since nearest neighbor search is usually limited by
+ * memory bandwidth, the search becomes faster, too.
+ *
+ * Each feature is scaled separately to the range of the codes
+ * (see PiiClassification::ModelPrecision). The scale and the offset
+ * are determined by the minimum and maximum value of the feature in
+ * the model set. If the measure is a sum of per-feature differences
+ * (see PiiDistanceForm), the distances are calculated directly on
+ * the codes with SIMD instructions. Other distance measures are
+ * given models that are first decoded into the original feature
+ * type. In both cases, the distances are approximate: the error
+ * depends on the range of the features and the precision.
+ *
+ * The quantized set is independent of the model set it was created
+ * of. Once [quantize()] has been called, the original models are no
+ * longer needed for classification.
+ *
+ * ~~~(c++)
+ * PiiMatrix<double> matModels(100000, 64);
+ * PiiQuantizedModelSet<PiiMatrix<double> > models;
+ * models.quantize(matModels, PiiClassification::Int8Precision);
+ * PiiSquaredGeometricDistance<const double*> measure;
+ * // Full-precision models are no longer needed.
+ * matModels = PiiMatrix<double>();
+ * int iClosest = models.findClosestMatch(pSample, measure);
+ * ~~~
+ */
+template <class SampleSet> class PiiQuantizedModelSet
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("precision", d->iPrecision);
+    archive & PII_NVP("offsets", d->vecOffsets);
+    archive & PII_NVP("scales", d->vecScales);
+    archive & PII_NVP("codes", d->matCodes);
+    if (Archive::InputArchive)
+      d->updateScales();
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
+
+  /**
+   * Constructs an empty set.
+   */
+  PiiQuantizedModelSet();
+  /**
+   * Constructs a shallow copy of *other*.
+   */
+  PiiQuantizedModelSet(const PiiQuantizedModelSet& other);
+  /**
+   * Destroys the set.
+   */
+  ~PiiQuantizedModelSet();
+
+  /**
+   * Assigns *other* to `this`.
+   */
+  PiiQuantizedModelSet& operator= (const PiiQuantizedModelSet& other);
+
+  /**
+   * Replaces the current contents of the set with *modelSet* stored
+   * in the given *precision*. If *precision* is
+   * PiiClassification::FullPrecision, the set will be cleared.
+   */
+  void quantize(const SampleSet& modelSet, PiiClassification::ModelPrecision precision);
+
+  /**
+   * Removes all models.
+   */
+  void clear();
+
+  /**
+   * Returns `true` if the set contains no models.
+   */
+  bool isEmpty() const { return d->matCodes.rows() == 0; }
+
+  /**
+   * Returns the precision of the stored models, or
+   * PiiClassification::FullPrecision if the set is empty.
+   */
+  PiiClassification::ModelPrecision precision() const
+  {
+    return PiiClassification::ModelPrecision(d->iPrecision);
+  }
+
+  /**
+   * Returns the number of models.
+   */
+  int modelCount() const { return d->matCodes.rows(); }
+
+  /**
+   * Returns the number of features in each model.
+   */
+  int featureCount() const { return d->vecOffsets.size(); }
+
+  /**
+   * Returns the number of bytes the codes take.
+   */
+  qint64 byteCount() const { return qint64(d->matCodes.rows()) * d->matCodes.columns(); }
+
+  /**
+   * Decodes the model at *index* and stores [featureCount()]
+   * features to *features*.
+   */
+  void decode(int index, FeatureType* features) const;
+
+  /**
+   * Returns the index of the closest model to *sample*.
+   *
+   * @param sample input feature vector
+   *
+   * @param measure the distance measure
+   *
+   * @param distance an optional output-value argument that will store
+   * the approximate distance to the closest model.
+   *
+   * @return the index of the closest model, or -1 if the set is
+   * empty.
+   */
+  template <class DistanceMeasure>
+  int findClosestMatch(Sample sample,
+                       const DistanceMeasure& measure,
+                       double* distance = 0) const;
+
+  /**
+   * Returns the *n* closest models to *sample* in ascending order
+   * of distance. If the set contains less than *n* models, all of
+   * them will be returned.
+   */
+  template <class DistanceMeasure>
+  PiiClassification::MatchList findClosestMatches(Sample sample,
+                                                  const DistanceMeasure& measure,
+                                                  int n) const;
+
+private:
+  enum { BlockSize = 16 };
+
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : iPrecision(PiiClassification::FullPrecision) {}
+    Data(const Data& other) :
+      PiiSharedD<Data>(),
+      iPrecision(other.iPrecision),
+      vecOffsets(other.vecOffsets),
+      vecScales(other.vecScales),
+      vecInverseScales(other.vecInverseScales),
+      vecSquaredScales(other.vecSquaredScales),
+      matCodes(other.matCodes)
+    {}
+
+    void updateScales();
+
+    int iPrecision;
+    // A feature is decoded as offset + scale * code.
+    QVector<float> vecOffsets, vecScales;
+    QVector<float> vecInverseScales, vecSquaredScales;
+    // One row per model. Half-precision codes take two bytes each.
+    PiiMatrix<unsigned char> matCodes;
+  } *d;
+
+  class Query;
+
+  const unsigned char* byteCodesAt(int index) const { return d->matCodes[index]; }
+  const PiiHalf* halfCodesAt(int index) const { return reinterpret_cast<const PiiHalf*>(d->matCodes[index]); }
+
+  static PiiClassification::DistanceForm distanceForm(const PiiDistanceMeasure<Sample>& measure)
+  {
+    return measure.distanceForm();
+  }
+  template <class DistanceMeasure> static PiiClassification::DistanceForm distanceForm(const DistanceMeasure&)
+  {
+    return PiiClassification::DistanceForm(PiiDistanceForm<DistanceMeasure>::value);
+  }
+
+  template <class DistanceMeasure>
+  void measureDistances(Query& query, const DistanceMeasure& measure,
+                        int first, int count, double bound, double* distances) const;
+  double codeDistance(const Query& query, int index, double bound) const;
+};
+
+#include "PiiQuantizedModelSet-templates.h"
+
+#endif //_PIIQUANTIZEDMODELSET_H
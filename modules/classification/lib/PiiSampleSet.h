@@ -24,9 +24,13 @@
  * but most learning and classification algorithms are written so that
  * they don't expect a specific sample set type. Instead, functions in
  * this namespace are used to access the sample set. If you want to
- * use a different type to hold your sample sets, you need to create
- * an overloaded version for each function in this namespace and
- * specialize the PiiSampleSet::Traits structure.
+ * use a different type to hold your sample sets, you need to
+ * specialize the PiiSampleSet::Traits structure and implement each
+ * function in this namespace either as an overloaded function or as
+ * a static member function of the Traits specialization. Overloads
+ * must be declared before the algorithms that use them; the generic
+ * versions that forward calls to Traits work regardless of the order
+ * of inclusion. See PiiMappedSampleSet for an example.
  *
  */
 namespace PiiSampleSet
@@ -142,6 +146,62 @@ namespace PiiSampleSet
   {
     return Pii::equals(set1, set2);
   }
+
+  /// @hide
+  // Generic versions that pass the call to Traits.
+  template <class SampleSet> inline int sampleCount(const SampleSet& samples)
+  {
+    return Traits<SampleSet>::sampleCount(samples);
+  }
+  template <class SampleSet> inline int featureCount(const SampleSet& samples)
+  {
+    return Traits<SampleSet>::featureCount(samples);
+  }
+  template <class SampleSet> inline void resize(SampleSet& samples, int sampleCount, int featureCount = -1)
+  {
+    Traits<SampleSet>::resize(samples, sampleCount, featureCount);
+  }
+  template <class SampleSet> inline void reserve(SampleSet& samples, int sampleCount, int featureCount = -1)
+  {
+    Traits<SampleSet>::reserve(samples, sampleCount, featureCount);
+  }
+  template <class SampleSet> inline void clear(SampleSet& samples)
+  {
+    Traits<SampleSet>::clear(samples);
+  }
+  template <class SampleSet> inline int capacity(const SampleSet& samples)
+  {
+    return Traits<SampleSet>::capacity(samples);
+  }
+  template <class SampleSet>
+  inline typename Traits<SampleSet>::ConstFeatureIterator sampleAt(const SampleSet& samples, int index)
+  {
+    return Traits<SampleSet>::sampleAt(samples, index);
+  }
+  template <class SampleSet>
+  inline typename Traits<SampleSet>::FeatureIterator sampleAt(SampleSet& samples, int index)
+  {
+    return Traits<SampleSet>::sampleAt(samples, index);
+  }
+  template <class SampleSet>
+  inline void setSampleAt(SampleSet& samples, int index, typename Traits<SampleSet>::ConstFeatureIterator features)
+  {
+    Traits<SampleSet>::setSampleAt(samples, index, features);
+  }
+  template <class SampleSet>
+  inline void append(SampleSet& samples, typename Traits<SampleSet>::ConstFeatureIterator sample)
+  {
+    Traits<SampleSet>::append(samples, sample);
+  }
+  template <class SampleSet> inline void remove(SampleSet& samples, int index)
+  {
+    Traits<SampleSet>::remove(samples, index);
+  }
+  template <class SampleSet> inline bool equals(SampleSet& set1, SampleSet& set2)
+  {
+    return Traits<SampleSet>::equals(set1, set2);
+  }
+  /// @endhide
 }
 
 #endif //_PIISAMPLESET_H
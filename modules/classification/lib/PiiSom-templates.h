@@ -33,6 +33,7 @@ template <class SampleSet> PiiSom<SampleSet>::Data::Data(int width,
   rateFunction(PiiClassification::SomLinearAlpha),
   neighborhood(PiiClassification::SomBubble),
   algorithm(PiiClassification::SomSequentialAlgorithm),
+  iBatchSize(256), iThreadCount(1),
   dMinQErr(0), dMaxQErr(0), dQErrRange(1),
   dMeanDist(0)
 {}
@@ -85,7 +86,7 @@ template <class SampleSet> double PiiSom<SampleSet>::findMostDistantNeighbor(int
   const PII_D;
   const int iSamples = this->sampleCount(), iFeatures = this->featureCount();
   if (iSamples < d->iSizeX * d->iSizeY)
-    return QVector<double>(iSamples, -1);
+    return -1;
 
   int hX = vector1Index % d->iSizeX;
   int hY = vector1Index / d->iSizeX;
@@ -189,6 +190,21 @@ template <class SampleSet> void PiiSom<SampleSet>::learn(const SampleSet& sample
         }
     }
 
+  if (d->algorithm == PiiClassification::SomBatchAlgorithm)
+    {
+      // Cycle through the samples one batch at a time. A batch never
+      // wraps around or exceeds the learning length.
+      for (int iStart = 0; !this->converged(); )
+        {
+          const int iCount = qMin(qMin(qMax(1, d->iBatchSize), iSamples - iStart),
+                                  d->iLearningLength - d->iIterationNumber);
+          adaptToBatch(samples, iStart, iCount);
+          iStart = (iStart + iCount) % iSamples;
+          PII_TRY_CONTINUE(this->controller(), double(d->iIterationNumber)/d->iLearningLength);
+        }
+      return;
+    }
+
   while (true)
     {
       for (int i=0; i<iSamples; ++i)
@@ -294,6 +310,7 @@ template <class SampleSet> void PiiSom<SampleSet>::adaptNeighborhood(int hitX, i
   switch (d->algorithm)
     {
     case PiiClassification::SomSequentialAlgorithm:
+    case PiiClassification::SomBatchAlgorithm:
       alpha = currentLearningRate();
       break;
 
@@ -358,40 +375,171 @@ template <class SampleSet> void PiiSom<SampleSet>::adaptNeighborhood(int hitX, i
   const int iModels = this->modelCount();
   for (int index=0; index < iModels; ++index)
     {
-      // current x,y
-      int tX = index % d->iSizeX;
-      int tY = index / d->iSizeX;
-
-      //distance to the current node at (hitX, hitY)
-      double distance = d->topology == PiiClassification::SomHexagonal ?
-        PiiClassification::somHexagonalDistance(hitX, hitY, tX, tY) :
-        PiiClassification::somSquareDistance(hitX, hitY, tX, tY);
-
-      /* Note that radius is squared! somXXXDistance functions return
-       * a squared distance as well.
-       */
-      switch (d->neighborhood)
-        {
-        case PiiClassification::SomBubble:
-          // Bubble neighborhood equally adapts all vectors within the
-          // current radius
-          if (distance <= radius)
-            PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures, alpha);
-          break;
-        case PiiClassification::SomGaussian:
-          // Gaussian updates all vectors, and weights the update with
-          // a Gaussian function.
-          PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures,
-                                    alpha*std::exp(-distance/(2*radius)));
-          break;
-        case PiiClassification::SomCutGaussian:
-          // Combination of the two above.
-          if (distance <= radius)
-            PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures,
-                                      alpha*std::exp(-distance/(2*radius)));
-          break;
-        }
+      const double dWeight = neighborhoodWeight(hitX, hitY, index % d->iSizeX, index / d->iSizeX, radius);
+      if (dWeight > 0)
+        PiiClassification::adaptVector(this->modelAt(index), vector, iFeatures, alpha * dWeight);
+    }
+}
+
+/*
+ * Returns the weight of the node at (x, y) in the neighborhood of the
+ * winning node at (hitX, hitY). Note that the radius is squared!
+ * somXXXDistance functions return a squared distance as well.
+ */
+template <class SampleSet> double PiiSom<SampleSet>::neighborhoodWeight(int hitX, int hitY,
+                                                                        int x, int y,
+                                                                        double squaredRadius) const
+{
+  const PII_D;
+  //distance to the current node at (hitX, hitY)
+  double distance = d->topology == PiiClassification::SomHexagonal ?
+    PiiClassification::somHexagonalDistance(hitX, hitY, x, y) :
+    PiiClassification::somSquareDistance(hitX, hitY, x, y);
+
+  switch (d->neighborhood)
+    {
+    case PiiClassification::SomBubble:
+      // Bubble neighborhood equally adapts all vectors within the
+      // current radius
+      return distance <= squaredRadius ? 1.0 : 0.0;
+    case PiiClassification::SomGaussian:
+      // Gaussian updates all vectors, and weights the update with
+      // a Gaussian function.
+      return std::exp(-distance/(2*squaredRadius));
+    case PiiClassification::SomCutGaussian:
+      // Combination of the two above.
+      return distance <= squaredRadius ? std::exp(-distance/(2*squaredRadius)) : 0.0;
+    }
+  return 0;
+}
+
+/// @internal
+template <class SampleSet> class PiiSom<SampleSet>::MatchFunction
+{
+public:
+  MatchFunction(const PiiSom* som, const SampleSet& samples, int start, int* matches) :
+    _pSom(som), _samples(samples), _iStart(start), _pMatches(matches)
+  {}
+
+  void operator() (int firstSample, int endSample)
+  {
+    double dDistance;
+    for (int i=firstSample; i<endSample; ++i)
+      _pMatches[i] = _pSom->findClosestMatch(PiiSampleSet::sampleAt(_samples, _iStart + i), &dDistance);
+  }
+
+private:
+  const PiiSom* _pSom;
+  const SampleSet& _samples;
+  const int _iStart;
+  int* _pMatches;
+};
+
+/// @internal
+template <class SampleSet> class PiiSom<SampleSet>::UpdateFunction
+{
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureIterator FeatureIterator;
+
+  UpdateFunction(const PiiSom* som,
+                 FeatureIterator* models,
+                 const QVector<int>& hitNodes,
+                 const double* hits,
+                 const double* sums,
+                 int featureCount,
+                 double rate,
+                 double squaredRadius) :
+    _pSom(som), _pModels(models), _hitNodes(hitNodes), _pHits(hits), _pSums(sums),
+    _iFeatureCount(featureCount), _dRate(rate), _dSquaredRadius(squaredRadius)
+  {}
+
+  void operator() (int firstNode, int endNode)
+  {
+    const int iSizeX = _pSom->width();
+    QVector<double> vecMean(_iFeatureCount);
+    double* pMean = vecMean.data();
+    for (int j=firstNode; j<endNode; ++j)
+      {
+        const int iX = j % iSizeX, iY = j / iSizeX;
+        Pii::fillN(pMean, _iFeatureCount, 0.0);
+        double dTotalWeight = 0;
+        for (int h=0; h<_hitNodes.size(); ++h)
+          {
+            const int iHit = _hitNodes[h];
+            const double dWeight = _pSom->neighborhoodWeight(iHit % iSizeX, iHit / iSizeX, iX, iY, _dSquaredRadius);
+            if (dWeight == 0)
+              continue;
+            dTotalWeight += dWeight * _pHits[iHit];
+            const double* pSum = _pSums + qint64(iHit) * _iFeatureCount;
+            for (int f=0; f<_iFeatureCount; ++f)
+              pMean[f] += dWeight * pSum[f];
+          }
+        if (dTotalWeight == 0)
+          continue;
+        Pii::mapN(pMean, _iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/dTotalWeight));
+        /* Sequentially adapting a code vector n times to the same
+           sample with a learning rate alpha moves it 1 - (1-alpha)^n
+           of the way towards the sample. The weighted mean stands for
+           the samples of the batch.
+         */
+        PiiClassification::adaptVector(_pModels[j], const_cast<const double*>(pMean), _iFeatureCount,
+                                       1.0 - std::pow(1.0 - _dRate, dTotalWeight));
+      }
+  }
+
+private:
+  const PiiSom* _pSom;
+  FeatureIterator* _pModels;
+  const QVector<int>& _hitNodes;
+  const double* _pHits, *_pSums;
+  const int _iFeatureCount;
+  const double _dRate, _dSquaredRadius;
+};
+
+/*
+ * Adapts the code book to count samples starting at start. The
+ * closest code vectors are first found for all samples, and their
+ * sums are collected per winning node. Each code vector is then
+ * moved once towards the neighborhood-weighted mean of the batch.
+ */
+template <class SampleSet> void PiiSom<SampleSet>::adaptToBatch(const SampleSet& samples, int start, int count)
+{
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureIterator FeatureIterator;
+  PII_D;
+  const int iModels = this->modelCount(), iFeatures = this->featureCount();
+
+  QVector<int> vecMatches(count);
+  MatchFunction matcher(this, samples, start, vecMatches.data());
+  Pii::forEachStrip(count, matcher, PiiParallelPolicy(d->iThreadCount, 16));
+
+  // Reduction: sum of samples and the number of hits for each node.
+  QVector<double> vecSums(iModels * iFeatures), vecHits(iModels);
+  QVector<int> vecHitNodes;
+  for (int i=0; i<count; ++i)
+    {
+      const int iMatch = vecMatches[i];
+      if (iMatch < 0)
+        continue;
+      if (vecHits[iMatch]++ == 0)
+        vecHitNodes.append(iMatch);
+      Pii::mapN(vecSums.data() + qint64(iMatch) * iFeatures, iFeatures,
+                PiiSampleSet::sampleAt(samples, start + i), std::plus<double>());
+    }
+
+  if (!vecHitNodes.isEmpty())
+    {
+      // Row pointers are taken here because detaching the code book
+      // is not thread-safe.
+      QVector<FeatureIterator> vecModels(iModels);
+      for (int i=0; i<iModels; ++i)
+        vecModels[i] = this->modelAt(i);
+      const double dRadius = currentRadius();
+      UpdateFunction updater(this, vecModels.data(), vecHitNodes,
+                             vecHits.constData(), vecSums.constData(),
+                             iFeatures, currentLearningRate(), dRadius * dRadius);
+      Pii::forEachStrip(iModels, updater, PiiParallelPolicy(d->iThreadCount, 16));
     }
+  d->iIterationNumber += count;
 }
 
 template <class SampleSet> void PiiSom<SampleSet>::setSize(int width, int height)
@@ -422,4 +570,8 @@ template <class SampleSet> void PiiSom<SampleSet>::setInitMode(PiiClassification
 template <class SampleSet> PiiClassification::SomInitMode PiiSom<SampleSet>::initMode() const { return _d()->initMode; }
 template <class SampleSet> PiiClassification::SomLearningAlgorithm PiiSom<SampleSet>::learningAlgorithm() const { return _d()->algorithm; }
 template <class SampleSet> void PiiSom<SampleSet>::setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm) { _d()->algorithm = algorithm; }
+template <class SampleSet> void PiiSom<SampleSet>::setBatchSize(int batchSize) { _d()->iBatchSize = qMax(1, batchSize); }
+template <class SampleSet> int PiiSom<SampleSet>::batchSize() const { return _d()->iBatchSize; }
+template <class SampleSet> void PiiSom<SampleSet>::setThreadCount(int threadCount) { _d()->iThreadCount = qMax(0, threadCount); }
+template <class SampleSet> int PiiSom<SampleSet>::threadCount() const { return _d()->iThreadCount; }
 template <class SampleSet> int PiiSom<SampleSet>::codeBookCollectionIndex() { return _d()->iCodeBookCollectionIndex; }
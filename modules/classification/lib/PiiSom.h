@@ -20,6 +20,8 @@
 #include "PiiClassificationGlobal.h"
 #include "PiiLearningAlgorithm.h"
 
+#include <PiiParallel.h>
+
 #include <QVector>
 
 /**
@@ -37,7 +39,8 @@
  * sufficient number of iterations (e.g. 10000) has been performed.
  * Each sample tunes the code book according to the then current
  * learning parameters. The class modifies a code book that is given
- * upon construction of the class.
+ * upon construction of the class. With large maps and sample sets,
+ * `SomBatchAlgorithm` processes the samples of a batch in parallel.
  *
  * In classification, the SOM works as a vector quantizer.
  *
@@ -232,6 +235,31 @@ public:
    */
   void setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm);
 
+  /**
+   * Set the number of samples processed at once by the
+   * `SomBatchAlgorithm` learning algorithm in [learn()]. Large
+   * batches parallelize better, but the learning parameters are
+   * updated less frequently. The batch should be small compared to
+   * the learning length. The default value is 256.
+   */
+  void setBatchSize(int batchSize);
+  /**
+   * Get the batch size.
+   */
+  int batchSize() const;
+
+  /**
+   * Set the number of threads used for finding the closest code
+   * vectors and updating the code book with `SomBatchAlgorithm` (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one, which learns in the calling thread only.
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Get the number of learning threads.
+   */
+  int threadCount() const;
+
   int codeBookCollectionIndex();
 
   QVector<double> findMostDistantNeighbors(int* vector1Index = 0, int* vector2Index = 0) const;
@@ -254,6 +282,7 @@ private:
     PiiClassification::SomRateFunction rateFunction;
     PiiClassification::SomNeighborhood neighborhood;
     PiiClassification::SomLearningAlgorithm algorithm;
+    int iBatchSize, iThreadCount;
     double dMinQErr, dMaxQErr, dQErrRange; // storage for the Qerr algorithm
     SampleSet previousSample; // storage for the balanced SOM algorithm
     SampleSet meanSample;
@@ -277,6 +306,11 @@ private:
 
   int adaptTo(ConstFeatureIterator vector);
   void adaptNeighborhood(int hitX, int hitY, ConstFeatureIterator vector, double distance);
+  void adaptToBatch(const SampleSet& samples, int start, int count);
+  inline double neighborhoodWeight(int hitX, int hitY, int x, int y, double squaredRadius) const;
+
+  class MatchFunction;
+  class UpdateFunction;
 };
 
 namespace PiiClassification
@@ -17,6 +17,8 @@
 #define _PIISQUAREDGEOMETRICDISTANCE_H
 
 #include "PiiDistanceMeasure.h"
+#include "PiiDistanceKernels.h"
+#include <PiiHalf.h>
 
 /**
  * Squared geometric distance. The squared geometric distance is
@@ -27,16 +29,75 @@
  * root is a monotonic function. Squared distance however works much
  * faster because no square root needs to be taken.
  *
+ * Since the partial sums never decrease, the distance can be bounded
+ * (see PiiBoundedDistance). `float` and `double` features are
+ * processed with SIMD instructions if the CPU supports them.
  */
-PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiSquaredGeometricDistance)
+PII_BOUNDED_DISTANCE_MEASURE_DEF(PiiSquaredGeometricDistance)
 {
   double sum = 0.0, tmp;
-  for (int i=0; i<length; ++i)
+  if (PiiDistanceKernel<FeatureIterator>::squaredGeometric(sample, model, length, bound, &sum))
+    return sum;
+  // Check the bound once in a block to keep the inner loop tight.
+  enum { BlockSize = 64 };
+  for (int i=0; i<length && sum <= bound; i += BlockSize)
     {
-      tmp = double(sample[i] - model[i]);
-      sum += tmp*tmp;
+      const int iEnd = qMin(i + int(BlockSize), length);
+      for (int j=i; j<iEnd; ++j)
+        {
+          tmp = double(sample[j] - model[j]);
+          sum += tmp*tmp;
+        }
     }
   return sum;
 }
 
+/**
+ * Specialization for half-precision features. The features are
+ * converted to single precision in blocks that fit in the L1 cache,
+ * which is much faster than converting them one at a time. The bound
+ * is checked once per block.
+ */
+template <> class PiiSquaredGeometricDistance<const PiiHalf*>
+{
+public:
+  inline double operator() (const PiiHalf* sample, const PiiHalf* model, int length) const throw()
+  {
+    return operator() (sample, model, length, INFINITY);
+  }
+
+  inline double operator() (const PiiHalf* sample, const PiiHalf* model, int length, double bound) const throw()
+  {
+    enum { BlockSize = 256 };
+    float afSample[BlockSize], afModel[BlockSize];
+    double sum = 0.0, tmp;
+    for (int i=0; i<length && sum <= bound; i += BlockSize)
+      {
+        const int iCount = qMin(int(BlockSize), length - i);
+        Pii::halfToFloatN(sample + i, iCount, afSample);
+        Pii::halfToFloatN(model + i, iCount, afModel);
+        for (int j=0; j<iCount; ++j)
+          {
+            tmp = double(afSample[j] - afModel[j]);
+            sum += tmp*tmp;
+          }
+      }
+    return sum;
+  }
+};
+
+template <> struct PiiBoundedDistance<PiiSquaredGeometricDistance<const PiiHalf*> >
+{
+  static double measure(const PiiSquaredGeometricDistance<const PiiHalf*>& distance,
+                        const PiiHalf* sample, const PiiHalf* model, int length, double bound)
+  {
+    return distance(sample, model, length, bound);
+  }
+};
+
+template <class FeatureIterator> struct PiiDistanceForm<PiiSquaredGeometricDistance<FeatureIterator> >
+{
+  enum { value = PiiClassification::SquaredDifferenceSum };
+};
+
 #endif //_PIISQUAREDGEOMETRICDISTANCE_H
@@ -24,14 +24,16 @@
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data() :
   pMeasure(new PII_POLYMORPHIC_MEASURE(PiiSquaredGeometricDistance)),
-  dRejectThreshold(INFINITY)
+  dRejectThreshold(INFINITY),
+  modelPrecision(PiiClassification::FullPrecision)
 {
 }
 
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data(PiiDistanceMeasure<ConstFeatureIterator>* measure) :
   dRejectThreshold(INFINITY),
-  pMeasure(measure)
+  pMeasure(measure),
+  modelPrecision(PiiClassification::FullPrecision)
 {
 }
 
@@ -78,6 +80,8 @@ PiiDistanceMeasure<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterato
 template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setModels(const SampleSet& models)
 {
   d->modelSet = models;
+  d->index.clear();
+  d->quantizedModels.quantize(d->modelSet, d->modelPrecision);
 }
 
 template <class SampleSet> SampleSet& PiiVectorQuantizer<SampleSet>::models()
@@ -117,6 +121,49 @@ template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setDistanceMeasur
 {
   delete d->pMeasure;
   d->pMeasure = measure;
+  d->index.clear();
+}
+
+template <class SampleSet> void PiiVectorQuantizer<SampleSet>::buildIndex(PiiProgressController* controller)
+{
+  d->index.buildIndex(d->modelSet, *d->pMeasure, controller);
+}
+
+template <class SampleSet> void PiiVectorQuantizer<SampleSet>::removeIndex()
+{
+  d->index.clear();
+}
+
+template <class SampleSet> bool PiiVectorQuantizer<SampleSet>::hasIndex() const
+{
+  return !d->index.isEmpty();
+}
+
+template <class SampleSet> PiiHnswIndex<SampleSet>& PiiVectorQuantizer<SampleSet>::index()
+{
+  return d->index;
+}
+
+template <class SampleSet> const PiiHnswIndex<SampleSet>& PiiVectorQuantizer<SampleSet>::index() const
+{
+  return d->index;
+}
+
+template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setModelPrecision(PiiClassification::ModelPrecision precision)
+{
+  d->modelPrecision = precision;
+  d->quantizedModels.quantize(d->modelSet, precision);
+}
+
+template <class SampleSet> PiiClassification::ModelPrecision PiiVectorQuantizer<SampleSet>::modelPrecision() const
+{
+  return d->modelPrecision;
+}
+
+template <class SampleSet>
+const PiiQuantizedModelSet<SampleSet>& PiiVectorQuantizer<SampleSet>::quantizedModels() const
+{
+  return d->quantizedModels;
 }
 
 template <class SampleSet> double PiiVectorQuantizer<SampleSet>::classify(ConstFeatureIterator features) throw()
@@ -130,10 +177,16 @@ template <class SampleSet> int PiiVectorQuantizer<SampleSet>::findClosestMatch(C
                                                                                double* distance) const throw()
 {
   *distance = INFINITY;
-  int iBestMatch = PiiClassification::findClosestMatch(features,
-                                                       const_cast<const SampleSet&>(d->modelSet),
-                                                       *d->pMeasure,
-                                                       distance);
+  int iBestMatch;
+  if (!d->index.isEmpty())
+    iBestMatch = d->index.findClosestMatch(features, *d->pMeasure, distance);
+  else if (d->useQuantizedModels())
+    iBestMatch = d->quantizedModels.findClosestMatch(features, *d->pMeasure, distance);
+  else
+    iBestMatch = PiiClassification::findClosestMatch(features,
+                                                     const_cast<const SampleSet&>(d->modelSet),
+                                                     *d->pMeasure,
+                                                     distance);
   // Return the index of the closest code vector or -1, if the sample
   // is rejected.
   return *distance <= d->dRejectThreshold ? iBestMatch : -1;
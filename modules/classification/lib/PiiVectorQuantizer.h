@@ -19,6 +19,8 @@
 #include <Pii.h>
 #include "PiiDistanceMeasure.h"
 #include "PiiClassifier.h"
+#include "PiiHnswIndex.h"
+#include "PiiQuantizedModelSet.h"
 
 /**
  * A vector quantizer. Vector quantization is perhaps the most
@@ -29,6 +31,10 @@
  * terms of a [classification_distance_measures] "distance
  * measure".
  *
+ * By default, the closest vector is found with exhaustive search.
+ * With large model sets, [buildIndex()] can be used to speed up the
+ * search at the cost of occasionally missing the exact closest
+ * vector.
  */
 template <class SampleSet> class PiiVectorQuantizer :
   public PiiClassifier<SampleSet>
@@ -130,6 +136,69 @@ public:
    */
   ConstFeatureIterator modelAt(int index) const;
 
+  /**
+   * Builds an approximate nearest neighbor index out of the current
+   * model set using the current distance measure. Once built,
+   * [findClosestMatch()] searches the index instead of comparing the
+   * sample to each model. The index is removed by [setModels()] and
+   * [setDistanceMeasure()]. If the models are modified through
+   * [models()] or [modelAt()], the index must be rebuilt.
+   *
+   * @param controller an optional external controller that can be
+   * used to stop building the index on user request.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted.
+   */
+  void buildIndex(PiiProgressController* controller = 0);
+
+  /**
+   * Removes the nearest neighbor index. Exhaustive search will be
+   * used thereafter.
+   */
+  void removeIndex();
+
+  /**
+   * Returns `true` if a nearest neighbor index has been built.
+   */
+  bool hasIndex() const;
+
+  /**
+   * Returns a modifiable reference to the nearest neighbor index.
+   * Use this function to change the speed/recall trade-off with
+   * PiiHnswIndex::setSearchWidth(), for example.
+   */
+  PiiHnswIndex<SampleSet>& index();
+
+  /**
+   * Returns the nearest neighbor index.
+   */
+  const PiiHnswIndex<SampleSet>& index() const;
+
+  /**
+   * Sets the precision of the models used in classification. If
+   * *precision* is something else than
+   * PiiClassification::FullPrecision, a quantized copy of the
+   * current model set will be created, and [findClosestMatch()] uses
+   * it instead of the full-precision models unless an index has been
+   * built. The full-precision models are retained for learning and
+   * can still be accessed with [models()]. The quantized copy is
+   * recreated by [setModels()]. If the models are modified through
+   * [models()] or [modelAt()], this function must be called again.
+   * The default is PiiClassification::FullPrecision.
+   */
+  void setModelPrecision(PiiClassification::ModelPrecision precision);
+  /**
+   * Returns the precision of the models used in classification.
+   */
+  PiiClassification::ModelPrecision modelPrecision() const;
+
+  /**
+   * Returns the quantized copy of the model set. The set is empty
+   * if the model precision is PiiClassification::FullPrecision.
+   */
+  const PiiQuantizedModelSet<SampleSet>& quantizedModels() const;
+
 protected:
   /// @internal
   class Data
@@ -137,9 +206,21 @@ protected:
   public:
     Data();
     Data(PiiDistanceMeasure<ConstFeatureIterator>* measure);
+    virtual ~Data() {}
     SampleSet modelSet;
     PiiDistanceMeasure<ConstFeatureIterator>* pMeasure;
     double dRejectThreshold;
+    PiiHnswIndex<SampleSet> index;
+    PiiClassification::ModelPrecision modelPrecision;
+    PiiQuantizedModelSet<SampleSet> quantizedModels;
+
+    // Quantized models are used only if they are in sync with the
+    // full-precision ones.
+    bool useQuantizedModels() const
+    {
+      return !quantizedModels.isEmpty() &&
+        quantizedModels.modelCount() == PiiSampleSet::sampleCount(modelSet);
+    }
   } *d;
 
   /// @internal
@@ -0,0 +1,204 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIVOCABULARYTREE_H
+# error "Never use <PiiVocabularyTree-templates.h> directly; include <PiiVocabularyTree.h> instead."
+#endif
+
+#include <QList>
+#include <QPair>
+#include <algorithm>
+
+template <class SampleSet>
+PiiVocabularyTree<SampleSet>::PiiVocabularyTree() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiVocabularyTree<SampleSet>::PiiVocabularyTree(const PiiVocabularyTree& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiVocabularyTree<SampleSet>::~PiiVocabularyTree()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiVocabularyTree<SampleSet>& PiiVocabularyTree<SampleSet>::operator= (const PiiVocabularyTree& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiVocabularyTree<SampleSet>::setBranchingFactor(int branchingFactor)
+{
+  d = d->detach();
+  d->iBranchingFactor = qMax(2, branchingFactor);
+}
+
+template <class SampleSet> void PiiVocabularyTree<SampleSet>::setLeafSize(int leafSize)
+{
+  d = d->detach();
+  d->iLeafSize = qMax(1, leafSize);
+}
+
+template <class SampleSet> void PiiVocabularyTree<SampleSet>::clear()
+{
+  Data* pData = new Data;
+  pData->iBranchingFactor = d->iBranchingFactor;
+  pData->iLeafSize = d->iLeafSize;
+  d->release();
+  d = pData;
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+void PiiVocabularyTree<SampleSet>::buildTree(const SampleSet& modelSet,
+                                             const DistanceMeasure& measure,
+                                             PiiProgressController* controller)
+{
+  clear();
+  const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
+  const int iFeatures = d->iFeatureCount = PiiSampleSet::featureCount(modelSet);
+  if (iFeatures == 0 || iSampleCount == 0)
+    return;
+
+  const int iBranching = d->iBranchingFactor;
+  const int iLeafSize = qMax(d->iLeafSize, iBranching);
+  // Lloyd's algorithm converges slowly near the optimum. A rough
+  // clustering is good enough for a vocabulary.
+  const unsigned int uiKMeansIterations = 10;
+
+  d->centroids = PiiSampleSet::create<SampleSet>(0, iFeatures);
+  QList<QVector<int> > lstWords;
+  int iQuantizedSamples = 0;
+
+  // Nodes waiting to be split, with the samples assigned to them.
+  // The tree is built depth first.
+  typedef QPair<int, QVector<int> > Node;
+  QList<Node> lstNodes;
+  QVector<int> vecAllSamples(iSampleCount);
+  for (int i=0; i<iSampleCount; ++i)
+    vecAllSamples[i] = i;
+  d->vecFirstChildren << -1;
+  d->vecChildCounts << 0;
+  d->vecNodeWords << -1;
+  lstNodes << Node(0, vecAllSamples);
+  vecAllSamples.clear();
+
+  try
+    {
+      while (!lstNodes.isEmpty())
+        {
+          const Node node = lstNodes.last();
+          lstNodes.removeLast();
+          const QVector<int>& vecSamples = node.second;
+          const int iNodeSamples = vecSamples.size();
+
+          if (iNodeSamples > iLeafSize)
+            {
+              SampleSet subset(PiiSampleSet::create<SampleSet>(0, iFeatures));
+              PiiSampleSet::reserve(subset, iNodeSamples);
+              for (int i=0; i<iNodeSamples; ++i)
+                PiiSampleSet::append(subset, PiiSampleSet::sampleAt(modelSet, vecSamples[i]));
+              SampleSet clusters(PiiClassification::kMeans(subset, iBranching, measure, uiKMeansIterations));
+              const int iClusters = PiiSampleSet::sampleCount(clusters);
+
+              QVector<QVector<int> > vecClusterSamples(iClusters);
+              for (int i=0; i<iNodeSamples; ++i)
+                vecClusterSamples[PiiClassification::findClosestMatch(PiiSampleSet::sampleAt(subset, i),
+                                                                      clusters, measure)] << vecSamples[i];
+
+              int iNonEmpty = 0;
+              for (int i=0; i<iClusters; ++i)
+                if (!vecClusterSamples[i].isEmpty())
+                  ++iNonEmpty;
+
+              // Identical samples can't be split. Such a node becomes
+              // a leaf even though it is large.
+              if (iNonEmpty > 1)
+                {
+                  d->vecFirstChildren[node.first] = d->vecFirstChildren.size();
+                  d->vecChildCounts[node.first] = iNonEmpty;
+                  for (int i=0; i<iClusters; ++i)
+                    {
+                      if (vecClusterSamples[i].isEmpty())
+                        continue;
+                      lstNodes << Node(d->vecFirstChildren.size(), vecClusterSamples[i]);
+                      PiiSampleSet::append(d->centroids, PiiSampleSet::sampleAt(const_cast<const SampleSet&>(clusters), i));
+                      d->vecFirstChildren << -1;
+                      d->vecChildCounts << 0;
+                      d->vecNodeWords << -1;
+                    }
+                  continue;
+                }
+            }
+
+          d->vecNodeWords[node.first] = lstWords.size();
+          lstWords << vecSamples;
+          iQuantizedSamples += iNodeSamples;
+          PII_TRY_CONTINUE(controller, double(iQuantizedSamples) / iSampleCount);
+        }
+    }
+  catch (...)
+    {
+      // Don't leave a half-built tree behind.
+      clear();
+      throw;
+    }
+
+  // Flatten the inverted lists.
+  d->vecWordOffsets.reserve(lstWords.size() + 1);
+  d->vecWordSamples.reserve(iSampleCount);
+  d->vecWordOffsets << 0;
+  for (int i=0; i<lstWords.size(); ++i)
+    {
+      QVector<int>& vecSamples = lstWords[i];
+      std::sort(vecSamples.begin(), vecSamples.end());
+      for (int j=0; j<vecSamples.size(); ++j)
+        d->vecWordSamples << vecSamples[j];
+      d->vecWordOffsets << d->vecWordSamples.size();
+    }
+}
+
+template <class SampleSet> template <class DistanceMeasure>
+int PiiVocabularyTree<SampleSet>::quantize(Sample sample, const DistanceMeasure& measure) const
+{
+  if (d->vecNodeWords.isEmpty())
+    return -1;
+
+  QVarLengthArray<Sample, 16> vecCentroids;
+  QVarLengthArray<double, 16> vecDistances;
+  int iNode = 0;
+  while (d->vecFirstChildren[iNode] >= 0)
+    {
+      const int iFirstChild = d->vecFirstChildren[iNode], iChildren = d->vecChildCounts[iNode];
+      vecCentroids.resize(iChildren);
+      vecDistances.resize(iChildren);
+      for (int i=0; i<iChildren; ++i)
+        vecCentroids[i] = centroidAt(iFirstChild + i);
+      PiiClassification::measureDistances(sample, vecCentroids.constData(), iChildren, d->iFeatureCount,
+                                          measure, INFINITY, vecDistances.data());
+      int iClosest = 0;
+      for (int i=1; i<iChildren; ++i)
+        if (vecDistances[i] < vecDistances[iClosest])
+          iClosest = i;
+      iNode = iFirstChild + iClosest;
+    }
+  return d->vecNodeWords[iNode];
+}
@@ -0,0 +1,220 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIVOCABULARYTREE_H
+#define _PIIVOCABULARYTREE_H
+
+#include <QVector>
+#include <QVarLengthArray>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * A vocabulary tree that quantizes feature vectors into "visual
+ * words". The tree is built with hierarchical k-means clustering:
+ * the model samples are divided into [branchingFactor()] clusters,
+ * and each cluster is recursively divided again until it has at most
+ * [leafSize()] samples. The leaves of the tree are the words of the
+ * vocabulary. Quantizing a sample needs `branchingFactor()` distance
+ * calculations per level, which makes the complexity roughly `O(k
+ * log_k N)`.
+ *
+ * Each word has an inverted list that contains the indices of the
+ * model samples that ended up in the word. The tree can thus be used
+ * as an inverted file that quickly retrieves the model samples that
+ * share a word with a query. Samples in the same word are probably,
+ * but not necessarily, close to each other. Unlike PiiKdTree, the
+ * tree works with any distance measure, provided that a mean of
+ * samples makes sense in it. The same measure must be given to
+ * [buildTree()] and [quantize()].
+ *
+ * ~~~(c++)
+ * PiiMatrix<float> matModels(100000, 64);
+ * PiiSquaredGeometricDistance<const float*> measure;
+ * PiiVocabularyTree<PiiMatrix<float> > tree;
+ * tree.buildTree(matModels, measure);
+ * int iWord = tree.quantize(matQuery[0], measure);
+ * for (int i=0; i<tree.wordSize(iWord); ++i)
+ *   qDebug("Model sample %d shares word %d", tree.wordSamples(iWord)[i], iWord);
+ * ~~~
+ */
+template <class SampleSet> class PiiVocabularyTree
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("branching", d->iBranchingFactor);
+    archive & PII_NVP("leafSize", d->iLeafSize);
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("firstChildren", d->vecFirstChildren);
+    archive & PII_NVP("childCounts", d->vecChildCounts);
+    archive & PII_NVP("nodeWords", d->vecNodeWords);
+    archive & PII_NVP("wordOffsets", d->vecWordOffsets);
+    archive & PII_NVP("wordSamples", d->vecWordSamples);
+    archive & PII_NVP("centroids", d->centroids);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  /**
+   * Constructs an empty tree.
+   */
+  PiiVocabularyTree();
+  /**
+   * Constructs a shallow copy of *other*.
+   */
+  PiiVocabularyTree(const PiiVocabularyTree& other);
+  /**
+   * Destroys the tree.
+   */
+  ~PiiVocabularyTree();
+
+  /**
+   * Assigns *other* to `this`.
+   */
+  PiiVocabularyTree& operator= (const PiiVocabularyTree& other);
+
+  /**
+   * Deletes the old tree (if any) and builds a new one out of the
+   * given model samples. The model samples themselves are not
+   * stored; only their indices are kept in the inverted lists.
+   *
+   * @param modelSet model samples
+   *
+   * @param measure the distance measure used in clustering
+   *
+   * @param controller an optional external controller that can be
+   * used to stop building the tree on user request.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted.
+   */
+  template <class DistanceMeasure>
+  void buildTree(const SampleSet& modelSet,
+                 const DistanceMeasure& measure,
+                 PiiProgressController* controller = 0);
+
+  /**
+   * Removes all words from the tree.
+   */
+  void clear();
+
+  /**
+   * Returns `true` if the tree has no words.
+   */
+  bool isEmpty() const { return d->vecNodeWords.isEmpty(); }
+
+  /**
+   * Returns the index of the word *sample* belongs to, or -1 if the
+   * tree is empty.
+   *
+   * @param measure the distance measure. Must be the same that was
+   * used in building the tree.
+   */
+  template <class DistanceMeasure>
+  int quantize(Sample sample, const DistanceMeasure& measure) const;
+
+  /**
+   * Returns the number of words (leaves) in the tree.
+   */
+  int wordCount() const { return qMax(0, d->vecWordOffsets.size() - 1); }
+  /**
+   * Returns the number of model samples in *word*.
+   */
+  int wordSize(int word) const { return d->vecWordOffsets[word+1] - d->vecWordOffsets[word]; }
+  /**
+   * Returns a pointer to the indices of the model samples in *word*.
+   * The array contains [wordSize(word)] indices in ascending order.
+   */
+  const int* wordSamples(int word) const { return d->vecWordSamples.constData() + d->vecWordOffsets[word]; }
+
+  /**
+   * Returns the number of model samples in the tree.
+   */
+  int modelCount() const { return d->vecWordSamples.size(); }
+
+  /**
+   * Sets the number of clusters each node is divided into. Takes
+   * effect when the tree is rebuilt. The default is 10.
+   */
+  void setBranchingFactor(int branchingFactor);
+  /**
+   * Returns the number of clusters each node is divided into.
+   */
+  int branchingFactor() const { return d->iBranchingFactor; }
+
+  /**
+   * Sets the maximum number of samples in a leaf. A node that has
+   * more samples will be split. The smaller the leaves, the more
+   * words there are and the more selective each of them is. Values
+   * smaller than [branchingFactor()] are treated as
+   * [branchingFactor()]. Takes effect when the tree is rebuilt. The
+   * default is 16.
+   */
+  void setLeafSize(int leafSize);
+  /**
+   * Returns the maximum number of samples in a leaf.
+   */
+  int leafSize() const { return d->iLeafSize; }
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() :
+      iBranchingFactor(10), iLeafSize(16), iFeatureCount(0)
+    {}
+    Data(const Data& other) :
+      iBranchingFactor(other.iBranchingFactor),
+      iLeafSize(other.iLeafSize),
+      iFeatureCount(other.iFeatureCount),
+      vecFirstChildren(other.vecFirstChildren),
+      vecChildCounts(other.vecChildCounts),
+      vecNodeWords(other.vecNodeWords),
+      vecWordOffsets(other.vecWordOffsets),
+      vecWordSamples(other.vecWordSamples),
+      centroids(other.centroids)
+    {}
+
+    int iBranchingFactor, iLeafSize;
+    int iFeatureCount;
+    /* The children of a node are stored consecutively. The first
+       child of each node, or -1 for leaves. Node 0 is the root. */
+    QVector<int> vecFirstChildren;
+    QVector<int> vecChildCounts;
+    // The word index of each leaf node, -1 for inner nodes.
+    QVector<int> vecNodeWords;
+    // The inverted lists: samples of word i are at
+    // vecWordSamples[vecWordOffsets[i]] ... vecWordSamples[vecWordOffsets[i+1]-1].
+    QVector<int> vecWordOffsets;
+    QVector<int> vecWordSamples;
+    // Cluster centers. The root has no centroid; node i is at i-1.
+    SampleSet centroids;
+  } *d;
+
+  inline Sample centroidAt(int node) const
+  {
+    return PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->centroids), node-1);
+  }
+};
+
+#include "PiiVocabularyTree-templates.h"
+
+#endif //_PIIVOCABULARYTREE_H
@@ -21,7 +21,9 @@ PiiBoostClassifierOperation::Data::Data() :
   PiiClassifierOperation::Data(PiiClassification::WeightedLearner),
   algorithm(PiiClassification::RealBoost),
   iMaxClassifiers(100),
-  dMinError(0)
+  dMinError(0),
+  iBinCount(0),
+  iLearningThreadCount(1)
 {
 }
 
@@ -39,3 +41,7 @@ void PiiBoostClassifierOperation::setMaxClassifiers(int maxClassifiers) { _d()->
 int PiiBoostClassifierOperation::maxClassifiers() const { return _d()->iMaxClassifiers; }
 void PiiBoostClassifierOperation::setMinError(double minError) { _d()->dMinError = minError; }
 double PiiBoostClassifierOperation::minError() const { return _d()->dMinError; }
+void PiiBoostClassifierOperation::setBinCount(int binCount) { _d()->iBinCount = qBound(0, binCount, 65536); }
+int PiiBoostClassifierOperation::binCount() const { return _d()->iBinCount; }
+void PiiBoostClassifierOperation::setLearningThreadCount(int learningThreadCount) { _d()->iLearningThreadCount = qMax(0, learningThreadCount); }
+int PiiBoostClassifierOperation::learningThreadCount() const { return _d()->iLearningThreadCount; }
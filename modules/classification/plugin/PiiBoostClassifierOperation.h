@@ -18,8 +18,7 @@
 
 #include "PiiClassifierOperation.h"
 #include "PiiBoostClassifier.h"
-#include "PiiDefaultClassifierFactory.h"
-#include "PiiDecisionStump.h"
+#include "PiiDecisionStumpFactory.h"
 #include "PiiSampleSetCollector.h"
 
 /**
@@ -52,6 +51,23 @@ class PiiBoostClassifierOperation : public PiiClassifierOperation
    */
   Q_PROPERTY(double minError READ minError WRITE setMinError);
 
+  /**
+   * The maximum number of distinct thresholds tried on each feature.
+   * If this value is non-zero, feature values are quantized into at
+   * most this many bins with approximately the same number of
+   * samples. This speeds up learning with large sample sets at the
+   * cost of slightly less accurate thresholds. Zero means that all
+   * distinct feature values will be tried. The default is zero.
+   */
+  Q_PROPERTY(int binCount READ binCount WRITE setBinCount);
+
+  /**
+   * The maximum number of threads used in training the weak
+   * classifiers. Features are evaluated in parallel. Zero means the
+   * ideal number of threads for the system. The default is one.
+   */
+  Q_PROPERTY(int learningThreadCount READ learningThreadCount WRITE setLearningThreadCount);
+
 public:
   template <class SampleSet> class Template;
 
@@ -66,6 +82,8 @@ protected:
     PiiClassification::BoostingAlgorithm algorithm;
     int iMaxClassifiers;
     double dMinError;
+    int iBinCount;
+    int iLearningThreadCount;
   };
   PII_D_FUNC;
   /// @internal
@@ -77,6 +95,10 @@ protected:
   int maxClassifiers() const;
   void setMinError(double minError);
   double minError() const;
+  void setBinCount(int binCount);
+  int binCount() const;
+  void setLearningThreadCount(int learningThreadCount);
+  int learningThreadCount() const;
 };
 
 template <class T> struct MsvcHack
@@ -88,7 +110,7 @@ template <class T> struct MsvcHack
 /// @internal
 template <class SampleSet> class PiiBoostClassifierOperation::Template :
   public PiiBoostClassifierOperation,
-  public PiiDefaultClassifierFactory<PiiDecisionStump<SampleSet> >
+  public PiiDecisionStumpFactory<SampleSet>
 {
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
@@ -136,6 +158,9 @@ private:
     PiiBoostClassifier<SampleSet>* pClassifier = new PiiBoostClassifier<SampleSet>(this, d->algorithm);
     pClassifier->setMaxClassifiers(d->iMaxClassifiers);
     pClassifier->setMinError(d->dMinError);
+    // The operation has properties with the same names.
+    PiiDecisionStumpFactory<SampleSet>::setBinCount(d->iBinCount);
+    PiiDecisionStumpFactory<SampleSet>::setThreadCount(d->iLearningThreadCount);
     return pClassifier;
   }
 };
@@ -196,11 +221,15 @@ void PiiBoostClassifierOperation::Template<SampleSet>::collectSample(double labe
 template <class SampleSet> bool PiiBoostClassifierOperation::Template<SampleSet>::learnBatch()
 {
   PII_D;
+  // The classifier replaced last time is no longer in use.
+  delete d->pNewClassifier;
   d->pNewClassifier = createClassifier();
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
                                                      *d->collector.samples(),
                                                      *d->collector.classLabels(),
                                                      *d->collector.sampleWeights());
+  // The sorted samples are only needed during learning.
+  this->clearIndex();
   if (!bSuccess)
     {
       delete d->pNewClassifier;
@@ -213,9 +242,8 @@ template <class SampleSet> bool PiiBoostClassifierOperation::Template<SampleSet>
 template <class SampleSet> void PiiBoostClassifierOperation::Template<SampleSet>::replaceClassifier()
 {
   PII_D;
-  delete d->pClassifier;
-  d->pClassifier = d->pNewClassifier;
-  d->pNewClassifier = 0;
+  // The old classifier will be deleted in the learning thread.
+  qSwap(d->pClassifier, d->pNewClassifier);
 }
 
 template <class SampleSet> void PiiBoostClassifierOperation::Template<SampleSet>::resetClassifier()
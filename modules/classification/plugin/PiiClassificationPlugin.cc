@@ -100,6 +100,11 @@ PII_REGISTER_DISTANCE_MEASURES(PiiSquaredGeometricDistance);
 PII_REGISTER_DISTANCE_MEASURES(PiiCosineDistance);
 PII_REGISTER_DISTANCE_MEASURES(PiiAbsDiffDistance);
 
+PII_REGISTER_DISTANCE_MEASURE(PiiGeometricDistance, PiiHalf);
+PII_REGISTER_DISTANCE_MEASURE(PiiSquaredGeometricDistance, PiiHalf);
+PII_REGISTER_DISTANCE_MEASURE(PiiCosineDistance, PiiHalf);
+PII_REGISTER_DISTANCE_MEASURE(PiiAbsDiffDistance, PiiHalf);
+
 PII_REGISTER_DISTANCE_MEASURES(PiiLogLikelihood);
 PII_REGISTER_DISTANCE_MEASURES(PiiHistogramIntersection);
 PII_REGISTER_DISTANCE_MEASURES(PiiJeffreysDivergence);
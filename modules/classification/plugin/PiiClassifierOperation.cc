@@ -70,6 +70,12 @@ void PiiClassifierOperation::check(bool reset)
   d->pLabelInput->setOptional(d->iLearningBatchSize == 0 ||
                               d->capabilities & PiiClassification::NonSupervisedLearner);
   PiiDefaultOperation::check(reset);
+  {
+    // A classifier may have been trained while the operation was
+    // stopped or paused.
+    QMutexLocker lock(&d->learningMutex);
+    takeNewClassifier();
+  }
   if (reset)
     {
       stopLearningThread();
@@ -93,6 +99,9 @@ void PiiClassifierOperation::process()
   PII_D;
   QMutexLocker lock(&d->learningMutex);
 
+  // The learning thread publishes new classifiers without locking.
+  takeNewClassifier();
+
   // Collect samples for training only if requested (by setting batch
   // size to a non-zero value) and if the learning thread is not
   // already running.
@@ -119,20 +128,40 @@ void PiiClassifierOperation::process()
 
 bool PiiClassifierOperation::learningThread()
 {
-  _d()->strLearningError.clear();
+  PII_D;
+  d->strLearningError.clear();
 
   if (learnBatch())
     {
-      QMutexLocker lock(&_d()->learningMutex);
-      replaceClassifier();
-      emit progressed(1.0);
-      emit learningFinished(true);
+      // Publish the new classifier. If the operation is running, the
+      // processing thread takes it into use on the next round.
+      // Otherwise, replace the classifier right away.
+      d->iClassifierPending.storeRelease(1);
+      if (state() != Running)
+        {
+          QMutexLocker lock(&d->learningMutex);
+          takeNewClassifier();
+        }
       return true;
     }
   emit learningFinished(false);
   return false;
 }
 
+bool PiiClassifierOperation::takeNewClassifier()
+{
+  PII_D;
+  // Called with learningMutex locked, so only one thread at a time
+  // can get here.
+  if (d->iClassifierPending.loadAcquire() == 0)
+    return false;
+  replaceClassifier();
+  d->iClassifierPending.storeRelease(0);
+  emit progressed(1.0);
+  emit learningFinished(true);
+  return true;
+}
+
 bool PiiClassifierOperation::needsThread() const
 {
   return true;
@@ -148,6 +177,9 @@ bool PiiClassifierOperation::startLearningThread(bool startThread)
 {
   PII_D;
   QMutexLocker lock(&d->learningMutex);
+  // If the previous result hasn't been taken into use yet, do it now
+  // because learnBatch() may reuse its storage.
+  takeNewClassifier();
   if (!needsThread())
     {
       replaceClassifier();
@@ -21,6 +21,7 @@
 #include "PiiClassification.h"
 #include "PiiClassifier.h"
 #include "PiiLearningAlgorithm.h"
+#include <PiiAtomicInt.h>
 #include <QMutex>
 
 class QThread;
@@ -107,7 +108,12 @@ namespace PiiClassification
  * [startLearningThread()] function. Although learning is usually done
  * off-line, it is possible to start the learning thread while the
  * operation is running. The old classifier will be replaced by the
- * new one once the learning thread finishes. The downside of run-time
+ * new one once the learning thread finishes. The learning thread
+ * trains a private copy of the classifier and only publishes it when
+ * done. The processing thread takes the published classifier into
+ * use between two classifications by swapping pointers. Therefore,
+ * classification never waits for learning, and its latency doesn't
+ * change during run-time training. The downside of run-time
  * learning is that the old classifier must be kept in memory while
  * training. If you want to avoid this, [reset](reset()) the old
  * classifier before learning.
@@ -321,7 +327,10 @@ signals:
   void progressed(double percentage);
 
   /**
-   * This signal is emitted when the learning thread finishes.
+   * This signal is emitted when the learning thread finishes. If the
+   * operation is running, a successfully trained classifier is taken
+   * into use in the processing thread, and the signal will be
+   * emitted once the next sample has been received.
    *
    * @param success `true` if the learning was successful, `false`
    * otherwise. If an error occurs during training, the [learningError]
@@ -350,6 +359,9 @@ protected:
     QMutex learningMutex;
     bool bThreadRunning;
     QString strLearningError;
+    // Set to one by the learning thread when a new classifier is
+    // ready to replace the current one.
+    PiiAtomicInt iClassifierPending;
   };
   PII_D_FUNC;
 
@@ -429,6 +441,12 @@ protected:
    * classifier provides information about itself as properties (such
    * as the code book of an NN classifier), these property values need
    * to be changed here.
+   *
+   * If the operation is running, this function will be called in the
+   * processing thread just before the next classification. To keep
+   * the latency of classification steady, only swap pointers here.
+   * Freeing the old classifier can be postponed to the next
+   * [learnBatch()] call, which happens in the learning thread.
    */
   virtual void replaceClassifier() = 0;
 
@@ -616,6 +634,7 @@ private:
   void init();
   bool learningThread();
   bool startLearningThread(bool startThread);
+  bool takeNewClassifier();
 };
 
 
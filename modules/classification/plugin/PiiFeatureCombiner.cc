@@ -28,7 +28,8 @@ PiiFeatureCombiner::Data::Data() :
   iLearningBatchSize(0),
   fullBufferBehavior(PiiFeatureCombiner::OverwriteRandomSample),
   pLearningThread(0),
-  iSampleIndex(0)
+  iSampleIndex(0),
+  bNormalize(false)
 {
 }
 
@@ -80,6 +81,24 @@ void PiiFeatureCombiner::check(bool reset)
       d->lstDistanceMeasureNames.size() != dynamicInputCount())
     PII_THROW(PiiExecutionException, tr("The number of distance measures must match the number of feature vectors."));
 
+  const bool bWasNormalizing = d->bNormalize;
+  d->matOffset = PiiYdin::convertMatrixTo<double>(d->varNormalizationOffset);
+  d->matScale = PiiYdin::convertMatrixTo<double>(d->varNormalizationScale);
+  d->matProjection = PiiYdin::convertMatrixTo<double>(d->varProjection);
+  if (d->varNormalizationOffset.isValid() && d->matOffset.rows() != 1)
+    PII_THROW(PiiExecutionException, tr("Normalization offset must be a row vector."));
+  if (d->varNormalizationScale.isValid() && d->matScale.rows() != 1)
+    PII_THROW(PiiExecutionException, tr("Normalization scale must be a row vector."));
+  if (d->varProjection.isValid() && d->matProjection.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Projection must be a non-empty numeric matrix."));
+  if (!d->matProjection.isEmpty() && d->iLearningBatchSize != 0)
+    PII_THROW(PiiExecutionException, tr("Distance variances cannot be learnt if a projection is applied."));
+  d->bNormalize = !d->matOffset.isEmpty() || !d->matScale.isEmpty() || !d->matProjection.isEmpty();
+  // The sizes are checked and defaults filled in once the feature
+  // count is known.
+  if (d->bNormalize || bWasNormalizing)
+    d->uiMaxType = 0;
+
   qDeleteAll(d->lstDistanceMeasures);
   d->lstDistanceMeasures.clear();
   for (int i=0; i<d->lstDistanceMeasureNames.size(); ++i)
@@ -102,6 +121,15 @@ void PiiFeatureCombiner::process()
   if (d->uiMaxType == 0)
     initializeBoundaries();
 
+  if (d->bNormalize)
+    {
+      if (d->uiMaxType == PiiYdin::DoubleMatrixType)
+        emitNormalized<double>();
+      else
+        emitNormalized<float>();
+      return;
+    }
+
   // Max type id determines the output type (smaller ids are more "primitive")
   switch (d->uiMaxType)
     {
@@ -139,6 +167,42 @@ void PiiFeatureCombiner::initializeBoundaries()
       if (uiType > d->uiMaxType)
         d->uiMaxType = uiType;
     }
+
+  if (d->bNormalize)
+    initializeNormalization();
+}
+
+void PiiFeatureCombiner::initializeNormalization()
+{
+  PII_D;
+  const int iLength = d->iTotalLength;
+  if (d->matOffset.isEmpty())
+    d->matOffset = PiiMatrix<double>(1, iLength);
+  else if (d->matOffset.columns() != iLength)
+    PII_THROW(PiiExecutionException, tr("Normalization offset has %1 elements, but there are %2 features.")
+              .arg(d->matOffset.columns()).arg(iLength));
+  if (d->matScale.isEmpty())
+    {
+      d->matScale = PiiMatrix<double>(1, iLength);
+      d->matScale = 1.0;
+    }
+  else if (d->matScale.columns() != iLength)
+    PII_THROW(PiiExecutionException, tr("Normalization scale has %1 elements, but there are %2 features.")
+              .arg(d->matScale.columns()).arg(iLength));
+
+  if (!d->matProjection.isEmpty())
+    {
+      if (d->matProjection.columns() != iLength)
+        PII_THROW(PiiExecutionException, tr("Projection has %1 columns, but there are %2 features.")
+                  .arg(d->matProjection.columns()).arg(iLength));
+      d->matNormalized = PiiMatrix<double>::uninitialized(1, iLength);
+      // The projected vector has no parts.
+      PiiMatrix<int> matBoundaries(1,1);
+      matBoundaries(0,0) = d->matProjection.rows();
+      d->varBoundaries = PiiVariant(matBoundaries);
+    }
+  else
+    d->matNormalized.clear();
 }
 
 template <class T> void PiiFeatureCombiner::emitCompound(int totalLength)
@@ -183,6 +247,77 @@ template <class T> void PiiFeatureCombiner::emitCompound(int totalLength)
 
       matBoundaries(0, i) = pResultRow - pBegin;
     }
+
+  storeSample(pBegin);
+
+  d->pFeatureOutput->emitObject(matResult);
+  d->pBoundaryOutput->emitObject(d->varBoundaries);
+}
+
+template <class T> void PiiFeatureCombiner::emitNormalized()
+{
+  PII_D;
+  if (d->matProjection.isEmpty())
+    {
+      // Offset and scale are applied while copying the input values
+      // into the output vector.
+      PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(1, d->iTotalLength));
+      normalizeInputs(matResult.row(0));
+      storeSample(matResult.row(0));
+      d->pFeatureOutput->emitObject(matResult);
+    }
+  else
+    {
+      double* pNormalized = d->matNormalized.row(0);
+      normalizeInputs(pNormalized);
+      const int iRows = d->matProjection.rows(), iColumns = d->iTotalLength;
+      PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(1, iRows));
+      T* pResult = matResult.row(0);
+      for (int r=0; r<iRows; ++r)
+        pResult[r] = T(Pii::innerProductN(d->matProjection.row(r), iColumns, pNormalized, 0.0));
+      d->pFeatureOutput->emitObject(matResult);
+    }
+  d->pBoundaryOutput->emitObject(d->varBoundaries);
+}
+
+template <class T> void PiiFeatureCombiner::normalizeInputs(T* row)
+{
+  PII_D;
+  const double* pOffset = d->matOffset.row(0), *pScale = d->matScale.row(0);
+  const bool bStoreBoundaries = d->matProjection.isEmpty();
+  PiiMatrix<int>& matBoundaries = d->varBoundaries.valueAs<PiiMatrix<int> >();
+  int iStart = 0;
+  for (int i=0; i<inputCount(); ++i)
+    {
+      PiiVariant obj = inputAt(i)->firstObject();
+      // In: the number of features left. Out: the number of features
+      // written, or -1 if the input doesn't fit.
+      int iColumns = d->iTotalLength - iStart;
+      switch (obj.type())
+        {
+          PII_PRIMITIVE_MATRIX_CASES_M(normalizeMatrixAs, (obj, pOffset + iStart, pScale + iStart,
+                                                          row + iStart, &iColumns));
+          PII_PRIMITIVE_CASES_M(normalizeScalarAs, (obj, pOffset + iStart, pScale + iStart,
+                                                    row + iStart, &iColumns));
+        default:
+          PII_THROW_UNKNOWN_TYPE(inputAt(i));
+        }
+      if (iColumns < 0)
+        PII_THROW(PiiExecutionException,
+                  tr("The feature vector read from the \"%1%0\" input is not a row matrix, or its size has changed.")
+                  .arg("features").arg(i));
+      iStart += iColumns;
+      if (bStoreBoundaries)
+        matBoundaries(0, i) = iStart;
+    }
+  if (iStart != d->iTotalLength)
+    PII_THROW(PiiExecutionException, tr("The number of features has changed from %1 to %2.")
+              .arg(d->iTotalLength).arg(iStart));
+}
+
+template <class T> void PiiFeatureCombiner::storeSample(const T* sample)
+{
+  PII_D;
   // If batch size is non-zero, store the compound feature vector
   // into our buffer.
   if (d->iLearningBatchSize != 0 && !learningThreadRunning())
@@ -217,12 +352,9 @@ template <class T> void PiiFeatureCombiner::emitCompound(int totalLength)
           pNewRow = d->matBuffer[iOverwriteIndex % d->matBuffer.rows()];
         }
       if (pNewRow != 0)
-        Pii::copyN(pBegin, d->iTotalLength, pNewRow);
+        Pii::copyN(sample, d->iTotalLength, pNewRow);
       ++d->iSampleIndex;
     }
-
-  d->pFeatureOutput->emitObject(matResult);
-  d->pBoundaryOutput->emitObject(d->varBoundaries);
 }
 
 template <class T, class U> void PiiFeatureCombiner::copyMatrixAs(const PiiVariant& obj, U* row, int* columns)
@@ -238,6 +370,38 @@ template <class T, class U> void PiiFeatureCombiner::copyScalarAs(const PiiVaria
   *row = static_cast<U>(obj.valueAs<T>());
 }
 
+template <class T, class U> void PiiFeatureCombiner::normalizeMatrixAs(const PiiVariant& obj,
+                                                                       const double* offset,
+                                                                       const double* scale,
+                                                                       U* row, int* columns)
+{
+  const PiiMatrix<T>& mat = obj.valueAs<PiiMatrix<T> >();
+  const int iColumns = mat.columns();
+  if (mat.rows() != 1 || iColumns > *columns)
+    {
+      *columns = -1;
+      return;
+    }
+  const T* pValues = mat.row(0);
+  for (int i=0; i<iColumns; ++i)
+    row[i] = U((double(pValues[i]) - offset[i]) * scale[i]);
+  *columns = iColumns;
+}
+
+template <class T, class U> void PiiFeatureCombiner::normalizeScalarAs(const PiiVariant& obj,
+                                                                       const double* offset,
+                                                                       const double* scale,
+                                                                       U* row, int* columns)
+{
+  if (*columns < 1)
+    {
+      *columns = -1;
+      return;
+    }
+  *row = U((double(obj.valueAs<T>()) - *offset) * *scale);
+  *columns = 1;
+}
+
 void PiiFeatureCombiner::learnBatch()
 {
   PII_D;
@@ -337,5 +501,12 @@ void PiiFeatureCombiner::setLearningBatchSize(int learningBatchSize)
 int PiiFeatureCombiner::learningBatchSize() const { return _d()->iLearningBatchSize; }
 bool PiiFeatureCombiner::learningThreadRunning() const { return _d()->pLearningThread->isRunning(); }
 
+void PiiFeatureCombiner::setNormalizationOffset(const PiiVariant& normalizationOffset) { _d()->varNormalizationOffset = normalizationOffset; }
+PiiVariant PiiFeatureCombiner::normalizationOffset() const { return _d()->varNormalizationOffset; }
+void PiiFeatureCombiner::setNormalizationScale(const PiiVariant& normalizationScale) { _d()->varNormalizationScale = normalizationScale; }
+PiiVariant PiiFeatureCombiner::normalizationScale() const { return _d()->varNormalizationScale; }
+void PiiFeatureCombiner::setProjection(const PiiVariant& projection) { _d()->varProjection = projection; }
+PiiVariant PiiFeatureCombiner::projection() const { return _d()->varProjection; }
+
 void PiiFeatureCombiner::setFullBufferBehavior(FullBufferBehavior fullBufferBehavior) { _d()->fullBufferBehavior = fullBufferBehavior; }
 PiiFeatureCombiner::FullBufferBehavior PiiFeatureCombiner::fullBufferBehavior() const { return _d()->fullBufferBehavior; }
@@ -82,6 +82,46 @@
  * 0.3, 4, 5, 6, 7, 80.0 ]. The `boundaries` output will emit a
  * PiiMatrix<int> [ 3, 7, 8 ].
  *
+ * Normalization
+ * -------------
+ *
+ * A precomputed normalization can be applied to the compound vector
+ * while it is being combined. This avoids separate normalization and
+ * projection operations that would each copy the whole vector. If
+ * any of [normalizationOffset], [normalizationScale] and
+ * [projection] is set, the operation emits
+ *
+ * \[
+ * y = P ((x - o) \circ s),
+ * \]
+ *
+ * where *x* is the compound vector, *o* and *s* the offset and
+ * scale vectors, \(\circ\) stands for element-wise multiplication
+ * and *P* is the projection matrix. Missing parts are left out. The
+ * result is a PiiMatrix<double> if any input is double and a
+ * PiiMatrix<float> otherwise. Without a projection, the offset and
+ * scale are applied as the input values are copied, and the result
+ * is written only once. The projection needs the whole normalized
+ * vector, which is stored into a buffer allocated once for all
+ * samples.
+ *
+ * For example, to decorrelate and whiten the combined features
+ * using principal components learnt off-line:
+ *
+ * ~~~(c++)
+ * PiiIncrementalPca<double> pca;
+ * pca.addSamples(matTrainingFeatures);
+ * PiiMatrix<double> matV(pca.baseVectors()), matSv(pca.singularValues());
+ * // The base vectors are the columns of V. Each one is divided by
+ * // the standard deviation along it.
+ * const double dSqrtN = std::sqrt(pca.sampleCount() - 1.0);
+ * PiiMatrix<double> matWhitening(iDimensions, matV.rows());
+ * for (int r=0; r<iDimensions; ++r)
+ *   for (int c=0; c<matV.rows(); ++c)
+ *     matWhitening(r,c) = matV(c,r) * dSqrtN / matSv(r);
+ * pCombiner->setProperty("normalizationOffset", PiiVariant(pca.mean()));
+ * pCombiner->setProperty("projection", PiiVariant(matWhitening));
+ * ~~~
  */
 class PiiFeatureCombiner : public PiiDefaultOperation
 {
@@ -149,6 +189,34 @@ class PiiFeatureCombiner : public PiiDefaultOperation
    */
   Q_PROPERTY(bool learningThreadRunning READ learningThreadRunning);
 
+  /**
+   * A row vector that is subtracted from each compound feature
+   * vector, for example the mean of training samples. Any primitive
+   * matrix type. The length must equal [featureCount]. By default,
+   * the value is invalid, and no offset is applied.
+   */
+  Q_PROPERTY(PiiVariant normalizationOffset READ normalizationOffset WRITE setNormalizationOffset);
+
+  /**
+   * A row vector whose elements multiply the corresponding features
+   * after [normalizationOffset] has been subtracted, for example the
+   * inverses of feature standard deviations. Any primitive matrix
+   * type. The length must equal [featureCount]. By default, the value
+   * is invalid, and the features are not scaled.
+   */
+  Q_PROPERTY(PiiVariant normalizationScale READ normalizationScale WRITE setNormalizationScale);
+
+  /**
+   * A M-by-[featureCount] matrix that projects the normalized feature
+   * vector to M dimensions, for example a whitening matrix whose rows
+   * are scaled principal components. Any primitive matrix type. If
+   * this property is set, the `boundaries` output emits a single
+   * boundary, M, and distance learning ([learningBatchSize]) cannot
+   * be used. By default, the value is invalid, and no projection is
+   * applied.
+   */
+  Q_PROPERTY(PiiVariant projection READ projection WRITE setProjection);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -185,6 +253,13 @@ public:
   int featureCount() const;
   bool learningThreadRunning() const;
 
+  void setNormalizationOffset(const PiiVariant& normalizationOffset);
+  PiiVariant normalizationOffset() const;
+  void setNormalizationScale(const PiiVariant& normalizationScale);
+  PiiVariant normalizationScale() const;
+  void setProjection(const PiiVariant& projection);
+  PiiVariant projection() const;
+
 public slots:
   /**
    * Start the learning thread. If the number of buffered samples is
@@ -240,13 +315,28 @@ private:
     PiiMatrix<double> matBuffer;
     PiiMatrix<int> matStoredBoundaries;
     mutable QMutex learningMutex;
+    PiiVariant varNormalizationOffset, varNormalizationScale, varProjection;
+    bool bNormalize;
+    // Normalization parameters converted to double in check() and
+    // filled with defaults once the feature count is known.
+    PiiMatrix<double> matOffset, matScale, matProjection;
+    // The normalized vector before projection.
+    PiiMatrix<double> matNormalized;
   };
   PII_D_FUNC;
 
   void initializeBoundaries();
+  void initializeNormalization();
   template <class T> void emitCompound(int totalLength);
+  template <class T> void emitNormalized();
+  template <class T> void normalizeInputs(T* row);
+  template <class T> void storeSample(const T* sample);
   template <class T, class U> void copyMatrixAs(const PiiVariant& obj, U* row, int* columns);
   template <class T, class U> void copyScalarAs(const PiiVariant& obj, U* row, int* columns);
+  template <class T, class U> void normalizeMatrixAs(const PiiVariant& obj, const double* offset,
+                                                     const double* scale, U* row, int* columns);
+  template <class T, class U> void normalizeScalarAs(const PiiVariant& obj, const double* offset,
+                                                     const double* scale, U* row, int* columns);
 
   void learnBatch();
 };
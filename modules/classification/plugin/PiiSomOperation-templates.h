@@ -57,6 +57,10 @@ protected:
   void setInitMode(PiiClassification::SomInitMode mode) { _d()->pClassifier->setInitMode(mode); }
   PiiClassification::SomLearningAlgorithm learningAlgorithm() const { return _d()->pClassifier->learningAlgorithm(); }
   void setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm) { _d()->pClassifier->setLearningAlgorithm(algorithm); }
+  int batchSize() const { return _d()->pClassifier->batchSize(); }
+  void setBatchSize(int batchSize) { _d()->pClassifier->setBatchSize(batchSize); }
+  int learningThreadCount() const { return _d()->pClassifier->threadCount(); }
+  void setLearningThreadCount(int learningThreadCount) { _d()->pClassifier->setThreadCount(learningThreadCount); }
 
   double classify();
   double learnOne(double label, double weight);
@@ -174,6 +178,8 @@ template <class SampleSet> void PiiSomOperation::Template<SampleSet>::resetClass
 template <class SampleSet> bool PiiSomOperation::Template<SampleSet>::learnBatch()
 {
   PII_D;
+  // The classifier replaced last time is no longer in use.
+  delete d->pNewClassifier;
   d->pNewClassifier = createSom();
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
                                                      *d->collector.samples(),
@@ -190,9 +196,8 @@ template <class SampleSet> bool PiiSomOperation::Template<SampleSet>::learnBatch
 template <class SampleSet> void PiiSomOperation::Template<SampleSet>::replaceClassifier()
 {
   PII_D;
-  delete d->pClassifier;
-  d->pClassifier = d->pNewClassifier;
-  d->pNewClassifier = 0;
+  // The old SOM will be deleted in the learning thread.
+  qSwap(d->pClassifier, d->pNewClassifier);
   d->varModels = PiiVariant(d->pClassifier->models());
 }
 
@@ -209,6 +214,8 @@ template <class SampleSet> PiiSom<SampleSet>* PiiSomOperation::Template<SampleSe
   pSom->setIterationNumber(d->pClassifier->iterationNumber());
   pSom->setInitMode(d->pClassifier->initMode());
   pSom->setLearningAlgorithm(d->pClassifier->learningAlgorithm());
+  pSom->setBatchSize(d->pClassifier->batchSize());
+  pSom->setThreadCount(d->pClassifier->threadCount());
   return pSom;
 }
 
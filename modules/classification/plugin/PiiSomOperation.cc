@@ -51,7 +51,9 @@ void PiiSomOperation::protectProps()
       "initialRadius",
       "initialLearningRate",
       "initMode",
-      "learningAlgorithm"
+      "learningAlgorithm",
+      "batchSize",
+      "learningThreadCount"
     };
   for (unsigned i=0; i<sizeof(protectedProps)/sizeof(protectedProps[0]); ++i)
     setProtectionLevel(protectedProps[i], WriteWhenStoppedOrPaused);
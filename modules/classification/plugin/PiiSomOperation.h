@@ -124,6 +124,20 @@ class PII_CLASSIFICATION_EXPORT PiiSomOperation : public PiiVectorQuantizerOpera
    */
   Q_PROPERTY(PiiClassification::SomLearningAlgorithm learningAlgorithm READ learningAlgorithm WRITE setLearningAlgorithm);
 
+  /**
+   * The number of samples processed at once by
+   * `PiiClassification::SomBatchAlgorithm`. The default value is
+   * 256.
+   */
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize);
+
+  /**
+   * The number of threads used in batch learning (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one.
+   */
+  Q_PROPERTY(int learningThreadCount READ learningThreadCount WRITE setLearningThreadCount);
+
 public:
   template <class SampleSet> class Template;
 
@@ -170,6 +184,10 @@ protected:
   virtual void setInitMode(PiiClassification::SomInitMode mode) = 0;
   virtual PiiClassification::SomLearningAlgorithm learningAlgorithm() const = 0;
   virtual void setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm) = 0;
+  virtual int batchSize() const = 0;
+  virtual void setBatchSize(int batchSize) = 0;
+  virtual int learningThreadCount() const = 0;
+  virtual void setLearningThreadCount(int learningThreadCount) = 0;
 
 private:
   void protectProps();
@@ -75,6 +75,8 @@ void PiiVectorQuantizerOperation::check(PiiVectorQuantizer<SampleSet>& classifie
 {
   PII_D;
   PiiClassifierOperation::check(reset);
+  // setModels() quantizes the new models.
+  classifier.setModelPrecision(d->modelPrecision);
   setModels(classifier);
   if (d->vecClassLabels.size() != 0 &&
       d->vecClassLabels.size() != classifier.modelCount())
@@ -20,6 +20,7 @@ PiiVectorQuantizerOperation::Data::Data(PiiClassification::LearnerCapabilities c
   PiiClassifierOperation::Data(capabilities),
   distanceCombinationMode(PiiClassification::DistanceSum),
   dRejectThreshold(INFINITY),
+  modelPrecision(PiiClassification::FullPrecision),
   bMultiFeatureMeasure(false),
   bMustConfigureBoundaries(false)
 {
@@ -108,6 +109,8 @@ void PiiVectorQuantizerOperation::setDistanceMeasures(const QStringList& names)
 QStringList PiiVectorQuantizerOperation::distanceMeasures() const { return _d()->lstDistanceMeasures; }
 double PiiVectorQuantizerOperation::rejectThreshold() const { return _d()->dRejectThreshold; }
 void PiiVectorQuantizerOperation::setRejectThreshold(double rejectThreshold) { _d()->dRejectThreshold = rejectThreshold; }
+PiiClassification::ModelPrecision PiiVectorQuantizerOperation::modelPrecision() const { return _d()->modelPrecision; }
+void PiiVectorQuantizerOperation::setModelPrecision(PiiClassification::ModelPrecision modelPrecision) { _d()->modelPrecision = modelPrecision; }
 void PiiVectorQuantizerOperation::setModels(const PiiVariant& models) { _d()->varModels = models; }
 PiiVariant PiiVectorQuantizerOperation::models() const { return _d()->varModels; }
 void PiiVectorQuantizerOperation::setDistanceWeights(const QVariantList& distanceWeights) { _d()->lstDistanceWeights = distanceWeights; }
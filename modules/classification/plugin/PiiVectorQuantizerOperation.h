@@ -108,6 +108,17 @@ class PII_CLASSIFICATION_EXPORT PiiVectorQuantizerOperation : public PiiClassifi
    */
   Q_PROPERTY(double rejectThreshold READ rejectThreshold WRITE setRejectThreshold);
 
+  /**
+   * The precision of the model samples used in classification. With
+   * a large model set, storing the models as 8-bit integers or
+   * half-precision numbers reduces memory consumption and speeds up
+   * classification at the cost of accuracy. The full-precision
+   * models are retained for learning. See
+   * PiiClassification::ModelPrecision. The default is
+   * `FullPrecision`.
+   */
+  Q_PROPERTY(PiiClassification::ModelPrecision modelPrecision READ modelPrecision WRITE setModelPrecision);
+
   /**
    * The model samples as a PiiVariant. The variant will usually
    * hold a PiiMatrix whose data type equals the type of the
@@ -142,6 +153,7 @@ protected:
     QVariantList lstDistanceWeights;
     PiiClassification::DistanceCombinationMode distanceCombinationMode;
     double dRejectThreshold;
+    PiiClassification::ModelPrecision modelPrecision;
     QVector<double> vecClassLabels;
     bool bMultiFeatureMeasure;
     bool bMustConfigureBoundaries;
@@ -163,6 +175,9 @@ protected:
   double rejectThreshold() const;
   void setRejectThreshold(double rejectThreshold);
 
+  PiiClassification::ModelPrecision modelPrecision() const;
+  void setModelPrecision(PiiClassification::ModelPrecision modelPrecision);
+
   void setModels(const PiiVariant& models);
   PiiVariant models() const;
 
@@ -0,0 +1,746 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiColorKernels.h"
+
+#include <PiiCpu.h>
+#include <PiiMath.h>
+#include <PiiTypeTraits.h>
+#include <cstring>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define PII_COLORS_SSE2 1
+#elif defined(PII_NEON) && defined(__aarch64__)
+// Division is not available on 32-bit ARM.
+#  include <arm_neon.h>
+#  define PII_COLORS_NEON 1
+#endif
+
+namespace PiiColors
+{
+  namespace
+  {
+    bool isVectorized()
+    {
+#if defined(PII_COLORS_SSE2)
+      return Pii::hasCpuFeature(Pii::CpuSse2);
+#elif defined(PII_COLORS_NEON)
+      return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+      return false;
+#endif
+    }
+
+#ifdef PII_COLORS_SSE2
+    namespace Sse2
+    {
+      struct Ops
+      {
+        typedef __m128 Vec;
+        typedef __m128 Mask;
+        typedef __m128i IVec;
+
+        static inline Vec zero() { return _mm_setzero_ps(); }
+        static inline Vec set1(float value) { return _mm_set1_ps(value); }
+        static inline Vec load(const float* data) { return _mm_loadu_ps(data); }
+        static inline void store(float* data, Vec value) { _mm_storeu_ps(data, value); }
+        static inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static inline Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+        static inline Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+        static inline Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        static inline Mask equal(Vec a, Vec b) { return _mm_cmpeq_ps(a, b); }
+        static inline Mask greaterEqual(Vec a, Vec b) { return _mm_cmpge_ps(a, b); }
+        static inline Mask lessEqual(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+        // mask ? a : b
+        static inline Vec select(Mask mask, Vec a, Vec b)
+        {
+          return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+        static inline void transpose(Vec& a, Vec& b, Vec& c, Vec& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+        static inline IVec loadInt(const void* data) { return _mm_loadu_si128(static_cast<const __m128i*>(data)); }
+        static inline IVec setInt(int w0, int w1, int w2, int w3) { return _mm_set_epi32(w3, w2, w1, w0); }
+        static inline void storeInt(int* data, IVec value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value); }
+        static inline IVec andInt(IVec a, int mask) { return _mm_and_si128(a, _mm_set1_epi32(mask)); }
+        static inline IVec orInt(IVec a, IVec b) { return _mm_or_si128(a, b); }
+        template <int bits> static inline IVec shiftRight(IVec a) { return _mm_srli_epi32(a, bits); }
+        template <int bits> static inline IVec shiftLeft(IVec a) { return _mm_slli_epi32(a, bits); }
+        static inline Vec toFloat(IVec a) { return _mm_cvtepi32_ps(a); }
+        static inline IVec truncate(Vec a) { return _mm_cvttps_epi32(a); }
+        // Stores four integers in [0,255] as bytes.
+        static inline void storeBytes(unsigned char* data, IVec value)
+        {
+          __m128i packed = _mm_packs_epi32(value, value);
+          int iWord = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+          std::memcpy(data, &iWord, 4);
+        }
+      };
+    }
+#endif
+
+#ifdef PII_COLORS_NEON
+    namespace Neon
+    {
+      struct Ops
+      {
+        typedef float32x4_t Vec;
+        typedef uint32x4_t Mask;
+        typedef int32x4_t IVec;
+
+        static inline Vec zero() { return vdupq_n_f32(0); }
+        static inline Vec set1(float value) { return vdupq_n_f32(value); }
+        static inline Vec load(const float* data) { return vld1q_f32(data); }
+        static inline void store(float* data, Vec value) { vst1q_f32(data, value); }
+        static inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+        static inline Vec mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+        static inline Vec div(Vec a, Vec b) { return vdivq_f32(a, b); }
+        static inline Vec min(Vec a, Vec b) { return vminq_f32(a, b); }
+        static inline Vec max(Vec a, Vec b) { return vmaxq_f32(a, b); }
+        static inline Mask equal(Vec a, Vec b) { return vceqq_f32(a, b); }
+        static inline Mask greaterEqual(Vec a, Vec b) { return vcgeq_f32(a, b); }
+        static inline Mask lessEqual(Vec a, Vec b) { return vcleq_f32(a, b); }
+        static inline Vec select(Mask mask, Vec a, Vec b) { return vbslq_f32(mask, a, b); }
+        static inline void transpose(Vec& a, Vec& b, Vec& c, Vec& d)
+        {
+          float32x4_t ab0 = vzip1q_f32(a, b), ab1 = vzip2q_f32(a, b);
+          float32x4_t cd0 = vzip1q_f32(c, d), cd1 = vzip2q_f32(c, d);
+          a = vreinterpretq_f32_f64(vzip1q_f64(vreinterpretq_f64_f32(ab0), vreinterpretq_f64_f32(cd0)));
+          b = vreinterpretq_f32_f64(vzip2q_f64(vreinterpretq_f64_f32(ab0), vreinterpretq_f64_f32(cd0)));
+          c = vreinterpretq_f32_f64(vzip1q_f64(vreinterpretq_f64_f32(ab1), vreinterpretq_f64_f32(cd1)));
+          d = vreinterpretq_f32_f64(vzip2q_f64(vreinterpretq_f64_f32(ab1), vreinterpretq_f64_f32(cd1)));
+        }
+
+        static inline IVec loadInt(const void* data) { return vreinterpretq_s32_u8(vld1q_u8(static_cast<const uint8_t*>(data))); }
+        static inline IVec setInt(int w0, int w1, int w2, int w3)
+        {
+          int32_t aWords[4] = { w0, w1, w2, w3 };
+          return vld1q_s32(aWords);
+        }
+        static inline void storeInt(int* data, IVec value) { vst1q_s32(data, value); }
+        static inline IVec andInt(IVec a, int mask) { return vandq_s32(a, vdupq_n_s32(mask)); }
+        static inline IVec orInt(IVec a, IVec b) { return vorrq_s32(a, b); }
+        template <int bits> static inline IVec shiftRight(IVec a)
+        {
+          return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), bits));
+        }
+        template <int bits> static inline IVec shiftLeft(IVec a) { return vshlq_n_s32(a, bits); }
+        static inline Vec toFloat(IVec a) { return vcvtq_f32_s32(a); }
+        static inline IVec truncate(Vec a) { return vcvtq_s32_f32(a); }
+        static inline void storeBytes(unsigned char* data, IVec value)
+        {
+          int16x4_t narrow = vmovn_s32(value);
+          uint8_t aBytes[8];
+          vst1_u8(aBytes, vqmovun_s16(vcombine_s16(narrow, narrow)));
+          std::memcpy(data, aBytes, 4);
+        }
+      };
+    }
+#endif
+
+    // Rounds half-way cases away from zero, like roundf() does.
+    template <class Ops> inline typename Ops::Vec roundAway(typename Ops::Vec value)
+    {
+      typedef typename Ops::Vec Vec;
+      Vec truncated = Ops::toFloat(Ops::truncate(value));
+      Vec fraction = Ops::sub(value, truncated);
+      const Vec one = Ops::set1(1), zero = Ops::zero();
+      truncated = Ops::add(truncated, Ops::select(Ops::greaterEqual(fraction, Ops::set1(0.5f)), one, zero));
+      return Ops::sub(truncated, Ops::select(Ops::lessEqual(fraction, Ops::set1(-0.5f)), one, zero));
+    }
+
+    /* Pixels<Ops,Clr> transposes four interleaved pixels to channel
+       vectors and back. Channels are indexed in memory order:
+       channel[0] is c2, channel[2] is c0. The fourth channel of a
+       three-channel color loads as zero, and stores always set the
+       fourth channel to zero, just like the color constructors do.
+
+       Three-channel colors are loaded and stored four bytes or floats
+       at a time. This touches the first channel of the pixel
+       following the block. Overrun tells how many extra pixels must be
+       available. Since stores proceed from left to right, the extra
+       channel will be overwritten with the correct value later.
+     */
+    template <class Ops, class Clr> struct Pixels;
+
+    template <class Ops> struct Pixels<Ops, PiiColor4<unsigned char> >
+    {
+      typedef typename Ops::Vec Vec;
+      typedef typename Ops::IVec IVec;
+      enum { Overrun = 0 };
+
+      static inline void split(IVec words, Vec* channels)
+      {
+        channels[0] = Ops::toFloat(Ops::andInt(words, 0xff));
+        channels[1] = Ops::toFloat(Ops::andInt(Ops::template shiftRight<8>(words), 0xff));
+        channels[2] = Ops::toFloat(Ops::andInt(Ops::template shiftRight<16>(words), 0xff));
+      }
+
+      static inline IVec combine(const Vec* channels)
+      {
+        return Ops::orInt(Ops::truncate(channels[0]),
+                          Ops::orInt(Ops::template shiftLeft<8>(Ops::truncate(channels[1])),
+                                     Ops::template shiftLeft<16>(Ops::truncate(channels[2]))));
+      }
+
+      static inline void load(const PiiColor4<unsigned char>* pixels, Vec* channels)
+      {
+        IVec words = Ops::loadInt(pixels);
+        split(words, channels);
+        channels[3] = Ops::toFloat(Ops::template shiftRight<24>(words));
+      }
+
+      static inline void store(PiiColor4<unsigned char>* pixels, const Vec* channels)
+      {
+        int aWords[4];
+        Ops::storeInt(aWords, combine(channels));
+        // The cast tells the compiler that copying raw bytes into
+        // PiiColor4 is intended.
+        std::memcpy(static_cast<void*>(pixels), aWords, 16);
+      }
+    };
+
+    template <class Ops> struct Pixels<Ops, PiiColor<unsigned char> >
+    {
+      typedef typename Ops::Vec Vec;
+      typedef Pixels<Ops, PiiColor4<unsigned char> > Words;
+      enum { Overrun = 1 };
+
+      static inline void load(const PiiColor<unsigned char>* pixels, Vec* channels)
+      {
+        int aWords[4];
+        for (int i=0; i<4; ++i)
+          std::memcpy(aWords + i, static_cast<const void*>(pixels + i), 4);
+        Words::split(Ops::setInt(aWords[0], aWords[1], aWords[2], aWords[3]), channels);
+        channels[3] = Ops::zero();
+      }
+
+      static inline void store(PiiColor<unsigned char>* pixels, const Vec* channels)
+      {
+        int aWords[4];
+        Ops::storeInt(aWords, Words::combine(channels));
+        for (int i=0; i<4; ++i)
+          std::memcpy(static_cast<void*>(pixels + i), aWords + i, 4);
+      }
+    };
+
+    template <class Ops> struct Pixels<Ops, PiiColor4<float> >
+    {
+      typedef typename Ops::Vec Vec;
+      enum { Overrun = 0 };
+
+      static inline void load(const PiiColor4<float>* pixels, Vec* channels)
+      {
+        const float* pData = reinterpret_cast<const float*>(pixels);
+        for (int i=0; i<4; ++i)
+          channels[i] = Ops::load(pData + 4*i);
+        Ops::transpose(channels[0], channels[1], channels[2], channels[3]);
+      }
+
+      static inline void store(PiiColor4<float>* pixels, const Vec* channels)
+      {
+        Vec a = channels[0], b = channels[1], c = channels[2], d = Ops::zero();
+        Ops::transpose(a, b, c, d);
+        float* pData = reinterpret_cast<float*>(pixels);
+        Ops::store(pData, a);
+        Ops::store(pData + 4, b);
+        Ops::store(pData + 8, c);
+        Ops::store(pData + 12, d);
+      }
+    };
+
+    template <class Ops> struct Pixels<Ops, PiiColor<float> >
+    {
+      typedef typename Ops::Vec Vec;
+      enum { Overrun = 1 };
+
+      static inline void load(const PiiColor<float>* pixels, Vec* channels)
+      {
+        const float* pData = reinterpret_cast<const float*>(pixels);
+        for (int i=0; i<4; ++i)
+          channels[i] = Ops::load(pData + 3*i);
+        Ops::transpose(channels[0], channels[1], channels[2], channels[3]);
+        channels[3] = Ops::zero();
+      }
+
+      static inline void store(PiiColor<float>* pixels, const Vec* channels)
+      {
+        Vec a = channels[0], b = channels[1], c = channels[2], d = Ops::zero();
+        Ops::transpose(a, b, c, d);
+        float* pData = reinterpret_cast<float*>(pixels);
+        Ops::store(pData, a);
+        Ops::store(pData + 3, b);
+        Ops::store(pData + 6, c);
+        Ops::store(pData + 9, d);
+      }
+    };
+
+    // Stores four values of a single channel.
+    template <class Ops, class T> struct Channel;
+
+    template <class Ops> struct Channel<Ops, float>
+    {
+      static inline void store(float* data, typename Ops::Vec values) { Ops::store(data, values); }
+    };
+
+    template <class Ops> struct Channel<Ops, unsigned char>
+    {
+      // Converts like a cast, which keeps the lowest eight bits.
+      static inline void store(unsigned char* data, typename Ops::Vec values)
+      {
+        Ops::storeBytes(data, Ops::andInt(Ops::truncate(values), 0xff));
+      }
+    };
+
+    /* Output<Ops,Out> stores three logical channels (c0, c1, c2) to
+       a color image, or the first one to a gray-level image. Integer
+       channels are clamped to [0, maximum] and rounded.
+     */
+    template <class Ops, class Out> struct Output : Pixels<Ops, Out>
+    {
+      typedef typename Ops::Vec Vec;
+      enum { ChannelCount = 3 };
+
+      static inline void store(Out* pixels, const Vec* values, float maximum)
+      {
+        Vec aChannels[3] = { values[2], values[1], values[0] };
+        if (Pii::IsInteger<typename Out::Type>::boolValue)
+          {
+            const Vec vMax = Ops::set1(maximum), vZero = Ops::zero();
+            for (int i=0; i<3; ++i)
+              aChannels[i] = roundAway<Ops>(Ops::min(Ops::max(aChannels[i], vZero), vMax));
+          }
+        Pixels<Ops, Out>::store(pixels, aChannels);
+      }
+    };
+
+    template <class Ops> struct Output<Ops, float>
+    {
+      enum { ChannelCount = 1, Overrun = 0 };
+
+      static inline void store(float* data, const typename Ops::Vec* values, float)
+      {
+        Ops::store(data, values[0]);
+      }
+    };
+
+    /* Runs kernel.block() over all pixels, four at a time. The last
+       columns of each row are copied to temporary buffers so that
+       they go through exactly the same arithmetic.
+     */
+    template <class Ops, class In, class Out, class Kernel>
+    void processPixels(const PiiMatrix<In>& image, const Kernel& kernel, PiiMatrix<Out>& result)
+    {
+      const int iRows = image.rows(), iCols = image.columns();
+      const int iOverrun = qMax(int(Pixels<Ops,In>::Overrun), int(Output<Ops,Out>::Overrun));
+      In aInput[8];
+      Out aOutput[8];
+      for (int r=0; r<iRows; ++r)
+        {
+          const In* pInput = image[r];
+          Out* pOutput = result[r];
+          int c = 0;
+          for (; c + 4 + iOverrun <= iCols; c += 4)
+            kernel.template block<Ops>(pInput + c, pOutput + c);
+          if (c < iCols)
+            {
+              const int iCount = iCols - c;
+              for (int i=0; i<iCount; ++i)
+                aInput[i] = pInput[c+i];
+              kernel.template block<Ops>(aInput, aOutput);
+              for (int i=0; i<iCount; ++i)
+                pOutput[c+i] = aOutput[i];
+            }
+        }
+    }
+
+    /* Runs kernel.block() over all pixels and stores the four
+       resulting channel vectors to separate channel images. Null
+       channel pointers are skipped.
+     */
+    template <class Ops, class In, class Kernel>
+    void processChannels(const PiiMatrix<In>& image, const Kernel& kernel,
+                         PiiMatrix<typename In::Type>** channels, int channelCount)
+    {
+      typedef typename In::Type T;
+      typedef typename Ops::Vec Vec;
+      const int iRows = image.rows(), iCols = image.columns();
+      In aInput[8];
+      Vec aValues[4];
+      T* apChannels[4];
+      for (int r=0; r<iRows; ++r)
+        {
+          const In* pInput = image[r];
+          for (int i=0; i<channelCount; ++i)
+            apChannels[i] = channels[i] != 0 ? channels[i]->row(r) : 0;
+          int c = 0;
+          for (; c + 4 + Pixels<Ops,In>::Overrun <= iCols; c += 4)
+            {
+              kernel.template block<Ops>(pInput + c, aValues);
+              for (int i=0; i<channelCount; ++i)
+                if (apChannels[i] != 0)
+                  Channel<Ops,T>::store(apChannels[i] + c, aValues[i]);
+            }
+          if (c < iCols)
+            {
+              const int iCount = iCols - c;
+              for (int i=0; i<iCount; ++i)
+                aInput[i] = pInput[c+i];
+              kernel.template block<Ops>(aInput, aValues);
+              for (int i=0; i<channelCount; ++i)
+                if (apChannels[i] != 0)
+                  {
+                    T aTail[4];
+                    Channel<Ops,T>::store(aTail, aValues[i]);
+                    for (int j=0; j<iCount; ++j)
+                      apChannels[i][c+j] = aTail[j];
+                  }
+            }
+        }
+    }
+
+    /* Multiplies the logical channels (c0, c1, c2) by a 3-by-4
+       matrix whose last column is an offset. The products are summed
+       in the same order as in GenericConversion.
+     */
+    class LinearKernel
+    {
+    public:
+      LinearKernel(double maximum = 0) : _bOffset(false), _fMaximum(float(maximum))
+      {
+        std::memset(_aCoefficients, 0, sizeof(_aCoefficients));
+      }
+
+      void setRow(int row, double c0, double c1, double c2, double offset = 0)
+      {
+        _aCoefficients[row][0] = float(c0);
+        _aCoefficients[row][1] = float(c1);
+        _aCoefficients[row][2] = float(c2);
+        _aCoefficients[row][3] = float(offset);
+        if (offset != 0)
+          _bOffset = true;
+      }
+
+      template <class Ops, class In, class Out> void block(const In* input, Out* output) const
+      {
+        typedef typename Ops::Vec Vec;
+        Vec aChannels[4], aValues[3];
+        Pixels<Ops,In>::load(input, aChannels);
+        for (int i=0; i<Output<Ops,Out>::ChannelCount; ++i)
+          {
+            Vec value = Ops::add(Ops::add(Ops::mul(Ops::set1(_aCoefficients[i][0]), aChannels[2]),
+                                          Ops::mul(Ops::set1(_aCoefficients[i][1]), aChannels[1])),
+                                 Ops::mul(Ops::set1(_aCoefficients[i][2]), aChannels[0]));
+            if (_bOffset)
+              value = Ops::add(value, Ops::set1(_aCoefficients[i][3]));
+            aValues[i] = value;
+          }
+        Output<Ops,Out>::store(output, aValues, _fMaximum);
+      }
+
+    private:
+      float _aCoefficients[3][4];
+      bool _bOffset;
+      float _fMaximum;
+    };
+
+    // Mirrors rgbToHsv() for unsigned char channels.
+    struct HsvKernel
+    {
+      template <class Ops, class Clr> void block(const Clr* input, Clr* output) const
+      {
+        typedef typename Ops::Vec Vec;
+        Vec aChannels[4];
+        Pixels<Ops,Clr>::load(input, aChannels);
+        const Vec r = aChannels[2], g = aChannels[1], b = aChannels[0];
+        const Vec vMax = Ops::max(Ops::max(r, g), b);
+        const Vec vDelta = Ops::sub(vMax, Ops::min(Ops::min(r, g), b));
+        const Vec vZero = Ops::zero();
+        const Vec vSixth = Ops::set1(256.0f/6);
+
+        Vec vHue = Ops::add(Ops::set1(2*256.0f/3), Ops::div(Ops::mul(vSixth, Ops::sub(r, g)), vDelta));
+        vHue = Ops::select(Ops::equal(g, vMax),
+                           Ops::add(Ops::set1(256.0f/3), Ops::div(Ops::mul(vSixth, Ops::sub(b, r)), vDelta)),
+                           vHue);
+        vHue = Ops::select(Ops::equal(r, vMax), Ops::div(Ops::mul(vSixth, Ops::sub(g, b)), vDelta), vHue);
+        vHue = Ops::select(Ops::equal(vDelta, vZero), vZero, roundAway<Ops>(vHue));
+        // Negative hues wrap around the 256-level hue circle.
+        vHue = Ops::toFloat(Ops::andInt(Ops::truncate(vHue), 0xff));
+
+        Vec vSaturation = roundAway<Ops>(Ops::div(Ops::mul(Ops::set1(255), vDelta), vMax));
+        vSaturation = Ops::select(Ops::equal(vMax, vZero), vZero, vSaturation);
+
+        Vec aHsv[3] = { vMax, vSaturation, vHue };
+        Pixels<Ops,Clr>::store(output, aHsv);
+      }
+    };
+
+    // Mirrors the inner loop of normalizedRgb().
+    class NormalizedRgbKernel
+    {
+    public:
+      NormalizedRgbKernel(float multiplier, int ch1Index, int ch2Index) :
+        _fMultiplier(multiplier), _iCh1Index(ch1Index), _iCh2Index(ch2Index)
+      {}
+
+      template <class Ops, class Clr> void block(const Clr* input, typename Ops::Vec* values) const
+      {
+        typedef typename Ops::Vec Vec;
+        Vec aChannels[4];
+        Pixels<Ops,Clr>::load(input, aChannels);
+        const Vec vSum = Ops::add(Ops::add(aChannels[2], aChannels[1]), aChannels[0]);
+        const typename Ops::Mask black = Ops::equal(vSum, Ops::zero());
+        const Vec vNormalizer = Ops::div(Ops::set1(_fMultiplier), vSum);
+        values[0] = Ops::select(black, Ops::zero(), Ops::mul(vNormalizer, aChannels[_iCh1Index]));
+        values[1] = Ops::select(black, Ops::zero(), Ops::mul(vNormalizer, aChannels[_iCh2Index]));
+      }
+
+    private:
+      float _fMultiplier;
+      int _iCh1Index, _iCh2Index;
+    };
+
+    // Reorders channels from memory order to logical order.
+    struct SplitKernel
+    {
+      template <class Ops, class Clr> void block(const Clr* input, typename Ops::Vec* values) const
+      {
+        typename Ops::Vec aChannels[4];
+        Pixels<Ops,Clr>::load(input, aChannels);
+        values[0] = aChannels[2];
+        values[1] = aChannels[1];
+        values[2] = aChannels[0];
+        values[3] = aChannels[3];
+      }
+    };
+
+    template <class In, class Out, class Kernel>
+    bool runPixels(const PiiMatrix<In>& image, const Kernel& kernel, PiiMatrix<Out>& result)
+    {
+      if (!isVectorized())
+        return false;
+      PiiMatrix<Out> matResult(PiiMatrix<Out>::uninitialized(image.rows(), image.columns()));
+#if defined(PII_COLORS_SSE2)
+      processPixels<Sse2::Ops>(image, kernel, matResult);
+#elif defined(PII_COLORS_NEON)
+      processPixels<Neon::Ops>(image, kernel, matResult);
+#endif
+      result = matResult;
+      return true;
+    }
+
+    template <class In, class Kernel>
+    bool runChannels(const PiiMatrix<In>& image, const Kernel& kernel,
+                     PiiMatrix<typename In::Type>** channels, int channelCount)
+    {
+      if (!isVectorized())
+        return false;
+      for (int i=0; i<channelCount; ++i)
+        if (channels[i] != 0)
+          channels[i]->resize(image.rows(), image.columns());
+#if defined(PII_COLORS_SSE2)
+      processChannels<Sse2::Ops>(image, kernel, channels, channelCount);
+#elif defined(PII_COLORS_NEON)
+      processChannels<Neon::Ops>(image, kernel, channels, channelCount);
+#endif
+      return true;
+    }
+
+    // BT.709 luma and the scaling constants of color differences,
+    // see rgbToYpbpr().
+    const double dKr = 0.2126, dKg = 0.7152, dKb = 0.0722;
+    const double dPbScale = 0.53890924768269023496, dPrScale = 0.63500127000254000508;
+
+    void setLumaRow(LinearKernel& kernel)
+    {
+      kernel.setRow(0, dKr, dKg, dKb);
+    }
+
+    LinearKernel rgbToYpbprKernel(double halfMaximum = 0, double maximum = 0)
+    {
+      LinearKernel kernel(maximum);
+      setLumaRow(kernel);
+      kernel.setRow(1, -dPbScale * dKr, -dPbScale * dKg, dPbScale * (1 - dKb), halfMaximum);
+      kernel.setRow(2, dPrScale * (1 - dKr), -dPrScale * dKg, -dPrScale * dKb, halfMaximum);
+      return kernel;
+    }
+
+    LinearKernel ypbprToRgbKernel(double halfMaximum = 0, double maximum = 0)
+    {
+      const double dRCr = 1.5748, dGCb = -0.18732427293064876958,
+        dGCr = -0.46812427293064876957, dBCb = 1.8556;
+      LinearKernel kernel(maximum);
+      kernel.setRow(0, 1, 0, dRCr, -dRCr * halfMaximum);
+      kernel.setRow(1, 1, dGCb, dGCr, -(dGCb + dGCr) * halfMaximum);
+      kernel.setRow(2, 1, dBCb, 0, -dBCb * halfMaximum);
+      return kernel;
+    }
+
+    // The scalar versions clamp to maximum after rounding, which
+    // only works the same way with integer maxima.
+    bool isValidMaximum(double maximum)
+    {
+      return maximum >= 1 && maximum <= 255 && maximum == int(maximum);
+    }
+
+    /* A lookup table for the cube root in [0,1]. Linear
+       interpolation between the entries is refined with a Newton
+       step, which makes the result accurate to about one unit in the
+       last place.
+     */
+    class CubeRootTable
+    {
+    public:
+      enum { Size = 1024 };
+
+      CubeRootTable()
+      {
+        for (int i=0; i<=Size; ++i)
+          _afTable[i] = float(Pii::pow(double(i)/Size, 1.0/3.0));
+      }
+
+      float operator() (float value) const
+      {
+        float fPosition = value * Size;
+        int iIndex = qMin(int(fPosition), Size-1);
+        float fRoot = _afTable[iIndex] + (fPosition - iIndex) * (_afTable[iIndex+1] - _afTable[iIndex]);
+        return fRoot - (fRoot * fRoot * fRoot - value) / (3 * fRoot * fRoot);
+      }
+
+    private:
+      float _afTable[Size+1];
+    };
+
+    const CubeRootTable cubeRoot;
+
+    inline float labF(float value)
+    {
+      if (value > 0.008856451679035631)
+        return value <= 1 ? cubeRoot(value) : Pii::pow(value, 1.0f/3.0f);
+      return float(7.787037037037036*value + 16.0/116.0);
+    }
+
+    template <class Clr> bool xyzToLabImpl(const PiiMatrix<Clr>& image, const Clr& whitePoint, PiiMatrix<Clr>& result)
+    {
+      PiiMatrix<Clr> matResult(PiiMatrix<Clr>::uninitialized(image.rows(), image.columns()));
+      const int iRows = image.rows(), iCols = image.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          const Clr* pInput = image[r];
+          Clr* pOutput = matResult[r];
+          for (int c=0; c<iCols; ++c)
+            {
+              float fx = labF(pInput[c].xyzX/whitePoint.xyzX);
+              float fy = labF(pInput[c].xyzY/whitePoint.xyzY);
+              float fz = labF(pInput[c].xyzZ/whitePoint.xyzZ);
+              pOutput[c] = Clr(116*fy - 16, 500*(fx - fy), 200*(fy - fz));
+            }
+        }
+      result = matResult;
+      return true;
+    }
+  }
+
+#define PII_DEFINE_COMMON_COLOR_KERNELS(COLOR)                          \
+  bool ColorKernel<COLOR >::genericConversion(const PiiMatrix<COLOR >& image, \
+                                              const PiiMatrix<float>& matrix, \
+                                              PiiMatrix<PiiColor<float> >& result) \
+  {                                                                     \
+    if (matrix.rows() < 3 || matrix.columns() < 3)                      \
+      return false;                                                     \
+    LinearKernel kernel;                                                \
+    for (int i=0; i<3; ++i)                                             \
+      kernel.setRow(i, matrix(i,0), matrix(i,1), matrix(i,2));          \
+    return runPixels(image, kernel, result);                            \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::rgbToY709(const PiiMatrix<COLOR >& image, PiiMatrix<float>& result) \
+  {                                                                     \
+    LinearKernel kernel;                                                \
+    setLumaRow(kernel);                                                 \
+    return runPixels(image, kernel, result);                            \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::normalizedRgb(const PiiMatrix<COLOR >& image, \
+                                          PiiMatrix<T>& ch1, PiiMatrix<T>& ch2, \
+                                          float multiplier, int ch1Index, int ch2Index) \
+  {                                                                     \
+    PiiMatrix<T>* apChannels[2] = { &ch1, &ch2 };                       \
+    return runChannels(image, NormalizedRgbKernel(multiplier, (2-ch1Index) & 3, (2-ch2Index) & 3), \
+                       apChannels, 2);                                  \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::splitChannels(const PiiMatrix<COLOR >& image, PiiMatrix<T>** channels) \
+  {                                                                     \
+    return runChannels(image, SplitKernel(), channels, COLOR::ChannelCount); \
+  }
+
+#define PII_DEFINE_INTEGER_COLOR_KERNELS(COLOR)                         \
+  PII_DEFINE_COMMON_COLOR_KERNELS(COLOR)                                \
+  bool ColorKernel<COLOR >::rgbToYpbpr(const PiiMatrix<COLOR >&, PiiMatrix<COLOR >&) { return false; } \
+  bool ColorKernel<COLOR >::ypbprToRgb(const PiiMatrix<COLOR >&, PiiMatrix<COLOR >&) { return false; } \
+  bool ColorKernel<COLOR >::xyzToLab(const PiiMatrix<COLOR >&, const COLOR&, PiiMatrix<COLOR >&) { return false; } \
+                                                                        \
+  bool ColorKernel<COLOR >::rgbToYcbcr(const PiiMatrix<COLOR >& image, double maximum, PiiMatrix<COLOR >& result) \
+  {                                                                     \
+    return isValidMaximum(maximum) &&                                   \
+      runPixels(image, rgbToYpbprKernel(maximum/2, maximum), result);   \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::ycbcrToRgb(const PiiMatrix<COLOR >& image, double maximum, PiiMatrix<COLOR >& result) \
+  {                                                                     \
+    return isValidMaximum(maximum) &&                                   \
+      runPixels(image, ypbprToRgbKernel(maximum/2, maximum), result);   \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::rgbToHsv(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result) \
+  {                                                                     \
+    return runPixels(image, HsvKernel(), result);                       \
+  }
+
+#define PII_DEFINE_FLOAT_COLOR_KERNELS(COLOR)                           \
+  PII_DEFINE_COMMON_COLOR_KERNELS(COLOR)                                \
+  bool ColorKernel<COLOR >::rgbToYcbcr(const PiiMatrix<COLOR >&, double, PiiMatrix<COLOR >&) { return false; } \
+  bool ColorKernel<COLOR >::ycbcrToRgb(const PiiMatrix<COLOR >&, double, PiiMatrix<COLOR >&) { return false; } \
+  bool ColorKernel<COLOR >::rgbToHsv(const PiiMatrix<COLOR >&, PiiMatrix<COLOR >&) { return false; } \
+                                                                        \
+  bool ColorKernel<COLOR >::rgbToYpbpr(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result) \
+  {                                                                     \
+    return runPixels(image, rgbToYpbprKernel(), result);                \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::ypbprToRgb(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result) \
+  {                                                                     \
+    return runPixels(image, ypbprToRgbKernel(), result);                \
+  }                                                                     \
+                                                                        \
+  bool ColorKernel<COLOR >::xyzToLab(const PiiMatrix<COLOR >& image, const COLOR& whitePoint, \
+                                     PiiMatrix<COLOR >& result)         \
+  {                                                                     \
+    return xyzToLabImpl(image, whitePoint, result);                     \
+  }
+
+  PII_DEFINE_INTEGER_COLOR_KERNELS(PiiColor<unsigned char>)
+  PII_DEFINE_INTEGER_COLOR_KERNELS(PiiColor4<unsigned char>)
+  PII_DEFINE_FLOAT_COLOR_KERNELS(PiiColor<float>)
+  PII_DEFINE_FLOAT_COLOR_KERNELS(PiiColor4<float>)
+
+#undef PII_DEFINE_FLOAT_COLOR_KERNELS
+#undef PII_DEFINE_INTEGER_COLOR_KERNELS
+#undef PII_DEFINE_COMMON_COLOR_KERNELS
+}
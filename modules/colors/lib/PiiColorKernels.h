@@ -0,0 +1,105 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIICOLORKERNELS_H
+#define _PIICOLORKERNELS_H
+
+#include "PiiColorsGlobal.h"
+#include <PiiColor.h>
+#include <PiiMatrix.h>
+
+namespace PiiColors
+{
+  /**
+   * Batch implementations of color conversions. Each function
+   * converts a whole image with SSE2 or NEON instructions, four
+   * pixels at a time. Interleaved pixels are transposed to separate
+   * channel vectors on load and back on store; the arithmetic in
+   * between is done in single precision.
+   *
+   * The generic template says "not supported", which makes the
+   * caller fall back to converting one color at a time.
+   * Specializations exist for PiiColor and PiiColor4 with `unsigned
+   * char` and `float` channels. Each function returns `false` if it
+   * doesn't support the color type or the CPU lacks the required
+   * instructions. In this case *result* is not modified.
+   *
+   * - genericConversion(), rgbToHsv(), normalizedRgb() and
+   * splitChannels() produce exactly what the scalar code does.
+   *
+   * - rgbToY709(), rgbToYpbpr() and ypbprToRgb() calculate in single
+   * instead of double precision. rgbToYcbcr() and ycbcrToRgb() only
+   * support integer channels; a channel that is very close to a
+   * half-way point may round to the other direction.
+   *
+   * - xyzToLab() uses a lookup table refined with a Newton step for
+   * the cube root. It is accurate to about one unit in the last
+   * place and doesn't need vector instructions.
+   *
+   * @internal
+   */
+  template <class Clr> struct ColorKernel
+  {
+    typedef typename Clr::Type T;
+
+    static bool genericConversion(const PiiMatrix<Clr>&, const PiiMatrix<float>&,
+                                  PiiMatrix<PiiColor<float> >&) { return false; }
+    static bool rgbToY709(const PiiMatrix<Clr>&, PiiMatrix<float>&) { return false; }
+    static bool rgbToYpbpr(const PiiMatrix<Clr>&, PiiMatrix<Clr>&) { return false; }
+    static bool ypbprToRgb(const PiiMatrix<Clr>&, PiiMatrix<Clr>&) { return false; }
+    static bool rgbToYcbcr(const PiiMatrix<Clr>&, double, PiiMatrix<Clr>&) { return false; }
+    static bool ycbcrToRgb(const PiiMatrix<Clr>&, double, PiiMatrix<Clr>&) { return false; }
+    static bool rgbToHsv(const PiiMatrix<Clr>&, PiiMatrix<Clr>&) { return false; }
+    static bool xyzToLab(const PiiMatrix<Clr>&, const Clr&, PiiMatrix<Clr>&) { return false; }
+    static bool normalizedRgb(const PiiMatrix<Clr>&, PiiMatrix<T>&, PiiMatrix<T>&,
+                              float, int, int) { return false; }
+    /**
+     * Copies each channel of *image* to `*channels[i]`, which will be
+     * resized to the size of *image*. Null pointers in *channels*
+     * are skipped.
+     */
+    static bool splitChannels(const PiiMatrix<Clr>&, PiiMatrix<T>**) { return false; }
+  };
+
+#define PII_DECLARE_COLOR_KERNEL(COLOR)                                 \
+  template <> struct PII_COLORS_EXPORT ColorKernel<COLOR >              \
+  {                                                                     \
+    typedef COLOR::Type T;                                              \
+    static bool genericConversion(const PiiMatrix<COLOR >& image,       \
+                                  const PiiMatrix<float>& matrix,       \
+                                  PiiMatrix<PiiColor<float> >& result); \
+    static bool rgbToY709(const PiiMatrix<COLOR >& image, PiiMatrix<float>& result); \
+    static bool rgbToYpbpr(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result); \
+    static bool ypbprToRgb(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result); \
+    static bool rgbToYcbcr(const PiiMatrix<COLOR >& image, double maximum, PiiMatrix<COLOR >& result); \
+    static bool ycbcrToRgb(const PiiMatrix<COLOR >& image, double maximum, PiiMatrix<COLOR >& result); \
+    static bool rgbToHsv(const PiiMatrix<COLOR >& image, PiiMatrix<COLOR >& result); \
+    static bool xyzToLab(const PiiMatrix<COLOR >& image, const COLOR& whitePoint, \
+                         PiiMatrix<COLOR >& result);                    \
+    static bool normalizedRgb(const PiiMatrix<COLOR >& image,           \
+                              PiiMatrix<T>& ch1, PiiMatrix<T>& ch2,     \
+                              float multiplier, int ch1Index, int ch2Index); \
+    static bool splitChannels(const PiiMatrix<COLOR >& image, PiiMatrix<T>** channels); \
+  }
+
+  PII_DECLARE_COLOR_KERNEL(PiiColor<unsigned char>);
+  PII_DECLARE_COLOR_KERNEL(PiiColor4<unsigned char>);
+  PII_DECLARE_COLOR_KERNEL(PiiColor<float>);
+  PII_DECLARE_COLOR_KERNEL(PiiColor4<float>);
+
+#undef PII_DECLARE_COLOR_KERNEL
+}
+
+#endif //_PIICOLORKERNELS_H
@@ -57,6 +57,9 @@ namespace PiiColors
                                         float multiplier,
                                         int ch1Index, int ch2Index)
   {
+    if (ColorKernel<T>::normalizedRgb(image, ch1, ch2, multiplier, ch1Index, ch2Index))
+      return;
+
     ch1Index = (2-ch1Index) & 3;
     ch2Index = (2-ch2Index) & 3;
     // Reserve space for color channels
@@ -190,6 +193,47 @@ namespace PiiColors
     return resultImg;
   }
 
+  template <class UnaryFunction>
+  PiiMatrix<typename UnaryFunction::result_type> createColorMatchTable(const PiiMatrix<double>& baseVectors,
+                                                                       const PiiMatrix<double>& center,
+                                                                       UnaryFunction func,
+                                                                       int bits)
+  {
+    const int iLevels = 1 << bits;
+    const float fStep = 256.0f / iLevels, fOffset = fStep / 2 - 0.5f;
+    // One pixel for each cell of the color cube. The cube is matched
+    // like an ordinary image to get exactly the same results.
+    PiiMatrix<PiiColor<float> > matCube(PiiMatrix<PiiColor<float> >::uninitialized(1, iLevels*iLevels*iLevels));
+    PiiColor<float>* pColor = matCube[0];
+    for (int r=0; r<iLevels; ++r)
+      for (int g=0; g<iLevels; ++g)
+        for (int b=0; b<iLevels; ++b, ++pColor)
+          *pColor = PiiColor<float>(r * fStep + fOffset,
+                                    g * fStep + fOffset,
+                                    b * fStep + fOffset);
+    return matchColors(matCube, baseVectors, center, func);
+  }
+
+  template <class ColorType, class T> PiiMatrix<T> lookupColors(const PiiMatrix<ColorType>& clrImage,
+                                                                const PiiMatrix<T>& table,
+                                                                int bits)
+  {
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(clrImage.rows(), clrImage.columns()));
+    const int iShift = 8 - bits, iRedStep = 2*bits;
+    const T* pTable = table[0];
+    const int iRows = clrImage.rows(), iCols = clrImage.columns();
+    for (int r=0; r<iRows; ++r)
+      {
+        const ColorType* pSource = clrImage[r];
+        T* pTarget = result[r];
+        for (int c=0; c<iCols; ++c)
+          pTarget[c] = pTable[(int(pSource[c].rgbR) >> iShift) << iRedStep |
+                              (int(pSource[c].rgbG) >> iShift) << bits |
+                              int(pSource[c].rgbB) >> iShift];
+      }
+    return result;
+  }
+
 
   /// @hide
   template <class T> struct UnsignedHueLimit
@@ -330,8 +374,8 @@ namespace PiiColors
 #undef PII_LAB_F
 
     return Clr(116*yPerYn - 16,
-               500*xPerXn - yPerYn,
-               200*yPerYn - zPerZn);
+               500*(xPerXn - yPerYn),
+               200*(yPerYn - zPerZn));
   }
 
   template <class Clr> Clr labToXyz(const Clr& labColor,
@@ -350,6 +394,32 @@ namespace PiiColors
 #undef PII_LAB_F
   }
 
+  template <class Clr> void splitChannels(const PiiMatrix<Clr>& image,
+                                          PiiMatrix<typename Clr::Type>** channels)
+  {
+    typedef typename Clr::Type T;
+    if (ColorKernel<Clr>::splitChannels(image, channels))
+      return;
+
+    const int iRows = image.rows(), iCols = image.columns();
+    for (int i=0; i<Clr::ChannelCount; ++i)
+      {
+        if (channels[i] == 0)
+          continue;
+        PiiMatrix<T>& matChannel = *channels[i];
+        matChannel.resize(iRows, iCols);
+        // Logical channel index to memory order
+        const int iIndex = (2-i) & 3;
+        for (int r=0; r<iRows; ++r)
+          {
+            const Clr* pSource = image[r];
+            T* pTarget = matChannel[r];
+            for (int c=0; c<iCols; ++c)
+              pTarget[c] = pSource[c].channels[iIndex];
+          }
+      }
+  }
+
   template <class Color>
   void yuv411toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height)
   {
@@ -14,6 +14,7 @@
  */
 
 #include "PiiColors.h"
+#include <cstring>
 
 namespace PiiColors
 {
@@ -28,6 +29,161 @@ namespace PiiColors
                                      0.019334, 0.119193, 0.950227);
 
 
+  namespace
+  {
+    // Windows up to this wide are counted with row-shifted
+    // comparisons. Wider ones use a sliding histogram, whose cost
+    // doesn't depend on the width.
+    const int iMaxShiftedWindow = 9;
+
+    inline bool isValidColor(int color, int levels) { return unsigned(color) < unsigned(levels); }
+
+    /* Adds to pCounts[c] the number of pixels in columns [c-halfWidth,
+     * c+halfWidth] of pOther that are equal to pCenter[c].
+     * pHistogram must have `levels` zeros, and it is left zeroed.
+     */
+    void addSegmentCounts(const int* pCenter, const int* pOther, int columns,
+                          int halfWidth, int levels, int* pHistogram, int* pCounts)
+    {
+      if (2*halfWidth + 1 <= iMaxShiftedWindow)
+        {
+          // One pass over the row for each shift. The inner loop has
+          // no branches and vectorizes.
+          for (int dx=-halfWidth; dx<=halfWidth; ++dx)
+            {
+              const int iStart = qMax(0, -dx), iEnd = qMin(columns, columns - dx);
+              for (int c=iStart; c<iEnd; ++c)
+                pCounts[c] += pCenter[c] == pOther[c + dx];
+            }
+          return;
+        }
+
+      // The histogram of the window centered at c.
+      for (int c=0; c<=qMin(halfWidth, columns-1); ++c)
+        if (isValidColor(pOther[c], levels))
+          ++pHistogram[pOther[c]];
+      for (int c=0; c<columns; ++c)
+        {
+          if (isValidColor(pCenter[c], levels))
+            pCounts[c] += pHistogram[pCenter[c]];
+          const int iOut = c - halfWidth, iIn = c + halfWidth + 1;
+          if (iOut >= 0 && isValidColor(pOther[iOut], levels))
+            --pHistogram[pOther[iOut]];
+          if (iIn < columns && isValidColor(pOther[iIn], levels))
+            ++pHistogram[pOther[iIn]];
+        }
+      for (int c=qMax(0, columns-halfWidth); c<columns; ++c)
+        if (isValidColor(pOther[c], levels))
+          --pHistogram[pOther[c]];
+    }
+
+    /* Adds to each count the number of equal pixels on the rows that
+     * are `distance` rows above and below, in a window whose half
+     * width is distance + widthDelta.
+     */
+    struct SegmentCounter
+    {
+      SegmentCounter(const PiiMatrix<int>& image, int distance, int widthDelta, int levels,
+                     PiiMatrix<int>& counts) :
+        image(image), iDistance(distance), iHalfWidth(distance + widthDelta),
+        iLevels(levels), counts(counts)
+      {}
+
+      void operator() (int firstRow, int endRow)
+      {
+        QVector<int> vecHistogram(iLevels);
+        const int iRows = image.rows(), iCols = image.columns();
+        for (int r=firstRow; r<endRow; ++r)
+          {
+            if (r - iDistance >= 0)
+              addSegmentCounts(image[r], image[r - iDistance], iCols, iHalfWidth, iLevels,
+                               vecHistogram.data(), counts[r]);
+            if (r + iDistance < iRows)
+              addSegmentCounts(image[r], image[r + iDistance], iCols, iHalfWidth, iLevels,
+                               vecHistogram.data(), counts[r]);
+          }
+      }
+
+      const PiiMatrix<int>& image;
+      int iDistance, iHalfWidth, iLevels;
+      PiiMatrix<int>& counts;
+    };
+
+    /* Calculates the correlograms of a range of rows. The counts on
+     * the left and right sides of each ring are precalculated, top
+     * and bottom are counted here. Pixels with a full ring are summed
+     * up as integers and divided once in the end.
+     */
+    struct CorrelogramStrip
+    {
+      CorrelogramStrip(const PiiMatrix<int>& image, const QList<int>& distances, int levels,
+                       const QVector<PiiMatrix<int> >& sideCounts, int strips) :
+        image(image), lstDistances(distances), iLevels(levels), vecSideCounts(sideCounts),
+        vecFullSums(strips, QVector<qint64>(levels * distances.size())),
+        vecPartialSums(strips, QVector<double>(levels * distances.size()))
+      {}
+
+      int firstRow(int strip) const
+      {
+        return int(qint64(image.rows()) * strip / vecFullSums.size());
+      }
+
+      void operator() (int firstStrip, int endStrip)
+      {
+        const int iRows = image.rows(), iCols = image.columns();
+        QVector<int> vecHistogram(iLevels), vecCounts(iCols);
+        int* pCounts = vecCounts.data();
+        for (int i = firstStrip; i < endStrip; ++i)
+          {
+            for (int d=0; d<lstDistances.size(); ++d)
+              {
+                const int iDist = lstDistances[d];
+                if (iDist < 1)
+                  continue;
+                qint64* pFullSums = vecFullSums[i].data() + d * iLevels;
+                double* pPartialSums = vecPartialSums[i].data() + d * iLevels;
+                for (int r = firstRow(i); r < firstRow(i+1); ++r)
+                  {
+                    const int* pRow = image[r];
+                    const bool bTop = r - iDist >= 0, bBottom = r + iDist < iRows;
+                    memcpy(pCounts, vecSideCounts[d][r], sizeof(int) * iCols);
+                    if (bTop)
+                      addSegmentCounts(pRow, image[r - iDist], iCols, iDist, iLevels,
+                                       vecHistogram.data(), pCounts);
+                    if (bBottom)
+                      addSegmentCounts(pRow, image[r + iDist], iCols, iDist, iLevels,
+                                       vecHistogram.data(), pCounts);
+
+                    // The number of ring pixels inside the image.
+                    const int iSideRows = qMin(r + iDist - 1, iRows - 1) - qMax(r - iDist + 1, 0) + 1;
+                    const int iRingRows = int(bTop) + int(bBottom);
+                    for (int c=0; c<iCols; ++c)
+                      {
+                        const int iCenter = pRow[c];
+                        if (!isValidColor(iCenter, iLevels))
+                          continue;
+                        const int iRingColumns = qMin(c + iDist, iCols - 1) - qMax(c - iDist, 0) + 1;
+                        const int iCount = iRingColumns * iRingRows +
+                          iSideRows * (int(c - iDist >= 0) + int(c + iDist < iCols));
+                        if (iCount == 8 * iDist)
+                          pFullSums[iCenter] += pCounts[c];
+                        else if (iCount > 0)
+                          pPartialSums[iCenter] += double(pCounts[c]) / iCount;
+                      }
+                  }
+              }
+          }
+      }
+
+      const PiiMatrix<int>& image;
+      const QList<int>& lstDistances;
+      int iLevels;
+      const QVector<PiiMatrix<int> >& vecSideCounts;
+      QVector<QVector<qint64> > vecFullSums;
+      QVector<QVector<double> > vecPartialSums;
+    };
+  }
+
   PiiMatrix<float> autocorrelogram(const PiiMatrix<int>& image,
                                    int maxDistance,
                                    int levels)
@@ -41,197 +197,61 @@ namespace PiiColors
   PiiMatrix<float> autocorrelogram(const PiiMatrix<int>& image,
                                    const QList<int>& distances,
                                    int levels)
+  {
+    return autocorrelogram(image, distances, levels, PiiParallelPolicy::sequential());
+  }
+
+  PiiMatrix<float> autocorrelogram(const PiiMatrix<int>& image,
+                                   const QList<int>& distances,
+                                   int levels,
+                                   const PiiParallelPolicy& policy)
   {
     if (levels <= 0)
-      levels = Pii::max(image) + 1;
+      levels = image.isEmpty() ? 1 : Pii::max(image) + 1;
     PiiMatrix<float> matCorrelogram(1, levels * distances.size());
-    float* pCorrelogram = matCorrelogram[0];
+    if (image.isEmpty())
+      return matCorrelogram;
 
-    const int iRows = image.rows(), iCols = image.columns();
+    /* The ring of pixels at distance d consists of two rows of 2d+1
+     * pixels (top and bottom) and two columns of 2d-1 pixels (left
+     * and right). The columns of the image are the rows of its
+     * transpose, so both are counted the same way.
+     */
+    const PiiMatrix<int> matTransposed(Pii::matrix(Pii::transpose(image)));
+    QVector<PiiMatrix<int> > vecSideCounts(distances.size());
     for (int d=0; d<distances.size(); ++d)
       {
-        const int iDist = distances[d];
-        const int iWindowSize = iDist * 8;
-        if (iRows <= iDist && iCols <= iDist)
-          continue;
-
-        const int iLastRow = iRows - iDist, iLastCol = iCols - iDist;
-
-        int r = 0;
-        // Top boundary
-        for (; r<qMin(iDist,iRows); ++r)
+        PiiMatrix<int> matCounts(matTransposed.rows(), matTransposed.columns());
+        if (distances[d] >= 1)
           {
-            int iWindowVEnd = r+iDist;
-            const int* pRow = image[r], *pRow1 = 0;
-            if (iWindowVEnd < iRows)
-              pRow1 = image[iWindowVEnd];
-            else
-              iWindowVEnd = iRows-1;
-
-            for (int c=0; c<iCols; ++c)
-              {
-                int iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c];
-                if (iCenter >= levels)
-                  continue;
-
-                int iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
-
-                // Verticals
-                if (iWindowHStart >= 0)
-                  {
-                    for (int v=0; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHStart) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd + 1;
-                  }
-                else
-                  iWindowHStart = -1;
-
-                if (iWindowHEnd < iCols)
-                  {
-                    for (int v=0; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd + 1;
-                  }
-                else
-                  iWindowHEnd = iCols;
-
-                // Horizontal
-                if (pRow1 != 0)
-                  {
-                    for (int h=iWindowHStart+1; h<iWindowHEnd; ++h)
-                      if (pRow1[h] == iCenter)
-                        ++iSum;
-                    iCnt += iWindowHEnd - iWindowHStart - 1;
-                  }
-                if (iCnt > 0)
-                  pCorrelogram[iCenter] += float(iSum) / iCnt;
-              }
+            SegmentCounter counter(matTransposed, distances[d], -1, levels, matCounts);
+            Pii::forEachStrip(matTransposed.rows(), counter, policy);
           }
+        vecSideCounts[d] = Pii::matrix(Pii::transpose(matCounts));
+      }
 
-        // Center
-        for (; r<iLastRow; ++r)
-          {
-            const int iWindowVStart = r-iDist, iWindowVEnd = r+iDist;
-            const int* pRow1 = image[iWindowVStart], *pRow = image[r], *pRow2 = image[iWindowVEnd];
-            int c = 0, iSum = 0, iCnt = 0;
-            // Left center
-            for (; c<qMin(iCols, iDist); ++c)
-              {
-                iSum = 0;
-                const int iCenter = pRow[c], iWindowHEnd = qMin(iCols-1, c+iDist);
-                if (iCenter >= levels)
-                  continue;
-                for (int h=0; h<=iWindowHEnd; ++h)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                iCnt = (iWindowHEnd+1)*2;
-                if (c+iDist < iCols)
-                  {
-                    for (int v=iWindowVStart+1; v<iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart - 1;
-                  }
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
-              }
-            // Image center
-            for (; c<iLastCol; ++c)
-              {
-                iSum = 0;
-                const int iCenter = pRow[c], iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
-                if (iCenter >= levels)
-                  continue;
-                for (int h=iWindowHStart; h<=iWindowHEnd; ++h)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                for (int v=iWindowVStart+1; v<iWindowVEnd; ++v)
-                  {
-                    if (image(v, iWindowHStart) == iCenter)
-                      ++iSum;
-                    if (image(v, iWindowHEnd) == iCenter)
-                      ++iSum;
-                  }
-                pCorrelogram[iCenter] += float(iSum) / iWindowSize;
-              }
-            // Right center
-            for (; c<iCols; ++c)
-              {
-                iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c], iWindowHStart = qMax(0, c-iDist), iWindowHEnd = iCols-1;
-                if (iCenter >= levels)
-                  continue;
-                for (int h=iWindowHStart; h<=iWindowHEnd; ++h, iCnt += 2)
-                  {
-                    if (pRow1[h] == iCenter)
-                      ++iSum;
-                    if (pRow2[h] == iCenter)
-                      ++iSum;
-                  }
-                if (c-iDist >= 0)
-                  for (int v=iWindowVStart+1; v<iWindowVEnd; ++v, ++iCnt)
-                    if (image(v, iWindowHStart) == iCenter)
-                      ++iSum;
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
-              }
-          }
+    const int iStrips = policy.stripCount(image.rows());
+    CorrelogramStrip strip(image, distances, levels, vecSideCounts, iStrips);
+    Pii::forEachStrip(iStrips, strip, PiiParallelPolicy(iStrips, 1));
 
-        // Bottom boundary
-        for (; r<iRows; ++r)
+    float* pCorrelogram = matCorrelogram[0];
+    for (int d=0; d<distances.size(); ++d, pCorrelogram += levels)
+      {
+        if (distances[d] < 1)
+          continue;
+        const double dFullRing = 8.0 * distances[d];
+        for (int l=0; l<levels; ++l)
           {
-            const int iWindowVEnd = iRows-1, iWindowVStart = r-iDist;
-            const int* pRow = image[r], *pRow1 = image[iWindowVStart];
-
-            for (int c=0; c<iCols; ++c)
+            const int i = d * levels + l;
+            qint64 iFullSum = 0;
+            double dPartialSum = 0;
+            for (int s=0; s<iStrips; ++s)
               {
-                int iSum = 0, iCnt = 0;
-                const int iCenter = pRow[c];
-                if (iCenter >= levels)
-                  continue;
-
-                int iWindowHStart = c-iDist, iWindowHEnd = c+iDist;
-
-                // Verticals
-                if (iWindowHStart >= 0)
-                  {
-                    for (int v=iWindowVStart; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHStart) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart + 1;
-                  }
-                else
-                  iWindowHStart = -1;
-
-                if (iWindowHEnd < iCols)
-                  {
-                    for (int v=iWindowVStart; v<=iWindowVEnd; ++v)
-                      if (image(v, iWindowHEnd) == iCenter)
-                        ++iSum;
-                    iCnt += iWindowVEnd - iWindowVStart + 1;
-                  }
-                else
-                  iWindowHEnd = iCols;
-
-                // Horizontal
-                for (int h=iWindowHStart+1; h<iWindowHEnd; ++h)
-                  if (pRow1[h] == iCenter)
-                    ++iSum;
-                iCnt += iWindowHEnd - iWindowHStart - 1;
-                pCorrelogram[iCenter] += float(iSum) / iCnt;
+                iFullSum += strip.vecFullSums[s][i];
+                dPartialSum += strip.vecPartialSums[s][i];
               }
+            pCorrelogram[l] = float(double(iFullSum) / dFullRing + dPartialSum);
           }
-
-        pCorrelogram += levels;
       }
     return matCorrelogram;
   }
@@ -22,10 +22,13 @@
 #include <PiiFunctional.h>
 #include <PiiImageTraits.h>
 #include <PiiTypeTraits.h>
+#include <PiiParallel.h>
 
 #include "PiiColorsGlobal.h"
+#include "PiiColorKernels.h"
 
 #include <QList>
+#include <QVector>
 
 /**
  * Functions for transforming colors.
@@ -196,6 +199,67 @@ namespace PiiColors
                                                              const PiiMatrix<double>& center,
                                                              UnaryFunction func);
 
+  /**
+   * Tabulate matchColors() over a quantized RGB cube. Each color
+   * channel is quantized to \(2^b\) levels, where *b* is `bits`, and
+   * *func* is evaluated once at the center of each cell of the cube.
+   * The value for a color (R, G, B) is stored at index \(R 2^{2b} +
+   * G 2^b + B\), where R, G and B are the quantized channel values.
+   * This is the indexing used by toIndexed() with \(2^b\) levels.
+   *
+   * Building the table costs as much as matching an image with
+   * \(2^{3b}\) pixels. Once built, lookupColors() replaces the
+   * projection and the distance function with a single table lookup
+   * per pixel. The table only needs to be rebuilt when the color
+   * model changes.
+   *
+   * @param baseVectors a 3-by-3 matrix in which rows represent a
+   * normalized base for the color system.
+   *
+   * @param center a 1-by-3 translation vector
+   *
+   * @param func an adaptable unary function that converts a squared
+   * distance to the output value.
+   *
+   * @param bits the number of bits per channel, 1-8. With the default
+   * value, the table has 32768 entries and the center of each cell is
+   * at most 3.5 intensity levels away from the colors it represents.
+   *
+   * @return a 1-by-\(2^{3b}\) matrix
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matTable = PiiColors::createColorMatchTable(matBase, matCenter,
+   *                                                              PiiColors::LikelihoodFunction());
+   * PiiMatrix<float> matLikelihood = PiiColors::lookupColors(image, matTable);
+   * ~~~
+   *
+   * @see lookupColors()
+   */
+  template <class UnaryFunction>
+  PiiMatrix<typename UnaryFunction::result_type> createColorMatchTable(const PiiMatrix<double>& baseVectors,
+                                                                       const PiiMatrix<double>& center,
+                                                                       UnaryFunction func,
+                                                                       int bits = 5);
+
+  /**
+   * Map each pixel in *clrImage* through a table created with
+   * createColorMatchTable(). The channels of the input image must be
+   * in [0, 255]. Typically, `ColorType` is PiiColor<unsigned char> or
+   * PiiColor4<unsigned char>.
+   *
+   * @param clrImage the input image
+   *
+   * @param table a 1-by-\(2^{3b}\) lookup table
+   *
+   * @param bits the number of bits per channel used when building
+   * *table*.
+   *
+   * @return an image of the same size as *clrImage*
+   */
+  template <class ColorType, class T> PiiMatrix<T> lookupColors(const PiiMatrix<ColorType>& clrImage,
+                                                                const PiiMatrix<T>& table,
+                                                                int bits = 5);
+
   /**
    * Convert a color image into indexed colors. This function
    * quantizes each color channel to the specified number of levels.
@@ -236,6 +300,12 @@ namespace PiiColors
    * Pages: 762 -768*. This implementation does not use the bogus
    * "optimization" technique reported in the paper.
    *
+   * The pixels on the sides of each ring are not compared one by
+   * one. Instead, the number of matches on each side is read from a
+   * sliding color histogram or, with small distances, calculated by
+   * comparing whole rows to shifted copies of each other. The cost
+   * per pixel is thus (almost) independent of the distance.
+   *
    * @param image an indexed color image
    *
    * @param maxDistance measure correlation between colors separated
@@ -276,6 +346,24 @@ namespace PiiColors
                                                      const QList<int>& distances,
                                                      int levels = 0);
 
+  /**
+   * Calculates the autocorrelogram in parallel. The image is divided
+   * into horizontal strips as determined by *policy*. The result can
+   * differ from that of the sequential version in the last bits due
+   * to a different summation order.
+   *
+   * ~~~(c++)
+   * QList<int> lstDistances = QList<int>() << 1 << 3 << 5 << 7;
+   * PiiMatrix<float> matCorrelogram =
+   *   PiiColors::autocorrelogram(PiiColors::toIndexed(image, 4), lstDistances, 64,
+   *                              PiiParallelPolicy());
+   * ~~~
+   */
+  PII_COLORS_EXPORT PiiMatrix<float> autocorrelogram(const PiiMatrix<int>& image,
+                                                     const QList<int>& distances,
+                                                     int levels,
+                                                     const PiiParallelPolicy& policy);
+
   /**
    * Apply gamma correction to a color channel. Gamma correction is
    * defined as \(v_o = v_i^\gamma\), where `o` and `i` stand for
@@ -397,6 +485,69 @@ namespace PiiColors
     double _gamma, _max;
   };
 
+  /// @hide
+  template <class T> struct ChannelType { typedef T Type; };
+  template <class T> struct ChannelType<PiiColor<T> > { typedef T Type; };
+  template <class T> struct ChannelType<PiiColor4<T> > { typedef T Type; };
+
+  /* Gamma correction through a table that covers all possible values
+     of an 8 or 16-bit unsigned channel. The table is implicitly
+     shared, which keeps copies of the function object cheap.
+   */
+  template <class T> class GammaTable : public Pii::UnaryFunction<T>
+  {
+  public:
+    typedef typename ChannelType<T>::Type Channel;
+    enum { Size = 1 << (8 * sizeof(Channel)) };
+
+    GammaTable(double gamma, double maximum) : _vecTable(Size)
+    {
+      Channel* pTable = _vecTable.data();
+      for (int i=0; i<Size; ++i)
+        pTable[i] = correctGamma(Channel(i), gamma, maximum);
+    }
+
+    T operator() (const T& value) const { return lookup(value); }
+
+  private:
+    Channel lookup(Channel value) const { return _vecTable[value]; }
+    PiiColor<Channel> lookup(const PiiColor<Channel>& clr) const
+    {
+      return PiiColor<Channel>(_vecTable[clr.c0], _vecTable[clr.c1], _vecTable[clr.c2]);
+    }
+    PiiColor4<Channel> lookup(const PiiColor4<Channel>& clr) const
+    {
+      return PiiColor4<Channel>(_vecTable[clr.c0], _vecTable[clr.c1], _vecTable[clr.c2], clr.c3);
+    }
+
+    QVector<Channel> _vecTable;
+  };
+
+  template <class T,
+            bool useTable = Pii::IsUnsigned<typename ChannelType<T>::Type>::boolValue &&
+                            sizeof(typename ChannelType<T>::Type) <= 2>
+  struct ScaledGammaCorrection
+  {
+    static PiiMatrix<T> apply(const PiiMatrix<T>& image, double gamma, double maximum)
+    {
+      return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
+    }
+  };
+
+  template <class T> struct ScaledGammaCorrection<T, true>
+  {
+    static PiiMatrix<T> apply(const PiiMatrix<T>& image, double gamma, double maximum)
+    {
+      // Filling the table costs about as much as correcting the same
+      // number of channel values directly.
+      if (image.rows() * image.columns() * int(sizeof(T) / sizeof(typename ChannelType<T>::Type)) <
+          int(GammaTable<T>::Size))
+        return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
+      return Pii::matrix(image.mapped(GammaTable<T>(gamma, maximum)));
+    }
+  };
+  /// @endhide
+
   /**
    * Apply gamma correction to all pixels in `image`. The function
    * works with both gray-level and color images. Color channels are
@@ -414,11 +565,15 @@ namespace PiiColors
    * works with both gray-level and color images. Color channels are
    * assumed to be in [0, `maximum`].
    *
+   * With 8 and 16-bit unsigned channels, the corrected value of each
+   * possible channel value is calculated only once, provided that
+   * the image is large enough to make this worthwhile.
+   *
    * @see correctGamma(T, double, double)
    */
   template <class T> inline PiiMatrix<T> correctGamma(const PiiMatrix<T>& image, double gamma, double maximum)
   {
-    return Pii::matrix(image.mapped(CorrectGammaScaled<T>(gamma, maximum)));
+    return ScaledGammaCorrection<T>::apply(image, gamma, maximum);
   }
 
   /**
@@ -521,6 +676,9 @@ namespace PiiColors
    */
   template <class Clr> inline PiiMatrix<Clr> rgbToHsv(const PiiMatrix<Clr>& rgbColorImage)
   {
+    PiiMatrix<Clr> matResult;
+    if (ColorKernel<Clr>::rgbToHsv(rgbColorImage, matResult))
+      return matResult;
     return Pii::matrix(rgbColorImage.mapped(RgbToHsv<Clr>()));
   }
 
@@ -616,12 +774,17 @@ namespace PiiColors
   };
 
   /**
-   * Convert an XYZ color image into an L*a*b* color image.
+   * Convert an XYZ color image into an L*a*b* color image. With
+   * `float` channels, the cube root is calculated with a lookup
+   * table.
    *
    * @see xyzToLab(Clr, Clr)
    */
   template <class Clr> inline PiiMatrix<Clr> xyzToLab(const PiiMatrix<Clr>& xyzColorImage, const Clr& whitePoint)
   {
+    PiiMatrix<Clr> matResult;
+    if (ColorKernel<Clr>::xyzToLab(xyzColorImage, whitePoint, matResult))
+      return matResult;
     return Pii::matrix(xyzColorImage.mapped(XyzToLab<Clr>(), whitePoint));
   }
 
@@ -651,7 +814,7 @@ namespace PiiColors
    *
    * @see rgbToY709(Clr)
    */
-  template <class Clr> struct RgbToY709 : Pii::BinaryFunction<Clr,float>
+  template <class Clr> struct RgbToY709 : Pii::UnaryFunction<Clr,float>
   {
     float operator() (const Clr& clr) const { return rgbToY709(clr); }
   };
@@ -662,6 +825,9 @@ namespace PiiColors
    */
   template <class Clr> inline PiiMatrix<float> rgbToY709(const PiiMatrix<Clr>& clrImage)
   {
+    PiiMatrix<float> matResult;
+    if (ColorKernel<Clr>::rgbToY709(clrImage, matResult))
+      return matResult;
     return Pii::matrix(clrImage.mapped(RgbToY709<Clr>()));
   }
 
@@ -725,6 +891,9 @@ namespace PiiColors
    */
   template <class T> inline PiiMatrix<T> rgbToYpbpr(const PiiMatrix<T>& image)
   {
+    PiiMatrix<T> matResult;
+    if (ColorKernel<T>::rgbToYpbpr(image, matResult))
+      return matResult;
     return Pii::matrix(image.mapped(RgbToYpbpr<T>()));
   }
 
@@ -742,6 +911,9 @@ namespace PiiColors
    */
   template <class T> inline PiiMatrix<T> ypbprToRgb(const PiiMatrix<T>& image)
   {
+    PiiMatrix<T> matResult;
+    if (ColorKernel<T>::ypbprToRgb(image, matResult))
+      return matResult;
     return Pii::matrix(image.mapped(YpbprToRgb<T>()));
   }
 
@@ -826,10 +998,16 @@ namespace PiiColors
 
   /**
    * Convert a color image in a non-linear RGB space into Y'CbCr.
+   * Images with `unsigned char` channels are converted in single
+   * precision, which may occasionally round a channel to the other
+   * direction than rgbToYcbcr(const Clr&, double) does.
    */
   template <class T> inline PiiMatrix<T> rgbToYcbcr(const PiiMatrix<T>& image,
                                                     double maximum = PiiImage::Traits<T>::max())
   {
+    PiiMatrix<T> matResult;
+    if (ColorKernel<T>::rgbToYcbcr(image, maximum, matResult))
+      return matResult;
     return Pii::matrix(image.mapped(RgbToYcbcr<T>(maximum)));
   }
 
@@ -852,6 +1030,9 @@ namespace PiiColors
   template <class T> inline PiiMatrix<T> ycbcrToRgb(const PiiMatrix<T>& image,
                                                     double maximum = PiiImage::Traits<T>::max())
   {
+    PiiMatrix<T> matResult;
+    if (ColorKernel<T>::ycbcrToRgb(image, maximum, matResult))
+      return matResult;
     return Pii::matrix(image.mapped(YcbcrToRgb<T>(maximum)));
   }
 
@@ -888,9 +1069,34 @@ namespace PiiColors
   template <class Clr> inline PiiMatrix<PiiColor<float> > genericConversion(const PiiMatrix<Clr>& colorImage,
                                                                             const PiiMatrix<float>& conversionMatrix)
   {
+    PiiMatrix<PiiColor<float> > matResult;
+    if (ColorKernel<Clr>::genericConversion(colorImage, conversionMatrix, matResult))
+      return matResult;
     return Pii::matrix(colorImage.mapped(std::bind1st(GenericConversion<Clr>(), conversionMatrix)));
   }
 
+  /**
+   * Splits a color image into separate channel images (planar
+   * format). Each of *channels* will be resized to the size of
+   * *image*. Null pointers in *channels* are skipped, which saves the
+   * work of extracting channels that are not needed.
+   *
+   * @param image the color image to split
+   *
+   * @param channels an array of `Clr::ChannelCount` pointers to
+   * channel images. The first pointer receives `c0` (red), the
+   * second one `c1` and so on.
+   *
+   * ~~~(c++)
+   * PiiMatrix<PiiColor4<> > clrImage;
+   * PiiMatrix<unsigned char> matRed, matBlue;
+   * PiiMatrix<unsigned char>* channels[] = { &matRed, 0, &matBlue, 0 };
+   * PiiColors::splitChannels(clrImage, channels);
+   * ~~~
+   */
+  template <class Clr> void splitChannels(const PiiMatrix<Clr>& image,
+                                          PiiMatrix<typename Clr::Type>** channels);
+
   template <class Color>
   void yuv411toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height);
   template <class Color>
@@ -15,7 +15,7 @@
 
 #include "PiiColorChannelSplitter.h"
 #include <PiiYdinTypes.h>
-#include <PiiColor.h>
+#include <PiiColors.h>
 
 using namespace Pii;
 using namespace PiiYdin;
@@ -71,32 +71,16 @@ template <class Color, int channels> void PiiColorChannelSplitter::splitChannels
   typedef typename Color::Type T;
   const PiiMatrix<Color> image = obj.valueAs<PiiMatrix<Color> >();
   PiiMatrix<T> channelImages[channels];
+  PiiMatrix<T>* apChannels[4] = { 0, 0, 0, 0 };
 
+  // Don't waste time on channels nobody listens to.
   for (int i=0; i<channels; ++i)
-    channelImages[i] = PiiMatrix<T>(PiiMatrix<T>::uninitialized(image.rows(), image.columns()));
+    if (outputAt(i)->isConnected())
+      apChannels[i] = &channelImages[i];
 
-  const int iRows = image.rows(), iCols = image.columns();
-  for (int r=0; r<iRows; ++r)
-    {
-      const Color* row = image.row(r);
-      T *row0 = channelImages[0][r],
-        *row1 = channelImages[1][r],
-        *row2 = channelImages[2][r],
-        *row3;
-
-      if (channels == 4)
-        row3 = channelImages[3][r];
-
-      for (int c=0; c<iCols; ++c)
-        {
-          row0[c] = row[c].c0;
-          row1[c] = row[c].c1;
-          row2[c] = row[c].c2;
-          if (channels == 4)
-            row3[c] = row[c].channels[3];
-        }
-    }
+  PiiColors::splitChannels(image, apChannels);
 
   for (int i=0; i<channels; ++i)
-    outputAt(i)->emitObject(channelImages[i]);
+    if (apChannels[i] != 0)
+      outputAt(i)->emitObject(channelImages[i]);
 }
@@ -82,7 +82,8 @@ template <class Clr> void PiiColorCorrelogramOperation::processColor(const PiiVa
     {
       d->pOutput->emitObject(PiiColors::autocorrelogram(PiiColors::toIndexed(img, d->iLevels),
                                                         d->lstDistances,
-                                                        d->iLevels*d->iLevels*d->iLevels));
+                                                        d->iLevels*d->iLevels*d->iLevels,
+                                                        PiiParallelPolicy()));
     }
   else
     {
@@ -98,9 +99,10 @@ template <class Clr> void PiiColorCorrelogramOperation::processColor(const PiiVa
               d->iLevels * pSource[c].rgbG +
               pSource[c].rgbB;
         }
-      d->pOutput->emitObject(PiiColors::autocorrelogram(img,
+      d->pOutput->emitObject(PiiColors::autocorrelogram(matIndexed,
                                                         d->lstDistances,
-                                                        d->iLevels*d->iLevels*d->iLevels));
+                                                        d->iLevels*d->iLevels*d->iLevels,
+                                                        PiiParallelPolicy()));
     }
 }
 
@@ -115,12 +117,14 @@ template <class T> void PiiColorCorrelogramOperation::processGray(const PiiVaria
       d->pOutput->emitObject(PiiColors::autocorrelogram(Pii::matrix(img.mapped(Pii::unaryCompose(Pii::Round<T>(),
                                                                                                  std::bind2nd(std::multiplies<double>(), dScale)))),
                                                         d->lstDistances,
-                                                        d->iLevels));
+                                                        d->iLevels,
+                                                        PiiParallelPolicy()));
     }
   else
     {
-      d->pOutput->emitObject(PiiColors::autocorrelogram(img,
+      d->pOutput->emitObject(PiiColors::autocorrelogram(PiiMatrix<int>(img),
                                                         d->lstDistances,
-                                                        d->iLevels));
+                                                        d->iLevels,
+                                                        PiiParallelPolicy()));
     }
 }
@@ -20,7 +20,9 @@
 #include "PiiColors.h"
 
 PiiColorModelMatcher::Data::Data() :
-  matBaseVectors(3,3), matCenter(1,3), dMatchingThreshold(0)
+  matBaseVectors(3,3), matCenter(1,3), dMatchingThreshold(0),
+  iLookupBits(5),
+  bTableValid(false)
 {
 }
 
@@ -31,6 +33,19 @@ PiiColorModelMatcher::PiiColorModelMatcher() :
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiInputSocket("model"));
   addSocket(new PiiOutputSocket("image"));
+
+  setProtectionLevel("lookupBits", WriteWhenStopped);
+}
+
+void PiiColorModelMatcher::check(bool reset)
+{
+  PII_D;
+  if (d->iLookupBits < 0 || d->iLookupBits > 8)
+    PII_THROW(PiiExecutionException, tr("The number of lookup bits must be between 0 and 8."));
+
+  PiiDefaultOperation::check(reset);
+
+  d->bTableValid = false;
 }
 
 void PiiColorModelMatcher::process()
@@ -62,20 +77,75 @@ template <class T> void PiiColorModelMatcher::calculateModel(const PiiVariant& o
 }
 
 template <class T> void PiiColorModelMatcher::matchImageToModel(const PiiVariant& obj)
+{
+  matchImageToModel(obj.valueAs<PiiMatrix<T> >(),
+                    Pii::IsSame<typename PiiColors::ChannelType<T>::Type, unsigned char>());
+}
+
+void PiiColorModelMatcher::updateTable()
 {
   PII_D;
+  // The model is usually derived from the same image over and over
+  // again. Rebuild the table only if the model actually changes.
+  if (d->bTableValid &&
+      Pii::equals(d->matBaseVectors, d->matTableBaseVectors) &&
+      Pii::equals(d->matCenter, d->matTableCenter))
+    return;
+
   if (d->dMatchingThreshold > 0)
-    emitObject(PiiColors::matchColors(obj.valueAs<PiiMatrix<T> >(),
+    d->matThresholdTable = PiiColors::createColorMatchTable(d->matBaseVectors,
+                                                            d->matCenter,
+                                                            std::bind2nd(PiiImage::InverseThresholdFunction<float,unsigned char>(),
+                                                                         d->dMatchingThreshold),
+                                                            d->iLookupBits);
+  else
+    d->matLikelihoodTable = PiiColors::createColorMatchTable(d->matBaseVectors,
+                                                             d->matCenter,
+                                                             PiiColors::LikelihoodFunction(),
+                                                             d->iLookupBits);
+  d->matTableBaseVectors = d->matBaseVectors;
+  d->matTableCenter = d->matCenter;
+  d->bTableValid = true;
+}
+
+template <class T> void PiiColorModelMatcher::matchImageToModel(const PiiMatrix<T>& image, Pii::True)
+{
+  PII_D;
+  if (d->iLookupBits == 0)
+    {
+      matchImageToModel(image, Pii::False());
+      return;
+    }
+
+  updateTable();
+  if (d->dMatchingThreshold > 0)
+    emitObject(PiiColors::lookupColors(image, d->matThresholdTable, d->iLookupBits));
+  else
+    emitObject(PiiColors::lookupColors(image, d->matLikelihoodTable, d->iLookupBits));
+}
+
+template <class T> void PiiColorModelMatcher::matchImageToModel(const PiiMatrix<T>& image, Pii::False)
+{
+  PII_D;
+  if (d->dMatchingThreshold > 0)
+    emitObject(PiiColors::matchColors(image,
                                                       d->matBaseVectors,
                                                       d->matCenter,
                                                       std::bind2nd(PiiImage::InverseThresholdFunction<float,unsigned char>(),
                                                                    d->dMatchingThreshold)));
   else
-    emitObject(PiiColors::matchColors(obj.valueAs<PiiMatrix<T> >(),
+    emitObject(PiiColors::matchColors(image,
                                                       d->matBaseVectors,
                                                       d->matCenter,
                                                       PiiColors::LikelihoodFunction()));
 }
 
-void PiiColorModelMatcher::setMatchingThreshold(double matchingThreshold) { _d()->dMatchingThreshold = matchingThreshold; }
+void PiiColorModelMatcher::setMatchingThreshold(double matchingThreshold)
+{
+  PII_D;
+  d->dMatchingThreshold = matchingThreshold;
+  d->bTableValid = false;
+}
 double PiiColorModelMatcher::matchingThreshold() const { return _d()->dMatchingThreshold; }
+void PiiColorModelMatcher::setLookupBits(int lookupBits) { _d()->iLookupBits = lookupBits; }
+int PiiColorModelMatcher::lookupBits() const { return _d()->iLookupBits; }
@@ -40,6 +40,23 @@
  * thresholded image (PiiMatrix<unsigned char>), if [matchingThreshold]
  * is non-zero.
  *
+ * Lookup tables
+ * -------------
+ *
+ * With 8-bit color images, the operation doesn't project each pixel
+ * to the color model separately. Instead, it tabulates the match
+ * results for all colors in a quantized RGB cube (see
+ * PiiColors::createColorMatchTable()) and converts each pixel with a
+ * single table lookup. The table is rebuilt only if the model or
+ * [matchingThreshold] changes. The accuracy of the table is
+ * controlled by [lookupBits]. Images with other channel types are
+ * always matched pixel by pixel.
+ *
+ * The table is indexed like PiiColors::toIndexed(). Thus, a table
+ * built with PiiColors::createColorMatchTable() can also be used as
+ * a one-dimensional model in PiiHistogramBackProjector, if the input
+ * image is first quantized to \(2^b\) levels per channel.
+ *
  */
 class PiiColorModelMatcher : public PiiDefaultOperation
 {
@@ -49,12 +66,25 @@ class PiiColorModelMatcher : public PiiDefaultOperation
    */
   Q_PROPERTY(double matchingThreshold READ matchingThreshold WRITE setMatchingThreshold);
 
+  /**
+   * The number of bits per color channel in the lookup table used
+   * with 8-bit color images. Valid values are 1-8. The table has
+   * \(2^{3b}\) entries, where *b* is the number of bits. The default
+   * value is 5, which results in a table of 32768 entries. 0 disables
+   * the table, and each pixel is matched separately.
+   */
+  Q_PROPERTY(int lookupBits READ lookupBits WRITE setLookupBits);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiColorModelMatcher();
 
   void setMatchingThreshold(double matchingThreshold);
   double matchingThreshold() const;
+  void setLookupBits(int lookupBits);
+  int lookupBits() const;
+
+  void check(bool reset);
 
 protected:
   void process();
@@ -62,6 +92,9 @@ protected:
 private:
   template <class T> void calculateModel(const PiiVariant& obj);
   template <class T> void matchImageToModel(const PiiVariant& obj);
+  template <class T> void matchImageToModel(const PiiMatrix<T>& image, Pii::True);
+  template <class T> void matchImageToModel(const PiiMatrix<T>& image, Pii::False);
+  void updateTable();
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -70,6 +103,11 @@ private:
     Data();
     PiiMatrix<double> matBaseVectors, matCenter;
     double dMatchingThreshold;
+    int iLookupBits;
+    bool bTableValid;
+    PiiMatrix<double> matTableBaseVectors, matTableCenter;
+    PiiMatrix<float> matLikelihoodTable;
+    PiiMatrix<unsigned char> matThresholdTable;
   };
   PII_D_FUNC;
 };
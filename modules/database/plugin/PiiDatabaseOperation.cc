@@ -225,6 +225,26 @@ bool PiiDatabaseOperation::exec(QSqlQuery& query)
   return checkQuery(query);
 }
 
+bool PiiDatabaseOperation::execBatch(QSqlQuery& query)
+{
+  if (query.execBatch())
+    return true;
+
+  if (query.lastError().type() == QSqlError::ConnectionError)
+    {
+      PII_D;
+      int i = d->iRetryCount;
+      while (i-- > 0 && state() == Running)
+        {
+          PiiDelay::msleep(d->iRetryDelay);
+          if (query.execBatch())
+            return true;
+        }
+    }
+
+  return checkQuery(query);
+}
+
 void PiiDatabaseOperation::setDatabaseUri(const QString& databaseUri) { _d()->strDatabaseUri = databaseUri; }
 void PiiDatabaseOperation::setDatabaseName(const QString& databaseName) { _d()->strDatabaseName = databaseName; }
 void PiiDatabaseOperation::setIgnoreErrors(bool ignoreErrors) { _d()->bIgnoreErrors = ignoreErrors; }
@@ -215,6 +215,12 @@ protected:
    * error, retries [retryCount] times.
    */
   bool exec(QSqlQuery& query);
+  /**
+   * Executes *query* in batch mode using the value lists bound to
+   * it. See QSqlQuery::execBatch(). Failed queries are retried like
+   * in [exec()].
+   */
+  bool execBatch(QSqlQuery& query);
   /**
    * Checks an executed *query* for errors. Returns `true` if the
    * query was successfully executed, `false` otherwise. Throws a
@@ -17,8 +17,12 @@
 
 #include "PiiDatabaseWriter.h"
 #include "PiiDatabaseReader.h"
+#include "PiiResultLogWriter.h"
+#include "PiiResultLogReader.h"
 
 PII_IMPLEMENT_PLUGIN(PiiDatabasePlugin);
 
 PII_REGISTER_OPERATION(PiiDatabaseWriter);
 PII_REGISTER_OPERATION(PiiDatabaseReader);
+PII_REGISTER_OPERATION(PiiResultLogWriter);
+PII_REGISTER_OPERATION(PiiResultLogReader);
@@ -16,14 +16,56 @@
 #include "PiiDatabaseReader.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
 
 #include <QSqlQuery>
 #include <QSqlDriver>
+#include <QSqlRecord>
+#include <QSqlField>
 #include <QFile>
 
+namespace
+{
+  int columnType(QVariant::Type type)
+  {
+    switch (type)
+      {
+      case QVariant::Bool:
+      case QVariant::Int:
+      case QVariant::UInt:
+        return PiiVariant::IntType;
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+        return PiiVariant::Int64Type;
+      case QVariant::Double:
+        return PiiVariant::DoubleType;
+      default:
+        return PiiYdin::QStringType;
+      }
+  }
+
+  template <class T> PiiMatrix<T> columnMatrix(const QList<QVector<PiiVariant> >& rows, int column)
+  {
+    PiiMatrix<T> matValues(PiiMatrix<T>::uninitialized(rows.size(), 1));
+    for (int r=0; r<rows.size(); ++r)
+      matValues(r,0) = rows[r][column].valueAs<T>();
+    return matValues;
+  }
+}
+
 PiiDatabaseReader::Data::Data() :
   pQuery(0),
-  pFile(0)
+  pFile(0),
+  bSourceOpen(false),
+  bCursor(false),
+  iFetchedRows(0),
+  iFetchSize(1000),
+  iPrefetchSize(0),
+  iBlockSize(1),
+  pPrefetchThread(0),
+  bPrefetchRunning(false),
+  bPrefetchDone(false)
 {
 }
 
@@ -37,16 +79,114 @@ PiiDatabaseReader::PiiDatabaseReader() : PiiDatabaseOperation(new Data)
 {
   setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
   setProtectionLevel("defaultValues", WriteWhenStoppedOrPaused);
+  setProtectionLevel("fetchSize", WriteWhenStopped);
+  setProtectionLevel("prefetchSize", WriteWhenStopped);
+}
+
+PiiDatabaseReader::~PiiDatabaseReader()
+{
+  stopPrefetcher();
+  closeSource();
+  closeConnection();
 }
 
 void PiiDatabaseReader::aboutToChangeState(State state)
 {
-  PII_D;
   if (state == Stopped)
-    delete d->pFile, d->pFile = 0;
+    {
+      stopPrefetcher();
+      closeSource();
+    }
   PiiDatabaseOperation::aboutToChangeState(state);
 }
 
+void PiiDatabaseReader::check(bool reset)
+{
+  PII_D;
+  PiiDatabaseOperation::check(reset);
+
+  if (reset)
+    d->strPrefetchError.clear();
+
+  if (d->iPrefetchSize > 0 && d->pPrefetchThread == 0)
+    {
+      d->bPrefetchRunning = true;
+      d->bPrefetchDone = false;
+      d->pPrefetchThread = Pii::createAsyncCall(this, &PiiDatabaseReader::prefetchRows);
+      d->pPrefetchThread->start();
+    }
+}
+
+void PiiDatabaseReader::stopPrefetcher()
+{
+  PII_D;
+  if (d->pPrefetchThread == 0)
+    return;
+  synchronized (d->prefetchMutex)
+    {
+      d->bPrefetchRunning = false;
+      d->spaceAvailable.wakeAll();
+    }
+  // The thread exits once the rows being read have been received
+  // from the database.
+  d->pPrefetchThread->wait();
+  delete d->pPrefetchThread;
+  d->pPrefetchThread = 0;
+  d->lstRows.clear();
+}
+
+void PiiDatabaseReader::prefetchRows()
+{
+  PII_D;
+  QString strError;
+  // Never read more rows at once than fit into the buffer.
+  const int iChunkSize = qBound(1, d->iFetchSize, d->iPrefetchSize);
+  try
+    {
+      openSource();
+      bool bMore = true;
+      while (bMore)
+        {
+          // Read without holding the lock so that the processing
+          // thread can consume rows in the meantime.
+          QList<Row> lstChunk;
+          Row row(d->lstColumnNames.size());
+          for (int i=0; i<iChunkSize; ++i)
+            {
+              if (!readRow(row))
+                {
+                  bMore = false;
+                  break;
+                }
+              lstChunk << row;
+            }
+
+          QMutexLocker lock(&d->prefetchMutex);
+          while (d->bPrefetchRunning && d->lstRows.size() + lstChunk.size() > d->iPrefetchSize)
+            d->spaceAvailable.wait(&d->prefetchMutex);
+          if (!d->bPrefetchRunning)
+            break;
+          d->lstRows << lstChunk;
+          d->rowsAvailable.wakeOne();
+        }
+    }
+  catch (PiiExecutionException& ex)
+    {
+      strError = ex.message();
+    }
+
+  // The connection was opened in this thread and must be closed here.
+  closeSource();
+  closeConnection();
+
+  synchronized (d->prefetchMutex)
+    {
+      d->strPrefetchError = strError;
+      d->bPrefetchDone = true;
+      d->rowsAvailable.wakeAll();
+    }
+}
+
 PiiOutputSocket* PiiDatabaseReader::output(const QString& name) const
 {
   const PII_D;
@@ -82,7 +222,6 @@ QSqlDatabase* PiiDatabaseReader::createDatabase(const QString& driver,
 void PiiDatabaseReader::createQuery()
 {
   PII_D;
-  // PENDING
   QSqlDriver* pDriver = db()->driver();
   QString strQuery("SELECT ");
   for (int i=0; i<d->lstColumnNames.size(); ++i)
@@ -93,18 +232,108 @@ void PiiDatabaseReader::createQuery()
     }
   strQuery.append(" FROM ");
   strQuery.append(pDriver->escapeIdentifier(d->strTableName, QSqlDriver::TableName));
+
   d->pQuery = new QSqlQuery(*db());
+  // Rows that have been read are not needed again. This lets the
+  // drivers release them and stream the rest of the result.
+  d->pQuery->setForwardOnly(true);
+
+  // The PostgreSQL driver receives the whole result before returning
+  // the first row. A server-side cursor limits the number of rows
+  // transferred at once. Cursors only live within a transaction.
+  d->bCursor = d->iFetchSize > 0 && db()->driverName() == "QPSQL" && db()->transaction();
+  if (d->bCursor)
+    {
+      QString strCursor(d->strConnectionId + "_reader");
+      QSqlQuery declareQuery(*db());
+      declareQuery.prepare(QString("DECLARE %1 NO SCROLL CURSOR FOR %2").arg(strCursor, strQuery));
+      if (!exec(declareQuery))
+        return;
+      strQuery = QString("FETCH FORWARD %1 FROM %2").arg(d->iFetchSize).arg(strCursor);
+    }
+
   d->pQuery->prepare(strQuery);
+  d->iFetchedRows = 0;
+  if (!exec(*d->pQuery))
+    return;
+
+  QSqlRecord record(d->pQuery->record());
+  for (int i=0; i<record.count() && i<d->vecColumnTypes.size(); ++i)
+    d->vecColumnTypes[i] = columnType(record.field(i).type());
 }
 
-void PiiDatabaseReader::process()
+void PiiDatabaseReader::openSource()
+{
+  PII_D;
+  closeSource();
+  d->bSourceOpen = true;
+  // CSV fields are text unless a default value says otherwise.
+  d->vecColumnTypes.fill(PiiYdin::QStringType, d->lstColumnNames.size());
+  if (openConnection())
+    createQuery();
+  for (int i=0; i<d->vecColumnTypes.size(); ++i)
+    if (d->vecDefaultValues[i].isValid())
+      d->vecColumnTypes[i] = d->vecDefaultValues[i].type();
+}
+
+void PiiDatabaseReader::closeSource()
+{
+  PII_D;
+  delete d->pQuery, d->pQuery = 0;
+  delete d->pFile, d->pFile = 0;
+  // Nothing was changed. Ending the transaction also closes the
+  // cursor.
+  if (d->bCursor && isConnected())
+    db()->rollback();
+  d->bCursor = false;
+  d->bSourceOpen = false;
+}
+
+bool PiiDatabaseReader::fetchMore()
+{
+  PII_D;
+  // A chunk smaller than fetchSize means the cursor is at the end.
+  if (!d->bCursor || d->iFetchedRows < d->iFetchSize)
+    return false;
+  d->iFetchedRows = 0;
+  return exec(*d->pQuery);
+}
+
+PiiVariant PiiDatabaseReader::convert(const QVariant& value, int column)
 {
   PII_D;
-  if (!isConnected() && d->pFile == 0)
+  if (value.isNull())
     {
-      delete d->pQuery, d->pQuery = 0;
-      if (openConnection())
-        createQuery();
+      if (d->vecDefaultValues[column].isValid())
+        return d->vecDefaultValues[column];
+      error(tr("Column \"%1\" contains a NULL value but has no default value.")
+            .arg(d->lstColumnNames[column]));
+    }
+  switch (d->vecColumnTypes[column])
+    {
+    case PiiVariant::IntType:
+      return PiiVariant(value.toInt());
+    case PiiVariant::Int64Type:
+      return PiiVariant(value.toLongLong());
+    case PiiVariant::DoubleType:
+      return PiiVariant(value.toDouble());
+    default:
+      return PiiVariant(value.toString());
+    }
+}
+
+bool PiiDatabaseReader::readRow(Row& row)
+{
+  PII_D;
+  if (d->pQuery != 0)
+    {
+      while (!d->pQuery->next())
+        if (!checkQuery(*d->pQuery) || !fetchMore())
+          return false;
+      ++d->iFetchedRows;
+      for (int i=0; i<row.size(); ++i)
+        row[i] = convert(d->pQuery->value(i), i);
+      return true;
     }
   else if (d->pFile != 0)
     {
@@ -114,7 +343,7 @@ void PiiDatabaseReader::process()
       if (!strLine.isEmpty() && strLine[strLine.size()-1] == '\r')
         strLine.chop(1);
       if (strLine.isEmpty())
-        operationStopped(); // throws
+        return false;
       QStringList lstParts = Pii::splitQuoted(strLine, QChar(';'));
       if (lstParts.size() != d->lstColumnNames.size())
         PII_THROW(PiiExecutionException,
@@ -123,23 +352,103 @@ void PiiDatabaseReader::process()
                   .arg(d->lstColumnNames.size()));
       for (int i=0; i<lstParts.size(); ++i)
         {
-          QString strPart(lstParts[i]);
-          switch (d->vecDefaultValues[i].type())
-            {
-            case PiiVariant::IntType:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toInt()), i);
-              break;
-            case PiiVariant::DoubleType:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart.toDouble()), i);
-              break;
-            default:
-              emitObject(strPart.isEmpty() ? d->vecDefaultValues[i] : PiiVariant(strPart), i);
-              break;
-            }
+          if (lstParts[i].isEmpty() && d->vecDefaultValues[i].isValid())
+            row[i] = d->vecDefaultValues[i];
+          else
+            row[i] = convert(lstParts[i], i);
+        }
+      return true;
+    }
+  return false;
+}
+
+bool PiiDatabaseReader::takeRows(int count, QList<Row>& rows)
+{
+  PII_D;
+  if (d->pPrefetchThread == 0)
+    {
+      if (!d->bSourceOpen)
+        openSource();
+      Row row(d->lstColumnNames.size());
+      while (rows.size() < count && readRow(row))
+        rows << row;
+      return !rows.isEmpty();
+    }
+
+  QMutexLocker lock(&d->prefetchMutex);
+  while (rows.size() < count)
+    {
+      // Don't block a pause or a stop request if the database is
+      // slow.
+      while (d->lstRows.isEmpty() && !d->bPrefetchDone && state() == Running)
+        d->rowsAvailable.wait(&d->prefetchMutex, 100);
+      if (d->lstRows.isEmpty())
+        break;
+      const int iCount = qMin(count - rows.size(), d->lstRows.size());
+      rows << d->lstRows.mid(0, iCount);
+      d->lstRows.erase(d->lstRows.begin(), d->lstRows.begin() + iCount);
+      d->spaceAvailable.wakeOne();
+    }
+  if (!rows.isEmpty() || !d->bPrefetchDone)
+    return true;
+
+  // All rows read before a possible error have been emitted.
+  if (!d->strPrefetchError.isEmpty())
+    {
+      QString strError(d->strPrefetchError);
+      d->strPrefetchError.clear();
+      PII_THROW(PiiExecutionException, strError);
+    }
+  return false;
+}
+
+void PiiDatabaseReader::emitBlock(const QList<Row>& rows)
+{
+  PII_D;
+  for (int i=0; i<d->vecColumnTypes.size(); ++i)
+    {
+      switch (d->vecColumnTypes[i])
+        {
+        case PiiVariant::IntType:
+          emitObject(columnMatrix<int>(rows, i), i);
+          break;
+        case PiiVariant::Int64Type:
+          emitObject(columnMatrix<qint64>(rows, i), i);
+          break;
+        case PiiVariant::DoubleType:
+          emitObject(columnMatrix<double>(rows, i), i);
+          break;
+        default:
+          {
+            QStringList lstValues;
+            for (int r=0; r<rows.size(); ++r)
+              lstValues << rows[r][i].valueAs<QString>();
+            emitObject(lstValues, i);
+          }
         }
     }
 }
 
+void PiiDatabaseReader::process()
+{
+  PII_D;
+  QList<Row> lstRows;
+  if (!takeRows(qMax(1, d->iBlockSize), lstRows))
+    operationStopped(); // throws
+  // Interrupted while waiting for the prefetch thread.
+  if (lstRows.isEmpty())
+    return;
+
+  if (d->iBlockSize > 1)
+    emitBlock(lstRows);
+  else
+    {
+      const Row& row = lstRows[0];
+      for (int i=0; i<row.size(); ++i)
+        emitObject(row[i], i);
+    }
+}
+
 void PiiDatabaseReader::setColumnNames(const QStringList& columnNames)
 {
   PII_D;
@@ -177,6 +486,9 @@ void PiiDatabaseReader::initializeDefaults()
         case QVariant::Int:
           d->vecDefaultValues[i] = PiiVariant(varDefault.toInt());
           break;
+        case QVariant::LongLong:
+          d->vecDefaultValues[i] = PiiVariant(varDefault.toLongLong());
+          break;
         case QVariant::Double:
           d->vecDefaultValues[i] = PiiVariant(varDefault.toDouble());
           break;
@@ -187,3 +499,12 @@ void PiiDatabaseReader::initializeDefaults()
 }
 
 QVariantMap PiiDatabaseReader::defaultValues() const { return _d()->mapDefaultValues; }
+
+void PiiDatabaseReader::setFetchSize(int fetchSize) { _d()->iFetchSize = qMax(0, fetchSize); }
+int PiiDatabaseReader::fetchSize() const { return _d()->iFetchSize; }
+
+void PiiDatabaseReader::setPrefetchSize(int prefetchSize) { _d()->iPrefetchSize = qMax(0, prefetchSize); }
+int PiiDatabaseReader::prefetchSize() const { return _d()->iPrefetchSize; }
+
+void PiiDatabaseReader::setBlockSize(int blockSize) { _d()->iBlockSize = qMax(1, blockSize); }
+int PiiDatabaseReader::blockSize() const { return _d()->iBlockSize; }
@@ -18,17 +18,26 @@
 
 #include "PiiDatabaseOperation.h"
 #include <QSqlDatabase>
+#include <QMutex>
+#include <QWaitCondition>
 
 class QFile;
 class QSqlQuery;
+class QThread;
 
 /**
- * PiiDatabaseReader description
+ * An operation that reads rows from a database table and emits the
+ * values of each row through its outputs. Once all rows have been
+ * read, the operation stops.
  *
- * Inputs
- * ------
+ * Query results are read through a forward-only cursor, which lets
+ * the drivers stream the result instead of buffering all of it in
+ * client memory. Database round trips can be moved out of the
+ * processing thread with [prefetchSize], and a whole block of rows
+ * can be emitted at once with [blockSize].
  *
- * @in name - Description
+ * This operation adds "csv" as a supported connection scheme. See
+ * PiiDatabaseOperation::databaseName for examples.
  *
  * Outputs
  * -------
@@ -80,9 +89,45 @@ class PiiDatabaseReader : public PiiDatabaseOperation
    */
   Q_PROPERTY(QVariantMap defaultValues READ defaultValues WRITE setDefaultValues);
 
+  /**
+   * The number of rows transferred from the database at once. With
+   * PostgreSQL, a value larger than zero makes the query run through
+   * a server-side cursor, and rows are fetched in chunks of this
+   * size. With other drivers, the forward-only result is streamed by
+   * the driver, and this value only controls how many rows the
+   * prefetch thread reads before handing them over. The default
+   * value is 1000.
+   */
+  Q_PROPERTY(int fetchSize READ fetchSize WRITE setFetchSize);
+
+  /**
+   * The maximum number of rows read in advance. If this value is
+   * larger than zero, rows are read by a separate thread that owns
+   * the database connection, and database latency never delays
+   * processing. The thread waits if the buffer is full. Database
+   * errors are reported once the rows read before the error have
+   * been emitted. The default value is 0, which means that rows are
+   * read in the processing thread.
+   */
+  Q_PROPERTY(int prefetchSize READ prefetchSize WRITE setPrefetchSize);
+
+  /**
+   * The number of rows emitted at once. If this value is larger than
+   * one, each output emits an N-by-1 matrix (or a QStringList for
+   * text columns) that contains the values of the column in N
+   * consecutive rows. N equals `blockSize` except in the last block,
+   * which may be smaller. Integer columns are emitted as
+   * PiiMatrix<int> and decimal columns as PiiMatrix<double>. The
+   * default value is 1.
+   */
+  Q_PROPERTY(int blockSize READ blockSize WRITE setBlockSize);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiDatabaseReader();
+  ~PiiDatabaseReader();
+
+  void check(bool reset);
 
 protected:
   void process();
@@ -106,7 +151,18 @@ protected:
   QVariantMap defaultValues() const;
   void setDefaultValues(const QVariantMap& defaultValues);
 
+  void setFetchSize(int fetchSize);
+  int fetchSize() const;
+
+  void setPrefetchSize(int prefetchSize);
+  int prefetchSize() const;
+
+  void setBlockSize(int blockSize);
+  int blockSize() const;
+
 private:
+  typedef QVector<PiiVariant> Row;
+
   /// @internal
   class Data : public PiiDatabaseOperation::Data
   {
@@ -120,11 +176,33 @@ private:
     QSqlQuery *pQuery;
     QFile *pFile;
     QVector<PiiVariant> vecDefaultValues;
+    // The type of each column, fixed when the source is opened.
+    QVector<int> vecColumnTypes;
+    bool bSourceOpen, bCursor;
+    int iFetchedRows;
+
+    int iFetchSize, iPrefetchSize, iBlockSize;
+    // Rows read by the prefetch thread but not emitted yet.
+    QList<Row> lstRows;
+    QThread* pPrefetchThread;
+    bool bPrefetchRunning, bPrefetchDone;
+    QMutex prefetchMutex;
+    QWaitCondition rowsAvailable, spaceAvailable;
+    QString strPrefetchError;
   };
   PII_D_FUNC;
 
   void initializeDefaults();
   void createQuery();
+  void openSource();
+  void closeSource();
+  bool fetchMore();
+  bool readRow(Row& row);
+  PiiVariant convert(const QVariant& value, int column);
+  bool takeRows(int count, QList<Row>& rows);
+  void emitBlock(const QList<Row>& rows);
+  void prefetchRows();
+  void stopPrefetcher();
 };
 
 #endif //_PIIDATABASEREADER_H
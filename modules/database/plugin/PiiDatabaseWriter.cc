@@ -19,6 +19,9 @@
 #include <QMetaType>
 #include <QSqlQuery>
 #include <QFile>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
+#include <PiiTimer.h>
 
 using namespace PiiYdin;
 
@@ -26,7 +29,14 @@ PiiDatabaseWriter::Data::Data() :
   bWriteEnabled(true),
   iDecimalsShown(0),
   pQuery(0),
-  pFile(0)
+  pFile(0),
+  iBatchSize(1),
+  iFlushInterval(1000),
+  iMaxBacklog(0),
+  iDroppedCount(0),
+  iBatchStartTime(0),
+  pWriterThread(0),
+  bWriterRunning(false)
 {
 }
 
@@ -41,10 +51,12 @@ PiiDatabaseWriter::PiiDatabaseWriter() :
 {
   setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
   setProtectionLevel("defaultValues", WriteWhenStoppedOrPaused);
+  setProtectionLevel("maxBacklog", WriteWhenStoppedOrPaused);
 }
 
 PiiDatabaseWriter::~PiiDatabaseWriter()
 {
+  stopWriter();
   closeConnection();
 }
 
@@ -53,6 +65,21 @@ void PiiDatabaseWriter::aboutToChangeState(State state)
   PII_D;
   if (state == Stopped)
     {
+      // Write whatever is left in the backlog or in the last batch.
+      stopWriter();
+      if (!d->lstRows.isEmpty())
+        {
+          QList<QVariantList> lstRows(d->lstRows);
+          d->lstRows.clear();
+          try
+            {
+              writeRows(lstRows);
+            }
+          catch (PiiExecutionException& ex)
+            {
+              piiWarning(ex.message());
+            }
+        }
       delete d->pFile, d->pFile = 0;
       delete d->pQuery, d->pQuery = 0;
     }
@@ -61,12 +88,98 @@ void PiiDatabaseWriter::aboutToChangeState(State state)
 
 void PiiDatabaseWriter::check(bool reset)
 {
+  PII_D;
   PiiDefaultOperation::check(reset);
 
+  bool bConnected = false;
   for (int i=0; i<inputCount(); i++)
     if (inputAt(i)->isConnected())
-      return;
-  PII_THROW(PiiExecutionException, tr("At least one input must be connected."));
+      {
+        bConnected = true;
+        break;
+      }
+  if (!bConnected)
+    PII_THROW(PiiExecutionException, tr("At least one input must be connected."));
+
+  if (reset)
+    {
+      d->iDroppedCount = 0;
+      d->strWriterError.clear();
+    }
+
+  if (d->iMaxBacklog <= 0)
+    stopWriter();
+  else if (d->pWriterThread == 0)
+    {
+      d->bWriterRunning = true;
+      d->pWriterThread = Pii::createAsyncCall(this, &PiiDatabaseWriter::writeBacklog);
+      d->pWriterThread->start();
+    }
+}
+
+void PiiDatabaseWriter::stopWriter()
+{
+  PII_D;
+  if (d->pWriterThread == 0)
+    return;
+  synchronized (d->writerMutex)
+    {
+      d->bWriterRunning = false;
+      d->rowsAvailable.wakeAll();
+    }
+  // The writer exits once the backlog is empty.
+  d->pWriterThread->wait();
+  delete d->pWriterThread;
+  d->pWriterThread = 0;
+}
+
+void PiiDatabaseWriter::writeBacklog()
+{
+  PII_D;
+  QMutexLocker lock(&d->writerMutex);
+  forever
+    {
+      // Wait until a batch is full, the oldest row has waited long
+      // enough, or the writer is stopped.
+      while (d->bWriterRunning && d->lstRows.size() < d->iBatchSize)
+        {
+          if (d->lstRows.isEmpty())
+            d->rowsAvailable.wait(&d->writerMutex);
+          else
+            {
+              int iWaited = int((PiiTimer::timestamp() - d->iBatchStartTime) / 1000);
+              if (iWaited >= d->iFlushInterval)
+                break;
+              d->rowsAvailable.wait(&d->writerMutex, d->iFlushInterval - iWaited);
+            }
+        }
+      if (d->lstRows.isEmpty())
+        break;
+
+      QList<QVariantList> lstBatch(d->lstRows.mid(0, qMax(1, d->iBatchSize)));
+      d->lstRows.erase(d->lstRows.begin(), d->lstRows.begin() + lstBatch.size());
+      d->iBatchStartTime = PiiTimer::timestamp();
+      lock.unlock();
+
+      QString strError;
+      try
+        {
+          writeRows(lstBatch);
+        }
+      catch (PiiExecutionException& ex)
+        {
+          strError = ex.message();
+        }
+
+      lock.relock();
+      if (!strError.isEmpty())
+        d->strWriterError = strError;
+    }
+  lock.unlock();
+
+  // The connection was opened in this thread and must be closed here.
+  delete d->pQuery, d->pQuery = 0;
+  closeConnection();
 }
 
 void PiiDatabaseWriter::createQuery()
@@ -117,17 +230,53 @@ QSqlDatabase* PiiDatabaseWriter::createDatabase(const QString& driver,
 void PiiDatabaseWriter::process()
 {
   PII_D;
+  if (d->pWriterThread != 0)
+    {
+      QMutexLocker lock(&d->writerMutex);
+      if (!d->strWriterError.isEmpty())
+        {
+          QString strError(d->strWriterError);
+          d->strWriterError.clear();
+          PII_THROW(PiiExecutionException, strError);
+        }
+    }
+
   if (!d->bWriteEnabled)
     return;
 
-  if (!isConnected() && d->pFile == 0)
+  QVariantList row(readRow());
+
+  if (d->pWriterThread != 0)
     {
-      delete d->pQuery, d->pQuery = 0;
-      if (openConnection())
-        createQuery();
+      QMutexLocker lock(&d->writerMutex);
+      if (d->lstRows.size() >= d->iMaxBacklog)
+        {
+          ++d->iDroppedCount;
+          return;
+        }
+      if (d->lstRows.isEmpty())
+        d->iBatchStartTime = PiiTimer::timestamp();
+      d->lstRows << row;
+      d->rowsAvailable.wakeOne();
+      return;
+    }
+
+  if (d->lstRows.isEmpty())
+    d->iBatchStartTime = PiiTimer::timestamp();
+  d->lstRows << row;
+  if (d->lstRows.size() >= d->iBatchSize ||
+      PiiTimer::timestamp() - d->iBatchStartTime >= qint64(d->iFlushInterval) * 1000)
+    {
+      QList<QVariantList> lstRows(d->lstRows);
+      d->lstRows.clear();
+      writeRows(lstRows);
     }
+}
 
-  QStringList row;
+QVariantList PiiDatabaseWriter::readRow()
+{
+  PII_D;
+  QVariantList row;
   for (int i=0; i<inputCount() && i<d->lstColumnNames.size(); i++)
     {
       QVariant value;
@@ -150,34 +299,75 @@ void PiiDatabaseWriter::process()
       else
         value = d->vecDefaultValues[i];
 
-      // Decimal numbers may need rounding
-      if (d->iDecimalsShown > 0 && value.type() == QVariant::Double)
-        row << QString().setNum(value.toDouble(), 'f', d->iDecimalsShown);
-      else
-        row << value.toString();
+      row << value;
+    }
+  return row;
+}
 
-      if (d->pQuery != 0)
-        // Bind the value to a prepared query
-        d->pQuery->bindValue(i, value.toString());
+QString PiiDatabaseWriter::formatValue(const QVariant& value) const
+{
+  const PII_D;
+  // Decimal numbers may need rounding
+  if (d->iDecimalsShown > 0 && value.type() == QVariant::Double)
+    return QString().setNum(value.toDouble(), 'f', d->iDecimalsShown);
+  return value.toString();
+}
+
+void PiiDatabaseWriter::writeRows(const QList<QVariantList>& rows)
+{
+  PII_D;
+  if (!isConnected() && d->pFile == 0)
+    {
+      delete d->pQuery, d->pQuery = 0;
+      if (openConnection())
+        createQuery();
     }
 
   if (d->pQuery != 0)
     {
-      // Try to execute the query
-      exec(*d->pQuery);
+      if (rows.size() == 1)
+        {
+          // Bind the values to a prepared query
+          for (int i=0; i<rows[0].size(); ++i)
+            d->pQuery->bindValue(i, rows[0][i].toString());
+          // Try to execute the query
+          exec(*d->pQuery);
+          return;
+        }
+
+      // Batch queries take a list of values for each column.
+      const int iColumns = rows[0].size();
+      for (int i=0; i<iColumns; ++i)
+        {
+          QVariantList lstValues;
+          for (int r=0; r<rows.size(); ++r)
+            lstValues << rows[r][i].toString();
+          d->pQuery->bindValue(i, lstValues);
+        }
+      bool bTransaction = driver()->hasFeature(QSqlDriver::Transactions) && db()->transaction();
+      if (execBatch(*d->pQuery))
+        {
+          if (bTransaction)
+            db()->commit();
+        }
+      else if (bTransaction)
+        db()->rollback();
     }
   else if (d->pFile != 0)
     {
-      for (int i=0; i<row.size(); i++)
+      for (int r=0; r<rows.size(); ++r)
         {
-          if (i)
-            d->pFile->putChar(',');
-          QString value = row[i].replace('"', "\"\"");
-          d->pFile->putChar('"');
-          d->pFile->write(value.toUtf8());
-          d->pFile->putChar('"');
+          for (int i=0; i<rows[r].size(); i++)
+            {
+              if (i)
+                d->pFile->putChar(',');
+              QString value = formatValue(rows[r][i]).replace('"', "\"\"");
+              d->pFile->putChar('"');
+              d->pFile->write(value.toUtf8());
+              d->pFile->putChar('"');
+            }
+          d->pFile->putChar('\n');
         }
-      d->pFile->putChar('\n');
       d->pFile->flush();
     }
 }
@@ -229,5 +419,16 @@ int PiiDatabaseWriter::decimalsShown() const { return _d()->iDecimalsShown; }
 void PiiDatabaseWriter::setTableName(const QString& tableName) { _d()->strTableName = tableName; }
 QString PiiDatabaseWriter::tableName() const { return _d()->strTableName; }
 
+void PiiDatabaseWriter::setBatchSize(int batchSize) { _d()->iBatchSize = qMax(1, batchSize); }
+int PiiDatabaseWriter::batchSize() const { return _d()->iBatchSize; }
+
+void PiiDatabaseWriter::setFlushInterval(int flushInterval) { _d()->iFlushInterval = flushInterval; }
+int PiiDatabaseWriter::flushInterval() const { return _d()->iFlushInterval; }
+
+void PiiDatabaseWriter::setMaxBacklog(int maxBacklog) { _d()->iMaxBacklog = maxBacklog; }
+int PiiDatabaseWriter::maxBacklog() const { return _d()->iMaxBacklog; }
+
+int PiiDatabaseWriter::droppedCount() const { return _d()->iDroppedCount; }
+
 QStringList PiiDatabaseWriter::columnNames() const { return _d()->lstColumnNames; }
 QVariantMap PiiDatabaseWriter::defaultValues() const { return _d()->mapDefaultValues; }
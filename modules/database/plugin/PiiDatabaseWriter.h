@@ -18,6 +18,10 @@
 
 #include "PiiDatabaseOperation.h"
 #include <QSqlDatabase>
+#include <QVariant>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 class QFile;
 class QSqlQuery;
@@ -90,6 +94,40 @@ class PiiDatabaseWriter : public PiiDatabaseOperation
    */
   Q_PROPERTY(int decimalsShown READ decimalsShown WRITE setDecimalsShown);
 
+  /**
+   * The maximum number of rows written at once. If this value is
+   * larger than one, rows are collected and written in a single
+   * transaction using a batch query, which greatly reduces the number
+   * of round trips to the database server. Flat files are flushed once
+   * per batch. The default value is 1.
+   */
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize);
+
+  /**
+   * The maximum time a row may wait for the rest of its batch, in
+   * milliseconds. An incomplete batch is written when this time has
+   * passed, and when the operation stops. If there is no background
+   * writer (see [maxBacklog]), the time limit is checked only when
+   * new rows arrive. The default value is 1000.
+   */
+  Q_PROPERTY(int flushInterval READ flushInterval WRITE setFlushInterval);
+
+  /**
+   * The maximum number of rows waiting to be written. If this value
+   * is larger than zero, rows are written by a separate thread that
+   * owns the database connection, and database latency never delays
+   * processing. If the backlog is full, new rows are discarded and
+   * counted in [droppedCount]. Database errors are reported on the
+   * next incoming row. The default value is 0, which means that rows
+   * are written in the processing thread.
+   */
+  Q_PROPERTY(int maxBacklog READ maxBacklog WRITE setMaxBacklog);
+
+  /**
+   * The number of rows discarded because the backlog was full.
+   */
+  Q_PROPERTY(int droppedCount READ droppedCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -126,8 +164,24 @@ protected:
   QString tableName() const;
   void setTableName(const QString& tableName);
 
+  void setBatchSize(int batchSize);
+  int batchSize() const;
+
+  void setFlushInterval(int flushInterval);
+  int flushInterval() const;
+
+  void setMaxBacklog(int maxBacklog);
+  int maxBacklog() const;
+
+  int droppedCount() const;
+
 private:
   void initializeDefaults();
+  QVariantList readRow();
+  QString formatValue(const QVariant& value) const;
+  void writeRows(const QList<QVariantList>& rows);
+  void writeBacklog();
+  void stopWriter();
 
   /// @internal
   class Data : public PiiDatabaseOperation::Data
@@ -144,6 +198,16 @@ private:
     int iDecimalsShown;
     QSqlQuery* pQuery;
     QFile *pFile;
+
+    int iBatchSize, iFlushInterval, iMaxBacklog, iDroppedCount;
+    // Rows waiting to be written, and the time the first one arrived.
+    QList<QVariantList> lstRows;
+    qint64 iBatchStartTime;
+    QThread* pWriterThread;
+    bool bWriterRunning;
+    QMutex writerMutex;
+    QWaitCondition rowsAvailable;
+    QString strWriterError;
   };
   PII_D_FUNC;
 
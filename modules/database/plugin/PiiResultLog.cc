@@ -0,0 +1,473 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiResultLog.h"
+
+#include <PiiMappedFile.h>
+#include <QCoreApplication>
+#include <cstring>
+
+namespace PiiResultLog
+{
+  static const char aFileMagic[8] = { 'P', 'I', 'I', 'R', 'L', 'O', 'G', '1' };
+  static const char aTrailerMagic[8] = { 'P', 'I', 'I', 'R', 'L', 'E', 'N', 'D' };
+  static const quint32 iByteOrderMark = 0x01020304;
+  static const quint32 iVersion = 1;
+  static const quint32 iBlockMagic = 0x4b4c4250; // "PBLK"
+  static const quint32 iIndexMagic = 0x58444950; // "PIDX"
+
+  struct FileHeader
+  {
+    char magic[8];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 columnCount;
+    quint32 blockRows;
+  };
+
+  struct BlockHeader
+  {
+    quint32 magic;
+    quint32 rowCount;
+    quint64 firstRow;
+  };
+
+  struct IndexHeader
+  {
+    quint32 magic;
+    quint32 entryCount;
+    quint64 previousIndex;
+  };
+
+  struct Trailer
+  {
+    quint64 lastIndex;
+    quint64 rowCount;
+    char magic[8];
+  };
+
+  static inline quint64 padded(quint64 bytes) { return (bytes + 7) & ~quint64(7); }
+  static const char aPadding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+  static inline QString tr(const char* text)
+  {
+    return QCoreApplication::translate("PiiResultLog", text);
+  }
+
+  int columnTypeSize(int type)
+  {
+    switch (type)
+      {
+      case Int8Column: case UInt8Column: return 1;
+      case Int16Column: case UInt16Column: return 2;
+      case Int32Column: case UInt32Column: case FloatColumn: return 4;
+      case Int64Column: case UInt64Column: case DoubleColumn: return 8;
+      }
+    return 0;
+  }
+
+  Writer::Writer() :
+    _iBlockRows(4096),
+    _iIndexInterval(16),
+    _iBufferedRows(0),
+    _iRowCount(0),
+    _iLastIndexOffset(0)
+  {}
+
+  Writer::~Writer()
+  {
+    close();
+  }
+
+  bool Writer::write(const void* data, qint64 bytes)
+  {
+    if (_file.write(static_cast<const char*>(data), bytes) != bytes)
+      {
+        _strError = tr("Cannot write to %1: %2").arg(_file.fileName()).arg(_file.errorString());
+        return false;
+      }
+    return true;
+  }
+
+  bool Writer::open(const QString& fileName, const QList<Column>& columns,
+                    int blockRows, int indexInterval)
+  {
+    close();
+
+    if (columns.isEmpty())
+      {
+        _strError = tr("A result log must have at least one column.");
+        return false;
+      }
+    for (int i=0; i<columns.size(); ++i)
+      if (columnTypeSize(columns[i].type) == 0 || columns[i].iWidth < 1)
+        {
+          _strError = tr("Column \"%1\" has an invalid type or width.").arg(columns[i].strName);
+          return false;
+        }
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+      {
+        _strError = tr("Cannot open %1 for writing: %2").arg(fileName).arg(_file.errorString());
+        return false;
+      }
+
+    _lstColumns = columns;
+    _iBlockRows = qMax(blockRows, 1);
+    _iIndexInterval = qMax(indexInterval, 1);
+    _iBufferedRows = 0;
+    _iRowCount = 0;
+    _iLastIndexOffset = 0;
+    _vecIndexEntries.clear();
+    _vecBuffers.resize(columns.size());
+    for (int i=0; i<columns.size(); ++i)
+      {
+        // Reserving keeps the capacity when the buffer is emptied.
+        _vecBuffers[i].reserve(_iBlockRows * columns[i].rowSize());
+        _vecBuffers[i].resize(0);
+      }
+
+    FileHeader header;
+    std::memcpy(header.magic, aFileMagic, sizeof(aFileMagic));
+    header.byteOrder = iByteOrderMark;
+    header.version = iVersion;
+    header.columnCount = quint32(columns.size());
+    header.blockRows = quint32(_iBlockRows);
+    bool bOk = write(&header, sizeof(header));
+
+    for (int i=0; bOk && i<columns.size(); ++i)
+      {
+        QByteArray aName(columns[i].strName.toUtf8());
+        quint32 aDescriptor[3] = { quint32(columns[i].type), quint32(columns[i].iWidth), quint32(aName.size()) };
+        bOk = write(aDescriptor, sizeof(aDescriptor)) &&
+          write(aName.constData(), aName.size()) &&
+          write(aPadding, padded(sizeof(aDescriptor) + aName.size()) - sizeof(aDescriptor) - aName.size());
+      }
+    // Header (24 bytes) + descriptors are now aligned to 8 bytes.
+
+    if (!bOk)
+      {
+        _file.close();
+        return false;
+      }
+    return true;
+  }
+
+  char* Writer::reserveRows(int column, int rows)
+  {
+    QByteArray& buffer = _vecBuffers[column];
+    const int iOldSize = buffer.size();
+    buffer.resize(iOldSize + rows * _lstColumns[column].rowSize());
+    return buffer.data() + iOldSize;
+  }
+
+  bool Writer::commitRows(int rows)
+  {
+    _iBufferedRows += rows;
+    _iRowCount += rows;
+    if (_iBufferedRows >= _iBlockRows)
+      return writeBlock();
+    return true;
+  }
+
+  bool Writer::flush()
+  {
+    if (!isOpen())
+      return true;
+    if (!writeBlock())
+      return false;
+    _file.flush();
+    return true;
+  }
+
+  bool Writer::writeBlock()
+  {
+    if (_iBufferedRows == 0)
+      return true;
+
+    const quint64 iOffset = quint64(_file.pos());
+    BlockHeader header;
+    header.magic = iBlockMagic;
+    header.rowCount = quint32(_iBufferedRows);
+    header.firstRow = quint64(_iRowCount - _iBufferedRows);
+    if (!write(&header, sizeof(header)))
+      return false;
+    for (int i=0; i<_vecBuffers.size(); ++i)
+      {
+        QByteArray& buffer = _vecBuffers[i];
+        if (!write(buffer.constData(), buffer.size()) ||
+            !write(aPadding, padded(buffer.size()) - buffer.size()))
+          return false;
+        buffer.resize(0);
+      }
+    _iBufferedRows = 0;
+
+    _vecIndexEntries << iOffset << header.firstRow;
+    if (_vecIndexEntries.size() >= 2 * _iIndexInterval)
+      return writeIndex();
+    return true;
+  }
+
+  bool Writer::writeIndex()
+  {
+    const quint64 iOffset = quint64(_file.pos());
+    IndexHeader header;
+    header.magic = iIndexMagic;
+    header.entryCount = quint32(_vecIndexEntries.size() / 2);
+    header.previousIndex = _iLastIndexOffset;
+    if (!write(&header, sizeof(header)) ||
+        !write(_vecIndexEntries.constData(), _vecIndexEntries.size() * sizeof(quint64)))
+      return false;
+    _vecIndexEntries.clear();
+    _iLastIndexOffset = iOffset;
+    return true;
+  }
+
+  bool Writer::close()
+  {
+    if (!isOpen())
+      return true;
+
+    bool bOk = writeBlock() && writeIndex();
+    if (bOk)
+      {
+        Trailer trailer;
+        trailer.lastIndex = _iLastIndexOffset;
+        trailer.rowCount = quint64(_iRowCount);
+        std::memcpy(trailer.magic, aTrailerMagic, sizeof(aTrailerMagic));
+        bOk = write(&trailer, sizeof(trailer));
+      }
+    _file.close();
+    _vecBuffers.clear();
+    _vecIndexEntries.clear();
+    return bOk;
+  }
+
+
+  Reader::Reader() :
+    _pMappedFile(0),
+    _iDataOffset(0),
+    _iRowCount(0),
+    _bComplete(false)
+  {}
+
+  Reader::~Reader()
+  {
+    close();
+  }
+
+  void Reader::close()
+  {
+    if (_pMappedFile != 0)
+      _pMappedFile->release();
+    _pMappedFile = 0;
+    _lstColumns.clear();
+    _vecBlocks.clear();
+    _iRowCount = 0;
+    _bComplete = false;
+  }
+
+  bool Reader::open(const QString& fileName)
+  {
+    close();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+      {
+        _strError = tr("Cannot open %1 for reading: %2").arg(fileName).arg(file.errorString());
+        return false;
+      }
+    // The mapping stays valid after the file has been closed.
+    _pMappedFile = PiiMappedFile::map(file.handle());
+    file.close();
+    if (_pMappedFile == 0)
+      {
+        _strError = tr("Cannot map %1 to memory.").arg(fileName);
+        return false;
+      }
+
+    if (!readHeader())
+      {
+        _strError = tr("%1 is not a result log or it was written on an incompatible machine.").arg(fileName);
+        close();
+        return false;
+      }
+
+    _bComplete = readIndex();
+    if (!_bComplete)
+      scanBlocks();
+
+    _iRowCount = 0;
+    if (!_vecBlocks.isEmpty())
+      _iRowCount = _vecBlocks.last().iFirstRow + _vecBlocks.last().iRowCount;
+    return true;
+  }
+
+  bool Reader::readHeader()
+  {
+    const char* pData = _pMappedFile->data();
+    const quint64 iSize = _pMappedFile->size();
+    FileHeader header;
+    if (iSize < sizeof(header))
+      return false;
+    std::memcpy(&header, pData, sizeof(header));
+    if (std::memcmp(header.magic, aFileMagic, sizeof(aFileMagic)) != 0 ||
+        header.byteOrder != iByteOrderMark ||
+        header.version > iVersion)
+      return false;
+
+    quint64 iOffset = sizeof(header);
+    for (quint32 i=0; i<header.columnCount; ++i)
+      {
+        quint32 aDescriptor[3];
+        if (iOffset + sizeof(aDescriptor) > iSize)
+          return false;
+        std::memcpy(aDescriptor, pData + iOffset, sizeof(aDescriptor));
+        if (columnTypeSize(aDescriptor[0]) == 0 || aDescriptor[1] == 0 ||
+            iOffset + sizeof(aDescriptor) + aDescriptor[2] > iSize)
+          return false;
+        _lstColumns << Column(QString::fromUtf8(pData + iOffset + sizeof(aDescriptor), int(aDescriptor[2])),
+                              ColumnType(aDescriptor[0]),
+                              int(aDescriptor[1]));
+        iOffset += padded(sizeof(aDescriptor) + aDescriptor[2]);
+      }
+    _iDataOffset = iOffset;
+    return !_lstColumns.isEmpty();
+  }
+
+  quint64 Reader::blockSize(int rowCount) const
+  {
+    quint64 iSize = sizeof(BlockHeader);
+    for (int i=0; i<_lstColumns.size(); ++i)
+      iSize += padded(quint64(rowCount) * _lstColumns[i].rowSize());
+    return iSize;
+  }
+
+  bool Reader::readBlockHeader(quint64 offset, Block* block) const
+  {
+    BlockHeader header;
+    if (offset < _iDataOffset || offset + sizeof(header) > _pMappedFile->size())
+      return false;
+    std::memcpy(&header, _pMappedFile->data() + offset, sizeof(header));
+    if (header.magic != iBlockMagic ||
+        offset + blockSize(int(header.rowCount)) > _pMappedFile->size())
+      return false;
+    *block = Block(offset, qint64(header.firstRow), int(header.rowCount));
+    return true;
+  }
+
+  bool Reader::readIndex()
+  {
+    const char* pData = _pMappedFile->data();
+    const quint64 iSize = _pMappedFile->size();
+    Trailer trailer;
+    if (iSize < _iDataOffset + sizeof(trailer))
+      return false;
+    std::memcpy(&trailer, pData + iSize - sizeof(trailer), sizeof(trailer));
+    if (std::memcmp(trailer.magic, aTrailerMagic, sizeof(aTrailerMagic)) != 0)
+      return false;
+
+    // Index blocks are chained backwards from the trailer.
+    QVector<Block> vecBlocks;
+    quint64 iIndexOffset = trailer.lastIndex;
+    while (iIndexOffset != 0)
+      {
+        IndexHeader header;
+        if (iIndexOffset < _iDataOffset || iIndexOffset + sizeof(header) > iSize)
+          return false;
+        std::memcpy(&header, pData + iIndexOffset, sizeof(header));
+        const quint64 iEntriesOffset = iIndexOffset + sizeof(header);
+        if (header.magic != iIndexMagic ||
+            header.previousIndex >= iIndexOffset ||
+            iEntriesOffset + quint64(header.entryCount) * 2 * sizeof(quint64) > iSize)
+          return false;
+        for (int i=int(header.entryCount); i--; )
+          {
+            quint64 aEntry[2];
+            std::memcpy(aEntry, pData + iEntriesOffset + i * sizeof(aEntry), sizeof(aEntry));
+            Block block;
+            if (!readBlockHeader(aEntry[0], &block) || block.iFirstRow != qint64(aEntry[1]))
+              return false;
+            vecBlocks << block;
+          }
+        iIndexOffset = header.previousIndex;
+      }
+
+    // Reverse to get the blocks in row order.
+    _vecBlocks.resize(vecBlocks.size());
+    for (int i=0; i<vecBlocks.size(); ++i)
+      _vecBlocks[i] = vecBlocks[vecBlocks.size() - 1 - i];
+    return true;
+  }
+
+  void Reader::scanBlocks()
+  {
+    const char* pData = _pMappedFile->data();
+    const quint64 iSize = _pMappedFile->size();
+    _vecBlocks.clear();
+    quint64 iOffset = _iDataOffset;
+    while (iOffset + sizeof(quint32) * 2 <= iSize)
+      {
+        quint32 aMagic[2];
+        std::memcpy(aMagic, pData + iOffset, sizeof(aMagic));
+        if (aMagic[0] == iIndexMagic)
+          iOffset += sizeof(IndexHeader) + quint64(aMagic[1]) * 2 * sizeof(quint64);
+        else
+          {
+            // Stops at the trailer and at a truncated block.
+            Block block;
+            if (!readBlockHeader(iOffset, &block))
+              break;
+            _vecBlocks << block;
+            iOffset += blockSize(block.iRowCount);
+          }
+      }
+  }
+
+  int Reader::columnIndex(const QString& name) const
+  {
+    for (int i=0; i<_lstColumns.size(); ++i)
+      if (_lstColumns[i].strName == name)
+        return i;
+    return -1;
+  }
+
+  int Reader::findBlock(qint64 row) const
+  {
+    if (row < 0 || row >= _iRowCount)
+      return -1;
+    // Binary search for the last block whose first row is <= row.
+    int iLow = 0, iHigh = _vecBlocks.size() - 1;
+    while (iLow < iHigh)
+      {
+        int iMid = (iLow + iHigh + 1) / 2;
+        if (_vecBlocks[iMid].iFirstRow <= row)
+          iLow = iMid;
+        else
+          iHigh = iMid - 1;
+      }
+    return iLow;
+  }
+
+  const char* Reader::data(int block, int column) const
+  {
+    const Block& b = _vecBlocks[block];
+    quint64 iOffset = b.iOffset + sizeof(BlockHeader);
+    for (int i=0; i<column; ++i)
+      iOffset += padded(quint64(b.iRowCount) * _lstColumns[i].rowSize());
+    return _pMappedFile->data() + iOffset;
+  }
+}
@@ -0,0 +1,420 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRESULTLOG_H
+#define _PIIRESULTLOG_H
+
+#include "PiiDatabaseGlobal.h"
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <QFile>
+
+class PiiMappedFile;
+
+/**
+ * Functions and classes for storing measurement results in a compact
+ * columnar binary format. A *result log* contains a fixed set of
+ * typed columns. Each row stores `width` values of the column's type
+ * to each column. Rows are collected into *blocks*, and the values
+ * of each column are stored contiguously within a block. The file
+ * is designed to be memory-mapped: all values are aligned to eight
+ * bytes, so a block of a column can be used as a matrix without
+ * copying.
+ *
+ * File layout
+ * -----------
+ *
+ * All numbers are stored in the native byte order of the writing
+ * machine. A byte order mark in the header lets the reader reject
+ * files written on a machine with a different byte order.
+ *
+ * - Header: magic (8 bytes, "PIIRLOG1"), byte order mark (u32,
+ * 0x01020304), version (u32), column count (u32), nominal rows per
+ * block (u32). The header is followed by a descriptor for each
+ * column: type (u32, [ColumnType]), width (u32), name length (u32)
+ * and the name in UTF-8, padded to a multiple of eight bytes.
+ *
+ * - Data block: magic (u32, "PBLK"), row count (u32), index of the
+ * first row (u64). The data of each column follows in order, each
+ * padded to a multiple of eight bytes.
+ *
+ * - Index block: magic (u32, "PIDX"), entry count (u32), offset of
+ * the previous index block (u64, zero if none). Each entry contains
+ * the offset (u64) and the first row (u64) of a data block written
+ * after the previous index block. Index blocks are written
+ * periodically between data blocks.
+ *
+ * - Trailer: offset of the last index block (u64), total row count
+ * (u64) and magic (8 bytes, "PIIRLEND"). The trailer is written when
+ * the log is closed.
+ *
+ * A reader follows the chain of index blocks from the trailer
+ * backwards. If the trailer is missing (the writer crashed), data
+ * blocks are scanned sequentially from the beginning of the file,
+ * and all complete blocks can still be recovered.
+ */
+namespace PiiResultLog
+{
+  /**
+   * Column types. Boolean values are stored as `UInt8Column`.
+   */
+  enum ColumnType
+    {
+      Int8Column = 1,
+      UInt8Column,
+      Int16Column,
+      UInt16Column,
+      Int32Column,
+      UInt32Column,
+      Int64Column,
+      UInt64Column,
+      FloatColumn,
+      DoubleColumn
+    };
+
+  /**
+   * Returns the size of a value of the given column *type* in bytes,
+   * or zero if the type is unknown.
+   */
+  PII_DATABASE_EXPORT int columnTypeSize(int type);
+
+  /**
+   * Converts a primitive type to a column type.
+   *
+   * ~~~(c++)
+   * PiiResultLog::ColumnType type = PiiResultLog::ColumnTypeOf<float>::type;
+   * ~~~
+   */
+  template <class T> struct ColumnTypeOf;
+  /// @hide
+#define PII_RESULT_LOG_COLUMN_TYPE(TYPE, COLUMN_TYPE)                   \
+  template <> struct ColumnTypeOf<TYPE> { static const ColumnType type = COLUMN_TYPE; }
+  PII_RESULT_LOG_COLUMN_TYPE(char, Int8Column);
+  PII_RESULT_LOG_COLUMN_TYPE(unsigned char, UInt8Column);
+  PII_RESULT_LOG_COLUMN_TYPE(bool, UInt8Column);
+  PII_RESULT_LOG_COLUMN_TYPE(short, Int16Column);
+  PII_RESULT_LOG_COLUMN_TYPE(unsigned short, UInt16Column);
+  PII_RESULT_LOG_COLUMN_TYPE(int, Int32Column);
+  PII_RESULT_LOG_COLUMN_TYPE(unsigned int, UInt32Column);
+  PII_RESULT_LOG_COLUMN_TYPE(qint64, Int64Column);
+  PII_RESULT_LOG_COLUMN_TYPE(quint64, UInt64Column);
+  PII_RESULT_LOG_COLUMN_TYPE(float, FloatColumn);
+  PII_RESULT_LOG_COLUMN_TYPE(double, DoubleColumn);
+#undef PII_RESULT_LOG_COLUMN_TYPE
+  /// @endhide
+
+  /**
+   * Case clauses for all column types. Calls *func* with the
+   * primitive type that corresponds to the column type in a switch
+   * statement.
+   *
+   * ~~~(c++)
+   * switch (column.type)
+   *   {
+   *     PII_RESULT_LOG_CASES(emitValue, (column, data));
+   *   }
+   * ~~~
+   */
+#define PII_RESULT_LOG_CASES(func, params)                        \
+  case PiiResultLog::Int8Column: func<char>params; break;         \
+  case PiiResultLog::UInt8Column: func<unsigned char>params; break; \
+  case PiiResultLog::Int16Column: func<short>params; break;       \
+  case PiiResultLog::UInt16Column: func<unsigned short>params; break; \
+  case PiiResultLog::Int32Column: func<int>params; break;         \
+  case PiiResultLog::UInt32Column: func<unsigned int>params; break; \
+  case PiiResultLog::Int64Column: func<qint64>params; break;      \
+  case PiiResultLog::UInt64Column: func<quint64>params; break;    \
+  case PiiResultLog::FloatColumn: func<float>params; break;       \
+  case PiiResultLog::DoubleColumn: func<double>params; break
+
+  /**
+   * Describes a column in a result log.
+   */
+  struct Column
+  {
+    Column(const QString& name = QString(), ColumnType type = DoubleColumn, int width = 1) :
+      strName(name), type(type), iWidth(width)
+    {}
+
+    /// Returns the number of bytes each row takes in this column.
+    int rowSize() const { return iWidth * columnTypeSize(type); }
+
+    bool operator== (const Column& other) const
+    {
+      return strName == other.strName && type == other.type && iWidth == other.iWidth;
+    }
+
+    /// The name of the column.
+    QString strName;
+    /// The type of the values.
+    ColumnType type;
+    /// The number of values on each row.
+    int iWidth;
+  };
+
+  /**
+   * Appends rows to a result log file. Rows are buffered in memory
+   * until a block is full and only then written to the file.
+   *
+   * ~~~(c++)
+   * PiiResultLog::Writer writer;
+   * QList<PiiResultLog::Column> lstColumns;
+   * lstColumns << PiiResultLog::Column("area", PiiResultLog::Int32Column)
+   *            << PiiResultLog::Column("centroid", PiiResultLog::DoubleColumn, 2);
+   * if (!writer.open("results.prl", lstColumns))
+   *   qDebug() << writer.errorString();
+   * *reinterpret_cast<int*>(writer.reserveRows(0, 1)) = 100;
+   * double* pCentroid = reinterpret_cast<double*>(writer.reserveRows(1, 1));
+   * pCentroid[0] = 1.5; pCentroid[1] = 2.5;
+   * writer.commitRows(1);
+   * writer.close();
+   * ~~~
+   */
+  class PII_DATABASE_EXPORT Writer
+  {
+  public:
+    Writer();
+    /**
+     * Closes the log.
+     */
+    ~Writer();
+
+    /**
+     * Creates a new log file. An existing file will be overwritten.
+     *
+     * @param fileName the name of the file
+     *
+     * @param columns column descriptions
+     *
+     * @param blockRows the number of rows to buffer before writing a
+     * block
+     *
+     * @param indexInterval the number of data blocks between index
+     * blocks
+     *
+     * @return `true` on success, `false` on failure
+     */
+    bool open(const QString& fileName, const QList<Column>& columns,
+              int blockRows = 4096, int indexInterval = 16);
+
+    /**
+     * Writes buffered rows, the last index block and the trailer and
+     * closes the file. Does nothing if the log is not open.
+     */
+    bool close();
+
+    /**
+     * Returns `true` if the log is open.
+     */
+    bool isOpen() const { return _file.isOpen(); }
+
+    /**
+     * Returns a pointer to a buffer that will receive the values of
+     * *rows* new rows in *column*. The buffer has room for `rows *
+     * rowSize()` bytes. The rows become part of the log once
+     * [commitRows()] is called. All columns must be filled before
+     * that.
+     */
+    char* reserveRows(int column, int rows);
+
+    /**
+     * Commits *rows* rows previously filled in with
+     * [reserveRows()]. Writes a block to the file if the number of
+     * buffered rows reaches the block size. Returns `false` on a
+     * write error.
+     */
+    bool commitRows(int rows);
+
+    /**
+     * Writes buffered rows to the file as a (possibly short) block.
+     * This makes the rows visible to readers even if the writer
+     * crashes later.
+     */
+    bool flush();
+
+    /**
+     * Returns the number of rows committed to the log.
+     */
+    qint64 rowCount() const { return _iRowCount; }
+
+    /**
+     * Returns the columns of the open log.
+     */
+    QList<Column> columns() const { return _lstColumns; }
+
+    /**
+     * Returns a description of the last error.
+     */
+    QString errorString() const { return _strError; }
+
+  private:
+    bool write(const void* data, qint64 bytes);
+    bool writeBlock();
+    bool writeIndex();
+
+    QFile _file;
+    QList<Column> _lstColumns;
+    QVector<QByteArray> _vecBuffers;
+    int _iBlockRows, _iIndexInterval;
+    int _iBufferedRows;
+    qint64 _iRowCount;
+    // Offsets and first rows of blocks written after the last index
+    QVector<quint64> _vecIndexEntries;
+    quint64 _iLastIndexOffset;
+    QString _strError;
+
+    PII_DISABLE_COPY(Writer);
+  };
+
+  /**
+   * Reads a result log by mapping it to memory. Data are never
+   * copied; the pointers returned by [data()] point directly to the
+   * mapped file.
+   *
+   * ~~~(c++)
+   * PiiResultLog::Reader reader;
+   * if (reader.open("results.prl"))
+   *   {
+   *     int iArea = reader.columnIndex("area");
+   *     for (int b=0; b<reader.blockCount(); ++b)
+   *       {
+   *         const int* pAreas = reinterpret_cast<const int*>(reader.data(b, iArea));
+   *         for (int r=0; r<reader.blockRowCount(b); ++r)
+   *           sum += pAreas[r];
+   *       }
+   *   }
+   * ~~~
+   */
+  class PII_DATABASE_EXPORT Reader
+  {
+  public:
+    Reader();
+    /**
+     * Closes the log.
+     */
+    ~Reader();
+
+    /**
+     * Maps *fileName* to memory and reads the list of blocks.
+     * Returns `true` on success and `false` on failure.
+     */
+    bool open(const QString& fileName);
+
+    /**
+     * Releases the memory mapping. Data previously returned by
+     * [data()] stays valid if the mapping was reserved with
+     * PiiMappedFile::reserve().
+     */
+    void close();
+
+    /**
+     * Returns `true` if a log is open.
+     */
+    bool isOpen() const { return _pMappedFile != 0; }
+
+    /**
+     * Returns the columns stored in the log.
+     */
+    QList<Column> columns() const { return _lstColumns; }
+
+    /**
+     * Returns the index of the column called *name*, or -1 if there
+     * is no such column.
+     */
+    int columnIndex(const QString& name) const;
+
+    /**
+     * Returns the total number of rows in the log.
+     */
+    qint64 rowCount() const { return _iRowCount; }
+
+    /**
+     * Returns the number of data blocks in the log.
+     */
+    int blockCount() const { return _vecBlocks.size(); }
+
+    /**
+     * Returns the index of the first row in *block*.
+     */
+    qint64 blockFirstRow(int block) const { return _vecBlocks[block].iFirstRow; }
+
+    /**
+     * Returns the number of rows in *block*.
+     */
+    int blockRowCount(int block) const { return _vecBlocks[block].iRowCount; }
+
+    /**
+     * Returns the index of the block that contains *row*, or -1 if
+     * the row is out of range.
+     */
+    int findBlock(qint64 row) const;
+
+    /**
+     * Returns a pointer to the beginning of the values of *column*
+     * in *block*. The values of consecutive rows are stored
+     * contiguously, `columns()[column].iWidth` values per row.
+     */
+    const char* data(int block, int column) const;
+
+    /**
+     * Returns `true` if the log was closed properly and its index
+     * could be used. If this function returns `false`, the blocks
+     * were found by scanning the file.
+     */
+    bool isComplete() const { return _bComplete; }
+
+    /**
+     * Returns the mapped file. Matrices that refer to the file must
+     * hold a reference to it.
+     */
+    PiiMappedFile* mappedFile() const { return _pMappedFile; }
+
+    /**
+     * Returns a description of the last error.
+     */
+    QString errorString() const { return _strError; }
+
+  private:
+    struct Block
+    {
+      Block(quint64 offset = 0, qint64 firstRow = 0, int rowCount = 0) :
+        iOffset(offset), iFirstRow(firstRow), iRowCount(rowCount)
+      {}
+      quint64 iOffset;
+      qint64 iFirstRow;
+      int iRowCount;
+    };
+
+    bool readHeader();
+    bool readIndex();
+    void scanBlocks();
+    quint64 blockSize(int rowCount) const;
+    bool readBlockHeader(quint64 offset, Block* block) const;
+
+    PiiMappedFile* _pMappedFile;
+    QList<Column> _lstColumns;
+    QVector<Block> _vecBlocks;
+    quint64 _iDataOffset;
+    qint64 _iRowCount;
+    bool _bComplete;
+    QString _strError;
+
+    PII_DISABLE_COPY(Reader);
+  };
+}
+
+#endif //_PIIRESULTLOG_H
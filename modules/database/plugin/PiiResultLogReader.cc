@@ -0,0 +1,214 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiResultLogReader.h"
+
+#include <PiiYdinTypes.h>
+
+PiiResultLogReader::Data::Data() :
+  bBlockMode(false),
+  iFirstRow(0),
+  iCurrentBlock(0),
+  iCurrentRow(0)
+{
+}
+
+PiiResultLogReader::PiiResultLogReader() :
+  PiiDefaultOperation(new Data)
+{
+  setProtectionLevel("fileName", WriteWhenStoppedOrPaused);
+  setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
+  setProtectionLevel("blockMode", WriteWhenStoppedOrPaused);
+  setProtectionLevel("firstRow", WriteWhenStoppedOrPaused);
+}
+
+PiiResultLogReader::~PiiResultLogReader()
+{
+}
+
+void PiiResultLogReader::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  if (outputCount() == 0)
+    PII_THROW(PiiExecutionException, tr("No columns have been selected."));
+
+  if (reset || !d->reader.isOpen())
+    openLog();
+}
+
+void PiiResultLogReader::aboutToChangeState(State state)
+{
+  PII_D;
+  // Emitted matrices keep their own references to the mapping.
+  if (state == Stopped)
+    d->reader.close();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiResultLogReader::openLog()
+{
+  PII_D;
+  if (!d->reader.open(d->strFileName))
+    PII_THROW(PiiExecutionException, d->reader.errorString());
+
+  d->vecColumnIndices.resize(d->lstColumnNames.size());
+  for (int i=0; i<d->lstColumnNames.size(); ++i)
+    {
+      d->vecColumnIndices[i] = d->reader.columnIndex(d->lstColumnNames[i]);
+      if (d->vecColumnIndices[i] == -1)
+        {
+          d->reader.close();
+          PII_THROW(PiiExecutionException,
+                    tr("There is no column called \"%1\" in %2.")
+                    .arg(d->lstColumnNames[i]).arg(d->strFileName));
+        }
+    }
+
+  if (!d->reader.isComplete())
+    piiWarning(tr("%1 was not closed properly. Recovered %2 rows.")
+               .arg(d->strFileName).arg(d->reader.rowCount()));
+
+  d->iCurrentBlock = d->reader.findBlock(d->iFirstRow);
+  if (d->iCurrentBlock == -1)
+    {
+      d->iCurrentBlock = d->reader.blockCount();
+      d->iCurrentRow = 0;
+    }
+  else
+    d->iCurrentRow = d->bBlockMode ? 0 : int(d->iFirstRow - d->reader.blockFirstRow(d->iCurrentBlock));
+}
+
+template <class T> void PiiResultLogReader::emitRows(int output, int column, int row, int rows)
+{
+  PII_D;
+  const int iWidth = d->reader.columns()[column].iWidth;
+  const T* pData = reinterpret_cast<const T*>(d->reader.data(d->iCurrentBlock, column)) + row * iWidth;
+  if (rows == 1 && iWidth == 1 && !d->bBlockMode)
+    emitObject(*pData, output);
+  else
+    emitObject(PiiMatrix<T>(rows, iWidth, pData, d->reader.mappedFile()), output);
+}
+
+void PiiResultLogReader::process()
+{
+  PII_D;
+  if (d->iCurrentBlock >= d->reader.blockCount())
+    operationStopped(); // throws
+
+  const int iBlockRows = d->reader.blockRowCount(d->iCurrentBlock);
+  const int iRows = d->bBlockMode ? iBlockRows - d->iCurrentRow : 1;
+  QList<PiiResultLog::Column> lstColumns(d->reader.columns());
+  for (int i=0; i<d->vecColumnIndices.size(); ++i)
+    {
+      const int iColumn = d->vecColumnIndices[i];
+      switch (lstColumns[iColumn].type)
+        {
+          PII_RESULT_LOG_CASES(emitRows, (i, iColumn, d->iCurrentRow, iRows));
+        }
+    }
+
+  d->iCurrentRow += iRows;
+  if (d->iCurrentRow >= iBlockRows)
+    {
+      ++d->iCurrentBlock;
+      d->iCurrentRow = 0;
+    }
+}
+
+template <class T> void PiiResultLogReader::appendValues(const char* data, int width, int row, int rows,
+                                                         QVariantList* values)
+{
+  const T* pData = reinterpret_cast<const T*>(data) + row * width;
+  for (int r=0; r<rows; ++r, pData += width)
+    {
+      if (width == 1)
+        values->append(double(*pData));
+      else
+        {
+          QVariantList lstRow;
+          for (int c=0; c<width; ++c)
+            lstRow.append(double(pData[c]));
+          values->append(QVariant(lstRow));
+        }
+    }
+}
+
+QVariantList PiiResultLogReader::readColumn(const QString& name, int firstRow, int count) const
+{
+  QVariantList lstValues;
+  PiiResultLog::Reader reader;
+  if (!reader.open(_d()->strFileName))
+    return lstValues;
+  const int iColumn = reader.columnIndex(name);
+  if (iColumn == -1)
+    return lstValues;
+  const PiiResultLog::Column column(reader.columns()[iColumn]);
+
+  qint64 iRemaining = count < 0 ? reader.rowCount() : qint64(count);
+  qint64 iRow = firstRow;
+  for (int b = reader.findBlock(iRow); b != -1 && b < reader.blockCount() && iRemaining > 0; ++b)
+    {
+      const int iStart = int(iRow - reader.blockFirstRow(b));
+      const int iRows = int(qMin(qint64(reader.blockRowCount(b) - iStart), iRemaining));
+      switch (column.type)
+        {
+          PII_RESULT_LOG_CASES(appendValues, (reader.data(b, iColumn), column.iWidth, iStart, iRows, &lstValues));
+        }
+      iRow += iRows;
+      iRemaining -= iRows;
+    }
+  return lstValues;
+}
+
+QStringList PiiResultLogReader::fileColumns() const
+{
+  QStringList lstNames;
+  PiiResultLog::Reader reader;
+  if (reader.open(_d()->strFileName))
+    {
+      QList<PiiResultLog::Column> lstColumns(reader.columns());
+      for (int i=0; i<lstColumns.size(); ++i)
+        lstNames << lstColumns[i].strName;
+    }
+  return lstNames;
+}
+
+PiiOutputSocket* PiiResultLogReader::output(const QString& name) const
+{
+  const PII_D;
+  int index = d->lstColumnNames.indexOf(name);
+  if (index != -1)
+    return outputAt(index);
+  else
+    return PiiDefaultOperation::output(name);
+}
+
+void PiiResultLogReader::setColumnNames(const QStringList& columnNames)
+{
+  PII_D;
+  d->lstColumnNames = columnNames;
+  setNumberedOutputs(d->lstColumnNames.size());
+}
+
+QStringList PiiResultLogReader::columnNames() const { return _d()->lstColumnNames; }
+void PiiResultLogReader::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
+QString PiiResultLogReader::fileName() const { return _d()->strFileName; }
+void PiiResultLogReader::setBlockMode(bool blockMode) { _d()->bBlockMode = blockMode; }
+bool PiiResultLogReader::blockMode() const { return _d()->bBlockMode; }
+void PiiResultLogReader::setFirstRow(qint64 firstRow) { _d()->iFirstRow = qMax(firstRow, qint64(0)); }
+qint64 PiiResultLogReader::firstRow() const { return _d()->iFirstRow; }
+qint64 PiiResultLogReader::rowCount() const { return _d()->reader.rowCount(); }
@@ -0,0 +1,156 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRESULTLOGREADER_H
+#define _PIIRESULTLOGREADER_H
+
+#include <PiiDefaultOperation.h>
+#include <QVariant>
+#include "PiiResultLog.h"
+
+/**
+ * An operation that reads binary result logs written by
+ * PiiResultLogWriter. The log is memory-mapped, and the emitted
+ * matrices refer to the mapped data directly. Reading is limited by
+ * disk throughput only, and pages that are not accessed are never
+ * loaded.
+ *
+ * By default, one row is emitted at a time. A column with one value
+ * per row is emitted as a primitive value of the column's type. A
+ * wider column is emitted as a 1-by-N matrix. If [blockMode] is
+ * enabled, a whole block of rows is emitted at once as an N-by-M
+ * matrix in each output, which is the fastest way of processing a
+ * large log.
+ *
+ * The log can also be read from scripts without running the
+ * operation:
+ *
+ * ~~~
+ * var reader = new PiiResultLogReader({ fileName: "objects.prl" });
+ * var areas = reader.readColumn("areas", 0, 1000);
+ * ~~~
+ *
+ * Outputs
+ * -------
+ *
+ * @out outputX - X ranges from 0 to the number of column names - 1.
+ * The outputs can also be retrieved with the column name using the
+ * [output()] function.
+ *
+ * @see PiiResultLogWriter
+ */
+class PiiResultLogReader : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the log file. A new name takes effect when the
+   * operation is started from scratch.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * The names of the columns to read. When this property is set, an
+   * equivalent number of output sockets will be created. The columns
+   * must exist in the log file.
+   */
+  Q_PROPERTY(QStringList columnNames READ columnNames WRITE setColumnNames);
+
+  /**
+   * If `true`, a whole block of rows is emitted at once. The number
+   * of rows in a block is determined by the settings of the writer.
+   * The default value is `false`.
+   */
+  Q_PROPERTY(bool blockMode READ blockMode WRITE setBlockMode);
+
+  /**
+   * The index of the first row to read. The index blocks of the log
+   * are used to find the row without reading the data before it. In
+   * block mode, reading starts at the beginning of the block that
+   * contains this row. The default value is 0.
+   */
+  Q_PROPERTY(qint64 firstRow READ firstRow WRITE setFirstRow);
+
+  /**
+   * The total number of rows in the currently opened log.
+   */
+  Q_PROPERTY(qint64 rowCount READ rowCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+
+public:
+  PiiResultLogReader();
+  ~PiiResultLogReader();
+
+  PiiOutputSocket* output(const QString& name) const;
+
+  void check(bool reset);
+
+  /**
+   * Returns the names of all columns stored in the file pointed to
+   * by [fileName].
+   */
+  Q_INVOKABLE QStringList fileColumns() const;
+
+  /**
+   * Reads at most *count* values from the column called *name*,
+   * starting at *firstRow*, from the file pointed to by [fileName].
+   * If *count* is negative, reads all rows until the end of the log.
+   * The values are converted to `double`. If the column has more
+   * than one value per row, each row is returned as a list of
+   * values. Returns an empty list if the file or the column cannot
+   * be read.
+   */
+  Q_INVOKABLE QVariantList readColumn(const QString& name, int firstRow = 0, int count = -1) const;
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+  void setColumnNames(const QStringList& columnNames);
+  QStringList columnNames() const;
+  void setBlockMode(bool blockMode);
+  bool blockMode() const;
+  void setFirstRow(qint64 firstRow);
+  qint64 firstRow() const;
+  qint64 rowCount() const;
+
+private:
+  void openLog();
+  template <class T> void emitRows(int output, int column, int row, int rows);
+  template <class T> static void appendValues(const char* data, int width, int row, int rows, QVariantList* values);
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    QString strFileName;
+    QStringList lstColumnNames;
+    bool bBlockMode;
+    qint64 iFirstRow;
+    PiiResultLog::Reader reader;
+    // Indices of emitted columns in the log
+    QVector<int> vecColumnIndices;
+    int iCurrentBlock;
+    int iCurrentRow;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIRESULTLOGREADER_H
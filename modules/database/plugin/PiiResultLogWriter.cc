@@ -0,0 +1,210 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiResultLogWriter.h"
+
+#include <PiiYdinTypes.h>
+#include <cstring>
+
+using namespace PiiYdin;
+
+PiiResultLogWriter::Data::Data() :
+  iBlockSize(4096),
+  iIndexInterval(16)
+{
+}
+
+PiiResultLogWriter::PiiResultLogWriter() :
+  PiiDefaultOperation(new Data)
+{
+  setProtectionLevel("fileName", WriteWhenStoppedOrPaused);
+  setProtectionLevel("columnNames", WriteWhenStoppedOrPaused);
+  setProtectionLevel("blockSize", WriteWhenStoppedOrPaused);
+  setProtectionLevel("indexInterval", WriteWhenStoppedOrPaused);
+}
+
+PiiResultLogWriter::~PiiResultLogWriter()
+{
+  closeLog();
+}
+
+void PiiResultLogWriter::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  if (inputCount() == 0)
+    PII_THROW(PiiExecutionException, tr("No columns have been defined."));
+  if (d->strFileName.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Log file name has not been set."));
+
+  // The file will be created once the column types are known.
+  if (reset)
+    closeLog();
+}
+
+void PiiResultLogWriter::aboutToChangeState(State state)
+{
+  PII_D;
+  if (state == Paused)
+    {
+      if (!d->writer.flush())
+        piiWarning(d->writer.errorString());
+    }
+  else if (state == Stopped)
+    closeLog();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiResultLogWriter::closeLog()
+{
+  PII_D;
+  if (!d->writer.close())
+    piiWarning(d->writer.errorString());
+}
+
+template <class T> void PiiResultLogWriter::primitiveColumn(const PiiVariant&,
+                                                            PiiResultLog::Column* column,
+                                                            int*) const
+{
+  column->type = PiiResultLog::ColumnTypeOf<T>::type;
+  column->iWidth = 1;
+}
+
+template <class T> void PiiResultLogWriter::matrixColumn(const PiiVariant& obj,
+                                                         PiiResultLog::Column* column,
+                                                         int* rows) const
+{
+  const PiiMatrix<T>& matrix = obj.valueAs<PiiMatrix<T> >();
+  column->type = PiiResultLog::ColumnTypeOf<T>::type;
+  column->iWidth = matrix.columns();
+  *rows = matrix.rows();
+}
+
+PiiResultLog::Column PiiResultLogWriter::column(int index, const PiiVariant& obj, int* rows) const
+{
+  PiiResultLog::Column column(_d()->lstColumnNames[index]);
+  switch (obj.type())
+    {
+      PII_PRIMITIVE_CASES_M(primitiveColumn, (obj, &column, rows));
+      PII_NUMERIC_MATRIX_CASES_M(matrixColumn, (obj, &column, rows));
+    default:
+      PII_THROW_UNKNOWN_TYPE(inputAt(index));
+    }
+  return column;
+}
+
+template <class T> void PiiResultLogWriter::copyPrimitive(const PiiVariant& obj, char* buffer, int rows)
+{
+  const T value = obj.valueAs<T>();
+  T* pValues = reinterpret_cast<T*>(buffer);
+  for (int r=0; r<rows; ++r)
+    pValues[r] = value;
+}
+
+template <class T> void PiiResultLogWriter::copyMatrix(const PiiVariant& obj, char* buffer)
+{
+  const PiiMatrix<T>& matrix = obj.valueAs<PiiMatrix<T> >();
+  const std::size_t iRowBytes = matrix.columns() * sizeof(T);
+  // Matrix rows may be padded.
+  for (int r=0; r<matrix.rows(); ++r, buffer += iRowBytes)
+    std::memcpy(buffer, matrix.row(r), iRowBytes);
+}
+
+void PiiResultLogWriter::process()
+{
+  PII_D;
+  const int iColumns = inputCount();
+
+  // Matrices determine the number of rows. Primitive values are
+  // repeated on each.
+  QList<PiiResultLog::Column> lstColumns;
+  int iRows = -1;
+  for (int i=0; i<iColumns; ++i)
+    {
+      int iMatrixRows = -1;
+      lstColumns << column(i, inputAt(i)->firstObject(), &iMatrixRows);
+      if (iMatrixRows >= 0)
+        {
+          if (iRows >= 0 && iMatrixRows != iRows)
+            PII_THROW(PiiExecutionException,
+                      tr("All matrices must have the same number of rows. "
+                         "Input \"%1\" received %2 rows, expected %3.")
+                      .arg(d->lstColumnNames[i]).arg(iMatrixRows).arg(iRows));
+          iRows = iMatrixRows;
+        }
+    }
+  if (iRows < 0)
+    iRows = 1;
+  else if (iRows == 0)
+    return;
+
+  if (!d->writer.isOpen())
+    {
+      if (!d->writer.open(d->strFileName, lstColumns, d->iBlockSize, d->iIndexInterval))
+        PII_THROW(PiiExecutionException, d->writer.errorString());
+    }
+  else
+    {
+      QList<PiiResultLog::Column> lstLogColumns(d->writer.columns());
+      for (int i=0; i<iColumns; ++i)
+        if (!(lstColumns[i] == lstLogColumns[i]))
+          PII_THROW(PiiExecutionException,
+                    tr("Input \"%1\" received data of different type or width than before. "
+                       "Expected %2 values of type %3, got %4 values of type %5.")
+                    .arg(d->lstColumnNames[i])
+                    .arg(lstLogColumns[i].iWidth).arg(int(lstLogColumns[i].type))
+                    .arg(lstColumns[i].iWidth).arg(int(lstColumns[i].type)));
+    }
+
+  for (int i=0; i<iColumns; ++i)
+    {
+      PiiVariant obj = inputAt(i)->firstObject();
+      char* pBuffer = d->writer.reserveRows(i, iRows);
+      switch (obj.type())
+        {
+          PII_PRIMITIVE_CASES_M(copyPrimitive, (obj, pBuffer, iRows));
+          PII_NUMERIC_MATRIX_CASES_M(copyMatrix, (obj, pBuffer));
+        }
+    }
+  if (!d->writer.commitRows(iRows))
+    PII_THROW(PiiExecutionException, d->writer.errorString());
+}
+
+PiiInputSocket* PiiResultLogWriter::input(const QString& name) const
+{
+  const PII_D;
+  int index = d->lstColumnNames.indexOf(name);
+  if (index != -1)
+    return inputAt(index);
+  else
+    return PiiDefaultOperation::input(name);
+}
+
+void PiiResultLogWriter::setColumnNames(const QStringList& columnNames)
+{
+  PII_D;
+  d->lstColumnNames = columnNames;
+  setNumberedInputs(d->lstColumnNames.size());
+}
+
+QStringList PiiResultLogWriter::columnNames() const { return _d()->lstColumnNames; }
+void PiiResultLogWriter::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
+QString PiiResultLogWriter::fileName() const { return _d()->strFileName; }
+void PiiResultLogWriter::setBlockSize(int blockSize) { _d()->iBlockSize = qMax(blockSize, 1); }
+int PiiResultLogWriter::blockSize() const { return _d()->iBlockSize; }
+void PiiResultLogWriter::setIndexInterval(int indexInterval) { _d()->iIndexInterval = qMax(indexInterval, 1); }
+int PiiResultLogWriter::indexInterval() const { return _d()->iIndexInterval; }
+qint64 PiiResultLogWriter::rowCount() const { return _d()->writer.rowCount(); }
@@ -0,0 +1,148 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRESULTLOGWRITER_H
+#define _PIIRESULTLOGWRITER_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiResultLog.h"
+
+/**
+ * An operation that stores measurement results into a binary result
+ * log (see PiiResultLog). The result log is a light-weight
+ * alternative to PiiDatabaseWriter for high data rates: values are
+ * stored in their native binary representation, rows are collected
+ * into blocks in memory, and file system calls are made only once per
+ * block. The CPU cost of storing a row is essentially that of
+ * copying its values.
+ *
+ * The operation has a user-configurable number of inputs, one for
+ * each column. An input accepts any primitive type or a numeric
+ * matrix. A primitive value is stored as a single value on one row.
+ * Each row of an N-by-M matrix becomes a row in the log with M
+ * values in the corresponding column. For example, the matrices
+ * emitted by PiiObjectPropertyExtractor fill in one row for each
+ * detected object. All matrices received at once must have the same
+ * number of rows. Primitive values received together with matrices
+ * are repeated on each row, which makes it possible to mark the
+ * objects with a frame index or a time stamp.
+ *
+ * The type and the width of each column are determined by the
+ * objects received first. The log file is created at that point.
+ * Later objects must be of the same type and width. An existing
+ * file is overwritten.
+ *
+ * Inputs
+ * ------
+ *
+ * @in inputX - input sockets. X is a zero-based index. Inputs can
+ * also be accessed with the names given by the [columnNames]
+ * property.
+ *
+ * ~~~(c++)
+ * PiiOperation* pWriter = engine.createOperation("PiiResultLogWriter");
+ * pWriter->setProperty("fileName", "objects.prl");
+ * pWriter->setProperty("columnNames", QStringList() << "frame" << "areas" << "boxes");
+ * pIndexOutput->connectInput(pWriter->input("frame"));
+ * pExtractor->output("areas")->connectInput(pWriter->input("areas"));
+ * pExtractor->output("boundingBoxes")->connectInput(pWriter->input("boxes"));
+ * ~~~
+ *
+ * @see PiiResultLogReader
+ */
+class PiiResultLogWriter : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the log file. A new name takes effect when the
+   * operation is started from scratch.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * Column names. When this property is set, an equivalent number of
+   * input sockets will be created.
+   */
+  Q_PROPERTY(QStringList columnNames READ columnNames WRITE setColumnNames);
+
+  /**
+   * The number of rows buffered in memory before they are written
+   * to the file as a block. Larger blocks mean fewer system calls.
+   * Buffered rows are also written when the operation is paused or
+   * stopped. The default value is 4096.
+   */
+  Q_PROPERTY(int blockSize READ blockSize WRITE setBlockSize);
+
+  /**
+   * The number of data blocks between index blocks. The index makes
+   * it possible to find all blocks without reading the whole file.
+   * The default value is 16.
+   */
+  Q_PROPERTY(int indexInterval READ indexInterval WRITE setIndexInterval);
+
+  /**
+   * The number of rows written to the current log.
+   */
+  Q_PROPERTY(qint64 rowCount READ rowCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+
+public:
+  PiiResultLogWriter();
+  ~PiiResultLogWriter();
+
+  PiiInputSocket* input(const QString& name) const;
+
+  void check(bool reset);
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+  void setColumnNames(const QStringList& columnNames);
+  QStringList columnNames() const;
+  void setBlockSize(int blockSize);
+  int blockSize() const;
+  void setIndexInterval(int indexInterval);
+  int indexInterval() const;
+  qint64 rowCount() const;
+
+private:
+  void closeLog();
+  PiiResultLog::Column column(int index, const PiiVariant& obj, int* rows) const;
+  template <class T> void primitiveColumn(const PiiVariant& obj, PiiResultLog::Column* column, int* rows) const;
+  template <class T> void matrixColumn(const PiiVariant& obj, PiiResultLog::Column* column, int* rows) const;
+  template <class T> void copyPrimitive(const PiiVariant& obj, char* buffer, int rows);
+  template <class T> void copyMatrix(const PiiVariant& obj, char* buffer);
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    QString strFileName;
+    QStringList lstColumnNames;
+    int iBlockSize;
+    int iIndexInterval;
+    PiiResultLog::Writer writer;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIRESULTLOGWRITER_H
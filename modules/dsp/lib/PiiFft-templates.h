@@ -21,9 +21,10 @@
 #endif
 
 #include <cmath>
+#include <PiiInvalidArgumentException.h>
+#include <QCoreApplication>
 
-template <class T> PiiFft<T>::PiiFft() : _trig(new std::complex<T>[37]), _twiddle(new std::complex<T>[37]), _z(new std::complex<T>[37]),
-                                         _count(0), _factorCount(0), _prevPrimeRadix(37)
+template <class T> PiiFft<T>::PiiFft()
 {
   _pi  = T(4*std::atan(1.0));
   c3_1 = T(std::cos(2*_pi/3)-1);
@@ -35,423 +36,652 @@ template <class T> PiiFft<T>::PiiFft() : _trig(new std::complex<T>[37]), _twiddl
   c5_4 = T(-(std::sin(u5)+std::sin(2*u5)));
   c5_5 = T((std::sin(u5)-std::sin(2*u5)));
   c8   = T(1/std::sqrt(2.0));
+}
+
+template <class T> PiiFft<T>::~PiiFft()
+{
+  for (int i=0; i<_vecPlans.size(); ++i)
+    delete _vecPlans[i];
+}
 
-  for ( int i=0; i<20; i++ )
+template <class T> PiiFft<T>::Workspace::Workspace(const Plan* plan, int bufferSize) :
+  vecZ(qMax(10, plan->iMaxRadix)),
+  vecBuffer1(bufferSize),
+  vecBuffer2(bufferSize)
+{
+  if (isPrimeFactor(plan->iMaxRadix))
     {
-      _actualRadix[i] = 0;
-      _sofarRadix[i] = 0;
-      _remainRadix[i] = 0;
+      vecV.resize((plan->iMaxRadix+1)/2);
+      vecW.resize((plan->iMaxRadix+1)/2);
     }
 }
 
-template <class T> PiiFft<T>::~PiiFft()
+template <class T>
+template <class S> class PiiFft<T>::ForwardRowFunction
 {
-  delete[] _trig;
-  delete[] _twiddle;
-  delete[] _z;
-}
+public:
+  ForwardRowFunction(const PiiFft* fft, const Plan* plan,
+                     const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result) :
+    _pFft(fft), _pPlan(plan), _source(source), _result(result)
+  {}
+
+  void operator() (int firstRow, int endRow)
+  {
+    Workspace workspace(_pPlan, 0);
+    for (int r=firstRow; r<endRow; ++r)
+      _pFft->forward1d(_pPlan, _source.row(r), _result.row(r), workspace);
+  }
+
+private:
+  const PiiFft* _pFft;
+  const Plan* _pPlan;
+  const PiiMatrix<S>& _source;
+  PiiMatrix<std::complex<T> >& _result;
+};
 
 template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source)
+template <class S> class PiiFft<T>::InverseRowFunction
+{
+public:
+  InverseRowFunction(const PiiFft* fft, const Plan* plan,
+                     const PiiMatrix<std::complex<S> >& source, PiiMatrix<std::complex<T> >& result) :
+    _pFft(fft), _pPlan(plan), _source(source), _result(result)
+  {}
+
+  void operator() (int firstRow, int endRow)
+  {
+    Workspace workspace(_pPlan, 0);
+    for (int r=firstRow; r<endRow; ++r)
+      _pFft->inverse1d(_pPlan, _source.row(r), _result.row(r), workspace);
+  }
+
+private:
+  const PiiFft* _pFft;
+  const Plan* _pPlan;
+  const PiiMatrix<std::complex<S> >& _source;
+  PiiMatrix<std::complex<T> >& _result;
+};
+
+/* Transforms pairs of real rows. The strips are counted in pairs so
+   that the result doesn't depend on the number of threads.
+
+   Two real rows a and b are transformed at once as z = a + ib. Since
+   the transforms of a and b are conjugate symmetric, they can be
+   separated from Z:
+
+   A(k) = (Z(k) + Z*(n-k)) / 2
+   B(k) = (Z(k) - Z*(n-k)) / 2i
+*/
+template <class T>
+template <class S> class PiiFft<T>::RealRowFunction
 {
-  int cols = source.columns();
-  int rows = source.rows();
+public:
+  RealRowFunction(const PiiFft* fft, const Plan* plan,
+                  const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result) :
+    _pFft(fft), _pPlan(plan), _source(source), _result(result)
+  {}
+
+  void operator() (int firstPair, int endPair)
+  {
+    const int iCols = _source.columns(), iHalfCols = _result.columns();
+    const int iEndRow = qMin(endPair*2, _source.rows());
+    const int* pOrder = _pPlan->vecOrder.constData();
+    Workspace workspace(_pPlan, iCols);
+    std::complex<T>* pZ = workspace.vecBuffer1.data();
+    const T half(0.5);
+
+    int r = firstPair*2;
+    for (; r+1<iEndRow; r+=2)
+      {
+        const S *pA = _source.row(r), *pB = _source.row(r+1);
+        for (int i=0; i<iCols; ++i)
+          pZ[i] = std::complex<T>(T(pA[pOrder[i]]), T(pB[pOrder[i]]));
+        _pFft->synthesizeFft(_pPlan, pZ, workspace);
+
+        std::complex<T> *pResultA = _result.row(r), *pResultB = _result.row(r+1);
+        for (int k=0; k<iHalfCols; ++k)
+          {
+            std::complex<T> z(pZ[k]), mirror(std::conj(pZ[k == 0 ? 0 : iCols - k]));
+            std::complex<T> diff(z - mirror);
+            pResultA[k] = (z + mirror) * half;
+            pResultB[k] = std::complex<T>(diff.imag() * half, -diff.real() * half);
+          }
+      }
+    if (r < iEndRow)
+      {
+        _pFft->forward1d(_pPlan, _source.row(r), pZ, workspace);
+        std::complex<T>* pResult = _result.row(r);
+        for (int k=0; k<iHalfCols; ++k)
+          pResult[k] = pZ[k];
+      }
+  }
+
+private:
+  const PiiFft* _pFft;
+  const Plan* _pPlan;
+  const PiiMatrix<S>& _source;
+  PiiMatrix<std::complex<T> >& _result;
+};
+
+/* Two rows are again transformed at once: Z = A + iB. The redundant
+   half of A and B is restored by symmetry. The imaginary parts of the
+   terms that are their own conjugates (DC and the Nyquist frequency)
+   are ignored.
+*/
+template <class T> class PiiFft<T>::InverseRealRowFunction
+{
+public:
+  InverseRealRowFunction(const PiiFft* fft, const Plan* plan,
+                         const PiiMatrix<std::complex<T> >& source, PiiMatrix<T>& result) :
+    _pFft(fft), _pPlan(plan), _source(source), _result(result)
+  {}
+
+  void operator() (int firstPair, int endPair)
+  {
+    const int iCols = _result.columns(), iHalfCols = _source.columns();
+    const int iSelfConjugate = iCols % 2 == 0 ? iCols/2 : 0;
+    const int iEndRow = qMin(endPair*2, _source.rows());
+    Workspace workspace(_pPlan, iCols);
+    std::complex<T> *pZ = workspace.vecBuffer1.data(), *pz = workspace.vecBuffer2.data();
+
+    int r = firstPair*2;
+    for (; r+1<iEndRow; r+=2)
+      {
+        const std::complex<T> *pA = _source.row(r), *pB = _source.row(r+1);
+        pZ[0] = std::complex<T>(pA[0].real(), pB[0].real());
+        for (int k=1; k<iHalfCols; ++k)
+          pZ[k] = std::complex<T>(pA[k].real() - pB[k].imag(), pA[k].imag() + pB[k].real());
+        if (iSelfConjugate != 0)
+          pZ[iSelfConjugate] = std::complex<T>(pA[iSelfConjugate].real(), pB[iSelfConjugate].real());
+        for (int k=iHalfCols; k<iCols; ++k)
+          {
+            const std::complex<T> &a = pA[iCols - k], &b = pB[iCols - k];
+            pZ[k] = std::complex<T>(a.real() + b.imag(), b.real() - a.imag());
+          }
+        _pFft->inverse1d(_pPlan, pZ, pz, workspace);
 
-  PiiMatrix<std::complex<T> > result(rows, cols);
+        T *pResultA = _result.row(r), *pResultB = _result.row(r+1);
+        for (int i=0; i<iCols; ++i)
+          {
+            pResultA[i] = pz[i].real();
+            pResultB[i] = pz[i].imag();
+          }
+      }
+    if (r < iEndRow)
+      {
+        const std::complex<T>* pA = _source.row(r);
+        for (int k=0; k<iHalfCols; ++k)
+          pZ[k] = pA[k];
+        for (int k=iHalfCols; k<iCols; ++k)
+          pZ[k] = std::conj(pA[iCols - k]);
+        _pFft->inverse1d(_pPlan, pZ, pz, workspace);
+
+        T* pResult = _result.row(r);
+        for (int i=0; i<iCols; ++i)
+          pResult[i] = pz[i].real();
+      }
+  }
+
+private:
+  const PiiFft* _pFft;
+  const Plan* _pPlan;
+  const PiiMatrix<std::complex<T> >& _source;
+  PiiMatrix<T>& _result;
+};
+
+/* Transforms blocks of ColumnBlockSize columns. Reading the input in
+   reordered sequence and transposing the block to contiguous memory
+   are done in one pass, row by row. The transformed columns are
+   transposed back the same way.
+*/
+template <class T> class PiiFft<T>::ColumnFunction
+{
+public:
+  ColumnFunction(const PiiFft* fft, const Plan* plan,
+                 PiiMatrix<std::complex<T> >& matrix, bool inverse) :
+    _pFft(fft), _pPlan(plan), _matrix(matrix), _bInverse(inverse)
+  {}
+
+  void operator() (int firstColumn, int endColumn)
+  {
+    const int iRows = _matrix.rows();
+    const int* pOrder = _pPlan->vecOrder.constData();
+    Workspace workspace(_pPlan, ColumnBlockSize * iRows);
+    std::complex<T>* pBlock = workspace.vecBuffer1.data();
+    const T s = T(1.0 / iRows);
+
+    for (int c0=firstColumn; c0<endColumn; c0 += ColumnBlockSize)
+      {
+        const int iWidth = qMin(int(ColumnBlockSize), endColumn - c0);
+        for (int i=0; i<iRows; ++i)
+          {
+            const std::complex<T>* pRow = _matrix.row(pOrder[i]) + c0;
+            if (_bInverse)
+              for (int j=0; j<iWidth; ++j)
+                pBlock[j*iRows + i] = std::conj(pRow[j]);
+            else
+              for (int j=0; j<iWidth; ++j)
+                pBlock[j*iRows + i] = pRow[j];
+          }
 
-  if ( cols > 1 )
-    {
-      for ( int r=0; r<rows; r++ )
-        {
-          if (!forward1d<S>(source.row(r), result.row(r), cols) )
-            return PiiMatrix<std::complex<T> >(1,1);
-        }
-    }
-  else
-    result = source;
+        for (int j=0; j<iWidth; ++j)
+          _pFft->synthesizeFft(_pPlan, pBlock + j*iRows, workspace);
 
-  if ( rows > 1 )
-    {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
+        for (int r=0; r<iRows; ++r)
+          {
+            std::complex<T>* pRow = _matrix.row(r) + c0;
+            if (_bInverse)
+              for (int j=0; j<iWidth; ++j)
+                pRow[j] = s * std::conj(pBlock[j*iRows + r]);
+            else
+              for (int j=0; j<iWidth; ++j)
+                pRow[j] = pBlock[j*iRows + r];
+          }
+      }
+  }
+
+private:
+  const PiiFft* _pFft;
+  const Plan* _pPlan;
+  PiiMatrix<std::complex<T> >& _matrix;
+  bool _bInverse;
+};
+
+/* Fills in the redundant half of a real signal's spectrum. The
+   spectrum is conjugate symmetric: F(r,c) = F*(-r,-c)
+*/
+template <class T> class PiiFft<T>::SymmetryFunction
+{
+public:
+  SymmetryFunction(const PiiMatrix<std::complex<T> >& half, PiiMatrix<std::complex<T> >& result) :
+    _half(half), _result(result)
+  {}
+
+  void operator() (int firstRow, int endRow)
+  {
+    const int iRows = _result.rows(), iCols = _result.columns(), iHalfCols = _half.columns();
+    for (int r=firstRow; r<endRow; ++r)
+      {
+        const std::complex<T>* pHalfRow = _half.row(r);
+        const std::complex<T>* pMirrorRow = _half.row(r == 0 ? 0 : iRows - r);
+        std::complex<T>* pRow = _result.row(r);
+        for (int c=0; c<iHalfCols; ++c)
+          pRow[c] = pHalfRow[c];
+        for (int c=iHalfCols; c<iCols; ++c)
+          pRow[c] = std::conj(pMirrorRow[iCols - c]);
+      }
+  }
+
+private:
+  const PiiMatrix<std::complex<T> >& _half;
+  PiiMatrix<std::complex<T> >& _result;
+};
 
-      for ( int c=0; c<cols; c++ )
-        {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source,
+                                                                     const PiiParallelPolicy& policy)
+{
+  return forwardComplex(source, policy, Pii::IsComplex<S>());
+}
 
-          if ( !forward1d<std::complex<T> >(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
-        }
-    }
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardComplex(const PiiMatrix<S>& source,
+                                                                         const PiiParallelPolicy& policy,
+                                                                         Pii::True)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols));
+  if (iRows == 0 || iCols == 0)
+    return result;
+
+  ForwardRowFunction<S> rowFunction(this, plan(iCols), source, result);
+  Pii::forEachStrip(iRows, rowFunction, policy);
+
+  transformColumns(result, false, policy);
   return result;
 }
 
-template <class T> void PiiFft<T>::reallocateBuffers(int len)
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardComplex(const PiiMatrix<S>& source,
+                                                                         const PiiParallelPolicy& policy,
+                                                                         Pii::False)
 {
-  _tempSource.resize(1,len);
-  _tempResult.resize(1,len);
+  PiiMatrix<std::complex<T> > matHalf(forwardRealFft(source, policy));
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(source.rows(), source.columns()));
+  SymmetryFunction symmetryFunction(matHalf, result);
+  Pii::forEachStrip(source.rows(), symmetryFunction, policy);
+  return result;
 }
 
 template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source)
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRealFft(const PiiMatrix<S>& source,
+                                                                         const PiiParallelPolicy& policy)
 {
-  int cols = source.columns();
-  int rows = source.rows();
+  const int iRows = source.rows(), iCols = source.columns();
+  if (iRows == 0 || iCols == 0)
+    return PiiMatrix<std::complex<T> >(iRows, iCols);
 
-  PiiMatrix<std::complex<T> > result(rows, cols);
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols/2 + 1));
+  RealRowFunction<S> rowFunction(this, plan(iCols), source, result);
+  Pii::forEachStrip((iRows + 1) / 2, rowFunction, policy);
 
-  if ( cols > 1 )
-    {
-      for ( int r=0; r<rows; r++ )
-        {
-          if (!inverse1d<S>(source.row(r), result.row(r), cols))
-            return PiiMatrix<std::complex<T> >(1,1);
-        }
-    }
-  else
-    result = source;
-
-  if ( rows > 1 )
-    {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
+  transformColumns(result, false, policy);
+  return result;
+}
 
-      for ( int c=0; c<cols; c++ )
-        {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source,
+                                                                     const PiiParallelPolicy& policy)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols));
+  if (iRows == 0 || iCols == 0)
+    return result;
 
-          if ( !inverse1d<T>(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
-        }
-    }
+  InverseRowFunction<S> rowFunction(this, plan(iCols), source, result);
+  Pii::forEachStrip(iRows, rowFunction, policy);
 
+  transformColumns(result, true, policy);
   return result;
 }
 
-
 template <class T>
-template <class S> bool PiiFft<T>::forward1d(const S* source, std::complex<T>* destination, int count)
+template <class S> PiiMatrix<T> PiiFft<T>::inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns,
+                                                          const PiiParallelPolicy& policy)
 {
-  if (count == 0)
-    return false;
-
-  if (_count != count)
+  const int iRows = source.rows(), iHalfCols = columns/2 + 1;
+  if (columns < 0 || (source.columns() != iHalfCols && (iRows != 0 || source.columns() != 0)))
+    PII_THROW(PiiInvalidArgumentException,
+              QCoreApplication::translate("PiiFft", "A spectrum with %1 columns cannot be transformed to %2 columns.")
+              .arg(source.columns()).arg(columns));
+  if (iRows == 0 || columns == 0)
+    return PiiMatrix<T>(iRows, columns);
+
+  PiiMatrix<std::complex<T> > matHalf(PiiMatrix<std::complex<T> >::uninitialized(iRows, iHalfCols));
+  for (int r=0; r<iRows; ++r)
     {
-      factorize(count);
-      _count = count;
+      const std::complex<S>* pSource = source.row(r);
+      std::complex<T>* pHalf = matHalf.row(r);
+      for (int c=0; c<iHalfCols; ++c)
+        pHalf[c] = pSource[c];
     }
+  // After this, each row is the conjugate symmetric spectrum of a
+  // real row.
+  transformColumns(matHalf, true, policy);
 
-  _remainRadix[0] = _count;
-  _sofarRadix[1] = 1;
-  _remainRadix[1] = _count / _actualRadix[1];
-  for ( int i = 2; i<=_factorCount; i++ )
-    {
-      _sofarRadix[i]  = _sofarRadix[i-1] * _actualRadix[i-1];
-      _remainRadix[i] = _remainRadix[i-1] / _actualRadix[i];
-    }
-
-  reorderSeries(source, destination);
-
-  for ( int i=1; i<=_factorCount; i++)
-    synthesizeFft(_sofarRadix[i], _actualRadix[i], _remainRadix[i], destination);
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, columns));
+  InverseRealRowFunction rowFunction(this, plan(columns), matHalf, result);
+  Pii::forEachStrip((iRows + 1) / 2, rowFunction, policy);
+  return result;
+}
 
-  return true;
+template <class T> void PiiFft<T>::transformColumns(PiiMatrix<std::complex<T> >& matrix, bool inverse,
+                                                    const PiiParallelPolicy& policy)
+{
+  if (matrix.rows() <= 1)
+    return;
 
+  ColumnFunction columnFunction(this, plan(matrix.rows()), matrix, inverse);
+  Pii::forEachStrip(matrix.columns(), columnFunction, policy);
 }
 
 template <class T>
-template <class S> bool PiiFft<T>::inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count)
+template <class S> void PiiFft<T>::forward1d(const Plan* plan, const S* source, std::complex<T>* destination,
+                                             Workspace& workspace) const
 {
-  S s;
-
-  if ( count == 0 )
-    return false;
-
-  std::complex<S> *tmpPtr = new std::complex<S>[count];
+  const int* pOrder = plan->vecOrder.constData();
+  for (int i=0; i<plan->iCount; ++i)
+    destination[i] = source[pOrder[i]];
 
-  for ( int i=count; i--; )
-    tmpPtr[i] = std::complex<S>(source[i].real(), -source[i].imag());
-
-  forward1d(tmpPtr, destination, count);
+  synthesizeFft(plan, destination, workspace);
+}
 
-  s = 1.0 / count;
-  for ( int i=count; i--; )
-    {
-      destination[i] = (T)s * std::conj(destination[i]);
-      //destination[i].real() =  s * destination[i].real();
-      //destination[i].imag() = -s * destination[i].imag();
-    }
+template <class T>
+template <class S> void PiiFft<T>::inverse1d(const Plan* plan, const std::complex<S>* source, std::complex<T>* destination,
+                                             Workspace& workspace) const
+{
+  // F^-1(x) = F(x*)* / n
+  const int* pOrder = plan->vecOrder.constData();
+  for (int i=0; i<plan->iCount; ++i)
+    destination[i] = std::conj(source[pOrder[i]]);
 
-  delete[] tmpPtr;
+  synthesizeFft(plan, destination, workspace);
 
-  return true;
+  const T s = T(1.0 / plan->iCount);
+  for (int i=plan->iCount; i--; )
+    destination[i] = s * std::conj(destination[i]);
 }
 
 
 /********** PRIVATE FUNCTIONS **********/
 
-/**
- * Reorder the series in X to a permuted sequence in Y so that the later step can
- * be done in place, and the final Fft result is in correct order.
- * The series X and Y must be different series!
- */
-template <class T>
-template <class S> void PiiFft<T>::reorderSeries(const S* source, std::complex<T>* dest)
+template <class T> const typename PiiFft<T>::Plan* PiiFft<T>::plan(int count)
 {
-  int i,j,k;
-  int *counts = new int[_factorCount+1];
-
-  for (i=1; i<=_factorCount; i++)
-    counts[i]=0;
+  for (int i=0; i<_vecPlans.size(); ++i)
+    if (_vecPlans[i]->iCount == count)
+      return _vecPlans[i];
+  Plan* pPlan = createPlan(count);
+  _vecPlans.append(pPlan);
+  return pPlan;
+}
 
-  k=0;
+template <class T> typename PiiFft<T>::Plan* PiiFft<T>::createPlan(int count)
+{
+  Plan* pPlan = new Plan;
+  pPlan->iCount = count;
+  pPlan->iMaxRadix = 1;
+
+  QVector<int> vecRadices(factorize(count));
+  const int iFactorCount = vecRadices.size();
+  int iSofar = 1, iRemain = count;
+  for (int i=0; i<iFactorCount; ++i)
+    {
+      Stage stage;
+      stage.iRadix = vecRadices[i];
+      stage.iSofar = iSofar;
+      stage.iRemain = iRemain /= stage.iRadix;
+      stage.iTwiddleOffset = pPlan->vecTwiddles.size();
+      stage.iTrigOffset = -1;
+      pPlan->iMaxRadix = qMax(pPlan->iMaxRadix, stage.iRadix);
+
+      // twiddle(b,d) = exp(-2 pi i bd / (sofar radix))
+      const double dOmega = -2 * M_PI / (iSofar * stage.iRadix);
+      for (int b=0; b<stage.iRadix; ++b)
+        for (int d=0; d<iSofar; ++d)
+          pPlan->vecTwiddles.append(std::complex<T>(std::polar(1.0, dOmega * b * d)));
+
+      if (isPrimeFactor(stage.iRadix))
+        {
+          stage.iTrigOffset = pPlan->vecTwiddles.size();
+          for (int j=0; j<stage.iRadix; ++j)
+            pPlan->vecTwiddles.append(std::complex<T>(std::polar(1.0, -2 * M_PI * j / stage.iRadix)));
+        }
+      pPlan->vecStages.append(stage);
+      iSofar *= stage.iRadix;
+    }
 
-  for (i=0; i<=_count-2; i++)
+  /* Reorder the input so that the stages can be done in place, and
+     the final FFT result is in correct order. The input index is a
+     mixed-radix counter: moving to the next output element adds
+     remain[1] to it, with a carry whenever a digit overflows.
+   */
+  pPlan->vecOrder.resize(count);
+  QVector<int> vecCounts(iFactorCount + 2, 0);
+  QVector<int> vecRemain(iFactorCount + 2, 0);
+  vecRemain[0] = count;
+  for (int i=0; i<iFactorCount; ++i)
+    vecRemain[i+1] = pPlan->vecStages[i].iRemain;
+
+  int k = 0;
+  for (int i=0; i<count-1; ++i)
     {
-      dest[i] = source[k];
-      j = 1;
-      k = k + _remainRadix[j];
-      counts[1]++;
-      while (counts[j] >= _actualRadix[j])
+      pPlan->vecOrder[i] = k;
+      int j = 1;
+      k += vecRemain[j];
+      ++vecCounts[1];
+      while (vecCounts[j] >= vecRadices[j-1])
         {
-          counts[j] = 0;
-          k = k - _remainRadix[j-1] + _remainRadix[j+1];
-          j = j + 1;
-          counts[j] = counts[j] + 1;
+          vecCounts[j] = 0;
+          k = k - vecRemain[j-1] + vecRemain[j+1];
+          ++j;
+          ++vecCounts[j];
         }
     }
+  if (count > 0)
+    pPlan->vecOrder[count-1] = count-1;
 
-  dest[_count-1] = source[_count-1];
-  delete[] counts;
+  return pPlan;
 }
 
-
-template <class T> void PiiFft<T>::factorize(int count)
+template <class T> QVector<int> PiiFft<T>::factorize(int count)
 {
-  int i = 0, k;
-  int factors[20];
+  QVector<int> vecFactors;
   const int iRadixCount = 6;
   const int iRadices[7] = {0,2,3,4,5,8,10};
 
-  if ( count == 1 )
-    {
-      _factorCount = 1;
-      factors[1] = 1;
-    }
-  else
-    _factorCount = 0;
-
-
   // Factorise the original series length Count into known factors and rest value
-  i = iRadixCount;
-  while(count > 1 && i > 0)
+  int i = iRadixCount;
+  while (count > 1 && i > 0)
     {
-      if ( count % iRadices[i] == 0 )
+      if (count % iRadices[i] == 0)
         {
           count = count / iRadices[i];
-          _factorCount++;
-          factors[_factorCount] = iRadices[i];
+          vecFactors.append(iRadices[i]);
         }
       else
         i--;
     }
 
   // substitute factors 2*8 with more optimal 4*4
-  if ( factors[_factorCount] == 2 )
+  if (!vecFactors.isEmpty() && vecFactors.last() == 2)
     {
-      i = _factorCount - 1;
-      while( i > 0 && factors[i] != 8 )
+      i = vecFactors.size() - 2;
+      while (i >= 0 && vecFactors[i] != 8)
         i--;
 
-      if ( i > 0 )
+      if (i >= 0)
         {
-          factors[_factorCount] = 4;
-          factors[i] = 4;
+          vecFactors.last() = 4;
+          vecFactors[i] = 4;
         }
     }
 
   // Analyse the rest value and see if it can be factored in primes
-  if ( count > 1 )
+  if (count > 1)
     {
-      for ( k = 2; k<std::sqrt((double)count)+1; k++ )
+      for (int k = 2; k<std::sqrt((double)count)+1; k++)
         {
           while (count % k == 0)
             {
               count = count / k;
-              _factorCount++;
-              factors[_factorCount] = k;
+              vecFactors.append(k);
             }
         }
 
-      if ( count > 1)
-        {
-          _factorCount++;
-          factors[_factorCount] = count;
-        }
+      if (count > 1)
+        vecFactors.append(count);
     }
 
-  _actualRadix[0] = 0;
-  for ( i=1; i<=_factorCount; i++ )
-    _actualRadix[i] = factors[_factorCount - i + 1];
-
+  // The stages are run in reverse order
+  QVector<int> vecRadices;
+  for (i=vecFactors.size(); i--; )
+    vecRadices.append(vecFactors[i]);
+  return vecRadices;
 }
 
-template <class T> void PiiFft<T>::synthesizeFft(int sofarRadix, int radix, int remainRadix, std::complex<T>* dest)
+template <class T> void PiiFft<T>::synthesizeFft(const Plan* plan, std::complex<T>* dest, Workspace& workspace) const
 {
-  T omega = 2 * _pi/(T)(sofarRadix*radix);
-  std::complex<T> cosSin(std::cos(omega), -std::sin(omega));
-  std::complex<T> S(1,0);
+  for (int i=0; i<plan->vecStages.size(); ++i)
+    synthesizeStage(plan, plan->vecStages[i], dest, workspace);
+}
 
-  int groupOffset, dataOffset, adr;
-  int groupNo, dataNo, blockNo, twNo;
+template <class T> void PiiFft<T>::synthesizeStage(const Plan* plan, const Stage& stage, std::complex<T>* dest,
+                                                   Workspace& workspace) const
+{
+  const int iSofar = stage.iSofar, iRadix = stage.iRadix;
+  const std::complex<T>* pTwiddles = plan->vecTwiddles.constData() + stage.iTwiddleOffset;
 
-  if ( isPrimeFactor(radix) )
-    initializeTrigonomials(radix);
+  if (PiiDsp::FftKernel<T>::runStage(iRadix, iSofar, stage.iRemain, pTwiddles, dest))
+    return;
 
-  dataOffset = 0;
-  groupOffset = dataOffset;
-  adr = groupOffset;
+  const std::complex<T>* pTrig = stage.iTrigOffset >= 0 ? plan->vecTwiddles.constData() + stage.iTrigOffset : 0;
+  std::complex<T>* z = workspace.vecZ.data();
 
-  for (dataNo=0; dataNo<sofarRadix; dataNo++)
+  for (int groupNo=0; groupNo<stage.iRemain; ++groupNo, dest += iSofar * iRadix)
     {
-      if (sofarRadix>1)
+      for (int dataNo=0; dataNo<iSofar; ++dataNo)
         {
-          _twiddle[0] = std::complex<T>(1.0,0.0);
-          _twiddle[1] = S;
+          std::complex<T>* pData = dest + dataNo;
+          z[0] = pData[0];
+          if (dataNo > 0)
+            {
+              for (int blockNo=1; blockNo<iRadix; ++blockNo)
+                z[blockNo] = pTwiddles[blockNo*iSofar + dataNo] * pData[blockNo*iSofar];
+            }
+          else
+            {
+              for (int blockNo=1; blockNo<iRadix; ++blockNo)
+                z[blockNo] = pData[blockNo*iSofar];
+            }
 
-          for (twNo=2; twNo<radix; twNo++)
-            _twiddle[twNo] = S * _twiddle[twNo-1];
+          switch (iRadix)
+            {
+            case  2: fft2(z); break;
+            case  3: fft3(z); break;
+            case  4: fft4(z); break;
+            case  5: fft5(z); break;
+            case  8: fft8(z); break;
+            case 10: fft10(z); break;
+            default: fftPrime(iRadix, pTrig, workspace); break;
+            }
 
-          S = cosSin * S;
+          for (int blockNo=0; blockNo<iRadix; ++blockNo)
+            pData[blockNo*iSofar] = z[blockNo];
         }
-
-        for (groupNo=0; groupNo<remainRadix; groupNo++)
-          {
-            if ((sofarRadix>1) && (dataNo > 0))
-              {
-                _z[0] = dest[adr];
-                blockNo=1;
-
-                do {
-                  adr = adr + sofarRadix;
-                  _z[blockNo] = _twiddle[blockNo] * dest[adr];
-                  blockNo++;
-                } while (blockNo < radix);
-              }
-            else
-              {
-                for (blockNo=0; blockNo<radix; blockNo++)
-                  {
-                    _z[blockNo] = dest[adr];
-                    adr = adr + sofarRadix;
-                  }
-              }
-
-            switch(radix)
-              {
-              case  2  : fft2(_z); break;
-              case  3  : fft3(_z); break;
-              case  4  : fft4(_z); break;
-              case  5  : fft5(_z); break;
-              case  8  : fft8(_z); break;
-              case 10  : fft10(_z); break;
-              default  : fftPrime(radix); break;
-              }
-
-            adr = groupOffset;
-            for (blockNo=0; blockNo<radix; blockNo++)
-              {
-                dest[adr] = _z[blockNo];
-                adr = adr + sofarRadix;
-              }
-            groupOffset = groupOffset + sofarRadix * radix;
-            adr = groupOffset;
-          }
-        dataOffset++;
-        groupOffset = dataOffset;
-        adr = dataOffset;
     }
-
 }
 
-template <class T> void PiiFft<T>::initializeTrigonomials( int radix )
-{
-  if ( radix > _prevPrimeRadix )
-    {
-      delete[] _trig;
-      delete[] _twiddle;
-      delete[] _z;
-      _trig = new std::complex<T>[radix];
-      _twiddle = new std::complex<T>[radix];
-      _z = new std::complex<T>[radix];
-      _prevPrimeRadix = radix;
-    }
-
-  int i;
-  T w;
-  std::complex<T> x;
-
-
-  w = 2 * _pi / radix;
-  _trig[0] = std::complex<T>(1,0);
-  x = std::complex<T>(std::cos(w), -std::sin(w));
-  _trig[1] = x;
-
-  for (i=2; i<radix; i++)
-    _trig[i] = x * _trig[i-1];
-
-
-}
-
-template <class T> inline void PiiFft<T>::fftPrime(int radix)
+template <class T> inline void PiiFft<T>::fftPrime(int radix, const std::complex<T>* trig, Workspace& workspace) const
 {
   int i,j,k,n,max;
   std::complex<T> re, im;
-  int cols = ((radix+1) / 2);
-  std::complex<T> *v = new std::complex<T>[cols];
-  std::complex<T> *w = new std::complex<T>[cols];
+  std::complex<T> *v = workspace.vecV.data();
+  std::complex<T> *w = workspace.vecW.data();
+  std::complex<T> *z = workspace.vecZ.data();
 
   n = radix;
   max = (n + 1)/2;
   for (j = 1; j < max; j++)
     {
-      v[j] = std::complex<T>(_z[j].real() + _z[n-j].real(), _z[j].imag() - _z[n-j].imag());
-      w[j] = std::complex<T>(_z[j].real() - _z[n-j].real(), _z[j].imag() + _z[n-j].imag());
-      //v[j].real() = _z[j].real() + _z[n-j].real();
-      //v[j].imag() = _z[j].imag() - _z[n-j].imag();
-      //w[j].real() = _z[j].real() - _z[n-j].real();
-      //w[j].imag() = _z[j].imag() + _z[n-j].imag();
+      v[j] = std::complex<T>(z[j].real() + z[n-j].real(), z[j].imag() - z[n-j].imag());
+      w[j] = std::complex<T>(z[j].real() - z[n-j].real(), z[j].imag() + z[n-j].imag());
+      //v[j].real() = z[j].real() + z[n-j].real();
+      //v[j].imag() = z[j].imag() - z[n-j].imag();
+      //w[j].real() = z[j].real() - z[n-j].real();
+      //w[j].imag() = z[j].imag() + z[n-j].imag();
     }
 
   for (j = 1; j < max; j++)
     {
-      _z[j] = _z[0];
-      _z[n-j] = _z[0];
+      z[j] = z[0];
+      z[n-j] = z[0];
       k = j;
       for (i = 1; i < max; i++)
         {
-          re = std::complex<T>(_trig[k].real() * v[i].real(), _trig[k].real() * w[i].imag());
-          im = std::complex<T>(_trig[k].imag() * w[i].real(), _trig[k].imag() * v[i].imag());
-          //re.real() = _trig[k].real() * v[i].real();
-          //im.imag() = _trig[k].imag() * v[i].imag();
-          //re.imag() = _trig[k].real() * w[i].imag();
-          //im.real() = _trig[k].imag() * w[i].real();
+          re = std::complex<T>(trig[k].real() * v[i].real(), trig[k].real() * w[i].imag());
+          im = std::complex<T>(trig[k].imag() * w[i].real(), trig[k].imag() * v[i].imag());
+          //re.real() = trig[k].real() * v[i].real();
+          //im.imag() = trig[k].imag() * v[i].imag();
+          //re.imag() = trig[k].real() * w[i].imag();
+          //im.real() = trig[k].imag() * w[i].real();
 
-          _z[n-j] = std::complex<T>(_z[n-j].real() + re.real() + im.imag(), _z[n-j].imag() + re.imag() - im.real());
-          _z[j] = std::complex<T>(_z[j].real() + re.real() - im.imag(), _z[j].imag() + re.imag() + im.real());
+          z[n-j] = std::complex<T>(z[n-j].real() + re.real() + im.imag(), z[n-j].imag() + re.imag() - im.real());
+          z[j] = std::complex<T>(z[j].real() + re.real() - im.imag(), z[j].imag() + re.imag() + im.real());
 
-          //_z[n-j].real() += (re.real() + im.imag());
-          //_z[n-j].imag() += (re.imag() - im.real());
-          //_z[j].real()   += (re.real() - im.imag());
-          //_z[j].imag()   += (re.imag() + im.real());
+          //z[n-j].real() += (re.real() + im.imag());
+          //z[n-j].imag() += (re.imag() - im.real());
+          //z[j].real()   += (re.real() - im.imag());
+          //z[j].imag()   += (re.imag() + im.real());
 
           k = k + j;
           if (k >= n)
@@ -461,16 +691,13 @@ template <class T> inline void PiiFft<T>::fftPrime(int radix)
 
   for ( j = 1; j < max; j++)
     {
-      _z[0] = std::complex<T>(_z[0].real() + v[j].real(), _z[0].imag() + w[j].imag() );
-      //_z[0].real() += v[j].real();
-      //_z[0].imag() += w[j].imag();
+      z[0] = std::complex<T>(z[0].real() + v[j].real(), z[0].imag() + w[j].imag() );
+      //z[0].real() += v[j].real();
+      //z[0].imag() += w[j].imag();
     }
-  delete[] w;
-  delete[] v;
-
 }
 
-template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z) const
 {
   std::complex<T> t1;
 
@@ -479,7 +706,7 @@ template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z)
   z[0] = t1;
 }
 
-template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z) const
 {
   std::complex<T> t1, m1, m2, s1;
 
@@ -495,7 +722,7 @@ template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
 
 }
 
-template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z) const
 {
   std::complex<T> t1, t2, m2, m3;
 
@@ -513,7 +740,7 @@ template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z)
   z[3] = m2 - m3;
 }
 
-template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z) const
 {
   std::complex<T> t1, t2, t3, t4, t5;
   std::complex<T> m1, m2, m3, m4, m5;
@@ -551,82 +778,84 @@ template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
   z[4] = s2 - s3;
 }
 
-template <class T> inline void PiiFft<T>::fft8(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft8(std::complex<T>* z) const
 {
+  std::complex<T> a[4], b[4];
   T gem;
 
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
+  a[0] = z[0];
+  a[1] = z[2];
+  a[2] = z[4];
+  a[3] = z[6];
 
-  _b[0] = z[1];
-  _b[1] = z[3];
-  _b[2] = z[5];
-  _b[3] = z[7];
+  b[0] = z[1];
+  b[1] = z[3];
+  b[2] = z[5];
+  b[3] = z[7];
 
-  fft4(_a);
-  fft4(_b);
+  fft4(a);
+  fft4(b);
 
-  gem = c8 * (_b[1].real() + _b[1].imag());
-  _b[1] = std::complex<T>(gem, c8 * (_b[1].imag() - _b[1].real()));
-  //_b[1].imag() = c8 * (_b[1].imag() - _b[1].real());
-  //_b[1].real() = gem;
+  gem = c8 * (b[1].real() + b[1].imag());
+  b[1] = std::complex<T>(gem, c8 * (b[1].imag() - b[1].real()));
+  //b[1].imag() = c8 * (b[1].imag() - b[1].real());
+  //b[1].real() = gem;
 
-  gem = _b[2].imag();
-  _b[2] = std::complex<T>(gem, -_b[2].real());
-  //_b[2].imag() = -_b[2].real();
-  //_b[2].real() = gem;
+  gem = b[2].imag();
+  b[2] = std::complex<T>(gem, -b[2].real());
+  //b[2].imag() = -b[2].real();
+  //b[2].real() = gem;
 
-  gem = c8 * (_b[3].imag() - _b[3].real());
-  _b[3] = std::complex<T>(gem, -c8 * (_b[3].real() + _b[3].imag()));
-  //_b[3].imag() = -c8 * (_b[3].real() + _b[3].imag());
-  //_b[3].real() = gem;
+  gem = c8 * (b[3].imag() - b[3].real());
+  b[3] = std::complex<T>(gem, -c8 * (b[3].real() + b[3].imag()));
+  //b[3].imag() = -c8 * (b[3].real() + b[3].imag());
+  //b[3].real() = gem;
 
-  z[0] = _a[0] + _b[0];
-  z[1] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[3] = _a[3] + _b[3];
+  z[0] = a[0] + b[0];
+  z[1] = a[1] + b[1];
+  z[2] = a[2] + b[2];
+  z[3] = a[3] + b[3];
 
-  z[4] = _a[0] - _b[0];
-  z[5] = _a[1] - _b[1];
-  z[6] = _a[2] - _b[2];
-  z[7] = _a[3] - _b[3];
+  z[4] = a[0] - b[0];
+  z[5] = a[1] - b[1];
+  z[6] = a[2] - b[2];
+  z[7] = a[3] - b[3];
 
 }
 
-template <class T> inline void PiiFft<T>::fft10(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft10(std::complex<T>* z) const
 {
-
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
-  _a[4] = z[8];
-
-  _b[0] = z[5];
-  _b[1] = z[7];
-  _b[2] = z[9];
-  _b[3] = z[1];
-  _b[4] = z[3];
-
-  fft5(_a);
-  fft5(_b);
-
-  z[0] = _a[0] + _b[0];
-  z[6] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[8] = _a[3] + _b[3];
-  z[4] = _a[4] + _b[4];
-  z[5] = _a[0] - _b[0];
-  z[1] = _a[1] - _b[1];
-  z[7] = _a[2] - _b[2];
-  z[3] = _a[3] - _b[3];
-  z[9] = _a[4] - _b[4];
+  std::complex<T> a[5], b[5];
+
+  a[0] = z[0];
+  a[1] = z[2];
+  a[2] = z[4];
+  a[3] = z[6];
+  a[4] = z[8];
+
+  b[0] = z[5];
+  b[1] = z[7];
+  b[2] = z[9];
+  b[3] = z[1];
+  b[4] = z[3];
+
+  fft5(a);
+  fft5(b);
+
+  z[0] = a[0] + b[0];
+  z[6] = a[1] + b[1];
+  z[2] = a[2] + b[2];
+  z[8] = a[3] + b[3];
+  z[4] = a[4] + b[4];
+  z[5] = a[0] - b[0];
+  z[1] = a[1] - b[1];
+  z[7] = a[2] - b[2];
+  z[3] = a[3] - b[3];
+  z[9] = a[4] - b[4];
 
 }
 
-template <class T> bool PiiFft<T>::isPrimeFactor( int radix )
+template <class T> bool PiiFft<T>::isPrimeFactor(int radix)
 {
   switch(radix)
     {
@@ -643,5 +872,4 @@ template <class T> bool PiiFft<T>::isPrimeFactor( int radix )
     }
 }
 
-
 #endif //_PIIFFT_TEMPLATES_H
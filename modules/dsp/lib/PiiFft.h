@@ -19,14 +19,56 @@
 #include <PiiMatrix.h>
 #include <PiiFunctional.h>
 #include <PiiMatrixValue.h>
+#include <PiiTypeTraits.h>
+#include <PiiParallel.h>
+#include <QVector>
 #include <complex>
+#include "PiiFftKernels.h"
 
 /**
  * A class for performing forward and inverse FFT for 1D and 2D
  * signals. The calculation is optimized by splitting the input into
  * pieces for which an optimized radix-N implementation exists. The
- * class has implementations for radix 2, 3, 4, 5, 8, and 10.
+ * class has implementations for radix 2, 3, 4, 5, 8, and 10. Radix 2,
+ * 4 and 8 stages are vectorized with SSE2 or NEON if available.
  *
+ * The factorization of a transform length, the order in which the
+ * input is read and the twiddle factors are stored in a *plan* the
+ * first time a length is needed. Subsequent transforms of the same
+ * length reuse the plan. It therefore pays off to keep a PiiFft
+ * object around if many transforms of equal size are calculated.
+ * The same plan works in both directions.
+ *
+ * Real-valued input is transformed two rows at a time as the real
+ * and imaginary parts of a complex signal. Since the spectrum of a
+ * real signal is conjugate symmetric, only the first `columns/2 + 1`
+ * columns need to be calculated. [forwardRealFft()] returns just
+ * them, and [inverseRealFft()] transforms them back to a real
+ * signal. This halves both the work and the memory needed.
+ *
+ * ~~~(c++)
+ * PiiFft<float> fft;
+ * PiiMatrix<float> matImage(480, 640);
+ * // 480 x 321 complex matrix
+ * PiiMatrix<std::complex<float> > matSpectrum(fft.forwardRealFft(matImage));
+ * // Back to 480 x 640
+ * PiiMatrix<float> matRestored(fft.inverseRealFft(matSpectrum, 640));
+ * ~~~
+ *
+ * All transform functions optionally accept a PiiParallelPolicy.
+ * The rows of a 2D transform are then divided among threads, and so
+ * are the columns. Columns are transformed in blocks: a block of
+ * neighboring columns is copied to contiguous memory row by row,
+ * transformed, and copied back. This keeps the column pass from
+ * reading a new cache line for each element.
+ *
+ * ~~~(c++)
+ * PiiFft<float> fft;
+ * // Use all cores
+ * PiiMatrix<std::complex<float> > matSpectrum(fft.forwardFft(matImage, PiiParallelPolicy()));
+ * ~~~
+ *
+ * PiiFft is not thread-safe. Use a separate object in each thread.
  */
 template <class T> class PiiFft
 {
@@ -35,40 +77,120 @@ public:
   ~PiiFft();
 
   /**
-   * Perform a forward Fourier transform.
+   * Perform a forward Fourier transform. If *source* is real, the
+   * transform is calculated with [forwardRealFft()], and the
+   * missing columns are filled in by conjugate symmetry.
    */
-  template <class S> PiiMatrix<std::complex<T> > forwardFft(const PiiMatrix<S>& source);
+  template <class S> PiiMatrix<std::complex<T> > forwardFft(const PiiMatrix<S>& source,
+                                                            const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
   /**
    * Perform an inverse Fourier transform.
    */
-  template <class S> PiiMatrix<std::complex<T> > inverseFft(const PiiMatrix<std::complex<S> >& source);
+  template <class S> PiiMatrix<std::complex<T> > inverseFft(const PiiMatrix<std::complex<S> >& source,
+                                                            const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
+  /**
+   * Perform a forward Fourier transform on a real-valued *source*
+   * matrix. The result contains only the non-redundant part of the
+   * spectrum, i.e. the first `source.columns()/2 + 1` columns of
+   * what [forwardFft()] would return.
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardRealFft(const PiiMatrix<S>& source,
+                                                                const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
+  /**
+   * Perform an inverse Fourier transform on the non-redundant part
+   * of the spectrum of a real signal, as returned by
+   * [forwardRealFft()]. The imaginary part of the result, which
+   * would be zero for a conjugate symmetric spectrum, is not
+   * calculated.
+   *
+   * @param source the first `columns/2 + 1` columns of a spectrum
+   *
+   * @param columns the number of columns in the real signal. This
+   * is needed because both `2n` and `2n+1` columns produce `n+1`
+   * columns of spectrum.
+   *
+   * @param policy the execution policy
+   *
+   * @exception PiiInvalidArgumentException& if the number of
+   * columns in *source* doesn't match *columns*.
+   */
+  template <class S> PiiMatrix<T> inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns,
+                                                 const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
 
 private:
-  template <class S> bool forward1d(const S* source, std::complex<T>* destination, int count);
-  template <class S> bool inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count);
-
-  void factorize(int count);
-  template <class S> void reorderSeries(const S* source, std::complex<T>* dest);
-  void initializeTrigonomials(int radix);
-
-  inline void fftPrime(int radix);
-  inline void fft2(std::complex<T>* z);
-  inline void fft3(std::complex<T>* z);
-  inline void fft4(std::complex<T>* z);
-  inline void fft5(std::complex<T>* z);
-  inline void fft8(std::complex<T>* z);
-  inline void fft10(std::complex<T>* z);
-  void synthesizeFft(int sofar, int radix, int remain, std::complex<T>* dest);
-  bool isPrimeFactor(int radix);
-  void reallocateBuffers(int len);
-
-  std::complex<T> _a[5], _b[5];
-  std::complex<T> *_trig, *_twiddle, *_z;
-  int _sofarRadix[20], _actualRadix[20], _remainRadix[20];
-  int _count, _factorCount, _prevPrimeRadix;
+  PII_DISABLE_COPY(PiiFft);
+
+  struct Stage
+  {
+    int iSofar, iRadix, iRemain;
+    // Twiddle factors in Plan::vecTwiddles, radix*sofar entries
+    int iTwiddleOffset;
+    // Trigonometric constants for prime radices, radix entries
+    int iTrigOffset;
+  };
+
+  struct Plan
+  {
+    int iCount;
+    // The largest radix of all stages
+    int iMaxRadix;
+    QVector<Stage> vecStages;
+    // The input index of each output element after reordering
+    QVector<int> vecOrder;
+    QVector<std::complex<T> > vecTwiddles;
+  };
+
+  /* Scratch memory for one thread. Plans are shared by all threads
+     but never modified after creation.
+   */
+  struct Workspace
+  {
+    Workspace(const Plan* plan, int bufferSize);
+
+    QVector<std::complex<T> > vecZ, vecV, vecW, vecBuffer1, vecBuffer2;
+  };
+
+  // Strip functions for Pii::forEachStrip()
+  template <class S> class ForwardRowFunction;
+  template <class S> class InverseRowFunction;
+  template <class S> class RealRowFunction;
+  class InverseRealRowFunction;
+  class ColumnFunction;
+  class SymmetryFunction;
+
+  enum { ColumnBlockSize = 16 };
+
+  const Plan* plan(int count);
+  Plan* createPlan(int count);
+  QVector<int> factorize(int count);
+
+  template <class S> PiiMatrix<std::complex<T> > forwardComplex(const PiiMatrix<S>& source,
+                                                                const PiiParallelPolicy& policy, Pii::True);
+  template <class S> PiiMatrix<std::complex<T> > forwardComplex(const PiiMatrix<S>& source,
+                                                                const PiiParallelPolicy& policy, Pii::False);
+
+  template <class S> void forward1d(const Plan* plan, const S* source, std::complex<T>* destination,
+                                    Workspace& workspace) const;
+  template <class S> void inverse1d(const Plan* plan, const std::complex<S>* source, std::complex<T>* destination,
+                                    Workspace& workspace) const;
+  void transformColumns(PiiMatrix<std::complex<T> >& matrix, bool inverse, const PiiParallelPolicy& policy);
+  void synthesizeFft(const Plan* plan, std::complex<T>* dest, Workspace& workspace) const;
+  void synthesizeStage(const Plan* plan, const Stage& stage, std::complex<T>* dest, Workspace& workspace) const;
+  static bool isPrimeFactor(int radix);
+
+  inline void fftPrime(int radix, const std::complex<T>* trig, Workspace& workspace) const;
+  inline void fft2(std::complex<T>* z) const;
+  inline void fft3(std::complex<T>* z) const;
+  inline void fft4(std::complex<T>* z) const;
+  inline void fft5(std::complex<T>* z) const;
+  inline void fft8(std::complex<T>* z) const;
+  inline void fft10(std::complex<T>* z) const;
+
+  QVector<Plan*> _vecPlans;
 
   T _pi, c3_1, c3_2, u5, c5_1, c5_2, c5_3, c5_4, c5_5, c8;
-  PiiMatrix<std::complex<T> > _tempSource, _tempResult;
 };
 
 #include "PiiFft-templates.h"
@@ -76,15 +198,31 @@ private:
 
 namespace PiiDsp
 {
-  /// @internal Takes the real part of a complex number
-  template <class T> struct FastCorrelationConverter
+  /// @internal Correlates real signals using half spectra
+  template <class T> struct FastCorrelation
   {
-    static PiiMatrix<T> apply(const PiiMatrix<std::complex<T> >& matrix) { return Pii::matrix(Pii::real(matrix)); }
+    typedef PiiFft<T> FftType;
+    static PiiMatrix<T> apply(FftType& fft, const PiiMatrix<T>& a, const PiiMatrix<T>& b,
+                              const PiiParallelPolicy& policy)
+    {
+      return fft.inverseRealFft(Pii::matrix(Pii::multiplied(fft.forwardRealFft(a, policy),
+                                                            Pii::conj(fft.forwardRealFft(b, policy)))),
+                                a.columns(), policy);
+    }
   };
-  /// @internal Returns the complex number itself
-  template <class T> struct FastCorrelationConverter<std::complex<T> >
+  /// @internal Correlates complex signals
+  template <class T> struct FastCorrelation<std::complex<T> >
   {
-    static PiiMatrix<std::complex<T> > apply(const PiiMatrix<std::complex<T> >& matrix) { return matrix; }
+    typedef PiiFft<T> FftType;
+    static PiiMatrix<std::complex<T> > apply(FftType& fft,
+                                             const PiiMatrix<std::complex<T> >& a,
+                                             const PiiMatrix<std::complex<T> >& b,
+                                             const PiiParallelPolicy& policy)
+    {
+      return fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a, policy),
+                                                        Pii::conj(fft.forwardFft(b, policy)))),
+                            policy);
+    }
   };
 
   /**
@@ -96,10 +234,32 @@ namespace PiiDsp
    * \]
    *
    * where *F* stands for the Fourier transform, and "*" marks complex
-   * conjugation. The input matrices must be equal in size.
+   * conjugation. The input matrices must be equal in size. Real
+   * signals are correlated using [PiiFft::forwardRealFft()] and
+   * [PiiFft::inverseRealFft()].
+   *
+   * If the correlation is calculated repeatedly for equal-sized
+   * signals, pass the same *fft* object each time. This way the FFT
+   * plans need to be created only once. The transforms are divided
+   * among threads as determined by *policy*.
    *
-   * @exception PiiMathException& if input matrices are different in
-   * size
+   * @exception PiiInvalidArgumentException& if input matrices are
+   * different in size
+   *
+   * @relates PiiFft
+   */
+  template <class T> inline PiiMatrix<T> fastCorrelation(typename FastCorrelation<T>::FftType& fft,
+                                                         const PiiMatrix<T>& a,
+                                                         const PiiMatrix<T>& b,
+                                                         const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    PII_MATRIX_CHECK_EQUAL_SIZE(a,b);
+    return FastCorrelation<T>::apply(fft, a, b, policy);
+  }
+
+  /**
+   * Calculates the correlation of two signals using a temporary
+   * PiiFft object.
    *
    * @relates PiiFft
    */
@@ -107,9 +267,8 @@ namespace PiiDsp
                                                          const PiiMatrix<T>& b)
 
   {
-    PiiFft<T> fft;
-    return FastCorrelationConverter<T>::apply(fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a),
-                                                                                         Pii::conj(fft.forwardFft(b))))));
+    typename FastCorrelation<T>::FftType fft;
+    return fastCorrelation<T>(fft, a, b);
   }
 
   template <class T> PiiMatrixValue<T> findTranslation(const PiiMatrix<T>& correlation)
@@ -140,6 +299,21 @@ namespace PiiDsp
   {
     return findTranslation(PiiDsp::fastCorrelation(a,b));
   }
+
+  /**
+   * Find the translation of signal `a` with respect to signal `b`
+   * using the given *fft* object. Reusing the same object when
+   * registering a sequence of equal-sized images avoids recreating
+   * the FFT plans. The transforms are divided among threads as
+   * determined by *policy*.
+   */
+  template <class T> inline PiiMatrixValue<T> findTranslation(typename FastCorrelation<T>::FftType& fft,
+                                                              const PiiMatrix<T>& a,
+                                                              const PiiMatrix<T>& b,
+                                                              const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    return findTranslation(PiiDsp::fastCorrelation<T>(fft,a,b,policy));
+  }
 };
 
 #endif //_PIIFFT_H
@@ -0,0 +1,318 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiFftKernels.h"
+
+#include <PiiCpu.h>
+#include <cmath>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define PII_FFT_SSE2 1
+#elif defined(PII_NEON) && defined(__aarch64__)
+// Double-precision vectors are not available on 32-bit ARM.
+#  include <arm_neon.h>
+#  define PII_FFT_NEON 1
+#endif
+
+namespace PiiDsp
+{
+  namespace
+  {
+    bool isVectorized()
+    {
+#if defined(PII_FFT_SSE2)
+      return Pii::hasCpuFeature(Pii::CpuSse2);
+#elif defined(PII_FFT_NEON)
+      return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+      return false;
+#endif
+    }
+
+    /* Each Ops struct stores complex numbers in memory order (real,
+       imaginary) in a vector register. ComplexCount tells how many
+       of them fit into one register. load() and store() move
+       ComplexCount numbers, loadOne() and storeOne() just one.
+     */
+#if defined(PII_FFT_SSE2)
+    namespace Sse2
+    {
+      struct FloatOps
+      {
+        typedef __m128 Vec;
+        typedef float Type;
+        enum { ComplexCount = 2 };
+
+        static inline Vec load(const std::complex<float>* p) { return _mm_loadu_ps(reinterpret_cast<const float*>(p)); }
+        static inline void store(std::complex<float>* p, Vec v) { _mm_storeu_ps(reinterpret_cast<float*>(p), v); }
+        static inline Vec loadOne(const std::complex<float>* p)
+        {
+          return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+        }
+        static inline void storeOne(std::complex<float>* p, Vec v)
+        {
+          _mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+        }
+        static inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static inline Vec scale(Vec a, float c) { return _mm_mul_ps(a, _mm_set1_ps(c)); }
+        // (re, im) -> (im, -re)
+        static inline Vec mulMinusI(Vec a)
+        {
+          return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)),
+                            _mm_castsi128_ps(_mm_set_epi32(int(0x80000000), 0, int(0x80000000), 0)));
+        }
+        static inline Vec mul(Vec a, Vec w)
+        {
+          Vec re = _mm_mul_ps(a, _mm_shuffle_ps(w, w, _MM_SHUFFLE(2,2,0,0)));
+          Vec im = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)),
+                              _mm_shuffle_ps(w, w, _MM_SHUFFLE(3,3,1,1)));
+          return _mm_add_ps(re, _mm_xor_ps(im, _mm_castsi128_ps(_mm_set_epi32(0, int(0x80000000), 0, int(0x80000000)))));
+        }
+      };
+
+      struct DoubleOps
+      {
+        typedef __m128d Vec;
+        typedef double Type;
+        enum { ComplexCount = 1 };
+
+        static inline Vec load(const std::complex<double>* p) { return _mm_loadu_pd(reinterpret_cast<const double*>(p)); }
+        static inline void store(std::complex<double>* p, Vec v) { _mm_storeu_pd(reinterpret_cast<double*>(p), v); }
+        static inline Vec loadOne(const std::complex<double>* p) { return load(p); }
+        static inline void storeOne(std::complex<double>* p, Vec v) { store(p, v); }
+        static inline Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static inline Vec scale(Vec a, double c) { return _mm_mul_pd(a, _mm_set1_pd(c)); }
+        static inline Vec mulMinusI(Vec a)
+        {
+          return _mm_xor_pd(_mm_shuffle_pd(a, a, 1), _mm_set_pd(-0.0, 0.0));
+        }
+        static inline Vec mul(Vec a, Vec w)
+        {
+          Vec re = _mm_mul_pd(a, _mm_unpacklo_pd(w, w));
+          Vec im = _mm_mul_pd(_mm_shuffle_pd(a, a, 1), _mm_unpackhi_pd(w, w));
+          return _mm_add_pd(re, _mm_xor_pd(im, _mm_set_pd(0.0, -0.0)));
+        }
+      };
+    }
+#elif defined(PII_FFT_NEON)
+    namespace Neon
+    {
+      struct FloatOps
+      {
+        typedef float32x4_t Vec;
+        typedef float Type;
+        enum { ComplexCount = 2 };
+
+        static inline Vec load(const std::complex<float>* p) { return vld1q_f32(reinterpret_cast<const float*>(p)); }
+        static inline void store(std::complex<float>* p, Vec v) { vst1q_f32(reinterpret_cast<float*>(p), v); }
+        static inline Vec loadOne(const std::complex<float>* p)
+        {
+          return vcombine_f32(vld1_f32(reinterpret_cast<const float*>(p)), vdup_n_f32(0));
+        }
+        static inline void storeOne(std::complex<float>* p, Vec v)
+        {
+          vst1_f32(reinterpret_cast<float*>(p), vget_low_f32(v));
+        }
+        static inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+        static inline Vec scale(Vec a, float c) { return vmulq_n_f32(a, c); }
+        static inline Vec mulMinusI(Vec a)
+        {
+          return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vrev64q_f32(a)),
+                                                 vreinterpretq_u32_u64(vdupq_n_u64(0x8000000000000000ULL))));
+        }
+        static inline Vec mul(Vec a, Vec w)
+        {
+          Vec re = vmulq_f32(a, vtrn1q_f32(w, w));
+          Vec im = vmulq_f32(vrev64q_f32(a), vtrn2q_f32(w, w));
+          return vaddq_f32(re, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(im),
+                                                               vreinterpretq_u32_u64(vdupq_n_u64(0x80000000ULL)))));
+        }
+      };
+
+      struct DoubleOps
+      {
+        typedef float64x2_t Vec;
+        typedef double Type;
+        enum { ComplexCount = 1 };
+
+        static inline Vec load(const std::complex<double>* p) { return vld1q_f64(reinterpret_cast<const double*>(p)); }
+        static inline void store(std::complex<double>* p, Vec v) { vst1q_f64(reinterpret_cast<double*>(p), v); }
+        static inline Vec loadOne(const std::complex<double>* p) { return load(p); }
+        static inline void storeOne(std::complex<double>* p, Vec v) { store(p, v); }
+        static inline Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+        static inline Vec sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+        static inline Vec scale(Vec a, double c) { return vmulq_n_f64(a, c); }
+        static inline Vec mulMinusI(Vec a)
+        {
+          return vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(vextq_f64(a, a, 1)),
+                                                 vcombine_u64(vdup_n_u64(0), vdup_n_u64(0x8000000000000000ULL))));
+        }
+        static inline Vec mul(Vec a, Vec w)
+        {
+          Vec re = vmulq_f64(a, vdupq_laneq_f64(w, 0));
+          Vec im = vmulq_f64(vextq_f64(a, a, 1), vdupq_laneq_f64(w, 1));
+          return vaddq_f64(re, vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(im),
+                                                               vcombine_u64(vdup_n_u64(0x8000000000000000ULL), vdup_n_u64(0)))));
+        }
+      };
+    }
+#endif
+
+    template <class Ops, bool full> struct Memory
+    {
+      typedef typename Ops::Type T;
+      static inline typename Ops::Vec load(const std::complex<T>* p) { return Ops::load(p); }
+      static inline void store(std::complex<T>* p, typename Ops::Vec v) { Ops::store(p, v); }
+    };
+
+    template <class Ops> struct Memory<Ops,false>
+    {
+      typedef typename Ops::Type T;
+      static inline typename Ops::Vec load(const std::complex<T>* p) { return Ops::loadOne(p); }
+      static inline void store(std::complex<T>* p, typename Ops::Vec v) { Ops::storeOne(p, v); }
+    };
+
+    /* The butterflies follow PiiFft::fft2(), fft4() and fft8()
+       operation by operation.
+     */
+    template <class Ops, int radix> struct Butterfly;
+
+    template <class Ops> struct Butterfly<Ops,2>
+    {
+      typedef typename Ops::Vec Vec;
+      static inline void apply(Vec* z)
+      {
+        Vec t1 = Ops::add(z[0], z[1]);
+        z[1] = Ops::sub(z[0], z[1]);
+        z[0] = t1;
+      }
+    };
+
+    template <class Ops> struct Butterfly<Ops,4>
+    {
+      typedef typename Ops::Vec Vec;
+      static inline void apply(Vec* z)
+      {
+        Vec t1 = Ops::add(z[0], z[2]), t2 = Ops::add(z[1], z[3]);
+        Vec m2 = Ops::sub(z[0], z[2]), m3 = Ops::mulMinusI(Ops::sub(z[1], z[3]));
+        z[0] = Ops::add(t1, t2);
+        z[2] = Ops::sub(t1, t2);
+        z[1] = Ops::add(m2, m3);
+        z[3] = Ops::sub(m2, m3);
+      }
+    };
+
+    template <class Ops> struct Butterfly<Ops,8>
+    {
+      typedef typename Ops::Vec Vec;
+      typedef typename Ops::Type T;
+      static inline void apply(Vec* z)
+      {
+        const T c8 = T(1/std::sqrt(2.0));
+        Vec a[4] = { z[0], z[2], z[4], z[6] };
+        Vec b[4] = { z[1], z[3], z[5], z[7] };
+        Butterfly<Ops,4>::apply(a);
+        Butterfly<Ops,4>::apply(b);
+        b[1] = Ops::scale(Ops::add(b[1], Ops::mulMinusI(b[1])), c8);
+        b[2] = Ops::mulMinusI(b[2]);
+        b[3] = Ops::scale(Ops::sub(Ops::mulMinusI(b[3]), b[3]), c8);
+        for (int i=0; i<4; ++i)
+          {
+            z[i] = Ops::add(a[i], b[i]);
+            z[i+4] = Ops::sub(a[i], b[i]);
+          }
+      }
+    };
+
+    template <class Ops, int radix, bool full>
+    inline void butterfly(std::complex<typename Ops::Type>* data,
+                          const std::complex<typename Ops::Type>* twiddles,
+                          int sofar)
+    {
+      typedef Memory<Ops,full> Mem;
+      typename Ops::Vec z[radix];
+      z[0] = Mem::load(data);
+      for (int b=1; b<radix; ++b)
+        {
+          z[b] = Mem::load(data + b*sofar);
+          if (sofar > 1)
+            z[b] = Ops::mul(z[b], Mem::load(twiddles + b*sofar));
+        }
+      Butterfly<Ops,radix>::apply(z);
+      for (int b=0; b<radix; ++b)
+        Mem::store(data + b*sofar, z[b]);
+    }
+
+    template <class Ops, int radix>
+    void runStage(int sofar, int remain,
+                  const std::complex<typename Ops::Type>* twiddles,
+                  std::complex<typename Ops::Type>* data)
+    {
+      const int iStep = Ops::ComplexCount;
+      for (int g=0; g<remain; ++g, data += sofar*radix)
+        {
+          int d = 0;
+          for (; d+iStep <= sofar; d += iStep)
+            butterfly<Ops,radix,true>(data + d, twiddles + d, sofar);
+          for (; d < sofar; ++d)
+            butterfly<Ops,radix,false>(data + d, twiddles + d, sofar);
+        }
+    }
+
+    template <class Ops>
+    bool runStage(int radix, int sofar, int remain,
+                  const std::complex<typename Ops::Type>* twiddles,
+                  std::complex<typename Ops::Type>* data)
+    {
+      switch (radix)
+        {
+        case 2: runStage<Ops,2>(sofar, remain, twiddles, data); return true;
+        case 4: runStage<Ops,4>(sofar, remain, twiddles, data); return true;
+        case 8: runStage<Ops,8>(sofar, remain, twiddles, data); return true;
+        default: return false;
+        }
+    }
+  }
+
+#if defined(PII_FFT_SSE2)
+#  define PII_FFT_OPS(TYPE) Sse2::TYPE
+#elif defined(PII_FFT_NEON)
+#  define PII_FFT_OPS(TYPE) Neon::TYPE
+#endif
+
+#ifdef PII_FFT_OPS
+#  define PII_DEFINE_FFT_KERNEL(TYPE, OPS)                              \
+  bool FftKernel<TYPE>::runStage(int radix, int sofar, int remain,      \
+                                 const std::complex<TYPE>* twiddles,    \
+                                 std::complex<TYPE>* data)              \
+  {                                                                     \
+    return isVectorized() &&                                            \
+      PiiDsp::runStage<PII_FFT_OPS(OPS)>(radix, sofar, remain, twiddles, data); \
+  }
+#else
+#  define PII_DEFINE_FFT_KERNEL(TYPE, OPS)                              \
+  bool FftKernel<TYPE>::runStage(int, int, int, const std::complex<TYPE>*, std::complex<TYPE>*) \
+  {                                                                     \
+    return false;                                                       \
+  }
+#endif
+
+  PII_DEFINE_FFT_KERNEL(float, FloatOps)
+  PII_DEFINE_FFT_KERNEL(double, DoubleOps)
+}
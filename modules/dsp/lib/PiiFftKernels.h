@@ -0,0 +1,67 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFFTKERNELS_H
+#define _PIIFFTKERNELS_H
+
+#include "PiiDspGlobal.h"
+#include <complex>
+
+namespace PiiDsp
+{
+  /**
+   * Vectorized butterflies for PiiFft. A *stage* of a mixed-radix
+   * FFT combines *remain* groups of *radix* interleaved sub-transforms
+   * of length *sofar* into transforms of length *sofar* × *radix*.
+   * The kernels run a whole stage with SSE2 or NEON instructions.
+   * With `double`, one complex number fits into a register; with
+   * `float`, two neighboring sub-transforms are processed at once.
+   *
+   * The generic template says "not supported", which makes PiiFft
+   * fall back to its scalar butterflies. Specializations exist for
+   * `float` and `double`. The operations are the same as in the
+   * scalar code, but the result may differ in the last bit because
+   * std::complex multiplication is not used.
+   *
+   * @internal
+   */
+  template <class T> struct FftKernel
+  {
+    /**
+     * Runs a radix-2, radix-4 or radix-8 stage in place on *data*.
+     * *twiddles* contains `radix * sofar` twiddle factors so that
+     * `twiddles[b*sofar + d]` is the factor for the *b*th input of
+     * sub-transform *d*. Returns `false` if *radix* is not supported
+     * or the CPU lacks the required instructions. In this case
+     * *data* is not modified.
+     */
+    static bool runStage(int, int, int, const std::complex<T>*, std::complex<T>*) { return false; }
+  };
+
+#define PII_DECLARE_FFT_KERNEL(TYPE)                                    \
+  template <> struct PII_DSP_EXPORT FftKernel<TYPE>                     \
+  {                                                                     \
+    static bool runStage(int radix, int sofar, int remain,              \
+                         const std::complex<TYPE>* twiddles,            \
+                         std::complex<TYPE>* data);                     \
+  }
+
+  PII_DECLARE_FFT_KERNEL(float);
+  PII_DECLARE_FFT_KERNEL(double);
+
+#undef PII_DECLARE_FFT_KERNEL
+}
+
+#endif //_PIIFFTKERNELS_H
@@ -0,0 +1,138 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiStreamingPeakDetector.h"
+
+namespace PiiDsp
+{
+  StreamingPeakDetector::StreamingPeakDetector(double highThreshold,
+                                               double lowThreshold,
+                                               int baselineWindow) :
+    _dHighThreshold(highThreshold),
+    _dLowThreshold(lowThreshold),
+    _iBaselineWindow(baselineWindow)
+  {
+    reset();
+  }
+
+  void StreamingPeakDetector::reset()
+  {
+    _iSampleIndex = 0;
+    _iChunkStart = 0;
+    _dBaseline = 0;
+    _bHasPrevious = false;
+    _dPrevious = 0;
+    _dLowCrossing = 0;
+    _bInPeak = false;
+    _bAfterMaxKnown = false;
+    _iMaxIndex = 0;
+    _dMax = _dBeforeMax = _dAfterMax = _dPeakBaseline = 0;
+  }
+
+  QList<Peak> StreamingPeakDetector::process(const double* samples, int count)
+  {
+    QList<Peak> lstPeaks;
+    _iChunkStart = _iSampleIndex;
+    for (int i=0; i<count; ++i)
+      addSample(samples[i], lstPeaks);
+    return lstPeaks;
+  }
+
+  void StreamingPeakDetector::addSample(double value, QList<Peak>& peaks)
+  {
+    const double dLow = qMin(_dLowThreshold, _dHighThreshold);
+    if (_iBaselineWindow > 0 && !_bHasPrevious)
+      _dBaseline = value;
+    const double dHeight = value - _dBaseline;
+    const double dIndex = double(_iSampleIndex);
+
+    if (!_bInPeak)
+      {
+        if (dHeight >= dLow && (!_bHasPrevious || _dPrevious < dLow))
+          _dLowCrossing = _bHasPrevious ?
+            dIndex - 1 + (dLow - _dPrevious) / (dHeight - _dPrevious) :
+            dIndex;
+
+        if (dHeight > _dHighThreshold)
+          {
+            _bInPeak = true;
+            _bAfterMaxKnown = false;
+            _iMaxIndex = _iSampleIndex;
+            _dMax = dHeight;
+            _dBeforeMax = _bHasPrevious ? _dPrevious : dHeight;
+            _dPeakBaseline = _dBaseline;
+          }
+        else if (_iBaselineWindow > 0)
+          _dBaseline += (value - _dBaseline) / _iBaselineWindow;
+      }
+    else
+      {
+        if (!_bAfterMaxKnown && _iSampleIndex == _iMaxIndex + 1)
+          {
+            _dAfterMax = dHeight;
+            _bAfterMaxKnown = true;
+          }
+        if (dHeight > _dMax)
+          {
+            _dBeforeMax = _dPrevious;
+            _dMax = dHeight;
+            _iMaxIndex = _iSampleIndex;
+            _bAfterMaxKnown = false;
+          }
+        else if (dHeight < dLow)
+          endPeak(dIndex - 1 + (_dPrevious - dLow) / (_dPrevious - dHeight), peaks);
+      }
+
+    _dPrevious = dHeight;
+    _bHasPrevious = true;
+    ++_iSampleIndex;
+  }
+
+  void StreamingPeakDetector::endPeak(double endPosition, QList<Peak>& peaks)
+  {
+    if (!_bAfterMaxKnown)
+      _dAfterMax = _dMax;
+    // Vertex of a parabola through the maximum and its neighbors.
+    const double dCurvature = _dBeforeMax - 2 * _dMax + _dAfterMax;
+    double dOffset = 0;
+    if (dCurvature < 0)
+      dOffset = qBound(-0.5, 0.5 * (_dBeforeMax - _dAfterMax) / dCurvature, 0.5);
+    const double dTop = _dMax - 0.25 * (_dBeforeMax - _dAfterMax) * dOffset;
+
+    peaks << Peak(int(_iMaxIndex - _iChunkStart),
+                  double(_iMaxIndex) + dOffset,
+                  _dPeakBaseline + dTop,
+                  endPosition - _dLowCrossing);
+    _bInPeak = false;
+  }
+
+  QList<Peak> StreamingPeakDetector::flush()
+  {
+    QList<Peak> lstPeaks;
+    if (_bInPeak)
+      endPeak(double(_iSampleIndex - 1), lstPeaks);
+    return lstPeaks;
+  }
+
+  void StreamingPeakDetector::setHighThreshold(double highThreshold) { _dHighThreshold = highThreshold; }
+  double StreamingPeakDetector::highThreshold() const { return _dHighThreshold; }
+  void StreamingPeakDetector::setLowThreshold(double lowThreshold) { _dLowThreshold = lowThreshold; }
+  double StreamingPeakDetector::lowThreshold() const { return _dLowThreshold; }
+  void StreamingPeakDetector::setBaselineWindow(int baselineWindow) { _iBaselineWindow = baselineWindow; }
+  int StreamingPeakDetector::baselineWindow() const { return _iBaselineWindow; }
+  qint64 StreamingPeakDetector::sampleCount() const { return _iSampleIndex; }
+  double StreamingPeakDetector::baseline() const { return _dBaseline; }
+  bool StreamingPeakDetector::isInPeak() const { return _bInPeak; }
+}
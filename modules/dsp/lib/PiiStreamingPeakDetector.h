@@ -0,0 +1,156 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISTREAMINGPEAKDETECTOR_H
+#define _PIISTREAMINGPEAKDETECTOR_H
+
+#include "PiiDsp.h"
+
+namespace PiiDsp
+{
+  /**
+   * Detects peaks in an endless one-dimensional signal that arrives
+   * in chunks, such as a profile accumulated from line-scan data.
+   * Unlike [findPeaks()], the detector keeps its state between calls
+   * to [process()]. A peak that spans two chunks is reported once,
+   * as soon as it has ended. The cost per sample is constant.
+   *
+   * The detector tracks a baseline with an exponential moving
+   * average, which is frozen while a peak is in progress. A peak
+   * starts when the signal rises more than [highThreshold()] above
+   * the baseline and ends when it falls below [lowThreshold()]. Using
+   * a lower threshold for the end (hysteresis) prevents noise from
+   * splitting a peak into many.
+   *
+   * The fields of the reported [Peak] structures are filled as
+   * follows:
+   *
+   * - `position` - the index of the maximum, counted from the first
+   * sample since [reset()], refined by fitting a parabola to the
+   * maximum and its neighbors.
+   * - `height` - the height of the fitted parabola (absolute, not
+   * relative to the baseline).
+   * - `width` - the distance between the points where the signal
+   * crossed the low threshold, linearly interpolated.
+   * - `dataIndex` - the index of the maximum relative to the first
+   * sample of the chunk passed to [process()]. Negative if the
+   * maximum was in an earlier chunk.
+   *
+   * ~~~(c++)
+   * PiiDsp::StreamingPeakDetector detector(10, 5, 1000);
+   * forever
+   *   {
+   *     PiiMatrix<double> matProfile = nextProfile();
+   *     QList<PiiDsp::Peak> lstPeaks = detector.process(matProfile);
+   *     // ...
+   *   }
+   * ~~~
+   */
+  class PII_DSP_EXPORT StreamingPeakDetector
+  {
+  public:
+    /**
+     * Creates a new detector.
+     *
+     * @param highThreshold the minimum height above the baseline
+     * that starts a peak.
+     *
+     * @param lowThreshold the height above the baseline below which
+     * a peak ends. If greater than *highThreshold*, *highThreshold*
+     * will be used.
+     *
+     * @param baselineWindow the time constant of the baseline
+     * estimate, in samples. Zero or negative means that the baseline
+     * is fixed at zero and the thresholds are absolute.
+     */
+    StreamingPeakDetector(double highThreshold = 0,
+                          double lowThreshold = 0,
+                          int baselineWindow = 0);
+
+    void setHighThreshold(double highThreshold);
+    double highThreshold() const;
+    void setLowThreshold(double lowThreshold);
+    double lowThreshold() const;
+    void setBaselineWindow(int baselineWindow);
+    int baselineWindow() const;
+
+    /**
+     * Processes *count* consecutive samples and returns the peaks
+     * that ended within them.
+     */
+    QList<Peak> process(const double* samples, int count);
+
+    /**
+     * Processes all samples in *samples*, which is a row vector. If
+     * *samples* has two rows, the second one is used.
+     */
+    template <class T> QList<Peak> process(const PiiMatrix<T>& samples);
+
+    /**
+     * Ends the current peak, if any, and returns it. Call this
+     * function at the end of the signal to get a peak still in
+     * progress.
+     */
+    QList<Peak> flush();
+
+    /**
+     * Forgets all state, including the baseline and sample count.
+     */
+    void reset();
+
+    /**
+     * Returns the number of samples processed since [reset()].
+     */
+    qint64 sampleCount() const;
+
+    /**
+     * Returns the current baseline estimate.
+     */
+    double baseline() const;
+
+    /**
+     * Returns `true` if a peak is in progress.
+     */
+    bool isInPeak() const;
+
+  private:
+    void addSample(double value, QList<Peak>& peaks);
+    void endPeak(double endPosition, QList<Peak>& peaks);
+
+    double _dHighThreshold, _dLowThreshold;
+    int _iBaselineWindow;
+
+    qint64 _iSampleIndex, _iChunkStart;
+    double _dBaseline;
+    bool _bHasPrevious;
+    // Height of the previous sample above the baseline.
+    double _dPrevious;
+    // The position where the signal last rose above the low
+    // threshold.
+    double _dLowCrossing;
+
+    bool _bInPeak, _bAfterMaxKnown;
+    qint64 _iMaxIndex;
+    double _dMax, _dBeforeMax, _dAfterMax, _dPeakBaseline;
+  };
+
+  template <class T> QList<Peak> StreamingPeakDetector::process(const PiiMatrix<T>& samples)
+  {
+    const PiiMatrix<double> matSamples(samples(samples.rows() == 2 ? 1 : 0, 0, 1, -1));
+    return process(matSamples[0], matSamples.columns());
+  }
+}
+
+#endif //_PIISTREAMINGPEAKDETECTOR_H
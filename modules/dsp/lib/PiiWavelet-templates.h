@@ -18,41 +18,130 @@
 #endif
 
 #include "PiiDsp.h"
+#include <algorithm>
 
 namespace PiiDsp
 {
   template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
                                               WaveletFamily type,
                                               int index)
+  {
+    PiiMatrix<T> matBuffer;
+    return dwt(mat, type, index, matBuffer);
+  }
+
+  template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
+                                              WaveletFamily type,
+                                              int index,
+                                              PiiMatrix<T>& buffer)
   {
     QList<PiiMatrix<double> > filters(createScalingWavelets(scalingFilter(type, index)));
-    return dwt(mat, PiiMatrix<T>(filters[0]), PiiMatrix<T>(filters[1]));
+    return dwt(mat, PiiMatrix<T>(filters[0]), PiiMatrix<T>(filters[1]), buffer);
   }
 
   template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
                                               const PiiMatrix<T>& lo,
                                               const PiiMatrix<T>& hi)
   {
-    QList<PiiMatrix<T> > result;
-    PiiMatrix<T> loT(Pii::transpose(lo)), hiT(Pii::transpose(hi));
-
-    // Low-pass filter vertically
-    PiiMatrix<T> tmp(downSample(PiiDsp::convolution<T>(mat,loT), Pii::Vertically, 1));
+    PiiMatrix<T> matBuffer;
+    return dwt(mat, lo, hi, matBuffer);
+  }
 
-    // Low-pass in both directions (approximation)
-    result << downSample(PiiDsp::convolution<T>(tmp,lo), Pii::Horizontally, 1);
-    // Vertical low-pass, horizontal high-pass (vertical details)
-    result << downSample(PiiDsp::convolution<T>(tmp,hi), Pii::Horizontally, 1);
+  namespace Private
+  {
+    /* Calculates the odd samples of the full convolution of the
+     * rows of mat with filter along the vertical axis. Only the
+     * output row 2*row+1 is calculated. The taps are summed in the
+     * same order as PiiDsp::convolution() does.
+     */
+    template <class T> void decimateRows(const PiiMatrix<T>& mat,
+                                         const T* filter, int taps,
+                                         int row, T* output)
+    {
+      const int iColumns = mat.columns(), iRow = 2*row + 1;
+      std::fill(output, output + iColumns, T(0));
+      for (int i = qMax(0, iRow - mat.rows() + 1); i <= qMin(taps - 1, iRow); ++i)
+        {
+          const T* pInput = mat.row(iRow - i);
+          const T tap = filter[i];
+          for (int c=0; c<iColumns; ++c)
+            output[c] += pInput[c] * tap;
+        }
+    }
+
+    // Calculates the odd samples of the full convolution of input
+    // with filter.
+    template <class T> void decimateColumns(const T* input, int columns,
+                                            const T* filter, int taps,
+                                            T* output, int outputColumns)
+    {
+      for (int c=0; c<outputColumns; ++c)
+        {
+          const int iColumn = 2*c + 1;
+          T sum(0);
+          for (int i = qMax(0, iColumn - columns + 1); i <= qMin(taps - 1, iColumn); ++i)
+            sum += input[iColumn - i] * filter[i];
+          output[c] = sum;
+        }
+    }
+  }
 
-    // High-pass vertically
-    tmp = downSample(PiiDsp::convolution<T>(mat,hiT), Pii::Vertically, 1);
+  template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
+                                              const PiiMatrix<T>& lo,
+                                              const PiiMatrix<T>& hi,
+                                              PiiMatrix<T>& buffer)
+  {
+    const int
+      iRows = mat.rows(),
+      iColumns = mat.columns(),
+      iLoTaps = lo.columns(),
+      iHiTaps = hi.columns(),
+      // Downsampling retains every second sample of the full
+      // convolution, starting at index one.
+      iLoRows = (iRows + iLoTaps - 1) / 2,
+      iHiRows = (iRows + iHiTaps - 1) / 2,
+      iLoColumns = (iColumns + iLoTaps - 1) / 2,
+      iHiColumns = (iColumns + iHiTaps - 1) / 2;
+
+    if (iRows == 0 || iColumns == 0 || iLoTaps == 0 || iHiTaps == 0)
+      return QList<PiiMatrix<T> >() << PiiMatrix<T>() << PiiMatrix<T>() << PiiMatrix<T>() << PiiMatrix<T>();
+
+    if (buffer.rows() < iLoRows + iHiRows || buffer.columns() < iLoColumns + iHiColumns)
+      buffer = PiiMatrix<T>::uninitialized(iLoRows + iHiRows, iLoColumns + iHiColumns);
+
+    // Each row of vertical low-pass and high-pass result is stored
+    // here and immediately filtered horizontally.
+    PiiMatrix<T> matRow(PiiMatrix<T>::uninitialized(1, iColumns));
+    T* pRow = matRow.row(0);
+    const T* pLo = lo.row(0), *pHi = hi.row(0);
+
+    for (int r=0; r<iLoRows; ++r)
+      {
+        Private::decimateRows(mat, pLo, iLoTaps, r, pRow);
+        T* pTarget = buffer.row(r);
+        Private::decimateColumns(pRow, iColumns, pLo, iLoTaps, pTarget, iLoColumns);
+        Private::decimateColumns(pRow, iColumns, pHi, iHiTaps, pTarget + iLoColumns, iHiColumns);
+      }
 
-    // Vertical high-pass, horizontal low-pass (horizontal details)
-    result << downSample(PiiDsp::convolution<T>(tmp,lo), Pii::Horizontally, 1);
-    // High-pass in both directions (diagonal details)
-    result << downSample(PiiDsp::convolution<T>(tmp,hi), Pii::Horizontally, 1);
+    for (int r=0; r<iHiRows; ++r)
+      {
+        Private::decimateRows(mat, pHi, iHiTaps, r, pRow);
+        T* pTarget = buffer.row(iLoRows + r);
+        Private::decimateColumns(pRow, iColumns, pLo, iLoTaps, pTarget, iLoColumns);
+        Private::decimateColumns(pRow, iColumns, pHi, iHiTaps, pTarget + iLoColumns, iHiColumns);
+      }
 
-    return result;
+    // Immutable references to the sub-bands
+    const PiiMatrix<T>& matResult = buffer;
+    return QList<PiiMatrix<T> >()
+      // Low-pass in both directions (approximation)
+      << matResult(0, 0, iLoRows, iLoColumns)
+      // Vertical low-pass, horizontal high-pass (vertical details)
+      << matResult(0, iLoColumns, iLoRows, iHiColumns)
+      // Vertical high-pass, horizontal low-pass (horizontal details)
+      << matResult(iLoRows, 0, iHiRows, iLoColumns)
+      // High-pass in both directions (diagonal details)
+      << matResult(iLoRows, iLoColumns, iHiRows, iHiColumns);
   }
 
   template <class T> PiiMatrix<T> quadratureMirror(const PiiMatrix<T>& filter, int odd)
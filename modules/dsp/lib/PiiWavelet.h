@@ -89,6 +89,59 @@ namespace PiiDsp
   template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
                                               const PiiMatrix<T>& lo,
                                               const PiiMatrix<T>& hi);
+
+  /**
+   * Performs a two-dimensional one-level discrete wavelet transform
+   * on the input matrix, storing the result into *buffer*. The
+   * result is equal to that of the other dwt() functions, but only
+   * the coefficients that survive downsampling are calculated, and
+   * no intermediate matrices are allocated. The four sub-bands are
+   * stored in *buffer* side by side: approximation in the top left
+   * corner, vertical details on its right, horizontal details below
+   * it and diagonal details in the bottom right corner.
+   *
+   * If *buffer* is at least as large as needed, its memory will be
+   * reused. This makes it possible to perform repeated transforms
+   * without allocating memory:
+   *
+   * ~~~(c++)
+   * // Three-level decomposition with two alternating buffers.
+   * PiiMatrix<float> aBuffers[2];
+   * QList<PiiMatrix<float> > lstBands;
+   * lstBands << matImage;
+   * for (int i=0; i<3; ++i)
+   *   lstBands = PiiDsp::dwt(lstBands[0], lo, hi, aBuffers[i & 1]);
+   * ~~~
+   *
+   * Writing to *buffer* detaches it from shared data. Thus, the
+   * input matrix may not be a part of *buffer*, but results of a
+   * previous transform into the same buffer still remain valid.
+   *
+   * @param mat the input matrix
+   *
+   * @param lo low-pass decomposition filter (a row matrix)
+   *
+   * @param hi high-pass decomposition filter (a row matrix)
+   *
+   * @param buffer storage for the result
+   *
+   * @return references to the four sub-bands in *buffer*, in the
+   * same order as with the other dwt() functions.
+   */
+  template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
+                                              const PiiMatrix<T>& lo,
+                                              const PiiMatrix<T>& hi,
+                                              PiiMatrix<T>& buffer);
+
+  /**
+   * Performs a two-dimensional one-level discrete wavelet transform
+   * into *buffer* using a known wavelet family. See the other
+   * dwt() functions for details.
+   */
+  template <class T> QList<PiiMatrix<T> > dwt(const PiiMatrix<T>& mat,
+                                              WaveletFamily wavelet,
+                                              int familyMember,
+                                              PiiMatrix<T>& buffer);
   /**
    * Performs a two-dimensional one-level discrete wavelet transform
    * on the input matrix.
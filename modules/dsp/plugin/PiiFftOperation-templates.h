@@ -91,10 +91,11 @@ template <class S> void PiiFftOperation::Template<T>::operateForward(const PiiVa
   typedef typename Pii::ToFloatingPoint<S>::Type FloatType;
 
   const PiiMatrix<S>& image = obj.valueAs<PiiMatrix<S> >();
+  const PiiParallelPolicy policy(d->iTransformThreadCount);
 
   ResultType result = d->bSubtractMean ?
-    d->fft.forwardFft(Pii::matrix(image.mapped(std::minus<FloatType>(), Pii::mean<FloatType>(image)))) :
-    d->fft.forwardFft(image);
+    d->fft.forwardFft(Pii::matrix(image.mapped(std::minus<FloatType>(), Pii::mean<FloatType>(image))), policy) :
+    d->fft.forwardFft(image, policy);
 
   if (d->bShift)
     result = PiiDsp::fftShift(result);
@@ -110,5 +111,6 @@ template <class S> void PiiFftOperation::Template<T>::operateInverse(const PiiVa
 {
   PII_D;
   const PiiMatrix<std::complex<S> > image = obj.valueAs<PiiMatrix<std::complex<S> > >();
-  emitObject(d->fft.inverseFft(d->bShift ? PiiDsp::fftShift(image, true) : image));
+  emitObject(d->fft.inverseFft(d->bShift ? PiiDsp::fftShift(image, true) : image,
+                               PiiParallelPolicy(d->iTransformThreadCount)));
 }
@@ -73,6 +73,15 @@ class PiiFftOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool subtractMean READ subtractMean WRITE setSubtractMean);
 
+  /**
+   * The number of threads used for transforming one matrix. The rows
+   * and columns of large matrices are divided among the threads (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one, which transforms each matrix in the processing
+   * thread only.
+   */
+  Q_PROPERTY(int transformThreadCount READ transformThreadCount WRITE setTransformThreadCount);
+
 public:
 
   PiiFftOperation();
@@ -93,6 +102,8 @@ public:
   void setShift(bool shift);
   void setSubtractMean(bool subtractMean);
   bool subtractMean() const;
+  void setTransformThreadCount(int transformThreadCount);
+  int transformThreadCount() const;
 
   template <class T> class Template;
 
@@ -106,6 +117,7 @@ protected:
     FftDirection direction;
     bool bShift;
     bool bSubtractMean;
+    int iTransformThreadCount;
   };
   PII_D_FUNC;
 
@@ -23,7 +23,10 @@ PiiPeakDetector::Data::Data() :
   dSharpnessThreshold(0.001),
   iSmoothWidth(5),
   iWindowWidth(7),
- iLevelCorrectionWindow(0)
+  iLevelCorrectionWindow(0),
+  bStreaming(false),
+  dLowThreshold(0),
+  iBaselineWindow(0)
 {
 }
 
@@ -33,6 +36,22 @@ PiiPeakDetector::PiiPeakDetector() :
   addSocket(new PiiInputSocket("signal"));
   addSocket(new PiiOutputSocket("peaks"));
   addSocket(new PiiOutputSocket("indices"));
+
+  setProtectionLevel("streaming", WriteWhenStopped);
+  setProtectionLevel("lowThreshold", WriteWhenStopped);
+  setProtectionLevel("baselineWindow", WriteWhenStopped);
+}
+
+void PiiPeakDetector::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  d->streamDetector.setHighThreshold(d->dLevelThreshold);
+  d->streamDetector.setLowThreshold(d->dLowThreshold);
+  d->streamDetector.setBaselineWindow(d->iBaselineWindow);
+  if (reset)
+    d->streamDetector.reset();
 }
 
 void PiiPeakDetector::process()
@@ -51,12 +70,18 @@ template <class T> void PiiPeakDetector::findPeaks(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> matrix = obj.valueAs<PiiMatrix<T> >();
-  QList<PiiDsp::Peak> lstPeaks = PiiDsp::findPeaks(adjustLevel(matrix),
-                                                   d->dLevelThreshold,
-                                                   d->dSharpnessThreshold,
-                                                   d->iSmoothWidth,
-                                                   d->iWindowWidth);
+  if (d->bStreaming)
+    emitPeaks(d->streamDetector.process(matrix));
+  else
+    emitPeaks(PiiDsp::findPeaks(adjustLevel(matrix),
+                                d->dLevelThreshold,
+                                d->dSharpnessThreshold,
+                                d->iSmoothWidth,
+                                d->iWindowWidth));
+}
 
+void PiiPeakDetector::emitPeaks(const QList<PiiDsp::Peak>& lstPeaks)
+{
   PiiMatrix<double> matPeaks(lstPeaks.size(), 3);
   PiiMatrix<int> matIndices(lstPeaks.size(), 1);
   for (int i=0; i<lstPeaks.size(); ++i)
@@ -96,3 +121,9 @@ void PiiPeakDetector::setWindowWidth(int windowWidth) { _d()->iWindowWidth = win
 int PiiPeakDetector::windowWidth() const { return _d()->iWindowWidth; }
 void PiiPeakDetector::setLevelCorrectionWindow(int levelCorrectionWindow) { _d()->iLevelCorrectionWindow = levelCorrectionWindow; }
 int PiiPeakDetector::levelCorrectionWindow() const { return _d()->iLevelCorrectionWindow; }
+void PiiPeakDetector::setStreaming(bool streaming) { _d()->bStreaming = streaming; }
+bool PiiPeakDetector::streaming() const { return _d()->bStreaming; }
+void PiiPeakDetector::setLowThreshold(double lowThreshold) { _d()->dLowThreshold = lowThreshold; }
+double PiiPeakDetector::lowThreshold() const { return _d()->dLowThreshold; }
+void PiiPeakDetector::setBaselineWindow(int baselineWindow) { _d()->iBaselineWindow = baselineWindow; }
+int PiiPeakDetector::baselineWindow() const { return _d()->iBaselineWindow; }
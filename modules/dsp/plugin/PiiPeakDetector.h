@@ -18,6 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
+#include "PiiStreamingPeakDetector.h"
 
 /**
  * Detect peaks in noisy data. See PiiDsp::findPeaks() for a detailed
@@ -38,6 +39,20 @@
  * @out indices - zero-based indices of detected peaks in the original
  * signal. A N-by-1 PiiMatrix<int>.
  *
+ * Streaming
+ * ---------
+ *
+ * If [streaming] is enabled, the input signals are treated as
+ * consecutive chunks of one endless signal, and peaks are detected
+ * with PiiDsp::StreamingPeakDetector. A peak is emitted with the
+ * chunk in which it ends, and its position is counted from the
+ * first sample after reset. The indices are relative to the
+ * beginning of the current chunk and negative for peaks whose
+ * maximum was in an earlier chunk. In this mode, [levelThreshold]
+ * is the height above the baseline that starts a peak, and
+ * [lowThreshold] and [baselineWindow] control hysteresis and
+ * baseline tracking. The other properties are not used.
+ *
  */
 class PiiPeakDetector : public PiiDefaultOperation
 {
@@ -69,6 +84,20 @@ class PiiPeakDetector : public PiiDefaultOperation
    * over this many elements. The default value is 0.
    */
   Q_PROPERTY(int levelCorrectionWindow READ levelCorrectionWindow WRITE setLevelCorrectionWindow);
+  /**
+   * Enables the streaming mode. The default is `false`.
+   */
+  Q_PROPERTY(bool streaming READ streaming WRITE setStreaming);
+  /**
+   * The height above the baseline below which a peak ends in
+   * streaming mode. The default value is 0.
+   */
+  Q_PROPERTY(double lowThreshold READ lowThreshold WRITE setLowThreshold);
+  /**
+   * The time constant of the baseline estimate in streaming mode, in
+   * samples. Zero (the default) fixes the baseline at zero.
+   */
+  Q_PROPERTY(int baselineWindow READ baselineWindow WRITE setBaselineWindow);
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
@@ -84,6 +113,14 @@ public:
   int windowWidth() const;
   void setLevelCorrectionWindow(int levelCorrectionWindow);
   int levelCorrectionWindow() const;
+  void setStreaming(bool streaming);
+  bool streaming() const;
+  void setLowThreshold(double lowThreshold);
+  double lowThreshold() const;
+  void setBaselineWindow(int baselineWindow);
+  int baselineWindow() const;
+
+  void check(bool reset);
 
 protected:
   void process();
@@ -91,6 +128,7 @@ protected:
 private:
   template <class T> void findPeaks(const PiiVariant& obj);
   template <class T> PiiMatrix<double> adjustLevel(const PiiMatrix<T>& matrix);
+  void emitPeaks(const QList<PiiDsp::Peak>& peaks);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -103,6 +141,10 @@ private:
     int iSmoothWidth;
     int iWindowWidth;
     int iLevelCorrectionWindow;
+    bool bStreaming;
+    double dLowThreshold;
+    int iBaselineWindow;
+    PiiDsp::StreamingPeakDetector streamDetector;
   };
   PII_D_FUNC;
 };
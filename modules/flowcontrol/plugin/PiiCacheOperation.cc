@@ -16,12 +16,32 @@
 #include "PiiCacheOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiWireFormat.h>
+#include <PiiSerializationException.h>
+#include <PiiSynchronized.h>
+#include <QCryptographicHash>
+#include <QWeakPointer>
+#include <QHash>
+#include <QFile>
+
+namespace
+{
+  // Shared caches by name. The caches are destroyed when the last
+  // operation using them is deleted.
+  QMutex registryMutex;
+  QHash<QString, QWeakPointer<PiiObjectCache> > hashSharedCaches;
+
+  // Serializes concurrent saves of a shared cache.
+  QMutex fileMutex;
+}
 
 PiiCacheOperation::Data::Data() :
   iMaxBytes(2*1024*1024),
   iMaxObjects(0),
   bAllowOrderChanges(false),
-  iConsumedMemory(0)
+  replacementPolicy(Lru),
+  iShardCount(1),
+  bConfigChanged(true)
 {
 }
 
@@ -30,12 +50,148 @@ PiiCacheOperation::PiiCacheOperation() :
 {
   PII_D;
   addSocket(d->pKeyInput = new PiiInputSocket("key"));
+  addSocket(d->pObjectInput = new PiiInputSocket("object"));
+  d->pObjectInput->setOptional(true);
   addSocket(d->pDataInput = new PiiInputSocket("data"));
   d->pDataInput->setOptional(true);
+  // Data is requested asynchronously.
+  d->pDataInput->setGroupId(1);
 
   addSocket(d->pFoundOutput = new PiiOutputSocket("found"));
   addSocket(d->pKeyOutput = new PiiOutputSocket("key"));
   addSocket(d->pDataOutput = new PiiOutputSocket("data"));
+  for (int i=0; i<outputCount(); ++i)
+    outputAt(i)->setGroupId(-1);
+
+  setProtectionLevel("shardCount", WriteWhenStopped);
+  setProtectionLevel("cacheName", WriteWhenStopped);
+  setProtectionLevel("cacheFile", WriteWhenStopped);
+}
+
+void PiiCacheOperation::check(bool reset)
+{
+  PiiDefaultOperation::check(reset);
+
+  PII_D;
+  if (reset)
+    {
+      d->queRequests.clear();
+      d->setPendingKeys.clear();
+    }
+  // The cache survives restarts unless it needs to be reconfigured.
+  if (d->pCache.isNull() || d->bConfigChanged)
+    createCache();
+}
+
+void PiiCacheOperation::createCache()
+{
+  PII_D;
+  QSharedPointer<PiiObjectCache> pCache;
+  synchronized (registryMutex)
+    {
+      if (!d->strCacheName.isEmpty())
+        {
+          pCache = hashSharedCaches.value(d->strCacheName).toStrongRef();
+          if (pCache.isNull())
+            hashSharedCaches.remove(d->strCacheName);
+        }
+      if (pCache.isNull())
+        {
+          pCache = QSharedPointer<PiiObjectCache>(new PiiObjectCache);
+          pCache->reset(d->iShardCount,
+                        PiiObjectCache::ReplacementPolicy(d->replacementPolicy),
+                        d->iMaxBytes, d->iMaxObjects);
+          synchronized (d->cacheMutex) d->pCache = pCache;
+          loadCache();
+          if (!d->strCacheName.isEmpty())
+            hashSharedCaches.insert(d->strCacheName, pCache.toWeakRef());
+        }
+      else
+        synchronized (d->cacheMutex) d->pCache = pCache;
+    }
+  d->bConfigChanged = false;
+}
+
+void PiiCacheOperation::loadCache()
+{
+  PII_D;
+  if (d->strCacheFile.isEmpty() || !QFile::exists(d->strCacheFile))
+    return;
+
+  QFile file(d->strCacheFile);
+  if (!file.open(QIODevice::ReadOnly))
+    PII_THROW(PiiExecutionException, tr("Cannot open cache file %1 for reading.").arg(d->strCacheFile));
+  try
+    {
+      d->pCache->load(&file);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      PII_THROW(PiiExecutionException, tr("Cannot read cache file %1: %2").arg(d->strCacheFile).arg(ex.message()));
+    }
+}
+
+void PiiCacheOperation::saveCache()
+{
+  PII_D;
+  if (d->strCacheFile.isEmpty() || d->pCache.isNull())
+    return;
+
+  // Write to a temporary file first so that a failure won't destroy
+  // the previous contents.
+  QMutexLocker lock(&fileMutex);
+  QString strTmpFile = d->strCacheFile + ".tmp";
+  QFile file(strTmpFile);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      piiWarning(tr("Cannot open cache file %1 for writing.").arg(strTmpFile));
+      return;
+    }
+  try
+    {
+      d->pCache->save(&file);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      piiWarning(tr("Cannot write cache file %1: %2").arg(strTmpFile).arg(ex.message()));
+      file.close();
+      QFile::remove(strTmpFile);
+      return;
+    }
+  file.close();
+  QFile::remove(d->strCacheFile);
+  if (!QFile::rename(strTmpFile, d->strCacheFile))
+    piiWarning(tr("Cannot rename %1 to %2.").arg(strTmpFile).arg(d->strCacheFile));
+}
+
+void PiiCacheOperation::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    saveCache();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+QString PiiCacheOperation::cacheKey(const PiiVariant& obj) const
+{
+  QString strKey = PiiYdin::convertToQString(obj);
+  if (!strKey.isNull())
+    return strKey;
+  try
+    {
+      return "#" + QString::fromLatin1(QCryptographicHash::hash(PiiWireFormat::encode(obj),
+                                                                QCryptographicHash::Sha1).toHex());
+    }
+  catch (PiiSerializationException&)
+    {
+      PII_THROW_UNKNOWN_TYPE(_d()->pKeyInput);
+    }
+}
+
+void PiiCacheOperation::emitResult(bool found, const PiiVariant& value)
+{
+  PII_D;
+  d->pFoundOutput->emitObject(found ? 1 : 0);
+  d->pDataOutput->emitObject(value);
 }
 
 void PiiCacheOperation::process()
@@ -43,26 +199,112 @@ void PiiCacheOperation::process()
   PII_D;
   if (activeInputGroup() == d->pKeyInput->groupId())
     {
-      QString strKey = PiiYdin::convertToQString(d->pKeyInput);
-      QHash<QString,PiiVariant>::iterator i = d->hashObjects.find(strKey);
-      if (i != d->hashObjects.end())
-        d->pDataOutput->emitObject(i.value());
+      QString strKey = cacheKey(d->pKeyInput->firstObject());
+      PiiVariant value;
+      if (d->pCache->find(strKey, &value))
+        {
+          if (d->bAllowOrderChanges || d->queRequests.isEmpty())
+            emitResult(true, value);
+          else
+            d->queRequests.enqueue(Request(strKey, true, true, value));
+        }
+      // The data is already being calculated.
+      else if (d->setPendingKeys.contains(strKey))
+        d->queRequests.enqueue(Request(strKey, true));
       else
-        d->hashObjects.insert(strKey, d->pDataInput->firstObject());
+        {
+          d->queRequests.enqueue(Request(strKey));
+          d->setPendingKeys << strKey;
+          d->pKeyOutput->emitObject(d->pObjectInput->isConnected() ?
+                                    d->pObjectInput->firstObject() :
+                                    d->pKeyInput->firstObject());
+        }
+    }
+  else
+    {
+      if (d->queRequests.isEmpty())
+        PII_THROW(PiiExecutionException, tr("Received data although no key is waiting for it."));
+
+      // Misses are resolved in order, and hits that came after a
+      // miss can be released once it is resolved.
+      PiiVariant value = d->pDataInput->firstObject();
+      Request request = d->queRequests.dequeue();
+      d->setPendingKeys.remove(request.strKey);
+      d->pCache->insert(request.strKey, value);
+      emitResult(false, value);
+
+      // Answer repeated requests for the same key.
+      for (int i=0; i<d->queRequests.size(); )
+        {
+          Request& waiting = d->queRequests[i];
+          if (!waiting.bReady && waiting.strKey == request.strKey)
+            {
+              if (d->bAllowOrderChanges)
+                {
+                  d->queRequests.removeAt(i);
+                  emitResult(true, value);
+                  continue;
+                }
+              waiting.value = value;
+              waiting.bReady = true;
+            }
+          ++i;
+        }
+
+      while (!d->queRequests.isEmpty() && d->queRequests.head().bReady)
+        {
+          request = d->queRequests.dequeue();
+          emitResult(true, request.value);
+        }
     }
-  /*
-    int iSize = 64;
-    if (PiiYdin::isMatrixType(obj.type()))
-    iSize += PiiYdin::matrixRows(obj) * PiiYdin::matrixStride(obj);
-    else
-    PII_THROW_UNKNOWN_TYPE(inputAt(0));
-  */
 }
 
+QVariantMap PiiCacheOperation::statistics() const
+{
+  QVariantMap mapStats = PiiDefaultOperation::statistics();
+  const PII_D;
+  QSharedPointer<PiiObjectCache> pCache;
+  synchronized (d->cacheMutex) pCache = d->pCache;
+  if (pCache.isNull())
+    return mapStats;
+  QVariantMap mapCache;
+  mapCache["hits"] = pCache->hits();
+  mapCache["misses"] = pCache->misses();
+  mapCache["evictions"] = pCache->evictions();
+  mapCache["objects"] = pCache->count();
+  mapCache["bytes"] = pCache->bytes();
+  mapStats["cache"] = mapCache;
+  return mapStats;
+}
+
+void PiiCacheOperation::resetStatistics()
+{
+  PiiDefaultOperation::resetStatistics();
+  PII_D;
+  synchronized (d->cacheMutex)
+    if (!d->pCache.isNull())
+      d->pCache->resetStatistics();
+}
+
+void PiiCacheOperation::clear()
+{
+  PII_D;
+  synchronized (d->cacheMutex)
+    if (!d->pCache.isNull())
+      d->pCache->clear();
+}
 
-void PiiCacheOperation::setMaxBytes(int maxBytes) { _d()->iMaxBytes = maxBytes; }
+void PiiCacheOperation::setMaxBytes(int maxBytes) { _d()->iMaxBytes = maxBytes; _d()->bConfigChanged = true; }
 int PiiCacheOperation::maxBytes() const { return _d()->iMaxBytes; }
-void PiiCacheOperation::setMaxObjects(int maxObjects) { _d()->iMaxObjects = maxObjects; }
+void PiiCacheOperation::setMaxObjects(int maxObjects) { _d()->iMaxObjects = maxObjects; _d()->bConfigChanged = true; }
 int PiiCacheOperation::maxObjects() const { return _d()->iMaxObjects; }
 void PiiCacheOperation::setAllowOrderChanges(bool allowOrderChanges) { _d()->bAllowOrderChanges = allowOrderChanges; }
 bool PiiCacheOperation::allowOrderChanges() const { return _d()->bAllowOrderChanges; }
+void PiiCacheOperation::setReplacementPolicy(ReplacementPolicy replacementPolicy) { _d()->replacementPolicy = replacementPolicy; _d()->bConfigChanged = true; }
+PiiCacheOperation::ReplacementPolicy PiiCacheOperation::replacementPolicy() const { return _d()->replacementPolicy; }
+void PiiCacheOperation::setShardCount(int shardCount) { _d()->iShardCount = qMax(shardCount, 1); _d()->bConfigChanged = true; }
+int PiiCacheOperation::shardCount() const { return _d()->iShardCount; }
+void PiiCacheOperation::setCacheName(const QString& cacheName) { _d()->strCacheName = cacheName; _d()->bConfigChanged = true; }
+QString PiiCacheOperation::cacheName() const { return _d()->strCacheName; }
+void PiiCacheOperation::setCacheFile(const QString& cacheFile) { _d()->strCacheFile = cacheFile; _d()->bConfigChanged = true; }
+QString PiiCacheOperation::cacheFile() const { return _d()->strCacheFile; }
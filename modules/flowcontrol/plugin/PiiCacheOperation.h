@@ -17,10 +17,11 @@
 #define _PIICACHEOPERATION_H
 
 #include <PiiDefaultOperation.h>
-#include <QLinkedList>
-#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QSharedPointer>
 
-#include <PiiMatrix.h>
+#include "PiiObjectCache.h"
 
 /**
  * An operation that caches processing results. PiiCacheOperation can
@@ -28,9 +29,6 @@
  * than once. The most typical use is in caching feature vectors used
  * for training a classifier.
  *
- * ! The implementation of this operation is still incomplete.
- * Don't use.
- *
  * The cache works by associating each cached object with a *key*.
  * Whenever a key is received, the cache is searched for an
  * occurrence. If a hit is found, it will be sent to the `data`
@@ -45,16 +43,51 @@
  * object that will be sent back to the cache to be associated with
  * the key.
  *
+ * ~~~
+ * key ---> [cache] -key--> [feature extractor] --+
+ *            ^  |                                 |
+ *            |  +-data--> [classifier]            |
+ *            +------------------------------------+ data
+ * ~~~
+ *
+ * The cache keeps its contents over restarts of the engine. In
+ * repeated training runs over the same image set, the feature
+ * extractor only runs on the first pass. If [cacheFile] is set, the
+ * contents are also stored to disk and restored on the next start.
+ * Several operations can share a cache by giving it a [cacheName].
+ *
+ * If a key is requested again while its data is still being
+ * calculated, the key is not emitted again. The request is answered
+ * from the data that is on its way. PiiImageHasher uses this to
+ * replay the results of the first frame of a stopped production line
+ * for all subsequent frames.
+ *
+ * In addition to timing, [statistics()] returns a map called
+ * "cache" with the following keys: "hits", "misses", "evictions"
+ * (number of objects removed from the cache to make space),
+ * "objects" (number of objects in cache) and "bytes" (estimated
+ * memory usage).
+ *
+ * The outputs are not synchronized to the inputs.
+ * Synchronization tags are not passed. Thus, the cache should be
+ * used on flow level zero.
+ *
  * Inputs
  * ------
  *
- * @in key - a cache key that uniquely identifies data in the cache. A
- * QString or a primitive type that is convertible to a QString.
+ * @in key - a cache key that uniquely identifies data in the cache.
+ * Primitive types and QStrings are converted to strings. Any other
+ * serializable type, e.g. an image, is identified by the SHA-1 hash
+ * of its contents.
+ *
+ * @in object - an optional input that is passed to the `key` output
+ * instead of the key. This makes it possible to use e.g. a hash of
+ * an image as the key, but to calculate the data from the image
+ * itself. Any type.
  *
  * @in data - the data associated with key. Any type. Note that this
  * input is not synchronous to `key`. It must receive an object if
- * and only if the `key` output emits an object. Objects in this
- * input will be passed directly to the `data` output.
+ * and only if the `key` output emits an object, in the same order.
  *
  * Outputs
  * -------
@@ -63,8 +96,9 @@
  * or not (0 = not found, 1 = found). This output can be used as a
  * control signal to a PiiDemuxOperation.
  *
- * @out key - passes the object in the `key` input, if the key was
- * not found in cache.
+ * @out key - passes the object in the `key` input (or in the `object`
+ * input, if connected), if the key was not found in cache and is not
+ * already waiting for data.
  *
  * @out data - the data associated with the key input, if found in the
  * cache. In the case of a cache miss, an object received in the
@@ -77,15 +111,12 @@ class PiiCacheOperation : public PiiDefaultOperation
 
   /**
    * The maximum number of bytes the cache is allowed to occupy. The
-   * operation recognizes all primitive types, complex numbers, and
-   * matrices composed of them. It also knows QStrings. The number of
-   * bytes an object occupies is an approximation because memory
-   * allocation techniques vary. The operation uses an estimate of 32
-   * bytes per each object (const PiiVariant&). If the object is a
-   * primitive type, additional 32 bytes will be assumed. If it is a
-   * matrix, 32 bytes + sizeof(T) * rows * columns will be assumed.
-   * The size of a QString is assumed to be 32 + two times its length.
-   * Zero means no limit. The default is 2 Mb.
+   * number of bytes is an estimate because memory allocation
+   * techniques vary. For matrices and images, the estimate includes
+   * the allocated rows with their padding and the matrix header. For
+   * strings, it includes the allocated characters. Other objects are
+   * estimated by the size of their serialized representation. Zero
+   * means no limit. The default is 2 Mb.
    */
   Q_PROPERTY(int maxBytes READ maxBytes WRITE setMaxBytes);
 
@@ -101,44 +132,141 @@ class PiiCacheOperation : public PiiDefaultOperation
    * away. Normally, this is however not done until all data related
    * to previously received requests has been handled to avoid
    * synchronization problems. If it doesn't matter in which order the
-   * objects are sent, setting this flag to `true` may increase
-   * processing speed on multi-core machines.
+   * objects are sent, setting this flag to `true` reduces latency.
    */
   Q_PROPERTY(bool allowOrderChanges READ allowOrderChanges WRITE setAllowOrderChanges);
 
+  /**
+   * The policy used in selecting the objects to remove when the cache
+   * is full. The default is `Lru`.
+   */
+  Q_PROPERTY(ReplacementPolicy replacementPolicy READ replacementPolicy WRITE setReplacementPolicy);
+  Q_ENUMS(ReplacementPolicy);
+
+  /**
+   * The number of independently locked parts the cache is divided
+   * into. Sharding reduces lock contention if the cache is shared by
+   * many operations running in parallel (see [cacheName]). The size
+   * limits are divided evenly among the shards. An object larger
+   * than `maxBytes / shardCount` will not be cached. The default is
+   * one.
+   */
+  Q_PROPERTY(int shardCount READ shardCount WRITE setShardCount);
+
+  /**
+   * The name of a shared cache. Operations with the same non-empty
+   * name use the same cache. This makes it possible, for example, to
+   * put a cache into each replica of a PiiWorkerFarm worker and still
+   * calculate each result only once. The first operation that is
+   * started creates the cache with its own size limits, policy and
+   * [cacheFile]; these properties are ignored in the others. The
+   * default is an empty string, which gives each operation a private
+   * cache.
+   */
+  Q_PROPERTY(QString cacheName READ cacheName WRITE setCacheName);
+
+  /**
+   * The name of a file the cache is stored in. If this property is
+   * set, the cache will be loaded from the file when it is created,
+   * and saved to it whenever the operation stops. Objects that
+   * cannot be serialized will not be saved. The default is an empty
+   * string, which disables persistence.
+   */
+  Q_PROPERTY(QString cacheFile READ cacheFile WRITE setCacheFile);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Replacement policies.
+   *
+   * - `Lru` - the least recently used object is removed first.
+   *
+   * - `Arc` - adaptive replacement cache. Objects that have been
+   * requested more than once are kept separately from those
+   * requested only once, and the space allocated to each group
+   * adapts to the request pattern. Better than `Lru` if the set of
+   * keys is larger than the cache.
+   */
+  enum ReplacementPolicy { Lru, Arc };
+
   PiiCacheOperation();
 
+  void check(bool reset);
+
+  QVariantMap statistics() const;
+  void resetStatistics();
+
+  /**
+   * Removes all objects from the cache.
+   */
+  Q_INVOKABLE void clear();
+
   void setMaxBytes(int maxBytes);
   int maxBytes() const;
   void setMaxObjects(int maxObjects);
   int maxObjects() const;
   void setAllowOrderChanges(bool allowOrderChanges);
   bool allowOrderChanges() const;
+  void setReplacementPolicy(ReplacementPolicy replacementPolicy);
+  ReplacementPolicy replacementPolicy() const;
+  void setShardCount(int shardCount);
+  int shardCount() const;
+  void setCacheName(const QString& cacheName);
+  QString cacheName() const;
+  void setCacheFile(const QString& cacheFile);
+  QString cacheFile() const;
 
 protected:
   void process();
+  void aboutToChangeState(State state);
 
 private:
+  struct Request
+  {
+    Request(const QString& key = QString(), bool found = false, bool ready = false,
+            const PiiVariant& value = PiiVariant()) :
+      strKey(key), bFound(found), bReady(ready), value(value)
+    {}
+    QString strKey;
+    // False if the data is calculated for this request.
+    bool bFound;
+    bool bReady;
+    PiiVariant value;
+  };
+
+  QString cacheKey(const PiiVariant& obj) const;
+  void emitResult(bool found, const PiiVariant& value);
+  void createCache();
+  void loadCache();
+  void saveCache();
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
   public:
     Data();
-    PiiInputSocket* pKeyInput, *pDataInput;
+    PiiInputSocket* pKeyInput, *pObjectInput, *pDataInput;
     PiiOutputSocket* pFoundOutput, *pKeyOutput, *pDataOutput;
     int iMaxBytes;
     int iMaxObjects;
     bool bAllowOrderChanges;
+    ReplacementPolicy replacementPolicy;
+    int iShardCount;
+    QString strCacheName;
+    QString strCacheFile;
 
-    int iConsumedMemory;
+    // Set when a property that affects the cache changes.
+    bool bConfigChanged;
+    mutable QMutex cacheMutex;
+    QSharedPointer<PiiObjectCache> pCache;
 
-    QHash<QString, PiiVariant> hashObjects;
-    QLinkedList<QString> lstKeys;
+    // Results waiting for earlier misses to be resolved. The first
+    // entry is always an unresolved miss.
+    QQueue<Request> queRequests;
+    // Keys emitted but whose data has not been received yet.
+    QSet<QString> setPendingKeys;
   };
   PII_D_FUNC;
-
 };
 
 
@@ -16,12 +16,28 @@
 #include "PiiDemuxOperation.h"
 #include <PiiYdinTypes.h>
 
+PiiDemuxOperation::Data::Data() :
+  iLaneCapacity(0)
+{
+}
+
 PiiDemuxOperation::PiiDemuxOperation() :
   PiiDefaultOperation(new Data)
 {
   addSocket(new PiiInputSocket("control"));
   addSocket(new PiiInputSocket("input"));
   setDynamicOutputCount(2);
+
+  setProtectionLevel("laneCapacity", WriteWhenStoppedOrPaused);
+}
+
+void PiiDemuxOperation::check(bool reset)
+{
+  PII_D;
+  for (int i=0; i<outputCount(); ++i)
+    outputAt(i)->setLaneCapacity(d->iLaneCapacity);
+
+  PiiDefaultOperation::check(reset);
 }
 
 void PiiDemuxOperation::setDynamicOutputCount(int cnt)
@@ -31,6 +47,8 @@ void PiiDemuxOperation::setDynamicOutputCount(int cnt)
 }
 
 int PiiDemuxOperation::dynamicOutputCount() const { return outputCount(); }
+void PiiDemuxOperation::setLaneCapacity(int laneCapacity) { _d()->iLaneCapacity = qMax(0, laneCapacity); }
+int PiiDemuxOperation::laneCapacity() const { return _d()->iLaneCapacity; }
 
 void PiiDemuxOperation::process()
 {
@@ -44,6 +44,15 @@
  * advisable to always couple PiiDemuxOperation with a PiiMuxOperation
  * that is controlled by the same control signal.
  *
+ * By default, objects are passed to the selected output in the
+ * thread that runs the demultiplexer. If the receiver of one output
+ * is busy, the next object waits even if it goes to an idle branch.
+ * Setting [laneCapacity] to a positive value gives each output its
+ * own emission lane (see PiiOutputSocket::setLaneCapacity()). A
+ * heavy branch, such as defect classification, then only delays the
+ * objects routed to itself, and a lightweight branch keeps running
+ * until the heavy branch has *laneCapacity* objects waiting.
+ *
  * Inputs
  * ------
  *
@@ -71,15 +80,36 @@ class PiiDemuxOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(int dynamicOutputCount READ dynamicOutputCount WRITE setDynamicOutputCount);
 
+  /**
+   * The maximum number of objects waiting in the emission lane of
+   * each output. Zero disables lanes, and objects are passed in the
+   * processing thread. The default value is zero.
+   */
+  Q_PROPERTY(int laneCapacity READ laneCapacity WRITE setLaneCapacity);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiDemuxOperation();
 
   void setDynamicOutputCount(int count);
   int dynamicOutputCount() const;
+  void setLaneCapacity(int laneCapacity);
+  int laneCapacity() const;
+
+  void check(bool reset);
 
 protected:
   void process();
+
+private:
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    int iLaneCapacity;
+  };
+  PII_D_FUNC;
 };
 
 
@@ -23,6 +23,7 @@
 #include "PiiObjectRateChanger.h"
 #include "PiiObjectReplicator.h"
 #include "PiiCacheOperation.h"
+#include "PiiWorkerFarm.h"
 
 PII_IMPLEMENT_PLUGIN(PiiFlowControlPlugin);
 
@@ -34,3 +35,6 @@ PII_REGISTER_OPERATION(PiiFrequencyCounter);
 PII_REGISTER_OPERATION(PiiObjectRateChanger);
 PII_REGISTER_OPERATION(PiiObjectReplicator);
 PII_REGISTER_OPERATION(PiiCacheOperation);
+PII_REGISTER_COMPOUND(PiiWorkerFarm);
+PII_REGISTER_OPERATION(PiiWorkerFarmDispatcher);
+PII_REGISTER_OPERATION(PiiWorkerFarmCollector);
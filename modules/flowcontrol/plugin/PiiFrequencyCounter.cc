@@ -21,69 +21,9 @@
 
 #define FREQCOUNTER_NEW_WEIGHT 0.1
 #define FREQCOUNTER_OLD_WEIGHT 0.9
-// Maximum sleeping time for PiiFreOutputEmitter in milliseconds.
-#define FREQOUTPUTEMITTTER_MAX_SLEEP_TIME 1000
-
-
-PiiFreqOutputEmitter::PiiFreqOutputEmitter(PiiFrequencyCounter *parent) :
-  QThread(parent), _pParent(parent), _pParentData(parent->_d()), _bRunning(false)
-{
-  //qDebug("PiiFreqOutputEmitter, constructor, _pParent->_iMeasurementInterval = %d", _pParent->_iMeasurementInterval);
-  _iSleepDuration = qMin(_pParentData->iMeasurementInterval , (unsigned int)FREQOUTPUTEMITTTER_MAX_SLEEP_TIME);
-
-  //qDebug("PiiFreqOutputEmitter, constructor, _iSleepDuration = %d", _iSleepDuration);
-}
-
-void PiiFreqOutputEmitter::run()
-{
-  //qDebug("PiiFreqOutputEmitter::run() BEGIN");
-  setPriority(LowestPriority);
-  _pParentData->measurementTime.start();
-  while ( _bRunning )
-    {
-      //qDebug("PiiFreqOutputEmitter::run(), in the beginning of while");
-      int elapsed = _pParentData->measurementTime.elapsed();
-      if (elapsed >= (int)_pParentData->iMeasurementInterval)
-         {
-           emitFrequency(elapsed);
-           _pParentData->measurementTime.restart();
-         }
-      else
-        {
-          // Let's make sure that the sleeping time is not too long.
-          unsigned int timeToNextEmission = _pParentData->iMeasurementInterval - elapsed;
-          unsigned int sleepDuration = _iSleepDuration == 0 ? 0 : qMin(_iSleepDuration,  timeToNextEmission);
-          //qDebug("PiiFreqOutputEmitter::run() timeToNextEmission = %d", timeToNextEmission);
-          //qDebug("PiiFreqOutputEmitter::run(), sleeping = %d mseconds", sleepDuration);
-          msleep(sleepDuration);
-        }
-
-    }
-  //qDebug("PiiFreqOutputEmitter::run() END");
-}
-
-void PiiFreqOutputEmitter::emitFrequency(int elapsed)
-{
-  //qDebug("PiiFreqOutputEmitter::emitFrequency(), BEGIN elapsed = %d", elapsed);
-
-  // This if is is to make sure, that nothing is emitted, once the
-  // engine is in paused state. It also avoids a crash after the
-  // engine has been interrupted.
-  if (_pParent->state() == PiiOperation::Running)
-    {
-      //qDebug("                                       _pParent->_iFrequencyCounter = %d", _pParent->_iFrequencyCounter);
-      int hitsPerSecond = int((double)1000/(double)elapsed*_pParentData->iFrequencyCounter);
-      _pParentData->pFreqOutput->emitObject(hitsPerSecond);
-      _pParentData->iFrequencyCounter = 0;
-      //qDebug("PiiFreqOutputEmitter::emitFrequency(),  hitsPerSecond = %d", hitsPerSecond);
-    }
-
-  //qDebug("PiiFreqOutputEmitter::emitFrequency(), END");
-}
 
 PiiFrequencyCounter::Data::Data(PiiFrequencyCounter*) :
   iMeasurementInterval(1000),
-  pEmitter(0),
   iFilterInterval(0),
   dMeasurementFrequency(1),
   dMeanInterval(0.0),
@@ -108,15 +48,14 @@ PiiFrequencyCounter::PiiFrequencyCounter() :
   setDynamicInputCount(1);
 
   connect(this, SIGNAL(stateChanged(PiiOperation::State)), this, SLOT(stateChangeOccured(PiiOperation::State)));
-  d->pEmitter = new PiiFreqOutputEmitter(this);
+  // The timeout is delivered through this object's event loop, which
+  // keeps a blocking output from stalling the timer thread.
+  connect(&d->measurementTimer, SIGNAL(timeout()), this, SLOT(emitFrequency()));
 }
 
 PiiFrequencyCounter::~PiiFrequencyCounter()
 {
-  PII_D;
-  d->pEmitter->stop();
-  d->pEmitter->wait();
-  delete d->pEmitter;
+  _d()->measurementTimer.stop();
 }
 
 void PiiFrequencyCounter::setDynamicInputCount(int inputCount)
@@ -222,8 +161,11 @@ void PiiFrequencyCounter::process()
 void PiiFrequencyCounter::start()
 {
   PII_D;
-  if (d->bFrequencyOutputConnected && d->state == Stopped)
-    d->pEmitter->startThread();
+  if (d->bFrequencyOutputConnected && d->state == Stopped && d->iMeasurementInterval > 0)
+    {
+      d->measurementTime.start();
+      d->measurementTimer.start(d->iMeasurementInterval);
+    }
 
   PiiDefaultOperation::start();
 }
@@ -243,15 +185,25 @@ void PiiFrequencyCounter::check(bool reset)
   d->bFrequencyOutputConnected = d->pFreqOutput->isConnected();
 }
 
-/* This private slot takes care of stopping the execution of the
- *  emitter thread. */
+/* This private slot takes care of stopping the measurement timer. */
 void PiiFrequencyCounter::stateChangeOccured(PiiOperation::State state)
 {
-  PII_D;
   if (state == Stopped)
+    _d()->measurementTimer.stop();
+}
+
+void PiiFrequencyCounter::emitFrequency()
+{
+  PII_D;
+  int iElapsed = d->measurementTime.restart();
+  // This if is is to make sure, that nothing is emitted, once the
+  // engine is in paused state. It also avoids a crash after the
+  // engine has been interrupted.
+  if (state() == PiiOperation::Running && iElapsed > 0)
     {
-      d->pEmitter->stop();
-      d->pEmitter->wait();
+      int hitsPerSecond = int((double)1000/(double)iElapsed*d->iFrequencyCounter);
+      d->pFreqOutput->emitObject(hitsPerSecond);
+      d->iFrequencyCounter = 0;
     }
 }
 
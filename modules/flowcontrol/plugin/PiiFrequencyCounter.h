@@ -17,11 +17,10 @@
 #define _PIIFREQUENCYCOUNTER_H
 
 #include <PiiDefaultOperation.h>
-#include <QThread>
+#include <PiiThreadSafeTimer.h>
 #include <QTime>
 
 class PiiOutputSocket;
-class PiiFreqOutputEmitter;
 
 /**
  * Limits object rate based on frequency. This operation can be used
@@ -95,38 +94,14 @@ protected:
 
 private slots:
   void stateChangeOccured(PiiOperation::State state);
+  /* Emits the frequency output. */
+  void emitFrequency();
 
 private:
-  friend class PiiFreqOutputEmitter;
-
   class Data;
   PII_UNSAFE_D_FUNC;
 };
 
-/// @internal
-class PiiFreqOutputEmitter : public QThread
-{
-public:
-  PiiFreqOutputEmitter(PiiFrequencyCounter* parent);
-
-  /* Stops the thread.  */
-  void stop() { _bRunning = false; }
-  void startThread() { _bRunning = true; start(); }
-
-protected:
-  void run();
-
-private:
-  // Sleeping time in milliseconds
-  unsigned int _iSleepDuration;
-  PiiFrequencyCounter* _pParent;
-  PiiFrequencyCounter::Data* _pParentData;
-  volatile bool _bRunning;
-
-  /* Emits the frequency output. */
-  void emitFrequency(int elapsed);
-};
-
 class PiiFrequencyCounter::Data : public PiiDefaultOperation::Data
 {
 public:
@@ -135,7 +110,8 @@ public:
   // is emitted. Calculated from dMeasurementFrequency
   unsigned int iMeasurementInterval;
 
-  PiiFreqOutputEmitter *pEmitter;
+  // Times the "frequency" output on the global timer thread.
+  PiiThreadSafeTimer measurementTimer;
   double dMaxFrequency;
   // The interval (in mill seconds), how often the outputs are emitted.
   // The value is calculated from dMaxFrequency.
@@ -0,0 +1,464 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiObjectCache.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiMatrix.h>
+#include <PiiWireFormat.h>
+#include <PiiSerializationException.h>
+#include <QIODevice>
+#include <QList>
+#include <QPair>
+
+namespace
+{
+  // The four lists of the adaptive replacement cache. LRU uses only
+  // RecentList.
+  enum ListIndex { RecentList, FrequentList, RecentGhosts, FrequentGhosts, ListCount };
+
+  const char* pFileHeader = "PiiObjectCache/1";
+
+  // Shard i gets its share of total plus one if i is less than the
+  // remainder. Zero means no limit.
+  template <class T> T shareOf(T total, int shard, int shardCount)
+  {
+    if (total <= 0)
+      return 0;
+    return qMax(T(1), T(total / shardCount + (shard < total % shardCount ? 1 : 0)));
+  }
+}
+
+class PiiObjectCache::Shard
+{
+public:
+  struct Entry
+  {
+    QString strKey;
+    PiiVariant value;
+    qint64 iBytes;
+    int iList;
+    Entry* pPrev, *pNext;
+  };
+
+  // Head is the most recently used entry.
+  struct List
+  {
+    List() : pHead(0), pTail(0), iCount(0), iBytes(0) {}
+    Entry* pHead, *pTail;
+    int iCount;
+    qint64 iBytes;
+  };
+
+  Shard(ReplacementPolicy policy, qint64 maxBytes, int maxObjects);
+  ~Shard();
+
+  void clear();
+  bool find(const QString& key, PiiVariant* value);
+  void insert(const QString& key, const PiiVariant& value, qint64 bytes);
+  // Returns resident entries, least recently used first.
+  QList<QPair<QString,PiiVariant> > entries() const;
+
+  int residentCount() const { return _lists[RecentList].iCount + _lists[FrequentList].iCount; }
+  qint64 residentBytes() const { return _lists[RecentList].iBytes + _lists[FrequentList].iBytes; }
+
+  mutable QMutex mutex;
+  ReplacementPolicy policy;
+  qint64 iMaxBytes;
+  int iMaxObjects;
+  qint64 iHits, iMisses, iEvictions;
+
+private:
+  // ARC balances the lists either in bytes or in objects, depending
+  // on which limit is in effect.
+  qint64 weightOf(qint64 bytes) const { return iMaxBytes > 0 ? bytes : 1; }
+  qint64 listWeight(int list) const { return iMaxBytes > 0 ? _lists[list].iBytes : _lists[list].iCount; }
+  qint64 capacity() const { return iMaxBytes > 0 ? iMaxBytes : iMaxObjects; }
+  bool isFull() const;
+
+  void unlink(Entry* entry);
+  void pushFront(Entry* entry, int list);
+  void drop(Entry* entry);
+  void evict(Entry* keep, bool frequentGhostHit);
+  void trimGhosts();
+
+  QHash<QString,Entry*> _hashEntries;
+  List _lists[ListCount];
+  // The target weight of RecentList (ARC's p).
+  qint64 _iTarget;
+};
+
+PiiObjectCache::Shard::Shard(ReplacementPolicy policy, qint64 maxBytes, int maxObjects) :
+  policy(policy),
+  iMaxBytes(maxBytes),
+  iMaxObjects(maxObjects),
+  iHits(0), iMisses(0), iEvictions(0),
+  _iTarget(0)
+{}
+
+PiiObjectCache::Shard::~Shard()
+{
+  clear();
+}
+
+void PiiObjectCache::Shard::clear()
+{
+  qDeleteAll(_hashEntries);
+  _hashEntries.clear();
+  for (int i=0; i<ListCount; ++i)
+    _lists[i] = List();
+  _iTarget = 0;
+}
+
+bool PiiObjectCache::Shard::isFull() const
+{
+  return (iMaxBytes > 0 && residentBytes() > iMaxBytes) ||
+    (iMaxObjects > 0 && residentCount() > iMaxObjects);
+}
+
+void PiiObjectCache::Shard::unlink(Entry* entry)
+{
+  List& list = _lists[entry->iList];
+  if (entry->pPrev != 0)
+    entry->pPrev->pNext = entry->pNext;
+  else
+    list.pHead = entry->pNext;
+  if (entry->pNext != 0)
+    entry->pNext->pPrev = entry->pPrev;
+  else
+    list.pTail = entry->pPrev;
+  --list.iCount;
+  list.iBytes -= entry->iBytes;
+}
+
+void PiiObjectCache::Shard::pushFront(Entry* entry, int index)
+{
+  List& list = _lists[index];
+  entry->iList = index;
+  entry->pPrev = 0;
+  entry->pNext = list.pHead;
+  if (list.pHead != 0)
+    list.pHead->pPrev = entry;
+  else
+    list.pTail = entry;
+  list.pHead = entry;
+  ++list.iCount;
+  list.iBytes += entry->iBytes;
+}
+
+void PiiObjectCache::Shard::drop(Entry* entry)
+{
+  unlink(entry);
+  _hashEntries.remove(entry->strKey);
+  delete entry;
+}
+
+bool PiiObjectCache::Shard::find(const QString& key, PiiVariant* value)
+{
+  Entry* pEntry = _hashEntries.value(key);
+  if (pEntry == 0 || pEntry->iList >= RecentGhosts)
+    {
+      ++iMisses;
+      return false;
+    }
+  ++iHits;
+  unlink(pEntry);
+  pushFront(pEntry, policy == Arc ? FrequentList : RecentList);
+  *value = pEntry->value;
+  return true;
+}
+
+void PiiObjectCache::Shard::insert(const QString& key, const PiiVariant& value, qint64 bytes)
+{
+  Entry* pEntry = _hashEntries.value(key);
+  // An object that doesn't fit would just flush everything else.
+  if (iMaxBytes > 0 && bytes > iMaxBytes)
+    {
+      if (pEntry != 0)
+        drop(pEntry);
+      return;
+    }
+
+  int iList = RecentList;
+  bool bFrequentGhostHit = false;
+  if (pEntry != 0)
+    {
+      // A miss on a remembered key tells that the list the key was
+      // evicted from was too short.
+      if (pEntry->iList == RecentGhosts)
+        {
+          qint64 iRatio = qMax(1, _lists[FrequentGhosts].iCount / _lists[RecentGhosts].iCount);
+          _iTarget = qMin(capacity(), _iTarget + iRatio * weightOf(bytes));
+          iList = FrequentList;
+        }
+      else if (pEntry->iList == FrequentGhosts)
+        {
+          qint64 iRatio = qMax(1, _lists[RecentGhosts].iCount / _lists[FrequentGhosts].iCount);
+          _iTarget = qMax(qint64(0), _iTarget - iRatio * weightOf(bytes));
+          iList = FrequentList;
+          bFrequentGhostHit = true;
+        }
+      else if (policy == Arc)
+        iList = FrequentList;
+      unlink(pEntry);
+    }
+  else
+    {
+      pEntry = new Entry;
+      pEntry->strKey = key;
+      _hashEntries.insert(key, pEntry);
+    }
+
+  pEntry->value = value;
+  pEntry->iBytes = bytes;
+  pushFront(pEntry, iList);
+
+  while (isFull())
+    evict(pEntry, bFrequentGhostHit);
+  if (policy == Arc)
+    trimGhosts();
+}
+
+// The newest entry (keep) always fits alone. Thus, there is always
+// another one to take.
+void PiiObjectCache::Shard::evict(Entry* keep, bool frequentGhostHit)
+{
+  Entry* pVictim;
+  if (policy == Lru)
+    pVictim = _lists[RecentList].pTail;
+  else
+    {
+      qint64 iRecent = listWeight(RecentList);
+      bool bTakeRecent = iRecent > _iTarget || (frequentGhostHit && iRecent == _iTarget);
+      if (_lists[FrequentList].iCount == 0 ||
+          (_lists[FrequentList].iCount == 1 && _lists[FrequentList].pTail == keep))
+        bTakeRecent = true;
+      else if (_lists[RecentList].iCount == 0 ||
+               (_lists[RecentList].iCount == 1 && _lists[RecentList].pTail == keep))
+        bTakeRecent = false;
+      pVictim = _lists[bTakeRecent ? RecentList : FrequentList].pTail;
+    }
+
+  ++iEvictions;
+  if (policy == Lru)
+    drop(pVictim);
+  else
+    {
+      int iGhosts = pVictim->iList == RecentList ? RecentGhosts : FrequentGhosts;
+      unlink(pVictim);
+      pVictim->value = PiiVariant();
+      pushFront(pVictim, iGhosts);
+    }
+}
+
+void PiiObjectCache::Shard::trimGhosts()
+{
+  const qint64 iCapacity = capacity();
+  while (_lists[RecentGhosts].iCount > 0 &&
+         listWeight(RecentList) + listWeight(RecentGhosts) > iCapacity)
+    drop(_lists[RecentGhosts].pTail);
+  while (_lists[RecentGhosts].iCount + _lists[FrequentGhosts].iCount > 0 &&
+         listWeight(RecentList) + listWeight(FrequentList) +
+         listWeight(RecentGhosts) + listWeight(FrequentGhosts) > 2 * iCapacity)
+    drop(_lists[_lists[FrequentGhosts].iCount > 0 ? FrequentGhosts : RecentGhosts].pTail);
+}
+
+QList<QPair<QString,PiiVariant> > PiiObjectCache::Shard::entries() const
+{
+  // Frequently used entries go last so that they end up being most
+  // recently used when loaded back.
+  QList<QPair<QString,PiiVariant> > lstEntries;
+  for (int i=RecentList; i<=FrequentList; ++i)
+    for (Entry* pEntry = _lists[i].pTail; pEntry != 0; pEntry = pEntry->pPrev)
+      lstEntries << qMakePair(pEntry->strKey, pEntry->value);
+  return lstEntries;
+}
+
+PiiObjectCache::PiiObjectCache(int shardCount)
+{
+  reset(shardCount, Lru, 0, 0);
+}
+
+PiiObjectCache::~PiiObjectCache()
+{
+  qDeleteAll(_vecShards);
+}
+
+void PiiObjectCache::reset(int shardCount, ReplacementPolicy policy, qint64 maxBytes, int maxObjects)
+{
+  qDeleteAll(_vecShards);
+  _vecShards.clear();
+  shardCount = qMax(shardCount, 1);
+  for (int i=0; i<shardCount; ++i)
+    _vecShards << new Shard(policy,
+                            shareOf(maxBytes, i, shardCount),
+                            shareOf(maxObjects, i, shardCount));
+}
+
+void PiiObjectCache::clear()
+{
+  for (int i=0; i<_vecShards.size(); ++i)
+    {
+      QMutexLocker lock(&_vecShards[i]->mutex);
+      _vecShards[i]->clear();
+    }
+}
+
+PiiObjectCache::Shard* PiiObjectCache::shardFor(const QString& key) const
+{
+  return _vecShards[qHash(key) % uint(_vecShards.size())];
+}
+
+bool PiiObjectCache::find(const QString& key, PiiVariant* value)
+{
+  Shard* pShard = shardFor(key);
+  QMutexLocker lock(&pShard->mutex);
+  return pShard->find(key, value);
+}
+
+void PiiObjectCache::insert(const QString& key, const PiiVariant& value)
+{
+  // Size estimation may encode the object. Do it without holding the
+  // lock.
+  qint64 iBytes = sizeOf(value) + qint64(sizeof(QString)) + 2 * key.size();
+  Shard* pShard = shardFor(key);
+  QMutexLocker lock(&pShard->mutex);
+  pShard->insert(key, value, iBytes);
+}
+
+int PiiObjectCache::count() const
+{
+  int iCount = 0;
+  for (int i=0; i<_vecShards.size(); ++i)
+    {
+      QMutexLocker lock(&_vecShards[i]->mutex);
+      iCount += _vecShards[i]->residentCount();
+    }
+  return iCount;
+}
+
+qint64 PiiObjectCache::bytes() const
+{
+  qint64 iBytes = 0;
+  for (int i=0; i<_vecShards.size(); ++i)
+    {
+      QMutexLocker lock(&_vecShards[i]->mutex);
+      iBytes += _vecShards[i]->residentBytes();
+    }
+  return iBytes;
+}
+
+#define PII_SUM_SHARDS(MEMBER)                          \
+  qint64 iSum = 0;                                      \
+  for (int i=0; i<_vecShards.size(); ++i)               \
+    {                                                   \
+      QMutexLocker lock(&_vecShards[i]->mutex);         \
+      iSum += _vecShards[i]->MEMBER;                    \
+    }                                                   \
+  return iSum
+
+qint64 PiiObjectCache::hits() const { PII_SUM_SHARDS(iHits); }
+qint64 PiiObjectCache::misses() const { PII_SUM_SHARDS(iMisses); }
+qint64 PiiObjectCache::evictions() const { PII_SUM_SHARDS(iEvictions); }
+
+#undef PII_SUM_SHARDS
+
+void PiiObjectCache::resetStatistics()
+{
+  for (int i=0; i<_vecShards.size(); ++i)
+    {
+      QMutexLocker lock(&_vecShards[i]->mutex);
+      _vecShards[i]->iHits = _vecShards[i]->iMisses = _vecShards[i]->iEvictions = 0;
+    }
+}
+
+int PiiObjectCache::save(QIODevice* device) const
+{
+  PiiWireFormat::write(device, PiiVariant(QString(pFileHeader)));
+  int iCount = 0;
+  for (int i=0; i<_vecShards.size(); ++i)
+    {
+      QList<QPair<QString,PiiVariant> > lstEntries;
+      {
+        QMutexLocker lock(&_vecShards[i]->mutex);
+        lstEntries = _vecShards[i]->entries();
+      }
+      for (int j=0; j<lstEntries.size(); ++j)
+        {
+          QByteArray aValue;
+          try
+            {
+              aValue = PiiWireFormat::encode(lstEntries[j].second, PiiWireFormat::FastCompression);
+            }
+          catch (PiiSerializationException&)
+            {
+              continue;
+            }
+          PiiWireFormat::write(device, PiiVariant(lstEntries[j].first));
+          if (device->write(aValue) != aValue.size())
+            PII_SERIALIZATION_ERROR(StreamError);
+          ++iCount;
+        }
+    }
+  return iCount;
+}
+
+int PiiObjectCache::load(QIODevice* device)
+{
+  PiiVariant header = PiiWireFormat::read(device);
+  if (header.type() != PiiYdin::QStringType ||
+      header.valueAs<QString>() != pFileHeader)
+    PII_SERIALIZATION_ERROR(UnrecognizedArchiveFormat);
+
+  int iCount = 0;
+  while (!device->atEnd())
+    {
+      PiiVariant key = PiiWireFormat::read(device);
+      if (key.type() != PiiYdin::QStringType)
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      insert(key.valueAs<QString>(), PiiWireFormat::read(device));
+      ++iCount;
+    }
+  return iCount;
+}
+
+qint64 PiiObjectCache::sizeOf(const PiiVariant& obj)
+{
+  const qint64 iVariantSize = sizeof(PiiVariant);
+  if (obj.isPrimitive())
+    return iVariantSize;
+  if (PiiYdin::isMatrixType(obj.type()))
+    {
+      // Rows are allocated up to capacity, and each row is padded to
+      // the stride.
+      const PiiTypelessMatrix& mat = obj.valueAs<PiiTypelessMatrix>();
+      return iVariantSize + qint64(sizeof(PiiMatrixData)) +
+        qint64(qMax(mat.rows(), mat.capacity())) * qint64(mat.stride());
+    }
+  if (obj.type() == PiiYdin::QStringType)
+    {
+      const QString& str = obj.valueAs<QString>();
+      return iVariantSize + qint64(sizeof(QString)) + 2 * qint64(str.capacity() + 1);
+    }
+  try
+    {
+      return iVariantSize + PiiWireFormat::encode(obj).size();
+    }
+  catch (PiiSerializationException&)
+    {
+      // Unserializable objects are cached but never persisted.
+      return 4 * iVariantSize;
+    }
+}
@@ -0,0 +1,153 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOBJECTCACHE_H
+#define _PIIOBJECTCACHE_H
+
+#include <PiiVariant.h>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * A thread-safe cache that maps string keys to PiiVariants. The
+ * cache is split into a number of *shards*, each with its own lock
+ * and its own share of the size limits. A key always goes to the
+ * same shard, which lets independent threads hit the cache without
+ * waiting for each other.
+ *
+ * When a shard exceeds its share of the limits, objects are evicted
+ * according to the [replacement policy](ReplacementPolicy). The
+ * memory used by an object is estimated with [sizeOf()].
+ *
+ * @internal
+ */
+class PiiObjectCache
+{
+public:
+  /**
+   * Replacement policies.
+   *
+   * - `Lru` - least recently used objects are evicted first.
+   *
+   * - `Arc` - adaptive replacement cache. The cache keeps separate
+   * lists of objects seen once and objects seen at least twice, and
+   * remembers the keys of recently evicted objects in both. A miss
+   * on a remembered key moves the balance between the lists towards
+   * the one the key was evicted from. Unlike LRU, a single pass over
+   * a large set of keys does not flush objects that are used
+   * repeatedly.
+   */
+  enum ReplacementPolicy { Lru, Arc };
+
+  /**
+   * Creates an unlimited LRU cache with the given number of shards.
+   */
+  PiiObjectCache(int shardCount = 1);
+  ~PiiObjectCache();
+
+  /**
+   * Removes all objects and resets statistics. Changes the number
+   * of shards, the replacement policy and the limits. Zero limits
+   * mean no limit. The limits are divided evenly among the shards;
+   * an object larger than `maxBytes / shardCount` is never cached.
+   */
+  void reset(int shardCount, ReplacementPolicy policy, qint64 maxBytes, int maxObjects);
+
+  /**
+   * Removes all objects but retains the configuration and
+   * statistics.
+   */
+  void clear();
+
+  /**
+   * Looks up *key*. If the key is found, stores the associated object
+   * to *value*, marks it used and returns `true`. Otherwise returns
+   * `false`.
+   */
+  bool find(const QString& key, PiiVariant* value);
+
+  /**
+   * Inserts *value* to the cache, replacing the old value of *key*,
+   * if any. Evicts other objects as needed.
+   */
+  void insert(const QString& key, const PiiVariant& value);
+
+  /**
+   * Returns the number of objects currently in the cache.
+   */
+  int count() const;
+  /**
+   * Returns the estimated number of bytes used by the objects
+   * currently in the cache.
+   */
+  qint64 bytes() const;
+
+  /**
+   * Returns the number of successful [find()] calls.
+   */
+  qint64 hits() const;
+  /**
+   * Returns the number of unsuccessful [find()] calls.
+   */
+  qint64 misses() const;
+  /**
+   * Returns the number of objects removed to make space for others.
+   */
+  qint64 evictions() const;
+  /**
+   * Sets hit, miss and eviction counts to zero.
+   */
+  void resetStatistics();
+
+  /**
+   * Writes all objects to *device* in [PiiWireFormat], least
+   * recently used first. Objects that cannot be serialized are
+   * skipped. Returns the number of objects written.
+   *
+   * @exception PiiSerializationException& if *device* cannot be
+   * written to.
+   */
+  int save(QIODevice* device) const;
+
+  /**
+   * Reads objects written by [save()] and inserts them to the cache.
+   * Returns the number of objects read.
+   *
+   * @exception PiiSerializationException& if the data is invalid.
+   */
+  int load(QIODevice* device);
+
+  /**
+   * Returns the estimated number of bytes *obj* occupies in memory.
+   * For matrices, the estimate includes the allocated rows with
+   * padding and the shared data header. For strings, the estimate
+   * includes the allocated characters. Other non-primitive types are
+   * estimated by the size of their [PiiWireFormat] encoding.
+   */
+  static qint64 sizeOf(const PiiVariant& obj);
+
+private:
+  class Shard;
+
+  Shard* shardFor(const QString& key) const;
+
+  QVector<Shard*> _vecShards;
+};
+
+#endif //_PIIOBJECTCACHE_H
@@ -19,7 +19,8 @@
 PiiSwitch::Data::Data() :
   operationMode(SynchronousMode),
   iTriggerCount(0),
-  bPassThrough(false)
+  bPassThrough(false),
+  iLaneCapacity(0)
 {
 }
 
@@ -33,6 +34,7 @@ PiiSwitch::PiiSwitch() :
 
   setProtectionLevel("dynamicInputCount", WriteWhenStoppedOrPaused);
   setProtectionLevel("operationMode", WriteWhenStoppedOrPaused);
+  setProtectionLevel("laneCapacity", WriteWhenStoppedOrPaused);
 }
 
 PiiInputSocket* PiiSwitch::input(const QString &name) const
@@ -64,7 +66,10 @@ void PiiSwitch::check(bool reset)
   int iGroupId = d->operationMode == SynchronousMode ? 0 : -1;
   inputAt(0)->setGroupId(iGroupId);
   for (int i=0; i<outputCount(); ++i)
-    outputAt(i)->setGroupId(iGroupId);
+    {
+      outputAt(i)->setGroupId(iGroupId);
+      outputAt(i)->setLaneCapacity(d->iLaneCapacity);
+    }
 
   inputAt(0)->setOptional(d->operationMode == AsynchronousMode);
 
@@ -151,3 +156,5 @@ void PiiSwitch::setPassThrough(bool passThrough)
     d->iTriggerCount = 1;
 }
 bool PiiSwitch::passThrough() const { return _d()->bPassThrough; }
+void PiiSwitch::setLaneCapacity(int laneCapacity) { _d()->iLaneCapacity = qMax(0, laneCapacity); }
+int PiiSwitch::laneCapacity() const { return _d()->iLaneCapacity; }
@@ -70,6 +70,16 @@ class PiiSwitch : public PiiDefaultOperation
    */
   Q_PROPERTY(bool passThrough READ passThrough WRITE setPassThrough);
 
+  /**
+   * The maximum number of objects waiting in the emission lane of
+   * each output. If this value is positive, each output passes its
+   * objects in its own thread (see
+   * PiiOutputSocket::setLaneCapacity()), and a slow receiver at one
+   * output does not delay the others. Zero disables lanes. The
+   * default value is zero.
+   */
+  Q_PROPERTY(int laneCapacity READ laneCapacity WRITE setLaneCapacity);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -119,6 +129,8 @@ protected:
   int dynamicInputCount() const;
   void setPassThrough(bool passThrough);
   bool passThrough() const;
+  void setLaneCapacity(int laneCapacity);
+  int laneCapacity() const;
 
 private:
   void emitInputObjects();
@@ -135,6 +147,7 @@ private:
     QList<PiiVariant> lstObjects;
     int iStaticInputCount;
     bool bPassThrough;
+    int iLaneCapacity;
   };
   PII_D_FUNC;
 };
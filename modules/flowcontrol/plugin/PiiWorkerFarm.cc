@@ -0,0 +1,403 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiWorkerFarm.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiSynchronized.h>
+
+namespace
+{
+  // Each worker is placed this many times on the hash ring to make
+  // key distribution even.
+  const int iRingPointsPerWorker = 64;
+
+  inline QString workerName(int index) { return QString("worker%1").arg(index); }
+}
+
+PiiWorkerFarm::Schedule::Schedule() :
+  _distribution(RoundRobin),
+  _iWindowSize(1),
+  _iNextWorker(0),
+  _bInterrupted(false)
+{}
+
+void PiiWorkerFarm::Schedule::reset(int workerCount, int windowSize, Distribution distribution)
+{
+  QMutexLocker lock(&_mutex);
+  _order.clear();
+  _vecResults.fill(QQueue<PiiVariant>(), workerCount);
+  _vecLoad.fill(0, workerCount);
+  _distribution = distribution;
+  _iWindowSize = qMax(windowSize, 1);
+  _iNextWorker = 0;
+  _bInterrupted = false;
+
+  _mapRing.clear();
+  if (distribution == KeyHash)
+    for (int i=0; i<workerCount; ++i)
+      for (int j=0; j<iRingPointsPerWorker; ++j)
+        _mapRing.insert(qHash(QString("%1/%2").arg(workerName(i)).arg(j)), i);
+}
+
+void PiiWorkerFarm::Schedule::interrupt()
+{
+  QMutexLocker lock(&_mutex);
+  _bInterrupted = true;
+  _windowCondition.wakeAll();
+}
+
+int PiiWorkerFarm::Schedule::selectWorker(const PiiVariant& key)
+{
+  const int iWorkers = _vecLoad.size();
+  int iWorker = _iNextWorker;
+  switch (_distribution)
+    {
+    case RoundRobin:
+      break;
+    case LeastLoaded:
+      // Ties are broken in round-robin order.
+      for (int i=1; i<iWorkers; ++i)
+        {
+          int iCandidate = (_iNextWorker + i) % iWorkers;
+          if (_vecLoad[iCandidate] < _vecLoad[iWorker])
+            iWorker = iCandidate;
+        }
+      break;
+    case KeyHash:
+      {
+        QMap<uint,int>::const_iterator i = _mapRing.lowerBound(qHash(PiiYdin::convertToQString(key)));
+        if (i == _mapRing.constEnd())
+          i = _mapRing.constBegin();
+        return i.value();
+      }
+    }
+  _iNextWorker = (iWorker + 1) % iWorkers;
+  return iWorker;
+}
+
+int PiiWorkerFarm::Schedule::dispatch(const PiiVariant& key)
+{
+  QMutexLocker lock(&_mutex);
+  while (_order.size() >= _iWindowSize)
+    {
+      if (_bInterrupted)
+        throw PiiExecutionException(PiiExecutionException::Interrupted);
+      _windowCondition.wait(&_mutex);
+    }
+  int iWorker = selectWorker(key);
+  _order.enqueue(iWorker);
+  ++_vecLoad[iWorker];
+  return iWorker;
+}
+
+QList<PiiVariant> PiiWorkerFarm::Schedule::collect(int worker, const PiiVariant& result)
+{
+  QList<PiiVariant> lstResults;
+  QMutexLocker lock(&_mutex);
+  _vecResults[worker].enqueue(result);
+  // Release everything up to the first object whose result is still
+  // being processed.
+  while (!_order.isEmpty() && !_vecResults[_order.head()].isEmpty())
+    {
+      int iWorker = _order.dequeue();
+      lstResults << _vecResults[iWorker].dequeue();
+      --_vecLoad[iWorker];
+    }
+  if (!lstResults.isEmpty())
+    _windowCondition.wakeAll();
+  return lstResults;
+}
+
+PiiWorkerFarm::Data::Data() :
+  iWorkerCount(2),
+  distribution(RoundRobin),
+  iWindowSize(16),
+  strWorkerInput("input"),
+  strWorkerOutput("output")
+{}
+
+PiiWorkerFarm::PiiWorkerFarm() :
+  PiiOperationCompound(new Data)
+{
+  PiiWorkerFarmDispatcher* pDispatcher = new PiiWorkerFarmDispatcher;
+  pDispatcher->setObjectName("dispatcher");
+  addOperation(pDispatcher);
+
+  PiiWorkerFarmCollector* pCollector = new PiiWorkerFarmCollector;
+  pCollector->setObjectName("collector");
+  addOperation(pCollector);
+
+  createInputProxy("input", QStringList() << "dispatcher.input");
+  createInputProxy("key", QStringList() << "dispatcher.key");
+  createOutputProxy("output", "collector.output");
+
+  setProtectionLevel("workerCount", WriteWhenStopped);
+  setProtectionLevel("distribution", WriteWhenStopped);
+  setProtectionLevel("windowSize", WriteWhenStopped);
+  setProtectionLevel("nodes", WriteWhenStopped);
+  setProtectionLevel("workerInput", WriteWhenStopped);
+  setProtectionLevel("workerOutput", WriteWhenStopped);
+  connectWorkers();
+}
+
+PiiWorkerFarm::PiiWorkerFarm(PiiSerialization::Void) :
+  PiiOperationCompound(new Data)
+{}
+
+PiiWorkerFarm::~PiiWorkerFarm()
+{}
+
+PiiWorkerFarmDispatcher* PiiWorkerFarm::dispatcher() const
+{
+  return qobject_cast<PiiWorkerFarmDispatcher*>(childOperation("dispatcher"));
+}
+
+PiiWorkerFarmCollector* PiiWorkerFarm::collector() const
+{
+  return qobject_cast<PiiWorkerFarmCollector*>(childOperation("collector"));
+}
+
+PiiOperation* PiiWorkerFarm::workerAt(int index) const
+{
+  return childOperation(workerName(index));
+}
+
+PiiWorkerFarm::Schedule* PiiWorkerFarm::schedule()
+{
+  return &_d()->schedule;
+}
+
+void PiiWorkerFarm::setWorker(PiiOperation* worker)
+{
+  if (worker == 0)
+    return;
+  destroyWorkers(0);
+  worker->setObjectName(workerName(0));
+  addOperation(worker);
+  connectWorkers();
+}
+
+void PiiWorkerFarm::destroyWorkers(int firstIndex)
+{
+  QList<PiiOperation*> lstWorkers;
+  for (int i=firstIndex; workerAt(i) != 0; ++i)
+    lstWorkers << workerAt(i);
+  for (int i=0; i<lstWorkers.size(); ++i)
+    {
+      removeOperation(lstWorkers[i]);
+      delete lstWorkers[i];
+    }
+}
+
+void PiiWorkerFarm::connectWorkers()
+{
+  PII_D;
+  PiiWorkerFarmDispatcher* pDispatcher = dispatcher();
+  PiiWorkerFarmCollector* pCollector = collector();
+  if (pDispatcher == 0 || pCollector == 0)
+    return;
+  pDispatcher->setWorkerCount(d->iWorkerCount);
+  pCollector->setWorkerCount(d->iWorkerCount);
+
+  PiiOperation* pPrototype = workerAt(0);
+  if (pPrototype == 0)
+    return;
+
+  destroyWorkers(d->iWorkerCount);
+
+  for (int i=0; i<d->iWorkerCount; ++i)
+    {
+      PiiOperation* pWorker = workerAt(i);
+      if (pWorker == 0)
+        {
+          pWorker = pPrototype->clone();
+          if (pWorker == 0)
+            {
+              piiWarning(tr("%1 cannot be cloned.").arg(pPrototype->metaObject()->className()));
+              return;
+            }
+          pWorker->setObjectName(workerName(i));
+          addOperation(pWorker);
+        }
+      PiiAbstractInputSocket* pInput = pWorker->input(d->strWorkerInput);
+      PiiAbstractOutputSocket* pOutput = pWorker->output(d->strWorkerOutput);
+      if (pInput == 0 || pOutput == 0)
+        {
+          piiWarning(tr("The worker has no \"%1\" input or no \"%2\" output.")
+                     .arg(d->strWorkerInput).arg(d->strWorkerOutput));
+          return;
+        }
+      PiiAbstractOutputSocket* pDispatcherOutput = pDispatcher->outputAt(i);
+      pDispatcherOutput->disconnectInputs();
+      pDispatcherOutput->connectInput(pInput);
+      pOutput->connectInput(pCollector->inputAt(i));
+    }
+}
+
+void PiiWorkerFarm::check(bool reset)
+{
+  PII_D;
+  if (workerAt(0) == 0)
+    PII_THROW(PiiExecutionException, tr("The worker has not been set."));
+
+  if (!d->lstNodes.isEmpty())
+    for (int i=0; i<d->iWorkerCount; ++i)
+      {
+        PiiOperationCompound* pWorker = qobject_cast<PiiOperationCompound*>(workerAt(i));
+        if (pWorker != 0)
+          pWorker->setNode(d->lstNodes[i % d->lstNodes.size()]);
+      }
+
+  if (reset)
+    d->schedule.reset(d->iWorkerCount, d->iWindowSize, d->distribution);
+
+  PiiOperationCompound::check(reset);
+}
+
+void PiiWorkerFarm::interrupt()
+{
+  _d()->schedule.interrupt();
+  PiiOperationCompound::interrupt();
+}
+
+void PiiWorkerFarm::setWorkerCount(int workerCount)
+{
+  if (workerCount < 1 || workerCount == _d()->iWorkerCount)
+    return;
+  _d()->iWorkerCount = workerCount;
+  connectWorkers();
+}
+
+int PiiWorkerFarm::workerCount() const { return _d()->iWorkerCount; }
+void PiiWorkerFarm::setDistribution(Distribution distribution) { _d()->distribution = distribution; }
+PiiWorkerFarm::Distribution PiiWorkerFarm::distribution() const { return _d()->distribution; }
+void PiiWorkerFarm::setWindowSize(int windowSize) { _d()->iWindowSize = qMax(windowSize, 1); }
+int PiiWorkerFarm::windowSize() const { return _d()->iWindowSize; }
+void PiiWorkerFarm::setNodes(const QStringList& nodes) { _d()->lstNodes = nodes; }
+QStringList PiiWorkerFarm::nodes() const { return _d()->lstNodes; }
+
+void PiiWorkerFarm::setWorkerInput(const QString& workerInput)
+{
+  _d()->strWorkerInput = workerInput;
+  connectWorkers();
+}
+
+QString PiiWorkerFarm::workerInput() const { return _d()->strWorkerInput; }
+
+void PiiWorkerFarm::setWorkerOutput(const QString& workerOutput)
+{
+  PII_D;
+  // Results must come from one output only.
+  PiiWorkerFarmCollector* pCollector = collector();
+  for (int i=0; pCollector != 0 && i<d->iWorkerCount; ++i)
+    if (PiiOperation* pWorker = workerAt(i))
+      if (PiiAbstractOutputSocket* pOutput = pWorker->output(d->strWorkerOutput))
+        pOutput->disconnectInput(pCollector->inputAt(i));
+  d->strWorkerOutput = workerOutput;
+  connectWorkers();
+}
+
+QString PiiWorkerFarm::workerOutput() const { return _d()->strWorkerOutput; }
+
+
+PiiWorkerFarmDispatcher::Data::Data() :
+  pSchedule(0),
+  bKeyed(false)
+{}
+
+PiiWorkerFarmDispatcher::PiiWorkerFarmDispatcher() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiInputSocket("input"));
+  PiiInputSocket* pKeyInput = new PiiInputSocket("key");
+  pKeyInput->setOptional(true);
+  addSocket(pKeyInput);
+  setWorkerCount(2);
+}
+
+void PiiWorkerFarmDispatcher::setWorkerCount(int workerCount)
+{
+  if (workerCount < 1) return;
+  setNumberedOutputs(workerCount);
+  // The workers get no synchronization tags.
+  for (int i=0; i<workerCount; ++i)
+    outputAt(i)->setGroupId(-1);
+}
+
+int PiiWorkerFarmDispatcher::workerCount() const { return outputCount(); }
+
+void PiiWorkerFarmDispatcher::check(bool reset)
+{
+  PII_D;
+  PiiWorkerFarm* pFarm = qobject_cast<PiiWorkerFarm*>(parent());
+  if (pFarm == 0)
+    PII_THROW(PiiExecutionException, tr("The dispatcher must be a child of PiiWorkerFarm."));
+  d->pSchedule = pFarm->schedule();
+  d->bKeyed = pFarm->distribution() == PiiWorkerFarm::KeyHash;
+  if (d->bKeyed && !inputAt(1)->isConnected())
+    PII_THROW(PiiExecutionException, tr("The key input must be connected with key-hashed distribution."));
+
+  PiiDefaultOperation::check(reset);
+}
+
+void PiiWorkerFarmDispatcher::process()
+{
+  PII_D;
+  int iWorker = d->pSchedule->dispatch(d->bKeyed ? readInput(1) : PiiVariant());
+  emitObject(readInput(0), iWorker);
+}
+
+
+PiiWorkerFarmCollector::Data::Data() :
+  pSchedule(0)
+{}
+
+PiiWorkerFarmCollector::PiiWorkerFarmCollector() :
+  PiiDefaultOperation(new Data)
+{
+  PiiOutputSocket* pOutput = new PiiOutputSocket("output");
+  pOutput->setGroupId(-1);
+  addSocket(pOutput);
+  setWorkerCount(2);
+}
+
+void PiiWorkerFarmCollector::setWorkerCount(int workerCount)
+{
+  if (workerCount < 1) return;
+  setNumberedInputs(workerCount);
+  // Results from different workers arrive independently.
+  for (int i=0; i<workerCount; ++i)
+    inputAt(i)->setGroupId(i);
+}
+
+int PiiWorkerFarmCollector::workerCount() const { return inputCount(); }
+
+void PiiWorkerFarmCollector::check(bool reset)
+{
+  PiiWorkerFarm* pFarm = qobject_cast<PiiWorkerFarm*>(parent());
+  if (pFarm == 0)
+    PII_THROW(PiiExecutionException, tr("The collector must be a child of PiiWorkerFarm."));
+  _d()->pSchedule = pFarm->schedule();
+
+  PiiDefaultOperation::check(reset);
+}
+
+void PiiWorkerFarmCollector::process()
+{
+  int iWorker = activeInputGroup();
+  QList<PiiVariant> lstResults = _d()->pSchedule->collect(iWorker, readInput(iWorker));
+  for (int i=0; i<lstResults.size(); ++i)
+    emitObject(lstResults[i]);
+}
@@ -0,0 +1,305 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIWORKERFARM_H
+#define _PIIWORKERFARM_H
+
+#include <PiiOperationCompound.h>
+#include <PiiDefaultOperation.h>
+
+#include <QQueue>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
+
+class PiiWorkerFarmDispatcher;
+class PiiWorkerFarmCollector;
+
+/**
+ * Distributes incoming objects to a number of identical workers and
+ * collects the results in the order the objects were received. A
+ * worker farm is useful if a processing stage is too heavy for one
+ * thread or one computer. The worker is any operation with one input
+ * and one output, usually a compound. It is configured once with
+ * [setWorker()], and the farm replicates it with
+ * [clone()](PiiOperation::clone()) up to [workerCount].
+ *
+ * ~~~(c++)
+ * PiiWorkerFarm* pFarm = new PiiWorkerFarm;
+ * pFarm->setWorker(createOcrCompound());
+ * pFarm->setProperty("workerCount", 4);
+ * pFarm->setProperty("nodes", QStringList() << "tcp://10.0.0.2:3142/node/"
+ *                                           << "tcp://10.0.0.3:3142/node/");
+ * engine.addOperation(pFarm);
+ * ~~~
+ *
+ * If [nodes] is set and the workers are compounds, each worker is
+ * deployed to a remote node (see PiiOperationCompound::node).
+ * Otherwise, the workers run locally in parallel.
+ *
+ * Each worker must emit exactly one result for each object it
+ * receives, in the order it received the objects. The farm uses
+ * this to restore the original order without altering the objects.
+ * Synchronization tags are not passed to the workers. The farm
+ * should therefore be used for independent objects, not inside
+ * nested flow levels.
+ *
+ * Inputs
+ * ------
+ *
+ * @in input - the objects to process. Any type accepted by the
+ * worker.
+ *
+ * @in key - an optional key that selects the worker if
+ * [distribution] is `KeyHash`. Any primitive type or a string.
+ *
+ * Outputs
+ * -------
+ *
+ * @out output - the results of the workers, in the order the
+ * corresponding objects arrived in `input`.
+ */
+class PiiWorkerFarm : public PiiOperationCompound
+{
+  Q_OBJECT
+
+  /**
+   * The number of worker replicas. Changing the value clones the
+   * first worker or destroys the last ones. The default is two.
+   */
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  /**
+   * The way objects are distributed to workers. The default is
+   * `RoundRobin`.
+   */
+  Q_PROPERTY(Distribution distribution READ distribution WRITE setDistribution);
+  Q_ENUMS(Distribution);
+
+  /**
+   * The maximum number of objects that may be in the workers at the
+   * same time. If the result of the oldest object is not available,
+   * the farm stops accepting new objects after this many. The window
+   * also limits the number of results held back to restore the
+   * order. The default is 16.
+   */
+  Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize);
+
+  /**
+   * Node URIs for the workers. The *i*th worker is assigned to
+   * `nodes[i % nodes.size()]` when the farm is checked. An empty
+   * string runs the worker locally. If the list is empty (the
+   * default), the [node](PiiOperationCompound::node) properties of
+   * the workers are left untouched.
+   */
+  Q_PROPERTY(QStringList nodes READ nodes WRITE setNodes);
+
+  /**
+   * The name of the input socket of the worker. The default is
+   * "input".
+   */
+  Q_PROPERTY(QString workerInput READ workerInput WRITE setWorkerInput);
+
+  /**
+   * The name of the output socket of the worker. The default is
+   * "output".
+   */
+  Q_PROPERTY(QString workerOutput READ workerOutput WRITE setWorkerOutput);
+
+  PII_COMPOUND_SERIALIZATION_FUNCTION
+public:
+  /**
+   * Distribution policies.
+   *
+   * - `RoundRobin` - objects are passed to the workers in turn.
+   *
+   * - `LeastLoaded` - each object is passed to the worker with the
+   * fewest objects in processing. This balances the load if the
+   * processing time varies from object to object or the workers run
+   * on computers of different speed.
+   *
+   * - `KeyHash` - the worker is selected by hashing the object in the
+   * `key` input onto a consistent hash ring. Objects with the same
+   * key always go to the same worker, and changing [workerCount]
+   * moves only a small fraction of keys to another worker.
+   */
+  enum Distribution { RoundRobin, LeastLoaded, KeyHash };
+
+  PiiWorkerFarm();
+  ~PiiWorkerFarm();
+
+  /**
+   * Sets the worker prototype. The farm takes the ownership of
+   * *worker* and destroys the previous workers. *worker* becomes the
+   * first worker, and the rest are cloned from it.
+   */
+  Q_INVOKABLE void setWorker(PiiOperation* worker);
+
+  /**
+   * Returns the worker at *index*, or zero if there is no such
+   * worker.
+   */
+  Q_INVOKABLE PiiOperation* workerAt(int index) const;
+
+  void check(bool reset);
+  void interrupt();
+
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+  void setDistribution(Distribution distribution);
+  Distribution distribution() const;
+  void setWindowSize(int windowSize);
+  int windowSize() const;
+  void setNodes(const QStringList& nodes);
+  QStringList nodes() const;
+  void setWorkerInput(const QString& workerInput);
+  QString workerInput() const;
+  void setWorkerOutput(const QString& workerOutput);
+  QString workerOutput() const;
+
+  /**
+   * Book-keeping shared by the dispatcher and the collector.
+   *
+   * @internal
+   */
+  class Schedule
+  {
+  public:
+    Schedule();
+
+    /// Clears all state and prepares for *workerCount* workers.
+    void reset(int workerCount, int windowSize, Distribution distribution);
+    /// Releases a dispatcher waiting for space in the window.
+    void interrupt();
+    /**
+     * Selects a worker for the next object and records the choice.
+     * Blocks while the window is full. Throws PiiExecutionException
+     * if interrupted.
+     */
+    int dispatch(const PiiVariant& key);
+    /**
+     * Stores a *result* from *worker* and returns the results that
+     * are now in order.
+     */
+    QList<PiiVariant> collect(int worker, const PiiVariant& result);
+
+  private:
+    int selectWorker(const PiiVariant& key);
+
+    QMutex _mutex;
+    QWaitCondition _windowCondition;
+    QQueue<int> _order;
+    QVector<QQueue<PiiVariant> > _vecResults;
+    QVector<int> _vecLoad;
+    QMap<uint,int> _mapRing;
+    Distribution _distribution;
+    int _iWindowSize, _iNextWorker;
+    bool _bInterrupted;
+  };
+
+  /// @internal
+  Schedule* schedule();
+
+private:
+  PiiWorkerFarm(PiiSerialization::Void);
+
+  PiiWorkerFarmDispatcher* dispatcher() const;
+  PiiWorkerFarmCollector* collector() const;
+  void destroyWorkers(int firstIndex);
+  void connectWorkers();
+
+  /// @internal
+  class Data : public PiiOperationCompound::Data
+  {
+  public:
+    Data();
+    int iWorkerCount;
+    Distribution distribution;
+    int iWindowSize;
+    QStringList lstNodes;
+    QString strWorkerInput, strWorkerOutput;
+    Schedule schedule;
+  };
+  PII_D_FUNC;
+};
+
+/**
+ * Passes the objects received by PiiWorkerFarm to its workers.
+ *
+ * @internal
+ */
+class PiiWorkerFarmDispatcher : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiWorkerFarmDispatcher();
+
+  void check(bool reset);
+
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+
+protected:
+  void process();
+
+private:
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    PiiWorkerFarm::Schedule* pSchedule;
+    bool bKeyed;
+  };
+  PII_D_FUNC;
+};
+
+/**
+ * Restores the order of the results of the workers of PiiWorkerFarm.
+ *
+ * @internal
+ */
+class PiiWorkerFarmCollector : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiWorkerFarmCollector();
+
+  void check(bool reset);
+
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+
+protected:
+  void process();
+
+private:
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    PiiWorkerFarm::Schedule* pSchedule;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIWORKERFARM_H
@@ -18,6 +18,11 @@
 
 #include <PiiMath.h>
 #include <PiiGeometricObjects.h>
+#include "PiiPointArray.h"
+#include "PiiRectangleArray.h"
+#include "PiiGeometryKernels.h"
+#include <cmath>
+#include <algorithm>
 
 
 /**
@@ -347,6 +352,219 @@ namespace PiiGeometry
 
     return iWindingNumber != 0;
   }
+
+  /// @internal
+  namespace Private
+  {
+    template <class T> inline int windingNumber(const T* vertexX, const T* vertexY, int vertexCount, T x, T y)
+    {
+      int iWindingNumber = 0;
+      for (int i=0; i<vertexCount; ++i)
+        {
+          const int j = i < vertexCount-1 ? i+1 : 0;
+          // Same test as in checkEdge(), without integer coordinates.
+          const T projectionSign = (vertexX[j] - vertexX[i]) * (y - vertexY[i]) -
+            (vertexY[j] - vertexY[i]) * (x - vertexX[i]);
+          if (vertexY[i] <= y)
+            {
+              if (vertexY[j] > y && projectionSign > 0)
+                ++iWindingNumber;
+            }
+          else if (vertexY[j] <= y && projectionSign < 0)
+            --iWindingNumber;
+        }
+      return iWindingNumber;
+    }
+
+    // The scalar loops start at *c* so that the vectorized kernels
+    // can use them for the last few points.
+    template <class T> void contains(const T* vertexX, const T* vertexY, int vertexCount,
+                                     const T* x, const T* y, int c, int count,
+                                     unsigned char* result)
+    {
+      for (; c<count; ++c)
+        result[c] = windingNumber(vertexX, vertexY, vertexCount, x[c], y[c]) != 0 ? 1 : 0;
+    }
+
+    template <class T> void contains(T x1, T y1, T x2, T y2,
+                                     const T* x, const T* y, int c, int count,
+                                     unsigned char* result)
+    {
+      for (; c<count; ++c)
+        result[c] = x1 <= x[c] && x[c] <= x2 && y1 <= y[c] && y[c] <= y2 ? 1 : 0;
+    }
+
+    template <class T> void intersects(T x1, T y1, T x2, T y2,
+                                       const T* rectX1, const T* rectY1,
+                                       const T* rectX2, const T* rectY2,
+                                       int c, int count, unsigned char* result)
+    {
+      for (; c<count; ++c)
+        result[c] = rectX1[c] <= x2 && rectY1[c] <= y2 && rectX2[c] >= x1 && rectY2[c] >= y1 ? 1 : 0;
+    }
+
+    template <class T> void distanceToSegment(T x1, T y1, T x2, T y2,
+                                              const T* x, const T* y, int c, int count,
+                                              T* distances)
+    {
+      const T dx = x2 - x1, dy = y2 - y1;
+      const T length2 = dx*dx + dy*dy;
+      for (; c<count; ++c)
+        {
+          // Project the point to the line and clamp the projection
+          // to the segment.
+          T t = 0;
+          if (length2 > 0)
+            {
+              t = ((x[c] - x1) * dx + (y[c] - y1) * dy) / length2;
+              t = t < 0 ? T(0) : t > 1 ? T(1) : t;
+            }
+          const T ex = x[c] - (x1 + t * dx), ey = y[c] - (y1 + t * dy);
+          distances[c] = std::sqrt(ex*ex + ey*ey);
+        }
+    }
+  }
+
+  /**
+   * Checks which points a polygon contains. This is a batched
+   * version of [contains(const PiiMatrix<T>&, int, int)] that works
+   * with real-valued coordinates. With `float` coordinates, several
+   * points are tested at once using SIMD instructions.
+   *
+   * @param polygon the vertices of the polygon
+   *
+   * @param points the points to check
+   *
+   * @param result an array of `points.count()` bytes. Set to one for
+   * each point inside *polygon* and to zero for the others.
+   */
+  template <class T> void contains(const PiiPointArray<T>& polygon,
+                                   const PiiPointArray<T>& points,
+                                   unsigned char* result)
+  {
+    if (polygon.isEmpty())
+      {
+        std::fill(result, result + points.count(), 0);
+        return;
+      }
+    if (!GeometryKernel<T>::contains(polygon.x(), polygon.y(), polygon.count(),
+                                     points.x(), points.y(), points.count(), result))
+      Private::contains(polygon.x(), polygon.y(), polygon.count(),
+                        points.x(), points.y(), 0, points.count(), result);
+  }
+
+  /**
+   * Checks which points a polygon contains. The polygon is given as a N-by-2 matrix. If the same polygon is
+   * tested many times, it is faster to convert it to a
+   * PiiPointArray once.
+   */
+  template <class T> void contains(const PiiMatrix<T>& polygon,
+                                   const PiiPointArray<T>& points,
+                                   unsigned char* result)
+  {
+    contains(PiiPointArray<T>(polygon), points, result);
+  }
+
+  /**
+   * Returns an array that has a one for each point inside *polygon*
+   * and a zero for the others.
+   */
+  template <class T> QVector<unsigned char> contains(const PiiMatrix<T>& polygon,
+                                                     const PiiPointArray<T>& points)
+  {
+    QVector<unsigned char> vecResult(points.count());
+    contains(polygon, points, vecResult.data());
+    return vecResult;
+  }
+
+  /**
+   * Checks which points are inside a rectangle. The rectangle is
+   * closed, as in PiiRectangle::contains().
+   *
+   * @param result an array of `points.count()` bytes. Set to one for
+   * each point inside *rectangle* and to zero for the others.
+   */
+  template <class T> void contains(const PiiRectangle<T>& rectangle,
+                                   const PiiPointArray<T>& points,
+                                   unsigned char* result)
+  {
+    const T x2 = rectangle.x + rectangle.width, y2 = rectangle.y + rectangle.height;
+    if (!GeometryKernel<T>::contains(rectangle.x, rectangle.y, x2, y2,
+                                     points.x(), points.y(), points.count(), result))
+      Private::contains(rectangle.x, rectangle.y, x2, y2,
+                        points.x(), points.y(), 0, points.count(), result);
+  }
+
+  template <class T> QVector<unsigned char> contains(const PiiRectangle<T>& rectangle,
+                                                     const PiiPointArray<T>& points)
+  {
+    QVector<unsigned char> vecResult(points.count());
+    contains(rectangle, points, vecResult.data());
+    return vecResult;
+  }
+
+  /**
+   * Checks which rectangles in *rectangles* intersect *rectangle*.
+   * The result is the same as that of PiiRectangle::intersects()
+   * for each rectangle.
+   *
+   * @param result an array of `rectangles.count()` bytes. Set to one
+   * for each intersecting rectangle and to zero for the others.
+   */
+  template <class T> void intersects(const PiiRectangle<T>& rectangle,
+                                     const PiiRectangleArray<T>& rectangles,
+                                     unsigned char* result)
+  {
+    const T x2 = rectangle.x + rectangle.width, y2 = rectangle.y + rectangle.height;
+    if (!GeometryKernel<T>::intersects(rectangle.x, rectangle.y, x2, y2,
+                                       rectangles.x1(), rectangles.y1(),
+                                       rectangles.x2(), rectangles.y2(),
+                                       rectangles.count(), result))
+      Private::intersects(rectangle.x, rectangle.y, x2, y2,
+                          rectangles.x1(), rectangles.y1(),
+                          rectangles.x2(), rectangles.y2(),
+                          0, rectangles.count(), result);
+  }
+
+  template <class T> QVector<unsigned char> intersects(const PiiRectangle<T>& rectangle,
+                                                       const PiiRectangleArray<T>& rectangles)
+  {
+    QVector<unsigned char> vecResult(rectangles.count());
+    intersects(rectangle, rectangles, vecResult.data());
+    return vecResult;
+  }
+
+  /**
+   * Calculates the distance from each point to a line segment.
+   * Unlike [pointToLineSegmentDistance()], which measures the
+   * distance to the infinite line through the end points, this
+   * function returns the distance to the closer end point for points
+   * whose projection falls outside of the segment. If the end points
+   * are equal, the distance to that point is returned. `T` must be a
+   * floating-point type.
+   *
+   * @param distances an array of `points.count()` values that
+   * receives the distances
+   */
+  template <class T> void distanceToSegment(const PiiPoint<T>& start,
+                                            const PiiPoint<T>& end,
+                                            const PiiPointArray<T>& points,
+                                            T* distances)
+  {
+    if (!GeometryKernel<T>::distanceToSegment(start.x, start.y, end.x, end.y,
+                                              points.x(), points.y(), points.count(), distances))
+      Private::distanceToSegment(start.x, start.y, end.x, end.y,
+                                 points.x(), points.y(), 0, points.count(), distances);
+  }
+
+  template <class T> QVector<T> distanceToSegment(const PiiPoint<T>& start,
+                                                  const PiiPoint<T>& end,
+                                                  const PiiPointArray<T>& points)
+  {
+    QVector<T> vecResult(points.count());
+    distanceToSegment(start, end, points, vecResult.data());
+    return vecResult;
+  }
 }
 
 #endif //_PIIGEOMETRY_H
@@ -0,0 +1,348 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiGeometryKernels.h"
+#include "PiiGeometry.h"
+
+#include <PiiCpuDispatcher.h>
+#include <cstring>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_GEOMETRY_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_GEOMETRY_AVX2 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_GEOMETRY_NEON 1
+#endif
+
+typedef unsigned char uchar;
+
+namespace PiiGeometry
+{
+  namespace
+  {
+    typedef void (*PolygonFunction)(const float*, const float*, int, const float*, const float*, int, uchar*);
+    typedef void (*RectangleFunction)(float, float, float, float, const float*, const float*, int, uchar*);
+    typedef void (*IntersectionFunction)(float, float, float, float,
+                                         const float*, const float*, const float*, const float*,
+                                         int, uchar*);
+    typedef void (*DistanceFunction)(float, float, float, float, const float*, const float*, int, float*);
+  }
+
+  /* Comparisons produce lane masks that are -1 where true.
+     Subtracting an upward crossing mask and adding a downward one
+     accumulates the winding numbers of a whole vector of points. The
+     loops are stamped out with a macro because all functions called
+     from an AVX2 loop must have the same target attribute.
+   */
+#define PII_GEOMETRY_LOOPS(TARGET)                                      \
+  TARGET void contains(const float* vertexX, const float* vertexY, int vertexCount, \
+                       const float* x, const float* y, int count,       \
+                       uchar* result)                                   \
+  {                                                                     \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const Vec px = Ops::load(x + c), py = Ops::load(y + c);         \
+        IntVec winding = Ops::zero();                                   \
+        for (int i=0; i<vertexCount; ++i)                               \
+          {                                                             \
+            const int j = i < vertexCount-1 ? i+1 : 0;                  \
+            const Vec x0 = Ops::set(vertexX[i]), y0 = Ops::set(vertexY[i]); \
+            const Vec y1 = Ops::set(vertexY[j]);                        \
+            const Vec sign = Ops::sub(Ops::mul(Ops::set(vertexX[j] - vertexX[i]), Ops::sub(py, y0)), \
+                                      Ops::mul(Ops::set(vertexY[j] - vertexY[i]), Ops::sub(px, x0))); \
+            const IntVec startBelow = Ops::lessEqual(y0, py);           \
+            const IntVec endBelow = Ops::lessEqual(y1, py);             \
+            const IntVec up = Ops::andNot(endBelow, Ops::bitAnd(startBelow, Ops::greater(sign, Ops::zeroFloat()))); \
+            const IntVec down = Ops::andNot(startBelow, Ops::bitAnd(endBelow, Ops::greater(Ops::zeroFloat(), sign))); \
+            winding = Ops::addInt(Ops::subInt(winding, up), down);      \
+          }                                                             \
+        Ops::storeFlags(result + c, Ops::notZero(winding));             \
+      }                                                                 \
+    Private::contains(vertexX, vertexY, vertexCount, x, y, c, count, result); \
+  }                                                                     \
+                                                                        \
+  TARGET void containsRect(float x1, float y1, float x2, float y2,      \
+                           const float* x, const float* y, int count,   \
+                           uchar* result)                               \
+  {                                                                     \
+    const Vec left = Ops::set(x1), top = Ops::set(y1), right = Ops::set(x2), bottom = Ops::set(y2); \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const Vec px = Ops::load(x + c), py = Ops::load(y + c);         \
+        const IntVec inside = Ops::bitAnd(Ops::bitAnd(Ops::lessEqual(left, px), Ops::lessEqual(px, right)), \
+                                          Ops::bitAnd(Ops::lessEqual(top, py), Ops::lessEqual(py, bottom))); \
+        Ops::storeFlags(result + c, inside);                            \
+      }                                                                 \
+    Private::contains(x1, y1, x2, y2, x, y, c, count, result);          \
+  }                                                                     \
+                                                                        \
+  TARGET void intersects(float x1, float y1, float x2, float y2,        \
+                         const float* rectX1, const float* rectY1,      \
+                         const float* rectX2, const float* rectY2,      \
+                         int count, uchar* result)                      \
+  {                                                                     \
+    const Vec left = Ops::set(x1), top = Ops::set(y1), right = Ops::set(x2), bottom = Ops::set(y2); \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const IntVec overlap =                                          \
+          Ops::bitAnd(Ops::bitAnd(Ops::lessEqual(Ops::load(rectX1 + c), right), \
+                                  Ops::lessEqual(Ops::load(rectY1 + c), bottom)), \
+                      Ops::bitAnd(Ops::lessEqual(left, Ops::load(rectX2 + c)), \
+                                  Ops::lessEqual(top, Ops::load(rectY2 + c)))); \
+        Ops::storeFlags(result + c, overlap);                           \
+      }                                                                 \
+    Private::intersects(x1, y1, x2, y2, rectX1, rectY1, rectX2, rectY2, c, count, result); \
+  }                                                                     \
+                                                                        \
+  TARGET void distanceToSegment(float x1, float y1, float x2, float y2, \
+                                const float* x, const float* y, int count, \
+                                float* distances)                       \
+  {                                                                     \
+    const float dx = x2 - x1, dy = y2 - y1;                             \
+    const float length2 = dx*dx + dy*dy;                                \
+    const Vec startX = Ops::set(x1), startY = Ops::set(y1);             \
+    const Vec directionX = Ops::set(dx), directionY = Ops::set(dy);     \
+    const Vec length = Ops::set(length2 > 0 ? length2 : 1.0f);          \
+    const Vec zero = Ops::zeroFloat(), one = Ops::set(1.0f);            \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const Vec px = Ops::load(x + c), py = Ops::load(y + c);         \
+        Vec t = zero;                                                   \
+        if (length2 > 0)                                                \
+          t = Ops::min(Ops::max(Ops::div(Ops::add(Ops::mul(Ops::sub(px, startX), directionX), \
+                                                  Ops::mul(Ops::sub(py, startY), directionY)), \
+                                         length), zero), one);          \
+        const Vec ex = Ops::sub(px, Ops::add(startX, Ops::mul(t, directionX))); \
+        const Vec ey = Ops::sub(py, Ops::add(startY, Ops::mul(t, directionY))); \
+        Ops::store(distances + c, Ops::sqrt(Ops::add(Ops::mul(ex, ex), Ops::mul(ey, ey)))); \
+      }                                                                 \
+    Private::distanceToSegment(x1, y1, x2, y2, x, y, c, count, distances); \
+  }
+
+#ifdef PII_GEOMETRY_SSE2
+  namespace Sse2
+  {
+    struct Ops
+    {
+      enum { Width = 4 };
+      static inline __m128 load(const float* data) { return _mm_loadu_ps(data); }
+      static inline void store(float* data, __m128 value) { _mm_storeu_ps(data, value); }
+      static inline __m128 set(float value) { return _mm_set1_ps(value); }
+      static inline __m128 zeroFloat() { return _mm_setzero_ps(); }
+      static inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+      static inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+      static inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+      static inline __m128 div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+      static inline __m128 min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+      static inline __m128 max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+      static inline __m128 sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+      static inline __m128i lessEqual(__m128 a, __m128 b) { return _mm_castps_si128(_mm_cmple_ps(a, b)); }
+      static inline __m128i greater(__m128 a, __m128 b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+      static inline __m128i zero() { return _mm_setzero_si128(); }
+      static inline __m128i bitAnd(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+      // ~a & b
+      static inline __m128i andNot(__m128i a, __m128i b) { return _mm_andnot_si128(a, b); }
+      static inline __m128i addInt(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+      static inline __m128i subInt(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+      static inline __m128i notZero(__m128i a)
+      {
+        return _mm_andnot_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), _mm_set1_epi32(-1));
+      }
+      // Packs four lane masks to bytes and keeps the lowest bit.
+      static inline void storeFlags(uchar* flags, __m128i mask)
+      {
+        const __m128i bytes = _mm_and_si128(_mm_packs_epi16(_mm_packs_epi32(mask, mask), mask),
+                                            _mm_set1_epi8(1));
+        const int iBytes = _mm_cvtsi128_si32(bytes);
+        std::memcpy(flags, &iBytes, 4);
+      }
+    };
+    typedef __m128 Vec;
+    typedef __m128i IntVec;
+
+    PII_GEOMETRY_LOOPS(static)
+  }
+#endif
+
+#ifdef PII_GEOMETRY_AVX2
+  namespace Avx2
+  {
+#  define PII_AVX2 PII_TARGET("avx2")
+
+    struct Ops
+    {
+      enum { Width = 8 };
+      PII_AVX2 static inline __m256 load(const float* data) { return _mm256_loadu_ps(data); }
+      PII_AVX2 static inline void store(float* data, __m256 value) { _mm256_storeu_ps(data, value); }
+      PII_AVX2 static inline __m256 set(float value) { return _mm256_set1_ps(value); }
+      PII_AVX2 static inline __m256 zeroFloat() { return _mm256_setzero_ps(); }
+      PII_AVX2 static inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+      PII_AVX2 static inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+      PII_AVX2 static inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+      PII_AVX2 static inline __m256 div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+      PII_AVX2 static inline __m256 min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+      PII_AVX2 static inline __m256 max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+      PII_AVX2 static inline __m256 sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+      PII_AVX2 static inline __m256i lessEqual(__m256 a, __m256 b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+      PII_AVX2 static inline __m256i greater(__m256 a, __m256 b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+      PII_AVX2 static inline __m256i zero() { return _mm256_setzero_si256(); }
+      PII_AVX2 static inline __m256i bitAnd(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+      PII_AVX2 static inline __m256i andNot(__m256i a, __m256i b) { return _mm256_andnot_si256(a, b); }
+      PII_AVX2 static inline __m256i addInt(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+      PII_AVX2 static inline __m256i subInt(__m256i a, __m256i b) { return _mm256_sub_epi32(a, b); }
+      PII_AVX2 static inline __m256i notZero(__m256i a)
+      {
+        return _mm256_andnot_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), _mm256_set1_epi32(-1));
+      }
+      // Packs the two halves into eight bytes.
+      PII_AVX2 static inline void storeFlags(uchar* flags, __m256i mask)
+      {
+        const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+        const __m128i bytes = _mm_and_si128(_mm_packs_epi16(words, words), _mm_set1_epi8(1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(flags), bytes);
+      }
+    };
+    typedef __m256 Vec;
+    typedef __m256i IntVec;
+
+    PII_GEOMETRY_LOOPS(PII_AVX2 static)
+
+#  undef PII_AVX2
+  }
+#endif
+
+#ifdef PII_GEOMETRY_NEON
+  namespace Neon
+  {
+    struct Ops
+    {
+      enum { Width = 4 };
+      static inline float32x4_t load(const float* data) { return vld1q_f32(data); }
+      static inline void store(float* data, float32x4_t value) { vst1q_f32(data, value); }
+      static inline float32x4_t set(float value) { return vdupq_n_f32(value); }
+      static inline float32x4_t zeroFloat() { return vdupq_n_f32(0); }
+      static inline float32x4_t add(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+      static inline float32x4_t sub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+      static inline float32x4_t mul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+      static inline float32x4_t div(float32x4_t a, float32x4_t b) { return vdivq_f32(a, b); }
+      static inline float32x4_t min(float32x4_t a, float32x4_t b) { return vminq_f32(a, b); }
+      static inline float32x4_t max(float32x4_t a, float32x4_t b) { return vmaxq_f32(a, b); }
+      static inline float32x4_t sqrt(float32x4_t a) { return vsqrtq_f32(a); }
+      static inline int32x4_t lessEqual(float32x4_t a, float32x4_t b) { return vreinterpretq_s32_u32(vcleq_f32(a, b)); }
+      static inline int32x4_t greater(float32x4_t a, float32x4_t b) { return vreinterpretq_s32_u32(vcgtq_f32(a, b)); }
+      static inline int32x4_t zero() { return vdupq_n_s32(0); }
+      static inline int32x4_t bitAnd(int32x4_t a, int32x4_t b) { return vandq_s32(a, b); }
+      static inline int32x4_t andNot(int32x4_t a, int32x4_t b) { return vbicq_s32(b, a); }
+      static inline int32x4_t addInt(int32x4_t a, int32x4_t b) { return vaddq_s32(a, b); }
+      static inline int32x4_t subInt(int32x4_t a, int32x4_t b) { return vsubq_s32(a, b); }
+      static inline int32x4_t notZero(int32x4_t a) { return vreinterpretq_s32_u32(vtstq_s32(a, a)); }
+      static inline void storeFlags(uchar* flags, int32x4_t mask)
+      {
+        const uint16x4_t words = vmovn_u32(vreinterpretq_u32_s32(mask));
+        const uint8x8_t bytes = vand_u8(vmovn_u16(vcombine_u16(words, words)), vdup_n_u8(1));
+        vst1_lane_u32(reinterpret_cast<uint32_t*>(flags), vreinterpret_u32_u8(bytes), 0);
+      }
+    };
+    typedef float32x4_t Vec;
+    typedef int32x4_t IntVec;
+
+    PII_GEOMETRY_LOOPS(static)
+  }
+#endif
+
+#undef PII_GEOMETRY_LOOPS
+
+  /* There is no generic implementation. A null function makes
+     PiiGeometry use its scalar loops.
+   */
+#if defined(PII_GEOMETRY_AVX2)
+#  define PII_GEOMETRY_DISPATCHER(TYPE, FUNCTION)                       \
+  PiiCpuDispatcher<TYPE>()                                              \
+  .add(Pii::CpuAvx2, Avx2::FUNCTION)                                    \
+  .add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_GEOMETRY_SSE2)
+#  define PII_GEOMETRY_DISPATCHER(TYPE, FUNCTION)                       \
+  PiiCpuDispatcher<TYPE>().add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_GEOMETRY_NEON)
+#  define PII_GEOMETRY_DISPATCHER(TYPE, FUNCTION)                       \
+  PiiCpuDispatcher<TYPE>().add(Pii::CpuNeon, Neon::FUNCTION)
+#else
+#  define PII_GEOMETRY_DISPATCHER(TYPE, FUNCTION) PiiCpuDispatcher<TYPE>()
+#endif
+
+  static const PiiCpuDispatcher<PolygonFunction> polygonDispatcher =
+    PII_GEOMETRY_DISPATCHER(PolygonFunction, contains);
+  static const PiiCpuDispatcher<RectangleFunction> rectangleDispatcher =
+    PII_GEOMETRY_DISPATCHER(RectangleFunction, containsRect);
+  static const PiiCpuDispatcher<IntersectionFunction> intersectionDispatcher =
+    PII_GEOMETRY_DISPATCHER(IntersectionFunction, intersects);
+  static const PiiCpuDispatcher<DistanceFunction> distanceDispatcher =
+    PII_GEOMETRY_DISPATCHER(DistanceFunction, distanceToSegment);
+
+#undef PII_GEOMETRY_DISPATCHER
+
+  bool GeometryKernel<float>::contains(const float* vertexX, const float* vertexY, int vertexCount,
+                                       const float* x, const float* y, int count,
+                                       uchar* result)
+  {
+    PolygonFunction pFunction = polygonDispatcher.function();
+    if (pFunction == 0)
+      return false;
+    pFunction(vertexX, vertexY, vertexCount, x, y, count, result);
+    return true;
+  }
+
+  bool GeometryKernel<float>::contains(float x1, float y1, float x2, float y2,
+                                       const float* x, const float* y, int count,
+                                       uchar* result)
+  {
+    RectangleFunction pFunction = rectangleDispatcher.function();
+    if (pFunction == 0)
+      return false;
+    pFunction(x1, y1, x2, y2, x, y, count, result);
+    return true;
+  }
+
+  bool GeometryKernel<float>::intersects(float x1, float y1, float x2, float y2,
+                                         const float* rectX1, const float* rectY1,
+                                         const float* rectX2, const float* rectY2,
+                                         int count, uchar* result)
+  {
+    IntersectionFunction pFunction = intersectionDispatcher.function();
+    if (pFunction == 0)
+      return false;
+    pFunction(x1, y1, x2, y2, rectX1, rectY1, rectX2, rectY2, count, result);
+    return true;
+  }
+
+  bool GeometryKernel<float>::distanceToSegment(float x1, float y1, float x2, float y2,
+                                                const float* x, const float* y, int count,
+                                                float* distances)
+  {
+    DistanceFunction pFunction = distanceDispatcher.function();
+    if (pFunction == 0)
+      return false;
+    pFunction(x1, y1, x2, y2, x, y, count, distances);
+    return true;
+  }
+}
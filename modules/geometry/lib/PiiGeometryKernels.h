@@ -0,0 +1,84 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIGEOMETRYKERNELS_H
+#define _PIIGEOMETRYKERNELS_H
+
+#include "PiiGeometryGlobal.h"
+
+namespace PiiGeometry
+{
+  /**
+   * Vectorized versions of the batched point and rectangle tests in
+   * PiiGeometry. Each kernel processes 4 (SSE2, NEON) or 8 (AVX2)
+   * points or rectangles at once. Polygon edges, segment end points
+   * and query rectangles are broadcast to all lanes, so there are no
+   * gathers or branches in the inner loops.
+   *
+   * The generic template says "not supported", and PiiGeometry falls
+   * back to scalar loops. A specialization exists for `float`. The
+   * arithmetic is the same as in the scalar code. The flags are
+   * identical except possibly for points that lie exactly on a
+   * polygon edge if the compiler fuses the scalar multiply-adds.
+   * Each function returns `false` if the CPU lacks the required
+   * instructions. In this case the output is not modified.
+   *
+   * @internal
+   */
+  template <class T> struct GeometryKernel
+  {
+    /**
+     * Sets `result[i]` to one if the polygon whose *vertexCount*
+     * vertices are stored in *vertexX* and *vertexY* contains the
+     * point (`x[i]`, `y[i]`), and to zero otherwise.
+     */
+    static bool contains(const T*, const T*, int, const T*, const T*, int, unsigned char*) { return false; }
+    /**
+     * Sets `result[i]` to one if the point (`x[i]`, `y[i]`) is
+     * inside the closed rectangle (*x1*, *y1*)-(*x2*, *y2*).
+     */
+    static bool contains(T, T, T, T, const T*, const T*, int, unsigned char*) { return false; }
+    /**
+     * Sets `result[i]` to one if the closed rectangle (*x1*,
+     * *y1*)-(*x2*, *y2*) intersects the *i*th rectangle in the four
+     * edge arrays.
+     */
+    static bool intersects(T, T, T, T, const T*, const T*, const T*, const T*, int, unsigned char*) { return false; }
+    /**
+     * Stores the distance from each point to the line segment
+     * (*x1*, *y1*)-(*x2*, *y2*) to *distances*.
+     */
+    static bool distanceToSegment(T, T, T, T, const T*, const T*, int, T*) { return false; }
+  };
+
+  template <> struct PII_GEOMETRY_EXPORT GeometryKernel<float>
+  {
+    static bool contains(const float* vertexX, const float* vertexY, int vertexCount,
+                         const float* x, const float* y, int count,
+                         unsigned char* result);
+    static bool contains(float x1, float y1, float x2, float y2,
+                         const float* x, const float* y, int count,
+                         unsigned char* result);
+    static bool intersects(float x1, float y1, float x2, float y2,
+                           const float* rectX1, const float* rectY1,
+                           const float* rectX2, const float* rectY2,
+                           int count, unsigned char* result);
+    static bool distanceToSegment(float x1, float y1, float x2, float y2,
+                                  const float* x, const float* y, int count,
+                                  float* distances);
+  };
+}
+
+#endif //_PIIGEOMETRYKERNELS_H
@@ -0,0 +1,146 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPOINTARRAY_H
+#define _PIIPOINTARRAY_H
+
+#include <PiiMatrix.h>
+#include <PiiPoint.h>
+#include <QVector>
+
+/**
+ * A set of 2D points stored as a structure of arrays. The x and y
+ * coordinates are kept in two separate, contiguous arrays, which
+ * lets the batched functions in [PiiGeometry] test many points with
+ * a single vector instruction.
+ *
+ * ~~~(c++)
+ * PiiPointArray<float> points;
+ * points.reserve(trackedObjects.size());
+ * for (int i=0; i<trackedObjects.size(); ++i)
+ *   points.append(trackedObjects[i].x, trackedObjects[i].y);
+ * QVector<unsigned char> vecInside = PiiGeometry::contains(polygon, points);
+ * ~~~
+ */
+template <class T> class PiiPointArray
+{
+public:
+  /**
+   * Creates an empty point array.
+   */
+  PiiPointArray() {}
+
+  /**
+   * Creates an array of *count* points at the origin.
+   */
+  explicit PiiPointArray(int count) : _vecX(count, T(0)), _vecY(count, T(0)) {}
+
+  /**
+   * Creates an array out of a N-by-2 matrix in which each row
+   * represents a point (x,y).
+   */
+  explicit PiiPointArray(const PiiMatrix<T>& points) :
+    _vecX(points.rows()), _vecY(points.rows())
+  {
+    for (int i=0; i<points.rows(); ++i)
+      {
+        const T* pRow = points[i];
+        _vecX[i] = pRow[0];
+        _vecY[i] = pRow[1];
+      }
+  }
+
+  /**
+   * Creates an array out of a list of points.
+   */
+  explicit PiiPointArray(const QVector<PiiPoint<T> >& points) :
+    _vecX(points.size()), _vecY(points.size())
+  {
+    for (int i=0; i<points.size(); ++i)
+      {
+        _vecX[i] = points[i].x;
+        _vecY[i] = points[i].y;
+      }
+  }
+
+  /**
+   * Returns the number of points.
+   */
+  int count() const { return _vecX.size(); }
+  /**
+   * Returns `true` if there are no points.
+   */
+  bool isEmpty() const { return _vecX.isEmpty(); }
+
+  /**
+   * Reserves space for *count* points.
+   */
+  void reserve(int count) { _vecX.reserve(count); _vecY.reserve(count); }
+  /**
+   * Changes the number of points. New points are placed at the
+   * origin.
+   */
+  void resize(int count) { _vecX.resize(count); _vecY.resize(count); }
+  /**
+   * Removes all points.
+   */
+  void clear() { _vecX.clear(); _vecY.clear(); }
+
+  /**
+   * Adds a point to the end of the array.
+   */
+  void append(T x, T y) { _vecX.append(x); _vecY.append(y); }
+  void append(const PiiPoint<T>& point) { append(point.x, point.y); }
+
+  /**
+   * Returns the point at *index*.
+   */
+  PiiPoint<T> at(int index) const { return PiiPoint<T>(_vecX[index], _vecY[index]); }
+  /**
+   * Replaces the point at *index*.
+   */
+  void set(int index, T x, T y) { _vecX[index] = x; _vecY[index] = y; }
+
+  /**
+   * Returns a pointer to the x coordinates.
+   */
+  const T* x() const { return _vecX.constData(); }
+  T* x() { return _vecX.data(); }
+  /**
+   * Returns a pointer to the y coordinates.
+   */
+  const T* y() const { return _vecY.constData(); }
+  T* y() { return _vecY.data(); }
+
+  /**
+   * Returns the points as a N-by-2 matrix, one point per row.
+   */
+  PiiMatrix<T> toMatrix() const
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(count(), 2));
+    for (int i=0; i<count(); ++i)
+      {
+        T* pRow = matResult[i];
+        pRow[0] = _vecX[i];
+        pRow[1] = _vecY[i];
+      }
+    return matResult;
+  }
+
+private:
+  QVector<T> _vecX, _vecY;
+};
+
+#endif //_PIIPOINTARRAY_H
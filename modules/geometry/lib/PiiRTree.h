@@ -0,0 +1,290 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRTREE_H
+#define _PIIRTREE_H
+
+#include <PiiRectangle.h>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * A static R-tree for finding rectangles that overlap a query
+ * rectangle or contain a point. The tree is built once from a fixed
+ * set of rectangles, typically the bounding boxes of measurement
+ * areas or other shapes, and cannot be modified afterwards. A query
+ * visits only the branches whose bounding boxes overlap the query,
+ * which makes it `O(log N)` for small queries instead of the `O(N)`
+ * of testing all rectangles.
+ *
+ * The tree is bulk-loaded using the Sort-Tile-Recursive (STR)
+ * algorithm: the rectangles are sorted by the x coordinate of their
+ * center, cut into vertical slices, and each slice is sorted by y
+ * and packed into full nodes of `NodeCapacity` entries. The same is
+ * repeated for the nodes until a single root remains. The nodes are
+ * stored in a single array, leaves first, and the children of each
+ * node are next to each other in memory.
+ *
+ * ~~~(c++)
+ * QVector<PiiRectangle<double> > lstBoundingBoxes;
+ * for (int i=0; i<lstPolygons.size(); ++i)
+ *   lstBoundingBoxes << boundingBox(lstPolygons[i]);
+ * PiiRTree<double> tree(lstBoundingBoxes);
+ *
+ * // Run the exact test only for polygons whose bounding box
+ * // contains the point.
+ * QVector<int> vecCandidates = tree.containing(x, y);
+ * for (int i=0; i<vecCandidates.size(); ++i)
+ *   if (PiiGeometry::contains(lstPolygons[vecCandidates[i]], x, y))
+ *     ...
+ * ~~~
+ *
+ * The rectangles are closed, as in PiiRectangle::intersects(). The
+ * tree is thread-safe for queries.
+ */
+template <class T> class PiiRTree
+{
+public:
+  /**
+   * The maximum number of children in a node.
+   */
+  enum { NodeCapacity = 16 };
+
+  /**
+   * Creates an empty tree.
+   */
+  PiiRTree() : _iLeafCount(0) {}
+
+  /**
+   * Creates a tree out of *rectangles*. The indices returned by
+   * queries refer to this list.
+   */
+  explicit PiiRTree(const QVector<PiiRectangle<T> >& rectangles) : _iLeafCount(0)
+  {
+    build(rectangles);
+  }
+
+  /**
+   * Discards the current tree and builds a new one out of
+   * *rectangles*.
+   */
+  void build(const QVector<PiiRectangle<T> >& rectangles);
+
+  /**
+   * Returns the number of rectangles in the tree.
+   */
+  int count() const { return _vecEntries.size(); }
+  /**
+   * Returns `true` if there are no rectangles in the tree.
+   */
+  bool isEmpty() const { return _vecEntries.isEmpty(); }
+
+  /**
+   * Returns the bounding box of all rectangles in the tree, or an
+   * empty rectangle if the tree is empty.
+   */
+  PiiRectangle<T> bounds() const
+  {
+    if (_vecNodes.isEmpty())
+      return PiiRectangle<T>();
+    const Box& root = _vecNodes.last();
+    return PiiRectangle<T>(root.x1, root.y1, root.x2 - root.x1, root.y2 - root.y1);
+  }
+
+  /**
+   * Appends the indices of all rectangles that intersect *rectangle*
+   * to *indices*. The indices are in no particular order.
+   */
+  void intersecting(const PiiRectangle<T>& rectangle, QVector<int>& indices) const;
+
+  /**
+   * Returns the indices of all rectangles that intersect
+   * *rectangle*.
+   */
+  QVector<int> intersecting(const PiiRectangle<T>& rectangle) const
+  {
+    QVector<int> vecResult;
+    intersecting(rectangle, vecResult);
+    return vecResult;
+  }
+
+  /**
+   * Appends the indices of all rectangles that contain the point
+   * (*x*, *y*) to *indices*.
+   */
+  void containing(T x, T y, QVector<int>& indices) const
+  {
+    intersecting(PiiRectangle<T>(x, y, 0, 0), indices);
+  }
+
+  /**
+   * Returns the indices of all rectangles that contain the point
+   * (*x*, *y*).
+   */
+  QVector<int> containing(T x, T y) const
+  {
+    QVector<int> vecResult;
+    containing(x, y, vecResult);
+    return vecResult;
+  }
+
+private:
+  enum { MaxDepth = 8 };
+
+  /* A rectangle stored as its corners. For an entry, iFirst is the
+     index of the rectangle in the original list. For a node, the
+     children are at [iFirst, iEnd) in _vecEntries (leaf nodes) or
+     _vecNodes.
+   */
+  struct Box
+  {
+    T x1, y1, x2, y2;
+    int iFirst, iEnd;
+
+    bool intersects(T qx1, T qy1, T qx2, T qy2) const
+    {
+      return x1 <= qx2 && y1 <= qy2 && x2 >= qx1 && y2 >= qy1;
+    }
+  };
+
+  struct CenterXLess
+  {
+    bool operator() (const Box& a, const Box& b) const { return a.x1 + a.x2 < b.x1 + b.x2; }
+  };
+  struct CenterYLess
+  {
+    bool operator() (const Box& a, const Box& b) const { return a.y1 + a.y2 < b.y1 + b.y2; }
+  };
+
+  static void sortTiles(QVector<Box>& boxes);
+  static QVector<Box> pack(const QVector<Box>& boxes, int offset);
+
+  QVector<Box> _vecEntries;
+  // Leaves first, root last.
+  QVector<Box> _vecNodes;
+  int _iLeafCount;
+};
+
+template <class T> void PiiRTree<T>::build(const QVector<PiiRectangle<T> >& rectangles)
+{
+  _vecEntries.clear();
+  _vecNodes.clear();
+  _iLeafCount = 0;
+  if (rectangles.isEmpty())
+    return;
+
+  _vecEntries.resize(rectangles.size());
+  for (int i=0; i<rectangles.size(); ++i)
+    {
+      const PiiRectangle<T>& rect = rectangles[i];
+      Box& entry = _vecEntries[i];
+      entry.x1 = rect.x;
+      entry.y1 = rect.y;
+      entry.x2 = rect.x + rect.width;
+      entry.y2 = rect.y + rect.height;
+      entry.iFirst = i;
+      entry.iEnd = i+1;
+    }
+
+  sortTiles(_vecEntries);
+  QVector<Box> vecLevel(pack(_vecEntries, 0));
+  _iLeafCount = vecLevel.size();
+  while (vecLevel.size() > 1)
+    {
+      // The children of vecLevel are already in place. Sorting the
+      // level itself only changes the order of its nodes.
+      sortTiles(vecLevel);
+      const int iOffset = _vecNodes.size();
+      for (int i=0; i<vecLevel.size(); ++i)
+        _vecNodes.append(vecLevel[i]);
+      vecLevel = pack(vecLevel, iOffset);
+    }
+  _vecNodes.append(vecLevel[0]);
+}
+
+template <class T> void PiiRTree<T>::sortTiles(QVector<Box>& boxes)
+{
+  const int iCount = boxes.size();
+  const int iNodeCount = (iCount + NodeCapacity - 1) / NodeCapacity;
+  const int iSliceCount = int(std::ceil(std::sqrt(double(iNodeCount))));
+  const int iSliceSize = iSliceCount * NodeCapacity;
+
+  std::sort(boxes.begin(), boxes.end(), CenterXLess());
+  for (int i=0; i<iCount; i += iSliceSize)
+    std::sort(boxes.begin() + i, boxes.begin() + qMin(i + iSliceSize, iCount), CenterYLess());
+}
+
+template <class T> QVector<typename PiiRTree<T>::Box> PiiRTree<T>::pack(const QVector<Box>& boxes, int offset)
+{
+  const int iCount = boxes.size();
+  QVector<Box> vecParents;
+  vecParents.reserve((iCount + NodeCapacity - 1) / NodeCapacity);
+  for (int i=0; i<iCount; i += NodeCapacity)
+    {
+      const int iEnd = qMin(i + NodeCapacity, iCount);
+      Box parent = boxes[i];
+      for (int j=i+1; j<iEnd; ++j)
+        {
+          const Box& child = boxes[j];
+          if (child.x1 < parent.x1) parent.x1 = child.x1;
+          if (child.y1 < parent.y1) parent.y1 = child.y1;
+          if (child.x2 > parent.x2) parent.x2 = child.x2;
+          if (child.y2 > parent.y2) parent.y2 = child.y2;
+        }
+      parent.iFirst = offset + i;
+      parent.iEnd = offset + iEnd;
+      vecParents.append(parent);
+    }
+  return vecParents;
+}
+
+template <class T> void PiiRTree<T>::intersecting(const PiiRectangle<T>& rectangle, QVector<int>& indices) const
+{
+  if (_vecNodes.isEmpty())
+    return;
+
+  const T qx1 = rectangle.x, qy1 = rectangle.y;
+  const T qx2 = rectangle.x + rectangle.width, qy2 = rectangle.y + rectangle.height;
+
+  // A depth-first search leaves at most NodeCapacity-1 siblings
+  // pending per level, and a tree of 2^31 entries has no more than
+  // eight levels.
+  int aiStack[MaxDepth * NodeCapacity];
+  int iStackSize = 0;
+  const int iRoot = _vecNodes.size() - 1;
+  if (_vecNodes[iRoot].intersects(qx1, qy1, qx2, qy2))
+    aiStack[iStackSize++] = iRoot;
+
+  while (iStackSize > 0)
+    {
+      const int iNode = aiStack[--iStackSize];
+      const Box& node = _vecNodes[iNode];
+      if (iNode < _iLeafCount)
+        {
+          for (int i=node.iFirst; i<node.iEnd; ++i)
+            if (_vecEntries[i].intersects(qx1, qy1, qx2, qy2))
+              indices.append(_vecEntries[i].iFirst);
+        }
+      else
+        {
+          for (int i=node.iFirst; i<node.iEnd; ++i)
+            if (_vecNodes[i].intersects(qx1, qy1, qx2, qy2))
+              aiStack[iStackSize++] = i;
+        }
+    }
+}
+
+#endif //_PIIRTREE_H
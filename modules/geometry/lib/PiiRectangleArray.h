@@ -0,0 +1,101 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRECTANGLEARRAY_H
+#define _PIIRECTANGLEARRAY_H
+
+#include <PiiRectangle.h>
+#include <QVector>
+
+/**
+ * A set of rectangles stored as a structure of arrays. Each
+ * rectangle is stored as its top left and bottom right corners
+ * (`x`, `y`, `x` + `width`, `y` + `height`) in four contiguous
+ * arrays. See [PiiPointArray] and [PiiGeometry::intersects()].
+ */
+template <class T> class PiiRectangleArray
+{
+public:
+  /**
+   * Creates an empty rectangle array.
+   */
+  PiiRectangleArray() {}
+
+  /**
+   * Creates an array out of a list of rectangles.
+   */
+  explicit PiiRectangleArray(const QVector<PiiRectangle<T> >& rectangles)
+  {
+    reserve(rectangles.size());
+    for (int i=0; i<rectangles.size(); ++i)
+      append(rectangles[i]);
+  }
+
+  /**
+   * Returns the number of rectangles.
+   */
+  int count() const { return _vecX1.size(); }
+  /**
+   * Returns `true` if there are no rectangles.
+   */
+  bool isEmpty() const { return _vecX1.isEmpty(); }
+
+  /**
+   * Reserves space for *count* rectangles.
+   */
+  void reserve(int count)
+  {
+    _vecX1.reserve(count); _vecY1.reserve(count);
+    _vecX2.reserve(count); _vecY2.reserve(count);
+  }
+  /**
+   * Removes all rectangles.
+   */
+  void clear() { _vecX1.clear(); _vecY1.clear(); _vecX2.clear(); _vecY2.clear(); }
+
+  /**
+   * Adds a rectangle to the end of the array.
+   */
+  void append(const PiiRectangle<T>& rectangle)
+  {
+    _vecX1.append(rectangle.x);
+    _vecY1.append(rectangle.y);
+    _vecX2.append(rectangle.x + rectangle.width);
+    _vecY2.append(rectangle.y + rectangle.height);
+  }
+
+  /**
+   * Returns the rectangle at *index*.
+   */
+  PiiRectangle<T> at(int index) const
+  {
+    return PiiRectangle<T>(_vecX1[index], _vecY1[index],
+                           _vecX2[index] - _vecX1[index], _vecY2[index] - _vecY1[index]);
+  }
+
+  /**
+   * Returns a pointer to the left (x1), top (y1), right (x2) or
+   * bottom (y2) edges.
+   */
+  const T* x1() const { return _vecX1.constData(); }
+  const T* y1() const { return _vecY1.constData(); }
+  const T* x2() const { return _vecX2.constData(); }
+  const T* y2() const { return _vecY2.constData(); }
+
+private:
+  QVector<T> _vecX1, _vecY1, _vecX2, _vecY2;
+};
+
+#endif //_PIIRECTANGLEARRAY_H
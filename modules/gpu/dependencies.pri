@@ -0,0 +1 @@
+EXTENSIONS = opencl
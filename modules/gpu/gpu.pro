@@ -0,0 +1,2 @@
+MODULE = Gpu
+include(../module.pri)
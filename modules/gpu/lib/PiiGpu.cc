@@ -0,0 +1,123 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiGpu.h"
+#include "PiiGpuDispatcher.h"
+
+#ifndef PII_NO_OPENCL
+#  include "PiiOpenCl.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+namespace PiiGpu
+{
+  static int probeBackends()
+  {
+    int iBackends = 0;
+#ifndef PII_NO_OPENCL
+    if (PiiOpenCl::isAvailable())
+      iBackends |= OpenClBackend;
+#endif
+    return iBackends;
+  }
+
+  // Parses the value of PII_GPU_BACKENDS. Unknown names are ignored.
+  static int initialBackendMask()
+  {
+    const char* pBackends = std::getenv("PII_GPU_BACKENDS");
+    if (pBackends == 0 || *pBackends == 0)
+      return -1;
+
+    static const struct { const char* pName; int iBackend; } aNames[] =
+      {
+        { "opencl", OpenClBackend },
+        { "none", 0 }
+      };
+    int iMask = 0;
+    while (*pBackends != 0)
+      {
+        size_t iLength = std::strcspn(pBackends, ",");
+        for (size_t i=0; i<sizeof(aNames)/sizeof(aNames[0]); ++i)
+          if (std::strlen(aNames[i].pName) == iLength &&
+              std::strncmp(aNames[i].pName, pBackends, iLength) == 0)
+            iMask |= aNames[i].iBackend;
+        pBackends += iLength;
+        if (*pBackends == ',')
+          ++pBackends;
+      }
+    return iMask;
+  }
+
+  static volatile int& backendMaskRef()
+  {
+    static volatile int iBackendMask = initialBackendMask();
+    return iBackendMask;
+  }
+
+  int backends()
+  {
+    // Probing creates the device context, which must happen only
+    // once.
+    static const int iBackends = backendMaskRef() != 0 ? probeBackends() : 0;
+    return iBackends & backendMaskRef();
+  }
+
+  void setBackendMask(int mask)
+  {
+    backendMaskRef() = mask;
+  }
+
+  int backendMask()
+  {
+    return backendMaskRef();
+  }
+
+  static bool thresholdHost(const PiiMatrix<uchar>& image, uchar level, PiiMatrix<uchar>& result)
+  {
+    // The input may come from a device whose backend has since been
+    // disabled.
+    image.syncHost();
+    const int iRows = image.rows(), iColumns = image.columns();
+    result = PiiMatrix<uchar>::uninitialized(iRows, iColumns);
+    for (int r=0; r<iRows; ++r)
+      {
+        const uchar* pSource = image[r];
+        uchar* pTarget = result[r];
+        for (int c=0; c<iColumns; ++c)
+          pTarget[c] = pSource[c] < level ? 0 : 1;
+      }
+    return true;
+  }
+
+  typedef bool (*ThresholdFunction)(const PiiMatrix<uchar>&, uchar, PiiMatrix<uchar>&);
+
+  static const PiiGpuDispatcher<ThresholdFunction> thresholdDispatcher =
+    PiiGpuDispatcher<ThresholdFunction>(thresholdHost)
+#ifndef PII_NO_OPENCL
+    .add(OpenClBackend, PiiOpenCl::threshold)
+#endif
+    ;
+
+  PiiMatrix<uchar> threshold(const PiiMatrix<uchar>& image, uchar level)
+  {
+    PiiMatrix<uchar> result;
+    // A device implementation returns false if the device fails.
+    if (!thresholdDispatcher.function()(image, level, result))
+      thresholdHost(image, level, result);
+    return result;
+  }
+}
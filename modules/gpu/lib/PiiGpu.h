@@ -0,0 +1,74 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIGPU_H
+#define _PIIGPU_H
+
+#include "PiiGpuGlobal.h"
+#include <PiiMatrix.h>
+
+/**
+ * Image processing functions that run on a compute device and leave
+ * their results in device memory. The result of each function has a
+ * [PiiDeviceBuffer] attached to it, and another function in this
+ * namespace will use it without copying the data through host
+ * memory. Call [PiiTypelessMatrix::syncHost()] before reading the
+ * result on the host.
+ *
+ * If no backend is enabled, or the device fails, the functions run
+ * on the host. The result is the same either way.
+ */
+namespace PiiGpu
+{
+  /**
+   * Compute backends.
+   *
+   * - `OpenClBackend` - the first OpenCL 1.2 device, GPUs preferred.
+   */
+  enum Backend
+  {
+    OpenClBackend = 0x1
+  };
+
+  /**
+   * Returns the backends that have a usable device and are not
+   * masked out by [setBackendMask()], as a bitwise OR of [Backend]
+   * values. The devices are probed on first use.
+   */
+  PII_GPU_EXPORT int backends();
+
+  /**
+   * Restricts the backends reported by [backends()] to those set in
+   * *mask*. Setting the mask to zero makes all functions run on the
+   * host.
+   *
+   * The initial mask is read from the `PII_GPU_BACKENDS` environment
+   * variable, a comma-separated list of backend names (`opencl`) or
+   * `none`. If the variable is not set, all backends are enabled.
+   */
+  PII_GPU_EXPORT void setBackendMask(int mask);
+  /**
+   * Returns the current backend mask.
+   */
+  PII_GPU_EXPORT int backendMask();
+
+  /**
+   * Thresholds *image*. Pixels below *level* become zero and the
+   * others one, as with [PiiImage::ThresholdFunction].
+   */
+  PII_GPU_EXPORT PiiMatrix<uchar> threshold(const PiiMatrix<uchar>& image, uchar level);
+}
+
+#endif //_PIIGPU_H
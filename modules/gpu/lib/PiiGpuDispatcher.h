@@ -0,0 +1,143 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIGPUDISPATCHER_H
+#define _PIIGPUDISPATCHER_H
+
+#include "PiiGpu.h"
+
+/**
+ * Selects one of many implementations of a function based on the
+ * enabled compute backends. This is the counterpart of
+ * [PiiCpuDispatcher] for [PiiGpu::backends()]: [function()] returns
+ * the first registered implementation whose backends are all
+ * enabled, or the host implementation given to the constructor if
+ * none is. The choice is cached and redone only if
+ * [PiiGpu::setBackendMask()] changes the enabled backends.
+ *
+ * ~~~(c++)
+ * typedef bool (*ThresholdFunction)(const PiiMatrix<uchar>&, uchar, PiiMatrix<uchar>&);
+ *
+ * static const PiiGpuDispatcher<ThresholdFunction> thresholdDispatcher =
+ *   PiiGpuDispatcher<ThresholdFunction>(thresholdHost)
+ *   .add(PiiGpu::OpenClBackend, PiiOpenCl::threshold);
+ * ~~~
+ *
+ * The dispatcher is thread-safe once all implementations have been
+ * added.
+ */
+template <class Function> class PiiGpuDispatcher
+{
+public:
+  /**
+   * The maximum number of implementations in addition to the host
+   * one.
+   */
+  enum { MaxImplementations = 4 };
+
+  /**
+   * Creates a dispatcher with the given host implementation.
+   */
+  PiiGpuDispatcher(Function host = 0) :
+    _host(host),
+    _iCount(0),
+    _iCache(-1)
+  {}
+
+  PiiGpuDispatcher(const PiiGpuDispatcher& other) :
+    _host(other._host),
+    _iCount(other._iCount),
+    _iCache(-1)
+  {
+    for (int i=0; i<_iCount; ++i)
+      _aImplementations[i] = other._aImplementations[i];
+  }
+
+  /**
+   * Registers *function* as an implementation that requires all of
+   * the *backends*, a bitwise OR of [PiiGpu::Backend] values. Full
+   * dispatchers and null pointers ignore the call. Returns a
+   * reference to `this`.
+   */
+  PiiGpuDispatcher& add(int backends, Function function)
+  {
+    if (function != 0 && _iCount < MaxImplementations)
+      {
+        _aImplementations[_iCount].iBackends = backends;
+        _aImplementations[_iCount].function = function;
+        ++_iCount;
+        _iCache = -1;
+      }
+    return *this;
+  }
+
+  /**
+   * Returns the best implementation for the currently enabled
+   * backends.
+   */
+  Function function() const
+  {
+    const int iIndex = selectedIndex();
+    return iIndex == Host ? _host : _aImplementations[iIndex].function;
+  }
+
+  /**
+   * Returns the backends required by the implementation currently
+   * returned by [function()], or zero if the host implementation is
+   * selected.
+   */
+  int selectedBackends() const
+  {
+    const int iIndex = selectedIndex();
+    return iIndex == Host ? 0 : _aImplementations[iIndex].iBackends;
+  }
+
+private:
+  enum { Host = 0xff };
+
+  PiiGpuDispatcher& operator= (const PiiGpuDispatcher&);
+
+  int selectedIndex() const
+  {
+    const int iBackends = PiiGpu::backends();
+    // Same single-int cache as in PiiCpuDispatcher.
+    const int iCache = _iCache;
+    if (iCache >= 0 && (iCache >> 8) == iBackends)
+      return iCache & 0xff;
+
+    int iIndex = Host;
+    for (int i=0; i<_iCount; ++i)
+      if ((_aImplementations[i].iBackends & iBackends) == _aImplementations[i].iBackends)
+        {
+          iIndex = i;
+          break;
+        }
+    _iCache = iBackends << 8 | iIndex;
+    return iIndex;
+  }
+
+  struct Implementation
+  {
+    int iBackends;
+    Function function;
+  };
+
+  Function _host;
+  Implementation _aImplementations[MaxImplementations];
+  int _iCount;
+  mutable volatile int _iCache;
+};
+
+#endif //_PIIGPUDISPATCHER_H
@@ -0,0 +1,179 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiOpenCl.h"
+
+namespace PiiOpenCl
+{
+  static const char* pKernelSource =
+    "__kernel void threshold(__global const uchar* source, int sourceStride,\n"
+    "                        __global uchar* target, int targetStride,\n"
+    "                        uchar level)\n"
+    "{\n"
+    "  const int c = get_global_id(0), r = get_global_id(1);\n"
+    "  target[r * targetStride + c] = source[r * sourceStride + c] < level ? 0 : 1;\n"
+    "}\n";
+
+  // The device, its command queue and the compiled kernels. The
+  // context is created once and never released.
+  struct Context
+  {
+    Context();
+
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+  };
+
+  Context::Context() :
+    context(0), queue(0), program(0)
+  {
+    cl_platform_id aPlatforms[8];
+    cl_uint iPlatforms = 0;
+    if (clGetPlatformIDs(8, aPlatforms, &iPlatforms) != CL_SUCCESS)
+      return;
+    if (iPlatforms > 8)
+      iPlatforms = 8;
+
+    // Prefer a GPU, take any device otherwise.
+    const cl_device_type aTypes[2] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL };
+    cl_device_id device = 0;
+    for (int t=0; t<2 && device == 0; ++t)
+      for (cl_uint i=0; i<iPlatforms && device == 0; ++i)
+        if (clGetDeviceIDs(aPlatforms[i], aTypes[t], 1, &device, 0) != CL_SUCCESS)
+          device = 0;
+    if (device == 0)
+      return;
+
+    cl_int iError;
+    cl_context ctx = clCreateContext(0, 1, &device, 0, 0, &iError);
+    if (iError != CL_SUCCESS)
+      return;
+    cl_command_queue q = clCreateCommandQueue(ctx, device, 0, &iError);
+    if (iError != CL_SUCCESS)
+      {
+        clReleaseContext(ctx);
+        return;
+      }
+    cl_program prog = clCreateProgramWithSource(ctx, 1, &pKernelSource, 0, &iError);
+    if (iError == CL_SUCCESS && clBuildProgram(prog, 1, &device, 0, 0, 0) != CL_SUCCESS)
+      {
+        clReleaseProgram(prog);
+        iError = CL_BUILD_PROGRAM_FAILURE;
+      }
+    if (iError != CL_SUCCESS)
+      {
+        clReleaseCommandQueue(q);
+        clReleaseContext(ctx);
+        return;
+      }
+    context = ctx;
+    queue = q;
+    program = prog;
+  }
+
+  static Context& context()
+  {
+    static Context ctx;
+    return ctx;
+  }
+
+  PiiOpenClBuffer::~PiiOpenClBuffer()
+  {
+    clReleaseMemObject(_memory);
+  }
+
+  void PiiOpenClBuffer::download(void* host, std::size_t stride, int rows)
+  {
+    const size_t aOrigin[3] = { 0, 0, 0 };
+    const size_t aRegion[3] = { _bytesPerRow, size_t(rows), 1 };
+    // The queue is in order: all kernels writing to the buffer have
+    // finished once the blocking read returns.
+    clEnqueueReadBufferRect(context().queue, _memory, CL_TRUE,
+                            aOrigin, aOrigin, aRegion,
+                            _stride, 0, stride, 0,
+                            host, 0, 0, 0);
+  }
+
+  bool isAvailable()
+  {
+    return context().program != 0;
+  }
+
+  bool threshold(const PiiMatrix<uchar>& image, uchar level, PiiMatrix<uchar>& result)
+  {
+    const int iRows = image.rows(), iColumns = image.columns();
+    if (iRows == 0 || iColumns == 0)
+      {
+        result = PiiMatrix<uchar>(iRows, iColumns);
+        return true;
+      }
+    Context& ctx = context();
+    cl_int iError;
+
+    // Use the device copy if there is one. Otherwise upload.
+    PiiOpenClBuffer* pSource = dynamic_cast<PiiOpenClBuffer*>(image.deviceBuffer());
+    if (pSource != 0)
+      pSource->reserve();
+    else
+      {
+        image.syncHost();
+        const std::size_t iSize = image.stride() * (iRows - 1) + iColumns;
+        cl_mem memory = clCreateBuffer(ctx.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       iSize, const_cast<uchar*>(image[0]), &iError);
+        if (iError != CL_SUCCESS)
+          return false;
+        pSource = new PiiOpenClBuffer(memory, image.stride(), iColumns);
+      }
+
+    result = PiiMatrix<uchar>::uninitialized(iRows, iColumns);
+    cl_mem target = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE,
+                                   result.stride() * iRows, 0, &iError);
+    if (iError != CL_SUCCESS)
+      {
+        pSource->release();
+        return false;
+      }
+    PiiOpenClBuffer* pTarget = new PiiOpenClBuffer(target, result.stride(), iColumns);
+
+    // A kernel object per call: setting arguments isn't thread-safe.
+    cl_mem source = pSource->memory();
+    const cl_int iSourceStride = cl_int(pSource->stride()), iTargetStride = cl_int(result.stride());
+    const cl_uchar ucLevel = level;
+    cl_kernel kernel = clCreateKernel(ctx.program, "threshold", &iError);
+    if (iError == CL_SUCCESS)
+      {
+        const size_t aSize[2] = { size_t(iColumns), size_t(iRows) };
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &source);
+        clSetKernelArg(kernel, 1, sizeof(cl_int), &iSourceStride);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &target);
+        clSetKernelArg(kernel, 3, sizeof(cl_int), &iTargetStride);
+        clSetKernelArg(kernel, 4, sizeof(cl_uchar), &ucLevel);
+        iError = clEnqueueNDRangeKernel(ctx.queue, kernel, 2, 0, aSize, 0, 0, 0, 0);
+        clReleaseKernel(kernel);
+      }
+    // The queue holds its own references to the memory objects.
+    pSource->release();
+    if (iError != CL_SUCCESS)
+      {
+        pTarget->release();
+        return false;
+      }
+    pTarget->setHostStale(true);
+    result.setDeviceBuffer(pTarget);
+    pTarget->release();
+    return true;
+  }
+}
@@ -0,0 +1,75 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2014.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOPENCL_H
+#define _PIIOPENCL_H
+
+#include <PiiDeviceBuffer.h>
+#include <PiiMatrix.h>
+
+#if defined(__APPLE__)
+#  include <OpenCL/cl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+/**
+ * The OpenCL backend of [PiiGpu]. All functions use a single device
+ * and an in-order command queue that are created on first use.
+ */
+namespace PiiOpenCl
+{
+  /**
+   * Device memory that mirrors the data of a matrix. The memory has
+   * the same stride as the matrix it is attached to.
+   */
+  class PiiOpenClBuffer : public PiiDeviceBuffer
+  {
+  public:
+    /**
+     * Takes the ownership of *memory*, which holds *rows* rows of
+     * *bytesPerRow* bytes, *stride* bytes apart.
+     */
+    PiiOpenClBuffer(cl_mem memory, std::size_t stride, std::size_t bytesPerRow) :
+      _memory(memory), _stride(stride), _bytesPerRow(bytesPerRow)
+    {}
+
+    cl_mem memory() const { return _memory; }
+    std::size_t stride() const { return _stride; }
+
+  protected:
+    ~PiiOpenClBuffer();
+    void download(void* host, std::size_t stride, int rows);
+
+  private:
+    cl_mem _memory;
+    std::size_t _stride, _bytesPerRow;
+  };
+
+  /**
+   * Returns `true` if a device was found and the kernels were built
+   * for it.
+   */
+  bool isAvailable();
+
+  /**
+   * Thresholds *image* on the device. Uses the device copy of *image*
+   * if it has one. The result stays on the device. Returns `false`
+   * if the device fails.
+   */
+  bool threshold(const PiiMatrix<uchar>& image, uchar level, PiiMatrix<uchar>& result);
+}
+
+#endif //_PIIOPENCL_H
@@ -10,6 +10,4 @@ qt {
   HEADERS += rawimage/*.h
   INCLUDEPATH += $$INTODIR/modules/camera/lib
   DEFINES += QT_STATICPLUGIN
-} else {
-  LIBS -= -lpiidsp
 }
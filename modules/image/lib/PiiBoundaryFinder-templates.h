@@ -18,6 +18,7 @@
 #endif
 
 #include <PiiMatrixUtil.h>
+#include "PiiLabeling.h"
 
 template <class T, class Matrix, class UnaryOp>
 QList<PiiMatrix<T> > PiiBoundaryFinder::findBoundaries(const Matrix& objects,
@@ -40,6 +41,111 @@ QList<PiiMatrix<T> > PiiBoundaryFinder::findBoundaries(const Matrix& objects,
   return result;
 }
 
+// Traces the objects in [firstLabel-1, endLabel-1). The runs of each
+// object are visited in reverse raster order, which is the order the
+// sequential scan meets their right ends.
+template <class T> struct PiiBoundaryFinder::BitTracer
+{
+  BitTracer(const PiiBitMatrix& objects,
+            const QVector<PiiImage::LabeledRun>& runs,
+            const QVector<int>& objectStarts,
+            const QVector<int>& objectRuns,
+            PiiMatrix<unsigned char>& boundaryMask,
+            PiiMatrix<T>* boundaries) :
+    objects(objects),
+    vecRuns(runs),
+    vecObjectStarts(objectStarts),
+    vecObjectRuns(objectRuns),
+    matBoundaryMask(boundaryMask),
+    pBoundaries(boundaries)
+  {}
+
+  void operator() (int firstObject, int endObject)
+  {
+    for (int i=vecObjectStarts[endObject]; i-- > vecObjectStarts[firstObject]; )
+      {
+        const int iRun = vecObjectRuns[i];
+        const PiiImage::LabeledRun& run = vecRuns[iRun];
+        if ((matBoundaryMask(run.row, run.end-1) & 1) == 0)
+          {
+            pBoundaries[iRun].resize(0,2);
+            pBoundaries[iRun].reserve(256);
+            traceBits(objects, matBoundaryMask, run.row, run.end-1, pBoundaries[iRun]);
+          }
+      }
+  }
+
+  const PiiBitMatrix& objects;
+  const QVector<PiiImage::LabeledRun>& vecRuns;
+  const QVector<int>& vecObjectStarts;
+  const QVector<int>& vecObjectRuns;
+  PiiMatrix<unsigned char>& matBoundaryMask;
+  PiiMatrix<T>* pBoundaries;
+};
+
+template <class T>
+QList<PiiMatrix<T> > PiiBoundaryFinder::findBoundaries(const PiiBitMatrix& objects,
+                                                       PiiMatrix<unsigned char>* boundaryMask,
+                                                       const PiiParallelPolicy& policy)
+{
+  PiiBoundaryFinder finder(objects.rows(), objects.columns(), boundaryMask);
+
+  QList<PiiMatrix<T> > result;
+  if (policy.threadCount() == 1)
+    {
+      for (;;)
+        {
+          PiiMatrix<T> boundary = finder.findNextBoundary<T>(objects);
+          if (boundary.isEmpty())
+            break;
+          result.push_back(boundary);
+        }
+      return result;
+    }
+
+  // The tracer moves to 8-connected neighbors, so each object must
+  // be 8-connected for its boundaries not to depend on other objects.
+  int iObjects = 0;
+  QVector<PiiImage::LabeledRun> vecRuns(PiiImage::labelRuns(objects, PiiImage::Connect8,
+                                                            &iObjects, policy));
+  // Group the run indices by object with a counting sort that keeps
+  // the raster order. The runs of object i (label i+1) will be at
+  // [vecObjectStarts[i], vecObjectStarts[i+1]).
+  QVector<int> vecObjectStarts(iObjects + 1), vecObjectRuns(vecRuns.size());
+  for (int i=0; i<vecRuns.size(); ++i)
+    ++vecObjectStarts[vecRuns[i].label-1];
+  for (int i=0, iStart=0; i<=iObjects; ++i)
+    {
+      const int iCount = vecObjectStarts[i];
+      vecObjectStarts[i] = iStart;
+      iStart += iCount;
+    }
+  {
+    QVector<int> vecPositions(vecObjectStarts);
+    for (int i=0; i<vecRuns.size(); ++i)
+      vecObjectRuns[vecPositions[vecRuns[i].label-1]++] = i;
+  }
+
+  // One boundary slot per run. A boundary that starts at the right
+  // end of a run is stored to its slot.
+  QVector<PiiMatrix<T> > vecBoundaries(vecRuns.size());
+  if (iObjects > 0)
+    {
+      // The threads write to distinct pixels of the mask, but it must
+      // not be shared with another matrix.
+      finder.d->pmatBoundaryMask->detach();
+      BitTracer<T> tracer(objects, vecRuns, vecObjectStarts, vecObjectRuns,
+                          *finder.d->pmatBoundaryMask, vecBoundaries.data());
+      Pii::forEachStrip(iObjects, tracer, policy);
+    }
+
+  for (int i=vecBoundaries.size(); i-- > 0; )
+    if (!vecBoundaries[i].isEmpty())
+      result.push_back(vecBoundaries[i]);
+
+  return result;
+}
+
 template <class T, class Matrix>
 PiiMatrix<T> PiiBoundaryFinder::findBoundary(const Matrix& objects, typename Matrix::value_type label,
                                              PiiMatrix<unsigned char>* boundaryMask)
@@ -267,3 +373,137 @@ int PiiBoundaryFinder::findBoundary(const Matrix& objects,
 
   return iPoints;
 }
+
+template <class T>
+PiiMatrix<T> PiiBoundaryFinder::findNextBoundary(const PiiBitMatrix& objects)
+{
+  findNextUnhandledPoint(objects);
+
+  if (d->iRow >= 0)
+    {
+      PiiMatrix<T> matResult(0,2);
+      matResult.reserve(256);
+      traceBits(objects, *d->pmatBoundaryMask, d->iRow, d->iRightEdge, matResult);
+      return matResult;
+    }
+
+  return PiiMatrix<T>(0,2);
+}
+
+template <class T>
+int PiiBoundaryFinder::findNextBoundary(const PiiBitMatrix& objects, PiiMatrix<T>& points)
+{
+  findNextUnhandledPoint(objects);
+
+  if (d->iRow >= 0)
+    return traceBits(objects, *d->pmatBoundaryMask, d->iRow, d->iRightEdge, points);
+
+  return 0;
+}
+
+template <class T>
+int PiiBoundaryFinder::findBoundary(const PiiBitMatrix& objects,
+                                    int startR, int startC,
+                                    PiiMatrix<T>& points)
+{
+  return traceBits(objects, *d->pmatBoundaryMask, startR, startC, points);
+}
+
+unsigned int PiiBoundaryFinder::rowNeighbors(const quint64* row, int words, int c)
+{
+  const int w = c >> 6, b = c & 63;
+  // c and c+1 to bits 1 and 2. Bits beyond the last column are zero.
+  unsigned int iBits = unsigned((row[w] >> b) << 1) & 6;
+  if (b != 0)
+    iBits |= unsigned(row[w] >> (b-1)) & 1;
+  else if (w > 0)
+    iBits |= unsigned(row[w-1] >> 63);
+  if (b == 63 && w+1 < words)
+    iBits |= unsigned(row[w+1] & 1) << 2;
+  return iBits;
+}
+
+unsigned int PiiBoundaryFinder::neighbors(const PiiBitMatrix& objects, int r, int c)
+{
+  const int iWords = objects.wordsPerRow();
+  const unsigned int iMiddle = rowNeighbors(objects.row(r), iWords, c);
+  const unsigned int iTop = r > 0 ? rowNeighbors(objects.row(r-1), iWords, c) : 0;
+  const unsigned int iBottom = r+1 < objects.rows() ? rowNeighbors(objects.row(r+1), iWords, c) : 0;
+  return
+    (iMiddle >> 2) |            // E
+    (iBottom >> 2 & 1) << 1 |   // SE
+    (iBottom >> 1 & 1) << 2 |   // S
+    (iBottom & 1) << 3 |        // SW
+    (iMiddle & 1) << 4 |        // W
+    (iTop & 1) << 5 |           // NW
+    (iTop >> 1 & 1) << 6 |      // N
+    (iTop >> 2) << 7;           // NE
+}
+
+template <class T>
+int PiiBoundaryFinder::traceBits(const PiiBitMatrix& objects,
+                                 PiiMatrix<unsigned char>& boundaryMask,
+                                 int startR, int startC,
+                                 PiiMatrix<T>& points)
+{
+  // Steps and double edge limits in the same order as in the
+  // directions table of the generic findBoundary().
+  static const int aSteps[8][3] = {
+    { 1,  0, 8}, //E
+    { 1,  1, 6}, //SE
+    { 0,  1, 4}, //S
+    {-1,  1, 4}, //SW
+    {-1,  0, 8}, //W
+    {-1, -1, 6}, //NW
+    { 0, -1, 4}, //N
+    { 1, -1, 4}  //NE
+  };
+  const unsigned char (*pTurns)[256] = turnTable();
+
+  int r = startR, c = startC;
+  int iPoints = 0;
+  int currentDir = 2;
+  int firstPossibleDir = (currentDir | 1) + 6;
+  do
+    {
+      const int turns = pTurns[(firstPossibleDir & 7) >> 1][neighbors(objects, r, c)];
+      // A single pixel has no neighbors.
+      if (turns == 8)
+        break;
+
+      points.appendRow(T(c), T(r));
+      ++iPoints;
+
+      // See findBoundary() for the marking rules.
+      unsigned char& mark = boundaryMask(r,c);
+      if (turns >= aSteps[currentDir][2])
+        {
+          if (mark == 0)
+            mark = 3;
+        }
+      else if (turns != 0 || (currentDir != 1 && currentDir != 5))
+        mark |= (currentDir >> 2) + 1;
+
+      currentDir = (firstPossibleDir + turns) & 0x7;
+      firstPossibleDir = (currentDir | 1) + 6;
+
+      c += aSteps[currentDir][0];
+      r += aSteps[currentDir][1];
+    }
+  while (r != startR || c != startC);
+
+  points.appendRow(T(startC), T(startR));
+  ++iPoints;
+
+  if (iPoints == 1)
+    boundaryMask(r,c) = 3;
+  else if (currentDir == 7)
+    {
+      int iFirstRow = points.rows() - iPoints;
+      if (points(iFirstRow+1,0) - points(iFirstRow,0) == 1 &&
+          points(iFirstRow+1,1) - points(iFirstRow,1) == 1)
+        boundaryMask(startR, startC) = 3;
+    }
+
+  return iPoints;
+}
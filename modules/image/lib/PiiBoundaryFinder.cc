@@ -43,3 +43,71 @@ PiiBoundaryFinder::~PiiBoundaryFinder()
 }
 
 PiiMatrix<unsigned char> PiiBoundaryFinder::boundaryMask() const { return d->matBoundaryMask; }
+
+namespace
+{
+  struct TurnTable
+  {
+    TurnTable()
+    {
+      for (int i=0; i<4; ++i)
+        {
+          const int iFirstDir = 2*i + 1;
+          for (int iNeighbors=0; iNeighbors<256; ++iNeighbors)
+            {
+              int iTurns = 0;
+              while (iTurns < 8 && !(iNeighbors & (1 << ((iFirstDir + iTurns) & 7))))
+                ++iTurns;
+              aTurns[i][iNeighbors] = (unsigned char)iTurns;
+            }
+        }
+    }
+
+    unsigned char aTurns[4][256];
+  } turnTableInstance;
+}
+
+const unsigned char (*PiiBoundaryFinder::turnTable())[256] { return turnTableInstance.aTurns; }
+
+void PiiBoundaryFinder::findNextUnhandledPoint(const PiiBitMatrix& objects)
+{
+  if (d->iColumn == -1)
+    {
+      d->iColumn = objects.columns()-1;
+      --d->iRow;
+    }
+  for ( ;d->iRow >= 0; --d->iRow, d->iColumn = objects.columns()-1)
+    {
+      const quint64* pWords = objects.row(d->iRow);
+      const unsigned char* maskRow = d->pmatBoundaryMask->row(d->iRow);
+
+      while (d->iColumn >= 0)
+        {
+          // Find right edge: the highest set bit at or before iColumn.
+          int w = d->iColumn >> 6;
+          quint64 iBits = pWords[w] & (~quint64(0) >> (63 - (d->iColumn & 63)));
+          while (iBits == 0)
+            {
+              // The beginning of the row was empty
+              if (--w < 0)
+                goto nextRow;
+              iBits = pWords[w];
+            }
+          d->iRightEdge = (w << 6) + Pii::highestBit(iBits);
+
+          // Find the left edge: the highest zero bit before the right edge.
+          quint64 iBackground = ~pWords[w] & ((quint64(1) << (d->iRightEdge & 63)) - 1);
+          while (iBackground == 0)
+            {
+              if (--w < 0)
+                break;
+              iBackground = ~pWords[w];
+            }
+          d->iColumn = w < 0 ? -1 : (w << 6) + Pii::highestBit(iBackground);
+
+          if ((maskRow[d->iRightEdge] & 1) == 0)
+            return;
+        }
+    nextRow:;
+    }
+}
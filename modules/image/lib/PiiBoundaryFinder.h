@@ -15,6 +15,8 @@
 
 #include "PiiImageGlobal.h"
 #include <PiiMatrix.h>
+#include <PiiBitMatrix.h>
+#include <PiiParallel.h>
 #include <QList>
 
 #ifndef _PIIBOUNDARYFINDER_H
@@ -28,6 +30,12 @@
  * a matrix in which each row stores the (x,y) coordinates of a pixel
  * on the boundary.
  *
+ * Bit-packed binary images ([PiiBitMatrix]) have overloads that take
+ * no decision rule. They treat set bits as objects and produce the
+ * same boundaries and boundary mask as the generic functions with a
+ * rule that accepts `true`, but find start points a word at a time
+ * and select the next boundary pixel from a lookup table indexed by
+ * the 8-neighborhood of the current pixel.
  */
 class PII_IMAGE_EXPORT PiiBoundaryFinder
 {
@@ -76,6 +84,22 @@ public:
   template <class Matrix, class UnaryOp, class T>
   int findNextBoundary(const Matrix& objects, UnaryOp rule, PiiMatrix<T>& points);
 
+  /**
+   * Finds the next unhandled boundary of the set bits in *objects*.
+   * Returns the coordinates of the boundary points, or an empty
+   * matrix if no more boundaries can be found.
+   */
+  template <class T>
+  PiiMatrix<T> findNextBoundary(const PiiBitMatrix& objects);
+
+  /**
+   * Finds the next unhandled boundary of the set bits in *objects*
+   * and appends its coordinates to *points*. Returns the number of
+   * boundary points, or zero if no more boundaries can be found.
+   */
+  template <class T>
+  int findNextBoundary(const PiiBitMatrix& objects, PiiMatrix<T>& points);
+
   /**
    * Returns the boundary mask. After each iteration
    * ([findNextBoundary()]), all detected boundaries are marked into
@@ -116,6 +140,17 @@ public:
                    int startR, int startC,
                    PiiMatrix<T>& points);
 
+  /**
+   * Extracts the boundary of an object in a bit-packed binary image
+   * starting at (*startR*, *startC*). Set bits are objects.
+   *
+   * @return the number of boundary points found
+   */
+  template <class T>
+  int findBoundary(const PiiBitMatrix& objects,
+                   int startR, int startC,
+                   PiiMatrix<T>& points);
+
   /**
    * A convenience function that returns the outer boundary of a
    * single labeled object.
@@ -181,6 +216,25 @@ public:
                                              UnaryOp rule,
                                              PiiMatrix<unsigned char>* boundaryMask = 0);
 
+  /**
+   * Extracts all outer and inner boundaries of the set bits in
+   * *objects*. The boundaries and the boundary mask are the same as
+   * those returned by the generic function with a rule that accepts
+   * `true`.
+   *
+   * If *policy* allows more than one thread, the image is first
+   * labeled into 8-connected objects with PiiImage::labelRuns(). The
+   * boundaries of an object only depend on its own pixels, so
+   * independent objects are traced concurrently. The right end of
+   * each run is a candidate start point, exactly like in the
+   * sequential scan. The boundaries are finally arranged to the scan
+   * order.
+   */
+  template <class T>
+  static QList<PiiMatrix<T> > findBoundaries(const PiiBitMatrix& objects,
+                                             PiiMatrix<unsigned char>* boundaryMask = 0,
+                                             const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
 private:
   /// @internal
   class Data
@@ -204,6 +258,31 @@ private:
   template <class Matrix, class UnaryOp>
   void findNextUnhandledPoint(const Matrix& objects,
                               UnaryOp rule);
+
+  /**
+   * Finds the last unprocessed right edge of a run of set bits. Empty
+   * words are skipped as a whole, and the edges of a run are located
+   * with bit scan instructions.
+   */
+  void findNextUnhandledPoint(const PiiBitMatrix& objects);
+
+  template <class T>
+  static int traceBits(const PiiBitMatrix& objects,
+                       PiiMatrix<unsigned char>& boundaryMask,
+                       int startR, int startC,
+                       PiiMatrix<T>& points);
+
+  // Pixels c-1, c and c+1 on row as bits 0, 1 and 2.
+  static inline unsigned int rowNeighbors(const quint64* row, int words, int c);
+  // The 8-neighborhood of (r,c). Bit i is set if the neighbor at
+  // direction i (0 = E, 1 = SE, ..., 7 = NE) is an object pixel.
+  static inline unsigned int neighbors(const PiiBitMatrix& objects, int r, int c);
+  // The number of clockwise turns to the next boundary pixel,
+  // indexed by the first possible direction (1, 3, 5, 7) / 2 and the
+  // 8-neighborhood. 8 means there are no neighbors.
+  static const unsigned char (*turnTable())[256];
+
+  template <class T> struct BitTracer;
 };
 
 #include "PiiBoundaryFinder-templates.h"
@@ -0,0 +1,1373 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiFilterKernels.h"
+
+#include <PiiCpu.h>
+#include <cstring>
+#include <vector>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_FILTER_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_FILTER_AVX2 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_FILTER_NEON 1
+#endif
+
+namespace PiiImage
+{
+  namespace
+  {
+    template <class U> struct Tap
+    {
+      int iRow, iColumn;
+      U weight;
+    };
+
+    /* Collects the non-zero coefficients of filter in row-major
+       order, which is the order in which PiiDsp::convolution()
+       accumulates the products. Zero coefficients don't contribute
+       to the result; the prebuilt edge detection masks consist of
+       zeros by a third.
+     */
+    template <class U> std::vector<Tap<U> > collectTaps(const PiiMatrix<U>& filter)
+    {
+      std::vector<Tap<U> > vecTaps;
+      for (int r=0; r<filter.rows(); ++r)
+        {
+          const U* pRow = filter[r];
+          for (int c=0; c<filter.columns(); ++c)
+            if (pRow[c] != 0)
+              {
+                Tap<U> tap = { r, c, pRow[c] };
+                vecTaps.push_back(tap);
+              }
+        }
+      return vecTaps;
+    }
+  }
+
+  /* The same correlation loop is compiled separately for each
+     instruction set. The loop must have the same target attribute as
+     the vector operations it uses; otherwise the compiler refuses to
+     inline them. Each output row is processed in blocks of two
+     vectors, then one vector, and the remaining columns with plain
+     scalar code. Accumulators stay in registers over all filter
+     coefficients.
+   */
+#define PII_FILTER_CORRELATE(TARGET)                                    \
+  template <class Ops, class T, class U, class R> TARGET                \
+  void correlate(const PiiMatrix<T>& image,                             \
+                 const std::vector<Tap<U> >& taps,                      \
+                 PiiMatrix<R>& result)                                  \
+  {                                                                     \
+    typedef typename Ops::Vec Vec;                                      \
+    const int iWidth = Ops::Width;                                      \
+    const int iRows = result.rows(), iCols = result.columns();          \
+    const int iTapCount = int(taps.size());                             \
+    std::vector<const T*> vecSources(iTapCount);                        \
+    for (int r=0; r<iRows; ++r)                                         \
+      {                                                                 \
+        for (int t=0; t<iTapCount; ++t)                                 \
+          vecSources[t] = image[r + taps[t].iRow] + taps[t].iColumn;    \
+        R* pTarget = result[r];                                         \
+        int c = 0;                                                      \
+        for (; c <= iCols - 2*iWidth; c += 2*iWidth)                    \
+          {                                                             \
+            Vec sum1 = Ops::zero(), sum2 = Ops::zero();                 \
+            for (int t=0; t<iTapCount; ++t)                             \
+              {                                                         \
+                const Vec weight = Ops::set1(taps[t].weight);           \
+                sum1 = Ops::add(sum1, Ops::mul(Ops::load(vecSources[t] + c), weight)); \
+                sum2 = Ops::add(sum2, Ops::mul(Ops::load(vecSources[t] + c + iWidth), weight)); \
+              }                                                         \
+            Ops::store(pTarget + c, sum1);                              \
+            Ops::store(pTarget + c + iWidth, sum2);                     \
+          }                                                             \
+        for (; c <= iCols - iWidth; c += iWidth)                        \
+          {                                                             \
+            Vec sum = Ops::zero();                                      \
+            for (int t=0; t<iTapCount; ++t)                             \
+              sum = Ops::add(sum, Ops::mul(Ops::load(vecSources[t] + c), \
+                                           Ops::set1(taps[t].weight))); \
+            Ops::store(pTarget + c, sum);                               \
+          }                                                             \
+        for (; c < iCols; ++c)                                          \
+          {                                                             \
+            R sum(0);                                                   \
+            for (int t=0; t<iTapCount; ++t)                             \
+              sum += R(vecSources[t][c]) * R(taps[t].weight);           \
+            pTarget[c] = sum;                                           \
+          }                                                             \
+      }                                                                 \
+  }
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    template <class R> struct Ops;
+
+    template <> struct Ops<int>
+    {
+      typedef __m128i Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return _mm_setzero_si128(); }
+      static inline Vec set1(int value) { return _mm_set1_epi32(value); }
+      static inline Vec load(const uchar* data)
+      {
+        int iBytes;
+        std::memcpy(&iBytes, data, 4);
+        const Vec zero = _mm_setzero_si128();
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(iBytes), zero), zero);
+      }
+      static inline Vec load(const ushort* data)
+      {
+        return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const Vec*>(data)), _mm_setzero_si128());
+      }
+      static inline Vec load(const int* data) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(data)); }
+      static inline Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+      // SSE2 has no 32-bit multiplication that keeps the low bits.
+      // Multiply even and odd lanes separately and interleave.
+      static inline Vec mul(Vec a, Vec b)
+      {
+        const Vec even = _mm_mul_epu32(a, b);
+        const Vec odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+      }
+      static inline void store(int* data, Vec value) { _mm_storeu_si128(reinterpret_cast<Vec*>(data), value); }
+    };
+
+    template <> struct Ops<float>
+    {
+      typedef __m128 Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return _mm_setzero_ps(); }
+      static inline Vec set1(float value) { return _mm_set1_ps(value); }
+      static inline Vec load(const uchar* data) { return _mm_cvtepi32_ps(Ops<int>::load(data)); }
+      static inline Vec load(const ushort* data) { return _mm_cvtepi32_ps(Ops<int>::load(data)); }
+      static inline Vec load(const float* data) { return _mm_loadu_ps(data); }
+      // See PiiHalf.cc for the conversion.
+      static inline Vec load(const PiiHalf* data)
+      {
+        const __m128i half = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)),
+                                                _mm_setzero_si128());
+        const __m128i expMant = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+        const __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, expMant), 16);
+        const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)),
+                                         _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+        const __m128i infNan = _mm_and_si128(_mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7bff)),
+                                             _mm_set1_epi32(255 << 23));
+        return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+      }
+      static inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+      static inline void store(float* data, Vec value) { _mm_storeu_ps(data, value); }
+    };
+
+    PII_FILTER_CORRELATE()
+  }
+#endif
+
+#ifdef PII_FILTER_AVX2
+  namespace Avx2
+  {
+    template <class R> struct Ops;
+
+#  define PII_AVX2 PII_TARGET("avx2")
+
+    template <> struct Ops<int>
+    {
+      typedef __m256i Vec;
+      enum { Width = 8 };
+
+      PII_AVX2 static inline Vec zero() { return _mm256_setzero_si256(); }
+      PII_AVX2 static inline Vec set1(int value) { return _mm256_set1_epi32(value); }
+      PII_AVX2 static inline Vec load(const uchar* data)
+      {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+      }
+      PII_AVX2 static inline Vec load(const ushort* data)
+      {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+      }
+      PII_AVX2 static inline Vec load(const int* data) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(data)); }
+      PII_AVX2 static inline Vec add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+      PII_AVX2 static inline Vec mul(Vec a, Vec b) { return _mm256_mullo_epi32(a, b); }
+      PII_AVX2 static inline void store(int* data, Vec value) { _mm256_storeu_si256(reinterpret_cast<Vec*>(data), value); }
+    };
+
+    template <> struct Ops<float>
+    {
+      typedef __m256 Vec;
+      enum { Width = 8 };
+
+      PII_AVX2 static inline Vec zero() { return _mm256_setzero_ps(); }
+      PII_AVX2 static inline Vec set1(float value) { return _mm256_set1_ps(value); }
+      PII_AVX2 static inline Vec load(const uchar* data) { return _mm256_cvtepi32_ps(Ops<int>::load(data)); }
+      PII_AVX2 static inline Vec load(const ushort* data) { return _mm256_cvtepi32_ps(Ops<int>::load(data)); }
+      PII_AVX2 static inline Vec load(const float* data) { return _mm256_loadu_ps(data); }
+      PII_AVX2 static inline Vec load(const PiiHalf* data)
+      {
+        const __m256i half = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+        const __m256i expMant = _mm256_and_si256(half, _mm256_set1_epi32(0x7fff));
+        const __m256i sign = _mm256_slli_epi32(_mm256_xor_si256(half, expMant), 16);
+        const __m256 scaled = _mm256_mul_ps(_mm256_castsi256_ps(_mm256_slli_epi32(expMant, 13)),
+                                            _mm256_castsi256_ps(_mm256_set1_epi32((254 - 15) << 23)));
+        const __m256i infNan = _mm256_and_si256(_mm256_cmpgt_epi32(expMant, _mm256_set1_epi32(0x7bff)),
+                                                _mm256_set1_epi32(255 << 23));
+        return _mm256_or_ps(scaled, _mm256_castsi256_ps(_mm256_or_si256(sign, infNan)));
+      }
+      PII_AVX2 static inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+      PII_AVX2 static inline Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+      PII_AVX2 static inline void store(float* data, Vec value) { _mm256_storeu_ps(data, value); }
+    };
+
+    PII_FILTER_CORRELATE(PII_AVX2)
+
+#  undef PII_AVX2
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    template <class R> struct Ops;
+
+    template <> struct Ops<int>
+    {
+      typedef int32x4_t Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return vdupq_n_s32(0); }
+      static inline Vec set1(int value) { return vdupq_n_s32(value); }
+      static inline Vec load(const uchar* data)
+      {
+        uint32_t uiBytes;
+        std::memcpy(&uiBytes, data, 4);
+        const uint16x8_t words = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(uiBytes)));
+        return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(words)));
+      }
+      static inline Vec load(const ushort* data) { return vreinterpretq_s32_u32(vmovl_u16(vld1_u16(data))); }
+      static inline Vec load(const int* data) { return vld1q_s32(data); }
+      static inline Vec add(Vec a, Vec b) { return vaddq_s32(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return vmulq_s32(a, b); }
+      static inline void store(int* data, Vec value) { vst1q_s32(data, value); }
+    };
+
+    template <> struct Ops<float>
+    {
+      typedef float32x4_t Vec;
+      enum { Width = 4 };
+
+      static inline Vec zero() { return vdupq_n_f32(0); }
+      static inline Vec set1(float value) { return vdupq_n_f32(value); }
+      static inline Vec load(const uchar* data) { return vcvtq_f32_s32(Ops<int>::load(data)); }
+      static inline Vec load(const ushort* data) { return vcvtq_f32_s32(Ops<int>::load(data)); }
+      static inline Vec load(const float* data) { return vld1q_f32(data); }
+      static inline Vec load(const PiiHalf* data)
+      {
+        const uint32x4_t half = vmovl_u16(vld1_u16(reinterpret_cast<const uint16_t*>(data)));
+        const uint32x4_t expMant = vandq_u32(half, vdupq_n_u32(0x7fff));
+        const uint32x4_t sign = vshlq_n_u32(veorq_u32(half, expMant), 16);
+        const float32x4_t scaled = vmulq_f32(vreinterpretq_f32_u32(vshlq_n_u32(expMant, 13)),
+                                             vreinterpretq_f32_u32(vdupq_n_u32((254 - 15) << 23)));
+        const uint32x4_t infNan = vandq_u32(vcgtq_u32(expMant, vdupq_n_u32(0x7bff)),
+                                            vdupq_n_u32(255 << 23));
+        return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(scaled), vorrq_u32(sign, infNan)));
+      }
+      static inline Vec add(Vec a, Vec b) { return vaddq_f32(a, b); }
+      static inline Vec mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+      static inline void store(float* data, Vec value) { vst1q_f32(data, value); }
+    };
+
+    PII_FILTER_CORRELATE()
+  }
+#endif
+
+#undef PII_FILTER_CORRELATE
+
+  namespace
+  {
+    bool isVectorized()
+    {
+#if defined(PII_FILTER_SSE2)
+      return Pii::hasCpuFeature(Pii::CpuSse2) || Pii::hasCpuFeature(Pii::CpuAvx2);
+#elif defined(PII_FILTER_NEON)
+      return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+      return false;
+#endif
+    }
+
+    template <class R, class T, class U>
+    bool correlateValid(const PiiMatrix<T>& image, const PiiMatrix<U>& filter, PiiMatrix<R>& result)
+    {
+      const int iRows = image.rows() - filter.rows() + 1,
+        iCols = image.columns() - filter.columns() + 1;
+      if (filter.rows() == 0 || filter.columns() == 0 ||
+          iRows <= 0 || iCols <= 0 ||
+          !isVectorized())
+        return false;
+
+      std::vector<Tap<U> > vecTaps(collectTaps(filter));
+      PiiMatrix<R> matResult(PiiMatrix<R>::uninitialized(iRows, iCols));
+
+#if defined(PII_FILTER_AVX2)
+      if (Pii::hasCpuFeature(Pii::CpuAvx2))
+        Avx2::correlate<Avx2::Ops<R> >(image, vecTaps, matResult);
+      else
+        Sse2::correlate<Sse2::Ops<R> >(image, vecTaps, matResult);
+#elif defined(PII_FILTER_SSE2)
+      Sse2::correlate<Sse2::Ops<R> >(image, vecTaps, matResult);
+#elif defined(PII_FILTER_NEON)
+      Neon::correlate<Neon::Ops<R> >(image, vecTaps, matResult);
+#endif
+      result = matResult;
+      return true;
+    }
+  }
+
+#define PII_DEFINE_FILTER_KERNEL(RESULT, INPUT, FILTER)                 \
+  bool FilterKernel<RESULT, INPUT, FILTER>::isSupported() { return isVectorized(); } \
+  bool FilterKernel<RESULT, INPUT, FILTER>::filter(const PiiMatrix<INPUT>& image, \
+                                                   const PiiMatrix<FILTER>& filter, \
+                                                   PiiMatrix<RESULT>& result) \
+  {                                                                     \
+    return correlateValid(image, filter, result);                       \
+  }
+
+  PII_DEFINE_FILTER_KERNEL(int, uchar, int)
+  PII_DEFINE_FILTER_KERNEL(int, ushort, int)
+  PII_DEFINE_FILTER_KERNEL(int, int, int)
+  PII_DEFINE_FILTER_KERNEL(float, uchar, float)
+  PII_DEFINE_FILTER_KERNEL(float, ushort, float)
+  PII_DEFINE_FILTER_KERNEL(float, float, float)
+  PII_DEFINE_FILTER_KERNEL(float, PiiHalf, float)
+
+#undef PII_DEFINE_FILTER_KERNEL
+
+  /* 2x downsampling. Each output row is produced from two
+     consecutive input rows. The vector loops consume 16 (uchar) or 8
+     (float) input columns at a time; the remaining columns are
+     handled with scalar code that sums in the same order.
+   */
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+  namespace
+  {
+    inline uchar halveScalar(const uchar* row1, const uchar* row2, int c)
+    {
+      return uchar(((int(row1[c]) + int(row1[c+1])) + (int(row2[c]) + int(row2[c+1]))) / 4);
+    }
+
+    inline float halveScalar(const float* row1, const float* row2, int c)
+    {
+      return ((row1[c] + row1[c+1]) + (row2[c] + row2[c+1])) / 4;
+    }
+
+    template <class T> void halveTail(const T* row1, const T* row2, T* target, int c, int columns)
+    {
+      for (; c<columns; ++c)
+        target[c] = halveScalar(row1, row2, c*2);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    void halve(const PiiMatrix<uchar>& image, PiiMatrix<uchar>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns();
+      const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+      for (int r=0; r<iRows; ++r)
+        {
+          const uchar* pRow1 = image[r*2], *pRow2 = image[r*2+1];
+          uchar* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 8; c += 8)
+            {
+              const __m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + c*2));
+              const __m128i row2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow2 + c*2));
+              // Vertical sums as 16-bit words, then horizontal pairs
+              // as 32-bit integers.
+              const __m128i low = _mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(row1, zero),
+                                                               _mm_unpacklo_epi8(row2, zero)), ones);
+              const __m128i high = _mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(row1, zero),
+                                                                _mm_unpackhi_epi8(row2, zero)), ones);
+              const __m128i words = _mm_packs_epi32(_mm_srli_epi32(low, 2), _mm_srli_epi32(high, 2));
+              _mm_storel_epi64(reinterpret_cast<__m128i*>(pTarget + c), _mm_packus_epi16(words, words));
+            }
+          halveTail(pRow1, pRow2, pTarget, c, iCols);
+        }
+    }
+
+    void halve(const PiiMatrix<float>& image, PiiMatrix<float>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns();
+      const __m128 quarter = _mm_set1_ps(0.25f);
+      for (int r=0; r<iRows; ++r)
+        {
+          const float* pRow1 = image[r*2], *pRow2 = image[r*2+1];
+          float* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 4; c += 4)
+            {
+              const __m128 a1 = _mm_loadu_ps(pRow1 + c*2), b1 = _mm_loadu_ps(pRow1 + c*2 + 4);
+              const __m128 a2 = _mm_loadu_ps(pRow2 + c*2), b2 = _mm_loadu_ps(pRow2 + c*2 + 4);
+              const __m128 sum1 = _mm_add_ps(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2,0,2,0)),
+                                             _mm_shuffle_ps(a1, b1, _MM_SHUFFLE(3,1,3,1)));
+              const __m128 sum2 = _mm_add_ps(_mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2,0,2,0)),
+                                             _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3,1,3,1)));
+              _mm_storeu_ps(pTarget + c, _mm_mul_ps(_mm_add_ps(sum1, sum2), quarter));
+            }
+          halveTail(pRow1, pRow2, pTarget, c, iCols);
+        }
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    void halve(const PiiMatrix<uchar>& image, PiiMatrix<uchar>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          const uchar* pRow1 = image[r*2], *pRow2 = image[r*2+1];
+          uchar* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 8; c += 8)
+            {
+              const uint16x8_t sum = vpadalq_u8(vpaddlq_u8(vld1q_u8(pRow1 + c*2)), vld1q_u8(pRow2 + c*2));
+              vst1_u8(pTarget + c, vshrn_n_u16(sum, 2));
+            }
+          halveTail(pRow1, pRow2, pTarget, c, iCols);
+        }
+    }
+
+    void halve(const PiiMatrix<float>& image, PiiMatrix<float>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          const float* pRow1 = image[r*2], *pRow2 = image[r*2+1];
+          float* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 4; c += 4)
+            {
+              // vld2q deinterleaves even and odd columns.
+              const float32x4x2_t row1 = vld2q_f32(pRow1 + c*2), row2 = vld2q_f32(pRow2 + c*2);
+              const float32x4_t sum = vaddq_f32(vaddq_f32(row1.val[0], row1.val[1]),
+                                                vaddq_f32(row2.val[0], row2.val[1]));
+              vst1q_f32(pTarget + c, vmulq_n_f32(sum, 0.25f));
+            }
+          halveTail(pRow1, pRow2, pTarget, c, iCols);
+        }
+    }
+  }
+#endif
+
+  namespace
+  {
+    template <class T> bool halveImage(const PiiMatrix<T>& image, PiiMatrix<T>& result)
+    {
+      if (result.rows() != image.rows()/2 || result.columns() != image.columns()/2 ||
+          !isVectorized())
+        return false;
+#if defined(PII_FILTER_SSE2)
+      Sse2::halve(image, result);
+#elif defined(PII_FILTER_NEON)
+      Neon::halve(image, result);
+#endif
+      return true;
+    }
+  }
+
+  bool HalvingKernel<uchar>::halve(const PiiMatrix<uchar>& image, PiiMatrix<uchar>& result)
+  {
+    return halveImage(image, result);
+  }
+
+  bool HalvingKernel<float>::halve(const PiiMatrix<float>& image, PiiMatrix<float>& result)
+  {
+    return halveImage(image, result);
+  }
+
+  /* Sobel gradients of one row. The rows have been extended by one
+     pixel on both sides, so column c of the result is centered at
+     column c+1 of the input rows. The scalar and vector versions
+     calculate in the same order, which makes the floating-point
+     results identical.
+   */
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+  namespace
+  {
+    template <class G> inline G absolute(G value) { return value < 0 ? -value : value; }
+
+    template <class T, class G> inline void sobelScalar(const T* row0, const T* row1, const T* row2, int c,
+                                                        G* gradientX, G* gradientY, G* magnitude)
+    {
+      const G x = (G(row0[c+2]) - G(row0[c])) + G(2) * (G(row1[c+2]) - G(row1[c])) + (G(row2[c+2]) - G(row2[c]));
+      const G y = (G(row2[c]) + G(2) * G(row2[c+1]) + G(row2[c+2])) - (G(row0[c]) + G(2) * G(row0[c+1]) + G(row0[c+2]));
+      gradientX[c] = x;
+      gradientY[c] = y;
+      magnitude[c] = absolute(x) + absolute(y);
+    }
+
+    template <class T, class G> void sobelTail(const T* row0, const T* row1, const T* row2, int c, int columns,
+                                               G* gradientX, G* gradientY, G* magnitude)
+    {
+      for (; c<columns; ++c)
+        sobelScalar(row0, row1, row2, c, gradientX, gradientY, magnitude);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    inline void storeWords(int* target, __m128i words)
+    {
+      // Sign-extend 16-bit words to 32 bits.
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target), _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 4), _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16));
+    }
+
+    inline __m128i absWords(__m128i words)
+    {
+      return _mm_max_epi16(words, _mm_sub_epi16(_mm_setzero_si128(), words));
+    }
+
+    void sobel(const uchar* row0, const uchar* row1, const uchar* row2, int columns,
+               int* gradientX, int* gradientY, int* magnitude)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      int c = 0;
+      // 8 pixels at a time. Neighbors at c and c+2 are loaded
+      // separately. The gradients fit into 16 bits.
+      for (; c <= columns - 8; c += 8)
+        {
+#define PII_LOAD_WORDS(ROW, OFFSET) _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ROW + c + OFFSET)), zero)
+          const __m128i a0 = PII_LOAD_WORDS(row0, 0), a1 = PII_LOAD_WORDS(row0, 1), a2 = PII_LOAD_WORDS(row0, 2);
+          const __m128i b0 = PII_LOAD_WORDS(row1, 0), b2 = PII_LOAD_WORDS(row1, 2);
+          const __m128i c0 = PII_LOAD_WORDS(row2, 0), c1 = PII_LOAD_WORDS(row2, 1), c2 = PII_LOAD_WORDS(row2, 2);
+#undef PII_LOAD_WORDS
+          const __m128i b = _mm_sub_epi16(b2, b0);
+          const __m128i x = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_add_epi16(b, b)),
+                                          _mm_sub_epi16(c2, c0));
+          const __m128i y = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(c0, _mm_add_epi16(c1, c1)), c2),
+                                          _mm_add_epi16(_mm_add_epi16(a0, _mm_add_epi16(a1, a1)), a2));
+          storeWords(gradientX + c, x);
+          storeWords(gradientY + c, y);
+          storeWords(magnitude + c, _mm_add_epi16(absWords(x), absWords(y)));
+        }
+      sobelTail(row0, row1, row2, c, columns, gradientX, gradientY, magnitude);
+    }
+
+    void sobel(const float* row0, const float* row1, const float* row2, int columns,
+               float* gradientX, float* gradientY, float* magnitude)
+    {
+      const __m128 two = _mm_set1_ps(2.0f), signMask = _mm_set1_ps(-0.0f);
+      int c = 0;
+      for (; c <= columns - 4; c += 4)
+        {
+          const __m128 a0 = _mm_loadu_ps(row0 + c), a1 = _mm_loadu_ps(row0 + c + 1), a2 = _mm_loadu_ps(row0 + c + 2);
+          const __m128 b0 = _mm_loadu_ps(row1 + c), b2 = _mm_loadu_ps(row1 + c + 2);
+          const __m128 c0 = _mm_loadu_ps(row2 + c), c1 = _mm_loadu_ps(row2 + c + 1), c2 = _mm_loadu_ps(row2 + c + 2);
+          const __m128 x = _mm_add_ps(_mm_add_ps(_mm_sub_ps(a2, a0), _mm_mul_ps(two, _mm_sub_ps(b2, b0))),
+                                      _mm_sub_ps(c2, c0));
+          const __m128 y = _mm_sub_ps(_mm_add_ps(_mm_add_ps(c0, _mm_mul_ps(two, c1)), c2),
+                                      _mm_add_ps(_mm_add_ps(a0, _mm_mul_ps(two, a1)), a2));
+          _mm_storeu_ps(gradientX + c, x);
+          _mm_storeu_ps(gradientY + c, y);
+          _mm_storeu_ps(magnitude + c, _mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)));
+        }
+      sobelTail(row0, row1, row2, c, columns, gradientX, gradientY, magnitude);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    inline void storeWords(int* target, int16x8_t words)
+    {
+      vst1q_s32(target, vmovl_s16(vget_low_s16(words)));
+      vst1q_s32(target + 4, vmovl_s16(vget_high_s16(words)));
+    }
+
+    void sobel(const uchar* row0, const uchar* row1, const uchar* row2, int columns,
+               int* gradientX, int* gradientY, int* magnitude)
+    {
+      int c = 0;
+      for (; c <= columns - 8; c += 8)
+        {
+#define PII_LOAD_WORDS(ROW, OFFSET) vreinterpretq_s16_u16(vmovl_u8(vld1_u8(ROW + c + OFFSET)))
+          const int16x8_t a0 = PII_LOAD_WORDS(row0, 0), a1 = PII_LOAD_WORDS(row0, 1), a2 = PII_LOAD_WORDS(row0, 2);
+          const int16x8_t b0 = PII_LOAD_WORDS(row1, 0), b2 = PII_LOAD_WORDS(row1, 2);
+          const int16x8_t c0 = PII_LOAD_WORDS(row2, 0), c1 = PII_LOAD_WORDS(row2, 1), c2 = PII_LOAD_WORDS(row2, 2);
+#undef PII_LOAD_WORDS
+          const int16x8_t b = vsubq_s16(b2, b0);
+          const int16x8_t x = vaddq_s16(vaddq_s16(vsubq_s16(a2, a0), vaddq_s16(b, b)), vsubq_s16(c2, c0));
+          const int16x8_t y = vsubq_s16(vaddq_s16(vaddq_s16(c0, vaddq_s16(c1, c1)), c2),
+                                        vaddq_s16(vaddq_s16(a0, vaddq_s16(a1, a1)), a2));
+          storeWords(gradientX + c, x);
+          storeWords(gradientY + c, y);
+          storeWords(magnitude + c, vaddq_s16(vabsq_s16(x), vabsq_s16(y)));
+        }
+      sobelTail(row0, row1, row2, c, columns, gradientX, gradientY, magnitude);
+    }
+
+    void sobel(const float* row0, const float* row1, const float* row2, int columns,
+               float* gradientX, float* gradientY, float* magnitude)
+    {
+      int c = 0;
+      for (; c <= columns - 4; c += 4)
+        {
+          const float32x4_t a0 = vld1q_f32(row0 + c), a1 = vld1q_f32(row0 + c + 1), a2 = vld1q_f32(row0 + c + 2);
+          const float32x4_t b0 = vld1q_f32(row1 + c), b2 = vld1q_f32(row1 + c + 2);
+          const float32x4_t c0 = vld1q_f32(row2 + c), c1 = vld1q_f32(row2 + c + 1), c2 = vld1q_f32(row2 + c + 2);
+          const float32x4_t x = vaddq_f32(vaddq_f32(vsubq_f32(a2, a0), vmulq_n_f32(vsubq_f32(b2, b0), 2.0f)),
+                                          vsubq_f32(c2, c0));
+          const float32x4_t y = vsubq_f32(vaddq_f32(vaddq_f32(c0, vmulq_n_f32(c1, 2.0f)), c2),
+                                          vaddq_f32(vaddq_f32(a0, vmulq_n_f32(a1, 2.0f)), a2));
+          vst1q_f32(gradientX + c, x);
+          vst1q_f32(gradientY + c, y);
+          vst1q_f32(magnitude + c, vaddq_f32(vabsq_f32(x), vabsq_f32(y)));
+        }
+      sobelTail(row0, row1, row2, c, columns, gradientX, gradientY, magnitude);
+    }
+  }
+#endif
+
+  namespace
+  {
+    template <class T, class G> bool sobelRow(const T* row0, const T* row1, const T* row2, int columns,
+                                              G* gradientX, G* gradientY, G* magnitude)
+    {
+      if (!isVectorized())
+        return false;
+#if defined(PII_FILTER_SSE2)
+      Sse2::sobel(row0, row1, row2, columns, gradientX, gradientY, magnitude);
+#elif defined(PII_FILTER_NEON)
+      Neon::sobel(row0, row1, row2, columns, gradientX, gradientY, magnitude);
+#else
+      Q_UNUSED(row0); Q_UNUSED(row1); Q_UNUSED(row2); Q_UNUSED(columns);
+      Q_UNUSED(gradientX); Q_UNUSED(gradientY); Q_UNUSED(magnitude);
+#endif
+      return true;
+    }
+  }
+
+  bool SobelKernel<uchar,int>::gradient(const uchar* row0, const uchar* row1, const uchar* row2, int columns,
+                                        int* gradientX, int* gradientY, int* magnitude)
+  {
+    return sobelRow(row0, row1, row2, columns, gradientX, gradientY, magnitude);
+  }
+
+  bool SobelKernel<float,float>::gradient(const float* row0, const float* row1, const float* row2, int columns,
+                                          float* gradientX, float* gradientY, float* magnitude)
+  {
+    return sobelRow(row0, row1, row2, columns, gradientX, gradientY, magnitude);
+  }
+
+  /* FAST-9 segment test. A pixel is a corner if nine contiguous
+     pixels on a circle of radius three are all brighter than the
+     center plus the threshold or all darker than the center minus the
+     threshold. The vector loops first check that two consecutive
+     compass points pass the test, which any corner must satisfy,
+     and then count the longest run of brighter and darker pixels
+     around the circle 16 centers at a time.
+   */
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+  namespace
+  {
+    const int aFastCircle[16][2] = { {0,3}, {1,3}, {2,2}, {3,1}, {3,0}, {3,-1}, {2,-2}, {1,-3},
+                                     {0,-3}, {-1,-3}, {-2,-2}, {-3,-1}, {-3,0}, {-3,1}, {-2,2}, {-1,3} };
+
+    void makeCircle(int stride, int* offsets)
+    {
+      for (int i=0; i<16; ++i)
+        offsets[i] = aFastCircle[i][0] + aFastCircle[i][1] * stride;
+    }
+
+    void fastSegmentTestTail(const uchar* row, const int* offsets, int c, int columns, int threshold,
+                             uchar* corners)
+    {
+      for (; c < columns - 3; ++c)
+        {
+          const uchar* p = row + c;
+          const int iUpper = *p + threshold, iLower = *p - threshold;
+          int iBright = 0, iDark = 0, iMaxRun = 0;
+          for (int k=0; k<25; ++k)
+            {
+              const int iValue = p[offsets[k & 15]];
+              iBright = iValue > iUpper ? iBright + 1 : 0;
+              iDark = iValue < iLower ? iDark + 1 : 0;
+              iMaxRun = qMax(iMaxRun, qMax(iBright, iDark));
+            }
+          corners[c] = iMaxRun >= 9 ? 1 : 0;
+        }
+    }
+
+    /* Differences between the center and the circle, repeated so
+       that each arc of nine can be loaded without wrapping around.
+       An arc is darker than the center by the minimum of its
+       differences and brighter by the negated maximum.
+     */
+    void collectDiffs(const uchar* center, const int* pixel, short* diffs)
+    {
+      for (int k=0; k<16; ++k)
+        diffs[k] = short(int(*center) - int(center[pixel[k]]));
+      for (int k=16; k<32; ++k)
+        diffs[k] = diffs[k-16];
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    void fastSegmentTest(const uchar* row, int stride, int columns, int threshold, uchar* corners)
+    {
+      int aiOffsets[16];
+      makeCircle(stride, aiOffsets);
+      // There is no unsigned byte comparison. Flipping the sign bits
+      // maps unsigned order to signed order.
+      const __m128i sign = _mm_set1_epi8(char(0x80)), limit = _mm_set1_epi8(char(threshold)),
+        eight = _mm_set1_epi8(8), one = _mm_set1_epi8(1);
+#define PII_LOAD_CIRCLE(INDEX) _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + aiOffsets[INDEX])), sign)
+      int c = 3;
+      for (; c <= columns - 19; c += 16)
+        {
+          const uchar* p = row + c;
+          const __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+          // Saturation doesn't change the result: nothing is brighter
+          // than 255 or darker than 0.
+          const __m128i upper = _mm_xor_si128(_mm_adds_epu8(center, limit), sign),
+            lower = _mm_xor_si128(_mm_subs_epu8(center, limit), sign);
+
+          const __m128i a0 = PII_LOAD_CIRCLE(0), a4 = PII_LOAD_CIRCLE(4),
+            a8 = PII_LOAD_CIRCLE(8), a12 = PII_LOAD_CIRCLE(12);
+          const __m128i b0 = _mm_cmpgt_epi8(a0, upper), b4 = _mm_cmpgt_epi8(a4, upper),
+            b8 = _mm_cmpgt_epi8(a8, upper), b12 = _mm_cmpgt_epi8(a12, upper);
+          const __m128i d0 = _mm_cmpgt_epi8(lower, a0), d4 = _mm_cmpgt_epi8(lower, a4),
+            d8 = _mm_cmpgt_epi8(lower, a8), d12 = _mm_cmpgt_epi8(lower, a12);
+          const __m128i candidates =
+            _mm_or_si128(_mm_or_si128(_mm_or_si128(_mm_and_si128(b0, b4), _mm_and_si128(b4, b8)),
+                                      _mm_or_si128(_mm_and_si128(b8, b12), _mm_and_si128(b12, b0))),
+                         _mm_or_si128(_mm_or_si128(_mm_and_si128(d0, d4), _mm_and_si128(d4, d8)),
+                                      _mm_or_si128(_mm_and_si128(d8, d12), _mm_and_si128(d12, d0))));
+          if (_mm_movemask_epi8(candidates) == 0)
+            {
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(corners + c), _mm_setzero_si128());
+              continue;
+            }
+
+          __m128i aCircle[16];
+          for (int k=0; k<16; ++k)
+            aCircle[k] = PII_LOAD_CIRCLE(k);
+          // Run lengths are incremented by subtracting the all-ones
+          // mask and reset by masking.
+          __m128i bright = _mm_setzero_si128(), dark = _mm_setzero_si128(), maxRun = _mm_setzero_si128();
+          for (int k=0; k<25; ++k)
+            {
+              const __m128i brighter = _mm_cmpgt_epi8(aCircle[k & 15], upper),
+                darker = _mm_cmpgt_epi8(lower, aCircle[k & 15]);
+              bright = _mm_and_si128(_mm_sub_epi8(bright, brighter), brighter);
+              dark = _mm_and_si128(_mm_sub_epi8(dark, darker), darker);
+              maxRun = _mm_max_epu8(maxRun, _mm_max_epu8(bright, dark));
+            }
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(corners + c),
+                           _mm_and_si128(_mm_cmpgt_epi8(maxRun, eight), one));
+        }
+#undef PII_LOAD_CIRCLE
+      fastSegmentTestTail(row, aiOffsets, c, columns, threshold, corners);
+    }
+
+    int fastScore(const uchar* center, const int* pixel)
+    {
+      short aDiffs[32];
+      collectDiffs(center, pixel, aDiffs);
+      __m128i maxDark = _mm_set1_epi16(-1000), minBright = _mm_set1_epi16(1000);
+      for (int k=0; k<16; k += 8)
+        {
+#define PII_LOAD_DIFFS(OFFSET) _mm_loadu_si128(reinterpret_cast<const __m128i*>(aDiffs + k + OFFSET))
+          // Extremes of the eight differences shared by two arcs
+          __m128i minimum = PII_LOAD_DIFFS(1), maximum = minimum;
+          for (int i=2; i<9; ++i)
+            {
+              const __m128i diffs = PII_LOAD_DIFFS(i);
+              minimum = _mm_min_epi16(minimum, diffs);
+              maximum = _mm_max_epi16(maximum, diffs);
+            }
+          __m128i diffs = PII_LOAD_DIFFS(0);
+          maxDark = _mm_max_epi16(maxDark, _mm_min_epi16(minimum, diffs));
+          minBright = _mm_min_epi16(minBright, _mm_max_epi16(maximum, diffs));
+          diffs = PII_LOAD_DIFFS(9);
+          maxDark = _mm_max_epi16(maxDark, _mm_min_epi16(minimum, diffs));
+          minBright = _mm_min_epi16(minBright, _mm_max_epi16(maximum, diffs));
+#undef PII_LOAD_DIFFS
+        }
+      __m128i best = _mm_max_epi16(maxDark, _mm_sub_epi16(_mm_setzero_si128(), minBright));
+      best = _mm_max_epi16(best, _mm_srli_si128(best, 8));
+      best = _mm_max_epi16(best, _mm_srli_si128(best, 4));
+      best = _mm_max_epi16(best, _mm_srli_si128(best, 2));
+      return short(_mm_cvtsi128_si32(best)) - 1;
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    void fastSegmentTest(const uchar* row, int stride, int columns, int threshold, uchar* corners)
+    {
+      int aiOffsets[16];
+      makeCircle(stride, aiOffsets);
+      const uint8x16_t limit = vdupq_n_u8(uchar(threshold)), eight = vdupq_n_u8(8), one = vdupq_n_u8(1);
+      int c = 3;
+      for (; c <= columns - 19; c += 16)
+        {
+          const uchar* p = row + c;
+          const uint8x16_t center = vld1q_u8(p);
+          const uint8x16_t upper = vqaddq_u8(center, limit), lower = vqsubq_u8(center, limit);
+
+          const uint8x16_t a0 = vld1q_u8(p + aiOffsets[0]), a4 = vld1q_u8(p + aiOffsets[4]),
+            a8 = vld1q_u8(p + aiOffsets[8]), a12 = vld1q_u8(p + aiOffsets[12]);
+          const uint8x16_t b0 = vcgtq_u8(a0, upper), b4 = vcgtq_u8(a4, upper),
+            b8 = vcgtq_u8(a8, upper), b12 = vcgtq_u8(a12, upper);
+          const uint8x16_t d0 = vcltq_u8(a0, lower), d4 = vcltq_u8(a4, lower),
+            d8 = vcltq_u8(a8, lower), d12 = vcltq_u8(a12, lower);
+          const uint8x16_t candidates =
+            vorrq_u8(vorrq_u8(vorrq_u8(vandq_u8(b0, b4), vandq_u8(b4, b8)),
+                              vorrq_u8(vandq_u8(b8, b12), vandq_u8(b12, b0))),
+                     vorrq_u8(vorrq_u8(vandq_u8(d0, d4), vandq_u8(d4, d8)),
+                              vorrq_u8(vandq_u8(d8, d12), vandq_u8(d12, d0))));
+          const uint64x2_t candidates64 = vreinterpretq_u64_u8(candidates);
+          if ((vgetq_lane_u64(candidates64, 0) | vgetq_lane_u64(candidates64, 1)) == 0)
+            {
+              vst1q_u8(corners + c, vdupq_n_u8(0));
+              continue;
+            }
+
+          uint8x16_t aCircle[16];
+          for (int k=0; k<16; ++k)
+            aCircle[k] = vld1q_u8(p + aiOffsets[k]);
+          uint8x16_t bright = vdupq_n_u8(0), dark = vdupq_n_u8(0), maxRun = vdupq_n_u8(0);
+          for (int k=0; k<25; ++k)
+            {
+              const uint8x16_t brighter = vcgtq_u8(aCircle[k & 15], upper),
+                darker = vcltq_u8(aCircle[k & 15], lower);
+              bright = vandq_u8(vsubq_u8(bright, brighter), brighter);
+              dark = vandq_u8(vsubq_u8(dark, darker), darker);
+              maxRun = vmaxq_u8(maxRun, vmaxq_u8(bright, dark));
+            }
+          vst1q_u8(corners + c, vandq_u8(vcgtq_u8(maxRun, eight), one));
+        }
+      fastSegmentTestTail(row, aiOffsets, c, columns, threshold, corners);
+    }
+
+    int fastScore(const uchar* center, const int* pixel)
+    {
+      short aDiffs[32];
+      collectDiffs(center, pixel, aDiffs);
+      int16x8_t maxDark = vdupq_n_s16(-1000), minBright = vdupq_n_s16(1000);
+      for (int k=0; k<16; k += 8)
+        {
+          int16x8_t minimum = vld1q_s16(aDiffs + k + 1), maximum = minimum;
+          for (int i=2; i<9; ++i)
+            {
+              const int16x8_t diffs = vld1q_s16(aDiffs + k + i);
+              minimum = vminq_s16(minimum, diffs);
+              maximum = vmaxq_s16(maximum, diffs);
+            }
+          int16x8_t diffs = vld1q_s16(aDiffs + k);
+          maxDark = vmaxq_s16(maxDark, vminq_s16(minimum, diffs));
+          minBright = vminq_s16(minBright, vmaxq_s16(maximum, diffs));
+          diffs = vld1q_s16(aDiffs + k + 9);
+          maxDark = vmaxq_s16(maxDark, vminq_s16(minimum, diffs));
+          minBright = vminq_s16(minBright, vmaxq_s16(maximum, diffs));
+        }
+      const int16x8_t best = vmaxq_s16(maxDark, vnegq_s16(minBright));
+      int16x4_t half = vpmax_s16(vget_low_s16(best), vget_high_s16(best));
+      half = vpmax_s16(half, half);
+      half = vpmax_s16(half, half);
+      return vget_lane_s16(half, 0) - 1;
+    }
+  }
+#endif
+
+  bool FastCornerKernel<uchar>::isSupported() { return isVectorized(); }
+
+  int FastCornerKernel<uchar>::score(const uchar* center, const int* pixel)
+  {
+#if defined(PII_FILTER_SSE2)
+    return Sse2::fastScore(center, pixel);
+#elif defined(PII_FILTER_NEON)
+    return Neon::fastScore(center, pixel);
+#else
+    Q_UNUSED(center); Q_UNUSED(pixel);
+    return 0;
+#endif
+  }
+
+  bool FastCornerKernel<uchar>::segmentTest(const uchar* row, int stride, int columns, int threshold,
+                                            uchar* corners)
+  {
+    if (!isVectorized())
+      return false;
+#if defined(PII_FILTER_SSE2)
+    Sse2::fastSegmentTest(row, stride, columns, threshold, corners);
+#elif defined(PII_FILTER_NEON)
+    Neon::fastSegmentTest(row, stride, columns, threshold, corners);
+#else
+    Q_UNUSED(row); Q_UNUSED(stride); Q_UNUSED(columns); Q_UNUSED(threshold); Q_UNUSED(corners);
+#endif
+    return true;
+  }
+
+  /* Block sums. Each block is summed separately with a vector loop
+     over 16 bytes at a time and scalar code for the rest. The sums
+     are integers and therefore identical to scalar summation.
+   */
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+  namespace
+  {
+    inline unsigned int sumBytesTail(const uchar* data, int c, int count)
+    {
+      unsigned int iSum = 0;
+      for (; c<count; ++c)
+        iSum += data[c];
+      return iSum;
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    unsigned int sumBytes(const uchar* data, int count)
+    {
+      // SAD against zero sums eight bytes into each 64-bit half.
+      const __m128i zero = _mm_setzero_si128();
+      __m128i sum = zero;
+      int c = 0;
+      for (; c <= count - 16; c += 16)
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + c)), zero));
+      sum = _mm_add_epi64(sum, _mm_srli_si128(sum, 8));
+      return static_cast<unsigned int>(_mm_cvtsi128_si32(sum)) + sumBytesTail(data, c, count);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    unsigned int sumBytes(const uchar* data, int count)
+    {
+      uint32x4_t sum = vdupq_n_u32(0);
+      int c = 0;
+      while (c <= count - 16)
+        {
+          // 16-bit lanes can take 128 pairwise byte sums without
+          // overflow.
+          uint16x8_t partial = vdupq_n_u16(0);
+          for (int i=0; i<128 && c <= count - 16; ++i, c += 16)
+            partial = vpadalq_u8(partial, vld1q_u8(data + c));
+          sum = vpadalq_u16(sum, partial);
+        }
+      const uint64x2_t total = vpaddlq_u32(sum);
+      return static_cast<unsigned int>(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1)) +
+        sumBytesTail(data, c, count);
+    }
+  }
+#endif
+
+  bool BlockSumKernel<uchar>::sumRow(const uchar* row, const int* blockEnds, int blocks, unsigned int* sums)
+  {
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+    if (!isVectorized())
+      return false;
+    int iStart = 0;
+    for (int b=0; b<blocks; ++b)
+      {
+#  if defined(PII_FILTER_SSE2)
+        sums[b] += Sse2::sumBytes(row + iStart, blockEnds[b] - iStart);
+#  else
+        sums[b] += Neon::sumBytes(row + iStart, blockEnds[b] - iStart);
+#  endif
+        iStart = blockEnds[b];
+      }
+    return true;
+#else
+    Q_UNUSED(row); Q_UNUSED(blockEnds); Q_UNUSED(blocks); Q_UNUSED(sums);
+    return false;
+#endif
+  }
+
+  /* Table-driven bilinear sampling. The vector loops handle four
+     output pixels at a time. The two horizontally adjacent pixels on
+     both source rows are gathered into one 32-bit word per output
+     pixel, widened to 16 bits and multiplied by the weights with a
+     single multiply-add. Blocks that contain pixels outside of the
+     source image are handled with scalar code, which rounds the same
+     way.
+   */
+  namespace
+  {
+    inline uchar remapScalar(const uchar* pixel, int stepX, int stepY, const short* weights)
+    {
+      return uchar((int(pixel[0]) * weights[0] + int(pixel[stepX]) * weights[1] +
+                    int(pixel[stepY]) * weights[2] + int(pixel[stepY + stepX]) * weights[3] +
+                    (1 << (RemapWeightBits-1))) >> RemapWeightBits);
+    }
+
+    void remapTail(const PiiMatrix<uchar>& image, int stepX, int stepY,
+                   const int* coordinates, const short* weights, uchar background,
+                   uchar* target, int c, int columns)
+    {
+      for (; c<columns; ++c)
+        {
+          const int iX = coordinates[c*2];
+          if (iX < 0)
+            target[c] = background;
+          else
+            target[c] = remapScalar(image[coordinates[c*2+1]] + iX, stepX, stepY, weights + c*4);
+        }
+    }
+
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+    // Returns the pixels at (x,y), (x+1,y), (x,y+1) and (x+1,y+1) in
+    // memory order.
+    inline quint32 loadQuad(const uchar* pixel, int stride)
+    {
+      quint16 iTop, iBottom;
+      std::memcpy(&iTop, pixel, 2);
+      std::memcpy(&iBottom, pixel + stride, 2);
+      return quint32(iTop) | (quint32(iBottom) << 16);
+    }
+
+    inline bool gatherQuads(const PiiMatrix<uchar>& image, int stride,
+                            const int* coordinates, quint32* quads)
+    {
+      if ((coordinates[0] | coordinates[2] | coordinates[4] | coordinates[6]) < 0)
+        return false;
+      for (int i=0; i<4; ++i)
+        quads[i] = loadQuad(image[coordinates[i*2+1]] + coordinates[i*2], stride);
+      return true;
+    }
+#endif
+  }
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    void remap(const PiiMatrix<uchar>& image, const PiiMatrix<int>& coordinates,
+               const PiiMatrix<short>& weights, uchar background, PiiMatrix<uchar>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns(), iStride = image.stride();
+      const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi32(1 << (RemapWeightBits-1));
+      quint32 aQuads[4];
+      for (int r=0; r<iRows; ++r)
+        {
+          const int* pCoordinates = coordinates[r];
+          const short* pWeights = weights[r];
+          uchar* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 4; c += 4)
+            {
+              if (!gatherQuads(image, iStride, pCoordinates + c*2, aQuads))
+                {
+                  remapTail(image, 1, iStride, pCoordinates, pWeights, background, pTarget, c, c+4);
+                  continue;
+                }
+              const __m128i quads = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aQuads));
+              // Top and bottom sums of two pixels in each register.
+              const __m128 sums1 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(quads, zero),
+                                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(pWeights + c*4))));
+              const __m128 sums2 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(quads, zero),
+                                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(pWeights + c*4 + 8))));
+              const __m128i sums = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(sums1, sums2, _MM_SHUFFLE(2,0,2,0))),
+                                                 _mm_castps_si128(_mm_shuffle_ps(sums1, sums2, _MM_SHUFFLE(3,1,3,1))));
+              const __m128i words = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(sums, half), RemapWeightBits), zero);
+              const int iPixels = _mm_cvtsi128_si32(_mm_packus_epi16(words, zero));
+              std::memcpy(pTarget + c, &iPixels, 4);
+            }
+          remapTail(image, 1, iStride, pCoordinates, pWeights, background, pTarget, c, iCols);
+        }
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    inline int32x4_t pairwiseSums(int32x4_t a, int32x4_t b)
+    {
+      return vcombine_s32(vpadd_s32(vget_low_s32(a), vget_high_s32(a)),
+                          vpadd_s32(vget_low_s32(b), vget_high_s32(b)));
+    }
+
+    void remap(const PiiMatrix<uchar>& image, const PiiMatrix<int>& coordinates,
+               const PiiMatrix<short>& weights, uchar background, PiiMatrix<uchar>& result)
+    {
+      const int iRows = result.rows(), iCols = result.columns(), iStride = image.stride();
+      quint32 aQuads[4];
+      for (int r=0; r<iRows; ++r)
+        {
+          const int* pCoordinates = coordinates[r];
+          const short* pWeights = weights[r];
+          uchar* pTarget = result[r];
+          int c = 0;
+          for (; c <= iCols - 4; c += 4)
+            {
+              if (!gatherQuads(image, iStride, pCoordinates + c*2, aQuads))
+                {
+                  remapTail(image, 1, iStride, pCoordinates, pWeights, background, pTarget, c, c+4);
+                  continue;
+                }
+              const uint8x16_t quads = vreinterpretq_u8_u32(vld1q_u32(aQuads));
+              const int16x8_t pixels1 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(quads)));
+              const int16x8_t pixels2 = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(quads)));
+              const int16x8_t weights1 = vld1q_s16(pWeights + c*4), weights2 = vld1q_s16(pWeights + c*4 + 8);
+              const int32x4_t sums = pairwiseSums(pairwiseSums(vmull_s16(vget_low_s16(pixels1), vget_low_s16(weights1)),
+                                                               vmull_s16(vget_high_s16(pixels1), vget_high_s16(weights1))),
+                                                  pairwiseSums(vmull_s16(vget_low_s16(pixels2), vget_low_s16(weights2)),
+                                                               vmull_s16(vget_high_s16(pixels2), vget_high_s16(weights2))));
+              const uint16x4_t words = vqmovun_s32(vrshrq_n_s32(sums, RemapWeightBits));
+              const quint32 iPixels = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(words, words))), 0);
+              std::memcpy(pTarget + c, &iPixels, 4);
+            }
+          remapTail(image, 1, iStride, pCoordinates, pWeights, background, pTarget, c, iCols);
+        }
+    }
+  }
+#endif
+
+  bool RemapKernel<uchar>::remap(const PiiMatrix<uchar>& image,
+                                 const PiiMatrix<int>& coordinates,
+                                 const PiiMatrix<short>& weights,
+                                 uchar background,
+                                 PiiMatrix<uchar>& result)
+  {
+    // Single-pixel rows and columns are sampled with zero steps. The
+    // vector loops always read two columns and two rows.
+    const int iStepX = image.columns() > 1 ? 1 : 0, iStepY = image.rows() > 1 ? image.stride() : 0;
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+    if (iStepX != 0 && iStepY != 0 && isVectorized())
+      {
+#  if defined(PII_FILTER_SSE2)
+        Sse2::remap(image, coordinates, weights, background, result);
+#  else
+        Neon::remap(image, coordinates, weights, background, result);
+#  endif
+        return true;
+      }
+#endif
+    for (int r=0; r<result.rows(); ++r)
+      remapTail(image, iStepX, iStepY, coordinates[r], weights[r], background, result[r], 0, result.columns());
+    return true;
+  }
+
+  /* Vertical pass of separable resampling. Each result is a weighted
+     sum of the same element on all rows. The vector loops handle 16
+     (uchar) or 8 (ushort, float) elements at a time; the rest is
+     handled with scalar code that sums in the same order. Integers
+     are clamped, and one half is added before truncation.
+   */
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+  namespace
+  {
+    inline float combineScalar(const float* const* rows, const float* weights, int taps, int i)
+    {
+      float fSum = 0;
+      for (int k=0; k<taps; ++k)
+        fSum += rows[k][i] * weights[k];
+      return fSum;
+    }
+
+    inline void storeCombined(float value, float* result) { *result = value; }
+    inline void storeCombined(float value, uchar* result) { *result = uchar(qBound(0.0f, value, 255.0f) + 0.5f); }
+    inline void storeCombined(float value, ushort* result) { *result = ushort(qBound(0.0f, value, 65535.0f) + 0.5f); }
+
+    template <class T> void combineTail(const float* const* rows, const float* weights, int taps,
+                                        int i, int count, T* result)
+    {
+      for (; i<count; ++i)
+        storeCombined(combineScalar(rows, weights, taps, i), result + i);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_SSE2
+  namespace Sse2
+  {
+    inline __m128 combine(const float* const* rows, const float* weights, int taps, int i)
+    {
+      __m128 sum = _mm_setzero_ps();
+      for (int k=0; k<taps; ++k)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+      return sum;
+    }
+
+    inline __m128i roundClamped(__m128 value, __m128 maximum)
+    {
+      return _mm_cvttps_epi32(_mm_add_ps(_mm_max_ps(_mm_min_ps(value, maximum), _mm_setzero_ps()),
+                                         _mm_set1_ps(0.5f)));
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, float* result)
+    {
+      int i = 0;
+      for (; i <= count - 8; i += 8)
+        {
+          _mm_storeu_ps(result + i, combine(rows, weights, taps, i));
+          _mm_storeu_ps(result + i + 4, combine(rows, weights, taps, i + 4));
+        }
+      combineTail(rows, weights, taps, i, count, result);
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, uchar* result)
+    {
+      const __m128 maximum = _mm_set1_ps(255.0f);
+      int i = 0;
+      for (; i <= count - 16; i += 16)
+        {
+          const __m128i low = _mm_packs_epi32(roundClamped(combine(rows, weights, taps, i), maximum),
+                                              roundClamped(combine(rows, weights, taps, i + 4), maximum));
+          const __m128i high = _mm_packs_epi32(roundClamped(combine(rows, weights, taps, i + 8), maximum),
+                                               roundClamped(combine(rows, weights, taps, i + 12), maximum));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), _mm_packus_epi16(low, high));
+        }
+      combineTail(rows, weights, taps, i, count, result);
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, ushort* result)
+    {
+      // There is no unsigned 32-to-16 bit pack in SSE2. Shifting by
+      // 32768 maps the values to the signed range and back.
+      const __m128 maximum = _mm_set1_ps(65535.0f);
+      const __m128i offset = _mm_set1_epi32(32768), sign = _mm_set1_epi16(short(0x8000));
+      int i = 0;
+      for (; i <= count - 8; i += 8)
+        {
+          const __m128i low = _mm_sub_epi32(roundClamped(combine(rows, weights, taps, i), maximum), offset);
+          const __m128i high = _mm_sub_epi32(roundClamped(combine(rows, weights, taps, i + 4), maximum), offset);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i),
+                           _mm_xor_si128(_mm_packs_epi32(low, high), sign));
+        }
+      combineTail(rows, weights, taps, i, count, result);
+    }
+  }
+#endif
+
+#ifdef PII_FILTER_NEON
+  namespace Neon
+  {
+    inline float32x4_t combine(const float* const* rows, const float* weights, int taps, int i)
+    {
+      // Multiplication and addition are kept separate, as in the
+      // scalar code.
+      float32x4_t sum = vdupq_n_f32(0);
+      for (int k=0; k<taps; ++k)
+        sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(rows[k] + i), weights[k]));
+      return sum;
+    }
+
+    inline uint32x4_t roundClamped(float32x4_t value, float maximum)
+    {
+      return vcvtq_u32_f32(vaddq_f32(vmaxq_f32(vminq_f32(value, vdupq_n_f32(maximum)), vdupq_n_f32(0)),
+                                     vdupq_n_f32(0.5f)));
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, float* result)
+    {
+      int i = 0;
+      for (; i <= count - 8; i += 8)
+        {
+          vst1q_f32(result + i, combine(rows, weights, taps, i));
+          vst1q_f32(result + i + 4, combine(rows, weights, taps, i + 4));
+        }
+      combineTail(rows, weights, taps, i, count, result);
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, uchar* result)
+    {
+      int i = 0;
+      for (; i <= count - 16; i += 16)
+        {
+          const uint16x8_t low = vcombine_u16(vmovn_u32(roundClamped(combine(rows, weights, taps, i), 255.0f)),
+                                              vmovn_u32(roundClamped(combine(rows, weights, taps, i + 4), 255.0f)));
+          const uint16x8_t high = vcombine_u16(vmovn_u32(roundClamped(combine(rows, weights, taps, i + 8), 255.0f)),
+                                               vmovn_u32(roundClamped(combine(rows, weights, taps, i + 12), 255.0f)));
+          vst1q_u8(result + i, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+      combineTail(rows, weights, taps, i, count, result);
+    }
+
+    void combineRows(const float* const* rows, const float* weights, int taps, int count, ushort* result)
+    {
+      int i = 0;
+      for (; i <= count - 8; i += 8)
+        vst1q_u16(result + i, vcombine_u16(vmovn_u32(roundClamped(combine(rows, weights, taps, i), 65535.0f)),
+                                           vmovn_u32(roundClamped(combine(rows, weights, taps, i + 4), 65535.0f))));
+      combineTail(rows, weights, taps, i, count, result);
+    }
+  }
+#endif
+
+  namespace
+  {
+    template <class T> bool combineResampledRows(const float* const* rows, const float* weights,
+                                                 int taps, int count, T* result)
+    {
+#if defined(PII_FILTER_SSE2) || defined(PII_FILTER_NEON)
+      if (!isVectorized())
+        return false;
+#  if defined(PII_FILTER_SSE2)
+      Sse2::combineRows(rows, weights, taps, count, result);
+#  else
+      Neon::combineRows(rows, weights, taps, count, result);
+#  endif
+      return true;
+#else
+      Q_UNUSED(rows); Q_UNUSED(weights); Q_UNUSED(taps); Q_UNUSED(count); Q_UNUSED(result);
+      return false;
+#endif
+    }
+  }
+
+#define PII_DEFINE_RESAMPLE_KERNEL(TYPE)                                \
+  bool ResampleKernel<TYPE>::combineRows(const float* const* rows, const float* weights, \
+                                         int taps, int count, TYPE* result) \
+  {                                                                     \
+    return combineResampledRows(rows, weights, taps, count, result);    \
+  }
+
+  PII_DEFINE_RESAMPLE_KERNEL(uchar)
+  PII_DEFINE_RESAMPLE_KERNEL(ushort)
+  PII_DEFINE_RESAMPLE_KERNEL(float)
+
+#undef PII_DEFINE_RESAMPLE_KERNEL
+}
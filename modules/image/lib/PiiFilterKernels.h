@@ -0,0 +1,279 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFILTERKERNELS_H
+#define _PIIFILTERKERNELS_H
+
+#include "PiiImageGlobal.h"
+#include <PiiMatrix.h>
+#include <PiiHalf.h>
+
+namespace PiiImage
+{
+  /**
+   * Vectorized implementations of linear image filtering. The
+   * kernels compute the valid part of the correlation between an
+   * image and a filter, which is what [filter()] does after
+   * extending the borders of an image.
+   *
+   * The generic template only says "not supported", which makes the
+   * caller fall back to PiiDsp::filter(). Specializations exist for
+   * the combinations of input, filter and result types most commonly
+   * used in image processing:
+   *
+   * - `uchar`, `ushort` and `int` images with `int` filters and
+   * `int` results
+   * - `uchar`, `ushort`, `float` and PiiHalf images with `float`
+   * filters and `float` results
+   *
+   * The instruction set (SSE2, AVX2 or NEON) is selected at run time
+   * based on Pii::cpuFeatures(). Results are identical to those of
+   * the generic implementation: the products are accumulated in the
+   * same order, and fused multiply-add is not used.
+   *
+   * @internal
+   */
+  template <class ResultType, class T, class U> struct FilterKernel
+  {
+    /**
+     * Returns `true` if a vectorized kernel can be used on this CPU.
+     */
+    static bool isSupported() { return false; }
+    /**
+     * Calculates the valid part of the correlation of *image* and
+     * *filter* into *result*. Returns `false` if a vectorized kernel
+     * is not available. In this case *result* is not modified.
+     */
+    static bool filter(const PiiMatrix<T>&, const PiiMatrix<U>&, PiiMatrix<ResultType>&) { return false; }
+  };
+
+#define PII_DECLARE_FILTER_KERNEL(RESULT, INPUT, FILTER)                \
+  template <> struct PII_IMAGE_EXPORT FilterKernel<RESULT, INPUT, FILTER> \
+  {                                                                     \
+    static bool isSupported();                                          \
+    static bool filter(const PiiMatrix<INPUT>& image,                   \
+                       const PiiMatrix<FILTER>& filter,                 \
+                       PiiMatrix<RESULT>& result);                      \
+  }
+
+  PII_DECLARE_FILTER_KERNEL(int, uchar, int);
+  PII_DECLARE_FILTER_KERNEL(int, ushort, int);
+  PII_DECLARE_FILTER_KERNEL(int, int, int);
+  PII_DECLARE_FILTER_KERNEL(float, uchar, float);
+  PII_DECLARE_FILTER_KERNEL(float, ushort, float);
+  PII_DECLARE_FILTER_KERNEL(float, float, float);
+  PII_DECLARE_FILTER_KERNEL(float, PiiHalf, float);
+
+#undef PII_DECLARE_FILTER_KERNEL
+
+  /**
+   * Vectorized implementations of 2x downsampling by averaging. The
+   * kernels calculate each pixel of *result* as the average of a 2-by-2
+   * block of *image*, which is what [quarterSize()] does. *result*
+   * must be preallocated to half the size of *image* (rounded down).
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to scalar code. Specializations exist for `uchar` and `float`
+   * images. Results are identical to those of the generic
+   * implementation: the four pixels are summed as (a+b)+(c+d).
+   *
+   * @internal
+   */
+  template <class T> struct HalvingKernel
+  {
+    static bool halve(const PiiMatrix<T>&, PiiMatrix<T>&) { return false; }
+  };
+
+#define PII_DECLARE_HALVING_KERNEL(TYPE)                                \
+  template <> struct PII_IMAGE_EXPORT HalvingKernel<TYPE>               \
+  {                                                                     \
+    static bool halve(const PiiMatrix<TYPE>& image, PiiMatrix<TYPE>& result); \
+  }
+
+  PII_DECLARE_HALVING_KERNEL(uchar);
+  PII_DECLARE_HALVING_KERNEL(float);
+
+#undef PII_DECLARE_HALVING_KERNEL
+
+  /**
+   * Vectorized Sobel gradients for the fused edge detector (see
+   * [cannyEdges()]). The kernels take three consecutive image rows
+   * that have been extended by one pixel on both sides and calculate
+   * the horizontal and vertical gradients and the gradient magnitude
+   * (|gx| + |gy|) of *columns* pixels. The result at index *c*
+   * corresponds to column *c+1* of the extended rows. The gradients
+   * are the same as those obtained by correlating the image with
+   * [SobelXFilter] and [SobelYFilter].
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to scalar code. Specializations exist for `uchar` images
+   * with `int` gradients and `float` images with `float` gradients.
+   * The terms are summed in the same order as in the scalar code.
+   *
+   * @internal
+   */
+  template <class T, class G> struct SobelKernel
+  {
+    static bool gradient(const T*, const T*, const T*, int, G*, G*, G*) { return false; }
+  };
+
+#define PII_DECLARE_SOBEL_KERNEL(TYPE, GRADIENT)                        \
+  template <> struct PII_IMAGE_EXPORT SobelKernel<TYPE, GRADIENT>       \
+  {                                                                     \
+    static bool gradient(const TYPE* row0, const TYPE* row1, const TYPE* row2, int columns, \
+                         GRADIENT* gradientX, GRADIENT* gradientY, GRADIENT* magnitude); \
+  }
+
+  PII_DECLARE_SOBEL_KERNEL(uchar, int);
+  PII_DECLARE_SOBEL_KERNEL(float, float);
+
+#undef PII_DECLARE_SOBEL_KERNEL
+
+  /**
+   * Vectorized FAST-9 segment test for [detectFastCorners()]. *row*
+   * points to the beginning of an image row whose three neighbors
+   * above and below can be accessed through *stride* (the distance
+   * between rows in bytes). The kernel sets `corners[c]` to one if
+   * the pixel at column *c* is a corner with the given *threshold*
+   * and to zero otherwise, for all *c* in [3, *columns* - 3).
+   *
+   * [score()] returns the largest threshold with which the corner at
+   * *center* would still be detected. *pixel* contains the byte
+   * offsets of the 16 pixels on the circle (see
+   * fast9_make_offsets()). The score is the same as that found by
+   * the binary search in fast9_corner_score().
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to the decision tree of the original FAST implementation. A
+   * specialization exists for `uchar` images. The detected corners
+   * are the same. [score()] may only be called if [isSupported()]
+   * returns `true`.
+   *
+   * @internal
+   */
+  template <class T> struct FastCornerKernel
+  {
+    static bool isSupported() { return false; }
+    static bool segmentTest(const T*, int, int, int, uchar*) { return false; }
+    static int score(const T*, const int*) { return 0; }
+  };
+
+  template <> struct PII_IMAGE_EXPORT FastCornerKernel<uchar>
+  {
+    static bool isSupported();
+    static bool segmentTest(const uchar* row, int stride, int columns, int threshold, uchar* corners);
+    static int score(const uchar* center, const int* pixel);
+  };
+
+  /**
+   * Vectorized row sums for [blockSums()]. The kernel divides the
+   * first `blockEnds[blocks-1]` bytes of *row* into *blocks*
+   * consecutive blocks so that block *b* ends just before
+   * `blockEnds[b]`. The sum of the bytes in each block is added to
+   * `sums[b]`. Color images with 8-bit channels are summed as byte
+   * rows.
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to scalar code. A specialization exists for `uchar`. The
+   * sums are exact.
+   *
+   * @internal
+   */
+  template <class T> struct BlockSumKernel
+  {
+    static bool sumRow(const T*, const int*, int, unsigned int*) { return false; }
+  };
+
+  template <> struct PII_IMAGE_EXPORT BlockSumKernel<uchar>
+  {
+    static bool sumRow(const uchar* row, const int* blockEnds, int blocks, unsigned int* sums);
+  };
+
+  /**
+   * The number of bits in the fractional part of source coordinates
+   * stored in a PiiRemapTable, and the number of bits in the
+   * interpolation weights derived from them. The four weights of a
+   * pixel sum up to `1 << RemapWeightBits`.
+   *
+   * @internal
+   */
+  enum { RemapFractionBits = 7, RemapWeightBits = 2*RemapFractionBits };
+
+  /**
+   * Vectorized implementations of table-driven bilinear sampling (see
+   * PiiRemapTable). *coordinates* stores an (x,y) pair and *weights*
+   * four interpolation weights for each pixel of *result*, which must
+   * be preallocated to the size of the table. A negative x coordinate
+   * marks a pixel outside of *image*; such pixels are set to
+   * *background*.
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to floating-point interpolation. The `uchar` specialization
+   * always succeeds: it interpolates in fixed point and rounds the
+   * result to the nearest integer even if the CPU lacks vector
+   * instructions.
+   *
+   * @internal
+   */
+  template <class T> struct RemapKernel
+  {
+    static bool remap(const PiiMatrix<T>&, const PiiMatrix<int>&, const PiiMatrix<short>&,
+                      T, PiiMatrix<T>&) { return false; }
+  };
+
+  template <> struct PII_IMAGE_EXPORT RemapKernel<uchar>
+  {
+    static bool remap(const PiiMatrix<uchar>& image,
+                      const PiiMatrix<int>& coordinates,
+                      const PiiMatrix<short>& weights,
+                      uchar background,
+                      PiiMatrix<uchar>& result);
+  };
+
+  /**
+   * Vectorized vertical pass of separable resampling (see
+   * [scale()]). The kernel calculates
+   * `result[i] = rows[0][i] * weights[0] + ... + rows[taps-1][i] *
+   * weights[taps-1]` for all *i* in [0, *count*). Color images are
+   * processed as rows of channels. Integer results are clamped to the
+   * range of the type, and halves are rounded up.
+   *
+   * The generic template says "not supported", and the caller falls
+   * back to scalar code. Specializations exist for `uchar`, `ushort`
+   * and `float` results. The products are summed in the same order as
+   * in the scalar code, which makes the results identical.
+   *
+   * @internal
+   */
+  template <class T> struct ResampleKernel
+  {
+    static bool combineRows(const float* const*, const float*, int, int, T*) { return false; }
+  };
+
+#define PII_DECLARE_RESAMPLE_KERNEL(TYPE)                               \
+  template <> struct PII_IMAGE_EXPORT ResampleKernel<TYPE>              \
+  {                                                                     \
+    static bool combineRows(const float* const* rows, const float* weights, \
+                            int taps, int count, TYPE* result);         \
+  }
+
+  PII_DECLARE_RESAMPLE_KERNEL(uchar);
+  PII_DECLARE_RESAMPLE_KERNEL(ushort);
+  PII_DECLARE_RESAMPLE_KERNEL(float);
+
+#undef PII_DECLARE_RESAMPLE_KERNEL
+}
+
+#endif //_PIIFILTERKERNELS_H
@@ -22,36 +22,225 @@
 
 namespace PiiImage
 {
+  namespace Private
+  {
+    // The fast histogram works on 8 and 16-bit images and on ROIs
+    // that can be read a row at a time.
+    template <class U> struct IsShortInteger : Pii::False {};
+    template <> struct IsShortInteger<unsigned char> : Pii::True {};
+    template <> struct IsShortInteger<unsigned short> : Pii::True {};
+
+    template <class Roi> struct RowRoi : Pii::False {};
+    template <> struct RowRoi<DefaultRoi> : Pii::True
+    {
+      static const bool* row(const DefaultRoi&, int) { return 0; }
+    };
+    template <> struct RowRoi<PiiMatrix<bool> > : Pii::True
+    {
+      static const bool* row(const PiiMatrix<bool>& roi, int r) { return roi[r]; }
+    };
+    // Run-length ROIs are read span by span, see addRoiRow().
+    template <> struct RowRoi<RunLengthRoi> : Pii::True {};
+
+    template <class U, class Roi> struct FastHistogram :
+      Pii::And<IsShortInteger<U>::boolValue, RowRoi<Roi>::boolValue>
+    {};
+
+    // Returns the bin of a pixel, or the extra bin if the pixel is
+    // out of range or not in the ROI.
+    template <class U> inline unsigned int roiBin(U value, bool inRoi, unsigned int levels)
+    {
+      const unsigned int uiValue = qMin(unsigned(value), levels);
+      return uiValue + ((levels - uiValue) & (unsigned(inRoi) - 1));
+    }
+
+    /* Adds one row to four interleaved sub-histograms, each of which
+     * has levels+1 bins. Values that are out of range or outside of
+     * the ROI go to the extra bin, which is ignored in the end.
+     */
+    template <class U> void addToHistogram(const U* row, const bool* mask, int columns,
+                                           unsigned int levels, int* bins)
+    {
+      const int iStride = int(levels) + 1;
+      int* pBins0 = bins, *pBins1 = bins + iStride, *pBins2 = pBins1 + iStride, *pBins3 = pBins2 + iStride;
+      int c = 0;
+      if (mask == 0)
+        {
+          for (; c <= columns-4; c += 4)
+            {
+              ++pBins0[qMin(unsigned(row[c]), levels)];
+              ++pBins1[qMin(unsigned(row[c+1]), levels)];
+              ++pBins2[qMin(unsigned(row[c+2]), levels)];
+              ++pBins3[qMin(unsigned(row[c+3]), levels)];
+            }
+          for (; c < columns; ++c)
+            ++pBins0[qMin(unsigned(row[c]), levels)];
+        }
+      else
+        {
+          for (; c <= columns-4; c += 4)
+            {
+              ++pBins0[roiBin(row[c], mask[c], levels)];
+              ++pBins1[roiBin(row[c+1], mask[c+1], levels)];
+              ++pBins2[roiBin(row[c+2], mask[c+2], levels)];
+              ++pBins3[roiBin(row[c+3], mask[c+3], levels)];
+            }
+          for (; c < columns; ++c)
+            ++pBins0[roiBin(row[c], mask[c], levels)];
+        }
+    }
+
+    template <class U, class Roi> inline void addRoiRow(const PiiMatrix<U>& image, const Roi& roi, int r,
+                                                        unsigned int levels, int* bins)
+    {
+      addToHistogram(image.row(r), RowRoi<Roi>::row(roi, r), image.columns(), levels, bins);
+    }
+
+    // Only the pixels inside the spans are touched.
+    template <class U> inline void addRoiRow(const PiiMatrix<U>& image, const RunLengthRoi& roi, int r,
+                                             unsigned int levels, int* bins)
+    {
+      const U* pRow = image.row(r);
+      for (const RunLengthRoi::Span* pSpan = roi.rowBegin(r); pSpan != roi.rowEnd(r); ++pSpan)
+        addToHistogram(pRow + pSpan->start, 0, pSpan->end - pSpan->start, levels, bins);
+    }
+
+    template <class U, class Roi> struct HistogramStrip
+    {
+      HistogramStrip(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels, int strips) :
+        matImage(image), roi(roi), uiLevels(levels),
+        vecBins(strips, QVector<int>(4 * (int(levels) + 1)))
+      {}
+
+      int firstRow(int strip) const
+      {
+        return int(qint64(matImage.rows()) * strip / vecBins.size());
+      }
+
+      void operator() (int firstStrip, int endStrip)
+      {
+        for (int i = firstStrip; i < endStrip; ++i)
+          {
+            int* pBins = vecBins[i].data();
+            for (int r = firstRow(i); r < firstRow(i+1); ++r)
+              addRoiRow(matImage, roi, r, uiLevels, pBins);
+          }
+      }
+
+      const PiiMatrix<U>& matImage;
+      const Roi& roi;
+      unsigned int uiLevels;
+      QVector<QVector<int> > vecBins;
+    };
+
+    template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi,
+                                                                  unsigned int levels,
+                                                                  const PiiParallelPolicy& policy,
+                                                                  Pii::True)
+    {
+      const int iStrips = image.isEmpty() ? 1 : policy.stripCount(image.rows());
+      HistogramStrip<U,Roi> strip(image, roi, levels, iStrips);
+      Pii::forEachStrip(iStrips, strip, PiiParallelPolicy(iStrips, 1));
+
+      // Sum up the sub-histograms of all strips.
+      PiiMatrix<T> result(1, int(levels));
+      T* vector = result.row(0);
+      const int iStride = int(levels) + 1;
+      for (int i = 0; i < iStrips; ++i)
+        {
+          const int* pBins = strip.vecBins[i].constData();
+          for (int b = 0; b < int(levels); ++b)
+            vector[b] += T(pBins[b] + pBins[b + iStride] + pBins[b + 2*iStride] + pBins[b + 3*iStride]);
+        }
+      return result;
+    }
+
+    template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi,
+                                                                  unsigned int levels,
+                                                                  const PiiParallelPolicy& /*policy*/,
+                                                                  Pii::False)
+    {
+      PiiMatrix<T> result(1, int(levels));
+      T* vector = result.row(0);
+
+      const int iRows = image.rows(), iCols = image.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          int iFirst = 0, iEnd = iCols;
+          if (!clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+          const U* row = image.row(r);
+          for (int c=iFirst; c<iEnd; ++c)
+            if (unsigned(row[c]) < levels && roi(r,c)) ++vector[unsigned(row[c])];
+        }
+      return result;
+    }
+  }
+
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels)
+  {
+    return histogram<T>(image, roi, levels, PiiParallelPolicy::sequential());
+  }
+
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels,
+                                                                const PiiParallelPolicy& policy)
   {
     if (levels < 1)
       levels = unsigned(Pii::max(image)) + 1;
-    PiiMatrix<T> result(1, int(levels));
-    T* vector = result.row(0);
+    return Private::histogram<T>(image, roi, levels, policy,
+                                 typename Pii::IfClass<Private::FastHistogram<U,Roi>, Pii::True, Pii::False>::Type());
+  }
 
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int r=0; r<iRows; ++r)
-      {
-        const U* row = image.row(r);
-        for (int c=0; c<iCols; ++c)
-          if (unsigned(row[c]) < levels && roi(r,c)) ++vector[unsigned(row[c])];
-      }
-    return result;
+  namespace Private
+  {
+    template <class T, class U, class Roi> PiiMatrix<T> quantizedHistogram(const PiiMatrix<U>& image, const Roi& roi,
+                                                                           const PiiQuantizer<U>& quantizer,
+                                                                           Pii::False)
+    {
+      PiiMatrix<T> result(1, quantizer.levels());
+      T* vector = result.row(0);
+
+      const int iRows = image.rows(), iCols = image.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          int iFirst = 0, iEnd = iCols;
+          if (!clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+          const U* row = image.row(r);
+          for (int c=iFirst; c<iEnd; ++c)
+            if (roi(r,c)) ++vector[quantizer.quantize(row[c])];
+        }
+      return result;
+    }
+
+    /* With 8 and 16-bit images, the quantizer has a table that maps
+       each pixel value to a level. A plain histogram of the pixel
+       values is folded through the table, which is as fast as the
+       plain histogram itself.
+     */
+    template <class T, class U, class Roi> PiiMatrix<T> quantizedHistogram(const PiiMatrix<U>& image, const Roi& roi,
+                                                                           const PiiQuantizer<U>& quantizer,
+                                                                           Pii::True)
+    {
+      const PiiMatrix<int> matTable(quantizer.lookupTable());
+      if (matTable.isEmpty())
+        return quantizedHistogram<T>(image, roi, quantizer, Pii::False());
+
+      const PiiMatrix<int> matValues(histogram<int>(image, roi, unsigned(matTable.columns()),
+                                                    PiiParallelPolicy::sequential(), Pii::True()));
+      PiiMatrix<T> result(1, quantizer.levels());
+      T* vector = result.row(0);
+      const int* pTable = matTable.row(0), *pValues = matValues.row(0);
+      for (int i=0; i<matTable.columns(); ++i)
+        vector[pTable[i]] += T(pValues[i]);
+      return result;
+    }
   }
 
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer)
   {
-    PiiMatrix<T> result(1, quantizer.levels());
-    T* vector = result.row(0);
-
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int r=0; r<iRows; ++r)
-      {
-        const U* row = image.row(r);
-        for (int c=0; c<iCols; ++c)
-          if (roi(r,c)) ++vector[quantizer.quantize(row[c])];
-      }
-    return result;
+    return Private::quantizedHistogram<T>(image, roi, quantizer,
+                                          typename Pii::IfClass<Private::FastHistogram<U,Roi>, Pii::True, Pii::False>::Type());
   }
 
   template <class T, class U> PiiMatrix<T> normalize(const PiiMatrix<U>& histogram)
@@ -142,4 +331,123 @@ namespace PiiImage
       }
     return backProject(img, newDist);
   }
+
+  namespace Private
+  {
+    /* Finds the two tile centers that surround each position on one
+       axis. Tile i spans [i*size/tiles, (i+1)*size/tiles). Outside
+       of the outermost centers, both indices point to the same tile.
+     */
+    inline void tileInterpolation(int size, int tiles, int* firstTiles, int* secondTiles, float* weights)
+    {
+      QVector<float> vecCenters(tiles);
+      for (int i=0; i<tiles; ++i)
+        vecCenters[i] = 0.5f * (i * size / tiles + (i+1) * size / tiles - 1);
+
+      int iTile = 0;
+      for (int i=0; i<size; ++i)
+        {
+          while (iTile < tiles-1 && i >= vecCenters[iTile+1])
+            ++iTile;
+          if (i <= vecCenters[iTile] || iTile == tiles-1)
+            {
+              firstTiles[i] = secondTiles[i] = iTile;
+              weights[i] = 0;
+            }
+          else
+            {
+              firstTiles[i] = iTile;
+              secondTiles[i] = iTile + 1;
+              weights[i] = (i - vecCenters[iTile]) / (vecCenters[iTile+1] - vecCenters[iTile]);
+            }
+        }
+    }
+  }
+
+  template <class T> PiiMatrix<T> equalizeLocally(const PiiMatrix<T>& img,
+                                                  int tileRows, int tileColumns,
+                                                  unsigned int levels,
+                                                  double clipLimit)
+  {
+    const int iRows = img.rows(), iCols = img.columns();
+    if (iRows == 0 || iCols == 0)
+      return img;
+
+    unsigned int maxValue = (unsigned int)Pii::max(img);
+    if (levels <= maxValue)
+      levels = maxValue + 1;
+
+    const int iTileRows = qBound(1, (iRows + qMax(tileRows, 1)/2) / qMax(tileRows, 1), iRows);
+    const int iTileCols = qBound(1, (iCols + qMax(tileColumns, 1)/2) / qMax(tileColumns, 1), iCols);
+    const int iLevels = int(levels);
+
+    // The mappings (float gray levels) of a row of tiles are stored
+    // on one row.
+    PiiMatrix<float> matMappings(PiiMatrix<float>::uninitialized(iTileRows, iTileCols * iLevels));
+    PiiMatrix<int> matHistogram(1, iLevels);
+    int* pHistogram = matHistogram[0];
+    for (int tr=0; tr<iTileRows; ++tr)
+      for (int tc=0; tc<iTileCols; ++tc)
+        {
+          const int iTop = tr * iRows / iTileRows, iBottom = (tr+1) * iRows / iTileRows;
+          const int iLeft = tc * iCols / iTileCols, iRight = (tc+1) * iCols / iTileCols;
+          std::fill(pHistogram, pHistogram + iLevels, 0);
+          for (int r=iTop; r<iBottom; ++r)
+            {
+              const T* pRow = img[r];
+              for (int c=iLeft; c<iRight; ++c)
+                ++pHistogram[int(pRow[c])];
+            }
+          const int iPixels = (iBottom - iTop) * (iRight - iLeft);
+
+          float fExcess = 0;
+          if (clipLimit > 0)
+            {
+              const int iClip = qMax(1, int(clipLimit * iPixels / iLevels));
+              int iClipped = 0;
+              for (int i=0; i<iLevels; ++i)
+                if (pHistogram[i] > iClip)
+                  {
+                    iClipped += pHistogram[i] - iClip;
+                    pHistogram[i] = iClip;
+                  }
+              fExcess = float(iClipped) / iLevels;
+            }
+
+          // The clipped pixels are spread evenly over all levels.
+          float* pMapping = matMappings[tr] + tc * iLevels;
+          const float fScale = float(iLevels - 1) / iPixels;
+          float fSum = 0;
+          for (int i=0; i<iLevels; ++i)
+            {
+              fSum += pHistogram[i] + fExcess;
+              pMapping[i] = fSum * fScale;
+            }
+        }
+
+    QVector<int> vecFirstRows(iRows), vecSecondRows(iRows), vecFirstCols(iCols), vecSecondCols(iCols);
+    QVector<float> vecRowWeights(iRows), vecColWeights(iCols);
+    Private::tileInterpolation(iRows, iTileRows, vecFirstRows.data(), vecSecondRows.data(), vecRowWeights.data());
+    Private::tileInterpolation(iCols, iTileCols, vecFirstCols.data(), vecSecondCols.data(), vecColWeights.data());
+
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* pSource = img[r];
+        T* pTarget = result[r];
+        const float fRowWeight = vecRowWeights[r];
+        const float* pTopMappings = matMappings[vecFirstRows[r]];
+        const float* pBottomMappings = matMappings[vecSecondRows[r]];
+        for (int c=0; c<iCols; ++c)
+          {
+            const int iValue = int(pSource[c]);
+            const int iFirst = vecFirstCols[c] * iLevels + iValue, iSecond = vecSecondCols[c] * iLevels + iValue;
+            const float fColWeight = vecColWeights[c];
+            const float fTop = pTopMappings[iFirst] + fColWeight * (pTopMappings[iSecond] - pTopMappings[iFirst]);
+            const float fBottom = pBottomMappings[iFirst] + fColWeight * (pBottomMappings[iSecond] - pBottomMappings[iFirst]);
+            pTarget[c] = T(fTop + fRowWeight * (fBottom - fTop) + 0.5f);
+          }
+      }
+    return result;
+  }
 }
@@ -19,6 +19,7 @@
 #include "PiiQuantizer.h"
 #include "PiiImage.h"
 #include <PiiMath.h>
+#include <QVector>
 
 namespace PiiImage
 {
@@ -42,6 +43,27 @@ namespace PiiImage
    */
   template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels);
 
+  /**
+   * Calculate the histogram of a one-channel image in parallel. The
+   * image is divided into horizontal strips as determined by
+   * *policy*, and the partial histograms are summed at the end.
+   *
+   * 8 and 16-bit images are processed with four interleaved
+   * sub-histograms, which prevents consecutive pixels with equal
+   * values from waiting for each other's increments. This is done
+   * also in the sequential version. If *roi* is DefaultRoi or a
+   * PiiMatrix<bool> mask, the ROI test is folded into the bin index
+   * without a per-pixel branch.
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> image;
+   * PiiMatrix<int> matHistogram(PiiImage::histogram<int>(image, PiiImage::DefaultRoi(),
+   *                                                      256, PiiParallelPolicy()));
+   * ~~~
+   */
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels,
+                                                                const PiiParallelPolicy& policy);
+
   /**
    * Calculate the histogram of a one-channel image. This is a
    * shorthand for `histogram<int>(image, roi, levels)`.
@@ -229,6 +251,43 @@ namespace PiiImage
    * @return an image with enhanced contrast
    */
   template <class T> PiiMatrix<T> equalize(const PiiMatrix<T>& img, unsigned int levels = 0);
+
+  /**
+   * Contrast-limited adaptive histogram equalization (CLAHE). Divides
+   * `img` into a grid of tiles and calculates an equalization mapping
+   * for each tile once. The mapping of each pixel is bilinearly
+   * interpolated between the mappings of the four closest tile
+   * centers, which hides the tile boundaries. Unlike with a sliding
+   * window, the cost is independent of tile size.
+   *
+   * @param img the input image. The gray levels must be non-negative
+   * integers since they are used as histogram indices.
+   *
+   * @param tileRows the approximate height of a tile. The image is
+   * divided into `round(img.rows() / tileRows)` tiles vertically, at
+   * least one.
+   *
+   * @param tileColumns the approximate width of a tile
+   *
+   * @param levels the number of quantization levels, as in
+   * equalize().
+   *
+   * @param clipLimit limits the amplification of contrast. Histogram
+   * bins higher than `clipLimit` times the average bin height are
+   * clipped, and the excess is spread evenly over all bins. Typical
+   * values are 2-4. Zero disables clipping, which results in plain
+   * tile-based adaptive equalization.
+   *
+   * @return an image with locally enhanced contrast
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> matEnhanced(PiiImage::equalizeLocally(image, 64, 64, 256, 3.0));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> equalizeLocally(const PiiMatrix<T>& img,
+                                                  int tileRows, int tileColumns,
+                                                  unsigned int levels = 0,
+                                                  double clipLimit = 0);
 };
 
 #include "PiiHistogram-templates.h"
@@ -23,6 +23,13 @@
 
 #include <PiiMatrixUtil.h>
 #include <PiiMath.h>
+#include <PiiFixedPoint.h>
+#include <PiiInvalidArgumentException.h>
+#include <QCoreApplication>
+#include <QVector>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
 
 namespace PiiImage
 {
@@ -140,6 +147,11 @@ namespace PiiImage
   template <class T> struct Rounder { static T round(typename Pii::ToFloatingPoint<T>::Type val) { return (T)Pii::round(val); } };
   template <> struct Rounder<float> { static float round(float val) { return val; } };
   template <> struct Rounder<double> { static double round(double val) { return val; }  };
+  template <> struct Rounder<PiiHalf> { static PiiHalf round(float val) { return PiiHalf(val); } };
+  template <int decimals, class T> struct Rounder<PiiFixedPoint<decimals,T> >
+  {
+    static PiiFixedPoint<decimals,T> round(float val) { return PiiFixedPoint<decimals,T>(double(val)); }
+  };
   // Round each color channel separately
   template <class T> struct Rounder<PiiColor<T> >
   {
@@ -173,6 +185,133 @@ namespace PiiImage
   }
 
 
+  // Channel type and count of pixels in resampling
+  template <class T> struct ResampleChannels { typedef T Type; enum { Count = 1 }; };
+  template <class T> struct ResampleChannels<PiiColor<T> > { typedef T Type; enum { Count = 3 }; };
+  template <class T> struct ResampleChannels<PiiColor4<T> > { typedef T Type; enum { Count = 4 }; };
+
+  // Images whose channels ResampleKernel can write
+  template <class T> struct IsResampleVectorizable :
+    Pii::Or<Pii::IsSame<typename ResampleChannels<T>::Type, uchar>::boolValue,
+            Pii::IsSame<typename ResampleChannels<T>::Type, ushort>::boolValue,
+            Pii::IsSame<typename ResampleChannels<T>::Type, float>::boolValue>
+  {};
+
+  // Integers are clamped and rounded half up like in ResampleKernel.
+  template <class T, class Real> inline T castResampled(Real value, Pii::True)
+  {
+    value = std::floor(value + Real(0.5));
+    if (value <= Real(Pii::Numeric<T>::minValue()))
+      return Pii::Numeric<T>::minValue();
+    if (value >= Real(Pii::Numeric<T>::maxValue()))
+      return Pii::Numeric<T>::maxValue();
+    return T(value);
+  }
+
+  template <class T, class Real> inline T castResampled(Real value, Pii::False)
+  {
+    return Rounder<T>::round(value);
+  }
+
+  template <class T> struct ResampleCaster
+  {
+    template <class Real> static T cast(Real value)
+    {
+      return castResampled<T>(value, typename Pii::IfClass<Pii::IsInteger<T>, Pii::True, Pii::False>::Type());
+    }
+  };
+
+  template <class T> struct ResampleCaster<PiiColor<T> >
+  {
+    template <class Real> static PiiColor<T> cast(const Real& value)
+    {
+      return PiiColor<T>(ResampleCaster<T>::cast(value.c0),
+                         ResampleCaster<T>::cast(value.c1),
+                         ResampleCaster<T>::cast(value.c2));
+    }
+  };
+
+  template <class T> struct ResampleCaster<PiiColor4<T> >
+  {
+    template <class Real> static PiiColor4<T> cast(const Real& value)
+    {
+      return PiiColor4<T>(ResampleCaster<T>::cast(value.c0),
+                          ResampleCaster<T>::cast(value.c1),
+                          ResampleCaster<T>::cast(value.c2),
+                          ResampleCaster<T>::cast(value.c3));
+    }
+  };
+
+  // Horizontal pass: resamples one row of the input image.
+  template <class T, class Real> void resampleRow(const T* source, const ResampleTable& table,
+                                                  int columns, Real* target)
+  {
+    typedef typename Pii::ToFloatingPoint<T>::PrimitiveType RealScalar;
+    const int iTaps = table.iTaps;
+    const float* pWeights = table.vecWeights.constData();
+    for (int c=0; c<columns; ++c, pWeights += iTaps)
+      {
+        const T* pSource = source + table.vecFirst[c];
+        Real sum(0);
+        for (int k=0; k<iTaps; ++k)
+          sum += Real(pSource[k]) * RealScalar(pWeights[k]);
+        target[c] = sum;
+      }
+  }
+
+  // Vertical pass: combines horizontally resampled rows to a row of
+  // the result.
+  template <class T, class Real> void combineResampledRows(const Real* const* rows, const float* weights,
+                                                           int taps, int columns, T* result, Pii::False)
+  {
+    typedef typename Pii::ToFloatingPoint<T>::PrimitiveType RealScalar;
+    for (int c=0; c<columns; ++c)
+      {
+        Real sum(0);
+        for (int k=0; k<taps; ++k)
+          sum += rows[k][c] * RealScalar(weights[k]);
+        result[c] = ResampleCaster<T>::cast(sum);
+      }
+  }
+
+  template <class T, class Real> void combineResampledRows(const Real* const* rows, const float* weights,
+                                                           int taps, int columns, T* result, Pii::True)
+  {
+    typedef typename ResampleChannels<T>::Type Channel;
+    QVarLengthArray<const float*,16> vecChannelRows(taps);
+    for (int k=0; k<taps; ++k)
+      vecChannelRows[k] = reinterpret_cast<const float*>(rows[k]);
+    if (!ResampleKernel<Channel>::combineRows(vecChannelRows.data(), weights, taps,
+                                              columns * ResampleChannels<T>::Count,
+                                              reinterpret_cast<Channel*>(result)))
+      combineResampledRows(rows, weights, taps, columns, result, Pii::False());
+  }
+
+  template <class T> PiiMatrix<T> resample(const PiiMatrix<T>& image, int rows, int columns,
+                                           Pii::Interpolation interpolation)
+  {
+    typedef typename Pii::ToFloatingPoint<T>::Type Real;
+    const ResampleTable horizontal(image.columns(), columns, interpolation),
+      vertical(image.rows(), rows, interpolation);
+
+    PiiMatrix<Real> matRows(PiiMatrix<Real>::uninitialized(image.rows(), columns));
+    for (int r=0; r<image.rows(); ++r)
+      resampleRow(image.row(r), horizontal, columns, matRows.row(r));
+
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(rows, columns));
+    const int iTaps = vertical.iTaps;
+    QVarLengthArray<const Real*,16> vecRows(iTaps);
+    for (int r=0; r<rows; ++r)
+      {
+        for (int k=0; k<iTaps; ++k)
+          vecRows[k] = matRows.row(vertical.vecFirst[r] + k);
+        combineResampledRows(vecRows.data(), vertical.vecWeights.constData() + r*iTaps,
+                             iTaps, columns, result.row(r),
+                             typename Pii::IfClass<IsResampleVectorizable<T>, Pii::True, Pii::False>::Type());
+      }
+    return result;
+  }
+
   template <class T> PiiMatrix<T> scale(const PiiMatrix<T>& image, int rows, int columns, Pii::Interpolation interpolation)
   {
     // Catch invalid cases
@@ -182,19 +321,27 @@ namespace PiiImage
     if (rows == image.rows() && columns == image.columns())
       return image;
 
+    if (interpolation == Pii::CubicInterpolation || interpolation == Pii::AreaInterpolation)
+      return resample(image, rows, columns, interpolation);
+
     PiiMatrix<T> result(PiiMatrix<T>::uninitialized(rows, columns));
     if (interpolation == Pii::NearestNeighborInterpolation)
       {
         double stepX = (double)image.columns() / columns;
         double stepY = (double)image.rows() / rows;
+        // Source columns are the same on each row.
+        QVector<int> vecColumns(columns);
+        double currentColumn = 0;
+        for (int c=0; c<columns; c++, currentColumn += stepX)
+          vecColumns[c] = (int)currentColumn;
+        const int* pColumns = vecColumns.constData();
         double currentRow = 0;
         for (int r=0; r<rows; r++, currentRow += stepY)
           {
             const T* sourceRow = image.row((int)currentRow);
             T* resultRow = result.row(r);
-            double currentColumn = 0;
-            for (int c=0; c<columns; c++, currentColumn += stepX)
-              resultRow[c] = sourceRow[(int)currentColumn];
+            for (int c=0; c<columns; c++)
+              resultRow[c] = sourceRow[pColumns[c]];
           }
       }
     else //if (interpolation == Pii::LinearInterpolation)
@@ -465,7 +612,6 @@ namespace PiiImage
     return matResult;
   }
 
-  // PENDING use histogram-based filtering for large neighborhoods
   template <class T> PiiMatrix<T> medianFilter(const PiiMatrix<T>& image,
                                                int windowRows, int windowColumns,
                                                Pii::ExtendMode mode)
@@ -477,6 +623,16 @@ namespace PiiImage
     int rows = windowRows / 2, cols = windowColumns / 2;
     PiiMatrix<T> result(Pii::extend(image, rows, rows, cols, cols, mode));
 
+    // Large neighborhoods of 8-bit images are faster to handle with
+    // histograms.
+    PiiMatrix<T> matMedian;
+    if (histogramMedianFilter(result, windowRows, windowColumns, matMedian))
+      {
+        if (mode != Pii::ExtendNot)
+          return matMedian(0, 0, image.rows(), image.columns());
+        return matMedian;
+      }
+
     // Allocate an array to which the entire neigbhborhood will be
     // stored.
     int neighborhoodSize = windowRows * windowColumns;
@@ -757,6 +913,56 @@ namespace PiiImage
   template <class GreaterThan, class T, class U>
   inline void takeExtremum(GreaterThan greater, T& a, U b) { if (greater(b, a)) a = b; }
 
+  /* van Herk/Gil-Werman running extremum. The (conceptually padded)
+     input is divided into blocks of window pixels. Within each block,
+     a forward pass calculates prefix extrema and a backward pass
+     suffix extrema. Any window overlaps exactly two blocks, so its
+     extremum is combined from one suffix and one prefix. The number
+     of comparisons per pixel is three, independent of window size.
+
+     The window of target[i] covers source[i-offset,
+     i-offset+window-1]; values outside of source are initialValue.
+     Source and target may be the same. The buffer must have room for
+     2*(length+2*window) entries.
+   */
+  template <class T, class GreaterThan>
+  void runningExtremum(const T* source, int length,
+                       int window, int offset,
+                       GreaterThan greater, T initialValue,
+                       T* target, T* buffer)
+  {
+    const int iPadded = (length + window - 1 + window - 1) / window * window;
+    T* pForward = buffer;
+    T* pBackward = buffer + iPadded;
+    for (int i=0; i<iPadded; ++i)
+      {
+        const int iSource = i - offset;
+        pBackward[i] = uint(iSource) < uint(length) ? source[iSource] : initialValue;
+      }
+    for (int iBlock=0; iBlock<iPadded; iBlock += window)
+      {
+        pForward[iBlock] = pBackward[iBlock];
+        for (int i=iBlock+1; i<iBlock+window; ++i)
+          {
+            pForward[i] = pForward[i-1];
+            takeExtremum(greater, pForward[i], pBackward[i]);
+          }
+        for (int i=iBlock+window-1; i-- > iBlock; )
+          takeExtremum(greater, pBackward[i], pBackward[i+1]);
+      }
+    for (int i=0; i<length; ++i)
+      {
+        T value = pBackward[i];
+        takeExtremum(greater, value, pForward[i+window-1]);
+        target[i] = value;
+      }
+  }
+
+  /* Windows at least this large are faster to process with
+     runningExtremum() than by brute force.
+   */
+  enum { MinRunningExtremumWindow = 5 };
+
   template <class T, class GreaterThan>
   PiiMatrix<T> extremumFilter(const PiiMatrix<T>& image,
                               int windowRows, int windowColumns,
@@ -764,11 +970,36 @@ namespace PiiImage
                               T initialValue)
   {
     const int iRows = image.rows(), iCols = image.columns();
-    PiiMatrix<T> matResult(PiiMatrix<T>::constant(iRows, iCols, initialValue));
     if (windowColumns <= 0) windowColumns = windowRows;
     if (windowRows > iRows) windowRows = iRows;
     if (windowColumns > iCols) windowColumns = iCols;
 
+    if (windowRows > 0 && windowColumns > 0 &&
+        (windowRows >= MinRunningExtremumWindow || windowColumns >= MinRunningExtremumWindow))
+      {
+        PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iRows, iCols));
+        QVector<T> vecBuffer(2 * (qMax(iRows, iCols) + 2 * qMax(windowRows, windowColumns)));
+        for (int r=0; r<iRows; ++r)
+          runningExtremum(image[r], iCols, windowColumns, windowColumns / 2,
+                          greater, initialValue, matResult[r], vecBuffer.data());
+        if (windowRows > 1)
+          {
+            QVector<T> vecColumn(iRows);
+            for (int c=0; c<iCols; ++c)
+              {
+                for (int r=0; r<iRows; ++r)
+                  vecColumn[r] = matResult(r,c);
+                runningExtremum(vecColumn.data(), iRows, windowRows, windowRows / 2,
+                                greater, initialValue, vecColumn.data(), vecBuffer.data());
+                for (int r=0; r<iRows; ++r)
+                  matResult(r,c) = vecColumn[r];
+              }
+          }
+        return matResult;
+      }
+
+    PiiMatrix<T> matResult(PiiMatrix<T>::constant(iRows, iCols, initialValue));
+
     const int iLeftCols = windowColumns / 2, iRightCols = windowColumns - iLeftCols;
     for (int r=0; r<iRows; ++r)
       {
@@ -788,6 +1019,9 @@ namespace PiiImage
       }
 
     const int iTopRows = windowRows / 2, iBottomRows = windowRows - iTopRows;
+    // A single-row window leaves columns untouched.
+    if (iTopRows == 0)
+      return matResult;
     // Cyclic temporary buffer for data that cannot be written to the
     // result matrix yet.
     QVarLengthArray<T,8> tmpBfr(iTopRows);
@@ -940,14 +1174,281 @@ namespace PiiImage
     if (horizontalFilter.rows() != 1 || verticalFilter.columns() != 1)
       return PiiMatrix<ResultType>(image);
 
-    if (mode == Pii::ExtendZeros)
+    if (mode == Pii::ExtendZeros &&
+        (!FilterKernel<ResultType,T,U>::isSupported() ||
+         !FilterKernel<ResultType,ResultType,U>::isSupported()))
       return PiiDsp::filter<ResultType>(PiiDsp::filter<ResultType>(image, horizontalFilter, PiiDsp::FilterOriginalSize),
                                         verticalFilter, PiiDsp::FilterOriginalSize);
 
-    const int rows = verticalFilter.rows() >> 1, cols = horizontalFilter.columns() >> 1;
-    return PiiDsp::filter<ResultType>(PiiDsp::filter<ResultType>(Pii::extend(image, rows, rows, cols, cols, mode),
-                                                                 horizontalFilter, PiiDsp::FilterValidPart),
-                                      verticalFilter, PiiDsp::FilterValidPart);
+    // With zero padding, the result is cropped the same way as with
+    // FilterOriginalSize.
+    const int
+      rows = verticalFilter.rows() >> 1,
+      cols = horizontalFilter.columns() >> 1,
+      top = mode == Pii::ExtendZeros ? (verticalFilter.rows() - 1) >> 1 : rows,
+      left = mode == Pii::ExtendZeros ? (horizontalFilter.columns() - 1) >> 1 : cols;
+    return filterValidPart<ResultType>(filterValidPart<ResultType>(Pii::extend(image, top, rows, left, cols, mode),
+                                                                   horizontalFilter),
+                                       verticalFilter);
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> fftFilterValidPart(const PiiMatrix<T>& image,
+                                           const PiiMatrix<U>& filter,
+                                           int tileRows,
+                                           int tileColumns)
+  {
+    typedef typename Pii::IfClass<Pii::IsSame<ResultType,float>, float, double>::Type Real;
+    typedef std::complex<Real> Complex;
+
+    const int
+      iImageRows = image.rows(),
+      iImageColumns = image.columns(),
+      iFilterRows = filter.rows(),
+      iFilterColumns = filter.columns(),
+      iRows = iImageRows - iFilterRows + 1,
+      iColumns = iImageColumns - iFilterColumns + 1;
+    if (iFilterRows == 0 || iFilterColumns == 0 || iRows <= 0 || iColumns <= 0)
+      return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterValidPart);
+
+    if (tileRows <= 0 || tileColumns <= 0)
+      planFftFilter(iImageRows, iImageColumns, iFilterRows, iFilterColumns,
+                    iFilterRows * iFilterColumns, false, &tileRows, &tileColumns);
+    tileRows = qMax(tileRows, iFilterRows);
+    tileColumns = qMax(tileColumns, iFilterColumns);
+    const int
+      iValidRows = tileRows - iFilterRows + 1,
+      iValidColumns = tileColumns - iFilterColumns + 1;
+
+    PiiFft<Real> fft;
+    PiiMatrix<Real> matTile(tileRows, tileColumns);
+    for (int r=0; r<iFilterRows; ++r)
+      {
+        const U* pFilter = filter[r];
+        Real* pTile = matTile[r];
+        for (int c=0; c<iFilterColumns; ++c)
+          pTile[c] = Real(pFilter[c]);
+      }
+    // Circular correlation with the filter is a multiplication by
+    // the conjugate of its spectrum. No scaling is needed because
+    // inverseRealFft() divides by the number of elements.
+    PiiMatrix<Complex> matFilter(fft.forwardRealFft(matTile));
+    for (typename PiiMatrix<Complex>::iterator i = matFilter.begin(); i != matFilter.end(); ++i)
+      *i = std::conj(*i);
+
+    PiiMatrix<ResultType> matResult(PiiMatrix<ResultType>::uninitialized(iRows, iColumns));
+    for (int iTop=0; iTop<iRows; iTop += iValidRows)
+      {
+        const int
+          iInputRows = qMin(tileRows, iImageRows - iTop),
+          iOutputRows = qMin(iValidRows, iRows - iTop);
+        for (int iLeft=0; iLeft<iColumns; iLeft += iValidColumns)
+          {
+            const int
+              iInputColumns = qMin(tileColumns, iImageColumns - iLeft),
+              iOutputColumns = qMin(iValidColumns, iColumns - iLeft);
+            // Tiles on the right and bottom edges are zero-padded. The
+            // padding only affects pixels that will not be copied to
+            // the result.
+            for (int r=0; r<tileRows; ++r)
+              {
+                Real* pTile = matTile[r];
+                int c = 0;
+                if (r < iInputRows)
+                  for (const T* pImage = image[iTop + r] + iLeft; c<iInputColumns; ++c)
+                    pTile[c] = Real(pImage[c]);
+                for (; c<tileColumns; ++c)
+                  pTile[c] = 0;
+              }
+            PiiMatrix<Complex> matSpectrum(fft.forwardRealFft(matTile));
+            for (int r=0; r<matSpectrum.rows(); ++r)
+              {
+                Complex* pSpectrum = matSpectrum[r];
+                const Complex* pFilter = matFilter[r];
+                for (int c=0; c<matSpectrum.columns(); ++c)
+                  pSpectrum[c] *= pFilter[c];
+              }
+            PiiMatrix<Real> matFiltered(fft.inverseRealFft(matSpectrum, tileColumns));
+            for (int r=0; r<iOutputRows; ++r)
+              {
+                const Real* pFiltered = matFiltered[r];
+                ResultType* pResult = matResult[iTop + r] + iLeft;
+                for (int c=0; c<iOutputColumns; ++c)
+                  pResult[c] = ResultType(pFiltered[c]);
+              }
+          }
+      }
+    return matResult;
+  }
+
+  /// @internal
+  template <class ResultType, class T, class U>
+  inline bool isFftFilterFaster(int, int, const PiiMatrix<U>&, Pii::False)
+  {
+    return false;
+  }
+
+  /// @internal
+  template <class ResultType, class T, class U>
+  bool isFftFilterFaster(int imageRows, int imageColumns, const PiiMatrix<U>& filter, Pii::True)
+  {
+    const int iRows = filter.rows(), iColumns = filter.columns();
+    // Small filters are always faster to apply directly. Don't even
+    // count the coefficients.
+    if (iRows * iColumns < 64 || imageRows < iRows || imageColumns < iColumns)
+      return false;
+    int iNonZeroCount = 0;
+    for (int r=0; r<iRows; ++r)
+      {
+        const U* pRow = filter[r];
+        for (int c=0; c<iColumns; ++c)
+          if (pRow[c] != 0)
+            ++iNonZeroCount;
+      }
+    int iTileRows, iTileColumns;
+    return planFftFilter(imageRows, imageColumns, iRows, iColumns, iNonZeroCount,
+                         FilterKernel<ResultType,T,U>::isSupported(),
+                         &iTileRows, &iTileColumns);
+  }
+
+  template <class ResultType, class T, class U>
+  bool isFftFilterFaster(int imageRows, int imageColumns, const PiiMatrix<U>& filter)
+  {
+    return isFftFilterFaster<ResultType,T>(imageRows, imageColumns, filter,
+                                           Pii::And<Pii::IsFloatingPoint<ResultType>::boolValue,
+                                                    Pii::IsFloatingPoint<U>::boolValue,
+                                                    Pii::IsNumeric<T>::boolValue>());
+  }
+
+  /// @internal
+  template <class ResultType, class T, class U> class FilterValidPartStrip
+  {
+  public:
+    FilterValidPartStrip(const PiiMatrix<T>& image,
+                         const PiiMatrix<U>& filter,
+                         PiiMatrix<ResultType>& result) :
+      _image(image),
+      _filter(filter),
+      // Rows of the result are accessed through a raw pointer.
+      // PiiMatrix::row() would try to detach the matrix in every
+      // thread.
+      _pResult(reinterpret_cast<char*>(result.row(0))),
+      _iStride(result.stride()),
+      _iColumns(result.columns())
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      // An immutable reference to the input rows needed by this strip.
+      PiiMatrix<T> matInput(endRow - firstRow + _filter.rows() - 1, _image.columns(),
+                            _image.row(firstRow), _image.stride());
+      PiiMatrix<ResultType> matStrip(filterValidPart<ResultType>(matInput, _filter));
+      for (int r=firstRow; r<endRow; ++r)
+        memcpy(_pResult + r * _iStride, matStrip.row(r - firstRow), sizeof(ResultType) * _iColumns);
+    }
+
+  private:
+    const PiiMatrix<T>& _image;
+    const PiiMatrix<U>& _filter;
+    char* _pResult;
+    std::size_t _iStride;
+    int _iColumns;
+  };
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filterValidPart(const PiiMatrix<T>& image,
+                                        const PiiMatrix<U>& filter,
+                                        const PiiParallelPolicy& policy)
+  {
+    const int iRows = image.rows() - filter.rows() + 1,
+      iColumns = image.columns() - filter.columns() + 1;
+    if (iRows <= 0 || iColumns <= 0 || policy.stripCount(iRows) <= 1)
+      return filterValidPart<ResultType>(image, filter);
+
+    PiiMatrix<ResultType> matResult(PiiMatrix<ResultType>::uninitialized(iRows, iColumns));
+    FilterValidPartStrip<ResultType,T,U> strip(image, filter, matResult);
+    Pii::forEachStrip(iRows, strip, policy);
+    return matResult;
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
+                               const PiiMatrix<U>& filter,
+                               Pii::ExtendMode mode,
+                               const PiiParallelPolicy& policy)
+  {
+    if (policy.stripCount(image.rows()) <= 1)
+      return PiiImage::filter<ResultType>(image, filter, mode);
+
+    const int
+      rows = filter.rows() >> 1,
+      cols = filter.columns() >> 1,
+      top = mode == Pii::ExtendZeros ? (filter.rows() - 1) >> 1 : rows,
+      left = mode == Pii::ExtendZeros ? (filter.columns() - 1) >> 1 : cols;
+    return filterValidPart<ResultType>(Pii::extend(image, top, rows, left, cols, mode), filter, policy);
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
+                               const PiiMatrix<U>& horizontalFilter,
+                               const PiiMatrix<U>& verticalFilter,
+                               Pii::ExtendMode mode,
+                               const PiiParallelPolicy& policy)
+  {
+    if (horizontalFilter.rows() != 1 || verticalFilter.columns() != 1)
+      return PiiMatrix<ResultType>(image);
+    if (policy.stripCount(image.rows()) <= 1)
+      return PiiImage::filter<ResultType>(image, horizontalFilter, verticalFilter, mode);
+
+    const int
+      rows = verticalFilter.rows() >> 1,
+      cols = horizontalFilter.columns() >> 1,
+      top = mode == Pii::ExtendZeros ? (verticalFilter.rows() - 1) >> 1 : rows,
+      left = mode == Pii::ExtendZeros ? (horizontalFilter.columns() - 1) >> 1 : cols;
+    return filterValidPart<ResultType>(filterValidPart<ResultType>(Pii::extend(image, top, rows, left, cols, mode),
+                                                                   horizontalFilter, policy),
+                                       verticalFilter, policy);
+  }
+
+  template <class ResultType, class T>
+  PiiMatrix<ResultType> boxFilter(const PiiMatrix<T>& image,
+                                  int windowRows,
+                                  int windowColumns,
+                                  Pii::ExtendMode mode)
+  {
+    if (windowColumns <= 0)
+      windowColumns = windowRows;
+    if (windowRows <= 0)
+      return PiiMatrix<ResultType>(image);
+
+    // Pad the image the same way filter() does.
+    const int
+      bottom = windowRows >> 1,
+      right = windowColumns >> 1,
+      top = mode == Pii::ExtendZeros ? (windowRows - 1) >> 1 : bottom,
+      left = mode == Pii::ExtendZeros ? (windowColumns - 1) >> 1 : right;
+
+    // Integer sums are exact, floating-point ones need precision.
+    typedef typename Pii::IfClass<Pii::IsInteger<T>, long long, double>::Type SumType;
+    PiiIntegralImage<SumType> integral(Pii::extend(image, top, bottom, left, right, mode));
+
+    const int
+      iRows = integral.rows() - windowRows + 1,
+      iCols = integral.columns() - windowColumns + 1;
+    if (iRows <= 0 || iCols <= 0)
+      return PiiMatrix<ResultType>();
+
+    const double dCount = double(windowRows) * windowColumns;
+    PiiMatrix<ResultType> matResult(PiiMatrix<ResultType>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const SumType* pTopRow = integral.sumRow(r), *pBottomRow = integral.sumRow(r + windowRows);
+        ResultType* pTarget = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          pTarget[c] = ResultType(double(PiiIntegralImage<SumType>::sum(pTopRow, pBottomRow,
+                                                                          c, c + windowColumns)) / dCount);
+      }
+    return matResult;
   }
 
   template <class ResultType, class ImageType>
@@ -978,19 +1479,31 @@ namespace PiiImage
         }
       case GaussianFilter:
         {
-          // Separable, but must use doubles
-          typedef typename Pii::Combine<ImageType,double>::Type FilterType;
+          // Separable, but must use floating point. The filter can
+          // only be decomposed in double precision. If the result is
+          // float anyway, single precision is enough for filtering
+          // and allows a vectorized implementation.
+          typedef typename Pii::IfClass<Pii::IsSame<ResultType,float>, float, double>::Type RealType;
+          typedef typename Pii::Combine<ImageType,RealType>::Type FilterType;
           PiiMatrix<double> filter2D = makeFilter<double>(type, filterSize), hFilter, vFilter;
           separateFilter(filter2D, hFilter, vFilter);
-          return PiiMatrix<ResultType>(filter<FilterType>(image, hFilter, vFilter, mode));
+          return PiiMatrix<ResultType>(filter<FilterType>(image,
+                                                          PiiMatrix<RealType>(hFilter),
+                                                          PiiMatrix<RealType>(vFilter),
+                                                          mode));
         }
       case UniformFilter:
+        // Small kernels are faster to convolve directly.
+        if (filterSize > 5)
+          return boxFilter<ResultType>(image, filterSize, filterSize, mode);
+        // Fall through
       case LoGFilter:
       default:
         {
-          // Not separable, and must use doubles
-          typedef typename Pii::Combine<ImageType,double>::Type FilterType;
-          return PiiMatrix<ResultType>(filter<FilterType>(image, makeFilter<double>(type, filterSize), mode));
+          // Not separable, and must use floating point
+          typedef typename Pii::IfClass<Pii::IsSame<ResultType,float>, float, double>::Type RealType;
+          typedef typename Pii::Combine<ImageType,RealType>::Type FilterType;
+          return PiiMatrix<ResultType>(filter<FilterType>(image, makeFilter<RealType>(type, filterSize), mode));
         }
       }
   }
@@ -1081,40 +1594,9 @@ namespace PiiImage
                                             TransformedSize handling,
                                             T backgroundColor)
   {
-    int x = 0, y = 0;
-    float fX, fY;
-
-    int iMinX = Pii::Numeric<int>::maxValue(), iMinY = Pii::Numeric<int>::maxValue(),
-      iMaxX = Pii::Numeric<int>::minValue(), iMaxY = Pii::Numeric<int>::minValue();
-
-    if (handling == ExpandAsNecessary)
-      {
-#define PII_CHECK_EXTREMA_WITH_POINT \
-        transformHomogeneousPoint(transform, float(x), float(y), &fX, &fY); \
-        if (fX < iMinX) iMinX = int(floor(fX)); \
-        if (fX > iMaxX) iMaxX = int(ceil(fX)); \
-        if (fY < iMinY) iMinY = int(floor(fY)); \
-        if (fY > iMaxY) iMaxY = int(ceil(fY))
-        // Find extrema by transforming old corner coordinates.
-        // Origin first (initially, x and y are zeros)
-        PII_CHECK_EXTREMA_WITH_POINT;
-        // Top right
-        x = image.columns();
-        PII_CHECK_EXTREMA_WITH_POINT;
-        // Bottom right
-        y = image.rows();
-        PII_CHECK_EXTREMA_WITH_POINT;
-        // Bottom left
-        x = 0;
-        PII_CHECK_EXTREMA_WITH_POINT;
-#undef PII_CHECK_EXTREMA_WITH_POINT
-      }
-    else
-      {
-        iMinX = iMinY = 0;
-        iMaxX = image.columns()-1;
-        iMaxY = image.rows()-1;
-      }
+    int iMinX, iMinY, iMaxX, iMaxY;
+    transformedBounds(transform, image.rows(), image.columns(), handling,
+                      &iMinX, &iMinY, &iMaxX, &iMaxY);
 
     //qDebug("x: %d-%d, y: %d-%d", iMinX, iMaxX, iMinY, iMaxY);
     // Create the result matrix
@@ -1126,13 +1608,14 @@ namespace PiiImage
     PiiMatrix<float> matInverseTransform = Pii::inverse(transform);
 
     int lastX = image.columns()-1, lastY = image.rows()-1;
+    float fX, fY;
 
     // Loop through all pixels in the transformed domain
-    for (y=iMinY; y<=iMaxY; ++y)
+    for (int y=iMinY; y<=iMaxY; ++y)
       {
         // Row pointer is out of bound on purpose.
         T* pResultRow = result[y-iMinY] - iMinX;
-        for (x=iMinX; x<=iMaxX; ++x)
+        for (int x=iMinX; x<=iMaxX; ++x)
           {
             transformHomogeneousPoint(matInverseTransform, float(x), float(y), &fX, &fY);
             if (fX >= 0 && fX <= lastX &&
@@ -1143,38 +1626,456 @@ namespace PiiImage
     return result;
   }
 
+  /// @internal
+  template <class T, class G> class CannyGradientRows
+  {
+  public:
+    CannyGradientRows(const PiiMatrix<T>& image, Pii::ExtendMode mode) :
+      _image(image),
+      _mode(mode),
+      _iRows(image.rows()),
+      _iColumns(image.columns()),
+      _vecInput(3 * (_iColumns + 2)),
+      _vecGradients(9 * _iColumns),
+      _iNextInput(0),
+      _iNextGradient(0)
+    {}
+
+    /**
+     * Starts a new sequence of gradient rows at *firstRow*.
+     */
+    void start(int firstRow)
+    {
+      _iNextGradient = firstRow;
+      _iNextInput = firstRow - 1;
+    }
+
+    /**
+     * Calculates the gradients of all rows up to and including *row*.
+     * Only the three latest rows are retained.
+     */
+    void advance(int row)
+    {
+      for (; _iNextGradient <= row; ++_iNextGradient)
+        {
+          for (; _iNextInput <= _iNextGradient + 1; ++_iNextInput)
+            loadInput(_iNextInput);
+          calculate(_iNextGradient);
+        }
+    }
+
+    const G* gradientX(int row) const { return _vecGradients.constData() + (row % 3) * 3 * _iColumns; }
+    const G* gradientY(int row) const { return gradientX(row) + _iColumns; }
+    const G* magnitude(int row) const { return gradientX(row) + 2 * _iColumns; }
+
+  private:
+    // Extended input rows -1, ..., rows are cycled through three
+    // buffers, each one pixel wider than the image on both sides.
+    T* input(int row) { return _vecInput.data() + ((row + 3) % 3) * (_iColumns + 2); }
+
+    int sourceRow(int row) const
+    {
+      if (row >= 0 && row < _iRows)
+        return row;
+      switch (_mode)
+        {
+        case Pii::ExtendZeros: return -1;
+        case Pii::ExtendPeriodic: return row < 0 ? _iRows - 1 : 0;
+          // With a one-pixel border, symmetric extension replicates.
+        default: return row < 0 ? 0 : _iRows - 1;
+        }
+    }
+
+    void loadInput(int row)
+    {
+      T* pTarget = input(row);
+      const int iSource = sourceRow(row);
+      if (iSource < 0)
+        {
+          std::fill(pTarget, pTarget + _iColumns + 2, T(0));
+          return;
+        }
+      const T* pSource = _image.row(iSource);
+      std::copy(pSource, pSource + _iColumns, pTarget + 1);
+      switch (_mode)
+        {
+        case Pii::ExtendZeros:
+          pTarget[0] = pTarget[_iColumns + 1] = T(0);
+          break;
+        case Pii::ExtendPeriodic:
+          pTarget[0] = pSource[_iColumns - 1];
+          pTarget[_iColumns + 1] = pSource[0];
+          break;
+        default:
+          pTarget[0] = pSource[0];
+          pTarget[_iColumns + 1] = pSource[_iColumns - 1];
+          break;
+        }
+    }
+
+    void calculate(int row)
+    {
+      const T* pRow0 = input(row - 1), *pRow1 = input(row), *pRow2 = input(row + 1);
+      G* pX = _vecGradients.data() + (row % 3) * 3 * _iColumns, *pY = pX + _iColumns, *pMagnitude = pY + _iColumns;
+      if (SobelKernel<T,G>::gradient(pRow0, pRow1, pRow2, _iColumns, pX, pY, pMagnitude))
+        return;
+      // Same order of summation as in the vectorized kernels.
+      for (int c=0; c<_iColumns; ++c)
+        {
+          const G x = (G(pRow0[c+2]) - G(pRow0[c])) + G(2) * (G(pRow1[c+2]) - G(pRow1[c])) + (G(pRow2[c+2]) - G(pRow2[c]));
+          const G y = (G(pRow2[c]) + G(2) * G(pRow2[c+1]) + G(pRow2[c+2])) - (G(pRow0[c]) + G(2) * G(pRow0[c+1]) + G(pRow0[c+2]));
+          pX[c] = x;
+          pY[c] = y;
+          pMagnitude[c] = Pii::abs(x) + Pii::abs(y);
+        }
+    }
+
+    const PiiMatrix<T>& _image;
+    Pii::ExtendMode _mode;
+    int _iRows, _iColumns;
+    QVector<T> _vecInput;
+    QVector<G> _vecGradients;
+    int _iNextInput, _iNextGradient;
+  };
+
+  /// @internal
+  template <class T, class G> struct CannyStatisticsStrip
+  {
+    CannyStatisticsStrip(const PiiMatrix<T>& image, Pii::ExtendMode mode, int strips) :
+      matImage(image), mode(mode),
+      vecSums(strips), vecSquares(strips)
+    {}
+
+    int firstRow(int strip) const
+    {
+      return int(qint64(matImage.rows()) * strip / vecSums.size());
+    }
+
+    void operator() (int firstStrip, int endStrip)
+    {
+      const int iColumns = matImage.columns();
+      for (int i = firstStrip; i < endStrip; ++i)
+        {
+          CannyGradientRows<T,G> gradients(matImage, mode);
+          gradients.start(firstRow(i));
+          double dSum = 0, dSquares = 0;
+          for (int r = firstRow(i); r < firstRow(i+1); ++r)
+            {
+              gradients.advance(r);
+              const G* pMagnitude = gradients.magnitude(r);
+              for (int c=0; c<iColumns; ++c)
+                {
+                  const double dValue = double(pMagnitude[c]);
+                  dSum += dValue;
+                  dSquares += dValue * dValue;
+                }
+            }
+          vecSums[i] = dSum;
+          vecSquares[i] = dSquares;
+        }
+    }
+
+    const PiiMatrix<T>& matImage;
+    Pii::ExtendMode mode;
+    QVector<double> vecSums, vecSquares;
+  };
+
+  /// @internal
+  template <class T, class G> class CannyEdgeStrip
+  {
+  public:
+    CannyEdgeStrip(const PiiMatrix<T>& image, Pii::ExtendMode mode,
+                   G lowThreshold, G highThreshold, int strips,
+                   PiiMatrix<int>& edges, PiiMatrix<G>* magnitude, PiiMatrix<float>* direction) :
+      vecSeeds(strips),
+      _image(image),
+      _mode(mode),
+      _lowThreshold(lowThreshold),
+      _highThreshold(highThreshold),
+      _iRows(image.rows()),
+      _iColumns(image.columns()),
+      // Rows are accessed through raw pointers. PiiMatrix::row()
+      // would try to detach the matrices in every thread.
+      _pEdges(reinterpret_cast<char*>(edges.row(0))),
+      _iEdgeStride(edges.stride()),
+      _pMagnitude(magnitude != 0 ? reinterpret_cast<char*>(magnitude->row(0)) : 0),
+      _iMagnitudeStride(magnitude != 0 ? magnitude->stride() : 0),
+      _pDirection(direction != 0 ? reinterpret_cast<char*>(direction->row(0)) : 0),
+      _iDirectionStride(direction != 0 ? direction->stride() : 0)
+    {}
+
+    int firstRow(int strip) const
+    {
+      return int(qint64(_iRows) * strip / vecSeeds.size());
+    }
+
+    void operator() (int firstStrip, int endStrip)
+    {
+      for (int i = firstStrip; i < endStrip; ++i)
+        classify(firstRow(i), firstRow(i+1), vecSeeds[i]);
+    }
+
+    /// Linear indices of strong edge pixels in each strip.
+    QVector<QVector<int> > vecSeeds;
+
+  private:
+    void classify(int firstRow, int endRow, QVector<int>& seeds)
+    {
+      // Direction vectors for eight gradient angles
+      static const int directions[8][2] = { {1,0}, {1,1}, {0,1}, {-1,1},
+                                            {-1,0}, {-1,-1}, {0,-1}, {1,-1} };
+      RadiansToPoints<float> quantizer;
+      const int iLastRow = _iRows - 1, iLastColumn = _iColumns - 1;
+
+      // The neighbors of the first and last row of the strip are
+      // recalculated.
+      CannyGradientRows<T,G> gradients(_image, _mode);
+      gradients.start(qMax(firstRow - 1, 0));
+      for (int r=firstRow; r<endRow; ++r)
+        {
+          gradients.advance(qMin(r + 1, iLastRow));
+          const G* pX = gradients.gradientX(r), *pY = gradients.gradientY(r);
+          // Magnitudes of the previous, current and next row. The
+          // outermost ones exist only for inner rows.
+          const G* pMagnitudes[3] = { r > 0 ? gradients.magnitude(r - 1) : 0,
+                                      gradients.magnitude(r),
+                                      r < iLastRow ? gradients.magnitude(r + 1) : 0 };
+          const G* pCurrent = pMagnitudes[1];
+          int* pEdges = reinterpret_cast<int*>(_pEdges + r * _iEdgeStride);
+          if (_pMagnitude != 0)
+            std::copy(pCurrent, pCurrent + _iColumns, reinterpret_cast<G*>(_pMagnitude + r * _iMagnitudeStride));
+          float* pDirection = 0;
+          if (_pDirection != 0)
+            {
+              pDirection = reinterpret_cast<float*>(_pDirection + r * _iDirectionStride);
+              for (int c=0; c<_iColumns; ++c)
+                pDirection[c] = Pii::atan2(float(pY[c]), float(pX[c]));
+            }
+
+          const bool bInnerRow = r > 0 && r < iLastRow;
+          for (int c=0; c<_iColumns; ++c)
+            {
+              const G currentMag = pCurrent[c];
+              pEdges[c] = 0;
+              // Suppression can only lower the magnitude.
+              if (currentMag < _lowThreshold && _lowThreshold > 0)
+                continue;
+
+              G value(0);
+              const bool bInnerColumn = c > 0 && c < iLastColumn;
+              // Corners are never local maxima.
+              if (bInnerRow || bInnerColumn)
+                {
+                  const int iAngle = quantizer(pDirection != 0 ? pDirection[c] :
+                                               Pii::atan2(float(pY[c]), float(pX[c])));
+                  const int iDx = directions[iAngle][0], iDy = directions[iAngle][1];
+                  // Same rules as in suppressNonMaxima(). Only
+                  // horizontal gradients are accepted on the top and
+                  // bottom rows and vertical ones on the left and
+                  // right columns.
+                  if ((bInnerRow && bInnerColumn) ||
+                      (bInnerColumn && (iAngle & 3) == 0) ||
+                      (bInnerRow && (iAngle & 3) == 2))
+                    {
+                      if (pMagnitudes[1 + iDy][c + iDx] < currentMag &&
+                          pMagnitudes[1 - iDy][c - iDx] <= currentMag)
+                        value = currentMag;
+                    }
+                }
+
+              if (value >= _lowThreshold)
+                {
+                  if (value >= _highThreshold)
+                    {
+                      pEdges[c] = 1;
+                      seeds.append(r * _iColumns + c);
+                    }
+                  else
+                    pEdges[c] = -1;
+                }
+            }
+        }
+    }
+
+    const PiiMatrix<T>& _image;
+    Pii::ExtendMode _mode;
+    G _lowThreshold, _highThreshold;
+    int _iRows, _iColumns;
+    char* _pEdges;
+    std::size_t _iEdgeStride;
+    char* _pMagnitude;
+    std::size_t _iMagnitudeStride;
+    char* _pDirection;
+    std::size_t _iDirectionStride;
+  };
+
+  template <class T>
+  PiiMatrix<int> cannyEdges(const PiiMatrix<T>& image,
+                            typename EdgeGradient<T>::Type lowThreshold,
+                            typename EdgeGradient<T>::Type highThreshold,
+                            Pii::ExtendMode mode,
+                            const PiiParallelPolicy& policy,
+                            PiiMatrix<typename EdgeGradient<T>::Type>* magnitude,
+                            PiiMatrix<float>* direction)
+  {
+    typedef typename EdgeGradient<T>::Type G;
+    if (mode == Pii::ExtendNot)
+      PII_THROW(PiiInvalidArgumentException,
+                QCoreApplication::translate("PiiImage", "Canny edge detection requires the image to be extended."));
+
+    const int iRows = image.rows(), iColumns = image.columns();
+    if (magnitude != 0)
+      *magnitude = PiiMatrix<G>(PiiMatrix<G>::uninitialized(iRows, iColumns));
+    if (direction != 0)
+      *direction = PiiMatrix<float>(PiiMatrix<float>::uninitialized(iRows, iColumns));
+    if (iRows == 0 || iColumns == 0)
+      return PiiMatrix<int>(iRows, iColumns);
+
+    const int iStrips = policy.stripCount(iRows);
+    // Automatic threshold if not explicitly given
+    if (highThreshold == 0)
+      {
+        CannyStatisticsStrip<T,G> statistics(image, mode, iStrips);
+        Pii::forEachStrip(iStrips, statistics, PiiParallelPolicy(iStrips, 1));
+        double dSum = 0, dSquares = 0;
+        for (int i = 0; i < iStrips; ++i)
+          {
+            dSum += statistics.vecSums[i];
+            dSquares += statistics.vecSquares[i];
+          }
+        const double dPixels = double(iRows) * iColumns;
+        const double dMean = dSum / dPixels;
+        // Use the famous two-sigma rule (TM) as a threshold.
+        highThreshold = G(dMean + 2 * std::sqrt(qMax(dSquares / dPixels - dMean * dMean, 0.0)));
+      }
+    if (lowThreshold == 0)
+      lowThreshold = G(0.4 * highThreshold);
+
+    // Strong edges are marked with 1 and weak ones with -1.
+    PiiMatrix<int> matEdges(PiiMatrix<int>::uninitialized(iRows, iColumns));
+    CannyEdgeStrip<T,G> strip(image, mode, lowThreshold, highThreshold, iStrips,
+                              matEdges, magnitude, direction);
+    Pii::forEachStrip(iStrips, strip, PiiParallelPolicy(iStrips, 1));
+
+    // Trace weak edges 8-connected to strong ones.
+    for (int i = 0; i < iStrips; ++i)
+      {
+        QVector<int>& vecStack = strip.vecSeeds[i];
+        while (!vecStack.isEmpty())
+          {
+            const int iIndex = vecStack.back();
+            vecStack.pop_back();
+            const int r = iIndex / iColumns, c = iIndex % iColumns;
+            for (int iNeighborRow = qMax(r - 1, 0); iNeighborRow <= qMin(r + 1, iRows - 1); ++iNeighborRow)
+              {
+                int* pRow = matEdges.row(iNeighborRow);
+                for (int iNeighborColumn = qMax(c - 1, 0); iNeighborColumn <= qMin(c + 1, iColumns - 1); ++iNeighborColumn)
+                  if (pRow[iNeighborColumn] < 0)
+                    {
+                      pRow[iNeighborColumn] = 1;
+                      vecStack.append(iNeighborRow * iColumns + iNeighborColumn);
+                    }
+              }
+          }
+      }
+    // Drop the weak edges that weren't reached.
+    for (int r=0; r<iRows; ++r)
+      {
+        int* pRow = matEdges.row(r);
+        for (int c=0; c<iColumns; ++c)
+          if (pRow[c] < 0)
+            pRow[c] = 0;
+      }
+    return matEdges;
+  }
+
   template <class T> PiiMatrix<int> detectEdges(const PiiMatrix<T>& image,
                                                 int smoothWidth,
                                                 T lowThreshold, T highThreshold)
   {
+    typedef typename EdgeGradient<T>::Type G;
     // Filter the source image if necessary
     PiiMatrix<T> matSource(smoothWidth != 0 ?
                            filter<T>(image, GaussianFilter, Pii::ExtendReplicate, smoothWidth) :
                            image);
+    return cannyEdges(matSource, G(lowThreshold), G(highThreshold), Pii::ExtendZeros);
+  }
 
-    PiiMatrix<T> matGradientX = filter<T>(matSource, SobelXFilter, Pii::ExtendZeros);
-    PiiMatrix<T> matGradientY = filter<T>(matSource, SobelYFilter, Pii::ExtendZeros);
-    PiiMatrix<T> matMagnitude = gradientMagnitude(matGradientX, matGradientY);
+  /**
+   * FAST corners with a vectorized segment test and score. Scores
+   * are kept in a rolling buffer of three rows, and each corner is
+   * compared to its eight neighbors once the row below it has been
+   * scored. The result is the same as with fast_suppress_nonmax(): a
+   * corner is dropped if any of its neighbors has an equal or higher
+   * score.
+   *
+   * @internal
+   */
+  template <class T> PiiMatrix<int> detectFastCornersVectorized(const PiiMatrix<T>& image, T threshold)
+  {
+    const int iRows = image.rows(), iColumns = image.columns();
+    PiiMatrix<int> matCorners(0,2);
+    if (iRows < 7 || iColumns < 7)
+      return matCorners;
+    matCorners.reserve(512);
 
-    // Automatic threshold if not explicitly given
-    if (highThreshold == 0)
+    int pixel[16];
+    fast9_make_offsets<T>(pixel, image.stride());
+    QVector<uchar> vecFlags(iColumns);
+    uchar* pFlags = vecFlags.data();
+    // -1 marks pixels that are not corners.
+    QVector<int> vecScores(3 * iColumns, -1);
+    QVector<int> vecCornerColumns[3];
+
+    // One extra round to suppress non-maxima on the last row.
+    for (int y=3; y <= iRows - 3; ++y)
       {
-        // Use the famous two-sigma rule (TM) as a threshold.
-        float fMean = 0;
-        float fStd = Pii::std<float>(matMagnitude, &fMean);
-        highThreshold = T(fMean + fStd * 2);
-      }
-    if (lowThreshold == 0)
-      lowThreshold = T(0.4 * highThreshold);
+        int* pScores = vecScores.data() + (y % 3) * iColumns;
+        QVector<int>& vecColumns = vecCornerColumns[y % 3];
+        // Forget the row three rows up.
+        for (int i=0; i<vecColumns.size(); ++i)
+          pScores[vecColumns[i]] = -1;
+        vecColumns.clear();
+
+        if (y < iRows - 3)
+          {
+            const T* pRow = image[y];
+            FastCornerKernel<T>::segmentTest(pRow, int(image.stride()), iColumns, int(threshold), pFlags);
+            for (int x=3; x < iColumns - 3; ++x)
+              if (pFlags[x])
+                {
+                  vecColumns.append(x);
+                  pScores[x] = FastCornerKernel<T>::score(pRow + x, pixel);
+                }
+          }
 
-    return hysteresisThreshold(suppressNonMaxima(matMagnitude,
-                                                 gradientDirection(matGradientX, matGradientY),
-                                                 RadiansToPoints<float>()),
-                               lowThreshold, highThreshold);
+        const int iRow = y - 1;
+        if (iRow < 3)
+          continue;
+        const int* pAbove = vecScores.constData() + ((iRow - 1) % 3) * iColumns,
+          *pCurrent = vecScores.constData() + (iRow % 3) * iColumns,
+          *pBelow = pScores;
+        const QVector<int>& vecPrevious = vecCornerColumns[iRow % 3];
+        for (int i=0; i<vecPrevious.size(); ++i)
+          {
+            const int x = vecPrevious[i], iScore = pCurrent[x];
+            if (pCurrent[x-1] >= iScore || pCurrent[x+1] >= iScore ||
+                pAbove[x-1] >= iScore || pAbove[x] >= iScore || pAbove[x+1] >= iScore ||
+                pBelow[x-1] >= iScore || pBelow[x] >= iScore || pBelow[x+1] >= iScore)
+              continue;
+            int* pCorner = matCorners.appendRow();
+            pCorner[0] = x;
+            pCorner[1] = iRow;
+          }
+      }
+    return matCorners;
   }
 
   template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold)
   {
+    if (FastCornerKernel<T>::isSupported())
+      return detectFastCornersVectorized(image, threshold);
+
     int pixel[16];
     fast9_make_offsets<T>(pixel, image.stride());
 
@@ -1188,6 +2089,7 @@ namespace PiiImage
                                                  const PiiMatrix<PiiPoint<U> >& map)
   {
     const int iRows = map.rows(), iCols = map.columns();
+    const int iLastX = image.columns()-1, iLastY = image.rows()-1;
     PiiMatrix<T> matResult(iRows, iCols);
     for (int r=0; r<iRows; ++r)
       {
@@ -1196,8 +2098,8 @@ namespace PiiImage
         for (int c=0; c<iCols; ++c)
           {
             PiiPoint<U> pt = pMapRow[c];
-            if (pt.x >= 0 && pt.x < iCols &&
-                pt.y >= 0 && pt.y < iRows)
+            if (pt.x >= 0 && pt.x <= iLastX &&
+                pt.y >= 0 && pt.y <= iLastY)
               pResultRow[c] = T(Pii::valueAt(image, pt.y, pt.x));
           }
       }
@@ -1275,6 +2177,9 @@ namespace PiiImage
     const int iRows = image.rows(), iCols = image.columns();
     const int iResultRows = iRows/2, iResultCols = iCols/2;
     PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iResultRows, iResultCols));
+    if (HalvingKernel<T>::halve(image, matResult))
+      return matResult;
+
     typedef typename Pii::Combine<T,int>::Type U;
     for (int r=0; r<iResultRows; ++r)
       {
@@ -1283,9 +2188,10 @@ namespace PiiImage
         for (int c=0; c<iResultCols; ++c)
           {
             int c2 = c*2, c21 = c2+1;
+            // Same order of summation as in HalvingKernel.
             pResultRow[c] =
-              T((U(pSource1[c2]) + U(pSource1[c21]) +
-                 U(pSource2[c2]) + U(pSource2[c21])) / 4);
+              T(((U(pSource1[c2]) + U(pSource1[c21])) +
+                 (U(pSource2[c2]) + U(pSource2[c21]))) / 4);
           }
       }
     return matResult;
@@ -1322,6 +2228,83 @@ namespace PiiImage
     return matResult;
   }
 
+  /// @internal
+  template <class T> struct BlockSumPixel
+  {
+    typedef T Scalar;
+    enum { Channels = 1 };
+    static double sum(T value) { return double(value); }
+  };
+
+  /// @internal
+  template <class T> struct BlockSumPixel<PiiColor<T> >
+  {
+    typedef T Scalar;
+    enum { Channels = 3 };
+    static double sum(const PiiColor<T>& clr) { return double(clr.c0) + double(clr.c1) + double(clr.c2); }
+  };
+
+  /// @internal
+  template <class T> struct BlockSumPixel<PiiColor4<T> >
+  {
+    typedef T Scalar;
+    enum { Channels = 4 };
+    static double sum(const PiiColor4<T>& clr)
+    {
+      return double(clr.c0) + double(clr.c1) + double(clr.c2) + double(clr.c3);
+    }
+  };
+
+  template <class T> PiiMatrix<double> blockSums(const PiiMatrix<T>& image, int gridRows, int gridColumns)
+  {
+    typedef BlockSumPixel<T> Pixel;
+    typedef typename Pixel::Scalar Scalar;
+    const int iRows = image.rows(), iCols = image.columns();
+    gridRows = qBound(1, gridRows, qMax(iRows, 1));
+    gridColumns = qBound(1, gridColumns, qMax(iCols, 1));
+    PiiMatrix<double> matSums(gridRows, gridColumns);
+    if (iRows == 0 || iCols == 0)
+      return matSums;
+
+    // Block boundaries are given to the kernel in channels.
+    QVector<int> vecEnds(gridColumns);
+    for (int b=0; b<gridColumns; ++b)
+      vecEnds[b] = int(qint64(b+1) * iCols / gridColumns) * Pixel::Channels;
+    // Color channels must be packed to be summed as a scalar row.
+    const bool bPacked = sizeof(T) == sizeof(Scalar) * Pixel::Channels;
+    QVector<unsigned int> vecRowSums(gridColumns, 0);
+
+    for (int gr=0; gr<gridRows; ++gr)
+      {
+        double* pSums = matSums[gr];
+        const int iLastRow = int(qint64(gr+1) * iRows / gridRows);
+        for (int r = int(qint64(gr) * iRows / gridRows); r<iLastRow; ++r)
+          {
+            const T* pRow = image[r];
+            // The kernel sums one row at a time to prevent overflows.
+            if (bPacked &&
+                BlockSumKernel<Scalar>::sumRow(reinterpret_cast<const Scalar*>(pRow),
+                                               vecEnds.constData(), gridColumns, vecRowSums.data()))
+              {
+                for (int b=0; b<gridColumns; ++b)
+                  {
+                    pSums[b] += vecRowSums[b];
+                    vecRowSums[b] = 0;
+                  }
+                continue;
+              }
+            for (int b=0, c=0; b<gridColumns; ++b)
+              {
+                double dSum = 0;
+                for (const int iEnd = vecEnds[b] / Pixel::Channels; c<iEnd; ++c)
+                  dSum += Pixel::sum(pRow[c]);
+                pSums[b] += dSum;
+              }
+          }
+      }
+    return matSums;
+  }
+
   template <class Matrix, class BinaryFunction>
   void fastGradient(const Matrix& input,
                     BinaryFunction function,
@@ -14,7 +14,14 @@
  */
 
 #include "PiiImage.h"
+#include "PiiSlidingHistogram.h"
 #include <PiiMatrixUtil.h>
+#include <PiiCpu.h>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace PiiImage
 {
@@ -150,27 +157,9 @@ namespace PiiImage
     if (nonZeroSums(iVSum, dVSum))
       dVScale = double(iVSum) / dVSum;
 
-    if (mode == Pii::ExtendZeros)
-      {
-        PiiMatrix<int> filtered = PiiDsp::filter<int>(PiiDsp::filter<int>(image,
-                                                                          horizontalIntegerFilter,
-                                                                          PiiDsp::FilterOriginalSize),
-                                                      verticalIntegerFilter,
-                                                      PiiDsp::FilterOriginalSize);
-        // Readable? Not. Scales each element as doubles and rounds
-        // the result to an int.
-        filtered.map(Pii::unaryCompose(Pii::Round<double,int>(),
-                                       std::bind2nd(std::multiplies<double>(),
-                                                    1.0/(dVScale*dHScale))));
-        return filtered;
-      }
-
-    const int rows = verticalFilter.rows() >> 1, cols = horizontalFilter.columns() >> 1;
-    PiiMatrix<int> filtered = PiiDsp::filter<int>(PiiDsp::filter<int>(Pii::extend(image, rows, rows, cols, cols, mode),
-                                                                      horizontalIntegerFilter,
-                                                                      PiiDsp::FilterValidPart),
-                                                  verticalIntegerFilter, PiiDsp::FilterValidPart);
-    // Scale back, see above
+    PiiMatrix<int> filtered = filter<int>(image, horizontalIntegerFilter, verticalIntegerFilter, mode);
+    // Readable? Not. Scales each element as doubles and rounds the
+    // result to an int.
     filtered.map(Pii::unaryCompose(Pii::Round<double,int>(),
                                    std::bind2nd(std::multiplies<double>(),
                                                 1.0/(dVScale*dHScale))));
@@ -194,6 +183,50 @@ namespace PiiImage
       createTranslationTransform(-centerX, -centerY);
   }
 
+  void transformedBounds(const PiiMatrix<float>& transform,
+                         int rows, int columns,
+                         TransformedSize handling,
+                         int* minX, int* minY,
+                         int* maxX, int* maxY)
+  {
+    if (handling != ExpandAsNecessary)
+      {
+        *minX = *minY = 0;
+        *maxX = columns-1;
+        *maxY = rows-1;
+        return;
+      }
+
+    int x = 0, y = 0;
+    float fX, fY;
+
+    int iMinX = Pii::Numeric<int>::maxValue(), iMinY = Pii::Numeric<int>::maxValue(),
+      iMaxX = Pii::Numeric<int>::minValue(), iMaxY = Pii::Numeric<int>::minValue();
+
+#define PII_CHECK_EXTREMA_WITH_POINT \
+    transformHomogeneousPoint(transform, float(x), float(y), &fX, &fY); \
+    if (fX < iMinX) iMinX = int(floor(fX)); \
+    if (fX > iMaxX) iMaxX = int(ceil(fX)); \
+    if (fY < iMinY) iMinY = int(floor(fY)); \
+    if (fY > iMaxY) iMaxY = int(ceil(fY))
+    // Find extrema by transforming old corner coordinates.
+    // Origin first (initially, x and y are zeros)
+    PII_CHECK_EXTREMA_WITH_POINT;
+    // Top right
+    x = columns;
+    PII_CHECK_EXTREMA_WITH_POINT;
+    // Bottom right
+    y = rows;
+    PII_CHECK_EXTREMA_WITH_POINT;
+    // Bottom left
+    x = 0;
+    PII_CHECK_EXTREMA_WITH_POINT;
+#undef PII_CHECK_EXTREMA_WITH_POINT
+
+    *minX = iMinX; *minY = iMinY;
+    *maxX = iMaxX; *maxY = iMaxY;
+  }
+
   PiiMatrix<float> createShearingTransform(float shearX, float shearY)
   {
     return PiiMatrix<float>(3,3,
@@ -218,11 +251,88 @@ namespace PiiImage
                             0.0, 0.0, 1.0);
   }
 
+  namespace
+  {
+    // Keys' cubic convolution kernel with a = -0.5.
+    inline double cubicWeight(double x)
+    {
+      x = Pii::abs(x);
+      if (x < 1)
+        return (1.5 * x - 2.5) * x * x + 1;
+      if (x < 2)
+        return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+      return 0;
+    }
+  }
+
+  ResampleTable::ResampleTable(int sourceSize, int targetSize, Pii::Interpolation interpolation) :
+    iTaps(1),
+    vecFirst(targetSize)
+  {
+    if (sourceSize == targetSize)
+      {
+        for (int i=0; i<targetSize; ++i)
+          vecFirst[i] = i;
+        vecWeights.fill(1, targetSize);
+        return;
+      }
+
+    const double dScale = double(sourceSize) / targetSize;
+    if (interpolation == Pii::AreaInterpolation)
+      {
+        // Target sample i covers [i*dScale, (i+1)*dScale) of the
+        // source. Each source sample is weighted by its share of
+        // the interval.
+        iTaps = qMin(int(std::ceil(dScale)) + 1, sourceSize);
+        vecWeights.fill(0, targetSize * iTaps);
+        for (int i=0; i<targetSize; ++i)
+          {
+            const double dStart = i * dScale, dEnd = qMin((i+1) * dScale, double(sourceSize));
+            const int iFirst = qMin(int(dStart), sourceSize - iTaps);
+            float* pWeights = vecWeights.data() + i * iTaps;
+            vecFirst[i] = iFirst;
+            for (int j=int(dStart); j < dEnd; ++j)
+              pWeights[j - iFirst] = float((qMin(dEnd, j + 1.0) - qMax(dStart, double(j))) / (dEnd - dStart));
+          }
+      }
+    else
+      {
+        // Reduction stretches the kernel over dScale source samples
+        // per target sample. Samples beyond the ends of the signal
+        // are replaced by the end samples. Their weights are added to
+        // those of the end samples, which keeps the window within the
+        // signal.
+        const double dStretch = qMax(dScale, 1.0), dSupport = 2 * dStretch;
+        const int iKernelSize = int(std::ceil(2 * dSupport));
+        iTaps = qMin(iKernelSize, sourceSize);
+        vecWeights.resize(targetSize * iTaps);
+        std::vector<double> vecAccumulated(iTaps);
+        for (int i=0; i<targetSize; ++i)
+          {
+            const double dCenter = (i + 0.5) * dScale - 0.5;
+            const int iStart = int(std::floor(dCenter - dSupport)) + 1;
+            const int iFirst = qBound(0, iStart, sourceSize - iTaps);
+            float* pWeights = vecWeights.data() + i * iTaps;
+            vecFirst[i] = iFirst;
+            double dSum = 0;
+            std::fill(vecAccumulated.begin(), vecAccumulated.end(), 0.0);
+            for (int j=iStart; j<iStart + iKernelSize; ++j)
+              {
+                const double dWeight = cubicWeight((j - dCenter) / dStretch);
+                vecAccumulated[qBound(0, j, sourceSize-1) - iFirst] += dWeight;
+                dSum += dWeight;
+              }
+            for (int k=0; k<iTaps; ++k)
+              pWeights[k] = float(vecAccumulated[k] / dSum);
+          }
+      }
+  }
+
   PiiMatrix<bool> createRoiMask(int rows, int columns,
                                 const PiiMatrix<int>& rectangles)
   {
     PiiMatrix<bool> result(rows, columns);
-    for (int r=0; r<rows; ++r)
+    for (int r=0; r<rectangles.rows(); ++r)
       {
         const PiiRectangle<int>& rect = rectangles.rowAs<PiiRectangle<int> >(r);
         if (rect.x >=0 && rect.x < columns &&
@@ -264,4 +374,306 @@ namespace PiiImage
       }
     return matMask;
   }
+
+  namespace
+  {
+    struct RankFunction
+    {
+      RankFunction(PiiMatrix<uchar>& result, int rank) :
+        matResult(result), iRank(rank)
+      {}
+
+      void operator() (int r, int c, PiiSlidingHistogram& histogram)
+      {
+        matResult(r,c) = uchar(histogram.rankValue(iRank));
+      }
+
+      PiiMatrix<uchar>& matResult;
+      int iRank;
+    };
+
+    bool rankFilter(const PiiMatrix<uchar>& image,
+                    int windowRows, int windowColumns, int rank,
+                    PiiMatrix<uchar>& result)
+    {
+      const int iRows = image.rows() - windowRows + 1,
+        iCols = image.columns() - windowColumns + 1;
+      if (iRows <= 0 || iCols <= 0)
+        return false;
+      PiiMatrix<uchar> matResult(PiiMatrix<uchar>::uninitialized(iRows, iCols));
+      RankFunction function(matResult, rank);
+      PiiSlidingHistogram histogram(256);
+      if (!histogram.scan(image, windowRows, windowColumns, function))
+        return false;
+      result = matResult;
+      return true;
+    }
+  }
+
+  bool histogramMedianFilter(const PiiMatrix<uchar>& image,
+                             int windowRows, int windowColumns,
+                             PiiMatrix<uchar>& result)
+  {
+    if (windowRows * windowColumns < MinHistogramMedianArea)
+      return false;
+    // The median is the smallest value whose cumulative frequency
+    // reaches this rank. Pii::medianN() uses the same definition.
+    return rankFilter(image, windowRows, windowColumns,
+                      (windowRows * windowColumns + 1) / 2,
+                      result);
+  }
+
+  PiiMatrix<uchar> percentileFilter(const PiiMatrix<uchar>& image,
+                                    double percentile,
+                                    int windowRows, int windowColumns,
+                                    Pii::ExtendMode mode)
+  {
+    if (windowColumns <= 0) windowColumns = windowRows;
+    windowRows = qBound(1, windowRows, image.rows());
+    windowColumns = qBound(1, windowColumns, image.columns());
+    const int iRows = windowRows / 2, iCols = windowColumns / 2;
+    const int iRank = qMax(1, int(std::ceil(percentile * windowRows * windowColumns)));
+
+    PiiMatrix<uchar> matResult;
+    if (!rankFilter(Pii::extend(image, iRows, iRows, iCols, iCols, mode),
+                    windowRows, windowColumns, iRank,
+                    matResult))
+      return PiiMatrix<uchar>();
+    if (mode != Pii::ExtendNot)
+      return matResult(0, 0, image.rows(), image.columns());
+    return matResult;
+  }
+
+  namespace
+  {
+    // Relative costs of the operations in planFftFilter(), in the
+    // time it takes to apply one filter coefficient to one pixel
+    // without vector instructions. Measured with float images.
+    const double dVectorTapCost = 0.08;
+    const double dFftCost = 0.4; // per element and log2(elements)
+    const double dTileCost = 2.0; // copying and multiplying, per element
+
+    // Tiles larger than this in either direction don't fit into
+    // cache any more.
+    const int iMaxTileSize = 1024;
+
+    // Tile lengths are powers of two, possibly multiplied by three
+    // or five. Returns the relative cost of a transform, which is
+    // higher for lengths that need radix-3 or radix-5 stages.
+    double transformCost(int length)
+    {
+      while (length % 2 == 0) length /= 2;
+      return length == 1 ? 1.0 : 1.8;
+    }
+
+    // Lengths that are at least filterLength and don't exceed the
+    // first length that covers the whole image.
+    QVector<int> tileLengths(int filterLength, int imageLength)
+    {
+      QVector<int> vecLengths;
+      for (int iPower = 8; iPower <= iMaxTileSize; iPower *= 2)
+        for (int i=0; i<3; ++i)
+          {
+            static const int aMultipliers[] = { 4, 5, 6 };
+            const int iLength = iPower * aMultipliers[i] / 4;
+            if (iLength < filterLength || iLength > iMaxTileSize)
+              continue;
+            vecLengths.append(iLength);
+            if (iLength >= imageLength)
+              return vecLengths;
+          }
+      return vecLengths;
+    }
+  }
+
+  bool planFftFilter(int imageRows, int imageColumns,
+                     int filterRows, int filterColumns,
+                     int nonZeroCount, bool vectorized,
+                     int* tileRows, int* tileColumns)
+  {
+    *tileRows = filterRows;
+    *tileColumns = filterColumns;
+    const int
+      iRows = imageRows - filterRows + 1,
+      iColumns = imageColumns - filterColumns + 1;
+    if (iRows <= 0 || iColumns <= 0)
+      return false;
+
+    const QVector<int>
+      vecRowLengths(tileLengths(filterRows, imageRows)),
+      vecColumnLengths(tileLengths(filterColumns, imageColumns));
+    double dBestCost = -1;
+    for (int i=0; i<vecRowLengths.size(); ++i)
+      {
+        const int iTileRows = vecRowLengths[i], iValidRows = iTileRows - filterRows + 1;
+        const double dTilesDown = (iRows + iValidRows - 1) / iValidRows;
+        for (int j=0; j<vecColumnLengths.size(); ++j)
+          {
+            const int iTileColumns = vecColumnLengths[j], iValidColumns = iTileColumns - filterColumns + 1;
+            const double
+              dTilesAcross = (iColumns + iValidColumns - 1) / iValidColumns,
+              dArea = double(iTileRows) * iTileColumns,
+              // Forward and inverse transform per tile, plus the
+              // transform of the filter.
+              dCost = (2 * dTilesDown * dTilesAcross + 1) * dArea *
+                      (dFftCost * std::log(dArea) / std::log(2.0) *
+                       (transformCost(iTileRows) + transformCost(iTileColumns)) / 2 +
+                       dTileCost);
+            if (dBestCost < 0 || dCost < dBestCost)
+              {
+                dBestCost = dCost;
+                *tileRows = iTileRows;
+                *tileColumns = iTileColumns;
+              }
+          }
+      }
+    const double dDirectCost = double(iRows) * iColumns * nonZeroCount *
+      (vectorized ? dVectorTapCost : 1.0);
+    return dBestCost >= 0 && dBestCost < dDirectCost;
+  }
+
+  namespace
+  {
+    /* Counts the differing pixels between *rows* rows of shifted
+       image words and the template. The summation is stopped once
+       the count reaches *limit*. With the popcnt target, the compiler
+       turns Pii::countBits() into a single instruction. All CPUs with
+       AVX2 have it.
+     */
+#define PII_XOR_DISTANCE(TARGET, NAME)                                  \
+    TARGET int NAME(const PiiMatrix<quint64>& shifted, const PiiBitMatrix& templ, \
+                    int row, int limit)                                 \
+    {                                                                   \
+      const int iWords = templ.wordsPerRow();                           \
+      int iSum = 0;                                                     \
+      for (int i=0; i<templ.rows() && iSum < limit; ++i)                \
+        {                                                               \
+          const quint64* pImage = shifted[row+i], *pTempl = templ.row(i); \
+          for (int w=0; w<iWords; ++w)                                  \
+            iSum += Pii::countBits(pImage[w] ^ pTempl[w]);              \
+        }                                                               \
+      return iSum;                                                      \
+    }
+
+    PII_XOR_DISTANCE(static, xorDistance)
+#if defined(PII_X86) && defined(__GNUC__)
+#  define PII_XOR_POPCNT 1
+    PII_XOR_DISTANCE(PII_TARGET("popcnt") static, xorDistancePopcnt)
+#endif
+#undef PII_XOR_DISTANCE
+
+    /* Slides a binary template over a binary image. For each column
+       offset, the image rows are shifted so that the template's
+       columns start at bit zero, after which the template can be
+       compared word by word at every row offset.
+     */
+    class XorSlider
+    {
+    public:
+      XorSlider(const PiiBitMatrix& image, const PiiBitMatrix& templ) :
+        _image(image),
+        _templ(templ),
+        _iTemplWords(templ.wordsPerRow()),
+        _iTailMask(templ.columns() & 63 ? (quint64(1) << (templ.columns() & 63)) - 1 : ~quint64(0)),
+        _matShifted(PiiMatrix<quint64>::uninitialized(image.rows(), templ.wordsPerRow())),
+        _bPopcnt(Pii::hasCpuFeature(Pii::CpuAvx2))
+      {}
+
+      void shift(int column)
+      {
+        const int iImageWords = _image.wordsPerRow(), iFirst = column >> 6, iShift = column & 63;
+        for (int r=0; r<_image.rows(); ++r)
+          {
+            const quint64* pSource = _image.row(r) + iFirst;
+            quint64* pTarget = _matShifted[r];
+            // The template never extends beyond the image, so the
+            // first word is always valid.
+            for (int w=0; w<_iTemplWords; ++w)
+              {
+                quint64 iWord = pSource[w] >> iShift;
+                if (iShift != 0 && iFirst + w + 1 < iImageWords)
+                  iWord |= pSource[w+1] << (64 - iShift);
+                pTarget[w] = iWord;
+              }
+            pTarget[_iTemplWords-1] &= _iTailMask;
+          }
+      }
+
+      // Counts the differing pixels with the template at (row, the
+      // last shifted column). Stops once the count reaches *limit*.
+      int distance(int row, int limit) const
+      {
+#ifdef PII_XOR_POPCNT
+        if (_bPopcnt)
+          return xorDistancePopcnt(_matShifted, _templ, row, limit);
+#endif
+        return xorDistance(_matShifted, _templ, row, limit);
+      }
+
+    private:
+      const PiiBitMatrix& _image;
+      const PiiBitMatrix& _templ;
+      const int _iTemplWords;
+      const quint64 _iTailMask;
+      PiiMatrix<quint64> _matShifted;
+      const bool _bPopcnt;
+    };
+  }
+
+  double xorMatch(const PiiBitMatrix& image, const PiiBitMatrix& templ, int* row, int* column)
+  {
+    const int
+      iResultRows = image.rows() - templ.rows() + 1,
+      iResultCols = image.columns() - templ.columns() + 1;
+
+    if (row != 0) *row = -1;
+    if (column != 0) *column = -1;
+    if (iResultRows <= 0 || iResultCols <= 0 || templ.isEmpty())
+      return 0;
+
+    const int iMaskSize = templ.rows() * templ.columns();
+    int iMinSum = iMaskSize + 1;
+    XorSlider slider(image, templ);
+    for (int c=0; c<iResultCols && iMinSum > 0; ++c)
+      {
+        slider.shift(c);
+        for (int r=0; r<iResultRows; ++r)
+          {
+            const int iSum = slider.distance(r, iMinSum);
+            if (iSum < iMinSum)
+              {
+                iMinSum = iSum;
+                if (row != 0) *row = r;
+                if (column != 0) *column = c;
+                if (iMinSum == 0)
+                  break;
+              }
+          }
+      }
+
+    return 1.0 - double(iMinSum) / iMaskSize;
+  }
+
+  PiiMatrix<int> xorDistances(const PiiBitMatrix& image, const PiiBitMatrix& templ)
+  {
+    const int
+      iResultRows = image.rows() - templ.rows() + 1,
+      iResultCols = image.columns() - templ.columns() + 1;
+
+    if (iResultRows <= 0 || iResultCols <= 0)
+      return PiiMatrix<int>();
+    if (templ.isEmpty())
+      return PiiMatrix<int>(iResultRows, iResultCols);
+
+    PiiMatrix<int> matResult(PiiMatrix<int>::uninitialized(iResultRows, iResultCols));
+    const int iLimit = templ.rows() * templ.columns() + 1;
+    XorSlider slider(image, templ);
+    for (int c=0; c<iResultCols; ++c)
+      {
+        slider.shift(c);
+        for (int r=0; r<iResultRows; ++r)
+          matResult(r,c) = slider.distance(r, iLimit);
+      }
+    return matResult;
+  }
 }
@@ -17,11 +17,18 @@
 #define _PIIIMAGE_H
 
 #include "PiiImageGlobal.h"
+#include "PiiFilterKernels.h"
+#include "PiiIntegralImage.h"
+#include "PiiRunLengthRoi.h"
 #include <PiiMath.h>
 #include <PiiMatrixUtil.h>
+#include <PiiBitMatrix.h>
+#include <PiiParallel.h>
 #include <PiiDsp.h>
+#include <PiiFft.h>
 #include <PiiColor.h>
 #include <PiiPoint.h>
+#include <QVector>
 
 /**
  * Definitions and functions for image processing.
@@ -53,6 +60,21 @@ namespace PiiImage
     inline bool operator() (int r, int c) const { Q_UNUSED(r); Q_UNUSED(c); return true; }
   };
 
+  /**
+   * Restricts the column range [*first*, *end*) on *row* to the
+   * columns where *roi* may contain pixels. Returns `false` if the
+   * row can be skipped altogether. Algorithms call this function
+   * once per row before testing individual pixels with the ROI
+   * functor. The generic version doesn't know anything about the
+   * ROI and returns `first < end`. See RunLengthRoi for an overload
+   * that actually restricts the range.
+   */
+  template <class Roi> inline bool clipToRoi(const Roi& roi, int row, int& first, int& end)
+  {
+    Q_UNUSED(roi); Q_UNUSED(row);
+    return first < end;
+  }
+
   /**
    * A region-of-interest function object that returns `true` if the
    * alpha channel has a non-zero value at (r,c) and `false`
@@ -471,11 +493,196 @@ namespace PiiImage
    *
    * @return a binary image in which detected edges are ones and other
    * pixels zeros.
+   *
+   * @see cannyEdges()
    */
   template <class T> PiiMatrix<int> detectEdges(const PiiMatrix<T>& image,
                                                 int smoothWidth = 0,
                                                 T lowThreshold = 0, T highThreshold = 0);
 
+  /**
+   * The type of the gradients calculated by [cannyEdges()]: `int`
+   * for integer images and the pixel type itself for floating-point
+   * images.
+   */
+  template <class T> struct EdgeGradient
+  {
+    typedef typename Pii::IfClass<Pii::IsFloatingPoint<T>, T, int>::Type Type;
+  };
+
+  /**
+   * Detect edges in a gray-level image with the Canny edge detector
+   * without creating full-size intermediate images. The result is the
+   * same as that of
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> gradientX = filter<int>(image, SobelXFilter, mode),
+   *   gradientY = filter<int>(image, SobelYFilter, mode);
+   * hysteresisThreshold(suppressNonMaxima(gradientMagnitude(gradientX, gradientY),
+   *                                       gradientDirection(gradientX, gradientY),
+   *                                       RadiansToPoints<float>()),
+   *                     lowThreshold, highThreshold);
+   * ~~~
+   *
+   * The gradients, their magnitude and direction and the suppressed
+   * magnitude are calculated a row at a time into a rolling buffer of
+   * three rows. Each pixel is classified as a strong edge, a weak edge
+   * or background, and the weak edges connected to strong ones are
+   * finally traced in the result. The gradient of `uchar` and `float`
+   * images is calculated with vector instructions if the CPU supports
+   * them.
+   *
+   * @param image a gray-level image in which edges are to be found
+   *
+   * @param lowThreshold the low threshold value for hysteresis
+   * thresholding. If zero, 0.4 * *highThreshold* will be used.
+   *
+   * @param highThreshold the high threshold value for hysteresis
+   * thresholding. If zero, mean+2*std of the gradient magnitude will
+   * be used. This requires an additional pass over the image.
+   *
+   * @param mode the way image borders are extended. `ExtendNot` is
+   * not supported.
+   *
+   * @param policy the strips of the image are classified in parallel
+   * as determined by *policy*. Tracing the edges is sequential.
+   *
+   * @param magnitude if non-zero, the gradient magnitude (|gx|+|gy|)
+   * will be stored here.
+   *
+   * @param direction if non-zero, the gradient direction (see
+   * [gradientDirection()]) will be stored here.
+   *
+   * @return a binary image in which detected edges are ones and other
+   * pixels zeros.
+   *
+   * @exception PiiInvalidArgumentException& if *mode* is
+   * `ExtendNot`.
+   */
+  template <class T>
+  PiiMatrix<int> cannyEdges(const PiiMatrix<T>& image,
+                            typename EdgeGradient<T>::Type lowThreshold = 0,
+                            typename EdgeGradient<T>::Type highThreshold = 0,
+                            Pii::ExtendMode mode = Pii::ExtendZeros,
+                            const PiiParallelPolicy& policy = PiiParallelPolicy::sequential(),
+                            PiiMatrix<typename EdgeGradient<T>::Type>* magnitude = 0,
+                            PiiMatrix<float>* direction = 0);
+
+  /**
+   * Estimates whether the valid part of the correlation of an image
+   * and a filter is faster to calculate in the frequency domain
+   * ([fftFilterValidPart()]) than directly, and selects a tile size
+   * for the frequency-domain version.
+   *
+   * The cost of direct filtering is proportional to the number of
+   * output pixels times the number of non-zero filter coefficients.
+   * The cost of the frequency-domain version is that of a forward
+   * and an inverse transform per tile. The tile size is selected
+   * among the lengths PiiFft handles efficiently (products of 2, 3
+   * and 5) so that the total cost is minimized.
+   *
+   * @param imageRows the number of rows in the (extended) input image
+   *
+   * @param imageColumns the number of columns in the input image
+   *
+   * @param filterRows the number of rows in the filter
+   *
+   * @param filterColumns the number of columns in the filter
+   *
+   * @param nonZeroCount the number of non-zero coefficients in the
+   * filter
+   *
+   * @param vectorized `true` if direct filtering would use a vector
+   * [FilterKernel]
+   *
+   * @param tileRows return value: the best number of rows in a tile
+   *
+   * @param tileColumns return value: the best number of columns in a
+   * tile
+   *
+   * @return `true` if the frequency-domain version is expected to be
+   * faster, `false` otherwise. The tile size is returned in both
+   * cases.
+   */
+  PII_IMAGE_EXPORT bool planFftFilter(int imageRows, int imageColumns,
+                                      int filterRows, int filterColumns,
+                                      int nonZeroCount, bool vectorized,
+                                      int* tileRows, int* tileColumns);
+
+  /**
+   * Calculates the valid part of the correlation of *image* and
+   * *filter* in the frequency domain using the overlap-save method.
+   * The image is divided into overlapping tiles, each of which is
+   * transformed with PiiFft, multiplied by the conjugate of the
+   * spectrum of the zero-padded filter and transformed back. Each
+   * tile produces `tileRows - filter.rows() + 1` rows and `tileColumns
+   * - filter.columns() + 1` columns of the result.
+   *
+   * The result is equal to that of PiiDsp::filter() with
+   * `PiiDsp::FilterValidPart` up to rounding errors. The transforms
+   * are calculated in single precision if *ResultType* is `float`,
+   * and in double precision otherwise. Complex images and filters
+   * are not supported.
+   *
+   * @param image the input image
+   *
+   * @param filter the filter
+   *
+   * @param tileRows the number of rows in a tile. If zero or
+   * negative, the tile size will be selected with [planFftFilter()].
+   * Values smaller than `filter.rows()` are increased.
+   *
+   * @param tileColumns the number of columns in a tile
+   *
+   * ~~~(c++)
+   * // Large kernels are much faster in the frequency domain.
+   * PiiMatrix<float> matBlurred = PiiImage::fftFilterValidPart<float>(image, PiiImage::makeGaussian(63));
+   * ~~~
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> fftFilterValidPart(const PiiMatrix<T>& image,
+                                           const PiiMatrix<U>& filter,
+                                           int tileRows = 0,
+                                           int tileColumns = 0);
+
+  /// @internal
+  template <class ResultType, class T, class U>
+  bool isFftFilterFaster(int imageRows, int imageColumns,
+                         const PiiMatrix<U>& filter);
+
+  /**
+   * Calculates the valid part of the correlation of *image* and
+   * *filter*. This is equivalent to PiiDsp::filter() with
+   * `PiiDsp::FilterValidPart`, but uses a vectorized [FilterKernel]
+   * if one exists for the given types. If *ResultType* and the
+   * filter are real floating-point types and [planFftFilter()]
+   * predicts that the frequency domain is faster, the result will
+   * be calculated with [fftFilterValidPart()] instead. This
+   * typically happens with filters larger than about 15-by-15.
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filterValidPart(const PiiMatrix<T>& image,
+                                        const PiiMatrix<U>& filter)
+  {
+    if (isFftFilterFaster<ResultType,T>(image.rows(), image.columns(), filter))
+      return fftFilterValidPart<ResultType>(image, filter);
+    PiiMatrix<ResultType> matResult;
+    if (FilterKernel<ResultType,T,U>::filter(image, filter, matResult))
+      return matResult;
+    return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterValidPart);
+  }
+
+  /**
+   * Calculates the valid part of the correlation of *image* and
+   * *filter* in horizontal strips as determined by *policy*. Each
+   * strip reads `filter.rows() - 1` rows of overlap from the input,
+   * so the result is equal to that of the sequential version.
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filterValidPart(const PiiMatrix<T>& image,
+                                        const PiiMatrix<U>& filter,
+                                        const PiiParallelPolicy& policy);
+
   /**
    * Filter an image with the given filter. This is equivalent to
    * PiiDsp::filter(), except for the `mode` parameter.
@@ -504,11 +711,44 @@ namespace PiiImage
                                Pii::ExtendMode mode = Pii::ExtendReplicate)
   {
     if (mode == Pii::ExtendZeros)
-      return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterOriginalSize);
+      {
+        if (!FilterKernel<ResultType,T,U>::isSupported() &&
+            !isFftFilterFaster<ResultType,T>(image.rows() + filter.rows() - 1,
+                                             image.columns() + filter.columns() - 1,
+                                             filter))
+          return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterOriginalSize);
+        // Pad so that the result is cropped the same way as with
+        // FilterOriginalSize.
+        return filterValidPart<ResultType>(Pii::extend(image,
+                                                       (filter.rows() - 1) >> 1, filter.rows() >> 1,
+                                                       (filter.columns() - 1) >> 1, filter.columns() >> 1,
+                                                       mode),
+                                           filter);
+      }
     const int rows = filter.rows() >> 1, cols = filter.columns() >> 1;
-    return PiiDsp::filter<ResultType>(Pii::extend(image, rows, rows, cols, cols, mode), filter, PiiDsp::FilterValidPart);
+    return filterValidPart<ResultType>(Pii::extend(image, rows, rows, cols, cols, mode), filter);
   }
 
+  /**
+   * Filters an image in parallel. The image is first extended as
+   * determined by *mode* and the valid part of the result is then
+   * calculated in strips (see [filterValidPart()]). If the policy
+   * does not split the image, this function is equivalent to the
+   * sequential version.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> filtered = PiiImage::filter<float>(image,
+   *                                                     PiiImage::makeFilter<float>(PiiImage::GaussianFilter, 7),
+   *                                                     Pii::ExtendSymmetric,
+   *                                                     PiiParallelPolicy());
+   * ~~~
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
+                               const PiiMatrix<U>& filter,
+                               Pii::ExtendMode mode,
+                               const PiiParallelPolicy& policy);
+
   template <class Input, class Filter, class UnaryFunction, class Output>
   void filter(const Input& input,
               const Filter& filter,
@@ -708,6 +948,17 @@ namespace PiiImage
                                const PiiMatrix<U>& verticalFilter,
                                Pii::ExtendMode mode = Pii::ExtendReplicate);
 
+  /**
+   * Filters an image with two one-dimensional filters in parallel.
+   * Both passes are divided into strips as determined by *policy*.
+   */
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
+                               const PiiMatrix<U>& horizontalFilter,
+                               const PiiMatrix<U>& verticalFilter,
+                               Pii::ExtendMode mode,
+                               const PiiParallelPolicy& policy);
+
   /**
    * Same as above, but filters the image with a named filter. See
    * [makeFilter()] for information about filter names. This function
@@ -738,6 +989,32 @@ namespace PiiImage
                                Pii::ExtendMode mode = Pii::ExtendReplicate,
                                int filterSize = 3);
 
+  /**
+   * Calculates the mean of each *windowRows*-by-*windowColumns*
+   * neighborhood in *image*. The result equals that of [filter()]
+   * with a `UniformFilter` of the same size, but the sums are taken
+   * from a [PiiIntegralImage], so the calculation time does not
+   * depend on the size of the window.
+   *
+   * @param image input image
+   *
+   * @param windowRows the height of the window
+   *
+   * @param windowColumns the width of the window. If this value is
+   * non-positive, *windowRows* will be used.
+   *
+   * @param mode how to handle image borders
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matSmooth = PiiImage::boxFilter<float>(image, 31);
+   * ~~~
+   */
+  template <class ResultType, class T>
+  PiiMatrix<ResultType> boxFilter(const PiiMatrix<T>& image,
+                                  int windowRows,
+                                  int windowColumns = 0,
+                                  Pii::ExtendMode mode = Pii::ExtendReplicate);
+
   /**
    * Filters an integer image by a double-valued filter. The filter is
    * first scaled and rounded to integers. The image is then filtered
@@ -804,11 +1081,69 @@ namespace PiiImage
    * value is less than one, `windowRows` will be used instead.
    *
    * @param mode the method of handling image borders
+   *
+   * 8-bit images are filtered with a histogram-based algorithm whose
+   * running time doesn't depend on the window size. For other types,
+   * the time grows with the window area.
    */
   template <class T> PiiMatrix<T> medianFilter(const PiiMatrix<T>& image,
                                                int windowRows = 3, int windowColumns = 0,
                                                Pii::ExtendMode mode = Pii::ExtendZeros);
 
+  /**
+   * The smallest window area (rows times columns) for which
+   * [medianFilter()] uses a histogram-based algorithm on 8-bit
+   * images.
+   */
+  enum { MinHistogramMedianArea = 9 };
+
+  /**
+   * Calculates the valid part of a median-filtered 8-bit *image* in
+   * constant time with respect to the window size. [medianFilter()]
+   * calls this function automatically. Returns `false` and leaves
+   * *result* untouched if the window is smaller than
+   * [MinHistogramMedianArea], in which case sorting-based filtering
+   * is faster.
+   *
+   * @internal
+   */
+  PII_IMAGE_EXPORT bool histogramMedianFilter(const PiiMatrix<uchar>& image,
+                                              int windowRows, int windowColumns,
+                                              PiiMatrix<uchar>& result);
+
+  template <class T> inline bool histogramMedianFilter(const PiiMatrix<T>&, int, int, PiiMatrix<T>&)
+  {
+    return false;
+  }
+
+  /**
+   * Filters an 8-bit image with a percentile (rank) filter. Each
+   * pixel is replaced by the *percentile* of its neighborhood. Zero
+   * gives a minimum filter, one a maximum filter and 0.5 a median
+   * filter. The running time doesn't depend on the window size (see
+   * PiiSlidingHistogram).
+   *
+   * @param image the input image
+   *
+   * @param percentile the percentile to pick, in [0,1]
+   *
+   * @param windowRows filter size in vertical direction
+   *
+   * @param windowColumns filter size in horizontal direction. If this
+   * value is less than one, `windowRows` will be used instead.
+   *
+   * @param mode the method of handling image borders
+   *
+   * ~~~(c++)
+   * // Remove dark specks that cover less than a quarter of the window
+   * PiiMatrix<uchar> matFiltered = PiiImage::percentileFilter(image, 0.75, 15);
+   * ~~~
+   */
+  PII_IMAGE_EXPORT PiiMatrix<uchar> percentileFilter(const PiiMatrix<uchar>& image,
+                                                     double percentile,
+                                                     int windowRows, int windowColumns = 0,
+                                                     Pii::ExtendMode mode = Pii::ExtendReplicate);
+
   template <class Input, class Output, class BinaryFunction>
   void medianFilter(const Input& image,
                     int windowRows,
@@ -829,6 +1164,10 @@ namespace PiiImage
    * @param windowColumns the size of the local window in horizontal
    * direction. If this value is less than one, `windowRows` will be
    * used instead.
+   *
+   * The filter is separable. Large windows are handled with the van
+   * Herk/Gil-Werman algorithm, which needs three comparisons per pixel
+   * in each direction regardless of the window size.
    */
   template <class T> PiiMatrix<T> maxFilter(const PiiMatrix<T>& image,
                                             int windowRows, int windowColumns = -1);
@@ -845,6 +1184,23 @@ namespace PiiImage
   /**
    * Scales image to a specified size.
    *
+   * `CubicInterpolation` and `AreaInterpolation` resample the image
+   * in two separable passes. The filter coefficients of each output
+   * column and row are calculated once, and the vertical pass uses
+   * vector instructions with 8 and 16 bit and `float` channels (see
+   * [ResampleKernel]).
+   *
+   * - `CubicInterpolation` uses the cubic convolution kernel with a
+   * = -0.5 (Catmull-Rom). When an image is reduced, the kernel is
+   * stretched by the scale factor, which prevents aliasing. Borders
+   * are extended by repeating the outermost pixels. Integer results
+   * are clamped to the range of the type.
+   *
+   * - `AreaInterpolation` calculates each output pixel as the average
+   * of the input pixels it covers, weighted by the covered area. This
+   * is the best choice for large reductions. All input pixels
+   * contribute to the result.
+   *
    * @param image input image
    *
    * @param rows the number of pixel rows in the result image
@@ -856,6 +1212,29 @@ namespace PiiImage
   template <class T> PiiMatrix<T> scale(const PiiMatrix<T>& image, int rows, int columns,
                                         Pii::Interpolation interpolation = Pii::LinearInterpolation);
 
+  /**
+   * Resampling coefficients for one dimension of [scale()]. Sample
+   * *i* of the resampled signal is `source[first[i]] * weights[i*taps]
+   * + ... + source[first[i] + taps-1] * weights[i*taps + taps-1]`.
+   * The weights of each sample sum up to one, and all indices are
+   * within the source signal.
+   *
+   * @internal
+   */
+  struct PII_IMAGE_EXPORT ResampleTable
+  {
+    /**
+     * Calculates the coefficients for resampling *sourceSize*
+     * samples to *targetSize* samples with cubic or area
+     * interpolation.
+     */
+    ResampleTable(int sourceSize, int targetSize, Pii::Interpolation interpolation);
+
+    int iTaps;
+    QVector<int> vecFirst;
+    QVector<float> vecWeights;
+  };
+
   /**
    * Scales image according to a scale ratio.
    *
@@ -888,6 +1267,25 @@ namespace PiiImage
    */
   template <class T> PiiMatrix<T> oneSixteenthSize(const PiiMatrix<T>& image);
 
+  /**
+   * Divides *image* into a grid of *gridRows* by *gridColumns* blocks
+   * of (nearly) equal size and returns the sum of the pixel values in
+   * each block. The channels of color images are summed together. If
+   * the image has fewer rows or columns than the grid, the grid is
+   * shrunk accordingly.
+   *
+   * Block sums are a cheap fingerprint of image content: the whole
+   * image is read only once, and 8-bit gray-level and color images
+   * are summed with vector instructions.
+   *
+   * ~~~(c++)
+   * // An 8-by-8 thumbnail of block averages
+   * PiiMatrix<double> matMeans(PiiImage::blockSums(image, 8, 8));
+   * matMeans *= 64.0 / (image.rows() * image.columns());
+   * ~~~
+   */
+  template <class T> PiiMatrix<double> blockSums(const PiiMatrix<T>& image, int gridRows, int gridColumns);
+
   /**
    * Transforms a 2D point using *transform*. The source point is
    * represented in homogeneous coordinates; it is assumed that the
@@ -1017,12 +1415,29 @@ namespace PiiImage
    * transformation matrices. Assume *R* is a rotation transform and
    * *S* is a shear transform. Shear after rotate transform is
    * obtained with \(T = SR\).
+   *
+   * If the same *transform* is applied to many images of the same
+   * size, it is faster to convert it to a PiiRemapTable once.
    */
   template <class T> PiiMatrix<T> transform(const PiiMatrix<T>& image,
                                             const PiiMatrix<float>& transform,
                                             TransformedSize handling = ExpandAsNecessary,
                                             T backgroundColor = T(0));
 
+  /**
+   * Calculates the range of pixel coordinates [transform()] produces
+   * when *transform* is applied to a *rows*-by-*columns* image. The
+   * result image spans the closed ranges [*minX*, *maxX*] and
+   * [*minY*, *maxY*] in the transformed domain.
+   *
+   * @internal
+   */
+  PII_IMAGE_EXPORT void transformedBounds(const PiiMatrix<float>& transform,
+                                          int rows, int columns,
+                                          TransformedSize handling,
+                                          int* minX, int* minY,
+                                          int* maxX, int* maxY);
+
   /**
    * Rotates image clockwise `theta` radians around its center.
    *
@@ -1132,7 +1547,11 @@ namespace PiiImage
    * corners are detected, which also means lower processing speed.
    *
    * @return a N-by-2 matrix in which each row stores the (x,y)
-   * coordinates of a detected corner.
+   * coordinates of a detected corner, in raster order.
+   *
+   * With `uchar` images, the segment test and the corner score are
+   * calculated with vector instructions if the CPU supports them.
+   * The result is the same as with the generic decision tree.
    */
   template <class T> PiiMatrix<int> detectFastCorners(const PiiMatrix<T>& image, T threshold=25);
 
@@ -1146,6 +1565,9 @@ namespace PiiImage
    * boundaries, the corresponding pixel in the result image will be
    * left black. If the map coordinates are given as `doubles`, this
    * function samples *image* using bilinear interpolation.
+   *
+   * If the same *map* is applied to many images, it is faster to
+   * convert it to a PiiRemapTable once.
    */
   template <class T, class U> PiiMatrix<T> remap(const PiiMatrix<T>& image, const PiiMatrix<PiiPoint<U> >& map);
 
@@ -1179,6 +1601,49 @@ namespace PiiImage
    */
   template <class T> double xorMatch(const PiiMatrix<T>& image, const PiiMatrix<T>& templ);
 
+  /**
+   * Matches a binary template to a binary image. This function is
+   * equivalent to xorMatch(const PiiMatrix<T>&, const PiiMatrix<T>&)
+   * with 0/1 matrices, but compares 64 pixels at a time by counting
+   * the set bits of xor'ed words. All offsets are tried, and the
+   * summation at an offset is stopped as soon as it cannot improve
+   * the best match found so far.
+   *
+   * @param image the image to search
+   *
+   * @param templ the template
+   *
+   * @param row store the row of the best match here, -1 if *templ*
+   * is larger than *image*
+   *
+   * @param column store the column of the best match here, -1 if
+   * *templ* is larger than *image*
+   *
+   * @return a value in [0,1], where 1 means a perfect match. If
+   * *templ* is larger than *image*, zero will be returned.
+   *
+   * ~~~(c++)
+   * PiiBitMatrix matImage(matGray, std::bind2nd(std::greater<uchar>(), 128));
+   * PiiBitMatrix matTemplate(PiiBitMatrix::fromMatrix(matDigit));
+   * int iRow, iColumn;
+   * double dMatch = PiiImage::xorMatch(matImage, matTemplate, &iRow, &iColumn);
+   * ~~~
+   */
+  PII_IMAGE_EXPORT double xorMatch(const PiiBitMatrix& image, const PiiBitMatrix& templ,
+                                   int* row = 0, int* column = 0);
+
+  /**
+   * Slides *templ* over *image* and counts the differing pixels at
+   * each offset. The returned matrix has `image.rows() - templ.rows()
+   * + 1` rows and `image.columns() - templ.columns() + 1` columns.
+   * The value at (r,c) is the number of pixels that differ when the
+   * top left corner of *templ* is placed at (r,c) in *image*. If
+   * *templ* is larger than *image*, an empty matrix will be returned.
+   *
+   * @see xorMatch(const PiiBitMatrix&, const PiiBitMatrix&, int*, int*)
+   */
+  PII_IMAGE_EXPORT PiiMatrix<int> xorDistances(const PiiBitMatrix& image, const PiiBitMatrix& templ);
+
   /**
    * Transforms *input* to *function(output)*. This function calls
    * *function* for each pixel except if the type of the input matrix
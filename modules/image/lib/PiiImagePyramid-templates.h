@@ -0,0 +1,231 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEPYRAMID_H
+# error "Never use <PiiImagePyramid-templates.h> directly; include <PiiImagePyramid.h> instead."
+#endif
+
+#include <QMutexLocker>
+#include <vector>
+
+namespace PiiImage
+{
+  namespace Private
+  {
+    template <class U> inline U divideBy256(U sum, Pii::True) { return (sum + 128) / 256; }
+    template <class U> inline U divideBy256(U sum, Pii::False) { return sum / 256; }
+
+    template <class T> PiiMatrix<T> gaussianPyramidDown(const PiiMatrix<T>& image)
+    {
+      typedef typename Pii::Combine<T,int>::Type U;
+      const int iRows = image.rows(), iCols = image.columns();
+      PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized((iRows+1)/2, (iCols+1)/2));
+      if (matResult.isEmpty())
+        return matResult;
+
+      // The vertically filtered row has two replicated columns on
+      // both sides.
+      std::vector<U> vecRow(iCols + 4);
+      U* pRow = &vecRow[2];
+      for (int r=0; r<matResult.rows(); ++r)
+        {
+          const int r2 = r*2;
+          const T *pSource0 = image[qMax(r2-2, 0)], *pSource1 = image[qMax(r2-1, 0)],
+            *pSource2 = image[r2],
+            *pSource3 = image[qMin(r2+1, iRows-1)], *pSource4 = image[qMin(r2+2, iRows-1)];
+          for (int c=0; c<iCols; ++c)
+            pRow[c] = U(pSource0[c]) + U(pSource4[c]) + 4 * (U(pSource1[c]) + U(pSource3[c])) + 6 * U(pSource2[c]);
+          pRow[-2] = pRow[-1] = pRow[0];
+          pRow[iCols] = pRow[iCols+1] = pRow[iCols-1];
+
+          T* pTarget = matResult[r];
+          for (int c=0; c<matResult.columns(); ++c)
+            {
+              const U* p = pRow + c*2;
+              pTarget[c] = T(divideBy256(p[-2] + p[2] + 4 * (p[-1] + p[1]) + 6 * p[0],
+                                         typename Pii::IfClass<Pii::IsInteger<U>, Pii::True, Pii::False>::Type()));
+            }
+        }
+      return matResult;
+    }
+  }
+
+  template <class T> PiiMatrix<T> pyramidDown(const PiiMatrix<T>& image, PyramidKernel kernel)
+  {
+    if (kernel == BoxPyramidKernel)
+      return quarterSize(image);
+    return Private::gaussianPyramidDown(image);
+  }
+}
+
+template <class T> PiiImagePyramid<T>::Data::Data(const PiiMatrix<T>& image, PiiImage::PyramidKernel k) :
+  kernel(k),
+  iLevelCount(0),
+  matImage(image)
+{
+  if (image.isEmpty())
+    return;
+  lstLevels << image;
+  int iRows = image.rows(), iCols = image.columns();
+  for (iLevelCount = 1; iRows >= 2 && iCols >= 2; ++iLevelCount)
+    {
+      iRows = nextSize(iRows, kernel);
+      iCols = nextSize(iCols, kernel);
+    }
+}
+
+template <class T> PiiImagePyramid<T>::PiiImagePyramid() :
+  d(new Data)
+{}
+
+template <class T> PiiImagePyramid<T>::PiiImagePyramid(const PiiMatrix<T>& image,
+                                                       PiiImage::PyramidKernel kernel) :
+  d(new Data(image, kernel))
+{}
+
+template <class T> PiiImagePyramid<T>::PiiImagePyramid(const PiiImagePyramid& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class T> PiiImagePyramid<T>::~PiiImagePyramid()
+{
+  d->release();
+}
+
+template <class T> PiiImagePyramid<T>& PiiImagePyramid<T>::operator= (const PiiImagePyramid& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class T> int PiiImagePyramid<T>::nextSize(int size, PiiImage::PyramidKernel kernel)
+{
+  return kernel == PiiImage::BoxPyramidKernel ? size/2 : (size+1)/2;
+}
+
+template <class T> bool PiiImagePyramid<T>::isSameImage(const PiiMatrix<T>& a, const PiiMatrix<T>& b)
+{
+  return a.rows() == b.rows() &&
+    a.columns() == b.columns() &&
+    a.stride() == b.stride() &&
+    a.row(0) == b.row(0);
+}
+
+template <class T> PiiImagePyramid<T> PiiImagePyramid<T>::shared(const PiiMatrix<T>& image,
+                                                                 PiiImage::PyramidKernel kernel)
+{
+  if (image.isEmpty())
+    return PiiImagePyramid(image, kernel);
+
+  static QMutex cacheMutex;
+  static QList<PiiImagePyramid> lstCache;
+
+  QMutexLocker lock(&cacheMutex);
+  // The most recently used pyramid is at the end of the list.
+  for (int i=lstCache.size(); i--; )
+    {
+      if (lstCache[i].d->kernel == kernel &&
+          isSameImage(lstCache[i].d->matImage, image))
+        {
+          PiiImagePyramid pyramid(lstCache[i]);
+          lstCache.removeAt(i);
+          lstCache.append(pyramid);
+          return pyramid;
+        }
+    }
+
+  PiiImagePyramid pyramid(image, kernel);
+  lstCache.append(pyramid);
+  if (lstCache.size() > SharedCacheSize)
+    lstCache.removeAt(0);
+  return pyramid;
+}
+
+template <class T> PiiImage::PyramidKernel PiiImagePyramid<T>::kernel() const
+{
+  return d->kernel;
+}
+
+template <class T> PiiMatrix<T> PiiImagePyramid<T>::image() const
+{
+  return d->matImage;
+}
+
+template <class T> int PiiImagePyramid<T>::levelCount() const
+{
+  return d->iLevelCount;
+}
+
+template <class T> int PiiImagePyramid<T>::cachedLevelCount() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->lstLevels.size();
+}
+
+template <class T> PiiMatrix<T> PiiImagePyramid<T>::level(int index) const
+{
+  if (index < 0 || index >= d->iLevelCount)
+    return PiiMatrix<T>();
+
+  QMutexLocker lock(&d->mutex);
+  while (d->lstLevels.size() <= index)
+    d->lstLevels << PiiImage::pyramidDown(d->lstLevels.last(), d->kernel);
+  return d->lstLevels[index];
+}
+
+template <class T> int PiiImagePyramid<T>::levelForSize(int rows, int columns) const
+{
+  if (d->iLevelCount == 0)
+    return 0;
+  int iRows = d->matImage.rows(), iCols = d->matImage.columns();
+  int iLevel = 0;
+  for (; iLevel < d->iLevelCount - 1; ++iLevel)
+    {
+      const int iNextRows = nextSize(iRows, d->kernel), iNextCols = nextSize(iCols, d->kernel);
+      if (iNextRows < rows || iNextCols < columns)
+        break;
+      iRows = iNextRows;
+      iCols = iNextCols;
+    }
+  return iLevel;
+}
+
+namespace PiiImage
+{
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiImagePyramid<T>& pyramid,
+                                                      T threshold,
+                                                      int levelCount)
+  {
+    if (levelCount < 0 || levelCount > pyramid.levelCount())
+      levelCount = pyramid.levelCount();
+
+    PiiMatrix<int> matResult(0,3);
+    for (int i=0; i<levelCount; ++i)
+      {
+        PiiMatrix<int> matCorners(detectFastCorners(pyramid.level(i), threshold));
+        matResult.reserve(matResult.rows() + matCorners.rows());
+        for (int r=0; r<matCorners.rows(); ++r)
+          {
+            int* pRow = matResult.appendRow();
+            pRow[0] = matCorners(r,0);
+            pRow[1] = matCorners(r,1);
+            pRow[2] = i;
+          }
+      }
+    return matResult;
+  }
+}
@@ -0,0 +1,208 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEPYRAMID_H
+#define _PIIIMAGEPYRAMID_H
+
+#include "PiiImage.h"
+#include <PiiSharedD.h>
+#include <QMutex>
+#include <QList>
+
+template <class T> class PiiImagePyramid;
+
+namespace PiiImage
+{
+  /**
+   * Smoothing kernels for building image pyramids.
+   *
+   * - `BoxPyramidKernel` - each pixel is the average of a 2-by-2
+   * block (see [quarterSize()]). Odd rows and columns at the bottom
+   * and right edges are dropped. Fastest, but more prone to aliasing.
+   *
+   * - `GaussianPyramidKernel` - the image is smoothed with a 5-by-5
+   * binomial filter (1 4 6 4 1 in both directions) before dropping
+   * every other row and column. The size of the result is rounded
+   * up. Borders are replicated.
+   */
+  enum PyramidKernel { BoxPyramidKernel, GaussianPyramidKernel };
+
+  /**
+   * Halves both dimensions of *image* using the given smoothing
+   * *kernel*. This is the operation that creates each level of
+   * PiiImagePyramid from the previous one.
+   *
+   * ! With integer images, the Gaussian kernel accumulates sums of
+   * 256 pixel values in `int`. Values larger than 2^23 will overflow.
+   */
+  template <class T> PiiMatrix<T> pyramidDown(const PiiMatrix<T>& image,
+                                              PyramidKernel kernel = GaussianPyramidKernel);
+
+  /**
+   * Detects FAST corners on the levels of *pyramid* (see
+   * [detectFastCorners()]). The same *threshold* is used on each
+   * level.
+   *
+   * @param pyramid the image pyramid. Missing levels will be
+   * calculated.
+   *
+   * @param threshold detection threshold
+   *
+   * @param levelCount the number of levels to search, starting at
+   * the original image. -1 means all levels. Levels smaller than 7 by
+   * 7 pixels contain no corners.
+   *
+   * @return an N-by-3 matrix in which each row stores the (x,y)
+   * coordinates of a corner and the index of the level it was found
+   * on. The coordinates are those of the level. To convert them to
+   * the coordinates of the original image, multiply by 2^level.
+   *
+   * ~~~(c++)
+   * PiiImagePyramid<uchar> pyramid(PiiImagePyramid<uchar>::shared(image));
+   * // Corners on the original image and the two levels above it.
+   * PiiMatrix<int> matCorners = PiiImage::detectFastCorners(pyramid, uchar(20), 3);
+   * ~~~
+   */
+  template <class T> PiiMatrix<int> detectFastCorners(const PiiImagePyramid<T>& pyramid,
+                                                      T threshold = 25,
+                                                      int levelCount = -1);
+}
+
+/**
+ * A multi-resolution representation of an image. Level zero is the
+ * original image, and each subsequent level halves the dimensions of
+ * the previous one (see PiiImage::pyramidDown()). The levels are
+ * calculated on demand and cached. The last level is the first one
+ * whose width or height is less than two.
+ *
+ * PiiImagePyramid is implicitly shared, and all copies of a pyramid
+ * share the same cache. A level calculated through one copy is
+ * immediately available to all others, even if the copies are used
+ * in different threads. Concurrent requests for a missing level block
+ * until one of them has calculated it.
+ *
+ * [shared()] returns a pyramid from a small process-wide cache keyed
+ * by the image data. Operations that receive the same image object
+ * from an upstream operation can use it to share a single pyramid
+ * without passing the pyramid itself between them.
+ *
+ * ~~~(c++)
+ * PiiMatrix<uchar> matImage = ...;
+ * PiiImagePyramid<uchar> pyramid(matImage);
+ * // One sixteenth of the original area
+ * PiiMatrix<uchar> matSmall = pyramid.level(2);
+ *
+ * // Coarse-to-fine search
+ * for (int i=pyramid.levelCount()-1; i>=0; --i)
+ *   refineMatches(pyramid.level(i));
+ * ~~~
+ */
+template <class T> class PiiImagePyramid
+{
+public:
+  /**
+   * The maximum number of pyramids retained by [shared()].
+   */
+  enum { SharedCacheSize = 4 };
+
+  /**
+   * Creates an empty pyramid with no levels.
+   */
+  PiiImagePyramid();
+
+  /**
+   * Creates a pyramid out of *image*. No levels other than the
+   * original image will be calculated before they are requested.
+   */
+  explicit PiiImagePyramid(const PiiMatrix<T>& image,
+                           PiiImage::PyramidKernel kernel = PiiImage::GaussianPyramidKernel);
+
+  PiiImagePyramid(const PiiImagePyramid& other);
+  ~PiiImagePyramid();
+  PiiImagePyramid& operator= (const PiiImagePyramid& other);
+
+  /**
+   * Returns a pyramid of *image* from a process-wide cache. If the
+   * cache contains a pyramid built with *kernel* out of the same
+   * image data, that pyramid will be returned. Otherwise, a new one
+   * will be created and stored in the cache. At most
+   * [SharedCacheSize] pyramids are retained; the least recently used
+   * one is dropped first.
+   *
+   * The cache holds a reference to the image data. Modifying a copy
+   * of a cached image thus detaches the modified copy instead of
+   * invalidating the cached levels.
+   */
+  static PiiImagePyramid shared(const PiiMatrix<T>& image,
+                                PiiImage::PyramidKernel kernel = PiiImage::GaussianPyramidKernel);
+
+  /**
+   * Returns the kernel used in building the pyramid.
+   */
+  PiiImage::PyramidKernel kernel() const;
+
+  /**
+   * Returns the original image (level zero).
+   */
+  PiiMatrix<T> image() const;
+
+  /**
+   * Returns the total number of levels including the original image.
+   * An empty pyramid has no levels.
+   */
+  int levelCount() const;
+
+  /**
+   * Returns the number of levels that have already been calculated.
+   */
+  int cachedLevelCount() const;
+
+  /**
+   * Returns the pyramid level at *index*, calculating it and all
+   * missing levels above it if needed. Returns an empty matrix if
+   * *index* is out of range.
+   */
+  PiiMatrix<T> level(int index) const;
+
+  /**
+   * Returns the index of the smallest level whose size is at least
+   * *rows* by *columns*. Level zero will be returned if the original
+   * image is smaller than the requested size.
+   */
+  int levelForSize(int rows, int columns) const;
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : kernel(PiiImage::GaussianPyramidKernel), iLevelCount(0) {}
+    Data(const PiiMatrix<T>& image, PiiImage::PyramidKernel k);
+
+    PiiImage::PyramidKernel kernel;
+    int iLevelCount;
+    PiiMatrix<T> matImage;
+    QList<PiiMatrix<T> > lstLevels;
+    // Guards lstLevels. The levels are calculated with the lock held
+    // so that concurrent requests don't duplicate the work.
+    mutable QMutex mutex;
+  } *d;
+
+  static int nextSize(int size, PiiImage::PyramidKernel kernel);
+  static bool isSameImage(const PiiMatrix<T>& a, const PiiMatrix<T>& b);
+};
+
+#include "PiiImagePyramid-templates.h"
+
+#endif //_PIIIMAGEPYRAMID_H
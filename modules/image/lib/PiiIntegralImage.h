@@ -0,0 +1,131 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIINTEGRALIMAGE_H
+#define _PIIINTEGRALIMAGE_H
+
+#include <PiiMath.h>
+
+/**
+ * An integral image, also known as a summed-area table. Each element
+ * of the table stores the sum of all pixels above and left of it.
+ * Once built, the table gives the sum over any rectangular window in
+ * constant time, regardless of the size of the window. This makes it
+ * the basic building block of local means, variances and box filters.
+ *
+ * The table has a zero border on the top and on the left (see
+ * Pii::ZeroBorderCumulativeSum), so it is one row and one column
+ * larger than the image. The type of the sum, *T*, must be large
+ * enough to hold the sum of all pixels in the image without
+ * overflowing.
+ *
+ * ~~~(c++)
+ * PiiMatrix<unsigned char> matImage = ...;
+ * PiiIntegralImage<int> sum(matImage);
+ * // Integral image of squares, for local variance
+ * PiiIntegralImage<long long> sum2(matImage, Pii::Square<long long>());
+ * // Sum over the 10-by-10 window whose upper left corner is at (5,5)
+ * int iSum = sum.sum(5, 5, 15, 15);
+ * ~~~
+ */
+template <class T> class PiiIntegralImage
+{
+public:
+  typedef T value_type;
+
+  /**
+   * Creates an empty integral image.
+   */
+  PiiIntegralImage() {}
+
+  /**
+   * Creates the integral image of *image*.
+   */
+  template <class Matrix> explicit PiiIntegralImage(const Matrix& image) :
+    _matSum(Pii::cumulativeSum<T,Matrix>(image, Pii::ZeroBorderCumulativeSum))
+  {}
+
+  /**
+   * Creates an integral image of *image* whose pixels are first
+   * transformed with *func*. The `result_type` of *func* must be
+   * *T*.
+   */
+  template <class Matrix, class UnaryFunction> PiiIntegralImage(const Matrix& image, UnaryFunction func) :
+    _matSum(Pii::cumulativeSum(image, func, Pii::ZeroBorderCumulativeSum))
+  {}
+
+  /**
+   * Returns the number of rows in the original image.
+   */
+  int rows() const { return qMax(_matSum.rows() - 1, 0); }
+  /**
+   * Returns the number of columns in the original image.
+   */
+  int columns() const { return qMax(_matSum.columns() - 1, 0); }
+
+  /**
+   * Returns the sum of pixels in the window whose upper left corner
+   * is at (*r1*, *c1*) and whose lower right corner is at (*r2* - 1,
+   * *c2* - 1). The window must be within the image.
+   */
+  T sum(int r1, int c1, int r2, int c2) const
+  {
+    return sum(_matSum[r1], _matSum[r2], c1, c2);
+  }
+
+  /**
+   * Returns the sum of pixels in a window centered at (*r*, *c*).
+   * The window extends *halfRows* rows up and down and *halfColumns*
+   * columns left and right of the center. Parts of the window outside
+   * of the image are ignored. If *count* is non-zero, the number of
+   * pixels summed up will be stored to it.
+   */
+  T windowSum(int r, int c, int halfRows, int halfColumns, int* count = 0) const
+  {
+    const int r1 = qMax(r - halfRows, 0), r2 = qMin(r + halfRows + 1, rows());
+    const int c1 = qMax(c - halfColumns, 0), c2 = qMin(c + halfColumns + 1, columns());
+    if (count != 0)
+      *count = (r2 - r1) * (c2 - c1);
+    return sum(r1, c1, r2, c2);
+  }
+
+  /**
+   * Returns a pointer to the beginning of the *r*th row of the
+   * table. Row zero is the zero border, and row *r* stores the sums
+   * over the first *r* rows of the image. Use this with the static
+   * [sum(const T*, const T*, int, int)] function to avoid evaluating
+   * row addresses in inner loops.
+   */
+  const T* sumRow(int r) const { return _matSum[r]; }
+
+  /**
+   * Returns the sum over columns [*c1*, *c2*) between the table rows
+   * *topRow* and *bottomRow* (see [sumRow()]).
+   */
+  static T sum(const T* topRow, const T* bottomRow, int c1, int c2)
+  {
+    return bottomRow[c2] + topRow[c1] - bottomRow[c1] - topRow[c2];
+  }
+
+  /**
+   * Returns the summed-area table as a matrix.
+   */
+  PiiMatrix<T> table() const { return _matSum; }
+
+private:
+  PiiMatrix<T> _matSum;
+};
+
+#endif //_PIIINTEGRALIMAGE_H
@@ -18,6 +18,8 @@
 
 #include "PiiImageGlobal.h"
 #include <PiiMatrix.h>
+#include <PiiBitMatrix.h>
+#include <PiiParallel.h>
 #include <QVector>
 #include <QPair>
 #include <QStack>
@@ -219,7 +221,7 @@ namespace PiiImage
                   PiiMatrix<int>& labels,
                   UnaryOp rule,
                   Limiter limiter,
-                  int* labelCount = 0)
+                  int* labelCount)
   {
     if (mat.isEmpty())
       {
@@ -415,6 +417,422 @@ namespace PiiImage
   }
 
 
+  /**
+   * A horizontal run of object pixels labeled by [labelRuns()].
+   */
+  struct LabeledRun
+  {
+    /// The row the run is on.
+    int row;
+    /// The first column of the run.
+    int start;
+    /// One past the last column of the run.
+    int end;
+    /// The label of the object the run belongs to (1, 2, ...).
+    int label;
+  };
+
+  /// @hide
+  namespace Private
+  {
+    // Union-find over run indices. The root of a set is always its
+    // smallest index, i.e. the first run of the object in raster
+    // order.
+    inline int findRoot(int* parents, int index)
+    {
+      while (parents[index] != index)
+        {
+          // Path halving
+          parents[index] = parents[parents[index]];
+          index = parents[index];
+        }
+      return index;
+    }
+
+    inline void uniteRuns(int* parents, int a, int b)
+    {
+      a = findRoot(parents, a);
+      b = findRoot(parents, b);
+      if (a < b)
+        parents[b] = a;
+      else if (b < a)
+        parents[a] = b;
+    }
+
+    // Joins the runs in [current, currentEnd) to the overlapping runs
+    // in [previous, previousEnd). Both ranges are sorted by column.
+    // Indices are relative to runs.
+    inline void connectRows(const LabeledRun* runs, int* parents,
+                            int previous, int previousEnd,
+                            int current, int currentEnd,
+                            int connectivityShift)
+    {
+      for (; current < currentEnd; ++current)
+        {
+          const int iStart = runs[current].start - connectivityShift;
+          const int iEnd = runs[current].end + connectivityShift;
+          // Runs that end before this one starts can't touch any of
+          // the following ones either.
+          while (previous < previousEnd && runs[previous].end <= iStart)
+            ++previous;
+          for (int i = previous; i < previousEnd && runs[i].start < iEnd; ++i)
+            uniteRuns(parents, i, current);
+        }
+    }
+
+    // Finds the runs in a strip of rows and joins the overlapping
+    // ones within the strip.
+    // Appends the runs of object pixels on row r to runs.
+    template <class Matrix, class UnaryOp>
+    void appendRuns(const Matrix& mat, UnaryOp rule, int r, QVector<LabeledRun>& runs)
+    {
+      typename Matrix::const_row_iterator sourceRow = mat.rowBegin(r);
+      const int iCols = mat.columns();
+      for (int c = 0; c < iCols; ++c)
+        {
+          if (rule(sourceRow[c]))
+            {
+              LabeledRun run = { r, c, 0, 0 };
+              ++c;
+              while (c < iCols && rule(sourceRow[c]))
+                ++c;
+              run.end = c;
+              runs.append(run);
+            }
+        }
+    }
+
+    // Bit matrices are scanned a word at a time. The rule is only
+    // evaluated for true and false, which means that the set bits,
+    // the unset bits or all pixels may be objects.
+    template <class UnaryOp>
+    void appendRuns(const PiiBitMatrix& mat, UnaryOp rule, int r, QVector<LabeledRun>& runs)
+    {
+      const quint64 iOnes = rule(true) ? ~quint64(0) : 0, iZeros = rule(false) ? ~quint64(0) : 0;
+      const quint64* pWords = mat.row(r);
+      const int iCols = mat.columns(), iWords = mat.wordsPerRow();
+      int w = 0;
+      // Object pixels in the current word at or after the current column
+      quint64 iBits = iWords > 0 ? (pWords[0] & iOnes) | (~pWords[0] & iZeros) : 0;
+      for (;;)
+        {
+          while (iBits == 0)
+            {
+              if (++w == iWords)
+                return;
+              iBits = (pWords[w] & iOnes) | (~pWords[w] & iZeros);
+            }
+          LabeledRun run = { r, (w << 6) + Pii::lowestBit(iBits), 0, 0 };
+          if (run.start >= iCols)
+            return;
+          // Find the first background pixel after the start.
+          quint64 iBackground = ~iBits & (~quint64(0) << (run.start & 63));
+          while (iBackground == 0)
+            {
+              if (++w == iWords)
+                break;
+              iBits = (pWords[w] & iOnes) | (~pWords[w] & iZeros);
+              iBackground = ~iBits;
+            }
+          if (w == iWords)
+            {
+              run.end = iCols;
+              runs.append(run);
+              return;
+            }
+          run.end = qMin((w << 6) + Pii::lowestBit(iBackground), iCols);
+          runs.append(run);
+          // Clear the processed bits of the current word.
+          iBits &= ~((iBackground & -iBackground) - 1);
+        }
+    }
+
+    struct BitRule
+    {
+      bool operator() (bool value) const { return value; }
+    };
+
+    template <class Matrix, class UnaryOp> struct RunLabelingStrip
+    {
+      struct Runs
+      {
+        QVector<LabeledRun> vecRuns;
+        QVector<int> vecParents;
+        // The runs on the first row of the strip end here.
+        int iFirstRowEnd;
+        // The runs on the last row of the strip start here.
+        int iLastRowStart;
+      };
+
+      RunLabelingStrip(const Matrix& mat, UnaryOp rule, Connectivity connectivity, int strips) :
+        matImage(mat), rule(rule),
+        iConnectivityShift(connectivity == Connect8 ? 1 : 0),
+        vecStrips(strips)
+      {}
+
+      int firstRow(int strip) const
+      {
+        return int(qint64(matImage.rows()) * strip / vecStrips.size());
+      }
+
+      void operator() (int firstStrip, int endStrip)
+      {
+        for (int i = firstStrip; i < endStrip; ++i)
+          findRuns(vecStrips[i], firstRow(i), firstRow(i+1));
+      }
+
+      void findRuns(Runs& strip, int firstRow, int endRow)
+      {
+        QVector<LabeledRun>& vecRuns = strip.vecRuns;
+        int iPreviousStart = 0, iPreviousEnd = 0;
+        strip.iFirstRowEnd = 0;
+        for (int r = firstRow; r < endRow; ++r)
+          {
+            const int iCurrentStart = vecRuns.size();
+            appendRuns(matImage, rule, r, vecRuns);
+            const int iCurrentEnd = vecRuns.size();
+            for (int i = iCurrentStart; i < iCurrentEnd; ++i)
+              strip.vecParents.append(i);
+            if (r == firstRow)
+              strip.iFirstRowEnd = iCurrentEnd;
+            else
+              connectRows(vecRuns.constData(), strip.vecParents.data(),
+                          iPreviousStart, iPreviousEnd,
+                          iCurrentStart, iCurrentEnd,
+                          iConnectivityShift);
+            iPreviousStart = iCurrentStart;
+            iPreviousEnd = iCurrentEnd;
+          }
+        strip.iLastRowStart = iPreviousStart;
+      }
+
+      const Matrix& matImage;
+      UnaryOp rule;
+      int iConnectivityShift;
+      QVector<Runs> vecStrips;
+    };
+
+    struct NullRunFunction
+    {
+      void operator() (const LabeledRun&) {}
+    };
+
+    struct RunPaintStrip
+    {
+      RunPaintStrip(const QVector<LabeledRun>& runs, const QVector<int>& rowStarts, PiiMatrix<int>& labels) :
+        vecRuns(runs), vecRowStarts(rowStarts), matLabels(labels)
+      {}
+
+      void operator() (int firstRow, int endRow)
+      {
+        for (int i = vecRowStarts[firstRow]; i < vecRowStarts[endRow]; ++i)
+          {
+            const LabeledRun& run = vecRuns[i];
+            int* pRow = matLabels[run.row];
+            for (int c = run.start; c < run.end; ++c)
+              pRow[c] = run.label;
+          }
+      }
+
+      const QVector<LabeledRun>& vecRuns;
+      const QVector<int>& vecRowStarts;
+      PiiMatrix<int>& matLabels;
+    };
+  }
+  /// @endhide
+
+  /**
+   * Finds the connected components of an image and returns them as a
+   * list of horizontal runs. This avoids building a full label image
+   * if only the objects themselves are needed. The runs are sorted by
+   * row and then by column. Labels are assigned in the order the
+   * objects are first found in raster order, which gives the same
+   * labels as [labelImage()].
+   *
+   * The image is scanned in horizontal strips as determined by
+   * *policy*. Each strip finds its runs and joins overlapping runs on
+   * adjacent rows with a union-find structure. The seams between the
+   * strips are joined once all strips have been processed. Labels
+   * merge by pointing one set to another, so no pixels are ever
+   * rewritten.
+   *
+   * @param mat the image to label
+   *
+   * @param rule a unary predicate that returns `true` for object
+   * pixels
+   *
+   * @param connectivity the connectivity type
+   *
+   * @param labelCount an optional output-value parameter that stores
+   * the number of objects found
+   *
+   * @param policy the execution policy
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> matBinary;
+   * int iObjects = 0;
+   * QVector<PiiImage::LabeledRun> vecRuns =
+   *   PiiImage::labelRuns(matBinary,
+   *                       std::bind2nd(std::not_equal_to<uchar>(), 0),
+   *                       PiiImage::Connect8,
+   *                       &iObjects,
+   *                       PiiParallelPolicy());
+   * PiiMatrix<int> matAreas, matCentroids, matBoxes;
+   * PiiImage::calculateProperties(vecRuns, iObjects, matAreas, matCentroids, matBoxes);
+   * ~~~
+   */
+  template <class Matrix, class UnaryOp>
+  QVector<LabeledRun> labelRuns(const Matrix& mat,
+                                UnaryOp rule,
+                                Connectivity connectivity = Connect4,
+                                int* labelCount = 0,
+                                const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    Private::NullRunFunction function;
+    return labelRuns(mat, rule, connectivity, function, labelCount, policy);
+  }
+
+  /**
+   * Labels the set bits in a bit-packed binary image. The runs are
+   * found a word at a time, which is considerably faster than
+   * scanning a byte mask.
+   *
+   * ~~~(c++)
+   * PiiBitMatrix matBinary;
+   * QVector<PiiImage::LabeledRun> vecRuns = PiiImage::labelRuns(matBinary, PiiImage::Connect8);
+   * ~~~
+   */
+  inline QVector<LabeledRun> labelRuns(const PiiBitMatrix& mat,
+                                       Connectivity connectivity = Connect4,
+                                       int* labelCount = 0,
+                                       const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    return labelRuns(mat, Private::BitRule(), connectivity, labelCount, policy);
+  }
+
+  /**
+   * Labels runs like the other labelRuns() function, but also calls
+   * *function* for each run once its label is known. The runs are
+   * passed in raster order, which makes it possible to accumulate
+   * object properties while labeling (see
+   * [ObjectFeatureAccumulator]). The function is always called in the
+   * calling thread.
+   *
+   * @param function a function object that takes a `const
+   * LabeledRun&` as a parameter
+   */
+  template <class Matrix, class UnaryOp, class RunFunction>
+  QVector<LabeledRun> labelRuns(const Matrix& mat,
+                                UnaryOp rule,
+                                Connectivity connectivity,
+                                RunFunction& function,
+                                int* labelCount = 0,
+                                const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    typedef Private::RunLabelingStrip<Matrix,UnaryOp> Strip;
+    const int iStrips = mat.isEmpty() ? 1 : policy.stripCount(mat.rows());
+    Strip strip(mat, rule, connectivity, iStrips);
+    // One strip of rows per parallel strip
+    Pii::forEachStrip(iStrips, strip, PiiParallelPolicy(iStrips, 1));
+
+    // Concatenate the strips and join the seams.
+    int iTotalRuns = 0;
+    for (int i = 0; i < iStrips; ++i)
+      iTotalRuns += strip.vecStrips[i].vecRuns.size();
+    QVector<LabeledRun> vecRuns;
+    vecRuns.reserve(iTotalRuns);
+    QVector<int> vecParents;
+    vecParents.reserve(iTotalRuns);
+    int iPreviousStart = 0, iPreviousEnd = 0;
+    for (int i = 0; i < iStrips; ++i)
+      {
+        typename Strip::Runs& runs = strip.vecStrips[i];
+        const int iOffset = vecRuns.size();
+        for (int j = 0; j < runs.vecRuns.size(); ++j)
+          {
+            vecRuns.append(runs.vecRuns[j]);
+            vecParents.append(runs.vecParents[j] + iOffset);
+          }
+        // Nothing to join if either row at the seam is empty.
+        if (i > 0 && runs.iFirstRowEnd > 0 && iPreviousEnd > iPreviousStart &&
+            vecRuns[iPreviousStart].row + 1 == vecRuns[iOffset].row)
+          Private::connectRows(vecRuns.constData(), vecParents.data(),
+                               iPreviousStart, iPreviousEnd,
+                               iOffset, iOffset + runs.iFirstRowEnd,
+                               connectivity == Connect8 ? 1 : 0);
+        if (!runs.vecRuns.isEmpty())
+          {
+            iPreviousStart = iOffset + runs.iLastRowStart;
+            iPreviousEnd = vecRuns.size();
+          }
+        runs.vecRuns.clear();
+        runs.vecParents.clear();
+      }
+
+    // Roots precede their children, so one pass resolves all labels.
+    int iLabelIndex = 0;
+    for (int i = 0; i < iTotalRuns; ++i)
+      {
+        int iRoot = Private::findRoot(vecParents.data(), i);
+        vecRuns[i].label = iRoot == i ? ++iLabelIndex : vecRuns[iRoot].label;
+        function(vecRuns[i]);
+      }
+
+    if (labelCount != 0)
+      *labelCount = iLabelIndex;
+    return vecRuns;
+  }
+
+  /**
+   * Paints labeled runs to a label image. The size of *labels* must
+   * match the image the runs were extracted from, and it must be
+   * initialized to zeros. Rows are painted in parallel as determined
+   * by *policy*.
+   */
+  inline void paintRuns(const QVector<LabeledRun>& runs,
+                        PiiMatrix<int>& labels,
+                        const PiiParallelPolicy& policy = PiiParallelPolicy::sequential())
+  {
+    // Index of the first run on each row
+    const int iRows = labels.rows();
+    QVector<int> vecRowStarts(iRows + 1);
+    for (int r = 0, i = 0; r <= iRows; ++r)
+      {
+        while (i < runs.size() && runs[i].row < r)
+          ++i;
+        vecRowStarts[r] = i;
+      }
+    Private::RunPaintStrip strip(runs, vecRowStarts, labels);
+    Pii::forEachStrip(iRows, strip, policy);
+  }
+
+  /**
+   * Labels connected components with [labelRuns()] and paints them to
+   * a label image. The result is equal to that of the other
+   * labelImage() functions with the same rule and connectivity, but
+   * the work is divided into horizontal strips as determined by
+   * *policy*.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matLabels = PiiImage::labelImage(matBinary,
+   *                                                 std::bind2nd(std::greater<uchar>(), 0),
+   *                                                 PiiImage::Connect4,
+   *                                                 PiiParallelPolicy(),
+   *                                                 &iLabelCount);
+   * ~~~
+   */
+  template <class Matrix, class UnaryOp>
+  PiiMatrix<int> labelImage(const Matrix& mat,
+                            UnaryOp rule,
+                            Connectivity connectivity,
+                            const PiiParallelPolicy& policy,
+                            int* labelCount = 0)
+  {
+    PiiMatrix<int> matLabels(mat.rows(), mat.columns());
+    paintRuns(labelRuns(mat, rule, connectivity, labelCount, policy), matLabels, policy);
+    return matLabels;
+  }
+
   /// @hide
 
   // A linked list node for runs of consequtive object pixels on one
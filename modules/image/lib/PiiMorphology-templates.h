@@ -33,6 +33,122 @@ namespace PiiImage
   };
 
 
+  namespace Private
+  {
+    template <class U> bool maskSegments(const PiiMatrix<U>& mask, QVector<MaskSegment>& segments)
+    {
+      for (int r=0; r<mask.rows(); ++r)
+        {
+          const U* pRow = mask[r];
+          for (int c=0; c<mask.columns(); ++c)
+            {
+              if (pRow[c] != U(0) && pRow[c] != U(1))
+                return false;
+              if (pRow[c] == U(1))
+                {
+                  MaskSegment segment = { r, c, c+1 };
+                  while (segment.end < mask.columns() && pRow[segment.end] == U(1))
+                    ++segment.end;
+                  segments.append(segment);
+                  c = segment.end - 1;
+                }
+            }
+        }
+      return true;
+    }
+
+    template <class U> void nonZeroSegments(const PiiMatrix<U>& mask, QVector<MaskSegment>& segments)
+    {
+      for (int r=0; r<mask.rows(); ++r)
+        {
+          const U* pRow = mask[r];
+          for (int c=0; c<mask.columns(); ++c)
+            if (pRow[c] != U(0))
+              {
+                MaskSegment segment = { r, c, c+1 };
+                while (segment.end < mask.columns() && pRow[segment.end] != U(0))
+                  ++segment.end;
+                segments.append(segment);
+                c = segment.end - 1;
+              }
+        }
+    }
+
+    template <class U> bool hitAndMissSegments(const PiiMatrix<U>& mask, const PiiMatrix<U>& significance,
+                                               QVector<MaskSegment>& hits, QVector<MaskSegment>& misses)
+    {
+      if (mask.rows() != significance.rows() || mask.columns() != significance.columns())
+        return false;
+      PiiMatrix<U> matHits(mask.rows(), mask.columns()), matMisses(mask.rows(), mask.columns());
+      for (int r=0; r<mask.rows(); ++r)
+        for (int c=0; c<mask.columns(); ++c)
+          {
+            if (significance(r,c) == U(0))
+              continue;
+            if (significance(r,c) != U(1))
+              return false;
+            if (mask(r,c) == U(1))
+              matHits(r,c) = 1;
+            else if (mask(r,c) == U(0))
+              matMisses(r,c) = 1;
+            else
+              return false;
+          }
+      return maskSegments(matHits, hits) && maskSegments(matMisses, misses);
+    }
+
+    // The morphology functions compare masks to images bitwise. With
+    // a mask of zeros and ones, only the lowest bit of each pixel
+    // matters.
+    template <class Matrix> PiiMatrix<quint64> packOddBits(const Matrix& image)
+    {
+      PiiMatrix<quint64> matBits(image.rows(), (image.columns() + 63) >> 6);
+      for (int r=0; r<image.rows(); ++r)
+        {
+          typename Matrix::const_row_iterator pRow = image.rowBegin(r);
+          quint64* pBits = matBits[r];
+          for (int c=0; c<image.columns(); ++c)
+            if (int(pRow[c]) & 1)
+              pBits[c >> 6] |= quint64(1) << (c & 63);
+        }
+      return matBits;
+    }
+
+    template <class Matrix> PiiMatrix<quint64> packNonZeroBits(const Matrix& image)
+    {
+      typedef typename Matrix::value_type T;
+      PiiMatrix<quint64> matBits(image.rows(), (image.columns() + 63) >> 6);
+      for (int r=0; r<image.rows(); ++r)
+        {
+          typename Matrix::const_row_iterator pRow = image.rowBegin(r);
+          quint64* pBits = matBits[r];
+          for (int c=0; c<image.columns(); ++c)
+            if (pRow[c] != T(0))
+              pBits[c >> 6] |= quint64(1) << (c & 63);
+        }
+      return matBits;
+    }
+
+    template <class T> PiiMatrix<T> unpackBits(const PiiMatrix<quint64>& bits, int columns)
+    {
+      PiiMatrix<T> matResult(bits.rows(), columns);
+      for (int r=0; r<bits.rows(); ++r)
+        {
+          const quint64* pBits = bits[r];
+          T* pRow = matResult[r];
+          for (int w=0; w<bits.columns(); ++w)
+            {
+              // Skip empty words quickly
+              quint64 iWord = pBits[w];
+              for (int c=w << 6; iWord != 0; ++c, iWord >>= 1)
+                if (iWord & 1)
+                  pRow[c] = T(1);
+            }
+        }
+      return matResult;
+    }
+  }
+
   template <class Matrix, class U>
   PiiMatrix<typename Matrix::value_type> morphology(const Matrix& image,
                                                     const PiiMatrix<U>& mask,
@@ -109,7 +225,19 @@ namespace PiiImage
         return img;
       }
 
-    PiiMatrix<T> result(rows,cols);
+    PiiMatrix<T> result;
+    QVector<Private::MaskSegment> vecSegments;
+    if (Private::maskSegments(mask, vecSegments))
+      {
+        result = Private::unpackBits<T>(Private::erodeBits(Private::packOddBits(img), cols,
+                                                           vecSegments, maskRows, maskCols),
+                                        cols);
+        if (handleBorders)
+          return result(rOrig, cOrig, image.rows(), image.columns());
+        return result;
+      }
+
+    result = PiiMatrix<T>(rows,cols);
     int rDiff = rows-maskRows;
     int cDiff = cols-maskCols;
     for (int r=0; r<=rDiff; ++r)
@@ -147,6 +275,14 @@ namespace PiiImage
 
     if (maskRows > rows || maskCols > cols)
       piiWarning("BinaryMorphology::dilate(image, mask): Mask cannot be larger than image.");
+    else
+      {
+        QVector<Private::MaskSegment> vecSegments;
+        if (Private::maskSegments(mask, vecSegments))
+          return Private::unpackBits<T>(Private::dilateBits(Private::packNonZeroBits(image), cols,
+                                                            vecSegments, maskRows, maskCols),
+                                        cols);
+      }
 
     PiiMatrix<T> result(rows,cols);
     typename Matrix::row_iterator ptr;
@@ -377,6 +513,12 @@ namespace PiiImage
         return image;
       }
 
+    QVector<Private::MaskSegment> vecHits, vecMisses;
+    if (Private::hitAndMissSegments(mask, significance, vecHits, vecMisses))
+      return Private::unpackBits<T>(Private::hitAndMissBits(Private::packOddBits(image), cols,
+                                                            vecHits, vecMisses, maskRows, maskCols),
+                                    cols);
+
     PiiMatrix<T> result(rows,cols);
 
     for (int r=0; r<=(rows-maskRows); r++)
@@ -409,6 +551,19 @@ namespace PiiImage
   PiiMatrix<typename Matrix::value_type> thin(const Matrix& image, int amount)
   {
     typedef typename Matrix::value_type T;
+    if (amount != 0 && image.rows() >= 3 && image.columns() >= 3)
+      {
+        // The packed version can be used if the first hit-and-miss
+        // sees the same objects as the subtraction, i.e. there are no
+        // even non-zero pixels.
+        PiiMatrix<quint64> matBits(Private::packNonZeroBits(image));
+        if (Pii::equals(matBits, Private::packOddBits(image)))
+          {
+            Private::thinBits(matBits, image.columns(), amount);
+            return Private::unpackBits<T>(matBits, image.columns());
+          }
+      }
+
     PiiMatrix<T> result(image);
 
     if (amount >= 0)
@@ -549,6 +704,97 @@ namespace PiiImage
     return mask;
   }
 
+
+  template <class U>
+  PiiBitMatrix erode(const PiiBitMatrix& image, const PiiMatrix<U>& mask, bool handleBorders)
+  {
+    if (!handleBorders && (mask.rows() > image.rows() || mask.columns() > image.columns()))
+      {
+        piiWarning("PiiMorphology::erode(image, mask): Mask cannot be larger than image.");
+        return image;
+      }
+    QVector<Private::MaskSegment> vecSegments;
+    Private::nonZeroSegments(mask, vecSegments);
+    return Private::erodeBits(image, vecSegments, mask.rows(), mask.columns(), handleBorders);
+  }
+
+  template <class U>
+  PiiBitMatrix dilate(const PiiBitMatrix& image, const PiiMatrix<U>& mask)
+  {
+    if (mask.rows() > image.rows() || mask.columns() > image.columns())
+      {
+        piiWarning("BinaryMorphology::dilate(image, mask): Mask cannot be larger than image.");
+        return PiiBitMatrix(image.rows(), image.columns());
+      }
+    QVector<Private::MaskSegment> vecSegments;
+    Private::nonZeroSegments(mask, vecSegments);
+    return PiiBitMatrix(Private::dilateBits(image.words(), image.columns(),
+                                            vecSegments, mask.rows(), mask.columns()),
+                        image.columns());
+  }
+
+  template <class U>
+  PiiBitMatrix hitAndMiss(const PiiBitMatrix& image,
+                          const PiiMatrix<U>& mask,
+                          const PiiMatrix<U>& significance)
+  {
+    if (mask.rows() > image.rows() || mask.columns() > image.columns())
+      {
+        piiWarning("PiiMorphology::hitAndMiss(image, structure, mask): Mask cannot be larger than image.");
+        return image;
+      }
+    PiiMatrix<int> matHits(mask.rows(), mask.columns()), matMisses(mask.rows(), mask.columns());
+    for (int r=0; r<mask.rows(); ++r)
+      for (int c=0; c<mask.columns(); ++c)
+        if (significance(r,c) != U(0))
+          {
+            if (mask(r,c) != U(0))
+              matHits(r,c) = 1;
+            else
+              matMisses(r,c) = 1;
+          }
+    QVector<Private::MaskSegment> vecHits, vecMisses;
+    Private::nonZeroSegments(matHits, vecHits);
+    Private::nonZeroSegments(matMisses, vecMisses);
+    return PiiBitMatrix(Private::hitAndMissBits(image.words(), image.columns(),
+                                                vecHits, vecMisses, mask.rows(), mask.columns()),
+                        image.columns());
+  }
+
+  template <class U>
+  PiiBitMatrix topHat(const PiiBitMatrix& image, const PiiMatrix<U>& mask)
+  {
+    return image & ~open(image, mask);
+  }
+
+  template <class U>
+  PiiBitMatrix bottomHat(const PiiBitMatrix& image, const PiiMatrix<U>& mask)
+  {
+    return close(image, mask) & ~image;
+  }
+
+  template <class U>
+  PiiBitMatrix morphology(const PiiBitMatrix& image, const PiiMatrix<U>& mask,
+                          MorphologyOperation type, bool handleBorders)
+  {
+    switch (type)
+      {
+      case Erode:
+        return erode(image, mask, handleBorders);
+      case Dilate:
+        return dilate(image, mask);
+      case Open:
+        return open(image, mask);
+      case Close:
+        return close(image, mask);
+      case TopHat:
+        return topHat(image, mask);
+      case BottomHat:
+        return bottomHat(image, mask);
+      default:
+        return image;
+      }
+  }
 }
 
 #endif //_PIIMORPHOLOGY_TEMPLATES_H
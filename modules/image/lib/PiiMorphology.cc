@@ -125,4 +125,374 @@ namespace PiiImage
 
   // Export an explicit instantiation.
   PII_DEFINE_EXPORTED_FUNCTION_TEMPLATE(PiiMatrix<unsigned char>, createMask<unsigned char>, (MaskType type, int rows, int columns));
+
+  namespace Private
+  {
+    static inline int wordCount(int columns) { return (columns + 63) >> 6; }
+
+    // Zeros the bits beyond the last column.
+    static inline void clearTail(quint64* row, int columns)
+    {
+      if (columns & 63)
+        row[columns >> 6] &= (quint64(1) << (columns & 63)) - 1;
+    }
+
+    // dst(x) = src(x + shift). Zeros are shifted in.
+    static void shiftBits(const quint64* src, quint64* dst, int columns, int shift)
+    {
+      const int iWords = wordCount(columns);
+      // Floor division
+      const int iWordShift = shift >= 0 ? shift >> 6 : -((-shift + 63) >> 6);
+      const int iBitShift = shift - (iWordShift << 6);
+      for (int w=0; w<iWords; ++w)
+        {
+          const int iSource = w + iWordShift;
+          quint64 iLow = iSource >= 0 && iSource < iWords ? src[iSource] : 0;
+          if (iBitShift == 0)
+            dst[w] = iLow;
+          else
+            {
+              quint64 iHigh = iSource + 1 >= 0 && iSource + 1 < iWords ? src[iSource + 1] : 0;
+              dst[w] = (iLow >> iBitShift) | (iHigh << (64 - iBitShift));
+            }
+        }
+      clearTail(dst, columns);
+    }
+
+    struct AndBits { quint64 operator() (quint64 a, quint64 b) const { return a & b; } };
+    struct OrBits { quint64 operator() (quint64 a, quint64 b) const { return a | b; } };
+
+    // row(x) = op(row(x), ..., row(x+length-1)). Pixels beyond the
+    // image are zeros. The window is built by doubling, and the
+    // remainder is covered by an overlapping window, which works
+    // because both operations are idempotent.
+    template <class Op> static void windowBits(quint64* row, quint64* tmp, int columns, int length, Op op)
+    {
+      const int iWords = wordCount(columns);
+      int iWindow = 1;
+      while (iWindow * 2 <= length)
+        {
+          shiftBits(row, tmp, columns, iWindow);
+          for (int w=0; w<iWords; ++w)
+            row[w] = op(row[w], tmp[w]);
+          iWindow *= 2;
+        }
+      if (iWindow < length)
+        {
+          shiftBits(row, tmp, columns, length - iWindow);
+          for (int w=0; w<iWords; ++w)
+            row[w] = op(row[w], tmp[w]);
+        }
+    }
+
+    // Horizontal windows of the given length for all rows.
+    template <class Op> static PiiMatrix<quint64> windowRows(const PiiMatrix<quint64>& bits, int columns, int length, Op op)
+    {
+      PiiMatrix<quint64> matResult(bits);
+      QVector<quint64> vecTmp(bits.columns());
+      for (int r=0; r<bits.rows(); ++r)
+        windowBits(matResult.row(r), vecTmp.data(), columns, length, op);
+      return matResult;
+    }
+
+    // result(r) = op(rows(r), ..., rows(r+height-1)) using van
+    // Herk/Gil-Werman. Rows beyond the input are neutral.
+    template <class Op> static PiiMatrix<quint64> verticalWindow(const PiiMatrix<quint64>& rows, int height, Op op)
+    {
+      const int iRows = rows.rows(), iWords = rows.columns();
+      PiiMatrix<quint64> matPrefix(rows), matSuffix(rows), matResult(iRows, iWords);
+      for (int r=0; r<iRows; ++r)
+        if (r % height != 0)
+          for (int w=0; w<iWords; ++w)
+            matPrefix(r,w) = op(matPrefix(r-1,w), rows(r,w));
+      for (int r=iRows-1; r--; )
+        if ((r+1) % height != 0)
+          for (int w=0; w<iWords; ++w)
+            matSuffix(r,w) = op(matSuffix(r+1,w), rows(r,w));
+      for (int r=0; r<iRows; ++r)
+        {
+          const int iLast = qMin(r + height, iRows) - 1;
+          // If the window ends in the same block, the suffix covers it.
+          if (iLast / height == r / height)
+            for (int w=0; w<iWords; ++w)
+              matResult(r,w) = matSuffix(r,w);
+          else
+            for (int w=0; w<iWords; ++w)
+              matResult(r,w) = op(matSuffix(r,w), matPrefix(iLast,w));
+        }
+      return matResult;
+    }
+
+    // Returns true if segments form a full rectangle.
+    static bool isRectangle(const QVector<MaskSegment>& segments, int maskRows)
+    {
+      if (segments.size() != maskRows)
+        return false;
+      for (int i=0; i<segments.size(); ++i)
+        if (segments[i].row != i ||
+            segments[i].start != segments[0].start ||
+            segments[i].end != segments[0].end)
+          return false;
+      return true;
+    }
+
+    PiiMatrix<quint64> erodeBits(const PiiMatrix<quint64>& bits, int columns,
+                                 const QVector<MaskSegment>& segments,
+                                 int maskRows, int maskColumns)
+    {
+      const int iRows = bits.rows(), iWords = bits.columns();
+      const int rOrig = maskRows / 2, cOrig = maskColumns / 2;
+      const int iFirstRow = rOrig, iLastRow = iRows - maskRows + rOrig;
+      const int iFirstColumn = cOrig, iLastColumn = columns - maskColumns + cOrig;
+
+      PiiMatrix<quint64> matResult(iRows, iWords);
+      // Pixels at which the mask fits in the image
+      QVector<quint64> vecValid(iWords);
+      for (int c=iFirstColumn; c<=iLastColumn; ++c)
+        vecValid[c >> 6] |= quint64(1) << (c & 63);
+      for (int r=iFirstRow; r<=iLastRow; ++r)
+        for (int w=0; w<iWords; ++w)
+          matResult(r,w) = vecValid[w];
+
+      QVector<quint64> vecShifted(iWords);
+      if (isRectangle(segments, maskRows))
+        {
+          const int iShift = segments[0].start - cOrig;
+          PiiMatrix<quint64> matWindows(verticalWindow(windowRows(bits, columns, segments[0].end - segments[0].start, AndBits()),
+                                                       maskRows, AndBits()));
+          for (int r=iFirstRow; r<=iLastRow; ++r)
+            {
+              shiftBits(matWindows.row(r - rOrig), vecShifted.data(), columns, iShift);
+              quint64* pResult = matResult.row(r);
+              for (int w=0; w<iWords; ++w)
+                pResult[w] &= vecShifted[w];
+            }
+          return matResult;
+        }
+
+      // Process all segments of the same length at once.
+      QVector<bool> vecDone(segments.size());
+      for (int i=0; i<segments.size(); ++i)
+        {
+          if (vecDone[i])
+            continue;
+          const int iLength = segments[i].end - segments[i].start;
+          PiiMatrix<quint64> matWindows(windowRows(bits, columns, iLength, AndBits()));
+          for (int j=i; j<segments.size(); ++j)
+            {
+              if (vecDone[j] || segments[j].end - segments[j].start != iLength)
+                continue;
+              vecDone[j] = true;
+              const int iShift = segments[j].start - cOrig;
+              for (int r=iFirstRow; r<=iLastRow; ++r)
+                {
+                  shiftBits(matWindows.row(r - rOrig + segments[j].row), vecShifted.data(), columns, iShift);
+                  quint64* pResult = matResult.row(r);
+                  for (int w=0; w<iWords; ++w)
+                    pResult[w] &= vecShifted[w];
+                }
+            }
+        }
+      return matResult;
+    }
+
+    PiiMatrix<quint64> dilateBits(const PiiMatrix<quint64>& bits, int columns,
+                                  const QVector<MaskSegment>& segments,
+                                  int maskRows, int maskColumns)
+    {
+      const int iRows = bits.rows(), iWords = bits.columns();
+      const int rOrig = maskRows / 2, cOrig = maskColumns / 2;
+
+      // Windows may start before the first column. Move the image
+      // right by iPad pixels to make room for them.
+      const int iPad = maskColumns, iPaddedColumns = columns + iPad;
+      const int iPaddedWords = wordCount(iPaddedColumns);
+      PiiMatrix<quint64> matPadded(iRows, iPaddedWords);
+      QVector<quint64> vecShifted(iPaddedWords);
+      for (int r=0; r<iRows; ++r)
+        {
+          for (int w=0; w<iWords; ++w)
+            vecShifted[w] = bits(r,w);
+          for (int w=iWords; w<iPaddedWords; ++w)
+            vecShifted[w] = 0;
+          shiftBits(vecShifted.constData(), matPadded.row(r), iPaddedColumns, -iPad);
+        }
+
+      PiiMatrix<quint64> matResult(iRows, iWords);
+      if (isRectangle(segments, maskRows))
+        {
+          // Pad with zero rows so that the vertical window may extend
+          // beyond the image.
+          const int iRowPad = maskRows - 1;
+          PiiMatrix<quint64> matWindows(windowRows(matPadded, iPaddedColumns,
+                                                   segments[0].end - segments[0].start, OrBits()));
+          PiiMatrix<quint64> matRows(iRows + 2*iRowPad, iPaddedWords);
+          for (int r=0; r<iRows; ++r)
+            for (int w=0; w<iPaddedWords; ++w)
+              matRows(r + iRowPad, w) = matWindows(r,w);
+          matWindows = verticalWindow(matRows, maskRows, OrBits());
+          const int iShift = cOrig - segments[0].end + 1 + iPad;
+          // Output row r collects input rows r+rOrig-maskRows+1 ... r+rOrig.
+          for (int r=0; r<iRows; ++r)
+            {
+              shiftBits(matWindows.row(r + rOrig - maskRows + 1 + iRowPad), vecShifted.data(), iPaddedColumns, iShift);
+              quint64* pResult = matResult.row(r);
+              for (int w=0; w<iWords; ++w)
+                pResult[w] = vecShifted[w];
+              clearTail(pResult, columns);
+            }
+          return matResult;
+        }
+
+      QVector<bool> vecDone(segments.size());
+      for (int i=0; i<segments.size(); ++i)
+        {
+          if (vecDone[i])
+            continue;
+          const int iLength = segments[i].end - segments[i].start;
+          PiiMatrix<quint64> matWindows(windowRows(matPadded, iPaddedColumns, iLength, OrBits()));
+          for (int j=i; j<segments.size(); ++j)
+            {
+              if (vecDone[j] || segments[j].end - segments[j].start != iLength)
+                continue;
+              vecDone[j] = true;
+              const int iShift = cOrig - segments[j].end + 1 + iPad;
+              for (int r=0; r<iRows; ++r)
+                {
+                  const int iSourceRow = r + rOrig - segments[j].row;
+                  if (iSourceRow < 0 || iSourceRow >= iRows)
+                    continue;
+                  shiftBits(matWindows.row(iSourceRow), vecShifted.data(), iPaddedColumns, iShift);
+                  quint64* pResult = matResult.row(r);
+                  for (int w=0; w<iWords; ++w)
+                    pResult[w] |= vecShifted[w];
+                }
+            }
+        }
+      for (int r=0; r<iRows; ++r)
+        clearTail(matResult.row(r), columns);
+      return matResult;
+    }
+
+    PiiMatrix<quint64> hitAndMissBits(const PiiMatrix<quint64>& bits, int columns,
+                                      const QVector<MaskSegment>& hits,
+                                      const QVector<MaskSegment>& misses,
+                                      int maskRows, int maskColumns)
+    {
+      PiiMatrix<quint64> matResult(erodeBits(bits, columns, hits, maskRows, maskColumns));
+      if (misses.isEmpty())
+        return matResult;
+      // Misses are hits in the inverted image.
+      PiiMatrix<quint64> matInverted(bits.rows(), bits.columns());
+      for (int r=0; r<bits.rows(); ++r)
+        {
+          for (int w=0; w<bits.columns(); ++w)
+            matInverted(r,w) = ~bits(r,w);
+          clearTail(matInverted.row(r), columns);
+        }
+      PiiMatrix<quint64> matMisses(erodeBits(matInverted, columns, misses, maskRows, maskColumns));
+      for (int r=0; r<bits.rows(); ++r)
+        for (int w=0; w<bits.columns(); ++w)
+          matResult(r,w) &= matMisses(r,w);
+      return matResult;
+    }
+
+    // Sets the pixels from start to end-1.
+    static void setBits(quint64* row, int start, int end)
+    {
+      for (int c=start; c<end; ++c)
+        row[c >> 6] |= quint64(1) << (c & 63);
+    }
+
+    // Extends a packed image by replicating the border pixels.
+    static PiiMatrix<quint64> replicateBits(const PiiMatrix<quint64>& bits, int columns,
+                                            int top, int bottom, int left, int right)
+    {
+      const int iRows = bits.rows(), iWords = bits.columns();
+      const int iColumns = columns + left + right, iExtendedWords = wordCount(iColumns);
+      PiiMatrix<quint64> matResult(iRows + top + bottom, iExtendedWords);
+      QVector<quint64> vecRow(iExtendedWords);
+      for (int r=0; r<matResult.rows(); ++r)
+        {
+          const quint64* pSource = bits.row(qBound(0, r - top, iRows - 1));
+          for (int w=0; w<iWords; ++w)
+            vecRow[w] = pSource[w];
+          quint64* pResult = matResult.row(r);
+          shiftBits(vecRow.constData(), pResult, iColumns, -left);
+          if (pSource[0] & 1)
+            setBits(pResult, 0, left);
+          if ((pSource[(columns-1) >> 6] >> ((columns-1) & 63)) & 1)
+            setBits(pResult, left + columns, iColumns);
+        }
+      return matResult;
+    }
+
+    PiiBitMatrix erodeBits(const PiiBitMatrix& image,
+                           const QVector<MaskSegment>& segments,
+                           int maskRows, int maskColumns,
+                           bool handleBorders)
+    {
+      if (!handleBorders || image.isEmpty())
+        return PiiBitMatrix(erodeBits(image.words(), image.columns(), segments, maskRows, maskColumns),
+                            image.columns());
+
+      const int rOrig = maskRows / 2, cOrig = maskColumns / 2;
+      const int iColumns = image.columns() + maskColumns - 1;
+      PiiMatrix<quint64> matEroded(erodeBits(replicateBits(image.words(), image.columns(),
+                                                           rOrig, maskRows - rOrig - 1,
+                                                           cOrig, maskColumns - cOrig - 1),
+                                             iColumns, segments, maskRows, maskColumns));
+      // Crop the extended area away.
+      PiiBitMatrix matResult(image.rows(), image.columns());
+      QVector<quint64> vecShifted(matEroded.columns());
+      for (int r=0; r<image.rows(); ++r)
+        {
+          shiftBits(matEroded.row(r + rOrig), vecShifted.data(), iColumns, cOrig);
+          quint64* pResult = matResult.row(r);
+          for (int w=0; w<matResult.wordsPerRow(); ++w)
+            pResult[w] = vecShifted[w];
+          matResult.clearTail(r);
+        }
+      return matResult;
+    }
+
+    int thinBits(PiiMatrix<quint64>& bits, int columns, int amount)
+    {
+      QVector<MaskSegment> vecHits[8], vecMisses[8];
+      for (int m=0; m<8; ++m)
+        hitAndMissSegments(borderMasks[m][0], borderMasks[m][1], vecHits[m], vecMisses[m]);
+
+      int iIterations = 0;
+      while (amount < 0 || iIterations < amount)
+        {
+          PiiMatrix<quint64> matPrevious(bits);
+          // Take off edges in each direction
+          for (int m=8; m--;)
+            {
+              PiiMatrix<quint64> matHits(hitAndMissBits(bits, columns, vecHits[m], vecMisses[m],
+                                                        borderMasks[m][0].rows(), borderMasks[m][0].columns()));
+              for (int r=0; r<bits.rows(); ++r)
+                for (int w=0; w<bits.columns(); ++w)
+                  bits(r,w) &= ~matHits(r,w);
+            }
+          ++iIterations;
+          if (amount < 0 && Pii::equals(bits, matPrevious))
+            break;
+        }
+      return iIterations;
+    }
+  }
+
+  PiiBitMatrix thin(const PiiBitMatrix& image, int amount)
+  {
+    if (amount == 0)
+      return image;
+    // The border masks don't fit. The byte image version removes
+    // everything in this case.
+    if (image.rows() < 3 || image.columns() < 3)
+      return PiiBitMatrix(image.rows(), image.columns());
+    PiiMatrix<quint64> matBits(image.words());
+    Private::thinBits(matBits, image.columns(), amount);
+    return PiiBitMatrix(matBits, image.columns());
+  }
 }
@@ -17,6 +17,8 @@
 #define _PIIMORPHOLOGY_H
 
 #include <PiiMatrix.h>
+#include <PiiBitMatrix.h>
+#include <QVector>
 #include <iostream>
 #include "PiiImageGlobal.h"
 #include <PiiTemplateExport.h>
@@ -370,6 +372,130 @@ namespace PiiImage
    */
   template <class Matrix>
   PiiMatrix<typename Matrix::value_type> shrink(const Matrix& image, int amount = 1);
+
+  /**
+   * Erodes a bit-packed binary image. All non-zero entries in *mask*
+   * are treated as ones. The result is equal to that of the byte
+   * image version with a binary mask, but the image is processed 64
+   * pixels at a time.
+   */
+  template <class U>
+  PiiBitMatrix erode(const PiiBitMatrix& image, const PiiMatrix<U>& mask, bool handleBorders = false);
+
+  /**
+   * Dilates a bit-packed binary image. All non-zero entries in *mask*
+   * are treated as ones.
+   */
+  template <class U>
+  PiiBitMatrix dilate(const PiiBitMatrix& image, const PiiMatrix<U>& mask);
+
+  /**
+   * Morphological opening of a bit-packed binary image.
+   */
+  template <class U>
+  inline PiiBitMatrix open(const PiiBitMatrix& image, const PiiMatrix<U>& mask)
+  { return dilate(erode(image,mask),mask); }
+  /**
+   * Morphological closing of a bit-packed binary image.
+   */
+  template <class U>
+  inline PiiBitMatrix close(const PiiBitMatrix& image, const PiiMatrix<U>& mask)
+  { return erode(dilate(image,mask), mask); }
+
+  /**
+   * Hit-and-miss transform for a bit-packed binary image. Significant
+   * non-zero entries in *mask* must hit set bits, and significant
+   * zeros must hit unset bits.
+   */
+  template <class U>
+  PiiBitMatrix hitAndMiss(const PiiBitMatrix& image,
+                          const PiiMatrix<U>& mask,
+                          const PiiMatrix<U>& significance);
+
+  /**
+   * Top-hat transform for a bit-packed binary image.
+   */
+  template <class U>
+  PiiBitMatrix topHat(const PiiBitMatrix& image, const PiiMatrix<U>& mask);
+
+  /**
+   * Bottom-hat transform for a bit-packed binary image.
+   */
+  template <class U>
+  PiiBitMatrix bottomHat(const PiiBitMatrix& image, const PiiMatrix<U>& mask);
+
+  /**
+   * Performs a morphological operation on a bit-packed binary image.
+   */
+  template <class U>
+  PiiBitMatrix morphology(const PiiBitMatrix& image, const PiiMatrix<U>& mask,
+                          MorphologyOperation type, bool handleBorders = false);
+
+  /**
+   * Thins the objects in a bit-packed binary image.
+   */
+  PII_IMAGE_EXPORT PiiBitMatrix thin(const PiiBitMatrix& image, int amount = 1);
+
+  /// @hide
+  namespace Private
+  {
+    /* Binary morphology is performed on images packed 64 pixels per
+     * word. Pixel x on a row is stored in bit x%64 of word x/64. Bits
+     * beyond the last column are always zero.
+     *
+     * Structuring elements are decomposed into horizontal segments. A
+     * segment of length L is applied to a whole row with log2(L)
+     * shifted word operations, and the rows are combined one word
+     * (64 pixels) at a time. If the mask is a rectangle (this includes
+     * lines), the rows are combined with the van Herk/Gil-Werman
+     * algorithm, which takes a constant number of operations per word
+     * irrespective of mask size.
+     */
+    struct MaskSegment
+    {
+      int row, start, end;
+    };
+
+    // Collects the runs of ones in mask. Returns false if the mask
+    // contains values other than zero and one.
+    template <class U> bool maskSegments(const PiiMatrix<U>& mask, QVector<MaskSegment>& segments);
+    // Collects the runs of significant ones (hits) and significant
+    // zeros (misses) in a hit-and-miss mask.
+    template <class U> bool hitAndMissSegments(const PiiMatrix<U>& mask, const PiiMatrix<U>& significance,
+                                               QVector<MaskSegment>& hits, QVector<MaskSegment>& misses);
+
+    // Collects the runs of non-zero entries in mask.
+    template <class U> void nonZeroSegments(const PiiMatrix<U>& mask, QVector<MaskSegment>& segments);
+
+    template <class Matrix> PiiMatrix<quint64> packOddBits(const Matrix& image);
+    template <class Matrix> PiiMatrix<quint64> packNonZeroBits(const Matrix& image);
+    template <class T> PiiMatrix<T> unpackBits(const PiiMatrix<quint64>& bits, int columns);
+
+    /* Erodes a packed image. Only the pixels at which the whole mask
+     * fits in the image can be set in the result.
+     */
+    PII_IMAGE_EXPORT PiiMatrix<quint64> erodeBits(const PiiMatrix<quint64>& bits, int columns,
+                                                  const QVector<MaskSegment>& segments,
+                                                  int maskRows, int maskColumns);
+    // Dilates a packed image. Zeros are assumed outside of the image.
+    PII_IMAGE_EXPORT PiiMatrix<quint64> dilateBits(const PiiMatrix<quint64>& bits, int columns,
+                                                   const QVector<MaskSegment>& segments,
+                                                   int maskRows, int maskColumns);
+    PII_IMAGE_EXPORT PiiMatrix<quint64> hitAndMissBits(const PiiMatrix<quint64>& bits, int columns,
+                                                       const QVector<MaskSegment>& hits,
+                                                       const QVector<MaskSegment>& misses,
+                                                       int maskRows, int maskColumns);
+    // Erodes a bit matrix. If handleBorders is true, the image is
+    // extended by replicating the border pixels.
+    PII_IMAGE_EXPORT PiiBitMatrix erodeBits(const PiiBitMatrix& image,
+                                            const QVector<MaskSegment>& segments,
+                                            int maskRows, int maskColumns,
+                                            bool handleBorders);
+    // Thins a packed image. Returns the number of iterations
+    // performed. If amount < 0, iterates until convergence.
+    PII_IMAGE_EXPORT int thinBits(PiiMatrix<quint64>& bits, int columns, int amount);
+  }
+  /// @endhide
 }
 
 #include <PiiMorphology-templates.h>
@@ -94,6 +94,171 @@ namespace PiiImage
       }
   }
 
+  void calculateProperties(const QVector<LabeledRun>& runs, int labels, PiiMatrix<int>& areas,
+                           PiiMatrix<int>& centroids, PiiMatrix<int>& bbox)
+  {
+    if (labels == 0)
+      for (int i=0; i<runs.size(); ++i)
+        labels = qMax(labels, runs[i].label);
+
+    areas = PiiMatrix<int>(labels,1);
+    centroids = PiiMatrix<int>(labels,2);
+    PiiMatrix<double> matTmpCentroids(labels,2);
+    bbox = PiiMatrix<int>(labels,4);
+    for (int i=0; i<labels; i++)
+      {
+        bbox(i,0) = INT_MAX;
+        bbox(i,1) = INT_MAX;
+      }
+
+    for (int i=0; i<runs.size(); ++i)
+      {
+        const LabeledRun& run = runs[i];
+        const int label = run.label - 1;
+        const int iLength = run.end - run.start;
+        if (run.start < bbox(label,0)) //left
+          bbox(label,0) = run.start;
+        if (run.row < bbox(label,1)) //top
+          bbox(label,1) = run.row;
+        if (run.end - 1 > bbox(label,2)) //right
+          bbox(label,2) = run.end - 1;
+        // Runs are in row order
+        bbox(label,3) = run.row; //bottom
+        areas(label,0) += iLength;
+        // Sum of column indices start, ..., end-1
+        matTmpCentroids(label,0) += 0.5 * double(run.start + run.end - 1) * iLength;
+        matTmpCentroids(label,1) += double(run.row) * iLength;
+      }
+
+    // Convert coordinates to width, height
+    for (int i=0; i<labels; i++)
+      {
+        bbox(i,2) = bbox(i,2) - bbox(i,0) + 1;
+        bbox(i,3) = bbox(i,3) - bbox(i,1) + 1;
+        centroids(i,0) = (int)(matTmpCentroids(i,0) / (double)areas(i,0) + 0.5);
+        centroids(i,1) = (int)(matTmpCentroids(i,1) / (double)areas(i,0) + 0.5);
+      }
+  }
+
+  void ObjectFeatureAccumulator::Object::axes(double* major, double* minor) const
+  {
+    const double dMean = 0.5 * (mu20() + mu02());
+    const double dDiff = 0.5 * (mu20() - mu02());
+    const double dRoot = std::sqrt(dDiff * dDiff + mu11() * mu11());
+    if (major != 0) *major = std::sqrt(dMean + dRoot);
+    if (minor != 0) *minor = std::sqrt(qMax(0.0, dMean - dRoot));
+  }
+
+  void ObjectFeatureAccumulator::operator() (const LabeledRun& run)
+  {
+    if (run.row != _iCurrentRow)
+      {
+        _vecPreviousRow.clear();
+        if (run.row == _iCurrentRow + 1)
+          qSwap(_vecPreviousRow, _vecCurrentRow);
+        _vecCurrentRow.clear();
+        _iCurrentRow = run.row;
+        _iPreviousIndex = 0;
+      }
+    _vecCurrentRow.append(run);
+
+    if (run.label > _vecObjects.size())
+      {
+        Object obj = { 0, run.start, run.row, run.end - 1, run.row, 0, 0, 0, 0, 0, 0 };
+        _vecObjects.append(obj);
+      }
+    Object& obj = _vecObjects[run.label - 1];
+
+    const int iLength = run.end - run.start;
+    const double dStart = run.start, dEnd = run.end - 1, dRow = run.row;
+    if (run.start < obj.left)
+      obj.left = run.start;
+    if (run.end - 1 > obj.right)
+      obj.right = run.end - 1;
+    obj.bottom = run.row;
+    obj.area += iLength;
+    // Sums of x and x^2 over x = start, ..., end-1
+    const double dSumX = 0.5 * (dStart + dEnd) * iLength;
+    const double dSumXX = (dEnd * (dEnd + 1) * (2 * dEnd + 1) - (dStart - 1) * dStart * (2 * dStart - 1)) / 6;
+    obj.sumX += dSumX;
+    obj.sumY += dRow * iLength;
+    obj.sumXX += dSumXX;
+    obj.sumYY += dRow * dRow * iLength;
+    obj.sumXY += dRow * dSumX;
+
+    // Each pixel edge shared with a run on the previous row is
+    // internal to the object.
+    obj.perimeter += 2 * (iLength + 1);
+    while (_iPreviousIndex < _vecPreviousRow.size() &&
+           _vecPreviousRow[_iPreviousIndex].end <= run.start)
+      ++_iPreviousIndex;
+    for (int i = _iPreviousIndex; i < _vecPreviousRow.size() && _vecPreviousRow[i].start < run.end; ++i)
+      obj.perimeter -= 2 * (qMin(run.end, _vecPreviousRow[i].end) -
+                            qMax(run.start, _vecPreviousRow[i].start));
+  }
+
+  void ObjectFeatureAccumulator::clear()
+  {
+    _vecObjects.clear();
+    _vecPreviousRow.clear();
+    _vecCurrentRow.clear();
+    _iCurrentRow = -2;
+    _iPreviousIndex = 0;
+  }
+
+  PiiMatrix<int> ObjectFeatureAccumulator::areas() const
+  {
+    PiiMatrix<int> matResult(_vecObjects.size(), 1);
+    for (int i=0; i<_vecObjects.size(); ++i)
+      matResult(i,0) = _vecObjects[i].area;
+    return matResult;
+  }
+
+  PiiMatrix<int> ObjectFeatureAccumulator::centroids() const
+  {
+    PiiMatrix<int> matResult(_vecObjects.size(), 2);
+    for (int i=0; i<_vecObjects.size(); ++i)
+      {
+        matResult(i,0) = (int)(_vecObjects[i].centroidX() + 0.5);
+        matResult(i,1) = (int)(_vecObjects[i].centroidY() + 0.5);
+      }
+    return matResult;
+  }
+
+  PiiMatrix<int> ObjectFeatureAccumulator::boundingBoxes() const
+  {
+    PiiMatrix<int> matResult(_vecObjects.size(), 4);
+    for (int i=0; i<_vecObjects.size(); ++i)
+      {
+        const Object& obj = _vecObjects[i];
+        matResult(i,0) = obj.left;
+        matResult(i,1) = obj.top;
+        matResult(i,2) = obj.right - obj.left + 1;
+        matResult(i,3) = obj.bottom - obj.top + 1;
+      }
+    return matResult;
+  }
+
+  PiiMatrix<int> ObjectFeatureAccumulator::perimeters() const
+  {
+    PiiMatrix<int> matResult(_vecObjects.size(), 1);
+    for (int i=0; i<_vecObjects.size(); ++i)
+      matResult(i,0) = _vecObjects[i].perimeter;
+    return matResult;
+  }
+
+  PiiMatrix<double> ObjectFeatureAccumulator::moments() const
+  {
+    PiiMatrix<double> matResult(_vecObjects.size(), 3);
+    for (int i=0; i<_vecObjects.size(); ++i)
+      {
+        matResult(i,0) = _vecObjects[i].mu20();
+        matResult(i,1) = _vecObjects[i].mu02();
+        matResult(i,2) = _vecObjects[i].mu11();
+      }
+    return matResult;
+  }
+
   template <class T> PiiMatrix<double> calculateDirection(const PiiMatrix<T>& mat,
                                                           T label,
                                                           double* length,
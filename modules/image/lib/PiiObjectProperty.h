@@ -18,6 +18,7 @@
 
 #include <PiiMatrix.h>
 #include <PiiMath.h>
+#include "PiiLabeling.h"
 
 #include <PiiMatrixUtil.h>
 #include <QDebug>
@@ -46,6 +47,148 @@ namespace PiiImage
   template <class T> void calculateProperties(const PiiMatrix<T>& mat, int labels, PiiMatrix<int>& areas,
                                               PiiMatrix<int>& centroids, PiiMatrix<int>& bbox);
 
+  /**
+   * Calculates areas, centroids and bounding boxes for objects stored
+   * as labeled runs (see [labelRuns()]). The output matrices are
+   * equal to those calculated from the corresponding label image, but
+   * each run is processed as a whole instead of pixel by pixel.
+   *
+   * @param runs labeled runs
+   *
+   * @param labels the number of labeled objects. Must equal to the
+   * maximum label in `runs`. Set to zero if unknown.
+   */
+  inline void calculateProperties(const QVector<LabeledRun>& runs, int labels, PiiMatrix<int>& areas,
+                                  PiiMatrix<int>& centroids, PiiMatrix<int>& bbox);
+
+
+  /**
+   * Accumulates object properties from labeled runs in a single pass.
+   * The accumulator is designed to be passed to [labelRuns()], which
+   * calls it for each run as soon as the run's label is known. This
+   * way areas, bounding boxes, moments and perimeters are collected
+   * while labeling, and neither the input image nor a label image
+   * needs to be scanned again.
+   *
+   * Runs must be added in raster order, and the labels must be
+   * consecutive integers starting at one, in the order objects are
+   * first encountered. [labelRuns()] guarantees both.
+   *
+   * ~~~(c++)
+   * PiiImage::ObjectFeatureAccumulator features;
+   * PiiImage::labelRuns(matBinary,
+   *                     std::bind2nd(std::not_equal_to<uchar>(), 0),
+   *                     PiiImage::Connect8,
+   *                     features);
+   * PiiMatrix<int> matAreas(features.areas());
+   * double dAngle = features.object(0).orientation();
+   * ~~~
+   */
+  class ObjectFeatureAccumulator
+  {
+  public:
+    /**
+     * Accumulated properties of a single object.
+     */
+    struct Object
+    {
+      /// The number of pixels in the object.
+      int area;
+      /// The bounding box of the object. Right and bottom are inclusive.
+      int left, top, right, bottom;
+      /**
+       * The number of pixel edges between the object and the
+       * background (crack perimeter).
+       */
+      int perimeter;
+      /// Raw first and second moments.
+      double sumX, sumY, sumXX, sumYY, sumXY;
+
+      /// Returns the x coordinate of the center of mass.
+      double centroidX() const { return sumX / area; }
+      /// Returns the y coordinate of the center of mass.
+      double centroidY() const { return sumY / area; }
+      /// Returns the central second moment along the x axis.
+      double mu20() const { return sumXX / area - centroidX() * centroidX(); }
+      /// Returns the central second moment along the y axis.
+      double mu02() const { return sumYY / area - centroidY() * centroidY(); }
+      /// Returns the central mixed second moment.
+      double mu11() const { return sumXY / area - centroidX() * centroidY(); }
+      /**
+       * Returns the angle of the major axis in radians. Zero points
+       * right, and y grows downwards as in the image.
+       */
+      double orientation() const { return 0.5 * std::atan2(2 * mu11(), mu20() - mu02()); }
+      /**
+       * Returns the standard deviations of the pixel coordinates along
+       * the major and minor axes.
+       */
+      inline void axes(double* major, double* minor) const;
+    };
+
+    ObjectFeatureAccumulator() : _iCurrentRow(-2), _iPreviousIndex(0) {}
+
+    /**
+     * Adds *run* to the object it belongs to.
+     */
+    inline void operator() (const LabeledRun& run);
+
+    /**
+     * Removes all collected objects.
+     */
+    inline void clear();
+
+    /**
+     * Returns the number of objects seen so far.
+     */
+    int objectCount() const { return _vecObjects.size(); }
+
+    /**
+     * Returns the properties of the object at *index*. Note that
+     * the index of label N is N-1.
+     */
+    const Object& object(int index) const { return _vecObjects[index]; }
+
+    /**
+     * Returns the properties of all objects.
+     */
+    const QVector<Object>& objects() const { return _vecObjects; }
+
+    /**
+     * Returns the areas of the objects as a N-by-1 matrix (see
+     * [calculateProperties()]).
+     */
+    inline PiiMatrix<int> areas() const;
+    /**
+     * Returns the rounded centroids of the objects as a N-by-2 matrix
+     * (see [calculateProperties()]).
+     */
+    inline PiiMatrix<int> centroids() const;
+    /**
+     * Returns the bounding boxes of the objects as a N-by-4 matrix
+     * (see [calculateProperties()]).
+     */
+    inline PiiMatrix<int> boundingBoxes() const;
+    /**
+     * Returns the crack perimeters of the objects as a N-by-1 matrix.
+     */
+    inline PiiMatrix<int> perimeters() const;
+    /**
+     * Returns the central second moments of the objects as a N-by-3
+     * matrix. Each row stores mu20, mu02 and mu11, in this order.
+     */
+    inline PiiMatrix<double> moments() const;
+
+  private:
+    QVector<Object> _vecObjects;
+    // The runs on the two latest rows for perimeter estimation.
+    QVector<LabeledRun> _vecPreviousRow, _vecCurrentRow;
+    int _iCurrentRow;
+    // The first run on the previous row that may still touch the
+    // next run on the current row.
+    int _iPreviousIndex;
+  };
+
 
   /**
    * Calculates the dominant orientation of an object in `mat`. This
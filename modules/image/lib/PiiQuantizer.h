@@ -18,11 +18,41 @@
 
 #include <algorithm>
 #include <PiiMatrix.h>
+#include <QVector>
+#include "PiiQuantizerKernels.h"
+
+namespace PiiImage
+{
+  /**
+   * Tells if PiiQuantizer<T> builds a lookup table that maps each
+   * value of `T` to a quantization level. `size` is the number of
+   * table entries (zero if there is no table), and `offset` is
+   * added to a value to get its index.
+   *
+   * @internal
+   */
+  template <class T> struct QuantizerTable { enum { size = 0, offset = 0 }; };
+  /// @internal
+  template <> struct QuantizerTable<unsigned char> { enum { size = 256, offset = 0 }; };
+  /// @internal
+  template <> struct QuantizerTable<signed char> { enum { size = 256, offset = 128 }; };
+  /// @internal
+  template <> struct QuantizerTable<char> { enum { size = 256, offset = char(-1) < 0 ? 128 : 0 }; };
+  /// @internal
+  template <> struct QuantizerTable<unsigned short> { enum { size = 65536, offset = 0 }; };
+  /// @internal
+  template <> struct QuantizerTable<short> { enum { size = 65536, offset = 32768 }; };
+}
 
 /**
  * A class that quantizes (floating point) values to integers. Each
  * quantization level corresponds to a continuous range of values.
  *
+ * With 8 and 16-bit integer types, the quantizer maps each possible
+ * value to its level in advance when the limits are set. After that,
+ * quantizing a value costs one table lookup instead of a binary
+ * search over the limits. Matrices of `int` and `float` values with
+ * at most 64 limits are quantized with SIMD instructions.
  */
 template <class T> class PiiQuantizer
 {
@@ -35,7 +65,7 @@ public:
    * Create a new quantizer with quantization limits. See [setLimits()]
    * for details.
    */
-  PiiQuantizer(const PiiMatrix<T>& limits) : _matLimits(limits) {}
+  PiiQuantizer(const PiiMatrix<T>& limits) : _matLimits(limits) { createTable(); }
 
   /**
    * Quantize a (floating-point) value to an integer (quantization
@@ -43,6 +73,41 @@ public:
    */
   int quantize(T value) const;
 
+  /**
+   * Quantizes all elements in *values* and returns the levels. The
+   * result type `U` must be able to hold [maxValue()].
+   *
+   * ~~~(c++)
+   * PiiQuantizer<float> q(PiiMatrix<float>(1,3, 0.1, 0.5, 0.7));
+   * PiiMatrix<uchar> matLevels(q.quantize<uchar>(matFeatures));
+   * ~~~
+   */
+  template <class U> PiiMatrix<U> quantize(const PiiMatrix<T>& values) const;
+
+  /**
+   * Returns the lookup table that maps values to levels. Entry `v +
+   * PiiImage::QuantizerTable<T>::offset` holds the level of value
+   * `v`. If `T` has no lookup table or there are no limits, an empty
+   * matrix will be returned.
+   */
+  PiiMatrix<int> lookupTable() const { return _matTable; }
+
+  /**
+   * Creates a lookup table that maps each value of an 8 or 16-bit
+   * integer type `U` to the level the value would get if it was
+   * converted to `T` and quantized. Entry `v +
+   * PiiImage::QuantizerTable<U>::offset` holds the level of `v`. If
+   * `U` is not an 8 or 16-bit integer type or there are no limits,
+   * an empty matrix will be returned.
+   *
+   * ~~~(c++)
+   * PiiQuantizer<double> q(PiiMatrix<double>(1,2, 63.5, 127.5));
+   * PiiMatrix<int> matTable(q.createLookupTable<uchar>());
+   * // matTable(63) == 0, matTable(64) == 1
+   * ~~~
+   */
+  template <class U> PiiMatrix<int> createLookupTable() const;
+
   /**
    * Get the number of quantization levels.
    */
@@ -65,7 +130,7 @@ public:
    * q.quantize(-1.0); // returns 0
    * ~~~
    */
-  void setLimits(const PiiMatrix<T>& limits) { _matLimits = limits; }
+  void setLimits(const PiiMatrix<T>& limits) { _matLimits = limits; createTable(); }
   /**
    * Get the current limits.
    */
@@ -89,7 +154,11 @@ public:
   static PiiMatrix<T> divideEqually(PiiMatrix<T>& data, int levels);
 
 private:
+  int search(T value) const;
+  void createTable();
+
   PiiMatrix<T> _matLimits;
+  PiiMatrix<int> _matTable;
 
   static PiiMatrix<T> divideEqually(typename PiiMatrix<T>::iterator begin,
                                     typename PiiMatrix<T>::iterator end,
@@ -115,6 +184,13 @@ PiiMatrix<T> PiiQuantizer<T>::divideEqually(typename PiiMatrix<T>::iterator begi
 }
 
 template <class T> int PiiQuantizer<T>::quantize(T value) const
+{
+  if (PiiImage::QuantizerTable<T>::size != 0 && !_matTable.isEmpty())
+    return _matTable.row(0)[int(value) + PiiImage::QuantizerTable<T>::offset];
+  return search(value);
+}
+
+template <class T> int PiiQuantizer<T>::search(T value) const
 {
   int start = 0, end = _matLimits.columns();
   while (start<end)
@@ -128,4 +204,70 @@ template <class T> int PiiQuantizer<T>::quantize(T value) const
   return start;
 }
 
+template <class T> void PiiQuantizer<T>::createTable()
+{
+  _matTable = createLookupTable<T>();
+}
+
+template <class T> template <class U> PiiMatrix<int> PiiQuantizer<T>::createLookupTable() const
+{
+  typedef PiiImage::QuantizerTable<U> Table;
+  if (Table::size == 0 || _matLimits.isEmpty())
+    return PiiMatrix<int>();
+
+  // The limits are sorted. Sweep the values in increasing order and
+  // step the level each time a limit is passed.
+  PiiMatrix<int> matTable(PiiMatrix<int>::uninitialized(1, Table::size));
+  int* pTable = matTable.row(0);
+  const T* pLimits = _matLimits.row(0);
+  const int iLimits = _matLimits.columns();
+  int iLevel = 0;
+  for (int i=0; i<Table::size; ++i)
+    {
+      const T value = T(U(i - Table::offset));
+      while (iLevel < iLimits && !(pLimits[iLevel] > value))
+        ++iLevel;
+      pTable[i] = iLevel;
+    }
+  return matTable;
+}
+
+template <class T> template <class U> PiiMatrix<U> PiiQuantizer<T>::quantize(const PiiMatrix<T>& values) const
+{
+  const int iRows = values.rows(), iColumns = values.columns();
+  PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(iRows, iColumns));
+  if (PiiImage::QuantizerTable<T>::size != 0 && !_matTable.isEmpty())
+    {
+      const int* pTable = _matTable.row(0) + PiiImage::QuantizerTable<T>::offset;
+      for (int r=0; r<iRows; ++r)
+        {
+          const T* pValues = values.row(r);
+          U* pLevels = matResult.row(r);
+          for (int c=0; c<iColumns; ++c)
+            pLevels[c] = U(pTable[int(pValues[c])]);
+        }
+      return matResult;
+    }
+
+  const T* pLimits = _matLimits.isEmpty() ? 0 : _matLimits.row(0);
+  QVector<int> vecLevels(iColumns);
+  for (int r=0; r<iRows; ++r)
+    {
+      const T* pValues = values.row(r);
+      U* pLevels = matResult.row(r);
+      if (PiiImage::QuantizerKernel<T>::quantize(pValues, iColumns, pLimits, _matLimits.columns(),
+                                                 vecLevels.data()))
+        {
+          for (int c=0; c<iColumns; ++c)
+            pLevels[c] = U(vecLevels[c]);
+        }
+      else
+        {
+          for (int c=0; c<iColumns; ++c)
+            pLevels[c] = U(search(pValues[c]));
+        }
+    }
+  return matResult;
+}
+
 #endif //_PIIQUANTIZER_H
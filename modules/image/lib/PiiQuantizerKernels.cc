@@ -0,0 +1,263 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiQuantizerKernels.h"
+
+#include <PiiCpuDispatcher.h>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_QUANTIZER_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_QUANTIZER_AVX2 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_QUANTIZER_NEON 1
+#endif
+
+namespace PiiImage
+{
+  namespace
+  {
+    // The columns that don't fill a whole vector. NaN is not greater
+    // than any limit and goes to the last level, like in the binary
+    // search.
+    template <class T> void quantizeTail(const T* values, int c, int count,
+                                         const T* limits, int limitCount, int* levels)
+    {
+      for (; c<count; ++c)
+        {
+          int iLevel = limitCount;
+          for (int l=0; l<limitCount; ++l)
+            iLevel -= limits[l] > values[c] ? 1 : 0;
+          levels[c] = iLevel;
+        }
+    }
+
+    typedef void (*IntFunction)(const int*, int, const int*, int, int*);
+    typedef void (*FloatFunction)(const float*, int, const float*, int, int*);
+  }
+
+  /* A comparison mask is -1 where the limit is greater than the
+     value. Adding the masks to the number of limits gives the level.
+     The loop is stamped out with a macro because all functions called
+     from an AVX2 loop must have the same target attribute.
+   */
+#define PII_QUANTIZER_LOOP(TARGET)                                      \
+  template <class Ops> TARGET                                           \
+  void quantize(const typename Ops::Type* values, int count,            \
+                const typename Ops::Type* limits, int limitCount,       \
+                int* levels)                                            \
+  {                                                                     \
+    typedef typename Ops::Vec Vec;                                      \
+    typedef typename Ops::IntVec IntVec;                                \
+    const IntVec start = Ops::setInt(limitCount);                       \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const Vec value = Ops::load(values + c);                        \
+        IntVec level = start;                                           \
+        for (int l=0; l<limitCount; ++l)                                \
+          level = Ops::add(level, Ops::greater(Ops::set(limits[l]), value)); \
+        Ops::store(levels + c, level);                                  \
+      }                                                                 \
+    quantizeTail(values, c, count, limits, limitCount, levels);         \
+  }
+
+#ifdef PII_QUANTIZER_SSE2
+  namespace Sse2
+  {
+    struct IntOps
+    {
+      typedef int Type;
+      typedef __m128i Vec;
+      typedef __m128i IntVec;
+      enum { Width = 4 };
+      static inline __m128i load(const int* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+      static inline __m128i set(int value) { return _mm_set1_epi32(value); }
+      static inline __m128i setInt(int value) { return _mm_set1_epi32(value); }
+      static inline __m128i greater(__m128i a, __m128i b) { return _mm_cmpgt_epi32(a, b); }
+      static inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+      static inline void store(int* data, __m128i value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value); }
+    };
+
+    struct FloatOps
+    {
+      typedef float Type;
+      typedef __m128 Vec;
+      typedef __m128i IntVec;
+      enum { Width = 4 };
+      static inline __m128 load(const float* data) { return _mm_loadu_ps(data); }
+      static inline __m128 set(float value) { return _mm_set1_ps(value); }
+      static inline __m128i setInt(int value) { return _mm_set1_epi32(value); }
+      static inline __m128i greater(__m128 a, __m128 b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+      static inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+      static inline void store(int* data, __m128i value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value); }
+    };
+
+    PII_QUANTIZER_LOOP(static)
+
+    static void quantizeInt(const int* values, int count, const int* limits, int limitCount, int* levels)
+    {
+      quantize<IntOps>(values, count, limits, limitCount, levels);
+    }
+    static void quantizeFloat(const float* values, int count, const float* limits, int limitCount, int* levels)
+    {
+      quantize<FloatOps>(values, count, limits, limitCount, levels);
+    }
+  }
+#endif
+
+#ifdef PII_QUANTIZER_AVX2
+  namespace Avx2
+  {
+#  define PII_AVX2 PII_TARGET("avx2")
+
+    struct IntOps
+    {
+      typedef int Type;
+      typedef __m256i Vec;
+      typedef __m256i IntVec;
+      enum { Width = 8 };
+      PII_AVX2 static inline __m256i load(const int* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+      PII_AVX2 static inline __m256i set(int value) { return _mm256_set1_epi32(value); }
+      PII_AVX2 static inline __m256i setInt(int value) { return _mm256_set1_epi32(value); }
+      PII_AVX2 static inline __m256i greater(__m256i a, __m256i b) { return _mm256_cmpgt_epi32(a, b); }
+      PII_AVX2 static inline __m256i add(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+      PII_AVX2 static inline void store(int* data, __m256i value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value); }
+    };
+
+    struct FloatOps
+    {
+      typedef float Type;
+      typedef __m256 Vec;
+      typedef __m256i IntVec;
+      enum { Width = 8 };
+      PII_AVX2 static inline __m256 load(const float* data) { return _mm256_loadu_ps(data); }
+      PII_AVX2 static inline __m256 set(float value) { return _mm256_set1_ps(value); }
+      PII_AVX2 static inline __m256i setInt(int value) { return _mm256_set1_epi32(value); }
+      // Ordered comparison: false if either operand is NaN.
+      PII_AVX2 static inline __m256i greater(__m256 a, __m256 b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+      PII_AVX2 static inline __m256i add(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+      PII_AVX2 static inline void store(int* data, __m256i value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value); }
+    };
+
+    PII_QUANTIZER_LOOP(PII_AVX2 static)
+
+    PII_AVX2 static void quantizeInt(const int* values, int count, const int* limits, int limitCount, int* levels)
+    {
+      quantize<IntOps>(values, count, limits, limitCount, levels);
+    }
+    PII_AVX2 static void quantizeFloat(const float* values, int count, const float* limits, int limitCount, int* levels)
+    {
+      quantize<FloatOps>(values, count, limits, limitCount, levels);
+    }
+
+#  undef PII_AVX2
+  }
+#endif
+
+#ifdef PII_QUANTIZER_NEON
+  namespace Neon
+  {
+    struct IntOps
+    {
+      typedef int Type;
+      typedef int32x4_t Vec;
+      typedef int32x4_t IntVec;
+      enum { Width = 4 };
+      static inline int32x4_t load(const int* data) { return vld1q_s32(data); }
+      static inline int32x4_t set(int value) { return vdupq_n_s32(value); }
+      static inline int32x4_t setInt(int value) { return vdupq_n_s32(value); }
+      static inline int32x4_t greater(int32x4_t a, int32x4_t b) { return vreinterpretq_s32_u32(vcgtq_s32(a, b)); }
+      static inline int32x4_t add(int32x4_t a, int32x4_t b) { return vaddq_s32(a, b); }
+      static inline void store(int* data, int32x4_t value) { vst1q_s32(data, value); }
+    };
+
+    struct FloatOps
+    {
+      typedef float Type;
+      typedef float32x4_t Vec;
+      typedef int32x4_t IntVec;
+      enum { Width = 4 };
+      static inline float32x4_t load(const float* data) { return vld1q_f32(data); }
+      static inline float32x4_t set(float value) { return vdupq_n_f32(value); }
+      static inline int32x4_t setInt(int value) { return vdupq_n_s32(value); }
+      static inline int32x4_t greater(float32x4_t a, float32x4_t b) { return vreinterpretq_s32_u32(vcgtq_f32(a, b)); }
+      static inline int32x4_t add(int32x4_t a, int32x4_t b) { return vaddq_s32(a, b); }
+      static inline void store(int* data, int32x4_t value) { vst1q_s32(data, value); }
+    };
+
+    PII_QUANTIZER_LOOP(static)
+
+    static void quantizeInt(const int* values, int count, const int* limits, int limitCount, int* levels)
+    {
+      quantize<IntOps>(values, count, limits, limitCount, levels);
+    }
+    static void quantizeFloat(const float* values, int count, const float* limits, int limitCount, int* levels)
+    {
+      quantize<FloatOps>(values, count, limits, limitCount, levels);
+    }
+  }
+#endif
+
+#undef PII_QUANTIZER_LOOP
+
+  /* There is no generic implementation. A null function makes
+     PiiQuantizer use a binary search.
+   */
+#if defined(PII_QUANTIZER_AVX2)
+#  define PII_QUANTIZER_DISPATCHER(TYPE, FUNCTION)                      \
+  PiiCpuDispatcher<TYPE>()                                              \
+  .add(Pii::CpuAvx2, Avx2::FUNCTION)                                    \
+  .add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_QUANTIZER_SSE2)
+#  define PII_QUANTIZER_DISPATCHER(TYPE, FUNCTION)                      \
+  PiiCpuDispatcher<TYPE>().add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_QUANTIZER_NEON)
+#  define PII_QUANTIZER_DISPATCHER(TYPE, FUNCTION)                      \
+  PiiCpuDispatcher<TYPE>().add(Pii::CpuNeon, Neon::FUNCTION)
+#else
+#  define PII_QUANTIZER_DISPATCHER(TYPE, FUNCTION) PiiCpuDispatcher<TYPE>()
+#endif
+
+  static const PiiCpuDispatcher<IntFunction> intDispatcher = PII_QUANTIZER_DISPATCHER(IntFunction, quantizeInt);
+  static const PiiCpuDispatcher<FloatFunction> floatDispatcher = PII_QUANTIZER_DISPATCHER(FloatFunction, quantizeFloat);
+
+#undef PII_QUANTIZER_DISPATCHER
+
+  bool QuantizerKernel<int>::quantize(const int* values, int count,
+                                      const int* limits, int limitCount,
+                                      int* levels)
+  {
+    IntFunction pFunction = intDispatcher.function();
+    if (pFunction == 0 || limitCount > MaxLimits)
+      return false;
+    pFunction(values, count, limits, limitCount, levels);
+    return true;
+  }
+
+  bool QuantizerKernel<float>::quantize(const float* values, int count,
+                                        const float* limits, int limitCount,
+                                        int* levels)
+  {
+    FloatFunction pFunction = floatDispatcher.function();
+    if (pFunction == 0 || limitCount > MaxLimits)
+      return false;
+    pFunction(values, count, limits, limitCount, levels);
+    return true;
+  }
+}
@@ -0,0 +1,70 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIQUANTIZERKERNELS_H
+#define _PIIQUANTIZERKERNELS_H
+
+#include "PiiImageGlobal.h"
+
+namespace PiiImage
+{
+  /**
+   * Vectorized quantization for PiiQuantizer. The level of a value is
+   * the number of limits minus the number of limits greater than the
+   * value. The kernels compare 4 (SSE2, NEON) or 8 (AVX2) values to
+   * each limit at once and accumulate the comparison masks. This is
+   * faster than a binary search for a moderate number of limits
+   * because there are no branches to mispredict.
+   *
+   * The generic template says "not supported", and PiiQuantizer
+   * falls back to a binary search. Specializations exist for `int`
+   * and `float`. The levels are identical to those of
+   * PiiQuantizer::quantize(), provided that the limits are sorted.
+   *
+   * @internal
+   */
+  template <class T> struct QuantizerKernel
+  {
+    /**
+     * The maximum number of limits the kernels accept. With more
+     * limits, a binary search is faster.
+     */
+    enum { MaxLimits = 64 };
+
+    /**
+     * Quantizes *count* *values* and stores the level indices to
+     * *levels*. Returns `false` if there are more than `MaxLimits`
+     * limits or the CPU lacks the required instructions. In this
+     * case *levels* is not modified.
+     */
+    static bool quantize(const T*, int, const T*, int, int*) { return false; }
+  };
+
+#define PII_DECLARE_QUANTIZER_KERNEL(TYPE)                              \
+  template <> struct PII_IMAGE_EXPORT QuantizerKernel<TYPE>             \
+  {                                                                     \
+    enum { MaxLimits = 64 };                                            \
+    static bool quantize(const TYPE* values, int count,                 \
+                         const TYPE* limits, int limitCount,            \
+                         int* levels);                                  \
+  }
+
+  PII_DECLARE_QUANTIZER_KERNEL(int);
+  PII_DECLARE_QUANTIZER_KERNEL(float);
+
+#undef PII_DECLARE_QUANTIZER_KERNEL
+}
+
+#endif //_PIIQUANTIZERKERNELS_H
@@ -0,0 +1,72 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIREMAPTABLE_H
+# error "Never use <PiiRemapTable-templates.h> directly; include <PiiRemapTable.h> instead."
+#endif
+
+template <class U> PiiRemapTable::PiiRemapTable(const PiiMatrix<PiiPoint<U> >& map,
+                                                int sourceRows, int sourceColumns) :
+  d(new Data(map.rows(), map.columns(), sourceRows, sourceColumns))
+{
+  for (int r=0; r<map.rows(); ++r)
+    {
+      const PiiPoint<U>* pMapRow = map[r];
+      for (int c=0; c<map.columns(); ++c)
+        setSource(r, c, double(pMapRow[c].x), double(pMapRow[c].y));
+    }
+}
+
+template <class T> PiiMatrix<T> PiiRemapTable::remap(const PiiMatrix<T>& image, T background) const
+{
+  if (image.rows() != d->iSourceRows || image.columns() != d->iSourceColumns)
+    return PiiMatrix<T>();
+
+  PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(rows(), columns()));
+  if (!PiiImage::RemapKernel<T>::remap(image, d->matCoordinates, d->matWeights, background, matResult))
+    remapGeneric(image, background, matResult);
+  return matResult;
+}
+
+template <class T> void PiiRemapTable::remapGeneric(const PiiMatrix<T>& image, T background,
+                                                    PiiMatrix<T>& result) const
+{
+  typedef typename Pii::ToFloatingPoint<T>::Type Real;
+  typedef typename Pii::ToFloatingPoint<T>::PrimitiveType RealScalar;
+  const RealScalar scale = RealScalar(1.0 / (1 << PiiImage::RemapWeightBits));
+  const int iStepX = image.columns() > 1 ? 1 : 0, iStepY = image.rows() > 1 ? 1 : 0;
+
+  for (int r=0; r<result.rows(); ++r)
+    {
+      const int* pCoordinates = d->matCoordinates[r];
+      const short* pWeights = d->matWeights[r];
+      T* pResultRow = result[r];
+      for (int c=0; c<result.columns(); ++c, pCoordinates += 2, pWeights += 4)
+        {
+          if (pCoordinates[0] < 0)
+            {
+              pResultRow[c] = background;
+              continue;
+            }
+          const T* pTop = image[pCoordinates[1]] + pCoordinates[0];
+          const T* pBottom = image[pCoordinates[1] + iStepY] + pCoordinates[0];
+          Real sum = Real(pTop[0]) * RealScalar(pWeights[0]);
+          sum += Real(pTop[iStepX]) * RealScalar(pWeights[1]);
+          sum += Real(pBottom[0]) * RealScalar(pWeights[2]);
+          sum += Real(pBottom[iStepX]) * RealScalar(pWeights[3]);
+          pResultRow[c] = T(sum * scale);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRemapTable.h"
+
+PiiRemapTable::Data::Data(int rows, int columns, int sourceRows, int sourceColumns) :
+  iSourceRows(sourceRows),
+  iSourceColumns(sourceColumns),
+  matCoordinates(PiiMatrix<int>::uninitialized(rows, columns*2)),
+  matWeights(PiiMatrix<short>::uninitialized(rows, columns*4))
+{}
+
+PiiRemapTable::PiiRemapTable() :
+  d(new Data)
+{}
+
+PiiRemapTable::PiiRemapTable(const PiiMatrix<float>& transform,
+                             int sourceRows, int sourceColumns,
+                             PiiImage::TransformedSize handling)
+{
+  int iMinX, iMinY, iMaxX, iMaxY;
+  PiiImage::transformedBounds(transform, sourceRows, sourceColumns, handling,
+                              &iMinX, &iMinY, &iMaxX, &iMaxY);
+  d = new Data(iMaxY-iMinY+1, iMaxX-iMinX+1, sourceRows, sourceColumns);
+
+  // Sample the same positions PiiImage::transform() does.
+  PiiMatrix<float> matInverseTransform = Pii::inverse(transform);
+  float fX, fY;
+  for (int y=iMinY; y<=iMaxY; ++y)
+    for (int x=iMinX; x<=iMaxX; ++x)
+      {
+        PiiImage::transformHomogeneousPoint(matInverseTransform, float(x), float(y), &fX, &fY);
+        setSource(y-iMinY, x-iMinX, fX, fY);
+      }
+}
+
+PiiRemapTable::PiiRemapTable(const PiiRemapTable& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+PiiRemapTable::~PiiRemapTable()
+{
+  d->release();
+}
+
+PiiRemapTable& PiiRemapTable::operator= (const PiiRemapTable& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+void PiiRemapTable::setSource(int row, int column, double x, double y)
+{
+  int* pCoordinates = d->matCoordinates[row] + column*2;
+  short* pWeights = d->matWeights[row] + column*4;
+  const int iLastX = d->iSourceColumns-1, iLastY = d->iSourceRows-1;
+  // The negated comparison also catches NaNs.
+  if (!(x >= 0 && x <= iLastX && y >= 0 && y <= iLastY))
+    {
+      pCoordinates[0] = pCoordinates[1] = -1;
+      pWeights[0] = pWeights[1] = pWeights[2] = pWeights[3] = 0;
+      return;
+    }
+
+  const int iOne = 1 << PiiImage::RemapFractionBits;
+  int iX = int(x), iY = int(y);
+  int iFractionX = Pii::round<int>((x - iX) * iOne), iFractionY = Pii::round<int>((y - iY) * iOne);
+  if (iFractionX == iOne) { ++iX; iFractionX = 0; }
+  if (iFractionY == iOne) { ++iY; iFractionY = 0; }
+  // Keep the 2-by-2 neighborhood inside of the image. On the last
+  // column (row), all weight goes to the right (bottom) neighbor.
+  if (iX == iLastX && iX > 0) { --iX; iFractionX = iOne; }
+  if (iY == iLastY && iY > 0) { --iY; iFractionY = iOne; }
+
+  pCoordinates[0] = iX;
+  pCoordinates[1] = iY;
+  pWeights[0] = short((iOne - iFractionX) * (iOne - iFractionY));
+  pWeights[1] = short(iFractionX * (iOne - iFractionY));
+  pWeights[2] = short((iOne - iFractionX) * iFractionY);
+  pWeights[3] = short(iFractionX * iFractionY);
+}
+
+bool PiiRemapTable::isEmpty() const { return d->matCoordinates.isEmpty(); }
+int PiiRemapTable::rows() const { return d->matCoordinates.rows(); }
+int PiiRemapTable::columns() const { return d->matCoordinates.columns() / 2; }
+int PiiRemapTable::sourceRows() const { return d->iSourceRows; }
+int PiiRemapTable::sourceColumns() const { return d->iSourceColumns; }
@@ -0,0 +1,138 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIREMAPTABLE_H
+#define _PIIREMAPTABLE_H
+
+#include "PiiImage.h"
+#include <PiiSharedD.h>
+
+/**
+ * A precomputed geometric mapping between two images. For each pixel
+ * in the result, the table stores the position of the top left
+ * corner of the 2-by-2 source neighborhood and four bilinear
+ * interpolation weights. Building a table is roughly as expensive as
+ * transforming a single image with [PiiImage::transform()] or
+ * [PiiImage::remap()], but applying it is much cheaper. If the same
+ * geometric transformation is applied to many images of the same
+ * size, as is the case with lens undistortion or rotation by a fixed
+ * angle, the table should be built just once.
+ *
+ * Source coordinates are stored in fixed point with
+ * [RemapFractionBits](PiiImage::RemapFractionBits) fractional bits,
+ * which limits the sub-pixel accuracy of the table to 1/128 pixels.
+ * Gray-level `uchar` images are interpolated in fixed point using
+ * vector instructions where available, and the results are rounded.
+ * Other types are interpolated in floating point and converted back
+ * like in [PiiImage::transform()].
+ *
+ * PiiRemapTable is implicitly shared and read-only once built. The
+ * same table can be applied to any number of images in concurrent
+ * threads.
+ *
+ * ~~~(c++)
+ * PiiRemapTable table(PiiImage::createRotationTransform(M_PI/6, 320, 240),
+ *                     480, 640);
+ * for (int i=0; i<lstImages.size(); ++i)
+ *   lstImages[i] = table.remap(lstImages[i]);
+ * ~~~
+ */
+class PII_IMAGE_EXPORT PiiRemapTable
+{
+public:
+  /**
+   * Creates an empty table that maps nothing.
+   */
+  PiiRemapTable();
+
+  /**
+   * Creates a table out of a coordinate *map*. The size of the result
+   * image will be equal to the size of *map*, and each pixel will be
+   * sampled from the (x,y) position stored in the corresponding
+   * element of *map*. Positions outside of a *sourceRows*-by-
+   * *sourceColumns* image will be filled with a background color. The
+   * table maps images exactly like [PiiImage::remap()] does.
+   */
+  template <class U> PiiRemapTable(const PiiMatrix<PiiPoint<U> >& map,
+                                   int sourceRows, int sourceColumns);
+
+  /**
+   * Creates a table that applies a geometric *transform* to a
+   * *sourceRows*-by-*sourceColumns* image. The table maps images
+   * exactly like [PiiImage::transform()] does, and the size of the
+   * result image is determined by *handling*.
+   */
+  PiiRemapTable(const PiiMatrix<float>& transform,
+                int sourceRows, int sourceColumns,
+                PiiImage::TransformedSize handling = PiiImage::ExpandAsNecessary);
+
+  PiiRemapTable(const PiiRemapTable& other);
+  ~PiiRemapTable();
+  PiiRemapTable& operator= (const PiiRemapTable& other);
+
+  /**
+   * Returns `true` if the table has no pixels.
+   */
+  bool isEmpty() const;
+
+  /**
+   * Returns the number of rows in result images.
+   */
+  int rows() const;
+  /**
+   * Returns the number of columns in result images.
+   */
+  int columns() const;
+  /**
+   * Returns the number of rows the table expects source images to
+   * have.
+   */
+  int sourceRows() const;
+  /**
+   * Returns the number of columns the table expects source images to
+   * have.
+   */
+  int sourceColumns() const;
+
+  /**
+   * Samples *image* through the table. Pixels that map outside of
+   * *image* will be set to *background*. Returns an empty matrix if
+   * the size of *image* doesn't match the source size of the table.
+   */
+  template <class T> PiiMatrix<T> remap(const PiiMatrix<T>& image, T background = T(0)) const;
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : iSourceRows(0), iSourceColumns(0) {}
+    Data(int rows, int columns, int sourceRows, int sourceColumns);
+
+    int iSourceRows, iSourceColumns;
+    // (x,y) pairs. A negative x marks a pixel outside of the source.
+    PiiMatrix<int> matCoordinates;
+    // Four weights for each pixel: top left, top right, bottom left,
+    // bottom right.
+    PiiMatrix<short> matWeights;
+  } *d;
+
+  void setSource(int row, int column, double x, double y);
+  template <class T> void remapGeneric(const PiiMatrix<T>& image, T background,
+                                       PiiMatrix<T>& result) const;
+};
+
+#include "PiiRemapTable-templates.h"
+
+#endif //_PIIREMAPTABLE_H
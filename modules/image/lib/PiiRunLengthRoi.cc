@@ -0,0 +1,126 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRunLengthRoi.h"
+#include <PiiRectangle.h>
+#include <algorithm>
+
+namespace PiiImage
+{
+  namespace
+  {
+    struct StartsBefore
+    {
+      bool operator() (const RunLengthRoi::Span& a, const RunLengthRoi::Span& b) const { return a.start < b.start; }
+    };
+  }
+
+  RunLengthRoi::RunLengthRoi(int rows, int columns) :
+    _iRows(rows), _iColumns(columns),
+    _vecRowStarts(rows + 1)
+  {}
+
+  RunLengthRoi RunLengthRoi::fromRectangles(int rows, int columns, const PiiMatrix<int>& rectangles)
+  {
+    // Pick the rectangles that fit into the image.
+    QVector<PiiRectangle<int> > vecRects;
+    for (int i=0; i<rectangles.rows(); ++i)
+      {
+        const PiiRectangle<int>& rect = rectangles.rowAs<PiiRectangle<int> >(i);
+        if (rect.x >=0 && rect.x < columns &&
+            rect.y >=0 && rect.y < rows &&
+            rect.width > 0 &&
+            rect.height > 0 &&
+            rect.x + rect.width <= columns &&
+            rect.y + rect.height <= rows)
+          vecRects << rect;
+      }
+
+    RunLengthRoi roi(rows, columns);
+    QVector<Span> vecRow;
+    for (int r=0; r<rows; ++r)
+      {
+        roi._vecRowStarts[r] = roi._vecSpans.size();
+        vecRow.clear();
+        for (int i=0; i<vecRects.size(); ++i)
+          if (r >= vecRects[i].y && r < vecRects[i].y + vecRects[i].height)
+            {
+              Span span = { vecRects[i].x, vecRects[i].x + vecRects[i].width };
+              vecRow << span;
+            }
+        if (vecRow.isEmpty())
+          continue;
+
+        // Join overlapping and adjacent spans.
+        std::sort(vecRow.begin(), vecRow.end(), StartsBefore());
+        Span current = vecRow[0];
+        for (int i=1; i<vecRow.size(); ++i)
+          {
+            if (vecRow[i].start <= current.end)
+              current.end = qMax(current.end, vecRow[i].end);
+            else
+              {
+                roi._vecSpans << current;
+                current = vecRow[i];
+              }
+          }
+        roi._vecSpans << current;
+      }
+    roi._vecRowStarts[rows] = roi._vecSpans.size();
+    return roi;
+  }
+
+  RunLengthRoi RunLengthRoi::fromMask(const PiiMatrix<bool>& mask)
+  {
+    const int iRows = mask.rows(), iColumns = mask.columns();
+    RunLengthRoi roi(iRows, iColumns);
+    for (int r=0; r<iRows; ++r)
+      {
+        roi._vecRowStarts[r] = roi._vecSpans.size();
+        const bool* pRow = mask[r];
+        for (int c=0; c<iColumns; )
+          {
+            while (c < iColumns && !pRow[c]) ++c;
+            if (c == iColumns)
+              break;
+            const int iStart = c;
+            while (c < iColumns && pRow[c]) ++c;
+            roi.appendSpan(iStart, c);
+          }
+      }
+    roi._vecRowStarts[iRows] = roi._vecSpans.size();
+    return roi;
+  }
+
+  PiiMatrix<bool> RunLengthRoi::toMask() const
+  {
+    PiiMatrix<bool> matMask(_iRows, _iColumns);
+    for (int r=0; r<_iRows; ++r)
+      {
+        bool* pRow = matMask[r];
+        for (const Span* pSpan = rowBegin(r); pSpan != rowEnd(r); ++pSpan)
+          std::fill(pRow + pSpan->start, pRow + pSpan->end, true);
+      }
+    return matMask;
+  }
+
+  int RunLengthRoi::pixelCount() const
+  {
+    int iCount = 0;
+    for (int i=0; i<_vecSpans.size(); ++i)
+      iCount += _vecSpans[i].end - _vecSpans[i].start;
+    return iCount;
+  }
+}
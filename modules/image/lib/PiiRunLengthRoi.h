@@ -0,0 +1,164 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRUNLENGTHROI_H
+#define _PIIRUNLENGTHROI_H
+
+#include "PiiImageGlobal.h"
+#include <PiiMatrix.h>
+#include <QVector>
+
+namespace PiiImage
+{
+  /**
+   * A region of interest stored as horizontal runs of pixels. Each
+   * row of the image has a sorted list of non-overlapping spans, and
+   * rows with no spans are not occupied at all. Algorithms that
+   * support run-length ROIs only visit the pixels inside the spans,
+   * which makes processing cheap if most of the image is background.
+   *
+   * RunLengthRoi can be used wherever a ROI function object is
+   * accepted; operator() tells whether a pixel is inside the ROI.
+   * [clipToRoi()] gives the column range of the ROI on a row, and
+   * rowBegin() and rowEnd() give direct access to the spans.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matRects(2, 4,
+   *                         0, 0, 20, 10,
+   *                         10, 5, 30, 20);
+   * PiiImage::RunLengthRoi roi(PiiImage::RunLengthRoi::fromRectangles(480, 640, matRects));
+   * PiiMatrix<int> matHistogram = PiiImage::histogram(image, roi, 256);
+   * ~~~
+   */
+  class PII_IMAGE_EXPORT RunLengthRoi
+  {
+  public:
+    /**
+     * A run of pixels on a row. Both *start* and *end* are column
+     * indices, and *end* is not included in the span.
+     */
+    struct Span
+    {
+      int start, end;
+    };
+
+    /**
+     * Creates an empty ROI for a *rows*-by-*columns* image. No pixel
+     * is inside the ROI.
+     */
+    explicit RunLengthRoi(int rows = 0, int columns = 0);
+
+    /**
+     * Creates a ROI that covers all the given *rectangles* in a
+     * *rows*-by-*columns* image. *rectangles* is an N-by-4 matrix in
+     * which each row represents a rectangle (x, y, width, height).
+     * Rectangles can overlap. Rectangles that exceed the boundaries
+     * of the image are ignored like in [createRoiMask()].
+     */
+    static RunLengthRoi fromRectangles(int rows, int columns, const PiiMatrix<int>& rectangles);
+
+    /**
+     * Creates a ROI that contains the `true` entries of *mask*.
+     */
+    static RunLengthRoi fromMask(const PiiMatrix<bool>& mask);
+
+    /**
+     * Returns a binary mask in which the pixels inside the ROI are
+     * `true`.
+     */
+    PiiMatrix<bool> toMask() const;
+
+    /// Returns the number of rows in the image the ROI was made for.
+    int rows() const { return _iRows; }
+    /// Returns the number of columns in the image the ROI was made for.
+    int columns() const { return _iColumns; }
+
+    /**
+     * Returns the number of pixels inside the ROI.
+     */
+    int pixelCount() const;
+
+    /**
+     * Returns `true` if there are no pixels inside the ROI.
+     */
+    bool isEmpty() const { return _vecSpans.isEmpty(); }
+
+    /**
+     * Returns the number of spans on *row*.
+     */
+    int spanCount(int row) const { return _vecRowStarts[row+1] - _vecRowStarts[row]; }
+
+    /**
+     * Returns a pointer to the first span on *row*.
+     */
+    const Span* rowBegin(int row) const { return _vecSpans.constData() + _vecRowStarts[row]; }
+
+    /**
+     * Returns a pointer past the last span on *row*.
+     */
+    const Span* rowEnd(int row) const { return _vecSpans.constData() + _vecRowStarts[row+1]; }
+
+    /**
+     * Returns `true` if the pixel at (*r*, *c*) is inside the ROI.
+     * The spans on the row are searched with binary search.
+     */
+    bool operator() (int r, int c) const
+    {
+      const Span* pBegin = rowBegin(r), *pEnd = rowEnd(r);
+      while (pBegin < pEnd)
+        {
+          const Span* pMiddle = pBegin + (pEnd - pBegin) / 2;
+          if (c < pMiddle->start)
+            pEnd = pMiddle;
+          else if (c >= pMiddle->end)
+            pBegin = pMiddle + 1;
+          else
+            return true;
+        }
+      return false;
+    }
+
+  private:
+    void appendSpan(int start, int end)
+    {
+      Span span = { start, end };
+      _vecSpans.append(span);
+    }
+
+    int _iRows, _iColumns;
+    // Index of the first span of each row, plus an end marker.
+    QVector<int> _vecRowStarts;
+    QVector<Span> _vecSpans;
+  };
+
+  /**
+   * Restricts the column range [*first*, *end*) on *row* to the
+   * columns where *roi* may contain pixels. Returns `false` if no
+   * pixel on the row can be inside the ROI, in which case the row can
+   * be skipped altogether. This overload narrows the range to the
+   * first and last span on the row.
+   */
+  inline bool clipToRoi(const RunLengthRoi& roi, int row, int& first, int& end)
+  {
+    const RunLengthRoi::Span* pBegin = roi.rowBegin(row), *pEnd = roi.rowEnd(row);
+    if (pBegin == pEnd)
+      return false;
+    first = qMax(first, pBegin->start);
+    end = qMin(end, pEnd[-1].end);
+    return first < end;
+  }
+}
+
+#endif //_PIIRUNLENGTHROI_H
@@ -0,0 +1,331 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISLIDINGHISTOGRAM_H
+#define _PIISLIDINGHISTOGRAM_H
+
+#include <PiiMatrix.h>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+/**
+ * A histogram of a rectangular window that slides over an image. The
+ * histogram is updated incrementally as the window moves, which makes
+ * the cost per window position independent of the window size
+ * (Perreault & Hebert, 2007). This makes it the basic building block
+ * of median and rank filters, local percentile thresholds and local
+ * feature histograms.
+ *
+ * Each column of the image has a histogram that covers *windowRows*
+ * pixels. Moving one row down updates each column histogram by one
+ * removal and one addition. The histogram of the window is the sum of
+ * *windowColumns* column histograms; moving one column right
+ * subtracts the leftmost column and adds a new one. The histograms
+ * are split into coarse bins of 16 fine bins each. The coarse level
+ * is always kept up to date, but each fine segment is updated only
+ * when a query needs it. Rank queries thus touch just one fine
+ * segment.
+ *
+ * The pixels must be integers in [0, [levels()] - 1]. Values outside
+ * of this range are counted to the first or the last bin. Since the
+ * column histograms store one counter for each level and image
+ * column, the number of levels should be kept moderate. 256 is
+ * typical.
+ *
+ * [scan()] moves the window over all valid positions and calls a
+ * user-supplied function at each. The histogram can be queried in the
+ * function.
+ *
+ * ~~~(c++)
+ * // Local LBP histograms for texture segmentation
+ * struct LbpCollector
+ * {
+ *   void operator() (int r, int c, PiiSlidingHistogram& histogram)
+ *   {
+ *     const int* pBins = histogram.bins();
+ *     // Compare pBins[0] ... pBins[255] to texture models
+ *   }
+ * };
+ *
+ * PiiMatrix<int> matCodes = PiiLbp::basicLbp<PiiLbp::Image>(image);
+ * PiiSlidingHistogram histogram(256);
+ * LbpCollector collector;
+ * histogram.scan(matCodes, 32, 32, collector);
+ * ~~~
+ */
+class PiiSlidingHistogram
+{
+public:
+  /**
+   * Creates a sliding histogram with *levels* bins.
+   */
+  PiiSlidingHistogram(int levels = 256) :
+    _iLevels(qMax(levels, 1)),
+    _iCoarseBins((_iLevels + SegmentSize - 1) / SegmentSize),
+    _iFineBins(_iCoarseBins * SegmentSize),
+    _iWindowRows(0), _iWindowColumns(0),
+    _iColumn(0),
+    _pColumnFine(0),
+    _vecCoarse(_iCoarseBins),
+    _vecFine(_iFineBins),
+    _vecUpdated(_iCoarseBins)
+  {}
+
+  /**
+   * Moves a *windowRows* by *windowColumns* window over *image* and
+   * calls `function(r, c, *this)` at each position where the window
+   * is completely within the image. (*r*, *c*) is the upper left
+   * corner of the window. The positions are scanned row by row from
+   * top to bottom. The histogram can only be queried within
+   * *function*.
+   *
+   * Returns `false` and calls nothing if the window doesn't fit in
+   * the image or if *windowRows* is larger than 65535.
+   */
+  template <class T, class Function>
+  bool scan(const PiiMatrix<T>& image, int windowRows, int windowColumns, Function& function);
+
+  /**
+   * Returns the number of bins.
+   */
+  int levels() const { return _iLevels; }
+
+  /**
+   * Returns the number of rows in the current window.
+   */
+  int windowRows() const { return _iWindowRows; }
+  /**
+   * Returns the number of columns in the current window.
+   */
+  int windowColumns() const { return _iWindowColumns; }
+  /**
+   * Returns the number of pixels in the current window.
+   */
+  int windowSize() const { return _iWindowRows * _iWindowColumns; }
+
+  /**
+   * Returns the smallest value whose cumulative frequency reaches
+   * *rank*. Rank one is the minimum and [windowSize()] the maximum
+   * of the window. Other ranks are clamped to this range.
+   */
+  int rankValue(int rank)
+  {
+    rank = qBound(1, rank, windowSize());
+    int iBin = 0, iCount = 0;
+    while (iCount + _vecCoarse[iBin] < rank)
+      iCount += _vecCoarse[iBin++];
+
+    const int* pSegment = updateSegment(iBin);
+    int iFineBin = 0;
+    while (iCount + pSegment[iFineBin] < rank)
+      iCount += pSegment[iFineBin++];
+    return iBin * SegmentSize + iFineBin;
+  }
+
+  /**
+   * Returns the median of the window. The median is the value at rank
+   * (n+1)/2, where n is the number of pixels in the window.
+   * Pii::medianN() uses the same definition.
+   */
+  int median() { return rankValue((windowSize() + 1) / 2); }
+
+  /**
+   * Returns the *percentile* (0-1) of the window, i.e. the smallest
+   * value at or below which at least *percentile* of the pixels are.
+   * Zero gives the minimum, one the maximum and 0.5 the median.
+   */
+  int percentile(double percentile)
+  {
+    return rankValue(int(std::ceil(percentile * windowSize())));
+  }
+
+  /**
+   * Returns the number of pixels in the window whose value is
+   * *level*.
+   */
+  int count(int level)
+  {
+    level = qBound(0, level, _iLevels - 1);
+    return updateSegment(level / SegmentSize)[level % SegmentSize];
+  }
+
+  /**
+   * Returns the number of pixels in the window whose value is less
+   * than or equal to *level*. Dividing the result by [windowSize()]
+   * gives the local percentile of *level*.
+   */
+  int cumulativeCount(int level)
+  {
+    if (level < 0)
+      return 0;
+    if (level >= _iLevels)
+      return windowSize();
+    const int iBin = level / SegmentSize;
+    int iCount = 0;
+    for (int i=0; i<iBin; ++i)
+      iCount += _vecCoarse[i];
+    const int* pSegment = updateSegment(iBin);
+    for (int i=0; i<=level % SegmentSize; ++i)
+      iCount += pSegment[i];
+    return iCount;
+  }
+
+  /**
+   * Returns the full histogram of the window. The returned array
+   * contains [levels()] bins and is valid until the window moves.
+   * Bringing all fine segments up to date is more expensive than a
+   * rank query; use [rankValue()] or [count()] if possible.
+   */
+  const int* bins()
+  {
+    for (int i=0; i<_iCoarseBins; ++i)
+      updateSegment(i);
+    return &_vecFine[0];
+  }
+
+private:
+  typedef unsigned short ColumnCount;
+  enum { SegmentSize = 16 };
+
+  inline int clampLevel(int value) const { return qBound(0, value, _iLevels - 1); }
+
+  inline void addPixel(int column, int value)
+  {
+    ++_vecColumnCoarse[column * _iCoarseBins + value / SegmentSize];
+    ++_vecColumnFine[column * _iFineBins + value];
+  }
+
+  inline void removePixel(int column, int value)
+  {
+    --_vecColumnCoarse[column * _iCoarseBins + value / SegmentSize];
+    --_vecColumnFine[column * _iFineBins + value];
+  }
+
+  static inline void addSegment(int* target, const ColumnCount* source, int count)
+  {
+    for (int i=0; i<count; ++i)
+      target[i] += source[i];
+  }
+
+  static inline void subtractSegment(int* target, const ColumnCount* source, int count)
+  {
+    for (int i=0; i<count; ++i)
+      target[i] -= source[i];
+  }
+
+  void startRow()
+  {
+    std::fill(_vecCoarse.begin(), _vecCoarse.end(), 0);
+    for (int c=0; c<_iWindowColumns; ++c)
+      addSegment(&_vecCoarse[0], &_vecColumnCoarse[c * _iCoarseBins], _iCoarseBins);
+    // Force a full update on first use.
+    std::fill(_vecUpdated.begin(), _vecUpdated.end(), -_iWindowColumns - 1);
+    _iColumn = 0;
+  }
+
+  void moveRight()
+  {
+    subtractSegment(&_vecCoarse[0], &_vecColumnCoarse[_iColumn * _iCoarseBins], _iCoarseBins);
+    addSegment(&_vecCoarse[0], &_vecColumnCoarse[(_iColumn + _iWindowColumns) * _iCoarseBins], _iCoarseBins);
+    ++_iColumn;
+  }
+
+  // Brings the fine segment of a coarse bin up to date. If it has
+  // fallen more than a window behind, recalculating is cheaper.
+  const int* updateSegment(int bin)
+  {
+    int* pSegment = &_vecFine[bin * SegmentSize];
+    const ColumnCount* pColumns = _pColumnFine + bin * SegmentSize;
+    if (_iColumn - _vecUpdated[bin] > _iWindowColumns)
+      {
+        std::fill(pSegment, pSegment + SegmentSize, 0);
+        for (int i=_iColumn; i<_iColumn+_iWindowColumns; ++i)
+          addSegment(pSegment, pColumns + i * _iFineBins, SegmentSize);
+      }
+    else
+      {
+        for (int i=_vecUpdated[bin]+1; i<=_iColumn; ++i)
+          {
+            subtractSegment(pSegment, pColumns + (i-1) * _iFineBins, SegmentSize);
+            addSegment(pSegment, pColumns + (i+_iWindowColumns-1) * _iFineBins, SegmentSize);
+          }
+      }
+    _vecUpdated[bin] = _iColumn;
+    return pSegment;
+  }
+
+  int _iLevels, _iCoarseBins;
+  // The number of fine bins per column, padded to full segments.
+  int _iFineBins;
+  int _iWindowRows, _iWindowColumns;
+  // The leftmost column of the current window.
+  int _iColumn;
+  const ColumnCount* _pColumnFine;
+  std::vector<ColumnCount> _vecColumnCoarse, _vecColumnFine;
+  std::vector<int> _vecCoarse, _vecFine;
+  // The window column each fine segment is up to date with.
+  std::vector<int> _vecUpdated;
+};
+
+template <class T, class Function>
+bool PiiSlidingHistogram::scan(const PiiMatrix<T>& image, int windowRows, int windowColumns, Function& function)
+{
+  const int iSourceCols = image.columns();
+  const int iRows = image.rows() - windowRows + 1,
+    iCols = iSourceCols - windowColumns + 1;
+  if (windowRows <= 0 || windowColumns <= 0 ||
+      windowRows > 0xffff ||
+      iRows <= 0 || iCols <= 0)
+    return false;
+
+  _iWindowRows = windowRows;
+  _iWindowColumns = windowColumns;
+  _vecColumnCoarse.assign(iSourceCols * _iCoarseBins, 0);
+  _vecColumnFine.assign(iSourceCols * _iFineBins, 0);
+  _pColumnFine = &_vecColumnFine[0];
+
+  for (int r=0; r<windowRows; ++r)
+    {
+      const T* pRow = image[r];
+      for (int c=0; c<iSourceCols; ++c)
+        addPixel(c, clampLevel(int(pRow[c])));
+    }
+
+  for (int r=0; r<iRows; ++r)
+    {
+      if (r > 0)
+        {
+          const T* pOldRow = image[r-1];
+          const T* pNewRow = image[r + windowRows - 1];
+          for (int c=0; c<iSourceCols; ++c)
+            {
+              removePixel(c, clampLevel(int(pOldRow[c])));
+              addPixel(c, clampLevel(int(pNewRow[c])));
+            }
+        }
+
+      startRow();
+      for (int c=0; c<iCols; ++c)
+        {
+          if (c > 0)
+            moveRight();
+          function(r, c, *this);
+        }
+    }
+  return true;
+}
+
+#endif //_PIISLIDINGHISTOGRAM_H
@@ -0,0 +1,375 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISTREAMLABELER_H
+#define _PIISTREAMLABELER_H
+
+#include "PiiLabeling.h"
+#include <QHash>
+
+namespace PiiImage
+{
+  /**
+   * Labels connected components in an endless image that arrives in
+   * horizontal strips, as produced by a line-scan camera. Rows of
+   * consecutive strips are treated as one continuous image, so an
+   * object that crosses a strip boundary is reported once, with its
+   * full area and extent. There is no need to cut the web into
+   * overlapping frames and join the pieces afterwards.
+   *
+   * Only the runs on the latest row and the properties of the objects
+   * that touch it are retained between strips. An object is *closed*
+   * once a row without any of its pixels has been seen, and its
+   * properties can then be taken with takeClosedObjects().
+   *
+   * Rows are numbered from the first row of the first strip. Row
+   * numbers are 64-bit, which means an endless web never runs out of
+   * them.
+   *
+   * ~~~(c++)
+   * PiiImage::StreamLabeler labeler(PiiImage::Connect8);
+   * forever
+   *   {
+   *     PiiMatrix<uchar> matStrip = grabStrip();
+   *     labeler.addStrip(matStrip, std::bind2nd(std::greater<uchar>(), 128));
+   *     QVector<PiiImage::StreamLabeler::Object> vecObjects = labeler.takeClosedObjects();
+   *     // ...
+   *   }
+   * ~~~
+   */
+  class StreamLabeler
+  {
+  public:
+    /**
+     * The properties of an object found in the stream.
+     */
+    struct Object
+    {
+      /// A unique, ever-increasing id of the object (1, 2, ...).
+      qint64 id;
+      /// The number of pixels in the object.
+      int area;
+      /// The horizontal extent of the object. Both are inclusive.
+      int left, right;
+      /// The first and last row of the object. Both are inclusive.
+      qint64 top, bottom;
+      /// The number of pixel edges between the object and the background.
+      int perimeter;
+      /// Raw moments. Row coordinates are relative to `top`.
+      double sumX, sumY, sumXX, sumYY, sumXY;
+
+      /// Returns the x coordinate of the center of mass.
+      double centroidX() const { return sumX / area; }
+      /**
+       * Returns the y coordinate of the center of mass relative to
+       * `top`.
+       */
+      double centroidY() const { return sumY / area; }
+    };
+
+    /**
+     * Creates a labeler that joins pixels with the given
+     * *connectivity*.
+     */
+    StreamLabeler(Connectivity connectivity = Connect4) :
+      _connectivity(connectivity)
+    {
+      reset();
+    }
+
+    /**
+     * Changes the connectivity. Calls reset().
+     */
+    void setConnectivity(Connectivity connectivity) { _connectivity = connectivity; reset(); }
+    Connectivity connectivity() const { return _connectivity; }
+
+    /**
+     * Starts a new stream. Open and closed objects are discarded and
+     * row and object numbering restart.
+     */
+    void reset()
+    {
+      _iNextRow = 0;
+      _iNextId = 1;
+      _iColumns = -1;
+      _vecPreviousRuns.clear();
+      _vecOpenObjects.clear();
+      _vecClosedObjects.clear();
+      _vecStripRuns.clear();
+      _vecStripIds.clear();
+      _hashAliases.clear();
+    }
+
+    /**
+     * Appends the rows of *strip* to the stream. The pixels for which
+     * *rule* returns `true` are objects. All strips must have the
+     * same number of columns; a change in width starts a new stream.
+     * After this function returns, stripRuns() returns the runs found
+     * in the strip.
+     */
+    template <class Matrix, class UnaryOp> void addStrip(const Matrix& strip, UnaryOp rule)
+    {
+      if (strip.columns() != _iColumns)
+        {
+          closeAll();
+          _iColumns = strip.columns();
+        }
+      _vecStripRuns.clear();
+      _vecStripIds.clear();
+      _hashAliases.clear();
+      QVector<LabeledRun> vecRow;
+      for (int r=0; r<strip.rows(); ++r)
+        {
+          vecRow.clear();
+          Private::appendRuns(strip, rule, r, vecRow);
+          addRow(vecRow, r);
+        }
+      resolveStripLabels();
+    }
+
+    /**
+     * Appends the rows of a bit-packed binary strip. Set bits are
+     * objects.
+     */
+    void addStrip(const PiiBitMatrix& strip)
+    {
+      addStrip(strip, Private::BitRule());
+    }
+
+    /**
+     * Closes all open objects. Call this function at the end of the
+     * web, or when a gap in the stream is detected.
+     */
+    void closeAll()
+    {
+      _vecClosedObjects << _vecOpenObjects;
+      _vecOpenObjects.clear();
+      _vecPreviousRuns.clear();
+    }
+
+    /**
+     * Returns the objects closed since the last call and forgets
+     * them. The objects are in the order they were closed.
+     */
+    QVector<Object> takeClosedObjects()
+    {
+      QVector<Object> vecResult;
+      vecResult.swap(_vecClosedObjects);
+      return vecResult;
+    }
+
+    /**
+     * Returns the runs of the latest strip. Row indices are relative
+     * to the first row of the strip, and the label of each run is
+     * the [id](Object::id) of its object, truncated to an `int`.
+     * Objects that are merged later, when they meet in a subsequent
+     * strip, keep their old labels in the runs of earlier strips.
+     */
+    const QVector<LabeledRun>& stripRuns() const { return _vecStripRuns; }
+
+    /**
+     * Returns the number of objects that touch the latest row.
+     */
+    int openObjectCount() const { return _vecOpenObjects.size(); }
+
+    /**
+     * Returns the index of the next row to be added, which equals the
+     * total number of rows seen since the last reset().
+     */
+    qint64 rowCount() const { return _iNextRow; }
+
+  private:
+    struct Run
+    {
+      int start, end;
+      // Index to open objects
+      int object;
+    };
+
+    struct Node
+    {
+      Object object;
+      int parent;
+    };
+
+    static int findRoot(QVector<Node>& nodes, int index)
+    {
+      while (nodes[index].parent != index)
+        {
+          nodes[index].parent = nodes[nodes[index].parent].parent;
+          index = nodes[index].parent;
+        }
+      return index;
+    }
+
+    // Moves the row origin of the moments of *obj* to *top*.
+    static void shiftTop(Object& obj, qint64 top)
+    {
+      const double dy = double(obj.top - top);
+      obj.sumYY += 2 * dy * obj.sumY + obj.area * dy * dy;
+      obj.sumXY += dy * obj.sumX;
+      obj.sumY += obj.area * dy;
+      obj.top = top;
+    }
+
+    static void merge(Object& target, Object& source)
+    {
+      if (source.top < target.top)
+        shiftTop(target, source.top);
+      else if (source.top > target.top)
+        shiftTop(source, target.top);
+      target.area += source.area;
+      target.left = qMin(target.left, source.left);
+      target.right = qMax(target.right, source.right);
+      target.bottom = qMax(target.bottom, source.bottom);
+      target.perimeter += source.perimeter;
+      target.sumX += source.sumX;
+      target.sumY += source.sumY;
+      target.sumXX += source.sumXX;
+      target.sumYY += source.sumYY;
+      target.sumXY += source.sumXY;
+      // The older object gives its id to the union.
+      target.id = qMin(target.id, source.id);
+    }
+
+    static double sumTo(int n) { return 0.5 * double(n) * double(n - 1); }
+    static double squareSumTo(int n) { return double(n - 1) * double(n) * double(2*n - 1) / 6.0; }
+
+    static void addRun(Object& obj, int start, int end, qint64 row, int overlap)
+    {
+      const int iLength = end - start;
+      const double dy = double(row - obj.top);
+      const double dSumX = sumTo(end) - sumTo(start);
+      obj.area += iLength;
+      obj.left = qMin(obj.left, start);
+      obj.right = qMax(obj.right, end - 1);
+      obj.bottom = row;
+      // Two vertical edges and the top and bottom edges of each
+      // pixel, minus the edges shared with the previous row, which
+      // were counted as bottom edges there.
+      obj.perimeter += 2 + 2 * iLength - 2 * overlap;
+      obj.sumX += dSumX;
+      obj.sumY += iLength * dy;
+      obj.sumXX += squareSumTo(end) - squareSumTo(start);
+      obj.sumYY += iLength * dy * dy;
+      obj.sumXY += dSumX * dy;
+    }
+
+    void addRow(const QVector<LabeledRun>& row, int stripRow)
+    {
+      const qint64 iRow = _iNextRow++;
+      const int iShift = _connectivity == Connect8 ? 1 : 0;
+
+      QVector<Node> vecNodes(_vecOpenObjects.size());
+      for (int i=0; i<vecNodes.size(); ++i)
+        {
+          vecNodes[i].object = _vecOpenObjects[i];
+          vecNodes[i].parent = i;
+        }
+
+      QVector<Run> vecCurrent(row.size());
+      int iPrevious = 0;
+      for (int i=0; i<row.size(); ++i)
+        {
+          const int iStart = row[i].start, iEnd = row[i].end;
+          while (iPrevious < _vecPreviousRuns.size() && _vecPreviousRuns[iPrevious].end <= iStart - iShift)
+            ++iPrevious;
+          int iNode = -1, iOverlap = 0;
+          for (int p = iPrevious; p < _vecPreviousRuns.size() && _vecPreviousRuns[p].start < iEnd + iShift; ++p)
+            {
+              const Run& previous = _vecPreviousRuns[p];
+              iOverlap += qMax(0, qMin(iEnd, previous.end) - qMax(iStart, previous.start));
+              int iRoot = findRoot(vecNodes, previous.object);
+              if (iNode == -1)
+                iNode = iRoot;
+              else if (iRoot != iNode)
+                {
+                  const qint64 iOldId = qMax(vecNodes[iNode].object.id, vecNodes[iRoot].object.id);
+                  merge(vecNodes[iNode].object, vecNodes[iRoot].object);
+                  vecNodes[iRoot].parent = iNode;
+                  _hashAliases.insert(iOldId, vecNodes[iNode].object.id);
+                }
+            }
+          if (iNode == -1)
+            {
+              Node node;
+              Object& obj = node.object;
+              obj.id = _iNextId++;
+              obj.area = 0;
+              obj.left = iStart;
+              obj.right = iEnd - 1;
+              obj.top = obj.bottom = iRow;
+              obj.perimeter = 0;
+              obj.sumX = obj.sumY = obj.sumXX = obj.sumYY = obj.sumXY = 0;
+              node.parent = iNode = vecNodes.size();
+              vecNodes.append(node);
+            }
+          addRun(vecNodes[iNode].object, iStart, iEnd, iRow, iOverlap);
+          vecCurrent[i].start = iStart;
+          vecCurrent[i].end = iEnd;
+          vecCurrent[i].object = iNode;
+        }
+
+      // Objects that reach the current row stay open, the rest are
+      // closed. New indices are assigned in the order of the runs.
+      QVector<int> vecNewIndices(vecNodes.size(), -1);
+      QVector<Object> vecOpen;
+      for (int i=0; i<vecCurrent.size(); ++i)
+        {
+          const int iRoot = findRoot(vecNodes, vecCurrent[i].object);
+          if (vecNewIndices[iRoot] == -1)
+            {
+              vecNewIndices[iRoot] = vecOpen.size();
+              vecOpen.append(vecNodes[iRoot].object);
+            }
+          vecCurrent[i].object = vecNewIndices[iRoot];
+          LabeledRun run = { stripRow, vecCurrent[i].start, vecCurrent[i].end, 0 };
+          _vecStripRuns.append(run);
+          _vecStripIds.append(vecNodes[iRoot].object.id);
+        }
+      for (int i=0; i<vecNodes.size(); ++i)
+        if (vecNodes[i].parent == i && vecNewIndices[i] == -1)
+          _vecClosedObjects << vecNodes[i].object;
+
+      _vecOpenObjects.swap(vecOpen);
+      _vecPreviousRuns.swap(vecCurrent);
+    }
+
+    // Runs labeled before a merge in the same strip get the id of
+    // the union. Aliases always point to smaller ids.
+    void resolveStripLabels()
+    {
+      for (int i=0; i<_vecStripRuns.size(); ++i)
+        {
+          qint64 iId = _vecStripIds[i];
+          QHash<qint64,qint64>::const_iterator it;
+          while ((it = _hashAliases.constFind(iId)) != _hashAliases.constEnd())
+            iId = it.value();
+          _vecStripRuns[i].label = int(iId);
+        }
+    }
+
+    Connectivity _connectivity;
+    qint64 _iNextRow, _iNextId;
+    int _iColumns;
+    QVector<Run> _vecPreviousRuns;
+    QVector<Object> _vecOpenObjects, _vecClosedObjects;
+    QVector<LabeledRun> _vecStripRuns;
+    QVector<qint64> _vecStripIds;
+    QHash<qint64,qint64> _hashAliases;
+  };
+}
+
+#endif //_PIISTREAMLABELER_H
@@ -0,0 +1,276 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEMPLATEMATCHING_H
+# error "Never use <PiiTemplateMatching-templates.h> directly; include <PiiTemplateMatching.h> instead."
+#endif
+
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+namespace PiiImage
+{
+  namespace Private
+  {
+    // The squared sum of a window is compared to its variance to
+    // detect constant windows despite rounding errors.
+    const double dFlatWindowTolerance = 1e-10;
+
+    /* A template with its mean subtracted. The zero-mean values are
+       stored in single precision for filterValidPart() and in double
+       precision for the direct evaluation at a single position.
+     */
+    template <class T> struct CorrelationTemplate
+    {
+      CorrelationTemplate(const PiiMatrix<T>& templ) :
+        matValues(PiiMatrix<double>::uninitialized(templ.rows(), templ.columns())),
+        dSquares(0)
+      {
+        const int iRows = templ.rows(), iCols = templ.columns();
+        double dSum = 0;
+        for (int r=0; r<iRows; ++r)
+          {
+            const T* pRow = templ[r];
+            for (int c=0; c<iCols; ++c)
+              dSum += double(pRow[c]);
+          }
+        const double dMean = dSum / (iRows * iCols);
+        for (int r=0; r<iRows; ++r)
+          {
+            const T* pSource = templ[r];
+            double* pTarget = matValues[r];
+            for (int c=0; c<iCols; ++c)
+              {
+                pTarget[c] = double(pSource[c]) - dMean;
+                dSquares += pTarget[c] * pTarget[c];
+              }
+          }
+      }
+
+      PiiMatrix<double> matValues;
+      double dSquares;
+    };
+
+    inline float correlationCoefficient(double product, double sum, double squares,
+                                        int count, double templateSquares)
+    {
+      const double dVariance = squares - sum * sum / count;
+      if (dVariance <= squares * dFlatWindowTolerance)
+        return 0;
+      return float(product / std::sqrt(dVariance * templateSquares));
+    }
+
+    // Calculates the correlation at a single position directly.
+    template <class T> float correlationAt(const PiiMatrix<T>& image,
+                                           const CorrelationTemplate<T>& templ,
+                                           int row, int column)
+    {
+      const int iRows = templ.matValues.rows(), iCols = templ.matValues.columns();
+      double dSum = 0, dSquares = 0, dProduct = 0;
+      for (int r=0; r<iRows; ++r)
+        {
+          const T* pImage = image[row+r] + column;
+          const double* pTempl = templ.matValues[r];
+          for (int c=0; c<iCols; ++c)
+            {
+              const double dValue = double(pImage[c]);
+              dSum += dValue;
+              dSquares += dValue * dValue;
+              dProduct += dValue * pTempl[c];
+            }
+        }
+      return correlationCoefficient(dProduct, dSum, dSquares, iRows * iCols, templ.dSquares);
+    }
+
+    struct TemplateMatch
+    {
+      TemplateMatch(int r = 0, int c = 0, float s = 0) : row(r), column(c), score(s) {}
+      bool operator< (const TemplateMatch& other) const { return score > other.score; }
+      int row, column;
+      float score;
+    };
+
+    // Collects the local maxima of *correlation* that exceed
+    // *threshold*. On plateaus, the first pixel in raster order wins.
+    inline void collectCorrelationPeaks(const PiiMatrix<float>& correlation, float threshold,
+                                        QVector<TemplateMatch>& matches)
+    {
+      const int iRows = correlation.rows(), iCols = correlation.columns();
+      for (int r=0; r<iRows; ++r)
+        {
+          const float* pRow = correlation[r];
+          for (int c=0; c<iCols; ++c)
+            {
+              const float fValue = pRow[c];
+              if (fValue < threshold)
+                continue;
+              bool bPeak = true;
+              for (int i=qMax(r-1,0); i<=qMin(r+1,iRows-1) && bPeak; ++i)
+                {
+                  const float* pNeighbors = correlation[i];
+                  for (int j=qMax(c-1,0); j<=qMin(c+1,iCols-1); ++j)
+                    {
+                      const bool bBefore = i < r || (i == r && j < c);
+                      if (bBefore ? pNeighbors[j] >= fValue : pNeighbors[j] > fValue)
+                        {
+                          bPeak = false;
+                          break;
+                        }
+                    }
+                }
+              if (bPeak)
+                matches.append(TemplateMatch(r, c, fValue));
+            }
+        }
+      std::sort(matches.begin(), matches.end());
+    }
+
+    inline bool isCoarseEnough(int templateRows, int templateColumns)
+    {
+      return templateRows >= 8 && templateColumns >= 8;
+    }
+  }
+
+  template <class T>
+  PiiMatrix<float> normalizedCorrelation(const PiiMatrix<T>& image,
+                                         const PiiMatrix<T>& templ,
+                                         const PiiParallelPolicy& policy)
+  {
+    typedef typename Pii::IfClass<Pii::IsFloatingPoint<T>, double, long long>::Type SumType;
+
+    const int
+      iTemplRows = templ.rows(),
+      iTemplCols = templ.columns(),
+      iRows = image.rows() - iTemplRows + 1,
+      iCols = image.columns() - iTemplCols + 1;
+    if (templ.isEmpty() || iRows <= 0 || iCols <= 0)
+      return PiiMatrix<float>();
+
+    Private::CorrelationTemplate<T> correlationTemplate(templ);
+    if (correlationTemplate.dSquares <= 0)
+      return PiiMatrix<float>(iRows, iCols);
+
+    PiiMatrix<float> matResult(filterValidPart<float>(image, PiiMatrix<float>(correlationTemplate.matValues), policy));
+    PiiIntegralImage<SumType> sum(image), squares(image, Pii::Square<SumType>());
+    const int iCount = iTemplRows * iTemplCols;
+    for (int r=0; r<iRows; ++r)
+      {
+        const SumType
+          *pSumTop = sum.sumRow(r), *pSumBottom = sum.sumRow(r + iTemplRows),
+          *pSquaresTop = squares.sumRow(r), *pSquaresBottom = squares.sumRow(r + iTemplRows);
+        float* pResult = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          pResult[c] = Private::correlationCoefficient(pResult[c],
+                                                       double(PiiIntegralImage<SumType>::sum(pSumTop, pSumBottom, c, c + iTemplCols)),
+                                                       double(PiiIntegralImage<SumType>::sum(pSquaresTop, pSquaresBottom, c, c + iTemplCols)),
+                                                       iCount, correlationTemplate.dSquares);
+      }
+    return matResult;
+  }
+
+  template <class T>
+  PiiMatrix<float> findTemplate(const PiiImagePyramid<T>& image,
+                                const PiiImagePyramid<T>& templ,
+                                float threshold,
+                                int maxMatches,
+                                int levelCount)
+  {
+    using namespace Private;
+
+    PiiMatrix<float> matResult(0,3);
+    const PiiMatrix<T> matImage(image.image()), matTempl(templ.image());
+    if (matTempl.isEmpty() ||
+        matImage.rows() < matTempl.rows() ||
+        matImage.columns() < matTempl.columns())
+      return matResult;
+
+    const int iMaxLevels = qMin(image.levelCount(), templ.levelCount());
+    if (levelCount < 0 || levelCount > iMaxLevels)
+      levelCount = iMaxLevels;
+
+    // Find the coarsest level on which the template is still large
+    // enough.
+    int iTop = 0;
+    while (iTop + 1 < levelCount)
+      {
+        const PiiMatrix<T> matLevel(templ.level(iTop + 1));
+        if (!isCoarseEnough(matLevel.rows(), matLevel.columns()))
+          break;
+        ++iTop;
+      }
+
+    QVector<TemplateMatch> vecMatches;
+    collectCorrelationPeaks(normalizedCorrelation(image.level(iTop), templ.level(iTop)),
+                            threshold, vecMatches);
+    // Keep a few extra candidates in case some of them fade out or
+    // merge on the way down.
+    if (maxMatches > 0 && vecMatches.size() > qMax(4 * maxMatches, 8))
+      vecMatches.resize(qMax(4 * maxMatches, 8));
+
+    for (int iLevel=iTop-1; iLevel>=0 && vecMatches.size() > 0; --iLevel)
+      {
+        const PiiMatrix<T> matLevel(image.level(iLevel)), matTemplLevel(templ.level(iLevel));
+        const CorrelationTemplate<T> correlationTemplate(matTemplLevel);
+        const int
+          iMaxRow = matLevel.rows() - matTemplLevel.rows(),
+          iMaxCol = matLevel.columns() - matTemplLevel.columns();
+
+        QVector<TemplateMatch> vecRefined;
+        for (int i=0; i<vecMatches.size(); ++i)
+          {
+            // A pixel on the coarser level is two pixels on this one.
+            // Search a 5-by-5 neighborhood to tolerate the shifts
+            // caused by smoothing.
+            const int
+              iRow = vecMatches[i].row * 2,
+              iColumn = vecMatches[i].column * 2;
+            TemplateMatch best(-1, -1, -2);
+            for (int r=qMax(iRow-2, 0); r<=qMin(iRow+2, iMaxRow); ++r)
+              for (int c=qMax(iColumn-2, 0); c<=qMin(iColumn+2, iMaxCol); ++c)
+                {
+                  const float fScore = correlationAt(matLevel, correlationTemplate, r, c);
+                  if (fScore > best.score)
+                    best = TemplateMatch(r, c, fScore);
+                }
+            if (best.score >= threshold)
+              vecRefined.append(best);
+          }
+        std::sort(vecRefined.begin(), vecRefined.end());
+        vecMatches = vecRefined;
+      }
+
+    // Suppress duplicates and store the best matches.
+    const int iMinRowDistance = matTempl.rows() / 2, iMinColDistance = matTempl.columns() / 2;
+    for (int i=0; i<vecMatches.size() && (maxMatches < 0 || matResult.rows() < maxMatches); ++i)
+      {
+        bool bDuplicate = false;
+        for (int j=0; j<matResult.rows(); ++j)
+          if (Pii::abs(int(matResult(j,1)) - vecMatches[i].row) <= iMinRowDistance &&
+              Pii::abs(int(matResult(j,0)) - vecMatches[i].column) <= iMinColDistance)
+            {
+              bDuplicate = true;
+              break;
+            }
+        if (bDuplicate)
+          continue;
+        float* pRow = matResult.appendRow();
+        pRow[0] = float(vecMatches[i].column);
+        pRow[1] = float(vecMatches[i].row);
+        pRow[2] = vecMatches[i].score;
+      }
+    return matResult;
+  }
+}
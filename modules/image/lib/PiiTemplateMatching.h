@@ -0,0 +1,130 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEMPLATEMATCHING_H
+#define _PIITEMPLATEMATCHING_H
+
+#include "PiiImagePyramid.h"
+#include "PiiIntegralImage.h"
+
+namespace PiiImage
+{
+  /**
+   * Calculates the normalized cross-correlation (the correlation
+   * coefficient) between *templ* and each equal-sized window of
+   * *image*:
+   *
+   * \[
+   * \mathrm{ncc}(r,c) = \frac{\sum_{i,j} (I(r+i,c+j) - \bar{I}_{rc})(T(i,j) - \bar{T})}
+   * {\sqrt{\sum_{i,j} (I(r+i,c+j) - \bar{I}_{rc})^2 \sum_{i,j} (T(i,j) - \bar{T})^2}},
+   * \]
+   *
+   * where \(\bar{I}_{rc}\) is the mean of the window at (r,c) and
+   * \(\bar{T}\) the mean of the template. Since the zero-mean
+   * template sums up to zero, the numerator is the correlation of
+   * the image and the zero-mean template. It is calculated with
+   * [filterValidPart()], which moves to the frequency domain with
+   * large templates. The window sums in the denominator are read
+   * from integral images. If either the window or the template is
+   * constant, the correlation is zero.
+   *
+   * @param image the image to search
+   *
+   * @param templ the template
+   *
+   * @param policy the numerator is calculated in parallel as
+   * determined by *policy*.
+   *
+   * @return a matrix with `image.rows() - templ.rows() + 1` rows and
+   * `image.columns() - templ.columns() + 1` columns. The value at
+   * (r,c) is the correlation with the top left corner of the template
+   * at (r,c). The values are in [-1,1], 1 meaning a perfect match. If
+   * *templ* is empty or larger than *image*, an empty matrix will be
+   * returned.
+   */
+  template <class T>
+  PiiMatrix<float> normalizedCorrelation(const PiiMatrix<T>& image,
+                                         const PiiMatrix<T>& templ,
+                                         const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
+  /**
+   * Finds occurrences of *templ* in *image* with a coarse-to-fine
+   * search over image pyramids. The full [normalizedCorrelation()]
+   * is only calculated on the coarsest level. Its local maxima are
+   * tracked down the pyramid by evaluating the correlation at a few
+   * positions around each candidate on each finer level. A candidate
+   * is dropped as soon as its correlation falls below *threshold*.
+   *
+   * The coarsest level is the highest one on which the template is
+   * still at least 8 pixels high and wide. Since smoothing reduces
+   * the correlation of fine details, templates that consist of thin
+   * lines may need a lower *threshold* or a smaller *levelCount*.
+   *
+   * @param image a pyramid of the image to search. Missing levels
+   * will be calculated.
+   *
+   * @param templ a pyramid of the template, built with the same
+   * kernel as *image*
+   *
+   * @param threshold the minimum correlation of a match on each
+   * level
+   *
+   * @param maxMatches the maximum number of matches to return. -1
+   * means all. Matches that are at most half the template size away
+   * from a better one in both directions are considered duplicates.
+   *
+   * @param levelCount the maximum number of pyramid levels to use.
+   * One means that the full correlation is calculated on the original
+   * image. -1 means as many as possible.
+   *
+   * @return an N-by-3 matrix in which each row stores the (x,y)
+   * coordinates of the top left corner of a match and its
+   * correlation, in descending order of correlation. If *templ* is
+   * larger than *image*, an empty matrix will be returned.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matMatches = PiiImage::findTemplate(PiiImagePyramid<uchar>::shared(image),
+   *                                                      PiiImagePyramid<uchar>(templ),
+   *                                                      0.8f, 5);
+   * for (int i=0; i<matMatches.rows(); ++i)
+   *   markMatch(int(matMatches(i,0)), int(matMatches(i,1)), templ.columns(), templ.rows());
+   * ~~~
+   */
+  template <class T>
+  PiiMatrix<float> findTemplate(const PiiImagePyramid<T>& image,
+                                const PiiImagePyramid<T>& templ,
+                                float threshold = 0.7f,
+                                int maxMatches = 1,
+                                int levelCount = -1);
+
+  /**
+   * Finds occurrences of *templ* in *image* using temporary Gaussian
+   * pyramids.
+   */
+  template <class T>
+  inline PiiMatrix<float> findTemplate(const PiiMatrix<T>& image,
+                                       const PiiMatrix<T>& templ,
+                                       float threshold = 0.7f,
+                                       int maxMatches = 1,
+                                       int levelCount = -1)
+  {
+    return findTemplate(PiiImagePyramid<T>(image), PiiImagePyramid<T>(templ),
+                        threshold, maxMatches, levelCount);
+  }
+}
+
+#include "PiiTemplateMatching-templates.h"
+
+#endif //_PIITEMPLATEMATCHING_H
@@ -73,17 +73,16 @@ namespace PiiImage
     return th;
   }
 
-  template <class Image, class IntegralImage, class PixelCounter, class BinaryFunction>
+  template <class Image, class I, class PixelCounter, class BinaryFunction>
   void adaptiveThresholdImpl(const Image& image,
                              PiiMatrix<typename BinaryFunction::result_type>& matThresholded,
-                             const IntegralImage& integral,
+                             const PiiIntegralImage<I>& integral,
                              const PixelCounter& counter,
                              BinaryFunction func,
                              int windowRows, int windowColumns)
   {
     typedef typename BinaryFunction::result_type T;
     typedef typename Image::const_row_iterator ImageRow;
-    typedef typename IntegralImage::const_row_iterator IntegralRow;
     // Use at least float for the mean.
     typedef typename Pii::Combine<typename Image::value_type,float>::Type M;
 
@@ -93,15 +92,15 @@ namespace PiiImage
     const int iRows = image.rows(), iCols = image.columns();
     int c1, c2, r1, r2;
 
-    IntegralRow prevRow, nextRow;
+    const I* pPrevRow, *pNextRow;
     T* pTarget;
     for (int r=0; r<iRows; ++r)
       {
         // Check image boundaries
         r1 = qMax(r-iHalfRows, 0);
         r2 = qMin(r+iHalfRows+1, iRows);
-        prevRow = integral[r1];
-        nextRow = integral[r2];
+        pPrevRow = integral.sumRow(r1);
+        pNextRow = integral.sumRow(r2);
         pTarget = matThresholded[r];
         ImageRow pSource = image[r];
         for (int c=0; c<iCols; ++c)
@@ -110,7 +109,7 @@ namespace PiiImage
             c2 = qMin(c+iHalfCols+1, iCols);
             // Use the integral image to calculate moving average.
             pTarget[c] = func(M(pSource[c]),
-                              M(nextRow[c2] + prevRow[c1] - nextRow[c1] - prevRow[c2]) /
+                              M(PiiIntegralImage<I>::sum(pPrevRow, pNextRow, c1, c2)) /
                               counter.countPixels(r1, c1, r2, c2));
           }
       }
@@ -127,7 +126,7 @@ namespace PiiImage
     typedef typename Pii::Combine<typename Image::value_type,int>::Type I;
     adaptiveThresholdImpl(image,
                           matThresholded,
-                          Pii::cumulativeSum<I,Image>(image, Pii::ZeroBorderCumulativeSum),
+                          PiiIntegralImage<I>(image),
                           counter,
                           func,
                           windowRows,
@@ -139,20 +138,20 @@ namespace PiiImage
     T operator() (T value, U mask) const { return mask ? value : T(0); }
   };
 
-  // Uses cumulative sum of mask matrix to quickly count handled
-  // pixels in a local window.
+  // Uses the integral image of the mask matrix to quickly count
+  // handled pixels in a local window.
   template <class T=bool> struct RoiMaskPixelCounter
   {
     RoiMaskPixelCounter(const PiiMatrix<T>& mask) :
-      matMaskSum(Pii::cumulativeSum<int>(mask & 1, Pii::ZeroBorderCumulativeSum))
+      maskSum(mask & 1)
     {}
 
     inline int countPixels(int r1, int c1, int r2, int c2) const
     {
-      return matMaskSum(r2,c2) + matMaskSum(r1,c1) - matMaskSum(r2,c1) - matMaskSum(r1,c2);
+      return maskSum.sum(r1, c1, r2, c2);
     }
 
-    PiiMatrix<int> matMaskSum;
+    PiiIntegralImage<int> maskSum;
   };
 
   struct DefaultPixelCounter
@@ -279,9 +278,9 @@ namespace PiiImage
     typedef typename Pii::Combine<typename Matrix::value_type,long long>::Type I2;
 
     // Calculate an integral image
-    PiiMatrix<I> matIntegral = Pii::cumulativeSum<I,Matrix>(image, Pii::ZeroBorderCumulativeSum);
+    PiiIntegralImage<I> integral(image);
     // Integral image of squares
-    PiiMatrix<I2> matIntegral2 = Pii::cumulativeSum(image, Pii::Square<I2>(), Pii::ZeroBorderCumulativeSum);
+    PiiIntegralImage<I2> integral2(image, Pii::Square<I2>());
 
     if (windowColumns <= 0)
       windowColumns = windowRows;
@@ -298,10 +297,10 @@ namespace PiiImage
         // Check image boundaries
         r1 = qMax(r-iHalfRows, 0);
         r2 = qMin(r+iHalfRows+1, iRows);
-        pPrevRow = matIntegral[r1];
-        pNextRow = matIntegral[r2];
-        pPrevRow2 = matIntegral2[r1];
-        pNextRow2 = matIntegral2[r2];
+        pPrevRow = integral.sumRow(r1);
+        pNextRow = integral.sumRow(r2);
+        pPrevRow2 = integral2.sumRow(r1);
+        pNextRow2 = integral2.sumRow(r2);
         pTarget = matThresholded[r];
         ImageRow pSource = image[r];
 
@@ -310,8 +309,8 @@ namespace PiiImage
             c1 = qMax(c-iHalfCols, 0);
             c2 = qMin(c+iHalfCols+1, iCols);
             int iCount = (c2-c1) * (r2-r1);
-            double dMean = double(pNextRow[c2] + pPrevRow[c1] - pNextRow[c1] - pPrevRow[c2]) / iCount;
-            double dVar = double(pNextRow2[c2] + pPrevRow2[c1] - pNextRow2[c1] - pPrevRow2[c2]) / iCount // sum(x)/N
+            double dMean = double(PiiIntegralImage<I>::sum(pPrevRow, pNextRow, c1, c2)) / iCount;
+            double dVar = double(PiiIntegralImage<I2>::sum(pPrevRow2, pNextRow2, c1, c2)) / iCount // sum(x)/N
               - Pii::square(dMean);
 
             pTarget[c] = func(pSource[c],
@@ -320,6 +319,61 @@ namespace PiiImage
           }
       }
   }
+
+  namespace Private
+  {
+    template <class BinaryFunction> struct PercentileThreshold
+    {
+      typedef typename BinaryFunction::result_type T;
+      typedef typename BinaryFunction::second_argument_type U;
+
+      PercentileThreshold(const PiiMatrix<uchar>& image, PiiMatrix<T>& result,
+                          BinaryFunction func, double percentile, int offset) :
+        matImage(image), matResult(result),
+        function(func), dPercentile(percentile), iOffset(offset)
+      {}
+
+      void operator() (int r, int c, PiiSlidingHistogram& histogram)
+      {
+        matResult(r,c) = function(matImage(r,c), U(histogram.percentile(dPercentile) + iOffset));
+      }
+
+      const PiiMatrix<uchar>& matImage;
+      PiiMatrix<T>& matResult;
+      BinaryFunction function;
+      double dPercentile;
+      int iOffset;
+    };
+  }
+
+  template <class BinaryFunction>
+  PiiMatrix<typename BinaryFunction::result_type> percentileThreshold(const PiiMatrix<uchar>& image,
+                                                                      BinaryFunction func,
+                                                                      double percentile,
+                                                                      int offset,
+                                                                      int windowRows, int windowColumns)
+  {
+    typedef typename BinaryFunction::result_type T;
+    if (windowColumns <= 0)
+      windowColumns = windowRows;
+    const int iRows = image.rows(), iCols = image.columns();
+    if (iRows == 0 || iCols == 0)
+      return PiiMatrix<T>();
+    windowRows = qBound(1, windowRows, iRows);
+    windowColumns = qBound(1, windowColumns, iCols);
+    const int iHalfRows = windowRows/2, iHalfCols = windowColumns/2;
+
+    // Pad the image so that a window centered at each pixel fits in.
+    PiiMatrix<uchar> matPadded(Pii::extend(image, iHalfRows, windowRows - iHalfRows - 1,
+                                           iHalfCols, windowColumns - iHalfCols - 1,
+                                           Pii::ExtendReplicate));
+    PiiMatrix<T> matThresholded(PiiMatrix<T>::uninitialized(iRows, iCols));
+    Private::PercentileThreshold<BinaryFunction> threshold(image, matThresholded, func, percentile, offset);
+    PiiSlidingHistogram histogram(256);
+    histogram.scan(matPadded, windowRows, windowColumns, threshold);
+    return matThresholded;
+  }
 }
 
 #endif //_PIITHRESHOLDING_TEMPLATES_H
+
@@ -17,8 +17,13 @@
 #define _PIITHRESHOLDING_H
 
 #include <PiiMatrix.h>
+#include <PiiBitMatrix.h>
+#include <PiiParallel.h>
+#include <PiiMatrixUtil.h>
 #include "PiiHistogram.h"
 #include "PiiLabeling.h"
+#include "PiiIntegralImage.h"
+#include "PiiSlidingHistogram.h"
 
 namespace PiiImage
 {
@@ -325,6 +330,60 @@ namespace PiiImage
     return matOutput;
   }
 
+  /// @internal
+  template <class T, class UnaryFunction> class ThresholdStrip
+  {
+  public:
+    ThresholdStrip(const PiiMatrix<T>& input, PiiMatrix<T>& output, UnaryFunction function) :
+      _input(input),
+      _pOutput(reinterpret_cast<char*>(output.row(0))),
+      _iStride(output.stride()),
+      _function(function)
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      const int iRows = endRow - firstRow;
+      PiiMatrix<T> matInput(iRows, _input.columns(), _input.row(firstRow), _input.stride());
+      PiiMatrix<T> matOutput(iRows, _input.columns(), _pOutput + firstRow * _iStride,
+                             Pii::RetainOwnership, _iStride);
+      transform(matInput, matOutput, _function);
+    }
+
+  private:
+    const PiiMatrix<T>& _input;
+    char* _pOutput;
+    std::size_t _iStride;
+    UnaryFunction _function;
+  };
+
+  /**
+   * Thresholds *input* in parallel. Each pixel is transformed with
+   * *function* and *level* as in the sequential version, but the
+   * image is divided into strips as determined by *policy*.
+   *
+   * ~~~(c++)
+   * PiiMatrix<uchar> matBinary = PiiImage::threshold(image,
+   *                                                  PiiImage::ThresholdFunction<uchar>(),
+   *                                                  uchar(128),
+   *                                                  PiiParallelPolicy());
+   * ~~~
+   */
+  template <class T, class Function>
+  PiiMatrix<T> threshold(const PiiMatrix<T>& input,
+                         Function function,
+                         T level,
+                         const PiiParallelPolicy& policy)
+  {
+    if (policy.stripCount(input.rows()) <= 1)
+      return threshold(input, function, level);
+
+    PiiMatrix<T> matOutput(PiiMatrix<T>::uninitialized(input.rows(), input.columns()));
+    ThresholdStrip<T, std::binder2nd<Function> > strip(input, matOutput, std::bind2nd(function, level));
+    Pii::forEachStrip(input.rows(), strip, policy);
+    return matOutput;
+  }
+
   /**
    * Thresholds an image.
    *
@@ -359,6 +418,29 @@ namespace PiiImage
     return threshold(image, InverseThresholdFunction<T>(), level);
   }
 
+  /**
+   * Thresholds an image directly to a bit-packed binary image. The
+   * result has a bit set wherever [threshold()] would output a
+   * non-zero value, but no intermediate byte image is created.
+   *
+   * ~~~(c++)
+   * PiiBitMatrix matBinary = PiiImage::thresholdBits(image, uchar(128));
+   * ~~~
+   */
+  template <class T> inline PiiBitMatrix thresholdBits(const PiiMatrix<T>& image, T level)
+  {
+    return PiiBitMatrix(image, std::bind2nd(ThresholdFunction<T>(), level));
+  }
+
+  /**
+   * Thresholds and inverts an image directly to a bit-packed binary
+   * image.
+   */
+  template <class T> inline PiiBitMatrix inverseThresholdBits(const PiiMatrix<T>& image, T level)
+  {
+    return PiiBitMatrix(image, std::bind2nd(InverseThresholdFunction<T>(), level));
+  }
+
   /**
    * Sets pixels above *level* to *level*.
    *
@@ -694,6 +776,49 @@ namespace PiiImage
   PiiMatrix<typename TernaryFunction::result_type> adaptiveThresholdVar(const Matrix& image,
                                                                         TernaryFunction func,
                                                                         int windowRows, int windowColumns = 0);
+
+  /**
+   * Thresholds an 8-bit image against a local percentile. The
+   * threshold of each pixel is the *percentile* of its neighborhood
+   * plus *offset*. Unlike the local mean used by
+   * [adaptiveThreshold()], a percentile is not biased by a few very
+   * bright or dark pixels in the window. Image borders are handled by
+   * replicating the outermost pixels.
+   *
+   * @param image the input image
+   *
+   * @param func a binary function whose return value replaces the
+   * pixel value, invoked as `func(pixel, threshold)`.
+   *
+   * @param percentile the local percentile, in [0,1]. 0.5 uses the
+   * local median.
+   *
+   * @param offset a constant added to the local percentile
+   *
+   * @param windowRows the number of rows in the local window
+   *
+   * @param windowColumns the number of columns in the local window.
+   * If this value is non-positive, a `windowRows` - by - `windowRows`
+   * square window will be used.
+   *
+   * ! Window size has no effect on processing time (see
+   * PiiSlidingHistogram).
+   *
+   * ~~~(c++)
+   * using namespace PiiImage;
+   * PiiMatrix<uchar> img;
+   * // Mark pixels that are at least 10 levels above the local 75th
+   * // percentile.
+   * PiiMatrix<uchar> matBinary = percentileThreshold(img, ThresholdFunction<uchar,uchar,int>(),
+   *                                                  0.75, 10, 31);
+   * ~~~
+   */
+  template <class BinaryFunction>
+  PiiMatrix<typename BinaryFunction::result_type> percentileThreshold(const PiiMatrix<uchar>& image,
+                                                                      BinaryFunction func,
+                                                                      double percentile,
+                                                                      int offset,
+                                                                      int windowRows, int windowColumns = 0);
 }
 
 #include "PiiThresholding-templates.h"
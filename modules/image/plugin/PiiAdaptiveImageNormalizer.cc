@@ -18,10 +18,13 @@
 #include <PiiYdinTypes.h>
 
 #include "PiiThresholding.h"
+#include "PiiHistogram.h"
 
 PiiAdaptiveImageNormalizer::Data::Data() :
   windowSize(64,64),
-  dTargetMean(NAN)
+  dTargetMean(NAN),
+  mode(MeanNormalization),
+  dClipLimit(2)
 {
 }
 
@@ -75,14 +78,39 @@ template <class T> void PiiAdaptiveImageNormalizer::normalizeColor(const PiiVari
 template <class T> PiiMatrix<T> PiiAdaptiveImageNormalizer::normalize(const PiiMatrix<T>& image)
 {
   PII_D;
+  if (d->mode == TileEqualization)
+    return equalizeTiles(image, Pii::IsInteger<T>());
+
   double dTarget = d->dTargetMean;
   if (Pii::isNan(dTarget))
     dTarget = PiiImage::Traits<T>::max() / 2;
   return PiiImage::adaptiveThreshold(image, Normalizer<T>(dTarget), d->windowSize.width(), d->windowSize.height());
 }
 
+template <class T> PiiMatrix<T> PiiAdaptiveImageNormalizer::equalizeTiles(const PiiMatrix<T>& image, Pii::True)
+{
+  PII_D;
+  // 8-bit images are stretched to the full range. With other types,
+  // the maximum gray level is retained.
+  return PiiImage::equalizeLocally(image,
+                                   d->windowSize.height(), d->windowSize.width(),
+                                   Pii::IsSame<T,uchar>::boolValue ? 256 : 0,
+                                   d->dClipLimit);
+}
+
+template <class T> PiiMatrix<T> PiiAdaptiveImageNormalizer::equalizeTiles(const PiiMatrix<T>&, Pii::False)
+{
+  PII_THROW(PiiExecutionException, tr("Tile equalization requires integer gray levels."));
+}
+
 void PiiAdaptiveImageNormalizer::setWindowSize(const QSize& windowSize) { _d()->windowSize = windowSize; }
 QSize PiiAdaptiveImageNormalizer::windowSize() const { return _d()->windowSize; }
 
 void PiiAdaptiveImageNormalizer::setTargetMean(double targetMean) { _d()->dTargetMean = targetMean; }
 double PiiAdaptiveImageNormalizer::targetMean() const { return _d()->dTargetMean; }
+
+void PiiAdaptiveImageNormalizer::setMode(Mode mode) { _d()->mode = mode; }
+PiiAdaptiveImageNormalizer::Mode PiiAdaptiveImageNormalizer::mode() const { return _d()->mode; }
+
+void PiiAdaptiveImageNormalizer::setClipLimit(double clipLimit) { _d()->dClipLimit = qMax(0.0, clipLimit); }
+double PiiAdaptiveImageNormalizer::clipLimit() const { return _d()->dClipLimit; }
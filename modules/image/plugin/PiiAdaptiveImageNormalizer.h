@@ -29,6 +29,14 @@
  * The operation prevents overflows by cutting the gray levels at 255
  * in 8-bit images. Other data types will not be cut.
  *
+ * Alternatively, the operation can normalize contrast with
+ * contrast-limited adaptive histogram equalization (see [mode]). In
+ * this mode, [windowSize] sets the size of the tiles whose histograms
+ * are equalized. Since the mapping of each tile is calculated only
+ * once and interpolated between tile centers, the cost doesn't grow
+ * with window size. Tile equalization works only with integer gray
+ * levels.
+ *
  * Inputs
  * ------
  *
@@ -59,8 +67,32 @@ class PiiAdaptiveImageNormalizer : public PiiDefaultOperation
    */
   Q_PROPERTY(double targetMean READ targetMean WRITE setTargetMean);
 
+  /**
+   * The normalization method. The default is `MeanNormalization`.
+   */
+  Q_PROPERTY(Mode mode READ mode WRITE setMode);
+  Q_ENUMS(Mode);
+
+  /**
+   * Limits contrast amplification in `TileEqualization` mode. See
+   * PiiImage::equalizeLocally(). The default value is 2. Zero
+   * disables clipping.
+   */
+  Q_PROPERTY(double clipLimit READ clipLimit WRITE setClipLimit);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Normalization methods.
+   *
+   * - `MeanNormalization` - scale each pixel by the ratio of the
+   * target mean to the local mean in a sliding window.
+   *
+   * - `TileEqualization` - equalize histograms locally in tiles and
+   * interpolate between them (CLAHE). [targetMean] is not used.
+   */
+  enum Mode { MeanNormalization, TileEqualization };
+
   PiiAdaptiveImageNormalizer();
 
 protected:
@@ -72,10 +104,18 @@ protected:
   void setTargetMean(double targetMean);
   double targetMean() const;
 
+  void setMode(Mode mode);
+  Mode mode() const;
+
+  void setClipLimit(double clipLimit);
+  double clipLimit() const;
+
 private:
   template <class T> void normalizeColor(const PiiVariant& obj);
   template <class T> void normalizeGray(const PiiVariant& obj);
   template <class T> PiiMatrix<T> normalize(const PiiMatrix<T>& obj);
+  template <class T> PiiMatrix<T> equalizeTiles(const PiiMatrix<T>& image, Pii::True);
+  template <class T> PiiMatrix<T> equalizeTiles(const PiiMatrix<T>& image, Pii::False);
   template <class T> struct Normalizer;
 
   /// @internal
@@ -85,6 +125,8 @@ private:
     Data();
     QSize windowSize;
     double dTargetMean;
+    Mode mode;
+    double dClipLimit;
   };
   PII_D_FUNC;
 };
@@ -43,15 +43,23 @@ void PiiBoundaryFinderOperation::process()
   switch (obj.type())
     {
       PII_GRAY_IMAGE_CASES(findBoundaries, obj);
+    case PiiYdin::BitMatrixType:
+      findBoundaries(obj.valueAs<PiiBitMatrix>(), std::bind2nd(std::equal_to<bool>(), true));
+      break;
     default:
       PII_THROW_UNKNOWN_TYPE(inputAt(0));
     }
 }
 
 template <class T> void PiiBoundaryFinderOperation::findBoundaries(const PiiVariant& obj)
+{
+  findBoundaries(obj.valueAs<PiiMatrix<T> >(), std::bind2nd(std::greater<T>(), T(_d()->dThreshold)));
+}
+
+template <class Matrix, class UnaryOp>
+void PiiBoundaryFinderOperation::findBoundaries(const Matrix& image, UnaryOp rule)
 {
   PII_D;
-  const PiiMatrix<T> image(obj.valueAs<PiiMatrix<T> >());
   PiiMatrix<unsigned char> matBoundaryMask;
   PiiBoundaryFinder finder(image.rows(), image.columns(), &matBoundaryMask);
   PiiMatrix<int> matPoints(0,2);
@@ -62,7 +70,7 @@ template <class T> void PiiBoundaryFinderOperation::findBoundaries(const PiiVari
 
   for (;;)
     {
-      int iPoints = finder.findNextBoundary(image, std::bind2nd(std::greater<T>(), T(d->dThreshold)), matPoints);
+      int iPoints = finder.findNextBoundary(image, rule, matPoints);
       if (iPoints == 0)
         break;
       if (iPoints < d->iMinLength || iPoints > d->iMaxLength)
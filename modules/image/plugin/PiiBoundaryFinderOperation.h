@@ -27,7 +27,8 @@
  * @in image - input image. This is usually a binary image or a
  * labeled image, but any gray-level image works. To avoid a separate
  * thresholding step one can set the [threshold] property to a non-zero
- * value.
+ * value. Bit-packed binary images (PiiBitMatrix) are traced as such;
+ * their set bits are objects.
  *
  * Outputs
  * -------
@@ -110,6 +111,7 @@ private:
   PII_D_FUNC;
 
   template <class T> void findBoundaries(const PiiVariant& obj);
+  template <class Matrix, class UnaryOp> void findBoundaries(const Matrix& image, UnaryOp rule);
 };
 
 #endif //_PIIBOUNDARYFINDEROPERATION_H
@@ -16,9 +16,11 @@
 #include <PiiYdinTypes.h>
 #include "PiiCornerDetector.h"
 #include "PiiImage.h"
+#include "PiiImagePyramid.h"
 
 PiiCornerDetector::Data::Data() :
-  dThreshold(25)
+  dThreshold(25),
+  iLevelCount(1)
 {
 }
 
@@ -43,9 +45,17 @@ void PiiCornerDetector::process()
 
 template <class T> void PiiCornerDetector::detectCorners(const PiiVariant& obj)
 {
-  emitObject(PiiImage::detectFastCorners(obj.valueAs<PiiMatrix<T> >(),
-                                         T(_d()->dThreshold)));
+  PII_D;
+  const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  if (d->iLevelCount == 1)
+    emitObject(PiiImage::detectFastCorners(image, T(d->dThreshold)));
+  else
+    emitObject(PiiImage::detectFastCorners(PiiImagePyramid<T>::shared(image),
+                                           T(d->dThreshold),
+                                           d->iLevelCount));
 }
 
 void PiiCornerDetector::setThreshold(double threshold) { _d()->dThreshold = threshold; }
 double PiiCornerDetector::threshold() const { return _d()->dThreshold; }
+void PiiCornerDetector::setLevelCount(int levelCount) { _d()->iLevelCount = levelCount < 0 ? -1 : qMax(1, levelCount); }
+int PiiCornerDetector::levelCount() const { return _d()->iLevelCount; }
@@ -31,7 +31,10 @@
  * -------
  *
  * @out corners - corner coordinates, a N-by-2 PiiMatrix<int> in which
- * each row stores the (x,y) coordinates of a detected corner.
+ * each row stores the (x,y) coordinates of a detected corner. If
+ * [levelCount] is not one, the matrix has a third column that stores
+ * the index of the pyramid level the corner was found on. The
+ * coordinates are those of the level.
  *
  */
 class PiiCornerDetector : public PiiDefaultOperation
@@ -44,6 +47,16 @@ class PiiCornerDetector : public PiiDefaultOperation
    */
   Q_PROPERTY(double threshold READ threshold WRITE setThreshold);
 
+  /**
+   * The number of image pyramid levels corners are detected on,
+   * starting at the original image. Each level halves the size of the
+   * previous one (see PiiImagePyramid). The pyramid is shared with
+   * other operations that build a Gaussian pyramid out of the same
+   * image. -1 means all levels. The default is one, which only
+   * detects corners on the original image.
+   */
+  Q_PROPERTY(int levelCount READ levelCount WRITE setLevelCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiCornerDetector();
@@ -51,6 +64,9 @@ public:
   void setThreshold(double threshold);
   double threshold() const;
 
+  void setLevelCount(int levelCount);
+  int levelCount() const;
+
 protected:
   void process();
 
@@ -61,6 +77,7 @@ private:
   public:
     Data();
     double dThreshold;
+    int iLevelCount;
   };
   PII_D_FUNC;
 
@@ -21,6 +21,8 @@
 PiiEdgeDetector::Data::Data() :
   detector(CannyDetector),
   dThreshold(0), dLowThreshold(0),
+  iTransformThreadCount(1),
+  bMagnitudeConnected(false),
   bDirectionConnected(false)
 {
 }
@@ -57,6 +59,7 @@ void PiiEdgeDetector::check(bool reset)
       break;
     }
 
+  d->bMagnitudeConnected = outputAt(1)->isConnected();
   d->bDirectionConnected = outputAt(2)->isConnected();
 }
 
@@ -78,6 +81,11 @@ void PiiEdgeDetector::process()
 template <class T> void PiiEdgeDetector::detectIntEdges(const PiiVariant& obj)
 {
   PII_D;
+  if (d->detector == CannyDetector)
+    {
+      detectCannyEdges(obj.valueAs<PiiMatrix<T> >());
+      return;
+    }
   PiiMatrix<int> image(obj.valueAs<PiiMatrix<T> >());
   detectEdges(PiiImage::filter<int>(image, d->matFilterX),
               PiiImage::filter<int>(image, d->matFilterY));
@@ -87,10 +95,33 @@ template <class T> void PiiEdgeDetector::detectFloatEdges(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  if (d->detector == CannyDetector)
+    {
+      detectCannyEdges(image);
+      return;
+    }
   detectEdges(PiiImage::filter<T>(image, PiiMatrix<T>(d->matFilterX)),
               PiiImage::filter<T>(image, PiiMatrix<T>(d->matFilterY)));
 }
 
+template <class T> void PiiEdgeDetector::detectCannyEdges(const PiiMatrix<T>& image)
+{
+  PII_D;
+  typedef typename PiiImage::EdgeGradient<T>::Type G;
+  PiiMatrix<G> matMagnitude;
+  PiiMatrix<float> matDirection;
+  PiiMatrix<int> matEdges = PiiImage::cannyEdges(image, G(d->dLowThreshold), G(d->dThreshold),
+                                                 Pii::ExtendReplicate,
+                                                 PiiParallelPolicy(d->iTransformThreadCount),
+                                                 d->bMagnitudeConnected ? &matMagnitude : 0,
+                                                 d->bDirectionConnected ? &matDirection : 0);
+  if (d->bMagnitudeConnected)
+    outputAt(1)->emitObject(matMagnitude);
+  emitObject(PiiMatrix<G>(matEdges));
+  if (d->bDirectionConnected)
+    outputAt(2)->emitObject(matDirection);
+}
+
 template <class T> void PiiEdgeDetector::detectEdges(const PiiMatrix<T>& gradientX,
                                                      const PiiMatrix<T>& gradientY)
 {
@@ -106,10 +137,7 @@ template <class T> void PiiEdgeDetector::detectEdges(const PiiMatrix<T>& gradien
       threshold = T(fMean + fStd * 2);
     }
 
-  if (d->detector == CannyDetector)
-    cannyThreshold(gradientX, gradientY, matMagnitude, threshold);
-  else
-    matMagnitude.map(PiiImage::ThresholdFunction<T>(), threshold);
+  matMagnitude.map(PiiImage::ThresholdFunction<T>(), threshold);
 
   // Send detected edges
   emitObject(matMagnitude);
@@ -118,26 +146,11 @@ template <class T> void PiiEdgeDetector::detectEdges(const PiiMatrix<T>& gradien
     outputAt(2)->emitObject(PiiImage::gradientDirection(gradientX, gradientY));
 }
 
-template <class T> void PiiEdgeDetector::cannyThreshold(const PiiMatrix<T>& gradientX,
-                                                        const PiiMatrix<T>& gradientY,
-                                                        PiiMatrix<T>& magnitude,
-                                                        T highThreshold)
-{
-  PII_D;
-  T lowThreshold = T(d->dLowThreshold == 0 ? 0.4 * highThreshold : d->dLowThreshold);
-  /*magnitude = PiiImage::suppressNonMaxima(magnitude,
-                                          PiiImage::gradientDirection(gradientX, gradientY),
-                                          PiiImage::RadiansToPoints<float>());
-  */
-  magnitude = PiiImage::hysteresisThreshold(PiiImage::suppressNonMaxima(magnitude,
-                                                                        PiiImage::gradientDirection(gradientX, gradientY),
-                                                                        PiiImage::RadiansToPoints<float>()),
-                                            lowThreshold, highThreshold);
-}
-
 PiiEdgeDetector::Detector PiiEdgeDetector::detector() const { return _d()->detector; }
 void PiiEdgeDetector::setDetector(Detector detector) { _d()->detector = detector; }
 void PiiEdgeDetector::setThreshold(double threshold) { _d()->dThreshold = threshold; }
 double PiiEdgeDetector::threshold() const { return _d()->dThreshold; }
 void PiiEdgeDetector::setLowThreshold(double lowThreshold) { _d()->dLowThreshold = lowThreshold; }
 double PiiEdgeDetector::lowThreshold() const { return _d()->dLowThreshold; }
+void PiiEdgeDetector::setTransformThreadCount(int transformThreadCount) { _d()->iTransformThreadCount = qMax(0, transformThreadCount); }
+int PiiEdgeDetector::transformThreadCount() const { return _d()->iTransformThreadCount; }
@@ -74,6 +74,15 @@ class PiiEdgeDetector : public PiiDefaultOperation
    */
   Q_PROPERTY(double lowThreshold READ lowThreshold WRITE setLowThreshold);
 
+  /**
+   * The number of threads used for detecting Canny edges in one
+   * image. The rows of the image are divided among the threads (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one, which processes each image in the processing
+   * thread only.
+   */
+  Q_PROPERTY(int transformThreadCount READ transformThreadCount WRITE setTransformThreadCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -92,7 +101,10 @@ public:
    * image is processed to contain only local maxima (
    * [PiiImage::suppressNonMaxima()]) 3) hysteresis thresholding is
    * performed ([PiiImage::hysteresisThreshold()]). This technique
-   * requires two thresholds ([lowThreshold] and [threshold]).
+   * requires two thresholds ([lowThreshold] and [threshold]). All
+   * steps are performed in a single pass over the image
+   * ([PiiImage::cannyEdges()]), and the magnitude and direction are
+   * only stored if the corresponding outputs are connected.
    *
    * ! The original edge detection technique by Canny actually
    * uses derivatives of 2D Gaussians to calculate the gradient. This
@@ -115,6 +127,9 @@ public:
   void setLowThreshold(double lowThreshold);
   double lowThreshold() const;
 
+  void setTransformThreadCount(int transformThreadCount);
+  int transformThreadCount() const;
+
   void check(bool reset);
 
 protected:
@@ -123,12 +138,9 @@ protected:
 private:
   template <class T> void detectIntEdges(const PiiVariant& obj);
   template <class T> void detectFloatEdges(const PiiVariant& obj);
+  template <class T> void detectCannyEdges(const PiiMatrix<T>& image);
   template <class T> void detectEdges(const PiiMatrix<T>& gradientX,
                                       const PiiMatrix<T>& gradientY);
-  template <class T> void cannyThreshold(const PiiMatrix<T>& gradientX,
-                                         const PiiMatrix<T>& gradientY,
-                                         PiiMatrix<T>& magnitude,
-                                         T highThreshold);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -139,7 +151,8 @@ private:
     double dThreshold;
     double dLowThreshold;
     PiiMatrix<int> matFilterX, matFilterY;
-    bool bDirectionConnected;
+    int iTransformThreadCount;
+    bool bMagnitudeConnected, bDirectionConnected;
   };
   PII_D_FUNC;
 };
@@ -18,7 +18,9 @@
 #include "PiiHistogram.h"
 
 PiiHistogramEqualizer::Data::Data() :
-  iLevels(256)
+  iLevels(256),
+  tileSize(0,0),
+  dClipLimit(0)
 {
 }
 
@@ -50,11 +52,22 @@ void PiiHistogramEqualizer::process()
 
 template <class T> void PiiHistogramEqualizer::equalize(const PiiVariant& obj)
 {
+  PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  emitObject(PiiImage::equalize(img, (unsigned)_d()->iLevels));
+  if (d->tileSize.width() > 0 && d->tileSize.height() > 0)
+    emitObject(PiiImage::equalizeLocally(img,
+                                         d->tileSize.height(), d->tileSize.width(),
+                                         (unsigned)d->iLevels, d->dClipLimit));
+  else
+    emitObject(PiiImage::equalize(img, (unsigned)d->iLevels));
 }
 
 int PiiHistogramEqualizer::levels() const
 {
   return _d()->iLevels;
 }
+
+void PiiHistogramEqualizer::setTileSize(const QSize& tileSize) { _d()->tileSize = tileSize; }
+QSize PiiHistogramEqualizer::tileSize() const { return _d()->tileSize; }
+void PiiHistogramEqualizer::setClipLimit(double clipLimit) { _d()->dClipLimit = qMax(0.0, clipLimit); }
+double PiiHistogramEqualizer::clipLimit() const { return _d()->dClipLimit; }
@@ -22,6 +22,12 @@
  * Histogram equalizer. Enhances the contrast of input images by
  * making their gray-level distributions as uniform as possible.
  *
+ * By default, the whole image is equalized with a single mapping.
+ * If [tileSize] is set, the operation performs contrast-limited
+ * adaptive histogram equalization (CLAHE) instead: each tile is
+ * equalized separately, and the mappings are interpolated between
+ * tile centers. See PiiImage::equalizeLocally().
+ *
  * Inputs
  * ------
  *
@@ -44,12 +50,31 @@ class PiiHistogramEqualizer : public PiiDefaultOperation
    */
   Q_PROPERTY(int levels READ levels WRITE setLevels);
 
+  /**
+   * The approximate size of a tile in local equalization. If either
+   * dimension is zero or negative (the default), the image is
+   * equalized globally.
+   */
+  Q_PROPERTY(QSize tileSize READ tileSize WRITE setTileSize);
+
+  /**
+   * Limits contrast amplification in local equalization. Histogram
+   * bins higher than `clipLimit` times the average bin height are
+   * clipped. The default is 0, which disables clipping. Typical
+   * values are 2-4. Ignored in global equalization.
+   */
+  Q_PROPERTY(double clipLimit READ clipLimit WRITE setClipLimit);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiHistogramEqualizer();
 
   void setLevels(int levels);
   int levels() const;
+  void setTileSize(const QSize& tileSize);
+  QSize tileSize() const;
+  void setClipLimit(double clipLimit);
+  double clipLimit() const;
 
 protected:
   void process();
@@ -62,7 +87,10 @@ private:
   {
   public:
     Data();
-    int iLevels;};
+    int iLevels;
+    QSize tileSize;
+    double dClipLimit;
+  };
   PII_D_FUNC;
 
 };
@@ -0,0 +1,324 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImageAugmenter.h"
+#include "PiiImage.h"
+#include <PiiYdinTypes.h>
+#include <PiiParallel.h>
+#include <PiiMath.h>
+#include <limits>
+
+namespace
+{
+  // Integers are rounded and saturated, floats just added.
+  template <class T> inline T addNoise(T value, float noise, Pii::True)
+  {
+    return Pii::round<T>(qBound(double(std::numeric_limits<T>::min()),
+                                double(value) + noise,
+                                double(std::numeric_limits<T>::max())));
+  }
+
+  template <class T> inline T addNoise(T value, float noise, Pii::False)
+  {
+    return T(value + noise);
+  }
+
+  template <class T> inline T addNoise(T value, float noise)
+  {
+    return addNoise(value, noise, typename Pii::IfClass<Pii::IsInteger<T>, Pii::True, Pii::False>::Type());
+  }
+}
+
+template <class T> struct PiiImageAugmenter::Noise
+{
+  enum { channels = 1 };
+  static inline T add(T value, const float* noise) { return addNoise(value, noise[0]); }
+};
+
+template <class T> struct PiiImageAugmenter::Noise<PiiColor<T> >
+{
+  enum { channels = 3 };
+  static inline PiiColor<T> add(const PiiColor<T>& value, const float* noise)
+  {
+    return PiiColor<T>(addNoise(value.c0, noise[0]),
+                       addNoise(value.c1, noise[1]),
+                       addNoise(value.c2, noise[2]));
+  }
+};
+
+// Alpha is retained
+template <class T> struct PiiImageAugmenter::Noise<PiiColor4<T> >
+{
+  enum { channels = 3 };
+  static inline PiiColor4<T> add(const PiiColor4<T>& value, const float* noise)
+  {
+    return PiiColor4<T>(addNoise(value.c0, noise[0]),
+                        addNoise(value.c1, noise[1]),
+                        addNoise(value.c2, noise[2]),
+                        value.c3);
+  }
+};
+
+// Builds the missing rotation tables concurrently.
+struct PiiImageAugmenter::TableStrip
+{
+  TableStrip(const PiiImageAugmenter* op, const QVector<int>& angles, PiiRemapTable* tables,
+             int rows, int columns, PiiImage::TransformedSize handling) :
+    pOperation(op), vecAngles(angles), pTables(tables),
+    iRows(rows), iColumns(columns), transformedSize(handling)
+  {}
+
+  void operator() (int first, int end)
+  {
+    for (int i=first; i<end; ++i)
+      pTables[vecAngles[i]] = PiiRemapTable(PiiImage::createRotationTransform(float(pOperation->angleAt(vecAngles[i])),
+                                                                            iColumns/2.0, iRows/2.0),
+                                            iRows, iColumns, transformedSize);
+  }
+
+  const PiiImageAugmenter* pOperation;
+  const QVector<int>& vecAngles;
+  PiiRemapTable* pTables;
+  int iRows, iColumns;
+  PiiImage::TransformedSize transformedSize;
+};
+
+// Creates the variants concurrently. The image and the tables are
+// only read, and each variant is written to its own slot.
+template <class T> struct PiiImageAugmenter::VariantStrip
+{
+  VariantStrip(const PiiMatrix<T>& image, const Variant* variants, const PiiRemapTable* tables,
+               float noiseSigma, PiiMatrix<T>* results) :
+    matImage(image), pVariants(variants), pTables(tables),
+    fNoiseSigma(noiseSigma), pResults(results)
+  {}
+
+  void operator() (int first, int end)
+  {
+    for (int i=first; i<end; ++i)
+      {
+        const Variant& variant = pVariants[i];
+        const PiiMatrix<T> matRotated(variant.iAngle >= 0 ?
+                                      pTables[variant.iAngle].remap(matImage, T(0)) :
+                                      matImage);
+        // The crop refers to the rotated image.
+        const PiiMatrix<T> matCrop(variant.iWidth == matRotated.columns() &&
+                                   variant.iHeight == matRotated.rows() ?
+                                   matRotated :
+                                   matRotated(variant.iY, variant.iX, variant.iHeight, variant.iWidth));
+        pResults[i] = fNoiseSigma > 0 ? noisy(matCrop, variant.iNoiseSeed) : matCrop;
+      }
+  }
+
+  PiiMatrix<T> noisy(const PiiMatrix<T>& image, quint64 seed) const
+  {
+    const int iRows = image.rows(), iColumns = image.columns();
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iRows, iColumns));
+    PiiRandomGenerator generator(seed);
+    QVector<float> vecNoise(iColumns * Noise<T>::channels);
+    for (int r=0; r<iRows; ++r)
+      {
+        // A row of noise at a time
+        generator.fillNormal(vecNoise.data(), vecNoise.size(), 0.0f, fNoiseSigma);
+        const T* pSource = image.row(r);
+        T* pTarget = matResult.row(r);
+        const float* pNoise = vecNoise.constData();
+        for (int c=0; c<iColumns; ++c, pNoise += Noise<T>::channels)
+          pTarget[c] = Noise<T>::add(pSource[c], pNoise);
+      }
+    return matResult;
+  }
+
+  const PiiMatrix<T>& matImage;
+  const Variant* pVariants;
+  const PiiRemapTable* pTables;
+  float fNoiseSigma;
+  PiiMatrix<T>* pResults;
+};
+
+PiiImageAugmenter::Data::Data() :
+  iVariantCount(16),
+  dMaxAngle(0.0),
+  iAngleSteps(9),
+  transformedSize(PiiImage::RetainOriginalSize),
+  iCropWidth(0), iCropHeight(0),
+  dNoiseLevel(0.0),
+  iRandomSeed(0),
+  iWorkerCount(0),
+  iTableRows(0), iTableColumns(0)
+{
+}
+
+PiiImageAugmenter::PiiImageAugmenter() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  addSocket(new PiiInputSocket("image"));
+  addSocket(new PiiInputSocket("label"));
+  inputAt(1)->setOptional(true);
+  addSocket(new PiiOutputSocket("image"));
+  addSocket(new PiiOutputSocket("label"));
+}
+
+void PiiImageAugmenter::check(bool reset)
+{
+  PII_D;
+  if (d->iVariantCount < 1)
+    PII_THROW(PiiExecutionException, tr("The number of variants must be at least one."));
+  if (d->iAngleSteps < 1)
+    PII_THROW(PiiExecutionException, tr("The number of rotation angles must be at least one."));
+
+  PiiDefaultOperation::check(reset);
+
+  if (reset)
+    d->generator.seed(quint64(d->iRandomSeed));
+}
+
+void PiiImageAugmenter::process()
+{
+  PiiVariant obj = inputAt(0)->firstObject();
+
+  switch (obj.type())
+    {
+      PII_GRAY_IMAGE_CASES(augment, obj);
+      PII_COLOR_IMAGE_CASES(augment, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(inputAt(0));
+    }
+}
+
+template <class T> void PiiImageAugmenter::augment(const PiiVariant& obj)
+{
+  PII_D;
+  const PiiMatrix<T> matImage(obj.valueAs<PiiMatrix<T> >());
+  const int iVariants = d->iVariantCount;
+
+  if (matImage.rows() != d->iTableRows || matImage.columns() != d->iTableColumns ||
+      d->vecRotationTables.size() != d->iAngleSteps)
+    {
+      clearTables();
+      d->vecRotationTables.resize(d->iAngleSteps);
+      d->iTableRows = matImage.rows();
+      d->iTableColumns = matImage.columns();
+    }
+
+  // Draw the angles first because the crops depend on the size of
+  // the rotated image.
+  QVector<Variant> vecVariants(iVariants);
+  QVector<int> vecMissingTables;
+  const bool bRotate = d->dMaxAngle != 0 && !matImage.isEmpty();
+  for (int i=0; i<iVariants; ++i)
+    {
+      Variant& variant = vecVariants[i];
+      variant.iAngle = bRotate ? d->generator.integer(0, d->iAngleSteps - 1) : -1;
+      if (variant.iAngle >= 0 && angleAt(variant.iAngle) == 0)
+        variant.iAngle = -1;
+      if (variant.iAngle >= 0 &&
+          d->vecRotationTables[variant.iAngle].isEmpty() &&
+          !vecMissingTables.contains(variant.iAngle))
+        vecMissingTables << variant.iAngle;
+      variant.iNoiseSeed = d->generator.next();
+    }
+
+  const PiiParallelPolicy policy(d->iWorkerCount, 1);
+  if (!vecMissingTables.isEmpty())
+    {
+      TableStrip tables(this, vecMissingTables, d->vecRotationTables.data(),
+                        matImage.rows(), matImage.columns(), d->transformedSize);
+      Pii::forEachStrip(vecMissingTables.size(), tables, policy);
+    }
+
+  for (int i=0; i<iVariants; ++i)
+    {
+      Variant& variant = vecVariants[i];
+      int iRows = matImage.rows(), iColumns = matImage.columns();
+      if (variant.iAngle >= 0)
+        {
+          iRows = d->vecRotationTables[variant.iAngle].rows();
+          iColumns = d->vecRotationTables[variant.iAngle].columns();
+        }
+      variant.iWidth = d->iCropWidth > 0 && d->iCropWidth < iColumns ? d->iCropWidth : iColumns;
+      variant.iHeight = d->iCropHeight > 0 && d->iCropHeight < iRows ? d->iCropHeight : iRows;
+      variant.iX = d->generator.integer(0, iColumns - variant.iWidth);
+      variant.iY = d->generator.integer(0, iRows - variant.iHeight);
+    }
+
+  QVector<PiiMatrix<T> > vecResults(iVariants);
+  VariantStrip<T> variants(matImage, vecVariants.constData(), d->vecRotationTables.constData(),
+                           float(d->dNoiseLevel * PiiImage::Traits<T>::max()), vecResults.data());
+  Pii::forEachStrip(iVariants, variants, policy);
+
+  PiiVariant label;
+  if (inputAt(1)->isConnected())
+    label = inputAt(1)->firstObject();
+
+  outputAt(0)->startMany();
+  outputAt(1)->startMany();
+  for (int i=0; i<iVariants; ++i)
+    {
+      outputAt(0)->emitObject(vecResults[i]);
+      outputAt(1)->emitObject(label.isValid() ? label : PiiVariant(i));
+    }
+  outputAt(0)->endMany();
+  outputAt(1)->endMany();
+}
+
+double PiiImageAugmenter::angleAt(int index) const
+{
+  const PII_D;
+  if (d->iAngleSteps < 2)
+    return 0;
+  return d->dMaxAngle * (2.0 * index / (d->iAngleSteps - 1) - 1.0);
+}
+
+void PiiImageAugmenter::clearTables()
+{
+  PII_D;
+  d->vecRotationTables.clear();
+  d->iTableRows = d->iTableColumns = 0;
+}
+
+void PiiImageAugmenter::setVariantCount(int variantCount) { _d()->iVariantCount = variantCount; }
+int PiiImageAugmenter::variantCount() const { return _d()->iVariantCount; }
+void PiiImageAugmenter::setMaxAngle(double maxAngle)
+{
+  _d()->dMaxAngle = maxAngle;
+  clearTables();
+}
+double PiiImageAugmenter::maxAngle() const { return _d()->dMaxAngle; }
+void PiiImageAugmenter::setMaxAngleDeg(double maxAngleDeg) { setMaxAngle(maxAngleDeg / 180.0 * M_PI); }
+double PiiImageAugmenter::maxAngleDeg() const { return _d()->dMaxAngle / M_PI * 180.0; }
+void PiiImageAugmenter::setAngleSteps(int angleSteps)
+{
+  _d()->iAngleSteps = angleSteps;
+  clearTables();
+}
+int PiiImageAugmenter::angleSteps() const { return _d()->iAngleSteps; }
+void PiiImageAugmenter::setTransformedSize(PiiImage::TransformedSize transformedSize)
+{
+  _d()->transformedSize = transformedSize;
+  clearTables();
+}
+PiiImage::TransformedSize PiiImageAugmenter::transformedSize() const { return _d()->transformedSize; }
+void PiiImageAugmenter::setCropWidth(int cropWidth) { _d()->iCropWidth = cropWidth; }
+int PiiImageAugmenter::cropWidth() const { return _d()->iCropWidth; }
+void PiiImageAugmenter::setCropHeight(int cropHeight) { _d()->iCropHeight = cropHeight; }
+int PiiImageAugmenter::cropHeight() const { return _d()->iCropHeight; }
+void PiiImageAugmenter::setNoiseLevel(double noiseLevel) { _d()->dNoiseLevel = noiseLevel; }
+double PiiImageAugmenter::noiseLevel() const { return _d()->dNoiseLevel; }
+void PiiImageAugmenter::setRandomSeed(int randomSeed) { _d()->iRandomSeed = randomSeed; }
+int PiiImageAugmenter::randomSeed() const { return _d()->iRandomSeed; }
+void PiiImageAugmenter::setWorkerCount(int workerCount) { _d()->iWorkerCount = workerCount; }
+int PiiImageAugmenter::workerCount() const { return _d()->iWorkerCount; }
@@ -0,0 +1,199 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEAUGMENTER_H
+#define _PIIIMAGEAUGMENTER_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiRandomGenerator.h>
+#include "PiiImageGlobal.h"
+#include "PiiRemapTable.h"
+
+/**
+ * Generates randomly distorted variants of images for training
+ * classifiers. Each incoming image is rotated, cropped and corrupted
+ * with additive Gaussian noise [variantCount] times, each time with
+ * different random parameters. The variants of an image are created
+ * concurrently, and they are emitted in a burst once all of them are
+ * ready. A classifier operation downstream (through a feature
+ * extractor) collects the whole burst into its sample set.
+ *
+ * Rotation angles are chosen from [angleSteps] evenly spaced angles
+ * in [-[maxAngle], [maxAngle]]. The mapping of each angle is stored
+ * in a PiiRemapTable, which is reused as long as the size of the
+ * input images doesn't change. Crops are not copied but refer to the
+ * rotated image. Noise is generated for a whole variant at once with
+ * PiiRandomGenerator.
+ *
+ * The random parameters of the variants are drawn in the processing
+ * thread, and each variant gets its own noise generator. Therefore,
+ * the output only depends on [randomSeed] and the order of the input
+ * images, not on the number of threads.
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - the input image. Any gray-level or color image.
+ *
+ * @in label - an optional label that will be repeated for each
+ * variant. Any type.
+ *
+ * Outputs
+ * -------
+ *
+ * @out image - distorted variants of the input image. [variantCount]
+ * objects for each input image.
+ *
+ * @out label - the label of each variant. If the `label` input is
+ * not connected, the index of the variant (int) will be emitted
+ * instead.
+ */
+class PiiImageAugmenter : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of variants generated for each input image. The
+   * default is 16.
+   */
+  Q_PROPERTY(int variantCount READ variantCount WRITE setVariantCount);
+
+  /**
+   * The maximum rotation angle in radians. Variants are rotated by up
+   * to this angle clockwise or counter-clockwise. The default is 0,
+   * which disables rotation.
+   */
+  Q_PROPERTY(double maxAngle READ maxAngle WRITE setMaxAngle);
+
+  /**
+   * The maximum rotation angle in degrees.
+   */
+  Q_PROPERTY(double maxAngleDeg READ maxAngleDeg WRITE setMaxAngleDeg STORED false);
+
+  /**
+   * The number of distinct rotation angles. One remap table is built
+   * for each angle. The default is 9.
+   */
+  Q_PROPERTY(int angleSteps READ angleSteps WRITE setAngleSteps);
+
+  /**
+   * How to handle the size of rotated images. The default is
+   * `RetainOriginalSize`.
+   */
+  Q_PROPERTY(PiiImage::TransformedSize transformedSize READ transformedSize WRITE setTransformedSize);
+
+  /**
+   * The width of a randomly placed crop in pixels. Zero or a value
+   * larger than the width of the rotated image disables horizontal
+   * cropping. The default is 0.
+   */
+  Q_PROPERTY(int cropWidth READ cropWidth WRITE setCropWidth);
+
+  /**
+   * The height of a randomly placed crop in pixels. The default is 0.
+   */
+  Q_PROPERTY(int cropHeight READ cropHeight WRITE setCropHeight);
+
+  /**
+   * The standard deviation of additive noise, relative to the maximum
+   * value of a color channel (see PiiImage::Traits). The default is
+   * 0, which disables noise.
+   */
+  Q_PROPERTY(double noiseLevel READ noiseLevel WRITE setNoiseLevel);
+
+  /**
+   * The seed of the random number generator. The generator is reset
+   * whenever the operation is reset. The default is 0.
+   */
+  Q_PROPERTY(int randomSeed READ randomSeed WRITE setRandomSeed);
+
+  /**
+   * The maximum number of threads used for generating the variants
+   * of one image. Zero means the number of processor cores. The
+   * default is 0.
+   */
+  Q_PROPERTY(int workerCount READ workerCount WRITE setWorkerCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiImageAugmenter();
+
+  void check(bool reset);
+
+  void setVariantCount(int variantCount);
+  int variantCount() const;
+  void setMaxAngle(double maxAngle);
+  double maxAngle() const;
+  void setMaxAngleDeg(double maxAngleDeg);
+  double maxAngleDeg() const;
+  void setAngleSteps(int angleSteps);
+  int angleSteps() const;
+  void setTransformedSize(PiiImage::TransformedSize transformedSize);
+  PiiImage::TransformedSize transformedSize() const;
+  void setCropWidth(int cropWidth);
+  int cropWidth() const;
+  void setCropHeight(int cropHeight);
+  int cropHeight() const;
+  void setNoiseLevel(double noiseLevel);
+  double noiseLevel() const;
+  void setRandomSeed(int randomSeed);
+  int randomSeed() const;
+  void setWorkerCount(int workerCount);
+  int workerCount() const;
+
+protected:
+  void process();
+
+private:
+  // Random parameters of one variant
+  struct Variant
+  {
+    int iAngle;
+    int iX, iY, iWidth, iHeight;
+    quint64 iNoiseSeed;
+  };
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    int iVariantCount;
+    double dMaxAngle;
+    int iAngleSteps;
+    PiiImage::TransformedSize transformedSize;
+    int iCropWidth, iCropHeight;
+    double dNoiseLevel;
+    int iRandomSeed;
+    int iWorkerCount;
+    PiiRandomGenerator generator;
+    // One table for each angle, built on demand. Cleared if the size
+    // of the input changes.
+    QVector<PiiRemapTable> vecRotationTables;
+    int iTableRows, iTableColumns;
+  };
+  PII_D_FUNC;
+
+  template <class T> void augment(const PiiVariant& obj);
+  double angleAt(int index) const;
+  void clearTables();
+
+  struct TableStrip;
+  template <class T> struct VariantStrip;
+  template <class T> struct Noise;
+};
+
+
+#endif //_PIIIMAGEAUGMENTER_H
@@ -0,0 +1,76 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImageDecoder.h"
+#include <PiiYdinTypes.h>
+#include <PiiQImage.h>
+#include <QImage>
+
+PiiImageDecoder::Data::Data() :
+  imageType(Original)
+{
+}
+
+PiiImageDecoder::PiiImageDecoder() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  addSocket(new PiiInputSocket("data"));
+  addSocket(new PiiOutputSocket("image"));
+}
+
+void PiiImageDecoder::process()
+{
+  PII_D;
+  PiiVariant obj = readInput();
+  if (obj.type() != PiiYdin::UnsignedCharMatrixType)
+    PII_THROW_UNKNOWN_TYPE(inputAt(0));
+
+  const PiiMatrix<unsigned char> matData(obj.valueAs<PiiMatrix<unsigned char> >());
+  QByteArray aFormat(d->strFormat.toLatin1());
+  QImage image;
+  bool bDecoded;
+  if (matData.rows() == 1)
+    bDecoded = image.loadFromData(matData.row(0), matData.columns(),
+                                  aFormat.isEmpty() ? 0 : aFormat.constData());
+  else
+    {
+      QByteArray aData;
+      aData.reserve(matData.rows() * matData.columns());
+      for (int r=0; r<matData.rows(); ++r)
+        aData.append(reinterpret_cast<const char*>(matData.row(r)), matData.columns());
+      bDecoded = image.loadFromData(aData, aFormat.isEmpty() ? 0 : aFormat.constData());
+    }
+
+  if (!bDecoded || image.isNull())
+    PII_THROW(PiiExecutionException, tr("Could not decode image."));
+
+  if (d->imageType == GrayScale ||
+      (d->imageType == Original && image.depth() != 32))
+    {
+      Pii::convertToGray(image);
+      emitObject(PiiGrayQImage::create(image)->toMatrix());
+    }
+  else
+    {
+      Pii::convertToRgba(image);
+      emitObject(PiiColorQImage::create(image)->toMatrix());
+    }
+}
+
+void PiiImageDecoder::setFormat(const QString& format) { _d()->strFormat = format; }
+QString PiiImageDecoder::format() const { return _d()->strFormat; }
+void PiiImageDecoder::setImageType(ImageType imageType) { _d()->imageType = imageType; }
+PiiImageDecoder::ImageType PiiImageDecoder::imageType() const { return _d()->imageType; }
@@ -0,0 +1,96 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEDECODER_H
+#define _PIIIMAGEDECODER_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiImageGlobal.h"
+
+/**
+ * Decodes compressed images received as byte arrays. The operation
+ * accepts any format supported by QImageReader, such as JPEG and
+ * PNG. It is typically placed after a camera source that passes
+ * compressed (e.g. MJPEG) frames through as such. If [threadCount]
+ * is larger than one, many frames will be decoded in parallel, but
+ * the output order is not guaranteed to match the input order.
+ *
+ * Inputs
+ * ------
+ *
+ * @in data - compressed image data as a `PiiMatrix<unsigned char>`.
+ * A single row containing the whole file is the usual form. If the
+ * matrix has many rows, they will be concatenated.
+ *
+ * Outputs
+ * -------
+ *
+ * @out image - the decoded image. Either a four-channel color image
+ * or a gray-level image in 8-bit (unsigned char) channel format,
+ * depending on [imageType].
+ */
+class PiiImageDecoder : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the image format, e.g. "jpeg". If the format is
+   * empty (the default), it will be guessed from the data.
+   */
+  Q_PROPERTY(QString format READ format WRITE setFormat);
+
+  /**
+   * The type of the decoded images. The default is `Original`.
+   */
+  Q_PROPERTY(ImageType imageType READ imageType WRITE setImageType);
+  Q_ENUMS(ImageType);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  /**
+   * Output image types.
+   *
+   * - `GrayScale` - 8-bit gray-level images (unsigned char).
+   *
+   * - `Color` - 32-bit color images (PiiColor4<unsigned char>).
+   *
+   * - `Original` - gray-level or color, depending on the type of the
+   * encoded image.
+   */
+  enum ImageType { GrayScale, Color, Original };
+
+  PiiImageDecoder();
+
+  void setFormat(const QString& format);
+  QString format() const;
+  void setImageType(ImageType imageType);
+  ImageType imageType() const;
+
+protected:
+  void process();
+
+private:
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    QString strFormat;
+    ImageType imageType;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIIMAGEDECODER_H
@@ -16,12 +16,16 @@
 #include "PiiImageFileReader.h"
 #include <PiiYdinTypes.h>
 #include <PiiRandom.h>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
 #include <QDir>
 #include <QFileInfo>
 #include <QtGui>
 
 #ifndef Q_OS_WIN
 #  include <sys/file.h>
+#  include <fcntl.h>
+#  include <unistd.h>
 #  include <QFile>
 #endif
 
@@ -32,8 +36,13 @@ PiiImageFileReader::Data::Data() :
   iRepeatCount(1), bFirst(false), bLockFiles(false),
   bTriggered(false), bNameConnected(false),
   randMode(NoRandomization),
-  bSendKeys(false)
+  bSendKeys(false),
+  iReadAheadCount(0),
+  iReaderThreads(2),
+  bFileHints(false),
+  bReadersRunning(false)
 {
+  imageCache.setMaxCost(0);
 }
 
 PiiImageFileReader::PiiImageFileReader(const QString& pattern) :
@@ -53,6 +62,13 @@ PiiImageFileReader::PiiImageFileReader(const QString& pattern) :
   d->iStaticOutputCount = outputCount();
 
   setProtectionLevel("metaFields", WriteWhenStoppedOrPaused);
+  setProtectionLevel("readAheadCount", WriteWhenStoppedOrPaused);
+  setProtectionLevel("readerThreads", WriteWhenStoppedOrPaused);
+}
+
+PiiImageFileReader::~PiiImageFileReader()
+{
+  stopReaders();
 }
 
 void PiiImageFileReader::check(bool reset)
@@ -81,6 +97,272 @@ void PiiImageFileReader::check(bool reset)
       }
 
   d->bTriggered = d->pTriggerInput->isConnected() || d->bNameConnected;
+
+  stopReaders();
+  if (reset || d->bTriggered)
+    clearSlots();
+  if (!d->bTriggered && d->iReadAheadCount > 0)
+    startReaders();
+}
+
+void PiiImageFileReader::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    {
+      stopReaders();
+      clearSlots();
+    }
+  PiiImageReaderOperation::aboutToChangeState(state);
+}
+
+void PiiImageFileReader::startReaders()
+{
+  PII_D;
+  if (d->iReaderThreads <= 0)
+    return;
+  d->bReadersRunning = true;
+  for (int i=0; i<d->iReaderThreads; ++i)
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiImageFileReader::readAhead);
+      d->lstReaderThreads << pThread;
+      pThread->start();
+    }
+}
+
+void PiiImageFileReader::stopReaders()
+{
+  PII_D;
+  synchronized (d->readerMutex)
+    {
+      d->bReadersRunning = false;
+      d->slotAvailable.wakeAll();
+      d->slotDone.wakeAll();
+    }
+  // Images being decoded are finished before the threads exit.
+  for (int i=0; i<d->lstReaderThreads.size(); ++i)
+    {
+      d->lstReaderThreads[i]->wait();
+      delete d->lstReaderThreads[i];
+    }
+  d->lstReaderThreads.clear();
+}
+
+void PiiImageFileReader::clearSlots()
+{
+  PII_D;
+  synchronized (d->readerMutex)
+    d->lstSlots.clear();
+  d->vecNextIndices.clear();
+}
+
+void PiiImageFileReader::readAhead()
+{
+  PII_D;
+  QMutexLocker lock(&d->readerMutex);
+  forever
+    {
+      int iSlot = -1;
+      while (d->bReadersRunning)
+        {
+          for (int i=0; i<d->lstSlots.size(); ++i)
+            if (d->lstSlots[i].state == SlotPending)
+              {
+                iSlot = i;
+                break;
+              }
+          if (iSlot != -1)
+            break;
+          d->slotAvailable.wait(&d->readerMutex);
+        }
+      if (!d->bReadersRunning)
+        break;
+
+      d->lstSlots[iSlot].state = SlotLoading;
+      const int iPosition = d->lstSlots[iSlot].iPosition;
+      const QString strFileName = d->lstSlots[iSlot].strFileName;
+      const ImageType type = d->lstSlots[iSlot].imageType;
+      lock.unlock();
+
+      QImage img;
+      QString strError;
+      try
+        {
+          img = readImage(strFileName);
+          convertImage(img, type);
+        }
+      catch (PiiExecutionException& ex)
+        {
+          strError = ex.message();
+        }
+
+      lock.relock();
+      // The slots may have been cleared and rescheduled meanwhile.
+      for (int i=0; i<d->lstSlots.size(); ++i)
+        {
+          ReadSlot& slot = d->lstSlots[i];
+          if (slot.iPosition == iPosition && slot.state != SlotDone &&
+              slot.strFileName == strFileName)
+            {
+              slot.image = img;
+              slot.strError = strError;
+              slot.state = SlotDone;
+              break;
+            }
+        }
+      d->slotDone.wakeAll();
+    }
+}
+
+QString PiiImageFileReader::scheduledFileName(int position)
+{
+  PII_D;
+  const int iCount = d->lstFileNames.size();
+  if (d->randMode != RandomizeOnEachIteration ||
+      position / iCount == d->iCurrentIndex / iCount)
+    return d->lstFileNames[d->vecIndices[position % iCount]];
+
+  // The read-ahead window never reaches beyond the next iteration.
+  if (d->vecNextIndices.isEmpty())
+    {
+      d->vecNextIndices = d->vecIndices;
+      Pii::shuffle(d->vecNextIndices);
+    }
+  return d->lstFileNames[d->vecNextIndices[position % iCount]];
+}
+
+void PiiImageFileReader::scheduleReads()
+{
+  PII_D;
+  const int iTotalCount = totalImageCount();
+  int iEnd = d->iCurrentIndex + qMin(d->iReadAheadCount, d->lstFileNames.size());
+  if (iTotalCount >= 0 && iEnd > iTotalCount)
+    iEnd = iTotalCount;
+
+  QStringList lstNewNames;
+  synchronized (d->readerMutex)
+    {
+      while (!d->lstSlots.isEmpty() && d->lstSlots.first().iPosition < d->iCurrentIndex)
+        d->lstSlots.removeFirst();
+      int iPosition = d->lstSlots.isEmpty() ? d->iCurrentIndex : d->lstSlots.last().iPosition + 1;
+      for (; iPosition < iEnd; ++iPosition)
+        {
+          QString strFileName(scheduledFileName(iPosition));
+          d->lstSlots << ReadSlot(iPosition, strFileName, d->imageType);
+          lstNewNames << strFileName;
+        }
+      if (!lstNewNames.isEmpty())
+        d->slotAvailable.wakeAll();
+    }
+
+#if !defined(Q_OS_WIN) && defined(POSIX_FADV_WILLNEED)
+  if (d->bFileHints)
+    {
+      for (int i=0; i<lstNewNames.size(); ++i)
+        {
+          int iFd = ::open(QFile::encodeName(lstNewNames[i]).constData(), O_RDONLY);
+          if (iFd != -1)
+            {
+              posix_fadvise(iFd, 0, 0, POSIX_FADV_WILLNEED);
+              ::close(iFd);
+            }
+        }
+    }
+#endif
+}
+
+QImage PiiImageFileReader::takeImage(const QString& fileName)
+{
+  PII_D;
+  QMutexLocker lock(&d->readerMutex);
+  if (d->lstSlots.isEmpty() ||
+      d->lstSlots.first().iPosition != d->iCurrentIndex ||
+      d->lstSlots.first().strFileName != fileName)
+    {
+      // The file list has changed under us. Start over.
+      d->lstSlots.clear();
+      return QImage();
+    }
+
+  while (d->lstSlots.first().state != SlotDone && d->bReadersRunning)
+    d->slotDone.wait(&d->readerMutex);
+  if (d->lstSlots.first().state != SlotDone)
+    return QImage();
+
+  ReadSlot slot(d->lstSlots.takeFirst());
+  lock.unlock();
+  if (!slot.strError.isEmpty())
+    PII_THROW(PiiExecutionException, slot.strError);
+  return slot.image;
+}
+
+QImage PiiImageFileReader::readImage(const QString& fileName)
+{
+  PII_D;
+  synchronized (d->cacheMutex)
+    {
+      if (d->imageCache.maxCost() == 0)
+        break;
+      QImage* pImage = d->imageCache.object(fileName);
+      if (pImage != 0)
+        return *pImage;
+    }
+
+  QImage img(loadImage(fileName, d->bLockFiles));
+
+  synchronized (d->cacheMutex)
+    {
+      if (d->imageCache.maxCost() > 0)
+        d->imageCache.insert(fileName, new QImage(img),
+                             qMax(1, img.bytesPerLine() * img.height() / 1024));
+    }
+  return img;
+}
+
+void PiiImageFileReader::convertImage(QImage& img, ImageType type)
+{
+  // Conversion creates a new image. Retain meta data for sendKeys().
+  QImage original(img);
+  if (type == GrayScale || (type == Original && img.depth() != 32))
+    Pii::convertToGray(img);
+  else
+    Pii::convertToRgba(img);
+  if (img.cacheKey() != original.cacheKey())
+    {
+      QStringList lstKeys = original.textKeys();
+      for (int i=0; i<lstKeys.size(); ++i)
+        img.setText(lstKeys[i], original.text(lstKeys[i]));
+    }
+}
+
+QImage PiiImageFileReader::loadImage(const QString& fileName, bool lock)
+{
+  QImage img;
+#ifdef Q_OS_WIN // no locking on windows
+  Q_UNUSED(lock);
+  if (!img.load(fileName))
+    PII_THROW(PiiExecutionException, tr("Cannot read image \"%1\".").arg(fileName));
+#else
+  // Must manually open the file to obtain its handle
+  // See PiiImageFileReader.h for a detailed description.
+  QFile f(fileName);
+  if (!f.open(QIODevice::ReadOnly))
+    {
+      f.close();
+      PII_THROW(PiiExecutionException, tr("Cannot open %1.").arg(fileName));
+    }
+  if (lock && flock(f.handle(), LOCK_SH) == -1)
+    {
+      f.close();
+      PII_THROW(PiiExecutionException, tr("Cannot lock %1.").arg(fileName));
+    }
+  if (!img.load(&f, qPrintable(QFileInfo(fileName).suffix())))
+    {
+      f.close();
+      PII_THROW(PiiExecutionException, tr("Cannot decode %1.").arg(fileName));
+    }
+  f.close();
+#endif
+  return img;
 }
 
 void PiiImageFileReader::process()
@@ -89,9 +371,19 @@ void PiiImageFileReader::process()
   if (!d->bNameConnected &&
       d->randMode == RandomizeOnEachIteration &&
       d->iCurrentIndex % d->lstFileNames.size() == 0)
-    Pii::shuffle(d->vecIndices);
+    {
+      // Read-ahead may have already decided the order.
+      if (d->vecNextIndices.isEmpty())
+        Pii::shuffle(d->vecIndices);
+      else
+        {
+          d->vecIndices = d->vecNextIndices;
+          d->vecNextIndices.clear();
+        }
+    }
 
   QString fileName;
+  QImage img;
   //We only track the counts if neither trigger input isn't connected
   if (!d->bTriggered)
     {
@@ -100,6 +392,11 @@ void PiiImageFileReader::process()
           (d->iRepeatCount > 0 && loopIndex >= d->iRepeatCount))
         operationStopped(); //stop here
       fileName = d->lstFileNames[d->vecIndices[d->iCurrentIndex % d->lstFileNames.size()]];
+      if (!d->lstReaderThreads.isEmpty())
+        {
+          scheduleReads();
+          img = takeImage(fileName);
+        }
     }
   else if (d->bNameConnected) // name input is connected -> we don't care about trigger
     {
@@ -125,31 +422,8 @@ void PiiImageFileReader::process()
 
   //qDebug("PiiImageFileReader: Emitting image %d/%d", d->iCurrentIndex+1, d->lstFileNames.size());
 
-  QImage img;
-#ifdef Q_OS_WIN // no locking on windows
-  if (!img.load(fileName))
-    PII_THROW(PiiExecutionException, tr("Cannot read image \"%1\".").arg(fileName));
-#else
-  // Must manually open the file to obtain its handle
-  // See PiiImageFileReader.h for a detailed description.
-  QFile f(fileName);
-  if (!f.open(QIODevice::ReadOnly))
-    {
-      f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot open %1.").arg(fileName));
-    }
-  if (d->bLockFiles && flock(f.handle(), LOCK_SH) == -1)
-    {
-      f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot lock %1.").arg(fileName));
-    }
-  if (!img.load(&f, qPrintable(QFileInfo(fileName).suffix())))
-    {
-      f.close();
-      PII_THROW(PiiExecutionException, tr("Cannot decode %1.").arg(fileName));
-    }
-  f.close();
-#endif
+  if (img.isNull())
+    img = readImage(fileName);
 
   if (d->bSendKeys)
     sendKeys(img);
@@ -214,6 +488,7 @@ void PiiImageFileReader::createIndices()
       d->vecIndices.clear();
       d->vecIndices.reserve(d->lstFileNames.size());
     }
+  d->vecNextIndices.clear();
   for (int i=0; i<d->lstFileNames.size(); i++)
     d->vecIndices << i;
   if (d->randMode != NoRandomization)
@@ -273,6 +548,19 @@ void PiiImageFileReader::setFileNames(const QStringList& fileNames)
 QString PiiImageFileReader::fileNamePattern() const { return _d()->strPattern; }
 int PiiImageFileReader::repeatCount() const { return _d()->iRepeatCount; }
 void PiiImageFileReader::setRepeatCount(int cnt) { _d()->iRepeatCount = cnt; }
+void PiiImageFileReader::setReadAheadCount(int readAheadCount) { _d()->iReadAheadCount = readAheadCount; }
+int PiiImageFileReader::readAheadCount() const { return _d()->iReadAheadCount; }
+void PiiImageFileReader::setReaderThreads(int readerThreads) { _d()->iReaderThreads = readerThreads; }
+int PiiImageFileReader::readerThreads() const { return _d()->iReaderThreads; }
+void PiiImageFileReader::setCacheSize(int cacheSize)
+{
+  PII_D;
+  synchronized (d->cacheMutex)
+    d->imageCache.setMaxCost(qMax(0, cacheSize) * 1024);
+}
+int PiiImageFileReader::cacheSize() const { return _d()->imageCache.maxCost() / 1024; }
+void PiiImageFileReader::setFileHints(bool fileHints) { _d()->bFileHints = fileHints; }
+bool PiiImageFileReader::fileHints() const { return _d()->bFileHints; }
 void PiiImageFileReader::setLockFiles(bool lockFiles) { _d()->bLockFiles = lockFiles; }
 bool PiiImageFileReader::lockFiles() const { return _d()->bLockFiles; }
 void PiiImageFileReader::setRandomizationMode(RandomizationMode mode)
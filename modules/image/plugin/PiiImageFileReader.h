@@ -20,6 +20,11 @@
 #include <PiiColor.h>
 #include <QStringList>
 #include <QVector>
+#include <QList>
+#include <QCache>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include "PiiImageReaderOperation.h"
 
 /**
@@ -133,6 +138,47 @@ class PII_IMAGE_EXPORT PiiImageFileReader : public PiiImageReaderOperation
    */
   Q_PROPERTY(QVariantList metaFields READ metaFields WRITE setMetaFields);
 
+  /**
+   * The number of images decoded in advance. If this value is larger
+   * than zero and the operation is not triggered, the next
+   * `readAheadCount` images in emission order are read and decoded
+   * by [readerThreads] background threads while earlier images are
+   * being processed. The images are still emitted in order, and
+   * [randomizationMode], [repeatCount] and
+   * [PiiImageReaderOperation::maxImages] "maxImages" work as
+   * without read-ahead. If the trigger or filename input is
+   * connected, the next image is not known beforehand, and images
+   * are read synchronously. The default value is 0, which disables
+   * read-ahead.
+   */
+  Q_PROPERTY(int readAheadCount READ readAheadCount WRITE setReadAheadCount);
+
+  /**
+   * The number of background threads that decode images if
+   * [readAheadCount] is larger than zero. The default value is 2.
+   */
+  Q_PROPERTY(int readerThreads READ readerThreads WRITE setReaderThreads);
+
+  /**
+   * The maximum amount of decoded image data kept in memory, in
+   * megabytes. If this value is larger than zero, decoded images are
+   * cached, and an image that is read again (e.g. if [repeatCount]
+   * is larger than one) will not be decoded again. The least
+   * recently used images are discarded first. Note that the cache
+   * makes it impossible to see changes in image files during
+   * execution. The default value is 0, which disables the cache.
+   */
+  Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize);
+
+  /**
+   * If this flag is `true`, the operating system is told in advance
+   * which files are going to be read so that it can start fetching
+   * them from disk before the reader threads get to them. This works
+   * only with read-ahead enabled, and only on systems that support
+   * `posix_fadvise()`. The default value is `false`.
+   */
+  Q_PROPERTY(bool fileHints READ fileHints WRITE setFileHints);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
@@ -154,6 +200,7 @@ public:
    * given file name wildcard pattern (glob).
    */
   PiiImageFileReader(const QString& pattern = "");
+  ~PiiImageFileReader();
 
   /**
    * Read an image from the file denoted by `fileName`. The image is
@@ -176,6 +223,7 @@ public:
   void check(bool reset);
 protected:
   void process();
+  void aboutToChangeState(State state);
 
   QStringList fileNames() const;
   void setFileNames(const QStringList& fileNames);
@@ -197,9 +245,44 @@ protected:
   void setMetaFields(const QVariantList& metaFields);
   QVariantList metaFields() const;
 
+  void setReadAheadCount(int readAheadCount);
+  int readAheadCount() const;
+  void setReaderThreads(int readerThreads);
+  int readerThreads() const;
+  void setCacheSize(int cacheSize);
+  int cacheSize() const;
+  void setFileHints(bool fileHints);
+  bool fileHints() const;
+
 private:
+  enum SlotState { SlotPending, SlotLoading, SlotDone };
+
+  struct ReadSlot
+  {
+    ReadSlot(int position = 0, const QString& fileName = QString(), ImageType type = Original) :
+      iPosition(position), strFileName(fileName), imageType(type), state(SlotPending)
+    {}
+    int iPosition;
+    QString strFileName;
+    ImageType imageType;
+    SlotState state;
+    QImage image;
+    QString strError;
+  };
+
   void createIndices();
   void sendKeys(const QImage& img);
+  QString scheduledFileName(int position);
+  void scheduleReads();
+  QImage takeImage(const QString& fileName);
+  QImage readImage(const QString& fileName);
+  void readAhead();
+  void startReaders();
+  void stopReaders();
+  void clearSlots();
+
+  static QImage loadImage(const QString& fileName, bool lock);
+  static void convertImage(QImage& img, ImageType type);
 
   /// @internal
   class Data : public PiiImageReaderOperation::Data
@@ -220,6 +303,22 @@ private:
     PiiOutputSocket *pNameOutput, *pKeyOutput, *pValueOutput;
     QList<QPair<QString,PiiVariant> > lstMetaFields;
     bool bSendKeys;
+
+    int iReadAheadCount;
+    int iReaderThreads;
+    bool bFileHints;
+    // The order of the next iteration with RandomizeOnEachIteration,
+    // shuffled as soon as read-ahead gets there.
+    QVector<int> vecNextIndices;
+    QList<ReadSlot> lstSlots;
+    int iNextPosition;
+    QList<QThread*> lstReaderThreads;
+    bool bReadersRunning;
+    QMutex readerMutex;
+    QWaitCondition slotAvailable, slotDone;
+
+    QCache<QString,QImage> imageCache;
+    QMutex cacheMutex;
   };
   PII_D_FUNC;
 };
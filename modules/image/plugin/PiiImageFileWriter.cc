@@ -16,6 +16,8 @@
 #include "PiiImageFileWriter.h"
 #include <PiiYdinTypes.h>
 #include <PiiColor.h>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
 #include "PiiImage.h"
 #include <QFileInfo>
 #include <QDir>
@@ -36,7 +38,14 @@ PiiImageFileWriter::Data::Data() :
   nameObject(0),
   bStoreAlpha(false),
   bChangeExtension(false),
-  bOverwrite(true)
+  bOverwrite(true),
+  iWriterThreads(0),
+  iMaxBacklog(16),
+  iSyncInterval(0),
+  backlogPolicy(DropNewest),
+  iActiveJobs(0),
+  iDroppedCount(0),
+  bWritersRunning(false)
 {
 }
 
@@ -67,6 +76,13 @@ PiiImageFileWriter::PiiImageFileWriter() :
 
   d->iStaticInputCount = inputCount();
   setProtectionLevel("metaFields", WriteWhenStoppedOrPaused);
+  setProtectionLevel("writerThreads", WriteWhenStoppedOrPaused);
+}
+
+PiiImageFileWriter::~PiiImageFileWriter()
+{
+  stopWriters();
+  syncFiles(&_d()->lstUnsyncedHandles);
 }
 
 void PiiImageFileWriter::check(bool reset)
@@ -77,6 +93,7 @@ void PiiImageFileWriter::check(bool reset)
     {
       d->iNextIndex = 0;
       clearKeyValues();
+      d->iDroppedCount = 0;
     }
 
   if (d->pKeyInput->isConnected() != d->pValueInput->isConnected())
@@ -84,6 +101,110 @@ void PiiImageFileWriter::check(bool reset)
 
   d->bKeyValuesConnected = d->pKeyInput->isConnected();
   d->bNameInputConnected = d->pNameInput->isConnected();
+
+  // Restart the writers in case their number has changed. This
+  // drains the backlog.
+  stopWriters();
+  startWriters();
+}
+
+void PiiImageFileWriter::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    {
+      stopWriters();
+      syncFiles(&_d()->lstUnsyncedHandles);
+    }
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiImageFileWriter::startWriters()
+{
+  PII_D;
+  if (d->iWriterThreads <= 0)
+    return;
+  d->bWritersRunning = true;
+  for (int i=0; i<d->iWriterThreads; ++i)
+    {
+      QThread* pThread = Pii::createAsyncCall(this, &PiiImageFileWriter::writeBacklog);
+      d->lstWriterThreads << pThread;
+      pThread->start();
+    }
+}
+
+void PiiImageFileWriter::stopWriters()
+{
+  PII_D;
+  synchronized (d->writerMutex)
+    {
+      d->bWritersRunning = false;
+      d->jobAvailable.wakeAll();
+    }
+  // The writers exit once the backlog is empty.
+  for (int i=0; i<d->lstWriterThreads.size(); ++i)
+    {
+      d->lstWriterThreads[i]->wait();
+      delete d->lstWriterThreads[i];
+    }
+  d->lstWriterThreads.clear();
+}
+
+void PiiImageFileWriter::writeBacklog()
+{
+  PII_D;
+  QList<int> lstUnsyncedHandles;
+  QMutexLocker lock(&d->writerMutex);
+  forever
+    {
+      while (d->lstJobs.isEmpty() && d->bWritersRunning)
+        d->jobAvailable.wait(&d->writerMutex);
+      if (d->lstJobs.isEmpty())
+        break;
+
+      WriteJob job(d->lstJobs.takeFirst());
+      ++d->iActiveJobs;
+      d->jobFinished.wakeAll();
+      lock.unlock();
+      if (!writeJob(job, &lstUnsyncedHandles))
+        piiWarning(tr("Could not write %1.").arg(job.strFileName));
+      lock.relock();
+      --d->iActiveJobs;
+    }
+  lock.unlock();
+  syncFiles(&lstUnsyncedHandles);
+}
+
+void PiiImageFileWriter::enqueueJob(const WriteJob& job)
+{
+  PII_D;
+  QMutexLocker lock(&d->writerMutex);
+  // A waiting image with the same name would be overwritten anyway.
+  for (int i=0; i<d->lstJobs.size(); ++i)
+    if (d->lstJobs[i].strFileName == job.strFileName)
+      {
+        d->lstJobs[i] = job;
+        ++d->iDroppedCount;
+        return;
+      }
+
+  while (d->lstJobs.size() >= d->iMaxBacklog)
+    {
+      switch (d->backlogPolicy)
+        {
+        case DropNewest:
+          ++d->iDroppedCount;
+          return;
+        case DropOldest:
+          d->lstJobs.removeFirst();
+          ++d->iDroppedCount;
+          break;
+        case BlockWhenFull:
+          d->jobFinished.wait(&d->writerMutex);
+          break;
+        }
+    }
+  d->lstJobs.append(job);
+  d->jobAvailable.wakeOne();
 }
 
 void PiiImageFileWriter::clearKeyValues()
@@ -191,47 +312,89 @@ void PiiImageFileWriter::processImage()
         }
     }
 
-  switch (d->imageObject.type())
+  if (!isImageType(d->imageObject.type()))
+    PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+
+  WriteJob job;
+  job.image = d->imageObject;
+  job.strFileName = strFileName;
+  job.strFormat = QFileInfo(strFileName).suffix();
+  if (job.strFormat.isEmpty())
+    job.strFormat = d->strExtension;
+  job.lstTexts = collectTexts();
+  job.iDotsPerMeterX = static_cast<int>(1000.0 / d->pixelSize.width());
+  job.iDotsPerMeterY = static_cast<int>(1000.0 / d->pixelSize.height());
+  job.iCompression = d->iCompression;
+  job.bLock = d->bLockFiles;
+  job.bOverwrite = d->bOverwrite;
+  job.bStoreAlpha = d->bStoreAlpha;
+
+  if (d->lstWriterThreads.isEmpty())
+    writeJob(job, &d->lstUnsyncedHandles);
+  else
+    enqueueJob(job);
+
+  d->iNextIndex++;
+  d->imageObject = PiiVariant();
+  d->nameObject = PiiVariant();
+}
+
+bool PiiImageFileWriter::isImageType(unsigned int type)
+{
+  using namespace PiiYdin;
+  switch (type)
+    {
+    case UnsignedCharMatrixType:
+    case IntMatrixType:
+    case FloatMatrixType:
+    case UnsignedCharColorMatrixType:
+    case UnsignedCharColor4MatrixType:
+      return true;
+    default:
+      return false;
+    }
+}
+
+QImage* PiiImageFileWriter::createImage(const PiiVariant& obj, bool storeAlpha)
+{
+  using namespace PiiYdin;
+  QImage* pImage = 0;
+  switch (obj.type())
     {
-      PII_GRAY_IMAGE_CASES_M(writeGrayImage, (d->imageObject, strFileName));
+      PII_GRAY_IMAGE_CASES(pImage = createGrayImage, obj);
     case UnsignedCharColorMatrixType:
-      writeColorImage<PiiColor<unsigned char> >(d->imageObject, strFileName);
+      pImage = createColorImage<PiiColor<unsigned char> >(obj, storeAlpha);
       break;
     case UnsignedCharColor4MatrixType:
-      writeColorImage<PiiColor4<unsigned char> >(d->imageObject, strFileName);
+      pImage = createColorImage<PiiColor4<unsigned char> >(obj, storeAlpha);
       break;
     default:
-      PII_THROW_UNKNOWN_TYPE(d->pImageInput);
+      break;
     }
-
-  d->iNextIndex++;
-  d->imageObject = PiiVariant();
-  d->nameObject = PiiVariant();
+  return pImage;
 }
 
-template <class T> void PiiImageFileWriter::writeGrayImage(const PiiVariant& obj, const QString& fileName)
+template <class T> QImage* PiiImageFileWriter::createGrayImage(const PiiVariant& obj)
 {
-  writeImage(Pii::createQImage(PiiImage::to8Bit(obj.valueAs<PiiMatrix<T> >())), fileName, _d()->bLockFiles);
+  return Pii::createQImage(PiiImage::to8Bit(obj.valueAs<PiiMatrix<T> >()));
 }
 
-template <class T> void PiiImageFileWriter::writeColorImage(const PiiVariant& obj, const QString& fileName)
+template <class T> QImage* PiiImageFileWriter::createColorImage(const PiiVariant& obj, bool storeAlpha)
 {
-  PII_D;
   QImage* pImage = Pii::createQImage(obj.valueAs<PiiMatrix<T> >());
   // If the input image has four channels and storing alpha channel is
   // enabled, change image format.
-  if (sizeof(T) == 4 && d->bStoreAlpha)
+  if (sizeof(T) == 4 && storeAlpha)
     Pii::setQImageFormat(pImage, QImage::Format_ARGB32);
-  writeImage(pImage, fileName, d->bLockFiles);
+  return pImage;
 }
 
-void PiiImageFileWriter::writeKeyValues(QImage* image)
+QList<QPair<QString,QString> > PiiImageFileWriter::collectTexts()
 {
   PII_D;
-  image->setDotsPerMeterX(static_cast<int>(1000.0 / d->pixelSize.width()));
-  image->setDotsPerMeterY(static_cast<int>(1000.0 / d->pixelSize.height()));
+  QList<QPair<QString,QString> > lstTexts;
   for (int i=0; i<d->lstKeys.size(); i++)
-    image->setText(d->lstKeys[i], d->lstValues[i]);
+    lstTexts << qMakePair(d->lstKeys[i], d->lstValues[i]);
   // If the operation was paused while processing many key/value pairs
   // and the number of meta fields was changed, lstStaticMeta may be
   // empty.
@@ -241,45 +404,85 @@ void PiiImageFileWriter::writeKeyValues(QImage* image)
       QString strValue = PiiYdin::convertToQString(d->lstStaticMeta[i]);
       if (strValue.isNull())
         PII_THROW_UNKNOWN_TYPE(inputAt(d->iStaticInputCount + i));
-      image->setText(d->lstMetaFields[i], strValue);
+      lstTexts << qMakePair(d->lstMetaFields[i], strValue);
     }
+  return lstTexts;
 }
 
-// There is no advisory file locking on Windows
-#ifdef Q_OS_WIN
-bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool /*lock*/)
+void PiiImageFileWriter::writeKeyValues(QImage* image)
+{
+  PII_D;
+  image->setDotsPerMeterX(static_cast<int>(1000.0 / d->pixelSize.width()));
+  image->setDotsPerMeterY(static_cast<int>(1000.0 / d->pixelSize.height()));
+  QList<QPair<QString,QString> > lstTexts(collectTexts());
+  for (int i=0; i<lstTexts.size(); ++i)
+    image->setText(lstTexts[i].first, lstTexts[i].second);
+}
+
+bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool lock)
 {
   PII_D;
   // Delete image on return
   PiiSmartPtr<QImage> pImage(image);
-
   writeKeyValues(image);
+
   QString format = QFileInfo(fileName).suffix();
-  if (format.isEmpty()) format = _d()->strExtension;
-  if (d->bOverwrite || !QFileInfo(fileName).exists())
-    return image->save(fileName, qPrintable(format), d->iCompression);
+  if (format.isEmpty()) format = d->strExtension;
+  return saveImage(image, fileName, format, d->iCompression, d->bOverwrite, lock, 0);
+}
+
+bool PiiImageFileWriter::writeJob(const WriteJob& job, QList<int>* unsyncedHandles)
+{
+  PiiSmartPtr<QImage> pImage(createImage(job.image, job.bStoreAlpha));
+  if (pImage == 0)
+    return false;
+  pImage->setDotsPerMeterX(job.iDotsPerMeterX);
+  pImage->setDotsPerMeterY(job.iDotsPerMeterY);
+  for (int i=0; i<job.lstTexts.size(); ++i)
+    pImage->setText(job.lstTexts[i].first, job.lstTexts[i].second);
+
+  const PII_D;
+  int iSyncHandle = -1;
+  bool bSync = d->iSyncInterval > 0;
+  bool bResult = saveImage(pImage, job.strFileName, job.strFormat, job.iCompression,
+                           job.bOverwrite, job.bLock, bSync ? &iSyncHandle : 0);
+  if (iSyncHandle != -1)
+    {
+      unsyncedHandles->append(iSyncHandle);
+      if (unsyncedHandles->size() >= d->iSyncInterval)
+        syncFiles(unsyncedHandles);
+    }
+  return bResult;
+}
+
+// There is no advisory file locking on Windows
+#ifdef Q_OS_WIN
+bool PiiImageFileWriter::saveImage(QImage* image, const QString& fileName, const QString& format,
+                                   int compression, bool overwrite, bool /*lock*/, int* /*syncHandle*/)
+{
+  if (overwrite || !QFileInfo(fileName).exists())
+    return image->save(fileName, qPrintable(format), compression);
   else
     piiWarning(tr("Will not overwrite %1.").arg(fileName));
   return false;
 }
+
+void PiiImageFileWriter::syncFiles(QList<int>* handles)
+{
+  handles->clear();
+}
 // On Unix, we can selectively protect against concurrent usage
 #else
 #include <sys/file.h>
+#include <unistd.h>
 #include <QFile>
 
-bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool lock)
+bool PiiImageFileWriter::saveImage(QImage* image, const QString& fileName, const QString& format,
+                                   int compression, bool overwrite, bool lock, int* syncHandle)
 {
-  PII_D;
-  // Delete image on return
-  PiiSmartPtr<QImage> pImage(image);
-  writeKeyValues(image);
-
-  QString format = QFileInfo(fileName).suffix();
-  if (format.isEmpty()) format = d->strExtension;
-
   // Must manually open the file to obtain its handle
   QFile f(fileName);
-  if (!d->bOverwrite && f.exists())
+  if (!overwrite && f.exists())
     {
       piiWarning(tr("Will not overwrite %1.").arg(fileName));
       return false;
@@ -303,12 +506,35 @@ bool PiiImageFileWriter::writeImage(QImage* image, const QString& fileName, bool
       return false;
     }
   // Save to the locked file
-  bool result = image->save(&f, qPrintable(format), d->iCompression);
+  bool result = image->save(&f, qPrintable(format), compression);
+
+  // Keep a duplicate handle for a later sync. The duplicate shares
+  // the lock, which must thus be released explicitly.
+  if (result && syncHandle != 0 && f.flush())
+    {
+      *syncHandle = ::dup(f.handle());
+      if (lock)
+        flock(f.handle(), LOCK_UN);
+    }
 
   // Close the file (this also unlocks it)
   f.close();
   return result;
 }
+
+void PiiImageFileWriter::syncFiles(QList<int>* handles)
+{
+  for (int i=0; i<handles->size(); ++i)
+    {
+#ifdef Q_OS_LINUX
+      ::fdatasync((*handles)[i]);
+#else
+      ::fsync((*handles)[i]);
+#endif
+      ::close((*handles)[i]);
+    }
+  handles->clear();
+}
 #endif
 
 
@@ -348,3 +574,25 @@ void PiiImageFileWriter::setChangeExtension(bool changeExtension) { _d()->bChang
 bool PiiImageFileWriter::changeExtension() const { return _d()->bChangeExtension; }
 void PiiImageFileWriter::setOverwrite(bool overwrite) { _d()->bOverwrite = overwrite; }
 bool PiiImageFileWriter::overwrite() const { return _d()->bOverwrite; }
+void PiiImageFileWriter::setWriterThreads(int writerThreads) { _d()->iWriterThreads = qBound(0, writerThreads, 64); }
+int PiiImageFileWriter::writerThreads() const { return _d()->iWriterThreads; }
+void PiiImageFileWriter::setMaxBacklog(int maxBacklog) { _d()->iMaxBacklog = qMax(1, maxBacklog); }
+int PiiImageFileWriter::maxBacklog() const { return _d()->iMaxBacklog; }
+void PiiImageFileWriter::setBacklogPolicy(BacklogPolicy backlogPolicy) { _d()->backlogPolicy = backlogPolicy; }
+PiiImageFileWriter::BacklogPolicy PiiImageFileWriter::backlogPolicy() const { return _d()->backlogPolicy; }
+void PiiImageFileWriter::setSyncInterval(int syncInterval) { _d()->iSyncInterval = qMax(0, syncInterval); }
+int PiiImageFileWriter::syncInterval() const { return _d()->iSyncInterval; }
+
+int PiiImageFileWriter::backlog() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->writerMutex);
+  return d->lstJobs.size() + d->iActiveJobs;
+}
+
+int PiiImageFileWriter::droppedCount() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->writerMutex);
+  return d->iDroppedCount;
+}
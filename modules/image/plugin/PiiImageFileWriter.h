@@ -19,6 +19,10 @@
 #include <PiiDefaultOperation.h>
 #include <PiiQImage.h>
 #include <QFileInfo>
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include "PiiImageGlobal.h"
 
 /**
@@ -67,6 +71,18 @@
  * The path is relative unless the `filename` input or the
  * [outputDirectory] property contains an absolute path.
  *
+ * Background writing
+ * ------------------
+ *
+ * By default, images are encoded and written in [process()]. A slow
+ * disk or a high compression level therefore slows down the whole
+ * pipeline. If [writerThreads] is set to a positive value, process()
+ * just collects the image and its meta-data into a bounded backlog
+ * of at most [maxBacklog] images, and a pool of writer threads
+ * encodes and writes them in parallel. If the disk can't keep up,
+ * [backlogPolicy] decides which images to discard. File names are
+ * still assigned in input order, but the files may be completed out
+ * of order. The backlog is drained before the operation stops.
  */
 class PII_IMAGE_EXPORT PiiImageFileWriter : public PiiDefaultOperation
 {
@@ -220,9 +236,69 @@ class PII_IMAGE_EXPORT PiiImageFileWriter : public PiiDefaultOperation
    */
   Q_PROPERTY(bool storeAlpha READ storeAlpha WRITE setStoreAlpha);
 
+  /**
+   * The number of background threads that encode and write images.
+   * Zero (the default) writes each image synchronously in process().
+   * See [above](PiiImageFileWriter) for details.
+   */
+  Q_PROPERTY(int writerThreads READ writerThreads WRITE setWriterThreads);
+
+  /**
+   * The maximum number of images waiting for a writer thread. The
+   * default is 16. Each waiting image holds a reference to the input
+   * matrix, so the memory consumption is bounded by this value.
+   */
+  Q_PROPERTY(int maxBacklog READ maxBacklog WRITE setMaxBacklog);
+
+  /**
+   * What to do when the backlog is full. The default is
+   * `DropNewest`, which never blocks the pipeline. Independent of
+   * the policy, an image whose file name is already in the backlog
+   * replaces the waiting one, because only the last of them would
+   * survive anyway.
+   */
+  Q_PROPERTY(BacklogPolicy backlogPolicy READ backlogPolicy WRITE setBacklogPolicy);
+  Q_ENUMS(BacklogPolicy);
+
+  /**
+   * The number of files written before their contents are forced to
+   * the disk with `fdatasync()`. Syncing many files at once amortizes
+   * the cost of disk flushes. Zero (the default) leaves flushing to
+   * the operating system. Syncing is not available on Windows. In
+   * background mode, each writer thread syncs its own files.
+   */
+  Q_PROPERTY(int syncInterval READ syncInterval WRITE setSyncInterval);
+
+  /**
+   * The number of images in the backlog, including the ones being
+   * written at the moment.
+   */
+  Q_PROPERTY(int backlog READ backlog STORED false);
+
+  /**
+   * The number of images that were discarded or replaced because of
+   * a full backlog since the operation was last reset.
+   */
+  Q_PROPERTY(int droppedCount READ droppedCount STORED false);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Policies for a full backlog.
+   *
+   * - `BlockWhenFull` - process() waits until a writer thread takes
+   *   the next image. Nothing is lost, but a slow disk stalls the
+   *   pipeline.
+   *
+   * - `DropNewest` - the incoming image is discarded.
+   *
+   * - `DropOldest` - the oldest waiting image is discarded to make
+   *   room for the incoming one.
+   */
+  enum BacklogPolicy { BlockWhenFull, DropNewest, DropOldest };
+
   PiiImageFileWriter();
+  ~PiiImageFileWriter();
 
   /**
    * Write a matrix as an image to a file.
@@ -247,6 +323,7 @@ public:
 protected:
   void syncEvent(SyncEvent* event);
   void process();
+  void aboutToChangeState(State state);
 
   QString outputDirectory() const;
   void setOutputDirectory(const QString& dirName);
@@ -290,13 +367,52 @@ protected:
   void setOverwrite(bool overwrite);
   bool overwrite() const;
 
+  void setWriterThreads(int writerThreads);
+  int writerThreads() const;
+
+  void setMaxBacklog(int maxBacklog);
+  int maxBacklog() const;
+
+  void setBacklogPolicy(BacklogPolicy backlogPolicy);
+  BacklogPolicy backlogPolicy() const;
+
+  void setSyncInterval(int syncInterval);
+  int syncInterval() const;
+
+  int backlog() const;
+  int droppedCount() const;
+
 private:
+  // Everything needed for encoding and writing an image without
+  // touching the operation's state.
+  struct WriteJob
+  {
+    PiiVariant image;
+    QString strFileName, strFormat;
+    QList<QPair<QString,QString> > lstTexts;
+    int iDotsPerMeterX, iDotsPerMeterY;
+    int iCompression;
+    bool bLock, bOverwrite, bStoreAlpha;
+  };
+
   void clearKeyValues();
   void processImage();
+  QList<QPair<QString,QString> > collectTexts();
   void writeKeyValues(QImage* image);
   bool writeImage(QImage* image, const QString& fileName, bool lock);
-  template <class T> void writeGrayImage(const PiiVariant& obj, const QString& fileName);
-  template <class T> void writeColorImage(const PiiVariant& obj, const QString& fileName);
+  bool writeJob(const WriteJob& job, QList<int>* unsyncedHandles);
+  void enqueueJob(const WriteJob& job);
+  void startWriters();
+  void stopWriters();
+  void writeBacklog();
+  void syncFiles(QList<int>* handles);
+
+  static bool isImageType(unsigned int type);
+  static QImage* createImage(const PiiVariant& obj, bool storeAlpha);
+  template <class T> static QImage* createGrayImage(const PiiVariant& obj);
+  template <class T> static QImage* createColorImage(const PiiVariant& obj, bool storeAlpha);
+  static bool saveImage(QImage* image, const QString& fileName, const QString& format,
+                        int compression, bool overwrite, bool lock, int* syncHandle);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -327,6 +443,17 @@ private:
     bool bStoreAlpha;
     bool bChangeExtension;
     bool bOverwrite;
+
+    int iWriterThreads, iMaxBacklog, iSyncInterval;
+    BacklogPolicy backlogPolicy;
+    QList<QThread*> lstWriterThreads;
+    mutable QMutex writerMutex;
+    QWaitCondition jobAvailable, jobFinished;
+    QList<WriteJob> lstJobs;
+    int iActiveJobs, iDroppedCount;
+    bool bWritersRunning;
+    // Handles of synchronously written files waiting for a sync.
+    QList<int> lstUnsyncedHandles;
   };
   PII_D_FUNC;
 };
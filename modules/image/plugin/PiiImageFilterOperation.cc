@@ -23,7 +23,12 @@ PiiImageFilterOperation::Data::Data() :
   filterType(Prebuilt), iFilterSize(3),
   borderHandling(Pii::ExtendZeros),
   matPrebuiltFilter(3, 3),
-  bSeparableFilter(false)
+  bSeparableFilter(false),
+  imageDispatcher(resolveHandler),
+  bStreaming(false),
+  iStreamFilterRows(0),
+  iPendingRows(0),
+  iOutputStart(0), iOutputEnd(0)
 {
 }
 
@@ -35,6 +40,8 @@ PiiImageFilterOperation::PiiImageFilterOperation() :
 
   addSocket(new PiiInputSocket("image"));
   addSocket(new PiiOutputSocket("image"));
+
+  setProtectionLevel("streaming", WriteWhenStopped);
 }
 
 void PiiImageFilterOperation::setFilterName(const QString& filterName)
@@ -117,42 +124,109 @@ void PiiImageFilterOperation::check(bool reset)
          d->matHorzFilter.rows(), d->matHorzFilter.columns(),
          d->matVertFilter.rows(), d->matVertFilter.columns());
   */
+
+  if (d->filterType == Median)
+    d->iStreamFilterRows = d->iFilterSize;
+  else
+    d->iStreamFilterRows = d->bSeparableFilter ? d->matVertFilter.rows() : d->matActiveFilter.rows();
+  if (reset)
+    {
+      d->varTail = PiiVariant();
+      d->iPendingRows = 0;
+    }
+}
+
+/* In streaming mode, the last 2r rows of the previous input (r is
+ * half the filter height) are stacked on top of each new strip. Rows
+ * [r, n-r) of the combined image are filtered from real data only,
+ * but the ones already emitted are skipped.
+ */
+template <class T> PiiMatrix<T> PiiImageFilterOperation::streamInput(const PiiMatrix<T>& strip)
+{
+  PII_D;
+  if (!d->bStreaming)
+    return strip;
+
+  PiiMatrix<T> matInput;
+  if (d->varTail.type() == Pii::typeId<PiiMatrix<T> >() &&
+      d->varTail.valueAs<PiiMatrix<T> >().columns() == strip.columns())
+    matInput = d->varTail.valueAs<PiiMatrix<T> >();
+  else
+    d->iPendingRows = 0;
+  const int iTailRows = matInput.rows();
+  matInput.appendRows(strip);
+
+  const int iRows = matInput.rows(), iRadius = d->iStreamFilterRows / 2;
+  d->iOutputStart = iTailRows - d->iPendingRows;
+  d->iOutputEnd = qMax(d->iOutputStart, iRows - iRadius);
+  d->iPendingRows = iRows - d->iOutputEnd;
+
+  const int iKeep = qMin(2 * iRadius, iRows);
+  if (iKeep > 0)
+    d->varTail = PiiYdin::createVariant(PiiMatrix<T>(matInput(iRows - iKeep, 0, iKeep, -1)));
+  else
+    d->varTail = PiiVariant();
+  return matInput;
+}
+
+template <class T> void PiiImageFilterOperation::emitFiltered(const PiiMatrix<T>& result)
+{
+  PII_D;
+  if (!d->bStreaming)
+    {
+      emitObject(result);
+      return;
+    }
+  // Without border extension, the result lacks the top rows of the
+  // input.
+  const int iOffset = d->borderHandling == Pii::ExtendNot ? (d->iStreamFilterRows - 1) / 2 : 0;
+  const int iStart = qMin(qMax(d->iOutputStart - iOffset, 0), result.rows());
+  const int iEnd = qMin(qMax(d->iOutputEnd - iOffset, iStart), result.rows());
+  if (iEnd > iStart)
+    emitObject(PiiMatrix<T>(result(iStart, 0, iEnd - iStart, -1)));
+  else
+    emitObject(PiiMatrix<T>(0, result.columns()));
 }
 
 void PiiImageFilterOperation::process()
 {
-  PiiVariant obj = readInput();
+  PII_D;
+  d->imageDispatcher.dispatch(this, inputAt(0));
+}
 
-  switch (obj.type())
+PiiImageFilterOperation::Dispatcher::Handler PiiImageFilterOperation::resolveHandler(unsigned int type)
+{
+  switch (type)
     {
-      PII_INT_GRAY_IMAGE_CASES(intGrayFilter, obj);
-      PII_INT_COLOR_IMAGE_CASES(intColorFilter, obj);
+      PII_INT_GRAY_IMAGE_CASES_M(return &PiiImageFilterOperation::intGrayFilter, );
+      PII_INT_COLOR_IMAGE_CASES_M(return &PiiImageFilterOperation::intColorFilter, );
     case PiiYdin::FloatMatrixType:
-      floatGrayFilter<float>(obj);
-      break;
+      return &PiiImageFilterOperation::floatGrayFilter<float>;
     case PiiYdin::FloatColorMatrixType:
-      floatColorFilter<PiiColor<float> >(obj);
-      break;
-    default:
-      PII_THROW_UNKNOWN_TYPE(inputAt(0));
+      return &PiiImageFilterOperation::floatColorFilter<PiiColor<float> >;
+    case PiiYdin::HalfMatrixType:
+      return &PiiImageFilterOperation::halfGrayFilter;
+    case PiiYdin::FixedPointMatrixType:
+      return &PiiImageFilterOperation::fixedGrayFilter<PiiFixedPoint<16> >;
     }
+  return 0;
 }
 
 template <class T> void PiiImageFilterOperation::intGrayFilter(const PiiVariant& obj)
 {
   PII_D;
-  const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
+  const PiiMatrix<T> img = streamInput(obj.valueAs<PiiMatrix<T> >());
   switch (d->filterType)
     {
     case Prebuilt:
     case Custom:
       if (d->bSeparableFilter)
-        emitObject(PiiImage::intFilter(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
+        emitFiltered(PiiImage::intFilter(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
       else
-        emitObject(PiiImage::intFilter(img, d->matActiveFilter, d->borderHandling));
+        emitFiltered(PiiImage::intFilter(img, d->matActiveFilter, d->borderHandling));
       break;
     case Median:
-      emitObject(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
+      emitFiltered(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
       break;
     }
 }
@@ -160,26 +234,57 @@ template <class T> void PiiImageFilterOperation::intGrayFilter(const PiiVariant&
 template <class T> void PiiImageFilterOperation::floatGrayFilter(const PiiVariant& obj)
 {
   PII_D;
-  const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
+  const PiiMatrix<T> img = streamInput(obj.valueAs<PiiMatrix<T> >());
   switch (d->filterType)
     {
     case Prebuilt:
     case Custom:
       if (d->bSeparableFilter)
-        emitObject(PiiImage::filter<T>(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
+        emitFiltered(PiiImage::filter<T>(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
       else
-        emitObject(PiiImage::filter<T>(img, d->matActiveFilter, d->borderHandling));
+        emitFiltered(PiiImage::filter<T>(img, d->matActiveFilter, d->borderHandling));
       break;
     case Median:
-      emitObject(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
+      emitFiltered(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
       break;
     }
 }
 
+template <class T> PiiMatrix<float> PiiImageFilterOperation::filterAsFloat(const PiiMatrix<T>& image)
+{
+  PII_D;
+  switch (d->filterType)
+    {
+    case Prebuilt:
+    case Custom:
+      if (d->bSeparableFilter)
+        return PiiImage::filter<float>(image,
+                                       PiiMatrix<float>(d->matHorzFilter),
+                                       PiiMatrix<float>(d->matVertFilter),
+                                       d->borderHandling);
+      return PiiImage::filter<float>(image, PiiMatrix<float>(d->matActiveFilter), d->borderHandling);
+    case Median:
+      break;
+    }
+  return PiiImage::medianFilter(PiiMatrix<float>(image), d->iFilterSize, d->iFilterSize, d->borderHandling);
+}
+
+// Half-precision pixels are converted to floats while they are
+// loaded by the filter kernel.
+void PiiImageFilterOperation::halfGrayFilter(const PiiVariant& obj)
+{
+  emitFiltered(Pii::floatToHalf(filterAsFloat(streamInput(obj.valueAs<PiiMatrix<PiiHalf> >()))));
+}
+
+template <class T> void PiiImageFilterOperation::fixedGrayFilter(const PiiVariant& obj)
+{
+  emitFiltered(PiiMatrix<T>(filterAsFloat(PiiMatrix<float>(streamInput(obj.valueAs<PiiMatrix<T> >())))));
+}
+
 template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant& obj)
 {
   PII_D;
-  const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
+  const PiiMatrix<T> img = streamInput(obj.valueAs<PiiMatrix<T> >());
   typedef typename T::Type PrimitiveType;
   switch (d->filterType)
     {
@@ -200,7 +305,7 @@ template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant
                                                         d->matHorzFilter, d->matVertFilter, d->borderHandling) :
                                     PiiImage::intFilter(PiiImage::colorChannel(img,i),
                                                         d->matActiveFilter, d->borderHandling));
-        emitObject(matResult);
+        emitFiltered(matResult);
       }
       break;
     case Median:
@@ -213,7 +318,7 @@ template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant
                                                                      d->iFilterSize, d->iFilterSize, d->borderHandling));
         PiiImage::setColorChannel(matResult, 0, PiiImage::medianFilter(PiiImage::colorChannel(img,0),
                                                                      d->iFilterSize, d->iFilterSize, d->borderHandling));
-        emitObject(matResult);
+        emitFiltered(matResult);
       }
       break;
     }
@@ -222,19 +327,19 @@ template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant
 template <class T> void PiiImageFilterOperation::floatColorFilter(const PiiVariant& obj)
 {
   PII_D;
-  const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
+  const PiiMatrix<T> img = streamInput(obj.valueAs<PiiMatrix<T> >());
   typedef typename T::Type PrimitiveType;
   switch (d->filterType)
     {
     case Prebuilt:
     case Custom:
       if (d->bSeparableFilter)
-        emitObject(PiiImage::filter<T>(img,
+        emitFiltered(PiiImage::filter<T>(img,
                                        PiiMatrix<PrimitiveType>(d->matHorzFilter),
                                        PiiMatrix<PrimitiveType>(d->matVertFilter),
                                        d->borderHandling));
       else
-        emitObject(PiiImage::filter<T>(img,
+        emitFiltered(PiiImage::filter<T>(img,
                                        PiiMatrix<PrimitiveType>(d->matActiveFilter),
                                        d->borderHandling));
       break;
@@ -244,7 +349,7 @@ template <class T> void PiiImageFilterOperation::floatColorFilter(const PiiVaria
       PiiImage::setColorChannel(result, 2, ch2);
       PiiImage::setColorChannel(result, 1, PiiImage::medianFilter(PiiImage::colorChannel(img,1), d->iFilterSize, d->iFilterSize, d->borderHandling));
       PiiImage::setColorChannel(result, 0, PiiImage::medianFilter(PiiImage::colorChannel(img,0), d->iFilterSize, d->iFilterSize, d->borderHandling));
-      emitObject(result);
+      emitFiltered(result);
       break;
     }
 }
@@ -254,3 +359,5 @@ PiiVariant PiiImageFilterOperation::filter() const { return _d()->pCustomFilter;
 int PiiImageFilterOperation::filterSize() const { return _d()->iFilterSize; }
 void PiiImageFilterOperation::setBorderHandling(ExtendMode borderHandling) { _d()->borderHandling = static_cast<Pii::ExtendMode>(borderHandling); }
 PiiImageFilterOperation::ExtendMode PiiImageFilterOperation::borderHandling() const { return static_cast<ExtendMode>(_d()->borderHandling); }
+void PiiImageFilterOperation::setStreaming(bool streaming) { _d()->bStreaming = streaming; }
+bool PiiImageFilterOperation::streaming() const { return _d()->bStreaming; }
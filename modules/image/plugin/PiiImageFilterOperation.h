@@ -17,6 +17,7 @@
 #define _PIIIMAGEFILTEROPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiTypeDispatcher.h>
 #include <PiiMatrixUtil.h>
 
 /**
@@ -28,7 +29,9 @@
  * ------
  *
  * @in image - the image to be filtered. Any image type. For color
- * images, the filter will be applied channel-wise.
+ * images, the filter will be applied channel-wise. Half-precision
+ * (PiiHalf) and fixed-point images are filtered in single precision
+ * and converted back to the input type.
  *
  * Outputs
  * -------
@@ -36,6 +39,18 @@
  * @out image - the filtered image. The type of the output image
  * equals that of the input.
  *
+ * Streaming
+ * ---------
+ *
+ * If [streaming] is `true`, consecutive input images are treated as
+ * horizontal strips of one endless image, for example a web imaged
+ * with a line-scan camera. The operation keeps the last rows of the
+ * previous strip and filters across strip boundaries so that the
+ * concatenation of the output images equals the result of filtering
+ * the whole image at once. Rows whose neighborhood extends to the
+ * next strip are held back, so the output lags the input by half the
+ * height of the filter. The number of columns must stay constant;
+ * a change in the size or the type of the input restarts the stream.
  */
 class PiiImageFilterOperation : public PiiDefaultOperation
 {
@@ -86,6 +101,13 @@ class PiiImageFilterOperation : public PiiDefaultOperation
   Q_PROPERTY(ExtendMode borderHandling READ borderHandling WRITE setBorderHandling);
   Q_ENUMS(ExtendMode);
 
+  /**
+   * Enables the streaming mode, in which the input images are
+   * filtered as consecutive strips of a larger image. The default is
+   * `false`.
+   */
+  Q_PROPERTY(bool streaming READ streaming WRITE setStreaming);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -111,6 +133,8 @@ public:
   int filterSize() const;
   void setBorderHandling(ExtendMode borderHandling);
   ExtendMode borderHandling() const;
+  void setStreaming(bool streaming);
+  bool streaming() const;
 
   void check(bool reset);
 
@@ -119,12 +143,20 @@ protected:
 
 private:
   enum FilterType { Prebuilt, Median, Custom };
+  typedef PiiTypeDispatcher<PiiImageFilterOperation> Dispatcher;
+
+  static Dispatcher::Handler resolveHandler(unsigned int type);
 
   template <class T> void intGrayFilter(const PiiVariant& obj);
   template <class T> void floatGrayFilter(const PiiVariant& obj);
   template <class T> void intColorFilter(const PiiVariant& obj);
   template <class T> void floatColorFilter(const PiiVariant& obj);
+  void halfGrayFilter(const PiiVariant& obj);
+  template <class T> void fixedGrayFilter(const PiiVariant& obj);
+  template <class T> PiiMatrix<float> filterAsFloat(const PiiMatrix<T>& image);
   template <class T> void setCustomFilter(const PiiVariant& obj);
+  template <class T> PiiMatrix<T> streamInput(const PiiMatrix<T>& strip);
+  template <class T> void emitFiltered(const PiiMatrix<T>& result);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -142,6 +174,18 @@ private:
     // Active filter and its decomposition (is available)
     bool bSeparableFilter;
     PiiMatrix<double> matActiveFilter, matHorzFilter, matVertFilter;
+    Dispatcher imageDispatcher;
+
+    bool bStreaming;
+    // The height of the filter and the rows kept from the previous
+    // strip.
+    int iStreamFilterRows;
+    PiiVariant varTail;
+    // The number of rows in varTail that have not been emitted yet.
+    int iPendingRows;
+    // The rows of the current (tail + strip) input that will be
+    // emitted.
+    int iOutputStart, iOutputEnd;
   };
   PII_D_FUNC;
 
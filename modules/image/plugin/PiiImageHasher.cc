@@ -0,0 +1,133 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImageHasher.h"
+
+#include <PiiYdinTypes.h>
+#include "PiiImage.h"
+
+PiiImageHasher::Data::Data() :
+  iGridSize(16),
+  dTolerance(1.0),
+  iReferenceRows(0), iReferenceColumns(0), iReferenceType(-1)
+{
+}
+
+PiiImageHasher::PiiImageHasher() :
+  PiiDefaultOperation(new Data)
+{
+  PII_D;
+  addSocket(d->pImageInput = new PiiInputSocket("image"));
+  addSocket(d->pKeyOutput = new PiiOutputSocket("key"));
+  addSocket(d->pChangedOutput = new PiiOutputSocket("changed"));
+  addSocket(d->pImageOutput = new PiiOutputSocket("image"));
+}
+
+void PiiImageHasher::check(bool reset)
+{
+  PII_D;
+  if (d->iGridSize < 1)
+    PII_THROW(PiiExecutionException, tr("Grid size must be at least one."));
+
+  PiiDefaultOperation::check(reset);
+
+  if (reset)
+    {
+      d->matReference.resize(0,0);
+      d->iReferenceType = -1;
+      d->strReferenceKey = QString();
+    }
+}
+
+void PiiImageHasher::process()
+{
+  PiiVariant obj = _d()->pImageInput->firstObject();
+  switch (obj.type())
+    {
+      PII_ALL_IMAGE_CASES(hash, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(_d()->pImageInput);
+    }
+}
+
+template <class T> void PiiImageHasher::hash(const PiiVariant& obj)
+{
+  PII_D;
+  const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  PiiMatrix<double> matSums(PiiImage::blockSums(image, d->iGridSize, d->iGridSize));
+
+  bool bChanged = !isReference(matSums, image.rows(), image.columns(), obj.type(),
+                               PiiImage::BlockSumPixel<T>::Channels);
+  if (bChanged)
+    {
+      d->matReference = matSums;
+      d->iReferenceRows = image.rows();
+      d->iReferenceColumns = image.columns();
+      d->iReferenceType = obj.type();
+      d->strReferenceKey = hashKey(matSums, image.rows(), image.columns(), obj.type());
+    }
+
+  d->pKeyOutput->emitObject(d->strReferenceKey);
+  d->pChangedOutput->emitObject(bChanged ? 1 : 0);
+  d->pImageOutput->emitObject(obj);
+}
+
+bool PiiImageHasher::isReference(const PiiMatrix<double>& sums, int rows, int columns, int type, int channels) const
+{
+  const PII_D;
+  if (d->dTolerance < 0 ||
+      type != d->iReferenceType ||
+      rows != d->iReferenceRows ||
+      columns != d->iReferenceColumns)
+    return false;
+
+  // The grid is the same as in PiiImage::blockSums().
+  const int iGridRows = sums.rows(), iGridCols = sums.columns();
+  for (int gr=0; gr<iGridRows; ++gr)
+    {
+      const qint64 iBlockRows = qint64(gr+1) * rows / iGridRows - qint64(gr) * rows / iGridRows;
+      const double* pSums = sums[gr], *pReference = d->matReference[gr];
+      for (int gc=0; gc<iGridCols; ++gc)
+        {
+          const qint64 iBlockCols = qint64(gc+1) * columns / iGridCols - qint64(gc) * columns / iGridCols;
+          const double dLimit = d->dTolerance * double(iBlockRows * iBlockCols * channels);
+          if (Pii::abs(pSums[gc] - pReference[gc]) > dLimit)
+            return false;
+        }
+    }
+  return true;
+}
+
+QString PiiImageHasher::hashKey(const PiiMatrix<double>& sums, int rows, int columns, int type) const
+{
+  // 64-bit FNV-1a over the image geometry and the block sums.
+  quint64 iHash = Q_UINT64_C(14695981039346656037);
+  const int aHeader[] = { rows, columns, type };
+  const uchar* pBytes = reinterpret_cast<const uchar*>(aHeader);
+  for (std::size_t i=0; i<sizeof(aHeader); ++i)
+    iHash = (iHash ^ pBytes[i]) * Q_UINT64_C(1099511628211);
+  for (int r=0; r<sums.rows(); ++r)
+    {
+      pBytes = reinterpret_cast<const uchar*>(sums[r]);
+      for (std::size_t i=0; i<sizeof(double) * sums.columns(); ++i)
+        iHash = (iHash ^ pBytes[i]) * Q_UINT64_C(1099511628211);
+    }
+  return QString("%1").arg(iHash, 16, 16, QChar('0'));
+}
+
+void PiiImageHasher::setGridSize(int gridSize) { _d()->iGridSize = gridSize; }
+int PiiImageHasher::gridSize() const { return _d()->iGridSize; }
+void PiiImageHasher::setTolerance(double tolerance) { _d()->dTolerance = tolerance; }
+double PiiImageHasher::tolerance() const { return _d()->dTolerance; }
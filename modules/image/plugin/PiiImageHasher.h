@@ -0,0 +1,124 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIIMAGEHASHER_H
+#define _PIIIMAGEHASHER_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiMatrix.h>
+
+/**
+ * An operation that calculates a content key for images. The key
+ * makes it possible to skip processing of frames that don't differ
+ * from earlier ones, e.g. when a production line or a conveyor is
+ * stopped.
+ *
+ * The image is divided into a [gridSize] by [gridSize] grid of
+ * blocks, and the pixel values in each block are summed (see
+ * PiiImage::blockSums()). The key is a hash of the block sums and
+ * the size and type of the image. If the average pixel value of each
+ * block differs from that of the *reference frame* by no more than
+ * [tolerance], the key of the reference frame is emitted again.
+ * Otherwise, the frame becomes the new reference frame. Comparing to
+ * the reference frame instead of the previous one ensures that slow
+ * changes are eventually detected.
+ *
+ * The operation is typically placed in front of a PiiCacheOperation
+ * that stores the results of the actual processing. The key is sent
+ * to the `key` input of the cache and the image to its `object`
+ * input. The image is processed only if the key is not found in the
+ * cache; otherwise, the cached result is replayed.
+ *
+ * ~~~
+ * [camera] --> [hasher] -key----> [cache] -key--> [processing] --+
+ *                 |                  ^  ^                         |
+ *                 +-image------------+  +-------------------------+
+ *                            (object)                       (data)
+ * ~~~
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - any gray-level or color image.
+ *
+ * Outputs
+ * -------
+ *
+ * @out key - the content key of the image as a QString of 16
+ * hexadecimal digits.
+ *
+ * @out changed - 1 if the image became the new reference frame, 0
+ * if it is considered identical to the reference frame. (int)
+ *
+ * @out image - the input image.
+ */
+class PiiImageHasher : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of blocks the image is divided into in both
+   * directions. A larger grid detects smaller changes. The default
+   * is 16.
+   */
+  Q_PROPERTY(int gridSize READ gridSize WRITE setGridSize);
+
+  /**
+   * The maximum absolute difference in the average pixel value
+   * (per channel) of any block for a frame to be considered identical
+   * to the reference frame. Should be set just above the noise level
+   * of the camera. Zero accepts only exactly equal block sums, and a
+   * negative value makes each frame a new reference frame. The
+   * default is 1.0.
+   */
+  Q_PROPERTY(double tolerance READ tolerance WRITE setTolerance);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiImageHasher();
+
+  void check(bool reset);
+
+  void setGridSize(int gridSize);
+  int gridSize() const;
+  void setTolerance(double tolerance);
+  double tolerance() const;
+
+protected:
+  void process();
+
+private:
+  template <class T> void hash(const PiiVariant& obj);
+  bool isReference(const PiiMatrix<double>& sums, int rows, int columns, int type, int channels) const;
+  QString hashKey(const PiiMatrix<double>& sums, int rows, int columns, int type) const;
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    PiiInputSocket* pImageInput;
+    PiiOutputSocket* pKeyOutput, *pChangedOutput, *pImageOutput;
+    int iGridSize;
+    double dTolerance;
+
+    PiiMatrix<double> matReference;
+    int iReferenceRows, iReferenceColumns, iReferenceType;
+    QString strReferenceKey;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIIMAGEHASHER_H
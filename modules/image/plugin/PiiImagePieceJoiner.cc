@@ -24,6 +24,9 @@ using namespace PiiYdin;
 PiiImagePieceJoiner::Data::Data() :
   bTransparent(false), clrBackground(Qt::black),
   largeImage(0), bDiscardDefault(true),
+  iCellWidth(1), iCellHeight(1),
+  iLastTop(0), bInOrder(true),
+  openCompounds(0, Pii::InverseHeap),
   iLeftX(0), iTopY(0)
 {
 }
@@ -74,6 +77,7 @@ void PiiImagePieceJoiner::process()
   if (activeInputGroup() == 1)
     {
       PiiVariant obj = d->pRectangleInput->firstObject();
+      QRect area;
       if (obj.type() == IntMatrixType)
         {
           const PiiMatrix<int> mat = obj.valueAs<PiiMatrix<int> >();
@@ -81,7 +85,7 @@ void PiiImagePieceJoiner::process()
             PII_THROW_WRONG_SIZE(d->pRectangleInput, mat, 1, 4);
 
           // Take the location and build up a QRect out of it.
-          d->rectList << QRect(mat(0,0), mat(0,1), mat(0,2), mat(0,3));
+          area = QRect(mat(0,0), mat(0,1), mat(0,2), mat(0,3));
         }
       else
         PII_THROW_UNKNOWN_TYPE(d->pRectangleInput);
@@ -97,10 +101,16 @@ void PiiImagePieceJoiner::process()
               PII_THROW_UNKNOWN_TYPE(d->pLabelInput);
             }
         }
-      d->labelList << label;
+      addPiece(area, label);
     }
   else
     {
+      // Compounds may be emitted while the pieces of this image are
+      // still coming.
+      d->pPieceOutput->startMany();
+      d->pRectangleOutput->startMany();
+      d->pLabelOutput->startMany();
+
       d->largeImage = d->pImageInput->firstObject();
       if (d->pLocationInput->isConnected())
         readLocation();
@@ -116,10 +126,6 @@ void PiiImagePieceJoiner::syncEvent(SyncEvent* event)
       event->groupId() == d->pImageInput->groupId())
     {
       //qDebug("PiiImagePieceJoiner: inputs in group %d synchronized.", event->groupId());
-      d->pPieceOutput->startMany();
-      d->pRectangleOutput->startMany();
-      d->pLabelOutput->startMany();
-
       //qDebug("PiiImagePieceJoiner: joining");
       joinPieces();
 
@@ -143,88 +149,162 @@ void PiiImagePieceJoiner::readLocation()
   d->iTopY = mat(0,1);
 }
 
-void PiiImagePieceJoiner::joinPieces()
+void PiiImagePieceJoiner::addPiece(QRect area, int label)
 {
   PII_D;
-  if (d->rectList.size() == 0)
-    return;
+  const int iIndex = d->rectList.size();
+  d->rectList << area;
+  d->labelList << label;
+  Data::Piece piece = { -1, iIndex, 1, area };
+  d->vecPieces << piece;
 
-  QLinkedList<QPair<int,int> > pairs;
+  if (iIndex == 0)
+    {
+      // The first piece determines the grid. With equally sized
+      // pieces, each piece then touches at most nine cells.
+      d->iCellWidth = qMax(1, area.width());
+      d->iCellHeight = qMax(1, area.height());
+      d->iLastTop = area.top();
+    }
+  else if (area.top() < d->iLastTop)
+    d->bInOrder = false;
+  else if (area.top() > d->iLastTop)
+    {
+      d->iLastTop = area.top();
+      if (d->bInOrder)
+        emitCompleted(area.top());
+    }
 
-  /*QRect r1(0,0,10,10), r2(10,0,10,10), r3(20,0,10,10),
-    r4(0,10,10,10), r5(10,10,10,10), r6(20,10,10,10),
-    r7(0,20,10,10), r8(10,20,10,10), r9(20,20,10,10);
+  // Unknown (negative) labels are joined like the others. The
+  // default label is discarded if requested.
+  if (d->bDiscardDefault && label == 0)
+    return;
+  d->vecPieces[iIndex].parent = iIndex;
+
+  // Join all neighbors with the same label. Neighbors may be in the
+  // cells next to the ones this piece covers.
+  const int iLeft = cellColumn(area.left() - 1), iRight = cellColumn(area.right() + 1);
+  const int iTop = cellRow(area.top() - 1), iBottom = cellRow(area.bottom() + 1);
+  for (int y=iTop; y<=iBottom; ++y)
+    for (int x=iLeft; x<=iRight; ++x)
+      {
+        QHash<qint64, QList<int> >::const_iterator i = d->hashGrid.constFind(cellKey(x,y));
+        if (i == d->hashGrid.constEnd())
+          continue;
+        const QList<int>& lstCandidates = i.value();
+        for (int j=0; j<lstCandidates.size(); ++j)
+          {
+            const int iOther = lstCandidates[j];
+            if (d->vecPieces[iOther].parent != -1 &&
+                d->labelList[iOther] == label &&
+                isNeighbor(area, d->rectList[iOther]))
+              join(iIndex, iOther);
+          }
+      }
+
+  for (int y=cellRow(area.top()); y<=cellRow(area.bottom()); ++y)
+    for (int x=cellColumn(area.left()); x<=cellColumn(area.right()); ++x)
+      d->hashGrid[cellKey(x,y)] << iIndex;
+}
 
-  qDebug("Neighbors:");
-  qDebug("r1,r5: %s", isNeighbor(r1,r5) ? "yes" : "no");
-  qDebug("r2,r5: %s", isNeighbor(r2,r5) ? "yes" : "no");
-  qDebug("r3,r5: %s", isNeighbor(r3,r5) ? "yes" : "no");
-  qDebug("r4,r5: %s", isNeighbor(r4,r5) ? "yes" : "no");
-  qDebug("r5,r5: %s", isNeighbor(r5,r5) ? "yes" : "no");
-  qDebug("r6,r5: %s", isNeighbor(r6,r5) ? "yes" : "no");
-  qDebug("r7,r5: %s", isNeighbor(r7,r5) ? "yes" : "no");
-  qDebug("r8,r5: %s", isNeighbor(r8,r5) ? "yes" : "no");
-  qDebug("r9,r5: %s", isNeighbor(r9,r5) ? "yes" : "no");*/
+int PiiImagePieceJoiner::findRoot(int index)
+{
+  PII_D;
+  while (d->vecPieces[index].parent != index)
+    {
+      d->vecPieces[index].parent = d->vecPieces[d->vecPieces[index].parent].parent;
+      index = d->vecPieces[index].parent;
+    }
+  return index;
+}
 
-  //qDebug("PiiImagePieceJoiner: Joining %d pieces", d->rectList.size());
+void PiiImagePieceJoiner::join(int index1, int index2)
+{
+  PII_D;
+  int iRoot1 = findRoot(index1), iRoot2 = findRoot(index2);
+  if (iRoot1 == iRoot2)
+    return;
+  // Attach the smaller tree to the larger one to keep the trees flat.
+  if (d->vecPieces[iRoot1].size < d->vecPieces[iRoot2].size)
+    qSwap(iRoot1, iRoot2);
+  Data::Piece& root1 = d->vecPieces[iRoot1];
+  Data::Piece& root2 = d->vecPieces[iRoot2];
+  root2.parent = iRoot1;
+  root1.size += root2.size;
+  root1.bounds |= root2.bounds;
+  // Splice the two circular lists.
+  qSwap(root1.next, root2.next);
+  d->openCompounds.append(qMakePair(root1.bounds.bottom(), iRoot1));
+}
 
-  // First find all pairs of neighboring pieces (a piece is a neighbor
-  // to itself)
-  for (int i=d->rectList.size(); i--; )
+void PiiImagePieceJoiner::emitCompleted(int top)
+{
+  PII_D;
+  // A piece whose top edge is at or below top can only touch
+  // compounds that reach at least the row above it.
+  while (d->openCompounds.size() > 0 && d->openCompounds[0].first + 1 < top)
     {
-      if (//d->labelList[i] >= 0 && // negative values are unknown and always discarded
-          (!d->bDiscardDefault || d->labelList[i] != 0)) // we need to consider also label 0
-        {
-          for (int j=i; j--; )
-            if (d->labelList[i] == d->labelList[j] && //if the pieces are in the same class
-                isNeighbor(d->rectList[i], d->rectList[j])) //... and they are neighbors
-              pairs << qMakePair(i,j);
-        }
+      QPair<int,int> entry(d->openCompounds.take(0));
+      const Data::Piece& root = d->vecPieces[entry.second];
+      if (root.parent == entry.second && root.bounds.bottom() == entry.first)
+        finishCompound(entry.second);
     }
+}
 
-  // Then recursively join all neighbors
-  while (!pairs.isEmpty())
+void PiiImagePieceJoiner::finishCompound(int root)
+{
+  PII_D;
+  const QRect area(d->vecPieces[root].bounds);
+  if (d->bTransparent)
     {
-      // Stores the indices (in d->rectList) of all neighbors
-      QList<int> indices;
-      indices << pairs.first().first;
-      // This removes all neighbors of the first item from <pairs>
-      joinNeighbors(pairs.first().first, pairs, indices);
-
-      //qDebug("PiiImagePieceJoiner: Joined %d neighbors. %d pairs left.", indices.size(), pairs.size());
-      // Build up a compound that encloses all the neighbors
-      if (d->bTransparent)
-        {
-          // If transparency is used, we need to collect all the
-          // joined rectangles and copy each to a new image.
-          QList<QRect*> subAreas;
-          QRect area = d->rectList[indices[0]];
-          subAreas << &d->rectList[indices[0]];
-          for (int i=1; i<indices.size(); i++)
-            {
-              area |= d->rectList[indices[i]];
-              subAreas << &d->rectList[indices[i]];
-            }
-          emitCompound(area, subAreas);
-        }
-      else
+      // If transparency is used, we need to collect all the
+      // joined rectangles and copy each to a new image.
+      QList<QRect*> subAreas;
+      int i = root;
+      do
         {
-          // If transparency is not used, it suffices to frame the
-          // rectangles and send that as a shared copy.
-          QRect area = d->rectList[indices[0]];
-          for (int i=1; i<indices.size(); i++)
-            area |= d->rectList[indices[i]];
-          emitCompound(area);
+          subAreas << &d->rectList[i];
+          i = d->vecPieces[i].next;
         }
+      while (i != root);
+      emitCompound(area, subAreas);
+    }
+  else
+    {
+      // If transparency is not used, it suffices to frame the
+      // rectangles and send that as a shared copy.
+      emitCompound(area);
+    }
 
-      // Send its label
-      d->pLabelOutput->emitObject(d->labelList[indices[0]]);
-      //qDebug("PiiImagePieceJoiner: finished this compound");
+  // Send its label
+  d->pLabelOutput->emitObject(d->labelList[root]);
+
+  // The pieces are used up.
+  int i = root;
+  do
+    {
+      d->vecPieces[i].parent = -1;
+      i = d->vecPieces[i].next;
     }
+  while (i != root);
+}
+
+void PiiImagePieceJoiner::joinPieces()
+{
+  PII_D;
+  // Emit everything that may still have been waiting for more
+  // pieces. A piece alone is not a compound.
+  for (int i=0; i<d->vecPieces.size(); ++i)
+    if (d->vecPieces[i].parent == i && d->vecPieces[i].size > 1)
+      finishCompound(i);
 
   // Initialize the lists of rectangles and labels
   d->rectList.clear();
   d->labelList.clear();
+  d->vecPieces.clear();
+  d->hashGrid.clear();
+  d->openCompounds.fill(0, QPair<int,int>());
+  d->bInOrder = true;
 }
 
 // For transparency
@@ -311,39 +391,22 @@ bool PiiImagePieceJoiner::isNeighbor(QRect r1, QRect r2)
             r2.top() > (r1.bottom())+1));
 }
 
-void PiiImagePieceJoiner::joinNeighbors(int index, QLinkedList<QPair<int,int> >& pairs, QList<int>& indices)
+int PiiImagePieceJoiner::cellColumn(int x) const
 {
-  //qDebug("Finding neighbors for %d", index);
-  QList<int> newIndices;
-  QLinkedList<QPair<int,int> >::iterator i = pairs.begin();
-  while (i != pairs.end())
-    {
-      // If a match was found in the pair, add the other index in the
-      // pair to the index list. Then remove the found match from the
-      // list.
-      if (i->first == index)
-        {
-          //qDebug("  %d matches", i->second);
-          newIndices << i->second;
-          i = pairs.erase(i);
-        }
-      else if (i->second == index)
-        {
-          //qDebug("  %d matches", i->first);
-          newIndices << i->first;
-          i = pairs.erase(i);
-        }
-      else
-        i++;
-    }
-  // Now we have found all direct neighbors of <index>. Let's find
-  // (recursively) the neighbors of its neighbors.
-  for (int i=newIndices.size(); i--; )
-    if (newIndices[i] != index) //no need to check myself again...
-      joinNeighbors(newIndices[i], pairs, indices);
-
-  // Store all indices to a single list
-  indices << newIndices;
+  const int iWidth = _d()->iCellWidth;
+  // Round towards negative infinity.
+  return x >= 0 ? x / iWidth : (x + 1) / iWidth - 1;
+}
+
+int PiiImagePieceJoiner::cellRow(int y) const
+{
+  const int iHeight = _d()->iCellHeight;
+  return y >= 0 ? y / iHeight : (y + 1) / iHeight - 1;
+}
+
+qint64 PiiImagePieceJoiner::cellKey(int x, int y) const
+{
+  return (qint64(y) << 32) | quint32(x);
 }
 
 bool PiiImagePieceJoiner::isTransparent() const { return _d()->bTransparent; }
@@ -17,8 +17,10 @@
 #define _PIIIMAGEPIECEJOINER_H
 
 #include <PiiDefaultOperation.h>
+#include <PiiHeap.h>
 #include <QList>
-#include <QLinkedList>
+#include <QVector>
+#include <QHash>
 #include <QPair>
 #include <QColor>
 #include <QRect>
@@ -31,7 +33,19 @@
  * recognizing large defects in defect detection. Each sub-image has a
  * label that tells the class of the sub-image. Adjacent sub-images
  * with the same class label are joined together to form continuous
- * regions.
+ * regions. Only regions that consist of at least two sub-images are
+ * emitted.
+ *
+ * Each incoming sub-image is looked up in a grid index and merged
+ * with its neighbors in a union-find structure. Joining takes
+ * roughly constant time per sub-image, independent of how many
+ * sub-images there are. If the areas arrive in raster order (sorted
+ * by their top edge, as PiiImageSplitter sends them), a compound is
+ * emitted as soon as the incoming areas are so far down that none
+ * of them can touch it anymore. Otherwise, compounds are emitted
+ * once all areas of the large image have been received. If an area
+ * arrives out of order after some compounds have already been
+ * emitted, it is never merged with them.
  *
  * Inputs
  * ------
@@ -137,11 +151,18 @@ protected:
 
 private:
   void readLocation();
+  void addPiece(QRect area, int label);
+  void emitCompleted(int top);
+  void finishCompound(int root);
   void joinPieces();
   void emitCompound(QRect area);
   void emitCompound(QRect area, QList<QRect*>& subAreas);
   inline bool isNeighbor(QRect r1, QRect r2);
-  void joinNeighbors(int index, QLinkedList<QPair<int,int> >& pairs, QList<int>& indices);
+  int findRoot(int index);
+  void join(int index1, int index2);
+  inline qint64 cellKey(int x, int y) const;
+  inline int cellColumn(int x) const;
+  inline int cellRow(int y) const;
   template <class T> void emitSubImage(QRect area);
   template <class T> void emitSubImage(QPair<QRect,QList<QRect*>* >& pair);
 
@@ -160,6 +181,30 @@ private:
     QList<QRect> rectList;
     QList<int> labelList;
 
+    /* A node in the union-find forest. Each piece is a node, and the
+       root of a tree represents a compound. *next* links the pieces
+       of a compound into a circular list. *parent* is -1 for pieces
+       that are not joined or whose compound has been emitted.
+     */
+    struct Piece
+    {
+      int parent, next, size;
+      // The bounding box of the compound. Valid for roots only.
+      QRect bounds;
+    };
+    QVector<Piece> vecPieces;
+    // Pieces that overlap each grid cell.
+    QHash<qint64, QList<int> > hashGrid;
+    int iCellWidth, iCellHeight;
+    // The largest top edge seen so far, and whether pieces have so
+    // far arrived in raster order.
+    int iLastTop;
+    bool bInOrder;
+    // (bottom edge, root) of compounds that may still grow, the
+    // smallest bottom first. Entries that have been outdated by
+    // merging are skipped.
+    PiiHeap<QPair<int,int>, 64> openCompounds;
+
     PiiInputSocket* pImageInput, *pLocationInput, *pRectangleInput, *pLabelInput;
     PiiOutputSocket* pPieceOutput, *pRectangleOutput, *pLabelOutput;
 
@@ -18,6 +18,8 @@
 //Basic image handling
 #include "PiiImageFileReader.h"
 #include "PiiImageFileWriter.h"
+#include "PiiImageDecoder.h"
+#include "PiiRawImageReader.h"
 #include "PiiImageSplitter.h"
 #include "PiiImageCropper.h"
 #include "PiiImagePieceJoiner.h"
@@ -29,6 +31,8 @@
 #include "PiiImageFilterOperation.h"
 #include "PiiCornerDetector.h"
 #include "PiiAdaptiveImageNormalizer.h"
+#include "PiiImageHasher.h"
+#include "PiiImageAugmenter.h"
 
 //Histograms
 #include "PiiHistogramOperation.h"
@@ -47,12 +51,15 @@
 
 // Other
 #include "PiiImageUnwarpOperation.h"
+#include "PiiTemplateMatchingOperation.h"
 
 PII_IMPLEMENT_PLUGIN(PiiImagePlugin);
 
 //Basic image handling
 PII_REGISTER_OPERATION(PiiImageFileReader);
 PII_REGISTER_OPERATION(PiiImageFileWriter);
+PII_REGISTER_OPERATION(PiiImageDecoder);
+PII_REGISTER_OPERATION(PiiRawImageReader);
 PII_REGISTER_OPERATION(PiiImageSplitter);
 PII_REGISTER_OPERATION(PiiImageCropper);
 PII_REGISTER_OPERATION(PiiImagePieceJoiner);
@@ -64,6 +71,8 @@ PII_REGISTER_OPERATION(PiiImageRotationOperation);
 PII_REGISTER_OPERATION(PiiImageFilterOperation);
 PII_REGISTER_OPERATION(PiiCornerDetector);
 PII_REGISTER_OPERATION(PiiAdaptiveImageNormalizer);
+PII_REGISTER_OPERATION(PiiImageHasher);
+PII_REGISTER_OPERATION(PiiImageAugmenter);
 
 //Histograms
 PII_REGISTER_OPERATION(PiiHistogramOperation);
@@ -82,6 +91,7 @@ PII_REGISTER_OPERATION(PiiBoundaryFinderOperation);
 
 //Other
 PII_REGISTER_OPERATION(PiiImageUnwarpOperation);
+PII_REGISTER_OPERATION(PiiTemplateMatchingOperation);
 
 #include <QtPlugin>
 #if QT_VERSION < 0x050000
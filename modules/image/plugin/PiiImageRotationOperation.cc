@@ -91,21 +91,53 @@ template <class T> void PiiImageRotationOperation::rotate(const PiiVariant& obj)
     }
 
   //qDebug("Rotating image %d degrees.", int(angle / M_PI * 180));
+  const PiiMatrix<T> matImage(obj.valueAs<PiiMatrix<T> >());
   // Rotate if needed
-  if (angle == 0.0 || obj.valueAs<PiiMatrix<T> >().isEmpty())
+  if (angle == 0.0 || matImage.isEmpty())
     emitObject(obj);
-  else
-    emitObject(PiiImage::rotate(obj.valueAs<PiiMatrix<T> >(),
+  // Right angles are just copies, and a changing angle would need a
+  // new table for each image.
+  else if (inputAt(1)->isConnected() || isRightAngle(angle))
+    emitObject(PiiImage::rotate(matImage,
                                 angle,
                                 d->transformedSize,
                                 Background<T>::get(d->backgroundColor)));
+  else
+    {
+      if (d->rotationTable.sourceRows() != matImage.rows() ||
+          d->rotationTable.sourceColumns() != matImage.columns())
+        d->rotationTable = PiiRemapTable(PiiImage::createRotationTransform(float(angle),
+                                                                           matImage.columns()/2.0,
+                                                                           matImage.rows()/2.0),
+                                         matImage.rows(), matImage.columns(),
+                                         d->transformedSize);
+      emitObject(d->rotationTable.remap(matImage, Background<T>::get(d->backgroundColor)));
+    }
+}
+
+bool PiiImageRotationOperation::isRightAngle(double angle)
+{
+  double dQuarters = angle / M_PI_2;
+  return Pii::almostEqualRel(dQuarters, double(Pii::round<int>(dQuarters)));
+}
+
+void PiiImageRotationOperation::setAngle(double angle)
+{
+  PII_D;
+  d->dAngle = angle;
+  d->rotationTable = PiiRemapTable();
 }
 
-void PiiImageRotationOperation::setAngle(double angle) { _d()->dAngle = angle; }
 double PiiImageRotationOperation::angle() const { return _d()->dAngle; }
-void PiiImageRotationOperation::setAngleDeg(double angleDeg) { _d()->dAngle = angleDeg / 180.0 * M_PI; }
+void PiiImageRotationOperation::setAngleDeg(double angleDeg) { setAngle(angleDeg / 180.0 * M_PI); }
 double PiiImageRotationOperation::angleDeg() const { return _d()->dAngle / M_PI * 180.0; }
-void PiiImageRotationOperation::setTransformedSize(PiiImage::TransformedSize transformedSize) { _d()->transformedSize = transformedSize; }
+void PiiImageRotationOperation::setTransformedSize(PiiImage::TransformedSize transformedSize)
+{
+  PII_D;
+  d->transformedSize = transformedSize;
+  d->rotationTable = PiiRemapTable();
+}
+
 PiiImage::TransformedSize PiiImageRotationOperation::transformedSize() const { return _d()->transformedSize; }
 void PiiImageRotationOperation::setBackgroundColor(const QColor& backgroundColor) { _d()->backgroundColor = backgroundColor; }
 QColor PiiImageRotationOperation::backgroundColor() const { return _d()->backgroundColor; }
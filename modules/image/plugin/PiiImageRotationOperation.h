@@ -19,6 +19,7 @@
 #include <PiiDefaultOperation.h>
 #include <PiiMath.h>
 #include "PiiImageGlobal.h"
+#include "PiiRemapTable.h"
 
 /**
  * Rotate images to arbitrary angles in two dimension.
@@ -30,7 +31,9 @@
  *
  * @in angle - rotation angle (radians, clockwise). This input is
  * optional. If it is not connected, the `angle` property will be
- * used.
+ * used. With a fixed angle, the mapping between input and output
+ * pixels is calculated only once per image size (see
+ * PiiRemapTable).
  *
  * Outputs
  * -------
@@ -91,11 +94,13 @@ private:
     double dAngle;
     PiiImage::TransformedSize transformedSize;
     QColor backgroundColor;
+    PiiRemapTable rotationTable;
   };
   PII_D_FUNC;
 
   template <class T> void rotate(const PiiVariant& obj);
   template <class T> struct Background;
+  static bool isRightAngle(double angle);
 };
 
 
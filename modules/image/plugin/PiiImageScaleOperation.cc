@@ -15,8 +15,35 @@
 
 #include "PiiImageScaleOperation.h"
 #include "PiiImage.h"
+#include "PiiImagePyramid.h"
 #include <PiiYdinTypes.h>
 
+namespace
+{
+  template <class T> PiiMatrix<T> scaleDown(const PiiMatrix<T>& image, int rows, int columns,
+                                            Pii::Interpolation interpolation, Pii::False)
+  {
+    return PiiImage::scale(image, rows, columns, interpolation);
+  }
+
+  // Reduces the image first with the averaging pyramid. This avoids
+  // aliasing, and the reduced levels are shared with other users of
+  // the same image.
+  template <class T> PiiMatrix<T> scaleDown(const PiiMatrix<T>& image, int rows, int columns,
+                                            Pii::Interpolation interpolation, Pii::True)
+  {
+    if (interpolation != Pii::LinearInterpolation ||
+        rows*2 > image.rows() || columns*2 > image.columns())
+      return PiiImage::scale(image, rows, columns, interpolation);
+
+    PiiImagePyramid<T> pyramid(PiiImagePyramid<T>::shared(image, PiiImage::BoxPyramidKernel));
+    PiiMatrix<T> matLevel(pyramid.level(pyramid.levelForSize(rows, columns)));
+    if (matLevel.rows() == rows && matLevel.columns() == columns)
+      return matLevel;
+    return PiiImage::scale(matLevel, rows, columns, interpolation);
+  }
+}
+
 PiiImageScaleOperation::Data::Data() :
   scaleMode(ScaleAccordingToFactor),
   dScaleRatio(1.0),
@@ -41,6 +68,12 @@ void PiiImageScaleOperation::process()
     {
       PII_GRAY_IMAGE_CASES(scaleImage, image);
       PII_COLOR_IMAGE_CASES(scaleImage, image);
+    case PiiYdin::HalfMatrixType:
+      scaleImage<PiiHalf>(image);
+      break;
+    case PiiYdin::FixedPointMatrixType:
+      scaleImage<PiiFixedPoint<16> >(image);
+      break;
     default:
       PII_THROW_UNKNOWN_TYPE(inputAt(0));
     }
@@ -97,7 +130,8 @@ template <class T> void PiiImageScaleOperation::scaleImage(const PiiVariant& obj
   // Do we actually need to scale the image?
   if ((rows != image.rows() || cols != image.columns()) &&
       rows > 0 && cols > 0)
-    emitObject(PiiImage::scale(image, rows, cols, (Pii::Interpolation)d->interpolation));
+    emitObject(scaleDown(image, rows, cols, (Pii::Interpolation)d->interpolation,
+                         typename Pii::IfClass<Pii::IsNumeric<T>, Pii::True, Pii::False>::Type()));
   else // Pass the image without modification
     emitObject(obj);
 }
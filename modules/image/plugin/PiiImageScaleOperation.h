@@ -25,7 +25,8 @@
  * Inputs
  * ------
  *
- * @in image - Input image. Any image type.
+ * @in image - Input image. Any image type, including
+ * half-precision (PiiHalf) and fixed-point images.
  *
  * Outputs
  * -------
@@ -58,6 +59,17 @@ class PiiImageScaleOperation : public PiiDefaultOperation
   /**
    * Interpolation mode. The default is `LinearInterpolation`.
    * `NearestNeighborInterpolation` is faster, but less accurate.
+   * `CubicInterpolation` gives the sharpest results.
+   * `AreaInterpolation` averages all input pixels under each output
+   * pixel and is the best choice for large reductions. See
+   * PiiImage::scale() for details.
+   *
+   * If a gray-level image is scaled down to half or less of its size
+   * with `LinearInterpolation`, it is first reduced by averaging
+   * 2-by-2 blocks as many times as the target size allows (see
+   * PiiImagePyramid::shared()). This reduces aliasing. The reduced
+   * levels are shared with other operations that build an averaging
+   * pyramid out of the same image.
    */
   Q_PROPERTY(Interpolation interpolation READ interpolation WRITE setInterpolation);
   Q_ENUMS(Interpolation);
@@ -67,7 +79,13 @@ public:
   /**
    * A copy of Pii::Interpolation. (Stupid moc.)
    */
-  enum Interpolation { NearestNeighborInterpolation, LinearInterpolation };
+  enum Interpolation
+    {
+      NearestNeighborInterpolation,
+      LinearInterpolation,
+      CubicInterpolation,
+      AreaInterpolation
+    };
 
   /**
    * Scaling modes:
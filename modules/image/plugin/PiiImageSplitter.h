@@ -52,7 +52,10 @@
  * input image to this output before it sends the pieces.
  *
  * @out subimage - pieces of the large image. The type of the
- * subimages is the same as that of the input images.
+ * subimages is the same as that of the input images. The pieces are
+ * not copied but refer to the data of the input image, which stays
+ * alive as long as any of its pieces does. If a receiver modifies a
+ * piece, only the piece will be detached.
  *
  * @out location - the location of the corresponding sub-image as a
  * rectangle (1-by-4 PiiMatrix<int> containing x, y, width, and height
@@ -16,6 +16,7 @@
 #include "PiiLabelingOperation.h"
 #include <PiiMatrix.h>
 #include "PiiLabeling.h"
+#include "PiiObjectProperty.h"
 #include "PiiImageTraits.h"
 #include <PiiYdinTypes.h>
 
@@ -23,7 +24,8 @@ PiiLabelingOperation::Data::Data() :
   connectivity(PiiImage::Connect4),
   dThreshold(0),
   dHysteresis(0),
-  bInverse(false)
+  bInverse(false),
+  bStreaming(false)
 {
 }
 
@@ -35,10 +37,26 @@ PiiLabelingOperation::PiiLabelingOperation() :
   d->pBinaryImageInput = new PiiInputSocket("image");
   d->pLabeledImageOutput = new PiiOutputSocket("image");
   d->pLabelsOutput = new PiiOutputSocket("labels");
+  d->pAreasOutput = new PiiOutputSocket("areas");
+  d->pCentroidsOutput = new PiiOutputSocket("centroids");
+  d->pBoundingBoxOutput = new PiiOutputSocket("boundingboxes");
 
   addSocket(d->pBinaryImageInput);
   addSocket(d->pLabeledImageOutput);
   addSocket(d->pLabelsOutput);
+  addSocket(d->pAreasOutput);
+  addSocket(d->pCentroidsOutput);
+  addSocket(d->pBoundingBoxOutput);
+
+  setProtectionLevel("streaming", WriteWhenStopped);
+}
+
+void PiiLabelingOperation::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+  if (reset || d->streamLabeler.connectivity() != d->connectivity)
+    d->streamLabeler.setConnectivity(d->connectivity);
 }
 
 
@@ -51,6 +69,13 @@ void PiiLabelingOperation::process()
   switch (obj.type())
     {
       PII_GRAY_IMAGE_CASES(operate, obj);
+    case PiiYdin::BitMatrixType:
+      // Set bits are objects. Threshold and hysteresis are ignored.
+      if (d->bStreaming)
+        labelStrip(obj.valueAs<PiiBitMatrix>(), std::bind2nd(std::not_equal_to<bool>(), d->bInverse));
+      else
+        labelRuns(obj.valueAs<PiiBitMatrix>(), std::bind2nd(std::not_equal_to<bool>(), d->bInverse));
+      break;
     default:
       PII_THROW_UNKNOWN_TYPE(d->pBinaryImageInput);
     }
@@ -61,47 +86,127 @@ template <class T> void PiiLabelingOperation::operate(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
-  int iLabels = 0;
-  if (d->connectivity == PiiImage::Connect4 && d->dHysteresis == 0)
+  if (d->bStreaming)
     {
       if (!d->bInverse)
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::greater<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        labelStrip(image, std::bind2nd(std::greater<T>(), T(d->dThreshold)));
       else
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::less_equal<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        labelStrip(image, std::bind2nd(std::less_equal<T>(), T(d->dThreshold)));
+      return;
     }
-  else if (!d->bInverse)
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(qMax(0.0,
-                                                                                d->dThreshold - d->dHysteresis))),
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(d->dThreshold)),
-                                                            d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
-                                                            &iLabels));
+  if (d->dHysteresis == 0)
+    {
+      if (!d->bInverse)
+        labelRuns(image, std::bind2nd(std::greater<T>(), T(d->dThreshold)));
+      else
+        labelRuns(image, std::bind2nd(std::less_equal<T>(), T(d->dThreshold)));
+      return;
+    }
+
+  int iLabels = 0;
+  PiiMatrix<int> matLabels;
+  if (!d->bInverse)
+    matLabels = PiiImage::labelImage(image,
+                                     std::bind2nd(std::greater<T>(),
+                                                  T(qMax(0.0,
+                                                         d->dThreshold - d->dHysteresis))),
+                                     std::bind2nd(std::greater<T>(),
+                                                  T(d->dThreshold)),
+                                     d->connectivity,
+                                     false,
+                                     0,
+                                     INT_MAX,
+                                     &iLabels);
   else
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(qMin(double(PiiImage::Traits<T>::max()),
-                                                                                d->dThreshold + d->dHysteresis))),
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(d->dThreshold)),
-                                                            d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
-                                                            &iLabels));
+    matLabels = PiiImage::labelImage(image,
+                                     std::bind2nd(std::less_equal<T>(),
+                                                  T(qMin(double(PiiImage::Traits<T>::max()),
+                                                         d->dThreshold + d->dHysteresis))),
+                                     std::bind2nd(std::less_equal<T>(),
+                                                  T(d->dThreshold)),
+                                     d->connectivity,
+                                     false,
+                                     0,
+                                     INT_MAX,
+                                     &iLabels);
+  d->pLabeledImageOutput->emitObject(matLabels);
+  d->pLabelsOutput->emitObject(iLabels);
+
+  if (d->pAreasOutput->isConnected() ||
+      d->pCentroidsOutput->isConnected() ||
+      d->pBoundingBoxOutput->isConnected())
+    {
+      PiiMatrix<int> matAreas, matCentroids, matBoundingBoxes;
+      if (iLabels > 0)
+        PiiImage::calculateProperties(matLabels, iLabels, matAreas, matCentroids, matBoundingBoxes);
+      emitProperties(matAreas, matCentroids, matBoundingBoxes);
+    }
+}
+
+template <class Matrix, class UnaryOp> void PiiLabelingOperation::labelRuns(const Matrix& image, UnaryOp rule)
+{
+  PII_D;
+  int iLabels = 0;
+  // Object properties are collected while labeling.
+  PiiImage::ObjectFeatureAccumulator features;
+  QVector<PiiImage::LabeledRun> vecRuns(PiiImage::labelRuns(image, rule, d->connectivity,
+                                                            features, &iLabels,
+                                                            PiiParallelPolicy()));
+  if (d->pLabeledImageOutput->isConnected())
+    {
+      PiiMatrix<int> matLabels(image.rows(), image.columns());
+      PiiImage::paintRuns(vecRuns, matLabels, PiiParallelPolicy());
+      d->pLabeledImageOutput->emitObject(matLabels);
+    }
   d->pLabelsOutput->emitObject(iLabels);
+  emitProperties(features.areas(), features.centroids(), features.boundingBoxes());
+}
+
+template <class Matrix, class UnaryOp> void PiiLabelingOperation::labelStrip(const Matrix& strip, UnaryOp rule)
+{
+  PII_D;
+  PiiImage::StreamLabeler& labeler = d->streamLabeler;
+  labeler.addStrip(strip, rule);
+  if (d->pLabeledImageOutput->isConnected())
+    {
+      PiiMatrix<int> matLabels(strip.rows(), strip.columns());
+      PiiImage::paintRuns(labeler.stripRuns(), matLabels);
+      d->pLabeledImageOutput->emitObject(matLabels);
+    }
+
+  QVector<PiiImage::StreamLabeler::Object> vecObjects(labeler.takeClosedObjects());
+  const int iCount = vecObjects.size();
+  d->pLabelsOutput->emitObject(iCount);
+
+  // Rows are reported relative to the first row of this strip.
+  const qint64 iFirstRow = labeler.rowCount() - strip.rows();
+  PiiMatrix<int> matAreas(iCount, 1), matCentroids(iCount, 2), matBoundingBoxes(iCount, 4);
+  for (int i=0; i<iCount; ++i)
+    {
+      const PiiImage::StreamLabeler::Object& obj = vecObjects[i];
+      const int iTop = int(obj.top - iFirstRow);
+      matAreas(i,0) = obj.area;
+      matCentroids(i,0) = int(obj.centroidX() + 0.5);
+      matCentroids(i,1) = iTop + int(obj.centroidY() + 0.5);
+      matBoundingBoxes(i,0) = obj.left;
+      matBoundingBoxes(i,1) = iTop;
+      matBoundingBoxes(i,2) = obj.right - obj.left + 1;
+      matBoundingBoxes(i,3) = int(obj.bottom - obj.top) + 1;
+    }
+  emitProperties(matAreas, matCentroids, matBoundingBoxes);
+}
+
+void PiiLabelingOperation::emitProperties(const PiiMatrix<int>& areas,
+                                          const PiiMatrix<int>& centroids,
+                                          const PiiMatrix<int>& boundingBoxes)
+{
+  PII_D;
+  if (d->pAreasOutput->isConnected())
+    d->pAreasOutput->emitObject(areas);
+  if (d->pCentroidsOutput->isConnected())
+    d->pCentroidsOutput->emitObject(centroids);
+  if (d->pBoundingBoxOutput->isConnected())
+    d->pBoundingBoxOutput->emitObject(boundingBoxes);
 }
 
 void PiiLabelingOperation::setConnectivity(PiiImage::Connectivity connectivity) { _d()->connectivity = connectivity; }
@@ -113,3 +218,5 @@ void PiiLabelingOperation::setHysteresis(double hysteresis) { _d()->dHysteresis
 double PiiLabelingOperation::hysteresis() const { return _d()->dHysteresis; }
 void PiiLabelingOperation::setInverse(bool inverse) { _d()->bInverse = inverse; }
 bool PiiLabelingOperation::inverse() const { return _d()->bInverse; }
+void PiiLabelingOperation::setStreaming(bool streaming) { _d()->bStreaming = streaming; }
+bool PiiLabelingOperation::streaming() const { return _d()->bStreaming; }
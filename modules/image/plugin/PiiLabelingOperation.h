@@ -19,6 +19,7 @@
 #include <PiiDefaultOperation.h>
 #include <PiiMatrix.h>
 #include "PiiImageGlobal.h"
+#include "PiiStreamLabeler.h"
 
 /**
  * Basic labeling operations.
@@ -28,7 +29,8 @@
  *
  * @in image - the input image. Binary image. If the image is not
  * binary, it will be automatically thresholded. (Any gray-level image
- * type.)
+ * type.) Bit-packed binary images (PiiBitMatrix) are labeled a word
+ * at a time. Their set bits are objects unless `inverse` is `true`.
  *
  * Outputs
  * -------
@@ -40,6 +42,46 @@
  * @out labels - the number of distinct objects in the input image.
  * (int)
  *
+ * @out areas - the areas of the objects. A N-by-1 PiiMatrix<int>.
+ *
+ * @out centroids - the centroids of the objects. A N-by-2
+ * PiiMatrix<int> with the x and y coordinates of each object on its
+ * rows.
+ *
+ * @out boundingboxes - the bounding boxes of the objects. A N-by-4
+ * PiiMatrix<int> with the x, y, width and height of each object on
+ * its rows.
+ *
+ * The object properties are the same as those produced by
+ * PiiObjectPropertyExtractor. Unless `hysteresis` is used, they are
+ * accumulated while labeling, and no extra pass over the image is
+ * needed. If the `image` output is not connected, no label image
+ * will be created.
+ *
+ * Streaming
+ * ---------
+ *
+ * If [streaming] is `true`, consecutive input images are treated as
+ * strips of one endless image, for example a web imaged with a
+ * line-scan camera. Objects that cross strip boundaries are joined,
+ * and each object is reported once, after the first strip that
+ * no longer contains any of its pixels. In this mode:
+ *
+ * - `labels` is the number of objects closed by the current strip,
+ * and `areas`, `centroids` and `boundingboxes` describe them. Row
+ * coordinates are relative to the first row of the current strip.
+ * Objects that began in earlier strips therefore have negative y
+ * coordinates.
+ *
+ * - `image` is the current strip labeled with object ids that keep
+ * increasing from strip to strip. An object that spans many strips
+ * has the same id in all of them, unless two objects merge in a
+ * later strip.
+ *
+ * - `hysteresis` is ignored.
+ *
+ * The stream restarts whenever the operation is started after a
+ * reset, or when the width of the input changes.
  */
 class PiiLabelingOperation : public PiiDefaultOperation
 {
@@ -73,6 +115,12 @@ class PiiLabelingOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool inverse READ inverse WRITE setInverse);
 
+  /**
+   * Enables the streaming mode, in which objects are tracked across
+   * consecutive input images. The default is `false`.
+   */
+  Q_PROPERTY(bool streaming READ streaming WRITE setStreaming);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiLabelingOperation();
@@ -85,12 +133,21 @@ public:
   double hysteresis() const;
   void setInverse(bool inverse);
   bool inverse() const;
+  void setStreaming(bool streaming);
+  bool streaming() const;
+
+  void check(bool reset);
 
 protected:
   void process();
 
 private:
   template <class T> void operate(const PiiVariant& obj);
+  template <class Matrix, class UnaryOp> void labelRuns(const Matrix& image, UnaryOp rule);
+  template <class Matrix, class UnaryOp> void labelStrip(const Matrix& strip, UnaryOp rule);
+  void emitProperties(const PiiMatrix<int>& areas,
+                      const PiiMatrix<int>& centroids,
+                      const PiiMatrix<int>& boundingBoxes);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -102,9 +159,14 @@ private:
     PiiInputSocket* pBinaryImageInput;
     PiiOutputSocket* pLabeledImageOutput;
     PiiOutputSocket* pLabelsOutput;
+    PiiOutputSocket* pAreasOutput;
+    PiiOutputSocket* pCentroidsOutput;
+    PiiOutputSocket* pBoundingBoxOutput;
     double dThreshold;
     double dHysteresis;
     bool bInverse;
+    bool bStreaming;
+    PiiImage::StreamLabeler streamLabeler;
   };
   PII_D_FUNC;
 };
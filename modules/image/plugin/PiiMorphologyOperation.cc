@@ -52,6 +52,9 @@ void PiiMorphologyOperation::process()
   switch (obj.type())
     {
       PII_GRAY_IMAGE_CASES(morphologyOperation, obj);
+    case PiiYdin::BitMatrixType:
+      morphologyOperation(obj.valueAs<PiiBitMatrix>(), obj);
+      break;
     default:
       PII_THROW_UNKNOWN_TYPE(d->pImageInput);
     }
@@ -59,9 +62,13 @@ void PiiMorphologyOperation::process()
 
 
 template <class T> void PiiMorphologyOperation::morphologyOperation(const PiiVariant& obj)
+{
+  morphologyOperation(obj.valueAs<PiiMatrix<T> >(), obj);
+}
+
+template <class Matrix> void PiiMorphologyOperation::morphologyOperation(const Matrix& image, const PiiVariant& obj)
 {
   PII_D;
-  const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
 
   // Ensure that the image is large enough
   if (image.rows() < d->matMask.rows() || image.columns() < d->matMask.columns())
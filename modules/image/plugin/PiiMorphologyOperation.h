@@ -29,12 +29,15 @@
  *
  * @in image - the input image. Any gray-scale image. Zero is treated
  * as "false". Any value other than zero is considered "true".
+ * Bit-packed binary images (PiiBitMatrix) are processed without
+ * unpacking them.
  *
  * Outputs
  * -------
  *
  * @out image - the image output. Output image is of the same data
  * type as the input image, but contains only ones and zeros.
+ * PiiBitMatrix input produces PiiBitMatrix output.
  *
  */
 class PiiMorphologyOperation : public PiiDefaultOperation
@@ -89,6 +92,7 @@ protected:
 
 private:
   template <class T> void morphologyOperation(const PiiVariant& obj);
+  template <class Matrix> void morphologyOperation(const Matrix& image, const PiiVariant& obj);
 
   void prepareMask();
 
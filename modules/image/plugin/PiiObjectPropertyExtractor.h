@@ -45,6 +45,10 @@
  * @out boundingboxes - The bounding boxes of each object
  * (x,y,width,height). PiiMatrix<int>(N,4).
  *
+ * If the labeled image comes from PiiLabelingOperation, it is faster
+ * to take the properties from its outputs. They are collected while
+ * labeling, without a separate pass over the label image.
+ *
  */
 class PiiObjectPropertyExtractor : public PiiDefaultOperation
 {
@@ -23,7 +23,8 @@ PiiQuantizerOperation::Data::Data() :
   iTrainingPixels(100000),
   iCollectionIndex(0),
   dSelectionProbability(1.0),
-  pCollectedData(0)
+  pCollectedData(0),
+  iTableType(-1)
 {
 }
 
@@ -46,6 +47,7 @@ void PiiQuantizerOperation::setLimits(const QVariantList& limits)
   PiiMatrix<double> limitMat(1, limits.size());
   for (int i=limits.size(); i--; ) limitMat(i) = limits[i].toDouble();
   d->quantizer.setLimits(limitMat);
+  d->iTableType = -1;
 }
 
 QVariantList PiiQuantizerOperation::limits() const
@@ -127,11 +129,41 @@ trainingFinished:
 }
 
 
+template <class U> const PiiMatrix<int>& PiiQuantizerOperation::lookupTable()
+{
+  PII_D;
+  // The table is rebuilt only if the limits or the input type change.
+  if (d->iTableType != int(Pii::typeId<PiiMatrix<U> >()))
+    {
+      d->matTable = d->quantizer.createLookupTable<U>();
+      d->iTableType = Pii::typeId<PiiMatrix<U> >();
+    }
+  return d->matTable;
+}
+
 template <class T, class U> void PiiQuantizerOperation::quantize(const PiiMatrix<U>& img)
 {
   PII_D;
   // Create an empty matrix with the same size as the input.
   PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(img.rows(), img.columns()));
+  // 8 and 16-bit pixels are converted with a lookup table.
+  if (PiiImage::QuantizerTable<U>::size != 0)
+    {
+      const PiiMatrix<int>& matTable = lookupTable<U>();
+      if (!matTable.isEmpty())
+        {
+          const int* pTable = matTable.row(0) + PiiImage::QuantizerTable<U>::offset;
+          for (int r = matResult.rows(); r--; )
+            {
+              const U* sourceRow = img.row(r);
+              T* targetRow = matResult.row(r);
+              for (int c = matResult.columns(); c--; )
+                targetRow[c] = T(pTable[int(sourceRow[c])]);
+            }
+          emitObject(matResult);
+          return;
+        }
+    }
   // Quantize each pixel
   for (int r = matResult.rows(); r--; )
     {
@@ -149,6 +181,7 @@ void PiiQuantizerOperation::learnBoundaries()
   PII_D;
   PiiMatrix<double> data(1, d->iTrainingPixels, d->pCollectedData);
   d->quantizer.setLimits(PiiQuantizer<double>::divideEqually(data, d->iLevels));
+  d->iTableType = -1;
   qDebug("Quantization limits:");
   for (int i=0; i<d->quantizer.limits().columns(); i++)
     qDebug("%lf", d->quantizer.limits()(i));
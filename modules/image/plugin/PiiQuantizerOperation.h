@@ -106,11 +106,15 @@ private:
     double dSelectionProbability;
     PiiQuantizer<double> quantizer;
     double* pCollectedData;
+    // Levels of all values of an 8 or 16-bit input type
+    PiiMatrix<int> matTable;
+    int iTableType;
   };
   PII_D_FUNC;
 
   template <class T> void quantize(const PiiVariant& obj);
   template <class T, class U> void quantize(const PiiMatrix<U>& img);
+  template <class U> const PiiMatrix<int>& lookupTable();
   void learnBoundaries();
 };
 
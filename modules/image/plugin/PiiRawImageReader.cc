@@ -0,0 +1,217 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRawImageReader.h"
+#include <PiiYdinTypes.h>
+#include <PiiMappedFile.h>
+#include <PiiColor.h>
+#include <PiiCamera.h>
+#include "PiiImage.h"
+#include <QFile>
+#include <QtEndian>
+#include <cstring>
+
+namespace
+{
+  // magic, width, height, bitsPerPixel, imageFormat, frameCount
+  enum { HeaderWords = 6, HeaderSize = HeaderWords * 4, RawMagic = 0x31415927 };
+}
+
+PiiRawImageReader::Data::Data() :
+  iRepeatCount(1),
+  pMappedFile(0),
+  iWidth(0), iHeight(0),
+  iFrameCount(0),
+  iBytesPerFrame(0),
+  pixelType(Gray8)
+{
+}
+
+PiiRawImageReader::PiiRawImageReader() :
+  PiiImageReaderOperation(new Data)
+{
+  PII_D;
+  addSocket(d->pIndexOutput = new PiiOutputSocket("index"));
+}
+
+PiiRawImageReader::~PiiRawImageReader()
+{
+  closeFile();
+}
+
+void PiiRawImageReader::check(bool reset)
+{
+  PII_D;
+  PiiImageReaderOperation::check(reset);
+  if (reset || d->pMappedFile == 0)
+    openFile();
+}
+
+void PiiRawImageReader::closeFile()
+{
+  PII_D;
+  // Emitted frames keep their own references to the mapping.
+  if (d->pMappedFile != 0)
+    d->pMappedFile->release();
+  d->pMappedFile = 0;
+  d->iFrameCount = 0;
+}
+
+void PiiRawImageReader::openFile()
+{
+  PII_D;
+  closeFile();
+
+  QFile file(d->strFileName);
+  if (d->strFileName.isEmpty() || !file.open(QIODevice::ReadOnly))
+    PII_THROW(PiiExecutionException, tr("Cannot open \"%1\".").arg(d->strFileName));
+  // The mapping stays valid after the file has been closed.
+  PiiMappedFile* pMappedFile = PiiMappedFile::map(file.handle());
+  file.close();
+  if (pMappedFile == 0)
+    PII_THROW(PiiExecutionException, tr("Cannot map \"%1\" to memory.").arg(d->strFileName));
+
+  quint32 aHeader[HeaderWords];
+  if (pMappedFile->size() < std::size_t(HeaderSize))
+    {
+      pMappedFile->release();
+      PII_THROW(PiiExecutionException, tr("\"%1\" is not a raw image file.").arg(d->strFileName));
+    }
+  std::memcpy(aHeader, pMappedFile->data(), HeaderSize);
+  for (int i=0; i<HeaderWords; ++i)
+    aHeader[i] = qFromLittleEndian(aHeader[i]);
+
+  const int iBitsPerPixel = aHeader[3] & 0xff;
+  const int iFormat = int(aHeader[4]);
+  bool bSupported = true;
+  switch (iFormat)
+    {
+    case PiiCamera::MonoFormat:
+    case PiiCamera::BayerRGGBFormat:
+    case PiiCamera::BayerBGGRFormat:
+    case PiiCamera::BayerGBRGFormat:
+    case PiiCamera::BayerGRBGFormat:
+      bSupported = iBitsPerPixel == 8 || iBitsPerPixel == 16;
+      d->pixelType = iBitsPerPixel == 8 ? Gray8 : Gray16;
+      break;
+    case PiiCamera::BgrFormat:
+      bSupported = iBitsPerPixel == 24 || iBitsPerPixel == 32;
+      d->pixelType = iBitsPerPixel == 24 ? Bgr24 : Bgr32;
+      break;
+    case PiiCamera::RgbFormat:
+      bSupported = iBitsPerPixel == 24 || iBitsPerPixel == 32;
+      d->pixelType = iBitsPerPixel == 24 ? Rgb24 : Rgb32;
+      break;
+    default:
+      bSupported = false;
+    }
+
+  if (aHeader[0] != RawMagic || aHeader[1] == 0 || aHeader[2] == 0 || !bSupported)
+    {
+      pMappedFile->release();
+      PII_THROW(PiiExecutionException,
+                tr("\"%1\" is not a raw image file or its pixel format (%2, %3 bits) is not supported.")
+                .arg(d->strFileName).arg(iFormat).arg(iBitsPerPixel));
+    }
+
+  d->iWidth = int(aHeader[1]);
+  d->iHeight = int(aHeader[2]);
+  d->iBytesPerFrame = std::size_t(d->iWidth) * d->iHeight * (iBitsPerPixel / 8);
+  // The frame count is zero if writing was interrupted before the
+  // header was finished. Trust the file size instead.
+  const int iAvailableFrames = int((pMappedFile->size() - HeaderSize) / d->iBytesPerFrame);
+  const int iStoredFrames = int(aHeader[5]);
+  d->iFrameCount = iStoredFrames > 0 ? qMin(iStoredFrames, iAvailableFrames) : iAvailableFrames;
+  if (d->iFrameCount == 0)
+    {
+      pMappedFile->release();
+      PII_THROW(PiiExecutionException, tr("\"%1\" contains no frames.").arg(d->strFileName));
+    }
+  d->pMappedFile = pMappedFile;
+}
+
+void PiiRawImageReader::process()
+{
+  PII_D;
+  if (!d->pTriggerInput->isConnected())
+    {
+      if ((d->iMaxImages > 0 && d->iCurrentIndex >= d->iMaxImages) ||
+          (d->iRepeatCount > 0 && d->iCurrentIndex >= d->iRepeatCount * d->iFrameCount))
+        operationStopped();
+    }
+
+  const int iFrame = d->iCurrentIndex % d->iFrameCount;
+  const char* pFrame = d->pMappedFile->data() + HeaderSize + d->iBytesPerFrame * iFrame;
+  switch (d->pixelType)
+    {
+    case Gray8: emitFrame(frame<unsigned char>(pFrame)); break;
+    case Gray16: emitFrame(frame<unsigned short>(pFrame)); break;
+    case Bgr24: emitFrame(frame<PiiColor<unsigned char> >(pFrame)); break;
+    case Bgr32: emitFrame(frame<PiiColor4<unsigned char> >(pFrame)); break;
+    case Rgb24: emitFrame(swappedFrame<PiiColor<unsigned char> >(pFrame)); break;
+    case Rgb32: emitFrame(swappedFrame<PiiColor4<unsigned char> >(pFrame)); break;
+    }
+  d->pIndexOutput->emitObject(iFrame);
+
+  if (d->pTriggerInput->isConnected())
+    d->iCurrentIndex = (d->iCurrentIndex + 1) % d->iFrameCount;
+  else
+    ++d->iCurrentIndex;
+}
+
+template <class T> PiiMatrix<T> PiiRawImageReader::frame(const char* data) const
+{
+  const PII_D;
+  return PiiMatrix<T>(d->iHeight, d->iWidth, static_cast<const void*>(data), d->pMappedFile);
+}
+
+template <class T> PiiMatrix<T> PiiRawImageReader::swappedFrame(const char* data) const
+{
+  // PiiColor stores the channels in BGR order.
+  PiiMatrix<T> matFrame(frame<T>(data));
+  for (typename PiiMatrix<T>::iterator it = matFrame.begin(); it != matFrame.end(); ++it)
+    qSwap(it->c0, it->c2);
+  return matFrame;
+}
+
+void PiiRawImageReader::emitFrame(const PiiMatrix<unsigned char>& image)
+{
+  PII_D;
+  if (d->imageType == Color)
+    d->pImageOutput->emitObject(PiiMatrix<PiiColor4<unsigned char> >(image));
+  else
+    d->pImageOutput->emitObject(image);
+}
+
+void PiiRawImageReader::emitFrame(const PiiMatrix<unsigned short>& image)
+{
+  _d()->pImageOutput->emitObject(image);
+}
+
+template <class Clr> void PiiRawImageReader::emitFrame(const PiiMatrix<Clr>& image)
+{
+  PII_D;
+  if (d->imageType == GrayScale)
+    d->pImageOutput->emitObject(PiiImage::toGray(image));
+  else
+    d->pImageOutput->emitObject(image);
+}
+
+void PiiRawImageReader::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
+QString PiiRawImageReader::fileName() const { return _d()->strFileName; }
+void PiiRawImageReader::setRepeatCount(int repeatCount) { _d()->iRepeatCount = repeatCount; }
+int PiiRawImageReader::repeatCount() const { return _d()->iRepeatCount; }
+int PiiRawImageReader::frameCount() const { return _d()->iFrameCount; }
+QSize PiiRawImageReader::frameSize() const { return QSize(_d()->iWidth, _d()->iHeight); }
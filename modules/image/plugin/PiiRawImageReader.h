@@ -0,0 +1,136 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRAWIMAGEREADER_H
+#define _PIIRAWIMAGEREADER_H
+
+#include <QSize>
+#include "PiiImageReaderOperation.h"
+
+class PiiMappedFile;
+
+/**
+ * Reads frames from a raw image sequence without decoding them. The
+ * input file must be in the *praw* format written by
+ * PiiRawImageHandler: a 24-byte header followed by contiguous frames
+ * of pixel data. The whole file is memory-mapped, and each emitted
+ * matrix refers to the mapped data directly. No data is copied, and
+ * the operating system loads pages from disk only when the pixels
+ * are actually accessed. This makes the operation suitable for
+ * replaying long line-scan captures at the maximum speed the rest
+ * of the configuration can handle.
+ *
+ * The emitted matrices are immutable. Modifying one makes a private
+ * copy of its data, and neither the file nor other frames are
+ * affected.
+ *
+ * Monochrome and Bayer-encoded frames are emitted as
+ * `PiiMatrix<unsigned char>` (8 bits per pixel) or
+ * `PiiMatrix<unsigned short>` (16 bits per pixel). BGR frames are
+ * emitted as `PiiMatrix<PiiColor<unsigned char> >` (24 bits) or
+ * `PiiMatrix<PiiColor4<unsigned char> >` (32 bits). RGB frames
+ * need their channels swapped and are therefore copied. If
+ * [imageType] is `GrayScale`, color frames are converted to gray
+ * levels. If it is `Color`, 8-bit gray frames are converted to
+ * four-channel color. Both conversions make a copy.
+ *
+ * Inputs
+ * ------
+ *
+ * @in trigger - an optional trigger input. If this input is
+ * connected, the next frame is emitted whenever any object is
+ * received. The sequence restarts from the beginning after the last
+ * frame, and [repeatCount] and [maxImages] have no effect.
+ *
+ * Outputs
+ * -------
+ *
+ * @out image - the frame
+ *
+ * @out index - the index of the frame in the sequence (int)
+ */
+class PiiRawImageReader : public PiiImageReaderOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the raw image file. A new file name takes effect
+   * when the operation is started from scratch.
+   */
+  Q_PROPERTY(QString fileName READ fileName WRITE setFileName);
+
+  /**
+   * The number of times the sequence is played. 1 means once, < 1
+   * means eternally. The default value is 1.
+   */
+  Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
+
+  /**
+   * The number of frames in the currently opened file, or zero if no
+   * file has been opened.
+   */
+  Q_PROPERTY(int frameCount READ frameCount);
+
+  /**
+   * The size of frames in the currently opened file.
+   */
+  Q_PROPERTY(QSize frameSize READ frameSize);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiRawImageReader();
+  ~PiiRawImageReader();
+
+  void check(bool reset);
+
+protected:
+  void process();
+
+  void setFileName(const QString& fileName);
+  QString fileName() const;
+  void setRepeatCount(int repeatCount);
+  int repeatCount() const;
+  int frameCount() const;
+  QSize frameSize() const;
+
+private:
+  enum PixelType { Gray8, Gray16, Bgr24, Bgr32, Rgb24, Rgb32 };
+
+  void openFile();
+  void closeFile();
+  template <class T> PiiMatrix<T> frame(const char* data) const;
+  template <class T> PiiMatrix<T> swappedFrame(const char* data) const;
+  void emitFrame(const PiiMatrix<unsigned char>& image);
+  void emitFrame(const PiiMatrix<unsigned short>& image);
+  template <class Clr> void emitFrame(const PiiMatrix<Clr>& image);
+
+  /// @internal
+  class Data : public PiiImageReaderOperation::Data
+  {
+  public:
+    Data();
+    QString strFileName;
+    int iRepeatCount;
+    PiiMappedFile* pMappedFile;
+    int iWidth, iHeight;
+    int iFrameCount;
+    std::size_t iBytesPerFrame;
+    PixelType pixelType;
+    PiiOutputSocket* pIndexOutput;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIIRAWIMAGEREADER_H
@@ -47,6 +47,10 @@ namespace PiiImage
    * Reads a ROI object from *input* and handles *image* based on it
    * and *roiType*. Uses *process* to actually perform the image
    * processing operation.
+   *
+   * Rectangles and masks are converted to a RunLengthRoi, which
+   * lets the processor skip the image outside of the ROI instead of
+   * testing each pixel against a full-size mask.
    */
   template <class T, class Processor> void handleRoiInput(PiiInputSocket* input,
                                                           RoiType roiType,
@@ -110,7 +114,7 @@ namespace PiiImage
               }
           }
         else
-          process(image, createRoiMask(iRows, iColumns, matRectangles));
+          process(image, RunLengthRoi::fromRectangles(iRows, iColumns, matRectangles));
       }
     else // roiType = MaskRoi
       {
@@ -120,7 +124,7 @@ namespace PiiImage
                     QCoreApplication::translate("PiiRoi", roiMaskSizeError)
                     .arg(matMask.columns()).arg(matMask.rows())
                     .arg(image.columns()).arg(image.rows()));
-        process(image, matMask);
+        process(image, RunLengthRoi::fromMask(matMask));
       }
   }
 }
@@ -0,0 +1,96 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiTemplateMatchingOperation.h"
+
+#include <PiiYdinTypes.h>
+#include "PiiImageFileReader.h"
+#include "PiiTemplateMatching.h"
+
+PiiTemplateMatchingOperation::Data::Data() :
+  dThreshold(0.7),
+  iMaxMatches(1),
+  iLevelCount(-1),
+  bTemplateConnected(false)
+{
+}
+
+PiiTemplateMatchingOperation::PiiTemplateMatchingOperation() :
+  PiiDefaultOperation(new Data)
+{
+  setThreadCount(1);
+  addSocket(new PiiInputSocket("image"));
+  addSocket(new PiiInputSocket("template"));
+  addSocket(new PiiOutputSocket("matches"));
+  inputAt(1)->setOptional(true);
+}
+
+void PiiTemplateMatchingOperation::check(bool reset)
+{
+  PII_D;
+  d->bTemplateConnected = inputAt(1)->isConnected();
+  if (!d->bTemplateConnected && d->matTemplate.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Template input is not connected and template has not been set."));
+
+  PiiDefaultOperation::check(reset);
+}
+
+void PiiTemplateMatchingOperation::process()
+{
+  PiiVariant obj = readInput();
+
+  switch (obj.type())
+    {
+      PII_GRAY_IMAGE_CASES(match, obj);
+    default:
+      PII_THROW_UNKNOWN_TYPE(inputAt(0));
+    }
+}
+
+template <class T> void PiiTemplateMatchingOperation::match(const PiiVariant& obj)
+{
+  PII_D;
+  const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
+  const PiiMatrix<T> matTemplate(d->bTemplateConnected ?
+                                 PiiYdin::convertMatrixTo<T>(inputAt(1)) :
+                                 PiiMatrix<T>(d->matTemplate));
+  emitObject(PiiImage::findTemplate(PiiImagePyramid<T>::shared(image),
+                                    PiiImagePyramid<T>(matTemplate),
+                                    float(d->dThreshold),
+                                    d->iMaxMatches,
+                                    d->iLevelCount));
+}
+
+void PiiTemplateMatchingOperation::setTemplateFile(const QString& templateFile)
+{
+  PII_D;
+  d->strTemplateFile = templateFile;
+  PiiGrayQImage* pImage = PiiImageFileReader::readGrayImage(templateFile);
+  if (pImage != 0)
+    d->matTemplate = pImage->toMatrix();
+  else
+    {
+      d->matTemplate = PiiMatrix<unsigned char>();
+      piiWarning(tr("Cannot read template image from %1.").arg(templateFile));
+    }
+}
+
+QString PiiTemplateMatchingOperation::templateFile() const { return _d()->strTemplateFile; }
+void PiiTemplateMatchingOperation::setThreshold(double threshold) { _d()->dThreshold = threshold; }
+double PiiTemplateMatchingOperation::threshold() const { return _d()->dThreshold; }
+void PiiTemplateMatchingOperation::setMaxMatches(int maxMatches) { _d()->iMaxMatches = maxMatches < 0 ? -1 : qMax(1, maxMatches); }
+int PiiTemplateMatchingOperation::maxMatches() const { return _d()->iMaxMatches; }
+void PiiTemplateMatchingOperation::setLevelCount(int levelCount) { _d()->iLevelCount = levelCount < 0 ? -1 : qMax(1, levelCount); }
+int PiiTemplateMatchingOperation::levelCount() const { return _d()->iLevelCount; }
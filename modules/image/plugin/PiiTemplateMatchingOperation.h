@@ -0,0 +1,115 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITEMPLATEMATCHINGOPERATION_H
+#define _PIITEMPLATEMATCHINGOPERATION_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiMatrix.h>
+
+/**
+ * Finds a template in gray-level images using normalized
+ * cross-correlation. The search proceeds from coarse to fine over
+ * image pyramids (see PiiImage::findTemplate()). Unlike
+ * PiiTemplateMatcher in the OpenCV plugin, this operation has no
+ * external dependencies.
+ *
+ * Inputs
+ * ------
+ *
+ * @in image - the input image. Any gray-level image.
+ *
+ * @in template - an optional template image. If this input is
+ * connected, the template is read from it together with each image.
+ * Otherwise, the template is loaded from [templateFile]. The template
+ * is converted to the type of the input image.
+ *
+ * Outputs
+ * -------
+ *
+ * @out matches - an N-by-3 PiiMatrix<float> in which each row stores
+ * the (x,y) coordinates of the top left corner of a match and its
+ * correlation, in descending order of correlation. If the template is
+ * larger than the image, an empty matrix will be emitted.
+ *
+ */
+class PiiTemplateMatchingOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the template file. Set this property to load the
+   * template from a file.
+   */
+  Q_PROPERTY(QString templateFile READ templateFile WRITE setTemplateFile);
+
+  /**
+   * The minimum correlation of a match, in [-1,1]. The default is
+   * 0.7.
+   */
+  Q_PROPERTY(double threshold READ threshold WRITE setThreshold);
+
+  /**
+   * The maximum number of matches to emit. -1 means all matches
+   * above [threshold]. The default is one.
+   */
+  Q_PROPERTY(int maxMatches READ maxMatches WRITE setMaxMatches);
+
+  /**
+   * The maximum number of pyramid levels to use in the search. The
+   * pyramid is shared with other operations that build a Gaussian
+   * pyramid out of the same image. One means an exhaustive search on
+   * the original image. The default is -1, which uses as many levels
+   * as the size of the template allows.
+   */
+  Q_PROPERTY(int levelCount READ levelCount WRITE setLevelCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiTemplateMatchingOperation();
+
+  void check(bool reset);
+
+  void setTemplateFile(const QString& templateFile);
+  QString templateFile() const;
+  void setThreshold(double threshold);
+  double threshold() const;
+  void setMaxMatches(int maxMatches);
+  int maxMatches() const;
+  void setLevelCount(int levelCount);
+  int levelCount() const;
+
+protected:
+  void process();
+
+private:
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+    QString strTemplateFile;
+    PiiMatrix<unsigned char> matTemplate;
+    double dThreshold;
+    int iMaxMatches;
+    int iLevelCount;
+    bool bTemplateConnected;
+  };
+  PII_D_FUNC;
+
+  template <class T> void match(const PiiVariant& obj);
+};
+
+#endif //_PIITEMPLATEMATCHINGOPERATION_H
@@ -26,7 +26,8 @@ PiiThresholdingOperation::Data::Data() :
   thresholdType(StaticThreshold),
   bThresholdConnected(false),
   bInverse(false),
-  windowSize(15,15)
+  windowSize(15,15),
+  bPacked(false)
 {
 }
 
@@ -87,6 +88,15 @@ template <class T> void PiiThresholdingOperation::thresholdGray(const PiiVariant
 
 
 
+template <class T> void PiiThresholdingOperation::emitBinaryImage(const PiiMatrix<T>& image)
+{
+  PII_D;
+  if (d->bPacked)
+    d->pBinaryImageOutput->emitObject(PiiBitMatrix::fromMatrix(image));
+  else
+    d->pBinaryImageOutput->emitObject(image);
+}
+
 template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>& image)
 {
   PII_D;
@@ -153,11 +163,11 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           {
             double otherThreshold = d->dAbsoluteThreshold + d->dRelativeThreshold;
             if (!d->bInverse)
-              d->pBinaryImageOutput->emitObject(Pii::matrix(image.mapped(
+              emitBinaryImage(Pii::matrix(image.mapped(
                 PiiImage::TwoLevelThresholdFunction<T>(T(qMin(d->dAbsoluteThreshold, otherThreshold)),
                                                        T(qMax(d->dAbsoluteThreshold, otherThreshold))))));
             else
-              d->pBinaryImageOutput->emitObject(Pii::matrix(image.mapped(
+              emitBinaryImage(Pii::matrix(image.mapped(
                 PiiImage::InverseTwoLevelThresholdFunction<T>(T(qMin(d->dAbsoluteThreshold, otherThreshold)),
                                                               T(qMax(d->dAbsoluteThreshold, otherThreshold))))));
           }
@@ -165,24 +175,24 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           return;
         case HysteresisThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::hysteresisThreshold(image,
+            emitBinaryImage(PiiImage::hysteresisThreshold(image,
                                                                             T(d->dAbsoluteThreshold - d->dRelativeThreshold),
                                                                             T(d->dAbsoluteThreshold)));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::inverseHysteresisThreshold(image,
+            emitBinaryImage(PiiImage::inverseHysteresisThreshold(image,
                                                                                    T(d->dAbsoluteThreshold - d->dRelativeThreshold),
                                                                                    T(d->dAbsoluteThreshold)));
           d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
           return;
         case RelativeToMeanAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThreshold(image,
+            emitBinaryImage(PiiImage::adaptiveThreshold(image,
                                                                           PiiImage::ThresholdFunction<T>(),
                                                                           float(d->dRelativeThreshold),
                                                                           float(d->dAbsoluteThreshold),
                                                                           d->windowSize.height(), d->windowSize.width()));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThreshold(image,
+            emitBinaryImage(PiiImage::adaptiveThreshold(image,
                                                                           PiiImage::InverseThresholdFunction<T>(),
                                                                           float(d->dRelativeThreshold),
                                                                           float(d->dAbsoluteThreshold),
@@ -191,14 +201,14 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           return;
         case MeanStdAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
+            emitBinaryImage(PiiImage::adaptiveThresholdVar(image,
                                                                              PiiImage::meanStdThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
                                                                                                                 std::bind2nd(std::minus<double>(),
                                                                                                                              d->dAbsoluteThreshold),
                                                                                                                 d->dRelativeThreshold),
                                                                              d->windowSize.height(), d->windowSize.width()));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
+            emitBinaryImage(PiiImage::adaptiveThresholdVar(image,
                                                                              PiiImage::meanStdThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
                                                                                                                 std::bind2nd(std::minus<double>(),
                                                                                                                              d->dAbsoluteThreshold),
@@ -208,14 +218,14 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           return;
         case SauvolaAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
+            emitBinaryImage(PiiImage::adaptiveThresholdVar(image,
                                                                              PiiImage::sauvolaThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
                                                                                                                 std::bind2nd(std::minus<double>(),
                                                                                                                              d->dAbsoluteThreshold),
                                                                                                                 d->dRelativeThreshold),
                                                                              d->windowSize.height(), d->windowSize.width()));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
+            emitBinaryImage(PiiImage::adaptiveThresholdVar(image,
                                                                              PiiImage::sauvolaThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
                                                                                                                 std::bind2nd(std::minus<double>(),
                                                                                                                              d->dAbsoluteThreshold),
@@ -227,7 +237,14 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
 
     }
 
-  if (!d->bInverse)
+  if (d->bPacked)
+    {
+      if (!d->bInverse)
+        d->pBinaryImageOutput->emitObject(PiiImage::thresholdBits(image, T(threshold)));
+      else
+        d->pBinaryImageOutput->emitObject(PiiImage::inverseThresholdBits(image, T(threshold)));
+    }
+  else if (!d->bInverse)
     d->pBinaryImageOutput->emitObject(PiiImage::threshold(image, T(threshold)));
   else
     d->pBinaryImageOutput->emitObject(PiiImage::inverseThreshold(image, T(threshold)));
@@ -245,3 +262,5 @@ void PiiThresholdingOperation::setInverse(bool inverse) { _d()->bInverse = inver
 bool PiiThresholdingOperation::isInverse() const { return _d()->bInverse; }
 void PiiThresholdingOperation::setWindowSize(const QSize& windowSize) { _d()->windowSize = windowSize; }
 QSize PiiThresholdingOperation::windowSize() const { return _d()->windowSize; }
+void PiiThresholdingOperation::setPacked(bool packed) { _d()->bPacked = packed; }
+bool PiiThresholdingOperation::isPacked() const { return _d()->bPacked; }
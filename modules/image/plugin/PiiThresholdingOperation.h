@@ -48,6 +48,9 @@
  * `HysteresisThreshold` is in use, the output will always be a
  * PiiMatrix<int>.
  *
+ * If [packed] is `true`, the output will be a PiiBitMatrix
+ * irrespective of the input type.
+ *
  * @out threshold - the value of the threshold. (`double`)
  *
  */
@@ -89,6 +92,15 @@ class PiiThresholdingOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(QSize windowSize READ windowSize WRITE setWindowSize);
 
+  /**
+   * Emit bit-packed binary images. If this value is set to `true`,
+   * the binary image will be emitted as a PiiBitMatrix. Morphology
+   * and labeling operations process packed images considerably
+   * faster than byte images, and they take one eighth of the memory.
+   * The default is `false`.
+   */
+  Q_PROPERTY(bool packed READ isPacked WRITE setPacked);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -203,6 +215,8 @@ public:
   bool isInverse() const;
   void setWindowSize(const QSize& windowSize);
   QSize windowSize() const;
+  void setPacked(bool packed);
+  bool isPacked() const;
 
 protected:
   void process();
@@ -211,6 +225,7 @@ private:
   template <class T> void thresholdColor(const PiiVariant& obj);
   template <class T> void thresholdGray(const PiiVariant& obj);
   template <class T> void threshold(const PiiMatrix<T>& image);
+  template <class T> void emitBinaryImage(const PiiMatrix<T>& image);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -226,6 +241,7 @@ private:
     PiiOutputSocket* pBinaryImageOutput, *pThresholdOutput;
     bool bInverse;
     QSize windowSize;
+    bool bPacked;
   };
   PII_D_FUNC;
 };
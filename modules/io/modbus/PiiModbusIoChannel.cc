@@ -38,7 +38,12 @@ bool PiiModbusIoChannel::currentState() const
 
   int res = 0;
   if (mode == Input)
-    res = driver()->readInputBits(d->iAddress, 1, &bits);
+    {
+      // Use the result of a combined read if available.
+      if (driver()->cachedInputBit(d->iAddress, &bits))
+        return bits == 1;
+      res = driver()->readInputBits(d->iAddress, 1, &bits);
+    }
   else
     res = driver()->readBits(d->iAddress, 1, &bits);
 
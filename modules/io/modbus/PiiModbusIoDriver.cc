@@ -16,13 +16,17 @@
 #include "PiiModbusIoDriver.h"
 #include <PiiModbusIoChannel.h>
 #include <errno.h>
+#include <algorithm>
+#include <climits>
 
 PiiModbusIoDriver::InstanceList PiiModbusIoDriver::_lstInstances;
 QMutex PiiModbusIoDriver::_instanceMutex;
 
 PiiModbusIoDriver::Data::Data() :
   pHandle(0),
-  strUnit("")
+  strUnit(""),
+  bInputCacheValid(false),
+  iInputCacheAddress(0)
 {
 }
 
@@ -216,3 +220,123 @@ int PiiModbusIoDriver::writeBit(int addr, int status)
   PII_D;
   return d->pHandle ? modbus_write_bit(d->pHandle, addr, status) : -1;
 }
+
+int PiiModbusIoDriver::writeBits(int addr, int nb, const uint8_t *src)
+{
+  QMutexLocker lock(&_instanceMutex);
+  PII_D;
+  return d->pHandle ? modbus_write_bits(d->pHandle, addr, nb, src) : -1;
+}
+
+bool PiiModbusIoDriver::cachedInputBit(int addr, uint8_t *dest) const
+{
+  const PII_D;
+  int iIndex = addr - d->iInputCacheAddress;
+  if (!d->bInputCacheValid || iIndex < 0 || iIndex >= d->vecInputCache.size())
+    return false;
+  *dest = d->vecInputCache[iIndex];
+  return true;
+}
+
+void PiiModbusIoDriver::checkInputs(const QList<PiiIoChannel*>& channels)
+{
+  PII_D;
+  int iMinAddress = INT_MAX, iMaxAddress = -1;
+  for (int i=0; i<channels.size(); ++i)
+    {
+      PiiModbusIoChannel *pChannel = static_cast<PiiModbusIoChannel*>(channels[i]);
+      if (pChannel->channelMode() == PiiDefaultIoChannel::Input && pChannel->address() >= 0)
+        {
+          iMinAddress = qMin(iMinAddress, pChannel->address());
+          iMaxAddress = qMax(iMaxAddress, pChannel->address());
+        }
+    }
+
+  // Read the whole address range at once. If this fails, the channels
+  // will read their states one by one and report errors themselves.
+  if (iMaxAddress >= iMinAddress)
+    {
+      int iCount = iMaxAddress - iMinAddress + 1;
+      d->vecInputCache.resize(iCount);
+      d->iInputCacheAddress = iMinAddress;
+      bool bSuccess = true;
+      for (int i=0; i<iCount && bSuccess; i += MODBUS_MAX_READ_BITS)
+        {
+          int iBits = qMin(iCount - i, (int)MODBUS_MAX_READ_BITS);
+          bSuccess = readInputBits(iMinAddress + i, iBits, d->vecInputCache.data() + i) == iBits;
+        }
+      d->bInputCacheValid = bSuccess;
+    }
+
+  PiiDefaultIoDriver::checkInputs(channels);
+  d->bInputCacheValid = false;
+}
+
+namespace
+{
+  struct OutputBit
+  {
+    int iAddress;
+    PiiIoChannel *pChannel;
+    uint8_t value;
+    bool operator< (const OutputBit& other) const { return iAddress < other.iAddress; }
+  };
+}
+
+void PiiModbusIoDriver::setOutputStates(const QList<PiiIoChannel*>& channels, const QList<bool>& states)
+{
+  QList<PiiIoChannel*> lstSeparate;
+  QList<bool> lstSeparateStates;
+  QVector<OutputBit> vecBits;
+  for (int i=0; i<channels.size(); ++i)
+    {
+      PiiModbusIoChannel *pChannel = static_cast<PiiModbusIoChannel*>(channels[i]);
+      if (pChannel->channelMode() == PiiDefaultIoChannel::Output && pChannel->address() >= 0)
+        {
+          OutputBit bit = { pChannel->address(), pChannel, uint8_t(states[i] ? 1 : 0) };
+          vecBits << bit;
+        }
+      else
+        {
+          lstSeparate << channels[i];
+          lstSeparateStates << states[i];
+        }
+    }
+
+  // stable_sort retains the order of transitions to the same address.
+  std::stable_sort(vecBits.begin(), vecBits.end());
+
+  QVector<uint8_t> vecValues;
+  for (int iStart = 0; iStart < vecBits.size(); )
+    {
+      // Collect a run of consecutive addresses. If the same address
+      // appears many times, the last state wins.
+      vecValues.clear();
+      vecValues << vecBits[iStart].value;
+      int iEnd = iStart + 1;
+      for (; iEnd < vecBits.size() && vecValues.size() < MODBUS_MAX_WRITE_BITS; ++iEnd)
+        {
+          int iOffset = vecBits[iEnd].iAddress - vecBits[iStart].iAddress;
+          if (iOffset == vecValues.size() - 1)
+            vecValues.last() = vecBits[iEnd].value;
+          else if (iOffset == vecValues.size())
+            vecValues << vecBits[iEnd].value;
+          else
+            break;
+        }
+
+      if (writeBits(vecBits[iStart].iAddress, vecValues.size(), vecValues.data()) != vecValues.size())
+        {
+          // Retry one by one so that failures are reported per channel.
+          for (int i=iStart; i<iEnd; ++i)
+            {
+              lstSeparate << vecBits[i].pChannel;
+              lstSeparateStates << (vecBits[i].value != 0);
+            }
+        }
+      iStart = iEnd;
+    }
+
+  if (!lstSeparate.isEmpty())
+    PiiDefaultIoDriver::setOutputStates(lstSeparate, lstSeparateStates);
+}
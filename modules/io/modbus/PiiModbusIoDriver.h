@@ -28,6 +28,10 @@ class PiiModbusIoChannel;
  * An implementation of the PiiIoChannel-interface for Modbus I/O
  * driver.
  *
+ * Polled inputs are read with one request per contiguous block of
+ * addresses, and outputs that change at the same time are written
+ * with one request per contiguous block. To benefit from this, assign
+ * neighboring addresses to channels that are used together.
  */
 class PII_MODBUSIODRIVER_EXPORT PiiModbusIoDriver : public PiiDefaultIoDriver
 {
@@ -80,6 +84,9 @@ protected:
    */
   PiiIoChannel* createChannel(int channel);
 
+  void checkInputs(const QList<PiiIoChannel*>& channels);
+  void setOutputStates(const QList<PiiIoChannel*>& channels, const QList<bool>& states);
+
 private:
   /// @internal
   class Data : public PiiDefaultIoDriver::Data
@@ -89,6 +96,10 @@ private:
 
     modbus_t *pHandle;
     QString strUnit;
+    // Input bits read in one request during checkInputs().
+    bool bInputCacheValid;
+    int iInputCacheAddress;
+    QVector<uint8_t> vecInputCache;
   };
   PII_D_FUNC;
 
@@ -113,6 +124,8 @@ private:
   int readInputBits(int addr, int nb, uint8_t *dest);
   int readBits(int addr, int nb, uint8_t *dest);
   int writeBit(int addr, int status);
+  int writeBits(int addr, int nb, const uint8_t *src);
+  bool cachedInputBit(int addr, uint8_t *dest) const;
 
   typedef QList<Instance> InstanceList;
   template <class T> static InstanceList::iterator findInstance(const T& value);
@@ -15,8 +15,6 @@
 
 #include "PiiDefaultIoChannel.h"
 #include "PiiDefaultIoDriver.h"
-#include <QDateTime>
-#include <QTime>
 
 PiiDefaultIoChannel::Data::Data() :
   pDriver(0),
@@ -102,8 +100,8 @@ void PiiDefaultIoChannel::activate()
 {
   if (d->pDriver != 0 && d->channelMode == Output)
     {
-      qint64 time = QDateTime::currentDateTime().addMSecs(d->iPulseDelay).toMSecsSinceEpoch();
-      d->pDriver->sendSignal(this, d->bActiveState, time, d->iPulseWidth);
+      qint64 time = PiiIoThread::currentTime() + qint64(d->iPulseDelay) * 1000;
+      d->pDriver->sendSignal(this, d->bActiveState, time, qint64(d->iPulseWidth) * 1000);
     }
 }
 
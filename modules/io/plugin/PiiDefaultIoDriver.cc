@@ -69,11 +69,8 @@ PiiDefaultIoDriver::~PiiDefaultIoDriver()
 
       if (_iInstanceCounter == 0)
         {
-          if (_pSendingThread->isRunning())
-            {
-              _pSendingThread->stop();
-              while(!_pSendingThread->isFinished());
-            }
+          _pSendingThread->stop();
+          _pSendingThread->wait();
           delete _pSendingThread;
           _pSendingThread = 0;
         }
@@ -91,10 +88,73 @@ void PiiDefaultIoDriver::reconnect(PiiIoChannel* channel, const QString& message
     emit connectionLost();
 }
 
-void PiiDefaultIoDriver::sendSignal(PiiIoChannel *channel, bool value, qint64 time, int pulseWidth)
+void PiiDefaultIoDriver::sendSignal(PiiIoChannel *channel, bool value, qint64 time, qint64 pulseWidth)
 {
   if (_pSendingThread != 0)
-    _pSendingThread->sendSignal(channel,value,time,pulseWidth);
+    _pSendingThread->sendSignal(this,channel,value,time,pulseWidth);
+}
+
+void PiiDefaultIoDriver::checkInputs(const QList<PiiIoChannel*>& channels)
+{
+  for (int i=0; i<channels.size(); ++i)
+    {
+      try
+        {
+          channels[i]->checkInputState();
+        }
+      catch (PiiException&)
+        {
+        }
+    }
+}
+
+void PiiDefaultIoDriver::setOutputStates(const QList<PiiIoChannel*>& channels, const QList<bool>& states)
+{
+  for (int i=0; i<channels.size(); ++i)
+    {
+      try
+        {
+          channels[i]->setOutputState(states[i]);
+        }
+      catch (PiiException&)
+        {
+        }
+    }
+}
+
+void PiiDefaultIoDriver::setPollingInterval(int pollingInterval)
+{
+  if (_pSendingThread != 0)
+    _pSendingThread->setPollingInterval(pollingInterval);
+}
+
+int PiiDefaultIoDriver::pollingInterval() const
+{
+  return _pSendingThread != 0 ? _pSendingThread->pollingInterval() : 0;
+}
+
+void PiiDefaultIoDriver::setBusyWaitThreshold(int busyWaitThreshold)
+{
+  if (_pSendingThread != 0)
+    _pSendingThread->setBusyWaitThreshold(busyWaitThreshold);
+}
+
+int PiiDefaultIoDriver::busyWaitThreshold() const
+{
+  return _pSendingThread != 0 ? _pSendingThread->busyWaitThreshold() : 0;
+}
+
+QVariantMap PiiDefaultIoDriver::outputLatency() const
+{
+  QVariantMap mapResult;
+  if (_pSendingThread != 0)
+    {
+      PiiIoThread::LatencyStatistics statistics = _pSendingThread->latencyStatistics();
+      mapResult["transitionCount"] = statistics.transitionCount;
+      mapResult["averageLatency"] = statistics.averageLatency;
+      mapResult["maxLatency"] = statistics.maxLatency;
+    }
+  return mapResult;
 }
 
 PiiIoChannel* PiiDefaultIoDriver::channel(int channel)
@@ -126,7 +186,7 @@ int PiiDefaultIoDriver::channelCount() const
 void PiiDefaultIoDriver::addPollingInput(PiiIoChannel *input)
 {
   if (_pSendingThread)
-    _pSendingThread->addPollingInput(input);
+    _pSendingThread->addPollingInput(this, input);
 }
 void PiiDefaultIoDriver::removePollingInput(PiiIoChannel *input)
 {
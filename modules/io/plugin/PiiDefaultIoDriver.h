@@ -20,16 +20,47 @@
 #include "PiiIoThread.h"
 #include "PiiIoDriverException.h"
 #include <QVector>
+#include <QVariantMap>
 
 class PiiDefaultIoChannel;
 
 /**
  * The default implementation of the PiiIoDriver-interface for input/output drivers.
  *
+ * All instances share one I/O thread that schedules output pulses
+ * and polls inputs. Thus, the timing properties affect all
+ * instances.
  */
 class PII_IO_EXPORT PiiDefaultIoDriver : public PiiIoDriver
 {
   Q_OBJECT
+
+  /**
+   * The interval between successive reads of input channels, in
+   * microseconds. The default value is 10000.
+   */
+  Q_PROPERTY(int pollingInterval READ pollingInterval WRITE setPollingInterval STORED false);
+
+  /**
+   * The I/O thread sleeps until the next output transition is due.
+   * Waking up from sleep typically takes some tens of microseconds
+   * but may take more than a millisecond on a loaded system. If the
+   * time to the next transition is less than this many microseconds,
+   * the thread spins instead of sleeping. Spinning makes the timing
+   * accurate to a few microseconds but keeps one processor core
+   * busy. The default value is 0, which disables spinning.
+   */
+  Q_PROPERTY(int busyWaitThreshold READ busyWaitThreshold WRITE setBusyWaitThreshold STORED false);
+
+  /**
+   * Statistics on the difference between the scheduled and actual
+   * times of output transitions. The map contains
+   * `transitionCount`, `averageLatency` and `maxLatency`. Times are
+   * in microseconds and include the time taken by the driver to
+   * write the output.
+   */
+  Q_PROPERTY(QVariantMap outputLatency READ outputLatency STORED false);
+
 public:
   ~PiiDefaultIoDriver();
 
@@ -46,12 +77,39 @@ public:
    */
   int channelCount() const;
 
+  void setPollingInterval(int pollingInterval);
+  int pollingInterval() const;
+  void setBusyWaitThreshold(int busyWaitThreshold);
+  int busyWaitThreshold() const;
+  QVariantMap outputLatency() const;
+
 protected:
   /**
    * Create a PiiIoChannel depends on given channel-index.
    */
   virtual PiiIoChannel* createChannel(int channel) = 0;
 
+  /**
+   * Checks the states of polled input channels. The I/O thread calls
+   * this function periodically with all polled inputs of this driver.
+   * Drivers that can read many channels in one transaction should
+   * override this function, read all channels at once and then call
+   * the default implementation. The default implementation calls
+   * PiiIoChannel::checkInputState() for each channel and ignores
+   * errors.
+   */
+  virtual void checkInputs(const QList<PiiIoChannel*>& channels);
+
+  /**
+   * Changes the states of many output channels at once. The I/O
+   * thread calls this function with all transitions that are due at
+   * the same time. Drivers that can write many channels in one
+   * transaction should override this function. The default
+   * implementation calls PiiIoChannel::setOutputState() for each
+   * channel and ignores errors.
+   */
+  virtual void setOutputStates(const QList<PiiIoChannel*>& channels, const QList<bool>& states);
+
   class Data
   {
   public:
@@ -69,6 +127,7 @@ private slots:
 
 private:
   friend class PiiDefaultIoChannel;
+  friend class PiiIoThread;
 
   void init();
 
@@ -77,10 +136,10 @@ private:
    *
    * @param channel - the pointer to the output-channel
    * @param value - true = on, false = off
-   * @param time - msecs from 1970-01-01T00:00:00.000
-   * @param pulseWidth - pulse width in msecs.
+   * @param time - usecs as given by PiiIoThread::currentTime()
+   * @param pulseWidth - pulse width in usecs.
    */
-  void sendSignal(PiiIoChannel *channel, bool value, qint64 time, int pulseWidth);
+  void sendSignal(PiiIoChannel *channel, bool value, qint64 time, qint64 pulseWidth);
 
   /**
    * Add the input channel in the polling input list.
@@ -16,6 +16,7 @@
 #include "PiiIoInputOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiTimer.h>
 
 PiiIoInputOperation::Data::Data()
 {
@@ -58,6 +59,7 @@ void PiiIoInputOperation::sendSignal(bool state)
 {
   PII_D;
   int iChannel = d->lstChannels.indexOf(static_cast<PiiIoChannel*>(sender()));
+  PiiYdin::setCurrentOriginTime(PiiTimer::timestamp());
   d->pChannelOutput->emitObject(iChannel);
   emitObject(iChannel + 1, state);
 }
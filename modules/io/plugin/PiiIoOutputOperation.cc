@@ -16,9 +16,11 @@
 #include "PiiIoOutputOperation.h"
 
 #include <PiiYdinTypes.h>
+#include <PiiTimer.h>
 #include "PiiIoDriverException.h"
 
-PiiIoOutputOperation::Data::Data()
+PiiIoOutputOperation::Data::Data() :
+  iLatencyDeadline(0)
 {
 }
 
@@ -36,6 +38,66 @@ PiiIoOutputOperation::~PiiIoOutputOperation()
 {
 }
 
+void PiiIoOutputOperation::check(bool reset)
+{
+  PiiIoOperation::check(reset);
+
+  PII_D;
+  QMutexLocker lock(&d->latencyMutex);
+  const int iChannels = d->lstChannels.size();
+  d->vecPulseDelays.resize(iChannels);
+  for (int i=0; i<iChannels; ++i)
+    d->vecPulseDelays[i] = qint64(qMax(0, d->lstChannels[i]->property("pulseDelay").toInt())) * 1000;
+  if (reset || d->vecLatencies.size() != iChannels)
+    {
+      d->vecLatencies.fill(PiiLatencyHistogram(), iChannels);
+      d->vecDeadlineMisses.fill(0, iChannels);
+    }
+}
+
+void PiiIoOutputOperation::setLatencyDeadline(int latencyDeadline) { _d()->iLatencyDeadline = qMax(0, latencyDeadline); }
+int PiiIoOutputOperation::latencyDeadline() const { return _d()->iLatencyDeadline; }
+
+QVariantList PiiIoOutputOperation::latencyStatistics() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->latencyMutex);
+  QVariantList lstStatistics;
+  for (int i=0; i<d->vecLatencies.size(); ++i)
+    {
+      QVariantMap mapStatistics(d->vecLatencies[i].toMap());
+      mapStatistics["deadlineMisses"] = d->vecDeadlineMisses[i];
+      lstStatistics << mapStatistics;
+    }
+  return lstStatistics;
+}
+
+void PiiIoOutputOperation::resetLatencyStatistics()
+{
+  PII_D;
+  QMutexLocker lock(&d->latencyMutex);
+  for (int i=0; i<d->vecLatencies.size(); ++i)
+    {
+      d->vecLatencies[i].clear();
+      d->vecDeadlineMisses[i] = 0;
+    }
+}
+
+void PiiIoOutputOperation::recordLatency(int channel)
+{
+  PII_D;
+  qint64 iOriginTime = PiiYdin::currentOriginTime();
+  if (iOriginTime == 0)
+    return;
+  QMutexLocker lock(&d->latencyMutex);
+  if (channel >= d->vecLatencies.size())
+    return;
+  qint64 iLatency = PiiTimer::timestamp() - iOriginTime + d->vecPulseDelays[channel];
+  d->vecLatencies[channel].add(iLatency);
+  if (d->iLatencyDeadline > 0 && iLatency > qint64(d->iLatencyDeadline) * 1000)
+    ++d->vecDeadlineMisses[channel];
+}
+
 QVariantList PiiIoOutputOperation::pulseWidths() const
 {
   const PII_D;
@@ -82,6 +144,7 @@ void PiiIoOutputOperation::activateChannel(int channel)
           try
             {
               d->lstChannels[channel]->activate();
+              recordLatency(channel);
               return;
             }
           catch (PiiIoDriverException &ex)
@@ -18,6 +18,9 @@
 
 #include "PiiIoOperation.h"
 
+#include <PiiLatencyHistogram.h>
+#include <QVector>
+
 /**
  * An operation that controls digital output channels based on input.
  *
@@ -36,6 +39,15 @@
  * Connecting this input makes it possible to selectively
  * enable/disable I/O signals at run time.
  *
+ * Latency
+ * -------
+ *
+ * Each activation is tagged with the end-to-end latency from the
+ * [origin](PiiYdin::currentOriginTime()) of the received objects
+ * (typically a camera frame or a trigger) to the moment the output
+ * pulse starts, including the channel's `pulseDelay`. The latencies
+ * are collected per channel and reported by [latencyStatistics].
+ * Activations whose origin is unknown are not measured.
  */
 class PiiIoOutputOperation : public PiiIoOperation
 {
@@ -47,24 +59,53 @@ class PiiIoOutputOperation : public PiiIoOperation
    */
   Q_PROPERTY(QVariantList pulseWidths READ pulseWidths);
 
+  /**
+   * The maximum allowed latency from origin to actuation, in
+   * milliseconds. Activations later than this are counted as
+   * deadline misses in [latencyStatistics]. Zero (the default)
+   * disables deadline checking.
+   */
+  Q_PROPERTY(int latencyDeadline READ latencyDeadline WRITE setLatencyDeadline);
+
+  /**
+   * Latency statistics for each output channel. Each entry in the
+   * list is a map that contains `count`, `mean`, `median`, `p90`,
+   * `p99`, `p999` and `max` (see PiiLatencyHistogram::toMap()) and
+   * `deadlineMisses`, the number of activations that exceeded
+   * [latencyDeadline]. All times are in microseconds. The statistics
+   * are cleared when the operation is reset.
+   */
+  Q_PROPERTY(QVariantList latencyStatistics READ latencyStatistics STORED false);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiIoOutputOperation();
   ~PiiIoOutputOperation();
 
+  void check(bool reset);
+
 public slots:
   /**
    * Sets the state of *channel* to *value*.
    */
   void setChannelState(int channel, bool value);
 
+  /**
+   * Clears [latencyStatistics].
+   */
+  void resetLatencyStatistics();
+
 protected:
   void process();
 
   QVariantList pulseWidths() const;
+  void setLatencyDeadline(int latencyDeadline);
+  int latencyDeadline() const;
+  QVariantList latencyStatistics() const;
 
 private:
   void activateChannel(int channel);
+  void recordLatency(int channel);
 
   /// @internal
   class Data : public PiiIoOperation::Data
@@ -73,6 +114,12 @@ private:
     Data();
 
     PiiInputSocket *pChannelInput, *pValueInput;
+    int iLatencyDeadline;
+    // Per-channel pulse delays in microseconds, cached at check().
+    QVector<qint64> vecPulseDelays;
+    QVector<PiiLatencyHistogram> vecLatencies;
+    QVector<qint64> vecDeadlineMisses;
+    mutable QMutex latencyMutex;
   };
   PII_D_FUNC;
 };
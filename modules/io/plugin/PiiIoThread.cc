@@ -12,129 +12,267 @@
  * to use Into as a part of open source software projects. Please
  * refer to LICENSE.AGPL3 for details.
  */
-
 #include "PiiIoThread.h"
-#include <PiiDelay.h>
-#include <QDateTime>
+#include "PiiDefaultIoDriver.h"
 #include "PiiIoDriverException.h"
 
-PiiIoThread::PiiIoThread(QObject *parent) : QThread(parent), _bRunning(true)
+#include <PiiAsyncCall.h>
+#include <PiiDelay.h>
+#include <PiiTimer.h>
+
+PiiIoThread::PiiIoThread(QObject *parent) :
+  QThread(parent),
+  _bRunning(true),
+  _bQueueChanged(false),
+  _iBusyWaitThreshold(0),
+  _iTransitionCount(0),
+  _iTotalLatency(0),
+  _iMaxLatency(0),
+  _pPollingThread(0),
+  _iPollingInterval(10000)
+{
+}
+
+PiiIoThread::~PiiIoThread()
 {
+  stop();
+  wait();
+}
+
+qint64 PiiIoThread::currentTime()
+{
+  static PiiTimer timer;
+  return timer.microseconds();
+}
+
+void PiiIoThread::stop()
+{
+  synchronized (_mutex)
+    {
+      _bRunning = false;
+      _outputCondition.wakeAll();
+    }
+  synchronized (_pollMutex)
+    _pollCondition.wakeAll();
 }
 
 void PiiIoThread::run()
 {
   setPriority(TimeCriticalPriority);
+
+  _pPollingThread = Pii::createAsyncCall(this, &PiiIoThread::poll);
+  _pPollingThread->start();
+
+  QMutexLocker lock(&_mutex);
   while (_bRunning)
     {
-      _mutex.lock();
+      _bQueueChanged = false;
+      if (_lstWaitingOutputSignals.isEmpty())
+        _outputCondition.wait(&_mutex);
+      else
+        waitUntil(_lstWaitingOutputSignals.first().time);
 
-      for (int i=_lstPollingInputs.size(); i--; )
+      if (_bRunning)
+        handleDueOutputs();
+    }
+  lock.unlock();
+
+  _pPollingThread->wait();
+  delete _pPollingThread;
+  _pPollingThread = 0;
+}
+
+void PiiIoThread::waitUntil(qint64 time)
+{
+  // Called with _mutex locked. Returns when the time has been
+  // reached or the queue has been changed.
+  while (_bRunning && !_bQueueChanged)
+    {
+      qint64 iRemaining = time - currentTime();
+      if (iRemaining <= 0)
+        return;
+      if (iRemaining > _iBusyWaitThreshold + 1000)
+        _outputCondition.wait(&_mutex, (unsigned long)(iRemaining - _iBusyWaitThreshold) / 1000);
+      else
         {
-          try
-            {
-              _lstPollingInputs[i]->checkInputState();
-            }
-          catch (PiiException &ex)
-            {
-            }
+          int iBusyWaitThreshold = _iBusyWaitThreshold;
+          _mutex.unlock();
+          if (iRemaining > iBusyWaitThreshold)
+            PiiDelay::usleep(int(iRemaining - iBusyWaitThreshold));
+          else
+            while (currentTime() < time) ;
+          _mutex.lock();
         }
+    }
+}
+
+void PiiIoThread::handleDueOutputs()
+{
+  // Called with _mutex locked.
+  qint64 iNow = currentTime();
+  QList<OutputSignal> lstDue;
+  while (!_lstWaitingOutputSignals.isEmpty() && _lstWaitingOutputSignals.first().time <= iNow)
+    lstDue << _lstWaitingOutputSignals.takeFirst();
+  if (lstDue.isEmpty())
+    return;
+
+  _mutex.unlock();
+  synchronized (_writeMutex)
+    setOutputStates(lstDue);
+  qint64 iDone = currentTime();
+  _mutex.lock();
 
-      //HANDLE OUTPUTS ->
-      qint64 currentTime = QDateTime::currentDateTime().toMSecsSinceEpoch();
-      int size = _lstWaitingOutputSignals.size();
+  for (int i=0; i<lstDue.size(); ++i)
+    {
+      qint64 iLatency = iDone - lstDue[i].time;
+      ++_iTransitionCount;
+      _iTotalLatency += iLatency;
+      _iMaxLatency = qMax(_iMaxLatency, iLatency);
+    }
+}
 
-      //handle all current output structs
-      for (int i=0; i<size; i++)
+void PiiIoThread::setOutputStates(const QList<OutputSignal>& signalList)
+{
+  // Pass all transitions of a driver at once.
+  QList<OutputSignal> lstRemaining(signalList);
+  while (!lstRemaining.isEmpty())
+    {
+      PiiDefaultIoDriver *pDriver = lstRemaining.first().driver;
+      QList<PiiIoChannel*> lstChannels;
+      QList<bool> lstStates;
+      for (int i=0; i<lstRemaining.size(); )
         {
-          OutputSignal stru = _lstWaitingOutputSignals[i];
-          if (currentTime > stru.time)
+          if (lstRemaining[i].driver == pDriver)
             {
-              try
-                {
-                  stru.channel->setOutputState(stru.active);
-                }
-              catch (PiiException &ex)
-                {
-                }
-              _lstWaitingOutputSignals[i].handled = true;
+              lstChannels << lstRemaining[i].channel;
+              lstStates << lstRemaining[i].active;
+              lstRemaining.removeAt(i);
             }
+          else
+            ++i;
         }
+      pDriver->setOutputStates(lstChannels, lstStates);
+    }
+}
 
-      //remove all handled output structs
-      for (int i=_lstWaitingOutputSignals.size(); i--; )
-        if (_lstWaitingOutputSignals[i].handled)
-          _lstWaitingOutputSignals.removeAt(i);
+void PiiIoThread::poll()
+{
+  QMutexLocker lock(&_pollMutex);
+  while (_bRunning)
+    {
+      if (_lstPollingInputs.isEmpty())
+        {
+          _pollCondition.wait(&_pollMutex);
+          continue;
+        }
+
+      qint64 iStartTime = currentTime();
 
-      _mutex.unlock();
+      // Group inputs by driver
+      QList<PollingInput> lstRemaining(_lstPollingInputs);
+      while (!lstRemaining.isEmpty())
+        {
+          PiiDefaultIoDriver *pDriver = lstRemaining.first().driver;
+          QList<PiiIoChannel*> lstChannels;
+          for (int i=0; i<lstRemaining.size(); )
+            {
+              if (lstRemaining[i].driver == pDriver)
+                lstChannels << lstRemaining.takeAt(i).channel;
+              else
+                ++i;
+            }
+          pDriver->checkInputs(lstChannels);
+        }
 
-      PiiDelay::msleep(10);
+      qint64 iRemaining = _iPollingInterval - (currentTime() - iStartTime);
+      if (iRemaining >= 1000)
+        _pollCondition.wait(&_pollMutex, (unsigned long)iRemaining / 1000);
+      else if (iRemaining > 0)
+        {
+          lock.unlock();
+          PiiDelay::usleep(int(iRemaining));
+          lock.relock();
+        }
     }
 }
 
 void PiiIoThread::removeOutputList(const QVector<PiiIoChannel*>& lstChannels)
 {
-  _mutex.lock();
+  QList<OutputSignal> lstRemoved;
+  synchronized (_mutex)
+    {
+      for (int i=0; i<_lstWaitingOutputSignals.size(); )
+        {
+          if (lstChannels.contains(_lstWaitingOutputSignals[i].channel))
+            lstRemoved << _lstWaitingOutputSignals.takeAt(i);
+          else
+            ++i;
+        }
+    }
 
-  // First handle all waiting output signals depends on lstChannels
-  for (int i=0; i<_lstWaitingOutputSignals.size(); i++)
+  // Handle all waiting output signals depends on lstChannels now.
+  synchronized (_writeMutex)
     {
-      OutputSignal& stru = _lstWaitingOutputSignals[i];
-      if (lstChannels.contains(stru.channel))
+      for (int i=0; i<lstRemoved.size(); ++i)
         {
           try
             {
-              stru.channel->setOutputState(stru.active);
+              lstRemoved[i].channel->setOutputState(lstRemoved[i].active);
             }
-          catch (PiiException &ex)
+          catch (PiiException&)
             {
             }
-          stru.handled = true;
         }
     }
-
-  // Second remove all handled output structs
-  for (int i=_lstWaitingOutputSignals.size(); i--; )
-    if (_lstWaitingOutputSignals[i].handled)
-      _lstWaitingOutputSignals.removeAt(i);
-
-  _mutex.unlock();
-
 }
 
-void PiiIoThread::addNewStruct(PiiIoChannel *channel, bool active, qint64 time, int width)
+void PiiIoThread::addNewStruct(PiiDefaultIoDriver *driver, PiiIoChannel *channel, bool active, qint64 time)
 {
   OutputSignal stru;
-  stru.handled = false;
+  stru.driver = driver;
   stru.channel = channel;
   stru.active = active;
   stru.time = time;
-  stru.pulseWidth = width;
-  _lstWaitingOutputSignals << stru;
+
+  // Keep the queue sorted. Transitions scheduled at the same time
+  // retain their order.
+  int i = _lstWaitingOutputSignals.size();
+  while (i > 0 && _lstWaitingOutputSignals[i-1].time > time)
+    --i;
+  _lstWaitingOutputSignals.insert(i, stru);
+  _bQueueChanged = true;
 }
 
-void PiiIoThread::addPollingInput(PiiIoChannel *input)
+void PiiIoThread::addPollingInput(PiiDefaultIoDriver *driver, PiiIoChannel *input)
 {
-  _mutex.lock();
-  if (!_lstPollingInputs.contains(input))
-    _lstPollingInputs << input;
-  _mutex.unlock();
+  synchronized (_pollMutex)
+    {
+      if (!_lstPollingInputs.contains(input))
+        {
+          PollingInput pollingInput = { driver, input };
+          _lstPollingInputs << pollingInput;
+          _pollCondition.wakeAll();
+        }
+    }
 }
 
 void PiiIoThread::removePollingInput(PiiIoChannel *input)
 {
-  _mutex.lock();
-  _lstPollingInputs.removeAll(input);
-  _mutex.unlock();
+  // Waits until an ongoing poll has finished.
+  synchronized (_pollMutex)
+    {
+      for (int i=_lstPollingInputs.size(); i--; )
+        if (_lstPollingInputs[i] == input)
+          _lstPollingInputs.removeAt(i);
+    }
 }
 
-
-void PiiIoThread::sendSignal(PiiIoChannel *channel, bool active, qint64 time, int width)
+void PiiIoThread::sendSignal(PiiDefaultIoDriver *driver, PiiIoChannel *channel, bool active, qint64 time, qint64 width)
 {
-  _mutex.lock();
+  QMutexLocker lock(&_mutex);
 
   if (width == 0)
-    addNewStruct(channel,active,time,width);
+    addNewStruct(driver, channel, active, time);
   else
     {
       /**
@@ -164,10 +302,12 @@ void PiiIoThread::sendSignal(PiiIoChannel *channel, bool active, qint64 time, in
                   bAddNew = false;
                   break;
                 }
-              else if(stru.time >= time &&
-                      stru.time <= (time + qint64(width)))
+              else if (stru.time >= time &&
+                       stru.time <= time + width)
                 {
-                  stru.time = time + qint64(width);
+                  // Move the transition to keep the queue sorted.
+                  OutputSignal moved = _lstWaitingOutputSignals.takeAt(i);
+                  addNewStruct(moved.driver, moved.channel, moved.active, time + width);
                   bAddNew = false;
                   break;
                 }
@@ -176,9 +316,60 @@ void PiiIoThread::sendSignal(PiiIoChannel *channel, bool active, qint64 time, in
 
       if (bAddNew)
         {
-          addNewStruct(channel, active, time, width);
-          addNewStruct(channel, !active, time + qint64(width), 0);
+          addNewStruct(driver, channel, active, time);
+          addNewStruct(driver, channel, !active, time + width);
         }
     }
-  _mutex.unlock();
+
+  if (_bQueueChanged)
+    _outputCondition.wakeOne();
+}
+
+void PiiIoThread::setPollingInterval(int pollingInterval)
+{
+  synchronized (_pollMutex)
+    {
+      _iPollingInterval = qMax(0, pollingInterval);
+      _pollCondition.wakeAll();
+    }
+}
+
+int PiiIoThread::pollingInterval() const
+{
+  synchronized (_pollMutex) return _iPollingInterval;
+  return 0;
+}
+
+void PiiIoThread::setBusyWaitThreshold(int busyWaitThreshold)
+{
+  synchronized (_mutex)
+    {
+      _iBusyWaitThreshold = qMax(0, busyWaitThreshold);
+      _bQueueChanged = true;
+      _outputCondition.wakeOne();
+    }
+}
+
+int PiiIoThread::busyWaitThreshold() const
+{
+  synchronized (_mutex) return _iBusyWaitThreshold;
+  return 0;
+}
+
+PiiIoThread::LatencyStatistics PiiIoThread::latencyStatistics() const
+{
+  LatencyStatistics statistics;
+  synchronized (_mutex)
+    {
+      statistics.transitionCount = _iTransitionCount;
+      statistics.averageLatency = _iTransitionCount > 0 ? _iTotalLatency / _iTransitionCount : 0;
+      statistics.maxLatency = _iMaxLatency;
+    }
+  return statistics;
+}
+
+void PiiIoThread::resetLatencyStatistics()
+{
+  synchronized (_mutex)
+    _iTransitionCount = _iTotalLatency = _iMaxLatency = 0;
 }
@@ -12,15 +12,39 @@
  * to use Into as a part of open source software projects. Please
  * refer to LICENSE.AGPL3 for details.
  */
-
 #ifndef _PIIIOTHREAD_H
 #define _PIIIOTHREAD_H
 
 #include <QMutex>
 #include <QThread>
 #include <QVector>
+#include <QWaitCondition>
 #include "PiiIoChannel.h"
 
+class PiiDefaultIoDriver;
+
+/**
+ * The thread that drives the outputs and polls the inputs of all
+ * [PiiDefaultIoDriver] instances.
+ *
+ * Output transitions are kept in a queue sorted by time. The thread
+ * sleeps until the next transition is due or a new one is scheduled,
+ * so output timing does not depend on a polling interval. Waits
+ * shorter than [busyWaitThreshold()] are spun out to meet
+ * sub-millisecond deadlines at the cost of keeping one core busy.
+ * All transitions due at the same time are passed to
+ * PiiDefaultIoDriver::setOutputStates() at once so that drivers can
+ * write them in a single transaction.
+ *
+ * Inputs are polled in a separate thread so that slow input reads
+ * don't delay outputs. All inputs of a driver are passed to
+ * PiiDefaultIoDriver::checkInputs() at once.
+ *
+ * All times are in microseconds. Absolute times are measured with
+ * [currentTime()].
+ *
+ * @internal
+ */
 class PiiIoThread : public QThread
 {
   Q_OBJECT
@@ -28,21 +52,43 @@ class PiiIoThread : public QThread
 public:
   struct OutputSignal
   {
-    bool handled;
+    PiiDefaultIoDriver *driver;
     PiiIoChannel *channel;
     bool active;
     qint64 time;
-    int pulseWidth;
+  };
+
+  /**
+   * The difference between the scheduled and actual times of output
+   * transitions.
+   */
+  struct LatencyStatistics
+  {
+    LatencyStatistics() : transitionCount(0), averageLatency(0), maxLatency(0) {}
+    qint64 transitionCount;
+    qint64 averageLatency;
+    qint64 maxLatency;
   };
 
   PiiIoThread(QObject *parent = 0);
+  ~PiiIoThread();
 
   void run();
-  void stop() { _bRunning = false; }
+  void stop();
 
-  void sendSignal(PiiIoChannel *channel, bool value, qint64 time, int pulseWidth);
+  /**
+   * Returns the current time on a monotonic clock, in microseconds.
+   */
+  static qint64 currentTime();
+
+  /**
+   * Schedules *channel* to be set to *active* at *time*. If
+   * *pulseWidth* is non-zero, the channel will be restored after
+   * *pulseWidth* microseconds.
+   */
+  void sendSignal(PiiDefaultIoDriver *driver, PiiIoChannel *channel, bool active, qint64 time, qint64 pulseWidth);
 
-  void addPollingInput(PiiIoChannel *input);
+  void addPollingInput(PiiDefaultIoDriver *driver, PiiIoChannel *input);
   void removePollingInput(PiiIoChannel *input);
 
   /**
@@ -51,14 +97,44 @@ public:
    */
   void removeOutputList(const QVector<PiiIoChannel*>& lstChannels);
 
+  void setPollingInterval(int pollingInterval);
+  int pollingInterval() const;
+  void setBusyWaitThreshold(int busyWaitThreshold);
+  int busyWaitThreshold() const;
+
+  LatencyStatistics latencyStatistics() const;
+  void resetLatencyStatistics();
+
 private:
-  bool needAppend(PiiIoChannel *channel, bool active, qint64 checkTime);
-  void addNewStruct(PiiIoChannel *channel, bool active, qint64 time, int width);
+  struct PollingInput
+  {
+    PiiDefaultIoDriver *driver;
+    PiiIoChannel *channel;
+    bool operator== (PiiIoChannel *other) const { return channel == other; }
+  };
+
+  void poll();
+  void waitUntil(qint64 time);
+  void handleDueOutputs();
+  void setOutputStates(const QList<OutputSignal>& signalList);
+  void addNewStruct(PiiDefaultIoDriver *driver, PiiIoChannel *channel, bool active, qint64 time);
 
-  bool _bRunning;
-  QMutex _mutex;
+  volatile bool _bRunning;
+  volatile bool _bQueueChanged;
+  mutable QMutex _mutex;
+  // Held while writing outputs.
+  QMutex _writeMutex;
+  QWaitCondition _outputCondition;
+  // Sorted by time.
   QList<OutputSignal> _lstWaitingOutputSignals;
-  QList<PiiIoChannel*> _lstPollingInputs;
+  int _iBusyWaitThreshold;
+  qint64 _iTransitionCount, _iTotalLatency, _iMaxLatency;
+
+  QThread *_pPollingThread;
+  mutable QMutex _pollMutex;
+  QWaitCondition _pollCondition;
+  QList<PollingInput> _lstPollingInputs;
+  int _iPollingInterval;
 };
 
 #endif //_PIIIOTHREAD_H
@@ -64,8 +64,43 @@ void PiiFeaturePointMatcher<T, SampleSet>::buildDatabase(const PiiMatrix<T>& poi
   // We are going to use the K-d tree only if the number of points is
   // much larger than the number of features. This limit would be way
   // too low if we performed exact search, but we won't.
-  if (measure == 0 && // K-d tree doesn't work in non-Euclidean spaces.
-      points.rows() > 2 * iFeatures)
+  if (d->iVocabularyBranching > 0)
+    {
+      PiiSmartPtr<PiiVocabularyTree<SampleSet> > pVocabulary(new PiiVocabularyTree<SampleSet>);
+      pVocabulary->setBranchingFactor(d->iVocabularyBranching);
+      // may throw
+      if (measure != 0)
+        pVocabulary->buildTree(features, *measure, controller);
+      else
+        pVocabulary->buildTree(features, d->squaredGeometricDistance, controller);
+      d->pVocabulary = pVocabulary.release();
+      // Points in a word are compared exhaustively.
+      d->modelFeatures = features;
+      d->pDistanceMeasure = measure;
+    }
+  else if (d->iHashTableCount > 0)
+    {
+      PiiSmartPtr<PiiLshIndex<SampleSet> > pLshIndex(new PiiLshIndex<SampleSet>);
+      pLshIndex->setTableCount(d->iHashTableCount);
+      pLshIndex->buildIndex(features, controller); // may throw
+      d->pLshIndex = pLshIndex.release();
+      // Not used, but owned.
+      d->pDistanceMeasure = measure;
+    }
+  else if (d->iSearchWidth > 0)
+    {
+      PiiSmartPtr<PiiHnswIndex<SampleSet> > pIndex(new PiiHnswIndex<SampleSet>);
+      pIndex->setSearchWidth(d->iSearchWidth);
+      // may throw
+      if (measure != 0)
+        pIndex->buildIndex(features, *measure, controller);
+      else
+        pIndex->buildIndex(features, d->squaredGeometricDistance, controller);
+      d->pIndex = pIndex.release();
+      d->pDistanceMeasure = measure;
+    }
+  else if (measure == 0 && // K-d tree doesn't work in non-Euclidean spaces.
+           points.rows() > 2 * iFeatures)
     {
       PiiSmartPtr<PiiKdTree<SampleSet> > pKdTree(new PiiKdTree<SampleSet>);
       pKdTree->buildTree(features, controller); // may throw
@@ -78,6 +113,119 @@ void PiiFeaturePointMatcher<T, SampleSet>::buildDatabase(const PiiMatrix<T>& poi
     }
   d->matModelPoints = points;
   d->vecModelIndices = modelIndices;
+  if (d->pVocabulary != 0)
+    calculateWordWeights();
+}
+
+template <class T, class SampleSet>
+void PiiFeaturePointMatcher<T, SampleSet>::calculateWordWeights()
+{
+  const int iWords = d->pVocabulary->wordCount();
+  // The number of different models in each word, and the last word
+  // each model was seen in (plus one).
+  QVector<int> vecModelCounts(iWords, 0);
+  QHash<int,int> hashLastWords;
+  for (int iWord=0; iWord<iWords; ++iWord)
+    {
+      const int* pSamples = d->pVocabulary->wordSamples(iWord);
+      for (int i=d->pVocabulary->wordSize(iWord); i--; )
+        {
+          int& iLastWord = hashLastWords[modelIndex(pSamples[i])];
+          if (iLastWord != iWord + 1)
+            {
+              iLastWord = iWord + 1;
+              ++vecModelCounts[iWord];
+            }
+        }
+    }
+
+  // Inverse document frequency: words that appear in many models
+  // tell little about the identity of the object.
+  const double dModels = hashLastWords.size();
+  d->vecWordWeights.resize(iWords);
+  for (int i=0; i<iWords; ++i)
+    d->vecWordWeights[i] = Pii::log(1.0 + dModels / qMax(1, vecModelCounts[i]));
+}
+
+template <class T, class SampleSet>
+template <class DistanceMeasure>
+void PiiFeaturePointMatcher<T, SampleSet>::findVocabularyMatches(const SampleSet& features,
+                                                                 int points,
+                                                                 const DistanceMeasure& measure,
+                                                                 MatchHash& matches) const
+{
+  using namespace PiiSampleSet;
+  const PiiVocabularyTree<SampleSet>* pVocabulary = d->pVocabulary;
+  const SampleSet& modelFeatures = d->modelFeatures;
+  const int iFeatures = featureCount(modelFeatures);
+
+  // Each query point votes once for each model that has points in
+  // the same word. The score of a model is the sum of the weights of
+  // the words it shares with the query.
+  typedef QPair<double,int> Score; // (score, last voter + 1)
+  QHash<int,Score> hashScores;
+  QVector<int> vecWords(points);
+  for (int i=0; i<points; ++i)
+    {
+      const int iWord = vecWords[i] = pVocabulary->quantize(sampleAt(features, i), measure);
+      if (iWord < 0)
+        continue;
+      const double dWeight = d->vecWordWeights[iWord];
+      const int* pSamples = pVocabulary->wordSamples(iWord);
+      for (int j=pVocabulary->wordSize(iWord); j--; )
+        {
+          Score& score = hashScores[modelIndex(pSamples[j])];
+          if (score.second != i + 1)
+            {
+              score.first += dWeight;
+              score.second = i + 1;
+            }
+        }
+    }
+
+  // Sort candidates so that the one with the highest score comes first.
+  QList<QPair<double,int> > lstCandidates;
+  for (typename QHash<int,Score>::const_iterator i = hashScores.begin();
+       i != hashScores.end(); ++i)
+    lstCandidates << qMakePair(-PII_ITERATOR_VALUE(i).first, PII_ITERATOR_KEY(i));
+  std::sort(lstCandidates.begin(), lstCandidates.end());
+  if (d->iMaxCandidateModels > 0 && lstCandidates.size() > d->iMaxCandidateModels)
+    lstCandidates.erase(lstCandidates.begin() + d->iMaxCandidateModels, lstCandidates.end());
+
+  QHash<int,int> hashIsCandidate;
+  for (int i=0; i<lstCandidates.size(); ++i)
+    hashIsCandidate.insert(lstCandidates[i].second, 1);
+
+  // Match each query point to the closest points of each candidate
+  // model in its word.
+  typedef QPair<int,QPair<double,int> > PointMatch; // (model, (distance, point))
+  QVector<PointMatch> vecPointMatches;
+  for (int i=0; i<points; ++i)
+    {
+      const int iWord = vecWords[i];
+      if (iWord < 0)
+        continue;
+      const int* pSamples = pVocabulary->wordSamples(iWord);
+      const int iWordSize = pVocabulary->wordSize(iWord);
+      vecPointMatches.resize(0);
+      for (int j=0; j<iWordSize; ++j)
+        {
+          const int iModel = modelIndex(pSamples[j]);
+          if (hashIsCandidate.value(iModel))
+            vecPointMatches << PointMatch(iModel, qMakePair(measure(sampleAt(features, i),
+                                                                    sampleAt(modelFeatures, pSamples[j]),
+                                                                    iFeatures),
+                                                            pSamples[j]));
+        }
+      std::sort(vecPointMatches.begin(), vecPointMatches.end());
+      for (int j=0, iRank=0; j<vecPointMatches.size(); ++j)
+        {
+          if (j > 0 && vecPointMatches[j].first != vecPointMatches[j-1].first)
+            iRank = 0;
+          if (iRank++ < d->iClosestMatchCount)
+            matches[vecPointMatches[j].first] << qMakePair(i, vecPointMatches[j].second.second);
+        }
+    }
 }
 
 template <class T, class SampleSet>
@@ -95,50 +243,17 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   const int iPoints = qMin(points.rows(), sampleCount(features)),
     iDimensions = points.columns();
 
-  typedef QHash<int, QList<QPair<int,int> > > MatchHash;
   MatchHash hashMatchIndices;
 
-  // Find N closest matches for each point
-  for (int i=0; i<iPoints; ++i)
+  if (d->pVocabulary != 0)
     {
-      PiiClassification::MatchList lstMatches;
-      if (d->pKdTree != 0)
-        {
-          if (d->iMaxEvaluations > 0)
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
-                                                        d->iClosestMatchCount,
-                                                        d->iMaxEvaluations);
-          else
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
-                                                        d->iClosestMatchCount);
-        }
-      else if (d->pDistanceMeasure != 0)
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           *d->pDistanceMeasure,
-                                                           d->iClosestMatchCount);
+      if (d->pDistanceMeasure != 0)
+        findVocabularyMatches(features, iPoints, *d->pDistanceMeasure, hashMatchIndices);
       else
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           d->squaredGeometricDistance,
-                                                           d->iClosestMatchCount);
-
-      // All matches that are good enough compared to the best one
-      // will be accepted as candidates.
-      for (int j=0; j<lstMatches.size(); ++j)
-        {
-          if (lstMatches[j].first == 0 || lstMatches[0].first / lstMatches[j].first > 0.8)
-            {
-              int iModelIndex = d->vecModelIndices.size() != 0 ?
-                int(d->vecModelIndices[lstMatches[j].second]) : 0;
-              // Store the indices of matched points for each model
-              // class separately.
-              hashMatchIndices[iModelIndex] << qMakePair(i, lstMatches[j].second);
-            }
-          else
-            break;
-        }
+        findVocabularyMatches(features, iPoints, d->squaredGeometricDistance, hashMatchIndices);
     }
+  else
+    findNearestMatches(features, iPoints, hashMatchIndices);
 
   QList<QPair<int,int> > lstCandidateModels;
   int iMinMatches = 1;
@@ -156,6 +271,11 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   // Sort according to match count (the candidate model with most
   // matches will be evaluated first)
   std::sort(lstCandidateModels.begin(), lstCandidateModels.end());
+  if (d->iMaxCandidateModels > 0 && lstCandidateModels.size() > d->iMaxCandidateModels)
+    lstCandidateModels.erase(lstCandidateModels.begin(),
+                             lstCandidateModels.end() - d->iMaxCandidateModels);
+  if (lstCandidateModels.isEmpty())
+    return lstMatchedModels;
 
   PiiMatrix<T> matQueryPoints(0,iDimensions), matModelPoints(0,iDimensions);
 
@@ -219,6 +339,68 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   return lstMatchedModels;
 }
 
+template <class T, class SampleSet>
+void PiiFeaturePointMatcher<T, SampleSet>::findNearestMatches(const SampleSet& features,
+                                                              int points,
+                                                              MatchHash& matches) const
+{
+  using namespace PiiSampleSet;
+  // Find N closest matches for each point
+  for (int i=0; i<points; ++i)
+    {
+      PiiClassification::MatchList lstMatches;
+      if (d->pLshIndex != 0)
+        lstMatches = d->pLshIndex->findClosestMatches(sampleAt(features, i),
+                                                      d->iClosestMatchCount);
+      else if (d->pIndex != 0)
+        {
+          if (d->pDistanceMeasure != 0)
+            lstMatches = d->pIndex->findClosestMatches(sampleAt(features, i),
+                                                       *d->pDistanceMeasure,
+                                                       d->iClosestMatchCount);
+          else
+            lstMatches = d->pIndex->findClosestMatches(sampleAt(features, i),
+                                                       d->squaredGeometricDistance,
+                                                       d->iClosestMatchCount);
+        }
+      else if (d->pKdTree != 0)
+        {
+          if (d->iMaxEvaluations > 0)
+            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
+                                                        d->iClosestMatchCount,
+                                                        d->iMaxEvaluations);
+          else
+            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
+                                                        d->iClosestMatchCount);
+        }
+      else if (d->pDistanceMeasure != 0)
+        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
+                                                           d->modelFeatures,
+                                                           *d->pDistanceMeasure,
+                                                           d->iClosestMatchCount);
+      else
+        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
+                                                           d->modelFeatures,
+                                                           d->squaredGeometricDistance,
+                                                           d->iClosestMatchCount);
+
+      // All matches that are good enough compared to the best one
+      // will be accepted as candidates.
+      for (int j=0; j<lstMatches.size(); ++j)
+        {
+          if (lstMatches[j].first == 0 || lstMatches[0].first / lstMatches[j].first > 0.8)
+            {
+              int iModelIndex = modelIndex(lstMatches[j].second);
+              // Store the indices of matched points for each model
+              // class separately.
+              matches[iModelIndex] << qMakePair(i, lstMatches[j].second);
+            }
+          else
+            break;
+        }
+    }
+}
+
 template <class T, class SampleSet>
 void PiiFeaturePointMatcher<T,SampleSet>::collectPoints(const QList<QPair<int,int> >& indices,
                                                         const PiiMatrix<T>& points,
@@ -236,8 +418,18 @@ template <class T, class SampleSet>
 void PiiFeaturePointMatcher<T,SampleSet>::removePoints(const QVector<int>& indices,
                                                        QList<QPair<int,int> >& matches)
 {
-  for (int i=indices.size(); i--; )
-    matches.removeAt(indices[i]);
+  if (indices.isEmpty())
+    return;
+  // Removing one by one would be quadratic.
+  QList<QPair<int,int> > lstRemaining;
+  for (int i=0, j=0; i<matches.size(); ++i)
+    {
+      if (j < indices.size() && indices[j] == i)
+        ++j;
+      else
+        lstRemaining << matches[i];
+    }
+  matches = lstRemaining;
 }
 
 template <class T, class SampleSet>
@@ -255,19 +447,36 @@ namespace PiiMatching
 {
   template <class Merger> void removeDuplicates(MatchList& matchedModels, Merger& merge)
   {
-    for (int i=matchedModels.size()-1; i>0; --i)
+    // Only matches to the same model can be duplicates. Group them
+    // by model index first.
+    QHash<int, QList<int> > hashModelMatches;
+    for (int i=0; i<matchedModels.size(); ++i)
+      hashModelMatches[matchedModels[i].modelIndex()] << i;
+
+    QVector<bool> vecRemoved(matchedModels.size(), false);
+    for (QHash<int, QList<int> >::const_iterator it = hashModelMatches.begin();
+         it != hashModelMatches.end(); ++it)
       {
-        for (int j=i-1; j>=0; --j)
+        const QList<int>& lstIndices = PII_ITERATOR_VALUE(it);
+        for (int i=lstIndices.size()-1; i>0; --i)
           {
-            // If there are two matches to the same model and they can
-            // be merged, remove the other entry.
-            if (matchedModels[i].modelIndex() == matchedModels[j].modelIndex() &&
-                merge(matchedModels[i], matchedModels[j]))
+            for (int j=i-1; j>=0; --j)
               {
-                matchedModels.removeAt(i);
-                break;
+                // If two matches to the same model can be merged,
+                // remove the other entry.
+                if (merge(matchedModels[lstIndices[i]], matchedModels[lstIndices[j]]))
+                  {
+                    vecRemoved[lstIndices[i]] = true;
+                    break;
+                  }
               }
           }
       }
+
+    MatchList lstRemaining;
+    for (int i=0; i<matchedModels.size(); ++i)
+      if (!vecRemoved[i])
+        lstRemaining << matchedModels[i];
+    matchedModels = lstRemaining;
   }
 }
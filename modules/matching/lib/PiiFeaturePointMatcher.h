@@ -20,6 +20,9 @@
 #include <PiiMatrix.h>
 #include <PiiDistanceMeasure.h>
 #include <PiiKdTree.h>
+#include <PiiHnswIndex.h>
+#include <PiiVocabularyTree.h>
+#include <PiiLshIndex.h>
 #include <PiiClassification.h>
 #include <PiiSharedD.h>
 
@@ -178,10 +181,27 @@ namespace PiiMatching
 template <class T, class SampleSet> class PiiFeaturePointMatcher
 {
   friend struct PiiSerialization::Accessor;
-  template <class Archive> void serialize(Archive& archive, const unsigned int /*version*/)
+  template <class Archive> void serialize(Archive& archive, const unsigned int version)
   {
     archive & PII_NVP("points", d->matModelPoints);
     archive & PII_NVP("kdTree", d->pKdTree);
+    if (version > 0)
+      {
+        archive & PII_NVP("index", d->pIndex);
+        archive & PII_NVP("searchWidth", d->iSearchWidth);
+      }
+    if (version > 1)
+      {
+        archive & PII_NVP("vocabulary", d->pVocabulary);
+        archive & PII_NVP("wordWeights", d->vecWordWeights);
+        archive & PII_NVP("vocabularyBranching", d->iVocabularyBranching);
+        archive & PII_NVP("maxCandidates", d->iMaxCandidateModels);
+      }
+    if (version > 2)
+      {
+        archive & PII_NVP("lshIndex", d->pLshIndex);
+        archive & PII_NVP("hashTables", d->iHashTableCount);
+      }
     archive & PII_NVP("features", d->modelFeatures);
     archive & PII_NVP("indices", d->vecModelIndices);
     //archive & PII_NVP("distanceMeasure", d->pDistanceMeasure);
@@ -204,7 +224,14 @@ public:
    * *features* for linear search or builds a [K-d tree](PiiKdtree),
    * which will be later used for quick queries. The most suitable
    * search technique is determined by the number of points and
-   * features.
+   * features. If a positive [searchWidth()] has been set, an
+   * approximate nearest neighbor graph (PiiHnswIndex) will be built
+   * instead. If a positive [vocabularyBranching()] has been set, the
+   * features are quantized with a PiiVocabularyTree, which takes
+   * precedence over the other two. If a positive [hashTableCount()]
+   * has been set, the features are treated as binary descriptors and
+   * indexed with PiiLshIndex, which takes precedence over the
+   * nearest neighbor graph.
    *
    * @param points the locations of feature points with respect to the
    * model the point belongs to.
@@ -226,7 +253,9 @@ public:
    * @param measure an optional distance measure that can be used if
    * the feature space is non-Euclidean. Note that the K-d tree will
    * not be used for queries if a custom distance measure is
-   * provided. PiiFeaturePointMatcher takes the ownership of the
+   * provided. The nearest neighbor graph works with any measure.
+   * The hash index always uses the Hamming distance and ignores
+   * *measure*. PiiFeaturePointMatcher takes the ownership of the
    * measure.
    *
    * @exception PiiClassificationException& if the tree building
@@ -246,12 +275,20 @@ public:
    *
    * The matching algorithm:
    *
+   * - If the database has a vocabulary tree, quantize each query
+   * point to a word and let it vote for the models that have points
+   * in the same word. Each vote is weighted by the rarity of the word
+   * among the models. Only the [maxCandidateModels()] models with the
+   * highest scores are considered, and each query point is matched
+   * to the M closest points of each of them in its word. Otherwise:
+   *
    * - Find the M closest matches of each key point (*points*) in the
    * key point database. Matches whose distance ratio to the closest
    * one is less than 0.8 will be discarded.
    *
    * - Select candidate models with a sufficient number of matches for
-   * further inspection.
+   * further inspection. If [maxCandidateModels()] is positive, only
+   * the models with the most matches are selected.
    *
    * - Repeat until the candidate model set is empty:
    *
@@ -355,6 +392,108 @@ public:
    */
   int maxEvaluations() const { return d->iMaxEvaluations; }
 
+  /**
+   * Sets the number of candidates kept when searching an approximate
+   * nearest neighbor graph (see PiiHnswIndex::setSearchWidth()). If
+   * *searchWidth* is positive, [buildDatabase()] indexes the features
+   * with a graph, which scales to high-dimensional feature spaces
+   * much better than the k-d tree. A larger value means more
+   * accurate but slower queries. Changing the value affects an
+   * existing graph immediately. Setting *searchWidth* to a
+   * non-positive value disables the graph in the next
+   * [buildDatabase()] call.
+   */
+  void setSearchWidth(int searchWidth)
+  {
+    if (searchWidth != d->iSearchWidth)
+      {
+        detach();
+        d->iSearchWidth = searchWidth;
+        if (d->pIndex != 0 && searchWidth > 0)
+          d->pIndex->setSearchWidth(searchWidth);
+      }
+  }
+  /**
+   * Returns the search width of the nearest neighbor graph. The
+   * default is 0.
+   */
+  int searchWidth() const { return d->iSearchWidth; }
+
+  /**
+   * Sets the number of hash tables used for indexing binary
+   * descriptors (see PiiLshIndex::setTableCount()). If
+   * *hashTableCount* is positive, [buildDatabase()] treats each
+   * feature vector as a string of bits and indexes the model
+   * features with locality sensitive hashing. The nearest neighbors
+   * are then searched in the Hamming space among the model points
+   * that share a hash bucket with the query point. This is a good
+   * choice for binary descriptors such as those produced by
+   * PiiRandomLbp::calculateDescriptor(), especially if they are
+   * stored as `unsigned char`. More tables find more of the true
+   * neighbors but make queries slower. Takes effect in the next
+   * [buildDatabase()] call. The default is 0.
+   */
+  void setHashTableCount(int hashTableCount)
+  {
+    if (hashTableCount != d->iHashTableCount)
+      {
+        detach();
+        d->iHashTableCount = hashTableCount;
+      }
+  }
+  /**
+   * Returns the number of hash tables.
+   */
+  int hashTableCount() const { return d->iHashTableCount; }
+
+  /**
+   * Sets the branching factor of the vocabulary tree (see
+   * PiiVocabularyTree::setBranchingFactor()). If *branching* is
+   * positive, [buildDatabase()] quantizes the features with a
+   * vocabulary tree and builds an inverted index from words to
+   * models. [findMatchingModels()] then retrieves candidate models
+   * through the index with a cost that depends on the number of
+   * query points and the size of the words rather than the size of
+   * the database. Combined with [maxCandidateModels()], this makes
+   * it possible to match against tens of thousands of models. The
+   * correspondences are coarser than with nearest neighbor search,
+   * but the matcher verifies each candidate anyway. Takes effect in
+   * the next [buildDatabase()] call. The default is 0.
+   */
+  void setVocabularyBranching(int branching)
+  {
+    if (branching != d->iVocabularyBranching)
+      {
+        detach();
+        d->iVocabularyBranching = branching;
+      }
+  }
+  /**
+   * Returns the branching factor of the vocabulary tree.
+   */
+  int vocabularyBranching() const { return d->iVocabularyBranching; }
+
+  /**
+   * Sets the maximum number of candidate models verified with the
+   * matcher per query. The candidates with the most matches (or the
+   * highest scores with a vocabulary tree) are verified first and
+   * the rest are ignored. Zero or a negative value means no limit.
+   * The default is 0.
+   */
+  void setMaxCandidateModels(int maxCandidateModels)
+  {
+    if (maxCandidateModels != d->iMaxCandidateModels)
+      {
+        detach();
+        d->iMaxCandidateModels = maxCandidateModels;
+      }
+  }
+  /**
+   * Returns the maximum number of candidate models verified per
+   * query.
+   */
+  int maxCandidateModels() const { return d->iMaxCandidateModels; }
+
   /**
    * Returns the stored model points.
    */
@@ -362,7 +501,7 @@ public:
   /**
    * Returns the stored model features.
    */
-  const SampleSet& modelFeatures() const { return d->matModelFeatures; }
+  const SampleSet& modelFeatures() const { return d->modelFeatures; }
   /**
    * Returns the stored model indices.
    */
@@ -374,24 +513,42 @@ private:
   public:
     Data() :
       pKdTree(0),
+      pIndex(0),
+      pVocabulary(0),
+      pLshIndex(0),
       pDistanceMeasure(0),
       matchingMode(PiiMatching::MatchAllModels),
       iClosestMatchCount(1),
-      iMaxEvaluations(0)
+      iMaxEvaluations(0),
+      iSearchWidth(0),
+      iVocabularyBranching(0),
+      iMaxCandidateModels(0),
+      iHashTableCount(0)
     {}
     Data(const Data& other) :
       matModelPoints(other.matModelPoints),
       pKdTree(other.pKdTree ? new PiiKdTree<SampleSet>(*other.pKdTree) : 0),
+      pIndex(other.pIndex ? new PiiHnswIndex<SampleSet>(*other.pIndex) : 0),
+      pVocabulary(other.pVocabulary ? new PiiVocabularyTree<SampleSet>(*other.pVocabulary) : 0),
+      vecWordWeights(other.vecWordWeights),
+      pLshIndex(other.pLshIndex ? new PiiLshIndex<SampleSet>(*other.pLshIndex) : 0),
       modelFeatures(other.modelFeatures),
       vecModelIndices(other.vecModelIndices),
       pDistanceMeasure(other.pDistanceMeasure ? other.pDistanceMeasure->clone() : 0),
       matchingMode(other.matchingMode),
       iClosestMatchCount(other.iClosestMatchCount),
-      iMaxEvaluations(other.iMaxEvaluations)
+      iMaxEvaluations(other.iMaxEvaluations),
+      iSearchWidth(other.iSearchWidth),
+      iVocabularyBranching(other.iVocabularyBranching),
+      iMaxCandidateModels(other.iMaxCandidateModels),
+      iHashTableCount(other.iHashTableCount)
     {}
     ~Data()
     {
       delete pKdTree;
+      delete pIndex;
+      delete pVocabulary;
+      delete pLshIndex;
       delete pDistanceMeasure;
     }
 
@@ -401,23 +558,50 @@ private:
       d->matchingMode = matchingMode;
       d->iClosestMatchCount = iClosestMatchCount;
       d->iMaxEvaluations = iMaxEvaluations;
+      d->iSearchWidth = iSearchWidth;
+      d->iVocabularyBranching = iVocabularyBranching;
+      d->iMaxCandidateModels = iMaxCandidateModels;
+      d->iHashTableCount = iHashTableCount;
       this->release();
       return d;
     }
 
     PiiMatrix<T> matModelPoints;
     PiiKdTree<SampleSet>* pKdTree;
+    PiiHnswIndex<SampleSet>* pIndex;
+    PiiVocabularyTree<SampleSet>* pVocabulary;
+    // The weight of a vote through each word of the vocabulary
+    QVector<double> vecWordWeights;
+    PiiLshIndex<SampleSet>* pLshIndex;
     SampleSet modelFeatures;
     QVector<int> vecModelIndices;
     PiiDistanceMeasure<ConstFeatureIterator>* pDistanceMeasure;
     PiiMatching::ModelMatchingMode matchingMode;
     int iClosestMatchCount;
     int iMaxEvaluations;
+    int iSearchWidth;
+    int iVocabularyBranching;
+    int iMaxCandidateModels;
+    int iHashTableCount;
     PiiSquaredGeometricDistance<ConstFeatureIterator> squaredGeometricDistance;
   } *d;
 
   void detach() { d = d->detach(); }
 
+  typedef QHash<int, QList<QPair<int,int> > > MatchHash;
+
+  int modelIndex(int point) const { return d->vecModelIndices.size() != 0 ? d->vecModelIndices[point] : 0; }
+
+  void calculateWordWeights();
+  void findNearestMatches(const SampleSet& features,
+                          int points,
+                          MatchHash& matches) const;
+  template <class DistanceMeasure>
+  void findVocabularyMatches(const SampleSet& features,
+                             int points,
+                             const DistanceMeasure& measure,
+                             MatchHash& matches) const;
+
   void collectPoints(const QList<QPair<int,int> >& indices,
                      const PiiMatrix<T>& points,
                      PiiMatrix<T>& queryPoints,
@@ -430,6 +614,13 @@ private:
                                              const QList<QPair<int,int> >& matches);
 };
 
+// Version 1 added the nearest neighbor graph, version 2 the
+// vocabulary tree, version 3 the hash index.
+namespace PiiSerializationTraits
+{
+  template <class T, class SampleSet> struct Version<PiiFeaturePointMatcher<T,SampleSet> > { enum { intValue = 3 }; };
+}
+
 #include "PiiFeaturePointMatcher-templates.h"
 
 #endif //_PIIFEATUREPOINTMATCHER_H
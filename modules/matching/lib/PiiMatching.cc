@@ -14,18 +14,68 @@
  */
 
 #include "PiiMatching.h"
+#include "PiiShapeContextKernels.h"
 #include <PiiMath.h>
 #include <PiiMatrixUtil.h>
 #include <PiiPoint.h>
 
 #include <iostream>
 
+namespace
+{
+  // Calculates the histograms of a strip of key points.
+  struct ShapeContextStrip
+  {
+    ShapeContextStrip(const PiiShapeContextKernel& kernel,
+                      const PiiMatrix<int>& keyPoints,
+                      const QVector<double>& directions,
+                      const QVector<float>& xs,
+                      const QVector<float>& ys,
+                      PiiMatrix<float>& features) :
+      kernel(kernel), keyPoints(keyPoints), directions(directions),
+      xs(xs), ys(ys), features(features)
+    {}
+
+    void operator() (int firstRow, int endRow)
+    {
+      const int iPoints = xs.size(), iColumns = features.columns();
+      QVector<int> vecBins(iPoints);
+      int* pBins = vecBins.data();
+      for (int i=firstRow; i<endRow; ++i)
+        {
+          kernel.bins(float(keyPoints(i,0)), float(keyPoints(i,1)),
+                      directions.size() > 0 ? directions[i] : 0.0,
+                      xs.constData(), ys.constData(), iPoints, pBins);
+
+          float* pCurrentRow = features[i];
+          for (int j=0; j<iPoints; ++j)
+            if (pBins[j] >= 0)
+              ++pCurrentRow[pBins[j]];
+
+          // Normalize histogram
+          float fSum = Pii::accumulateN(pCurrentRow, iColumns, std::plus<float>(), 0.0f);
+          if (fSum != 0)
+            Pii::mapN(pCurrentRow, iColumns, std::bind2nd(std::multiplies<float>(), 1.0f/fSum));
+        }
+    }
+
+    const PiiShapeContextKernel& kernel;
+    const PiiMatrix<int>& keyPoints;
+    const QVector<double>& directions;
+    const QVector<float>& xs;
+    const QVector<float>& ys;
+    PiiMatrix<float>& features;
+  };
+}
+
 PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& boundaryPoints,
                                                      const PiiMatrix<int>& keyPoints,
                                                      int angles,
                                                      const QVector<double>& distances,
                                                      const QVector<double>& directions,
-                                                     InvarianceFlags invariance)
+                                                     InvarianceFlags invariance,
+                                                     int maxReferencePoints,
+                                                     const PiiParallelPolicy& policy)
 {
   const int iColumns = angles * distances.size();
   const int iKeyPoints = keyPoints.rows(), iDistances = distances.size();
@@ -34,7 +84,7 @@ PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& bound
 
   PiiMatrix<float> matFeatures(iKeyPoints, iColumns);
 
-  if (iKeyPoints < 1 || iBoundaryPoints < 1)
+  if (iKeyPoints < 1 || iBoundaryPoints < 1 || iColumns < 1)
     return matFeatures;
 
   // If the first and last point on the boundary are not the same,
@@ -45,11 +95,7 @@ PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& bound
   if (iBoundaryPoints < 2)
     return matFeatures;
 
-  // Calculate max distance and angle step
-  double dMaxDistance = distances.last();
-  double dAngleStep = 2*M_PI / qMax(1,angles);
-
-  double* pNewDistances = 0;
+  QVector<double> vecScaledDistances;
   const double* pDistances = 0;
   if (invariance & ScaleInvariant)
     {
@@ -73,69 +119,30 @@ PiiMatrix<float> PiiMatching::shapeContextDescriptor(const PiiMatrix<int>& bound
           }
       // Scale distance limits (same as dividing each distance by the
       // mean)
-      pDistances = pNewDistances = new double[iDistances];
+      vecScaledDistances.reserve(iDistances);
       for (int i=0; i<iDistances; ++i)
-        pNewDistances[i] = distances[i] * dMeanDistance;
+        vecScaledDistances.append(distances[i] * dMeanDistance);
+      pDistances = vecScaledDistances.constData();
     }
   else
-    pDistances = distances.data();
-
-  // Calculate features for selected points
-  for (int i=0; i<iKeyPoints; ++i)
+    pDistances = distances.constData();
+
+  // Collect reference points. If there are too many, take an evenly
+  // spaced subset. The histograms are normalized, so sampling only
+  // increases noise.
+  const int iReferencePoints = maxReferencePoints > 0 ? qMin(maxReferencePoints, iBoundaryPoints) : iBoundaryPoints;
+  const double dReferenceStep = double(iBoundaryPoints) / iReferencePoints;
+  QVector<float> vecX(iReferencePoints), vecY(iReferencePoints);
+  for (int j=0; j<iReferencePoints; ++j)
     {
-      float* pCurrentRow = matFeatures[i];
-
-      // Get the main point
-      int x = keyPoints(i,0);
-      int y = keyPoints(i,1);
-
-      // Loop all points
-      for (int j=0; j<iBoundaryPoints; ++j)
-        {
-          // Calculate distance
-          int dx = x-boundaryPoints(j,0);
-          int dy = y-boundaryPoints(j,1);
-          double dDistance = dx*dx + dy*dy;
-
-          if (dDistance < dMaxDistance && dDistance != 0)
-            {
-              // Find distance bin index
-              int iDistanceIndex = 0;
-              for (int c=0; c<iDistances; ++c)
-                {
-                  if (dDistance < pDistances[c])
-                    iDistanceIndex = c;
-                  else
-                    break;
-                }
-
-              // Calculate angle between feature point and current boundary point
-              float dAngle = Pii::atan2((float)dy,(float)dx) + M_PI;
-
-              // Rotate along boundary direction
-              if (directions.size() > 0)
-                {
-                  dAngle -= directions[i];
-                  if (dAngle < 0)
-                    dAngle += 2*M_PI;
-                  else if (dAngle > 2*M_PI)
-                    dAngle -= 2*M_PI;
-                }
-
-              int iBinIndex = iDistances * int(dAngle / dAngleStep) + iDistanceIndex;
-              // Special case: dAngle == 2*M_PI
-              if (iBinIndex >= iColumns)
-                iBinIndex = 0;
-              ++pCurrentRow[iBinIndex];
-            }
-        }
-      // Normalize histogram and return it
-      float fSum = Pii::accumulateN(pCurrentRow, iColumns, std::plus<float>(), 0.0f);
-      if (fSum != 0)
-        Pii::mapN(pCurrentRow, iColumns, std::bind2nd(std::multiplies<float>(), 1.0f/fSum));
+      const int iPoint = iReferencePoints == iBoundaryPoints ? j : int(j * dReferenceStep);
+      vecX[j] = float(boundaryPoints(iPoint,0));
+      vecY[j] = float(boundaryPoints(iPoint,1));
     }
 
-  delete[] pNewDistances;
+  PiiShapeContextKernel kernel(angles, pDistances, iDistances);
+  ShapeContextStrip strip(kernel, keyPoints, directions, vecX, vecY, matFeatures);
+  Pii::forEachStrip(iKeyPoints, strip, policy);
 
   return matFeatures;
 }
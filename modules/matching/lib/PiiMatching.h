@@ -17,6 +17,7 @@
 #define _PIIMATCHING_H
 
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include <QVector>
 #include <QObject>
 
@@ -118,13 +119,26 @@ public:
    * `ScaleInvariant` mode, all distances will be divided by the mean
    * (squared) distance between key points. Thus, *distances* must
    * not be absolute values but relative to the mean distance.
+   *
+   * @param maxReferencePoints the maximum number of boundary points
+   * each key point is compared to. If *boundaryPoints* has more
+   * points, an evenly spaced subset will be used as reference
+   * points. Since the histograms are normalized, this makes the
+   * descriptor slightly noisier but keeps the cost linear in the
+   * number of key points. Zero means all points.
+   *
+   * @param policy the execution policy. Key points are divided into
+   * strips that are processed in parallel. The result does not
+   * depend on the number of threads.
    */
   PII_MATCHING_EXPORT PiiMatrix<float> shapeContextDescriptor(const PiiMatrix<int>& boundaryPoints,
                                                               const PiiMatrix<int>& keyPoints,
                                                               int angles,
                                                               const QVector<double>& distances,
                                                               const QVector<double>& boundaryDirections = QVector<double>(),
-                                                              InvarianceFlags invariance = NonInvariant);
+                                                              InvarianceFlags invariance = NonInvariant,
+                                                              int maxReferencePoints = 0,
+                                                              const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
 
   /**
    * Returns the direction of the boundary for each point in
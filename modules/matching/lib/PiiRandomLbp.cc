@@ -22,6 +22,31 @@ PiiRandomLbp::Data::Data() :
   iPairs(11)
 {}
 
+PiiRandomLbp::PiiRandomLbp() :
+  d(new Data)
+{}
+
+PiiRandomLbp::PiiRandomLbp(const PiiRandomLbp& other) :
+  d(new Data(*other.d))
+{}
+
+PiiRandomLbp::~PiiRandomLbp()
+{
+  delete d;
+}
+
+PiiRandomLbp& PiiRandomLbp::operator= (const PiiRandomLbp& other)
+{
+  if (&other != this)
+    *d = *other.d;
+  return *this;
+}
+
+int PiiRandomLbp::descriptorBytes() const
+{
+  return (d->iPatterns * d->iPairs + 7) / 8;
+}
+
 PiiMatrix<int> PiiRandomLbp::initializeHistogram() const
 {
   PiiMatrix<int> matResult(1, d->iPatterns * (1 << d->iPairs));
@@ -33,13 +58,15 @@ void PiiRandomLbp::setParameters(int patterns, int pairs, int rows, int columns)
 {
   d->iPatterns = patterns;
   d->iPairs = pairs;
+  if (columns <= 0)
+    columns = rows;
 
   d->vecPointPairs.clear();
   d->vecPointPairs.reserve(patterns*pairs);
 
   for (int i=0; i<patterns*pairs; ++i)
-    d->vecPointPairs << qMakePair(PiiPoint<int>(rand() % rows, rand() % columns),
-                                  PiiPoint<int>(rand() % rows, rand() % columns));
+    d->vecPointPairs << qMakePair(PiiPoint<int>(rand() % columns, rand() % rows),
+                                  PiiPoint<int>(rand() % columns, rand() % rows));
   /* PENDING
    * The pairs could be reordered to optimize cache usage.
    */
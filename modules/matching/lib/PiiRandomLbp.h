@@ -50,6 +50,16 @@
 class PiiRandomLbp
 {
 public:
+  /**
+   * Constructs a random LBP with 50 patterns of 11 pairs each. The
+   * point pairs are not selected before [setParameters()] is called.
+   */
+  PiiRandomLbp();
+  PiiRandomLbp(const PiiRandomLbp& other);
+  ~PiiRandomLbp();
+
+  PiiRandomLbp& operator= (const PiiRandomLbp& other);
+
   /**
    * Sets parameters for the RLBP and re-randomizes the selected point
    * pairs. The total length of the feature point descriptor will be
@@ -81,6 +91,33 @@ public:
    */
   template <class T> void updateHistogram(int* histogram, const PiiMatrix<T>& image);
 
+  /**
+   * Returns the number of bytes needed to store the M N-bit codes as
+   * a packed binary descriptor, \(\lceil MN/8 \rceil\).
+   */
+  int descriptorBytes() const;
+
+  /**
+   * Calculates the M N-bit RLBP codes in *image* and stores them as
+   * a packed binary descriptor to *descriptor*, which must have room
+   * for [descriptorBytes()] bytes. Bit *j* of pattern *i* is stored
+   * into bit \(k \bmod 8\) of byte \(\lfloor k/8 \rfloor\), where
+   * \(k = iN + j\). Unused bits in the last byte are set to zero.
+   *
+   * A binary descriptor is a much more compact representation of a
+   * keypoint than a histogram, and it can be compared to others
+   * with PiiHammingDistance.
+   *
+   * ~~~(c++)
+   * PiiRandomLbp rlbp;
+   * rlbp.setParameters(16, 16, 32); // 256 bits
+   * PiiMatrix<unsigned char> matDescriptors(keypoints, rlbp.descriptorBytes());
+   * for (int i=0; i<keypoints; ++i)
+   *   rlbp.calculateDescriptor(matDescriptors[i], windowAround(i));
+   * ~~~
+   */
+  template <class T> void calculateDescriptor(unsigned char* descriptor, const PiiMatrix<T>& image);
+
 private:
   typedef QPair<PiiPoint<int>, PiiPoint<int> > PointPair;
   typedef QVector<PointPair> PointPairList;
@@ -117,4 +154,17 @@ template <class T> void PiiRandomLbp::updateHistogram(int* histogram,
     }
 }
 
+template <class T> void PiiRandomLbp::calculateDescriptor(unsigned char* descriptor,
+                                                          const PiiMatrix<T>& image)
+{
+  const PointPair* pPair = d->vecPointPairs.constData();
+  const int iBits = d->vecPointPairs.size(), iBytes = descriptorBytes();
+  for (int iByte=0; iByte<iBytes; ++iByte)
+    descriptor[iByte] = 0;
+  for (int i=0; i<iBits; ++i, ++pPair)
+    if (Pii::signBit(image(pPair->first.y, pPair->first.x),
+                     image(pPair->second.y, pPair->second.x)))
+      descriptor[i >> 3] |= static_cast<unsigned char>(1 << (i & 7));
+}
+
 #endif //_PIIRANDOMLBP_H
@@ -0,0 +1,325 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiShapeContextKernels.h"
+
+#include <PiiCpu.h>
+#include <PiiMath.h>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_SC_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_SC_AVX2 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_SC_NEON 1
+#endif
+
+namespace
+{
+  /* The tables passed to the loops. Sector boundaries [0,
+     upperSectors) lie in the upper half plane, the rest (negated)
+     in the lower one.
+   */
+  struct Tables
+  {
+    const float* pLimits;
+    int iDistances;
+    const float* pSectorX;
+    const float* pSectorY;
+    int iUpperSectors, iSectors;
+  };
+
+  void binsTail(const Tables& t, float x, float y, float cosine, float sine,
+                const float* xs, const float* ys, int j, int count, int* bins)
+  {
+    const float fMaxDistance = t.pLimits[t.iDistances-1];
+    for (; j<count; ++j)
+      {
+        const float dx = xs[j] - x, dy = ys[j] - y;
+        const float fDistance = dx*dx + dy*dy;
+        if (fDistance == 0 || fDistance >= fMaxDistance)
+          {
+            bins[j] = -1;
+            continue;
+          }
+        int iDistanceBin = 0;
+        for (int c=0; c<t.iDistances; ++c)
+          iDistanceBin += fDistance >= t.pLimits[c] ? 1 : 0;
+
+        // Rotate by -direction and fold the lower half plane onto the upper one.
+        float ux = cosine*dx + sine*dy, uy = cosine*dy - sine*dx;
+        const bool bLower = uy < 0 || (uy == 0 && ux < 0);
+        if (bLower)
+          {
+            ux = -ux;
+            uy = -uy;
+          }
+        int iAngleBin = 0;
+        for (int k=0; k<t.iUpperSectors; ++k)
+          iAngleBin += bLower || t.pSectorX[k]*uy - t.pSectorY[k]*ux >= 0 ? 1 : 0;
+        for (int k=t.iUpperSectors; k<t.iSectors; ++k)
+          iAngleBin += bLower && t.pSectorX[k]*uy - t.pSectorY[k]*ux >= 0 ? 1 : 0;
+
+        bins[j] = iAngleBin * t.iDistances + iDistanceBin;
+      }
+  }
+
+  bool isVectorized()
+  {
+#if defined(PII_SC_SSE2)
+    return Pii::hasCpuFeature(Pii::CpuSse2) || Pii::hasCpuFeature(Pii::CpuAvx2);
+#elif defined(PII_SC_NEON)
+    return Pii::hasCpuFeature(Pii::CpuNeon);
+#else
+    return false;
+#endif
+  }
+}
+
+/* Comparisons produce all-ones masks, which are -1 as integers.
+   Subtracting a mask counts the lanes where a condition holds. The
+   loops are stamped out with a macro because all functions called
+   from an AVX2 loop must have the same target attribute.
+ */
+#define PII_SHAPE_CONTEXT_LOOPS(TARGET)                                 \
+  TARGET void bins(const Tables& t, float x, float y, float cosine, float sine, \
+                   const float* xs, const float* ys, int count, int* bins) \
+  {                                                                     \
+    const Vec vecX = Ops::set(x), vecY = Ops::set(y);                   \
+    const Vec vecCos = Ops::set(cosine), vecSin = Ops::set(sine);       \
+    const Vec vecZero = Ops::set(0), vecMax = Ops::set(t.pLimits[t.iDistances-1]); \
+    const IVec vecDistances = Ops::setInt(t.iDistances);                \
+    int j = 0;                                                          \
+    for (; j <= count - Ops::Width; j += Ops::Width)                    \
+      {                                                                 \
+        const Vec dx = Ops::sub(Ops::load(xs + j), vecX);               \
+        const Vec dy = Ops::sub(Ops::load(ys + j), vecY);               \
+        const Vec distance = Ops::add(Ops::mul(dx, dx), Ops::mul(dy, dy)); \
+        IVec bin = Ops::setInt(0);                                      \
+        for (int c=0; c<t.iDistances; ++c)                              \
+          bin = Ops::count(bin, Ops::ge(distance, Ops::set(t.pLimits[c]))); \
+                                                                        \
+        Vec ux = Ops::add(Ops::mul(vecCos, dx), Ops::mul(vecSin, dy));  \
+        Vec uy = Ops::sub(Ops::mul(vecCos, dy), Ops::mul(vecSin, dx));  \
+        const Mask lower = Ops::either(Ops::lt(uy, vecZero),            \
+                                       Ops::both(Ops::eq(uy, vecZero), Ops::lt(ux, vecZero))); \
+        ux = Ops::negate(ux, lower);                                    \
+        uy = Ops::negate(uy, lower);                                    \
+        for (int k=0; k<t.iUpperSectors; ++k)                           \
+          bin = Ops::addIf(bin, Ops::either(lower, Ops::ge(Ops::sub(Ops::mul(Ops::set(t.pSectorX[k]), uy), \
+                                                                    Ops::mul(Ops::set(t.pSectorY[k]), ux)), \
+                                                           vecZero)), vecDistances); \
+        for (int k=t.iUpperSectors; k<t.iSectors; ++k)                  \
+          bin = Ops::addIf(bin, Ops::both(lower, Ops::ge(Ops::sub(Ops::mul(Ops::set(t.pSectorX[k]), uy), \
+                                                                  Ops::mul(Ops::set(t.pSectorY[k]), ux)), \
+                                                         vecZero)), vecDistances); \
+                                                                        \
+        Ops::store(bins + j, bin, Ops::either(Ops::eq(distance, vecZero), Ops::ge(distance, vecMax))); \
+      }                                                                 \
+    Ops::done();                                                        \
+    binsTail(t, x, y, cosine, sine, xs, ys, j, count, bins);            \
+  }
+
+#ifdef PII_SC_SSE2
+namespace Sse2
+{
+  typedef __m128 Vec;
+  typedef __m128 Mask;
+  typedef __m128i IVec;
+
+  struct Ops
+  {
+    enum { Width = 4 };
+    static inline __m128 load(const float* data) { return _mm_loadu_ps(data); }
+    static inline __m128 set(float value) { return _mm_set1_ps(value); }
+    static inline __m128i setInt(int value) { return _mm_set1_epi32(value); }
+    static inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+    static inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+    static inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+    static inline __m128 ge(__m128 a, __m128 b) { return _mm_cmpge_ps(a, b); }
+    static inline __m128 lt(__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }
+    static inline __m128 eq(__m128 a, __m128 b) { return _mm_cmpeq_ps(a, b); }
+    static inline __m128 either(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+    static inline __m128 both(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+    static inline __m128 negate(__m128 a, __m128 mask) { return _mm_xor_ps(a, _mm_and_ps(mask, _mm_set1_ps(-0.0f))); }
+    static inline __m128i count(__m128i sum, __m128 mask) { return _mm_sub_epi32(sum, _mm_castps_si128(mask)); }
+    static inline __m128i addIf(__m128i sum, __m128 mask, __m128i value)
+    {
+      return _mm_add_epi32(sum, _mm_and_si128(_mm_castps_si128(mask), value));
+    }
+    static inline void store(int* data, __m128i value, __m128 invalid)
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(data), _mm_or_si128(value, _mm_castps_si128(invalid)));
+    }
+    static inline void done() {}
+  };
+
+  PII_SHAPE_CONTEXT_LOOPS(static)
+}
+#endif
+
+#ifdef PII_SC_AVX2
+namespace Avx2
+{
+#  define PII_AVX2 PII_TARGET("avx2")
+
+  typedef __m256 Vec;
+  typedef __m256 Mask;
+  typedef __m256i IVec;
+
+  struct Ops
+  {
+    enum { Width = 8 };
+    PII_AVX2 static inline __m256 load(const float* data) { return _mm256_loadu_ps(data); }
+    PII_AVX2 static inline __m256 set(float value) { return _mm256_set1_ps(value); }
+    PII_AVX2 static inline __m256i setInt(int value) { return _mm256_set1_epi32(value); }
+    PII_AVX2 static inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+    PII_AVX2 static inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+    PII_AVX2 static inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+    PII_AVX2 static inline __m256 ge(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    PII_AVX2 static inline __m256 lt(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    PII_AVX2 static inline __m256 eq(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    PII_AVX2 static inline __m256 either(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+    PII_AVX2 static inline __m256 both(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+    PII_AVX2 static inline __m256 negate(__m256 a, __m256 mask) { return _mm256_xor_ps(a, _mm256_and_ps(mask, _mm256_set1_ps(-0.0f))); }
+    PII_AVX2 static inline __m256i count(__m256i sum, __m256 mask) { return _mm256_sub_epi32(sum, _mm256_castps_si256(mask)); }
+    PII_AVX2 static inline __m256i addIf(__m256i sum, __m256 mask, __m256i value)
+    {
+      return _mm256_add_epi32(sum, _mm256_and_si256(_mm256_castps_si256(mask), value));
+    }
+    PII_AVX2 static inline void store(int* data, __m256i value, __m256 invalid)
+    {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), _mm256_or_si256(value, _mm256_castps_si256(invalid)));
+    }
+    // The scalar tail follows. Avoid AVX-SSE transition penalties.
+    PII_AVX2 static inline void done() { _mm256_zeroupper(); }
+  };
+
+  PII_SHAPE_CONTEXT_LOOPS(PII_AVX2 static)
+
+#  undef PII_AVX2
+}
+#endif
+
+#ifdef PII_SC_NEON
+namespace Neon
+{
+  typedef float32x4_t Vec;
+  typedef uint32x4_t Mask;
+  typedef int32x4_t IVec;
+
+  struct Ops
+  {
+    enum { Width = 4 };
+    static inline float32x4_t load(const float* data) { return vld1q_f32(data); }
+    static inline float32x4_t set(float value) { return vdupq_n_f32(value); }
+    static inline int32x4_t setInt(int value) { return vdupq_n_s32(value); }
+    static inline float32x4_t add(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+    static inline float32x4_t sub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+    static inline float32x4_t mul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+    static inline uint32x4_t ge(float32x4_t a, float32x4_t b) { return vcgeq_f32(a, b); }
+    static inline uint32x4_t lt(float32x4_t a, float32x4_t b) { return vcltq_f32(a, b); }
+    static inline uint32x4_t eq(float32x4_t a, float32x4_t b) { return vceqq_f32(a, b); }
+    static inline uint32x4_t either(uint32x4_t a, uint32x4_t b) { return vorrq_u32(a, b); }
+    static inline uint32x4_t both(uint32x4_t a, uint32x4_t b) { return vandq_u32(a, b); }
+    static inline float32x4_t negate(float32x4_t a, uint32x4_t mask)
+    {
+      return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vandq_u32(mask, vdupq_n_u32(0x80000000u))));
+    }
+    static inline int32x4_t count(int32x4_t sum, uint32x4_t mask) { return vsubq_s32(sum, vreinterpretq_s32_u32(mask)); }
+    static inline int32x4_t addIf(int32x4_t sum, uint32x4_t mask, int32x4_t value)
+    {
+      return vaddq_s32(sum, vandq_s32(vreinterpretq_s32_u32(mask), value));
+    }
+    static inline void store(int* data, int32x4_t value, uint32x4_t invalid)
+    {
+      vst1q_s32(data, vorrq_s32(value, vreinterpretq_s32_u32(invalid)));
+    }
+    static inline void done() {}
+  };
+
+  PII_SHAPE_CONTEXT_LOOPS(static)
+}
+#endif
+
+#undef PII_SHAPE_CONTEXT_LOOPS
+
+PiiShapeContextKernel::PiiShapeContextKernel(int angles, const double* distances, int distanceCount) :
+  iUpperSectors(0)
+{
+  vecLimits.reserve(distanceCount);
+  for (int i=0; i<distanceCount; ++i)
+    vecLimits.append(float(distances[i]));
+
+  // Sector k starts at k*2pi/angles. The first one starts at zero
+  // and needs no test. Boundaries in the lower half plane are
+  // rotated by pi, because the tested vectors will be too.
+  const double dAngleStep = 2*M_PI / angles;
+  for (int k=1; k<angles; ++k)
+    {
+      double dAngle = k * dAngleStep;
+      if (2*k < angles)
+        ++iUpperSectors;
+      else
+        dAngle -= M_PI;
+      double dX = Pii::cos(dAngle), dY = Pii::sin(dAngle);
+      // Make axis-aligned boundaries exact.
+      if (Pii::abs(dX) < 1e-12) dX = 0;
+      if (Pii::abs(dY) < 1e-12) dY = 0;
+      vecSectorX.append(float(dX));
+      vecSectorY.append(float(dY));
+    }
+}
+
+void PiiShapeContextKernel::bins(float x, float y, double direction,
+                                 const float* xs, const float* ys, int count,
+                                 int* bins) const
+{
+  if (vecLimits.isEmpty())
+    {
+      for (int j=0; j<count; ++j)
+        bins[j] = -1;
+      return;
+    }
+
+  Tables t;
+  t.pLimits = vecLimits.constData();
+  t.iDistances = vecLimits.size();
+  t.pSectorX = vecSectorX.constData();
+  t.pSectorY = vecSectorY.constData();
+  t.iUpperSectors = iUpperSectors;
+  t.iSectors = vecSectorX.size();
+
+  const float fCos = direction != 0 ? float(Pii::cos(direction)) : 1.0f;
+  const float fSin = direction != 0 ? float(Pii::sin(direction)) : 0.0f;
+
+  if (!isVectorized())
+    binsTail(t, x, y, fCos, fSin, xs, ys, 0, count, bins);
+#if defined(PII_SC_AVX2)
+  else if (Pii::hasCpuFeature(Pii::CpuAvx2))
+    Avx2::bins(t, x, y, fCos, fSin, xs, ys, count, bins);
+  else
+    Sse2::bins(t, x, y, fCos, fSin, xs, ys, count, bins);
+#elif defined(PII_SC_SSE2)
+  else
+    Sse2::bins(t, x, y, fCos, fSin, xs, ys, count, bins);
+#elif defined(PII_SC_NEON)
+  else
+    Neon::bins(t, x, y, fCos, fSin, xs, ys, count, bins);
+#endif
+}
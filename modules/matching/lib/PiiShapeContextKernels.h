@@ -0,0 +1,67 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISHAPECONTEXTKERNELS_H
+#define _PIISHAPECONTEXTKERNELS_H
+
+#include "PiiMatchingPlugin.h"
+#include <QVector>
+
+/**
+ * Vectorized binning for PiiMatching::shapeContextDescriptor(). The
+ * kernel finds the log-polar histogram bin of a key point for a
+ * whole array of reference points at once, 4 (SSE2, NEON) or 8
+ * (AVX2) points per instruction.
+ *
+ * No trigonometric functions are evaluated per point. The sector
+ * boundaries of the polar histogram are precomputed as unit vectors,
+ * and the angle bin is found by testing the sign of the cross
+ * product between each boundary and the vector from the key point
+ * to the reference point. Likewise, the distance bin is the number
+ * of squared distance limits not greater than the squared distance.
+ * All arithmetic is done in single precision. The scalar fallback
+ * used for the last points and for CPUs without vector instructions
+ * performs the same operations in the same order.
+ *
+ * @internal
+ */
+struct PII_MATCHING_EXPORT PiiShapeContextKernel
+{
+  /**
+   * Precomputes the bin boundaries for a histogram with *angles* ×
+   * *distanceCount* bins. *distances* must contain *distanceCount*
+   * squared distance limits in ascending order.
+   */
+  PiiShapeContextKernel(int angles, const double* distances, int distanceCount);
+
+  /**
+   * Calculates histogram bin indices for *count* reference points
+   * with respect to a key point at (*x*, *y*). The coordinates of
+   * the reference points are in *xs* and *ys*. The angles are
+   * measured relative to *direction* (in radians). *bins* receives
+   * `angleBin * distanceCount + distanceBin` for each point, or -1 if
+   * the point coincides with the key point or is not closer than the
+   * last distance limit.
+   */
+  void bins(float x, float y, double direction,
+            const float* xs, const float* ys, int count,
+            int* bins) const;
+
+  QVector<float> vecLimits;
+  QVector<float> vecSectorX, vecSectorY;
+  int iUpperSectors;
+};
+
+#endif //_PIISHAPECONTEXTKERNELS_H
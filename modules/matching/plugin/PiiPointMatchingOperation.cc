@@ -32,7 +32,10 @@ PiiPointMatchingOperation::Data::Data(int pointDimensions) :
   iPointDimensions(pointDimensions),
   matchingMode(PiiMatching::MatchAllModels),
   bMustSendPoints(false),
-  iClosestMatchCount(pMatcher->closestMatchCount())
+  iClosestMatchCount(pMatcher->closestMatchCount()),
+  iVocabularyBranching(pMatcher->vocabularyBranching()),
+  iMaxCandidateModels(pMatcher->maxCandidateModels()),
+  iHashTableCount(pMatcher->hashTableCount())
 {
 }
 
@@ -94,8 +97,12 @@ void PiiPointMatchingOperation::check(bool reset)
 
 PiiPointMatchingOperation::Matcher* PiiPointMatchingOperation::createMatcher()
 {
+  const PII_D;
   Matcher* pMatcher = new Matcher;
-  pMatcher->setClosestMatchCount(_d()->iClosestMatchCount);
+  pMatcher->setClosestMatchCount(d->iClosestMatchCount);
+  pMatcher->setVocabularyBranching(d->iVocabularyBranching);
+  pMatcher->setMaxCandidateModels(d->iMaxCandidateModels);
+  pMatcher->setHashTableCount(d->iHashTableCount);
   return pMatcher;
 }
 
@@ -463,6 +470,9 @@ PiiPointMatchingOperation* PiiPointMatchingOperation::clone() const
   pNewData->iModelCount = d->iModelCount;
   pNewData->matchingMode = d->matchingMode;
   pNewData->iClosestMatchCount = d->iClosestMatchCount;
+  pNewData->iVocabularyBranching = d->iVocabularyBranching;
+  pNewData->iMaxCandidateModels = d->iMaxCandidateModels;
+  pNewData->iHashTableCount = d->iHashTableCount;
 
   return pNewOperation;
 }
@@ -480,3 +490,36 @@ int PiiPointMatchingOperation::closestMatchCount() const
 {
   return _d()->iClosestMatchCount;
 }
+
+void PiiPointMatchingOperation::setVocabularyBranching(int vocabularyBranching)
+{
+  PII_D;
+  d->pMatcher->setVocabularyBranching(d->iVocabularyBranching = vocabularyBranching);
+}
+
+int PiiPointMatchingOperation::vocabularyBranching() const
+{
+  return _d()->iVocabularyBranching;
+}
+
+void PiiPointMatchingOperation::setMaxCandidateModels(int maxCandidateModels)
+{
+  PII_D;
+  d->pMatcher->setMaxCandidateModels(d->iMaxCandidateModels = maxCandidateModels);
+}
+
+int PiiPointMatchingOperation::maxCandidateModels() const
+{
+  return _d()->iMaxCandidateModels;
+}
+
+void PiiPointMatchingOperation::setHashTableCount(int hashTableCount)
+{
+  PII_D;
+  d->pMatcher->setHashTableCount(d->iHashTableCount = hashTableCount);
+}
+
+int PiiPointMatchingOperation::hashTableCount() const
+{
+  return _d()->iHashTableCount;
+}
@@ -152,6 +152,32 @@ class PII_MATCHING_EXPORT PiiPointMatchingOperation : public PiiClassifierOperat
    */
   Q_PROPERTY(int closestMatchCount READ closestMatchCount WRITE setClosestMatchCount);
 
+  /**
+   * The branching factor of a vocabulary tree used for retrieving
+   * candidate models (see
+   * PiiFeaturePointMatcher::setVocabularyBranching()). Zero disables
+   * the vocabulary tree. Use this with large model databases. Takes
+   * effect when the database is rebuilt. The default is 0.
+   */
+  Q_PROPERTY(int vocabularyBranching READ vocabularyBranching WRITE setVocabularyBranching);
+
+  /**
+   * The maximum number of candidate models verified per query. Zero
+   * means no limit. The default is 0.
+   */
+  Q_PROPERTY(int maxCandidateModels READ maxCandidateModels WRITE setMaxCandidateModels);
+
+  /**
+   * The number of hash tables used for indexing binary descriptors
+   * (see PiiFeaturePointMatcher::setHashTableCount()). If this value
+   * is positive, each feature must be a byte of a packed binary
+   * descriptor, such as those produced by
+   * PiiRandomLbp::calculateDescriptor(), and the descriptors are
+   * compared with the Hamming distance. Zero disables hashing. Takes
+   * effect when the database is rebuilt. The default is 0.
+   */
+  Q_PROPERTY(int hashTableCount READ hashTableCount WRITE setHashTableCount);
+
   friend struct PiiSerialization::Accessor;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
   {
@@ -226,6 +252,9 @@ protected:
     PiiMatching::ModelMatchingMode matchingMode;
     bool bMustSendPoints;
     int iClosestMatchCount;
+    int iVocabularyBranching;
+    int iMaxCandidateModels;
+    int iHashTableCount;
   };
   PII_D_FUNC;
 
@@ -244,6 +273,12 @@ protected:
   PiiMatching::ModelMatchingMode matchingMode() const;
   void setClosestMatchCount(int closestMatchCount);
   int closestMatchCount() const;
+  void setVocabularyBranching(int vocabularyBranching);
+  int vocabularyBranching() const;
+  void setMaxCandidateModels(int maxCandidateModels);
+  int maxCandidateModels() const;
+  void setHashTableCount(int hashTableCount);
+  int hashTableCount() const;
 
   bool learnBatch();
   void replaceClassifier();
@@ -37,6 +37,8 @@ class PII_MATCHING_EXPORT PiiRansacPointMatcher : public PiiPointMatchingOperati
   Q_PROPERTY(int minInliers READ minInliers WRITE setMinInliers);
   Q_PROPERTY(double fittingThreshold READ fittingThreshold WRITE setFittingThreshold);
   Q_PROPERTY(double selectionProbability READ selectionProbability WRITE setSelectionProbability);
+  Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
+  Q_PROPERTY(int preemptiveSampleCount READ preemptiveSampleCount WRITE setPreemptiveSampleCount);
 
 public:
   void setMaxIterations(int maxIterations);
@@ -49,6 +51,10 @@ public:
   double fittingThreshold() const;
   void setSelectionProbability(double selectionProbability);
   double selectionProbability() const;
+  void setThreadCount(int threadCount);
+  int threadCount() const;
+  void setPreemptiveSampleCount(int preemptiveSampleCount);
+  int preemptiveSampleCount() const;
 
 protected:
   /// @internal
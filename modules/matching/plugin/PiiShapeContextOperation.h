@@ -179,6 +179,25 @@ class PiiShapeContextOperation : public PiiDefaultOperation
   Q_PROPERTY(ShapeJoiningMode shapeJoiningMode READ shapeJoiningMode WRITE setShapeJoiningMode);
   Q_ENUMS(ShapeJoiningMode);
 
+  /**
+   * The maximum number of boundary points each key point is compared
+   * to. The cost of the descriptor is proportional to the number of
+   * key points times the number of boundary points. With objects
+   * that have thousands of boundary points, an evenly spaced subset
+   * of this many points is used as the reference for the
+   * histograms. Zero means all points. The default is zero.
+   */
+  Q_PROPERTY(int maxReferencePoints READ maxReferencePoints WRITE setMaxReferencePoints);
+
+  /**
+   * The number of threads used for calculating the descriptors of
+   * one object. The key points are divided among the threads (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one, which processes each object in the processing
+   * thread only.
+   */
+  Q_PROPERTY(int descriptorThreadCount READ descriptorThreadCount WRITE setDescriptorThreadCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -243,6 +262,10 @@ protected:
   PiiMatching::InvarianceFlags invariance() const;
   void setMaxPoints(int maxPoints);
   int maxPoints() const;
+  void setMaxReferencePoints(int maxReferencePoints);
+  int maxReferencePoints() const;
+  void setDescriptorThreadCount(int descriptorThreadCount);
+  int descriptorThreadCount() const;
 
 private:
   void processBoundary(const PiiMatrix<int>& boundary, const PiiMatrix<int>& limits);
@@ -286,6 +309,8 @@ private:
     PiiOutputSocket *pPointsOutput, *pFeaturesOutput, *pBoundariesOutput, *pLimitsOutput;
     int iLastImageRows, iLastImageColumns;
     int iMaxPoints;
+    int iMaxReferencePoints;
+    int iDescriptorThreadCount;
   };
   PII_D_FUNC;
 };
@@ -4,32 +4,51 @@ include($$INTODIR/extensions.pri)
 TEMPLATE = subdirs
 
 # Directories
-SUBDIRS = base \
-          camera \
-          classification \
-          colors \
-          calibration \
-          database \
-          dsp \
-          flowcontrol \
-          geometry \
-          image \
-          io \
-          matching \
-          network \
-          optimization \
-          statistics \
-          texture \
-          tracking \
-          transforms \
-          video
+qt {
+  SUBDIRS = base \
+            camera \
+            classification \
+            colors \
+            calibration \
+            database \
+            dsp \
+            flowcontrol \
+            geometry \
+            image \
+            io \
+            matching \
+            network \
+            optimization \
+            statistics \
+            texture \
+            tracking \
+            transforms \
+            video
+} else {
+  # Without Qt, only the lib directories are built. Modules that
+  # have nothing but operations are left out.
+  SUBDIRS = camera \
+            classification \
+            colors \
+            dsp \
+            geometry \
+            image \
+            matching \
+            optimization \
+            texture \
+            tracking \
+            transforms
+}
 
 enabled(opencv) {
   SUBDIRS += opencv
   opencv.depends += image
+  !qt: SUBDIRS += calibration
   calibration.depends += opencv
 }
 
+enabled(opencl): SUBDIRS += gpu
+
 image.depends += dsp
 geometry.depends += dsp
 video.depends += image
@@ -22,7 +22,6 @@
 #include <PiiMultipartStreamBuffer.h>
 #include <PiiYdinTypes.h>
 #include <PiiOneGroupFlowController.h>
-#include <PiiGenericTextOutputArchive.h>
 #include <PiiLog.h>
 
 PiiNetworkInputOperation::Data::Data() :
@@ -30,7 +29,8 @@ PiiNetworkInputOperation::Data::Data() :
   bOwnServer(false),
   bNeedToWaitResponse(false),
   bStatusConnected(false),
-  iStatusCode(200),
+  iReservedSlots(0),
+  iMaxRequestsInFlight(1),
   strInterruptedResponse("The operation was interrupted."),
   strTimeoutResponse("Timed out while waiting for response")
 {
@@ -121,31 +121,77 @@ void PiiNetworkInputOperation::check(bool reset)
   d->pServer->protocol()->registerUriHandler(strUri, this);
 
   d->strCurrentContentType = d->strContentType;
-  d->strResponseData = "";
-  d->iStatusCode = 200;
   d->bStatusConnected = d->pStatusInput->isConnected();
+
+  // Responses to requests of a previous run will never come.
+  synchronized (d->responseMutex)
+    {
+      d->lstPendingResponses.clear();
+      d->responseCondition.wakeAll();
+    }
 }
 
 void PiiNetworkInputOperation::process()
 {
   PII_D;
+  Response response;
   if (d->bBodyConnected)
     {
-      d->strResponseData = PiiYdin::convertToQString(d->pBodyInput);
+      response.strData = PiiYdin::convertToQString(d->pBodyInput);
       if (d->bTypeConnected)
         d->strCurrentContentType = PiiYdin::convertToQString(d->pTypeInput);
+      response.strContentType = d->strCurrentContentType;
     }
   else
     {
-      d->lstResponseValues.clear();
       for (int i=0; i<d->lstInputNames.size(); ++i)
-        d->lstResponseValues << inputAt(i+d->iStaticInputCount)->firstObject();
+        response.lstValues << inputAt(i+d->iStaticInputCount)->firstObject();
     }
 
   if (d->bStatusConnected)
-    d->iStatusCode = PiiYdin::primitiveAs<int>(d->pStatusInput);
+    response.iStatusCode = PiiYdin::primitiveAs<int>(d->pStatusInput);
 
-  d->responseCondition.wakeOne();
+  // The oldest pending request gets the response.
+  QMutexLocker lock(&d->responseMutex);
+  if (d->lstPendingResponses.isEmpty())
+    {
+      piiWarning("Received a response, but no request is waiting for one.");
+      return;
+    }
+  Response* pResponse = d->lstPendingResponses.takeFirst();
+  // Zero means that the client has gone already.
+  if (pResponse != 0)
+    {
+      *pResponse = response;
+      pResponse->bDone = true;
+    }
+  d->responseCondition.wakeAll();
+}
+
+// Waits until a new request can be passed to the pipeline and
+// reserves a place for it. Returns false if the request must be
+// rejected.
+bool PiiNetworkInputOperation::waitForResponseSlot(PiiHttpDevice* h,
+                                                   PiiHttpProtocol::TimeLimiter* controller,
+                                                   bool* timedOut)
+{
+  PII_D;
+  QMutexLocker lock(&d->responseMutex);
+  QTime t;
+  t.start();
+  while (d->lstPendingResponses.size() + d->iReservedSlots >= d->iMaxRequestsInFlight)
+    {
+      if (d->state != Running || !h->isWritable() || !controller->canContinue())
+        return false;
+      if (t.elapsed() > d->iResponseTimeout)
+        {
+          *timedOut = true;
+          return false;
+        }
+      d->responseCondition.wait(&d->responseMutex, 100);
+    }
+  ++d->iReservedSlots;
+  return true;
 }
 
 void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
@@ -159,10 +205,27 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
       return;
     }
 
-  QMutexLocker lock(&d->requestLock);
+  bool bTimedOut = false;
+  // Reserve a place in the pipeline before decoding the request so
+  // that the pipeline never has more than iMaxRequestsInFlight
+  // requests.
+  bool bNeedToWaitResponse = d->bNeedToWaitResponse;
+  if (bNeedToWaitResponse && !waitForResponseSlot(h, controller, &bTimedOut))
+    {
+      if (h->isWritable())
+        {
+          h->setStatus(bTimedOut ? 500 : 503);
+          h->print(bTimedOut ? d->strTimeoutResponse : d->strInterruptedResponse);
+        }
+      return;
+    }
+
+  Response response;
+  bool bEmitted = false;
 
   try
     {
+      QMutexLocker lock(&d->requestLock);
       //piiDebug("%s", h->requestHeader().toByteArray().constData());
       // Parse request body
       if (h->requestMethod() == "POST" &&
@@ -171,55 +234,26 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
           if (!d->bIgnoreErrors)
             PII_THROW(PiiExecutionException, tr("Client sent an invalid request."));
           h->setStatus(422); // Unprocessable entity
-          return;
         }
-      // Add query values (GET parameters)
-      addToOutputMap(h->queryValues());
-
-      //qDebug() << d->mapOutputValues;
-
-      // All objects are here
-      if (d->mapOutputValues.size() >= d->lstOutputNames.size())
+      else
         {
-          d->responseCondition.wakeAll();
-          emitOutputValues();
+          // Add query values (GET parameters)
+          addToOutputMap(h->queryValues());
 
-          bool bTimedOut = false;
-
-          // If there are connected inputs, must wait for response now
-          if (d->bNeedToWaitResponse)
-            {
-              QTime t;
-              t.start();
-              while ((d->state == Running || d->state == Pausing) &&
-                     h->isWritable() && controller->canContinue())
-                {
-                  if (t.elapsed() > d->iResponseTimeout)
-                    {
-                      bTimedOut = true;
-                      break;
-                    }
-                  if (d->responseCondition.wait(100))
-                    {
-                      replyToClient(h);
-                      return;
-                    }
-                }
-            }
+          //qDebug() << d->mapOutputValues;
 
-          if (h->isWritable())
+          // All objects are here
+          if (d->mapOutputValues.size() >= d->lstOutputNames.size())
             {
-              // The operation is being stopped, but client is connected
-              if (d->state == Stopping || d->state == Stopped || d->state == Interrupted)
-                {
-                  h->setStatus(500); // internal server error
-                  h->print(d->strInterruptedResponse);
-                }
-              else if (bTimedOut)
-                {
-                  h->setStatus(500);
-                  h->print(d->strTimeoutResponse);
-                }
+              // The response will come in emission order.
+              if (bNeedToWaitResponse)
+                synchronized (d->responseMutex)
+                  {
+                    d->lstPendingResponses << &response;
+                    --d->iReservedSlots;
+                  }
+              bEmitted = true;
+              emitOutputValues();
             }
         }
     }
@@ -229,27 +263,88 @@ void PiiNetworkInputOperation::handleRequest(const QString& /*uri*/,
       h->print(ex.message());
       piiWarning(ex.message());
       piiWarning(ex.info());
-      return;
     }
   catch (PiiException& ex)
     {
       h->setStatus(422); // Unprocessable entity
       h->print(ex.message());
       piiWarning(ex.message());
+    }
+
+  if (!bNeedToWaitResponse)
+    return;
+
+  QMutexLocker lock(&d->responseMutex);
+  if (!bEmitted)
+    {
+      // Release the reserved place.
+      --d->iReservedSlots;
+      d->responseCondition.wakeAll();
       return;
     }
+
+  // Wait for the response to this request.
+  QTime t;
+  t.start();
+  while (!response.bDone &&
+         (d->state == Running || d->state == Pausing) &&
+         h->isWritable() && controller->canContinue())
+    {
+      if (t.elapsed() > d->iResponseTimeout)
+        {
+          bTimedOut = true;
+          break;
+        }
+      d->responseCondition.wait(&d->responseMutex, 100);
+    }
+
+  if (!response.bDone)
+    {
+      // The response will still come, and the place in the queue
+      // must be kept.
+      int iIndex = d->lstPendingResponses.indexOf(&response);
+      if (iIndex != -1)
+        d->lstPendingResponses[iIndex] = 0;
+      lock.unlock();
+
+      if (h->isWritable())
+        {
+          // The operation is being stopped, but client is connected
+          if (d->state == Stopping || d->state == Stopped || d->state == Interrupted)
+            {
+              h->setStatus(500); // internal server error
+              h->print(d->strInterruptedResponse);
+            }
+          else if (bTimedOut)
+            {
+              h->setStatus(500);
+              h->print(d->strTimeoutResponse);
+            }
+        }
+      return;
+    }
+  lock.unlock();
+
+  try
+    {
+      replyToClient(h, response);
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+    }
 }
 
-void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
+void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h, const Response& response)
 {
   PII_D;
-  h->setStatus(d->iStatusCode);
+  h->setStatus(response.iStatusCode);
 
   if (d->bBodyConnected)
     {
       h->startOutputFiltering(new PiiStreamBuffer);
-      h->setHeader("Content-Type", d->strCurrentContentType);
-      h->print(d->strResponseData);
+      h->setHeader("Content-Type", response.strContentType);
+      h->print(response.strData);
     }
   // Only one input -> serialize a single object
   else if (d->lstInputNames.size() == 1)
@@ -259,18 +354,16 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
 
       // Everything but QStrings are marshalled with the standard
       // serialization mechanism.
-      if (d->lstResponseValues[0].type() != PiiYdin::QStringType)
+      if (response.lstValues[0].type() != PiiYdin::QStringType)
         {
-          h->setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
-
-          PiiGenericTextOutputArchive outputArchive(h);
-          outputArchive << d->lstResponseValues[0];
+          h->setHeader("Content-Type", objectContentType());
+          writeObject(*h, response.lstValues[0]);
         }
       // QStrings are just printed as such.
       else
         {
           h->setHeader("Content-Type", "text/plain");
-          h->print(d->lstResponseValues[0].valueAs<QString>());
+          h->print(response.lstValues[0].valueAs<QString>());
         }
     }
   else
@@ -278,14 +371,13 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
       QString strBoundary("243F6A8885A308D31319");
       h->setHeader("Content-Type", "multipart/mixed; boundary=\"" + strBoundary + "\"");
 
-      for (int i=0; i<d->lstResponseValues.size(); ++i)
+      for (int i=0; i<response.lstValues.size(); ++i)
         {
           PiiMultipartStreamBuffer* bfr = new PiiMultipartStreamBuffer(strBoundary);
           bfr->setHeader(pContentNameHeader, d->lstInputNames[i]);
-          bfr->setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
+          bfr->setHeader("Content-Type", objectContentType());
           h->startOutputFiltering(bfr);
-          PiiGenericTextOutputArchive outputArchive(h);
-          outputArchive << d->lstResponseValues[i];
+          writeObject(*h, response.lstValues[i]);
           h->endOutputFiltering();
           if (!h->isWritable())
             {
@@ -296,7 +388,6 @@ void PiiNetworkInputOperation::replyToClient(PiiHttpDevice* h)
         }
       h->print("\r\n--" + strBoundary + "--\r\n");
     }
-  d->lstResponseValues.clear();
 }
 
 void PiiNetworkInputOperation::setHttpServer(const QString& httpServer) { _d()->strHttpServer = httpServer; }
@@ -307,3 +398,5 @@ void PiiNetworkInputOperation::setInterruptedResponse(const QString& interrupted
 QString PiiNetworkInputOperation::interruptedResponse() const { return _d()->strInterruptedResponse; }
 void PiiNetworkInputOperation::setTimeoutResponse(const QString& timeoutResponse) { _d()->strTimeoutResponse = timeoutResponse; }
 QString PiiNetworkInputOperation::timeoutResponse() const { return _d()->strTimeoutResponse; }
+void PiiNetworkInputOperation::setMaxRequestsInFlight(int maxRequestsInFlight) { _d()->iMaxRequestsInFlight = qMax(1, maxRequestsInFlight); }
+int PiiNetworkInputOperation::maxRequestsInFlight() const { return _d()->iMaxRequestsInFlight; }
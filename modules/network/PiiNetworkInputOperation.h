@@ -19,7 +19,7 @@
 #include <QMutex>
 #include <QStringList>
 #include <PiiHttpProtocol.h>
-#include <PiiWaitCondition.h>
+#include <QWaitCondition>
 
 #include "PiiNetworkOperation.h"
 
@@ -99,6 +99,18 @@ class PiiHttpServer;
  * `double` will be tried next, and if that is not successful, the value
  * will be used as a string.
  *
+ * Concurrent requests
+ * -------------------
+ *
+ * If response inputs are connected, each request that passes objects
+ * to the pipeline waits for its response. By default, only one
+ * request is in the pipeline at a time, and throughput is limited to
+ * one request per pipeline latency. Setting [maxRequestsInFlight] to
+ * a larger value lets new requests enter the pipeline while previous
+ * ones are still being processed. Since objects travel through the
+ * pipeline in order, responses are matched to clients in the order
+ * the requests were emitted. Therefore, the configuration must
+ * produce exactly one response for each request.
  */
 class PiiNetworkInputOperation : public PiiNetworkOperation,
                                  public PiiHttpProtocol::UriHandler
@@ -143,6 +155,14 @@ class PiiNetworkInputOperation : public PiiNetworkOperation,
    */
   Q_PROPERTY(QString timeoutResponse READ timeoutResponse WRITE setTimeoutResponse);
 
+  /**
+   * The maximum number of requests whose responses can be pending at
+   * the same time. If this many requests are in the pipeline, new
+   * requests wait until a response has been sent. The default is 1.
+   * Has no effect unless response inputs are connected.
+   */
+  Q_PROPERTY(int maxRequestsInFlight READ maxRequestsInFlight WRITE setMaxRequestsInFlight);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -164,13 +184,27 @@ public:
   QString interruptedResponse() const;
   void setTimeoutResponse(const QString& timeoutResponse);
   QString timeoutResponse() const;
+  void setMaxRequestsInFlight(int maxRequestsInFlight);
+  int maxRequestsInFlight() const;
 
 protected:
   void process();
 
 private:
-  void replyToClient(PiiHttpDevice* h);
+  /// @internal
+  struct Response
+  {
+    Response() : bDone(false), iStatusCode(200) {}
+
+    bool bDone;
+    int iStatusCode;
+    QString strContentType, strData;
+    QList<PiiVariant> lstValues;
+  };
+
+  void replyToClient(PiiHttpDevice* h, const Response& response);
   void destroyServer();
+  bool waitForResponseSlot(PiiHttpDevice* h, PiiHttpProtocol::TimeLimiter* controller, bool* timedOut);
 
   /// @internal
   class Data : public PiiNetworkOperation::Data
@@ -181,17 +215,21 @@ private:
     PiiHttpServer* pServer;
     bool bOwnServer;
     bool bNeedToWaitResponse;
-    PiiWaitCondition responseCondition;
     QMutex requestLock;
 
     PiiInputSocket* pStatusInput;
     bool bStatusConnected;
-    int iStatusCode;
 
-    QList<PiiVariant> lstResponseValues;
+    // Requests in the pipeline in emission order. The handler owns
+    // each Response and replaces its entry with zero if it gives up
+    // waiting. Guarded by responseMutex.
+    QList<Response*> lstPendingResponses;
+    int iReservedSlots;
+    int iMaxRequestsInFlight;
+    QMutex responseMutex;
+    QWaitCondition responseCondition;
 
     QString strCurrentContentType;
-    QString strResponseData;
 
     QString strHttpServer;
     QString strUri;
@@ -18,6 +18,8 @@
 #include <PiiMimeHeader.h>
 #include <PiiMultipartDecoder.h>
 #include <PiiGenericTextInputArchive.h>
+#include <PiiGenericTextOutputArchive.h>
+#include <PiiWireFormat.h>
 
 #include <QTextCodec>
 #if QT_VERSION >= 0x050000
@@ -32,7 +34,8 @@ const char* PiiNetworkOperation::pContentNameHeader = "Content-Name";
 PiiNetworkOperation::Data::Data() :
   bIgnoreErrors(false),
   strContentType("text/plain"),
-  iResponseTimeout(5000)
+  iResponseTimeout(5000),
+  objectEncoding(TextArchiveEncoding)
 {
 }
 
@@ -101,9 +104,10 @@ bool PiiNetworkOperation::decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& h
   QString strContentType = header.contentType();
   //qDebug("Decoding %s", qPrintable(strContentType));
   // The server responded with/client sent one serialized object
-  if (strContentType == PiiNetwork::pTextArchiveContentType)
+  if (strContentType == PiiNetwork::pTextArchiveContentType ||
+      strContentType == PiiNetwork::pVariantContentType)
     {
-      addToOutputMap(header.value(pContentNameHeader), h);
+      addToOutputMap(header.value(pContentNameHeader), h, strContentType);
       return true;
     }
   else if (strContentType.startsWith("multipart/"))
@@ -113,8 +117,10 @@ bool PiiNetworkOperation::decodeObjects(PiiHttpDevice& h, const PiiMimeHeader& h
       while (decoder.nextMessage())
         {
           // PENDING Content-Disposition: form-data; name="name"
-          if (decoder.header().contentType() == PiiNetwork::pTextArchiveContentType)
-            addToOutputMap(decoder.header().value(pContentNameHeader), decoder);
+          QString strPartType = decoder.header().contentType();
+          if (strPartType == PiiNetwork::pTextArchiveContentType ||
+              strPartType == PiiNetwork::pVariantContentType)
+            addToOutputMap(decoder.header().value(pContentNameHeader), decoder, strPartType);
           else
             decoder.readAll();
         }
@@ -181,17 +187,44 @@ void PiiNetworkOperation::addToOutputMap(const QString& name, const QVariant& va
   d->mapOutputValues[name] = PiiVariant(value.toString());
 }
 
-void PiiNetworkOperation::addToOutputMap(const QString& name, QIODevice& device)
+void PiiNetworkOperation::addToOutputMap(const QString& name, QIODevice& device, const QString& contentType)
 {
   PII_D;
-  PiiGenericTextInputArchive inputArchive(&device);
   PiiVariant obj;
-  inputArchive >> obj;
+  if (contentType == PiiNetwork::pVariantContentType)
+    obj = PiiWireFormat::read(&device);
+  else
+    {
+      PiiGenericTextInputArchive inputArchive(&device);
+      inputArchive >> obj;
+    }
   // If the name of the output is not given, we use the name of the
   // first output.
   d->mapOutputValues[name.isEmpty() ? d->lstOutputNames[0] : name] = obj;
 }
 
+const char* PiiNetworkOperation::objectContentType() const
+{
+  return _d()->objectEncoding == TextArchiveEncoding ?
+    PiiNetwork::pTextArchiveContentType :
+    PiiNetwork::pVariantContentType;
+}
+
+void PiiNetworkOperation::writeObject(QIODevice& device, const PiiVariant& obj)
+{
+  PII_D;
+  if (d->objectEncoding == TextArchiveEncoding)
+    {
+      PiiGenericTextOutputArchive outputArchive(&device);
+      outputArchive << obj;
+    }
+  else
+    PiiWireFormat::write(&device, obj,
+                         d->objectEncoding == CompressedEncoding ?
+                         PiiWireFormat::FastCompression :
+                         PiiWireFormat::NoCompression);
+}
+
 void PiiNetworkOperation::emitOutputValues()
 {
   PII_D;
@@ -239,3 +272,5 @@ void PiiNetworkOperation::setIgnoreErrors(bool ignoreErrors) { _d()->bIgnoreErro
 bool PiiNetworkOperation::ignoreErrors() const { return _d()->bIgnoreErrors; }
 void PiiNetworkOperation::setResponseTimeout(int responseTimeout) { _d()->iResponseTimeout = responseTimeout; }
 int PiiNetworkOperation::responseTimeout() const { return _d()->iResponseTimeout; }
+void PiiNetworkOperation::setObjectEncoding(ObjectEncoding objectEncoding) { _d()->objectEncoding = objectEncoding; }
+PiiNetworkOperation::ObjectEncoding PiiNetworkOperation::objectEncoding() const { return _d()->objectEncoding; }
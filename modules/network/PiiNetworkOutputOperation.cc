@@ -19,7 +19,6 @@
 #include <PiiHttpDevice.h>
 #include <PiiStreamBuffer.h>
 #include <PiiYdinTypes.h>
-#include <PiiGenericTextOutputArchive.h>
 
 #include <QUrl>
 
@@ -149,13 +148,8 @@ void PiiNetworkOutputOperation::sendPostRequest()
           // Everything but QStrings are serializer
           if (obj.type() != PiiYdin::QStringType)
             {
-              h.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
-
-              PiiGenericTextOutputArchive outputArchive(&h);
-              outputArchive << inputAt(i+d->iStaticInputCount)->firstObject();
-
-              // This if block ensures the archive flushes itself to the
-              // device before finish().
+              h.setHeader("Content-Type", objectContentType());
+              writeObject(h, obj);
             }
           // QStrings are just printed
           else
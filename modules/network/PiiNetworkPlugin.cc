@@ -17,8 +17,16 @@
 
 #include "PiiNetworkInputOperation.h"
 #include "PiiNetworkOutputOperation.h"
+#include "PiiSharedMemoryInputOperation.h"
+#include "PiiSharedMemoryOutputOperation.h"
+#include "PiiStreamInputOperation.h"
+#include "PiiStreamOutputOperation.h"
 
 PII_IMPLEMENT_PLUGIN(PiiNetworkPlugin);
 
 PII_REGISTER_OPERATION(PiiNetworkInputOperation);
 PII_REGISTER_OPERATION(PiiNetworkOutputOperation);
+PII_REGISTER_OPERATION(PiiSharedMemoryInputOperation);
+PII_REGISTER_OPERATION(PiiSharedMemoryOutputOperation);
+PII_REGISTER_OPERATION(PiiStreamInputOperation);
+PII_REGISTER_OPERATION(PiiStreamOutputOperation);
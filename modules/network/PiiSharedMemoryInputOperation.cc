@@ -0,0 +1,198 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiSharedMemoryInputOperation.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiWireFormat.h>
+#include <PiiBufferLease.h>
+#include <PiiSerializationException.h>
+#include <PiiDelay.h>
+#include <cstring>
+
+namespace
+{
+  // Gives a slot back to the writer once the last matrix referencing
+  // it has been destroyed. The lease keeps the segment mapped.
+  class SlotLease : public PiiBufferLease
+  {
+  public:
+    SlotLease(PiiSharedMemoryRing* ring, PiiSharedMemoryRing::Slot* slot) :
+      _pRing(ring), _pSlot(slot)
+    {
+      _pRing->reserve();
+    }
+
+  protected:
+    void returnBuffer()
+    {
+      _pSlot->state.storeRelease(PiiSharedMemoryRing::FreeSlot);
+      _pRing->release();
+    }
+
+  private:
+    PiiSharedMemoryRing* _pRing;
+    PiiSharedMemoryRing::Slot* _pSlot;
+  };
+}
+
+PiiSharedMemoryInputOperation::Data::Data() :
+  bZeroCopy(true),
+  pRing(0)
+{
+}
+
+PiiSharedMemoryInputOperation::PiiSharedMemoryInputOperation() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiOutputSocket("output"));
+
+  setProtectionLevel("segmentName", WriteWhenStoppedOrPaused);
+}
+
+PiiSharedMemoryInputOperation::~PiiSharedMemoryInputOperation()
+{
+  releaseRing();
+}
+
+void PiiSharedMemoryInputOperation::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  if (d->strSegmentName.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Shared memory segment name has not been set."));
+
+  // The segment is attached in process() because the writer may be
+  // started later.
+  if (reset)
+    releaseRing();
+}
+
+void PiiSharedMemoryInputOperation::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    releaseRing();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiSharedMemoryInputOperation::releaseRing()
+{
+  PII_D;
+  if (d->pRing != 0)
+    {
+      d->pRing->release();
+      d->pRing = 0;
+    }
+}
+
+void PiiSharedMemoryInputOperation::process()
+{
+  PII_D;
+  if (d->pRing == 0)
+    {
+      PiiSharedMemoryRing* pRing = new PiiSharedMemoryRing(d->strSegmentName);
+      if (!pRing->attach())
+        {
+          pRing->release();
+          // No writer yet. The processor calls us again.
+          PiiDelay::msleep(100);
+          return;
+        }
+      d->pRing = pRing;
+    }
+
+  const int iSequence = d->pRing->readSequence().load();
+  PiiSharedMemoryRing::Slot* pSlot = d->pRing->slot(iSequence);
+  // Time out now and then to let the processor check for state
+  // changes.
+  if (!PiiSharedMemoryRing::waitForState(pSlot, PiiSharedMemoryRing::WrittenSlot, 100))
+    return;
+
+  pSlot->state.storeRelease(PiiSharedMemoryRing::ReadingSlot);
+  d->pRing->readSequence().storeRelease(iSequence + 1);
+
+  if (pSlot->uiEncoding == PiiSharedMemoryRing::MatrixEncoding)
+    {
+      switch (pSlot->uiType)
+        {
+          PII_ALL_MATRIX_CASES_M(emitMatrix, (pSlot));
+          PII_COLOR_IMAGE_CASES_M(emitMatrix, (pSlot));
+        default:
+          freeSlotAndThrow(pSlot, tr("Received a matrix of unknown type 0x%1.").arg(pSlot->uiType, 0, 16));
+        }
+    }
+  else
+    emitEncoded(pSlot);
+}
+
+template <class T> void PiiSharedMemoryInputOperation::emitMatrix(PiiSharedMemoryRing::Slot* slot)
+{
+  PII_D;
+  const int iRows = slot->iRows, iColumns = slot->iColumns;
+  const std::size_t iRowBytes = std::size_t(iColumns) * sizeof(T);
+  if (iRows < 0 || iColumns < 0 ||
+      quint64(iRowBytes) * quint64(iRows) != slot->uiBytes ||
+      slot->uiBytes > quint32(d->pRing->slotSize()))
+    freeSlotAndThrow(slot, tr("Received a corrupted matrix descriptor."));
+
+  char* pData = d->pRing->payload(slot);
+  if (d->bZeroCopy && slot->uiBytes > 0)
+    {
+      PiiBufferLease* pLease = new SlotLease(d->pRing, slot);
+      PiiMatrix<T> matrix(iRows, iColumns, pData, pLease);
+      pLease->release();
+      emitObject(matrix);
+    }
+  else
+    {
+      PiiMatrix<T> matrix(PiiMatrix<T>::uninitialized(iRows, iColumns));
+      for (int r=0; r<iRows; ++r, pData += iRowBytes)
+        memcpy(matrix.row(r), pData, iRowBytes);
+      slot->state.storeRelease(PiiSharedMemoryRing::FreeSlot);
+      emitObject(matrix);
+    }
+}
+
+void PiiSharedMemoryInputOperation::emitEncoded(PiiSharedMemoryRing::Slot* slot)
+{
+  PII_D;
+  if (slot->uiBytes > quint32(d->pRing->slotSize()))
+    freeSlotAndThrow(slot, tr("Received a corrupted object descriptor."));
+
+  PiiVariant obj;
+  try
+    {
+      // Decoding copies the data.
+      obj = PiiWireFormat::decode(QByteArray::fromRawData(d->pRing->payload(slot), int(slot->uiBytes)));
+    }
+  catch (PiiSerializationException& ex)
+    {
+      freeSlotAndThrow(slot, tr("Cannot decode a received object: %1").arg(ex.message()));
+    }
+  slot->state.storeRelease(PiiSharedMemoryRing::FreeSlot);
+  emitObject(obj);
+}
+
+void PiiSharedMemoryInputOperation::freeSlotAndThrow(PiiSharedMemoryRing::Slot* slot, const QString& message)
+{
+  slot->state.storeRelease(PiiSharedMemoryRing::FreeSlot);
+  PII_THROW(PiiExecutionException, message);
+}
+
+void PiiSharedMemoryInputOperation::setSegmentName(const QString& segmentName) { _d()->strSegmentName = segmentName; }
+QString PiiSharedMemoryInputOperation::segmentName() const { return _d()->strSegmentName; }
+void PiiSharedMemoryInputOperation::setZeroCopy(bool zeroCopy) { _d()->bZeroCopy = zeroCopy; }
+bool PiiSharedMemoryInputOperation::zeroCopy() const { return _d()->bZeroCopy; }
+bool PiiSharedMemoryInputOperation::isAttached() const { return _d()->pRing != 0; }
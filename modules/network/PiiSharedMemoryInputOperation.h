@@ -0,0 +1,99 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIISHAREDMEMORYINPUTOPERATION_H
+#define _PIISHAREDMEMORYINPUTOPERATION_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiSharedMemoryRing.h"
+
+/**
+ * Receives objects sent by PiiSharedMemoryOutputOperation in another
+ * process on the same computer. The operation attaches to the shared
+ * memory segment given by [segmentName] and emits objects in the
+ * order they were written. If the segment does not exist yet, the
+ * operation keeps trying until the writer has been started.
+ *
+ * By default, received matrices reference the shared memory directly
+ * (see [zeroCopy]). The slot is returned to the writer once the last
+ * copy of the matrix has been destroyed. Operations that keep
+ * received matrices for a long time pin slots, which eventually
+ * stalls the writer. Turn [zeroCopy] off in such cases.
+ *
+ * Outputs
+ * -------
+ *
+ * @out output - the received object.
+ */
+class PiiSharedMemoryInputOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the shared memory segment. Must match the
+   * [PiiSharedMemoryOutputOperation::segmentName] of the sender.
+   * There is no default value.
+   */
+  Q_PROPERTY(QString segmentName READ segmentName WRITE setSegmentName);
+
+  /**
+   * If `true` (the default), matrices are emitted without copying
+   * the data out of shared memory. If `false`, each matrix is copied
+   * and its slot freed immediately.
+   */
+  Q_PROPERTY(bool zeroCopy READ zeroCopy WRITE setZeroCopy);
+
+  /**
+   * `true` if the operation is attached to the shared memory
+   * segment, `false` if it is still waiting for the writer.
+   */
+  Q_PROPERTY(bool attached READ isAttached);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiSharedMemoryInputOperation();
+  ~PiiSharedMemoryInputOperation();
+
+  void check(bool reset);
+
+  void setSegmentName(const QString& segmentName);
+  QString segmentName() const;
+  void setZeroCopy(bool zeroCopy);
+  bool zeroCopy() const;
+  bool isAttached() const;
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+private:
+  template <class T> void emitMatrix(PiiSharedMemoryRing::Slot* slot);
+  void emitEncoded(PiiSharedMemoryRing::Slot* slot);
+  void freeSlotAndThrow(PiiSharedMemoryRing::Slot* slot, const QString& message);
+  void releaseRing();
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    QString strSegmentName;
+    bool bZeroCopy;
+    PiiSharedMemoryRing* pRing;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIISHAREDMEMORYINPUTOPERATION_H
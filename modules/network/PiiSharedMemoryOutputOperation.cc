@@ -0,0 +1,178 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiSharedMemoryOutputOperation.h"
+
+#include <PiiYdinTypes.h>
+#include <PiiWireFormat.h>
+#include <cstring>
+
+PiiSharedMemoryOutputOperation::Data::Data() :
+  iSlotCount(8),
+  iSlotSize(16 << 20),
+  bDropWhenFull(false),
+  iDroppedCount(0),
+  pRing(0)
+{
+}
+
+PiiSharedMemoryOutputOperation::PiiSharedMemoryOutputOperation() :
+  PiiDefaultOperation(new Data)
+{
+  addSocket(new PiiInputSocket("input"));
+
+  setProtectionLevel("segmentName", WriteWhenStoppedOrPaused);
+  setProtectionLevel("slotCount", WriteWhenStoppedOrPaused);
+  setProtectionLevel("slotSize", WriteWhenStoppedOrPaused);
+}
+
+PiiSharedMemoryOutputOperation::~PiiSharedMemoryOutputOperation()
+{
+  releaseRing();
+}
+
+void PiiSharedMemoryOutputOperation::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  if (d->strSegmentName.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Shared memory segment name has not been set."));
+
+  if (reset)
+    {
+      d->iDroppedCount = 0;
+      // Geometry may have changed.
+      releaseRing();
+    }
+
+  if (d->pRing == 0)
+    {
+      PiiSharedMemoryRing* pRing = new PiiSharedMemoryRing(d->strSegmentName);
+      if (!pRing->create(d->iSlotCount, d->iSlotSize))
+        {
+          QString strError(pRing->errorString());
+          pRing->release();
+          PII_THROW(PiiExecutionException, tr("Cannot create shared memory segment \"%1\": %2")
+                    .arg(d->strSegmentName).arg(strError));
+        }
+      d->pRing = pRing;
+    }
+}
+
+void PiiSharedMemoryOutputOperation::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    releaseRing();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+void PiiSharedMemoryOutputOperation::releaseRing()
+{
+  PII_D;
+  if (d->pRing != 0)
+    {
+      d->pRing->release();
+      d->pRing = 0;
+    }
+}
+
+void PiiSharedMemoryOutputOperation::process()
+{
+  PII_D;
+  PiiVariant obj = inputAt(0)->firstObject();
+  PiiSharedMemoryRing* pRing = d->pRing;
+
+  const int iSequence = pRing->writeSequence().load();
+  PiiSharedMemoryRing::Slot* pSlot = pRing->slot(iSequence);
+
+  // Wait for the reader to give the slot back.
+  while (!PiiSharedMemoryRing::waitForState(pSlot, PiiSharedMemoryRing::FreeSlot,
+                                            d->bDropWhenFull ? 0 : 100))
+    {
+      if (d->bDropWhenFull || state() == Interrupted)
+        {
+          ++d->iDroppedCount;
+          return;
+        }
+    }
+
+  switch (obj.type())
+    {
+      PII_ALL_MATRIX_CASES_M(writeMatrix, (obj, pSlot));
+      PII_COLOR_IMAGE_CASES_M(writeMatrix, (obj, pSlot));
+    default:
+      writeEncoded(obj, pSlot);
+    }
+  pSlot->uiType = obj.type();
+
+  // Publishing the state makes the payload visible to the reader.
+  pSlot->state.storeRelease(PiiSharedMemoryRing::WrittenSlot);
+  pRing->writeSequence().storeRelease(iSequence + 1);
+}
+
+template <class T> void PiiSharedMemoryOutputOperation::writeMatrix(const PiiVariant& obj,
+                                                                   PiiSharedMemoryRing::Slot* slot)
+{
+  PII_D;
+  const PiiMatrix<T> matrix(obj.valueAs<PiiMatrix<T> >());
+  const int iRows = matrix.rows();
+  const std::size_t iRowBytes = matrix.columns() * sizeof(T);
+  const qint64 iBytes = qint64(iRowBytes) * iRows;
+  if (iBytes > d->pRing->slotSize())
+    throwTooLarge(iBytes);
+
+  char* pData = d->pRing->payload(slot);
+  if (matrix.stride() == iRowBytes)
+    {
+      if (iBytes > 0)
+        memcpy(pData, matrix.row(0), iBytes);
+    }
+  else
+    for (int r=0; r<iRows; ++r, pData += iRowBytes)
+      memcpy(pData, matrix.row(r), iRowBytes);
+
+  slot->uiEncoding = PiiSharedMemoryRing::MatrixEncoding;
+  slot->uiBytes = quint32(iBytes);
+  slot->iRows = iRows;
+  slot->iColumns = matrix.columns();
+}
+
+void PiiSharedMemoryOutputOperation::writeEncoded(const PiiVariant& obj, PiiSharedMemoryRing::Slot* slot)
+{
+  PII_D;
+  const QByteArray aData(PiiWireFormat::encode(obj));
+  if (aData.size() > d->pRing->slotSize())
+    throwTooLarge(aData.size());
+  memcpy(d->pRing->payload(slot), aData.constData(), aData.size());
+  slot->uiEncoding = PiiSharedMemoryRing::WireFormatEncoding;
+  slot->uiBytes = aData.size();
+  slot->iRows = slot->iColumns = 0;
+}
+
+void PiiSharedMemoryOutputOperation::throwTooLarge(qint64 bytes)
+{
+  PII_THROW(PiiExecutionException, tr("An object of %1 bytes does not fit into a slot of %2 bytes.")
+            .arg(bytes).arg(_d()->pRing->slotSize()));
+}
+
+void PiiSharedMemoryOutputOperation::setSegmentName(const QString& segmentName) { _d()->strSegmentName = segmentName; }
+QString PiiSharedMemoryOutputOperation::segmentName() const { return _d()->strSegmentName; }
+void PiiSharedMemoryOutputOperation::setSlotCount(int slotCount) { _d()->iSlotCount = slotCount; }
+int PiiSharedMemoryOutputOperation::slotCount() const { return _d()->iSlotCount; }
+void PiiSharedMemoryOutputOperation::setSlotSize(int slotSize) { _d()->iSlotSize = slotSize; }
+int PiiSharedMemoryOutputOperation::slotSize() const { return _d()->iSlotSize; }
+void PiiSharedMemoryOutputOperation::setDropWhenFull(bool dropWhenFull) { _d()->bDropWhenFull = dropWhenFull; }
+bool PiiSharedMemoryOutputOperation::dropWhenFull() const { return _d()->bDropWhenFull; }
+int PiiSharedMemoryOutputOperation::droppedCount() const { return _d()->iDroppedCount; }
@@ -0,0 +1,137 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIISHAREDMEMORYOUTPUTOPERATION_H
+#define _PIISHAREDMEMORYOUTPUTOPERATION_H
+
+#include <PiiDefaultOperation.h>
+#include "PiiSharedMemoryRing.h"
+
+/**
+ * Sends objects to another process on the same computer through
+ * shared memory. The operation is a faster replacement for a
+ * PiiNetworkOutputOperation - PiiNetworkInputOperation pair
+ * connected over localhost. Objects are copied into a ring of
+ * buffers in a named shared memory segment (see
+ * [segmentName]), and PiiSharedMemoryInputOperation in the receiving
+ * process picks them up. Nothing is serialized for matrices, and no
+ * system calls are made when the ring has space. The delay between
+ * the processes is typically a few microseconds.
+ *
+ * The operation creates the segment when started. One writer and
+ * one reader can use a segment at a time. If the reader is not
+ * running, the ring fills up, and the operation waits until space
+ * becomes available (see [dropWhenFull]).
+ *
+ * Inputs
+ * ------
+ *
+ * @in input - any object. Matrices and color images are copied into
+ * the ring as raw memory. Other types are encoded with
+ * PiiWireFormat. The encoded object must fit into a slot (see
+ * [slotSize]).
+ *
+ * ~~~(c++)
+ * // Process 1
+ * PiiOperation* pSender = engine.createOperation("PiiSharedMemoryOutputOperation");
+ * pSender->setProperty("segmentName", "camera1");
+ * pSender->setProperty("slotSize", 2048*2048);
+ *
+ * // Process 2
+ * PiiOperation* pReceiver = engine.createOperation("PiiSharedMemoryInputOperation");
+ * pReceiver->setProperty("segmentName", "camera1");
+ * ~~~
+ */
+class PiiSharedMemoryOutputOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The name of the shared memory segment. The receiving
+   * PiiSharedMemoryInputOperation must use the same name. There is
+   * no default value.
+   */
+  Q_PROPERTY(QString segmentName READ segmentName WRITE setSegmentName);
+
+  /**
+   * The number of buffers in the ring. More slots allow the reader
+   * to fall further behind before the writer needs to wait. The
+   * default value is 8.
+   */
+  Q_PROPERTY(int slotCount READ slotCount WRITE setSlotCount);
+
+  /**
+   * The size of each buffer in bytes. The largest object to be sent
+   * must fit into a slot. The default value is 16 MB. The total size
+   * of the segment is roughly [slotCount] times [slotSize].
+   */
+  Q_PROPERTY(int slotSize READ slotSize WRITE setSlotSize);
+
+  /**
+   * If `true`, objects are discarded when the ring is full instead of
+   * waiting for the reader. This keeps the sending pipeline running
+   * at full speed if the receiver is slow or not running. The default
+   * value is `false`.
+   */
+  Q_PROPERTY(bool dropWhenFull READ dropWhenFull WRITE setDropWhenFull);
+
+  /**
+   * The number of objects discarded since the last reset.
+   */
+  Q_PROPERTY(int droppedCount READ droppedCount);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiSharedMemoryOutputOperation();
+  ~PiiSharedMemoryOutputOperation();
+
+  void check(bool reset);
+
+  void setSegmentName(const QString& segmentName);
+  QString segmentName() const;
+  void setSlotCount(int slotCount);
+  int slotCount() const;
+  void setSlotSize(int slotSize);
+  int slotSize() const;
+  void setDropWhenFull(bool dropWhenFull);
+  bool dropWhenFull() const;
+  int droppedCount() const;
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+private:
+  template <class T> void writeMatrix(const PiiVariant& obj, PiiSharedMemoryRing::Slot* slot);
+  void writeEncoded(const PiiVariant& obj, PiiSharedMemoryRing::Slot* slot);
+  void throwTooLarge(qint64 bytes);
+  void releaseRing();
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    QString strSegmentName;
+    int iSlotCount;
+    int iSlotSize;
+    bool bDropWhenFull;
+    int iDroppedCount;
+    PiiSharedMemoryRing* pRing;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIISHAREDMEMORYOUTPUTOPERATION_H
@@ -0,0 +1,215 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiSharedMemoryRing.h"
+
+#include <PiiDelay.h>
+#include <QCoreApplication>
+#include <QTime>
+#include <QThread>
+#include <cstring>
+#include <new>
+
+namespace
+{
+  const char pMagic[8] = { 'P', 'I', 'I', 'S', 'H', 'M', 'R', '1' };
+  enum { Alignment = 64, SpinCount = 2000, YieldCount = 200 };
+
+  inline int alignUp(int bytes) { return (bytes + Alignment - 1) & ~(Alignment - 1); }
+
+  inline QString tr(const char* text) { return QCoreApplication::translate("PiiSharedMemoryRing", text); }
+}
+
+struct PiiSharedMemoryRing::Header
+{
+  char magic[8];
+  qint32 iSlotCount;
+  qint32 iSlotSize;
+  PiiAtomicInt iWriteSequence;
+  PiiAtomicInt iReadSequence;
+};
+
+PiiSharedMemoryRing::PiiSharedMemoryRing(const QString& key) :
+  _memory(key),
+  _pHeader(0),
+  _pSlots(0),
+  _iSlotStride(0)
+{
+}
+
+PiiSharedMemoryRing::~PiiSharedMemoryRing()
+{
+  if (_memory.isAttached())
+    _memory.detach();
+}
+
+int PiiSharedMemoryRing::slotStride(int slotSize)
+{
+  return alignUp(sizeof(Slot)) + alignUp(slotSize);
+}
+
+void PiiSharedMemoryRing::initialize(int slotCount, int slotSize)
+{
+  char* pData = static_cast<char*>(_memory.data());
+  _pHeader = reinterpret_cast<Header*>(pData);
+  _pSlots = pData + alignUp(sizeof(Header));
+  _iSlotStride = slotStride(slotSize);
+
+  new (&_pHeader->iWriteSequence) PiiAtomicInt(0);
+  new (&_pHeader->iReadSequence) PiiAtomicInt(0);
+  _pHeader->iSlotCount = slotCount;
+  _pHeader->iSlotSize = slotSize;
+  for (int i=0; i<slotCount; ++i)
+    // Value-initialization clears the descriptor. FreeSlot is zero.
+    new (_pSlots + i * _iSlotStride) Slot();
+  // The magic is written last. A reader that sees it can trust the
+  // rest of the header.
+  memcpy(_pHeader->magic, pMagic, sizeof(pMagic));
+}
+
+bool PiiSharedMemoryRing::create(int slotCount, int slotSize)
+{
+  if (slotCount < 1 || slotSize < 1)
+    {
+      _strError = tr("The number of slots and their size must be positive.");
+      return false;
+    }
+  const qint64 iTotalSize = alignUp(sizeof(Header)) + qint64(slotCount) * slotStride(slotSize);
+  if (iTotalSize > 0x7fffffff)
+    {
+      _strError = tr("The shared memory segment would exceed 2 GB.");
+      return false;
+    }
+
+  if (_memory.create(int(iTotalSize)))
+    {
+      _memory.lock();
+      initialize(slotCount, slotSize);
+      _memory.unlock();
+      return true;
+    }
+
+  if (_memory.error() != QSharedMemory::AlreadyExists || !_memory.attach())
+    {
+      _strError = _memory.errorString();
+      return false;
+    }
+
+  // The segment exists. It was left behind by an earlier writer or
+  // is kept alive by an attached reader.
+  _memory.lock();
+  Header* pHeader = static_cast<Header*>(_memory.data());
+  bool bValid = memcmp(pHeader->magic, pMagic, sizeof(pMagic)) == 0;
+  if (bValid && (pHeader->iSlotCount != slotCount || pHeader->iSlotSize != slotSize))
+    {
+      _memory.unlock();
+      _memory.detach();
+      _strError = tr("The shared memory segment is in use with a different slot configuration.");
+      return false;
+    }
+  if (!bValid)
+    {
+      if (_memory.size() < iTotalSize)
+        {
+          _memory.unlock();
+          _memory.detach();
+          _strError = tr("The shared memory segment exists but is not a valid ring.");
+          return false;
+        }
+      initialize(slotCount, slotSize);
+    }
+  else
+    {
+      _pHeader = pHeader;
+      _pSlots = static_cast<char*>(_memory.data()) + alignUp(sizeof(Header));
+      _iSlotStride = slotStride(slotSize);
+    }
+  _memory.unlock();
+  return true;
+}
+
+bool PiiSharedMemoryRing::attach()
+{
+  if (!_memory.attach())
+    {
+      _strError = _memory.errorString();
+      return false;
+    }
+
+  _memory.lock();
+  Header* pHeader = static_cast<Header*>(_memory.data());
+  if (_memory.size() < int(sizeof(Header)) ||
+      memcmp(pHeader->magic, pMagic, sizeof(pMagic)) != 0 ||
+      pHeader->iSlotCount < 1 || pHeader->iSlotSize < 1 ||
+      _memory.size() < alignUp(sizeof(Header)) + qint64(pHeader->iSlotCount) * slotStride(pHeader->iSlotSize))
+    {
+      _memory.unlock();
+      _memory.detach();
+      _strError = tr("The shared memory segment is not a valid ring.");
+      return false;
+    }
+  _pHeader = pHeader;
+  _pSlots = static_cast<char*>(_memory.data()) + alignUp(sizeof(Header));
+  _iSlotStride = slotStride(pHeader->iSlotSize);
+
+  // Only one reader is supported. Slots still in use belong to a
+  // reader that is gone.
+  for (int i=0; i<pHeader->iSlotCount; ++i)
+    {
+      Slot* pSlot = reinterpret_cast<Slot*>(_pSlots + i * _iSlotStride);
+      if (pSlot->state.loadAcquire() == ReadingSlot)
+        pSlot->state.storeRelease(FreeSlot);
+    }
+  _memory.unlock();
+  return true;
+}
+
+PiiSharedMemoryRing::Slot* PiiSharedMemoryRing::slot(int sequence) const
+{
+  return reinterpret_cast<Slot*>(_pSlots + int(uint(sequence) % uint(_pHeader->iSlotCount)) * _iSlotStride);
+}
+
+char* PiiSharedMemoryRing::payload(Slot* slot) const
+{
+  return reinterpret_cast<char*>(slot) + alignUp(sizeof(Slot));
+}
+
+bool PiiSharedMemoryRing::waitForState(Slot* slot, SlotState state, int msecs)
+{
+  for (int i=0; i<SpinCount; ++i)
+    if (slot->state.loadAcquire() == state)
+      return true;
+  for (int i=0; i<YieldCount; ++i)
+    {
+      if (slot->state.loadAcquire() == state)
+        return true;
+      QThread::yieldCurrentThread();
+    }
+
+  QTime time;
+  time.start();
+  while (slot->state.loadAcquire() != state)
+    {
+      if (time.elapsed() >= msecs)
+        return false;
+      PiiDelay::usleep(50);
+    }
+  return true;
+}
+
+QString PiiSharedMemoryRing::errorString() const { return _strError; }
+int PiiSharedMemoryRing::slotCount() const { return _pHeader->iSlotCount; }
+int PiiSharedMemoryRing::slotSize() const { return _pHeader->iSlotSize; }
+PiiAtomicInt& PiiSharedMemoryRing::writeSequence() const { return _pHeader->iWriteSequence; }
+PiiAtomicInt& PiiSharedMemoryRing::readSequence() const { return _pHeader->iReadSequence; }
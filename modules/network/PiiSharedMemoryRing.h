@@ -0,0 +1,156 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIISHAREDMEMORYRING_H
+#define _PIISHAREDMEMORYRING_H
+
+#include <PiiSharedObject.h>
+#include <PiiAtomicInt.h>
+#include <QSharedMemory>
+#include <QString>
+
+#include "PiiNetworkPlugin.h"
+
+/**
+ * A ring of fixed-size buffers in a named shared memory segment.
+ * The ring connects one writer and one reader process. Objects are
+ * copied into a free slot by the writer, and the reader may use the
+ * slot memory in place until it marks the slot free again. Only slot
+ * states are exchanged between the processes. No system calls are
+ * needed on the fast path.
+ *
+ * Each slot carries a small descriptor (type id, size and matrix
+ * dimensions) followed by the payload. Payloads start at 64-byte
+ * boundaries.
+ *
+ * The writer creates the segment with [create()], and the reader
+ * uses [attach()]. Both ends keep the segment mapped as long as the
+ * ring object is alive. The ring is reference-counted so that leased
+ * slot memory remains valid until the last user has released it.
+ *
+ * @internal
+ */
+class PII_NETWORKPLUGIN_EXPORT PiiSharedMemoryRing : public PiiSharedObject
+{
+public:
+  /**
+   * Slot states.
+   *
+   * - `FreeSlot` - the writer may fill the slot.
+   * - `WrittenSlot` - the slot contains an object the reader has
+   * not seen yet.
+   * - `ReadingSlot` - the reader is using the slot.
+   */
+  enum SlotState { FreeSlot, WrittenSlot, ReadingSlot };
+
+  /**
+   * Payload encodings.
+   *
+   * - `MatrixEncoding` - the payload is the elements of a matrix,
+   * stored row by row without padding.
+   * - `WireFormatEncoding` - the payload was written with
+   * PiiWireFormat.
+   */
+  enum Encoding { MatrixEncoding, WireFormatEncoding };
+
+  /**
+   * A slot descriptor in shared memory.
+   */
+  struct Slot
+  {
+    PiiAtomicInt state;
+    quint32 uiType;
+    quint32 uiEncoding;
+    quint32 uiBytes;
+    qint32 iRows;
+    qint32 iColumns;
+  };
+
+  /**
+   * Creates a ring that uses the shared memory segment identified
+   * by *key*. The segment is not accessed before [create()] or
+   * [attach()] is called.
+   */
+  PiiSharedMemoryRing(const QString& key);
+  ~PiiSharedMemoryRing();
+
+  /**
+   * Creates the segment with *slotCount* slots of *slotSize* bytes,
+   * or attaches to an existing one with the same geometry. A
+   * segment left behind by a crashed writer is reused. Returns
+   * `false` and sets [errorString()] on failure.
+   */
+  bool create(int slotCount, int slotSize);
+
+  /**
+   * Attaches to a segment created by a writer and takes the geometry
+   * from it. Slots left in `ReadingSlot` state by an earlier reader
+   * are freed. Returns `false` if the segment does not exist yet or
+   * is not a valid ring.
+   */
+  bool attach();
+
+  /**
+   * Returns a description of the last error.
+   */
+  QString errorString() const;
+
+  int slotCount() const;
+  int slotSize() const;
+
+  /**
+   * Returns the slot for the given sequence number. Sequence numbers
+   * grow by one for each object and wrap around on overflow.
+   */
+  Slot* slot(int sequence) const;
+  /**
+   * Returns a pointer to the first byte of the payload of *slot*.
+   */
+  char* payload(Slot* slot) const;
+
+  /**
+   * The sequence number of the next slot to be written. Only the
+   * writer modifies this value.
+   */
+  PiiAtomicInt& writeSequence() const;
+  /**
+   * The sequence number of the next slot to be read. Only the
+   * reader modifies this value.
+   */
+  PiiAtomicInt& readSequence() const;
+
+  /**
+   * Waits until *slot* is in *state* for at most *msecs*
+   * milliseconds. The function spins first to catch fast hand-offs
+   * and falls back to short sleeps. Returns `true` if the slot
+   * reached the state.
+   */
+  static bool waitForState(Slot* slot, SlotState state, int msecs);
+
+private:
+  struct Header;
+
+  void initialize(int slotCount, int slotSize);
+  static int slotStride(int slotSize);
+
+  QSharedMemory _memory;
+  Header* _pHeader;
+  char* _pSlots;
+  int _iSlotStride;
+  QString _strError;
+
+  PII_DISABLE_COPY(PiiSharedMemoryRing);
+};
+
+#endif //_PIISHAREDMEMORYRING_H
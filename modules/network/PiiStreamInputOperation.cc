@@ -0,0 +1,101 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiStreamInputOperation.h"
+
+#include <PiiDataStream.h>
+#include <PiiSocketDevice.h>
+#include <PiiYdinTypes.h>
+
+PiiStreamInputOperation::Data::Data() :
+  iWindowSize(0)
+{
+}
+
+PiiStreamInputOperation::PiiStreamInputOperation() :
+  PiiStreamOperation(new Data)
+{
+  addSocket(new PiiOutputSocket("output"));
+
+  setProtectionLevel("windowSize", WriteWhenStoppedOrPaused);
+}
+
+int PiiStreamInputOperation::initialCredits() const
+{
+  const PII_D;
+  if (d->iWindowSize > 0)
+    return d->iWindowSize;
+
+  int iCredits = 0;
+  QList<PiiAbstractInputSocket*> lstInputs = outputAt(0)->connectedInputs();
+  for (int i=0; i<lstInputs.size(); ++i)
+    {
+      int iCapacity = PiiDataStream::queueCapacity(lstInputs[i]);
+      if (iCredits == 0 || iCapacity < iCredits)
+        iCredits = iCapacity;
+    }
+  return qMax(iCredits, 1);
+}
+
+void PiiStreamInputOperation::process()
+{
+  PII_D;
+  if (d->pSocket == 0)
+    {
+      openStream("outputs", d->bCompressed ? "compression=fast" : ""); // may throw
+      if (!PiiDataStream::writeCredit(d->pSocket, initialCredits()))
+        throwConnectionLost();
+    }
+
+  PiiSocketDevice socket(d->pSocket);
+  // Time out now and then to let the processor check for state
+  // changes.
+  if (socket->bytesAvailable() == 0 && !socket->waitForReadyRead(100))
+    {
+      if (!socket.isReadable())
+        throwConnectionLost();
+      return;
+    }
+
+  PiiDataStream::Frame frame;
+  if (!PiiDataStream::readFrame(d->pSocket, &frame) ||
+      frame.type == PiiDataStream::CreditFrame)
+    throwConnectionLost();
+
+  switch (frame.object.type())
+    {
+    case PiiYdin::StopTagType:
+    case PiiYdin::PauseTagType:
+      if (!PiiDataStream::writeCredit(d->pSocket, 1))
+        throwConnectionLost();
+      // The remote output stopped or paused. So do we.
+      if (frame.object.type() == PiiYdin::StopTagType)
+        operationStopped();
+      operationPaused();
+      break;
+    case PiiYdin::ResumeTagType:
+      // We are resumed by start().
+      break;
+    default:
+      PiiDataStream::emitObject(outputAt(0), frame.object);
+    }
+
+  // The object has been accepted. Allow the sender to fill the slot.
+  if (!PiiDataStream::writeCredit(d->pSocket, 1))
+    throwConnectionLost();
+}
+
+void PiiStreamInputOperation::setWindowSize(int windowSize) { _d()->iWindowSize = qMax(windowSize, 0); }
+int PiiStreamInputOperation::windowSize() const { return _d()->iWindowSize; }
@@ -0,0 +1,79 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISTREAMINPUTOPERATION_H
+#define _PIISTREAMINPUTOPERATION_H
+
+#include "PiiStreamOperation.h"
+
+/**
+ * Receives objects from an output of a remote operation through a
+ * data stream. The operation grants the remote output a window of
+ * [windowSize] objects and one more each time it has emitted an
+ * object. If the local pipeline cannot keep up, the remote output
+ * blocks.
+ *
+ * ~~~(c++)
+ * PiiOperation* pReceiver = engine.createOperation("PiiStreamInputOperation");
+ * pReceiver->setProperty("serverUri", "tcp://10.10.10.2:3142/camera/");
+ * pReceiver->setProperty("remoteSocket", "image");
+ * ~~~
+ *
+ * Outputs
+ * -------
+ *
+ * @out output - objects emitted by the remote output, including
+ * synchronization tags. If the remote output stops or pauses, so
+ * does this operation.
+ */
+class PiiStreamInputOperation : public PiiStreamOperation
+{
+  Q_OBJECT
+
+  /**
+   * The number of objects the remote output may send before the
+   * local pipeline has accepted any of them. Zero (the default)
+   * means the smallest [PiiInputSocket::queueCapacity] of the inputs
+   * connected to `output`, which makes the stream behave like a
+   * local connection. Larger windows hide network latency at the
+   * cost of memory.
+   */
+  Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize);
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiStreamInputOperation();
+
+  void setWindowSize(int windowSize);
+  int windowSize() const;
+
+protected:
+  void process();
+
+private:
+  int initialCredits() const;
+
+  /// @internal
+  class Data : public PiiStreamOperation::Data
+  {
+  public:
+    Data();
+
+    int iWindowSize;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIISTREAMINPUTOPERATION_H
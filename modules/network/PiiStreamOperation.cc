@@ -0,0 +1,109 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiStreamOperation.h"
+
+#include <PiiDataStream.h>
+#include <PiiNetworkClient.h>
+#include <PiiNetworkException.h>
+
+#include <QRegExp>
+
+PiiStreamOperation::Data::Data() :
+  bCompressed(false),
+  pNetworkClient(0),
+  pSocket(0)
+{
+}
+
+PiiStreamOperation::PiiStreamOperation(Data* data) :
+  PiiDefaultOperation(data)
+{
+  setProtectionLevel("serverUri", WriteWhenStoppedOrPaused);
+  setProtectionLevel("remoteSocket", WriteWhenStoppedOrPaused);
+}
+
+PiiStreamOperation::~PiiStreamOperation()
+{
+  delete _d()->pNetworkClient;
+}
+
+void PiiStreamOperation::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  QRegExp uriExp("([^:]+://[^/]+)(/[^ ]*)?");
+  if (!uriExp.exactMatch(d->strServerUri))
+    PII_THROW(PiiExecutionException, tr("The supplied server URI is not valid."));
+  if (d->strRemoteSocket.isEmpty())
+    PII_THROW(PiiExecutionException, tr("Remote socket name has not been set."));
+
+  closeStream();
+  delete d->pNetworkClient;
+  d->pNetworkClient = new PiiNetworkClient(uriExp.cap(1));
+  d->strPath = uriExp.cap(2);
+  if (!d->strPath.endsWith('/'))
+    d->strPath.append('/');
+}
+
+void PiiStreamOperation::aboutToChangeState(State state)
+{
+  if (state == Stopped)
+    closeStream();
+  PiiDefaultOperation::aboutToChangeState(state);
+}
+
+QIODevice* PiiStreamOperation::openStream(const QString& streamType, const QString& query)
+{
+  PII_D;
+  QString strPath = d->strPath + "streams/" + streamType + "/" + d->strRemoteSocket;
+  if (!query.isEmpty())
+    strPath += "?" + query;
+  try
+    {
+      d->pSocket = PiiDataStream::openStream(d->pNetworkClient, strPath);
+    }
+  catch (PiiNetworkException& ex)
+    {
+      closeStream();
+      PII_THROW(PiiExecutionException, ex.message());
+    }
+  return d->pSocket;
+}
+
+void PiiStreamOperation::closeStream()
+{
+  PII_D;
+  if (d->pSocket != 0)
+    {
+      d->pSocket->close();
+      d->pSocket = 0;
+    }
+}
+
+void PiiStreamOperation::throwConnectionLost()
+{
+  closeStream();
+  PII_THROW(PiiExecutionException, tr("Lost connection to %1.").arg(serverUri()));
+}
+
+void PiiStreamOperation::setServerUri(const QString& serverUri) { _d()->strServerUri = serverUri; }
+QString PiiStreamOperation::serverUri() const { return _d()->strServerUri; }
+void PiiStreamOperation::setRemoteSocket(const QString& remoteSocket) { _d()->strRemoteSocket = remoteSocket; }
+QString PiiStreamOperation::remoteSocket() const { return _d()->strRemoteSocket; }
+void PiiStreamOperation::setCompressed(bool compressed) { _d()->bCompressed = compressed; }
+bool PiiStreamOperation::compressed() const { return _d()->bCompressed; }
+bool PiiStreamOperation::isConnected() const { return _d()->pSocket != 0; }
@@ -0,0 +1,119 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISTREAMOPERATION_H
+#define _PIISTREAMOPERATION_H
+
+#include <PiiDefaultOperation.h>
+
+#include "PiiNetworkPlugin.h"
+
+class PiiNetworkClient;
+
+/**
+ * A base class for operations that connect a local pipeline to a
+ * remote operation through a data stream (see PiiDataStream). The
+ * remote operation must be published with a PiiOperationServer.
+ * Unlike the HTTP-based network operations, a stream is a single
+ * persistent connection with credit-based flow control, which keeps
+ * back-pressure intact across machines. The operation connects when
+ * it processes its first object and disconnects when stopped.
+ *
+ * The control plane is not affected. The remote engine must be
+ * started and stopped separately, for example with PiiRemoteObject.
+ */
+class PII_NETWORKPLUGIN_EXPORT PiiStreamOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  /**
+   * The URI of the PiiOperationServer that publishes the remote
+   * operation, for example "tcp://10.10.10.2:3142/operations/camera/".
+   * There is no default value.
+   */
+  Q_PROPERTY(QString serverUri READ serverUri WRITE setServerUri);
+
+  /**
+   * The name of the socket in the remote operation. In
+   * PiiStreamInputOperation, this is an output, in
+   * PiiStreamOutputOperation an input. There is no default value.
+   */
+  Q_PROPERTY(QString remoteSocket READ remoteSocket WRITE setRemoteSocket);
+
+  /**
+   * If `true`, matrices are compressed with LZ4 before they are sent.
+   * This saves bandwidth on slow networks, but costs processing time
+   * on both ends. The default value is `false`.
+   */
+  Q_PROPERTY(bool compressed READ compressed WRITE setCompressed);
+
+  /**
+   * `true` if the stream is currently open.
+   */
+  Q_PROPERTY(bool connected READ isConnected);
+
+public:
+  ~PiiStreamOperation();
+
+  void check(bool reset);
+
+  void setServerUri(const QString& serverUri);
+  QString serverUri() const;
+  void setRemoteSocket(const QString& remoteSocket);
+  QString remoteSocket() const;
+  void setCompressed(bool compressed);
+  bool compressed() const;
+  bool isConnected() const;
+
+protected:
+  void aboutToChangeState(State state);
+
+  /**
+   * Opens a stream to the remote socket. *streamType* is either
+   * "outputs" or "inputs". Returns the socket. Throws a
+   * PiiExecutionException on failure.
+   */
+  QIODevice* openStream(const QString& streamType, const QString& query = "");
+  /**
+   * Closes the stream and throws a PiiExecutionException telling the
+   * connection was lost.
+   */
+  void throwConnectionLost();
+  /**
+   * Closes the stream.
+   */
+  void closeStream();
+
+  /// @internal
+  class Data : public PiiDefaultOperation::Data
+  {
+  public:
+    Data();
+
+    QString strServerUri;
+    QString strRemoteSocket;
+    bool bCompressed;
+    // Path to the operation on the server.
+    QString strPath;
+    PiiNetworkClient* pNetworkClient;
+    // The stream or zero if not connected.
+    QIODevice* pSocket;
+  };
+  PII_D_FUNC;
+  /// @internal
+  PiiStreamOperation(Data* data);
+};
+
+#endif //_PIISTREAMOPERATION_H
@@ -0,0 +1,82 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiStreamOutputOperation.h"
+
+#include <PiiDataStream.h>
+#include <PiiSocketDevice.h>
+#include <PiiYdinTypes.h>
+
+PiiStreamOutputOperation::Data::Data() :
+  iCredits(0)
+{
+}
+
+PiiStreamOutputOperation::PiiStreamOutputOperation() :
+  PiiStreamOperation(new Data)
+{
+  addSocket(new PiiInputSocket("input"));
+}
+
+void PiiStreamOutputOperation::receiveCredits(int waitTime)
+{
+  PII_D;
+  PiiSocketDevice socket(d->pSocket);
+  PiiDataStream::Frame frame;
+  while (socket->bytesAvailable() > 0 || socket->waitForReadyRead(waitTime))
+    {
+      if (!PiiDataStream::readFrame(d->pSocket, &frame) ||
+          frame.type != PiiDataStream::CreditFrame)
+        throwConnectionLost();
+      d->iCredits += frame.iCredits;
+      waitTime = 0;
+    }
+  if (!socket.isWritable())
+    throwConnectionLost();
+}
+
+void PiiStreamOutputOperation::aboutToChangeState(State newState)
+{
+  PII_D;
+  // Stop the remote pipeline too, unless we were interrupted.
+  if (newState == Stopped && state() != Interrupted && d->pSocket != 0)
+    PiiDataStream::writeObject(d->pSocket, PiiYdin::createStopTag());
+  PiiStreamOperation::aboutToChangeState(newState);
+}
+
+void PiiStreamOutputOperation::process()
+{
+  PII_D;
+  if (d->pSocket == 0)
+    {
+      openStream("inputs"); // may throw
+      d->iCredits = 0;
+    }
+
+  receiveCredits(0);
+  while (d->iCredits <= 0)
+    {
+      if (state() == Interrupted)
+        return;
+      receiveCredits(100);
+    }
+
+  if (!PiiDataStream::writeObject(d->pSocket, readInput(),
+                                  d->bCompressed ?
+                                  PiiWireFormat::FastCompression :
+                                  PiiWireFormat::NoCompression))
+    throwConnectionLost();
+  --d->iCredits;
+}
@@ -0,0 +1,65 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISTREAMOUTPUTOPERATION_H
+#define _PIISTREAMOUTPUTOPERATION_H
+
+#include "PiiStreamOperation.h"
+
+/**
+ * Sends objects to an input of a remote operation through a data
+ * stream. The remote end grants as many credits as its input queue
+ * holds. Once they have been used up, the operation waits until the
+ * remote input has accepted an object, which blocks the local
+ * pipeline just like a full local input would.
+ *
+ * Synchronization tags are handled by the local flow controller and
+ * not forwarded. If the remote pipeline needs them, publish an
+ * output of the sending operation and connect a
+ * PiiStreamInputOperation to it instead. When the operation stops,
+ * it sends a stop tag to the remote input.
+ *
+ * Inputs
+ * ------
+ *
+ * @in input - any object.
+ */
+class PiiStreamOutputOperation : public PiiStreamOperation
+{
+  Q_OBJECT
+
+  PII_OPERATION_SERIALIZATION_FUNCTION
+public:
+  PiiStreamOutputOperation();
+
+protected:
+  void process();
+  void aboutToChangeState(State state);
+
+private:
+  void receiveCredits(int waitTime);
+
+  /// @internal
+  class Data : public PiiStreamOperation::Data
+  {
+  public:
+    Data();
+
+    int iCredits;
+  };
+  PII_D_FUNC;
+};
+
+#endif //_PIISTREAMOUTPUTOPERATION_H
@@ -34,7 +34,8 @@ PiiDigitExtractor::Data::Data() :
   iCombineXThreshold(2),
   dSizeThreshold(0.2),
   dLocationThreshold(0.6),
-  bInverse(false)
+  bInverse(false),
+  bBatchClassification(true)
 {
 }
 
@@ -154,9 +155,11 @@ template <class T> void PiiDigitExtractor::extractDigits(const PiiMatrix<T>& ima
   Pii::sortRows(matBB2,0);
 
   PiiMatrix<int> matScaledDigit;
+  // One row for each digit in batch classification
+  PiiMatrix<float> matSamples(PiiMatrix<float>::uninitialized(d->bBatchClassification ? matBB2.rows() : 0, 400));
+  QVector<int> vecLabels;
 
-  int iNumber = 0;
-  //Classify each digit
+  //Scale and classify each digit
   for (int nbr=0; nbr<matBB2.rows(); nbr++)
     {
       //Extract digit from thresholded image in center of image "matDigit"
@@ -174,10 +177,22 @@ template <class T> void PiiDigitExtractor::extractDigits(const PiiMatrix<T>& ima
       matScaledDigit = PiiImage::scale(matDigit, 20, 20);
 
       //Classify image matScaledDigit
-      int label = classify(matScaledDigit);
+      if (d->bBatchClassification)
+        addSample(matScaledDigit, matSamples[nbr]);
+      else
+        vecLabels << classify(matScaledDigit);
+    }
+
+  if (d->bBatchClassification)
+    vecLabels = classifyAll(matSamples);
+
+  int iNumber = 0;
+  for (int nbr=0; nbr<vecLabels.size(); nbr++)
+    {
+      int label = vecLabels[nbr];
       sDigitsString.append(QString::number(label));
       matDigits.appendColumn(PiiMatrix<int> (1,1,label));
-      iNumber += Pii::pow(10, matBB2.rows()-nbr-1) * label;
+      iNumber += Pii::pow(10, vecLabels.size()-nbr-1) * label;
     }
 
   d->pNumberOutput->emitObject(iNumber);
@@ -350,6 +365,62 @@ void PiiDigitExtractor::initializeKnnClassifier()
 
   //Base vectors
   ia >> d->matBaseDigitVectors;
+
+  //Batch classification compares all samples to all models with one
+  //matrix product. The squared distance |s-m|^2 = |s|^2 - 2s.m +
+  //|m|^2, and |s|^2 doesn't change the order.
+  d->matBaseTransposed = Pii::matrix(Pii::transpose(d->matBaseDigitVectors));
+  d->matModelsTransposed = Pii::matrix(Pii::transpose(matFeatureVector));
+  d->matModelNorms.resize(1, matFeatureVector.rows());
+  for (int i=0; i<matFeatureVector.rows(); ++i)
+    {
+      const float* pModel = matFeatureVector[i];
+      float fNorm = 0;
+      for (int j=0; j<matFeatureVector.columns(); ++j)
+        fNorm += pModel[j] * pModel[j];
+      d->matModelNorms(0,i) = fNorm;
+    }
+  d->vecModelLabels = vecLabels;
+}
+
+//Stores the normalized pixels of a scaled digit to a row of the
+//sample matrix in the same order as classify() does
+void PiiDigitExtractor::addSample(const PiiMatrix<int>& scaledImage, float* sample)
+{
+  PII_D;
+  for (int i=0;i<20;i++)
+    for (int j=0;j<20;j++)
+      sample[j*20+i] = (scaledImage(i,j) - 127.5f) / 127.5f - d->matMeanDigitVector(j*20+i,0);
+}
+
+//PCA-transforms all samples and finds the closest model for each
+QVector<int> PiiDigitExtractor::classifyAll(const PiiMatrix<float>& samples)
+{
+  PII_D;
+  QVector<int> vecLabels(samples.rows());
+  if (samples.rows() == 0 || d->matModelsTransposed.columns() == 0)
+    return vecLabels;
+
+  PiiMatrix<float> matFeatures(samples * d->matBaseTransposed);
+  PiiMatrix<float> matProducts(matFeatures * d->matModelsTransposed);
+  const float* pNorms = d->matModelNorms[0];
+  for (int r=0; r<matProducts.rows(); ++r)
+    {
+      const float* pProducts = matProducts[r];
+      int iClosest = 0;
+      float fMinDistance = pNorms[0] - 2 * pProducts[0];
+      for (int c=1; c<matProducts.columns(); ++c)
+        {
+          float fDistance = pNorms[c] - 2 * pProducts[c];
+          if (fDistance < fMinDistance)
+            {
+              fMinDistance = fDistance;
+              iClosest = c;
+            }
+        }
+      vecLabels[r] = int(d->vecModelLabels.value(iClosest));
+    }
+  return vecLabels;
 }
 
 //Converts segmented image into (PCA-reduced) feature vector, and classifies it using kNN
@@ -373,3 +444,5 @@ int PiiDigitExtractor::classify(const PiiMatrix<int> &scaledImage)
 
 void PiiDigitExtractor::setInverse(bool inverse) { _d()->bInverse = inverse; }
 bool PiiDigitExtractor::inverse() const { return _d()->bInverse; }
+void PiiDigitExtractor::setBatchClassification(bool batchClassification) { _d()->bBatchClassification = batchClassification; }
+bool PiiDigitExtractor::batchClassification() const { return _d()->bBatchClassification; }
@@ -28,6 +28,14 @@
  * coefficients are used as the feature vector, which is classified
  * using a k-NN classifier.
  *
+ * By default, all digits found in an image are classified at once
+ * (see [batchClassification]). The scaled digits are collected into
+ * one sample matrix, the PCA transform is applied to all of them
+ * with one matrix multiplication, and the distances to all model
+ * samples are calculated with another. The blocked and vectorized
+ * matrix product reuses each model for many digits, which makes long
+ * serial numbers much cheaper to read.
+ *
  * Inputs
  * ------
  *
@@ -58,6 +66,15 @@ class PiiDigitExtractor: public PiiDefaultOperation
    */
   Q_PROPERTY(bool inverse READ inverse WRITE setInverse);
 
+  /**
+   * If `true` (the default), all digits in an image are transformed
+   * and classified in a single batch. If `false`, each digit is
+   * classified separately with PiiKnnClassifier. The results are
+   * the same except for ties in distance, which may be resolved
+   * differently due to rounding.
+   */
+  Q_PROPERTY(bool batchClassification READ batchClassification WRITE setBatchClassification);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiDigitExtractor();
@@ -69,6 +86,8 @@ protected:
 
   void setInverse(bool inverse);
   bool inverse() const;
+  void setBatchClassification(bool batchClassification);
+  bool batchClassification() const;
 
 private:
   template <class T> void extractIntDigits(const PiiVariant& obj);
@@ -77,6 +96,8 @@ private:
   bool isIncorrectBlob(const PiiMatrix<int> &boundingBoxes, int index,int imageHeight);
   void initializeKnnClassifier();
   int classify(const PiiMatrix<int> &scaledImage);
+  void addSample(const PiiMatrix<int>& scaledImage, float* sample);
+  QVector<int> classifyAll(const PiiMatrix<float>& samples);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -93,6 +114,12 @@ private:
       PiiMatrix<float> matMeanDigitVector; //(400,1);
       PiiMatrix<float> matBaseDigitVectors; //(50,400);
       bool bInverse;
+      bool bBatchClassification;
+      // Copies of the classifier data laid out for matrix products.
+      PiiMatrix<float> matBaseTransposed; //(400,50)
+      PiiMatrix<float> matModelsTransposed; //(50,10000)
+      PiiMatrix<float> matModelNorms; //(1,10000)
+      QVector<double> vecModelLabels;
     };
   PII_D_FUNC;
 };
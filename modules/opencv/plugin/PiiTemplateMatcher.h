@@ -25,6 +25,8 @@
  * cvMatchTemplate() for matching. It is mostly an illustration on how
  * to integrate OpenCV to Into and not intended for production-grade
  * applications.
+ * PiiTemplateMatchingOperation in the image plugin implements
+ * normalized cross-correlation natively.
  *
  * Inputs
  * ------
@@ -157,6 +157,13 @@ protected:
    */
   double fitToModel(int dataIndex, const double* model);
 
+  /**
+   * Calculates the distances of *count* points starting at
+   * *firstIndex* to the circle at once. The loop is vectorized by the
+   * compiler if the points are stored contiguously.
+   */
+  void fitSamplesToModel(int firstIndex, int count, const double* model, double* fits);
+
   int minInliers(const double* model) const;
   double fittingThreshold(const double* model) const;
 
@@ -322,6 +329,31 @@ double PiiCircleRansac<T>::fitToModel(int dataIndex, const double* model)
                   model[2]);
 }
 
+template <class T>
+void PiiCircleRansac<T>::fitSamplesToModel(int firstIndex, int count, const double* model, double* fits)
+{
+  const PII_D;
+  const double dCx = model[0], dCy = model[1], dRadius = model[2];
+  if (d->matPoints.stride() == 2 * sizeof(T))
+    {
+      const T* pPoints = d->matPoints[firstIndex];
+      for (int i = 0; i < count; ++i)
+        fits[i] = Pii::abs(Pii::fastHypotenuse(pPoints[2*i] - dCx,
+                                               pPoints[2*i+1] - dCy) -
+                           dRadius);
+    }
+  else
+    {
+      for (int i = 0; i < count; ++i)
+        {
+          const T* pPoint = d->matPoints[firstIndex + i];
+          fits[i] = Pii::abs(Pii::fastHypotenuse(pPoint[0] - dCx,
+                                                 pPoint[1] - dCy) -
+                             dRadius);
+        }
+    }
+}
+
 template <class T>
 int PiiCircleRansac<T>::minInliers(const double* model) const
 {
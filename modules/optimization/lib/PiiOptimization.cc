@@ -17,13 +17,82 @@
 #include "lbfgs.h"
 #include "lmmin.h"
 
-static void lbfgsCallbackFunction(ap::real_1d_array x, double& f, ap::real_1d_array& g, void* data)
+#include <algorithm>
+#include <vector>
+
+static void lbfgsCallbackFunction(const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* data)
 {
   PiiOptimization::GradientFunction<double>* func = reinterpret_cast<PiiOptimization::GradientFunction<double>*>(data);
   f = func->functionValue(x.getcontent());
   func->functionGradient(x.getcontent(), g.getcontent());
 }
 
+namespace PiiOptimization
+{
+  /* Work buffers for bfgsMinimize() with a SampleGradientFunction.
+     Each block of samples has its own row in matPartialGradients and
+     its own entry in vecPartialValues. The strips write to disjoint
+     rows, and the rows are summed in order afterwards.
+   */
+  struct SampleGradientData
+  {
+    // The number of samples in a block. Small enough to balance the
+    // load, large enough to make the reduction cheap.
+    enum { BlockSize = 64 };
+
+    SampleGradientData(const SampleGradientFunction<double>* function,
+                       int parameterCount,
+                       const PiiParallelPolicy& policy) :
+      func(function),
+      iSampleCount(function->sampleCount()),
+      iBlockCount((qMax(iSampleCount, 0) + BlockSize - 1) / BlockSize),
+      matPartialGradients(qMax(iBlockCount, 1), parameterCount),
+      vecPartialValues(qMax(iBlockCount, 1), 0.0),
+      policy(policy),
+      pParams(0)
+    {}
+
+    void operator() (int firstBlock, int endBlock)
+    {
+      for (int b=firstBlock; b<endBlock; ++b)
+        {
+          double* pGradient = matPartialGradients[b];
+          std::fill(pGradient, pGradient + matPartialGradients.columns(), 0.0);
+          vecPartialValues[b] = func->accumulateGradient(pParams,
+                                                         b * BlockSize,
+                                                         qMin(iSampleCount, (b+1) * BlockSize),
+                                                         pGradient);
+        }
+    }
+
+    const SampleGradientFunction<double>* func;
+    int iSampleCount, iBlockCount;
+    PiiMatrix<double> matPartialGradients;
+    std::vector<double> vecPartialValues;
+    PiiParallelPolicy policy;
+    const double* pParams;
+  };
+}
+
+static void lbfgsSampleCallbackFunction(const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* data)
+{
+  PiiOptimization::SampleGradientData* funcData = reinterpret_cast<PiiOptimization::SampleGradientData*>(data);
+  funcData->pParams = x.getcontent();
+  Pii::forEachStrip(funcData->iBlockCount, *funcData, funcData->policy);
+
+  const int iParams = funcData->matPartialGradients.columns();
+  double* pGradient = g.getcontent();
+  std::fill(pGradient, pGradient + iParams, 0.0);
+  f = 0;
+  for (int b=0; b<funcData->iBlockCount; ++b)
+    {
+      const double* pPartial = funcData->matPartialGradients[b];
+      for (int i=0; i<iParams; ++i)
+        pGradient[i] += pPartial[i];
+      f += funcData->vecPartialValues[b];
+    }
+}
+
 namespace PiiOptimization
 {
   struct LmCallbackData
@@ -153,4 +222,32 @@ namespace PiiOptimization
       }
      return res;
    }
+
+  PiiMatrix<double> bfgsMinimize(const SampleGradientFunction<double>* function,
+                                 const PiiMatrix<double>& initialParams,
+                                 const PiiParallelPolicy& policy,
+                                 double epsG, double epsF, double epsX,
+                                 int maxIterations)
+  {
+    int info = 0;
+    const int iParams = initialParams.columns();
+    ap::real_1d_array array;
+    array.setbounds(1, iParams);
+    for (int i=iParams; i--; )
+      array.getcontent()[i] = initialParams(i);
+
+    SampleGradientData data(function, iParams, policy);
+    lbfgsminimize(iParams, iParams,
+                  array,
+                  epsG, epsF, epsX,
+                  maxIterations,
+                  info,
+                  lbfgsSampleCallbackFunction,
+                  &data);
+
+    PiiMatrix<double> res(1, iParams);
+    for (int i=iParams; i--; )
+      res(0,i) = array(i+1);
+    return res;
+  }
 }
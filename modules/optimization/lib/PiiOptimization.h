@@ -18,6 +18,7 @@
 
 #include <PiiMathException.h>
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include "PiiOptimizationGlobal.h"
 
 /**
@@ -63,6 +64,43 @@ namespace PiiOptimization
     virtual void functionGradient(const T* params, T* gradient) const = 0;
   };
 
+  /**
+   * An interface for functions that are sums over a large number of
+   * samples, such as the error of a model fitted to measurements:
+   * \(F(x) = \sum_i f_i(x)\). Instead of evaluating the whole sum at
+   * once, the function evaluates a range of samples. This makes it
+   * possible to divide the samples among threads and to reduce the
+   * partial sums in parallel.
+   *
+   * The optimizer calls [accumulateGradient()] concurrently for
+   * disjoint ranges of samples. The implementation must not modify
+   * shared state.
+   */
+  template <class T> class SampleGradientFunction
+  {
+  public:
+    virtual ~SampleGradientFunction() {}
+
+    /**
+     * Returns the number of samples in the sum.
+     */
+    virtual int sampleCount() const = 0;
+
+    /**
+     * Calculates the values and gradients of the samples
+     * [*firstSample*, *endSample*) at the given point.
+     *
+     * @param params an N-element vector containing the function
+     * parameters.
+     *
+     * @param gradient an N-element vector. The gradient of each
+     * sample must be added to this vector. It is zero on entry.
+     *
+     * @return the sum of the function values of the samples
+     */
+    virtual T accumulateGradient(const T* params, int firstSample, int endSample, T* gradient) const = 0;
+  };
+
   /**
    * An interface for functions optimized with respect to residual
    * values. This type of function can be optimized with the
@@ -184,6 +222,30 @@ namespace PiiOptimization
                                                          double epsX = 1e-8,
                                                          int maxIterations = 100);
 
+  /**
+   * Minimizes a sum of sample functions with the BFGS method. The
+   * samples are divided into fixed-size blocks whose gradients are
+   * calculated concurrently as determined by *policy*. The partial
+   * sums are always added in the same order, and the result does not
+   * depend on the number of threads. The buffers holding the partial
+   * sums are allocated once and reused in all iterations.
+   *
+   * The parameters are the same as above.
+   *
+   * ~~~(c++)
+   * MyErrorFunction func(matMeasurements);
+   * PiiMatrix<double> matParams = PiiOptimization::bfgsMinimize(&func, matInitial,
+   *                                                               PiiParallelPolicy());
+   * ~~~
+   */
+  PII_OPTIMIZATION_EXPORT PiiMatrix<double> bfgsMinimize(const SampleGradientFunction<double>* function,
+                                                         const PiiMatrix<double>& initialParams,
+                                                         const PiiParallelPolicy& policy,
+                                                         double epsG = 1e-8,
+                                                         double epsF = 1e-8,
+                                                         double epsX = 1e-8,
+                                                         int maxIterations = 100);
+
   /**
    * The Levenberg-Marquardt is a method of non-linear optimization.
    * It minimizes the sum of the squares of M nonlinear functions in N
@@ -19,6 +19,7 @@
 #include <PiiFunctional.h>
 #include <PiiRandom.h>
 #include <PiiMath.h>
+#include <PiiParallel.h>
 #include <QVector>
 
 PiiRansac::Data::Data() :
@@ -26,7 +27,9 @@ PiiRansac::Data::Data() :
   iMaxSamplings(100),
   iMinInliers(0),
   dFittingThreshold(16),
-  dSelectionProbability(0.99)
+  dSelectionProbability(0.99),
+  iThreadCount(1),
+  iPreemptiveSampleCount(0)
 {
 }
 
@@ -46,6 +49,102 @@ PiiRansac::~PiiRansac()
   delete d;
 }
 
+namespace
+{
+  // The number of samples matched with a single fitSamplesToModel()
+  // call. The full evaluation of a candidate may be terminated
+  // between blocks.
+  const int iFitBlockSize = 256;
+}
+
+/* Matches a batch of model candidates against the observed data.
+ * Each candidate is first scored on the preemptive subset, if
+ * there is one. The candidates that pass are matched against all
+ * samples, block by block, until they can no longer beat the best
+ * model of the previous batch. The inliers of rejected candidates
+ * are left empty.
+ */
+class PiiRansac::HypothesisScorer
+{
+public:
+  HypothesisScorer(PiiRansac* ransac,
+                   int samples,
+                   const QVector<PiiMatrix<double> >& candidates,
+                   const QVector<int>& preemptiveIndices,
+                   int bestInlierCount,
+                   QVector<QVector<int> >& inliers) :
+    _pRansac(ransac),
+    _iSamples(samples),
+    _candidates(candidates),
+    _preemptiveIndices(preemptiveIndices),
+    _iBestInlierCount(bestInlierCount),
+    _iPreemptiveLimit(0),
+    _inliers(inliers)
+  {
+    if (!preemptiveIndices.isEmpty() && bestInlierCount > 0)
+      {
+        /* A candidate that is at least as good as the best one so far
+         * finds its share of inliers on the subset with a binomial
+         * distribution. Rejecting candidates that fall 3 sigma short
+         * of the expected count very rarely loses a better model.
+         */
+        const double dFraction = double(bestInlierCount) / samples;
+        const double dExpected = dFraction * preemptiveIndices.size();
+        _iPreemptiveLimit = int(Pii::ceil(dExpected - 3 * Pii::sqrt(dExpected * (1.0 - dFraction))));
+      }
+  }
+
+  void operator() (int firstCandidate, int endCandidate)
+  {
+    double adFits[iFitBlockSize];
+    for (int i = firstCandidate; i < endCandidate; ++i)
+      score(_candidates[i].constRowBegin(0), _inliers[i], adFits);
+  }
+
+private:
+  void score(const double* model, QVector<int>& inliers, double* fits)
+  {
+    inliers.resize(0);
+    const double dFittingThreshold = _pRansac->fittingThreshold(model);
+
+    if (_iPreemptiveLimit > 0)
+      {
+        int iSubsetInliers = 0;
+        for (int i = 0; i < _preemptiveIndices.size(); ++i)
+          if (_pRansac->fitToModel(_preemptiveIndices[i], model) < dFittingThreshold)
+            ++iSubsetInliers;
+        if (iSubsetInliers < _iPreemptiveLimit)
+          return;
+      }
+
+    for (int iFirst = 0; iFirst < _iSamples; iFirst += iFitBlockSize)
+      {
+        // Even if all remaining samples were inliers, this candidate
+        // wouldn't be better than the best one.
+        if (inliers.size() + _iSamples - iFirst <= _iBestInlierCount)
+          {
+            inliers.resize(0);
+            return;
+          }
+        const int iCount = qMin(iFitBlockSize, _iSamples - iFirst);
+        _pRansac->fitSamplesToModel(iFirst, iCount, model, fits);
+        // Store points that match to the model with an error less
+        // than the threshold.
+        for (int i = 0; i < iCount; ++i)
+          if (fits[i] < dFittingThreshold)
+            inliers << iFirst + i;
+      }
+  }
+
+  PiiRansac* _pRansac;
+  int _iSamples;
+  const QVector<PiiMatrix<double> >& _candidates;
+  const QVector<int>& _preemptiveIndices;
+  int _iBestInlierCount;
+  int _iPreemptiveLimit;
+  QVector<QVector<int> >& _inliers;
+};
+
 bool PiiRansac::findBestModel()
 {
   const int iSamples = totalSampleCount();
@@ -67,65 +166,79 @@ bool PiiRansac::findBestModel()
   Pii::shuffleN(vecIndices.begin(), iSamples);
   int iSubsetStartIndex = 0;
 
+  // The same random subset is used for scoring all candidates.
+  QVector<int> vecPreemptiveIndices;
+  if (d->iPreemptiveSampleCount > 0 && d->iPreemptiveSampleCount < iSamples)
+    Pii::selectRandomly(vecPreemptiveIndices, d->iPreemptiveSampleCount, iSamples);
+
+  const PiiParallelPolicy policy(d->iThreadCount, 1);
+  const int iThreads = policy.stripCount(d->iMaxIterations);
+
+  // Model candidates of the current batch, one matrix each
+  QVector<PiiMatrix<double> > vecCandidates;
+  // This vector stores the indices of inlying points for each
+  // candidate.
+  QVector<QVector<int> > vecInliers;
+
   while (iIterations < qMin(d->iMaxIterations, iRequiredIterations))
     {
-      PiiMatrix<double> matModels;
-      int iSamplingCount = 0;
-
-      // Try hard to find a non-degenerate model
-      while (matModels.isEmpty() && iSamplingCount < d->iMaxSamplings)
+      // Draw a sample for each thread. In sequential mode, a batch
+      // consists of the candidates found with a single sample.
+      const int iBatchSize = qMin(iThreads, qMin(d->iMaxIterations, iRequiredIterations) - iIterations);
+      vecCandidates.resize(0);
+      for (int iBatch = 0; iBatch < iBatchSize; ++iBatch)
         {
-          // No more random orderings left -> reshuffle the samples
-          // and start over.
-          if (iSubsetStartIndex + iMinSamples > vecIndices.size())
+          PiiMatrix<double> matModels;
+          int iSamplingCount = 0;
+
+          // Try hard to find a non-degenerate model
+          while (matModels.isEmpty() && iSamplingCount < d->iMaxSamplings)
             {
-              Pii::shuffleN(vecIndices.begin(), iSamples);
-              iSubsetStartIndex = 0;
+              // No more random orderings left -> reshuffle the samples
+              // and start over.
+              if (iSubsetStartIndex + iMinSamples > vecIndices.size())
+                {
+                  Pii::shuffleN(vecIndices.begin(), iSamples);
+                  iSubsetStartIndex = 0;
+                }
+              matModels = findPossibleModels(vecIndices.data() + iSubsetStartIndex);
+              iSubsetStartIndex += iMinSamples;
+              ++iSamplingCount;
+              // Special case: if there is only one way to select the
+              // samples, there is no need to try again.
+              if (iSamples == iMinSamples)
+                break;
             }
-          matModels = findPossibleModels(vecIndices.data() + iSubsetStartIndex);
-          iSubsetStartIndex += iMinSamples;
-          ++iSamplingCount;
-          // Special case: if there is only one way to select the
-          // samples, there is no need to try again.
-          if (iSamples == iMinSamples)
-            break;
-        }
 
-      // We are out of luck. No model could be found.
-      if (matModels.isEmpty())
-        return false;
+          // We are out of luck. No model could be found.
+          if (matModels.isEmpty())
+            return false;
 
-      // This vector stores the indices of selected inlying points.
-      QVector<int> vecInliers;
-      vecInliers.reserve(iSamples);
+          for (int iModel = 0; iModel < matModels.rows(); ++iModel)
+            vecCandidates << matModels(iModel, 0, 1, -1);
+        }
+      iIterations += iBatchSize;
 
       // Test all possible models
-      for (int iModel = 0; iModel < matModels.rows(); ++iModel)
-        {
-          // Clear the inlier list at the beginning of each round.
-          vecInliers.resize(0);
-
-          const double* pModel = matModels.constRowBegin(iModel);
-          double dFittingThreshold = fittingThreshold(pModel);
-          // Match all points against the current model
-          for (int iPoint = 0; iPoint < iSamples; ++iPoint)
-            {
-              // Store points that match to the model with an error
-              // less than the threshold.
-              if (fitToModel(iPoint, pModel) < dFittingThreshold)
-                vecInliers << iPoint;
-            }
+      const int iCandidates = vecCandidates.size();
+      if (vecInliers.size() < iCandidates)
+        vecInliers.resize(iCandidates);
+      HypothesisScorer scorer(this, iSamples, vecCandidates, vecPreemptiveIndices,
+                              d->vecBestInliers.size(), vecInliers);
+      Pii::forEachStrip(iCandidates, scorer, policy);
 
+      for (int iCandidate = 0; iCandidate < iCandidates; ++iCandidate)
+        {
           // If the number of inliers is the best so far, store the
           // score.
-          const int iInlierCount = vecInliers.size();
+          const int iInlierCount = vecInliers[iCandidate].size();
           if (iInlierCount > d->vecBestInliers.size())
             {
               //piiDebug("Inliers: %d", iInlierCount);
-              if (iInlierCount > minInliers(pModel))
+              if (iInlierCount > minInliers(vecCandidates[iCandidate].constRowBegin(0)))
                 {
-                  d->vecBestInliers = vecInliers;
-                  d->matBestModel = matModels(iModel, 0, 1, -1);
+                  d->vecBestInliers = vecInliers[iCandidate];
+                  d->matBestModel = vecCandidates[iCandidate];
                 }
 
               // The fraction of inliers
@@ -137,12 +250,17 @@ bool PiiRansac::findBestModel()
                 iRequiredIterations = 0;
             }
         }
-      ++iIterations;
     }
 
   return !d->matBestModel.isEmpty();
 }
 
+void PiiRansac::fitSamplesToModel(int firstIndex, int count, const double* model, double* fits)
+{
+  for (int i = 0; i < count; ++i)
+    fits[i] = fitToModel(firstIndex + i, model);
+}
+
 PiiMatrix<double> PiiRansac::bestModel() const { return d->matBestModel; }
 QVector<int> PiiRansac::inlyingPoints() const { return d->vecBestInliers; }
 int PiiRansac::inlierCount() const { return d->vecBestInliers.size(); }
@@ -158,3 +276,7 @@ double PiiRansac::fittingThreshold() const { return d->dFittingThreshold; }
 double PiiRansac::fittingThreshold(const double*) const { return d->dFittingThreshold; }
 void PiiRansac::setSelectionProbability(double selectionProbability) { d->dSelectionProbability = selectionProbability; }
 double PiiRansac::selectionProbability() const { return d->dSelectionProbability; }
+void PiiRansac::setThreadCount(int threadCount) { d->iThreadCount = qMax(0, threadCount); }
+int PiiRansac::threadCount() const { return d->iThreadCount; }
+void PiiRansac::setPreemptiveSampleCount(int preemptiveSampleCount) { d->iPreemptiveSampleCount = qMax(0, preemptiveSampleCount); }
+int PiiRansac::preemptiveSampleCount() const { return d->iPreemptiveSampleCount; }
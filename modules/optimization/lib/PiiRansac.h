@@ -144,6 +144,51 @@ public:
    */
   double selectionProbability() const;
 
+  /**
+   * Sets the number of threads used for evaluating model candidates.
+   * The algorithm draws a batch of candidates, one or more per
+   * thread, and matches them against the observed data in parallel
+   * (see PiiParallelPolicy). Candidates are always drawn and
+   * [findPossibleModels()] called in the calling thread, but
+   * [fitToModel()], [fitSamplesToModel()], [minInliers(const
+   * double*)] and [fittingThreshold(const double*)] will be called
+   * concurrently and must be reentrant in subclasses. Zero means
+   * QThread::idealThreadCount(). The default is one, which runs the
+   * algorithm sequentially.
+   *
+   * Since the number of required iterations is only updated after
+   * each batch, a parallel run may evaluate a few more candidates
+   * than a sequential one.
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Returns the number of threads used for evaluating model
+   * candidates.
+   */
+  int threadCount() const;
+
+  /**
+   * Sets the number of samples used for preemptive scoring. If this
+   * value is non-zero, findBestModel() picks this many random
+   * samples at the beginning and first matches each model candidate
+   * against them only. Candidates whose inlier count on the subset
+   * is too low to be better than the best model found so far (with
+   * a 3-sigma margin) are rejected without a full evaluation. Since
+   * most candidates in a RANSAC run are wrong, this saves most of
+   * the matching effort with large data sets. The default is zero,
+   * which disables preemptive scoring. Values of about 50-100 are
+   * typically enough. Preemption is disabled if there are no more
+   * samples than this value.
+   *
+   * The full evaluation of a candidate is always stopped as soon as
+   * it can no longer beat the best model found so far.
+   */
+  void setPreemptiveSampleCount(int preemptiveSampleCount);
+  /**
+   * Returns the number of samples used for preemptive scoring.
+   */
+  int preemptiveSampleCount() const;
+
 protected:
   /// @internal
   class PII_OPTIMIZATION_EXPORT Data
@@ -157,6 +202,8 @@ protected:
     int iMinInliers;
     double dFittingThreshold;
     double dSelectionProbability;
+    int iThreadCount;
+    int iPreemptiveSampleCount;
     QVector<int> vecBestInliers;
     PiiMatrix<double> matBestModel;
   } *d;
@@ -231,6 +278,19 @@ protected:
    */
   virtual double fitToModel(int dataIndex, const double* model) = 0;
 
+  /**
+   * Fits *count* consecutive samples starting at *firstIndex* to the
+   * given *model* and stores the results to *fits*. findBestModel()
+   * uses this function to evaluate model candidates against all
+   * observed data. The default implementation calls [fitToModel()]
+   * for each sample. Subclasses should override this function with a
+   * loop that avoids the per-sample overhead and recalculation of
+   * values derived from the model. Such loops can often be
+   * vectorized by the compiler. The results must be equal to those
+   * of [fitToModel()].
+   */
+  virtual void fitSamplesToModel(int firstIndex, int count, const double* model, double* fits);
+
   /**
    * Returns the minimum number of inliers required to match the given
    * *model*. Subclasses may override this function to return a
@@ -247,6 +307,9 @@ protected:
    */
   virtual double fittingThreshold(const double* model) const;
 
+private:
+  class HypothesisScorer;
+
   PII_DISABLE_COPY(PiiRansac);
 };
 
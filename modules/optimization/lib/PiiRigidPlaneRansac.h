@@ -218,6 +218,14 @@ protected:
    */
   double fitToModel(int dataIndex, const double* model);
 
+  /**
+   * Transforms *count* points starting at *firstIndex* at once. The
+   * rotation matrix is calculated only once, and the loop is
+   * vectorized by the compiler if both point sets are stored
+   * contiguously.
+   */
+  void fitSamplesToModel(int firstIndex, int count, const double* model, double* fits);
+
 private:
   class Data :
     public PiiRansac::Data,
@@ -412,6 +420,40 @@ template <class T> double PiiRigidPlaneRansac<T>::fitToModel(int dataIndex, cons
                                0.0);
 }
 
+template <class T> void PiiRigidPlaneRansac<T>::fitSamplesToModel(int firstIndex, int count,
+                                                                  const double* model, double* fits)
+{
+  const PII_D;
+  const double dCos = model[0] * Pii::cos(model[1]), dSin = model[0] * Pii::sin(model[1]);
+  const double dTx = model[2], dTy = model[3];
+  if (d->matPoints1.stride() == 2 * sizeof(T) && d->matPoints2.stride() == 2 * sizeof(T))
+    {
+      // Both point sets are packed. Treat them as flat arrays of
+      // interleaved coordinates.
+      const T* pPoints1 = d->matPoints1[firstIndex];
+      const T* pPoints2 = d->matPoints2[firstIndex];
+      for (int i = 0; i < count; ++i)
+        {
+          const double dX1 = double(pPoints1[2*i]), dY1 = double(pPoints1[2*i+1]);
+          const double dX = dCos * dX1 - dSin * dY1 + dTx - double(pPoints2[2*i]);
+          const double dY = dSin * dX1 + dCos * dY1 + dTy - double(pPoints2[2*i+1]);
+          fits[i] = dX * dX + dY * dY;
+        }
+    }
+  else
+    {
+      for (int i = 0; i < count; ++i)
+        {
+          const T* pPoint1 = d->matPoints1[firstIndex + i];
+          const T* pPoint2 = d->matPoints2[firstIndex + i];
+          const double dX1 = double(pPoint1[0]), dY1 = double(pPoint1[1]);
+          const double dX = dCos * dX1 - dSin * dY1 + dTx - double(pPoint2[0]);
+          const double dY = dSin * dX1 + dCos * dY1 + dTy - double(pPoint2[1]);
+          fits[i] = dX * dX + dY * dY;
+        }
+    }
+}
+
 template <class T> PiiMatrix<double> PiiRigidPlaneRansac<T>::transform(const PiiMatrix<T>& points, const double* model)
 {
   PiiMatrix<double> matResult(points.rows(), 2);
@@ -20,6 +20,7 @@
 PiiHistogramCollector::Data::Data() :
   iBinCount(256),
   bSyncConnected(false),
+  bBinsConnected(false),
   outputMode(FixedLengthOutput),
   pSyncObject(0),
   bNormalized(false)
@@ -33,6 +34,9 @@ PiiHistogramCollector::PiiHistogramCollector() :
   inputAt(0)->setOptional(true);
   addSocket(new PiiInputSocket("data"));
   inputAt(1)->setGroupId(1);
+  addSocket(new PiiInputSocket("bins"));
+  inputAt(2)->setOptional(true);
+  inputAt(2)->setGroupId(1);
 
   addSocket(new PiiOutputSocket("sync"));
   addSocket(new PiiOutputSocket("y"));
@@ -43,7 +47,11 @@ void PiiHistogramCollector::check(bool reset)
 {
   PII_D;
   d->bSyncConnected = inputAt(0)->isConnected();
+  d->bBinsConnected = inputAt(2)->isConnected();
   inputAt(1)->setGroupId(d->bSyncConnected ? 1 : 0);
+  inputAt(2)->setGroupId(d->bSyncConnected ? 1 : 0);
+  d->vecSparseBins.clear();
+  d->vecSparseCounts.clear();
 
   if (d->outputMode == FixedLengthOutput)
     {
@@ -64,6 +72,22 @@ void PiiHistogramCollector::check(bool reset)
 void PiiHistogramCollector::emitHistogram()
 {
   PII_D;
+  if (d->bBinsConnected && d->outputMode == VariableLengthOutput)
+    {
+      const int iBinCount = d->vecSparseBins.size();
+      PiiMatrix<int> matCounts(PiiMatrix<int>::uninitialized(1, iBinCount));
+      PiiMatrix<qint64> matBins(PiiMatrix<qint64>::uninitialized(1, iBinCount));
+      qCopy(d->vecSparseCounts.begin(), d->vecSparseCounts.end(), matCounts.rowBegin(0));
+      qCopy(d->vecSparseBins.begin(), d->vecSparseBins.end(), matBins.rowBegin(0));
+      if (!d->bNormalized)
+        outputAt(1)->emitObject(matCounts);
+      else
+        outputAt(1)->emitObject(Pii::matrix(matCounts.mapped(std::multiplies<float>(),
+                                                             1.0 / Pii::sum<int>(matCounts))));
+      outputAt(2)->emitObject(matBins);
+      return;
+    }
+
   if (!d->bNormalized)
     outputAt(1)->emitObject(d->matHistogram);
   else
@@ -72,6 +96,72 @@ void PiiHistogramCollector::emitHistogram()
   outputAt(2)->emitObject(d->matX);
 }
 
+void PiiHistogramCollector::clearHistogram()
+{
+  PII_D;
+  if (d->bBinsConnected && d->outputMode == VariableLengthOutput)
+    {
+      d->vecSparseBins.clear();
+      d->vecSparseCounts.clear();
+    }
+  else
+    for ( int i=0; i<d->matHistogram.columns(); i++)
+      d->matHistogram(0,i) = 0;
+}
+
+/* Both the collected and the incoming bins are sorted, which makes
+   merging a single linear pass.
+ */
+void PiiHistogramCollector::mergeHistogram(const PiiMatrix<int>& counts, const PiiMatrix<qint64>& bins)
+{
+  PII_D;
+  if (counts.rows() != 1 || bins.rows() != 1 || counts.columns() != bins.columns())
+    PII_THROW(PiiExecutionException, tr("Bins and counts must be row vectors of equal length."));
+
+  const int iCount = bins.columns();
+  const qint64* pBins = bins[0];
+  const int* pCounts = counts[0];
+
+  if (d->outputMode == FixedLengthOutput)
+    {
+      for (int i=0; i<iCount; ++i)
+        if (pBins[i] >= 0 && pBins[i] < d->matHistogram.columns())
+          d->matHistogram(0, int(pBins[i])) += pCounts[i];
+      return;
+    }
+
+  for (int i=1; i<iCount; ++i)
+    if (pBins[i] <= pBins[i-1])
+      PII_THROW(PiiExecutionException, tr("Histogram bins must be in ascending order."));
+
+  QVector<qint64> vecBins;
+  QVector<int> vecCounts;
+  vecBins.reserve(d->vecSparseBins.size() + iCount);
+  vecCounts.reserve(d->vecSparseBins.size() + iCount);
+  int iOld = 0, iNew = 0;
+  const int iOldCount = d->vecSparseBins.size();
+  while (iOld < iOldCount || iNew < iCount)
+    {
+      if (iNew == iCount || (iOld < iOldCount && d->vecSparseBins[iOld] < pBins[iNew]))
+        {
+          vecBins << d->vecSparseBins[iOld];
+          vecCounts << d->vecSparseCounts[iOld++];
+        }
+      else if (iOld == iOldCount || pBins[iNew] < d->vecSparseBins[iOld])
+        {
+          vecBins << pBins[iNew];
+          vecCounts << pCounts[iNew++];
+        }
+      else
+        {
+          vecBins << pBins[iNew];
+          vecCounts << d->vecSparseCounts[iOld++] + pCounts[iNew++];
+        }
+    }
+  d->vecSparseBins.swap(vecBins);
+  d->vecSparseCounts.swap(vecCounts);
+}
+
 void PiiHistogramCollector::syncEvent(SyncEvent* event)
 {
   PII_D;
@@ -83,9 +173,7 @@ void PiiHistogramCollector::syncEvent(SyncEvent* event)
       outputAt(1)->endDelay();
       outputAt(2)->endDelay();
 
-      //clear the histogram
-      for ( int i=0; i<d->matHistogram.columns(); i++)
-        d->matHistogram(0,i) = 0;
+      clearHistogram();
     }
 }
 
@@ -96,6 +184,29 @@ void PiiHistogramCollector::process()
     {
       PiiVariant obj = inputAt(1)->firstObject();
 
+      if (d->bBinsConnected)
+        {
+          PiiMatrix<int> matCounts;
+          PiiMatrix<qint64> matBins;
+          PiiVariant binsObj = inputAt(2)->firstObject();
+          switch (obj.type())
+            {
+              PII_INTEGER_MATRIX_CASES(matCounts = (PiiMatrix<int>)PiiYdin::matrixAs, obj);
+            default:
+              PII_THROW_UNKNOWN_TYPE(inputAt(1));
+            }
+          switch (binsObj.type())
+            {
+              PII_INTEGER_MATRIX_CASES(matBins = (PiiMatrix<qint64>)PiiYdin::matrixAs, binsObj);
+            default:
+              PII_THROW_UNKNOWN_TYPE(inputAt(2));
+            }
+          mergeHistogram(matCounts, matBins);
+          if (!d->bSyncConnected)
+            emitHistogram();
+          return;
+        }
+
       switch (obj.type())
         {
           PII_PRIMITIVE_CASES(addPrimitive, obj);
@@ -35,7 +35,17 @@
  * received, each element in the matrix will be added to the
  * histogram. If a scalar is received, it will be added to the
  * histogram. The data will be converted to integers before adding to
- * the histogram.
+ * the histogram. If `bins` is connected, `data` must be an integer
+ * matrix of bin counts.
+ *
+ * @in bins - an optional input for bin indices. If this input is
+ * connected, `data` and `bins` together carry a sparse histogram
+ * such as the one produced by PiiMultiVariableHistogram in
+ * `SparseJointDistribution` mode: `data` is a 1-by-N matrix of counts
+ * and `bins` a 1-by-N matrix of the corresponding bin indices in
+ * ascending order (any integer matrix). Incoming histograms are
+ * merged into the collected one in time linear to their combined
+ * length.
  *
  * Outputs
  * -------
@@ -59,7 +69,9 @@
  * PiiMatrix<int>. In `FixedLengthOutput` mode this will always be
  * the same: (0, 1, 2, ..., [binCount]-1). In `VariableLengthOutput`
  * mode the size of the matrix will be equal to that of `y`. The
- * coordinates will always be in ascending order.
+ * coordinates will always be in ascending order. If `bins` is
+ * connected, the coordinates are emitted as a PiiMatrix<qint64> in
+ * `VariableLengthOutput` mode.
  *
  */
 class PiiHistogramCollector : public PiiDefaultOperation
@@ -125,6 +137,8 @@ private:
   void addToHistogram(int element);
   template <class T> void addPrimitive(const PiiVariant& obj);
   template <class T> void addMatrix(const PiiVariant& obj);
+  void mergeHistogram(const PiiMatrix<int>& counts, const PiiMatrix<qint64>& bins);
+  void clearHistogram();
   void emitHistogram();
 
   /// @internal
@@ -134,9 +148,13 @@ private:
     Data();
 
     int iBinCount;
-    bool bSyncConnected;
+    bool bSyncConnected, bBinsConnected;
     PiiMatrix<int> matHistogram;
     PiiMatrix<int> matX;
+    // The collected sparse histogram if bins are connected in
+    // VariableLengthOutput mode.
+    QVector<qint64> vecSparseBins;
+    QVector<int> vecSparseCounts;
     OutputMode outputMode;
     PiiVariant pSyncObject;
     bool bNormalized;
@@ -18,7 +18,10 @@
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
 
+#include <QHash>
+
 #define LENGTH_LIMIT (1<<24)
+#define SPARSE_LENGTH_LIMIT (Q_INT64_C(1)<<62)
 
 PiiMultiVariableHistogram::Data::Data() :
   distributionType(JointDistribution),
@@ -33,6 +36,7 @@ PiiMultiVariableHistogram::PiiMultiVariableHistogram() :
   setInputCount(1);
 
   addSocket(_d()->pHistogramOutput = new PiiOutputSocket("histogram"));
+  addSocket(_d()->pBinsOutput = new PiiOutputSocket("bins"));
 }
 
 PiiMultiVariableHistogram::~PiiMultiVariableHistogram()
@@ -74,7 +78,18 @@ void PiiMultiVariableHistogram::check(bool reset)
   if (d->vecSteps[0] > LENGTH_LIMIT)
     throwTooLong();
 
-  if (d->distributionType == JointDistribution)
+  if (d->distributionType == SparseJointDistribution)
+    {
+      for (int i=1; i<d->vecLevels.size(); i++)
+        {
+          if (d->vecLevels[i] > LENGTH_LIMIT || d->vecSteps[i-1] > SPARSE_LENGTH_LIMIT / d->vecLevels[i])
+            throwTooLong();
+          d->vecSteps << d->vecSteps[i-1]*d->vecLevels[i];
+        }
+    }
+  else if (d->pBinsOutput->isConnected())
+    PII_THROW(PiiExecutionException, tr("The bins output can only be used with a sparse distribution."));
+  else if (d->distributionType == JointDistribution)
     {
       // The first multiplier (1) is omitted. The last one tells the total
       // length of the histogram.
@@ -180,8 +195,14 @@ void PiiMultiVariableHistogram::process()
         }
     }
 
+  if (d->distributionType == SparseJointDistribution)
+    {
+      sparseHistogram(lstMatrices, iRows, iColumns);
+      return;
+    }
+
   // Allocate size for the histogram
-  PiiMatrix<int> matResult(1, d->vecSteps.last());
+  PiiMatrix<int> matResult(1, int(d->vecSteps.last()));
   if (d->distributionType == JointDistribution)
     jointHistogram(lstMatrices, iRows, iColumns, &matResult);
   else
@@ -239,5 +260,45 @@ void PiiMultiVariableHistogram::marginalHistograms(const QList<PiiMatrix<int> >&
     }
 }
 
+void PiiMultiVariableHistogram::sparseHistogram(const QList<PiiMatrix<int> >& matrices,
+                                                int rows, int columns)
+{
+  PII_D;
+
+  const int iDimensions = matrices.size();
+  QHash<qint64,int> hashCounts;
+  // Most images have much fewer distinct values than pixels.
+  hashCounts.reserve(qMin(rows * columns, 1 << 16));
+  for (int r=0; r<rows; ++r)
+    {
+      const int* pFirstRow = const_cast<const PiiMatrix<int>&>(matrices[0])[r];
+      for (int c=0; c<columns; ++c)
+        {
+          qint64 index = qBound(0, pFirstRow[c], d->vecLevels[0]-1);
+          for (int k=1; k<iDimensions; ++k)
+            index += d->vecSteps[k-1] * qBound(0, const_cast<const PiiMatrix<int>&>(matrices[k])(r, c), d->vecLevels[k]-1);
+          ++hashCounts[index];
+        }
+    }
+
+  QList<qint64> lstBins(hashCounts.keys());
+  qSort(lstBins);
+  const int iBinCount = lstBins.size();
+  PiiMatrix<qint64> matBins(PiiMatrix<qint64>::uninitialized(1, iBinCount));
+  PiiMatrix<int> matCounts(PiiMatrix<int>::uninitialized(1, iBinCount));
+  for (int i=0; i<iBinCount; ++i)
+    {
+      matBins(0,i) = lstBins[i];
+      matCounts(0,i) = hashCounts[lstBins[i]];
+    }
+
+  if (d->bNormalized)
+    d->pHistogramOutput->emitObject(Pii::matrix(matCounts.mapped(std::bind2nd(std::multiplies<double>(),
+                                                                              1.0 / (rows * columns)))));
+  else
+    d->pHistogramOutput->emitObject(matCounts);
+  d->pBinsOutput->emitObject(matBins);
+}
+
 void PiiMultiVariableHistogram::setNormalized(bool normalize) { _d()->bNormalized = normalize; }
 bool PiiMultiVariableHistogram::normalized() const { return _d()->bNormalized; }
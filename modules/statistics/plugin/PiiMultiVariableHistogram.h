@@ -58,7 +58,15 @@
  *
  * @out histogram - a multi-dimensional histogram folded into a
  * one-dimensional row matrix, or multiple one-dimensional histograms
- * concatenated into a row matrix (PiiMatrix<int>).
+ * concatenated into a row matrix (PiiMatrix<int>). In
+ * `SparseJointDistribution` mode, only the non-empty bins of the
+ * joint histogram.
+ *
+ * @out bins - the folded indices of the non-empty bins in
+ * `SparseJointDistribution` mode, in ascending order
+ * (PiiMatrix<qint64>). The size of the matrix equals that of
+ * `histogram`. This output can only be connected in
+ * `SparseJointDistribution` mode.
  *
  */
 class PiiMultiVariableHistogram : public PiiDefaultOperation
@@ -79,7 +87,8 @@ class PiiMultiVariableHistogram : public PiiDefaultOperation
    * for practical use. In theory, this allows one to create a
    * three-dimensional color histogram out of three 8-bit color
    * channels. In `MarginalDistributions` mode, the same limit holds
-   * for the sum of levels.
+   * for the sum of levels. In `SparseJointDistribution` mode, the
+   * product of the levels can be at most 2^62.
    */
   Q_PROPERTY(QVariantList levels READ levels WRITE setLevels);
 
@@ -126,8 +135,17 @@ public:
    * - `MarginalDistributions` - marginal distributions will be
    * created for each input and concatenated together. The length of
    * the histogram will be \(\sum_i l_i\).
+   *
+   * - `SparseJointDistribution` - a joint distribution in which only
+   * the non-empty bins are stored. The bins are the same as in
+   * `JointDistribution`, but they are collected into a hash table,
+   * and the memory needed depends on the number of distinct values in
+   * the input, not on the product of levels. This makes it possible
+   * to build joint histograms out of four or more variables. The
+   * indices of the emitted bins are sent through the `bins` output.
+   * PiiHistogramCollector can merge sparse histograms.
    */
-  enum DistributionType { JointDistribution, MarginalDistributions };
+  enum DistributionType { JointDistribution, MarginalDistributions, SparseJointDistribution };
 
   PiiMultiVariableHistogram();
   ~PiiMultiVariableHistogram();
@@ -152,6 +170,7 @@ private:
   void setInputCount(int cnt);
   void jointHistogram(const QList<PiiMatrix<int> >& matrices, int rows, int columns, PiiMatrix<int>* result);
   void marginalHistograms(const QList<PiiMatrix<int> >& matrices, int rows, int columns, PiiMatrix<int>* result);
+  void sparseHistogram(const QList<PiiMatrix<int> >& matrices, int rows, int columns);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -160,9 +179,10 @@ private:
     Data();
 
     QVector<int> vecLevels;
-    QVector<int> vecSteps;
+    QVector<qint64> vecSteps;
     QVector<double> vecScales;
     PiiOutputSocket* pHistogramOutput;
+    PiiOutputSocket* pBinsOutput;
     DistributionType distributionType;
     bool bNormalized;
   };
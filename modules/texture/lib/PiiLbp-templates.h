@@ -37,11 +37,12 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
   if (d->mode == Symmetric)
     return genericSymmetricLbp<MatrixClass>(image, roi);
 
-  if (d->mode == Standard &&
-      d->interpolation == Pii::NearestNeighborInterpolation &&
+  // The 8,1 neighborhood samples the same pixels as basicLbp(). The
+  // other modes are just a table look-up away.
+  if (d->interpolation == Pii::NearestNeighborInterpolation &&
       d->iSamples == 8 &&
       d->dRadius == 1)
-    return basicLbp<MatrixClass>(image, roi, centerFunc);
+    return mappedBasicLbp<MatrixClass>(image, roi, centerFunc, d->pLookup, featureCount(8, d->mode));
 
   // This much free space must be ensured on all sides.
   const int iMargin = (int)std::ceil(d->dRadius);
@@ -62,16 +63,21 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
       const T* centerPtr;
       for (r=iMargin; r<image.rows()-iMargin; ++r)
         {
+          // Skip the columns (or the whole row) outside of the ROI.
+          int iFirst = iMargin, iEnd = image.columns()-iMargin;
+          if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+
           // Tell our matrix that we're about to handle a new row.
           result.changeRow(r);
 
           // Initialize pointers to center and neighbors at the start
           // of each row sweep
           for (bit=0; bit<iSamples; ++bit)
-            neighborPtr[bit] = image.row(r+d->pPoints[bit].nearestY) + (d->pPoints[bit].nearestX + iMargin);
-          centerPtr = image.row(r) + iMargin;
+            neighborPtr[bit] = image.row(r+d->pPoints[bit].nearestY) + (d->pPoints[bit].nearestX + iFirst);
+          centerPtr = image.row(r) + iFirst;
 
-          for (c=iMargin; c<image.columns()-iMargin; ++c)
+          for (c=iFirst; c<iEnd; ++c)
             {
               if (roi(r,c))
                 {
@@ -108,69 +114,73 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
   else
     {
       MatrixClass result(image.rows(), image.columns(), iMargin, featureCount(iSamples, d->mode));
-      const T *centerPtr;
-      const T** neighborPtr1 = new const T*[iSamples];
-      const T** neighborPtr2 = new const T*[iSamples];
-      float* coeffs;
-      C center;
+      // The codes of a whole row are built one sample at a time. This
+      // way the zero interpolation coefficients are checked once per
+      // row, not once per pixel.
+      const int iCount = image.columns() - 2*iMargin;
+      if (iCount <= 0)
+        return result;
+      C* pCenters = new C[iCount];
+      unsigned int* pValues = new unsigned int[iCount];
+      const T *centerPtr, *neighborPtr1, *neighborPtr2;
+      const float* coeffs;
       float neighbor;
-      unsigned int value;
       int bit, r, c;
       for (r=iMargin; r<image.rows()-iMargin; ++r)
         {
+          // Only the codes between iFirst and iEnd are calculated.
+          int iFirst = iMargin, iEnd = image.columns()-iMargin;
+          if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+          const int iRowCount = iEnd - iFirst;
+
           // Tell our matrix that we're about to handle a new row.
           result.changeRow(r);
 
-          //Initialize pointers to center and neighbors at the start
-          //of each row sweep. Two pointers for each neighbor are
-          //needed because (in general) two rows of pixels are
-          //accessed at each sample.
-          for (bit=0; bit<iSamples; ++bit)
+          centerPtr = image.row(r) + iFirst;
+          for (c=0; c<iRowCount; ++c)
             {
-              neighborPtr1[bit] = image.row(r+d->pPoints[bit].y) + (d->pPoints[bit].x + iMargin);
-              //Second row is used only if it fits in the image. (It
-              //won't if ceil(radius) = radius).
-              if (r+d->pPoints[bit].y+1 < image.rows())
-                neighborPtr2[bit] = image.row(r+d->pPoints[bit].y+1) + (d->pPoints[bit].x + iMargin);
+              pCenters[c] = centerFunc(centerPtr[c]);
+              pValues[c] = 0;
             }
-          centerPtr = image.row(r) + iMargin;
 
-          for (c=iMargin; c<image.columns()-iMargin; ++c)
+          for (bit=0; bit<iSamples; ++bit)
             {
-              if (roi(r,c))
+              coeffs = d->pPoints[bit].coeffs;
+              // Two rows of pixels are (in general) accessed at each
+              // sample. The second row is used only if it fits in the
+              // image. (It won't if ceil(radius) = radius). In that
+              // case, its coefficients are zero.
+              neighborPtr1 = image.row(r+d->pPoints[bit].y) + (d->pPoints[bit].x + iFirst);
+              neighborPtr2 = r+d->pPoints[bit].y+1 < image.rows() ?
+                image.row(r+d->pPoints[bit].y+1) + (d->pPoints[bit].x + iFirst) : 0;
+              const bool bCoeff1 = coeffs[1] != 0;
+              const bool bCoeff2 = coeffs[2] != 0 && neighborPtr2 != 0;
+              const bool bCoeff3 = coeffs[3] != 0 && neighborPtr2 != 0;
+              for (c=0; c<iRowCount; ++c)
                 {
-                  center = centerFunc(*centerPtr);
-                  //the first bit doesn't need to be shifted
-                  INTERPOLATE_NEIGHBOR(neighbor, 0);
-                  value = Pii::floatSignBit(center, neighbor);
-                  //take the LBP bit for each sample
-                  for (bit=1; bit<iSamples; ++bit)
-                    {
-                      INTERPOLATE_NEIGHBOR(neighbor, bit);
-                      value |= Pii::floatSignBit(center, neighbor) >> bit;
-                    }
+                  neighbor = coeffs[0] * (float)neighborPtr1[c];
+                  if (bCoeff1) neighbor += coeffs[1] * (float)neighborPtr1[c+1];
+                  if (bCoeff2) neighbor += coeffs[2] * (float)neighborPtr2[c];
+                  if (bCoeff3) neighbor += coeffs[3] * (float)neighborPtr2[c+1];
+                  pValues[c] |= Pii::floatSignBit(pCenters[c], neighbor) >> bit;
+                }
+            }
 
-                  // Update the result matrix.
+          // Update the result matrix.
+          for (c=0; c<iRowCount; ++c)
+            {
+              if (roi(r,c+iFirst))
+                {
                   if (bStandardMode)
-                    result.modify(c, static_cast<unsigned int>(value >> iFinalShift));
+                    result.modify(c+iFirst, static_cast<unsigned int>(pValues[c] >> iFinalShift));
                   else
-                    result.modify(c, d->pLookup[value >> iFinalShift]);
+                    result.modify(c+iFirst, d->pLookup[pValues[c] >> iFinalShift]);
                 }
-              else
-                {
-                  // Not in ROI -> just increment neighbor pointers
-                  for (bit=0; bit<iSamples; ++bit)
-                    {
-                      ++neighborPtr1[bit];
-                      ++neighborPtr2[bit];
-                    }
-                }
-
-              ++centerPtr;
             }
         }
-      delete[] neighborPtr1;
-      delete[] neighborPtr2;
+      delete[] pCenters;
+      delete[] pValues;
       return result;
     }
 }
@@ -200,14 +210,18 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
       const T** neighborPtr = new const T*[iSamples];
       for (r=iMargin; r<image.rows()-iMargin; ++r)
         {
+          int iFirst = iMargin, iEnd = image.columns()-iMargin;
+          if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+
           // Tell our matrix that we're about to handle a new row.
           result.changeRow(r);
 
           // Initialize pointers to neighbors at the start of each row
           for (bit=0; bit<iSamples; ++bit)
-            neighborPtr[bit] = image.row(r+d->pPoints[bit].nearestY) + (d->pPoints[bit].nearestX + iMargin);
+            neighborPtr[bit] = image.row(r+d->pPoints[bit].nearestY) + (d->pPoints[bit].nearestX + iFirst);
 
-          for (c=iMargin; c<image.columns()-iMargin; ++c)
+          for (c=iFirst; c<iEnd; ++c)
             {
               if (roi(r,c))
                 {
@@ -249,6 +263,10 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
       int bit, r, c, secondBit;
       for (r=iMargin; r<image.rows()-iMargin; ++r)
         {
+          int iFirst = iMargin, iEnd = image.columns()-iMargin;
+          if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+            continue;
+
           // Tell our matrix that we're about to handle a new row.
           result.changeRow(r);
 
@@ -258,14 +276,14 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
           //accessed at each sample.
           for (bit=0; bit<iSamples; ++bit)
             {
-              neighborPtr1[bit] = image.row(r+d->pPoints[bit].y) + (d->pPoints[bit].x + iMargin);
+              neighborPtr1[bit] = image.row(r+d->pPoints[bit].y) + (d->pPoints[bit].x + iFirst);
               //Second row is used only if it fits in the image. (It
               //won't if ceil(radius) = radius).
               if (r+d->pPoints[bit].y+1 < image.rows())
-                neighborPtr2[bit] = image.row(r+d->pPoints[bit].y+1) + (d->pPoints[bit].x + iMargin);
+                neighborPtr2[bit] = image.row(r+d->pPoints[bit].y+1) + (d->pPoints[bit].x + iFirst);
             }
 
-          for (c=iMargin; c<image.columns()-iMargin; ++c)
+          for (c=iFirst; c<iEnd; ++c)
             {
               if (roi(r,c))
                 {
@@ -303,6 +321,13 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
 
 template <class MatrixClass, class T, class Roi, class UnaryFunction>
 PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc)
+{
+  return mappedBasicLbp<MatrixClass>(image, roi, centerFunc, 0, 256);
+}
+
+template <class MatrixClass, class T, class Roi, class UnaryFunction>
+PiiMatrix<int> PiiLbp::mappedBasicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc,
+                                      const unsigned short* lookup, int features)
 {
   typedef typename UnaryFunction::result_type C;
 
@@ -310,19 +335,35 @@ PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunctio
   register unsigned int value;
   int r, c;
   C center;
-  MatrixClass result(image.rows(), image.columns(), 1, 256);
+  MatrixClass result(image.rows(), image.columns(), 1, features);
+  // Codes for one row if a vectorized implementation is available.
+  const int iCount = image.columns() - 2;
+  unsigned char* pCodes = iCount > 0 ? new unsigned char[iCount] : 0;
 
   for (r=1; r<image.rows()-1; ++r)
     {
+      // Codes are only calculated for columns [iFirst, iEnd).
+      int iFirst = 1, iEnd = image.columns()-1;
+      if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+        continue;
+
       result.changeRow(r);
 
       //Initialize row pointers to the beginning of three successive
       //rows.
-      r0 = image.row(r-1);
-      r1 = image.row(r);
-      r2 = image.row(r+1);
+      r0 = image.row(r-1) + (iFirst-1);
+      r1 = image.row(r) + (iFirst-1);
+      r2 = image.row(r+1) + (iFirst-1);
+
+      if (pCodes != 0 && vectorBasicLbp(r0, r1, r2, iEnd-iFirst, centerFunc, pCodes))
+        {
+          for (c=iFirst; c<iEnd; ++c)
+            if (roi(r,c))
+              result.modify(c, lookup ? lookup[pCodes[c-iFirst]] : pCodes[c-iFirst]);
+          continue;
+        }
 
-      for (c=1; c<image.columns()-1; ++c)
+      for (c=iFirst; c<iEnd; ++c)
         {
           if (roi(r,c))
             {
@@ -339,12 +380,13 @@ PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunctio
               value |= Pii::signBit(center, C(r2[1])) >> 25;
               value |= Pii::signBit(center, C(r2[2])) >> 24;
 
-              result.modify(c, value);
+              result.modify(c, lookup ? lookup[value] : value);
             }
 
           ++r0; ++r1; ++r2;
         }
     }
+  delete[] pCodes;
   return result;
 }
 
@@ -354,18 +396,32 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::basicSym
   register unsigned int value;
   int r, c;
   MatrixClass result(image.rows(), image.columns(), 1, 16);
+  const int iCount = image.columns() - 2;
+  unsigned char* pCodes = iCount > 0 ? new unsigned char[iCount] : 0;
 
   for (r=1; r<image.rows()-1; ++r)
     {
+      int iFirst = 1, iEnd = image.columns()-1;
+      if (!PiiImage::clipToRoi(roi, r, iFirst, iEnd))
+        continue;
+
       result.changeRow(r);
 
       // Initialize row pointers to the beginning of three successive
       // rows.
-      r0 = image.row(r-1);
-      r1 = image.row(r);
-      r2 = image.row(r+1);
+      r0 = image.row(r-1) + (iFirst-1);
+      r1 = image.row(r) + (iFirst-1);
+      r2 = image.row(r+1) + (iFirst-1);
+
+      if (pCodes != 0 && PiiLbpKernel<T>::basicSymmetricLbp(r0, r1, r2, iEnd-iFirst, pCodes))
+        {
+          for (c=iFirst; c<iEnd; ++c)
+            if (roi(r,c))
+              result.modify(c, pCodes[c-iFirst]);
+          continue;
+        }
 
-      for (c=1; c<image.columns()-1; ++c)
+      for (c=iFirst; c<iEnd; ++c)
         {
           if (roi(r,c))
             {
@@ -380,5 +436,6 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::basicSym
           ++r0; ++r1; ++r2;
         }
     }
+  delete[] pCodes;
   return result;
 }
@@ -22,6 +22,7 @@
 #include <PiiFunctional.h>
 #include <cmath>
 #include "PiiTextureGlobal.h"
+#include "PiiLbpKernels.h"
 
 /**
  * An implementation of the Local Binary Patterns (LBP) texture
@@ -308,6 +309,28 @@ public:
   static unsigned short* createLookupTable(int samples, Mode mode);
 
 private:
+  /* The 8,1 operator with nearest neighbor sampling. If *lookup* is
+   * non-zero, codes are mapped through it before they are passed to
+   * the matrix class. This makes it possible to accumulate uniform
+   * and rotation invariant histograms without a code image.
+   */
+  template <class MatrixClass, class T, class Roi, class UnaryFunction>
+  static PiiMatrix<int> mappedBasicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc,
+                                       const unsigned short* lookup, int features);
+
+  // Only the identity function has a vectorized implementation.
+  template <class T, class UnaryFunction>
+  static inline bool vectorBasicLbp(const T*, const T*, const T*, int, UnaryFunction, unsigned char*)
+  {
+    return false;
+  }
+  template <class T>
+  static inline bool vectorBasicLbp(const T* r0, const T* r1, const T* r2, int count,
+                                    Pii::Identity<T>, unsigned char* codes)
+  {
+    return PiiLbpKernel<T>::basicLbp(r0, r1, r2, count, codes);
+  }
+
   struct InterpolationPoint
   {
     int x,y;
@@ -0,0 +1,224 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiLbpKernels.h"
+
+#include <PiiCpuDispatcher.h>
+
+#if defined(PII_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  include <immintrin.h>
+#  define PII_LBP_SSE2 1
+#  if !defined(__GNUC__) || defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define PII_LBP_AVX2 1
+#  endif
+#elif defined(PII_NEON)
+#  include <arm_neon.h>
+#  define PII_LBP_NEON 1
+#endif
+
+typedef unsigned char uchar;
+
+namespace
+{
+  /* Scalar versions for the columns that don't fill a whole vector.
+     A bit is set if the neighbor is strictly larger than the center
+     (or the second pixel of a symmetric pair larger than the first),
+     which is what Pii::signBit() tests in PiiLbp.
+   */
+  inline uchar greater(uchar a, uchar b) { return a > b ? 1 : 0; }
+
+  void basicLbpTail(const uchar* r0, const uchar* r1, const uchar* r2,
+                    int c, int count, uchar* codes)
+  {
+    for (; c<count; ++c)
+      {
+        const uchar center = r1[c+1];
+        codes[c] = uchar(greater(r1[c+2], center) |
+                         greater(r0[c+2], center) << 1 |
+                         greater(r0[c+1], center) << 2 |
+                         greater(r0[c], center) << 3 |
+                         greater(r1[c], center) << 4 |
+                         greater(r2[c], center) << 5 |
+                         greater(r2[c+1], center) << 6 |
+                         greater(r2[c+2], center) << 7);
+      }
+  }
+
+  void basicSymmetricLbpTail(const uchar* r0, const uchar* r1, const uchar* r2,
+                             int c, int count, uchar* codes)
+  {
+    for (; c<count; ++c)
+      codes[c] = uchar(greater(r1[c+2], r1[c]) |
+                       greater(r0[c+2], r2[c]) << 1 |
+                       greater(r0[c+1], r2[c+1]) << 2 |
+                       greater(r0[c], r2[c+2]) << 3);
+  }
+
+  typedef void (*LbpFunction)(const uchar*, const uchar*, const uchar*, int, uchar*);
+}
+
+/* Each comparison produces a byte mask. The masks are reduced to
+   one bit each and collected into a code byte per pixel. The loops
+   are stamped out with a macro because all functions called from an
+   AVX2 loop must have the same target attribute.
+ */
+#define PII_LBP_LOOPS(TARGET)                                           \
+  TARGET void basicLbp(const uchar* r0, const uchar* r1, const uchar* r2, \
+                       int count, uchar* codes)                         \
+  {                                                                     \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        const Vec center = Ops::load(r1 + c + 1);                       \
+        Vec code = Ops::bit(Ops::greater(Ops::load(r1 + c + 2), center), 0); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c + 2), center), 1)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c + 1), center), 2)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c), center), 3)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r1 + c), center), 4)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r2 + c), center), 5)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r2 + c + 1), center), 6)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r2 + c + 2), center), 7)); \
+        Ops::store(codes + c, code);                                    \
+      }                                                                 \
+    basicLbpTail(r0, r1, r2, c, count, codes);                          \
+  }                                                                     \
+                                                                        \
+  TARGET void basicSymmetricLbp(const uchar* r0, const uchar* r1, const uchar* r2, \
+                                int count, uchar* codes)                \
+  {                                                                     \
+    int c = 0;                                                          \
+    for (; c <= count - Ops::Width; c += Ops::Width)                    \
+      {                                                                 \
+        Vec code = Ops::bit(Ops::greater(Ops::load(r1 + c + 2), Ops::load(r1 + c)), 0); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c + 2), Ops::load(r2 + c)), 1)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c + 1), Ops::load(r2 + c + 1)), 2)); \
+        code = Ops::bitOr(code, Ops::bit(Ops::greater(Ops::load(r0 + c), Ops::load(r2 + c + 2)), 3)); \
+        Ops::store(codes + c, code);                                    \
+      }                                                                 \
+    basicSymmetricLbpTail(r0, r1, r2, c, count, codes);                 \
+  }
+
+#ifdef PII_LBP_SSE2
+namespace Sse2
+{
+  struct Ops
+  {
+    enum { Width = 16 };
+    static inline __m128i load(const uchar* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+    // There is no unsigned byte comparison. Flipping the sign bits
+    // maps unsigned order to signed order.
+    static inline __m128i greater(__m128i a, __m128i b)
+    {
+      const __m128i sign = _mm_set1_epi8(char(0x80));
+      return _mm_cmpgt_epi8(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+    }
+    static inline __m128i bit(__m128i mask, int index) { return _mm_and_si128(mask, _mm_set1_epi8(char(1 << index))); }
+    static inline __m128i bitOr(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+    static inline void store(uchar* data, __m128i value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value); }
+  };
+  typedef __m128i Vec;
+
+  PII_LBP_LOOPS(static)
+}
+#endif
+
+#ifdef PII_LBP_AVX2
+namespace Avx2
+{
+#  define PII_AVX2 PII_TARGET("avx2")
+
+  struct Ops
+  {
+    enum { Width = 32 };
+    PII_AVX2 static inline __m256i load(const uchar* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+    PII_AVX2 static inline __m256i greater(__m256i a, __m256i b)
+    {
+      const __m256i sign = _mm256_set1_epi8(char(0x80));
+      return _mm256_cmpgt_epi8(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+    }
+    PII_AVX2 static inline __m256i bit(__m256i mask, int index) { return _mm256_and_si256(mask, _mm256_set1_epi8(char(1 << index))); }
+    PII_AVX2 static inline __m256i bitOr(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+    PII_AVX2 static inline void store(uchar* data, __m256i value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value); }
+  };
+  typedef __m256i Vec;
+
+  PII_LBP_LOOPS(PII_AVX2 static)
+
+#  undef PII_AVX2
+}
+#endif
+
+#ifdef PII_LBP_NEON
+namespace Neon
+{
+  struct Ops
+  {
+    enum { Width = 16 };
+    static inline uint8x16_t load(const uchar* data) { return vld1q_u8(data); }
+    static inline uint8x16_t greater(uint8x16_t a, uint8x16_t b) { return vcgtq_u8(a, b); }
+    static inline uint8x16_t bit(uint8x16_t mask, int index) { return vandq_u8(mask, vdupq_n_u8(uchar(1 << index))); }
+    static inline uint8x16_t bitOr(uint8x16_t a, uint8x16_t b) { return vorrq_u8(a, b); }
+    static inline void store(uchar* data, uint8x16_t value) { vst1q_u8(data, value); }
+  };
+  typedef uint8x16_t Vec;
+
+  PII_LBP_LOOPS(static)
+}
+#endif
+
+#undef PII_LBP_LOOPS
+
+/* There is no generic implementation. A null function makes PiiLbp
+   use its own scalar code.
+ */
+#if defined(PII_LBP_AVX2)
+#  define PII_LBP_DISPATCHER(FUNCTION)                                  \
+  PiiCpuDispatcher<LbpFunction>()                                       \
+  .add(Pii::CpuAvx2, Avx2::FUNCTION)                                    \
+  .add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_LBP_SSE2)
+#  define PII_LBP_DISPATCHER(FUNCTION)                                  \
+  PiiCpuDispatcher<LbpFunction>().add(Pii::CpuSse2, Sse2::FUNCTION)
+#elif defined(PII_LBP_NEON)
+#  define PII_LBP_DISPATCHER(FUNCTION)                                  \
+  PiiCpuDispatcher<LbpFunction>().add(Pii::CpuNeon, Neon::FUNCTION)
+#else
+#  define PII_LBP_DISPATCHER(FUNCTION) PiiCpuDispatcher<LbpFunction>()
+#endif
+
+static const PiiCpuDispatcher<LbpFunction> basicLbpDispatcher = PII_LBP_DISPATCHER(basicLbp);
+static const PiiCpuDispatcher<LbpFunction> basicSymmetricLbpDispatcher = PII_LBP_DISPATCHER(basicSymmetricLbp);
+
+#undef PII_LBP_DISPATCHER
+
+bool PiiLbpKernel<uchar>::basicLbp(const uchar* row0, const uchar* row1, const uchar* row2,
+                                   int count, uchar* codes)
+{
+  LbpFunction pFunction = basicLbpDispatcher.function();
+  if (pFunction == 0)
+    return false;
+  pFunction(row0, row1, row2, count, codes);
+  return true;
+}
+
+bool PiiLbpKernel<uchar>::basicSymmetricLbp(const uchar* row0, const uchar* row1, const uchar* row2,
+                                            int count, uchar* codes)
+{
+  LbpFunction pFunction = basicSymmetricLbpDispatcher.function();
+  if (pFunction == 0)
+    return false;
+  pFunction(row0, row1, row2, count, codes);
+  return true;
+}
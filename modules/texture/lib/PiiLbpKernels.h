@@ -0,0 +1,52 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILBPKERNELS_H
+#define _PIILBPKERNELS_H
+
+#include "PiiTextureGlobal.h"
+
+/**
+ * Vectorized implementations of the 8-neighbor LBP operators. The
+ * kernels calculate the codes of a whole image row at once, 16
+ * (SSE2, NEON) or 32 (AVX2) pixels per instruction. The three row
+ * pointers point to the beginnings of the rows above, at and below
+ * the center pixels. *codes* receives the codes of the center pixels
+ * at columns 1, ..., `count`.
+ *
+ * The generic template says "not supported", and PiiLbp falls back
+ * to scalar code. A specialization exists for `unsigned char`. The
+ * codes are identical to those of PiiLbp::basicLbp() and
+ * PiiLbp::basicSymmetricLbp() with Pii::Identity as the center
+ * function. Each function returns `false` if the CPU lacks the
+ * required instructions. In this case *codes* is not modified.
+ *
+ * @internal
+ */
+template <class T> struct PiiLbpKernel
+{
+  static bool basicLbp(const T*, const T*, const T*, int, unsigned char*) { return false; }
+  static bool basicSymmetricLbp(const T*, const T*, const T*, int, unsigned char*) { return false; }
+};
+
+template <> struct PII_TEXTURE_EXPORT PiiLbpKernel<unsigned char>
+{
+  static bool basicLbp(const unsigned char* row0, const unsigned char* row1, const unsigned char* row2,
+                       int count, unsigned char* codes);
+  static bool basicSymmetricLbp(const unsigned char* row0, const unsigned char* row1, const unsigned char* row2,
+                                int count, unsigned char* codes);
+};
+
+#endif //_PIILBPKERNELS_H
@@ -17,6 +17,7 @@
 #include "PiiContrastOperation.h"
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
+#include <PiiIntegralImage.h>
 
 PiiContrastOperation::Data::Data() :
   type(MaxDiff),
@@ -91,13 +92,25 @@ template <class T> void PiiContrastOperation::contrast(const PiiVariant& obj)
       break;
     case LocalVar:
       {
+        // Local sums of pixels and their squares from integral
+        // images: var = sum(x^2)/N - (sum(x)/N)^2
+        typedef typename Pii::IfClass<Pii::IsInteger<T>, long long, double>::Type SumType;
+        PiiIntegralImage<SumType> sum(image), sum2(image, Pii::Square<SumType>());
+        const double dCount = windowSize * windowSize;
         PiiMatrix<float> matResult(PiiMatrix<float>::uninitialized(image.rows()-doubleMargin,
                                                                    image.columns()-doubleMargin));
         for (int r=matResult.rows(); r--; )
           {
             float *resultRow = matResult.row(r);
+            const SumType* pTop = sum.sumRow(r), *pBottom = sum.sumRow(r + windowSize);
+            const SumType* pTop2 = sum2.sumRow(r), *pBottom2 = sum2.sumRow(r + windowSize);
             for (int c=matResult.columns(); c--; )
-              resultRow[c] = Pii::var<float,PiiMatrix<T> >(image(r,c, windowSize, windowSize));
+              {
+                double dMean = double(PiiIntegralImage<SumType>::sum(pTop, pBottom, c, c + windowSize)) / dCount;
+                double dVar = double(PiiIntegralImage<SumType>::sum(pTop2, pBottom2, c, c + windowSize)) / dCount -
+                  dMean * dMean;
+                resultRow[c] = float(qMax(dVar, 0.0));
+              }
           }
         d->pImageOutput->emitObject(matResult);
       }
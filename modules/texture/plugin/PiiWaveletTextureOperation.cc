@@ -103,13 +103,16 @@ template <class T> void PiiWaveletTextureOperation::waveletNorm(const PiiMatrix<
 {
   PII_D;
   PiiMatrix<float> result(1, d->iLevels * d->iFeaturesPerLevel + 1);
-  // Perform a N-level wavelet decomposition
+  // Perform a N-level wavelet decomposition. The approximation of
+  // the previous level is read from one buffer while the next level
+  // is written to the other.
   QList<PiiMatrix<T> > decomposition;
   decomposition << mat;
+  PiiMatrix<T> aBuffers[2];
   int index = 0;
   for (int i=d->iLevels; i--; )
     {
-      decomposition = PiiDsp::dwt(decomposition[0], d->waveletFamily, d->iWaveletIndex);
+      decomposition = PiiDsp::dwt(decomposition[0], d->waveletFamily, d->iWaveletIndex, aBuffers[i & 1]);
       switch (d->iFeaturesPerLevel)
         {
         case 1: // rotation invariant
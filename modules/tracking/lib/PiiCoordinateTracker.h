@@ -19,6 +19,9 @@
 #include "PiiMultiHypothesisTracker.h"
 #include "PiiCoordinateTrackerNode.h"
 #include <PiiMatrix.h>
+#include <PiiMath.h>
+#include <algorithm>
+#include <functional>
 
 
 /**
@@ -130,6 +133,28 @@ public:
    */
   double initialThreshold() const { return _dInitialThreshold; }
 
+  /**
+   * Enable or disable spatial gating. With gating, the measurements
+   * are put into a uniform grid whose cell size equals the square
+   * root of the larger one of [initialThreshold()] and
+   * [predictionThreshold()]. A trajectory is only compared against
+   * measurements in the cells within the threshold distance from its
+   * prediction (or last measurement, if there is no prediction yet).
+   * This reduces the cost of association from N x M to roughly N + M
+   * evaluations on crowded scenes.
+   *
+   * Gating assumes that
+   * [measureFit(TrajectoryType**,const MeasurementType&,int)]
+   * returns zero for measurements beyond the thresholds, as the
+   * default implementation does. If you override it with a different
+   * measurement model, don't enable gating. The default is `false`.
+   */
+  void setSpatialGating(bool spatialGating) { _bSpatialGating = spatialGating; }
+  /**
+   * Returns `true` if spatial gating is enabled.
+   */
+  bool spatialGating() const { return _bSpatialGating; }
+
   /**
    * Sort trajectories using the trajectory type's LessThan comparison
    * functor. If the trajectory type is PiiCoordinateTrackerNode, the
@@ -176,6 +201,12 @@ protected:
    */
   double measureFit(TrajectoryType** trajectory, const MeasurementType& measurement, int t) const;
 
+  /**
+   * Selects the measurements in the grid cells near `trajectory` if
+   * spatial gating is enabled. See [setSpatialGating()].
+   */
+  bool selectMeasurements(TrajectoryType** trajectory, QVector<int>& indices, int t);
+
   /**
    * Evaluate the likelihood that `measurement` is a starting point
    * of a new trajectory. The default implementation returns 1.0 when
@@ -232,13 +263,27 @@ protected:
   }
 
 private:
+  void buildGrid(const QList<MeasurementType>& measurements);
+
   double _dInitialThreshold;
   double _dPredictionThreshold;
+  bool _bSpatialGating;
 
+  // Gating grid for the measurements being processed. The
+  // measurements in cell c are _vecCellMeasurements[i] for i in
+  // [_vecCellStarts[c], _vecCellStarts[c+1]).
+  bool _bGridValid;
+  double _dCellSize;
+  double _adGridOrigin[D];
+  int _aiGridSize[D];
+  QVector<int> _vecCellStarts, _vecCellMeasurements;
 };
 
 template <class T, int D> PiiCoordinateTracker<T,D>::PiiCoordinateTracker() :
-  _dInitialThreshold(1), _dPredictionThreshold(1)
+  _dInitialThreshold(1), _dPredictionThreshold(1),
+  _bSpatialGating(false),
+  _bGridValid(false),
+  _dCellSize(1)
 {
 }
 
@@ -248,8 +293,143 @@ void PiiCoordinateTracker<T,D>::addMeasurements(const QList<MeasurementType>& me
   // Predict the next point for each trajectory
   predict(t);
 
+  if (_bSpatialGating)
+    buildGrid(measurements);
+
   // Run the algorithm
   ParentType::addMeasurements(measurements, t);
+
+  _bGridValid = false;
+}
+
+template <class T, int D>
+void PiiCoordinateTracker<T,D>::buildGrid(const QList<MeasurementType>& measurements)
+{
+  _bGridValid = false;
+  const int iMeasurements = measurements.size();
+  _dCellSize = Pii::sqrt(qMax(_dInitialThreshold, _dPredictionThreshold));
+  // Everything is close to everything. Nothing to gain.
+  if (iMeasurements < 2 || !(_dCellSize > 0) || _dCellSize == INFINITY)
+    return;
+
+  double adMax[D];
+  for (int d=0; d<D; ++d)
+    _adGridOrigin[d] = adMax[d] = double(measurements[0][d]);
+  for (int i=1; i<iMeasurements; ++i)
+    for (int d=0; d<D; ++d)
+      {
+        const double dValue = double(measurements[i][d]);
+        if (dValue < _adGridOrigin[d]) _adGridOrigin[d] = dValue;
+        if (dValue > adMax[d]) adMax[d] = dValue;
+      }
+
+  // Limit the number of cells to a few per measurement. Sparse
+  // scenes get larger cells.
+  const double dMaxCells = qMax(16, 4 * iMeasurements);
+  for (;;)
+    {
+      double dCells = 1;
+      for (int d=0; d<D; ++d)
+        {
+          const double dSize = Pii::floor((adMax[d] - _adGridOrigin[d]) / _dCellSize) + 1;
+          _aiGridSize[d] = dSize < dMaxCells ? int(dSize) : int(dMaxCells);
+          dCells *= dSize;
+        }
+      if (dCells <= dMaxCells)
+        break;
+      _dCellSize *= 2;
+    }
+
+  int iCells = 1;
+  for (int d=0; d<D; ++d)
+    iCells *= _aiGridSize[d];
+
+  // Counting sort of measurement indices by cell
+  QVector<int> vecCells(iMeasurements);
+  _vecCellStarts.fill(0, iCells + 1);
+  for (int i=0; i<iMeasurements; ++i)
+    {
+      int iCell = 0;
+      for (int d=D; d--; )
+        iCell = iCell * _aiGridSize[d] +
+          qMin(_aiGridSize[d]-1, int((double(measurements[i][d]) - _adGridOrigin[d]) / _dCellSize));
+      vecCells[i] = iCell;
+      ++_vecCellStarts[iCell+1];
+    }
+  for (int c=0; c<iCells; ++c)
+    _vecCellStarts[c+1] += _vecCellStarts[c];
+  _vecCellMeasurements.resize(iMeasurements);
+  QVector<int> vecFill(_vecCellStarts);
+  for (int i=0; i<iMeasurements; ++i)
+    _vecCellMeasurements[vecFill[vecCells[i]]++] = i;
+
+  _bGridValid = true;
+}
+
+template <class T, int D>
+bool PiiCoordinateTracker<T,D>::selectMeasurements(TrajectoryType** trajectory, QVector<int>& indices, int t)
+{
+  Q_UNUSED(t);
+  if (!_bGridValid)
+    return false;
+
+  const MeasurementType* pPosition = (*trajectory)->prediction();
+  double dRadius;
+  if (pPosition)
+    dRadius = Pii::sqrt(_dPredictionThreshold);
+  else
+    {
+      pPosition = &(*trajectory)->measurement();
+      dRadius = Pii::sqrt(_dInitialThreshold);
+    }
+
+  // Leave room for rounding errors. It is harmless to include a cell
+  // too many.
+  dRadius *= 1.000001;
+
+  // The range of cells that overlaps the gate
+  int aiFirst[D], aiLast[D];
+  for (int d=0; d<D; ++d)
+    {
+      const double dPosition = double((*pPosition)[d]) - _adGridOrigin[d];
+      const double dFirst = Pii::floor((dPosition - dRadius) / _dCellSize);
+      const double dLast = Pii::floor((dPosition + dRadius) / _dCellSize);
+      // Gate is completely outside of the grid
+      if (dLast < 0 || dFirst >= _aiGridSize[d])
+        return true;
+      aiFirst[d] = dFirst < 0 ? 0 : int(dFirst);
+      aiLast[d] = dLast >= _aiGridSize[d] ? _aiGridSize[d]-1 : int(dLast);
+    }
+
+  // Visit all cells in the D-dimensional range.
+  int aiCell[D];
+  for (int d=0; d<D; ++d)
+    aiCell[d] = aiFirst[d];
+  for (;;)
+    {
+      int iCell = 0;
+      for (int d=D; d--; )
+        iCell = iCell * _aiGridSize[d] + aiCell[d];
+      for (int i=_vecCellStarts[iCell]; i<_vecCellStarts[iCell+1]; ++i)
+        indices.append(_vecCellMeasurements[i]);
+
+      int d = 0;
+      for (; d<D; ++d)
+        {
+          if (aiCell[d] < aiLast[d])
+            {
+              ++aiCell[d];
+              break;
+            }
+          aiCell[d] = aiFirst[d];
+        }
+      if (d == D)
+        break;
+    }
+
+  // Evaluate in the same order as without gating.
+  std::sort(indices.begin(), indices.end(), std::greater<int>());
+  return true;
 }
 
 template <class T, int D>
@@ -82,9 +82,14 @@ public:
   MeasurementType* prediction() const { return _pPrediction; }
   /**
    * Set the prediction. The node takes the ownership of
-   * `prediction`.
+   * `prediction`. The old prediction will be deleted.
    */
-  void setPrediction(MeasurementType* prediction) { _pPrediction = prediction; }
+  void setPrediction(MeasurementType* prediction)
+  {
+    if (prediction != _pPrediction)
+      delete _pPrediction;
+    _pPrediction = prediction;
+  }
 
   /**
    * Set the fitness of the measurement stored in this trajectory
@@ -123,7 +123,14 @@ public:
 
 protected:
   MeasurementType* predict(TrajectoryType* trajectory, int t);
-  double measureFit(TrajectoryType** trajectory, const MeasurementType& measurement, int t) const;
+  /**
+   * Records the maximum fitness of the current measurement and
+   * trajectory and extends the trajectory. All fitting measurements
+   * pass through this function in the calling thread, also when
+   * measurements are evaluated in parallel.
+   */
+  TrajectoryType* createTrajectory(TrajectoryType** trajectory, const MeasurementType& measurement, double fitness, int t);
+  using ParentType::measureFit;
   double measureFit(const MeasurementType& measurement, int t) const;
 
   /**
@@ -215,21 +222,20 @@ PiiExtendedCoordinateTracker<T,D>::predict(TrajectoryType* trajectory, int t)
   return ::PiiTracking::predictConstantVelocity(trajectory, t, _iMaximumPredictionLength);
 }
 
-template <class T, int D>
-double PiiExtendedCoordinateTracker<T,D>::measureFit(TrajectoryType** trajectory,
-                                                     const MeasurementType& measurement,
-                                                     int t) const
+template <class T, int D> typename PiiExtendedCoordinateTracker<T,D>::TrajectoryType*
+PiiExtendedCoordinateTracker<T,D>::createTrajectory(TrajectoryType** trajectory,
+                                                    const MeasurementType& measurement,
+                                                    double fitness, int t)
 {
-  double score = ParentType::measureFit(trajectory, measurement, t);
   if (trajectory)
     {
       // Store the maximum fitness for the current measurement
-      _pMaximumMeasurementFitness[this->currentMeasurementIndex()] = qMax(score, _pMaximumMeasurementFitness[this->currentMeasurementIndex()]);
+      _pMaximumMeasurementFitness[this->currentMeasurementIndex()] = qMax(fitness, _pMaximumMeasurementFitness[this->currentMeasurementIndex()]);
 
       // Store the maximum fitness for the current trajectory
-      _pMaximumTrajectoryFitness[this->currentTrajectoryIndex()] = qMax(score, _pMaximumTrajectoryFitness[this->currentTrajectoryIndex()]);
+      _pMaximumTrajectoryFitness[this->currentTrajectoryIndex()] = qMax(fitness, _pMaximumTrajectoryFitness[this->currentTrajectoryIndex()]);
     }
-  return score;
+  return ParentType::createTrajectory(trajectory, measurement, fitness, t);
 }
 
 template <class T, int D>
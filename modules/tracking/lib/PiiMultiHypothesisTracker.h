@@ -17,6 +17,11 @@
 #define _PIIMULTIHYPOTHESISTRACKER_H
 
 #include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <PiiParallel.h>
+#include <algorithm>
 
 /**
  * The tracking algorithm uses a greedy breadth-first search algorithm
@@ -29,7 +34,8 @@
  *
  * - Evaluate how well each of the N measurements fits into the
  * current set of M candidate trajectories (N x M evaluations).
- * ([measureFit()])
+ * ([measureFit()]) Subclasses can restrict the evaluations to
+ * measurements that may fit in principle. ([selectMeasurements()])
  *
  * - Generate a new set of candidate trajectories by extending the
  * old ones with the measurements with non-zero probabilities. This
@@ -49,6 +55,14 @@
  * of points). Measurements and trajectories can even be implemented
  * as indices to external storage.
  *
+ * The evaluation step can be run in parallel (see
+ * [setParallelPolicy()]). The old trajectories are then divided into
+ * strips, and each thread collects the fitting measurements of its
+ * strip into a pool of its own. The new trajectories are created
+ * from the pools in the calling thread, in the same order as in
+ * sequential mode. The result is thus independent of the number of
+ * threads.
+ *
  */
 template <class Measurement, class Trajectory> class PiiMultiHypothesisTracker : public QList<Trajectory>
 {
@@ -66,7 +80,43 @@ public:
    */
   virtual void addMeasurements(const QList<MeasurementType>& measurements, int t);
 
+  /**
+   * Set the execution policy for evaluating measurements against
+   * trajectories. The old trajectories are divided into strips of at
+   * least `policy.minStripRows()` trajectories. In parallel mode,
+   * [measureFit()] and [selectMeasurements()] are called
+   * concurrently from many threads and must not modify the tracker.
+   * [currentTrajectoryIndex()] and [currentMeasurementIndex()] are
+   * not valid in these functions, but they are always valid in
+   * [createTrajectory()]. The default is
+   * PiiParallelPolicy::sequential().
+   */
+  void setParallelPolicy(const PiiParallelPolicy& policy) { _policy = policy; }
+  /**
+   * Get the current execution policy.
+   */
+  PiiParallelPolicy parallelPolicy() const { return _policy; }
+
+  /**
+   * Set the maximum number of branches created from a trajectory at
+   * once. If more measurements fit into a trajectory, only the ones
+   * with the highest scores will be used to extend it. Zero means no
+   * limit, which is the default.
+   */
+  void setMaxBranches(int maxBranches) { _iMaxBranches = qMax(0, maxBranches); }
+  /**
+   * Get the maximum number of branches per trajectory.
+   */
+  int maxBranches() const { return _iMaxBranches; }
+
 protected:
+  PiiMultiHypothesisTracker() :
+    _iMeasurementIndex(0),
+    _iTrajectoryIndex(0),
+    _policy(PiiParallelPolicy::sequential()),
+    _iMaxBranches(0)
+  {}
+
   virtual ~PiiMultiHypothesisTracker() {}
 
   /**
@@ -103,6 +153,34 @@ protected:
    */
   virtual double measureFit(TrajectoryType* trajectory, const MeasurementType& measurement, int t) const = 0;
 
+  /**
+   * Select the measurements that may fit into `trajectory`. This
+   * function makes it possible to avoid N x M evaluations by gating:
+   * the tracker only calls [measureFit()] for the selected
+   * measurements. The others are assumed to have a zero fitness.
+   * The default implementation returns `false`, which makes the
+   * tracker evaluate all measurements.
+   *
+   * @param trajectory the trajectory candidate measurements are
+   * selected for
+   *
+   * @param indices store the indices of the selected measurements
+   * here, in descending order. The vector is empty when the function
+   * is called.
+   *
+   * @param t the current time instant
+   *
+   * @return `true` if the measurements were selected, `false` if all
+   * measurements must be evaluated
+   */
+  virtual bool selectMeasurements(TrajectoryType* trajectory, QVector<int>& indices, int t)
+  {
+    Q_UNUSED(trajectory);
+    Q_UNUSED(indices);
+    Q_UNUSED(t);
+    return false;
+  }
+
   /**
    * Get the current index of the trajectory.
    */
@@ -132,26 +210,151 @@ private:
    * The index refers to trajectories.
    */
   int _iTrajectoryIndex;
+
+  PiiParallelPolicy _policy;
+  int _iMaxBranches;
+
+  struct Hypothesis
+  {
+    Hypothesis(int measurement = 0, double score = 0) : iMeasurement(measurement), dScore(score) {}
+    bool operator< (const Hypothesis& other) const { return dScore > other.dScore; }
+    int iMeasurement;
+    double dScore;
+  };
+  typedef QVector<Hypothesis> HypothesisPool;
+  class Expansion;
+  friend class Expansion;
+};
+
+/// @internal
+template <class Measurement, class Trajectory>
+class PiiMultiHypothesisTracker<Measurement,Trajectory>::Expansion
+{
+public:
+  Expansion(PiiMultiHypothesisTracker* tracker,
+            const QList<MeasurementType>& measurements,
+            int t,
+            const QVector<TrajectoryType*>& trajectories,
+            bool parallel) :
+    _pTracker(tracker), _measurements(measurements), _iTime(t),
+    _vecTrajectories(trajectories), _bParallel(parallel),
+    _vecPools(trajectories.size()),
+    _vecBegins(trajectories.size()),
+    _vecEnds(trajectories.size())
+  {}
+
+  ~Expansion() { qDeleteAll(_lstPools); }
+
+  // Collects the fitting measurements of trajectories [firstRow, endRow).
+  void operator() (int firstRow, int endRow)
+  {
+    HypothesisPool* pPool = new HypothesisPool;
+    {
+      QMutexLocker lock(&_poolMutex);
+      _lstPools.append(pPool);
+    }
+    QVector<int> vecCandidates;
+    for (int i=endRow; i-- > firstRow; )
+      {
+        TrajectoryType* pTrajectory = _vecTrajectories[i];
+        const int iBegin = pPool->size();
+        vecCandidates.resize(0);
+        if (_pTracker->selectMeasurements(pTrajectory, vecCandidates, _iTime))
+          {
+            for (int c=0; c<vecCandidates.size(); ++c)
+              evaluate(pPool, i, pTrajectory, vecCandidates[c]);
+          }
+        else
+          {
+            for (int m=_measurements.size(); m--; )
+              evaluate(pPool, i, pTrajectory, m);
+          }
+        // Retain the best ones in the original order.
+        const int iMaxBranches = _pTracker->_iMaxBranches;
+        if (iMaxBranches > 0 && pPool->size() - iBegin > iMaxBranches)
+          {
+            Hypothesis* pFirst = pPool->data() + iBegin;
+            Hypothesis* pLast = pPool->data() + pPool->size();
+            std::stable_sort(pFirst, pLast);
+            std::sort(pFirst, pFirst + iMaxBranches, DescendingMeasurement());
+            pPool->resize(iBegin + iMaxBranches);
+          }
+        _vecPools[i] = pPool;
+        _vecBegins[i] = iBegin;
+        _vecEnds[i] = pPool->size();
+      }
+  }
+
+  // Creates the new trajectories in the calling thread.
+  void extend()
+  {
+    for (int i=_vecTrajectories.size(); i--; )
+      {
+        _pTracker->_iTrajectoryIndex = i;
+        const Hypothesis* pHypotheses = _vecPools[i]->constData();
+        for (int h=_vecBegins[i]; h<_vecEnds[i]; ++h)
+          {
+            _pTracker->_iMeasurementIndex = pHypotheses[h].iMeasurement;
+            _pTracker->append(_pTracker->createTrajectory(_vecTrajectories[i],
+                                                          _measurements[pHypotheses[h].iMeasurement],
+                                                          pHypotheses[h].dScore,
+                                                          _iTime));
+          }
+      }
+  }
+
+private:
+  struct DescendingMeasurement
+  {
+    bool operator() (const Hypothesis& a, const Hypothesis& b) const { return a.iMeasurement > b.iMeasurement; }
+  };
+
+  void evaluate(HypothesisPool* pool, int trajectoryIndex, TrajectoryType* trajectory, int measurementIndex)
+  {
+    // Sequential mode retains the indices for subclasses.
+    if (!_bParallel)
+      {
+        _pTracker->_iTrajectoryIndex = trajectoryIndex;
+        _pTracker->_iMeasurementIndex = measurementIndex;
+      }
+    // See how well this measurement would fit into the current
+    // trajectory. If it fits even in principle, it is a candidate
+    // for a new trajectory.
+    double dScore = _pTracker->measureFit(trajectory, _measurements[measurementIndex], _iTime);
+    if (dScore > 0)
+      pool->append(Hypothesis(measurementIndex, dScore));
+  }
+
+  PiiMultiHypothesisTracker* _pTracker;
+  const QList<MeasurementType>& _measurements;
+  int _iTime;
+  const QVector<TrajectoryType*>& _vecTrajectories;
+  bool _bParallel;
+  QMutex _poolMutex;
+  QList<HypothesisPool*> _lstPools;
+  QVector<HypothesisPool*> _vecPools;
+  QVector<int> _vecBegins, _vecEnds;
 };
 
 
 template <class Measurement, class Trajectory>
 void PiiMultiHypothesisTracker<Measurement,Trajectory>::addMeasurements(const QList<MeasurementType>& measurements, int t)
 {
-  QList<TrajectoryType> oldTrajectories = *this;
-  this->clear();
+  QList<TrajectoryType> oldTrajectories;
+  qSwap(oldTrajectories, static_cast<QList<TrajectoryType>&>(*this));
 
-  for (_iTrajectoryIndex=oldTrajectories.size(); _iTrajectoryIndex--; )
+  const int iTrajectories = oldTrajectories.size();
+  if (iTrajectories > 0 && measurements.size() > 0)
     {
-      for (_iMeasurementIndex=measurements.size(); _iMeasurementIndex--; )
-        {
-          // See how well this measurement would fit into the current
-          // trajectory.
-          double score = measureFit(&oldTrajectories[_iTrajectoryIndex], measurements[_iMeasurementIndex], t);
-          // If it fits even in principle, create a new trajectory
-          if (score > 0)
-            this->append(createTrajectory(&oldTrajectories[_iTrajectoryIndex], measurements[_iMeasurementIndex], score, t));
-        }
+      // Take the addresses once. Workers must not touch the list.
+      QVector<TrajectoryType*> vecTrajectories(iTrajectories);
+      for (int i=0; i<iTrajectories; ++i)
+        vecTrajectories[i] = &oldTrajectories[i];
+
+      const bool bParallel = _policy.stripCount(iTrajectories) > 1;
+      Expansion expansion(this, measurements, t, vecTrajectories, bParallel);
+      Pii::forEachStrip(iTrajectories, expansion, _policy);
+      expansion.extend();
     }
 
   for (_iMeasurementIndex=measurements.size(); _iMeasurementIndex--; )
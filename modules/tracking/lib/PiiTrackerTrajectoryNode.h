@@ -16,6 +16,8 @@
 #ifndef _PIITRACKERTRAJECTORYNODE_H
 #define _PIITRACKERTRAJECTORYNODE_H
 
+#include <PiiSmallObjectAllocator.h>
+
 /**
  * A utility class that can be used as the `Trajectory` type with
  * PiiMultiHypothesisTracker. With this structure, trajectories are
@@ -30,6 +32,9 @@
  * };
  * ~~~
  *
+ * Trackers create and destroy nodes at a high rate, often thousands
+ * per frame. Nodes are therefore allocated from
+ * PiiSmallObjectAllocator. Derived classes inherit the allocator.
  */
 template <class Measurement, class Node> class PiiTrackerTrajectoryNode
 {
@@ -37,6 +42,8 @@ public:
   typedef Measurement MeasurementType;
   typedef Node NodeType;
 
+  PII_SMALL_OBJECT_ALLOCATOR
+
   /**
    * Get the number of branches originating from (that is, references
    * to) this node. If this is the head of a list, the value will be
@@ -32,7 +32,8 @@ PiiMultiPointTracker::Data::Data(PiiMultiPointTracker *parent) :
   matMeasurementCounts(1,10),
   bCumulativeStatistics(false),
   iEmissionInterval(570),
-  bAllowMerging(false)
+  bAllowMerging(false),
+  iTrackingThreadCount(1)
 {
 }
 
@@ -586,6 +587,13 @@ void PiiMultiPointTracker::setEmissionInterval(int emissionInterval) { _d()->iEm
 int PiiMultiPointTracker::emissionInterval() const { return _d()->iEmissionInterval; }
 void PiiMultiPointTracker::setAllowMerging(bool allowMerging) { _d()->bAllowMerging = allowMerging; }
 bool PiiMultiPointTracker::allowMerging() const { return _d()->bAllowMerging; }
+void PiiMultiPointTracker::setTrackingThreadCount(int trackingThreadCount)
+{
+  PII_D;
+  d->iTrackingThreadCount = qMax(0, trackingThreadCount);
+  d->tracker.setParallelPolicy(PiiParallelPolicy(d->iTrackingThreadCount));
+}
+int PiiMultiPointTracker::trackingThreadCount() const { return _d()->iTrackingThreadCount; }
 
 
 void PiiMultiPointTracker::setInitialThreshold(int initialThreshold)
@@ -631,6 +639,9 @@ int PiiMultiPointTracker::maximumPredictionLength() const
 PiiMultiPointTracker::Tracker::Tracker(PiiMultiPointTracker *parent)
   : _pParent(parent)
 {
+  // The default measurement model is used. Crowded scenes would
+  // otherwise compare every point to every trajectory.
+  setSpatialGating(true);
 }
 
 PiiMultiPointTracker::Tracker::~Tracker()
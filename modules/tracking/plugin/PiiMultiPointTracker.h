@@ -128,6 +128,15 @@ class PiiMultiPointTracker : public PiiDefaultOperation
    */
   Q_PROPERTY(bool allowMerging READ allowMerging WRITE setAllowMerging);
 
+  /**
+   * The number of threads used for matching the points of one frame
+   * to trajectories. The trajectories are divided among the threads
+   * (see PiiParallelPolicy). The result does not depend on the number
+   * of threads. Zero means QThread::idealThreadCount(). The default
+   * is one, which processes each frame in the processing thread only.
+   */
+  Q_PROPERTY(int trackingThreadCount READ trackingThreadCount WRITE setTrackingThreadCount);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiMultiPointTracker();
@@ -174,6 +183,9 @@ public:
   void setAllowMerging(bool allowMerging);
   bool allowMerging() const;
 
+  void setTrackingThreadCount(int trackingThreadCount);
+  int trackingThreadCount() const;
+
   struct AreaStatistics
   {
     PiiMatrix<int> dwellHistogram;
@@ -260,6 +272,7 @@ private:
     QHash<int, AreaStatistics> hashAreas;
     QHash<int, LineStatistics> hashLines;
     bool bAllowMerging;
+    int iTrackingThreadCount;
   };
   PII_D_FUNC;
 };
@@ -18,9 +18,128 @@
 #endif
 
 #include <PiiMath.h>
+#include <PiiInvalidArgumentException.h>
+#include <QCoreApplication>
+#include <QVector>
+#include <cmath>
+
+/// @internal
+template <class T> struct PiiHoughTransform::Vote
+{
+  double dX, dY;
+  T value;
+  // The accumulator column of the gradient direction. Only used with
+  // gradient-restricted voting.
+  double dCenter;
+};
+
+/**
+ * @internal
+ *
+ * Adds the votes of a list of pixels to a range of columns in the
+ * accumulator. The function object is shared by all threads, and
+ * each thread handles a disjoint set of columns.
+ */
+template <class T> class PiiHoughTransform::Voter
+{
+public:
+  Voter(const QVector<Vote<T> >& votes,
+        PiiMatrix<T>& result,
+        const double* cosTable,
+        const double* sinTable,
+        double distanceResolution,
+        int startDistance,
+        double halfWindow,
+        double period) :
+    _votes(votes),
+    _vecRows(result.rows()),
+    _pCosTable(cosTable),
+    _pSinTable(sinTable),
+    _dDistanceResolution(distanceResolution),
+    _iStartDistance(startDistance),
+    _iEndDistance(startDistance + result.rows() - 1),
+    _dHalfWindow(halfWindow),
+    _dPeriod(period)
+  {
+    // Take the row pointers in advance to avoid concurrent detach
+    // checks.
+    for (int r=0; r<result.rows(); ++r)
+      _vecRows[r] = result.row(r);
+  }
+
+  void operator() (int firstAngle, int endAngle)
+  {
+    const Vote<T>* pVotes = _votes.constData();
+    const int iVotes = _votes.size();
+    for (int i=0; i<iVotes; ++i)
+      {
+        if (_dHalfWindow < 0)
+          vote(pVotes[i], firstAngle, endAngle);
+        else
+          {
+            // The gradient direction and its opposite are equal. Go
+            // through all repetitions of the window that hit the
+            // accumulator.
+            for (double dCenter = pVotes[i].dCenter; dCenter - _dHalfWindow < endAngle; dCenter += _dPeriod)
+              vote(pVotes[i],
+                   qMax(firstAngle, int(std::ceil(dCenter - _dHalfWindow))),
+                   qMin(endAngle, int(std::floor(dCenter + _dHalfWindow)) + 1));
+          }
+      }
+  }
+
+private:
+  inline void vote(const Vote<T>& v, int firstAngle, int endAngle)
+  {
+    T** ppRows = _vecRows.data() - _iStartDistance;
+    for (int omega=firstAngle; omega<endAngle; ++omega)
+      {
+        // Calculate distance to origin
+        int d = Pii::round<int>((v.dX*_pCosTable[omega] +
+                                 v.dY*_pSinTable[omega])/_dDistanceResolution);
+        if (d >= _iStartDistance && d <= _iEndDistance)
+          ppRows[d][omega] += v.value;
+      }
+  }
+
+  const QVector<Vote<T> >& _votes;
+  QVector<T*> _vecRows;
+  const double* _pCosTable;
+  const double* _pSinTable;
+  double _dDistanceResolution;
+  int _iStartDistance, _iEndDistance;
+  double _dHalfWindow, _dPeriod;
+};
 
 template <class T, class Matrix, class UnaryOp>
 PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule)
+{
+  return accumulate<T>(img, rule, 0, 90, PiiParallelPolicy::sequential());
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule, const PiiParallelPolicy& policy)
+{
+  return accumulate<T>(img, rule, 0, 90, policy);
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule,
+                                          const PiiMatrix<float>& gradientDirections,
+                                          double angleWindow,
+                                          const PiiParallelPolicy& policy)
+{
+  if (gradientDirections.rows() != img.rows() || gradientDirections.columns() != img.columns())
+    PII_THROW(PiiInvalidArgumentException,
+              QCoreApplication::translate("PiiHoughTransform", "Gradient directions must be of the same size as the input image."));
+  return accumulate<T>(img, rule, &gradientDirections, angleWindow, policy);
+}
+
+template <class T, class Matrix, class UnaryOp>
+PiiMatrix<T> PiiHoughTransform::accumulate(const Matrix& img, UnaryOp rule,
+                                           const PiiMatrix<float>* gradientDirections,
+                                           double angleWindow,
+                                           const PiiParallelPolicy& policy)
 {
   const int iRows = img.rows();
   const int iCols = img.columns();
@@ -50,26 +169,36 @@ PiiMatrix<T> PiiHoughTransform::transform(const Matrix& img, UnaryOp rule)
 
   initSinCosTables(iAngles);
 
-  const double* pCosAngleValues = cosTable();
-  const double* pSinAngleValues = sinTable();
+  // A negative half window votes for all angles. The window is
+  // measured in columns of the accumulator.
+  const double dPeriod = 180.0 / dAngleResolution;
+  const double dHalfWindow = gradientDirections != 0 && angleWindow < 90 ?
+    qMax(0.0, angleWindow) / dAngleResolution : -1;
 
+  QVector<Vote<T> > vecVotes;
   for (typename Matrix::const_iterator it = img.begin(); it != img.end(); ++it)
     // Is this pixel part of target?
     if (rule(*it))
       {
         //qDebug("(%d, %d) matches", r, c);
-        double coordX = double(it.column()) - centerX;
-        double coordY = double(it.row()) - centerY;
-        for (int omega=0; omega<iAngles; ++omega)
+        Vote<T> vote;
+        vote.dX = double(it.column()) - centerX;
+        vote.dY = double(it.row()) - centerY;
+        vote.value = T(*it);
+        if (dHalfWindow >= 0)
           {
-            // Calculate distance to origin
-            int d = Pii::round<int>((coordX*pCosAngleValues[omega] +
-                                     coordY*pSinAngleValues[omega])/dDistanceResolution);
-            //qDebug("Accessing (%d, %d) of %d-by-%d", d-iStartDistance, omega, iDistances, iAngles);
-            if (d >= iStartDistance && d <= iEndDistance)
-              result(d - iStartDistance, omega) += T(*it);
+            // The column of the gradient direction, moved to the
+            // first repetition whose window ends at or after the
+            // first column.
+            double dCenter = ((*gradientDirections)(it.row(), it.column()) * (180 / M_PI) - iStartAngle) / dAngleResolution;
+            vote.dCenter = dCenter - std::floor((dCenter + dHalfWindow) / dPeriod) * dPeriod;
           }
+        vecVotes.append(vote);
       }
 
+  Voter<T> voter(vecVotes, result, cosTable(), sinTable(),
+                 dDistanceResolution, iStartDistance, dHalfWindow, dPeriod);
+  Pii::forEachStrip(iAngles, voter, policy);
+
   return result;
 }
@@ -21,6 +21,7 @@
 #include <PiiMathDefs.h>
 #include <PiiFunctional.h>
 #include <PiiSharedD.h>
+#include <PiiParallel.h>
 
 /**
  * Linear Hough transform. The linear Hough transform is used in
@@ -200,6 +201,57 @@ public:
     return transform<T>(img, Pii::Identity<typename Matrix::value_type>());
   }
 
+  /**
+   * Transforms *img* in parallel. The pixels that make *rule*
+   * evaluate `true` are first collected into a list. The columns
+   * (angles) of the accumulator are then divided into strips as
+   * determined by *policy*, and each thread votes with all collected
+   * pixels into its own strip. Since the strips are disjoint, no
+   * locking or merging is needed, and the result is exactly the
+   * same as with the sequential version.
+   *
+   * ~~~(c++)
+   * PiiMatrix<int> matAccumulator(hough.transform<int>(matEdges,
+   *                                                   Pii::Identity<uchar>(),
+   *                                                   PiiParallelPolicy()));
+   * ~~~
+   */
+  template <class T, class Matrix, class UnaryOp>
+  PiiMatrix<T> transform(const Matrix& img, UnaryOp rule, const PiiParallelPolicy& policy);
+
+  /**
+   * Transforms *img* so that each pixel only votes for lines whose
+   * direction is close to the local edge direction.
+   *
+   * The normal of a line (\(	heta\)) is parallel to the image
+   * gradient at the pixels on the line. With an accurate gradient
+   * estimate, it is therefore enough to vote for the angles within a
+   * narrow window around the gradient direction instead of all angles.
+   * This both speeds up the transform and suppresses spurious peaks
+   * formed by unrelated edges. The gradient direction and its
+   * opposite are considered equal.
+   *
+   * @param img the input image, see [transform()].
+   *
+   * @param rule the rule for selecting the pixels to be transformed.
+   *
+   * @param gradientDirections the direction of the gradient at each
+   * pixel, in radians, as returned by PiiImage::gradientDirection().
+   * Must be of the same size as *img*.
+   *
+   * @param angleWindow the maximum difference (in degrees) between
+   * the gradient direction and the angle of a line a pixel votes
+   * for. 90 or more makes every pixel vote for all angles.
+   *
+   * @param policy divides the angles among threads as described
+   * above.
+   */
+  template <class T, class Matrix, class UnaryOp>
+  PiiMatrix<T> transform(const Matrix& img, UnaryOp rule,
+                         const PiiMatrix<float>& gradientDirections,
+                         double angleWindow,
+                         const PiiParallelPolicy& policy = PiiParallelPolicy::sequential());
+
 protected:
   /// @internal
   class Data : public PiiSharedD<Data>
@@ -230,6 +282,14 @@ protected:
   PII_SHARED_D_FUNC;
 
 private:
+  template <class T> struct Vote;
+  template <class T> class Voter;
+  template <class T, class Matrix, class UnaryOp>
+  PiiMatrix<T> accumulate(const Matrix& img, UnaryOp rule,
+                          const PiiMatrix<float>* gradientDirections,
+                          double angleWindow,
+                          const PiiParallelPolicy& policy);
+
   void setSize(int rows, int columns);
   void initSinCosTables(int angles);
   const double* sinTable() const;
@@ -22,15 +22,21 @@ PiiHoughTransformOperation::Data::Data() :
   iMaxPeakCount(1),
   dMinPeakMagnitude(0),
   bPeaksConnected(false),
-  dMinPeakDistance(1)
+  dMinPeakDistance(1),
+  dAngleWindow(10),
+  iTransformThreadCount(1),
+  bDirectionConnected(false)
 {
 }
 
 PiiHoughTransformOperation::PiiHoughTransformOperation() :
   PiiDefaultOperation(new Data)
 {
+  PII_D;
   setThreadCount(1);
   addSocket(new PiiInputSocket("image"));
+  addSocket(d->pDirectionInput = new PiiInputSocket("direction"));
+  d->pDirectionInput->setOptional(true);
   addSocket(new PiiOutputSocket("accumulator"));
   addSocket(new PiiOutputSocket("peaks"));
   addSocket(new PiiOutputSocket("coordinates"));
@@ -50,6 +56,7 @@ void PiiHoughTransformOperation::check(bool reset)
     PII_THROW(PiiExecutionException, tr("Start distance must be smaller than end distance."));
 
   d->bPeaksConnected = outputAt(1)->isConnected() || outputAt(2)->isConnected();
+  d->bDirectionConnected = d->pDirectionInput->isConnected();
 }
 
 void PiiHoughTransformOperation::process()
@@ -74,7 +81,21 @@ template <class T> void PiiHoughTransformOperation::transform(const PiiVariant&
   typedef typename TransformTraits<T>::Type ResultType;
   PiiMatrix<ResultType> accumulator;
 
-  accumulator = d->hough.transform<ResultType>(image, Pii::Identity<T>());
+  const PiiParallelPolicy policy(d->iTransformThreadCount);
+
+  if (d->bDirectionConnected)
+    {
+      PiiVariant directionObj = d->pDirectionInput->firstObject();
+      if (directionObj.type() != PiiYdin::FloatMatrixType)
+        PII_THROW_UNKNOWN_TYPE(d->pDirectionInput);
+      const PiiMatrix<float> matDirections = directionObj.valueAs<PiiMatrix<float> >();
+      if (matDirections.rows() != image.rows() || matDirections.columns() != image.columns())
+        PII_THROW_WRONG_SIZE(d->pDirectionInput, matDirections, image.rows(), image.columns());
+      accumulator = d->hough.transform<ResultType>(image, Pii::Identity<T>(),
+                                                   matDirections, d->dAngleWindow, policy);
+    }
+  else
+    accumulator = d->hough.transform<ResultType>(image, Pii::Identity<T>(), policy);
 
   if (d->bPeaksConnected)
     findPeaks(accumulator);
@@ -123,3 +144,7 @@ void PiiHoughTransformOperation::setMinPeakMagnitude(double minPeakMagnitude) {
 double PiiHoughTransformOperation::minPeakMagnitude() const { return _d()->dMinPeakMagnitude; }
 void PiiHoughTransformOperation::setMinPeakDistance(double minPeakDistance) { _d()->dMinPeakDistance = qMax(1.0, minPeakDistance); }
 double PiiHoughTransformOperation::minPeakDistance() const { return _d()->dMinPeakDistance; }
+void PiiHoughTransformOperation::setAngleWindow(double angleWindow) { _d()->dAngleWindow = qMax(0.0, angleWindow); }
+double PiiHoughTransformOperation::angleWindow() const { return _d()->dAngleWindow; }
+void PiiHoughTransformOperation::setTransformThreadCount(int transformThreadCount) { _d()->iTransformThreadCount = qMax(0, transformThreadCount); }
+int PiiHoughTransformOperation::transformThreadCount() const { return _d()->iTransformThreadCount; }
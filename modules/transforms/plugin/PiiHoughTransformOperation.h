@@ -45,6 +45,13 @@
  * values in the input image will add to the transform. Higher values
  * have higher weight.
  *
+ * @in direction - an optional input that receives the local gradient
+ * direction for each pixel of `image`, in radians. A PiiMatrix<float>
+ * that must be of the same size as `image`. This input can be
+ * directly connected to the `direction` output of [PiiEdgeDetector].
+ * If this input is connected, each pixel only votes for lines whose
+ * angle is within [angleWindow] degrees of the gradient direction.
+ *
  * Outputs
  * -------
  *
@@ -109,6 +116,25 @@ class PII_TRANSFORMS_EXPORT PiiHoughTransformOperation : public PiiDefaultOperat
    */
   Q_PROPERTY(double minPeakDistance READ minPeakDistance WRITE setMinPeakDistance);
 
+  /**
+   * The maximum difference (in degrees) between the local gradient
+   * direction and the angle of a line an edge pixel votes for. Only
+   * effective if the `direction` input is connected. Smaller values
+   * make the transform faster and the peaks sharper, but require a
+   * more accurate gradient estimate. 90 or more makes every pixel
+   * vote for all angles. The default is 10.
+   */
+  Q_PROPERTY(double angleWindow READ angleWindow WRITE setAngleWindow);
+
+  /**
+   * The number of threads used for transforming one image. The angles
+   * of the accumulator are divided among the threads (see
+   * PiiParallelPolicy). Zero means QThread::idealThreadCount(). The
+   * default is one, which transforms each image in the processing
+   * thread only.
+   */
+  Q_PROPERTY(int transformThreadCount READ transformThreadCount WRITE setTransformThreadCount);
+
   Q_PROPERTY(int startAngle READ startAngle WRITE setStartAngle);
   Q_PROPERTY(int endAngle READ endAngle WRITE setEndAngle);
   Q_PROPERTY(int startDistance READ startDistance WRITE setStartDistance);
@@ -145,6 +171,10 @@ protected:
   double minPeakMagnitude() const;
   void setMinPeakDistance(double minPeakDistance);
   double minPeakDistance() const;
+  void setAngleWindow(double angleWindow);
+  double angleWindow() const;
+  void setTransformThreadCount(int transformThreadCount);
+  int transformThreadCount() const;
 
 private:
   template <class T> void transform(const PiiVariant& obj);
@@ -163,6 +193,10 @@ private:
     bool bPeaksConnected;
     PiiHoughTransform hough;
     double dMinPeakDistance;
+    double dAngleWindow;
+    int iTransformThreadCount;
+    PiiInputSocket* pDirectionInput;
+    bool bDirectionConnected;
   };
   PII_D_FUNC;
 };
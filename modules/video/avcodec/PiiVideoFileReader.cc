@@ -174,3 +174,7 @@ int PiiVideoFileReader::repeatCount() const { return _d()->iRepeatCount; }
 void PiiVideoFileReader::setRepeatCount(int cnt) { _d()->iRepeatCount = cnt; }
 void PiiVideoFileReader::setFrameStep(int frameStep) { _d()->iFrameStep = frameStep; }
 int PiiVideoFileReader::frameStep() const { return _d()->iFrameStep; }
+void PiiVideoFileReader::setDecoderThreads(int decoderThreads) { _d()->pVideoReader->setThreadCount(decoderThreads); }
+int PiiVideoFileReader::decoderThreads() const { return _d()->pVideoReader->threadCount(); }
+void PiiVideoFileReader::setFrameThreading(bool frameThreading) { _d()->pVideoReader->setFrameThreading(frameThreading); }
+bool PiiVideoFileReader::frameThreading() const { return _d()->pVideoReader->frameThreading(); }
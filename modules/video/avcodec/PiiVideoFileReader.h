@@ -53,10 +53,29 @@ class PII_VIDEO_EXPORT PiiVideoFileReader : public PiiImageReaderOperation
   Q_PROPERTY(int repeatCount READ repeatCount WRITE setRepeatCount);
 
   /**
-   * FrameStep description
+   * The number of frames to advance after each emitted frame. 1
+   * emits all frames, 2 every second frame and so on. Negative
+   * values play the video backwards. Steps that are shorter than the
+   * key frame interval of the video are made by decoding only the
+   * reference frames in between. Longer steps and backward steps
+   * seek to the preceding key frame. The default value is 1.
    */
   Q_PROPERTY(int frameStep READ frameStep WRITE setFrameStep);
 
+  /**
+   * The number of threads used for decoding. See
+   * PiiVideoReader::setThreadCount(). The default value is 1.
+   */
+  Q_PROPERTY(int decoderThreads READ decoderThreads WRITE setDecoderThreads);
+
+  /**
+   * Decode many frames in parallel instead of slices of one frame if
+   * [decoderThreads] is larger than one. See
+   * PiiVideoReader::setFrameThreading(). The default value is
+   * `true`.
+   */
+  Q_PROPERTY(bool frameThreading READ frameThreading WRITE setFrameThreading);
+
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 
@@ -74,6 +93,12 @@ public:
   void setFrameStep(int frameStep);
   int frameStep() const;
 
+  void setDecoderThreads(int decoderThreads);
+  int decoderThreads() const;
+
+  void setFrameThreading(bool frameThreading);
+  bool frameThreading() const;
+
 protected:
 
   void process();
@@ -16,10 +16,18 @@
 #include "PiiVideoFileWriter.h"
 #include <PiiYdinTypes.h>
 #include <PiiColor.h>
+#include <PiiAsyncCall.h>
+#include <PiiSynchronized.h>
+#include <QFileInfo>
 
 PiiVideoFileWriter::Data::Data() :
   strOutputDirectory("."), strFileName("output.mpg"), iIndex(0),
-  iWidth(0), iHeight(0), iFrameRate(25), pVideoWriter(0)
+  iWidth(0), iHeight(0), iFrameRate(25), pVideoWriter(0),
+  iQueueSize(0), iEncoderThreads(1),
+  pEncoderThread(0), bEncoderRunning(false),
+  dPreTriggerTime(5), dPostTriggerTime(5),
+  bRecordConnected(false),
+  iPostFramesLeft(0), iClipIndex(0)
 {}
 
 PiiVideoFileWriter::PiiVideoFileWriter() :
@@ -29,6 +37,11 @@ PiiVideoFileWriter::PiiVideoFileWriter() :
   PII_D;
   d->pImageInput = new PiiInputSocket("image");
   addSocket(d->pImageInput);
+  d->pRecordInput = new PiiInputSocket("record");
+  d->pRecordInput->setOptional(true);
+  addSocket(d->pRecordInput);
+
+  setProtectionLevel("queueSize", WriteWhenStoppedOrPaused);
 
   connect(this, SIGNAL(stateChanged(PiiOperation::State)),
           SLOT(deletePiiVideoWriter(PiiOperation::State)),
@@ -38,15 +51,147 @@ PiiVideoFileWriter::PiiVideoFileWriter() :
 PiiVideoFileWriter::~PiiVideoFileWriter()
 {
   PII_D;
+  stopEncoder();
   delete d->pVideoWriter;
 }
 
+void PiiVideoFileWriter::check(bool reset)
+{
+  PII_D;
+  PiiDefaultOperation::check(reset);
+
+  d->bRecordConnected = d->pRecordInput->isConnected();
+  if (reset)
+    {
+      d->lstPreTrigger.clear();
+      d->iPostFramesLeft = 0;
+      d->iClipIndex = 0;
+    }
+
+  if (d->iQueueSize <= 0)
+    stopEncoder();
+  else if (d->pEncoderThread == 0)
+    {
+      d->bEncoderRunning = true;
+      d->pEncoderThread = Pii::createAsyncCall(this, &PiiVideoFileWriter::encodeQueue);
+      d->pEncoderThread->start();
+    }
+}
+
+void PiiVideoFileWriter::stopEncoder()
+{
+  PII_D;
+  if (d->pEncoderThread == 0)
+    return;
+  synchronized (d->queueMutex)
+    {
+      d->bEncoderRunning = false;
+      d->queueNotEmpty.wakeAll();
+      d->queueNotFull.wakeAll();
+    }
+  // The encoder exits once the queue is empty.
+  d->pEncoderThread->wait();
+  delete d->pEncoderThread;
+  d->pEncoderThread = 0;
+}
+
 void PiiVideoFileWriter::process()
 {
   PII_D;
-  using namespace PiiYdin;
   PiiVariant obj = d->pImageInput->firstObject();
 
+  if (!d->bRecordConnected)
+    {
+      queueFrame(obj, false);
+      return;
+    }
+
+  const int iPreTriggerFrames = int(d->dPreTriggerTime * d->iFrameRate + 0.5);
+  const int iPostTriggerFrames = int(d->dPostTriggerTime * d->iFrameRate + 0.5);
+  bool bNewClip = false;
+  if (PiiYdin::primitiveAs<int>(d->pRecordInput) != 0)
+    {
+      if (d->iPostFramesLeft == 0)
+        {
+          // Start a new clip with the frames preceding the trigger.
+          bNewClip = true;
+          for (int i=0; i<d->lstPreTrigger.size(); ++i, bNewClip = false)
+            queueFrame(d->lstPreTrigger[i], bNewClip);
+          d->lstPreTrigger.clear();
+        }
+      // Counts the current frame.
+      d->iPostFramesLeft = iPostTriggerFrames + 1;
+    }
+
+  if (d->iPostFramesLeft > 0)
+    {
+      queueFrame(obj, bNewClip);
+      --d->iPostFramesLeft;
+    }
+  else if (iPreTriggerFrames > 0)
+    {
+      d->lstPreTrigger << obj;
+      if (d->lstPreTrigger.size() > iPreTriggerFrames)
+        d->lstPreTrigger.removeFirst();
+    }
+}
+
+void PiiVideoFileWriter::queueFrame(const PiiVariant& obj, bool newClip)
+{
+  PII_D;
+  if (d->pEncoderThread == 0)
+    {
+      encodeFrame(obj, newClip);
+      return;
+    }
+
+  QMutexLocker lock(&d->queueMutex);
+  while (d->lstQueue.size() >= d->iQueueSize && d->bEncoderRunning)
+    d->queueNotFull.wait(&d->queueMutex);
+  d->lstQueue << EncodeItem(obj, newClip);
+  d->queueNotEmpty.wakeOne();
+}
+
+void PiiVideoFileWriter::encodeQueue()
+{
+  PII_D;
+  QMutexLocker lock(&d->queueMutex);
+  forever
+    {
+      while (d->lstQueue.isEmpty() && d->bEncoderRunning)
+        d->queueNotEmpty.wait(&d->queueMutex);
+      if (d->lstQueue.isEmpty())
+        break;
+
+      EncodeItem item(d->lstQueue.takeFirst());
+      d->queueNotFull.wakeOne();
+      lock.unlock();
+      try
+        {
+          encodeFrame(item.varImage, item.bNewClip);
+        }
+      catch (PiiException& ex)
+        {
+          piiWarning(ex.message());
+        }
+      lock.relock();
+    }
+}
+
+void PiiVideoFileWriter::encodeFrame(const PiiVariant& obj, bool newClip)
+{
+  PII_D;
+  using namespace PiiYdin;
+
+  if (newClip)
+    {
+      // Deleting the writer finishes the previous clip.
+      delete d->pVideoWriter;
+      d->pVideoWriter = 0;
+      d->iIndex = 0;
+      ++d->iClipIndex;
+    }
+
   if (d->iIndex == 0 )
     {
       switch (obj.type())
@@ -93,12 +238,30 @@ void PiiVideoFileWriter::deletePiiVideoWriter(PiiOperation::State state)
 
   if ( state == PiiOperation::Stopped )
     {
+      // Encode everything that is still in the queue.
+      stopEncoder();
       delete d->pVideoWriter;
       d->pVideoWriter = 0;
       d->iIndex = 0;
+      d->iPostFramesLeft = 0;
+      d->lstPreTrigger.clear();
     }
 }
 
+QString PiiVideoFileWriter::clipFileName() const
+{
+  const PII_D;
+  if (!d->bRecordConnected)
+    return QString("%1/%2").arg(d->strOutputDirectory).arg(d->strFileName);
+
+  QFileInfo info(d->strFileName);
+  return QString("%1/%2-%3.%4")
+    .arg(d->strOutputDirectory)
+    .arg(info.completeBaseName())
+    .arg(d->iClipIndex, 4, 10, QChar('0'))
+    .arg(info.suffix());
+}
+
 template <class T> void PiiVideoFileWriter::initPiiVideoWriter(const PiiVariant& obj)
 {
   PII_D;
@@ -111,7 +274,7 @@ template <class T> void PiiVideoFileWriter::initPiiVideoWriter(const PiiVariant&
                                           "not been set or file name is empty."));
     }
 
-  QString filename = QString("%1/%2").arg(d->strOutputDirectory).arg(d->strFileName);
+  QString filename = clipFileName();
 
    d->iWidth = matrix.columns();
    d->iHeight = matrix.rows();
@@ -125,6 +288,7 @@ template <class T> void PiiVideoFileWriter::initPiiVideoWriter(const PiiVariant&
        d->pVideoWriter->setHeight(d->iHeight);
        d->pVideoWriter->setFrameRate(d->iFrameRate);
      }
+   d->pVideoWriter->setThreadCount(d->iEncoderThreads);
 
    try
      {
@@ -162,7 +326,7 @@ template <class T> void PiiVideoFileWriter::floatImage( const PiiVariant& obj )
   const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
   bool bSave = false;
   if ( mat.columns() == d->iWidth || mat.rows() == d->iHeight )
-    d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat * 255));
+    bSave = d->pVideoWriter->saveNextGrayFrame(PiiMatrix<unsigned char>(mat * 255));
   else
     {
       PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
@@ -179,7 +343,7 @@ template <class T> void PiiVideoFileWriter::colorImage( const PiiVariant& obj )
   const PiiMatrix<T> mat = obj.valueAs<PiiMatrix<T> >();
   bool bSave = false;
   if ( mat.columns() == d->iWidth || mat.rows() == d->iHeight )
-    d->pVideoWriter->saveNextColorFrame(PiiMatrix<PiiColor<unsigned char> >(mat));
+    bSave = d->pVideoWriter->saveNextColorFrame(PiiMatrix<PiiColor<unsigned char> >(mat));
   else
     {
       PII_THROW(PiiExecutionException, tr("Input frame might be corrupted."));
@@ -197,3 +361,11 @@ QString PiiVideoFileWriter::fileName() const { return _d()->strFileName; }
 void PiiVideoFileWriter::setFileName(const QString& fileName) { _d()->strFileName = fileName; }
 int PiiVideoFileWriter::frameRate() const { return _d()->iFrameRate; }
 void PiiVideoFileWriter::setFrameRate(int frameRate) { _d()->iFrameRate = frameRate; }
+int PiiVideoFileWriter::queueSize() const { return _d()->iQueueSize; }
+void PiiVideoFileWriter::setQueueSize(int queueSize) { _d()->iQueueSize = queueSize; }
+int PiiVideoFileWriter::encoderThreads() const { return _d()->iEncoderThreads; }
+void PiiVideoFileWriter::setEncoderThreads(int encoderThreads) { _d()->iEncoderThreads = encoderThreads; }
+double PiiVideoFileWriter::preTriggerTime() const { return _d()->dPreTriggerTime; }
+void PiiVideoFileWriter::setPreTriggerTime(double preTriggerTime) { _d()->dPreTriggerTime = preTriggerTime; }
+double PiiVideoFileWriter::postTriggerTime() const { return _d()->dPostTriggerTime; }
+void PiiVideoFileWriter::setPostTriggerTime(double postTriggerTime) { _d()->dPostTriggerTime = postTriggerTime; }
@@ -18,6 +18,10 @@
 
 #include <PiiDefaultOperation.h>
 #include <PiiQImage.h>
+#include <QList>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "PiiVideoException.h"
 #include "PiiVideoGlobal.h"
@@ -33,6 +37,16 @@
  *
  * @in image - video frames, any gray-level or color image
  *
+ * @in record - an optional input that controls recording in
+ * pre-trigger mode. If this input is connected, frames are not
+ * written continuously. Instead, the last [preTriggerTime] seconds
+ * of video are kept in memory without encoding. A non-zero value in
+ * this input starts a new clip that begins with the buffered frames
+ * and continues until [postTriggerTime] seconds have passed since the
+ * last non-zero value. Each clip is written to its own file whose
+ * name is formed by adding a running number to [fileName], e.g.
+ * "output-0001.mpg".
+ *
  */
 class PII_VIDEO_EXPORT PiiVideoFileWriter : public PiiDefaultOperation
 {
@@ -54,6 +68,35 @@ class PII_VIDEO_EXPORT PiiVideoFileWriter : public PiiDefaultOperation
    */
   Q_PROPERTY(int frameRate READ frameRate WRITE setFrameRate);
 
+  /**
+   * The maximum number of frames waiting for encoding. If this value
+   * is larger than zero, frames are encoded in a separate thread, and
+   * temporary encoder slowdowns do not stall the processing pipeline.
+   * If the queue is full, the writer waits until there is space. The
+   * default value is zero, which means that each frame is encoded
+   * immediately when received.
+   */
+  Q_PROPERTY(int queueSize READ queueSize WRITE setQueueSize);
+
+  /**
+   * The number of threads used by the encoder. Only some codecs can
+   * make use of more than one thread. The default value is 1.
+   */
+  Q_PROPERTY(int encoderThreads READ encoderThreads WRITE setEncoderThreads);
+
+  /**
+   * The length of the video stored before a trigger in the `record`
+   * input, in seconds. The number of frames kept in memory is
+   * determined through [frameRate]. The default value is 5.
+   */
+  Q_PROPERTY(double preTriggerTime READ preTriggerTime WRITE setPreTriggerTime);
+
+  /**
+   * The length of the video stored after the last trigger in the
+   * `record` input, in seconds. The default value is 5.
+   */
+  Q_PROPERTY(double postTriggerTime READ postTriggerTime WRITE setPostTriggerTime);
+
 
   PII_OPERATION_SERIALIZATION_FUNCTION
 
@@ -70,6 +113,20 @@ public:
   int frameRate() const;
   void setFrameRate(int frameRate);
 
+  int queueSize() const;
+  void setQueueSize(int queueSize);
+
+  int encoderThreads() const;
+  void setEncoderThreads(int encoderThreads);
+
+  double preTriggerTime() const;
+  void setPreTriggerTime(double preTriggerTime);
+
+  double postTriggerTime() const;
+  void setPostTriggerTime(double postTriggerTime);
+
+  void check(bool reset);
+
 protected:
   void process();
 
@@ -77,6 +134,20 @@ private slots:
   void deletePiiVideoWriter(PiiOperation::State state);
 
 private:
+  struct EncodeItem
+  {
+    EncodeItem(const PiiVariant& image = PiiVariant(), bool newClip = false) :
+      varImage(image), bNewClip(newClip)
+    {}
+    PiiVariant varImage;
+    bool bNewClip;
+  };
+
+  void queueFrame(const PiiVariant& obj, bool newClip);
+  void encodeFrame(const PiiVariant& obj, bool newClip);
+  void encodeQueue();
+  void stopEncoder();
+  QString clipFileName() const;
   template <class T> void initPiiVideoWriter(const PiiVariant& obj);
   template <class T> void grayImage(const PiiVariant& obj);
   template <class T> void floatImage(const PiiVariant& obj);
@@ -92,7 +163,19 @@ private:
     int iIndex, iWidth, iHeight, iFrameRate;
 
     PiiVideoWriter *pVideoWriter;
-    PiiInputSocket* pImageInput;
+    PiiInputSocket* pImageInput, *pRecordInput;
+
+    int iQueueSize, iEncoderThreads;
+    QThread* pEncoderThread;
+    bool bEncoderRunning;
+    QList<EncodeItem> lstQueue;
+    QMutex queueMutex;
+    QWaitCondition queueNotEmpty, queueNotFull;
+
+    double dPreTriggerTime, dPostTriggerTime;
+    bool bRecordConnected;
+    QList<PiiVariant> lstPreTrigger;
+    int iPostFramesLeft, iClipIndex;
   };
   PII_D_FUNC;
 };
@@ -17,6 +17,7 @@
 #include <PiiFraction.h>
 #include "avcodec_hacks.h"
 #include <imgconvert.h>
+#include <cstring>
 
 PiiVideoReader::Data::Data(const QString& fileName) :
   pFormatCtx(0),
@@ -28,6 +29,8 @@ PiiVideoReader::Data::Data(const QString& fileName) :
   iLastFramePts(0),
   iTargetPts(0),
   bTargetChanged(false),
+  iThreadCount(1),
+  bFrameThreading(true),
   strFileName(fileName)
 {
 }
@@ -67,6 +70,26 @@ QString PiiVideoReader::fileName() const
   return d->strFileName;
 }
 
+void PiiVideoReader::setThreadCount(int threadCount)
+{
+  d->iThreadCount = threadCount;
+}
+
+int PiiVideoReader::threadCount() const
+{
+  return d->iThreadCount;
+}
+
+void PiiVideoReader::setFrameThreading(bool frameThreading)
+{
+  d->bFrameThreading = frameThreading;
+}
+
+bool PiiVideoReader::frameThreading() const
+{
+  return d->bFrameThreading;
+}
+
 void PiiVideoReader::initialize() throw(PiiVideoException&)
 {
   // Free frame.
@@ -132,6 +155,15 @@ void PiiVideoReader::initialize() throw(PiiVideoException&)
   if (pCodec->capabilities & CODEC_CAP_TRUNCATED)
     d->pCodecCtx->flags |= CODEC_FLAG_TRUNCATED;
 
+  // Threading must be configured before the codec is opened.
+  if (d->iThreadCount > 1)
+    {
+#ifdef FF_THREAD_FRAME
+      d->pCodecCtx->thread_type = d->bFrameThreading ? FF_THREAD_FRAME : FF_THREAD_SLICE;
+#endif
+      avcodec_thread_init(d->pCodecCtx, d->iThreadCount);
+    }
+
   // Open codec
   if (avcodec_open(d->pCodecCtx, pCodec) < 0)
     PII_THROW(PiiVideoException, tr("Couldn't open codec."));
@@ -187,10 +219,16 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
 
   /**
    * If the target of the next frame has changed OR frameStep != 1, we
-   * must to seek the stream.
+   * must find a new position in the stream.
    */
   if (d->bTargetChanged || frameStep != 1)
     {
+      // Within a group of pictures, skipping forward by decoding only
+      // reference frames is cheaper than seeking back to the previous
+      // key frame.
+      bool bSeek = d->bTargetChanged || frameStep < 1 ||
+        d->pCodecCtx->gop_size <= 0 || frameStep >= d->pCodecCtx->gop_size;
+
       // If the target of the next frame has not changed, we will
       // calculate a new target depends on frameStep.
       if (!d->bTargetChanged)
@@ -199,18 +237,14 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
       d->bTargetChanged = false;
       bSeeked = true;
 
-
-      // Seek the video stream to the next target
-      if (av_seek_frame(d->pFormatCtx, d->iVideoStream, d->iTargetPts, frameStep < 0 ? AVSEEK_FLAG_BACKWARD : 0) < 0)
+      // Seek the video stream to the key frame preceding the target.
+      // Frames between it and the target are skipped below.
+      if (bSeek &&
+          av_seek_frame(d->pFormatCtx, d->iVideoStream, d->iTargetPts, AVSEEK_FLAG_BACKWARD) < 0)
         return false;
-
-      d->pCodecCtx->skip_frame = AVDISCARD_BIDIR;
     }
   else
-    {
-      d->pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
-      d->iTargetPts = d->iLastFramePts + d->iFrameTime;
-    }
+    d->iTargetPts = d->iLastFramePts + d->iFrameTime;
 
   while (AV_READ_FRAME(d->pFormatCtx, &packet) >= 0)
     {
@@ -219,6 +253,13 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
         {
           int iFrameFinished = 0;
 
+          // Frames well before the target are needed only if other
+          // frames refer to them.
+          d->pCodecCtx->skip_frame =
+            bSeeked && packet.pts != int64_t(AV_NOPTS_VALUE) &&
+            packet.pts + d->iFrameTime < d->iTargetPts ?
+            AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
           // Decode video frame
           if (AVCODEC_DECODE_VIDEO(d->pCodecCtx, frame,
                                    &iFrameFinished,
@@ -246,9 +287,52 @@ bool PiiVideoReader::getFrame(AVFrame *frame, int frameStep = 1)
       av_free_packet(&packet);
     }
 
+  // At the end of the stream, codecs with delay (B frames, frame
+  // threading) still hold decoded frames. Empty packets flush them
+  // out.
+  d->pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+  int iFrameFinished = 0;
+  if (!bSeeked &&
+      AVCODEC_DECODE_VIDEO(d->pCodecCtx, frame, &iFrameFinished, 0, 0) >= 0 &&
+      iFrameFinished)
+    {
+      d->iLastFramePts += d->iFrameTime;
+      return true;
+    }
+
   return false;
 }
 
+bool PiiVideoReader::hasLuminancePlane(int format)
+{
+  switch (format)
+    {
+    case PIX_FMT_GRAY8:
+    case PIX_FMT_YUV420P:
+    case PIX_FMT_YUV422P:
+    case PIX_FMT_YUV444P:
+    case PIX_FMT_YUV410P:
+    case PIX_FMT_YUV411P:
+    case PIX_FMT_YUVJ420P:
+    case PIX_FMT_YUVJ422P:
+    case PIX_FMT_YUVJ444P:
+      return true;
+    default:
+      return false;
+    }
+}
+
+template <class T> bool PiiVideoReader::convertFrame(int format, PiiMatrix<T>& matrix)
+{
+  // Point the conversion target directly to the matrix.
+  AVPicture picture;
+  std::memset(&picture, 0, sizeof(picture));
+  picture.data[0] = reinterpret_cast<uint8_t*>(matrix.row(0));
+  picture.linesize[0] = int(matrix.stride());
+  return IMGCONVERT(&picture, format, (AVPicture*)d->pFrame,
+                    d->pCodecCtx->pix_fmt, d->pCodecCtx->width, d->pCodecCtx->height) >= 0;
+}
+
 template <> PiiMatrix<unsigned char> PiiVideoReader::getFrame(int frameStep)
 {
   bool bSuccess = getFrame(d->pFrame, frameStep);
@@ -261,16 +345,23 @@ template <> PiiMatrix<unsigned char> PiiVideoReader::getFrame(int frameStep)
          d->pFrame->linesize[0], d->pFrame->linesize[1], d->pFrame->linesize[2], d->pFrame->linesize[3],
          d->pFrame->linesize[0] - d->pCodecCtx->width);
   */
-  if (bSuccess)
+  if (!bSuccess)
+    return PiiMatrix<unsigned char>();
+
+  const int iRows = d->pCodecCtx->height, iColumns = d->pCodecCtx->width;
+  // Fresh matrices come from PiiMatrixPool and are thus recycled.
+  PiiMatrix<unsigned char> matResult(PiiMatrix<unsigned char>::uninitialized(iRows, iColumns));
+  if (hasLuminancePlane(d->pCodecCtx->pix_fmt))
     {
-      PiiMatrix<unsigned char> matResult(d->pCodecCtx->height,
-                                         d->pCodecCtx->width,
-                                         static_cast<unsigned char*>(d->pFrame->data[0]),
-                                         d->pFrame->linesize[0]);
-      return matResult;
+      // The Y plane is the gray-level image. The decoder reuses
+      // its buffers, so the data must be copied.
+      for (int r=0; r<iRows; ++r)
+        std::memcpy(matResult.row(r), d->pFrame->data[0] + r * d->pFrame->linesize[0], iColumns);
     }
+  else if (!convertFrame(PIX_FMT_GRAY8, matResult))
+    return PiiMatrix<unsigned char>();
 
-  return PiiMatrix<unsigned char>();
+  return matResult;
 }
 
 template <> PiiMatrix<PiiColor4<> > PiiVideoReader::getFrame(int frameStep)
@@ -285,44 +376,15 @@ template <> PiiMatrix<PiiColor4<> > PiiVideoReader::getFrame(int frameStep)
          d->pFrame->linesize[2], d->pFrame->linesize[3]);
   */
 
-  if (bSuccess)
-    {
-      // Allocate an AVFrame structure for conversion result
-      AVFrame *pResultFrame = avcodec_alloc_frame();
-      if (pResultFrame == 0)
-        return PiiMatrix<PiiColor4<> >();
-
-      // Malloc ensures we can safely leave the buffer to PiiMatrix.
-      void* bfr = ::malloc(avpicture_get_size(PIX_FMT_RGB32, d->pCodecCtx->width, d->pCodecCtx->height));
-
-      if (bfr == 0)
-        {
-          av_free(pResultFrame);
-          return PiiMatrix<PiiColor4<> >();
-        }
-
-      // Assign appropriate parts of buffer to image planes in pResultFrame
-      avpicture_fill((AVPicture *)pResultFrame, (uint8_t*)bfr, PIX_FMT_RGB32,
-                     d->pCodecCtx->width, d->pCodecCtx->height);
-
-      // Convert color space (this stores the result into bfr)
-      int iResult = IMGCONVERT((AVPicture *)pResultFrame, PIX_FMT_RGB32, (AVPicture*)d->pFrame,
-                               d->pCodecCtx->pix_fmt, d->pCodecCtx->width, d->pCodecCtx->height);
+  if (!bSuccess)
+    return PiiMatrix<PiiColor4<> >();
 
-      // Get rid of the conversion result frame. This does not free
-      // the data buffer itself.
-      av_free(pResultFrame);
-
-      if (iResult < 0)
-        {
-          free(bfr);
-          return PiiMatrix<PiiColor4<> >();
-        }
-
-      // Let PiiMatrix take the ownership of the buffer.
-      return PiiMatrix<PiiColor4<> >(d->pCodecCtx->height, d->pCodecCtx->width, bfr, Pii::ReleaseOwnership, 0);
-    }
-  return PiiMatrix<PiiColor4<> >();
+  // Convert color space directly into a (pooled) matrix.
+  PiiMatrix<PiiColor4<> > matResult(PiiMatrix<PiiColor4<> >::uninitialized(d->pCodecCtx->height,
+                                                                          d->pCodecCtx->width));
+  if (!convertFrame(PIX_FMT_RGB32, matResult))
+    return PiiMatrix<PiiColor4<> >();
+  return matResult;
 }
 
 void PiiVideoReader::seekToBegin()
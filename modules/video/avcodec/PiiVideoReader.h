@@ -109,6 +109,33 @@ public:
    */
   QString fileName() const;
 
+  /**
+   * Set the number of threads used for decoding. Values larger than
+   * one make avcodec decode each frame in parallel, if the codec
+   * supports it. The default value is one. This function has no
+   * effect after initialize().
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Get the number of decoding threads.
+   */
+  int threadCount() const;
+
+  /**
+   * Enable or disable frame-level threading. If frame threading is
+   * enabled and supported by avcodec, [threadCount()] successive
+   * frames will be decoded in parallel. This gives the best
+   * throughput, but delays the output by a few frames. Otherwise,
+   * each frame is split into slices that are decoded in parallel.
+   * The default is `true`. This function has no effect after
+   * initialize().
+   */
+  void setFrameThreading(bool frameThreading);
+  /**
+   * Returns `true` if frame-level threading is enabled.
+   */
+  bool frameThreading() const;
+
   /**
    * Seek at begin of the stream.
    */
@@ -127,6 +154,16 @@ private:
    * case of a reading error.
    */
   bool getFrame(AVFrame* frame, int skipFrames);
+  /**
+   * Returns `true` if the first plane of *format* contains 8-bit
+   * luminance, which can be used as a gray-level image as such.
+   */
+  static bool hasLuminancePlane(int format);
+  /**
+   * Converts the last decoded frame to *format* directly into the
+   * data buffer of *matrix*.
+   */
+  template <class T> bool convertFrame(int format, PiiMatrix<T>& matrix);
 
   static QString tr(const char* text) { return QCoreApplication::translate("PiiVideoReader", text); }
 
@@ -157,6 +194,9 @@ private:
     // getFrame()-function (for example seekToBegin() or seekToEnd())
     bool bTargetChanged;
 
+    int iThreadCount;
+    bool bFrameThreading;
+
     QString strFileName;
   } *d;
 };
@@ -18,7 +18,7 @@
 #include <PiiColor.h>
 
 PiiVideoWriter::Data::Data(const QString& fileName, int width, int height, int frameRate) :
-  strFileName(fileName), pFmt(0), pOc(0), iWidth(width), iHeight(height), iFrameRate(frameRate), pPicture(0),
+  strFileName(fileName), pFmt(0), pOc(0), iWidth(width), iHeight(height), iFrameRate(frameRate), iThreadCount(1), pPicture(0),
   pVideost(0), dVideopts(0), pVideooutbuf(0), iFramecount(0), iVideooutbufsize(0)
 {
 }
@@ -258,6 +258,10 @@ void PiiVideoWriter::open_video(AVFormatContext *oc, AVStream *st)
   if (codec == 0)
     PII_THROW(PiiVideoException, "Could not find suitable codec");
 
+  // threading must be configured before the codec is opened
+  if (d->iThreadCount > 1)
+    avcodec_thread_init(c, d->iThreadCount);
+
   // open the codec
   if (avcodec_open(c, codec) < 0)
     PII_THROW(PiiVideoException,"Could not open codec");
@@ -507,3 +511,5 @@ int PiiVideoWriter::height() const { return d->iHeight; }
 void PiiVideoWriter::setSize(int width, int height) { d->iWidth = width; d->iHeight = height; }
 void PiiVideoWriter::setFrameRate(int frameRate) { d->iFrameRate = frameRate; }
 int PiiVideoWriter::frameRate() const { return d->iFrameRate; }
+void PiiVideoWriter::setThreadCount(int threadCount) { d->iThreadCount = threadCount; }
+int PiiVideoWriter::threadCount() const { return d->iThreadCount; }
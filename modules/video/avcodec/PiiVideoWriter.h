@@ -66,6 +66,15 @@ public:
   void setFrameRate( int frameRate );
   int frameRate() const;
 
+  /**
+   * Set the number of threads used for encoding. Values larger than
+   * one make avcodec encode each frame in parallel, if the codec
+   * supports it. The default value is one. This function has no
+   * effect after initialize().
+   */
+  void setThreadCount(int threadCount);
+  int threadCount() const;
+
 
 protected:
   bool allocateMediaContext();
@@ -96,7 +105,7 @@ private:
     QString         strFileName;
     AVOutputFormat  *pFmt;
     AVFormatContext *pOc;
-    int             iWidth, iHeight, iFrameRate;
+    int             iWidth, iHeight, iFrameRate, iThreadCount;
     AVFrame         *pPicture;
     AVStream        *pVideost; //!!!!!!!!!!!!
     double          dVideopts;//!!!!!!!!!!!!
@@ -24,6 +24,7 @@
 
 #include <QMap>
 #include <QMutexLocker>
+#include <QElapsedTimer>
 
 #define PII_ALL_IMAGE_TYPES                     \
   (PiiYdin::UnsignedCharMatrixType,             \
@@ -37,13 +38,16 @@ struct PiiQmlImageProvider::Slot
   Slot() :
     pProbe(0),
     pListener(0),
-    iMethodIndex(-1)
+    iMethodIndex(-1),
+    bUpdatePending(false)
   {}
   Slot(const Slot& other) :
     varImage(other.varImage),
     pProbe(0),
     pListener(other.pListener),
-    iMethodIndex(other.iMethodIndex)
+    iMethodIndex(other.iMethodIndex),
+    bUpdatePending(other.bUpdatePending),
+    updateTimer(other.updateTimer)
   {}
 
   Slot& operator= (const Slot& other)
@@ -52,6 +56,8 @@ struct PiiQmlImageProvider::Slot
     pProbe = other.pProbe;
     pListener = other.pListener;
     iMethodIndex = other.iMethodIndex;
+    bUpdatePending = other.bUpdatePending;
+    updateTimer = other.updateTimer;
     return *this;
   }
 
@@ -59,8 +65,41 @@ struct PiiQmlImageProvider::Slot
   PiiProbeInput* pProbe;
   QObject* pListener;
   int iMethodIndex;
+  // True if the listener has been notified but hasn't requested the
+  // image yet.
+  bool bUpdatePending;
+  // Measures time since the last notification.
+  QElapsedTimer updateTimer;
 };
 
+namespace
+{
+  /* If a listener doesn't request the image after a notification
+   * (e.g. because it is hidden), it will be notified again after
+   * this many milliseconds.
+   */
+  const qint64 iMaxPendingTime = 1000;
+
+  QSize displaySize(const QSize& imageSize, const QSize& requestedSize)
+  {
+    if (imageSize.isEmpty())
+      return imageSize;
+    int iWidth = requestedSize.width(), iHeight = requestedSize.height();
+    if (iWidth <= 0 && iHeight <= 0)
+      return imageSize;
+    if (iWidth <= 0)
+      iWidth = qMax(1, qRound(double(iHeight) * imageSize.width() / imageSize.height()));
+    else if (iHeight <= 0)
+      iHeight = qMax(1, qRound(double(iWidth) * imageSize.height() / imageSize.width()));
+    return QSize(iWidth, iHeight);
+  }
+
+  int decimationStep(int imageSize, int displaySize)
+  {
+    return displaySize > 0 ? qMax(1, imageSize / displaySize) : 1;
+  }
+}
+
 class PiiQmlImageProvider::Data
 {
 public:
@@ -103,26 +142,51 @@ QImage PiiQmlImageProvider::requestImage(const QString& slot, QSize* size, const
       return QImage();
     }
   PiiVariant varImage = it->varImage;
+  // Images stored from now on must be notified to the listener.
+  it->bUpdatePending = false;
   d->slotMutex.unlock();
 
   QImage qImage;
   switch (varImage.type())
     {
-      PII_ALL_IMAGE_CASES(qImage = matrixToQImage, varImage);
+      PII_ALL_IMAGE_CASES_M(qImage = matrixToQImage, (varImage, requestedSize, size));
     default:
       qImage = varImage.convertTo<QImage>();
+      *size = qImage.size();
     }
 
-  *size = qImage.size();
-
-  if (requestedSize.isValid() && requestedSize != qImage.size())
-    return qImage.scaled(requestedSize);
+  QSize targetSize(displaySize(*size, requestedSize));
+  if (targetSize != qImage.size())
+    return qImage.scaled(targetSize);
   return qImage;
 }
 
-template <class T> QImage PiiQmlImageProvider::matrixToQImage(const PiiVariant& image)
+template <class T> QImage PiiQmlImageProvider::matrixToQImage(const PiiVariant& image,
+                                                              const QSize& requestedSize,
+                                                              QSize* size)
 {
-  return Pii::matrixToQImage(image.valueAs<PiiMatrix<T> >());
+  const PiiMatrix<T> matrix(image.valueAs<PiiMatrix<T> >());
+  *size = QSize(matrix.columns(), matrix.rows());
+
+  // Pick every nth pixel if the image is at least twice as large as
+  // requested. QImage::scaled() takes care of the remaining factor.
+  QSize targetSize(displaySize(*size, requestedSize));
+  const int iColumnStep = decimationStep(matrix.columns(), targetSize.width()),
+    iRowStep = decimationStep(matrix.rows(), targetSize.height());
+  if (iColumnStep == 1 && iRowStep == 1)
+    {
+    return Pii::matrixToSharedQImage(matrix);
+
+  const int iRows = matrix.rows() / iRowStep, iColumns = matrix.columns() / iColumnStep;
+  PiiMatrix<T> matDecimated(PiiMatrix<T>::uninitialized(iRows, iColumns));
+  for (int r=0; r<iRows; ++r)
+    {
+      const T* pSource = matrix.row(r * iRowStep);
+      T* pTarget = matDecimated.row(r);
+      for (int c=0; c<iColumns; ++c, pSource += iColumnStep)
+        pTarget[c] = *pSource;
+    }
+  return Pii::matrixToSharedQImage(matDecimated);
 }
 
 void PiiQmlImageProvider::removeSlot(const QString& slot)
@@ -147,6 +211,7 @@ bool PiiQmlImageProvider::setListener(const QString& slot, QObject* listener)
           Slot& s = d->mapSlots[slot];
           s.pListener = listener;
           s.iMethodIndex = iMethodIndex;
+          s.bUpdatePending = false;
         }
       connect(listener, SIGNAL(destroyed(QObject*)), SLOT(removeListener(QObject*)));
     }
@@ -251,10 +316,19 @@ bool PiiQmlImageProvider::storeImage(const QString& slot, const PiiVariant& imag
        * would have to be queued through the main thread's event loop
        * anyway.
        */
-      if (s.pListener)
-        s.pListener->metaObject()->method(s.iMethodIndex).invoke(s.pListener,
-                                                                 Qt::QueuedConnection,
-                                                                 Q_ARG(QVariant, slot));
+      if (s.pListener &&
+          (!s.bUpdatePending || s.updateTimer.elapsed() > iMaxPendingTime))
+        {
+          /* If the listener hasn't fetched the previous image yet,
+           * it'll get this one when it does. Don't flood the event
+           * queue.
+           */
+          s.bUpdatePending = true;
+          s.updateTimer.start();
+          s.pListener->metaObject()->method(s.iMethodIndex).invoke(s.pListener,
+                                                                   Qt::QueuedConnection,
+                                                                   Q_ARG(QVariant, slot));
+        }
       return true;
     }
   return false;
@@ -48,6 +48,17 @@ class PiiProbeInput;
  * Into.PiiImageProvider.connectOutput(engine.output("imageSource.image"), "imageSource.image");
  * Into.PiiImageProvider.setListener("imageSource.image", image);
  * ~~~
+ *
+ * Images are converted lazily in [requestImage()], and only the
+ * latest image in a slot is ever converted. A listener is not
+ * notified again until it has requested the previous update, which
+ * keeps the conversion rate at or below the refresh rate of the UI
+ * no matter how fast images are stored. 8-bit gray scale and
+ * four-channel color matrices are shared with the QImage without
+ * copying if no scaling is needed. If the requested size is smaller
+ * than the image, the matrix is decimated before conversion so that
+ * pixels that won't be shown are never touched. Set the `sourceSize`
+ * property of the Image element to take advantage of this.
  */
 class PiiQmlImageProvider :
   public QObject,
@@ -61,6 +72,8 @@ public:
   /**
    * Returns the last image saved to *slot*. Stores the original size
    * of the image to *size* and scales the image to *requestedSize*.
+   * If only one dimension of *requestedSize* is positive, the other
+   * one is calculated so that the aspect ratio is retained.
    *
    * ! The QtQuick Image component provides no way of updating a
    *   displayed image. The only way to force an update is to change
@@ -78,7 +91,8 @@ public slots:
    * Stores *image* to the given *slot*. If the slot doesn't exist
    * yet, creates a new slot. If *image* is invalid, the slot will be
    * cleared. If the slot has an associated listener, storing an image
-   * always invokes the listener's `updateImage()` function. In other
+   * invokes the listener's `updateImage()` function, unless the
+   * previous update is still waiting to be requested. In other
    * words, [setUpdateInterval()] has no effect when this function is
    * called directly. If the type of *image* cannot be recognized,
    * returns `false`.
@@ -147,7 +161,7 @@ private slots:
   void disconnectOutput(QObject* output);
 
 private:
-  template <class T> inline QImage matrixToQImage(const PiiVariant& image);
+  template <class T> inline QImage matrixToQImage(const PiiVariant& image, const QSize& requestedSize, QSize* size);
 
   struct Slot;
   class Data;
@@ -52,6 +52,53 @@ public slots:
   {
     return PiiYdin::convertPrimitiveTo<bool>(v);
   }
+
+  bool isMatrix() const
+  {
+    return PiiYdin::isMatrixType(v.type());
+  }
+
+  int rows() const
+  {
+    return isMatrix() ? PiiYdin::matrixRows(v) : 0;
+  }
+
+  int columns() const
+  {
+    return isMatrix() ? PiiYdin::matrixColumns(v) : 0;
+  }
+
+  /**
+   * Returns the name of the typed array that matches the elements of
+   * a matrix, e.g. "Float32Array". See [PiiYdin::typedArrayName()].
+   */
+  QString typedArrayName() const
+  {
+    return PiiYdin::typedArrayName(v);
+  }
+
+  /**
+   * Returns the elements of a primitive matrix as an ArrayBuffer.
+   * The data is copied in bulk, not element by element. Wrap the
+   * buffer into a typed array to read the values:
+   *
+   * ~~~(javascript)
+   * var histogram = new Float64Array(variant.toArrayBuffer());
+   * ~~~
+   */
+  QByteArray toArrayBuffer() const
+  {
+    return PiiYdin::matrixToByteArray(v);
+  }
+
+  /**
+   * Returns the elements of a primitive matrix as a JavaScript array
+   * in row-major order.
+   */
+  QVariantList toArray() const
+  {
+    return PiiYdin::matrixToVariantList(v);
+  }
 };
 
 #endif //_PIIVARIANTWRAPPER_H
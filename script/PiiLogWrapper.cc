@@ -17,6 +17,12 @@
 
 #include "PiiScript.h"
 
+// The script functions have the same names as the logging macros.
+#undef piiDebug
+#undef piiWarning
+#undef piiCritical
+#undef piiFatal
+
 namespace PiiLogWrapper
 {
   PII_STATIC_TR_FUNC(PiiLog)
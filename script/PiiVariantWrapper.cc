@@ -40,6 +40,36 @@ bool PiiVariantScriptObject::toBool() const
   return PiiYdin::convertPrimitiveTo<bool>(variant);
 }
 
+bool PiiVariantScriptObject::isMatrix() const
+{
+  return PiiYdin::isMatrixType(variant.type());
+}
+
+int PiiVariantScriptObject::rows() const
+{
+  return isMatrix() ? PiiYdin::matrixRows(variant) : 0;
+}
+
+int PiiVariantScriptObject::columns() const
+{
+  return isMatrix() ? PiiYdin::matrixColumns(variant) : 0;
+}
+
+QString PiiVariantScriptObject::typedArrayName() const
+{
+  return PiiYdin::typedArrayName(variant);
+}
+
+QByteArray PiiVariantScriptObject::toByteArray() const
+{
+  return PiiYdin::matrixToByteArray(variant);
+}
+
+QVariantList PiiVariantScriptObject::toArray() const
+{
+  return PiiYdin::matrixToVariantList(variant);
+}
+
 namespace PiiVariantWrapper
 {
   PII_STATIC_TR_FUNC(PiiVariant)
@@ -17,6 +17,7 @@
 #define _PIIVARIANTWRAPPER_H
 
 #include <PiiVariant.h>
+#include <QVariant>
 
 class PiiVariantScriptObject : public QObject
 {
@@ -29,6 +30,13 @@ public:
   Q_INVOKABLE double toDouble() const;
   Q_INVOKABLE bool toBool() const;
 
+  Q_INVOKABLE bool isMatrix() const;
+  Q_INVOKABLE int rows() const;
+  Q_INVOKABLE int columns() const;
+  Q_INVOKABLE QString typedArrayName() const;
+  Q_INVOKABLE QByteArray toByteArray() const;
+  Q_INVOKABLE QVariantList toArray() const;
+
   PiiVariant variant;
 };
 
@@ -0,0 +1,159 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiBitMatrix.h"
+
+#include <PiiBitMatrix.h>
+#include <PiiMatrixSerialization.h>
+#include <PiiBinaryInputArchive.h>
+#include <PiiBinaryOutputArchive.h>
+#include <PiiTextInputArchive.h>
+#include <PiiTextOutputArchive.h>
+#include <QtTest>
+#include <QBuffer>
+#include <cstdlib>
+
+static PiiMatrix<uchar> randomBinary(int rows, int columns, int density)
+{
+  PiiMatrix<uchar> mat(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      if (std::rand() % 100 < density)
+        mat(r,c) = 1;
+  return mat;
+}
+
+void TestPiiBitMatrix::construction()
+{
+  PiiBitMatrix matEmpty;
+  QVERIFY(matEmpty.isEmpty());
+  QCOMPARE(matEmpty.rows(), 0);
+  QCOMPARE(matEmpty.columns(), 0);
+
+  PiiBitMatrix matZeros(3, 65);
+  QCOMPARE(matZeros.rows(), 3);
+  QCOMPARE(matZeros.columns(), 65);
+  QCOMPARE(matZeros.wordsPerRow(), 2);
+  QCOMPARE(matZeros.count(), 0);
+
+  PiiMatrix<int> matSource(2,5,
+                           0, 3, 7, 0, 9,
+                           1, 0, 0, 4, 0);
+  PiiBitMatrix matThresholded(matSource, std::bind2nd(std::greater<int>(), 3));
+  QVERIFY(Pii::equals(matThresholded.toMatrix<int>(),
+                      PiiMatrix<int>(2,5,
+                                     0, 0, 1, 0, 1,
+                                     0, 0, 0, 1, 0)));
+  QCOMPARE(matThresholded.row(0)[0], quint64(0x14));
+  QCOMPARE(matThresholded.count(), 3);
+
+  PiiBitMatrix matNonZero(PiiBitMatrix::fromMatrix(matSource));
+  QCOMPARE(matNonZero.count(), 5);
+  PiiMatrix<uchar> matMask(matNonZero.toMatrix<uchar>(255));
+  QCOMPARE(matMask(1,0), uchar(255));
+  QCOMPARE(matMask(1,1), uchar(0));
+  QCOMPARE(Pii::sum<int>(matMask), 5*255);
+
+  // Sizes around word boundaries
+  for (int iColumns = 62; iColumns <= 130; ++iColumns)
+    {
+      PiiMatrix<uchar> matRandom(randomBinary(3, iColumns, 50));
+      PiiBitMatrix matBits(PiiBitMatrix::fromMatrix(matRandom));
+      QCOMPARE(matBits.wordsPerRow(), (iColumns + 63) / 64);
+      QCOMPARE(matBits.count(), Pii::sum<int>(matRandom));
+      QVERIFY(Pii::equals(matBits.toMatrix<uchar>(), matRandom));
+      QVERIFY(PiiBitMatrix(matBits.words(), iColumns) == matBits);
+    }
+}
+
+void TestPiiBitMatrix::access()
+{
+  PiiMatrix<uchar> matRandom(randomBinary(7, 100, 30));
+  PiiBitMatrix matBits(PiiBitMatrix::fromMatrix(matRandom));
+  for (int r=0; r<matRandom.rows(); ++r)
+    {
+      PiiBitMatrix::const_row_iterator row = matBits.rowBegin(r);
+      QCOMPARE(int(matBits.rowEnd(r) - row), 100);
+      for (int c=0; c<matRandom.columns(); ++c)
+        {
+          QCOMPARE(matBits(r,c), matRandom(r,c) != 0);
+          QCOMPARE(row[c], matRandom(r,c) != 0);
+        }
+      QVERIFY(std::equal(row, matBits.rowEnd(r), matRandom.rowBegin(r)));
+    }
+
+  PiiBitMatrix matCopy(matBits);
+  matCopy.set(6, 99);
+  matCopy.set(0, 0, false);
+  QVERIFY(matCopy(6, 99));
+  QVERIFY(!matCopy(0, 0));
+  // Implicit sharing must not leak the changes.
+  QCOMPARE(matBits(6, 99), matRandom(6, 99) != 0);
+  QCOMPARE(matBits(0, 0), matRandom(0, 0) != 0);
+}
+
+void TestPiiBitMatrix::bitOperations()
+{
+  PiiMatrix<uchar> matA(randomBinary(5, 71, 50)), matB(randomBinary(5, 71, 50));
+  PiiBitMatrix matBitsA(PiiBitMatrix::fromMatrix(matA)), matBitsB(PiiBitMatrix::fromMatrix(matB));
+
+  PiiMatrix<uchar> matAnd(5, 71), matOr(5, 71), matXor(5, 71), matNot(5, 71);
+  for (int r=0; r<5; ++r)
+    for (int c=0; c<71; ++c)
+      {
+        matAnd(r,c) = matA(r,c) & matB(r,c);
+        matOr(r,c) = matA(r,c) | matB(r,c);
+        matXor(r,c) = matA(r,c) ^ matB(r,c);
+        matNot(r,c) = !matA(r,c);
+      }
+  QVERIFY(Pii::equals((matBitsA & matBitsB).toMatrix<uchar>(), matAnd));
+  QVERIFY(Pii::equals((matBitsA | matBitsB).toMatrix<uchar>(), matOr));
+  QVERIFY(Pii::equals((matBitsA ^ matBitsB).toMatrix<uchar>(), matXor));
+  QVERIFY(Pii::equals((~matBitsA).toMatrix<uchar>(), matNot));
+  // The bits beyond the last column must stay clear.
+  QCOMPARE((~matBitsA).count(), 5*71 - matBitsA.count());
+  QVERIFY(~~matBitsA == matBitsA);
+  QVERIFY(matBitsA != matBitsB);
+}
+
+template <class InputArchive, class OutputArchive> static void testSerialization()
+{
+  PiiBitMatrix matBits(PiiBitMatrix::fromMatrix(randomBinary(23, 131, 40)));
+  QByteArray array;
+  QBuffer buffer(&array);
+  buffer.open(QIODevice::ReadWrite);
+  {
+    OutputArchive oa(&buffer);
+    oa << matBits;
+    oa << PiiBitMatrix();
+  }
+  buffer.seek(0);
+  InputArchive ia(&buffer);
+  PiiBitMatrix matResult, matEmpty(2,2);
+  ia >> matResult;
+  ia >> matEmpty;
+  QCOMPARE(matResult.rows(), 23);
+  QCOMPARE(matResult.columns(), 131);
+  QVERIFY(matResult == matBits);
+  QVERIFY(matEmpty.isEmpty());
+}
+
+void TestPiiBitMatrix::serialization()
+{
+  testSerialization<PiiBinaryInputArchive, PiiBinaryOutputArchive>();
+  testSerialization<PiiTextInputArchive, PiiTextOutputArchive>();
+}
+
+QTEST_MAIN(TestPiiBitMatrix)
@@ -24,6 +24,8 @@ class TestBoosting : public QObject
 
 private slots:
   void decisionStump();
+  void decisionStumpIndex();
+  void decisionStumpFactory();
   void adaBoost();
   void adaBoost_data();
 };
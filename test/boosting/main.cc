@@ -18,6 +18,8 @@
 #include <PiiBoostClassifier.h>
 #include <PiiDecisionStump.h>
 #include <PiiDefaultClassifierFactory.h>
+#include <PiiDecisionStumpFactory.h>
+#include <PiiRandom.h>
 
 void TestBoosting::decisionStump()
 {
@@ -73,6 +75,108 @@ void TestBoosting::decisionStump()
   QCOMPARE(stumps.classify(PiiMatrix<int>(1,1, 2).row(0)), 1.0);
 }
 
+void TestBoosting::decisionStumpIndex()
+{
+  typedef PiiDecisionStump<PiiMatrix<int> > Stump;
+  // Equal values must not be split.
+  PiiMatrix<int> features(6,1, 0, 1, 1, 1, 2, 3);
+  QVector<double> labels;
+  labels << 0 << 0 << 1 << 1 << 1 << 1;
+  Stump stump;
+  stump.learn(features, labels, QVector<double>());
+  QCOMPARE(stump.threshold(), 0);
+  QCOMPARE(stump.leftLabel(), 0.0);
+  QCOMPARE(stump.rightLabel(), 1.0);
+
+  Pii::seedRandom(1);
+  PiiMatrix<int> randomFeatures(500, 40);
+  QVector<double> randomLabels(500), randomWeights(500);
+  for (int r=0; r<randomFeatures.rows(); ++r)
+    {
+      for (int c=0; c<randomFeatures.columns(); ++c)
+        randomFeatures(r,c) = rand() % 100;
+      randomLabels[r] = rand() % 3;
+      randomWeights[r] = Pii::uniformRandom();
+    }
+  // Make feature 17 informative.
+  for (int r=0; r<randomFeatures.rows(); ++r)
+    if (randomLabels[r] == 2)
+      randomFeatures(r,17) += 40;
+
+  Stump exact;
+  exact.learn(randomFeatures, randomLabels, randomWeights);
+  QCOMPARE(exact.selectedFeature(), 17);
+
+  // Parallel evaluation and a bin for each distinct value must give
+  // the same result as exact sequential learning.
+  Stump::Index index(randomFeatures, 0, PiiParallelPolicy(4, 1));
+  Stump::Index binnedIndex(randomFeatures, 1000, PiiParallelPolicy(4, 1));
+  for (int i=0; i<2; ++i)
+    {
+      stump.learn(i == 0 ? index : binnedIndex, randomLabels, randomWeights, PiiParallelPolicy(4, 1));
+      QCOMPARE(stump.selectedFeature(), exact.selectedFeature());
+      QCOMPARE(stump.threshold(), exact.threshold());
+      QCOMPARE(stump.leftLabel(), exact.leftLabel());
+      QCOMPARE(stump.rightLabel(), exact.rightLabel());
+    }
+
+  // With few bins, the split can't be better than the optimal one.
+  stump.learn(Stump::Index(randomFeatures, 8), randomLabels, randomWeights);
+  QCOMPARE(stump.selectedFeature(), 17);
+  double dExactError = 0, dBinnedError = 0;
+  for (int r=0; r<randomFeatures.rows(); ++r)
+    {
+      if (exact.classify(randomFeatures[r]) != randomLabels[r])
+        dExactError += randomWeights[r];
+      if (stump.classify(randomFeatures[r]) != randomLabels[r])
+        dBinnedError += randomWeights[r];
+    }
+  QVERIFY(dBinnedError >= dExactError);
+}
+
+void TestBoosting::decisionStumpFactory()
+{
+  PiiMatrix<int> features(8, 2,
+                          1, 1,
+                          5, 4,
+                          -5, 5,
+                          -4, 3,
+                          3, -3,
+                          7, -4,
+                          -2, -6,
+                          -3, -2);
+  QVector<double> labels;
+  labels << 0 << 0 << 1 << 1 << 0 << 0 << 1 << 0;
+  PiiDefaultClassifierFactory<PiiDecisionStump<PiiMatrix<int> > > defaultFactory;
+  PiiDecisionStumpFactory<PiiMatrix<int> > factory;
+  factory.setThreadCount(2);
+  PiiBoostClassifier<PiiMatrix<int> > classifier1(&defaultFactory), classifier2(&factory);
+  classifier1.setMaxClassifiers(3);
+  classifier2.setMaxClassifiers(3);
+  classifier1.learn(features, labels);
+  classifier2.learn(features, labels);
+
+  QList<PiiClassifier<PiiMatrix<int> >*> learners1 = classifier1.classifiers(),
+    learners2 = classifier2.classifiers();
+  QCOMPARE(learners2.size(), learners1.size());
+  for (int i=0; i<learners1.size(); ++i)
+    {
+      PiiDecisionStump<PiiMatrix<int> >* pStump1 = static_cast<PiiDecisionStump<PiiMatrix<int> >*>(learners1[i]);
+      PiiDecisionStump<PiiMatrix<int> >* pStump2 = static_cast<PiiDecisionStump<PiiMatrix<int> >*>(learners2[i]);
+      QCOMPARE(pStump2->selectedFeature(), pStump1->selectedFeature());
+      QCOMPARE(pStump2->threshold(), pStump1->threshold());
+    }
+
+  // A modified sample set must be reindexed.
+  features(0,0) = 10;
+  features(1,1) = -10;
+  classifier1.learn(features, labels);
+  classifier2.learn(features, labels);
+  for (int r=-10; r<=10; ++r)
+    for (int c=-10; c<=10; ++c)
+      QCOMPARE(classifier2.classify(PiiMatrix<int>(1,2, r, c)[0]), classifier1.classify(PiiMatrix<int>(1,2, r, c)[0]));
+}
+
 void TestBoosting::adaBoost()
 {
   QFETCH(int, algorithm);
@@ -34,6 +34,7 @@ public:
 private slots:
   void calculateCameraPosition();
   void calibrateCameras();
+  void refineCalibration();
   void worldToCameraCoordinates();
   void cameraToWorldCoordinates();
   void unDistort();
@@ -41,6 +42,8 @@ private slots:
   void rotationVectors();
   void rotationVectors_data();
   void normalizedToPixelCoordinates();
+  void projectionKernels();
+  void undistortionGrid();
 
 private:
   bool _bVerbose;
@@ -22,6 +22,8 @@
 #include <iostream>
 
 #include <PiiCalibration.h>
+#include <PiiUndistortionGrid.h>
+#include <PiiCpu.h>
 #ifndef PII_NO_OPENCV
 #  include <PiiCalibrationPointFinder.h>
 #endif
@@ -1007,6 +1009,94 @@ void TestPiiCalibration::unDistort()
 #endif
 }
 
+void TestPiiCalibration::refineCalibration()
+{
+  using namespace PiiCalibration;
+
+  // A planar 9-by-6 board with 30 mm squares
+  PiiMatrix<double> matBoard(54, 3);
+  for (int r=0; r<6; ++r)
+    for (int c=0; c<9; ++c)
+      {
+        matBoard(r*9+c, 0) = c*30;
+        matBoard(r*9+c, 1) = r*30;
+      }
+
+  CameraParameters truth(640, 480);
+  truth.focalLength = PiiPoint<double>(800, 805);
+  truth.center = PiiPoint<double>(322, 236);
+  truth.k1 = -0.25;
+  truth.k2 = 0.1;
+  truth.p1 = 0.001;
+  truth.p2 = -0.0005;
+
+  const int iViewCount = 40;
+  QList<PiiMatrix<double> > lstWorld, lstImage;
+  QList<RelativePosition> lstTruth, lstInitial;
+  lstWorld << matBoard;
+  for (int v=0; v<iViewCount; ++v)
+    {
+      RelativePosition position(PiiVector<double,3>(0.4*sin(v*1.3), 0.4*cos(v*0.7), 0.2*v/iViewCount),
+                                PiiVector<double,3>(-120.0 + 5*(v%5), -75.0 + 4*(v%3), 600.0 + 10*v));
+      lstTruth << position;
+      lstImage << worldToPixelCoordinates(matBoard, position, truth);
+      position.rotation += PiiVector<double,3>(0.02, -0.01, 0.015);
+      position.translation += PiiVector<double,3>(5.0, -4.0, 20.0);
+      lstInitial << position;
+    }
+
+  CameraParameters initial(640, 480);
+  initial.focalLength = PiiPoint<double>(760, 770);
+
+  CameraParameters intrinsic(initial);
+  QList<RelativePosition> lstExtrinsic(lstInitial);
+  double dError = PiiCalibration::refineCalibration(lstWorld, lstImage, intrinsic, lstExtrinsic);
+  QVERIFY(dError < 1e-6);
+  QVERIFY(Pii::abs(intrinsic.focalLength.x - truth.focalLength.x) < 1e-4);
+  QVERIFY(Pii::abs(intrinsic.focalLength.y - truth.focalLength.y) < 1e-4);
+  QVERIFY(Pii::abs(intrinsic.center.x - truth.center.x) < 1e-4);
+  QVERIFY(Pii::abs(intrinsic.center.y - truth.center.y) < 1e-4);
+  QVERIFY(Pii::abs(intrinsic.k1 - truth.k1) < 1e-6);
+  QVERIFY(Pii::abs(intrinsic.k2 - truth.k2) < 1e-6);
+  QVERIFY(Pii::abs(intrinsic.p1 - truth.p1) < 1e-8);
+  QVERIFY(Pii::abs(intrinsic.p2 - truth.p2) < 1e-8);
+  QCOMPARE(lstExtrinsic.size(), iViewCount);
+  for (int v=0; v<iViewCount; ++v)
+    for (int i=0; i<3; ++i)
+      {
+        QVERIFY(Pii::abs(lstExtrinsic[v].rotation[i] - lstTruth[v].rotation[i]) < 1e-8);
+        QVERIFY(Pii::abs(lstExtrinsic[v].translation[i] - lstTruth[v].translation[i]) < 1e-5);
+      }
+
+  // The result must not depend on the number of threads.
+  CameraParameters parallelIntrinsic(initial);
+  QList<RelativePosition> lstParallelExtrinsic(lstInitial);
+  QCOMPARE(PiiCalibration::refineCalibration(lstWorld, lstImage, parallelIntrinsic, lstParallelExtrinsic,
+                                             NoCalibrationOptions, PiiParallelPolicy(4, 1)),
+           dError);
+  QCOMPARE(parallelIntrinsic.focalLength.x, intrinsic.focalLength.x);
+  QCOMPARE(parallelIntrinsic.k2, intrinsic.k2);
+  for (int v=0; v<iViewCount; ++v)
+    for (int i=0; i<3; ++i)
+      {
+        QCOMPARE(lstParallelExtrinsic[v].rotation[i], lstExtrinsic[v].rotation[i]);
+        QCOMPARE(lstParallelExtrinsic[v].translation[i], lstExtrinsic[v].translation[i]);
+      }
+
+  // Fixed parameters must stay put.
+  CameraParameters fixedIntrinsic(initial);
+  fixedIntrinsic.p1 = 0.01;
+  QList<RelativePosition> lstFixedExtrinsic(lstInitial);
+  PiiCalibration::refineCalibration(lstWorld, lstImage, fixedIntrinsic, lstFixedExtrinsic,
+                                    FixPrincipalPoint | FixAspectRatio | NoTangentialDistortion);
+  QCOMPARE(fixedIntrinsic.center.x, initial.center.x);
+  QCOMPARE(fixedIntrinsic.center.y, initial.center.y);
+  QCOMPARE(fixedIntrinsic.focalLength.x / fixedIntrinsic.focalLength.y,
+           initial.focalLength.x / initial.focalLength.y);
+  QCOMPARE(fixedIntrinsic.p1, 0.0);
+  QCOMPARE(fixedIntrinsic.p2, 0.0);
+}
+
 void TestPiiCalibration::normalizedToPixelCoordinates()
 {
   PiiCalibration::CameraParameters intrinsic;
@@ -1035,5 +1125,97 @@ void TestPiiCalibration::normalizedToPixelCoordinates()
 }
 
 
+void TestPiiCalibration::projectionKernels()
+{
+  PiiCalibration::CameraParameters intrinsic;
+  intrinsic.focalLength.x = 1210;
+  intrinsic.focalLength.y = 1190;
+  intrinsic.center.x = 650;
+  intrinsic.center.y = 470;
+  intrinsic.k1 = -0.21;
+  intrinsic.k2 = 0.08;
+  intrinsic.p1 = 0.0012;
+  intrinsic.p2 = -0.0007;
+  PiiCalibration::RelativePosition extrinsic(PiiVector<double,3>(0.1, -0.2, 0.05),
+                                             PiiVector<double,3>(-30.0, 20.0, 800.0));
+
+  // An odd number of points leaves a scalar tail for all vector widths.
+  const int iPoints = 37;
+  PiiMatrix<double> matWorld(iPoints, 3);
+  for (int i=0; i<iPoints; ++i)
+    {
+      matWorld(i,0) = -200 + 11.0 * i;
+      matWorld(i,1) = 150 - 7.5 * i;
+      matWorld(i,2) = (i % 5) * 3.0;
+    }
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  PiiMatrix<double> matPixels(worldToPixelCoordinates(matWorld, extrinsic, intrinsic));
+  PiiMatrix<double> matCamera(worldToCameraCoordinates(matWorld, extrinsic));
+  PiiMatrix<double> matCameraPixels(cameraToPixelCoordinates(matCamera, intrinsic));
+  Pii::setCpuFeatureMask(0);
+  QVERIFY(Pii::equals(worldToPixelCoordinates(matWorld, extrinsic, intrinsic), matPixels));
+  QVERIFY(Pii::equals(cameraToPixelCoordinates(matCamera, intrinsic), matCameraPixels));
+  Pii::setCpuFeatureMask(iFeatures);
+
+  QCOMPARE(matPixels.rows(), iPoints);
+  QCOMPARE(matPixels.columns(), 2);
+  for (int i=0; i<iPoints; ++i)
+    {
+      // The unfused chain, one point at a time.
+      double dX, dY;
+      PiiCalibration::normalizedToPixelCoordinates(intrinsic,
+                                                   matCamera(i,0) / matCamera(i,2),
+                                                   matCamera(i,1) / matCamera(i,2),
+                                                   &dX, &dY);
+      QVERIFY(Pii::abs(matPixels(i,0) - dX) < 1e-9);
+      QVERIFY(Pii::abs(matPixels(i,1) - dY) < 1e-9);
+      QCOMPARE(matCameraPixels(i,0), dX);
+      QCOMPARE(matCameraPixels(i,1), dY);
+    }
+}
+
+void TestPiiCalibration::undistortionGrid()
+{
+  PiiCalibration::CameraParameters intrinsic;
+  intrinsic.focalLength.x = intrinsic.focalLength.y = 800;
+  intrinsic.center.x = 320;
+  intrinsic.center.y = 240;
+  intrinsic.k1 = -0.3;
+  intrinsic.k2 = 0.12;
+  intrinsic.p1 = 0.001;
+  intrinsic.p2 = -0.002;
+
+  PiiUndistortionGrid grid(intrinsic, 640, 480);
+  QVERIFY(!grid.isEmpty());
+
+  // Normalized points all over the image and a bit outside of it.
+  const int iPoints = 15*11;
+  PiiMatrix<double> matNormalized(iPoints, 2);
+  for (int r=0; r<11; ++r)
+    for (int c=0; c<15; ++c)
+      {
+        matNormalized(r*15+c, 0) = -0.45 + c * 0.9 / 14;
+        matNormalized(r*15+c, 1) = -0.35 + r * 0.7 / 10;
+      }
+  PiiMatrix<double> matPixels(normalizedToPixelCoordinates(matNormalized, intrinsic));
+  PiiMatrix<double> matUndistorted(grid.undistort(matPixels, 1.0, PiiParallelPolicy(0, 8)));
+  QCOMPARE(matUndistorted.rows(), iPoints);
+  QCOMPARE(matUndistorted.columns(), 3);
+  for (int i=0; i<iPoints; ++i)
+    {
+      QVERIFY(Pii::abs(matUndistorted(i,0) - matNormalized(i,0)) < 1e-10);
+      QVERIFY(Pii::abs(matUndistorted(i,1) - matNormalized(i,1)) < 1e-10);
+      QCOMPARE(matUndistorted(i,2), 1.0);
+    }
+  QVERIFY(Pii::equals(grid.undistort(matPixels), grid.undistort(matPixels, NAN, PiiParallelPolicy(0, 8))));
+
+  double dX, dY;
+  grid.undistort(NAN, 10, &dX, &dY);
+  QVERIFY(Pii::isNan(dX) && Pii::isNan(dY));
+  PiiUndistortionGrid().undistort(10, 10, &dX, &dY);
+  QVERIFY(Pii::isNan(dX) && Pii::isNan(dY));
+}
+
 QTEST_MAIN(TestPiiCalibration)
 
@@ -24,6 +24,7 @@ class TestPiiCamera : public QObject
 
 private slots:
   void bayerToRgb();
+  void demosaic();
   //void bayerToRgbSpeed();
 };
 
@@ -18,6 +18,7 @@
 #include <PiiCamera.h>
 #include <PiiBayerConverter.h>
 #include <PiiColor.h>
+#include <PiiCpu.h>
 
 #include <QtTest>
 
@@ -89,6 +90,117 @@ void TestPiiCamera::bayerToRgb()
   QVERIFY(Pii::equals(gray, (red + green + blue)/3));
 }
 
+template <class T, class Decoder, class Pixel> static bool demosaicMatches(const PiiMatrix<T>& encoded,
+                                                                           PiiCamera::ImageFormat format,
+                                                                           Decoder decoder, Pixel pixel)
+{
+  return Pii::equals(PiiCamera::demosaic(encoded, format),
+                     PiiCamera::bayerToRgb(encoded, decoder, pixel));
+}
+
+void TestPiiCamera::demosaic()
+{
+  // Sizes that exercise both vector blocks and scalar tails
+  PiiMatrix<unsigned char> matRaw8(PiiMatrix<unsigned char>::uninitialized(7,37));
+  PiiMatrix<unsigned short> matRaw16(PiiMatrix<unsigned short>::uninitialized(6,23));
+  for (int r=0; r<matRaw8.rows(); ++r)
+    for (int c=0; c<matRaw8.columns(); ++c)
+      matRaw8(r,c) = (unsigned char)((r*73 + c*151 + r*c*7) & 0xff);
+  for (int r=0; r<matRaw16.rows(); ++r)
+    for (int c=0; c<matRaw16.columns(); ++c)
+      matRaw16(r,c) = (unsigned short)((r*7919 + c*104729 + r*c*13) & 0xffff);
+
+  // Bilinear decoding equals the template decoders.
+  QVERIFY(demosaicMatches(matRaw8, PiiCamera::BayerRGGBFormat, PiiCamera::RggbDecoder<unsigned char>(),
+                          PiiCamera::Rgb4Pixel<unsigned char>()));
+  QVERIFY(demosaicMatches(matRaw8, PiiCamera::BayerGRBGFormat, PiiCamera::GrbgDecoder<unsigned char>(),
+                          PiiCamera::Rgb4Pixel<unsigned char>()));
+  QVERIFY(demosaicMatches(matRaw8, PiiCamera::BayerBGGRFormat, PiiCamera::BggrDecoder<unsigned char>(),
+                          PiiCamera::Rgb4Pixel<unsigned char>()));
+  QVERIFY(demosaicMatches(matRaw16, PiiCamera::BayerRGGBFormat, PiiCamera::RggbDecoder<unsigned short>(),
+                          PiiCamera::RgbPixel<unsigned short>()));
+  QVERIFY(demosaicMatches(matRaw16, PiiCamera::BayerGRBGFormat, PiiCamera::GrbgDecoder<unsigned short>(),
+                          PiiCamera::RgbPixel<unsigned short>()));
+  QVERIFY(demosaicMatches(matRaw16, PiiCamera::BayerBGGRFormat, PiiCamera::BggrDecoder<unsigned short>(),
+                          PiiCamera::RgbPixel<unsigned short>()));
+
+  // GBRG is GRBG rotated 180 degrees.
+  {
+    PiiMatrix<unsigned char> matGrbgRaw(matRaw8(0,0,6,36));
+    PiiMatrix<unsigned char> matRotated(PiiMatrix<unsigned char>::uninitialized(6,36));
+    for (int r=0; r<6; ++r)
+      for (int c=0; c<36; ++c)
+        matRotated(r,c) = matGrbgRaw(5-r,35-c);
+    PiiMatrix<PiiColor4<> > matGbrg(PiiCamera::demosaic(matRotated, PiiCamera::BayerGBRGFormat));
+    PiiMatrix<PiiColor4<> > matGrbg(PiiCamera::demosaic(matGrbgRaw, PiiCamera::BayerGRBGFormat));
+    bool bRotated = true;
+    for (int r=0; r<6; ++r)
+      for (int c=0; c<36; ++c)
+        bRotated = bRotated && matGbrg(r,c) == matGrbg(5-r,35-c);
+    QVERIFY(bRotated);
+  }
+
+  // Vector and scalar code agree.
+  for (int i=0; i<2; ++i)
+    {
+      PiiCamera::BayerInterpolation interpolation = PiiCamera::BayerInterpolation(i);
+      PiiMatrix<PiiColor4<> > matVector8(PiiCamera::demosaic(matRaw8, PiiCamera::BayerGBRGFormat, interpolation));
+      PiiMatrix<PiiColor<unsigned short> > matVector16(PiiCamera::demosaic(matRaw16, PiiCamera::BayerRGGBFormat, interpolation));
+      Pii::setCpuFeatureMask(0);
+      QVERIFY(Pii::equals(PiiCamera::demosaic(matRaw8, PiiCamera::BayerGBRGFormat, interpolation), matVector8));
+      QVERIFY(Pii::equals(PiiCamera::demosaic(matRaw16, PiiCamera::BayerRGGBFormat, interpolation), matVector16));
+      Pii::setCpuFeatureMask(-1);
+    }
+
+  // Gray levels and separate channels are the same data.
+  {
+    PiiMatrix<PiiColor4<> > matColor(PiiCamera::demosaic(matRaw8, PiiCamera::BayerRGGBFormat));
+    PiiMatrix<unsigned char> matRed, matGreen, matBlue;
+    QVERIFY(PiiCamera::demosaicToChannels(matRaw8, matRed, matGreen, matBlue, PiiCamera::BayerRGGBFormat));
+    PiiMatrix<unsigned char> matGray(PiiCamera::demosaicToGray(matRaw8, PiiCamera::BayerRGGBFormat));
+    bool bSame = true;
+    for (int r=0; r<matColor.rows(); ++r)
+      for (int c=0; c<matColor.columns(); ++c)
+        bSame = bSame &&
+          matRed(r,c) == matColor(r,c).rgbR &&
+          matGreen(r,c) == matColor(r,c).rgbG &&
+          matBlue(r,c) == matColor(r,c).rgbB &&
+          matGray(r,c) == (int(matRed(r,c)) + int(matGreen(r,c)) + int(matBlue(r,c))) / 3;
+    QVERIFY(bSame);
+  }
+
+  // Green is interpolated along edges.
+  {
+    PiiMatrix<unsigned char> matEdge(4,20);
+    for (int r=0; r<4; ++r)
+      for (int c=11; c<20; ++c)
+        matEdge(r,c) = 200;
+    PiiMatrix<PiiColor4<> > matBilinear(PiiCamera::demosaic(matEdge, PiiCamera::BayerRGGBFormat));
+    PiiMatrix<PiiColor4<> > matEdgeAware(PiiCamera::demosaic(matEdge, PiiCamera::BayerRGGBFormat,
+                                                             PiiCamera::EdgeAwareBayerInterpolation));
+    // (1,11) is a blue site right next to the edge.
+    QCOMPARE(int(matBilinear(1,11).rgbG), 150);
+    QCOMPARE(int(matEdgeAware(1,11).rgbG), 200);
+    QCOMPARE(int(matEdgeAware(1,11).rgbR), int(matBilinear(1,11).rgbR));
+  }
+
+  // Half size
+  {
+    PiiMatrix<unsigned char> matCells(3,5,
+                                      10, 20, 11, 21, 99,
+                                      30, 40, 31, 41, 99,
+                                      99, 99, 99, 99, 99);
+    PiiMatrix<PiiColor4<> > matHalf(PiiCamera::demosaicHalfSize(matCells, PiiCamera::BayerGRBGFormat));
+    QCOMPARE(matHalf.rows(), 1);
+    QCOMPARE(matHalf.columns(), 2);
+    QVERIFY(matHalf(0,0) == PiiColor4<>(20, 25, 30));
+    QVERIFY(matHalf(0,1) == PiiColor4<>(21, 26, 31));
+  }
+
+  QVERIFY(PiiCamera::demosaic(matRaw8, PiiCamera::MonoFormat).isEmpty());
+  QVERIFY(PiiCamera::demosaicToGray(PiiMatrix<unsigned char>(1,5), PiiCamera::BayerRGGBFormat).isEmpty());
+}
+
 #if 0
 void TestPiiCamera::bayerToRgbSpeed()
 {
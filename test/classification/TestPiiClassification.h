@@ -26,6 +26,15 @@ private slots:
   void kMeans();
   void calculateDistanceMatrix();
   void countLabels();
+  void distanceKernels();
+  void findClosestMatches();
+  void hammingDistance();
+  void hnswIndex();
+  void kernelMatrix();
+  void lshIndex();
+  void quantizedModels();
+  void somBatch();
+  void vocabularyTree();
 };
 
 
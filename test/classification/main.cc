@@ -18,10 +18,83 @@
 #include <PiiClassification.h>
 #include <PiiSquaredGeometricDistance.h>
 #include <PiiGeometricDistance.h>
+#include <PiiAbsDiffDistance.h>
+#include <PiiChiSquaredDistance.h>
+#include <PiiCosineDistance.h>
+#include <PiiHistogramIntersection.h>
+#include <PiiHammingDistance.h>
+#include <PiiHnswIndex.h>
+#include <PiiLshIndex.h>
+#include <PiiVocabularyTree.h>
+#include <PiiQuantizedModelSet.h>
+#include <PiiGaussianKernel.h>
+#include <PiiPolynomialKernel.h>
+#include <PiiKernelCache.h>
+#include <PiiKnnClassifier.h>
+#include <PiiSom.h>
+#include <PiiCpu.h>
 #include <QtTest>
 
 #include <PiiMatrixUtil.h>
 #include <iostream>
+#include <algorithm>
+
+template <class Kernel> static void testKernelMatrix(const PiiMatrix<float>& samples, const Kernel& kernel)
+{
+  typedef typename PiiKernelFunction<const float*>::template Impl<Kernel> Impl;
+  Impl impl;
+  static_cast<Kernel&>(impl) = kernel;
+  QVector<const float*> vecSamples;
+  for (int r=0; r<samples.rows(); ++r)
+    vecSamples << samples[r];
+
+  // The first 7 samples against all, and all against all.
+  for (int iRows=7; iRows<=samples.rows(); iRows += samples.rows() - 7)
+    {
+      QVector<double> vecDistances(iRows * samples.rows());
+      impl.distanceMatrix(vecSamples.constData(), iRows, vecSamples.constData(), samples.rows(),
+                          samples.columns(), vecDistances.data());
+      for (int r=0; r<iRows; ++r)
+        for (int c=0; c<samples.rows(); ++c)
+          QVERIFY(Pii::abs(vecDistances[r*samples.rows() + c] -
+                           kernel(samples[r], samples[c], samples.columns())) < 1e-9);
+    }
+
+  // Rows must remain correct even if the cache can hold only a few
+  // of them.
+  for (int iRows=1; iRows<=samples.rows(); iRows *= 4)
+    {
+      PiiKernelCache<PiiMatrix<float> > cache(samples, impl, iRows * samples.rows() * sizeof(double));
+      QCOMPARE(cache.capacity(), iRows);
+      for (int i=0; i<samples.rows() * 3; ++i)
+        {
+          const int iRow = (i * 7 + i / 13) % samples.rows();
+          const double* pRow = cache.row(iRow);
+          for (int c=0; c<samples.rows(); ++c)
+            QVERIFY(Pii::abs(pRow[c] - kernel(samples[iRow], samples[c], samples.columns())) < 1e-9);
+        }
+      if (iRows == samples.rows())
+        QCOMPARE(cache.calculatedRowCount(), samples.rows());
+    }
+}
+
+void TestPiiClassification::kernelMatrix()
+{
+  srand(3);
+  PiiMatrix<float> matSamples(70, 23);
+  for (int r=0; r<matSamples.rows(); ++r)
+    for (int c=0; c<matSamples.columns(); ++c)
+      matSamples(r,c) = float(rand() % 100) / 50;
+
+  PiiGaussianKernel<const float*> gaussian;
+  gaussian.setSigma(3);
+  testKernelMatrix(matSamples, gaussian);
+  PiiPolynomialKernel<const float*> polynomial;
+  polynomial.setOffset(1);
+  polynomial.setScale(0.1);
+  polynomial.setDegree(3);
+  testKernelMatrix(matSamples, polynomial);
+}
 
 void TestPiiClassification::kMeans()
 {
@@ -102,4 +175,562 @@ void TestPiiClassification::countLabels()
   QCOMPARE(counts[3].second, 1);
 }
 
+template <class T> static double referenceDistance(int measure, const T* a, const T* b, int length)
+{
+  double dSum = 0, dLen1 = 0, dLen2 = 0;
+  for (int i=0; i<length; ++i)
+    {
+      const double dDiff = double(a[i] - b[i]);
+      switch (measure)
+        {
+        case 0: dSum += dDiff * dDiff; break;
+        case 1: dSum += Pii::abs(dDiff); break;
+        case 2: dSum += dDiff * dDiff / double(a[i] + b[i]); break;
+        case 3: dSum -= double(qMin(a[i], b[i])); break;
+        default:
+          dSum += double(a[i]) * double(b[i]);
+          dLen1 += double(a[i]) * double(a[i]);
+          dLen2 += double(b[i]) * double(b[i]);
+        }
+    }
+  return measure == 4 ? -dSum / ::sqrt(dLen1 * dLen2) : dSum;
+}
+
+template <class T> static void testDistanceKernels()
+{
+  typedef const T* It;
+  const int aiLengths[] = { 1, 2, 3, 7, 16, 63, 64, 65, 200 };
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { iFeatures, 0 };
+  for (unsigned l=0; l<sizeof(aiLengths)/sizeof(aiLengths[0]); ++l)
+    {
+      const int iLength = aiLengths[l];
+      PiiMatrix<T> matData(2, iLength);
+      for (int c=0; c<iLength; ++c)
+        {
+          matData(0,c) = T(rand() % 1000) / 100 + 1;
+          matData(1,c) = T(rand() % 1000) / 100 + 1;
+        }
+      const T* a = matData[0], *b = matData[1];
+      double adExpected[5];
+      for (int m=0; m<5; ++m)
+        adExpected[m] = referenceDistance(m, a, b, iLength);
+
+      for (int f=0; f<2; ++f)
+        {
+          Pii::setCpuFeatureMask(aiFeatures[f]);
+          QVERIFY(Pii::almostEqualRel(PiiSquaredGeometricDistance<It>()(a, b, iLength), adExpected[0], 1e-10));
+          QVERIFY(Pii::almostEqualRel(PiiAbsDiffDistance<It>()(a, b, iLength), adExpected[1], 1e-10));
+          QVERIFY(Pii::almostEqualRel(PiiChiSquaredDistance<It>()(a, b, iLength), adExpected[2], 1e-10));
+          QVERIFY(Pii::almostEqualRel(PiiHistogramIntersection<It>()(a, b, iLength), adExpected[3], 1e-10));
+          QVERIFY(Pii::almostEqualRel(PiiCosineDistance<It>()(a, b, iLength), adExpected[4], 1e-10));
+
+          // A bound below the distance may stop the calculation, but
+          // the result must still exceed the bound.
+          const double dBound = adExpected[0] / 3;
+          QVERIFY(PiiSquaredGeometricDistance<It>()(a, b, iLength, dBound) > dBound);
+          QVERIFY(PiiAbsDiffDistance<It>()(a, b, iLength, adExpected[1] / 3) > adExpected[1] / 3);
+          QVERIFY(Pii::almostEqualRel(PiiSquaredGeometricDistance<It>()(a, b, iLength, adExpected[0] * 2),
+                                      adExpected[0], 1e-10));
+        }
+      Pii::setCpuFeatureMask(iFeatures);
+    }
+}
+
+void TestPiiClassification::distanceKernels()
+{
+  srand(1);
+  testDistanceKernels<float>();
+  testDistanceKernels<double>();
+  testDistanceKernels<int>();
+}
+
+static int countDifferentBits(const unsigned char* a, const unsigned char* b, int length)
+{
+  int iCount = 0;
+  for (int i=0; i<length; ++i)
+    for (int b2=0; b2<8; ++b2)
+      iCount += ((a[i] ^ b[i]) >> b2) & 1;
+  return iCount;
+}
+
+void TestPiiClassification::hammingDistance()
+{
+  srand(5);
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { iFeatures, 0 };
+  PiiHammingDistance<const unsigned char*> measure;
+  // Lengths that leave different tails after full vectors.
+  const int aiLengths[] = { 0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 64, 100 };
+  for (int l=0; l<int(sizeof(aiLengths)/sizeof(aiLengths[0])); ++l)
+    {
+      const int iLength = aiLengths[l];
+      PiiMatrix<unsigned char> matModels(5, qMax(iLength, 1));
+      for (int r=0; r<matModels.rows(); ++r)
+        for (int c=0; c<matModels.columns(); ++c)
+          matModels(r,c) = static_cast<unsigned char>(rand() % 256);
+      const unsigned char* apModels[4] = { matModels[1], matModels[2], matModels[3], matModels[4] };
+
+      for (int f=0; f<2; ++f)
+        {
+          Pii::setCpuFeatureMask(aiFeatures[f]);
+          for (int r=1; r<matModels.rows(); ++r)
+            QCOMPARE(measure(matModels[0], matModels[r], iLength),
+                     double(countDifferentBits(matModels[0], matModels[r], iLength)));
+          int aiDistances[4];
+          PiiHammingKernel<const unsigned char*>::distances(matModels[0], apModels, 4, iLength, aiDistances);
+          for (int i=0; i<4; ++i)
+            QCOMPARE(aiDistances[i], countDifferentBits(matModels[0], apModels[i], iLength));
+        }
+      Pii::setCpuFeatureMask(iFeatures);
+    }
+
+  // All bits of wider types count.
+  const int aiA[] = { 0x7fff0000, 3 }, aiB[] = { 0, 0 };
+  QCOMPARE(PiiHammingDistance<const int*>()(aiA, aiB, 2), 17.0);
+}
+
+void TestPiiClassification::lshIndex()
+{
+  srand(6);
+  // 256-bit random descriptors. Two random descriptors differ in
+  // about 128 bits, a distorted copy in eight.
+  const int iModels = 2000, iBytes = 32, iQueries = 200;
+  PiiMatrix<unsigned char> matModels(iModels, iBytes);
+  for (int r=0; r<iModels; ++r)
+    for (int c=0; c<iBytes; ++c)
+      matModels(r,c) = static_cast<unsigned char>(rand() % 256);
+  PiiMatrix<unsigned char> matQueries(iQueries, iBytes);
+  for (int q=0; q<iQueries; ++q)
+    {
+      for (int c=0; c<iBytes; ++c)
+        matQueries(q,c) = matModels(q * 7, c);
+      for (int i=0; i<8; ++i)
+        {
+          const int iBit = rand() % (iBytes * 8);
+          matQueries(q, iBit / 8) ^= static_cast<unsigned char>(1 << (iBit % 8));
+        }
+    }
+
+  PiiLshIndex<PiiMatrix<unsigned char> > index;
+  QVERIFY(index.isEmpty());
+  QCOMPARE(index.findClosestMatch(matModels[0]), -1);
+  QCOMPARE(index.findClosestMatches(matModels[0], 3).size(), 0);
+
+  index.buildIndex(matModels);
+  QVERIFY(!index.isEmpty());
+  QCOMPARE(index.modelCount(), iModels);
+
+  // Each model is its own nearest neighbor.
+  for (int r=0; r<iModels; r += 7)
+    {
+      double dDistance = -1;
+      QCOMPARE(index.findClosestMatch(matModels[r], &dDistance), r);
+      QCOMPARE(dDistance, 0.0);
+    }
+
+  // The same bytes stored as floats hash identically.
+  PiiMatrix<float> matFloatModels(matModels);
+  PiiLshIndex<PiiMatrix<float> > floatIndex;
+  floatIndex.buildIndex(matFloatModels);
+
+  int iHits = 0, iFloatHits = 0;
+  for (int q=0; q<iQueries; ++q)
+    {
+      PiiClassification::MatchList lstMatches = index.findClosestMatches(matQueries[q], 2);
+      QVERIFY(lstMatches.size() <= 2);
+      if (lstMatches.size() > 0 && lstMatches[0].second == q * 7)
+        {
+          ++iHits;
+          QVERIFY(lstMatches[0].first <= 8.0);
+          if (lstMatches.size() > 1)
+            QVERIFY(lstMatches[1].first > lstMatches[0].first);
+        }
+      PiiMatrix<float> matFloatQuery(PiiMatrix<unsigned char>(matQueries(q,0,1,-1)));
+      if (floatIndex.findClosestMatch(matFloatQuery[0]) == q * 7)
+        ++iFloatHits;
+    }
+  QVERIFY(iHits >= iQueries * 98 / 100);
+  QCOMPARE(iFloatHits, iHits);
+
+  // A single table with long keys misses some.
+  index.setTableCount(1);
+  index.setKeyBits(24);
+  index.buildIndex(matModels);
+  int iSingleHits = 0;
+  for (int q=0; q<iQueries; ++q)
+    if (index.findClosestMatch(matQueries[q]) == q * 7)
+      ++iSingleHits;
+  QVERIFY(iSingleHits < iHits);
+}
+
+void TestPiiClassification::findClosestMatches()
+{
+  srand(2);
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { iFeatures, 0 };
+  PiiMatrix<float> matModels(53, 37);
+  for (int r=0; r<matModels.rows(); ++r)
+    for (int c=0; c<matModels.columns(); ++c)
+      matModels(r,c) = float(rand() % 256);
+  PiiSquaredGeometricDistance<const float*> measure;
+  PiiDistanceMeasure<const float*>* pMeasure = new PiiDistanceMeasure<const float*>::Impl<PiiSquaredGeometricDistance<const float*> >;
+
+  for (int s=0; s<10; ++s)
+    {
+      PiiMatrix<float> matSample(1, matModels.columns());
+      for (int c=0; c<matSample.columns(); ++c)
+        matSample(0,c) = float(rand() % 256);
+
+      // Brute force
+      QVector<QPair<double,int> > lstExpected;
+      for (int r=0; r<matModels.rows(); ++r)
+        lstExpected << qMakePair(measure(matSample[0], matModels[r], matModels.columns()), r);
+      std::sort(lstExpected.begin(), lstExpected.end());
+
+      for (int f=0; f<2; ++f)
+        {
+          Pii::setCpuFeatureMask(aiFeatures[f]);
+          double dDistance = 0;
+          QCOMPARE(PiiClassification::findClosestMatch(matSample[0], matModels, measure, &dDistance),
+                   lstExpected[0].second);
+          QCOMPARE(dDistance, lstExpected[0].first);
+          QCOMPARE(PiiClassification::findClosestMatch(matSample[0], matModels, *pMeasure, &dDistance),
+                   lstExpected[0].second);
+          QCOMPARE(dDistance, lstExpected[0].first);
+
+          PiiClassification::MatchList lstMatches = PiiClassification::findClosestMatches(matSample[0], matModels,
+                                                                                          *pMeasure, 5);
+          QCOMPARE(lstMatches.size(), 5);
+          for (int i=0; i<5; ++i)
+            {
+              QCOMPARE(lstMatches[i].second, lstExpected[i].second);
+              QCOMPARE(lstMatches[i].first, lstExpected[i].first);
+            }
+        }
+      Pii::setCpuFeatureMask(iFeatures);
+    }
+  delete pMeasure;
+}
+
+void TestPiiClassification::hnswIndex()
+{
+  srand(3);
+  // Clustered data in a 40-dimensional space.
+  const int iModels = 2000, iFeatures = 40, iClusters = 20;
+  PiiMatrix<float> matCenters(iClusters, iFeatures);
+  for (int r=0; r<iClusters; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matCenters(r,c) = float(rand() % 1000);
+  PiiMatrix<float> matModels(iModels, iFeatures);
+  QVector<double> vecLabels(iModels);
+  for (int r=0; r<iModels; ++r)
+    {
+      vecLabels[r] = r % iClusters;
+      for (int c=0; c<iFeatures; ++c)
+        matModels(r,c) = matCenters(r % iClusters, c) + float(rand() % 200);
+    }
+
+  PiiSquaredGeometricDistance<const float*> measure;
+  PiiHnswIndex<PiiMatrix<float> > index;
+  QVERIFY(index.isEmpty());
+  QCOMPARE(index.findClosestMatch(matModels[0], measure), -1);
+  QCOMPARE(index.findClosestMatches(matModels[0], measure, 3).size(), 0);
+
+  index.buildIndex(matModels, measure);
+  QVERIFY(!index.isEmpty());
+  QCOMPARE(index.modelCount(), iModels);
+
+  // Each model is its own nearest neighbor.
+  for (int r=0; r<iModels; r += 7)
+    {
+      double dDistance = -1;
+      QCOMPARE(index.findClosestMatch(matModels[r], measure, &dDistance), r);
+      QCOMPARE(dDistance, 0.0);
+    }
+
+  const int iQueries = 200;
+  PiiMatrix<float> matQueries(iQueries, iFeatures);
+  for (int r=0; r<iQueries; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matQueries(r,c) = matCenters(r % iClusters, c) + float(rand() % 200);
+
+  // Recall improves with search width and reaches 100% when the
+  // search is exhaustive.
+  const int aiWidths[] = { 10, 50, iModels };
+  const int aiMinHits[] = { iQueries * 8 / 10, iQueries * 95 / 100, iQueries };
+  for (int w=0; w<3; ++w)
+    {
+      index.setSearchWidth(aiWidths[w]);
+      int iHits = 0, iKnnHits = 0;
+      for (int q=0; q<iQueries; ++q)
+        {
+          double dExpected;
+          const int iExpected = PiiClassification::findClosestMatch(matQueries[q], matModels, measure, &dExpected);
+          double dDistance;
+          if (index.findClosestMatch(matQueries[q], measure, &dDistance) == iExpected)
+            {
+              ++iHits;
+              QCOMPARE(dDistance, dExpected);
+            }
+          PiiClassification::MatchList lstExpected = PiiClassification::findClosestMatches(matQueries[q], matModels,
+                                                                                           measure, 5);
+          PiiClassification::MatchList lstMatches = index.findClosestMatches(matQueries[q], measure, 5);
+          QCOMPARE(lstMatches.size(), 5);
+          for (int i=1; i<5; ++i)
+            QVERIFY(lstMatches[i-1].first <= lstMatches[i].first);
+          if (lstMatches[4].second == lstExpected[4].second)
+            ++iKnnHits;
+        }
+      QVERIFY(iHits >= aiMinHits[w]);
+      QVERIFY(iKnnHits >= aiMinHits[w]);
+    }
+
+  // The classifiers use the index once it has been built.
+  PiiKnnClassifier<PiiMatrix<float> > knn;
+  knn.setModels(matModels);
+  knn.setClassLabels(vecLabels);
+  knn.setK(3);
+  QVERIFY(!knn.hasIndex());
+  knn.buildIndex();
+  QVERIFY(knn.hasIndex());
+  knn.index().setSearchWidth(iModels);
+  for (int q=0; q<iQueries; q += 10)
+    QCOMPARE(knn.classify(matQueries[q]),
+             PiiClassification::knnClassify(matQueries[q], matModels, vecLabels, measure, 3));
+  knn.setModels(matModels);
+  QVERIFY(!knn.hasIndex());
+}
+
+template <class Measure> static void testQuantizedMatches(const PiiQuantizedModelSet<PiiMatrix<double> >& models,
+                                                          const PiiMatrix<double>& matModels,
+                                                          const PiiMatrix<double>& matQueries,
+                                                          const Measure& measure)
+{
+  int iHits = 0;
+  for (int q=0; q<matQueries.rows(); ++q)
+    {
+      double dExpected, dDistance;
+      const int iExpected = PiiClassification::findClosestMatch(matQueries[q], matModels, measure, &dExpected);
+      const int iClosest = models.findClosestMatch(matQueries[q], measure, &dDistance);
+      QVERIFY(iClosest >= 0);
+      // The approximate distance is close to the true distance of the
+      // match.
+      const double dTrue = measure(matQueries[q], matModels[iClosest], matModels.columns());
+      QVERIFY(Pii::abs(dDistance - dTrue) <= 0.02 * Pii::abs(dTrue) + 1e-6);
+      if (iClosest == iExpected)
+        ++iHits;
+
+      PiiClassification::MatchList lstMatches = models.findClosestMatches(matQueries[q], measure, 5);
+      QCOMPARE(lstMatches.size(), 5);
+      QCOMPARE(lstMatches[0].second, iClosest);
+      for (int i=1; i<5; ++i)
+        QVERIFY(lstMatches[i-1].first <= lstMatches[i].first);
+    }
+  QVERIFY(iHits >= matQueries.rows() * 9 / 10);
+}
+
+void TestPiiClassification::quantizedModels()
+{
+  srand(5);
+  const int iModels = 500, iFeatures = 24, iQueries = 100;
+  PiiMatrix<double> matModels(iModels, iFeatures), matQueries(iQueries, iFeatures);
+  for (int r=0; r<iModels; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matModels(r,c) = double(rand() % 10000) / 10 + c * 100;
+  for (int r=0; r<iQueries; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matQueries(r,c) = matModels(r*3,c) + double(rand() % 1000) / 10;
+
+  PiiSquaredGeometricDistance<const double*> squaredDistance;
+  PiiAbsDiffDistance<const double*> absDistance;
+  PiiGeometricDistance<const double*> geometricDistance;
+  PiiCosineDistance<const double*> cosineDistance;
+  typedef PiiDistanceMeasure<const double*> Measure;
+  Measure::Impl<PiiSquaredGeometricDistance<const double*> > polymorphicDistance;
+  QCOMPARE(int(polymorphicDistance.distanceForm()), int(PiiClassification::SquaredDifferenceSum));
+  QCOMPARE(int(Measure::Impl<PiiCosineDistance<const double*> >().distanceForm()),
+           int(PiiClassification::GenericDistance));
+
+  PiiQuantizedModelSet<PiiMatrix<double> > models;
+  QVERIFY(models.isEmpty());
+  QCOMPARE(models.findClosestMatch(matQueries[0], squaredDistance), -1);
+
+  const PiiClassification::ModelPrecision aPrecisions[] =
+    { PiiClassification::Int8Precision, PiiClassification::Float16Precision };
+  for (int p=0; p<2; ++p)
+    {
+      models.quantize(matModels, aPrecisions[p]);
+      QCOMPARE(models.precision(), aPrecisions[p]);
+      QCOMPARE(models.modelCount(), iModels);
+      QCOMPARE(models.featureCount(), iFeatures);
+      QCOMPARE(models.byteCount(), qint64(iModels) * iFeatures * (p + 1));
+
+      // Each feature spans 1000 units. The error is at most half a
+      // quantization step.
+      const double dMaxError = p == 0 ? 1000.0 / 255 / 2 : 1000.0 / 2048;
+      double adDecoded[iFeatures];
+      for (int r=0; r<iModels; r += 11)
+        {
+          models.decode(r, adDecoded);
+          for (int c=0; c<iFeatures; ++c)
+            QVERIFY(Pii::abs(adDecoded[c] - matModels(r,c)) <= dMaxError);
+        }
+
+      testQuantizedMatches(models, matModels, matQueries, squaredDistance);
+      testQuantizedMatches(models, matModels, matQueries, absDistance);
+      testQuantizedMatches(models, matModels, matQueries, geometricDistance);
+      testQuantizedMatches(models, matModels, matQueries, cosineDistance);
+      testQuantizedMatches(models, matModels, matQueries,
+                           static_cast<const Measure&>(polymorphicDistance));
+    }
+  models.quantize(matModels, PiiClassification::FullPrecision);
+  QVERIFY(models.isEmpty());
+
+  // The classifiers use the quantized models if requested.
+  PiiKnnClassifier<PiiMatrix<double> > knn;
+  QVector<double> vecLabels(iModels);
+  for (int r=0; r<iModels; ++r)
+    vecLabels[r] = r % 10;
+  knn.setModels(matModels);
+  knn.setClassLabels(vecLabels);
+  knn.setK(3);
+  QCOMPARE(knn.modelPrecision(), PiiClassification::FullPrecision);
+  QVERIFY(knn.quantizedModels().isEmpty());
+  knn.setModelPrecision(PiiClassification::Int8Precision);
+  QCOMPARE(knn.quantizedModels().modelCount(), iModels);
+  int iHits = 0;
+  for (int q=0; q<iQueries; ++q)
+    if (knn.classify(matQueries[q]) ==
+        PiiClassification::knnClassify(matQueries[q], matModels, vecLabels, squaredDistance, 3))
+      ++iHits;
+  QVERIFY(iHits >= iQueries * 9 / 10);
+  // New models are quantized automatically.
+  knn.setModels(matModels(0,0,100,-1));
+  QCOMPARE(knn.quantizedModels().modelCount(), 100);
+  knn.setModelPrecision(PiiClassification::FullPrecision);
+  QVERIFY(knn.quantizedModels().isEmpty());
+}
+
+void TestPiiClassification::somBatch()
+{
+  const int iSamples = 600, iFeatures = 3;
+  PiiMatrix<double> matSamples(iSamples, iFeatures);
+  for (int r=0; r<iSamples; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matSamples(r,c) = double(rand() % 1000) / 10;
+  // All code vectors start from a corner of the input space.
+  PiiMatrix<double> matInitial(matSamples(0,0,36,-1) / 100);
+
+  PiiSom<PiiMatrix<double> > sequentialSom(6,6), batchSom(6,6);
+  sequentialSom.setInitialRadius(3);
+  sequentialSom.setLearningLength(1500);
+  sequentialSom.setModels(matInitial);
+  batchSom.setInitialRadius(3);
+  batchSom.setLearningLength(1500);
+  batchSom.setModels(matInitial);
+  batchSom.setLearningAlgorithm(PiiClassification::SomBatchAlgorithm);
+
+  // With one sample per batch, the batch algorithm is the sequential
+  // one.
+  batchSom.setBatchSize(1);
+  sequentialSom.learn(matSamples, QVector<double>());
+  batchSom.learn(matSamples, QVector<double>());
+  QCOMPARE(batchSom.iterationNumber(), 1500);
+  QVERIFY(Pii::almostEqual(batchSom.models(), sequentialSom.models(), 1e-9));
+
+  // The result doesn't depend on the number of threads.
+  PiiSom<PiiMatrix<double> > parallelSom(6,6);
+  parallelSom.setInitialRadius(3);
+  parallelSom.setLearningLength(1500);
+  parallelSom.setLearningAlgorithm(PiiClassification::SomBatchAlgorithm);
+  parallelSom.setBatchSize(100);
+  parallelSom.setThreadCount(4);
+  QCOMPARE(parallelSom.batchSize(), 100);
+  QCOMPARE(parallelSom.threadCount(), 4);
+  parallelSom.setModels(matInitial);
+  parallelSom.learn(matSamples, QVector<double>());
+  batchSom.setBatchSize(100);
+  batchSom.setIterationNumber(0);
+  batchSom.setModels(matInitial);
+  batchSom.learn(matSamples, QVector<double>());
+  QVERIFY(Pii::equals(batchSom.models(), parallelSom.models()));
+
+  // Batch learning spreads the map over the input space about as
+  // well as sequential learning.
+  PiiSquaredGeometricDistance<const double*> measure;
+  double dInitialError = 0, dSequentialError = 0, dBatchError = 0;
+  for (int i=0; i<iSamples; ++i)
+    {
+      double dDistance;
+      PiiClassification::findClosestMatch(matSamples[i], matInitial, measure, &dDistance);
+      dInitialError += dDistance;
+      PiiClassification::findClosestMatch(matSamples[i], sequentialSom.models(), measure, &dDistance);
+      dSequentialError += dDistance;
+      PiiClassification::findClosestMatch(matSamples[i], parallelSom.models(), measure, &dDistance);
+      dBatchError += dDistance;
+    }
+  QVERIFY(dBatchError < dInitialError / 4);
+  QVERIFY(dBatchError < dSequentialError * 1.5);
+}
+
+void TestPiiClassification::vocabularyTree()
+{
+  srand(5);
+  PiiSquaredGeometricDistance<const float*> measure;
+  PiiVocabularyTree<PiiMatrix<float> > tree;
+  QVERIFY(tree.isEmpty());
+  QCOMPARE(tree.wordCount(), 0);
+
+  const int iModels = 3000, iFeatures = 16, iClusters = 30;
+  PiiMatrix<float> matCenters(iClusters, iFeatures);
+  for (int r=0; r<iClusters; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matCenters(r,c) = float(rand() % 1000);
+  PiiMatrix<float> matModels(iModels, iFeatures);
+  for (int r=0; r<iModels; ++r)
+    for (int c=0; c<iFeatures; ++c)
+      matModels(r,c) = matCenters(r % iClusters, c) + float(rand() % 100);
+  QCOMPARE(tree.quantize(matModels[0], measure), -1);
+
+  tree.setBranchingFactor(4);
+  tree.setLeafSize(20);
+  tree.buildTree(matModels, measure);
+  QVERIFY(!tree.isEmpty());
+  QCOMPARE(tree.modelCount(), iModels);
+  QVERIFY(tree.wordCount() >= iModels / 20);
+
+  // Each model sample is in exactly one word, and quantizing it
+  // yields that word.
+  QVector<int> vecWords(iModels, -1);
+  for (int w=0; w<tree.wordCount(); ++w)
+    {
+      QVERIFY(tree.wordSize(w) > 0);
+      QVERIFY(tree.wordSize(w) <= 20);
+      const int* pSamples = tree.wordSamples(w);
+      for (int i=0; i<tree.wordSize(w); ++i)
+        {
+          QCOMPARE(vecWords[pSamples[i]], -1);
+          vecWords[pSamples[i]] = w;
+          if (i > 0)
+            QVERIFY(pSamples[i-1] < pSamples[i]);
+        }
+    }
+  for (int r=0; r<iModels; ++r)
+    QCOMPARE(tree.quantize(matModels[r], measure), vecWords[r]);
+
+  // Words don't mix the clusters.
+  for (int w=0; w<tree.wordCount(); ++w)
+    for (int i=1; i<tree.wordSize(w); ++i)
+      QCOMPARE(tree.wordSamples(w)[i] % iClusters, tree.wordSamples(w)[0] % iClusters);
+
+  // Identical samples end up in a single word.
+  PiiMatrix<float> matSame(100, iFeatures);
+  matSame = 1;
+  tree.buildTree(matSame, measure);
+  QCOMPARE(tree.wordCount(), 1);
+  QCOMPARE(tree.wordSize(0), 100);
+  QCOMPARE(tree.quantize(matSame[50], measure), 0);
+}
+
 QTEST_MAIN(TestPiiClassification)
@@ -0,0 +1,364 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+/* Throughput benchmarks for the classifiers in the classification
+ * module. Each data row is tagged as
+ * `classifier-samples-features-function`, where *function* is the
+ * distance measure or kernel used. The data is created with fixed
+ * random seeds and is the same on every run.
+ *
+ * `classify` measures the time it takes to classify QueryCount
+ * samples with a classifier trained on *samples* samples. `learn`
+ * measures the time it takes to train a new classifier.
+ *
+ * The benchmarks are built with `qmake CONFIG+=benchmark`. Use the
+ * standard QtTest options to select rows and the output format:
+ *
+ * ~~~
+ * classificationbenchmark -xml -o results.xml
+ * classificationbenchmark -csv classify:knn-10000-128-squared
+ * ~~~
+ */
+
+#include "TestPiiClassificationBenchmark.h"
+
+#include <PiiVectorQuantizer.h>
+#include <PiiKnnClassifier.h>
+#include <PiiSom.h>
+#include <PiiKdTree.h>
+#include <PiiHnswIndex.h>
+#include <PiiBoostClassifier.h>
+#include <PiiDecisionStumpFactory.h>
+#include <PiiPerceptron.h>
+#include <PiiKernelPerceptron.h>
+#include <PiiKernelAdatron.h>
+#include <PiiSquaredGeometricDistance.h>
+#include <PiiAbsDiffDistance.h>
+#include <PiiChiSquaredDistance.h>
+#include <PiiGaussianKernel.h>
+#include <PiiPolynomialKernel.h>
+#include <PiiRandom.h>
+#include <PiiSmartPtr.h>
+#include <QtTest>
+
+typedef PiiMatrix<float> SampleSet;
+typedef const float* ConstFeatureIterator;
+
+enum
+{
+  QueryCount = 1000,
+  ClusterCount = 8,
+  SampleSeed = 1,
+  QuerySeed = 2
+};
+
+/* Creates *samples* feature vectors distributed around ClusterCount
+ * cluster centers in [0,1]^features. Odd clusters belong to class 1
+ * and even clusters to class 0. All features are positive because
+ * the chi squared distance is undefined if both features are zero.
+ */
+static SampleSet createSamples(int samples, int features, long seed, QVector<double>* labels = 0)
+{
+  // The centers don't depend on the seed.
+  Pii::seedRandom(0);
+  PiiMatrix<double> matCenters(Pii::uniformRandomMatrix(ClusterCount, features));
+  Pii::seedRandom(seed);
+  SampleSet matSamples(samples, features);
+  if (labels != 0)
+    labels->resize(samples);
+  for (int r=0; r<samples; ++r)
+    {
+      const int iCluster = int(Pii::uniformRandom() * ClusterCount) % ClusterCount;
+      for (int c=0; c<features; ++c)
+        matSamples(r,c) = float(qMax(0.001, matCenters(iCluster,c) + 0.1 * Pii::normalRandom()));
+      if (labels != 0)
+        (*labels)[r] = iCluster & 1;
+    }
+  return matSamples;
+}
+
+typedef PiiDistanceMeasure<ConstFeatureIterator> Measure;
+typedef PiiKernelFunction<ConstFeatureIterator> Kernel;
+
+static Measure* createMeasure(const QString& name)
+{
+  if (name == "squared")
+    return new Measure::Impl<PiiSquaredGeometricDistance<ConstFeatureIterator> >;
+  else if (name == "abs")
+    return new Measure::Impl<PiiAbsDiffDistance<ConstFeatureIterator> >;
+  else if (name == "chisquared")
+    return new Measure::Impl<PiiChiSquaredDistance<ConstFeatureIterator> >;
+  return 0;
+}
+
+static Kernel* createKernel(const QString& name)
+{
+  if (name == "gaussian")
+    return new Kernel::Impl<PiiGaussianKernel<ConstFeatureIterator> >;
+  else if (name == "polynomial")
+    return new Kernel::Impl<PiiPolynomialKernel<ConstFeatureIterator> >;
+  return 0;
+}
+
+// Classification results are stored here to keep the compiler from
+// optimizing the benchmark loops away.
+static volatile double dResultSink = 0;
+
+template <class Classifier> static void benchmarkClassify(Classifier& classifier, const SampleSet& queries)
+{
+  QBENCHMARK
+    {
+      double dSum = 0;
+      for (int i=0; i<queries.rows(); ++i)
+        dSum += classifier.classify(queries[i]);
+      dResultSink = dSum;
+    }
+}
+
+/* Adapts PiiKdTree to the classifier interface.
+ */
+struct KdTreeClassifier
+{
+  KdTreeClassifier(const SampleSet& models) : tree(models) {}
+  double classify(ConstFeatureIterator sample) { return tree.findClosestMatch(sample); }
+  PiiKdTree<SampleSet> tree;
+};
+
+static void addRows(const char* classifier,
+                    const int* sampleCounts, int sampleCountCount,
+                    const char* const* functions, int functionCount)
+{
+  static const int aiFeatureCounts[] = { 16, 128 };
+  for (int s=0; s<sampleCountCount; ++s)
+    for (int f=0; f<2; ++f)
+      for (int i=0; i<functionCount; ++i)
+        QTest::newRow(qPrintable(QString("%1-%2-%3-%4")
+                                 .arg(classifier)
+                                 .arg(sampleCounts[s])
+                                 .arg(aiFeatureCounts[f])
+                                 .arg(functions[i])))
+          << QString(classifier) << sampleCounts[s] << aiFeatureCounts[f] << QString(functions[i]);
+}
+
+template <class T, int N> static inline int countOf(const T (&)[N]) { return N; }
+
+static void addColumns()
+{
+  QTest::addColumn<QString>("classifier");
+  QTest::addColumn<int>("samples");
+  QTest::addColumn<int>("features");
+  QTest::addColumn<QString>("function");
+}
+
+static const int aiSampleCounts[] = { 1000, 10000 };
+// Kernel methods are quadratic in the number of samples.
+static const int aiKernelSampleCounts[] = { 500, 2000 };
+static const char* const apMeasures[] = { "squared", "abs", "chisquared" };
+static const char* const apSquared[] = { "squared" };
+static const char* const apKernels[] = { "gaussian", "polynomial" };
+static const char* const apNone[] = { "none" };
+
+void TestPiiClassificationBenchmark::classify_data()
+{
+  addColumns();
+  // Exhaustive nearest neighbor search
+  addRows("vq", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("knn", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  // Approximate and compressed search
+  addRows("hnsw", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("int8", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("float16", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("kdtree", aiSampleCounts, countOf(aiSampleCounts), apSquared, 1);
+  addRows("boost", aiSampleCounts, countOf(aiSampleCounts), apNone, 1);
+  addRows("perceptron", aiSampleCounts, countOf(aiSampleCounts), apNone, 1);
+  addRows("kernelperceptron", aiKernelSampleCounts, countOf(aiKernelSampleCounts), apKernels, countOf(apKernels));
+  addRows("kerneladatron", aiKernelSampleCounts, countOf(aiKernelSampleCounts), apKernels, countOf(apKernels));
+}
+
+void TestPiiClassificationBenchmark::classify()
+{
+  QFETCH(QString, classifier);
+  QFETCH(int, samples);
+  QFETCH(int, features);
+  QFETCH(QString, function);
+
+  QVector<double> vecLabels;
+  SampleSet matSamples(createSamples(samples, features, SampleSeed, &vecLabels));
+  SampleSet matQueries(createSamples(QueryCount, features, QuerySeed));
+
+  if (classifier == "vq" || classifier == "hnsw" ||
+      classifier == "int8" || classifier == "float16")
+    {
+      PiiVectorQuantizer<SampleSet> vq(createMeasure(function));
+      vq.setModels(matSamples);
+      if (classifier == "hnsw")
+        vq.buildIndex();
+      else if (classifier == "int8")
+        vq.setModelPrecision(PiiClassification::Int8Precision);
+      else if (classifier == "float16")
+        vq.setModelPrecision(PiiClassification::Float16Precision);
+      benchmarkClassify(vq, matQueries);
+    }
+  else if (classifier == "knn")
+    {
+      PiiKnnClassifier<SampleSet> knn;
+      knn.setDistanceMeasure(createMeasure(function));
+      knn.setModels(matSamples);
+      knn.setClassLabels(vecLabels);
+      knn.setK(5);
+      benchmarkClassify(knn, matQueries);
+    }
+  else if (classifier == "kdtree")
+    {
+      KdTreeClassifier tree(matSamples);
+      benchmarkClassify(tree, matQueries);
+    }
+  else if (classifier == "boost")
+    {
+      PiiDecisionStumpFactory<SampleSet> factory;
+      PiiBoostClassifier<SampleSet> boost(&factory);
+      boost.setMaxClassifiers(20);
+      boost.learn(matSamples, vecLabels);
+      benchmarkClassify(boost, matQueries);
+    }
+  else if (classifier == "perceptron")
+    {
+      PiiPerceptron<SampleSet> perceptron;
+      perceptron.setMaxIterations(20);
+      perceptron.learn(matSamples, vecLabels);
+      benchmarkClassify(perceptron, matQueries);
+    }
+  else if (classifier == "kernelperceptron")
+    {
+      PiiKernelPerceptron<SampleSet> perceptron;
+      perceptron.setKernelFunction(createKernel(function));
+      perceptron.setMaxIterations(20);
+      perceptron.learn(matSamples, vecLabels);
+      benchmarkClassify(perceptron, matQueries);
+    }
+  else if (classifier == "kerneladatron")
+    {
+      PiiKernelAdatron<SampleSet> adatron;
+      adatron.setKernelFunction(createKernel(function));
+      adatron.setMaxIterations(20);
+      adatron.learn(matSamples, vecLabels);
+      benchmarkClassify(adatron, matQueries);
+    }
+}
+
+void TestPiiClassificationBenchmark::learn_data()
+{
+  addColumns();
+  addRows("som", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("sombatch", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  // Building a search structure is the learning phase of a nearest
+  // neighbor classifier.
+  addRows("hnsw", aiSampleCounts, countOf(aiSampleCounts), apMeasures, countOf(apMeasures));
+  addRows("int8", aiSampleCounts, countOf(aiSampleCounts), apNone, 1);
+  addRows("kdtree", aiSampleCounts, countOf(aiSampleCounts), apSquared, 1);
+  addRows("boost", aiSampleCounts, countOf(aiSampleCounts), apNone, 1);
+  addRows("perceptron", aiSampleCounts, countOf(aiSampleCounts), apNone, 1);
+  addRows("kernelperceptron", aiKernelSampleCounts, countOf(aiKernelSampleCounts), apKernels, countOf(apKernels));
+  addRows("kerneladatron", aiKernelSampleCounts, countOf(aiKernelSampleCounts), apKernels, countOf(apKernels));
+}
+
+void TestPiiClassificationBenchmark::learn()
+{
+  QFETCH(QString, classifier);
+  QFETCH(int, samples);
+  QFETCH(int, features);
+  QFETCH(QString, function);
+
+  QVector<double> vecLabels;
+  SampleSet matSamples(createSamples(samples, features, SampleSeed, &vecLabels));
+
+  if (classifier == "som" || classifier == "sombatch")
+    {
+      QBENCHMARK
+        {
+          PiiSom<SampleSet> som(8, 8);
+          som.setDistanceMeasure(createMeasure(function));
+          som.setLearningLength(samples);
+          if (classifier == "sombatch")
+            som.setLearningAlgorithm(PiiClassification::SomBatchAlgorithm);
+          som.learn(matSamples, vecLabels);
+        }
+    }
+  else if (classifier == "hnsw")
+    {
+      PiiSmartPtr<Measure> pMeasure(createMeasure(function));
+      QBENCHMARK
+        {
+          PiiHnswIndex<SampleSet> index;
+          index.buildIndex(matSamples, *pMeasure);
+        }
+    }
+  else if (classifier == "int8")
+    {
+      QBENCHMARK
+        {
+          PiiQuantizedModelSet<SampleSet> models;
+          models.quantize(matSamples, PiiClassification::Int8Precision);
+        }
+    }
+  else if (classifier == "kdtree")
+    {
+      QBENCHMARK
+        {
+          PiiKdTree<SampleSet> tree(matSamples);
+        }
+    }
+  else if (classifier == "boost")
+    {
+      QBENCHMARK
+        {
+          PiiDecisionStumpFactory<SampleSet> factory;
+          PiiBoostClassifier<SampleSet> boost(&factory);
+          boost.setMaxClassifiers(20);
+          boost.learn(matSamples, vecLabels);
+        }
+    }
+  else if (classifier == "perceptron")
+    {
+      QBENCHMARK
+        {
+          PiiPerceptron<SampleSet> perceptron;
+          perceptron.setMaxIterations(20);
+          perceptron.learn(matSamples, vecLabels);
+        }
+    }
+  else if (classifier == "kernelperceptron")
+    {
+      QBENCHMARK
+        {
+          PiiKernelPerceptron<SampleSet> perceptron;
+          perceptron.setKernelFunction(createKernel(function));
+          perceptron.setMaxIterations(20);
+          perceptron.learn(matSamples, vecLabels);
+        }
+    }
+  else if (classifier == "kerneladatron")
+    {
+      QBENCHMARK
+        {
+          PiiKernelAdatron<SampleSet> adatron;
+          adatron.setKernelFunction(createKernel(function));
+          adatron.setMaxIterations(20);
+          adatron.learn(matSamples, vecLabels);
+        }
+    }
+}
+
+QTEST_MAIN(TestPiiClassificationBenchmark)
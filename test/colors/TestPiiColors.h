@@ -33,6 +33,10 @@ private slots:
   void rgbToFromYpbpr();
   void rgbToFromYcbcr();
   void autocorrelogram();
+  void colorMatchTable();
+  void vectorizedConversions();
+  void splitChannels();
+  void xyzToFromLab();
 };
 
 
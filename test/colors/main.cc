@@ -19,6 +19,7 @@
 #include <PiiColor.h>
 #include <QDebug>
 #include <PiiMatrixUtil.h>
+#include <PiiCpu.h>
 
 void TestPiiColors::sizeOf()
 {
@@ -222,6 +223,19 @@ void TestPiiColors::correctGamma()
       QCOMPARE(clr1.c1, clr2.c1);
       QCOMPARE(clr1.c2, clr2.c2);
     }
+
+  // Large images go through a lookup table
+  PiiMatrix<PiiColor<unsigned short> > matColors(1,30000);
+  for (int i=0; i<matColors.columns(); ++i)
+    matColors(0,i) = PiiColor<unsigned short>(i*2, 60000 - i, i);
+  PiiMatrix<PiiColor<unsigned short> > matCorrected(PiiColors::correctGamma(matColors, 1.0/2.2, 65535));
+  for (int i=0; i<matColors.columns(); ++i)
+    {
+      PiiColor<unsigned short> clr(PiiColors::correctGamma(matColors(0,i), 1.0/2.2, 65535));
+      QCOMPARE(matCorrected(0,i).c0, clr.c0);
+      QCOMPARE(matCorrected(0,i).c1, clr.c1);
+      QCOMPARE(matCorrected(0,i).c2, clr.c2);
+    }
 }
 
 void TestPiiColors::rgbToFromYpbpr()
@@ -307,6 +321,250 @@ void TestPiiColors::autocorrelogram()
   QVERIFY(Pii::almostEqual(c1, r1, 1e-6));
   QVERIFY(Pii::almostEqual(c2, r2, 1e-6));
   QVERIFY(Pii::almostEqual(PiiColors::autocorrelogram(Pii::matrix(Pii::transpose(input2)), 4), r2, 1e-6));
+
+  // Compare to a pixel-by-pixel reference. Short distances use
+  // shifted comparisons and long ones sliding histograms.
+  srand(4);
+  PiiMatrix<int> matImage(57, 43);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = rand() % 5; // 4 is out of range
+  QList<int> lstDistances = QList<int>() << 1 << 2 << 7 << 30;
+  PiiMatrix<double> matReference(1, 4 * lstDistances.size());
+  for (int d=0; d<lstDistances.size(); ++d)
+    {
+      const int iDist = lstDistances[d];
+      for (int r=0; r<matImage.rows(); ++r)
+        for (int c=0; c<matImage.columns(); ++c)
+          {
+            const int iCenter = matImage(r,c);
+            if (iCenter >= 4)
+              continue;
+            int iSum = 0, iCount = 0;
+            for (int y=r-iDist; y<=r+iDist; ++y)
+              for (int x=c-iDist; x<=c+iDist; ++x)
+                if (qMax(qAbs(y-r), qAbs(x-c)) == iDist &&
+                    y >= 0 && y < matImage.rows() && x >= 0 && x < matImage.columns())
+                  {
+                    ++iCount;
+                    if (matImage(y,x) == iCenter)
+                      ++iSum;
+                  }
+            if (iCount > 0)
+              matReference(0, d*4 + iCenter) += double(iSum) / iCount;
+          }
+    }
+  QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiColors::autocorrelogram(matImage, lstDistances, 4)),
+                           matReference, 1e-3));
+  QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiColors::autocorrelogram(matImage, lstDistances, 4,
+                                                                         PiiParallelPolicy(3, 4))),
+                           matReference, 1e-3));
+}
+
+template <class Clr> PiiMatrix<Clr> testColors(int rows, int columns, typename Clr::Type step)
+{
+  PiiMatrix<Clr> matColors(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      {
+        int i = r*columns + c;
+        matColors(r,c) = Clr(typename Clr::Type((i*37 % 256) * step),
+                             typename Clr::Type((i*101 % 256) * step),
+                             typename Clr::Type((i*53 % 256) * step));
+      }
+  // Pure grays and black
+  matColors(0,0) = Clr(0);
+  matColors(0,1) = Clr(typename Clr::Type(100 * step));
+  return matColors;
+}
+
+template <class Clr> bool sameAsScalar(const PiiMatrix<Clr>& image)
+{
+  const PiiMatrix<float> matConversion(3,3,
+                                       0.1, -0.7, 2.5,
+                                       1.0, 0.5, 0.25,
+                                       -1.5, 3.0, 0.0);
+  PiiMatrix<PiiColor<float> > matConverted(PiiColors::genericConversion(image, matConversion));
+  PiiMatrix<float> matY709(PiiColors::rgbToY709(image));
+  PiiMatrix<typename Clr::Type> matCh1, matCh2, matCh3, matCh4;
+  PiiColors::normalizedRgb(image, matCh1, matCh2, 255, 2, 0);
+
+  Pii::setCpuFeatureMask(0);
+  PiiMatrix<typename Clr::Type> matScalarCh1, matScalarCh2;
+  PiiColors::normalizedRgb(image, matScalarCh1, matScalarCh2, 255, 2, 0);
+  bool bSame = Pii::equals(matConverted, PiiColors::genericConversion(image, matConversion)) &&
+    Pii::almostEqual(matY709, PiiColors::rgbToY709(image), 1e-3f) &&
+    Pii::equals(matCh1, matScalarCh1) &&
+    Pii::equals(matCh2, matScalarCh2);
+  Pii::setCpuFeatureMask(-1);
+  return bSame;
+}
+
+void TestPiiColors::colorMatchTable()
+{
+  PiiMatrix<double> matBase(3,3,
+                            0.02, 0.005, 0.0,
+                            0.0, 0.03, 0.01,
+                            0.004, 0.0, 0.025);
+  PiiMatrix<double> matCenter(1,3, 100.0, 120.0, 140.0);
+
+  PiiMatrix<PiiColor<unsigned char> > matImage(17,23);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = PiiColor<unsigned char>((r*37 + c*11) & 0xff,
+                                              (r*5 + c*29 + 60) & 0xff,
+                                              (r*c*3 + 128) & 0xff);
+
+  // With eight bits, the cells are single colors.
+  PiiMatrix<float> matTable(PiiColors::createColorMatchTable(matBase, matCenter,
+                                                             PiiColors::LikelihoodFunction(), 8));
+  QCOMPARE(matTable.columns(), 1 << 24);
+  PiiMatrix<float> matExpected(PiiColors::matchColors(matImage, matBase, matCenter,
+                                                      PiiColors::LikelihoodFunction()));
+  QVERIFY(Pii::equals(PiiColors::lookupColors(matImage, matTable, 8), matExpected));
+
+  // With fewer bits, each pixel gets the value of its cell center.
+  matTable = PiiColors::createColorMatchTable(matBase, matCenter, PiiColors::LikelihoodFunction());
+  QCOMPARE(matTable.columns(), 1 << 15);
+  PiiMatrix<float> matLookup(PiiColors::lookupColors(matImage, matTable));
+  PiiMatrix<PiiColor<float> > matCenters(matImage.rows(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matCenters(r,c) = PiiColor<float>((matImage(r,c).rgbR & ~7) + 3.5f,
+                                        (matImage(r,c).rgbG & ~7) + 3.5f,
+                                        (matImage(r,c).rgbB & ~7) + 3.5f);
+  matExpected = PiiColors::matchColors(matCenters, matBase, matCenter, PiiColors::LikelihoodFunction());
+  QVERIFY(Pii::equals(matLookup, matExpected));
+
+  // Indexing is the same as in toIndexed(). toIndexed() maps 255 out
+  // of the range of the levels, so those pixels are skipped.
+  PiiMatrix<int> matIndexed(PiiColors::toIndexed(matImage, 32));
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      if (matImage(r,c).rgbR != 255 && matImage(r,c).rgbG != 255 && matImage(r,c).rgbB != 255)
+        QCOMPARE(matLookup(r,c), matTable(0, matIndexed(r,c)));
+}
+
+void TestPiiColors::vectorizedConversions()
+{
+  // Odd sizes exercise the scalar tails.
+  QVERIFY(sameAsScalar(testColors<PiiColor<unsigned char> >(3, 13, 1)));
+  QVERIFY(sameAsScalar(testColors<PiiColor4<unsigned char> >(4, 11, 1)));
+  QVERIFY(sameAsScalar(testColors<PiiColor<float> >(2, 7, 1.0f/255)));
+  QVERIFY(sameAsScalar(testColors<PiiColor4<float> >(5, 3, 1.0f/255)));
+
+  {
+    PiiMatrix<PiiColor<> > matRgb(testColors<PiiColor<> >(5, 25, 1));
+    PiiMatrix<PiiColor<> > matHsv(PiiColors::rgbToHsv(matRgb));
+    PiiMatrix<PiiColor<> > matYcbcr(PiiColors::rgbToYcbcr(matRgb));
+    PiiMatrix<PiiColor<> > matRgb2(PiiColors::ycbcrToRgb(matYcbcr));
+    for (int r=0; r<matRgb.rows(); ++r)
+      for (int c=0; c<matRgb.columns(); ++c)
+        {
+          PiiColor<> hsv(PiiColors::rgbToHsv(matRgb(r,c)));
+          QCOMPARE(matHsv(r,c).c0, hsv.c0);
+          QCOMPARE(matHsv(r,c).c1, hsv.c1);
+          QCOMPARE(matHsv(r,c).c2, hsv.c2);
+          // Single precision may round to the other direction.
+          PiiColor<> ycbcr(PiiColors::rgbToYcbcr(matRgb(r,c)));
+          QVERIFY(Pii::abs(int(matYcbcr(r,c).c0) - ycbcr.c0) <= 1);
+          QVERIFY(Pii::abs(int(matYcbcr(r,c).c1) - ycbcr.c1) <= 1);
+          QVERIFY(Pii::abs(int(matYcbcr(r,c).c2) - ycbcr.c2) <= 1);
+          QVERIFY(Pii::abs(int(matRgb(r,c).c0) - matRgb2(r,c).c0) < 2);
+          QVERIFY(Pii::abs(int(matRgb(r,c).c1) - matRgb2(r,c).c1) < 2);
+          QVERIFY(Pii::abs(int(matRgb(r,c).c2) - matRgb2(r,c).c2) < 2);
+        }
+  }
+  {
+    PiiMatrix<PiiColor4<> > matRgb(testColors<PiiColor4<> >(2, 9, 1));
+    PiiMatrix<PiiColor4<> > matHsv(PiiColors::rgbToHsv(matRgb));
+    for (int c=0; c<matRgb.columns(); ++c)
+      {
+        PiiColor4<> hsv(PiiColors::rgbToHsv(matRgb(1,c)));
+        QCOMPARE(matHsv(1,c).c0, hsv.c0);
+        QCOMPARE(matHsv(1,c).c1, hsv.c1);
+        QCOMPARE(matHsv(1,c).c2, hsv.c2);
+        QCOMPARE(matHsv(1,c).c3, uchar(0));
+      }
+  }
+  {
+    PiiMatrix<PiiColor<float> > matRgb(testColors<PiiColor<float> >(3, 6, 1));
+    PiiMatrix<PiiColor<float> > matYpbpr(PiiColors::rgbToYpbpr(matRgb));
+    PiiMatrix<PiiColor<float> > matRgb2(PiiColors::ypbprToRgb(matYpbpr));
+    for (int r=0; r<matRgb.rows(); ++r)
+      for (int c=0; c<matRgb.columns(); ++c)
+        {
+          PiiColor<float> ypbpr(PiiColors::rgbToYpbpr(matRgb(r,c)));
+          QVERIFY(Pii::abs(matYpbpr(r,c).c0 - ypbpr.c0) < 1e-3);
+          QVERIFY(Pii::abs(matYpbpr(r,c).c1 - ypbpr.c1) < 1e-3);
+          QVERIFY(Pii::abs(matYpbpr(r,c).c2 - ypbpr.c2) < 1e-3);
+          QVERIFY(Pii::abs(matRgb(r,c).c0 - matRgb2(r,c).c0) < 1e-3);
+          QVERIFY(Pii::abs(matRgb(r,c).c1 - matRgb2(r,c).c1) < 1e-3);
+          QVERIFY(Pii::abs(matRgb(r,c).c2 - matRgb2(r,c).c2) < 1e-3);
+        }
+  }
+}
+
+void TestPiiColors::splitChannels()
+{
+  PiiMatrix<PiiColor4<> > matColors(testColors<PiiColor4<> >(3, 10, 1));
+  matColors(2,9).c3 = 7;
+  PiiMatrix<unsigned char> matRed, matGreen, matBlue, matAlpha;
+  PiiMatrix<unsigned char>* channels[] = { &matRed, &matGreen, &matBlue, &matAlpha };
+  PiiColors::splitChannels(matColors, channels);
+  QCOMPARE(matRed.rows(), 3);
+  QCOMPARE(matRed.columns(), 10);
+  for (int r=0; r<matColors.rows(); ++r)
+    for (int c=0; c<matColors.columns(); ++c)
+      {
+        QCOMPARE(matRed(r,c), matColors(r,c).rgbR);
+        QCOMPARE(matGreen(r,c), matColors(r,c).rgbG);
+        QCOMPARE(matBlue(r,c), matColors(r,c).rgbB);
+        QCOMPARE(matAlpha(r,c), matColors(r,c).rgbaA);
+      }
+
+  PiiMatrix<PiiColor<float> > matFloat(testColors<PiiColor<float> >(2, 5, 0.5f));
+  PiiMatrix<float> matFloatGreen;
+  PiiMatrix<float>* floatChannels[] = { 0, &matFloatGreen, 0 };
+  PiiColors::splitChannels(matFloat, floatChannels);
+  for (int r=0; r<matFloat.rows(); ++r)
+    for (int c=0; c<matFloat.columns(); ++c)
+      QCOMPARE(matFloatGreen(r,c), matFloat(r,c).rgbG);
+}
+
+void TestPiiColors::xyzToFromLab()
+{
+  PiiColor<float> clrWhite(95.05f, 100.0f, 108.88f);
+  PiiMatrix<PiiColor<float> > matXyz(2,3);
+  matXyz(0,0) = clrWhite;
+  matXyz(0,1) = PiiColor<float>(0.5f, 0.4f, 0.3f);
+  matXyz(0,2) = PiiColor<float>(41.24f, 21.26f, 1.93f);
+  matXyz(1,0) = PiiColor<float>(35.76f, 71.52f, 11.92f);
+  matXyz(1,1) = PiiColor<float>(18.05f, 7.22f, 95.05f);
+  matXyz(1,2) = PiiColor<float>(120.0f, 50.0f, 30.0f);
+
+  PiiMatrix<PiiColor<float> > matLab(PiiColors::xyzToLab(matXyz, clrWhite));
+  // The white point maps to L = 100, a = b = 0
+  QVERIFY(Pii::abs(matLab(0,0).labL - 100.0f) < 1e-3);
+  QVERIFY(Pii::abs(matLab(0,0).labA) < 1e-3);
+  QVERIFY(Pii::abs(matLab(0,0).labB) < 1e-3);
+  // Pure sRGB red
+  QVERIFY(Pii::abs(matLab(0,2).labL - 53.24f) < 0.01);
+  QVERIFY(Pii::abs(matLab(0,2).labA - 80.09f) < 0.1);
+  QVERIFY(Pii::abs(matLab(0,2).labB - 67.20f) < 0.1);
+
+  PiiMatrix<PiiColor<float> > matXyz2(PiiColors::labToXyz(matLab, clrWhite));
+  for (int r=0; r<matXyz.rows(); ++r)
+    for (int c=0; c<matXyz.columns(); ++c)
+      {
+        PiiColor<float> lab(PiiColors::xyzToLab(matXyz(r,c), clrWhite));
+        QVERIFY(Pii::abs(matLab(r,c).labL - lab.labL) < 1e-3);
+        QVERIFY(Pii::abs(matLab(r,c).labA - lab.labA) < 1e-3);
+        QVERIFY(Pii::abs(matLab(r,c).labB - lab.labB) < 1e-3);
+        QVERIFY(Pii::almostEqualRel(matXyz(r,c).xyzX, matXyz2(r,c).xyzX, 1e-4f));
+        QVERIFY(Pii::almostEqualRel(matXyz(r,c).xyzY, matXyz2(r,c).xyzY, 1e-4f));
+        QVERIFY(Pii::almostEqualRel(matXyz(r,c).xyzZ, matXyz2(r,c).xyzZ, 1e-4f));
+      }
 }
 
 QTEST_MAIN(TestPiiColors)
@@ -0,0 +1,95 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiCpuDispatcher.h"
+
+#include <PiiCpuDispatcher.h>
+#include <QtTest>
+
+typedef int (*Function)();
+
+static int generic() { return 0; }
+static int sse2() { return 1; }
+static int avx2() { return 2; }
+static int sse2AndSse41() { return 3; }
+
+void TestPiiCpuDispatcher::selection()
+{
+  PiiCpuDispatcher<Function> dispatcher =
+    PiiCpuDispatcher<Function>(generic)
+    .add(Pii::CpuAvx2, avx2)
+    .add(Pii::CpuSse2 | Pii::CpuSse41, sse2AndSse41)
+    .add(Pii::CpuSse2, sse2);
+  QCOMPARE(dispatcher.count(), 3);
+
+  const int iFeatures = Pii::cpuFeatures();
+  int iExpected = 0;
+  if (iFeatures & Pii::CpuAvx2)
+    iExpected = 2;
+  else if ((iFeatures & (Pii::CpuSse2 | Pii::CpuSse41)) == (Pii::CpuSse2 | Pii::CpuSse41))
+    iExpected = 3;
+  else if (iFeatures & Pii::CpuSse2)
+    iExpected = 1;
+  QCOMPARE(dispatcher.function()(), iExpected);
+  // The cached choice must be the same.
+  QCOMPARE(dispatcher.function()(), iExpected);
+
+  // Null pointers are not registered.
+  dispatcher.add(Pii::CpuNeon, 0);
+  QCOMPARE(dispatcher.count(), 3);
+}
+
+void TestPiiCpuDispatcher::featureMask()
+{
+  const int iOriginalMask = Pii::cpuFeatureMask();
+  PiiCpuDispatcher<Function> dispatcher =
+    PiiCpuDispatcher<Function>(generic)
+    .add(Pii::CpuAvx2, avx2)
+    .add(Pii::CpuSse2, sse2);
+
+  Pii::setCpuFeatureMask(0);
+  QCOMPARE(dispatcher.function()(), 0);
+  QCOMPARE(dispatcher.selectedFeatures(), 0);
+
+  Pii::setCpuFeatureMask(Pii::CpuSse2);
+  if (Pii::hasCpuFeature(Pii::CpuSse2))
+    {
+      QCOMPARE(dispatcher.function()(), 1);
+      QCOMPARE(dispatcher.selectedFeatures(), int(Pii::CpuSse2));
+    }
+  else
+    QCOMPARE(dispatcher.function()(), 0);
+
+  Pii::setCpuFeatureMask(Pii::CpuAvx2 | Pii::CpuSse2);
+  if (Pii::hasCpuFeature(Pii::CpuAvx2))
+    QCOMPARE(dispatcher.function()(), 2);
+
+  Pii::setCpuFeatureMask(iOriginalMask);
+}
+
+void TestPiiCpuDispatcher::nullGeneric()
+{
+  const int iOriginalMask = Pii::cpuFeatureMask();
+  PiiCpuDispatcher<Function> dispatcher;
+  QVERIFY(dispatcher.function() == 0);
+  dispatcher.add(Pii::CpuSse2, sse2);
+  Pii::setCpuFeatureMask(0);
+  QVERIFY(dispatcher.function() == 0);
+  Pii::setCpuFeatureMask(iOriginalMask);
+  if (Pii::hasCpuFeature(Pii::CpuSse2))
+    QVERIFY(dispatcher.function() == sse2);
+}
+
+QTEST_MAIN(TestPiiCpuDispatcher)
@@ -17,6 +17,7 @@
 #define _TESTOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <QVector>
 
 class CounterOperation : public PiiDefaultOperation
 {
@@ -64,11 +65,45 @@ public:
   BufferOperation();
 
   QList<QPair<int,int> > lstData;
+  QList<QPair<qint64,qint64> > lstOriginTimes;
+  int iLargestBatch;
+  int iDelay;
 
 protected:
   void process();
 };
 
+class TableOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int tableSize READ tableSize WRITE setTableSize);
+  Q_PROPERTY(int offset READ offset WRITE setOffset);
+
+public:
+  TableOperation();
+
+  void setTableSize(int tableSize);
+  int tableSize() const { return _vecTable.size(); }
+  void setOffset(int offset) { _iOffset = offset; }
+  int offset() const { return _iOffset; }
+
+  int iSetterCalls;
+
+protected:
+  void process() {}
+  PreparedProperties* prepareProperties(PropertyList& properties);
+  void swapProperties(PreparedProperties* prepared);
+
+private:
+  struct PreparedTable : PreparedProperties
+  {
+    QVector<int> vecTable;
+  };
+
+  QVector<int> _vecTable;
+  int _iOffset;
+};
 
 
 #endif //_TESTOPERATION_H
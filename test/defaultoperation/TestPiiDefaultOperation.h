@@ -33,6 +33,17 @@ private slots:
   void metaProperties();
   void process();
   void process_data();
+  void unorderedEmission();
+  void unorderedEmission_data();
+  void statistics();
+  void statistics_data();
+  void profile();
+  void profile_data();
+  void batch();
+  void batch_data();
+  void latencyBudget();
+  void originTime();
+  void preparePropertySet();
 
 private:
   enum { sequenceLength = 2048 };
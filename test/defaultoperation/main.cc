@@ -16,8 +16,12 @@
 #include "TestPiiDefaultOperation.h"
 
 #include <QtTest>
+#include <QBuffer>
 
 #include <PiiYdinUtil.h>
+#include <PiiProfiler.h>
+#include <PiiDelay.h>
+#include <PiiTimer.h>
 
 CounterOperation::CounterOperation() :
   _iProp1(0),
@@ -38,17 +42,56 @@ void CounterOperation::process()
   outputAt(1)->emitObject(iValue*2);
 }
 
-BufferOperation::BufferOperation()
+BufferOperation::BufferOperation() :
+  iLargestBatch(0),
+  iDelay(0)
 {
   setObjectName("buffer");
   addSocket(new PiiInputSocket("input0"));
   addSocket(new PiiInputSocket("input1"));
+  setMaxBatchSize(64);
 }
 
 void BufferOperation::process()
 {
-  lstData << qMakePair(inputAt(0)->firstObject().valueAs<int>(),
-                       inputAt(1)->firstObject().valueAs<int>());
+  int iBatchSize = inputAt(0)->batchSize();
+  if (iBatchSize != inputAt(1)->batchSize())
+    PII_THROW(PiiExecutionException, "Mismatched batch sizes.");
+  for (int i=0; i<iBatchSize; ++i)
+    lstData << qMakePair(inputAt(0)->batchObject(i).valueAs<int>(),
+                         inputAt(1)->batchObject(i).valueAs<int>());
+  lstOriginTimes << qMakePair(inputAt(0)->originTime(), inputAt(1)->originTime());
+  iLargestBatch = qMax(iLargestBatch, iBatchSize);
+  if (iDelay > 0)
+    PiiDelay::msleep(iDelay);
+}
+
+TableOperation::TableOperation() :
+  iSetterCalls(0),
+  _iOffset(0)
+{}
+
+void TableOperation::setTableSize(int tableSize)
+{
+  ++iSetterCalls;
+  _vecTable.fill(0, tableSize);
+}
+
+PiiOperation::PreparedProperties* TableOperation::prepareProperties(PropertyList& properties)
+{
+  for (int i=0; i<properties.size(); ++i)
+    if (properties[i].first == "tableSize")
+      {
+        PreparedTable* pTable = new PreparedTable;
+        pTable->vecTable.fill(0, properties.takeAt(i).second.toInt());
+        return pTable;
+      }
+  return 0;
+}
+
+void TableOperation::swapProperties(PreparedProperties* prepared)
+{
+  qSwap(_vecTable, static_cast<PreparedTable*>(prepared)->vecTable);
 }
 
 void TestPiiDefaultOperation::initTestCase()
@@ -207,4 +250,314 @@ void TestPiiDefaultOperation::process_data()
     QTest::newRow(qPrintable(QString::number(i))) << i;
 }
 
+void TestPiiDefaultOperation::unorderedEmission()
+{
+  QFETCH(int, threadCount);
+
+  _pBuffer->lstData.clear();
+  _pCounter->setProperty("threadCount", threadCount);
+  for (int i=0; i<2; ++i)
+    _pCounter->outputAt(i)->setEmissionOrder(PiiOutputSocket::UnorderedEmission);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  bool bStopped = _engine.wait(PiiOperation::Stopped, 500);
+  for (int i=0; i<2; ++i)
+    _pCounter->outputAt(i)->setEmissionOrder(PiiOutputSocket::OrderedEmission);
+  QVERIFY(bStopped);
+
+  // Every object must arrive exactly once, but in any order.
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<int> lstFirst, lstSecond;
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      lstFirst << _pBuffer->lstData[i].first;
+      lstSecond << _pBuffer->lstData[i].second;
+    }
+  qSort(lstFirst);
+  qSort(lstSecond);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstFirst[i], i);
+      QCOMPARE(lstSecond[i], i*2);
+    }
+}
+
+void TestPiiDefaultOperation::unorderedEmission_data()
+{
+  QTest::addColumn<int>("threadCount");
+
+  QTest::newRow("0") << 0;
+  QTest::newRow("1") << 1;
+  QTest::newRow("4") << 4;
+}
+
+void TestPiiDefaultOperation::statistics()
+{
+  QFETCH(int, threadCount);
+
+  _pCounter->setProperty("threadCount", threadCount);
+  _engine.resetStatistics();
+  QVERIFY(_pCounter->statistics().isEmpty());
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 500));
+
+  QVariantMap mapStats(_engine.statistics());
+#ifndef PII_NO_OPERATION_STATISTICS
+  QVERIFY(mapStats.contains("counter"));
+  QVariantMap mapCounter(mapStats["counter"].toMap());
+  QVariantMap mapProcessing(mapCounter["processing"].toMap());
+  QCOMPARE(mapProcessing["count"].toInt(), int(sequenceLength));
+  QCOMPARE(mapProcessing["bins"].toList().size(), int(PiiOperationStatistics::BinCount));
+  qint64 iBinSum = 0;
+  foreach (QVariant varBin, mapProcessing["bins"].toList())
+    iBinSum += varBin.toLongLong();
+  QCOMPARE(iBinSum, qint64(sequenceLength));
+  QCOMPARE(mapCounter["emissionStall"].toMap()["count"].toInt(), int(sequenceLength));
+  // Every round except the first one in each processing slot was
+  // preceded by a wait.
+  int iWaitCount = mapCounter["inputWait"].toMap()["count"].toInt();
+  QVERIFY(iWaitCount <= int(sequenceLength) - 1);
+  QVERIFY(iWaitCount >= int(sequenceLength) - qMax(1, threadCount));
+
+  _pCounter->resetStatistics();
+  QVERIFY(_pCounter->statistics().isEmpty());
+#else
+  QVERIFY(mapStats.isEmpty());
+#endif
+}
+
+void TestPiiDefaultOperation::statistics_data()
+{
+  QTest::addColumn<int>("threadCount");
+
+  for (int i=0; i<=3; ++i)
+    QTest::newRow(qPrintable(QString::number(i))) << i;
+}
+
+void TestPiiDefaultOperation::profile()
+{
+  QFETCH(int, threadCount);
+
+  _pCounter->setProperty("threadCount", threadCount);
+  _engine.startProfiling(4*sequenceLength);
+  QVERIFY(_engine.isProfiling());
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 500));
+  _engine.stopProfiling();
+  QVERIFY(!_engine.isProfiling());
+
+  QVector<PiiProfiler::Event> vecEvents(_engine.profiler()->events());
+#ifndef PII_NO_OPERATION_STATISTICS
+  int iCounterRounds = 0;
+  for (int i=0; i<vecEvents.size(); ++i)
+    {
+      const PiiProfiler::Event& event = vecEvents[i];
+      QVERIFY(event.iStartTime <= event.iProcessedTime);
+      QVERIFY(event.iProcessedTime <= event.iEndTime);
+      if (event.pOperation == _pCounter)
+        {
+          ++iCounterRounds;
+          QCOMPARE(event.iEmittedCount, 2);
+        }
+    }
+  QCOMPARE(iCounterRounds, int(sequenceLength));
+
+  QBuffer trace;
+  trace.open(QIODevice::WriteOnly);
+  _engine.profiler()->writeChromeTrace(&trace);
+  QVERIFY(trace.data().startsWith("{\"displayTimeUnit\""));
+  QVERIFY(trace.data().contains("\"name\":\"counter\""));
+  QVERIFY(trace.data().trimmed().endsWith("]}"));
+#else
+  QVERIFY(vecEvents.isEmpty());
+#endif
+}
+
+void TestPiiDefaultOperation::profile_data()
+{
+  statistics_data();
+}
+
+void TestPiiDefaultOperation::batch()
+{
+  QFETCH(int, threadCount);
+  QFETCH(int, batchSize);
+
+  _pBuffer->setProperty("batchSize", 1000);
+  QCOMPARE(_pBuffer->property("batchSize").toInt(), 64);
+
+  _pBuffer->lstData.clear();
+  _pBuffer->iLargestBatch = 0;
+  _pBuffer->setProperty("threadCount", threadCount);
+  _pBuffer->setProperty("batchSize", batchSize);
+  _pBuffer->input("input0")->setQueueCapacity(batchSize);
+  _pBuffer->input("input1")->setQueueCapacity(batchSize);
+  _pCounter->setProperty("threadCount", 1);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  bool bStopped = _engine.wait(PiiOperation::Stopped, 1000);
+
+  _pBuffer->setProperty("batchSize", 1);
+  _pBuffer->input("input0")->setQueueCapacity(2);
+  _pBuffer->input("input1")->setQueueCapacity(2);
+  _pBuffer->setProperty("threadCount", 0);
+  QVERIFY(bStopped);
+
+  QVERIFY(_pBuffer->iLargestBatch >= 1);
+  QVERIFY(_pBuffer->iLargestBatch <= batchSize);
+  QCOMPARE(_pBuffer->lstData.size(), int(sequenceLength));
+  QList<QPair<int,int> > lstData(_pBuffer->lstData);
+  for (int i=0; i<sequenceLength; ++i)
+    {
+      QCOMPARE(lstData[i].first, i);
+      QCOMPARE(lstData[i].second, i*2);
+    }
+}
+
+void TestPiiDefaultOperation::batch_data()
+{
+  QTest::addColumn<int>("threadCount");
+  QTest::addColumn<int>("batchSize");
+
+  QTest::newRow("0, 1") << 0 << 1;
+  QTest::newRow("0, 8") << 0 << 8;
+  QTest::newRow("1, 1") << 1 << 1;
+  QTest::newRow("1, 8") << 1 << 8;
+  QTest::newRow("1, 64") << 1 << 64;
+}
+
+void TestPiiDefaultOperation::latencyBudget()
+{
+  QCOMPARE(_pBuffer->latencyBudget(), 0);
+  _pBuffer->setProperty("latencyBudget", -1);
+  QCOMPARE(_pBuffer->latencyBudget(), 0);
+
+  // The buffer can't keep up with the generator. Objects pile up in
+  // its input queues and exceed the engine-wide budget.
+  _pBuffer->lstData.clear();
+  _pBuffer->iDelay = 1;
+  _pBuffer->input("input0")->setQueueCapacity(256);
+  _pBuffer->input("input1")->setQueueCapacity(256);
+  _engine.setProperty("latencyBudget", 5);
+  QCOMPARE(_engine.latencyBudget(), 5);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  bool bStopped = _engine.wait(PiiOperation::Stopped, 3000);
+
+  _engine.setProperty("latencyBudget", 0);
+  _pBuffer->iDelay = 0;
+  _pBuffer->input("input0")->setQueueCapacity(2);
+  _pBuffer->input("input1")->setQueueCapacity(2);
+  QVERIFY(bStopped);
+
+  // Some objects must have been dropped, but the inputs must have
+  // been dropped together.
+  QList<QPair<int,int> > lstData(_pBuffer->lstData);
+  QVERIFY(lstData.size() > 0);
+  QVERIFY(lstData.size() < int(sequenceLength));
+  for (int i=0; i<lstData.size(); ++i)
+    {
+      QCOMPARE(lstData[i].second, lstData[i].first*2);
+      if (i > 0)
+        QVERIFY(lstData[i].first > lstData[i-1].first);
+    }
+}
+
+void TestPiiDefaultOperation::preparePropertySet()
+{
+  TableOperation op;
+  op.startPropertySet("recipe");
+  op.setProperty("tableSize", 256);
+  op.setProperty("offset", 5);
+  op.endPropertySet();
+  QCOMPARE(op.tableSize(), 0);
+
+  op.preparePropertySet("recipe");
+  // Nothing changes before the set is applied.
+  QCOMPARE(op.tableSize(), 0);
+  QCOMPARE(op.offset(), 0);
+
+  op.reconfigure("recipe");
+  QCOMPARE(op.tableSize(), 256);
+  QCOMPARE(op.offset(), 5);
+  // The prepared table was swapped in without calling the setter.
+  QCOMPARE(op.iSetterCalls, 0);
+
+  // The prepared state was consumed. Reapplying falls back to
+  // setting the properties one by one.
+  op.setProperty("tableSize", 1);
+  QCOMPARE(op.iSetterCalls, 1);
+  op.reconfigure("recipe");
+  QCOMPARE(op.tableSize(), 256);
+  QCOMPARE(op.iSetterCalls, 2);
+
+  // Removing a set discards its prepared state.
+  op.preparePropertySet("recipe");
+  op.removePropertySet("recipe");
+  op.setProperty("tableSize", 1);
+  op.reconfigure("recipe");
+  QCOMPARE(op.tableSize(), 1);
+}
+
+void TestPiiDefaultOperation::originTime()
+{
+  _pBuffer->lstOriginTimes.clear();
+  qint64 iStartTime = PiiTimer::timestamp();
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 3000));
+
+  // The generator is a source, and its rounds stamp the origin. The
+  // counter emits both of its outputs with the origin of its input.
+  QList<QPair<qint64,qint64> > lstOriginTimes(_pBuffer->lstOriginTimes);
+  QVERIFY(lstOriginTimes.size() > 0);
+  for (int i=0; i<lstOriginTimes.size(); ++i)
+    {
+      QVERIFY(lstOriginTimes[i].first >= iStartTime);
+      QCOMPARE(lstOriginTimes[i].second, lstOriginTimes[i].first);
+      if (i > 0)
+        QVERIFY(lstOriginTimes[i].first >= lstOriginTimes[i-1].first);
+    }
+  QVERIFY(lstOriginTimes.last().first <= PiiTimer::timestamp());
+}
+
 QTEST_MAIN(TestPiiDefaultOperation)
@@ -25,11 +25,16 @@ class TestPiiDsp : public QObject
 private slots:
   void fftShift();
   void fft();
+  void realFft();
+  void vectorizedFft();
+  void parallelFft();
   void correlation();
   void normalizedCorrelation();
   void convolution();
   void fastCorrelation();
   void findPeaks();
+  void streamingPeakDetector();
+  void dwt();
 };
 
 
@@ -17,7 +17,10 @@
 
 #include <PiiDsp.h>
 #include <PiiFft.h>
+#include <PiiWavelet.h>
+#include <PiiStreamingPeakDetector.h>
 #include <PiiMatrixUtil.h>
+#include <PiiCpu.h>
 #include <QtTest>
 #include <iostream>
 
@@ -130,6 +133,102 @@ void TestPiiDsp::fft()
   }
 }
 
+template <class T> PiiMatrix<T> testSignal(int rows, int columns)
+{
+  PiiMatrix<T> matResult(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      matResult(r,c) = T((r*7 + c*13) % 17) - T(8) + T(r) / T(columns);
+  return matResult;
+}
+
+template <class T> bool almostEqualComplex(const PiiMatrix<std::complex<T> >& a,
+                                           const PiiMatrix<std::complex<T> >& b,
+                                           T tolerance)
+{
+  return Pii::almostEqual(Pii::real(a), Pii::real(b), tolerance) &&
+    Pii::almostEqual(Pii::imag(a), Pii::imag(b), tolerance);
+}
+
+template <class T> bool realFftMatchesComplex(PiiFft<T>& fft, int rows, int columns, T tolerance)
+{
+  PiiMatrix<T> matSignal(testSignal<T>(rows, columns));
+  PiiMatrix<std::complex<T> > matComplex(Pii::matrix(matSignal.mapped(Pii::Cast<T,std::complex<T> >())));
+  PiiMatrix<std::complex<T> > matSpectrum(fft.forwardFft(matComplex));
+  PiiMatrix<std::complex<T> > matHalf(fft.forwardRealFft(matSignal));
+  return matHalf.rows() == rows && matHalf.columns() == columns/2 + 1 &&
+    almostEqualComplex(matHalf, PiiMatrix<std::complex<T> >(matSpectrum(0,0,rows,columns/2 + 1)), tolerance) &&
+    almostEqualComplex(fft.forwardFft(matSignal), matSpectrum, tolerance) &&
+    Pii::almostEqual(fft.inverseRealFft(matHalf, columns), matSignal, tolerance);
+}
+
+void TestPiiDsp::realFft()
+{
+  PiiFft<double> fft;
+  // Even and odd numbers of rows and columns, prime lengths
+  QVERIFY(realFftMatchesComplex(fft, 4, 8, 1e-10));
+  QVERIFY(realFftMatchesComplex(fft, 5, 6, 1e-10));
+  QVERIFY(realFftMatchesComplex(fft, 3, 7, 1e-10));
+  QVERIFY(realFftMatchesComplex(fft, 1, 16, 1e-10));
+  QVERIFY(realFftMatchesComplex(fft, 11, 1, 1e-10));
+  QVERIFY(realFftMatchesComplex(fft, 24, 20, 1e-10));
+  // Plans are reused
+  QVERIFY(realFftMatchesComplex(fft, 4, 8, 1e-10));
+
+  PiiFft<float> fftFloat;
+  QVERIFY(realFftMatchesComplex(fftFloat, 16, 32, 1e-3f));
+  QVERIFY(realFftMatchesComplex(fftFloat, 9, 10, 1e-3f));
+
+  QVERIFY(fft.forwardRealFft(PiiMatrix<double>()).isEmpty());
+  try
+    {
+      fft.inverseRealFft(PiiMatrix<std::complex<double> >(2,3), 6);
+      QFAIL("inverseRealFft() didn't throw an exception on invalid size.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
+void TestPiiDsp::vectorizedFft()
+{
+  // 512 = 8*8*8, 64 = 4*4*4, 32 = 4*8, 48 = 3*4*4
+  const int aSizes[] = { 512, 64, 32, 48, 6 };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      PiiMatrix<std::complex<double> > matDouble(Pii::matrix(testSignal<double>(3, aSizes[i]).mapped(Pii::Cast<double,std::complex<double> >())));
+      PiiMatrix<std::complex<float> > matFloat(Pii::matrix(testSignal<float>(aSizes[i], 5).mapped(Pii::Cast<float,std::complex<float> >())));
+      PiiFft<double> fftDouble;
+      PiiFft<float> fftFloat;
+      PiiMatrix<std::complex<double> > matVectorDouble(fftDouble.forwardFft(matDouble));
+      PiiMatrix<std::complex<float> > matVectorFloat(fftFloat.forwardFft(matFloat));
+      Pii::setCpuFeatureMask(0);
+      PiiMatrix<std::complex<double> > matScalarDouble(fftDouble.forwardFft(matDouble));
+      PiiMatrix<std::complex<float> > matScalarFloat(fftFloat.forwardFft(matFloat));
+      Pii::setCpuFeatureMask(-1);
+      QVERIFY(almostEqualComplex(matVectorDouble, matScalarDouble, 1e-10));
+      QVERIFY(almostEqualComplex(matVectorFloat, matScalarFloat, 1e-3f));
+    }
+}
+
+void TestPiiDsp::parallelFft()
+{
+  // Strips don't change the result. Minimum strip size one splits
+  // even small matrices.
+  PiiParallelPolicy policy(4, 1);
+  PiiFft<double> fft;
+  for (int iSize=5; iSize<=40; iSize += 7)
+    {
+      PiiMatrix<double> matSignal(testSignal<double>(iSize, iSize+3));
+      PiiMatrix<std::complex<double> > matComplex(Pii::matrix(matSignal.mapped(Pii::Cast<double,std::complex<double> >())));
+      PiiMatrix<std::complex<double> > matHalf(fft.forwardRealFft(matSignal));
+
+      QVERIFY(Pii::equals(fft.forwardFft(matSignal, policy), fft.forwardFft(matSignal)));
+      QVERIFY(Pii::equals(fft.forwardFft(matComplex, policy), fft.forwardFft(matComplex)));
+      QVERIFY(Pii::equals(fft.forwardRealFft(matSignal, policy), matHalf));
+      QVERIFY(Pii::equals(fft.inverseFft(matComplex, policy), fft.inverseFft(matComplex)));
+      QVERIFY(Pii::equals(fft.inverseRealFft(matHalf, iSize+3, policy), fft.inverseRealFft(matHalf, iSize+3)));
+    }
+}
+
 void TestPiiDsp::findPeaks()
 {
   try
@@ -330,6 +429,118 @@ void TestPiiDsp::fastCorrelation()
   peak = PiiDsp::findTranslation<double>(b(0,1,5,5), a(0,0,5,5));
   QCOMPARE(peak.row, 1);
   QCOMPARE(peak.column, 1);
+
+  // Reused plans, odd size
+  PiiFft<double> fft;
+  for (int i=0; i<2; ++i)
+    {
+      peak = PiiDsp::findTranslation<double>(fft, b(0,1,5,5), a(0,0,5,5));
+      QCOMPARE(peak.row, 1);
+      QCOMPARE(peak.column, 1);
+    }
+
+  PiiMatrix<double> matCorrelation(PiiDsp::fastCorrelation(a, b));
+  PiiMatrix<std::complex<double> > matComplexCorrelation(fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a),
+                                                                                                    Pii::conj(fft.forwardFft(b))))));
+  QVERIFY(Pii::almostEqual(matCorrelation, Pii::matrix(Pii::real(matComplexCorrelation)), 1e-10));
+}
+
+void TestPiiDsp::streamingPeakDetector()
+{
+  // Gaussian peaks on a rising baseline. The last one is cut off by
+  // the end of the signal.
+  const double adCenters[] = { 300.3, 1200.7, 2500.0, 4990.2 };
+  const int iLength = 5000;
+  PiiMatrix<double> matSignal(1, iLength);
+  for (int i=0; i<iLength; ++i)
+    {
+      matSignal(0,i) = 20 + 0.002 * i;
+      for (int p=0; p<4; ++p)
+        matSignal(0,i) += 50 * std::exp(-Pii::square(i - adCenters[p]) / 50);
+    }
+
+  for (int iChunk=1; iChunk<=1000; iChunk *= 10)
+    {
+      PiiDsp::StreamingPeakDetector detector(10, 5, 200);
+      QList<PiiDsp::Peak> lstPeaks;
+      for (int i=0; i<iLength; i+=iChunk)
+        {
+          const int iCount = qMin(iChunk, iLength - i);
+          QList<PiiDsp::Peak> lstChunkPeaks = detector.process(matSignal(0, i, 1, iCount));
+          for (int p=0; p<lstChunkPeaks.size(); ++p)
+            {
+              // Data indices are relative to the chunk.
+              QVERIFY(Pii::abs(lstChunkPeaks[p].position - (i + lstChunkPeaks[p].dataIndex)) <= 0.5);
+              lstPeaks << lstChunkPeaks[p];
+            }
+        }
+      QCOMPARE(lstPeaks.size(), 3);
+      QVERIFY(detector.isInPeak());
+      lstPeaks << detector.flush();
+      QCOMPARE(lstPeaks.size(), 4);
+      QCOMPARE(detector.sampleCount(), qint64(iLength));
+
+      for (int p=0; p<3; ++p)
+        {
+          QVERIFY(Pii::abs(lstPeaks[p].position - adCenters[p]) < 0.05);
+          // 50 above the baseline at the peak
+          QVERIFY(Pii::abs(lstPeaks[p].height - (70 + 0.002 * adCenters[p])) < 1.5);
+          QVERIFY(lstPeaks[p].width > 15 && lstPeaks[p].width < 30);
+        }
+      QVERIFY(Pii::abs(lstPeaks[3].position - adCenters[3]) < 0.05);
+    }
+}
+
+void TestPiiDsp::dwt()
+{
+  PiiMatrix<double> matImage(23,30);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = (r * 37 + c * 11 + r * c) % 256;
+
+  for (int member = 1; member <= 4; ++member)
+    {
+      QList<PiiMatrix<double> > lstFilters(PiiDsp::createScalingWavelets(PiiDsp::scalingFilter(PiiDsp::Daubechies, member)));
+      const PiiMatrix<double>& lo = lstFilters[0], hi = lstFilters[1];
+      PiiMatrix<double> loT(Pii::transpose(lo)), hiT(Pii::transpose(hi));
+
+      // Reference: full convolution followed by downsampling
+      PiiMatrix<double> matLo(PiiDsp::downSample(PiiDsp::convolution<double>(matImage, loT), Pii::Vertically, 1));
+      PiiMatrix<double> matHi(PiiDsp::downSample(PiiDsp::convolution<double>(matImage, hiT), Pii::Vertically, 1));
+      QList<PiiMatrix<double> > lstExpected;
+      lstExpected << PiiDsp::downSample(PiiDsp::convolution<double>(matLo, lo), Pii::Horizontally, 1)
+                  << PiiDsp::downSample(PiiDsp::convolution<double>(matLo, hi), Pii::Horizontally, 1)
+                  << PiiDsp::downSample(PiiDsp::convolution<double>(matHi, lo), Pii::Horizontally, 1)
+                  << PiiDsp::downSample(PiiDsp::convolution<double>(matHi, hi), Pii::Horizontally, 1);
+
+      QList<PiiMatrix<double> > lstBands(PiiDsp::dwt(matImage, PiiDsp::Daubechies, member));
+      QCOMPARE(lstBands.size(), 4);
+      for (int i=0; i<4; ++i)
+        {
+          QCOMPARE(lstBands[i].rows(), lstExpected[i].rows());
+          QCOMPARE(lstBands[i].columns(), lstExpected[i].columns());
+          QVERIFY(Pii::almostEqual(lstBands[i], lstExpected[i], 1e-10));
+        }
+
+      // A large enough buffer is reused.
+      PiiMatrix<double> matBuffer(40, 40);
+      const PiiMatrix<double>& matConstBuffer = matBuffer;
+      const double* pBuffer = matConstBuffer.row(0);
+      lstBands = PiiDsp::dwt(matImage, lo, hi, matBuffer);
+      QVERIFY(matConstBuffer.row(0) == pBuffer);
+      const PiiMatrix<double> matApproximation(lstBands[0]);
+      QVERIFY(matApproximation.row(0) == pBuffer);
+      for (int i=0; i<4; ++i)
+        QVERIFY(Pii::almostEqual(lstBands[i], lstExpected[i], 1e-10));
+
+      // Writing to a buffer that is still in use detaches it.
+      QList<PiiMatrix<double> > lstSecond(PiiDsp::dwt(lstBands[0], lo, hi, matBuffer));
+      for (int i=0; i<4; ++i)
+        QVERIFY(Pii::almostEqual(lstBands[i], lstExpected[i], 1e-10));
+      QVERIFY(Pii::almostEqual(lstSecond[3], PiiDsp::dwt(lstExpected[0], lo, hi)[3], 1e-10));
+    }
+
+  QVERIFY(PiiDsp::dwt(PiiMatrix<double>())[0].isEmpty());
 }
 
 QTEST_MAIN(TestPiiDsp)
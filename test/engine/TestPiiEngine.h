@@ -24,6 +24,7 @@ class TestPiiEngine : public QObject
 
 private slots:
   void usedPluginLibraryNames();
+  void pluginIndex();
 };
 
 #endif //_TESTPIIENGINE_H
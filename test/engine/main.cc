@@ -31,4 +31,36 @@ void TestPiiEngine::usedPluginLibraryNames()
   QCOMPARE(e.usedPluginLibraryNames(), QStringList() << "piibase" << "piiflowcontrol");
 }
 
+void TestPiiEngine::pluginIndex()
+{
+  PiiEngine::loadPlugin("piibase");
+  PiiEngine::loadPlugin("piiflowcontrol");
+  PiiEngine::savePluginIndex("plugins.idx");
+  PiiEngine::loadPluginIndex("plugins.idx");
+  QCOMPARE(PiiEngine::indexedPlugin("PiiClock"), QString("piibase"));
+  QCOMPARE(PiiEngine::indexedPlugin("PiiPisoOperation"), QString("piiflowcontrol"));
+  QVERIFY(PiiEngine::indexedPlugin("NoSuchOperation").isEmpty());
+
+  {
+    PiiEngine e;
+    e.createOperation("PiiClock");
+    e.save("clock.cft");
+  }
+  PiiEngine* pEngine = PiiEngine::load("clock.cft");
+  QVERIFY(pEngine != 0);
+  QCOMPARE(pEngine->childCount(), 1);
+  delete pEngine;
+
+  QVariantMap mapTimes(PiiEngine::lastLoadTimes());
+  QVERIFY(mapTimes.contains("total"));
+  QVERIFY(mapTimes["total"].toLongLong() >= mapTimes["config"].toLongLong());
+  // Both plug-ins were already loaded.
+  QVERIFY(mapTimes["pluginTimes"].toMap().isEmpty());
+
+  PiiEngine::clearPluginIndex();
+  QVERIFY(PiiEngine::indexedPlugin("PiiClock").isEmpty());
+  QFile::remove("plugins.idx");
+  QFile::remove("clock.cft");
+}
+
 QTEST_MAIN(TestPiiEngine)
@@ -0,0 +1,62 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIIENGINEBENCHMARK_H
+#define _TESTPIIENGINEBENCHMARK_H
+
+#include <QObject>
+#include <QVector>
+#include <QAtomicInt>
+#include <PiiVariant.h>
+
+class PiiEngine;
+class PiiOperation;
+
+/**
+ * Reference pipelines for measuring the performance of the whole
+ * engine. Each pipeline is driven by PiiLineScanEmulator at a trigger
+ * rate higher than the pipeline can sustain, and it reports frames
+ * per second, latency percentiles, CPU time per frame and peak memory
+ * usage. The number of measured frames can be changed with the
+ * `PII_BENCHMARK_FRAMES` environment variable.
+ */
+class TestPiiEngineBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  TestPiiEngineBenchmark();
+
+private slots:
+  void initTestCase();
+  void inspectionPipeline();
+  void texturePipeline();
+
+protected slots:
+  void recordFrame();
+  void recordResult();
+
+private:
+  PiiOperation* createCamera(PiiEngine& engine);
+  PiiOperation* createClassifier(PiiEngine& engine, int features, int models);
+  void measure(PiiEngine& engine, PiiOperation* camera,
+               PiiOperation* sink, const QString& output);
+
+  int _iFrameCount;
+  QVector<qint64> _vecFrameTimes, _vecResultTimes;
+  QAtomicInt _iFrameIndex, _iResultIndex;
+};
+
+#endif //_TESTPIIENGINEBENCHMARK_H
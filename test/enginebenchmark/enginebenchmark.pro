@@ -0,0 +1,2 @@
+include(../unit_test.pri)
+win32: LIBS += -lpsapi
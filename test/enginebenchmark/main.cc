@@ -0,0 +1,255 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiEngineBenchmark.h"
+
+#include <QtTest>
+
+#include <PiiEngine.h>
+#include <PiiProbeInput.h>
+#include <PiiLatencyHistogram.h>
+#include <PiiRandom.h>
+#include <PiiTimer.h>
+
+#include <cstdlib>
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#  include <psapi.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+namespace
+{
+  const int iWarmupCount = 10;
+
+  // Returns the CPU time used by all threads of this process in
+  // microseconds.
+  qint64 processCpuTime()
+  {
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+      return 0;
+    return ((qint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) +
+            (qint64(user.dwHighDateTime) << 32 | user.dwLowDateTime)) / 10;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+  }
+
+  // Returns the peak resident memory of this process in kilobytes.
+  qint64 peakMemoryUsage()
+  {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return 0;
+    return qint64(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#  ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024; // bytes
+#  else
+    return usage.ru_maxrss;
+#  endif
+#endif
+  }
+}
+
+TestPiiEngineBenchmark::TestPiiEngineBenchmark() :
+  _iFrameCount(300)
+{
+  int iFrames = qgetenv("PII_BENCHMARK_FRAMES").toInt();
+  if (iFrames > 0)
+    _iFrameCount = iFrames;
+}
+
+void TestPiiEngineBenchmark::initTestCase()
+{
+  try
+    {
+      PiiEngine::loadPlugins(QStringList() <<
+                             "piicamera" <<
+                             "piicameraemulator" <<
+                             "piiimage" <<
+                             "piitexture" <<
+                             "piiclassification");
+    }
+  catch (PiiLoadException& ex)
+    {
+      QSKIP(qPrintable(ex.message()));
+    }
+}
+
+PiiOperation* TestPiiEngineBenchmark::createCamera(PiiEngine& engine)
+{
+  PiiOperation* pCamera = engine.createOperation("PiiCameraOperation", "camera");
+  pCamera->setProperty("driverName", "PiiLineScanEmulator");
+  pCamera->setProperty("cameraId", "0");
+  pCamera->setProperty("driver.frameSize", QSize(1024, 512));
+  // Faster than any of the pipelines. The camera blocks when the
+  // pipeline is full, so the slowest stage sets the frame rate.
+  pCamera->setProperty("driver.triggerRate", 100000.0);
+  return pCamera;
+}
+
+PiiOperation* TestPiiEngineBenchmark::createClassifier(PiiEngine& engine, int features, int models)
+{
+  // Random normalized histograms in five classes.
+  PiiMatrix<float> matModels(Pii::uniformRandomMatrix(models, features));
+  QVariantList lstLabels;
+  for (int r=0; r<models; ++r)
+    {
+      float* pRow = matModels[r];
+      float fSum = 0;
+      for (int c=0; c<features; ++c)
+        fSum += pRow[c];
+      for (int c=0; c<features; ++c)
+        pRow[c] /= fSum;
+      lstLabels << r % 5;
+    }
+  PiiOperation* pClassifier = engine.createOperation("PiiKnnClassifierOperation<float>", "classifier");
+  pClassifier->setProperty("k", 5);
+  pClassifier->setProperty("models", Pii::createQVariant(matModels));
+  pClassifier->setProperty("classLabels", lstLabels);
+  return pClassifier;
+}
+
+void TestPiiEngineBenchmark::inspectionPipeline()
+{
+  // camera -> filter -> threshold -> labeling -> properties
+  //                 \-> histogram -> classifier
+  PiiEngine engine;
+  PiiOperation* pCamera = createCamera(engine);
+
+  PiiOperation* pFilter = engine.createOperation("PiiImageFilterOperation", "filter");
+  pFilter->setProperty("filterName", "gaussian");
+  pFilter->setProperty("filterSize", 5);
+
+  PiiOperation* pThreshold = engine.createOperation("PiiThresholdingOperation", "threshold");
+  pThreshold->setProperty("thresholdType", "OtsuThreshold");
+
+  PiiOperation* pLabeling = engine.createOperation("PiiLabelingOperation", "labeling");
+  PiiOperation* pProperties = engine.createOperation("PiiObjectPropertyExtractor", "properties");
+
+  // Classifies the frames by their gray-level distribution.
+  PiiOperation* pHistogram = engine.createOperation("PiiHistogramOperation", "histogram");
+  pHistogram->setProperty("normalized", true);
+  PiiOperation* pClassifier = createClassifier(engine, 256, 100);
+
+  QVERIFY(pCamera->connectOutput("image", pFilter, "image"));
+  QVERIFY(pFilter->connectOutput("image", pThreshold, "image"));
+  QVERIFY(pThreshold->connectOutput("image", pLabeling, "image"));
+  QVERIFY(pLabeling->connectOutput("image", pProperties, "image"));
+  QVERIFY(pLabeling->connectOutput("labels", pProperties, "labels"));
+  QVERIFY(pFilter->connectOutput("image", pHistogram, "image"));
+  QVERIFY(pHistogram->connectOutput("red", pClassifier, "features"));
+
+  measure(engine, pCamera, pClassifier, "classification");
+}
+
+void TestPiiEngineBenchmark::texturePipeline()
+{
+  // camera -> LBP -> kNN
+  PiiEngine engine;
+  PiiOperation* pCamera = createCamera(engine);
+
+  PiiOperation* pLbp = engine.createOperation("PiiLbpOperation", "lbp");
+  pLbp->setProperty("parameters", QStringList() << "8,1,Uniform");
+  pLbp->setProperty("outputType", "NormalizedHistogramOutput");
+
+  // 59 uniform patterns
+  PiiOperation* pClassifier = createClassifier(engine, 59, 500);
+
+  QVERIFY(pCamera->connectOutput("image", pLbp, "image"));
+  QVERIFY(pLbp->connectOutput("features", pClassifier, "features"));
+
+  measure(engine, pCamera, pClassifier, "classification");
+}
+
+void TestPiiEngineBenchmark::measure(PiiEngine& engine, PiiOperation* camera,
+                                     PiiOperation* sink, const QString& output)
+{
+  const int iTotal = iWarmupCount + _iFrameCount;
+  _vecFrameTimes.fill(0, iTotal);
+  _vecResultTimes.fill(0, iTotal);
+  _iFrameIndex.storeRelease(0);
+  _iResultIndex.storeRelease(0);
+
+  PiiProbeInput frameProbe(camera->output("image"), this, SLOT(recordFrame()), Qt::DirectConnection);
+  PiiProbeInput resultProbe(sink->output(output), this, SLOT(recordResult()), Qt::DirectConnection);
+
+  try
+    {
+      engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  qint64 iCpuStart = 0;
+  PiiTimer timer;
+  bool bWarm = false;
+  while (_iResultIndex.loadAcquire() < iTotal && timer.seconds() < 60)
+    {
+      if (!bWarm && _iResultIndex.loadAcquire() >= iWarmupCount)
+        {
+          iCpuStart = processCpuTime();
+          bWarm = true;
+        }
+      QCoreApplication::processEvents();
+    }
+  const qint64 iCpuTime = processCpuTime() - iCpuStart;
+  engine.interrupt();
+  engine.wait(PiiOperation::Stopped, 5000);
+
+  QVERIFY2(_iResultIndex.loadAcquire() >= iTotal, "The pipeline did not produce all results in time.");
+
+  PiiLatencyHistogram latencies;
+  for (int i=iWarmupCount; i<iTotal; ++i)
+    latencies.add(_vecResultTimes[i] - _vecFrameTimes[i]);
+  const qint64 iElapsed = qMax(qint64(1), _vecResultTimes[iTotal-1] - _vecResultTimes[iWarmupCount-1]);
+  const double dFps = _iFrameCount * 1e6 / iElapsed;
+
+  qDebug("%.1f frames/s, latency median %lld us, 90%% %lld us, 99%% %lld us, max %lld us, "
+         "CPU %.0f us/frame, peak memory %lld kB",
+         dFps, latencies.percentile(0.5), latencies.percentile(0.9), latencies.percentile(0.99),
+         latencies.max(), double(iCpuTime) / _iFrameCount, peakMemoryUsage());
+  QTest::setBenchmarkResult(dFps, QTest::FramesPerSecond);
+}
+
+void TestPiiEngineBenchmark::recordFrame()
+{
+  int iIndex = _iFrameIndex.fetchAndAddOrdered(1);
+  if (iIndex < _vecFrameTimes.size())
+    _vecFrameTimes[iIndex] = PiiTimer::timestamp();
+}
+
+void TestPiiEngineBenchmark::recordResult()
+{
+  int iIndex = _iResultIndex.fetchAndAddOrdered(1);
+  if (iIndex < _vecResultTimes.size())
+    _vecResultTimes[iIndex] = PiiTimer::timestamp();
+}
+
+QTEST_MAIN(TestPiiEngineBenchmark)
@@ -25,6 +25,7 @@ class TestPiiFeatureCombiner : public PiiOperationTest
 private slots:
   void initTestCase();
   void process();
+  void normalize();
 };
 
 
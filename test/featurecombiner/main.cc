@@ -95,6 +95,37 @@ void TestPiiFeatureCombiner::process()
   QCOMPARE(lstDistanceWeights[0], 1.125);
   QCOMPARE(lstDistanceWeights[1], 4.5);
   QCOMPARE(lstDistanceWeights[2], 0.5);
+
+  QVERIFY(stop());
+}
+
+void TestPiiFeatureCombiner::normalize()
+{
+  operation()->setProperty("learningBatchSize", 0);
+  operation()->setProperty("normalizationOffset", Pii::createQVariant(PiiMatrix<double>(1,6, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0)));
+  operation()->setProperty("normalizationScale", Pii::createQVariant(PiiMatrix<double>(1,6, 1.0, 2.0, 1.0, 2.0, 1.0, 2.0)));
+
+  QVERIFY(start());
+  QVERIFY(sendObject("features0", PiiMatrix<int>(1,2, 1,2)));
+  QVERIFY(sendObject("features1", 3.0));
+  QVERIFY(sendObject("features2", PiiMatrix<int>(1,3, 4,5,6)));
+  QVERIFY(Pii::equals(outputValue("features", PiiMatrix<double>()), PiiMatrix<double>(1,6, 0.0, 2.0, 2.0, 6.0, 4.0, 10.0)));
+  QVERIFY(Pii::equals(outputValue("boundaries", PiiMatrix<int>()), PiiMatrix<int>(1,3, 2,3,6)));
+  QVERIFY(stop());
+
+  // Pick the first and the last normalized feature
+  PiiMatrix<double> matProjection(2,6);
+  matProjection(0,0) = 1;
+  matProjection(1,5) = 1;
+  operation()->setProperty("projection", Pii::createQVariant(matProjection));
+
+  QVERIFY(start());
+  QVERIFY(sendObject("features0", PiiMatrix<int>(1,2, 1,2)));
+  QVERIFY(sendObject("features1", 3.0f));
+  QVERIFY(sendObject("features2", PiiMatrix<int>(1,3, 4,5,6)));
+  QVERIFY(Pii::equals(outputValue("features", PiiMatrix<float>()), PiiMatrix<float>(1,2, 0.0, 10.0)));
+  QVERIFY(Pii::equals(outputValue("boundaries", PiiMatrix<int>()), PiiMatrix<int>(1,1, 2)));
+  QVERIFY(stop());
 }
 
 QTEST_MAIN(TestPiiFeatureCombiner)
@@ -19,7 +19,9 @@
 #include <QThread>
 #include <QObject>
 #include <QIODevice>
+#include <PiiFifoBuffer.h>
 #include <cstdlib>
+#include <cstring>
 
 #define BUFFERSIZE 1024
 
@@ -95,6 +97,38 @@ protected:
   }
 };
 
+// Writes in place without copying through writeData().
+class PeekWriter : public RWBase
+{
+public:
+  PeekWriter(PiiFifoBuffer* buffer) : RWBase(buffer), _pBuffer(buffer) {}
+
+protected:
+  void run()
+  {
+    while (_iIndex < _iBufferSize)
+      {
+        char* pData;
+        int iBytes = int(_pBuffer->peekWrite(&pData));
+        if (iBytes == 0)
+          {
+            qCritical("No space available!");
+            break;
+          }
+        if (iBytes > _iBlockSize)
+          iBytes = _iBlockSize;
+        if (iBytes > _iBufferSize - _iIndex)
+          iBytes = _iBufferSize - _iIndex;
+        std::memcpy(pData, _array + _iIndex, iBytes);
+        _pBuffer->commitWrite(iBytes);
+        _iIndex += iBytes;
+      }
+    _pBuffer->finishWriting();
+  }
+
+private:
+  PiiFifoBuffer* _pBuffer;
+};
 
 class TestPiiFifoBuffer : public QObject
 {
@@ -105,6 +139,8 @@ private slots:
   void oneThread_data();
   void twoThreads();
   void twoThreads_data();
+  void peekAndCommit();
+  void peekAndCommit_data();
 };
 
 #endif //_TESTPIIFIFOBUFFER_H
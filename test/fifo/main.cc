@@ -111,4 +111,48 @@ void TestPiiFifoBuffer::twoThreads_data()
   QTest::newRow("103,103,103") << 103 << 103 << 103;
 }
 
+void TestPiiFifoBuffer::peekAndCommit()
+{
+  QFETCH(int, bufferSize);
+  QFETCH(int, writerBlock);
+  QFETCH(int, readerBlock);
+
+  PiiFifoBuffer bfr(bufferSize);
+  bfr.setWaitTime(500);
+  PeekWriter w(&bfr);
+  w.setBlockSize(writerBlock);
+  w.start();
+
+  unsigned char read[BUFFERSIZE];
+  int iIndex = 0;
+  const char* pData;
+  while (qint64 iBytes = bfr.peekRead(&pData))
+    {
+      // A region never wraps around the end of the buffer.
+      QVERIFY(iBytes <= bufferSize);
+      iBytes = qMin(iBytes, qint64(readerBlock));
+      QVERIFY(iIndex + iBytes <= BUFFERSIZE);
+      std::memcpy(read + iIndex, pData, iBytes);
+      bfr.commitRead(iBytes);
+      iIndex += int(iBytes);
+    }
+  w.wait();
+  QCOMPARE(iIndex, BUFFERSIZE);
+  QCOMPARE(bfr.pos(), qint64(BUFFERSIZE));
+  QVERIFY(bfr.atEnd());
+  QVERIFY(std::memcmp(w.getArray(), read, BUFFERSIZE) == 0);
+}
+
+void TestPiiFifoBuffer::peekAndCommit_data()
+{
+  QTest::addColumn<int>("bufferSize");
+  QTest::addColumn<int>("writerBlock");
+  QTest::addColumn<int>("readerBlock");
+
+  QTest::newRow("16,1,1") << 16 << 1 << 1;
+  QTest::newRow("59,2,1") << 59 << 2 << 1;
+  QTest::newRow("7,9,15") << 7 << 9 << 15;
+  QTest::newRow("103,103,103") << 103 << 103 << 103;
+}
+
 QTEST_MAIN(TestPiiFifoBuffer)
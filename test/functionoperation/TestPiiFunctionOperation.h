@@ -22,6 +22,7 @@
 #ifdef PII_CXX11
 double sum(double a, int b);
 void sum2(double a, int b, int* c);
+void scale(PiiMatrix<int>& matrix, int factor);
 
 class SumTestOperation : public PII_FUNCTION_OP_FOR(sum)
 {
@@ -50,6 +51,15 @@ public:
   void checkSockets();
 };
 
+class ScaleTestOperation : public PII_FUNCTION_OP_FOR(scale)
+{
+  Q_OBJECT
+public:
+  typedef PII_FUNCTION_OP_FOR(scale) SuperType;
+  ScaleTestOperation() :
+    SuperType(scale, inPlace<PiiMatrix<int>&>("matrix", "matrix"), "factor") {}
+};
+
 #endif
 
 class TestPiiFunctionOperation : public PiiOperationTest
@@ -64,6 +74,8 @@ private slots:
   void sum2Operation();
   void setDefaultValue();
   void socketAt();
+  void inPlace();
+  void benchmark();
 
 protected:
   void cleanup();
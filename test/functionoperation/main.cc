@@ -19,6 +19,7 @@
 
 double sum(double a, int b) { return a + b; }
 void sum2(double a, int b, int* c) { *c = a + b; }
+void scale(PiiMatrix<int>& matrix, int factor) { matrix *= factor; }
 
 void SumTestOperation::checkSockets()
 {
@@ -121,6 +122,43 @@ void TestPiiFunctionOperation::socketAt()
   s2.checkSockets();
 }
 
+void TestPiiFunctionOperation::inPlace()
+{
+  setOperation(new ScaleTestOperation);
+  QCOMPARE(operation()->inputCount(), 2);
+  QCOMPARE(operation()->outputCount(), 1);
+
+  QVERIFY(connectInput("matrix"));
+  QVERIFY(connectInput("factor"));
+  QVERIFY(start());
+
+  PiiMatrix<int> matInput(1, 3, 1, 2, 3);
+  QVERIFY(sendObject("matrix", matInput));
+  QVERIFY(sendObject("factor", 2));
+  QVERIFY(Pii::equals(outputValue("matrix", PiiMatrix<int>()), PiiMatrix<int>(1, 3, 2, 4, 6)));
+  // The input object must not change.
+  QCOMPARE(matInput(0,2), 3);
+}
+
+void TestPiiFunctionOperation::benchmark()
+{
+  setOperation(new SumTestOperation);
+  connectAllInputs();
+
+  BenchmarkOptions options;
+  options.iObjectCount = 100;
+  options.lstThreadCounts << 0 << 1;
+  QMap<QString,PiiVariant> mapObjects;
+  mapObjects["a"] = PiiVariant(1.0);
+  mapObjects["b"] = PiiVariant(2);
+  QList<BenchmarkResult> lstResults = PiiOperationTest::benchmark(mapObjects, options);
+  QCOMPARE(lstResults.size(), 2);
+  QCOMPARE(lstResults[1].iThreadCount, 1);
+  QCOMPARE(lstResults[1].iObjectCount, 100);
+  QVERIFY(lstResults[1].dThroughput > 0);
+  QVERIFY(lstResults[1].iMedianLatency <= lstResults[1].iMaxLatency);
+}
+
 #endif
 
 QTEST_MAIN(TestPiiFunctionOperation)
@@ -0,0 +1,149 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiFuture.h"
+
+#include <PiiFuture.h>
+#include <PiiAtomicInt.h>
+#include <QtTest>
+#include <QSemaphore>
+
+namespace
+{
+  struct Calculator
+  {
+    int sum(int a, int b) { return a + b; }
+  };
+
+  int fail()
+  {
+    PII_THROW(PiiException, "Failed on purpose.");
+  }
+}
+
+void TestPiiFuture::runTask()
+{
+  PiiFuture<int> future = PiiYdin::runTask([]() { return 42; });
+  QVERIFY(future.isValid());
+  QVERIFY(future.wait(5000));
+  QVERIFY(future.isFinished());
+  QCOMPARE(future.result(), 42);
+
+  PiiAtomicInt iCalls;
+  PiiFuture<void> voidFuture = PiiYdin::runTask([&iCalls]() { iCalls.ref(); });
+  voidFuture.result();
+  QCOMPARE(iCalls.load(), 1);
+}
+
+void TestPiiFuture::memberFunction()
+{
+  Calculator calculator;
+  PiiFuture<int> future = PiiYdin::runTask(&calculator, &Calculator::sum, 1, 2);
+  QCOMPARE(future.result(), 3);
+}
+
+void TestPiiFuture::failure()
+{
+  PiiFuture<int> future = PiiYdin::runTask(&fail);
+  QVERIFY(future.wait(5000));
+  QVERIFY(future.hasFailed());
+  QCOMPARE(future.errorMessage(), QString("Failed on purpose."));
+  try
+    {
+      future.result();
+      QFAIL("result() must throw if the task failed.");
+    }
+  catch (PiiException&)
+    {}
+
+  // Continuations of failed tasks are not run.
+  PiiAtomicInt iCalls;
+  PiiFuture<int> next = future.then([&iCalls](int value) { iCalls.ref(); return value; });
+  QVERIFY(next.wait(5000));
+  QVERIFY(next.hasFailed());
+  QCOMPARE(next.errorMessage(), QString("Failed on purpose."));
+  QCOMPARE(iCalls.load(), 0);
+}
+
+void TestPiiFuture::continuation()
+{
+  PiiFuture<QString> future = PiiYdin::runTask([]() { return 2; })
+    .then([](int value) { return value * 3; })
+    .then([](int value) { return QString::number(value); });
+  QCOMPARE(future.result(), QString("6"));
+
+  // Chaining to a finished future starts the continuation at once.
+  PiiFuture<int> finished = PiiYdin::runTask([]() { return 1; });
+  finished.wait();
+  QCOMPARE(finished.then([](int value) { return value + 1; }).result(), 2);
+
+  PiiFuture<int> afterVoid = PiiYdin::runTask([]() {}).then([]() { return 5; });
+  QCOMPARE(afterVoid.result(), 5);
+}
+
+void TestPiiFuture::cancel()
+{
+  QSemaphore started, release;
+  PiiFuture<bool> future = PiiYdin::runTask([&started, &release]()
+                                            {
+                                              started.release();
+                                              release.acquire();
+                                              return PiiYdin::isTaskCanceled();
+                                            });
+  started.acquire();
+  QCOMPARE(future.status(), PiiFutureState::Running);
+  QVERIFY(future.cancel());
+  QVERIFY(!future.isDone());
+  release.release();
+  QVERIFY(future.wait(5000));
+  QVERIFY(future.isCanceled());
+
+  // A continuation of a pending task can be canceled before it runs.
+  PiiFuture<int> first = PiiYdin::runTask([&started, &release]() { started.release(); release.acquire(); return 1; });
+  PiiAtomicInt iCalls;
+  PiiFuture<int> second = first.then([&iCalls](int value) { iCalls.ref(); return value; });
+  started.acquire();
+  QVERIFY(second.cancel());
+  QVERIFY(second.isCanceled());
+  release.release();
+  QCOMPARE(first.result(), 1);
+  QVERIFY(!second.cancel());
+  QCOMPARE(iCalls.load(), 0);
+  QVERIFY(!PiiYdin::isTaskCanceled());
+}
+
+void TestPiiFuture::whenAll()
+{
+  QList<PiiFuture<int> > lstFutures;
+  for (int i=0; i<8; ++i)
+    lstFutures << PiiYdin::runTask([i]() { return i*i; });
+  PiiFuture<void> all = PiiYdin::whenAll(lstFutures);
+  QVERIFY(all.wait(5000));
+  QVERIFY(all.isFinished());
+  for (int i=0; i<8; ++i)
+    {
+      QVERIFY(lstFutures[i].isDone());
+      QCOMPARE(lstFutures[i].result(), i*i);
+    }
+
+  lstFutures << PiiYdin::runTask(&fail);
+  all = PiiYdin::whenAll(lstFutures);
+  QVERIFY(all.wait(5000));
+  QVERIFY(all.hasFailed());
+
+  QVERIFY(PiiYdin::whenAll(QList<PiiFuture<int> >()).isFinished());
+}
+
+QTEST_MAIN(TestPiiFuture)
@@ -26,6 +26,10 @@ private slots:
   void simplifyVertices();
   void lineToLineDistance();
   void pointToLineSegmentDistance();
+  void batchedContains();
+  void batchedRectangles();
+  void distanceToSegment();
+  void rTree();
 };
 
 
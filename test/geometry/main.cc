@@ -16,6 +16,8 @@
 #include "TestPiiGeometry.h"
 
 #include <PiiGeometry.h>
+#include <PiiRTree.h>
+#include <PiiCpu.h>
 #include <QtTest>
 #include <PiiMatrixUtil.h>
 #include <QDebug>
@@ -148,6 +150,154 @@ void TestPiiGeometry::pointToLineSegmentDistance()
 
 }
 
+namespace
+{
+  PiiPointArray<float> randomPoints(int count)
+  {
+    PiiPointArray<float> points;
+    for (int i=0; i<count; ++i)
+      points.append(float(rand() % 2000) / 10, float(rand() % 2000) / 10);
+    return points;
+  }
+
+  QVector<PiiRectangle<float> > randomRectangles(int count)
+  {
+    QVector<PiiRectangle<float> > lstRectangles;
+    for (int i=0; i<count; ++i)
+      lstRectangles << PiiRectangle<float>(rand() % 200, rand() % 200, rand() % 20, rand() % 20);
+    return lstRectangles;
+  }
+}
+
+void TestPiiGeometry::batchedContains()
+{
+  // A star with some concave corners.
+  PiiMatrix<float> polygon(0,2);
+  for (int i=0; i<37; ++i)
+    {
+      double dAngle = i * 2 * M_PI / 37, dRadius = i % 2 ? 30 : 80;
+      polygon.insertRow(-1, 100 + dRadius * cos(dAngle), 100 + dRadius * sin(dAngle));
+    }
+  // Integer coordinates so that the old implementation can be used
+  // as a reference. 1003 points leaves a tail for the vector loops.
+  PiiPointArray<float> points(randomPoints(1003));
+  for (int i=0; i<points.count(); ++i)
+    points.set(i, int(points.x()[i]), int(points.y()[i]));
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { 0, iFeatures };
+  for (int f=0; f<2; ++f)
+    {
+      Pii::setCpuFeatureMask(aiFeatures[f]);
+      QVector<unsigned char> vecInside(PiiGeometry::contains(polygon, points));
+      QCOMPARE(vecInside.size(), points.count());
+      for (int i=0; i<points.count(); ++i)
+        QCOMPARE(bool(vecInside[i]), PiiGeometry::contains(polygon, int(points.x()[i]), int(points.y()[i])));
+    }
+  Pii::setCpuFeatureMask(iFeatures);
+
+  QVector<unsigned char> vecInside(PiiGeometry::contains(PiiMatrix<float>(0,2), points));
+  QCOMPARE(vecInside.count(0), points.count());
+}
+
+void TestPiiGeometry::batchedRectangles()
+{
+  const PiiRectangle<float> rect(50, 50, 60, 70);
+  const PiiPointArray<float> points(randomPoints(1003));
+  const QVector<PiiRectangle<float> > lstRectangles(randomRectangles(1001));
+  const PiiRectangleArray<float> rectangles(lstRectangles);
+  QCOMPARE(rectangles.at(3), lstRectangles[3]);
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { 0, iFeatures };
+  for (int f=0; f<2; ++f)
+    {
+      Pii::setCpuFeatureMask(aiFeatures[f]);
+      QVector<unsigned char> vecInside(PiiGeometry::contains(rect, points));
+      for (int i=0; i<points.count(); ++i)
+        QCOMPARE(bool(vecInside[i]), rect.contains(points.x()[i], points.y()[i]));
+      QVector<unsigned char> vecIntersects(PiiGeometry::intersects(rect, rectangles));
+      for (int i=0; i<lstRectangles.size(); ++i)
+        QCOMPARE(bool(vecIntersects[i]), rect.intersects(lstRectangles[i]));
+    }
+  Pii::setCpuFeatureMask(iFeatures);
+}
+
+void TestPiiGeometry::distanceToSegment()
+{
+  PiiPointArray<float> points;
+  points.append(0, 1);   // above the segment
+  points.append(-3, -4); // beyond the start point
+  points.append(13, 0);  // beyond the end point
+  points.append(4, 0);   // on the segment
+  const PiiPointArray<float> cloud(randomPoints(1001));
+  const PiiPoint<float> start(10,20), end(150,90);
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { 0, iFeatures };
+  QVector<float> vecReference;
+  for (int f=0; f<2; ++f)
+    {
+      Pii::setCpuFeatureMask(aiFeatures[f]);
+      QVector<float> vecDistances(PiiGeometry::distanceToSegment(PiiPoint<float>(0,0), PiiPoint<float>(10,0), points));
+      QCOMPARE(vecDistances[0], 1.0f);
+      QCOMPARE(vecDistances[1], 5.0f);
+      QCOMPARE(vecDistances[2], 3.0f);
+      QCOMPARE(vecDistances[3], 0.0f);
+
+      vecDistances = PiiGeometry::distanceToSegment(PiiPoint<float>(0,0), PiiPoint<float>(0,0), points);
+      QCOMPARE(vecDistances[1], 5.0f);
+
+      vecDistances = PiiGeometry::distanceToSegment(start, end, cloud);
+      if (f == 0)
+        vecReference = vecDistances;
+      else
+        {
+          for (int i=0; i<cloud.count(); ++i)
+            QVERIFY(Pii::abs(vecDistances[i] - vecReference[i]) < 1e-4);
+        }
+    }
+  Pii::setCpuFeatureMask(iFeatures);
+}
+
+void TestPiiGeometry::rTree()
+{
+  PiiRTree<float> emptyTree;
+  QVERIFY(emptyTree.isEmpty());
+  QVERIFY(emptyTree.intersecting(PiiRectangle<float>(0,0,100,100)).isEmpty());
+
+  const QVector<PiiRectangle<float> > lstRectangles(randomRectangles(1000));
+  PiiRTree<float> tree(lstRectangles);
+  QCOMPARE(tree.count(), lstRectangles.size());
+
+  for (int q=0; q<100; ++q)
+    {
+      const PiiRectangle<float> query(rand() % 200, rand() % 200, rand() % 40, rand() % 40);
+      QVector<int> vecFound(tree.intersecting(query));
+      std::sort(vecFound.begin(), vecFound.end());
+      QVector<int> vecExpected;
+      for (int i=0; i<lstRectangles.size(); ++i)
+        if (query.intersects(lstRectangles[i]))
+          vecExpected << i;
+      QCOMPARE(vecFound, vecExpected);
+
+      const float x = rand() % 200, y = rand() % 200;
+      vecFound = tree.containing(x, y);
+      std::sort(vecFound.begin(), vecFound.end());
+      vecExpected.clear();
+      for (int i=0; i<lstRectangles.size(); ++i)
+        if (lstRectangles[i].contains(x, y))
+          vecExpected << i;
+      QCOMPARE(vecFound, vecExpected);
+    }
+
+  // Partially filled nodes
+  for (int iCount=1; iCount<40; ++iCount)
+    {
+      PiiRTree<float> smallTree(lstRectangles.mid(0, iCount));
+      QCOMPARE(smallTree.intersecting(tree.bounds()).size(), iCount);
+    }
+}
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,145 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiHalf.h"
+
+#include <PiiHalf.h>
+#include <PiiFixedPoint.h>
+#include <PiiCpu.h>
+#include <QtTest>
+#include <cstring>
+
+void TestPiiHalf::conversion()
+{
+  QCOMPARE(float(PiiHalf(1.0f)), 1.0f);
+  QCOMPARE(float(PiiHalf(-2.5f)), -2.5f);
+  QCOMPARE(PiiHalf(1.0f).bits(), (unsigned short)0x3c00);
+  QCOMPARE(PiiHalf(65504.0f).bits(), (unsigned short)0x7bff);
+  // Beyond the largest finite value
+  QCOMPARE(PiiHalf(65520.0f).bits(), (unsigned short)0x7c00);
+  QCOMPARE(PiiHalf(-1e10f).bits(), (unsigned short)0xfc00);
+  // Smallest denormal
+  QCOMPARE(float(PiiHalf::fromBits(0x0001)), std::ldexp(1.0f, -24));
+  QCOMPARE(PiiHalf(std::ldexp(1.0f, -24)).bits(), (unsigned short)0x0001);
+  // Ties round to even
+  QCOMPARE(PiiHalf(1.0f + std::ldexp(1.0f, -11)).bits(), (unsigned short)0x3c00);
+  QCOMPARE(PiiHalf(1.0f + 3 * std::ldexp(1.0f, -11)).bits(), (unsigned short)0x3c02);
+  QVERIFY(Pii::isNan(float(PiiHalf(std::numeric_limits<float>::quiet_NaN()))));
+
+  // Every finite half converts to a float and back unchanged.
+  for (int i=0; i<0x10000; ++i)
+    {
+      if ((i & 0x7c00) == 0x7c00 && (i & 0x3ff) != 0)
+        continue;
+      PiiHalf half(PiiHalf::fromBits((unsigned short)i));
+      QCOMPARE(PiiHalf(float(half)).bits(), half.bits());
+    }
+}
+
+void TestPiiHalf::vectorConversion()
+{
+  // All bit patterns plus a tail that doesn't fill a vector
+  const int iCount = 0x10000 + 5;
+  QVector<PiiHalf> vecHalfs(iCount), vecHalfs2(iCount);
+  QVector<float> vecFloats(iCount);
+  for (int i=0; i<iCount; ++i)
+    vecHalfs[i] = PiiHalf::fromBits((unsigned short)(i * 40503));
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  for (int iMask = 0; iMask <= 1; ++iMask)
+    {
+      Pii::setCpuFeatureMask(iMask ? -1 : 0);
+      Pii::halfToFloatN(vecHalfs.constData(), iCount, vecFloats.data());
+      for (int i=0; i<iCount; ++i)
+        {
+          float fExpected = vecHalfs[i];
+          QVERIFY(std::memcmp(&fExpected, &vecFloats[i], 4) == 0);
+        }
+      Pii::floatToHalfN(vecFloats.constData(), iCount, vecHalfs2.data());
+      for (int i=0; i<iCount; ++i)
+        QCOMPARE(vecHalfs2[i].bits(), Pii::floatToHalf(vecFloats[i]));
+
+      // Arbitrary floats, including values that round to denormals
+      // and overflow to infinity.
+      for (int i=0; i<iCount; ++i)
+        {
+          unsigned int uiBits = 0x2e000000u + unsigned(i) * 0x7fed1u;
+          std::memcpy(&vecFloats[i], &uiBits, 4);
+        }
+      Pii::floatToHalfN(vecFloats.constData(), iCount, vecHalfs2.data());
+      for (int i=0; i<iCount; ++i)
+        QCOMPARE(vecHalfs2[i].bits(), Pii::floatToHalf(vecFloats[i]));
+    }
+  Pii::setCpuFeatureMask(iFeatures);
+}
+
+void TestPiiHalf::arithmetic()
+{
+  PiiHalf a(1.5f), b(-0.25f);
+  QCOMPARE(a + b, 1.25f);
+  QCOMPARE(a * b, -0.375f);
+  QVERIFY(b < a);
+  a += 1;
+  QCOMPARE(float(a), 2.5f);
+  a /= 2;
+  QCOMPARE(float(a), 1.25f);
+  QCOMPARE(float(Pii::Numeric<PiiHalf>::maxValue()), 65504.0f);
+  QCOMPARE(float(Pii::Numeric<PiiHalf>::minValue()), -65504.0f);
+}
+
+void TestPiiHalf::matrixConversion()
+{
+  PiiMatrix<float> matFloats(3,11);
+  for (int r=0; r<matFloats.rows(); ++r)
+    for (int c=0; c<matFloats.columns(); ++c)
+      matFloats(r,c) = float(r * 11 + c) / 8 - 2;
+
+  PiiMatrix<PiiHalf> matHalfs(Pii::floatToHalf(matFloats));
+  QCOMPARE(matHalfs.rows(), 3);
+  QCOMPARE(matHalfs.columns(), 11);
+  QCOMPARE(float(matHalfs(2,10)), matFloats(2,10));
+  // All values are exactly representable.
+  QVERIFY(Pii::equals(Pii::halfToFloat(matHalfs), matFloats));
+  QVERIFY(Pii::equals(PiiMatrix<float>(matHalfs), matFloats));
+}
+
+void TestPiiHalf::fixedPoint()
+{
+  typedef PiiFixedPoint<16> Fixed;
+  Fixed a(2.5), b(-1.25), c(3);
+  QCOMPARE(a.rawValue(), 5 << 15);
+  QCOMPARE(c.rawValue(), 3 << 16);
+  QCOMPARE(double(a + b), 1.25);
+  QCOMPARE(double(a - b), 3.75);
+  QCOMPARE(double(a * b), -3.125);
+  QCOMPARE(double(a / b), -2.0);
+  QCOMPARE(double(-a), -2.5);
+  QCOMPARE(double(a * 2), 5.0);
+  QCOMPARE(double(a * 0.5), 1.25);
+  QCOMPARE(b.floor(), -2);
+  QCOMPARE(b.round(), -1);
+  QCOMPARE(a.round(), 3);
+  QVERIFY(b < a);
+  QVERIFY(a == Fixed::fromRaw(5 << 15));
+  a *= b;
+  QCOMPARE(double(a), -3.125);
+  // Products don't overflow in the intermediate result.
+  QCOMPARE(double(Fixed(300) * Fixed(100)), 30000.0);
+
+  PiiMatrix<Fixed> matFixed(PiiMatrix<float>(1,3, 0.5, -1.0, 2.25));
+  QCOMPARE(matFixed(0,2).rawValue(), 9 << 14);
+}
+
+QTEST_MAIN(TestPiiHalf)
@@ -30,6 +30,10 @@ public:
 private slots:
   void httpRequest();
   void httpRequest_data();
+  void requestLength();
+  void requestLength_data();
+  void chunkedTransfer();
+  void compression();
   void cleanup();
 
 private:
@@ -39,6 +43,7 @@ private:
   QThread* _pServerThread;
   PiiWaitCondition _serverCondition;
   bool _bServerRunning, _bSuccess;
+  int _iIoThreads, _iCacheSize;
 };
 
 
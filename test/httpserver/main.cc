@@ -18,17 +18,23 @@
 #include <QtTest>
 
 #include <PiiHttpServer.h>
+#include <PiiHttpProtocol.h>
 #include <PiiNetwork.h>
 #include <PiiException.h>
 #include <PiiFileUtil.h>
 #include <PiiFileSystemUriHandler.h>
+#include <PiiHttpResponseHeader.h>
+#include <PiiHttpDevice.h>
+#include <PiiStreamBuffer.h>
 #include <PiiAsyncCall.h>
 
 TestPiiHttpServer::TestPiiHttpServer() :
   _strBase(Pii::applicationBasePath() + "/data"),
   _pServerThread(0),
   _bServerRunning(false),
-  _bSuccess(false)
+  _bSuccess(false),
+  _iIoThreads(0),
+  _iCacheSize(0)
 {}
 
 void TestPiiHttpServer::serverThread(const QString& address)
@@ -36,8 +42,10 @@ void TestPiiHttpServer::serverThread(const QString& address)
   PiiFileSystemUriHandler handler(_strBase);
   handler.setAllowedMethods(QStringList() << "GET" << "HEAD" << "PUT" << "MKCOL" << "DELETE");
   handler.setIndexFile("test.txt");
+  handler.setCacheSize(_iCacheSize);
   PiiHttpServer* pServer = PiiHttpServer::addServer("TestServer", address);
   pServer->protocol()->registerUriHandler("/", &handler);
+  pServer->networkServer()->setIoThreads(_iIoThreads);
   if (pServer->start())
     {
       _bSuccess = _bServerRunning = true;
@@ -70,6 +78,10 @@ void TestPiiHttpServer::httpRequest()
 
   // Start server in another thread
   QFETCH(QString, address);
+  QFETCH(int, ioThreads);
+  QFETCH(int, cacheSize);
+  _iIoThreads = ioThreads;
+  _iCacheSize = cacheSize;
   _bSuccess = false;
   _pServerThread = Pii::asyncCall(this, &TestPiiHttpServer::serverThread, address);
   _serverCondition.wait();
@@ -81,6 +93,22 @@ void TestPiiHttpServer::httpRequest()
     {
       PiiNetwork::putFile(address + "/test.txt", aFileContents);
       QCOMPARE(PiiNetwork::readFile(address + "/"), aFileContents);
+
+      PiiHttpResponseHeader header;
+      QCOMPARE(PiiNetwork::readFile(address + "/test.txt", 0, &header), aFileContents);
+      QCOMPARE(header.value("Accept-Ranges"), QString("bytes"));
+      QVERIFY(!header.value("ETag").isEmpty());
+      PiiMimeHeader requestHeader;
+      requestHeader.setValue("Range", "bytes=10-");
+      QCOMPARE(PiiNetwork::readFile(address + "/test.txt", requestHeader), aFileContents.mid(10));
+      requestHeader.setValue("Range", "bytes=4-8");
+      QCOMPARE(PiiNetwork::readFile(address + "/test.txt", requestHeader), aFileContents.mid(4, 5));
+      requestHeader.setValue("Range", "bytes=-5");
+      QCOMPARE(PiiNetwork::readFile(address + "/test.txt", requestHeader), aFileContents.right(5));
+      requestHeader.removeValue("Range");
+      requestHeader.setValue("If-None-Match", header.value("ETag"));
+      QCOMPARE(PiiNetwork::readFile(address + "/test.txt", requestHeader), QByteArray());
+
       PiiNetwork::makeDirectory(address + "/test");
       PiiNetwork::putFile(address + "/test/test2.txt", aFileContents);
 
@@ -105,10 +133,94 @@ void TestPiiHttpServer::httpRequest()
 void TestPiiHttpServer::httpRequest_data()
 {
   QTest::addColumn<QString>("address");
+  QTest::addColumn<int>("ioThreads");
+  QTest::addColumn<int>("cacheSize");
+
+  QTest::newRow("tcp") << "tcp://0.0.0.0:31415" << 0 << 0;
+  QTest::newRow("tcp, cached") << "tcp://0.0.0.0:31415" << 0 << 1024;
+  QTest::newRow("tcp, event-driven") << "tcp://0.0.0.0:31415" << 2 << 0;
+  //QTest::newRow("ssl") << "ssl://127.0.0.1:31415" << 0 << 0;
+  //QTest::newRow("local") << "local://" + _strBase + "/server.sock" << 0 << 0;
+}
+
+void TestPiiHttpServer::requestLength()
+{
+  QFETCH(QByteArray, buffer);
+  QFETCH(int, length);
+
+  PiiHttpProtocol protocol;
+  QCOMPARE(protocol.requestLength(buffer), length);
+}
 
-  QTest::newRow("tcp") << "tcp://0.0.0.0:31415";
-  //QTest::newRow("ssl") << "ssl://127.0.0.1:31415";
-  //QTest::newRow("local") << "local://" + _strBase + "/server.sock";
+void TestPiiHttpServer::requestLength_data()
+{
+  QTest::addColumn<QByteArray>("buffer");
+  QTest::addColumn<int>("length");
+
+  QByteArray aGet("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  QByteArray aPut("PUT /a HTTP/1.1\r\ncontent-length: 5\r\n\r\n");
+
+  QTest::newRow("empty") << QByteArray() << 0;
+  QTest::newRow("partial header") << aGet.left(20) << 0;
+  QTest::newRow("get") << aGet << aGet.size();
+  QTest::newRow("pipelined") << aGet + aGet << aGet.size();
+  QTest::newRow("lf only") << QByteArray("GET / HTTP/1.0\nHost: x\n\nGET") << 24;
+  QTest::newRow("partial body") << aPut + "abc" << 0;
+  QTest::newRow("body") << aPut + "abcdeGET" << aPut.size() + 5;
+  QTest::newRow("too large") << QByteArray("PUT /a HTTP/1.1\r\nContent-Length: 100000000\r\n\r\n") << 46;
+  QTest::newRow("endless header") << QByteArray(5000, 'a') << 5000;
+}
+
+void TestPiiHttpServer::chunkedTransfer()
+{
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  buffer.write("GET / HTTP/1.1\r\n\r\n");
+  buffer.seek(0);
+  qint64 iResponsePos = 0;
+  {
+    PiiHttpDevice server(&buffer, PiiHttpDevice::Server);
+    QVERIFY(server.readHeader());
+    iResponsePos = buffer.pos();
+    server.print("Hello, ");
+    server.print("chunked world.");
+  }
+  buffer.seek(iResponsePos);
+  PiiHttpDevice client(&buffer, PiiHttpDevice::Client);
+  QVERIFY(client.readHeader());
+  QCOMPARE(client.responseHeader().value("Transfer-Encoding"), QString("chunked"));
+  QCOMPARE(client.readBody(), QByteArray("Hello, chunked world."));
+  QVERIFY(client.isMessageComplete());
+}
+
+void TestPiiHttpServer::compression()
+{
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  buffer.write("GET / HTTP/1.1\r\nAccept-Encoding: deflate, gzip;q=0.5\r\n\r\n");
+  buffer.seek(0);
+  QByteArray aData(QByteArray("All work and no play makes Jack a dull boy. ").repeated(100));
+  qint64 iResponsePos = 0;
+  {
+    PiiHttpDevice server(&buffer, PiiHttpDevice::Server);
+    QVERIFY(server.readHeader());
+    iResponsePos = buffer.pos();
+    server.startOutputFiltering(new PiiStreamBuffer);
+    QVERIFY(server.startOutputCompression());
+    server.write(aData);
+  }
+  buffer.seek(iResponsePos);
+  PiiHttpDevice client(&buffer, PiiHttpDevice::Client);
+  QVERIFY(client.readHeader());
+  QCOMPARE(client.responseHeader().value("Content-Encoding"), QString("deflate"));
+  QByteArray aBody(client.readBody());
+  QCOMPARE(qint64(aBody.size()), client.bodyLength());
+  QVERIFY(aBody.size() < aData.size());
+  // qUncompress() wants the uncompressed size in front of zlib data.
+  QByteArray aSize(4, 0);
+  for (int i=0; i<4; ++i)
+    aSize[i] = char(aData.size() >> (24 - 8*i));
+  QCOMPARE(qUncompress(aSize + aBody), aData);
 }
 
 QTEST_MAIN(TestPiiHttpServer)
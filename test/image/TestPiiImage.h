@@ -32,14 +32,27 @@ private slots:
   void scaleNearestNeighborInterpolation();
   void scaleLinearInterpolation();
   void scaleColor();
+  void scaleResample();
+  void quarterSize();
+  void imagePyramid();
   void rotate();
+  void remapTable();
   void colorChannel();
   void setColorChannel();
   void detectEdges();
+  void cannyEdges();
+  void fastCorners();
   void suppressNonMaxima();
   void medianFilter();
+  void slidingHistogram();
+  void percentileFilter();
   void separateFilter();
   void filter();
+  void vectorizedFilter();
+  void parallelFilter();
+  void fftFilter();
+  void boxFilter();
+  void integralImage();
   void intFilter();
   void maxFilter();
   void minFilter();
@@ -54,6 +67,7 @@ private slots:
   void twoLevelThreshold();
   void inverseTwoLevelThreshold();
   void hysteresisThreshold();
+  void percentileThreshold();
   void adaptiveThreshold();
 
   // Morphology
@@ -66,13 +80,21 @@ private slots:
   void hitAndMiss();
   void border();
   void thin();
+  void largeMasks();
   void bottomHat();
   void labelImage();
   void labelLargerThan();
+  void labelRuns();
+  void streamLabeler();
+  void objectFeatureAccumulator();
+  void bitMatrix();
 
   // Histogram
   void equalize();
+  void equalizeLocally();
   void histogram();
+  void fastHistogram();
+  void runLengthRoi();
   void cumulative();
   void normalize();
   void percentile();
@@ -92,6 +114,8 @@ private slots:
   void sweepLine();
   void crop();
   void xorMatch();
+  void bitXorMatch();
+  void templateMatching();
   void fastGradient();
 
 private:
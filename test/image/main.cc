@@ -25,11 +25,18 @@
 #include <PiiMorphology.h>
 #include <PiiBoundaryFinder.h>
 #include <PiiLabeling.h>
+#include <PiiStreamLabeler.h>
 #include <PiiFunctional.h>
 #include <PiiObjectProperty.h>
 #include <PiiMaskGenerator.h>
 #include <PiiColor.h>
 #include <PiiImageDistortions.h>
+#include <PiiCpu.h>
+#include <PiiThresholding.h>
+#include <PiiSlidingHistogram.h>
+#include <PiiImagePyramid.h>
+#include <PiiTemplateMatching.h>
+#include <PiiRemapTable.h>
 
 #include <functional>
 
@@ -483,6 +490,49 @@ void TestPiiImage::createMask()
   */
 }
 
+void TestPiiImage::largeMasks()
+{
+  // Compare to a straightforward implementation with masks that span
+  // several 64-bit words.
+  srand(1);
+  PiiMatrix<int> image(60,150);
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.columns(); ++c)
+      image(r,c) = rand() % 4 != 0 ? 1 : 0;
+
+  PiiImage::MaskType types[] = { PiiImage::RectangularMask, PiiImage::EllipticalMask, PiiImage::DiamondMask };
+  for (int t=0; t<3; ++t)
+    {
+      for (int size=1; size<=31; size+=6)
+        {
+          PiiMatrix<int> mask(PiiImage::createMask<int>(types[t], size, size/2 + 1));
+          int rOrig = mask.rows()/2, cOrig = mask.columns()/2;
+          PiiMatrix<int> eroded(image.rows(), image.columns()), dilated(image.rows(), image.columns());
+          for (int r=0; r<image.rows(); ++r)
+            for (int c=0; c<image.columns(); ++c)
+              {
+                bool bFits = r >= rOrig && r - rOrig + mask.rows() <= image.rows() &&
+                  c >= cOrig && c - cOrig + mask.columns() <= image.columns();
+                eroded(r,c) = bFits ? 1 : 0;
+                for (int mr=0; mr<mask.rows(); ++mr)
+                  for (int mc=0; mc<mask.columns(); ++mc)
+                    {
+                      if (!mask(mr,mc))
+                        continue;
+                      int ir = r - rOrig + mr, ic = c - cOrig + mc;
+                      if (bFits && !image(ir,ic))
+                        eroded(r,c) = 0;
+                      ir = r + rOrig - mr, ic = c + cOrig - mc;
+                      if (ir >= 0 && ir < image.rows() && ic >= 0 && ic < image.columns() && image(ir,ic))
+                        dilated(r,c) = 1;
+                    }
+              }
+          QVERIFY(Pii::equals(PiiImage::erode(image, mask), eroded));
+          QVERIFY(Pii::equals(PiiImage::dilate(image, mask), dilated));
+        }
+    }
+}
+
 void TestPiiImage::erode()
 {
   {
@@ -818,6 +868,146 @@ void TestPiiImage::scaleColor()
   QVERIFY(Pii::equals(PiiImage::scale(*pInput2, 0.5),*pResult2));
 }
 
+void TestPiiImage::scaleResample()
+{
+  PiiMatrix<int> input(4,4,
+                       0,2,1,3,
+                       2,0,3,1,
+                       3,1,2,0,
+                       1,3,0,2);
+  QVERIFY(Pii::equals(PiiImage::scale(input, 2, 2, Pii::AreaInterpolation), PiiMatrix<int>(2,2, 1, 2, 2, 1)));
+
+  // The weights of each output pixel sum up to one.
+  PiiMatrix<float> matFlat(PiiMatrix<float>::constant(20, 30, 7.5f));
+  PiiMatrix<float> matReduced(PiiImage::scale(matFlat, 7, 9, Pii::AreaInterpolation));
+  PiiMatrix<float> matEnlarged(PiiImage::scale(matFlat, 45, 61, Pii::CubicInterpolation));
+  QCOMPARE(matReduced.rows(), 7);
+  QCOMPARE(matEnlarged.columns(), 61);
+  QVERIFY(Pii::maxAbs(matReduced - 7.5f) < 1e-5f);
+  QVERIFY(Pii::maxAbs(matEnlarged - 7.5f) < 1e-5f);
+
+  // Vectorized 8-bit results must match rounded floating-point
+  // results, also for each channel of a color image.
+  PiiMatrix<uchar> matImage(PiiMatrix<uchar>::uninitialized(40, 70));
+  PiiMatrix<PiiColor4<uchar> > matColor(PiiMatrix<PiiColor4<uchar> >::uninitialized(40, 70));
+  for (int r=0; r<40; ++r)
+    for (int c=0; c<70; ++c)
+      {
+        matImage(r,c) = uchar((r*r*3 + c*29) % 256);
+        matColor(r,c) = PiiColor4<uchar>(matImage(r,c), 255 - matImage(r,c), 10, 0);
+      }
+  PiiMatrix<uchar> matScaled(PiiImage::scale(matImage, 23, 51, Pii::CubicInterpolation));
+  PiiMatrix<float> matScaledFloat(PiiImage::scale(PiiMatrix<float>(matImage), 23, 51, Pii::CubicInterpolation));
+  PiiMatrix<PiiColor4<uchar> > matScaledColor(PiiImage::scale(matColor, 23, 51, Pii::CubicInterpolation));
+  for (int r=0; r<23; ++r)
+    for (int c=0; c<51; ++c)
+      {
+        const float fExpected = std::floor(qBound(0.0f, matScaledFloat(r,c), 255.0f) + 0.5f);
+        QCOMPARE(float(matScaled(r,c)), fExpected);
+        QCOMPARE(matScaledColor(r,c).c0, matScaled(r,c));
+        QCOMPARE(int(matScaledColor(r,c).c2), 10);
+      }
+}
+
+void TestPiiImage::quarterSize()
+{
+  // Odd sizes exercise the scalar tail of the vectorized kernels.
+  PiiMatrix<uchar> matImage(23, 53);
+  PiiMatrix<float> matFloatImage(23, 53);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      {
+        matImage(r,c) = uchar((r * 71 + c * 13 + r * c * 7) & 0xff);
+        matFloatImage(r,c) = float(matImage(r,c)) / 7;
+      }
+
+  PiiMatrix<uchar> matSmall(PiiImage::quarterSize(matImage));
+  PiiMatrix<float> matFloatSmall(PiiImage::quarterSize(matFloatImage));
+  QCOMPARE(matSmall.rows(), 11);
+  QCOMPARE(matSmall.columns(), 26);
+  QCOMPARE(matFloatSmall.rows(), 11);
+  QCOMPARE(matFloatSmall.columns(), 26);
+  for (int r=0; r<matSmall.rows(); ++r)
+    for (int c=0; c<matSmall.columns(); ++c)
+      {
+        QCOMPARE(int(matSmall(r,c)),
+                 (matImage(2*r,2*c) + matImage(2*r,2*c+1) + matImage(2*r+1,2*c) + matImage(2*r+1,2*c+1)) / 4);
+        QCOMPARE(matFloatSmall(r,c),
+                 ((matFloatImage(2*r,2*c) + matFloatImage(2*r,2*c+1)) +
+                  (matFloatImage(2*r+1,2*c) + matFloatImage(2*r+1,2*c+1))) / 4);
+      }
+}
+
+void TestPiiImage::imagePyramid()
+{
+  PiiMatrix<uchar> matImage(37, 50);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 29 + c * 17 + r * c * 3) & 0xff);
+
+  {
+    PiiImagePyramid<uchar> empty;
+    QCOMPARE(empty.levelCount(), 0);
+    QVERIFY(empty.level(0).isEmpty());
+  }
+  {
+    PiiImagePyramid<uchar> pyramid(matImage, PiiImage::BoxPyramidKernel);
+    // 37x50, 18x25, 9x12, 4x6, 2x3, 1x1
+    QCOMPARE(pyramid.levelCount(), 6);
+    QCOMPARE(pyramid.cachedLevelCount(), 1);
+    QVERIFY(Pii::equals(pyramid.level(2), PiiImage::quarterSize(PiiImage::quarterSize(matImage))));
+    QCOMPARE(pyramid.cachedLevelCount(), 3);
+    QCOMPARE(pyramid.level(5).rows(), 1);
+    QCOMPARE(pyramid.level(5).columns(), 1);
+    QVERIFY(pyramid.level(6).isEmpty());
+    QCOMPARE(pyramid.levelForSize(9, 12), 2);
+    QCOMPARE(pyramid.levelForSize(9, 13), 1);
+    QCOMPARE(pyramid.levelForSize(100, 100), 0);
+  }
+  {
+    PiiImagePyramid<uchar> pyramid(matImage);
+    // 37x50, 19x25, 10x13, 5x7, 3x4, 2x2, 1x1
+    QCOMPARE(pyramid.levelCount(), 7);
+    PiiMatrix<uchar> matLevel(pyramid.level(1));
+    QCOMPARE(matLevel.rows(), 19);
+    QCOMPARE(matLevel.columns(), 25);
+    const int aWeights[] = { 1, 4, 6, 4, 1 };
+    for (int r=0; r<matLevel.rows(); ++r)
+      for (int c=0; c<matLevel.columns(); ++c)
+        {
+          int iSum = 0;
+          for (int i=0; i<5; ++i)
+            for (int j=0; j<5; ++j)
+              iSum += aWeights[i] * aWeights[j] *
+                matImage(qBound(0, 2*r+i-2, matImage.rows()-1), qBound(0, 2*c+j-2, matImage.columns()-1));
+          QCOMPARE(int(matLevel(r,c)), (iSum + 128) / 256);
+        }
+
+    // Copies share the cache.
+    PiiImagePyramid<uchar> copy(pyramid);
+    copy.level(4);
+    QCOMPARE(pyramid.cachedLevelCount(), 5);
+    QCOMPARE(pyramid.level(6).rows(), 1);
+
+    PiiImagePyramid<float> floatPyramid(PiiMatrix<float>::constant(9, 14, 0.5f));
+    QVERIFY(Pii::equals(floatPyramid.level(2), PiiMatrix<float>::constant(3, 4, 0.5f)));
+  }
+  {
+    // The shared cache is keyed by the image data.
+    PiiImagePyramid<uchar> pyramid1(PiiImagePyramid<uchar>::shared(matImage));
+    pyramid1.level(3);
+    PiiMatrix<uchar> matCopy(matImage);
+    PiiImagePyramid<uchar> pyramid2(PiiImagePyramid<uchar>::shared(matCopy));
+    QCOMPARE(pyramid2.cachedLevelCount(), 4);
+    PiiImagePyramid<uchar> pyramid3(PiiImagePyramid<uchar>::shared(matCopy, PiiImage::BoxPyramidKernel));
+    QCOMPARE(pyramid3.cachedLevelCount(), 1);
+    // Modifying the copy detaches it from the cached data.
+    matCopy(0,0) = 1;
+    QCOMPARE(PiiImagePyramid<uchar>::shared(matCopy).cachedLevelCount(), 1);
+    QCOMPARE(PiiImagePyramid<uchar>::shared(matImage).cachedLevelCount(), 4);
+  }
+}
+
 void TestPiiImage::rotate()
 {
   PiiMatrix<int> mat(3,3,
@@ -879,6 +1069,77 @@ void TestPiiImage::rotate()
                                                                     8,5,2)));
 }
 
+
+void TestPiiImage::remapTable()
+{
+  {
+    // Integer maps sample exactly. Points outside of the source image
+    // are left black, even if the map is larger than the image.
+    PiiMatrix<float> matImage(2,3,
+                              1.0, 2.0, 3.0,
+                              4.0, 5.0, 6.0);
+    PiiImage::IntCoordinateMap matMap(2,4);
+    matMap(0,0) = PiiPoint<int>(2,1);
+    matMap(0,1) = PiiPoint<int>(0,0);
+    matMap(0,2) = PiiPoint<int>(3,0);
+    matMap(0,3) = PiiPoint<int>(1,1);
+    matMap(1,0) = PiiPoint<int>(2,2);
+    matMap(1,1) = PiiPoint<int>(-1,0);
+    matMap(1,2) = PiiPoint<int>(2,0);
+    matMap(1,3) = PiiPoint<int>(0,1);
+    PiiMatrix<float> matExpected(2,4,
+                                 6.0, 1.0, 0.0, 5.0,
+                                 0.0, 0.0, 3.0, 4.0);
+    QVERIFY(Pii::equals(PiiImage::remap(matImage, matMap), matExpected));
+    PiiRemapTable table(matMap, 2, 3);
+    QCOMPARE(table.rows(), 2);
+    QCOMPARE(table.columns(), 4);
+    QVERIFY(Pii::equals(table.remap(matImage), matExpected));
+    QVERIFY(table.remap(PiiMatrix<float>(3,2)).isEmpty());
+    QVERIFY(PiiRemapTable().isEmpty());
+  }
+  {
+    // Single-column source images are sampled without reading past
+    // the last column.
+    PiiMatrix<uchar> matImage(3,1, 10, 20, 30);
+    PiiImage::DoubleCoordinateMap matMap(1,5);
+    for (int i=0; i<5; ++i)
+      matMap(0,i) = PiiPoint<double>(0, i*0.5);
+    PiiRemapTable table(matMap, 3, 1);
+    QVERIFY(Pii::equals(table.remap(matImage, uchar(1)), PiiMatrix<uchar>(1,5, 10, 15, 20, 25, 30)));
+  }
+  {
+    // Rotations match PiiImage::transform() except for the rounding
+    // of fixed-point weights. Vectorized uchar sampling must agree
+    // with floating-point sampling.
+    PiiMatrix<uchar> matImage(PiiMatrix<uchar>::uninitialized(37,53));
+    for (int r=0; r<matImage.rows(); ++r)
+      for (int c=0; c<matImage.columns(); ++c)
+        matImage(r,c) = uchar((r*31 + c*17 + r*c) & 0xff);
+    PiiMatrix<float> matTransform(PiiImage::createRotationTransform(0.3f, 26.5f, 18.5f));
+    PiiRemapTable table(matTransform, matImage.rows(), matImage.columns());
+    PiiMatrix<uchar> matDirect(PiiImage::transform(matImage, matTransform, PiiImage::ExpandAsNecessary, uchar(7)));
+    PiiMatrix<uchar> matTable(table.remap(matImage, uchar(7)));
+    PiiMatrix<float> matFloat(table.remap(PiiMatrix<float>(matImage), 7.0f));
+    QCOMPARE(matTable.rows(), matDirect.rows());
+    QCOMPARE(matTable.columns(), matDirect.columns());
+    int iBackground = 0;
+    for (int r=0; r<matTable.rows(); ++r)
+      for (int c=0; c<matTable.columns(); ++c)
+        {
+          QVERIFY(Pii::abs(int(matTable(r,c)) - int(matDirect(r,c))) <= 2);
+          QVERIFY(Pii::abs(float(matTable(r,c)) - matFloat(r,c)) <= 0.5f + 1e-3f);
+          if (matTable(r,c) == 7 && matFloat(r,c) == 7.0f)
+            ++iBackground;
+        }
+    QVERIFY(iBackground > 0);
+
+    PiiRemapTable cropped(matTransform, matImage.rows(), matImage.columns(), PiiImage::RetainOriginalSize);
+    QCOMPARE(cropped.rows(), matImage.rows());
+    QCOMPARE(cropped.columns(), matImage.columns());
+  }
+}
+
 void TestPiiImage::colorChannel()
 {
   PiiMatrix<PiiColor4<> > img(4,4);
@@ -962,6 +1223,141 @@ void TestPiiImage::detectEdges()
 
 }
 
+template <class T, class G> static PiiMatrix<int> composedCannyEdges(const PiiMatrix<T>& image,
+                                                                     G lowThreshold, G highThreshold,
+                                                                     Pii::ExtendMode mode)
+{
+  PiiMatrix<G> matGradientX = PiiImage::filter<G>(image, PiiImage::SobelXFilter, mode);
+  PiiMatrix<G> matGradientY = PiiImage::filter<G>(image, PiiImage::SobelYFilter, mode);
+  PiiMatrix<G> matMagnitude = PiiImage::gradientMagnitude(matGradientX, matGradientY);
+  if (highThreshold == 0)
+    {
+      double dMean = 0;
+      double dStd = Pii::std<double>(matMagnitude, &dMean);
+      highThreshold = G(dMean + 2 * dStd);
+    }
+  if (lowThreshold == 0)
+    lowThreshold = G(0.4 * highThreshold);
+  return PiiImage::hysteresisThreshold(PiiImage::suppressNonMaxima(matMagnitude,
+                                                                   PiiImage::gradientDirection(matGradientX, matGradientY),
+                                                                   PiiImage::RadiansToPoints<float>()),
+                                       lowThreshold, highThreshold);
+}
+
+void TestPiiImage::cannyEdges()
+{
+  srand(4);
+  const int aiSizes[][2] = { {3,3}, {2,5}, {5,2}, {37,53}, {64,41} };
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { iFeatures, 0 };
+  for (unsigned s=0; s<sizeof(aiSizes)/sizeof(aiSizes[0]); ++s)
+    {
+      // Blocks of constant intensity with some noise.
+      PiiMatrix<uchar> matImage(aiSizes[s][0], aiSizes[s][1]);
+      for (int r=0; r<matImage.rows(); ++r)
+        for (int c=0; c<matImage.columns(); ++c)
+          matImage(r,c) = uchar(((r/8 + c/11) % 3) * 80 + rand() % 20);
+      PiiMatrix<float> matFloatImage(matImage);
+
+      for (int mode = Pii::ExtendZeros; mode < Pii::ExtendNot; ++mode)
+        {
+          Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+          for (int low = 0; low <= 40; low += 40)
+            for (int high = 0; high <= 200; high += 100)
+              {
+                PiiMatrix<int> matExpected = composedCannyEdges(matImage, low, high, extendMode);
+                // Automatic thresholds aren't rounded with floats.
+                PiiMatrix<int> matFloatExpected = composedCannyEdges(matFloatImage, float(low), float(high), extendMode);
+                for (int f=0; f<2; ++f)
+                  {
+                    Pii::setCpuFeatureMask(aiFeatures[f]);
+                    QVERIFY(Pii::equals(PiiImage::cannyEdges(matImage, low, high, extendMode), matExpected));
+                    QVERIFY(Pii::equals(PiiImage::cannyEdges(matFloatImage, float(low), float(high), extendMode), matFloatExpected));
+                    // Uneven strips that are smaller than the filter
+                    QVERIFY(Pii::equals(PiiImage::cannyEdges(matImage, low, high, extendMode,
+                                                             PiiParallelPolicy(7, 1)), matExpected));
+                  }
+                Pii::setCpuFeatureMask(iFeatures);
+              }
+
+          PiiMatrix<int> matGradientX = PiiImage::filter<int>(matImage, PiiImage::SobelXFilter, extendMode);
+          PiiMatrix<int> matGradientY = PiiImage::filter<int>(matImage, PiiImage::SobelYFilter, extendMode);
+          PiiMatrix<int> matMagnitude;
+          PiiMatrix<float> matDirection;
+          PiiImage::cannyEdges(matImage, 0, 0, extendMode, PiiParallelPolicy(3, 1), &matMagnitude, &matDirection);
+          QVERIFY(Pii::equals(matMagnitude, PiiImage::gradientMagnitude(matGradientX, matGradientY)));
+          QVERIFY(Pii::equals(matDirection, PiiImage::gradientDirection(matGradientX, matGradientY)));
+        }
+    }
+
+  PiiMatrix<int> matEmpty = PiiImage::cannyEdges(PiiMatrix<uchar>(0, 4));
+  QCOMPARE(matEmpty.rows(), 0);
+  QCOMPARE(matEmpty.columns(), 4);
+  // A single row or column is both the first and the last one.
+  QVERIFY(Pii::equals(PiiImage::cannyEdges(PiiMatrix<uchar>(1, 5, 0, 0, 255, 255, 255), 1, 1),
+                      PiiMatrix<int>(1, 5, 0, 0, 1, 0, 0)));
+  QVERIFY(Pii::equals(PiiImage::cannyEdges(PiiMatrix<uchar>(5, 1, 0, 0, 255, 255, 255), 1, 1),
+                      PiiMatrix<int>(5, 1, 0, 0, 1, 0, 0)));
+  try
+    {
+      PiiImage::cannyEdges(matEmpty, 0, 0, Pii::ExtendNot);
+      QFAIL("cannyEdges() should throw an exception with ExtendNot.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
+void TestPiiImage::fastCorners()
+{
+  srand(5);
+  // Noisy rectangles on a noisy background
+  PiiMatrix<uchar> matImage(61, 90);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar(rand() % 30);
+  for (int i=0; i<12; ++i)
+    {
+      const int iRow = rand() % 50, iColumn = rand() % 80, iValue = 60 + rand() % 190;
+      for (int r=iRow; r<iRow + 4 + rand() % 20 && r<matImage.rows(); ++r)
+        for (int c=iColumn; c<iColumn + 4 + rand() % 20 && c<matImage.columns(); ++c)
+          matImage(r,c) = uchar(qMin(255, iValue + rand() % 10));
+    }
+  // A view with an odd stride
+  PiiMatrix<uchar> matView(matImage(3, 5, 47, 71));
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  for (int t=0; t<=60; t+=15)
+    {
+      Pii::setCpuFeatureMask(0);
+      PiiMatrix<int> matExpected = PiiImage::detectFastCorners(matImage, uchar(t));
+      PiiMatrix<int> matExpectedView = PiiImage::detectFastCorners(matView, uchar(t));
+      Pii::setCpuFeatureMask(iFeatures);
+      QVERIFY(matExpected.rows() > 0);
+      QVERIFY(Pii::equals(PiiImage::detectFastCorners(matImage, uchar(t)), matExpected));
+      QVERIFY(Pii::equals(PiiImage::detectFastCorners(matView, uchar(t)), matExpectedView));
+    }
+  QCOMPARE(PiiImage::detectFastCorners(PiiMatrix<uchar>(6, 100), uchar(0)).rows(), 0);
+
+  PiiImagePyramid<uchar> pyramid(matImage);
+  PiiMatrix<int> matCorners = PiiImage::detectFastCorners(pyramid, uchar(10));
+  QCOMPARE(matCorners.columns(), 3);
+  int iStart = 0;
+  for (int i=0; i<pyramid.levelCount(); ++i)
+    {
+      PiiMatrix<int> matLevel = PiiImage::detectFastCorners(pyramid.level(i), uchar(10));
+      QVERIFY(iStart + matLevel.rows() <= matCorners.rows());
+      for (int r=0; r<matLevel.rows(); ++r)
+        {
+          QCOMPARE(matCorners(iStart + r, 0), matLevel(r,0));
+          QCOMPARE(matCorners(iStart + r, 1), matLevel(r,1));
+          QCOMPARE(matCorners(iStart + r, 2), i);
+        }
+      iStart += matLevel.rows();
+    }
+  QCOMPARE(iStart, matCorners.rows());
+  QCOMPARE(PiiImage::detectFastCorners(pyramid, uchar(10), 1).rows(),
+           PiiImage::detectFastCorners(matImage, uchar(10)).rows());
+}
+
 template <class TernaryFunction, class T>
 PiiMatrix<typename TernaryFunction::result_type> TestPiiImage::apply(const PiiMatrix<T>& mat,
                                                                      TernaryFunction func,
@@ -1176,6 +1572,118 @@ void TestPiiImage::medianFilter()
   QCOMPARE(matClrOut(1, 0), PiiColor<>(3, 4, 5));
   QCOMPARE(matClrOut(1, 1), PiiColor<>(4, 5, 6));
   QCOMPARE(matClrOut(1, 2), PiiColor<>(5, 6, 7));
+
+  // Large windows on 8-bit images use histograms. Compare to the
+  // generic algorithm.
+  PiiMatrix<uchar> matImage(37, 41);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 71 + c * 13 + r * c * 7) & 0xff);
+  PiiMatrix<int> matIntImage(matImage);
+  for (int iSize = 3; iSize <= 17; iSize += 7)
+    for (int mode = Pii::ExtendZeros; mode <= Pii::ExtendNot; ++mode)
+      {
+        Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+        QVERIFY(Pii::equals(PiiMatrix<int>(PiiImage::medianFilter(matImage, iSize, iSize + 1, extendMode)),
+                            PiiImage::medianFilter(matIntImage, iSize, iSize + 1, extendMode)));
+      }
+}
+
+namespace
+{
+  struct HistogramChecker
+  {
+    HistogramChecker(const PiiMatrix<uchar>& image) : matImage(image), iPositions(0), bOk(true) {}
+
+    void operator() (int r, int c, PiiSlidingHistogram& histogram)
+    {
+      ++iPositions;
+      std::vector<int> vecSorted;
+      for (int i=r; i<r+histogram.windowRows(); ++i)
+        for (int j=c; j<c+histogram.windowColumns(); ++j)
+          vecSorted.push_back(matImage(i,j));
+      std::sort(vecSorted.begin(), vecSorted.end());
+      // Alternate between queries to exercise the lazy updates.
+      switch ((r + c) % 4)
+        {
+        case 0:
+          bOk = bOk && histogram.median() == vecSorted[(vecSorted.size() - 1) / 2];
+          break;
+        case 1:
+          bOk = bOk && histogram.rankValue(1) == vecSorted.front() &&
+            histogram.rankValue(int(vecSorted.size())) == vecSorted.back();
+          break;
+        case 2:
+          {
+            const int iLevel = matImage(r,c);
+            bOk = bOk && histogram.count(iLevel) == int(std::count(vecSorted.begin(), vecSorted.end(), iLevel)) &&
+              histogram.cumulativeCount(iLevel) == int(std::upper_bound(vecSorted.begin(), vecSorted.end(), iLevel) -
+                                                       vecSorted.begin());
+          }
+          break;
+        default:
+          {
+            const int* pBins = histogram.bins();
+            for (int i=0; i<histogram.levels(); ++i)
+              bOk = bOk && pBins[i] == int(std::count(vecSorted.begin(), vecSorted.end(), i));
+          }
+        }
+    }
+
+    PiiMatrix<uchar> matImage;
+    int iPositions;
+    bool bOk;
+  };
+}
+
+void TestPiiImage::slidingHistogram()
+{
+  PiiMatrix<uchar> matImage(23, 31);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 37 + c * 11 + r * c * 5) % 100);
+
+  PiiSlidingHistogram histogram(100);
+  HistogramChecker checker(matImage);
+  QVERIFY(histogram.scan(matImage, 5, 8, checker));
+  QCOMPARE(histogram.windowSize(), 40);
+  QCOMPARE(checker.iPositions, 19 * 24);
+  QVERIFY(checker.bOk);
+
+  HistogramChecker checker2(matImage);
+  QVERIFY(!histogram.scan(matImage, 24, 3, checker2));
+  QCOMPARE(checker2.iPositions, 0);
+}
+
+void TestPiiImage::percentileFilter()
+{
+  PiiMatrix<uchar> matImage(19, 26);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 71 + c * 13 + r * c * 7) & 0xff);
+
+  // Zeros and ones give minimum and maximum filters.
+  QVERIFY(Pii::equals(PiiImage::percentileFilter(matImage, 0.0, 5),
+                      PiiImage::minFilter(matImage, 5, 5)));
+  QVERIFY(Pii::equals(PiiImage::percentileFilter(matImage, 1.0, 5),
+                      PiiImage::maxFilter(matImage, 5, 5)));
+  // 0.5 is the median.
+  QVERIFY(Pii::equals(PiiImage::percentileFilter(matImage, 0.5, 7, 4, Pii::ExtendZeros),
+                      PiiImage::medianFilter(matImage, 7, 4, Pii::ExtendZeros)));
+  PiiMatrix<uchar> matValid(PiiImage::percentileFilter(matImage, 0.25, 3, 0, Pii::ExtendNot));
+  QCOMPARE(matValid.rows(), 17);
+  QCOMPARE(matValid.columns(), 24);
+  for (int r=0; r<matValid.rows(); ++r)
+    for (int c=0; c<matValid.columns(); ++c)
+      {
+        std::vector<int> vecSorted;
+        for (int i=r; i<r+3; ++i)
+          for (int j=c; j<c+3; ++j)
+            vecSorted.push_back(matImage(i,j));
+        std::sort(vecSorted.begin(), vecSorted.end());
+        // ceil(0.25 * 9) = 3
+        QCOMPARE(int(matValid(r,c)), vecSorted[2]);
+      }
 }
 
 void TestPiiImage::backProject()
@@ -1240,6 +1748,58 @@ void TestPiiImage::equalize()
                                                                 24,24,24,24,
                                                                 31,31,31,31)));
 }
+void TestPiiImage::equalizeLocally()
+{
+  PiiMatrix<uchar> img(40,64);
+  for (int r=0; r<img.rows(); ++r)
+    for (int c=0; c<img.columns(); ++c)
+      img(r,c) = uchar((r * 7 + c * 13) % 97 + (c < 32 ? 0 : 150));
+
+  // A single tile without clipping maps through the cumulative
+  // distribution.
+  {
+    PiiMatrix<int> matCumulative(PiiImage::cumulative(PiiImage::histogram(img, 256)));
+    PiiMatrix<uchar> matExpected(img.rows(), img.columns());
+    for (int r=0; r<img.rows(); ++r)
+      for (int c=0; c<img.columns(); ++c)
+        matExpected(r,c) = uchar(255.0f * matCumulative(0, img(r,c)) / img.rows() / img.columns() + 0.5f);
+    PiiMatrix<uchar> matResult(PiiImage::equalizeLocally(img, 100, 100, 256));
+    for (int r=0; r<img.rows(); ++r)
+      for (int c=0; c<img.columns(); ++c)
+        QVERIFY(Pii::abs(int(matResult(r,c)) - int(matExpected(r,c))) <= 1);
+  }
+
+  // Extreme clipping flattens the histogram, and the mapping becomes
+  // almost linear.
+  {
+    PiiMatrix<uchar> matFull(16,16);
+    for (int i=0; i<256; ++i)
+      matFull(i/16, i%16) = uchar(i);
+    PiiMatrix<uchar> matResult(PiiImage::equalizeLocally(matFull, 16, 16, 256, 1e-6));
+    for (int i=0; i<256; ++i)
+      QVERIFY(Pii::abs(int(matResult(i/16, i%16)) - i) <= 1);
+  }
+
+  // With two tiles, the dark left half is stretched to the full
+  // range.
+  {
+    PiiMatrix<uchar> matResult(PiiImage::equalizeLocally(img, 40, 32, 256));
+    int iMax = 0;
+    for (int r=0; r<img.rows(); ++r)
+      for (int c=0; c<8; ++c)
+        iMax = qMax(iMax, int(matResult(r,c)));
+    QVERIFY(iMax >= 250);
+  }
+
+  // If all tiles have the same mapping, interpolation changes
+  // nothing.
+  {
+    PiiMatrix<uchar> matFlat(PiiMatrix<uchar>::constant(30,50, 100));
+    PiiMatrix<uchar> matResult(PiiImage::equalizeLocally(matFlat, 10, 10, 256));
+    QVERIFY(Pii::equals(matResult, PiiMatrix<uchar>::constant(30,50, 255)));
+  }
+}
+
 void TestPiiImage::histogram()
 {
   //Testing basic functionality of PiiHistogram-class
@@ -1262,6 +1822,114 @@ void TestPiiImage::histogram()
 
 
 }
+namespace
+{
+  struct FunctionalRoi
+  {
+    FunctionalRoi(const PiiMatrix<bool>& mask) : matMask(mask) {}
+    bool operator() (int r, int c) const { return matMask(r,c); }
+    PiiMatrix<bool> matMask;
+  };
+}
+
+void TestPiiImage::fastHistogram()
+{
+  // 8 and 16-bit images with a mask ROI use the interleaved
+  // sub-histograms. Compare to the generic implementation used with
+  // an int image and a functional ROI.
+  srand(2);
+  PiiMatrix<uchar> image8(45, 67);
+  PiiMatrix<unsigned short> image16(45, 67);
+  PiiMatrix<bool> mask(45, 67);
+  for (int r=0; r<image8.rows(); ++r)
+    for (int c=0; c<image8.columns(); ++c)
+      {
+        image8(r,c) = uchar(rand() % 256);
+        image16(r,c) = (unsigned short)(rand() % 1000);
+        mask(r,c) = rand() % 3 == 0;
+      }
+  PiiMatrix<int> intImage8(image8), intImage16(image16);
+  FunctionalRoi maskRoi(mask);
+
+  // Zero levels, full range and values out of range
+  unsigned int levels[] = { 0, 256, 100 };
+  for (int i=0; i<3; ++i)
+    {
+      QVERIFY(Pii::equals(PiiImage::histogram(image8, levels[i]),
+                          PiiImage::histogram(intImage8, levels[i])));
+      QVERIFY(Pii::equals(PiiImage::histogram(image16, levels[i]),
+                          PiiImage::histogram(intImage16, levels[i])));
+      QVERIFY(Pii::equals(PiiImage::histogram(image8, mask, levels[i]),
+                          PiiImage::histogram(intImage8, maskRoi, levels[i])));
+      for (int iThreads=1; iThreads<=4; ++iThreads)
+        {
+          PiiParallelPolicy policy(iThreads, 1);
+          QVERIFY(Pii::equals(PiiImage::histogram<int>(image8, mask, levels[i], policy),
+                              PiiImage::histogram(intImage8, maskRoi, levels[i])));
+          QVERIFY(Pii::equals(PiiImage::histogram<int>(image16, PiiImage::DefaultRoi(), levels[i], policy),
+                              PiiImage::histogram(intImage16, levels[i])));
+        }
+    }
+}
+
+void TestPiiImage::runLengthRoi()
+{
+  // Overlapping and adjacent rectangles are joined, and rectangles
+  // outside of the image are ignored.
+  PiiMatrix<int> matRects(4, 4,
+                          1, 1, 3, 2,
+                          2, 2, 4, 2,
+                          6, 2, 1, 1,
+                          5, 5, 10, 10);
+  PiiImage::RunLengthRoi roi(PiiImage::RunLengthRoi::fromRectangles(6, 8, matRects));
+  QCOMPARE(roi.rows(), 6);
+  QCOMPARE(roi.columns(), 8);
+  QCOMPARE(roi.spanCount(0), 0);
+  QCOMPARE(roi.spanCount(1), 1);
+  QCOMPARE(roi.spanCount(2), 1);
+  QCOMPARE(roi.rowBegin(2)->start, 1);
+  QCOMPARE(roi.rowBegin(2)->end, 7);
+  QCOMPARE(roi.spanCount(3), 1);
+  QCOMPARE(roi.pixelCount(), 3 + 6 + 4);
+  QVERIFY(Pii::equals(roi.toMask(), PiiImage::createRoiMask(6, 8, matRects)));
+  QVERIFY(!roi(0,0));
+  QVERIFY(roi(1,1));
+  QVERIFY(!roi(1,4));
+  QVERIFY(roi(2,6));
+
+  int iFirst = 0, iEnd = 8;
+  QVERIFY(!PiiImage::clipToRoi(roi, 0, iFirst, iEnd));
+  QVERIFY(PiiImage::clipToRoi(roi, 3, iFirst, iEnd));
+  QCOMPARE(iFirst, 2);
+  QCOMPARE(iEnd, 6);
+
+  // Masks survive a round trip, and histograms match those
+  // calculated with a mask.
+  srand(3);
+  PiiMatrix<uchar> image(37, 53);
+  PiiMatrix<bool> mask(37, 53);
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.columns(); ++c)
+      {
+        image(r,c) = uchar(rand() % 256);
+        mask(r,c) = r % 5 != 0 && rand() % 4 == 0;
+      }
+  PiiImage::RunLengthRoi maskRoi(PiiImage::RunLengthRoi::fromMask(mask));
+  QVERIFY(Pii::equals(maskRoi.toMask(), mask));
+  QCOMPARE(maskRoi.pixelCount(), Pii::sum<int>(mask));
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.columns(); ++c)
+      QCOMPARE(maskRoi(r,c), mask(r,c));
+
+  PiiMatrix<int> intImage(image);
+  QVERIFY(Pii::equals(PiiImage::histogram(image, maskRoi, 256),
+                      PiiImage::histogram(image, mask, 256)));
+  QVERIFY(Pii::equals(PiiImage::histogram(intImage, maskRoi, 256),
+                      PiiImage::histogram(image, mask, 256)));
+  QVERIFY(Pii::equals(PiiImage::histogram<int>(image, maskRoi, 256, PiiParallelPolicy(3, 1)),
+                      PiiImage::histogram(image, mask, 256)));
+}
+
 void TestPiiImage::cumulative()
 {
   //Testing basic functionality of PiiHistogram-class
@@ -1547,6 +2215,304 @@ void TestPiiImage::labelImage()
                       mat8 > 2));
 }
 
+void TestPiiImage::labelRuns()
+{
+  PiiMatrix<int> mat(8,8,
+                     1,1,1,0,0,0,0,0,
+                     0,1,0,1,1,1,0,1,
+                     0,1,0,1,0,1,0,1,
+                     0,0,1,1,0,1,1,1,
+                     0,1,1,0,1,0,0,1,
+                     0,0,1,0,0,0,1,1,
+                     0,0,1,1,1,1,0,0,
+                     1,0,0,0,0,1,1,1);
+
+  int count = 0;
+  QVector<PiiImage::LabeledRun> runs = PiiImage::labelRuns(mat,
+                                                           std::bind2nd(std::not_equal_to<int>(), 0),
+                                                           PiiImage::Connect4,
+                                                           &count);
+  QCOMPARE(count, 4);
+  QCOMPARE(runs.size(), 18);
+  QCOMPARE(runs[0].row, 0);
+  QCOMPARE(runs[0].start, 0);
+  QCOMPARE(runs[0].end, 3);
+  QCOMPARE(runs[0].label, 1);
+  QCOMPARE(runs[17].row, 7);
+  QCOMPARE(runs[17].start, 5);
+  QCOMPARE(runs[17].end, 8);
+  QCOMPARE(runs[17].label, 2);
+
+  PiiMatrix<int> labels(8,8);
+  PiiImage::paintRuns(runs, labels);
+  QVERIFY(Pii::equals(labels, PiiImage::labelImage(mat)));
+
+  PiiMatrix<int> areas, centroids, bbox;
+  PiiImage::calculateProperties(runs, count, areas, centroids, bbox);
+  QVERIFY(Pii::equals(areas, PiiMatrix<int>(4,1, 5,25,1,1)));
+  QCOMPARE(bbox(1,0), 1);
+  QCOMPARE(bbox(1,1), 1);
+  QCOMPARE(bbox(1,2), 7);
+  QCOMPARE(bbox(1,3), 7);
+
+  // Random images must label equally irrespective of the number of
+  // strips.
+  srand(0);
+  for (int i=0; i<50; ++i)
+    {
+      PiiMatrix<int> matRandom(1 + rand() % 50, 1 + rand() % 50);
+      for (int r=0; r<matRandom.rows(); ++r)
+        for (int c=0; c<matRandom.columns(); ++c)
+          matRandom(r,c) = rand() % 3 == 0 ? 1 : 0;
+      int iCount4 = 0, iCount8 = 0, iParallelCount = 0;
+      PiiMatrix<int> matLabels4 = PiiImage::labelImage(matRandom, &iCount4);
+      PiiMatrix<int> matLabels8 = PiiImage::labelImage(matRandom,
+                                                       std::bind2nd(std::not_equal_to<int>(), 0),
+                                                       Pii::YesFunction<bool>(),
+                                                       PiiImage::Connect8,
+                                                       false, 0, INT_MAX,
+                                                       &iCount8);
+      for (int iThreads=1; iThreads<=4; ++iThreads)
+        {
+          QVERIFY(Pii::equals(PiiImage::labelImage(matRandom,
+                                                   std::bind2nd(std::not_equal_to<int>(), 0),
+                                                   PiiImage::Connect4,
+                                                   PiiParallelPolicy(iThreads, 1),
+                                                   &iParallelCount),
+                              matLabels4));
+          QCOMPARE(iParallelCount, iCount4);
+          QVERIFY(Pii::equals(PiiImage::labelImage(matRandom,
+                                                   std::bind2nd(std::not_equal_to<int>(), 0),
+                                                   PiiImage::Connect8,
+                                                   PiiParallelPolicy(iThreads, 1),
+                                                   &iParallelCount),
+                              matLabels8));
+          QCOMPARE(iParallelCount, iCount8);
+        }
+    }
+}
+
+// Describes each labeled object as "top left width height area
+// perimeter" and sorts the descriptions.
+static QStringList describeObjects(const PiiMatrix<int>& labels, int count)
+{
+  QVector<int> vecAreas(count + 1), vecPerimeters(count + 1);
+  QVector<int> vecLeft(count + 1, INT_MAX), vecRight(count + 1, -1);
+  QVector<int> vecTop(count + 1, INT_MAX), vecBottom(count + 1, -1);
+  for (int r=0; r<labels.rows(); ++r)
+    for (int c=0; c<labels.columns(); ++c)
+      {
+        const int l = labels(r,c);
+        if (l == 0)
+          continue;
+        ++vecAreas[l];
+        vecLeft[l] = qMin(vecLeft[l], c);
+        vecRight[l] = qMax(vecRight[l], c);
+        vecTop[l] = qMin(vecTop[l], r);
+        vecBottom[l] = qMax(vecBottom[l], r);
+        vecPerimeters[l] += (r == 0 || labels(r-1,c) != l) +
+          (r == labels.rows()-1 || labels(r+1,c) != l) +
+          (c == 0 || labels(r,c-1) != l) +
+          (c == labels.columns()-1 || labels(r,c+1) != l);
+      }
+  QStringList lstResult;
+  for (int l=1; l<=count; ++l)
+    lstResult << QString("%1 %2 %3 %4 %5 %6").arg(vecTop[l]).arg(vecLeft[l])
+      .arg(vecRight[l] - vecLeft[l] + 1).arg(vecBottom[l] - vecTop[l] + 1)
+      .arg(vecAreas[l]).arg(vecPerimeters[l]);
+  lstResult.sort();
+  return lstResult;
+}
+
+void TestPiiImage::streamLabeler()
+{
+  srand(1);
+  for (int i=0; i<40; ++i)
+    {
+      PiiMatrix<int> matRandom(1 + rand() % 60, 1 + rand() % 30);
+      for (int r=0; r<matRandom.rows(); ++r)
+        for (int c=0; c<matRandom.columns(); ++c)
+          matRandom(r,c) = rand() % 3 == 0 ? 1 : 0;
+
+      for (int iConnectivity=0; iConnectivity<2; ++iConnectivity)
+        {
+          PiiImage::Connectivity connectivity = iConnectivity == 0 ? PiiImage::Connect4 : PiiImage::Connect8;
+          int iCount = 0;
+          PiiMatrix<int> matLabels = PiiImage::labelImage(matRandom,
+                                                          std::bind2nd(std::not_equal_to<int>(), 0),
+                                                          Pii::YesFunction<bool>(),
+                                                          connectivity,
+                                                          false, 0, INT_MAX,
+                                                          &iCount);
+
+          // Feed the image in strips of random height.
+          PiiImage::StreamLabeler labeler(connectivity);
+          QVector<PiiImage::StreamLabeler::Object> vecObjects;
+          for (int r=0; r<matRandom.rows(); )
+            {
+              const int iStripRows = qMin(1 + rand() % 7, matRandom.rows() - r);
+              const PiiMatrix<int> matStrip(matRandom(r, 0, iStripRows, -1));
+              labeler.addStrip(matStrip, std::bind2nd(std::not_equal_to<int>(), 0));
+              QCOMPARE(labeler.rowCount(), qint64(r + iStripRows));
+
+              // The runs of the strip must cover its object pixels exactly.
+              PiiMatrix<int> matStripLabels(iStripRows, matRandom.columns());
+              PiiImage::paintRuns(labeler.stripRuns(), matStripLabels);
+              for (int sr=0; sr<iStripRows; ++sr)
+                for (int c=0; c<matStrip.columns(); ++c)
+                  QCOMPARE(matStripLabels(sr,c) != 0, matStrip(sr,c) != 0);
+
+              vecObjects << labeler.takeClosedObjects();
+              r += iStripRows;
+            }
+          labeler.closeAll();
+          vecObjects << labeler.takeClosedObjects();
+          QCOMPARE(labeler.openObjectCount(), 0);
+          QCOMPARE(vecObjects.size(), iCount);
+
+          QStringList lstStreamed;
+          for (int o=0; o<vecObjects.size(); ++o)
+            {
+              const PiiImage::StreamLabeler::Object& obj = vecObjects[o];
+              lstStreamed << QString("%1 %2 %3 %4 %5 %6").arg(obj.top).arg(obj.left)
+                .arg(obj.right - obj.left + 1).arg(obj.bottom - obj.top + 1)
+                .arg(obj.area).arg(obj.perimeter);
+            }
+          lstStreamed.sort();
+          QCOMPARE(lstStreamed, describeObjects(matLabels, iCount));
+        }
+    }
+}
+
+void TestPiiImage::objectFeatureAccumulator()
+{
+  PiiMatrix<int> mat(4,6,
+                     0,1,0,0,0,0,
+                     1,1,1,0,1,1,
+                     0,1,0,0,1,1,
+                     0,0,0,0,1,1);
+  PiiImage::ObjectFeatureAccumulator features;
+  int count = 0;
+  PiiImage::labelRuns(mat,
+                      std::bind2nd(std::not_equal_to<int>(), 0),
+                      PiiImage::Connect4,
+                      features,
+                      &count);
+  QCOMPARE(count, 2);
+  QCOMPARE(features.objectCount(), 2);
+  QVERIFY(Pii::equals(features.areas(), PiiMatrix<int>(2,1, 5,6)));
+  QVERIFY(Pii::equals(features.centroids(), PiiMatrix<int>(2,2, 1,1, 5,2)));
+  QVERIFY(Pii::equals(features.boundingBoxes(), PiiMatrix<int>(2,4, 0,0,3,3, 4,1,2,3)));
+  QVERIFY(Pii::equals(features.perimeters(), PiiMatrix<int>(2,1, 12,10)));
+
+  const PiiImage::ObjectFeatureAccumulator::Object& cross = features.object(0);
+  QVERIFY(Pii::almostEqualRel(cross.mu20(), 0.4));
+  QVERIFY(Pii::almostEqualRel(cross.mu02(), 0.4));
+  QVERIFY(Pii::abs(cross.mu11()) < 1e-10);
+
+  // A vertical rectangle is oriented along the y axis.
+  const PiiImage::ObjectFeatureAccumulator::Object& rect = features.object(1);
+  QVERIFY(Pii::almostEqualRel(Pii::abs(rect.orientation()), M_PI/2));
+  double dMajor = 0, dMinor = 0;
+  rect.axes(&dMajor, &dMinor);
+  QVERIFY(Pii::almostEqualRel(dMajor, std::sqrt(2.0/3)));
+  QVERIFY(Pii::almostEqualRel(dMinor, 0.5));
+
+  // Must agree with calculateProperties() on the label image.
+  PiiMatrix<int> areas, centroids, bbox;
+  PiiImage::calculateProperties(PiiImage::labelImage(mat), 2, areas, centroids, bbox);
+  QVERIFY(Pii::equals(areas, features.areas()));
+  QVERIFY(Pii::equals(centroids, features.centroids()));
+  QVERIFY(Pii::equals(bbox, features.boundingBoxes()));
+}
+
+void TestPiiImage::bitMatrix()
+{
+  // Bit-packed images must give the same results as byte images.
+  srand(3);
+  PiiMatrix<uchar> matGray(37, 141);
+  for (int r=0; r<matGray.rows(); ++r)
+    for (int c=0; c<matGray.columns(); ++c)
+      matGray(r,c) = uchar(rand() % 256);
+
+  PiiMatrix<uchar> matImage(PiiImage::threshold(matGray, uchar(64)));
+  PiiBitMatrix matBits(PiiImage::thresholdBits(matGray, uchar(64)));
+  QVERIFY(Pii::equals(matBits.toMatrix<uchar>(), matImage));
+  QVERIFY(Pii::equals(PiiImage::inverseThresholdBits(matGray, uchar(64)).toMatrix<uchar>(),
+                      PiiImage::inverseThreshold(matGray, uchar(64))));
+
+  PiiImage::MaskType types[] = { PiiImage::RectangularMask, PiiImage::EllipticalMask, PiiImage::DiamondMask };
+  PiiImage::MorphologyOperation operations[] = { PiiImage::Erode, PiiImage::Dilate, PiiImage::Open,
+                                                 PiiImage::Close, PiiImage::TopHat, PiiImage::BottomHat };
+  for (int t=0; t<3; ++t)
+    for (int size=1; size<=21; size+=5)
+      {
+        PiiMatrix<int> mask(PiiImage::createMask<int>(types[t], size, size/2 + 1));
+        for (int o=0; o<6; ++o)
+          QVERIFY(Pii::equals(PiiImage::morphology(matBits, mask, operations[o]).toMatrix<uchar>(),
+                              PiiImage::morphology(matImage, mask, operations[o])));
+        QVERIFY(Pii::equals(PiiImage::erode(matBits, mask, true).toMatrix<uchar>(),
+                            PiiImage::erode(matImage, mask, true)));
+      }
+
+  for (int m=0; m<8; ++m)
+    QVERIFY(Pii::equals(PiiImage::hitAndMiss(matBits, PiiImage::borderMasks[m][0],
+                                             PiiImage::borderMasks[m][1]).toMatrix<uchar>(),
+                        PiiImage::hitAndMiss(matImage, PiiImage::borderMasks[m][0],
+                                             PiiImage::borderMasks[m][1])));
+  QVERIFY(Pii::equals(PiiImage::thin(matBits, 2).toMatrix<uchar>(), PiiImage::thin(matImage, 2)));
+  QVERIFY(Pii::equals(PiiImage::thin(matBits, -1).toMatrix<uchar>(), PiiImage::thin(matImage, -1)));
+
+  // Labeling
+  for (int i=0; i<2; ++i)
+    {
+      PiiImage::Connectivity connectivity = i == 0 ? PiiImage::Connect4 : PiiImage::Connect8;
+      int iBitLabels = 0, iLabels = 0, iInverseBitLabels = 0, iInverseLabels = 0;
+      QVector<PiiImage::LabeledRun> vecBitRuns(PiiImage::labelRuns(matBits, connectivity, &iBitLabels));
+      QVector<PiiImage::LabeledRun> vecRuns(PiiImage::labelRuns(matImage,
+                                                                std::bind2nd(std::not_equal_to<uchar>(), 0),
+                                                                connectivity, &iLabels));
+      QCOMPARE(iBitLabels, iLabels);
+      QCOMPARE(vecBitRuns.size(), vecRuns.size());
+      for (int j=0; j<vecRuns.size(); ++j)
+        {
+          QCOMPARE(vecBitRuns[j].row, vecRuns[j].row);
+          QCOMPARE(vecBitRuns[j].start, vecRuns[j].start);
+          QCOMPARE(vecBitRuns[j].end, vecRuns[j].end);
+          QCOMPARE(vecBitRuns[j].label, vecRuns[j].label);
+        }
+      QVERIFY(Pii::equals(PiiImage::labelImage(matBits, std::bind2nd(std::equal_to<bool>(), false),
+                                               connectivity, PiiParallelPolicy(3, 1), &iInverseBitLabels),
+                          PiiImage::labelImage(matImage, std::bind2nd(std::equal_to<uchar>(), 0),
+                                               connectivity, PiiParallelPolicy::sequential(), &iInverseLabels)));
+      QCOMPARE(iInverseBitLabels, iInverseLabels);
+    }
+
+  // Boundaries
+  PiiBoundaryFinder bitFinder(matBits.rows(), matBits.columns()), finder(matImage.rows(), matImage.columns());
+  PiiMatrix<int> matBitPoints(0,2), matPoints(0,2);
+  while (finder.findNextBoundary(matImage, std::bind2nd(std::greater<uchar>(), 0), matPoints) != 0)
+    QVERIFY(bitFinder.findNextBoundary(matBits, std::bind2nd(std::equal_to<bool>(), true), matBitPoints) != 0);
+  QVERIFY(Pii::equals(matBitPoints, matPoints));
+
+  PiiBoundaryFinder fastFinder(matBits.rows(), matBits.columns());
+  PiiMatrix<int> matFastPoints(0,2);
+  while (fastFinder.findNextBoundary(matBits, matFastPoints) != 0) ;
+  QVERIFY(Pii::equals(matFastPoints, matPoints));
+  QVERIFY(Pii::equals(fastFinder.boundaryMask(), finder.boundaryMask()));
+
+  PiiMatrix<uchar> matMask, matParallelMask;
+  QList<PiiMatrix<int> > lstBoundaries(PiiBoundaryFinder::findBoundaries<int>(matImage,
+                                                                             std::bind2nd(std::greater<uchar>(), 0),
+                                                                             &matMask));
+  QList<PiiMatrix<int> > lstParallelBoundaries(PiiBoundaryFinder::findBoundaries<int>(matBits, &matParallelMask,
+                                                                                     PiiParallelPolicy(3, 1)));
+  QCOMPARE(lstParallelBoundaries.size(), lstBoundaries.size());
+  for (int i=0; i<lstBoundaries.size(); ++i)
+    QVERIFY(Pii::equals(lstParallelBoundaries[i], lstBoundaries[i]));
+  QVERIFY(Pii::equals(matParallelMask, matMask));
+}
+
 void TestPiiImage::labelLargerThan()
 {
   PiiMatrix<int> source(6,5,
@@ -1990,6 +2956,24 @@ void TestPiiImage::findBoundaries()
                                                      0,0,0,0,0,0,0,0)));
 }
 
+void TestPiiImage::percentileThreshold()
+{
+  PiiMatrix<uchar> matImage(16, 21);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 29 + c * 17 + r * c * 3) & 0xff);
+
+  PiiMatrix<uchar> matLocal(PiiImage::percentileFilter(matImage, 0.75, 9, 5));
+  PiiMatrix<uchar> matBinary(PiiImage::percentileThreshold(matImage,
+                                                           PiiImage::ThresholdFunction<uchar,uchar,int>(),
+                                                           0.75, 3, 9, 5));
+  QCOMPARE(matBinary.rows(), matImage.rows());
+  QCOMPARE(matBinary.columns(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      QCOMPARE(int(matBinary(r,c)), matImage(r,c) >= matLocal(r,c) + 3 ? 1 : 0);
+}
+
 void TestPiiImage::threshold()
 {
   QVERIFY(Pii::equals(PiiImage::threshold(_matThreshold, 5),
@@ -2177,6 +3161,198 @@ void TestPiiImage::filter()
   }
 }
 
+void TestPiiImage::vectorizedFilter()
+{
+  // Odd sizes exercise the scalar tail of the vectorized loops.
+  PiiMatrix<uchar> matImage(45,67);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 37 + c * 11 + r * c) & 0xff);
+  PiiMatrix<ushort> matImage16(Pii::matrix(PiiMatrix<ushort>(matImage) * ushort(200)));
+  PiiMatrix<float> matFloatImage(matImage);
+  matFloatImage /= 7;
+  PiiMatrix<PiiHalf> matHalfImage(Pii::floatToHalf(matFloatImage));
+
+  PiiMatrix<int> matMask(5,5,
+                         1, -2, 3, 0, 1,
+                         0, 4, -1, 2, 2,
+                         7, 0, 0, -3, 1,
+                         1, 1, 1, 1, 1,
+                         -5, 2, 0, 0, 3);
+  PiiMatrix<float> matFloatMask(matMask);
+  matFloatMask /= 9;
+
+  const int iFeatures = Pii::cpuFeatureMask();
+  for (int mode = Pii::ExtendZeros; mode <= Pii::ExtendNot; ++mode)
+    {
+      Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+      Pii::setCpuFeatureMask(-1);
+      PiiMatrix<int> matInt1 = PiiImage::filter<int>(matImage, matMask, extendMode);
+      PiiMatrix<int> matInt2 = PiiImage::filter<int>(matImage16, matMask, extendMode);
+      PiiMatrix<int> matSobel = PiiImage::filter<int>(matImage, PiiImage::SobelYFilter, extendMode);
+      PiiMatrix<float> matFloat1 = PiiImage::filter<float>(matImage, matFloatMask, extendMode);
+      PiiMatrix<float> matFloat2 = PiiImage::filter<float>(matFloatImage, matFloatMask, extendMode);
+      PiiMatrix<float> matGauss = PiiImage::filter<float>(matImage, PiiImage::GaussianFilter, extendMode, 7);
+      PiiMatrix<float> matHalf = PiiImage::filter<float>(matHalfImage, matFloatMask, extendMode);
+      QVERIFY(Pii::equals(matHalf, PiiImage::filter<float>(Pii::halfToFloat(matHalfImage), matFloatMask, extendMode)));
+
+      // Disable all optimizations and compare to generic code.
+      Pii::setCpuFeatureMask(0);
+      QVERIFY(Pii::equals(matInt1, PiiImage::filter<int>(matImage, matMask, extendMode)));
+      QVERIFY(Pii::equals(matInt2, PiiImage::filter<int>(matImage16, matMask, extendMode)));
+      QVERIFY(Pii::equals(matSobel, PiiImage::filter<int>(matImage, PiiImage::SobelYFilter, extendMode)));
+      // With zero padding, the generic code sums in different order.
+      QVERIFY(Pii::almostEqual(matFloat1, PiiImage::filter<float>(matImage, matFloatMask, extendMode), 1e-3));
+      QVERIFY(Pii::almostEqual(matFloat2, PiiImage::filter<float>(matFloatImage, matFloatMask, extendMode), 1e-3));
+      QVERIFY(Pii::almostEqual(matGauss, PiiImage::filter<float>(matImage, PiiImage::GaussianFilter, extendMode, 7), 1e-3));
+      QVERIFY(Pii::almostEqual(matHalf, PiiImage::filter<float>(matHalfImage, matFloatMask, extendMode), 1e-3));
+    }
+  Pii::setCpuFeatureMask(iFeatures);
+}
+
+void TestPiiImage::parallelFilter()
+{
+  PiiMatrix<uchar> matImage(203,61);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 13 + c * 7 + r * c) & 0xff);
+
+  PiiMatrix<int> matMask(3,4,
+                         1, -2, 3, 0,
+                         0, 4, -1, 2,
+                         7, 0, 0, -3);
+  PiiMatrix<int> matH(1,5, 1, 4, 6, 4, 1), matV(3,1, -1, 0, 1);
+
+  // Uneven strips that are smaller than the filter
+  const PiiParallelPolicy policy(7, 1);
+  QCOMPARE(policy.stripCount(matImage.rows()), 7);
+  QCOMPARE(PiiParallelPolicy::sequential().stripCount(matImage.rows()), 1);
+  QCOMPARE(PiiParallelPolicy(4, 64).stripCount(100), 1);
+
+  for (int mode = Pii::ExtendZeros; mode <= Pii::ExtendNot; ++mode)
+    {
+      Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+      QVERIFY(Pii::equals(PiiImage::filter<int>(matImage, matMask, extendMode, policy),
+                          PiiImage::filter<int>(matImage, matMask, extendMode)));
+      QVERIFY(Pii::equals(PiiImage::filter<int>(matImage, matH, matV, extendMode, policy),
+                          PiiImage::filter<int>(matImage, matH, matV, extendMode)));
+    }
+
+  QVERIFY(Pii::equals(PiiImage::threshold(matImage, PiiImage::ThresholdFunction<uchar>(), uchar(100), policy),
+                      PiiImage::threshold(matImage, uchar(100))));
+}
+
+void TestPiiImage::fftFilter()
+{
+  PiiMatrix<uchar> matImage(71,93);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 37 + c * 11 + r * c) & 0xff);
+  PiiMatrix<double> matMask(17,13);
+  for (int r=0; r<matMask.rows(); ++r)
+    for (int c=0; c<matMask.columns(); ++c)
+      matMask(r,c) = double((r * 5 + c * 3) % 7 - 3) / 16;
+
+  PiiMatrix<double> matDirect(PiiDsp::filter<double>(matImage, matMask, PiiDsp::FilterValidPart));
+  QCOMPARE(matDirect.rows(), 55);
+  QCOMPARE(matDirect.columns(), 81);
+  // Automatic tile size, single and double precision
+  QVERIFY(Pii::almostEqual(PiiImage::fftFilterValidPart<double>(matImage, matMask), matDirect, 1e-9));
+  QVERIFY(Pii::almostEqual(PiiImage::fftFilterValidPart<float>(matImage, matMask), PiiMatrix<float>(matDirect), 1e-2));
+  // Many tiles that don't divide the image evenly.
+  QVERIFY(Pii::almostEqual(PiiImage::fftFilterValidPart<double>(matImage, matMask, 20, 16), matDirect, 1e-9));
+  // Tiles smaller than the filter are enlarged.
+  QVERIFY(Pii::almostEqual(PiiImage::fftFilterValidPart<double>(matImage, matMask, 1, 1), matDirect, 1e-9));
+  // Filter larger than the image
+  QCOMPARE(PiiImage::fftFilterValidPart<double>(matMask, matImage).rows(), 0);
+
+  int iTileRows = 0, iTileColumns = 0;
+  QVERIFY(!PiiImage::planFftFilter(512, 512, 3, 3, 9, false, &iTileRows, &iTileColumns));
+  QVERIFY(PiiImage::planFftFilter(512, 512, 31, 31, 961, true, &iTileRows, &iTileColumns));
+  QVERIFY(iTileRows >= 31 && iTileRows <= 1024);
+  QVERIFY(iTileColumns >= 31 && iTileColumns <= 1024);
+  QVERIFY(!PiiImage::planFftFilter(20, 20, 31, 31, 961, true, &iTileRows, &iTileColumns));
+
+  // filter() switches to the frequency domain automatically.
+  PiiMatrix<double> matGauss(PiiImage::makeGaussian(25));
+  QVERIFY((PiiImage::isFftFilterFaster<double,uchar>(matImage.rows(), matImage.columns(), matGauss)));
+  QVERIFY((!PiiImage::isFftFilterFaster<int,uchar>(matImage.rows(), matImage.columns(), PiiMatrix<int>(matGauss))));
+  for (int mode = Pii::ExtendZeros; mode <= Pii::ExtendNot; ++mode)
+    {
+      Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+      PiiMatrix<double> matExpected;
+      if (extendMode == Pii::ExtendZeros)
+        matExpected = PiiDsp::filter<double>(matImage, matGauss, PiiDsp::FilterOriginalSize);
+      else
+        matExpected = PiiDsp::filter<double>(Pii::extend(matImage, 12, 12, 12, 12, extendMode),
+                                             matGauss, PiiDsp::FilterValidPart);
+      QVERIFY(Pii::almostEqual(PiiImage::filter<double>(matImage, matGauss, extendMode), matExpected, 1e-9));
+      QVERIFY(Pii::almostEqual(PiiImage::filter<double>(matImage, matGauss, extendMode, PiiParallelPolicy(3, 1)),
+                               matExpected, 1e-9));
+    }
+}
+
+void TestPiiImage::boxFilter()
+{
+  PiiMatrix<uchar> matImage(37,29);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 13 + c * 7 + r * c) & 0xff);
+
+  for (int mode = Pii::ExtendZeros; mode <= Pii::ExtendNot; ++mode)
+    {
+      Pii::ExtendMode extendMode = static_cast<Pii::ExtendMode>(mode);
+      for (int iSize=1; iSize<8; ++iSize)
+        {
+          PiiMatrix<double> matBox(PiiImage::boxFilter<double>(matImage, iSize, iSize, extendMode));
+          PiiMatrix<double> matFiltered(PiiImage::filter<double>(matImage,
+                                                                 PiiImage::makeFilter<double>(PiiImage::UniformFilter, iSize),
+                                                                 extendMode));
+          QCOMPARE(matBox.rows(), matFiltered.rows());
+          QCOMPARE(matBox.columns(), matFiltered.columns());
+          QVERIFY(Pii::almostEqual(matBox, matFiltered, 1e-9));
+        }
+    }
+  // Non-square window
+  QVERIFY(Pii::almostEqual(PiiImage::boxFilter<double>(matImage, 5, 3, Pii::ExtendSymmetric),
+                           PiiImage::filter<double>(matImage,
+                                                    PiiMatrix<double>::constant(5, 3, 1.0 / 15),
+                                                    Pii::ExtendSymmetric),
+                           1e-9));
+  // Large named uniform filters use boxFilter()
+  QVERIFY(Pii::equals(PiiImage::filter<float>(matImage, PiiImage::UniformFilter, Pii::ExtendZeros, 9),
+                      PiiImage::boxFilter<float>(matImage, 9, 9, Pii::ExtendZeros)));
+  QVERIFY(PiiImage::boxFilter<float>(matImage, 40, 40, Pii::ExtendNot).isEmpty());
+}
+
+void TestPiiImage::integralImage()
+{
+  const PiiMatrix<int> matImage(3,4,
+                                1, 2, 3, 4,
+                                5, 6, 7, 8,
+                                9, 10, 11, 12);
+  PiiIntegralImage<int> integral(matImage);
+  QCOMPARE(integral.rows(), 3);
+  QCOMPARE(integral.columns(), 4);
+  QCOMPARE(integral.sum(0, 0, 3, 4), 78);
+  QCOMPARE(integral.sum(1, 1, 3, 3), 34);
+  QCOMPARE(integral.sum(2, 0, 3, 4), 42);
+  QCOMPARE(integral.sum(1, 2, 1, 4), 0);
+  QCOMPARE(PiiIntegralImage<int>::sum(integral.sumRow(0), integral.sumRow(2), 3, 4), 12);
+
+  int iCount = 0;
+  QCOMPARE(integral.windowSum(0, 0, 1, 1, &iCount), 14);
+  QCOMPARE(iCount, 4);
+  QCOMPARE(integral.windowSum(1, 2, 1, 1, &iCount), 63);
+  QCOMPARE(iCount, 9);
+  QCOMPARE(integral.windowSum(2, 3, 5, 0), 24);
+
+  PiiIntegralImage<long long> integral2(matImage, Pii::Square<long long>());
+  QCOMPARE(integral2.sum(0, 0, 2, 2), 66LL);
+
+  QCOMPARE(PiiIntegralImage<int>().rows(), 0);
+}
+
 void TestPiiImage::intFilter()
 {
   PiiMatrix<double> filter(PiiImage::makeFilter<double>(PiiImage::GaussianFilter, 3));
@@ -2265,6 +3441,179 @@ void TestPiiImage::xorMatch()
   QCOMPARE(PiiImage::xorMatch(matA, matB), 1.0);
 }
 
+void TestPiiImage::bitXorMatch()
+{
+  {
+    PiiMatrix<uchar> matA(5,5,
+                          0,0,0,0,0,
+                          0,1,1,0,0,
+                          0,1,1,0,0,
+                          0,1,1,1,0,
+                          0,0,0,0,0);
+    PiiMatrix<uchar> matB(3,3,
+                          1,1,0,
+                          1,1,0,
+                          1,1,1);
+    int iRow = 0, iColumn = 0;
+    QCOMPARE(PiiImage::xorMatch(PiiBitMatrix::fromMatrix(matA), PiiBitMatrix::fromMatrix(matB), &iRow, &iColumn), 1.0);
+    QCOMPARE(iRow, 1);
+    QCOMPARE(iColumn, 1);
+    QCOMPARE(PiiImage::xorMatch(PiiBitMatrix::fromMatrix(matB), PiiBitMatrix::fromMatrix(matA), &iRow, &iColumn), 0.0);
+    QCOMPARE(iRow, -1);
+    QCOMPARE(iColumn, -1);
+    QVERIFY(PiiImage::xorDistances(PiiBitMatrix::fromMatrix(matB), PiiBitMatrix::fromMatrix(matA)).isEmpty());
+  }
+
+  // Widths that cross word boundaries at various bit offsets.
+  srand(7);
+  const int iFeatures = Pii::cpuFeatureMask();
+  const int aiFeatures[] = { iFeatures, 0 };
+  const int aSizes[][4] = { { 9, 150, 4, 70 }, { 12, 200, 5, 128 }, { 6, 64, 3, 63 }, { 20, 90, 20, 1 } };
+  for (int s=0; s<4; ++s)
+    {
+      PiiMatrix<uchar> matImage(aSizes[s][0], aSizes[s][1]), matTempl(aSizes[s][2], aSizes[s][3]);
+      for (int r=0; r<matImage.rows(); ++r)
+        for (int c=0; c<matImage.columns(); ++c)
+          matImage(r,c) = rand() % 2;
+      // Plant a noisy copy of the template.
+      const int iRow = rand() % (matImage.rows() - matTempl.rows() + 1),
+        iColumn = rand() % (matImage.columns() - matTempl.columns() + 1);
+      for (int r=0; r<matTempl.rows(); ++r)
+        for (int c=0; c<matTempl.columns(); ++c)
+          {
+            matTempl(r,c) = rand() % 2;
+            matImage(iRow + r, iColumn + c) = rand() % 16 ? matTempl(r,c) : 1 - matTempl(r,c);
+          }
+
+      PiiBitMatrix matBitImage(PiiBitMatrix::fromMatrix(matImage)), matBitTempl(PiiBitMatrix::fromMatrix(matTempl));
+      PiiMatrix<int> matDistances(PiiImage::xorDistances(matBitImage, matBitTempl));
+      QCOMPARE(matDistances.rows(), matImage.rows() - matTempl.rows() + 1);
+      QCOMPARE(matDistances.columns(), matImage.columns() - matTempl.columns() + 1);
+      int iMinSum = matTempl.rows() * matTempl.columns() + 1, iMinRow = -1, iMinColumn = -1;
+      for (int c=0; c<matDistances.columns(); ++c)
+        for (int r=0; r<matDistances.rows(); ++r)
+          {
+            int iSum = 0;
+            for (int i=0; i<matTempl.rows(); ++i)
+              for (int j=0; j<matTempl.columns(); ++j)
+                iSum += matImage(r+i, c+j) ^ matTempl(i,j);
+            QCOMPARE(matDistances(r,c), iSum);
+            if (iSum < iMinSum)
+              {
+                iMinSum = iSum;
+                iMinRow = r;
+                iMinColumn = c;
+              }
+          }
+
+      for (int f=0; f<2; ++f)
+        {
+          Pii::setCpuFeatureMask(aiFeatures[f]);
+          QVERIFY(Pii::equals(PiiImage::xorDistances(matBitImage, matBitTempl), matDistances));
+          int iBestRow = 0, iBestColumn = 0;
+          const double dMatch = PiiImage::xorMatch(matBitImage, matBitTempl, &iBestRow, &iBestColumn);
+          Pii::setCpuFeatureMask(iFeatures);
+          QCOMPARE(dMatch, PiiImage::xorMatch(matImage, matTempl));
+          QCOMPARE(iBestRow, iMinRow);
+          QCOMPARE(iBestColumn, iMinColumn);
+        }
+    }
+}
+
+void TestPiiImage::templateMatching()
+{
+  srand(8);
+  // Overlapping blocks of random intensity with some noise.
+  PiiMatrix<uchar> matImage(150, 190);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar(rand() % 10);
+  for (int i=0; i<60; ++i)
+    {
+      const int iRow = rand() % 140, iColumn = rand() % 180, iValue = rand() % 150;
+      for (int r=iRow; r<iRow + 4 + rand() % 30 && r<matImage.rows(); ++r)
+        for (int c=iColumn; c<iColumn + 4 + rand() % 30 && c<matImage.columns(); ++c)
+          matImage(r,c) = uchar(qMin(matImage(r,c) + iValue, 255));
+    }
+
+  // Compare to the definition. The 21-by-23 template is correlated
+  // in the frequency domain.
+  const int aiTemplates[][4] = { { 17, 33, 5, 7 }, { 60, 101, 21, 23 }, { 0, 0, 150, 190 } };
+  for (int t=0; t<3; ++t)
+    {
+      PiiMatrix<uchar> matTempl(matImage(aiTemplates[t][0], aiTemplates[t][1],
+                                         aiTemplates[t][2], aiTemplates[t][3]));
+      PiiMatrix<float> matCorrelation(PiiImage::normalizedCorrelation(matImage, matTempl));
+      QCOMPARE(matCorrelation.rows(), matImage.rows() - matTempl.rows() + 1);
+      QCOMPARE(matCorrelation.columns(), matImage.columns() - matTempl.columns() + 1);
+      const double dTemplMean = Pii::mean<double>(matTempl);
+      for (int r=0; r<matCorrelation.rows(); r += 3)
+        for (int c=0; c<matCorrelation.columns(); c += 3)
+          {
+            PiiMatrix<uchar> matWindow(matImage(r, c, matTempl.rows(), matTempl.columns()));
+            const double dWindowMean = Pii::mean<double>(matWindow);
+            double dProduct = 0, dWindowSquares = 0, dTemplSquares = 0;
+            for (int i=0; i<matTempl.rows(); ++i)
+              for (int j=0; j<matTempl.columns(); ++j)
+                {
+                  dProduct += (matWindow(i,j) - dWindowMean) * (matTempl(i,j) - dTemplMean);
+                  dWindowSquares += Pii::square(matWindow(i,j) - dWindowMean);
+                  dTemplSquares += Pii::square(matTempl(i,j) - dTemplMean);
+                }
+            QVERIFY(Pii::abs(matCorrelation(r,c) - dProduct / std::sqrt(dWindowSquares * dTemplSquares)) < 1e-4);
+          }
+      QVERIFY(Pii::abs(matCorrelation(aiTemplates[t][0], aiTemplates[t][1]) - 1.0f) < 1e-4);
+      // Parallel strips
+      QVERIFY(Pii::almostEqual(PiiImage::normalizedCorrelation(matImage, matTempl, PiiParallelPolicy(3, 1)),
+                               matCorrelation, 1e-5f));
+    }
+
+  // Constant windows and templates
+  QVERIFY(Pii::equals(PiiImage::normalizedCorrelation(PiiMatrix<uchar>::constant(5, 6, 1), PiiMatrix<uchar>(matImage(0,0,2,3))),
+                      PiiMatrix<float>(4, 4)));
+  QVERIFY(Pii::equals(PiiImage::normalizedCorrelation(PiiMatrix<uchar>(matImage(0,0,5,6)), PiiMatrix<uchar>::constant(2, 3, 7)),
+                      PiiMatrix<float>(4, 4)));
+  QVERIFY(PiiImage::normalizedCorrelation(PiiMatrix<uchar>(matImage(0,0,5,6)), PiiMatrix<uchar>(6, 3)).isEmpty());
+
+  // Plant a template at two places. The origin of the second one is
+  // odd, which shifts the pyramid levels of the image with respect to
+  // those of the template.
+  PiiMatrix<uchar> matTempl(matImage(41, 60, 36, 44));
+  matImage(97, 131, 36, 44) << matTempl;
+  PiiMatrix<float> matMatches;
+  for (int iLevels = 1; iLevels <= 3; ++iLevels)
+    {
+      matMatches = PiiImage::findTemplate(matImage, matTempl, 0.8f, 2, iLevels);
+      QCOMPARE(matMatches.rows(), 2);
+      QCOMPARE(matMatches.columns(), 3);
+      QCOMPARE(matMatches(0,0), 60.0f);
+      QCOMPARE(matMatches(0,1), 41.0f);
+      QVERIFY(matMatches(0,2) > 0.999f);
+      QCOMPARE(matMatches(1,0), 131.0f);
+      QCOMPARE(matMatches(1,1), 97.0f);
+      QVERIFY(matMatches(1,2) > 0.999f);
+
+      matMatches = PiiImage::findTemplate(matImage, matTempl, 0.8f, 1, iLevels);
+      QCOMPARE(matMatches.rows(), 1);
+    }
+
+  // All local maxima on a single level
+  matMatches = PiiImage::findTemplate(matImage, PiiMatrix<uchar>(matImage(10, 20, 12, 15)), -1.0f, -1, 1);
+  QVERIFY(matMatches.rows() > 1);
+  QCOMPARE(matMatches(0,0), 20.0f);
+  QCOMPARE(matMatches(0,1), 10.0f);
+  QVERIFY(Pii::abs(matMatches(0,2) - 1.0f) < 1e-4);
+  for (int i=1; i<matMatches.rows(); ++i)
+    {
+      QVERIFY(matMatches(i,2) <= matMatches(i-1,2));
+      for (int j=0; j<i; ++j)
+        QVERIFY(Pii::abs(matMatches(i,0) - matMatches(j,0)) > 7 ||
+                Pii::abs(matMatches(i,1) - matMatches(j,1)) > 6);
+    }
+
+  QCOMPARE(PiiImage::findTemplate(matTempl, matImage).rows(), 0);
+}
+
 void TestPiiImage::maxFilter()
 {
   PiiMatrix<uchar> img(7, 8,
@@ -2294,6 +3643,19 @@ void TestPiiImage::maxFilter()
 
   QVERIFY(Pii::equals(PiiImage::maxFilter(img,3), res));
   QVERIFY(Pii::equals(PiiImage::maxFilter(img,4,3), res2));
+
+  // A 9-by-9 window is equal to applying a 3-by-3 window four
+  // times. The large window uses a different algorithm.
+  PiiMatrix<uchar> matImage(23, 31);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 71 + c * 13 + r * c * 7) & 0xff);
+  PiiMatrix<uchar> matSmall(matImage);
+  for (int i=0; i<4; ++i)
+    matSmall = PiiImage::maxFilter(matSmall, 3);
+  QVERIFY(Pii::equals(PiiImage::maxFilter(matImage, 9), matSmall));
+  QVERIFY(Pii::equals(PiiImage::maxFilter(matImage, 1, 9),
+                      PiiImage::maxFilter(PiiImage::maxFilter(matImage, 1, 5), 1, 5)));
 }
 
 void TestPiiImage::minFilter()
@@ -2316,6 +3678,15 @@ void TestPiiImage::minFilter()
                        0,0,0,2,2,2,2,2);
 
   QVERIFY(Pii::equals(PiiImage::minFilter(img,3,5), res));
+
+  PiiMatrix<float> matImage(29, 17);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = float((r * 71 + c * 13 + r * c * 7) % 101);
+  PiiMatrix<float> matSmall(matImage);
+  for (int i=0; i<3; ++i)
+    matSmall = PiiImage::minFilter(matSmall, 3);
+  QVERIFY(Pii::equals(PiiImage::minFilter(matImage, 7), matSmall));
 }
 
 struct GradientPicker
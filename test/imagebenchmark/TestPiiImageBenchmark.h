@@ -0,0 +1,49 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIIIMAGEBENCHMARK_H
+#define _TESTPIIIMAGEBENCHMARK_H
+
+#include <QObject>
+
+class TestPiiImageBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  TestPiiImageBenchmark();
+
+private slots:
+  void initTestCase();
+  void image_data();
+  void image();
+  void morphology_data();
+  void morphology();
+  void thresholding_data();
+  void thresholding();
+  void labeling_data();
+  void labeling();
+  void histogram_data();
+  void histogram();
+  void colors_data();
+  void colors();
+
+private:
+  int _iThreadCount;
+  int _iMinTime;
+};
+
+
+#endif //_TESTPIIIMAGEBENCHMARK_H
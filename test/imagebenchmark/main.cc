@@ -0,0 +1,561 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+/* Throughput benchmarks for the image processing kernels in the
+ * image and colors modules. Each data row is tagged as
+ * `kernel-type-size`. *type* is the pixel type, and *size* is one of
+ * `vga` (640-by-480), `4mp` (2048-by-2048) and `linescan16k` (16384
+ * pixels wide, 512 rows). The images are created with fixed random
+ * seeds and are the same on every run.
+ *
+ * Each kernel is run once to warm up caches and CPU dispatchers and
+ * then repeated for at least `PII_BENCHMARK_TIME` milliseconds
+ * (default 500). The benchmark result is the average time per call.
+ * The throughput in megapixels per second and the number of bytes
+ * read and written per pixel are printed as debug messages.
+ *
+ * Kernels that take a PiiParallelPolicy use `PII_BENCHMARK_THREADS`
+ * threads (default 1). The instruction set can be restricted with
+ * `PII_CPU_FEATURES` (see Pii::setCpuFeatureMask()). To compare
+ * SIMD variants and threading, run the same rows with different
+ * settings:
+ *
+ * ~~~
+ * PII_CPU_FEATURES=none imagebenchmark -csv colors > generic.csv
+ * PII_CPU_FEATURES=sse2 imagebenchmark -csv colors > sse2.csv
+ * PII_BENCHMARK_THREADS=4 imagebenchmark morphology:erode3-bits-4mp
+ * ~~~
+ *
+ * The benchmarks are built with `qmake CONFIG+=benchmark`.
+ */
+
+#include "TestPiiImageBenchmark.h"
+
+#include <PiiImage.h>
+#include <PiiMorphology.h>
+#include <PiiThresholding.h>
+#include <PiiLabeling.h>
+#include <PiiHistogram.h>
+#include <PiiColors.h>
+#include <PiiRandom.h>
+#include <PiiTimer.h>
+#include <PiiCpu.h>
+#include <QtTest>
+
+#include <functional>
+
+namespace
+{
+  enum { ImageSeed = 1 };
+
+  // Results are stored here to keep the compiler from optimizing the
+  // benchmark loops away.
+  volatile qint64 iResultSink = 0;
+
+  /* Repeats a kernel until enough time has passed. The first round
+   * is not timed.
+   *
+   * ~~~(c++)
+   * Measurement measurement(image, minTime);
+   * while (measurement.next())
+   *   measurement.keep(PiiImage::quarterSize(image));
+   * ~~~
+   */
+  class Measurement
+  {
+  public:
+    template <class T> Measurement(const PiiMatrix<T>& input, int minTime) :
+      _iPixels(qint64(input.rows()) * input.columns()),
+      _iInputBytes(_iPixels * sizeof(T)),
+      _iOutputBytes(0),
+      _iMinTime(minTime),
+      _iRounds(-1)
+    {}
+
+    Measurement(const PiiBitMatrix& input, int minTime) :
+      _iPixels(qint64(input.rows()) * input.columns()),
+      _iInputBytes(bitBytes(input)),
+      _iOutputBytes(0),
+      _iMinTime(minTime),
+      _iRounds(-1)
+    {}
+
+    bool next()
+    {
+      ++_iRounds;
+      if (_iRounds == 0)
+        return true;
+      if (_iRounds == 1)
+        {
+          _timer.restart();
+          return true;
+        }
+      if (_timer.milliseconds() < _iMinTime)
+        return true;
+      report();
+      return false;
+    }
+
+    template <class T> void keep(const PiiMatrix<T>& result)
+    {
+      _iOutputBytes = qint64(result.rows()) * result.columns() * sizeof(T);
+      iResultSink += result.rows();
+    }
+
+    void keep(const PiiBitMatrix& result)
+    {
+      _iOutputBytes = bitBytes(result);
+      iResultSink += result.rows();
+    }
+
+    template <class T> void keep(const QVector<T>& result)
+    {
+      _iOutputBytes = qint64(result.size()) * sizeof(T);
+      iResultSink += result.size();
+    }
+
+  private:
+    static qint64 bitBytes(const PiiBitMatrix& matrix)
+    {
+      return qint64(matrix.rows()) * PiiBitMatrix::wordCount(matrix.columns()) * sizeof(quint64);
+    }
+
+    void report()
+    {
+      const int iTimedRounds = _iRounds - 1;
+      const double dSeconds = qMax(qint64(1), _timer.microseconds()) / 1e6;
+      const double dMpixels = double(_iPixels) * iTimedRounds / dSeconds / 1e6;
+      const double dBytesPerPixel = double(_iInputBytes + _iOutputBytes) / _iPixels;
+      qDebug("%.1f Mpixel/s, %.2f bytes/pixel, %.0f MB/s, CPU features 0x%x",
+             dMpixels, dBytesPerPixel, dMpixels * dBytesPerPixel, Pii::cpuFeatures());
+      QTest::setBenchmarkResult(dSeconds * 1000 / iTimedRounds, QTest::WalltimeMilliseconds);
+    }
+
+    qint64 _iPixels, _iInputBytes, _iOutputBytes;
+    int _iMinTime, _iRounds;
+    PiiTimer _timer;
+  };
+
+  /* The value range of random pixels. 16-bit images are filled with
+   * 12-bit data, which is what most cameras produce.
+   */
+  template <class T> struct PixelRange { static double max() { return PiiImage::Traits<T>::max(); } };
+  template <> struct PixelRange<unsigned short> { static double max() { return 4095; } };
+
+  template <class T> struct RandomPixel
+  {
+    static T value() { return T(Pii::uniformRandom() * PixelRange<T>::max()); }
+  };
+  template <class T> struct RandomPixel<PiiColor<T> >
+  {
+    static PiiColor<T> value()
+    {
+      const T r = RandomPixel<T>::value(), g = RandomPixel<T>::value(), b = RandomPixel<T>::value();
+      return PiiColor<T>(r, g, b);
+    }
+  };
+  template <class T> struct RandomPixel<PiiColor4<T> >
+  {
+    static PiiColor4<T> value()
+    {
+      const T r = RandomPixel<T>::value(), g = RandomPixel<T>::value(), b = RandomPixel<T>::value();
+      return PiiColor4<T>(r, g, b, 0);
+    }
+  };
+
+  template <class T> PiiMatrix<T> createImage(int rows, int columns)
+  {
+    Pii::seedRandom(ImageSeed);
+    PiiMatrix<T> matImage(PiiMatrix<T>::uninitialized(rows, columns));
+    for (int r=0; r<rows; ++r)
+      {
+        T* pRow = matImage[r];
+        for (int c=0; c<columns; ++c)
+          pRow[c] = RandomPixel<T>::value();
+      }
+    return matImage;
+  }
+
+  /* Creates a binary image with irregular blobs of varying size,
+   * about half of the pixels set. Thresholded noise would be the
+   * worst case for labeling and a poor model of real images.
+   */
+  PiiMatrix<unsigned char> createBlobs(int rows, int columns)
+  {
+    PiiMatrix<float> matSmooth(PiiImage::boxFilter<float>(createImage<float>(rows, columns), 9));
+    PiiMatrix<unsigned char> matBlobs(PiiMatrix<unsigned char>::uninitialized(rows, columns));
+    for (int r=0; r<rows; ++r)
+      for (int c=0; c<columns; ++c)
+        matBlobs(r,c) = matSmooth(r,c) > 0.5f ? 1 : 0;
+    return matBlobs;
+  }
+
+  struct ImageSize { const char* name; int rows, columns; };
+  const ImageSize aSizes[] =
+    {
+      { "vga", 480, 640 },
+      { "4mp", 2048, 2048 },
+      { "linescan16k", 512, 16384 }
+    };
+
+  template <class T, int N> inline int countOf(const T (&)[N]) { return N; }
+
+  void addColumns()
+  {
+    QTest::addColumn<QString>("kernel");
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("columns");
+  }
+
+  void addRows(const char* const* kernels, int kernelCount,
+               const char* const* types, int typeCount)
+  {
+    for (int k=0; k<kernelCount; ++k)
+      for (int t=0; t<typeCount; ++t)
+        for (int s=0; s<countOf(aSizes); ++s)
+          QTest::newRow(qPrintable(QString("%1-%2-%3").arg(kernels[k]).arg(types[t]).arg(aSizes[s].name)))
+            << QString(kernels[k]) << QString(types[t]) << aSizes[s].rows << aSizes[s].columns;
+  }
+
+  template <class T> void benchmarkImage(const QString& kernel, int rows, int columns,
+                                         const PiiParallelPolicy& policy, int minTime)
+  {
+    const PiiMatrix<T> matImage(createImage<T>(rows, columns));
+    Measurement measurement(matImage, minTime);
+    if (kernel == "sobel")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::filter<float>(matImage, PiiImage::SobelXFilter));
+      }
+    else if (kernel == "gaussian5")
+      {
+        const PiiMatrix<float> matFilter(PiiImage::makeFilter<float>(PiiImage::GaussianFilter, 5));
+        while (measurement.next())
+          measurement.keep(PiiImage::filter<float>(matImage, matFilter, Pii::ExtendReplicate, policy));
+      }
+    else if (kernel == "box31")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::boxFilter<float>(matImage, 31));
+      }
+    else if (kernel == "median3" || kernel == "median7")
+      {
+        const int iSize = kernel == "median3" ? 3 : 7;
+        while (measurement.next())
+          measurement.keep(PiiImage::medianFilter(matImage, iSize));
+      }
+    else if (kernel == "scale")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::scale(matImage, rows * 2 / 3, columns * 2 / 3));
+      }
+    else if (kernel == "quartersize")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::quarterSize(matImage));
+      }
+    else if (kernel == "rotate")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::rotate(matImage, 0.2, PiiImage::RetainOriginalSize));
+      }
+    else
+      QFAIL(qPrintable(QString("Unknown kernel: %1").arg(kernel)));
+  }
+
+  template <class Matrix> void benchmarkMorphology(const QString& kernel, const Matrix& image, int minTime)
+  {
+    const PiiMatrix<int> matMask3(PiiImage::createMask(PiiImage::RectangularMask, 3));
+    const PiiMatrix<int> matMask7(PiiImage::createMask(PiiImage::EllipticalMask, 7));
+    Measurement measurement(image, minTime);
+    if (kernel == "erode3")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::erode(image, matMask3));
+      }
+    else if (kernel == "dilate3")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::dilate(image, matMask3));
+      }
+    else if (kernel == "open7")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::open(image, matMask7));
+      }
+    else if (kernel == "close7")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::close(image, matMask7));
+      }
+    else
+      QFAIL(qPrintable(QString("Unknown kernel: %1").arg(kernel)));
+  }
+
+  template <class T> void benchmarkThresholding(const QString& kernel, int rows, int columns,
+                                                const PiiParallelPolicy& policy, int minTime)
+  {
+    const PiiMatrix<T> matImage(createImage<T>(rows, columns));
+    const T level = T(PixelRange<T>::max() / 2);
+    Measurement measurement(matImage, minTime);
+    if (kernel == "threshold")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::threshold(matImage, PiiImage::ThresholdFunction<T>(), level, policy));
+      }
+    else if (kernel == "thresholdbits")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::thresholdBits(matImage, level));
+      }
+    else if (kernel == "adaptive31")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::adaptiveThreshold(matImage,
+                                                       PiiImage::ThresholdFunction<double,unsigned char>(1),
+                                                       1.0f, 0.0f, 31, 31));
+      }
+    else
+      QFAIL(qPrintable(QString("Unknown kernel: %1").arg(kernel)));
+  }
+
+  template <class T> void benchmarkHistogram(const QString& kernel, int rows, int columns,
+                                             const PiiParallelPolicy& policy, int minTime)
+  {
+    const PiiMatrix<T> matImage(createImage<T>(rows, columns));
+    const int iLevels = int(PixelRange<T>::max()) + 1;
+    Measurement measurement(matImage, minTime);
+    if (kernel == "histogram")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::histogram<int>(matImage, PiiImage::DefaultRoi(), iLevels, policy));
+      }
+    else if (kernel == "equalize")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::equalize(matImage, iLevels));
+      }
+    else
+      QFAIL(qPrintable(QString("Unknown kernel: %1").arg(kernel)));
+  }
+
+  template <class Clr> void benchmarkColors(const QString& kernel, int rows, int columns, int minTime)
+  {
+    const PiiMatrix<Clr> matImage(createImage<Clr>(rows, columns));
+    Measurement measurement(matImage, minTime);
+    if (kernel == "togray")
+      {
+        while (measurement.next())
+          measurement.keep(PiiImage::toGray(matImage));
+      }
+    else if (kernel == "hsv")
+      {
+        while (measurement.next())
+          measurement.keep(PiiColors::rgbToHsv(matImage));
+      }
+    else if (kernel == "ycbcr")
+      {
+        while (measurement.next())
+          measurement.keep(PiiColors::rgbToYcbcr(matImage));
+      }
+    else if (kernel == "gamma")
+      {
+        while (measurement.next())
+          measurement.keep(PiiColors::correctGamma(matImage, 2.2, PiiImage::Traits<Clr>::max()));
+      }
+    else
+      QFAIL(qPrintable(QString("Unknown kernel: %1").arg(kernel)));
+  }
+
+  const char* const apGrayTypes[] = { "uchar", "ushort", "float" };
+  const char* const apIntegerTypes[] = { "uchar", "ushort" };
+  const char* const apBinaryTypes[] = { "uchar", "bits" };
+  const char* const apBits[] = { "bits" };
+  const char* const apColorTypes[] = { "rgb", "rgba", "rgbfloat" };
+}
+
+TestPiiImageBenchmark::TestPiiImageBenchmark() :
+  _iThreadCount(1),
+  _iMinTime(500)
+{
+  int iThreads = qgetenv("PII_BENCHMARK_THREADS").toInt();
+  if (iThreads > 0)
+    _iThreadCount = iThreads;
+  int iTime = qgetenv("PII_BENCHMARK_TIME").toInt();
+  if (iTime > 0)
+    _iMinTime = iTime;
+}
+
+void TestPiiImageBenchmark::initTestCase()
+{
+  qDebug("CPU features 0x%x (mask 0x%x), %d thread(s)",
+         Pii::cpuFeatures(), Pii::cpuFeatureMask(), _iThreadCount);
+}
+
+void TestPiiImageBenchmark::image_data()
+{
+  static const char* const apKernels[] =
+    { "sobel", "gaussian5", "box31", "median3", "median7", "scale", "quartersize", "rotate" };
+  addColumns();
+  addRows(apKernels, countOf(apKernels), apGrayTypes, countOf(apGrayTypes));
+}
+
+void TestPiiImageBenchmark::image()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  const PiiParallelPolicy policy(_iThreadCount);
+  if (type == "uchar")
+    benchmarkImage<unsigned char>(kernel, rows, columns, policy, _iMinTime);
+  else if (type == "ushort")
+    benchmarkImage<unsigned short>(kernel, rows, columns, policy, _iMinTime);
+  else
+    benchmarkImage<float>(kernel, rows, columns, policy, _iMinTime);
+}
+
+void TestPiiImageBenchmark::morphology_data()
+{
+  static const char* const apKernels[] = { "erode3", "dilate3", "open7", "close7" };
+  addColumns();
+  addRows(apKernels, countOf(apKernels), apBinaryTypes, countOf(apBinaryTypes));
+}
+
+void TestPiiImageBenchmark::morphology()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  const PiiMatrix<unsigned char> matBlobs(createBlobs(rows, columns));
+  if (type == "bits")
+    benchmarkMorphology(kernel, PiiImage::thresholdBits(matBlobs, (unsigned char)1), _iMinTime);
+  else
+    benchmarkMorphology(kernel, matBlobs, _iMinTime);
+}
+
+void TestPiiImageBenchmark::thresholding_data()
+{
+  static const char* const apKernels[] = { "threshold", "thresholdbits", "adaptive31" };
+  addColumns();
+  addRows(apKernels, countOf(apKernels), apGrayTypes, countOf(apGrayTypes));
+}
+
+void TestPiiImageBenchmark::thresholding()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  const PiiParallelPolicy policy(_iThreadCount);
+  if (type == "uchar")
+    benchmarkThresholding<unsigned char>(kernel, rows, columns, policy, _iMinTime);
+  else if (type == "ushort")
+    benchmarkThresholding<unsigned short>(kernel, rows, columns, policy, _iMinTime);
+  else
+    benchmarkThresholding<float>(kernel, rows, columns, policy, _iMinTime);
+}
+
+void TestPiiImageBenchmark::labeling_data()
+{
+  static const char* const apImageKernels[] = { "labelimage" };
+  static const char* const apRunKernels[] = { "labelruns4", "labelruns8" };
+  addColumns();
+  addRows(apImageKernels, 1, apBinaryTypes, 1);
+  addRows(apRunKernels, countOf(apRunKernels), apBinaryTypes, countOf(apBinaryTypes));
+}
+
+void TestPiiImageBenchmark::labeling()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  const PiiParallelPolicy policy(_iThreadCount);
+  const PiiImage::Connectivity connectivity = kernel == "labelruns8" ? PiiImage::Connect8 : PiiImage::Connect4;
+  const PiiMatrix<unsigned char> matBlobs(createBlobs(rows, columns));
+  if (type == "bits")
+    {
+      const PiiBitMatrix matBits(PiiImage::thresholdBits(matBlobs, (unsigned char)1));
+      Measurement measurement(matBits, _iMinTime);
+      while (measurement.next())
+        measurement.keep(PiiImage::labelRuns(matBits, connectivity, 0, policy));
+    }
+  else if (kernel == "labelimage")
+    {
+      Measurement measurement(matBlobs, _iMinTime);
+      while (measurement.next())
+        measurement.keep(PiiImage::labelImage(matBlobs));
+    }
+  else
+    {
+      Measurement measurement(matBlobs, _iMinTime);
+      while (measurement.next())
+        measurement.keep(PiiImage::labelRuns(matBlobs,
+                                             std::bind2nd(std::not_equal_to<unsigned char>(), 0),
+                                             connectivity, 0, policy));
+    }
+}
+
+void TestPiiImageBenchmark::histogram_data()
+{
+  static const char* const apKernels[] = { "histogram", "equalize" };
+  addColumns();
+  addRows(apKernels, countOf(apKernels), apIntegerTypes, countOf(apIntegerTypes));
+}
+
+void TestPiiImageBenchmark::histogram()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  const PiiParallelPolicy policy(_iThreadCount);
+  if (type == "uchar")
+    benchmarkHistogram<unsigned char>(kernel, rows, columns, policy, _iMinTime);
+  else
+    benchmarkHistogram<unsigned short>(kernel, rows, columns, policy, _iMinTime);
+}
+
+void TestPiiImageBenchmark::colors_data()
+{
+  static const char* const apKernels[] = { "togray", "hsv", "ycbcr", "gamma" };
+  addColumns();
+  addRows(apKernels, countOf(apKernels), apColorTypes, countOf(apColorTypes));
+}
+
+void TestPiiImageBenchmark::colors()
+{
+  QFETCH(QString, kernel);
+  QFETCH(QString, type);
+  QFETCH(int, rows);
+  QFETCH(int, columns);
+
+  if (type == "rgb")
+    benchmarkColors<PiiColor<unsigned char> >(kernel, rows, columns, _iMinTime);
+  else if (type == "rgba")
+    benchmarkColors<PiiColor4<unsigned char> >(kernel, rows, columns, _iMinTime);
+  else
+    benchmarkColors<PiiColor<float> >(kernel, rows, columns, _iMinTime);
+}
+
+QTEST_MAIN(TestPiiImageBenchmark)
@@ -27,6 +27,8 @@ private slots:
   void initTestCase();
   void findClosestMatch();
   void findClosestMatches();
+  void randomData();
+  void parallelBuild();
   void cleanupTestCase();
 
 private:
@@ -17,6 +17,9 @@
 #include "TestPiiKdTree.h"
 
 #include <QtTest>
+#include <cstdlib>
+#include <climits>
+#include <sstream>
 
 void TestPiiKdTree::initTestCase()
 {
@@ -74,6 +77,120 @@ void TestPiiKdTree::findClosestMatches()
     }
 }
 
+void TestPiiKdTree::randomData()
+{
+  // Large enough to have many levels of buckets.
+  PiiMatrix<float> matModels(2000, 4), matQueries(50, 4);
+  for (int r=0; r<matModels.rows(); ++r)
+    for (int c=0; c<matModels.columns(); ++c)
+      matModels(r,c) = float(std::rand() % 1000);
+  for (int r=0; r<matQueries.rows(); ++r)
+    for (int c=0; c<matQueries.columns(); ++c)
+      matQueries(r,c) = float(std::rand() % 1000);
+
+  PiiSquaredGeometricDistance<const float*> measure;
+  const int aBucketSizes[] = { 1, 8, 64 };
+  for (int b=0; b<3; ++b)
+    {
+      PiiKdTree<PiiMatrix<float> > tree;
+      tree.setBucketSize(aBucketSizes[b]);
+      tree.buildTree(matModels);
+      QCOMPARE(tree.bucketSize(), aBucketSizes[b]);
+
+      int iApproximateHits = 0;
+      for (int i=0; i<matQueries.rows(); ++i)
+        {
+          double dExpected, dDistance;
+          PiiClassification::findClosestMatch(matQueries[i], matModels, measure, &dExpected);
+          tree.findClosestMatch(matQueries[i], &dDistance);
+          QCOMPARE(dDistance, dExpected);
+          // Exhaustive budget must give the exact answer.
+          tree.findClosestMatch(matQueries[i], matModels.rows(), &dDistance);
+          QCOMPARE(dDistance, dExpected);
+          if (tree.findClosestMatch(matQueries[i], 200, &dDistance) >= 0 &&
+              dDistance == dExpected)
+            ++iApproximateHits;
+
+          PiiClassification::MatchList lstExpected =
+            PiiClassification::findClosestMatches(matQueries[i], matModels, measure, 5);
+          PiiClassification::MatchList lstMatches = tree.findClosestMatches(matQueries[i], 5);
+          QCOMPARE(lstMatches.size(), 5);
+          for (int j=0; j<5; ++j)
+            QCOMPARE(lstMatches[j].first, lstExpected[j].first);
+          lstMatches = tree.findClosestMatches(matQueries[i], 5, 40);
+          QCOMPARE(lstMatches.size(), 5);
+          QVERIFY(lstMatches[0].second >= 0);
+        }
+      // Best bin first finds most nearest neighbors in 10% of the time.
+      QVERIFY(iApproximateHits > matQueries.rows() * 3 / 4);
+    }
+}
+
+namespace
+{
+  struct Controller : PiiProgressController
+  {
+    Controller(int maxCalls) : iMaxCalls(maxCalls), iCalls(0), dLastProgress(0) {}
+
+    bool canContinue(double progress) const
+    {
+      ++iCalls;
+      if (progress < dLastProgress || progress > 1)
+        dLastProgress = NAN;
+      else
+        dLastProgress = progress;
+      return iCalls < iMaxCalls;
+    }
+
+    int iMaxCalls;
+    mutable int iCalls;
+    mutable double dLastProgress;
+  };
+}
+
+void TestPiiKdTree::parallelBuild()
+{
+  PiiMatrix<float> matModels(20000, 3);
+  for (int r=0; r<matModels.rows(); ++r)
+    for (int c=0; c<matModels.columns(); ++c)
+      matModels(r,c) = float(std::rand() % 100);
+
+  Controller controller(INT_MAX);
+  PiiKdTree<PiiMatrix<float> > sequentialTree, parallelTree;
+  sequentialTree.buildTree(matModels, &controller);
+  QVERIFY(controller.iCalls > 0);
+  QCOMPARE(controller.dLastProgress, 1.0);
+  parallelTree.buildTree(matModels, PiiParallelPolicy(4));
+
+  std::ostringstream sequentialStream, parallelStream;
+  sequentialTree.print(sequentialStream);
+  parallelTree.print(parallelStream);
+  QVERIFY(!sequentialStream.str().empty());
+  QVERIFY(sequentialStream.str() == parallelStream.str());
+
+  PiiSquaredGeometricDistance<const float*> measure;
+  for (int i=0; i<20; ++i)
+    {
+      const float aSample[3] = { float(std::rand() % 100), float(std::rand() % 100), float(std::rand() % 100) };
+      double dExpected, dDistance;
+      PiiClassification::findClosestMatch(aSample, matModels, measure, &dExpected);
+      parallelTree.findClosestMatch(aSample, &dDistance);
+      QCOMPARE(dDistance, dExpected);
+    }
+
+  Controller interrupter(10);
+  try
+    {
+      parallelTree.buildTree(matModels, PiiParallelPolicy(4), &interrupter);
+      QFAIL("Building was not interrupted.");
+    }
+  catch (PiiClassificationException&)
+    {
+      QCOMPARE(interrupter.iCalls, 10);
+      QCOMPARE(parallelTree.findClosestMatch(matModels[0]), -1);
+    }
+}
+
 void TestPiiKdTree::cleanupTestCase()
 {
   delete _pTree;
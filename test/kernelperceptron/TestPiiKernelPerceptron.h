@@ -24,6 +24,7 @@ class TestPiiKernelPerceptron : public QObject
 
 private slots:
   void learn();
+  void kernelCache();
 };
 
 
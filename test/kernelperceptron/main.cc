@@ -44,4 +44,22 @@ void TestPiiKernelPerceptron::learn()
     }
 }
 
+void TestPiiKernelPerceptron::kernelCache()
+{
+  PiiMatrix<double> matSamples;
+  QVector<double> vecLabels;
+  PiiClassification::createDartBoard(50, 250, matSamples, vecLabels);
+
+  // A cache that holds only one row must give the same result as
+  // one that holds the whole kernel matrix.
+  PiiKernelPerceptron<PiiMatrix<double> > perceptron1, perceptron2;
+  perceptron2.setKernelCacheSize(0);
+  perceptron1.learn(matSamples, vecLabels);
+  perceptron2.learn(matSamples, vecLabels);
+  QVERIFY(perceptron2.converged());
+  QCOMPARE(perceptron2.weights(), perceptron1.weights());
+  for (int r=0; r<matSamples.rows(); ++r)
+    QCOMPARE(perceptron2.classify(matSamples[r]), vecLabels[r]);
+}
+
 QTEST_MAIN(TestPiiKernelPerceptron)
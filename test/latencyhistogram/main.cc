@@ -0,0 +1,92 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiLatencyHistogram.h"
+
+#include <PiiLatencyHistogram.h>
+#include <QtTest>
+
+void TestPiiLatencyHistogram::empty()
+{
+  PiiLatencyHistogram histogram;
+  QCOMPARE(histogram.count(), qint64(0));
+  QCOMPARE(histogram.max(), qint64(0));
+  QCOMPARE(histogram.percentile(0.5), qint64(0));
+  QCOMPARE(histogram.mean(), 0.0);
+}
+
+void TestPiiLatencyHistogram::exactBins()
+{
+  PiiLatencyHistogram histogram;
+  for (int i=0; i<PiiLatencyHistogram::SubBinCount; ++i)
+    histogram.add(i);
+  histogram.add(-5);
+  QCOMPARE(histogram.count(), qint64(PiiLatencyHistogram::SubBinCount + 1));
+  QCOMPARE(histogram.percentile(0), qint64(0));
+  QCOMPARE(histogram.percentile(1), qint64(PiiLatencyHistogram::SubBinCount - 1));
+  QCOMPARE(histogram.max(), qint64(PiiLatencyHistogram::SubBinCount - 1));
+}
+
+void TestPiiLatencyHistogram::percentile()
+{
+  PiiLatencyHistogram histogram;
+  // 1000 samples from 1 ms to 100 ms.
+  for (int i=1; i<=1000; ++i)
+    histogram.add(i * 100);
+  QCOMPARE(histogram.count(), qint64(1000));
+  QCOMPARE(histogram.max(), qint64(100000));
+  QCOMPARE(histogram.mean(), 50050.0);
+
+  // Percentiles are upper bin limits: never below the true value
+  // and at most one bin (1/16 of an octave) above it.
+  const double adFractions[] = { 0.5, 0.9, 0.99 };
+  for (int i=0; i<3; ++i)
+    {
+      qint64 iExact = qint64(adFractions[i] * 1000) * 100;
+      qint64 iEstimate = histogram.percentile(adFractions[i]);
+      QVERIFY(iEstimate >= iExact);
+      QVERIFY(iEstimate <= iExact + iExact / PiiLatencyHistogram::SubBinCount);
+    }
+  QCOMPARE(histogram.percentile(1.0), qint64(100000));
+
+  QVariantMap mapStatistics(histogram.toMap());
+  QCOMPARE(mapStatistics["count"].toLongLong(), qint64(1000));
+  QCOMPARE(mapStatistics["max"].toLongLong(), qint64(100000));
+  QCOMPARE(mapStatistics["p90"].toLongLong(), histogram.percentile(0.9));
+}
+
+void TestPiiLatencyHistogram::merge()
+{
+  PiiLatencyHistogram histogram1, histogram2;
+  histogram1.add(10);
+  histogram2.add(20000);
+  histogram1.merge(histogram2);
+  QCOMPARE(histogram1.count(), qint64(2));
+  QCOMPARE(histogram1.max(), qint64(20000));
+  QCOMPARE(histogram1.percentile(0.5), qint64(10));
+  histogram1.clear();
+  QCOMPARE(histogram1.count(), qint64(0));
+  QCOMPARE(histogram1.percentile(0.5), qint64(0));
+}
+
+void TestPiiLatencyHistogram::overflow()
+{
+  PiiLatencyHistogram histogram;
+  qint64 iHuge = Q_INT64_C(1) << 40;
+  histogram.add(iHuge);
+  QCOMPARE(histogram.percentile(0.5), iHuge);
+}
+
+QTEST_MAIN(TestPiiLatencyHistogram)
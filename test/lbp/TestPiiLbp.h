@@ -27,6 +27,8 @@ private slots:
   void basicLbp();
   void genericLbp();
   void thresholdedLbp();
+  void vectorizedLbp();
+  void runLengthRoi();
 
 private:
   template <class T> PiiMatrix<T> createRandomImage();
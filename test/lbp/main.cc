@@ -16,6 +16,7 @@
 #include "TestPiiLbp.h"
 
 #include <PiiLbp.h>
+#include <PiiCpu.h>
 #include <PiiMath.h>
 #include <PiiTypeTraits.h>
 #include <QtTest>
@@ -172,4 +173,85 @@ template <class T> void TestPiiLbp::thresholdedLbp()
     }
 }
 
+void TestPiiLbp::vectorizedLbp()
+{
+  const int iOriginalMask = Pii::cpuFeatureMask();
+  // Odd widths leave columns for the scalar code after the vector
+  // loop.
+  const int aiColumns[] = { 3, 18, 35, 100 };
+  for (int i=0; i<4; ++i)
+    {
+      PiiMatrix<unsigned char> matImage(23, aiColumns[i]);
+      PiiMatrix<bool> matRoi(23, aiColumns[i]);
+      for (int r=0; r<matImage.rows(); ++r)
+        for (int c=0; c<matImage.columns(); ++c)
+          {
+            // Plenty of equal neighbors
+            matImage(r,c) = (unsigned char)(rand() % 5 * 60);
+            matRoi(r,c) = (r + c) % 3 != 0;
+          }
+
+      PiiMatrix<int> aResults[2][5];
+      const int aiMasks[] = { iOriginalMask, 0 };
+      for (int j=0; j<2; ++j)
+        {
+          Pii::setCpuFeatureMask(aiMasks[j]);
+          aResults[j][0] = PiiLbp::basicLbp<PiiLbp::Image>(matImage);
+          aResults[j][1] = PiiLbp::basicLbp<PiiLbp::Histogram>(matImage, matRoi);
+          aResults[j][2] = PiiLbp::basicSymmetricLbp<PiiLbp::Image>(matImage);
+          PiiLbp lbp(8, 1, PiiLbp::Uniform, Pii::NearestNeighborInterpolation);
+          aResults[j][3] = lbp.genericLbp<PiiLbp::Image>(matImage);
+          aResults[j][4] = lbp.genericLbp<PiiLbp::Histogram>(matImage, matRoi);
+        }
+      Pii::setCpuFeatureMask(iOriginalMask);
+
+      for (int j=0; j<5; ++j)
+        QVERIFY(Pii::equals(aResults[0][j], aResults[1][j]));
+
+      // Uniform codes and histograms are mapped standard codes.
+      unsigned short* pLookup = PiiLbp::createLookupTable(8, PiiLbp::Uniform);
+      PiiMatrix<int> matHistogram(1, PiiLbp::featureCount(8, PiiLbp::Uniform));
+      for (int r=0; r<aResults[0][0].rows(); ++r)
+        for (int c=0; c<aResults[0][0].columns(); ++c)
+          {
+            const int iCode = pLookup[aResults[0][0](r,c)];
+            QCOMPARE(aResults[0][3](r,c), iCode);
+            if (matRoi(r+1,c+1))
+              ++matHistogram(iCode);
+          }
+      delete[] pLookup;
+      QVERIFY(Pii::equals(aResults[0][4], matHistogram));
+    }
+}
+
+void TestPiiLbp::runLengthRoi()
+{
+  // Histograms over a run-length ROI must equal those over the same
+  // pixels given as a mask.
+  PiiMatrix<unsigned char> matImage(31, 45);
+  PiiMatrix<bool> matRoi(31, 45);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      {
+        matImage(r,c) = (unsigned char)(rand() % 5 * 60);
+        matRoi(r,c) = r % 4 != 0 && c > 5 && (r + c) % 7 != 0;
+      }
+  PiiImage::RunLengthRoi runRoi(PiiImage::RunLengthRoi::fromMask(matRoi));
+
+  QVERIFY(Pii::equals(PiiLbp::basicLbp<PiiLbp::Histogram>(matImage, runRoi),
+                      PiiLbp::basicLbp<PiiLbp::Histogram>(matImage, matRoi)));
+  QVERIFY(Pii::equals(PiiLbp::basicSymmetricLbp<PiiLbp::Histogram>(matImage, runRoi),
+                      PiiLbp::basicSymmetricLbp<PiiLbp::Histogram>(matImage, matRoi)));
+
+  PiiLbp lbp1(8, 1, PiiLbp::Uniform, Pii::NearestNeighborInterpolation);
+  PiiLbp lbp2(8, 2, PiiLbp::Standard, Pii::NearestNeighborInterpolation);
+  PiiLbp lbp3(8, 2, PiiLbp::Standard, Pii::LinearInterpolation);
+  PiiLbp lbp4(8, 2, PiiLbp::Symmetric, Pii::NearestNeighborInterpolation);
+  PiiLbp lbp5(8, 2, PiiLbp::Symmetric, Pii::LinearInterpolation);
+  PiiLbp* pOperators[] = { &lbp1, &lbp2, &lbp3, &lbp4, &lbp5 };
+  for (int i=0; i<5; ++i)
+    QVERIFY(Pii::equals(pOperators[i]->genericLbp<PiiLbp::Histogram>(matImage, runRoi),
+                        pOperators[i]->genericLbp<PiiLbp::Histogram>(matImage, matRoi)));
+}
+
 QTEST_MAIN(TestPiiLbp)
@@ -0,0 +1,165 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiLog.h"
+
+#include <PiiLog.h>
+#include <QtTest>
+#include <QThread>
+
+static QStringList lstMessages;
+static QMutex messageLock;
+
+static void collectMessage(QtMsgType, const QMessageLogContext&, const QString& message)
+{
+  QMutexLocker lock(&messageLock);
+  lstMessages << message;
+}
+
+static int iEvaluations = 0;
+
+static int evaluate()
+{
+  return ++iEvaluations;
+}
+
+void TestPiiLog::init()
+{
+  lstMessages.clear();
+  qInstallMessageHandler(collectMessage);
+}
+
+void TestPiiLog::cleanup()
+{
+  PiiLog::setAsynchronous(false);
+  PiiLog::setMessageFilter(PiiLog::defaultMessageFilter);
+  qInstallMessageHandler(0);
+}
+
+static bool rejectAll(const char*, QtMsgType)
+{
+  return false;
+}
+
+void TestPiiLog::lazyArguments()
+{
+  iEvaluations = 0;
+  piiDebug("%d", evaluate());
+  QCOMPARE(iEvaluations, 1);
+  QCOMPARE(lstMessages, QStringList() << "1");
+
+  PiiLog::setMessageFilter(rejectAll);
+  piiDebug("%d", evaluate());
+  piiWarning(QString::number(evaluate()));
+  QCOMPARE(iEvaluations, 1);
+  QCOMPARE(lstMessages.size(), 1);
+}
+
+void TestPiiLog::moduleLevel()
+{
+  QCOMPARE(PiiLog::moduleLogLevel("Noisy"), -1);
+  PiiLog::setModuleLogLevel("Noisy", QtCriticalMsg);
+  QCOMPARE(PiiLog::moduleLogLevel("Noisy"), int(QtCriticalMsg));
+  QVERIFY(!piiLogEnabled("Noisy", QtWarningMsg));
+  QVERIFY(piiLogEnabled("Noisy", QtCriticalMsg));
+  QVERIFY(piiLogEnabled("Other", QtWarningMsg));
+  piiLog("Noisy", QtWarningMsg, "dropped");
+  piiLog("Noisy", QtCriticalMsg, "shown");
+  QCOMPARE(lstMessages, QStringList() << "shown");
+  PiiLog::setModuleLogLevel("Noisy", -1);
+  QCOMPARE(PiiLog::moduleLogLevel("Noisy"), -1);
+}
+
+void TestPiiLog::asynchronous()
+{
+  PiiLog::setAsynchronous(true);
+  if (!PiiLog::isAsynchronous())
+    QSKIP("Asynchronous logging is not available.");
+
+  char aTemporary[] = "temporary";
+  piiDebug("%d %u %ld %lld %x", -1, 2u, 3L, 4LL, 255);
+  piiDebug("%.2f %5.1e %s %c%%", 1.25, 100.0, aTemporary, 'x');
+  piiDebug("%*d|%-*.*f|", 4, 7, 6, 1, 2.5);
+  // Overwriting the argument must not change the message.
+  aTemporary[0] = 'T';
+  piiWarning(QString("QString"));
+  piiDebug("No arguments");
+  PiiLog::flush();
+
+  QCOMPARE(lstMessages.size(), 5);
+  QCOMPARE(lstMessages[0], QString("-1 2 3 4 ff"));
+  QCOMPARE(lstMessages[1], QString("1.25 1.0e+02 temporary x%"));
+  QCOMPARE(lstMessages[2], QString("   7|2.5   |"));
+  QCOMPARE(lstMessages[3], QString("QString"));
+  QCOMPARE(lstMessages[4], QString("No arguments"));
+
+  PiiLog::setAsynchronous(false);
+  piiDebug("%d", 1);
+  QCOMPARE(lstMessages.size(), 6);
+}
+
+class LogThread : public QThread
+{
+public:
+  LogThread(int index) : _iIndex(index) {}
+
+protected:
+  void run()
+  {
+    for (int i=0; i<100; ++i)
+      {
+        piiDebug("%d %d", _iIndex, i);
+        if (i % 50 == 0)
+          PiiLog::flush();
+      }
+  }
+
+private:
+  int _iIndex;
+};
+
+void TestPiiLog::asynchronousThreads()
+{
+  PiiLog::setAsynchronous(true);
+  if (!PiiLog::isAsynchronous())
+    QSKIP("Asynchronous logging is not available.");
+
+  LogThread* threads[4];
+  for (int i=0; i<4; ++i)
+    {
+      threads[i] = new LogThread(i);
+      threads[i]->start();
+    }
+  for (int i=0; i<4; ++i)
+    {
+      QVERIFY(threads[i]->wait(5000));
+      delete threads[i];
+    }
+  // Disabling writes out everything.
+  PiiLog::setAsynchronous(false);
+
+  QCOMPARE(lstMessages.size(), 400);
+  // Messages of each thread stay in order.
+  int aNext[4] = { 0, 0, 0, 0 };
+  for (int i=0; i<lstMessages.size(); ++i)
+    {
+      QStringList lstParts = lstMessages[i].split(' ');
+      int iThread = lstParts[0].toInt();
+      QCOMPARE(lstParts[1].toInt(), aNext[iThread]);
+      ++aNext[iThread];
+    }
+}
+
+QTEST_MAIN(TestPiiLog)
@@ -0,0 +1,130 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMailbox.h"
+
+#include <PiiMailbox.h>
+#include <QtTest>
+#include <QThread>
+#include <QVector>
+
+void TestPiiMailbox::singleThread()
+{
+  PiiMailbox<int> mailbox(3);
+  QCOMPARE(mailbox.capacity(), 4);
+  QVERIFY(mailbox.isEmpty());
+
+  int iValue = 0;
+  QVERIFY(!mailbox.takeFirst(iValue));
+  for (int i=1; i<=4; ++i)
+    QVERIFY(mailbox.append(i));
+  QVERIFY(!mailbox.append(5));
+  QVERIFY(!mailbox.isEmpty());
+
+  QVERIFY(mailbox.takeFirst(iValue));
+  QCOMPARE(iValue, 1);
+  QVERIFY(mailbox.append(5));
+
+  for (int i=2; i<=5; ++i)
+    {
+      QVERIFY(mailbox.takeFirst(iValue));
+      QCOMPARE(iValue, i);
+    }
+  QVERIFY(mailbox.isEmpty());
+
+  // Go around the ring a few times.
+  for (int i=0; i<100; ++i)
+    {
+      QVERIFY(mailbox.append(i));
+      QVERIFY(mailbox.takeFirst(iValue));
+      QCOMPARE(iValue, i);
+    }
+}
+
+void TestPiiMailbox::notification()
+{
+  PiiMailbox<int> mailbox(8);
+  QVERIFY(mailbox.notify());
+  QVERIFY(!mailbox.notify());
+  QVERIFY(!mailbox.notify());
+  mailbox.acknowledge();
+  QVERIFY(mailbox.notify());
+}
+
+class Producer : public QThread
+{
+public:
+  Producer(PiiMailbox<int>* mailbox, int id, int count) :
+    _pMailbox(mailbox), _iId(id), _iCount(count)
+  {}
+
+protected:
+  void run()
+  {
+    for (int i=0; i<_iCount; )
+      {
+        if (_pMailbox->append(_iId << 24 | i))
+          ++i;
+        else
+          yieldCurrentThread();
+      }
+  }
+
+private:
+  PiiMailbox<int>* _pMailbox;
+  int _iId, _iCount;
+};
+
+void TestPiiMailbox::manyProducers()
+{
+  const int iProducers = 4, iCount = 50000;
+  PiiMailbox<int> mailbox(16);
+  QList<Producer*> lstProducers;
+  for (int i=0; i<iProducers; ++i)
+    lstProducers << new Producer(&mailbox, i, iCount);
+  for (int i=0; i<iProducers; ++i)
+    lstProducers[i]->start();
+
+  // Objects from each producer must arrive in order.
+  QVector<int> vecNext(iProducers, 0);
+  QString strError;
+  for (int iReceived=0; iReceived<iProducers*iCount; )
+    {
+      int iValue;
+      if (mailbox.takeFirst(iValue))
+        {
+          int iId = iValue >> 24, iIndex = iValue & 0xffffff;
+          if (iId < 0 || iId >= iProducers)
+            strError = QString("Unknown producer %1.").arg(iId);
+          else
+            {
+              if (iIndex != vecNext[iId] && strError.isEmpty())
+                strError = QString("Expected %1 from producer %2, got %3.").arg(vecNext[iId]).arg(iId).arg(iIndex);
+              vecNext[iId] = iIndex + 1;
+            }
+          ++iReceived;
+        }
+      else
+        QThread::yieldCurrentThread();
+    }
+  for (int i=0; i<iProducers; ++i)
+    lstProducers[i]->wait();
+  qDeleteAll(lstProducers);
+  if (!strError.isEmpty())
+    QFAIL(qPrintable(strError));
+  QVERIFY(mailbox.isEmpty());
+}
+
+QTEST_MAIN(TestPiiMailbox)
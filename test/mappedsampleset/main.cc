@@ -0,0 +1,207 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMappedSampleSet.h"
+
+#include <PiiMappedSampleSet.h>
+#include <PiiKdTree.h>
+#include <PiiSom.h>
+#include <QtTest>
+#include <cstdlib>
+
+namespace
+{
+  QString temporaryFileName(QTemporaryFile& file)
+  {
+    // The file stays in place until the test function returns.
+    file.open();
+    return file.fileName();
+  }
+
+  template <class SampleSet> void fillRandomly(SampleSet& samples, int sampleCount, int featureCount)
+  {
+    QVector<float> vecSample(featureCount);
+    for (int i=0; i<sampleCount; ++i)
+      {
+        for (int j=0; j<featureCount; ++j)
+          vecSample[j] = float(std::rand() % 1000) / 10;
+        PiiSampleSet::append(samples, vecSample.constData());
+      }
+  }
+}
+
+void TestPiiMappedSampleSet::append()
+{
+  QTemporaryFile file;
+  PiiMappedSampleSet<int> samples(temporaryFileName(file), 3, 3);
+  QCOMPARE(samples.featureCount(), 3);
+  QCOMPARE(samples.sampleCount(), 0);
+  QCOMPARE(samples.chunkSize(), 4);
+
+  for (int i=0; i<37; ++i)
+    {
+      const int aSample[3] = { i, -i, i*i };
+      PiiSampleSet::append(samples, aSample);
+    }
+  const int* pFirst = PiiSampleSet::sampleAt(samples, 0);
+  for (int i=37; i<50; ++i)
+    {
+      const int aSample[3] = { i, -i, i*i };
+      samples.append(aSample);
+    }
+  // Chunks are never moved.
+  QVERIFY(samples.sampleAt(0) == pFirst);
+  QCOMPARE(PiiSampleSet::sampleCount(samples), 50);
+  QCOMPARE(PiiSampleSet::capacity(samples), 52);
+  for (int i=0; i<50; ++i)
+    {
+      const int* pSample = samples.sampleAt(i);
+      QCOMPARE(pSample[0], i);
+      QCOMPARE(pSample[1], -i);
+      QCOMPARE(pSample[2], i*i);
+    }
+
+  PiiSampleSet::remove(samples, 0);
+  QCOMPARE(samples.sampleCount(), 49);
+  QCOMPARE(samples.sampleAt(48)[0], 49);
+
+  PiiSampleSet::resize(samples, 60);
+  QCOMPARE(samples.sampleCount(), 60);
+  QCOMPARE(samples.sampleAt(59)[2], 0);
+
+  PiiSampleSet::clear(samples);
+  QCOMPARE(samples.sampleCount(), 0);
+
+  PiiMappedSampleSet<int> empty;
+  const int aSample[3] = { 1, 2, 3 };
+  empty.append(aSample);
+  QCOMPARE(empty.sampleCount(), 0);
+  empty.resize(2, 3);
+  QCOMPARE(empty.sampleCount(), 2);
+  QCOMPARE(empty.featureCount(), 3);
+  QVERIFY(!empty.fileName().isEmpty());
+}
+
+void TestPiiMappedSampleSet::reopen()
+{
+  QTemporaryFile file;
+  const QString strFileName(temporaryFileName(file));
+  {
+    PiiMappedSampleSet<double> samples(strFileName, 2, 16);
+    for (int i=0; i<100; ++i)
+      {
+        const double aSample[2] = { i, 0.5 * i };
+        samples.append(aSample);
+      }
+  }
+
+  PiiMappedSampleSet<double> samples(strFileName);
+  QCOMPARE(samples.sampleCount(), 100);
+  QCOMPARE(samples.featureCount(), 2);
+  QCOMPARE(samples.chunkSize(), 16);
+  QCOMPARE(samples.sampleAt(99)[1], 49.5);
+  const double aSample[2] = { -1, -2 };
+  samples.append(aSample);
+  QCOMPARE(samples.sampleCount(), 101);
+
+  try
+    {
+      PiiMappedSampleSet<double> wrongSize(strFileName, 3);
+      QFAIL("Opening a sample set with a wrong number of features succeeded.");
+    }
+  catch (PiiIOException&)
+    {}
+  try
+    {
+      PiiMappedSampleSet<float> wrongType(strFileName);
+      QFAIL("Opening a sample set with a wrong feature type succeeded.");
+    }
+  catch (PiiIOException&)
+    {}
+}
+
+void TestPiiMappedSampleSet::copyOnWrite()
+{
+  PiiMappedSampleSet<float> samples(0, 4);
+  fillRandomly(samples, 20, 4);
+  PiiMappedSampleSet<float> copy(samples);
+  const PiiMappedSampleSet<float>& constCopy = copy, &constSamples = samples;
+  QVERIFY(constCopy.sampleAt(5) == constSamples.sampleAt(5));
+  QVERIFY(PiiSampleSet::equals(copy, samples));
+
+  const float aSample[4] = { -1, -2, -3, -4 };
+  copy.setSampleAt(5, aSample);
+  QVERIFY(copy.fileName() != samples.fileName());
+  QVERIFY(!(copy == samples));
+  QCOMPARE(copy.sampleAt(5)[3], -4.0f);
+  QVERIFY(samples.sampleAt(5)[3] >= 0);
+
+  copy = samples;
+  QVERIFY(copy == samples);
+  copy.reserve(10, 2);
+  QCOMPARE(copy.featureCount(), 2);
+  QCOMPARE(copy.sampleCount(), 0);
+  QCOMPARE(samples.featureCount(), 4);
+  QCOMPARE(samples.sampleCount(), 20);
+}
+
+void TestPiiMappedSampleSet::kdTree()
+{
+  PiiMatrix<float> matModels(0, 3);
+  PiiMappedSampleSet<float> models(0, 3);
+  std::srand(1);
+  fillRandomly(matModels, 2000, 3);
+  std::srand(1);
+  fillRandomly(models, 2000, 3);
+  QVERIFY(models.capacity() >= 2000);
+
+  PiiKdTree<PiiMatrix<float> > matrixTree(matModels);
+  PiiKdTree<PiiMappedSampleSet<float> > mappedTree(models);
+  for (int i=0; i<50; ++i)
+    {
+      const float aSample[3] = { float(std::rand() % 100), float(std::rand() % 100), float(std::rand() % 100) };
+      QCOMPARE(mappedTree.findClosestMatch(aSample), matrixTree.findClosestMatch(aSample));
+    }
+}
+
+void TestPiiMappedSampleSet::som()
+{
+  PiiMatrix<double> matSamples(300, 2);
+  for (int r=0; r<matSamples.rows(); ++r)
+    for (int c=0; c<matSamples.columns(); ++c)
+      matSamples(r,c) = double(std::rand() % 1000) / 10;
+  PiiMappedSampleSet<double> samples(0, 2), initial(0, 2);
+  for (int r=0; r<matSamples.rows(); ++r)
+    PiiSampleSet::append(samples, matSamples[r]);
+  PiiMatrix<double> matInitial(matSamples(0,0,16,-1) / 100);
+  for (int r=0; r<matInitial.rows(); ++r)
+    PiiSampleSet::append(initial, matInitial[r]);
+
+  PiiSom<PiiMatrix<double> > matrixSom(4,4);
+  PiiSom<PiiMappedSampleSet<double> > mappedSom(4,4);
+  matrixSom.setLearningLength(600);
+  matrixSom.setModels(matInitial);
+  mappedSom.setLearningLength(600);
+  mappedSom.setModels(initial);
+  matrixSom.learn(matSamples, QVector<double>());
+  mappedSom.learn(samples, QVector<double>());
+
+  QCOMPARE(mappedSom.modelCount(), 16);
+  for (int i=0; i<16; ++i)
+    for (int j=0; j<2; ++j)
+      QCOMPARE(mappedSom.modelAt(i)[j], matrixSom.modelAt(i)[j]);
+}
+
+QTEST_MAIN(TestPiiMappedSampleSet)
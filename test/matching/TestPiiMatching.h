@@ -23,8 +23,11 @@ class TestPiiMatching : public QObject
   Q_OBJECT
 
 private slots:
+  void binaryMatching();
   void boundaryDirections();
+  void randomLbpDescriptor();
   void shapeContextDescriptor();
+  void vocabularyMatching();
 };
 
 
@@ -16,7 +16,11 @@
 #include "TestPiiMatching.h"
 
 #include <PiiMatching.h>
+#include <PiiFeaturePointMatcher.h>
+#include <PiiRandomLbp.h>
+#include <PiiRigidPlaneRansac.h>
 #include <PiiMath.h>
+#include <PiiCpu.h>
 #include <PiiMatrixUtil.h>
 
 #include <iostream>
@@ -83,6 +87,234 @@ void TestPiiMatching::shapeContextDescriptor()
     //Pii::printMatrix(std::cout, matFeatures, " ", "\n");
     //std::cout << std::endl;
   }
+
+  {
+    // One point at each distance, in distinct quadrants
+    PiiMatrix<int> matPoints(4,2,
+                             5,1,
+                             -1,15,
+                             -25,-1,
+                             1,-300);
+    PiiMatrix<int> matKeyPoints(1,2);
+    QVector<double> vecDistances = QVector<double>() << 100 << 400 << 900;
+    PiiMatrix<float> matFeatures = PiiMatching::shapeContextDescriptor(matPoints, matKeyPoints, 4, vecDistances);
+    QCOMPARE(matFeatures.columns(), 12);
+    // The last point is too far
+    QCOMPARE(matFeatures(0,0), 1.0f/3);
+    QCOMPARE(matFeatures(0,2), 0.0f);
+    QCOMPARE(matFeatures(0,4), 1.0f/3);
+    QCOMPARE(matFeatures(0,7), 0.0f);
+    QCOMPARE(matFeatures(0,8), 1.0f/3);
+    QVERIFY(Pii::abs(Pii::sum<double>(matFeatures) - 1.0) < 1e-6);
+  }
+
+  {
+    srand(3);
+    const int iPoints = 500, iKeyPoints = 50, iAngles = 12;
+    PiiMatrix<int> matPoints(iPoints, 2);
+    for (int r=0; r<iPoints; ++r)
+      {
+        double dAngle = 2*M_PI * r / iPoints, dRadius = 100 + rand() % 50;
+        matPoints(r,0) = Pii::round<int>(dRadius * cos(dAngle));
+        matPoints(r,1) = Pii::round<int>(dRadius * sin(dAngle));
+      }
+    PiiMatrix<int> matKeyPoints(iKeyPoints, 2);
+    QVector<double> vecDirections;
+    for (int r=0; r<iKeyPoints; ++r)
+      {
+        matKeyPoints(r,0) = matPoints(r*10,0);
+        matKeyPoints(r,1) = matPoints(r*10,1);
+        vecDirections << double(rand() % 6283) / 1000 - M_PI;
+      }
+    QVector<double> vecDistances = QVector<double>() << 25 << 121 << 576 << 2601 << 12100 << 57600;
+
+    // Straightforward implementation with atan2()
+    PiiMatrix<float> matExpected(iKeyPoints, iAngles * vecDistances.size());
+    for (int i=0; i<iKeyPoints; ++i)
+      {
+        for (int j=0; j<iPoints; ++j)
+          {
+            int dx = matPoints(j,0) - matKeyPoints(i,0), dy = matPoints(j,1) - matKeyPoints(i,1);
+            double dDistance = dx*dx + dy*dy;
+            if (dDistance == 0 || dDistance >= vecDistances.last())
+              continue;
+            int iDistance = 0;
+            while (dDistance >= vecDistances[iDistance])
+              ++iDistance;
+            double dAngle = atan2(double(dy), double(dx)) - vecDirections[i];
+            while (dAngle < 0) dAngle += 2*M_PI;
+            while (dAngle >= 2*M_PI) dAngle -= 2*M_PI;
+            ++matExpected(i, qMin(iAngles-1, int(dAngle / (2*M_PI) * iAngles)) * vecDistances.size() + iDistance);
+          }
+        float fSum = 0;
+        for (int c=0; c<matExpected.columns(); ++c)
+          fSum += matExpected(i,c);
+        for (int c=0; c<matExpected.columns(); ++c)
+          matExpected(i,c) /= fSum;
+      }
+
+    const int iFeatures = Pii::cpuFeatureMask();
+    const int aiFeatures[] = { iFeatures, 0 };
+    for (int f=0; f<2; ++f)
+      {
+        Pii::setCpuFeatureMask(aiFeatures[f]);
+        PiiMatrix<float> matFeatures = PiiMatching::shapeContextDescriptor(matPoints, matKeyPoints, iAngles,
+                                                                           vecDistances, vecDirections);
+        QVERIFY(Pii::maxAbs(matFeatures - matExpected) < 1e-6);
+        PiiMatrix<float> matParallel = PiiMatching::shapeContextDescriptor(matPoints, matKeyPoints, iAngles,
+                                                                           vecDistances, vecDirections,
+                                                                           PiiMatching::NonInvariant, 0,
+                                                                           PiiParallelPolicy(4, 1));
+        QVERIFY(Pii::equals(matParallel, matFeatures));
+      }
+    Pii::setCpuFeatureMask(iFeatures);
+
+    // Every fourth point as a reference
+    PiiMatrix<int> matReference(0, 2);
+    for (int r=0; r<iPoints; r += 4)
+      matReference.appendRow(matPoints[r]);
+    QVERIFY(Pii::equals(PiiMatching::shapeContextDescriptor(matPoints, matKeyPoints, iAngles,
+                                                            vecDistances, vecDirections,
+                                                            PiiMatching::NonInvariant, iPoints/4),
+                        PiiMatching::shapeContextDescriptor(matReference, matKeyPoints, iAngles,
+                                                            vecDistances, vecDirections)));
+  }
+}
+
+void TestPiiMatching::vocabularyMatching()
+{
+  srand(7);
+  // 200 models with 30 points each. Each point has a random
+  // descriptor.
+  const int iModels = 200, iModelPoints = 30, iFeatures = 8;
+  PiiMatrix<float> matPoints(iModels * iModelPoints, 2);
+  PiiMatrix<float> matFeatures(iModels * iModelPoints, iFeatures);
+  QVector<int> vecModelIndices;
+  for (int r=0; r<matPoints.rows(); ++r)
+    {
+      matPoints(r,0) = float(rand() % 200);
+      matPoints(r,1) = float(rand() % 200);
+      for (int c=0; c<iFeatures; ++c)
+        matFeatures(r,c) = float(rand() % 1000);
+      vecModelIndices << r / iModelPoints;
+    }
+
+  PiiFeaturePointMatcher<float, PiiMatrix<float> > matcher;
+  matcher.setVocabularyBranching(5);
+  matcher.setMaxCandidateModels(3);
+  matcher.setMatchingMode(PiiMatching::MatchOneModel);
+  matcher.buildDatabase(matPoints, matFeatures, vecModelIndices);
+
+  PiiRigidPlaneRansac<float> ransac;
+  ransac.setFittingThreshold(4);
+  ransac.setMinInliers(10);
+
+  // Query with rotated and translated copies of some models, with
+  // slightly distorted descriptors.
+  const PiiMatrix<double> matModel(1, 4, 1.0, 0.5, 50.0, -20.0);
+  for (int iModel = 0; iModel < iModels; iModel += 37)
+    {
+      PiiMatrix<float> matQueryPoints(PiiRigidPlaneRansac<float>::transform(matPoints(iModel * iModelPoints, 0,
+                                                                                     iModelPoints, -1),
+                                                                            matModel));
+      PiiMatrix<float> matQueryFeatures(matFeatures(iModel * iModelPoints, 0, iModelPoints, -1));
+      for (int r=0; r<iModelPoints; ++r)
+        for (int c=0; c<iFeatures; ++c)
+          matQueryFeatures(r,c) += float(rand() % 5);
+
+      PiiMatching::MatchList lstMatches = matcher.findMatchingModels(matQueryPoints, matQueryFeatures, ransac);
+      QCOMPARE(lstMatches.size(), 1);
+      QCOMPARE(lstMatches[0].modelIndex(), iModel);
+      QVERIFY(lstMatches[0].matchedPointCount() >= iModelPoints / 2);
+    }
+}
+
+void TestPiiMatching::binaryMatching()
+{
+  srand(8);
+  // 500 models with 30 points each. Each point has a random 256-bit
+  // descriptor.
+  const int iModels = 500, iModelPoints = 30, iBytes = 32;
+  PiiMatrix<float> matPoints(iModels * iModelPoints, 2);
+  PiiMatrix<unsigned char> matFeatures(iModels * iModelPoints, iBytes);
+  QVector<int> vecModelIndices;
+  for (int r=0; r<matPoints.rows(); ++r)
+    {
+      matPoints(r,0) = float(rand() % 200);
+      matPoints(r,1) = float(rand() % 200);
+      for (int c=0; c<iBytes; ++c)
+        matFeatures(r,c) = static_cast<unsigned char>(rand() % 256);
+      vecModelIndices << r / iModelPoints;
+    }
+
+  PiiFeaturePointMatcher<float, PiiMatrix<unsigned char> > matcher;
+  matcher.setHashTableCount(8);
+  matcher.setMatchingMode(PiiMatching::MatchOneModel);
+  matcher.buildDatabase(matPoints, matFeatures, vecModelIndices);
+
+  PiiRigidPlaneRansac<float> ransac;
+  ransac.setFittingThreshold(4);
+  ransac.setMinInliers(10);
+
+  // Query with rotated and translated copies of some models. A few
+  // bits of each descriptor are flipped.
+  const PiiMatrix<double> matModel(1, 4, 1.0, 0.5, 50.0, -20.0);
+  for (int iModel = 0; iModel < iModels; iModel += 61)
+    {
+      PiiMatrix<float> matQueryPoints(PiiRigidPlaneRansac<float>::transform(matPoints(iModel * iModelPoints, 0,
+                                                                                     iModelPoints, -1),
+                                                                            matModel));
+      PiiMatrix<unsigned char> matQueryFeatures(matFeatures(iModel * iModelPoints, 0, iModelPoints, -1));
+      for (int r=0; r<iModelPoints; ++r)
+        for (int i=0; i<6; ++i)
+          {
+            const int iBit = rand() % (iBytes * 8);
+            matQueryFeatures(r, iBit / 8) ^= static_cast<unsigned char>(1 << (iBit % 8));
+          }
+
+      PiiMatching::MatchList lstMatches = matcher.findMatchingModels(matQueryPoints, matQueryFeatures, ransac);
+      QCOMPARE(lstMatches.size(), 1);
+      QCOMPARE(lstMatches[0].modelIndex(), iModel);
+      QVERIFY(lstMatches[0].matchedPointCount() >= iModelPoints / 2);
+    }
+}
+
+void TestPiiMatching::randomLbpDescriptor()
+{
+  srand(9);
+  PiiMatrix<int> matImage(10, 20);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = rand() % 256;
+
+  // Four 8-bit patterns in a non-square window.
+  PiiRandomLbp rlbp;
+  rlbp.setParameters(4, 8, 10, 20);
+  QCOMPARE(rlbp.descriptorBytes(), 4);
+
+  unsigned char aDescriptor[4];
+  rlbp.calculateDescriptor(aDescriptor, matImage);
+
+  // The histogram stores the first comparison of each pattern to
+  // the most significant bit of its code, the descriptor to the
+  // least significant one.
+  PiiMatrix<int> matHistogram(rlbp.initializeHistogram());
+  QCOMPARE(matHistogram.columns(), 4 * 256);
+  rlbp.updateHistogram(matHistogram[0], matImage);
+  for (int p=0; p<4; ++p)
+    {
+      int iReversed = 0;
+      for (int b=0; b<8; ++b)
+        iReversed |= ((aDescriptor[p] >> b) & 1) << (7 - b);
+      QCOMPARE(matHistogram(0, p * 256 + iReversed), 2);
+    }
+
+  // Unused bits are cleared.
+  rlbp.setParameters(3, 3, 10, 20);
+  QCOMPARE(rlbp.descriptorBytes(), 2);
+  aDescriptor[1] = 0xff;
+  rlbp.calculateDescriptor(aDescriptor, matImage);
+  QCOMPARE(aDescriptor[1] >> 1, 0);
 }
 
 QTEST_MAIN(TestPiiMatching)
@@ -54,11 +54,13 @@ private slots:
   void square();
   void pseudoInverse();
   void multiplyTransposed();
+  void blockedProduct();
   void pivot();
   void norm();
   void multiply();
   void multiplied();
   void minMax();
+  void reductions();
   void mean();
   void isSingular();
   void isDiagonal();
@@ -88,6 +90,7 @@ private slots:
   void rank();
   void svd();
   void pca();
+  void incrementalPca();
   void plu();
   void numeric();
   void angleDiff();
@@ -116,6 +119,8 @@ private slots:
   void kthSmallest();
   void partition();
   void insertionSort();
+  void networkSort();
+  void parallelSort();
 
   void windowSum();
   void findMinima();
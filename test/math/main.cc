@@ -26,10 +26,14 @@ using std::endl;
 #include "TestPiiMath.h"
 #include <PiiMatrixUtil.h>
 #include <PiiPseudoInverse.h>
+#include <PiiPrincipalComponents.h>
 #include <PiiMath.h>
 #include <QtTest>
 #include <algorithm>
 #include <PiiVector.h>
+#include <PiiCpu.h>
+#include <PiiAlgorithm.h>
+#include <QVector>
 #include <cstdlib>
 #include <ctime>
 
@@ -789,6 +793,58 @@ void TestPiiMath::multiplyTransposed()
     }
 }
 
+template <class T> static PiiMatrix<T> referenceProduct(const PiiMatrix<T>& a, const PiiMatrix<T>& b)
+{
+  PiiMatrix<T> result(a.rows(), b.columns());
+  for (int r=0; r<a.rows(); ++r)
+    for (int c=0; c<b.columns(); ++c)
+      {
+        double dSum = 0;
+        for (int k=0; k<a.columns(); ++k)
+          dSum += double(a(r,k)) * double(b(k,c));
+        result(r,c) = T(dSum);
+      }
+  return result;
+}
+
+template <class T> static void testBlockedProduct(int rows, int inner, int columns, T tolerance)
+{
+  PiiMatrix<T> a(rows, inner), b(inner, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<inner; ++c)
+      a(r,c) = T(std::rand() % 201 - 100) / 16;
+  for (int r=0; r<inner; ++r)
+    for (int c=0; c<columns; ++c)
+      b(r,c) = T(std::rand() % 201 - 100) / 16;
+  const PiiMatrix<T> matReference(referenceProduct(a, b));
+  const PiiMatrix<T> aT(Pii::transpose(a)), bT(Pii::transpose(b));
+
+  QVERIFY(Pii::almostEqual(matReference, PiiMatrix<T>(a * b), tolerance));
+  QVERIFY(Pii::almostEqual(matReference, PiiMatrix<T>(Pii::transpose(aT) * b), tolerance));
+  QVERIFY(Pii::almostEqual(matReference, PiiMatrix<T>(a * Pii::transpose(bT)), tolerance));
+  QVERIFY(Pii::almostEqual(matReference, PiiMatrix<T>(Pii::transpose(aT) * Pii::transpose(bT)), tolerance));
+  QVERIFY(Pii::almostEqual(matReference,
+                           PiiMatrix<T>(Pii::matrixProduct(a, b, PiiParallelPolicy(4, 8))),
+                           tolerance));
+}
+
+void TestPiiMath::blockedProduct()
+{
+  const int iOriginalMask = Pii::cpuFeatureMask();
+  // Run with and without SIMD instructions.
+  const int aiMasks[] = { iOriginalMask, 0 };
+  for (int i=0; i<2; ++i)
+    {
+      Pii::setCpuFeatureMask(aiMasks[i]);
+      testBlockedProduct<double>(37, 517, 301, 1e-9);
+      testBlockedProduct<double>(200, 300, 1, 1e-9);
+      testBlockedProduct<double>(1, 300, 200, 1e-9);
+      testBlockedProduct<float>(130, 257, 45, 1e-2f);
+      testBlockedProduct<float>(64, 64, 64, 1e-2f);
+    }
+  Pii::setCpuFeatureMask(iOriginalMask);
+}
+
 void TestPiiMath::multiply()
 {
   {
@@ -844,6 +900,85 @@ void TestPiiMath::minMax()
   QCOMPARE( maxC, 0 );
 }
 
+template <class T> static void testReductions(int rows, int columns, double low, double high)
+{
+  PiiMatrix<T> mat(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      mat(r,c) = T(low + 1 + (high - low - 2) * std::rand() / RAND_MAX);
+  mat(rows/2, columns-1) = T(low);
+  mat(rows-1, columns/2) = T(high);
+  mat(rows-1, columns-1) = T(low);
+
+  double dSum = 0, dSquares = 0, dAbs = 0;
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      {
+        dSum += mat(r,c);
+        dSquares += double(mat(r,c)) * mat(r,c);
+        dAbs += std::fabs(double(mat(r,c)));
+      }
+  const double dMean = dSum / (rows * columns);
+  double dVar = 0;
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      dVar += Pii::square(mat(r,c) - dMean);
+  dVar /= rows * columns;
+
+  QVERIFY(Pii::almostEqualRel(Pii::sum<double>(mat), dSum, 1e-6));
+  QVERIFY(Pii::almostEqualRel(Pii::mean<double>(mat), dMean, 1e-6));
+  double dMeanOut = 0;
+  QVERIFY(Pii::almostEqualRel(Pii::var<double>(mat, &dMeanOut), dVar, 1e-6));
+  QVERIFY(Pii::almostEqualRel(dMeanOut, dMean, 1e-6));
+  QVERIFY(Pii::almostEqualRel(Pii::norm1(mat), dAbs, 1e-6));
+  QVERIFY(Pii::almostEqualRel(Pii::norm2(mat), std::sqrt(dSquares), 1e-6));
+
+  PiiMatrix<double> matRowSums(Pii::sum<double>(mat, Pii::Horizontally));
+  for (int r=0; r<rows; ++r)
+    {
+      double dRowSum = 0;
+      for (int c=0; c<columns; ++c)
+        dRowSum += mat(r,c);
+      QVERIFY(Pii::almostEqualRel(matRowSums(r,0), dRowSum, 1e-6));
+    }
+
+  T min, max;
+  int minR, minC, maxR, maxC;
+  Pii::minMax(mat, &min, &max, &minR, &minC, &maxR, &maxC);
+  QCOMPARE(min, T(low));
+  QCOMPARE(max, T(high));
+  // First occurrences in row-major order
+  QCOMPARE(minR, rows/2);
+  QCOMPARE(minC, columns-1);
+  QCOMPARE(maxR, rows-1);
+  QCOMPARE(maxC, columns/2);
+}
+
+void TestPiiMath::reductions()
+{
+  const int iOriginalMask = Pii::cpuFeatureMask();
+  // Run with and without SIMD instructions.
+  const int aiMasks[] = { iOriginalMask, 0 };
+  for (int i=0; i<2; ++i)
+    {
+      Pii::setCpuFeatureMask(aiMasks[i]);
+      testReductions<unsigned char>(37, 131, 1, 254);
+      testReductions<short>(13, 67, -32767, 32766);
+      testReductions<unsigned short>(5, 1001, 1, 65534);
+      testReductions<float>(29, 33, -1000, 1000);
+      testReductions<double>(1, 257, -1e6, 1e6);
+
+      // Element-wise accumulation would overflow
+      PiiMatrix<unsigned char> matBytes(PiiMatrix<unsigned char>::constant(1000, 1000, 255));
+      QCOMPARE(Pii::sum<int>(matBytes), 255000000);
+      QCOMPARE(Pii::norm2(matBytes), 255000.0);
+      QCOMPARE(Pii::var<double>(matBytes), 0.0);
+      PiiMatrix<short> matShorts(PiiMatrix<short>::constant(3, 50000, -32768));
+      QCOMPARE(Pii::norm1(matShorts), 4915200000.0);
+    }
+  Pii::setCpuFeatureMask(iOriginalMask);
+}
+
 void TestPiiMath::mean()
 {
   QVERIFY(Pii::almostEqual(Pii::mean<double>(matItest, Pii::Horizontally), matItestMeanAlongRow, tol));
@@ -1964,6 +2099,53 @@ void TestPiiMath::pca()
 }
 
 
+void TestPiiMath::incrementalPca()
+{
+  const int iSamples = 600, iDimensions = 12;
+  PiiMatrix<double> matData(iSamples, iDimensions);
+  for (int r=0; r<iSamples; ++r)
+    for (int c=0; c<iDimensions; ++c)
+      matData(r,c) = 50 + (c+1) * std::sin(0.37 * r * (c+1)) + (c % 3) * matData(r,0);
+
+  PiiIncrementalPca<double> pca;
+  QVERIFY(pca.baseVectors().isEmpty());
+  // Uneven batches, the last one is a single sample.
+  pca.addSamples(matData(0, 0, 100, -1));
+  QCOMPARE(pca.baseVectors().rows(), iDimensions);
+  pca.addSamples(matData(100, 0, 350, -1), PiiParallelPolicy(2));
+  pca.addSamples(matData(450, 0, 149, -1));
+  pca.addSamples(matData(599, 0, 1, -1));
+  QCOMPARE(pca.sampleCount(), iSamples);
+
+  QVERIFY(Pii::almostEqual(pca.mean(), Pii::mean<double>(matData, Pii::Vertically), 1e-9));
+
+  PiiMatrix<double> matCentered(matData);
+  Pii::subtractMean(matCentered);
+  PiiMatrix<double> matScatter(Pii::transpose(matCentered) * matCentered);
+  QVERIFY(Pii::almostEqual(pca.scatter(), matScatter, 1e-10 * Pii::maxAbs(matScatter)));
+
+  PiiMatrix<double> matS;
+  PiiMatrix<double> matV = Pii::principalComponents(matCentered, &matS);
+  PiiMatrix<double> matIncrementalS = pca.singularValues();
+  PiiMatrix<double> matIncrementalV = pca.baseVectors();
+  QVERIFY(Pii::almostEqual(matIncrementalS, matS, 1e-8 * matS(0,0)));
+  QVERIFY(Pii::isOrthogonalLike(matIncrementalV, 1e-8));
+  // Components with distinct singular values must match up to sign.
+  for (int i=0; i<iDimensions; ++i)
+    {
+      if (matS(0,i) < 1e-6 * matS(0,0) ||
+          (i > 0 && matS(0,i-1) - matS(0,i) < 1e-6 * matS(0,0)) ||
+          (i < iDimensions-1 && matS(0,i) - matS(0,i+1) < 1e-6 * matS(0,0)))
+        continue;
+      double dDot = Pii::innerProduct(matV.columnBegin(i), matV.columnEnd(i), matIncrementalV.columnBegin(i), 0.0);
+      QVERIFY(Pii::almostEqualRel(Pii::abs(dDot), 1.0, 1e-8));
+    }
+
+  pca.clear();
+  QCOMPARE(pca.sampleCount(), 0);
+  QVERIFY(pca.scatter().isEmpty());
+}
+
 void TestPiiMath::plu()
 {
 #if 0
@@ -2123,6 +2305,20 @@ void TestPiiMath::kthSmallest()
 
   }
 
+  {
+    // Long runs of equal values must not degrade the selection.
+    QVector<int> vecValues(100000);
+    for (int i=0; i<vecValues.size(); ++i)
+      vecValues[i] = (i % 3 == 0) ? i : 7;
+    QVector<int> vecSorted(vecValues);
+    std::sort(vecSorted.begin(), vecSorted.end());
+    for (int k=0; k<vecValues.size(); k += 997)
+      {
+        QVector<int> vecCopy(vecValues);
+        QCOMPARE(Pii::kthSmallest(vecCopy.data(), vecCopy.size(), k), vecSorted[k]);
+      }
+  }
+
 }
 
 void TestPiiMath::partition()
@@ -2166,6 +2362,50 @@ void TestPiiMath::insertionSort()
   }
 }
 
+void TestPiiMath::networkSort()
+{
+  // A network sorts everything if it sorts all zero-one inputs.
+  for (int iMask=0; iMask<(1 << 13); ++iMask)
+    {
+      int array[13];
+      for (int i=0; i<13; ++i)
+        array[i] = (iMask >> i) & 1;
+      Pii::networkSort<13>(array);
+      for (int i=1; i<13; ++i)
+        QVERIFY(array[i-1] <= array[i]);
+    }
+
+  for (int iLength=1; iLength<=25; ++iLength)
+    {
+      float array[25], sorted[25];
+      for (int i=0; i<iLength; ++i)
+        array[i] = sorted[i] = float(std::rand() % 10);
+      std::sort(sorted, sorted + iLength);
+      QCOMPARE(Pii::medianN(array, iLength), sorted[(iLength-1)/2]);
+      QCOMPARE(Pii::fastMedian(array, iLength), sorted[(iLength-1)/2]);
+    }
+}
+
+void TestPiiMath::parallelSort()
+{
+  PiiMatrix<int> matData(1, 100000);
+  for (int i=0; i<matData.columns(); ++i)
+    matData(0,i) = std::rand() % 1000;
+  QVector<int> vecSorted(matData.columns());
+  std::copy(matData.rowBegin(0), matData.rowEnd(0), vecSorted.begin());
+  std::sort(vecSorted.begin(), vecSorted.end());
+
+  for (int iThreads=1; iThreads<=5; ++iThreads)
+    {
+      PiiMatrix<int> matCopy(matData);
+      Pii::parallelSort(matCopy.rowBegin(0), matCopy.rowEnd(0), PiiParallelPolicy(iThreads, 1));
+      QVERIFY(std::equal(vecSorted.begin(), vecSorted.end(), matCopy.rowBegin(0)));
+    }
+
+  Pii::parallelSort(matData.rowBegin(0), matData.rowEnd(0), std::greater<int>(), PiiParallelPolicy(3, 1));
+  QVERIFY(std::equal(vecSorted.begin(), vecSorted.end(), std::reverse_iterator<int*>(matData.rowEnd(0))));
+}
+
 void TestPiiMath::windowSum()
 {
   float data[5] = { 1, 2, 3, 4, 5 };
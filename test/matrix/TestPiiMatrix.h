@@ -42,7 +42,10 @@ private slots:
   void uninitialized();
   void reserve();
   void mapped();
+  void leased();
+  void deviceBuffer();
   void map();
+  void expressions();
 
 private:
   template <class Matrix> void setTo(Matrix& matrix, typename Matrix::value_type value);
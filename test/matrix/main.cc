@@ -777,6 +777,34 @@ void TestPiiMatrix::alignment()
   QCOMPARE(long(mat1[0]) & 0x3, 0l);
   QCOMPARE(long(mat2[0]) & 0x3, 0l);
   QCOMPARE(long(mat3[0]) & 0x3, 0l);
+  QVERIFY(mat1.alignment() >= 4);
+  QCOMPARE(PiiTypelessMatrix::defaultAlignment(), std::size_t(4));
+
+  PiiTypelessMatrix::setDefaultAlignment();
+  QCOMPARE(PiiTypelessMatrix::defaultAlignment(), std::size_t(PiiTypelessMatrix::SimdAlignment));
+  {
+    PiiMatrix<uchar> mat4(5,3);
+    QCOMPARE(mat4.stride(), std::size_t(64));
+    QCOMPARE(mat4.alignment(), std::size_t(64));
+    PiiMatrix<float> mat5(3,100);
+    QCOMPARE(mat5.stride(), std::size_t(448));
+    QVERIFY(mat5.alignment() >= 64);
+    for (int r=0; r<3; ++r)
+      for (int c=0; c<100; ++c)
+        mat5(r,c) = float(r*100 + c);
+    // Reallocation must retain both alignment and contents.
+    for (int i=0; i<20; ++i)
+      mat5.appendRow();
+    QVERIFY(mat5.alignment() >= 64);
+    QCOMPARE(mat5(2,99), 299.0f);
+    QCOMPARE(mat5(1,0), 100.0f);
+  }
+  PiiTypelessMatrix::setDefaultAlignment(33);
+  QCOMPARE(PiiTypelessMatrix::defaultAlignment(), std::size_t(64));
+  PiiTypelessMatrix::setDefaultAlignment(0);
+  QCOMPARE(PiiTypelessMatrix::defaultAlignment(), std::size_t(4));
+  PiiMatrix<uchar> mat6(5,3);
+  QCOMPARE(mat6.stride(), std::size_t(4));
 }
 
 void TestPiiMatrix::multiply()
@@ -980,6 +1008,128 @@ void TestPiiMatrix::mapped()
   QVERIFY(Pii::equals(mat.mapped(std::minus<int>(), mat), PiiMatrix<int>(3,3)));
 
 }
+namespace
+{
+  class TestLease : public PiiBufferLease
+  {
+  public:
+    TestLease(int* returnCount) : _pReturnCount(returnCount) {}
+  protected:
+    void returnBuffer() { ++*_pReturnCount; }
+  private:
+    int* _pReturnCount;
+  };
+}
+
+void TestPiiMatrix::leased()
+{
+  int aiBuffer[6] = { 1, 2, 3, 4, 5, 6 };
+  int iReturnCount = 0;
+  PiiBufferLease* pLease = new TestLease(&iReturnCount);
+  {
+    PiiMatrix<int> mat(2, 3, aiBuffer, pLease);
+    pLease->release();
+    QCOMPARE(iReturnCount, 0);
+    QCOMPARE(mat(1,2), 6);
+    // Writes go to the leased buffer.
+    mat(0,0) = 7;
+    QCOMPARE(aiBuffer[0], 7);
+
+    {
+      // Modifying a shared matrix detaches it from the buffer.
+      PiiMatrix<int> copy(mat);
+      copy(0,1) = 8;
+      QCOMPARE(aiBuffer[1], 2);
+      QCOMPARE(copy(0,0), 7);
+    }
+    QCOMPARE(iReturnCount, 0);
+
+    // The lease is held until the last reference is gone.
+    const PiiMatrix<int> copy(mat);
+    mat = PiiMatrix<int>();
+    QCOMPARE(iReturnCount, 0);
+    QCOMPARE(copy(1,2), 6);
+  }
+  QCOMPARE(iReturnCount, 1);
+}
+
+namespace
+{
+  // Fills the host buffer with a constant, counting downloads and
+  // deletions.
+  class TestDeviceBuffer : public PiiDeviceBuffer
+  {
+  public:
+    TestDeviceBuffer(int value, int* downloads, int* deletions) :
+      _iValue(value), _pDownloads(downloads), _pDeletions(deletions)
+    {}
+    ~TestDeviceBuffer() { ++*_pDeletions; }
+  protected:
+    void download(void* host, std::size_t stride, int rows)
+    {
+      for (int r=0; r<rows; ++r)
+        {
+          int* pRow = reinterpret_cast<int*>(static_cast<char*>(host) + stride * r);
+          for (int c=0; c<3; ++c)
+            pRow[c] = _iValue;
+        }
+      ++*_pDownloads;
+    }
+  private:
+    int _iValue;
+    int *_pDownloads, *_pDeletions;
+  };
+}
+
+void TestPiiMatrix::deviceBuffer()
+{
+  int iDownloads = 0, iDeletions = 0;
+  {
+    PiiMatrix<int> mat(2, 3);
+    const PiiMatrix<int>& cmat = mat;
+    QVERIFY(mat.deviceBuffer() == 0);
+    PiiDeviceBuffer* pBuffer = new TestDeviceBuffer(5, &iDownloads, &iDeletions);
+    mat.setDeviceBuffer(pBuffer);
+    pBuffer->release();
+    QVERIFY(mat.deviceBuffer() == pBuffer);
+
+    // Nothing to download while the host copy is up to date.
+    mat.syncHost();
+    QCOMPARE(iDownloads, 0);
+    QCOMPARE(cmat(1,2), 0);
+
+    // Syncing a submatrix downloads the whole source.
+    pBuffer->setHostStale(true);
+    {
+      const PiiMatrix<int> sub(cmat(1,0,1,-1));
+      sub.syncHost();
+      QCOMPARE(iDownloads, 1);
+      QVERIFY(!pBuffer->isHostStale());
+      QCOMPARE(sub(0,2), 5);
+      QCOMPARE(cmat(0,0), 5);
+    }
+    mat.syncHost();
+    QCOMPARE(iDownloads, 1);
+
+    // Cloning synchronizes the host copy, and the clone stays on the
+    // host.
+    pBuffer->setHostStale(true);
+    PiiMatrix<int> copy(mat);
+    copy(0,0) = 1;
+    QCOMPARE(iDownloads, 2);
+    QVERIFY(copy.deviceBuffer() == 0);
+    QVERIFY(mat.deviceBuffer() == pBuffer);
+    QCOMPARE(copy(0,1), 5);
+
+    // Null matrices never get a device buffer.
+    PiiMatrix<int> empty;
+    empty.setDeviceBuffer(pBuffer);
+    QVERIFY(empty.deviceBuffer() == 0);
+    QCOMPARE(iDeletions, 0);
+  }
+  QCOMPARE(iDeletions, 1);
+}
+
 void TestPiiMatrix::map()
 {
   PiiMatrix<int> mat(3, 3,
@@ -992,4 +1142,33 @@ void TestPiiMatrix::map()
   QVERIFY(Pii::equals(mat, PiiMatrix<int>::constant(3,3, 1)));
 }
 
+void TestPiiMatrix::expressions()
+{
+  PiiMatrix<int> mat1(3, 4,
+                      1, 2, 3, 4,
+                      5, 6, 7, 8,
+                      9, 10, 11, 12);
+  PiiMatrix<int> mat2(PiiMatrix<int>::constant(3, 4, 1));
+
+  PiiMatrix<double> matResult(mat1 * 2 + mat2 - mat1);
+  QVERIFY(Pii::equals(matResult, PiiMatrix<double>(mat1 + 1)));
+
+  matResult = Pii::transpose(mat1) * 3;
+  QCOMPARE(matResult.rows(), 4);
+  QCOMPARE(matResult(3,2), 36.0);
+
+  PiiMatrix<int> matTarget(4, 5);
+  matTarget(1, 1, 3, 4) << mat1 - mat2;
+  QCOMPARE(matTarget(0,0), 0);
+  QCOMPARE(matTarget(1,1), 0);
+  QCOMPARE(matTarget(3,4), 11);
+  QCOMPARE(matTarget(3,0), 0);
+
+  matTarget(1, 1, 3, 4) += mat2 * 2;
+  QCOMPARE(matTarget(2,2), 7);
+  matTarget(1, 1, 3, 4) *= 2;
+  QCOMPARE(matTarget(3,4), 26);
+  QCOMPARE(Pii::sum<int>(matTarget(0, 0, 1, -1)), 0);
+}
+
 QTEST_MAIN(TestPiiMatrix)
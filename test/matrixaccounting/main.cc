@@ -0,0 +1,95 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMatrixAccounting.h"
+
+#include <PiiMatrixAccounting.h>
+#include <PiiMatrix.h>
+#include <QtTest>
+
+void TestPiiMatrixAccounting::counting()
+{
+  PiiMatrixAccounting::setEnabled(true);
+  PiiMatrixAccounting::Counters counters;
+  {
+    PiiMatrixAccounting::Scope scope(&counters);
+    PiiMatrix<int> a(10,10);
+    QCOMPARE(counters.iAllocations, qint64(1));
+    QCOMPARE(counters.iAllocatedBytes, qint64(400));
+
+    PiiMatrix<int> b(a);
+    QCOMPARE(counters.iAllocations, qint64(1));
+    QCOMPARE(counters.iClones, qint64(0));
+    b(0,0) = 1; // detaches
+    QCOMPARE(counters.iAllocations, qint64(2));
+    QCOMPARE(counters.iClones, qint64(1));
+    QCOMPARE(counters.iClonedBytes, qint64(400));
+
+    PiiMatrix<float> c(a);
+    QCOMPARE(counters.iAllocations, qint64(3));
+    QCOMPARE(counters.iConversions, qint64(1));
+    QCOMPARE(counters.iConvertedBytes, qint64(400));
+    PiiMatrix<double> d(c);
+    QCOMPARE(counters.iConversions, qint64(2));
+    QCOMPARE(counters.iConvertedBytes, qint64(1200));
+  }
+  QVERIFY(PiiMatrixAccounting::currentCounters() == 0);
+
+  // No counters installed -> nothing recorded
+  PiiMatrix<int> e(10,10);
+  QCOMPARE(counters.iAllocations, qint64(3));
+
+  PiiMatrixAccounting::Counters other;
+  other.merge(counters);
+  QCOMPARE(other.iAllocatedBytes, counters.iAllocatedBytes);
+  other.clear();
+  QVERIFY(other.isEmpty());
+  PiiMatrixAccounting::setEnabled(false);
+}
+
+void TestPiiMatrixAccounting::nesting()
+{
+  PiiMatrixAccounting::setEnabled(true);
+  PiiMatrixAccounting::Counters outer, inner;
+  {
+    PiiMatrixAccounting::Scope outerScope(&outer);
+    PiiMatrix<char> a(1,1);
+    {
+      PiiMatrixAccounting::Scope innerScope(&inner);
+      QVERIFY(PiiMatrixAccounting::currentCounters() == &inner);
+      PiiMatrix<char> b(1,1), c(1,1);
+    }
+    QVERIFY(PiiMatrixAccounting::currentCounters() == &outer);
+    PiiMatrix<char> d(1,1);
+  }
+  QCOMPARE(outer.iAllocations, qint64(2));
+  QCOMPARE(inner.iAllocations, qint64(2));
+  PiiMatrixAccounting::setEnabled(false);
+}
+
+void TestPiiMatrixAccounting::disabled()
+{
+  QVERIFY(!PiiMatrixAccounting::isEnabled());
+  PiiMatrixAccounting::Counters counters;
+  {
+    PiiMatrixAccounting::Scope scope(&counters);
+    QVERIFY(PiiMatrixAccounting::currentCounters() == 0);
+    PiiMatrix<int> a(10,10), b(a);
+    b(0,0) = 1;
+  }
+  QVERIFY(counters.isEmpty());
+}
+
+QTEST_MAIN(TestPiiMatrixAccounting)
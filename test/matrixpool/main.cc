@@ -0,0 +1,155 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMatrixPool.h"
+
+#include <PiiMatrixPool.h>
+#include <PiiMatrix.h>
+#include <QtTest>
+#include <QThread>
+
+void TestPiiMatrixPool::sizeClass()
+{
+  QCOMPARE(PiiMatrixPool::sizeClass(100), -1);
+  QCOMPARE(PiiMatrixPool::sizeClass(PiiMatrixPool::MinPooledSize), 0);
+  QCOMPARE(PiiMatrixPool::blockSize(0), std::size_t(65536));
+  QCOMPARE(PiiMatrixPool::sizeClass(65537), 1);
+  QCOMPARE(PiiMatrixPool::blockSize(1), std::size_t(81920));
+  for (int i=1; i<PiiMatrixPool::SizeClassCount; ++i)
+    {
+      std::size_t iSize = PiiMatrixPool::blockSize(i);
+      QVERIFY(iSize > PiiMatrixPool::blockSize(i-1));
+      // At most 25% waste
+      QVERIFY(iSize - PiiMatrixPool::blockSize(i-1) <= PiiMatrixPool::blockSize(i-1) / 4);
+      QCOMPARE(PiiMatrixPool::sizeClass(iSize), i);
+      QCOMPARE(PiiMatrixPool::sizeClass(PiiMatrixPool::blockSize(i-1) + 1), i);
+    }
+}
+
+void TestPiiMatrixPool::reuse()
+{
+  PiiMatrixPool::setEnabled(true);
+  QVERIFY(PiiMatrixPool::isEnabled());
+  PiiMatrixPool::resetStatistics();
+
+  const void* pFirstBuffer = 0;
+  for (int i=0; i<10; ++i)
+    {
+      PiiMatrix<uchar> image(512, 512);
+      if (i == 0)
+        pFirstBuffer = image[0];
+      else
+        QCOMPARE(static_cast<const void*>(image[0]), pFirstBuffer);
+      image(511, 511) = 1;
+    }
+
+  PiiMatrixPool::Statistics stats(PiiMatrixPool::statistics());
+  QCOMPARE(stats.iMisses, qint64(1));
+  QCOMPARE(stats.iHits, qint64(9));
+  QCOMPARE(stats.hitRate(), 0.9);
+  QVERIFY(stats.iRetainedBytes >= 512*512);
+  QVERIFY(stats.iRetainedBlocks >= 1);
+
+  // Small matrices bypass the pool.
+  PiiMatrix<int> small(3,3);
+  QCOMPARE(PiiMatrixPool::statistics().iMisses, qint64(1));
+
+  // Pooled data is initialized like any other.
+  PiiMatrix<uchar> zeros(512, 512);
+  QCOMPARE(zeros(511, 511), uchar(0));
+
+  PiiMatrixPool::setEnabled(false);
+}
+
+void TestPiiMatrixPool::disable()
+{
+  PiiMatrixPool::setEnabled(true);
+  {
+    PiiMatrix<float> mat(256, 256);
+  }
+  QVERIFY(PiiMatrixPool::statistics().iRetainedBlocks >= 1);
+  PiiMatrixPool::setEnabled(false);
+  QVERIFY(!PiiMatrixPool::isEnabled());
+  PiiMatrixPool::Statistics stats(PiiMatrixPool::statistics());
+  QCOMPARE(stats.iRetainedBlocks, 0);
+  QCOMPARE(stats.iRetainedBytes, qint64(0));
+
+  // Users are counted.
+  PiiMatrixPool::addUser();
+  PiiMatrixPool::setEnabled(true);
+  PiiMatrixPool::setEnabled(false);
+  QVERIFY(PiiMatrixPool::isEnabled());
+  PiiMatrixPool::removeUser();
+  QVERIFY(!PiiMatrixPool::isEnabled());
+
+  // A buffer allocated while pooling was enabled can be released
+  // after disabling.
+  PiiMatrixPool::setEnabled(true);
+  PiiMatrix<double>* pMatrix = new PiiMatrix<double>(100, 100);
+  PiiMatrixPool::setEnabled(false);
+  delete pMatrix;
+  QCOMPARE(PiiMatrixPool::statistics().iRetainedBlocks, 0);
+}
+
+void TestPiiMatrixPool::reserve()
+{
+  PiiMatrixPool::setEnabled(true);
+  // 80 kB, reallocation moves the data out of the pool.
+  PiiMatrix<int> mat(20, 1000);
+  for (int i=0; i<20; ++i)
+    mat(i, 999) = i;
+  mat.insertRow(0)[999] = -1;
+  mat.removeRow(0);
+  for (int i=20; i<100; ++i)
+    mat.appendRow()[999] = i;
+  QCOMPARE(mat.rows(), 100);
+  for (int i=0; i<100; ++i)
+    QCOMPARE(mat(i, 999), i);
+  mat.resize(0, 0);
+  PiiMatrixPool::setEnabled(false);
+}
+
+class AllocatorThread : public QThread
+{
+protected:
+  void run()
+  {
+    for (int i=0; i<100; ++i)
+      {
+        PiiMatrix<uchar> image(1024, 1024);
+        image(i, i) = uchar(i);
+      }
+  }
+};
+
+void TestPiiMatrixPool::threads()
+{
+  PiiMatrixPool::setEnabled(true);
+  PiiMatrixPool::resetStatistics();
+  AllocatorThread threads[4];
+  for (int i=0; i<4; ++i)
+    threads[i].start();
+  for (int i=0; i<4; ++i)
+    QVERIFY(threads[i].wait(5000));
+
+  PiiMatrixPool::Statistics stats(PiiMatrixPool::statistics());
+  QCOMPARE(stats.iHits + stats.iMisses, qint64(400));
+  QVERIFY(stats.iMisses <= 4);
+  // Exited threads hand their caches over to the shared pool.
+  QVERIFY(stats.iRetainedBytes >= 1024*1024);
+  PiiMatrixPool::setEnabled(false);
+}
+
+QTEST_MAIN(TestPiiMatrixPool)
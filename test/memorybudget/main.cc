@@ -0,0 +1,91 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiMemoryBudget.h"
+
+#include <PiiMemoryBudget.h>
+#include <QtTest>
+
+void TestPiiMemoryBudget::charge()
+{
+  PiiMemoryBudget root, child(&root);
+  QCOMPARE(child.parent(), &root);
+  QCOMPARE(root.usedBytes(), qint64(0));
+
+  child.charge(1);
+  QCOMPARE(child.usedBytes(), qint64(1024));
+  QCOMPARE(root.usedBytes(), qint64(1024));
+  child.charge(2048);
+  QCOMPARE(child.usedBytes(), qint64(3072));
+  root.charge(1024);
+  QCOMPARE(child.usedBytes(), qint64(3072));
+  QCOMPARE(root.usedBytes(), qint64(4096));
+  child.release(1);
+  child.release(2048);
+  QCOMPARE(child.usedBytes(), qint64(0));
+  QCOMPARE(root.usedBytes(), qint64(1024));
+  // Objects without data are not accounted for.
+  child.charge(0);
+  QCOMPARE(child.usedBytes(), qint64(0));
+}
+
+void TestPiiMemoryBudget::limit()
+{
+  PiiMemoryBudget root, child(&root);
+  QVERIFY(!child.isLimited());
+  QVERIFY(!child.isExceeded());
+
+  root.setLimit(4096);
+  QCOMPARE(root.limit(), qint64(4096));
+  QVERIFY(child.isLimited());
+  QVERIFY(!root.isExceeded());
+  child.charge(3072);
+  QVERIFY(!child.isExceeded());
+  child.charge(1024);
+  QVERIFY(child.isExceeded());
+  QVERIFY(root.isExceeded());
+
+  child.setLimit(8192);
+  QVERIFY(child.isExceeded());
+  root.setLimit(0);
+  QVERIFY(!child.isExceeded());
+  child.setLimit(4096);
+  QVERIFY(child.isExceeded());
+  QVERIFY(!root.isExceeded());
+  child.release(4096);
+  QVERIFY(!child.isExceeded());
+}
+
+void TestPiiMemoryBudget::setParent()
+{
+  PiiMemoryBudget a, b;
+  {
+    PiiMemoryBudget child(&a);
+    child.charge(2048);
+    QCOMPARE(a.usedBytes(), qint64(2048));
+
+    child.setParent(&b);
+    QCOMPARE(a.usedBytes(), qint64(0));
+    QCOMPARE(b.usedBytes(), qint64(2048));
+    child.setParent(0);
+    QCOMPARE(b.usedBytes(), qint64(0));
+    child.setParent(&a);
+    QCOMPARE(a.usedBytes(), qint64(2048));
+  }
+  // Destroying releases from the parents.
+  QCOMPARE(a.usedBytes(), qint64(0));
+}
+
+QTEST_MAIN(TestPiiMemoryBudget)
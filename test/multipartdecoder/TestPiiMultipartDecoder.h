@@ -25,6 +25,8 @@ class TestPiiMultipartDecoder : public QObject
 private slots:
   void nestedMultiparts();
   void prefetchedHeader();
+  void largeBodies();
+  void largeBodies_data();
 };
 
 
@@ -116,4 +116,63 @@ X-URI: empty\r\n\
     }
 }
 
+void TestPiiMultipartDecoder::largeBodies_data()
+{
+  QTest::addColumn<int>("bodySize");
+  QTest::addColumn<int>("readSize");
+
+  QTest::newRow("small reads") << 100000 << 7;
+  QTest::newRow("direct reads") << 100000 << 65536;
+  QTest::newRow("readAll") << 300000 << 0;
+}
+
+void TestPiiMultipartDecoder::largeBodies()
+{
+  QFETCH(int, bodySize);
+  QFETCH(int, readSize);
+
+  // Binary data with lots of dashes and partial boundaries.
+  QByteArray aBody;
+  for (int i=0; aBody.size() < bodySize; ++i)
+    aBody += i % 3 == 0 ? QByteArray("--AaB03") : QByteArray(1, char(i % 100));
+  QByteArray aMessage("Content-Type: multipart/mixed; boundary=AaB03x\r\n\r\n"
+                      "--AaB03x\r\n"
+                      "Content-Type: application/octet-stream\r\n\r\n");
+  aMessage += aBody;
+  aMessage += "--AaB03x\r\n"
+    "Content-Type: text/plain\r\n\r\n"
+    "second\r\n"
+    "--AaB03x--\r\n";
+
+  QBuffer bfr(&aMessage);
+  bfr.open(QIODevice::ReadOnly);
+  PiiMultipartDecoder decoder(&bfr);
+
+  try
+    {
+      QVERIFY(decoder.nextMessage());
+      QByteArray aDecoded;
+      if (readSize == 0)
+        aDecoded = decoder.readAll();
+      else
+        {
+          QByteArray aPiece(readSize, 0);
+          qint64 iBytesRead;
+          while ((iBytesRead = decoder.read(aPiece.data(), readSize)) > 0)
+            aDecoded.append(aPiece.constData(), int(iBytesRead));
+        }
+      QCOMPARE(aDecoded.size(), aBody.size());
+      QVERIFY(aDecoded == aBody);
+
+      QVERIFY(decoder.nextMessage());
+      QCOMPARE(decoder.header().contentType(), QString("text/plain"));
+      QCOMPARE(decoder.readAll(), QByteArray("second\r\n"));
+      QVERIFY(!decoder.nextMessage());
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.location() + ": " + ex.message()));
+    }
+}
+
 QTEST_MAIN(TestPiiMultipartDecoder)
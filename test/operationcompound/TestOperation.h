@@ -17,6 +17,7 @@
 #define _TESTOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include <QAtomicInt>
 
 class TestOperation : public PiiDefaultOperation
 {
@@ -25,6 +26,7 @@ class TestOperation : public PiiDefaultOperation
 public:
   TestOperation() :
     bFail(false),
+    iCheckOrder(-1),
     _iCount(0)
   {
     addSocket(new PiiInputSocket("input"));
@@ -35,13 +37,22 @@ public:
 
   void check(bool reset)
   {
+    iCheckOrder = checkCounter().fetchAndAddOrdered(1);
     if (bFail)
       PII_THROW(PiiExecutionException, "");
     PiiDefaultOperation::check(reset);
     _iCount = 0;
   }
 
+  // Counts check() calls over all instances.
+  static QAtomicInt& checkCounter()
+  {
+    static QAtomicInt iCounter;
+    return iCounter;
+  }
+
   bool bFail;
+  int iCheckOrder;
 
 protected:
   void process()
@@ -33,6 +33,8 @@ private slots:
   void addRemoveDetachChild();
   void proxyInnerSockets();
   void disabledOperations();
+  void fusedChains();
+  void parallelCheck();
   void cleanupTestCase();
 
 private:
@@ -314,6 +314,140 @@ void TestPiiOperationCompound::disabledOperations()
   QCOMPARE(e->activityMode(), PiiOperation::Disabled);
 }
 
+void TestPiiOperationCompound::fusedChains()
+{
+  PiiOperationCompound* pCompound = new PiiOperationCompound;
+  setOperation(pCompound);
+  /*              ,- d
+   * a - b - c --
+   *              `- e - f
+   */
+  TestOperation* a = new TestOperation;
+  TestOperation* b = new TestOperation;
+  TestOperation* c = new TestOperation;
+  TestOperation* d = new TestOperation;
+  TestOperation* e = new TestOperation;
+  TestOperation* f = new TestOperation;
+  pCompound->addOperation(a);
+  pCompound->addOperation(b);
+  pCompound->addOperation(c);
+  pCompound->addOperation(d);
+  pCompound->addOperation(e);
+  pCompound->addOperation(f);
+
+  a->connectOutput("output", b, "input");
+  b->connectOutput("output", c, "input");
+  c->connectOutput("output", d, "input");
+  c->connectOutput("output", e, "input");
+  e->connectOutput("output", f, "input");
+
+  pCompound->exposeInput(a->input("input"));
+  pCompound->exposeOutput(f->output("output"));
+
+  QVERIFY(!pCompound->chainFusion());
+  QVERIFY(start());
+  QVERIFY(pCompound->fusedChains().isEmpty());
+  QVERIFY(stop());
+
+  pCompound->setProperty("chainFusion", true);
+  QVERIFY(start());
+  QList<QList<PiiOperation*> > lstChains(pCompound->fusedChains());
+  QCOMPARE(lstChains.size(), 2);
+  QList<PiiOperation*> lstAbc, lstEf;
+  lstAbc << a << b << c;
+  lstEf << e << f;
+  QVERIFY(lstChains.contains(lstAbc));
+  QVERIFY(lstChains.contains(lstEf));
+
+  // Fused operations must still pass all objects.
+  for (int i=0; i<5; ++i)
+    {
+      QVERIFY(sendObject("input", i));
+      QCOMPARE(outputValue("output", -1), i);
+    }
+  QVERIFY(stop());
+
+  // Threaded operations can't be fused.
+  b->setProperty("threadCount", 1);
+  QVERIFY(start());
+  lstChains = pCompound->fusedChains();
+  QCOMPARE(lstChains.size(), 2);
+  lstAbc.removeFirst();
+  QVERIFY(lstChains.contains(lstAbc));
+  QVERIFY(lstChains.contains(lstEf));
+  QVERIFY(stop());
+}
+
+void TestPiiOperationCompound::parallelCheck()
+{
+  PiiOperationCompound* pCompound = new PiiOperationCompound;
+  setOperation(pCompound);
+  pCompound->setParallelCheck(true);
+  QVERIFY(pCompound->parallelCheck());
+
+  TestOperation* a = new TestOperation;
+  TestOperation* b = new TestOperation;
+  TestOperation* c = new TestOperation;
+  TestOperation* d = new TestOperation;
+  TestOperation* e = new TestOperation;
+  TestOperation* f = new TestOperation;
+  // Added in reverse order to make sure that the dependencies, not the
+  // order of children, determine the order of checks.
+  pCompound->addOperation(f);
+  pCompound->addOperation(e);
+  pCompound->addOperation(d);
+  pCompound->addOperation(c);
+  pCompound->addOperation(b);
+  pCompound->addOperation(a);
+
+  a->connectOutput("output", b, "input");
+  a->connectOutput("output", c, "input");
+  c->connectOutput("output", d, "input");
+  c->connectOutput("output", e, "input");
+  e->connectOutput("output", f, "input");
+
+  pCompound->exposeInput(a->input("input"));
+  pCompound->exposeOutput(f->output("output"));
+
+  QVERIFY(start());
+  QVERIFY(a->iCheckOrder < b->iCheckOrder);
+  QVERIFY(a->iCheckOrder < c->iCheckOrder);
+  QVERIFY(c->iCheckOrder < d->iCheckOrder);
+  QVERIFY(c->iCheckOrder < e->iCheckOrder);
+  QVERIFY(e->iCheckOrder < f->iCheckOrder);
+  for (int i=0; i<3; ++i)
+    {
+      QVERIFY(sendObject("input", i));
+      QCOMPARE(outputValue("output", -1), i);
+    }
+  QVERIFY(stop());
+
+  // A failure must be reported and disable the dependent operations
+  // just like in sequential checking.
+  e->bFail = true;
+  try
+    {
+      pCompound->check(true);
+      QFAIL("Check did not fail.");
+    }
+  catch (PiiExecutionException& ex)
+    {
+      QVERIFY(ex.isCompound());
+      QCOMPARE(static_cast<PiiCompoundExecutionException&>(ex).exceptions().size(), 1);
+    }
+  QCOMPARE(a->activityMode(), PiiOperation::Enabled);
+  QCOMPARE(b->activityMode(), PiiOperation::Enabled);
+  QCOMPARE(c->activityMode(), PiiOperation::Enabled);
+  QCOMPARE(d->activityMode(), PiiOperation::Enabled);
+  QCOMPARE(e->activityMode(), PiiOperation::TemporarilyDisabled);
+  QCOMPARE(f->activityMode(), PiiOperation::TemporarilyDisabled);
+
+  e->bFail = false;
+  QVERIFY(start());
+  QCOMPARE(e->activityMode(), PiiOperation::Enabled);
+  QVERIFY(stop());
+}
+
 void TestPiiOperationCompound::cleanupTestCase()
 {
   setOperation(0);
@@ -26,6 +26,7 @@ class TestPiiOptimization : public QObject
 
 private slots:
   void bfgsMinimize();
+  void bfgsMinimizeSamples();
   void lmMinimize();
   void assign();
 };
@@ -0,0 +1,36 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestSampleFunction.h"
+
+int TestSampleFunction::sampleCount() const
+{
+  return _matSamples.rows();
+}
+
+double TestSampleFunction::accumulateGradient(const double* params, int firstSample, int endSample,
+                                              double* gradient) const
+{
+  double dSum = 0;
+  for (int i=firstSample; i<endSample; ++i)
+    {
+      const double* pSample = _matSamples[i];
+      double dError = params[0] * pSample[0] + params[1] - pSample[1];
+      dSum += dError * dError;
+      gradient[0] += 2 * dError * pSample[0];
+      gradient[1] += 2 * dError;
+    }
+  return dSum;
+}
@@ -0,0 +1,38 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTSAMPLEFUNCTION_H
+#define _TESTSAMPLEFUNCTION_H
+
+#include <PiiMatrix.h>
+#include <PiiOptimization.h>
+
+/**
+ * Fits a line y = x0 * t + x1 to samples (t, y) by minimizing the
+ * sum of squared errors.
+ */
+class TestSampleFunction : public PiiOptimization::SampleGradientFunction<double>
+{
+public:
+  TestSampleFunction(const PiiMatrix<double>& samples) : _matSamples(samples) {}
+
+  int sampleCount() const;
+  double accumulateGradient(const double* params, int firstSample, int endSample, double* gradient) const;
+
+private:
+  PiiMatrix<double> _matSamples;
+};
+
+#endif
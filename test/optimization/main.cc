@@ -20,6 +20,7 @@
 #include <QtTest>
 #include "TestFunction.h"
 #include "TestMarquardtFunction.h"
+#include "TestSampleFunction.h"
 
 #include <QDebug>
 #include <PiiMatrix.h>
@@ -40,6 +41,50 @@ void TestPiiOptimization::bfgsMinimize()
   QCOMPARE(results(0,0),0.0);
 }
 
+void TestPiiOptimization::bfgsMinimizeSamples()
+{
+  // y = 0.5 * t - 2 with a small symmetric disturbance. 1000 samples
+  // fill 16 blocks, the last one partially.
+  PiiMatrix<double> matSamples(1000, 2);
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      double t = (i - 500) * 0.01;
+      matSamples(i,0) = t;
+      matSamples(i,1) = 0.5 * t - 2 + (i % 2 ? 0.01 : -0.01);
+    }
+  TestSampleFunction func(matSamples);
+  PiiMatrix<double> initialParams(1,2, 3.0, 1.0);
+
+  PiiMatrix<double> result = PiiOptimization::bfgsMinimize(&func, initialParams,
+                                                           PiiParallelPolicy::sequential(),
+                                                           1e-10, 1e-14, 1e-14);
+  // The closed-form least-squares solution
+  double dMeanT = 0, dMeanY = 0;
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      dMeanT += matSamples(i,0);
+      dMeanY += matSamples(i,1);
+    }
+  dMeanT /= matSamples.rows();
+  dMeanY /= matSamples.rows();
+  double dCovariance = 0, dVariance = 0;
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      dCovariance += (matSamples(i,0) - dMeanT) * (matSamples(i,1) - dMeanY);
+      dVariance += (matSamples(i,0) - dMeanT) * (matSamples(i,0) - dMeanT);
+    }
+  double dSlope = dCovariance / dVariance;
+  QVERIFY(Pii::abs(result(0) - dSlope) < 1e-6);
+  QVERIFY(Pii::abs(result(1) - (dMeanY - dSlope * dMeanT)) < 1e-6);
+
+  // The partial sums are reduced in a fixed order.
+  PiiMatrix<double> parallelResult = PiiOptimization::bfgsMinimize(&func, initialParams,
+                                                                   PiiParallelPolicy(4, 1),
+                                                                   1e-10, 1e-14, 1e-14);
+  QCOMPARE(parallelResult(0), result(0));
+  QCOMPARE(parallelResult(1), result(1));
+}
+
 void TestPiiOptimization::lmMinimize()
 {
   TestMarquardtFunction func;
@@ -0,0 +1,58 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIIPROPERTYBATCH_H
+#define _TESTPIIPROPERTYBATCH_H
+
+#include <QObject>
+#include <PiiDefaultOperation.h>
+
+class TestOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+  Q_PROPERTY(int value READ value WRITE setValue);
+  Q_PROPERTY(QString text READ text WRITE setText);
+
+public:
+  TestOperation(const QString& name) : _iValue(0)
+  {
+    setObjectName(name);
+  }
+
+  void setValue(int value) { _iValue = value; }
+  int value() const { return _iValue; }
+  void setText(const QString& text) { _strText = text; }
+  QString text() const { return _strText; }
+
+protected:
+  void process() {}
+
+private:
+  int _iValue;
+  QString _strText;
+};
+
+class TestPiiPropertyBatch : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void values();
+  void setValues();
+  void update();
+  void deletedOperation();
+};
+
+#endif //_TESTPIIPROPERTYBATCH_H
@@ -0,0 +1,130 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiPropertyBatch.h"
+
+#include <PiiOperationCompound.h>
+#include <PiiPropertyBatch.h>
+#include <QtTest>
+
+namespace
+{
+  /*  root
+   *  |- a
+   *  `- sub
+   *     `- b
+   */
+  PiiOperationCompound* createTree()
+  {
+    PiiOperationCompound* pRoot = new PiiOperationCompound;
+    PiiOperationCompound* pSub = new PiiOperationCompound;
+    pSub->setObjectName("sub");
+    pRoot->addOperation(new TestOperation("a"));
+    pRoot->addOperation(pSub);
+    pSub->addOperation(new TestOperation("b"));
+    return pRoot;
+  }
+
+  QStringList names()
+  {
+    return QStringList()
+      << "a.value"
+      << "sub.b.text"
+      << "a.dynamic"
+      << "chainFusion"
+      << "sub.b.value"
+      << "missing.value";
+  }
+}
+
+void TestPiiPropertyBatch::values()
+{
+  QScopedPointer<PiiOperationCompound> pRoot(createTree());
+  pRoot->childOperation("a")->setProperty("value", 1);
+  pRoot->childOperation("a")->setProperty("dynamic", 3.0);
+  pRoot->childOperation("sub.b")->setProperty("text", QString("b"));
+  pRoot->childOperation("sub.b")->setProperty("value", 2);
+
+  PiiPropertyBatch batch(pRoot.data(), names());
+  QCOMPARE(batch.count(), 6);
+  QCOMPARE(batch.names(), names());
+  QVERIFY(batch.root() == pRoot.data());
+
+  QVariantList lstValues(batch.values());
+  QCOMPARE(lstValues.size(), 6);
+  QCOMPARE(lstValues[0].toInt(), 1);
+  QCOMPARE(lstValues[1].toString(), QString("b"));
+  QCOMPARE(lstValues[2].toDouble(), 3.0);
+  QCOMPARE(lstValues[3].toBool(), false);
+  QCOMPARE(lstValues[4].toInt(), 2);
+  QVERIFY(!lstValues[5].isValid());
+
+  // Must be equal to reading the properties one by one.
+  QStringList lstNames(names());
+  for (int i=0; i<lstNames.size(); ++i)
+    QCOMPARE(lstValues[i], pRoot->property(lstNames[i]));
+}
+
+void TestPiiPropertyBatch::setValues()
+{
+  QScopedPointer<PiiOperationCompound> pRoot(createTree());
+  PiiPropertyBatch batch(pRoot.data(), names());
+
+  QCOMPARE(batch.setValues(QVariantList() << 5 << "text" << QVariant() << true << 6), 5);
+  QCOMPARE(pRoot->property("a.value").toInt(), 5);
+  QCOMPARE(pRoot->property("sub.b.text").toString(), QString("text"));
+  QVERIFY(!pRoot->property("a.dynamic").isValid());
+  QCOMPARE(pRoot->property("chainFusion").toBool(), true);
+  QCOMPARE(pRoot->property("sub.b.value").toInt(), 6);
+}
+
+void TestPiiPropertyBatch::update()
+{
+  QScopedPointer<PiiOperationCompound> pRoot(createTree());
+  PiiPropertyBatch batch(pRoot.data(), names());
+
+  QVariantList lstValues;
+  QCOMPARE(batch.update(lstValues).size(), 6);
+  QCOMPARE(lstValues.size(), 6);
+  QVERIFY(batch.update(lstValues).isEmpty());
+
+  pRoot->setProperty("sub.b.value", 7);
+  pRoot->setProperty("a.dynamic", 1);
+  QVector<int> vecChanged(batch.update(lstValues));
+  QCOMPARE(vecChanged.size(), 2);
+  QCOMPARE(vecChanged[0], 2);
+  QCOMPARE(vecChanged[1], 4);
+  QCOMPARE(lstValues[4].toInt(), 7);
+  QVERIFY(batch.update(lstValues).isEmpty());
+}
+
+void TestPiiPropertyBatch::deletedOperation()
+{
+  QScopedPointer<PiiOperationCompound> pRoot(createTree());
+  PiiPropertyBatch batch(pRoot.data(), names());
+  pRoot->setProperty("a.value", 1);
+
+  delete pRoot->removeOperation("sub");
+  QVariantList lstValues(batch.values());
+  QCOMPARE(lstValues[0].toInt(), 1);
+  QVERIFY(!lstValues[1].isValid());
+  QVERIFY(!lstValues[4].isValid());
+
+  // Resolving again looks for the properties in the compound itself.
+  batch.resolve();
+  QVERIFY(!batch.values()[4].isValid());
+}
+
+QTEST_MAIN(TestPiiPropertyBatch)
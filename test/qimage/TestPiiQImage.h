@@ -25,6 +25,8 @@ class TestPiiQImage : public QObject
 private slots:
   void imageToMatrix();
   void matrixToImage();
+  void sharedImageToMatrix();
+  void sharedMatrixToImage();
 };
 
 #endif //_TESTPIIQIMAGEMATRIX_H
@@ -102,4 +102,65 @@ void TestPiiQImage::matrixToImage()
   }
 }
 
+void TestPiiQImage::sharedImageToMatrix()
+{
+  {
+    QImage image(5, 3, QImage::Format_RGB32);
+    image.fill(qRgb(1, 2, 3));
+    PiiMatrix<PiiColor4<unsigned char> > matrix(Pii::qImageToSharedMatrix<PiiColor4<unsigned char> >(image));
+    const PiiMatrix<PiiColor4<unsigned char> >& constMatrix = matrix;
+    QCOMPARE(matrix.rows(), 3);
+    QCOMPARE(matrix.columns(), 5);
+    QVERIFY(static_cast<const void*>(constMatrix.row(0)) == static_cast<const void*>(image.constBits()));
+    QCOMPARE(constMatrix(2,4).rgbR, (unsigned char)1);
+    QCOMPARE(constMatrix(2,4).rgbB, (unsigned char)3);
+
+    // Modifying the matrix must not change the image.
+    matrix(0,0) = PiiColor4<unsigned char>(0, 0, 0);
+    QVERIFY(static_cast<const void*>(constMatrix.row(0)) != static_cast<const void*>(image.constBits()));
+    QCOMPARE(qRed(image.pixel(0,0)), 1);
+  }
+  {
+    // Incompatible formats are converted
+    QImage image(4, 2, QImage::Format_RGB16);
+    image.fill(Qt::white);
+    PiiMatrix<PiiColor4<unsigned char> > matrix(Pii::qImageToSharedMatrix<PiiColor4<unsigned char> >(image));
+    QCOMPARE(matrix.rows(), 2);
+    QCOMPARE(matrix(1,3).rgbG, (unsigned char)255);
+  }
+  // No matching format
+  QVERIFY(Pii::qImageToSharedMatrix<double>(QImage(2, 2, QImage::Format_RGB32)).isEmpty());
+}
+
+void TestPiiQImage::sharedMatrixToImage()
+{
+  QImage image;
+  {
+    PiiMatrix<PiiColor4<unsigned char> > matrix(2, 8);
+    matrix(1,7) = PiiColor4<unsigned char>(10, 20, 30);
+    const PiiMatrix<PiiColor4<unsigned char> >& constMatrix = matrix;
+    image = Pii::matrixToSharedQImage(constMatrix);
+    QCOMPARE(image.format(), QImage::Format_RGB32);
+    QVERIFY(static_cast<const void*>(image.constBits()) == static_cast<const void*>(constMatrix.row(0)));
+  }
+  // The image keeps the data alive.
+  QCOMPARE(qRed(image.pixel(7,1)), 10);
+  QCOMPARE(qBlue(image.pixel(7,1)), 30);
+
+#if QT_VERSION >= 0x050500
+  {
+    PiiMatrix<unsigned char> matrix(3, 4);
+    matrix(2,3) = 7;
+    const PiiMatrix<unsigned char>& constMatrix = matrix;
+    QImage gray(Pii::matrixToSharedQImage(constMatrix));
+    QCOMPARE(gray.format(), QImage::Format_Grayscale8);
+    QVERIFY(gray.constBits() == constMatrix.row(0));
+    // Modifying the image must not change the matrix.
+    gray.bits()[0] = 1;
+    QCOMPARE(constMatrix(0,0), (unsigned char)0);
+    QCOMPARE(gray.constScanLine(2)[3], (unsigned char)7);
+  }
+#endif
+}
+
 QTEST_MAIN(TestPiiQImage)
@@ -24,6 +24,8 @@ class TestQuantizer : public QObject
 
 private slots:
   void divideEqually();
+  void lookupTable();
+  void quantizeMatrix();
 };
 
 #endif //_TESTQUANTIZER_H
@@ -16,6 +16,9 @@
 #include <QtTest>
 #include "TestQuantizer.h"
 #include <PiiQuantizer.h>
+#include <PiiHistogram.h>
+#include <PiiMatrixUtil.h>
+#include <limits>
 
 void TestQuantizer::divideEqually()
 {
@@ -37,5 +40,68 @@ void TestQuantizer::divideEqually()
   QCOMPARE(quantizer.quantize(7),2);
 }
 
+void TestQuantizer::lookupTable()
+{
+  PiiQuantizer<uchar> quantizer(PiiMatrix<uchar>(1,3, 10,10,200));
+  QCOMPARE(quantizer.lookupTable().columns(), 256);
+  QCOMPARE(quantizer.quantize(0), 0);
+  QCOMPARE(quantizer.quantize(9), 0);
+  QCOMPARE(quantizer.quantize(10), 2);
+  QCOMPARE(quantizer.quantize(199), 2);
+  QCOMPARE(quantizer.quantize(200), 3);
+  QCOMPARE(quantizer.quantize(255), 3);
+
+  PiiQuantizer<short> shortQuantizer(PiiMatrix<short>(1,2, -1000,0));
+  QCOMPARE(shortQuantizer.quantize(-32768), 0);
+  QCOMPARE(shortQuantizer.quantize(-1000), 1);
+  QCOMPARE(shortQuantizer.quantize(-1), 1);
+  QCOMPARE(shortQuantizer.quantize(32767), 2);
+
+  // Integer pixels, floating-point limits
+  PiiQuantizer<double> doubleQuantizer(PiiMatrix<double>(1,2, -0.5, 63.5));
+  PiiMatrix<int> matTable(doubleQuantizer.createLookupTable<signed char>());
+  QCOMPARE(matTable.columns(), 256);
+  for (int i=-128; i<128; ++i)
+    QCOMPARE(matTable(0, i+128), doubleQuantizer.quantize(i));
+  QVERIFY(doubleQuantizer.createLookupTable<int>().isEmpty());
+
+  // Quantized histograms must not depend on the table.
+  PiiMatrix<uchar> matImage(3,4,
+                            0,10,11,200,
+                            255,9,10,3,
+                            1,2,199,201);
+  QVERIFY(Pii::equals(PiiImage::histogram(matImage, quantizer), PiiMatrix<int>(1,4, 5,0,4,3)));
+}
+
+void TestQuantizer::quantizeMatrix()
+{
+  PiiMatrix<float> matLimits(1,5, -1.0, 0.0, 0.25, 0.25, 3.0);
+  PiiQuantizer<float> quantizer(matLimits);
+  PiiMatrix<float> matValues(3,7,
+                             -2.0, -1.0, -0.5, 0.0, 0.1, 0.25, 0.3,
+                             2.9, 3.0, 4.0, 1e10, -1e10, 0.24, 0.26,
+                             0.0, 0.0, 0.0, 0.0, 0.0, 0.0, std::numeric_limits<float>::quiet_NaN());
+  PiiMatrix<int> matLevels(quantizer.quantize<int>(matValues));
+  QCOMPARE(matLevels.rows(), 3);
+  QCOMPARE(matLevels.columns(), 7);
+  for (int r=0; r<matValues.rows(); ++r)
+    for (int c=0; c<matValues.columns(); ++c)
+      QCOMPARE(matLevels(r,c), quantizer.quantize(matValues(r,c)));
+  QCOMPARE(matLevels(0,5), 4);
+  QCOMPARE(matLevels(2,6), 5);
+
+  PiiQuantizer<int> intQuantizer(PiiMatrix<int>(1,3, -5,0,7));
+  PiiMatrix<int> matInts(2,9,
+                         -6,-5,-4,0,1,6,7,8,100,
+                         -100,100,0,0,0,0,0,0,0);
+  PiiMatrix<uchar> matIntLevels(intQuantizer.quantize<uchar>(matInts));
+  for (int r=0; r<matInts.rows(); ++r)
+    for (int c=0; c<matInts.columns(); ++c)
+      QCOMPARE(int(matIntLevels(r,c)), intQuantizer.quantize(matInts(r,c)));
+
+  PiiQuantizer<uchar> byteQuantizer(PiiMatrix<uchar>(1,1, 128));
+  QVERIFY(Pii::equals(byteQuantizer.quantize<int>(PiiMatrix<uchar>(1,3, 0,128,255)), PiiMatrix<int>(1,3, 0,1,1)));
+}
+
 QTEST_MAIN(TestQuantizer)
 
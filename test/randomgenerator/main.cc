@@ -0,0 +1,148 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiRandomGenerator.h"
+
+#include <PiiRandomGenerator.h>
+#include <QtTest>
+#include <QVector>
+#include <climits>
+#include <cmath>
+
+void TestPiiRandomGenerator::reproducibility()
+{
+  PiiRandomGenerator gen1(7), gen2(7), gen3(7, 1);
+  QVector<quint64> vec1(37), vec2(37), vec3(37);
+  gen1.fillBits(vec1.data(), vec1.size());
+  gen2.fillBits(vec2.data(), vec2.size());
+  gen3.fillBits(vec3.data(), vec3.size());
+  QVERIFY(vec1 == vec2);
+  QVERIFY(vec1 != vec3);
+
+  // Bulk and single-value generation produce the same bits.
+  gen1.seed(7);
+  for (int i=0; i<vec1.size(); ++i)
+    QCOMPARE(gen1.next(), vec2[i]);
+
+  gen1.seed(7);
+  QCOMPARE(gen1.next(), vec2[0]);
+}
+
+void TestPiiRandomGenerator::uniform()
+{
+  PiiRandomGenerator generator(1);
+  QVector<double> vecValues(10003);
+  generator.fillUniform(vecValues.data(), vecValues.size(), -2, 3);
+  double dSum = 0;
+  for (int i=0; i<vecValues.size(); ++i)
+    {
+      QVERIFY(vecValues[i] >= -2 && vecValues[i] < 3);
+      dSum += vecValues[i];
+    }
+  QVERIFY(std::fabs(dSum / vecValues.size() - 0.5) < 0.1);
+
+  QVector<float> vecFloats(5);
+  generator.fillUniform(vecFloats.data(), vecFloats.size());
+  for (int i=0; i<vecFloats.size(); ++i)
+    QVERIFY(vecFloats[i] >= 0 && vecFloats[i] < 1);
+
+  for (int i=0; i<1000; ++i)
+    {
+      double dValue = generator.uniform();
+      QVERIFY(dValue >= 0 && dValue < 1);
+    }
+}
+
+void TestPiiRandomGenerator::normal()
+{
+  PiiRandomGenerator generator(2);
+  QVector<double> vecValues(20001);
+  generator.fillNormal(vecValues.data(), vecValues.size(), 3, 2);
+  double dSum = 0, dSquareSum = 0;
+  for (int i=0; i<vecValues.size(); ++i)
+    {
+      dSum += vecValues[i];
+      dSquareSum += vecValues[i] * vecValues[i];
+    }
+  const double dMean = dSum / vecValues.size();
+  const double dVariance = dSquareSum / vecValues.size() - dMean * dMean;
+  QVERIFY(std::fabs(dMean - 3) < 0.1);
+  QVERIFY(std::fabs(dVariance - 4) < 0.2);
+
+  dSum = dSquareSum = 0;
+  for (int i=0; i<20000; ++i)
+    {
+      double dValue = generator.normal();
+      dSum += dValue;
+      dSquareSum += dValue * dValue;
+    }
+  QVERIFY(std::fabs(dSum / 20000) < 0.05);
+  QVERIFY(std::fabs(dSquareSum / 20000 - 1) < 0.05);
+}
+
+void TestPiiRandomGenerator::integers()
+{
+  PiiRandomGenerator generator(3);
+  QVector<int> vecValues(6007), vecCounts(7, 0);
+  generator.fillIntegers(vecValues.data(), vecValues.size(), -3, 3);
+  for (int i=0; i<vecValues.size(); ++i)
+    {
+      QVERIFY(vecValues[i] >= -3 && vecValues[i] <= 3);
+      ++vecCounts[vecValues[i] + 3];
+    }
+  // Every value must be hit roughly equally often.
+  for (int i=0; i<vecCounts.size(); ++i)
+    QVERIFY(vecCounts[i] > 700 && vecCounts[i] < 1000);
+
+  for (int i=0; i<100; ++i)
+    {
+      int iValue = generator.integer(10, 12);
+      QVERIFY(iValue >= 10 && iValue <= 12);
+    }
+  QCOMPARE(generator.integer(5, 5), 5);
+
+  // The full range must not overflow.
+  generator.fillIntegers(vecValues.data(), 4, INT_MIN, INT_MAX);
+}
+
+void TestPiiRandomGenerator::matrix()
+{
+  PiiRandomGenerator generator(4);
+  // Padding at the end of each row must not be touched.
+  double aData[6*8];
+  for (int i=0; i<6*8; ++i)
+    aData[i] = 0;
+  PiiMatrix<double> matPadded(6, 5, aData, Pii::RetainOwnership, 8*sizeof(double));
+  generator.fillUniform(matPadded, 1.0, 2.0);
+  for (int r=0; r<6; ++r)
+    for (int c=0; c<8; ++c)
+      {
+        if (c < 5)
+          QVERIFY(aData[r*8+c] >= 1 && aData[r*8+c] < 2);
+        else
+          QCOMPARE(aData[r*8+c], 0.0);
+      }
+
+  PiiMatrix<float> matNormal(PiiMatrix<float>::uninitialized(3, 5));
+  generator.fillNormal(matNormal, 0.0f, 1.0f);
+
+  PiiMatrix<int> matIntegers(PiiMatrix<int>::uninitialized(4, 3));
+  generator.fillIntegers(matIntegers, 0, 1);
+  for (int r=0; r<4; ++r)
+    for (int c=0; c<3; ++c)
+      QVERIFY(matIntegers(r,c) == 0 || matIntegers(r,c) == 1);
+}
+
+QTEST_MAIN(TestPiiRandomGenerator)
@@ -136,4 +136,97 @@ void TestPiiRansac::CircleRansac()
   }
 }
 
+template <class Ransac> struct FittingRansac : Ransac
+{
+  FittingRansac(const PiiMatrix<double>& points1, const PiiMatrix<double>& points2) :
+    Ransac(points1, points2)
+  {}
+  FittingRansac(const PiiMatrix<double>& points) :
+    Ransac(points)
+  {}
+
+  // Compares fitSamplesToModel() to fitToModel() at all samples.
+  bool fitsMatch(const double* model)
+  {
+    const int iSamples = this->totalSampleCount();
+    QVector<double> vecFits(iSamples);
+    this->fitSamplesToModel(0, iSamples, model, vecFits.data());
+    for (int i = 0; i < iSamples; ++i)
+      {
+        const double dFit = this->fitToModel(i, model);
+        if (Pii::abs(vecFits[i] - dFit) > 1e-9 * qMax(1.0, dFit))
+          return false;
+      }
+    return true;
+  }
+};
+
+void TestPiiRansac::fitSamplesToModel()
+{
+  PiiMatrix<double> matPoints1(Pii::uniformRandomMatrix(100, 2, -50, 50));
+  PiiMatrix<double> matModel(1,4, 1.5, 0.5, -3.0, 7.0);
+  PiiMatrix<double> matPoints2(PiiRigidPlaneRansac<double>::transform(matPoints1, matModel[0]) +
+                               Pii::uniformRandomMatrix(100, 2, -1, 1));
+  {
+    FittingRansac<PiiRigidPlaneRansac<double> > ransac(matPoints1, matPoints2);
+    QVERIFY(ransac.fitsMatch(matModel[0]));
+  }
+  {
+    // Column-wise submatrices aren't stored contiguously.
+    PiiMatrix<double> matWide1(100, 3), matWide2(100, 3);
+    for (int r = 0; r < 100; ++r)
+      for (int c = 0; c < 2; ++c)
+        {
+          matWide1(r, c) = matPoints1(r, c);
+          matWide2(r, c+1) = matPoints2(r, c);
+        }
+    const PiiMatrix<double>& matConstWide1 = matWide1, & matConstWide2 = matWide2;
+    FittingRansac<PiiRigidPlaneRansac<double> > ransac(matConstWide1(0, 0, -1, 2), matConstWide2(0, 1, -1, 2));
+    QVERIFY(ransac.fitsMatch(matModel[0]));
+  }
+  {
+    PiiMatrix<double> matCircle(1, 3, 1.0, -2.0, 30.0);
+    FittingRansac<PiiCircleRansac<double> > ransac(matPoints1);
+    QVERIFY(ransac.fitsMatch(matCircle[0]));
+  }
+}
+
+void TestPiiRansac::preemptiveParallel()
+{
+  PiiMatrix<double> matPoints1(Pii::uniformRandomMatrix(2000, 2, -500, 500));
+  PiiMatrix<double> matModel(1,4, 0.8, 2.0, 30.0, 15.0);
+  PiiMatrix<double> matPoints2(PiiRigidPlaneRansac<double>::transform(matPoints1, matModel[0]));
+  // 60% outliers
+  for (int i=0; i<matPoints2.rows(); ++i)
+    {
+      if (i % 5 < 3)
+        {
+          matPoints2(i,0) = Pii::uniformRandom(-500, 500);
+          matPoints2(i,1) = Pii::uniformRandom(-500, 500);
+        }
+      else
+        {
+          matPoints2(i,0) += Pii::uniformRandom(-0.5, 0.5);
+          matPoints2(i,1) += Pii::uniformRandom(-0.5, 0.5);
+        }
+    }
+
+  for (int iThreads = 1; iThreads <= 4; iThreads += 3)
+    {
+      PiiRigidPlaneRansac<double> ransac(matPoints1, matPoints2);
+      ransac.setFittingThreshold(1);
+      ransac.setThreadCount(iThreads);
+      ransac.setPreemptiveSampleCount(100);
+      QVERIFY(ransac.findBestModel());
+      // Only outliers may be rejected.
+      QVERIFY(ransac.inlierCount() >= 750);
+      QVERIFY(ransac.inlierCount() <= 820);
+      PiiMatrix<double> matEstModel(ransac.refineModel());
+      QVERIFY(Pii::abs(matModel(0) - matEstModel(0)) < 0.01);
+      QVERIFY(Pii::abs(matModel(1) - matEstModel(1)) < 0.01);
+      QVERIFY(Pii::abs(matModel(2) - matEstModel(2)) < 1);
+      QVERIFY(Pii::abs(matModel(3) - matEstModel(3)) < 1);
+    }
+}
+
 QTEST_MAIN(TestPiiRansac)
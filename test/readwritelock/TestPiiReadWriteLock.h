@@ -29,10 +29,12 @@ public:
 private slots:
   void threaded();
   void recursive();
+  void upgrade();
 
 private:
   void writer(int count);
   void reader();
+  void competingWriter(PiiReadWriteLock* lock, int* value);
 
   int _iCounter;
   bool _bFailure;
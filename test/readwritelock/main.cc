@@ -82,4 +82,27 @@ void TestPiiReadWriteLock::recursive()
   lock.unlockWrite();
 }
 
+void TestPiiReadWriteLock::competingWriter(PiiReadWriteLock* lock, int* value)
+{
+  PiiWriteLocker locker(lock);
+  *value = *value * 10 + 2;
+}
+
+void TestPiiReadWriteLock::upgrade()
+{
+  // A reader that upgrades must get the lock before a writer that is
+  // already waiting for the reader to go.
+  PiiReadWriteLock lock(PiiReadWriteLock::Recursive);
+  int iValue = 0;
+  lock.lockForRead();
+  QThread* pWriter = Pii::asyncCall(this, &TestPiiReadWriteLock::competingWriter, &lock, &iValue);
+  PiiDelay::msleep(20);
+  lock.lockForWrite();
+  iValue = iValue * 10 + 1;
+  lock.unlockWrite();
+  lock.unlockRead();
+  pWriter->wait();
+  QCOMPARE(iValue, 12);
+}
+
 QTEST_MAIN(TestPiiReadWriteLock)
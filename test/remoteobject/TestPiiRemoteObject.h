@@ -137,7 +137,7 @@ public:
   TestPiiRemoteObject();
 
 public slots:
-  void storeNumber(int value) { _iNumber = value; }
+  void storeNumber(int value) { _iNumber = value; ++_iNumberCount; }
   void storeVariant(const PiiVariant& var) { _variant = var; }
 
 private slots:
@@ -147,7 +147,9 @@ private slots:
   void functionSignatures();
   void remoteSlots();
   void remoteSignals();
+  void coalescedSignals();
   void functionCalls();
+  void asyncCalls();
   void cleanupTestCase();
   void exceptions();
   void singleThreaded();
@@ -169,7 +171,7 @@ private:
   ServerObject _serverObject1;
   ServerObject2 _serverObject2;
   bool _bServerStarted;
-  int _iNumber;
+  int _iNumber, _iNumberCount;
   PiiVariant _variant;
 };
 
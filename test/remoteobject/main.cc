@@ -32,7 +32,8 @@ TestPiiRemoteObject::TestPiiRemoteObject() :
   _pClient1(0),
   _pClient2(0),
   _bServerStarted(false),
-  _iNumber(0)
+  _iNumber(0),
+  _iNumberCount(0)
 {}
 
 void TestPiiRemoteObject::serverThread()
@@ -215,6 +216,29 @@ void TestPiiRemoteObject::remoteSignals()
   QVERIFY(Pii::equals(_variant.valueAs<PiiMatrix<double> >(), PiiMatrix<double>()));
 }
 
+void TestPiiRemoteObject::coalescedSignals()
+{
+  const QString strSource("signals/numberChanged(int)");
+  _pObjectServer1->setPushInterval(strSource, 500);
+  QCOMPARE(_pObjectServer1->pushInterval(strSource), 500);
+  _iNumberCount = 0;
+  for (int i=0; i<10; ++i)
+    QVERIFY(_pClient1->setProperty("number", 400 + i));
+  PiiDelay::msleep(1000);
+  // Intermediate values were replaced, but the last one must arrive.
+  QCOMPARE(_iNumber, 409);
+  QVERIFY(_iNumberCount < 10);
+
+  _pObjectServer1->setPushInterval(strSource, -1);
+  QCOMPARE(_pObjectServer1->pushInterval(strSource), -1);
+  _iNumberCount = 0;
+  for (int i=0; i<3; ++i)
+    QVERIFY(_pClient1->setProperty("number", 500 + i));
+  PiiDelay::msleep(100);
+  QCOMPARE(_iNumber, 502);
+  QCOMPARE(_iNumberCount, 3);
+}
+
 void TestPiiRemoteObject::functionCalls()
 {
   QString strReturn;
@@ -230,6 +254,36 @@ void TestPiiRemoteObject::functionCalls()
   QCOMPARE(_pClient1->call<int>("functions/plus", 1, 2), 3);
 }
 
+void TestPiiRemoteObject::asyncCalls()
+{
+  _pClient1->setMaxPipelineDepth(2);
+  QList<PiiRemoteFuture<int> > lstSums;
+  for (int i=0; i<5; ++i)
+    lstSums << _pClient1->callAsync<int>("functions/plus", i, 1);
+  PiiRemoteFuture<QString> hello = _pClient1->callAsync<QString>("functions/test2");
+  // Read in reverse order; all previous responses are read first.
+  QCOMPARE(hello.result(), QString("test2"));
+  for (int i=4; i>=0; --i)
+    {
+      QVERIFY(lstSums[i].isFinished());
+      QCOMPARE(lstSums[i].result(), i+1);
+    }
+
+  PiiRemoteFuture<void> thrower = _pClient1->callAsync<void>("functions/thrower", 0);
+  try
+    {
+      thrower.result();
+      QFAIL("Call should have caused an exception.");
+    }
+  catch (PiiInvalidArgumentException& ex)
+    {
+      QCOMPARE(ex.message(), QString("InvalidArgument"));
+    }
+  // The connection must still be usable.
+  QCOMPARE(_pClient1->callAsync<int>("functions/plus", 2, 3).result(), 5);
+  _pClient1->setMaxPipelineDepth(8);
+}
+
 void TestPiiRemoteObject::exceptions()
 {
   try
@@ -134,4 +134,36 @@ void TestPiiResourceDatabase::subselect()
   QCOMPARE(lstResult[0], QString("PiiResourceDatabase"));
 }
 
+void TestPiiResourceDatabase::index()
+{
+  using namespace Pii;
+  PiiResourceDatabase db2;
+  QList<int> lstIds;
+  for (int i=0; i<100; ++i)
+    lstIds << db2.addStatement(db2.resource(QString("Op%1").arg(i), "pii:parent", QString("Plugin%1").arg(i % 3)));
+  QCOMPARE(db2.select(subject, attribute("pii:parent") == "Plugin1").size(), 33);
+  QCOMPARE(db2.findFirst(subject == "Op50"), lstIds[50]);
+
+  db2.removeStatement(lstIds[50]);
+  QCOMPARE(db2.statementCount(), 99);
+  QCOMPARE(db2.findFirst(subject == "Op50"), -1);
+  QCOMPARE(db2.indexedStatements(PiiResourceDatabase::SubjectIndex, "Op50").size(), 0);
+  QCOMPARE(db2.select(object == "Plugin2").size(), 33);
+
+  // Ids keep growing after removal, and results stay in id order.
+  int id = db2.addStatement(db2.resource("Op50", "pii:parent", "Plugin2"));
+  QCOMPARE(id, lstIds.last() + 1);
+  QList<PiiResourceStatement> lstResult = db2.select(subject == "Op2" || subject == "Op50" || subject == "Op1");
+  QCOMPARE(lstResult.size(), 3);
+  QCOMPARE(lstResult[0].subject(), QString("Op1"));
+  QCOMPARE(lstResult[1].subject(), QString("Op2"));
+  QCOMPARE(lstResult[2].subject(), QString("Op50"));
+
+  // Indexed and unindexed queries give the same result.
+  QCOMPARE(db2.select(subject, predicate == "pii:parent" && object == "Plugin0"),
+           db2.select(subject, resourceType == PiiResourceStatement::Resource && object >= "Plugin0" && object <= "Plugin0"));
+  QCOMPARE(db2.select(subject, subject == (QList<QString>() << "Op3" << "Op1")),
+           QList<QString>() << "Op1" << "Op3");
+}
+
 QTEST_MAIN(TestPiiResourceDatabase)
@@ -0,0 +1,99 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiRingBuffer.h"
+
+#include <PiiRingBuffer.h>
+#include <QtTest>
+#include <QThread>
+
+void TestPiiRingBuffer::singleThread()
+{
+  PiiRingBuffer<int> buffer(3);
+  QCOMPARE(buffer.capacity(), 3);
+  QVERIFY(buffer.isEmpty());
+  QVERIFY(!buffer.isFull());
+
+  buffer.append(1);
+  buffer.append(2);
+  buffer.append(3);
+  QVERIFY(buffer.isFull());
+  QCOMPARE(buffer.size(), 3);
+  QCOMPARE(buffer[0], 1);
+  QCOMPARE(buffer[2], 3);
+
+  QCOMPARE(buffer.takeFirst(), 1);
+  buffer.append(4);
+  QCOMPARE(buffer.size(), 3);
+  QCOMPARE(buffer[0], 2);
+  QCOMPARE(buffer[2], 4);
+
+  // Consumer may reorder the queue.
+  qSwap(buffer[0], buffer[2]);
+  QCOMPARE(buffer.takeFirst(), 4);
+  QCOMPARE(buffer.takeFirst(), 3);
+  QCOMPARE(buffer.takeFirst(), 2);
+  QVERIFY(buffer.isEmpty());
+
+  buffer.append(5);
+  buffer.clear();
+  QVERIFY(buffer.isEmpty());
+}
+
+class Producer : public QThread
+{
+public:
+  Producer(PiiRingBuffer<int>* buffer, int count) : _pBuffer(buffer), _iCount(count) {}
+
+protected:
+  void run()
+  {
+    for (int i=0; i<_iCount; )
+      {
+        if (!_pBuffer->isFull())
+          _pBuffer->append(i++);
+        else
+          yieldCurrentThread();
+      }
+  }
+
+private:
+  PiiRingBuffer<int>* _pBuffer;
+  int _iCount;
+};
+
+void TestPiiRingBuffer::twoThreads()
+{
+  const int iCount = 100000;
+  PiiRingBuffer<int> buffer(5);
+  Producer producer(&buffer, iCount);
+  producer.start();
+  for (int i=0; i<iCount; )
+    {
+      if (!buffer.isEmpty())
+        {
+          int iValue = buffer.takeFirst();
+          if (iValue != i)
+            QFAIL(qPrintable(QString("Expected %1, got %2.").arg(i).arg(iValue)));
+          ++i;
+        }
+      else
+        QThread::yieldCurrentThread();
+    }
+  producer.wait();
+  QVERIFY(buffer.isEmpty());
+}
+
+QTEST_MAIN(TestPiiRingBuffer)
@@ -0,0 +1,158 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiRunningStatistics.h"
+
+#include <PiiRunningStatistics.h>
+#include <PiiMath.h>
+#include <QtTest>
+#include <complex>
+
+void TestPiiRunningStatistics::runningSum()
+{
+  PiiRunningSum<double> sum;
+  QCOMPARE(sum.mean(), 0.0);
+  for (int i=0; i<1000000; ++i)
+    sum.add(0.1);
+  for (int i=0; i<999999; ++i)
+    sum.remove(0.1);
+  QCOMPARE(sum.count(), 1);
+  // Plain summation would be off in the 11th digit.
+  QCOMPARE(sum.sum(), 0.1);
+
+  // 1e-16 is lost in plain summation. The compensation must carry
+  // it over when the large values cancel, and must not be applied
+  // in the wrong direction before that.
+  sum.clear();
+  sum.add(1.0);
+  sum.add(1e-16);
+  QCOMPARE(sum.sum(), 1.0);
+  sum.remove(1.0);
+  QVERIFY(Pii::abs(sum.sum() - 1e-16) < 2e-17);
+
+  PiiRunningSum<std::complex<double> > complexSum;
+  complexSum.add(std::complex<double>(1,2));
+  complexSum.add(std::complex<double>(3,4));
+  QCOMPARE(complexSum.mean(), std::complex<double>(2,3));
+
+  sum.clear();
+  QCOMPARE(sum.count(), 0);
+  QCOMPARE(sum.sum(), 0.0);
+}
+
+void TestPiiRunningStatistics::matrixSum()
+{
+  PiiRunningSum<PiiMatrix<float> > sum;
+  sum.add(PiiMatrix<float>(2,2, 1.0, 2.0, 3.0, 4.0));
+  sum.add(PiiMatrix<float>(2,2, 3.0, 2.0, 1.0, 0.0));
+  sum.add(PiiMatrix<float>(2,2, 5.0, 5.0, 5.0, 5.0));
+  sum.remove(PiiMatrix<float>(2,2, 1.0, 2.0, 3.0, 4.0));
+  QCOMPARE(sum.count(), 2);
+  QVERIFY(Pii::equals(sum.mean(), PiiMatrix<float>(2,2, 4.0, 3.5, 3.0, 2.5)));
+
+  PiiRunningSum<PiiMatrix<double> > smallSum;
+  smallSum.add(PiiMatrix<double>(1,2, 1.0, -1.0));
+  smallSum.add(PiiMatrix<double>(1,2, 1e-16, -1e-16));
+  QVERIFY(Pii::equals(smallSum.sum(), PiiMatrix<double>(1,2, 1.0, -1.0)));
+  smallSum.remove(PiiMatrix<double>(1,2, 1.0, -1.0));
+  QVERIFY(Pii::abs(smallSum.sum()(0,0) - 1e-16) < 2e-17);
+  QVERIFY(Pii::abs(smallSum.sum()(0,1) + 1e-16) < 2e-17);
+
+  try
+    {
+      sum.add(PiiMatrix<float>(3,3));
+      QFAIL("Adding a matrix of a different size succeeded.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
+void TestPiiRunningStatistics::runningVariance()
+{
+  // A large offset would make the sum of squares cancel
+  // catastrophically.
+  const double aValues[] = { 4, 7, 13, 16, 1, 9, 2 };
+  PiiRunningVariance<double> variance;
+  for (int i=0; i<7; ++i)
+    variance.add(1e6 + aValues[i]);
+  for (int i=0; i<3; ++i)
+    variance.remove(1e6 + aValues[i]);
+  // Window is { 16, 1, 9, 2 }
+  QCOMPARE(variance.count(), 4);
+  QCOMPARE(variance.mean(), 1e6 + 7);
+  QVERIFY(Pii::abs(variance.variance() - 36.5) < 1e-6);
+  QVERIFY(Pii::abs(variance.sampleVariance() - 146.0 / 3) < 1e-6);
+
+  variance.remove(0);
+  variance.remove(0);
+  variance.remove(0);
+  variance.remove(0);
+  QCOMPARE(variance.count(), 0);
+  QCOMPARE(variance.variance(), 0.0);
+}
+
+void TestPiiRunningStatistics::matrixVariance()
+{
+  PiiRunningVariance<PiiMatrix<double> > variance;
+  variance.add(PiiMatrix<double>(1,2, 1.0, 10.0));
+  variance.add(PiiMatrix<double>(1,2, 3.0, 10.0));
+  variance.add(PiiMatrix<double>(1,2, 8.0, 13.0));
+  variance.remove(PiiMatrix<double>(1,2, 1.0, 10.0));
+  QVERIFY(Pii::equals(variance.mean(), PiiMatrix<double>(1,2, 5.5, 11.5)));
+  QVERIFY(Pii::equals(variance.variance(), PiiMatrix<double>(1,2, 6.25, 2.25)));
+}
+
+void TestPiiRunningStatistics::slidingExtrema()
+{
+  PiiSlidingExtrema<int> extrema(3);
+  QVERIFY(extrema.isEmpty());
+  extrema.add(5);
+  QCOMPARE(extrema.minimum(), 5);
+  QCOMPARE(extrema.maximum(), 5);
+  extrema.add(1);
+  extrema.add(4);
+  QCOMPARE(extrema.minimum(), 1);
+  QCOMPARE(extrema.maximum(), 5);
+  extrema.add(3);
+  QCOMPARE(extrema.count(), 3);
+  QCOMPARE(extrema.minimum(), 1);
+  QCOMPARE(extrema.maximum(), 4);
+  extrema.add(3);
+  QCOMPARE(extrema.minimum(), 3);
+  QCOMPARE(extrema.maximum(), 4);
+  extrema.add(2);
+  QCOMPARE(extrema.minimum(), 2);
+  QCOMPARE(extrema.maximum(), 3);
+
+  // Compare to brute force
+  const int iWindowSize = 7;
+  extrema.setWindowSize(iWindowSize);
+  QList<int> lstValues;
+  for (int i=0; i<1000; ++i)
+    {
+      int iValue = (i * 7919) % 1013;
+      lstValues << iValue;
+      extrema.add(iValue);
+      int iMin = iValue, iMax = iValue;
+      for (int j=qMax(0, i-iWindowSize+1); j<i; ++j)
+        {
+          iMin = qMin(iMin, lstValues[j]);
+          iMax = qMax(iMax, lstValues[j]);
+        }
+      QCOMPARE(extrema.minimum(), iMin);
+      QCOMPARE(extrema.maximum(), iMax);
+    }
+}
+
+QTEST_MAIN(TestPiiRunningStatistics)
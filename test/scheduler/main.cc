@@ -0,0 +1,112 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiScheduler.h"
+
+#include <PiiScheduler.h>
+#include <PiiTimer.h>
+#include <QtTest>
+
+// Ends a round after a delay.
+class DelayedLeave : public QThread
+{
+public:
+  DelayedLeave(PiiScheduler* scheduler, PiiScheduler::SchedulingClass schedulingClass, int delay) :
+    _pScheduler(scheduler), _class(schedulingClass), _iDelay(delay)
+  {}
+
+protected:
+  void run()
+  {
+    msleep(_iDelay);
+    _pScheduler->leave(_class);
+  }
+
+private:
+  PiiScheduler* _pScheduler;
+  PiiScheduler::SchedulingClass _class;
+  int _iDelay;
+};
+
+void TestPiiScheduler::uncontended()
+{
+  PiiScheduler scheduler;
+  scheduler.setCoreCount(2);
+  PiiTimer timer;
+  scheduler.enter(PiiScheduler::BackgroundClass);
+  scheduler.enter(PiiScheduler::NormalClass);
+  // Critical rounds never wait, even if all cores are busy.
+  scheduler.enter(PiiScheduler::CriticalClass);
+  QVERIFY(timer.milliseconds() < 10);
+  QCOMPARE(scheduler.runningCount(PiiScheduler::BackgroundClass), 1);
+  QCOMPARE(scheduler.runningCount(PiiScheduler::NormalClass), 1);
+  QCOMPARE(scheduler.runningCount(PiiScheduler::CriticalClass), 1);
+  scheduler.leave(PiiScheduler::CriticalClass);
+  scheduler.leave(PiiScheduler::NormalClass);
+  scheduler.leave(PiiScheduler::BackgroundClass);
+  QCOMPARE(scheduler.runningCount(PiiScheduler::NormalClass), 0);
+}
+
+void TestPiiScheduler::background()
+{
+  PiiScheduler scheduler;
+  scheduler.setCoreCount(1);
+  scheduler.setMaxDelay(PiiScheduler::BackgroundClass, 50);
+
+  // Held back until the deadline.
+  scheduler.enter(PiiScheduler::NormalClass);
+  PiiTimer timer;
+  scheduler.enter(PiiScheduler::BackgroundClass);
+  QVERIFY(timer.milliseconds() >= 45);
+  scheduler.leave(PiiScheduler::BackgroundClass);
+
+  // Released as soon as a core becomes free.
+  scheduler.setMaxDelay(PiiScheduler::BackgroundClass, 5000);
+  DelayedLeave leave(&scheduler, PiiScheduler::NormalClass, 20);
+  timer.restart();
+  leave.start();
+  scheduler.enter(PiiScheduler::BackgroundClass);
+  QVERIFY(timer.milliseconds() < 2000);
+  leave.wait();
+  scheduler.leave(PiiScheduler::BackgroundClass);
+}
+
+void TestPiiScheduler::normal()
+{
+  PiiScheduler scheduler;
+  scheduler.setCoreCount(1);
+  scheduler.setMaxDelay(PiiScheduler::NormalClass, 5000);
+
+  // Contention among normal rounds doesn't hold anyone back.
+  scheduler.enter(PiiScheduler::NormalClass);
+  PiiTimer timer;
+  scheduler.enter(PiiScheduler::NormalClass);
+  QVERIFY(timer.milliseconds() < 10);
+  scheduler.leave(PiiScheduler::NormalClass);
+  scheduler.leave(PiiScheduler::NormalClass);
+
+  // A running critical round does.
+  scheduler.enter(PiiScheduler::CriticalClass);
+  DelayedLeave leave(&scheduler, PiiScheduler::CriticalClass, 20);
+  timer.restart();
+  leave.start();
+  scheduler.enter(PiiScheduler::NormalClass);
+  QVERIFY(timer.milliseconds() >= 15);
+  QVERIFY(timer.milliseconds() < 2000);
+  leave.wait();
+  scheduler.leave(PiiScheduler::NormalClass);
+}
+
+QTEST_MAIN(TestPiiScheduler)
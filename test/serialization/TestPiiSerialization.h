@@ -30,6 +30,8 @@ private slots:
   void textArchive();
   void binaryArchive();
   void derivedTypes();
+  void mappedMatrix();
+  void consecutiveArchives();
 
 private:
   PiiMatrix<double> _dMat;
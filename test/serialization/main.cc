@@ -280,5 +280,117 @@ void TestPiiSerialization::binaryArchive()
   anyArchive<PiiGenericBinaryInputArchive,PiiGenericBinaryOutputArchive>();
 }
 
+void TestPiiSerialization::mappedMatrix()
+{
+  PiiMatrix<float> small(2, 3), large(100, 30);
+  for (int i=0; i<small.rows(); ++i)
+    for (int j=0; j<small.columns(); ++j)
+      small(i,j) = i*j;
+  for (int i=0; i<large.rows(); ++i)
+    for (int j=0; j<large.columns(); ++j)
+      large(i,j) = i + j*0.5f;
+
+  try
+    {
+      {
+        QFile file("mapped.bin");
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        PiiGenericBinaryOutputArchive oa(&file);
+        oa << small << large;
+      }
+      PiiMatrix<float> small2, large2;
+      {
+        QFile file("mapped.bin");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        PiiGenericBinaryInputArchive ia(&file);
+        ia >> small2 >> large2;
+      }
+      QVERIFY(Pii::equals(small, small2));
+      // The large matrix references the file, which must stay mapped
+      // after it has been closed.
+      QVERIFY(Pii::equals(large, large2));
+      QVERIFY(large2.alignment() >= 64);
+      QCOMPARE(large2.capacity(), 0);
+      // The mapping is private.
+      large2(0,0) = -1;
+      {
+        QFile file("mapped.bin");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        PiiGenericBinaryInputArchive ia(&file);
+        ia >> small2 >> large2;
+      }
+      QCOMPARE(large2(0,0), 0.0f);
+
+      // Other devices fall back to copying.
+      QByteArray array;
+      QBuffer buffer(&array);
+      buffer.open(QIODevice::ReadWrite);
+      {
+        PiiGenericBinaryOutputArchive oa(&buffer);
+        oa << large;
+      }
+      buffer.seek(0);
+      PiiMatrix<float> large3;
+      {
+        PiiGenericBinaryInputArchive ia(&buffer);
+        ia >> large3;
+      }
+      QVERIFY(Pii::equals(large, large3));
+      QCOMPARE(large3.capacity(), 100);
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QFile::remove("mapped.bin");
+}
+
+void TestPiiSerialization::consecutiveArchives()
+{
+  QByteArray array;
+  QBuffer buffer(&array);
+  buffer.open(QIODevice::ReadWrite);
+  try
+    {
+      {
+        PiiGenericBinaryOutputArchive oa(&buffer);
+        oa << 0x01020304 << 1.5f << QString("first");
+      }
+      // Primitives are little-endian after the ID and the version
+      // numbers.
+      QCOMPARE(array.mid(PII_BINARY_ARCHIVE_ID_LEN + 8, 4), QByteArray("\x04\x03\x02\x01", 4));
+      {
+        PiiGenericBinaryOutputArchive oa(&buffer);
+        oa << QString("second") << 2.5;
+      }
+      const qint64 iSize = array.size();
+
+      buffer.seek(0);
+      int iValue = 0;
+      float fValue = 0;
+      double dValue = 0;
+      QString strFirst, strSecond;
+      {
+        PiiGenericBinaryInputArchive ia(&buffer);
+        ia >> iValue >> fValue >> strFirst;
+      }
+      // Data read ahead must be put back.
+      {
+        PiiGenericBinaryInputArchive ia(&buffer);
+        ia >> strSecond >> dValue;
+      }
+      QCOMPARE(iValue, 0x01020304);
+      QCOMPARE(fValue, 1.5f);
+      QCOMPARE(strFirst, QString("first"));
+      QCOMPARE(strSecond, QString("second"));
+      QCOMPARE(dValue, 2.5);
+      QCOMPARE(buffer.pos(), iSize);
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+}
+
 QTEST_MAIN(TestPiiSerialization)
 
@@ -0,0 +1,191 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiSmallObjectAllocator.h"
+
+#include <PiiSmallObjectAllocator.h>
+#include <PiiVariant.h>
+#include <PiiYdinTypes.h>
+#include <QtTest>
+#include <QThread>
+#include <cstring>
+
+typedef PiiSmallObjectAllocator Allocator;
+
+void TestPiiSmallObjectAllocator::sizeClass()
+{
+  QCOMPARE(Allocator::sizeClass(0), 0);
+  QCOMPARE(Allocator::sizeClass(1), 0);
+  QCOMPARE(Allocator::sizeClass(16 - sizeof(void*)), 0);
+  QCOMPARE(Allocator::sizeClass(17 - sizeof(void*)), 1);
+  QCOMPARE(Allocator::sizeClass(Allocator::MaxPooledSize), Allocator::SizeClassCount-1);
+  QCOMPARE(Allocator::sizeClass(Allocator::MaxPooledSize + 1), -1);
+  for (int i=0; i<Allocator::SizeClassCount; ++i)
+    {
+      QCOMPARE(Allocator::sizeClass(Allocator::blockSize(i)), i);
+      QCOMPARE(Allocator::blockSize(i) + sizeof(void*), std::size_t(16*(i+1)));
+    }
+}
+
+void TestPiiSmallObjectAllocator::allocation()
+{
+  Allocator::resetStatistics();
+  void* buffers[1000];
+  for (int i=0; i<1000; ++i)
+    {
+      std::size_t bytes = std::size_t(i % 300);
+      buffers[i] = Allocator::allocate(bytes);
+      QVERIFY(buffers[i] != 0);
+      QCOMPARE(long(buffers[i]) & 0xf, 0l);
+      std::memset(buffers[i], i & 0xff, bytes);
+    }
+  for (int i=0; i<1000; ++i)
+    {
+      std::size_t bytes = std::size_t(i % 300);
+      for (std::size_t j=0; j<bytes; ++j)
+        QCOMPARE(int(static_cast<unsigned char*>(buffers[i])[j]), i & 0xff);
+      Allocator::deallocate(buffers[i], bytes);
+    }
+  Allocator::deallocate(0, 10);
+
+  // A freshly released block is reused.
+  void* pBuffer = Allocator::allocate(40);
+  Allocator::deallocate(pBuffer, 40);
+  QCOMPARE(Allocator::allocate(33), pBuffer);
+  Allocator::deallocate(pBuffer, 33);
+
+  Allocator::Statistics stats(Allocator::statistics());
+  QVERIFY(stats.iSlabCount > 0);
+  QCOMPARE(stats.iReservedBytes, qint64(stats.iSlabCount) * Allocator::SlabSize);
+  QVERIFY(stats.iAllocations <= 1000 - 4*51 + 1);
+  QVERIFY(stats.iHeapAllocations <= 4*51);
+}
+
+namespace
+{
+  class AllocatorThread : public QThread
+  {
+  public:
+    AllocatorThread(void** buffers, int count) :
+      _ppBuffers(buffers), _iCount(count), _bOk(true)
+    {}
+
+    void run()
+    {
+      // Release blocks allocated by another thread and allocate
+      // new ones.
+      for (int i=0; i<_iCount; ++i)
+        {
+          if (*static_cast<int*>(_ppBuffers[i]) != i)
+            _bOk = false;
+          Allocator::deallocate(_ppBuffers[i], sizeof(int) * (i % 8 + 1));
+        }
+      for (int i=0; i<_iCount; ++i)
+        {
+          _ppBuffers[i] = Allocator::allocate(sizeof(int) * (i % 8 + 1));
+          *static_cast<int*>(_ppBuffers[i]) = -i;
+        }
+    }
+
+    bool isOk() const { return _bOk; }
+
+  private:
+    void** _ppBuffers;
+    int _iCount;
+    bool _bOk;
+  };
+}
+
+void TestPiiSmallObjectAllocator::threads()
+{
+  const int iCount = 10000;
+  QVector<void*> vecBuffers(iCount);
+  for (int i=0; i<iCount; ++i)
+    {
+      vecBuffers[i] = Allocator::allocate(sizeof(int) * (i % 8 + 1));
+      *static_cast<int*>(vecBuffers[i]) = i;
+    }
+  AllocatorThread thread(vecBuffers.data(), iCount);
+  thread.start();
+  thread.wait();
+  QVERIFY(thread.isOk());
+
+  // Once the thread has exited, its cache is back in the shared pool.
+  Allocator::Statistics stats(Allocator::statistics());
+  QVERIFY(stats.iFreeBlocks > 0);
+
+  for (int i=0; i<iCount; ++i)
+    {
+      QCOMPARE(*static_cast<int*>(vecBuffers[i]), -i);
+      Allocator::deallocate(vecBuffers[i], sizeof(int) * (i % 8 + 1));
+    }
+}
+
+class A
+{
+public:
+  virtual ~A() {}
+};
+
+class B : public A
+{
+public:
+  PII_SMALL_OBJECT_ALLOCATOR
+
+  B(int value) : _iMember(value) {}
+
+  int member() const { return _iMember; }
+
+private:
+  int _iMember;
+  double _adPadding[8];
+};
+
+void TestPiiSmallObjectAllocator::overriddenNewDelete()
+{
+  A* ptrs[17];
+  for (int i=0; i<17; ++i)
+    ptrs[i] = new B(i);
+  for (int i=0; i<17; ++i)
+    {
+      QCOMPARE(static_cast<B*>(ptrs[i])->member(), i);
+      delete ptrs[i];
+    }
+
+  // Placement new must still be available.
+  char buffer[sizeof(B)];
+  B* pB = new (buffer) B(3);
+  QCOMPARE(pB->member(), 3);
+  pB->~B();
+}
+
+void TestPiiSmallObjectAllocator::variant()
+{
+  QList<PiiVariant> lstVariants;
+  for (int i=0; i<100; ++i)
+    lstVariants << PiiVariant(PiiMatrix<int>(2, 2, i, i, i, i));
+  QList<PiiVariant> lstCopies(lstVariants);
+  lstVariants.clear();
+  for (int i=0; i<100; ++i)
+    {
+      QCOMPARE(lstCopies[i].type(), PiiVariant::IntMatrixType);
+      QCOMPARE(lstCopies[i].valueAs<PiiMatrix<int> >()(1,1), i);
+    }
+  PiiVariant* pVariant = new PiiVariant(lstCopies[5]);
+  QCOMPARE(pVariant->valueAs<PiiMatrix<int> >()(0,0), 5);
+  delete pVariant;
+}
+
+QTEST_MAIN(TestPiiSmallObjectAllocator)
@@ -33,6 +33,11 @@ private slots:
   void proxyLoop();
   void connectedInputs();
   void root();
+  void backPressure();
+  void idleSender();
+  void memoryLimit();
+  void wakeUp();
+  void queuePeek();
 
 private:
   PiiOutputSocket a;
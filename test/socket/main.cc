@@ -16,6 +16,36 @@
 #include "TestPiiSocket.h"
 #include <QtTest>
 
+#include <PiiInputController.h>
+#include <PiiInputListener.h>
+#include <PiiYdinTypes.h>
+
+// Accepts objects until the given number of objects is stored.
+struct StoringController : PiiInputController
+{
+  StoringController(int capacity) : iCapacity(capacity) {}
+
+  bool tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
+  {
+    if (lstObjects.size() >= iCapacity)
+      return false;
+    lstObjects << object;
+    return true;
+  }
+
+  int valueAt(int index) const { return lstObjects[index].valueAs<int>(); }
+
+  int iCapacity;
+  QList<PiiVariant> lstObjects;
+};
+
+struct CountingListener : PiiInputListener
+{
+  CountingListener() : iReadyCount(0) {}
+  void inputReady(PiiAbstractInputSocket*) { ++iReadyCount; }
+  int iReadyCount;
+};
+
 TestPiiSocket::TestPiiSocket() :
   a(""), b(""), e(""), h("")
 {}
@@ -98,4 +128,201 @@ void TestPiiSocket::root()
   QCOMPARE(PiiProxySocket::root(&a), &a);
 }
 
+void TestPiiSocket::backPressure()
+{
+  PiiOutputSocket output("output");
+  PiiInputSocket fast("fast"), slow("slow"), other("other");
+  StoringController fastController(100), slowController(1);
+  fast.setController(&fastController);
+  slow.setController(&slowController);
+  output.connectInput(&fast);
+  output.connectInput(&slow);
+
+  QCOMPARE(output.backPressurePolicy(&slow), PiiOutputSocket::BlockWhenFull);
+  QVERIFY(!output.setBackPressurePolicy(&other, PiiOutputSocket::DropNewest));
+  QVERIFY(output.setBackPressurePolicy(&slow, PiiOutputSocket::DropOldest, 2));
+  QCOMPARE(output.backPressurePolicy(&slow), PiiOutputSocket::DropOldest);
+
+  // 0 is received, 3 and 4 stay in the side queue.
+  for (int i=0; i<5; ++i)
+    QVERIFY(output.tryEmit(PiiVariant(i)));
+  QCOMPARE(fastController.lstObjects.size(), 5);
+  QCOMPARE(slowController.lstObjects.size(), 1);
+  QCOMPARE(slowController.valueAt(0), 0);
+  QCOMPARE(output.droppedObjectCount(&slow), 2);
+
+  // Queued objects go first.
+  slowController.lstObjects.clear();
+  QVERIFY(output.tryEmit(PiiVariant(5)));
+  QCOMPARE(slowController.lstObjects.size(), 1);
+  QCOMPARE(slowController.valueAt(0), 3);
+
+  // Control objects are never dropped or queued.
+  QVERIFY(!output.tryEmit(PiiYdin::createStopTag()));
+  slowController.iCapacity = 4;
+  QVERIFY(output.tryEmit(PiiYdin::createStopTag()));
+  QCOMPARE(slowController.lstObjects.size(), 4);
+  QCOMPARE(slowController.valueAt(1), 4);
+  QCOMPARE(slowController.valueAt(2), 5);
+  QCOMPARE(slowController.lstObjects[3].type(), (unsigned)PiiYdin::StopTagType);
+  QCOMPARE(fastController.lstObjects.size(), 7);
+
+  QVERIFY(output.setBackPressurePolicy(&slow, PiiOutputSocket::DropNewest));
+  QVERIFY(output.tryEmit(PiiVariant(6)));
+  QCOMPARE(slowController.lstObjects.size(), 4);
+  QCOMPARE(output.droppedObjectCount(&slow), 3);
+
+  QVERIFY(output.setBackPressurePolicy(&slow, PiiOutputSocket::SpillToQueue, 1));
+  QVERIFY(output.tryEmit(PiiVariant(7)));
+  QVERIFY(!output.tryEmit(PiiVariant(8)));
+  slowController.lstObjects.clear();
+  QVERIFY(output.tryEmit(PiiVariant(8)));
+  QCOMPARE(slowController.valueAt(0), 7);
+  QCOMPARE(output.droppedObjectCount(&slow), 3);
+
+  // Disconnecting resets the policy.
+  output.disconnectInput(&slow);
+  output.connectInput(&slow);
+  QCOMPARE(output.backPressurePolicy(&slow), PiiOutputSocket::BlockWhenFull);
+  output.disconnectInputs();
+}
+
+void TestPiiSocket::idleSender()
+{
+  PiiOutputSocket output("output");
+  PiiInputSocket slow("slow");
+  StoringController slowController(1);
+  slow.setController(&slowController);
+  output.connectInput(&slow);
+  QVERIFY(output.setBackPressurePolicy(&slow, PiiOutputSocket::SpillToQueue, 2));
+
+  // 0 is received, 1 and 2 stay in the side queue.
+  for (int i=0; i<3; ++i)
+    QVERIFY(output.tryEmit(PiiVariant(i)));
+  QCOMPARE(slowController.lstObjects.size(), 1);
+
+  // The sender emits nothing more. The queued objects are passed
+  // once the receiver signals it has room.
+  slowController.lstObjects.clear();
+  slowController.iCapacity = 1;
+  QVERIFY(slow.listener() != 0);
+  slow.listener()->inputReady(&slow);
+  QCOMPARE(slowController.lstObjects.size(), 1);
+  QCOMPARE(slowController.valueAt(0), 1);
+
+  slowController.iCapacity = 10;
+  slow.listener()->inputReady(&slow);
+  QCOMPARE(slowController.lstObjects.size(), 2);
+  QCOMPARE(slowController.valueAt(1), 2);
+  QCOMPARE(output.droppedObjectCount(&slow), 0);
+
+  // Nothing is left to pass.
+  slow.listener()->inputReady(&slow);
+  QCOMPARE(slowController.lstObjects.size(), 2);
+  output.disconnectInputs();
+}
+
+void TestPiiSocket::memoryLimit()
+{
+  PiiInputSocket input("input");
+  input.setQueueCapacity(10);
+  QCOMPARE(input.memoryBudget(), PiiMemoryBudget::global());
+  QCOMPARE(input.queueMemoryLimit(), qint64(0));
+  input.setQueueMemoryLimit(2048);
+  QCOMPARE(input.queueMemoryLimit(), qint64(2048));
+
+  qint64 iGlobalBytes = PiiMemoryBudget::global()->usedBytes();
+  // 1024 bytes each
+  PiiMatrix<unsigned char> matrix(32, 32);
+  QVERIFY(input.canReceive());
+  input.receive(PiiVariant(matrix));
+  QCOMPARE(input.queuedBytes(), qint64(1024));
+  QCOMPARE(PiiMemoryBudget::global()->usedBytes(), iGlobalBytes + 1024);
+  // Objects other than matrices are free.
+  input.receive(PiiVariant(1));
+  QCOMPARE(input.queuedBytes(), qint64(1024));
+  QVERIFY(input.canReceive());
+  input.receive(PiiVariant(matrix));
+  QVERIFY(!input.canReceive());
+
+  input.shift();
+  QCOMPARE(input.queuedBytes(), qint64(1024));
+  QVERIFY(input.canReceive());
+
+  // Limits of enclosing budgets apply as well.
+  PiiMemoryBudget budget;
+  input.setMemoryBudget(&budget);
+  QCOMPARE(budget.usedBytes(), qint64(1024));
+  QCOMPARE(PiiMemoryBudget::global()->usedBytes(), iGlobalBytes);
+  input.setQueueMemoryLimit(0);
+  budget.setLimit(1024);
+  QVERIFY(!input.canReceive());
+
+  // An empty queue always receives
+  input.shift();
+  input.shift();
+  QCOMPARE(input.queueLength(), 0);
+  QCOMPARE(budget.usedBytes(), qint64(0));
+  input.receive(PiiVariant(PiiMatrix<unsigned char>(64, 64)));
+  QVERIFY(!input.canReceive());
+  input.reset();
+  QCOMPARE(budget.usedBytes(), qint64(0));
+  QVERIFY(input.canReceive());
+  input.setMemoryBudget(PiiMemoryBudget::global());
+}
+
+void TestPiiSocket::wakeUp()
+{
+  CountingListener listener;
+  PiiInputSocket input("input");
+  input.setListener(&listener);
+
+  // The queue is filled without a refusal. Nobody waits, so
+  // nobody is woken up.
+  input.receive(PiiVariant(1));
+  input.receive(PiiVariant(2));
+  input.shift();
+  QCOMPARE(listener.iReadyCount, 0);
+
+  // A refused sender is woken up by the next shift() even though
+  // the queue was filled after shift() was entered.
+  input.receive(PiiVariant(3));
+  QVERIFY(!input.canReceive());
+  input.shift();
+  QCOMPARE(listener.iReadyCount, 1);
+  input.shift();
+  QCOMPARE(listener.iReadyCount, 1);
+
+  // Refusals because of the memory budget work the same way.
+  input.setQueueCapacity(10);
+  input.setQueueMemoryLimit(1500);
+  input.receive(PiiVariant(PiiMatrix<unsigned char>(32, 32)));
+  input.receive(PiiVariant(PiiMatrix<unsigned char>(32, 32)));
+  QVERIFY(!input.canReceive());
+  input.shift();
+  QCOMPARE(listener.iReadyCount, 2);
+  QVERIFY(input.canReceive());
+  input.shift();
+  QCOMPARE(listener.iReadyCount, 2);
+}
+
+void TestPiiSocket::queuePeek()
+{
+  PiiInputSocket input("input");
+  QCOMPARE(input.queuedType(0), (unsigned)PiiVariant::InvalidType);
+  QVERIFY(!input.queuedObject(0).isValid());
+  QCOMPARE(input.queuedTimestamp(0), qint64(0));
+
+  input.receive(PiiVariant(1));
+  QCOMPARE(input.queuedType(0), (unsigned)PiiVariant::IntType);
+  QCOMPARE(input.queuedObject(0).valueAs<int>(), 1);
+  QVERIFY(input.queuedTimestamp(0) != 0);
+  // Slots that have not been published read as empty.
+  QCOMPARE(input.queuedType(1), (unsigned)PiiVariant::InvalidType);
+  QVERIFY(!input.queuedObject(1).isValid());
+
+  input.shift();
+  QCOMPARE(input.queuedType(0), (unsigned)PiiVariant::InvalidType);
+}
+
 QTEST_MAIN(TestPiiSocket)
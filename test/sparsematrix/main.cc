@@ -0,0 +1,173 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiSparseMatrix.h"
+
+#include <PiiSparseMatrix.h>
+#include <PiiMatrixSerialization.h>
+#include <PiiBinaryInputArchive.h>
+#include <PiiBinaryOutputArchive.h>
+#include <PiiTextInputArchive.h>
+#include <PiiTextOutputArchive.h>
+#include <QtTest>
+#include <QBuffer>
+#include <cstdlib>
+
+static PiiMatrix<int> randomSparse(int rows, int columns, int density)
+{
+  PiiMatrix<int> mat(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      if (std::rand() % 100 < density)
+        mat(r,c) = std::rand() % 19 - 9;
+  return mat;
+}
+
+void TestPiiSparseMatrix::construction()
+{
+  PiiSparseMatrix<int> matEmpty;
+  QCOMPARE(matEmpty.rows(), 0);
+  QCOMPARE(matEmpty.columns(), 0);
+  QCOMPARE(matEmpty.nonZeroCount(), 0);
+  QVERIFY(matEmpty.begin() == matEmpty.end());
+
+  PiiMatrix<int> matDense(3,4,
+                          0, 0, 2, 0,
+                          0, 0, 0, 0,
+                          1, 0, 0, 3);
+  PiiSparseMatrix<int> matSparse(matDense);
+  QCOMPARE(matSparse.nonZeroCount(), 3);
+  QCOMPARE(matSparse.values(), QVector<int>() << 2 << 1 << 3);
+  QCOMPARE(matSparse.columnIndices(), QVector<int>() << 2 << 0 << 3);
+  QCOMPARE(matSparse.rowOffsets(), QVector<int>() << 0 << 1 << 1 << 3);
+  QCOMPARE(matSparse.rowNonZeroCount(1), 0);
+  QCOMPARE(matSparse(0,2), 2);
+  QCOMPARE(matSparse(2,3), 3);
+  QCOMPARE(matSparse(1,1), 0);
+  QVERIFY(Pii::equals(matSparse.toDense(), matDense));
+
+  PiiSparseMatrix<int> matCsr(3, 4, matSparse.rowOffsets(), matSparse.columnIndices(), matSparse.values());
+  QVERIFY(Pii::equals(matCsr.toDense(), matDense));
+
+  // Unsorted columns
+  try
+    {
+      PiiSparseMatrix<int>(1, 4, QVector<int>() << 0 << 2, QVector<int>() << 3 << 1, QVector<int>() << 1 << 1);
+      QFAIL("Invalid CSR data was accepted.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+
+  PiiSparseMatrix<int> matTriplets(PiiSparseMatrix<int>::fromTriplets(3, 4,
+                                                                      QVector<int>() << 2 << 0 << 2 << 1 << 2,
+                                                                      QVector<int>() << 3 << 2 << 0 << 1 << 3,
+                                                                      QVector<int>() << 1 << 2 << 1 << 0 << 2));
+  QVERIFY(Pii::equals(matTriplets.toDense(), matDense));
+  QCOMPARE(matTriplets.nonZeroCount(), 3);
+
+  PiiMatrix<int> matRandom(randomSparse(17, 23, 10));
+  QVERIFY(Pii::equals(PiiSparseMatrix<int>(matRandom).transposed().toDense(),
+                      PiiMatrix<int>(Pii::transpose(matRandom))));
+}
+
+void TestPiiSparseMatrix::iteration()
+{
+  PiiMatrix<int> matDense(randomSparse(13, 9, 20));
+  PiiSparseMatrix<int> matSparse(matDense);
+  QCOMPARE(int(matSparse.end() - matSparse.begin()), 13 * 9);
+  QVERIFY(std::equal(matSparse.begin(), matSparse.end(), matDense.begin()));
+  QCOMPARE(Pii::sum<int>(matSparse), Pii::sum<int>(matDense));
+  // Backwards
+  PiiSparseMatrix<int>::const_iterator it = matSparse.end();
+  for (int i=13*9; i--; )
+    QCOMPARE(*--it, matDense.begin()[i]);
+  QCOMPARE(matSparse.begin()[50], matDense.begin()[50]);
+  for (int c=0; c<9; ++c)
+    QVERIFY(std::equal(matSparse.columnBegin(c), matSparse.columnEnd(c), matDense.columnBegin(c)));
+
+  // Sparse matrices can be used in expressions.
+  QVERIFY(Pii::equals(PiiMatrix<int>(matSparse + matDense), PiiMatrix<int>(matDense * 2)));
+}
+
+void TestPiiSparseMatrix::product()
+{
+  PiiMatrix<int> matA(randomSparse(31, 40, 10)), matB(randomSparse(40, 27, 15));
+  PiiSparseMatrix<int> matSparseA(matA), matSparseB(matB);
+  PiiMatrix<int> matExpected(matA * matB);
+  QVERIFY(Pii::equals(PiiMatrix<int>(matSparseA * matB), matExpected));
+  QVERIFY(Pii::equals(PiiMatrix<int>(matA * matSparseB), matExpected));
+  QVERIFY(Pii::equals(PiiMatrix<int>(matSparseA * matSparseB), matExpected));
+  QVERIFY(Pii::equals(PiiMatrix<int>(Pii::matrixProduct(matSparseA, matB, PiiParallelPolicy(4, 4))),
+                      matExpected));
+
+  PiiMatrix<double> matD(40, 1);
+  for (int r=0; r<40; ++r)
+    matD(r,0) = r * 0.5;
+  PiiSparseMatrix<double> matSparseD(matA);
+  QVERIFY(Pii::almostEqual(PiiMatrix<double>(matSparseD * matD),
+                           PiiMatrix<double>(PiiMatrix<double>(matA) * matD), 1e-10));
+}
+
+void TestPiiSparseMatrix::distance()
+{
+  PiiMatrix<int> matDense(randomSparse(5, 200, 5));
+  PiiSparseMatrix<int> matSparse(matDense);
+  for (int r1=0; r1<5; ++r1)
+    for (int r2=0; r2<5; ++r2)
+      {
+        double dSquared = 0, dAbs = 0, dInner = 0;
+        for (int c=0; c<200; ++c)
+          {
+            dSquared += Pii::square(double(matDense(r1,c) - matDense(r2,c)));
+            dAbs += std::abs(matDense(r1,c) - matDense(r2,c));
+            dInner += matDense(r1,c) * matDense(r2,c);
+          }
+        QCOMPARE(Pii::sparseSquaredDistance(matSparse, r1, matSparse, r2), dSquared);
+        QCOMPARE(Pii::sparseAbsDiffDistance(matSparse, r1, matSparse, r2), dAbs);
+        QCOMPARE(Pii::sparseInnerProduct(matSparse, r1, matSparse, r2), dInner);
+        QCOMPARE(Pii::sparseInnerProduct(matSparse, r1, matDense[r2]), dInner);
+      }
+}
+
+template <class InputArchive, class OutputArchive> static void testSerialization()
+{
+  PiiSparseMatrix<double> matSparse(PiiMatrix<double>(randomSparse(23, 31, 10)) / 4);
+  QByteArray array;
+  QBuffer buffer(&array);
+  buffer.open(QIODevice::ReadWrite);
+  {
+    OutputArchive oa(&buffer);
+    oa << matSparse;
+    oa << PiiSparseMatrix<double>();
+  }
+  buffer.seek(0);
+  InputArchive ia(&buffer);
+  PiiSparseMatrix<double> matResult, matEmpty(2,2);
+  ia >> matResult;
+  ia >> matEmpty;
+  QCOMPARE(matResult.rows(), 23);
+  QCOMPARE(matResult.columns(), 31);
+  QCOMPARE(matResult.rowOffsets(), matSparse.rowOffsets());
+  QCOMPARE(matResult.columnIndices(), matSparse.columnIndices());
+  QCOMPARE(matResult.values(), matSparse.values());
+  QCOMPARE(matEmpty.rows(), 0);
+}
+
+void TestPiiSparseMatrix::serialization()
+{
+  testSerialization<PiiBinaryInputArchive, PiiBinaryOutputArchive>();
+  testSerialization<PiiTextInputArchive, PiiTextOutputArchive>();
+}
+
+QTEST_MAIN(TestPiiSparseMatrix)
@@ -3,6 +3,7 @@
 TEMPLATE = subdirs
 
 SUBDIRS = algorithm \
+          bitmatrix \
           bits \
           boosting \
           camera \
@@ -10,19 +11,23 @@ SUBDIRS = algorithm \
           classification \
           color \
           colors \
+          cpudispatcher \
           databasewriter \
           defaultoperation \
           dsp \
           engine \
+          enginebenchmark \
           featurecombiner \
           fifo \
           filesystemscanner \
           fileutil \
           functional \
           functionoperation \
+          future \
           fraction \
           genericfunction \
           geometry \
+          half \
           heap \
           houghtransformoperation \
           httpserver \
@@ -31,14 +36,21 @@ SUBDIRS = algorithm \
           kdtree \
           kerneladatron \
           kernelperceptron \
+          latencyhistogram \
           lbp \
           lbpoperation \
+          log \
+          mailbox \
+          mappedsampleset \
           matching \
           math \
           matrix \
+          matrixaccounting \
           matrixcomposer \
           matrixdecompositions \
+          matrixpool \
           matrixutil \
+          memorybudget \
           multipartdecoder \
           operationcompound \
           optimization \
@@ -46,21 +58,31 @@ SUBDIRS = algorithm \
           pisooperation \
           planerotation \
           probeinput \
+          propertybatch \
           qimage \
           quantizer \
+          randomgenerator \
           ransac \
           readwritelock \
           remoteobject \
           resourcedatabase \
+          ringbuffer \
+          runningstatistics \
+          scheduler \
           serialization \
           simplememorymanager \
+          smallobjectallocator \
           socket \
+          sparsematrix \
           stereotriangulator \
           stringformatter \
           timer \
+          timerwheel \
+          threadpool \
           threadsafetimer \
           tracking \
           transforms \
+          typedispatcher \
           typetraits \
           universalslot \
           util \
@@ -68,7 +90,11 @@ SUBDIRS = algorithm \
           variant \
           versionnumber \
           video \
+          waitcondition \
           ydin
 
 include(../qt5.pri)
 qt5: SUBDIRS += qml
+
+# Benchmarks take long and are built only with qmake CONFIG+=benchmark
+benchmark: SUBDIRS += classificationbenchmark imagebenchmark
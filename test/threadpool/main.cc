@@ -0,0 +1,140 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiThreadPool.h"
+
+#include <PiiThreadPool.h>
+#include <PiiCpu.h>
+#include <QtTest>
+
+class CounterTask : public PiiThreadPool::Task
+{
+public:
+  CounterTask(QAtomicInt* counter) : _pCounter(counter), _threadId(0) {}
+
+  void run()
+  {
+    _threadId = QThread::currentThreadId();
+    _pCounter->ref();
+  }
+
+  Qt::HANDLE threadId() const { return _threadId; }
+
+private:
+  QAtomicInt* _pCounter;
+  Qt::HANDLE _threadId;
+};
+
+void TestPiiThreadPool::reserve()
+{
+  PiiThreadPool pool;
+  PiiThreadPool::Thread* pThread1 = pool.reserveThread();
+  PiiThreadPool::Thread* pThread2 = pool.reserveThread();
+  QVERIFY(pThread1 != pThread2);
+  QVERIFY(pool.threadId(pThread1) != 0);
+  QVERIFY(pool.threadId(pThread1) != pool.threadId(pThread2));
+  QCOMPARE(pool.activeThreadCount(), 2);
+  QCOMPARE(pool.threadCount(), 2);
+
+  pool.releaseThread(pThread1);
+  QCOMPARE(pool.activeThreadCount(), 1);
+  // The released thread must be reused.
+  PiiThreadPool::Thread* pThread3 = pool.reserveThread();
+  QVERIFY(pThread3 == pThread1);
+  QCOMPARE(pool.threadCount(), 2);
+  pool.releaseThread(pThread2);
+  pool.releaseThread(pThread3);
+  QCOMPARE(pool.activeThreadCount(), 0);
+}
+
+void TestPiiThreadPool::start()
+{
+  PiiThreadPool pool;
+  QAtomicInt iCounter(0);
+  CounterTask task(&iCounter);
+
+  PiiThreadPool::Thread* pThread = pool.reserveThread();
+  Qt::HANDLE threadId = pool.threadId(pThread);
+  pool.start(pThread, &task);
+  QVERIFY(pool.waitForTask(&task, 1000));
+  QCOMPARE(task.threadId(), threadId);
+  QCOMPARE(iCounter.load(), 1);
+
+  for (int i=0; i<100; ++i)
+    {
+      pool.start(&task);
+      QVERIFY(pool.waitForTask(&task, 1000));
+    }
+  QCOMPARE(iCounter.load(), 101);
+  QCOMPARE(pool.activeThreadCount(), 0);
+}
+
+void TestPiiThreadPool::maxThreadCount()
+{
+  PiiThreadPool pool;
+  pool.setMaxThreadCount(2);
+  QCOMPARE(pool.maxThreadCount(), 2);
+
+  QList<PiiThreadPool::Thread*> lstThreads;
+  for (int i=0; i<5; ++i)
+    lstThreads << pool.reserveThread();
+  // Reservation never blocks.
+  QCOMPARE(pool.threadCount(), 5);
+  for (int i=0; i<5; ++i)
+    pool.releaseThread(lstThreads[i]);
+  // Only two of the idle threads are retained.
+  QCOMPARE(pool.threadCount(), 2);
+  QCOMPARE(pool.activeThreadCount(), 0);
+
+  pool.setMaxThreadCount(1);
+  QCOMPARE(pool.threadCount(), 1);
+}
+
+class CpuTask : public PiiThreadPool::Task
+{
+public:
+  CpuTask() : iCpu(-1) {}
+
+  void run() { iCpu = Pii::currentCpu(); }
+
+  int iCpu;
+};
+
+void TestPiiThreadPool::affinity()
+{
+  QList<int> lstCpus(Pii::numaNodeCpus(0));
+  QVERIFY(Pii::numaNodeCount() >= 1);
+  QVERIFY(!lstCpus.isEmpty());
+  QCOMPARE(Pii::numaNodeOfCpu(lstCpus.last()), 0);
+
+#ifdef Q_OS_LINUX
+  PiiThreadPool pool;
+  pool.setMaxThreadCount(1);
+  CpuTask task;
+  int iLastCpu = lstCpus.last();
+  for (int i=0; i<10; ++i)
+    {
+      pool.start(&task, QThread::InheritPriority, QList<int>() << iLastCpu);
+      QVERIFY(pool.waitForTask(&task, 1000));
+      QCOMPARE(task.iCpu, iLastCpu);
+    }
+  // The restriction is lifted for tasks without a hint.
+  pool.start(&task);
+  QVERIFY(pool.waitForTask(&task, 1000));
+  QCOMPARE(pool.threadCount(), 1);
+#endif
+}
+
+QTEST_MAIN(TestPiiThreadPool)
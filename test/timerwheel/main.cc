@@ -0,0 +1,148 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiTimerWheel.h"
+
+#include <PiiTimerWheel.h>
+#include <QtTest>
+#include <QVector>
+
+namespace
+{
+  struct Timeout : PiiTimerWheel::Entry
+  {
+    Timeout() : iExpirations(0) {}
+    int iExpirations;
+  };
+
+  // Marks the expired entries and checks that none of them expired
+  // too early. Returns the number of expired entries.
+  int expire(PiiTimerWheel& wheel, qint64 time, bool* early)
+  {
+    int iCount = 0;
+    for (PiiTimerWheel::Entry* pEntry = wheel.advance(time); pEntry != 0; pEntry = pEntry->next())
+      {
+        if (pEntry->time() > time || pEntry->isScheduled())
+          *early = true;
+        ++static_cast<Timeout*>(pEntry)->iExpirations;
+        ++iCount;
+      }
+    return iCount;
+  }
+}
+
+void TestPiiTimerWheel::schedule()
+{
+  PiiTimerWheel wheel(10, 1000);
+  QVERIFY(wheel.isEmpty());
+  QCOMPARE(wheel.resolution(), qint64(10));
+
+  Timeout aTimeouts[3];
+  wheel.schedule(&aTimeouts[0], 1005);
+  wheel.schedule(&aTimeouts[1], 1025);
+  wheel.schedule(&aTimeouts[2], 500); // overdue
+  QCOMPARE(wheel.count(), 3);
+  QVERIFY(aTimeouts[0].isScheduled());
+
+  bool bEarly = false;
+  QCOMPARE(expire(wheel, 1004, &bEarly), 1);
+  QCOMPARE(aTimeouts[2].iExpirations, 1);
+  QCOMPARE(expire(wheel, 1005, &bEarly), 1);
+  QCOMPARE(aTimeouts[0].iExpirations, 1);
+  QVERIFY(!aTimeouts[0].isScheduled());
+  QCOMPARE(expire(wheel, 1024, &bEarly), 0);
+  QCOMPARE(expire(wheel, 2000, &bEarly), 1);
+  QVERIFY(!bEarly);
+  QVERIFY(wheel.isEmpty());
+
+  // Rescheduling moves the entry.
+  wheel.schedule(&aTimeouts[0], 3000);
+  wheel.schedule(&aTimeouts[0], 2500);
+  QCOMPARE(wheel.count(), 1);
+  QCOMPARE(expire(wheel, 2600, &bEarly), 1);
+  QCOMPARE(aTimeouts[0].iExpirations, 2);
+}
+
+void TestPiiTimerWheel::cancel()
+{
+  PiiTimerWheel wheel(1);
+  QVector<Timeout> vecTimeouts(1000);
+  for (int i=0; i<vecTimeouts.size(); ++i)
+    wheel.schedule(&vecTimeouts[i], i * 97);
+  for (int i=0; i<vecTimeouts.size(); i+=2)
+    wheel.cancel(&vecTimeouts[i]);
+  // Cancelling twice does nothing.
+  wheel.cancel(&vecTimeouts[0]);
+  QCOMPARE(wheel.count(), 500);
+
+  bool bEarly = false;
+  for (qint64 iTime = 0; !wheel.isEmpty(); iTime += 1000)
+    expire(wheel, iTime, &bEarly);
+  QVERIFY(!bEarly);
+  for (int i=0; i<vecTimeouts.size(); ++i)
+    QCOMPARE(vecTimeouts[i].iExpirations, i & 1);
+}
+
+void TestPiiTimerWheel::nextExpirationTime()
+{
+  PiiTimerWheel wheel(10);
+  QCOMPARE(wheel.nextExpirationTime(), qint64(-1));
+
+  Timeout near, far;
+  wheel.schedule(&far, 1000000);
+  // Beyond the first level: the time at which the entry is moved down.
+  qint64 iNext = wheel.nextExpirationTime();
+  QVERIFY(iNext > 0);
+  QVERIFY(iNext <= 1000000);
+
+  // Within the first level: the exact time.
+  wheel.schedule(&near, 1234);
+  QCOMPARE(wheel.nextExpirationTime(), qint64(1234));
+
+  // Following nextExpirationTime() never misses an entry.
+  bool bEarly = false;
+  int iSteps = 0;
+  while (!wheel.isEmpty())
+    {
+      iNext = wheel.nextExpirationTime();
+      QVERIFY(iNext <= far.time());
+      expire(wheel, iNext, &bEarly);
+      ++iSteps;
+    }
+  QVERIFY(!bEarly);
+  QCOMPARE(near.iExpirations, 1);
+  QCOMPARE(far.iExpirations, 1);
+  // Empty stretches are skipped, not walked through.
+  QVERIFY(iSteps < 10);
+}
+
+void TestPiiTimerWheel::longTimeouts()
+{
+  PiiTimerWheel wheel(1, 12345);
+  QVector<Timeout> vecTimeouts(150);
+  // Spread over all levels, some beyond the reach of the wheel.
+  qint64 iTime = 1;
+  for (int i=0; i<vecTimeouts.size(); ++i, iTime = iTime * 5 / 4 + 1)
+    wheel.schedule(&vecTimeouts[i], 12345 + iTime);
+
+  bool bEarly = false;
+  int iExpired = 0;
+  while (!wheel.isEmpty())
+    iExpired += expire(wheel, wheel.nextExpirationTime(), &bEarly);
+  QVERIFY(!bEarly);
+  QCOMPARE(iExpired, vecTimeouts.size());
+}
+
+QTEST_MAIN(TestPiiTimerWheel)
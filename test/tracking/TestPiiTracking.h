@@ -26,6 +26,8 @@ private slots:
   void testLinkedList();
   void testConstantVelocityTracker();
   void testExtendedCoordinateTracker();
+  void testSpatialGating();
+  void testParallelExpansion();
 };
 
 
@@ -261,4 +261,114 @@ void TestPiiTracking::testExtendedCoordinateTracker()
     }
 }
 
+namespace
+{
+  typedef PiiVector<double,2> Point;
+
+  // A crowd of points moving at constant velocities, with a few
+  // spurious detections.
+  QList<QList<Point> > createCrowd(int points, int frames)
+  {
+    srand(11);
+    PiiMatrix<double> matState(points, 4);
+    for (int i=0; i<points; ++i)
+      {
+        matState(i,0) = rand() % 1000;
+        matState(i,1) = rand() % 1000;
+        matState(i,2) = rand() % 7 - 3;
+        matState(i,3) = rand() % 7 - 3;
+      }
+
+    QList<QList<Point> > lstFrames;
+    for (int t=0; t<frames; ++t)
+      {
+        QList<Point> measurements;
+        for (int i=0; i<points; ++i)
+          {
+            if (rand() % 10 != 0)
+              measurements << Point(matState(i,0) + rand() % 3 - 1, matState(i,1) + rand() % 3 - 1);
+            matState(i,0) += matState(i,2);
+            matState(i,1) += matState(i,3);
+          }
+        for (int i=0; i<10; ++i)
+          measurements << Point(rand() % 1000, rand() % 1000);
+        lstFrames << measurements;
+      }
+    return lstFrames;
+  }
+
+  void initTracker(PiiExtendedCoordinateTracker<double,2>& tracker)
+  {
+    tracker.setInitialThreshold(30);
+    tracker.setPredictionThreshold(9);
+    tracker.setMaximumStopTime(2);
+    tracker.setMaximumPredictionLength(2);
+  }
+
+  bool equalTrajectories(const PiiExtendedCoordinateTracker<double,2>& tracker1,
+                         const PiiExtendedCoordinateTracker<double,2>& tracker2)
+  {
+    if (tracker1.count() != tracker2.count())
+      return false;
+    for (int i=0; i<tracker1.count(); ++i)
+      {
+        PiiCoordinateTrackerNode<double,2>* tr1 = tracker1[i], *tr2 = tracker2[i];
+        if (tr1->length() != tr2->length() ||
+            tr1->measurementFitness() != tr2->measurementFitness())
+          return false;
+        for (; tr1; tr1 = tr1->next(), tr2 = tr2->next())
+          if (!(tr1->measurement() == tr2->measurement()))
+            return false;
+      }
+    return true;
+  }
+}
+
+void TestPiiTracking::testSpatialGating()
+{
+  PiiExtendedCoordinateTracker<double,2> trackers[2];
+  for (int i=0; i<2; ++i)
+    initTracker(trackers[i]);
+  trackers[1].setSpatialGating(true);
+  QVERIFY(!trackers[0].spatialGating());
+
+  QList<QList<Point> > lstFrames(createCrowd(150, 8));
+  for (int t=0; t<lstFrames.size(); ++t)
+    {
+      trackers[0].addMeasurements(lstFrames[t], t);
+      trackers[1].addMeasurements(lstFrames[t], t);
+      QVERIFY(equalTrajectories(trackers[0], trackers[1]));
+    }
+  QVERIFY(trackers[0].count() > 75);
+  for (int i=0; i<2; ++i)
+    qDeleteAll(trackers[i]);
+}
+
+void TestPiiTracking::testParallelExpansion()
+{
+  PiiExtendedCoordinateTracker<double,2> trackers[3];
+  for (int i=0; i<3; ++i)
+    initTracker(trackers[i]);
+  trackers[1].setParallelPolicy(PiiParallelPolicy(4, 8));
+  trackers[1].setSpatialGating(true);
+  trackers[2].setParallelPolicy(PiiParallelPolicy(4, 8));
+  trackers[2].setInitialThreshold(400);
+  trackers[2].setMaxBranches(2);
+  QCOMPARE(trackers[2].maxBranches(), 2);
+
+  QList<QList<Point> > lstFrames(createCrowd(150, 8));
+  for (int t=0; t<lstFrames.size(); ++t)
+    {
+      for (int i=0; i<3; ++i)
+        trackers[i].addMeasurements(lstFrames[t], t);
+      QVERIFY(equalTrajectories(trackers[0], trackers[1]));
+      // No trajectory was extended with more than two measurements.
+      for (int i=0; i<trackers[2].count(); ++i)
+        if (trackers[2][i]->time() == t && trackers[2][i]->next() != 0)
+          QVERIFY(trackers[2][i]->next()->branches() <= 2);
+    }
+  for (int i=0; i<3; ++i)
+    qDeleteAll(trackers[i]);
+}
+
 QTEST_MAIN(TestPiiTracking)
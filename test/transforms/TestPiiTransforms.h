@@ -24,6 +24,7 @@ class TestPiiTransforms : public QObject
 
 private slots:
   void linearHough();
+  void parallelHough();
   void circularHough();
 };
 
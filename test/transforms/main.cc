@@ -227,6 +227,67 @@ void TestPiiTransforms::linearHough()
   */
 }
 
+void TestPiiTransforms::parallelHough()
+{
+  PiiMatrix<int> img(61, 87);
+  PiiMatrix<float> matDirections(61, 87);
+  for (int r=0; r<img.rows(); ++r)
+    for (int c=0; c<img.columns(); ++c)
+      {
+        if (rand() % 7 == 0)
+          img(r,c) = rand() % 200 + 1;
+        matDirections(r,c) = float((rand() / double(RAND_MAX) * 2 - 1) * M_PI);
+      }
+  // A line at 30 degrees through the center, with gradient in the
+  // same direction.
+  int iLinePixels = 0;
+  for (int c=0; c<img.columns(); ++c)
+    {
+      int r = Pii::round<int>(30 - (c - 43) / std::tan(M_PI/6));
+      if (r >= 0 && r < img.rows())
+        {
+          img(r,c) = 255;
+          matDirections(r,c) = float(M_PI/6);
+          ++iLinePixels;
+        }
+    }
+
+  PiiHoughTransform hough(2.0, 0.5, -30, 200);
+  PiiMatrix<int> matSequential(hough.transform<int>(img));
+  // The columns are divided among threads. The result must be exactly
+  // the same.
+  QVERIFY(Pii::equals(matSequential, hough.transform<int>(img, Pii::Identity<int>(), PiiParallelPolicy(4, 3))));
+  // A window of 90 degrees covers all angles.
+  QVERIFY(Pii::equals(matSequential, hough.transform<int>(img, Pii::Identity<int>(),
+                                                          matDirections, 90, PiiParallelPolicy(3, 1))));
+
+  // Restricted voting keeps the peak but removes most other votes.
+  PiiMatrix<int> matRestricted(hough.transform<int>(img, Pii::Identity<int>(),
+                                                    matDirections, 5, PiiParallelPolicy(4, 3)));
+  QVERIFY(Pii::equals(matRestricted, hough.transform<int>(img, Pii::Identity<int>(), matDirections, 5)));
+  int r1, c1, r2, c2;
+  Pii::max(matSequential, &r1, &c1);
+  Pii::max(matRestricted, &r2, &c2);
+  QCOMPARE(r2, r1);
+  QCOMPARE(c2, c1);
+  QVERIFY(matRestricted(r2, c2) >= iLinePixels * 255);
+  QVERIFY(Pii::sum<int>(matRestricted) < Pii::sum<int>(matSequential) / 8);
+
+  // The opposite gradient direction votes for the same lines.
+  PiiMatrix<float> matOpposite(matDirections);
+  for (int r=0; r<img.rows(); ++r)
+    for (int c=0; c<img.columns(); ++c)
+      matOpposite(r,c) += matOpposite(r,c) > 0 ? float(-M_PI) : float(M_PI);
+  QVERIFY(Pii::equals(matRestricted, hough.transform<int>(img, Pii::Identity<int>(), matOpposite, 5)));
+
+  try
+    {
+      hough.transform<int>(img, Pii::Identity<int>(), PiiMatrix<float>(3,3), 5);
+      QFAIL("Mismatching gradient directions were accepted.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
 void TestPiiTransforms::circularHough()
 {
   PiiMatrix<int> matImg(9,9,
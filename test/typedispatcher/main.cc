@@ -0,0 +1,97 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiTypeDispatcher.h"
+
+#include <PiiTypeDispatcher.h>
+#include <PiiYdinTypes.h>
+#include <QtTest>
+
+class Receiver
+{
+public:
+  typedef PiiTypeDispatcher<Receiver> Dispatcher;
+
+  Receiver() : iSum(0) {}
+
+  template <class T> void handle(const PiiVariant& obj)
+  {
+    iSum += int(obj.valueAs<T>());
+  }
+
+  void handleString(const PiiVariant& obj)
+  {
+    strValue = obj.valueAs<QString>();
+  }
+
+  static Dispatcher::Handler resolveHandler(unsigned int type)
+  {
+    ++iResolveCount;
+    switch (type)
+      {
+        PII_INTEGER_CASES_M(return &Receiver::handle, );
+      case PiiVariant::DoubleType:
+        return &Receiver::handle<double>;
+      }
+    return 0;
+  }
+
+  int iSum;
+  QString strValue;
+  static int iResolveCount;
+};
+
+int Receiver::iResolveCount = 0;
+
+void TestPiiTypeDispatcher::dispatch()
+{
+  Receiver::iResolveCount = 0;
+  Receiver receiver;
+  Receiver::Dispatcher dispatcher(Receiver::resolveHandler);
+
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(1)));
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(2)));
+  QCOMPARE(receiver.iSum, 3);
+  QCOMPARE(Receiver::iResolveCount, 1);
+
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(4.0)));
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(char(8))));
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(16)));
+  QCOMPARE(receiver.iSum, 31);
+  QCOMPARE(Receiver::iResolveCount, 3);
+
+  // Unsupported types are resolved only once, too.
+  QVERIFY(!dispatcher.dispatch(&receiver, PiiVariant(true)));
+  QVERIFY(!dispatcher.dispatch(&receiver, PiiVariant(false)));
+  QCOMPARE(Receiver::iResolveCount, 4);
+  QCOMPARE(receiver.iSum, 31);
+  QVERIFY(dispatcher.handler(PiiVariant::BoolType) == 0);
+}
+
+void TestPiiTypeDispatcher::setHandler()
+{
+  Receiver receiver;
+  Receiver::Dispatcher dispatcher;
+
+  QVERIFY(!dispatcher.dispatch(&receiver, PiiVariant(1)));
+  dispatcher.setHandler(PiiVariant::IntType, &Receiver::handle<int>);
+  dispatcher.setHandler(PiiYdin::QStringType, &Receiver::handleString);
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(1)));
+  QVERIFY(dispatcher.dispatch(&receiver, PiiVariant(QString("abc"))));
+  QCOMPARE(receiver.iSum, 1);
+  QCOMPARE(receiver.strValue, QString("abc"));
+}
+
+QTEST_MAIN(TestPiiTypeDispatcher)
@@ -32,6 +32,7 @@ private slots:
   void typeName();
   void equals();
   void toQVariant();
+  void moveAndEmplace();
 };
 
 #endif //_TESTPIIVARIANT_H
@@ -176,6 +176,53 @@ void TestPiiVariant::copy()
   QVERIFY(!v4.isValid());
 }
 
+void TestPiiVariant::moveAndEmplace()
+{
+#ifdef PII_CXX11
+  QCOMPARE(BigType::iCount, 0);
+  {
+    PiiVariant v1(BigType(), 0x666);
+    QCOMPARE(BigType::iCount, 1);
+    PiiVariant v2(std::move(v1));
+    QVERIFY(!v1.isValid());
+    QCOMPARE(v2.type(), Pii::typeId<BigType>());
+    QCOMPARE(BigType::iCount, 1);
+    v1 = std::move(v2);
+    QVERIFY(!v2.isValid());
+    QCOMPARE(BigType::iCount, 1);
+
+    PiiMatrix<int>& mat = v1.emplace<PiiMatrix<int> >(2, 3);
+    QCOMPARE(BigType::iCount, 0);
+    QCOMPARE(v1.type(), (unsigned)PiiYdin::IntMatrixType);
+    mat(1,2) = 5;
+    QCOMPARE(v1.valueAs<PiiMatrix<int> >()(1,2), 5);
+
+    PiiVariant v3(v1);
+    PiiVariant v4(std::move(v3));
+    QCOMPARE(v4.valueAs<PiiMatrix<int> >().rows(), 2);
+    QVERIFY(!v3.isValid());
+
+    v4 = PiiVariant(QString("moved"));
+    QCOMPARE(v4.valueAs<QString>(), QString("moved"));
+    PiiVariant v5(1.5);
+    v4 = std::move(v5);
+    QCOMPARE(v4.valueAs<double>(), 1.5);
+    QVERIFY(!v5.isValid());
+
+    // A custom type id must not be mistaken for a temporary.
+    PiiVariant v6(0, PiiYdin::DropTagType);
+    QCOMPARE(v6.type(), (unsigned)PiiYdin::DropTagType);
+  }
+  QCOMPARE(BigType::iCount, 0);
+#else
+  QSKIP("Move semantics require C++11."
+#if QT_VERSION < 0x050000
+        , SkipAll
+#endif
+        );
+#endif
+}
+
 void TestPiiVariant::mapType()
 {
   QCOMPARE(BigType::iCount, 0);
@@ -0,0 +1,44 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIIWAITCONDITION_H
+#define _TESTPIIWAITCONDITION_H
+
+#include <QObject>
+#include <PiiWaitCondition.h>
+#include <PiiAtomicInt.h>
+
+class TestPiiWaitCondition : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void noQueue();
+  void queue();
+  void timeout();
+  void threaded();
+  void wakeAll();
+  void wakeAllWhileJoining();
+
+private:
+  void waiter(PiiWaitCondition* condition, int count);
+  void blockingWaiter(PiiWaitCondition* condition);
+  void waker(PiiWaitCondition* condition, int count);
+  void countingWaiter(PiiWaitCondition* condition, PiiAtomicInt* released);
+  void joiner(PiiWaitCondition* condition, PiiAtomicInt* running, PiiAtomicInt* stop);
+};
+
+
+#endif //_TESTPIIWAITCONDITION_H
@@ -0,0 +1,157 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiWaitCondition.h"
+
+#include <QtTest>
+#include <PiiAsyncCall.h>
+#include <PiiDelay.h>
+#include <PiiAtomicInt.h>
+#include <QElapsedTimer>
+
+void TestPiiWaitCondition::noQueue()
+{
+  PiiWaitCondition condition;
+  QCOMPARE(condition.queueMode(), PiiWaitCondition::NoQueue);
+  condition.wakeOne();
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 1u);
+  QVERIFY(condition.wait(0));
+  QVERIFY(!condition.wait(0));
+  QCOMPARE(condition.queueLength(), 0u);
+  QCOMPARE(condition.waiterCount(), 0u);
+}
+
+void TestPiiWaitCondition::queue()
+{
+  PiiWaitCondition condition(PiiWaitCondition::Queue);
+  condition.wakeOne();
+  condition.wakeOne();
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 3u);
+  QVERIFY(condition.wait(0));
+  QVERIFY(condition.wait(0));
+  QCOMPARE(condition.queueLength(), 1u);
+  condition.wakeAll();
+  QCOMPARE(condition.queueLength(), 0u);
+  QVERIFY(!condition.wait(0));
+}
+
+void TestPiiWaitCondition::timeout()
+{
+  PiiWaitCondition condition;
+  QTime time;
+  time.start();
+  QVERIFY(!condition.wait(50));
+  QVERIFY(time.elapsed() >= 45);
+  // A timed-out waiter must not be counted.
+  QCOMPARE(condition.waiterCount(), 0u);
+  condition.wakeOne();
+  QCOMPARE(condition.queueLength(), 1u);
+}
+
+void TestPiiWaitCondition::waiter(PiiWaitCondition* condition, int count)
+{
+  for (int i=0; i<count; ++i)
+    while (!condition->wait(10)) ;
+}
+
+void TestPiiWaitCondition::blockingWaiter(PiiWaitCondition* condition)
+{
+  condition->wait();
+}
+
+void TestPiiWaitCondition::waker(PiiWaitCondition* condition, int count)
+{
+  for (int i=0; i<count; ++i)
+    condition->wakeOne();
+}
+
+void TestPiiWaitCondition::threaded()
+{
+  // Every signal must be consumed exactly once.
+  PiiWaitCondition condition(PiiWaitCondition::Queue);
+  QThread* pWaiter1 = Pii::asyncCall(this, &TestPiiWaitCondition::waiter, &condition, 10000);
+  QThread* pWaiter2 = Pii::asyncCall(this, &TestPiiWaitCondition::waiter, &condition, 10000);
+  QThread* pWaker1 = Pii::asyncCall(this, &TestPiiWaitCondition::waker, &condition, 5000);
+  QThread* pWaker2 = Pii::asyncCall(this, &TestPiiWaitCondition::waker, &condition, 15000);
+
+  QVERIFY(pWaiter1->wait(10000));
+  QVERIFY(pWaiter2->wait(10000));
+  pWaker1->wait();
+  pWaker2->wait();
+
+  QCOMPARE(condition.queueLength(), 0u);
+  QCOMPARE(condition.waiterCount(), 0u);
+}
+
+void TestPiiWaitCondition::wakeAll()
+{
+  PiiWaitCondition condition;
+  QThread* pWaiter1 = Pii::asyncCall(this, &TestPiiWaitCondition::blockingWaiter, &condition);
+  QThread* pWaiter2 = Pii::asyncCall(this, &TestPiiWaitCondition::blockingWaiter, &condition);
+  while (condition.waiterCount() < 2)
+    PiiDelay::msleep(1);
+  condition.wakeAll();
+  QVERIFY(pWaiter1->wait(1000));
+  QVERIFY(pWaiter2->wait(1000));
+}
+
+void TestPiiWaitCondition::countingWaiter(PiiWaitCondition* condition, PiiAtomicInt* released)
+{
+  condition->wait();
+  ++*released;
+}
+
+void TestPiiWaitCondition::joiner(PiiWaitCondition* condition, PiiAtomicInt* running, PiiAtomicInt* stop)
+{
+  ++*running;
+  while (stop->load() == 0)
+    condition->wait(0);
+  --*running;
+}
+
+void TestPiiWaitCondition::wakeAllWhileJoining()
+{
+  // Threads that start waiting during wakeAll() must not take the
+  // wake-ups of the threads that were already waiting.
+  PiiWaitCondition condition;
+  for (int iRound=0; iRound<50; ++iRound)
+    {
+      PiiAtomicInt iReleased(0), iRunning(0), iStop(0);
+      for (int i=0; i<4; ++i)
+        Pii::asyncCall(this, &TestPiiWaitCondition::countingWaiter, &condition, &iReleased);
+      while (condition.waiterCount() < 4)
+        PiiDelay::msleep(1);
+      for (int i=0; i<4; ++i)
+        Pii::asyncCall(this, &TestPiiWaitCondition::joiner, &condition, &iRunning, &iStop);
+      while (iRunning.load() < 4)
+        PiiDelay::msleep(1);
+
+      condition.wakeAll();
+
+      QElapsedTimer timer;
+      timer.start();
+      while (iReleased.load() < 4 && timer.elapsed() < 1000)
+        PiiDelay::msleep(1);
+      iStop.store(1);
+      while (iRunning.load() > 0)
+        PiiDelay::msleep(1);
+      QCOMPARE(iReleased.load(), 4);
+      QCOMPARE(condition.waiterCount(), 0u);
+    }
+}
+
+QTEST_MAIN(TestPiiWaitCondition)
@@ -25,6 +25,8 @@ class TestPiiYdin : public QObject
 private slots:
   void initTestCase();
   void createResource();
+  void wireFormat();
+  void matrixToScript();
 };
 
 
@@ -17,6 +17,10 @@
 
 #include <PiiYdin.h>
 #include <PiiPlugin.h>
+#include <PiiWireFormat.h>
+#include <PiiColor.h>
+#include <PiiYdinTypes.h>
+#include <PiiSerializationException.h>
 #include <QtTest>
 
 class Interface1
@@ -100,4 +104,75 @@ void TestPiiYdin::createResource()
 
 }
 
+void TestPiiYdin::wireFormat()
+{
+  using namespace PiiWireFormat;
+
+  QCOMPARE(decode(encode(PiiVariant(-5))).valueAs<int>(), -5);
+  QCOMPARE(decode(encode(PiiVariant(0.25))).valueAs<double>(), 0.25);
+  QCOMPARE(decode(encode(PiiVariant(QString("\xe4\xf6")))).valueAs<QString>(), QString("\xe4\xf6"));
+
+  PiiMatrix<unsigned char> matImage(480, 640);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = (unsigned char)(r/40 + c/64);
+
+  for (int i=0; i<2; ++i)
+    {
+      Compression compression = i == 0 ? NoCompression : FastCompression;
+      QByteArray aEncoded = encode(PiiVariant(matImage), compression);
+      if (compression == FastCompression)
+        QVERIFY(aEncoded.size() < matImage.rows() * matImage.columns() / 4);
+      PiiVariant decoded = decode(aEncoded);
+      QCOMPARE(decoded.type(), (unsigned)PiiYdin::UnsignedCharMatrixType);
+      QVERIFY(Pii::equals(decoded.valueAs<PiiMatrix<unsigned char> >(), matImage));
+
+      // A sub-matrix has a stride larger than the row length.
+      PiiMatrix<unsigned char> matSub(matImage(10, 3, 100, 301));
+      decoded = decode(encode(PiiVariant(matSub), compression));
+      QVERIFY(Pii::equals(decoded.valueAs<PiiMatrix<unsigned char> >(), matSub));
+    }
+
+  PiiMatrix<PiiColor<float> > matColor(3, 2);
+  matColor(2,1) = PiiColor<float>(1, 2, 3);
+  PiiVariant decoded = decode(encode(PiiVariant(matColor)));
+  QCOMPARE(decoded.type(), (unsigned)PiiYdin::FloatColorMatrixType);
+  QCOMPARE(decoded.valueAs<PiiMatrix<PiiColor<float> > >()(2,1).c2, 3.0f);
+
+  QByteArray aTruncated = encode(PiiVariant(matImage), FastCompression);
+  aTruncated.chop(1);
+  try
+    {
+      decode(aTruncated);
+      QFAIL("Truncated data was accepted.");
+    }
+  catch (PiiSerializationException&) {}
+}
+
+void TestPiiYdin::matrixToScript()
+{
+  const PiiMatrix<double> matData(2, 3,
+                                  1.0, 2.0, 3.0,
+                                  4.0, 5.0, 6.0);
+  // A submatrix has padding between rows.
+  PiiVariant varSub(PiiMatrix<double>(matData(0,1,2,2)));
+  QCOMPARE(PiiYdin::typedArrayName(varSub), QString("Float64Array"));
+
+  QByteArray aData = PiiYdin::matrixToByteArray(varSub);
+  QCOMPARE(aData.size(), int(4 * sizeof(double)));
+  const double* pValues = reinterpret_cast<const double*>(aData.constData());
+  QCOMPARE(pValues[0], 2.0);
+  QCOMPARE(pValues[1], 3.0);
+  QCOMPARE(pValues[2], 5.0);
+  QCOMPARE(pValues[3], 6.0);
+
+  QVariantList lstValues = PiiYdin::matrixToVariantList(PiiVariant(matData));
+  QCOMPARE(lstValues.size(), 6);
+  QCOMPARE(lstValues[4].toDouble(), 5.0);
+
+  QVERIFY(PiiYdin::typedArrayName(PiiVariant(PiiMatrix<qint64>(1,1))).isNull());
+  QVERIFY(PiiYdin::matrixToByteArray(PiiVariant(1.0)).isEmpty());
+  QVERIFY(PiiYdin::matrixToVariantList(PiiVariant(QString("a"))).isEmpty());
+}
+
 QTEST_MAIN(TestPiiYdin)
@@ -16,6 +16,7 @@
 #include "PiiBasicOperation.h"
 #include "PiiYdinTypes.h"
 #include "PiiNullInputController.h"
+#include "PiiOperationCompound.h"
 
 PiiBasicOperation::Data::Data() :
   state(PiiOperation::Stopped)
@@ -48,8 +49,15 @@ void PiiBasicOperation::check(bool reset)
                .arg(metaObject()->className())
                .arg(objectName()));
 
+  PiiOperationCompound* pParentCompound = qobject_cast<PiiOperationCompound*>(parent());
+  PiiMemoryBudget* pBudget = pParentCompound != 0 ?
+    pParentCompound->memoryBudget() :
+    PiiMemoryBudget::global();
+
   for (int i=d->lstInputs.size(); i--; )
     {
+      d->lstInputs[i]->setMemoryBudget(pBudget);
+
       if (!d->lstInputs[i]->isOptional() &&
           !d->lstInputs[i]->isConnected())
         PII_THROW(PiiExecutionException, tr("Input \"%1\" of %2 (objectName %3) is required but not connected.")
@@ -35,7 +35,9 @@ public:
 
   /**
    * Check the operation for execution. If any non-optional sockets is
-   * not connected, an exception is thrown.
+   * not connected, an exception is thrown. The inputs are connected
+   * to the memory budget of the parent compound
+   * ([PiiOperationCompound::memoryBudget()]).
    *
    * @param reset if `true`, all sockets are cleared.
    *
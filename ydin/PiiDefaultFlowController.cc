@@ -52,6 +52,13 @@ void PiiDefaultFlowController::SyncGroup::sendTag()
   _iFlowLevel += flowLevelChange;
 }
 
+void PiiDefaultFlowController::SyncGroup::sendDropTag()
+{
+  PiiVariant tag(PiiYdin::createDropTag());
+  for (int i=lstOutputs.size(); i--; )
+    lstOutputs[i]->emitObject(tag);
+}
+
 void PiiDefaultFlowController::SyncGroup::shiftInputs()
 {
   for (int i=size(); i--; )
@@ -200,7 +207,8 @@ void PiiDefaultFlowController::SyncGroup::resume()
   _bSyncStartSent = false;
 }
 
-PiiFlowController::FlowState PiiDefaultFlowController::SyncGroup::prepareProcess(QVector<SyncEvent>& syncEvents)
+PiiFlowController::FlowState PiiDefaultFlowController::SyncGroup::prepareProcess(QVector<SyncEvent>& syncEvents,
+                                                                                 qint64 expiryTime)
 {
   // Can't handle objects if children have not been processed yet.
 #define CHECK_ACTIVE_CHILDREN  if (_iActiveChildren > 0) return IncompleteState
@@ -214,45 +222,57 @@ PiiFlowController::FlowState PiiDefaultFlowController::SyncGroup::prepareProcess
          _iActiveChildren);
   */
 
-  switch (PiiFlowController::inputGroupTypeMask(begin(), end()))
+  int iTypeMask = PiiFlowController::inputGroupTypeMask(begin(), end());
+  switch (iTypeMask)
     {
     case NoObject: // (Partially) empty group
       return IncompleteState;
 
+    case DropTag: // A dropped object replaces a normal one
     case NormalObject: // Normal object in all sockets
-      CHECK_ACTIVE_CHILDREN;
-
-      if (_pParentGroup != 0)
-        {
-          // Ensure sync events have been sent to all parents
-          _pParentGroup->activateParents(syncEvents);
-          // Flow level must be higher than that of the parent.
-          if (_iFlowLevel <= _pParentGroup->_iFlowLevel)
-            flowLevelError();
-          // If the parent-child relationship is of a strict type, we
-          // need to wait for the parent first.
-          if (_bStrictRelationship && _pParentGroup->_iActiveChildren == 0)
-            return IncompleteState;
-        }
-
-      // We are going to process this group
-      shiftInputs();
-
-      // Setting this value makes it possible for the child groups to
-      // decrease their flow level.
-      _iActiveChildren = _lstChildGroups.size();
-
-      // If this group is a parent, a sync event must be sent. The
-      // event may already have been sent if any child group received
-      // a start tag earlier.
-      if (_iActiveChildren > 0 && !_bSyncStartSent)
-        {
-          syncEvents << SyncEvent(SyncEvent::StartInput, _iGroupId);
-          _bSyncStartSent = true;
-        }
-
-      // Process this group
-      return ProcessableState;
+      {
+        CHECK_ACTIVE_CHILDREN;
+
+        if (_pParentGroup != 0)
+          {
+            // Ensure sync events have been sent to all parents
+            _pParentGroup->activateParents(syncEvents);
+            // Flow level must be higher than that of the parent.
+            if (_iFlowLevel <= _pParentGroup->_iFlowLevel)
+              flowLevelError();
+            // If the parent-child relationship is of a strict type, we
+            // need to wait for the parent first.
+            if (_bStrictRelationship && _pParentGroup->_iActiveChildren == 0)
+              return IncompleteState;
+          }
+
+        // Shed load only in independent groups. The objects in related
+        // groups are accounted for in the flow levels of the others.
+        bool bDrop = iTypeMask == DropTag ||
+          (_pParentGroup == 0 && _lstChildGroups.isEmpty() &&
+           PiiFlowController::isExpired(begin(), end(), expiryTime));
+        if (bDrop)
+          sendDropTag();
+
+        // We are going to process this group
+        shiftInputs();
+
+        // Setting this value makes it possible for the child groups to
+        // decrease their flow level.
+        _iActiveChildren = _lstChildGroups.size();
+
+        // If this group is a parent, a sync event must be sent. The
+        // event may already have been sent if any child group received
+        // a start tag earlier.
+        if (_iActiveChildren > 0 && !_bSyncStartSent)
+          {
+            syncEvents << SyncEvent(SyncEvent::StartInput, _iGroupId);
+            _bSyncStartSent = true;
+          }
+
+        // Process this group unless it was dropped
+        return bDrop ? SynchronizedState : ProcessableState;
+      }
 
     case StartTag:
       CHECK_ACTIVE_CHILDREN;
@@ -357,7 +377,8 @@ void PiiDefaultFlowController::SyncGroup::setParentGroup(SyncGroup* parent)
 
 PiiDefaultFlowController::Data::Data(const QList<PiiInputSocket*>& inputs,
                                      const QList<PiiOutputSocket*>& outputs,
-                                     const RelationList& relations)
+                                     const RelationList& relations) :
+  pProcessedGroup(0)
 {
   initHierarchy(relations);
 
@@ -499,6 +520,8 @@ PiiFlowController::FlowState PiiDefaultFlowController::prepareProcess()
 {
   PII_D;
   d->vecSyncEvents.clear();
+  d->pProcessedGroup = 0;
+  qint64 iExpiryTime = expiryTime();
 
   // Check all input groups from last to first. This order ensures
   // that parents are always handled after their children, which
@@ -506,13 +529,14 @@ PiiFlowController::FlowState PiiDefaultFlowController::prepareProcess()
   for (int i=d->vecActiveSyncGroups.size(); i--; )
     {
       SyncGroup* pGroup = d->vecActiveSyncGroups[i];
-      FlowState state = pGroup->prepareProcess(d->vecSyncEvents);
+      FlowState state = pGroup->prepareProcess(d->vecSyncEvents, iExpiryTime);
 
       switch (state)
         {
         case ProcessableState:
           // Process this group.
           d->iActiveInputGroup = pGroup->groupId();
+          d->pProcessedGroup = pGroup;
           return ProcessableState;
         case SynchronizedState:
           return SynchronizedState;
@@ -556,6 +580,16 @@ PiiFlowController::FlowState PiiDefaultFlowController::prepareProcess()
   return IncompleteState;
 }
 
+bool PiiDefaultFlowController::shiftToBatch()
+{
+  PII_D;
+  SyncGroup* pGroup = d->pProcessedGroup;
+  if (pGroup == 0 || pGroup->hasChildGroups())
+    return false;
+  return shiftGroupToBatch(pGroup->begin(), pGroup->end(),
+                           pGroup->parentGroup() == 0 ? expiryTime() : 0);
+}
+
 bool PiiDefaultFlowController::hasSyncEvents() const
 {
   return _d()->vecSyncEvents.size() > 0;
@@ -142,6 +142,14 @@ public:
   static Relation looseRelation(int parent, int child);
 
   FlowState prepareProcess();
+  /**
+   * Extends the current batch if the group that was last prepared
+   * for processing has no child groups and the next objects in all of
+   * its inputs are ordinary objects. Processing a parent group
+   * changes the flow level of its children, which makes batching
+   * impossible.
+   */
+  bool shiftToBatch();
   bool hasSyncEvents() const;
   void sendSyncEvents(SyncListener* listener);
 
@@ -190,15 +198,22 @@ private:
 
     inline void shiftInputs();
     void sendTag();
+    void sendDropTag();
     void resume();
 
     void setSyncStartSent(bool sent) { _bSyncStartSent = sent; }
     bool isSyncStartSent() const { return _bSyncStartSent; }
 
     /**
-     * Prepares this group of sockets for processing.
+     * Returns `true` if this group is a parent of other groups.
      */
-    inline FlowState prepareProcess(QVector<SyncEvent>& syncEvents);
+    bool hasChildGroups() const { return !_lstChildGroups.isEmpty(); }
+
+    /**
+     * Prepares this group of sockets for processing. Groups whose
+     * objects were received before *expiryTime* will be dropped.
+     */
+    inline FlowState prepareProcess(QVector<SyncEvent>& syncEvents, qint64 expiryTime);
     /**
      * Outputs synchronized to this group.
      */
@@ -241,6 +256,12 @@ private:
      */
     QVector<SyncGroup*> vecActiveSyncGroups;
     QVector<SyncEvent> vecSyncEvents;
+    /**
+     * The group prepared for processing by the last prepareProcess()
+     * call, or 0 if the call returned something else than
+     * ProcessableState.
+     */
+    SyncGroup* pProcessedGroup;
 
     bool bStateChanged;
 
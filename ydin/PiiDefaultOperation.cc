@@ -22,13 +22,23 @@
 #include "PiiOneInputFlowController.h"
 #include "PiiOneGroupFlowController.h"
 #include "PiiNullInputController.h"
+#include "PiiOperationCompound.h"
+
+#include <PiiCpu.h>
+#include <PiiTimer.h>
 
 PiiDefaultOperation::Data::Data() :
   pFlowController(0), pProcessor(0),
   bChecked(false),
   processLock(PiiReadWriteLock::Recursive),
   iThreadCount(0),
-  threadingCapabilities(NonThreaded | SingleThreaded)
+  threadingCapabilities(NonThreaded | SingleThreaded),
+  iBatchSize(1), iMaxBatchSize(1),
+  iLatencyBudget(0),
+  schedulingClass(PiiScheduler::NormalClass),
+  bFused(false),
+  affinityMode(NoAffinity),
+  effectiveAffinityMode(NoAffinity)
 {
 }
 
@@ -53,6 +63,7 @@ PiiDefaultOperation::PiiDefaultOperation(Data* data) :
 void PiiDefaultOperation::init()
 {
   setProtectionLevel("threadCount", WriteWhenStoppedOrPaused);
+  setProtectionLevel("batchSize", WriteWhenStoppedOrPaused);
   createProcessor();
 }
 
@@ -63,7 +74,12 @@ PiiDefaultOperation::~PiiDefaultOperation()
 void PiiDefaultOperation::createProcessor()
 {
   PII_D;
-  delete d->pProcessor;
+  if (d->pProcessor != 0)
+    {
+      // Retain measurements collected by the old processor.
+      d->pProcessor->flushStatistics();
+      delete d->pProcessor;
+    }
   switch (d->iThreadCount)
     {
     case 0:
@@ -81,9 +97,18 @@ void PiiDefaultOperation::createProcessor()
 void PiiDefaultOperation::setThreadCount(int threadCount)
 {
   PII_D;
-  // No change after check()
+  // After check(), only the concurrency limit of a multi-threaded
+  // processor can be changed.
   if (d->bChecked)
-    return;
+    {
+      if (d->iThreadCount > 1 && threadCount > 1 &&
+          threadCount != d->iThreadCount && isAcceptableThreadCount(threadCount))
+        {
+          d->iThreadCount = threadCount;
+          d->pProcessor->threadCountChanged();
+        }
+      return;
+    }
 
   if (isAcceptableThreadCount(threadCount))
     {
@@ -115,6 +140,15 @@ void PiiDefaultOperation::setPriority(int priority)
 
 int PiiDefaultOperation::priority() const { return _d()->pProcessor->processingPriority(); }
 
+void PiiDefaultOperation::setSchedulingClass(int schedulingClass)
+{
+  _d()->schedulingClass = PiiScheduler::SchedulingClass(qBound(int(PiiScheduler::CriticalClass),
+                                                               schedulingClass,
+                                                               int(PiiScheduler::BackgroundClass)));
+}
+
+int PiiDefaultOperation::schedulingClass() const { return _d()->schedulingClass; }
+
 void PiiDefaultOperation::syncEvent(SyncEvent* /*event*/) {}
 
 void PiiDefaultOperation::interrupt()
@@ -138,6 +172,23 @@ void PiiDefaultOperation::check(bool reset)
   delete d->pFlowController;
   d->pFlowController = createFlowController();
 
+  // Inherit the latency budget from the closest parent that has one.
+  if (d->pFlowController != 0)
+    {
+      int iLatencyBudget = d->iLatencyBudget;
+      for (QObject* pParent = parent(); iLatencyBudget == 0 && pParent != 0; pParent = pParent->parent())
+#ifndef PII_NO_QT
+        iLatencyBudget = pParent->property("latencyBudget").toInt();
+#else
+        // PiiEngine, the usual source of the budget, needs Qt.
+        if (qobject_cast<PiiDefaultOperation*>(pParent) != 0)
+          iLatencyBudget = static_cast<PiiDefaultOperation*>(pParent)->latencyBudget();
+#endif
+      d->pFlowController->setLatencyBudget(iLatencyBudget);
+    }
+
+  resolveAffinity();
+
   // If the operation is disabled or there is no flow controller (no
   // connected inputs), disable input controller.
   PiiInputController* pController =
@@ -156,6 +207,56 @@ void PiiDefaultOperation::check(bool reset)
   d->bChecked = true;
 }
 
+void PiiDefaultOperation::resolveAffinity()
+{
+  PII_D;
+  // Take the hint from the closest parent if there is none.
+  AffinityMode mode = d->affinityMode;
+#ifndef PII_NO_QT
+  QVariantList lstTarget = d->lstAffinityTarget;
+  for (QObject* pParent = parent(); mode == NoAffinity && pParent != 0; pParent = pParent->parent())
+    {
+      mode = AffinityMode(pParent->property("affinityMode").toInt());
+      lstTarget = pParent->property("affinityTarget").toList();
+    }
+#else
+  QList<int> lstTarget = d->lstAffinityTarget;
+  for (QObject* pParent = parent(); mode == NoAffinity && pParent != 0; pParent = pParent->parent())
+    {
+      PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(pParent);
+      if (pCompound != 0)
+        {
+          mode = pCompound->affinityMode();
+          lstTarget = pCompound->affinityTarget();
+        }
+    }
+#endif
+
+  d->lstAffinityCpus.clear();
+  if (mode == CpuAffinity)
+    {
+      for (int i=0; i<lstTarget.size(); ++i)
+#ifndef PII_NO_QT
+        d->lstAffinityCpus << lstTarget[i].toInt();
+#else
+        d->lstAffinityCpus << lstTarget[i];
+#endif
+    }
+  else if (mode == NumaNodeAffinity)
+    {
+      for (int i=0; i<lstTarget.size(); ++i)
+#ifndef PII_NO_QT
+        d->lstAffinityCpus << Pii::numaNodeCpus(lstTarget[i].toInt());
+#else
+        d->lstAffinityCpus << Pii::numaNodeCpus(lstTarget[i]);
+#endif
+    }
+  // An empty list would mean no restriction.
+  if (d->lstAffinityCpus.isEmpty() && mode != ProducerAffinity)
+    mode = NoAffinity;
+  d->effectiveAffinityMode = mode;
+}
+
 PiiFlowController* PiiDefaultOperation::createFlowController()
 {
   PII_D;
@@ -252,6 +353,24 @@ bool PiiDefaultOperation::wait(unsigned long time)
   return _d()->pProcessor->wait(time);
 }
 
+#ifndef PII_NO_QT
+QVariantMap PiiDefaultOperation::statistics() const
+{
+  const PII_D;
+  d->pProcessor->flushStatistics();
+  QMutexLocker lock(&d->statisticsMutex);
+  return d->statistics.toMap();
+}
+#endif
+
+void PiiDefaultOperation::resetStatistics()
+{
+  PII_D;
+  d->pProcessor->flushStatistics();
+  QMutexLocker lock(&d->statisticsMutex);
+  d->statistics.clear();
+}
+
 int PiiDefaultOperation::activeInputGroup() const
 {
   return _d()->pProcessor->activeInputGroup();
@@ -267,6 +386,7 @@ PiiReadWriteLock* PiiDefaultOperation::processLock()
   return &_d()->processLock;
 }
 
+#ifndef PII_NO_QT
 bool PiiDefaultOperation::setProperty(const char* name, const QVariant& value)
 {
   PiiWriteLocker lock(&_d()->processLock);
@@ -279,6 +399,13 @@ QVariant PiiDefaultOperation::property(const char* name) const
   return PiiBasicOperation::property(name);
 }
 
+QVariantList PiiDefaultOperation::propertyValues(const QVector<int>& indices) const
+{
+  PiiReadLocker lock(&_d()->processLock);
+  return PiiBasicOperation::propertyValues(indices);
+}
+#endif
+
 void PiiDefaultOperation::setThreadingCapabilities(ThreadingCapabilities threadingCapabilities)
 {
   PII_D;
@@ -305,3 +432,55 @@ PiiDefaultOperation::ThreadingCapabilities PiiDefaultOperation::threadingCapabil
 {
   return _d()->threadingCapabilities;
 }
+
+void PiiDefaultOperation::setBatchSize(int batchSize)
+{
+  PII_D;
+  d->iBatchSize = qBound(1, batchSize, d->iMaxBatchSize);
+}
+
+int PiiDefaultOperation::batchSize() const { return _d()->iBatchSize; }
+
+void PiiDefaultOperation::setMaxBatchSize(int maxBatchSize)
+{
+  PII_D;
+  d->iMaxBatchSize = qMax(1, maxBatchSize);
+  if (d->iBatchSize > d->iMaxBatchSize)
+    d->iBatchSize = d->iMaxBatchSize;
+}
+
+int PiiDefaultOperation::maxBatchSize() const { return _d()->iMaxBatchSize; }
+
+void PiiDefaultOperation::setAffinityMode(AffinityMode affinityMode) { _d()->affinityMode = affinityMode; }
+PiiOperation::AffinityMode PiiDefaultOperation::affinityMode() const { return _d()->affinityMode; }
+#ifndef PII_NO_QT
+void PiiDefaultOperation::setAffinityTarget(const QVariantList& affinityTarget) { _d()->lstAffinityTarget = affinityTarget; }
+QVariantList PiiDefaultOperation::affinityTarget() const { return _d()->lstAffinityTarget; }
+#else
+void PiiDefaultOperation::setAffinityTarget(const QList<int>& affinityTarget) { _d()->lstAffinityTarget = affinityTarget; }
+QList<int> PiiDefaultOperation::affinityTarget() const { return _d()->lstAffinityTarget; }
+#endif
+
+void PiiDefaultOperation::setLatencyBudget(int latencyBudget) { _d()->iLatencyBudget = qMax(0, latencyBudget); }
+int PiiDefaultOperation::latencyBudget() const { return _d()->iLatencyBudget; }
+
+/* The oldest known origin among the objects to be processed. An
+ * operation without connected inputs is a source, and its objects
+ * originate from the processing round itself.
+ */
+qint64 PiiDefaultOperation::inputOriginTime() const
+{
+  bool bConnected = false;
+  qint64 iOriginTime = 0;
+  for (int i=inputCount(); i--; )
+    {
+      PiiInputSocket* pInput = inputAt(i);
+      if (!pInput->isConnected())
+        continue;
+      bConnected = true;
+      qint64 iInputTime = pInput->originTime();
+      if (iInputTime != 0 && (iOriginTime == 0 || iInputTime < iOriginTime))
+        iOriginTime = iInputTime;
+    }
+  return bConnected ? iOriginTime : PiiTimer::timestamp();
+}
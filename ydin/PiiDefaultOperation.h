@@ -21,6 +21,8 @@
 #include <PiiReadWriteLock.h>
 #include "PiiBasicOperation.h"
 #include "PiiFlowController.h"
+#include "PiiOperationStatistics.h"
+#include "PiiScheduler.h"
 
 class PiiOperationProcessor;
 
@@ -62,10 +64,12 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    * [process()], [syncEvent()] is always the same, and no concurrent
    * calls will be made.
    *
-   * if `threadCount` is greater than one, a pool of threads will be
-   * created. The system ensures that [syncEvent()] and setProperty()
-   * are always called in isolation, but calls to [process()] may
-   * happen simultaneously in any of these threads.
+   * if `threadCount` is greater than one, processing rounds will be
+   * executed in threads borrowed from the application-wide
+   * PiiThreadPool, and at most `threadCount` rounds will run
+   * concurrently. The system ensures that [syncEvent()] and
+   * setProperty() are always called in isolation, but calls to
+   * [process()] may happen simultaneously in any of these threads.
    *
    * ! If `threadCount` is larger than one, special attention is
    * required. If the state of the operation is altered in [process()],
@@ -85,7 +89,11 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    * either stopped or paused, and only before [check()]. Setting the
    * value in other situations has no effect. Furthermore, some
    * derived operations may disable changes to the property
-   * altogether.
+   * altogether. As an exception, a value larger than one can be
+   * changed to another value larger than one at any time. An
+   * increase takes effect immediately; a decrease as soon as enough
+   * running rounds have finished. This makes it possible for
+   * PiiThreadBalancer to adjust the value at run time.
    */
   Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount);
 
@@ -108,6 +116,19 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    */
   Q_PROPERTY(int priority READ priority WRITE setPriority);
 
+  /**
+   * The scheduling class of the operation's processing rounds. Use
+   * PiiScheduler::SchedulingClass as the value. When there are more
+   * runnable rounds than processor cores, PiiScheduler lets critical
+   * rounds run first and holds back background rounds for a bounded
+   * time. Unlike [priority], the scheduling class works the same way
+   * on all platforms. The default value is
+   * PiiScheduler::NormalClass. Like [priority], this value has no
+   * effect on non-threaded operations, which run as part of the
+   * sending operation's round.
+   */
+  Q_PROPERTY(int schedulingClass READ schedulingClass WRITE setSchedulingClass);
+
   /**
    * This property lists the threading modes the operation is allowed
    * to run in. The default value is `NonThreaded |
@@ -118,6 +139,90 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
   Q_PROPERTY(ThreadingCapabilities threadingCapabilities READ threadingCapabilities);
   Q_FLAGS(ThreadingCapabilities);
 
+  /**
+   * The maximum number of synchronized input object sets passed to a
+   * single [process()] call. The default value is one, which means
+   * each processing round handles exactly one object in each input.
+   *
+   * If `batchSize` is larger than one, the processor collects as many
+   * sets of input objects as are readily available in the input
+   * queues, up to `batchSize`, and calls process() once for all of
+   * them. The objects can be retrieved with
+   * PiiInputSocket::batchObject(), and process() must emit the
+   * results of each set in order. Operations that can process many
+   * objects at once more efficiently than one at a time (e.g.
+   * classifiers that vectorize distance calculations) benefit from
+   * batching when they fall behind their input. The processor never
+   * waits for a batch to fill up, and a batch never extends over a
+   * synchronization tag. To allow large batches, the
+   * [queueCapacity](PiiInputSocket::queueCapacity) of the inputs must
+   * be increased accordingly.
+   *
+   * Batching must be supported by the operation. The value cannot
+   * exceed the limit set by the subclass with setMaxBatchSize(),
+   * which is one by default. Batching is only used in the
+   * non-threaded and single-threaded modes; multi-threaded operations
+   * ignore this value. Like [threadCount], the batch size can only be
+   * changed when the operation is stopped or paused.
+   */
+  Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize);
+
+  /**
+   * The maximum time, in milliseconds, an input object may wait in
+   * the input queue of this operation. If an object at the head of a
+   * queue is older than this when the operation is about to process
+   * it, the whole set of synchronized input objects is discarded and
+   * a drop tag (PiiYdin::DropTagType) is sent to the synchronized
+   * outputs instead. Downstream operations pass drop tags on without
+   * processing, which keeps the number of emitted objects in sync
+   * throughout the pipeline. This makes it possible to shed load
+   * instead of falling ever more behind when a pipeline temporarily
+   * cannot keep up with its source.
+   *
+   * Only input groups that have neither parent nor child groups are
+   * subject to the budget. The budget is applied separately in each
+   * operation; it is not an end-to-end limit.
+   *
+   * Zero means no budget of its own. In that case, the first
+   * non-zero `latencyBudget` property of the parent operations (e.g.
+   * PiiEngine::latencyBudget) will be used. The default value is
+   * zero. Changes take effect in the next [check()].
+   */
+  Q_PROPERTY(int latencyBudget READ latencyBudget WRITE setLatencyBudget);
+
+  /**
+   * A hint for placing the processing threads of the operation. On
+   * multi-socket systems, a thread that processes data produced on
+   * another socket spends much of its time waiting for remote memory.
+   * Pinning the processing threads to the socket (NUMA node) of the
+   * producer keeps the traffic local. PiiMatrixPool allocates pooled
+   * matrices from the memory of the node the allocating thread is
+   * running on.
+   *
+   * ~~~(c++)
+   * // Process camera frames on the node the camera driver runs on.
+   * camera->setProperty("affinityMode", PiiOperation::NumaNodeAffinity);
+   * camera->setProperty("affinityTarget", QVariantList() << 0);
+   * filter->setProperty("affinityMode", PiiOperation::ProducerAffinity);
+   * ~~~
+   *
+   * If the value is `NoAffinity` (the default), the hint of the
+   * closest parent compound that has one (see
+   * PiiOperationCompound::affinityMode) will be used. The hint has no
+   * effect on non-threaded operations, which always run in the
+   * thread of the producer. It is also ignored on platforms that
+   * don't support thread affinity (see Pii::setThreadAffinity()).
+   * Changes take effect in the next [check()].
+   */
+  Q_PROPERTY(AffinityMode affinityMode READ affinityMode WRITE setAffinityMode);
+
+  /**
+   * The CPUs (`CpuAffinity`) or NUMA nodes (`NumaNodeAffinity`) the
+   * processing threads are restricted to, as a list of indices.
+   * Ignored with other [affinityMode] values.
+   */
+  Q_PROPERTY(QVariantList affinityTarget READ affinityTarget WRITE setAffinityTarget);
+
 public:
   typedef PiiFlowController::SyncEvent SyncEvent;
 
@@ -140,6 +245,7 @@ public:
   PiiDefaultOperation();
   ~PiiDefaultOperation();
 
+#ifndef PII_NO_QT
   /**
    * Ensures that no property will be set while process() or
    * syncEvent() is being called by acquiring [processLock()] for
@@ -152,6 +258,13 @@ public:
    */
   QVariant property(const char* name) const;
 
+  /**
+   * Acquires [processLock()] for reading once and returns all of the
+   * properties.
+   */
+  QVariantList propertyValues(const QVector<int>& indices) const;
+#endif
+
   /**
    * Checks the operation for execution. This function creates a
    * suitable flow controller by calling [createFlowController()]. It
@@ -213,6 +326,17 @@ public:
    */
   bool wait(unsigned long time = ULONG_MAX);
 
+#ifndef PII_NO_QT
+  /**
+   * Returns the timing statistics of the processing rounds as
+   * described in PiiOperationStatistics::toMap(). Measurements are
+   * collected in all processing modes.
+   */
+  QVariantMap statistics() const;
+#endif
+
+  void resetStatistics();
+
 protected:
   /// @internal
   class PII_YDIN_EXPORT Data : public PiiBasicOperation::Data
@@ -223,9 +347,11 @@ protected:
 
   private:
     friend class PiiDefaultOperation;
+    friend class PiiOperationProcessor;
     friend class PiiSimpleProcessor;
     friend class PiiThreadedProcessor;
     friend class PiiMultiThreadedProcessor;
+    friend class PiiOperationCompound;
 
     // Handles object flow. Synchronizes inputs etc.
     PiiFlowController* pFlowController;
@@ -241,6 +367,25 @@ protected:
     mutable PiiReadWriteLock processLock;
     int iThreadCount;
     ThreadingCapabilities threadingCapabilities;
+    int iBatchSize, iMaxBatchSize;
+    int iLatencyBudget;
+    PiiScheduler::SchedulingClass schedulingClass;
+    // True if the operation is fused to the preceding one.
+    bool bFused;
+    AffinityMode affinityMode;
+#ifndef PII_NO_QT
+    QVariantList lstAffinityTarget;
+#else
+    QList<int> lstAffinityTarget;
+#endif
+    // Resolved in check(). lstAffinityCpus is used with Cpu and
+    // NumaNode affinity.
+    AffinityMode effectiveAffinityMode;
+    QList<int> lstAffinityCpus;
+
+    // Merged measurements from all processing threads.
+    PiiOperationStatistics statistics;
+    mutable QMutex statisticsMutex;
   };
   PII_D_FUNC;
 
@@ -253,9 +398,37 @@ protected:
   void setPriority(int priority);
   int priority() const;
 
+  void setSchedulingClass(int schedulingClass);
+  int schedulingClass() const;
+
   void setThreadingCapabilities(ThreadingCapabilities threadingCapabilities);
   ThreadingCapabilities threadingCapabilities() const;
 
+  void setBatchSize(int batchSize);
+  int batchSize() const;
+
+  void setLatencyBudget(int latencyBudget);
+  int latencyBudget() const;
+
+  void setAffinityMode(AffinityMode affinityMode);
+  AffinityMode affinityMode() const;
+#ifndef PII_NO_QT
+  void setAffinityTarget(const QVariantList& affinityTarget);
+  QVariantList affinityTarget() const;
+#else
+  void setAffinityTarget(const QList<int>& affinityTarget);
+  QList<int> affinityTarget() const;
+#endif
+
+  /**
+   * Sets the largest [batchSize] the operation can handle. Subclasses
+   * that process all objects in PiiInputSocket::batchObject() should
+   * raise the limit in their constructor. The default value is one,
+   * which disables batching.
+   */
+  void setMaxBatchSize(int maxBatchSize);
+  int maxBatchSize() const;
+
   /**
    * Executes one round of processing. This function is invoked by the
    * processor if the necessary preconditions for a new processing
@@ -277,6 +450,8 @@ protected:
    * @exception PiiExecutionException whenever an unrecoverable error
    * occurs during a processing round, the operation is interrupted,
    * or finishes execution due to end of input data.
+   *
+   * @see batchSize
    */
   virtual void process() = 0;
 
@@ -381,18 +556,24 @@ protected:
 
 private:
   void init();
+  void resolveAffinity();
   void createProcessor();
 
+  friend class PiiOperationProcessor;
   friend class PiiSimpleProcessor;
   friend class PiiThreadedProcessor;
   friend class PiiMultiThreadedProcessor;
+  friend class PiiOperationCompound;
 
   inline void processLocked()
   {
     PiiReadLocker lock(&_d()->processLock);
+    PiiYdin::setCurrentOriginTime(inputOriginTime());
     process();
   }
 
+  qint64 inputOriginTime() const;
+
   inline void sendSyncEvents(PiiFlowController* controller)
   {
     PiiReadLocker lock(&_d()->processLock);
@@ -400,6 +581,8 @@ private:
   }
 
   inline bool isAcceptableThreadCount(int threadCount) const;
+
+  friend class PiiThreadBalancer;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(PiiDefaultOperation::ThreadingCapabilities);
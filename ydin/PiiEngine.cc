@@ -19,14 +19,22 @@
 #include <PiiUtil.h>
 #include <PiiFileUtil.h>
 #include "PiiPlugin.h"
+#include "PiiProfiler.h"
+#include "PiiThreadBalancer.h"
+#include <PiiMatrixPool.h>
 #include <PiiGenericTextOutputArchive.h>
 #include <PiiGenericBinaryOutputArchive.h>
 #include <PiiGenericTextInputArchive.h>
 #include <PiiGenericBinaryInputArchive.h>
+#include <PiiSerializationFactory.h>
+#include <PiiSerializationException.h>
+#include <PiiSynchronized.h>
+#include <PiiTimer.h>
 
 #include <QLibrary>
 #include <QFile>
 #include <QFileInfo>
+#include <QTextStream>
 
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiEngine)
 PII_SERIALIZABLE_EXPORT(PiiEngine);
@@ -36,6 +44,9 @@ static int iPluginMetaType = qRegisterMetaType<PiiEngine::Plugin>("PiiEngine::Pl
 
 PiiEngine::PluginMap PiiEngine::_pluginMap;
 QMutex PiiEngine::_pluginLock;
+QHash<QString,QString> PiiEngine::_pluginIndex;
+QHash<QString,qint64> PiiEngine::_pluginLoadTimes;
+QVariantMap PiiEngine::_mapLastLoadTimes;
 
 class PiiEngine::Plugin::Data
 {
@@ -51,7 +62,24 @@ public:
 } *d;
 
 
-PiiEngine::PiiEngine()
+PiiEngine::Data::Data() :
+  pProfiler(0),
+  bMatrixPoolEnabled(false),
+  bUsingMatrixPool(false),
+  iLatencyBudget(0),
+  iThreadBudget(0),
+  pThreadBalancer(0)
+{}
+
+PiiEngine::Data::~Data()
+{
+  delete pThreadBalancer;
+  delete pProfiler;
+  qDeleteAll(lstRetiredProfilers);
+}
+
+PiiEngine::PiiEngine() :
+  PiiOperationCompound(new Data)
 {
   Q_UNUSED(iEngineMetaType); // suppresses compiler warning
   Q_UNUSED(iPluginMetaType);
@@ -70,7 +98,12 @@ PiiEngine::PiiEngine(Data* data) : PiiOperationCompound(data)
 {}
 
 PiiEngine::~PiiEngine()
-{}
+{
+  stopProfiling();
+  PII_D;
+  if (d->bUsingMatrixPool)
+    PiiMatrixPool::removeUser();
+}
 
 void PiiEngine::execute(ErrorHandling errorHandling)
 {
@@ -93,6 +126,128 @@ void PiiEngine::execute(ErrorHandling errorHandling)
     }
 }
 
+static void setProfiledNames(PiiProfiler* profiler, PiiOperationCompound* compound)
+{
+  QList<PiiOperation*> lstOperations(compound->childOperations());
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      profiler->setOperationName(lstOperations[i], lstOperations[i]->fullName());
+      if (lstOperations[i]->isCompound())
+        setProfiledNames(profiler, static_cast<PiiOperationCompound*>(lstOperations[i]));
+    }
+}
+
+void PiiEngine::startProfiling(int capacity)
+{
+  PII_D;
+  stopProfiling();
+  // Processing threads may still be recording to the old profiler.
+  // Therefore, it cannot be deleted before the engine is.
+  if (d->pProfiler == 0 || d->pProfiler->capacity() < capacity)
+    {
+      if (d->pProfiler != 0)
+        d->lstRetiredProfilers << d->pProfiler;
+      d->pProfiler = new PiiProfiler(capacity);
+    }
+  else
+    d->pProfiler->clear();
+  setProfiledNames(d->pProfiler, this);
+  PiiProfiler::setActiveProfiler(d->pProfiler);
+}
+
+void PiiEngine::stopProfiling()
+{
+  if (isProfiling())
+    PiiProfiler::setActiveProfiler(0);
+}
+
+bool PiiEngine::isProfiling() const
+{
+  const PII_D;
+  return d->pProfiler != 0 && PiiProfiler::activeProfiler() == d->pProfiler;
+}
+
+PiiProfiler* PiiEngine::profiler() const
+{
+  return _d()->pProfiler;
+}
+
+void PiiEngine::saveProfile(const QString& fileName) const
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly))
+    PII_THROW(PiiException, tr("Cannot open %1 for writing.").arg(fileName));
+  if (_d()->pProfiler != 0)
+    _d()->pProfiler->writeChromeTrace(&file);
+  else
+    PiiProfiler(1).writeChromeTrace(&file);
+}
+
+void PiiEngine::setMatrixPoolEnabled(bool matrixPoolEnabled)
+{
+  _d()->bMatrixPoolEnabled = matrixPoolEnabled;
+}
+
+bool PiiEngine::isMatrixPoolEnabled() const
+{
+  return _d()->bMatrixPoolEnabled;
+}
+
+void PiiEngine::setLatencyBudget(int latencyBudget)
+{
+  _d()->iLatencyBudget = qMax(0, latencyBudget);
+}
+
+int PiiEngine::latencyBudget() const
+{
+  return _d()->iLatencyBudget;
+}
+
+void PiiEngine::setThreadBudget(int threadBudget)
+{
+  _d()->iThreadBudget = threadBudget;
+}
+
+int PiiEngine::threadBudget() const
+{
+  return _d()->iThreadBudget;
+}
+
+void PiiEngine::aboutToChangeState(State newState)
+{
+  PII_D;
+  PiiOperationCompound::aboutToChangeState(newState);
+  if (newState == Starting && d->bMatrixPoolEnabled && !d->bUsingMatrixPool)
+    {
+      PiiMatrixPool::addUser();
+      d->bUsingMatrixPool = true;
+    }
+  else if (newState == Stopped && d->bUsingMatrixPool)
+    {
+      PiiMatrixPool::removeUser();
+      d->bUsingMatrixPool = false;
+    }
+
+  if (newState == Starting)
+    {
+      // The previous balancer has been asked to stop already.
+      delete d->pThreadBalancer;
+      d->pThreadBalancer = 0;
+      if (d->iThreadBudget != 0)
+        {
+          d->pThreadBalancer = new PiiThreadBalancer(this, d->iThreadBudget > 0 ?
+                                                     d->iThreadBudget :
+                                                     QThread::idealThreadCount());
+          if (d->pThreadBalancer->operationCount() > 0)
+            d->pThreadBalancer->start();
+        }
+    }
+  // This may be called from a processing thread. Don't wait for the
+  // balancer here.
+  else if (newState not_member_of (Running, Paused) && d->pThreadBalancer != 0)
+    d->pThreadBalancer->stop();
+}
+
 void PiiEngine::loadPlugins(const QStringList& plugins)
 {
   for (int i=0; i<plugins.size(); ++i)
@@ -139,6 +294,8 @@ PiiEngine::Plugin PiiEngine::loadPlugin(const QString& name)
     QLibrary* pLib;
   };
 
+  PiiTimer loadTimer;
+
   // Load library
   Unloader unloader(new QLibrary(pluginNameToPath(name)));
 
@@ -175,6 +332,7 @@ PiiEngine::Plugin PiiEngine::loadPlugin(const QString& name)
   unloader.pLib->setObjectName(name);
   Plugin plugin(unloader.release(), (*pNameFunc)(), pluginVersion);
   _pluginMap.insert(name, plugin);
+  _pluginLoadTimes.insert(name, loadTimer.microseconds());
 
   return plugin;
 }
@@ -193,6 +351,7 @@ int PiiEngine::unloadPlugin(const QString& name, bool force)
 
   // Remove the plug-in from our map.
   Plugin plugin = _pluginMap.take(name);
+  _pluginLoadTimes.remove(name);
   plugin.d->pLibrary->unload();
   delete plugin.d->pLibrary;
   return 0;
@@ -339,9 +498,14 @@ void PiiEngine::save(const QString& fileName,
     }
   else
     {
-      PiiGenericBinaryOutputArchive oa(&file);
-      oa << PII_NVP("config", mapConfig);
-      oa << PII_NVP("engine", this);
+      {
+        PiiGenericBinaryOutputArchive oa(&file);
+        oa << PII_NVP("config", mapConfig);
+        oa << PII_NVP("engine", this);
+      }
+      // The archive writes buffered data when destroyed.
+      if (file.error() != QFile::NoError)
+        PII_THROW(PiiException, tr("Cannot write to %1.").arg(fileName));
     }
 }
 
@@ -358,37 +522,166 @@ void PiiEngine::ensurePlugins(const QStringList& plugins)
       PiiEngine::loadPlugin(strPlugin);
 }
 
+template <class Archive>
+static PiiEngine* readEngine(QFile* file, QVariantMap& config, bool lazy, qint64* configTime)
+{
+  PiiTimer timer;
+  Archive ia(file);
+  PiiEngine* pEngine = 0;
+  ia >> PII_NVP("config", config);
+  *configTime = timer.microseconds();
+  QStringList lstPlugins(config["plugins"].toStringList());
+
+  if (!lazy)
+    {
+      PiiEngine::ensurePlugins(lstPlugins);
+      ia >> PII_NVP("engine", pEngine);
+      return pEngine;
+    }
+
+  try
+    {
+      // Plug-ins will be loaded on demand by the factory resolver.
+      ia >> PII_NVP("engine", pEngine);
+      return pEngine;
+    }
+  catch (PiiSerializationException&)
+    {
+      // The index may be out of date. If some of the listed plug-ins
+      // are not loaded yet, load them all and try again.
+      bool bAllLoaded = true;
+      foreach (QString strPlugin, lstPlugins)
+        if (!PiiEngine::isLoaded(strPlugin))
+          {
+            bAllLoaded = false;
+            break;
+          }
+      if (bAllLoaded)
+        throw;
+    }
+  file->seek(0);
+  return readEngine<Archive>(file, config, false, configTime);
+}
+
 PiiEngine* PiiEngine::load(const QString& fileName,
                            QVariantMap* config)
 {
+  PiiTimer totalTimer;
   QFile file(fileName);
   if (!file.open(QIODevice::ReadOnly))
     PII_THROW(PiiException, tr("Cannot open %1 for reading.").arg(fileName));
+
+  QStringList lstOldPlugins(pluginLibraryNames());
+  bool bLazy = false;
+  synchronized (_pluginLock) bLazy = !_pluginIndex.isEmpty();
+
   PiiEngine* pEngine = 0;
   QVariantMap mapConfig;
+  qint64 iConfigTime = 0;
   if (file.peek(PII_TEXT_ARCHIVE_ID_LEN) == PII_TEXT_ARCHIVE_ID)
-    {
-      PiiGenericTextInputArchive ia(&file);
-      ia >> PII_NVP("config", mapConfig);
-      ensurePlugins(mapConfig["plugins"].toStringList());
-      ia >> PII_NVP("engine", pEngine);
-    }
+    pEngine = readEngine<PiiGenericTextInputArchive>(&file, mapConfig, bLazy, &iConfigTime);
   else if (file.peek(PII_BINARY_ARCHIVE_ID_LEN) == PII_BINARY_ARCHIVE_ID)
-    {
-      PiiGenericBinaryInputArchive ia(&file);
-      ia >> PII_NVP("config", mapConfig);
-      ensurePlugins(mapConfig["plugins"].toStringList());
-      ia >> PII_NVP("engine", pEngine);
-    }
+    pEngine = readEngine<PiiGenericBinaryInputArchive>(&file, mapConfig, bLazy, &iConfigTime);
   else
     PII_SERIALIZATION_ERROR(UnrecognizedArchiveFormat);
 
   if (config != 0)
     *config = mapConfig;
 
+  qint64 iTotalTime = totalTimer.microseconds(), iPluginTime = 0;
+  QVariantMap mapPluginTimes;
+  synchronized (_pluginLock)
+    {
+      for (PluginMap::const_iterator i = _pluginMap.constBegin(); i != _pluginMap.constEnd(); ++i)
+        if (!lstOldPlugins.contains(i.key()))
+          {
+            qint64 iTime = _pluginLoadTimes.value(i.key());
+            mapPluginTimes[i.key()] = iTime;
+            iPluginTime += iTime;
+          }
+      _mapLastLoadTimes.clear();
+      _mapLastLoadTimes["total"] = iTotalTime;
+      _mapLastLoadTimes["config"] = iConfigTime;
+      _mapLastLoadTimes["plugins"] = iPluginTime;
+      _mapLastLoadTimes["engine"] = qMax(iTotalTime - iConfigTime - iPluginTime, qint64(0));
+      _mapLastLoadTimes["pluginTimes"] = mapPluginTimes;
+    }
+
   return pEngine;
 }
 
+QVariantMap PiiEngine::lastLoadTimes()
+{
+  QMutexLocker lock(&_pluginLock);
+  return _mapLastLoadTimes;
+}
+
+void PiiEngine::savePluginIndex(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    PII_THROW(PiiException, tr("Cannot open %1 for writing.").arg(fileName));
+
+  QMutexLocker lock(&_pluginLock);
+  QTextStream out(&file);
+  out << "# Into plug-in index " << INTO_VERSION_STR << "\n";
+  for (PluginMap::const_iterator i = _pluginMap.constBegin(); i != _pluginMap.constEnd(); ++i)
+    {
+      // In the resource database, the parent resource of a
+      // registered class is the plugin it came from.
+      QList<QString> lstClasses = PiiYdin::resourceDatabase()->
+        select(Pii::subject,
+               Pii::object == i.value().resourceName() &&
+               Pii::predicate == PiiYdin::parentPredicate);
+      foreach (QString strClass, lstClasses)
+        out << strClass << '\t' << i.key() << '\n';
+    }
+}
+
+void PiiEngine::loadPluginIndex(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    PII_THROW(PiiException, tr("Cannot open %1 for reading.").arg(fileName));
+
+  QHash<QString,QString> index;
+  QTextStream in(&file);
+  while (!in.atEnd())
+    {
+      QString strLine(in.readLine());
+      if (strLine.isEmpty() || strLine.startsWith('#'))
+        continue;
+      QStringList lstParts(strLine.split('\t'));
+      if (lstParts.size() == 2)
+        index.insert(lstParts[0], lstParts[1]);
+    }
+
+  synchronized (_pluginLock) _pluginIndex = index;
+  PiiSerializationFactory::setResolver(resolveClass);
+}
+
+void PiiEngine::clearPluginIndex()
+{
+  synchronized (_pluginLock) _pluginIndex.clear();
+  if (PiiSerializationFactory::resolver() == resolveClass)
+    PiiSerializationFactory::setResolver(0);
+}
+
+QString PiiEngine::indexedPlugin(const QString& className)
+{
+  QMutexLocker lock(&_pluginLock);
+  return _pluginIndex.value(className);
+}
+
+bool PiiEngine::resolveClass(const char* className)
+{
+  QString strPlugin(indexedPlugin(className));
+  if (strPlugin.isEmpty() || isLoaded(strPlugin))
+    return false;
+  loadPlugin(strPlugin);
+  return true;
+}
+
 static QString* pluginPathPtr()
 {
   static QString strPluginPath;
@@ -25,6 +25,8 @@
 #include "PiiOperationCompound.h"
 
 class QLibrary;
+class PiiProfiler;
+class PiiThreadBalancer;
 
 /**
  * An execution engine. The task of PiiEngine is to handle the
@@ -73,6 +75,37 @@ class PII_YDIN_EXPORT PiiEngine : public PiiOperationCompound
 {
   Q_OBJECT
 
+  /**
+   * Enables pooling of matrix buffers while the engine is running.
+   * If this flag is `true`, the engine becomes a user of
+   * PiiMatrixPool when it starts and stops using it when it is
+   * stopped. Pooling reduces heap traffic in pipelines that
+   * repeatedly allocate large, equally sized images. The default
+   * value is `false`.
+   */
+  Q_PROPERTY(bool matrixPoolEnabled READ isMatrixPoolEnabled WRITE setMatrixPoolEnabled);
+
+  /**
+   * The default [latencyBudget](PiiDefaultOperation::latencyBudget),
+   * in milliseconds, for all operations in the engine that don't
+   * have a budget of their own. The default value is zero, which
+   * disables load shedding.
+   */
+  Q_PROPERTY(int latencyBudget READ latencyBudget WRITE setLatencyBudget);
+
+  /**
+   * The total number of threads the engine may give to operations
+   * running in `MultiThreaded` mode. If this value is non-zero, the
+   * engine starts a PiiThreadBalancer that moves threads between
+   * such operations at run time to keep the pipeline balanced. Only
+   * operations whose [threadCount](PiiDefaultOperation::threadCount)
+   * is at least two at start-up are managed. A negative value means
+   * the number of processor cores. The default value is zero, which
+   * leaves thread counts alone. Changes take effect the next time
+   * the engine is started.
+   */
+  Q_PROPERTY(int threadBudget READ threadBudget WRITE setThreadBudget);
+
   Q_ENUMS(FileFormat ErrorHandling)
 
   friend struct PiiSerialization::Accessor;
@@ -244,6 +277,86 @@ public:
    */
   static QStringList pluginResourceNames();
 
+  /**
+   * Writes an index of all classes registered by the currently loaded
+   * plug-ins into *fileName*. Each line of the index maps a class
+   * name to the library name of the plug-in that registers it. The
+   * index is typically generated once at build or installation time
+   * by loading all plug-ins and calling this function.
+   *
+   * ~~~(c++)
+   * PiiEngine::loadPlugins(QStringList() << "piibase" << "piiimage" << "piiflowcontrol");
+   * PiiEngine::savePluginIndex("plugins.idx");
+   * ~~~
+   *
+   * @exception PiiException& if *fileName* cannot be opened for
+   * writing
+   *
+   * @see loadPluginIndex()
+   */
+  static void savePluginIndex(const QString& fileName);
+
+  /**
+   * Reads a plug-in index written by [savePluginIndex()] and enables
+   * lazy plug-in loading. Once an index is in use, [load()] no longer
+   * loads all plug-ins listed in the configuration of a stored
+   * engine. Instead, a plug-in is loaded only when the archive refers
+   * to a class the index maps to it. If the engine cannot be read
+   * this way (e.g. because the index is out of date), [load()] falls
+   * back to loading all listed plug-ins.
+   *
+   * Note that a plug-in that registers no class referenced in the
+   * archive by name will not be loaded. Such plug-ins must be loaded
+   * explicitly.
+   *
+   * ~~~(c++)
+   * PiiEngine::loadPluginIndex("plugins.idx");
+   * // Only opens the libraries that are actually needed
+   * PiiEngine* pEngine = PiiEngine::load("inspection.cft");
+   * ~~~
+   *
+   * @exception PiiException& if *fileName* cannot be opened for
+   * reading
+   */
+  static void loadPluginIndex(const QString& fileName);
+
+  /**
+   * Discards the plug-in index and disables lazy plug-in loading.
+   */
+  static void clearPluginIndex();
+
+  /**
+   * Returns the library name the plug-in index maps *className* to,
+   * or an empty string if the class is not in the index.
+   */
+  static QString indexedPlugin(const QString& className);
+
+  /**
+   * Returns a breakdown of the time spent in the most recent call to
+   * [load()]. All times are in microseconds. The returned map
+   * contains the following keys:
+   *
+   * - `total` - the total time spent in [load()].
+   *
+   * - `config` - the time spent reading the configuration map.
+   *
+   * - `plugins` - the time spent loading and initializing plug-ins
+   * that were not loaded before.
+   *
+   * - `engine` - the time spent deserializing the engine, excluding
+   * plug-in loading.
+   *
+   * - `pluginTimes` - a QVariantMap that maps the library name of
+   * each newly loaded plug-in to its load time.
+   *
+   * ~~~(c++)
+   * PiiEngine* pEngine = PiiEngine::load("inspection.cft");
+   * QVariantMap mapTimes(PiiEngine::lastLoadTimes());
+   * qDebug("Engine loaded in %d us", mapTimes["total"].toInt());
+   * ~~~
+   */
+  static QVariantMap lastLoadTimes();
+
   /**
    * Returns the library names of the plug-ins that are needed by this
    * engine, including all of its child operations. This is generally
@@ -349,17 +462,101 @@ public:
   static PiiEngine* load(const QString& fileName,
                          QVariantMap* config = 0);
 
+  /**
+   * Starts recording a timeline of the processing rounds of all
+   * operations in the engine. The timeline is stored in a ring
+   * buffer that holds at most *capacity* rounds. Once the buffer is
+   * full, the oldest rounds will be overwritten. Any previously
+   * recorded timeline will be discarded. Profiling can be started
+   * and stopped while the engine is running.
+   *
+   * Only one engine can be profiled at a time. Starting profiling
+   * stops profiling the engine that was previously profiled.
+   *
+   * ~~~(c++)
+   * engine.startProfiling();
+   * engine.execute();
+   * QThread::sleep(30);
+   * engine.stopProfiling();
+   * engine.saveProfile("pipeline.json");
+   * ~~~
+   *
+   * @see PiiProfiler
+   */
+  Q_INVOKABLE void startProfiling(int capacity = 65536);
+
+  /**
+   * Stops recording the timeline. The recorded timeline will be
+   * retained until profiling is restarted.
+   */
+  Q_INVOKABLE void stopProfiling();
+
+  /**
+   * Returns `true` if the engine is currently being profiled.
+   */
+  Q_INVOKABLE bool isProfiling() const;
+
+  /**
+   * Saves the recorded timeline to *fileName* in the Chrome trace
+   * event format. The file can be opened with `chrome://tracing` or
+   * the Perfetto UI. If nothing has been recorded, the file will
+   * contain an empty trace.
+   *
+   * @exception PiiException& if *fileName* cannot be opened for
+   * writing
+   */
+  Q_INVOKABLE void saveProfile(const QString& fileName) const;
+
+  /**
+   * Returns the profiler that stores the recorded timeline, or zero
+   * if profiling has never been started.
+   */
+  PiiProfiler* profiler() const;
+
+  void setMatrixPoolEnabled(bool matrixPoolEnabled);
+  bool isMatrixPoolEnabled() const;
+  void setLatencyBudget(int latencyBudget);
+  int latencyBudget() const;
+  void setThreadBudget(int threadBudget);
+  int threadBudget() const;
+
 protected:
+  /// @internal
+  class Data : public PiiOperationCompound::Data
+  {
+  public:
+    Data();
+    ~Data();
+
+    PiiProfiler* pProfiler;
+    QList<PiiProfiler*> lstRetiredProfilers;
+    bool bMatrixPoolEnabled;
+    // True if the engine is currently a user of PiiMatrixPool.
+    bool bUsingMatrixPool;
+    int iLatencyBudget;
+    int iThreadBudget;
+    PiiThreadBalancer* pThreadBalancer;
+  };
+  PII_D_FUNC;
+
   /// @internal
   PiiEngine(Data* data);
 
+  void aboutToChangeState(State newState);
+
 private:
   typedef QHash<QString,Plugin> PluginMap;
   static QStringList compoundsUsedPlugins(PiiOperationCompound* compound);
   static QString operationsUsedPlugin(PiiOperation* operation);
+  static bool resolveClass(const char* className);
 
   static PluginMap _pluginMap;
   static QMutex _pluginLock;
+  // Maps class names to plug-in library names.
+  static QHash<QString,QString> _pluginIndex;
+  // Load times of plug-ins in microseconds.
+  static QHash<QString,qint64> _pluginLoadTimes;
+  static QVariantMap _mapLastLoadTimes;
 };
 
 /**
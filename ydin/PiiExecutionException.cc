@@ -16,9 +16,11 @@
 #include "PiiExecutionException.h"
 #include <PiiOperation.h>
 
+#ifndef PII_NO_QT
 #include "PiiSerializableExport.h"
 PII_SERIALIZABLE_EXPORT(PiiExecutionException);
 PII_SERIALIZABLE_EXPORT(PiiCompoundExecutionException);
+#endif
 
 PiiExecutionException::Data::Data(const QString& message, const QString& location, Code c) :
   PiiException::Data(message, location),
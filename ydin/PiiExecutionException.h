@@ -30,8 +30,10 @@ class PiiOperation;
  */
 class PII_YDIN_EXPORT PiiExecutionException : public PiiException
 {
+#ifndef PII_NO_QT
   PII_DEFAULT_SERIALIZATION_FUNCTION(PiiException)
   PII_VIRTUAL_METAOBJECT_FUNCTION;
+#endif
 public:
   /**
    * Codes for different exception types.
@@ -108,11 +110,13 @@ protected:
   /// @endhide
 };
 
+#ifndef PII_NO_QT
 #define PII_SERIALIZABLE_CLASS PiiExecutionException
 #define PII_VIRTUAL_METAOBJECT
 #define PII_BUILDING_LIBRARY PII_BUILDING_YDIN
 
 #include "PiiSerializableRegistration.h"
+#endif
 
 /**
  * Thrown by PiiOperationCompound when errors occur during check().
@@ -122,6 +126,7 @@ protected:
  */
 class PII_YDIN_EXPORT PiiCompoundExecutionException : public PiiExecutionException
 {
+#ifndef PII_NO_QT
   friend struct PiiSerialization::Accessor;
   template <class Archive> void serialize(Archive& archive, const unsigned)
   {
@@ -129,6 +134,7 @@ class PII_YDIN_EXPORT PiiCompoundExecutionException : public PiiExecutionExcepti
     archive & _d()->lstExceptions;
   }
   PII_VIRTUAL_METAOBJECT_FUNCTION;
+#endif
 public:
   typedef QList<QPair<QString,PiiExecutionException*> > ExceptionList;
 
@@ -161,10 +167,12 @@ private:
   PII_D_FUNC;
 };
 
+#ifndef PII_NO_QT
 #define PII_SERIALIZABLE_CLASS PiiCompoundExecutionException
 #define PII_VIRTUAL_METAOBJECT
 #define PII_BUILDING_LIBRARY PII_BUILDING_YDIN
 
 #include "PiiSerializableRegistration.h"
+#endif
 
 #endif //_PIIEXECUTIONEXCEPTION_H
@@ -15,8 +15,11 @@
 
 #include "PiiFlowController.h"
 
+#include <PiiTimer.h>
+
 PiiFlowController::Data::Data() :
-  iActiveInputGroup(0)
+  iActiveInputGroup(0),
+  iLatencyBudget(0)
 {
 }
 
@@ -49,6 +52,11 @@ void PiiFlowController::setActiveInputGroup(int group)
   d->iActiveInputGroup = group;
 }
 
+bool PiiFlowController::shiftToBatch()
+{
+  return false;
+}
+
 bool PiiFlowController::hasSyncEvents() const
 {
   return false;
@@ -58,6 +66,21 @@ void PiiFlowController::sendSyncEvents(SyncListener* /*listener*/)
 {
 }
 
+void PiiFlowController::setLatencyBudget(int latencyBudget)
+{
+  d->iLatencyBudget = qint64(qMax(0, latencyBudget)) * 1000;
+}
+
+int PiiFlowController::latencyBudget() const
+{
+  return int(d->iLatencyBudget / 1000);
+}
+
+qint64 PiiFlowController::expiryTime() const
+{
+  return d->iLatencyBudget > 0 ? PiiTimer::timestamp() - d->iLatencyBudget : 0;
+}
+
 void PiiFlowController::setPropertySetName(const QString& propertySetName) { d->strPropertySetName = propertySetName; }
 QString PiiFlowController::propertySetName() const { return d->strPropertySetName; }
 
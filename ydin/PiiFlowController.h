@@ -197,6 +197,9 @@ public:
    * tag. Reconfiguration tags are QStrings that carry the id of the
    * property set that must be applied when the flow controller
    * returns `ReconfigurableState`.
+   * - `DropTag` - at least one input contains a drop tag, and all
+   * others contain either drop tags or ordinary objects. The whole
+   * group must be discarded.
    */
   enum InputGroupType
     {
@@ -207,7 +210,8 @@ public:
       StopTag = 8,
       PauseTag = 16,
       ResumeTag = 32,
-      ReconfigurationTag = 64
+      ReconfigurationTag = 64,
+      DropTag = 128
     };
 
   /**
@@ -252,6 +256,25 @@ public:
    template <class InputIterator>
    static QString dumpInputObjects(InputIterator begin, InputIterator end, int queueIndex = 0);
 
+  /**
+   * A utility function for implementing [shiftToBatch()]. If all
+   * inputs in the range [begin, end) have an ordinary object at the
+   * head of their queue, moves the objects to the current batch and
+   * returns `true`. Otherwise returns `false`. Objects received
+   * before *expiryTime* are not added to the batch (see
+   * [expiryTime()]).
+   */
+  template <class InputIterator> static inline bool shiftGroupToBatch(InputIterator begin, InputIterator end,
+                                                                      qint64 expiryTime = 0);
+
+  /**
+   * Returns `true` if any of the objects at the head of the input
+   * queues in the range [begin, end) was received before
+   * *expiryTime*. If *expiryTime* is zero, returns `false`.
+   */
+  template <class InputIterator> static inline bool isExpired(InputIterator begin, InputIterator end,
+                                                              qint64 expiryTime);
+
   /**
    * Prepares sockets for processing. This function is called by
    * PiiOperationProcessor just before it starts a processing round.
@@ -312,6 +335,24 @@ public:
    */
   virtual FlowState prepareProcess() = 0;
 
+  /**
+   * Extends the batch prepared by the previous [prepareProcess()]
+   * call that returned `ProcessableState`. This function is called by
+   * PiiOperationProcessor when the operation processes objects in
+   * [batches](PiiDefaultOperation::batchSize). If the next objects in
+   * all inputs of the active group are ordinary objects and
+   * processing them requires no synchronization events, the
+   * implementation must move them to the batch with
+   * [PiiInputSocket::shiftToBatch()] and return `true`. Otherwise,
+   * the input queues must be left untouched and `false` returned.
+   *
+   * A batch never crosses a synchronization tag. Any tags and sync
+   * events will thus be handled after the whole batch has been
+   * processed, in the same order as without batching. The default
+   * implementation returns `false`, which disables batching.
+   */
+  virtual bool shiftToBatch();
+
   /**
    * Returns `true` if the controller has queued synchronization
    * events and `false` otherwise. The default implementation returns
@@ -333,6 +374,18 @@ public:
    */
   int activeInputGroup() const;
 
+  /**
+   * Sets the latency budget in milliseconds. If an object has waited
+   * in an input queue longer than this, its whole group of
+   * synchronized inputs will be discarded instead of processed, and
+   * a drop tag (PiiYdin::DropTagType) will be sent to synchronized
+   * outputs. Only groups that have neither parent nor child groups
+   * are discarded this way. Zero disables the budget, which is the
+   * default.
+   */
+  void setLatencyBudget(int latencyBudget);
+  int latencyBudget() const;
+
   /**
    * Returns the name of the property set to be applied if
    * prepareProcess() returns `ReconfigurableState`.
@@ -350,6 +403,8 @@ protected:
     /// The ID of the currently active sync group.
     int iActiveInputGroup;
     QString strPropertySetName;
+    // In microseconds, zero if disabled.
+    qint64 iLatencyBudget;
   } *d;
   /// @internal
   PiiFlowController(Data* data);
@@ -362,6 +417,13 @@ protected:
   void setActiveInputGroup(int group);
   void setPropertySetName(const QString& propertySetName);
 
+  /**
+   * Returns the time stamp (PiiTimer::timestamp()) before which
+   * received objects exceed the latency budget. Returns zero if there
+   * is no budget.
+   */
+  qint64 expiryTime() const;
+
   /// @internal
   static QString tr(const char* msg) { return QCoreApplication::translate("PiiFlowController", msg); }
 
@@ -399,6 +461,9 @@ QString PiiFlowController::dumpInputObjects(InputIterator begin, InputIterator e
             case PiiYdin::SynchronizationTagType:
               objType = obj.valueAs<int>() < 0 ? tr("<synchronization end tag>") : tr("<synchronization start tag>");
               break;
+            case PiiYdin::DropTagType:
+              objType = tr("<drop tag>");
+              break;
             default:
               objType = tr("ordinary object, type id 0x%1").arg(obj.type(), 0, 16);
             }
@@ -430,6 +495,8 @@ int PiiFlowController::inputGroupTypeMask(InputIterator begin, InputIterator end
         typeMask |= PauseTag;
       else if (uiType == PiiYdin::ResumeTagType)
         typeMask |= ResumeTag;
+      else if (uiType == PiiYdin::DropTagType)
+        typeMask |= DropTag;
       else //if (uiType == PiiYdin::ReconfigurationTagType)
         typeMask |= ReconfigurationTag;
     }
@@ -438,6 +505,10 @@ int PiiFlowController::inputGroupTypeMask(InputIterator begin, InputIterator end
   if (typeMask == NormalObject)
     return NormalObject;
 
+  // Ordinary objects in a group with a drop tag are discarded.
+  if (typeMask == (DropTag | NormalObject))
+    return DropTag;
+
   // Special case: pause tags and normal objects mixed. This can
   // happen if an operation paused while emitting a set of subobjects
   // between startMany() and endMany() calls AND another operation
@@ -467,6 +538,33 @@ int PiiFlowController::inputGroupTypeMask(InputIterator begin, InputIterator end
   return typeMask;
 }
 
+template <class InputIterator>
+bool PiiFlowController::shiftGroupToBatch(InputIterator begin, InputIterator end, qint64 expiryTime)
+{
+  for (InputIterator i=begin; i != end; ++i)
+    {
+      unsigned int uiType = (*i)->queuedType(0);
+      if (uiType == PiiVariant::InvalidType || !PiiYdin::isNonControlType(uiType))
+        return false;
+    }
+  if (isExpired(begin, end, expiryTime))
+    return false;
+  for (InputIterator i=begin; i != end; ++i)
+    (*i)->shiftToBatch();
+  return true;
+}
+
+template <class InputIterator>
+bool PiiFlowController::isExpired(InputIterator begin, InputIterator end, qint64 expiryTime)
+{
+  if (expiryTime == 0)
+    return false;
+  for (; begin != end; ++begin)
+    if ((*begin)->queuedTimestamp(0) < expiryTime)
+      return true;
+  return false;
+}
+
 template <class InputIterator>
 bool PiiFlowController::resolvePausedState(unsigned int type, InputIterator begin, InputIterator end)
 {
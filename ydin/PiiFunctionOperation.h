@@ -257,16 +257,40 @@ namespace PiiFuncOpPrivate
     typedef typename Conv::ValueType ValueType;
 
     OutputHolder(const char* socketName) :
-      pSocket(new PiiOutputSocket(socketName))
+      pSocket(new PiiOutputSocket(socketName)),
+      pInput(nullptr),
+      bConnected(true)
+    {}
+    // In-place parameters are initialized by reading inputName and
+    // sent to socketName after the call.
+    OutputHolder(const char* socketName, const char* inputName) :
+      pSocket(new PiiOutputSocket(socketName)),
+      pInput(new PiiInputSocket(inputName)),
+      bConnected(true)
     {}
 
-    void initialize(Object*, ValueType& value) { Conv::initialize(value); }
+    void initialize(Object*, ValueType& value)
+    {
+      if (pInput == nullptr)
+        Conv::initialize(value);
+      else if (!DefaultInputConverter<ValueType>::initialize(pInput->firstObject(), value))
+        PII_THROW_UNKNOWN_TYPE(pInput);
+    }
     void emitValue(ValueType& value)
     {
-      pSocket->emitObject(Conv::toVariant(value)); // may throw
+      // Don't convert values nobody is going to receive.
+      if (bConnected)
+        pSocket->emitObject(Conv::toVariant(value)); // may throw
+    }
+
+    void check()
+    {
+      bConnected = pSocket->isConnected();
     }
 
     PiiOutputSocket* pSocket;
+    PiiInputSocket* pInput;
+    bool bConnected;
   };
 
   // ParamHolder::Type is either InputHolder or OutputHolder,
@@ -309,6 +333,14 @@ namespace PiiFuncOpPrivate
       if (holder.pSocket)
         op->addSocket(holder.pSocket);
     }
+
+    template <class Operation, class Object, class T>
+    void operator() (Operation* op, OutputHolder<Object,T>& holder)
+    {
+      if (holder.pInput)
+        op->addSocket(holder.pInput);
+      op->addSocket(holder.pSocket);
+    }
   };
 
   struct DefaultValueSetter
@@ -348,7 +380,11 @@ namespace PiiFuncOpPrivate
       holder.check();
     }
 
-    template <class... Args> void operator() (Args&...) const {}
+    template <class Object, class T>
+    void operator() (OutputHolder<Object,T>& holder)
+    {
+      holder.check();
+    }
   };
 
   template <class Function> struct FunctionCaller
@@ -368,6 +404,10 @@ namespace PiiFuncOpPrivate
     template <class Object, class T>
     void operator() (OutputHolder<Object,T>& holder)
     {
+      if (holder.pInput)
+        f(holder.pInput,
+          static_cast<T*>(nullptr),
+          static_cast<typename Converter<T>::Type::ValueType*>(nullptr));
       f(holder.pSocket,
         static_cast<T*>(nullptr),
         static_cast<typename Converter<T>::Type::ValueType*>(nullptr));
@@ -466,7 +506,17 @@ namespace PiiFuncOpPrivate
  *
  * 4.  When the function returns, all output parameters are converted
  *     to [PiiVariant]s using `converter::toVariant()` and passed to
- *     the corresponding output socket.
+ *     the corresponding output socket. Conversions are skipped for
+ *     outputs that were not connected when the operation was
+ *     started.
+ *
+ * All of this is resolved at compile time. The parameter types
+ * select the converters, and no type information is examined at run
+ * time except when an input object does not have the exact type of
+ * the temporary value and needs to be converted. An output-value
+ * parameter can also be initialized from an input, which makes it
+ * possible to wrap functions that modify matrices in place. See
+ * [inPlace()].
  *
  * ~~~(c++)
  * struct MyType
@@ -528,6 +578,7 @@ public:
 
     Pii::callWithTuples(PiiFuncOpPrivate::Checker(),
                         _d()->holderPack);
+    _d()->checkReturnOutput();
   }
 protected:
   /// @hide
@@ -559,6 +610,7 @@ protected:
     {}
 
     void addReturnOutput(ThisType*) const {}
+    void checkReturnOutput() {}
 
     void callAndEmit(typename Converter<Args>::ValueType&... values) const
     {
@@ -590,15 +642,20 @@ protected:
                 const char* outputName,
                 typename ParamHolder<Args>::Type&&... holders) :
       VoidData(function, std::forward<typename ParamHolder<Args>::Type>(holders)...),
-      pReturnOutput(new PiiOutputSocket(outputName))
+      pReturnOutput(new PiiOutputSocket(outputName)),
+      bReturnConnected(true)
     {}
 
     void addReturnOutput(ThisType* op) const { op->addSocket(pReturnOutput); }
+    void checkReturnOutput() { bReturnConnected = pReturnOutput->isConnected(); }
 
     void callAndEmit(typename Converter<Args>::ValueType&... values) const
     {
-      pReturnOutput->emitObject(PiiFuncOpPrivate::ReturnConverter<ReturnType>::Type::
-                                toVariant(this->function(Converter<Args>::Type::toParam(values)...)));
+      if (bReturnConnected)
+        pReturnOutput->emitObject(PiiFuncOpPrivate::ReturnConverter<ReturnType>::Type::
+                                  toVariant(this->function(Converter<Args>::Type::toParam(values)...)));
+      else
+        this->function(Converter<Args>::Type::toParam(values)...);
     }
 
     template <class BinaryFunction>
@@ -625,6 +682,7 @@ protected:
     }
 
     PiiOutputSocket* pReturnOutput;
+    bool bReturnConnected;
   };
 
   typedef typename Pii::IfClass<Pii::IsVoid<ReturnType>, VoidData, NonVoidData>::Type Data;
@@ -747,6 +805,32 @@ protected:
     return typename ParamHolder<T>::Type(getter);
   }
 
+  /**
+   * Makes the output-value parameter of type `T` an in-place
+   * parameter. The temporary value is initialized by reading *input*
+   * instead of default-constructing it. After the call, the modified
+   * value is sent to *output*. *input* and *output* may have the
+   * same name.
+   *
+   * ~~~(c++)
+   * void normalize(PiiMatrix<float>& histogram);
+   *
+   * MyNormalizer::MyNormalizer() :
+   *   SuperType(&normalize,
+   *             inPlace<PiiMatrix<float>&>("histogram", "histogram"))
+   * {}
+   * ~~~
+   *
+   * ! The input object is still owned by the input socket. Modifying
+   * an implicitly shared object such as PiiMatrix therefore copies
+   * it once, but no separate result object needs to be created.
+   */
+  template <class T>
+  typename ParamHolder<T>::Type inPlace(const char* input, const char* output) const
+  {
+    return typename ParamHolder<T>::Type(output, input);
+  }
+
   /**
    * Returns the socket corresponding to the Ith function parameter.
    * If the function has a return value, it is regarded as the first
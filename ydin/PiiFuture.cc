@@ -0,0 +1,175 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifdef PII_CXX11
+
+#include "PiiFuture.h"
+
+#include <PiiSynchronized.h>
+#include <PiiTimer.h>
+#include <exception>
+
+static thread_local PiiFutureState* pCurrentState = 0;
+
+PiiFutureState::PiiFutureState() :
+  _status(Pending),
+  _bCancelRequested(false)
+{}
+
+PiiFutureState::~PiiFutureState()
+{}
+
+bool PiiFutureState::start()
+{
+  QMutexLocker lock(&_mutex);
+  if (_status != Pending)
+    return false;
+  _status = Running;
+  return true;
+}
+
+void PiiFutureState::complete(Status status, const QString& errorMessage)
+{
+  QList<std::function<void()> > lstContinuations;
+  synchronized (_mutex)
+    {
+      if (_status >= Finished)
+        return;
+      _status = status;
+      _strErrorMessage = errorMessage;
+      lstContinuations.swap(_lstContinuations);
+      _condition.wakeAll();
+    }
+  // Continuations may add continuations to other futures or start
+  // new tasks, so they must be run without holding the lock.
+  for (int i=0; i<lstContinuations.size(); ++i)
+    lstContinuations[i]();
+}
+
+bool PiiFutureState::cancel()
+{
+  synchronized (_mutex)
+    {
+      if (_status >= Finished)
+        return false;
+      _bCancelRequested = true;
+      // A running task will be canceled once it returns.
+      if (_status == Running)
+        return true;
+    }
+  complete(Canceled);
+  return true;
+}
+
+bool PiiFutureState::wait(unsigned long time)
+{
+  QMutexLocker lock(&_mutex);
+  PiiTimer timer;
+  while (_status < Finished)
+    {
+      if (time != ULONG_MAX)
+        {
+          qint64 iElapsed = timer.milliseconds();
+          if ((unsigned long)iElapsed >= time)
+            return false;
+          _condition.wait(&_mutex, time - iElapsed);
+        }
+      else
+        _condition.wait(&_mutex);
+    }
+  return true;
+}
+
+void PiiFutureState::onComplete(const std::function<void()>& function)
+{
+  synchronized (_mutex)
+    {
+      if (_status < Finished)
+        {
+          _lstContinuations << function;
+          return;
+        }
+    }
+  function();
+}
+
+PiiFutureState::Status PiiFutureState::status() const
+{
+  QMutexLocker lock(&_mutex);
+  return _status;
+}
+
+QString PiiFutureState::errorMessage() const
+{
+  QMutexLocker lock(&_mutex);
+  return _strErrorMessage;
+}
+
+bool PiiFutureState::isCancelRequested() const
+{
+  QMutexLocker lock(&_mutex);
+  return _bCancelRequested;
+}
+
+void PiiFutureState::execute(const std::function<void()>& function)
+{
+  if (!start())
+    return;
+
+  PiiFutureState* pPreviousState = pCurrentState;
+  pCurrentState = this;
+  Status status = Finished;
+  QString strErrorMessage;
+  try
+    {
+      function();
+    }
+  catch (PiiException& ex)
+    {
+      status = Failed;
+      strErrorMessage = ex.message();
+    }
+  catch (std::exception& ex)
+    {
+      status = Failed;
+      strErrorMessage = QString::fromLocal8Bit(ex.what());
+    }
+  catch (...)
+    {
+      status = Failed;
+      strErrorMessage = QCoreApplication::translate("PiiFuture", "Unknown exception.");
+    }
+  pCurrentState = pPreviousState;
+
+  if (status == Finished && isCancelRequested())
+    status = Canceled;
+  complete(status, strErrorMessage);
+}
+
+PiiFutureState* PiiFutureState::current()
+{
+  return pCurrentState;
+}
+
+namespace PiiYdin
+{
+  bool isTaskCanceled()
+  {
+    PiiFutureState* pState = PiiFutureState::current();
+    return pState != 0 && pState->isCancelRequested();
+  }
+}
+
+#endif
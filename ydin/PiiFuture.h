@@ -0,0 +1,412 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIFUTURE_H
+#define _PIIFUTURE_H
+
+#ifdef PII_CXX11
+
+#include "PiiThreadPool.h"
+#include <PiiException.h>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <functional>
+#include <memory>
+#include <utility>
+
+/// @internal
+class PII_YDIN_EXPORT PiiFutureState
+{
+public:
+  enum Status { Pending, Running, Finished, Canceled, Failed };
+
+  PiiFutureState();
+  virtual ~PiiFutureState();
+
+  // Moves from Pending to Running. Returns false if the task was
+  // canceled before it could start.
+  bool start();
+  // Moves to a final state, wakes up waiters and runs continuations.
+  void complete(Status status, const QString& errorMessage = QString());
+  bool cancel();
+  bool wait(unsigned long time);
+  // Runs *function* once the state is final, possibly immediately.
+  void onComplete(const std::function<void()>& function);
+
+  Status status() const;
+  QString errorMessage() const;
+  bool isCancelRequested() const;
+
+  // Runs *function* in the context of this state. Exceptions thrown
+  // by the function change the state to Failed.
+  void execute(const std::function<void()>& function);
+
+  static PiiFutureState* current();
+
+private:
+  mutable QMutex _mutex;
+  QWaitCondition _condition;
+  Status _status;
+  bool _bCancelRequested;
+  QString _strErrorMessage;
+  QList<std::function<void()> > _lstContinuations;
+};
+
+/// @internal
+template <class T> class PiiFutureData : public PiiFutureState
+{
+public:
+  template <class Function> void run(Function& function)
+  {
+    execute([this, &function]() { result = function(); });
+  }
+  template <class Function, class U> void runWith(Function& function, const U& argument)
+  {
+    execute([this, &function, &argument]() { result = function(argument); });
+  }
+  T result;
+};
+
+/// @internal
+template <> class PiiFutureData<void> : public PiiFutureState
+{
+public:
+  template <class Function> void run(Function& function)
+  {
+    execute([&function]() { function(); });
+  }
+  template <class Function, class U> void runWith(Function& function, const U& argument)
+  {
+    execute([&function, &argument]() { function(argument); });
+  }
+};
+
+template <class T> class PiiFuture;
+
+namespace PiiYdin
+{
+  /// @internal
+  template <class T, class Function> class FutureTask : public PiiThreadPool::Task
+  {
+  public:
+    FutureTask(const std::shared_ptr<PiiFutureData<T> >& state, Function function) :
+      _pState(state), _function(std::move(function))
+    {
+      setAutoDelete(true);
+    }
+
+    void run() { _pState->run(_function); }
+
+  private:
+    std::shared_ptr<PiiFutureData<T> > _pState;
+    Function _function;
+  };
+
+  /// @internal
+  template <class T, class Function>
+  void startFutureTask(const std::shared_ptr<PiiFutureData<T> >& state, Function&& function)
+  {
+    PiiThreadPool::instance()->start(new FutureTask<T,typename std::decay<Function>::type>(state, std::forward<Function>(function)));
+  }
+
+  /// @internal
+  template <class T> struct ContinuationResult
+  {
+    template <class Function> static auto resolve(Function& f) -> decltype(f(std::declval<T>()));
+  };
+
+  /// @internal
+  template <> struct ContinuationResult<void>
+  {
+    template <class Function> static auto resolve(Function& f) -> decltype(f());
+  };
+
+  /// @internal
+  template <class T> struct ContinuationRunner
+  {
+    template <class R, class Function>
+    static void run(PiiFutureData<R>* state, Function& function, const PiiFutureData<T>* antecedent)
+    {
+      state->runWith(function, antecedent->result);
+    }
+  };
+
+  /// @internal
+  template <> struct ContinuationRunner<void>
+  {
+    template <class R, class Function>
+    static void run(PiiFutureData<R>* state, Function& function, const PiiFutureData<void>*)
+    {
+      state->run(function);
+    }
+  };
+
+  template <class Function> PiiFuture<decltype(std::declval<Function&>()())> runTask(Function&& function);
+
+  /**
+   * Returns `true` if the [future](PiiFuture) of the task running in
+   * the current thread has been canceled. Long-running tasks should
+   * check this regularly and return early if `true` is returned.
+   * Returns `false` if the current thread is not running a task
+   * started by runTask().
+   */
+  PII_YDIN_EXPORT bool isTaskCanceled();
+}
+
+/**
+ * A handle to the result of a task that runs in PiiThreadPool. A
+ * future is cheap to copy; all copies refer to the same result. The
+ * task keeps running even if all of its futures are destroyed.
+ *
+ * Tasks are started with PiiYdin::runTask(). A continuation can be
+ * chained to a future with then(), and PiiYdin::whenAll() combines
+ * many futures into one. No thread is created or destroyed per task
+ * unless the pool has no idle threads.
+ *
+ * ~~~(c++)
+ * PiiFuture<PiiMatrix<double> > future =
+ *   PiiYdin::runTask([fileName]() { return loadSamples(fileName); })
+ *     .then([](const PiiMatrix<double>& samples) { return retrain(samples); });
+ * // ...
+ * if (future.wait(1000))
+ *   useModel(future.result());
+ * ~~~
+ *
+ * If a task throws an exception, the future will be in failed state,
+ * and the exception message will be available through
+ * errorMessage(). Continuations of failed and canceled futures are
+ * not run; their futures inherit the state of the antecedent.
+ */
+template <class T> class PiiFuture
+{
+public:
+  typedef T ValueType;
+
+  /**
+   * Creates an invalid future that isn't associated with any task.
+   */
+  PiiFuture() {}
+
+  /**
+   * Returns `true` if the future is associated with a task.
+   */
+  bool isValid() const { return _pState != 0; }
+
+  /**
+   * Returns the current status of the task.
+   */
+  PiiFutureState::Status status() const { return _pState->status(); }
+
+  /**
+   * Returns `true` if the task has finished successfully.
+   */
+  bool isFinished() const { return status() == PiiFutureState::Finished; }
+  /**
+   * Returns `true` if the task was canceled.
+   */
+  bool isCanceled() const { return status() == PiiFutureState::Canceled; }
+  /**
+   * Returns `true` if the task threw an exception.
+   */
+  bool hasFailed() const { return status() == PiiFutureState::Failed; }
+  /**
+   * Returns `true` if the task has finished, failed or was canceled.
+   */
+  bool isDone() const { return status() >= PiiFutureState::Finished; }
+
+  /**
+   * Returns the message of the exception that made the task fail.
+   */
+  QString errorMessage() const { return _pState->errorMessage(); }
+
+  /**
+   * Cancels the task. If the task hasn't been started yet, it won't
+   * be run, and the future will be immediately canceled. If the task
+   * is running, PiiYdin::isTaskCanceled() will return `true` in the
+   * context of the task, and the future will be canceled once the
+   * task returns. Returns `false` if the task was already done.
+   */
+  bool cancel() { return _pState->cancel(); }
+
+  /**
+   * Blocks the calling thread until the task is done or *time*
+   * milliseconds have elapsed. Returns `true` if the task is done.
+   */
+  bool wait(unsigned long time = ULONG_MAX) const { return _pState->wait(time); }
+
+  /**
+   * Waits for the task to finish and returns its result.
+   *
+   * @exception PiiException& if the task failed or was canceled.
+   */
+  T result() const
+  {
+    checkResult();
+    return resultOf(_pState.get());
+  }
+
+  /**
+   * Chains *function* to this future. Once this future has
+   * finished, *function* will be called in a pooled thread with the
+   * result of this future as the parameter (or without parameters
+   * if `T` is `void`). Returns a future for the result of the
+   * continuation.
+   */
+  template <class Function>
+  PiiFuture<decltype(PiiYdin::ContinuationResult<T>::resolve(std::declval<Function&>()))> then(Function function) const
+  {
+    typedef decltype(PiiYdin::ContinuationResult<T>::resolve(std::declval<Function&>())) R;
+    std::shared_ptr<PiiFutureData<R> > pNext(new PiiFutureData<R>);
+    std::shared_ptr<PiiFutureData<T> > pThis(_pState);
+    _pState->onComplete([pThis, pNext, function]() mutable
+                        {
+                          if (pThis->status() != PiiFutureState::Finished)
+                            pNext->complete(pThis->status(), pThis->errorMessage());
+                          else
+                            PiiYdin::startFutureTask(pNext, [pThis, pNext, function]() mutable
+                                                     {
+                                                       PiiYdin::ContinuationRunner<T>::run(pNext.get(), function, pThis.get());
+                                                     });
+                        });
+    return PiiFuture<R>(pNext);
+  }
+
+  /// @internal
+  explicit PiiFuture(const std::shared_ptr<PiiFutureData<T> >& state) : _pState(state) {}
+  /// @internal
+  PiiFutureState* state() const { return _pState.get(); }
+
+private:
+  void checkResult() const
+  {
+    _pState->wait(ULONG_MAX);
+    switch (_pState->status())
+      {
+      case PiiFutureState::Failed:
+        PII_THROW(PiiException, _pState->errorMessage());
+      case PiiFutureState::Canceled:
+        PII_THROW(PiiException, QCoreApplication::translate("PiiFuture", "The task was canceled."));
+      default:
+        break;
+      }
+  }
+
+  template <class U> static U resultOf(PiiFutureData<U>* state) { return state->result; }
+  static void resultOf(PiiFutureData<void>*) {}
+
+  std::shared_ptr<PiiFutureData<T> > _pState;
+};
+
+namespace PiiYdin
+{
+  /**
+   * Runs *function* in a pooled thread and returns a future for its
+   * result. The function object is copied or moved; make sure
+   * everything it refers to stays alive until the task is done.
+   *
+   * ~~~(c++)
+   * PiiFuture<void> future = PiiYdin::runTask([pWriter]() { pWriter->flush(); });
+   * ~~~
+   *
+   * @relates PiiFuture
+   */
+  template <class Function> PiiFuture<decltype(std::declval<Function&>()())> runTask(Function&& function)
+  {
+    typedef decltype(std::declval<Function&>()()) R;
+    std::shared_ptr<PiiFutureData<R> > pState(new PiiFutureData<R>);
+    startFutureTask(pState, std::forward<Function>(function));
+    return PiiFuture<R>(pState);
+  }
+
+  /**
+   * Runs *member* of *object* with *args* in a pooled thread. This
+   * is the pooled counterpart of Pii::asyncCall().
+   *
+   * ~~~(c++)
+   * PiiFuture<bool> future = PiiYdin::runTask(pClassifier, &MyClassifier::learn, samples);
+   * ~~~
+   *
+   * @relates PiiFuture
+   */
+  template <class Object, class ReturnType, class Class, class... Params, class... Args>
+  PiiFuture<ReturnType> runTask(Object object, ReturnType (Class::* member)(Params...), Args&&... args)
+  {
+    return runTask(std::bind(member, object, std::forward<Args>(args)...));
+  }
+
+  /**
+   * Returns a future that is done when all *futures* are done. The
+   * combined future fails if any of the futures fails, and is
+   * canceled if any of them is canceled. Results are read from the
+   * original futures. An empty list results in a finished future.
+   *
+   * ~~~(c++)
+   * QList<PiiFuture<int> > lstFutures;
+   * for (int i=0; i<10; ++i)
+   *   lstFutures << PiiYdin::runTask(std::bind(&compute, i));
+   * PiiYdin::whenAll(lstFutures).wait();
+   * ~~~
+   *
+   * @relates PiiFuture
+   */
+  template <class T> PiiFuture<void> whenAll(const QList<PiiFuture<T> >& futures)
+  {
+    std::shared_ptr<PiiFutureData<void> > pState(new PiiFutureData<void>);
+    if (futures.isEmpty())
+      {
+        pState->complete(PiiFutureState::Finished);
+        return PiiFuture<void>(pState);
+      }
+
+    struct Counter
+    {
+      Counter(int count) : iRemaining(count), status(PiiFutureState::Finished) {}
+      QMutex mutex;
+      int iRemaining;
+      PiiFutureState::Status status;
+      QString strErrorMessage;
+    };
+    std::shared_ptr<Counter> pCounter(new Counter(futures.size()));
+    for (int i=0; i<futures.size(); ++i)
+      {
+        PiiFutureState* pPart = futures[i].state();
+        futures[i].state()->onComplete([pState, pCounter, pPart]()
+                                       {
+                                         QMutexLocker lock(&pCounter->mutex);
+                                         PiiFutureState::Status status = pPart->status();
+                                         // Failure overrides cancellation.
+                                         if (status == PiiFutureState::Failed && pCounter->status != PiiFutureState::Failed)
+                                           {
+                                             pCounter->status = status;
+                                             pCounter->strErrorMessage = pPart->errorMessage();
+                                           }
+                                         else if (status == PiiFutureState::Canceled && pCounter->status == PiiFutureState::Finished)
+                                           pCounter->status = status;
+                                         if (--pCounter->iRemaining == 0)
+                                           {
+                                             lock.unlock();
+                                             pState->complete(pCounter->status, pCounter->strErrorMessage);
+                                           }
+                                       });
+      }
+    return PiiFuture<void>(pState);
+  }
+}
+
+#endif
+
+#endif //_PIIFUTURE_H
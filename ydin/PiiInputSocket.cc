@@ -18,6 +18,8 @@
 #include "PiiYdinTypes.h"
 #include "PiiNullInputController.h"
 
+#include <PiiTimer.h>
+
 #include <QStringList>
 #include <QThread>
 #include <QCoreApplication>
@@ -29,8 +31,8 @@ PiiInputSocket::Data::Data() :
   bConnected(false),
   bOptional(false),
   pController(PiiNullInputController::instance()),
-  iQueueStart(0),
-  iQueueLength(0)
+  queueBudget(PiiMemoryBudget::global()),
+  iOriginTime(0)
 {}
 
 bool PiiInputSocket::Data::setInputConnected(bool connected)
@@ -38,6 +40,15 @@ bool PiiInputSocket::Data::setInputConnected(bool connected)
   return bConnected = connected;
 }
 
+bool PiiInputSocket::Data::hasRoom() const
+{
+  if (queue.isFull())
+    return false;
+  // An object always fits into an empty queue. Only the sender
+  // appends, so an empty queue stays empty.
+  return queue.isEmpty() || !queueBudget.isLimited() || !queueBudget.isExceeded();
+}
+
 PiiInputSocket::PiiInputSocket(const QString& name) :
   PiiAbstractInputSocket(name, new Data)
 {
@@ -65,32 +76,65 @@ void PiiInputSocket::setQueueCapacity(int queueCapacity)
 {
   PII_D;
   if (queueCapacity < 1) return;
-  d->lstQueue.resize(queueCapacity);
+  d->queue.setCapacity(queueCapacity);
+  d->timestamps.setCapacity(queueCapacity);
+  d->originTimes.setCapacity(queueCapacity);
   reset();
 }
 
 void PiiInputSocket::receive(const PiiVariant& obj)
 {
   PII_D;
-  d->lstQueue[queueIndex(d->iQueueLength)] = obj;
-  ++d->iQueueLength;
+  // Charge first. The consumer releases as soon as it sees the object.
+  d->queueBudget.charge(objectBytes(obj));
+  d->timestamps.append(PiiTimer::timestamp());
+  d->originTimes.append(PiiYdin::currentOriginTime());
+  d->queue.append(obj);
+}
+
+void PiiInputSocket::receiveFirst(const PiiVariant& obj)
+{
+  PII_D;
+  Q_ASSERT(d->queue.size() == 0);
+  d->varProcessableObject = obj;
+  d->iOriginTime = PiiYdin::currentOriginTime();
+  if (!d->vecBatchObjects.isEmpty())
+    d->vecBatchObjects.clear();
 }
 
 void PiiInputSocket::shift()
 {
   PII_D;
-  Q_ASSERT(d->iQueueLength > 0);
+  Q_ASSERT(d->queue.size() > 0);
 
   // Move queue head to the outgoing slot.
-  d->varProcessableObject = d->lstQueue[d->iQueueStart];
-  // Destroy the old head.
-  d->lstQueue[d->iQueueStart] = PiiVariant();
-  // Rotate the queue
-  d->iQueueStart = (d->iQueueStart+1) % d->lstQueue.size();
-  --d->iQueueLength;
-  // Signal the sender if the queue was full (there may be a thread
-  // waiting).
-  if (d->iQueueLength == d->lstQueue.size()-1 && d->pListener != 0)
+  // The time stamp goes first. The sender may append a new one as
+  // soon as the object has been taken.
+  d->timestamps.takeFirst();
+  d->iOriginTime = d->originTimes.takeFirst();
+  d->varProcessableObject = d->queue.takeFirst();
+  d->queueBudget.release(objectBytes(d->varProcessableObject));
+  if (!d->vecBatchObjects.isEmpty())
+    d->vecBatchObjects.clear();
+  // Signal the sender if it found no room. The flag is read after
+  // the take, so a sender that filled the queue concurrently and
+  // then refused is never missed.
+  if (d->iReceiveWait.fetchAndStore(0) != 0 && d->pListener != 0)
+    d->pListener->inputReady(this);
+}
+
+void PiiInputSocket::shiftToBatch()
+{
+  PII_D;
+  Q_ASSERT(d->queue.size() > 0);
+
+  d->timestamps.takeFirst();
+  qint64 iOriginTime = d->originTimes.takeFirst();
+  if (iOriginTime != 0 && (d->iOriginTime == 0 || iOriginTime < d->iOriginTime))
+    d->iOriginTime = iOriginTime;
+  d->vecBatchObjects.append(d->queue.takeFirst());
+  d->queueBudget.release(objectBytes(d->vecBatchObjects.last()));
+  if (d->iReceiveWait.fetchAndStore(0) != 0 && d->pListener != 0)
     d->pListener->inputReady(this);
 }
 
@@ -100,15 +144,17 @@ void PiiInputSocket::assignFirstObject(Qt::HANDLE activeThreadId)
   QMutexLocker lock(&d->firstObjectMutex);
   // Try to find an empty slot from the list of processable objects.
   for (int i=0; i<d->lstProcessableObjects.size(); ++i)
-    if (d->lstProcessableObjects[i].first == 0)
+    if (d->lstProcessableObjects[i].threadId == 0)
       {
-        d->lstProcessableObjects[i] = qMakePair(activeThreadId, d->varProcessableObject);
+        d->lstProcessableObjects[i] = Data::ProcessableObject(activeThreadId, d->varProcessableObject, d->iOriginTime);
         d->varProcessableObject = PiiVariant();
+        d->iOriginTime = 0;
         return;
       }
   // No empty slots found -> add a new one
-  d->lstProcessableObjects.append(qMakePair(activeThreadId, d->varProcessableObject));
+  d->lstProcessableObjects.append(Data::ProcessableObject(activeThreadId, d->varProcessableObject, d->iOriginTime));
   d->varProcessableObject = PiiVariant();
+  d->iOriginTime = 0;
 }
 
 void PiiInputSocket::unassignFirstObject(Qt::HANDLE activeThreadId)
@@ -117,9 +163,9 @@ void PiiInputSocket::unassignFirstObject(Qt::HANDLE activeThreadId)
   QMutexLocker lock(&d->firstObjectMutex);
   // Find the slot based on thread id and clear it.
   for (int i=0; i<d->lstProcessableObjects.size(); ++i)
-    if (d->lstProcessableObjects[i].first == activeThreadId)
+    if (d->lstProcessableObjects[i].threadId == activeThreadId)
       {
-        d->lstProcessableObjects[i] = qMakePair(Qt::HANDLE(0), PiiVariant());
+        d->lstProcessableObjects[i] = Data::ProcessableObject();
         return;
       }
 }
@@ -127,19 +173,27 @@ void PiiInputSocket::unassignFirstObject(Qt::HANDLE activeThreadId)
 void PiiInputSocket::jump(int oldIndex, int newIndex)
 {
   PII_D;
-  PiiVariant tmpObj = queuedObject(oldIndex);
+  PiiVariant tmpObj = d->queue[oldIndex];
+  qint64 iTmpTime = d->timestamps[oldIndex];
+  qint64 iTmpOrigin = d->originTimes[oldIndex];
   for (int i=oldIndex-1; i>=newIndex; --i)
-    d->lstQueue[queueIndex(i+1)] = d->lstQueue[queueIndex(i)];
-  d->lstQueue[queueIndex(newIndex)] = tmpObj;
+    {
+      d->queue[i+1] = d->queue[i];
+      d->timestamps[i+1] = d->timestamps[i];
+      d->originTimes[i+1] = d->originTimes[i];
+    }
+  d->queue[newIndex] = tmpObj;
+  d->timestamps[newIndex] = iTmpTime;
+  d->originTimes[newIndex] = iTmpOrigin;
 }
 
 int PiiInputSocket::indexOf(unsigned int type, int startIndex) const
 {
   const PII_D;
-  for (int i=startIndex; i<d->iQueueLength; ++i)
+  const int iQueueLength = d->queue.size();
+  for (int i=startIndex; i<iQueueLength; ++i)
     {
-      int iQueueIndex = queueIndex(i);
-      if (d->lstQueue[iQueueIndex].type() == type)
+      if (d->queue[i].type() == type)
         return i;
     }
   return -1;
@@ -148,12 +202,14 @@ int PiiInputSocket::indexOf(unsigned int type, int startIndex) const
 void PiiInputSocket::reset()
 {
   PII_D;
-  for (int i=0; i<d->lstQueue.size(); ++i)
-    d->lstQueue[i] = PiiVariant();
+  d->queue.clear();
+  d->queueBudget.release(d->queueBudget.usedBytes());
+  d->timestamps.clear();
+  d->originTimes.clear();
   d->varProcessableObject = PiiVariant();
+  d->iOriginTime = 0;
+  d->vecBatchObjects.clear();
   d->lstProcessableObjects.clear();
-  d->iQueueLength = 0;
-  d->iQueueStart = 0;
 }
 
 void PiiInputSocket::setController(PiiInputController* controller)
@@ -176,20 +232,98 @@ PiiVariant PiiInputSocket::firstObject() const
   // Otherwise look for the thread id
   Qt::HANDLE currentThreadId = QThread::currentThreadId();
   for (int i=0; i<d->lstProcessableObjects.size(); ++i)
-    if (d->lstProcessableObjects[i].first == currentThreadId)
-      return d->lstProcessableObjects[i].second;
+    if (d->lstProcessableObjects[i].threadId == currentThreadId)
+      return d->lstProcessableObjects[i].object;
 
   // The calling thread is not assigned an object.
   return d->varProcessableObject;
 }
 
+qint64 PiiInputSocket::originTime() const
+{
+  const PII_D;
+  QMutexLocker lock(&d->firstObjectMutex);
+  if (d->lstProcessableObjects.isEmpty())
+    return d->iOriginTime;
+
+  Qt::HANDLE currentThreadId = QThread::currentThreadId();
+  for (int i=0; i<d->lstProcessableObjects.size(); ++i)
+    if (d->lstProcessableObjects[i].threadId == currentThreadId)
+      return d->lstProcessableObjects[i].iOriginTime;
+
+  return d->iOriginTime;
+}
+
+int PiiInputSocket::batchSize() const
+{
+  const PII_D;
+  // Batches are never collected in multi-threaded mode. The first
+  // object may be thread-specific.
+  if (d->vecBatchObjects.isEmpty())
+    return firstObject().isValid() ? 1 : 0;
+  return d->vecBatchObjects.size() + 1;
+}
+
+PiiVariant PiiInputSocket::batchObject(int index) const
+{
+  const PII_D;
+  if (index == 0)
+    return firstObject();
+  return d->vecBatchObjects.value(index-1);
+}
+
 
 PiiInputController* PiiInputSocket::controller() const { return _d()->pController; }
-PiiVariant PiiInputSocket::queuedObject(int index) const { return _d()->lstQueue[queueIndex(index)]; }
-unsigned int PiiInputSocket::queuedType(int index) const { return _d()->lstQueue[queueIndex(index)].type(); }
-int PiiInputSocket::queueLength() const { return _d()->iQueueLength; }
-int PiiInputSocket::queueCapacity() const { return _d()->lstQueue.size(); }
-bool PiiInputSocket::canReceive() const { return _d()->lstQueue.size() > _d()->iQueueLength; }
+// The queue is filled by the sender without a lock. Slots beyond
+// size() may be being written; size() also makes the published ones
+// visible to this thread. The queue is appended last in receive(),
+// so the time stamps of a published object are visible as well.
+PiiVariant PiiInputSocket::queuedObject(int index) const
+{
+  const PII_D;
+  return index < d->queue.size() ? d->queue[index] : PiiVariant();
+}
+
+unsigned int PiiInputSocket::queuedType(int index) const
+{
+  const PII_D;
+  return index < d->queue.size() ? d->queue[index].type() : PiiVariant::InvalidType;
+}
+
+qint64 PiiInputSocket::queuedTimestamp(int index) const
+{
+  const PII_D;
+  return index < d->queue.size() ? d->timestamps[index] : 0;
+}
+
+qint64 PiiInputSocket::queuedOriginTime(int index) const
+{
+  const PII_D;
+  return index < d->queue.size() ? d->originTimes[index] : 0;
+}
+
+int PiiInputSocket::queueLength() const { return _d()->queue.size(); }
+int PiiInputSocket::queueCapacity() const { return _d()->queue.capacity(); }
+bool PiiInputSocket::canReceive() const
+{
+  const PII_D;
+  if (d->hasRoom())
+    return true;
+  // The sender is going to wait. The flag must be set before checking
+  // again. Otherwise shift() could make room in between and not wake
+  // the sender up.
+  d->iReceiveWait.fetchAndStore(1);
+  if (!d->hasRoom())
+    return false;
+  d->iReceiveWait.testAndSet(1, 0);
+  return true;
+}
+
+void PiiInputSocket::setQueueMemoryLimit(qint64 queueMemoryLimit) { _d()->queueBudget.setLimit(queueMemoryLimit); }
+qint64 PiiInputSocket::queueMemoryLimit() const { return _d()->queueBudget.limit(); }
+qint64 PiiInputSocket::queuedBytes() const { return _d()->queueBudget.usedBytes(); }
+void PiiInputSocket::setMemoryBudget(PiiMemoryBudget* budget) { _d()->queueBudget.setParent(budget); }
+PiiMemoryBudget* PiiInputSocket::memoryBudget() const { return _d()->queueBudget.parent(); }
 void PiiInputSocket::setOptional(bool optional) { _d()->bOptional = optional; }
 bool PiiInputSocket::isOptional() const { return _d()->bOptional; }
 
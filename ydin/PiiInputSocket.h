@@ -19,8 +19,12 @@
 #include "PiiSocket.h"
 #include "PiiAbstractInputSocket.h"
 #include "PiiInputController.h"
+#include "PiiMemoryBudget.h"
+
+#include <PiiRingBuffer.h>
 
 #include <QVarLengthArray>
+#include <QVector>
 #include <QPair>
 
 class PiiOutputSocket;
@@ -70,6 +74,13 @@ class PiiOutputSocket;
  * can be retrieved with [firstObject()]. New objects may then appear
  * at any time until the queue is full again.
  *
+ * The input queue is a lock-free [single-producer/single-consumer
+ * ring buffer](PiiRingBuffer). The connected output socket may
+ * [receive()] objects while the parent operation's flow controller
+ * inspects and [shift()]s the queue in another thread. All other
+ * functions that modify the queue must be called by the consumer
+ * side only.
+ *
  */
 class PII_YDIN_EXPORT PiiInputSocket : public PiiAbstractInputSocket
 {
@@ -84,6 +95,17 @@ class PII_YDIN_EXPORT PiiInputSocket : public PiiAbstractInputSocket
    */
   Q_PROPERTY(int queueCapacity READ queueCapacity WRITE setQueueCapacity);
 
+  /**
+   * The maximum number of bytes of matrix data held in the input
+   * queue. If the queued objects take this much memory, the socket
+   * accepts new objects only when the queue is empty. The queue is
+   * also throttled if the budget of an enclosing compound
+   * ([PiiOperationCompound::memoryLimit]) or the global budget
+   * (PiiMemoryBudget::global()) is exceeded. Zero means no limit,
+   * which is the default.
+   */
+  Q_PROPERTY(qint64 queueMemoryLimit READ queueMemoryLimit WRITE setQueueMemoryLimit);
+
 public:
   /**
    * Constructs a new input socket with the given name.
@@ -136,10 +158,22 @@ public:
    * Moves the queue one step forwards. The current head of the queue
    * will be moved out of the queue so that it can be retrieved with
    * [firstObject()]. Once the queue is successfully shifted, the
-   * socket signals inputReady().
+   * socket signals inputReady(). Shifting starts a new batch that
+   * initially contains only the first object.
    */
   void shift();
 
+  /**
+   * Moves the head of the queue to the end of the current batch
+   * without replacing [firstObject()]. This function is used by flow
+   * controllers to collect more than one set of synchronized objects
+   * for a single processing round. Once the queue is successfully
+   * shifted, the socket signals inputReady().
+   *
+   * @see PiiDefaultOperation::batchSize
+   */
+  void shiftToBatch();
+
   /**
    * Assigns the first object in the input queue to the specified
    * thread. If the input object is assigned to a thread,
@@ -181,13 +215,41 @@ public:
    */
   void receive(const PiiVariant& obj);
 
+  /**
+   * Makes `obj` the [firstObject()] without passing it through the
+   * input queue. This function is used by processors of
+   * [fused](PiiOperationCompound::chainFusion) operations that
+   * receive an ordinary object into an empty queue. Like [shift()],
+   * starts a new batch.
+   */
+  void receiveFirst(const PiiVariant& obj);
+
   /**
    * Checks if the input queue in this socket still has room for a new
-   * object. This function is a shorthand for queueCapacity() >
-   * queueLength().
+   * object. The queue has room if queueCapacity() > queueLength()
+   * and the memory budget of the queue is not exceeded. An empty
+   * queue can always receive.
    */
   bool canReceive() const;
 
+  void setQueueMemoryLimit(qint64 queueMemoryLimit);
+  qint64 queueMemoryLimit() const;
+
+  /**
+   * Returns the number of bytes of matrix data in the input queue,
+   * in the accuracy of PiiMemoryBudget.
+   */
+  qint64 queuedBytes() const;
+
+  /**
+   * Sets the budget the memory held by the input queue is charged
+   * to in addition to the socket's own budget. The default is
+   * PiiMemoryBudget::global(). PiiBasicOperation::check() sets the
+   * budget to that of the parent compound.
+   */
+  void setMemoryBudget(PiiMemoryBudget* budget);
+  PiiMemoryBudget* memoryBudget() const;
+
   /**
    * Sets the input queue capacity.
    */
@@ -210,9 +272,34 @@ public:
 
   /**
    * Returns the type ID of the object at `index` in the input queue.
+   * If there is no such object, PiiVariant::InvalidType will be
+   * returned.
    */
   unsigned int queuedType(int index) const;
 
+  /**
+   * Returns the time when the object at `index` in the input queue
+   * was received, as returned by PiiTimer::timestamp(). Flow
+   * controllers use this value for enforcing the
+   * [latency budget](PiiDefaultOperation::latencyBudget). If there
+   * is no such object, zero will be returned.
+   */
+  qint64 queuedTimestamp(int index) const;
+
+  /**
+   * Returns the [origin time](PiiYdin::currentOriginTime()) of the
+   * object at `index` in the input queue. Zero means unknown.
+   */
+  qint64 queuedOriginTime(int index) const;
+
+  /**
+   * Returns the [origin time](PiiYdin::currentOriginTime()) of
+   * [firstObject()]. In batch mode, the oldest origin in the batch is
+   * returned. Like [firstObject()], the value is thread-specific if
+   * [assignFirstObject()] has been called. Zero means unknown.
+   */
+  qint64 originTime() const;
+
   /**
    * Returns the object that was last shifted from the input queue. If
    * no objects have been shifted, an invalid variant will be
@@ -227,6 +314,33 @@ public:
    */
   PiiVariant firstObject() const;
 
+  /**
+   * Returns the number of objects in the current batch. If the parent
+   * operation doesn't process in batches, the batch consists of the
+   * [first object](firstObject()) only, and the number is one.
+   * Returns zero if no objects have been shifted.
+   *
+   * ! Batches are not supported in multi-threaded processing.
+   * Therefore, the thread-specific objects set by
+   * [assignFirstObject()] are always single-object batches.
+   */
+  int batchSize() const;
+
+  /**
+   * Returns the object at *index* in the current batch. The first
+   * object in the batch is the same as [firstObject()]. The objects at
+   * the same index in all synchronized inputs belong together.
+   *
+   * ~~~(c++)
+   * void MyOperation::process()
+   * {
+   *   for (int i=0; i<_pInput->batchSize(); ++i)
+   *     emitObject(doSomething(_pInput->batchObject(i)));
+   * }
+   * ~~~
+   */
+  PiiVariant batchObject(int index) const;
+
   /**
    * Sets the input controller. The controller must be set before the
    * input can receive objects. This is done automatically by
@@ -247,24 +361,51 @@ protected:
     Data();
 
     bool setInputConnected(bool connected);
+    // True if the queue can take one more object.
+    bool hasRoom() const;
 
     int iGroupId;
     bool bConnected;
     bool bOptional;
     PiiInputController* pController;
-    QVarLengthArray<PiiVariant, 4> lstQueue;
+    // Written by the emitting thread, read by the flow controller.
+    PiiRingBuffer<PiiVariant> queue;
+    // Reception times of the objects in queue. Always appended before
+    // the object so that the consumer never sees an object without a
+    // time stamp.
+    PiiRingBuffer<qint64> timestamps;
+    // Origin times of the objects in queue, appended together with
+    // the reception times.
+    PiiRingBuffer<qint64> originTimes;
+    // Charged for the objects in queue. The parent is the budget set
+    // with setMemoryBudget().
+    PiiMemoryBudget queueBudget;
+    // Set by canReceive() when it is about to refuse because the
+    // queue is full or the budget is exceeded, cleared by the
+    // consumer when it wakes up the sender.
+    mutable PiiAtomicInt iReceiveWait;
     PiiVariant varProcessableObject;
-    QVarLengthArray<QPair<Qt::HANDLE, PiiVariant> > lstProcessableObjects;
-    int iQueueStart, iQueueLength;
+    // The oldest origin time of varProcessableObject and
+    // vecBatchObjects.
+    qint64 iOriginTime;
+    // Objects shifted after varProcessableObject in batch mode.
+    QVector<PiiVariant> vecBatchObjects;
+    struct ProcessableObject
+    {
+      ProcessableObject(Qt::HANDLE id = 0, const PiiVariant& obj = PiiVariant(), qint64 originTime = 0) :
+        threadId(id), object(obj), iOriginTime(originTime)
+      {}
+      Qt::HANDLE threadId;
+      PiiVariant object;
+      qint64 iOriginTime;
+    };
+    QVarLengthArray<ProcessableObject> lstProcessableObjects;
     mutable QMutex firstObjectMutex;
   };
   PII_D_FUNC;
 
   /// @internal
   PiiInputSocket(const QString& name, Data* data);
-
-private:
-  inline int queueIndex(int index) const { return (_d()->iQueueStart+index) % _d()->lstQueue.size(); }
 };
 
 Q_DECLARE_METATYPE(PiiInputSocket*);
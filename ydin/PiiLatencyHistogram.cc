@@ -0,0 +1,80 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiLatencyHistogram.h"
+
+PiiLatencyHistogram::PiiLatencyHistogram()
+{
+  clear();
+}
+
+void PiiLatencyHistogram::clear()
+{
+  _iCount = _iTotal = _iMax = 0;
+  for (int i=0; i<BinCount; ++i)
+    _aBins[i] = 0;
+}
+
+void PiiLatencyHistogram::merge(const PiiLatencyHistogram& other)
+{
+  _iCount += other._iCount;
+  _iTotal += other._iTotal;
+  _iMax = qMax(_iMax, other._iMax);
+  for (int i=0; i<BinCount; ++i)
+    _aBins[i] += other._aBins[i];
+}
+
+qint64 PiiLatencyHistogram::binLimit(int bin)
+{
+  if (bin < SubBinCount)
+    return bin;
+  int iShift = bin / SubBinCount - 1;
+  qint64 iMantissa = bin % SubBinCount + SubBinCount;
+  return ((iMantissa + 1) << iShift) - 1;
+}
+
+qint64 PiiLatencyHistogram::percentile(double fraction) const
+{
+  if (_iCount == 0)
+    return 0;
+  // The rank of the requested sample, starting at one.
+  qint64 iRank = qint64(qBound(0.0, fraction, 1.0) * _iCount + 0.5);
+  if (iRank < 1)
+    iRank = 1;
+  qint64 iCumulative = 0;
+  for (int i=0; i<BinCount; ++i)
+    {
+      iCumulative += _aBins[i];
+      // The last bin has no upper limit.
+      if (iCumulative >= iRank)
+        return i < BinCount - 1 ? qMin(binLimit(i), _iMax) : _iMax;
+    }
+  return _iMax;
+}
+
+#ifndef PII_NO_QT
+QVariantMap PiiLatencyHistogram::toMap() const
+{
+  QVariantMap mapResult;
+  mapResult["count"] = _iCount;
+  mapResult["mean"] = mean();
+  mapResult["median"] = percentile(0.5);
+  mapResult["p90"] = percentile(0.9);
+  mapResult["p99"] = percentile(0.99);
+  mapResult["p999"] = percentile(0.999);
+  mapResult["max"] = _iMax;
+  return mapResult;
+}
+#endif
@@ -0,0 +1,119 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIILATENCYHISTOGRAM_H
+#define _PIILATENCYHISTOGRAM_H
+
+#include "PiiYdin.h"
+
+#ifndef PII_NO_QT
+#  include <QVariantMap>
+#endif
+
+/**
+ * A fixed-size histogram for end-to-end latencies. Unlike
+ * PiiOperationStatistics::Histogram, whose bins are one octave wide,
+ * each octave is divided into [SubBinCount] bins. Percentiles can
+ * thus be read with a relative error of about six per cent, which is
+ * enough for checking a latency against a deadline. Adding a
+ * measurement takes constant time and never allocates memory.
+ *
+ * ~~~(c++)
+ * PiiLatencyHistogram histogram;
+ * histogram.add(PiiTimer::timestamp() - PiiYdin::currentOriginTime());
+ * qint64 iWorstCase = histogram.percentile(0.99);
+ * ~~~
+ *
+ * The class is not thread-safe.
+ */
+class PII_YDIN_EXPORT PiiLatencyHistogram
+{
+public:
+  enum
+  {
+    /// The number of bits of precision in each octave.
+    SubBinBits = 4,
+    /// The number of bins in each octave.
+    SubBinCount = 1 << SubBinBits,
+    /**
+     * The total number of bins. Latencies below [SubBinCount]
+     * microseconds are stored exactly. The last bin collects
+     * everything longer than 2^36 microseconds.
+     */
+    BinCount = (36 - SubBinBits + 1) * SubBinCount
+  };
+
+  PiiLatencyHistogram();
+
+  /**
+   * Adds a latency of *usecs* microseconds to the histogram.
+   * Negative values are treated as zero.
+   */
+  inline void add(qint64 usecs)
+  {
+    if (usecs < 0)
+      usecs = 0;
+    ++_iCount;
+    _iTotal += usecs;
+    if (usecs > _iMax)
+      _iMax = usecs;
+    ++_aBins[binIndex(usecs)];
+  }
+
+  void merge(const PiiLatencyHistogram& other);
+  void clear();
+
+  /// Returns the number of latencies recorded.
+  qint64 count() const { return _iCount; }
+  /// Returns the longest latency recorded, in microseconds.
+  qint64 max() const { return _iMax; }
+  /// Returns the mean latency in microseconds.
+  double mean() const { return _iCount > 0 ? double(_iTotal) / _iCount : 0.0; }
+
+  /**
+   * Returns the latency below which *fraction* (0-1) of the recorded
+   * latencies fall, in microseconds. The value is the upper limit of
+   * the bin that contains the percentile, and it is never larger
+   * than [max()]. Returns zero if the histogram is empty.
+   */
+  qint64 percentile(double fraction) const;
+
+#ifndef PII_NO_QT
+  /**
+   * Returns the histogram as a map that contains `count`, `mean`,
+   * `median`, `p90`, `p99`, `p999` and `max`. All times are in
+   * microseconds.
+   */
+  QVariantMap toMap() const;
+#endif
+
+private:
+  static inline int binIndex(qint64 usecs)
+  {
+    if (usecs < SubBinCount)
+      return int(usecs);
+    int iShift = 0;
+    while ((usecs >> iShift) >= 2*SubBinCount)
+      ++iShift;
+    int iBin = (iShift + 1) * SubBinCount + int(usecs >> iShift) - SubBinCount;
+    return iBin < BinCount ? iBin : BinCount - 1;
+  }
+  static qint64 binLimit(int bin);
+
+  qint64 _iCount, _iTotal, _iMax;
+  qint64 _aBins[BinCount];
+};
+
+#endif //_PIILATENCYHISTOGRAM_H
@@ -0,0 +1,79 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiMemoryBudget.h"
+
+PiiMemoryBudget::PiiMemoryBudget(PiiMemoryBudget* parent) :
+  _pParent(parent)
+{}
+
+PiiMemoryBudget::~PiiMemoryBudget()
+{
+  int iUsed = _iUsed.load();
+  for (PiiMemoryBudget* pBudget = _pParent; pBudget != 0; pBudget = pBudget->_pParent)
+    pBudget->_iUsed -= iUsed;
+}
+
+void PiiMemoryBudget::setParent(PiiMemoryBudget* parent)
+{
+  if (parent == _pParent)
+    return;
+  int iUsed = _iUsed.load();
+  for (PiiMemoryBudget* pBudget = _pParent; pBudget != 0; pBudget = pBudget->_pParent)
+    pBudget->_iUsed -= iUsed;
+  _pParent = parent;
+  for (PiiMemoryBudget* pBudget = _pParent; pBudget != 0; pBudget = pBudget->_pParent)
+    pBudget->_iUsed += iUsed;
+}
+
+PiiMemoryBudget* PiiMemoryBudget::parent() const { return _pParent; }
+
+void PiiMemoryBudget::setLimit(qint64 limit) { _iLimit.store(limit > 0 ? units(limit) : 0); }
+qint64 PiiMemoryBudget::limit() const { return qint64(_iLimit.load()) << 10; }
+
+qint64 PiiMemoryBudget::usedBytes() const { return qint64(_iUsed.load()) << 10; }
+
+void PiiMemoryBudget::add(int units)
+{
+  if (units == 0)
+    return;
+  for (PiiMemoryBudget* pBudget = this; pBudget != 0; pBudget = pBudget->_pParent)
+    pBudget->_iUsed += units;
+}
+
+bool PiiMemoryBudget::isLimited() const
+{
+  for (const PiiMemoryBudget* pBudget = this; pBudget != 0; pBudget = pBudget->_pParent)
+    if (pBudget->_iLimit.load() > 0)
+      return true;
+  return false;
+}
+
+bool PiiMemoryBudget::isExceeded() const
+{
+  for (const PiiMemoryBudget* pBudget = this; pBudget != 0; pBudget = pBudget->_pParent)
+    {
+      int iLimit = pBudget->_iLimit.load();
+      if (iLimit > 0 && pBudget->_iUsed.load() >= iLimit)
+        return true;
+    }
+  return false;
+}
+
+PiiMemoryBudget* PiiMemoryBudget::global()
+{
+  static PiiMemoryBudget budget;
+  return &budget;
+}
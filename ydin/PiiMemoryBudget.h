@@ -0,0 +1,122 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIMEMORYBUDGET_H
+#define _PIIMEMORYBUDGET_H
+
+#include "PiiYdin.h"
+#include <PiiAtomicInt.h>
+
+/**
+ * Accounts for the memory held by objects waiting in input queues.
+ * The capacity of an input queue (PiiInputSocket::queueCapacity) is
+ * a number of objects, which says little about memory consumption
+ * if the objects are large images. Budgets limit the total size of
+ * the queued objects in bytes.
+ *
+ * Budgets form a tree. Memory charged to a budget is charged to all
+ * of its parents as well. Each PiiInputSocket has a budget of its
+ * own ([PiiInputSocket::queueMemoryLimit]), whose parent is the
+ * budget of the compound that contains the socket's operation
+ * ([PiiOperationCompound::memoryLimit]). The tree ends at the
+ * [global()] budget. A budget is *exceeded* if it or any of its
+ * parents has a limit and has been charged at least as much memory.
+ * An input socket whose budget is exceeded accepts new objects only
+ * into an empty queue. This throttles producers, but ensures that
+ * one object always fits in, however large.
+ *
+ * ~~~(c++)
+ * // Don't keep more than 1 GB of queued data in the whole engine.
+ * PiiMemoryBudget::global()->setLimit(1 << 30);
+ * ~~~
+ *
+ * Only the payloads of matrices are accounted for (see
+ * PiiYdin::objectBytes()). A matrix shared by many queues is
+ * charged once per queue. Memory is accounted in units of one
+ * kilobyte, each object being rounded up to the next kilobyte.
+ * Charges are atomic. Changing limits and parents isn't
+ * synchronized with charging and should only be done while the
+ * engine is not running.
+ */
+class PII_YDIN_EXPORT PiiMemoryBudget
+{
+public:
+  /**
+   * Creates a new budget with the given *parent*. The budget has no
+   * limit initially.
+   */
+  PiiMemoryBudget(PiiMemoryBudget* parent = 0);
+  /**
+   * Releases all memory still charged to this budget from the
+   * parents.
+   */
+  ~PiiMemoryBudget();
+
+  /**
+   * Sets the parent budget. Memory charged to this budget is moved
+   * from the old parents to the new ones.
+   */
+  void setParent(PiiMemoryBudget* parent);
+  PiiMemoryBudget* parent() const;
+
+  /**
+   * Sets the maximum number of bytes that can be charged. Zero
+   * means no limit.
+   */
+  void setLimit(qint64 limit);
+  qint64 limit() const;
+
+  /**
+   * Returns the number of bytes currently charged.
+   */
+  qint64 usedBytes() const;
+
+  /**
+   * Charges *bytes* bytes to this budget and its parents.
+   */
+  void charge(qint64 bytes) { add(units(bytes)); }
+  /**
+   * Releases *bytes* bytes previously charged with [charge()].
+   */
+  void release(qint64 bytes) { add(-units(bytes)); }
+
+  /**
+   * Returns `true` if this budget or any of its parents has a limit.
+   */
+  bool isLimited() const;
+
+  /**
+   * Returns `true` if the charged memory has reached the limit in
+   * this budget or any of its parents.
+   */
+  bool isExceeded() const;
+
+  /**
+   * Returns the budget that all other budgets ultimately belong to.
+   * The global budget has no limit by default.
+   */
+  static PiiMemoryBudget* global();
+
+private:
+  static inline int units(qint64 bytes) { return int((bytes + 1023) >> 10); }
+  void add(int units);
+
+  PiiMemoryBudget* _pParent;
+  PiiAtomicInt _iUsed, _iLimit;
+
+  PII_DISABLE_COPY(PiiMemoryBudget);
+};
+
+#endif //_PIIMEMORYBUDGET_H
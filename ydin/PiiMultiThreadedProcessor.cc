@@ -15,52 +15,81 @@
 
 #include "PiiMultiThreadedProcessor.h"
 
+#include "PiiProfiler.h"
+
 #include <PiiTimer.h>
+#include <PiiSynchronized.h>
 
-class PiiMultiProcessorThread : public QThread
+/* A processing lane. Each lane represents one concurrent processing
+ * slot of the operation. While a lane is active, it is bound to a
+ * thread borrowed from PiiThreadPool. Lanes are either used for a
+ * single processing round (operations with connected inputs) or run
+ * freely until stopped (producers with no connected inputs).
+ */
+class PiiMultiProcessorThread : public PiiThreadPool::Task
 {
 public:
   PiiMultiProcessorThread(PiiMultiThreadedProcessor* processor) :
     _pProcessor(processor),
+    _pPool(processor->_pThreadPool),
+    _pThread(0),
     _threadId(0),
     _iGroupId(0),
-    _bFreeRun(false)
+    _bFreeRun(false),
+    _iLastRoundEnd(0)
   {}
 
+  // Binds the lane to a pooled thread.
+  void reserve(QThread::Priority priority, const QList<int>& cpus)
+  {
+    _pThread = _pPool->reserveThread(priority, cpus);
+    _threadId = _pPool->threadId(_pThread);
+  }
+
   void process(int groupId)
   {
     _iGroupId = groupId;
-    _iProcessCounter.ref();
-    _processCondition.wakeOne();
+    _bFreeRun = false;
+    _pPool->start(_pThread, this);
+  }
+
+  void start()
+  {
+    _bFreeRun = true;
+    _pPool->start(_pThread, this);
   }
 
   void stop()
   {
     _bFreeRun = false;
-    _processCondition.wakeOne();
   }
 
-  void start(Priority priority, bool freeRun = false)
+  // Waits until the pool has completely released the lane.
+  void wait()
   {
-    QMutexLocker lock(&_startMutex);
-    _bFreeRun = freeRun;
-    _iProcessCounter = 1;
-    QThread::start(priority);
-    _threadStartedCondition.wait(&_startMutex);
+    _pPool->waitForTask(this);
   }
 
   Qt::HANDLE id() const { return _threadId; }
 
   int group() const { return _iGroupId; }
 
-protected:
+  // The functions below must not be called by other threads while
+  // the lane is running.
+  PiiOperationStatistics::Collector& statistics() { return _statistics; }
+
+  void recordInputWait()
+  {
+    if (_iLastRoundEnd != 0)
+      _statistics.record(PiiOperationStatistics::InputWait,
+                         _iLastRoundEnd, PiiOperationStatistics::Collector::timestamp());
+  }
+
+  qint64 lastRoundEnd() const { return _iLastRoundEnd; }
+  void resetLastRoundEnd() { _iLastRoundEnd = 0; }
+
   void run()
   {
-    synchronized (_startMutex)
-      {
-        _threadId = QThread::currentThreadId();
-        _threadStartedCondition.wakeOne();
-      }
     QMutex* pThreadMutex = &_pProcessor->_threadMutex;
     try
       {
@@ -69,40 +98,15 @@ protected:
             while (_bFreeRun)
               {
                 synchronized (pThreadMutex) _pProcessor->startEmit(_threadId);
-                _pProcessor->process(); // may throw
-                _pProcessor->endEmit(_threadId); // may throw
+                processRound(); // may throw
+                _pProcessor->mergeStatistics(_statistics, _iLastRoundEnd);
               }
           }
         else
           {
-            PiiTimer tmr;
-            long iWaitTime = 0, iProcessTime = 0, iEndEmitTime = 0, iUnassignTime = 0;
-            forever
-              {
-                _processCondition.wait();
-                iWaitTime += tmr.restart();
-
-                // Each wake consumes one process round. Stop()
-                // doesn't increase the counter, which therefore
-                // reaches zero when the thread needs to exit.
-                if (!_iProcessCounter.deref())
-                  break;
-
-                // No startEmit() here; emission turns are assigned in tryToReceive()
-                _pProcessor->process(); // may throw
-                iProcessTime += tmr.restart();
-                _pProcessor->endEmit(_threadId); // may throw
-                iEndEmitTime += tmr.restart();
-                synchronized (pThreadMutex)
-                  {
-                    _pProcessor->unassignInputs(_iGroupId, _threadId);
-                    _pProcessor->processFinished(this);
-                  }
-                iUnassignTime += tmr.restart();
-              }
-            piiDebug("Thread %p times: wait %ld, process %ld, endEmit %ld, unassign %ld, total %ld",
-                     (void*)_threadId, iWaitTime, iProcessTime, iEndEmitTime, iUnassignTime,
-                     iWaitTime + iProcessTime + iEndEmitTime + iUnassignTime);
+            // No startEmit() here; emission turns are assigned in tryToReceive()
+            processRound(); // may throw
+            synchronized (pThreadMutex) _pProcessor->unassignInputs(_iGroupId, _threadId);
           }
         synchronized (pThreadMutex) _pProcessor->threadFinished(this);
       }
@@ -113,21 +117,60 @@ protected:
   }
 
 private:
+  void processRound()
+  {
+#ifndef PII_NO_OPERATION_STATISTICS
+    PiiProfiler* pProfiler = PiiProfiler::activeProfiler();
+    int iQueueLength = pProfiler != 0 ? _pProcessor->inputQueueLength() : 0;
+#endif
+    qint64 iStart, iProcessed;
+    {
+      PiiScheduler::Round round(_pProcessor->schedulingClass());
+      PiiMatrixAccounting::Scope accounting(_statistics.matrixCounters());
+      iStart = PiiOperationStatistics::Collector::timestamp();
+      _pProcessor->process(); // may throw
+      iProcessed = PiiOperationStatistics::Collector::timestamp();
+    }
+#ifndef PII_NO_OPERATION_STATISTICS
+    // The emission turn will be gone after endEmit().
+    int iEmittedCount = pProfiler != 0 ? _pProcessor->takeEmittedCount(_threadId) : 0;
+#endif
+    _pProcessor->endEmit(_threadId); // may throw
+    _iLastRoundEnd = PiiOperationStatistics::Collector::timestamp();
+    _statistics.record(PiiOperationStatistics::Processing, iStart, iProcessed);
+    _statistics.record(PiiOperationStatistics::EmissionStall, iProcessed, _iLastRoundEnd);
+#ifndef PII_NO_OPERATION_STATISTICS
+    if (pProfiler != 0)
+      {
+        PiiProfiler::Event event;
+        event.pOperation = _pProcessor->_pParentOp;
+        event.threadId = _threadId;
+        event.iStartTime = iStart;
+        event.iProcessedTime = iProcessed;
+        event.iEndTime = _iLastRoundEnd;
+        event.iQueueLength = iQueueLength;
+        event.iEmittedCount = iEmittedCount;
+        pProfiler->record(event);
+      }
+#endif
+  }
+
   PiiMultiThreadedProcessor* _pProcessor;
-  QMutex _startMutex;
-  QWaitCondition _threadStartedCondition;
-  PiiWaitCondition _processCondition;
+  PiiThreadPool* _pPool;
+  PiiThreadPool::Thread* _pThread;
   Qt::HANDLE _threadId;
   int _iGroupId;
-  bool _bFreeRun;
-  QAtomicInt _iProcessCounter;
+  volatile bool _bFreeRun;
+  PiiOperationStatistics::Collector _statistics;
+  qint64 _iLastRoundEnd;
 };
 
 PiiMultiThreadedProcessor::PiiMultiThreadedProcessor(PiiDefaultOperation* parent) :
   PiiOperationProcessor(parent),
-  _bReset(false), _bBlocked(false),
+  _bReset(false),
   _pStateMutex(&(parent->_d()->stateMutex)),
   _priority(QThread::InheritPriority),
+  _pThreadPool(PiiThreadPool::instance()),
   _bSingleInputGroup(false),
   _iSingleInputGroupId(0)
 {
@@ -137,6 +180,11 @@ PiiMultiThreadedProcessor::~PiiMultiThreadedProcessor()
 {
   QMutexLocker lock(&_threadMutex);
   destroyAllThreads();
+  for (ThreadList::const_iterator i=_lstFreeThreads.begin(); i!=_lstFreeThreads.end(); ++i)
+    {
+      (*i)->wait();
+      delete *i;
+    }
 }
 
 // _threadMutex must be held when calling this function
@@ -203,12 +251,18 @@ void PiiMultiThreadedProcessor::unassignInputs(int groupId, Qt::HANDLE threadId)
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread)
 {
-  _lstFinishedThreads << thread;
+  mergeStatistics(thread->statistics(), thread->lastRoundEnd());
   _lstAllThreads.removeOne(thread);
-  _lstFreeThreads.removeOne(thread);
-  _freeThreadCondition.wakeOne();
-  // If all threads are done, we may need to change state
-  if (_lstAllThreads.isEmpty())
+  // The most recently used lane will be reused first. This keeps the
+  // number of lanes in use small and makes the idle time of a lane a
+  // good estimate of the time the operation waits for input.
+  _lstFreeThreads.prepend(thread);
+  _freeThreadCondition.wakeAll();
+  // If all threads are done, we may need to change state. Stopping
+  // and pausing operations with connected inputs is handled in
+  // finish().
+  if (_lstAllThreads.isEmpty() &&
+      (_pFlowController == 0 || _pParentOp->state() == PiiOperation::Interrupted))
     {
       startEmit(thread->id());
       if (_pParentOp->state() == PiiOperation::Pausing)
@@ -225,13 +279,6 @@ void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread)
     }
 }
 
-// _threadMutex must be held when calling this function
-void PiiMultiThreadedProcessor::processFinished(PiiMultiProcessorThread* thread)
-{
-  _lstFreeThreads << thread;
-  _freeThreadCondition.wakeOne();
-}
-
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread, const PiiExecutionException& ex)
 {
@@ -247,27 +294,33 @@ void PiiMultiThreadedProcessor::threadFinished(PiiMultiProcessorThread* thread,
 // _threadMutex must be held when calling this function
 PiiMultiProcessorThread* PiiMultiThreadedProcessor::reserveThread()
 {
-  if (!_bReset)
-    return 0;
-
-  // Add new threads until the pool is full
-  if (_lstAllThreads.size() < _pParentOp->threadCount())
+  // The concurrency limit may change while running. Lanes beyond
+  // the limit stay in the free list until it is raised again.
+  while (_lstAllThreads.size() >= _pParentOp->threadCount())
     {
-      PiiMultiProcessorThread* pThread = new PiiMultiProcessorThread(this);
-      pThread->setObjectName(_pParentOp->objectName());
-      _lstAllThreads << pThread;
-      // If there is no flow controller, let the thread run freely
-      pThread->start(_priority, _pFlowController == 0);
-      return pThread;
+      if (!_bReset || _pParentOp->state() == PiiOperation::Interrupted)
+        return 0;
+      _freeThreadCondition.wait(&_threadMutex);
     }
-  else if (!_lstFreeThreads.isEmpty())
-    return _lstFreeThreads.takeFirst();
 
-  _freeThreadCondition.wait(&_threadMutex);
-  // This may happen if a thread fails
-  if (_lstFreeThreads.size() == 0)
+  // Create new lanes until the concurrency limit has been reached.
+  if (_lstFreeThreads.isEmpty())
+    _lstFreeThreads << new PiiMultiProcessorThread(this);
+
+  if (!_bReset)
     return 0;
-  return _lstFreeThreads.takeFirst();
+
+  PiiMultiProcessorThread* pThread = _lstFreeThreads.takeFirst();
+  // The lane may still be returning from its previous round.
+  pThread->wait();
+  if (_pFlowController != 0)
+    pThread->recordInputWait();
+  pThread->reserve(_priority, affinityCpus());
+  _lstAllThreads << pThread;
+  // If there is no flow controller, let the thread run freely
+  if (_pFlowController == 0)
+    pThread->start();
+  return pThread;
 }
 
 // _threadMutex must be held when calling this function
@@ -307,18 +360,6 @@ bool PiiMultiThreadedProcessor::waitAllThreadsToExit(unsigned long time)
       if ((unsigned long)timer.milliseconds() > time)
         return false;
     }
-
-  // All threads should now be in _lstFinishedThreads.
-  Q_ASSERT(_lstFreeThreads.isEmpty());
-
-  // This waits until the threads are really done.
-  for (ThreadList::const_iterator i=_lstFinishedThreads.begin(); i!=_lstFinishedThreads.end(); ++i)
-    {
-      (*i)->wait();
-      delete *i;
-    }
-  _lstFinishedThreads.clear();
-
   return true;
 }
 
@@ -326,7 +367,7 @@ bool PiiMultiThreadedProcessor::waitAllThreadsToExit(unsigned long time)
 // _threadMutex must be held when calling this function
 void PiiMultiThreadedProcessor::waitAllThreadsToStop()
 {
-  while (_lstFreeThreads.size() < _lstAllThreads.size())
+  while (_lstAllThreads.size() > 0)
     _freeThreadCondition.wait(&_threadMutex);
 }
 
@@ -339,29 +380,39 @@ void PiiMultiThreadedProcessor::finish(Qt::HANDLE callingThreadId, PiiOperation:
         _pParentOp->setState(finalState == PiiOperation::Stopped ?
                              PiiOperation::Stopping :
                              PiiOperation::Pausing);
-      destroyAllThreads();
+      // Let the rounds that are already running finish first.
+      waitAllThreadsToStop();
+      // If the operation was interrupted meanwhile, threadFinished()
+      // has already changed the state.
+      if (_pParentOp->state() not_member_of (PiiOperation::Stopping, PiiOperation::Pausing))
+        return;
     }
-  else
+
+  startEmit(callingThreadId);
+  try
     {
-      startEmit(callingThreadId);
-      try
-        {
-          if (finalState == PiiOperation::Paused)
-            _pParentOp->operationPaused(); // throws
-          else
-            _pParentOp->operationStopped(); // throws
-        }
-      catch (...)
-        {}
-      synchronized (_pStateMutex) _pParentOp->setState(finalState);
-      endEmit(callingThreadId);
+      if (finalState == PiiOperation::Paused)
+        _pParentOp->operationPaused(); // throws
+      else
+        _pParentOp->operationStopped(); // throws
     }
+  catch (...)
+    {}
+  synchronized (_pStateMutex) _pParentOp->setState(finalState);
+  endEmit(callingThreadId);
 }
 
 /* Flow control (prepareProcess) is ran in the calling thread. If it
  * creates sync events, all active threads are waited before sync
  * events are sent.
  *
+ * Objects are received without locking because input queues are
+ * single-producer/single-consumer ring buffers. Only one thread at a
+ * time runs the flow controller. If another thread is already doing
+ * it, the calling thread just increases _iFlowControlRequests and
+ * returns. The thread running the flow controller loops until it has
+ * seen all requests.
+ *
  * Whenever a processing round needs to be started, input objects are
  * first assigned to a thread allocated from the thread pool. The
  * thread is also given an output turn in each output socket. Once the
@@ -369,12 +420,8 @@ void PiiMultiThreadedProcessor::finish(Qt::HANDLE callingThreadId, PiiOperation:
  * released and the output turn ended.
  */
 
-static long iIdleTime = 0, iSyncTime = 0, iReserveThreadTime = 0, iAssignInputsTime = 0, iStartEmitTime = 0, iStartProcessTime = 0;
-
 bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ()
 {
-  static PiiTimer tmr;
-  iIdleTime += tmr.restart();
   synchronized (_pStateMutex)
     {
       // If the processor has not been initialized for execution, we
@@ -386,22 +433,41 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
         _pParentOp->setState(PiiOperation::Running);
     }
 
-  try
-    {
-      QMutexLocker lock(&_threadMutex);
+  PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
+  if (!pInput->canReceive())
+    return false;
 
-      PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-      if (!pInput->canReceive())
-        return false;
+  pInput->receive(object);
+  recordProducerNode();
 
-      pInput->receive(object);
+  /*qDebug("%s: %d objects in queue",
+         qPrintable(pInput->objectName()), pInput->queueLength());
+  */
+  if (_iFlowControlRequests++ != 0)
+    return true;
 
-      /*PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-      qDebug("%s: %d objects in queue",
-             qPrintable(pInput->objectName()), pInput->queueLength());
-      */
-      if (_bBlocked)
-        return true;
+  int iRequests;
+  do
+    {
+      iRequests = _iFlowControlRequests.load();
+      if (!prepareAndProcess())
+        {
+          _iFlowControlRequests.store(0);
+          break;
+        }
+    }
+  while ((_iFlowControlRequests -= iRequests) != 0);
+
+  return true;
+}
+
+// Returns false if the processor must stop handling input due to
+// an error.
+bool PiiMultiThreadedProcessor::prepareAndProcess()
+{
+  try
+    {
+      QMutexLocker lock(&_threadMutex);
 
       Qt::HANDLE callingThreadId = QThread::currentThreadId();
       do
@@ -419,8 +485,6 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
               break;
             }
 
-          _bBlocked = true;
-
           // Must ensure sync events are not sent concurrently
           // with process().
           if (_pFlowController->hasSyncEvents())
@@ -436,24 +500,18 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
           endEmit(callingThreadId); // may throw
 
           lock.relock();
-          _bBlocked = false;
 
-          iSyncTime += tmr.restart();
           switch (state)
             {
             case PiiFlowController::ProcessableState:
               {
                 PiiMultiProcessorThread* pThread = reserveThread();
-                iReserveThreadTime += tmr.restart();
                 if (pThread == 0)
                   PII_THROW(PiiExecutionException, _pParentOp->tr("Could not reserve a thread."));
                 int iGroup = _pFlowController->activeInputGroup();
                 assignInputs(iGroup, pThread->id());
-                iAssignInputsTime += tmr.restart();
                 startEmit(pThread->id());
-                iStartEmitTime += tmr.restart();
                 pThread->process(iGroup); // starts processing in another thread
-                iStartProcessTime += tmr.restart();
               }
             case PiiFlowController::SynchronizedState:
             case PiiFlowController::IncompleteState:
@@ -487,8 +545,6 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
       // above. Therefore, the mutex is not held if we are here. Must relock.
       QMutexLocker lock(&_threadMutex);
 
-      _bBlocked = false;
-
       // Only errors are handled here. Stopping/pausing is handled
       // in threadFinished().
       emit _pParentOp->errorOccured(_pParentOp, ex.message());
@@ -500,15 +556,22 @@ bool PiiMultiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender, con
         }
       destroyAllThreads();
       synchronized (_pStateMutex) _pParentOp->setState(PiiOperation::Stopped);
+      return false;
     }
 
-  return true;
+  return _bReset;
 }
 
 
 void PiiMultiThreadedProcessor::check(bool reset)
 {
-  _bBlocked = false;
+  _iFlowControlRequests.store(0);
+  // Time spent while stopped or paused is not input wait.
+  synchronized (_threadMutex)
+    {
+      for (ThreadList::iterator i=_lstFreeThreads.begin(); i!=_lstFreeThreads.end(); ++i)
+        (*i)->resetLastRoundEnd();
+    }
   if (reset)
     _bReset = true;
 
@@ -548,8 +611,22 @@ void PiiMultiThreadedProcessor::check(bool reset)
         }
     }
 
-  qDeleteAll(_lstFinishedThreads);
-  _lstFinishedThreads.clear();
+}
+
+void PiiMultiThreadedProcessor::threadCountChanged()
+{
+  synchronized (_threadMutex)
+    {
+      _freeThreadCondition.wakeAll();
+      // Free-running lanes never return to the free list. Start the
+      // missing ones right away.
+      if (_pFlowController == 0 && _pParentOp->state() == PiiOperation::Running)
+        {
+          for (int i=_lstAllThreads.size(); i<_pParentOp->threadCount(); ++i)
+            if (reserveThread() == 0)
+              break;
+        }
+    }
 }
 
 void PiiMultiThreadedProcessor::start()
@@ -597,7 +674,7 @@ void PiiMultiThreadedProcessor::interrupt()
       if (_lstAllThreads.size() > 0)
         {
           _pParentOp->setState(PiiOperation::Interrupted);
-          // This may leave some dead threads in _lstFinishedThreads.
+          // Running lanes change the state once they are done.
           stopAllThreads();
         }
       // No threads running -> stop directly
@@ -617,7 +694,7 @@ void PiiMultiThreadedProcessor::pause()
   // immediately. Otherwise tryToReceive() will change the state when
   // it receives the stop tags.
   if (_pFlowController == 0)
-    // This may leave some dead threads in _lstFinishedThreads.
+    // The last lane to finish changes the state.
     synchronized (_threadMutex) stopAllThreads();
 }
 
@@ -647,9 +724,6 @@ void PiiMultiThreadedProcessor::reconfigure(const QString& propertySetName)
 
 void PiiMultiThreadedProcessor::stop()
 {
-  piiDebug("Spawner times: idle %ld, sync %ld, reserve %ld, assign %ld, startEmit %ld, startProcess %ld, total %ld",
-           iIdleTime, iSyncTime, iReserveThreadTime, iAssignInputsTime, iStartEmitTime, iStartProcessTime,
-           iIdleTime + iSyncTime + iReserveThreadTime + iAssignInputsTime + iStartEmitTime + iStartProcessTime);
   QMutexLocker lock(_pStateMutex);
   if (_pParentOp->state() != PiiOperation::Running)
     return;
@@ -675,6 +749,16 @@ QThread::Priority PiiMultiThreadedProcessor::processingPriority() const
   return _priority;
 }
 
+void PiiMultiThreadedProcessor::flushStatistics()
+{
+  // Running lanes flush their measurements once they are done.
+  synchronized (_threadMutex)
+    {
+      for (ThreadList::iterator i=_lstFreeThreads.begin(); i!=_lstFreeThreads.end(); ++i)
+        mergeStatistics((*i)->statistics());
+    }
+}
+
 int PiiMultiThreadedProcessor::activeInputGroup() const
 {
   // If there is only one input group, return its ID.
@@ -18,12 +18,18 @@
 
 #include "PiiOperationProcessor.h"
 #include "PiiInputListener.h"
+#include "PiiThreadPool.h"
+
+#include <PiiAtomicInt.h>
 
 class PiiMultiProcessorThread;
 
 /**
- * A processor that creates a user-defined number of threads into a
- * pool and calls process() concurrently from them.
+ * A processor that calls process() concurrently from many threads.
+ * The threads are borrowed from the application-wide PiiThreadPool
+ * for one processing round at a time. At most
+ * [threadCount](PiiDefaultOperation::threadCount) rounds will be
+ * running at once.
  *
  * @internal
  */
@@ -46,6 +52,8 @@ public:
   void setProcessingPriority(QThread::Priority priority);
   QThread::Priority processingPriority() const;
   int activeInputGroup() const;
+  void flushStatistics();
+  void threadCountChanged();
 
   void inputReady(PiiAbstractInputSocket* input);
 
@@ -59,7 +67,6 @@ private:
   void assignInputs(int groupId, Qt::HANDLE threadId);
   void unassignInputs(int groupId, Qt::HANDLE threadId);
   void threadFinished(PiiMultiProcessorThread* thread);
-  void processFinished(PiiMultiProcessorThread* thread);
   void threadFinished(PiiMultiProcessorThread* thread, const PiiExecutionException& ex);
   PiiMultiProcessorThread* reserveThread();
   void startAllThreads();
@@ -68,14 +75,18 @@ private:
   bool waitAllThreadsToExit(unsigned long time = ULONG_MAX);
   void waitAllThreadsToStop();
 
+  bool prepareAndProcess();
   inline void process() { _pParentOp->processLocked(); }
 
   volatile bool _bReset;
-  bool _bBlocked;
+  PiiAtomicInt _iFlowControlRequests;
   QMutex* _pStateMutex;
   QThread::Priority _priority;
+  PiiThreadPool* _pThreadPool;
   typedef QLinkedList<PiiMultiProcessorThread*> ThreadList;
-  ThreadList _lstAllThreads, _lstFinishedThreads, _lstFreeThreads;
+  // Lanes that are currently running in a pooled thread and lanes
+  // that are ready to be reused.
+  ThreadList _lstAllThreads, _lstFreeThreads;
   QWaitCondition _freeThreadCondition;
   PiiWaitCondition _freeInputCondition;
   QMutex _threadMutex;
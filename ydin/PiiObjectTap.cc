@@ -0,0 +1,126 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiObjectTap.h"
+
+#include <QMutex>
+#include <PiiRingBuffer.h>
+
+#include "PiiYdinTypes.h"
+
+class PiiObjectTap::Data :
+  public PiiAbstractInputSocket::Data,
+  public PiiInputController
+{
+public:
+  Data() :
+    samples(16),
+    iSampleInterval(0),
+    iReceivedCount(0),
+    bDiscardControlObjects(true)
+  {}
+
+  // Runs in the emitting thread and is the only producer for the
+  // ring buffer.
+  bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+
+  PiiRingBuffer<PiiVariant> samples;
+  int iSampleInterval;
+  int iReceivedCount;
+  bool bDiscardControlObjects;
+  PiiAtomicInt iRequestedCount, iDroppedCount;
+  // Serializes readers. Never touched by the emitter.
+  QMutex readerMutex;
+};
+
+PiiObjectTap::PiiObjectTap(const QString& name) :
+  PiiAbstractInputSocket(name, new Data)
+{}
+
+PiiObjectTap::PiiObjectTap(PiiAbstractOutputSocket* output) :
+  PiiAbstractInputSocket("tap", new Data)
+{
+  connectOutput(output);
+}
+
+PiiObjectTap::~PiiObjectTap()
+{}
+
+bool PiiObjectTap::Data::tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
+{
+  if (bDiscardControlObjects && PiiYdin::isControlType(object.type()))
+    return true;
+
+  bool bRecord = false;
+  if (iSampleInterval > 0 && ++iReceivedCount >= iSampleInterval)
+    {
+      iReceivedCount = 0;
+      bRecord = true;
+    }
+  // Only this thread decrements the counter. Readers may increase it
+  // concurrently, but it cannot drop below zero.
+  if (iRequestedCount.load() > 0)
+    {
+      --iRequestedCount;
+      bRecord = true;
+    }
+
+  if (bRecord)
+    {
+      if (samples.isFull())
+        ++iDroppedCount;
+      else
+        samples.append(object);
+    }
+  return true;
+}
+
+void PiiObjectTap::requestSamples(int count)
+{
+  if (count > 0)
+    _d()->iRequestedCount += count;
+}
+
+QList<PiiVariant> PiiObjectTap::takeSamples()
+{
+  PII_D;
+  QList<PiiVariant> lstSamples;
+  QMutexLocker lock(&d->readerMutex);
+  while (!d->samples.isEmpty())
+    lstSamples << d->samples.takeFirst();
+  return lstSamples;
+}
+
+PiiInputController* PiiObjectTap::controller() const { return const_cast<Data*>(_d()); }
+
+void PiiObjectTap::setSampleInterval(int sampleInterval)
+{
+  PII_D;
+  d->iSampleInterval = qMax(sampleInterval, 0);
+  d->iReceivedCount = 0;
+}
+int PiiObjectTap::sampleInterval() const { return _d()->iSampleInterval; }
+
+void PiiObjectTap::setCapacity(int capacity)
+{
+  PII_D;
+  QMutexLocker lock(&d->readerMutex);
+  d->samples.setCapacity(capacity);
+}
+int PiiObjectTap::capacity() const { return _d()->samples.capacity(); }
+
+void PiiObjectTap::setDiscardControlObjects(bool discardControlObjects) { _d()->bDiscardControlObjects = discardControlObjects; }
+bool PiiObjectTap::discardControlObjects() const { return _d()->bDiscardControlObjects; }
+int PiiObjectTap::droppedCount() const { return _d()->iDroppedCount.load(); }
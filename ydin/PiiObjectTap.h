@@ -0,0 +1,124 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOBJECTTAP_H
+#define _PIIOBJECTTAP_H
+
+#include "PiiInputSocket.h"
+#include "PiiInputController.h"
+
+/**
+ * An input socket that records a sample of the objects passing
+ * through an output. Unlike PiiProbeInput, PiiObjectTap does nothing
+ * with the objects in the emitting thread: no signals, no locks and
+ * no formatting. Sampled objects are appended to a lock-free ring
+ * buffer (PiiRingBuffer) and stay there until a reader takes them
+ * out with [takeSamples()]. Inspecting the objects, e.g. converting
+ * them to text, is left to the reader. This makes it cheap enough
+ * to leave taps in a production engine.
+ *
+ * Objects can be sampled in two ways. If [sampleInterval] is N > 0,
+ * every Nth object is recorded. Independent of the interval,
+ * [requestSamples()] makes the tap record the next objects
+ * regardless of their position in the sequence.
+ *
+ * ~~~(c++)
+ * PiiObjectTap* tap = new PiiObjectTap(reader->output("image"));
+ * tap->setSampleInterval(100);
+ * // Later, in another thread
+ * QList<PiiVariant> lstImages = tap->takeSamples();
+ * ~~~
+ *
+ * If the ring buffer is full, new samples are dropped instead of
+ * blocking the emitter. The number of dropped samples is available
+ * as [droppedCount].
+ *
+ * ! The tap assumes that objects are emitted to it from one thread
+ * at a time, which is what PiiOutputSocket does. Any number of
+ * readers may call [takeSamples()] concurrently.
+ */
+class PII_YDIN_EXPORT PiiObjectTap :
+  public PiiAbstractInputSocket
+{
+  Q_OBJECT
+
+  /**
+   * Record every Nth object. Zero disables periodic sampling; objects
+   * are then recorded only on demand (see [requestSamples()]). The
+   * default value is zero.
+   */
+  Q_PROPERTY(int sampleInterval READ sampleInterval WRITE setSampleInterval);
+
+  /**
+   * The maximum number of samples held in the ring buffer. The
+   * default value is 16. Changing the capacity destroys all recorded
+   * samples. Don't change it while objects are being received.
+   */
+  Q_PROPERTY(int capacity READ capacity WRITE setCapacity);
+
+  /**
+   * Toggles filtering of control objects. If `true`, control objects
+   * are never recorded and they don't count towards
+   * [sampleInterval]. The default value is `true`.
+   */
+  Q_PROPERTY(bool discardControlObjects READ discardControlObjects WRITE setDiscardControlObjects);
+
+  /**
+   * The number of samples that were discarded because the ring
+   * buffer was full.
+   */
+  Q_PROPERTY(int droppedCount READ droppedCount);
+
+public:
+  /**
+   * Constructs a new tap and sets its `objectName` property to
+   * *name*.
+   */
+  PiiObjectTap(const QString& name = "tap");
+  /**
+   * Constructs a new tap and connects it to *output*.
+   */
+  PiiObjectTap(PiiAbstractOutputSocket* output);
+
+  ~PiiObjectTap();
+
+  /**
+   * Records the next *count* objects independent of
+   * [sampleInterval]. This function can be called from any thread.
+   */
+  Q_INVOKABLE void requestSamples(int count = 1);
+
+  /**
+   * Removes all recorded samples from the ring buffer and returns
+   * them, oldest first. This function can be called from any thread.
+   */
+  QList<PiiVariant> takeSamples();
+
+  void setSampleInterval(int sampleInterval);
+  int sampleInterval() const;
+  void setCapacity(int capacity);
+  int capacity() const;
+  void setDiscardControlObjects(bool discardControlObjects);
+  bool discardControlObjects() const;
+  int droppedCount() const;
+
+  PiiInputController* controller() const;
+
+private:
+  class Data;
+  PII_UNSAFE_D_FUNC;
+};
+
+#endif //_PIIOBJECTTAP_H
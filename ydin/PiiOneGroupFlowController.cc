@@ -46,6 +46,13 @@ void PiiOneGroupFlowController::shiftInputs()
     d->vecInputs[i]->shift();
 }
 
+void PiiOneGroupFlowController::emitObject(const PiiVariant& obj)
+{
+  PII_D;
+  for (int i=0; i<d->vecOutputs.size(); ++i)
+    d->vecOutputs[i]->emitObject(obj);
+}
+
 PiiFlowController::FlowState PiiOneGroupFlowController::prepareProcess()
 {
   PII_D;
@@ -54,6 +61,13 @@ PiiFlowController::FlowState PiiOneGroupFlowController::prepareProcess()
   switch (typeMask)
     {
     case NormalObject:
+      // Groups that have waited too long are replaced with a drop tag.
+      if (isExpired(d->vecInputs.begin(), d->vecInputs.end(), expiryTime()))
+        {
+          shiftInputs();
+          emitObject(PiiYdin::createDropTag());
+          return SynchronizedState;
+        }
       // All objects are there -> shift sockets and process
       shiftInputs();
       return ProcessableState;
@@ -64,14 +78,15 @@ PiiFlowController::FlowState PiiOneGroupFlowController::prepareProcess()
 
     case EndTag:
     case StartTag:
-      {
-        // Pass the tag
-        const PiiVariant& obj = d->vecInputs[0]->queuedObject(0);
-        for (int i=0; i<d->vecOutputs.size(); ++i)
-          d->vecOutputs[i]->emitObject(obj);
-        shiftInputs();
-        return SynchronizedState;
-      }
+      // Pass the tag
+      emitObject(d->vecInputs[0]->queuedObject(0));
+      shiftInputs();
+      return SynchronizedState;
+
+    case DropTag:
+      shiftInputs();
+      emitObject(PiiYdin::createDropTag());
+      return SynchronizedState;
 
     case ReconfigurationTag:
       // Take the name of the property set from the first object
@@ -99,3 +114,9 @@ PiiFlowController::FlowState PiiOneGroupFlowController::prepareProcess()
                 dumpInputObjects(d->vecInputs.begin(), d->vecInputs.end()));
     }
 }
+
+bool PiiOneGroupFlowController::shiftToBatch()
+{
+  PII_D;
+  return shiftGroupToBatch(d->vecInputs.begin(), d->vecInputs.end(), expiryTime());
+}
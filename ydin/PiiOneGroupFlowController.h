@@ -42,9 +42,11 @@ public:
                             const QList<PiiOutputSocket*>& outputs);
 
   PiiFlowController::FlowState prepareProcess();
+  bool shiftToBatch();
 
 private:
   void shiftInputs();
+  void emitObject(const PiiVariant& obj);
 
   class Data : public PiiFlowController::Data
   {
@@ -46,6 +46,13 @@ PiiFlowController::FlowState PiiOneInputFlowController::prepareProcess()
   // If the incoming object is an ordinary one
   else if (isNonControlType(uiType))
     {
+      // Objects that have waited too long are replaced with a drop tag.
+      if (isExpired(&d->pInput, &d->pInput + 1, expiryTime()))
+        {
+          d->pInput->shift();
+          sendDropTag();
+          return SynchronizedState;
+        }
       // The input is now free and we are ready to process
       d->pInput->shift();
       return ProcessableState;
@@ -64,6 +71,11 @@ PiiFlowController::FlowState PiiOneInputFlowController::prepareProcess()
             return SynchronizedState;
           }
 
+        case DropTagType:
+          d->pInput->shift();
+          sendDropTag();
+          return SynchronizedState;
+
         case ReconfigurationTagType:
           setPropertySetName(d->pInput->queuedObject(0).valueAs<QString>());
           d->pInput->shift();
@@ -86,3 +98,23 @@ PiiFlowController::FlowState PiiOneInputFlowController::prepareProcess()
         }
     }
 }
+
+void PiiOneInputFlowController::sendDropTag()
+{
+  PII_D;
+  PiiVariant tag(PiiYdin::createDropTag());
+  for (int i=0; i<d->iOutputCount; ++i)
+    d->vecOutputs[i]->emitObject(tag);
+}
+
+bool PiiOneInputFlowController::shiftToBatch()
+{
+  PII_D;
+  unsigned int uiType = d->pInput->queuedType(0);
+  if (uiType == PiiVariant::InvalidType || !PiiYdin::isNonControlType(uiType))
+    return false;
+  if (isExpired(&d->pInput, &d->pInput + 1, expiryTime()))
+    return false;
+  d->pInput->shiftToBatch();
+  return true;
+}
@@ -42,6 +42,7 @@ public:
                             const QList<PiiOutputSocket*>& outputs);
 
   PiiFlowController::FlowState prepareProcess();
+  bool shiftToBatch();
 
 protected:
   /// @internal
@@ -55,6 +56,9 @@ protected:
     int iOutputCount; //optimization
   };
   PII_D_FUNC;
+
+private:
+  void sendDropTag();
 };
 
 #endif //_PIIONEINPUTFLOWCONTROLLER_H
@@ -16,10 +16,13 @@
 #include "PiiOperation.h"
 #include "PiiOperationCompound.h"
 #include <PiiUtil.h>
-#include <PiiSerializationFactory.h>
-#include <PiiSerializableExport.h>
-#include "PiiYdinResources.h"
 #include <PiiMath.h>
+#include <PiiSynchronized.h>
+#ifndef PII_NO_QT
+#  include <PiiSerializationFactory.h>
+#  include <PiiSerializableExport.h>
+#  include "PiiYdinResources.h"
+#  include <QMetaProperty>
 
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiOperation);
 PII_SERIALIZABLE_EXPORT(PiiOperation);
@@ -31,24 +34,41 @@ Q_DECLARE_METATYPE(QMetaMethod);
 static int iOperationStateMetaType = qRegisterMetaType<PiiOperation::State>("PiiOperation::State");
 static int iOperationMetaType = qRegisterMetaType<PiiOperation*>("PiiOperation*");
 static int iOperationPtrMetaType = qRegisterMetaType<PiiOperationPtr>("PiiOperationPtr");
+#else
+#  include <QCoreApplication>
+#endif
 
 PiiOperation::Data::Data() :
   activityMode(Enabled),
   stateMutex(QMutex::Recursive),
   bCachingProperties(false),
-  bApplyingPropertySet(false),
-  pmapMetaPropertyCache(0)
+  bApplyingPropertySet(false)
+#ifndef PII_NO_QT
+  , pmapMetaPropertyCache(0)
+#endif
 {}
 
 PiiOperation::Data::~Data()
+{
+#ifndef PII_NO_QT
+  qDeleteAll(mapPreparedProperties);
+  qDeleteAll(lstRetiredProperties);
+#endif
+}
+
+#ifndef PII_NO_QT
+PiiOperation::PreparedProperties::~PreparedProperties()
 {}
+#endif
 
 PiiOperation::PiiOperation() :
   d(new Data)
 {
+#ifndef PII_NO_QT
   Q_UNUSED(iOperationMetaType); // suppresses compiler warning
   Q_UNUSED(iOperationPtrMetaType);
   Q_UNUSED(iOperationStateMetaType);
+#endif
 }
 
 PiiOperation::PiiOperation(Data* data) :
@@ -57,6 +77,12 @@ PiiOperation::PiiOperation(Data* data) :
 
 PiiOperation::~PiiOperation()
 {
+#ifdef PII_NO_QT
+  // There is no destroyed() signal.
+  PiiOperationCompound* pParent = parentOperation();
+  if (pParent != 0)
+    pParent->childDestroyed(this);
+#endif
   delete d;
 }
 
@@ -167,6 +193,7 @@ bool PiiOperation::connectOutput(const QString& outputName, PiiOperation* other,
   return connectOutput(outputName, in);
 }
 
+#ifndef PII_NO_QT
 bool PiiOperation::connectOutput(const QString& outputName, const QVariant& input)
 {
   PiiAbstractInputSocket* pInput = qobject_cast<PiiAbstractInputSocket*>(input.value<QObject*>());
@@ -181,6 +208,7 @@ bool PiiOperation::connectOutput(const QString& outputName, const QVariant& inpu
     }
   return connectOutput(outputName, pInput);
 }
+#endif
 
 const char* PiiOperation::stateName(State state)
 {
@@ -188,6 +216,7 @@ const char* PiiOperation::stateName(State state)
   return state >= 0 && state < sizeof(states)/sizeof(states[0]) ? states[state] : 0;
 }
 
+#ifndef PII_NO_QT
 void PiiOperation::startPropertySet(const QString& name)
 {
   d->bCachingProperties = true;
@@ -205,20 +234,91 @@ void PiiOperation::endPropertySet()
 
 void PiiOperation::removePropertySet(const QString& name)
 {
-  d->mapCachedProperties.remove(name);
+  PreparedProperties* pPrepared = 0;
+  synchronized (d->stateMutex)
+    {
+      d->mapCachedProperties.remove(name);
+      pPrepared = d->mapPreparedProperties.take(name);
+    }
+  delete pPrepared;
 }
 
+void PiiOperation::preparePropertySet(const QString& name)
+{
+  PropertyList lstProperties;
+  QList<PreparedProperties*> lstRetired;
+  synchronized (d->stateMutex)
+    {
+      lstProperties = d->mapCachedProperties.value(name);
+      lstRetired = d->lstRetiredProperties;
+      d->lstRetiredProperties.clear();
+    }
+  // Destroy previously swapped-out states here, not in the
+  // processing thread.
+  qDeleteAll(lstRetired);
+
+  PreparedProperties* pPrepared = prepareProperties(lstProperties); // may take long
+  if (pPrepared == 0)
+    return;
+  pPrepared->lstProperties = lstProperties;
+
+  PreparedProperties* pOld = 0;
+  synchronized (d->stateMutex)
+    {
+      pOld = d->mapPreparedProperties.take(name);
+      d->mapPreparedProperties.insert(name, pPrepared);
+    }
+  delete pOld;
+}
+
+PiiOperation::PreparedProperties* PiiOperation::prepareProperties(PropertyList&)
+{
+  return 0;
+}
+
+void PiiOperation::swapProperties(PreparedProperties*)
+{}
+#endif
+
 void PiiOperation::applyPropertySet(const QString& name)
 {
+#ifndef PII_NO_QT
   // Don't apply to itself.
   if (d->bCachingProperties && name == d->strPropertySetName)
     return;
 
+  PreparedProperties* pPrepared = 0;
+  synchronized (d->stateMutex) pPrepared = d->mapPreparedProperties.take(name);
+
   d->bApplyingPropertySet = true;
-  Pii::setProperties(this, d->mapCachedProperties[name]);
+  if (pPrepared != 0)
+    {
+      try
+        {
+          swapProperties(pPrepared);
+          Pii::setProperties(this, pPrepared->lstProperties);
+        }
+      catch (...)
+        {
+          d->bApplyingPropertySet = false;
+          synchronized (d->stateMutex) d->lstRetiredProperties << pPrepared;
+          throw;
+        }
+      // The old state will be deleted by the next
+      // preparePropertySet() call or the destructor.
+      synchronized (d->stateMutex) d->lstRetiredProperties << pPrepared;
+    }
+  else
+    Pii::setProperties(this, d->mapCachedProperties[name]);
   d->bApplyingPropertySet = false;
+#else
+  // Properties cannot be set by name without Qt's meta objects.
+  Q_UNUSED(name);
+#endif
 }
 
+#ifndef PII_NO_QT
+
 void PiiOperation::addPropertyToList(PropertyList& properties,
                                      const QString& name,
                                      const QVariant& value)
@@ -309,6 +409,22 @@ QVariant PiiOperation::property(const QString& name) const
   return property(qPrintable(name));
 }
 
+QVariantList PiiOperation::propertyValues(const QVector<int>& indices) const
+{
+  const QMetaObject* pMetaObject = metaObject();
+  const int iPropertyCount = pMetaObject->propertyCount();
+  QVariantList lstValues;
+  lstValues.reserve(indices.size());
+  for (int i=0; i<indices.size(); ++i)
+    {
+      if (indices[i] >= 0 && indices[i] < iPropertyCount)
+        lstValues << pMetaObject->property(indices[i]).read(this);
+      else
+        lstValues << QVariant();
+    }
+  return lstValues;
+}
+
 QVariant PiiOperation::parsePrimitive(const QString& value)
 {
   bool bOk = false;
@@ -430,6 +546,17 @@ QVariantMap PiiOperation::metaProperties(const QString& propertyName) const
   return QVariantMap();
 }
 
+QVariantMap PiiOperation::statistics() const
+{
+  return QVariantMap();
+}
+#endif
+
+void PiiOperation::resetStatistics()
+{}
+
+#ifndef PII_NO_QT
+
 const QMap<QString,QVariantMap>* PiiOperation::createMetaPropertyCache(const QMetaObject* metaObj)
 {
   static QMutex cacheMutex;
@@ -510,6 +637,7 @@ PiiOperation* PiiOperation::clone() const
 
   return op;
 }
+#endif
 
 void PiiOperation::disconnectAllInputs()
 {
@@ -567,7 +695,9 @@ PiiOperation::ProtectionLevel PiiOperation::protectionLevel(const QString& prope
   return protectionLevel(qPrintable(property));
 }
 
+#ifndef PII_NO_QT
 QVariant PiiOperation::socketData(PiiSocket*, int) const { return QVariant(); }
+#endif
 
 void PiiOperation::setActivityMode(ActivityMode activityMode)
 {
@@ -595,3 +725,24 @@ void PiiOperation::setErrorString(const QString& errorString) { d->strErrorStrin
 QString PiiOperation::errorString() const { return d->strErrorString; }
 
 bool PiiOperation::hasError() const { return !d->strErrorString.isEmpty(); }
+
+#ifdef PII_NO_QT
+// Without moc, signals are ordinary functions. The parent compound
+// is the only receiver, and the events emulate the queued
+// connections made in PiiOperationCompound::addOperation().
+void PiiOperation::errorOccured(PiiOperation* sender, const QString& message)
+{
+  PiiOperationCompound* pParent = parentOperation();
+  if (pParent != 0)
+    QCoreApplication::postEvent(pParent, new PiiOperationCompound::ChildEvent(this, sender, message));
+}
+
+void PiiOperation::stateChanged(PiiOperation::State state)
+{
+  PiiOperationCompound* pParent = parentOperation();
+  if (pParent != 0)
+    QCoreApplication::postEvent(pParent, new PiiOperationCompound::ChildEvent(this, state));
+}
+
+void PiiOperation::activityModeChanged(ActivityMode) {}
+#endif
@@ -16,15 +16,18 @@
 #ifndef _PIIOPERATION_H
 #define _PIIOPERATION_H
 
-#include <PiiSerializationUtil.h>
-#include <PiiMatrixSerialization.h>
-#include <PiiConfigurable.h>
+#ifndef PII_NO_QT
+#  include <PiiSerializationUtil.h>
+#  include <PiiMatrixSerialization.h>
+#  include <PiiConfigurable.h>
+#endif
 #include "PiiInputSocket.h"
 #include "PiiOutputSocket.h"
 #include "PiiExecutionException.h"
 #include "PiiYdin.h"
 
 #include <QMutex>
+#include <QVector>
 
 class PiiOperationCompound;
 
@@ -32,9 +35,14 @@ class PiiOperationCompound;
  * Declares a virtual piiMetaObject() function and implements a
  * serialization function that serializes the properties of the class.
  */
-#define PII_OPERATION_SERIALIZATION_FUNCTION \
+#ifndef PII_NO_QT
+#  define PII_OPERATION_SERIALIZATION_FUNCTION \
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION; \
   PII_PROPERTY_SERIALIZATION_FUNCTION(PiiOperation)
+#else
+// Properties cannot be serialized without Qt's meta objects.
+#  define PII_OPERATION_SERIALIZATION_FUNCTION
+#endif
 
 /**
  * A superclass for operations that can be run by Ydin. Operations can
@@ -70,7 +78,11 @@ class PiiOperationCompound;
  * automatically deleted. Thus, one doesn't need to care about
  * deleting anything but the operation itself.
  */
-class PII_YDIN_EXPORT PiiOperation : public QObject, public PiiConfigurable
+class PII_YDIN_EXPORT PiiOperation :
+  public QObject
+#ifndef PII_NO_QT
+  , public PiiConfigurable
+#endif
 {
   Q_OBJECT
   Q_INTERFACES(PiiConfigurable)
@@ -113,10 +125,12 @@ class PII_YDIN_EXPORT PiiOperation : public QObject, public PiiConfigurable
    */
   Q_PROPERTY(ActivityMode activityMode READ activityMode WRITE setActivityMode NOTIFY activityModeChanged);
 
-  Q_ENUMS(State ProtectionLevel ActivityMode);
+  Q_ENUMS(State ProtectionLevel ActivityMode AffinityMode);
 
+#ifndef PII_NO_QT
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   PII_DEFAULT_SERIALIZATION_FUNCTION(QObject);
+#endif
 
 public:
 
@@ -186,6 +200,33 @@ public:
     TemporarilyDisabled
   };
 
+  /**
+   * Hints for placing processing threads on CPUs.
+   *
+   * - `NoAffinity` - no hint. Operations use the hint of the closest
+   *   parent compound that has one.
+   *
+   * - `CpuAffinity` - processing threads run only on the logical
+   *   CPUs listed in `affinityTarget`.
+   *
+   * - `NumaNodeAffinity` - processing threads run only on the CPUs
+   *   of the NUMA nodes listed in `affinityTarget`.
+   *
+   * - `ProducerAffinity` - processing threads run on the NUMA node
+   *   of the thread that most recently sent objects to the
+   *   operation. Data received from the producer will be processed
+   *   close to the memory it was placed in.
+   *
+   * @see PiiDefaultOperation::affinityMode
+   */
+  enum AffinityMode
+  {
+    NoAffinity,
+    CpuAffinity,
+    NumaNodeAffinity,
+    ProducerAffinity
+  };
+
   ~PiiOperation();
 
   /**
@@ -362,6 +403,7 @@ public:
    */
   Q_INVOKABLE PiiOperationCompound* parentOperation() const;
 
+#ifndef PII_NO_QT
   /**
    * Returns metadata associated with *socket*. The default
    * implementation always returns an invalid variant, but this
@@ -376,6 +418,7 @@ public:
    * associated with *role*.
    */
   virtual QVariant socketData(PiiSocket* socket, int role) const;
+#endif
 
   /**
    * A convenience function for connecting a named output socket to a
@@ -402,12 +445,15 @@ public:
 
   bool connectOutput(const QString& output, PiiAbstractInputSocket* input);
 
+#ifndef PII_NO_QT
   /**
    * Connects the output with the given name to *input*, which may be
    * either a name or a pointer to a PiiAbstractInputSocket.
    */
   Q_INVOKABLE bool connectOutput(const QString& outputName, const QVariant& input);
+#endif
 
+#ifndef PII_NO_QT
   /**
    * Starts storing a named property set. Between startPropertySet()
    * and [endPropertySet()] calls all [setProperty()] calls will be
@@ -443,6 +489,31 @@ public:
    */
   Q_INVOKABLE virtual void removePropertySet(const QString& name = QString());
 
+  /**
+   * Prepares the property set identified by *name* so that it can
+   * later be applied without delaying processing. This function calls
+   * [prepareProperties()] in the context of the calling thread, which
+   * lets an operation build expensive state (e.g. re-trained models
+   * or lookup tables) while it keeps processing data with the old
+   * state. When the set is applied at a synchronization boundary
+   * (see [reconfigure()]), the prepared state will be swapped in with
+   * [swapProperties()], and the processing thread never waits for
+   * the state to be built or the old state to be destroyed.
+   *
+   * A prepared set is consumed when it is applied. Preparing a set
+   * again replaces a previously prepared but unapplied state.
+   *
+   * ~~~(c++)
+   * engine.startPropertySet("recipe2");
+   * classifier->setProperty("models", varModels);
+   * engine.endPropertySet();
+   * engine.preparePropertySet("recipe2"); // may take long
+   * engine.reconfigure("recipe2");        // fast swap in the pipeline
+   * ~~~
+   */
+  Q_INVOKABLE virtual void preparePropertySet(const QString& name = QString());
+#endif
+
   /**
    * Synchronously reconfigures an operation with the properties
    * cached in the set identified by *propertySetName*. This function
@@ -456,6 +527,7 @@ public:
    */
   Q_INVOKABLE virtual void reconfigure(const QString& propertySetName = QString()) = 0;
 
+#ifndef PII_NO_QT
   /**
    * Virtual version of QObject::setProperty(). Making a non-virtual
    * function virtual in a subclass is *baad*. But we need to be able
@@ -474,6 +546,19 @@ public:
   virtual QVariant property(const char* name) const;
   Q_INVOKABLE QVariant property(const QString& name) const;
 
+  /**
+   * Returns the values of the properties at *indices* in the
+   * meta-object of this operation. An index that does not refer to
+   * a property produces an invalid variant. This function is used
+   * by PiiPropertyBatch to read many properties without looking them
+   * up by name. The default implementation reads the meta-properties
+   * directly. A subclass that overrides [property()] for properties
+   * declared with `Q_PROPERTY` must override this function as well.
+   *
+   * @see PiiDefaultOperation::propertyValues()
+   */
+  virtual QVariantList propertyValues(const QVector<int>& indices) const;
+
   /**
    * Returns the value of a metaproperty associated with
    * *propertyName*. PiiOperation extends Qt's metaobject system by
@@ -559,6 +644,7 @@ public:
    * found.
    */
   Q_INVOKABLE virtual PiiOperation* clone() const;
+#endif
 
   /**
    * Disconnects all inputs.
@@ -594,6 +680,31 @@ public:
    */
   Q_INVOKABLE bool hasError() const;
 
+#ifndef PII_NO_QT
+  /**
+   * Returns timing statistics collected while the operation
+   * processes data. The statistics are cumulative from the creation
+   * of the operation or the last [resetStatistics()] call. The
+   * default implementation returns an empty map. PiiDefaultOperation
+   * returns the map produced by PiiOperationStatistics::toMap().
+   * PiiOperationCompound returns the statistics of its child
+   * operations, keyed by their object names.
+   *
+   * ~~~(c++)
+   * QVariantMap mapStats = pEngine->statistics();
+   * QVariantMap mapProcessing = mapStats["reader"].toMap()["processing"].toMap();
+   * qDebug("reader: %lf us/round", mapProcessing["mean"].toDouble());
+   * ~~~
+   */
+  Q_INVOKABLE virtual QVariantMap statistics() const;
+#endif
+
+  /**
+   * Clears all collected timing statistics. The default
+   * implementation does nothing.
+   */
+  Q_INVOKABLE virtual void resetStatistics();
+
 signals:
   /**
    * Signals an error. The *message* should be a user-friendly
@@ -619,7 +730,29 @@ signals:
 protected:
   /// @hide
   typedef QList<QPair<const char*, ProtectionLevel> > ProtectionList;
+#ifndef PII_NO_QT
   typedef QList<QPair<QString,QVariant> > PropertyList;
+#endif
+  /// @endhide
+
+#ifndef PII_NO_QT
+  /**
+   * A base class for state built by [prepareProperties()]. Operations
+   * derive their own prepared state from this class.
+   */
+  class PII_YDIN_EXPORT PreparedProperties
+  {
+  public:
+    virtual ~PreparedProperties();
+
+  private:
+    friend class PiiOperation;
+    // The properties not consumed by prepareProperties()
+    PropertyList lstProperties;
+  };
+#endif
+
+  /// @hide
 
   class PII_YDIN_EXPORT Data
   {
@@ -634,8 +767,13 @@ protected:
     QMutex stateMutex;
     bool bCachingProperties, bApplyingPropertySet;
     QString strPropertySetName;
+#ifndef PII_NO_QT
     QMap<QString,PropertyList> mapCachedProperties;
+    QMap<QString,PreparedProperties*> mapPreparedProperties;
+    // Swapped-out states waiting to be deleted outside of processing
+    QList<PreparedProperties*> lstRetiredProperties;
     mutable const QMap<QString,QVariantMap>* pmapMetaPropertyCache;
+#endif
     QString strErrorString;
   } *d;
 
@@ -687,6 +825,57 @@ protected:
    */
   virtual void applyPropertySet(const QString& name);
 
+#ifndef PII_NO_QT
+  /**
+   * Builds the state needed by the cached *properties* in advance.
+   * This function is called by [preparePropertySet()] in the context
+   * of the thread that called it, possibly while the operation is
+   * running. It must therefore not modify anything the processing
+   * thread is using. The function should remove the properties it
+   * consumed from *properties*; the rest will be set normally when
+   * the set is applied. The default implementation returns 0, which
+   * means nothing needs to be prepared.
+   *
+   * ~~~(c++)
+   * struct MyPreparedTable : PiiOperation::PreparedProperties
+   * {
+   *   PiiMatrix<int> matTable;
+   * };
+   *
+   * PiiOperation::PreparedProperties* MyOperation::prepareProperties(PropertyList& properties)
+   * {
+   *   for (int i=0; i<properties.size(); ++i)
+   *     if (properties[i].first == "tableSize")
+   *       {
+   *         MyPreparedTable* pTable = new MyPreparedTable;
+   *         pTable->matTable = buildTable(properties.takeAt(i).second.toInt());
+   *         return pTable;
+   *       }
+   *   return 0;
+   * }
+   * ~~~
+   */
+  virtual PreparedProperties* prepareProperties(PropertyList& properties);
+
+  /**
+   * Swaps the state of the operation with *prepared*, which was
+   * returned by [prepareProperties()]. This function is called from
+   * [applyPropertySet()] at a synchronization boundary, usually in
+   * the processing thread. It must be fast; typically it just swaps
+   * pointers or implicitly shared objects. After the call, *prepared*
+   * should hold the old state, which will be destroyed outside of the
+   * processing thread. The default implementation does nothing.
+   *
+   * ~~~(c++)
+   * void MyOperation::swapProperties(PreparedProperties* prepared)
+   * {
+   *   qSwap(_matTable, static_cast<MyPreparedTable*>(prepared)->matTable);
+   * }
+   * ~~~
+   */
+  virtual void swapProperties(PreparedProperties* prepared);
+#endif
+
   /**
    * Returns a pointer to the mutex that prevents concurrent access to
    * the state of this operation.
@@ -714,6 +903,7 @@ protected:
 
 private:
   int indexOf(const char* property) const;
+#ifndef PII_NO_QT
   static void addPropertyToList(PropertyList& properties,
                                 const QString& name,
                                 const QVariant& value);
@@ -729,6 +919,7 @@ private:
   typedef QMap<QString,QMap<QString,QVariantMap> > MetaPropertyCache;
   static MetaPropertyCache* metaPropertyCache();
   static const QMap<QString, QVariantMap>* createMetaPropertyCache(const QMetaObject* metaObj);
+#endif
 
   PII_DISABLE_COPY(PiiOperation);
 };
@@ -743,6 +934,7 @@ Q_DECLARE_METATYPE(PiiOperationPtr);
 Q_DECLARE_METATYPE(QList<PiiAbstractInputSocket*>);
 Q_DECLARE_METATYPE(QList<PiiAbstractOutputSocket*>);
 
+#ifndef PII_NO_QT
 #define PII_SERIALIZABLE_CLASS PiiOperation
 #define PII_SERIALIZABLE_IS_ABSTRACT
 #define PII_BUILDING_LIBRARY PII_BUILDING_YDIN
@@ -758,5 +950,6 @@ Q_DECLARE_METATYPE(QList<PiiAbstractOutputSocket*>);
 #define PII_SERIALIZABLE_CLASS_NAME "PiiQVariantWrapper<PiiOperationPtr>"
 #define PII_BUILDING_LIBRARY PII_BUILDING_YDIN
 #include <PiiSerializableRegistration.h>
+#endif
 
 #endif //_PIIOPERATION_H
@@ -14,26 +14,43 @@
  */
 
 #include "PiiOperationCompound.h"
+#include "PiiDefaultOperation.h"
 
-#include <PiiSerializationFactory.h>
 #include <PiiUtil.h>
 #include <PiiDelay.h>
-#include <QTime>
+#include <PiiParallel.h>
+#include <QElapsedTimer>
 #include <QCoreApplication>
-#include <PiiYdinUtil.h>
-#include <PiiYdinResources.h>
-#include <PiiSerializableExport.h>
+#ifndef PII_NO_QT
+#  include <PiiSerializationFactory.h>
+#  include <PiiYdinUtil.h>
+#  include <PiiYdinResources.h>
+#  include <PiiSerializableExport.h>
+#else
+#  include <typeinfo>
+#endif
+
+#ifndef PII_NO_NETWORK
+#  include "network/PiiRemotePartition.h"
+#endif
 
 
+#ifndef PII_NO_QT
 PII_DEFINE_VIRTUAL_METAOBJECT_FUNCTION(PiiOperationCompound);
 PII_SERIALIZABLE_EXPORT(PiiOperationCompound);
 
 static int iOperationCompoundMetaType = qRegisterMetaType<PiiOperationCompound*>("PiiOperationCompound*");
+#endif
 
 PiiOperationCompound::Data::Data() :
   state(PiiOperation::Stopped),
   bChecked(false),
-  bWaiting(false)
+  bWaiting(false),
+  bChainFusion(false),
+  bParallelCheck(false),
+  memoryBudget(PiiMemoryBudget::global()),
+  affinityMode(PiiOperation::NoAffinity),
+  pPartition(0)
 {}
 
 PiiOperationCompound::Data::~Data()
@@ -42,7 +59,9 @@ PiiOperationCompound::Data::~Data()
 PiiOperationCompound::PiiOperationCompound() :
   PiiOperation(new Data)
 {
+#ifndef PII_NO_QT
   Q_UNUSED(iOperationCompoundMetaType); // suppresses compiler warning
+#endif
 }
 
 PiiOperationCompound::PiiOperationCompound(Data* data) :
@@ -51,7 +70,14 @@ PiiOperationCompound::PiiOperationCompound(Data* data) :
 
 PiiOperationCompound::~PiiOperationCompound()
 {
+#ifndef PII_NO_NETWORK
+  delete _d()->pPartition;
+#endif
   removeAllSockets();
+  // The children outlive the budget.
+  PII_D;
+  for (int i=0; i<d->lstOperations.size(); ++i)
+    releaseMemoryBudget(d->lstOperations[i]);
 }
 
 template <class Socket> void PiiOperationCompound::clearSocketList(QList<Socket*>& list)
@@ -80,19 +106,69 @@ void PiiOperationCompound::check(bool reset)
 {
   PII_D;
 
+#ifndef PII_NO_NETWORK
+  // The children run elsewhere.
+  if (!d->strNode.isEmpty())
+    {
+      if (d->pPartition == 0)
+        d->pPartition = new PiiRemotePartition(this);
+      d->pPartition->check(reset);
+      d->bChecked = true;
+      return;
+    }
+  delete d->pPartition;
+  d->pPartition = 0;
+#endif
+
   // Check for a parent if we haven't been derived.
   if (parent() == 0 &&
+#ifndef PII_NO_QT
       PiiOperationCompound::metaObject() == metaObject())
+#else
+      typeid(*this) == typeid(PiiOperationCompound))
+#endif
     piiWarning(tr("%1 (objectName %2) has no parent.")
                .arg(metaObject()->className())
                .arg(objectName()));
 
   PiiCompoundExecutionException PII_MAKE_EXCEPTION(compoundEx, "");
 
+  // Children connect their inputs to our budget in their check().
+  PiiOperationCompound* pParentCompound = qobject_cast<PiiOperationCompound*>(parent());
+  d->memoryBudget.setParent(pParentCompound != 0 ?
+                            pParentCompound->memoryBudget() :
+                            PiiMemoryBudget::global());
+
+  // Fusion must be decided before the children configure their
+  // processors.
+  if (reset)
+    {
+      bool bFuse = d->bChainFusion;
+      for (QObject* pParent = parent(); !bFuse && pParent != 0; pParent = pParent->parent())
+#ifndef PII_NO_QT
+        bFuse = pParent->property("chainFusion").toBool();
+#else
+        bFuse = qobject_cast<PiiOperationCompound*>(pParent) != 0 &&
+          static_cast<PiiOperationCompound*>(pParent)->chainFusion();
+#endif
+      compileChains(bFuse);
+    }
+
+  bool bParallel = d->bParallelCheck;
+  for (QObject* pParent = parent(); !bParallel && pParent != 0; pParent = pParent->parent())
+#ifndef PII_NO_QT
+    bParallel = pParent->property("parallelCheck").toBool();
+#else
+    bParallel = qobject_cast<PiiOperationCompound*>(pParent) != 0 &&
+      static_cast<PiiOperationCompound*>(pParent)->parallelCheck();
+#endif
+
   d->vecChildStates.resize(d->lstOperations.size());
   bool bError = false;
+  if (bParallel && d->lstOperations.size() > 1)
+    bError = checkInParallel(reset, compoundEx);
   // Reset enabled/disabled states and check all child operations.
-  for (int i = 0; i < d->lstOperations.size(); ++i)
+  else for (int i = 0; i < d->lstOperations.size(); ++i)
     {
       PiiOperation* pOperation = d->lstOperations[i];
       pOperation->setErrorString("");
@@ -152,6 +228,226 @@ void PiiOperationCompound::check(bool reset)
     throw compoundEx;
 }
 
+namespace
+{
+  // Checks the operations of one wave. Failures are stored and
+  // handled in the calling thread.
+  struct WaveChecker
+  {
+    WaveChecker(const QList<PiiOperation*>& operations,
+                const QVector<int>& wave,
+                bool reset,
+                QVector<PiiExecutionException*>& errors) :
+      lstOperations(operations), vecWave(wave), bReset(reset), vecErrors(errors)
+    {}
+
+    void operator() (int first, int end)
+    {
+      for (int i=first; i<end; ++i)
+        {
+          PiiOperation* pOperation = lstOperations[vecWave[i]];
+          try
+            {
+              pOperation->check(pOperation->state() == PiiOperation::Stopped || bReset);
+            }
+          catch (PiiExecutionException& ex)
+            {
+              vecErrors[vecWave[i]] = ex.isCompound() ?
+                new PiiCompoundExecutionException(static_cast<PiiCompoundExecutionException&>(ex)) :
+                new PiiExecutionException(ex);
+            }
+        }
+    }
+
+    const QList<PiiOperation*>& lstOperations;
+    const QVector<int>& vecWave;
+    bool bReset;
+    QVector<PiiExecutionException*>& vecErrors;
+  };
+}
+
+/* Divides the children into waves that can be checked concurrently.
+ * An operation goes to the wave after the last one that contains an
+ * operation connected to its inputs. If the remaining operations
+ * form a loop, the first of them goes to a wave of its own.
+ */
+QList<QVector<int> > PiiOperationCompound::checkWaves() const
+{
+  const PII_D;
+  const int iCount = d->lstOperations.size();
+  QHash<QObject*,int> hashIndices;
+  for (int i=0; i<iCount; ++i)
+    hashIndices.insert(d->lstOperations[i], i);
+
+  QVector<QVector<int> > vecSuccessors(iCount);
+  QVector<int> vecPredecessorCounts(iCount, 0);
+  for (int i=0; i<iCount; ++i)
+    {
+      QList<PiiAbstractInputSocket*> lstInputs(d->lstOperations[i]->inputs());
+      for (int j=0; j<lstInputs.size(); ++j)
+        {
+          PiiAbstractOutputSocket* pRootOutput = PiiProxySocket::root(lstInputs[j]->connectedOutput());
+          if (pRootOutput == 0)
+            continue;
+          // Find the child that contains the source operation.
+          int iSource = -1;
+          for (QObject* pObj = pRootOutput->parentOperation(); pObj != 0 && iSource < 0; pObj = pObj->parent())
+            iSource = hashIndices.value(pObj, -1);
+          if (iSource >= 0 && iSource != i && !vecSuccessors[iSource].contains(i))
+            {
+              vecSuccessors[iSource] << i;
+              ++vecPredecessorCounts[i];
+            }
+        }
+    }
+
+  QList<QVector<int> > lstWaves;
+  QVector<bool> vecDone(iCount, false);
+  QVector<int> vecWave;
+  for (int i=0; i<iCount; ++i)
+    if (vecPredecessorCounts[i] == 0)
+      vecWave << i;
+
+  for (int iDone = 0; iDone < iCount; )
+    {
+      if (vecWave.isEmpty())
+        {
+          for (int i=0; i<iCount; ++i)
+            if (!vecDone[i])
+              {
+                vecWave << i;
+                break;
+              }
+        }
+      for (int i=0; i<vecWave.size(); ++i)
+        vecDone[vecWave[i]] = true;
+      iDone += vecWave.size();
+      lstWaves << vecWave;
+
+      QVector<int> vecNext;
+      for (int i=0; i<vecWave.size(); ++i)
+        {
+          const QVector<int>& vecTargets = vecSuccessors[vecWave[i]];
+          for (int j=0; j<vecTargets.size(); ++j)
+            if (--vecPredecessorCounts[vecTargets[j]] == 0 && !vecDone[vecTargets[j]])
+              vecNext << vecTargets[j];
+        }
+      vecWave = vecNext;
+    }
+  return lstWaves;
+}
+
+/* Does the same as the sequential loop in check(), but runs the
+ * check() functions of the children concurrently, wave by wave.
+ * Returns true if any of the children failed.
+ */
+bool PiiOperationCompound::checkInParallel(bool reset, PiiCompoundExecutionException& compoundEx)
+{
+  PII_D;
+  const int iCount = d->lstOperations.size();
+  for (int i = 0; i < iCount; ++i)
+    {
+      PiiOperation* pOperation = d->lstOperations[i];
+      pOperation->setErrorString("");
+      if (pOperation->activityMode() == TemporarilyDisabled)
+        pOperation->setActivityMode(Enabled);
+    }
+
+  QVector<PiiExecutionException*> vecErrors(iCount, 0);
+  QList<QVector<int> > lstWaves(checkWaves());
+  for (int i=0; i<lstWaves.size(); ++i)
+    {
+      WaveChecker checker(d->lstOperations, lstWaves[i], reset, vecErrors);
+      Pii::forEachStrip(lstWaves[i].size(), checker, PiiParallelPolicy(lstWaves[i].size(), 1));
+    }
+
+  bool bError = false;
+  for (int i = 0; i < iCount; ++i)
+    {
+      PiiOperation* pOperation = d->lstOperations[i];
+      if (vecErrors[i] == 0)
+        d->vecChildStates[i] = ChildState(pOperation->state());
+      else
+        {
+          // Disable failed children.
+          bError = true;
+          compoundEx.addException(pOperation->objectName(), *vecErrors[i]);
+          pOperation->setErrorString(vecErrors[i]->message());
+          pOperation->setActivityMode(TemporarilyDisabled);
+          delete vecErrors[i];
+        }
+    }
+  return bError;
+}
+
+// Returns the operation op can be fused to, or zero if there is none.
+PiiOperation* PiiOperationCompound::fusedPredecessor(PiiOperation* op) const
+{
+  PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(op);
+  if (pOperation == 0 || pOperation->threadCount() != 0)
+    return 0;
+
+  PiiAbstractInputSocket* pConnectedInput = 0;
+  QList<PiiAbstractInputSocket*> lstInputs(op->inputs());
+  for (int i=0; i<lstInputs.size(); ++i)
+    if (lstInputs[i]->connectedOutput() != 0)
+      {
+        if (pConnectedInput != 0)
+          return 0;
+        pConnectedInput = lstInputs[i];
+      }
+  if (pConnectedInput == 0)
+    return 0;
+
+  // Proxies are not followed. The predecessor must be a sibling.
+  PiiAbstractOutputSocket* pOutput = pConnectedInput->connectedOutput();
+  if (pOutput->connectedInputCount() != 1)
+    return 0;
+  PiiOperation* pPredecessor = pOutput->parentOperation();
+  if (qobject_cast<PiiDefaultOperation*>(pPredecessor) == 0 ||
+      pPredecessor == op ||
+      !_d()->lstOperations.contains(pPredecessor))
+    return 0;
+  return pPredecessor;
+}
+
+void PiiOperationCompound::compileChains(bool fuse)
+{
+  PII_D;
+  d->lstFusedChains.clear();
+
+  QMap<PiiOperation*,PiiOperation*> mapSuccessors;
+  QList<PiiOperation*> lstFused;
+  for (int i=0; i<d->lstOperations.size(); ++i)
+    {
+      PiiOperation* pOperation = d->lstOperations[i];
+      PiiOperation* pPredecessor = fuse ? fusedPredecessor(pOperation) : 0;
+      if (pPredecessor != 0)
+        {
+          mapSuccessors[pPredecessor] = pOperation;
+          lstFused << pOperation;
+        }
+      if (qobject_cast<PiiDefaultOperation*>(pOperation) != 0)
+        static_cast<PiiDefaultOperation*>(pOperation)->_d()->bFused = pPredecessor != 0;
+    }
+
+  // Each operation has at most one fused successor because the
+  // connecting output must not branch. Chains start at operations
+  // that are not fused to a predecessor.
+  for (QMap<PiiOperation*,PiiOperation*>::const_iterator i=mapSuccessors.constBegin();
+       i != mapSuccessors.constEnd(); ++i)
+    {
+      if (lstFused.contains(i.key()))
+        continue;
+      QList<PiiOperation*> lstChain;
+      lstChain << i.key();
+      for (PiiOperation* pNext = i.value(); pNext != 0 && !lstChain.contains(pNext);
+           pNext = mapSuccessors.value(pNext, 0))
+        lstChain << pNext;
+      d->lstFusedChains << lstChain;
+    }
+}
+
 bool PiiOperationCompound::dependsOnDisabled(PiiOperation* op)
 {
   // Take all inputs of op.
@@ -191,6 +487,24 @@ void PiiOperationCompound::start()
   if (d->state == Stopped || d->state == Paused)
     {
       setState(Starting);
+#ifndef PII_NO_NETWORK
+      if (d->pPartition != 0)
+        {
+          d->bChecked = false;
+          try
+            {
+              d->pPartition->start();
+            }
+          catch (PiiExecutionException& ex)
+            {
+              // The partition did not start, and nobody will
+              // report its state.
+              emit errorOccured(this, ex.message());
+              setState(Stopped);
+            }
+          return;
+        }
+#endif
       // If there are no enabled children, just turn to running.
       if (commandChildren(Start()) == 0)
         setState(Running);
@@ -205,6 +519,22 @@ void PiiOperationCompound::pause()
   if (d->state == Running)
     {
       setState(Pausing);
+#ifndef PII_NO_NETWORK
+      if (d->pPartition != 0)
+        {
+          try
+            {
+              d->pPartition->pause();
+            }
+          catch (PiiExecutionException& ex)
+            {
+              // If the node is gone, the partition notices it and
+              // stops the compound.
+              emit errorOccured(this, ex.message());
+            }
+          return;
+        }
+#endif
       // No enabled children -> pause immediately
       if (commandChildren(Pause()) == 0)
         setState(Paused);
@@ -218,6 +548,22 @@ void PiiOperationCompound::stop()
   if (d->state member_of (Starting, Running, Stopping))
     {
       setState(Stopping);
+#ifndef PII_NO_NETWORK
+      if (d->pPartition != 0)
+        {
+          try
+            {
+              d->pPartition->stop();
+            }
+          catch (PiiExecutionException& ex)
+            {
+              // If the node is gone, the partition notices it and
+              // stops the compound.
+              emit errorOccured(this, ex.message());
+            }
+          return;
+        }
+#endif
       // No enabled children -> stop immediately
       if (commandChildren(Stop()) == 0)
         setState(Stopped);
@@ -233,6 +579,16 @@ void PiiOperationCompound::interrupt()
   if (d->state != Stopped)
     setState(Interrupted);
 
+#ifndef PII_NO_NETWORK
+  // The partition reports the stop when it has really stopped.
+  if (d->pPartition != 0)
+    {
+      if (d->state != Stopped)
+        d->pPartition->interrupt();
+      return;
+    }
+#endif
+
   if (commandChildren(Interrupt()) == 0)
     setState(Stopped);
 }
@@ -291,14 +647,21 @@ QString PiiOperationCompound::fullName(QObject* operation)
   return lstNames.join("/");
 }
 
+#ifndef PII_NO_QT
 void PiiOperationCompound::updateChildStates(PiiOperation::State state)
+{
+  updateChildState(static_cast<PiiOperation*>(sender()), state);
+}
+#endif
+
+void PiiOperationCompound::updateChildState(PiiOperation* child, State state)
 {
   PII_D;
   QMutexLocker lock(&d->stateMutex);
-  //piiDebug("\n%-11s %s", stateName((State)state), qPrintable(fullName(sender())));
-  //piiDebug("%s %s, compound %s", sender()->metaObject()->className(), stateName((State)state), stateName(this->state()));
+  //piiDebug("\n%-11s %s", stateName((State)state), qPrintable(fullName(child)));
+  //piiDebug("%s %s, compound %s", child->metaObject()->className(), stateName((State)state), stateName(this->state()));
 
-  int iIndex = d->lstOperations.indexOf(static_cast<PiiOperation*>(sender()));
+  int iIndex = d->lstOperations.indexOf(child);
   d->vecChildStates[iIndex].state = state;
   // Ignore state changes in disabled children.
   if (!d->vecChildStates[iIndex].bEnabled)
@@ -379,8 +742,21 @@ bool PiiOperationCompound::checkChildStates(State state)
 bool PiiOperationCompound::wait(unsigned long time)
 {
   PII_D;
-  QTime t;
+  QElapsedTimer t;
   t.start();
+#ifndef PII_NO_NETWORK
+  // The local children never run.
+  if (d->pPartition != 0)
+    {
+      while (d->state != Stopped &&
+             (time == ULONG_MAX || static_cast<unsigned long>(t.elapsed()) < time))
+        {
+          QCoreApplication::processEvents();
+          PiiDelay::msleep(10);
+        }
+      return d->state == Stopped;
+    }
+#endif
   // Wait for all children
   bool allDone;
   do
@@ -407,16 +783,20 @@ bool PiiOperationCompound::wait(State state, unsigned long time)
       return false;
     }
   d->bWaiting = true;
-  QTime t;
+  QElapsedTimer t;
   t.start();
   while (d->state != state && static_cast<unsigned long>(t.elapsed()) <= time)
     {
+#ifndef PII_NO_QT
       QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents |
-#if QT_VERSION < 0x050000
+#  if QT_VERSION < 0x050000
                                       QEventLoop::DeferredDeletion |
-#endif
+#  endif
                                       QEventLoop::ExcludeUserInputEvents,
                                       10);
+#else
+      QCoreApplication::processEvents();
+#endif
       PiiDelay::msleep(10);
     }
   d->bWaiting = false;
@@ -484,11 +864,13 @@ bool PiiOperationCompound::exposeInput(PiiAbstractInputSocket* socket)
   socket->disconnectOutput();
   d->lstInputs.append(socket);
 
+#ifndef PII_NO_QT
   // Break connection when the socket is destroyed.
   connect(socket,
           SIGNAL(destroyed(QObject*)),
           SLOT(removeExposedInput(QObject*)),
           Qt::DirectConnection);
+#endif
 
   return true;
 }
@@ -508,11 +890,13 @@ bool PiiOperationCompound::exposeOutput(PiiAbstractOutputSocket* socket)
 
   d->lstOutputs.append(socket);
 
+#ifndef PII_NO_QT
   // Break connection when the socket is destroyed
   connect(socket,
           SIGNAL(destroyed(QObject*)),
           SLOT(removeExposedOutput(QObject*)),
           Qt::DirectConnection);
+#endif
 
   return true;
 }
@@ -537,6 +921,7 @@ bool PiiOperationCompound::exposeOutput(const QString& name)
   return false;
 }
 
+#ifndef PII_NO_QT
 bool PiiOperationCompound::exposeInput(const QVariant& input)
 {
   PiiAbstractInputSocket* pInput = qobject_cast<PiiAbstractInputSocket*>(input.value<QObject*>());
@@ -560,6 +945,7 @@ bool PiiOperationCompound::removeOutput(const QVariant& output)
   PiiAbstractOutputSocket* pOutput = qobject_cast<PiiAbstractOutputSocket*>(output.value<QObject*>());
   return pOutput ? removeOutput(pOutput) : removeOutput(output.toString());
 }
+#endif
 
 PiiProxySocket* PiiOperationCompound::createInputProxy(const QString& name, const QStringList& intputNames)
 {
@@ -630,12 +1016,25 @@ bool PiiOperationCompound::removeSocket(const QString& name, QList<Socket*>& lis
 
 void PiiOperationCompound::removeExposedInput(QObject* socket)
 {
-  _d()->lstInputs.removeOne(static_cast<PiiAbstractInputSocket*>(socket));
+  removeExposedSocket(socket, _d()->lstInputs);
 }
 
 void PiiOperationCompound::removeExposedOutput(QObject* socket)
 {
-  _d()->lstOutputs.removeOne(static_cast<PiiAbstractOutputSocket*>(socket));
+  removeExposedSocket(socket, _d()->lstOutputs);
+}
+
+template <class Socket>
+void PiiOperationCompound::removeExposedSocket(QObject* socket, QList<Socket*>& list)
+{
+  // The socket is being destroyed and can no longer be cast down to
+  // Socket.
+  for (int i=list.size(); i--; )
+    if (list[i] == socket)
+      {
+        list.removeAt(i);
+        return;
+      }
 }
 
 QList<PiiOperation*> PiiOperationCompound::childOperations() const
@@ -696,6 +1095,7 @@ void PiiOperationCompound::addOperation(PiiOperation* op)
       d->lstOperations.append(op);
       op->setParent(this);
 
+#ifndef PII_NO_QT
       connect(op, SIGNAL(errorOccured(PiiOperation*,const QString&)),
               SLOT(handleError(PiiOperation*,const QString&)),
               Qt::QueuedConnection);
@@ -703,6 +1103,10 @@ void PiiOperationCompound::addOperation(PiiOperation* op)
               SLOT(updateChildStates(PiiOperation::State)),
               Qt::QueuedConnection);
       connect(op, SIGNAL(destroyed(QObject*)), SLOT(childDestroyed(QObject*)), Qt::DirectConnection);
+#else
+      // The child posts its signals to its parent operation as
+      // events. See event().
+#endif
     }
 }
 
@@ -728,6 +1132,25 @@ void PiiOperationCompound::handleError(PiiOperation* sender, const QString& msg)
   interrupt();
 }
 
+#ifdef PII_NO_QT
+bool PiiOperationCompound::event(QEvent* e)
+{
+  if (e->type() != ChildEvent::StateChanged && e->type() != ChildEvent::ErrorOccured)
+    return PiiOperation::event(e);
+
+  ChildEvent* pEvent = static_cast<ChildEvent*>(e);
+  // The child may have been removed after the event was posted.
+  if (_d()->lstOperations.contains(pEvent->pChild))
+    {
+      if (e->type() == ChildEvent::StateChanged)
+        updateChildState(pEvent->pChild, pEvent->state);
+      else
+        handleError(pEvent->pSender, pEvent->strMessage);
+    }
+  return true;
+}
+#endif
+
 bool PiiOperationCompound::replaceOperation(PiiOperation *oldOp, PiiOperation* newOp)
 {
   PII_D;
@@ -794,8 +1217,11 @@ bool PiiOperationCompound::replaceOperation(PiiOperation *oldOp, PiiOperation* n
 
   //remove the old operation
   d->lstOperations.removeAll(oldOp);
+#ifndef PII_NO_QT
   oldOp->disconnect(this);
+#endif
   oldOp->setParent(0);
+  releaseMemoryBudget(oldOp);
 
   return true;
 }
@@ -808,12 +1234,29 @@ bool PiiOperationCompound::detach(PiiOperation* op)
     return false;
 
   d->lstOperations.removeAll(op);
+#ifndef PII_NO_QT
   op->disconnect(this);
+#endif
   op->setParent(0);
+  releaseMemoryBudget(op);
   op->stop();
   return true;
 }
 
+void PiiOperationCompound::releaseMemoryBudget(PiiOperation* op)
+{
+  if (op->isCompound())
+    static_cast<PiiOperationCompound*>(op)->memoryBudget()->setParent(PiiMemoryBudget::global());
+  else
+    {
+      QList<PiiAbstractInputSocket*> lstInputs(op->inputs());
+      for (int i=0; i<lstInputs.size(); ++i)
+        if (PiiInputSocket* pInput = qobject_cast<PiiInputSocket*>(lstInputs[i]))
+          if (pInput->memoryBudget() == &_d()->memoryBudget)
+            pInput->setMemoryBudget(PiiMemoryBudget::global());
+    }
+}
+
 void PiiOperationCompound::removeOperation(PiiOperation* op)
 {
   PII_D;
@@ -863,6 +1306,7 @@ struct PiiOperationCompound::OutputFinder
   const QList<Type>& lstOutputs;
 };
 
+#ifndef PII_NO_QT
 struct PiiOperationCompound::SetPropertyFinder
 {
   typedef bool Type;
@@ -885,6 +1329,7 @@ struct PiiOperationCompound::GetPropertyFinder
 private:
   const PiiOperation* _pSelf;
 };
+#endif
 
 struct PiiOperationCompound::OperationFinder
 {
@@ -923,6 +1368,7 @@ PiiAbstractOutputSocket* PiiOperationCompound::output(const QString& path) const
   return find(OutputFinder(_d()->lstOutputs), path);
 }
 
+#ifndef PII_NO_QT
 void PiiOperationCompound::startPropertySet(const QString& name)
 {
   PiiOperation::startPropertySet(name);
@@ -940,11 +1386,58 @@ void PiiOperationCompound::removePropertySet(const QString& name)
   commandChildren(std::bind2nd(RemovePropertySet(), name));
 }
 
+void PiiOperationCompound::preparePropertySet(const QString& name)
+{
+  commandChildren(std::bind2nd(PreparePropertySet(), name));
+}
+#endif
+
 void PiiOperationCompound::reconfigure(const QString& name)
 {
   commandChildren(std::bind2nd(Reconfigure(), name));
 }
 
+#ifndef PII_NO_QT
+QVariantMap PiiOperationCompound::statistics() const
+{
+  QVariantMap mapResult;
+  foreach (PiiOperation* op, _d()->lstOperations)
+    {
+      QVariantMap mapChild(op->statistics());
+      if (!mapChild.isEmpty())
+        mapResult[op->objectName()] = mapChild;
+    }
+  return mapResult;
+}
+#endif
+
+void PiiOperationCompound::setChainFusion(bool chainFusion) { _d()->bChainFusion = chainFusion; }
+bool PiiOperationCompound::chainFusion() const { return _d()->bChainFusion; }
+void PiiOperationCompound::setParallelCheck(bool parallelCheck) { _d()->bParallelCheck = parallelCheck; }
+bool PiiOperationCompound::parallelCheck() const { return _d()->bParallelCheck; }
+void PiiOperationCompound::setMemoryLimit(qint64 memoryLimit) { _d()->memoryBudget.setLimit(memoryLimit); }
+qint64 PiiOperationCompound::memoryLimit() const { return _d()->memoryBudget.limit(); }
+PiiMemoryBudget* PiiOperationCompound::memoryBudget() const { return &const_cast<Data*>(_d())->memoryBudget; }
+QList<QList<PiiOperation*> > PiiOperationCompound::fusedChains() const { return _d()->lstFusedChains; }
+void PiiOperationCompound::setAffinityMode(AffinityMode affinityMode) { _d()->affinityMode = affinityMode; }
+PiiOperation::AffinityMode PiiOperationCompound::affinityMode() const { return _d()->affinityMode; }
+#ifndef PII_NO_QT
+void PiiOperationCompound::setAffinityTarget(const QVariantList& affinityTarget) { _d()->lstAffinityTarget = affinityTarget; }
+QVariantList PiiOperationCompound::affinityTarget() const { return _d()->lstAffinityTarget; }
+#else
+void PiiOperationCompound::setAffinityTarget(const QList<int>& affinityTarget) { _d()->lstAffinityTarget = affinityTarget; }
+QList<int> PiiOperationCompound::affinityTarget() const { return _d()->lstAffinityTarget; }
+#endif
+void PiiOperationCompound::setNode(const QString& node) { _d()->strNode = node; }
+QString PiiOperationCompound::node() const { return _d()->strNode; }
+
+void PiiOperationCompound::resetStatistics()
+{
+  foreach (PiiOperation* op, _d()->lstOperations)
+    op->resetStatistics();
+}
+
+#ifndef PII_NO_QT
 bool PiiOperationCompound::setProperty(const char* name, const QVariant& value)
 {
   return find(SetPropertyFinder(this, value), name);
@@ -954,6 +1447,7 @@ QVariant PiiOperationCompound::property(const char* name) const
 {
   return find(GetPropertyFinder(this), name);
 }
+#endif
 
 PiiOperation* PiiOperationCompound::childOperation(const QString& name) const
 {
@@ -1023,6 +1517,7 @@ PiiOperation::State PiiOperationCompound::state() const
   return _d()->state;
 }
 
+#ifndef PII_NO_QT
 PiiOperation* PiiOperationCompound::createOperation(const QString& className, const QString& objectName)
 {
   PiiOperation* op = PiiYdin::createResource<PiiOperation>(qPrintable(className));
@@ -1244,6 +1739,7 @@ PiiOperationCompound* PiiOperationCompound::clone() const
 
   return pResult;
 }
+#endif
 
 template <class Socket>
 Socket* PiiOperationCompound::findSocket(const QString& name, const QList<Socket*>& list)
@@ -1254,6 +1750,7 @@ Socket* PiiOperationCompound::findSocket(const QString& name, const QList<Socket
   return 0;
 }
 
+#ifndef PII_NO_QT
 void PiiOperationCompound::connectAll(PiiAbstractOutputSocket* source, const EndPointListType& targets)
 {
   if (source == 0) return;
@@ -1314,3 +1811,4 @@ QVariant PiiOperationCompound::socketData(PiiSocket* socket, int role) const
     }
   return QVariant();
 }
+#endif
@@ -22,6 +22,10 @@
 #include <PiiFunctional.h>
 
 #include <QMap>
+#include <QVector>
+#include <QEvent>
+
+class PiiRemotePartition;
 
 
 /**
@@ -29,9 +33,13 @@
  * serialization function that serializes the child operations and the
  * properties of the class.
  */
-#define PII_COMPOUND_SERIALIZATION_FUNCTION \
+#ifndef PII_NO_QT
+#  define PII_COMPOUND_SERIALIZATION_FUNCTION \
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION; \
   PII_PROPERTY_SERIALIZATION_FUNCTION(PiiOperationCompound)
+#else
+#  define PII_COMPOUND_SERIALIZATION_FUNCTION
+#endif
 
 /**
  * PiiOperationCompound is a class that controls a set of operations.
@@ -189,12 +197,112 @@ class PII_YDIN_EXPORT PiiOperationCompound : public PiiOperation
 {
   Q_OBJECT
 
+  /**
+   * Enables the compilation of fused execution chains. If this flag
+   * is `true`, [check()] analyzes the connections between the child
+   * operations whenever the compound is reset and finds linear runs
+   * of operations, such as *convert → filter → threshold*. An
+   * operation is fused to the operation preceding it if
+   *
+   * - both are derived from PiiDefaultOperation,
+   * - the operation has only one connected input, and it is
+   *   connected to an output of the preceding operation,
+   * - the output is not connected to any other input, and
+   * - the operation is non-threaded ([threadCount]
+   *   (PiiDefaultOperation::threadCount) is zero).
+   *
+   * A fused operation processes ordinary objects immediately in the
+   * thread that emits them, without placing them into its input
+   * queue or consulting its flow controller. Image data thus stays
+   * in the cache of the processor that produced it. Control objects
+   * and objects that arrive while the queue is not empty take the
+   * usual route.
+   *
+   * If this flag is `false`, the value of the parent compound will be
+   * used. The default value is `false`.
+   *
+   * @see fusedChains()
+   */
+  Q_PROPERTY(bool chainFusion READ chainFusion WRITE setChainFusion);
+
+  /**
+   * Check child operations concurrently. If this flag is `true`,
+   * [check()] divides the children into waves so that every
+   * operation comes after the operations it receives objects from.
+   * The operations within a wave are checked in parallel in the
+   * global thread pool. Operations in feedback loops are checked one
+   * at a time. This shortens the start-up of engines whose
+   * operations do heavy work in check(), such as building search
+   * structures for trained models.
+   *
+   * The check() functions of the children must then be thread-safe
+   * with respect to each other. In particular, they must not create
+   * QObjects with a parent or emit signals that are expected to be
+   * delivered directly.
+   *
+   * If this flag is `false`, the value of the parent compound will be
+   * used. The default value is `false`.
+   */
+  Q_PROPERTY(bool parallelCheck READ parallelCheck WRITE setParallelCheck);
+
+  /**
+   * The maximum number of bytes of matrix data held in the input
+   * queues of all operations within the compound, including nested
+   * compounds. When the limit is reached, the inputs accept new
+   * objects only into empty queues, which throttles the producers.
+   * The memory is also charged to the budgets of enclosing
+   * compounds and to the global budget. See PiiMemoryBudget for
+   * details. The budget is connected to the inputs in [check()]. Zero
+   * means no limit, which is the default.
+   */
+  Q_PROPERTY(qint64 memoryLimit READ memoryLimit WRITE setMemoryLimit);
+
+  /**
+   * The default thread placement hint for all operations in the
+   * compound whose own
+   * [affinityMode](PiiDefaultOperation::affinityMode) is
+   * `NoAffinity`. If the compound itself has no hint, that of its
+   * parent will be used. The default value is `NoAffinity`.
+   */
+  Q_PROPERTY(AffinityMode affinityMode READ affinityMode WRITE setAffinityMode);
+
+  /**
+   * The CPUs or NUMA nodes used with [affinityMode]. See
+   * PiiDefaultOperation::affinityTarget.
+   */
+  Q_PROPERTY(QVariantList affinityTarget READ affinityTarget WRITE setAffinityTarget);
+
+  /**
+   * The URI of a PiiEngineNode that executes the children of this
+   * compound, for example "tcp://192.168.0.12:3142/node/". If this
+   * property is set, [check()] serializes the compound and deploys it
+   * to the node instead of checking the children. The objects sent
+   * to the inputs of the compound are streamed to the node, and the
+   * objects the node emits come back through the outputs. Control
+   * tags travel with the data, so synchronization and stop signals
+   * cross the network like local connections.
+   *
+   * [start()], [pause()], [stop()] and [interrupt()] are forwarded
+   * to the node, and the state of the compound follows the state of
+   * the remote partition. The compound turns to `Stopped` once the
+   * partition has stopped and the stop tags have been passed on.
+   *
+   * The plug-ins used by the compound must be available on the node.
+   * The default value is an empty string, which means that the
+   * compound runs locally. Remote execution requires the ydin library
+   * to be built with network support.
+   */
+  Q_PROPERTY(QString node READ node WRITE setNode);
+
   Q_ENUMS(ConnectionType);
 
+  friend class PiiRemotePartition;
+#ifndef PII_NO_QT
   friend struct PiiSerialization::Accessor;
   PII_SEPARATE_SAVE_LOAD_MEMBERS
   PII_DECLARE_SAVE_LOAD_MEMBERS
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
+#endif
 
 public:
   /// Constructs a new operation compound.
@@ -483,8 +591,10 @@ public:
    */
   bool exposeOutput(const QString& fullName);
 
+#ifndef PII_NO_QT
   Q_INVOKABLE bool exposeInput(const QVariant& input);
   Q_INVOKABLE bool exposeOutput(const QVariant& output);
+#endif
 
   /**
    * Removes *socket* from the public interface. Returns `true` if the
@@ -511,8 +621,10 @@ public:
    */
   bool removeOutput(const QString& name);
 
+#ifndef PII_NO_QT
   Q_INVOKABLE bool removeInput(const QVariant& input);
   Q_INVOKABLE bool removeOutput(const QVariant& output);
+#endif
 
   /**
    * Removes all input and output sockets from the public interface.
@@ -583,6 +695,7 @@ public:
 
   State state() const;
 
+#ifndef PII_NO_QT
   /**
    * A convenience function that creates an instance of the named
    * class and adds it as a child to this compound. If the operation
@@ -598,7 +711,9 @@ public:
    * instantiated.
    */
   Q_INVOKABLE PiiOperation* createOperation(const QString& className, const QString& objectName = "");
+#endif
 
+#ifndef PII_NO_QT
   /**
    * Calls startPropertySet() on each child operation. Note that this
    * function has no effect on the compound itself. Compound
@@ -619,11 +734,32 @@ public:
    */
   void removePropertySet(const QString& name = QString());
 
+  /**
+   * Calls preparePropertySet() on each child operation.
+   */
+  void preparePropertySet(const QString& name = QString());
+#endif
+
   /**
    * Calls reconfigure() on each child operation.
    */
   void reconfigure(const QString& propertySetName = QString());
 
+#ifndef PII_NO_QT
+  /**
+   * Returns the statistics of all child operations in a map whose
+   * keys are the object names of the children. Children that have
+   * not collected any statistics are omitted.
+   */
+  QVariantMap statistics() const;
+#endif
+
+  /**
+   * Calls resetStatistics() on each child operation.
+   */
+  void resetStatistics();
+
+#ifndef PII_NO_QT
   /**
    * Sets a property in this compound. This function supports the "dot
    * syntax" for setting properties. If the compound has a child
@@ -668,6 +804,44 @@ public:
    *   every different value is returned as a QVariantList.
    */
   QVariant socketData(PiiSocket* socket, int role) const;
+#endif
+
+  void setChainFusion(bool chainFusion);
+  bool chainFusion() const;
+
+  void setParallelCheck(bool parallelCheck);
+  bool parallelCheck() const;
+
+  void setMemoryLimit(qint64 memoryLimit);
+  qint64 memoryLimit() const;
+
+  /**
+   * Returns the memory budget the input queues of child operations
+   * are charged to. See [memoryLimit].
+   */
+  PiiMemoryBudget* memoryBudget() const;
+
+  void setAffinityMode(AffinityMode affinityMode);
+  AffinityMode affinityMode() const;
+#ifndef PII_NO_QT
+  void setAffinityTarget(const QVariantList& affinityTarget);
+  QVariantList affinityTarget() const;
+#else
+  void setAffinityTarget(const QList<int>& affinityTarget);
+  QList<int> affinityTarget() const;
+#endif
+
+  void setNode(const QString& node);
+  QString node() const;
+
+  /**
+   * Returns the fused execution chains compiled in the last
+   * [check()]. Each chain lists the operations in the order they
+   * process the data, the first one being the head that still
+   * receives objects through its input queues. Returns an empty
+   * list if [chainFusion] is disabled.
+   */
+  QList<QList<PiiOperation*> > fusedChains() const;
 
 protected:
   /// @hide
@@ -680,13 +854,19 @@ protected:
   struct Stop { void operator() (PiiOperation* op) const { op->stop(); } };
   struct Interrupt { void operator() (PiiOperation* op) const { op->interrupt(); } };
 
+#ifndef PII_NO_QT
   struct StartPropertySet : Pii::BinaryFunction<PiiOperation*, QString, void>
   { void operator() (PiiOperation* op, const QString& n) const { op->startPropertySet(n); } };
   struct RemovePropertySet : Pii::BinaryFunction<PiiOperation*, QString, void>
   { void operator() (PiiOperation* op, const QString& n) const { op->removePropertySet(n); } };
+  struct PreparePropertySet : Pii::BinaryFunction<PiiOperation*, QString, void>
+  { void operator() (PiiOperation* op, const QString& n) const { op->preparePropertySet(n); } };
+#endif
   struct Reconfigure : Pii::BinaryFunction<PiiOperation*, QString, void>
   { void operator() (PiiOperation* op, const QString& n) const { op->reconfigure(n); } };
+#ifndef PII_NO_QT
   struct EndPropertySet { void operator() (PiiOperation* op) const { op->endPropertySet(); } };
+#endif
 
   /**
    * Sends a command to all enabled child operations. Use the action
@@ -731,21 +911,54 @@ protected:
 
   void updateActivityMode(ActivityMode mode);
 
+#ifdef PII_NO_QT
+  bool event(QEvent* e);
+#endif
+
 private slots:
+#ifndef PII_NO_QT
   void updateChildStates(PiiOperation::State state);
+#endif
   void childDestroyed(QObject* op);
   void handleError(PiiOperation* sender, const QString& msg);
   void removeExposedInput(QObject* socket);
   void removeExposedOutput(QObject* socket);
 
 private:
+#ifdef PII_NO_QT
+  friend class PiiOperation;
+  friend class PiiSocket;
+
+  // Carries the arguments of a child's stateChanged() or
+  // errorOccured() signal, which cannot be connected without Qt.
+  struct ChildEvent : QEvent
+  {
+    static const Type StateChanged = User, ErrorOccured = Type(User + 1);
+
+    ChildEvent(PiiOperation* child, State s) :
+      QEvent(StateChanged), pChild(child), pSender(child), state(s)
+    {}
+    ChildEvent(PiiOperation* child, PiiOperation* sender, const QString& message) :
+      QEvent(ErrorOccured), pChild(child), pSender(sender), state(Stopped), strMessage(message)
+    {}
+    PiiOperation* pChild;
+    PiiOperation* pSender;
+    State state;
+    QString strMessage;
+  };
+#endif
+
+  void updateChildState(PiiOperation* child, State state);
+
   // Recursive socket look-up
   struct InputFinder;
   struct OutputFinder;
 
+#ifndef PII_NO_QT
   // Finders for properties
   struct SetPropertyFinder;
   struct GetPropertyFinder;
+#endif
   // and sub-operations
   struct OperationFinder;
 
@@ -767,11 +980,17 @@ private:
 
   bool detach(PiiOperation* op);
   static bool dependsOnDisabled(PiiOperation* op);
+  void compileChains(bool fuse);
+  PiiOperation* fusedPredecessor(PiiOperation* op) const;
+  QList<QVector<int> > checkWaves() const;
+  bool checkInParallel(bool reset, PiiCompoundExecutionException& compoundEx);
+  void releaseMemoryBudget(PiiOperation* op);
 
   // State changing utilities
   bool checkSteadyStateChange(State newState, State intermediateState, State steadyState);
   bool checkChildStates(State state);
 
+#ifndef PII_NO_QT
   // Serialization stuff
   typedef QPair<PiiOperation*, QString> EndPointType;
   typedef QList<EndPointType> EndPointListType;
@@ -780,6 +999,7 @@ private:
   EndPointListType buildEndPointList(PiiAbstractOutputSocket* socket, const PiiOperationCompound *context = 0) const;
   void connectAll(PiiAbstractOutputSocket* source, const EndPointListType& targets);
   QString proxyInputName(PiiAbstractInputSocket* input) const;
+#endif
 
 
   template <class Socket> static void resetProxies(const QList<Socket*>& list);
@@ -787,6 +1007,7 @@ private:
   template <class Socket> static void clearSocketList(QList<Socket*>& list);
   template <class Socket> static bool removeSocket(QObject* socket, QList<Socket*>& list);
   template <class Socket> static bool removeSocket(const QString& name, QList<Socket*>& list);
+  template <class Socket> static void removeExposedSocket(QObject* socket, QList<Socket*>& list);
 
   QString fullName(QObject* operation);
 };
@@ -812,6 +1033,7 @@ public:
 
 private:
   friend class PiiOperationCompound;
+  friend class PiiRemotePartition;
 
   /**
    * Exposed input sockets.
@@ -827,18 +1049,37 @@ private:
    */
   QVector<ChildState> vecChildStates;
 
-  bool bChecked, bWaiting;
+  /**
+   * Fused execution chains.
+   */
+  QList<QList<PiiOperation*> > lstFusedChains;
+
+  bool bChecked, bWaiting, bChainFusion, bParallelCheck;
+  PiiMemoryBudget memoryBudget;
+  AffinityMode affinityMode;
+#ifndef PII_NO_QT
+  QVariantList lstAffinityTarget;
+#else
+  QList<int> lstAffinityTarget;
+#endif
+  QString strNode;
+  /**
+   * Deployment of the compound to strNode, if any.
+   */
+  PiiRemotePartition* pPartition;
 };
 
 Q_DECLARE_METATYPE(PiiOperationCompound*);
 typedef QList<PiiOperation*> PiiOperationList;
 Q_DECLARE_METATYPE(PiiOperationList);
 
+#ifndef PII_NO_QT
 #include "PiiOperationCompound-templates.h"
 
 #define PII_SERIALIZABLE_CLASS PiiOperationCompound
 #define PII_BUILDING_LIBRARY PII_BUILDING_YDIN
 
 #include <PiiSerializableRegistration.h>
+#endif
 
 #endif //_PIIOPERATIONCOMPOUND_H
@@ -14,7 +14,97 @@
  */
 
 #include "PiiOperationProcessor.h"
+#include "PiiOutputSocket.h"
+#include "PiiInputSocket.h"
+#include "PiiProfiler.h"
 
 PiiOperationProcessor::~PiiOperationProcessor()
 {
 }
+
+void PiiOperationProcessor::flushStatistics()
+{
+}
+
+void PiiOperationProcessor::threadCountChanged()
+{
+}
+
+void PiiOperationProcessor::measuredProcess(PiiOperationStatistics::Collector& collector, qint64& lastRoundEnd)
+{
+#ifndef PII_NO_OPERATION_STATISTICS
+  PiiProfiler* pProfiler = PiiProfiler::activeProfiler();
+  int iQueueLength = pProfiler != 0 ? inputQueueLength() : 0;
+  qint64 iStart = PiiOperationStatistics::Collector::timestamp();
+  if (lastRoundEnd != 0)
+    collector.record(PiiOperationStatistics::InputWait, lastRoundEnd, iStart);
+
+  {
+    PiiMatrixAccounting::Scope accounting(collector.matrixCounters());
+    _pParentOp->processLocked(); // may throw
+  }
+
+  qint64 iEnd = PiiOperationStatistics::Collector::timestamp();
+  // Time blocked in emission is not processing time.
+  qint64 iStallTime = 0;
+  for (int i=_pParentOp->outputCount(); i--; )
+    iStallTime += _pParentOp->outputAt(i)->takeStallTime();
+  collector.record(PiiOperationStatistics::Processing, iStart, iEnd - iStallTime);
+  collector.record(PiiOperationStatistics::EmissionStall, 0, iStallTime);
+  lastRoundEnd = iEnd;
+
+  if (pProfiler != 0)
+    {
+      // Blocked emissions may have happened anywhere during the
+      // round. They are shown as one block at the end.
+      PiiProfiler::Event event;
+      event.pOperation = _pParentOp;
+      event.threadId = QThread::currentThreadId();
+      event.iStartTime = iStart;
+      event.iProcessedTime = iEnd - iStallTime;
+      event.iEndTime = iEnd;
+      event.iQueueLength = iQueueLength;
+      event.iEmittedCount = takeEmittedCount(event.threadId);
+      pProfiler->record(event);
+    }
+#else
+  Q_UNUSED(collector); Q_UNUSED(lastRoundEnd);
+  _pParentOp->processLocked(); // may throw
+#endif
+}
+
+int PiiOperationProcessor::inputQueueLength() const
+{
+  int iMaxLength = 0;
+  for (int i=_pParentOp->inputCount(); i--; )
+    {
+      PiiInputSocket* pInput = _pParentOp->inputAt(i);
+      if (pInput->isConnected())
+        iMaxLength = qMax(iMaxLength, pInput->queueLength());
+    }
+  return iMaxLength;
+}
+
+QList<int> PiiOperationProcessor::affinityCpus() const
+{
+  const PiiDefaultOperation::Data* d = _pParentOp->_d();
+  switch (d->effectiveAffinityMode)
+    {
+    case PiiOperation::CpuAffinity:
+    case PiiOperation::NumaNodeAffinity:
+      return d->lstAffinityCpus;
+    case PiiOperation::ProducerAffinity:
+      // Unknown until the first object has been received.
+      return _iProducerNode >= 0 ? Pii::numaNodeCpus(_iProducerNode) : QList<int>();
+    default:
+      return QList<int>();
+    }
+}
+
+int PiiOperationProcessor::takeEmittedCount(Qt::HANDLE threadId)
+{
+  int iCount = 0;
+  for (int i=_pParentOp->outputCount(); i--; )
+    iCount += _pParentOp->outputAt(i)->takeEmittedCount(threadId);
+  return iCount;
+}
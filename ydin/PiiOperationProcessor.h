@@ -19,6 +19,7 @@
 #include "PiiYdinTypes.h"
 #include "PiiDefaultOperation.h"
 #include "PiiInputController.h"
+#include <PiiCpu.h>
 #include <QThread>
 
 class PiiInputSocket;
@@ -79,6 +80,23 @@ public:
    */
   PiiFlowController* flowController() const { return _pFlowController; }
 
+  /**
+   * Merges measurements held by processing threads that are not
+   * currently running into the statistics of the parent operation.
+   * This function is called before the statistics are read. The
+   * default implementation does nothing.
+   */
+  virtual void flushStatistics();
+
+  /**
+   * Informs the processor that the [threadCount]
+   * (PiiDefaultOperation::threadCount) of the parent operation has
+   * changed while it was running. Only processors that run many
+   * rounds concurrently need to react. The default implementation
+   * does nothing.
+   */
+  virtual void threadCountChanged();
+
 protected:
   /**
    * Creates a new PiiOperationProcessor.
@@ -86,9 +104,79 @@ protected:
    * @param parent the operation to be executed
    */
   PiiOperationProcessor(PiiDefaultOperation* parent) :
-    _pParentOp(parent)
+    _pParentOp(parent),
+    _iProducerNode(-1)
   {}
 
+  /**
+   * Merges the measurements in *collector* into the statistics of the
+   * parent operation. If *now* is non-zero, the merge will happen
+   * only if the collector hasn't been flushed recently.
+   */
+  void mergeStatistics(PiiOperationStatistics::Collector& collector, qint64 now = 0)
+  {
+    collector.flush(&_pParentOp->_d()->statistics, &_pParentOp->_d()->statisticsMutex, now);
+  }
+
+  /**
+   * Calls process() on the parent operation and records the timing
+   * of the round into *collector*. *lastRoundEnd* holds the time
+   * the previous round ended, or zero if there were no previous
+   * rounds. It will be updated once the round is finished.
+   */
+  void measuredProcess(PiiOperationStatistics::Collector& collector, qint64& lastRoundEnd);
+
+  /**
+   * Adds objects to the batch prepared by the flow controller until
+   * the [batch size](PiiDefaultOperation::batchSize) of the parent
+   * operation is reached or the flow controller can't extend the
+   * batch any more. Must be called after
+   * PiiFlowController::prepareProcess() has returned
+   * `ProcessableState`, while holding the same lock.
+   */
+  void prepareBatch()
+  {
+    int iBatchSize = _pParentOp->_d()->iBatchSize;
+    while (--iBatchSize > 0 && _pFlowController->shiftToBatch()) ;
+  }
+
+  /**
+   * Returns the length of the longest queue in the connected inputs
+   * of the parent operation.
+   */
+  int inputQueueLength() const;
+
+  /**
+   * Returns the [scheduling class](PiiDefaultOperation::schedulingClass)
+   * of the parent operation.
+   */
+  PiiScheduler::SchedulingClass schedulingClass() const { return _pParentOp->_d()->schedulingClass; }
+
+  /**
+   * Returns the number of objects emitted by *threadId* through all
+   * outputs of the parent operation since the previous call.
+   */
+  int takeEmittedCount(Qt::HANDLE threadId);
+
+  /**
+   * Returns the CPUs the processing threads should be restricted to
+   * according to the resolved
+   * [affinity hint](PiiDefaultOperation::affinityMode) of the parent
+   * operation. An empty list means no restriction.
+   */
+  QList<int> affinityCpus() const;
+
+  /**
+   * Stores the NUMA node of the calling thread as the node of the
+   * producer if the parent operation has `ProducerAffinity`. Called
+   * by the emitting thread in tryToReceive().
+   */
+  void recordProducerNode()
+  {
+    if (_pParentOp->_d()->effectiveAffinityMode == PiiOperation::ProducerAffinity)
+      _iProducerNode = Pii::currentNumaNode();
+  }
+
   /**
    * A pointer to the parent operation.
    */
@@ -97,6 +185,10 @@ protected:
    * A pointer to the currently installed flow controller.
    */
   PiiFlowController* _pFlowController;
+
+private:
+  // Written by emitting threads. A stale value is harmless.
+  volatile int _iProducerNode;
 };
 
 #endif //_PIIOPERATIONPROCESSOR_H
@@ -0,0 +1,132 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiOperationStatistics.h"
+
+#include <PiiSynchronized.h>
+#ifndef PII_NO_QT
+#  include <QVariantList>
+#endif
+
+PiiOperationStatistics::Histogram::Histogram()
+{
+  clear();
+}
+
+void PiiOperationStatistics::Histogram::clear()
+{
+  iCount = iTotal = iMax = 0;
+  for (int i=0; i<BinCount; ++i)
+    aBins[i] = 0;
+}
+
+void PiiOperationStatistics::Histogram::merge(const Histogram& other)
+{
+  iCount += other.iCount;
+  iTotal += other.iTotal;
+  iMax = qMax(iMax, other.iMax);
+  for (int i=0; i<BinCount; ++i)
+    aBins[i] += other.aBins[i];
+}
+
+#ifndef PII_NO_QT
+QVariantMap PiiOperationStatistics::Histogram::toMap() const
+{
+  QVariantMap mapResult;
+  mapResult["count"] = iCount;
+  mapResult["total"] = iTotal;
+  mapResult["max"] = iMax;
+  mapResult["mean"] = iCount > 0 ? double(iTotal) / iCount : 0.0;
+  QVariantList lstBins;
+  for (int i=0; i<BinCount; ++i)
+    lstBins << aBins[i];
+  mapResult["bins"] = lstBins;
+  return mapResult;
+}
+#endif
+
+PiiOperationStatistics::Collector::Collector() :
+  _iLastFlushTime(0),
+  _bDirty(false)
+{}
+
+void PiiOperationStatistics::Collector::flushNow(PiiOperationStatistics* target, QMutex* mutex, qint64 now)
+{
+  synchronized (mutex)
+    {
+      for (int i=0; i<MeasurementCount; ++i)
+        target->_aHistograms[i].merge(_aHistograms[i]);
+      target->_matrixCounters.merge(_matrixCounters);
+    }
+  for (int i=0; i<MeasurementCount; ++i)
+    _aHistograms[i].clear();
+  _matrixCounters.clear();
+  _iLastFlushTime = now != 0 ? now : timestamp();
+  _bDirty = false;
+}
+
+PiiOperationStatistics::PiiOperationStatistics()
+{}
+
+bool PiiOperationStatistics::isEmpty() const
+{
+  for (int i=0; i<MeasurementCount; ++i)
+    if (_aHistograms[i].iCount != 0)
+      return false;
+  return true;
+}
+
+void PiiOperationStatistics::merge(const PiiOperationStatistics& other)
+{
+  for (int i=0; i<MeasurementCount; ++i)
+    _aHistograms[i].merge(other._aHistograms[i]);
+  _matrixCounters.merge(other._matrixCounters);
+}
+
+void PiiOperationStatistics::clear()
+{
+  for (int i=0; i<MeasurementCount; ++i)
+    _aHistograms[i].clear();
+  _matrixCounters.clear();
+}
+
+const char* PiiOperationStatistics::measurementName(Measurement measurement)
+{
+  static const char* names[] = { "inputWait", "processing", "emissionStall" };
+  return names[measurement];
+}
+
+#ifndef PII_NO_QT
+QVariantMap PiiOperationStatistics::toMap() const
+{
+  QVariantMap mapResult;
+  if (isEmpty())
+    return mapResult;
+  for (int i=0; i<MeasurementCount; ++i)
+    mapResult[measurementName(Measurement(i))] = _aHistograms[i].toMap();
+  if (!_matrixCounters.isEmpty())
+    {
+      QVariantMap mapMatrices;
+      mapMatrices["allocations"] = _matrixCounters.iAllocations;
+      mapMatrices["allocatedBytes"] = _matrixCounters.iAllocatedBytes;
+      mapMatrices["clones"] = _matrixCounters.iClones;
+      mapMatrices["clonedBytes"] = _matrixCounters.iClonedBytes;
+      mapMatrices["conversions"] = _matrixCounters.iConversions;
+      mapMatrices["convertedBytes"] = _matrixCounters.iConvertedBytes;
+      mapResult["matrices"] = mapMatrices;
+    }
+  return mapResult;
+}
+#endif
@@ -0,0 +1,244 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOPERATIONSTATISTICS_H
+#define _PIIOPERATIONSTATISTICS_H
+
+#include "PiiYdin.h"
+
+#include <PiiTimer.h>
+#include <PiiMatrixAccounting.h>
+#ifndef PII_NO_QT
+#  include <QVariantMap>
+#endif
+#include <QMutex>
+
+/**
+ * Timing statistics collected from the processing rounds of an
+ * operation. The statistics make it possible to find the bottleneck
+ * of a processing pipeline without an external profiler. Three
+ * intervals are measured for each round:
+ *
+ * - `InputWait` - the time a processing slot stayed idle waiting for
+ *   input between two consecutive rounds. A large value indicates
+ *   that the operation is starved by its upstream.
+ *
+ * - `Processing` - the time spent in
+ *   [process()](PiiDefaultOperation::process()), excluding time
+ *   blocked in emission.
+ *
+ * - `EmissionStall` - the time the operation was blocked because
+ *   downstream input queues were full. A large value indicates that
+ *   a downstream operation is the bottleneck. Note that emission to
+ *   an operation that has no processing threads of its own runs the
+ *   receiver synchronously, and its processing time will be included
+ *   in the sender's emission time.
+ *
+ * Each measurement is stored in a [Histogram] with logarithmic bins.
+ * The bottleneck of a pipeline is usually the operation with a large
+ * processing time and a small emission stall.
+ *
+ * Processing threads accumulate measurements into
+ * thread-private [Collector]s and only occasionally merge them into
+ * the shared statistics. Collection adds neither atomic operations
+ * nor locks to the processing loop. Collection can be compiled out
+ * entirely by adding "statistics" to the `DISABLE` qmake variable,
+ * which defines `PII_NO_OPERATION_STATISTICS`.
+ *
+ * If PiiMatrixAccounting is enabled, the collectors also count the
+ * matrix allocations, clones and conversions caused by the
+ * operation.
+ *
+ * @see PiiOperation::statistics()
+ */
+class PII_YDIN_EXPORT PiiOperationStatistics
+{
+public:
+  /**
+   * Measured intervals.
+   */
+  enum Measurement { InputWait, Processing, EmissionStall };
+  enum { MeasurementCount = 3 };
+
+  /**
+   * The number of bins in each histogram. The first bin contains
+   * intervals shorter than one microsecond. Bin *i* contains
+   * intervals in [2^(i-1), 2^i) microseconds. The last bin collects
+   * everything longer than that.
+   */
+  enum { BinCount = 24 };
+
+  /**
+   * A histogram of interval lengths.
+   */
+  struct PII_YDIN_EXPORT Histogram
+  {
+    Histogram();
+
+    inline void add(qint64 usecs)
+    {
+      if (usecs < 0)
+        usecs = 0;
+      ++iCount;
+      iTotal += usecs;
+      if (usecs > iMax)
+        iMax = usecs;
+      int iBin = 0;
+      for (qint64 iTmp = usecs; iTmp > 0 && iBin < BinCount-1; iTmp >>= 1)
+        ++iBin;
+      ++aBins[iBin];
+    }
+
+    void merge(const Histogram& other);
+    void clear();
+
+#ifndef PII_NO_QT
+    /**
+     * Returns the histogram as a map with `count`, `total`, `max`
+     * and `mean` (all in microseconds) and `bins`, a list of
+     * [BinCount] counts.
+     */
+    QVariantMap toMap() const;
+#endif
+
+    /// The number of intervals recorded.
+    qint64 iCount;
+    /// The sum of interval lengths in microseconds.
+    qint64 iTotal;
+    /// The longest interval in microseconds.
+    qint64 iMax;
+    qint64 aBins[BinCount];
+  };
+
+  /**
+   * A thread-private accumulator for measurements. Each processing
+   * thread owns a collector and flushes it to the shared statistics
+   * once in a while. With `PII_NO_OPERATION_STATISTICS`, all
+   * functions are empty and compile to nothing.
+   */
+  class PII_YDIN_EXPORT Collector
+  {
+  public:
+    Collector();
+
+    /**
+     * Returns the current time in microseconds, or zero if
+     * statistics are disabled.
+     */
+    static inline qint64 timestamp()
+    {
+#ifndef PII_NO_OPERATION_STATISTICS
+      return PiiTimer::timestamp();
+#else
+      return 0;
+#endif
+    }
+
+    /**
+     * Records an interval from *begin* to *end*.
+     */
+    inline void record(Measurement measurement, qint64 begin, qint64 end)
+    {
+#ifndef PII_NO_OPERATION_STATISTICS
+      _aHistograms[measurement].add(end - begin);
+      _bDirty = true;
+#else
+      Q_UNUSED(measurement); Q_UNUSED(begin); Q_UNUSED(end);
+#endif
+    }
+
+    /**
+     * Merges collected measurements into *target* while holding
+     * *mutex* and clears the collector. If *now* is non-zero, the
+     * collector will be flushed only if [FlushInterval] microseconds
+     * have elapsed since the last flush.
+     */
+    inline void flush(PiiOperationStatistics* target, QMutex* mutex, qint64 now = 0)
+    {
+#ifndef PII_NO_OPERATION_STATISTICS
+      if (_bDirty && (now == 0 || now - _iLastFlushTime >= FlushInterval))
+        flushNow(target, mutex, now);
+#else
+      Q_UNUSED(target); Q_UNUSED(mutex); Q_UNUSED(now);
+#endif
+    }
+
+    /**
+     * The minimum interval between two flushes in the processing
+     * loop, in microseconds.
+     */
+    enum { FlushInterval = 100000 };
+
+    /**
+     * Returns the matrix accounting counters of this collector.
+     * Install them with PiiMatrixAccounting::Scope for the duration
+     * of a processing round.
+     */
+    PiiMatrixAccounting::Counters* matrixCounters() { return &_matrixCounters; }
+
+  private:
+    void flushNow(PiiOperationStatistics* target, QMutex* mutex, qint64 now);
+
+    Histogram _aHistograms[MeasurementCount];
+    PiiMatrixAccounting::Counters _matrixCounters;
+    qint64 _iLastFlushTime;
+    bool _bDirty;
+  };
+
+  PiiOperationStatistics();
+
+  /**
+   * Returns the histogram of the given *measurement*.
+   */
+  const Histogram& histogram(Measurement measurement) const { return _aHistograms[measurement]; }
+
+  /**
+   * Returns the matrix accounting counters. The counters stay at zero
+   * unless PiiMatrixAccounting is enabled.
+   */
+  const PiiMatrixAccounting::Counters& matrixCounters() const { return _matrixCounters; }
+
+  /**
+   * Returns `true` if no measurements have been recorded.
+   */
+  bool isEmpty() const;
+
+  void merge(const PiiOperationStatistics& other);
+  void clear();
+
+#ifndef PII_NO_QT
+  /**
+   * Converts the statistics to a map. The map contains `inputWait`,
+   * `processing` and `emissionStall`, each formatted as described in
+   * Histogram::toMap(). If matrix accounting events have been
+   * recorded, the map also contains `matrices`, a map with
+   * `allocations`, `allocatedBytes`, `clones`, `clonedBytes`,
+   * `conversions` and `convertedBytes`. An empty map is returned if
+   * no measurements have been recorded.
+   */
+  QVariantMap toMap() const;
+#endif
+
+  /**
+   * Returns the name of *measurement* as used in [toMap()].
+   */
+  static const char* measurementName(Measurement measurement);
+
+private:
+  Histogram _aHistograms[MeasurementCount];
+  PiiMatrixAccounting::Counters _matrixCounters;
+};
+
+#endif //_PIIOPERATIONSTATISTICS_H
@@ -21,6 +21,60 @@
 #include <PiiDelay.h>
 #include <PiiTimer.h>
 #include <QDebug>
+#include <QThread>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#  include <windows.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+namespace
+{
+  // Returns the CPU time used by all threads of this process in
+  // microseconds.
+  qint64 processCpuTime()
+  {
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+      return 0;
+    // FILETIME is in 100 ns units.
+    return ((qint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime) +
+            (qint64(user.dwHighDateTime) << 32 | user.dwLowDateTime)) / 10;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+    return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+      usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+  }
+
+  qint64 percentile(const QVector<qint64>& sorted, int percent)
+  {
+    return sorted[qMin(sorted.size() - 1, sorted.size() * percent / 100)];
+  }
+}
+
+PiiOperationTest::BenchmarkOptions::BenchmarkOptions() :
+  iObjectCount(1000),
+  iWarmupCount(10),
+  dRate(0),
+  iTimeout(5000)
+{}
+
+PiiOperationTest::BenchmarkResult::BenchmarkResult() :
+  iThreadCount(-1),
+  iObjectCount(0),
+  dThroughput(0),
+  iMedianLatency(0),
+  i90thLatency(0),
+  i99thLatency(0),
+  iMaxLatency(0),
+  dCpuTimePerObject(0)
+{}
 
 PiiOperationTest::Data::Data() :
   pOperation(0)
@@ -331,3 +385,152 @@ void PiiOperationTest::showError(PiiOperation*, const QString& message)
 {
   qDebug("%s", qPrintable(message));
 }
+
+QList<PiiOperationTest::BenchmarkResult> PiiOperationTest::benchmark(const QMap<QString,PiiVariant>& objects,
+                                                                     const BenchmarkOptions& options)
+{
+  QList<BenchmarkResult> lstResults;
+  if (d->pOperation == 0 || objects.isEmpty() || options.iObjectCount <= 0)
+    return lstResults;
+
+  d->strTimedOutput = options.strOutput;
+  if (d->strTimedOutput.isEmpty())
+    {
+      if (d->pOperation->outputCount() == 0)
+        {
+          qDebug("The operation has no output to time.");
+          return lstResults;
+        }
+      d->strTimedOutput = d->pOperation->outputAt(0)->objectName();
+    }
+
+  QList<int> lstThreadCounts(options.lstThreadCounts);
+  const bool bHasThreadCount = d->pOperation->property("threadCount").isValid();
+  if (lstThreadCounts.isEmpty() || !bHasThreadCount)
+    lstThreadCounts = QList<int>() << (bHasThreadCount ? d->pOperation->property("threadCount").toInt() : -1);
+
+  connect(this, SIGNAL(objectReceived(QString,PiiVariant)), SLOT(recordOutput(QString)), Qt::DirectConnection);
+  for (int i=0; i<lstThreadCounts.size(); ++i)
+    {
+      stop();
+      if (lstThreadCounts[i] >= 0)
+        d->pOperation->setProperty("threadCount", lstThreadCounts[i]);
+      BenchmarkResult result;
+      result.iThreadCount = lstThreadCounts[i];
+      if (!runBenchmark(objects, options, result))
+        {
+          lstResults.clear();
+          break;
+        }
+      qDebug("%s, threadCount %d: %.1f objects/s, latency median %lld us, 90%% %lld us, 99%% %lld us, "
+             "max %lld us, CPU %.1f us/object",
+             d->pOperation->metaObject()->className(), result.iThreadCount,
+             result.dThroughput, result.iMedianLatency, result.i90thLatency,
+             result.i99thLatency, result.iMaxLatency, result.dCpuTimePerObject);
+      lstResults << result;
+    }
+  disconnect(this, SIGNAL(objectReceived(QString,PiiVariant)), this, SLOT(recordOutput(QString)));
+  stop();
+  clearAllOutputValues();
+  return lstResults;
+}
+
+bool PiiOperationTest::runBenchmark(const QMap<QString,PiiVariant>& objects,
+                                    const BenchmarkOptions& options,
+                                    BenchmarkResult& result)
+{
+  // Warm-up rounds fill caches and let the operation allocate its
+  // buffers.
+  d->vecReceiveTimes.fill(0, options.iWarmupCount + options.iObjectCount);
+  d->iReceivedCount.storeRelease(0);
+  if (!start())
+    return false;
+  for (int i=0; i<options.iWarmupCount; ++i)
+    if (!feedRound(objects))
+      return false;
+  if (!waitReceived(options.iWarmupCount, options.iTimeout))
+    return false;
+
+  QVector<qint64> vecSendTimes(options.iObjectCount);
+  const qint64 iInterval = options.dRate > 0 ? qint64(1e6 / options.dRate) : 0;
+  const qint64 iCpuStart = processCpuTime(), iStart = PiiTimer::timestamp();
+  for (int i=0; i<options.iObjectCount; ++i)
+    {
+      if (iInterval > 0)
+        {
+          qint64 iDelay = iStart + i * iInterval - PiiTimer::timestamp();
+          if (iDelay > 0)
+            PiiDelay::usleep(int(iDelay));
+        }
+      vecSendTimes[i] = PiiTimer::timestamp();
+      if (!feedRound(objects))
+        return false;
+    }
+  const bool bComplete = waitReceived(options.iWarmupCount + options.iObjectCount, options.iTimeout);
+  const qint64 iCpuTime = processCpuTime() - iCpuStart;
+  if (!bComplete)
+    {
+      qDebug("Received only %d objects out of %d from %s.",
+             d->iReceivedCount.loadAcquire() - options.iWarmupCount, options.iObjectCount,
+             qPrintable(d->strTimedOutput));
+      return false;
+    }
+
+  QVector<qint64> vecLatencies(options.iObjectCount);
+  for (int i=0; i<options.iObjectCount; ++i)
+    vecLatencies[i] = d->vecReceiveTimes[options.iWarmupCount + i] - vecSendTimes[i];
+  std::sort(vecLatencies.begin(), vecLatencies.end());
+
+  const qint64 iElapsed = qMax(qint64(1), d->vecReceiveTimes.last() - iStart);
+  result.iObjectCount = options.iObjectCount;
+  result.dThroughput = options.iObjectCount * 1e6 / iElapsed;
+  result.iMedianLatency = percentile(vecLatencies, 50);
+  result.i90thLatency = percentile(vecLatencies, 90);
+  result.i99thLatency = percentile(vecLatencies, 99);
+  result.iMaxLatency = vecLatencies.last();
+  result.dCpuTimePerObject = double(iCpuTime) / options.iObjectCount;
+  return true;
+}
+
+bool PiiOperationTest::feedRound(const QMap<QString,PiiVariant>& objects)
+{
+  for (QMap<QString,PiiVariant>::const_iterator i=objects.begin(); i != objects.end(); ++i)
+    {
+      PiiAbstractInputSocket* pInput = d->pOperation->input(i.key());
+      if (pInput == 0 || pInput->connectedOutput() == 0)
+        {
+          qDebug("Input %s is not connected.", qPrintable(i.key()));
+          return false;
+        }
+      // A full input queue rejects the object. Retry until the
+      // operation has room for it.
+      while (!pInput->controller()->tryToReceive(pInput, i.value()))
+        {
+          if (d->pOperation->state() != PiiOperation::Running)
+            return false;
+          QThread::yieldCurrentThread();
+        }
+    }
+  return true;
+}
+
+bool PiiOperationTest::waitReceived(int count, int milliseconds)
+{
+  PiiTimer timer;
+  while (d->iReceivedCount.loadAcquire() < count)
+    {
+      if (timer.milliseconds() > milliseconds)
+        return false;
+      QCoreApplication::processEvents();
+    }
+  return true;
+}
+
+void PiiOperationTest::recordOutput(const QString& name)
+{
+  if (name != d->strTimedOutput)
+    return;
+  int iIndex = d->iReceivedCount.fetchAndAddOrdered(1);
+  if (iIndex < d->vecReceiveTimes.size())
+    d->vecReceiveTimes[iIndex] = PiiTimer::timestamp();
+}
@@ -20,6 +20,8 @@
 #include <PiiYdin.h>
 #include <PiiVariant.h>
 #include <QMap>
+#include <QVector>
+#include <QAtomicInt>
 #include "PiiOperation.h"
 #include "PiiYdinTypes.h"
 
@@ -75,6 +77,23 @@ class PiiProbeInput;
  * QTEST_MAIN(TestMyOperation)
  * ~~~
  *
+ * Performance is measured with [benchmark()]. It feeds the same
+ * objects to the operation repeatedly and times the emissions of one
+ * of its outputs:
+ *
+ * ~~~(c++)
+ * void TestMyOperation::benchmark()
+ * {
+ *   connectAllInputs();
+ *   BenchmarkOptions options;
+ *   options.lstThreadCounts << 0 << 1 << 4;
+ *   QMap<QString,PiiVariant> mapObjects;
+ *   mapObjects["input"] = PiiVariant(PiiMatrix<uchar>(480, 640));
+ *   QList<BenchmarkResult> lstResults = PiiOperationTest::benchmark(mapObjects, options);
+ *   QVERIFY(!lstResults.isEmpty());
+ *   QVERIFY(lstResults[0].dThroughput > 1000);
+ * }
+ * ~~~
  */
 class PII_YDIN_EXPORT PiiOperationTest : public QObject
 {
@@ -97,6 +116,55 @@ protected:
    */
   enum FailMode { ExpectSuccess, ExpectFail, IgnoreFail };
 
+  /**
+   * Settings for [benchmark()].
+   */
+  struct PII_YDIN_EXPORT BenchmarkOptions
+  {
+    BenchmarkOptions();
+
+    /// The number of timed rounds. The default is 1000.
+    int iObjectCount;
+    /// The number of untimed rounds before measuring. The default is 10.
+    int iWarmupCount;
+    /// Rounds per second. Zero (the default) feeds objects as fast
+    /// as the operation accepts them.
+    double dRate;
+    /// The values of the `threadCount` property to measure. If
+    /// empty, the current value is used.
+    QList<int> lstThreadCounts;
+    /// The output whose emissions are timed. If empty, the first
+    /// output is used.
+    QString strOutput;
+    /// The number of milliseconds to wait for an output after the
+    /// last object has been sent. The default is 5000.
+    int iTimeout;
+  };
+
+  /**
+   * Measurements of one [benchmark()] run. Latencies are measured
+   * from sending the *n*th round to receiving the *n*th object from
+   * the timed output, in microseconds.
+   */
+  struct PII_YDIN_EXPORT BenchmarkResult
+  {
+    BenchmarkResult();
+
+    /// The value of `threadCount`, or -1 if there is no such property.
+    int iThreadCount;
+    /// The number of objects received from the timed output.
+    int iObjectCount;
+    /// Received objects per second of wall-clock time.
+    double dThroughput;
+    qint64 iMedianLatency;
+    qint64 i90thLatency;
+    qint64 i99thLatency;
+    qint64 iMaxLatency;
+    /// Process CPU time per round in microseconds, all threads
+    /// included.
+    double dCpuTimePerObject;
+  };
+
   PiiOperationTest();
 
   /**
@@ -261,6 +329,22 @@ protected:
    */
   bool waitOutput(const QString& name, int milliseconds) const;
 
+  /**
+   * Measures the performance of the operation. Each round sends
+   * *objects* to the inputs named by the keys of the map. The inputs
+   * must be connected before calling this function. The operation is
+   * restarted once for each thread count in *options*, and stopped
+   * when the function returns. Output values collected during the
+   * measurement are cleared. The results are also printed with
+   * qDebug().
+   *
+   * Returns one result for each measured thread count, or an empty
+   * list if the operation could not be started, has no output to
+   * time or failed to produce all objects in time.
+   */
+  QList<BenchmarkResult> benchmark(const QMap<QString,PiiVariant>& objects,
+                                   const BenchmarkOptions& options = BenchmarkOptions());
+
 signals:
   /**
    * Emitted whenever an object is emitted through any of the output
@@ -279,6 +363,7 @@ private slots:
   void deleteOutput(QObject* input);
   void deleteProbe(QObject* output);
   void showError(PiiOperation* sender, const QString& message);
+  void recordOutput(const QString& name);
 
 private:
   typedef QMap<QString,PiiProbeInput*> ProbeMapType;
@@ -288,6 +373,11 @@ private:
   PiiProbeInput* createProbe(PiiAbstractOutputSocket* output, const QString& name);
   void createProbes();
   bool sendTag(const PiiVariant& tag);
+  bool runBenchmark(const QMap<QString,PiiVariant>& objects,
+                    const BenchmarkOptions& options,
+                    BenchmarkResult& result);
+  bool feedRound(const QMap<QString,PiiVariant>& objects);
+  bool waitReceived(int count, int milliseconds);
 
   class Data
   {
@@ -296,6 +386,10 @@ private:
     PiiOperation* pOperation;
     ProbeMapType mapProbes;
     InputMapType mapInputs;
+    // Benchmark state. Written by the operation's threads.
+    QString strTimedOutput;
+    QVector<qint64> vecReceiveTimes;
+    QAtomicInt iReceivedCount;
   } *d;
 };
 
@@ -19,12 +19,153 @@
 #include "PiiOperation.h"
 
 #include <PiiUtil.h>
-#include <PiiSerializableExport.h> // MSVC
+#include <PiiTimer.h>
+#include <PiiSynchronized.h>
+#ifndef PII_NO_QT
+#  include <PiiSerializableExport.h> // MSVC
+#endif
 
 #include <QThread>
+#include <QQueue>
 
 using namespace PiiYdin;
 
+namespace
+{
+  // Restores the origin time of the calling thread when deferred
+  // objects have been passed with their own origins.
+  class OriginTimeScope
+  {
+  public:
+    OriginTimeScope() : _iSavedTime(PiiYdin::currentOriginTime()) {}
+    ~OriginTimeScope() { PiiYdin::setCurrentOriginTime(_iSavedTime); }
+  private:
+    qint64 _iSavedTime;
+  };
+}
+
+/* The lane thread is started on the first emission and idles on the
+   wait condition when there is nothing to pass. If passing an object
+   fails, the lane rejects further objects until reset.
+ */
+class PiiOutputSocket::Lane : public QThread
+{
+public:
+  Lane(PiiOutputSocket* socket, int capacity) :
+    _pSocket(socket), _iCapacity(capacity),
+    _bBusy(false), _bInterrupted(false), _bQuit(false)
+  {}
+
+  ~Lane()
+  {
+    synchronized (_mutex)
+      {
+        _bQuit = true;
+        _condition.wakeAll();
+      }
+    wait();
+  }
+
+  int capacity() const { return _iCapacity; }
+
+  qint64 push(const PiiVariant& object)
+  {
+    QMutexLocker lock(&_mutex);
+    if (!isRunning())
+      start();
+    qint64 iStallTime = 0;
+    if (_queue.size() >= _iCapacity && !_bInterrupted)
+      {
+#ifndef PII_NO_OPERATION_STATISTICS
+        qint64 iStallStart = PiiTimer::timestamp();
+#endif
+        do
+          _condition.wait(&_mutex);
+        while (_queue.size() >= _iCapacity && !_bInterrupted);
+#ifndef PII_NO_OPERATION_STATISTICS
+        iStallTime = PiiTimer::timestamp() - iStallStart;
+#endif
+      }
+    if (_bInterrupted)
+      throw PiiExecutionException(PiiExecutionException::Interrupted);
+    _queue.enqueue(BufferedObject(object, PiiYdin::currentOriginTime()));
+    _condition.wakeAll();
+    return iStallTime;
+  }
+
+  bool waitForEmpty(unsigned long time)
+  {
+    QMutexLocker lock(&_mutex);
+    while ((!_queue.isEmpty() || _bBusy) && !_bInterrupted)
+      if (!_condition.wait(&_mutex, time))
+        return false;
+    return !_bInterrupted;
+  }
+
+  void interrupt()
+  {
+    synchronized (_mutex)
+      {
+        _bInterrupted = true;
+        _queue.clear();
+        _condition.wakeAll();
+      }
+  }
+
+  void reset()
+  {
+    synchronized (_mutex)
+      {
+        _bInterrupted = false;
+        _queue.clear();
+        _condition.wakeAll();
+      }
+  }
+
+protected:
+  void run()
+  {
+    QMutexLocker lock(&_mutex);
+    forever
+      {
+        while (_queue.isEmpty() && !_bQuit)
+          _condition.wait(&_mutex);
+        if (_bQuit)
+          return;
+        BufferedObject obj(_queue.dequeue());
+        _bBusy = true;
+        _condition.wakeAll();
+        lock.unlock();
+        bool bPassed = true;
+        try
+          {
+            PiiYdin::setCurrentOriginTime(obj.iOriginTime);
+            _pSocket->emitFromLane(obj.object);
+          }
+        catch (PiiExecutionException&)
+          {
+            bPassed = false;
+          }
+        lock.relock();
+        _bBusy = false;
+        if (!bPassed)
+          {
+            _bInterrupted = true;
+            _queue.clear();
+          }
+        _condition.wakeAll();
+      }
+  }
+
+private:
+  PiiOutputSocket* _pSocket;
+  int _iCapacity;
+  QMutex _mutex;
+  QWaitCondition _condition;
+  QQueue<BufferedObject> _queue;
+  bool _bBusy, _bInterrupted, _bQuit;
+};
+
 PiiOutputSocket::Data::Data() :
   PiiAbstractOutputSocket::Data(),
   iGroupId(0),
@@ -33,7 +174,12 @@ PiiOutputSocket::Data::Data() :
   pFirstController(0),
   bInterrupted(false),
   pbInputCompleted(0),
-  activeThreadId(0)
+  bAllBlocking(true),
+  activeThreadId(0),
+  emissionOrder(OrderedEmission),
+  iStallTime(0),
+  iEmittedCount(0),
+  pLane(0)
 {}
 
 PiiOutputSocket::Data::~Data()
@@ -91,8 +237,158 @@ void PiiOutputSocket::Data::createFlagArray()
     }
   else
     pbInputCompleted = 0;
+
+  // Retain the policies of inputs that are still connected.
+  QVector<Connection> vecOldConnections(vecConnections);
+  vecConnections.resize(lstInputs.size());
+  for (int i=0; i<lstInputs.size(); ++i)
+    {
+      vecConnections[i] = Connection(lstInputs.inputAt(i));
+      for (int j=0; j<vecOldConnections.size(); ++j)
+        if (vecOldConnections[j].pInput == vecConnections[i].pInput)
+          {
+            vecConnections[i] = vecOldConnections[j];
+            break;
+          }
+    }
+  updateBlocking();
+}
+
+int PiiOutputSocket::Data::connectionIndex(PiiAbstractInputSocket* input) const
+{
+  for (int i=0; i<vecConnections.size(); ++i)
+    if (vecConnections[i].pInput == input)
+      return i;
+  return -1;
+}
+
+void PiiOutputSocket::Data::updateBlocking()
+{
+  bAllBlocking = true;
+  for (int i=0; i<vecConnections.size(); ++i)
+    bAllBlocking &= vecConnections[i].policy == BlockWhenFull;
+}
+
+bool PiiOutputSocket::Data::tryToReceive(int index, const PiiVariant& object)
+{
+  PiiAbstractInputSocket* pInput = lstInputs.inputAt(index);
+  PiiInputController* pController = lstInputs.controllerAt(index);
+  if (vecConnections[index].policy == BlockWhenFull)
+    return pController->tryToReceive(pInput, object);
+
+  queueMutex.lock();
+  bool bReceived = receiveOrQueue(index, object);
+  queueMutex.unlock();
+  // A receiver may have signaled room while we held the lock.
+  drainQueues();
+  return bReceived;
+}
+
+// queueMutex must be held when calling this function.
+bool PiiOutputSocket::Data::receiveOrQueue(int index, const PiiVariant& object)
+{
+  PiiAbstractInputSocket* pInput = lstInputs.inputAt(index);
+  PiiInputController* pController = lstInputs.controllerAt(index);
+  Connection& connection = vecConnections[index];
+
+  // Objects queued earlier go first.
+  if (passQueued(index) && pController->tryToReceive(pInput, object))
+    return true;
+
+  // Control objects must reach the receiver in order.
+  if (PiiYdin::isControlType(object.type()))
+    return false;
+
+  switch (connection.policy)
+    {
+    case DropNewest:
+      ++connection.iDroppedCount;
+      return true;
+    case DropOldest:
+      if (connection.lstQueue.size() >= connection.iQueueCapacity)
+        {
+          connection.lstQueue.removeFirst();
+          ++connection.iDroppedCount;
+        }
+      break;
+    default:
+      if (connection.lstQueue.size() >= connection.iQueueCapacity)
+        return false;
+      break;
+    }
+  connection.lstQueue.append(BufferedObject(object, PiiYdin::currentOriginTime()));
+  return true;
+}
+
+// queueMutex must be held when calling this function.
+bool PiiOutputSocket::Data::passQueued(int index)
+{
+  Connection& connection = vecConnections[index];
+  if (connection.lstQueue.isEmpty())
+    return true;
+  PiiAbstractInputSocket* pInput = lstInputs.inputAt(index);
+  PiiInputController* pController = lstInputs.controllerAt(index);
+  // Each queued object is received with the origin time it was
+  // emitted with.
+  OriginTimeScope originScope;
+  while (!connection.lstQueue.isEmpty())
+    {
+      PiiYdin::setCurrentOriginTime(connection.lstQueue.first().iOriginTime);
+      if (!pController->tryToReceive(pInput, connection.lstQueue.first().object))
+        return false;
+      connection.lstQueue.removeFirst();
+    }
+  return true;
+}
+
+void PiiOutputSocket::Data::drainQueues()
+{
+  // A thread that fails to lock leaves iDrainRequests set, and the
+  // holder checks it again after unlocking. Both sides use atomic
+  // swaps, so one of them always sees the other.
+  while (queueMutex.tryLock())
+    {
+      while (iDrainRequests.fetchAndStore(0) != 0)
+        for (int i=0; i<vecConnections.size(); ++i)
+          if (vecConnections[i].policy != BlockWhenFull)
+            passQueued(i);
+      queueMutex.unlock();
+      if (iDrainRequests.fetchAndStore(0) == 0)
+        return;
+      // Put the request back for the next round.
+      iDrainRequests.fetchAndStore(1);
+    }
 }
 
+void PiiOutputSocket::EmissionQueue::append(Qt::HANDLE id)
+{
+  if (_iCount == _vecSlots.size())
+    {
+      // Reorder to the beginning of a twice as large array.
+      QVector<EmissionSlot> vecSlots(_vecSlots.size() * 2);
+      for (int i=0; i<_iCount; ++i)
+        vecSlots[i] = operator[](i);
+      _vecSlots = vecSlots;
+      _iFirst = 0;
+    }
+  ++_iCount;
+  operator[](_iCount-1) = EmissionSlot(id);
+}
+
+void PiiOutputSocket::EmissionQueue::removeFirst()
+{
+  // Release buffered objects now.
+  operator[](0) = EmissionSlot();
+  _iFirst = (_iFirst + 1) & (_vecSlots.size() - 1);
+  --_iCount;
+}
+
+void PiiOutputSocket::EmissionQueue::clear()
+{
+  while (_iCount > 0)
+    removeFirst();
+  _iFirst = 0;
+}
 
 PiiOutputSocket::PiiOutputSocket(const QString& name) :
   PiiAbstractOutputSocket(name, new Data)
@@ -103,11 +399,76 @@ PiiOutputSocket::PiiOutputSocket(const QString& name, Data* data) :
 {}
 
 PiiOutputSocket::~PiiOutputSocket()
-{}
+{
+  setLaneCapacity(0);
+}
 
 void PiiOutputSocket::setGroupId(int id) { _d()->iGroupId = id; }
 int PiiOutputSocket::groupId() const { return _d()->iGroupId; }
 
+void PiiOutputSocket::setEmissionOrder(EmissionOrder emissionOrder) { _d()->emissionOrder = emissionOrder; }
+PiiOutputSocket::EmissionOrder PiiOutputSocket::emissionOrder() const { return _d()->emissionOrder; }
+
+bool PiiOutputSocket::setBackPressurePolicy(PiiAbstractInputSocket* input,
+                                            BackPressurePolicy policy,
+                                            int queueCapacity)
+{
+  PII_D;
+  int iIndex = d->connectionIndex(input);
+  if (iIndex == -1)
+    return false;
+  Connection& connection = d->vecConnections[iIndex];
+  connection.policy = policy;
+  connection.iQueueCapacity = qMax(1, queueCapacity);
+  d->updateBlocking();
+  return true;
+}
+
+PiiOutputSocket::BackPressurePolicy PiiOutputSocket::backPressurePolicy(PiiAbstractInputSocket* input) const
+{
+  const PII_D;
+  int iIndex = d->connectionIndex(input);
+  return iIndex != -1 ? d->vecConnections[iIndex].policy : BlockWhenFull;
+}
+
+int PiiOutputSocket::droppedObjectCount(PiiAbstractInputSocket* input) const
+{
+  const PII_D;
+  int iIndex = d->connectionIndex(input);
+  return iIndex != -1 ? d->vecConnections[iIndex].iDroppedCount : 0;
+}
+
+void PiiOutputSocket::setLaneCapacity(int capacity)
+{
+  PII_D;
+  capacity = qMax(0, capacity);
+  if (d->pLane != 0)
+    {
+      if (d->pLane->capacity() == capacity)
+        return;
+      // Release the lane thread if it is blocked by a receiver.
+      d->bInterrupted = true;
+      d->freeInputCondition.wakeAll();
+      delete d->pLane;
+      d->pLane = 0;
+      d->bInterrupted = false;
+    }
+  if (capacity > 0)
+    d->pLane = new Lane(this, capacity);
+}
+
+int PiiOutputSocket::laneCapacity() const
+{
+  const PII_D;
+  return d->pLane != 0 ? d->pLane->capacity() : 0;
+}
+
+bool PiiOutputSocket::waitForLane(unsigned long time)
+{
+  PII_D;
+  return d->pLane == 0 || d->pLane->waitForEmpty(time);
+}
+
 bool PiiOutputSocket::isConnected() const
 {
   return _d()->bConnected;
@@ -119,6 +480,8 @@ void PiiOutputSocket::interrupt()
   d->bInterrupted = true;
   // Bypass any forthcoming wait() call.
   d->freeInputCondition.wakeOne();
+  if (d->pLane != 0)
+    d->pLane->interrupt();
   d->state = PiiSocketState();
 }
 
@@ -127,50 +490,66 @@ void PiiOutputSocket::reset()
   PII_D;
   d->bInterrupted = false;
   d->freeInputCondition.wakeAll();
-  d->lstBuffer.clear();
+  d->emissionQueue.clear();
+  d->lstUnqueuedObjects.clear();
+  synchronized (d->queueMutex)
+    {
+      for (int i=0; i<d->vecConnections.size(); ++i)
+        {
+          d->vecConnections[i].lstQueue.clear();
+          d->vecConnections[i].iDroppedCount = 0;
+        }
+    }
   d->activeThreadId = 0;
+  d->iStallTime = 0;
+  d->iEmittedCount = 0;
+  if (d->pLane != 0)
+    d->pLane->reset();
+}
+
+bool PiiOutputSocket::flushObjects(QList<BufferedObject>& objects, int& flushed)
+{
+  // The flushing thread may not be the one that emitted the objects.
+  OriginTimeScope originScope;
+  for (; flushed < objects.size(); ++flushed)
+    {
+      PiiYdin::setCurrentOriginTime(objects[flushed].iOriginTime);
+      if (!tryEmit(objects[flushed].object))
+        return false;
+    }
+  return true;
 }
 
 bool PiiOutputSocket::flushBuffer()
 {
   PII_D;
 
-  while (!d->lstThreads.isEmpty())
+  while (!d->emissionQueue.isEmpty())
     {
-      // Flush every object belonging to the thread that currently has
+      // Flush every object belonging to the round that currently has
       // emission turn.
-      Qt::HANDLE activeThreadId = d->lstThreads[0].id;
-      for (OutputBuffer::iterator i=d->lstBuffer.begin(); i!=d->lstBuffer.end(); )
-        {
-          if (i->first == activeThreadId)
-            {
-              if (!tryEmit(i->second))
-                return false;
-              i = d->lstBuffer.erase(i);
-            }
-          else
-            ++i;
-        }
-      // If this thread is already done, we can safely remove it.
-      if (d->lstThreads[0].bFinished)
+      EmissionSlot& slot = d->emissionQueue[0];
+      if (!flushObjects(slot.lstObjects, slot.iFlushed))
+        return false;
+      // If this round is already done, we can safely remove it.
+      if (slot.bFinished)
         {
-          d->lstThreads.remove(0);
+          d->emissionQueue.removeFirst();
           d->endEmitCondition.wakeAll();
         }
       // Otherwise stop flushing.
       else
         return true;
     }
-  // If the last thread was removed from emission queue and there are
+  // If the last round was removed from emission queue and there are
   // still buffered objects, flush everything.
-  if (d->lstThreads.isEmpty() && !d->lstBuffer.isEmpty())
+  if (!d->lstUnqueuedObjects.isEmpty())
     {
-      for (OutputBuffer::iterator i=d->lstBuffer.begin(); i!=d->lstBuffer.end(); )
-        {
-          if (!tryEmit(i->second))
-            return false;
-          i = d->lstBuffer.erase(i);
-        }
+      int iFlushed = 0;
+      bool bFlushed = flushObjects(d->lstUnqueuedObjects, iFlushed);
+      d->lstUnqueuedObjects.erase(d->lstUnqueuedObjects.begin(),
+                                  d->lstUnqueuedObjects.begin() + iFlushed);
+      return bFlushed;
     }
   return true;
 }
@@ -178,39 +557,57 @@ bool PiiOutputSocket::flushBuffer()
 void PiiOutputSocket::emitThreaded(const PiiVariant& object)
 {
   PII_D;
+  Qt::HANDLE threadId = QThread::currentThreadId();
   QMutexLocker lock(&d->emitLock);
-  d->lstBuffer.append(qMakePair(QThread::currentThreadId(), object));
+  int iQueueIndex = d->queueIndex(threadId);
+  if (iQueueIndex != -1)
+    {
+      EmissionSlot& slot = d->emissionQueue[iQueueIndex];
+      slot.lstObjects.append(BufferedObject(object, PiiYdin::currentOriginTime()));
+#ifndef PII_NO_OPERATION_STATISTICS
+      ++slot.iEmittedCount;
+#endif
+    }
+  else
+    d->lstUnqueuedObjects.append(BufferedObject(object, PiiYdin::currentOriginTime()));
 }
 
-int PiiOutputSocket::Data::queueIndex(Qt::HANDLE threadId) const
+void PiiOutputSocket::emitUnordered(const PiiVariant& object)
 {
-  for (int i=0; i<lstThreads.size(); ++i)
-    if (lstThreads[i].id == threadId)
-      return i;
-  return -1;
+  // tryEmit() is not reentrant.
+  QMutexLocker lock(&_d()->emitLock);
+  emitNonThreaded(object);
 }
 
-bool PiiOutputSocket::Data::hasBufferedObjects(Qt::HANDLE activeThreadId) const
+// Finds the round of *threadId* that is still emitting objects or
+// has buffered objects. Finished rounds whose objects have all been
+// passed are no longer considered part of the queue.
+int PiiOutputSocket::Data::queueIndex(Qt::HANDLE threadId) const
 {
-  // See if there are any buffered objects for this thread
-  for (OutputBuffer::const_iterator i=lstBuffer.begin(); i!=lstBuffer.end(); ++i)
-    if (i->first == activeThreadId)
-      return true;
-  return false;
+  for (int i=emissionQueue.size(); i--; )
+    {
+      const EmissionSlot& slot = emissionQueue[i];
+      if (slot.id == threadId &&
+          (!slot.bFinished || slot.iFlushed < slot.lstObjects.size()))
+        return i;
+    }
+  return -1;
 }
 
 void PiiOutputSocket::startEmit(Qt::HANDLE activeThreadId)
 {
   // Put the thread to the tail of the emission queue.
   PII_D;
+  if (d->emissionOrder == UnorderedEmission)
+    return;
   QMutexLocker lock(&d->emitLock);
-  //piiDebug("Start %p (%d)", (void*)activeThreadId, d->lstThreads.size());
+  //piiDebug("Start %p (%d)", (void*)activeThreadId, d->emissionQueue.size());
   // Must check that the thread isn't already in queue. If it is, wait
   // until it is finished.
   while (d->queueIndex(activeThreadId) != -1 && !d->bInterrupted)
     d->endEmitCondition.wait(&d->emitLock, 100);
 
-  d->lstThreads.append(ThreadInfo(activeThreadId));
+  d->emissionQueue.append(activeThreadId);
 }
 
 void PiiOutputSocket::endEmit(Qt::HANDLE activeThreadId)
@@ -229,6 +626,8 @@ void PiiOutputSocket::endEmit(Qt::HANDLE activeThreadId)
 bool PiiOutputSocket::tryEndEmit(Qt::HANDLE activeThreadId)
 {
   PII_D;
+  if (d->emissionOrder == UnorderedEmission)
+    return true;
   QMutexLocker lock(&d->emitLock);
 
   int iQueueIndex = d->queueIndex(activeThreadId);
@@ -239,17 +638,16 @@ bool PiiOutputSocket::tryEndEmit(Qt::HANDLE activeThreadId)
     {
     case 0:
       // This is the blocking thread
-      d->lstThreads[iQueueIndex].bFinished = true;
+      d->emissionQueue[iQueueIndex].bFinished = true;
     case -1:
       // The thread is no longer in queue -> last call ended with an
       // incomplete flush.
       return flushBuffer(); // may throw
     default:
-      // If there are buffered objects, cannot yet remove the thread from queue.
-      if (d->hasBufferedObjects(activeThreadId))
-        d->lstThreads[iQueueIndex].bFinished = true;
-      else // This thread wasn't blocking -> no signal needed, just remove.
-        d->lstThreads.remove(iQueueIndex);
+      // Buffered objects will be flushed once the preceding rounds
+      // are done. If there are none, the slot will be silently
+      // removed.
+      d->emissionQueue[iQueueIndex].bFinished = true;
       break;
     }
   return true;
@@ -257,7 +655,21 @@ bool PiiOutputSocket::tryEndEmit(Qt::HANDLE activeThreadId)
 
 void PiiOutputSocket::emitObject(const PiiVariant& object)
 {
-  if (_d()->lstThreads.isEmpty())
+  PII_D;
+  if (d->pLane != 0)
+    {
+      if (!object.isValid())
+        PII_THROW(PiiExecutionException, tr("Trying to send an invalid object."));
+#ifndef PII_NO_OPERATION_STATISTICS
+      ++d->iEmittedCount;
+      d->iStallTime += d->pLane->push(object);
+#else
+      d->pLane->push(object);
+#endif
+    }
+  else if (d->emissionOrder == UnorderedEmission)
+    emitUnordered(object);
+  else if (d->emissionQueue.isEmpty())
     emitNonThreaded(object);
   else
     emitThreaded(object);
@@ -272,7 +684,7 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
   const int iCnt = d->lstInputs.size();
 
   // Optimized emission for a single connected input
-  if (iCnt == 1)
+  if (iCnt == 1 && d->bAllBlocking)
     return d->pFirstController->tryToReceive(d->pFirstInput, object);
   else if (iCnt == 0)
     return true;
@@ -281,8 +693,7 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
   for (int i=0; i<iCnt; ++i)
     {
       if (!d->pbInputCompleted[i])
-        bAllCompleted &= d->pbInputCompleted[i] =
-          d->lstInputs.controllerAt(i)->tryToReceive(d->lstInputs.inputAt(i), object);
+        bAllCompleted &= d->pbInputCompleted[i] = d->tryToReceive(i, object);
     }
   if (bAllCompleted)
     {
@@ -296,19 +707,73 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
 void PiiOutputSocket::emitNonThreaded(const PiiVariant& object)
 {
   PII_D;
+#ifndef PII_NO_OPERATION_STATISTICS
+  ++d->iEmittedCount;
+#endif
+  if (tryEmit(object))
+    return;
+
+  // Only blocked emissions are timed. The non-blocking path
+  // above costs nothing extra.
+#ifndef PII_NO_OPERATION_STATISTICS
+  qint64 iStallStart = PiiTimer::timestamp();
+#endif
   // Try to send until the object is successfully received.
-  do
+  while (true)
     {
+      d->freeInputCondition.wait();
+      if (d->bInterrupted)
+        throw PiiExecutionException(PiiExecutionException::Interrupted);
       if (tryEmit(object))
-        return;
+        break;
+    }
+#ifndef PII_NO_OPERATION_STATISTICS
+  d->iStallTime += PiiTimer::timestamp() - iStallStart;
+#endif
+}
+
+// Called by the lane thread, which is the only one that passes
+// objects while the lane is in use. Statistics are collected in
+// emitObject().
+void PiiOutputSocket::emitFromLane(const PiiVariant& object)
+{
+  PII_D;
+  while (!tryEmit(object))
+    {
       d->freeInputCondition.wait();
+      if (d->bInterrupted)
+        throw PiiExecutionException(PiiExecutionException::Interrupted);
     }
-  while (!d->bInterrupted);
-  throw PiiExecutionException(PiiExecutionException::Interrupted);
+}
+
+qint64 PiiOutputSocket::takeStallTime()
+{
+  PII_D;
+  qint64 iStallTime = d->iStallTime;
+  d->iStallTime = 0;
+  return iStallTime;
+}
+
+int PiiOutputSocket::takeEmittedCount(Qt::HANDLE threadId)
+{
+  PII_D;
+  QMutexLocker lock(&d->emitLock);
+  int iQueueIndex = d->queueIndex(threadId);
+  int* pCount = iQueueIndex != -1 ? &d->emissionQueue[iQueueIndex].iEmittedCount : &d->iEmittedCount;
+  int iCount = *pCount;
+  *pCount = 0;
+  return iCount;
 }
 
 void PiiOutputSocket::Data::inputReady(PiiAbstractInputSocket* /*input*/)
 {
+  // Pass queued objects now. The sender may not emit again any time
+  // soon.
+  if (!bAllBlocking)
+    {
+      iDrainRequests.fetchAndStore(1);
+      drainQueues();
+    }
   freeInputCondition.wakeOne();
 }
 
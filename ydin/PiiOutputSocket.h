@@ -25,10 +25,10 @@
 #include <PiiVariant.h>
 #include <PiiMatrix.h>
 #include <PiiWaitCondition.h>
+#include <PiiAtomicInt.h>
 
-#include <QLinkedList>
-#include <QVarLengthArray>
-#include <QPair>
+#include <QVector>
+#include <QList>
 
 class PiiAbstractInputSocket;
 class PiiInputSocket;
@@ -80,8 +80,58 @@ namespace PiiYdin
 class PII_YDIN_EXPORT PiiOutputSocket : public PiiAbstractOutputSocket
 {
   Q_OBJECT
+  Q_ENUMS(EmissionOrder BackPressurePolicy);
 
 public:
+  /**
+   * Emission orders for objects sent from concurrent threads.
+   *
+   * - `OrderedEmission` - objects are passed in the order the
+   * emitting threads were put into the emission queue with
+   * [startEmit()]. Objects emitted by a thread that does not have the
+   * emission turn are buffered. This is the default.
+   *
+   * - `UnorderedEmission` - objects are passed immediately in the
+   * order they are emitted. The emission queue is not used, and
+   * nothing is buffered. Use this mode if the receivers don't care
+   * about the order of objects, for example if they only store or
+   * count them. Note that objects emitted by one thread during one
+   * processing round may be interleaved with objects emitted by other
+   * threads.
+   */
+  enum EmissionOrder { OrderedEmission, UnorderedEmission };
+
+  /**
+   * Ways of handling a connected input that cannot receive an object
+   * immediately.
+   *
+   * - `BlockWhenFull` - wait until the input is able to receive. The
+   * emission stalls until all connected inputs have received the
+   * object. This is the default.
+   *
+   * - `DropNewest` - discard the object that cannot be received.
+   *
+   * - `DropOldest` - put the object into a bounded side queue. If the
+   * queue is full, discard the oldest object in it.
+   *
+   * - `SpillToQueue` - put the object into a bounded side queue. If
+   * the queue is full, wait as with `BlockWhenFull`.
+   *
+   * Control objects (see PiiYdin::isControlType()) are never dropped
+   * or queued. They wait until the objects queued before them have
+   * been passed. Queued objects are passed to the input on the next
+   * emission or as soon as the input signals it has room, whichever
+   * comes first. Thus, objects don't get stuck in the side queue if
+   * the sender stops emitting. Stop and pause tags wait behind the
+   * queued objects as well.
+   *
+   * The dropping policies must only be used for connections whose
+   * receiver does not need to stay in sync with other inputs, for
+   * example an image display or a file writer. Otherwise, dropping a
+   * data object breaks synchronization at the receiver.
+   */
+  enum BackPressurePolicy { BlockWhenFull, DropNewest, DropOldest, SpillToQueue };
+
   /**
    * Construct a new output socket with the given name. This
    * constructor sets `name` as the `objectName` property of the
@@ -94,6 +144,58 @@ public:
    */
   ~PiiOutputSocket();
 
+  /**
+   * Sets the emission order. The order must not be changed while
+   * the socket is being used for emitting objects.
+   */
+  void setEmissionOrder(EmissionOrder emissionOrder);
+  /**
+   * Returns the emission order. The default is `OrderedEmission`.
+   */
+  EmissionOrder emissionOrder() const;
+
+  /**
+   * Sets the back-pressure policy for the connection to *input*. A
+   * slow receiver with a dropping policy will not throttle the other
+   * receivers connected to this output. The policy is reset to
+   * `BlockWhenFull` if *input* is disconnected. The policy must not
+   * be changed while objects are being emitted.
+   *
+   * @param input a connected input
+   *
+   * @param policy the way of handling a full input
+   *
+   * @param queueCapacity the maximum number of objects in the side
+   * queue. Used with `DropOldest` and `SpillToQueue`. The minimum is
+   * one.
+   *
+   * @return `true` if the policy was set, `false` if *input* is not
+   * connected to this output
+   *
+   * ~~~(c++)
+   * // Show only the latest images and never stall the inspection
+   * // branch.
+   * PiiOutputSocket* pImageOutput = pCamera->output("image");
+   * pImageOutput->setBackPressurePolicy(pDisplay->input("image"),
+   *                                     PiiOutputSocket::DropOldest);
+   * ~~~
+   */
+  bool setBackPressurePolicy(PiiAbstractInputSocket* input,
+                             BackPressurePolicy policy,
+                             int queueCapacity = 1);
+
+  /**
+   * Returns the back-pressure policy of the connection to *input*.
+   */
+  BackPressurePolicy backPressurePolicy(PiiAbstractInputSocket* input) const;
+
+  /**
+   * Returns the number of objects dropped at the connection to
+   * *input* since the connection was made or the socket was
+   * [reset()].
+   */
+  int droppedObjectCount(PiiAbstractInputSocket* input) const;
+
   /**
    * Set the group id of this socket. The group id of an output socket
    * is used to find synchronization pairs. The default flow control
@@ -287,6 +389,26 @@ public:
    */
   void reset();
 
+  /**
+   * Returns the number of microseconds [emitObject()] has been
+   * blocked waiting for receivers since the previous call, and resets
+   * the counter. Only emissions outside of the emission queue (see
+   * [startEmit()]) are measured. This function is used by
+   * PiiDefaultOperation for collecting
+   * [statistics](PiiOperationStatistics), and it must be called from
+   * the thread that emits objects.
+   */
+  qint64 takeStallTime();
+
+  /**
+   * Returns the number of objects emitted by *threadId* since the
+   * previous call, and resets the counter. If *threadId* is in the
+   * emission queue, only the objects emitted during its current turn
+   * are counted. Otherwise, all emissions outside of the emission
+   * queue are counted. This function is used by PiiProfiler.
+   */
+  int takeEmittedCount(Qt::HANDLE threadId);
+
   /**
    * Puts *activeThreadId* to the emission order queue. This function
    * makes it possible to use the same output socket from different
@@ -344,21 +466,107 @@ public:
    */
   void setInputListener(PiiInputListener* listener = 0);
 
+  /**
+   * Decouples the receivers from the emitting thread. If *capacity*
+   * is greater than zero, [emitObject()] puts objects into a bounded
+   * queue and returns immediately. A dedicated thread, the emission
+   * *lane*, passes the queued objects to the connected inputs in
+   * order. The emitter only blocks if the queue is full. Control
+   * objects travel through the same queue, so synchronization tags
+   * stay in order with the data they delimit.
+   *
+   * Lanes make it possible to feed branches of different speed from
+   * one thread: if each output of a demultiplexer has a lane, a
+   * branch that blocks only stalls its own lane until the lane fills
+   * up. The lane bypasses the emission queue (see [startEmit()]), and
+   * it must therefore only be used with operations that emit from
+   * one thread at a time. Time spent waiting for a full lane is
+   * reported by [takeStallTime()]. Zero (the default) turns the lane
+   * off. The capacity must not be changed while objects are being
+   * emitted.
+   */
+  void setLaneCapacity(int capacity);
+  /**
+   * Returns the capacity of the emission lane, or zero if the lane
+   * is not in use.
+   */
+  int laneCapacity() const;
+
+  /**
+   * Waits until the emission lane has passed all queued objects or
+   * *time* milliseconds have elapsed. Returns `true` if the lane is
+   * empty or not in use, and `false` on timeout or if the lane was
+   * interrupted.
+   */
+  bool waitForLane(unsigned long time = ULONG_MAX);
+
 protected:
   /// @hide
-  struct ThreadInfo
+  /* An object whose emission was deferred, together with the origin
+     time of the round that emitted it.
+   */
+  struct BufferedObject
+  {
+    BufferedObject(const PiiVariant& obj = PiiVariant(), qint64 originTime = 0) :
+      object(obj), iOriginTime(originTime)
+    {}
+    PiiVariant object;
+    qint64 iOriginTime;
+  };
+
+  /* One processing round in the emission queue. Objects emitted
+     during the round are kept in the slot until the round gets the
+     emission turn. *iFlushed* is the number of objects already
+     passed.
+   */
+  struct EmissionSlot
   {
-    ThreadInfo(Qt::HANDLE i=0, bool f = false) : id(i), bFinished(f) {}
+    EmissionSlot(Qt::HANDLE i=0) : id(i), bFinished(false), iEmittedCount(0), iFlushed(0) {}
     Qt::HANDLE id;
     bool bFinished;
+    int iEmittedCount;
+    int iFlushed;
+    QList<BufferedObject> lstObjects;
+  };
+
+  /* A ring buffer of emission slots in queue order. The capacity is
+     a power of two and grows with the number of concurrent rounds,
+     which is bounded by the number of threads. Removing the round
+     that has the emission turn is O(1).
+   */
+  class EmissionQueue
+  {
+  public:
+    EmissionQueue() : _vecSlots(16), _iFirst(0), _iCount(0) {}
+
+    int size() const { return _iCount; }
+    bool isEmpty() const { return _iCount == 0; }
+    EmissionSlot& operator[] (int index) { return _vecSlots[(_iFirst + index) & (_vecSlots.size() - 1)]; }
+    const EmissionSlot& operator[] (int index) const { return _vecSlots[(_iFirst + index) & (_vecSlots.size() - 1)]; }
+
+    void append(Qt::HANDLE id);
+    void removeFirst();
+    void clear();
+
+  private:
+    QVector<EmissionSlot> _vecSlots;
+    int _iFirst, _iCount;
   };
 
-#if (QT_VERSION < 0x040800)
-  typedef QVector<ThreadInfo> ThreadList;
-#else
-  typedef QVarLengthArray<ThreadInfo,16> ThreadList;
-#endif
-  typedef QLinkedList<QPair<Qt::HANDLE,PiiVariant> > OutputBuffer;
+  class Lane;
+
+  // Per-connection back-pressure handling.
+  struct Connection
+  {
+    Connection(PiiAbstractInputSocket* input = 0) :
+      pInput(input), policy(BlockWhenFull), iQueueCapacity(1), iDroppedCount(0)
+    {}
+    PiiAbstractInputSocket* pInput;
+    BackPressurePolicy policy;
+    int iQueueCapacity;
+    int iDroppedCount;
+    QList<BufferedObject> lstQueue;
+  };
 
   class Data :
     public PiiAbstractOutputSocket::Data,
@@ -372,11 +580,16 @@ protected:
     bool setOutputConnected(bool connected);
 
     inline int queueIndex(Qt::HANDLE threadId) const;
-    inline bool hasBufferedObjects(Qt::HANDLE activeThreadId) const;
     void inputConnected(PiiAbstractInputSocket* input);
     void inputDisconnected(PiiAbstractInputSocket* input);
     void inputUpdated(PiiAbstractInputSocket* input);
     void createFlagArray();
+    int connectionIndex(PiiAbstractInputSocket* input) const;
+    void updateBlocking();
+    bool tryToReceive(int index, const PiiVariant& object);
+    bool receiveOrQueue(int index, const PiiVariant& object);
+    bool passQueued(int index);
+    void drainQueues();
 
     int iGroupId;
     bool bConnected;
@@ -387,12 +600,28 @@ protected:
     PiiInputController* pFirstController;
     bool bInterrupted;
     bool *pbInputCompleted;
+    QVector<Connection> vecConnections;
+    // True if all connections use BlockWhenFull.
+    bool bAllBlocking;
+    // Serializes access to side queues and to the inputs of
+    // non-blocking connections. The sender and the inputReady()
+    // handlers of receivers both pass queued objects.
+    QMutex queueMutex;
+    // Set when a receiver has signaled room but could not lock
+    // queueMutex. The holder drains the queues after unlocking.
+    PiiAtomicInt iDrainRequests;
     PiiSocketState state;
     Qt::HANDLE activeThreadId;
-    OutputBuffer lstBuffer;
-    ThreadList lstThreads;
+    EmissionOrder emissionOrder;
+    EmissionQueue emissionQueue;
+    // Objects emitted by threads that are not in the emission queue.
+    // Passed once the queue becomes empty.
+    QList<BufferedObject> lstUnqueuedObjects;
     QMutex emitLock;
     QWaitCondition endEmitCondition;
+    qint64 iStallTime;
+    int iEmittedCount;
+    Lane* pLane;
   };
   PII_UNSAFE_D_FUNC;
 
@@ -401,8 +630,11 @@ protected:
 
 private:
   bool flushBuffer();
+  bool flushObjects(QList<BufferedObject>& objects, int& flushed);
   void emitThreaded(const PiiVariant& object);
+  void emitUnordered(const PiiVariant& object);
   void emitNonThreaded(const PiiVariant& object);
+  void emitFromLane(const PiiVariant& object);
 };
 
 Q_DECLARE_METATYPE(PiiOutputSocket*);
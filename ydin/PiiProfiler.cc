@@ -0,0 +1,171 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiProfiler.h"
+
+#include <PiiTimer.h>
+#ifndef PII_NO_QT
+#  include <QAtomicPointer>
+#  include <QIODevice>
+
+static QAtomicPointer<PiiProfiler> activeProfilerPtr;
+#else
+#  include <atomic>
+
+static std::atomic<PiiProfiler*> activeProfilerPtr(0);
+#endif
+
+PiiProfiler::PiiProfiler(int capacity) :
+  _iStartTime(PiiTimer::timestamp())
+{
+  int iSize = 1;
+  while (iSize < capacity && iSize < (1 << 30))
+    iSize <<= 1;
+  _vecEvents.resize(iSize);
+}
+
+PiiProfiler::~PiiProfiler()
+{
+  // Avoid leaving a dangling pointer behind.
+#ifndef PII_NO_QT
+  activeProfilerPtr.testAndSetOrdered(this, 0);
+#else
+  PiiProfiler* pThis = this;
+  activeProfilerPtr.compare_exchange_strong(pThis, 0);
+#endif
+}
+
+PiiProfiler* PiiProfiler::activeProfiler()
+{
+#if defined(PII_NO_QT)
+  return activeProfilerPtr.load(std::memory_order_acquire);
+#elif QT_VERSION >= 0x050000
+  return activeProfilerPtr.loadAcquire();
+#else
+  return activeProfilerPtr;
+#endif
+}
+
+void PiiProfiler::setActiveProfiler(PiiProfiler* profiler)
+{
+#ifndef PII_NO_QT
+  activeProfilerPtr.fetchAndStoreOrdered(profiler);
+#else
+  activeProfilerPtr.exchange(profiler);
+#endif
+}
+
+void PiiProfiler::setOperationName(const PiiOperation* operation, const QString& name)
+{
+  _hashNames.insert(operation, name);
+}
+
+void PiiProfiler::clear()
+{
+  _iNextIndex.store(0);
+  _iStartTime = PiiTimer::timestamp();
+}
+
+int PiiProfiler::eventCount() const
+{
+  return int(qMin(quint32(_iNextIndex.load()), quint32(_vecEvents.size())));
+}
+
+QVector<PiiProfiler::Event> PiiProfiler::events() const
+{
+  const int iCount = eventCount();
+  const int iMask = _vecEvents.size() - 1;
+  const int iFirst = _iNextIndex.load() - iCount;
+  QVector<Event> vecResult(iCount);
+  for (int i=0; i<iCount; ++i)
+    vecResult[i] = _vecEvents[(iFirst + i) & iMask];
+  return vecResult;
+}
+
+#ifndef PII_NO_QT
+static QByteArray jsonString(const QString& str)
+{
+  QByteArray aResult("\"");
+  QByteArray aUtf8(str.toUtf8());
+  for (int i=0; i<aUtf8.size(); ++i)
+    {
+      char c = aUtf8[i];
+      if (c == '"' || c == '\\')
+        aResult += '\\';
+      if (uchar(c) >= 0x20)
+        aResult += c;
+    }
+  aResult += '"';
+  return aResult;
+}
+
+static QByteArray traceSlice(const QByteArray& name, const char* category,
+                             qint64 start, qint64 duration, int threadIndex)
+{
+  return ",\n{\"name\":" + name +
+    ",\"cat\":\"" + category +
+    "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(threadIndex) +
+    ",\"ts\":" + QByteArray::number(start) +
+    ",\"dur\":" + QByteArray::number(duration);
+}
+
+void PiiProfiler::writeChromeTrace(QIODevice* device) const
+{
+  QVector<Event> vecEvents(events());
+  QHash<Qt::HANDLE,int> hashThreads;
+  QHash<const PiiOperation*,QByteArray> hashNames;
+
+  device->write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Into\"}}");
+  for (int i=0; i<vecEvents.size(); ++i)
+    {
+      const Event& event = vecEvents[i];
+      if (event.pOperation == 0)
+        continue;
+
+      // Number threads in the order they first appear.
+      int iThread = hashThreads.value(event.threadId, -1);
+      if (iThread == -1)
+        {
+          iThread = hashThreads.size() + 1;
+          hashThreads.insert(event.threadId, iThread);
+          device->write(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+                        QByteArray::number(iThread) +
+                        ",\"args\":{\"name\":\"Thread " + QByteArray::number(iThread) + "\"}}");
+        }
+
+      QHash<const PiiOperation*,QByteArray>::const_iterator it = hashNames.constFind(event.pOperation);
+      if (it == hashNames.constEnd())
+        {
+          QString strName = _hashNames.value(event.pOperation);
+          if (strName.isEmpty())
+            strName = QString("0x%1").arg(quintptr(event.pOperation), 0, 16);
+          it = hashNames.insert(event.pOperation, jsonString(strName));
+        }
+
+      device->write(traceSlice(*it, "process",
+                               event.iStartTime - _iStartTime,
+                               event.iProcessedTime - event.iStartTime,
+                               iThread) +
+                    ",\"args\":{\"queueLength\":" + QByteArray::number(event.iQueueLength) +
+                    ",\"emitted\":" + QByteArray::number(event.iEmittedCount) + "}}");
+      device->write(traceSlice(*it, "emit",
+                               event.iProcessedTime - _iStartTime,
+                               event.iEndTime - event.iProcessedTime,
+                               iThread) + "}");
+    }
+  device->write("\n]}\n");
+}
+#endif
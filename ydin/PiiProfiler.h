@@ -0,0 +1,152 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPROFILER_H
+#define _PIIPROFILER_H
+
+#include "PiiYdin.h"
+
+#include <PiiAtomicInt.h>
+#include <QVector>
+#include <QHash>
+#include <QString>
+
+class PiiOperation;
+#ifndef PII_NO_QT
+class QIODevice;
+#endif
+
+/**
+ * A recorder for a timeline of processing rounds. PiiProfiler stores
+ * an event for each processing round of each operation into a
+ * pre-allocated ring buffer. Recording takes no locks, and once the
+ * buffer is full, the oldest events will be overwritten. The
+ * timeline can be written out in the Chrome trace event format,
+ * which can be viewed with `chrome://tracing` or the Perfetto UI.
+ *
+ * Only one profiler can be active in a process at a time. Usually,
+ * the profiler is controlled through PiiEngine::startProfiling() and
+ * PiiEngine::stopProfiling(). Profiling relies on the same time
+ * measurements as [PiiOperationStatistics] and records nothing if
+ * statistics are compiled out.
+ */
+class PII_YDIN_EXPORT PiiProfiler
+{
+public:
+  /**
+   * A processing round.
+   */
+  struct Event
+  {
+    Event() :
+      pOperation(0), threadId(0),
+      iStartTime(0), iProcessedTime(0), iEndTime(0),
+      iQueueLength(0), iEmittedCount(0)
+    {}
+
+    /// The operation that was processed.
+    const PiiOperation* pOperation;
+    /// The thread that processed it.
+    Qt::HANDLE threadId;
+    /// The time process() was called, in microseconds.
+    qint64 iStartTime;
+    /// The time process() returned.
+    qint64 iProcessedTime;
+    /// The time all emitted objects had been passed on.
+    qint64 iEndTime;
+    /// The longest input queue at the beginning of the round.
+    int iQueueLength;
+    /// The number of objects emitted during the round.
+    int iEmittedCount;
+  };
+
+  /**
+   * Creates a profiler that can store *capacity* events. The
+   * capacity will be rounded up to the nearest power of two.
+   */
+  PiiProfiler(int capacity = 65536);
+  ~PiiProfiler();
+
+  /**
+   * Returns the profiler that is currently recording events, or zero
+   * if profiling is not active.
+   */
+  static PiiProfiler* activeProfiler();
+
+  /**
+   * Makes *profiler* the active one. Pass zero to stop profiling.
+   * Processing threads may still be recording to the previously
+   * active profiler when this function returns. Therefore, a
+   * profiler must not be deleted immediately after deactivation.
+   */
+  static void setActiveProfiler(PiiProfiler* profiler);
+
+  /**
+   * Records an event. This function can be called concurrently from
+   * any number of threads.
+   */
+  void record(const Event& event)
+  {
+    int iIndex = _iNextIndex++;
+    _vecEvents[iIndex & (_vecEvents.size() - 1)] = event;
+  }
+
+  /**
+   * Assigns a human-readable name to *operation*. Names are used
+   * when writing the trace. Operations with no name are identified
+   * by their memory address. This function is not thread-safe and
+   * should be called before the profiler is activated.
+   */
+  void setOperationName(const PiiOperation* operation, const QString& name);
+
+  /**
+   * Discards all recorded events and restarts the clock. This
+   * function is not thread-safe.
+   */
+  void clear();
+
+  int capacity() const { return _vecEvents.size(); }
+
+  /**
+   * Returns the number of events currently in the buffer.
+   */
+  int eventCount() const;
+
+  /**
+   * Returns all events currently stored, in recording order. If the
+   * profiler is still active, the newest events may be incomplete.
+   */
+  QVector<Event> events() const;
+
+#ifndef PII_NO_QT
+  /**
+   * Writes the recorded events to *device* as Chrome trace event
+   * JSON. Each processing round is presented as a "process" slice
+   * followed by an "emit" slice on the row of the thread that ran it.
+   * Long "emit" slices show where emission was blocked by full
+   * input queues downstream. Time stamps are relative to the
+   * creation of the profiler or the last [clear()] call.
+   */
+  void writeChromeTrace(QIODevice* device) const;
+#endif
+
+private:
+  QVector<Event> _vecEvents;
+  PiiAtomicInt _iNextIndex;
+  QHash<const PiiOperation*,QString> _hashNames;
+  qint64 _iStartTime;
+};
+
+#endif //_PIIPROFILER_H
@@ -0,0 +1,148 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiPropertyBatch.h"
+#include "PiiOperationCompound.h"
+
+#include <QHash>
+
+PiiPropertyBatch::PiiPropertyBatch()
+{}
+
+PiiPropertyBatch::PiiPropertyBatch(PiiOperation* root, const QStringList& names) :
+  _pRoot(root),
+  _lstNames(names)
+{
+  resolve();
+}
+
+void PiiPropertyBatch::setProperties(PiiOperation* root, const QStringList& names)
+{
+  _pRoot = root;
+  _lstNames = names;
+  resolve();
+}
+
+void PiiPropertyBatch::resolve()
+{
+  _vecProperties.fill(Property(), _lstNames.size());
+  _vecGroups.clear();
+  if (_pRoot == 0)
+    return;
+
+  QHash<PiiOperation*,int> hashGroups;
+  for (int i=0; i<_lstNames.size(); ++i)
+    {
+      // Descend as deep as there are child operations in the path.
+      PiiOperation* pOperation = _pRoot;
+      QString strName(_lstNames[i]);
+      for (int iDot; (iDot = strName.indexOf('.')) != -1 && pOperation->isCompound(); )
+        {
+          PiiOperation* pChild = static_cast<PiiOperationCompound*>(pOperation)->childOperation(strName.left(iDot));
+          if (pChild == 0)
+            break;
+          pOperation = pChild;
+          strName = strName.mid(iDot+1);
+        }
+
+      Property& property = _vecProperties[i];
+      property.aName = strName.toLatin1();
+      property.iGroup = hashGroups.value(pOperation, -1);
+      if (property.iGroup == -1)
+        {
+          property.iGroup = _vecGroups.size();
+          hashGroups.insert(pOperation, property.iGroup);
+          _vecGroups.append(Group());
+          _vecGroups.last().pOperation = pOperation;
+        }
+      property.iIndex = pOperation->metaObject()->indexOfProperty(property.aName.constData());
+      if (property.iIndex != -1)
+        {
+          _vecGroups[property.iGroup].vecIndices << property.iIndex;
+          _vecGroups[property.iGroup].vecPositions << i;
+        }
+    }
+}
+
+PiiOperation* PiiPropertyBatch::root() const { return _pRoot; }
+QStringList PiiPropertyBatch::names() const { return _lstNames; }
+int PiiPropertyBatch::count() const { return _lstNames.size(); }
+
+QVariantList PiiPropertyBatch::values() const
+{
+  QVariantList lstValues;
+  lstValues.reserve(_vecProperties.size());
+  for (int i=0; i<_vecProperties.size(); ++i)
+    lstValues << QVariant();
+
+  for (int i=0; i<_vecGroups.size(); ++i)
+    {
+      const Group& group = _vecGroups[i];
+      if (group.pOperation == 0 || group.vecIndices.isEmpty())
+        continue;
+      QVariantList lstGroupValues(group.pOperation->propertyValues(group.vecIndices));
+      for (int j=0; j<group.vecPositions.size(); ++j)
+        lstValues[group.vecPositions[j]] = lstGroupValues[j];
+    }
+
+  // Properties without a meta-property index go through property().
+  for (int i=0; i<_vecProperties.size(); ++i)
+    {
+      const Property& property = _vecProperties[i];
+      if (property.iIndex == -1 && property.iGroup != -1)
+        {
+          PiiOperation* pOperation = _vecGroups[property.iGroup].pOperation;
+          if (pOperation != 0)
+            lstValues[i] = pOperation->property(property.aName.constData());
+        }
+    }
+  return lstValues;
+}
+
+int PiiPropertyBatch::setValues(const QVariantList& values)
+{
+  int iSetCount = 0;
+  const int iCount = qMin(values.size(), _vecProperties.size());
+  for (int i=0; i<iCount; ++i)
+    {
+      const Property& property = _vecProperties[i];
+      if (!values[i].isValid() || property.iGroup == -1)
+        continue;
+      PiiOperation* pOperation = _vecGroups[property.iGroup].pOperation;
+      if (pOperation != 0 && pOperation->setProperty(property.aName.constData(), values[i]))
+        ++iSetCount;
+    }
+  return iSetCount;
+}
+
+QVector<int> PiiPropertyBatch::update(QVariantList& values) const
+{
+  QVariantList lstNewValues(this->values());
+  QVector<int> vecChanged;
+  if (values.size() != lstNewValues.size())
+    {
+      vecChanged.reserve(lstNewValues.size());
+      for (int i=0; i<lstNewValues.size(); ++i)
+        vecChanged << i;
+    }
+  else
+    {
+      for (int i=0; i<lstNewValues.size(); ++i)
+        if (lstNewValues[i] != values[i])
+          vecChanged << i;
+    }
+  values = lstNewValues;
+  return vecChanged;
+}
@@ -0,0 +1,143 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPROPERTYBATCH_H
+#define _PIIPROPERTYBATCH_H
+
+#include "PiiOperation.h"
+
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * Reads and writes a fixed set of properties in an operation tree.
+ * PiiOperationCompound::property() splits nested names such as
+ * "reader.imageCount" at every call, and QObject::property() looks
+ * the final name up in the meta-object. When the same properties are
+ * read over and over again, e.g. by a user interface, these lookups
+ * cost more than the actual reads. PiiPropertyBatch resolves the
+ * names once and groups the properties by the operation that owns
+ * them. Reading all values then takes one
+ * [PiiOperation::propertyValues()] call per operation, which
+ * PiiDefaultOperation serves while holding its property lock only
+ * once.
+ *
+ * ~~~(c++)
+ * PiiPropertyBatch batch(pEngine,
+ *                        QStringList() << "reader.imageCount"
+ *                                      << "detector.threshold"
+ *                                      << "classifier.classCount");
+ * QVariantList lstValues = batch.values();
+ * // Later
+ * QVector<int> vecChanged = batch.update(lstValues);
+ * ~~~
+ *
+ * Names that refer to properties declared with `Q_PROPERTY` are
+ * read by index. Everything else, e.g. dynamic properties and names
+ * an operation handles in its own [PiiOperation::property()]
+ * function, is read by name from the deepest child operation found
+ * in the path. The names are not resolved again automatically. If
+ * operations are added to or removed from the tree, call
+ * [resolve()]. The values of properties whose owner has been
+ * deleted are invalid.
+ *
+ * Values are compared with QVariant's equality operator. Types it
+ * cannot compare may be reported as changed every time.
+ */
+class PII_YDIN_EXPORT PiiPropertyBatch
+{
+public:
+  /**
+   * Creates an empty batch.
+   */
+  PiiPropertyBatch();
+
+  /**
+   * Creates a batch that accesses the properties *names* in
+   * *root* and its children.
+   */
+  PiiPropertyBatch(PiiOperation* root, const QStringList& names);
+
+  /**
+   * Replaces the root operation and the property names and resolves
+   * the names.
+   */
+  void setProperties(PiiOperation* root, const QStringList& names);
+
+  /**
+   * Resolves the property names again.
+   */
+  void resolve();
+
+  /**
+   * Returns the root operation.
+   */
+  PiiOperation* root() const;
+
+  /**
+   * Returns the names of the properties in the batch.
+   */
+  QStringList names() const;
+
+  /**
+   * Returns the number of properties in the batch.
+   */
+  int count() const;
+
+  /**
+   * Returns the current values of all properties in the order of
+   * [names()].
+   */
+  QVariantList values() const;
+
+  /**
+   * Sets the properties to *values*, which must be in the order of
+   * [names()]. Invalid variants are skipped. The properties are set
+   * with [PiiOperation::setProperty()] so that property sets, limits
+   * and write restrictions apply. Returns the number of properties
+   * successfully set.
+   */
+  int setValues(const QVariantList& values);
+
+  /**
+   * Reads the current values and stores them to *values*, which
+   * holds the previous ones. Returns the indices of the properties
+   * whose values changed. If the size of *values* doesn't match
+   * [count()], all properties are considered changed.
+   */
+  QVector<int> update(QVariantList& values) const;
+
+private:
+  struct Group
+  {
+    QPointer<PiiOperation> pOperation;
+    // Meta-property indices and their positions in the batch
+    QVector<int> vecIndices, vecPositions;
+  };
+  struct Property
+  {
+    Property() : iGroup(-1), iIndex(-1) {}
+    int iGroup, iIndex;
+    QByteArray aName;
+  };
+
+  QPointer<PiiOperation> _pRoot;
+  QStringList _lstNames;
+  QVector<Property> _vecProperties;
+  QVector<Group> _vecGroups;
+};
+
+#endif //_PIIPROPERTYBATCH_H
@@ -17,6 +17,7 @@
 #define _PIIPROXYSOCKET_H
 
 #include "PiiYdin.h"
+#include <QObject>
 
 class PiiSocket;
 class PiiAbstractInputSocket;
@@ -0,0 +1,94 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiScheduler.h"
+
+#include <PiiTimer.h>
+#include <PiiSynchronized.h>
+#include <QThread>
+
+PiiScheduler::PiiScheduler() :
+  _iCoreCount(qMax(1, QThread::idealThreadCount()))
+{
+  _aMaxDelays[CriticalClass] = 0;
+  _aMaxDelays[NormalClass] = 20;
+  _aMaxDelays[BackgroundClass] = 200;
+}
+
+PiiScheduler* PiiScheduler::instance()
+{
+  static PiiScheduler scheduler;
+  return &scheduler;
+}
+
+bool PiiScheduler::mustWait(SchedulingClass schedulingClass) const
+{
+  const int iCritical = _aRunning[CriticalClass].load();
+  const int iTotal = iCritical + _aRunning[NormalClass].load() + _aRunning[BackgroundClass].load();
+  if (iTotal < _iCoreCount)
+    return false;
+  switch (schedulingClass)
+    {
+    case NormalClass:
+      return iCritical > 0;
+    case BackgroundClass:
+      return true;
+    default:
+      return false;
+    }
+}
+
+void PiiScheduler::enter(SchedulingClass schedulingClass)
+{
+  if (schedulingClass != CriticalClass && mustWait(schedulingClass))
+    {
+      PiiTimer timer;
+      const int iMaxDelay = _aMaxDelays[schedulingClass];
+      synchronized (_mutex)
+        {
+          // Announce the waiter before checking again. leave()
+          // decrements the counters before it looks at _iWaiting,
+          // so a wake-up cannot be lost.
+          ++_iWaiting;
+          forever
+            {
+              const qint64 iElapsed = timer.milliseconds();
+              if (!mustWait(schedulingClass) || iElapsed >= iMaxDelay)
+                break;
+              _condition.wait(&_mutex, iMaxDelay - iElapsed);
+            }
+          --_iWaiting;
+        }
+    }
+  ++_aRunning[schedulingClass];
+}
+
+void PiiScheduler::leave(SchedulingClass schedulingClass)
+{
+  --_aRunning[schedulingClass];
+  if (_iWaiting.load() > 0)
+    synchronized (_mutex) _condition.wakeAll();
+}
+
+void PiiScheduler::setCoreCount(int coreCount) { _iCoreCount = qMax(1, coreCount); }
+int PiiScheduler::coreCount() const { return _iCoreCount; }
+
+void PiiScheduler::setMaxDelay(SchedulingClass schedulingClass, int maxDelay)
+{
+  _aMaxDelays[schedulingClass] = qMax(0, maxDelay);
+}
+
+int PiiScheduler::maxDelay(SchedulingClass schedulingClass) const { return _aMaxDelays[schedulingClass]; }
+int PiiScheduler::runningCount(SchedulingClass schedulingClass) const { return _aRunning[schedulingClass].load(); }
@@ -0,0 +1,140 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISCHEDULER_H
+#define _PIISCHEDULER_H
+
+#include "PiiYdin.h"
+
+#include <PiiAtomicInt.h>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * A process-wide admission gate for processing rounds. Thread
+ * priorities (see [PiiDefaultOperation::priority]) are coarse, and on
+ * some platforms they cannot be changed at all. PiiScheduler instead
+ * decides which rounds may start when there are more runnable rounds
+ * than processor cores. Each operation belongs to a
+ * [SchedulingClass](PiiDefaultOperation::schedulingClass):
+ *
+ * - `CriticalClass` - latency-critical work, such as the reject path
+ *   of an inspection pipeline. Critical rounds always start
+ *   immediately.
+ *
+ * - `NormalClass` - the default. Normal rounds start immediately
+ *   unless all cores are busy and at least one critical round is
+ *   running.
+ *
+ * - `BackgroundClass` - archiving, statistics, user interface
+ *   feeds. Background rounds start only if there are idle cores.
+ *
+ * A round that is held back waits until another round finishes or
+ * its class' [maxDelay()] has elapsed, whichever comes first. The
+ * delay is the deadline of the class: held-back rounds are never
+ * starved, and an upstream operation waiting for a full downstream
+ * queue cannot deadlock the pipeline.
+ *
+ * Rounds that don't need to wait cost two atomic operations. The
+ * scheduler applies to operations that have processing threads of
+ * their own (a non-zero [PiiDefaultOperation::threadCount]).
+ * Non-threaded operations run as part of their sender's round.
+ */
+class PII_YDIN_EXPORT PiiScheduler
+{
+public:
+  /**
+   * Scheduling classes, in decreasing order of precedence.
+   */
+  enum SchedulingClass { CriticalClass, NormalClass, BackgroundClass };
+  enum { ClassCount = 3 };
+
+  /**
+   * Marks a processing round as running for the lifetime of the
+   * object.
+   *
+   * ~~~(c++)
+   * {
+   *   PiiScheduler::Round round(PiiScheduler::BackgroundClass);
+   *   doSomethingHeavy();
+   * }
+   * ~~~
+   */
+  class Round
+  {
+  public:
+    Round(SchedulingClass schedulingClass, PiiScheduler* scheduler = PiiScheduler::instance()) :
+      _pScheduler(scheduler), _class(schedulingClass)
+    {
+      _pScheduler->enter(_class);
+    }
+    ~Round() { _pScheduler->leave(_class); }
+
+  private:
+    PiiScheduler* _pScheduler;
+    SchedulingClass _class;
+  };
+
+  PiiScheduler();
+
+  /**
+   * Returns a pointer to the application-wide scheduler.
+   */
+  static PiiScheduler* instance();
+
+  /**
+   * Blocks the calling thread until a round of the given class may
+   * start and marks it as running.
+   */
+  void enter(SchedulingClass schedulingClass);
+  /**
+   * Marks a round of the given class as finished.
+   */
+  void leave(SchedulingClass schedulingClass);
+
+  /**
+   * Sets the number of rounds that may run concurrently before the
+   * cores are considered contended. The default value is
+   * QThread::idealThreadCount().
+   */
+  void setCoreCount(int coreCount);
+  int coreCount() const;
+
+  /**
+   * Sets the longest time, in milliseconds, a round of the given
+   * class may be held back. The defaults are 0 for critical, 20 for
+   * normal and 200 for background rounds.
+   */
+  void setMaxDelay(SchedulingClass schedulingClass, int maxDelay);
+  int maxDelay(SchedulingClass schedulingClass) const;
+
+  /**
+   * Returns the number of rounds of the given class currently
+   * running.
+   */
+  int runningCount(SchedulingClass schedulingClass) const;
+
+private:
+  inline bool mustWait(SchedulingClass schedulingClass) const;
+
+  PiiAtomicInt _aRunning[ClassCount];
+  PiiAtomicInt _iWaiting;
+  int _iCoreCount;
+  int _aMaxDelays[ClassCount];
+  QMutex _mutex;
+  QWaitCondition _condition;
+};
+
+#endif //_PIISCHEDULER_H
@@ -16,13 +16,15 @@
 #include "PiiDefaultOperation.h"
 #include "PiiYdinTypes.h"
 #include "PiiSimpleProcessor.h"
+#include <PiiSynchronized.h>
 
 #include <QMutex>
 
 PiiSimpleProcessor::PiiSimpleProcessor(PiiDefaultOperation* parent) :
   PiiOperationProcessor(parent),
-  _bReset(false), _bProcessing(false),
-  _pStateMutex(&(parent->_d()->stateMutex))
+  _bReset(false), _bProcessing(false), _bFused(false),
+  _pStateMutex(&(parent->_d()->stateMutex)),
+  _iLastRoundEnd(0)
 {
 }
 
@@ -38,9 +40,18 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
     _pParentOp->setState(PiiOperation::Running);
 
   PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-  if (pInput->canReceive())
+  // In a fused chain, an ordinary object that arrives into an empty
+  // queue can be processed right away. The flow controller would
+  // have nothing to synchronize.
+  bool bDirect = _bFused && !_bProcessing &&
+    pInput->queueLength() == 0 &&
+    PiiYdin::isNonControlType(object.type());
+  if (bDirect || pInput->canReceive())
     {
-      pInput->receive(object);
+      if (bDirect)
+        pInput->receiveFirst(object);
+      else
+        pInput->receive(object);
       /*PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
       qDebug("%s: %d objects in queue",
              qPrintable(pInput->objectName()), pInput->queueLength());
@@ -53,21 +64,31 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
           do
             {
               PiiFlowController::FlowState state;
-              try
+              if (bDirect)
                 {
-                  // See if we can process the objects.
-                  //qDebug("%s: calling flow controller", qPrintable(_pParentOp->objectName()));
-                  state = _pFlowController->prepareProcess();
-                  //qDebug("%s: flow controller returned %d", qPrintable(_pParentOp->objectName()), int(state));
-                  if (state == PiiFlowController::IncompleteState)
-                    break;
+                  state = PiiFlowController::ProcessableState;
+                  bDirect = false;
                 }
-              catch (...)
+              else
                 {
-                  // If a synchronization or any other error
-                  // occurs, we need to ensure the lock is opened.
-                  lock.unlock();
-                  throw;
+                  try
+                    {
+                      // See if we can process the objects.
+                      //qDebug("%s: calling flow controller", qPrintable(_pParentOp->objectName()));
+                      state = _pFlowController->prepareProcess();
+                      //qDebug("%s: flow controller returned %d", qPrintable(_pParentOp->objectName()), int(state));
+                      if (state == PiiFlowController::IncompleteState)
+                        break;
+                      else if (state == PiiFlowController::ProcessableState)
+                        prepareBatch();
+                    }
+                  catch (...)
+                    {
+                      // If a synchronization or any other error
+                      // occurs, we need to ensure the lock is opened.
+                      lock.unlock();
+                      throw;
+                    }
                 }
 
               // Exit critical section. The objects have been
@@ -83,7 +104,7 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
               switch (state)
                 {
                 case PiiFlowController::ProcessableState:
-                  _pParentOp->processLocked(); // may throw
+                  measuredProcess(_statistics, _iLastRoundEnd); // may throw
                 case PiiFlowController::SynchronizedState:
                 case PiiFlowController::IncompleteState:
                   break;
@@ -103,6 +124,7 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
               // flag.
               lock.relock();
               _bProcessing = false;
+              mergeStatistics(_statistics, _iLastRoundEnd);
             }
           while (_bReset);
         }
@@ -143,6 +165,8 @@ bool PiiSimpleProcessor::tryToReceive(PiiAbstractInputSocket* sender, const PiiV
 void PiiSimpleProcessor::check(bool reset)
 {
   _bProcessing = false;
+  _iLastRoundEnd = 0;
+  _bFused = _pParentOp->_d()->bFused;
   if (reset)
     _bReset = true;
 }
@@ -259,3 +283,10 @@ int PiiSimpleProcessor::activeInputGroup() const
 {
   return _pFlowController->activeInputGroup();
 }
+
+void PiiSimpleProcessor::flushStatistics()
+{
+  synchronized (_pStateMutex)
+    if (!_bProcessing)
+      mergeStatistics(_statistics);
+}
@@ -90,12 +90,19 @@ public:
 
   int activeInputGroup() const;
 
+  void flushStatistics();
+
 private:
   void stop(PiiOperation::State finalState);
 
   volatile bool _bReset;
   bool _bProcessing;
+  // True if the parent operation is a non-head link of a fused chain.
+  bool _bFused;
   QMutex* _pStateMutex;
+  // Only accessed by the thread that has set _bProcessing.
+  PiiOperationStatistics::Collector _statistics;
+  qint64 _iLastRoundEnd;
 };
 
 #endif //_PIISIMPLEPROCESSOR_H
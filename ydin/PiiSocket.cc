@@ -15,6 +15,9 @@
 
 #include "PiiSocket.h"
 #include "PiiOperation.h"
+#ifdef PII_NO_QT
+#  include "PiiOperationCompound.h"
+#endif
 
 PiiSocket::Data::Data(Type t) :
   type(t)
@@ -28,6 +31,20 @@ PiiSocket::PiiSocket(Data* d) :
 
 PiiSocket::~PiiSocket()
 {
+#ifdef PII_NO_QT
+  // There is no destroyed() signal. Remove this socket from the
+  // compounds that may have exposed it.
+  for (QObject* pParent = parent(); pParent != 0; pParent = pParent->parent())
+    {
+      PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(pParent);
+      if (pCompound == 0)
+        continue;
+      if (isInput())
+        pCompound->removeExposedInput(this);
+      else
+        pCompound->removeExposedOutput(this);
+    }
+#endif
   delete d;
 }
 
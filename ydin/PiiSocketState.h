@@ -45,6 +45,7 @@ struct PII_YDIN_EXPORT PiiSocketState
     return flowLevel == other.flowLevel && delay == other.delay;
   }
 
+#ifndef PII_NO_QT
 private:
   friend struct PiiSerialization::Accessor;
   PII_SEPARATE_SAVE_LOAD_MEMBERS
@@ -62,6 +63,7 @@ private:
     archive >> PII_NVP("delay", iTmp);
     delay = iTmp;
   }
+#endif
 };
 
 #endif //_PIISOCKETSTATE_H
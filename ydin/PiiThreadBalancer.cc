@@ -0,0 +1,243 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiThreadBalancer.h"
+#include "PiiOperationCompound.h"
+#include "PiiDefaultOperation.h"
+#include "PiiOperationProcessor.h"
+#include "PiiInputSocket.h"
+
+#include <PiiTimer.h>
+#include <PiiSynchronized.h>
+
+#include <algorithm>
+
+namespace
+{
+  // An operation needs more threads if its queues are at least half
+  // full, its threads are busy processing and they don't wait for
+  // downstream.
+  const double dHighOccupancy = 0.5;
+  const double dHighUtilization = 0.75;
+  const double dHighStall = 0.25;
+  // An operation returns a thread if its queues are almost empty and
+  // its load per thread would still be moderate without it.
+  const double dLowOccupancy = 0.25;
+  const double dReleaseUtilization = 0.6;
+  const int iMinThreadCount = 2;
+}
+
+PiiThreadBalancer::Load::Load(PiiDefaultOperation* operation) :
+  pOperation(operation),
+  iLastTime(0), iLastProcessing(0), iLastStall(0),
+  dOccupancy(0), dUtilization(0), dStall(0),
+  bValid(false)
+{}
+
+PiiThreadBalancer::PiiThreadBalancer(PiiOperationCompound* compound, int budget) :
+  _iBudget(qMax(budget, iMinThreadCount)),
+  _iInterval(1000),
+  _bRunning(true)
+{
+  collectOperations(compound);
+}
+
+PiiThreadBalancer::~PiiThreadBalancer()
+{
+  stop();
+  wait();
+}
+
+void PiiThreadBalancer::collectOperations(PiiOperationCompound* compound)
+{
+  QList<PiiOperation*> lstOperations = compound->childOperations();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      if (PiiOperationCompound* pCompound = qobject_cast<PiiOperationCompound*>(lstOperations[i]))
+        collectOperations(pCompound);
+      else if (PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(lstOperations[i]))
+        {
+          if ((pOperation->threadingCapabilities() & PiiDefaultOperation::MultiThreaded) &&
+              pOperation->threadCount() >= iMinThreadCount)
+            _lstLoads << Load(pOperation);
+        }
+    }
+}
+
+void PiiThreadBalancer::run()
+{
+  forever
+    {
+      _mutex.lock();
+      if (_bRunning)
+        _condition.wait(&_mutex, _iInterval);
+      bool bRunning = _bRunning;
+      _mutex.unlock();
+      if (!bRunning)
+        break;
+      // Balancing calls into the processors and must not hold a lock
+      // stop() may need.
+      balance();
+    }
+}
+
+void PiiThreadBalancer::stop()
+{
+  synchronized (_mutex)
+    {
+      _bRunning = false;
+      _condition.wakeAll();
+    }
+}
+
+void PiiThreadBalancer::measure(Load& load, qint64 now)
+{
+  PiiDefaultOperation* pOperation = load.pOperation;
+  PiiDefaultOperation::Data* d = pOperation->_d();
+  d->pProcessor->flushStatistics();
+  qint64 iProcessing, iStall;
+  synchronized (d->statisticsMutex)
+    {
+      iProcessing = d->statistics.histogram(PiiOperationStatistics::Processing).iTotal;
+      iStall = d->statistics.histogram(PiiOperationStatistics::EmissionStall).iTotal;
+    }
+
+  double dOccupancy = 0;
+  QList<PiiAbstractInputSocket*> lstInputs = pOperation->inputs();
+  for (int i=0; i<lstInputs.size(); ++i)
+    {
+      PiiInputSocket* pInput = qobject_cast<PiiInputSocket*>(lstInputs[i]);
+      if (pInput != 0 && pInput->isConnected() && pInput->queueCapacity() > 0)
+        dOccupancy = qMax(dOccupancy, double(pInput->queueLength()) / pInput->queueCapacity());
+    }
+
+  const qint64 iElapsed = now - load.iLastTime;
+  // Statistics may have been reset meanwhile.
+  if (load.bValid && iElapsed > 0 &&
+      iProcessing >= load.iLastProcessing && iStall >= load.iLastStall)
+    {
+      const double dCapacity = double(iElapsed) * pOperation->threadCount();
+      load.dUtilization = (iProcessing - load.iLastProcessing) / dCapacity;
+      load.dStall = (iStall - load.iLastStall) / dCapacity;
+      // Queue length is a snapshot. Smooth it over rounds.
+      load.dOccupancy = (load.dOccupancy + dOccupancy) / 2;
+    }
+  else
+    {
+      load.dUtilization = load.dStall = 0;
+      load.dOccupancy = dOccupancy;
+    }
+  load.iLastTime = now;
+  load.iLastProcessing = iProcessing;
+  load.iLastStall = iStall;
+  load.bValid = pOperation->state() == PiiOperation::Running;
+}
+
+bool PiiThreadBalancer::isPressured(const Load& load) const
+{
+  return load.bValid &&
+    load.dOccupancy >= dHighOccupancy &&
+    load.dUtilization >= dHighUtilization &&
+    load.dStall < dHighStall;
+}
+
+bool PiiThreadBalancer::canSpare(const Load& load, double limit) const
+{
+  const int iThreads = load.pOperation->threadCount();
+  return load.bValid && iThreads > iMinThreadCount &&
+    load.dUtilization * iThreads / (iThreads - 1) < limit;
+}
+
+void PiiThreadBalancer::setThreadCount(Load& load, int threadCount)
+{
+  load.pOperation->setThreadCount(threadCount);
+  // The utilization per thread changes with the count. Don't let the
+  // next round decide based on the old value.
+  load.bValid = false;
+}
+
+namespace
+{
+  struct HigherPressure
+  {
+    HigherPressure(const QList<double>& pressures) : pressures(pressures) {}
+    bool operator() (int a, int b) const { return pressures[a] > pressures[b]; }
+    const QList<double>& pressures;
+  };
+}
+
+void PiiThreadBalancer::balance()
+{
+  const qint64 iNow = PiiTimer::timestamp();
+  int iUsed = 0;
+  for (int i=0; i<_lstLoads.size(); ++i)
+    {
+      measure(_lstLoads[i], iNow);
+      iUsed += _lstLoads[i].pOperation->threadCount();
+    }
+
+  QList<int> lstPressured;
+  QList<double> lstPressures;
+  for (int i=0; i<_lstLoads.size(); ++i)
+    {
+      Load& load = _lstLoads[i];
+      lstPressures << load.dOccupancy * load.dUtilization;
+      if (isPressured(load))
+        lstPressured << i;
+      else if (load.dOccupancy < dLowOccupancy && canSpare(load, dReleaseUtilization))
+        {
+          setThreadCount(load, load.pOperation->threadCount() - 1);
+          --iUsed;
+        }
+    }
+
+  // Serve the most congested operations first.
+  std::sort(lstPressured.begin(), lstPressured.end(), HigherPressure(lstPressures));
+  for (int i=0; i<lstPressured.size(); ++i)
+    {
+      Load& load = _lstLoads[lstPressured[i]];
+      if (iUsed >= _iBudget)
+        {
+          // Out of budget. Take a thread from the least loaded
+          // operation that won't become congested without it.
+          int iDonor = -1;
+          for (int j=0; j<_lstLoads.size(); ++j)
+            if (!isPressured(_lstLoads[j]) && canSpare(_lstLoads[j], dHighUtilization) &&
+                (iDonor == -1 || _lstLoads[j].dUtilization < _lstLoads[iDonor].dUtilization))
+              iDonor = j;
+          if (iDonor == -1)
+            break;
+          setThreadCount(_lstLoads[iDonor], _lstLoads[iDonor].pOperation->threadCount() - 1);
+          --iUsed;
+        }
+      setThreadCount(load, load.pOperation->threadCount() + 1);
+      ++iUsed;
+    }
+}
+
+void PiiThreadBalancer::setBudget(int budget)
+{
+  synchronized (_mutex) _iBudget = qMax(budget, iMinThreadCount);
+}
+
+int PiiThreadBalancer::budget() const { return _iBudget; }
+
+void PiiThreadBalancer::setInterval(int interval)
+{
+  synchronized (_mutex) _iInterval = qMax(interval, 1);
+}
+
+int PiiThreadBalancer::interval() const { return _iInterval; }
+int PiiThreadBalancer::operationCount() const { return _lstLoads.size(); }
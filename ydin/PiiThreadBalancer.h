@@ -0,0 +1,139 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITHREADBALANCER_H
+#define _PIITHREADBALANCER_H
+
+#include "PiiYdin.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+class PiiOperationCompound;
+class PiiDefaultOperation;
+
+/**
+ * Adjusts the [threadCount](PiiDefaultOperation::threadCount) of
+ * multi-threaded operations at run time to keep a pipeline balanced
+ * as load shifts. The balancer manages every PiiDefaultOperation
+ * within a compound (recursively) that is `MultiThreaded` and whose
+ * thread count was set to two or more before the compound was
+ * started. The sum of the thread counts of the managed operations
+ * is kept within a [budget()]. If the initial thread counts already
+ * exceed the budget, threads are moved between operations but the
+ * total is never raised.
+ *
+ * Once per [interval()], the balancer looks at the fill rate of the
+ * input queues of each operation and the fraction of the interval
+ * its threads spent in processing and in emission stall (see
+ * PiiOperationStatistics).
+ *
+ * - An operation whose queues are filling up while its threads are
+ *   busy processing gets one more thread, either from the free
+ *   budget or from the least loaded operation that can spare one.
+ *   Operations that spend their time waiting for downstream are not
+ *   given more threads because that would not help.
+ *
+ * - An operation whose queues are nearly empty and that would still
+ *   be moderately loaded with one thread less gives one back.
+ *
+ * Thread counts change by at most one per operation and round,
+ * which prevents oscillation. The thread count of an operation
+ * never drops below two.
+ *
+ * PiiEngine creates a balancer automatically if its
+ * [threadBudget](PiiEngine::threadBudget) is non-zero.
+ *
+ * ! Operations without connected inputs run their threads freely.
+ * Their thread count can be raised but lowering it has no effect
+ * until they are restarted.
+ */
+class PII_YDIN_EXPORT PiiThreadBalancer : public QThread
+{
+public:
+  /**
+   * Creates a balancer for the operations in *compound*. The set of
+   * managed operations is fixed at construction. *budget* is the
+   * total number of threads the managed operations may use.
+   */
+  PiiThreadBalancer(PiiOperationCompound* compound, int budget);
+  /**
+   * Stops the balancer and waits for it to exit.
+   */
+  ~PiiThreadBalancer();
+
+  /**
+   * Sets the total number of threads the managed operations may
+   * use.
+   */
+  void setBudget(int budget);
+  int budget() const;
+
+  /**
+   * Sets the time between balancing rounds, in milliseconds. The
+   * default is 1000.
+   */
+  void setInterval(int interval);
+  int interval() const;
+
+  /**
+   * Returns the number of operations being managed.
+   */
+  int operationCount() const;
+
+  /**
+   * Runs one balancing round in the calling thread. This function is
+   * called periodically by the balancer thread, but it can also be
+   * used to drive balancing manually without starting the thread.
+   */
+  void balance();
+
+  /**
+   * Asks the balancer thread to exit as soon as possible, but
+   * doesn't wait for it. This function can be safely called from a
+   * processing thread. A stopped balancer cannot be restarted.
+   */
+  void stop();
+
+protected:
+  void run();
+
+private:
+  struct Load
+  {
+    Load(PiiDefaultOperation* operation);
+
+    PiiDefaultOperation* pOperation;
+    qint64 iLastTime, iLastProcessing, iLastStall;
+    double dOccupancy, dUtilization, dStall;
+    bool bValid;
+  };
+
+  void collectOperations(PiiOperationCompound* compound);
+  void measure(Load& load, qint64 now);
+  void setThreadCount(Load& load, int threadCount);
+  bool isPressured(const Load& load) const;
+  bool canSpare(const Load& load, double limit) const;
+
+  QList<Load> _lstLoads;
+  int _iBudget, _iInterval;
+  bool _bRunning;
+  mutable QMutex _mutex;
+  QWaitCondition _condition;
+};
+
+#endif //_PIITHREADBALANCER_H
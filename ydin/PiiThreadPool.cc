@@ -0,0 +1,292 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiThreadPool.h"
+
+#include <PiiTimer.h>
+#include <PiiSynchronized.h>
+#include <PiiCpu.h>
+
+class PiiThreadPool::Thread : public QThread
+{
+public:
+  Thread(PiiThreadPool* pool) :
+    _pPool(pool),
+    _threadId(0),
+    _pTask(0),
+    _bRetired(false),
+    _bPriorityChanged(false)
+  {}
+
+  // _pPool->_mutex must be held when calling the functions below.
+  void startAndWait()
+  {
+    QThread::start();
+    while (_threadId == 0)
+      _condition.wait(&_pPool->_mutex);
+  }
+
+  void setTask(Task* task)
+  {
+    _pTask = task;
+    _condition.wakeOne();
+  }
+
+  void retire()
+  {
+    _bRetired = true;
+    _condition.wakeOne();
+  }
+
+  void setTaskPriority(QThread::Priority priority)
+  {
+    if (priority == QThread::InheritPriority)
+      return;
+    setPriority(priority);
+    _bPriorityChanged = true;
+  }
+
+  void setTaskAffinity(const QList<int>& cpus)
+  {
+    _lstCpus = cpus;
+  }
+
+  void restorePriority()
+  {
+    if (!_bPriorityChanged)
+      return;
+    setPriority(QThread::NormalPriority);
+    _bPriorityChanged = false;
+  }
+
+  Qt::HANDLE id() const { return _threadId; }
+
+protected:
+  void run()
+  {
+    QMutexLocker lock(&_pPool->_mutex);
+    _threadId = QThread::currentThreadId();
+    _condition.wakeAll();
+
+    forever
+      {
+        while (_pTask == 0 && !_bRetired)
+          _condition.wait(&_pPool->_mutex);
+        if (_pTask == 0)
+          break;
+
+        Task* pTask = _pTask;
+        QList<int> lstCpus(_lstCpus);
+        lock.unlock();
+        // Affinity can only be changed by the thread itself. The
+        // previous setting is retained until another task needs a
+        // different one.
+        if (lstCpus != _lstCurrentCpus)
+          {
+            Pii::setThreadAffinity(lstCpus);
+            _lstCurrentCpus = lstCpus;
+          }
+        pTask->run();
+        if (pTask->autoDelete())
+          {
+            delete pTask;
+            pTask = 0;
+          }
+        lock.relock();
+        _pTask = 0;
+        _pPool->threadDone(this, pTask);
+        if (_bRetired)
+          break;
+      }
+  }
+
+private:
+  PiiThreadPool* _pPool;
+  QWaitCondition _condition;
+  Qt::HANDLE _threadId;
+  Task* _pTask;
+  bool _bRetired;
+  bool _bPriorityChanged;
+  QList<int> _lstCpus;
+  // Only accessed by the thread itself.
+  QList<int> _lstCurrentCpus;
+};
+
+PiiThreadPool::Task::~Task()
+{}
+
+PiiThreadPool::PiiThreadPool() :
+  _iMaxThreadCount(qMax(1, QThread::idealThreadCount())),
+  _iThreadCount(0),
+  _iActiveThreadCount(0)
+{}
+
+PiiThreadPool::~PiiThreadPool()
+{
+  synchronized (_mutex)
+    {
+      for (ThreadList::iterator i=_lstIdleThreads.begin(); i!=_lstIdleThreads.end(); ++i)
+        {
+          (*i)->retire();
+          _lstRetiredThreads << *i;
+        }
+      _lstIdleThreads.clear();
+    }
+  reapRetiredThreads();
+}
+
+PiiThreadPool* PiiThreadPool::instance()
+{
+  static PiiThreadPool pool;
+  return &pool;
+}
+
+// _mutex must NOT be held when calling this function. Retired
+// threads may need to reacquire it before they can exit.
+void PiiThreadPool::reapRetiredThreads()
+{
+  ThreadList lstRetired;
+  synchronized (_mutex)
+    {
+      if (_lstRetiredThreads.isEmpty())
+        return;
+      lstRetired = _lstRetiredThreads;
+      _lstRetiredThreads.clear();
+    }
+  for (ThreadList::iterator i=lstRetired.begin(); i!=lstRetired.end(); ++i)
+    {
+      (*i)->wait();
+      delete *i;
+    }
+}
+
+PiiThreadPool::Thread* PiiThreadPool::reserveThread(QThread::Priority priority,
+                                                    const QList<int>& cpus)
+{
+  reapRetiredThreads();
+
+  QMutexLocker lock(&_mutex);
+  Thread* pThread;
+  if (!_lstIdleThreads.isEmpty())
+    pThread = _lstIdleThreads.takeFirst();
+  else
+    {
+      pThread = new Thread(this);
+      ++_iThreadCount;
+      pThread->startAndWait();
+    }
+  ++_iActiveThreadCount;
+  pThread->setTaskPriority(priority);
+  pThread->setTaskAffinity(cpus);
+  return pThread;
+}
+
+// _mutex must be held when calling this function
+void PiiThreadPool::threadDone(Thread* thread, Task* task)
+{
+  if (task != 0)
+    {
+      task->_bRunning = false;
+      _taskDoneCondition.wakeAll();
+    }
+  --_iActiveThreadCount;
+  thread->restorePriority();
+  // Keep at most _iMaxThreadCount idle threads. The most recently
+  // used thread goes to the head of the list because its stack is
+  // most likely still in cache.
+  if (_lstIdleThreads.size() >= _iMaxThreadCount)
+    {
+      thread->retire();
+      _lstRetiredThreads << thread;
+      --_iThreadCount;
+    }
+  else
+    _lstIdleThreads.prepend(thread);
+}
+
+void PiiThreadPool::releaseThread(Thread* thread)
+{
+  synchronized (_mutex) threadDone(thread, 0);
+}
+
+void PiiThreadPool::start(Thread* thread, Task* task)
+{
+  QMutexLocker lock(&_mutex);
+  task->_bRunning = true;
+  thread->setTask(task);
+}
+
+void PiiThreadPool::start(Task* task, QThread::Priority priority, const QList<int>& cpus)
+{
+  start(reserveThread(priority, cpus), task);
+}
+
+Qt::HANDLE PiiThreadPool::threadId(Thread* thread) const
+{
+  return thread->id();
+}
+
+bool PiiThreadPool::waitForTask(Task* task, unsigned long time)
+{
+  QMutexLocker lock(&_mutex);
+  PiiTimer timer;
+  while (task->_bRunning)
+    {
+      if (time != ULONG_MAX)
+        {
+          qint64 iElapsed = timer.milliseconds();
+          if ((unsigned long)iElapsed >= time)
+            return false;
+          _taskDoneCondition.wait(&_mutex, time - iElapsed);
+        }
+      else
+        _taskDoneCondition.wait(&_mutex);
+    }
+  return true;
+}
+
+void PiiThreadPool::setMaxThreadCount(int maxThreadCount)
+{
+  synchronized (_mutex)
+    {
+      _iMaxThreadCount = qMax(1, maxThreadCount);
+      while (_lstIdleThreads.size() > _iMaxThreadCount)
+        {
+          Thread* pThread = _lstIdleThreads.takeLast();
+          pThread->retire();
+          _lstRetiredThreads << pThread;
+          --_iThreadCount;
+        }
+    }
+  reapRetiredThreads();
+}
+
+int PiiThreadPool::maxThreadCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _iMaxThreadCount;
+}
+
+int PiiThreadPool::activeThreadCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _iActiveThreadCount;
+}
+
+int PiiThreadPool::threadCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _iThreadCount;
+}
@@ -0,0 +1,191 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITHREADPOOL_H
+#define _PIITHREADPOOL_H
+
+#include "PiiYdin.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QLinkedList>
+#include <QList>
+
+/**
+ * A process-wide pool of processing threads. Multi-threaded
+ * operations don't own threads but borrow them from the pool, one
+ * processing round at a time. A thread that finishes a round is
+ * immediately available for any other operation. Consequently, the
+ * number of threads in an engine is determined by the number of
+ * processing rounds that actually run concurrently instead of the sum
+ * of the [threadCount](PiiDefaultOperation::threadCount) properties
+ * of all operations.
+ *
+ * The pool retains at most [maxThreadCount()] idle threads. If all
+ * threads are busy, [reserveThread()] creates a new one instead of
+ * blocking. Blocking would easily deadlock a pipeline in which an
+ * upstream operation waits for a downstream input queue to be
+ * emptied. Extra threads retire as soon as they become idle.
+ *
+ * The operation that borrows a thread knows its id before any work
+ * is started on it. This makes it possible to reserve emission turns
+ * in output sockets in the correct order.
+ *
+ * ~~~(c++)
+ * class MyTask : public PiiThreadPool::Task
+ * {
+ * public:
+ *   void run() { doSomethingHeavy(); }
+ * };
+ *
+ * MyTask task;
+ * PiiThreadPool* pPool = PiiThreadPool::instance();
+ * PiiThreadPool::Thread* pThread = pPool->reserveThread();
+ * qDebug("Running in %p", (void*)pPool->threadId(pThread));
+ * pPool->start(pThread, &task);
+ * pPool->waitForTask(&task);
+ * ~~~
+ */
+class PII_YDIN_EXPORT PiiThreadPool
+{
+public:
+  class Thread;
+
+  /**
+   * An interface for units of work executed in the pool. The pool
+   * doesn't take the ownership of tasks unless [autoDelete] is set.
+   * A task must not be deleted while it is running; use
+   * [waitForTask()] to ensure this.
+   */
+  class PII_YDIN_EXPORT Task
+  {
+  public:
+    Task() : _bRunning(false), _bAutoDelete(false) {}
+    virtual ~Task();
+
+    /**
+     * If *autoDelete* is `true`, the pool deletes the task right
+     * after run() returns. [waitForTask()] must not be used with
+     * such tasks. The default is `false`.
+     */
+    void setAutoDelete(bool autoDelete) { _bAutoDelete = autoDelete; }
+    bool autoDelete() const { return _bAutoDelete; }
+
+    /**
+     * Executes the task. This function will be called in the context
+     * of a pooled thread. Exceptions must not leak out of this
+     * function.
+     */
+    virtual void run() = 0;
+
+  private:
+    friend class PiiThreadPool;
+    bool _bRunning;
+    bool _bAutoDelete;
+  };
+
+  PiiThreadPool();
+  ~PiiThreadPool();
+
+  /**
+   * Returns a pointer to the application-wide thread pool.
+   */
+  static PiiThreadPool* instance();
+
+  /**
+   * Reserves a thread for running a task. If there are idle threads
+   * in the pool, one of them will be returned. Otherwise, a new
+   * thread will be started. The returned thread must be passed to
+   * either [start()] or [releaseThread()].
+   *
+   * @param priority the scheduling priority of the thread while it
+   * runs the next task. `InheritPriority` leaves the priority
+   * untouched.
+   *
+   * @param cpus the logical CPUs the thread is restricted to while
+   * it runs the next task (see Pii::setThreadAffinity()). An empty
+   * list allows any CPU.
+   */
+  Thread* reserveThread(QThread::Priority priority = QThread::InheritPriority,
+                        const QList<int>& cpus = QList<int>());
+
+  /**
+   * Returns a reserved *thread* to the pool without running a task
+   * in it.
+   */
+  void releaseThread(Thread* thread);
+
+  /**
+   * Runs *task* in a *thread* previously returned by
+   * [reserveThread()]. The thread returns to the pool once
+   * Task::run() returns.
+   */
+  void start(Thread* thread, Task* task);
+
+  /**
+   * Reserves a thread and starts *task* in it.
+   */
+  void start(Task* task, QThread::Priority priority = QThread::InheritPriority,
+             const QList<int>& cpus = QList<int>());
+
+  /**
+   * Returns the id of a reserved *thread*. The id is the same that
+   * QThread::currentThreadId() returns in the context of the thread.
+   */
+  Qt::HANDLE threadId(Thread* thread) const;
+
+  /**
+   * Blocks the calling thread until *task* is no longer running or
+   * *time* milliseconds have elapsed. Once this function returns
+   * `true`, the pool won't touch the task any more.
+   */
+  bool waitForTask(Task* task, unsigned long time = ULONG_MAX);
+
+  /**
+   * Sets the maximum number of idle threads retained in the pool.
+   * The default value is QThread::idealThreadCount().
+   */
+  void setMaxThreadCount(int maxThreadCount);
+  int maxThreadCount() const;
+
+  /**
+   * Returns the number of threads currently reserved or running a
+   * task.
+   */
+  int activeThreadCount() const;
+
+  /**
+   * Returns the total number of threads in the pool.
+   */
+  int threadCount() const;
+
+private:
+  friend class Thread;
+
+  void threadDone(Thread* thread, Task* task);
+  void reapRetiredThreads();
+
+  typedef QLinkedList<Thread*> ThreadList;
+
+  mutable QMutex _mutex;
+  QWaitCondition _taskDoneCondition;
+  ThreadList _lstIdleThreads, _lstRetiredThreads;
+  int _iMaxThreadCount;
+  int _iThreadCount;
+  int _iActiveThreadCount;
+};
+
+#endif //_PIITHREADPOOL_H
@@ -15,15 +15,19 @@
 
 #include "PiiDefaultOperation.h"
 #include "PiiThreadedProcessor.h"
+#include <PiiSynchronized.h>
 
 PiiThreadedProcessor::PiiThreadedProcessor(PiiDefaultOperation* parent) :
   PiiOperationProcessor(parent),
   _inputCondition(PiiWaitCondition::NoQueue), _priority(InheritPriority),
-  _pStateMutex(parent->stateLock())
+  _pStateMutex(parent->stateLock()),
+  _iLastRoundEnd(0)
 {
+#ifndef PII_NO_QT
   // Set state to stopped once the thread finishes execution
   // DirectConnection ensures that the we don't need to run an event loop.
   connect(this, SIGNAL(finished()), SLOT(setStopped()), Qt::DirectConnection);
+#endif
 }
 
 void PiiThreadedProcessor::setProcessingPriority(QThread::Priority priority)
@@ -40,6 +44,10 @@ QThread::Priority PiiThreadedProcessor::processingPriority() const
 
 void PiiThreadedProcessor::setStopped()
 {
+  // This slot is called in the processing thread just before it
+  // exits.
+  mergeStatistics(_statistics);
+
   // The runner has finished. Our state is (or at least should be)
   // Stopping now
   synchronized (_pStateMutex)
@@ -55,6 +63,7 @@ void PiiThreadedProcessor::check(bool reset)
 
   _bMustReconfigure = false;
   _strPropertySetName = QString();
+  _iLastRoundEnd = 0;
 }
 
 void PiiThreadedProcessor::start()
@@ -124,11 +133,14 @@ bool PiiThreadedProcessor::wait(unsigned long time)
 bool PiiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender,
                                         const PiiVariant& object) throw ()
 {
-  QMutexLocker inputLock(_pStateMutex);
+  // Input queues are single-producer/single-consumer ring buffers.
+  // The emitting thread is the only producer, and the processing
+  // thread the only consumer. No locking is needed.
   PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
   if (pInput->canReceive())
     {
       pInput->receive(object);
+      recordProducerNode();
       // Send a signal to start the next round of processing and
       // return immediately.
       _inputCondition.wakeOne();
@@ -140,11 +152,10 @@ bool PiiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender,
 
 void PiiThreadedProcessor::prepareAndProcess()
 {
-  // This lock ensures that no input socket is able to take in objects
-  // for a while. They are thus unable to signal objectAccepted(),
-  // which means that _inputCondition.wakeOne() won't be called. Since
-  // we are going to process any object received so far, it is safe to
-  // reset the input condition.
+  // Input sockets receive objects without locking, but they always
+  // queue the object before signaling _inputCondition. Since the
+  // flow controller will see every object queued before the
+  // condition is reset, no wake-up signal can be lost.
   QMutexLocker lock(_pStateMutex);
   while (true)
     {
@@ -154,6 +165,8 @@ void PiiThreadedProcessor::prepareAndProcess()
       //qDebug("%s: flow controller returned %d", qPrintable(objectName()), int(state));
       if (state == PiiFlowController::IncompleteState)
         return;
+      else if (state == PiiFlowController::ProcessableState)
+        prepareBatch();
 
       lock.unlock();
 
@@ -162,7 +175,10 @@ void PiiThreadedProcessor::prepareAndProcess()
       switch (state)
         {
         case PiiFlowController::ProcessableState:
-          _pParentOp->processLocked();
+          {
+            PiiScheduler::Round round(schedulingClass());
+            measuredProcess(_statistics, _iLastRoundEnd);
+          }
         case PiiFlowController::SynchronizedState:
         case PiiFlowController::IncompleteState:
           break;
@@ -183,6 +199,16 @@ void PiiThreadedProcessor::prepareAndProcess()
 
 void PiiThreadedProcessor::run()
 {
+#ifdef PII_NO_QT
+  // There is no finished() signal. Set state to stopped however run()
+  // returns.
+  struct StopGuard
+  {
+    StopGuard(PiiThreadedProcessor* processor) : pProcessor(processor) {}
+    ~StopGuard() { pProcessor->setStopped(); }
+    PiiThreadedProcessor* pProcessor;
+  } stopGuard(this);
+#endif
   synchronized (_pStateMutex)
     {
       // State may have changed before we could even start. In such a
@@ -191,15 +217,27 @@ void PiiThreadedProcessor::run()
         _pParentOp->setState(PiiOperation::Running);
     }
 
+  QList<int> lstCurrentCpus;
   // Run the loop until we get an interrupt signal.
   while (_pParentOp->state() != PiiOperation::Interrupted)
     {
+      // The producer's node may change at any time. Other hints are
+      // applied only once.
+      QList<int> lstCpus(affinityCpus());
+      if (lstCpus != lstCurrentCpus)
+        {
+          Pii::setThreadAffinity(lstCpus);
+          lstCurrentCpus = lstCpus;
+        }
       try
         {
           // If a flow controller exists, we wait until an object is
           // received.
           if (_pFlowController != 0)
             {
+              // About to block anyway. A good time to publish
+              // measurements.
+              mergeStatistics(_statistics);
               _inputCondition.wait();
               // If the waiting was terminated by interrupt(), kill
               // the thread.
@@ -212,7 +250,11 @@ void PiiThreadedProcessor::run()
           // for input.
           else
             {
-              _pParentOp->processLocked();
+              {
+                PiiScheduler::Round round(schedulingClass());
+                measuredProcess(_statistics, _iLastRoundEnd);
+              }
+              mergeStatistics(_statistics, _iLastRoundEnd);
 
               synchronized (_pStateMutex)
                 if (_bMustReconfigure)
@@ -283,3 +325,9 @@ int PiiThreadedProcessor::activeInputGroup() const
 {
   return _pFlowController->activeInputGroup();
 }
+
+void PiiThreadedProcessor::flushStatistics()
+{
+  if (!isRunning())
+    mergeStatistics(_statistics);
+}
@@ -88,6 +88,8 @@ public:
 
   int activeInputGroup() const;
 
+  void flushStatistics();
+
 protected:
   void run();
 
@@ -102,6 +104,9 @@ private:
   QMutex *_pStateMutex;
   bool _bMustReconfigure;
   QString _strPropertySetName;
+  // Only accessed by the processing thread while it is running.
+  PiiOperationStatistics::Collector _statistics;
+  qint64 _iLastRoundEnd;
 };
 
 #endif // _PIITHREADEDPROCESSOR_H
@@ -0,0 +1,203 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIITYPEDISPATCHER_H
+#define _PIITYPEDISPATCHER_H
+
+#include "PiiInputSocket.h"
+#include "PiiExecutionException.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QAtomicPointer>
+
+/**
+ * A cached, type-based dispatch table for operations that handle
+ * many object types. Instead of going through a `switch` over
+ * PiiVariant::type() in each [process()](PiiDefaultOperation::process())
+ * call, an operation provides a *resolver* function that maps a type
+ * ID to a member function. The resolver is called only once for each
+ * type; the result is stored in the dispatcher, and the most recently
+ * used entry is checked first with a single pointer comparison. In a
+ * steady-state pipeline the type of objects in an input seldom
+ * changes, and dispatching costs no more than an indirect function
+ * call.
+ *
+ * The resolver can be written with the same [PII_ALL_MATRIX_CASES]
+ * family of macros used in switch-based dispatching. New types
+ * added to the macros are automatically picked up by all dispatchers
+ * that use them.
+ *
+ * Each input that needs type-based dispatching should have its own
+ * dispatcher, usually stored in the operation's data structure. The
+ * dispatcher is safe to use from multiple processing threads.
+ *
+ * ~~~(c++)
+ * typedef PiiTypeDispatcher<MyOperation> Dispatcher;
+ *
+ * Dispatcher::Handler MyOperation::resolveHandler(unsigned int type)
+ * {
+ *   switch (type)
+ *     {
+ *       PII_GRAY_IMAGE_CASES_M(return &MyOperation::grayImage, );
+ *       PII_COLOR_IMAGE_CASES_M(return &MyOperation::colorImage, );
+ *     }
+ *   return 0;
+ * }
+ *
+ * MyOperation::Data::Data() :
+ *   imageDispatcher(MyOperation::resolveHandler)
+ * {}
+ *
+ * void MyOperation::process()
+ * {
+ *   PII_D;
+ *   // Throws PiiExecutionException if the type is not recognized.
+ *   d->imageDispatcher.dispatch(this, inputAt(0));
+ * }
+ *
+ * template <class T> void MyOperation::grayImage(const PiiVariant& obj)
+ * {
+ *   const PiiMatrix<T> image(obj.valueAs<PiiMatrix<T> >());
+ *   // ...
+ * }
+ * ~~~
+ */
+template <class Class> class PiiTypeDispatcher
+{
+public:
+  /**
+   * The type of a handler function.
+   */
+  typedef void (Class::*Handler)(const PiiVariant&);
+  /**
+   * The type of a resolver function. The resolver returns the
+   * handler for the given type ID, or zero if the type is not
+   * supported.
+   */
+  typedef Handler (*Resolver)(unsigned int type);
+
+  /**
+   * Creates a new dispatcher that uses *resolver* to find handlers
+   * for types that have not been encountered before. If *resolver*
+   * is zero, only handlers explicitly added with [setHandler()] will
+   * be used.
+   */
+  PiiTypeDispatcher(Resolver resolver = 0) :
+    _pResolver(resolver),
+    _pLastEntry(0)
+  {}
+
+  ~PiiTypeDispatcher()
+  {
+    qDeleteAll(_hashEntries);
+  }
+
+  /**
+   * Sets the handler for objects whose type ID is *type*, overriding
+   * the resolver. Handlers must not be changed while objects are
+   * being dispatched.
+   */
+  void setHandler(unsigned int type, Handler handler)
+  {
+    QMutexLocker lock(&_mutex);
+    Entry* pEntry = _hashEntries.value(type);
+    if (pEntry != 0)
+      pEntry->handler = handler;
+    else
+      _hashEntries.insert(type, new Entry(type, handler));
+  }
+
+  /**
+   * Returns the handler for *type*, or zero if there is no handler
+   * for the type.
+   */
+  Handler handler(unsigned int type) const
+  {
+    const Entry* pEntry = lastEntry();
+    if (pEntry == 0 || pEntry->type != type)
+      pEntry = resolve(type);
+    return pEntry->handler;
+  }
+
+  /**
+   * Calls the handler of type of *obj* on *object*. Returns `true`
+   * if a handler was found and `false` otherwise.
+   */
+  bool dispatch(Class* object, const PiiVariant& obj) const
+  {
+    Handler pHandler = handler(obj.type());
+    if (pHandler == 0)
+      return false;
+    (object->*pHandler)(obj);
+    return true;
+  }
+
+  /**
+   * Reads the first object in *input* and calls its handler on
+   * *object*.
+   *
+   * @exception PiiExecutionException& if there is no handler for
+   * the type of the object.
+   */
+  void dispatch(Class* object, PiiInputSocket* input) const
+  {
+    if (!dispatch(object, input->firstObject()))
+      PII_THROW_UNKNOWN_TYPE(input);
+  }
+
+private:
+  struct Entry
+  {
+    Entry(unsigned int t, Handler h) : type(t), handler(h) {}
+    unsigned int type;
+    Handler handler;
+  };
+
+  const Entry* lastEntry() const
+  {
+#if QT_VERSION >= 0x050000
+    return _pLastEntry.loadAcquire();
+#else
+    return _pLastEntry;
+#endif
+  }
+
+  // Finds or creates the entry for type and makes it the last one.
+  // Entries are never deleted, so a cached pointer stays valid as
+  // long as the dispatcher exists. Unsupported types are cached as
+  // well.
+  const Entry* resolve(unsigned int type) const
+  {
+    QMutexLocker lock(&_mutex);
+    Entry* pEntry = _hashEntries.value(type);
+    if (pEntry == 0)
+      {
+        pEntry = new Entry(type, _pResolver != 0 ? _pResolver(type) : 0);
+        _hashEntries.insert(type, pEntry);
+      }
+    _pLastEntry.fetchAndStoreOrdered(pEntry);
+    return pEntry;
+  }
+
+  Resolver _pResolver;
+  mutable QMutex _mutex;
+  mutable QHash<unsigned int, Entry*> _hashEntries;
+  mutable QAtomicPointer<Entry> _pLastEntry;
+
+  PII_DISABLE_COPY(PiiTypeDispatcher);
+};
+
+#endif //_PIITYPEDISPATCHER_H
@@ -0,0 +1,498 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiWireFormat.h"
+#include "PiiYdinTypes.h"
+
+#include <PiiMatrix.h>
+#include <PiiColor.h>
+#include <PiiSerializationException.h>
+#include <PiiSerializationUtil.h>
+#include <PiiGenericBinaryOutputArchive.h>
+#include <PiiGenericBinaryInputArchive.h>
+
+#include <QIODevice>
+#include <QBuffer>
+#include <QVector>
+#include <complex>
+#include <cstring>
+
+namespace PiiWireFormat
+{
+  namespace
+  {
+    /* A self-contained implementation of the LZ4 block format
+       (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+       The compressor is a greedy single-probe matcher, which is what
+       the reference implementation does at its fastest setting. The
+       output can be decompressed with any LZ4 block decoder.
+     */
+    enum
+    {
+      Lz4MinMatch = 4,
+      Lz4LastLiterals = 5,
+      Lz4MatchFindLimit = 12,
+      Lz4MaxOffset = 65535,
+      Lz4HashBits = 14
+    };
+
+    inline quint32 read32(const uchar* p)
+    {
+      quint32 iValue;
+      memcpy(&iValue, p, 4);
+      return iValue;
+    }
+
+    inline int lz4Hash(quint32 sequence)
+    {
+      return int((sequence * 2654435761U) >> (32 - Lz4HashBits));
+    }
+
+    // Writes a 4-bit length continuation. Returns the new output
+    // position or -1 if the output buffer is full.
+    inline int lz4WriteLength(int length, uchar* dst, int op, int capacity)
+    {
+      for (; length >= 255; length -= 255)
+        {
+          if (op >= capacity) return -1;
+          dst[op++] = 255;
+        }
+      if (op >= capacity) return -1;
+      dst[op++] = uchar(length);
+      return op;
+    }
+
+    // Emits one sequence. A zero matchLength makes this the final,
+    // literals-only sequence.
+    int lz4WriteSequence(const uchar* literals, int literalLength,
+                         int offset, int matchLength,
+                         uchar* dst, int op, int capacity)
+    {
+      if (op >= capacity) return -1;
+      const int iTokenPos = op++;
+      uchar token = 0;
+      if (literalLength >= 15)
+        {
+          token = 15 << 4;
+          if ((op = lz4WriteLength(literalLength - 15, dst, op, capacity)) < 0) return -1;
+        }
+      else
+        token = uchar(literalLength << 4);
+      if (op + literalLength > capacity) return -1;
+      if (literalLength > 0)
+        memcpy(dst + op, literals, literalLength);
+      op += literalLength;
+
+      if (matchLength > 0)
+        {
+          if (op + 2 > capacity) return -1;
+          dst[op++] = uchar(offset);
+          dst[op++] = uchar(offset >> 8);
+          matchLength -= Lz4MinMatch;
+          if (matchLength >= 15)
+            {
+              token |= 15;
+              if ((op = lz4WriteLength(matchLength - 15, dst, op, capacity)) < 0) return -1;
+            }
+          else
+            token |= uchar(matchLength);
+        }
+      dst[iTokenPos] = token;
+      return op;
+    }
+
+    /* Compresses *size* bytes from *src* to *dst*. Returns the size of
+       the compressed data or zero if it didn't fit into *capacity*
+       bytes.
+     */
+    int lz4Compress(const uchar* src, int size, uchar* dst, int capacity)
+    {
+      QVector<int> vecTable(1 << Lz4HashBits, -1);
+      int* pTable = vecTable.data();
+      const int iMatchStartLimit = size - Lz4MatchFindLimit;
+      const int iMatchEndLimit = size - Lz4LastLiterals;
+      int ip = 0, iAnchor = 0, op = 0;
+
+      while (ip < iMatchStartLimit)
+        {
+          const quint32 iSequence = read32(src + ip);
+          const int iHash = lz4Hash(iSequence);
+          const int iRef = pTable[iHash];
+          pTable[iHash] = ip;
+          if (iRef < 0 || ip - iRef > Lz4MaxOffset || read32(src + iRef) != iSequence)
+            {
+              // Skip faster over data that doesn't compress.
+              ip += 1 + ((ip - iAnchor) >> 6);
+              continue;
+            }
+          int iLength = Lz4MinMatch;
+          while (ip + iLength < iMatchEndLimit && src[iRef + iLength] == src[ip + iLength])
+            ++iLength;
+          op = lz4WriteSequence(src + iAnchor, ip - iAnchor, ip - iRef, iLength, dst, op, capacity);
+          if (op < 0) return 0;
+          ip += iLength;
+          iAnchor = ip;
+          // Index one of the skipped positions to find overlapping
+          // repeats.
+          if (ip - 2 > 0 && ip - 2 < iMatchStartLimit)
+            pTable[lz4Hash(read32(src + ip - 2))] = ip - 2;
+        }
+      op = lz4WriteSequence(src + iAnchor, size - iAnchor, 0, 0, dst, op, capacity);
+      return op < 0 ? 0 : op;
+    }
+
+    /* Decompresses *size* bytes from *src* to *dst*, which must be
+       exactly *outputSize* bytes. All offsets and lengths are checked,
+       so corrupted input cannot write outside of the buffer. Returns
+       `false` on malformed input.
+     */
+    bool lz4Decompress(const uchar* src, int size, uchar* dst, int outputSize)
+    {
+      int ip = 0, op = 0;
+      while (ip < size)
+        {
+          const int iToken = src[ip++];
+          int iLiteralLength = iToken >> 4;
+          if (iLiteralLength == 15)
+            {
+              int iByte;
+              do
+                {
+                  if (ip >= size) return false;
+                  iByte = src[ip++];
+                  iLiteralLength += iByte;
+                }
+              while (iByte == 255);
+            }
+          if (iLiteralLength > size - ip || iLiteralLength > outputSize - op)
+            return false;
+          memcpy(dst + op, src + ip, iLiteralLength);
+          ip += iLiteralLength;
+          op += iLiteralLength;
+          // The last sequence has no match part.
+          if (ip == size)
+            break;
+
+          if (size - ip < 2) return false;
+          const int iOffset = src[ip] | (src[ip+1] << 8);
+          ip += 2;
+          if (iOffset == 0 || iOffset > op) return false;
+
+          int iMatchLength = iToken & 15;
+          if (iMatchLength == 15)
+            {
+              int iByte;
+              do
+                {
+                  if (ip >= size) return false;
+                  iByte = src[ip++];
+                  iMatchLength += iByte;
+                }
+              while (iByte == 255);
+            }
+          iMatchLength += Lz4MinMatch;
+          if (iMatchLength > outputSize - op) return false;
+
+          const uchar* pMatch = dst + op - iOffset;
+          if (iOffset >= iMatchLength)
+            memcpy(dst + op, pMatch, iMatchLength);
+          else
+            // Overlapping copy repeats the last iOffset bytes.
+            for (int i=0; i<iMatchLength; ++i)
+              dst[op+i] = pMatch[i];
+          op += iMatchLength;
+        }
+      return op == outputSize;
+    }
+
+    /* Header: "PIIV", version, flags, kind, reserved, 32-bit type id.
+       Matrix body: rows, columns, codec, raw size, [compressed size],
+       elements.
+     */
+    enum { HeaderSize = 12, FormatVersion = 1, BigEndianFlag = 1 };
+    enum Kind { PrimitiveKind, StringKind, MatrixKind, ArchiveKind };
+    enum Codec { RawCodec, Lz4Codec };
+    // Smaller matrices are not worth compressing.
+    enum { MinCompressedSize = 4096 };
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    const uchar ucNativeFlags = BigEndianFlag;
+#else
+    const uchar ucNativeFlags = 0;
+#endif
+
+    void writeData(QIODevice* device, const void* data, qint64 size)
+    {
+      if (size > 0 && device->write(static_cast<const char*>(data), size) != size)
+        PII_SERIALIZATION_ERROR(StreamError);
+    }
+
+    // QIODevice::read() may return less than requested. Network
+    // devices block until data arrives, so an empty read means the
+    // end of the stream.
+    void readData(QIODevice* device, void* data, qint64 size)
+    {
+      char* pData = static_cast<char*>(data);
+      while (size > 0)
+        {
+          qint64 iBytes = device->read(pData, size);
+          if (iBytes <= 0)
+            PII_SERIALIZATION_ERROR(StreamError);
+          pData += iBytes;
+          size -= iBytes;
+        }
+    }
+
+    template <class T> inline void writeValue(QIODevice* device, T value) { writeData(device, &value, sizeof(T)); }
+    template <class T> inline T readValue(QIODevice* device) { T value; readData(device, &value, sizeof(T)); return value; }
+
+    void writeHeader(QIODevice* device, Kind kind, unsigned int type)
+    {
+      char header[HeaderSize] = { 'P', 'I', 'I', 'V', FormatVersion, char(ucNativeFlags), char(kind), 0 };
+      const quint32 uiType = type;
+      memcpy(header + 8, &uiType, 4);
+      writeData(device, header, HeaderSize);
+    }
+
+    template <class T> void writePrimitive(QIODevice* device, const PiiVariant& object)
+    {
+      writeHeader(device, PrimitiveKind, object.type());
+      writeValue(device, object.valueAs<T>());
+    }
+
+    template <class T> void readPrimitive(QIODevice* device, PiiVariant& object)
+    {
+      object = PiiVariant(readValue<T>(device));
+    }
+
+    void writeString(QIODevice* device, const PiiVariant& object)
+    {
+      writeHeader(device, StringKind, object.type());
+      const QByteArray aUtf8(object.valueAs<QString>().toUtf8());
+      writeValue<quint32>(device, aUtf8.size());
+      writeData(device, aUtf8.constData(), aUtf8.size());
+    }
+
+    void readString(QIODevice* device, PiiVariant& object)
+    {
+      QByteArray aUtf8(readValue<quint32>(device), Qt::Uninitialized);
+      readData(device, aUtf8.data(), aUtf8.size());
+      object = PiiVariant(QString::fromUtf8(aUtf8.constData(), aUtf8.size()));
+    }
+
+    template <class T> void writeMatrix(QIODevice* device, const PiiVariant& object, Compression compression)
+    {
+      writeHeader(device, MatrixKind, object.type());
+      const PiiMatrix<T> matrix(object.valueAs<PiiMatrix<T> >());
+      const int iRows = matrix.rows();
+      const std::size_t iRowBytes = matrix.columns() * sizeof(T);
+      const quint64 iTotalBytes = quint64(iRowBytes) * iRows;
+      if (iTotalBytes > 0xffffffffu)
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      const bool bContiguous = matrix.stride() == iRowBytes;
+
+      writeValue<qint32>(device, iRows);
+      writeValue<qint32>(device, matrix.columns());
+
+      if (compression == FastCompression &&
+          iTotalBytes >= MinCompressedSize &&
+          iTotalBytes < 0x7fffffff)
+        {
+          QByteArray aPacked;
+          const uchar* pRaw;
+          if (bContiguous)
+            pRaw = reinterpret_cast<const uchar*>(matrix.row(0));
+          else
+            {
+              aPacked.resize(int(iTotalBytes));
+              for (int r=0; r<iRows; ++r)
+                memcpy(aPacked.data() + r*iRowBytes, matrix.row(r), iRowBytes);
+              pRaw = reinterpret_cast<const uchar*>(aPacked.constData());
+            }
+          // Only keep the result if it saves at least 1/16 of the
+          // space. A full output buffer also stops the compressor
+          // early on data that doesn't compress.
+          const int iCapacity = int(iTotalBytes - iTotalBytes/16);
+          QByteArray aCompressed(iCapacity, Qt::Uninitialized);
+          const int iCompressedBytes = lz4Compress(pRaw, int(iTotalBytes),
+                                                   reinterpret_cast<uchar*>(aCompressed.data()),
+                                                   iCapacity);
+          if (iCompressedBytes > 0)
+            {
+              writeValue<quint32>(device, Lz4Codec);
+              writeValue<quint32>(device, quint32(iTotalBytes));
+              writeValue<quint32>(device, iCompressedBytes);
+              writeData(device, aCompressed.constData(), iCompressedBytes);
+              return;
+            }
+        }
+
+      writeValue<quint32>(device, RawCodec);
+      writeValue<quint32>(device, quint32(iTotalBytes));
+      if (bContiguous)
+        writeData(device, matrix.row(0), iTotalBytes);
+      else
+        for (int r=0; r<iRows; ++r)
+          writeData(device, matrix.row(r), iRowBytes);
+    }
+
+    template <class T> void readMatrix(QIODevice* device, PiiVariant& object)
+    {
+      const qint32 iRows = readValue<qint32>(device);
+      const qint32 iColumns = readValue<qint32>(device);
+      const quint32 uiCodec = readValue<quint32>(device);
+      const quint32 uiTotalBytes = readValue<quint32>(device);
+      const std::size_t iRowBytes = std::size_t(iColumns) * sizeof(T);
+      if (iRows < 0 || iColumns < 0 ||
+          quint64(iRowBytes) * quint64(iRows) != uiTotalBytes)
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+      PiiMatrix<T> matrix(PiiMatrix<T>::uninitialized(iRows, iColumns));
+      const bool bContiguous = matrix.stride() == iRowBytes;
+
+      if (uiCodec == RawCodec)
+        {
+          if (bContiguous)
+            readData(device, matrix.row(0), uiTotalBytes);
+          else
+            for (int r=0; r<iRows; ++r)
+              readData(device, matrix.row(r), iRowBytes);
+        }
+      else if (uiCodec == Lz4Codec)
+        {
+          const quint32 uiCompressedBytes = readValue<quint32>(device);
+          // The writer never stores data that doesn't shrink.
+          if (uiCompressedBytes >= uiTotalBytes)
+            PII_SERIALIZATION_ERROR(InvalidDataFormat);
+          QByteArray aCompressed(int(uiCompressedBytes), Qt::Uninitialized);
+          readData(device, aCompressed.data(), uiCompressedBytes);
+          const uchar* pCompressed = reinterpret_cast<const uchar*>(aCompressed.constData());
+
+          if (bContiguous)
+            {
+              if (!lz4Decompress(pCompressed, int(uiCompressedBytes),
+                                 reinterpret_cast<uchar*>(matrix.row(0)), int(uiTotalBytes)))
+                PII_SERIALIZATION_ERROR(InvalidDataFormat);
+            }
+          else
+            {
+              QByteArray aPacked(int(uiTotalBytes), Qt::Uninitialized);
+              if (!lz4Decompress(pCompressed, int(uiCompressedBytes),
+                                 reinterpret_cast<uchar*>(aPacked.data()), int(uiTotalBytes)))
+                PII_SERIALIZATION_ERROR(InvalidDataFormat);
+              for (int r=0; r<iRows; ++r)
+                memcpy(matrix.row(r), aPacked.constData() + r*iRowBytes, iRowBytes);
+            }
+        }
+      else
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+
+      object = PiiVariant(matrix);
+    }
+
+    void writeArchive(QIODevice* device, const PiiVariant& object)
+    {
+      writeHeader(device, ArchiveKind, object.type());
+      const QByteArray aData(PiiSerialization::toByteArray<PiiGenericBinaryOutputArchive>(object));
+      writeValue<quint32>(device, aData.size());
+      writeData(device, aData.constData(), aData.size());
+    }
+
+    void readArchive(QIODevice* device, PiiVariant& object)
+    {
+      QByteArray aData(readValue<quint32>(device), Qt::Uninitialized);
+      readData(device, aData.data(), aData.size());
+      PiiSerialization::fromByteArray<PiiGenericBinaryInputArchive>(aData, object);
+    }
+  }
+
+  void write(QIODevice* device, const PiiVariant& object, Compression compression)
+  {
+    switch (object.type())
+      {
+        PII_PRIMITIVE_CASES_M(writePrimitive, (device, object));
+        PII_ALL_MATRIX_CASES_M(writeMatrix, (device, object, compression));
+        PII_COLOR_IMAGE_CASES_M(writeMatrix, (device, object, compression));
+      case PiiYdin::QStringType:
+        writeString(device, object);
+        break;
+      default:
+        writeArchive(device, object);
+      }
+  }
+
+  PiiVariant read(QIODevice* device)
+  {
+    char header[HeaderSize];
+    readData(device, header, HeaderSize);
+    if (memcmp(header, "PIIV", 4) != 0)
+      PII_SERIALIZATION_ERROR(UnrecognizedArchiveFormat);
+    if (header[4] != FormatVersion)
+      PII_SERIALIZATION_ERROR(ArchiveVersionMismatch);
+    if ((uchar(header[5]) & BigEndianFlag) != ucNativeFlags)
+      PII_SERIALIZATION_ERROR(InvalidDataFormat);
+    quint32 uiType;
+    memcpy(&uiType, header + 8, 4);
+
+    PiiVariant result;
+    switch (header[6])
+      {
+      case PrimitiveKind:
+        switch (uiType)
+          {
+            PII_PRIMITIVE_CASES_M(readPrimitive, (device, result));
+          default:
+            PII_SERIALIZATION_ERROR(InvalidDataFormat);
+          }
+        break;
+      case StringKind:
+        if (uiType != PiiYdin::QStringType)
+          PII_SERIALIZATION_ERROR(InvalidDataFormat);
+        readString(device, result);
+        break;
+      case MatrixKind:
+        switch (uiType)
+          {
+            PII_ALL_MATRIX_CASES_M(readMatrix, (device, result));
+            PII_COLOR_IMAGE_CASES_M(readMatrix, (device, result));
+          default:
+            PII_SERIALIZATION_ERROR(InvalidDataFormat);
+          }
+        break;
+      case ArchiveKind:
+        readArchive(device, result);
+        break;
+      default:
+        PII_SERIALIZATION_ERROR(InvalidDataFormat);
+      }
+    return result;
+  }
+
+  QByteArray encode(const PiiVariant& object, Compression compression)
+  {
+    QByteArray aResult;
+    QBuffer buffer(&aResult);
+    buffer.open(QIODevice::WriteOnly);
+    write(&buffer, object, compression);
+    return aResult;
+  }
+
+  PiiVariant decode(const QByteArray& data)
+  {
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    return read(&buffer);
+  }
+}
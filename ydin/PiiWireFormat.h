@@ -0,0 +1,93 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIWIREFORMAT_H
+#define _PIIWIREFORMAT_H
+
+#include "PiiYdin.h"
+#include <PiiVariant.h>
+#include <QByteArray>
+
+class QIODevice;
+
+/**
+ * A compact binary encoding for passing PiiVariants between
+ * processes. The serialization archives describe each object with
+ * class names, version numbers and element-by-element data, which is
+ * flexible but slow for large matrices. The wire format writes a
+ * fixed 12-byte header with the numeric [PiiYdin::TypeId] of the
+ * object followed by its raw data in native byte order.
+ *
+ * - Primitive types are written as such.
+ *
+ * - QStrings become a 32-bit length and UTF-8 data.
+ *
+ * - Matrices and color images become a 32-bit row count, a 32-bit
+ * column count and the elements row by row without padding. The
+ * element data can optionally be compressed with LZ4.
+ *
+ * - Any other type is written with PiiGenericBinaryOutputArchive.
+ *
+ * The header stores the byte order of the sender. Decoding data
+ * written on a machine with a different byte order fails with a
+ * PiiSerializationException instead of producing garbage.
+ *
+ * ~~~(c++)
+ * QByteArray aEncoded = PiiWireFormat::encode(PiiVariant(image),
+ *                                             PiiWireFormat::FastCompression);
+ * PiiVariant decoded = PiiWireFormat::decode(aEncoded);
+ * ~~~
+ */
+namespace PiiWireFormat
+{
+  /**
+   * Compression modes for matrix data.
+   *
+   * - `NoCompression` - elements are written as raw bytes.
+   *
+   * - `FastCompression` - elements are compressed with the LZ4 block
+   * format. Compression is skipped for small matrices and for data
+   * that does not become smaller. Typical throughput is several
+   * hundreds of megabytes per second, which is faster than most
+   * networks.
+   */
+  enum Compression { NoCompression, FastCompression };
+
+  /**
+   * Writes *object* to *device*. Throws a PiiSerializationException
+   * if the device cannot be written to.
+   */
+  PII_YDIN_EXPORT void write(QIODevice* device, const PiiVariant& object,
+                             Compression compression = NoCompression);
+
+  /**
+   * Reads an object written with [write()] from *device*. Throws a
+   * PiiSerializationException if the data is invalid or the device
+   * runs out of data.
+   */
+  PII_YDIN_EXPORT PiiVariant read(QIODevice* device);
+
+  /**
+   * Encodes *object* into a byte array.
+   */
+  PII_YDIN_EXPORT QByteArray encode(const PiiVariant& object,
+                                    Compression compression = NoCompression);
+
+  /**
+   * Decodes an object from a byte array created with [encode()].
+   */
+  PII_YDIN_EXPORT PiiVariant decode(const QByteArray& data);
+}
+
+#endif //_PIIWIREFORMAT_H
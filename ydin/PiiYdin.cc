@@ -14,10 +14,12 @@
  */
 
 #include "PiiYdin.h"
-#include "PiiEngine.h"
-#include "PiiPlugin.h"
-#include "PiiProbeInput.h"
-#include "PiiDefaultOperation.h"
+#ifndef PII_NO_QT
+#  include "PiiEngine.h"
+#  include "PiiPlugin.h"
+#  include "PiiProbeInput.h"
+#  include "PiiDefaultOperation.h"
+#endif
 
 namespace PiiYdin
 {
@@ -33,13 +35,24 @@ namespace PiiYdin
     return &database;
   }
 
+  static thread_local qint64 iCurrentOriginTime = 0;
+
+  qint64 currentOriginTime() { return iCurrentOriginTime; }
+  void setCurrentOriginTime(qint64 time) { iCurrentOriginTime = time; }
+
+#ifndef PII_NO_QT
   template <class T> inline const char* resourceName();
   template <> inline const char* resourceName<PiiSocket>()
   {
     return "PiiSocket";
   }
+#endif
 }
 
+// Without Qt, there are no meta objects and no plugins that could be
+// instantiated by name.
+#ifndef PII_NO_QT
+
 static const char* pluginName() { return "PiiYdin"; }
 
 PII_REGISTER_CLASS(PiiProbeInput, PiiSocket);
@@ -56,3 +69,4 @@ PII_BEGIN_STATEMENTS(PiiYdin)
   PII_YDIN_REGISTER_QOBJECT(PiiOperationCompound, PiiOperation)
   PII_YDIN_REGISTER_QOBJECT(PiiEngine, PiiOperationCompound)
 PII_END_STATEMENTS
+#endif
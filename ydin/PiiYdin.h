@@ -146,6 +146,34 @@ namespace PiiYdin
    * repeating the string literal to save memory.
    */
   extern PII_YDIN_EXPORT const char* metaObjectPredicate;
+
+  /**
+   * Returns the *origin time* of the objects the calling thread is
+   * currently processing. The origin time is the moment the event
+   * that eventually caused the objects was first seen, typically a
+   * camera trigger, as returned by PiiTimer::timestamp(). Zero means
+   * that the origin is unknown.
+   *
+   * Origin times travel alongside the objects through input queues.
+   * Before an operation is processed, the origin time of its thread
+   * is set to the oldest origin among its input objects. When the
+   * operation emits, the receiving inputs store the same origin. The
+   * current time minus the origin thus gives the end-to-end latency
+   * at any point of the pipeline.
+   *
+   * @see setCurrentOriginTime()
+   * @see PiiInputSocket::originTime()
+   */
+  PII_YDIN_EXPORT qint64 currentOriginTime();
+
+  /**
+   * Sets the origin time of the objects the calling thread is about to
+   * emit. Operations that create objects in response to external
+   * events (such as PiiCameraOperation) call this function before
+   * emitting. Operations driven by PiiDefaultOperation's processors
+   * don't need to; the processor sets the origin based on the inputs.
+   */
+  PII_YDIN_EXPORT void setCurrentOriginTime(qint64 time);
 }
 
 #endif //_PIIYDIN_H
@@ -14,6 +14,9 @@
  */
 
 #include "PiiYdinResources.h"
+#include <QHash>
+#include <QPair>
+#include <QMutex>
 #include <cstring>
 
 namespace PiiYdin
@@ -47,12 +50,8 @@ namespace PiiYdin
     return lstOffsets.size() == 0 ? 0 : lstOffsets[0];
   }
 
-  int pointerOffset(const char* superClass, const char* subClass)
+  static int findPointerOffset(const char* superClass, const char* subClass)
   {
-    // Superclass and subclass are the same.
-    if (!std::strcmp(superClass, subClass))
-      return 0;
-
     using namespace Pii;
     // First, we search all direct superclasses of the resource.
     QList<PiiResourceStatement> lstSuperClasses = resourceDatabase()->select(subject == subClass &&
@@ -64,11 +63,41 @@ namespace PiiYdin
     // Not a direct superclass. Recurse.
     for (int i=0; i<lstSuperClasses.size(); ++i)
       {
-        int iOffset = pointerOffset(superClass, qPrintable(lstSuperClasses[i].object()));
+        int iOffset = findPointerOffset(superClass, qPrintable(lstSuperClasses[i].object()));
         if (iOffset >= 0)
           return iOffset + pointerOffset(lstSuperClasses[i].id());
       }
     return -1;
   }
+
+  typedef QHash<QPair<QByteArray,QByteArray>,int> OffsetHash;
+
+  int pointerOffset(const char* superClass, const char* subClass)
+  {
+    // Superclass and subclass are the same.
+    if (!std::strcmp(superClass, subClass))
+      return 0;
+
+    // Every object created through the resource system needs a
+    // pointer offset. The class hierarchy does not change once it has
+    // been registered, so successful searches are cached.
+    static OffsetHash hashOffsets;
+    static QMutex offsetLock;
+    QPair<QByteArray,QByteArray> key(superClass, subClass);
+    {
+      QMutexLocker lock(&offsetLock);
+      OffsetHash::const_iterator i = hashOffsets.constFind(key);
+      if (i != hashOffsets.constEnd())
+        return i.value();
+    }
+
+    int iOffset = findPointerOffset(superClass, subClass);
+    if (iOffset >= 0)
+      {
+        QMutexLocker lock(&offsetLock);
+        hashOffsets.insert(key, iOffset);
+      }
+    return iOffset;
+  }
 }
 
@@ -14,16 +14,19 @@
  */
 
 #include "PiiYdinTypes.h"
-#include <PiiMatrixSerialization.h>
-#include <PiiSerializableExport.h>
-#include <PiiSerializationTraits.h>
-#include <PiiSerialization.h>
+#ifndef PII_NO_QT
+#  include <PiiMatrixSerialization.h>
+#  include <PiiSerializableExport.h>
+#  include <PiiSerializationTraits.h>
+#  include <PiiSerialization.h>
+#endif
 #include <PiiColor.h>
 #include <complex>
 #include <QDate>
 #include <QTime>
 #include <QStringList>
 
+#ifndef PII_NO_QT
 #include <PiiGenericInputArchive.h>
 #include <PiiGenericOutputArchive.h>
 
@@ -37,6 +40,10 @@
   PII_REGISTER_VARIANT_TYPE(TYPE); \
   PII_REGISTER_QVW(PiiQVariantWrapper::Template<TYPE >); \
   static int PII_JOIN(_qVariantId, __LINE__) = qRegisterMetaType<TYPE >()
+#else
+// No QVariant and no serialization.
+#define PII_REGISTER_VARIANT_BOTH(TYPE) PII_REGISTER_VARIANT_TYPE(TYPE)
+#endif
 
 // matrices
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<char>);
@@ -50,6 +57,8 @@ PII_REGISTER_VARIANT_BOTH(PiiMatrix<quint64>);
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<float>);
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<double>);
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<bool>);
+PII_REGISTER_VARIANT_BOTH(PiiMatrix<PiiHalf>);
+PII_REGISTER_VARIANT_BOTH(PiiMatrix<PiiFixedPoint<16> >);
 
 // color images
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<PiiColor<uchar> >);
@@ -62,6 +71,14 @@ PII_REGISTER_VARIANT_BOTH(PiiMatrix<std::complex<int> >);
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<std::complex<float> >);
 PII_REGISTER_VARIANT_BOTH(PiiMatrix<std::complex<double> >);
 
+// sparse matrices
+PII_REGISTER_VARIANT_BOTH(PiiSparseMatrix<int>);
+PII_REGISTER_VARIANT_BOTH(PiiSparseMatrix<float>);
+PII_REGISTER_VARIANT_BOTH(PiiSparseMatrix<double>);
+
+// bit matrices
+PII_REGISTER_VARIANT_BOTH(PiiBitMatrix);
+
 // colors
 PII_REGISTER_VARIANT_BOTH(PiiColor<uchar>);
 PII_REGISTER_VARIANT_BOTH(PiiColor4<uchar>);
@@ -79,7 +96,9 @@ PII_REGISTER_VARIANT_TYPE(QStringList);
 PII_REGISTER_VARIANT_TYPE(QDate);
 PII_REGISTER_VARIANT_TYPE(QTime);
 PII_REGISTER_VARIANT_TYPE(QDateTime);
+#ifndef PII_NO_QT
 PII_REGISTER_VARIANT_TYPE(QImage);
+#endif
 
 PII_REGISTER_VARIANT_TYPE(PiiSocketState);
 
@@ -100,6 +119,85 @@ namespace PiiYdin
     return QString();
   }
 
+  template <class T> struct TypedArrayTraits { static const char* name() { return 0; } };
+  template <> struct TypedArrayTraits<char> { static const char* name() { return "Int8Array"; } };
+  template <> struct TypedArrayTraits<unsigned char> { static const char* name() { return "Uint8Array"; } };
+  template <> struct TypedArrayTraits<bool> { static const char* name() { return "Uint8Array"; } };
+  template <> struct TypedArrayTraits<short> { static const char* name() { return "Int16Array"; } };
+  template <> struct TypedArrayTraits<unsigned short> { static const char* name() { return "Uint16Array"; } };
+  template <> struct TypedArrayTraits<int> { static const char* name() { return "Int32Array"; } };
+  template <> struct TypedArrayTraits<unsigned int> { static const char* name() { return "Uint32Array"; } };
+  template <> struct TypedArrayTraits<float> { static const char* name() { return "Float32Array"; } };
+  template <> struct TypedArrayTraits<double> { static const char* name() { return "Float64Array"; } };
+
+  template <class T> QString typedArrayNameAs(const PiiVariant&)
+  {
+    return QString(TypedArrayTraits<T>::name());
+  }
+
+#ifndef PII_NO_QT
+  template <class T> QByteArray matrixToByteArrayAs(const PiiVariant& variant)
+  {
+    const PiiMatrix<T> matrix(variant.valueAs<PiiMatrix<T> >());
+    const std::size_t iRowBytes = sizeof(T) * matrix.columns();
+    QByteArray aResult(int(iRowBytes * matrix.rows()), Qt::Uninitialized);
+    if (aResult.isEmpty())
+      return aResult;
+    char* pData = aResult.data();
+    if (matrix.stride() == iRowBytes)
+      memcpy(pData, matrix.row(0), iRowBytes * matrix.rows());
+    else
+      for (int r=0; r<matrix.rows(); ++r, pData += iRowBytes)
+        memcpy(pData, matrix.row(r), iRowBytes);
+    return aResult;
+  }
+
+  // JavaScript has only one number type.
+  template <class T> inline QVariant scriptNumber(T value) { return QVariant(double(value)); }
+  template <> inline QVariant scriptNumber(bool value) { return QVariant(value); }
+
+  template <class T> QVariantList matrixToVariantListAs(const PiiVariant& variant)
+  {
+    const PiiMatrix<T> matrix(variant.valueAs<PiiMatrix<T> >());
+    QVariantList lstResult;
+    lstResult.reserve(matrix.rows() * matrix.columns());
+    for (int r=0; r<matrix.rows(); ++r)
+      {
+        const T* pRow = matrix.row(r);
+        for (int c=0; c<matrix.columns(); ++c)
+          lstResult << scriptNumber(pRow[c]);
+      }
+    return lstResult;
+  }
+
+  QByteArray matrixToByteArray(const PiiVariant& variant)
+  {
+    switch (variant.type())
+      {
+        PII_PRIMITIVE_MATRIX_CASES(return matrixToByteArrayAs, variant);
+      }
+    return QByteArray();
+  }
+
+  QVariantList matrixToVariantList(const PiiVariant& variant)
+  {
+    switch (variant.type())
+      {
+        PII_PRIMITIVE_MATRIX_CASES(return matrixToVariantListAs, variant);
+      }
+    return QVariantList();
+  }
+#endif
+
+  QString typedArrayName(const PiiVariant& variant)
+  {
+    switch (variant.type())
+      {
+        PII_PRIMITIVE_MATRIX_CASES(return typedArrayNameAs, variant);
+      }
+    return QString();
+  }
+
   QString convertToQString(PiiInputSocket* input)
   {
     QString strValue(convertToQString(input->firstObject()));
@@ -17,17 +17,31 @@
 #define _PIIYDINTYPES_H
 
 #include "PiiColor.h"
-#include <PiiMatrixSerialization.h>
-#include <PiiSerializationUtil.h>
-#include <QVariant>
+#ifndef PII_NO_QT
+#  include <PiiMatrixSerialization.h>
+#else
+#  include <PiiMatrix.h>
+#  include <PiiSparseMatrix.h>
+#  include <PiiBitMatrix.h>
+#endif
+#include <PiiHalf.h>
+#include <PiiFixedPoint.h>
+#ifndef PII_NO_QT
+#  include <PiiSerializationUtil.h>
+#  include <QVariant>
+#endif
 #include <QDateTime>
 #include <QStringList>
-#include <PiiUtil.h>
+#ifndef PII_NO_QT
+#  include <PiiUtil.h>
+#endif
 #include "PiiInputSocket.h"
 #include "PiiYdin.h"
 #include "PiiSocketState.h"
 #include "PiiVariant.h"
-#include <PiiQVariantWrapper.h>
+#ifndef PII_NO_QT
+#  include <PiiQVariantWrapper.h>
+#endif
 #include <complex>
 
 /**
@@ -564,11 +578,13 @@ namespace PiiYdin
 #ifdef Q_MOC_RUN
   Q_GADGET
 
-  Q_ENUMS(MatrixTypeId ColorTypeId ComplexTypeId QtTypeId);
+  Q_ENUMS(MatrixTypeId ColorTypeId ComplexTypeId QtTypeId SparseMatrixTypeId BitMatrixTypeId);
 public:
 #endif
+#ifndef PII_NO_QT
   /// @internal
   extern PII_YDIN_EXPORT const QMetaObject staticMetaObject;
+#endif
 
   /**
    * A traits structure that converts primitive types to those
@@ -606,6 +622,14 @@ public:
    * to pause tags, but they don't change the state of the receiving
    * operation. The value of the tag is a QString that specifies the
    * property set to apply.
+   *
+   * - `DropTagType` - replaces an object, or a set of objects
+   * between synchronization tags, that was discarded by an upstream
+   * operation because it exceeded the latency budget (see
+   * PiiDefaultOperation::latencyBudget). Flow controllers discard the
+   * whole group of synchronized inputs that contains a drop tag and
+   * pass the tag to synchronized outputs, which keeps downstream
+   * operations in sync.
    */
   enum ControlTypeId
     {
@@ -613,7 +637,8 @@ public:
       StopTagType,
       PauseTagType,
       ResumeTagType,
-      ReconfigurationTagType
+      ReconfigurationTagType,
+      DropTagType
     };
 
   /**
@@ -628,6 +653,11 @@ public:
   /**
    * Type IDs for matrices. The ID numbers 0x40-0x7f are reserved for
    * different types of matrices.
+   *
+   * - `HalfMatrixType` - PiiMatrix<PiiHalf>, a compact storage
+   * format for images and features.
+   *
+   * - `FixedPointMatrixType` - PiiMatrix<PiiFixedPoint<16> >.
    */
   enum MatrixTypeId
     {
@@ -653,8 +683,11 @@ public:
 
       IntComplexMatrixType,
       FloatComplexMatrixType,
-      DoubleComplexMatrixType
+      DoubleComplexMatrixType,
       //LongDoubleComplexMatrixType
+
+      HalfMatrixType = 0x60,
+      FixedPointMatrixType
     };
 
   /**
@@ -663,7 +696,7 @@ public:
    */
   inline bool isMatrixType(int type)
   {
-    return (type & ~0x1f) == 0x40;
+    return (type & ~0x3f) == 0x40;
   }
 
   /**
@@ -705,6 +738,40 @@ public:
       QStringListType
     };
 
+  /**
+   * Type IDs for sparse matrices (PiiSparseMatrix). Sparse matrices
+   * occupy type ID numbers 0xe0-0xff (0xe0/~0x1f). Unlike the IDs in
+   * [MatrixTypeId], these are not matrix types according to
+   * [isMatrixType()], because the data is not stored in a PiiMatrix.
+   */
+  enum SparseMatrixTypeId
+    {
+      IntSparseMatrixType = 0xe0 + PiiVariant::IntType,
+      FloatSparseMatrixType = 0xe0 + PiiVariant::FloatType,
+      DoubleSparseMatrixType = 0xe0 + PiiVariant::DoubleType
+    };
+
+  /**
+   * Returns `true` if *type* is in the sparse matrix type id range,
+   * `false` otherwise.
+   */
+  inline bool isSparseMatrixType(int type)
+  {
+    return (type & ~0x1f) == 0xe0;
+  }
+
+  /**
+   * Type IDs for bit-packed binary images (PiiBitMatrix). Like sparse
+   * matrices, bit matrices are not matrix types according to
+   * [isMatrixType()]. Operations that accept binary images should
+   * check for [BitMatrixType] separately and convert with
+   * PiiBitMatrix::toMatrix() only if they cannot handle packed data.
+   */
+  enum BitMatrixTypeId
+    {
+      BitMatrixType = 0x100
+    };
+
   /**
    * A utility function that returns a copy of a primitive object held
    * by `obj` as a type compatible with QVariant. The function
@@ -848,6 +915,21 @@ public:
     return obj.valueAs<PiiTypelessMatrix>().stride();
   }
 
+  /**
+   * Returns the number of bytes the data of the matrix stored in
+   * `obj` occupies, or zero if `obj` is not a matrix. Memory budgets
+   * (PiiMemoryBudget) use this function to account for queued
+   * objects.
+   *
+   * @see isMatrixType()
+   */
+  inline qint64 objectBytes(const PiiVariant& obj)
+  {
+    if (!isMatrixType(obj.type()))
+      return 0;
+    return qint64(matrixRows(obj)) * qint64(matrixStride(obj));
+  }
+
   /**
    * Converts a PiiVariant containing a numeric type into a
    * QString.
@@ -881,6 +963,7 @@ public:
   inline PiiVariant createStopTag() { return PiiVariant(0, StopTagType); }
   inline PiiVariant createPauseTag() { return PiiVariant(0, PauseTagType); }
   inline PiiVariant createReconfigurationTag(const QString& name) { return PiiVariant(name, ReconfigurationTagType); }
+  inline PiiVariant createDropTag() { return PiiVariant(0, DropTagType); }
   //inline PiiVariant createResumeTag(PiiSocketState state) { return PiiVariant(state); }
 
   /**
@@ -897,6 +980,36 @@ public:
    */
   PII_YDIN_EXPORT QString convertToQString(const PiiVariant& variant);
 
+  /**
+   * Returns the raw elements of the primitive matrix in *variant* in
+   * row-major order, without padding. The data is copied with one
+   * memcpy() per row, or only one memcpy() if the rows are
+   * contiguous. Returns an empty array if *variant* does not hold a
+   * primitive matrix.
+   *
+   * The returned array can be used as the buffer of a typed array in
+   * JavaScript. Use [typedArrayName()] to find the correct view type.
+   */
+#ifndef PII_NO_QT
+  PII_YDIN_EXPORT QByteArray matrixToByteArray(const PiiVariant& variant);
+
+  /**
+   * Returns the elements of the primitive matrix in *variant* in
+   * row-major order as a list of numbers. Boolean matrices are
+   * converted to lists of booleans. Returns an empty list if
+   * *variant* does not hold a primitive matrix.
+   */
+  PII_YDIN_EXPORT QVariantList matrixToVariantList(const PiiVariant& variant);
+#endif
+
+  /**
+   * Returns the name of the JavaScript typed array whose elements
+   * match those of the matrix in *variant*, e.g. "Float64Array" for
+   * PiiMatrix<double>. Returns a `null` string if there is no
+   * matching typed array. 64-bit integers have no match.
+   */
+  PII_YDIN_EXPORT QString typedArrayName(const PiiVariant& variant);
+
   /**
    * Convert the object in `input` into the type specified by `T`.
    *
@@ -974,12 +1087,17 @@ public:
 #ifndef Q_MOC_RUN // moc fails
 
 // Declares both PiiVariant and QVariant
+#ifndef PII_NO_QT
 #define PII_DECLARE_SHARED_VARIANT_BOTH(TYPE, ID, BUILDING_LIB) \
   PII_DECLARE_SHARED_VARIANT_TYPE(TYPE, ID, BUILDING_LIB); \
   PII_SERIALIZATION_NAME_CUSTOM(PiiQVariantWrapper::Template<TYPE >, "PiiQVariantWrapper<" PII_STRINGIZE(TYPE) ">"); \
   PII_DECLARE_EXPORTED_CLASS_TEMPLATE(class, PiiQVariantWrapper::Template<TYPE >, BUILDING_LIB); \
   PII_DECLARE_FACTORY(PiiQVariantWrapper::Template<TYPE >, BUILDING_LIB); \
   Q_DECLARE_METATYPE(TYPE)
+#else
+#define PII_DECLARE_SHARED_VARIANT_BOTH(TYPE, ID, BUILDING_LIB) \
+  PII_DECLARE_SHARED_VARIANT_TYPE(TYPE, ID, BUILDING_LIB)
+#endif
 // complex numbers
 PII_DECLARE_SHARED_VARIANT_BOTH(std::complex<int>, PiiYdin::IntComplexType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_BOTH(std::complex<float>, PiiYdin::FloatComplexType, PII_BUILDING_YDIN);
@@ -1001,6 +1119,8 @@ PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<float>, PiiYdin::FloatMatrixType, PII_
 PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<double>, PiiYdin::DoubleMatrixType, PII_BUILDING_YDIN);
 //PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<long double>, PiiYdin::LongDoubleMatrixType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<bool>, PiiYdin::BoolMatrixType, PII_BUILDING_YDIN);
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<PiiHalf>, PiiYdin::HalfMatrixType, PII_BUILDING_YDIN);
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<PiiFixedPoint<16> >, PiiYdin::FixedPointMatrixType, PII_BUILDING_YDIN);
 
 // colors
 PII_DECLARE_SHARED_VARIANT_BOTH(PiiColor<unsigned char>, PiiYdin::UnsignedCharColorType, PII_BUILDING_YDIN);
@@ -1020,13 +1140,23 @@ PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<std::complex<float> >, PiiYdin::FloatC
 PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<std::complex<double> >, PiiYdin::DoubleComplexMatrixType, PII_BUILDING_YDIN);
 //PII_DECLARE_SHARED_VARIANT_BOTH(PiiMatrix<std::complex<long double> >, PiiYdin::LongDoubleComplexMatrixType, PII_BUILDING_YDIN);
 
+// sparse matrices
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiSparseMatrix<int>, PiiYdin::IntSparseMatrixType, PII_BUILDING_YDIN);
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiSparseMatrix<float>, PiiYdin::FloatSparseMatrixType, PII_BUILDING_YDIN);
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiSparseMatrix<double>, PiiYdin::DoubleSparseMatrixType, PII_BUILDING_YDIN);
+
+// bit matrices
+PII_DECLARE_SHARED_VARIANT_BOTH(PiiBitMatrix, PiiYdin::BitMatrixType, PII_BUILDING_YDIN);
+
 // Qt classes
 PII_DECLARE_SHARED_VARIANT_TYPE(QString, PiiYdin::QStringType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_TYPE(QStringList, PiiYdin::QStringListType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_TYPE(QDate, PiiYdin::QDateType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_TYPE(QTime, PiiYdin::QTimeType, PII_BUILDING_YDIN);
 PII_DECLARE_SHARED_VARIANT_TYPE(QDateTime, PiiYdin::QDateTimeType, PII_BUILDING_YDIN);
+#ifndef PII_NO_QT
 PII_DECLARE_SHARED_VARIANT_TYPE(QImage, PiiYdin::QImageType, PII_BUILDING_YDIN);
+#endif
 
 PII_DECLARE_SHARED_VARIANT_TYPE(PiiSocketState, PiiYdin::ResumeTagType, PII_BUILDING_YDIN);
 
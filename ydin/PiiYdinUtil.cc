@@ -46,6 +46,7 @@ namespace PiiYdin
       case PiiYdin::StopTagType: return 'S';
       case PiiYdin::PauseTagType: return 'P';
       case PiiYdin::ResumeTagType: return 'R';
+      case PiiYdin::DropTagType: return 'D';
       default: return '.';
       }
   }
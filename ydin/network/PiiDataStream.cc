@@ -0,0 +1,337 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiDataStream.h"
+#include "PiiYdinTypes.h"
+#include "PiiOutputSocket.h"
+#include "PiiProxySocket.h"
+
+#include <PiiAtomicInt.h>
+#include <PiiNetworkClient.h>
+#include <PiiNetworkException.h>
+#include <PiiHttpDevice.h>
+#include <PiiSocketDevice.h>
+#include <PiiSerializationException.h>
+
+#include <QCoreApplication>
+#include <QtEndian>
+
+namespace PiiDataStream
+{
+  const char* pProtocolName = "x-into-stream";
+
+  // Larger frames than this are considered garbage.
+  static const quint32 iMaxFrameSize = 0x40000000;
+
+  static void appendInt(QByteArray& data, int value)
+  {
+    uchar bytes[4];
+    qToLittleEndian(qint32(value), bytes);
+    data.append(reinterpret_cast<const char*>(bytes), 4);
+  }
+
+  static bool writeFrame(QIODevice* device, FrameType type, const char* data, int length)
+  {
+    uchar header[5];
+    header[0] = uchar(type);
+    qToLittleEndian(quint32(length), header + 1);
+    PiiSocketDevice socket(device);
+    return socket.writeWaited(reinterpret_cast<const char*>(header), 5) == 5 &&
+      socket.writeWaited(data, length) == length;
+  }
+
+  bool writeObject(QIODevice* device, const PiiVariant& object, PiiWireFormat::Compression compression)
+  {
+    if (PiiYdin::isControlType(object.type()))
+      {
+        QByteArray aData(4, Qt::Uninitialized);
+        qToLittleEndian(quint32(object.type()), reinterpret_cast<uchar*>(aData.data()));
+        switch (object.type())
+          {
+          case PiiYdin::ResumeTagType:
+            {
+              const PiiSocketState state(object.valueAs<PiiSocketState>());
+              appendInt(aData, state.flowLevel.load());
+              appendInt(aData, state.delay.load());
+            }
+            break;
+          case PiiYdin::ReconfigurationTagType:
+            aData.append(object.valueAs<QString>().toUtf8());
+            break;
+          default:
+            appendInt(aData, object.valueAs<int>());
+          }
+        return writeFrame(device, TagFrame, aData.constData(), aData.size());
+      }
+
+    QByteArray aData;
+    try
+      {
+        aData = PiiWireFormat::encode(object, compression);
+      }
+    catch (PiiSerializationException& ex)
+      {
+        piiWarning(QString("Cannot encode an object of type 0x%1: %2").arg(object.type(), 0, 16).arg(ex.message()));
+        // Stopping the stream would be worse than dropping one object.
+        return true;
+      }
+    return writeFrame(device, ObjectFrame, aData.constData(), aData.size());
+  }
+
+  bool writeCredit(QIODevice* device, int credits)
+  {
+    uchar value[4];
+    qToLittleEndian(quint32(credits), value);
+    return writeFrame(device, CreditFrame, reinterpret_cast<const char*>(value), 4);
+  }
+
+  static PiiVariant decodeTag(const QByteArray& payload, bool* ok)
+  {
+    const uchar* pData = reinterpret_cast<const uchar*>(payload.constData());
+    const int iType = qFromLittleEndian<qint32>(pData);
+    *ok = PiiYdin::isControlType(iType);
+    switch (iType)
+      {
+      case PiiYdin::ResumeTagType:
+        if (payload.size() != 12)
+          break;
+        // The type of PiiSocketState is ResumeTagType.
+        return PiiVariant(PiiSocketState(qFromLittleEndian<qint32>(pData + 4),
+                                         qFromLittleEndian<qint32>(pData + 8)));
+      case PiiYdin::ReconfigurationTagType:
+        return PiiYdin::createReconfigurationTag(QString::fromUtf8(payload.constData() + 4, payload.size() - 4));
+      default:
+        if (payload.size() != 8)
+          break;
+        return PiiVariant(qFromLittleEndian<qint32>(pData + 4), iType);
+      }
+    *ok = false;
+    return PiiVariant();
+  }
+
+  bool readFrame(QIODevice* device, Frame* frame)
+  {
+    PiiSocketDevice socket(device);
+    uchar header[5];
+    if (socket.readWaited(reinterpret_cast<char*>(header), 5) != 5)
+      return false;
+    const quint32 iLength = qFromLittleEndian<quint32>(header + 1);
+    if (iLength > iMaxFrameSize)
+      return false;
+
+    QByteArray aPayload(int(iLength), Qt::Uninitialized);
+    if (socket.readWaited(aPayload.data(), iLength) != qint64(iLength))
+      return false;
+
+    frame->type = FrameType(header[0]);
+    switch (frame->type)
+      {
+      case ObjectFrame:
+        try
+          {
+            frame->object = PiiWireFormat::decode(aPayload);
+          }
+        catch (PiiSerializationException& ex)
+          {
+            piiWarning(QString("Received an undecodable object: %1").arg(ex.message()));
+            return false;
+          }
+        return true;
+      case TagFrame:
+        {
+          if (iLength < 4)
+            return false;
+          bool bOk = false;
+          frame->object = decodeTag(aPayload, &bOk);
+          return bOk;
+        }
+      case CreditFrame:
+        if (iLength != 4)
+          return false;
+        frame->iCredits = qFromLittleEndian<qint32>(reinterpret_cast<const uchar*>(aPayload.constData()));
+        return true;
+      }
+    return false;
+  }
+
+  void emitObject(PiiOutputSocket* output, const PiiVariant& object)
+  {
+    switch (object.type())
+      {
+      case PiiYdin::SynchronizationTagType:
+        if (object.valueAs<int>() > 0)
+          output->startMany();
+        else
+          output->endMany();
+        break;
+      default:
+        output->emitObject(object);
+      }
+  }
+
+  int queueCapacity(PiiAbstractInputSocket* input)
+  {
+    PiiInputSocket* pInput = qobject_cast<PiiInputSocket*>(input);
+    if (pInput != 0)
+      return pInput->queueCapacity();
+
+    int iCapacity = 0;
+    QList<PiiAbstractInputSocket*> lstInputs(PiiProxySocket::connectedInputs(input));
+    for (int i=0; i<lstInputs.size(); ++i)
+      {
+        pInput = qobject_cast<PiiInputSocket*>(lstInputs[i]);
+        if (pInput != 0 && (iCapacity == 0 || pInput->queueCapacity() < iCapacity))
+          iCapacity = pInput->queueCapacity();
+      }
+    return qMax(iCapacity, 1);
+  }
+
+  Queue::Queue(const QString& name) :
+    PiiInputSocket(name),
+    _iCredits(0),
+    _bClosed(false)
+  {
+    setController(this);
+  }
+
+  bool Queue::tryToReceive(PiiAbstractInputSocket*, const PiiVariant& object) throw ()
+  {
+    synchronized (_mutex)
+      {
+        if (_bClosed)
+          return true;
+        if (_iCredits <= 0)
+          return false;
+        --_iCredits;
+        _queue.enqueue(object);
+        _objectCondition.wakeOne();
+      }
+    return true;
+  }
+
+  void Queue::addCredits(int credits)
+  {
+    synchronized (_mutex) _iCredits += credits;
+    // Wake up the output if it is waiting for us.
+    if (listener() != 0)
+      listener()->inputReady(this);
+  }
+
+  bool Queue::hasCredits()
+  {
+    QMutexLocker lock(&_mutex);
+    return _iCredits > 0;
+  }
+
+  bool Queue::takeObject(PiiVariant* object, int waitTime)
+  {
+    QMutexLocker lock(&_mutex);
+    if (_queue.isEmpty() && waitTime > 0)
+      _objectCondition.wait(&_mutex, waitTime);
+    if (_queue.isEmpty())
+      return false;
+    *object = _queue.dequeue();
+    return true;
+  }
+
+  void Queue::close()
+  {
+    synchronized (_mutex)
+      {
+        _bClosed = true;
+        _queue.clear();
+      }
+    if (listener() != 0)
+      listener()->inputReady(this);
+  }
+
+  void send(QIODevice* device, Queue* queue,
+            PiiWireFormat::Compression compression,
+            PiiProgressController* controller)
+  {
+    PiiSocketDevice socket(device);
+    Frame frame;
+    while (socket.isWritable() && controller->canContinue())
+      {
+        // If the output is blocked, wait for the receiver to grant
+        // more credits. Otherwise just collect what has arrived.
+        int iWaitTime = queue->hasCredits() ? 0 : 50;
+        while (socket->bytesAvailable() > 0 || socket->waitForReadyRead(iWaitTime))
+          {
+            if (!readFrame(device, &frame) || frame.type != CreditFrame)
+              return;
+            queue->addCredits(frame.iCredits);
+            iWaitTime = 0;
+          }
+
+        PiiVariant obj;
+        if (queue->takeObject(&obj, queue->hasCredits() ? 50 : 0) &&
+            !writeObject(device, obj, compression))
+          return;
+      }
+  }
+
+  void receive(QIODevice* device, PiiOutputSocket* output, int window,
+               PiiProgressController* controller,
+               PiiAtomicInt* stopTags)
+  {
+    PiiSocketDevice socket(device);
+    // In-flight objects never exceed what the receiver can queue.
+    if (!writeCredit(device, window))
+      return;
+
+    Frame frame;
+    while (socket.isReadable() && controller->canContinue())
+      {
+        if (socket->bytesAvailable() == 0 && !socket->waitForReadyRead(50))
+          continue;
+        if (!readFrame(device, &frame) || frame.type == CreditFrame)
+          return;
+        try
+          {
+            // Blocks until the output is accepted.
+            emitObject(output, frame.object);
+          }
+        catch (PiiExecutionException&)
+          {
+            // Interrupted
+            return;
+          }
+        if (stopTags != 0 && frame.object.type() == PiiYdin::StopTagType)
+          stopTags->ref();
+        frame.object = PiiVariant();
+        if (!writeCredit(device, 1))
+          return;
+      }
+  }
+
+  QIODevice* openStream(PiiNetworkClient* client, const QString& path)
+  {
+    QIODevice* pSocket = client->openConnection();
+    if (pSocket == 0)
+      PII_THROW(PiiNetworkException, QCoreApplication::translate("PiiDataStream", "Could not open connection to %1.")
+                .arg(client->serverAddress()));
+
+    PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
+    h.setRequest("GET", path);
+    h.setHeader("Connection", "Upgrade");
+    h.setHeader("Upgrade", pProtocolName);
+    h.finish();
+    if (!h.readHeader() || h.status() != PiiHttpProtocol::SwitchingProtocolsStatus)
+      PII_THROW(PiiNetworkException, QCoreApplication::translate("PiiDataStream", "The server refused to open a stream to %1 (status %2).")
+                .arg(path).arg(h.status()));
+    return pSocket;
+  }
+}
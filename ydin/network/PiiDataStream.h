@@ -0,0 +1,212 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIDATASTREAM_H
+#define _PIIDATASTREAM_H
+
+#include "PiiWireFormat.h"
+#include "PiiInputSocket.h"
+#include "PiiInputController.h"
+
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+
+class PiiNetworkClient;
+class PiiOutputSocket;
+class PiiProgressController;
+class PiiAtomicInt;
+
+/**
+ * The data plane of distributed engines. A data stream is a
+ * persistent connection that carries objects from an output socket
+ * in one process to an input socket in another. Streams are opened
+ * with an HTTP request that asks the server to switch to the
+ * `x-into-stream` protocol (see PiiOperationServer). After the 101
+ * response, both ends exchange binary frames:
+ *
+ * - an 8-bit frame type,
+ * - a 32-bit little-endian payload length and
+ * - the payload.
+ *
+ * Objects are encoded with PiiWireFormat. Control objects travel in
+ * their own frames. Synchronization tags are re-emitted through the
+ * flow-level bookkeeping of the receiving output, so that grouped
+ * flows survive the trip. Stop and pause tags arriving
+ * through a stream stop and pause the receiving operations just as
+ * they would locally.
+ *
+ * Flow control is based on credits. The receiver grants the sender a
+ * number of frames it may send without waiting, initially as many as
+ * its input queue holds, and one more each time it has passed an
+ * object on. The sender stops when it runs out of credits. Since the
+ * receiver only grants a credit once the receiving input has accepted
+ * the previous object, a full queue at the far end blocks the
+ * sending operation just as a local connection would.
+ */
+namespace PiiDataStream
+{
+  /**
+   * Frame types.
+   *
+   * - `ObjectFrame` - the payload is an object encoded with
+   * PiiWireFormat.
+   *
+   * - `TagFrame` - the payload is a control object: its 32-bit type
+   * ID followed by its value. Resume tags carry the flow level and
+   * the delay as two 32-bit numbers, reconfiguration tags the name
+   * of the property set in UTF-8, and all other tags a 32-bit
+   * number.
+   *
+   * - `CreditFrame` - the payload is a 32-bit number of additional
+   * frames the sender may transmit. Sent by the receiving end.
+   */
+  enum FrameType { ObjectFrame = 1, TagFrame = 2, CreditFrame = 3 };
+
+  /**
+   * A frame read with [readFrame()].
+   */
+  struct Frame
+  {
+    Frame() : type(ObjectFrame), iCredits(0) {}
+
+    FrameType type;
+    /// The received object or control tag.
+    PiiVariant object;
+    /// The number of credits in a `CreditFrame`.
+    int iCredits;
+  };
+
+  /**
+   * The protocol name used in the `Upgrade` header.
+   */
+  PII_YDIN_EXPORT extern const char* pProtocolName;
+
+  /**
+   * Writes *object* to *device* as an object or a tag frame. Returns
+   * `false` if the device could not be written to.
+   */
+  PII_YDIN_EXPORT bool writeObject(QIODevice* device, const PiiVariant& object,
+                                   PiiWireFormat::Compression compression = PiiWireFormat::NoCompression);
+
+  /**
+   * Grants the other end of the stream *credits* more frames.
+   * Returns `false` if the device could not be written to.
+   */
+  PII_YDIN_EXPORT bool writeCredit(QIODevice* device, int credits);
+
+  /**
+   * Reads a frame from *device* into *frame*. Returns `false` if the
+   * connection was closed or the frame is invalid. In both cases the
+   * stream cannot be continued.
+   */
+  PII_YDIN_EXPORT bool readFrame(QIODevice* device, Frame* frame);
+
+  /**
+   * Passes an object received from a stream to *output*. Ordinary
+   * objects and other tags are simply emitted. Synchronization tags
+   * are sent with [PiiOutputSocket::startMany()] and
+   * [PiiOutputSocket::endMany()], which keeps the flow level of
+   * *output* in sync with the sender.
+   *
+   * @exception PiiExecutionException& if the emission was interrupted
+   */
+  PII_YDIN_EXPORT void emitObject(PiiOutputSocket* output, const PiiVariant& object);
+
+  /**
+   * Returns the number of objects that can be sent to *input* before
+   * it blocks. If *input* is a proxy, the smallest queue capacity of
+   * the inputs it passes objects to is returned. The minimum value is
+   * one.
+   */
+  PII_YDIN_EXPORT int queueCapacity(PiiAbstractInputSocket* input);
+
+  /**
+   * An input socket that collects objects for a stream. Connect it to
+   * an output and let [send()] transmit what it receives. The queue
+   * accepts an object only if the receiver has granted a credit for
+   * it. Otherwise the output blocks until more credits arrive.
+   */
+  class PII_YDIN_EXPORT Queue :
+    public PiiInputSocket,
+    public PiiInputController
+  {
+  public:
+    Queue(const QString& name);
+
+    bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+
+    /**
+     * Allows the queue to accept *credits* more objects and wakes up
+     * the connected output.
+     */
+    void addCredits(int credits);
+    /**
+     * Returns `true` if the queue can accept at least one object.
+     */
+    bool hasCredits();
+    /**
+     * Takes the oldest object from the queue. Waits at most
+     * *waitTime* milliseconds for an object to appear. Returns
+     * `false` if there was nothing to take.
+     */
+    bool takeObject(PiiVariant* object, int waitTime);
+    /**
+     * Makes the queue accept and discard everything, which releases
+     * a blocked output. Call this before disconnecting the queue.
+     */
+    void close();
+
+  private:
+    QMutex _mutex;
+    QWaitCondition _objectCondition;
+    QQueue<PiiVariant> _queue;
+    int _iCredits;
+    bool _bClosed;
+  };
+
+  /**
+   * Sends the objects arriving in *queue* to *device* and passes the
+   * credits sent by the other end to *queue*. Returns when the
+   * connection breaks, the other end violates the protocol, or
+   * *controller* tells to stop.
+   */
+  PII_YDIN_EXPORT void send(QIODevice* device, Queue* queue,
+                            PiiWireFormat::Compression compression,
+                            PiiProgressController* controller);
+
+  /**
+   * Grants the other end *window* credits, passes received objects
+   * to *output* with [emitObject()] and grants one more credit each
+   * time *output* has accepted an object. Returns when the
+   * connection breaks, the other end violates the protocol, the
+   * emission is interrupted, or *controller* tells to stop. If
+   * *stopTags* is non-zero, it is incremented each time a stop tag
+   * has been passed to *output*.
+   */
+  PII_YDIN_EXPORT void receive(QIODevice* device, PiiOutputSocket* output, int window,
+                               PiiProgressController* controller,
+                               PiiAtomicInt* stopTags = 0);
+
+  /**
+   * Asks the server *client* is configured to contact to switch the
+   * connection to *path* into a data stream. Returns the connected
+   * socket, which is owned by *client*. Throws a PiiNetworkException
+   * if the connection fails or the server refuses the request.
+   */
+  PII_YDIN_EXPORT QIODevice* openStream(PiiNetworkClient* client, const QString& path);
+}
+
+#endif //_PIIDATASTREAM_H
@@ -0,0 +1,192 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiEngineNode.h"
+#include "PiiEngine.h"
+#include "PiiOperationServer.h"
+
+#include <PiiHttpDevice.h>
+#include <PiiHttpException.h>
+#include <PiiNetwork.h>
+#include <PiiSynchronized.h>
+#include <PiiSerializationUtil.h>
+#include <PiiSerializationException.h>
+#include <PiiGenericTextInputArchive.h>
+
+#include <QRegExp>
+
+PiiEngineNode::Partition::Partition(PiiOperation* operation) :
+  pOperation(operation),
+  pServer(new PiiOperationServer(operation)),
+  iUsers(1)
+{}
+
+PiiEngineNode::Partition::~Partition()
+{
+  delete pServer;
+  delete pOperation;
+}
+
+PiiEngineNode::Data::Data(PiiEngine* engine) :
+  pEngine(engine)
+{}
+
+PiiEngineNode::PiiEngineNode(PiiEngine* engine) :
+  d(new Data(engine))
+{}
+
+PiiEngineNode::~PiiEngineNode()
+{
+  QList<Partition*> lstPartitions;
+  synchronized (d->mutex)
+    {
+      lstPartitions = d->hashPartitions.values();
+      d->hashPartitions.clear();
+    }
+  for (int i=0; i<lstPartitions.size(); ++i)
+    destroyPartition(lstPartitions[i]);
+  delete d;
+}
+
+QStringList PiiEngineNode::partitionIds() const
+{
+  QMutexLocker lock(&d->mutex);
+  return d->hashPartitions.keys();
+}
+
+void PiiEngineNode::handleRequest(const QString& uri, PiiHttpDevice* dev,
+                                  PiiHttpProtocol::TimeLimiter* controller)
+{
+  QString strRequestPath = dev->requestPath(uri);
+  if (strRequestPath.isEmpty())
+    {
+      PII_REQUIRE_HTTP_METHOD("GET");
+      dev->print("partitions/");
+      return;
+    }
+  if (!strRequestPath.startsWith("partitions/"))
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+
+  strRequestPath = strRequestPath.mid(11);
+  if (strRequestPath.isEmpty())
+    {
+      PII_REQUIRE_HTTP_METHOD("GET");
+      dev->print(partitionIds().join("\n"));
+      return;
+    }
+
+  int iSlashIndex = strRequestPath.indexOf('/');
+  QString strId = strRequestPath.left(iSlashIndex);
+  if (!QRegExp("[\\w-]+").exactMatch(strId))
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+
+  if (iSlashIndex == -1)
+    {
+      if (dev->requestMethod() == "POST")
+        deployPartition(strId, dev);
+      else if (dev->requestMethod() == "DELETE")
+        removePartition(strId);
+      else
+        PII_THROW_HTTP_ERROR(MethodNotAllowedStatus);
+      return;
+    }
+
+  // Everything below the partition is served by its own operation
+  // server. The partition is kept alive until the request is done.
+  Partition* pPartition = acquirePartition(strId);
+  if (pPartition == 0)
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  try
+    {
+      pPartition->pServer->handleRequest(uri + "partitions/" + strId + "/", dev, controller);
+    }
+  catch (...)
+    {
+      releasePartition(pPartition);
+      throw;
+    }
+  releasePartition(pPartition);
+}
+
+void PiiEngineNode::deployPartition(const QString& id, PiiHttpDevice* dev)
+{
+  QStringList lstPlugins = dev->requestHeader().value("X-Into-Plugins").split(',', QString::SkipEmptyParts);
+  for (int i=0; i<lstPlugins.size(); ++i)
+    lstPlugins[i] = lstPlugins[i].trimmed();
+
+  PiiOperation* pOperation = 0;
+  try
+    {
+      PiiEngine::loadPlugins(lstPlugins);
+      PiiSerialization::fromByteArray<PiiGenericTextInputArchive>(dev->readBody(), pOperation);
+    }
+  catch (PiiLoadException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(InternalServerErrorStatus, ex.message());
+    }
+  catch (PiiSerializationException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(BadRequestStatus, ex.message() + " (" + ex.info() + ")");
+    }
+  if (pOperation == 0)
+    PII_THROW_HTTP_ERROR(BadRequestStatus);
+
+  // The compound was deployed because it had a node. Here, it must
+  // run locally.
+  pOperation->setProperty("node", QString());
+
+  Partition* pOldPartition = 0;
+  synchronized (d->mutex)
+    {
+      d->pEngine->addOperation(pOperation);
+      pOldPartition = d->hashPartitions.take(id);
+      d->hashPartitions.insert(id, new Partition(pOperation));
+    }
+  if (pOldPartition != 0)
+    destroyPartition(pOldPartition);
+}
+
+void PiiEngineNode::removePartition(const QString& id)
+{
+  Partition* pPartition = 0;
+  synchronized (d->mutex) pPartition = d->hashPartitions.take(id);
+  if (pPartition == 0)
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  destroyPartition(pPartition);
+}
+
+PiiEngineNode::Partition* PiiEngineNode::acquirePartition(const QString& id)
+{
+  QMutexLocker lock(&d->mutex);
+  Partition* pPartition = d->hashPartitions.value(id);
+  if (pPartition != 0)
+    ++pPartition->iUsers;
+  return pPartition;
+}
+
+void PiiEngineNode::releasePartition(Partition* partition)
+{
+  synchronized (d->mutex)
+    if (--partition->iUsers > 0)
+      return;
+  delete partition;
+}
+
+void PiiEngineNode::destroyPartition(Partition* partition)
+{
+  // A partition that still serves streams is deleted once the last
+  // one closes.
+  partition->pOperation->interrupt();
+  releasePartition(partition);
+}
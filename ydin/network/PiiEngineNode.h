@@ -0,0 +1,116 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIENGINENODE_H
+#define _PIIENGINENODE_H
+
+#include <PiiHttpProtocol.h>
+#include "PiiYdin.h"
+
+#include <QHash>
+#include <QMutex>
+
+class PiiEngine;
+class PiiOperation;
+class PiiOperationServer;
+
+/**
+ * A URI handler that lets other engines run partitions on this
+ * computer. If the [node](PiiOperationCompound::node) property of a
+ * compound names a URI served by a PiiEngineNode, the compound is
+ * serialized and uploaded to the node when the engine is checked,
+ * and its children are executed here instead of in the local engine.
+ *
+ * ~~~(c++)
+ * PiiEngine engine;
+ * PiiHttpServer* pServer = PiiHttpServer::addServer("node", "tcp://0.0.0.0:3142");
+ * pServer->protocol()->registerUriHandler("/node/", new PiiEngineNode(&engine));
+ * pServer->start();
+ * ~~~
+ *
+ * The node serves the following URIs relative to the path it is
+ * registered at:
+ *
+ * - `partitions/` - a GET request lists the identifiers of deployed
+ *   partitions.
+ *
+ * - `partitions/<id>` - a POST request deploys a partition. The body
+ *   of the request is the compound in text archive format, and the
+ *   `X-Into-Plugins` header lists the plug-ins that must be loaded
+ *   before the compound can be deserialized. An existing partition
+ *   with the same identifier is replaced. A DELETE request
+ *   interrupts the partition and destroys it.
+ *
+ * - `partitions/<id>/...` - passed to a PiiOperationServer that
+ *   controls the partition. The control functions, streams and
+ *   statistics of the partition are thus accessed exactly as with
+ *   any operation published through PiiOperationServer.
+ *
+ * Deployed partitions are added as children to the engine given in
+ * the constructor. The engine itself is never started; each
+ * partition is started and stopped by the engine that deployed it.
+ */
+class PII_YDIN_EXPORT PiiEngineNode : public PiiHttpProtocol::UriHandler
+{
+public:
+  /**
+   * Creates a node that places deployed partitions into *engine*.
+   * The engine must remain alive as long as the node.
+   */
+  PiiEngineNode(PiiEngine* engine);
+  /**
+   * Interrupts and destroys all partitions.
+   */
+  ~PiiEngineNode();
+
+  void handleRequest(const QString& uri, PiiHttpDevice* dev,
+                     PiiHttpProtocol::TimeLimiter* controller);
+
+  /**
+   * Returns the identifiers of all deployed partitions.
+   */
+  QStringList partitionIds() const;
+
+private:
+  struct Partition
+  {
+    Partition(PiiOperation* operation);
+    ~Partition();
+
+    PiiOperation* pOperation;
+    PiiOperationServer* pServer;
+    int iUsers;
+  };
+
+  class Data
+  {
+  public:
+    Data(PiiEngine* engine);
+
+    PiiEngine* pEngine;
+    mutable QMutex mutex; // Must be held when accessing hashPartitions
+    QHash<QString,Partition*> hashPartitions;
+  } *d;
+
+  void deployPartition(const QString& id, PiiHttpDevice* dev);
+  void removePartition(const QString& id);
+  Partition* acquirePartition(const QString& id);
+  void releasePartition(Partition* partition);
+  void destroyPartition(Partition* partition);
+
+  PII_DISABLE_COPY(PiiEngineNode);
+};
+
+#endif //_PIIENGINENODE_H
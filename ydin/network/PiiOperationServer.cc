@@ -14,10 +14,12 @@
  */
 
 #include "PiiOperationServer.h"
+#include "PiiDataStream.h"
 
 #include "PiiHttpDevice.h"
 #include "PiiHttpException.h"
 #include "PiiStreamBuffer.h"
+#include "PiiNetwork.h"
 
 #include <PiiSerializationUtil.h>
 #include <PiiGenericTextInputArchive.h>
@@ -29,11 +31,16 @@ PiiOperationServer::Data::Data(PiiOperation* operation) :
                          PiiQObjectServer::ExposeSlots |
                          PiiQObjectServer::ExposeProperties |
                          PiiQObjectServer::ExposeDynamicProperties)
-{}
+{
+  watchTimer.setInterval(200);
+}
 
 PiiOperationServer::Data::~Data()
 {
+  watchTimer.stop();
   qDeleteAll(hashConnectedInputs);
+  qDeleteAll(hashTaps);
+  qDeleteAll(hashWatches);
 }
 
 PiiOperationServer::PiiOperationServer(PiiOperation* operation) :
@@ -50,14 +57,20 @@ PiiOperationServer::PiiOperationServer(PiiOperation* operation) :
   addFunction("endPropertySet", operation, &PiiOperation::endPropertySet);
   addFunction("removePropertySet", operation, &PiiOperation::removePropertySet);
   addFunction("reconfigure", operation, &PiiOperation::reconfigure);
+  addFunction("resetStatistics", operation, &PiiOperation::resetStatistics);
 
   addFunction("connectInput", this, &PiiOperationServer::connectInput);
+
+  connect(&_d()->watchTimer, SIGNAL(timeout()), this, SLOT(checkWatches()));
 }
 
+void PiiOperationServer::setWatchInterval(int watchInterval) { _d()->watchTimer.setInterval(watchInterval); }
+int PiiOperationServer::watchInterval() const { return _d()->watchTimer.interval(); }
+
 QStringList PiiOperationServer::listRoot() const
 {
   QStringList lstFolders = PiiQObjectServer::listRoot();
-  lstFolders << "inputs/" << "outputs/";
+  lstFolders << "inputs/" << "outputs/" << "statistics/" << "streams/" << "taps/" << "watches/";
   return lstFolders;
 }
 
@@ -77,6 +90,26 @@ void PiiOperationServer::connectToChannel(Channel* channel, const QString& sourc
       // Create a new input socket for each connected output.
       findOutput(strOutputName)->connectInput(static_cast<ChannelImpl*>(channel)->createInput(strOutputName));
     }
+  else if (sourceId.startsWith("watches/"))
+    {
+      PII_D;
+      QMutexLocker lock(&d->watchMutex);
+      Watch* pWatch = d->hashWatches.value(sourceId.mid(8));
+      if (pWatch == 0)
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+      if (!pWatch->lstChannels.contains(channel))
+        pWatch->lstChannels << channel;
+      // The newcomer gets everything. The others continue from the
+      // values they already have.
+      QVariantList lstValues;
+      {
+        QMutexLocker accessLock(&d->accessMutex);
+        lstValues = pWatch->batch.values();
+      }
+      channel->enqueuePushData(sourceId, watchedValues(pWatch->batch, lstValues));
+      if (!d->watchTimer.isActive())
+        d->watchTimer.start();
+    }
   else
     PiiQObjectServer::connectToChannel(channel, sourceId);
 }
@@ -88,8 +121,130 @@ void PiiOperationServer::disconnectFromChannel(Channel* channel, const QString&
       QString strOutputName = sourceId.mid(8);
       static_cast<ChannelImpl*>(channel)->destroyInput(strOutputName);
     }
+  else if (sourceId.startsWith("watches/"))
+    {
+      PII_D;
+      QMutexLocker lock(&d->watchMutex);
+      Watch* pWatch = d->hashWatches.value(sourceId.mid(8));
+      if (pWatch != 0)
+        pWatch->lstChannels.removeAll(channel);
+    }
   else
-    PiiQObjectServer::connectToChannel(channel, sourceId);
+    PiiQObjectServer::disconnectFromChannel(channel, sourceId);
+}
+
+void PiiOperationServer::channelDeleted(Channel* channel)
+{
+  PII_D;
+  {
+    QMutexLocker lock(&d->watchMutex);
+    for (QHash<QString,Watch*>::iterator i = d->hashWatches.begin(); i != d->hashWatches.end(); ++i)
+      i.value()->lstChannels.removeAll(channel);
+  }
+  PiiQObjectServer::channelDeleted(channel);
+}
+
+QByteArray PiiOperationServer::watchedValues(const PiiPropertyBatch& batch, const QVariantList& values,
+                                             const QVector<int>& indices) const
+{
+  QStringList lstNames(batch.names());
+  QVariantMap mapValues;
+  if (indices.isEmpty())
+    {
+      for (int i=0; i<values.size(); ++i)
+        mapValues.insert(lstNames[i], values[i]);
+    }
+  else
+    {
+      for (int i=0; i<indices.size(); ++i)
+        mapValues.insert(lstNames[indices[i]], values[indices[i]]);
+    }
+  return PiiNetwork::toJson(mapValues).toUtf8();
+}
+
+void PiiOperationServer::checkWatches()
+{
+  PII_D;
+  QMutexLocker lock(&d->watchMutex);
+  bool bConnected = false;
+  for (QHash<QString,Watch*>::iterator i = d->hashWatches.begin(); i != d->hashWatches.end(); ++i)
+    {
+      Watch* pWatch = i.value();
+      if (pWatch->lstChannels.isEmpty())
+        continue;
+      bConnected = true;
+
+      QVector<int> vecChanged;
+      {
+        QMutexLocker accessLock(&d->accessMutex);
+        vecChanged = pWatch->batch.update(pWatch->lstValues);
+      }
+      if (vecChanged.isEmpty())
+        continue;
+
+      QString strSourceId("watches/" + i.key());
+      QByteArray aData(watchedValues(pWatch->batch, pWatch->lstValues, vecChanged));
+      bool bDelivered = true;
+      for (int j=0; j<pWatch->lstChannels.size(); ++j)
+        bDelivered &= pWatch->lstChannels[j]->enqueuePushData(strSourceId, aData);
+      // Someone missed the changes. Send everything next time.
+      if (!bDelivered)
+        pWatch->lstValues.clear();
+    }
+  if (!bConnected)
+    d->watchTimer.stop();
+}
+
+void PiiOperationServer::handleWatchRequest(const QString& watchName, PiiHttpDevice* dev)
+{
+  PII_D;
+  QString strMethod(dev->requestMethod());
+  bool bCreate = strMethod == "PUT" || strMethod == "POST";
+  // Read the body before locking. The client may be slow.
+  QStringList lstNames;
+  if (bCreate)
+    {
+      foreach (const QString& strName, QString::fromUtf8(dev->readBody()).split('\n'))
+        {
+          QString strTrimmed(strName.trimmed());
+          if (!strTrimmed.isEmpty())
+            lstNames << strTrimmed;
+        }
+    }
+
+  QMutexLocker lock(&d->watchMutex);
+  Watch* pWatch = d->hashWatches.value(watchName);
+  if (bCreate)
+    {
+      if (pWatch == 0)
+        {
+          pWatch = new Watch;
+          d->hashWatches.insert(watchName, pWatch);
+        }
+      pWatch->batch.setProperties(operation(), lstNames);
+      pWatch->lstValues.clear();
+    }
+  else if (strMethod == "DELETE")
+    {
+      if (pWatch == 0)
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+      delete d->hashWatches.take(watchName);
+      return;
+    }
+  else
+    {
+      PII_REQUIRE_HTTP_METHOD("GET");
+      if (pWatch == 0)
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+    }
+
+  QVariantList lstValues;
+  {
+    QMutexLocker accessLock(&d->accessMutex);
+    lstValues = pWatch->batch.values();
+  }
+  dev->setHeader("Content-Type", "application/json");
+  dev->write(watchedValues(pWatch->batch, lstValues));
 }
 
 void PiiOperationServer::sendToInput(const QString& inputName, PiiHttpDevice* dev,
@@ -125,6 +280,137 @@ void PiiOperationServer::connectInput(const QString& inputName)
     }
 }
 
+void PiiOperationServer::handleTapRequest(const QString& outputName, PiiHttpDevice* dev)
+{
+  PII_D;
+  if (dev->requestMethod() == "DELETE")
+    {
+      PiiObjectTap* pTap = 0;
+      {
+        QMutexLocker lock(&d->tapMutex);
+        pTap = d->hashTaps.take(outputName);
+      }
+      if (pTap == 0)
+        PII_THROW_HTTP_ERROR(NotFoundStatus);
+      delete pTap;
+      return;
+    }
+
+  PII_REQUIRE_HTTP_METHOD("GET");
+  QVariant varCapacity(dev->queryValue("capacity")),
+    varInterval(dev->queryValue("interval")),
+    varRequest(dev->queryValue("request"));
+  QList<PiiVariant> lstSamples;
+  int iDroppedCount = 0;
+  {
+    QMutexLocker lock(&d->tapMutex);
+    PiiObjectTap* pTap = d->hashTaps.value(outputName);
+    if (pTap == 0)
+      {
+        PiiAbstractOutputSocket* pOutput = findOutput(outputName); // may throw
+        pTap = new PiiObjectTap(outputName);
+        // Configure before connecting. Nothing is received meanwhile.
+        if (varCapacity.isValid())
+          pTap->setCapacity(varCapacity.toInt());
+        pTap->connectOutput(pOutput);
+        d->hashTaps.insert(outputName, pTap);
+      }
+    else if (varCapacity.isValid() && varCapacity.toInt() != pTap->capacity())
+      {
+        // The ring buffer can only be resized while nothing is
+        // being received.
+        PiiAbstractOutputSocket* pOutput = pTap->connectedOutput();
+        pTap->disconnectOutput();
+        pTap->setCapacity(varCapacity.toInt());
+        pTap->connectOutput(pOutput);
+      }
+    if (varInterval.isValid())
+      pTap->setSampleInterval(varInterval.toInt());
+    if (varRequest.isValid())
+      pTap->requestSamples(varRequest.toInt());
+    // Take the samples while the tap is guaranteed to exist, but
+    // serialize them only after releasing the lock.
+    lstSamples = pTap->takeSamples();
+    iDroppedCount = pTap->droppedCount();
+  }
+
+  dev->setHeader("X-Dropped-Count", QString::number(iDroppedCount));
+  try
+    {
+      for (int i=0; i<lstSamples.size(); ++i)
+        {
+          dev->write(PiiSerialization::toByteArray<PiiGenericTextOutputArchive>(lstSamples[i]));
+          dev->write("\n", 1);
+        }
+    }
+  catch (PiiSerializationException& ex)
+    {
+      PII_THROW_HTTP_ERROR_MSG(InternalServerErrorStatus, ex.message() + " (" + ex.info() + ")");
+    }
+}
+
+void PiiOperationServer::openStream(const QString& path, PiiHttpDevice* dev,
+                                    PiiHttpProtocol::TimeLimiter* controller)
+{
+  PII_REQUIRE_HTTP_METHOD("GET");
+  if (dev->requestHeader().value("Upgrade").toLower() != PiiDataStream::pProtocolName)
+    {
+      dev->setHeader("Upgrade", PiiDataStream::pProtocolName);
+      PII_THROW_HTTP_ERROR(UpgradeRequiredStatus);
+    }
+
+  if (path.startsWith("outputs/"))
+    streamFromOutput(path.mid(8), dev, controller);
+  else if (path.startsWith("inputs/"))
+    streamToInput(path.mid(7), dev, controller);
+  else
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+
+  dev->setHeader("Connection", "close");
+}
+
+namespace
+{
+  void acceptStream(PiiHttpDevice* dev, PiiHttpProtocol::TimeLimiter* controller)
+  {
+    controller->setMaxTime(-1);
+    dev->setStatus(PiiHttpProtocol::SwitchingProtocolsStatus);
+    dev->setHeader("Upgrade", PiiDataStream::pProtocolName);
+    dev->setHeader("Connection", "Upgrade");
+    dev->sendHeader();
+    dev->flushFilter();
+  }
+}
+
+void PiiOperationServer::streamFromOutput(const QString& outputName, PiiHttpDevice* dev,
+                                          PiiHttpProtocol::TimeLimiter* controller)
+{
+  PiiAbstractOutputSocket* pOutput = findOutput(outputName); // may throw
+  PiiWireFormat::Compression compression = dev->queryValue("compression").toString() == "fast" ?
+    PiiWireFormat::FastCompression : PiiWireFormat::NoCompression;
+  acceptStream(dev, controller);
+
+  PiiDataStream::Queue queue(outputName);
+  pOutput->connectInput(&queue);
+  PiiDataStream::send(dev->device(), &queue, compression, controller);
+  // Let a blocked output through before the queue disappears.
+  queue.close();
+  pOutput->disconnectInput(&queue);
+}
+
+void PiiOperationServer::streamToInput(const QString& inputName, PiiHttpDevice* dev,
+                                       PiiHttpProtocol::TimeLimiter* controller)
+{
+  PiiAbstractInputSocket* pInput = operation()->input(inputName);
+  if (pInput == 0)
+    PII_THROW_HTTP_ERROR(NotFoundStatus);
+  connectInput(inputName);
+  acceptStream(dev, controller);
+
+  PiiDataStream::receive(dev->device(), _d()->hashConnectedInputs[inputName],
+                         PiiDataStream::queueCapacity(pInput), controller);
+}
+
 void PiiOperationServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
                                        PiiHttpProtocol::TimeLimiter* controller)
 {
@@ -146,6 +432,39 @@ void PiiOperationServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
       dev->startOutputFiltering(new PiiStreamBuffer);
       dev->print(operation()->outputNames().join("\n"));
     }
+  else if (strRequestPath.startsWith("streams/"))
+    openStream(strRequestPath.mid(8), dev, controller); // may throw
+  else if (strRequestPath.startsWith("taps/"))
+    {
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      if (strRequestPath.size() == 5)
+        {
+          PII_REQUIRE_HTTP_METHOD("GET");
+          QMutexLocker lock(&_d()->tapMutex);
+          dev->print(QStringList(_d()->hashTaps.keys()).join("\n"));
+        }
+      else
+        handleTapRequest(strRequestPath.mid(5), dev); // may throw
+    }
+  else if (strRequestPath.startsWith("watches/"))
+    {
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      if (strRequestPath.size() == 8)
+        {
+          PII_REQUIRE_HTTP_METHOD("GET");
+          QMutexLocker lock(&_d()->watchMutex);
+          dev->print(QStringList(_d()->hashWatches.keys()).join("\n"));
+        }
+      else
+        handleWatchRequest(strRequestPath.mid(8), dev); // may throw
+    }
+  else if (strRequestPath == "statistics/")
+    {
+      PII_REQUIRE_HTTP_METHOD("GET");
+      dev->startOutputFiltering(new PiiStreamBuffer);
+      dev->setHeader("Content-Type", "application/json");
+      dev->print(PiiNetwork::toJson(operation()->statistics()));
+    }
   else
     PiiQObjectServer::handleRequest(uri, dev, controller);
 }
@@ -20,8 +20,12 @@
 #include <PiiYdin.h>
 #include <PiiOperation.h>
 #include <PiiOutputSocket.h>
+#include <PiiObjectTap.h>
+#include <PiiPropertyBatch.h>
+#include <PiiThreadSafeTimer.h>
 
 #include <QHash>
+#include <QMutex>
 
 PII_MAP_METATYPE(PiiOperation::State, int);
 
@@ -35,12 +39,104 @@ PII_MAP_METATYPE(PiiOperation::State, int);
  * the server. A request to these URIs returns a list of input and
  * output names, respectively.
  *
+ * A GET request to "/statistics/" returns the timing statistics of
+ * the operation ([PiiOperation::statistics()]) as a JSON object.
+ * The statistics can be cleared by calling the "resetStatistics"
+ * function.
+ *
+ * Object taps
+ * -----------
+ *
+ * A GET request to "/taps/<name>" attaches a PiiObjectTap to the
+ * named output and returns the objects the tap has recorded since
+ * the previous request, oldest first. Each object is serialized with
+ * PiiGenericTextOutputArchive and followed by a newline. The tap is
+ * created on the first request and stays connected until it is
+ * removed with a DELETE request. Objects are recorded without
+ * locking or formatting in the pipeline; serialization happens in
+ * the thread that serves the request. The following query
+ * parameters configure the tap:
+ *
+ * - `interval` - record every Nth object (see
+ * [PiiObjectTap::sampleInterval]).
+ *
+ * - `capacity` - the size of the ring buffer (see
+ * [PiiObjectTap::capacity]). Changing the capacity destroys the
+ * recorded samples.
+ *
+ * - `request` - record the next N objects independent of the
+ * interval (see [PiiObjectTap::requestSamples()]).
+ *
+ * The number of objects dropped because the ring buffer was full is
+ * returned in the `X-Dropped-Count` header. A GET request to
+ * "/taps/" lists the outputs that currently have a tap.
+ *
+ * Data plane
+ * ----------
+ *
+ * Pushing objects through channels and posting them to "/inputs/"
+ * is convenient for monitoring but slow, and there is no flow
+ * control. Pipelines split across machines should use persistent
+ * data streams (see PiiDataStream) instead. A GET request to
+ * "/streams/outputs/<name>" or "/streams/inputs/<name>" with
+ * `Connection: Upgrade` and `Upgrade: x-into-stream` headers turns
+ * the connection into a binary stream from the named output or to
+ * the named input.
+ *
+ * - An output stream sends objects only as long as the client has
+ * granted credits. When they run out, the output blocks just like a
+ * local output whose receiver is full. Add `compression=fast` to the
+ * query to compress matrices with LZ4.
+ *
+ * - An input stream initially grants the client as many credits as
+ * the queue of the input holds (see
+ * [PiiInputSocket::queueCapacity]) and one more each time an object
+ * has been passed to the input.
+ *
+ * The streams stay open until either end closes the connection. The
+ * control plane, i.e. starting, stopping and configuring the
+ * operation, is still handled with function calls.
+ *
+ * Property watches
+ * ----------------
+ *
+ * User interfaces typically show dozens of properties of many
+ * operations. Instead of requesting them one by one, a client can
+ * create a named *watch*, a list of property names resolved once in
+ * a PiiPropertyBatch. Nested names such as "reader.imageCount" refer
+ * to properties of child operations.
+ *
+ * - A PUT or POST request to "/watches/<name>" creates or replaces
+ * the watch. The body lists the property names, one per line.
+ *
+ * - A GET request to "/watches/<name>" returns the current values of
+ * all properties in the watch as a JSON object.
+ *
+ * - A DELETE request to "/watches/<name>" removes the watch.
+ *
+ * - A GET request to "/watches/" lists the existing watches.
+ *
+ * A watch whose source ID "watches/<name>" is connected to a channel
+ * is checked every [watchInterval()] milliseconds. The properties
+ * that changed since the previous check are pushed to the channel as
+ * a JSON object. A newly connected channel first receives all
+ * values. If the channel can't take the changes, all values will be
+ * sent again on the next check.
  */
 class PII_YDIN_EXPORT PiiOperationServer : public PiiQObjectServer
 {
+  Q_OBJECT
+
 public:
   PiiOperationServer(PiiOperation* operation);
 
+  /**
+   * Sets the interval between checks for changed properties in
+   * watches, in milliseconds. The default is 200.
+   */
+  void setWatchInterval(int watchInterval);
+  int watchInterval() const;
+
   void handleRequest(const QString& uri, PiiHttpDevice* dev,
                      PiiHttpProtocol::TimeLimiter* controller);
 protected:
@@ -48,11 +144,23 @@ protected:
 
   void connectToChannel(Channel* channel, const QString& sourceId);
   void disconnectFromChannel(Channel* channel, const QString& sourceId);
+  void channelDeleted(Channel* channel);
 
   /// @internal
   ChannelImpl* createChannel(const QString& clientId) const;
 
+private slots:
+  void checkWatches();
+
 private:
+  struct Watch
+  {
+    PiiPropertyBatch batch;
+    // Values pushed in the previous check
+    QVariantList lstValues;
+    QList<Channel*> lstChannels;
+  };
+
   class Data : public PiiQObjectServer::Data
   {
   public:
@@ -60,6 +168,11 @@ private:
     ~Data();
 
     QHash<QString,PiiOutputSocket*> hashConnectedInputs;
+    QHash<QString,PiiObjectTap*> hashTaps;
+    QMutex tapMutex;
+    QHash<QString,Watch*> hashWatches;
+    QMutex watchMutex;
+    PiiThreadSafeTimer watchTimer;
   };
   PII_D_FUNC;
 
@@ -85,6 +198,16 @@ private:
   void connectInput(const QString& inputName);
   void sendToInput(const QString& inputName, PiiHttpDevice* dev,
                    PiiHttpProtocol::TimeLimiter* controller);
+  void handleTapRequest(const QString& outputName, PiiHttpDevice* dev);
+  void handleWatchRequest(const QString& watchName, PiiHttpDevice* dev);
+  QByteArray watchedValues(const PiiPropertyBatch& batch, const QVariantList& values,
+                           const QVector<int>& indices = QVector<int>()) const;
+  void openStream(const QString& path, PiiHttpDevice* dev,
+                  PiiHttpProtocol::TimeLimiter* controller);
+  void streamFromOutput(const QString& outputName, PiiHttpDevice* dev,
+                        PiiHttpProtocol::TimeLimiter* controller);
+  void streamToInput(const QString& inputName, PiiHttpDevice* dev,
+                     PiiHttpProtocol::TimeLimiter* controller);
 };
 
 #endif //_PIIOPERATIONSERVER_H
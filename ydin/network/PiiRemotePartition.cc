@@ -0,0 +1,486 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#include "PiiRemotePartition.h"
+#include "PiiDataStream.h"
+#include "PiiOperationCompound.h"
+#include "PiiOutputSocket.h"
+#include "PiiEngine.h"
+#include "PiiYdinTypes.h"
+
+#include <PiiAtomicInt.h>
+#include <PiiDelay.h>
+#include <PiiNetwork.h>
+#include <PiiNetworkClient.h>
+#include <PiiNetworkException.h>
+#include <PiiHttpDevice.h>
+#include <PiiStreamBuffer.h>
+#include <PiiRemoteObject.h>
+#include <PiiSerializationUtil.h>
+#include <PiiSerializationException.h>
+#include <PiiGenericTextOutputArchive.h>
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QRegExp>
+#include <QUuid>
+
+namespace
+{
+  QString tr(const char* text)
+  {
+    return QCoreApplication::translate("PiiRemotePartition", text);
+  }
+
+  // Waits this long for the stop tags to arrive after the remote
+  // partition has stopped.
+  const int iStopTagTimeout = 2000;
+}
+
+/* A thread that moves objects over a data stream. The stream is
+   opened in the thread that uses it.
+ */
+class PiiRemotePartition::Pump : public QThread, public PiiProgressController
+{
+public:
+  Pump(const QString& serverAddress, const QString& path) :
+    _bRunning(true), _strServerAddress(serverAddress), _strPath(path)
+  {}
+
+  /// Tells the thread to stop and waits until it has.
+  virtual void close()
+  {
+    _bRunning = false;
+    wait();
+  }
+
+  /// Restores the connection the pump replaced.
+  virtual void restore() = 0;
+
+  bool canContinue(double) const { return _bRunning; }
+
+protected:
+  virtual void pump(QIODevice* device) = 0;
+
+  void run()
+  {
+    PiiNetworkClient client(_strServerAddress);
+    try
+      {
+        pump(PiiDataStream::openStream(&client, _strPath));
+      }
+    catch (PiiNetworkException& ex)
+      {
+        piiWarning(ex.message());
+      }
+    client.closeConnection();
+  }
+
+  volatile bool _bRunning;
+
+private:
+  QString _strServerAddress, _strPath;
+};
+
+/* Sends the objects arriving to an input of the compound to the
+   remote partition.
+ */
+class PiiRemotePartition::InputPump : public Pump
+{
+public:
+  InputPump(const QString& serverAddress, const QString& path, PiiAbstractInputSocket* input) :
+    Pump(serverAddress, path),
+    _pInput(input),
+    _pOutput(input->connectedOutput()),
+    _queue(input->objectName())
+  {
+    _pOutput->disconnectInput(_pInput);
+    _pOutput->connectInput(&_queue);
+  }
+
+  void close()
+  {
+    _bRunning = false;
+    // Releases a sender blocked on the queue.
+    _queue.close();
+    Pump::close();
+  }
+
+  void restore()
+  {
+    _pOutput->disconnectInput(&_queue);
+    _pOutput->connectInput(_pInput);
+  }
+
+protected:
+  void pump(QIODevice* device)
+  {
+    PiiDataStream::send(device, &_queue, PiiWireFormat::NoCompression, this);
+  }
+
+private:
+  PiiAbstractInputSocket* _pInput;
+  PiiAbstractOutputSocket* _pOutput;
+  PiiDataStream::Queue _queue;
+};
+
+/* Passes the objects emitted by an output of the remote partition to
+   the inputs connected to the corresponding output of the compound.
+ */
+class PiiRemotePartition::OutputPump : public Pump
+{
+public:
+  OutputPump(const QString& serverAddress, const QString& path, PiiAbstractOutputSocket* output) :
+    Pump(serverAddress, path),
+    _pOutput(output),
+    _lstInputs(output->connectedInputs()),
+    _bridge(output->objectName()),
+    _iWindow(INT_MAX)
+  {
+    _pOutput->disconnectInputs();
+    for (int i=0; i<_lstInputs.size(); ++i)
+      {
+        _bridge.connectInput(_lstInputs[i]);
+        _iWindow = qMin(_iWindow, PiiDataStream::queueCapacity(_lstInputs[i]));
+      }
+  }
+
+  void close()
+  {
+    _bRunning = false;
+    // Releases an emission blocked on the receivers.
+    _bridge.interrupt();
+    Pump::close();
+  }
+
+  void restore()
+  {
+    _bridge.disconnectInputs();
+    for (int i=0; i<_lstInputs.size(); ++i)
+      _pOutput->connectInput(_lstInputs[i]);
+  }
+
+  /// The number of stop tags passed to the receivers.
+  PiiAtomicInt stopTags;
+
+protected:
+  void pump(QIODevice* device)
+  {
+    PiiDataStream::receive(device, &_bridge, _iWindow, this, &stopTags);
+  }
+
+private:
+  PiiAbstractOutputSocket* _pOutput;
+  QList<PiiAbstractInputSocket*> _lstInputs;
+  PiiOutputSocket _bridge;
+  int _iWindow;
+};
+
+class PiiRemotePartition::Monitor : public QThread
+{
+public:
+  Monitor(PiiRemotePartition* partition) : _pPartition(partition) {}
+
+protected:
+  void run() { _pPartition->monitorState(); }
+
+private:
+  PiiRemotePartition* _pPartition;
+};
+
+PiiRemotePartition::PiiRemotePartition(PiiOperationCompound* compound) :
+  _pCompound(compound),
+  _pControl(0),
+  _pMonitor(new Monitor(this)),
+  _bMonitoring(false)
+{}
+
+PiiRemotePartition::~PiiRemotePartition()
+{
+  stopMonitor();
+  closeStreams();
+  undeploy();
+  delete _pMonitor;
+}
+
+void PiiRemotePartition::check(bool reset)
+{
+  if (reset || _pControl == 0 || _strNode != _pCompound->node())
+    {
+      stopMonitor();
+      closeStreams();
+      undeploy();
+      deploy();
+    }
+  call("check", QVariantList() << reset);
+  if (_lstPumps.isEmpty())
+    openStreams();
+}
+
+void PiiRemotePartition::start()
+{
+  _stopTime = QTime();
+  call("start");
+  if (!_pMonitor->isRunning())
+    {
+      _bMonitoring = true;
+      _pMonitor->start();
+    }
+}
+
+void PiiRemotePartition::pause()
+{
+  call("pause");
+}
+
+void PiiRemotePartition::stop()
+{
+  call("stop");
+}
+
+void PiiRemotePartition::interrupt()
+{
+  try
+    {
+      call("interrupt");
+    }
+  catch (PiiExecutionException& ex)
+    {
+      // The monitor notices the broken connection and stops the
+      // compound.
+      piiWarning(ex.message());
+    }
+}
+
+void PiiRemotePartition::deploy()
+{
+  _strNode = _pCompound->node();
+  QRegExp uriExp("([^:]+://[^/]+)(/[^ ]*)?");
+  if (!uriExp.exactMatch(_strNode))
+    PII_THROW(PiiExecutionException, tr("\"%1\" is not a valid node URI.").arg(_strNode));
+  _strServerAddress = uriExp.cap(1);
+  _strPath = uriExp.cap(2);
+  if (!_strPath.endsWith('/'))
+    _strPath.append('/');
+  _strPath += "partitions/" + QUuid::createUuid().toString().mid(1, 36) + "/";
+
+  QByteArray aData;
+  try
+    {
+      PiiOperation* pOperation = _pCompound;
+      aData = PiiSerialization::toByteArray<PiiGenericTextOutputArchive>(pOperation);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      PII_THROW(PiiExecutionException, tr("Could not serialize %1: %2").arg(_pCompound->objectName()).arg(ex.message()));
+    }
+
+  PiiNetworkClient client(_strServerAddress);
+  QIODevice* pSocket = client.openConnection();
+  if (pSocket == 0)
+    PII_THROW(PiiExecutionException, tr("Could not connect to %1.").arg(_strServerAddress));
+
+  PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
+  h.setRequest("POST", _strPath.left(_strPath.size()-1));
+  h.setHeader("Content-Type", PiiNetwork::pTextArchiveContentType);
+  h.setHeader("X-Into-Plugins", PiiEngine::usedPluginLibraryNames(_pCompound).join(","));
+  h.startOutputFiltering(new PiiStreamBuffer);
+  h.write(aData);
+  h.finish();
+  if (!h.readHeader())
+    PII_THROW(PiiExecutionException, tr("%1 did not respond to a deployment request.").arg(_strNode));
+  if (h.status() != PiiHttpProtocol::OkStatus)
+    PII_THROW(PiiExecutionException, tr("%1 refused to run %2: %3")
+              .arg(_strNode).arg(_pCompound->objectName()).arg(QString::fromUtf8(h.readBody())));
+  h.readBody();
+
+  try
+    {
+      _pControl = new PiiRemoteObject(_strServerAddress + _strPath);
+    }
+  catch (PiiException& ex)
+    {
+      PII_THROW(PiiExecutionException, ex.message());
+    }
+}
+
+void PiiRemotePartition::undeploy()
+{
+  if (_pControl == 0)
+    return;
+  delete _pControl;
+  _pControl = 0;
+
+  PiiNetworkClient client(_strServerAddress);
+  QIODevice* pSocket = client.openConnection();
+  if (pSocket == 0)
+    {
+      piiWarning(tr("Could not remove a partition from %1.").arg(_strNode));
+      return;
+    }
+  PiiHttpDevice h(pSocket, PiiHttpDevice::Client);
+  h.setRequest("DELETE", _strPath.left(_strPath.size()-1));
+  h.finish();
+  if (h.readHeader())
+    h.readBody();
+}
+
+void PiiRemotePartition::openStreams()
+{
+  QString strStreamPath = _strPath + "streams/";
+  QStringList lstInputs = _pCompound->inputNames();
+  for (int i=0; i<lstInputs.size(); ++i)
+    {
+      PiiAbstractInputSocket* pInput = _pCompound->input(lstInputs[i]);
+      if (pInput->connectedOutput() != 0)
+        _lstPumps << new InputPump(_strServerAddress, strStreamPath + "inputs/" + lstInputs[i], pInput);
+    }
+  QStringList lstOutputs = _pCompound->outputNames();
+  for (int i=0; i<lstOutputs.size(); ++i)
+    {
+      PiiAbstractOutputSocket* pOutput = _pCompound->output(lstOutputs[i]);
+      if (!pOutput->connectedInputs().isEmpty())
+        _lstPumps << new OutputPump(_strServerAddress, strStreamPath + "outputs/" + lstOutputs[i], pOutput);
+    }
+  for (int i=0; i<_lstPumps.size(); ++i)
+    _lstPumps[i]->start();
+}
+
+void PiiRemotePartition::closeStreams()
+{
+  for (int i=0; i<_lstPumps.size(); ++i)
+    _lstPumps[i]->close();
+  for (int i=0; i<_lstPumps.size(); ++i)
+    _lstPumps[i]->restore();
+  qDeleteAll(_lstPumps);
+  _lstPumps.clear();
+}
+
+void PiiRemotePartition::stopMonitor()
+{
+  _bMonitoring = false;
+  _pMonitor->wait();
+}
+
+QVariant PiiRemotePartition::call(const QString& function, const QVariantList& params)
+{
+  try
+    {
+      return _pControl->callList(function, params);
+    }
+  catch (PiiExecutionException&)
+    {
+      throw;
+    }
+  catch (PiiException& ex)
+    {
+      PII_THROW(PiiExecutionException, tr("Calling %1() on %2 failed: %3").arg(function).arg(_strNode).arg(ex.message()));
+    }
+}
+
+void PiiRemotePartition::monitorState()
+{
+  // The control object is not shared with the thread that commands
+  // the compound.
+  PiiRemoteObject* pRemote = 0;
+  try
+    {
+      pRemote = new PiiRemoteObject(_strServerAddress + _strPath);
+    }
+  catch (PiiException& ex)
+    {
+      piiWarning(ex.message());
+    }
+
+  while (_bMonitoring)
+    {
+      PiiOperation::State remoteState = PiiOperation::Stopped;
+      bool bConnectionLost = pRemote == 0;
+      if (pRemote != 0)
+        {
+          try
+            {
+              remoteState = PiiOperation::State(pRemote->callList("state", QVariantList()).toInt());
+            }
+          catch (PiiException& ex)
+            {
+              piiWarning(tr("Lost connection to %1: %2").arg(_strNode).arg(ex.message()));
+              bConnectionLost = true;
+            }
+        }
+      if (updateState(remoteState, bConnectionLost))
+        break;
+      PiiDelay::msleep(50);
+    }
+  delete pRemote;
+}
+
+bool PiiRemotePartition::updateState(PiiOperation::State remoteState, bool connectionLost)
+{
+  QMutexLocker lock(&_pCompound->_d()->stateMutex);
+  PiiOperation::State localState = _pCompound->state();
+  switch (remoteState)
+    {
+    case PiiOperation::Running:
+      if (localState == PiiOperation::Starting)
+        _pCompound->setState(PiiOperation::Running);
+      break;
+    case PiiOperation::Pausing:
+    case PiiOperation::Stopping:
+      if (localState == PiiOperation::Running)
+        _pCompound->setState(remoteState);
+      break;
+    case PiiOperation::Paused:
+      if (localState == PiiOperation::Running)
+        _pCompound->setState(PiiOperation::Pausing);
+      if (_pCompound->state() == PiiOperation::Pausing)
+        _pCompound->setState(PiiOperation::Paused);
+      break;
+    case PiiOperation::Stopped:
+      if (localState == PiiOperation::Stopped)
+        return true;
+      if (localState member_of (PiiOperation::Starting, PiiOperation::Running,
+                                PiiOperation::Pausing, PiiOperation::Paused))
+        _pCompound->setState(PiiOperation::Stopping);
+      if (_stopTime.isNull())
+        _stopTime.start();
+      // Wait for the stop tags to reach the receivers before
+      // announcing the stop. Otherwise the next operations could
+      // still be waiting for the last objects when the engine stops.
+      if (connectionLost ||
+          _pCompound->state() == PiiOperation::Interrupted ||
+          outputsStopped() ||
+          _stopTime.elapsed() > iStopTagTimeout)
+        {
+          closeStreams();
+          _pCompound->setState(PiiOperation::Stopped);
+          return true;
+        }
+      break;
+    default:
+      break;
+    }
+  return false;
+}
+
+bool PiiRemotePartition::outputsStopped() const
+{
+  for (int i=0; i<_lstPumps.size(); ++i)
+    {
+      OutputPump* pPump = dynamic_cast<OutputPump*>(_lstPumps[i]);
+      if (pPump != 0 && pPump->stopTags.load() == 0)
+        return false;
+    }
+  return true;
+}
@@ -0,0 +1,84 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+#ifndef _PIIREMOTEPARTITION_H
+#define _PIIREMOTEPARTITION_H
+
+#include "PiiOperation.h"
+
+#include <QTime>
+
+class PiiOperationCompound;
+class PiiRemoteObject;
+
+/**
+ * Runs the children of a compound on a remote PiiEngineNode. The
+ * compound is serialized and deployed to the node given by its
+ * [node](PiiOperationCompound::node) property. Its inputs and outputs
+ * are detached from the local children and connected to data
+ * streams that carry objects and control tags to and from the
+ * partition. The state of the remote partition is polled and
+ * reflected to the compound until it stops.
+ *
+ * @internal
+ */
+class PiiRemotePartition
+{
+public:
+  PiiRemotePartition(PiiOperationCompound* compound);
+  /**
+   * Closes the streams, restores the original connections and
+   * destroys the remote partition.
+   */
+  ~PiiRemotePartition();
+
+  /**
+   * Deploys the compound to its node unless it is already there and
+   * *reset* is `false`, checks the remote partition and opens the
+   * streams.
+   */
+  void check(bool reset);
+  void start();
+  void pause();
+  void stop();
+  void interrupt();
+
+private:
+  class Pump;
+  class InputPump;
+  class OutputPump;
+  class Monitor;
+
+  void deploy();
+  void undeploy();
+  void openStreams();
+  void closeStreams();
+  void stopMonitor();
+  QVariant call(const QString& function, const QVariantList& params = QVariantList());
+  void monitorState();
+  bool updateState(PiiOperation::State remoteState, bool connectionLost);
+  bool outputsStopped() const;
+
+  PiiOperationCompound* _pCompound;
+  QString _strNode, _strServerAddress, _strPath;
+  PiiRemoteObject* _pControl;
+  QList<Pump*> _lstPumps;
+  Monitor* _pMonitor;
+  volatile bool _bMonitoring;
+  QTime _stopTime;
+
+  PII_DISABLE_COPY(PiiRemotePartition);
+};
+
+#endif //_PIIREMOTEPARTITION_H
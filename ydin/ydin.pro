@@ -1,11 +1,27 @@
 TEMPLATE        = lib
 TARGET          = piiydin
-HEADERS         = *.h
-SOURCES         = *.cc
+qt {
+  HEADERS         = *.h
+  SOURCES         = *.cc
 
-!contains(DISABLE,network) {
-  HEADERS += network/*.h
-  SOURCES += network/*.cc
+  !contains(DISABLE,network) {
+    HEADERS += network/*.h
+    SOURCES += network/*.cc
+  } else {
+    DEFINES += PII_NO_NETWORK
+  }
+} else {
+  # The execution engine without properties by name, serialization,
+  # plugins or PiiEngine. Threads need C++11.
+  c++03: error("ydin cannot be built without Qt in C++03 mode.")
+  SOURCES = PiiAbstractInputSocket.cc PiiAbstractOutputSocket.cc PiiBasicOperation.cc PiiDefaultFlowController.cc \
+    PiiDefaultOperation.cc PiiExecutionException.cc PiiFlowController.cc PiiFuture.cc PiiInputController.cc \
+    PiiInputListener.cc PiiInputSocket.cc PiiLatencyHistogram.cc PiiMemoryBudget.cc PiiMultiThreadedProcessor.cc \
+    PiiNullInputController.cc PiiOneGroupFlowController.cc PiiOneInputFlowController.cc PiiOperation.cc \
+    PiiOperationCompound.cc PiiOperationProcessor.cc PiiOperationStatistics.cc PiiOutputSocket.cc PiiProfiler.cc \
+    PiiProxySocket.cc PiiResourceConnector.cc PiiScheduler.cc PiiSimpleProcessor.cc PiiSocket.cc PiiThreadPool.cc \
+    PiiThreadedProcessor.cc PiiYdin.cc PiiYdinTypes.cc
+  DEFINES += PII_NO_NETWORK
 }
 
 INTODIR = ..